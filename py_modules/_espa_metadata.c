@@ -0,0 +1,2102 @@
+/*****************************************************************************
+FILE: _espa_metadata.c
+
+PURPOSE: Python extension module which reads and writes the ESPA internal
+metadata with the C metadata library, for fast scanning of many XML files
+from Python and fast writing of the products built in Python.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. This module is normally used through metadata_fast.py, which provides
+     the same accessors as the generateDS objects of metadata_api.py.
+  2. The XML is parsed with parse_metadata_lazy, so the bitmap descriptions,
+     classes, cover types, QA description and statistics of the bands are
+     only read from the XML if band_details is called.
+  3. The fields of the global metadata and of each band are converted to
+     Python objects only when they are requested.
+  4. Fill values in the metadata structure are returned as None, as are the
+     missing elements in metadata_api.py.
+  5. map_band maps a band with open_raw_binary_mapped and returns a
+     MappedBand, which exports the band data through the buffer protocol so
+     numpy (see espa_bands.py) can use it without copying.
+  6. write_metadata and append_metadata take the same dictionaries the
+     Metadata object returns, with None for the missing elements, and write
+     them with the C write_metadata and append_metadata.
+*****************************************************************************/
+
+#include <Python.h>
+#include <math.h>
+#include <limits.h>
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+#include "write_metadata.h"
+#include "gctp_defines.h"
+
+#if PY_MAJOR_VERSION >= 3
+#define STR_FROM_C PyUnicode_FromString
+#define STR_AS_C PyUnicode_AsUTF8
+#else
+#define STR_FROM_C PyString_FromString
+#define STR_AS_C PyString_AsString
+#endif
+
+/* Metadata object; owns the parsed metadata structure */
+typedef struct
+{
+    PyObject_HEAD
+    Espa_internal_meta_t meta;    /* parsed metadata */
+    bool parsed;                  /* was the metadata parsed (i.e. does it
+                                     need to be freed) */
+    char xml_dir[PATH_MAX];       /* directory of the XML file, including the
+                                     trailing '/'; empty for the current
+                                     directory */
+} Metadata_object_t;
+
+/* Mapped band object; owns the mapping of the band */
+typedef struct
+{
+    PyObject_HEAD
+    Raw_binary_mapped_t rbmap;    /* mapped band */
+    bool mapped;                  /* is the band still mapped */
+    int exports;                  /* number of buffers exported from the
+                                     mapping which haven't been released */
+} Mapped_band_object_t;
+
+static PyTypeObject Mapped_band_type;
+
+/* Names of the data types, as they are written to the XML file */
+static const char *data_type_names[] = {"INT8", "UINT8", "INT16", "UINT16",
+    "INT32", "UINT32", "FLOAT32", "FLOAT64"};
+
+
+/******************************************************************************
+MODULE:  str_or_none
+
+PURPOSE: Converts a metadata string to a Python string, or None if it's fill.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the Python object
+non-NULL        New reference to the string or None
+
+NOTES:
+******************************************************************************/
+static PyObject *str_or_none
+(
+    const char *str             /* I: metadata string */
+)
+{
+    if (str[0] == '\0' || !strcmp (str, ESPA_STRING_META_FILL))
+        Py_RETURN_NONE;
+    return (STR_FROM_C (str));
+}
+
+
+/******************************************************************************
+MODULE:  int_or_none
+
+PURPOSE: Converts a metadata integer to a Python integer, or None if it's
+fill.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the Python object
+non-NULL        New reference to the integer or None
+
+NOTES:
+******************************************************************************/
+static PyObject *int_or_none
+(
+    long value                  /* I: metadata integer */
+)
+{
+    if (value == ESPA_INT_META_FILL)
+        Py_RETURN_NONE;
+    return (PyLong_FromLong (value));
+}
+
+
+/******************************************************************************
+MODULE:  float_or_none
+
+PURPOSE: Converts a metadata float to a Python float, or None if it's fill.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the Python object
+non-NULL        New reference to the float or None
+
+NOTES:
+******************************************************************************/
+static PyObject *float_or_none
+(
+    double value                /* I: metadata float */
+)
+{
+    if (fabs (value - ESPA_FLOAT_META_FILL) < ESPA_EPSILON)
+        Py_RETURN_NONE;
+    return (PyFloat_FromDouble (value));
+}
+
+
+/******************************************************************************
+MODULE:  set_item
+
+PURPOSE: Adds a value to a dictionary, releasing the reference to the value.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value is NULL or couldn't be added
+0               The value was added
+
+NOTES:
+******************************************************************************/
+static int set_item
+(
+    PyObject *dict,             /* I/O: dictionary */
+    const char *key,            /* I: key of the value */
+    PyObject *value             /* I: new reference to the value; may be
+                                      NULL after an error */
+)
+{
+    int status;                 /* return status */
+
+    if (value == NULL)
+        return (-1);
+    status = PyDict_SetItemString (dict, key, value);
+    Py_DECREF (value);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_band
+
+PURPOSE: Returns the band with the specified index, raising IndexError if
+there isn't one.
+
+RETURN VALUE:
+Type = Espa_band_meta_t *
+Value           Description
+-----           -----------
+NULL            The index is out of range
+non-NULL        Band metadata
+
+NOTES:
+******************************************************************************/
+static Espa_band_meta_t *get_band
+(
+    Metadata_object_t *self,    /* I: metadata object */
+    int index                   /* I: index of the band */
+)
+{
+    if (index < 0 || index >= self->meta.nbands)
+    {
+        PyErr_SetString (PyExc_IndexError, "band index out of range");
+        return (NULL);
+    }
+    return (&self->meta.band[index]);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_init
+
+PURPOSE: Parses the XML file into the metadata object.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Error parsing the XML file; IOError is raised
+0               Successfully parsed the XML file
+
+NOTES:
+  1. The band details are left out (see parse_metadata_lazy).
+******************************************************************************/
+static int metadata_init
+(
+    Metadata_object_t *self,    /* I/O: metadata object */
+    PyObject *args,             /* I: XML filename */
+    PyObject *kwds              /* I: unused */
+)
+{
+    char *xml_file = NULL;      /* name of the XML file */
+    char *slash = NULL;         /* last '/' in the XML filename */
+    int status;                 /* return status */
+
+    if (!PyArg_ParseTuple (args, "s", &xml_file))
+        return (-1);
+
+    /* The band files are relative to the directory of the XML file */
+    slash = strrchr (xml_file, '/');
+    if (slash != NULL && slash - xml_file + 1 >= PATH_MAX)
+    {
+        PyErr_SetString (PyExc_ValueError, "XML filename is too long");
+        return (-1);
+    }
+    self->xml_dir[0] = '\0';
+    if (slash != NULL)
+    {
+        memcpy (self->xml_dir, xml_file, slash - xml_file + 1);
+        self->xml_dir[slash - xml_file + 1] = '\0';
+    }
+
+    if (self->parsed)
+    {
+        free_metadata (&self->meta);
+        self->parsed = false;
+    }
+
+    init_metadata_struct (&self->meta);
+    Py_BEGIN_ALLOW_THREADS
+    status = parse_metadata_lazy (xml_file, &self->meta);
+    Py_END_ALLOW_THREADS
+    self->parsed = true;
+    if (status != SUCCESS)
+    {
+        PyErr_Format (PyExc_IOError, "Unable to parse the metadata file %s",
+            xml_file);
+        return (-1);
+    }
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_dealloc
+
+PURPOSE: Frees the metadata object.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void metadata_dealloc
+(
+    Metadata_object_t *self     /* I: metadata object */
+)
+{
+    if (self->parsed)
+        free_metadata (&self->meta);
+    Py_TYPE (self)->tp_free ((PyObject *) self);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_len
+
+PURPOSE: Returns the number of bands.
+
+RETURN VALUE:
+Type = Py_ssize_t
+Value           Description
+-----           -----------
+>= 0            Number of bands
+
+NOTES:
+******************************************************************************/
+static Py_ssize_t metadata_len
+(
+    Metadata_object_t *self     /* I: metadata object */
+)
+{
+    return (self->parsed ? self->meta.nbands : 0);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_global
+
+PURPOSE: Returns the global metadata as a dictionary.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the dictionary
+non-NULL        Dictionary of the global metadata
+
+NOTES:
+  1. The keys follow the element and attribute names of the XML file, with
+     the nested elements (e.g. wrs) flattened into prefixed keys.  The
+     projection and datum are returned as they are written to the XML file
+     (e.g. "UTM", "WGS84").
+******************************************************************************/
+static PyObject *metadata_global
+(
+    Metadata_object_t *self,    /* I: metadata object */
+    PyObject *unused            /* I: no arguments */
+)
+{
+    Espa_global_meta_t *gmeta = &self->meta.global;  /* global metadata */
+    Espa_proj_meta_t *proj = &gmeta->proj_info;      /* projection info */
+    const char *projection = NULL;  /* projection name */
+    const char *datum = NULL;   /* datum name; NULL if there is none */
+    PyObject *dict = NULL;      /* global metadata dictionary */
+
+    switch (proj->proj_type)
+    {
+        case GCTP_GEO_PROJ: projection = "GEO"; break;
+        case GCTP_UTM_PROJ: projection = "UTM"; break;
+        case GCTP_ALBERS_PROJ: projection = "ALBERS"; break;
+        case GCTP_PS_PROJ: projection = "PS"; break;
+        case GCTP_SIN_PROJ: projection = "SIN"; break;
+        default: projection = ESPA_STRING_META_FILL; break;
+    }
+
+    switch (proj->datum_type)
+    {
+        case ESPA_WGS84: datum = "WGS84"; break;
+        case ESPA_NAD27: datum = "NAD27"; break;
+        case ESPA_NAD83: datum = "NAD83"; break;
+        default: datum = ESPA_STRING_META_FILL; break;
+    }
+
+    dict = PyDict_New ();
+    if (dict == NULL)
+        return (NULL);
+
+    if (set_item (dict, "namespace",
+            str_or_none (self->meta.meta_namespace)) ||
+        set_item (dict, "data_provider", str_or_none (gmeta->data_provider)) ||
+        set_item (dict, "satellite", str_or_none (gmeta->satellite)) ||
+        set_item (dict, "instrument", str_or_none (gmeta->instrument)) ||
+        set_item (dict, "acquisition_date",
+            str_or_none (gmeta->acquisition_date)) ||
+        set_item (dict, "scene_center_time",
+            str_or_none (gmeta->scene_center_time)) ||
+        set_item (dict, "level1_production_date",
+            str_or_none (gmeta->level1_production_date)) ||
+        set_item (dict, "solar_zenith", float_or_none (gmeta->solar_zenith)) ||
+        set_item (dict, "solar_azimuth",
+            float_or_none (gmeta->solar_azimuth)) ||
+        set_item (dict, "solar_units", str_or_none (gmeta->solar_units)) ||
+        set_item (dict, "earth_sun_distance",
+            float_or_none (gmeta->earth_sun_dist)) ||
+        set_item (dict, "wrs_system", int_or_none (gmeta->wrs_system)) ||
+        set_item (dict, "wrs_path", int_or_none (gmeta->wrs_path)) ||
+        set_item (dict, "wrs_row", int_or_none (gmeta->wrs_row)) ||
+        set_item (dict, "htile", int_or_none (gmeta->htile)) ||
+        set_item (dict, "vtile", int_or_none (gmeta->vtile)) ||
+        set_item (dict, "product_id", str_or_none (gmeta->product_id)) ||
+        set_item (dict, "lpgs_metadata_file",
+            str_or_none (gmeta->lpgs_metadata_file)) ||
+        set_item (dict, "ul_corner", Py_BuildValue ("(dd)",
+            gmeta->ul_corner[0], gmeta->ul_corner[1])) ||
+        set_item (dict, "lr_corner", Py_BuildValue ("(dd)",
+            gmeta->lr_corner[0], gmeta->lr_corner[1])) ||
+        set_item (dict, "bounding_coordinates", Py_BuildValue ("(dddd)",
+            gmeta->bounding_coords[ESPA_WEST],
+            gmeta->bounding_coords[ESPA_EAST],
+            gmeta->bounding_coords[ESPA_NORTH],
+            gmeta->bounding_coords[ESPA_SOUTH])) ||
+        set_item (dict, "orientation_angle",
+            float_or_none (gmeta->orientation_angle)) ||
+        set_item (dict, "valid_mask", str_or_none (gmeta->valid_mask)) ||
+        set_item (dict, "projection", str_or_none (projection)) ||
+        set_item (dict, "datum", str_or_none (datum)) ||
+        set_item (dict, "proj_units", str_or_none (proj->units)) ||
+        set_item (dict, "proj_ul_corner", Py_BuildValue ("(dd)",
+            proj->ul_corner[0], proj->ul_corner[1])) ||
+        set_item (dict, "proj_lr_corner", Py_BuildValue ("(dd)",
+            proj->lr_corner[0], proj->lr_corner[1])) ||
+        set_item (dict, "grid_origin", str_or_none (proj->grid_origin)) ||
+        set_item (dict, "utm_zone", int_or_none (proj->utm_zone)) ||
+        set_item (dict, "longitude_pole",
+            float_or_none (proj->longitude_pole)) ||
+        set_item (dict, "latitude_true_scale",
+            float_or_none (proj->latitude_true_scale)) ||
+        set_item (dict, "false_easting", float_or_none (proj->false_easting)) ||
+        set_item (dict, "false_northing",
+            float_or_none (proj->false_northing)) ||
+        set_item (dict, "standard_parallel1",
+            float_or_none (proj->standard_parallel1)) ||
+        set_item (dict, "standard_parallel2",
+            float_or_none (proj->standard_parallel2)) ||
+        set_item (dict, "central_meridian",
+            float_or_none (proj->central_meridian)) ||
+        set_item (dict, "origin_latitude",
+            float_or_none (proj->origin_latitude)) ||
+        set_item (dict, "sphere_radius", float_or_none (proj->sphere_radius)))
+    {
+        Py_DECREF (dict);
+        return (NULL);
+    }
+
+    return (dict);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_band
+
+PURPOSE: Returns the main fields of a band as a dictionary.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the dictionary, or the index is out of range
+non-NULL        Dictionary of the band metadata
+
+NOTES:
+  1. The band details are returned by band_details.
+  2. The data type and resampling method are returned as they are written to
+     the XML file (e.g. "INT16", "cubic convolution").
+******************************************************************************/
+static PyObject *metadata_band
+(
+    Metadata_object_t *self,    /* I: metadata object */
+    PyObject *args              /* I: index of the band */
+)
+{
+    static const char *rtypes[] = {"cubic convolution", "nearest neighbor",
+        "bilinear", "none"};                        /* resampling names */
+    int index;                  /* index of the band */
+    Espa_band_meta_t *bmeta = NULL;  /* band metadata */
+    PyObject *dict = NULL;      /* band metadata dictionary */
+
+    if (!PyArg_ParseTuple (args, "i", &index))
+        return (NULL);
+    bmeta = get_band (self, index);
+    if (bmeta == NULL)
+        return (NULL);
+
+    dict = PyDict_New ();
+    if (dict == NULL)
+        return (NULL);
+
+    if (set_item (dict, "product", str_or_none (bmeta->product)) ||
+        set_item (dict, "source", str_or_none (bmeta->source)) ||
+        set_item (dict, "name", str_or_none (bmeta->name)) ||
+        set_item (dict, "category", str_or_none (bmeta->category)) ||
+        set_item (dict, "data_type", STR_FROM_C (
+            bmeta->data_type >= ESPA_INT8 && bmeta->data_type <= ESPA_FLOAT64
+            ? data_type_names[bmeta->data_type] : ESPA_STRING_META_FILL)) ||
+        set_item (dict, "nlines", PyLong_FromLong (bmeta->nlines)) ||
+        set_item (dict, "nsamps", PyLong_FromLong (bmeta->nsamps)) ||
+        set_item (dict, "fill_value", int_or_none (bmeta->fill_value)) ||
+        set_item (dict, "saturate_value",
+            int_or_none (bmeta->saturate_value)) ||
+        set_item (dict, "scale_factor", float_or_none (bmeta->scale_factor)) ||
+        set_item (dict, "add_offset", float_or_none (bmeta->add_offset)) ||
+        set_item (dict, "short_name", str_or_none (bmeta->short_name)) ||
+        set_item (dict, "long_name", str_or_none (bmeta->long_name)) ||
+        set_item (dict, "file_name", str_or_none (bmeta->file_name)) ||
+        set_item (dict, "pixel_size", Py_BuildValue ("(dd)",
+            bmeta->pixel_size[0], bmeta->pixel_size[1])) ||
+        set_item (dict, "pixel_units", str_or_none (bmeta->pixel_units)) ||
+        set_item (dict, "sub_sample", Py_BuildValue ("(iii)",
+            bmeta->sub_sample.factor, bmeta->sub_sample.nlines,
+            bmeta->sub_sample.nsamps)) ||
+        set_item (dict, "resample_method", STR_FROM_C (
+            bmeta->resample_method >= ESPA_CC &&
+            bmeta->resample_method <= ESPA_NONE
+            ? rtypes[bmeta->resample_method] : ESPA_STRING_META_FILL)) ||
+        set_item (dict, "data_units", str_or_none (bmeta->data_units)) ||
+        set_item (dict, "valid_min", float_or_none (bmeta->valid_range[0])) ||
+        set_item (dict, "valid_max", float_or_none (bmeta->valid_range[1])) ||
+        set_item (dict, "rad_gain", float_or_none (bmeta->rad_gain)) ||
+        set_item (dict, "rad_bias", float_or_none (bmeta->rad_bias)) ||
+        set_item (dict, "refl_gain", float_or_none (bmeta->refl_gain)) ||
+        set_item (dict, "refl_bias", float_or_none (bmeta->refl_bias)) ||
+        set_item (dict, "k1_const", float_or_none (bmeta->k1_const)) ||
+        set_item (dict, "k2_const", float_or_none (bmeta->k2_const)) ||
+        set_item (dict, "checksum", str_or_none (bmeta->checksum)) ||
+        set_item (dict, "app_version", str_or_none (bmeta->app_version)) ||
+        set_item (dict, "production_date",
+            str_or_none (bmeta->production_date)))
+    {
+        Py_DECREF (dict);
+        return (NULL);
+    }
+
+    return (dict);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_band_details
+
+PURPOSE: Returns the details of a band (bitmap descriptions, classes, cover
+types, QA description and statistics) as a dictionary.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error loading the details or creating the dictionary, or the
+                index is out of range
+non-NULL        Dictionary of the band details
+
+NOTES:
+  1. The details of all the bands are read from the XML file the first time
+     this is called (see load_band_details).
+  2. The statistics are None if they aren't available, and the histogram is
+     None if there isn't one.
+******************************************************************************/
+static PyObject *metadata_band_details
+(
+    Metadata_object_t *self,    /* I: metadata object */
+    PyObject *args              /* I: index of the band */
+)
+{
+    int index;                  /* index of the band */
+    int i;                      /* looping variable */
+    int status;                 /* return status */
+    Espa_band_meta_t *bmeta = NULL;  /* band metadata */
+    Espa_band_stats_t *stats = NULL; /* band statistics */
+    PyObject *dict = NULL;      /* band details dictionary */
+    PyObject *list = NULL;      /* list of bits, classes or covers; owned
+                                   by dict */
+    PyObject *item = NULL;      /* current list item */
+    PyObject *stats_dict = NULL;  /* statistics dictionary; owned by dict */
+
+    if (!PyArg_ParseTuple (args, "i", &index))
+        return (NULL);
+    if (get_band (self, index) == NULL)
+        return (NULL);
+
+    if (self->meta.lazy_file != NULL)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        status = load_band_details (&self->meta);
+        Py_END_ALLOW_THREADS
+        if (status != SUCCESS)
+        {
+            PyErr_SetString (PyExc_IOError,
+                "Unable to load the band details from the metadata file");
+            return (NULL);
+        }
+    }
+    bmeta = &self->meta.band[index];
+    stats = &bmeta->stats;
+
+    dict = PyDict_New ();
+    if (dict == NULL)
+        return (NULL);
+
+    /* Bitmap descriptions, in bit order */
+    list = PyList_New (0);
+    if (set_item (dict, "bitmap_description", list))
+        goto error;
+    for (i = 0; i < bmeta->nbits; i++)
+    {
+        item = STR_FROM_C (bmeta->bitmap_description[i]);
+        if (item == NULL || PyList_Append (list, item))
+            goto error;
+        Py_DECREF (item);
+        item = NULL;
+    }
+
+    /* Classes as (num, description) */
+    list = PyList_New (0);
+    if (set_item (dict, "class_values", list))
+        goto error;
+    for (i = 0; i < bmeta->nclass; i++)
+    {
+        item = Py_BuildValue ("(is)", bmeta->class_values[i].class,
+            bmeta->class_values[i].description);
+        if (item == NULL || PyList_Append (list, item))
+            goto error;
+        Py_DECREF (item);
+        item = NULL;
+    }
+
+    /* Cover types as (type, percent) */
+    list = PyList_New (0);
+    if (set_item (dict, "percent_coverage", list))
+        goto error;
+    for (i = 0; i < bmeta->ncover; i++)
+    {
+        item = Py_BuildValue ("(sd)", bmeta->percent_cover[i].description,
+            (double) bmeta->percent_cover[i].percent);
+        if (item == NULL || PyList_Append (list, item))
+            goto error;
+        Py_DECREF (item);
+        item = NULL;
+    }
+
+    if (set_item (dict, "qa_description", str_or_none (bmeta->qa_desc)))
+        goto error;
+
+    /* Constant value of a constant band */
+    if (bmeta->constant.is_constant)
+    {
+        if (set_item (dict, "constant", Py_BuildValue ("(ds)",
+            bmeta->constant.value, bmeta->constant.fill_band)))
+            goto error;
+    }
+    else
+    {
+        Py_INCREF (Py_None);
+        if (set_item (dict, "constant", Py_None))
+            goto error;
+    }
+
+    /* Expression of a derived band */
+    if (set_item (dict, "derived", str_or_none (bmeta->derived.is_derived
+        ? bmeta->derived.expression : "")))
+        goto error;
+
+    /* Tile size of a tiled band */
+    if (bmeta->tiling.is_tiled)
+    {
+        if (set_item (dict, "tiling", Py_BuildValue ("(ii)",
+            bmeta->tiling.nlines, bmeta->tiling.nsamps)))
+            goto error;
+    }
+    else
+    {
+        Py_INCREF (Py_None);
+        if (set_item (dict, "tiling", Py_None))
+            goto error;
+    }
+
+    /* Stage which wrote the band */
+    if (bmeta->provenance.stage[0] != '\0')
+    {
+        if (set_item (dict, "provenance", Py_BuildValue ("(ss)",
+            bmeta->provenance.stage, bmeta->provenance.key)))
+            goto error;
+    }
+    else
+    {
+        Py_INCREF (Py_None);
+        if (set_item (dict, "provenance", Py_None))
+            goto error;
+    }
+
+    /* Statistics */
+    if (stats->valid_pixels == ESPA_INT_META_FILL)
+    {
+        Py_INCREF (Py_None);
+        if (set_item (dict, "statistics", Py_None))
+            goto error;
+        return (dict);
+    }
+    stats_dict = PyDict_New ();
+    if (set_item (dict, "statistics", stats_dict))
+        goto error;
+    if (set_item (stats_dict, "valid_pixels",
+            PyLong_FromLong (stats->valid_pixels)) ||
+        set_item (stats_dict, "fill_pixels",
+            PyLong_FromLong (stats->fill_pixels)) ||
+        set_item (stats_dict, "out_of_range_pixels",
+            PyLong_FromLong (stats->out_of_range_pixels)) ||
+        set_item (stats_dict, "min", PyFloat_FromDouble (stats->min)) ||
+        set_item (stats_dict, "max", PyFloat_FromDouble (stats->max)) ||
+        set_item (stats_dict, "mean", PyFloat_FromDouble (stats->mean)) ||
+        set_item (stats_dict, "stddev", PyFloat_FromDouble (stats->stddev)))
+        goto error;
+    if (stats->nbins > 0)
+    {
+        list = PyList_New (stats->nbins);
+        if (set_item (stats_dict, "histogram", list))
+            goto error;
+        for (i = 0; i < stats->nbins; i++)
+        {
+            item = PyLong_FromLong (stats->histogram[i]);
+            if (item == NULL)
+                goto error;
+            PyList_SET_ITEM (list, i, item);   /* steals the reference */
+            item = NULL;
+        }
+        if (set_item (stats_dict, "hist_min",
+                PyFloat_FromDouble (stats->hist_min)) ||
+            set_item (stats_dict, "hist_max",
+                PyFloat_FromDouble (stats->hist_max)))
+            goto error;
+    }
+    else
+    {
+        Py_INCREF (Py_None);
+        if (set_item (stats_dict, "histogram", Py_None))
+            goto error;
+    }
+
+    return (dict);
+
+error:
+    /* The lists and statistics are owned by the dictionaries once added */
+    Py_XDECREF (item);
+    Py_DECREF (dict);
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  metadata_find_band
+
+PURPOSE: Finds the first band which matches the specified product, name and
+category.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error parsing the arguments
+non-NULL        Index of the band, or None if no band matches
+
+NOTES:
+  1. A product, name or category of None matches any band.
+  2. The bands are looked up through the band index (see find_band_metadata).
+******************************************************************************/
+static PyObject *metadata_find_band
+(
+    Metadata_object_t *self,    /* I: metadata object */
+    PyObject *args,             /* I: product, name and category */
+    PyObject *kwds              /* I: keyword arguments */
+)
+{
+    static char *kwlist[] = {"product", "name", "category", NULL};
+    char *product = NULL;       /* product of the band; NULL for any */
+    char *name = NULL;          /* name of the band; NULL for any */
+    char *category = NULL;      /* category of the band; NULL for any */
+    int index;                  /* index of the band */
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwds, "|zzz", kwlist, &product,
+        &name, &category))
+        return (NULL);
+
+    index = find_band_metadata (&self->meta, product, name, category);
+    if (index < 0)
+        Py_RETURN_NONE;
+    return (PyLong_FromLong (index));
+}
+
+
+/******************************************************************************
+MODULE:  metadata_map_band
+
+PURPOSE: Memory maps the band with the specified index.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error mapping the band, or the index is out of range
+non-NULL        MappedBand object
+
+NOTES:
+  1. A band file name without a directory is taken to be in the directory of
+     the XML file.
+  2. access is "sequential" or "random" (see Raw_binary_access_t).
+  3. Compressed (chunked) bands are decoded into memory instead, and can
+     only be opened read-only (see open_raw_binary_mapped).
+******************************************************************************/
+static PyObject *metadata_map_band
+(
+    Metadata_object_t *self,    /* I: metadata object */
+    PyObject *args,             /* I: index of the band */
+    PyObject *kwds              /* I: writable and access */
+)
+{
+    static char *kwlist[] = {"index", "writable", "access", NULL};
+    int index;                  /* index of the band */
+    int writable = 0;           /* should the band be mapped for writing */
+    int status;                 /* return status */
+    int count;                  /* number of characters in the filename */
+    char *access = "sequential";  /* expected access pattern */
+    Raw_binary_access_t rb_access;  /* expected access pattern */
+    Espa_band_meta_t *bmeta = NULL;  /* band metadata */
+    Espa_band_meta_t *band = NULL;   /* copy of the band with the full
+                                        filename */
+    Mapped_band_object_t *mapped = NULL;  /* mapped band object */
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwds, "i|is", kwlist, &index,
+        &writable, &access))
+        return (NULL);
+    bmeta = get_band (self, index);
+    if (bmeta == NULL)
+        return (NULL);
+
+    if (!strcmp (access, "sequential"))
+        rb_access = RB_ACCESS_SEQUENTIAL;
+    else if (!strcmp (access, "random"))
+        rb_access = RB_ACCESS_RANDOM;
+    else
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "access must be 'sequential' or 'random'");
+        return (NULL);
+    }
+
+    band = malloc (sizeof (Espa_band_meta_t));
+    if (band == NULL)
+        return (PyErr_NoMemory ());
+    *band = *bmeta;
+    count = snprintf (band->file_name, sizeof (band->file_name), "%s%s",
+        bmeta->file_name[0] == '/' ? "" : self->xml_dir, bmeta->file_name);
+    if (count < 0 || count >= (int) sizeof (band->file_name))
+    {
+        free (band);
+        PyErr_SetString (PyExc_ValueError, "Band filename is too long");
+        return (NULL);
+    }
+
+    mapped = PyObject_New (Mapped_band_object_t, &Mapped_band_type);
+    if (mapped == NULL)
+    {
+        free (band);
+        return (NULL);
+    }
+    mapped->mapped = false;
+    mapped->exports = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = open_raw_binary_mapped (band, writable != 0, rb_access,
+        &mapped->rbmap);
+    Py_END_ALLOW_THREADS
+    if (status != SUCCESS)
+    {
+        PyErr_Format (PyExc_IOError, "Unable to map the band file %s",
+            band->file_name);
+        free (band);
+        Py_DECREF (mapped);
+        return (NULL);
+    }
+    free (band);
+    mapped->mapped = true;
+
+    return ((PyObject *) mapped);
+}
+
+
+static PyMethodDef metadata_methods[] =
+{
+    {"global_metadata", (PyCFunction) metadata_global, METH_NOARGS,
+     "Returns the global metadata as a dictionary."},
+    {"band", (PyCFunction) metadata_band, METH_VARARGS,
+     "Returns the main fields of the band with the specified index as a "
+     "dictionary."},
+    {"band_details", (PyCFunction) metadata_band_details, METH_VARARGS,
+     "Returns the bitmap descriptions, classes, cover types, QA description "
+     "and statistics of the band with the specified index as a dictionary."},
+    {"find_band", (PyCFunction) metadata_find_band,
+     METH_VARARGS | METH_KEYWORDS,
+     "Returns the index of the first band matching the product, name and "
+     "category, or None."},
+    {"map_band", (PyCFunction) metadata_map_band,
+     METH_VARARGS | METH_KEYWORDS,
+     "map_band(index, writable=False, access='sequential') memory maps the "
+     "band with the specified index and returns a MappedBand."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PySequenceMethods metadata_as_sequence =
+{
+    (lenfunc) metadata_len,     /* sq_length */
+};
+
+static PyTypeObject Metadata_type =
+{
+    PyVarObject_HEAD_INIT (NULL, 0)
+    "_espa_metadata.Metadata",  /* tp_name */
+    sizeof (Metadata_object_t), /* tp_basicsize */
+};
+
+
+/******************************************************************************
+MODULE:  mapped_band_dealloc
+
+PURPOSE: Unmaps the band and frees the mapped band object.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. There can't be any exported buffers left, since each of them holds a
+     reference to the object.
+******************************************************************************/
+static void mapped_band_dealloc
+(
+    Mapped_band_object_t *self  /* I: mapped band object */
+)
+{
+    if (self->mapped)
+        close_raw_binary_mapped (&self->rbmap);
+    PyObject_Del (self);
+}
+
+
+/******************************************************************************
+MODULE:  mapped_band_getbuffer
+
+PURPOSE: Exports the mapped band data through the buffer protocol.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The band has been closed, or a writable buffer was requested
+                for a read-only band
+0               The buffer was exported
+
+NOTES:
+  1. The buffer is the whole band as bytes, nlines * nsamps * nbytes long.
+******************************************************************************/
+static int mapped_band_getbuffer
+(
+    Mapped_band_object_t *self, /* I/O: mapped band object */
+    Py_buffer *view,            /* O: exported buffer */
+    int flags                   /* I: requested buffer flags */
+)
+{
+    if (!self->mapped)
+    {
+        PyErr_SetString (PyExc_ValueError, "mapped band is closed");
+        return (-1);
+    }
+
+    if (PyBuffer_FillInfo (view, (PyObject *) self, self->rbmap.data,
+        (Py_ssize_t) self->rbmap.size, !self->rbmap.writable, flags) != 0)
+        return (-1);
+    self->exports++;
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  mapped_band_releasebuffer
+
+PURPOSE: Releases a buffer exported from the mapped band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void mapped_band_releasebuffer
+(
+    Mapped_band_object_t *self, /* I/O: mapped band object */
+    Py_buffer *view             /* I: released buffer */
+)
+{
+    self->exports--;
+}
+
+
+/******************************************************************************
+MODULE:  mapped_band_close
+
+PURPOSE: Unmaps the band before the object is freed.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Buffers exported from the band are still in use; BufferError
+                is raised
+non-NULL        None
+
+NOTES:
+  1. Changes to a writable band are written back to the file when it's
+     unmapped.
+******************************************************************************/
+static PyObject *mapped_band_close
+(
+    Mapped_band_object_t *self, /* I/O: mapped band object */
+    PyObject *unused            /* I: no arguments */
+)
+{
+    int status;                 /* return status */
+
+    if (self->exports > 0)
+    {
+        PyErr_SetString (PyExc_BufferError,
+            "mapped band data is still in use");
+        return (NULL);
+    }
+
+    if (self->mapped)
+    {
+        self->mapped = false;
+        status = close_raw_binary_mapped (&self->rbmap);
+        if (status != SUCCESS)
+        {
+            PyErr_Format (PyExc_IOError, "Unable to unmap the band file %s",
+                self->rbmap.file_name);
+            return (NULL);
+        }
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+/******************************************************************************
+MODULE:  mapped_band_info
+
+PURPOSE: Returns the layout of the mapped band as a dictionary.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the dictionary
+non-NULL        Dictionary with the file_name, nlines, nsamps, data_type,
+                nbytes, writable and decoded values of the band
+
+NOTES:
+******************************************************************************/
+static PyObject *mapped_band_info
+(
+    Mapped_band_object_t *self, /* I: mapped band object */
+    PyObject *unused            /* I: no arguments */
+)
+{
+    Raw_binary_mapped_t *rbmap = &self->rbmap;  /* mapped band */
+
+    return (Py_BuildValue ("{s:s,s:i,s:i,s:s,s:i,s:O,s:O}",
+        "file_name", rbmap->file_name, "nlines", rbmap->nlines,
+        "nsamps", rbmap->nsamps, "data_type",
+        rbmap->data_type >= ESPA_INT8 && rbmap->data_type <= ESPA_FLOAT64
+        ? data_type_names[rbmap->data_type] : ESPA_STRING_META_FILL,
+        "nbytes", rbmap->nbytes,
+        "writable", rbmap->writable ? Py_True : Py_False,
+        "decoded", rbmap->decoded ? Py_True : Py_False));
+}
+
+
+static PyMethodDef mapped_band_methods[] =
+{
+    {"close", (PyCFunction) mapped_band_close, METH_NOARGS,
+     "Unmaps the band; fails if the band data is still in use."},
+    {"info", (PyCFunction) mapped_band_info, METH_NOARGS,
+     "Returns the file name, size, data type and mode of the band as a "
+     "dictionary."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyBufferProcs mapped_band_as_buffer;
+
+static PyTypeObject Mapped_band_type =
+{
+    PyVarObject_HEAD_INIT (NULL, 0)
+    "_espa_metadata.MappedBand",    /* tp_name */
+    sizeof (Mapped_band_object_t),  /* tp_basicsize */
+};
+
+
+/******************************************************************************
+MODULE:  get_value
+
+PURPOSE: Returns the value of a key of a dictionary, or NULL if the key is
+missing or its value is None.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            The value is missing or None
+non-NULL        Borrowed reference to the value
+
+NOTES:
+******************************************************************************/
+static PyObject *get_value
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key             /* I: key of the value */
+)
+{
+    PyObject *value = PyDict_GetItemString (dict, key);  /* value */
+
+    if (value == Py_None)
+        return (NULL);
+    return (value);
+}
+
+
+/******************************************************************************
+MODULE:  get_str
+
+PURPOSE: Copies a string of a dictionary to a metadata string.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't a string or is too long; an exception is
+                raised
+0               The string was copied
+
+NOTES:
+  1. A missing or None value is stored as the fill string.
+******************************************************************************/
+static int get_str
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the string */
+    const char *fill,           /* I: string stored for a missing value */
+    char *str,                  /* O: metadata string */
+    size_t size                 /* I: size of str */
+)
+{
+    PyObject *value = get_value (dict, key);  /* value of the key */
+    const char *cstr = NULL;    /* C string of the value */
+
+    cstr = (value == NULL) ? fill : STR_AS_C (value);
+    if (cstr == NULL)
+        return (-1);
+    if (strlen (cstr) >= size)
+    {
+        PyErr_Format (PyExc_ValueError, "%s is too long", key);
+        return (-1);
+    }
+    strcpy (str, cstr);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_long
+
+PURPOSE: Converts an integer of a dictionary to a metadata integer.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't an integer; an exception is raised
+0               The integer was converted
+
+NOTES:
+  1. A missing or None value is returned as the fill value.
+******************************************************************************/
+static int get_long
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the integer */
+    long *result                /* O: metadata integer */
+)
+{
+    PyObject *value = get_value (dict, key);  /* value of the key */
+
+    if (value == NULL)
+    {
+        *result = ESPA_INT_META_FILL;
+        return (0);
+    }
+    *result = PyLong_AsLong (value);
+    if (*result == -1 && PyErr_Occurred ())
+        return (-1);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_int
+
+PURPOSE: Converts an integer of a dictionary to a metadata int.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't an integer or doesn't fit; an exception is
+                raised
+0               The integer was converted
+
+NOTES:
+  1. A missing or None value is returned as the fill value.
+******************************************************************************/
+static int get_int
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the integer */
+    int *result                 /* O: metadata integer */
+)
+{
+    long value;                 /* value of the key */
+
+    if (get_long (dict, key, &value))
+        return (-1);
+    if (value < INT_MIN || value > INT_MAX)
+    {
+        PyErr_Format (PyExc_OverflowError, "%s is out of range", key);
+        return (-1);
+    }
+    *result = (int) value;
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_double
+
+PURPOSE: Converts a number of a dictionary to a metadata float.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't a number; an exception is raised
+0               The number was converted
+
+NOTES:
+  1. A missing or None value is returned as the fill value.
+******************************************************************************/
+static int get_double
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the number */
+    double *result              /* O: metadata float */
+)
+{
+    PyObject *value = get_value (dict, key);  /* value of the key */
+
+    if (value == NULL)
+    {
+        *result = ESPA_FLOAT_META_FILL;
+        return (0);
+    }
+    *result = PyFloat_AsDouble (value);
+    if (*result == -1.0 && PyErr_Occurred ())
+        return (-1);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_float
+
+PURPOSE: Converts a number of a dictionary to a single precision metadata
+float.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't a number; an exception is raised
+0               The number was converted
+
+NOTES:
+  1. A missing or None value is returned as the fill value.
+******************************************************************************/
+static int get_float
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the number */
+    float *result               /* O: metadata float */
+)
+{
+    double value;               /* value of the key */
+
+    if (get_double (dict, key, &value))
+        return (-1);
+    *result = (float) value;
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_doubles
+
+PURPOSE: Converts a tuple of numbers of a dictionary to metadata floats.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't a sequence of n numbers; an exception is
+                raised
+0               The numbers were converted
+
+NOTES:
+  1. A missing or None value is returned as fill values.
+******************************************************************************/
+static int get_doubles
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the numbers */
+    int n,                      /* I: number of numbers */
+    double *result              /* O: metadata floats */
+)
+{
+    int i;                      /* looping variable */
+    PyObject *value = get_value (dict, key);  /* value of the key */
+    PyObject *seq = NULL;       /* value as a sequence */
+
+    if (value == NULL)
+    {
+        for (i = 0; i < n; i++)
+            result[i] = ESPA_FLOAT_META_FILL;
+        return (0);
+    }
+
+    seq = PySequence_Fast (value, key);
+    if (seq == NULL)
+        return (-1);
+    if (PySequence_Fast_GET_SIZE (seq) != n)
+    {
+        PyErr_Format (PyExc_ValueError, "%s must have %d values", key, n);
+        Py_DECREF (seq);
+        return (-1);
+    }
+    for (i = 0; i < n; i++)
+    {
+        result[i] = PyFloat_AsDouble (PySequence_Fast_GET_ITEM (seq, i));
+        if (result[i] == -1.0 && PyErr_Occurred ())
+        {
+            Py_DECREF (seq);
+            return (-1);
+        }
+    }
+    Py_DECREF (seq);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_name_index
+
+PURPOSE: Finds a name of a dictionary in a list of names.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The value isn't one of the names; ValueError is raised
+>= 0            Index of the name
+
+NOTES:
+  1. A missing or None value returns fill_index.
+******************************************************************************/
+static int get_name_index
+(
+    PyObject *dict,             /* I: dictionary */
+    const char *key,            /* I: key of the name */
+    int nnames,                 /* I: number of names */
+    const char *names[],        /* I: names */
+    int fill_index              /* I: index returned for a missing value */
+)
+{
+    int i;                      /* looping variable */
+    char name[STR_SIZE];        /* name of the dictionary */
+
+    if (get_value (dict, key) == NULL)
+        return (fill_index);
+    if (get_str (dict, key, "", name, sizeof (name)))
+        return (-1);
+    for (i = 0; i < nnames; i++)
+    {
+        if (!strcmp (name, names[i]))
+            return (i);
+    }
+    PyErr_Format (PyExc_ValueError, "Unknown %s %s", key, name);
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  set_global_metadata
+
+PURPOSE: Fills the global metadata from a dictionary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              A value of the dictionary is invalid; an exception is raised
+0               The global metadata was filled
+
+NOTES:
+  1. The dictionary has the keys returned by Metadata.global_metadata.
+     Missing keys are fill.
+******************************************************************************/
+static int set_global_metadata
+(
+    PyObject *dict,             /* I: global metadata dictionary */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata; initialized via
+                                        init_metadata_struct */
+)
+{
+    static const char *projections[] = {"GEO", "UTM", "ALBERS", "PS",
+        "SIN"};                 /* projection names */
+    static const int proj_types[] = {GCTP_GEO_PROJ, GCTP_UTM_PROJ,
+        GCTP_ALBERS_PROJ, GCTP_PS_PROJ, GCTP_SIN_PROJ};  /* projections */
+    static const char *datums[] = {"WGS84", "NAD27", "NAD83"};
+                                /* datum names */
+    static const int datum_types[] = {ESPA_WGS84, ESPA_NAD27, ESPA_NAD83};
+                                /* datums */
+    int index;                  /* index of a name */
+    double bounds[4];           /* west, east, north, south */
+    Espa_proj_meta_t *proj = &gmeta->proj_info;  /* projection info */
+
+    if (!PyDict_Check (dict))
+    {
+        PyErr_SetString (PyExc_TypeError,
+            "global metadata must be a dictionary");
+        return (-1);
+    }
+
+    if (get_str (dict, "data_provider", ESPA_STRING_META_FILL,
+            gmeta->data_provider, sizeof (gmeta->data_provider)) ||
+        get_str (dict, "satellite", ESPA_STRING_META_FILL, gmeta->satellite,
+            sizeof (gmeta->satellite)) ||
+        get_str (dict, "instrument", ESPA_STRING_META_FILL,
+            gmeta->instrument, sizeof (gmeta->instrument)) ||
+        get_str (dict, "acquisition_date", ESPA_STRING_META_FILL,
+            gmeta->acquisition_date, sizeof (gmeta->acquisition_date)) ||
+        get_str (dict, "scene_center_time", ESPA_STRING_META_FILL,
+            gmeta->scene_center_time, sizeof (gmeta->scene_center_time)) ||
+        get_str (dict, "level1_production_date", ESPA_STRING_META_FILL,
+            gmeta->level1_production_date,
+            sizeof (gmeta->level1_production_date)) ||
+        get_float (dict, "solar_zenith", &gmeta->solar_zenith) ||
+        get_float (dict, "solar_azimuth", &gmeta->solar_azimuth) ||
+        get_str (dict, "solar_units", ESPA_STRING_META_FILL,
+            gmeta->solar_units, sizeof (gmeta->solar_units)) ||
+        get_float (dict, "earth_sun_distance", &gmeta->earth_sun_dist) ||
+        get_int (dict, "wrs_system", &gmeta->wrs_system) ||
+        get_int (dict, "wrs_path", &gmeta->wrs_path) ||
+        get_int (dict, "wrs_row", &gmeta->wrs_row) ||
+        get_int (dict, "htile", &gmeta->htile) ||
+        get_int (dict, "vtile", &gmeta->vtile) ||
+        get_str (dict, "product_id", ESPA_STRING_META_FILL,
+            gmeta->product_id, sizeof (gmeta->product_id)) ||
+        get_str (dict, "lpgs_metadata_file", ESPA_STRING_META_FILL,
+            gmeta->lpgs_metadata_file, sizeof (gmeta->lpgs_metadata_file)) ||
+        get_doubles (dict, "ul_corner", 2, gmeta->ul_corner) ||
+        get_doubles (dict, "lr_corner", 2, gmeta->lr_corner) ||
+        get_doubles (dict, "bounding_coordinates", 4, bounds) ||
+        get_float (dict, "orientation_angle", &gmeta->orientation_angle) ||
+        get_str (dict, "valid_mask", ESPA_STRING_META_FILL,
+            gmeta->valid_mask, sizeof (gmeta->valid_mask)))
+        return (-1);
+    gmeta->bounding_coords[ESPA_WEST] = bounds[0];
+    gmeta->bounding_coords[ESPA_EAST] = bounds[1];
+    gmeta->bounding_coords[ESPA_NORTH] = bounds[2];
+    gmeta->bounding_coords[ESPA_SOUTH] = bounds[3];
+
+    /* Projection information */
+    index = get_name_index (dict, "projection", 5, projections, 5);
+    if (index < 0)
+        return (-1);
+    proj->proj_type = (index < 5) ? proj_types[index] : ESPA_INT_META_FILL;
+    index = get_name_index (dict, "datum", 3, datums, 3);
+    if (index < 0)
+        return (-1);
+    proj->datum_type = (index < 3) ? datum_types[index] : ESPA_NODATUM;
+    if (get_str (dict, "proj_units", ESPA_STRING_META_FILL, proj->units,
+            sizeof (proj->units)) ||
+        get_doubles (dict, "proj_ul_corner", 2, proj->ul_corner) ||
+        get_doubles (dict, "proj_lr_corner", 2, proj->lr_corner) ||
+        get_str (dict, "grid_origin", ESPA_STRING_META_FILL,
+            proj->grid_origin, sizeof (proj->grid_origin)) ||
+        get_int (dict, "utm_zone", &proj->utm_zone) ||
+        get_double (dict, "longitude_pole", &proj->longitude_pole) ||
+        get_double (dict, "latitude_true_scale",
+            &proj->latitude_true_scale) ||
+        get_double (dict, "false_easting", &proj->false_easting) ||
+        get_double (dict, "false_northing", &proj->false_northing) ||
+        get_double (dict, "standard_parallel1",
+            &proj->standard_parallel1) ||
+        get_double (dict, "standard_parallel2",
+            &proj->standard_parallel2) ||
+        get_double (dict, "central_meridian", &proj->central_meridian) ||
+        get_double (dict, "origin_latitude", &proj->origin_latitude) ||
+        get_double (dict, "sphere_radius", &proj->sphere_radius))
+        return (-1);
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  set_band_details
+
+PURPOSE: Fills the bitmap descriptions, classes, cover types and statistics
+of a band from a dictionary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              A value of the dictionary is invalid; an exception is raised
+0               The band details were filled
+
+NOTES:
+  1. The lists have the layout returned by Metadata.band_details.  Missing
+     keys leave the details out.
+******************************************************************************/
+static int set_band_details
+(
+    PyObject *dict,             /* I: band dictionary */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata */
+)
+{
+    int i;                      /* looping variable */
+    int n;                      /* number of list items */
+    int num;                    /* class number */
+    char *desc = NULL;          /* class or cover description */
+    double percent;             /* cover percentage */
+    PyObject *value = NULL;     /* value of a key */
+    PyObject *seq = NULL;       /* value as a sequence */
+    PyObject *item = NULL;      /* current list item; borrowed */
+    Espa_band_stats_t *stats = &bmeta->stats;  /* band statistics */
+
+    /* Bitmap descriptions, in bit order */
+    value = get_value (dict, "bitmap_description");
+    if (value != NULL)
+    {
+        seq = PySequence_Fast (value, "bitmap_description must be a list");
+        if (seq == NULL)
+            return (-1);
+        n = PySequence_Fast_GET_SIZE (seq);
+        if (n > 0 && allocate_bitmap_metadata (bmeta, n) != SUCCESS)
+            goto nomem;
+        for (i = 0; i < n; i++)
+        {
+            desc = (char *) STR_AS_C (PySequence_Fast_GET_ITEM (seq, i));
+            if (desc == NULL)
+                goto error;
+            snprintf (bmeta->bitmap_description[i], STR_SIZE, "%s", desc);
+        }
+        Py_DECREF (seq);
+    }
+
+    /* Classes as (num, description) */
+    value = get_value (dict, "class_values");
+    if (value != NULL)
+    {
+        seq = PySequence_Fast (value, "class_values must be a list");
+        if (seq == NULL)
+            return (-1);
+        n = PySequence_Fast_GET_SIZE (seq);
+        if (n > 0 && allocate_class_metadata (bmeta, n) != SUCCESS)
+            goto nomem;
+        for (i = 0; i < n; i++)
+        {
+            item = PySequence_Fast_GET_ITEM (seq, i);
+            if (!PyArg_ParseTuple (item, "is", &num, &desc))
+                goto error;
+            bmeta->class_values[i].class = num;
+            snprintf (bmeta->class_values[i].description, STR_SIZE, "%s",
+                desc);
+        }
+        Py_DECREF (seq);
+    }
+
+    /* Cover types as (type, percent) */
+    value = get_value (dict, "percent_coverage");
+    if (value != NULL)
+    {
+        seq = PySequence_Fast (value, "percent_coverage must be a list");
+        if (seq == NULL)
+            return (-1);
+        n = PySequence_Fast_GET_SIZE (seq);
+        if (n > 0 && allocate_percent_coverage_metadata (bmeta, n)
+            != SUCCESS)
+            goto nomem;
+        for (i = 0; i < n; i++)
+        {
+            item = PySequence_Fast_GET_ITEM (seq, i);
+            if (!PyArg_ParseTuple (item, "sd", &desc, &percent))
+                goto error;
+            bmeta->percent_cover[i].percent = (float) percent;
+            snprintf (bmeta->percent_cover[i].description, STR_SIZE, "%s",
+                desc);
+        }
+        Py_DECREF (seq);
+    }
+    seq = NULL;
+
+    /* Statistics */
+    value = get_value (dict, "statistics");
+    if (value == NULL)
+        return (0);
+    if (!PyDict_Check (value))
+    {
+        PyErr_SetString (PyExc_TypeError, "statistics must be a dictionary");
+        return (-1);
+    }
+    if (get_long (value, "valid_pixels", &stats->valid_pixels) ||
+        get_long (value, "fill_pixels", &stats->fill_pixels) ||
+        get_long (value, "out_of_range_pixels",
+            &stats->out_of_range_pixels) ||
+        get_double (value, "min", &stats->min) ||
+        get_double (value, "max", &stats->max) ||
+        get_double (value, "mean", &stats->mean) ||
+        get_double (value, "stddev", &stats->stddev) ||
+        get_double (value, "hist_min", &stats->hist_min) ||
+        get_double (value, "hist_max", &stats->hist_max))
+        return (-1);
+    stats->nbins = 0;
+    item = get_value (value, "histogram");
+    if (item == NULL)
+        return (0);
+    seq = PySequence_Fast (item, "histogram must be a list");
+    if (seq == NULL)
+        return (-1);
+    n = PySequence_Fast_GET_SIZE (seq);
+    if (n > ESPA_STATS_NBINS)
+    {
+        PyErr_Format (PyExc_ValueError, "histogram has more than %d bins",
+            ESPA_STATS_NBINS);
+        goto error;
+    }
+    for (i = 0; i < n; i++)
+    {
+        stats->histogram[i] = PyLong_AsLong (PySequence_Fast_GET_ITEM (seq,
+            i));
+        if (stats->histogram[i] == -1 && PyErr_Occurred ())
+            goto error;
+    }
+    stats->nbins = n;
+    Py_DECREF (seq);
+    return (0);
+
+nomem:
+    PyErr_NoMemory ();
+error:
+    Py_XDECREF (seq);
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  set_band_metadata
+
+PURPOSE: Fills a band from a dictionary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              A value of the dictionary is invalid; an exception is raised
+0               The band was filled
+
+NOTES:
+  1. The dictionary has the keys returned by Metadata.band, along with those
+     returned by Metadata.band_details.  Missing keys are fill, except the
+     data type, which is required.
+******************************************************************************/
+static int set_band_metadata
+(
+    PyObject *dict,             /* I: band dictionary */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata; initialized via
+                                        allocate_band_metadata */
+)
+{
+    static const char *rtypes[] = {"cubic convolution", "nearest neighbor",
+        "bilinear", "none"};    /* resampling names */
+    int index;                  /* index of a name */
+    int tile[2];                /* tile lines and samples */
+    const char *stage;          /* stage of the band provenance */
+    const char *key;            /* key of the band provenance */
+    char *fill_band = "";       /* fill band of a constant band */
+    double range[2];            /* valid range */
+    double sub_sample[3];       /* sub-sampling factor, lines and samples */
+    PyObject *value = NULL;     /* value of a key */
+
+    if (!PyDict_Check (dict))
+    {
+        PyErr_SetString (PyExc_TypeError, "band must be a dictionary");
+        return (-1);
+    }
+
+    if (get_value (dict, "data_type") == NULL)
+    {
+        PyErr_SetString (PyExc_ValueError, "band data_type is required");
+        return (-1);
+    }
+    index = get_name_index (dict, "data_type", ESPA_FLOAT64 + 1,
+        data_type_names, 0);
+    if (index < 0)
+        return (-1);
+    bmeta->data_type = (enum Espa_data_type) index;
+    index = get_name_index (dict, "resample_method", 4, rtypes, ESPA_NONE);
+    if (index < 0)
+        return (-1);
+    bmeta->resample_method = (enum Espa_resampling_type) index;
+
+    range[0] = range[1] = ESPA_FLOAT_META_FILL;
+    if (get_str (dict, "product", ESPA_STRING_META_FILL, bmeta->product,
+            sizeof (bmeta->product)) ||
+        get_str (dict, "source", ESPA_STRING_META_FILL, bmeta->source,
+            sizeof (bmeta->source)) ||
+        get_str (dict, "name", ESPA_STRING_META_FILL, bmeta->name,
+            sizeof (bmeta->name)) ||
+        get_str (dict, "category", ESPA_STRING_META_FILL, bmeta->category,
+            sizeof (bmeta->category)) ||
+        get_int (dict, "nlines", &bmeta->nlines) ||
+        get_int (dict, "nsamps", &bmeta->nsamps) ||
+        get_long (dict, "fill_value", &bmeta->fill_value) ||
+        get_int (dict, "saturate_value", &bmeta->saturate_value) ||
+        get_float (dict, "scale_factor", &bmeta->scale_factor) ||
+        get_float (dict, "add_offset", &bmeta->add_offset) ||
+        get_str (dict, "short_name", ESPA_STRING_META_FILL,
+            bmeta->short_name, sizeof (bmeta->short_name)) ||
+        get_str (dict, "long_name", ESPA_STRING_META_FILL, bmeta->long_name,
+            sizeof (bmeta->long_name)) ||
+        get_str (dict, "file_name", ESPA_STRING_META_FILL, bmeta->file_name,
+            sizeof (bmeta->file_name)) ||
+        get_doubles (dict, "pixel_size", 2, bmeta->pixel_size) ||
+        get_str (dict, "pixel_units", ESPA_STRING_META_FILL,
+            bmeta->pixel_units, sizeof (bmeta->pixel_units)) ||
+        get_str (dict, "data_units", ESPA_STRING_META_FILL,
+            bmeta->data_units, sizeof (bmeta->data_units)) ||
+        get_double (dict, "valid_min", &range[0]) ||
+        get_double (dict, "valid_max", &range[1]) ||
+        get_double (dict, "rad_gain", &bmeta->rad_gain) ||
+        get_double (dict, "rad_bias", &bmeta->rad_bias) ||
+        get_double (dict, "refl_gain", &bmeta->refl_gain) ||
+        get_double (dict, "refl_bias", &bmeta->refl_bias) ||
+        get_double (dict, "k1_const", &bmeta->k1_const) ||
+        get_double (dict, "k2_const", &bmeta->k2_const) ||
+        get_str (dict, "checksum", "", bmeta->checksum,
+            sizeof (bmeta->checksum)) ||
+        get_str (dict, "qa_description", ESPA_STRING_META_FILL,
+            bmeta->qa_desc, sizeof (bmeta->qa_desc)) ||
+        get_str (dict, "app_version", ESPA_STRING_META_FILL,
+            bmeta->app_version, sizeof (bmeta->app_version)) ||
+        get_str (dict, "production_date", ESPA_STRING_META_FILL,
+            bmeta->production_date, sizeof (bmeta->production_date)))
+        return (-1);
+    bmeta->valid_range[0] = (float) range[0];
+    bmeta->valid_range[1] = (float) range[1];
+
+    /* Sub-sampling as (factor, nlines, nsamps) */
+    if (get_value (dict, "sub_sample") != NULL)
+    {
+        if (get_doubles (dict, "sub_sample", 3, sub_sample))
+            return (-1);
+        bmeta->sub_sample.factor = (int) sub_sample[0];
+        bmeta->sub_sample.nlines = (int) sub_sample[1];
+        bmeta->sub_sample.nsamps = (int) sub_sample[2];
+    }
+
+    /* Constant value as (value, fill_band) */
+    value = get_value (dict, "constant");
+    if (value != NULL)
+    {
+        if (!PyArg_ParseTuple (value, "d|z", &bmeta->constant.value,
+            &fill_band))
+            return (-1);
+        bmeta->constant.is_constant = true;
+        snprintf (bmeta->constant.fill_band,
+            sizeof (bmeta->constant.fill_band), "%s",
+            fill_band != NULL ? fill_band : "");
+    }
+
+    /* Expression of a derived band */
+    if (get_value (dict, "derived") != NULL)
+    {
+        if (get_str (dict, "derived", "", bmeta->derived.expression,
+            sizeof (bmeta->derived.expression)))
+            return (-1);
+        bmeta->derived.is_derived = true;
+    }
+
+    /* Tile size as (nlines, nsamps) */
+    value = get_value (dict, "tiling");
+    if (value != NULL)
+    {
+        if (!PyArg_ParseTuple (value, "ii", &tile[0], &tile[1]))
+            return (-1);
+        bmeta->tiling.is_tiled = true;
+        bmeta->tiling.nlines = tile[0];
+        bmeta->tiling.nsamps = tile[1];
+    }
+
+    /* Provenance as (stage, key) */
+    value = get_value (dict, "provenance");
+    if (value != NULL)
+    {
+        if (!PyArg_ParseTuple (value, "ss", &stage, &key))
+            return (-1);
+        snprintf (bmeta->provenance.stage, sizeof (bmeta->provenance.stage),
+            "%s", stage);
+        snprintf (bmeta->provenance.key, sizeof (bmeta->provenance.key),
+            "%s", key);
+    }
+
+    return (set_band_details (dict, bmeta));
+}
+
+
+/******************************************************************************
+MODULE:  set_bands_metadata
+
+PURPOSE: Allocates and fills the bands of a metadata structure from a
+sequence of dictionaries.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Error allocating the bands, or a band is invalid; an
+                exception is raised
+0               The bands were filled
+
+NOTES:
+******************************************************************************/
+static int set_bands_metadata
+(
+    PyObject *bands,            /* I: sequence of band dictionaries */
+    Espa_internal_meta_t *meta  /* I/O: metadata structure; initialized via
+                                        init_metadata_struct */
+)
+{
+    int i;                      /* looping variable */
+    int nbands;                 /* number of bands */
+    PyObject *seq = NULL;       /* bands as a sequence */
+
+    seq = PySequence_Fast (bands, "bands must be a list of dictionaries");
+    if (seq == NULL)
+        return (-1);
+    nbands = PySequence_Fast_GET_SIZE (seq);
+    if (nbands > 0 && allocate_band_metadata (meta, nbands) != SUCCESS)
+    {
+        Py_DECREF (seq);
+        PyErr_NoMemory ();
+        return (-1);
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        if (set_band_metadata (PySequence_Fast_GET_ITEM (seq, i),
+            &meta->band[i]))
+        {
+            Py_DECREF (seq);
+            return (-1);
+        }
+    }
+
+    Py_DECREF (seq);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  module_write_metadata
+
+PURPOSE: Writes an XML metadata file from the global metadata and band
+dictionaries.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            A value is invalid, or the file couldn't be written
+non-NULL        None
+
+NOTES:
+  1. The dictionaries have the keys returned by Metadata.global_metadata,
+     and by Metadata.band along with Metadata.band_details, so a product
+     read with this module can be written back unchanged.
+  2. The file is written by write_metadata, which also stamps it as written
+     by the library so validate_xml_file doesn't validate it again against
+     the schema (see metadata_cache.h).
+******************************************************************************/
+static PyObject *module_write_metadata
+(
+    PyObject *self,             /* I: module */
+    PyObject *args              /* I: global metadata, bands and XML
+                                      filename */
+)
+{
+    char *xml_file = NULL;      /* name of the XML file */
+    int status;                 /* return status */
+    PyObject *global = NULL;    /* global metadata dictionary */
+    PyObject *bands = NULL;     /* band dictionaries */
+    Espa_internal_meta_t meta;  /* metadata to be written */
+
+    if (!PyArg_ParseTuple (args, "OOs", &global, &bands, &xml_file))
+        return (NULL);
+
+    init_metadata_struct (&meta);
+    if (set_global_metadata (global, &meta.global) ||
+        set_bands_metadata (bands, &meta))
+    {
+        free_metadata (&meta);
+        return (NULL);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    status = write_metadata (&meta, xml_file);
+    Py_END_ALLOW_THREADS
+    free_metadata (&meta);
+    if (status != SUCCESS)
+    {
+        PyErr_Format (PyExc_IOError, "Unable to write the metadata file %s",
+            xml_file);
+        return (NULL);
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+/******************************************************************************
+MODULE:  module_append_metadata
+
+PURPOSE: Appends bands to an existing XML metadata file from band
+dictionaries.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            A value is invalid, or the file couldn't be written
+non-NULL        None
+
+NOTES:
+  1. The band dictionaries are the same as for write_metadata.
+******************************************************************************/
+static PyObject *module_append_metadata
+(
+    PyObject *self,             /* I: module */
+    PyObject *args              /* I: bands and XML filename */
+)
+{
+    char *xml_file = NULL;      /* name of the XML file */
+    int status = SUCCESS;       /* return status */
+    PyObject *bands = NULL;     /* band dictionaries */
+    Espa_internal_meta_t meta;  /* holds the bands to be appended */
+
+    if (!PyArg_ParseTuple (args, "Os", &bands, &xml_file))
+        return (NULL);
+
+    init_metadata_struct (&meta);
+    if (set_bands_metadata (bands, &meta))
+    {
+        free_metadata (&meta);
+        return (NULL);
+    }
+
+    if (meta.nbands > 0)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        status = append_metadata (meta.nbands, meta.band, xml_file);
+        Py_END_ALLOW_THREADS
+    }
+    free_metadata (&meta);
+    if (status != SUCCESS)
+    {
+        PyErr_Format (PyExc_IOError,
+            "Unable to append the bands to the metadata file %s", xml_file);
+        return (NULL);
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+static PyMethodDef module_methods[] =
+{
+    {"write_metadata", (PyCFunction) module_write_metadata, METH_VARARGS,
+     "write_metadata(global_metadata, bands, xml_file) writes the XML "
+     "metadata file from a global metadata dictionary and a list of band "
+     "dictionaries, with the keys of Metadata.global_metadata, band and "
+     "band_details."},
+    {"append_metadata", (PyCFunction) module_append_metadata, METH_VARARGS,
+     "append_metadata(bands, xml_file) appends a list of band dictionaries "
+     "to the XML metadata file."},
+    {NULL, NULL, 0, NULL}
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef espa_metadata_module =
+{
+    PyModuleDef_HEAD_INIT,
+    "_espa_metadata",
+    "Fast reader and writer of the ESPA internal metadata.",
+    -1,
+    module_methods
+};
+#endif
+
+
+/******************************************************************************
+MODULE:  init_module
+
+PURPOSE: Creates the module and adds the Metadata and MappedBand types to
+it.
+
+RETURN VALUE:
+Type = PyObject *
+Value           Description
+-----           -----------
+NULL            Error creating the module
+non-NULL        Module
+
+NOTES:
+******************************************************************************/
+static PyObject *init_module ()
+{
+    PyObject *module = NULL;    /* extension module */
+
+    Metadata_type.tp_dealloc = (destructor) metadata_dealloc;
+    Metadata_type.tp_as_sequence = &metadata_as_sequence;
+    Metadata_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    Metadata_type.tp_doc = "Metadata(xml_file) parses an ESPA XML metadata "
+        "file.";
+    Metadata_type.tp_methods = metadata_methods;
+    Metadata_type.tp_init = (initproc) metadata_init;
+    Metadata_type.tp_new = PyType_GenericNew;
+    if (PyType_Ready (&Metadata_type) < 0)
+        return (NULL);
+
+    mapped_band_as_buffer.bf_getbuffer = (getbufferproc) mapped_band_getbuffer;
+    mapped_band_as_buffer.bf_releasebuffer =
+        (releasebufferproc) mapped_band_releasebuffer;
+    Mapped_band_type.tp_dealloc = (destructor) mapped_band_dealloc;
+    Mapped_band_type.tp_as_buffer = &mapped_band_as_buffer;
+#if PY_MAJOR_VERSION >= 3
+    Mapped_band_type.tp_flags = Py_TPFLAGS_DEFAULT;
+#else
+    Mapped_band_type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+    Mapped_band_type.tp_doc = "Band memory mapped by Metadata.map_band; "
+        "exports the band data through the buffer protocol.";
+    Mapped_band_type.tp_methods = mapped_band_methods;
+    if (PyType_Ready (&Mapped_band_type) < 0)
+        return (NULL);
+
+#if PY_MAJOR_VERSION >= 3
+    module = PyModule_Create (&espa_metadata_module);
+#else
+    module = Py_InitModule3 ("_espa_metadata", module_methods,
+        "Fast reader and writer of the ESPA internal metadata.");
+#endif
+    if (module == NULL)
+        return (NULL);
+
+    Py_INCREF (&Metadata_type);
+    PyModule_AddObject (module, "Metadata", (PyObject *) &Metadata_type);
+    Py_INCREF (&Mapped_band_type);
+    PyModule_AddObject (module, "MappedBand", (PyObject *) &Mapped_band_type);
+    return (module);
+}
+
+
+#if PY_MAJOR_VERSION >= 3
+PyMODINIT_FUNC PyInit__espa_metadata ()
+{
+    return (init_module ());
+}
+#else
+PyMODINIT_FUNC init_espa_metadata ()
+{
+    init_module ();
+}
+#endif
@@ -0,0 +1,190 @@
+
+'''
+License:
+  "NASA Open Source Agreement 1.3"
+
+Description:
+  This module provides zero-copy numpy access to the raw binary bands of an
+  ESPA product.  The bands are memory mapped, so opening a band is immediate
+  and only the pages actually used are read from the file.
+
+Notes:
+  With Python 3, the bands are mapped by the C library through the
+  _espa_metadata extension module (see metadata_fast.py), which also decodes
+  compressed (chunked) bands.  If the extension isn't available, or with
+  Python 2 (whose numpy doesn't support the buffers exported by the
+  extension), numpy.memmap is used instead, which only supports uncompressed
+  bands.
+
+  The band data is a numpy array of shape (nlines, nsamps) with the dtype of
+  the band.  Slicing it (or using BandData.window(...)) doesn't copy the data.
+
+History:
+  Created Oct/2026 for the ESPA product formatter
+'''
+
+import os
+import sys
+
+import numpy
+
+import metadata_fast
+
+try:
+    import _espa_metadata
+except ImportError:
+    _espa_metadata = None
+
+
+'''
+The numpy dtype of each ESPA data type.  The raw binary files are in the
+native byte order.
+'''
+DTYPES = {'INT8': numpy.int8,
+          'UINT8': numpy.uint8,
+          'INT16': numpy.int16,
+          'UINT16': numpy.uint16,
+          'INT32': numpy.int32,
+          'UINT32': numpy.uint32,
+          'FLOAT32': numpy.float32,
+          'FLOAT64': numpy.float64}
+
+
+class BandData(object):
+    '''
+    Description:
+      A memory-mapped band.  data is the (nlines, nsamps) numpy array of the
+      band, and fill_value, scale_factor, add_offset and valid_range come
+      from the band metadata (None if they aren't in the XML).
+
+    Notes:
+      The mapping is released by close(), or when the BandData and all the
+      arrays taken from data are no longer referenced.
+    '''
+    def __init__(self, band, data, mapped=None):
+        self.name = band.get_name()
+        self.product = band.get_product()
+        self.data = data
+        self.dtype = data.dtype
+        self.fill_value = band.get_fill_value()
+        self.scale_factor = band.get_scale_factor()
+        self.add_offset = band.get_add_offset()
+        self.valid_range = None
+        if band.get_valid_range() is not None:
+            self.valid_range = (band.get_valid_range().get_min(),
+                                band.get_valid_range().get_max())
+        self._mapped = mapped
+
+    def window(self, line, samp, nlines, nsamps):
+        '''
+        Description:
+          Returns the nlines x nsamps window of the band starting at line,
+          samp (0-based) as a view of the mapped data, without copying it
+
+        Returns:
+          The numpy array of the window
+        '''
+        if (line < 0 or samp < 0 or nlines < 0 or nsamps < 0 or
+                line + nlines > self.data.shape[0] or
+                samp + nsamps > self.data.shape[1]):
+            raise IndexError('Window is outside of band %s' % self.name)
+        return self.data[line:line + nlines, samp:samp + nsamps]
+
+    def scaled(self, data=None):
+        '''
+        Description:
+          Applies the scale_factor and add_offset of the band to the data (the
+          whole band by default), with the fill pixels set to NaN
+
+        Returns:
+          A new float32 array of the scaled values
+        '''
+        if data is None:
+            data = self.data
+        result = data.astype(numpy.float32)
+        if self.scale_factor is not None:
+            result *= self.scale_factor
+        if self.add_offset is not None:
+            result += self.add_offset
+        if self.fill_value is not None:
+            result[data == self.fill_value] = numpy.nan
+        return result
+
+    def close(self):
+        '''
+        Description:
+          Releases the mapping of the band.  Arrays taken from data keep the
+          mapping alive until they are released too.
+        '''
+        self.data = None
+        if self._mapped is not None:
+            try:
+                self._mapped.close()
+            except BufferError:
+                # Still used by arrays taken from data; unmapped once
+                # they're released
+                pass
+            self._mapped = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+# END BandData
+
+
+def open_band(xml_file, name=None, product=None, category=None,
+              writable=False, access='sequential', metadata=None):
+    '''
+    Description:
+      Memory maps the first band of the product matching the name, product
+      and category.  A value of None matches any band.
+
+    Returns:
+      The BandData of the band
+
+    Notes:
+      access is 'sequential' or 'random' and tells the kernel how the pages
+      will be read.
+
+      metadata may be the result of metadata_fast.parse(xml_file), to avoid
+      parsing the XML again for each band.
+
+      With writable=True, changes to the data are written back to the band
+      file.
+    '''
+    if metadata is None:
+        metadata = metadata_fast.parse(xml_file)
+
+    if isinstance(metadata, metadata_fast.EspaMetadata):
+        band = metadata.find_band(product=product, name=name,
+                                  category=category)
+    else:
+        band = None
+        for candidate in metadata.get_bands().get_band():
+            if ((name is None or candidate.get_name() == name) and
+                    (product is None or candidate.get_product() == product) and
+                    (category is None or
+                     candidate.get_category() == category)):
+                band = candidate
+                break
+    if band is None:
+        raise KeyError('No band matches name=%s product=%s category=%s in %s'
+                       % (name, product, category, xml_file))
+
+    dtype = DTYPES[band.get_data_type()]
+    shape = (band.get_nlines(), band.get_nsamps())
+
+    if (_espa_metadata is not None and sys.version_info[0] >= 3 and
+            isinstance(metadata, metadata_fast.EspaMetadata)):
+        mapped = metadata.map_band(band, writable=writable, access=access)
+        data = numpy.frombuffer(mapped, dtype=dtype).reshape(shape)
+        return BandData(band, data, mapped)
+
+    # Fall back to numpy's own mapping of the band file
+    file_name = os.path.join(os.path.dirname(xml_file), band.get_file_name())
+    data = numpy.memmap(file_name, dtype=dtype, mode='r+' if writable else 'r',
+                        shape=shape)
+    return BandData(band, data)
+# END open_band
@@ -0,0 +1,373 @@
+
+'''
+License:
+  "NASA Open Source Agreement 1.3"
+
+Description:
+  This module queries the catalog of ESPA products built by the
+  build_espa_catalog tool, to find the products by satellite, instrument,
+  acquisition date, WRS path/row, MODIS tile or band product without parsing
+  each XML file.
+
+Notes:
+  The catalog is memory mapped and read directly, so the catalog layout
+  defined in raw_binary/io_libs/espa_catalog.h must be matched here.  The
+  catalog is in the native byte order of the system which built it.
+
+  The scenes are sorted by acquisition date, and the path/row, tile and band
+  product indexes are sorted, so a query only reads the records selected by
+  whichever index narrows it the most.
+
+History:
+  Created Oct/2026 for the ESPA product formatter
+'''
+
+import mmap
+import struct
+
+
+'''
+Layout of the catalog (see espa_catalog.h).
+'''
+CATALOG_MAGIC = b'ESPACATL'
+CATALOG_VERSION = 1
+_HEADER = struct.Struct('=8s4i2q7Q')
+_SCENE = struct.Struct('=3qQ64s64s16s64s4i4d2i')
+_BAND = struct.Struct('=64s64s16s4i2d')
+_INDEX = struct.Struct('=i')
+
+'''
+ESPA_INT_META_FILL, used for the path/row and tile of the scenes which don't
+have them.
+'''
+_INT_FILL = -3333
+
+'''
+The ESPA data types in the order of enum Espa_data_type.
+'''
+_DATA_TYPES = ('INT8', 'UINT8', 'INT16', 'UINT16', 'INT32', 'UINT32',
+               'FLOAT32', 'FLOAT64')
+
+
+def _to_str(value):
+    '''
+    Description:
+      Converts a NUL-padded field of a record to a string
+
+    Returns:
+      The string
+    '''
+    return value.split(b'\0', 1)[0].decode('utf-8', 'replace')
+# END _to_str
+
+
+def _to_int(value):
+    '''
+    Description:
+      Converts an integer field which may be ESPA_INT_META_FILL
+
+    Returns:
+      The integer, or None if it's the fill value
+    '''
+    if value == _INT_FILL:
+        return None
+    return value
+# END _to_int
+
+
+class CatalogBand(object):
+    '''
+    Description:
+      The summary of one band of a cataloged product
+    '''
+    __slots__ = ('product', 'name', 'category', 'data_type', 'nlines',
+                 'nsamps', 'pixel_size')
+
+    def __init__(self, values):
+        (product, name, category, _scene, data_type, self.nlines,
+         self.nsamps, pixel_x, pixel_y) = values
+        self.product = _to_str(product)
+        self.name = _to_str(name)
+        self.category = _to_str(category)
+        self.data_type = (_DATA_TYPES[data_type]
+                          if 0 <= data_type < len(_DATA_TYPES) else None)
+        self.pixel_size = (pixel_x, pixel_y)
+
+    def __repr__(self):
+        return 'CatalogBand(%s, %s, %s)' % (self.product, self.name,
+                                            self.category)
+# END CatalogBand
+
+
+class CatalogScene(object):
+    '''
+    Description:
+      The summary of the global metadata of a cataloged product.  The bands
+      are read from the catalog when they are first accessed.
+    '''
+    def __init__(self, catalog, index):
+        (self.xml_size, self.xml_mtime, mtime_nsec, self._xml_file,
+         satellite, instrument, acquisition_date, product_id, wrs_path,
+         wrs_row, htile, vtile, west, east, north, south, self._first_band,
+         self._nbands) = _SCENE.unpack_from(
+            catalog._map, catalog._scene_offset + index * _SCENE.size)
+        self.xml_mtime += mtime_nsec * 1e-9
+        self.index = index
+        self.xml_file = catalog._string(self._xml_file)
+        self.satellite = _to_str(satellite)
+        self.instrument = _to_str(instrument)
+        self.acquisition_date = _to_str(acquisition_date)
+        self.product_id = _to_str(product_id)
+        self.wrs_path = _to_int(wrs_path)
+        self.wrs_row = _to_int(wrs_row)
+        self.htile = _to_int(htile)
+        self.vtile = _to_int(vtile)
+        self.bounding_coordinates = (west, east, north, south)
+        self._catalog = catalog
+        self._bands = None
+
+    @property
+    def bands(self):
+        '''
+        Description:
+          The band summaries of the product
+
+        Returns:
+          The list of CatalogBand
+        '''
+        if self._bands is None:
+            self._bands = [self._catalog._band(self._first_band + i)
+                           for i in range(self._nbands)]
+        return self._bands
+
+    def __repr__(self):
+        return 'CatalogScene(%s, %s)' % (self.xml_file, self.acquisition_date)
+# END CatalogScene
+
+
+class Catalog(object):
+    '''
+    Description:
+      An opened catalog.  len(catalog) is the number of scenes, and
+      catalog[i] is the i'th CatalogScene in acquisition date order.
+    '''
+    def __init__(self, catalog_file):
+        with open(catalog_file, 'rb') as fd:
+            self._map = mmap.mmap(fd.fileno(), 0, access=mmap.ACCESS_READ)
+
+        try:
+            if len(self._map) < _HEADER.size:
+                raise ValueError('%s is not an ESPA catalog' % catalog_file)
+            (magic, version, scene_size, band_size, _reserved, nscenes,
+             nbands, strings_size, self._scene_offset, self._band_offset,
+             self._pathrow_offset, self._tile_offset, self._product_offset,
+             self._strings_offset) = _HEADER.unpack_from(self._map, 0)
+            if magic != CATALOG_MAGIC:
+                raise ValueError('%s is not an ESPA catalog' % catalog_file)
+            if (version != CATALOG_VERSION or scene_size != _SCENE.size or
+                    band_size != _BAND.size):
+                raise ValueError('Catalog %s is version %d; version %d is '
+                                 'supported.  Rebuild the catalog.'
+                                 % (catalog_file, version, CATALOG_VERSION))
+            if (self._strings_offset + strings_size > len(self._map) or
+                    self._scene_offset + nscenes * _SCENE.size >
+                    len(self._map) or
+                    self._band_offset + nbands * _BAND.size >
+                    len(self._map) or
+                    self._product_offset + nbands * _INDEX.size >
+                    len(self._map)):
+                raise ValueError('Catalog %s is truncated or corrupt'
+                                 % catalog_file)
+        except ValueError:
+            self._map.close()
+            raise
+
+        self.nscenes = nscenes
+        self.nbands = nbands
+        self._strings_end = self._strings_offset + strings_size
+
+    def close(self):
+        '''
+        Description:
+          Unmaps the catalog
+        '''
+        self._map.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __len__(self):
+        return self.nscenes
+
+    def __getitem__(self, index):
+        if index < 0:
+            index += self.nscenes
+        if index < 0 or index >= self.nscenes:
+            raise IndexError(index)
+        return CatalogScene(self, index)
+
+    def _string(self, offset):
+        start = self._strings_offset + offset
+        end = self._map.find(b'\0', start, self._strings_end)
+        if end < 0:
+            return ''
+        return self._map[start:end].decode('utf-8', 'replace')
+
+    def _band(self, index):
+        return CatalogBand(_BAND.unpack_from(
+            self._map, self._band_offset + index * _BAND.size))
+
+    def _index(self, offset, position):
+        return _INDEX.unpack_from(self._map,
+                                  offset + position * _INDEX.size)[0]
+
+    def _scene_field(self, index, field):
+        return _SCENE.unpack_from(
+            self._map, self._scene_offset + index * _SCENE.size)[field]
+
+    def _has_product(self, scene, product):
+        key = product.encode('utf-8')
+        for band in range(scene._first_band,
+                          scene._first_band + scene._nbands):
+            offset = self._band_offset + band * _BAND.size
+            if self._map[offset:offset + 64].split(b'\0', 1)[0] == key:
+                return True
+        return False
+
+    def _bisect(self, count, key_of, key, upper):
+        '''
+        Description:
+          Binary search of a sorted index, where key_of(position) returns
+          the key of an index entry
+
+        Returns:
+          The first position whose key is >= key (> key if upper)
+        '''
+        (low, high) = (0, count)
+        while low < high:
+            mid = (low + high) // 2
+            entry = key_of(mid)
+            if entry > key or (entry == key and not upper):
+                high = mid
+            else:
+                low = mid + 1
+        return low
+
+    def _grid_range(self, offset, fields, key1, key2):
+        def key_of(position):
+            values = _SCENE.unpack_from(
+                self._map, self._scene_offset +
+                self._index(offset, position) * _SCENE.size)
+            if key2 is None:
+                return (values[fields[0]],)
+            return (values[fields[0]], values[fields[1]])
+        key = (key1,) if key2 is None else (key1, key2)
+        return (self._bisect(self.nscenes, key_of, key, False),
+                self._bisect(self.nscenes, key_of, key, True))
+
+    def _date_range(self, start_date, end_date):
+        def key_of(position):
+            return self._scene_field(position, 6).split(b'\0', 1)[0]
+        first = 0
+        last = self.nscenes
+        if start_date is not None:
+            first = self._bisect(self.nscenes, key_of,
+                                 start_date.encode('ascii'), False)
+        if end_date is not None:
+            last = self._bisect(self.nscenes, key_of,
+                                end_date.encode('ascii'), True)
+        return (first, max(first, last))
+
+    def _product_range(self, product):
+        def key_of(position):
+            band = _BAND.unpack_from(
+                self._map, self._band_offset +
+                self._index(self._product_offset, position) * _BAND.size)
+            return band[0].split(b'\0', 1)[0]
+        key = product.encode('utf-8')
+        return (self._bisect(self.nbands, key_of, key, False),
+                self._bisect(self.nbands, key_of, key, True))
+
+    def query(self, satellite=None, instrument=None, start_date=None,
+              end_date=None, wrs_path=None, wrs_row=None, htile=None,
+              vtile=None, product=None):
+        '''
+        Description:
+          Finds the products matching all the specified criteria.  The dates
+          are 'yyyy-mm-dd' strings and product is the product of at least one
+          band of the products.
+
+        Returns:
+          The list of matching CatalogScene in acquisition date order
+        '''
+        # Pick the index which selects the fewest records
+        (first, last) = self._date_range(start_date, end_date)
+        source = None
+        if wrs_path is not None:
+            (rfirst, rlast) = self._grid_range(self._pathrow_offset, (8, 9),
+                                               wrs_path, wrs_row)
+            if rlast - rfirst < last - first:
+                (source, first, last) = ('pathrow', rfirst, rlast)
+        if htile is not None:
+            (rfirst, rlast) = self._grid_range(self._tile_offset, (10, 11),
+                                               htile, vtile)
+            if rlast - rfirst < last - first:
+                (source, first, last) = ('tile', rfirst, rlast)
+        if product is not None:
+            (rfirst, rlast) = self._product_range(product)
+            if rlast - rfirst < last - first:
+                (source, first, last) = ('product', rfirst, rlast)
+
+        indexes = set()
+        for position in range(first, last):
+            if source == 'pathrow':
+                index = self._index(self._pathrow_offset, position)
+            elif source == 'tile':
+                index = self._index(self._tile_offset, position)
+            elif source == 'product':
+                index = _BAND.unpack_from(
+                    self._map, self._band_offset +
+                    self._index(self._product_offset, position) *
+                    _BAND.size)[3]
+            else:
+                index = position
+            indexes.add(index)
+
+        # Check the rest of the query on each selected scene
+        scenes = []
+        for index in sorted(indexes):
+            scene = CatalogScene(self, index)
+            if ((satellite is not None and scene.satellite != satellite) or
+                    (instrument is not None and
+                     scene.instrument != instrument) or
+                    (start_date is not None and
+                     scene.acquisition_date < start_date) or
+                    (end_date is not None and
+                     scene.acquisition_date > end_date) or
+                    (wrs_path is not None and scene.wrs_path != wrs_path) or
+                    (wrs_row is not None and scene.wrs_row != wrs_row) or
+                    (htile is not None and scene.htile != htile) or
+                    (vtile is not None and scene.vtile != vtile)):
+                continue
+            # Scenes found with the product index have the product
+            if (product is not None and source != 'product' and
+                    not self._has_product(scene, product)):
+                continue
+            scenes.append(scene)
+        return scenes
+# END Catalog
+
+
+def open_catalog(catalog_file):
+    '''
+    Description:
+      Opens a catalog built by build_espa_catalog
+
+    Returns:
+      The Catalog
+    '''
+    return Catalog(catalog_file)
+# END open_catalog
@@ -0,0 +1,584 @@
+
+'''
+License:
+  "NASA Open Source Agreement 1.3"
+
+Description:
+  This module provides fast access to the ESPA internal metadata.  The XML
+  is parsed and written by the C metadata library through the _espa_metadata
+  extension module, and the objects returned have the same get_* accessors as
+  the objects built by metadata_api.parse(...).
+
+Notes:
+  Use metadata_api for building metadata.  write_metadata(...) and
+  append_metadata(...) write either the metadata_api objects or the objects
+  of this module through the C library, which is much faster than
+  metadata_api.export(...) for products with many bands and bitmap
+  descriptions.  The XML files they write are stamped by the C library, so
+  validate_xml_file doesn't validate them again against the schema.
+
+  The values are converted to Python objects when they are first accessed.
+  The bitmap descriptions, classes, cover types, QA description and
+  statistics of the bands are only read from the XML when one of them is
+  first accessed.
+
+  If the _espa_metadata extension isn't available, parse(...) falls back to
+  metadata_api.parse(...), so callers only need the accessors common to both.
+
+  The dates and times are converted as metadata_api converts them when
+  metadata_api is available, otherwise they are returned as the strings in
+  the XML.
+
+History:
+  Created Oct/2026 for the ESPA product formatter
+'''
+
+try:
+    import _espa_metadata
+except ImportError:
+    _espa_metadata = None
+
+try:
+    import metadata_api
+except ImportError:
+    metadata_api = None
+
+try:
+    _string_types = basestring
+except NameError:
+    _string_types = str
+
+
+def _parse_date(value, kind):
+    '''
+    Description:
+      Converts a date, time or datetime string from the XML the same way
+      metadata_api does, if it's available
+
+    Returns:
+      The converted value, or the string if it can't be converted
+    '''
+    if value is None or metadata_api is None:
+        return value
+
+    parsers = {'date': metadata_api.GeneratedsSuper.gds_parse_date,
+               'time': metadata_api.GeneratedsSuper.gds_parse_time,
+               'datetime': metadata_api.GeneratedsSuper.gds_parse_datetime}
+    try:
+        return parsers[kind](value)
+    except ValueError:
+        return value
+# END _parse_date
+
+
+def _format_date(value, kind):
+    '''
+    Description:
+      Converts a date, time or datetime to the string written to the XML, the
+      same way metadata_api does if it's available
+
+    Returns:
+      The string, or None if there is no value
+    '''
+    if value is None or isinstance(value, _string_types):
+        return value
+    if metadata_api is None:
+        return value.isoformat()
+
+    formatter = metadata_api.GeneratedsSuper()
+    formatters = {'date': formatter.gds_format_date,
+                  'time': formatter.gds_format_time,
+                  'datetime': formatter.gds_format_datetime}
+    return formatters[kind](value)
+# END _format_date
+
+
+class Element(object):
+    '''
+    Description:
+      Holds the values of an XML element as attributes.  get_<name>() returns
+      the <name> attribute, as the metadata_api objects do.  Subclasses may
+      define _load() to provide attributes when they are first accessed.
+    '''
+    def __init__(self, **values):
+        self.__dict__.update(values)
+
+    def _load(self):
+        return False
+
+    def __getattr__(self, name):
+        if name.startswith('get_'):
+            attr = name[4:]
+            return lambda: getattr(self, attr)
+        if not name.startswith('_') and self._load():
+            return getattr(self, name)
+        raise AttributeError(name)
+
+    def __repr__(self):
+        return '%s(%s)' % (self.__class__.__name__, ', '.join(
+            '%s=%r' % (key, value) for (key, value)
+            in sorted(self.__dict__.items()) if not key.startswith('_')))
+# END Element
+
+
+class GlobalMetadata(Element):
+    '''
+    Description:
+      The global_metadata element, built from the global metadata of the C
+      metadata structure when it's first accessed
+    '''
+    def __init__(self, meta):
+        self._meta = meta
+
+    def _load(self):
+        if self._meta is None:
+            return False
+        values = self._meta.global_metadata()
+        self._meta = None
+
+        self.data_provider = values['data_provider']
+        self.satellite = values['satellite']
+        self.instrument = values['instrument']
+        self.acquisition_date = _parse_date(values['acquisition_date'],
+                                            'date')
+        self.scene_center_time = _parse_date(values['scene_center_time'],
+                                             'time')
+        self.level1_production_date = _parse_date(
+            values['level1_production_date'], 'datetime')
+
+        self.solar_angles = None
+        if values['solar_zenith'] is not None:
+            self.solar_angles = Element(zenith=values['solar_zenith'],
+                                        azimuth=values['solar_azimuth'],
+                                        units=values['solar_units'])
+        self.earth_sun_distance = values['earth_sun_distance']
+
+        self.wrs = None
+        if values['wrs_path'] is not None:
+            self.wrs = Element(system=values['wrs_system'],
+                               path=values['wrs_path'],
+                               row=values['wrs_row'])
+        self.modis = None
+        if values['htile'] is not None:
+            self.modis = Element(htile=values['htile'],
+                                 vtile=values['vtile'])
+
+        self.product_id = values['product_id']
+        self.lpgs_metadata_file = values['lpgs_metadata_file']
+        self.corner = [
+            Element(location='UL', latitude=values['ul_corner'][0],
+                    longitude=values['ul_corner'][1]),
+            Element(location='LR', latitude=values['lr_corner'][0],
+                    longitude=values['lr_corner'][1])]
+        (west, east, north, south) = values['bounding_coordinates']
+        self.bounding_coordinates = Element(west=west, east=east,
+                                            north=north, south=south)
+        self.projection_information = self._projection(values)
+        self.orientation_angle = values['orientation_angle']
+        self.valid_mask = values['valid_mask']
+        return True
+
+    @staticmethod
+    def _projection(values):
+        proj = Element(
+            projection=values['projection'], datum=values['datum'],
+            units=values['proj_units'], grid_origin=values['grid_origin'],
+            corner_point=[
+                Element(location='UL', x=values['proj_ul_corner'][0],
+                        y=values['proj_ul_corner'][1]),
+                Element(location='LR', x=values['proj_lr_corner'][0],
+                        y=values['proj_lr_corner'][1])],
+            utm_proj_params=None, ps_proj_params=None,
+            albers_proj_params=None, sin_proj_params=None)
+
+        if proj.projection == 'UTM':
+            proj.utm_proj_params = Element(zone_code=values['utm_zone'])
+        elif proj.projection == 'PS':
+            proj.ps_proj_params = Element(
+                longitude_pole=values['longitude_pole'],
+                latitude_true_scale=values['latitude_true_scale'],
+                false_easting=values['false_easting'],
+                false_northing=values['false_northing'])
+        elif proj.projection == 'ALBERS':
+            proj.albers_proj_params = Element(
+                standard_parallel1=values['standard_parallel1'],
+                standard_parallel2=values['standard_parallel2'],
+                central_meridian=values['central_meridian'],
+                origin_latitude=values['origin_latitude'],
+                false_easting=values['false_easting'],
+                false_northing=values['false_northing'])
+        elif proj.projection == 'SIN':
+            proj.sin_proj_params = Element(
+                sphere_radius=values['sphere_radius'],
+                central_meridian=values['central_meridian'],
+                false_easting=values['false_easting'],
+                false_northing=values['false_northing'])
+        return proj
+# END GlobalMetadata
+
+
+'''
+The band attributes which are only loaded with the band details.
+'''
+_BAND_DETAILS = ('bitmap_description', 'class_values', 'qa_description',
+                 'percent_coverage', 'constant', 'derived', 'tiling',
+                 'provenance', 'statistics')
+
+
+class Band(Element):
+    '''
+    Description:
+      A band element, built from a band of the C metadata structure when it's
+      first accessed.  The band details are loaded separately, the first
+      time one of them is accessed.
+    '''
+    def __init__(self, meta, index):
+        self._meta = meta
+        self._index = index
+        self._main_loaded = False
+
+    def _load(self):
+        if self._meta is None:
+            return False
+        if not self._main_loaded:
+            self._load_main()
+            return True
+        self._load_details()
+        self._meta = None
+        return True
+
+    def _load_main(self):
+        values = self._meta.band(self._index)
+        self._main_loaded = True
+
+        for key in ('product', 'source', 'name', 'category', 'data_type',
+                    'nlines', 'nsamps', 'fill_value', 'saturate_value',
+                    'scale_factor', 'add_offset', 'short_name', 'long_name',
+                    'file_name', 'resample_method', 'data_units',
+                    'checksum', 'app_version'):
+            setattr(self, key, values[key])
+        self.production_date = _parse_date(values['production_date'],
+                                           'datetime')
+        self.pixel_size = Element(x=values['pixel_size'][0],
+                                  y=values['pixel_size'][1],
+                                  units=values['pixel_units'])
+        self.sub_sample = None
+        (factor, nlines, nsamps) = values['sub_sample']
+        if factor > 1:
+            self.sub_sample = Element(factor=factor, nlines=nlines,
+                                      nsamps=nsamps)
+
+        self.valid_range = None
+        if values['valid_min'] is not None and values['valid_max'] is not None:
+            self.valid_range = Element(min=values['valid_min'],
+                                       max=values['valid_max'])
+        self.radiance = None
+        if values['rad_gain'] is not None and values['rad_bias'] is not None:
+            self.radiance = Element(gain=values['rad_gain'],
+                                    bias=values['rad_bias'])
+        self.reflectance = None
+        if (values['refl_gain'] is not None and
+                values['refl_bias'] is not None):
+            self.reflectance = Element(gain=values['refl_gain'],
+                                       bias=values['refl_bias'])
+        self.thermal_const = None
+        if values['k1_const'] is not None and values['k2_const'] is not None:
+            self.thermal_const = Element(k1=values['k1_const'],
+                                         k2=values['k2_const'])
+
+    def _load_details(self):
+        values = self._meta.band_details(self._index)
+
+        self.bitmap_description = None
+        if values['bitmap_description']:
+            self.bitmap_description = Element(bit=[
+                Element(num=num, valueOf_=text) for (num, text)
+                in enumerate(values['bitmap_description'])])
+        self.class_values = None
+        if values['class_values']:
+            self.class_values = Element(class_=[
+                Element(num=num, valueOf_=text) for (num, text)
+                in values['class_values']])
+        self.percent_coverage = None
+        if values['percent_coverage']:
+            self.percent_coverage = Element(cover=[
+                Element(type_=cover_type, valueOf_=percent)
+                for (cover_type, percent) in values['percent_coverage']])
+        self.qa_description = values['qa_description']
+        self.constant = None
+        if values['constant'] is not None:
+            (value, fill_band) = values['constant']
+            self.constant = Element(value=value)
+            if fill_band:
+                self.constant.fill_band = fill_band
+        self.derived = None
+        if values['derived'] is not None:
+            self.derived = Element(expression=values['derived'])
+        self.tiling = None
+        if values['tiling'] is not None:
+            (nlines, nsamps) = values['tiling']
+            self.tiling = Element(nlines=nlines, nsamps=nsamps)
+        self.provenance = None
+        if values['provenance'] is not None:
+            (stage, key) = values['provenance']
+            self.provenance = Element(stage=stage, key=key)
+        self.statistics = values['statistics']
+
+    def __getattr__(self, name):
+        # Only the band details need the second load; don't load them for
+        # a main attribute which doesn't exist
+        if (self.__dict__.get('_main_loaded') and
+                not name.startswith('get_') and name not in _BAND_DETAILS):
+            raise AttributeError(name)
+        return Element.__getattr__(self, name)
+# END Band
+
+
+class EspaMetadata(Element):
+    '''
+    Description:
+      The espa_metadata root element
+    '''
+    def __init__(self, xml_file):
+        meta = _espa_metadata.Metadata(xml_file)
+        self._meta = meta
+        self.global_metadata = GlobalMetadata(meta)
+        self.bands = Element(band=[Band(meta, index)
+                                   for index in range(len(meta))])
+
+    def find_band(self, product=None, name=None, category=None):
+        '''
+        Description:
+          Finds the first band matching the product, name and category.  A
+          value of None matches any band.
+
+        Returns:
+          The band, or None if no band matches
+        '''
+        index = self._meta.find_band(product, name, category)
+        if index is None:
+            return None
+        return self.bands.band[index]
+
+    def map_band(self, band, writable=False, access='sequential'):
+        '''
+        Description:
+          Memory maps the band file of one of the bands of this metadata.
+          access is 'sequential' or 'random'.
+
+        Returns:
+          The _espa_metadata.MappedBand, which exports the band data through
+          the buffer protocol (see espa_bands.py)
+        '''
+        return self._meta.map_band(band._index, writable=writable,
+                                   access=access)
+# END EspaMetadata
+
+
+def parse(xml_file, silence=True):
+    '''
+    Description:
+      Reads the ESPA XML metadata file
+
+    Returns:
+      The espa_metadata object, from the C metadata library if it's
+      available, otherwise from metadata_api
+
+    Notes:
+      The silence argument is only used by the metadata_api fallback.
+    '''
+    if _espa_metadata is not None:
+        return EspaMetadata(xml_file)
+    if metadata_api is None:
+        raise ImportError('Neither _espa_metadata nor metadata_api is '
+                          'available')
+    return metadata_api.parse(xml_file, silence=silence)
+# END parse
+
+
+def _get(element, name):
+    '''
+    Description:
+      Returns an attribute of an element of either metadata_api or this
+      module
+
+    Returns:
+      The attribute, or None if the element or attribute is missing
+    '''
+    if element is None:
+        return None
+    return getattr(element, name, None)
+# END _get
+
+
+def _global_values(gmeta):
+    '''
+    Description:
+      Converts the global_metadata element to the dictionary written by
+      _espa_metadata.write_metadata
+
+    Returns:
+      The global metadata dictionary
+    '''
+    solar_angles = _get(gmeta, 'solar_angles')
+    wrs = _get(gmeta, 'wrs')
+    modis = _get(gmeta, 'modis')
+    corners = dict((corner.location, (corner.latitude, corner.longitude))
+                   for corner in (_get(gmeta, 'corner') or []))
+    bounds = _get(gmeta, 'bounding_coordinates')
+    proj = _get(gmeta, 'projection_information')
+    proj_corners = dict((corner.location, (corner.x, corner.y))
+                        for corner in (_get(proj, 'corner_point') or []))
+
+    values = {
+        'data_provider': _get(gmeta, 'data_provider'),
+        'satellite': _get(gmeta, 'satellite'),
+        'instrument': _get(gmeta, 'instrument'),
+        'acquisition_date': _format_date(_get(gmeta, 'acquisition_date'),
+                                         'date'),
+        'scene_center_time': _format_date(_get(gmeta, 'scene_center_time'),
+                                          'time'),
+        'level1_production_date': _format_date(
+            _get(gmeta, 'level1_production_date'), 'datetime'),
+        'solar_zenith': _get(solar_angles, 'zenith'),
+        'solar_azimuth': _get(solar_angles, 'azimuth'),
+        'solar_units': _get(solar_angles, 'units'),
+        'earth_sun_distance': _get(gmeta, 'earth_sun_distance'),
+        'wrs_system': _get(wrs, 'system'),
+        'wrs_path': _get(wrs, 'path'),
+        'wrs_row': _get(wrs, 'row'),
+        'htile': _get(modis, 'htile'),
+        'vtile': _get(modis, 'vtile'),
+        'product_id': _get(gmeta, 'product_id'),
+        'lpgs_metadata_file': _get(gmeta, 'lpgs_metadata_file'),
+        'ul_corner': corners.get('UL'),
+        'lr_corner': corners.get('LR'),
+        'bounding_coordinates': None,
+        'orientation_angle': _get(gmeta, 'orientation_angle'),
+        'valid_mask': _get(gmeta, 'valid_mask'),
+        'projection': _get(proj, 'projection'),
+        'datum': _get(proj, 'datum'),
+        'proj_units': _get(proj, 'units'),
+        'proj_ul_corner': proj_corners.get('UL'),
+        'proj_lr_corner': proj_corners.get('LR'),
+        'grid_origin': _get(proj, 'grid_origin'),
+        'utm_zone': _get(_get(proj, 'utm_proj_params'), 'zone_code')}
+    if bounds is not None:
+        values['bounding_coordinates'] = (bounds.west, bounds.east,
+                                          bounds.north, bounds.south)
+
+    # The parameters of the other projections share their names
+    for params in ('ps_proj_params', 'albers_proj_params',
+                   'sin_proj_params'):
+        params = _get(proj, params)
+        for key in ('longitude_pole', 'latitude_true_scale', 'false_easting',
+                    'false_northing', 'standard_parallel1',
+                    'standard_parallel2', 'central_meridian',
+                    'origin_latitude', 'sphere_radius'):
+            if _get(params, key) is not None:
+                values[key] = _get(params, key)
+    return values
+# END _global_values
+
+
+def _band_values(band):
+    '''
+    Description:
+      Converts a band element to the dictionary written by
+      _espa_metadata.write_metadata
+
+    Returns:
+      The band dictionary
+    '''
+    values = dict((key, _get(band, key)) for key in (
+        'product', 'source', 'name', 'category', 'data_type', 'nlines',
+        'nsamps', 'fill_value', 'saturate_value', 'scale_factor',
+        'add_offset', 'short_name', 'long_name', 'file_name',
+        'resample_method', 'data_units', 'checksum', 'qa_description',
+        'app_version', 'statistics'))
+    values['production_date'] = _format_date(_get(band, 'production_date'),
+                                             'datetime')
+
+    pixel_size = _get(band, 'pixel_size')
+    if pixel_size is not None:
+        values['pixel_size'] = (pixel_size.x, pixel_size.y)
+        values['pixel_units'] = pixel_size.units
+    for (element, low, high, keys) in (
+            ('valid_range', 'min', 'max', ('valid_min', 'valid_max')),
+            ('radiance', 'gain', 'bias', ('rad_gain', 'rad_bias')),
+            ('reflectance', 'gain', 'bias', ('refl_gain', 'refl_bias')),
+            ('thermal_const', 'k1', 'k2', ('k1_const', 'k2_const'))):
+        element = _get(band, element)
+        values[keys[0]] = _get(element, low)
+        values[keys[1]] = _get(element, high)
+
+    sub_sample = _get(band, 'sub_sample')
+    if sub_sample is not None:
+        values['sub_sample'] = (sub_sample.factor, sub_sample.nlines,
+                                sub_sample.nsamps)
+    constant = _get(band, 'constant')
+    if constant is not None:
+        values['constant'] = (constant.value, _get(constant, 'fill_band'))
+    values['derived'] = _get(_get(band, 'derived'), 'expression')
+    tiling = _get(band, 'tiling')
+    if tiling is not None:
+        values['tiling'] = (tiling.nlines, tiling.nsamps)
+    provenance = _get(band, 'provenance')
+    if provenance is not None:
+        values['provenance'] = (provenance.stage, provenance.key)
+
+    bits = _get(_get(band, 'bitmap_description'), 'bit') or []
+    values['bitmap_description'] = [
+        bit.valueOf_ for bit in sorted(bits, key=lambda bit: int(bit.num))]
+    values['class_values'] = [
+        (int(class_.num), class_.valueOf_) for class_
+        in _get(_get(band, 'class_values'), 'class_') or []]
+    values['percent_coverage'] = [
+        (cover.type_, float(cover.valueOf_)) for cover
+        in _get(_get(band, 'percent_coverage'), 'cover') or []]
+    return values
+# END _band_values
+
+
+def write_metadata(espa_metadata, xml_file):
+    '''
+    Description:
+      Writes the espa_metadata object, from metadata_api or this module, to
+      the XML metadata file
+
+    Notes:
+      The file is written by the C metadata library if the _espa_metadata
+      extension is available, otherwise by metadata_api.export(...).
+    '''
+    if _espa_metadata is None:
+        with open(xml_file, 'w') as xml_fd:
+            metadata_api.export(xml_fd, espa_metadata)
+        return
+
+    _espa_metadata.write_metadata(
+        _global_values(espa_metadata.global_metadata),
+        [_band_values(band) for band in espa_metadata.bands.band], xml_file)
+# END write_metadata
+
+
+def append_metadata(bands, xml_file):
+    '''
+    Description:
+      Appends band objects, from metadata_api or this module, to the bands
+      of the XML metadata file
+
+    Notes:
+      The bands are appended by the C metadata library if the
+      _espa_metadata extension is available, otherwise the file is parsed
+      and exported again by metadata_api.
+    '''
+    if _espa_metadata is None:
+        espa_metadata = metadata_api.parse(xml_file, silence=True)
+        for band in bands:
+            espa_metadata.bands.add_band(band)
+        write_metadata(espa_metadata, xml_file)
+        return
+
+    _espa_metadata.append_metadata([_band_values(band) for band in bands],
+                                   xml_file)
+# END append_metadata
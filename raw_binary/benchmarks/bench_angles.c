@@ -0,0 +1,148 @@
+/*****************************************************************************
+FILE: bench_angles.c
+
+PURPOSE: Contains the benchmark of the per-pixel angle calculation from the
+RPC coefficients of an ANG file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. There is no synthetic ANG file, since the RPC coefficients only make
+     sense for a real scene, so the benchmark needs the ANG file of one.
+*****************************************************************************/
+#include "espa_bench.h"
+#include "ias_angle_gen_distro.h"
+
+/* Defines */
+/* Number of pixels along each side of the grid of pixels the angles are
+   computed for */
+#define ANGLE_GRID 256
+
+/* Angle metadata and band for the angle benchmark */
+typedef struct
+{
+    IAS_ANGLE_GEN_METADATA *metadata;  /* angle metadata of the scene */
+    int band_index;         /* index of the band the angles are for */
+    IAS_ANGLE_GEN_TYPE type;/* satellite or solar angles */
+} Bench_angles_t;
+
+
+/******************************************************************************
+MODULE:  bench_angles
+
+PURPOSE: Computes the angles of a grid of pixels covering the band with
+ias_angle_gen_calculate_angles_rpc.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the angles
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_angles
+(
+    void *arg               /* I: angle metadata and band (Bench_angles_t) */
+)
+{
+    Bench_angles_t *angles = arg;  /* angle metadata and band */
+    const IAS_ANGLE_GEN_BAND *band =
+        &angles->metadata->band_metadata[angles->band_index];
+    int line;               /* line index in the grid */
+    int samp;               /* sample index in the grid */
+    int outside_image_flag; /* was the pixel outside the image? */
+    double angle[2];        /* zenith and azimuth of the pixel */
+
+    for (line = 0; line < ANGLE_GRID; line++)
+    {
+        for (samp = 0; samp < ANGLE_GRID; samp++)
+        {
+            if (ias_angle_gen_calculate_angles_rpc (angles->metadata,
+                (double) line * (band->l1t_lines - 1) / (ANGLE_GRID - 1),
+                (double) samp * (band->l1t_samps - 1) / (ANGLE_GRID - 1),
+                NULL, angles->band_index, angles->type, &outside_image_flag,
+                angle) != SUCCESS)
+                return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  run_angle_benchmarks
+
+PURPOSE: Runs the angles_rpc benchmark on the first band of the ANG file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmark
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int run_angle_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    char *ang_file          /* I: name of the ANG file; NULL if not given */
+)
+{
+    char FUNC_NAME[] = "run_angle_benchmarks";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char bench_case[STR_SIZE];  /* name of the case */
+    IAS_ANGLE_GEN_METADATA metadata;  /* angle metadata of the scene */
+    Bench_angles_t angles;  /* angles computed */
+    int status;             /* status of the benchmarks */
+
+    if (!is_selected (options, "angles_rpc"))
+        return (SUCCESS);
+
+    if (ang_file == NULL)
+    {
+        report_skipped (options, "angles_rpc", "no ANG file given");
+        return (SUCCESS);
+    }
+
+    if (ias_angle_gen_read_ang (ang_file, &metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the ANG file %s", ang_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Use the first band in the ANG file */
+    angles.metadata = &metadata;
+    for (angles.band_index = 0; angles.band_index < IAS_MAX_NBANDS &&
+        !metadata.band_present[angles.band_index]; angles.band_index++)
+        ;
+    if (angles.band_index == IAS_MAX_NBANDS)
+    {
+        sprintf (errmsg, "No bands in the ANG file %s", ang_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        ias_angle_gen_free (&metadata);
+        return (ERROR);
+    }
+
+    angles.type = IAS_ANGLE_GEN_SATELLITE;
+    sprintf (bench_case, "satellite_band%d",
+        metadata.band_metadata[angles.band_index].band_number);
+    status = run_benchmark (options, "angles_rpc", bench_case, bench_angles,
+        &angles, ANGLE_GRID * ANGLE_GRID, 0);
+    angles.type = IAS_ANGLE_GEN_SOLAR;
+    sprintf (bench_case, "solar_band%d",
+        metadata.band_metadata[angles.band_index].band_number);
+    if (status == SUCCESS)
+        status = run_benchmark (options, "angles_rpc", bench_case,
+            bench_angles, &angles, ANGLE_GRID * ANGLE_GRID, 0);
+
+    ias_angle_gen_free (&metadata);
+    return (status);
+}
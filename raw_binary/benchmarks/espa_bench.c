@@ -0,0 +1,1867 @@
+/*****************************************************************************
+FILE: espa_bench
+
+PURPOSE: Times the hot paths of the raw binary libraries on synthetic data
+and writes the results as JSON lines, so the performance of the libraries
+can be measured and regressions caught.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The benchmarks are read_raw_binary, write_raw_binary, parse_metadata,
+     write_metadata (on 10, 50 and 100 band XML files),
+     find_band_metadata, subset_metadata_by_band,
+     subset_metadata_by_product (on 5000 band metadata),
+     point_in_closed_polygon, shape_mask (on a synthetic coastline),
+     angles_rpc, bip_interleave and clip_band_misalignment.  angles_rpc
+     needs the ANG file of a real scene and is reported as skipped without
+     one.
+  2. Each benchmark is run once to warm up, and then repeatedly until it
+     has run for the minimum time.  Its result is a JSON line with the
+     "benchmark", "case", "iterations", "seconds" (total of the timed
+     iterations), "seconds_per_iteration", "ns_per_op" and, for the I/O
+     benchmarks, "mb_per_sec".  An operation is a pixel, a point or a file
+     depending on the benchmark.
+  3. The synthetic files are written by the synthetic scene generator of
+     the raw binary library to the working directory, which is a new
+     temporary directory by default, and removed at the end.  The band
+     files are usually in the page cache, so the I/O benchmarks measure the
+     library rather than the disk.
+  4. The environment variables which tune the libraries (ESPA_WRITE_CACHE,
+     ESPA_ASYNC_IO, ESPA_METADATA_CACHE, ESPA_XML_VALIDATION,
+     ESPA_POLYGON_ISA, ESPA_SHAPE_MASK_ISA, ...) apply to the benchmarks,
+     so their settings can be compared.  ESPA_SCHEMA must point to the
+     schema if it isn't installed.
+  5. large_band is only run when asked for with --large_size.  It writes a
+     single UINT8 band of large_size x large_size pixels with the synthetic
+     scene generator and reads it back, so a size over 46341 checks the
+     64-bit offsets of bands beyond 2^31 pixels.  The band needs
+     large_size^2 bytes of disk, e.g. 10 GB at 100000.
+*****************************************************************************/
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "espa_bench.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "convert_espa_to_raw_binary_bip.h"
+#include "clip_band_misalignment.h"
+#include "subset_metadata.h"
+#include "synthetic_scene.h"
+#include "ias_lw_geo.h"
+#include "ias_math.h"
+
+/* Defines */
+/* Numbers of bands of the XML files the metadata is benchmarked on */
+#define NMETA_CASES 3
+static const int meta_nbands[NMETA_CASES] = {10, 50, 100};
+
+/* Number of bands of the metadata the band lookups and subsets are
+   benchmarked on, and the number of those bands in each product */
+#define NSUBSET_BANDS 5000
+#define NSUBSET_PRODUCT_BANDS 50
+
+/* Image bands of the synthetic ETM+ scene */
+#define NSCENE_BANDS 8
+static const char *scene_bands[NSCENE_BANDS] =
+{
+    "band1", "band2", "band3", "band4", "band5", "band61", "band62", "band7"
+};
+
+/* Extent of the synthetic coastline and of the masks (degrees) */
+#define COAST_NORTH 40.0
+#define COAST_SOUTH 39.0
+#define COAST_WEST -100.0
+#define COAST_EAST -99.0
+
+/* Number of vertices along the coastline and around each island */
+#define COAST_POINTS 20000
+#define ISLAND_POINTS 1000
+
+/* Number of islands along each side of the grid of islands */
+#define ISLAND_GRID 4
+
+/* Number of points tested against the polygon along each side of the grid
+   of points */
+#define POINT_GRID 256
+
+/* Number of lines of the large band read at a time, and number of samples
+   of the window read at its last corner */
+#define LARGE_BLOCK_LINES 64
+#define LARGE_CORNER 16
+
+/* Band file read or written by the I/O benchmarks */
+typedef struct
+{
+    char *file_name;        /* name of the band file */
+    int nlines;             /* number of lines in the band */
+    int nsamps;             /* number of samples in the band */
+    int16_t *buf;           /* band data */
+} Bench_band_t;
+
+/* XML file the metadata benchmarks read or write */
+typedef struct
+{
+    char *xml_file;                 /* name of the XML file */
+    Espa_internal_meta_t *metadata; /* metadata written to the file */
+} Bench_meta_t;
+
+/* Metadata and the band names or products the lookup and subset benchmarks
+   search for */
+typedef struct
+{
+    Espa_internal_meta_t *metadata; /* metadata searched and subset */
+    int nnames;                     /* number of names */
+    char (*names)[STR_SIZE];        /* band names or products */
+} Bench_subset_t;
+
+/* Polygon and points for the point in polygon benchmark */
+typedef struct
+{
+    const IAS_POLYGON_LINKED_LIST *polygon;  /* polygon tested */
+    unsigned int num_segs;  /* number of segments used; 0 to test every side
+                               of the polygon */
+    int npoints;            /* number of points */
+    double *point_x;        /* x of the points */
+    double *point_y;        /* y of the points */
+    long inside;            /* number of points inside the polygon */
+} Bench_points_t;
+
+/* Polygon file and mask for the shape mask benchmarks */
+typedef struct
+{
+    char *polygon_file;     /* name of the polygon file */
+    bool scanline;          /* use ias_geo_shape_mask_scanline? */
+    int nlines;             /* number of lines in the mask */
+    int nsamps;             /* number of samples in the mask */
+    unsigned char *mask;    /* mask bits */
+} Bench_mask_t;
+
+/* Scene the BIP and clipping benchmarks run on */
+typedef struct
+{
+    char *xml_file;         /* name of the XML file of the scene */
+    char *bip_file;         /* name of the BIP file written */
+} Bench_scene_t;
+
+/* Band of the large band check */
+typedef struct
+{
+    Espa_band_meta_t *bmeta;  /* metadata of the band */
+    uint8_t *buf;           /* block of LARGE_BLOCK_LINES lines */
+    uint8_t *corner;        /* window at the last corner of the band */
+} Bench_large_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_bench times the hot paths of the raw binary libraries on "
+            "synthetic data and writes the results as JSON lines.\n\n");
+    printf ("usage: espa_bench [--nlines=lines] [--nsamps=samples] "
+            "[--min_seconds=seconds] [--filter=benchmark] "
+            "[--ang_file=ang_filename] [--workdir=directory] "
+            "[--output=results_filename] [--large_size=lines]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -nlines: number of lines in the synthetic bands and masks "
+            "(default is 2048)\n");
+    printf ("    -nsamps: number of samples in the synthetic bands and masks "
+            "(default is 2048)\n");
+    printf ("    -min_seconds: minimum time each benchmark is run for "
+            "(default is 1.0)\n");
+    printf ("    -filter: only run the benchmarks whose name contains this "
+            "string\n");
+    printf ("    -ang_file: ANG file of a Landsat 8 scene for the angles_rpc "
+            "benchmark, which is skipped without one\n");
+    printf ("    -workdir: existing directory the synthetic files are "
+            "written to (default is a new temporary directory)\n");
+    printf ("    -output: file the results are appended to (default is the "
+            "standard output, with the library messages moved to the "
+            "standard error)\n");
+    printf ("    -large_size: number of lines and samples of the band of the "
+            "large_band check, which is skipped without it; more than 46341 "
+            "for a band beyond 2^31 pixels\n");
+    printf ("\nExample: espa_bench --min_seconds=2 --filter=metadata "
+            "--output=bench.json\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input strings.  It is up to the caller to
+     free them.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    int *nlines,          /* O: number of lines in the synthetic data */
+    int *nsamps,          /* O: number of samples in the synthetic data */
+    double *min_seconds,  /* O: minimum time each benchmark is run for */
+    char **filter,        /* O: address of the benchmark filter */
+    char **ang_file,      /* O: address of the ANG filename */
+    char **workdir,       /* O: address of the working directory */
+    char **output_file,   /* O: address of the results filename */
+    int *large_size       /* O: number of lines and samples of the large
+                                band; 0 to skip it */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"nlines", required_argument, 0, 'l'},
+        {"nsamps", required_argument, 0, 's'},
+        {"min_seconds", required_argument, 0, 't'},
+        {"filter", required_argument, 0, 'f'},
+        {"ang_file", required_argument, 0, 'a'},
+        {"workdir", required_argument, 0, 'w'},
+        {"output", required_argument, 0, 'o'},
+        {"large_size", required_argument, 0, 'g'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'l':  /* number of lines */
+                *nlines = atoi (optarg);
+                break;
+
+            case 's':  /* number of samples */
+                *nsamps = atoi (optarg);
+                break;
+
+            case 't':  /* minimum time of each benchmark */
+                *min_seconds = atof (optarg);
+                break;
+
+            case 'f':  /* benchmark filter */
+                *filter = strdup (optarg);
+                break;
+
+            case 'a':  /* ANG filename */
+                *ang_file = strdup (optarg);
+                break;
+
+            case 'w':  /* working directory */
+                *workdir = strdup (optarg);
+                break;
+
+            case 'o':  /* results filename */
+                *output_file = strdup (optarg);
+                break;
+
+            case 'g':  /* size of the large band */
+                *large_size = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the size of the synthetic data is valid */
+    if (*nlines < 16 || *nsamps < 16)
+    {
+        sprintf (errmsg, "Number of lines and samples must be at least 16");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the size of the large band is valid */
+    if (*large_size != 0 && (*large_size < LARGE_BLOCK_LINES ||
+        *large_size > SYNTHETIC_MAX_SIZE))
+    {
+        sprintf (errmsg, "Size of the large band must be from %d to %d",
+            LARGE_BLOCK_LINES, SYNTHETIC_MAX_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the minimum time is valid */
+    if (*min_seconds < 0.0)
+    {
+        sprintf (errmsg, "Minimum time must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_seconds
+
+PURPOSE: Returns the time of the monotonic clock in seconds.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+seconds         Time of the monotonic clock
+
+NOTES:
+******************************************************************************/
+static double elapsed_seconds (void)
+{
+    struct timespec now;         /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec + now.tv_nsec * 1e-9);
+}
+
+
+/******************************************************************************
+MODULE:  is_selected
+
+PURPOSE: Determines whether a benchmark is selected by the filter.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The benchmark is run
+false           The benchmark is skipped
+
+NOTES:
+******************************************************************************/
+bool is_selected
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    const char *benchmark            /* I: name of the benchmark */
+)
+{
+    return (options->filter == NULL ||
+        strstr (benchmark, options->filter) != NULL);
+}
+
+
+/******************************************************************************
+MODULE:  run_benchmark
+
+PURPOSE: Runs a benchmark once to warm up and then until it has run for the
+minimum time, and writes its result as a JSON line.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The benchmarked operation failed
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int run_benchmark
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    const char *benchmark,  /* I: name of the benchmark */
+    const char *bench_case, /* I: name of the case of the benchmark */
+    Bench_func_t func,      /* I: operation timed */
+    void *arg,              /* I: passed to func */
+    double ops,             /* I: number of operations in each call of func */
+    double nbytes           /* I: number of bytes read or written in each
+                                  call of func; 0 if not an I/O benchmark */
+)
+{
+    char FUNC_NAME[] = "run_benchmark";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    long iterations = 0;    /* number of timed calls of func */
+    double start;           /* time the timed calls started */
+    double seconds;         /* time of the timed calls */
+
+    if (!is_selected (options, benchmark))
+        return (SUCCESS);
+
+    /* Warm up the caches, and run until the minimum time has passed */
+    if (func (arg) != SUCCESS)
+    {
+        sprintf (errmsg, "Running the %s benchmark for %s", benchmark,
+            bench_case);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    start = elapsed_seconds ();
+    do
+    {
+        if (func (arg) != SUCCESS)
+        {
+            sprintf (errmsg, "Running the %s benchmark for %s", benchmark,
+                bench_case);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        iterations++;
+        seconds = elapsed_seconds () - start;
+    } while (seconds < options->min_seconds);
+
+    fprintf (options->out, "{\"benchmark\": \"%s\", \"case\": \"%s\", "
+        "\"iterations\": %ld, \"seconds\": %.6f, "
+        "\"seconds_per_iteration\": %.9f, \"ns_per_op\": %.3f", benchmark,
+        bench_case, iterations, seconds, seconds / iterations,
+        seconds * 1e9 / (iterations * ops));
+    if (nbytes > 0.0)
+        fprintf (options->out, ", \"mb_per_sec\": %.3f",
+            nbytes * iterations / (seconds * 1048576.0));
+    fprintf (options->out, "}\n");
+    fflush (options->out);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_skipped
+
+PURPOSE: Writes a JSON line for a benchmark which couldn't be run.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void report_skipped
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    const char *benchmark,  /* I: name of the benchmark */
+    const char *reason      /* I: why it was skipped */
+)
+{
+    if (!is_selected (options, benchmark))
+        return;
+
+    fprintf (options->out, "{\"benchmark\": \"%s\", \"skipped\": \"%s\"}\n",
+        benchmark, reason);
+    fflush (options->out);
+}
+
+
+/******************************************************************************
+MODULE:  bench_write_band
+
+PURPOSE: Writes a band with write_raw_binary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_write_band
+(
+    void *arg               /* I: band written (Bench_band_t) */
+)
+{
+    Bench_band_t *band = arg;  /* band written */
+    FILE *fp;                  /* band file */
+    int status;                /* status of the write */
+
+    fp = open_raw_binary (band->file_name, "w");
+    if (fp == NULL)
+        return (ERROR);
+
+    status = write_raw_binary (fp, band->nlines, band->nsamps,
+        sizeof (int16_t), band->buf);
+    close_raw_binary (fp);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_read_band
+
+PURPOSE: Reads a band with read_raw_binary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_read_band
+(
+    void *arg               /* I: band read (Bench_band_t) */
+)
+{
+    Bench_band_t *band = arg;  /* band read */
+    FILE *fp;                  /* band file */
+    int status;                /* status of the read */
+
+    fp = open_raw_binary (band->file_name, "r");
+    if (fp == NULL)
+        return (ERROR);
+
+    status = read_raw_binary (fp, band->nlines, band->nsamps,
+        sizeof (int16_t), band->buf);
+    close_raw_binary (fp);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_write_metadata
+
+PURPOSE: Writes the metadata to an XML file with write_metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the metadata
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_write_metadata
+(
+    void *arg               /* I: XML file written (Bench_meta_t) */
+)
+{
+    Bench_meta_t *meta = arg;  /* XML file written */
+
+    return (write_metadata (meta->metadata, meta->xml_file));
+}
+
+
+/******************************************************************************
+MODULE:  bench_parse_metadata
+
+PURPOSE: Parses an XML file with parse_metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_parse_metadata
+(
+    void *arg               /* I: XML file parsed (Bench_meta_t) */
+)
+{
+    Bench_meta_t *meta = arg;  /* XML file parsed */
+    Espa_internal_meta_t metadata;  /* metadata read from the file */
+    int status;                /* status of the parse */
+
+    init_metadata_struct (&metadata);
+    status = parse_metadata (meta->xml_file, &metadata);
+    free_metadata (&metadata);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_find_band_metadata
+
+PURPOSE: Looks up each of the bands of the metadata by name with
+find_band_metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A band wasn't found
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_find_band_metadata
+(
+    void *arg               /* I: metadata and band names (Bench_subset_t) */
+)
+{
+    Bench_subset_t *subset = arg;  /* metadata and band names */
+    int i;                  /* looping variable for the names */
+
+    for (i = 0; i < subset->nnames; i++)
+    {
+        if (find_band_metadata (subset->metadata, NULL, subset->names[i],
+            NULL) < 0)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  bench_subset_metadata_by_band
+
+PURPOSE: Subsets the metadata to the named bands with
+subset_metadata_by_band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the metadata
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_subset_metadata_by_band
+(
+    void *arg               /* I: metadata and band names (Bench_subset_t) */
+)
+{
+    Bench_subset_t *subset = arg;  /* metadata and band names */
+    Espa_internal_meta_t outmeta;  /* subset metadata */
+    int status;                /* status of the subset */
+
+    status = subset_metadata_by_band (subset->metadata, &outmeta,
+        subset->nnames, subset->names);
+    free_metadata (&outmeta);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_subset_metadata_by_product
+
+PURPOSE: Subsets the metadata to the bands of the named products with
+subset_metadata_by_product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the metadata
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_subset_metadata_by_product
+(
+    void *arg               /* I: metadata and products (Bench_subset_t) */
+)
+{
+    Bench_subset_t *subset = arg;  /* metadata and products */
+    Espa_internal_meta_t outmeta;  /* subset metadata */
+    int status;                /* status of the subset */
+
+    status = subset_metadata_by_product (subset->metadata, &outmeta,
+        subset->nnames, subset->names);
+    free_metadata (&outmeta);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  bench_point_in_polygon
+
+PURPOSE: Tests the grid of points against the polygon with
+ias_math_point_in_closed_polygon.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_point_in_polygon
+(
+    void *arg               /* I/O: polygon and points (Bench_points_t) */
+)
+{
+    Bench_points_t *points = arg;  /* polygon and points */
+    const IAS_POLYGON_LINKED_LIST *polygon = points->polygon;
+    int i;                  /* point index */
+    long inside = 0;        /* number of points inside the polygon */
+
+    for (i = 0; i < points->npoints; i++)
+    {
+        if (ias_math_point_in_closed_polygon (polygon->num_points - 1,
+            polygon->point_x, polygon->point_y, points->point_x[i],
+            points->point_y[i], points->num_segs, polygon->poly_seg))
+            inside++;
+    }
+
+    /* Keep the result, so the calls can't be optimized away */
+    points->inside = inside;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  bench_shape_mask
+
+PURPOSE: Creates the mask of the polygon file with ias_geo_shape_mask or
+ias_geo_shape_mask_scanline.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the mask
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_shape_mask
+(
+    void *arg               /* I/O: polygon file and mask (Bench_mask_t) */
+)
+{
+    Bench_mask_t *mask = arg;  /* polygon file and mask */
+
+    if (mask->scanline)
+        return (ias_geo_shape_mask_scanline (mask->polygon_file,
+            mask->nlines, mask->nsamps, COAST_NORTH, COAST_SOUTH, COAST_WEST,
+            COAST_EAST, mask->mask));
+
+    return (ias_geo_shape_mask (mask->polygon_file, mask->nlines,
+        mask->nsamps, COAST_NORTH, COAST_SOUTH, COAST_WEST, COAST_EAST,
+        mask->mask));
+}
+
+
+/******************************************************************************
+MODULE:  bench_bip
+
+PURPOSE: Interleaves the scene into a BIP file with
+convert_espa_to_raw_binary_bip.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the scene
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int bench_bip
+(
+    void *arg               /* I: scene converted (Bench_scene_t) */
+)
+{
+    Bench_scene_t *scene = arg;  /* scene converted */
+
+    return (convert_espa_to_raw_binary_bip (scene->xml_file, scene->bip_file,
+        false, false));
+}
+
+
+/******************************************************************************
+MODULE:  bench_clip
+
+PURPOSE: Clips the band misalignment of the scene with
+clip_band_misalignment.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error clipping the scene
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The bands are only changed by the first call, so the later calls clip
+     a scene whose fill is already aligned.  They still read every band and
+     write back the lines with fill.
+******************************************************************************/
+static int bench_clip
+(
+    void *arg               /* I: scene clipped (Bench_scene_t) */
+)
+{
+    Bench_scene_t *scene = arg;  /* scene clipped */
+
+    return (clip_band_misalignment (scene->xml_file));
+}
+
+
+/******************************************************************************
+MODULE:  bench_large_band
+
+PURPOSE: Reads the large band with read_raw_binary, and checks that it ends
+where its size says and that a window at its last corner read with
+read_raw_binary_window matches the lines read.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band, or the reads don't agree
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The window is read at the byte offset of the last corner, computed
+     from the band size, while the lines are read in order, so an offset
+     truncated to 32 bits reads a different window or fails.
+******************************************************************************/
+static int bench_large_band
+(
+    void *arg               /* I: band read (Bench_large_t) */
+)
+{
+    char FUNC_NAME[] = "bench_large_band";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    Bench_large_t *large = arg;  /* band read */
+    Espa_band_meta_t *bmeta = large->bmeta;  /* metadata of the band */
+    uint8_t *last_line;     /* last line of the band in the block */
+    int line;               /* first line of the current block */
+    int nlines = 0;         /* number of lines in the current block */
+    int status = SUCCESS;   /* status of the reads */
+    FILE *fp;               /* band file */
+
+    fp = open_raw_binary (bmeta->file_name, "r");
+    if (fp == NULL)
+        return (ERROR);
+
+    for (line = 0; line < bmeta->nlines && status == SUCCESS;
+         line += LARGE_BLOCK_LINES)
+    {
+        nlines = bmeta->nlines - line;
+        if (nlines > LARGE_BLOCK_LINES)
+            nlines = LARGE_BLOCK_LINES;
+        status = read_raw_binary (fp, nlines, bmeta->nsamps,
+            sizeof (uint8_t), large->buf);
+    }
+    if (status == SUCCESS && fgetc (fp) != EOF)
+    {
+        sprintf (errmsg, "Band file %s continues past its %d lines",
+            bmeta->file_name, bmeta->nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status == SUCCESS)
+        status = read_raw_binary_window (fp, bmeta, bmeta->nlines - 1,
+            bmeta->nsamps - LARGE_CORNER, 1, LARGE_CORNER, 1,
+            large->corner);
+    last_line = large->buf + (size_t) (nlines - 1) * bmeta->nsamps;
+    if (status == SUCCESS && memcmp (large->corner,
+        last_line + bmeta->nsamps - LARGE_CORNER, LARGE_CORNER) != 0)
+    {
+        sprintf (errmsg, "Window at the last corner of band file %s doesn't "
+            "match its last line", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    close_raw_binary (fp);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_bench_scene
+
+PURPOSE: Describes the synthetic product the benchmarks run on: bands of the
+given size over the extent of the synthetic coastline.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void init_bench_scene
+(
+    int nlines,             /* I: number of lines in the bands */
+    int nsamps,             /* I: number of samples in the bands */
+    Synthetic_scene_t *scene  /* O: synthetic product */
+)
+{
+    init_synthetic_scene (scene);
+    scene->nlines = nlines;
+    scene->nsamps = nsamps;
+    scene->bounding_coords[ESPA_WEST] = COAST_WEST;
+    scene->bounding_coords[ESPA_EAST] = COAST_EAST;
+    scene->bounding_coords[ESPA_NORTH] = COAST_NORTH;
+    scene->bounding_coords[ESPA_SOUTH] = COAST_SOUTH;
+}
+
+
+/******************************************************************************
+MODULE:  remove_bench_scene
+
+PURPOSE: Removes the XML file, band files, and ENVI headers of a synthetic
+product written by create_synthetic_scene.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_bench_scene
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    const char *base_name   /* I: XML filename without the .xml extension */
+)
+{
+    char file_name[STR_SIZE];   /* name of the file removed */
+    Espa_internal_meta_t metadata;  /* metadata of the product */
+    int i;                  /* band index */
+
+    init_metadata_struct (&metadata);
+    if (fill_synthetic_metadata (scene, base_name, &metadata) == SUCCESS)
+    {
+        for (i = 0; i < metadata.nbands; i++)
+        {
+            unlink (metadata.band[i].file_name);
+            snprintf (file_name, sizeof (file_name), "%s_%s.hdr", base_name,
+                metadata.band[i].name);
+            unlink (file_name);
+        }
+    }
+    free_metadata (&metadata);
+
+    snprintf (file_name, sizeof (file_name), "%s.xml", base_name);
+    unlink (file_name);
+}
+
+
+/******************************************************************************
+MODULE:  set_polygon_bounds
+
+PURPOSE: Sets the bounds of a polygon from its vertices and builds its
+segments, in groups of IAS_POLYGON_SEGMENT_SIZE sides, the same as the
+polygons read from a shapefile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the segments
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int set_polygon_bounds
+(
+    IAS_POLYGON_LINKED_LIST *polygon  /* I/O: polygon updated */
+)
+{
+    char FUNC_NAME[] = "set_polygon_bounds";   /* function name */
+    unsigned int num_points = polygon->num_points;  /* number of vertices */
+    unsigned int point;     /* vertex index */
+    unsigned int seg;       /* segment index */
+    IAS_POLYGON_SEGMENT *segment;  /* current segment */
+
+    polygon->num_segs = (num_points - 2) / IAS_POLYGON_SEGMENT_SIZE + 1;
+    polygon->poly_seg = malloc (polygon->num_segs *
+        sizeof (IAS_POLYGON_SEGMENT));
+    if (polygon->poly_seg == NULL)
+    {
+        error_handler (true, FUNC_NAME, "Allocating the polygon segments");
+        return (ERROR);
+    }
+
+    for (seg = 0; seg < polygon->num_segs; seg++)
+    {
+        segment = &polygon->poly_seg[seg];
+        segment->first_point = seg * IAS_POLYGON_SEGMENT_SIZE;
+        segment->last_point = segment->first_point + IAS_POLYGON_SEGMENT_SIZE;
+        if (segment->last_point > num_points - 1)
+            segment->last_point = num_points - 1;
+        segment->min_x = segment->max_x =
+            polygon->point_x[segment->first_point];
+        segment->min_y = segment->max_y =
+            polygon->point_y[segment->first_point];
+        for (point = segment->first_point + 1; point <= segment->last_point;
+            point++)
+        {
+            segment->min_x = fmin (segment->min_x, polygon->point_x[point]);
+            segment->max_x = fmax (segment->max_x, polygon->point_x[point]);
+            segment->min_y = fmin (segment->min_y, polygon->point_y[point]);
+            segment->max_y = fmax (segment->max_y, polygon->point_y[point]);
+        }
+    }
+
+    polygon->min_x = polygon->max_x = polygon->point_x[0];
+    polygon->min_y = polygon->max_y = polygon->point_y[0];
+    for (point = 1; point < num_points; point++)
+    {
+        polygon->min_x = fmin (polygon->min_x, polygon->point_x[point]);
+        polygon->max_x = fmax (polygon->max_x, polygon->point_x[point]);
+        polygon->min_y = fmin (polygon->min_y, polygon->point_y[point]);
+        polygon->max_y = fmax (polygon->max_y, polygon->point_y[point]);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_coastline
+
+PURPOSE: Creates a synthetic coastline: a land mass covering the south of the
+extent, whose northern shore is a wiggly line across the extent, and a grid
+of wiggly islands in the sea to the north.
+
+RETURN VALUE:
+Type = IAS_POLYGON_LINKED_LIST *
+Value           Description
+-----           -----------
+NULL            Error allocating the polygons
+not NULL        First polygon of the list; the land mass
+
+NOTES:
+  1. The polygons are numbered from 1 and are all top-level polygons.  The
+     list is freed with ias_geo_free_polygon_linked_list.
+******************************************************************************/
+static IAS_POLYGON_LINKED_LIST *create_coastline
+(
+    unsigned int *npolygons  /* O: number of polygons */
+)
+{
+    char FUNC_NAME[] = "create_coastline";   /* function name */
+    IAS_POLYGON_LINKED_LIST *head = NULL;    /* first polygon */
+    IAS_POLYGON_LINKED_LIST *tail = NULL;    /* last polygon */
+    IAS_POLYGON_LINKED_LIST *polygon;        /* current polygon */
+    unsigned int id;        /* polygon ID */
+    unsigned int num_points;/* number of vertices, including the closing one */
+    unsigned int point;     /* vertex index */
+    double width = COAST_EAST - COAST_WEST;  /* width of the extent */
+    double height = COAST_NORTH - COAST_SOUTH;  /* height of the extent */
+    double shore_y;         /* mean latitude of the shore */
+    double t;               /* position along the shore or island (0-1) */
+    double radius;          /* radius of the island at the vertex */
+    double center_x;        /* longitude of the center of the island */
+    double center_y;        /* latitude of the center of the island */
+
+    for (id = 1; id <= 1 + ISLAND_GRID * ISLAND_GRID; id++)
+    {
+        polygon = calloc (1, sizeof (IAS_POLYGON_LINKED_LIST));
+        num_points = (id == 1) ? COAST_POINTS + 3 : ISLAND_POINTS + 1;
+        if (polygon != NULL)
+        {
+            polygon->point_x = malloc (num_points * sizeof (double));
+            polygon->point_y = malloc (num_points * sizeof (double));
+        }
+        if (polygon == NULL || polygon->point_x == NULL ||
+            polygon->point_y == NULL)
+        {
+            error_handler (true, FUNC_NAME, "Allocating a polygon");
+            free (polygon);
+            ias_geo_free_polygon_linked_list (head);
+            return (NULL);
+        }
+        polygon->id = id;
+        polygon->num_points = num_points;
+
+        if (id == 1)
+        {
+            /* The shore runs west to east across the middle of the extent
+               and the land mass is closed beyond the south edge */
+            shore_y = COAST_SOUTH + 0.45 * height;
+            for (point = 0; point < COAST_POINTS; point++)
+            {
+                t = (double) point / (COAST_POINTS - 1);
+                polygon->point_x[point] = COAST_WEST - 0.01 + t *
+                    (width + 0.02);
+                polygon->point_y[point] = shore_y + height *
+                    (0.1 * sin (2.0 * M_PI * 3.0 * t) +
+                     0.03 * sin (2.0 * M_PI * 47.0 * t) +
+                     0.01 * sin (2.0 * M_PI * 331.0 * t));
+            }
+            polygon->point_x[COAST_POINTS] = COAST_EAST + 0.01;
+            polygon->point_y[COAST_POINTS] = COAST_SOUTH - 0.01;
+            polygon->point_x[COAST_POINTS + 1] = COAST_WEST - 0.01;
+            polygon->point_y[COAST_POINTS + 1] = COAST_SOUTH - 0.01;
+        }
+        else
+        {
+            /* The islands are on a grid over the northern part, clockwise
+               like the land mass */
+            center_x = COAST_WEST + width *
+                (((id - 2) % ISLAND_GRID) + 0.5) / ISLAND_GRID;
+            center_y = COAST_SOUTH + height * (0.65 + 0.35 *
+                (((id - 2) / ISLAND_GRID) + 0.5) / ISLAND_GRID);
+            for (point = 0; point < ISLAND_POINTS; point++)
+            {
+                t = (double) point / ISLAND_POINTS;
+                radius = 0.3 * height / (2 * ISLAND_GRID) *
+                    (1.0 + 0.3 * sin (2.0 * M_PI * 5.0 * t) +
+                     0.1 * sin (2.0 * M_PI * 37.0 * t));
+                polygon->point_x[point] = center_x + radius *
+                    sin (2.0 * M_PI * t);
+                polygon->point_y[point] = center_y + radius *
+                    cos (2.0 * M_PI * t);
+            }
+        }
+
+        /* Close the polygon */
+        polygon->point_x[num_points - 1] = polygon->point_x[0];
+        polygon->point_y[num_points - 1] = polygon->point_y[0];
+
+        /* Add it to the list before setting the bounds, so it is freed with
+           the list */
+        polygon->prev = tail;
+        if (tail != NULL)
+            tail->next = polygon;
+        else
+            head = polygon;
+        tail = polygon;
+
+        if (set_polygon_bounds (polygon) != SUCCESS)
+        {
+            error_handler (true, FUNC_NAME, "Setting the polygon bounds");
+            ias_geo_free_polygon_linked_list (head);
+            return (NULL);
+        }
+    }
+
+    *npolygons = 1 + ISLAND_GRID * ISLAND_GRID;
+    return (head);
+}
+
+
+/******************************************************************************
+MODULE:  write_coastline
+
+PURPOSE: Writes the synthetic coastline as a polygon file and as a packed
+polygon file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the polygon files
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int write_coastline
+(
+    const IAS_POLYGON_LINKED_LIST *coastline,  /* I: polygons */
+    unsigned int npolygons,    /* I: number of polygons */
+    char *polygon_file,        /* I: name of the polygon file */
+    char *packed_file          /* I: name of the packed polygon file */
+)
+{
+    char FUNC_NAME[] = "write_coastline";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    FILE *fp;               /* polygon file */
+    int status;             /* status of the dump */
+
+    fp = fopen (polygon_file, "wb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening %s", polygon_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    status = ias_geo_dump_polygon (fp, coastline, npolygons, npolygons);
+    if (fclose (fp) != 0 || status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing %s", polygon_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (ias_geo_write_packed_polygon (packed_file, coastline) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing %s", packed_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  run_io_benchmarks
+
+PURPOSE: Runs the write_raw_binary and read_raw_binary benchmarks on an
+INT16 band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int run_io_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    int nlines,             /* I: number of lines in the band */
+    int nsamps              /* I: number of samples in the band */
+)
+{
+    char FUNC_NAME[] = "run_io_benchmarks";   /* function name */
+    char bench_case[STR_SIZE];  /* name of the case */
+    Bench_band_t band;      /* band written and read */
+    size_t npixels = (size_t) nlines * nsamps;  /* pixels in the band */
+    size_t i;               /* pixel index */
+    int status;             /* status of the benchmarks */
+
+    if (!is_selected (options, "write_raw_binary") &&
+        !is_selected (options, "read_raw_binary"))
+        return (SUCCESS);
+
+    band.file_name = "bench_io.img";
+    band.nlines = nlines;
+    band.nsamps = nsamps;
+    band.buf = malloc (npixels * sizeof (int16_t));
+    if (band.buf == NULL)
+    {
+        error_handler (true, FUNC_NAME, "Allocating the band");
+        return (ERROR);
+    }
+    for (i = 0; i < npixels; i++)
+        band.buf[i] = (int16_t) (i % 10007);
+
+    sprintf (bench_case, "int16_%dx%d", nlines, nsamps);
+    status = run_benchmark (options, "write_raw_binary", bench_case,
+        bench_write_band, &band, npixels, npixels * sizeof (int16_t));
+    if (status == SUCCESS)
+    {
+        /* Make sure the band exists if only the reads are run */
+        status = bench_write_band (&band);
+    }
+    if (status == SUCCESS)
+        status = run_benchmark (options, "read_raw_binary", bench_case,
+            bench_read_band, &band, npixels, npixels * sizeof (int16_t));
+
+    unlink (band.file_name);
+    free (band.buf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_metadata_benchmarks
+
+PURPOSE: Runs the write_metadata and parse_metadata benchmarks on XML files
+with 10, 50 and 100 bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int run_metadata_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    int nlines,             /* I: number of lines in the bands */
+    int nsamps              /* I: number of samples in the bands */
+)
+{
+    char bench_case[STR_SIZE];  /* name of the case */
+    char xml_file[STR_SIZE];    /* name of the XML file */
+    Espa_internal_meta_t metadata;  /* metadata written */
+    Synthetic_scene_t synthetic;    /* synthetic product described */
+    Bench_meta_t meta;      /* XML file written and parsed */
+    int i;                  /* case index */
+    int status = SUCCESS;   /* status of the benchmarks */
+
+    if (!is_selected (options, "write_metadata") &&
+        !is_selected (options, "parse_metadata"))
+        return (SUCCESS);
+
+    for (i = 0; i < NMETA_CASES && status == SUCCESS; i++)
+    {
+        init_bench_scene (nlines, nsamps, &synthetic);
+        synthetic.nbands = meta_nbands[i];
+        init_metadata_struct (&metadata);
+        status = fill_synthetic_metadata (&synthetic, "bench_meta", &metadata);
+        if (status != SUCCESS)
+            break;
+
+        sprintf (xml_file, "bench_meta_%d.xml", meta_nbands[i]);
+        sprintf (bench_case, "%d_bands", meta_nbands[i]);
+        meta.xml_file = xml_file;
+        meta.metadata = &metadata;
+        status = run_benchmark (options, "write_metadata", bench_case,
+            bench_write_metadata, &meta, 1, 0);
+        if (status == SUCCESS)
+            status = write_metadata (&metadata, xml_file);
+        if (status == SUCCESS)
+            status = run_benchmark (options, "parse_metadata", bench_case,
+                bench_parse_metadata, &meta, 1, 0);
+
+        unlink (xml_file);
+        free_metadata (&metadata);
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_subset_benchmarks
+
+PURPOSE: Runs the find_band_metadata, subset_metadata_by_band and
+subset_metadata_by_product benchmarks on the metadata of a product with
+NSUBSET_BANDS bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The bands are split into products of NSUBSET_PRODUCT_BANDS bands.
+     Every band is looked up, and every other band or product is kept in
+     the subsets, so an operation is a band of the input metadata.
+******************************************************************************/
+static int run_subset_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    int nlines,             /* I: number of lines in the bands */
+    int nsamps              /* I: number of samples in the bands */
+)
+{
+    char FUNC_NAME[] = "run_subset_benchmarks";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char bench_case[STR_SIZE];  /* name of the case */
+    char (*names)[STR_SIZE];    /* band names or products searched for */
+    Espa_internal_meta_t metadata;  /* metadata searched and subset */
+    Synthetic_scene_t synthetic;    /* synthetic product described */
+    Bench_subset_t subset;  /* metadata and names of the benchmarks */
+    int i;                  /* looping variable for the bands */
+    int nproducts;          /* number of products of the bands */
+    int status;             /* status of the benchmarks */
+
+    if (!is_selected (options, "find_band_metadata") &&
+        !is_selected (options, "subset_metadata_by_band") &&
+        !is_selected (options, "subset_metadata_by_product"))
+        return (SUCCESS);
+
+    names = calloc (NSUBSET_BANDS, sizeof (*names));
+    if (names == NULL)
+    {
+        sprintf (errmsg, "Allocating the band names");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    init_bench_scene (nlines, nsamps, &synthetic);
+    synthetic.nbands = NSUBSET_BANDS;
+    init_metadata_struct (&metadata);
+    status = fill_synthetic_metadata (&synthetic, "bench_subset", &metadata);
+    if (status != SUCCESS)
+    {
+        free (names);
+        return (ERROR);
+    }
+
+    /* Split the bands into products, and index them again since the
+       products changed */
+    for (i = 0; i < metadata.nbands; i++)
+        sprintf (metadata.band[i].product, "product%d",
+            i / NSUBSET_PRODUCT_BANDS);
+    nproducts = (metadata.nbands + NSUBSET_PRODUCT_BANDS - 1)
+        / NSUBSET_PRODUCT_BANDS;
+    status = build_band_index (&metadata);
+
+    sprintf (bench_case, "%d_bands", metadata.nbands);
+    subset.metadata = &metadata;
+    subset.names = names;
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < metadata.nbands; i++)
+            strcpy (names[i], metadata.band[i].name);
+        subset.nnames = metadata.nbands;
+        status = run_benchmark (options, "find_band_metadata", bench_case,
+            bench_find_band_metadata, &subset, metadata.nbands, 0);
+    }
+
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < metadata.nbands; i += 2)
+            strcpy (names[i/2], metadata.band[i].name);
+        subset.nnames = (metadata.nbands + 1) / 2;
+        status = run_benchmark (options, "subset_metadata_by_band",
+            bench_case, bench_subset_metadata_by_band, &subset,
+            metadata.nbands, 0);
+    }
+
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < nproducts; i += 2)
+            sprintf (names[i/2], "product%d", i);
+        subset.nnames = (nproducts + 1) / 2;
+        status = run_benchmark (options, "subset_metadata_by_product",
+            bench_case, bench_subset_metadata_by_product, &subset,
+            metadata.nbands, 0);
+    }
+
+    free_metadata (&metadata);
+    free (names);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_polygon_benchmarks
+
+PURPOSE: Runs the point_in_closed_polygon and shape_mask benchmarks on the
+synthetic coastline.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int run_polygon_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    int nlines,             /* I: number of lines in the masks */
+    int nsamps              /* I: number of samples in the masks */
+)
+{
+    char FUNC_NAME[] = "run_polygon_benchmarks";   /* function name */
+    char bench_case[STR_SIZE];  /* name of the case */
+    char *polygon_file = "bench_coastline.ply";  /* polygon file */
+    char *packed_file = "bench_coastline.pkd";   /* packed polygon file */
+    IAS_POLYGON_LINKED_LIST *coastline;  /* synthetic coastline */
+    unsigned int npolygons; /* number of polygons in the coastline */
+    Bench_points_t points;  /* points tested against the land mass */
+    Bench_mask_t mask;      /* mask created */
+    double npixels = (double) nlines * nsamps;  /* pixels in the mask */
+    int i;                  /* point index */
+    int status = SUCCESS;   /* status of the benchmarks */
+
+    if (!is_selected (options, "point_in_closed_polygon") &&
+        !is_selected (options, "shape_mask"))
+        return (SUCCESS);
+
+    coastline = create_coastline (&npolygons);
+    if (coastline == NULL)
+        return (ERROR);
+
+    /* Test a grid of points covering the land mass and the sea */
+    points.polygon = coastline;
+    points.npoints = POINT_GRID * POINT_GRID;
+    points.point_x = malloc (points.npoints * sizeof (double));
+    points.point_y = malloc (points.npoints * sizeof (double));
+    if (points.point_x == NULL || points.point_y == NULL)
+    {
+        error_handler (true, FUNC_NAME, "Allocating the points");
+        status = ERROR;
+    }
+    for (i = 0; i < points.npoints && status == SUCCESS; i++)
+    {
+        points.point_x[i] = COAST_WEST + (COAST_EAST - COAST_WEST) *
+            ((i % POINT_GRID) + 0.5) / POINT_GRID;
+        points.point_y[i] = COAST_SOUTH + (COAST_NORTH - COAST_SOUTH) *
+            ((i / POINT_GRID) + 0.5) / POINT_GRID;
+    }
+
+    sprintf (bench_case, "%d_sides_segments", COAST_POINTS + 2);
+    points.num_segs = coastline->num_segs;
+    if (status == SUCCESS)
+        status = run_benchmark (options, "point_in_closed_polygon",
+            bench_case, bench_point_in_polygon, &points, points.npoints, 0);
+    sprintf (bench_case, "%d_sides_no_segments", COAST_POINTS + 2);
+    points.num_segs = 0;
+    if (status == SUCCESS)
+        status = run_benchmark (options, "point_in_closed_polygon",
+            bench_case, bench_point_in_polygon, &points, points.npoints, 0);
+    free (points.point_x);
+    free (points.point_y);
+
+    /* Create the masks from both polygon file formats */
+    mask.nlines = nlines;
+    mask.nsamps = nsamps;
+    mask.mask = malloc ((size_t) nlines * nsamps / 8 + 1);
+    if (mask.mask == NULL && status == SUCCESS)
+    {
+        error_handler (true, FUNC_NAME, "Allocating the mask");
+        status = ERROR;
+    }
+    if (status == SUCCESS && is_selected (options, "shape_mask"))
+    {
+        status = write_coastline (coastline, npolygons, polygon_file,
+            packed_file);
+        for (i = 0; i < 4 && status == SUCCESS; i++)
+        {
+            mask.polygon_file = (i / 2) ? packed_file : polygon_file;
+            mask.scanline = i % 2;
+            sprintf (bench_case, "coastline_%s_%s_%dx%d",
+                (i / 2) ? "packed" : "ply", (i % 2) ? "scanline" : "point",
+                nlines, nsamps);
+            status = run_benchmark (options, "shape_mask", bench_case,
+                bench_shape_mask, &mask, npixels, 0);
+        }
+        unlink (polygon_file);
+        unlink (packed_file);
+    }
+
+    free (mask.mask);
+    ias_geo_free_polygon_linked_list (coastline);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_scene_benchmarks
+
+PURPOSE: Runs the bip_interleave and clip_band_misalignment benchmarks on a
+synthetic ETM+ scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The BIP file is written from the UINT8 bands of the scene, since all
+     its bands must be of the same data type.
+******************************************************************************/
+static int run_scene_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    int nlines,             /* I: number of lines in the bands */
+    int nsamps              /* I: number of samples in the bands */
+)
+{
+    char bench_case[STR_SIZE];  /* name of the case */
+    Synthetic_scene_t synthetic;    /* synthetic ETM+ scene */
+    Bench_scene_t scene;    /* scene interleaved and clipped */
+    double npixels = (double) nlines * nsamps;  /* pixels in each band */
+    int status;             /* status of the benchmarks */
+
+    if (!is_selected (options, "bip_interleave") &&
+        !is_selected (options, "clip_band_misalignment"))
+        return (SUCCESS);
+
+    /* ETM+ scene with a footprint whose edges are misaligned between the
+       bands */
+    init_bench_scene (nlines, nsamps, &synthetic);
+    strcpy (synthetic.satellite, "LANDSAT_7");
+    strcpy (synthetic.instrument, "ETM");
+    synthetic.nbands = NSCENE_BANDS;
+    synthetic.band_names = scene_bands;
+    synthetic.data_type = ESPA_UINT8;
+    synthetic.misalign = 5;
+
+    /* Write the UINT8 bands without the quality band for the BIP file */
+    scene.xml_file = "bench_bip.xml";
+    scene.bip_file = "bench_scene.bip";
+    status = create_synthetic_scene (&synthetic, scene.xml_file);
+    sprintf (bench_case, "%d_uint8_bands_%dx%d", NSCENE_BANDS, nlines,
+        nsamps);
+    if (status == SUCCESS)
+        status = run_benchmark (options, "bip_interleave", bench_case,
+            bench_bip, &scene, npixels * NSCENE_BANDS,
+            npixels * NSCENE_BANDS);
+    unlink (scene.bip_file);
+    unlink ("bench_scene.hdr");
+    unlink ("bench_scene_bip.xml");
+    remove_bench_scene (&synthetic, "bench_bip");
+
+    /* Add the UINT16 quality band for the clipping */
+    synthetic.qa_band = true;
+    scene.xml_file = "bench_clip.xml";
+    if (status == SUCCESS)
+        status = create_synthetic_scene (&synthetic, scene.xml_file);
+    sprintf (bench_case, "etm_%dx%d", nlines, nsamps);
+    if (status == SUCCESS)
+        status = run_benchmark (options, "clip_band_misalignment",
+            bench_case, bench_clip, &scene, npixels,
+            npixels * (NSCENE_BANDS + 2));
+    remove_bench_scene (&synthetic, "bench_clip");
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_large_band_check
+
+PURPOSE: Writes a band of large_size x large_size pixels with the synthetic
+scene generator, and runs the large_band benchmark on it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing or reading the band
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The band is checked to have been written to its full size before it's
+     read.
+******************************************************************************/
+static int run_large_band_check
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    int large_size          /* I: number of lines and samples of the band;
+                                  0 to skip the check */
+)
+{
+    char FUNC_NAME[] = "run_large_band_check";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char bench_case[STR_SIZE];  /* name of the case */
+    char *xml_file = "bench_large.xml";  /* XML file of the band */
+    Synthetic_scene_t synthetic;    /* synthetic product of the band */
+    Espa_internal_meta_t metadata;  /* metadata of the band */
+    Bench_large_t large;    /* band read */
+    off_t band_size;        /* number of bytes in the band */
+    struct stat statbuf;    /* status of the band file */
+    int status;             /* status of the check */
+
+    if (!is_selected (options, "large_band"))
+        return (SUCCESS);
+    if (large_size == 0)
+    {
+        report_skipped (options, "large_band", "no large_size given");
+        return (SUCCESS);
+    }
+
+    init_bench_scene (large_size, large_size, &synthetic);
+    synthetic.nbands = 1;
+    synthetic.data_type = ESPA_UINT8;
+    band_size = (off_t) large_size * large_size;
+
+    init_metadata_struct (&metadata);
+    large.buf = malloc ((size_t) LARGE_BLOCK_LINES * large_size);
+    large.corner = malloc (LARGE_CORNER);
+    status = (large.buf != NULL && large.corner != NULL) ? SUCCESS : ERROR;
+    if (status != SUCCESS)
+        error_handler (true, FUNC_NAME, "Allocating the band buffers");
+
+    /* Write the band, and make sure it has all its pixels */
+    if (status == SUCCESS)
+        status = create_synthetic_scene (&synthetic, xml_file);
+    if (status == SUCCESS)
+        status = parse_metadata (xml_file, &metadata);
+    if (status == SUCCESS)
+    {
+        large.bmeta = &metadata.band[0];
+        if (stat (large.bmeta->file_name, &statbuf) != 0 ||
+            statbuf.st_size != band_size)
+        {
+            sprintf (errmsg, "Band file %s isn't %lld bytes",
+                large.bmeta->file_name, (long long) band_size);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    sprintf (bench_case, "uint8_%dx%d", large_size, large_size);
+    if (status == SUCCESS)
+        status = run_benchmark (options, "large_band", bench_case,
+            bench_large_band, &large, (double) band_size,
+            (double) band_size);
+
+    remove_bench_scene (&synthetic, "bench_large");
+    free_metadata (&metadata);
+    free (large.buf);
+    free (large.corner);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Runs the benchmarks and writes their results.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmp_dir[] = "/tmp/espa_bench.XXXXXX";  /* temporary directory */
+    char *filter = NULL;         /* benchmark filter */
+    char *ang_file = NULL;       /* name of the ANG file */
+    char *workdir = NULL;        /* working directory */
+    char *output_file = NULL;    /* name of the results file */
+    char *ang_path = NULL;       /* ANG file relative to the working dir */
+    bool remove_workdir = false; /* was the working directory created? */
+    int nlines = 2048;           /* number of lines in the synthetic data */
+    int nsamps = 2048;           /* number of samples in the synthetic data */
+    int large_size = 0;          /* size of the large band; 0 to skip it */
+    int results_fd;              /* descriptor the results are written to */
+    int status;                  /* status of the benchmarks */
+    Bench_options_t options;     /* options of the benchmarks */
+
+    options.min_seconds = 1.0;
+    if (get_args (argc, argv, &nlines, &nsamps, &options.min_seconds,
+        &filter, &ang_file, &workdir, &output_file, &large_size) != SUCCESS)
+        exit (EXIT_FAILURE);
+    options.filter = filter;
+
+    /* Open the results file, or keep the standard output for the results
+       and move the messages of the libraries to the standard error */
+    if (output_file != NULL)
+        options.out = fopen (output_file, "a");
+    else
+    {
+        fflush (stdout);
+        results_fd = dup (STDOUT_FILENO);
+        options.out = (results_fd < 0) ? NULL : fdopen (results_fd, "w");
+        if (options.out != NULL)
+            dup2 (STDERR_FILENO, STDOUT_FILENO);
+    }
+    if (options.out == NULL)
+    {
+        sprintf (errmsg, "Opening the results file %s",
+            output_file ? output_file : "(standard output)");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* The ANG file is read after changing to the working directory */
+    if (ang_file != NULL)
+        ang_path = realpath (ang_file, NULL);
+    if (ang_file != NULL && ang_path == NULL)
+    {
+        sprintf (errmsg, "Finding the ANG file %s", ang_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the synthetic files to the working directory, since the band
+       files are named relative to the XML files */
+    if (workdir == NULL)
+    {
+        workdir = mkdtemp (tmp_dir);
+        remove_workdir = (workdir != NULL);
+    }
+    if (workdir == NULL || chdir (workdir) != 0)
+    {
+        sprintf (errmsg, "Changing to the working directory %s",
+            workdir ? workdir : tmp_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    status = run_io_benchmarks (&options, nlines, nsamps);
+    if (status == SUCCESS)
+        status = run_metadata_benchmarks (&options, nlines, nsamps);
+    if (status == SUCCESS)
+        status = run_subset_benchmarks (&options, nlines, nsamps);
+    if (status == SUCCESS)
+        status = run_polygon_benchmarks (&options, nlines, nsamps);
+    if (status == SUCCESS)
+        status = run_angle_benchmarks (&options, ang_path);
+    if (status == SUCCESS)
+        status = run_scene_benchmarks (&options, nlines, nsamps);
+    if (status == SUCCESS)
+        status = run_large_band_check (&options, large_size);
+
+    if (remove_workdir && (chdir ("/") != 0 || rmdir (workdir) != 0))
+    {
+        sprintf (errmsg, "Removing the working directory %s", workdir);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    fclose (options.out);
+    cleanup_espa_xml ();
+    free (filter);
+    free (ang_file);
+    free (ang_path);
+    free (output_file);
+    if (!remove_workdir)
+        free (workdir);
+
+    if (status != SUCCESS)
+    {
+        error_handler (true, FUNC_NAME, "Running the benchmarks");
+        exit (EXIT_FAILURE);
+    }
+
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+FILE: espa_bench.h
+
+PURPOSE: Contains defines, structures and prototypes for running the
+benchmarks of the raw binary libraries and reporting their results.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The angle benchmark is in its own file, since the IAS angle headers
+     and the land/water mask headers both define IAS_PROJECTION.
+*****************************************************************************/
+
+#ifndef ESPA_BENCH_H_
+#define ESPA_BENCH_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "espa_common.h"
+#include "error_handler.h"
+
+/* Operation timed by a benchmark; returns SUCCESS or ERROR */
+typedef int (*Bench_func_t) (void *arg);
+
+/* Options of the benchmarks */
+typedef struct
+{
+    double min_seconds;     /* minimum time each benchmark is run for */
+    char *filter;           /* only benchmarks whose name contains this are
+                               run; NULL to run all */
+    FILE *out;              /* file the results are written to */
+} Bench_options_t;
+
+/* Prototypes */
+bool is_selected
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    const char *benchmark            /* I: name of the benchmark */
+);
+
+int run_benchmark
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    const char *benchmark,  /* I: name of the benchmark */
+    const char *bench_case, /* I: name of the case of the benchmark */
+    Bench_func_t func,      /* I: operation timed */
+    void *arg,              /* I: passed to func */
+    double ops,             /* I: number of operations in each call of func */
+    double nbytes           /* I: number of bytes read or written in each
+                                  call of func; 0 if not an I/O benchmark */
+);
+
+void report_skipped
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    const char *benchmark,  /* I: name of the benchmark */
+    const char *reason      /* I: why it was skipped */
+);
+
+int run_angle_benchmarks
+(
+    const Bench_options_t *options,  /* I: options of the benchmarks */
+    char *ang_file          /* I: name of the ANG file; NULL if not given */
+);
+
+#endif
@@ -0,0 +1,1969 @@
+/*****************************************************************************
+FILE: espa_regress
+
+PURPOSE: Runs the tools on real or synthetic scenes once in the legacy
+(serial, scalar) mode and once in the optimized mode, compares the products
+band by band and the XML files of the two modes, and checks the time of each
+stage in the optimized mode against a stored baseline.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The stages are convert_lpgs_to_espa, clip_band_misalignment,
+     create_angle_bands, create_land_water_mask, create_toa_bands and
+     create_date_bands, run in that order on a copy of each scene for each
+     mode.  A scene is an MTL file or an ESPA XML file, as for
+     espa_scene_bench; the conversion is only run for the MTL scenes and the
+     angle bands only for the scenes with an _ANG.txt file.
+  2. The modes differ only in the environment of the tools.  The legacy mode
+     runs with one task pool thread, the scalar paths of the SIMD kernels,
+     the thread backend of the asynchronous I/O and double precision angles;
+     the optimized mode runs with --threads task pool threads and single
+     precision angles.  --legacy_env and --optimized_env add to or override
+     these, e.g. to compare the offloaded angles or a band codec.
+  3. The bands are read back through the raw binary I/O library, so encoded,
+     chunked and tiled bands are compared by their pixels rather than their
+     files.  A band matches if every pixel is within the tolerance of the
+     first --tolerance rule matching its name, or of the default rules for
+     the angle bands (one hundredth of a degree, with the azimuths wrapping
+     at 360 degrees), and is otherwise compared exactly.  NaNs match NaNs.
+  4. The XML files match if they are the same apart from the production
+     dates and provenance keys of the bands, which change with every run.
+  5. A stage whose exit status differs between the modes is a mismatch.  A
+     stage failing in both modes is reported, and the later stages are still
+     run so their outputs are compared as far as they get.
+  6. Each scene is written as a JSON line with its stage times and the bands
+     which differ, followed by a summary line with the legacy and optimized
+     time of each stage.  With --baseline, a stage whose optimized time is
+     more than --max_slowdown slower than in the summary line of the baseline
+     file is a regression; --save_baseline writes the summary line as a new
+     baseline.  The exit status is nonzero on any mismatch or regression.
+*****************************************************************************/
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "espa_common.h"
+#include "error_handler.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+#include "synthetic_scene.h"
+
+/* Defines */
+/* Largest number of --tolerance rules */
+#define REGRESS_MAX_RULES 32
+
+/* Largest number of environment settings of a mode */
+#define REGRESS_MAX_ENV 32
+
+/* Largest number of differing bands reported for a scene */
+#define REGRESS_MAX_DIFFS 64
+
+/* Size of the buffer files are copied with */
+#define REGRESS_COPY_SIZE (1024 * 1024)
+
+/* Number of pixels of a band compared at a time */
+#define REGRESS_BLOCK_PIXELS (1024 * 1024)
+
+/* Modes the tools are run in */
+typedef enum
+{
+    MODE_LEGACY,            /* serial, scalar paths */
+    MODE_OPTIMIZED,         /* parallel, SIMD and single precision paths */
+    NUM_MODES
+} Mode_t;
+
+/* Names of the modes in the directories and results */
+static const char *mode_names[NUM_MODES] = {"legacy", "optimized"};
+
+/* Stages run on each scene, in order */
+typedef enum
+{
+    STAGE_LPGS,             /* convert_lpgs_to_espa */
+    STAGE_CLIP,             /* clip_band_misalignment */
+    STAGE_ANGLES,           /* create_angle_bands */
+    STAGE_LAND_WATER_MASK,  /* create_land_water_mask */
+    STAGE_TOA,              /* create_toa_bands */
+    STAGE_DATE_BANDS,       /* create_date_bands */
+    NUM_STAGES
+} Stage_t;
+
+/* Names of the stages in --stages and in the results */
+static const char *stage_names[NUM_STAGES] =
+{
+    "lpgs", "clip", "angles", "land_water_mask", "toa", "date_bands"
+};
+
+/* Tools run by the stages */
+static const char *stage_tools[NUM_STAGES] =
+{
+    "convert_lpgs_to_espa", "clip_band_misalignment", "create_angle_bands",
+    "create_land_water_mask", "create_toa_bands", "create_date_bands"
+};
+
+/* Default environment of the legacy mode */
+static const char *legacy_env[] =
+{
+    "ESPA_TASK_THREADS=1", "ESPA_CONVERT_ISA=scalar",
+    "ESPA_SHAPE_MASK_ISA=scalar", "ESPA_POLYGON_ISA=scalar",
+    "ESPA_FILL_MASK_ISA=scalar", "ESPA_CHECKSUM_ISA=scalar",
+    "ESPA_ASYNC_IO=threads", "ESPA_ANGLE_PRECISION=double",
+    "ESPA_ANGLE_DEVICE=cpu", NULL
+};
+
+/* Default environment of the optimized mode; ESPA_TASK_THREADS follows
+   --threads */
+static const char *optimized_env[] =
+{
+    "ESPA_ANGLE_PRECISION=single", NULL
+};
+
+/* Tolerance of the bands whose names match a pattern */
+typedef struct
+{
+    char pattern[STR_SIZE]; /* fnmatch pattern of the band names */
+    double tolerance;       /* largest difference of a pixel */
+    double wrap;            /* period the values wrap at (e.g. 36000 for
+                               azimuths in hundredths of a degree); 0 if
+                               they don't wrap */
+} Tolerance_rule_t;
+
+/* Default tolerances of the angle bands, after the --tolerance rules */
+static const Tolerance_rule_t default_rules[] =
+{
+    {"*azimuth*", 1.0, 36000.0},
+    {"*zenith*", 1.0, 0.0}
+};
+
+/* Options of the harness */
+typedef struct
+{
+    char *scene_list;       /* file listing the scenes; NULL if synthetic */
+    int nsynthetic;         /* number of synthetic scenes */
+    int nlines;             /* number of lines in the synthetic scenes */
+    int nsamps;             /* number of samples in the synthetic scenes */
+    int threads;            /* threads of the optimized mode */
+    bool stages[NUM_STAGES];/* stages selected */
+    char *env[NUM_MODES][REGRESS_MAX_ENV];  /* --legacy_env and
+                               --optimized_env settings */
+    int nenv[NUM_MODES];    /* number of settings of each mode */
+    Tolerance_rule_t rules[REGRESS_MAX_RULES];  /* --tolerance rules */
+    int nrules;             /* number of --tolerance rules */
+    char *baseline;         /* baseline the times are checked against */
+    char *save_baseline;    /* file the summary is written to as a baseline */
+    double max_slowdown;    /* largest slowdown against the baseline */
+    char *bindir;           /* directory of the tools; NULL to use PATH */
+    char *workdir;          /* directory of the runs */
+    bool keep;              /* keep the directories of the runs? */
+    FILE *out;              /* file the results are written to */
+} Regress_options_t;
+
+/* Scene processed by the stages */
+typedef struct
+{
+    char src_dir[PATH_MAX]; /* directory of the scene's files */
+    char prefix[STR_SIZE];  /* scene name the files start with */
+    bool is_mtl;            /* do the stages start from the MTL file? */
+    bool has_ang;           /* does the scene have an ANG file? */
+} Scene_t;
+
+/* Totals of a stage over the scenes */
+typedef struct
+{
+    int runs;               /* number of scenes the stage was run on */
+    int mismatches;         /* number of runs whose status differed */
+    double seconds[NUM_MODES];  /* total wall time of each mode */
+} Stage_totals_t;
+
+/* Difference of a band between the modes */
+typedef struct
+{
+    char name[STR_SIZE];    /* name of the band */
+    char reason[STR_SIZE];  /* why the band differs, if not by its pixels */
+    long long npixels;      /* number of pixels outside the tolerance */
+    double max_diff;        /* largest difference of a pixel */
+} Band_diff_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_regress runs the tools on real or synthetic scenes in the "
+            "legacy (serial, scalar) and the optimized mode, compares the "
+            "bands and XML files of the two modes, and checks the optimized "
+            "time of each stage against a baseline, writing the results as "
+            "JSON lines.\n\n");
+    printf ("usage: espa_regress --scene_list=scene_list_filename | "
+            "--synthetic=nscenes [--nlines=lines] [--nsamps=samples] "
+            "[--threads=nthreads] [--stages=stage1,stage2,...] "
+            "[--legacy_env=VAR=value] [--optimized_env=VAR=value] "
+            "[--tolerance=pattern[:tolerance[:wrap]]] "
+            "[--baseline=baseline_filename] "
+            "[--save_baseline=baseline_filename] [--max_slowdown=fraction] "
+            "[--bindir=directory] [--workdir=directory] [--keep] "
+            "[--output=results_filename]\n");
+
+    printf ("\nwhere one of the following parameters is required:\n");
+    printf ("    -scene_list: name of a file listing the MTL or ESPA XML "
+            "files of the scenes, one per line\n");
+    printf ("    -synthetic: number of synthetic ETM+ scenes to generate "
+            "and process\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -nlines, -nsamps: size of the synthetic scenes (default "
+            "is 2000 x 2000)\n");
+    printf ("    -threads: task pool threads of the optimized mode (default "
+            "is the number of CPUs)\n");
+    printf ("    -stages: stages run, of lpgs, clip, angles, "
+            "land_water_mask, toa and date_bands (default is all)\n");
+    printf ("    -legacy_env, -optimized_env: environment variable set for "
+            "the tools of the mode, added to the defaults; VAR without a "
+            "value unsets it (may be repeated)\n");
+    printf ("    -tolerance: largest difference of the pixels of the bands "
+            "whose names match the pattern, with the period the values "
+            "wrap at, if any (default is 0; may be repeated)\n");
+    printf ("    -baseline: results file whose last summary line gives the "
+            "baseline optimized times\n");
+    printf ("    -save_baseline: file the summary line is written to as a "
+            "new baseline\n");
+    printf ("    -max_slowdown: largest slowdown of a stage against the "
+            "baseline, as a fraction (default is 0.10)\n");
+    printf ("    -bindir: directory of the tools (default is the PATH)\n");
+    printf ("    -workdir: existing directory the runs are done in (default "
+            "is a new temporary directory)\n");
+    printf ("    -keep: keep the products and logs of the runs\n");
+    printf ("    -output: file the results are appended to (default is the "
+            "standard output)\n");
+    printf ("\nExample: espa_regress --scene_list=scenes.txt "
+            "--tolerance='*toa*:1' --baseline=regress.json\n");
+}
+
+
+/******************************************************************************
+MODULE:  parse_stages
+
+PURPOSE:  Parses the comma-separated names of the stages run.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown stage
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int parse_stages
+(
+    const char *value,      /* I: value of --stages */
+    Regress_options_t *options  /* I/O: options of the harness */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "parse_stages";   /* function name */
+    char names[STR_SIZE];            /* copy of the value */
+    char *name;                      /* current stage name */
+    char *saveptr = NULL;            /* state of strtok_r */
+    int stage;                       /* stage index */
+
+    snprintf (names, sizeof (names), "%s", value);
+    for (stage = 0; stage < NUM_STAGES; stage++)
+        options->stages[stage] = false;
+
+    for (name = strtok_r (names, ",", &saveptr); name != NULL;
+        name = strtok_r (NULL, ",", &saveptr))
+    {
+        for (stage = 0; stage < NUM_STAGES; stage++)
+            if (!strcmp (name, stage_names[stage]))
+                break;
+        if (stage == NUM_STAGES)
+        {
+            sprintf (errmsg, "Unknown stage %s", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        options->stages[stage] = true;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_tolerance
+
+PURPOSE:  Parses a --tolerance rule of the form pattern[:tolerance[:wrap]].
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Invalid rule, or too many rules
+SUCCESS         No errors encountered
+
+NOTES:
+  1. A rule without a tolerance requires the matching bands to be exact,
+     which overrides the default rules of the angle bands.
+******************************************************************************/
+static int parse_tolerance
+(
+    const char *value,      /* I: value of --tolerance */
+    Regress_options_t *options  /* I/O: options of the harness */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "parse_tolerance";   /* function name */
+    char *cptr;                      /* separator of the tolerance */
+    char *end;                       /* end of a number */
+    Tolerance_rule_t *rule;          /* rule parsed */
+
+    if (options->nrules == REGRESS_MAX_RULES)
+    {
+        sprintf (errmsg, "At most %d tolerance rules", REGRESS_MAX_RULES);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    rule = &options->rules[options->nrules];
+    snprintf (rule->pattern, sizeof (rule->pattern), "%s", value);
+    rule->tolerance = 0.0;
+    rule->wrap = 0.0;
+
+    cptr = strchr (rule->pattern, ':');
+    if (cptr != NULL)
+    {
+        *cptr = '\0';
+        rule->tolerance = strtod (cptr + 1, &end);
+        if (*end == ':')
+            rule->wrap = strtod (end + 1, &end);
+        if (end == cptr + 1 || *end != '\0' || rule->tolerance < 0.0 ||
+            rule->wrap < 0.0)
+        {
+            sprintf (errmsg, "Invalid tolerance rule %s", value);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    options->nrules++;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input strings.  It is up to the caller to
+     free them.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    Regress_options_t *options,  /* O: options of the harness */
+    char **output_file    /* O: address of the results filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int mode;                        /* mode of an environment setting */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int keep_flag = 0;        /* flag to indicate if the runs should
+                                        be kept */
+    static struct option long_options[] =
+    {
+        {"keep", no_argument, &keep_flag, 1},
+        {"scene_list", required_argument, 0, 'L'},
+        {"synthetic", required_argument, 0, 'n'},
+        {"nlines", required_argument, 0, 'l'},
+        {"nsamps", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 't'},
+        {"stages", required_argument, 0, 'S'},
+        {"legacy_env", required_argument, 0, 'e'},
+        {"optimized_env", required_argument, 0, 'E'},
+        {"tolerance", required_argument, 0, 'T'},
+        {"baseline", required_argument, 0, 'B'},
+        {"save_baseline", required_argument, 0, 'W'},
+        {"max_slowdown", required_argument, 0, 'x'},
+        {"bindir", required_argument, 0, 'b'},
+        {"workdir", required_argument, 0, 'w'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'L':  /* scene list */
+                options->scene_list = strdup (optarg);
+                break;
+
+            case 'n':  /* number of synthetic scenes */
+                options->nsynthetic = atoi (optarg);
+                break;
+
+            case 'l':  /* number of lines */
+                options->nlines = atoi (optarg);
+                break;
+
+            case 's':  /* number of samples */
+                options->nsamps = atoi (optarg);
+                break;
+
+            case 't':  /* threads of the optimized mode */
+                options->threads = atoi (optarg);
+                break;
+
+            case 'S':  /* stages */
+                if (parse_stages (optarg, options) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'e':  /* environment of the legacy mode */
+            case 'E':  /* environment of the optimized mode */
+                mode = (c == 'e') ? MODE_LEGACY : MODE_OPTIMIZED;
+                if (options->nenv[mode] == REGRESS_MAX_ENV)
+                {
+                    sprintf (errmsg, "At most %d environment settings per "
+                        "mode", REGRESS_MAX_ENV);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                options->env[mode][options->nenv[mode]++] = strdup (optarg);
+                break;
+
+            case 'T':  /* tolerance rule */
+                if (parse_tolerance (optarg, options) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'B':  /* baseline */
+                options->baseline = strdup (optarg);
+                break;
+
+            case 'W':  /* new baseline */
+                options->save_baseline = strdup (optarg);
+                break;
+
+            case 'x':  /* largest slowdown */
+                options->max_slowdown = atof (optarg);
+                break;
+
+            case 'b':  /* directory of the tools */
+                options->bindir = strdup (optarg);
+                break;
+
+            case 'w':  /* working directory */
+                options->workdir = strdup (optarg);
+                break;
+
+            case 'o':  /* results filename */
+                *output_file = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the scene list or the synthetic scenes were
+       specified */
+    if ((options->scene_list == NULL) == (options->nsynthetic == 0))
+    {
+        sprintf (errmsg, "Either the scene list or the number of synthetic "
+            "scenes is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the numbers are valid */
+    if (options->nsynthetic < 0 || options->threads < 1 ||
+        options->max_slowdown < 0.0)
+    {
+        sprintf (errmsg, "Number of synthetic scenes, threads and largest "
+            "slowdown must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the flags */
+    if (keep_flag)
+        options->keep = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_seconds
+
+PURPOSE: Returns the time of the monotonic clock in seconds.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+seconds         Time of the monotonic clock
+
+NOTES:
+******************************************************************************/
+static double elapsed_seconds (void)
+{
+    struct timespec now;         /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec + now.tv_nsec * 1e-9);
+}
+
+
+/******************************************************************************
+MODULE:  add_scene
+
+PURPOSE: Adds an MTL or XML file to the scenes processed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finding the file or allocating the scenes
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int add_scene
+(
+    const char *file_name,  /* I: name of the MTL or XML file */
+    Scene_t **scenes,       /* I/O: scenes processed */
+    int *nscenes            /* I/O: number of scenes */
+)
+{
+    char FUNC_NAME[] = "add_scene";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char path[PATH_MAX];    /* absolute name of the file */
+    char ang_file[PATH_MAX];/* name of the ANG file */
+    char *cptr;             /* pointer into the filename */
+    Scene_t *scene;         /* scene added */
+    Scene_t *new_scenes;    /* reallocated scenes */
+
+    if (realpath (file_name, path) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Finding the scene %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    new_scenes = realloc (*scenes, (*nscenes + 1) * sizeof (Scene_t));
+    if (new_scenes == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Allocating the scene %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    *scenes = new_scenes;
+    scene = &new_scenes[*nscenes];
+
+    /* Split the file into its directory and the scene prefix */
+    cptr = strrchr (path, '/');
+    *cptr = '\0';
+    snprintf (scene->src_dir, sizeof (scene->src_dir), "%s", path);
+    snprintf (scene->prefix, sizeof (scene->prefix), "%s", cptr + 1);
+    cptr = strstr (scene->prefix, "_MTL.txt");
+    scene->is_mtl = (cptr != NULL && cptr[8] == '\0');
+    if (scene->is_mtl)
+        *cptr = '\0';
+    else
+    {
+        cptr = strrchr (scene->prefix, '.');
+        if (cptr == NULL || strcmp (cptr, ".xml"))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Scene %s is neither an "
+                "_MTL.txt nor an .xml file", file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        *cptr = '\0';
+    }
+
+    snprintf (ang_file, sizeof (ang_file), "%s/%s_ANG.txt", scene->src_dir,
+        scene->prefix);
+    scene->has_ang = (access (ang_file, R_OK) == 0);
+
+    (*nscenes)++;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_scene_list
+
+PURPOSE: Reads the MTL or XML files of the scenes from the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the scene list
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped, and anything after
+     the first word of a line is ignored, as in the scene lists of the tools.
+******************************************************************************/
+static int read_scene_list
+(
+    const char *scene_list, /* I: name of the scene list */
+    Scene_t **scenes,       /* O: scenes processed */
+    int *nscenes            /* O: number of scenes */
+)
+{
+    char FUNC_NAME[] = "read_scene_list";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char line[PATH_MAX];    /* line of the scene list */
+    char file_name[PATH_MAX];  /* first word of the line */
+    FILE *fp;               /* scene list */
+
+    fp = fopen (scene_list, "r");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the scene list %s",
+            scene_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if (sscanf (line, "%s", file_name) != 1 || file_name[0] == '#')
+            continue;
+        if (add_scene (file_name, scenes, nscenes) != SUCCESS)
+        {
+            fclose (fp);
+            return (ERROR);
+        }
+    }
+    fclose (fp);
+
+    if (*nscenes == 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "No scenes in the scene list %s",
+            scene_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_synthetic_scenes
+
+PURPOSE: Writes the synthetic ETM+ scenes to the source directory and adds
+them to the scenes processed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the scenes
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The scenes are the same as those of espa_scene_bench, with their
+     footprint edges misaligned between the bands.
+******************************************************************************/
+static int create_synthetic_scenes
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const char *src_dir,    /* I: directory the scenes are written to */
+    Scene_t **scenes,       /* O: scenes processed */
+    int *nscenes            /* O: number of scenes */
+)
+{
+    char FUNC_NAME[] = "create_synthetic_scenes";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char xml_file[PATH_MAX];/* XML file of the current scene */
+    static const char *etm_bands[] = {"band1", "band2", "band3", "band4",
+        "band5", "band61", "band62", "band7"};  /* ETM+ band layout */
+    Synthetic_scene_t synthetic;   /* description of the scene */
+    int i;                  /* scene index */
+
+    init_synthetic_scene (&synthetic);
+    strcpy (synthetic.satellite, "LANDSAT_7");
+    strcpy (synthetic.instrument, "ETM");
+    synthetic.nbands = 8;
+    synthetic.band_names = etm_bands;
+    synthetic.qa_band = true;
+    synthetic.data_type = ESPA_UINT8;
+    synthetic.misalign = 5;
+    synthetic.nlines = options->nlines;
+    synthetic.nsamps = options->nsamps;
+
+    for (i = 0; i < options->nsynthetic; i++)
+    {
+        synthetic.seed = i + 1;
+        snprintf (xml_file, sizeof (xml_file), "%s/synthetic_%04d.xml",
+            src_dir, i + 1);
+        if (create_synthetic_scene (&synthetic, xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Creating synthetic scene %d", i + 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (add_scene (xml_file, scenes, nscenes) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  copy_file
+
+PURPOSE: Copies a file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the file
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int copy_file
+(
+    const char *src_file,   /* I: file copied */
+    const char *dest_file,  /* I: copy written */
+    char *buf               /* I: buffer of REGRESS_COPY_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "copy_file";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int src_fd;             /* file copied */
+    int dest_fd;            /* copy written */
+    ssize_t nread;          /* bytes read */
+    int status = SUCCESS;   /* status of the copy */
+
+    src_fd = open (src_file, O_RDONLY);
+    dest_fd = open (dest_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (src_fd < 0 || dest_fd < 0)
+        status = ERROR;
+
+    while (status == SUCCESS &&
+        (nread = read (src_fd, buf, REGRESS_COPY_SIZE)) != 0)
+    {
+        if (nread < 0 || write (dest_fd, buf, nread) != nread)
+            status = ERROR;
+    }
+
+    if (src_fd >= 0)
+        close (src_fd);
+    if (dest_fd >= 0 && close (dest_fd) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Copying %s to %s: %s", src_file,
+            dest_file, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  prepare_scene
+
+PURPOSE: Copies the files of a scene (prefix.* and prefix_*) to its
+directory of a mode.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the scene
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int prepare_scene
+(
+    const Scene_t *scene,   /* I: scene copied */
+    const char *dir_name,   /* I: directory of the scene in the mode */
+    char *buf               /* I: buffer of REGRESS_COPY_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "prepare_scene";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char src_file[PATH_MAX];/* file copied */
+    char dest_file[PATH_MAX];  /* copy written */
+    size_t len = strlen (scene->prefix);  /* length of the prefix */
+    DIR *dir;               /* source directory of the scene */
+    struct dirent *entry;   /* current directory entry */
+    struct stat stat_buf;   /* status of the current file */
+    int status = SUCCESS;   /* status of the copies */
+
+    if (mkdir (dir_name, 0755) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the directory %s",
+            dir_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    dir = opendir (scene->src_dir);
+    if (dir == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the directory %s",
+            scene->src_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (entry = readdir (dir)) != NULL)
+    {
+        if (strncmp (entry->d_name, scene->prefix, len) ||
+            (entry->d_name[len] != '.' && entry->d_name[len] != '_'))
+            continue;
+        snprintf (src_file, sizeof (src_file), "%s/%s", scene->src_dir,
+            entry->d_name);
+        if (stat (src_file, &stat_buf) != 0 || !S_ISREG (stat_buf.st_mode))
+            continue;
+        snprintf (dest_file, sizeof (dest_file), "%s/%s", dir_name,
+            entry->d_name);
+        status = copy_file (src_file, dest_file, buf);
+    }
+    closedir (dir);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  remove_tree_entry
+
+PURPOSE: Removes an entry of a directory tree; called by nftw.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               Continue the walk
+
+NOTES:
+******************************************************************************/
+static int remove_tree_entry
+(
+    const char *path,       /* I: name of the entry */
+    const struct stat *stat_buf,  /* I: not used */
+    int type,               /* I: not used */
+    struct FTW *ftw_buf     /* I: not used */
+)
+{
+    remove (path);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  stage_applies
+
+PURPOSE: Determines whether a stage is run on a scene.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The stage is run on the scene
+false           The stage is skipped
+
+NOTES:
+******************************************************************************/
+static bool stage_applies
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene processed */
+    int stage               /* I: stage index */
+)
+{
+    if (!options->stages[stage])
+        return (false);
+    if (stage == STAGE_LPGS)
+        return (scene->is_mtl);
+    if (stage == STAGE_ANGLES)
+        return (scene->has_ang);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  set_mode_env
+
+PURPOSE: Sets the environment of the tools of a mode; called in the child
+process of a stage.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The defaults of the mode are set first, so the --legacy_env and
+     --optimized_env settings override them.  A setting without a value
+     unsets the variable.
+******************************************************************************/
+static void set_mode_env
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    int mode                /* I: mode of the tools */
+)
+{
+    char setting[STR_SIZE]; /* copy of a setting */
+    char threads[STR_SIZE]; /* task pool threads of the optimized mode */
+    char *value;            /* value of a setting */
+    const char **defaults;  /* default settings of the mode */
+    int i;                  /* looping variable */
+
+    defaults = (mode == MODE_LEGACY) ? legacy_env : optimized_env;
+    if (mode == MODE_OPTIMIZED)
+    {
+        snprintf (threads, sizeof (threads), "%d", options->threads);
+        setenv ("ESPA_TASK_THREADS", threads, 1);
+    }
+
+    for (i = 0; defaults[i] != NULL; i++)
+        putenv ((char *) defaults[i]);
+
+    for (i = 0; i < options->nenv[mode]; i++)
+    {
+        snprintf (setting, sizeof (setting), "%s", options->env[mode][i]);
+        value = strchr (setting, '=');
+        if (value == NULL)
+            unsetenv (setting);
+        else
+        {
+            *value++ = '\0';
+            setenv (setting, value, 1);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  run_stage
+
+PURPOSE: Runs the tool of a stage on a scene in the scene's directory of a
+mode and waits for it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting or waiting for the tool
+SUCCESS         The tool was run; its exit status is in *exit_status
+
+NOTES:
+  1. The tool's output is appended to regress.log in the scene's directory.
+******************************************************************************/
+static int run_stage
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene processed */
+    const char *dir_name,   /* I: directory of the scene in the mode */
+    int mode,               /* I: mode of the tools */
+    int stage,              /* I: stage run */
+    int *exit_status,       /* O: exit status of the tool; -1 if killed */
+    double *seconds         /* O: wall time of the tool */
+)
+{
+    char FUNC_NAME[] = "run_stage";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char tool[PATH_MAX];    /* name of the tool run */
+    char args[2][STR_SIZE]; /* arguments of the tool */
+    char *argv[4];          /* argument list of the tool */
+    int nargs = 0;          /* number of arguments */
+    int fd;                 /* log of the scene */
+    int wait_status;        /* status of the tool */
+    int i;                  /* looping variable */
+    double start;           /* time the tool started */
+    pid_t pid;              /* process of the tool */
+
+    /* Build the arguments; the XML file is in the scene's directory */
+    if (stage == STAGE_LPGS)
+    {
+        snprintf (args[nargs++], STR_SIZE, "--mtl=%s_MTL.txt",
+            scene->prefix);
+        snprintf (args[nargs++], STR_SIZE, "--threads=%d",
+            (mode == MODE_LEGACY) ? 1 : options->threads);
+    }
+    else
+        snprintf (args[nargs++], STR_SIZE, "--xml=%s.xml", scene->prefix);
+
+    if (options->bindir != NULL)
+        snprintf (tool, sizeof (tool), "%s/%s", options->bindir,
+            stage_tools[stage]);
+    else
+        snprintf (tool, sizeof (tool), "%s", stage_tools[stage]);
+
+    argv[0] = (char *) stage_tools[stage];
+    for (i = 0; i < nargs; i++)
+        argv[i + 1] = args[i];
+    argv[nargs + 1] = NULL;
+
+    fflush (stdout);
+    fflush (stderr);
+    start = elapsed_seconds ();
+    pid = fork ();
+    if (pid < 0)
+    {
+        sprintf (errmsg, "Starting %s", stage_tools[stage]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (pid == 0)
+    {
+        /* Run the tool in the scene's directory, logging its output */
+        if (chdir (dir_name) != 0 || (fd = open ("regress.log",
+            O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0)
+            _exit (127);
+        dup2 (fd, STDOUT_FILENO);
+        dup2 (fd, STDERR_FILENO);
+        close (fd);
+        set_mode_env (options, mode);
+        if (options->bindir != NULL)
+            execv (tool, argv);
+        else
+            execvp (tool, argv);
+        fprintf (stderr, "Unable to run %s: %s\n", tool, strerror (errno));
+        _exit (127);
+    }
+
+    while (waitpid (pid, &wait_status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            sprintf (errmsg, "Waiting for %s", stage_tools[stage]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    *seconds = elapsed_seconds () - start;
+    *exit_status = WIFEXITED (wait_status) ? WEXITSTATUS (wait_status) : -1;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compare_xml_files
+
+PURPOSE: Compares the XML files of the two modes, ignoring the production
+dates and provenance keys of the bands.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The XML files match, or neither mode wrote one
+false           The XML files differ, or only one mode wrote one
+
+NOTES:
+******************************************************************************/
+static bool compare_xml_files
+(
+    const char *legacy_xml,     /* I: XML file of the legacy mode */
+    const char *optimized_xml   /* I: XML file of the optimized mode */
+)
+{
+    char line[2][STR_SIZE * 4]; /* current lines of the files */
+    char *got[2];           /* results of reading the lines */
+    FILE *fp[2];            /* XML files */
+    bool equal = true;      /* do the files match? */
+    int i;                  /* looping variable */
+
+    fp[0] = fopen (legacy_xml, "r");
+    fp[1] = fopen (optimized_xml, "r");
+    if (fp[0] == NULL || fp[1] == NULL)
+        equal = (fp[0] == fp[1]);
+
+    while (equal && fp[0] != NULL)
+    {
+        /* Skip the lines which change with every run */
+        for (i = 0; i < 2; i++)
+        {
+            do
+                got[i] = fgets (line[i], sizeof (line[i]), fp[i]);
+            while (got[i] != NULL &&
+                (strstr (line[i], "<production_date>") != NULL ||
+                 strstr (line[i], "<provenance ") != NULL));
+        }
+
+        if (got[0] == NULL || got[1] == NULL)
+        {
+            equal = (got[0] == got[1]);
+            break;
+        }
+        equal = !strcmp (line[0], line[1]);
+    }
+
+    for (i = 0; i < 2; i++)
+        if (fp[i] != NULL)
+            fclose (fp[i]);
+
+    return (equal);
+}
+
+
+/******************************************************************************
+MODULE:  find_tolerance
+
+PURPOSE: Finds the tolerance rule of a band.
+
+RETURN VALUE:
+Type = const Tolerance_rule_t *
+Value           Description
+-----           -----------
+NULL            The band is compared exactly
+rule            First --tolerance rule, or else default rule, matching the
+                band's name
+
+NOTES:
+******************************************************************************/
+static const Tolerance_rule_t *find_tolerance
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const char *band_name   /* I: name of the band */
+)
+{
+    int i;                  /* looping variable */
+
+    for (i = 0; i < options->nrules; i++)
+        if (fnmatch (options->rules[i].pattern, band_name, 0) == 0)
+            return (&options->rules[i]);
+
+    for (i = 0; i < (int) (sizeof (default_rules) / sizeof (default_rules[0]));
+        i++)
+        if (fnmatch (default_rules[i].pattern, band_name, 0) == 0)
+            return (&default_rules[i]);
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  pixel_value
+
+PURPOSE: Returns a pixel of a buffer of a band's data type as a double.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+value           Value of the pixel
+
+NOTES:
+******************************************************************************/
+static double pixel_value
+(
+    const void *buf,        /* I: pixels of the band */
+    enum Espa_data_type data_type,  /* I: data type of the band */
+    size_t i                /* I: index of the pixel */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:    return (((const int8_t *) buf)[i]);
+        case ESPA_UINT8:   return (((const uint8_t *) buf)[i]);
+        case ESPA_INT16:   return (((const int16_t *) buf)[i]);
+        case ESPA_UINT16:  return (((const uint16_t *) buf)[i]);
+        case ESPA_INT32:   return (((const int32_t *) buf)[i]);
+        case ESPA_UINT32:  return (((const uint32_t *) buf)[i]);
+        case ESPA_FLOAT32: return (((const float *) buf)[i]);
+        case ESPA_FLOAT64: return (((const double *) buf)[i]);
+        default:           return (0.0);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  compare_band
+
+PURPOSE: Compares the pixels of a band of the two modes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band; diff->reason says why
+SUCCESS         The band was compared; diff->npixels is the number of pixels
+                outside the tolerance
+
+NOTES:
+  1. The band is read a block of lines at a time.  Blocks which are
+     identical are skipped with memcmp, so exact bands cost no more than
+     reading them.
+******************************************************************************/
+static int compare_band
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const char *dir_name[NUM_MODES],   /* I: directories of the scene */
+    Espa_band_meta_t *bmeta[NUM_MODES],  /* I: band of each mode */
+    char *buf[NUM_MODES],   /* I: buffers of REGRESS_BLOCK_PIXELS pixels
+                                  of 8 bytes */
+    Band_diff_t *diff       /* O: difference of the band */
+)
+{
+    char file_name[PATH_MAX];  /* name of the band file */
+    const Tolerance_rule_t *rule;  /* tolerance of the band */
+    FILE *fp[NUM_MODES];    /* band files */
+    int nbytes;             /* bytes per pixel */
+    int block_lines;        /* lines per block */
+    int nlines;             /* lines of the current block */
+    int line;               /* first line of the current block */
+    int mode;               /* mode index */
+    int status = SUCCESS;   /* status of the comparison */
+    size_t npix;            /* pixels of the current block */
+    size_t i;               /* pixel index */
+    double value[NUM_MODES];/* values of a pixel */
+    double delta;           /* difference of a pixel */
+
+    nbytes = get_data_type_size (bmeta[MODE_LEGACY]->data_type);
+    rule = find_tolerance (options, bmeta[MODE_LEGACY]->name);
+    block_lines = REGRESS_BLOCK_PIXELS / bmeta[MODE_LEGACY]->nsamps;
+    if (block_lines < 1)
+        block_lines = 1;
+
+    for (mode = 0; mode < NUM_MODES; mode++)
+    {
+        snprintf (file_name, sizeof (file_name), "%s/%s", dir_name[mode],
+            bmeta[mode]->file_name);
+        fp[mode] = open_raw_binary (file_name, "rb");
+        if (fp[mode] == NULL)
+        {
+            snprintf (diff->reason, sizeof (diff->reason), "unreadable in "
+                "the %s mode", mode_names[mode]);
+            status = ERROR;
+        }
+    }
+
+    for (line = 0; status == SUCCESS && line < bmeta[MODE_LEGACY]->nlines;
+        line += block_lines)
+    {
+        nlines = bmeta[MODE_LEGACY]->nlines - line;
+        if (nlines > block_lines)
+            nlines = block_lines;
+        npix = (size_t) nlines * bmeta[MODE_LEGACY]->nsamps;
+
+        for (mode = 0; mode < NUM_MODES; mode++)
+        {
+            if (read_raw_binary (fp[mode], nlines, bmeta[mode]->nsamps,
+                nbytes, buf[mode]) != SUCCESS)
+            {
+                snprintf (diff->reason, sizeof (diff->reason), "unreadable "
+                    "in the %s mode", mode_names[mode]);
+                status = ERROR;
+                break;
+            }
+        }
+        if (status != SUCCESS ||
+            !memcmp (buf[MODE_LEGACY], buf[MODE_OPTIMIZED], npix * nbytes))
+            continue;
+
+        for (i = 0; i < npix; i++)
+        {
+            for (mode = 0; mode < NUM_MODES; mode++)
+                value[mode] = pixel_value (buf[mode],
+                    bmeta[MODE_LEGACY]->data_type, i);
+            if (isnan (value[MODE_LEGACY]) && isnan (value[MODE_OPTIMIZED]))
+                continue;
+            delta = fabs (value[MODE_LEGACY] - value[MODE_OPTIMIZED]);
+            if (isnan (delta))
+                delta = INFINITY;
+            if (rule != NULL && rule->wrap > 0.0 && delta > rule->wrap / 2)
+                delta = fabs (rule->wrap - delta);
+            if (delta > diff->max_diff)
+                diff->max_diff = delta;
+            if (rule == NULL ? delta > 0.0 : delta > rule->tolerance)
+                diff->npixels++;
+        }
+    }
+
+    for (mode = 0; mode < NUM_MODES; mode++)
+        if (fp[mode] != NULL)
+            close_raw_binary (fp[mode]);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  compare_products
+
+PURPOSE: Compares the bands of a scene's product in the two modes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+number          Number of bands which differ, of which the first
+                REGRESS_MAX_DIFFS are in diffs
+
+NOTES:
+  1. A band missing in either mode, or whose size or data type differs,
+     differs.  Constant and derived bands have no pixels of their own and are
+     compared through the XML files.
+******************************************************************************/
+static int compare_products
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene compared */
+    const char *dir_name[NUM_MODES],   /* I: directories of the scene */
+    char *buf[NUM_MODES],   /* I: buffers of REGRESS_BLOCK_PIXELS pixels
+                                  of 8 bytes */
+    Band_diff_t *diffs      /* O: bands which differ */
+)
+{
+    char xml_file[PATH_MAX];/* XML file of a mode */
+    Espa_internal_meta_t meta[NUM_MODES];  /* metadata of each mode */
+    Espa_band_meta_t *bmeta[NUM_MODES];    /* band of each mode */
+    Band_diff_t diff;       /* difference of the current band */
+    bool parsed[NUM_MODES]; /* was the XML file of the mode parsed? */
+    int missing;            /* mode without a product */
+    int ndiffs = 0;         /* number of bands which differ */
+    int mode;               /* mode index */
+    int i, j;               /* looping variables */
+
+    for (mode = 0; mode < NUM_MODES; mode++)
+    {
+        snprintf (xml_file, sizeof (xml_file), "%s/%s.xml", dir_name[mode],
+            scene->prefix);
+        init_metadata_struct (&meta[mode]);
+        parsed[mode] = (access (xml_file, R_OK) == 0 &&
+            parse_metadata (xml_file, &meta[mode]) == SUCCESS);
+    }
+    if (!parsed[MODE_LEGACY] || !parsed[MODE_OPTIMIZED])
+    {
+        /* Without a product in either mode there is nothing to compare */
+        if (parsed[MODE_LEGACY] || parsed[MODE_OPTIMIZED])
+        {
+            missing = parsed[MODE_LEGACY] ? MODE_OPTIMIZED : MODE_LEGACY;
+            memset (&diffs[0], 0, sizeof (Band_diff_t));
+            snprintf (diffs[0].name, sizeof (diffs[0].name), "(xml)");
+            snprintf (diffs[0].reason, sizeof (diffs[0].reason),
+                "no product in the %s mode", mode_names[missing]);
+            ndiffs = 1;
+        }
+        for (mode = 0; mode < NUM_MODES; mode++)
+            if (parsed[mode])
+                free_metadata (&meta[mode]);
+        return (ndiffs);
+    }
+
+    for (i = 0; i < meta[MODE_LEGACY].nbands; i++)
+    {
+        bmeta[MODE_LEGACY] = &meta[MODE_LEGACY].band[i];
+        memset (&diff, 0, sizeof (diff));
+        snprintf (diff.name, sizeof (diff.name), "%s",
+            bmeta[MODE_LEGACY]->name);
+
+        bmeta[MODE_OPTIMIZED] = NULL;
+        for (j = 0; j < meta[MODE_OPTIMIZED].nbands; j++)
+            if (!strcmp (meta[MODE_OPTIMIZED].band[j].name, diff.name))
+                bmeta[MODE_OPTIMIZED] = &meta[MODE_OPTIMIZED].band[j];
+
+        if (bmeta[MODE_OPTIMIZED] == NULL)
+            snprintf (diff.reason, sizeof (diff.reason), "missing in the "
+                "optimized mode");
+        else if (bmeta[MODE_OPTIMIZED]->nlines != bmeta[MODE_LEGACY]->nlines
+            || bmeta[MODE_OPTIMIZED]->nsamps != bmeta[MODE_LEGACY]->nsamps
+            || bmeta[MODE_OPTIMIZED]->data_type !=
+               bmeta[MODE_LEGACY]->data_type)
+            snprintf (diff.reason, sizeof (diff.reason), "size or data type "
+                "differs");
+        else if (bmeta[MODE_LEGACY]->constant.is_constant ||
+            bmeta[MODE_LEGACY]->derived.is_derived ||
+            bmeta[MODE_OPTIMIZED]->constant.is_constant ||
+            bmeta[MODE_OPTIMIZED]->derived.is_derived)
+            continue;
+        else
+            compare_band (options, dir_name, bmeta, buf, &diff);
+
+        if (diff.reason[0] == '\0' && diff.npixels == 0)
+            continue;
+        if (ndiffs < REGRESS_MAX_DIFFS)
+            diffs[ndiffs] = diff;
+        ndiffs++;
+    }
+
+    /* Bands only in the optimized product */
+    for (j = 0; j < meta[MODE_OPTIMIZED].nbands; j++)
+    {
+        for (i = 0; i < meta[MODE_LEGACY].nbands; i++)
+            if (!strcmp (meta[MODE_LEGACY].band[i].name,
+                meta[MODE_OPTIMIZED].band[j].name))
+                break;
+        if (i < meta[MODE_LEGACY].nbands)
+            continue;
+        if (ndiffs < REGRESS_MAX_DIFFS)
+        {
+            memset (&diffs[ndiffs], 0, sizeof (Band_diff_t));
+            snprintf (diffs[ndiffs].name, sizeof (diffs[ndiffs].name), "%s",
+                meta[MODE_OPTIMIZED].band[j].name);
+            snprintf (diffs[ndiffs].reason, sizeof (diffs[ndiffs].reason),
+                "missing in the legacy mode");
+        }
+        ndiffs++;
+    }
+
+    for (mode = 0; mode < NUM_MODES; mode++)
+        free_metadata (&meta[mode]);
+
+    return (ndiffs);
+}
+
+
+/******************************************************************************
+MODULE:  run_scene
+
+PURPOSE: Runs the stages on a scene in both modes, compares the products and
+writes the results of the scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error preparing or running the scene
+SUCCESS         No errors encountered; *mismatch tells if the modes differ
+
+NOTES:
+  1. The modes alternate stage by stage, so both see the same state of the
+     node as far as possible.
+******************************************************************************/
+static int run_scene
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene processed */
+    int index,              /* I: index of the scene */
+    char *buf[NUM_MODES],   /* I: buffers of REGRESS_BLOCK_PIXELS pixels
+                                  of 8 bytes */
+    Stage_totals_t *totals, /* I/O: totals of the stages */
+    bool *mismatch          /* O: do the modes differ? */
+)
+{
+    char FUNC_NAME[] = "run_scene";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char dirs[NUM_MODES][PATH_MAX];   /* directories of the scene */
+    const char *dir_name[NUM_MODES];  /* directories of the scene */
+    char xml_file[NUM_MODES][PATH_MAX];  /* XML files of the scene */
+    Band_diff_t diffs[REGRESS_MAX_DIFFS];  /* bands which differ */
+    double seconds[NUM_STAGES][NUM_MODES];  /* wall times of the stages */
+    int exit_status[NUM_STAGES][NUM_MODES]; /* exit statuses of the
+                                               stages */
+    int ndiffs;             /* number of bands which differ */
+    int nreported = 0;      /* number of stages reported */
+    int stage;              /* stage index */
+    int mode;               /* mode index */
+    int i;                  /* looping variable */
+    bool xml_equal;         /* do the XML files match? */
+
+    for (mode = 0; mode < NUM_MODES; mode++)
+    {
+        snprintf (dirs[mode], sizeof (dirs[mode]), "%s/%s_%04d",
+            options->workdir, mode_names[mode], index + 1);
+        dir_name[mode] = dirs[mode];
+        nftw (dirs[mode], remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+        if (prepare_scene (scene, dirs[mode], buf[0]) != SUCCESS)
+            return (ERROR);
+        snprintf (xml_file[mode], sizeof (xml_file[mode]), "%s/%s.xml",
+            dirs[mode], scene->prefix);
+    }
+
+    *mismatch = false;
+    for (stage = 0; stage < NUM_STAGES; stage++)
+    {
+        if (!stage_applies (options, scene, stage))
+            continue;
+        for (mode = 0; mode < NUM_MODES; mode++)
+        {
+            if (run_stage (options, scene, dirs[mode], mode, stage,
+                &exit_status[stage][mode], &seconds[stage][mode]) != SUCCESS)
+                return (ERROR);
+            totals[stage].seconds[mode] += seconds[stage][mode];
+        }
+        totals[stage].runs++;
+
+        if (exit_status[stage][MODE_LEGACY] !=
+            exit_status[stage][MODE_OPTIMIZED])
+        {
+            totals[stage].mismatches++;
+            *mismatch = true;
+        }
+        else if (exit_status[stage][MODE_LEGACY] != 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "%s failed in both modes on "
+                "%s; see regress.log in %s", stage_tools[stage],
+                scene->prefix, dirs[MODE_LEGACY]);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+
+    xml_equal = compare_xml_files (xml_file[MODE_LEGACY],
+        xml_file[MODE_OPTIMIZED]);
+    ndiffs = compare_products (options, scene, dir_name, buf, diffs);
+    if (!xml_equal || ndiffs > 0)
+        *mismatch = true;
+
+    /* Write the results of the scene */
+    fprintf (options->out, "{\"scene\": \"%s\", \"match\": %s, "
+        "\"xml_equal\": %s, \"stages\": [", scene->prefix,
+        *mismatch ? "false" : "true", xml_equal ? "true" : "false");
+    for (stage = 0; stage < NUM_STAGES; stage++)
+    {
+        if (!stage_applies (options, scene, stage))
+            continue;
+        fprintf (options->out, "%s{\"name\": \"%s\", \"legacy_seconds\": "
+            "%.3f, \"optimized_seconds\": %.3f, \"legacy_status\": %d, "
+            "\"optimized_status\": %d}", nreported > 0 ? ", " : "",
+            stage_names[stage], seconds[stage][MODE_LEGACY],
+            seconds[stage][MODE_OPTIMIZED], exit_status[stage][MODE_LEGACY],
+            exit_status[stage][MODE_OPTIMIZED]);
+        nreported++;
+    }
+    fprintf (options->out, "], \"differing_bands\": %d, \"bands\": [",
+        ndiffs);
+    for (i = 0; i < ndiffs && i < REGRESS_MAX_DIFFS; i++)
+    {
+        fprintf (options->out, "%s{\"name\": \"%s\"", i > 0 ? ", " : "",
+            diffs[i].name);
+        if (diffs[i].reason[0] != '\0')
+            fprintf (options->out, ", \"reason\": \"%s\"}", diffs[i].reason);
+        else
+            fprintf (options->out, ", \"pixels\": %lld, \"max_diff\": %g}",
+                diffs[i].npixels, diffs[i].max_diff);
+    }
+    fprintf (options->out, "]}\n");
+    fflush (options->out);
+
+    if (!options->keep)
+        for (mode = 0; mode < NUM_MODES; mode++)
+            nftw (dirs[mode], remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_baseline
+
+PURPOSE: Reads the optimized time of each stage from the last summary line
+of a baseline file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the baseline, or it has no summary line
+SUCCESS         No errors encountered; stages not in the baseline are -1
+
+NOTES:
+  1. The baseline is a results file of an earlier run, or a file written
+     with --save_baseline.
+******************************************************************************/
+static int read_baseline
+(
+    const char *baseline,   /* I: name of the baseline file */
+    double *baseline_seconds  /* O: baseline optimized time of each stage */
+)
+{
+    char FUNC_NAME[] = "read_baseline";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char line[STR_SIZE * 8];/* current line of the baseline */
+    char summary[STR_SIZE * 8];  /* last summary line */
+    char key[STR_SIZE];     /* name of a stage in the summary */
+    char *cptr;             /* pointer into the summary */
+    FILE *fp;               /* baseline file */
+    int stage;              /* stage index */
+
+    for (stage = 0; stage < NUM_STAGES; stage++)
+        baseline_seconds[stage] = -1.0;
+
+    fp = fopen (baseline, "r");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the baseline %s",
+            baseline);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    summary[0] = '\0';
+    while (fgets (line, sizeof (line), fp) != NULL)
+        if (strstr (line, "\"summary\": true") != NULL)
+            strcpy (summary, line);
+    fclose (fp);
+
+    if (summary[0] == '\0')
+    {
+        snprintf (errmsg, sizeof (errmsg), "No summary line in the baseline "
+            "%s", baseline);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (stage = 0; stage < NUM_STAGES; stage++)
+    {
+        snprintf (key, sizeof (key), "\"name\": \"%s\"", stage_names[stage]);
+        cptr = strstr (summary, key);
+        if (cptr != NULL)
+            cptr = strstr (cptr, "\"optimized_seconds\": ");
+        if (cptr != NULL)
+            baseline_seconds[stage] = atof (cptr + 21);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_summary
+
+PURPOSE: Writes the summary line, with the legacy and optimized time of each
+stage and its comparison against the baseline.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            A stage regressed against the baseline
+false           No stage regressed
+
+NOTES:
+******************************************************************************/
+static bool write_summary
+(
+    const Regress_options_t *options,  /* I: options of the harness */
+    FILE *fp,               /* I: file the summary is written to */
+    int nscenes,            /* I: number of scenes */
+    int nmismatched,        /* I: number of scenes whose modes differ */
+    const Stage_totals_t *totals,  /* I: totals of the stages */
+    const double *baseline_seconds /* I: baseline times; NULL if none */
+)
+{
+    int stage;              /* stage index */
+    int nreported = 0;      /* number of stages reported */
+    bool regressed;         /* did the stage regress? */
+    bool any_regressed = false;  /* did any stage regress? */
+    double legacy;          /* legacy time of the stage */
+    double optimized;       /* optimized time of the stage */
+
+    fprintf (fp, "{\"summary\": true, \"scenes\": %d, \"mismatched\": %d, "
+        "\"threads\": %d, \"stages\": [", nscenes, nmismatched,
+        options->threads);
+    for (stage = 0; stage < NUM_STAGES; stage++)
+    {
+        if (totals[stage].runs == 0)
+            continue;
+        legacy = totals[stage].seconds[MODE_LEGACY];
+        optimized = totals[stage].seconds[MODE_OPTIMIZED];
+        fprintf (fp, "%s{\"name\": \"%s\", \"runs\": %d, \"mismatches\": %d, "
+            "\"legacy_seconds\": %.3f, \"optimized_seconds\": %.3f, "
+            "\"speedup\": %.2f", nreported > 0 ? ", " : "",
+            stage_names[stage], totals[stage].runs, totals[stage].mismatches,
+            legacy, optimized, optimized > 0.0 ? legacy / optimized : 0.0);
+        if (baseline_seconds != NULL && baseline_seconds[stage] >= 0.0)
+        {
+            regressed = (optimized > baseline_seconds[stage] *
+                (1.0 + options->max_slowdown));
+            fprintf (fp, ", \"baseline_seconds\": %.3f, \"regressed\": %s",
+                baseline_seconds[stage], regressed ? "true" : "false");
+            if (regressed)
+                any_regressed = true;
+        }
+        fprintf (fp, "}");
+        nreported++;
+    }
+    fprintf (fp, "], \"regressed\": %s}\n", any_regressed ? "true" : "false");
+    fflush (fp);
+
+    return (any_regressed);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Runs the stages on the scenes in both modes, compares the products
+and checks the times against the baseline.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the stages, the modes differ or a stage
+                regressed
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmp_dir[] = "/tmp/espa_regress.XXXXXX";  /* temporary directory */
+    char src_dir[PATH_MAX];      /* directory of the synthetic scenes */
+    char workdir[PATH_MAX];      /* absolute working directory */
+    char *output_file = NULL;    /* name of the results file */
+    char *buf[NUM_MODES] = {NULL, NULL};  /* buffers for copying and
+                                             comparing */
+    bool remove_workdir = false; /* was the working directory created? */
+    bool mismatch;               /* do the modes differ on a scene? */
+    bool regressed = false;      /* did a stage regress? */
+    int nscenes = 0;             /* number of scenes */
+    int nmismatched = 0;         /* number of scenes whose modes differ */
+    int results_fd;              /* descriptor the results are written to */
+    int status = SUCCESS;        /* status of the runs */
+    int i;                       /* looping variable */
+    int stage;                   /* stage index */
+    double baseline_seconds[NUM_STAGES];  /* baseline time of each stage */
+    FILE *fp;                    /* new baseline */
+    Scene_t *scenes = NULL;      /* scenes processed */
+    Stage_totals_t totals[NUM_STAGES];  /* totals of the stages */
+    Regress_options_t options;   /* options of the harness */
+
+    memset (&options, 0, sizeof (options));
+    options.nlines = 2000;
+    options.nsamps = 2000;
+    options.threads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (options.threads < 1)
+        options.threads = 1;
+    options.max_slowdown = 0.10;
+    for (stage = 0; stage < NUM_STAGES; stage++)
+        options.stages[stage] = true;
+    if (get_args (argc, argv, &options, &output_file) != SUCCESS)
+        exit (EXIT_FAILURE);
+
+    /* Open the results file, or keep the standard output for the results
+       and move the other messages to the standard error */
+    if (output_file != NULL)
+        options.out = fopen (output_file, "a");
+    else
+    {
+        fflush (stdout);
+        results_fd = dup (STDOUT_FILENO);
+        options.out = (results_fd < 0) ? NULL : fdopen (results_fd, "w");
+        if (options.out != NULL)
+            dup2 (STDERR_FILENO, STDOUT_FILENO);
+    }
+    if (options.out == NULL)
+    {
+        sprintf (errmsg, "Opening the results file %s",
+            output_file ? output_file : "(standard output)");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read the baseline before the runs, so a bad baseline fails early */
+    if (options.baseline != NULL &&
+        read_baseline (options.baseline, baseline_seconds) != SUCCESS)
+        exit (EXIT_FAILURE);
+
+    /* The scenes and tools are found from the working directory of the
+       tools, so use absolute names */
+    if (options.workdir == NULL)
+    {
+        remove_workdir = (mkdtemp (tmp_dir) != NULL);
+        options.workdir = strdup (tmp_dir);
+    }
+    if (!remove_workdir && realpath (options.workdir, workdir) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Finding the working directory %s",
+            options.workdir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    if (!remove_workdir)
+    {
+        free (options.workdir);
+        options.workdir = strdup (workdir);
+    }
+    if (options.bindir != NULL && realpath (options.bindir, workdir) != NULL)
+    {
+        free (options.bindir);
+        options.bindir = strdup (workdir);
+    }
+
+    for (i = 0; i < NUM_MODES; i++)
+    {
+        buf[i] = malloc (REGRESS_BLOCK_PIXELS * sizeof (double));
+        if (buf[i] == NULL)
+        {
+            sprintf (errmsg, "Allocating the comparison buffers");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* Find or generate the scenes */
+    if (options.scene_list != NULL)
+        status = read_scene_list (options.scene_list, &scenes, &nscenes);
+    else
+    {
+        snprintf (src_dir, sizeof (src_dir), "%s/synthetic",
+            options.workdir);
+        if (mkdir (src_dir, 0755) != 0 && errno != EEXIST)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Creating the directory %s",
+                src_dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+            status = create_synthetic_scenes (&options, src_dir, &scenes,
+                &nscenes);
+    }
+
+    memset (totals, 0, sizeof (totals));
+    for (i = 0; i < nscenes && status == SUCCESS; i++)
+    {
+        status = run_scene (&options, &scenes[i], i, buf, totals, &mismatch);
+        if (status == SUCCESS && mismatch)
+            nmismatched++;
+    }
+
+    if (status == SUCCESS)
+    {
+        regressed = write_summary (&options, options.out, nscenes,
+            nmismatched, totals,
+            options.baseline != NULL ? baseline_seconds : NULL);
+        if (options.save_baseline != NULL)
+        {
+            fp = fopen (options.save_baseline, "w");
+            if (fp == NULL)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Writing the baseline %s",
+                    options.save_baseline);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            else
+            {
+                write_summary (&options, fp, nscenes, nmismatched, totals,
+                    NULL);
+                fclose (fp);
+            }
+        }
+    }
+
+    if (options.scene_list == NULL && !options.keep)
+        nftw (src_dir, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if (remove_workdir && !options.keep && rmdir (options.workdir) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Removing the working directory %s",
+            options.workdir);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    fclose (options.out);
+    for (i = 0; i < NUM_MODES; i++)
+    {
+        free (buf[i]);
+        for (stage = 0; stage < options.nenv[i]; stage++)
+            free (options.env[i][stage]);
+    }
+    free (scenes);
+    free (options.scene_list);
+    free (options.baseline);
+    free (options.save_baseline);
+    free (options.bindir);
+    free (options.workdir);
+    free (output_file);
+
+    if (status != SUCCESS)
+    {
+        error_handler (true, FUNC_NAME, "Running the regression");
+        exit (EXIT_FAILURE);
+    }
+    if (nmismatched > 0 || regressed)
+    {
+        sprintf (errmsg, "%d of %d scenes differ between the modes%s",
+            nmismatched, nscenes,
+            regressed ? ", and a stage regressed against the baseline" : "");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,1576 @@
+/*****************************************************************************
+FILE: espa_scene_bench
+
+PURPOSE: Runs the tool chain end to end on real or synthetic scenes, with
+several scenes processed concurrently and with a cold or warm page cache,
+and writes the throughput, per-stage time, I/O and peak RSS of each run as
+JSON lines.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The chain is convert_lpgs_to_espa, clip_band_misalignment,
+     create_angle_bands, create_land_water_mask, create_date_bands,
+     convert_espa_to_gtif, convert_espa_to_hdf and convert_espa_to_bip.
+     With --mode=level1, create_level1_espa replaces convert_lpgs_to_espa,
+     create_angle_bands, create_land_water_mask and create_date_bands for
+     the MTL scenes, so the combined tool can be compared against the
+     separate ones.
+  2. A scene is an MTL file, which starts the chain at the conversion, or an
+     ESPA XML file, which starts it at the clipping.  Each run copies the
+     regular files named after the scene (prefix.* and prefix_*) to a
+     directory of its own, so every run starts from the same input.  The
+     angle bands are only created for the scenes with an _ANG.txt file.
+  3. A cold run drops the copied files from the page cache with
+     posix_fadvise before the chain starts; a warm run reads them first.
+     The tools and the land-mass polygon aren't dropped.
+  4. Each stage is a separate process.  Its wall time, peak RSS and block
+     I/O come from wait4, and the bytes of raw binary I/O from the profile
+     the tool writes with ESPA_PROFILE.  A stage which fails ends the chain
+     of its scene, except that the GeoTIFF, HDF and BIP conversions are
+     independent of each other, and the scene is counted as failed; the
+     tool messages are in bench.log in the scene's directory, which is kept
+     with --keep.
+  5. The BIP conversion is run with --convert_qa, but still needs the bands
+     to share a data type, so it fails on TM/ETM+ products (UINT8 bands with
+     a UINT16 quality band) and once the date bands are added.
+*****************************************************************************/
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "espa_common.h"
+#include "error_handler.h"
+#include "synthetic_scene.h"
+
+/* Defines */
+/* Largest number of scenes processed concurrently */
+#define SCENE_BENCH_MAX_PROCS 256
+
+/* Largest number of concurrency levels in --procs */
+#define SCENE_BENCH_MAX_RUNS 32
+
+/* Size of the buffer files are copied and read with */
+#define SCENE_BENCH_COPY_SIZE (1024 * 1024)
+
+/* Stages of the tool chain, in the order they are run */
+typedef enum
+{
+    STAGE_LPGS,             /* convert_lpgs_to_espa */
+    STAGE_LEVEL1,           /* create_level1_espa (--mode=level1) */
+    STAGE_CLIP,             /* clip_band_misalignment */
+    STAGE_ANGLES,           /* create_angle_bands */
+    STAGE_LAND_WATER_MASK,  /* create_land_water_mask */
+    STAGE_DATE_BANDS,       /* create_date_bands */
+    STAGE_GTIF,             /* convert_espa_to_gtif */
+    STAGE_HDF,              /* convert_espa_to_hdf */
+    STAGE_BIP,              /* convert_espa_to_bip */
+    NUM_STAGES
+} Stage_t;
+
+/* Names of the stages in --stages and in the results */
+static const char *stage_names[NUM_STAGES] =
+{
+    "lpgs", "level1", "clip", "angles", "land_water_mask", "date_bands",
+    "gtif", "hdf", "bip"
+};
+
+/* Tools run by the stages */
+static const char *stage_tools[NUM_STAGES] =
+{
+    "convert_lpgs_to_espa", "create_level1_espa", "clip_band_misalignment",
+    "create_angle_bands", "create_land_water_mask", "create_date_bands",
+    "convert_espa_to_gtif", "convert_espa_to_hdf", "convert_espa_to_bip"
+};
+
+/* Options of the harness */
+typedef struct
+{
+    char *scene_list;       /* file listing the scenes; NULL if synthetic */
+    int nsynthetic;         /* number of synthetic scenes */
+    int nlines;             /* number of lines in the synthetic scenes */
+    int nsamps;             /* number of samples in the synthetic scenes */
+    int procs[SCENE_BENCH_MAX_RUNS];  /* numbers of concurrent scenes */
+    int nprocs;             /* number of entries in procs */
+    int threads;            /* threads of the tools which take --threads */
+    bool cold;              /* run with a cold page cache? */
+    bool warm;              /* run with a warm page cache? */
+    bool level1;            /* use create_level1_espa for the MTL scenes? */
+    bool stages[NUM_STAGES];/* stages selected */
+    char *bindir;           /* directory of the tools; NULL to use PATH */
+    char *workdir;          /* directory of the runs */
+    bool keep;              /* keep the directories of the runs? */
+    FILE *out;              /* file the results are written to */
+} Scene_bench_options_t;
+
+/* Scene processed by the chain */
+typedef struct
+{
+    char src_dir[PATH_MAX]; /* directory of the scene's files */
+    char prefix[STR_SIZE];  /* scene name the files start with */
+    bool is_mtl;            /* does the chain start from the MTL file? */
+    bool has_ang;           /* does the scene have an ANG file? */
+} Scene_t;
+
+/* Totals of a stage over the scenes of a run */
+typedef struct
+{
+    int runs;               /* number of times the stage was run */
+    int failed;             /* number of runs which failed */
+    double seconds;         /* total wall time */
+    double max_seconds;     /* longest wall time of a run */
+    unsigned long long read_bytes;   /* raw binary bytes read */
+    unsigned long long write_bytes;  /* raw binary bytes written */
+    unsigned long long mapped_bytes; /* raw binary bytes mapped */
+    unsigned long long disk_read_bytes;   /* bytes read from the disk */
+    unsigned long long disk_write_bytes;  /* bytes written to the disk */
+    long peak_rss_kb;       /* largest peak RSS of a run (kB) */
+} Stage_stats_t;
+
+/* Chain of a scene in progress */
+typedef struct
+{
+    int scene;              /* index of the scene */
+    int stage;              /* stage running */
+    pid_t pid;              /* process of the stage; 0 if none */
+    bool failed;            /* has a stage of the scene failed? */
+    double start;           /* time the stage started */
+    char dir[PATH_MAX];     /* directory the scene is processed in */
+} Scene_job_t;
+
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_scene_bench runs the tool chain end to end on real or "
+            "synthetic scenes, with several scenes processed concurrently "
+            "and with a cold or warm page cache, and writes the scenes per "
+            "hour, per-stage wall time, bytes read and written, and peak RSS "
+            "of each run as JSON lines.\n\n");
+    printf ("usage: espa_scene_bench --scene_list=scene_list_filename | "
+            "--synthetic=nscenes [--nlines=lines] [--nsamps=samples] "
+            "[--procs=n1,n2,...] [--threads=nthreads] "
+            "[--cache=cold|warm|both] [--mode=tools|level1] "
+            "[--stages=stage1,stage2,...] [--bindir=directory] "
+            "[--workdir=directory] [--keep] [--output=results_filename]\n");
+
+    printf ("\nwhere one of the following parameters is required:\n");
+    printf ("    -scene_list: name of a file listing the MTL or ESPA XML "
+            "files of the scenes, one per line\n");
+    printf ("    -synthetic: number of synthetic ETM+ scenes to generate "
+            "and process\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -nlines, -nsamps: size of the synthetic scenes (default "
+            "is 2000 x 2000)\n");
+    printf ("    -procs: numbers of scenes processed concurrently, one run "
+            "each (default is 1)\n");
+    printf ("    -threads: threads of convert_lpgs_to_espa and "
+            "create_level1_espa (default is 1)\n");
+    printf ("    -cache: page cache at the start of each run (default is "
+            "both, a cold and a warm run for each number of concurrent "
+            "scenes)\n");
+    printf ("    -mode: tools runs the separate tools; level1 runs "
+            "create_level1_espa instead of the conversion, angle, "
+            "land/water mask and date band tools for MTL scenes (default "
+            "is tools)\n");
+    printf ("    -stages: stages run, of lpgs, clip, angles, "
+            "land_water_mask, date_bands, gtif, hdf and bip (default is "
+            "all)\n");
+    printf ("    -bindir: directory of the tools (default is the PATH)\n");
+    printf ("    -workdir: existing directory the runs are done in (default "
+            "is a new temporary directory)\n");
+    printf ("    -keep: keep the products and logs of the runs\n");
+    printf ("    -output: file the results are appended to (default is the "
+            "standard output)\n");
+    printf ("\nExample: espa_scene_bench --scene_list=scenes.txt "
+            "--procs=1,4,8 --output=scene_bench.json\n");
+}
+
+
+/******************************************************************************
+MODULE:  parse_procs
+
+PURPOSE:  Parses the comma-separated numbers of concurrent scenes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Invalid number of concurrent scenes
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int parse_procs
+(
+    const char *value,      /* I: value of --procs */
+    Scene_bench_options_t *options  /* I/O: options of the harness */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "parse_procs";   /* function name */
+    const char *cptr = value;        /* current number */
+    char *end;                       /* end of the current number */
+    long nprocs;                     /* current number of scenes */
+
+    options->nprocs = 0;
+    while (*cptr != '\0')
+    {
+        nprocs = strtol (cptr, &end, 10);
+        if (end == cptr || (*end != ',' && *end != '\0') || nprocs < 1 ||
+            nprocs > SCENE_BENCH_MAX_PROCS ||
+            options->nprocs == SCENE_BENCH_MAX_RUNS)
+        {
+            sprintf (errmsg, "Concurrent scenes must be up to %d numbers "
+                "from 1 to %d", SCENE_BENCH_MAX_RUNS, SCENE_BENCH_MAX_PROCS);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        options->procs[options->nprocs++] = nprocs;
+        cptr = (*end == ',') ? end + 1 : end;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_stages
+
+PURPOSE:  Parses the comma-separated names of the stages run.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown stage
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The level1 stage follows --mode rather than --stages.
+******************************************************************************/
+static int parse_stages
+(
+    const char *value,      /* I: value of --stages */
+    Scene_bench_options_t *options  /* I/O: options of the harness */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "parse_stages";   /* function name */
+    char names[STR_SIZE];            /* copy of the value */
+    char *name;                      /* current stage name */
+    char *saveptr = NULL;            /* state of strtok_r */
+    int stage;                       /* stage index */
+
+    snprintf (names, sizeof (names), "%s", value);
+    for (stage = 0; stage < NUM_STAGES; stage++)
+        options->stages[stage] = (stage == STAGE_LEVEL1);
+
+    for (name = strtok_r (names, ",", &saveptr); name != NULL;
+        name = strtok_r (NULL, ",", &saveptr))
+    {
+        for (stage = 0; stage < NUM_STAGES; stage++)
+            if (stage != STAGE_LEVEL1 && !strcmp (name, stage_names[stage]))
+                break;
+        if (stage == NUM_STAGES)
+        {
+            sprintf (errmsg, "Unknown stage %s", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        options->stages[stage] = true;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input strings.  It is up to the caller to
+     free them.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    Scene_bench_options_t *options,  /* O: options of the harness */
+    char **output_file    /* O: address of the results filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int keep_flag = 0;        /* flag to indicate if the runs should
+                                        be kept */
+    static struct option long_options[] =
+    {
+        {"keep", no_argument, &keep_flag, 1},
+        {"scene_list", required_argument, 0, 'L'},
+        {"synthetic", required_argument, 0, 'n'},
+        {"nlines", required_argument, 0, 'l'},
+        {"nsamps", required_argument, 0, 's'},
+        {"procs", required_argument, 0, 'P'},
+        {"threads", required_argument, 0, 't'},
+        {"cache", required_argument, 0, 'c'},
+        {"mode", required_argument, 0, 'm'},
+        {"stages", required_argument, 0, 'S'},
+        {"bindir", required_argument, 0, 'b'},
+        {"workdir", required_argument, 0, 'w'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'L':  /* scene list */
+                options->scene_list = strdup (optarg);
+                break;
+
+            case 'n':  /* number of synthetic scenes */
+                options->nsynthetic = atoi (optarg);
+                break;
+
+            case 'l':  /* number of lines */
+                options->nlines = atoi (optarg);
+                break;
+
+            case 's':  /* number of samples */
+                options->nsamps = atoi (optarg);
+                break;
+
+            case 'P':  /* numbers of concurrent scenes */
+                if (parse_procs (optarg, options) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* threads of the tools */
+                options->threads = atoi (optarg);
+                break;
+
+            case 'c':  /* page cache */
+                options->cold = !strcmp (optarg, "cold") ||
+                    !strcmp (optarg, "both");
+                options->warm = !strcmp (optarg, "warm") ||
+                    !strcmp (optarg, "both");
+                if (!options->cold && !options->warm)
+                {
+                    sprintf (errmsg, "Cache must be cold, warm or both");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'm':  /* tool chain */
+                if (!strcmp (optarg, "tools"))
+                    options->level1 = false;
+                else if (!strcmp (optarg, "level1"))
+                    options->level1 = true;
+                else
+                {
+                    sprintf (errmsg, "Mode must be tools or level1");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'S':  /* stages */
+                if (parse_stages (optarg, options) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'b':  /* directory of the tools */
+                options->bindir = strdup (optarg);
+                break;
+
+            case 'w':  /* working directory */
+                options->workdir = strdup (optarg);
+                break;
+
+            case 'o':  /* results filename */
+                *output_file = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the scene list or the synthetic scenes were
+       specified */
+    if ((options->scene_list == NULL) == (options->nsynthetic == 0))
+    {
+        sprintf (errmsg, "Either the scene list or the number of synthetic "
+            "scenes is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the numbers are valid */
+    if (options->nsynthetic < 0 || options->threads < 1)
+    {
+        sprintf (errmsg, "Number of synthetic scenes and threads must be "
+            "positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the flags */
+    if (keep_flag)
+        options->keep = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_seconds
+
+PURPOSE: Returns the time of the monotonic clock in seconds.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+seconds         Time of the monotonic clock
+
+NOTES:
+******************************************************************************/
+static double elapsed_seconds (void)
+{
+    struct timespec now;         /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec + now.tv_nsec * 1e-9);
+}
+
+
+/******************************************************************************
+MODULE:  add_scene
+
+PURPOSE: Adds an MTL or XML file to the scenes processed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finding the file or allocating the scenes
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int add_scene
+(
+    const char *file_name,  /* I: name of the MTL or XML file */
+    Scene_t **scenes,       /* I/O: scenes processed */
+    int *nscenes            /* I/O: number of scenes */
+)
+{
+    char FUNC_NAME[] = "add_scene";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char path[PATH_MAX];    /* absolute name of the file */
+    char ang_file[PATH_MAX];/* name of the ANG file */
+    char *cptr;             /* pointer into the filename */
+    Scene_t *scene;         /* scene added */
+    Scene_t *new_scenes;    /* reallocated scenes */
+
+    if (realpath (file_name, path) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Finding the scene %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    new_scenes = realloc (*scenes, (*nscenes + 1) * sizeof (Scene_t));
+    if (new_scenes == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Allocating the scene %s",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    *scenes = new_scenes;
+    scene = &new_scenes[*nscenes];
+
+    /* Split the file into its directory and the scene prefix */
+    cptr = strrchr (path, '/');
+    *cptr = '\0';
+    snprintf (scene->src_dir, sizeof (scene->src_dir), "%s", path);
+    snprintf (scene->prefix, sizeof (scene->prefix), "%s", cptr + 1);
+    cptr = strstr (scene->prefix, "_MTL.txt");
+    scene->is_mtl = (cptr != NULL && cptr[8] == '\0');
+    if (scene->is_mtl)
+        *cptr = '\0';
+    else
+    {
+        cptr = strrchr (scene->prefix, '.');
+        if (cptr == NULL || strcmp (cptr, ".xml"))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Scene %s is neither an "
+                "_MTL.txt nor an .xml file", file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        *cptr = '\0';
+    }
+
+    snprintf (ang_file, sizeof (ang_file), "%s/%s_ANG.txt", scene->src_dir,
+        scene->prefix);
+    scene->has_ang = (access (ang_file, R_OK) == 0);
+
+    (*nscenes)++;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_scene_list
+
+PURPOSE: Reads the MTL or XML files of the scenes from the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the scene list
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped, and anything after
+     the first word of a line is ignored, as in the scene lists of the tools.
+******************************************************************************/
+static int read_scene_list
+(
+    const char *scene_list, /* I: name of the scene list */
+    Scene_t **scenes,       /* O: scenes processed */
+    int *nscenes            /* O: number of scenes */
+)
+{
+    char FUNC_NAME[] = "read_scene_list";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char line[PATH_MAX];    /* line of the scene list */
+    char file_name[PATH_MAX];  /* first word of the line */
+    FILE *fp;               /* scene list */
+
+    fp = fopen (scene_list, "r");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the scene list %s",
+            scene_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if (sscanf (line, "%s", file_name) != 1 || file_name[0] == '#')
+            continue;
+        if (add_scene (file_name, scenes, nscenes) != SUCCESS)
+        {
+            fclose (fp);
+            return (ERROR);
+        }
+    }
+    fclose (fp);
+
+    if (*nscenes == 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "No scenes in the scene list %s",
+            scene_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_synthetic_scenes
+
+PURPOSE: Writes the synthetic ETM+ scenes to the source directory and adds
+them to the scenes processed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the scenes
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Each scene has its own seed, and its footprint edges are misaligned
+     between the bands, so the clipping has work to do.
+******************************************************************************/
+static int create_synthetic_scenes
+(
+    const Scene_bench_options_t *options,  /* I: options of the harness */
+    const char *src_dir,    /* I: directory the scenes are written to */
+    Scene_t **scenes,       /* O: scenes processed */
+    int *nscenes            /* O: number of scenes */
+)
+{
+    char FUNC_NAME[] = "create_synthetic_scenes";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char xml_file[PATH_MAX];/* XML file of the current scene */
+    static const char *etm_bands[] = {"band1", "band2", "band3", "band4",
+        "band5", "band61", "band62", "band7"};  /* ETM+ band layout */
+    Synthetic_scene_t synthetic;   /* description of the scene */
+    int i;                  /* scene index */
+
+    init_synthetic_scene (&synthetic);
+    strcpy (synthetic.satellite, "LANDSAT_7");
+    strcpy (synthetic.instrument, "ETM");
+    synthetic.nbands = 8;
+    synthetic.band_names = etm_bands;
+    synthetic.qa_band = true;
+    synthetic.data_type = ESPA_UINT8;
+    synthetic.misalign = 5;
+    synthetic.nlines = options->nlines;
+    synthetic.nsamps = options->nsamps;
+
+    for (i = 0; i < options->nsynthetic; i++)
+    {
+        synthetic.seed = i + 1;
+        snprintf (xml_file, sizeof (xml_file), "%s/synthetic_%04d.xml",
+            src_dir, i + 1);
+        if (create_synthetic_scene (&synthetic, xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Creating synthetic scene %d", i + 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (add_scene (xml_file, scenes, nscenes) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  is_scene_file
+
+PURPOSE: Determines whether a file belongs to a scene, being named prefix.*
+or prefix_*.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The file belongs to the scene
+false           The file doesn't belong to the scene
+
+NOTES:
+******************************************************************************/
+static bool is_scene_file
+(
+    const char *file_name,  /* I: name of the file */
+    const char *prefix      /* I: scene prefix */
+)
+{
+    size_t len = strlen (prefix);   /* length of the prefix */
+
+    return (!strncmp (file_name, prefix, len) &&
+        (file_name[len] == '.' || file_name[len] == '_'));
+}
+
+
+/******************************************************************************
+MODULE:  copy_file
+
+PURPOSE: Copies a file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the file
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int copy_file
+(
+    const char *src_file,   /* I: file copied */
+    const char *dest_file,  /* I: copy written */
+    char *buf               /* I: buffer of SCENE_BENCH_COPY_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "copy_file";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int src_fd;             /* file copied */
+    int dest_fd;            /* copy written */
+    ssize_t nread;          /* bytes read */
+    int status = SUCCESS;   /* status of the copy */
+
+    src_fd = open (src_file, O_RDONLY);
+    dest_fd = open (dest_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (src_fd < 0 || dest_fd < 0)
+        status = ERROR;
+
+    while (status == SUCCESS &&
+        (nread = read (src_fd, buf, SCENE_BENCH_COPY_SIZE)) != 0)
+    {
+        if (nread < 0 || write (dest_fd, buf, nread) != nread)
+            status = ERROR;
+    }
+
+    if (src_fd >= 0)
+        close (src_fd);
+    if (dest_fd >= 0 && close (dest_fd) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Copying %s to %s: %s", src_file,
+            dest_file, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  set_cache_state
+
+PURPOSE: Drops the files of a directory from the page cache, or reads them
+into it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The files are synced before they are dropped, since only clean pages
+     are dropped.
+******************************************************************************/
+static void set_cache_state
+(
+    const char *dir_name,   /* I: directory of the files */
+    bool cold,              /* I: drop the files rather than read them? */
+    char *buf               /* I: buffer of SCENE_BENCH_COPY_SIZE bytes */
+)
+{
+    char file_name[PATH_MAX];  /* name of the current file */
+    DIR *dir;               /* directory of the files */
+    struct dirent *entry;   /* current directory entry */
+    int fd;                 /* current file */
+
+    dir = opendir (dir_name);
+    if (dir == NULL)
+        return;
+
+    while ((entry = readdir (dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf (file_name, sizeof (file_name), "%s/%s", dir_name,
+            entry->d_name);
+        fd = open (file_name, O_RDONLY);
+        if (fd < 0)
+            continue;
+
+        if (cold)
+        {
+            fdatasync (fd);
+            posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+        else
+        {
+            while (read (fd, buf, SCENE_BENCH_COPY_SIZE) > 0)
+                ;
+        }
+        close (fd);
+    }
+    closedir (dir);
+}
+
+
+/******************************************************************************
+MODULE:  prepare_scene
+
+PURPOSE: Copies the files of a scene to its directory of the run and sets
+their page cache state.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the scene
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int prepare_scene
+(
+    const Scene_t *scene,   /* I: scene copied */
+    const char *dir_name,   /* I: directory of the scene in the run */
+    char *buf               /* I: buffer of SCENE_BENCH_COPY_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "prepare_scene";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char src_file[PATH_MAX];/* file copied */
+    char dest_file[PATH_MAX];  /* copy written */
+    DIR *dir;               /* source directory of the scene */
+    struct dirent *entry;   /* current directory entry */
+    struct stat stat_buf;   /* status of the current file */
+    int status = SUCCESS;   /* status of the copies */
+
+    if (mkdir (dir_name, 0755) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the directory %s",
+            dir_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    dir = opendir (scene->src_dir);
+    if (dir == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the directory %s",
+            scene->src_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && (entry = readdir (dir)) != NULL)
+    {
+        if (!is_scene_file (entry->d_name, scene->prefix))
+            continue;
+        snprintf (src_file, sizeof (src_file), "%s/%s", scene->src_dir,
+            entry->d_name);
+        if (stat (src_file, &stat_buf) != 0 || !S_ISREG (stat_buf.st_mode))
+            continue;
+        snprintf (dest_file, sizeof (dest_file), "%s/%s", dir_name,
+            entry->d_name);
+        status = copy_file (src_file, dest_file, buf);
+    }
+    closedir (dir);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  remove_tree_entry
+
+PURPOSE: Removes an entry of a directory tree; called by nftw.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               Continue the walk
+
+NOTES:
+******************************************************************************/
+static int remove_tree_entry
+(
+    const char *path,       /* I: name of the entry */
+    const struct stat *stat_buf,  /* I: not used */
+    int type,               /* I: not used */
+    struct FTW *ftw_buf     /* I: not used */
+)
+{
+    remove (path);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  stage_applies
+
+PURPOSE: Determines whether a stage is run on a scene.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The stage is run on the scene
+false           The stage is skipped
+
+NOTES:
+******************************************************************************/
+static bool stage_applies
+(
+    const Scene_bench_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene processed */
+    int stage               /* I: stage index */
+)
+{
+    bool level1 = options->level1 && scene->is_mtl;  /* is create_level1_espa
+                                                        used? */
+
+    if (!options->stages[stage])
+        return (false);
+
+    switch (stage)
+    {
+        case STAGE_LPGS:
+            return (scene->is_mtl && !level1);
+        case STAGE_LEVEL1:
+            return (level1);
+        case STAGE_ANGLES:
+            return (scene->has_ang && !level1);
+        case STAGE_LAND_WATER_MASK:
+        case STAGE_DATE_BANDS:
+            return (!level1);
+        default:
+            return (true);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  start_stage
+
+PURPOSE: Starts the tool of a stage on a scene in the scene's directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting the tool
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The tool's output is appended to bench.log, and its profile is written
+     to <stage>.profile, in the scene's directory.
+******************************************************************************/
+static int start_stage
+(
+    const Scene_bench_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene processed */
+    Scene_job_t *job        /* I/O: chain of the scene */
+)
+{
+    char FUNC_NAME[] = "start_stage";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char tool[PATH_MAX];    /* name of the tool run */
+    char profile[PATH_MAX]; /* ESPA_PROFILE of the tool */
+    char args[5][STR_SIZE]; /* arguments of the tool */
+    char *argv[8];          /* argument list of the tool */
+    int nargs = 0;          /* number of arguments */
+    int fd;                 /* log of the scene */
+    int i;                  /* looping variable */
+    const char *prefix = scene->prefix;  /* scene prefix */
+
+    /* Build the arguments; the XML file is in the scene's directory */
+    switch (job->stage)
+    {
+        case STAGE_LPGS:
+        case STAGE_LEVEL1:
+            snprintf (args[nargs++], STR_SIZE, "--mtl=%s_MTL.txt", prefix);
+            snprintf (args[nargs++], STR_SIZE, "--threads=%d",
+                options->threads);
+            if (job->stage == STAGE_LEVEL1)
+            {
+                if (scene->has_ang && options->stages[STAGE_ANGLES])
+                    snprintf (args[nargs++], STR_SIZE, "--angles");
+                if (options->stages[STAGE_LAND_WATER_MASK])
+                    snprintf (args[nargs++], STR_SIZE, "--land_water_mask");
+                if (options->stages[STAGE_DATE_BANDS])
+                    snprintf (args[nargs++], STR_SIZE, "--date_bands");
+            }
+            break;
+        case STAGE_GTIF:
+            snprintf (args[nargs++], STR_SIZE, "--xml=%s.xml", prefix);
+            snprintf (args[nargs++], STR_SIZE, "--gtif=%s", prefix);
+            break;
+        case STAGE_HDF:
+            snprintf (args[nargs++], STR_SIZE, "--xml=%s.xml", prefix);
+            snprintf (args[nargs++], STR_SIZE, "--hdf=%s.hdf", prefix);
+            break;
+        case STAGE_BIP:
+            snprintf (args[nargs++], STR_SIZE, "--xml=%s.xml", prefix);
+            snprintf (args[nargs++], STR_SIZE, "--bip=%s.bip", prefix);
+            snprintf (args[nargs++], STR_SIZE, "--convert_qa");
+            break;
+        default:
+            snprintf (args[nargs++], STR_SIZE, "--xml=%s.xml", prefix);
+            break;
+    }
+
+    if (options->bindir != NULL)
+        snprintf (tool, sizeof (tool), "%s/%s", options->bindir,
+            stage_tools[job->stage]);
+    else
+        snprintf (tool, sizeof (tool), "%s", stage_tools[job->stage]);
+    snprintf (profile, sizeof (profile), "%s/%s.profile", job->dir,
+        stage_names[job->stage]);
+    unlink (profile);
+
+    argv[0] = (char *) stage_tools[job->stage];
+    for (i = 0; i < nargs; i++)
+        argv[i + 1] = args[i];
+    argv[nargs + 1] = NULL;
+
+    fflush (stdout);
+    fflush (stderr);
+    job->start = elapsed_seconds ();
+    job->pid = fork ();
+    if (job->pid < 0)
+    {
+        sprintf (errmsg, "Starting %s", stage_tools[job->stage]);
+        error_handler (true, FUNC_NAME, errmsg);
+        job->pid = 0;
+        return (ERROR);
+    }
+
+    if (job->pid == 0)
+    {
+        /* Run the tool in the scene's directory, logging its output */
+        if (chdir (job->dir) != 0 ||
+            (fd = open ("bench.log", O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0)
+            _exit (127);
+        dup2 (fd, STDOUT_FILENO);
+        dup2 (fd, STDERR_FILENO);
+        close (fd);
+        setenv ("ESPA_PROFILE", profile, 1);
+        if (options->bindir != NULL)
+            execv (tool, argv);
+        else
+            execvp (tool, argv);
+        fprintf (stderr, "Unable to run %s: %s\n", tool, strerror (errno));
+        _exit (127);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_profile_bytes
+
+PURPOSE: Reads the raw binary bytes read, written and mapped by a stage from
+the profile its tool wrote.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The counters are left unchanged if the tool didn't write its profile,
+     e.g. because it failed to start.
+******************************************************************************/
+static void read_profile_bytes
+(
+    const char *profile,    /* I: name of the profile */
+    Stage_stats_t *stats    /* I/O: totals of the stage */
+)
+{
+    char line[STR_SIZE * 8];/* JSON line of the profile */
+    char *cptr;             /* pointer to a counter */
+    FILE *fp;               /* profile */
+
+    fp = fopen (profile, "r");
+    if (fp == NULL)
+        return;
+
+    /* The scene list tools write one line per scene, but the harness runs
+       one scene per tool, so there is a single line */
+    if (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if ((cptr = strstr (line, "\"read_bytes\": ")) != NULL)
+            stats->read_bytes += strtoull (cptr + 14, NULL, 10);
+        if ((cptr = strstr (line, "\"write_bytes\": ")) != NULL)
+            stats->write_bytes += strtoull (cptr + 15, NULL, 10);
+        if ((cptr = strstr (line, "\"mapped_bytes\": ")) != NULL)
+            stats->mapped_bytes += strtoull (cptr + 16, NULL, 10);
+    }
+    fclose (fp);
+}
+
+
+/******************************************************************************
+MODULE:  next_stage
+
+PURPOSE: Finds the next stage run on a scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+stage           Index of the next stage
+NUM_STAGES      The chain of the scene is done
+
+NOTES:
+******************************************************************************/
+static int next_stage
+(
+    const Scene_bench_options_t *options,  /* I: options of the harness */
+    const Scene_t *scene,   /* I: scene processed */
+    int stage               /* I: stage last run; -1 before the first */
+)
+{
+    for (stage++; stage < NUM_STAGES; stage++)
+        if (stage_applies (options, scene, stage))
+            break;
+
+    return (stage);
+}
+
+
+/******************************************************************************
+MODULE:  write_run_results
+
+PURPOSE: Writes the results of a run as a JSON line.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void write_run_results
+(
+    const Scene_bench_options_t *options,  /* I: options of the harness */
+    int procs,              /* I: number of concurrent scenes */
+    bool cold,              /* I: was the page cache cold? */
+    int nscenes,            /* I: number of scenes */
+    int nfailed,            /* I: number of scenes which failed */
+    double seconds,         /* I: wall time of the run */
+    const Stage_stats_t *stats  /* I: totals of the stages */
+)
+{
+    int stage;              /* stage index */
+    int nreported = 0;      /* number of stages reported */
+    long peak_rss_kb = 0;   /* largest peak RSS of the stages */
+
+    for (stage = 0; stage < NUM_STAGES; stage++)
+        if (stats[stage].peak_rss_kb > peak_rss_kb)
+            peak_rss_kb = stats[stage].peak_rss_kb;
+
+    fprintf (options->out, "{\"mode\": \"%s\", \"procs\": %d, "
+        "\"threads\": %d, \"cache\": \"%s\", \"scenes\": %d, "
+        "\"failed\": %d, \"seconds\": %.3f, \"scenes_per_hour\": %.2f, "
+        "\"peak_rss_kb\": %ld, \"stages\": [",
+        options->level1 ? "level1" : "tools", procs, options->threads,
+        cold ? "cold" : "warm", nscenes, nfailed, seconds,
+        seconds > 0.0 ? (nscenes - nfailed) * 3600.0 / seconds : 0.0,
+        peak_rss_kb);
+
+    for (stage = 0; stage < NUM_STAGES; stage++)
+    {
+        if (stats[stage].runs == 0)
+            continue;
+        fprintf (options->out, "%s{\"name\": \"%s\", \"tool\": \"%s\", "
+            "\"runs\": %d, \"failed\": %d, \"seconds\": %.3f, "
+            "\"mean_seconds\": %.3f, \"max_seconds\": %.3f, "
+            "\"read_bytes\": %llu, \"write_bytes\": %llu, "
+            "\"mapped_bytes\": %llu, \"disk_read_bytes\": %llu, "
+            "\"disk_write_bytes\": %llu, \"peak_rss_kb\": %ld}",
+            nreported > 0 ? ", " : "", stage_names[stage],
+            stage_tools[stage], stats[stage].runs, stats[stage].failed,
+            stats[stage].seconds, stats[stage].seconds / stats[stage].runs,
+            stats[stage].max_seconds, stats[stage].read_bytes,
+            stats[stage].write_bytes, stats[stage].mapped_bytes,
+            stats[stage].disk_read_bytes, stats[stage].disk_write_bytes,
+            stats[stage].peak_rss_kb);
+        nreported++;
+    }
+    fprintf (options->out, "]}\n");
+    fflush (options->out);
+}
+
+
+/******************************************************************************
+MODULE:  run_chain
+
+PURPOSE: Runs the tool chain on all the scenes, with up to procs scenes
+processed concurrently, and writes the results of the run.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error preparing or running the scenes
+SUCCESS         No errors encountered; stages may have failed
+
+NOTES:
+  1. The scenes are copied and their cache state set before the clock
+     starts.  The harness starts the next stage of a scene as soon as the
+     previous one exits, and the next scene as soon as a chain finishes.
+******************************************************************************/
+static int run_chain
+(
+    const Scene_bench_options_t *options,  /* I: options of the harness */
+    const Scene_t *scenes,  /* I: scenes processed */
+    int nscenes,            /* I: number of scenes */
+    int procs,              /* I: number of concurrent scenes */
+    bool cold,              /* I: start with a cold page cache? */
+    char *buf               /* I: buffer of SCENE_BENCH_COPY_SIZE bytes */
+)
+{
+    char FUNC_NAME[] = "run_chain";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char run_dir[PATH_MAX]; /* directory of the run */
+    char scene_dir[PATH_MAX];  /* directory of a scene in the run */
+    char profile[PATH_MAX]; /* profile of a stage */
+    Stage_stats_t stats[NUM_STAGES];  /* totals of the stages */
+    Stage_stats_t *stage_stats;       /* totals of the stage which exited */
+    Scene_job_t jobs[SCENE_BENCH_MAX_PROCS];  /* chains in progress */
+    Scene_job_t *job;       /* chain of the stage which exited */
+    struct rusage usage;    /* resource usage of the stage */
+    double start;           /* time the run started */
+    double seconds;         /* wall time of a stage */
+    int next_scene = 0;     /* next scene started */
+    int nactive = 0;        /* number of chains in progress */
+    int nfailed = 0;        /* number of scenes which failed */
+    int wait_status;        /* exit status of the stage */
+    int status = SUCCESS;   /* status of the run */
+    int i;                  /* looping variable */
+    pid_t pid;              /* process which exited */
+
+    /* Copy the scenes to the run's directory */
+    snprintf (run_dir, sizeof (run_dir), "%s/run_%s_%d_%s", options->workdir,
+        options->level1 ? "level1" : "tools", procs, cold ? "cold" : "warm");
+    nftw (run_dir, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if (mkdir (run_dir, 0755) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the directory %s",
+            run_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < nscenes && status == SUCCESS; i++)
+    {
+        snprintf (scene_dir, sizeof (scene_dir), "%s/%04d", run_dir, i + 1);
+        status = prepare_scene (&scenes[i], scene_dir, buf);
+    }
+    for (i = 0; i < nscenes && status == SUCCESS; i++)
+    {
+        snprintf (scene_dir, sizeof (scene_dir), "%s/%04d", run_dir, i + 1);
+        set_cache_state (scene_dir, cold, buf);
+    }
+
+    memset (stats, 0, sizeof (stats));
+    memset (jobs, 0, sizeof (jobs));
+    start = elapsed_seconds ();
+    while (status == SUCCESS && (next_scene < nscenes || nactive > 0))
+    {
+        /* Start the chains of the next scenes */
+        for (i = 0; i < procs && next_scene < nscenes; i++)
+        {
+            job = &jobs[i];
+            if (job->pid != 0)
+                continue;
+            job->scene = next_scene++;
+            job->failed = false;
+            job->stage = next_stage (options, &scenes[job->scene], -1);
+            snprintf (job->dir, sizeof (job->dir), "%s/%04d", run_dir,
+                job->scene + 1);
+            if (job->stage == NUM_STAGES)
+                continue;
+            if (start_stage (options, &scenes[job->scene], job) != SUCCESS)
+            {
+                status = ERROR;
+                break;
+            }
+            nactive++;
+        }
+        if (status != SUCCESS || nactive == 0)
+            continue;
+
+        /* Wait for a stage to exit */
+        pid = wait4 (-1, &wait_status, 0, &usage);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            sprintf (errmsg, "Waiting for the stages");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        for (i = 0; i < procs && jobs[i].pid != pid; i++)
+            ;
+        if (i == procs)
+            continue;
+        job = &jobs[i];
+        job->pid = 0;
+
+        /* Add the stage to its totals */
+        seconds = elapsed_seconds () - job->start;
+        stage_stats = &stats[job->stage];
+        stage_stats->runs++;
+        stage_stats->seconds += seconds;
+        if (seconds > stage_stats->max_seconds)
+            stage_stats->max_seconds = seconds;
+        stage_stats->disk_read_bytes += usage.ru_inblock * 512ULL;
+        stage_stats->disk_write_bytes += usage.ru_oublock * 512ULL;
+        if (usage.ru_maxrss > stage_stats->peak_rss_kb)
+            stage_stats->peak_rss_kb = usage.ru_maxrss;
+        snprintf (profile, sizeof (profile), "%s/%s.profile", job->dir,
+            stage_names[job->stage]);
+        read_profile_bytes (profile, stage_stats);
+
+        /* Start the next stage.  A failed stage ends the chain, except for
+           the output conversions, which don't depend on each other. */
+        if (!WIFEXITED (wait_status) || WEXITSTATUS (wait_status) != 0)
+        {
+            stage_stats->failed++;
+            job->failed = true;
+        }
+        if (!job->failed || job->stage >= STAGE_GTIF)
+            job->stage = next_stage (options, &scenes[job->scene],
+                job->stage);
+        else
+            job->stage = NUM_STAGES;
+        if (job->stage == NUM_STAGES)
+        {
+            if (job->failed)
+                nfailed++;
+            nactive--;
+        }
+        else if (start_stage (options, &scenes[job->scene], job) != SUCCESS)
+        {
+            nactive--;
+            status = ERROR;
+        }
+    }
+
+    /* Don't leave stages running if the run was cut short */
+    for (i = 0; i < procs; i++)
+        if (jobs[i].pid != 0)
+            waitpid (jobs[i].pid, &wait_status, 0);
+
+    if (status == SUCCESS)
+        write_run_results (options, procs, cold, nscenes, nfailed,
+            elapsed_seconds () - start, stats);
+
+    if (!options->keep)
+        nftw (run_dir, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Runs the tool chain on the scenes for each number of concurrent
+scenes and page cache state, and writes the results.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the chain
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmp_dir[] = "/tmp/espa_scene_bench.XXXXXX";  /* temporary
+                                                         directory */
+    char src_dir[PATH_MAX];      /* directory of the synthetic scenes */
+    char workdir[PATH_MAX];      /* absolute working directory */
+    char *output_file = NULL;    /* name of the results file */
+    char *buf = NULL;            /* buffer for copying and reading files */
+    bool remove_workdir = false; /* was the working directory created? */
+    int nscenes = 0;             /* number of scenes */
+    int results_fd;              /* descriptor the results are written to */
+    int status = SUCCESS;        /* status of the runs */
+    int i;                       /* looping variable */
+    int stage;                   /* stage index */
+    Scene_t *scenes = NULL;      /* scenes processed */
+    Scene_bench_options_t options;  /* options of the harness */
+
+    memset (&options, 0, sizeof (options));
+    options.nlines = 2000;
+    options.nsamps = 2000;
+    options.procs[0] = 1;
+    options.nprocs = 1;
+    options.threads = 1;
+    options.cold = true;
+    options.warm = true;
+    for (stage = 0; stage < NUM_STAGES; stage++)
+        options.stages[stage] = true;
+    if (get_args (argc, argv, &options, &output_file) != SUCCESS)
+        exit (EXIT_FAILURE);
+
+    /* Open the results file, or keep the standard output for the results
+       and move the other messages to the standard error */
+    if (output_file != NULL)
+        options.out = fopen (output_file, "a");
+    else
+    {
+        fflush (stdout);
+        results_fd = dup (STDOUT_FILENO);
+        options.out = (results_fd < 0) ? NULL : fdopen (results_fd, "w");
+        if (options.out != NULL)
+            dup2 (STDERR_FILENO, STDOUT_FILENO);
+    }
+    if (options.out == NULL)
+    {
+        sprintf (errmsg, "Opening the results file %s",
+            output_file ? output_file : "(standard output)");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* The scenes and tools are found from the working directory of the
+       tools, so use absolute names */
+    if (options.workdir == NULL)
+    {
+        remove_workdir = (mkdtemp (tmp_dir) != NULL);
+        options.workdir = strdup (tmp_dir);
+    }
+    if (!remove_workdir && realpath (options.workdir, workdir) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Finding the working directory %s",
+            options.workdir);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    if (!remove_workdir)
+    {
+        free (options.workdir);
+        options.workdir = strdup (workdir);
+    }
+    if (options.bindir != NULL && realpath (options.bindir, workdir) != NULL)
+    {
+        free (options.bindir);
+        options.bindir = strdup (workdir);
+    }
+
+    buf = malloc (SCENE_BENCH_COPY_SIZE);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the copy buffer");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Find or generate the scenes */
+    if (options.scene_list != NULL)
+        status = read_scene_list (options.scene_list, &scenes, &nscenes);
+    else
+    {
+        snprintf (src_dir, sizeof (src_dir), "%s/synthetic",
+            options.workdir);
+        if (mkdir (src_dir, 0755) != 0 && errno != EEXIST)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Creating the directory %s",
+                src_dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+            status = create_synthetic_scenes (&options, src_dir, &scenes,
+                &nscenes);
+    }
+
+    for (i = 0; i < options.nprocs && status == SUCCESS; i++)
+    {
+        if (options.cold)
+            status = run_chain (&options, scenes, nscenes, options.procs[i],
+                true, buf);
+        if (options.warm && status == SUCCESS)
+            status = run_chain (&options, scenes, nscenes, options.procs[i],
+                false, buf);
+    }
+
+    if (options.scene_list == NULL && !options.keep)
+        nftw (src_dir, remove_tree_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if (remove_workdir && !options.keep && rmdir (options.workdir) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Removing the working directory %s",
+            options.workdir);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    fclose (options.out);
+    free (buf);
+    free (scenes);
+    free (options.scene_list);
+    free (options.bindir);
+    free (options.workdir);
+    free (output_file);
+
+    if (status != SUCCESS)
+    {
+        error_handler (true, FUNC_NAME, "Running the tool chain");
+        exit (EXIT_FAILURE);
+    }
+
+    exit (EXIT_SUCCESS);
+}
@@ -14,10 +14,210 @@ Date         Programmer       Reason
 12/12/2013   Gail Schmidt     Original development
 
 NOTES:
+  1. Each message is saved in an error stack local to the calling thread and
+     in an error log shared by all the threads, in addition to being printed.
+     The log is a ring buffer whose slots are claimed with an atomic counter,
+     so threads don't take a lock to save their messages.  Readers of the log
+     detect slots which are being written or were overwritten using the
+     sequence number of the slot.
+  2. The output format is text unless set_error_output is called or the
+     ESPA_ERROR_OUTPUT environment variable is set to json or none.
 *****************************************************************************/
 
+#include <string.h>
 #include "error_handler.h"
 
+/* Slot of the shared error log */
+typedef struct
+{
+    unsigned long seq;     /* sequence number + 1 of the message in the slot,
+                              0 while the slot is being written */
+    Error_entry_t entry;   /* message */
+} Error_log_slot_t;
+
+/* Output format, -1 until it is set or read from the environment */
+static int error_output = -1;
+
+/* Shared error log and the sequence number of the next message */
+static Error_log_slot_t error_log[ERROR_LOG_SIZE];
+static unsigned long error_log_head = 0;
+
+/* Error stack of the current thread */
+static __thread Error_entry_t error_stack[ERROR_STACK_SIZE];
+static __thread int error_stack_top = 0;     /* index of the next slot */
+static __thread int error_stack_count = 0;   /* number of messages held */
+static __thread bool error_deferred = false; /* are messages held? */
+static __thread int error_deferred_count = 0;/* number of held messages not
+                                                yet printed */
+
+/******************************************************************************
+MODULE:  get_error_output
+
+PURPOSE:  Returns the output format, reading the ESPA_ERROR_OUTPUT environment
+variable if the format hasn't been set.
+
+RETURN VALUE:
+Type = Error_output_t
+Value           Description
+-----           -----------
+output format   Output format for the messages
+
+NOTES:
+******************************************************************************/
+static Error_output_t get_error_output (void)
+{
+    int output = __atomic_load_n (&error_output, __ATOMIC_RELAXED);
+    char *env = NULL;      /* value of the environment variable */
+
+    if (output == -1)
+    {
+        output = ERROR_OUTPUT_TEXT;
+        env = getenv ("ESPA_ERROR_OUTPUT");
+        if (env != NULL && !strcmp (env, "json"))
+            output = ERROR_OUTPUT_JSON;
+        else if (env != NULL && !strcmp (env, "none"))
+            output = ERROR_OUTPUT_NONE;
+        __atomic_store_n (&error_output, output, __ATOMIC_RELAXED);
+    }
+
+    return ((Error_output_t) output);
+}
+
+
+/******************************************************************************
+MODULE:  print_json_string
+
+PURPOSE:  Prints a string as a quoted JSON string.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void print_json_string
+(
+    const char *str   /* I: string to be printed */
+)
+{
+    const unsigned char *cptr = NULL;   /* pointer to the current character */
+
+    putchar_unlocked ('"');
+    for (cptr = (const unsigned char *) str; *cptr != '\0'; cptr++)
+    {
+        if (*cptr == '"' || *cptr == '\\')
+        {
+            putchar_unlocked ('\\');
+            putchar_unlocked (*cptr);
+        }
+        else if (*cptr == '\n')
+            fputs ("\\n", stdout);
+        else if (*cptr < 0x20)
+            printf ("\\u%04x", *cptr);
+        else
+            putchar_unlocked (*cptr);
+    }
+    putchar_unlocked ('"');
+}
+
+
+/******************************************************************************
+MODULE:  print_entry
+
+PURPOSE:  Prints the error/warning message in the current output format.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The message is written while holding the stdout lock, so messages from
+     multiple threads aren't interleaved.
+******************************************************************************/
+static void print_entry
+(
+    Error_entry_t *entry   /* I: message to be printed */
+)
+{
+    Error_output_t output = get_error_output ();   /* output format */
+
+    if (output == ERROR_OUTPUT_NONE)
+        return;
+
+    flockfile (stdout);
+    if (output == ERROR_OUTPUT_JSON)
+    {
+        printf ("{\"level\": \"%s\", \"code\": %d, \"module\": ",
+            entry->error_flag ? "error" : "warning", entry->code);
+        print_json_string (entry->module);
+        fputs (", \"message\": ", stdout);
+        print_json_string (entry->errmsg);
+        fputs ("}\n", stdout);
+    }
+    else if (entry->error_flag)
+        printf ("Error: %s : %s\n\n", entry->module, entry->errmsg);
+    else
+        printf ("Warning: %s : %s\n", entry->module, entry->errmsg);
+    fflush (stdout);
+    funlockfile (stdout);
+}
+
+
+/******************************************************************************
+MODULE:  error_handler_code
+
+PURPOSE:  Saves the error/warning message and its code in the error stack of
+the calling thread and the shared error log, and prints it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. If the messages of the thread are deferred, the message is printed by
+     flush_thread_errors instead.
+******************************************************************************/
+void error_handler_code
+(
+    bool error_flag,  /* I: true for errors, false for warnings */
+    int code,         /* I: error code for the message */
+    char *module,     /* I: calling module name */
+    char *errmsg      /* I: error/warning message to be printed, without
+                            ending EOL */
+)
+{
+    unsigned long seq;                /* sequence number of the message */
+    Error_entry_t *entry = NULL;      /* message in the stack */
+    Error_log_slot_t *slot = NULL;    /* slot of the message in the log */
+
+    /* Push the message on the stack of this thread, dropping the oldest
+       message if the stack is full */
+    entry = &error_stack[error_stack_top];
+    entry->error_flag = error_flag;
+    entry->code = code;
+    snprintf (entry->module, sizeof (entry->module), "%s", module);
+    snprintf (entry->errmsg, sizeof (entry->errmsg), "%s", errmsg);
+    error_stack_top = (error_stack_top + 1) % ERROR_STACK_SIZE;
+    if (error_stack_count < ERROR_STACK_SIZE)
+        error_stack_count++;
+
+    /* Claim the next slot of the shared log and mark it as being written
+       until the message is copied */
+    seq = __atomic_fetch_add (&error_log_head, 1, __ATOMIC_RELAXED);
+    slot = &error_log[seq % ERROR_LOG_SIZE];
+    __atomic_store_n (&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    memcpy (&slot->entry, entry, sizeof (Error_entry_t));
+    __atomic_store_n (&slot->seq, seq + 1, __ATOMIC_RELEASE);
+
+    /* Print the message unless it is held */
+    if (error_deferred)
+    {
+        if (error_deferred_count < ERROR_STACK_SIZE)
+            error_deferred_count++;
+    }
+    else
+        print_entry (entry);
+}
+
+
 /******************************************************************************
 MODULE:  error_handler
 
@@ -32,6 +232,8 @@ Date         Programmer       Reason
 12/12/2013   Gail Schmidt     Original development
 
 NOTES:
+  1. The message is saved with a code of ERROR for errors and SUCCESS for
+     warnings.  See error_handler_code.
 ******************************************************************************/
 void error_handler
 (
@@ -41,8 +243,238 @@ void error_handler
                             ending EOL */
 )
 {
-    if (error_flag)
-        printf ("Error: %s : %s\n\n", module, errmsg);
-    else
-        printf ("Warning: %s : %s\n", module, errmsg);
+    error_handler_code (error_flag, error_flag ? ERROR : SUCCESS, module,
+        errmsg);
+}
+
+
+/******************************************************************************
+MODULE:  set_error_output
+
+PURPOSE:  Sets the output format of the messages for all the threads.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void set_error_output
+(
+    Error_output_t output   /* I: output format for the messages */
+)
+{
+    __atomic_store_n (&error_output, (int) output, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  set_error_deferred
+
+PURPOSE:  Sets whether the messages of the calling thread are printed as they
+are reported, or held until flush_thread_errors is called.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. This allows a routine which may recover from an error to report it
+     without printing it, then print or discard it depending on the outcome.
+  2. Only the last ERROR_STACK_SIZE messages of the thread are held.
+******************************************************************************/
+void set_error_deferred
+(
+    bool deferred     /* I: should the messages of the calling thread be held
+                            until flush_thread_errors is called? */
+)
+{
+    error_deferred = deferred;
+}
+
+
+/******************************************************************************
+MODULE:  get_thread_error_count
+
+PURPOSE:  Returns the number of messages in the error stack of the calling
+thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0-ERROR_STACK_SIZE  Number of messages in the stack
+
+NOTES:
+******************************************************************************/
+int get_thread_error_count (void)
+{
+    return (error_stack_count);
+}
+
+
+/******************************************************************************
+MODULE:  get_thread_error
+
+PURPOSE:  Gets a message from the error stack of the calling thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           There is no message at the specified index
+SUCCESS         The message was copied
+
+NOTES:
+******************************************************************************/
+int get_thread_error
+(
+    int index,              /* I: index of the message, 0 being the most
+                                  recent */
+    Error_entry_t *entry    /* O: copy of the message */
+)
+{
+    int slot;                /* index of the message in the stack */
+
+    if (index < 0 || index >= error_stack_count)
+        return (ERROR);
+
+    slot = (error_stack_top - 1 - index + ERROR_STACK_SIZE) % ERROR_STACK_SIZE;
+    memcpy (entry, &error_stack[slot], sizeof (Error_entry_t));
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  save_thread_error
+
+PURPOSE:  Pushes a message reported by another thread on the error stack of
+the calling thread, without printing it or adding it to the shared log.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Used to pass the message of a failed task to the thread waiting on it
+     (see espa_task.h); the message was already printed and logged by the
+     thread which reported it.
+******************************************************************************/
+void save_thread_error
+(
+    const Error_entry_t *entry  /* I: message to be saved */
+)
+{
+    memcpy (&error_stack[error_stack_top], entry, sizeof (Error_entry_t));
+    error_stack_top = (error_stack_top + 1) % ERROR_STACK_SIZE;
+    if (error_stack_count < ERROR_STACK_SIZE)
+        error_stack_count++;
+}
+
+
+/******************************************************************************
+MODULE:  flush_thread_errors
+
+PURPOSE:  Prints the held messages of the calling thread, oldest first, and
+clears its error stack.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void flush_thread_errors (void)
+{
+    int i;                       /* looping variable */
+
+    for (i = error_deferred_count - 1; i >= 0; i--)
+    {
+        print_entry (&error_stack[(error_stack_top - 1 - i +
+            ERROR_STACK_SIZE) % ERROR_STACK_SIZE]);
+    }
+    clear_thread_errors ();
+}
+
+
+/******************************************************************************
+MODULE:  clear_thread_errors
+
+PURPOSE:  Clears the error stack of the calling thread, discarding any held
+messages.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The messages remain in the shared error log.
+******************************************************************************/
+void clear_thread_errors (void)
+{
+    error_stack_top = 0;
+    error_stack_count = 0;
+    error_deferred_count = 0;
+}
+
+
+/******************************************************************************
+MODULE:  read_error_log
+
+PURPOSE:  Reads the next message from the error log shared by all threads.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           There are no more messages to be read
+true            The message was copied and next_seq was advanced
+
+NOTES:
+  1. Messages which were overwritten before they were read are skipped, so
+     next_seq may advance by more than one.
+  2. No locks are taken, so this can be called while other threads report
+     messages, e.g. by a log aggregator.
+******************************************************************************/
+bool read_error_log
+(
+    unsigned long *next_seq, /* I/O: sequence number of the next message to
+                                     be read; start with 0 */
+    Error_entry_t *entry     /* O: copy of the message */
+)
+{
+    unsigned long head;            /* sequence number of the next message to
+                                      be written */
+    unsigned long seq;             /* sequence number of the slot */
+    Error_log_slot_t *slot = NULL; /* slot of the message in the log */
+
+    while (1)
+    {
+        head = __atomic_load_n (&error_log_head, __ATOMIC_ACQUIRE);
+        if (*next_seq >= head)
+            return (false);
+
+        /* Skip the messages which have already been overwritten */
+        if (head - *next_seq > ERROR_LOG_SIZE)
+            *next_seq = head - ERROR_LOG_SIZE;
+
+        slot = &error_log[*next_seq % ERROR_LOG_SIZE];
+        seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq < *next_seq + 1)
+        {   /* The message is still being written */
+            return (false);
+        }
+        else if (seq > *next_seq + 1)
+        {   /* The message was overwritten by a newer one */
+            (*next_seq)++;
+            continue;
+        }
+
+        /* Copy the message and make sure it wasn't overwritten meanwhile */
+        memcpy (entry, &slot->entry, sizeof (Error_entry_t));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (&slot->seq, __ATOMIC_RELAXED) != seq)
+        {
+            (*next_seq)++;
+            continue;
+        }
+
+        (*next_seq)++;
+        return (true);
+    }
 }
@@ -19,6 +19,36 @@ NOTES:
 #include <stdio.h>
 #include "espa_common.h"
 
+/* Defines */
+/* Number of messages kept in the error stack of each thread */
+#define ERROR_STACK_SIZE 16
+
+/* Number of messages kept in the error log shared by all threads */
+#define ERROR_LOG_SIZE 256
+
+/* Size of the module name saved with each message */
+#define ERROR_MODULE_SIZE 128
+
+/* Output format for the messages */
+typedef enum
+{
+    ERROR_OUTPUT_TEXT,    /* "Error: module : message" (default) */
+    ERROR_OUTPUT_JSON,    /* one JSON object per line */
+    ERROR_OUTPUT_NONE     /* messages are only kept in the stack and log */
+} Error_output_t;
+
+/* Error/warning message saved in the error stack and log */
+typedef struct
+{
+    bool error_flag;                   /* true for errors, false for
+                                          warnings */
+    int code;                          /* error code; ERROR for errors and
+                                          SUCCESS for warnings reported via
+                                          error_handler */
+    char module[ERROR_MODULE_SIZE];    /* calling module name */
+    char errmsg[STR_SIZE];             /* error/warning message */
+} Error_entry_t;
+
 /* Prototypes */
 void error_handler
 (
@@ -28,4 +58,49 @@ void error_handler
                             ending EOL */
 );
 
+void error_handler_code
+(
+    bool error_flag,  /* I: true for errors, false for warnings */
+    int code,         /* I: error code for the message */
+    char *module,     /* I: calling module name */
+    char *errmsg      /* I: error/warning message to be printed, without
+                            ending EOL */
+);
+
+void set_error_output
+(
+    Error_output_t output   /* I: output format for the messages */
+);
+
+void set_error_deferred
+(
+    bool deferred     /* I: should the messages of the calling thread be held
+                            until flush_thread_errors is called? */
+);
+
+int get_thread_error_count (void);
+
+int get_thread_error
+(
+    int index,              /* I: index of the message, 0 being the most
+                                  recent */
+    Error_entry_t *entry    /* O: copy of the message */
+);
+
+void save_thread_error
+(
+    const Error_entry_t *entry  /* I: message to be saved */
+);
+
+void flush_thread_errors (void);
+
+void clear_thread_errors (void);
+
+bool read_error_log
+(
+    unsigned long *next_seq, /* I/O: sequence number of the next message to
+                                     be read; start with 0 */
+    Error_entry_t *entry     /* O: copy of the message */
+);
+
 #endif
@@ -0,0 +1,276 @@
+/*****************************************************************************
+FILE: espa_alloc.c
+
+PURPOSE: Contains functions for allocating the large (full scene) buffers of
+the library routines, backed by transparent huge pages or hugetlbfs.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each buffer has a header in front of it recording how it was
+     allocated, so espa_free_large releases it the same way.  Heap buffers
+     have a small header; mapped buffers have a header page.
+  2. The mappings for transparent huge pages are aligned to and sized in
+     multiples of ESPA_HUGE_PAGE_SIZE, so all of the buffer can be backed by
+     huge pages rather than only the aligned part in the middle of it.
+  3. The allocations are counted by the profiler (see espa_profile.h) by
+     the kind of pages backing them.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "error_handler.h"
+#include "espa_profile.h"
+#include "espa_alloc.h"
+
+/* Marks the header of a large buffer */
+#define ALLOC_MAGIC 0x4553504cu
+
+/* Size of the header in front of a heap buffer, keeping the buffer aligned
+   to a cache line relative to the heap allocation */
+#define ALLOC_HEAP_HEADER 64
+
+/* Size of the header page in front of a mapped buffer */
+#define ALLOC_PAGE_HEADER 4096
+
+/* Huge page modes, selected by ESPA_HUGE_PAGES */
+#define ALLOC_MODE_OFF 0
+#define ALLOC_MODE_THP 1
+#define ALLOC_MODE_HUGETLB 2
+
+/* Header in front of each buffer */
+typedef struct
+{
+    uint32_t magic;           /* ALLOC_MAGIC */
+    Espa_profile_alloc_t kind;  /* pages backing the buffer */
+    size_t map_size;          /* size of the allocation, with the header */
+} Alloc_header_t;
+
+/* Huge page mode, read from the environment once */
+static int alloc_mode = ALLOC_MODE_THP;
+static pthread_once_t alloc_mode_once = PTHREAD_ONCE_INIT;
+
+/* Has the hugetlb fallback been reported? */
+static int hugetlb_reported = 0;
+
+/******************************************************************************
+MODULE:  init_alloc_mode
+
+PURPOSE:  Reads the huge page mode from the ESPA_HUGE_PAGES environment
+variable.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. An unknown mode is reported as a warning and the default is used.
+******************************************************************************/
+static void init_alloc_mode (void)
+{
+    char FUNC_NAME[] = "init_alloc_mode";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *mode = getenv ("ESPA_HUGE_PAGES");  /* requested mode */
+
+    if (mode == NULL || mode[0] == '\0' || !strcmp (mode, "thp"))
+        return;
+
+    if (!strcmp (mode, "off"))
+        alloc_mode = ALLOC_MODE_OFF;
+    else if (!strcmp (mode, "hugetlb"))
+        alloc_mode = ALLOC_MODE_HUGETLB;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown ESPA_HUGE_PAGES %s; "
+            "using thp", mode);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  map_huge_aligned
+
+PURPOSE:  Maps anonymous memory aligned to a huge page.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Error mapping the memory
+non-NULL        Start of the mapping
+
+NOTES:
+  1. A huge page more than needed is mapped and the unaligned ends are
+     unmapped again.
+******************************************************************************/
+static void *map_huge_aligned
+(
+    size_t map_size       /* I: size of the mapping; a multiple of the huge
+                                page size */
+)
+{
+    size_t over_size = map_size + ESPA_HUGE_PAGE_SIZE;  /* size mapped */
+    char *map = NULL;     /* mapping, before it is trimmed */
+    char *start = NULL;   /* aligned start of the mapping */
+
+    map = mmap (NULL, over_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return (NULL);
+
+    start = (char *) (((uintptr_t) map + ESPA_HUGE_PAGE_SIZE - 1) &
+        ~((uintptr_t) ESPA_HUGE_PAGE_SIZE - 1));
+    if (start > map)
+        munmap (map, start - map);
+    if (start + map_size < map + over_size)
+        munmap (start + map_size, map + over_size - (start + map_size));
+
+    return (start);
+}
+
+
+/******************************************************************************
+MODULE:  espa_alloc_large
+
+PURPOSE:  Allocates a zeroed buffer, backed by huge pages if it is large
+enough and huge pages aren't turned off.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Error allocating the buffer
+non-NULL        Pointer to the buffer; release it with espa_free_large
+
+NOTES:
+  1. The mapped buffers are page aligned.
+******************************************************************************/
+void *espa_alloc_large
+(
+    size_t nbytes         /* I: number of bytes needed */
+)
+{
+    char FUNC_NAME[] = "espa_alloc_large";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t map_size;         /* size of the allocation, with the header */
+    void *map = NULL;        /* allocation */
+    Espa_profile_alloc_t kind;  /* pages backing the buffer */
+    Alloc_header_t *hdr = NULL; /* header of the buffer */
+
+    pthread_once (&alloc_mode_once, init_alloc_mode);
+
+    /* Small buffers come from the heap */
+    if (nbytes < ESPA_HUGE_PAGE_SIZE)
+    {
+        map_size = ALLOC_HEAP_HEADER + nbytes;
+        map = calloc (1, map_size);
+        if (map == NULL)
+            return (NULL);
+        hdr = map;
+        hdr->magic = ALLOC_MAGIC;
+        hdr->kind = ESPA_PROFILE_ALLOC_HEAP;
+        hdr->map_size = map_size;
+        espa_profile_count_alloc (ESPA_PROFILE_ALLOC_HEAP, nbytes);
+        return ((char *) map + ALLOC_HEAP_HEADER);
+    }
+
+    map_size = (ALLOC_PAGE_HEADER + nbytes + ESPA_HUGE_PAGE_SIZE - 1) /
+        ESPA_HUGE_PAGE_SIZE * ESPA_HUGE_PAGE_SIZE;
+    map = MAP_FAILED;
+    kind = ESPA_PROFILE_ALLOC_PAGES;
+
+#ifdef MAP_HUGETLB
+    if (alloc_mode == ALLOC_MODE_HUGETLB)
+    {
+        map = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED)
+            kind = ESPA_PROFILE_ALLOC_HUGETLB;
+        else if (!__atomic_exchange_n (&hugetlb_reported, 1,
+            __ATOMIC_RELAXED))
+        {
+            sprintf (errmsg, "No free hugetlb pages; using transparent huge "
+                "pages");
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+#endif
+
+    if (map == MAP_FAILED && alloc_mode != ALLOC_MODE_OFF)
+    {
+        map = map_huge_aligned (map_size);
+        if (map == NULL)
+            return (NULL);
+#ifdef MADV_HUGEPAGE
+        if (madvise (map, map_size, MADV_HUGEPAGE) == 0)
+            kind = ESPA_PROFILE_ALLOC_THP;
+#endif
+    }
+    else if (map == MAP_FAILED)
+    {
+        map = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+            return (NULL);
+    }
+
+    hdr = map;
+    hdr->magic = ALLOC_MAGIC;
+    hdr->kind = kind;
+    hdr->map_size = map_size;
+    espa_profile_count_alloc (kind, nbytes);
+    return ((char *) map + ALLOC_PAGE_HEADER);
+}
+
+
+/******************************************************************************
+MODULE:  espa_free_large
+
+PURPOSE:  Releases a buffer allocated by espa_alloc_large.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_free_large
+(
+    void *buf             /* I: buffer from espa_alloc_large, or NULL */
+)
+{
+    char FUNC_NAME[] = "espa_free_large";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Alloc_header_t *hdr = NULL; /* header of the buffer */
+
+    if (buf == NULL)
+        return;
+
+    /* The header of a heap buffer is just in front of it, while a mapped
+       buffer has a whole header page */
+    hdr = (Alloc_header_t *) ((char *) buf - ALLOC_HEAP_HEADER);
+    if (hdr->magic == ALLOC_MAGIC && hdr->kind == ESPA_PROFILE_ALLOC_HEAP)
+    {
+        hdr->magic = 0;
+        free (hdr);
+        return;
+    }
+
+    hdr = (Alloc_header_t *) ((char *) buf - ALLOC_PAGE_HEADER);
+    if (hdr->magic != ALLOC_MAGIC)
+    {
+        sprintf (errmsg, "Releasing a buffer which isn't from "
+            "espa_alloc_large");
+        error_handler (true, FUNC_NAME, errmsg);
+        return;
+    }
+
+    hdr->magic = 0;
+    munmap (hdr, hdr->map_size);
+}
@@ -0,0 +1,45 @@
+/*****************************************************************************
+FILE: espa_alloc.h
+
+PURPOSE: Contains the defines and prototypes for the allocator of the large
+(full scene) buffers of the library routines, which backs them with huge
+pages to cut the page faults and TLB misses of touching them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The backing of the large buffers is selected by the ESPA_HUGE_PAGES
+     environment variable: "thp" (the default) advises the kernel to use
+     transparent huge pages, "hugetlb" maps them from the reserved huge
+     pages (vm.nr_hugepages), falling back to transparent huge pages when
+     none are free, and "off" maps them with normal pages.
+  2. Buffers smaller than ESPA_HUGE_PAGE_SIZE are allocated from the heap.
+  3. The buffers are zeroed, like calloc, and must be released with
+     espa_free_large rather than free.
+*****************************************************************************/
+
+#ifndef ESPA_ALLOC_H_
+#define ESPA_ALLOC_H_
+
+#include <stdlib.h>
+
+/* Defines */
+/* Size of a huge page, and the smallest buffer backed by huge pages
+   (bytes) */
+#define ESPA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* Prototypes */
+void *espa_alloc_large
+(
+    size_t nbytes         /* I: number of bytes needed */
+);
+
+void espa_free_large
+(
+    void *buf             /* I: buffer from espa_alloc_large, or NULL */
+);
+
+#endif
@@ -0,0 +1,625 @@
+/*****************************************************************************
+FILE: espa_batch.c
+
+PURPOSE: Contains functions for running the raw binary tools on a list of
+scenes in a single process, so the process startup and the setup shared by
+the scenes (e.g. compiling the schema) are paid once per batch instead of
+once per scene.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The scenes are processed by worker processes forked from the tool after
+     its shared setup, so the workers start with that setup already done.
+     Each worker takes the next scene from a counter in shared memory until
+     there are none left, so nprocs scenes are processed concurrently.
+  2. A scene which fails doesn't stop the batch.  If a worker crashes or
+     exits while processing a scene, the scene is reported as failed and a
+     new worker is forked to process the remaining scenes.
+  3. The tools' library functions aren't thread safe, which is why processes
+     are used rather than threads.
+  4. With NUMA placement on (see espa_numa.h), each worker is pinned to a
+     node by its slot, so the scenes processed concurrently are spread over
+     the sockets without any scene crossing them.
+  5. The workers report the progress of the long-running library routines
+     (see espa_progress.h) in 10% steps.  If ESPA_SCENE_TIMEOUT gives a
+     deadline for each scene in seconds, a scene which passes it is
+     cancelled by an alarm, so it fails the next time a routine checks for
+     cancellation and the worker moves on to the next scene.
+  6. With a node scheduler (see espa_node_sched.h), each scene waits to be
+     admitted before it's processed, as a job of the class of the tool, so
+     the batches of the tools running on the node share its cores and
+     bandwidth.  The deadline of a scene starts once it's admitted.
+*****************************************************************************/
+
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "error_handler.h"
+#include "espa_batch.h"
+#include "espa_profile.h"
+#include "espa_memory.h"
+#include "espa_numa.h"
+#include "espa_progress.h"
+#include "espa_node_sched.h"
+
+/* Step between the progress percentages reported by the workers */
+#define BATCH_PROGRESS_STEP 10
+
+/* State of each scene in the batch */
+typedef enum
+{
+    BATCH_PENDING,                /* not processed yet */
+    BATCH_RUNNING,                /* being processed by a worker */
+    BATCH_DONE,                   /* processed successfully */
+    BATCH_FAILED                  /* failed, or its worker died */
+} Batch_state_t;
+
+/* Scene list and the state shared with the workers */
+typedef struct
+{
+    int nscenes;                  /* number of scenes */
+    char **input;                 /* input file of each scene */
+    char **output;                /* output file of each scene, or NULL */
+    int *next;                    /* next scene to be processed (shared) */
+    int *state;                   /* Batch_state_t of each scene (shared) */
+    pid_t *owner;                 /* worker processing each scene (shared) */
+    void *shared;                 /* shared memory holding next, state and
+                                     owner */
+    size_t shared_size;           /* size of the shared memory */
+    int timeout;                  /* deadline of each scene (seconds); 0 for
+                                     none */
+} Batch_t;
+
+/* Progress reported by the routine processing the scene of a worker */
+typedef struct
+{
+    const char *routine;          /* routine last reported */
+    int percent;                  /* percentage last reported */
+} Batch_progress_t;
+
+/* Progress and cancellation of the scene being processed by the worker */
+static Espa_progress_t scene_progress;
+
+
+/******************************************************************************
+MODULE:  free_scene_list
+
+PURPOSE: Frees the scene list and the shared memory of the batch.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_scene_list
+(
+    Batch_t *batch                /* I/O: batch to be freed */
+)
+{
+    int i;                        /* looping variable for the scenes */
+
+    for (i = 0; i < batch->nscenes; i++)
+    {
+        free (batch->input[i]);
+        free (batch->output[i]);
+    }
+    free (batch->input);
+    free (batch->output);
+    if (batch->shared != NULL)
+        munmap (batch->shared, batch->shared_size);
+    memset (batch, 0, sizeof (Batch_t));
+}
+
+
+/******************************************************************************
+MODULE:  read_scene_list
+
+PURPOSE: Reads the scene list and sets up the state shared with the workers.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the scene list or allocating memory
+SUCCESS         The scene list was read
+
+NOTES:
+  1. A line with more than an input and an output file is an error, since it
+     probably means a filename contains spaces.
+******************************************************************************/
+static int read_scene_list
+(
+    char *scene_list,             /* I: name of the scene list; "-" for the
+                                        standard input */
+    Batch_t *batch                /* O: scenes of the batch */
+)
+{
+    char FUNC_NAME[] = "read_scene_list";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *line = NULL;            /* current line of the scene list */
+    size_t line_size = 0;         /* allocated size of line */
+    char *field[3];               /* fields of the line */
+    int nfields;                  /* number of fields in the line */
+    int size = 0;                 /* allocated number of scenes */
+    int line_num = 0;             /* current line number */
+    char *ptr = NULL;             /* current character of the line */
+    void *new_ptr = NULL;         /* reallocated scene arrays */
+    FILE *fptr = NULL;            /* scene list file pointer */
+    int status = SUCCESS;         /* return status */
+
+    memset (batch, 0, sizeof (Batch_t));
+    fptr = strcmp (scene_list, "-") ? fopen (scene_list, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the scene list %s", scene_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && getline (&line, &line_size, fptr) != -1)
+    {
+        line_num++;
+
+        /* Split the line into whitespace-separated fields */
+        nfields = 0;
+        ptr = line;
+        while (nfields < 3)
+        {
+            while (isspace ((unsigned char) *ptr))
+                ptr++;
+            if (*ptr == '\0' || (nfields == 0 && *ptr == '#'))
+                break;
+            field[nfields++] = ptr;
+            while (*ptr != '\0' && !isspace ((unsigned char) *ptr))
+                ptr++;
+            if (*ptr != '\0')
+                *ptr++ = '\0';
+        }
+        if (nfields == 0)
+            continue;
+        if (nfields > 2)
+        {
+            sprintf (errmsg, "Line %d of the scene list %s has more than an "
+                "input and an output file", line_num, scene_list);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        if (batch->nscenes == size)
+        {
+            size = (size > 0) ? size * 2 : 256;
+            new_ptr = realloc (batch->input, size * sizeof (char *));
+            if (new_ptr != NULL)
+            {
+                batch->input = new_ptr;
+                new_ptr = realloc (batch->output, size * sizeof (char *));
+                if (new_ptr != NULL)
+                    batch->output = new_ptr;
+            }
+            if (new_ptr == NULL)
+            {
+                sprintf (errmsg, "Allocating the scene list");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+
+        batch->input[batch->nscenes] = strdup (field[0]);
+        batch->output[batch->nscenes] = (nfields > 1) ? strdup (field[1])
+            : NULL;
+        if (batch->input[batch->nscenes] == NULL ||
+            (nfields > 1 && batch->output[batch->nscenes] == NULL))
+        {
+            free (batch->input[batch->nscenes]);
+            free (batch->output[batch->nscenes]);
+            sprintf (errmsg, "Allocating the scene list");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        batch->nscenes++;
+    }
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    /* Set up the state shared with the workers */
+    if (status == SUCCESS)
+    {
+        batch->shared_size = sizeof (int) + (size_t) batch->nscenes
+            * (sizeof (int) + sizeof (pid_t));
+        batch->shared = mmap (NULL, batch->shared_size, PROT_READ |
+            PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (batch->shared == MAP_FAILED)
+        {
+            batch->shared = NULL;
+            sprintf (errmsg, "Allocating the shared state of the batch");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+        {
+            /* The anonymous mapping is zeroed, so every scene is pending */
+            batch->next = batch->shared;
+            batch->state = batch->next + 1;
+            batch->owner = (pid_t *) (batch->state + batch->nscenes);
+        }
+    }
+
+    if (status != SUCCESS)
+        free_scene_list (batch);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_scene_timeout
+
+PURPOSE: Returns the deadline of each scene, from the ESPA_SCENE_TIMEOUT
+environment variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               No deadline
+other           Deadline of each scene (seconds)
+
+NOTES:
+  1. An invalid ESPA_SCENE_TIMEOUT is reported as a warning and ignored.
+******************************************************************************/
+static int get_scene_timeout (void)
+{
+    char FUNC_NAME[] = "get_scene_timeout";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *env = NULL;             /* value of the environment variable */
+    char *end = NULL;             /* end of the number in env */
+    long timeout;                 /* deadline (seconds) */
+
+    env = getenv ("ESPA_SCENE_TIMEOUT");
+    if (env == NULL || env[0] == '\0')
+        return (0);
+
+    timeout = strtol (env, &end, 10);
+    if (*end != '\0' || timeout < 0 || timeout > 0x7fffffffL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Ignoring the invalid "
+            "ESPA_SCENE_TIMEOUT %s", env);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (0);
+    }
+
+    return ((int) timeout);
+}
+
+
+/******************************************************************************
+MODULE:  report_scene_progress
+
+PURPOSE: Prints the progress of the routine processing the scene of the
+worker, each time it reaches another BATCH_PROGRESS_STEP percent.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void report_scene_progress
+(
+    Espa_progress_t *progress,  /* I/O: progress of the scene */
+    const char *routine,        /* I: name of the routine reporting */
+    double fraction             /* I: fraction of the routine's work done */
+)
+{
+    Batch_progress_t *last = progress->data;   /* progress last reported */
+    int percent;                /* percentage done, in whole steps */
+
+    percent = (int) (fraction * 100.0) / BATCH_PROGRESS_STEP
+        * BATCH_PROGRESS_STEP;
+    if (last->routine != NULL && strcmp (last->routine, routine) == 0 &&
+        percent == last->percent)
+        return;
+
+    last->routine = routine;
+    last->percent = percent;
+    printf ("  %s: %d%%\n", routine, percent);
+    fflush (stdout);
+}
+
+
+/******************************************************************************
+MODULE:  cancel_scene
+
+PURPOSE: Cancels the scene of the worker once it passes its deadline.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. This is the SIGALRM handler, so it only sets the cancel flag.
+******************************************************************************/
+static void cancel_scene
+(
+    int signum                  /* I: signal received */
+)
+{
+    scene_progress.cancel = 1;
+}
+
+
+/******************************************************************************
+MODULE:  run_batch_worker
+
+PURPOSE: Processes scenes of the batch until there are none left.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The output is flushed after each scene so the messages of the workers
+     aren't held in their buffers, and aren't lost if a worker dies.
+  2. The progress of each scene is installed while it's processed.  With a
+     deadline, an alarm cancels the scene once it passes the deadline; the
+     cancellation is cooperative, so a scene only stops the next time a
+     library routine checks for it.
+******************************************************************************/
+static void run_batch_worker
+(
+    Batch_t *batch,               /* I/O: scenes of the batch */
+    Espa_batch_func_t process_scene,  /* I: processes one scene */
+    void *arg                     /* I: passed to process_scene */
+)
+{
+    char FUNC_NAME[] = "run_batch_worker";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int scene;                    /* scene being processed */
+    int status;                   /* status of the scene */
+    Batch_progress_t last;        /* progress last reported for the scene */
+    int ticket;                   /* admission of the scene by the node
+                                     scheduler */
+    bool use_sched = espa_sched_enabled ();   /* are the scenes admitted by
+                                     a node scheduler? */
+    Espa_sched_class_t sched_class = ESPA_SCHED_IO;   /* class of the
+                                     scenes */
+    struct sigaction action;      /* SIGALRM action cancelling the scene */
+
+    if (use_sched)
+        sched_class = espa_sched_process_class ();
+    if (batch->timeout > 0)
+    {
+        memset (&action, 0, sizeof (action));
+        action.sa_handler = cancel_scene;
+        sigemptyset (&action.sa_mask);
+        sigaction (SIGALRM, &action, NULL);
+    }
+
+    while ((scene = __sync_fetch_and_add (batch->next, 1)) < batch->nscenes)
+    {
+        batch->owner[scene] = getpid ();
+        __sync_synchronize ();
+        batch->state[scene] = BATCH_RUNNING;
+
+        ticket = use_sched ? espa_sched_admit (sched_class, 0) : -1;
+        printf ("Processing scene %d of %d: %s\n", scene + 1,
+            batch->nscenes, batch->input[scene]);
+        fflush (stdout);
+
+        last.routine = NULL;
+        last.percent = 0;
+        scene_progress.report = report_scene_progress;
+        scene_progress.data = &last;
+        scene_progress.cancel = 0;
+        espa_set_progress (&scene_progress);
+        if (batch->timeout > 0)
+            alarm (batch->timeout);
+        status = process_scene (batch->input[scene], batch->output[scene],
+            arg);
+        alarm (0);
+        espa_set_progress (NULL);
+        espa_sched_leave (ticket);
+        if (scene_progress.cancel && status != SUCCESS)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Scene %s was cancelled after "
+                "its %d second deadline", batch->input[scene],
+                batch->timeout);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        fflush (stdout);
+        fflush (stderr);
+
+        batch->state[scene] = (status == SUCCESS) ? BATCH_DONE : BATCH_FAILED;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  start_batch_worker
+
+PURPOSE: Forks a worker process for the batch.
+
+RETURN VALUE:
+Type = pid_t
+Value           Description
+-----           -----------
+-1              Error forking the worker
+other           Process ID of the worker
+
+NOTES:
+  1. The worker exits with _exit once there are no scenes left, so the
+     parent's exit handlers and buffers aren't run or flushed twice.  The
+     worker writes its own profile, covering only its scenes.
+  2. The worker is pinned to the NUMA node of its slot, if NUMA placement
+     is on, before it starts any threads.
+******************************************************************************/
+static pid_t start_batch_worker
+(
+    Batch_t *batch,               /* I/O: scenes of the batch */
+    int slot,                     /* I: slot of the worker */
+    Espa_batch_func_t process_scene,  /* I: processes one scene */
+    void *arg                     /* I: passed to process_scene */
+)
+{
+    pid_t pid;                    /* process ID of the worker */
+
+    fflush (stdout);
+    fflush (stderr);
+    pid = fork ();
+    if (pid == 0)
+    {
+        espa_numa_bind_process (slot);
+        espa_profile_reset ();
+        run_batch_worker (batch, process_scene, arg);
+        espa_profile_report ();
+        fflush (stdout);
+        fflush (stderr);
+        _exit (EXIT_SUCCESS);
+    }
+
+    return (pid);
+}
+
+
+/******************************************************************************
+MODULE:  run_espa_batch
+
+PURPOSE: Processes each scene of the scene list, with up to nprocs scenes
+being processed concurrently.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the scene list, or at least one scene failed
+SUCCESS         Every scene was processed successfully
+
+NOTES:
+  1. The scenes which failed are listed once the batch is done, so they can
+     be resubmitted.
+  2. If no worker can be forked, the scenes are processed by the calling
+     process.
+  3. The workers share the memory budget, if one is set, so each worker's
+     budget is the budget divided by the number of workers.
+  4. The deadline of each scene is read from ESPA_SCENE_TIMEOUT (seconds)
+     before the workers are forked.
+******************************************************************************/
+int run_espa_batch
+(
+    char *scene_list,               /* I: name of the scene list file; "-"
+                                          for the standard input */
+    int nprocs,                     /* I: number of scenes processed
+                                          concurrently */
+    Espa_batch_func_t process_scene,/* I: processes one scene */
+    void *arg                       /* I: passed to process_scene */
+)
+{
+    char FUNC_NAME[] = "run_espa_batch";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Batch_t batch;                /* scenes of the batch */
+    pid_t pid;                    /* process ID of a worker */
+    pid_t slot_pid[ESPA_BATCH_MAX_PROCS];  /* worker in each slot; 0 if the
+                                     slot is free */
+    int wstatus;                  /* exit status of a worker */
+    int nworkers = 0;             /* number of running workers */
+    int nfailed = 0;              /* number of failed scenes */
+    int slot;                     /* slot of a worker */
+    int i;                        /* looping variable */
+
+    if (read_scene_list (scene_list, &batch) != SUCCESS)
+        return (ERROR);
+    if (nprocs < 1)
+        nprocs = 1;
+    if (nprocs > ESPA_BATCH_MAX_PROCS)
+        nprocs = ESPA_BATCH_MAX_PROCS;
+    if (nprocs > batch.nscenes)
+        nprocs = batch.nscenes;
+    espa_divide_memory_budget (nprocs);
+    batch.timeout = get_scene_timeout ();
+
+    memset (slot_pid, 0, sizeof (slot_pid));
+    for (slot = 0; slot < nprocs; slot++)
+    {
+        slot_pid[slot] = start_batch_worker (&batch, slot, process_scene,
+            arg);
+        if (slot_pid[slot] < 0)
+        {
+            slot_pid[slot] = 0;
+            break;
+        }
+        nworkers++;
+    }
+    if (nworkers == 0 && batch.nscenes > 0)
+    {
+        sprintf (errmsg, "Forking the batch workers; processing the scenes "
+            "in this process");
+        error_handler (false, FUNC_NAME, errmsg);
+        run_batch_worker (&batch, process_scene, arg);
+    }
+
+    /* Wait for the workers, replacing the ones which die while there are
+       scenes left */
+    while (nworkers > 0)
+    {
+        pid = wait (&wstatus);
+        if (pid < 0)
+            break;
+        nworkers--;
+
+        /* A worker only exits on its own once there are no scenes left, so
+           a scene it was still processing means it crashed or exited */
+        for (i = 0; i < batch.nscenes; i++)
+        {
+            if (batch.state[i] == BATCH_RUNNING && batch.owner[i] == pid)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Worker %ld died "
+                    "processing %s (status 0x%x)", (long) pid,
+                    batch.input[i], wstatus);
+                error_handler (true, FUNC_NAME, errmsg);
+                batch.state[i] = BATCH_FAILED;
+            }
+        }
+        /* Replace the worker in its own slot, so it keeps its NUMA node */
+        for (slot = 0; slot < nprocs && slot_pid[slot] != pid; slot++)
+            ;
+        if (slot == nprocs)
+            continue;
+        slot_pid[slot] = 0;
+        if (*batch.next < batch.nscenes)
+        {
+            slot_pid[slot] = start_batch_worker (&batch, slot, process_scene,
+                arg);
+            if (slot_pid[slot] < 0)
+                slot_pid[slot] = 0;
+            else
+                nworkers++;
+        }
+    }
+
+    /* Report the scenes which failed; any scene still pending or running
+       here lost its worker */
+    for (i = 0; i < batch.nscenes; i++)
+    {
+        if (batch.state[i] != BATCH_DONE)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Scene %s failed",
+                batch.input[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            nfailed++;
+        }
+    }
+    printf ("%d of %d scenes processed successfully\n",
+        batch.nscenes - nfailed, batch.nscenes);
+
+    free_scene_list (&batch);
+    return (nfailed == 0 ? SUCCESS : ERROR);
+}
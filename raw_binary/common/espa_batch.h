@@ -0,0 +1,53 @@
+/*****************************************************************************
+FILE: espa_batch.h
+
+PURPOSE: Contains defines and prototypes for running the raw binary tools on
+a list of scenes in a single process.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each line of a scene list is the input file of a scene, optionally
+     followed by the output file of the scene for the tools which take one.
+     Blank lines and lines starting with # are ignored.
+  2. Each scene may be given a deadline, in seconds, with the
+     ESPA_SCENE_TIMEOUT environment variable.  A scene passing its deadline
+     is cancelled through espa_progress.h and reported as failed.
+*****************************************************************************/
+
+#ifndef ESPA_BATCH_H_
+#define ESPA_BATCH_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "espa_common.h"
+
+/* Defines */
+/* Maximum number of scenes processed concurrently */
+#define ESPA_BATCH_MAX_PROCS 64
+
+/* Processes one scene of the batch; returns SUCCESS or ERROR */
+typedef int (*Espa_batch_func_t)
+(
+    char *input,      /* I: input file of the scene */
+    char *output,     /* I: output file of the scene; NULL if the scene list
+                            doesn't give one */
+    void *arg         /* I: options of the tool */
+);
+
+/* Prototypes */
+int run_espa_batch
+(
+    char *scene_list,               /* I: name of the scene list file; "-"
+                                          for the standard input */
+    int nprocs,                     /* I: number of scenes processed
+                                          concurrently */
+    Espa_batch_func_t process_scene,/* I: processes one scene */
+    void *arg                       /* I: passed to process_scene */
+);
+
+#endif
@@ -0,0 +1,333 @@
+/*****************************************************************************
+FILE: espa_checkpoint.c
+
+PURPOSE: Contains functions for reading and writing the checkpoint files of
+the long-running stages.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_checkpoint.h for when checkpoints are written and loaded.
+*****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "error_handler.h"
+#include "espa_checkpoint.h"
+
+/* Header of a checkpoint file, followed by the record */
+typedef struct
+{
+    char magic[8];              /* ESPA_CHECKPOINT_MAGIC */
+    uint32_t version;           /* ESPA_CHECKPOINT_VERSION */
+    uint32_t reserved;          /* 0 */
+    uint64_t size;              /* size of the record (bytes) */
+    char stage[ESPA_CHECKPOINT_STAGE_SIZE];  /* stage writing the output */
+} Checkpoint_header_t;
+
+/* Checkpoint interval (seconds) read from the environment; -1 if
+   checkpointing is off, -2 if the environment hasn't been read yet */
+static int checkpoint_interval = -2;
+
+
+/******************************************************************************
+MODULE:  espa_checkpoint_interval
+
+PURPOSE:  Returns the least number of seconds between the checkpoints of an
+output file, reading the ESPA_CHECKPOINT_INTERVAL environment variable the
+first time it is called.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Checkpointing is off
+other           Least number of seconds between checkpoints
+
+NOTES:
+  1. An invalid ESPA_CHECKPOINT_INTERVAL is reported as a warning and
+     ignored.
+******************************************************************************/
+int espa_checkpoint_interval (void)
+{
+    char FUNC_NAME[] = "espa_checkpoint_interval";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char *env = NULL;           /* value of the environment variable */
+    char *end = NULL;           /* end of the number in env */
+    long interval;              /* interval (seconds) */
+
+    if (checkpoint_interval == -2)
+    {
+        checkpoint_interval = -1;
+        env = getenv ("ESPA_CHECKPOINT_INTERVAL");
+        if (env != NULL && env[0] != '\0')
+        {
+            interval = strtol (env, &end, 10);
+            if (*end != '\0' || interval < 0 || interval > 0x7fffffffL)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Ignoring the invalid "
+                    "ESPA_CHECKPOINT_INTERVAL %s", env);
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+            else
+                checkpoint_interval = (int) interval;
+        }
+    }
+
+    return (checkpoint_interval);
+}
+
+
+/******************************************************************************
+MODULE:  espa_init_checkpoint
+
+PURPOSE:  Sets up the checkpoint of an output file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The checkpoint or stage name is too long
+SUCCESS         Successfully set up the checkpoint
+
+NOTES:
+  1. Nothing is read or written; see espa_load_checkpoint and
+     espa_save_checkpoint.
+******************************************************************************/
+int espa_init_checkpoint
+(
+    const char *output_file,    /* I: name of the output file */
+    const char *stage,          /* I: name of the stage writing the output */
+    Espa_checkpoint_t *ckpt     /* O: checkpoint of the output file */
+)
+{
+    char FUNC_NAME[] = "espa_init_checkpoint";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int count;                  /* number of chars copied in snprintf */
+
+    memset (ckpt, 0, sizeof (Espa_checkpoint_t));
+    count = snprintf (ckpt->file_name, sizeof (ckpt->file_name), "%s%s",
+        output_file, ESPA_CHECKPOINT_EXT);
+    if (count < 0 || count >= sizeof (ckpt->file_name))
+    {
+        sprintf (errmsg, "Overflow of the checkpoint filename of %s",
+            output_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (ckpt->stage, sizeof (ckpt->stage), "%s", stage);
+    if (count < 0 || count >= sizeof (ckpt->stage))
+    {
+        sprintf (errmsg, "Overflow of the checkpoint stage name %s", stage);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_checkpoint_due
+
+PURPOSE:  Returns whether the next checkpoint of an output file is due.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           Checkpointing is off, or the interval hasn't passed since the
+                last checkpoint
+true            A checkpoint should be saved
+
+NOTES:
+  1. Stages call this before gathering their record, so the work of making
+     the output durable is only done once per interval.
+******************************************************************************/
+bool espa_checkpoint_due
+(
+    const Espa_checkpoint_t *ckpt  /* I: checkpoint of the output file */
+)
+{
+    int interval = espa_checkpoint_interval ();   /* seconds between saves */
+
+    if (interval < 0)
+        return (false);
+
+    return (ckpt->last_save == 0 ||
+        difftime (time (NULL), ckpt->last_save) >= interval);
+}
+
+
+/******************************************************************************
+MODULE:  espa_load_checkpoint
+
+PURPOSE:  Reads the record of the checkpoint of an output file.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           There is no usable checkpoint; record is unchanged
+true            The record was read from the checkpoint
+
+NOTES:
+  1. A checkpoint which can't be read, or was written by another stage or
+     with a record of another size, is reported as a warning and ignored.
+******************************************************************************/
+bool espa_load_checkpoint
+(
+    Espa_checkpoint_t *ckpt,    /* I: checkpoint of the output file */
+    void *record,               /* O: record of the stage's progress */
+    size_t size                 /* I: size of the record (bytes) */
+)
+{
+    char FUNC_NAME[] = "espa_load_checkpoint";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    FILE *fp = NULL;            /* checkpoint file */
+    Checkpoint_header_t header; /* header of the checkpoint */
+    void *buf = NULL;           /* record read from the checkpoint */
+    bool loaded = false;        /* was the record read? */
+
+    fp = fopen (ckpt->file_name, "rb");
+    if (fp == NULL)
+        return (false);
+
+    buf = malloc (size > 0 ? size : 1);
+    if (buf != NULL &&
+        fread (&header, sizeof (header), 1, fp) == 1 &&
+        !memcmp (header.magic, ESPA_CHECKPOINT_MAGIC, sizeof (header.magic))
+        && header.version == ESPA_CHECKPOINT_VERSION &&
+        header.size == size &&
+        !strncmp (header.stage, ckpt->stage, sizeof (header.stage)) &&
+        fread (buf, 1, size, fp) == size)
+    {
+        memcpy (record, buf, size);
+        loaded = true;
+    }
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Ignoring the checkpoint %s, "
+            "which doesn't match %s", ckpt->file_name, ckpt->stage);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    free (buf);
+    fclose (fp);
+    return (loaded);
+}
+
+
+/******************************************************************************
+MODULE:  espa_save_checkpoint
+
+PURPOSE:  Writes the record of the checkpoint of an output file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the checkpoint
+SUCCESS         Successfully wrote the checkpoint
+
+NOTES:
+  1. The checkpoint is written to a temporary file, synced and renamed over
+     the previous one, so the checkpoint file is always complete.  The
+     output the record describes must already be durable.
+  2. The checkpoint is written whether or not it's due; see
+     espa_checkpoint_due.
+******************************************************************************/
+int espa_save_checkpoint
+(
+    Espa_checkpoint_t *ckpt,    /* I/O: checkpoint of the output file */
+    const void *record,         /* I: record of the stage's progress */
+    size_t size                 /* I: size of the record (bytes) */
+)
+{
+    char FUNC_NAME[] = "espa_save_checkpoint";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmp_file[STR_SIZE];    /* temporary checkpoint file */
+    int count;                  /* number of chars copied in snprintf */
+    FILE *fp = NULL;            /* temporary checkpoint file */
+    Checkpoint_header_t header; /* header of the checkpoint */
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.tmp",
+        ckpt->file_name);
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of the temporary checkpoint filename");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, ESPA_CHECKPOINT_MAGIC, sizeof (header.magic));
+    header.version = ESPA_CHECKPOINT_VERSION;
+    header.size = size;
+    strcpy (header.stage, ckpt->stage);
+
+    fp = fopen (tmp_file, "wb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Creating the checkpoint file %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (fwrite (&header, sizeof (header), 1, fp) != 1 ||
+        fwrite (record, 1, size, fp) != size || fflush (fp) != 0 ||
+        fsync (fileno (fp)) != 0)
+    {
+        sprintf (errmsg, "Writing the checkpoint file %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (fp);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    if (fclose (fp) != 0 || rename (tmp_file, ckpt->file_name) != 0)
+    {
+        sprintf (errmsg, "Replacing the checkpoint file %s",
+            ckpt->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    ckpt->last_save = time (NULL);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_remove_checkpoint
+
+PURPOSE:  Removes the checkpoint of an output file, once the output it
+belongs to is complete.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A missing checkpoint isn't an error.
+******************************************************************************/
+void espa_remove_checkpoint
+(
+    const char *output_file     /* I: name of the output file */
+)
+{
+    char ckpt_file[STR_SIZE];   /* checkpoint file */
+    int count;                  /* number of chars copied in snprintf */
+
+    count = snprintf (ckpt_file, sizeof (ckpt_file), "%s%s", output_file,
+        ESPA_CHECKPOINT_EXT);
+    if (count > 0 && count < sizeof (ckpt_file))
+        unlink (ckpt_file);
+}
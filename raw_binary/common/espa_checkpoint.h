@@ -0,0 +1,89 @@
+/*****************************************************************************
+FILE: espa_checkpoint.h
+
+PURPOSE: Contains the defines, structures and prototypes for the checkpoint
+files which let a long-running stage resume after a failure instead of
+starting over.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Checkpointing is off unless the ESPA_CHECKPOINT_INTERVAL environment
+     variable is set, giving the least number of seconds between the
+     checkpoints of an output file (0 to write one after every block).
+  2. The checkpoint of an output file is kept in a sidecar file, the output
+     filename followed by ESPA_CHECKPOINT_EXT.  It holds the name of the
+     stage writing the file and a record of the stage's progress, which is
+     opaque to this library.  It's replaced atomically, so a failure while
+     writing it leaves the previous checkpoint.
+  3. A checkpoint is only loaded by the same stage with a record of the same
+     size, so a sidecar left by another stage or version is ignored.  The
+     stage should include whatever identifies its output (e.g. the band and
+     its size) in the stage name.
+*****************************************************************************/
+
+#ifndef ESPA_CHECKPOINT_H_
+#define ESPA_CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <time.h>
+#include "espa_common.h"
+
+/* Defines */
+/* Extension appended to the output filename for its checkpoint */
+#define ESPA_CHECKPOINT_EXT ".ckpt"
+
+/* Identifies a checkpoint file and its version */
+#define ESPA_CHECKPOINT_MAGIC "ESPACKPT"
+#define ESPA_CHECKPOINT_VERSION 1
+
+/* Maximum length of a stage name, including the terminator */
+#define ESPA_CHECKPOINT_STAGE_SIZE 256
+
+/* Checkpoint of an output file */
+typedef struct
+{
+    char file_name[STR_SIZE];   /* name of the checkpoint file */
+    char stage[ESPA_CHECKPOINT_STAGE_SIZE];  /* stage writing the output */
+    time_t last_save;           /* time of the last checkpoint saved; 0 if
+                                   none */
+} Espa_checkpoint_t;
+
+/* Prototypes */
+int espa_checkpoint_interval (void);
+
+int espa_init_checkpoint
+(
+    const char *output_file,    /* I: name of the output file */
+    const char *stage,          /* I: name of the stage writing the output */
+    Espa_checkpoint_t *ckpt     /* O: checkpoint of the output file */
+);
+
+bool espa_checkpoint_due
+(
+    const Espa_checkpoint_t *ckpt  /* I: checkpoint of the output file */
+);
+
+bool espa_load_checkpoint
+(
+    Espa_checkpoint_t *ckpt,    /* I: checkpoint of the output file */
+    void *record,               /* O: record of the stage's progress */
+    size_t size                 /* I: size of the record (bytes) */
+);
+
+int espa_save_checkpoint
+(
+    Espa_checkpoint_t *ckpt,    /* I/O: checkpoint of the output file */
+    const void *record,         /* I: record of the stage's progress */
+    size_t size                 /* I: size of the record (bytes) */
+);
+
+void espa_remove_checkpoint
+(
+    const char *output_file     /* I: name of the output file */
+);
+
+#endif
@@ -0,0 +1,455 @@
+/*****************************************************************************
+FILE: espa_io_limit.c
+
+PURPOSE: Contains functions for limiting the rate of the reads and writes of
+a job with token buckets, and for setting the I/O priority of its class.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A transfer takes its bytes from the bucket up front, and the bucket may
+     go negative.  The caller then sleeps for the time the bucket needs to
+     come back to zero, outside the lock, so concurrent threads queue up
+     behind each other's debt and the total rate is kept.
+  2. Until a limit is set, espa_io_throttle only checks a flag, so the
+     unlimited case costs nothing measurable.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "error_handler.h"
+#include "espa_io_limit.h"
+
+/* Kernel I/O priority classes and values (see ioprio_set(2)) */
+#define IO_PRIO_WHO_PROCESS 1
+#define IO_PRIO_CLASS_SHIFT 13
+#define IO_PRIO_CLASS_BE 2
+#define IO_PRIO_CLASS_IDLE 3
+#define IO_PRIO_BE_DEFAULT 4
+
+/* Token bucket of one direction */
+typedef struct
+{
+    double rate;          /* bytes per second; 0 if not limited */
+    double tokens;        /* bytes which may be transferred without waiting;
+                             negative once transfers have to wait */
+    double last;          /* time the bucket was last refilled (s) */
+} Io_bucket_t;
+
+static Io_bucket_t io_bucket[2];
+static bool io_active = false;   /* is either direction limited? */
+static Espa_io_class_t io_job_class = ESPA_IO_NORMAL;  /* class of the job */
+static double io_job_rate[2] = {0.0, 0.0};  /* rates of the job (MB/s),
+                                    before the share of the class */
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t io_once = PTHREAD_ONCE_INIT;
+
+/******************************************************************************
+MODULE:  get_io_time
+
+PURPOSE:  Returns the time of the monotonic clock.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+> 0             Time in seconds
+
+NOTES:
+******************************************************************************/
+static double get_io_time (void)
+{
+    struct timespec ts;       /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((double) ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+
+/******************************************************************************
+MODULE:  set_io_priority
+
+PURPOSE:  Sets the kernel I/O priority of the calling thread for a priority
+class.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Failures are ignored, since the rates still apply.  Normal jobs get the
+     default best-effort priority back, in case an earlier job of the
+     process was a bulk one.
+******************************************************************************/
+static void set_io_priority
+(
+    Espa_io_class_t io_class  /* I: priority class */
+)
+{
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    int prio;                 /* kernel I/O priority */
+
+    if (io_class == ESPA_IO_BULK)
+        prio = IO_PRIO_CLASS_IDLE << IO_PRIO_CLASS_SHIFT;
+    else if (io_class == ESPA_IO_INTERACTIVE)
+        prio = IO_PRIO_CLASS_BE << IO_PRIO_CLASS_SHIFT;
+    else
+        prio = (IO_PRIO_CLASS_BE << IO_PRIO_CLASS_SHIFT) | IO_PRIO_BE_DEFAULT;
+
+    syscall (SYS_ioprio_set, IO_PRIO_WHO_PROCESS, 0, prio);
+#else
+    (void) io_class;
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  apply_io_limit
+
+PURPOSE:  Sets the token buckets and I/O priority of a priority class and the
+rates of a job.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void apply_io_limit
+(
+    Espa_io_class_t io_class, /* I: priority class of the job */
+    double read_rate,         /* I: read rate of the job (MB/s) */
+    double write_rate         /* I: write rate of the job (MB/s) */
+)
+{
+    double rate[2];           /* rate of each direction (bytes/s) */
+    double now = get_io_time ();  /* current time */
+    int i;                    /* looping variable for the directions */
+
+    rate[ESPA_IO_READ] = read_rate * 1e6;
+    rate[ESPA_IO_WRITE] = write_rate * 1e6;
+
+    pthread_mutex_lock (&io_lock);
+    io_job_class = io_class;
+    io_job_rate[ESPA_IO_READ] = read_rate;
+    io_job_rate[ESPA_IO_WRITE] = write_rate;
+    for (i = 0; i < 2; i++)
+    {
+        if (io_class == ESPA_IO_INTERACTIVE)
+            rate[i] = 0.0;
+        else if (io_class == ESPA_IO_BULK)
+            rate[i] /= ESPA_IO_BULK_SHARE;
+        io_bucket[i].rate = rate[i];
+        io_bucket[i].tokens = rate[i] * ESPA_IO_BURST;
+        io_bucket[i].last = now;
+    }
+    __atomic_store_n (&io_active, io_bucket[0].rate > 0.0 ||
+        io_bucket[1].rate > 0.0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock (&io_lock);
+
+    set_io_priority (io_class);
+}
+
+
+/******************************************************************************
+MODULE:  read_io_env
+
+PURPOSE:  Reads the priority class and rates from the ESPA_IO_CLASS and
+ESPA_IO_RATE environment variables.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A variable isn't valid; the transfers aren't limited
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+static int read_io_env
+(
+    Espa_io_class_t *io_class, /* O: priority class */
+    double *read_rate,         /* O: read rate (MB/s); 0 if not limited */
+    double *write_rate         /* O: write rate (MB/s); 0 if not limited */
+)
+{
+    char FUNC_NAME[] = "read_io_env";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *env = NULL;         /* value of the environment variable */
+    char *end = NULL;         /* end of a rate */
+
+    *io_class = ESPA_IO_NORMAL;
+    *read_rate = 0.0;
+    *write_rate = 0.0;
+
+    env = getenv ("ESPA_IO_CLASS");
+    if (env != NULL && *env != '\0' &&
+        espa_io_parse_class (env, io_class) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown ESPA_IO_CLASS %s; the "
+            "I/O isn't limited", env);
+        error_handler (false, FUNC_NAME, errmsg);
+        *io_class = ESPA_IO_NORMAL;
+        return (ERROR);
+    }
+
+    env = getenv ("ESPA_IO_RATE");
+    if (env == NULL || *env == '\0')
+        return (SUCCESS);
+
+    *read_rate = strtod (env, &end);
+    *write_rate = *read_rate;
+    if (end != env && *end == ',')
+    {
+        env = end + 1;
+        *write_rate = strtod (env, &end);
+    }
+    if (end == env || *end != '\0' || *read_rate < 0.0 || *write_rate < 0.0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid ESPA_IO_RATE %s; the "
+            "I/O isn't limited", getenv ("ESPA_IO_RATE"));
+        error_handler (false, FUNC_NAME, errmsg);
+        *read_rate = 0.0;
+        *write_rate = 0.0;
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_io_limit
+
+PURPOSE:  Sets the limits from the environment the first time they're
+needed.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void init_io_limit (void)
+{
+    Espa_io_class_t io_class; /* priority class */
+    double read_rate;         /* read rate (MB/s) */
+    double write_rate;        /* write rate (MB/s) */
+
+    read_io_env (&io_class, &read_rate, &write_rate);
+    if (io_class != ESPA_IO_NORMAL || read_rate > 0.0 || write_rate > 0.0)
+        apply_io_limit (io_class, read_rate, write_rate);
+}
+
+
+/******************************************************************************
+MODULE:  espa_io_parse_class
+
+PURPOSE:  Converts the name of a priority class.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown class
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+int espa_io_parse_class
+(
+    const char *name,         /* I: interactive, normal or bulk */
+    Espa_io_class_t *io_class /* O: priority class */
+)
+{
+    if (!strcmp (name, "interactive"))
+        *io_class = ESPA_IO_INTERACTIVE;
+    else if (!strcmp (name, "normal"))
+        *io_class = ESPA_IO_NORMAL;
+    else if (!strcmp (name, "bulk"))
+        *io_class = ESPA_IO_BULK;
+    else
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_io_set_limit
+
+PURPOSE:  Sets the priority class and rates of the job run next, in place
+of those of the environment.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A rate is negative
+SUCCESS         Successful completion
+
+NOTES:
+  1. The tokens left from the previous job are dropped.
+******************************************************************************/
+int espa_io_set_limit
+(
+    Espa_io_class_t io_class, /* I: priority class of the job */
+    double read_rate,         /* I: read rate of the job (MB/s); 0 for no
+                                    limit */
+    double write_rate         /* I: write rate of the job (MB/s); 0 for no
+                                    limit */
+)
+{
+    char FUNC_NAME[] = "espa_io_set_limit";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (read_rate < 0.0 || write_rate < 0.0)
+    {
+        sprintf (errmsg, "The I/O rates can't be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    pthread_once (&io_once, init_io_limit);
+    apply_io_limit (io_class, read_rate, write_rate);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_io_reset_limit
+
+PURPOSE:  Sets the priority class and rates back to those of the
+environment.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A variable isn't valid; the transfers aren't limited
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+int espa_io_reset_limit (void)
+{
+    Espa_io_class_t io_class; /* priority class */
+    double read_rate;         /* read rate (MB/s) */
+    double write_rate;        /* write rate (MB/s) */
+    int status;               /* return status */
+
+    pthread_once (&io_once, init_io_limit);
+    status = read_io_env (&io_class, &read_rate, &write_rate);
+    apply_io_limit (io_class, read_rate, write_rate);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  espa_io_get_limit
+
+PURPOSE:  Gets the priority class and rates of the job, as given to
+espa_io_set_limit or by the environment.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_io_get_limit
+(
+    Espa_io_class_t *io_class, /* O: priority class of the job */
+    double *read_rate,        /* O: read rate of the job (MB/s); 0 if not
+                                    limited */
+    double *write_rate        /* O: write rate of the job (MB/s); 0 if not
+                                    limited */
+)
+{
+    pthread_once (&io_once, init_io_limit);
+    pthread_mutex_lock (&io_lock);
+    *io_class = io_job_class;
+    *read_rate = io_job_rate[ESPA_IO_READ];
+    *write_rate = io_job_rate[ESPA_IO_WRITE];
+    pthread_mutex_unlock (&io_lock);
+}
+
+
+/******************************************************************************
+MODULE:  espa_io_limited
+
+PURPOSE:  Determines whether the transfers of the job are limited.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The reads or the writes are limited
+false           Neither is limited
+
+NOTES:
+******************************************************************************/
+bool espa_io_limited (void)
+{
+    pthread_once (&io_once, init_io_limit);
+    return (__atomic_load_n (&io_active, __ATOMIC_ACQUIRE));
+}
+
+
+/******************************************************************************
+MODULE:  espa_io_throttle
+
+PURPOSE:  Waits until nbytes may be transferred at the rate of the job.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Called right before each read or write, with the number of bytes it
+     asks for.
+******************************************************************************/
+void espa_io_throttle
+(
+    Espa_io_dir_t dir,        /* I: direction of the transfer */
+    size_t nbytes             /* I: number of bytes to be transferred */
+)
+{
+    Io_bucket_t *bucket = &io_bucket[dir];  /* bucket of the direction */
+    double now;               /* current time */
+    double wait = 0.0;        /* seconds to wait */
+    struct timespec ts;       /* time left to sleep */
+
+    if (!espa_io_limited () || nbytes == 0)
+        return;
+
+    pthread_mutex_lock (&io_lock);
+    if (bucket->rate > 0.0)
+    {
+        /* Refill the bucket for the time since the last transfer */
+        now = get_io_time ();
+        bucket->tokens += (now - bucket->last) * bucket->rate;
+        if (bucket->tokens > bucket->rate * ESPA_IO_BURST)
+            bucket->tokens = bucket->rate * ESPA_IO_BURST;
+        bucket->last = now;
+
+        bucket->tokens -= (double) nbytes;
+        if (bucket->tokens < 0.0)
+            wait = -bucket->tokens / bucket->rate;
+    }
+    pthread_mutex_unlock (&io_lock);
+
+    if (wait <= 0.0)
+        return;
+
+    ts.tv_sec = (time_t) wait;
+    ts.tv_nsec = (long) ((wait - ts.tv_sec) * 1e9);
+    while (nanosleep (&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
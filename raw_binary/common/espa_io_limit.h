@@ -0,0 +1,98 @@
+/*****************************************************************************
+FILE: espa_io_limit.h
+
+PURPOSE: Contains the defines and prototypes for limiting the rate of the
+reads and writes of a job, so the large sequential jobs running on a node
+leave bandwidth of the shared storage to the latency-sensitive ones.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each job has a priority class.  Interactive jobs are never limited and
+     keep the best-effort I/O priority of the kernel.  Normal jobs are
+     limited to the read and write rates of the job.  Bulk jobs are limited
+     to 1/ESPA_IO_BULK_SHARE of those rates and get the idle I/O priority,
+     so local disks serve them only when no one else is waiting.
+  2. Each rate is a token bucket refilled at the rate and holding up to
+     ESPA_IO_BURST seconds of transfers.  A read or write larger than the
+     tokens left waits until the bucket has refilled, so the rate is kept
+     over any span longer than the burst.  The buckets are shared by the
+     threads of the process.
+  3. The class and rates come from the ESPA_IO_CLASS (interactive, normal or
+     bulk) and ESPA_IO_RATE environment variables.  ESPA_IO_RATE is the read
+     and write rates in MB/s, such as "200,100", or a single rate for both;
+     without it, or with a rate of 0, the transfers aren't limited.  A
+     process running several jobs, such as espa_worker, sets them for each
+     job with espa_io_set_limit.
+  4. The kernel I/O priority is set for the calling thread, and is inherited
+     by the threads it starts afterwards.  It only affects the I/O
+     schedulers of local disks; the rates also hold on NFS.
+*****************************************************************************/
+
+#ifndef ESPA_IO_LIMIT_H_
+#define ESPA_IO_LIMIT_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Defines */
+/* Bulk jobs get this fraction of the rates of the job */
+#define ESPA_IO_BULK_SHARE 4
+
+/* Seconds of transfers a token bucket holds, so short bursts don't wait */
+#define ESPA_IO_BURST 0.25
+
+/* Priority class of a job */
+typedef enum
+{
+    ESPA_IO_INTERACTIVE,  /* never limited */
+    ESPA_IO_NORMAL,       /* limited to the rates of the job */
+    ESPA_IO_BULK          /* limited to a share of the rates, idle priority */
+} Espa_io_class_t;
+
+/* Direction of a transfer */
+typedef enum
+{
+    ESPA_IO_READ,
+    ESPA_IO_WRITE
+} Espa_io_dir_t;
+
+/* Prototypes */
+int espa_io_parse_class
+(
+    const char *name,         /* I: interactive, normal or bulk */
+    Espa_io_class_t *io_class /* O: priority class */
+);
+
+int espa_io_set_limit
+(
+    Espa_io_class_t io_class, /* I: priority class of the job */
+    double read_rate,         /* I: read rate of the job (MB/s); 0 for no
+                                    limit */
+    double write_rate         /* I: write rate of the job (MB/s); 0 for no
+                                    limit */
+);
+
+int espa_io_reset_limit (void);
+
+void espa_io_get_limit
+(
+    Espa_io_class_t *io_class, /* O: priority class of the job */
+    double *read_rate,        /* O: read rate of the job (MB/s); 0 if not
+                                    limited */
+    double *write_rate        /* O: write rate of the job (MB/s); 0 if not
+                                    limited */
+);
+
+bool espa_io_limited (void);
+
+void espa_io_throttle
+(
+    Espa_io_dir_t dir,        /* I: direction of the transfer */
+    size_t nbytes             /* I: number of bytes to be transferred */
+);
+
+#endif
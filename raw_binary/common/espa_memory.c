@@ -0,0 +1,333 @@
+/*****************************************************************************
+FILE: espa_memory.c
+
+PURPOSE: Contains functions for the memory budget of a process, which the
+library routines size their line blocks and threads to fit, so the peak
+memory of a job is bounded and predictable.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The memory available to a routine is the budget less the current RSS
+     of the process, so the metadata, polygons and other buffers already
+     held are accounted for without each routine tracking them.
+  2. A routine always gets at least one line and one thread, so a budget
+     which is too small slows it down rather than failing it.
+*****************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "error_handler.h"
+#include "espa_memory.h"
+
+/* Budget state: -1 until the environment is read, then 0 (no budget) or 1 */
+static int budget_state = -1;
+
+/* Memory budget of the process (bytes) */
+static size_t budget_bytes = 0;
+
+/******************************************************************************
+MODULE:  espa_parse_memory_size
+
+PURPOSE:  Converts a memory size, in bytes with an optional K, M, G or T
+suffix, to a number of bytes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The size isn't a valid number with an optional suffix
+SUCCESS         Successful completion
+
+NOTES:
+  1. The suffixes are powers of 1024 and may be lower case, optionally
+     followed by B (e.g. 512M, 512MB or 512m).
+******************************************************************************/
+int espa_parse_memory_size
+(
+    const char *value,    /* I: size with an optional K, M, G or T suffix */
+    size_t *nbytes        /* O: size in bytes */
+)
+{
+    char *end = NULL;           /* end of the number */
+    unsigned long long size;    /* size before the suffix is applied */
+    int shift = 0;              /* power of 2 of the suffix */
+
+    if (value == NULL || !isdigit ((unsigned char) value[0]))
+        return (ERROR);
+
+    errno = 0;
+    size = strtoull (value, &end, 10);
+    if (errno != 0)
+        return (ERROR);
+
+    switch (toupper ((unsigned char) *end))
+    {
+        case 'K':
+            shift = 10;
+            break;
+        case 'M':
+            shift = 20;
+            break;
+        case 'G':
+            shift = 30;
+            break;
+        case 'T':
+            shift = 40;
+            break;
+        case '\0':
+            break;
+        default:
+            return (ERROR);
+    }
+    if (shift > 0)
+    {
+        end++;
+        if (toupper ((unsigned char) *end) == 'B')
+            end++;
+    }
+    if (*end != '\0' || size > ((size_t) -1 >> shift))
+        return (ERROR);
+
+    *nbytes = (size_t) size << shift;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_set_memory_budget
+
+PURPOSE:  Sets the memory budget of the process, overriding the
+ESPA_MAX_MEMORY environment variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The budget isn't a valid memory size
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+int espa_set_memory_budget
+(
+    const char *value     /* I: budget with an optional K, M, G or T
+                                suffix; 0 for no budget */
+)
+{
+    char FUNC_NAME[] = "espa_set_memory_budget";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    size_t nbytes;              /* budget in bytes */
+
+    if (espa_parse_memory_size (value, &nbytes) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid memory budget %s; "
+            "expected a number of bytes with an optional K, M, G or T "
+            "suffix", value);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    budget_bytes = nbytes;
+    budget_state = (nbytes > 0) ? 1 : 0;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_memory_budget
+
+PURPOSE:  Returns the memory budget of the process, reading the
+ESPA_MAX_MEMORY environment variable the first time it is called unless the
+budget was already set.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+0               No budget
+other           Memory budget (bytes)
+
+NOTES:
+  1. An invalid ESPA_MAX_MEMORY is reported as a warning and ignored.
+******************************************************************************/
+size_t espa_memory_budget (void)
+{
+    char FUNC_NAME[] = "espa_memory_budget";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char *env = NULL;           /* value of the environment variable */
+
+    if (budget_state == -1)
+    {
+        budget_state = 0;
+        env = getenv ("ESPA_MAX_MEMORY");
+        if (env != NULL && env[0] != '\0')
+        {
+            if (espa_parse_memory_size (env, &budget_bytes) != SUCCESS)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Ignoring the invalid "
+                    "ESPA_MAX_MEMORY %s", env);
+                error_handler (false, FUNC_NAME, errmsg);
+                budget_bytes = 0;
+            }
+            budget_state = (budget_bytes > 0) ? 1 : 0;
+        }
+    }
+
+    return (budget_state == 1 ? budget_bytes : 0);
+}
+
+
+/******************************************************************************
+MODULE:  espa_divide_memory_budget
+
+PURPOSE:  Divides the memory budget between the processes sharing it, such
+as the workers of a scene list, so together they stay within the budget.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. It's called before the processes are forked, so they inherit their
+     share.
+******************************************************************************/
+void espa_divide_memory_budget
+(
+    int nshares           /* I: number of processes sharing the budget */
+)
+{
+    if (nshares > 1 && espa_memory_budget () > 0)
+        budget_bytes /= nshares;
+}
+
+
+/******************************************************************************
+MODULE:  get_rss_bytes
+
+PURPOSE:  Returns the current resident set size of the process.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+0               The RSS couldn't be read
+other           RSS (bytes)
+
+NOTES:
+******************************************************************************/
+static size_t get_rss_bytes (void)
+{
+    FILE *fp = NULL;            /* statm file */
+    unsigned long npages;       /* total program size (pages) */
+    unsigned long nresident = 0;  /* resident pages */
+
+    fp = fopen ("/proc/self/statm", "r");
+    if (fp == NULL)
+        return (0);
+    if (fscanf (fp, "%lu %lu", &npages, &nresident) != 2)
+        nresident = 0;
+    fclose (fp);
+
+    return ((size_t) nresident * sysconf (_SC_PAGESIZE));
+}
+
+
+/******************************************************************************
+MODULE:  espa_memory_available
+
+PURPOSE:  Returns the memory a routine may use within the budget.
+
+RETURN VALUE:
+Type = size_t
+Value           Description
+-----           -----------
+(size_t) -1     No budget
+other           Budget less the current RSS (bytes); 0 if the RSS is
+                already over the budget
+
+NOTES:
+******************************************************************************/
+size_t espa_memory_available (void)
+{
+    size_t budget = espa_memory_budget ();  /* memory budget */
+    size_t rss;                             /* current RSS */
+
+    if (budget == 0)
+        return ((size_t) -1);
+
+    rss = get_rss_bytes ();
+    return (rss < budget ? budget - rss : 0);
+}
+
+
+/******************************************************************************
+MODULE:  espa_budget_lines
+
+PURPOSE:  Returns the number of lines of a block which fit in the memory
+budget.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+1 - max_lines   Number of lines in a block
+
+NOTES:
+  1. Without a budget it's max_lines.
+******************************************************************************/
+int espa_budget_lines
+(
+    size_t line_bytes,    /* I: bytes needed for each line of the block */
+    size_t fixed_bytes,   /* I: bytes needed regardless of the block size */
+    int max_lines         /* I: default (largest) number of lines */
+)
+{
+    size_t available = espa_memory_available ();  /* memory for the block */
+    size_t nlines;              /* lines fitting in the available memory */
+
+    if (max_lines < 1)
+        return (1);
+    if (available == (size_t) -1 || line_bytes == 0)
+        return (max_lines);
+
+    available = (available > fixed_bytes) ? available - fixed_bytes : 0;
+    nlines = available / line_bytes;
+    if (nlines < 1)
+        return (1);
+    if (nlines > (size_t) max_lines)
+        return (max_lines);
+    return ((int) nlines);
+}
+
+
+/******************************************************************************
+MODULE:  espa_budget_threads
+
+PURPOSE:  Returns the number of threads whose buffers fit in the memory
+budget.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+1 - max_threads Number of threads
+
+NOTES:
+  1. Without a budget it's max_threads.
+******************************************************************************/
+int espa_budget_threads
+(
+    size_t thread_bytes,  /* I: bytes needed by each thread */
+    size_t fixed_bytes,   /* I: bytes needed regardless of the threads */
+    int max_threads       /* I: requested (largest) number of threads */
+)
+{
+    /* The threads are budgeted the same way as the lines of a block */
+    return (espa_budget_lines (thread_bytes, fixed_bytes, max_threads));
+}
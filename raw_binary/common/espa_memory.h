@@ -0,0 +1,64 @@
+/*****************************************************************************
+FILE: espa_memory.h
+
+PURPOSE: Contains the prototypes for the memory budget, which the library
+routines size their line blocks and threads to fit.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The budget is the largest resident set size (RSS) a process should
+     reach.  It is set by the --max_memory option of the tools, or the
+     ESPA_MAX_MEMORY environment variable, as a number of bytes with an
+     optional K, M, G or T suffix (powers of 1024), e.g. 512M or 2G.
+  2. Without a budget the routines use their default block sizes and thread
+     counts.  The budget only ever makes them smaller.
+  3. The budget is read and set by the main thread, before the routines
+     start any threads.
+*****************************************************************************/
+
+#ifndef ESPA_MEMORY_H_
+#define ESPA_MEMORY_H_
+
+#include <stdlib.h>
+
+/* Prototypes */
+int espa_parse_memory_size
+(
+    const char *value,    /* I: size with an optional K, M, G or T suffix */
+    size_t *nbytes        /* O: size in bytes */
+);
+
+int espa_set_memory_budget
+(
+    const char *value     /* I: budget with an optional K, M, G or T
+                                suffix; 0 for no budget */
+);
+
+size_t espa_memory_budget (void);
+
+void espa_divide_memory_budget
+(
+    int nshares           /* I: number of processes sharing the budget */
+);
+
+size_t espa_memory_available (void);
+
+int espa_budget_lines
+(
+    size_t line_bytes,    /* I: bytes needed for each line of the block */
+    size_t fixed_bytes,   /* I: bytes needed regardless of the block size */
+    int max_lines         /* I: default (largest) number of lines */
+);
+
+int espa_budget_threads
+(
+    size_t thread_bytes,  /* I: bytes needed by each thread */
+    size_t fixed_bytes,   /* I: bytes needed regardless of the threads */
+    int max_threads       /* I: requested (largest) number of threads */
+);
+
+#endif
@@ -0,0 +1,912 @@
+/*****************************************************************************
+FILE: espa_metrics.c
+
+PURPOSE: Contains functions for counting the live metrics of a daemon in
+shared memory and serving them in the Prometheus text format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The counters are updated with atomic operations, which work across the
+     processes sharing the mapping, so no lock is needed.  A stage's slot is
+     claimed the first time the stage is timed in any process, and its name
+     copied into the shared memory.
+  2. The metrics served are:
+       espa_stage_duration_seconds    histogram of the profiled stages
+       espa_io_bytes_total            raw binary bytes by backend and op
+       espa_io_calls_total            raw binary calls by backend and op
+       espa_cache_lookups_total       cache lookups by cache and result
+       espa_buffer_pool_bytes         buffer pool bytes in use and cached
+       espa_memory_budget_bytes       default memory budget of the jobs
+       espa_task_queue_depth          tasks queued in the task pools
+       espa_job_slots                 job slots of the daemon
+       espa_jobs_running              jobs running
+       espa_jobs_waiting              jobs waiting for a slot
+       espa_jobs_total                finished jobs by status
+       espa_job_duration_seconds      histogram of the job times
+       espa_metrics_start_time_seconds  time the metrics were started
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "error_handler.h"
+#include "espa_memory.h"
+#include "espa_metrics.h"
+
+/* Largest request read by the server */
+#define METRICS_REQUEST_SIZE 4096
+
+/* Time a connection to the server may take to send or receive (seconds) */
+#define METRICS_TIMEOUT 5
+
+/* Histogram of the times of a stage or of the jobs */
+typedef struct
+{
+    int state;                /* 0 if the slot is free, 1 while it is being
+                                 named, 2 once named */
+    char name[ESPA_METRICS_NAME_SIZE];  /* name of the stage */
+    unsigned long long bucket[ESPA_METRICS_NBUCKETS + 1];  /* number of
+                                 times in each bucket, not cumulative */
+    unsigned long long count; /* number of times */
+    unsigned long long sum_ns;  /* total of the times (nanoseconds) */
+} Metrics_histogram_t;
+
+/* Metrics in the shared memory */
+typedef struct
+{
+    Metrics_histogram_t stage[ESPA_PROFILE_MAX_STAGES];  /* stage times */
+    Metrics_histogram_t job;  /* job times */
+    unsigned long long io_bytes[ESPA_PROFILE_NBACKENDS][3];  /* bytes by
+                                 backend and Espa_profile_io_t */
+    unsigned long long io_calls[ESPA_PROFILE_NBACKENDS][3];  /* calls by
+                                 backend and Espa_profile_io_t */
+    unsigned long long cache_hits[ESPA_PROFILE_NCACHES];    /* cache hits */
+    unsigned long long cache_misses[ESPA_PROFILE_NCACHES];  /* cache misses */
+    long long gauge[ESPA_METRICS_MAX_SLOTS][ESPA_PROFILE_NGAUGES];  /* gauges
+                                 of each job slot */
+    unsigned long long jobs[2];  /* jobs which succeeded and failed */
+    int jobs_running;         /* number of jobs running */
+    int jobs_waiting;         /* number of jobs waiting for a slot */
+    int job_slots;            /* number of job slots */
+    long long start_time;     /* time the metrics were started (seconds
+                                 since the epoch) */
+} Metrics_shared_t;
+
+/* Shared metrics; NULL until espa_metrics_init */
+static Metrics_shared_t *metrics = NULL;
+
+/* Job slot of the process; -1 for the daemon itself */
+static int metrics_slot = -1;
+
+/* Metrics slot of each profiler stage: 0 if not looked up yet, the slot
+   plus one, or -1 if the slots are full */
+static int metrics_stage[ESPA_PROFILE_MAX_STAGES];
+
+/* Upper bounds of the histogram buckets */
+static const double metrics_bounds[ESPA_METRICS_NBUCKETS] =
+    ESPA_METRICS_BUCKETS;
+
+/* Names of the backends, kinds of I/O, caches and job statuses */
+static const char *metrics_backend_name[ESPA_PROFILE_NBACKENDS] =
+    {"stdio", "posix", "mmap", "async", "s3", "pipe"};
+static const char *metrics_io_name[3] = {"read", "write", "map"};
+static const char *metrics_cache_name[ESPA_PROFILE_NCACHES] =
+    {"schema", "metadata", "polygon", "ang", "derived", "transform"};
+
+/******************************************************************************
+MODULE:  espa_metrics_init
+
+PURPOSE:  Maps the shared memory of the metrics, turning the metrics on.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the shared memory
+SUCCESS         The metrics are on
+
+NOTES:
+  1. Must be called by the daemon before it starts the profiler (before
+     any library routine is called) and before it forks its jobs.
+******************************************************************************/
+int espa_metrics_init (void)
+{
+    char FUNC_NAME[] = "espa_metrics_init";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    void *map = NULL;       /* shared memory */
+
+    if (metrics != NULL)
+        return (SUCCESS);
+
+    map = mmap (NULL, sizeof (Metrics_shared_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Mapping the shared memory of the "
+            "metrics: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    metrics = map;
+    metrics->start_time = (long long) time (NULL);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_enabled
+
+PURPOSE:  Returns whether the metrics are on.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            espa_metrics_init was called
+false           The metrics are off
+
+NOTES:
+******************************************************************************/
+bool espa_metrics_enabled (void)
+{
+    return (metrics != NULL);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_set_slot
+
+PURPOSE:  Sets the job slot whose gauges the calling process updates.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Called by a job forked by the daemon.  The gauges of a process without
+     a slot aren't counted.
+******************************************************************************/
+void espa_metrics_set_slot
+(
+    int slot              /* I: job slot of the calling process */
+)
+{
+    if (slot >= 0 && slot < ESPA_METRICS_MAX_SLOTS)
+        metrics_slot = slot;
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_clear_slot
+
+PURPOSE:  Clears the gauges of a job slot once its job is done.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_clear_slot
+(
+    int slot              /* I: job slot whose gauges are cleared */
+)
+{
+    int i;                /* looping variable for the gauges */
+
+    if (metrics == NULL || slot < 0 || slot >= ESPA_METRICS_MAX_SLOTS)
+        return;
+
+    for (i = 0; i < ESPA_PROFILE_NGAUGES; i++)
+        __atomic_store_n (&metrics->gauge[slot][i], 0, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  observe_histogram
+
+PURPOSE:  Adds a time to a histogram.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void observe_histogram
+(
+    Metrics_histogram_t *hist,  /* I/O: histogram */
+    long long elapsed_ns        /* I: time (nanoseconds) */
+)
+{
+    double seconds = elapsed_ns * 1e-9;  /* time in seconds */
+    int b;                      /* bucket of the time */
+
+    for (b = 0; b < ESPA_METRICS_NBUCKETS; b++)
+    {
+        if (seconds <= metrics_bounds[b])
+            break;
+    }
+
+    __atomic_add_fetch (&hist->bucket[b], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&hist->sum_ns, elapsed_ns, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  find_metrics_stage
+
+PURPOSE:  Finds the metrics slot of a stage, claiming a free one the first
+time the stage is timed by any process.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The slots are taken by other stages
+other           Slot of the stage
+
+NOTES:
+******************************************************************************/
+static int find_metrics_stage
+(
+    const char *name      /* I: name of the stage */
+)
+{
+    Metrics_histogram_t *stage = NULL;  /* slot being checked */
+    int state;            /* state of the slot */
+    int i;                /* looping variable for the slots */
+
+    for (i = 0; i < ESPA_PROFILE_MAX_STAGES; i++)
+    {
+        stage = &metrics->stage[i];
+        state = __atomic_load_n (&stage->state, __ATOMIC_ACQUIRE);
+        if (state == 0 && __atomic_compare_exchange_n (&stage->state, &state,
+            1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            snprintf (stage->name, sizeof (stage->name), "%s", name);
+            __atomic_store_n (&stage->state, 2, __ATOMIC_RELEASE);
+            return (i);
+        }
+
+        /* Wait for another process naming the slot */
+        while (state == 1)
+            state = __atomic_load_n (&stage->state, __ATOMIC_ACQUIRE);
+        if (!strncmp (stage->name, name, sizeof (stage->name) - 1))
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_observe_stage
+
+PURPOSE:  Adds the time of a call of a profiled stage.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_observe_stage
+(
+    int stage,            /* I: index of the stage in the profiler */
+    const char *name,     /* I: name of the stage */
+    long long elapsed_ns  /* I: time of the call (nanoseconds) */
+)
+{
+    int slot;             /* metrics slot of the stage, plus one */
+
+    if (metrics == NULL || stage < 0 || stage >= ESPA_PROFILE_MAX_STAGES)
+        return;
+
+    slot = __atomic_load_n (&metrics_stage[stage], __ATOMIC_RELAXED);
+    if (slot == 0)
+    {
+        slot = find_metrics_stage (name) + 1;
+        if (slot == 0)
+            slot = -1;
+        __atomic_store_n (&metrics_stage[stage], slot, __ATOMIC_RELAXED);
+    }
+    if (slot > 0)
+        observe_histogram (&metrics->stage[slot - 1], elapsed_ns);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_count_io
+
+PURPOSE:  Counts a raw binary read, write or mapping.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_count_io
+(
+    Espa_profile_io_t kind,  /* I: kind of I/O */
+    Espa_profile_backend_t backend,  /* I: backend of the I/O */
+    size_t nbytes            /* I: number of bytes read, written or mapped */
+)
+{
+    if (metrics == NULL)
+        return;
+
+    __atomic_add_fetch (&metrics->io_bytes[backend][kind], nbytes,
+        __ATOMIC_RELAXED);
+    __atomic_add_fetch (&metrics->io_calls[backend][kind], 1,
+        __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_count_cache
+
+PURPOSE:  Counts a lookup of one of the caches of the libraries.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_count_cache
+(
+    Espa_profile_cache_t cache,  /* I: cache looked up */
+    bool hit                     /* I: was the entry found? */
+)
+{
+    if (metrics == NULL)
+        return;
+
+    if (hit)
+        __atomic_add_fetch (&metrics->cache_hits[cache], 1, __ATOMIC_RELAXED);
+    else
+        __atomic_add_fetch (&metrics->cache_misses[cache], 1,
+            __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_set_gauge
+
+PURPOSE:  Sets a gauge of the job slot of the calling process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_set_gauge
+(
+    Espa_profile_gauge_t gauge,  /* I: gauge to be set */
+    long long value              /* I: current value of the gauge */
+)
+{
+    if (metrics == NULL || metrics_slot < 0)
+        return;
+
+    __atomic_store_n (&metrics->gauge[metrics_slot][gauge], value,
+        __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_set_jobs
+
+PURPOSE:  Sets the job queue depths of the daemon.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_set_jobs
+(
+    int running,          /* I: number of jobs running */
+    int waiting,          /* I: number of jobs waiting for a slot */
+    int slots             /* I: number of job slots */
+)
+{
+    if (metrics == NULL)
+        return;
+
+    __atomic_store_n (&metrics->jobs_running, running, __ATOMIC_RELAXED);
+    __atomic_store_n (&metrics->jobs_waiting, waiting, __ATOMIC_RELAXED);
+    __atomic_store_n (&metrics->job_slots, slots, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  espa_metrics_count_job
+
+PURPOSE:  Counts a finished job and its time.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_metrics_count_job
+(
+    bool success,         /* I: did the job succeed? */
+    double seconds        /* I: elapsed time of the job */
+)
+{
+    if (metrics == NULL)
+        return;
+
+    __atomic_add_fetch (&metrics->jobs[success ? 0 : 1], 1,
+        __ATOMIC_RELAXED);
+    observe_histogram (&metrics->job, (long long) (seconds * 1e9));
+}
+
+
+/******************************************************************************
+MODULE:  append_metrics
+
+PURPOSE:  Appends formatted text to the metrics page.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Once the buffer is full, len is left at size or beyond it, so the
+     caller finds the overflow at the end.
+******************************************************************************/
+static void append_metrics
+(
+    char *buf,            /* I/O: metrics page */
+    size_t size,          /* I: size of the buffer */
+    size_t *len,          /* I/O: length of the page */
+    const char *format,   /* I: printf format of the text */
+    ...                   /* I: values of the format */
+)
+{
+    va_list ap;           /* values of the format */
+    int count;            /* number of chars of the text */
+
+    if (*len >= size)
+        return;
+
+    va_start (ap, format);
+    count = vsnprintf (buf + *len, size - *len, format, ap);
+    va_end (ap);
+    *len += (count < 0) ? size : (size_t) count;
+}
+
+
+/******************************************************************************
+MODULE:  append_histogram
+
+PURPOSE:  Appends the samples of a histogram to the metrics page.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void append_histogram
+(
+    char *buf,            /* I/O: metrics page */
+    size_t size,          /* I: size of the buffer */
+    size_t *len,          /* I/O: length of the page */
+    const char *metric,   /* I: name of the metric */
+    const char *labels,   /* I: labels of the histogram and a comma, or an
+                                empty string */
+    Metrics_histogram_t *hist  /* I: histogram */
+)
+{
+    unsigned long long total = 0;  /* cumulative count of the buckets */
+    int b;                /* looping variable for the buckets */
+
+    for (b = 0; b < ESPA_METRICS_NBUCKETS; b++)
+    {
+        total += __atomic_load_n (&hist->bucket[b], __ATOMIC_RELAXED);
+        append_metrics (buf, size, len, "%s_bucket{%sle=\"%g\"} %llu\n",
+            metric, labels, metrics_bounds[b], total);
+    }
+    total += __atomic_load_n (&hist->bucket[b], __ATOMIC_RELAXED);
+    append_metrics (buf, size, len, "%s_bucket{%sle=\"+Inf\"} %llu\n",
+        metric, labels, total);
+
+    /* The sum and count leave out the trailing comma of the labels */
+    append_metrics (buf, size, len, "%s_sum{%.*s} %.6f\n", metric,
+        (int) (labels[0] != '\0' ? strlen (labels) - 1 : 0), labels,
+        __atomic_load_n (&hist->sum_ns, __ATOMIC_RELAXED) * 1e-9);
+    append_metrics (buf, size, len, "%s_count{%.*s} %llu\n", metric,
+        (int) (labels[0] != '\0' ? strlen (labels) - 1 : 0), labels, total);
+}
+
+
+/******************************************************************************
+MODULE:  format_espa_metrics
+
+PURPOSE:  Formats the metrics in the Prometheus text format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The metrics are off or don't fit in the buffer
+other           Length of the metrics page
+
+NOTES:
+  1. The counters are read one at a time while the jobs update them, so the
+     page isn't an atomic snapshot.
+******************************************************************************/
+int format_espa_metrics
+(
+    char *buf,            /* O: metrics in the Prometheus text format */
+    size_t size           /* I: size of the buffer */
+)
+{
+    char labels[STR_SIZE];  /* labels of a histogram */
+    size_t len = 0;       /* length of the page */
+    long long gauge[ESPA_PROFILE_NGAUGES];  /* sum of the gauges of the
+                                             slots */
+    int i;                /* looping variable */
+    int j;                /* looping variable */
+
+    if (metrics == NULL)
+        return (ERROR);
+
+    append_metrics (buf, size, &len, "# HELP espa_stage_duration_seconds "
+        "Time of the calls of the profiled library stages.\n"
+        "# TYPE espa_stage_duration_seconds histogram\n");
+    for (i = 0; i < ESPA_PROFILE_MAX_STAGES; i++)
+    {
+        if (__atomic_load_n (&metrics->stage[i].state, __ATOMIC_ACQUIRE) != 2)
+            continue;
+        snprintf (labels, sizeof (labels), "stage=\"%s\",",
+            metrics->stage[i].name);
+        append_histogram (buf, size, &len, "espa_stage_duration_seconds",
+            labels, &metrics->stage[i]);
+    }
+
+    append_metrics (buf, size, &len, "# HELP espa_io_bytes_total Bytes read, "
+        "written and mapped by the raw binary I/O.\n"
+        "# TYPE espa_io_bytes_total counter\n");
+    for (i = 0; i < ESPA_PROFILE_NBACKENDS; i++)
+    {
+        for (j = 0; j < 3; j++)
+            append_metrics (buf, size, &len, "espa_io_bytes_total{backend="
+                "\"%s\",op=\"%s\"} %llu\n", metrics_backend_name[i],
+                metrics_io_name[j], __atomic_load_n (&metrics->io_bytes[i][j],
+                __ATOMIC_RELAXED));
+    }
+    append_metrics (buf, size, &len, "# HELP espa_io_calls_total Read, write "
+        "and map calls of the raw binary I/O.\n"
+        "# TYPE espa_io_calls_total counter\n");
+    for (i = 0; i < ESPA_PROFILE_NBACKENDS; i++)
+    {
+        for (j = 0; j < 3; j++)
+            append_metrics (buf, size, &len, "espa_io_calls_total{backend="
+                "\"%s\",op=\"%s\"} %llu\n", metrics_backend_name[i],
+                metrics_io_name[j], __atomic_load_n (&metrics->io_calls[i][j],
+                __ATOMIC_RELAXED));
+    }
+
+    append_metrics (buf, size, &len, "# HELP espa_cache_lookups_total "
+        "Lookups of the library caches.\n"
+        "# TYPE espa_cache_lookups_total counter\n");
+    for (i = 0; i < ESPA_PROFILE_NCACHES; i++)
+    {
+        append_metrics (buf, size, &len, "espa_cache_lookups_total{cache="
+            "\"%s\",result=\"hit\"} %llu\n", metrics_cache_name[i],
+            __atomic_load_n (&metrics->cache_hits[i], __ATOMIC_RELAXED));
+        append_metrics (buf, size, &len, "espa_cache_lookups_total{cache="
+            "\"%s\",result=\"miss\"} %llu\n", metrics_cache_name[i],
+            __atomic_load_n (&metrics->cache_misses[i], __ATOMIC_RELAXED));
+    }
+
+    for (j = 0; j < ESPA_PROFILE_NGAUGES; j++)
+    {
+        gauge[j] = 0;
+        for (i = 0; i < ESPA_METRICS_MAX_SLOTS; i++)
+            gauge[j] += __atomic_load_n (&metrics->gauge[i][j],
+                __ATOMIC_RELAXED);
+    }
+    append_metrics (buf, size, &len, "# HELP espa_buffer_pool_bytes Bytes of "
+        "the raw binary buffer pools of the jobs.\n"
+        "# TYPE espa_buffer_pool_bytes gauge\n"
+        "espa_buffer_pool_bytes{state=\"in_use\"} %lld\n"
+        "espa_buffer_pool_bytes{state=\"cached\"} %lld\n",
+        gauge[ESPA_PROFILE_POOL_IN_USE], gauge[ESPA_PROFILE_POOL_CACHED]);
+    append_metrics (buf, size, &len, "# HELP espa_memory_budget_bytes "
+        "Default memory budget of the jobs; 0 for no budget.\n"
+        "# TYPE espa_memory_budget_bytes gauge\n"
+        "espa_memory_budget_bytes %llu\n",
+        (unsigned long long) espa_memory_budget ());
+    append_metrics (buf, size, &len, "# HELP espa_task_queue_depth Tasks "
+        "queued in the task pools of the jobs.\n"
+        "# TYPE espa_task_queue_depth gauge\n"
+        "espa_task_queue_depth %lld\n", gauge[ESPA_PROFILE_TASK_QUEUE]);
+
+    append_metrics (buf, size, &len, "# HELP espa_job_slots Job slots of the "
+        "daemon.\n# TYPE espa_job_slots gauge\nespa_job_slots %d\n"
+        "# HELP espa_jobs_running Jobs running.\n"
+        "# TYPE espa_jobs_running gauge\nespa_jobs_running %d\n"
+        "# HELP espa_jobs_waiting Jobs waiting for a job slot.\n"
+        "# TYPE espa_jobs_waiting gauge\nespa_jobs_waiting %d\n",
+        __atomic_load_n (&metrics->job_slots, __ATOMIC_RELAXED),
+        __atomic_load_n (&metrics->jobs_running, __ATOMIC_RELAXED),
+        __atomic_load_n (&metrics->jobs_waiting, __ATOMIC_RELAXED));
+    append_metrics (buf, size, &len, "# HELP espa_jobs_total Finished jobs.\n"
+        "# TYPE espa_jobs_total counter\n"
+        "espa_jobs_total{status=\"success\"} %llu\n"
+        "espa_jobs_total{status=\"error\"} %llu\n",
+        __atomic_load_n (&metrics->jobs[0], __ATOMIC_RELAXED),
+        __atomic_load_n (&metrics->jobs[1], __ATOMIC_RELAXED));
+    append_metrics (buf, size, &len, "# HELP espa_job_duration_seconds "
+        "Elapsed time of the finished jobs.\n"
+        "# TYPE espa_job_duration_seconds histogram\n");
+    append_histogram (buf, size, &len, "espa_job_duration_seconds", "",
+        &metrics->job);
+
+    append_metrics (buf, size, &len, "# HELP espa_metrics_start_time_seconds "
+        "Time the metrics were started, in seconds since the epoch.\n"
+        "# TYPE espa_metrics_start_time_seconds gauge\n"
+        "espa_metrics_start_time_seconds %lld\n", metrics->start_time);
+
+    if (len >= size)
+        return (ERROR);
+    return ((int) len);
+}
+
+
+/******************************************************************************
+MODULE:  write_metrics_response
+
+PURPOSE:  Writes all of an HTTP response to a connection.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A client which goes away or stalls past the timeout just loses its
+     response.
+******************************************************************************/
+static void write_metrics_response
+(
+    int fd,               /* I: connection */
+    const char *data,     /* I: data to be written */
+    size_t nbytes         /* I: number of bytes to be written */
+)
+{
+    ssize_t nwritten;     /* bytes written by a call */
+
+    while (nbytes > 0)
+    {
+        nwritten = write (fd, data, nbytes);
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+            return;
+        data += nwritten;
+        nbytes -= nwritten;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  serve_metrics
+
+PURPOSE:  Answers the metrics requests on the listening socket; the loop of
+the server process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Only GET /metrics is answered with the metrics; any other request gets
+     a 404.
+******************************************************************************/
+static void serve_metrics
+(
+    int listen_fd         /* I: listening socket */
+)
+{
+    char request[METRICS_REQUEST_SIZE];  /* request of the client */
+    char header[STR_SIZE];    /* header of the response */
+    char *page = NULL;        /* metrics page */
+    const char *status = NULL;  /* status line of the response */
+    int conn_fd;              /* connection */
+    int page_len;             /* length of the page */
+    int header_len;           /* length of the header */
+    size_t len;               /* length of the request */
+    ssize_t nread;            /* bytes read by a call */
+    struct timeval timeout;   /* timeout of the connections */
+
+    page = malloc (ESPA_METRICS_PAGE_SIZE);
+    if (page == NULL)
+        _exit (ERROR);
+
+    timeout.tv_sec = METRICS_TIMEOUT;
+    timeout.tv_usec = 0;
+    while (1)
+    {
+        conn_fd = accept (listen_fd, NULL, NULL);
+        if (conn_fd < 0)
+            continue;
+        setsockopt (conn_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+            sizeof (timeout));
+        setsockopt (conn_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+            sizeof (timeout));
+
+        /* Read the request line and headers */
+        len = 0;
+        while (len < sizeof (request) - 1)
+        {
+            nread = read (conn_fd, request + len, sizeof (request) - 1 - len);
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread <= 0)
+                break;
+            len += nread;
+            request[len] = '\0';
+            if (strstr (request, "\r\n\r\n") != NULL ||
+                strstr (request, "\n\n") != NULL)
+                break;
+        }
+        request[len] = '\0';
+
+        page_len = 0;
+        if (strncmp (request, "GET /metrics", 12) != 0 ||
+            (request[12] != ' ' && request[12] != '?'))
+        {
+            status = "404 Not Found";
+        }
+        else
+        {
+            page_len = format_espa_metrics (page, ESPA_METRICS_PAGE_SIZE);
+            if (page_len < 0)
+            {
+                status = "500 Internal Server Error";
+                page_len = 0;
+            }
+            else
+                status = "200 OK";
+        }
+
+        header_len = snprintf (header, sizeof (header), "HTTP/1.0 %s\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %d\r\nConnection: close\r\n\r\n", status,
+            page_len);
+        write_metrics_response (conn_fd, header, header_len);
+        write_metrics_response (conn_fd, page, page_len);
+        close (conn_fd);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  start_espa_metrics_server
+
+PURPOSE:  Starts the process serving the metrics over HTTP.
+
+RETURN VALUE:
+Type = pid_t
+Value           Description
+-----           -----------
+-1              Error listening on the address or starting the process
+other           Process ID of the server
+
+NOTES:
+  1. The address is a port, or a host and port separated by a colon; with
+     only a port the server listens on all the interfaces.
+  2. The server stops when the calling process exits, or when it is sent
+     SIGTERM.
+******************************************************************************/
+pid_t start_espa_metrics_server
+(
+    const char *address   /* I: [host:]port to listen on */
+)
+{
+    char FUNC_NAME[] = "start_espa_metrics_server";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char host[STR_SIZE];    /* host of the address */
+    const char *port = NULL;  /* port of the address */
+    const char *colon = strrchr (address, ':');  /* end of the host */
+    int listen_fd = -1;     /* listening socket */
+    int on = 1;             /* value of SO_REUSEADDR */
+    int status;             /* return status of getaddrinfo */
+    pid_t parent = getpid ();  /* process ID of the daemon */
+    pid_t pid;              /* process ID of the server */
+    struct addrinfo hints;  /* kind of address wanted */
+    struct addrinfo *res = NULL;  /* addresses of the host and port */
+    struct addrinfo *ai = NULL;   /* current address */
+
+    if (metrics == NULL)
+    {
+        sprintf (errmsg, "The metrics haven't been initialized");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    host[0] = '\0';
+    port = address;
+    if (colon != NULL)
+    {
+        snprintf (host, sizeof (host), "%.*s", (int) (colon - address),
+            address);
+        port = colon + 1;
+    }
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    status = getaddrinfo (host[0] != '\0' ? host : NULL, port, &hints, &res);
+    if (status != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Resolving the metrics address "
+            "%s: %s", address, gai_strerror (status));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    for (ai = res; ai != NULL; ai = ai->ai_next)
+    {
+        listen_fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (listen_fd < 0)
+            continue;
+        setsockopt (listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+        if (bind (listen_fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+            listen (listen_fd, 16) == 0)
+            break;
+        close (listen_fd);
+        listen_fd = -1;
+    }
+    freeaddrinfo (res);
+    if (listen_fd < 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Listening on the metrics address "
+            "%s: %s", address, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    fflush (NULL);
+    pid = fork ();
+    if (pid < 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Starting the metrics server: %s",
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        close (listen_fd);
+        return (-1);
+    }
+
+    if (pid == 0)
+    {
+        /* Stop with the daemon, even if it is killed */
+        prctl (PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid () != parent)
+            _exit (SUCCESS);
+        signal (SIGINT, SIG_DFL);
+        signal (SIGTERM, SIG_DFL);
+        signal (SIGPIPE, SIG_IGN);
+        serve_metrics (listen_fd);
+        _exit (SUCCESS);
+    }
+
+    close (listen_fd);
+    return (pid);
+}
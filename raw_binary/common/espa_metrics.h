@@ -0,0 +1,119 @@
+/*****************************************************************************
+FILE: espa_metrics.h
+
+PURPOSE: Contains defines and prototypes for the live metrics of a daemon,
+such as espa_worker, served in the Prometheus text format for monitoring and
+autoscaling.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The metrics are fed by the profiler hooks (see espa_profile.h): the
+     time of the profiled stages, the raw binary I/O bytes of each backend,
+     the cache hits and misses, and the buffer pool and task queue gauges.
+     The daemon adds its own job counts and queue depths.
+  2. The counters are kept in shared memory mapped by espa_metrics_init, so
+     the jobs forked by the daemon add to the same counters and the server
+     process forked by start_espa_metrics_server reads them.  They count
+     the work of all the jobs since the daemon started.
+  3. The gauges of a job are kept in the slot given by espa_metrics_set_slot
+     in the job's process, and are cleared by the daemon with
+     espa_metrics_clear_slot once the job is done, so a job which crashed
+     doesn't leave them behind.  The served value is the sum of the slots.
+  4. The server answers GET /metrics over HTTP/1.0 on a TCP port, one
+     connection at a time, and stops when the daemon exits.
+*****************************************************************************/
+
+#ifndef ESPA_METRICS_H_
+#define ESPA_METRICS_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "espa_common.h"
+#include "espa_profile.h"
+
+/* Defines */
+/* Maximum number of job slots with their own gauges */
+#define ESPA_METRICS_MAX_SLOTS 64
+
+/* Upper bounds of the buckets of the latency histograms (seconds); the last
+   bucket, +Inf, is implied */
+#define ESPA_METRICS_NBUCKETS 12
+#define ESPA_METRICS_BUCKETS \
+    {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0, 10.0, 30.0, 60.0, 300.0}
+
+/* Largest length of a stage name in the metrics */
+#define ESPA_METRICS_NAME_SIZE 64
+
+/* Size of the buffer the metrics are formatted into */
+#define ESPA_METRICS_PAGE_SIZE 65536
+
+/* Prototypes */
+int espa_metrics_init (void);
+
+bool espa_metrics_enabled (void);
+
+void espa_metrics_set_slot
+(
+    int slot              /* I: job slot of the calling process */
+);
+
+void espa_metrics_clear_slot
+(
+    int slot              /* I: job slot whose gauges are cleared */
+);
+
+void espa_metrics_observe_stage
+(
+    int stage,            /* I: index of the stage in the profiler */
+    const char *name,     /* I: name of the stage */
+    long long elapsed_ns  /* I: time of the call (nanoseconds) */
+);
+
+void espa_metrics_count_io
+(
+    Espa_profile_io_t kind,  /* I: kind of I/O */
+    Espa_profile_backend_t backend,  /* I: backend of the I/O */
+    size_t nbytes            /* I: number of bytes read, written or mapped */
+);
+
+void espa_metrics_count_cache
+(
+    Espa_profile_cache_t cache,  /* I: cache looked up */
+    bool hit                     /* I: was the entry found? */
+);
+
+void espa_metrics_set_gauge
+(
+    Espa_profile_gauge_t gauge,  /* I: gauge to be set */
+    long long value              /* I: current value of the gauge */
+);
+
+void espa_metrics_set_jobs
+(
+    int running,          /* I: number of jobs running */
+    int waiting,          /* I: number of jobs waiting for a slot */
+    int slots             /* I: number of job slots */
+);
+
+void espa_metrics_count_job
+(
+    bool success,         /* I: did the job succeed? */
+    double seconds        /* I: elapsed time of the job */
+);
+
+int format_espa_metrics
+(
+    char *buf,            /* O: metrics in the Prometheus text format */
+    size_t size           /* I: size of the buffer */
+);
+
+pid_t start_espa_metrics_server
+(
+    const char *address   /* I: [host:]port to listen on */
+);
+
+#endif
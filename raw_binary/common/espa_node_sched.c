@@ -0,0 +1,327 @@
+/*****************************************************************************
+FILE: espa_node_sched.c
+
+PURPOSE: Contains functions for classifying the jobs of the tools as
+CPU-bound or I/O-bound, and for admitting them through the node scheduler.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A job waits for its admission in a blocking read of the connection, so
+     the waiting jobs use no CPU.  The coordinator answers the waiting jobs
+     of a class in the order they asked, but a job of the other class which
+     fits the budgets may pass them, so a node queued up with exports still
+     runs the angle jobs on its idle cores and the other way around.
+  2. A coordinator which can't be reached is reported once per process, and
+     the jobs then run as they would without a scheduler.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "error_handler.h"
+#include "espa_io_limit.h"
+#include "espa_task.h"
+#include "espa_node_sched.h"
+
+/* Tools and stages bound by the cores of the node; the others are bound by
+   the storage bandwidth */
+static const char *sched_cpu_stages[] =
+{
+    "create_angle_bands", "create_derived_bands",
+    "create_geolocation_bands", "create_land_water_mask",
+    "create_level1_espa", "create_toa_bands", "espa_reproject", "angles",
+    "land_water_mask", "mosaic", NULL
+};
+
+/* Has the unreachable coordinator been reported? */
+static bool sched_warned = false;
+
+/******************************************************************************
+MODULE:  espa_sched_parse_class
+
+PURPOSE:  Parses the name of a job class.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name isn't cpu or io
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+int espa_sched_parse_class
+(
+    const char *name,     /* I: cpu or io */
+    Espa_sched_class_t *sched_class  /* O: class of the job */
+)
+{
+    if (!strcmp (name, "cpu"))
+        *sched_class = ESPA_SCHED_CPU;
+    else if (!strcmp (name, "io"))
+        *sched_class = ESPA_SCHED_IO;
+    else
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_sched_class_name
+
+PURPOSE:  Returns the name of a job class.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+"cpu" or "io"   Name of the class
+
+NOTES:
+******************************************************************************/
+const char *espa_sched_class_name
+(
+    Espa_sched_class_t sched_class  /* I: class of the job */
+)
+{
+    return (sched_class == ESPA_SCHED_CPU ? "cpu" : "io");
+}
+
+
+/******************************************************************************
+MODULE:  espa_sched_classify
+
+PURPOSE:  Returns the class of the jobs of a tool or pipeline stage.
+
+RETURN VALUE:
+Type = Espa_sched_class_t
+Value           Description
+-----           -----------
+ESPA_SCHED_CPU  The per-pixel geometry, reprojection and mask stages
+ESPA_SCHED_IO   The ingests, exports, subsets and the other stages
+
+NOTES:
+  1. The CPU-bound stages are those whose time goes into evaluating models
+     or projections for each pixel; the others mostly move pixels between
+     files, and are limited by the storage.
+******************************************************************************/
+Espa_sched_class_t espa_sched_classify
+(
+    const char *stage     /* I: name of the tool or stage */
+)
+{
+    int i;                /* looping variable for the CPU-bound stages */
+
+    for (i = 0; sched_cpu_stages[i] != NULL; i++)
+    {
+        if (!strcmp (stage, sched_cpu_stages[i]))
+            return (ESPA_SCHED_CPU);
+    }
+
+    return (ESPA_SCHED_IO);
+}
+
+
+/******************************************************************************
+MODULE:  espa_sched_process_class
+
+PURPOSE:  Returns the class of the jobs of the calling tool.
+
+RETURN VALUE:
+Type = Espa_sched_class_t
+Value           Description
+-----           -----------
+ESPA_SCHED_CPU  The jobs of the tool are CPU-bound
+ESPA_SCHED_IO   The jobs of the tool are I/O-bound
+
+NOTES:
+  1. The class is ESPA_SCHED_CLASS if set, or else the class of the tool by
+     its name.  An invalid ESPA_SCHED_CLASS is reported as a warning and
+     ignored.
+******************************************************************************/
+Espa_sched_class_t espa_sched_process_class (void)
+{
+    char FUNC_NAME[] = "espa_sched_process_class";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *env = getenv (ESPA_SCHED_CLASS_ENV);   /* class of the tool */
+    Espa_sched_class_t sched_class;   /* class of the jobs */
+
+    if (env != NULL && env[0] != '\0')
+    {
+        if (espa_sched_parse_class (env, &sched_class) == SUCCESS)
+            return (sched_class);
+
+        snprintf (errmsg, sizeof (errmsg), "Ignoring the invalid %s %s; must "
+            "be cpu or io", ESPA_SCHED_CLASS_ENV, env);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return (espa_sched_classify (program_invocation_short_name));
+}
+
+
+/******************************************************************************
+MODULE:  espa_sched_enabled
+
+PURPOSE:  Returns whether the jobs are admitted through a node scheduler.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            ESPA_NODE_SCHED gives the socket of a node scheduler
+false           The jobs run without admission
+
+NOTES:
+******************************************************************************/
+bool espa_sched_enabled (void)
+{
+    char *env = getenv (ESPA_SCHED_ENV);   /* socket of the scheduler */
+
+    return (env != NULL && env[0] != '\0');
+}
+
+
+/******************************************************************************
+MODULE:  espa_sched_admit
+
+PURPOSE:  Waits until the node scheduler admits a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              No node scheduler, or it couldn't be reached; the job runs
+                without admission
+other           Admission of the job, to be released with espa_sched_leave
+
+NOTES:
+  1. The admission is the connection to the coordinator, so it's also
+     released when the process exits.  A process forking children while it
+     holds an admission shares it with them until they exit.
+  2. The bandwidth asked for is the sum of the read and write rates of the
+     job, or 0 if the job isn't limited, in which case the coordinator
+     gives the I/O-bound jobs its default bandwidth of a job.
+******************************************************************************/
+int espa_sched_admit
+(
+    Espa_sched_class_t sched_class,  /* I: class of the job */
+    int cores             /* I: cores the job uses; 0 for the threads of
+                                the task pool (CPU-bound) or one core
+                                (I/O-bound) */
+)
+{
+    char FUNC_NAME[] = "espa_sched_admit";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char line[ESPA_SCHED_MAX_LINE];  /* request and reply */
+    char *socket_file = getenv (ESPA_SCHED_ENV);   /* socket of the
+                                     scheduler */
+    int fd;                       /* connection to the scheduler */
+    int len;                      /* length of the request */
+    ssize_t nread;                /* length of the reply */
+    double read_rate;             /* read rate of the job (MB/s) */
+    double write_rate;            /* write rate of the job (MB/s) */
+    Espa_io_class_t io_class;     /* I/O priority class of the job */
+    struct sockaddr_un addr;      /* address of the socket */
+
+    if (socket_file == NULL || socket_file[0] == '\0')
+        return (-1);
+
+    if (cores <= 0)
+        cores = (sched_class == ESPA_SCHED_CPU) ? espa_task_nthreads () : 1;
+    espa_io_get_limit (&io_class, &read_rate, &write_rate);
+
+    if (strlen (socket_file) >= sizeof (addr.sun_path))
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s is too long",
+            ESPA_SCHED_ENV);
+        fd = -1;
+    }
+    else
+    {
+        memset (&addr, 0, sizeof (addr));
+        addr.sun_family = AF_UNIX;
+        strcpy (addr.sun_path, socket_file);
+
+        fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect (fd, (struct sockaddr *) &addr,
+            sizeof (addr)) != 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Connecting to the node "
+                "scheduler %s: %s", socket_file, strerror (errno));
+            if (fd >= 0)
+                close (fd);
+            fd = -1;
+        }
+    }
+
+    if (fd >= 0)
+    {
+        len = snprintf (line, sizeof (line), "admit %s %d %.1f %ld\n",
+            espa_sched_class_name (sched_class), cores,
+            read_rate + write_rate, (long) getpid ());
+        if (write (fd, line, len) != len)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Writing to the node "
+                "scheduler %s", socket_file);
+            close (fd);
+            fd = -1;
+        }
+    }
+
+    /* Wait for the reply, which only comes once the job is admitted */
+    if (fd >= 0)
+    {
+        do
+            nread = read (fd, line, sizeof (line) - 1);
+        while (nread < 0 && errno == EINTR);
+        if (nread < 2 || strncmp (line, "ok", 2) != 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Node scheduler %s didn't "
+                "admit the job", socket_file);
+            close (fd);
+            fd = -1;
+        }
+    }
+
+    if (fd < 0 && !sched_warned)
+    {
+        strncat (errmsg, "; running without admission",
+            sizeof (errmsg) - strlen (errmsg) - 1);
+        error_handler (false, FUNC_NAME, errmsg);
+        sched_warned = true;
+    }
+
+    return (fd);
+}
+
+
+/******************************************************************************
+MODULE:  espa_sched_leave
+
+PURPOSE:  Releases the admission of a job, so the node scheduler can admit
+the jobs waiting for its cores and bandwidth.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_sched_leave
+(
+    int ticket            /* I: admission from espa_sched_admit */
+)
+{
+    if (ticket >= 0)
+        close (ticket);
+}
@@ -0,0 +1,86 @@
+/*****************************************************************************
+FILE: espa_node_sched.h
+
+PURPOSE: Contains the defines and prototypes for admitting the jobs of the
+tool processes running on a node through the node scheduler, so the
+CPU-bound and I/O-bound jobs share the cores and the storage bandwidth of
+the node without oversubscribing either.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The node scheduler is the espa_node_sched coordinator, listening on the
+     UNIX socket given by ESPA_NODE_SCHED.  Without ESPA_NODE_SCHED, or if
+     the coordinator can't be reached, the jobs run without admission.
+  2. Each job is CPU-bound or I/O-bound.  A CPU-bound job asks for the
+     threads of its task pool and the I/O rates of the job, if limited (see
+     espa_io_limit.h).  An I/O-bound job asks for one core and the I/O rates
+     of the job, or the default bandwidth of a job of the coordinator.  The
+     coordinator admits the jobs against its core and bandwidth budgets.
+  3. A job holds its admission for as long as its connection to the
+     coordinator is open, so the admission of a job which crashes or is
+     killed is released by the kernel closing the connection.
+  4. The protocol is one line from the job, "admit <cpu|io> <cores> <MB/s>
+     <pid>", answered by "ok" once the job is admitted.
+*****************************************************************************/
+
+#ifndef ESPA_NODE_SCHED_H_
+#define ESPA_NODE_SCHED_H_
+
+#include <stdbool.h>
+
+/* Defines */
+/* Environment variable giving the socket of the node scheduler */
+#define ESPA_SCHED_ENV "ESPA_NODE_SCHED"
+
+/* Environment variable overriding the class of the jobs of a tool */
+#define ESPA_SCHED_CLASS_ENV "ESPA_SCHED_CLASS"
+
+/* Maximum length of a line of the protocol */
+#define ESPA_SCHED_MAX_LINE 128
+
+/* Class of a job */
+typedef enum
+{
+    ESPA_SCHED_CPU,       /* bound by the cores of the node */
+    ESPA_SCHED_IO         /* bound by the storage bandwidth of the node */
+} Espa_sched_class_t;
+
+/* Prototypes */
+int espa_sched_parse_class
+(
+    const char *name,     /* I: cpu or io */
+    Espa_sched_class_t *sched_class  /* O: class of the job */
+);
+
+const char *espa_sched_class_name
+(
+    Espa_sched_class_t sched_class  /* I: class of the job */
+);
+
+Espa_sched_class_t espa_sched_classify
+(
+    const char *stage     /* I: name of the tool or stage */
+);
+
+Espa_sched_class_t espa_sched_process_class (void);
+
+bool espa_sched_enabled (void);
+
+int espa_sched_admit
+(
+    Espa_sched_class_t sched_class,  /* I: class of the job */
+    int cores             /* I: cores the job uses; 0 for the threads of
+                                the task pool (CPU-bound) or one core
+                                (I/O-bound) */
+);
+
+void espa_sched_leave
+(
+    int ticket            /* I: admission from espa_sched_admit */
+);
+
+#endif
@@ -0,0 +1,345 @@
+/*****************************************************************************
+FILE: espa_numa.c
+
+PURPOSE: Contains functions for pinning the worker processes and threads of
+the parallel modes to NUMA nodes.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The node topology is read from /sys/devices/system/node, so libnuma
+     isn't needed.  Without NUMA support in the kernel, or with a single
+     usable node, the placement only restricts the threads to that node.
+  2. A thread is pinned the first time it asks, and keeps its node for the
+     rest of its life, so the threads of the task pool (see espa_task.h)
+     stay on the node their earlier buffers are on.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sched.h>
+#include "error_handler.h"
+#include "espa_numa.h"
+
+/* Directory of the NUMA nodes */
+#define NUMA_NODE_DIR "/sys/devices/system/node"
+
+/* Nodes used, with the allowed CPUs of each */
+static int numa_nnodes = 0;
+static int numa_node_id[ESPA_NUMA_MAX_NODES];
+static cpu_set_t numa_node_cpus[ESPA_NUMA_MAX_NODES];
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+
+/* Node the process is pinned to; -1 if it isn't */
+static int numa_process_node = -1;
+
+/* Node the calling thread is pinned to; -1 if it isn't */
+static __thread int numa_thread_node = -1;
+
+/******************************************************************************
+MODULE:  parse_numa_list
+
+PURPOSE:  Adds the numbers of a list such as "0-3,8,10-11", the format of the
+kernel's CPU and node lists, to a CPU set.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The list isn't valid
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+static int parse_numa_list
+(
+    const char *list,     /* I: list of numbers and ranges */
+    cpu_set_t *set        /* I/O: set the numbers are added to */
+)
+{
+    const char *cptr = list;  /* current position in the list */
+    char *end = NULL;         /* end of a number */
+    long first;               /* first number of a range */
+    long last;                /* last number of a range */
+    long i;                   /* looping variable */
+
+    while (*cptr != '\0' && !isspace ((unsigned char) *cptr))
+    {
+        first = strtol (cptr, &end, 10);
+        if (end == cptr || first < 0)
+            return (ERROR);
+        last = first;
+        cptr = end;
+        if (*cptr == '-')
+        {
+            last = strtol (cptr + 1, &end, 10);
+            if (end == cptr + 1 || last < first)
+                return (ERROR);
+            cptr = end;
+        }
+        for (i = first; i <= last && i < CPU_SETSIZE; i++)
+            CPU_SET (i, set);
+        if (*cptr == ',')
+            cptr++;
+        else if (*cptr != '\0' && !isspace ((unsigned char) *cptr))
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_numa
+
+PURPOSE:  Reads the ESPA_NUMA environment variable and the nodes and CPUs
+the process may use.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. An invalid setting, or one leaving no usable node, is reported as a
+     warning and placement is left off.
+******************************************************************************/
+static void init_numa (void)
+{
+    char FUNC_NAME[] = "init_numa";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* name of a node's CPU list */
+    char line[STR_SIZE];     /* node's CPU list */
+    char *env = getenv ("ESPA_NUMA");  /* requested nodes */
+    int node;                /* looping variable for the nodes */
+    cpu_set_t selected;      /* nodes selected by ESPA_NUMA */
+    cpu_set_t allowed;       /* CPUs the process may run on */
+    cpu_set_t cpus;          /* CPUs of a node */
+    FILE *fp = NULL;         /* node's CPU list file */
+
+    if (env == NULL || env[0] == '\0' || !strcmp (env, "off"))
+        return;
+
+    CPU_ZERO (&selected);
+    if (!strcmp (env, "on"))
+    {
+        for (node = 0; node < ESPA_NUMA_MAX_NODES; node++)
+            CPU_SET (node, &selected);
+    }
+    else if (parse_numa_list (env, &selected) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid ESPA_NUMA %s; NUMA "
+            "placement is off", env);
+        error_handler (false, FUNC_NAME, errmsg);
+        return;
+    }
+
+    if (sched_getaffinity (0, sizeof (allowed), &allowed) != 0)
+    {
+        sprintf (errmsg, "Unable to get the CPUs of the process; NUMA "
+            "placement is off");
+        error_handler (false, FUNC_NAME, errmsg);
+        return;
+    }
+
+    /* Keep the selected nodes with CPUs the process may run on */
+    for (node = 0; node < ESPA_NUMA_MAX_NODES; node++)
+    {
+        if (!CPU_ISSET (node, &selected))
+            continue;
+
+        snprintf (path, sizeof (path), "%s/node%d/cpulist", NUMA_NODE_DIR,
+            node);
+        fp = fopen (path, "r");
+        if (fp == NULL)
+            continue;
+        CPU_ZERO (&cpus);
+        if (fgets (line, sizeof (line), fp) == NULL ||
+            parse_numa_list (line, &cpus) != SUCCESS)
+            CPU_ZERO (&cpus);
+        fclose (fp);
+
+        CPU_AND (&cpus, &cpus, &allowed);
+        if (CPU_COUNT (&cpus) == 0)
+            continue;
+
+        numa_node_id[numa_nnodes] = node;
+        numa_node_cpus[numa_nnodes] = cpus;
+        numa_nnodes++;
+    }
+
+    if (numa_nnodes == 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "No usable NUMA node in %s; NUMA "
+            "placement is off", env);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  espa_numa_enabled
+
+PURPOSE:  Returns whether the processes and threads are placed on NUMA
+nodes.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            NUMA placement is on
+false           NUMA placement is off
+
+NOTES:
+******************************************************************************/
+bool espa_numa_enabled (void)
+{
+    pthread_once (&numa_once, init_numa);
+    return (numa_nnodes > 0);
+}
+
+
+/******************************************************************************
+MODULE:  espa_numa_nnodes
+
+PURPOSE:  Returns the number of NUMA nodes the processes and threads are
+placed on.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+1               NUMA placement is off, or uses a single node
+other           Number of nodes used
+
+NOTES:
+******************************************************************************/
+int espa_numa_nnodes (void)
+{
+    if (!espa_numa_enabled ())
+        return (1);
+    return (numa_nnodes);
+}
+
+
+/******************************************************************************
+MODULE:  espa_numa_bind_process
+
+PURPOSE:  Pins the calling process, and the threads it starts from then on,
+to the NUMA node of its worker slot.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              NUMA placement is off or the process couldn't be pinned
+other           Node the process is pinned to
+
+NOTES:
+  1. Called by a forked worker before it starts any threads, so all of its
+     threads inherit the node.
+******************************************************************************/
+int espa_numa_bind_process
+(
+    int slot              /* I: slot of the worker process */
+)
+{
+    char FUNC_NAME[] = "espa_numa_bind_process";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int index;               /* index of the node */
+
+    if (!espa_numa_enabled () || slot < 0)
+        return (-1);
+
+    index = slot % numa_nnodes;
+    if (sched_setaffinity (0, sizeof (cpu_set_t), &numa_node_cpus[index])
+        != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unable to pin worker %d to NUMA "
+            "node %d", slot, numa_node_id[index]);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    numa_process_node = numa_node_id[index];
+    numa_thread_node = numa_process_node;
+    return (numa_process_node);
+}
+
+
+/******************************************************************************
+MODULE:  espa_numa_bind_thread
+
+PURPOSE:  Pins the calling thread to a NUMA node, round robin by its thread
+number, the first time it is called by the thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              NUMA placement is off or the thread couldn't be pinned
+other           Node the thread is pinned to
+
+NOTES:
+  1. Called at the start of the work of each thread of a parallel mode.
+     After the first call it only returns the thread's node, so it is cheap
+     enough to call for each band, tile or row.
+  2. The threads of a process pinned by espa_numa_bind_process stay on the
+     process's node.
+******************************************************************************/
+int espa_numa_bind_thread
+(
+    int thread            /* I: number of the thread in its team */
+)
+{
+    int index;               /* index of the node */
+
+    if (numa_thread_node >= 0)
+        return (numa_thread_node);
+    if (!espa_numa_enabled () || thread < 0)
+        return (-1);
+    if (numa_process_node >= 0)
+    {
+        numa_thread_node = numa_process_node;
+        return (numa_thread_node);
+    }
+
+    index = thread % numa_nnodes;
+    if (pthread_setaffinity_np (pthread_self (), sizeof (cpu_set_t),
+        &numa_node_cpus[index]) != 0)
+        return (-1);
+
+    numa_thread_node = numa_node_id[index];
+    return (numa_thread_node);
+}
+
+
+/******************************************************************************
+MODULE:  espa_numa_node
+
+PURPOSE:  Returns the NUMA node the calling thread is pinned to.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               NUMA placement is off, or the thread isn't pinned
+other           Node the thread is pinned to
+
+NOTES:
+  1. Used to keep per-node caches of buffers, such as the raw binary buffer
+     pool, so a recycled buffer stays on its node.
+******************************************************************************/
+int espa_numa_node (void)
+{
+    if (numa_thread_node >= 0)
+        return (numa_thread_node);
+    if (numa_process_node >= 0)
+        return (numa_process_node);
+    return (0);
+}
@@ -0,0 +1,54 @@
+/*****************************************************************************
+FILE: espa_numa.h
+
+PURPOSE: Contains the defines and prototypes for placing the processes and
+threads of the parallel modes on NUMA nodes, so the threads and the buffers
+they touch stay on the same socket.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Placement is off unless the ESPA_NUMA environment variable is set, to
+     "on" to use all the NUMA nodes or to a list of node numbers (e.g. "1"
+     or "0,1").  Only the CPUs the process is allowed to run on (e.g. with
+     taskset or a cpuset cgroup) are used, so a CPU set is given that way.
+  2. The scenes or jobs processed concurrently by forked workers are each
+     pinned to a node, round robin by worker slot, so a scene's threads and
+     buffers never cross sockets.  The threads of a process which isn't
+     pinned are each pinned to a node, round robin by thread number.
+  3. A pinned thread or process may run on any CPU of its node.  Memory is
+     allocated on the node of the thread which first touches it (the
+     kernel's default policy), so buffers allocated and filled by a worker
+     are on its node.
+*****************************************************************************/
+
+#ifndef ESPA_NUMA_H_
+#define ESPA_NUMA_H_
+
+#include <stdbool.h>
+
+/* Defines */
+/* Largest number of NUMA nodes used; higher nodes are ignored */
+#define ESPA_NUMA_MAX_NODES 8
+
+/* Prototypes */
+bool espa_numa_enabled (void);
+
+int espa_numa_nnodes (void);
+
+int espa_numa_bind_process
+(
+    int slot              /* I: slot of the worker process */
+);
+
+int espa_numa_bind_thread
+(
+    int thread            /* I: number of the thread in its team */
+);
+
+int espa_numa_node (void);
+
+#endif
@@ -0,0 +1,55 @@
+/*****************************************************************************
+FILE: espa_probe.h
+
+PURPOSE: Contains the macros for the static tracepoints (USDT probes) of the
+library stages, which perf, bpftrace and SystemTap can attach to.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The probes are compiled in when sys/sdt.h (systemtap-sdt-devel or
+     systemtap-sdt-dev) is available, unless ESPA_DISABLE_PROBES is defined
+     (DISABLE_PROBES=yes in make.config).  Otherwise the macros are empty.
+  2. A probe that isn't attached is a single nop in the code, with its
+     arguments left where the tracer can read them, so the probes can be
+     left in the production builds.
+  3. The probes are in the "espa" provider.  A double underscore in a probe
+     name is shown as a dash by the tracers (band__start is band-start).
+       band__start(band name, nlines, nsamps)
+       band__done(band name, bytes written)
+       read__block(fd, nlines, bytes)
+       write__block(fd, nlines, bytes)
+       polygon__load(polygon file, packed)
+       mask__tile(first line, first sample, nlines, nsamps)
+       angle__band__done(band number, nlines, nsamps)
+*****************************************************************************/
+
+#ifndef ESPA_PROBE_H_
+#define ESPA_PROBE_H_
+
+#if !defined (ESPA_DISABLE_PROBES) && defined (__has_include)
+#if __has_include (<sys/sdt.h>)
+#include <sys/sdt.h>
+#define ESPA_HAVE_PROBES
+#endif
+#endif
+
+#ifdef ESPA_HAVE_PROBES
+#define ESPA_PROBE0(name) DTRACE_PROBE (espa, name)
+#define ESPA_PROBE1(name, a1) DTRACE_PROBE1 (espa, name, a1)
+#define ESPA_PROBE2(name, a1, a2) DTRACE_PROBE2 (espa, name, a1, a2)
+#define ESPA_PROBE3(name, a1, a2, a3) DTRACE_PROBE3 (espa, name, a1, a2, a3)
+#define ESPA_PROBE4(name, a1, a2, a3, a4) \
+    DTRACE_PROBE4 (espa, name, a1, a2, a3, a4)
+#else
+#define ESPA_PROBE0(name) ((void) 0)
+#define ESPA_PROBE1(name, a1) ((void) 0)
+#define ESPA_PROBE2(name, a1, a2) ((void) 0)
+#define ESPA_PROBE3(name, a1, a2, a3) ((void) 0)
+#define ESPA_PROBE4(name, a1, a2, a3, a4) ((void) 0)
+#endif
+
+#endif
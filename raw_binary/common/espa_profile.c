@@ -0,0 +1,671 @@
+/*****************************************************************************
+FILE: espa_profile.c
+
+PURPOSE: Contains functions for profiling the time spent in the library
+stages and the raw binary I/O of a tool run, and reporting them as JSON.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The stages are timed by any thread without taking a lock.  A stage's
+     slot is claimed the first time the stage is timed, by setting the slot
+     name atomically, and its counters are updated with atomic adds.  The
+     time of a stage run by several threads at once is counted once per
+     thread.
+  2. The report is one JSON line:
+       {"program": ..., "pid": ..., "seconds": ..., "user_seconds": ...,
+        "system_seconds": ..., "peak_rss_kb": ..., "minor_faults": ...,
+        "major_faults": ...,
+        "io": {"read_bytes": ..., "read_calls": ..., "write_bytes": ...,
+               "write_calls": ..., "mapped_bytes": ..., "map_calls": ...,
+               "backends": {"stdio": {"read_bytes": ..., "write_bytes": ...,
+                                      "mapped_bytes": ...}, "posix": ...,
+                            "mmap": ..., "async": ..., "s3": ...,
+                            "pipe": ...}},
+        "large_alloc": {"calls": ..., "heap_bytes": ..., "page_bytes": ...,
+                        "thp_bytes": ..., "hugetlb_bytes": ...},
+        "caches": {"schema": {"hits": ..., "misses": ...}, "metadata": ...,
+                   "polygon": ..., "ang": ..., "derived": ...,
+                   "transform": ...},
+        "peaks": {"pool_in_use_bytes": ..., "pool_cached_bytes": ...,
+                  "task_queue": ...},
+        "latency": {"first_band_seconds": ..., "complete_seconds": ...},
+        "stages": [{"name": ..., "calls": ..., "seconds": ...,
+                    "max_seconds": ..., "minor_faults": ...}, ...]}
+     where seconds is the time since profiling started and the I/O calls
+     are the read, write and map calls made by the raw binary I/O library
+     (the buffered stream reads and writes count as one call each).  The
+     transfers with an object store or on a pipe are only counted under the
+     s3 or pipe backend, since the library reads and writes their streams
+     like files.  The
+     large allocations are those of espa_alloc_large, by the kind of pages
+     backing them.  The latency milestones are null until they're marked
+     (see espa_profile_mark).
+  3. The minor faults of a stage are those of the whole process while the
+     stage runs, so they include the faults of the threads the stage
+     starts, and of other stages running at the same time in other
+     threads.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "error_handler.h"
+#include "espa_profile.h"
+#include "espa_metrics.h"
+
+/* Size of the buffer the report is written from */
+#define PROFILE_REPORT_SIZE 16384
+
+/* Counters of a stage */
+typedef struct
+{
+    const char *name;         /* name of the stage; NULL if the slot is free */
+    unsigned long calls;      /* number of calls */
+    long long total_ns;       /* total time of the calls (nanoseconds) */
+    long long max_ns;         /* longest call (nanoseconds) */
+    long long minor_faults;   /* minor page faults during the calls */
+} Profile_stage_t;
+
+/* Profiling state: -1 until the environment is read, 2 while it is being
+   read, then 0 (off) or 1 (on) */
+static int profile_state = -1;
+
+/* Time profiling started (nanoseconds) */
+static long long profile_start_ns = 0;
+
+/* Stage counters */
+static Profile_stage_t profile_stage[ESPA_PROFILE_MAX_STAGES];
+
+/* Raw binary I/O counters, indexed by Espa_profile_io_t */
+static unsigned long long profile_io_bytes[3];
+static unsigned long profile_io_calls[3];
+
+/* Raw binary I/O bytes of each backend, indexed by Espa_profile_backend_t
+   and Espa_profile_io_t */
+static unsigned long long profile_backend_bytes[ESPA_PROFILE_NBACKENDS][3];
+
+/* Large allocation counters; the bytes are indexed by Espa_profile_alloc_t */
+static unsigned long long profile_alloc_bytes[4];
+static unsigned long profile_alloc_calls;
+
+/* Cache counters, indexed by Espa_profile_cache_t */
+static unsigned long profile_cache_hits[ESPA_PROFILE_NCACHES];
+static unsigned long profile_cache_misses[ESPA_PROFILE_NCACHES];
+
+/* Peaks of the gauges, indexed by Espa_profile_gauge_t */
+static long long profile_gauge_peak[ESPA_PROFILE_NGAUGES];
+
+/* Time of each milestone from the start of profiling (nanoseconds), indexed
+   by Espa_profile_milestone_t; 0 until it's marked */
+static long long profile_milestone_ns[ESPA_PROFILE_NMILESTONES];
+
+/* Names of the backends and caches in the report */
+static const char *profile_backend_name[ESPA_PROFILE_NBACKENDS] =
+    {"stdio", "posix", "mmap", "async", "s3", "pipe"};
+static const char *profile_cache_name[ESPA_PROFILE_NCACHES] =
+    {"schema", "metadata", "polygon", "ang", "derived", "transform"};
+
+/******************************************************************************
+MODULE:  get_time_ns
+
+PURPOSE:  Returns the monotonic clock in nanoseconds.
+
+RETURN VALUE:
+Type = long long
+Value           Description
+-----           -----------
+time            Monotonic time in nanoseconds
+
+NOTES:
+******************************************************************************/
+static long long get_time_ns (void)
+{
+    struct timespec now;  /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return ((long long) now.tv_sec * 1000000000LL + now.tv_nsec);
+}
+
+
+/******************************************************************************
+MODULE:  get_minor_faults
+
+PURPOSE:  Returns the number of minor page faults of the process.
+
+RETURN VALUE:
+Type = long
+Value           Description
+-----           -----------
+faults          Minor page faults since the process started
+
+NOTES:
+******************************************************************************/
+static long get_minor_faults (void)
+{
+    struct rusage usage;  /* resource usage of the process */
+
+    getrusage (RUSAGE_SELF, &usage);
+    return (usage.ru_minflt);
+}
+
+
+/******************************************************************************
+MODULE:  report_at_exit
+
+PURPOSE:  Writes the profile when the process exits.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void report_at_exit (void)
+{
+    espa_profile_report ();
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_enabled
+
+PURPOSE:  Returns whether profiling is on, reading the ESPA_PROFILE
+environment variable the first time it is called.  Profiling is also on if
+the live metrics were initialized by then.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            Profiling is on
+false           Profiling is off
+
+NOTES:
+  1. Turning profiling on registers the exit handler writing the report.
+******************************************************************************/
+bool espa_profile_enabled (void)
+{
+    int state = __atomic_load_n (&profile_state, __ATOMIC_ACQUIRE);
+    int unread = -1;       /* state before the environment is read */
+    char *env = NULL;      /* value of the environment variable */
+
+    if (state == 0 || state == 1)
+        return (state == 1);
+
+    /* One thread reads the environment while the others wait for it */
+    if (__atomic_compare_exchange_n (&profile_state, &unread, 2, false,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        env = getenv ("ESPA_PROFILE");
+        state = (env != NULL && env[0] != '\0') ? 1 : 0;
+        if (state == 1)
+            atexit (report_at_exit);
+        if (espa_metrics_enabled ())
+            state = 1;
+        if (state == 1)
+            profile_start_ns = get_time_ns ();
+        __atomic_store_n (&profile_state, state, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        while ((state = __atomic_load_n (&profile_state, __ATOMIC_ACQUIRE))
+            == 2)
+            ;
+    }
+
+    return (state == 1);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_start
+
+PURPOSE:  Starts timing a call of a stage.
+
+RETURN VALUE:
+Type = Espa_profile_timer_t
+Value           Description
+-----           -----------
+timer           Timer to be passed to espa_profile_stop
+
+NOTES:
+  1. The timer does nothing if profiling is off or all the stage slots are
+     taken by other stages.
+******************************************************************************/
+Espa_profile_timer_t espa_profile_start
+(
+    const char *stage     /* I: name of the stage; must remain valid for the
+                                life of the process */
+)
+{
+    Espa_profile_timer_t timer;  /* timer of the call */
+    const char *name;            /* name of the stage in a slot */
+    int i;                       /* looping variable */
+
+    timer.stage = -1;
+    timer.start_ns = 0;
+    timer.start_faults = 0;
+    if (!espa_profile_enabled ())
+        return (timer);
+
+    /* Find the slot of the stage, claiming a free one the first time */
+    for (i = 0; i < ESPA_PROFILE_MAX_STAGES; i++)
+    {
+        name = __atomic_load_n (&profile_stage[i].name, __ATOMIC_ACQUIRE);
+        if (name == NULL && __atomic_compare_exchange_n
+            (&profile_stage[i].name, &name, stage, false, __ATOMIC_ACQ_REL,
+            __ATOMIC_ACQUIRE))
+            name = stage;
+        if (name == stage || !strcmp (name, stage))
+        {
+            timer.stage = i;
+            break;
+        }
+    }
+
+    timer.start_faults = get_minor_faults ();
+    timer.start_ns = get_time_ns ();
+    return (timer);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_stop
+
+PURPOSE:  Stops timing a call of a stage and adds it to the stage counters.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_profile_stop
+(
+    Espa_profile_timer_t *timer  /* I: timer returned by espa_profile_start */
+)
+{
+    Profile_stage_t *stage;   /* counters of the stage */
+    long long elapsed_ns;     /* time of the call */
+    long long max_ns;         /* longest call so far */
+
+    if (timer->stage < 0)
+        return;
+
+    elapsed_ns = get_time_ns () - timer->start_ns;
+    stage = &profile_stage[timer->stage];
+    __atomic_add_fetch (&stage->calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&stage->total_ns, elapsed_ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&stage->minor_faults, (long long)
+        (get_minor_faults () - timer->start_faults), __ATOMIC_RELAXED);
+
+    max_ns = __atomic_load_n (&stage->max_ns, __ATOMIC_RELAXED);
+    while (elapsed_ns > max_ns && !__atomic_compare_exchange_n
+        (&stage->max_ns, &max_ns, elapsed_ns, true, __ATOMIC_RELAXED,
+        __ATOMIC_RELAXED))
+        ;
+
+    espa_metrics_observe_stage (timer->stage, stage->name, elapsed_ns);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_count_io
+
+PURPOSE:  Counts a raw binary read, write or mapping.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The transfers of the S3 and pipe backends aren't added to the totals,
+     which the reads and writes of their streams already are.
+******************************************************************************/
+void espa_profile_count_io
+(
+    Espa_profile_io_t kind,  /* I: kind of I/O */
+    Espa_profile_backend_t backend,  /* I: backend of the I/O */
+    size_t nbytes            /* I: number of bytes read, written or mapped */
+)
+{
+    if (!espa_profile_enabled ())
+        return;
+
+    if (backend != ESPA_PROFILE_S3 && backend != ESPA_PROFILE_PIPE)
+    {
+        __atomic_add_fetch (&profile_io_bytes[kind], nbytes,
+            __ATOMIC_RELAXED);
+        __atomic_add_fetch (&profile_io_calls[kind], 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch (&profile_backend_bytes[backend][kind], nbytes,
+        __ATOMIC_RELAXED);
+    espa_metrics_count_io (kind, backend, nbytes);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_count_cache
+
+PURPOSE:  Counts a lookup of one of the caches of the libraries.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_profile_count_cache
+(
+    Espa_profile_cache_t cache,  /* I: cache looked up */
+    bool hit                     /* I: was the entry found? */
+)
+{
+    if (!espa_profile_enabled ())
+        return;
+
+    if (hit)
+        __atomic_add_fetch (&profile_cache_hits[cache], 1, __ATOMIC_RELAXED);
+    else
+        __atomic_add_fetch (&profile_cache_misses[cache], 1,
+            __ATOMIC_RELAXED);
+    espa_metrics_count_cache (cache, hit);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_set_gauge
+
+PURPOSE:  Sets the current value of a gauge of the process, keeping its peak.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_profile_set_gauge
+(
+    Espa_profile_gauge_t gauge,  /* I: gauge to be set */
+    long long value              /* I: current value of the gauge */
+)
+{
+    long long peak;       /* peak of the gauge so far */
+
+    if (!espa_profile_enabled ())
+        return;
+
+    peak = __atomic_load_n (&profile_gauge_peak[gauge], __ATOMIC_RELAXED);
+    while (value > peak && !__atomic_compare_exchange_n
+        (&profile_gauge_peak[gauge], &peak, value, true, __ATOMIC_RELAXED,
+        __ATOMIC_RELAXED))
+        ;
+    espa_metrics_set_gauge (gauge, value);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_count_alloc
+
+PURPOSE:  Counts a large buffer allocated by espa_alloc_large.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_profile_count_alloc
+(
+    Espa_profile_alloc_t kind,  /* I: kind of pages backing the buffer */
+    size_t nbytes               /* I: number of bytes allocated */
+)
+{
+    if (!espa_profile_enabled ())
+        return;
+
+    __atomic_add_fetch (&profile_alloc_bytes[kind], nbytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch (&profile_alloc_calls, 1, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_mark
+
+PURPOSE:  Records the time a milestone of the processing of a scene is
+reached.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Only the first time a milestone is marked is kept, so the first band
+     may be marked by every stage which completes bands, from any thread.
+     The times are from the start of profiling, which is the start of the
+     job in a forked worker (see espa_profile_reset).
+******************************************************************************/
+void espa_profile_mark
+(
+    Espa_profile_milestone_t milestone  /* I: milestone reached */
+)
+{
+    long long unmarked = 0;   /* time of a milestone not yet marked */
+    long long elapsed_ns;     /* time since profiling started */
+
+    if (!espa_profile_enabled ())
+        return;
+
+    elapsed_ns = get_time_ns () - profile_start_ns;
+    if (elapsed_ns < 1)
+        elapsed_ns = 1;
+    __atomic_compare_exchange_n (&profile_milestone_ns[milestone], &unmarked,
+        elapsed_ns, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_reset
+
+PURPOSE:  Clears the counters and restarts the profile clock.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Called by a process forked to run a scene or job, so its report only
+     holds its own work.  The slots keep their stage names.
+  2. The live metrics aren't reset, since they count the work of all the
+     jobs of a daemon.
+******************************************************************************/
+void espa_profile_reset (void)
+{
+    int i;                /* looping variable */
+    int j;                /* looping variable for the kinds of I/O */
+
+    if (!espa_profile_enabled ())
+        return;
+
+    for (i = 0; i < ESPA_PROFILE_MAX_STAGES; i++)
+    {
+        __atomic_store_n (&profile_stage[i].calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&profile_stage[i].total_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&profile_stage[i].max_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&profile_stage[i].minor_faults, 0,
+            __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        __atomic_store_n (&profile_io_bytes[i], 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&profile_io_calls[i], 0, __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < ESPA_PROFILE_NBACKENDS; i++)
+    {
+        for (j = 0; j < 3; j++)
+            __atomic_store_n (&profile_backend_bytes[i][j], 0,
+                __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < 4; i++)
+        __atomic_store_n (&profile_alloc_bytes[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n (&profile_alloc_calls, 0, __ATOMIC_RELAXED);
+    for (i = 0; i < ESPA_PROFILE_NCACHES; i++)
+    {
+        __atomic_store_n (&profile_cache_hits[i], 0, __ATOMIC_RELAXED);
+        __atomic_store_n (&profile_cache_misses[i], 0, __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < ESPA_PROFILE_NGAUGES; i++)
+        __atomic_store_n (&profile_gauge_peak[i], 0, __ATOMIC_RELAXED);
+    for (i = 0; i < ESPA_PROFILE_NMILESTONES; i++)
+        __atomic_store_n (&profile_milestone_ns[i], 0, __ATOMIC_RELAXED);
+    profile_start_ns = get_time_ns ();
+}
+
+
+/******************************************************************************
+MODULE:  espa_profile_report
+
+PURPOSE:  Writes the profile as a JSON line to the file named by ESPA_PROFILE,
+or to the standard error.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The line is written with a single write to a file opened for
+     appending, so the reports of concurrent processes don't interleave.
+  2. Called at exit once profiling is on.  A process which leaves with
+     _exit, such as a forked worker, calls it itself.
+******************************************************************************/
+void espa_profile_report (void)
+{
+    char FUNC_NAME[] = "espa_profile_report";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char report[PROFILE_REPORT_SIZE];  /* JSON line of the profile */
+    char milestone[ESPA_PROFILE_NMILESTONES][32];  /* time of each milestone
+                                 (seconds), or null */
+    char *env = getenv ("ESPA_PROFILE"); /* where the profile is written */
+    const char *name;     /* name of a stage */
+    size_t len = 0;       /* length of the report */
+    int nstages = 0;      /* number of stages reported */
+    int fd;               /* file the profile is written to */
+    int i;                /* looping variable */
+    struct rusage usage;  /* resource usage of the process */
+
+    if (!espa_profile_enabled () || env == NULL)
+        return;
+
+    getrusage (RUSAGE_SELF, &usage);
+    len += snprintf (report + len, sizeof (report) - len,
+        "{\"program\": \"%s\", \"pid\": %ld, \"seconds\": %.6f, "
+        "\"user_seconds\": %.6f, \"system_seconds\": %.6f, "
+        "\"peak_rss_kb\": %ld, \"minor_faults\": %ld, "
+        "\"major_faults\": %ld, \"io\": {\"read_bytes\": %llu, "
+        "\"read_calls\": %lu, \"write_bytes\": %llu, \"write_calls\": %lu, "
+        "\"mapped_bytes\": %llu, \"map_calls\": %lu, \"backends\": {",
+        program_invocation_short_name, (long) getpid (),
+        (get_time_ns () - profile_start_ns) * 1e-9,
+        usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6,
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6,
+        usage.ru_maxrss, usage.ru_minflt, usage.ru_majflt,
+        profile_io_bytes[ESPA_PROFILE_READ],
+        profile_io_calls[ESPA_PROFILE_READ],
+        profile_io_bytes[ESPA_PROFILE_WRITE],
+        profile_io_calls[ESPA_PROFILE_WRITE],
+        profile_io_bytes[ESPA_PROFILE_MAP],
+        profile_io_calls[ESPA_PROFILE_MAP]);
+    for (i = 0; i < ESPA_PROFILE_NBACKENDS && len < sizeof (report); i++)
+    {
+        len += snprintf (report + len, sizeof (report) - len,
+            "%s\"%s\": {\"read_bytes\": %llu, \"write_bytes\": %llu, "
+            "\"mapped_bytes\": %llu}", i > 0 ? ", " : "",
+            profile_backend_name[i],
+            profile_backend_bytes[i][ESPA_PROFILE_READ],
+            profile_backend_bytes[i][ESPA_PROFILE_WRITE],
+            profile_backend_bytes[i][ESPA_PROFILE_MAP]);
+    }
+    if (len < sizeof (report))
+        len += snprintf (report + len, sizeof (report) - len,
+            "}}, \"large_alloc\": {\"calls\": %lu, \"heap_bytes\": %llu, "
+            "\"page_bytes\": %llu, \"thp_bytes\": %llu, "
+            "\"hugetlb_bytes\": %llu}, \"caches\": {",
+            profile_alloc_calls,
+            profile_alloc_bytes[ESPA_PROFILE_ALLOC_HEAP],
+            profile_alloc_bytes[ESPA_PROFILE_ALLOC_PAGES],
+            profile_alloc_bytes[ESPA_PROFILE_ALLOC_THP],
+            profile_alloc_bytes[ESPA_PROFILE_ALLOC_HUGETLB]);
+    for (i = 0; i < ESPA_PROFILE_NCACHES && len < sizeof (report); i++)
+    {
+        len += snprintf (report + len, sizeof (report) - len,
+            "%s\"%s\": {\"hits\": %lu, \"misses\": %lu}",
+            i > 0 ? ", " : "", profile_cache_name[i], profile_cache_hits[i],
+            profile_cache_misses[i]);
+    }
+    for (i = 0; i < ESPA_PROFILE_NMILESTONES; i++)
+    {
+        if (profile_milestone_ns[i] == 0)
+            strcpy (milestone[i], "null");
+        else
+            snprintf (milestone[i], sizeof (milestone[i]), "%.6f",
+                profile_milestone_ns[i] * 1e-9);
+    }
+    if (len < sizeof (report))
+        len += snprintf (report + len, sizeof (report) - len,
+            "}, \"peaks\": {\"pool_in_use_bytes\": %lld, "
+            "\"pool_cached_bytes\": %lld, \"task_queue\": %lld}, "
+            "\"latency\": {\"first_band_seconds\": %s, "
+            "\"complete_seconds\": %s}, \"stages\": [",
+            profile_gauge_peak[ESPA_PROFILE_POOL_IN_USE],
+            profile_gauge_peak[ESPA_PROFILE_POOL_CACHED],
+            profile_gauge_peak[ESPA_PROFILE_TASK_QUEUE],
+            milestone[ESPA_PROFILE_FIRST_BAND],
+            milestone[ESPA_PROFILE_COMPLETE]);
+
+    /* The stage names are identifiers, so they aren't escaped */
+    for (i = 0; i < ESPA_PROFILE_MAX_STAGES && len < sizeof (report); i++)
+    {
+        name = __atomic_load_n (&profile_stage[i].name, __ATOMIC_ACQUIRE);
+        if (name == NULL)
+            break;
+        if (profile_stage[i].calls == 0)
+            continue;
+        len += snprintf (report + len, sizeof (report) - len,
+            "%s{\"name\": \"%s\", \"calls\": %lu, \"seconds\": %.6f, "
+            "\"max_seconds\": %.6f, \"minor_faults\": %lld}",
+            nstages > 0 ? ", " : "", name,
+            profile_stage[i].calls, profile_stage[i].total_ns * 1e-9,
+            profile_stage[i].max_ns * 1e-9, profile_stage[i].minor_faults);
+        nstages++;
+    }
+    if (len < sizeof (report))
+        len += snprintf (report + len, sizeof (report) - len, "]}\n");
+    if (len >= sizeof (report))
+    {   /* Too many stages to report; shouldn't happen */
+        sprintf (errmsg, "Profile is too large to be written");
+        error_handler (false, FUNC_NAME, errmsg);
+        return;
+    }
+
+    if (!strcmp (env, "stderr"))
+        fd = STDERR_FILENO;
+    else
+    {
+        fd = open (env, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Unable to open profile file "
+                "%s: %s", env, strerror (errno));
+            error_handler (false, FUNC_NAME, errmsg);
+            return;
+        }
+    }
+
+    if (write (fd, report, len) != (ssize_t) len)
+    {
+        sprintf (errmsg, "Unable to write the profile");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    if (fd != STDERR_FILENO)
+        close (fd);
+}
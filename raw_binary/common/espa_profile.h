@@ -0,0 +1,164 @@
+/*****************************************************************************
+FILE: espa_profile.h
+
+PURPOSE: Contains defines, structures and prototypes for profiling the time
+spent in the library stages and the raw binary I/O of a tool run.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Profiling is off unless the ESPA_PROFILE environment variable is set.
+     It is set to the name of a file the profile is appended to as a JSON
+     line when the process exits, or to stderr to write it to the standard
+     error.
+  2. A stage is timed from ESPA_PROFILE_SCOPE to the return of the function
+     it is used in, using the cleanup attribute of gcc.  The minor page
+     faults of the process during the stage are counted with its time.
+  3. The same counters feed the live metrics of a daemon when espa_metrics
+     is initialized (see espa_metrics.h), in which case the counting is on
+     even without ESPA_PROFILE.
+*****************************************************************************/
+
+#ifndef ESPA_PROFILE_H_
+#define ESPA_PROFILE_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Defines */
+/* Maximum number of stages profiled; later stages aren't timed */
+#define ESPA_PROFILE_MAX_STAGES 64
+
+/* Numbers of I/O backends, caches and gauges counted by the profiler */
+#define ESPA_PROFILE_NBACKENDS 6
+#define ESPA_PROFILE_NCACHES 6
+#define ESPA_PROFILE_NGAUGES 3
+#define ESPA_PROFILE_NMILESTONES 2
+
+/* Times the rest of the calling function as the named stage; must be the
+   last of the function's declarations */
+#define ESPA_PROFILE_SCOPE(stage) \
+    Espa_profile_timer_t espa_profile_scope_timer \
+        __attribute__ ((cleanup (espa_profile_stop))) = \
+        espa_profile_start (stage)
+
+/* Timer of one call of a stage */
+typedef struct
+{
+    int stage;            /* index of the stage; -1 if not timed */
+    long long start_ns;   /* time the call started (nanoseconds) */
+    long start_faults;    /* minor page faults when the call started */
+} Espa_profile_timer_t;
+
+/* Kinds of raw binary I/O counted by the profiler */
+typedef enum
+{
+    ESPA_PROFILE_READ,    /* data read from a band */
+    ESPA_PROFILE_WRITE,   /* data written to a band */
+    ESPA_PROFILE_MAP      /* band memory mapped */
+} Espa_profile_io_t;
+
+/* Backends the raw binary I/O goes through */
+typedef enum
+{
+    ESPA_PROFILE_STDIO,   /* buffered streams (fread, fwrite) */
+    ESPA_PROFILE_POSIX,   /* positional reads and writes of a descriptor */
+    ESPA_PROFILE_MMAP,    /* memory mapped bands */
+    ESPA_PROFILE_ASYNC,   /* asynchronous I/O (see raw_binary_async.h) */
+    ESPA_PROFILE_S3,      /* transfers with an object store; the reads and
+                             writes of the S3 streams are also counted as
+                             stdio */
+    ESPA_PROFILE_PIPE     /* band streams on pipes (see raw_binary_pipe.h);
+                             also counted as stdio */
+} Espa_profile_backend_t;
+
+/* Caches whose hits and misses are counted by the profiler */
+typedef enum
+{
+    ESPA_PROFILE_CACHE_SCHEMA,    /* compiled ESPA schema */
+    ESPA_PROFILE_CACHE_METADATA,  /* parsed metadata sidecars */
+    ESPA_PROFILE_CACHE_POLYGON,   /* resident packed land-mass polygon */
+    ESPA_PROFILE_CACHE_ANG,       /* parsed ANG files */
+    ESPA_PROFILE_CACHE_DERIVED,   /* derived band cache */
+    ESPA_PROFILE_CACHE_TRANSFORM  /* projection transformations */
+} Espa_profile_cache_t;
+
+/* Gauges of the process tracked by the profiler, which reports their peaks */
+typedef enum
+{
+    ESPA_PROFILE_POOL_IN_USE,     /* bytes of the buffer pool handed out */
+    ESPA_PROFILE_POOL_CACHED,     /* bytes of released buffers kept */
+    ESPA_PROFILE_TASK_QUEUE       /* tasks queued in the task pool */
+} Espa_profile_gauge_t;
+
+/* Milestones of the processing of a scene, reported as the time from the
+   start of profiling to the first time they are marked */
+typedef enum
+{
+    ESPA_PROFILE_FIRST_BAND,      /* first output band is complete */
+    ESPA_PROFILE_COMPLETE         /* all the outputs are complete */
+} Espa_profile_milestone_t;
+
+/* Kinds of pages backing the large buffers counted by the profiler (see
+   espa_alloc.h) */
+typedef enum
+{
+    ESPA_PROFILE_ALLOC_HEAP,     /* heap, for the smaller buffers */
+    ESPA_PROFILE_ALLOC_PAGES,    /* mapped normal pages */
+    ESPA_PROFILE_ALLOC_THP,      /* mapped, advised transparent huge pages */
+    ESPA_PROFILE_ALLOC_HUGETLB   /* mapped reserved huge pages */
+} Espa_profile_alloc_t;
+
+/* Prototypes */
+bool espa_profile_enabled (void);
+
+Espa_profile_timer_t espa_profile_start
+(
+    const char *stage     /* I: name of the stage; must remain valid for the
+                                life of the process */
+);
+
+void espa_profile_stop
+(
+    Espa_profile_timer_t *timer  /* I: timer returned by espa_profile_start */
+);
+
+void espa_profile_count_io
+(
+    Espa_profile_io_t kind,  /* I: kind of I/O */
+    Espa_profile_backend_t backend,  /* I: backend of the I/O */
+    size_t nbytes            /* I: number of bytes read, written or mapped */
+);
+
+void espa_profile_count_cache
+(
+    Espa_profile_cache_t cache,  /* I: cache looked up */
+    bool hit                     /* I: was the entry found? */
+);
+
+void espa_profile_set_gauge
+(
+    Espa_profile_gauge_t gauge,  /* I: gauge to be set */
+    long long value              /* I: current value of the gauge */
+);
+
+void espa_profile_count_alloc
+(
+    Espa_profile_alloc_t kind,  /* I: kind of pages backing the buffer */
+    size_t nbytes               /* I: number of bytes allocated */
+);
+
+void espa_profile_mark
+(
+    Espa_profile_milestone_t milestone  /* I: milestone reached */
+);
+
+void espa_profile_reset (void);
+
+void espa_profile_report (void);
+
+#endif
@@ -0,0 +1,138 @@
+/*****************************************************************************
+FILE: espa_progress.c
+
+PURPOSE: Contains functions for reporting the progress of the long-running
+library routines and for cancelling them cooperatively.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_progress.h for how the progress is installed and polled.
+*****************************************************************************/
+
+#include <stdio.h>
+#include "error_handler.h"
+#include "espa_progress.h"
+
+/* Progress of the job of the process; NULL if none is installed */
+static Espa_progress_t *volatile job_progress = NULL;
+
+/******************************************************************************
+MODULE:  espa_set_progress
+
+PURPOSE:  Installs the progress of the job of the process, which the library
+routines report to and poll for cancellation.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_set_progress
+(
+    Espa_progress_t *progress   /* I: progress of the job; NULL to remove
+                                      it.  Must remain valid while
+                                      installed. */
+)
+{
+    job_progress = progress;
+}
+
+
+/******************************************************************************
+MODULE:  espa_get_progress
+
+PURPOSE:  Returns the progress of the job of the process.
+
+RETURN VALUE:
+Type = Espa_progress_t *
+Value           Description
+-----           -----------
+NULL            No progress is installed
+other           Progress of the job
+
+NOTES:
+******************************************************************************/
+Espa_progress_t *espa_get_progress (void)
+{
+    return (job_progress);
+}
+
+
+/******************************************************************************
+MODULE:  espa_progress_cancelled
+
+PURPOSE:  Returns whether the job of the process has been cancelled.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           No progress is installed, or the job hasn't been cancelled
+true            The job has been cancelled
+
+NOTES:
+  1. This only reads the cancel flag, so it may be called from any thread,
+     e.g. by the workers of a parallel loop between their chunks.
+******************************************************************************/
+bool espa_progress_cancelled (void)
+{
+    Espa_progress_t *progress = job_progress;   /* progress of the job */
+
+    return (progress != NULL && progress->cancel);
+}
+
+
+/******************************************************************************
+MODULE:  espa_progress_update
+
+PURPOSE:  Reports the progress of a library routine and checks whether the
+job has been cancelled.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The job has been cancelled
+SUCCESS         The routine should continue
+
+NOTES:
+  1. The cancellation is reported as an error of the routine, so the caller
+     of the routine sees why it failed.
+  2. The fraction is clamped to 0 to 1 before it's reported.
+******************************************************************************/
+int espa_progress_update
+(
+    const char *routine,        /* I: name of the routine reporting */
+    double fraction             /* I: fraction of the routine's work done,
+                                      from 0 to 1 */
+)
+{
+    char FUNC_NAME[] = "espa_progress_update";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Espa_progress_t *progress = job_progress;   /* progress of the job */
+
+    if (progress == NULL)
+        return (SUCCESS);
+
+    if (progress->report != NULL && !progress->cancel)
+    {
+        if (fraction < 0.0)
+            fraction = 0.0;
+        else if (fraction > 1.0)
+            fraction = 1.0;
+        progress->report (progress, routine, fraction);
+    }
+
+    if (progress->cancel)
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s was cancelled", routine);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************
+FILE: espa_progress.h
+
+PURPOSE: Contains the structures and prototypes for reporting the progress
+of the long-running library routines and cancelling them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A caller wanting progress or cancellation installs an Espa_progress_t
+     with espa_set_progress before calling the routines.  The routines poll
+     it once per block of lines (or band) via espa_progress_update, which
+     calls the report routine and returns ERROR once the job is cancelled,
+     so the routine cleans up and returns ERROR like for any other error.
+  2. The progress is process-wide, like the memory budget (see
+     espa_memory.h), since the library routines process one job at a time
+     in a process.  The report routine is only called from the thread that
+     called the library routine.
+  3. cancel may be set at any time by the report routine, another thread,
+     or a signal handler (e.g. for a deadline, as the scene list workers do
+     with ESPA_SCENE_TIMEOUT; see espa_batch.h).
+  4. Without a progress installed, polling does nothing.
+*****************************************************************************/
+
+#ifndef ESPA_PROGRESS_H_
+#define ESPA_PROGRESS_H_
+
+#include <stdbool.h>
+#include <signal.h>
+
+typedef struct Espa_progress Espa_progress_t;
+
+/* Reports the progress of a library routine */
+typedef void (*Espa_progress_func_t)
+(
+    Espa_progress_t *progress,  /* I/O: progress being reported; cancel may
+                                        be set to cancel the job */
+    const char *routine,        /* I: name of the routine reporting */
+    double fraction             /* I: fraction of the routine's work done,
+                                      from 0 to 1 */
+);
+
+/* Progress and cancellation of the job of a process */
+struct Espa_progress
+{
+    Espa_progress_func_t report;  /* called as the work progresses; NULL to
+                                     only poll for cancellation */
+    void *data;                   /* data of the report routine */
+    volatile sig_atomic_t cancel; /* set non-zero to cancel the job */
+};
+
+/* Prototypes */
+void espa_set_progress
+(
+    Espa_progress_t *progress   /* I: progress of the job; NULL to remove
+                                      it.  Must remain valid while
+                                      installed. */
+);
+
+Espa_progress_t *espa_get_progress (void);
+
+bool espa_progress_cancelled (void);
+
+int espa_progress_update
+(
+    const char *routine,        /* I: name of the routine reporting */
+    double fraction             /* I: fraction of the routine's work done,
+                                      from 0 to 1 */
+);
+
+#endif
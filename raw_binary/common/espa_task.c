@@ -0,0 +1,715 @@
+/*****************************************************************************
+FILE: espa_task.c
+
+PURPOSE: Contains functions for the task runtime shared by the parallel
+stages: a pool of worker threads, each with its own deque of tasks, which
+steal tasks from the other deques when theirs is empty.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A thread pushes the tasks it submits on the head of its own deque and
+     takes its next task from the head, so a task's subtasks run while
+     their data is still in its cache.  Idle threads steal from the tails
+     of the other deques, taking the oldest (usually largest) tasks.
+     Threads which aren't workers share one more deque.
+  2. The pool is started the first time it is used.  A process forked
+     afterwards, such as a scene list worker, starts its own pool, since
+     the threads aren't copied by fork.
+  3. The workers are pinned to NUMA nodes when NUMA placement is on (see
+     espa_numa.h).
+  4. The error stack of a worker is cleared before each task, so the
+     message saved for a failed task is one it reported.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include "espa_numa.h"
+#include "espa_profile.h"
+#include "espa_tune.h"
+#include "espa_task.h"
+
+/* Task queued in a deque */
+typedef struct task
+{
+    Espa_task_func_t func;      /* task function */
+    void *arg;                  /* argument of the task */
+    Espa_task_group_t *group;   /* group of the task */
+    struct task *newer;         /* next task toward the head */
+    struct task *older;         /* next task toward the tail */
+} Task_t;
+
+/* Deque of tasks */
+typedef struct
+{
+    pthread_mutex_t lock;       /* protects the deque */
+    Task_t *head;               /* newest task, taken by the owner */
+    Task_t *tail;               /* oldest task, stolen by the others */
+} Task_deque_t;
+
+/* Pool of worker threads */
+typedef struct
+{
+    int nworkers;               /* number of worker threads */
+    Task_deque_t deque[ESPA_TASK_MAX_THREADS];  /* deque of each worker,
+                                   then the deque of the other threads */
+    int nqueued;                /* number of tasks in the deques */
+    pthread_mutex_t lock;       /* protects the sleeping and waking */
+    pthread_cond_t cond;        /* signaled when a task is queued or a
+                                   group is done */
+} Task_pool_t;
+
+/* Pool of the process, started the first time it is used */
+static Task_pool_t *task_pool = NULL;
+static pthread_mutex_t task_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Deque of the calling thread if it is a worker; -1 if it isn't */
+static __thread int task_worker = -1;
+
+/* Runners of espa_parallel_for */
+typedef struct
+{
+    Espa_task_group_t *group;   /* group of the runners */
+    Espa_range_func_t func;     /* chunk function */
+    void *arg;                  /* argument of the chunk function */
+    int first;                  /* first index of the range */
+    int end;                    /* index after the last one of the range */
+    int grain;                  /* number of indexes in each chunk */
+    int nchunks;                /* number of chunks */
+    int next_chunk;             /* next chunk to be handed out */
+} Task_range_t;
+
+typedef struct
+{
+    Task_range_t *range;        /* range of the runner */
+    int runner;                 /* number of the runner */
+} Task_runner_t;
+
+/******************************************************************************
+MODULE:  reset_task_pool
+
+PURPOSE:  Forgets the pool in a forked child, which doesn't have its
+threads, so the child starts a pool of its own.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The parent's pool is left allocated, since its locks may have been
+     held by the parent's threads when the child was forked.
+******************************************************************************/
+static void reset_task_pool (void)
+{
+    task_pool = NULL;
+    task_worker = -1;
+    pthread_mutex_init (&task_pool_lock, NULL);
+}
+
+
+/******************************************************************************
+MODULE:  take_task
+
+PURPOSE:  Takes a task from a deque, from its head or its tail.
+
+RETURN VALUE:
+Type = Task_t *
+Value           Description
+-----           -----------
+NULL            The deque is empty
+non-NULL        Task removed from the deque
+
+NOTES:
+******************************************************************************/
+static Task_t *take_task
+(
+    Task_pool_t *pool,    /* I/O: pool of the deque */
+    int index,            /* I: index of the deque */
+    bool head             /* I: take the newest task rather than the
+                                oldest? */
+)
+{
+    Task_deque_t *deque = &pool->deque[index];  /* deque taken from */
+    Task_t *task = NULL;  /* task taken */
+    int nqueued = 0;      /* number of tasks left in the deques */
+
+    pthread_mutex_lock (&deque->lock);
+    task = head ? deque->head : deque->tail;
+    if (task != NULL)
+    {
+        if (task->newer != NULL)
+            task->newer->older = task->older;
+        else
+            deque->head = task->older;
+        if (task->older != NULL)
+            task->older->newer = task->newer;
+        else
+            deque->tail = task->newer;
+        nqueued = __atomic_sub_fetch (&pool->nqueued, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock (&deque->lock);
+
+    if (task != NULL)
+        espa_profile_set_gauge (ESPA_PROFILE_TASK_QUEUE, nqueued);
+
+    return (task);
+}
+
+
+/******************************************************************************
+MODULE:  find_task
+
+PURPOSE:  Finds the next task for the calling thread: the newest task of its
+own deque, or else the oldest task of another deque.
+
+RETURN VALUE:
+Type = Task_t *
+Value           Description
+-----           -----------
+NULL            All the deques are empty
+non-NULL        Task to be run
+
+NOTES:
+******************************************************************************/
+static Task_t *find_task
+(
+    Task_pool_t *pool     /* I/O: pool of the tasks */
+)
+{
+    int own;              /* index of the calling thread's deque */
+    int ndeques = pool->nworkers + 1;  /* number of deques */
+    int i;                /* looping variable */
+    Task_t *task = NULL;  /* task found */
+
+    own = task_worker >= 0 ? task_worker : pool->nworkers;
+    task = take_task (pool, own, true);
+    for (i = 1; task == NULL && i < ndeques; i++)
+        task = take_task (pool, (own + i) % ndeques, false);
+
+    return (task);
+}
+
+
+/******************************************************************************
+MODULE:  run_task
+
+PURPOSE:  Runs a task and marks it finished in its group, saving its
+message in the group if it is the group's first failed task.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The group's waiters are woken once its last task is finished.
+******************************************************************************/
+static void run_task
+(
+    Task_pool_t *pool,    /* I/O: pool of the task */
+    Task_t *task          /* I: task to be run */
+)
+{
+    Espa_task_group_t *group = task->group;  /* group of the task */
+    int expected = SUCCESS;  /* status of the group before it failed */
+    int before;              /* number of messages before the task */
+
+    if (task_worker >= 0)
+        clear_thread_errors ();
+    before = get_thread_error_count ();
+
+    if (task->func (task->arg) != SUCCESS &&
+        __atomic_compare_exchange_n (&group->status, &expected, ERROR, false,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        /* Only keep a message the task itself reported */
+        if ((get_thread_error_count () > before ||
+            before == ERROR_STACK_SIZE) &&
+            get_thread_error (0, &group->error) == SUCCESS)
+        {
+            group->error_thread = pthread_self ();
+            group->has_error = true;
+        }
+    }
+
+    if (__atomic_sub_fetch (&group->pending, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        pthread_mutex_lock (&pool->lock);
+        pthread_cond_broadcast (&pool->cond);
+        pthread_mutex_unlock (&pool->lock);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  task_worker_main
+
+PURPOSE:  Runs the tasks of the pool, sleeping while there are none.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Never returns
+
+NOTES:
+******************************************************************************/
+static void *task_worker_main
+(
+    void *arg             /* I: index of the worker's deque */
+)
+{
+    Task_pool_t *pool = task_pool;  /* pool of the worker */
+    Task_t *task = NULL;  /* task to be run */
+
+    task_worker = (int) (intptr_t) arg;
+    espa_numa_bind_thread (task_worker + 1);
+
+    while (1)
+    {
+        task = find_task (pool);
+        if (task != NULL)
+        {
+            run_task (pool, task);
+            free (task);
+            continue;
+        }
+
+        pthread_mutex_lock (&pool->lock);
+        while (__atomic_load_n (&pool->nqueued, __ATOMIC_ACQUIRE) == 0)
+            pthread_cond_wait (&pool->cond, &pool->lock);
+        pthread_mutex_unlock (&pool->lock);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  get_task_pool
+
+PURPOSE:  Returns the pool of the process, starting it the first time.
+
+RETURN VALUE:
+Type = Task_pool_t *
+Value           Description
+-----           -----------
+NULL            Error allocating the pool
+non-NULL        Pool of the process
+
+NOTES:
+  1. If a worker can't be started, the pool runs with the workers already
+     started, or with none.
+  2. The number of threads is ESPA_TASK_THREADS, else task_threads of the
+     node profile (see espa_tune.h), else the number of CPUs.
+******************************************************************************/
+static Task_pool_t *get_task_pool (void)
+{
+    char FUNC_NAME[] = "get_task_pool";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    static bool atfork_set = false;  /* is the fork handler registered? */
+    Task_pool_t *pool = NULL;   /* new pool */
+    int nthreads = 1;        /* number of threads running tasks */
+    int i;                   /* looping variable */
+    char *env = NULL;        /* value of ESPA_TASK_THREADS */
+    pthread_t thread;        /* new worker */
+    pthread_attr_t attr;     /* attributes of the workers */
+#ifdef _OPENMP
+    cpu_set_t allowed;       /* CPUs the process may run on */
+#endif
+
+    pool = __atomic_load_n (&task_pool, __ATOMIC_ACQUIRE);
+    if (pool != NULL)
+        return (pool);
+
+    pthread_mutex_lock (&task_pool_lock);
+    if (task_pool != NULL)
+    {
+        pthread_mutex_unlock (&task_pool_lock);
+        return (task_pool);
+    }
+
+#ifdef _OPENMP
+    env = getenv ("ESPA_TASK_THREADS");
+    if (env != NULL && env[0] != '\0')
+        nthreads = atoi (env);
+    else if (espa_tune_int ("task_threads", 0) > 0)
+        nthreads = espa_tune_int ("task_threads", 0);
+    else if (sched_getaffinity (0, sizeof (allowed), &allowed) == 0)
+        nthreads = CPU_COUNT (&allowed);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > ESPA_TASK_MAX_THREADS)
+        nthreads = ESPA_TASK_MAX_THREADS;
+#else
+    (void) env;
+#endif
+
+    pool = calloc (1, sizeof (Task_pool_t));
+    if (pool == NULL)
+    {
+        pthread_mutex_unlock (&task_pool_lock);
+        sprintf (errmsg, "Allocating the task pool");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    for (i = 0; i < nthreads; i++)
+        pthread_mutex_init (&pool->deque[i].lock, NULL);
+    pthread_mutex_init (&pool->lock, NULL);
+    pthread_cond_init (&pool->cond, NULL);
+    __atomic_store_n (&task_pool, pool, __ATOMIC_RELEASE);
+
+    if (!atfork_set)
+    {
+        pthread_atfork (NULL, NULL, reset_task_pool);
+        atfork_set = true;
+    }
+
+    /* The workers are detached and live as long as the process */
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < nthreads - 1; i++)
+    {
+        /* Count the worker first, so its deque is searched once it runs */
+        pool->nworkers = i + 1;
+        if (pthread_create (&thread, &attr, task_worker_main,
+            (void *) (intptr_t) i) != 0)
+        {
+            pool->nworkers = i;
+            sprintf (errmsg, "Unable to start task worker %d; using %d "
+                "workers", i, i);
+            error_handler (false, FUNC_NAME, errmsg);
+            break;
+        }
+    }
+    pthread_attr_destroy (&attr);
+    pthread_mutex_unlock (&task_pool_lock);
+
+    return (pool);
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_nthreads
+
+PURPOSE:  Returns the number of threads which run tasks, with the waiting
+thread.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+1               Threading isn't enabled, or there are no workers
+other           Number of workers plus one
+
+NOTES:
+******************************************************************************/
+int espa_task_nthreads (void)
+{
+    Task_pool_t *pool = get_task_pool ();  /* pool of the process */
+
+    return (pool == NULL ? 1 : pool->nworkers + 1);
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_init
+
+PURPOSE:  Initializes an empty task group.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void espa_task_group_init
+(
+    Espa_task_group_t *group  /* O: empty task group */
+)
+{
+    memset (group, 0, sizeof (Espa_task_group_t));
+    group->status = SUCCESS;
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_submit
+
+PURPOSE:  Submits a task to the pool as part of a task group.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The task runs in the calling thread if there are no workers or the
+     task can't be queued.  Its failure is reported by
+     espa_task_group_wait either way.
+******************************************************************************/
+void espa_task_submit
+(
+    Espa_task_group_t *group, /* I/O: group of the task */
+    Espa_task_func_t func,    /* I: task function */
+    void *arg                 /* I: argument of the task; must remain valid
+                                    until the group is waited on */
+)
+{
+    Task_pool_t *pool = get_task_pool ();  /* pool of the process */
+    Task_deque_t *deque = NULL;  /* deque of the calling thread */
+    Task_t local;         /* task run in the calling thread */
+    Task_t *task = NULL;  /* task queued */
+    int nqueued;          /* number of tasks in the deques */
+
+    __atomic_add_fetch (&group->pending, 1, __ATOMIC_ACQ_REL);
+    if (pool != NULL && pool->nworkers > 0)
+        task = malloc (sizeof (Task_t));
+    if (task == NULL)
+    {
+        local.func = func;
+        local.arg = arg;
+        local.group = group;
+        if (pool != NULL)
+            run_task (pool, &local);
+        else
+        {   /* Without a pool there is no one to wake */
+            if (func (arg) != SUCCESS)
+                group->status = ERROR;
+            __atomic_sub_fetch (&group->pending, 1, __ATOMIC_ACQ_REL);
+        }
+        return;
+    }
+
+    task->func = func;
+    task->arg = arg;
+    task->group = group;
+    task->newer = NULL;
+    deque = &pool->deque[task_worker >= 0 ? task_worker : pool->nworkers];
+    pthread_mutex_lock (&deque->lock);
+    task->older = deque->head;
+    if (deque->head != NULL)
+        deque->head->newer = task;
+    else
+        deque->tail = task;
+    deque->head = task;
+    nqueued = __atomic_add_fetch (&pool->nqueued, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock (&deque->lock);
+    espa_profile_set_gauge (ESPA_PROFILE_TASK_QUEUE, nqueued);
+
+    pthread_mutex_lock (&pool->lock);
+    pthread_cond_signal (&pool->cond);
+    pthread_mutex_unlock (&pool->lock);
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_failed
+
+PURPOSE:  Returns whether a task of the group has failed, so the other tasks
+can stop early.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            A task of the group has failed
+false           None of the finished tasks has failed
+
+NOTES:
+******************************************************************************/
+bool espa_task_group_failed
+(
+    Espa_task_group_t *group  /* I: task group */
+)
+{
+    return (__atomic_load_n (&group->status, __ATOMIC_ACQUIRE) != SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_task_group_wait
+
+PURPOSE:  Waits for the tasks of a group to finish, running queued tasks in
+the meantime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           At least one task of the group failed
+SUCCESS         All the tasks of the group succeeded
+
+NOTES:
+  1. If the first failed task ran in another thread, its last message is
+     saved in the error stack of the calling thread, without printing it
+     again (see save_thread_error).
+  2. The message is only saved by the first wait, so a group waited on more
+     than once (e.g. to bound the tasks in flight) doesn't repeat it.  A
+     group is initialized again before it is reused for other tasks.
+******************************************************************************/
+int espa_task_group_wait
+(
+    Espa_task_group_t *group  /* I/O: task group */
+)
+{
+    Task_pool_t *pool = get_task_pool ();  /* pool of the process */
+    Task_t *task = NULL;  /* task run while waiting */
+
+    while (pool != NULL &&
+        __atomic_load_n (&group->pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        task = find_task (pool);
+        if (task != NULL)
+        {
+            run_task (pool, task);
+            free (task);
+            continue;
+        }
+
+        pthread_mutex_lock (&pool->lock);
+        while (__atomic_load_n (&group->pending, __ATOMIC_ACQUIRE) > 0 &&
+            __atomic_load_n (&pool->nqueued, __ATOMIC_ACQUIRE) == 0)
+            pthread_cond_wait (&pool->cond, &pool->lock);
+        pthread_mutex_unlock (&pool->lock);
+    }
+
+    if (group->status != SUCCESS && group->has_error &&
+        !pthread_equal (group->error_thread, pthread_self ()))
+    {
+        save_thread_error (&group->error);
+        group->has_error = false;
+    }
+
+    return (group->status);
+}
+
+
+/******************************************************************************
+MODULE:  run_task_range
+
+PURPOSE:  Runs the chunks of a range handed out to a runner, until there are
+none left or one has failed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A chunk failed
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+static int run_task_range
+(
+    void *arg             /* I: runner (Task_runner_t) */
+)
+{
+    Task_runner_t *runner = arg;          /* runner */
+    Task_range_t *range = runner->range;  /* range of the runner */
+    int chunk;            /* chunk handed out */
+    int first;            /* first index of the chunk */
+    int end;              /* index after the last one of the chunk */
+
+    while (!espa_task_group_failed (range->group))
+    {
+        chunk = __atomic_fetch_add (&range->next_chunk, 1, __ATOMIC_RELAXED);
+        if (chunk >= range->nchunks)
+            break;
+
+        first = range->first + chunk * range->grain;
+        end = first + range->grain;
+        if (end > range->end)
+            end = range->end;
+        if (range->func (range->arg, first, end, runner->runner) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  espa_parallel_for
+
+PURPOSE:  Runs a chunk function over a range of indexes, handing the chunks
+out to up to nthreads runners.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A chunk failed
+SUCCESS         All the chunks succeeded
+
+NOTES:
+  1. The calling thread is runner 0.  The number of runners is also limited
+     by the number of chunks and the threads of the pool.
+  2. A runner number is only used by one thread at a time.
+******************************************************************************/
+int espa_parallel_for
+(
+    int first,                /* I: first index of the range */
+    int end,                  /* I: index after the last one of the range */
+    int grain,                /* I: number of indexes in each chunk */
+    int nthreads,             /* I: largest number of runners */
+    Espa_range_func_t func,   /* I: chunk function */
+    void *arg                 /* I: argument of the chunk function */
+)
+{
+    Task_pool_t *pool = get_task_pool ();  /* pool of the process */
+    Espa_task_group_t group;  /* group of the runners */
+    Task_t local;             /* runner run in the calling thread */
+    Task_range_t range;       /* range handed out */
+    Task_runner_t runner[ESPA_TASK_MAX_THREADS];  /* runners */
+    int nrunners;             /* number of runners */
+    int i;                    /* looping variable */
+
+    if (end <= first)
+        return (SUCCESS);
+    if (grain < 1)
+        grain = 1;
+
+    espa_task_group_init (&group);
+    range.group = &group;
+    range.func = func;
+    range.arg = arg;
+    range.first = first;
+    range.end = end;
+    range.grain = grain;
+    range.nchunks = (int) (((long long) end - first + grain - 1) / grain);
+    range.next_chunk = 0;
+
+    nrunners = nthreads;
+    if (nrunners > range.nchunks)
+        nrunners = range.nchunks;
+    if (nrunners > espa_task_nthreads ())
+        nrunners = espa_task_nthreads ();
+    if (nrunners < 1)
+        nrunners = 1;
+
+    for (i = 0; i < nrunners; i++)
+    {
+        runner[i].range = &range;
+        runner[i].runner = i;
+    }
+    for (i = 1; i < nrunners; i++)
+        espa_task_submit (&group, run_task_range, &runner[i]);
+
+    /* The calling thread is the first runner */
+    local.func = run_task_range;
+    local.arg = &runner[0];
+    local.group = &group;
+    __atomic_add_fetch (&group.pending, 1, __ATOMIC_ACQ_REL);
+    if (pool != NULL)
+        run_task (pool, &local);
+    else
+    {
+        if (run_task_range (&runner[0]) != SUCCESS)
+            group.status = ERROR;
+        group.pending--;
+    }
+
+    return (espa_task_group_wait (&group));
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************
+FILE: espa_task.h
+
+PURPOSE: Contains the defines, structures and prototypes for the task
+runtime shared by the parallel stages of the libraries: a pool of worker
+threads which balance the load by stealing tasks from each other.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A task is a function returning SUCCESS or ERROR.  Tasks are submitted
+     to a task group and the group is waited on; the wait returns ERROR if
+     any of its tasks failed, and the last message the first failed task
+     reported (see error_handler.h) is saved in the error stack of the
+     waiting thread.
+  2. espa_parallel_for splits a range of lines, tiles or bands into chunks
+     which are handed out to up to nthreads runners as each one finishes
+     its previous chunk, so uneven chunks are balanced.  Each runner has a
+     number below nthreads, so it can use a per-thread resource such as a
+     file handle.  Once a chunk fails, the chunks not yet started are
+     skipped.
+  3. The threads only exist when threading is enabled (ENABLE_THREADING=yes,
+     which builds with OpenMP).  Otherwise the tasks run in the calling
+     thread, one after the other.  The number of workers is the number of
+     CPUs the process may use less one, since the waiting thread runs tasks
+     too, or ESPA_TASK_THREADS less one if it is set, or task_threads of
+     the node profile less one if it is set.
+  4. A thread waiting on a group runs the queued tasks until the group is
+     done, so tasks may submit and wait on groups of their own.
+*****************************************************************************/
+
+#ifndef ESPA_TASK_H_
+#define ESPA_TASK_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "error_handler.h"
+
+/* Defines */
+/* Largest number of threads running tasks, with the waiting thread */
+#define ESPA_TASK_MAX_THREADS 64
+
+/* Task function; returns SUCCESS or ERROR */
+typedef int (*Espa_task_func_t)
+(
+    void *arg             /* I: argument given when the task was submitted */
+);
+
+/* Chunk function of espa_parallel_for; returns SUCCESS or ERROR */
+typedef int (*Espa_range_func_t)
+(
+    void *arg,            /* I: argument given to espa_parallel_for */
+    int first,            /* I: first index of the chunk */
+    int end,              /* I: index after the last one of the chunk */
+    int runner            /* I: number of the runner, below nthreads */
+);
+
+/* Group of tasks waited on together */
+typedef struct
+{
+    int pending;          /* number of tasks not yet finished */
+    int status;           /* SUCCESS, or ERROR once a task has failed */
+    bool has_error;       /* was a message saved for the failed task? */
+    pthread_t error_thread;  /* thread which ran the failed task */
+    Error_entry_t error;  /* last message of the first failed task */
+} Espa_task_group_t;
+
+/* Prototypes */
+int espa_task_nthreads (void);
+
+void espa_task_group_init
+(
+    Espa_task_group_t *group  /* O: empty task group */
+);
+
+void espa_task_submit
+(
+    Espa_task_group_t *group, /* I/O: group of the task */
+    Espa_task_func_t func,    /* I: task function */
+    void *arg                 /* I: argument of the task; must remain valid
+                                    until the group is waited on */
+);
+
+bool espa_task_group_failed
+(
+    Espa_task_group_t *group  /* I: task group */
+);
+
+int espa_task_group_wait
+(
+    Espa_task_group_t *group  /* I/O: task group */
+);
+
+int espa_parallel_for
+(
+    int first,                /* I: first index of the range */
+    int end,                  /* I: index after the last one of the range */
+    int grain,                /* I: number of indexes in each chunk */
+    int nthreads,             /* I: largest number of runners */
+    Espa_range_func_t func,   /* I: chunk function */
+    void *arg                 /* I: argument of the chunk function */
+);
+
+#endif
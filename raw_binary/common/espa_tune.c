@@ -0,0 +1,348 @@
+/*****************************************************************************
+FILE: espa_tune.c
+
+PURPOSE: Contains functions for reading the settings of the node profile
+written by espa_autotune, and for writing the profile.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Malformed lines of the profile are reported as warnings and skipped,
+     since a bad profile shouldn't stop the processing; the defaults are
+     used instead.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "error_handler.h"
+#include "espa_tune.h"
+
+static Espa_tune_entry_t tune_entry[ESPA_TUNE_MAX_ENTRIES];
+static int tune_nentries = 0;
+static pthread_once_t tune_once = PTHREAD_ONCE_INIT;
+
+/******************************************************************************
+MODULE:  trim_tune_string
+
+PURPOSE:  Removes the leading and trailing white space of a string.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+non-NULL        Start of the trimmed string, within the input string
+
+NOTES:
+******************************************************************************/
+static char *trim_tune_string
+(
+    char *str             /* I/O: string to be trimmed */
+)
+{
+    char *end = NULL;     /* last character of the string */
+
+    while (isspace ((unsigned char) *str))
+        str++;
+
+    end = str + strlen (str);
+    while (end > str && isspace ((unsigned char) end[-1]))
+        end--;
+    *end = '\0';
+
+    return (str);
+}
+
+
+/******************************************************************************
+MODULE:  load_tune_profile
+
+PURPOSE:  Reads the settings of the node profile; the once routine of the
+profile.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A later setting of the same key replaces the earlier one.
+******************************************************************************/
+static void load_tune_profile (void)
+{
+    char FUNC_NAME[] = "load_tune_profile";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char line[STR_SIZE];      /* current line of the profile */
+    char *file = getenv ("ESPA_NODE_PROFILE");  /* profile to be read */
+    char *key = NULL;         /* key of the current line */
+    char *value = NULL;       /* value of the current line */
+    char *eq = NULL;          /* equals sign of the current line */
+    int nline = 0;            /* number of the current line */
+    int i;                    /* looping variable for the settings */
+    bool is_default = false;  /* is the default profile read? */
+    FILE *fp = NULL;          /* profile */
+
+    if (file != NULL && !strcmp (file, "off"))
+        return;
+    if (file == NULL || file[0] == '\0')
+    {
+        file = ESPA_TUNE_DEFAULT_PROFILE;
+        is_default = true;
+    }
+
+    fp = fopen (file, "r");
+    if (fp == NULL)
+    {
+        if (!is_default || errno != ENOENT)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Unable to read the node "
+                "profile %s; using the default settings", file);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+        return;
+    }
+
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        nline++;
+        key = trim_tune_string (line);
+        if (key[0] == '\0' || key[0] == '#')
+            continue;
+
+        eq = strchr (key, '=');
+        if (eq == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Skipping line %d of the node "
+                "profile %s, which isn't key = value", nline, file);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+        *eq = '\0';
+        key = trim_tune_string (key);
+        value = trim_tune_string (eq + 1);
+        if (key[0] == '\0' || strlen (key) >= ESPA_TUNE_KEY_SIZE ||
+            strlen (value) >= ESPA_TUNE_VALUE_SIZE)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Skipping line %d of the node "
+                "profile %s, whose key or value is invalid", nline, file);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        for (i = 0; i < tune_nentries; i++)
+        {
+            if (!strcmp (tune_entry[i].key, key))
+                break;
+        }
+        if (i == ESPA_TUNE_MAX_ENTRIES)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Skipping line %d of the node "
+                "profile %s, which has more than %d settings", nline, file,
+                ESPA_TUNE_MAX_ENTRIES);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        strcpy (tune_entry[i].key, key);
+        strcpy (tune_entry[i].value, value);
+        if (i == tune_nentries)
+            tune_nentries++;
+    }
+
+    fclose (fp);
+}
+
+
+/******************************************************************************
+MODULE:  espa_tune_value
+
+PURPOSE:  Returns the value of a setting of the node profile.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            The profile doesn't set the key
+non-NULL        Value of the setting
+
+NOTES:
+******************************************************************************/
+const char *espa_tune_value
+(
+    const char *key       /* I: name of the setting */
+)
+{
+    int i;                /* looping variable for the settings */
+
+    pthread_once (&tune_once, load_tune_profile);
+    for (i = 0; i < tune_nentries; i++)
+    {
+        if (!strcmp (tune_entry[i].key, key))
+            return (tune_entry[i].value);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  espa_tune_int
+
+PURPOSE:  Returns the value of an integer setting of the node profile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+default_value   The profile doesn't set the key, or its value isn't an
+                integer
+other           Value of the setting
+
+NOTES:
+******************************************************************************/
+int espa_tune_int
+(
+    const char *key,      /* I: name of the setting */
+    int default_value     /* I: value if the profile doesn't set it */
+)
+{
+    const char *value = espa_tune_value (key);  /* value of the setting */
+    char *end = NULL;     /* end of the number */
+    long number;          /* value as a number */
+
+    if (value == NULL)
+        return (default_value);
+
+    errno = 0;
+    number = strtol (value, &end, 10);
+    if (end == value || *end != '\0' || errno != 0 || number < -2147483647L
+        || number > 2147483647L)
+        return (default_value);
+
+    return ((int) number);
+}
+
+
+/******************************************************************************
+MODULE:  espa_tune_line_block
+
+PURPOSE:  Returns the number of lines of the blocks of a line-streaming stage,
+from the node profile if it sets line_block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+> 0             Number of lines in a block
+
+NOTES:
+  1. The profile value is limited to ESPA_TUNE_MIN_LINES to
+     ESPA_TUNE_MAX_LINES.  The memory budget is applied to the result by the
+     caller (see espa_budget_lines).
+******************************************************************************/
+int espa_tune_line_block
+(
+    int default_lines     /* I: built-in number of lines of the block */
+)
+{
+    int lines = espa_tune_int ("line_block", 0);  /* lines of the profile */
+
+    if (lines <= 0)
+        return (default_lines);
+    if (lines < ESPA_TUNE_MIN_LINES)
+        return (ESPA_TUNE_MIN_LINES);
+    if (lines > ESPA_TUNE_MAX_LINES)
+        return (ESPA_TUNE_MAX_LINES);
+
+    return (lines);
+}
+
+
+/******************************************************************************
+MODULE:  write_espa_tune_profile
+
+PURPOSE:  Writes a node profile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the profile
+SUCCESS         Successfully wrote the profile
+
+NOTES:
+  1. The profile is written to a temporary file which is renamed into place,
+     so processes starting meanwhile read either the old or the new
+     profile.
+******************************************************************************/
+int write_espa_tune_profile
+(
+    const char *file,     /* I: profile to be written */
+    const char *comment,  /* I: comment written at the top of the profile;
+                                may have several lines; NULL for none */
+    int nentries,         /* I: number of settings */
+    const Espa_tune_entry_t *entries  /* I: settings of the profile */
+)
+{
+    char FUNC_NAME[] = "write_espa_tune_profile";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char tmp_file[STR_SIZE];  /* temporary profile */
+    const char *cptr = NULL;  /* current line of the comment */
+    const char *eol = NULL;   /* end of the current line of the comment */
+    int count;                /* number of chars copied in snprintf */
+    int i;                    /* looping variable for the settings */
+    int status = SUCCESS;     /* return status */
+    FILE *fp = NULL;          /* temporary profile */
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.%ld", file,
+        (long) getpid ());
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of the temporary profile filename");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = fopen (tmp_file, "w");
+    if (fp == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the node profile %s",
+            tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (cptr = comment; cptr != NULL && *cptr != '\0'; cptr = eol)
+    {
+        eol = strchr (cptr, '\n');
+        if (eol == NULL)
+            eol = cptr + strlen (cptr);
+        fprintf (fp, "# %.*s\n", (int) (eol - cptr), cptr);
+        if (*eol == '\n')
+            eol++;
+    }
+    for (i = 0; i < nentries; i++)
+        fprintf (fp, "%s = %s\n", entries[i].key, entries[i].value);
+
+    if (ferror (fp))
+        status = ERROR;
+    if (fclose (fp) != 0)
+        status = ERROR;
+    if (status == SUCCESS && rename (tmp_file, file) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        unlink (tmp_file);
+        snprintf (errmsg, sizeof (errmsg), "Writing the node profile %s",
+            file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
@@ -0,0 +1,89 @@
+/*****************************************************************************
+FILE: espa_tune.h
+
+PURPOSE: Contains the defines, structures and prototypes for the node
+profile, which gives the library routines the line block size, thread count
+and write cache handling measured to be fastest on the node by
+espa_autotune.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The profile is the file named by the ESPA_NODE_PROFILE environment
+     variable, or ESPA_TUNE_DEFAULT_PROFILE if it isn't set.  Setting
+     ESPA_NODE_PROFILE to "off" ignores the profile.  A missing default
+     profile isn't an error, so nodes which haven't been tuned keep the
+     built-in defaults.
+  2. Each line of the profile is "key = value"; blank lines and lines
+     starting with # are ignored.  The keys read by the libraries are:
+       task_threads  number of threads of the task pool (see espa_task.h)
+       line_block    number of lines in the blocks of the line-streaming
+                     stages (TOA, QA masks, date bands, spatial subset and
+                     derived bands)
+       write_cache   page cache handling of the written bands: normal,
+                     dontneed or direct (see get_raw_binary_cache_mode)
+  3. The environment variables of a setting (ESPA_TASK_THREADS,
+     ESPA_WRITE_CACHE) override the profile, and the memory budget (see
+     espa_memory.h) still shrinks the blocks and threads to fit.
+  4. The profile is read once, on first use, and is shared by the threads of
+     the process.
+*****************************************************************************/
+
+#ifndef ESPA_TUNE_H_
+#define ESPA_TUNE_H_
+
+#include <stdbool.h>
+#include "espa_common.h"
+
+/* Defines */
+/* Profile read when ESPA_NODE_PROFILE isn't set */
+#define ESPA_TUNE_DEFAULT_PROFILE "/etc/espa/node_profile"
+
+/* Largest number of settings in a profile */
+#define ESPA_TUNE_MAX_ENTRIES 64
+
+/* Largest length of the key and value of a setting */
+#define ESPA_TUNE_KEY_SIZE 64
+#define ESPA_TUNE_VALUE_SIZE 256
+
+/* Range of the line block sizes taken from the profile */
+#define ESPA_TUNE_MIN_LINES 16
+#define ESPA_TUNE_MAX_LINES 8192
+
+/* Setting of the node profile */
+typedef struct
+{
+    char key[ESPA_TUNE_KEY_SIZE];      /* name of the setting */
+    char value[ESPA_TUNE_VALUE_SIZE];  /* value of the setting */
+} Espa_tune_entry_t;
+
+/* Prototypes */
+const char *espa_tune_value
+(
+    const char *key       /* I: name of the setting */
+);
+
+int espa_tune_int
+(
+    const char *key,      /* I: name of the setting */
+    int default_value     /* I: value if the profile doesn't set it */
+);
+
+int espa_tune_line_block
+(
+    int default_lines     /* I: built-in number of lines of the block */
+);
+
+int write_espa_tune_profile
+(
+    const char *file,     /* I: profile to be written */
+    const char *comment,  /* I: comment written at the top of the profile;
+                                may have several lines; NULL for none */
+    int nentries,         /* I: number of settings */
+    const Espa_tune_entry_t *entries  /* I: settings of the profile */
+);
+
+#endif
@@ -17,6 +17,167 @@ NOTES:
 *****************************************************************************/
 #include <unistd.h>
 #include "convert_espa_to_gtif.h"
+#include "espa_memory.h"
+#include "espa_task.h"
+#include "espa_profile.h"
+
+/* GeoTIFF file written by export_gtif_files */
+typedef struct
+{
+    char name[STR_SIZE];      /* name of the GeoTIFF file */
+    int ngroup;               /* number of bands written to the file */
+    Espa_band_meta_t **group; /* bands written to the file */
+} Gtif_file_t;
+
+/* GeoTIFF files written by export_gtif_files */
+typedef struct
+{
+    Gtif_file_t *file;        /* files to be written */
+    Espa_global_meta_t *gmeta;  /* global metadata of the product */
+    Gtif_compress_t compress; /* compression of the GeoTIFF tiles */
+    bool cog;                 /* write Cloud-Optimized GeoTIFFs? */
+    Gtif_interleave_t interleave;  /* layout of the multi-band files */
+    bool del_src;             /* remove the source bands? */
+    bool reclaim_src;         /* reclaim the source bands as they're read? */
+} Gtif_file_list_t;
+
+/******************************************************************************
+MODULE:  remove_espa_band
+
+PURPOSE: Removes the raw binary image and ENVI header files of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error removing the files
+SUCCESS         Successfully removed the files
+
+NOTES:
+******************************************************************************/
+static int remove_espa_band
+(
+    char *img_file         /* I: name of the raw binary image file */
+)
+{
+    char FUNC_NAME[] = "remove_espa_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char hdr_file[STR_SIZE];    /* name of the header file for this band */
+    char *cptr = NULL;          /* pointer to the file extension */
+    int count;                  /* number of chars copied in snprintf */
+
+    /* .img file */
+    printf ("  Removing %s\n", img_file);
+    if (unlink (img_file) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* .hdr file */
+    count = snprintf (hdr_file, sizeof (hdr_file), "%s", img_file);
+    if (count < 0 || count >= sizeof (hdr_file))
+    {
+        sprintf (errmsg, "Overflow of hdr_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (hdr_file, '.');
+    strcpy (cptr, ".hdr");
+    printf ("  Removing %s\n", hdr_file);
+    if (unlink (hdr_file) != 0)
+    {
+        sprintf (errmsg, "Deleting source file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  export_gtif_files
+
+PURPOSE: Writes a range of the GeoTIFF files of the product, each from its
+own bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing a file
+SUCCESS         Successful completion
+
+NOTES:
+  1. Called by espa_parallel_for from convert_espa_to_gtif.
+  2. Each file is written with its own TIFF handle, and only the bands of
+     the file are updated with the new file name.
+******************************************************************************/
+static int export_gtif_files
+(
+    void *arg,             /* I: files being written (Gtif_file_list_t) */
+    int first,             /* I: first file of the range */
+    int end,               /* I: file after the range */
+    int runner             /* I: number of the thread (unused) */
+)
+{
+    char FUNC_NAME[] = "export_gtif_files";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Gtif_file_list_t *list = arg;  /* files being written */
+    Gtif_file_t *file = NULL;   /* current file */
+    int i, j;                   /* looping variables for files and bands */
+    int status;                 /* return status of the conversion */
+
+    for (i = first; i < end; i++)
+    {
+        file = &list->file[i];
+        if (file->ngroup > 1)
+        {
+            printf ("Converting %d %s bands to %s\n", file->ngroup,
+                file->group[0]->product, file->name);
+            status = write_gtif_multiband (file->name, file->ngroup,
+                file->group, list->gmeta, list->compress, list->interleave,
+                list->reclaim_src);
+        }
+        else
+        {
+            printf ("Converting %s to %s\n", file->group[0]->file_name,
+                file->name);
+            status = write_gtif_band (file->group[0]->file_name, file->name,
+                file->group[0], list->gmeta, list->compress, list->cog,
+                list->reclaim_src);
+        }
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Converting %s to GeoTIFF",
+                file->group[0]->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (j = 0; j < file->ngroup; j++)
+        {
+            /* Remove the source files if specified */
+            if (list->del_src &&
+                remove_espa_band (file->group[j]->file_name) != SUCCESS)
+            {
+                sprintf (errmsg, "Removing the source files of band %s",
+                    file->group[j]->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Update the XML file to use the new GeoTIFF band name */
+            strcpy (file->group[j]->file_name, file->name);
+        }
+    }
+
+    return (SUCCESS);
+}
+
 
 /******************************************************************************
 MODULE:  convert_espa_to_gtif
@@ -31,31 +192,71 @@ ERROR           Error converting to GeoTIFF
 SUCCESS         Successfully converted to GeoTIFF
 
 NOTES:
-  1. The GDAL tools will be used for converting the raw binary (ENVI format)
-     files to GeoTIFF.
+  1. The raw binary bands are written directly to tiled GeoTIFF files, with
+     the GeoKeys generated from the projection information in the XML
+     metadata.
   2. An associated .tfw (ESRI world file) will be generated for each GeoTIFF
      file.
+  3. If cog is specified, each band is written as a Cloud-Optimized GeoTIFF
+     with internal overviews.
+  4. If interleave is band or pixel, the bands of a product which have the
+     same size and data type are written to a single multi-band GeoTIFF file,
+     in the order of the bands in the XML file.  Each of those bands refers
+     to the multi-band file in the output XML file.  Bands which can't be
+     grouped with another band are still written to their own file.
+  5. If del_src is specified and reclamation of the source bands is
+     requested (see raw_binary_reclaim.h), each band is reclaimed as it's
+     read, rather than only removed once it's converted.
+  6. The GeoTIFF files are independent, so they're written concurrently
+     when threading is enabled (ENABLE_THREADING=yes), using the task
+     runtime (see espa_task.h).  The files and their bands are all decided
+     before any is written, each file is written by one thread with its own
+     TIFF handle, and the XML file is written once all of them are done.
+     The number of threads is limited by the memory budget (see
+     espa_memory.h).  Once a file fails, the files not yet started are
+     skipped.
 ******************************************************************************/
 int convert_espa_to_gtif
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
     char *gtif_file,       /* I: base output GeoTIFF filename */
+    Gtif_compress_t compress,  /* I: compression of the GeoTIFF tiles */
+    bool cog,              /* I: should Cloud-Optimized GeoTIFFs be written? */
+    Gtif_interleave_t interleave,  /* I: layout of the bands of each product;
+                                 none writes one file per band */
     bool del_src           /* I: should the source files be removed after
                                  conversion? */
 )
 {
     char FUNC_NAME[] = "convert_espa_to_gtif";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
-    char gdal_cmd[STR_SIZE];    /* command string for GDAL call */
-    char gtif_band[STR_SIZE];   /* name of the GeoTIFF file for this band */
-    char hdr_file[STR_SIZE];    /* name of the header file for this band */
     char xml_file[STR_SIZE];    /* new XML file for the GeoTIFF product */
-    char tmpfile[STR_SIZE];     /* filename of file.tif.aux.xml */
     char *cptr = NULL;          /* pointer to empty space in the band name */
-    int i;                      /* looping variable for each band */
+    int i, j;                   /* looping variables for each band */
     int count;                  /* number of chars copied in snprintf */
+    int nfiles = 0;             /* number of GeoTIFF files */
+    int ngrouped = 0;           /* number of bands assigned to the files */
+    int nproduct;               /* number of bands in the current product */
+    int nthreads;               /* number of threads writing the files */
+    size_t file_bytes;          /* bytes buffered to write a file */
+    size_t thread_bytes = 0;    /* bytes buffered by each thread */
+    bool *converted = NULL;     /* has the band been converted? */
+    char *gtif_band = NULL;     /* name of the GeoTIFF file for this band */
+    Espa_band_meta_t **group = NULL;  /* bands written to each file */
+    Gtif_file_t *file = NULL;   /* GeoTIFF files to be written */
+    Gtif_file_list_t list;      /* files being written */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                    populated by reading the XML metadata file */
+    ESPA_PROFILE_SCOPE ("convert_espa_to_gtif");
+
+    /* Overviews are only written for single-band files */
+    if (cog && interleave != GTIF_INTERLEAVE_NONE)
+    {
+        sprintf (errmsg, "Cloud-Optimized GeoTIFFs can't be written with "
+            "interleaved bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
     /* Validate the input metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
@@ -74,97 +275,123 @@ int convert_espa_to_gtif
         return (ERROR);
     }
 
-    /* Loop through the bands in the XML file and convert them to GeoTIFF.
-       The filenames will have the GeoTIFF base name followed by _ and the
-       band name of each band in the XML file.  Blank spaced in the band name
-       will be replaced with underscores. */
-    for (i = 0; i < xml_metadata.nbands; i++)
+    /* Reclaim the source bands as they're converted if requested, since
+       they're removed anyway */
+    list.reclaim_src = del_src &&
+        can_reclaim_raw_binary_sources (&xml_metadata);
+
+    /* Allocate the list of GeoTIFF files and the bands written to each */
+    converted = calloc (xml_metadata.nbands, sizeof (bool));
+    group = calloc (xml_metadata.nbands, sizeof (Espa_band_meta_t *));
+    file = calloc (xml_metadata.nbands, sizeof (Gtif_file_t));
+    if (converted == NULL || group == NULL || file == NULL)
     {
-        /* Determine the output GeoTIFF band name */
-        count = snprintf (gtif_band, sizeof (gtif_band), "%s_%s.tif",
-            gtif_file, xml_metadata.band[i].name);
-        if (count < 0 || count >= sizeof (gtif_band))
-        {
-            sprintf (errmsg, "Overflow of gtif_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Allocating memory for the list of bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (converted);
+        free (group);
+        free (file);
+        return (ERROR);
+    }
 
-        /* Loop through this filename and replace any occurances of blank
-           spaces with underscores */
-        while ((cptr = strchr (gtif_band, ' ')) != NULL)
-            *cptr = '_';
+    /* Loop through the bands in the XML file and determine the GeoTIFF
+       file each is written to.  The filenames will have the GeoTIFF base name followed by _ and the
+       band name of each band in the XML file.  If the bands are interleaved,
+       the bands of each product with the same size and data type are
+       written to a single file named with the product instead of the band
+       name.  Blank spaced in the band name will be replaced with
+       underscores. */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (converted[i])
+            continue;
 
-        /* Convert the files */
-        printf ("Converting %s to %s\n", xml_metadata.band[i].file_name,
-            gtif_band);
-        count = snprintf (gdal_cmd, sizeof (gdal_cmd),
-            "gdal_translate -of Gtiff -a_nodata %ld -co \"TFW=YES\" -q %s %s",
-            xml_metadata.band[i].fill_value, xml_metadata.band[i].file_name,
-            gtif_band);
-        if (count < 0 || count >= sizeof (gdal_cmd))
+        /* Collect the bands to be written to this file */
+        file[nfiles].group = &group[ngrouped];
+        file[nfiles].group[0] = &xml_metadata.band[i];
+        file[nfiles].ngroup = 1;
+        for (j = i + 1; j < xml_metadata.nbands &&
+            interleave != GTIF_INTERLEAVE_NONE; j++)
         {
-            sprintf (errmsg, "Overflow of gdal_cmd string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            if (!converted[j] && !strcmp (xml_metadata.band[j].product,
+                    xml_metadata.band[i].product) &&
+                xml_metadata.band[j].nlines == xml_metadata.band[i].nlines &&
+                xml_metadata.band[j].nsamps == xml_metadata.band[i].nsamps &&
+                xml_metadata.band[j].data_type ==
+                    xml_metadata.band[i].data_type)
+            {
+                file[nfiles].group[file[nfiles].ngroup++] =
+                    &xml_metadata.band[j];
+                converted[j] = true;
+            }
         }
+        converted[i] = true;
+        ngrouped += file[nfiles].ngroup;
 
-        if (system (gdal_cmd) == -1)
+        /* Determine the output GeoTIFF band name.  Multi-band files are
+           named after the product, along with the first band if other bands
+           of the product are written to other files. */
+        nproduct = 0;
+        for (j = 0; j < xml_metadata.nbands; j++)
         {
-            sprintf (errmsg, "Running gdal_translate: %s", gdal_cmd);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            if (!strcmp (xml_metadata.band[j].product,
+                xml_metadata.band[i].product))
+                nproduct++;
         }
 
-        /* Remove the {gtif_name}.tif.aux.xml file since it's not needed and
-           clutters the results.  Don't worry about testing the unlink
-           results.  If it doesn't unlink it's not fatal. */
-        count = snprintf (tmpfile, sizeof (tmpfile), "%s.aux.xml", gtif_band);
-        if (count < 0 || count >= sizeof (tmpfile))
+        gtif_band = file[nfiles].name;
+        if (file[nfiles].ngroup == 1)
+            count = snprintf (gtif_band, STR_SIZE, "%s_%s.tif",
+                gtif_file, xml_metadata.band[i].name);
+        else if (nproduct == file[nfiles].ngroup)
+            count = snprintf (gtif_band, STR_SIZE, "%s_%s.tif",
+                gtif_file, xml_metadata.band[i].product);
+        else
+            count = snprintf (gtif_band, STR_SIZE, "%s_%s_%s.tif",
+                gtif_file, xml_metadata.band[i].product,
+                xml_metadata.band[i].name);
+        if (count < 0 || count >= STR_SIZE)
         {
-            sprintf (errmsg, "Overflow of tmpfile string");
+            sprintf (errmsg, "Overflow of gtif_file string");
             error_handler (true, FUNC_NAME, errmsg);
+            free (converted);
+            free (group);
+            free (file);
             return (ERROR);
         }
-        unlink (tmpfile);
-
-        /* Remove the source file if specified */
-        if (del_src)
-        {
-            /* .img file */
-            printf ("  Removing %s\n", xml_metadata.band[i].file_name);
-            if (unlink (xml_metadata.band[i].file_name) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s",
-                    xml_metadata.band[i].file_name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
 
-            /* .hdr file */
-            count = snprintf (hdr_file, sizeof (hdr_file), "%s",
-                xml_metadata.band[i].file_name);
-            if (count < 0 || count >= sizeof (hdr_file))
-            {
-                sprintf (errmsg, "Overflow of hdr_file string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        /* Loop through this filename and replace any occurances of blank
+           spaces with underscores */
+        while ((cptr = strchr (gtif_band, ' ')) != NULL)
+            *cptr = '_';
 
-            cptr = strrchr (hdr_file, '.');
-            strcpy (cptr, ".hdr");
-            printf ("  Removing %s\n", hdr_file);
-            if (unlink (hdr_file) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s", hdr_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+        /* Each thread buffers a row of tiles of every band of its file */
+        file_bytes = (size_t) file[nfiles].ngroup * GTIF_TILE_SIZE *
+            (xml_metadata.band[i].nsamps + GTIF_TILE_SIZE) *
+            get_data_type_size (xml_metadata.band[i].data_type);
+        if (file_bytes > thread_bytes)
+            thread_bytes = file_bytes;
+        nfiles++;
+    }
+    free (converted);
 
-        /* Update the XML file to use the new GeoTIFF band name */
-        strcpy (xml_metadata.band[i].file_name, gtif_band);
+    /* Write the GeoTIFF files, concurrently if threading is enabled */
+    list.file = file;
+    list.gmeta = &xml_metadata.global;
+    list.compress = compress;
+    list.cog = cog;
+    list.interleave = interleave;
+    list.del_src = del_src;
+    nthreads = espa_budget_threads (thread_bytes, 0, espa_task_nthreads ());
+    if (espa_parallel_for (0, nfiles, 1, nthreads, export_gtif_files, &list)
+        != SUCCESS)
+    {  /* Error messages already written */
+        free (group);
+        free (file);
+        return (ERROR);
     }
+    free (group);
+    free (file);
 
     /* Remove the source XML if specified */
     if (del_src)
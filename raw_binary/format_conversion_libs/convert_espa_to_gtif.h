@@ -22,6 +22,7 @@ NOTES:
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
+#include "espa_gtif.h"
 
 /* Defines */
 
@@ -30,6 +31,10 @@ int convert_espa_to_gtif
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
     char *gtif_file,       /* I: base output GeoTIFF filename */
+    Gtif_compress_t compress,  /* I: compression of the GeoTIFF tiles */
+    bool cog,              /* I: should Cloud-Optimized GeoTIFFs be written? */
+    Gtif_interleave_t interleave,  /* I: layout of the bands of each product;
+                                 none writes one file per band */
     bool del_src           /* I: should the source files be removed after
                                  conversion? */
 );
@@ -3,7 +3,7 @@ FILE: convert_espa_to_hdf.c
   
 PURPOSE: Contains functions for creating the HDF metadata and links to the
 external SDSs, using the existing raw binary bands for the external SDSs in
-the HDF file.
+the HDF file, or for writing the bands as chunked, compressed SDSs.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -21,6 +21,11 @@ NOTES:
 #include <math.h>
 #include "HE2_config.h"
 #include "convert_espa_to_hdf.h"
+#include "espa_memory.h"
+#include "espa_progress.h"
+#include "espa_task.h"
+#include "espa_io_limit.h"
+#include "espa_profile.h"
 
 #define OUTPUT_PROVIDER ("DataProvider")
 #define OUTPUT_SAT ("Satellite")
@@ -82,7 +87,7 @@ int write_global_attributes
     char errmsg[STR_SIZE];        /* error message */
     char hdf_version[] = H4_VERSION;  /* version for HDF4 */
     char hdfeos_version[] = PACKAGE_VERSION;  /* version for HDFEOS */
-    double dval[MAX_TOTAL_BANDS]; /* attribute values to be written */
+    double dval[2];               /* attribute values to be written */
     Espa_hdf_attr_t attr;         /* attribute fields */
     Espa_global_meta_t *gmeta = &xml_metadata->global;
                                   /* pointer to global metadata structure */
@@ -348,7 +353,7 @@ int write_sds_attributes
     char message[5000];         /* description of QA bits or classes */
     int i;                      /* looping variable for each SDS */
     int count;                  /* number of chars copied in snprintf */
-    double dval[MAX_TOTAL_BANDS];/* attribute values to be written */
+    double dval[2];              /* attribute values to be written */
     Espa_hdf_attr_t attr;       /* attribute fields */
 
     /* Write the band-related attributes to the SDS.  Some are required and
@@ -563,51 +568,235 @@ int write_sds_attributes
 
 
 /******************************************************************************
-MODULE:  create_hdf_metadata
+MODULE:  set_sds_compression
 
-PURPOSE: Create the HDF metadata file, using info from the XML file, which will
-point to the existing raw binary bands as external SDSs.
+PURPOSE: Sets up the chunking and compression for an internal SDS.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error creating the HDF file
-SUCCESS         Successfully created the HDF file
+ERROR           Error setting up the chunking and compression
+SUCCESS         Successfully set up the chunking and compression
 
 NOTES:
-  1. The ESPA products are 2D thus only 2D products are supported.
-  2. XDim, YDim will refer to the x,y dimension size in the first SDS.  From
-     there, different x,y dimensions will contain the pixel size at the end of
-     XDim, YDim.  Example: XDim_15, YDim_15.  For Geographic projections, the
-     name will be based on the count of grids instead of the pixel size.
+  1. The chunks are HDF_CHUNK_SIZE x HDF_CHUNK_SIZE, or the size of the band
+     if it is smaller.
 ******************************************************************************/
-int create_hdf_metadata
+static int set_sds_compression
 (
-    char *hdf_file,                     /* I: output HDF filename */
+    int32 sds_id,             /* I: SDS ID to be chunked and compressed */
+    Hdf_compress_t compress,  /* I: compression to be used */
+    int nlines,               /* I: number of lines in the band */
+    int nsamps                /* I: number of samples in the band */
+)
+{
+    char FUNC_NAME[] = "set_sds_compression";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    uint32 config_flags;      /* compression configuration flags */
+    HDF_CHUNK_DEF chunk_def;  /* chunking and compression definition */
+
+    memset (&chunk_def, 0, sizeof (chunk_def));
+    chunk_def.comp.chunk_lengths[0] =
+        (nlines < HDF_CHUNK_SIZE) ? nlines : HDF_CHUNK_SIZE;
+    chunk_def.comp.chunk_lengths[1] =
+        (nsamps < HDF_CHUNK_SIZE) ? nsamps : HDF_CHUNK_SIZE;
+
+    switch (compress)
+    {
+        case HDF_COMPRESS_DEFLATE:
+            chunk_def.comp.comp_type = COMP_CODE_DEFLATE;
+            chunk_def.comp.cinfo.deflate.level = HDF_DEFLATE_LEVEL;
+            break;
+
+        case HDF_COMPRESS_SZIP:
+            /* The szip encoder is optional in the HDF library */
+            if (HCget_config_info (COMP_CODE_SZIP, &config_flags) ==
+                HDF_ERROR || !(config_flags & COMP_ENCODER_ENABLED))
+            {
+                sprintf (errmsg, "The HDF library does not support szip "
+                    "compression.  Use deflate instead.");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            chunk_def.comp.comp_type = COMP_CODE_SZIP;
+            chunk_def.comp.cinfo.szip.options_mask = SZ_NN_OPTION_MASK;
+            chunk_def.comp.cinfo.szip.pixels_per_block =
+                HDF_SZIP_PIXELS_PER_BLOCK;
+            break;
+
+        default:
+            sprintf (errmsg, "Unsupported compression type: %d", compress);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    if (SDsetchunk (sds_id, chunk_def, HDF_CHUNK | HDF_COMP) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Setting the chunking and compression for the SDS.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_sds_progress
+
+PURPOSE: Reports the progress of writing the SDSs and checks whether the job
+has been cancelled.  If so, the SDS, mapped band and HDF file are closed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The job was cancelled, and the HDF file was closed
+SUCCESS         The SDS should continue to be written
+
+NOTES:
+  1. The fraction covers all the SDSs: band i of nbands, with the given
+     number of its lines written, is (i + line / nlines) / nbands.
+  2. The partially written HDF file is left for the caller to remove.
+******************************************************************************/
+static int report_sds_progress
+(
+    int32 hdf_vid,              /* I: HDF file ID for Vgroup access */
+    int32 hdf_id,               /* I: SD interface ID for the HDF file */
+    int32 sds_id,               /* I: ID of the SDS being written */
+    Raw_binary_mapped_t *rbmap, /* I/O: mapped band being written */
+    int band,                   /* I: index of the band being written */
+    int nbands,                 /* I: number of bands */
+    int line,                   /* I: number of lines of the band written */
+    int nlines                  /* I: number of lines in the band */
+)
+{
+    if (espa_progress_update ("convert_espa_to_hdf",
+        (band + (double) line / nlines) / nbands) == SUCCESS)
+        return (SUCCESS);
+
+    SDendaccess (sds_id);
+    close_raw_binary_mapped (rbmap);
+    SDend (hdf_id);
+    Vend (hdf_vid);
+    Hclose (hdf_vid);
+    return (ERROR);
+}
+
+
+/* Band mapped by map_hdf_band_task */
+typedef struct
+{
+    Espa_band_meta_t *bmeta;      /* metadata of the band to be mapped */
+    bool prefetch;                /* should the band data be read in? */
+    Raw_binary_mapped_t rbmap;    /* mapped band */
+} Hdf_band_map_t;
+
+
+/******************************************************************************
+MODULE:  map_hdf_band_task
+
+PURPOSE: Maps the raw binary file of a band and optionally reads its data in,
+as a task of the task runtime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the band
+SUCCESS         Successfully mapped the band
+
+NOTES:
+  1. Encoded (chunked, GeoTIFF, ...) bands are decoded into memory when
+     they're mapped.  The pages of a plain band are read in by touching
+     each one, so the band is in the page cache before its SDS is written.
+******************************************************************************/
+static int map_hdf_band_task
+(
+    void *arg                 /* I/O: band to be mapped (Hdf_band_map_t) */
+)
+{
+    char FUNC_NAME[] = "map_hdf_band_task";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Hdf_band_map_t *map = arg;    /* band to be mapped */
+    volatile const unsigned char *data = NULL;  /* mapped band data */
+    size_t page = sysconf (_SC_PAGESIZE);  /* size of a page */
+    size_t offset;                /* offset of the current page */
+
+    /* Map the raw binary file for this band, which allows the data to be
+       passed directly to the HDF library without an extra copy */
+    if (open_raw_binary_mapped (map->bmeta, false, RB_ACCESS_SEQUENTIAL,
+        &map->rbmap) != SUCCESS)
+    {
+        sprintf (errmsg, "Mapping the input raw binary file: %s",
+            map->bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (map->prefetch && !map->rbmap.decoded)
+    {
+        data = map->rbmap.data;
+        for (offset = 0; offset < map->rbmap.size; offset += page)
+            (void) data[offset];
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_hdf_sds
+
+PURPOSE: Creates the SDS of a band in the HDF file and writes the mapped band
+to it, then unmaps the band and removes the source files if requested.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the SDS
+SUCCESS         Successfully wrote the SDS
+
+NOTES:
+  1. See create_hdf_metadata.
+******************************************************************************/
+static int write_hdf_sds
+(
+    int32 hdf_vid,                      /* I: HDF file ID for Vgroup
+                                              access */
+    int32 hdf_id,                       /* I: SD interface ID for the HDF
+                                              file */
     Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
-    bool del_src           /* I: should the source files be removed after
+    int i,                              /* I: index of the band */
+    Hdf_compress_t compress,            /* I: storage/compression to be used
+                                              for the SDS */
+    bool del_src,          /* I: should the source files be removed after
                                  conversion? */
+    bool reclaim_src,      /* I: are the source bands reclaimed as they're
+                                 written? */
+    int *ngrids,           /* I/O: current number of grids in the product;
+                                 different grids are written for different
+                                 resolutions (1-based) */
+    Raw_binary_mapped_t *rbmap  /* I/O: mapped band; unmapped once written */
 )
 {
-    char FUNC_NAME[] = "create_hdf_metadata";  /* function name */
+    char FUNC_NAME[] = "write_hdf_sds";  /* function name */
     char errmsg[STR_SIZE];        /* error message */
     char bendian_file[STR_SIZE];  /* name of output big endian img file */
     char dim_name[2][STR_SIZE];   /* array of dimension names */
     char hdr_file[STR_SIZE];      /* ENVI header file */
     char *cptr = NULL;            /* pointer to the file extension */
-    int i;                        /* looping variable for each SDS */
-    int nbytes;                   /* number of bytes in the data type */
+    int line;                     /* looping variable for each chunk row */
+    int block_lines;              /* number of lines written at a time */
     int nlines;                   /* number of lines in the band */
     int nsamps;                   /* number of samples in the band */
     int dim;                      /* looping variable for dimensions */
     int count;                    /* number of chars copied in snprintf */
-    int ngrids;                   /* current number of grids in the product;
-                                     different grids are written for different
-                                     resolutions (1-based) */
     int mycount;                  /* integer value to use in the name of the
                                      2nd, 3rd, etc. grid dimensions */
-    int32 hdf_id;                 /* HDF file ID */
     int32 sds_id;                 /* ID for each SDS */
     int32 dim_id;                 /* ID for current dimension in SDS */
     int32 data_type;              /* data type for HDF file */
@@ -615,272 +804,447 @@ int create_hdf_metadata
     int32 dims[2];                /* array for dimension sizes; only 2D prods */
     int32 start[2];               /* starting location to write the HDF data */
     int32 edge[2];                /* number of values to write the HDF data */
-    FILE *fp_rb = NULL;           /* file pointer for the raw binary file */
-    void *file_buf = NULL;        /* pointer to correct input file buffer */
+    Raw_binary_reclaim_t rcl;     /* reclamation of the raw binary band */
 
-    /* Open the HDF file for creation (overwriting if it exists) */
-    hdf_id = SDstart (hdf_file, DFACC_CREATE);
-    if (hdf_id == HDF_ERROR)
+    /* Provide the status of processing */
+    printf ("Processing SDS: %s\n", xml_metadata->band[i].name);
+
+    /* Define the dimensions for this band */
+    nlines = xml_metadata->band[i].nlines;
+    nsamps = xml_metadata->band[i].nsamps;
+    dims[0] = nlines;
+    dims[1] = nsamps;
+
+    /* Determine the HDF data type */
+    switch (xml_metadata->band[i].data_type)
     {
-        sprintf (errmsg, "Creating the HDF file: %s", hdf_file);
+        case (ESPA_INT8):
+            data_type = DFNT_INT8;
+            break;
+        case (ESPA_UINT8):
+            data_type = DFNT_UINT8;
+            break;
+        case (ESPA_INT16):
+            data_type = DFNT_INT16;
+            break;
+        case (ESPA_UINT16):
+            data_type = DFNT_UINT16;
+            break;
+        case (ESPA_INT32):
+            data_type = DFNT_INT32;
+            break;
+        case (ESPA_UINT32):
+            data_type = DFNT_UINT32;
+            break;
+        case (ESPA_FLOAT32):
+            data_type = DFNT_FLOAT32;
+            break;
+        case (ESPA_FLOAT64):
+            data_type = DFNT_FLOAT64;
+            break;
+        default:
+            sprintf (errmsg, "Unsupported ESPA data type.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    open_raw_binary_reclaim (&xml_metadata->band[i], reclaim_src, &rcl);
+
+    /* Find the location of the file extension, then modify the filename
+       a bit to depict the big endian version of the imagery needed for
+       the external SDSs in the HDF files.  (It's assumed we are running
+       on Linux, thus the current output files will be little endian.
+       HDF uses big endian for their byte order.) */
+    count = snprintf (bendian_file, sizeof (bendian_file), "%s",
+        xml_metadata->band[i].file_name);
+    if (count < 0 || count >= sizeof (bendian_file))
+    {
+        sprintf (errmsg, "Overflow of bendian_file string");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Loop through the bands in the XML file and set each band as an
-       external SDS in this HDF file */
-    ngrids = 1;
-    for (i = 0; i < xml_metadata->nbands; i++)
+    cptr = strrchr (bendian_file, '.');
+    if (cptr != NULL)
+        *cptr = '\0';
+    strcpy (cptr, "_hdf.img");
+
+    /* Select/create the SDS index for the current band */
+    sds_id = SDcreate (hdf_id, xml_metadata->band[i].name, data_type,
+        rank, dims);
+    if (sds_id == HDF_ERROR)
     {
-        /* Provide the status of processing */
-        printf ("Processing SDS: %s\n", xml_metadata->band[i].name);
+        sprintf (errmsg, "Creating SDS in the HDF file: %d.", i);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set the dimension name for each dimension in this SDS.  The default
+       is to use YDim, XDim for the first band or for any bands
+       matching the resolution of the first band */
+    if (i == 0 ||
+        ((xml_metadata->band[i].pixel_size[0] ==
+         xml_metadata->band[0].pixel_size[0]) &&
+        (xml_metadata->band[i].pixel_size[1] ==
+         xml_metadata->band[0].pixel_size[1])))
+    {  /* first band or resolution matching the first band */
+        strcpy (dim_name[0], "YDim");
+        strcpy (dim_name[1], "XDim");
+    }
+    else
+    {  /* create new dimension name for this resolution */
+        /* Use the pixel size for non-geographic projections otherwise
+           use the grid count */
+        (*ngrids)++;
+        if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
+            mycount = *ngrids;
+        else
+            mycount = (int) xml_metadata->band[i].pixel_size[1]; /* Y dim */
 
-        /* Open the file for this band of data to allow for reading */
-        fp_rb = open_raw_binary (xml_metadata->band[i].file_name, "rb");
-        if (fp_rb == NULL)
+        count = snprintf (dim_name[0], sizeof (dim_name[0]), "YDim_%d",
+            mycount);  /* Y dim */
+        if (count < 0 || count >= sizeof (dim_name[0]))
         {
-            sprintf (errmsg, "Opening the input raw binary file: %s",
-                xml_metadata->band[i].file_name);
+            sprintf (errmsg, "Overflow of dim_name[0] string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Define the dimensions for this band */
-        nlines = xml_metadata->band[i].nlines;
-        nsamps = xml_metadata->band[i].nsamps;
-        dims[0] = nlines;
-        dims[1] = nsamps;
-
-        /* Determine the HDF data type */
-        switch (xml_metadata->band[i].data_type)
-        {
-            case (ESPA_INT8):
-                data_type = DFNT_INT8;
-                nbytes = 1;
-                break;
-            case (ESPA_UINT8):
-                data_type = DFNT_UINT8;
-                nbytes = 1;
-                break;
-            case (ESPA_INT16):
-                data_type = DFNT_INT16;
-                nbytes = 2;
-                break;
-            case (ESPA_UINT16):
-                data_type = DFNT_UINT16;
-                nbytes = 2;
-                break;
-            case (ESPA_INT32):
-                data_type = DFNT_INT32;
-                nbytes = 4;
-                break;
-            case (ESPA_UINT32):
-                data_type = DFNT_UINT32;
-                nbytes = 4;
-                break;
-            case (ESPA_FLOAT32):
-                data_type = DFNT_FLOAT32;
-                nbytes = 4;
-                break;
-            case (ESPA_FLOAT64):
-                data_type = DFNT_FLOAT64;
-                nbytes = 8;
-                break;
-            default:
-                sprintf (errmsg, "Unsupported ESPA data type.");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-        }
+        if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
+            mycount = *ngrids;
+        else
+            mycount = (int) xml_metadata->band[i].pixel_size[0]; /* X dim */
 
-        /* Allocate memory for the file buffer */
-        file_buf = calloc (nlines * nsamps, nbytes);
-        if (file_buf == NULL)
+        count = snprintf (dim_name[1], sizeof (dim_name[1]), "XDim_%d",
+            mycount);  /* X dim */
+        if (count < 0 || count >= sizeof (dim_name[1]))
         {
-            sprintf (errmsg, "Error allocating memory for the file buffer.");
+            sprintf (errmsg, "Overflow of dim_name[1] string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }
 
-        /* Read the data from the raw binary file */
-        if (read_raw_binary (fp_rb, nlines, nsamps, nbytes, file_buf) !=
-            SUCCESS)
+    /* Write the dimension names to the HDF file */
+    for (dim = 0; dim < rank; dim++)
+    {
+        dim_id = SDgetdimid (sds_id, dim);
+        if (dim_id == HDF_ERROR) 
         {
-            sprintf (errmsg, "Reading image data from the raw binary file");
+            sprintf (errmsg, "Getting dimension id for dimension %d and "
+                "SDS %d.", dim, i);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Close the raw binary file */
-        close_raw_binary (fp_rb);
-
-        /* Find the location of the file extension, then modify the filename
-           a bit to depict the big endian version of the imagery needed for
-           the HDF files.  (It's assumed we are running on Linux, thus the
-           current output files will be little endian.  HDF uses big endian
-           for their byte order.) */
-        count = snprintf (bendian_file, sizeof (bendian_file), "%s",
-            xml_metadata->band[i].file_name);
-        if (count < 0 || count >= sizeof (bendian_file))
+        if (SDsetdimname (dim_id, dim_name[dim]) == HDF_ERROR)
         {
-            sprintf (errmsg, "Overflow of bendian_file string");
+            sprintf (errmsg, "Setting dimension name (%s) for dimension "
+                "%d and SDS %d.", dim_name[dim], dim, i);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }
 
-        cptr = strrchr (bendian_file, '.');
-        if (cptr != NULL)
-            *cptr = '\0';
-        strcpy (cptr, "_hdf.img");
-
-        /* Select/create the SDS index for the current band */
-        sds_id = SDcreate (hdf_id, xml_metadata->band[i].name, data_type,
-            rank, dims);
-        if (sds_id == HDF_ERROR)
+    if (compress == HDF_COMPRESS_NONE)
+    {
+        /* Identify the external dataset for this SDS, starting at byte
+           location 0 since these are raw binary files without any
+           headers */
+        if (SDsetexternalfile (sds_id, bendian_file, 0 /* offset */) ==
+            HDF_ERROR)
         {
-            sprintf (errmsg, "Creating SDS in the HDF file: %d.", i);
+            sprintf (errmsg, "Setting the external dataset for this SDS "
+                "(%d): %s.", i, bendian_file);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Set the dimension name for each dimension in this SDS.  The default
-           is to use YDim, XDim for the first band or for any bands
-           matching the resolution of the first band */
-        if (i == 0 ||
-            ((xml_metadata->band[i].pixel_size[0] ==
-             xml_metadata->band[0].pixel_size[0]) &&
-            (xml_metadata->band[i].pixel_size[1] ==
-             xml_metadata->band[0].pixel_size[1])))
-        {  /* first band or resolution matching the first band */
-            strcpy (dim_name[0], "YDim");
-            strcpy (dim_name[1], "XDim");
-        }
-        else
-        {  /* create new dimension name for this resolution */
-            /* Use the pixel size for non-geographic projections otherwise
-               use the grid count */
-            ngrids++;
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
-                mycount = ngrids;
-            else
-                mycount = (int) xml_metadata->band[i].pixel_size[1]; /* Y dim */
-
-            count = snprintf (dim_name[0], sizeof (dim_name[0]), "YDim_%d",
-                mycount);  /* Y dim */
-            if (count < 0 || count >= sizeof (dim_name[0]))
+        /* Write the new big endian data to the SDS.  Without a memory
+           budget every element is written at once; otherwise a block
+           of lines at a time, allowing for the HDF library's byte
+           swapped copy of the block. */
+        block_lines = espa_budget_lines ((size_t) 2 * nsamps *
+            rbmap->nbytes, 0, nlines);
+        start[1] = 0;
+        edge[1] = dims[1];
+        for (line = 0; line < nlines; line += block_lines)
+        {
+            if (report_sds_progress (hdf_vid, hdf_id, sds_id, rbmap,
+                i, xml_metadata->nbands, line, nlines) != SUCCESS)
             {
-                sprintf (errmsg, "Overflow of dim_name[0] string");
+                sprintf (errmsg, "Writing the external dataset for this "
+                    "SDS (%d) was cancelled.", i);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
 
-            if (xml_metadata->global.proj_info.proj_type == GCTP_GEO)
-                mycount = ngrids;
-            else
-                mycount = (int) xml_metadata->band[i].pixel_size[0]; /* X dim */
-
-            count = snprintf (dim_name[1], sizeof (dim_name[1]), "XDim_%d",
-                mycount);  /* X dim */
-            if (count < 0 || count >= sizeof (dim_name[1]))
+            start[0] = line;
+            edge[0] = block_lines;
+            if (line + edge[0] > nlines)
+                edge[0] = nlines - line;
+            espa_io_throttle (ESPA_IO_WRITE, (size_t) edge[0] * nsamps *
+                rbmap->nbytes);
+            if (SDwritedata (sds_id, start, NULL, edge,
+                get_raw_binary_mapped_line (rbmap, line)) == HDF_ERROR)
             {
-                sprintf (errmsg, "Overflow of dim_name[1] string");
+                sprintf (errmsg, "Writing the external dataset for this "
+                    "SDS (%d): %s.", i, bendian_file);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
+            if (block_lines < nlines)
+                release_raw_binary_mapped_lines (rbmap, line, edge[0]);
+            reclaim_raw_binary_lines (&rcl, line + edge[0]);
+        }
+    }
+    else
+    {
+        /* Set up the chunking and compression for this SDS */
+        if (set_sds_compression (sds_id, compress, nlines, nsamps) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Setting up the compression for this SDS "
+                "(%d).", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
 
-        /* Write the dimension names to the HDF file */
-        for (dim = 0; dim < rank; dim++)
+        /* Write the data to the SDS one row of chunks at a time, so each
+           write only covers complete chunks */
+        start[1] = 0;
+        edge[1] = dims[1];
+        for (line = 0; line < nlines; line += HDF_CHUNK_SIZE)
         {
-            dim_id = SDgetdimid (sds_id, dim);
-            if (dim_id == HDF_ERROR) 
+            if (report_sds_progress (hdf_vid, hdf_id, sds_id, rbmap,
+                i, xml_metadata->nbands, line, nlines) != SUCCESS)
             {
-                sprintf (errmsg, "Getting dimension id for dimension %d and "
-                    "SDS %d.", dim, i);
+                sprintf (errmsg, "Writing the compressed SDS (%d) was "
+                    "cancelled.", i);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
 
-            if (SDsetdimname (dim_id, dim_name[dim]) == HDF_ERROR)
+            start[0] = line;
+            edge[0] = HDF_CHUNK_SIZE;
+            if (line + edge[0] > nlines)
+                edge[0] = nlines - line;
+            espa_io_throttle (ESPA_IO_WRITE, (size_t) edge[0] * nsamps *
+                rbmap->nbytes);
+            if (SDwritedata (sds_id, start, NULL, edge,
+                get_raw_binary_mapped_line (rbmap, line)) == HDF_ERROR)
             {
-                sprintf (errmsg, "Setting dimension name (%s) for dimension "
-                    "%d and SDS %d.", dim_name[dim], dim, i);
+                sprintf (errmsg, "Writing lines %d-%d of the compressed "
+                    "SDS (%d).", line, line + edge[0] - 1, i);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
+            if (espa_memory_budget () > 0)
+                release_raw_binary_mapped_lines (rbmap, line, edge[0]);
+            reclaim_raw_binary_lines (&rcl, line + edge[0]);
         }
+    }
 
-        /* Identify the external dataset for this SDS, starting at byte
-           location 0 since these are raw binary files without any headers */
-        if (SDsetexternalfile (sds_id, bendian_file, 0 /* offset */) ==
-            HDF_ERROR)
+    /* Write the SDS-level metadata */
+    if (write_sds_attributes (sds_id, &xml_metadata->band[i]) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing band attributes for this SDS (%d).", i);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Terminate access to the data set and SD interface */
+    SDendaccess (sds_id);
+
+    /* Unmap the raw binary band */
+    close_raw_binary_mapped (rbmap);
+    close_raw_binary_reclaim (&rcl);
+
+    /* Remove the source files if specified */
+    if (del_src)
+    {
+        /* .img file */
+        printf ("  Removing %s\n", xml_metadata->band[i].file_name);
+        if (unlink (xml_metadata->band[i].file_name) != 0)
         {
-            sprintf (errmsg, "Setting the external dataset for this SDS (%d): "
-                "%s.", i, bendian_file);
+            sprintf (errmsg, "Deleting source file: %s",
+                xml_metadata->band[i].file_name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Write the new big endian data to the SDS.  Start writing at the
-           beginning of the SDS, write every element, and write all the
-           elements in both dimensions. */
-        start[0] = start[1] = 0;
-        edge[0] = dims[0];
-        edge[1] = dims[1];
-        if (SDwritedata (sds_id, start, NULL, edge, file_buf) == HDF_ERROR)
+        /* .hdr file */
+        count = snprintf (hdr_file, sizeof (hdr_file), "%s",
+            xml_metadata->band[i].file_name);
+        if (count < 0 || count >= sizeof (hdr_file))
         {
-            sprintf (errmsg, "Writing the external dataset for this SDS (%d): "
-                "%s.", i, bendian_file);
+            sprintf (errmsg, "Overflow of hdr_file string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Write the SDS-level metadata */
-        if (write_sds_attributes (sds_id, &xml_metadata->band[i]) != SUCCESS)
+        cptr = strrchr (hdr_file, '.');
+        strcpy (cptr, ".hdr");
+        printf ("  Removing %s\n", hdr_file);
+        if (unlink (hdr_file) != 0)
         {
-            sprintf (errmsg, "Writing band attributes for this SDS (%d).", i);
+            sprintf (errmsg, "Deleting source file: %s", hdr_file);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_hdf_metadata
 
-        /* Terminate access to the data set and SD interface */
-        SDendaccess (sds_id);
+PURPOSE: Create the HDF metadata file, using info from the XML file, which will
+point to the existing raw binary bands as external SDSs or will contain the
+bands as chunked, compressed SDSs.
 
-        /* Free the file buffer */
-        free (file_buf);
-        file_buf = NULL;
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the HDF file
+SUCCESS         Successfully created the HDF file
 
-        /* Remove the source files if specified */
-        if (del_src)
+NOTES:
+  1. The ESPA products are 2D thus only 2D products are supported.
+  2. XDim, YDim will refer to the x,y dimension size in the first SDS.  From
+     there, different x,y dimensions will contain the pixel size at the end of
+     XDim, YDim.  Example: XDim_15, YDim_15.  For Geographic projections, the
+     name will be based on the count of grids instead of the pixel size.
+  3. External SDSs are written with a single SDwritedata call.  Compressed
+     SDSs are written one row of chunks (HDF_CHUNK_SIZE lines) at a time, so
+     the HDF library only needs to buffer a single row of chunks.
+  4. With a memory budget (see espa_memory.h), external SDSs are written in
+     blocks of lines fitting the budget, and the mapped lines of both kinds
+     of SDS are released once written, so the mapped band doesn't add to
+     the resident memory.
+  5. The HDF file is opened once for both Vgroup and SD access, the same way
+     HDF-EOS opens its files.  The SDSs, global attributes, and HDF-EOS
+     structural metadata and Grid Vgroups are all written in that session,
+     and the file is flushed and closed once at the end.
+  6. The progress is reported (see espa_progress.h) before each block of
+     lines written, and ERROR is returned if the job was cancelled.
+  7. If del_src is specified and reclamation of the source bands is
+     requested (see raw_binary_reclaim.h), the lines of each band are
+     reclaimed once written to the SDS, rather than the band only being
+     removed once it's converted.
+  8. With threading and no memory budget, the writing is pipelined: a task
+     maps the next band (decoding an encoded band) and reads its data in
+     while the SDS of the current band is written, so the reads overlap
+     the HDF writes.  The HDF library is only called from this thread.
+******************************************************************************/
+int create_hdf_metadata
+(
+    char *hdf_file,                     /* I: output HDF filename */
+    Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Hdf_compress_t compress,            /* I: storage/compression to be used
+                                              for the SDSs */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    char FUNC_NAME[] = "create_hdf_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for each SDS */
+    int ngrids;                   /* current number of grids in the product;
+                                     different grids are written for different
+                                     resolutions (1-based) */
+    int status;                   /* status of mapping a band */
+    int32 hdf_vid;                /* HDF file ID for Vgroup access */
+    int32 hdf_id;                 /* SD interface ID for the HDF file */
+    bool reclaim_src;             /* are the source bands reclaimed as
+                                     they're written? */
+    bool pipelined;               /* is the next band mapped while an SDS is
+                                     written? */
+    Hdf_band_map_t band_map[2];   /* bands mapped for the current and next
+                                     SDS */
+    Hdf_band_map_t *map = NULL;   /* band of the current SDS */
+    Hdf_band_map_t *next = NULL;  /* band of the next SDS, if it's being
+                                     mapped */
+    Espa_task_group_t map_group;  /* task mapping the next band */
+
+    /* Open the HDF file for creation (overwriting if it exists), then start
+       the Vgroup and SD interfaces on it */
+    hdf_vid = Hopen (hdf_file, DFACC_CREATE, 0);
+    if (hdf_vid == HDF_ERROR)
+    {
+        sprintf (errmsg, "Creating the HDF file: %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (Vstart (hdf_vid) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Starting Vgroup access to the HDF file: %s",
+            hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    hdf_id = SDstart (hdf_file, DFACC_RDWR);
+    if (hdf_id == HDF_ERROR)
+    {
+        sprintf (errmsg, "Starting SD access to the HDF file: %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Reclaim the source bands as they're written if requested, since
+       they're removed anyway */
+    reclaim_src = del_src && can_reclaim_raw_binary_sources (xml_metadata);
+
+    /* Loop through the bands in the XML file and set each band as an
+       external SDS in this HDF file.  When pipelined, the next band is
+       mapped and read in by a task while the SDS of the current one is
+       written. */
+    pipelined = espa_task_nthreads () > 1 && espa_memory_budget () == 0;
+    ngrids = 1;
+    espa_task_group_init (&map_group);
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        /* Map this band, unless it was mapped while the last SDS was
+           written */
+        map = &band_map[i % 2];
+        if (i == 0 || !pipelined)
         {
-            /* .img file */
-            printf ("  Removing %s\n", xml_metadata->band[i].file_name);
-            if (unlink (xml_metadata->band[i].file_name) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s",
-                    xml_metadata->band[i].file_name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            map->bmeta = &xml_metadata->band[i];
+            map->prefetch = false;
+            status = map_hdf_band_task (map);
+        }
+        else
+            status = espa_task_group_wait (&map_group);
+        if (status != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
 
-            /* .hdr file */
-            count = snprintf (hdr_file, sizeof (hdr_file), "%s",
-                xml_metadata->band[i].file_name);
-            if (count < 0 || count >= sizeof (hdr_file))
-            {
-                sprintf (errmsg, "Overflow of hdr_file string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        /* Map the next band while this one is written */
+        next = NULL;
+        espa_task_group_init (&map_group);
+        if (pipelined && i + 1 < xml_metadata->nbands)
+        {
+            next = &band_map[(i + 1) % 2];
+            next->bmeta = &xml_metadata->band[i + 1];
+            next->prefetch = true;
+            espa_task_submit (&map_group, map_hdf_band_task, next);
+        }
 
-            cptr = strrchr (hdr_file, '.');
-            strcpy (cptr, ".hdr");
-            printf ("  Removing %s\n", hdr_file);
-            if (unlink (hdr_file) != 0)
-            {
-                sprintf (errmsg, "Deleting source file: %s", hdr_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        if (write_hdf_sds (hdf_vid, hdf_id, xml_metadata, i, compress,
+            del_src, reclaim_src, &ngrids, &map->rbmap) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the SDS for band %s.",
+                xml_metadata->band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            if (next != NULL && espa_task_group_wait (&map_group) == SUCCESS)
+                close_raw_binary_mapped (&next->rbmap);
+            return (ERROR);
         }
     }
 
@@ -892,17 +1256,36 @@ int create_hdf_metadata
         return (ERROR);
     }
 
-    /* Terminate access to the HDF file */
-    SDend (hdf_id);
-
     /* Write HDF-EOS attributes and metadata */
-    if (write_hdf_eos_attr (hdf_file, xml_metadata) != SUCCESS)
+    if (write_hdf_eos_attr (hdf_vid, hdf_id, xml_metadata) != SUCCESS)
     {
         sprintf (errmsg, "Writing HDF-EOS attributes for this HDF file.");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
+    /* Terminate access to the HDF file, which flushes and closes it */
+    if (SDend (hdf_id) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Ending SD access to the HDF file: %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (Vend (hdf_vid) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Ending Vgroup access to the HDF file: %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (Hclose (hdf_vid) == HDF_ERROR)
+    {
+        sprintf (errmsg, "Closing the HDF file: %s", hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Successful conversion */
     return (SUCCESS);
 }
@@ -921,15 +1304,21 @@ ERROR           Error converting to HDF
 SUCCESS         Successfully converted to HDF
 
 NOTES:
-  1. The ESPA raw binary band files will be used, as-is, and linked to as
-     external SDSs from the HDF file.
+  1. By default the ESPA raw binary band files will be used, as-is, and
+     linked to as external SDSs from the HDF file.  If compression is
+     specified, the bands are instead written into the HDF file itself as
+     chunked, compressed SDSs.
   2. An ENVI header file will be written for the HDF files which contain
      SDSs of the same resolution (i.e. not a multi-resolution product).
+  3. The progress of writing the SDSs is reported, and the job may be
+     cancelled, through espa_progress.h (see create_hdf_metadata).
 ******************************************************************************/
 int convert_espa_to_hdf
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
     char *hdf_file,        /* I: output HDF filename */
+    Hdf_compress_t compress, /* I: storage/compression to be used for the
+                                   SDSs */
     bool del_src           /* I: should the source files be removed after
                                  conversion? */
 )
@@ -946,6 +1335,7 @@ int convert_espa_to_hdf
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
     Envi_header_t envi_hdr;  /* output ENVI header information */
+    ESPA_PROFILE_SCOPE ("convert_espa_to_hdf");
 
     /* Validate the input metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
@@ -966,7 +1356,8 @@ int convert_espa_to_hdf
 
     /* Create the HDF file for the HDF metadata from the XML metadata.  This
        also creates the big endian files for the HDF file. */
-    if (create_hdf_metadata (hdf_file, &xml_metadata, del_src) != SUCCESS)
+    if (create_hdf_metadata (hdf_file, &xml_metadata, compress, del_src) !=
+        SUCCESS)
     {
         sprintf (errmsg, "Creating the HDF metadata file (%s) which links to "
             "the raw binary bands as external SDSs.", hdf_file);
@@ -1068,9 +1459,23 @@ int convert_espa_to_hdf
     }
 
     /* Loop through the bands and modify the band names to match the new
-       (external) raw binary filenames in the HDF product */
+       (external) raw binary filenames in the HDF product.  Compressed SDSs
+       are stored in the HDF file itself. */
     for (i = 0; i < xml_metadata.nbands; i++)
     {
+        if (compress != HDF_COMPRESS_NONE)
+        {
+            count = snprintf (xml_metadata.band[i].file_name,
+                sizeof (xml_metadata.band[i].file_name), "%s", hdf_file);
+            if (count < 0 || count >= sizeof (xml_metadata.band[i].file_name))
+            {
+                sprintf (errmsg, "Overflow of band file_name string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            continue;
+        }
+
         count = snprintf (bendian_file, sizeof (bendian_file), "%s",
             xml_metadata.band[i].file_name);
         if (count < 0 || count >= sizeof (bendian_file))
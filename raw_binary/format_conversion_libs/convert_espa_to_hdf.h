@@ -28,10 +28,29 @@ NOTES:
 #include "espa_hdf_eos.h"
 #include "envi_header.h"
 #include "raw_binary_io.h"
+#include "raw_binary_reclaim.h"
 
 /* Defines */
 #define HDF_ERROR -1
 
+/* Size (in lines and samples) of the chunks used for compressed SDSs.  The
+   compressed SDSs are written one row of chunks at a time. */
+#define HDF_CHUNK_SIZE 256
+
+/* Compression settings for the compressed SDSs */
+#define HDF_DEFLATE_LEVEL 6
+#define HDF_SZIP_PIXELS_PER_BLOCK 16
+
+/* Type definitions */
+/* Storage to be used for the SDSs in the HDF file */
+typedef enum
+{
+    HDF_COMPRESS_NONE,     /* external SDSs pointing to big endian raw binary
+                              files (default) */
+    HDF_COMPRESS_DEFLATE,  /* internal, chunked SDSs compressed with deflate */
+    HDF_COMPRESS_SZIP      /* internal, chunked SDSs compressed with szip */
+} Hdf_compress_t;
+
 /* Prototypes */
 int write_global_attributes
 (
@@ -49,6 +68,8 @@ int create_hdf_metadata
 (
     char *hdf_file,                     /* I: output HDF filename */
     Espa_internal_meta_t *xml_metadata, /* I: XML metadata structure */
+    Hdf_compress_t compress,            /* I: storage/compression to be used
+                                              for the SDSs */
     bool del_src           /* I: should the source files be removed after
                                  conversion? */
 );
@@ -57,6 +78,8 @@ int convert_espa_to_hdf
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
     char *hdf_file,        /* I: output HDF filename */
+    Hdf_compress_t compress, /* I: storage/compression to be used for the
+                                   SDSs */
     bool del_src           /* I: should the source files be removed after
                                  conversion? */
 );
@@ -0,0 +1,1415 @@
+/*****************************************************************************
+FILE: convert_espa_to_netcdf.c
+
+PURPOSE: Contains functions for writing the bands in the XML file to a
+NetCDF-4 (HDF5) file of chunked, compressed variables.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each band is a 2-D variable named after the band, with the band
+     metadata as its attributes, and the global metadata are the global
+     attributes.  The grid mapping is the crs variable, and bands of the
+     same size share the y and x dimensions, whose coordinate variables are
+     the projection coordinates of the pixel centers.
+  2. The variables are chunked and use the shuffle (for multi-byte data) and
+     deflate filters.  The chunks are shuffled and compressed here, in
+     parallel by the task runtime (see espa_task.h), and handed to HDF5 with
+     direct chunk writes.  HDF5 itself is only called from the calling
+     thread.
+  3. Chunks which are all fill aren't written, since HDF5 returns the fill
+     value of the variable for them.
+*****************************************************************************/
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "convert_espa_to_netcdf.h"
+#include "raw_binary_pool.h"
+#include "espa_task.h"
+
+/* Row of chunks compressed by the chunks of espa_parallel_for */
+typedef struct
+{
+    uint8_t *line_buf;        /* lines of the band covered by the row */
+    int nrow_lines;           /* number of band lines in the row */
+    int nsamps;               /* number of samples in the band */
+    int chunk_lines;          /* number of lines in a chunk */
+    int chunk_samps;          /* number of samples in a chunk */
+    int size;                 /* number of bytes per pixel */
+    int level;                /* deflate level */
+    bool skip_fill;           /* should all-fill chunks be skipped? */
+    uint8_t *fill_chunk;      /* chunk of fill values */
+    uint8_t **chunk_buf;      /* chunk being compressed, per runner */
+    uint8_t **shuffle_buf;    /* shuffled chunk, per runner (multi-byte
+                                 data only) */
+    uint8_t **comp_buf;       /* compressed chunk, per chunk column */
+    size_t *comp_len;         /* size of each compressed chunk; 0 if the
+                                 chunk is skipped */
+    uLong comp_bound;         /* size of each comp_buf */
+} Netcdf_row_t;
+
+/******************************************************************************
+MODULE:  get_netcdf_type
+
+PURPOSE: Gets the HDF5 file data type of an ESPA data type.
+
+RETURN VALUE:
+Type = hid_t
+Value           Description
+-----           -----------
+-1              Unsupported data type
+other           HDF5 data type
+
+NOTES:
+******************************************************************************/
+static hid_t get_netcdf_type
+(
+    enum Espa_data_type data_type   /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:    return (H5T_STD_I8LE);
+        case ESPA_UINT8:   return (H5T_STD_U8LE);
+        case ESPA_INT16:   return (H5T_STD_I16LE);
+        case ESPA_UINT16:  return (H5T_STD_U16LE);
+        case ESPA_INT32:   return (H5T_STD_I32LE);
+        case ESPA_UINT32:  return (H5T_STD_U32LE);
+        case ESPA_FLOAT32: return (H5T_IEEE_F32LE);
+        case ESPA_FLOAT64: return (H5T_IEEE_F64LE);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_attr
+
+PURPOSE: Writes a numeric attribute of an HDF5 object.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attribute
+SUCCESS         Successfully wrote the attribute
+
+NOTES:
+  1. The values are converted from the memory type to the file type by
+     HDF5.
+******************************************************************************/
+static int write_netcdf_attr
+(
+    hid_t obj,            /* I: HDF5 file or dataset */
+    const char *name,     /* I: attribute name */
+    hid_t file_type,      /* I: data type of the attribute in the file */
+    hid_t mem_type,       /* I: data type of values */
+    int nvalues,          /* I: number of values */
+    const void *values    /* I: attribute values */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_attr";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    hsize_t dims = nvalues;     /* size of the attribute */
+    hid_t space;                /* dataspace of the attribute */
+    hid_t attr;                 /* attribute */
+    herr_t status;              /* status of writing the attribute */
+
+    space = (nvalues == 1) ? H5Screate (H5S_SCALAR) :
+        H5Screate_simple (1, &dims, NULL);
+    attr = H5Acreate2 (obj, name, file_type, space, H5P_DEFAULT,
+        H5P_DEFAULT);
+    status = (attr < 0) ? -1 : H5Awrite (attr, mem_type, values);
+    if (attr >= 0)
+        H5Aclose (attr);
+    H5Sclose (space);
+    if (status < 0)
+    {
+        sprintf (errmsg, "Writing the %s attribute", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_text_attr
+
+PURPOSE: Writes a text attribute of an HDF5 object, unless the text is empty
+or undefined.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attribute
+SUCCESS         Successfully wrote the attribute, or it was left out
+
+NOTES:
+  1. The text is a fixed-length string, which NetCDF reads as a character
+     attribute.
+******************************************************************************/
+static int write_netcdf_text_attr
+(
+    hid_t obj,            /* I: HDF5 file or dataset */
+    const char *name,     /* I: attribute name */
+    const char *value     /* I: attribute value */
+)
+{
+    hid_t str_type;             /* string type of the value */
+    int status;                 /* status of writing the attribute */
+
+    if (value[0] == '\0' || !strcmp (value, ESPA_STRING_META_FILL))
+        return (SUCCESS);
+
+    str_type = H5Tcopy (H5T_C_S1);
+    H5Tset_size (str_type, strlen (value));
+    H5Tset_strpad (str_type, H5T_STR_NULLTERM);
+    status = write_netcdf_attr (obj, name, str_type, str_type, 1, value);
+    H5Tclose (str_type);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_double_attr
+
+PURPOSE: Writes a 64-bit float attribute of an HDF5 object, unless the value
+is undefined.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attribute
+SUCCESS         Successfully wrote the attribute, or it was left out
+
+NOTES:
+******************************************************************************/
+static int write_netcdf_double_attr
+(
+    hid_t obj,            /* I: HDF5 file or dataset */
+    const char *name,     /* I: attribute name */
+    double value          /* I: attribute value */
+)
+{
+    if (fabs (value - ESPA_FLOAT_META_FILL) < ESPA_EPSILON)
+        return (SUCCESS);
+
+    return (write_netcdf_attr (obj, name, H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE,
+        1, &value));
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_int_attr
+
+PURPOSE: Writes a 32-bit integer attribute of an HDF5 object, unless the
+value is undefined.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attribute
+SUCCESS         Successfully wrote the attribute, or it was left out
+
+NOTES:
+******************************************************************************/
+static int write_netcdf_int_attr
+(
+    hid_t obj,            /* I: HDF5 file or dataset */
+    const char *name,     /* I: attribute name */
+    int value             /* I: attribute value */
+)
+{
+    if (value == ESPA_INT_META_FILL)
+        return (SUCCESS);
+
+    return (write_netcdf_attr (obj, name, H5T_STD_I32LE, H5T_NATIVE_INT, 1,
+        &value));
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_global_attrs
+
+PURPOSE: Writes the global metadata as the global attributes of the file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attributes
+SUCCESS         Successfully wrote the attributes
+
+NOTES:
+******************************************************************************/
+static int write_netcdf_global_attrs
+(
+    hid_t file,           /* I: HDF5 file */
+    Espa_global_meta_t *gmeta  /* I: global metadata */
+)
+{
+    int status = SUCCESS;       /* status of writing the attributes */
+    double bounds[4];           /* bounding coordinates */
+
+    bounds[0] = gmeta->bounding_coords[ESPA_WEST];
+    bounds[1] = gmeta->bounding_coords[ESPA_EAST];
+    bounds[2] = gmeta->bounding_coords[ESPA_NORTH];
+    bounds[3] = gmeta->bounding_coords[ESPA_SOUTH];
+
+    status |= write_netcdf_text_attr (file, "Conventions", "CF-1.8");
+    status |= write_netcdf_text_attr (file, "institution",
+        gmeta->data_provider);
+    status |= write_netcdf_text_attr (file, "satellite", gmeta->satellite);
+    status |= write_netcdf_text_attr (file, "instrument", gmeta->instrument);
+    status |= write_netcdf_text_attr (file, "acquisition_date",
+        gmeta->acquisition_date);
+    status |= write_netcdf_text_attr (file, "scene_center_time",
+        gmeta->scene_center_time);
+    status |= write_netcdf_text_attr (file, "level1_production_date",
+        gmeta->level1_production_date);
+    status |= write_netcdf_text_attr (file, "product_id", gmeta->product_id);
+    status |= write_netcdf_text_attr (file, "lpgs_metadata_file",
+        gmeta->lpgs_metadata_file);
+    status |= write_netcdf_int_attr (file, "wrs_system", gmeta->wrs_system);
+    status |= write_netcdf_int_attr (file, "wrs_path", gmeta->wrs_path);
+    status |= write_netcdf_int_attr (file, "wrs_row", gmeta->wrs_row);
+    status |= write_netcdf_int_attr (file, "htile", gmeta->htile);
+    status |= write_netcdf_int_attr (file, "vtile", gmeta->vtile);
+    status |= write_netcdf_double_attr (file, "solar_zenith",
+        gmeta->solar_zenith);
+    status |= write_netcdf_double_attr (file, "solar_azimuth",
+        gmeta->solar_azimuth);
+    status |= write_netcdf_double_attr (file, "earth_sun_distance",
+        gmeta->earth_sun_dist);
+    status |= write_netcdf_double_attr (file, "orientation_angle",
+        gmeta->orientation_angle);
+    status |= write_netcdf_attr (file, "bounding_coordinates",
+        H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, 4, bounds);
+
+    return ((status == SUCCESS) ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_crs
+
+PURPOSE: Writes the grid mapping variable of the projection.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the grid mapping
+SUCCESS         Successfully wrote the grid mapping
+
+NOTES:
+  1. The grid mapping is a scalar variable with the CF grid mapping
+     attributes of the projection and the ellipsoid of the datum.  The
+     GCTP projection parameters are also kept.
+******************************************************************************/
+static int write_netcdf_crs
+(
+    hid_t file,           /* I: HDF5 file */
+    Espa_proj_meta_t *proj  /* I: projection information */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_crs";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status = SUCCESS;       /* status of writing the attributes */
+    int value = 0;              /* value of the grid mapping variable */
+    double parallels[2];        /* standard parallels */
+    double semi_major = 0.0;    /* semi-major axis of the ellipsoid */
+    double inv_flattening = 0.0;  /* inverse flattening of the ellipsoid */
+    hid_t space;                /* dataspace of the variable */
+    hid_t crs;                  /* grid mapping variable */
+
+    space = H5Screate (H5S_SCALAR);
+    crs = H5Dcreate2 (file, NETCDF_CRS_NAME, H5T_STD_I32LE, space,
+        H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Sclose (space);
+    if (crs < 0 || H5Dwrite (crs, H5T_NATIVE_INT, H5S_ALL, H5S_ALL,
+        H5P_DEFAULT, &value) < 0)
+    {
+        sprintf (errmsg, "Creating the grid mapping variable");
+        error_handler (true, FUNC_NAME, errmsg);
+        if (crs >= 0)
+            H5Dclose (crs);
+        return (ERROR);
+    }
+
+    switch (proj->proj_type)
+    {
+        case GCTP_GEO_PROJ:
+            status |= write_netcdf_text_attr (crs, "grid_mapping_name",
+                "latitude_longitude");
+            break;
+
+        case GCTP_UTM_PROJ:
+            status |= write_netcdf_text_attr (crs, "grid_mapping_name",
+                "transverse_mercator");
+            status |= write_netcdf_double_attr (crs,
+                "scale_factor_at_central_meridian", 0.9996);
+            status |= write_netcdf_double_attr (crs,
+                "longitude_of_central_meridian",
+                abs (proj->utm_zone) * 6.0 - 183.0);
+            status |= write_netcdf_double_attr (crs,
+                "latitude_of_projection_origin", 0.0);
+            status |= write_netcdf_double_attr (crs, "false_easting",
+                500000.0);
+            status |= write_netcdf_double_attr (crs, "false_northing",
+                (proj->utm_zone < 0) ? 10000000.0 : 0.0);
+            status |= write_netcdf_int_attr (crs, "utm_zone", proj->utm_zone);
+            break;
+
+        case GCTP_ALBERS_PROJ:
+            parallels[0] = proj->standard_parallel1;
+            parallels[1] = proj->standard_parallel2;
+            status |= write_netcdf_text_attr (crs, "grid_mapping_name",
+                "albers_conical_equal_area");
+            status |= write_netcdf_attr (crs, "standard_parallel",
+                H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, 2, parallels);
+            status |= write_netcdf_double_attr (crs,
+                "longitude_of_central_meridian", proj->central_meridian);
+            status |= write_netcdf_double_attr (crs,
+                "latitude_of_projection_origin", proj->origin_latitude);
+            status |= write_netcdf_double_attr (crs, "false_easting",
+                proj->false_easting);
+            status |= write_netcdf_double_attr (crs, "false_northing",
+                proj->false_northing);
+            break;
+
+        case GCTP_PS_PROJ:
+            status |= write_netcdf_text_attr (crs, "grid_mapping_name",
+                "polar_stereographic");
+            status |= write_netcdf_double_attr (crs,
+                "straight_vertical_longitude_from_pole",
+                proj->longitude_pole);
+            status |= write_netcdf_double_attr (crs,
+                "latitude_of_projection_origin",
+                (proj->latitude_true_scale < 0.0) ? -90.0 : 90.0);
+            status |= write_netcdf_double_attr (crs, "standard_parallel",
+                proj->latitude_true_scale);
+            status |= write_netcdf_double_attr (crs, "false_easting",
+                proj->false_easting);
+            status |= write_netcdf_double_attr (crs, "false_northing",
+                proj->false_northing);
+            break;
+
+        case GCTP_SIN_PROJ:
+            status |= write_netcdf_text_attr (crs, "grid_mapping_name",
+                "sinusoidal");
+            status |= write_netcdf_double_attr (crs,
+                "longitude_of_central_meridian", proj->central_meridian);
+            status |= write_netcdf_double_attr (crs, "false_easting",
+                proj->false_easting);
+            status |= write_netcdf_double_attr (crs, "false_northing",
+                proj->false_northing);
+            status |= write_netcdf_double_attr (crs, "earth_radius",
+                proj->sphere_radius);
+            break;
+    }
+
+    /* Ellipsoid of the datum; the sinusoidal projection uses a sphere */
+    if (proj->datum_type == ESPA_WGS84)
+    {
+        semi_major = GCTP_WGS84_SEMI_MAJOR;
+        inv_flattening = GCTP_WGS84_INV_FLATTENING;
+    }
+    else if (proj->datum_type == ESPA_NAD83)
+    {
+        semi_major = GCTP_GRS80_SEMI_MAJOR;
+        inv_flattening = GCTP_GRS80_INV_FLATTENING;
+    }
+    else if (proj->datum_type == ESPA_NAD27)
+    {
+        semi_major = GCTP_CLARKE_1866_SEMI_MAJOR;
+        inv_flattening = GCTP_CLARKE_1866_INV_FLATTENING;
+    }
+    if (semi_major > 0.0 && proj->proj_type != GCTP_SIN_PROJ)
+    {
+        status |= write_netcdf_double_attr (crs, "semi_major_axis",
+            semi_major);
+        status |= write_netcdf_double_attr (crs, "inverse_flattening",
+            inv_flattening);
+    }
+
+    status |= write_netcdf_int_attr (crs, "gctp_projection",
+        proj->proj_type);
+    status |= write_netcdf_int_attr (crs, "espa_datum", proj->datum_type);
+    status |= write_netcdf_text_attr (crs, "grid_origin", proj->grid_origin);
+    H5Dclose (crs);
+
+    return ((status == SUCCESS) ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_coord
+
+PURPOSE: Writes the coordinate variable of the projection coordinates of the
+pixel centers along the y or x dimension of a band.
+
+RETURN VALUE:
+Type = hid_t
+Value           Description
+-----           -----------
+-1              Error writing the coordinates
+other           HDF5 dataset of the coordinates, which is the dimension scale
+                of the dimension
+
+NOTES:
+  1. The UL corner of the projection information is the center of the UL
+     pixel if the grid origin is CENTER, otherwise its outer corner.
+  2. The caller closes the dataset once the bands of the dimension are
+     attached to it.
+******************************************************************************/
+static hid_t write_netcdf_coord
+(
+    hid_t file,           /* I: HDF5 file */
+    char *dim,            /* I: name of the dimension */
+    bool is_y,            /* I: is this the y dimension? */
+    Espa_proj_meta_t *proj,  /* I: projection information */
+    Espa_band_meta_t *bmeta  /* I: metadata of a band of the dimension */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_coord";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the coordinates */
+    int status = SUCCESS;       /* status of writing the coordinates */
+    double first;               /* coordinate of the first pixel center */
+    double step;                /* coordinate change between pixels */
+    double *coords = NULL;      /* coordinates of the pixel centers */
+    hsize_t n;                  /* number of coordinates */
+    hid_t space;                /* dataspace of the coordinates */
+    hid_t dset;                 /* coordinate variable */
+
+    if (is_y)
+    {
+        n = bmeta->nlines;
+        first = proj->ul_corner[1];
+        step = -bmeta->pixel_size[1];
+    }
+    else
+    {
+        n = bmeta->nsamps;
+        first = proj->ul_corner[0];
+        step = bmeta->pixel_size[0];
+    }
+    if (strcmp (proj->grid_origin, "CENTER"))
+        first += 0.5 * step;
+
+    coords = malloc (n * sizeof (double));
+    if (coords == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the %s coordinates", dim);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+    for (i = 0; i < n; i++)
+        coords[i] = first + i * step;
+
+    space = H5Screate_simple (1, &n, NULL);
+    dset = H5Dcreate2 (file, dim, H5T_IEEE_F64LE, space, H5P_DEFAULT,
+        H5P_DEFAULT, H5P_DEFAULT);
+    H5Sclose (space);
+    if (dset < 0 || H5Dwrite (dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+        H5P_DEFAULT, coords) < 0 || H5DSset_scale (dset, dim) < 0)
+    {
+        sprintf (errmsg, "Writing the %s coordinate variable", dim);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (coords);
+        if (dset >= 0)
+            H5Dclose (dset);
+        return (-1);
+    }
+    free (coords);
+
+    /* Attributes of the coordinates */
+    if (proj->proj_type == GCTP_GEO_PROJ)
+    {
+        status |= write_netcdf_text_attr (dset, "standard_name",
+            is_y ? "latitude" : "longitude");
+        status |= write_netcdf_text_attr (dset, "units",
+            is_y ? "degrees_north" : "degrees_east");
+    }
+    else
+    {
+        status |= write_netcdf_text_attr (dset, "standard_name", is_y ?
+            "projection_y_coordinate" : "projection_x_coordinate");
+        status |= write_netcdf_text_attr (dset, "units",
+            !strcmp (proj->units, "meters") ? "m" : proj->units);
+    }
+    status |= write_netcdf_text_attr (dset, "axis", is_y ? "Y" : "X");
+    if (status != SUCCESS)
+    {
+        H5Dclose (dset);
+        return (-1);
+    }
+
+    return (dset);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_flag_attrs
+
+PURPOSE: Writes the CF flag attributes of the classes or the bitmap
+description of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attributes
+SUCCESS         Successfully wrote the attributes, or the band has no flags
+
+NOTES:
+  1. The classes are flag_values and the bits of the bitmap description are
+     flag_masks, with the descriptions as the flag_meanings.  Each meaning
+     is a single word, so the characters other than letters and digits are
+     replaced with underscores.
+  2. Only integer bands have flags.
+******************************************************************************/
+static int write_netcdf_flag_attrs
+(
+    hid_t dset,           /* I: band variable */
+    hid_t file_type,      /* I: data type of the band */
+    Espa_band_meta_t *bmeta  /* I: band metadata */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_flag_attrs";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char *meanings = NULL;      /* flag meanings, separated by blanks */
+    char *cptr = NULL;          /* pointer to the current meaning */
+    const char *desc = NULL;    /* description of the current flag */
+    int i;                      /* looping variable for the flags */
+    int nflags;                 /* number of flags */
+    int status;                 /* status of writing the attributes */
+    long *values = NULL;        /* flag values or masks */
+    bool is_class;              /* are the flags classes? */
+
+    if (bmeta->data_type == ESPA_FLOAT32 || bmeta->data_type == ESPA_FLOAT64)
+        return (SUCCESS);
+
+    is_class = (bmeta->nclass > 0 && bmeta->class_values != NULL);
+    if (is_class)
+        nflags = bmeta->nclass;
+    else if (bmeta->nbits > 0 && bmeta->bitmap_description != NULL)
+    {
+        nflags = bmeta->nbits;
+        if (nflags > 8 * get_data_type_size (bmeta->data_type))
+            nflags = 8 * get_data_type_size (bmeta->data_type);
+    }
+    else
+        return (SUCCESS);
+
+    values = malloc (nflags * sizeof (long));
+    meanings = malloc (nflags * (STR_SIZE + 1));
+    if (values == NULL || meanings == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the flags of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (values);
+        free (meanings);
+        return (ERROR);
+    }
+
+    cptr = meanings;
+    for (i = 0; i < nflags; i++)
+    {
+        if (is_class)
+        {
+            values[i] = bmeta->class_values[i].class;
+            desc = bmeta->class_values[i].description;
+        }
+        else
+        {
+            values[i] = 1L << i;
+            desc = bmeta->bitmap_description[i];
+        }
+
+        if (i > 0)
+            *cptr++ = ' ';
+        if (desc[0] == '\0')
+            cptr += sprintf (cptr, "%s_%d", is_class ? "class" : "bit", i);
+        for (; *desc != '\0'; desc++)
+            *cptr++ = isalnum ((unsigned char) *desc) ? *desc : '_';
+    }
+    *cptr = '\0';
+
+    status = write_netcdf_attr (dset, is_class ? "flag_values" :
+        "flag_masks", file_type, H5T_NATIVE_LONG, nflags, values);
+    if (status == SUCCESS)
+        status = write_netcdf_text_attr (dset, "flag_meanings", meanings);
+    free (values);
+    free (meanings);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_band_attrs
+
+PURPOSE: Writes the band metadata as the attributes of a band variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attributes
+SUCCESS         Successfully wrote the attributes
+
+NOTES:
+  1. The _FillValue and valid_range are of the data type of the band, and
+     the scale_factor and add_offset are 32-bit floats, as CF expects for
+     packed data.
+******************************************************************************/
+static int write_netcdf_band_attrs
+(
+    hid_t dset,           /* I: band variable */
+    hid_t file_type,      /* I: data type of the band */
+    Espa_band_meta_t *bmeta  /* I: band metadata */
+)
+{
+    int status = SUCCESS;       /* status of writing the attributes */
+
+    status |= write_netcdf_text_attr (dset, "long_name", bmeta->long_name);
+    status |= write_netcdf_text_attr (dset, "units", bmeta->data_units);
+    status |= write_netcdf_text_attr (dset, "grid_mapping", NETCDF_CRS_NAME);
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        status |= write_netcdf_attr (dset, "_FillValue", file_type,
+            H5T_NATIVE_LONG, 1, &bmeta->fill_value);
+    if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        status |= write_netcdf_attr (dset, "valid_range", file_type,
+            H5T_NATIVE_FLOAT, 2, bmeta->valid_range);
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        status |= write_netcdf_attr (dset, "scale_factor", H5T_IEEE_F32LE,
+            H5T_NATIVE_FLOAT, 1, &bmeta->scale_factor);
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        status |= write_netcdf_attr (dset, "add_offset", H5T_IEEE_F32LE,
+            H5T_NATIVE_FLOAT, 1, &bmeta->add_offset);
+    status |= write_netcdf_flag_attrs (dset, file_type, bmeta);
+
+    status |= write_netcdf_text_attr (dset, "product", bmeta->product);
+    status |= write_netcdf_text_attr (dset, "source", bmeta->source);
+    status |= write_netcdf_text_attr (dset, "category", bmeta->category);
+    status |= write_netcdf_text_attr (dset, "short_name", bmeta->short_name);
+    status |= write_netcdf_int_attr (dset, "saturate_value",
+        bmeta->saturate_value);
+    status |= write_netcdf_double_attr (dset, "radiance_gain",
+        bmeta->rad_gain);
+    status |= write_netcdf_double_attr (dset, "radiance_bias",
+        bmeta->rad_bias);
+    status |= write_netcdf_double_attr (dset, "reflectance_gain",
+        bmeta->refl_gain);
+    status |= write_netcdf_double_attr (dset, "reflectance_bias",
+        bmeta->refl_bias);
+    status |= write_netcdf_double_attr (dset, "k1_constant",
+        bmeta->k1_const);
+    status |= write_netcdf_double_attr (dset, "k2_constant",
+        bmeta->k2_const);
+    status |= write_netcdf_text_attr (dset, "qa_description",
+        bmeta->qa_desc);
+    status |= write_netcdf_text_attr (dset, "app_version",
+        bmeta->app_version);
+    status |= write_netcdf_text_attr (dset, "production_date",
+        bmeta->production_date);
+
+    return ((status == SUCCESS) ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  compress_netcdf_chunks
+
+PURPOSE: Pads, shuffles and compresses a range of chunks of a row of chunks,
+as the chunk function of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compressing a chunk
+SUCCESS         Successfully compressed the chunks
+
+NOTES:
+  1. The shuffle filter of HDF5 stores byte k of every pixel together,
+     for k from 0 to the pixel size minus 1, which is done here before the
+     deflate.
+******************************************************************************/
+static int compress_netcdf_chunks
+(
+    void *arg,              /* I: row of chunks (Netcdf_row_t *) */
+    int first,              /* I: first chunk column */
+    int end,                /* I: chunk column after the last one */
+    int runner              /* I: number of the runner */
+)
+{
+    char FUNC_NAME[] = "compress_netcdf_chunks";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int c;                      /* looping variable for the chunk columns */
+    int l;                      /* looping variable for the chunk lines */
+    int k;                      /* looping variable for the pixel bytes */
+    int samp;                   /* first sample of the chunk */
+    int nchunk_samps;           /* number of band samples in the chunk */
+    size_t p;                   /* looping variable for the chunk pixels */
+    size_t npix;                /* number of pixels in a chunk */
+    size_t chunk_bytes;         /* number of bytes in a chunk */
+    size_t chunk_line_bytes;    /* number of bytes in a chunk line */
+    uLongf comp_len;            /* size of the compressed chunk */
+    Netcdf_row_t *nr = arg;     /* row of chunks */
+    uint8_t *chunk = nr->chunk_buf[runner];  /* chunk being compressed */
+    uint8_t *data = NULL;       /* chunk data handed to deflate */
+
+    npix = (size_t) nr->chunk_lines * nr->chunk_samps;
+    chunk_line_bytes = (size_t) nr->chunk_samps * nr->size;
+    chunk_bytes = npix * nr->size;
+    for (c = first; c < end; c++)
+    {
+        /* Copy the chunk, padding the edge chunks with fill */
+        samp = c * nr->chunk_samps;
+        nchunk_samps = nr->chunk_samps;
+        if (samp + nchunk_samps > nr->nsamps)
+            nchunk_samps = nr->nsamps - samp;
+        if (nchunk_samps < nr->chunk_samps ||
+            nr->nrow_lines < nr->chunk_lines)
+            memcpy (chunk, nr->fill_chunk, chunk_bytes);
+        for (l = 0; l < nr->nrow_lines; l++)
+            memcpy (&chunk[l * chunk_line_bytes], &nr->line_buf[
+                ((size_t) l * nr->nsamps + samp) * nr->size],
+                (size_t) nchunk_samps * nr->size);
+
+        /* Leave out the chunks which are all fill */
+        if (nr->skip_fill && !memcmp (chunk, nr->fill_chunk, chunk_bytes))
+        {
+            nr->comp_len[c] = 0;
+            continue;
+        }
+
+        /* Shuffle the bytes of multi-byte pixels */
+        data = chunk;
+        if (nr->size > 1)
+        {
+            data = nr->shuffle_buf[runner];
+            for (k = 0; k < nr->size; k++)
+                for (p = 0; p < npix; p++)
+                    data[k * npix + p] = chunk[p * nr->size + k];
+        }
+
+        comp_len = nr->comp_bound;
+        if (compress2 (nr->comp_buf[c], &comp_len, data, chunk_bytes,
+            nr->level) != Z_OK)
+        {
+            sprintf (errmsg, "Compressing chunk column %d", c);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        nr->comp_len[c] = comp_len;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_netcdf_fill
+
+PURPOSE: Fills a chunk with the fill value of the band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The chunk is zeroed if the band has no fill value.
+******************************************************************************/
+static void set_netcdf_fill
+(
+    Espa_band_meta_t *bmeta,   /* I: band metadata */
+    size_t npix,               /* I: number of pixels in the chunk */
+    void *chunk                /* O: chunk of fill values */
+)
+{
+    size_t p;                  /* looping variable for the pixels */
+    long fill = bmeta->fill_value;  /* fill value of the band */
+
+    if (fill == ESPA_INT_META_FILL)
+    {
+        memset (chunk, 0, npix * get_data_type_size (bmeta->data_type));
+        return;
+    }
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+        case ESPA_UINT8:
+            memset (chunk, (int) (fill & 0xff), npix);
+            break;
+        case ESPA_INT16:
+        case ESPA_UINT16:
+            for (p = 0; p < npix; p++)
+                ((uint16_t *) chunk)[p] = (uint16_t) fill;
+            break;
+        case ESPA_INT32:
+        case ESPA_UINT32:
+            for (p = 0; p < npix; p++)
+                ((uint32_t *) chunk)[p] = (uint32_t) fill;
+            break;
+        case ESPA_FLOAT32:
+            for (p = 0; p < npix; p++)
+                ((float *) chunk)[p] = (float) fill;
+            break;
+        case ESPA_FLOAT64:
+            for (p = 0; p < npix; p++)
+                ((double *) chunk)[p] = (double) fill;
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_netcdf_band
+
+PURPOSE: Writes the chunks of a band to its variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chunks
+SUCCESS         Successfully wrote the chunks
+
+NOTES:
+  1. The band is read one row of chunks at a time.  The chunks of the row
+     are compressed in parallel by the task runtime, then written in order
+     with direct chunk writes, which bypass the HDF5 filter pipeline.
+  2. The dataset must be chunked with chunk_lines x chunk_samps chunks and
+     the shuffle (for multi-byte data) and deflate filters, in that order.
+******************************************************************************/
+int write_netcdf_band
+(
+    hid_t dset,            /* I: chunked HDF5 dataset of the band */
+    Espa_band_meta_t *bmeta,  /* I: band metadata; provides the raw binary
+                                 file, size, data type and fill value */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: deflate level of the chunks */
+)
+{
+    char FUNC_NAME[] = "write_netcdf_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int r;                      /* looping variable for the runners */
+    int c;                      /* looping variable for the chunk columns */
+    int line;                   /* first line of the current row */
+    int ncols;                  /* number of chunk columns */
+    int nthreads;               /* number of runners */
+    int status = SUCCESS;       /* status of writing the rows */
+    size_t chunk_bytes;         /* number of bytes in a chunk */
+    hsize_t offset[2];          /* first line and sample of a chunk */
+    FILE *fp_rb = NULL;         /* raw binary band file pointer */
+    Netcdf_row_t nr;            /* row of chunks being written */
+
+    memset (&nr, 0, sizeof (nr));
+    nr.nsamps = bmeta->nsamps;
+    nr.chunk_lines = chunk_lines;
+    nr.chunk_samps = chunk_samps;
+    nr.size = get_data_type_size (bmeta->data_type);
+    nr.level = level;
+    nr.skip_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    chunk_bytes = (size_t) chunk_lines * chunk_samps * nr.size;
+    nr.comp_bound = compressBound (chunk_bytes);
+    ncols = (bmeta->nsamps + chunk_samps - 1) / chunk_samps;
+    nthreads = espa_task_nthreads ();
+    if (nthreads > ncols)
+        nthreads = ncols;
+
+    /* Allocate the lines of a row, the fill chunk, the buffers of each
+       runner, and the compressed chunks of the row */
+    nr.line_buf = get_raw_binary_buffer ((size_t) chunk_lines *
+        bmeta->nsamps * nr.size, false);
+    nr.fill_chunk = malloc (chunk_bytes);
+    nr.chunk_buf = calloc (nthreads, sizeof (uint8_t *));
+    nr.shuffle_buf = calloc (nthreads, sizeof (uint8_t *));
+    nr.comp_buf = calloc (ncols, sizeof (uint8_t *));
+    nr.comp_len = calloc (ncols, sizeof (size_t));
+    if (nr.line_buf == NULL || nr.fill_chunk == NULL ||
+        nr.chunk_buf == NULL || nr.shuffle_buf == NULL ||
+        nr.comp_buf == NULL || nr.comp_len == NULL)
+        status = ERROR;
+    for (r = 0; r < nthreads && status == SUCCESS; r++)
+    {
+        nr.chunk_buf[r] = malloc (chunk_bytes);
+        if (nr.size > 1)
+            nr.shuffle_buf[r] = malloc (chunk_bytes);
+        if (nr.chunk_buf[r] == NULL ||
+            (nr.size > 1 && nr.shuffle_buf[r] == NULL))
+            status = ERROR;
+    }
+    for (c = 0; c < ncols && status == SUCCESS; c++)
+    {
+        nr.comp_buf[c] = malloc (nr.comp_bound);
+        if (nr.comp_buf[c] == NULL)
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating memory for the chunks of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else
+        set_netcdf_fill (bmeta, (size_t) chunk_lines * chunk_samps,
+            nr.fill_chunk);
+
+    /* Open the raw binary band */
+    if (status == SUCCESS)
+    {
+        fp_rb = open_raw_binary (bmeta->file_name, "rb");
+        if (fp_rb == NULL)
+        {
+            sprintf (errmsg, "Opening the raw binary file: %s",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Read a row of chunks at a time, compress its chunks and write them */
+    for (line = 0; status == SUCCESS && line < bmeta->nlines;
+        line += chunk_lines)
+    {
+        nr.nrow_lines = chunk_lines;
+        if (line + nr.nrow_lines > bmeta->nlines)
+            nr.nrow_lines = bmeta->nlines - line;
+
+        if (read_raw_binary (fp_rb, nr.nrow_lines, bmeta->nsamps, nr.size,
+            nr.line_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of band %s", line,
+                line + nr.nrow_lines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        status = espa_parallel_for (0, ncols, 1, nthreads,
+            compress_netcdf_chunks, &nr);
+
+        offset[0] = line;
+        for (c = 0; c < ncols && status == SUCCESS; c++)
+        {
+            if (nr.comp_len[c] == 0)
+                continue;
+            offset[1] = (hsize_t) c * chunk_samps;
+            if (H5Dwrite_chunk (dset, H5P_DEFAULT, 0, offset,
+                nr.comp_len[c], nr.comp_buf[c]) < 0)
+            {
+                sprintf (errmsg, "Writing the chunk at line %d, sample %d "
+                    "of band %s", line, c * chunk_samps, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+    }
+
+    /* Close the band and free the buffers */
+    if (fp_rb != NULL)
+        close_raw_binary (fp_rb);
+    for (r = 0; r < nthreads && nr.chunk_buf != NULL; r++)
+    {
+        free (nr.chunk_buf[r]);
+        if (nr.shuffle_buf != NULL)
+            free (nr.shuffle_buf[r]);
+    }
+    for (c = 0; c < ncols && nr.comp_buf != NULL; c++)
+        free (nr.comp_buf[c]);
+    free (nr.chunk_buf);
+    free (nr.shuffle_buf);
+    free (nr.comp_buf);
+    free (nr.comp_len);
+    free (nr.fill_chunk);
+    release_raw_binary_buffer (nr.line_buf);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  is_netcdf_name_used
+
+PURPOSE: Determines if a variable name is already used in the file.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The name is used by a previous band, or is the name of the
+                grid mapping or of a coordinate variable (y, x, y<n> or x<n>)
+false           The name is available
+
+NOTES:
+******************************************************************************/
+static bool is_netcdf_name_used
+(
+    const char *name,     /* I: variable name */
+    int nnames,           /* I: number of names already used */
+    char (*names)[STR_SIZE]  /* I: names already used */
+)
+{
+    int i;                /* looping variable for the names */
+
+    if (!strcmp (name, NETCDF_CRS_NAME))
+        return (true);
+    if ((name[0] == 'y' || name[0] == 'x') &&
+        strspn (&name[1], "0123456789") == strlen (&name[1]))
+        return (true);
+
+    for (i = 0; i < nnames; i++)
+    {
+        if (!strcmp (names[i], name))
+            return (true);
+    }
+
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE:  create_netcdf_band
+
+PURPOSE: Creates the chunked variable of a band, with its attributes and
+dimensions.
+
+RETURN VALUE:
+Type = hid_t
+Value           Description
+-----           -----------
+-1              Error creating the variable
+other           HDF5 dataset of the band
+
+NOTES:
+  1. The fill value of the band is the fill value of the dataset, which is
+     returned for the chunks that aren't written.
+******************************************************************************/
+static hid_t create_netcdf_band
+(
+    hid_t file,           /* I: HDF5 file */
+    char *name,           /* I: variable name */
+    Espa_band_meta_t *bmeta,  /* I: band metadata */
+    int chunk_lines,      /* I: number of lines in a chunk */
+    int chunk_samps,      /* I: number of samples in a chunk */
+    int level,            /* I: deflate level of the chunks */
+    hid_t ydim,           /* I: y dimension scale */
+    hid_t xdim            /* I: x dimension scale */
+)
+{
+    char FUNC_NAME[] = "create_netcdf_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    hsize_t dims[2];            /* lines and samples of the band */
+    hsize_t chunks[2];          /* chunk lines and samples */
+    hid_t file_type;            /* data type of the band */
+    hid_t space;                /* dataspace of the band */
+    hid_t dcpl;                 /* dataset creation properties */
+    hid_t dset;                 /* band variable */
+
+    file_type = get_netcdf_type (bmeta->data_type);
+    if (file_type < 0)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    dims[0] = bmeta->nlines;
+    dims[1] = bmeta->nsamps;
+    chunks[0] = chunk_lines;
+    chunks[1] = chunk_samps;
+    dcpl = H5Pcreate (H5P_DATASET_CREATE);
+    H5Pset_chunk (dcpl, 2, chunks);
+    if (get_data_type_size (bmeta->data_type) > 1)
+        H5Pset_shuffle (dcpl);
+    H5Pset_deflate (dcpl, level);
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        H5Pset_fill_value (dcpl, H5T_NATIVE_LONG, &bmeta->fill_value);
+    H5Pset_attr_creation_order (dcpl, H5P_CRT_ORDER_TRACKED |
+        H5P_CRT_ORDER_INDEXED);
+
+    space = H5Screate_simple (2, dims, NULL);
+    dset = H5Dcreate2 (file, name, file_type, space, H5P_DEFAULT, dcpl,
+        H5P_DEFAULT);
+    H5Sclose (space);
+    H5Pclose (dcpl);
+    if (dset < 0)
+    {
+        sprintf (errmsg, "Creating the variable of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    if (H5DSattach_scale (dset, ydim, 0) < 0 ||
+        H5DSattach_scale (dset, xdim, 1) < 0 ||
+        write_netcdf_band_attrs (dset, file_type, bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the attributes of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        H5Dclose (dset);
+        return (-1);
+    }
+
+    return (dset);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_netcdf
+
+PURPOSE: Converts the internal ESPA raw binary product to a NetCDF-4 file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to NetCDF
+SUCCESS         Successfully converted to NetCDF
+
+NOTES:
+  1. Each band is written to the variable named after the band, with the
+     characters other than letters, digits, - and _ replaced with
+     underscores.  The variable of a band whose name is already used by
+     another band, the grid mapping or a coordinate variable is named
+     <product>_<band>, or <product>_<band>_<n> for the nth band of the XML
+     file if that's used as well.
+  2. The first band size has the y and x dimensions; the other band sizes
+     have y<n> and x<n>, numbering the sizes from 1.
+  3. The chunks are no larger than the band.
+******************************************************************************/
+int convert_espa_to_netcdf
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *netcdf_file,     /* I: output NetCDF-4 filename */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: deflate level of the chunks, from 0
+                                 (stored) to 9 */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_netcdf";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char dim_name[STR_SIZE];    /* name of a new dimension */
+    char *cptr = NULL;          /* pointer to the current name character */
+    int i;                      /* looping variable for each band */
+    int k;                      /* looping variable for the name choices */
+    int g;                      /* looping variable for the band sizes */
+    int ngrids = 0;             /* number of distinct band sizes */
+    int count;                  /* number of chars copied in snprintf */
+    int nchunk_lines;           /* chunk lines of the band */
+    int nchunk_samps;           /* chunk samples of the band */
+    int status = SUCCESS;       /* status of the conversion */
+    char (*var_names)[STR_SIZE] = NULL;  /* variable name of each band */
+    Espa_band_meta_t *bmeta = NULL;  /* current band metadata */
+    Espa_band_meta_t *grid[NETCDF_MAX_GRIDS];  /* first band of each size */
+    hid_t ydims[NETCDF_MAX_GRIDS];  /* y dimension scale of each size */
+    hid_t xdims[NETCDF_MAX_GRIDS];  /* x dimension scale of each size */
+    hid_t fcpl;                 /* file creation properties */
+    hid_t file;                 /* NetCDF-4 file */
+    hid_t dset;                 /* current band variable */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the XML metadata file */
+
+    /* Check the chunking and the deflate level */
+    if (chunk_lines < 1 || chunk_lines > NETCDF_MAX_CHUNK_SIZE ||
+        chunk_samps < 1 || chunk_samps > NETCDF_MAX_CHUNK_SIZE)
+    {
+        sprintf (errmsg, "Chunk lines and samples must be from 1 to %d",
+            NETCDF_MAX_CHUNK_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (level < 0 || level > 9)
+    {
+        sprintf (errmsg, "Deflate level must be from 0 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Allocate the variable names of the bands */
+    var_names = calloc (xml_metadata.nbands, STR_SIZE);
+    if (var_names == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the variable names");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Create the file, tracking the creation order of the variables and
+       attributes as NetCDF-4 does, and write the global attributes and the
+       grid mapping */
+    fcpl = H5Pcreate (H5P_FILE_CREATE);
+    H5Pset_link_creation_order (fcpl, H5P_CRT_ORDER_TRACKED |
+        H5P_CRT_ORDER_INDEXED);
+    H5Pset_attr_creation_order (fcpl, H5P_CRT_ORDER_TRACKED |
+        H5P_CRT_ORDER_INDEXED);
+    file = H5Fcreate (netcdf_file, H5F_ACC_TRUNC, fcpl, H5P_DEFAULT);
+    H5Pclose (fcpl);
+    if (file < 0)
+    {
+        sprintf (errmsg, "Creating the NetCDF file: %s", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (var_names);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    if (write_netcdf_global_attrs (file, &xml_metadata.global) != SUCCESS ||
+        write_netcdf_crs (file, &xml_metadata.global.proj_info) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the global attributes and grid mapping");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Loop through the bands in the XML file and write each one to its own
+       variable */
+    for (i = 0; i < xml_metadata.nbands && status == SUCCESS; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+
+        /* Determine the variable name */
+        for (k = 0; k < 3; k++)
+        {
+            if (k == 0)
+                count = snprintf (var_names[i], STR_SIZE, "%s", bmeta->name);
+            else if (k == 1)
+                count = snprintf (var_names[i], STR_SIZE, "%s_%s",
+                    bmeta->product, bmeta->name);
+            else
+                count = snprintf (var_names[i], STR_SIZE, "%s_%s_%d",
+                    bmeta->product, bmeta->name, i + 1);
+            if (count < 0 || count >= STR_SIZE)
+                break;
+            for (cptr = var_names[i]; *cptr != '\0'; cptr++)
+            {
+                if (!isalnum ((unsigned char) *cptr) && *cptr != '-' &&
+                    *cptr != '_')
+                    *cptr = '_';
+            }
+            if (!is_netcdf_name_used (var_names[i], i, var_names))
+                break;
+        }
+        if (k < 3 && (count < 0 || count >= STR_SIZE))
+            k = 3;
+        if (k == 3)
+        {
+            sprintf (errmsg, "Determining the variable name of band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Determine the dimensions of the band, writing the coordinates of
+           a new band size */
+        for (g = 0; g < ngrids; g++)
+        {
+            if (grid[g]->nlines == bmeta->nlines &&
+                grid[g]->nsamps == bmeta->nsamps)
+                break;
+        }
+        if (g == NETCDF_MAX_GRIDS)
+        {
+            sprintf (errmsg, "More than %d band sizes in the product",
+                NETCDF_MAX_GRIDS);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        if (g == ngrids)
+        {
+            grid[g] = bmeta;
+            if (g == 0)
+                strcpy (dim_name, "y");
+            else
+                sprintf (dim_name, "y%d", g);
+            ydims[g] = write_netcdf_coord (file, dim_name, true,
+                &xml_metadata.global.proj_info, bmeta);
+            dim_name[0] = 'x';
+            xdims[g] = (ydims[g] < 0) ? -1 : write_netcdf_coord (file,
+                dim_name, false, &xml_metadata.global.proj_info, bmeta);
+            if (ydims[g] < 0 || xdims[g] < 0)
+            {  /* Error messages already written */
+                if (ydims[g] >= 0)
+                    H5Dclose (ydims[g]);
+                status = ERROR;
+                break;
+            }
+            ngrids++;
+        }
+
+        /* Create the variable and write its chunks */
+        printf ("Converting %s to %s\n", bmeta->file_name, var_names[i]);
+        nchunk_lines = (chunk_lines < bmeta->nlines) ? chunk_lines :
+            bmeta->nlines;
+        nchunk_samps = (chunk_samps < bmeta->nsamps) ? chunk_samps :
+            bmeta->nsamps;
+        dset = create_netcdf_band (file, var_names[i], bmeta, nchunk_lines,
+            nchunk_samps, level, ydims[g], xdims[g]);
+        if (dset < 0 || write_netcdf_band (dset, bmeta, nchunk_lines,
+            nchunk_samps, level) != SUCCESS)
+        {
+            sprintf (errmsg, "Converting %s to NetCDF", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (dset >= 0)
+            H5Dclose (dset);
+    }
+
+    /* Close the coordinate variables and the file */
+    for (g = 0; g < ngrids; g++)
+    {
+        H5Dclose (ydims[g]);
+        H5Dclose (xdims[g]);
+    }
+    if (H5Fclose (file) < 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing the NetCDF file: %s", netcdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Free the metadata structure */
+    free (var_names);
+    free_metadata (&xml_metadata);
+
+    return (status);
+}
@@ -0,0 +1,71 @@
+/*****************************************************************************
+FILE: convert_espa_to_netcdf.h
+
+PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
+and imagery, and convert from raw binary to a NetCDF-4 (HDF5) file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The file is written with the HDF5 library (1.10.3 or later, for the
+     direct chunk writes), following the NetCDF-4 conventions for the
+     dimensions so it opens as NetCDF-4 as well as HDF5.  The attributes
+     follow the CF conventions.
+*****************************************************************************/
+
+#ifndef CONVERT_ESPA_TO_NETCDF_H
+#define CONVERT_ESPA_TO_NETCDF_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "hdf5.h"
+#include "hdf5_hl.h"
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+
+/* Defines */
+/* Default number of lines and samples in a chunk */
+#define NETCDF_CHUNK_SIZE 512
+
+/* Largest number of lines or samples in a chunk */
+#define NETCDF_MAX_CHUNK_SIZE 8192
+
+/* Default deflate level of the chunks */
+#define NETCDF_DEFLATE_LEVEL 1
+
+/* Largest number of distinct band sizes in a product, each of which has its
+   own pair of dimensions */
+#define NETCDF_MAX_GRIDS 8
+
+/* Name of the grid mapping variable */
+#define NETCDF_CRS_NAME "crs"
+
+/* Prototypes */
+int write_netcdf_band
+(
+    hid_t dset,            /* I: chunked HDF5 dataset of the band */
+    Espa_band_meta_t *bmeta,  /* I: band metadata; provides the raw binary
+                                 file, size, data type and fill value */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: deflate level of the chunks */
+);
+
+int convert_espa_to_netcdf
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *netcdf_file,     /* I: output NetCDF-4 filename */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: deflate level of the chunks, from 0
+                                 (stored) to 9 */
+);
+
+#endif
@@ -2,7 +2,8 @@
 FILE: convert_espa_to_raw_binary_bip.c
   
 PURPOSE: Contains functions for creating the raw binary band interleave by
-pixel (BIP) product and adding bands for this product to the output XML file.
+pixel (BIP) or by line (BIL) product and adding bands for this product to the
+output XML file.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -15,35 +16,452 @@ NOTES:
      the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
 *****************************************************************************/
+#include <errno.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "convert_espa_to_raw_binary_bip.h"
+#include "raw_binary_pool.h"
+#include "raw_binary_convert.h"
+#include "espa_task.h"
+#include "espa_profile.h"
 
 /******************************************************************************
-MODULE:  convert_espa_to_raw_binary_bip
+MODULE:  interleave_bip_uint8
+
+PURPOSE: Interleaves a block of 8-bit pixels from each band into the BIP
+output buffer.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. With SSE2 the bands are transposed 8 bands by 16 pixels at a time using
+     byte, word, and dword unpacks.  Band counts which are not a multiple of
+     8 are handled by padding the last group of bands with repeats of its
+     first band and writing each pixel with an 8-byte store.  The pixels are
+     written in increasing address order, so the padding bytes written for
+     one pixel are overwritten by the following store.  The output buffer
+     must therefore have space for BIP_PAD_ELEMENTS beyond the block.
+******************************************************************************/
+static void interleave_bip_uint8
+(
+    uint8 *in_buf[],        /* I: array of nbands input buffers */
+    int nbands,             /* I: number of bands */
+    int npix,               /* I: number of pixels in each input buffer */
+    uint8 *out_buf          /* O: interleaved output buffer */
+)
+{
+    int i;                  /* looping variable for bands */
+    int p = 0;              /* looping variable for pixels */
+#ifdef __SSE2__
+    int g;                  /* looping variable for groups of 8 bands */
+    int k;                  /* looping variable for the pixels in a vector */
+    int ngroups = (nbands + 7) / 8;  /* number of groups of 8 bands */
+    uint8 *grp_buf[8];      /* input buffers for the current group */
+    __m128i a[8];           /* 16 pixels for each band in the group */
+    __m128i t[8], u[8];     /* partially transposed data */
+    __m128i w[BIP_MAX_GROUPS][8]; /* transposed data for each group, 2 pixels
+                               by 8 bands per vector */
+
+    if (nbands > 1 && ngroups <= BIP_MAX_GROUPS)
+    {
+        for (p = 0; p + 16 <= npix; p += 16)
+        {
+            for (g = 0; g < ngroups; g++)
+            {
+                for (i = 0; i < 8; i++)
+                {
+                    if (g*8 + i < nbands)
+                        grp_buf[i] = in_buf[g*8 + i];
+                    else
+                        grp_buf[i] = in_buf[g*8];
+                    a[i] = _mm_loadu_si128 ((__m128i *) &grp_buf[i][p]);
+                }
+
+                for (i = 0; i < 4; i++)
+                {
+                    t[2*i] = _mm_unpacklo_epi8 (a[2*i], a[2*i+1]);
+                    t[2*i+1] = _mm_unpackhi_epi8 (a[2*i], a[2*i+1]);
+                }
+                for (i = 0; i < 2; i++)
+                {
+                    u[4*i] = _mm_unpacklo_epi16 (t[4*i], t[4*i+2]);
+                    u[4*i+1] = _mm_unpackhi_epi16 (t[4*i], t[4*i+2]);
+                    u[4*i+2] = _mm_unpacklo_epi16 (t[4*i+1], t[4*i+3]);
+                    u[4*i+3] = _mm_unpackhi_epi16 (t[4*i+1], t[4*i+3]);
+                }
+                for (i = 0; i < 4; i++)
+                {
+                    w[g][2*i] = _mm_unpacklo_epi32 (u[i], u[i+4]);
+                    w[g][2*i+1] = _mm_unpackhi_epi32 (u[i], u[i+4]);
+                }
+            }
+
+            if (nbands == 8)
+            {
+                for (i = 0; i < 8; i++)
+                    _mm_storeu_si128 ((__m128i *) &out_buf[(p + 2*i) * 8],
+                        w[0][i]);
+                continue;
+            }
+
+            for (k = 0; k < 16; k++)
+                for (g = 0; g < ngroups; g++)
+                {
+                    if (k % 2 == 0)
+                        _mm_storel_epi64 ((__m128i *)
+                            &out_buf[(p + k) * nbands + g*8], w[g][k/2]);
+                    else
+                        _mm_storel_epi64 ((__m128i *)
+                            &out_buf[(p + k) * nbands + g*8],
+                            _mm_unpackhi_epi64 (w[g][k/2], w[g][k/2]));
+                }
+        }
+    }
+#endif
+
+    /* Remaining pixels */
+    for (; p < npix; p++)
+        for (i = 0; i < nbands; i++)
+            out_buf[p * nbands + i] = in_buf[i][p];
+}
+
+
+/******************************************************************************
+MODULE:  interleave_bip_uint16
+
+PURPOSE: Interleaves a block of 16-bit pixels from each band into the BIP
+output buffer.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Used for both int16 and uint16 data, since the pixels are only copied.
+  2. With SSE2 the bands are transposed 8 bands by 8 pixels at a time using
+     word, dword, and qword unpacks.  Band counts which are not a multiple of
+     8 are handled as described in interleave_bip_uint8.
+******************************************************************************/
+static void interleave_bip_uint16
+(
+    uint16 *in_buf[],       /* I: array of nbands input buffers */
+    int nbands,             /* I: number of bands */
+    int npix,               /* I: number of pixels in each input buffer */
+    uint16 *out_buf         /* O: interleaved output buffer */
+)
+{
+    int i;                  /* looping variable for bands */
+    int p = 0;              /* looping variable for pixels */
+#ifdef __SSE2__
+    int g;                  /* looping variable for groups of 8 bands */
+    int k;                  /* looping variable for the pixels in a vector */
+    int ngroups = (nbands + 7) / 8;  /* number of groups of 8 bands */
+    uint16 *grp_buf[8];     /* input buffers for the current group */
+    __m128i a[8];           /* 8 pixels for each band in the group */
+    __m128i t[8], u[8];     /* partially transposed data */
+    __m128i w[BIP_MAX_GROUPS][8]; /* transposed data for each group, 1 pixel
+                               by 8 bands per vector */
+
+    if (nbands > 1 && ngroups <= BIP_MAX_GROUPS)
+    {
+        for (p = 0; p + 8 <= npix; p += 8)
+        {
+            for (g = 0; g < ngroups; g++)
+            {
+                for (i = 0; i < 8; i++)
+                {
+                    if (g*8 + i < nbands)
+                        grp_buf[i] = in_buf[g*8 + i];
+                    else
+                        grp_buf[i] = in_buf[g*8];
+                    a[i] = _mm_loadu_si128 ((__m128i *) &grp_buf[i][p]);
+                }
+
+                for (i = 0; i < 4; i++)
+                {
+                    t[2*i] = _mm_unpacklo_epi16 (a[2*i], a[2*i+1]);
+                    t[2*i+1] = _mm_unpackhi_epi16 (a[2*i], a[2*i+1]);
+                }
+                for (i = 0; i < 2; i++)
+                {
+                    u[4*i] = _mm_unpacklo_epi32 (t[4*i], t[4*i+2]);
+                    u[4*i+1] = _mm_unpackhi_epi32 (t[4*i], t[4*i+2]);
+                    u[4*i+2] = _mm_unpacklo_epi32 (t[4*i+1], t[4*i+3]);
+                    u[4*i+3] = _mm_unpackhi_epi32 (t[4*i+1], t[4*i+3]);
+                }
+                for (i = 0; i < 4; i++)
+                {
+                    w[g][2*i] = _mm_unpacklo_epi64 (u[i], u[i+4]);
+                    w[g][2*i+1] = _mm_unpackhi_epi64 (u[i], u[i+4]);
+                }
+            }
+
+            for (k = 0; k < 8; k++)
+                for (g = 0; g < ngroups; g++)
+                    _mm_storeu_si128 ((__m128i *)
+                        &out_buf[(p + k) * nbands + g*8], w[g][k]);
+        }
+    }
+#endif
+
+    /* Remaining pixels */
+    for (; p < npix; p++)
+        for (i = 0; i < nbands; i++)
+            out_buf[p * nbands + i] = in_buf[i][p];
+}
+
+
+/******************************************************************************
+MODULE:  read_bip_block
+
+PURPOSE: Reads a block of lines from each band, converting the QA bands to
+the output data type if needed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the block
+SUCCESS         Successfully read the block
+
+NOTES:
+  1. The lines for band i are stored contiguously starting at
+     in_buf + i * block_size bytes.
+******************************************************************************/
+static int read_bip_block
+(
+    FILE **fp_rb,             /* I: file pointers for the input bands */
+    Espa_internal_meta_t *xml_metadata, /* I: input XML metadata */
+    bool convert_qa,          /* I: should uint8 QA bands be converted? */
+    int nbytes,               /* I: number of bytes per output pixel */
+    int line,                 /* I: first line in the block */
+    int nblock_lines,         /* I: number of lines in the block */
+    size_t block_size,        /* I: number of bytes per band in in_buf */
+    uint8 *tmp_buf_u8,        /* I: buffer for a block of uint8 QA data */
+    uint8 *in_buf             /* O: input buffer for all the bands */
+)
+{
+    char FUNC_NAME[] = "read_bip_block";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for each band */
+    int npix;                   /* number of pixels in the block */
+    Espa_band_meta_t *bmeta = xml_metadata->band;  /* band metadata */
+
+    npix = nblock_lines * bmeta[0].nsamps;
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        /* Check to make sure the current band data type is the same as the
+           output data type, otherwise this is a QA band that will get
+           converted to the output data type */
+        if ((bmeta[0].data_type != bmeta[i].data_type) &&
+            (bmeta[i].data_type == ESPA_UINT8) && convert_qa)
+        {
+            /* Read the current lines from the raw binary file into the
+               temporary UINT8 buffer */
+            if (read_raw_binary (fp_rb[i], nblock_lines, bmeta[0].nsamps,
+                sizeof (uint8), tmp_buf_u8) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading QA data from the raw binary "
+                    "file for lines %d-%d and band %d", line,
+                    line + nblock_lines - 1, i);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Convert the data and write it to the input buffer */
+            if (convert_raw_binary_pixels (tmp_buf_u8, ESPA_UINT8, npix,
+                bmeta[0].data_type, in_buf + i * block_size) != SUCCESS)
+            {
+                sprintf (errmsg, "Converting QA data for lines %d-%d and "
+                    "band %d", line, line + nblock_lines - 1, i);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else
+        {
+            /* Read the current lines from the raw binary file */
+            if (read_raw_binary (fp_rb[i], nblock_lines, bmeta[0].nsamps,
+                nbytes, in_buf + i * block_size) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading image data from the raw binary "
+                    "file for lines %d-%d and band %d", line,
+                    line + nblock_lines - 1, i);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }  /* end for i */
+
+    return (SUCCESS);
+}
+
+/* Block read by read_bip_block_task */
+typedef struct
+{
+    FILE **fp_rb;             /* file pointers for the input bands */
+    Espa_internal_meta_t *xml_metadata; /* input XML metadata */
+    bool convert_qa;          /* should uint8 QA bands be converted? */
+    int nbytes;               /* number of bytes per output pixel */
+    int line;                 /* first line in the block */
+    int nblock_lines;         /* number of lines in the block */
+    size_t block_size;        /* number of bytes per band in in_buf */
+    uint8 *tmp_buf_u8;        /* buffer for a block of uint8 QA data */
+    uint8 *in_buf;            /* input buffer for all the bands */
+} Bip_block_read_t;
+
+/******************************************************************************
+MODULE:  read_bip_block_task
+
+PURPOSE: Reads a block of lines from each band, as a task of the task
+runtime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the block
+SUCCESS         Successfully read the block
+
+NOTES:
+  1. See read_bip_block.
+******************************************************************************/
+static int read_bip_block_task
+(
+    void *arg                 /* I: block to be read (Bip_block_read_t) */
+)
+{
+    Bip_block_read_t *block = arg;  /* block to be read */
+
+    return (read_bip_block (block->fp_rb, block->xml_metadata,
+        block->convert_qa, block->nbytes, block->line, block->nblock_lines,
+        block->block_size, block->tmp_buf_u8, block->in_buf));
+}
+
+/******************************************************************************
+MODULE:  write_bil_block
+
+PURPOSE: Writes a block of lines from each band to the BIL file, with
+vectored writes of the band lines.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the block
+SUCCESS         Successfully wrote the block
+
+NOTES:
+  1. Each output line is the line of each band in turn, so the lines are
+     written straight from the input buffer, up to BIL_MAX_IOV band lines per
+     pwritev, with no copying.
+  2. The lines for band i are stored contiguously starting at
+     in_buf + i * block_size bytes, as read by read_bip_block.
+******************************************************************************/
+static int write_bil_block
+(
+    int fd,                   /* I: file descriptor of the BIL file */
+    off_t offset,             /* I: byte offset of the block in the file */
+    uint8 *in_buf,            /* I: input buffer for all the bands */
+    int nbands,               /* I: number of bands */
+    int nblock_lines,         /* I: number of lines in the block */
+    size_t line_size,         /* I: number of bytes in a band line */
+    size_t block_size,        /* I: number of bytes per band in in_buf */
+    struct iovec *iov         /* I: space for nblock_lines * nbands band
+                                    lines */
+)
+{
+    char FUNC_NAME[] = "write_bil_block";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for each band */
+    int l;                      /* looping variable for each line */
+    int niov;                   /* number of band lines left to write */
+    ssize_t nwritten;           /* number of bytes written by pwritev */
+
+    niov = 0;
+    for (l = 0; l < nblock_lines; l++)
+        for (i = 0; i < nbands; i++, niov++)
+        {
+            iov[niov].iov_base = in_buf + i * block_size + l * line_size;
+            iov[niov].iov_len = line_size;
+        }
+
+    while (niov > 0)
+    {
+        nwritten = pwritev (fd, iov, (niov < BIL_MAX_IOV) ? niov :
+            BIL_MAX_IOV, offset);
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+        {
+            sprintf (errmsg, "Writing %d band lines at byte offset %lld",
+                niov, (long long) offset);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        offset += nwritten;
+
+        /* Skip the band lines written, and the part written of the next
+           one after a short write */
+        while (niov > 0 && (size_t) nwritten >= iov->iov_len)
+        {
+            nwritten -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if (nwritten > 0)
+        {
+            iov->iov_base = (uint8 *) iov->iov_base + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+/******************************************************************************
+MODULE:  convert_espa_to_raw_binary_interleave
 
 PURPOSE: Converts the internal ESPA raw binary file to a raw binary band
-interleave by pixel format.
+interleave by pixel or band interleave by line format.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting to BIP
-SUCCESS         Successfully converted to BIP
+ERROR           Error converting to BIP or BIL
+SUCCESS         Successfully converted to BIP or BIL
 
 NOTES:
-  1. The bands in the XML file will be written, in order, to the BIP file.
+  1. The bands in the XML file will be written, in order, to the output file.
      These bands must be of the same datatype and same size, otherwise this
      function will exit with an error.
   2. If the data types are not the same, the convert_qa flag will allow the
      user to specify that the QA bands (uint8) should be included in the output
-     BIP product however the QA bands will be converted to the same data type
+     product however the QA bands will be converted to the same data type
      as the first band in the XML file.
+  3. The bands are read BIP_LINE_BLOCK lines at a time.  When threading is
+     enabled, the next block is read by a task of the task runtime (see
+     espa_task.h) while the current block is interleaved and written.
+  4. BIP blocks are interleaved pixel by pixel into an output buffer.  BIL
+     blocks need no interleaving, since each output line is just the band
+     lines in turn, so they are written from the input buffer by
+     write_bil_block.
+  5. The output XML file is the output filename with its extension replaced
+     by _bip.xml or _bil.xml.
+  6. If del_src is specified and reclamation of the source bands is
+     requested (see raw_binary_reclaim.h), the lines of the bands are
+     reclaimed once each block is written, rather than all the bands only
+     being removed at the end.
 ******************************************************************************/
-int convert_espa_to_raw_binary_bip
+int convert_espa_to_raw_binary_interleave
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
-    char *bip_file,        /* I: output BIP filename */
+    char *bip_file,        /* I: output BIP or BIL filename */
+    Espa_interleave_t interleave,  /* I: interleaving of the output file */
     bool convert_qa,       /* I: should the QA bands (uint8) be converted to
                                  the data type of band 1 (if QA bands are of
                                  a different data type)? */
@@ -51,34 +469,42 @@ int convert_espa_to_raw_binary_bip
                                  conversion? */
 )
 {
-    char FUNC_NAME[] = "convert_espa_to_raw_binary_bip";  /* function name */
+    /* function name */
+    char FUNC_NAME[] = "convert_espa_to_raw_binary_interleave";
     char errmsg[STR_SIZE];      /* error message */
+    const char *interleave_name;  /* name of the interleave (BIP or BIL) */
     char hdr_file[STR_SIZE];    /* name of the header file for this band */
     char xml_file[STR_SIZE];    /* new XML file for the BIP product */
     char envi_file[STR_SIZE];   /* name of the output ENVI header file */
     char *cptr = NULL;          /* pointer to empty space in the band name */
     int i;                      /* looping variable for each band */
     int l;                      /* looping variable for each line */
-    int s;                      /* looping variable for each sample */
+    int b;                      /* index of the current input buffer */
     int nbytes;                 /* number of bytes per pixel in the data type */
-    int nbytes_line;            /* number of bytes per line in the data type */
     int count;                  /* number of chars copied in snprintf */
-    int curr_pix;               /* index for current pixel for QA conversion */
-    int curr_ipix;              /* index for current input pixel */
-    int curr_opix;              /* index for current output pixel */
-    int number_elements;        /* number of elements per line for all bands */
-    void *file_buf = NULL;      /* pointer to correct input file buffer */
+    int nblock_lines;           /* number of lines in the current block */
+    int next_block_lines;       /* number of lines in the next block */
+    int number_elements;        /* number of elements per block for all
+                                   bands */
+    int read_status;            /* status of reading the next block */
+    int write_status;           /* status of writing the current block */
+    bool is_bil;                /* is the output interleaved by line? */
+    bool reclaim_src;           /* are the source bands reclaimed as they're
+                                   converted? */
+    struct iovec *iov = NULL;   /* band lines of a BIL block */
+    Bip_block_read_t next_block; /* next block being read */
+    Espa_task_group_t read_group; /* read of the next block */
+    size_t block_size;          /* number of bytes per band in a block */
+    uint8 *in_buf[2] = {NULL, NULL}; /* input buffers for a block of lines
+                                   for all the bands */
     uint8 *tmp_buf_u8 = NULL;   /* buffer for uint8 QA data to be read */
-    uint8 *file_buf_u8 = NULL;  /* buffer for uint8 data to be read */
-    int16 *file_buf_i16 = NULL; /* buffer for int16 data to be read */
-    int16 *file_buf_u16 = NULL; /* buffer for uint16 data to be read */
-    void *ofile_buf = NULL;     /* pointer to correct output file buffer */
-    uint8 *ofile_buf_u8 = NULL; /* buffer for output uint8 data to be written */
-    int16 *ofile_buf_i16 = NULL;/* buffer for output int16 data to be written */
-    int16 *ofile_buf_u16 = NULL;/* buffer for output uint16 data to be
-                                   written */
+    void *out_buf = NULL;       /* buffer for output BIP data to be written */
+    void **band_buf = NULL;     /* pointers to each band in the current input
+                                   buffer */
     FILE **fp_rb = NULL;        /* array of file pointers for the input raw
                                    binary files */
+    Raw_binary_reclaim_t *rcl = NULL;  /* reclamation of the input raw
+                                   binary files */
     FILE *fp_bip = NULL;        /* file pointer for the BIP raw binary file */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                    populated by reading the input XML metadata
@@ -87,6 +513,7 @@ int convert_espa_to_raw_binary_bip
     Espa_global_meta_t *gmeta=NULL; /* pointer to the global metadata
                                    structure */
     Envi_header_t envi_hdr;     /* output ENVI header information */
+    ESPA_PROFILE_SCOPE ("convert_espa_to_raw_binary_interleave");
 
     /* Validate the input metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
@@ -106,12 +533,15 @@ int convert_espa_to_raw_binary_bip
     }
     bmeta = xml_metadata.band;
     gmeta = &xml_metadata.global;
-    printf ("convert_espa_to_raw_binary_bip processing %d bands ...\n",
-        xml_metadata.nbands);
+    is_bil = (interleave == ESPA_INTERLEAVE_BIL);
+    interleave_name = is_bil ? "BIL" : "BIP";
+    printf ("convert_espa_to_raw_binary_interleave processing %d bands to "
+        "%s ...\n", xml_metadata.nbands, interleave_name);
 
-    /* Allocate file pointers for each band */
+    /* Allocate file pointers and the reclamation for each band */
     fp_rb = calloc (xml_metadata.nbands, sizeof (FILE *));
-    if (fp_rb == NULL)
+    rcl = calloc (xml_metadata.nbands, sizeof (Raw_binary_reclaim_t));
+    if (fp_rb == NULL || rcl == NULL)
     {
         sprintf (errmsg, "Allocating file pointers for all %d bands.",
             xml_metadata.nbands);
@@ -137,9 +567,9 @@ int convert_espa_to_raw_binary_bip
             {
                 sprintf (errmsg, "Data type for band %d (%s) in the XML file "
                     "does not match that of the first band.  All bands must "
-                    "have the same data type to be written to BIP raw binary. "
+                    "have the same data type to be written to %s raw binary. "
                     "Otherwise convert_qa can be specified to convert the QA "
-                    "bands (UINT8).", i+1, bmeta[i].name);
+                    "bands (UINT8).", i+1, bmeta[i].name, interleave_name);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
@@ -148,8 +578,8 @@ int convert_espa_to_raw_binary_bip
         {
             sprintf (errmsg, "Number of lines for band %d (%s) in the XML file "
                 "does not match that of the first band.  All bands must be of "
-                "the same image size to be written to BIP raw binary.", i+1,
-                bmeta[i].name);
+                "the same image size to be written to %s raw binary.", i+1,
+                bmeta[i].name, interleave_name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
@@ -157,13 +587,19 @@ int convert_espa_to_raw_binary_bip
         {
             sprintf (errmsg, "Number of samples for band %d (%s) in the XML "
                 "file does not match that of the first band.  All bands must "
-                "be of the same image size to be written to BIP raw binary.",
-                i+1, bmeta[i].name);
+                "be of the same image size to be written to %s raw binary.",
+                i+1, bmeta[i].name, interleave_name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
     }
 
+    /* Reclaim the source bands as they're converted if requested, since
+       they're removed anyway */
+    reclaim_src = del_src && can_reclaim_raw_binary_sources (&xml_metadata);
+    for (i = 0; i < xml_metadata.nbands; i++)
+        open_raw_binary_reclaim (&bmeta[i], reclaim_src, &rcl[i]);
+
     /* Loop through the bands in the XML file and open each band file for
        reading */
     for (i = 0; i < xml_metadata.nbands; i++)
@@ -179,18 +615,18 @@ int convert_espa_to_raw_binary_bip
         }
     }
 
-    /* Open the output BIP file to allow for writing */
+    /* Open the output file to allow for writing */
     fp_bip = open_raw_binary (bip_file, "wb");
     if (fp_bip == NULL)
     {
-        sprintf (errmsg, "Opening the output raw binary BIP file: %s",
-            bip_file);
+        sprintf (errmsg, "Opening the output raw binary %s file: %s",
+            interleave_name, bip_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Allocate memory for a single line of the image and all the bands, based
-       on the input data type of the first band */
+    /* Determine the number of bytes per pixel, based on the input data type
+       of the first band */
     switch (bmeta[0].data_type)
     {
         case ESPA_UINT8:
@@ -209,172 +645,187 @@ int convert_espa_to_raw_binary_bip
             return (ERROR);
     }
 
-    /* Input data */
-    file_buf = calloc (bmeta[0].nsamps * xml_metadata.nbands, nbytes);
-    if (file_buf == NULL)
+    /* Allocate two input buffers, each holding a block of lines for all the
+       bands, so the next block can be read while the current block is
+       interleaved and written */
+    block_size = (size_t) BIP_LINE_BLOCK * bmeta[0].nsamps * nbytes;
+    for (b = 0; b < 2; b++)
     {
-        sprintf (errmsg, "Allocating memory for a line of %d-byte data "
-            "containing %d samples for all %d bands.", nbytes, bmeta[0].nsamps,
-            xml_metadata.nbands);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        in_buf[b] = get_raw_binary_buffer (xml_metadata.nbands *
+            block_size, true);
+        if (in_buf[b] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for %d lines of %d-byte data "
+                "containing %d samples for all %d bands.", BIP_LINE_BLOCK,
+                nbytes, bmeta[0].nsamps, xml_metadata.nbands);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
     }
 
-    /* Output data */
-    ofile_buf = calloc (bmeta[0].nsamps * xml_metadata.nbands, nbytes);
-    if (ofile_buf == NULL)
+    /* Output data, with padding for the vector stores in the interleaver,
+       or the band lines of a block for BIL */
+    if (is_bil)
+        iov = calloc ((size_t) BIP_LINE_BLOCK * xml_metadata.nbands,
+            sizeof (struct iovec));
+    else
+        out_buf = get_raw_binary_buffer (((size_t) BIP_LINE_BLOCK *
+            bmeta[0].nsamps * xml_metadata.nbands + BIP_PAD_ELEMENTS) *
+            nbytes, true);
+    if (out_buf == NULL && iov == NULL)
     {
-        sprintf (errmsg, "Allocating memory for a line of %d-byte data "
-            "containing %d samples for all %d bands.", nbytes, bmeta[0].nsamps,
-            xml_metadata.nbands);
+        sprintf (errmsg, "Allocating memory for %d lines of %d-byte data "
+            "containing %d samples for all %d bands.", BIP_LINE_BLOCK, nbytes,
+            bmeta[0].nsamps, xml_metadata.nbands);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Assign the datatype-specific pointer to the void pointer to be used
-       in the data conversion later for QA pixels */
-    switch (bmeta[0].data_type)
-    {
-        case ESPA_UINT8:
-            file_buf_u8 = file_buf;
-            ofile_buf_u8 = ofile_buf;
-            break;
-        case ESPA_INT16:
-            file_buf_i16 = file_buf;
-            ofile_buf_i16 = ofile_buf;
-            break;
-        case ESPA_UINT16:
-            file_buf_u16 = file_buf;
-            ofile_buf_u16 = ofile_buf;
-            break;
-        default:
-            sprintf (errmsg, "Unsupported data type.  Currently only uint8, "
-                "int16, and uint16 are supported.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-    }
-
     /* The QA bands will be converted so allocate space for a temporary UINT8
        input array */
     if (convert_qa)
     {
-        tmp_buf_u8 = calloc (bmeta[0].nsamps, sizeof (uint8));
+        tmp_buf_u8 = get_raw_binary_buffer ((size_t) BIP_LINE_BLOCK *
+            bmeta[0].nsamps * sizeof (uint8), true);
         if (tmp_buf_u8 == NULL)
         {
-            sprintf (errmsg, "Allocating memory for a line of QA data "
-                "containing %d samples.", bmeta[0].nsamps);
+            sprintf (errmsg, "Allocating memory for %d lines of QA data "
+                "containing %d samples.", BIP_LINE_BLOCK, bmeta[0].nsamps);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
     }
 
-    /* Loop through the lines in the input raw binary file.  Read each line
-       for each band, put into the output BIP buffer, and write to the output
-       file. */
-    nbytes_line = nbytes * bmeta[0].nsamps;
-    for (l = 0; l < bmeta[0].nlines; l++)
+    /* Set up the pointers to each band within the input buffers */
+    band_buf = calloc (xml_metadata.nbands, sizeof (void *));
+    if (band_buf == NULL)
     {
-        if (l % 100 == 0)
-            printf ("Line %d\n", l);
+        sprintf (errmsg, "Allocating band pointers for all %d bands.",
+            xml_metadata.nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        for (i = 0; i < xml_metadata.nbands; i++)
-        {
-            /* Check to make sure the current band data type is the same as 
-               the output data type, otherwise this is a QA band that will
-               get converted to the output data type */
-            if ((bmeta[0].data_type != bmeta[i].data_type) &&
-                (bmeta[i].data_type == ESPA_UINT8) && convert_qa)
-            {
-                /* Read the current line from the raw binary file into the
-                   temporary UINT8 buffer */
-                if (read_raw_binary (fp_rb[i], 1, bmeta[0].nsamps,
-                    sizeof (uint8), tmp_buf_u8) != SUCCESS)
-                {
-                    sprintf (errmsg, "Reading QA data from the raw binary "
-                        "file for line %d and band %d", l, i);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+    /* Loop through the lines in the input raw binary file, a block of lines
+       at a time.  Read the block for each band, interleave it into the output
+       BIP buffer (or gather its band lines for BIL), and write it to the
+       output file.  When threading is enabled the next block is read while
+       the current block is interleaved and written. */
+    nblock_lines = BIP_LINE_BLOCK;
+    if (nblock_lines > bmeta[0].nlines)
+        nblock_lines = bmeta[0].nlines;
+    if (read_bip_block (fp_rb, &xml_metadata, convert_qa, nbytes, 0,
+        nblock_lines, block_size, tmp_buf_u8, in_buf[0]) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
 
-                /* Convert the data and write it to the output buffer */
-                if (bmeta[0].data_type == ESPA_INT16)
-                {
-                    curr_pix = i * bmeta[0].nsamps;
-                    for (s = 0; s < bmeta[0].nsamps; s++, curr_pix++)
-                        file_buf_i16[curr_pix] = (int16) tmp_buf_u8[s];
-                }
-                else if (bmeta[0].data_type == ESPA_UINT16)
-                {
-                    curr_pix = i * bmeta[0].nsamps;
-                    for (s = 0; s < bmeta[0].nsamps; s++, curr_pix++)
-                        file_buf_u16[curr_pix] = (uint16) tmp_buf_u8[s];
-                }
-            }
-            else
-            {
-                /* Read the current line from the raw binary file */
-                if (read_raw_binary (fp_rb[i], 1, bmeta[0].nsamps, nbytes,
-                    file_buf + (i*nbytes_line)) != SUCCESS)
-                {
-                    sprintf (errmsg, "Reading image data from the raw binary "
-                        "file for line %d and band %d", l, i);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-        }  /* end for i */
+    for (l = 0, b = 0; l < bmeta[0].nlines; l += nblock_lines, b = !b)
+    {
+        printf ("Line %d\n", l);
+
+        /* Determine the size of the current and next blocks */
+        nblock_lines = BIP_LINE_BLOCK;
+        if (l + nblock_lines > bmeta[0].nlines)
+            nblock_lines = bmeta[0].nlines - l;
+        next_block_lines = BIP_LINE_BLOCK;
+        if (l + nblock_lines + next_block_lines > bmeta[0].nlines)
+            next_block_lines = bmeta[0].nlines - l - nblock_lines;
+
+        /* Read the next block */
+        espa_task_group_init (&read_group);
+        if (next_block_lines > 0)
+        {
+            next_block.fp_rb = fp_rb;
+            next_block.xml_metadata = &xml_metadata;
+            next_block.convert_qa = convert_qa;
+            next_block.nbytes = nbytes;
+            next_block.line = l + nblock_lines;
+            next_block.nblock_lines = next_block_lines;
+            next_block.block_size = block_size;
+            next_block.tmp_buf_u8 = tmp_buf_u8;
+            next_block.in_buf = in_buf[!b];
+            espa_task_submit (&read_group, read_bip_block_task, &next_block);
+        }
 
-        /* Loop through the samples and put each band for each pixel into the
-           output buffer */
-        for (s = 0; s < bmeta[0].nsamps; s++)
+        /* Write the band lines of the current block to the BIL file */
+        write_status = SUCCESS;
+        if (is_bil)
         {
-            curr_opix = s * xml_metadata.nbands;
-            for (i = 0; i < xml_metadata.nbands; i++, curr_opix++)
+            if (write_bil_block (fileno (fp_bip), (off_t) l *
+                bmeta[0].nsamps * xml_metadata.nbands * nbytes, in_buf[b],
+                xml_metadata.nbands, nblock_lines,
+                (size_t) bmeta[0].nsamps * nbytes, block_size, iov) !=
+                SUCCESS)
             {
-                curr_ipix = i * bmeta[0].nsamps + s;
-                if (bmeta[0].data_type == ESPA_UINT8)
-                {
-                    ofile_buf_u8[curr_opix] = file_buf_u8[curr_ipix];
-                }
-                else if (bmeta[0].data_type == ESPA_INT16)
-                {
-                    ofile_buf_i16[curr_opix] = file_buf_i16[curr_ipix];
-                }
-                else if (bmeta[0].data_type == ESPA_UINT16)
-                {
-                    ofile_buf_u16[curr_opix] = file_buf_u16[curr_ipix];
-                }
+                sprintf (errmsg, "Writing data to the BIL raw binary file "
+                    "for lines %d-%d", l, l + nblock_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                write_status = ERROR;
+            }
+            read_status = espa_task_group_wait (&read_group);
+            if (read_status != SUCCESS || write_status != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
             }
+            for (i = 0; i < xml_metadata.nbands; i++)
+                reclaim_raw_binary_lines (&rcl[i], l + nblock_lines);
+            continue;
         }
 
-        /* Write the current line of data containing all the bands to the
+        /* Interleave the bands for each pixel in the current block */
+        for (i = 0; i < xml_metadata.nbands; i++)
+            band_buf[i] = in_buf[b] + i * block_size;
+        if (nbytes == sizeof (uint8))
+            interleave_bip_uint8 ((uint8 **) band_buf, xml_metadata.nbands,
+                nblock_lines * bmeta[0].nsamps, out_buf);
+        else
+            interleave_bip_uint16 ((uint16 **) band_buf, xml_metadata.nbands,
+                nblock_lines * bmeta[0].nsamps, out_buf);
+
+        /* Write the current block of lines containing all the bands to the
            output file */
-        number_elements = bmeta[0].nsamps * xml_metadata.nbands;
-        if (fwrite (ofile_buf, nbytes, number_elements, fp_bip) !=
+        number_elements = nblock_lines * bmeta[0].nsamps *
+            xml_metadata.nbands;
+        if (fwrite (out_buf, nbytes, number_elements, fp_bip) !=
             number_elements)
         {
             sprintf (errmsg, "Writing data to the BIP raw binary file for "
-                "line %d", l);
+                "lines %d-%d", l, l + nblock_lines - 1);
             error_handler (true, FUNC_NAME, errmsg);
+            write_status = ERROR;
+        }
+        read_status = espa_task_group_wait (&read_group);
+
+        if (read_status != SUCCESS || write_status != SUCCESS)
+        {  /* Error messages already written */
             return (ERROR);
         }
+
+        /* Reclaim the lines of the block from the source bands */
+        for (i = 0; i < xml_metadata.nbands; i++)
+            reclaim_raw_binary_lines (&rcl[i], l + nblock_lines);
     }  /* end for l */
 
     /* Close the raw binary files */
     for (i = 0; i < xml_metadata.nbands; i++)
+    {
         close_raw_binary (fp_rb[i]);
+        close_raw_binary_reclaim (&rcl[i]);
+    }
     close_raw_binary (fp_bip);
+    free (fp_rb);
+    free (rcl);
 
     /* Free the memory */
-    free (tmp_buf_u8);
-    free (file_buf_u8);
-    free (file_buf_i16);
-    free (file_buf_u16);
-    free (ofile_buf_u8);
-    free (ofile_buf_i16);
-    free (ofile_buf_u16);
-
-    /* Create the ENVI header file for this BIP product */
+    release_raw_binary_buffer (tmp_buf_u8);
+    release_raw_binary_buffer (in_buf[0]);
+    release_raw_binary_buffer (in_buf[1]);
+    release_raw_binary_buffer (out_buf);
+    free (iov);
+    free (band_buf);
+
+    /* Create the ENVI header file for this product */
     if (create_envi_struct (&bmeta[0], gmeta, &envi_hdr) != SUCCESS)
     {
         sprintf (errmsg, "Creating the ENVI header structure for this file.");
@@ -383,11 +834,11 @@ int convert_espa_to_raw_binary_bip
     }
 
     /* Update the ENVI header (created by default for a single BSQ band) to
-       represent that this product is a multi-band, BIP file */
+       represent that this product is a multi-band, BIP or BIL file */
     envi_hdr.nbands = xml_metadata.nbands;
 
     count = snprintf (envi_hdr.interleave, sizeof (envi_hdr.interleave), "%s",
-        "BIP");
+        interleave_name);
     if (count < 0 || count >= sizeof (envi_hdr.interleave))
     {
         sprintf (errmsg, "Overflow of envi_hdr.interleave");
@@ -473,7 +924,7 @@ int convert_espa_to_raw_binary_bip
 
     /* Use the input XML file structure for the output XML file since it's the
        same except for the band filenames.  Loop through the bands in the XML
-       file and change the filenames to be the single output BIP filename. */
+       file and change the filenames to be the single output filename. */
     for (i = 0; i < xml_metadata.nbands; i++)
     {
         count = snprintf (bmeta[i].file_name, sizeof (bmeta[i].file_name), "%s",
@@ -486,7 +937,7 @@ int convert_espa_to_raw_binary_bip
         }
     }
 
-    /* Create the XML file for the BIP product */
+    /* Create the XML file for the product */
     count = snprintf (xml_file, sizeof (xml_file), "%s", bip_file);
     if (count < 0 || count >= sizeof (xml_file))
     {
@@ -495,13 +946,13 @@ int convert_espa_to_raw_binary_bip
         return (ERROR);
     }
     cptr = strrchr (xml_file, '.');
-    strcpy (cptr, "_bip.xml");
+    strcpy (cptr, is_bil ? "_bil.xml" : "_bip.xml");
 
     /* Write the new XML file */
     if (write_metadata (&xml_metadata, xml_file) != SUCCESS)
     {
-        sprintf (errmsg, "Error writing updated XML for the GeoTIFF product: "
-            "%s", xml_file);
+        sprintf (errmsg, "Error writing updated XML for the %s product: "
+            "%s", interleave_name, xml_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -513,3 +964,35 @@ int convert_espa_to_raw_binary_bip
     return (SUCCESS);
 }
 
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_raw_binary_bip
+
+PURPOSE: Converts the internal ESPA raw binary file to a raw binary band
+interleave by pixel format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to BIP
+SUCCESS         Successfully converted to BIP
+
+NOTES:
+  1. See convert_espa_to_raw_binary_interleave.
+******************************************************************************/
+int convert_espa_to_raw_binary_bip
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *bip_file,        /* I: output BIP filename */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+)
+{
+    return (convert_espa_to_raw_binary_interleave (espa_xml_file, bip_file,
+        ESPA_INTERLEAVE_BIP, convert_qa, del_src));
+}
@@ -2,7 +2,7 @@
 FILE: convert_espa_to_raw_binary_bip.h
   
 PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
-and imagery, and convert from raw binary to raw binary BIP file format.
+and imagery, and convert from raw binary to raw binary BIP or BIL file format.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -24,11 +24,45 @@ NOTES:
 #include "parse_metadata.h"
 #include "write_metadata.h"
 #include "raw_binary_io.h"
+#include "raw_binary_reclaim.h"
 #include "envi_header.h"
 
 /* Defines */
+/* Number of lines read and interleaved at a time */
+#define BIP_LINE_BLOCK 64
+
+/* Maximum number of groups of 8 bands interleaved with vector instructions;
+   products with more bands are interleaved with scalar code */
+#define BIP_MAX_GROUPS 4
+
+/* Number of elements of padding at the end of the output buffer, which may
+   be written past the last pixel by the vector interleaver */
+#define BIP_PAD_ELEMENTS 8
+
+/* Maximum number of band lines written by each vectored write of a BIL
+   block, which is the Linux limit (IOV_MAX) on the number of buffers */
+#define BIL_MAX_IOV 1024
+
+/* Interleaving of the bands in the output raw binary file */
+typedef enum
+{
+    ESPA_INTERLEAVE_BIP,   /* band interleave by pixel */
+    ESPA_INTERLEAVE_BIL    /* band interleave by line */
+} Espa_interleave_t;
 
 /* Prototypes */
+int convert_espa_to_raw_binary_interleave
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *out_file,        /* I: output BIP or BIL filename */
+    Espa_interleave_t interleave,  /* I: interleaving of the output file */
+    bool convert_qa,       /* I: should the QA bands (uint8) be converted to
+                                 the data type of band 1 (if QA bands are of
+                                 a different data type)? */
+    bool del_src           /* I: should the source files be removed after
+                                 conversion? */
+);
+
 int convert_espa_to_raw_binary_bip
 (
     char *espa_xml_file,   /* I: input ESPA XML metadata filename */
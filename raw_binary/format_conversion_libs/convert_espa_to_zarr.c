@@ -0,0 +1,1329 @@
+/*****************************************************************************
+FILE: convert_espa_to_zarr.c
+
+PURPOSE: Contains functions for writing the bands in the XML file to a Zarr
+store of chunked, compressed arrays.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The store is a directory with the .zgroup and .zattrs of the group, and
+     a subdirectory per band with the .zarray and .zattrs of the band array
+     and one file per chunk, named <chunk row>.<chunk column>.  The global
+     metadata are the attributes of the group and the band metadata are the
+     attributes of each band array.
+  2. The arrays have the _ARRAY_DIMENSIONS attribute used by xarray.  Bands
+     of the same size share the y and x dimensions, which have 1-D arrays of
+     the projection coordinates of the pixel centers.
+  3. The edge chunks are padded to the full chunk size with the fill value,
+     as the Zarr specification requires.  Chunks which are all fill aren't
+     written, since Zarr readers return the fill value for missing chunks.
+*****************************************************************************/
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "convert_espa_to_zarr.h"
+#include "raw_binary_pool.h"
+#include "espa_task.h"
+#include "espa_profile.h"
+
+/* Row of chunks compressed by the chunks of espa_parallel_for */
+typedef struct
+{
+    char *array_dir;          /* directory of the band array */
+    uint8_t *line_buf;        /* lines of the band covered by the row */
+    int row;                  /* chunk row number */
+    int nrow_lines;           /* number of band lines in the row */
+    int nsamps;               /* number of samples in the band */
+    int chunk_lines;          /* number of lines in a chunk */
+    int chunk_samps;          /* number of samples in a chunk */
+    int size;                 /* number of bytes per pixel */
+    int level;                /* zlib compression level */
+    bool skip_fill;           /* should all-fill chunks be skipped? */
+    uint8_t *fill_chunk;      /* chunk of fill values */
+    uint8_t **chunk_buf;      /* chunk being compressed, per runner */
+    uint8_t **comp_buf;       /* compressed chunk, per runner */
+    uLong comp_bound;         /* size of each comp_buf */
+} Zarr_row_t;
+
+/******************************************************************************
+MODULE:  get_zarr_dtype
+
+PURPOSE: Gets the Zarr data type of an ESPA data type.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            Unsupported data type
+other           Zarr data type string
+
+NOTES:
+  1. The raw binary files are little-endian (ENVI byte order 0).
+******************************************************************************/
+const char *get_zarr_dtype
+(
+    enum Espa_data_type data_type   /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:    return ("|i1");
+        case ESPA_UINT8:   return ("|u1");
+        case ESPA_INT16:   return ("<i2");
+        case ESPA_UINT16:  return ("<u2");
+        case ESPA_INT32:   return ("<i4");
+        case ESPA_UINT32:  return ("<u4");
+        case ESPA_FLOAT32: return ("<f4");
+        case ESPA_FLOAT64: return ("<f8");
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_string
+
+PURPOSE: Writes a string as a quoted JSON string.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void write_zarr_string
+(
+    FILE *fp,             /* I: JSON file */
+    const char *str       /* I: string to be written */
+)
+{
+    const unsigned char *cptr = NULL;   /* pointer to the current character */
+
+    fputc ('"', fp);
+    for (cptr = (const unsigned char *) str; *cptr != '\0'; cptr++)
+    {
+        if (*cptr == '"' || *cptr == '\\')
+        {
+            fputc ('\\', fp);
+            fputc (*cptr, fp);
+        }
+        else if (*cptr < 0x20)
+            fprintf (fp, "\\u%04x", *cptr);
+        else
+            fputc (*cptr, fp);
+    }
+    fputc ('"', fp);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_text_attr
+
+PURPOSE: Writes a string attribute, unless the string is empty or undefined.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Each attribute is preceded by a comma, so the attributes follow a first
+     attribute which is always written.
+******************************************************************************/
+void write_zarr_text_attr
+(
+    FILE *fp,             /* I: .zattrs file */
+    const char *name,     /* I: attribute name */
+    const char *value     /* I: attribute value */
+)
+{
+    if (value[0] == '\0' || !strcmp (value, ESPA_STRING_META_FILL))
+        return;
+
+    fprintf (fp, ",\n  \"%s\": ", name);
+    write_zarr_string (fp, value);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_number_attr
+
+PURPOSE: Writes a numeric attribute, unless the value is undefined.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. See write_zarr_text_attr.
+******************************************************************************/
+void write_zarr_number_attr
+(
+    FILE *fp,             /* I: .zattrs file */
+    const char *name,     /* I: attribute name */
+    double value          /* I: attribute value */
+)
+{
+    if (fabs (value - ESPA_FLOAT_META_FILL) < ESPA_EPSILON)
+        return;
+
+    fprintf (fp, ",\n  \"%s\": %.15g", name, value);
+}
+
+
+/******************************************************************************
+MODULE:  close_zarr_json
+
+PURPOSE: Closes a JSON file of the store, checking that it was written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the file
+SUCCESS         Successfully wrote the file
+
+NOTES:
+******************************************************************************/
+int close_zarr_json
+(
+    FILE *fp,             /* I: JSON file */
+    char *json_file       /* I: name of the JSON file */
+)
+{
+    char FUNC_NAME[] = "close_zarr_json";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int status;                 /* status of writing the file */
+
+    status = ferror (fp);
+    if (fclose (fp) != 0 || status != 0)
+    {
+        sprintf (errmsg, "Writing the Zarr metadata file: %s", json_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_zarr_json
+
+PURPOSE: Creates a JSON file in a directory of the store.
+
+RETURN VALUE:
+Type = FILE *
+Value           Description
+-----           -----------
+NULL            Error creating the file
+other           File pointer of the JSON file
+
+NOTES:
+******************************************************************************/
+FILE *open_zarr_json
+(
+    char *dir,            /* I: directory of the group or array */
+    char *name,           /* I: name of the JSON file (.zgroup, ...) */
+    char *json_file       /* O: full name of the JSON file (STR_SIZE) */
+)
+{
+    char FUNC_NAME[] = "open_zarr_json";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int count;                  /* number of chars copied in snprintf */
+    FILE *fp = NULL;            /* JSON file pointer */
+
+    count = snprintf (json_file, STR_SIZE, "%s/%s", dir, name);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of json_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    fp = fopen (json_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Creating the Zarr metadata file: %s", json_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    return (fp);
+}
+
+
+/******************************************************************************
+MODULE:  make_zarr_dir
+
+PURPOSE: Creates a directory of the store, if it doesn't already exist.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the directory
+SUCCESS         The directory exists
+
+NOTES:
+******************************************************************************/
+int make_zarr_dir
+(
+    char *dir             /* I: directory to be created */
+)
+{
+    char FUNC_NAME[] = "make_zarr_dir";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+    {
+        sprintf (errmsg, "Creating the Zarr directory: %s", dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_array_meta
+
+PURPOSE: Writes the .zarray metadata of an array.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the metadata
+SUCCESS         Successfully wrote the metadata
+
+NOTES:
+  1. The fill value is null if fill_value is ESPA_INT_META_FILL.
+******************************************************************************/
+int write_zarr_array_meta
+(
+    char *array_dir,      /* I: directory of the array */
+    int ndims,            /* I: number of dimensions */
+    int *shape,           /* I: size of each dimension */
+    int *chunks,          /* I: chunk size of each dimension */
+    const char *dtype,    /* I: Zarr data type */
+    long fill_value,      /* I: fill value of the array */
+    int level             /* I: zlib compression level of the chunks */
+)
+{
+    char json_file[STR_SIZE];   /* name of the .zarray file */
+    int d;                      /* looping variable for the dimensions */
+    FILE *fp = NULL;            /* .zarray file pointer */
+
+    fp = open_zarr_json (array_dir, ".zarray", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    fprintf (fp, "{\n  \"zarr_format\": 2,\n  \"shape\": [");
+    for (d = 0; d < ndims; d++)
+        fprintf (fp, "%s%d", (d > 0) ? ", " : "", shape[d]);
+    fprintf (fp, "],\n  \"chunks\": [");
+    for (d = 0; d < ndims; d++)
+        fprintf (fp, "%s%d", (d > 0) ? ", " : "", chunks[d]);
+    fprintf (fp, "],\n  \"dtype\": \"%s\",\n", dtype);
+    fprintf (fp, "  \"compressor\": {\"id\": \"zlib\", \"level\": %d},\n",
+        level);
+    if (fill_value == ESPA_INT_META_FILL)
+        fprintf (fp, "  \"fill_value\": null,\n");
+    else
+        fprintf (fp, "  \"fill_value\": %ld,\n", fill_value);
+    fprintf (fp, "  \"order\": \"C\",\n  \"filters\": null,\n"
+        "  \"dimension_separator\": \".\"\n}\n");
+
+    return (close_zarr_json (fp, json_file));
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_group_meta
+
+PURPOSE: Writes the .zgroup and the .zattrs of the group, with the global
+metadata as attributes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the metadata
+SUCCESS         Successfully wrote the metadata
+
+NOTES:
+  1. The projection parameters are written for the projection of the
+     product, with the EPSG code of the UTM zones of WGS84.
+******************************************************************************/
+int write_zarr_group_meta
+(
+    char *zarr_dir,       /* I: Zarr store (directory) */
+    Espa_global_meta_t *gmeta  /* I: global metadata */
+)
+{
+    char json_file[STR_SIZE];   /* name of the .zgroup or .zattrs file */
+    FILE *fp = NULL;            /* JSON file pointer */
+    Espa_proj_meta_t *proj = &gmeta->proj_info;  /* projection information */
+
+    fp = open_zarr_json (zarr_dir, ".zgroup", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    fprintf (fp, "{\n  \"zarr_format\": 2\n}\n");
+    if (close_zarr_json (fp, json_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    fp = open_zarr_json (zarr_dir, ".zattrs", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Scene information */
+    fprintf (fp, "{\n  \"Conventions\": \"CF-1.8\"");
+    write_zarr_text_attr (fp, "data_provider", gmeta->data_provider);
+    write_zarr_text_attr (fp, "satellite", gmeta->satellite);
+    write_zarr_text_attr (fp, "instrument", gmeta->instrument);
+    write_zarr_text_attr (fp, "acquisition_date", gmeta->acquisition_date);
+    write_zarr_text_attr (fp, "scene_center_time", gmeta->scene_center_time);
+    write_zarr_text_attr (fp, "level1_production_date",
+        gmeta->level1_production_date);
+    write_zarr_text_attr (fp, "product_id", gmeta->product_id);
+    write_zarr_text_attr (fp, "lpgs_metadata_file",
+        gmeta->lpgs_metadata_file);
+    if (gmeta->wrs_system != ESPA_INT_META_FILL)
+        fprintf (fp, ",\n  \"wrs_system\": %d,\n  \"wrs_path\": %d,\n"
+            "  \"wrs_row\": %d", gmeta->wrs_system, gmeta->wrs_path,
+            gmeta->wrs_row);
+    if (gmeta->htile != ESPA_INT_META_FILL)
+        fprintf (fp, ",\n  \"htile\": %d,\n  \"vtile\": %d", gmeta->htile,
+            gmeta->vtile);
+    write_zarr_number_attr (fp, "solar_zenith", gmeta->solar_zenith);
+    write_zarr_number_attr (fp, "solar_azimuth", gmeta->solar_azimuth);
+    write_zarr_text_attr (fp, "solar_units", gmeta->solar_units);
+    write_zarr_number_attr (fp, "earth_sun_distance", gmeta->earth_sun_dist);
+    write_zarr_number_attr (fp, "orientation_angle",
+        gmeta->orientation_angle);
+    fprintf (fp, ",\n  \"bounding_coordinates\": [%.15g, %.15g, %.15g, "
+        "%.15g]", gmeta->bounding_coords[ESPA_WEST],
+        gmeta->bounding_coords[ESPA_EAST], gmeta->bounding_coords[ESPA_NORTH],
+        gmeta->bounding_coords[ESPA_SOUTH]);
+
+    /* Projection information */
+    fprintf (fp, ",\n  \"projection\": %d,\n  \"datum\": %d",
+        proj->proj_type, proj->datum_type);
+    write_zarr_text_attr (fp, "projection_units", proj->units);
+    write_zarr_text_attr (fp, "grid_origin", proj->grid_origin);
+    fprintf (fp, ",\n  \"ul_corner\": [%.15g, %.15g],\n"
+        "  \"lr_corner\": [%.15g, %.15g]", proj->ul_corner[0],
+        proj->ul_corner[1], proj->lr_corner[0], proj->lr_corner[1]);
+    switch (proj->proj_type)
+    {
+        case GCTP_UTM_PROJ:
+            fprintf (fp, ",\n  \"utm_zone\": %d", proj->utm_zone);
+            if (proj->datum_type == ESPA_WGS84)
+                fprintf (fp, ",\n  \"epsg\": %d", (proj->utm_zone > 0) ?
+                    32600 + proj->utm_zone : 32700 - proj->utm_zone);
+            break;
+
+        case GCTP_PS_PROJ:
+            write_zarr_number_attr (fp, "longitude_pole",
+                proj->longitude_pole);
+            write_zarr_number_attr (fp, "latitude_true_scale",
+                proj->latitude_true_scale);
+            write_zarr_number_attr (fp, "false_easting", proj->false_easting);
+            write_zarr_number_attr (fp, "false_northing",
+                proj->false_northing);
+            break;
+
+        case GCTP_ALBERS_PROJ:
+            write_zarr_number_attr (fp, "standard_parallel1",
+                proj->standard_parallel1);
+            write_zarr_number_attr (fp, "standard_parallel2",
+                proj->standard_parallel2);
+            write_zarr_number_attr (fp, "central_meridian",
+                proj->central_meridian);
+            write_zarr_number_attr (fp, "origin_latitude",
+                proj->origin_latitude);
+            write_zarr_number_attr (fp, "false_easting", proj->false_easting);
+            write_zarr_number_attr (fp, "false_northing",
+                proj->false_northing);
+            break;
+
+        case GCTP_SIN_PROJ:
+            write_zarr_number_attr (fp, "sphere_radius",
+                proj->sphere_radius);
+            write_zarr_number_attr (fp, "central_meridian",
+                proj->central_meridian);
+            write_zarr_number_attr (fp, "false_easting", proj->false_easting);
+            write_zarr_number_attr (fp, "false_northing",
+                proj->false_northing);
+            break;
+    }
+    fprintf (fp, "\n}\n");
+
+    return (close_zarr_json (fp, json_file));
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_band_attrs
+
+PURPOSE: Writes the .zattrs of a band array, with the band metadata as
+attributes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attributes
+SUCCESS         Successfully wrote the attributes
+
+NOTES:
+  1. The fill value isn't an attribute; it's the fill_value of the .zarray.
+  2. The bitmap description is an object keyed by the bit number and the
+     classes an object keyed by the class value.
+  3. A band stacked over time (see espa_stack.h) has the time dimension
+     before the y and x dimensions.
+******************************************************************************/
+int write_zarr_band_attrs
+(
+    char *array_dir,      /* I: directory of the band array */
+    Espa_band_meta_t *bmeta,  /* I: band metadata */
+    char *tdim,           /* I: name of the time dimension of the band; NULL
+                                if the band isn't stacked over time */
+    char *ydim,           /* I: name of the y dimension of the band */
+    char *xdim            /* I: name of the x dimension of the band */
+)
+{
+    char json_file[STR_SIZE];   /* name of the .zattrs file */
+    int i;                      /* looping variable for the bits and classes */
+    FILE *fp = NULL;            /* .zattrs file pointer */
+
+    fp = open_zarr_json (array_dir, ".zattrs", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    fprintf (fp, "{\n  \"_ARRAY_DIMENSIONS\": [");
+    if (tdim != NULL)
+        fprintf (fp, "\"%s\", ", tdim);
+    fprintf (fp, "\"%s\", \"%s\"]", ydim, xdim);
+    write_zarr_text_attr (fp, "name", bmeta->name);
+    write_zarr_text_attr (fp, "product", bmeta->product);
+    write_zarr_text_attr (fp, "source", bmeta->source);
+    write_zarr_text_attr (fp, "category", bmeta->category);
+    write_zarr_text_attr (fp, "short_name", bmeta->short_name);
+    write_zarr_text_attr (fp, "long_name", bmeta->long_name);
+    write_zarr_text_attr (fp, "units", bmeta->data_units);
+    fprintf (fp, ",\n  \"pixel_size\": [%.15g, %.15g]",
+        bmeta->pixel_size[0], bmeta->pixel_size[1]);
+    write_zarr_text_attr (fp, "pixel_units", bmeta->pixel_units);
+    if (bmeta->saturate_value != ESPA_INT_META_FILL)
+        fprintf (fp, ",\n  \"saturate_value\": %d", bmeta->saturate_value);
+    write_zarr_number_attr (fp, "scale_factor", bmeta->scale_factor);
+    write_zarr_number_attr (fp, "add_offset", bmeta->add_offset);
+    if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        fprintf (fp, ",\n  \"valid_range\": [%.15g, %.15g]",
+            bmeta->valid_range[0], bmeta->valid_range[1]);
+    write_zarr_number_attr (fp, "radiance_gain", bmeta->rad_gain);
+    write_zarr_number_attr (fp, "radiance_bias", bmeta->rad_bias);
+    write_zarr_number_attr (fp, "reflectance_gain", bmeta->refl_gain);
+    write_zarr_number_attr (fp, "reflectance_bias", bmeta->refl_bias);
+    write_zarr_number_attr (fp, "k1_constant", bmeta->k1_const);
+    write_zarr_number_attr (fp, "k2_constant", bmeta->k2_const);
+
+    if (bmeta->nbits > 0 && bmeta->bitmap_description != NULL)
+    {
+        fprintf (fp, ",\n  \"bitmap_description\": {");
+        for (i = 0; i < bmeta->nbits; i++)
+        {
+            fprintf (fp, "%s\n    \"%d\": ", (i > 0) ? "," : "", i);
+            write_zarr_string (fp, bmeta->bitmap_description[i]);
+        }
+        fprintf (fp, "\n  }");
+    }
+
+    if (bmeta->nclass > 0 && bmeta->class_values != NULL)
+    {
+        fprintf (fp, ",\n  \"class_values\": {");
+        for (i = 0; i < bmeta->nclass; i++)
+        {
+            fprintf (fp, "%s\n    \"%d\": ", (i > 0) ? "," : "",
+                bmeta->class_values[i].class);
+            write_zarr_string (fp, bmeta->class_values[i].description);
+        }
+        fprintf (fp, "\n  }");
+    }
+
+    write_zarr_text_attr (fp, "qa_description", bmeta->qa_desc);
+    write_zarr_text_attr (fp, "app_version", bmeta->app_version);
+    write_zarr_text_attr (fp, "production_date", bmeta->production_date);
+    fprintf (fp, "\n}\n");
+
+    return (close_zarr_json (fp, json_file));
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_vector
+
+PURPOSE: Writes a 1-D array of the store as a single chunk.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the array
+SUCCESS         Successfully wrote the array
+
+NOTES:
+  1. The array has no fill value.  Its attributes are written by the
+     caller.
+******************************************************************************/
+int write_zarr_vector
+(
+    char *zarr_dir,       /* I: Zarr store (directory) */
+    char *name,           /* I: name of the array */
+    const char *dtype,    /* I: Zarr data type */
+    int n,                /* I: number of values */
+    int size,             /* I: number of bytes per value */
+    void *values,         /* I: values of the array */
+    int level             /* I: zlib compression level */
+)
+{
+    char FUNC_NAME[] = "write_zarr_vector";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char array_dir[STR_SIZE];   /* directory of the array */
+    char chunk_file[STR_SIZE];  /* name of the chunk file */
+    int count;                  /* number of chars copied in snprintf */
+    uLongf comp_len;            /* size of the compressed chunk */
+    Bytef *comp_buf = NULL;     /* compressed chunk */
+    FILE *fp = NULL;            /* chunk file pointer */
+
+    count = snprintf (array_dir, sizeof (array_dir), "%s/%s", zarr_dir,
+        name);
+    if (count < 0 || count >= sizeof (array_dir))
+    {
+        sprintf (errmsg, "Overflow of array_dir string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (make_zarr_dir (array_dir) != SUCCESS ||
+        write_zarr_array_meta (array_dir, 1, &n, &n, dtype,
+            ESPA_INT_META_FILL, level) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Compress the values */
+    comp_len = compressBound ((uLong) n * size);
+    comp_buf = malloc (comp_len);
+    if (comp_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the %s array", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (compress2 (comp_buf, &comp_len, (const Bytef *) values,
+        (uLong) n * size, level) != Z_OK)
+    {
+        sprintf (errmsg, "Compressing the %s array", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (comp_buf);
+        return (ERROR);
+    }
+
+    snprintf (chunk_file, sizeof (chunk_file), "%s/0", array_dir);
+    fp = fopen (chunk_file, "wb");
+    if (fp == NULL || fwrite (comp_buf, 1, comp_len, fp) != comp_len)
+    {
+        sprintf (errmsg, "Writing the Zarr chunk file: %s", chunk_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (fp != NULL)
+            fclose (fp);
+        free (comp_buf);
+        return (ERROR);
+    }
+    free (comp_buf);
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the Zarr chunk file: %s", chunk_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_coord
+
+PURPOSE: Writes the 1-D array of the projection coordinates of the pixel
+centers along the y or x dimension of a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the coordinates
+SUCCESS         Successfully wrote the coordinates
+
+NOTES:
+  1. The UL corner of the projection information is the center of the UL
+     pixel if the grid origin is CENTER, otherwise its outer corner.
+  2. The coordinates are a single chunk.
+******************************************************************************/
+int write_zarr_coord
+(
+    char *zarr_dir,       /* I: Zarr store (directory) */
+    char *dim,            /* I: name of the dimension */
+    bool is_y,            /* I: is this the y dimension? */
+    Espa_proj_meta_t *proj,  /* I: projection information */
+    Espa_band_meta_t *bmeta, /* I: metadata of a band of the dimension */
+    int level             /* I: zlib compression level */
+)
+{
+    char FUNC_NAME[] = "write_zarr_coord";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char coord_dir[STR_SIZE];   /* directory of the coordinate array */
+    char json_file[STR_SIZE];   /* name of the .zattrs file */
+    int i;                      /* looping variable for the coordinates */
+    int n;                      /* number of coordinates */
+    int status;                 /* status of writing the coordinates */
+    double first;               /* coordinate of the first pixel center */
+    double step;                /* coordinate change between pixels */
+    double *coords = NULL;      /* coordinates of the pixel centers */
+    FILE *fp = NULL;            /* .zattrs file pointer */
+
+    if (is_y)
+    {
+        n = bmeta->nlines;
+        first = proj->ul_corner[1];
+        step = -bmeta->pixel_size[1];
+    }
+    else
+    {
+        n = bmeta->nsamps;
+        first = proj->ul_corner[0];
+        step = bmeta->pixel_size[0];
+    }
+    if (strcmp (proj->grid_origin, "CENTER"))
+        first += 0.5 * step;
+
+    /* Compute and write the coordinates */
+    coords = malloc (n * sizeof (double));
+    if (coords == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the %s coordinates", dim);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < n; i++)
+        coords[i] = first + i * step;
+    status = write_zarr_vector (zarr_dir, dim, "<f8", n, sizeof (double),
+        coords, level);
+    free (coords);
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Attributes of the coordinates */
+    snprintf (coord_dir, sizeof (coord_dir), "%s/%s", zarr_dir, dim);
+    fp = open_zarr_json (coord_dir, ".zattrs", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    fprintf (fp, "{\n  \"_ARRAY_DIMENSIONS\": [\"%s\"]", dim);
+    if (proj->proj_type == GCTP_GEO_PROJ)
+        fprintf (fp, ",\n  \"standard_name\": \"%s\"",
+            is_y ? "latitude" : "longitude");
+    else
+        fprintf (fp, ",\n  \"standard_name\": \"%s\"", is_y ?
+            "projection_y_coordinate" : "projection_x_coordinate");
+    write_zarr_text_attr (fp, "units", proj->units);
+    fprintf (fp, "\n}\n");
+
+    return (close_zarr_json (fp, json_file));
+}
+
+
+/******************************************************************************
+MODULE:  compress_zarr_chunks
+
+PURPOSE: Pads, compresses and writes a range of chunks of a row of chunks,
+as the chunk function of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compressing or writing a chunk
+SUCCESS         Successfully wrote the chunks
+
+NOTES:
+  1. The chunks are written straight to their own files, so the runners
+     don't share anything but the lines of the row.
+******************************************************************************/
+static int compress_zarr_chunks
+(
+    void *arg,              /* I: row of chunks (Zarr_row_t *) */
+    int first,              /* I: first chunk column */
+    int end,                /* I: chunk column after the last one */
+    int runner              /* I: number of the runner */
+)
+{
+    char FUNC_NAME[] = "compress_zarr_chunks";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char chunk_file[STR_SIZE];  /* name of the chunk file */
+    int c;                      /* looping variable for the chunk columns */
+    int l;                      /* looping variable for the chunk lines */
+    int samp;                   /* first sample of the chunk */
+    int nchunk_samps;           /* number of band samples in the chunk */
+    size_t chunk_bytes;         /* number of bytes in a chunk */
+    size_t chunk_line_bytes;    /* number of bytes in a chunk line */
+    uLongf comp_len;            /* size of the compressed chunk */
+    Zarr_row_t *zr = arg;       /* row of chunks */
+    uint8_t *chunk = zr->chunk_buf[runner];  /* chunk being compressed */
+    FILE *fp = NULL;            /* chunk file pointer */
+
+    chunk_line_bytes = (size_t) zr->chunk_samps * zr->size;
+    chunk_bytes = zr->chunk_lines * chunk_line_bytes;
+    for (c = first; c < end; c++)
+    {
+        /* Copy the chunk, padding the edge chunks with fill */
+        samp = c * zr->chunk_samps;
+        nchunk_samps = zr->chunk_samps;
+        if (samp + nchunk_samps > zr->nsamps)
+            nchunk_samps = zr->nsamps - samp;
+        if (nchunk_samps < zr->chunk_samps ||
+            zr->nrow_lines < zr->chunk_lines)
+            memcpy (chunk, zr->fill_chunk, chunk_bytes);
+        for (l = 0; l < zr->nrow_lines; l++)
+            memcpy (&chunk[l * chunk_line_bytes], &zr->line_buf[
+                ((size_t) l * zr->nsamps + samp) * zr->size],
+                (size_t) nchunk_samps * zr->size);
+
+        snprintf (chunk_file, sizeof (chunk_file), "%s/%d.%d", zr->array_dir,
+            zr->row, c);
+
+        /* Leave out the chunks which are all fill, removing any left from a
+           previous conversion */
+        if (zr->skip_fill && !memcmp (chunk, zr->fill_chunk, chunk_bytes))
+        {
+            unlink (chunk_file);
+            continue;
+        }
+
+        comp_len = zr->comp_bound;
+        if (compress2 (zr->comp_buf[runner], &comp_len, chunk, chunk_bytes,
+            zr->level) != Z_OK)
+        {
+            sprintf (errmsg, "Compressing the Zarr chunk: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        fp = fopen (chunk_file, "wb");
+        if (fp == NULL)
+        {
+            sprintf (errmsg, "Creating the Zarr chunk file: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (fwrite (zr->comp_buf[runner], 1, comp_len, fp) != comp_len)
+        {
+            sprintf (errmsg, "Writing the Zarr chunk file: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fp);
+            return (ERROR);
+        }
+        if (fclose (fp) != 0)
+        {
+            sprintf (errmsg, "Closing the Zarr chunk file: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_zarr_fill
+
+PURPOSE: Fills a chunk with the fill value of the band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The chunk is zeroed if the band has no fill value.
+******************************************************************************/
+void set_zarr_fill
+(
+    Espa_band_meta_t *bmeta,   /* I: band metadata */
+    size_t npix,               /* I: number of pixels in the chunk */
+    void *chunk                /* O: chunk of fill values */
+)
+{
+    size_t p;                  /* looping variable for the pixels */
+    long fill = bmeta->fill_value;  /* fill value of the band */
+
+    if (fill == ESPA_INT_META_FILL)
+    {
+        memset (chunk, 0, npix * get_data_type_size (bmeta->data_type));
+        return;
+    }
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+        case ESPA_UINT8:
+            memset (chunk, (int) (fill & 0xff), npix);
+            break;
+        case ESPA_INT16:
+        case ESPA_UINT16:
+            for (p = 0; p < npix; p++)
+                ((uint16_t *) chunk)[p] = (uint16_t) fill;
+            break;
+        case ESPA_INT32:
+        case ESPA_UINT32:
+            for (p = 0; p < npix; p++)
+                ((uint32_t *) chunk)[p] = (uint32_t) fill;
+            break;
+        case ESPA_FLOAT32:
+            for (p = 0; p < npix; p++)
+                ((float *) chunk)[p] = (float) fill;
+            break;
+        case ESPA_FLOAT64:
+            for (p = 0; p < npix; p++)
+                ((double *) chunk)[p] = (double) fill;
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_band
+
+PURPOSE: Writes the chunks of a band to its Zarr array directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chunks
+SUCCESS         Successfully wrote the chunks
+
+NOTES:
+  1. The band is read one row of chunks at a time, and the chunks of the row
+     are compressed and written in parallel by the task runtime (see
+     espa_task.h), one chunk buffer per runner.
+  2. Only the chunks are written; the .zarray is written by the caller.
+******************************************************************************/
+int write_zarr_band
+(
+    char *array_dir,       /* I: directory of the Zarr array of the band */
+    Espa_band_meta_t *bmeta,  /* I: band metadata; provides the raw binary
+                                 file, size, data type and fill value */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: zlib compression level of the chunks */
+)
+{
+    char FUNC_NAME[] = "write_zarr_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int r;                      /* looping variable for the runners */
+    int line;                   /* first line of the current row */
+    int ncols;                  /* number of chunk columns */
+    int nthreads;               /* number of runners */
+    int status = SUCCESS;       /* status of writing the rows */
+    size_t chunk_bytes;         /* number of bytes in a chunk */
+    FILE *fp_rb = NULL;         /* raw binary band file pointer */
+    Zarr_row_t zr;              /* row of chunks being written */
+
+    memset (&zr, 0, sizeof (zr));
+    zr.array_dir = array_dir;
+    zr.nsamps = bmeta->nsamps;
+    zr.chunk_lines = chunk_lines;
+    zr.chunk_samps = chunk_samps;
+    zr.size = get_data_type_size (bmeta->data_type);
+    zr.level = level;
+    zr.skip_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    chunk_bytes = (size_t) chunk_lines * chunk_samps * zr.size;
+    zr.comp_bound = compressBound (chunk_bytes);
+    ncols = (bmeta->nsamps + chunk_samps - 1) / chunk_samps;
+    nthreads = espa_task_nthreads ();
+    if (nthreads > ncols)
+        nthreads = ncols;
+
+    /* Allocate the lines of a row, the fill chunk, and the buffers of each
+       runner */
+    zr.line_buf = get_raw_binary_buffer ((size_t) chunk_lines *
+        bmeta->nsamps * zr.size, false);
+    zr.fill_chunk = malloc (chunk_bytes);
+    zr.chunk_buf = calloc (nthreads, sizeof (uint8_t *));
+    zr.comp_buf = calloc (nthreads, sizeof (uint8_t *));
+    if (zr.line_buf == NULL || zr.fill_chunk == NULL ||
+        zr.chunk_buf == NULL || zr.comp_buf == NULL)
+        status = ERROR;
+    for (r = 0; r < nthreads && status == SUCCESS; r++)
+    {
+        zr.chunk_buf[r] = malloc (chunk_bytes);
+        zr.comp_buf[r] = malloc (zr.comp_bound);
+        if (zr.chunk_buf[r] == NULL || zr.comp_buf[r] == NULL)
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating memory for the chunks of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else
+        set_zarr_fill (bmeta, (size_t) chunk_lines * chunk_samps,
+            zr.fill_chunk);
+
+    /* Open the raw binary band */
+    if (status == SUCCESS)
+    {
+        fp_rb = open_raw_binary (bmeta->file_name, "rb");
+        if (fp_rb == NULL)
+        {
+            sprintf (errmsg, "Opening the raw binary file: %s",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Read a row of chunks at a time and write its chunks */
+    for (line = 0; status == SUCCESS && line < bmeta->nlines;
+        line += chunk_lines)
+    {
+        zr.row = line / chunk_lines;
+        zr.nrow_lines = chunk_lines;
+        if (line + zr.nrow_lines > bmeta->nlines)
+            zr.nrow_lines = bmeta->nlines - line;
+
+        if (read_raw_binary (fp_rb, zr.nrow_lines, bmeta->nsamps, zr.size,
+            zr.line_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of band %s", line,
+                line + zr.nrow_lines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        status = espa_parallel_for (0, ncols, 1, nthreads,
+            compress_zarr_chunks, &zr);
+    }
+
+    /* Close the band and free the buffers */
+    if (fp_rb != NULL)
+        close_raw_binary (fp_rb);
+    for (r = 0; r < nthreads && zr.chunk_buf != NULL; r++)
+    {
+        free (zr.chunk_buf[r]);
+        free (zr.comp_buf[r]);
+    }
+    free (zr.chunk_buf);
+    free (zr.comp_buf);
+    free (zr.fill_chunk);
+    release_raw_binary_buffer (zr.line_buf);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  is_zarr_name_used
+
+PURPOSE: Determines if an array name is already used in the store.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The name is used by a previous band, or is the name of a
+                coordinate array (y, x, y<n> or x<n>)
+false           The name is available
+
+NOTES:
+******************************************************************************/
+static bool is_zarr_name_used
+(
+    const char *name,     /* I: array name */
+    int nnames,           /* I: number of names already used */
+    char (*names)[STR_SIZE]  /* I: names already used */
+)
+{
+    int i;                /* looping variable for the names */
+
+    if ((name[0] == 'y' || name[0] == 'x') &&
+        strspn (&name[1], "0123456789") == strlen (&name[1]))
+        return (true);
+
+    for (i = 0; i < nnames; i++)
+    {
+        if (!strcmp (names[i], name))
+            return (true);
+    }
+
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE:  convert_espa_to_zarr
+
+PURPOSE: Converts the internal ESPA raw binary product to a Zarr store.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting to Zarr
+SUCCESS         Successfully converted to Zarr
+
+NOTES:
+  1. Each band is written to the array named after the band, with blank
+     spaces and other characters which don't belong in a filename replaced
+     with underscores.  The array of a band whose name is already used by
+     another band or by a coordinate array is named <product>_<band>, or
+     <product>_<band>_<n> for the nth band of the XML file if that's used as
+     well.
+  2. The first band size has the y and x dimensions; the other band sizes
+     have y<n> and x<n>, numbering the sizes from 1.
+  3. The source product is left in place.  The store may be written over an
+     existing one, whose arrays are replaced.
+******************************************************************************/
+int convert_espa_to_zarr
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *zarr_dir,        /* I: output Zarr store (directory) */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: zlib compression level of the chunks, from
+                                 0 (stored) to 9 */
+)
+{
+    char FUNC_NAME[] = "convert_espa_to_zarr";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char array_dir[STR_SIZE];   /* directory of the current band array */
+    char ydim[STR_SIZE];        /* name of the y dimension of the band */
+    char xdim[STR_SIZE];        /* name of the x dimension of the band */
+    char *cptr = NULL;          /* pointer to the current name character */
+    int i;                      /* looping variable for each band */
+    int k;                      /* looping variable for the name choices */
+    int g;                      /* looping variable for the band sizes */
+    int ngrids = 0;             /* number of distinct band sizes */
+    int count;                  /* number of chars copied in snprintf */
+    int shape[2];               /* lines and samples of the band */
+    int chunks[2];              /* chunk lines and samples of the band */
+    const char *dtype = NULL;   /* Zarr data type of the band */
+    char (*array_names)[STR_SIZE] = NULL;  /* array name of each band */
+    Espa_band_meta_t *bmeta = NULL;  /* current band metadata */
+    Espa_band_meta_t *grid[ZARR_MAX_GRIDS];  /* first band of each size */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                   populated by reading the XML metadata file */
+    ESPA_PROFILE_SCOPE ("convert_espa_to_zarr");
+
+    /* Check the chunking and the compression level */
+    if (chunk_lines < 1 || chunk_lines > ZARR_MAX_CHUNK_SIZE ||
+        chunk_samps < 1 || chunk_samps > ZARR_MAX_CHUNK_SIZE)
+    {
+        sprintf (errmsg, "Chunk lines and samples must be from 1 to %d",
+            ZARR_MAX_CHUNK_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (level < 0 || level > 9)
+    {
+        sprintf (errmsg, "Compression level must be from 0 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Create the store and write the group metadata */
+    if (make_zarr_dir (zarr_dir) != SUCCESS ||
+        write_zarr_group_meta (zarr_dir, &xml_metadata.global) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Allocate the array names of the bands */
+    array_names = calloc (xml_metadata.nbands, STR_SIZE);
+    if (array_names == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the array names");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Loop through the bands in the XML file and write each one to its own
+       array */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        dtype = get_zarr_dtype (bmeta->data_type);
+        if (dtype == NULL)
+        {
+            sprintf (errmsg, "Unsupported data type for band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (array_names);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+
+        /* Determine the array name */
+        for (k = 0; k < 3; k++)
+        {
+            if (k == 0)
+                count = snprintf (array_names[i], STR_SIZE, "%s",
+                    bmeta->name);
+            else if (k == 1)
+                count = snprintf (array_names[i], STR_SIZE, "%s_%s",
+                    bmeta->product, bmeta->name);
+            else
+                count = snprintf (array_names[i], STR_SIZE, "%s_%s_%d",
+                    bmeta->product, bmeta->name, i + 1);
+            if (count < 0 || count >= STR_SIZE)
+                break;
+            for (cptr = array_names[i]; *cptr != '\0'; cptr++)
+            {
+                if (!isalnum ((unsigned char) *cptr) && *cptr != '-' &&
+                    *cptr != '_')
+                    *cptr = '_';
+            }
+            if (!is_zarr_name_used (array_names[i], i, array_names))
+                break;
+        }
+        if (k < 3)
+            count = snprintf (array_dir, sizeof (array_dir), "%s/%s",
+                zarr_dir, array_names[i]);
+        if (k < 3 && (count < 0 || count >= sizeof (array_dir)))
+            k = 3;
+        if (k == 3)
+        {
+            sprintf (errmsg, "Determining the Zarr array name of band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (array_names);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+
+        /* Determine the dimensions of the band, writing the coordinates of
+           a new band size */
+        for (g = 0; g < ngrids; g++)
+        {
+            if (grid[g]->nlines == bmeta->nlines &&
+                grid[g]->nsamps == bmeta->nsamps)
+                break;
+        }
+        if (g == ZARR_MAX_GRIDS)
+        {
+            sprintf (errmsg, "More than %d band sizes in the product",
+                ZARR_MAX_GRIDS);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (array_names);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+        if (g == 0)
+        {
+            strcpy (ydim, "y");
+            strcpy (xdim, "x");
+        }
+        else
+        {
+            sprintf (ydim, "y%d", g);
+            sprintf (xdim, "x%d", g);
+        }
+        if (g == ngrids)
+        {
+            grid[ngrids++] = bmeta;
+            if (write_zarr_coord (zarr_dir, ydim, true,
+                    &xml_metadata.global.proj_info, bmeta, level) != SUCCESS
+                || write_zarr_coord (zarr_dir, xdim, false,
+                    &xml_metadata.global.proj_info, bmeta, level) != SUCCESS)
+            {  /* Error messages already written */
+                free (array_names);
+                free_metadata (&xml_metadata);
+                return (ERROR);
+            }
+        }
+
+        /* Write the array metadata and the chunks.  The chunks are no
+           larger than the band. */
+        printf ("Converting %s to %s\n", bmeta->file_name, array_dir);
+        shape[0] = bmeta->nlines;
+        shape[1] = bmeta->nsamps;
+        chunks[0] = (chunk_lines < bmeta->nlines) ? chunk_lines :
+            bmeta->nlines;
+        chunks[1] = (chunk_samps < bmeta->nsamps) ? chunk_samps :
+            bmeta->nsamps;
+        if (make_zarr_dir (array_dir) != SUCCESS ||
+            write_zarr_array_meta (array_dir, 2, shape, chunks, dtype,
+                bmeta->fill_value, level) != SUCCESS ||
+            write_zarr_band_attrs (array_dir, bmeta, NULL, ydim, xdim) !=
+                SUCCESS ||
+            write_zarr_band (array_dir, bmeta, chunks[0], chunks[1], level)
+                != SUCCESS)
+        {
+            sprintf (errmsg, "Converting %s to Zarr", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (array_names);
+            free_metadata (&xml_metadata);
+            return (ERROR);
+        }
+    }
+
+    /* Free the metadata structure */
+    free (array_names);
+    free_metadata (&xml_metadata);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
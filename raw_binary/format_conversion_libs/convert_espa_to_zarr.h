@@ -0,0 +1,163 @@
+/*****************************************************************************
+FILE: convert_espa_to_zarr.h
+
+PURPOSE: Contains defines and prototypes to read the ESPA XML metadata file
+and imagery, and convert from raw binary to a Zarr store.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The store follows the Zarr version 2 storage specification: a directory
+     holding a group, with one chunked array per band.  The chunks are
+     compressed with zlib, which is the "zlib" codec of numcodecs.
+*****************************************************************************/
+
+#ifndef CONVERT_ESPA_TO_ZARR_H
+#define CONVERT_ESPA_TO_ZARR_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "raw_binary_io.h"
+
+/* Defines */
+/* Default number of lines and samples in a chunk */
+#define ZARR_CHUNK_SIZE 512
+
+/* Largest number of lines or samples in a chunk */
+#define ZARR_MAX_CHUNK_SIZE 8192
+
+/* Default zlib compression level of the chunks */
+#define ZARR_DEFLATE_LEVEL 1
+
+/* Largest number of distinct band sizes in a product, each of which has its
+   own pair of dimensions */
+#define ZARR_MAX_GRIDS 8
+
+/* Prototypes */
+const char *get_zarr_dtype
+(
+    enum Espa_data_type data_type   /* I: ESPA data type */
+);
+
+void write_zarr_string
+(
+    FILE *fp,             /* I: JSON file */
+    const char *str       /* I: string to be written */
+);
+
+void write_zarr_text_attr
+(
+    FILE *fp,             /* I: .zattrs file */
+    const char *name,     /* I: attribute name */
+    const char *value     /* I: attribute value */
+);
+
+void write_zarr_number_attr
+(
+    FILE *fp,             /* I: .zattrs file */
+    const char *name,     /* I: attribute name */
+    double value          /* I: attribute value */
+);
+
+int close_zarr_json
+(
+    FILE *fp,             /* I: JSON file */
+    char *json_file       /* I: name of the JSON file */
+);
+
+FILE *open_zarr_json
+(
+    char *dir,            /* I: directory of the group or array */
+    char *name,           /* I: name of the JSON file (.zgroup, ...) */
+    char *json_file       /* O: full name of the JSON file (STR_SIZE) */
+);
+
+int make_zarr_dir
+(
+    char *dir             /* I: directory to be created */
+);
+
+int write_zarr_array_meta
+(
+    char *array_dir,      /* I: directory of the array */
+    int ndims,            /* I: number of dimensions */
+    int *shape,           /* I: size of each dimension */
+    int *chunks,          /* I: chunk size of each dimension */
+    const char *dtype,    /* I: Zarr data type */
+    long fill_value,      /* I: fill value of the array */
+    int level             /* I: zlib compression level of the chunks */
+);
+
+int write_zarr_group_meta
+(
+    char *zarr_dir,       /* I: Zarr store (directory) */
+    Espa_global_meta_t *gmeta  /* I: global metadata */
+);
+
+int write_zarr_band_attrs
+(
+    char *array_dir,      /* I: directory of the band array */
+    Espa_band_meta_t *bmeta,  /* I: band metadata */
+    char *tdim,           /* I: name of the time dimension of the band; NULL
+                                if the band isn't stacked over time */
+    char *ydim,           /* I: name of the y dimension of the band */
+    char *xdim            /* I: name of the x dimension of the band */
+);
+
+int write_zarr_vector
+(
+    char *zarr_dir,       /* I: Zarr store (directory) */
+    char *name,           /* I: name of the array */
+    const char *dtype,    /* I: Zarr data type */
+    int n,                /* I: number of values */
+    int size,             /* I: number of bytes per value */
+    void *values,         /* I: values of the array */
+    int level             /* I: zlib compression level */
+);
+
+int write_zarr_coord
+(
+    char *zarr_dir,       /* I: Zarr store (directory) */
+    char *dim,            /* I: name of the dimension */
+    bool is_y,            /* I: is this the y dimension? */
+    Espa_proj_meta_t *proj,  /* I: projection information */
+    Espa_band_meta_t *bmeta, /* I: metadata of a band of the dimension */
+    int level             /* I: zlib compression level */
+);
+
+void set_zarr_fill
+(
+    Espa_band_meta_t *bmeta,   /* I: band metadata */
+    size_t npix,               /* I: number of pixels in the chunk */
+    void *chunk                /* O: chunk of fill values */
+);
+
+int write_zarr_band
+(
+    char *array_dir,       /* I: directory of the Zarr array of the band */
+    Espa_band_meta_t *bmeta,  /* I: band metadata; provides the raw binary
+                                 file, size, data type and fill value */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: zlib compression level of the chunks */
+);
+
+int convert_espa_to_zarr
+(
+    char *espa_xml_file,   /* I: input ESPA XML metadata filename */
+    char *zarr_dir,        /* I: output Zarr store (directory) */
+    int chunk_lines,       /* I: number of lines in a chunk */
+    int chunk_samps,       /* I: number of samples in a chunk */
+    int level              /* I: zlib compression level of the chunks, from
+                                 0 (stored) to 9 */
+);
+
+#endif
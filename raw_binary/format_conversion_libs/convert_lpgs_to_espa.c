@@ -17,13 +17,492 @@ NOTES:
 *****************************************************************************/
 #include <unistd.h>
 #include <math.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "convert_lpgs_to_espa.h"
+#include "espa_profile.h"
+#include "espa_probe.h"
+#include "espa_memory.h"
+#include "raw_binary_pool.h"
+#include "espa_task.h"
+
+/* Fields of the MTL file filled by parse_lpgs_mtl; each key of the MTL file
+   known to the parser is dispatched to one of these */
+typedef enum
+{
+    MTL_APP_VERSION, MTL_PRODUCT, MTL_SATELLITE, MTL_INSTRUMENT,
+    MTL_ACQUISITION_DATE, MTL_SCENE_CENTER_TIME, MTL_PRODUCTION_DATE,
+    MTL_SUN_ELEVATION, MTL_SUN_AZIMUTH, MTL_EARTH_SUN_DIST, MTL_WRS_PATH,
+    MTL_WRS_ROW, MTL_CORNER, MTL_PROJ_CORNER, MTL_NSAMPS, MTL_NLINES,
+    MTL_PIXEL_SIZE, MTL_MAP_PROJECTION, MTL_DATUM, MTL_UTM_ZONE,
+    MTL_PROJ_PARAM, MTL_RESAMPLING, MTL_END, MTL_BAND_FILE, MTL_QCAL_MIN,
+    MTL_QCAL_MAX, MTL_RAD_GAIN, MTL_RAD_BIAS, MTL_REFL_GAIN, MTL_REFL_BIAS,
+    MTL_K1, MTL_K2
+} Mtl_field_t;
+
+/* Band indices of the per-band values of bands 7 and 8, which depend on the
+   instrument (see get_mtl_band_index) */
+#define MTL_SENSOR_BAND7 -7
+#define MTL_SENSOR_BAND8 -8
+
+/* Key of the MTL file.  The index selects the value within the field: the
+   corner (UL lat, UL lon, LR lat, LR lon, UR lat, UR lon, LL lat, LL lon),
+   the projection corner (UL x, UL y, LR x, LR y), the resolution
+   (reflective, thermal, pan), the projection parameter (see parse_lpgs_mtl),
+   the band of lpgs_band_files, or the band of the per-band values. */
+typedef struct
+{
+    const char *key;          /* name of the key in the MTL file */
+    Mtl_field_t field;        /* field filled from the key */
+    int index;                /* index of the value within the field */
+} Mtl_key_t;
+
+/* Keys of the MTL file; in some cases both the old and the new LPGS
+   metadata tags are supported */
+static const Mtl_key_t mtl_keys[] =
+{
+    {"PROCESSING_SOFTWARE_VERSION", MTL_APP_VERSION, 0},
+    {"PROCESSING_SOFTWARE", MTL_APP_VERSION, 0},
+    {"DATA_TYPE", MTL_PRODUCT, 0},
+    {"PRODUCT_TYPE", MTL_PRODUCT, 0},
+    {"SPACECRAFT_ID", MTL_SATELLITE, 0},
+    {"SENSOR_ID", MTL_INSTRUMENT, 0},
+    {"DATE_ACQUIRED", MTL_ACQUISITION_DATE, 0},
+    {"ACQUISITION_DATE", MTL_ACQUISITION_DATE, 0},
+    {"SCENE_CENTER_TIME", MTL_SCENE_CENTER_TIME, 0},
+    {"SCENE_CENTER_SCAN_TIME", MTL_SCENE_CENTER_TIME, 0},
+    {"FILE_DATE", MTL_PRODUCTION_DATE, 0},
+    {"PRODUCT_CREATION_TIME", MTL_PRODUCTION_DATE, 0},
+    {"SUN_ELEVATION", MTL_SUN_ELEVATION, 0},
+    {"SUN_AZIMUTH", MTL_SUN_AZIMUTH, 0},
+    {"EARTH_SUN_DISTANCE", MTL_EARTH_SUN_DIST, 0},
+    {"WRS_PATH", MTL_WRS_PATH, 0},
+    {"WRS_ROW", MTL_WRS_ROW, 0},
+    {"STARTING_ROW", MTL_WRS_ROW, 0},
+    {"CORNER_UL_LAT_PRODUCT", MTL_CORNER, 0},
+    {"PRODUCT_UL_CORNER_LAT", MTL_CORNER, 0},
+    {"CORNER_UL_LON_PRODUCT", MTL_CORNER, 1},
+    {"PRODUCT_UL_CORNER_LON", MTL_CORNER, 1},
+    {"CORNER_LR_LAT_PRODUCT", MTL_CORNER, 2},
+    {"PRODUCT_LR_CORNER_LAT", MTL_CORNER, 2},
+    {"CORNER_LR_LON_PRODUCT", MTL_CORNER, 3},
+    {"PRODUCT_LR_CORNER_LON", MTL_CORNER, 3},
+    {"CORNER_UR_LAT_PRODUCT", MTL_CORNER, 4},
+    {"PRODUCT_UR_CORNER_LAT", MTL_CORNER, 4},
+    {"CORNER_UR_LON_PRODUCT", MTL_CORNER, 5},
+    {"PRODUCT_UR_CORNER_LON", MTL_CORNER, 5},
+    {"CORNER_LL_LAT_PRODUCT", MTL_CORNER, 6},
+    {"PRODUCT_LL_CORNER_LAT", MTL_CORNER, 6},
+    {"CORNER_LL_LON_PRODUCT", MTL_CORNER, 7},
+    {"PRODUCT_LL_CORNER_LON", MTL_CORNER, 7},
+    {"CORNER_UL_PROJECTION_X_PRODUCT", MTL_PROJ_CORNER, 0},
+    {"PRODUCT_UL_CORNER_MAPX", MTL_PROJ_CORNER, 0},
+    {"SCENE_UL_CORNER_MAPX", MTL_PROJ_CORNER, 0},
+    {"CORNER_UL_PROJECTION_Y_PRODUCT", MTL_PROJ_CORNER, 1},
+    {"PRODUCT_UL_CORNER_MAPY", MTL_PROJ_CORNER, 1},
+    {"SCENE_UL_CORNER_MAPY", MTL_PROJ_CORNER, 1},
+    {"CORNER_LR_PROJECTION_X_PRODUCT", MTL_PROJ_CORNER, 2},
+    {"PRODUCT_LR_CORNER_MAPX", MTL_PROJ_CORNER, 2},
+    {"SCENE_LR_CORNER_MAPX", MTL_PROJ_CORNER, 2},
+    {"CORNER_LR_PROJECTION_Y_PRODUCT", MTL_PROJ_CORNER, 3},
+    {"PRODUCT_LR_CORNER_MAPY", MTL_PROJ_CORNER, 3},
+    {"SCENE_LR_CORNER_MAPY", MTL_PROJ_CORNER, 3},
+    {"REFLECTIVE_SAMPLES", MTL_NSAMPS, 0},
+    {"PRODUCT_SAMPLES_REF", MTL_NSAMPS, 0},
+    {"REFLECTIVE_LINES", MTL_NLINES, 0},
+    {"PRODUCT_LINES_REF", MTL_NLINES, 0},
+    {"THERMAL_SAMPLES", MTL_NSAMPS, 1},
+    {"PRODUCT_SAMPLES_THM", MTL_NSAMPS, 1},
+    {"THERMAL_LINES", MTL_NLINES, 1},
+    {"PRODUCT_LINES_THM", MTL_NLINES, 1},
+    {"PANCHROMATIC_SAMPLES", MTL_NSAMPS, 2},
+    {"PRODUCT_SAMPLES_PAN", MTL_NSAMPS, 2},
+    {"PANCHROMATIC_LINES", MTL_NLINES, 2},
+    {"PRODUCT_LINES_PAN", MTL_NLINES, 2},
+    {"GRID_CELL_SIZE_REFLECTIVE", MTL_PIXEL_SIZE, 0},
+    {"GRID_CELL_SIZE_REF", MTL_PIXEL_SIZE, 0},
+    {"GRID_CELL_SIZE_THERMAL", MTL_PIXEL_SIZE, 1},
+    {"GRID_CELL_SIZE_THM", MTL_PIXEL_SIZE, 1},
+    {"GRID_CELL_SIZE_PANCHROMATIC", MTL_PIXEL_SIZE, 2},
+    {"GRID_CELL_SIZE_PAN", MTL_PIXEL_SIZE, 2},
+    {"MAP_PROJECTION", MTL_MAP_PROJECTION, 0},
+    {"DATUM", MTL_DATUM, 0},
+    {"REFERENCE_DATUM", MTL_DATUM, 0},
+    {"UTM_ZONE", MTL_UTM_ZONE, 0},
+    {"ZONE_NUMBER", MTL_UTM_ZONE, 0},
+    {"VERTICAL_LON_FROM_POLE", MTL_PROJ_PARAM, 0},
+    {"VERTICAL_LONGITUDE_FROM_POLE", MTL_PROJ_PARAM, 0},
+    {"TRUE_SCALE_LAT", MTL_PROJ_PARAM, 1},
+    {"LATITUDE_OF_TRUE_SCALE", MTL_PROJ_PARAM, 1},
+    {"FALSE_EASTING", MTL_PROJ_PARAM, 2},
+    {"FALSE_NORTHING", MTL_PROJ_PARAM, 3},
+    {"STANDARD_PARALLEL_1_LAT", MTL_PROJ_PARAM, 4},
+    {"STANDARD_PARALLEL_2_LAT", MTL_PROJ_PARAM, 5},
+    {"CENTRAL_MERIDIAN_LON", MTL_PROJ_PARAM, 6},
+    {"ORIGIN_LAT", MTL_PROJ_PARAM, 7},
+    {"RESAMPLING_OPTION", MTL_RESAMPLING, 0},
+    {"END", MTL_END, 0},
+    {"FILE_NAME_BAND_1", MTL_BAND_FILE, 0},
+    {"BAND1_FILE_NAME", MTL_BAND_FILE, 0},
+    {"FILE_NAME_BAND_2", MTL_BAND_FILE, 1},
+    {"BAND2_FILE_NAME", MTL_BAND_FILE, 1},
+    {"FILE_NAME_BAND_3", MTL_BAND_FILE, 2},
+    {"BAND3_FILE_NAME", MTL_BAND_FILE, 2},
+    {"FILE_NAME_BAND_4", MTL_BAND_FILE, 3},
+    {"BAND4_FILE_NAME", MTL_BAND_FILE, 3},
+    {"FILE_NAME_BAND_5", MTL_BAND_FILE, 4},
+    {"BAND5_FILE_NAME", MTL_BAND_FILE, 4},
+    {"FILE_NAME_BAND_6", MTL_BAND_FILE, 5},
+    {"BAND6_FILE_NAME", MTL_BAND_FILE, 5},
+    {"FILE_NAME_BAND_7", MTL_BAND_FILE, 6},
+    {"BAND7_FILE_NAME", MTL_BAND_FILE, 6},
+    {"FILE_NAME_BAND_8", MTL_BAND_FILE, 7},
+    {"BAND8_FILE_NAME", MTL_BAND_FILE, 7},
+    {"FILE_NAME_BAND_6_VCID_1", MTL_BAND_FILE, 8},
+    {"BAND61_FILE_NAME", MTL_BAND_FILE, 8},
+    {"FILE_NAME_BAND_6_VCID_2", MTL_BAND_FILE, 9},
+    {"BAND62_FILE_NAME", MTL_BAND_FILE, 9},
+    {"FILE_NAME_BAND_9", MTL_BAND_FILE, 10},
+    {"BAND9_FILE_NAME", MTL_BAND_FILE, 10},
+    {"FILE_NAME_BAND_10", MTL_BAND_FILE, 11},
+    {"BAND10_FILE_NAME", MTL_BAND_FILE, 11},
+    {"FILE_NAME_BAND_11", MTL_BAND_FILE, 12},
+    {"BAND11_FILE_NAME", MTL_BAND_FILE, 12},
+    {"FILE_NAME_BAND_QUALITY", MTL_BAND_FILE, 13},
+    {"QUANTIZE_CAL_MIN_BAND_1", MTL_QCAL_MIN, 0},
+    {"QCALMIN_BAND1", MTL_QCAL_MIN, 0},
+    {"QUANTIZE_CAL_MIN_BAND_2", MTL_QCAL_MIN, 1},
+    {"QCALMIN_BAND2", MTL_QCAL_MIN, 1},
+    {"QUANTIZE_CAL_MIN_BAND_3", MTL_QCAL_MIN, 2},
+    {"QCALMIN_BAND3", MTL_QCAL_MIN, 2},
+    {"QUANTIZE_CAL_MIN_BAND_4", MTL_QCAL_MIN, 3},
+    {"QCALMIN_BAND4", MTL_QCAL_MIN, 3},
+    {"QUANTIZE_CAL_MIN_BAND_5", MTL_QCAL_MIN, 4},
+    {"QCALMIN_BAND5", MTL_QCAL_MIN, 4},
+    {"QUANTIZE_CAL_MIN_BAND_6", MTL_QCAL_MIN, 5},
+    {"QCALMIN_BAND6", MTL_QCAL_MIN, 5},
+    {"QUANTIZE_CAL_MIN_BAND_7", MTL_QCAL_MIN, MTL_SENSOR_BAND7},
+    {"QCALMIN_BAND7", MTL_QCAL_MIN, MTL_SENSOR_BAND7},
+    {"QUANTIZE_CAL_MIN_BAND_8", MTL_QCAL_MIN, MTL_SENSOR_BAND8},
+    {"QCALMIN_BAND8", MTL_QCAL_MIN, MTL_SENSOR_BAND8},
+    {"QUANTIZE_CAL_MIN_BAND_6_VCID_1", MTL_QCAL_MIN, 5},
+    {"QCALMIN_BAND61", MTL_QCAL_MIN, 5},
+    {"QUANTIZE_CAL_MIN_BAND_6_VCID_2", MTL_QCAL_MIN, 6},
+    {"QCALMIN_BAND62", MTL_QCAL_MIN, 6},
+    {"QUANTIZE_CAL_MIN_BAND_9", MTL_QCAL_MIN, 8},
+    {"QUANTIZE_CAL_MIN_BAND_10", MTL_QCAL_MIN, 9},
+    {"QUANTIZE_CAL_MIN_BAND_11", MTL_QCAL_MIN, 10},
+    {"QUANTIZE_CAL_MAX_BAND_1", MTL_QCAL_MAX, 0},
+    {"QCALMAX_BAND1", MTL_QCAL_MAX, 0},
+    {"QUANTIZE_CAL_MAX_BAND_2", MTL_QCAL_MAX, 1},
+    {"QCALMAX_BAND2", MTL_QCAL_MAX, 1},
+    {"QUANTIZE_CAL_MAX_BAND_3", MTL_QCAL_MAX, 2},
+    {"QCALMAX_BAND3", MTL_QCAL_MAX, 2},
+    {"QUANTIZE_CAL_MAX_BAND_4", MTL_QCAL_MAX, 3},
+    {"QCALMAX_BAND4", MTL_QCAL_MAX, 3},
+    {"QUANTIZE_CAL_MAX_BAND_5", MTL_QCAL_MAX, 4},
+    {"QCALMAX_BAND5", MTL_QCAL_MAX, 4},
+    {"QUANTIZE_CAL_MAX_BAND_6", MTL_QCAL_MAX, 5},
+    {"QCALMAX_BAND6", MTL_QCAL_MAX, 5},
+    {"QUANTIZE_CAL_MAX_BAND_7", MTL_QCAL_MAX, MTL_SENSOR_BAND7},
+    {"QCALMAX_BAND7", MTL_QCAL_MAX, MTL_SENSOR_BAND7},
+    {"QUANTIZE_CAL_MAX_BAND_8", MTL_QCAL_MAX, MTL_SENSOR_BAND8},
+    {"QCALMAX_BAND8", MTL_QCAL_MAX, MTL_SENSOR_BAND8},
+    {"QUANTIZE_CAL_MAX_BAND_6_VCID_1", MTL_QCAL_MAX, 5},
+    {"QCALMAX_BAND61", MTL_QCAL_MAX, 5},
+    {"QUANTIZE_CAL_MAX_BAND_6_VCID_2", MTL_QCAL_MAX, 6},
+    {"QCALMAX_BAND62", MTL_QCAL_MAX, 6},
+    {"QUANTIZE_CAL_MAX_BAND_9", MTL_QCAL_MAX, 8},
+    {"QUANTIZE_CAL_MAX_BAND_10", MTL_QCAL_MAX, 9},
+    {"QUANTIZE_CAL_MAX_BAND_11", MTL_QCAL_MAX, 10},
+    {"RADIANCE_MULT_BAND_1", MTL_RAD_GAIN, 0},
+    {"RADIANCE_MULT_BAND_2", MTL_RAD_GAIN, 1},
+    {"RADIANCE_MULT_BAND_3", MTL_RAD_GAIN, 2},
+    {"RADIANCE_MULT_BAND_4", MTL_RAD_GAIN, 3},
+    {"RADIANCE_MULT_BAND_5", MTL_RAD_GAIN, 4},
+    {"RADIANCE_MULT_BAND_6", MTL_RAD_GAIN, 5},
+    {"RADIANCE_MULT_BAND_7", MTL_RAD_GAIN, MTL_SENSOR_BAND7},
+    {"RADIANCE_MULT_BAND_8", MTL_RAD_GAIN, MTL_SENSOR_BAND8},
+    {"RADIANCE_MULT_BAND_6_VCID_1", MTL_RAD_GAIN, 5},
+    {"RADIANCE_MULT_BAND_6_VCID_2", MTL_RAD_GAIN, 6},
+    {"RADIANCE_MULT_BAND_9", MTL_RAD_GAIN, 8},
+    {"RADIANCE_MULT_BAND_10", MTL_RAD_GAIN, 9},
+    {"RADIANCE_MULT_BAND_11", MTL_RAD_GAIN, 10},
+    {"RADIANCE_ADD_BAND_1", MTL_RAD_BIAS, 0},
+    {"RADIANCE_ADD_BAND_2", MTL_RAD_BIAS, 1},
+    {"RADIANCE_ADD_BAND_3", MTL_RAD_BIAS, 2},
+    {"RADIANCE_ADD_BAND_4", MTL_RAD_BIAS, 3},
+    {"RADIANCE_ADD_BAND_5", MTL_RAD_BIAS, 4},
+    {"RADIANCE_ADD_BAND_6", MTL_RAD_BIAS, 5},
+    {"RADIANCE_ADD_BAND_7", MTL_RAD_BIAS, MTL_SENSOR_BAND7},
+    {"RADIANCE_ADD_BAND_8", MTL_RAD_BIAS, MTL_SENSOR_BAND8},
+    {"RADIANCE_ADD_BAND_6_VCID_1", MTL_RAD_BIAS, 5},
+    {"RADIANCE_ADD_BAND_6_VCID_2", MTL_RAD_BIAS, 6},
+    {"RADIANCE_ADD_BAND_9", MTL_RAD_BIAS, 8},
+    {"RADIANCE_ADD_BAND_10", MTL_RAD_BIAS, 9},
+    {"RADIANCE_ADD_BAND_11", MTL_RAD_BIAS, 10},
+    {"REFLECTANCE_MULT_BAND_1", MTL_REFL_GAIN, 0},
+    {"REFLECTANCE_MULT_BAND_2", MTL_REFL_GAIN, 1},
+    {"REFLECTANCE_MULT_BAND_3", MTL_REFL_GAIN, 2},
+    {"REFLECTANCE_MULT_BAND_4", MTL_REFL_GAIN, 3},
+    {"REFLECTANCE_MULT_BAND_5", MTL_REFL_GAIN, 4},
+    {"REFLECTANCE_MULT_BAND_6", MTL_REFL_GAIN, 5},
+    {"REFLECTANCE_MULT_BAND_7", MTL_REFL_GAIN, MTL_SENSOR_BAND7},
+    {"REFLECTANCE_MULT_BAND_8", MTL_REFL_GAIN, MTL_SENSOR_BAND8},
+    {"REFLECTANCE_MULT_BAND_6_VCID_1", MTL_REFL_GAIN, 5},
+    {"REFLECTANCE_MULT_BAND_6_VCID_2", MTL_REFL_GAIN, 6},
+    {"REFLECTANCE_MULT_BAND_9", MTL_REFL_GAIN, 8},
+    {"REFLECTANCE_ADD_BAND_1", MTL_REFL_BIAS, 0},
+    {"REFLECTANCE_ADD_BAND_2", MTL_REFL_BIAS, 1},
+    {"REFLECTANCE_ADD_BAND_3", MTL_REFL_BIAS, 2},
+    {"REFLECTANCE_ADD_BAND_4", MTL_REFL_BIAS, 3},
+    {"REFLECTANCE_ADD_BAND_5", MTL_REFL_BIAS, 4},
+    {"REFLECTANCE_ADD_BAND_6", MTL_REFL_BIAS, 5},
+    {"REFLECTANCE_ADD_BAND_7", MTL_REFL_BIAS, MTL_SENSOR_BAND7},
+    {"REFLECTANCE_ADD_BAND_8", MTL_REFL_BIAS, MTL_SENSOR_BAND8},
+    {"REFLECTANCE_ADD_BAND_6_VCID_1", MTL_REFL_BIAS, 5},
+    {"REFLECTANCE_ADD_BAND_6_VCID_2", MTL_REFL_BIAS, 6},
+    {"REFLECTANCE_ADD_BAND_9", MTL_REFL_BIAS, 8},
+    {"K1_CONSTANT_BAND_10", MTL_K1, 9},
+    {"K1_CONSTANT_BAND_11", MTL_K1, 10},
+    {"K1_CONSTANT_BAND_6_VCID_1", MTL_K1, 5},
+    {"K1_CONSTANT_BAND_6_VCID_2", MTL_K1, 6},
+    {"K1_CONSTANT_BAND_6", MTL_K1, 5},
+    {"K2_CONSTANT_BAND_10", MTL_K2, 9},
+    {"K2_CONSTANT_BAND_11", MTL_K2, 10},
+    {"K2_CONSTANT_BAND_6_VCID_1", MTL_K2, 5},
+    {"K2_CONSTANT_BAND_6_VCID_2", MTL_K2, 6},
+    {"K2_CONSTANT_BAND_6", MTL_K2, 5},
+};
+
+#define NUM_MTL_KEYS ((int) (sizeof (mtl_keys) / sizeof (mtl_keys[0])))
+
+/* Size of the MTL key hash table; must be a power of 2 larger than
+   NUM_MTL_KEYS */
+#define MTL_KEY_HASH_SIZE 512
+
+/* Hash table of the MTL keys, holding the index in mtl_keys of the key of
+   each slot or -1 if the slot is empty; built once */
+static short mtl_key_hash[MTL_KEY_HASH_SIZE];
+static pthread_once_t mtl_key_hash_once = PTHREAD_ONCE_INIT;
+
+/* XTIFFOpen registers the GeoTIFF tag extender with libtiff the first time
+   it's called, which isn't thread safe, so the extender is registered once
+   before any GeoTIFF is opened */
+static pthread_once_t xtiff_once = PTHREAD_ONCE_INIT;
+
+/* Band files of the MTL file, in the order of their keys in mtl_keys */
+static const struct
+{
+    const char *band_num;     /* band number for the band name */
+    const char *category;     /* band category */
+    bool thermal;             /* is this band a thermal band? (band 6 is
+                                 thermal for TM only) */
+} lpgs_band_files[] =
+{
+    {"1", "image", false}, {"2", "image", false}, {"3", "image", false},
+    {"4", "image", false}, {"5", "image", false}, {"6", "image", false},
+    {"7", "image", false}, {"8", "image", false}, {"61", "image", true},
+    {"62", "image", true}, {"9", "image", false}, {"10", "image", true},
+    {"11", "image", true}, {"bqa", "qa", false}
+};
+
+/* Separators of the keys and values of the MTL file */
+#define MTL_SEPARATORS "=\" \t\r"
+
 
 /******************************************************************************
-MODULE:  read_lpgs_mtl
+MODULE:  hash_mtl_key
 
-PURPOSE: Read the LPGS MTL metadata file and populate the ESPA internal
-metadata structure
+PURPOSE: Returns the hash table slot for a key of the MTL file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+slot            Starting slot in the hash table for this key
+
+NOTES:
+  1. The hash is 32-bit FNV-1a.
+******************************************************************************/
+static int hash_mtl_key
+(
+    const char *key             /* I: key of the MTL file */
+)
+{
+    uint32_t hash = 2166136261u;   /* FNV-1a hash of the key */
+
+    for (; *key != '\0'; key++)
+    {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619u;
+    }
+
+    return ((int) (hash & (MTL_KEY_HASH_SIZE - 1)));
+}
+
+
+/******************************************************************************
+MODULE:  init_mtl_key_hash
+
+PURPOSE: Builds the hash table of the MTL keys.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Collisions are resolved by linear probing.
+******************************************************************************/
+static void init_mtl_key_hash ()
+{
+    int i;                      /* looping variable for keys */
+    int slot;                   /* slot in the hash table */
+
+    for (slot = 0; slot < MTL_KEY_HASH_SIZE; slot++)
+        mtl_key_hash[slot] = -1;
+
+    for (i = 0; i < NUM_MTL_KEYS; i++)
+    {
+        slot = hash_mtl_key (mtl_keys[i].key);
+        while (mtl_key_hash[slot] != -1)
+            slot = (slot + 1) & (MTL_KEY_HASH_SIZE - 1);
+        mtl_key_hash[slot] = i;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  find_mtl_key
+
+PURPOSE: Looks up a key of the MTL file.
+
+RETURN VALUE:
+Type = const Mtl_key_t *
+Value           Description
+-----           -----------
+NULL            Key isn't known to the parser
+other           Known key
+
+NOTES:
+******************************************************************************/
+static const Mtl_key_t *find_mtl_key
+(
+    const char *key             /* I: key of the MTL file */
+)
+{
+    int slot;                   /* slot in the hash table */
+
+    pthread_once (&mtl_key_hash_once, init_mtl_key_hash);
+
+    for (slot = hash_mtl_key (key); mtl_key_hash[slot] != -1;
+         slot = (slot + 1) & (MTL_KEY_HASH_SIZE - 1))
+    {
+        if (!strcmp (mtl_keys[mtl_key_hash[slot]].key, key))
+            return (&mtl_keys[mtl_key_hash[slot]]);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  get_mtl_band_index
+
+PURPOSE: Returns the band index of a per-band value of the MTL file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Value isn't used for this instrument
+other           Band index of the value
+
+NOTES:
+  1. Band 7 is the seventh band for TM and OLI, and the eighth band for ETM+
+     (after bands 61 and 62).  Band 8 is the eighth band for OLI and the
+     ninth band for ETM+.
+******************************************************************************/
+static int get_mtl_band_index
+(
+    const char *instrument,     /* I: instrument of the product */
+    int index                   /* I: index of the key */
+)
+{
+    bool oli = !strcmp (instrument, "OLI_TIRS") || !strcmp (instrument, "OLI");
+    bool etm = !strncmp (instrument, "ETM", 3);
+
+    if (index == MTL_SENSOR_BAND7)
+    {
+        if (oli || !strcmp (instrument, "TM"))
+            return (6);
+        return (etm ? 7 : -1);
+    }
+    else if (index == MTL_SENSOR_BAND8)
+    {
+        if (oli)
+            return (7);
+        return (etm ? 8 : -1);
+    }
+
+    return (index);
+}
+
+
+/******************************************************************************
+MODULE:  next_mtl_line
+
+PURPOSE: Tokenizes the next line of the MTL file in place.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           No more lines
+true            Line was tokenized
+
+NOTES:
+  1. The key and the value are NUL terminated in the buffer.  The key is
+     empty for a blank line, and the value is empty if the line has none.
+******************************************************************************/
+static bool next_mtl_line
+(
+    char **next,                /* I/O: start of the next line */
+    char **key,                 /* O: key of the line */
+    char **value                /* O: value of the line */
+)
+{
+    char *line = *next;         /* start of the line */
+    char *ptr = NULL;           /* current position in the line */
+
+    if (*line == '\0')
+        return (false);
+
+    ptr = strchr (line, '\n');
+    if (ptr != NULL)
+    {
+        *ptr = '\0';
+        *next = ptr + 1;
+    }
+    else
+        *next = line + strlen (line);
+
+    /* The key is the first token and the value the second */
+    *key = line + strspn (line, MTL_SEPARATORS);
+    ptr = *key + strcspn (*key, MTL_SEPARATORS);
+    if (*ptr != '\0')
+        *ptr++ = '\0';
+    *value = ptr + strspn (ptr, MTL_SEPARATORS);
+    (*value)[strcspn (*value, MTL_SEPARATORS)] = '\0';
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  parse_lpgs_mtl
+
+PURPOSE: Parse the LPGS MTL metadata held in memory and populate the ESPA
+internal metadata structure
 
 RETURN VALUE:
 Type = int
@@ -38,9 +517,14 @@ NOTES:
    parsed and written to our XML metadata file, if they exist.
 2. When processing OLI_TIRS stack the 11 image bands first, then add the
    QA band to the list.
+3. The MTL metadata is tokenized in place, one line at a time, and the key
+   of each line is looked up in the hash table of mtl_keys and dispatched to
+   the field it fills.
 ******************************************************************************/
-int read_lpgs_mtl
+static int parse_lpgs_mtl
 (
+    char *mtl_buf,                   /* I/O: contents of the MTL file, NUL
+                                           terminated; tokenized in place */
     char *mtl_file,                  /* I: name of the MTL metadata file to
                                            be read */
     Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
@@ -50,7 +534,7 @@ int read_lpgs_mtl
                                            the LPGS bands */
 )
 {
-    char FUNC_NAME[] = "read_lpgs_mtl";  /* function name */
+    char FUNC_NAME[] = "parse_lpgs_mtl";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
     char category[STR_SIZE][MAX_LPGS_BANDS]; /* band category - qa, image */
     char band_num[STR_SIZE][MAX_LPGS_BANDS]; /* band number for band name */
@@ -66,7 +550,6 @@ int read_lpgs_mtl
     bool refl_gain_bias_available; /* are TOA reflectance gain/bias values and
                                  K1/K2 constants available in the MTL file? */
     bool thermal[MAX_LPGS_BANDS]; /* is this band a thermal band? */
-    FILE *mtl_fptr=NULL;      /* file pointer to the MTL metadata file */
     Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
                                                        metadata structure */
     Espa_band_meta_t *bmeta;  /* pointer to the array of bands metadata */
@@ -98,128 +581,144 @@ int read_lpgs_mtl
     float k2[MAX_LPGS_BANDS]; /* K2 consts for brightness temp calculations */
 
     /* vars used in parameter parsing */
-    char buffer[STR_SIZE] = "\0";          /* line buffer from MTL file */
-    char *label = NULL;                    /* label value in the line */
-    char *tokenptr = NULL;                 /* pointer to process each line */
-    char *seperator = "=\" \t";            /* separator string */
+    char *next = mtl_buf;                  /* start of the next line */
+    char *key = NULL;                      /* key of the line */
+    char *value = NULL;                    /* value of the line */
+    const Mtl_key_t *mtl_key = NULL;       /* known key of the line */
+    int index;                             /* index of the value */
     float fnum;                            /* temporary variable for floating
                                               point numbers */
-
-    /* Open the metadata MTL file with read privelages */
-    mtl_fptr = fopen (mtl_file, "r");
-    if (mtl_fptr == NULL)
-    {
-        sprintf (errmsg, "Opening %s for read access.", mtl_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Process the MTL file line by line */
+    double *corner[8];        /* corners, in the order of the MTL_CORNER
+                                 indices */
+    double *proj_corner[4];   /* projection corners, in the order of the
+                                 MTL_PROJ_CORNER indices */
+    double *proj_param[8];    /* projection parameters, in the order of the
+                                 MTL_PROJ_PARAM indices */
+    Espa_band_meta_t *res_bmeta[3];  /* band metadata for each resolution,
+                                 in the order of the resolution indices */
+
+    /* Set up the values filled by the indexed fields */
+    corner[0] = &gmeta->ul_corner[0];
+    corner[1] = &gmeta->ul_corner[1];
+    corner[2] = &gmeta->lr_corner[0];
+    corner[3] = &gmeta->lr_corner[1];
+    corner[4] = &ur_corner[0];
+    corner[5] = &ur_corner[1];
+    corner[6] = &ll_corner[0];
+    corner[7] = &ll_corner[1];
+    proj_corner[0] = &gmeta->proj_info.ul_corner[0];
+    proj_corner[1] = &gmeta->proj_info.ul_corner[1];
+    proj_corner[2] = &gmeta->proj_info.lr_corner[0];
+    proj_corner[3] = &gmeta->proj_info.lr_corner[1];
+
+    /* PS projection parameters, then the ALBERS projection parameters (in
+       addition to false easting and northing) */
+    proj_param[0] = &gmeta->proj_info.longitude_pole;
+    proj_param[1] = &gmeta->proj_info.latitude_true_scale;
+    proj_param[2] = &gmeta->proj_info.false_easting;
+    proj_param[3] = &gmeta->proj_info.false_northing;
+    proj_param[4] = &gmeta->proj_info.standard_parallel1;
+    proj_param[5] = &gmeta->proj_info.standard_parallel2;
+    proj_param[6] = &gmeta->proj_info.central_meridian;
+    proj_param[7] = &gmeta->proj_info.origin_latitude;
+    res_bmeta[0] = &tmp_bmeta;
+    res_bmeta[1] = &tmp_bmeta_th;
+    res_bmeta[2] = &tmp_bmeta_pan;
+
+    /* Process the MTL file line by line, dispatching each known key to its
+       field */
     gain_bias_available = false;
     refl_gain_bias_available = false;
     done_with_mtl = false;
-    while (fgets (buffer, STR_SIZE, mtl_fptr) != NULL)
+    while (!done_with_mtl && next_mtl_line (&next, &key, &value))
     {
-        /* If the last character is the end of line, then strip it off */
-        if (buffer[strlen(buffer)-1] == '\n')
-            buffer[strlen(buffer)-1] = '\0';
-
-        /* Get string token */
-        tokenptr = strtok (buffer, seperator);
-        label = tokenptr;
- 
-        if (tokenptr != NULL)
-        {
-            tokenptr = strtok (NULL, seperator);
+        mtl_key = find_mtl_key (key);
+        if (mtl_key == NULL)
+            continue;
+        index = mtl_key->index;
 
-            /* Process each token; in some cases we are supporting both the
-               old and the new LPGS metadata tags */
-            if (!strcmp (label, "PROCESSING_SOFTWARE_VERSION") ||
-                !strcmp (label, "PROCESSING_SOFTWARE"))
-            {
+        switch (mtl_key->field)
+        {
+            case MTL_APP_VERSION:
                 count = snprintf (tmp_bmeta.app_version,
-                    sizeof (tmp_bmeta.app_version), "%s", tokenptr);
+                    sizeof (tmp_bmeta.app_version), "%s", value);
                 if (count < 0 || count >= sizeof (tmp_bmeta.app_version))
                 {
                     sprintf (errmsg, "Overflow of tmp_bmeta.app_version");
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "DATA_TYPE") ||
-                     !strcmp (label, "PRODUCT_TYPE"))
-            {
-                count = snprintf (tmp_bmeta.product, sizeof (tmp_bmeta.product),
-                    "%s", tokenptr);
+                break;
+
+            case MTL_PRODUCT:
+                count = snprintf (tmp_bmeta.product,
+                    sizeof (tmp_bmeta.product), "%s", value);
                 if (count < 0 || count >= sizeof (tmp_bmeta.product))
                 {
                     sprintf (errmsg, "Overflow of tmp_bmeta.product string");
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "SPACECRAFT_ID"))
-            {
-                if (strcmp (tokenptr, "LANDSAT_8") == 0 ||
-                    strcmp (tokenptr, "Landsat8") == 0)
+                break;
+
+            case MTL_SATELLITE:
+                if (strcmp (value, "LANDSAT_8") == 0 ||
+                    strcmp (value, "Landsat8") == 0)
                     strcpy (gmeta->satellite, "LANDSAT_8");
-                else if (strcmp (tokenptr, "LANDSAT_7") == 0 ||
-                    strcmp (tokenptr, "Landsat7") == 0)
+                else if (strcmp (value, "LANDSAT_7") == 0 ||
+                    strcmp (value, "Landsat7") == 0)
                     strcpy (gmeta->satellite, "LANDSAT_7");
-                else if (strcmp (tokenptr, "LANDSAT_5") == 0 ||
-                         strcmp (tokenptr, "Landsat5") == 0)
+                else if (strcmp (value, "LANDSAT_5") == 0 ||
+                         strcmp (value, "Landsat5") == 0)
                     strcpy (gmeta->satellite, "LANDSAT_5");
-                else if (strcmp (tokenptr, "LANDSAT_4") == 0 ||
-                         strcmp (tokenptr, "Landsat4") == 0)
+                else if (strcmp (value, "LANDSAT_4") == 0 ||
+                         strcmp (value, "Landsat4") == 0)
                     strcpy (gmeta->satellite, "LANDSAT_4");
                 else
                 {
                     sprintf (errmsg, "Unsupported satellite type: %s",
-                        tokenptr);
+                        value);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "SENSOR_ID"))
-            {
-                count = snprintf (gmeta->instrument, sizeof (gmeta->instrument),
-                    "%s", tokenptr);
+                break;
+
+            case MTL_INSTRUMENT:
+                count = snprintf (gmeta->instrument,
+                    sizeof (gmeta->instrument), "%s", value);
                 if (count < 0 || count >= sizeof (gmeta->instrument))
                 {
                     sprintf (errmsg, "Overflow of gmeta->instrument string");
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "DATE_ACQUIRED") ||
-                     !strcmp (label, "ACQUISITION_DATE"))
-            {
+                break;
+
+            case MTL_ACQUISITION_DATE:
                 count = snprintf (gmeta->acquisition_date,
-                    sizeof (gmeta->acquisition_date), "%s", tokenptr);
+                    sizeof (gmeta->acquisition_date), "%s", value);
                 if (count < 0 || count >= sizeof (gmeta->acquisition_date))
                 {
                     sprintf (errmsg, "Overflow of gmeta->acquisition_date");
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "SCENE_CENTER_TIME") ||
-                     !strcmp (label, "SCENE_CENTER_SCAN_TIME"))
-            {
+                break;
+
+            case MTL_SCENE_CENTER_TIME:
                 count = snprintf (gmeta->scene_center_time,
-                    sizeof (gmeta->scene_center_time), "%s", tokenptr);
+                    sizeof (gmeta->scene_center_time), "%s", value);
                 if (count < 0 || count >= sizeof (gmeta->scene_center_time))
                 {
                     sprintf (errmsg, "Overflow of gmeta->scene_center_time");
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "FILE_DATE") ||
-                     !strcmp (label, "PRODUCT_CREATION_TIME"))
-            {
+                break;
+
+            case MTL_PRODUCTION_DATE:
                 count = snprintf (gmeta->level1_production_date,
-                    sizeof (gmeta->level1_production_date), "%s", tokenptr);
+                    sizeof (gmeta->level1_production_date), "%s", value);
                 if (count < 0 ||
                     count >= sizeof (gmeta->level1_production_date))
                 {
@@ -228,241 +727,124 @@ int read_lpgs_mtl
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "SUN_ELEVATION"))
-            {
-                sscanf (tokenptr, "%f", &fnum);
-                gmeta->solar_zenith = 90.0 - fnum;
-            }
-            else if (!strcmp (label, "SUN_AZIMUTH"))
-                sscanf (tokenptr, "%f", &gmeta->solar_azimuth);
-            else if (!strcmp (label, "EARTH_SUN_DISTANCE"))
-                sscanf (tokenptr, "%f", &gmeta->earth_sun_dist);
-            else if (!strcmp (label, "WRS_PATH"))
-                sscanf (tokenptr, "%d", &gmeta->wrs_path);
-            else if (!strcmp (label, "WRS_ROW") ||
-                     !strcmp (label, "STARTING_ROW"))
-                sscanf (tokenptr, "%d", &gmeta->wrs_row);
-
-            else if (!strcmp (label, "CORNER_UL_LAT_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_UL_CORNER_LAT"))
-                sscanf (tokenptr, "%lf", &gmeta->ul_corner[0]);
-            else if (!strcmp (label, "CORNER_UL_LON_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_UL_CORNER_LON"))
-                sscanf (tokenptr, "%lf", &gmeta->ul_corner[1]);
-            else if (!strcmp (label, "CORNER_LR_LAT_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_LR_CORNER_LAT"))
-                sscanf (tokenptr, "%lf", &gmeta->lr_corner[0]);
-            else if (!strcmp (label, "CORNER_LR_LON_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_LR_CORNER_LON"))
-                sscanf (tokenptr, "%lf", &gmeta->lr_corner[1]);
-
-            else if (!strcmp (label, "CORNER_UR_LAT_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_UR_CORNER_LAT"))
-                sscanf (tokenptr, "%lf", &ur_corner[0]);
-            else if (!strcmp (label, "CORNER_UR_LON_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_UR_CORNER_LON"))
-                sscanf (tokenptr, "%lf", &ur_corner[1]);
-            else if (!strcmp (label, "CORNER_LL_LAT_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_LL_CORNER_LAT"))
-                sscanf (tokenptr, "%lf", &ll_corner[0]);
-            else if (!strcmp (label, "CORNER_LL_LON_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_LL_CORNER_LON"))
-                sscanf (tokenptr, "%lf", &ll_corner[1]);
-
-            else if (!strcmp (label, "CORNER_UL_PROJECTION_X_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_UL_CORNER_MAPX") ||
-                     !strcmp (label, "SCENE_UL_CORNER_MAPX"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.ul_corner[0]);
-            else if (!strcmp (label, "CORNER_UL_PROJECTION_Y_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_UL_CORNER_MAPY") ||
-                     !strcmp (label, "SCENE_UL_CORNER_MAPY"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.ul_corner[1]);
-            else if (!strcmp (label, "CORNER_LR_PROJECTION_X_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_LR_CORNER_MAPX") ||
-                     !strcmp (label, "SCENE_LR_CORNER_MAPX"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.lr_corner[0]);
-            else if (!strcmp (label, "CORNER_LR_PROJECTION_Y_PRODUCT") ||
-                     !strcmp (label, "PRODUCT_LR_CORNER_MAPY") ||
-                     !strcmp (label, "SCENE_LR_CORNER_MAPY"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.lr_corner[1]);
-
-            else if (!strcmp (label, "REFLECTIVE_SAMPLES") ||
-                     !strcmp (label, "PRODUCT_SAMPLES_REF"))
-                sscanf (tokenptr, "%d", &tmp_bmeta.nsamps);
-            else if (!strcmp (label, "REFLECTIVE_LINES") ||
-                     !strcmp (label, "PRODUCT_LINES_REF"))
-                sscanf (tokenptr, "%d", &tmp_bmeta.nlines);
-            else if (!strcmp (label, "THERMAL_SAMPLES") ||
-                     !strcmp (label, "PRODUCT_SAMPLES_THM"))
-                sscanf (tokenptr, "%d", &tmp_bmeta_th.nsamps);
-            else if (!strcmp (label, "THERMAL_LINES") ||
-                     !strcmp (label, "PRODUCT_LINES_THM"))
-                sscanf (tokenptr, "%d", &tmp_bmeta_th.nlines);
-            else if (!strcmp (label, "PANCHROMATIC_SAMPLES") ||
-                     !strcmp (label, "PRODUCT_SAMPLES_PAN"))
-                sscanf (tokenptr, "%d", &tmp_bmeta_pan.nsamps);
-            else if (!strcmp (label, "PANCHROMATIC_LINES") ||
-                     !strcmp (label, "PRODUCT_LINES_PAN"))
-                sscanf (tokenptr, "%d", &tmp_bmeta_pan.nlines);
-
-            else if (!strcmp (label, "MAP_PROJECTION"))
-            {
-                if (!strcmp (tokenptr, "UTM"))
+                break;
+
+            case MTL_SUN_ELEVATION:
+                if (sscanf (value, "%f", &fnum) == 1)
+                    gmeta->solar_zenith = 90.0 - fnum;
+                break;
+
+            case MTL_SUN_AZIMUTH:
+                sscanf (value, "%f", &gmeta->solar_azimuth);
+                break;
+
+            case MTL_EARTH_SUN_DIST:
+                sscanf (value, "%f", &gmeta->earth_sun_dist);
+                break;
+
+            case MTL_WRS_PATH:
+                sscanf (value, "%d", &gmeta->wrs_path);
+                break;
+
+            case MTL_WRS_ROW:
+                sscanf (value, "%d", &gmeta->wrs_row);
+                break;
+
+            case MTL_CORNER:
+                sscanf (value, "%lf", corner[index]);
+                break;
+
+            case MTL_PROJ_CORNER:
+                sscanf (value, "%lf", proj_corner[index]);
+                break;
+
+            case MTL_NSAMPS:
+                sscanf (value, "%d", &res_bmeta[index]->nsamps);
+                break;
+
+            case MTL_NLINES:
+                sscanf (value, "%d", &res_bmeta[index]->nlines);
+                break;
+
+            case MTL_PIXEL_SIZE:
+                sscanf (value, "%lf", &res_bmeta[index]->pixel_size[0]);
+                res_bmeta[index]->pixel_size[1] =
+                    res_bmeta[index]->pixel_size[0];
+                break;
+
+            case MTL_MAP_PROJECTION:
+                if (!strcmp (value, "UTM"))
                     gmeta->proj_info.proj_type = GCTP_UTM_PROJ;
-                else if (!strcmp (tokenptr, "PS"))
+                else if (!strcmp (value, "PS"))
                     gmeta->proj_info.proj_type = GCTP_PS_PROJ;
-                else if (!strcmp (tokenptr, "AEA"))  /* ALBERS */
+                else if (!strcmp (value, "AEA"))  /* ALBERS */
                     gmeta->proj_info.proj_type = GCTP_ALBERS_PROJ;
                 else
                 {
                     sprintf (errmsg, "Unsupported projection type: %s. "
                         "Only UTM, PS, and ALBERS EQUAL AREA are supported "
-                        "for LPGS.", tokenptr);
+                        "for LPGS.", value);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "DATUM") ||
-                     !strcmp (label, "REFERENCE_DATUM"))
-            {
-                if (!strcmp (tokenptr, "WGS84"))
+                break;
+
+            case MTL_DATUM:
+                if (!strcmp (value, "WGS84"))
                     gmeta->proj_info.datum_type = ESPA_WGS84;
                 else
                 {
-                    sprintf (errmsg, "Unexpected datum type: %s", tokenptr);
+                    sprintf (errmsg, "Unexpected datum type: %s", value);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
-            else if (!strcmp (label, "GRID_CELL_SIZE_REFLECTIVE") ||
-                     !strcmp (label, "GRID_CELL_SIZE_REF"))
-            {
-                sscanf (tokenptr, "%lf", &tmp_bmeta.pixel_size[0]);
-                tmp_bmeta.pixel_size[1] = tmp_bmeta.pixel_size[0];
-            }
-            else if (!strcmp (label, "GRID_CELL_SIZE_THERMAL") ||
-                     !strcmp (label, "GRID_CELL_SIZE_THM"))
-            {
-                sscanf (tokenptr, "%lf", &tmp_bmeta_th.pixel_size[0]);
-                tmp_bmeta_th.pixel_size[1] = tmp_bmeta_th.pixel_size[0];
-            }
-            else if (!strcmp (label, "GRID_CELL_SIZE_PANCHROMATIC") ||
-                     !strcmp (label, "GRID_CELL_SIZE_PAN"))
-            {
-                sscanf (tokenptr, "%lf", &tmp_bmeta_pan.pixel_size[0]);
-                tmp_bmeta_pan.pixel_size[1] = tmp_bmeta_pan.pixel_size[0];
-            }
-            else if (!strcmp (label, "UTM_ZONE") ||
-                     !strcmp (label, "ZONE_NUMBER"))
-            {
-                sscanf (tokenptr, "%d", &gmeta->proj_info.utm_zone);
-            }
+                break;
 
-            /* PS projection parameters */
-            else if (!strcmp (label, "VERTICAL_LON_FROM_POLE") ||
-                     !strcmp (label, "VERTICAL_LONGITUDE_FROM_POLE"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.longitude_pole);
-            else if (!strcmp (label, "TRUE_SCALE_LAT") ||
-                     !strcmp (label, "LATITUDE_OF_TRUE_SCALE"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.latitude_true_scale);
-            else if (!strcmp (label, "FALSE_EASTING"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.false_easting);
-            else if (!strcmp (label, "FALSE_NORTHING"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.false_northing);
-
-            /* ALBERS projection parameters (in addition to false easting and
-               northing under PS proj params) */
-            else if (!strcmp (label, "STANDARD_PARALLEL_1_LAT"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.standard_parallel1);
-            else if (!strcmp (label, "STANDARD_PARALLEL_2_LAT"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.standard_parallel2);
-            else if (!strcmp (label, "CENTRAL_MERIDIAN_LON"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.central_meridian);
-            else if (!strcmp (label, "ORIGIN_LAT"))
-                sscanf (tokenptr, "%lf", &gmeta->proj_info.origin_latitude);
-
-            else if (!strcmp (label, "RESAMPLING_OPTION"))
-            {
-                if (!strcmp (tokenptr, "CUBIC_CONVOLUTION"))
+            case MTL_UTM_ZONE:
+                sscanf (value, "%d", &gmeta->proj_info.utm_zone);
+                break;
+
+            case MTL_PROJ_PARAM:
+                sscanf (value, "%lf", proj_param[index]);
+                break;
+
+            case MTL_RESAMPLING:
+                if (!strcmp (value, "CUBIC_CONVOLUTION"))
                     tmp_bmeta.resample_method = ESPA_CC;
-                else if (!strcmp (tokenptr, "NEAREST_NEIGHBOR"))
+                else if (!strcmp (value, "NEAREST_NEIGHBOR"))
                     tmp_bmeta.resample_method = ESPA_NN;
-                else if (!strcmp (tokenptr, "BILINEAR"))
+                else if (!strcmp (value, "BILINEAR"))
                     tmp_bmeta.resample_method = ESPA_BI;
                 else
                 {
                     sprintf (errmsg, "Unsupported resampling option: %s",
-                        tokenptr);
+                        value);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-            }
+                break;
 
-            else if (!strcmp (label, "END"))
-            {
+            case MTL_END:
                 done_with_mtl = true;
                 break;
-            }
 
             /* Read the band names and identify band-specific metadata
                information */
-            else if (!strcmp (label, "FILE_NAME_BAND_1") ||
-                     !strcmp (label, "BAND1_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "1");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_2") ||
-                     !strcmp (label, "BAND2_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "2");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_3") ||
-                     !strcmp (label, "BAND3_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
+            case MTL_BAND_FILE:
+                /* Make sure we don't go over the maximum band count
+                   expected */
+                if (band_count >= MAX_LPGS_BANDS)
                 {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
+                    sprintf (errmsg, "The total band count of LPGS bands "
+                        "converted for this product (%d) exceeds the "
+                        "maximum expected (%d).", band_count + 1,
+                        MAX_LPGS_BANDS);
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "3");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_4") ||
-                     !strcmp (label, "BAND4_FILE_NAME"))
-            {
+
                 count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
+                    sizeof (band_fname[band_count]), "%s", value);
                 if (count < 0 || count >= sizeof (band_fname[band_count]))
                 {
                     sprintf (errmsg, "Overflow of band_fname[%d] string",
@@ -470,498 +852,65 @@ int read_lpgs_mtl
                     error_handler (true, FUNC_NAME, errmsg);
                     return (ERROR);
                 }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "4");
-                thermal[band_count] = false;
+                strcpy (category[band_count],
+                    lpgs_band_files[index].category);
+                strcpy (band_num[band_count],
+                    lpgs_band_files[index].band_num);
+                thermal[band_count] = lpgs_band_files[index].thermal ||
+                    (!strcmp (band_num[band_count], "6") &&
+                     !strcmp (gmeta->instrument, "TM"));  /* TM thermal */
                 band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_5") ||
-                     !strcmp (label, "BAND5_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
+                break;
+
+            /* Read the min and max pixel values, the radiance and
+               reflectance gains and biases, and the K1, K2 constants */
+            case MTL_QCAL_MIN:
+            case MTL_QCAL_MAX:
+            case MTL_RAD_GAIN:
+            case MTL_RAD_BIAS:
+            case MTL_REFL_GAIN:
+            case MTL_REFL_BIAS:
+            case MTL_K1:
+            case MTL_K2:
+                index = get_mtl_band_index (gmeta->instrument, index);
+                if (index < 0)
+                    break;
+
+                if (mtl_key->field == MTL_QCAL_MIN)
+                    sscanf (value, "%d", &band_min[index]);
+                else if (mtl_key->field == MTL_QCAL_MAX)
+                    sscanf (value, "%d", &band_max[index]);
+                else if (mtl_key->field == MTL_RAD_GAIN)
                 {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
+                    sscanf (value, "%f", &band_gain[index]);
+
+                    /* Assume that if gain value for band 1 is available,
+                       then the gain and bias values for all bands will be
+                       available */
+                    if (index == 0)
+                        gain_bias_available = true;
                 }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "5");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_6") ||
-                     !strcmp (label, "BAND6_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
+                else if (mtl_key->field == MTL_RAD_BIAS)
+                    sscanf (value, "%f", &band_bias[index]);
+                else if (mtl_key->field == MTL_REFL_GAIN)
                 {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
+                    sscanf (value, "%f", &refl_gain[index]);
+
+                    /* Assume that if the reflectance gain value for band 1
+                       is available, then the gain and bias values for all
+                       bands will be available */
+                    if (index == 0)
+                        refl_gain_bias_available = true;
                 }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "6");
-                if (!strcmp (gmeta->instrument, "TM"))
-                    thermal[band_count] = true;  /* TM thermal */
+                else if (mtl_key->field == MTL_REFL_BIAS)
+                    sscanf (value, "%f", &refl_bias[index]);
+                else if (mtl_key->field == MTL_K1)
+                    sscanf (value, "%f", &k1[index]);
                 else
-                    thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_7") ||
-                     !strcmp (label, "BAND7_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "7");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_8") ||
-                     !strcmp (label, "BAND8_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "8");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_6_VCID_1") ||
-                     !strcmp (label, "BAND61_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "61");
-                thermal[band_count] = true;  /* ETM+ thermal */
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_6_VCID_2") ||
-                     !strcmp (label, "BAND62_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "62");
-                thermal[band_count] = true;  /* ETM+ thermal */
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_9") ||
-                     !strcmp (label, "BAND9_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "9");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_10") ||
-                     !strcmp (label, "BAND10_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "10");
-                thermal[band_count] = true;  /* TIRS */
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_11") ||
-                     !strcmp (label, "BAND11_FILE_NAME"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "image");
-                strcpy (band_num[band_count], "11");
-                thermal[band_count] = true;  /* TIRS */
-                band_count++;  /* increment the band count */
-            }
-            else if (!strcmp (label, "FILE_NAME_BAND_QUALITY"))
-            {
-                count = snprintf (band_fname[band_count],
-                    sizeof (band_fname[band_count]), "%s", tokenptr);
-                if (count < 0 || count >= sizeof (band_fname[band_count]))
-                {
-                    sprintf (errmsg, "Overflow of band_fname[%d] string",
-                        band_count);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                strcpy (category[band_count], "qa");
-                strcpy (band_num[band_count], "bqa");
-                thermal[band_count] = false;
-                band_count++;  /* increment the band count */
-            }
-
-            /* Read the min pixel values */
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_1") ||
-                     !strcmp (label, "QCALMIN_BAND1"))
-                sscanf (tokenptr, "%d", &band_min[0]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_2") ||
-                     !strcmp (label, "QCALMIN_BAND2"))
-                sscanf (tokenptr, "%d", &band_min[1]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_3") ||
-                     !strcmp (label, "QCALMIN_BAND3"))
-                sscanf (tokenptr, "%d", &band_min[2]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_4") ||
-                     !strcmp (label, "QCALMIN_BAND4"))
-                sscanf (tokenptr, "%d", &band_min[3]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_5") ||
-                     !strcmp (label, "QCALMIN_BAND5"))
-                sscanf (tokenptr, "%d", &band_min[4]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_6") ||
-                     !strcmp (label, "QCALMIN_BAND6"))
-                sscanf (tokenptr, "%d", &band_min[5]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_7") ||
-                     !strcmp (label, "QCALMIN_BAND7"))
-            {
-                if (!strcmp (gmeta->instrument, "TM") ||
-                    !strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%d", &band_min[6]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%d", &band_min[7]);
-            }
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_8") ||
-                     !strcmp (label, "QCALMIN_BAND8"))
-            {
-                if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%d", &band_min[7]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%d", &band_min[8]);
-            }
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_6_VCID_1") ||
-                     !strcmp (label, "QCALMIN_BAND61"))
-                sscanf (tokenptr, "%d", &band_min[5]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_6_VCID_2") ||
-                     !strcmp (label, "QCALMIN_BAND62"))
-                sscanf (tokenptr, "%d", &band_min[6]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_9"))
-                sscanf (tokenptr, "%d", &band_min[8]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_10"))
-                sscanf (tokenptr, "%d", &band_min[9]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MIN_BAND_11"))
-                sscanf (tokenptr, "%d", &band_min[10]);
-
-            /* Read the max pixel values */
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_1") ||
-                     !strcmp (label, "QCALMAX_BAND1"))
-                sscanf (tokenptr, "%d", &band_max[0]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_2") ||
-                     !strcmp (label, "QCALMAX_BAND2"))
-                sscanf (tokenptr, "%d", &band_max[1]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_3") ||
-                     !strcmp (label, "QCALMAX_BAND3"))
-                sscanf (tokenptr, "%d", &band_max[2]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_4") ||
-                     !strcmp (label, "QCALMAX_BAND4"))
-                sscanf (tokenptr, "%d", &band_max[3]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_5") ||
-                     !strcmp (label, "QCALMAX_BAND5"))
-                sscanf (tokenptr, "%d", &band_max[4]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_6") ||
-                     !strcmp (label, "QCALMAX_BAND6"))
-                sscanf (tokenptr, "%d", &band_max[5]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_7") ||
-                     !strcmp (label, "QCALMAX_BAND7"))
-            {
-                if (!strcmp (gmeta->instrument, "TM") ||
-                    !strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%d", &band_max[6]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%d", &band_max[7]);
-            }
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_8") ||
-                     !strcmp (label, "QCALMAX_BAND8"))
-            {
-                if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%d", &band_max[7]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%d", &band_max[8]);
-            }
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_6_VCID_1") ||
-                     !strcmp (label, "QCALMAX_BAND61"))
-                sscanf (tokenptr, "%d", &band_max[5]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_6_VCID_2") ||
-                     !strcmp (label, "QCALMAX_BAND62"))
-                sscanf (tokenptr, "%d", &band_max[6]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_9"))
-                sscanf (tokenptr, "%d", &band_max[8]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_10"))
-                sscanf (tokenptr, "%d", &band_max[9]);
-            else if (!strcmp (label, "QUANTIZE_CAL_MAX_BAND_11"))
-                sscanf (tokenptr, "%d", &band_max[10]);
-
-            /* Read the radiance gains */
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_1"))
-            {
-                sscanf (tokenptr, "%f", &band_gain[0]);
-
-                /* Assume that if gain value for band 1 is available, then
-                   the gain and bias values for all bands will be available */
-                gain_bias_available = true;
-            }
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_2"))
-                sscanf (tokenptr, "%f", &band_gain[1]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_3"))
-                sscanf (tokenptr, "%f", &band_gain[2]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_4"))
-                sscanf (tokenptr, "%f", &band_gain[3]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_5"))
-                sscanf (tokenptr, "%f", &band_gain[4]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_6"))
-                sscanf (tokenptr, "%f", &band_gain[5]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_7"))
-            {
-                if (!strcmp (gmeta->instrument, "TM") ||
-                    !strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &band_gain[6]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &band_gain[7]);
-            }
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_8"))
-            {
-                if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &band_gain[7]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &band_gain[8]);
-            }
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_6_VCID_1"))
-                sscanf (tokenptr, "%f", &band_gain[5]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_6_VCID_2"))
-                sscanf (tokenptr, "%f", &band_gain[6]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_9"))
-                sscanf (tokenptr, "%f", &band_gain[8]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_10"))
-                sscanf (tokenptr, "%f", &band_gain[9]);
-            else if (!strcmp (label, "RADIANCE_MULT_BAND_11"))
-                sscanf (tokenptr, "%f", &band_gain[10]);
-
-            /* Read the radiance biases */
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_1"))
-                sscanf (tokenptr, "%f", &band_bias[0]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_2"))
-                sscanf (tokenptr, "%f", &band_bias[1]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_3"))
-                sscanf (tokenptr, "%f", &band_bias[2]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_4"))
-                sscanf (tokenptr, "%f", &band_bias[3]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_5"))
-                sscanf (tokenptr, "%f", &band_bias[4]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_6"))
-                sscanf (tokenptr, "%f", &band_bias[5]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_7"))
-            {
-                if (!strcmp (gmeta->instrument, "TM") ||
-                    !strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &band_bias[6]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &band_bias[7]);
-            }
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_8"))
-            {
-                if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &band_bias[7]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &band_bias[8]);
-            }
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_6_VCID_1"))
-                sscanf (tokenptr, "%f", &band_bias[5]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_6_VCID_2"))
-                sscanf (tokenptr, "%f", &band_bias[6]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_9"))
-                sscanf (tokenptr, "%f", &band_bias[8]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_10"))
-                sscanf (tokenptr, "%f", &band_bias[9]);
-            else if (!strcmp (label, "RADIANCE_ADD_BAND_11"))
-                sscanf (tokenptr, "%f", &band_bias[10]);
-
-            /* Read the reflectance gains */
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_1"))
-            {
-                sscanf (tokenptr, "%f", &refl_gain[0]);
-
-                /* Assume that if the reflectance gain value for band 1 is
-                   available, then the gain and bias values for all bands will
-                   be available */
-                refl_gain_bias_available = true;
-            }
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_2"))
-                sscanf (tokenptr, "%f", &refl_gain[1]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_3"))
-                sscanf (tokenptr, "%f", &refl_gain[2]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_4"))
-                sscanf (tokenptr, "%f", &refl_gain[3]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_5"))
-                sscanf (tokenptr, "%f", &refl_gain[4]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_6"))
-                sscanf (tokenptr, "%f", &refl_gain[5]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_7"))
-            {
-                if (!strcmp (gmeta->instrument, "TM") ||
-                    !strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &refl_gain[6]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &refl_gain[7]);
-            }
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_8"))
-            {
-                if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &refl_gain[7]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &refl_gain[8]);
-            }
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_6_VCID_1"))
-                sscanf (tokenptr, "%f", &refl_gain[5]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_6_VCID_2"))
-                sscanf (tokenptr, "%f", &refl_gain[6]);
-            else if (!strcmp (label, "REFLECTANCE_MULT_BAND_9"))
-                sscanf (tokenptr, "%f", &refl_gain[8]);
-
-            /* Read the reflectance biases */
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_1"))
-                sscanf (tokenptr, "%f", &refl_bias[0]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_2"))
-                sscanf (tokenptr, "%f", &refl_bias[1]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_3"))
-                sscanf (tokenptr, "%f", &refl_bias[2]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_4"))
-                sscanf (tokenptr, "%f", &refl_bias[3]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_5"))
-                sscanf (tokenptr, "%f", &refl_bias[4]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_6"))
-                sscanf (tokenptr, "%f", &refl_bias[5]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_7"))
-            {
-                if (!strcmp (gmeta->instrument, "TM") ||
-                    !strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &refl_bias[6]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &refl_bias[7]);
-            }
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_8"))
-            {
-                if (!strcmp (gmeta->instrument, "OLI_TIRS") ||
-                    !strcmp (gmeta->instrument, "OLI"))
-                    sscanf (tokenptr, "%f", &refl_bias[7]);
-                else if (!strncmp (gmeta->instrument, "ETM", 3))
-                    sscanf (tokenptr, "%f", &refl_bias[8]);
-            }
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_6_VCID_1"))
-                sscanf (tokenptr, "%f", &refl_bias[5]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_6_VCID_2"))
-                sscanf (tokenptr, "%f", &refl_bias[6]);
-            else if (!strcmp (label, "REFLECTANCE_ADD_BAND_9"))
-                sscanf (tokenptr, "%f", &refl_bias[8]);
-
-            /* Read the K1, K2 constants */
-            /* TIRS */
-            else if (!strcmp (label, "K1_CONSTANT_BAND_10"))
-                sscanf (tokenptr, "%f", &k1[9]);
-            else if (!strcmp (label, "K1_CONSTANT_BAND_11"))
-                sscanf (tokenptr, "%f", &k1[10]);
-            else if (!strcmp (label, "K2_CONSTANT_BAND_10"))
-                sscanf (tokenptr, "%f", &k2[9]);
-            else if (!strcmp (label, "K2_CONSTANT_BAND_11"))
-                sscanf (tokenptr, "%f", &k2[10]);
-
-            /* ETM+ */
-            else if (!strcmp (label, "K1_CONSTANT_BAND_6_VCID_1"))
-                sscanf (tokenptr, "%f", &k1[5]);
-            else if (!strcmp (label, "K1_CONSTANT_BAND_6_VCID_2"))
-                sscanf (tokenptr, "%f", &k1[6]);
-            else if (!strcmp (label, "K2_CONSTANT_BAND_6_VCID_1"))
-                sscanf (tokenptr, "%f", &k2[5]);
-            else if (!strcmp (label, "K2_CONSTANT_BAND_6_VCID_2"))
-                sscanf (tokenptr, "%f", &k2[6]);
-
-            /* TM */
-            else if (!strcmp (label, "K1_CONSTANT_BAND_6"))
-                sscanf (tokenptr, "%f", &k1[5]);
-            else if (!strcmp (label, "K2_CONSTANT_BAND_6"))
-                sscanf (tokenptr, "%f", &k2[5]);
-        } /* end if tokenptr */
-
-        /* If we are done */
-        if (done_with_mtl)
-            break;
-    }  /* end while fgets */
-
-    /* Check the band count to make sure we didn't go over the maximum
-       expected */
-    if (band_count > MAX_LPGS_BANDS)
-    {
-        sprintf (errmsg, "The total band count of LPGS bands converted for "
-            "this product (%d) exceeds the maximum expected (%d).", band_count,
-            MAX_LPGS_BANDS);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+                    sscanf (value, "%f", &k2[index]);
+                break;
+        }
+    }  /* end while next_mtl_line */
 
     /* Set defaults that aren't in the MTL file */
     gmeta->wrs_system = 2;
@@ -1278,9 +1227,6 @@ int read_lpgs_mtl
         }
     }
 
-    /* Close the metadata file */
-    fclose (mtl_fptr);
-
     /* Get geolocation information from the XML file to prepare for computing
        the bounding coordinates */
     if (!get_geoloc_info (metadata, &geoloc_def))
@@ -1328,250 +1274,1152 @@ int read_lpgs_mtl
 
 
 /******************************************************************************
-MODULE:  convert_gtif_to_img
+MODULE:  read_lpgs_mtl
 
-PURPOSE: Convert the LPGS GeoTIFF band to ESPA raw binary (.img) file and
-writes the associated ENVI header for each band.
+PURPOSE: Read the LPGS MTL metadata file and populate the ESPA internal
+metadata structure
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting the GeoTIFF file
-SUCCESS         Successfully converterd GeoTIFF to raw binary
+ERROR           Error reading the metadata file
+SUCCESS         Successfully populated the ESPA metadata structure
 
 NOTES:
-1. TIFF read scanline only supports reading a single line at a time.  We will
-   read a single line, stuff it into a large buffer, then write the entire
-   image at one time.  This is about 40% faster than reading a single line
-   then writing a single line.
+1. See parse_lpgs_mtl for the details of the metadata.
+2. The MTL file is read into memory with a single read and parsed from
+   there.
 ******************************************************************************/
-int convert_gtif_to_img
+int read_lpgs_mtl
 (
-    char *gtif_file,           /* I: name of the input GeoTIFF file */
-    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
-    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+    char *mtl_file,                  /* I: name of the MTL metadata file to
+                                           be read */
+    Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
+                                           populated from the MTL file */
+    int *nlpgs_bands,                /* O: number of bands in LPGS product */
+    char lpgs_bands[][STR_SIZE]      /* O: array containing the filenames of
+                                           the LPGS bands */
 )
 {
-    char FUNC_NAME[] = "convert_gtif_to_img";  /* function name */
+    char FUNC_NAME[] = "read_lpgs_mtl";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    char *cptr = NULL;        /* pointer to the file extension */
-    char *img_file = NULL;    /* name of the output raw binary file */
-    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
-    int i;                    /* looping variable for lines in image */
-    int nbytes;               /* number of bytes in the data type */
-    int count;                /* number of chars copied in snprintf */
-    void *file_buf = NULL;    /* pointer to correct input file buffer */
-    uint8 *file_buf_u8 = NULL;  /* buffer for uint8 TIFF data to be read */
-    int16 *file_buf_i16 = NULL; /* buffer for int16 TIFF data to be read */
-    int16 *file_buf_u16 = NULL; /* buffer for uint16 TIFF data to be read */
-    TIFF *fp_tiff = NULL;     /* file pointer for the TIFF file */
-    FILE *fp_rb = NULL;       /* file pointer for the raw binary file */
-    Envi_header_t envi_hdr;   /* output ENVI header information */
-
-    /* Open the TIFF file for reading */
-    fp_tiff = XTIFFOpen (gtif_file, "r");
-    if (fp_tiff == NULL)
-    {
-        sprintf (errmsg, "Opening the LPGS GeoTIFF file: %s", gtif_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Open the raw binary file for writing */
-    img_file = bmeta->file_name;
-    fp_rb = open_raw_binary (img_file, "wb");
-    if (fp_rb == NULL)
-    {
-        sprintf (errmsg, "Opening the output raw binary file: %s", img_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    FILE *mtl_fptr=NULL;      /* file pointer to the MTL metadata file */
+    char *mtl_buf = NULL;     /* contents of the MTL file */
+    long mtl_size;            /* size of the MTL file (bytes) */
+    int status;               /* return status */
 
-    /* Allocate memory for the entire image, based on the input data type */
-    if (bmeta->data_type == ESPA_UINT8)
-    {
-        nbytes = sizeof (uint8);
-        file_buf_u8 = calloc (bmeta->nlines * bmeta->nsamps, nbytes);
-        if (file_buf_u8 == NULL)
-        {
-            sprintf (errmsg, "Allocating memory for the image of uint8 data "
-                "containing %d lines x %d samples.", bmeta->nlines,
-                bmeta->nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        file_buf = file_buf_u8;
-    }
-    else if (bmeta->data_type == ESPA_INT16)
-    {
-        nbytes = sizeof (int16);
-        file_buf_i16 = calloc (bmeta->nlines * bmeta->nsamps, nbytes);
-        if (file_buf_i16 == NULL)
-        {
-            sprintf (errmsg, "Allocating memory for the image of int16 data "
-                "containing %d lines x %d samples.", bmeta->nlines,
-                bmeta->nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        file_buf = file_buf_i16;
-    }
-    else if (bmeta->data_type == ESPA_UINT16)
-    {
-        nbytes = sizeof (uint16);
-        file_buf_u16 = calloc (bmeta->nlines * bmeta->nsamps, nbytes);
-        if (file_buf_u16 == NULL)
-        {
-            sprintf (errmsg, "Allocating memory for the image of uint16 data "
-                "containing %d lines x %d samples.", bmeta->nlines,
-                bmeta->nsamps);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        file_buf = file_buf_u16;
-    }
-    else
+    /* Open the metadata MTL file with read privelages */
+    mtl_fptr = fopen (mtl_file, "r");
+    if (mtl_fptr == NULL)
     {
-        sprintf (errmsg, "Unsupported data type.  Currently only uint8, "
-            "int16, and uint16 are supported.");
+        sprintf (errmsg, "Opening %s for read access.", mtl_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Loop through the lines in the TIFF file, reading and stuffing in the
-       image buffer */
-    if (bmeta->data_type == ESPA_UINT8)
-    {
-        for (i = 0; i < bmeta->nlines; i++)
-        {
-            /* Read current line from the TIFF file */
-            if (!TIFFReadScanline (fp_tiff, &file_buf_u8[i*bmeta->nsamps],
-                i, 0))
-            {
-                sprintf (errmsg, "Reading line %d from the TIFF file: %s", i,
-                    gtif_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-    }
-    else if (bmeta->data_type == ESPA_INT16)
-    {
-        for (i = 0; i < bmeta->nlines; i++)
-        {
-            /* Read current line from the TIFF file */
-            if (!TIFFReadScanline (fp_tiff, &file_buf_i16[i*bmeta->nsamps],
-                i, 0))
-            {
-                sprintf (errmsg, "Reading line %d from the TIFF file: %s", i,
-                    gtif_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-    }
-    else if (bmeta->data_type == ESPA_UINT16)
-    {
-        for (i = 0; i < bmeta->nlines; i++)
-        {
-            /* Read current line from the TIFF file */
-            if (!TIFFReadScanline (fp_tiff, &file_buf_u16[i*bmeta->nsamps],
-                i, 0))
-            {
-                sprintf (errmsg, "Reading line %d from the TIFF file: %s", i,
-                    gtif_file);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-    }
-
-    /* Write entire image to the raw binary file */
-    if (write_raw_binary (fp_rb, bmeta->nlines, bmeta->nsamps, nbytes,
-        file_buf) != SUCCESS)
+    /* Read the whole file, NUL terminated for parsing */
+    if (fseek (mtl_fptr, 0, SEEK_END) != 0 ||
+        (mtl_size = ftell (mtl_fptr)) < 0 || fseek (mtl_fptr, 0, SEEK_SET))
     {
-        sprintf (errmsg, "Writing image to the raw binary file: %s", img_file);
+        sprintf (errmsg, "Getting the size of %s", mtl_file);
         error_handler (true, FUNC_NAME, errmsg);
+        fclose (mtl_fptr);
         return (ERROR);
     }
 
-    /* Close the TIFF and raw binary files */
-    XTIFFClose (fp_tiff);
-    close_raw_binary (fp_rb);
-
-    /* Free the memory */
-    free (file_buf_u8);
-    free (file_buf_i16);
-    free (file_buf_u16);
-
-    /* Create the ENVI header file this band */
-    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    mtl_buf = malloc (mtl_size + 1);
+    if (mtl_buf == NULL)
     {
-        sprintf (errmsg, "Creating the ENVI header structure for this file.");
+        sprintf (errmsg, "Allocating %ld bytes for %s", mtl_size + 1,
+            mtl_file);
         error_handler (true, FUNC_NAME, errmsg);
+        fclose (mtl_fptr);
         return (ERROR);
     }
 
-    /* Write the ENVI header */
-    count = snprintf (envi_file, sizeof (envi_file), "%s", img_file);
-    if (count < 0 || count >= sizeof (envi_file))
+    if (fread (mtl_buf, 1, mtl_size, mtl_fptr) != mtl_size)
     {
-        sprintf (errmsg, "Overflow of envi_file string");
+        sprintf (errmsg, "Reading %s", mtl_file);
         error_handler (true, FUNC_NAME, errmsg);
+        fclose (mtl_fptr);
+        free (mtl_buf);
         return (ERROR);
     }
-    cptr = strchr (envi_file, '.');
-    strcpy (cptr, ".hdr");
+    mtl_buf[mtl_size] = '\0';
+    fclose (mtl_fptr);
 
-    if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    status = parse_lpgs_mtl (mtl_buf, mtl_file, metadata, nlpgs_bands,
+        lpgs_bands);
+    free (mtl_buf);
 
-    /* Successful conversion */
-    return (SUCCESS);
+    return (status);
 }
 
 
 /******************************************************************************
-MODULE:  convert_lpgs_to_espa
+MODULE:  read_lpgs_mtl_buffer
 
-PURPOSE: Converts the input LPGS GeoTIFF files (and associated MTL file) to
-the ESPA internal raw binary file format (and associated XML file).
+PURPOSE: Read the LPGS MTL metadata from memory (such as an MTL file read
+from a product bundle) and populate the ESPA internal metadata structure
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error converting the GeoTIFF file
-SUCCESS         Successfully converted GeoTIFF to raw binary
+ERROR           Error reading the metadata
+SUCCESS         Successfully populated the ESPA metadata structure
 
 NOTES:
-  1. The LPGS GeoTIFF band files will be deciphered from the LPGS MTL file.
-  2. The ESPA raw binary band files will be generated from the ESPA XML
-     filename.
+1. See parse_lpgs_mtl for the details of the metadata.
+2. The metadata is tokenized in place, so the buffer is modified.  It must
+   have room for a NUL after the last byte of the MTL file, as the members
+   read by read_lpgs_bundle_member do.
 ******************************************************************************/
-int convert_lpgs_to_espa
+int read_lpgs_mtl_buffer
 (
-    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
-    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
-                                 conversion? */
-)
-{
-    char FUNC_NAME[] = "convert_lpgs_to_espa";  /* function name */
+    char *mtl_file,                  /* I: name of the MTL metadata file,
+                                           written to the XML metadata */
+    char *mtl_buf,                   /* I/O: contents of the MTL file */
+    size_t mtl_size,                 /* I: size of the MTL file (bytes) */
+    Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
+                                           populated from the MTL file */
+    int *nlpgs_bands,                /* O: number of bands in LPGS product */
+    char lpgs_bands[][STR_SIZE]      /* O: array containing the filenames of
+                                           the LPGS bands */
+)
+{
+    mtl_buf[mtl_size] = '\0';
+    return (parse_lpgs_mtl (mtl_buf, mtl_file, metadata, nlpgs_bands,
+        lpgs_bands));
+}
+
+
+/* Reader for the strips or tiles of an LPGS GeoTIFF band */
+typedef struct
+{
+    TIFF **fp_tiff;           /* handles for the GeoTIFF, one per decoding
+                                 thread, each with its own codec state */
+    int ntiff;                /* number of handles */
+    bool tiled;               /* is the GeoTIFF tiled? */
+    bool scanlines;           /* read with TIFFReadScanline? */
+    int nlines;               /* number of lines in the band */
+    int nsamps;               /* number of samples in the band */
+    int nbytes;               /* number of bytes per pixel */
+    uint32 unit_width;        /* width of a tile; or the band for strips */
+    uint32 unit_lines;        /* lines in a tile or strip */
+    tmsize_t unit_size;       /* decoded size of a tile (bytes) */
+    uint8 *unit_buf;          /* tile buffer for each handle */
+} Lpgs_tiff_reader_t;
+
+/* Block of strips or tiles decoded by read_lpgs_tiff_block */
+typedef struct
+{
+    Lpgs_tiff_reader_t *reader;  /* reader for the GeoTIFF band */
+    char *gtif_file;          /* name of the input GeoTIFF file */
+    int line;                 /* first line of the block */
+    int nblock_lines;         /* number of lines in the block */
+    int ntiles_across;        /* number of tiles across the band */
+    uint8 *file_buf;          /* block of lines from the GeoTIFF */
+} Lpgs_tiff_block_t;
+
+
+/******************************************************************************
+MODULE:  init_lpgs_tiff_reader
+
+PURPOSE: Determines the strip or tile organization of the GeoTIFF band and
+sets up the reader for it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The GeoTIFF doesn't match the band or can't be read
+SUCCESS         Successful completion
+
+NOTES:
+  1. block_lines is a multiple of the strip or tile length, so each
+     strip or tile is decoded only once.  It's at least LPGS_LINE_BLOCK
+     lines, and more if the strips or tiles are longer than that.
+  2. Uncompressed strips longer than LPGS_LINE_BLOCK (such as a single strip
+     for the whole band) are read a scanline at a time, to keep the memory
+     bounded by the line block.
+  3. With a memory budget (see espa_memory.h), the block is shrunk to the
+     whole strips or tiles (or scanlines) which fit in it, and tiles are
+     decoded by fewer threads if their tile buffers don't fit.
+******************************************************************************/
+static int init_lpgs_tiff_reader
+(
+    TIFF **fp_tiff,            /* I: handles for the GeoTIFF band */
+    int ntiff,                 /* I: number of handles */
+    char *gtif_file,           /* I: name of the input GeoTIFF file */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    int nbytes,                /* I: number of bytes per pixel */
+    Lpgs_tiff_reader_t *reader,  /* O: reader for the GeoTIFF band */
+    int *block_lines           /* O: number of lines to read at a time */
+)
+{
+    char FUNC_NAME[] = "init_lpgs_tiff_reader";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    uint32 width;             /* width of the GeoTIFF */
+    uint32 length;            /* length of the GeoTIFF */
+    uint16 bits_per_sample;   /* bits per sample of the GeoTIFF */
+    uint16 samples_per_pixel; /* samples per pixel of the GeoTIFF */
+    uint16 compression;       /* compression of the GeoTIFF */
+    size_t unit_row_bytes;    /* bytes in a row of strips or tiles */
+    size_t tile_bytes = 0;    /* bytes of the tile buffers */
+
+    memset (reader, 0, sizeof (Lpgs_tiff_reader_t));
+    reader->fp_tiff = fp_tiff;
+    reader->ntiff = ntiff;
+    reader->nlines = bmeta->nlines;
+    reader->nsamps = bmeta->nsamps;
+    reader->nbytes = nbytes;
+
+    /* Make sure the GeoTIFF matches the band metadata */
+    TIFFGetField (fp_tiff[0], TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField (fp_tiff[0], TIFFTAG_IMAGELENGTH, &length);
+    TIFFGetFieldDefaulted (fp_tiff[0], TIFFTAG_BITSPERSAMPLE,
+        &bits_per_sample);
+    TIFFGetFieldDefaulted (fp_tiff[0], TIFFTAG_SAMPLESPERPIXEL,
+        &samples_per_pixel);
+    TIFFGetFieldDefaulted (fp_tiff[0], TIFFTAG_COMPRESSION, &compression);
+    if (width != bmeta->nsamps || length != bmeta->nlines ||
+        bits_per_sample != nbytes * 8 || samples_per_pixel != 1)
+    {
+        sprintf (errmsg, "%s is %u x %u with %u %u-bit samples per pixel; "
+            "expected %d x %d with 1 %d-bit sample", gtif_file, width,
+            length, samples_per_pixel, bits_per_sample, bmeta->nsamps,
+            bmeta->nlines, nbytes * 8);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Determine the tile or strip size */
+    reader->tiled = TIFFIsTiled (fp_tiff[0]);
+    if (reader->tiled)
+    {
+        TIFFGetField (fp_tiff[0], TIFFTAG_TILEWIDTH, &reader->unit_width);
+        TIFFGetField (fp_tiff[0], TIFFTAG_TILELENGTH, &reader->unit_lines);
+        reader->unit_size = TIFFTileSize (fp_tiff[0]);
+    }
+    else
+    {
+        reader->unit_width = width;
+        TIFFGetFieldDefaulted (fp_tiff[0], TIFFTAG_ROWSPERSTRIP,
+            &reader->unit_lines);
+        if (reader->unit_lines > length)
+            reader->unit_lines = length;
+        reader->scanlines = compression == COMPRESSION_NONE &&
+            reader->unit_lines > LPGS_LINE_BLOCK;
+    }
+    if (reader->unit_width == 0 || reader->unit_lines == 0)
+    {
+        sprintf (errmsg, "Invalid tile or strip size in %s", gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Fit the tile buffers and the line block in the memory budget, if
+       there is one */
+    unit_row_bytes = (size_t) reader->unit_lines * width * nbytes;
+    if (reader->tiled)
+    {
+        reader->ntiff = espa_budget_threads (reader->unit_size,
+            unit_row_bytes, ntiff);
+        tile_bytes = (size_t) reader->ntiff * reader->unit_size;
+    }
+    if (reader->scanlines)
+        *block_lines = espa_budget_lines ((size_t) width * nbytes, 0,
+            LPGS_LINE_BLOCK);
+    else
+        *block_lines = espa_budget_lines (unit_row_bytes, tile_bytes,
+            (LPGS_LINE_BLOCK + reader->unit_lines - 1) / reader->unit_lines)
+            * reader->unit_lines;
+
+    /* Tiles are decoded into a buffer for each handle and then copied to
+       the line block; strips are decoded in place */
+    if (reader->tiled)
+    {
+        reader->unit_buf = malloc (tile_bytes);
+        if (reader->unit_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the tiles of %s",
+                gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  decode_lpgs_tiff_units
+
+PURPOSE: Decodes a range of the strips or tiles of a block into the block
+buffer.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error decoding the GeoTIFF
+SUCCESS         Successful completion
+
+NOTES:
+  1. Called by espa_parallel_for; the runner number selects the handle and
+     tile buffer, so no two threads use the same handle at once.
+******************************************************************************/
+static int decode_lpgs_tiff_units
+(
+    void *arg,                 /* I: block being decoded (Lpgs_tiff_block_t) */
+    int first,                 /* I: first strip or tile of the range */
+    int end,                   /* I: strip or tile after the range */
+    int runner                 /* I: number of the decoding thread */
+)
+{
+    char FUNC_NAME[] = "decode_lpgs_tiff_units";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Lpgs_tiff_block_t *block = arg;  /* block being decoded */
+    Lpgs_tiff_reader_t *reader = block->reader;  /* reader for the band */
+    TIFF *fp_tiff = reader->fp_tiff[runner];  /* handle of this thread */
+    int line = block->line;   /* first line of the block */
+    int i;                    /* looping variable for lines */
+    int job;                  /* current strip or tile in the block */
+    int x, y;                 /* sample and line of the strip or tile */
+    int ncopy_lines;          /* lines of the tile in the block */
+    int ncopy_samps;          /* samples of the tile in the band */
+    size_t line_size;         /* bytes in a line of the band */
+    uint8 *unit_buf = NULL;   /* tile buffer for this thread */
+
+    line_size = (size_t) reader->nsamps * reader->nbytes;
+    for (job = first; job < end; job++)
+    {
+        if (!reader->tiled)
+        {
+            /* Decode the strip directly into the block */
+            y = line + job * reader->unit_lines;
+            ncopy_lines = reader->unit_lines;
+            if (y + ncopy_lines > line + block->nblock_lines)
+                ncopy_lines = line + block->nblock_lines - y;
+            if (TIFFReadEncodedStrip (fp_tiff, TIFFComputeStrip (fp_tiff, y,
+                0), &block->file_buf[(y - line) * line_size],
+                (tmsize_t) ncopy_lines * line_size) < 0)
+            {
+                sprintf (errmsg, "Decoding the strip at line %d of the TIFF "
+                    "file: %s", y, block->gtif_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            continue;
+        }
+
+        /* Decode the tile and copy the part within the band to the block */
+        unit_buf = &reader->unit_buf[runner * reader->unit_size];
+        y = line + (job / block->ntiles_across) * reader->unit_lines;
+        x = (job % block->ntiles_across) * reader->unit_width;
+        if (TIFFReadEncodedTile (fp_tiff, TIFFComputeTile (fp_tiff, x, y, 0,
+            0), unit_buf, reader->unit_size) < 0)
+        {
+            sprintf (errmsg, "Decoding the tile at line %d, sample %d of the "
+                "TIFF file: %s", y, x, block->gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        ncopy_lines = reader->unit_lines;
+        if (y + ncopy_lines > line + block->nblock_lines)
+            ncopy_lines = line + block->nblock_lines - y;
+        ncopy_samps = reader->unit_width;
+        if (x + ncopy_samps > reader->nsamps)
+            ncopy_samps = reader->nsamps - x;
+        for (i = 0; i < ncopy_lines; i++)
+            memcpy (&block->file_buf[(y - line + i) * line_size + (size_t) x *
+                reader->nbytes], &unit_buf[(size_t) i * reader->unit_width *
+                reader->nbytes], (size_t) ncopy_samps * reader->nbytes);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_lpgs_tiff_block
+
+PURPOSE: Reads a block of lines from the GeoTIFF band, decoding the strips or
+tiles of the block in parallel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error decoding the GeoTIFF
+SUCCESS         Successful completion
+
+NOTES:
+  1. The strips and tiles are independent, so each decoding thread decodes
+     them with its own handle for the GeoTIFF.  The block starts on a strip
+     or tile boundary.
+******************************************************************************/
+static int read_lpgs_tiff_block
+(
+    Lpgs_tiff_reader_t *reader,  /* I: reader for the GeoTIFF band */
+    char *gtif_file,           /* I: name of the input GeoTIFF file */
+    int line,                  /* I: first line of the block */
+    int nblock_lines,          /* I: number of lines in the block */
+    uint8 *file_buf            /* O: block of lines from the GeoTIFF */
+)
+{
+    char FUNC_NAME[] = "read_lpgs_tiff_block";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for lines */
+    int njobs;                /* number of strips or tiles in the block */
+    int nunit_rows;           /* number of strip or tile rows in the block */
+    size_t line_size;         /* bytes in a line of the band */
+    Lpgs_tiff_block_t block;  /* block being decoded */
+
+    line_size = (size_t) reader->nsamps * reader->nbytes;
+
+    /* Scanlines are only read sequentially */
+    if (reader->scanlines)
+    {
+        for (i = 0; i < nblock_lines; i++)
+        {
+            if (TIFFReadScanline (reader->fp_tiff[0], &file_buf[i *
+                line_size], line + i, 0) < 0)
+            {
+                sprintf (errmsg, "Reading line %d from the TIFF file: %s",
+                    line + i, gtif_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        return (SUCCESS);
+    }
+
+    block.reader = reader;
+    block.gtif_file = gtif_file;
+    block.line = line;
+    block.nblock_lines = nblock_lines;
+    block.ntiles_across = (reader->nsamps + reader->unit_width - 1) /
+        reader->unit_width;
+    block.file_buf = file_buf;
+
+    nunit_rows = (nblock_lines + reader->unit_lines - 1) / reader->unit_lines;
+    njobs = reader->tiled ? nunit_rows * block.ntiles_across : nunit_rows;
+
+    return (espa_parallel_for (0, njobs, 1, reader->ntiff,
+        decode_lpgs_tiff_units, &block));
+}
+
+
+/******************************************************************************
+MODULE:  convert_tiff_to_img
+
+PURPOSE: Convert the open LPGS GeoTIFF band to ESPA raw binary (.img) file and
+writes the associated ENVI header for each band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converterd GeoTIFF to raw binary
+
+NOTES:
+1. The GeoTIFF is read a block of lines at a time (LPGS_LINE_BLOCK lines,
+   rounded up to whole strips or tiles), then the entire block is written at
+   one time.  This keeps most of the speed of writing the whole image at
+   once, while bounding the memory to the size of the line block rather than
+   the size of the band.
+2. Stripped and tiled GeoTIFFs, compressed or not, are supported.  The strips
+   or tiles of each block are decoded in parallel, one thread per handle in
+   fp_tiff.  All the handles need to be open on the same GeoTIFF.
+3. The page cache handling of the raw binary file is selected via the
+   ESPA_WRITE_CACHE environment variable (see get_raw_binary_cache_mode).
+   The block buffer is aligned so that O_DIRECT writes don't need copying,
+   and comes from the buffer pool so the bands reuse the same block.
+4. When ESPA_PERCENT_COVER is yes, the percent coverage of the bits of the
+   QA band is computed while it's written (see raw_binary_cover.h).
+5. The TIFF files are left open for the caller to close.
+6. If the band is scaled (see espa_ingest_scale.h), the digital numbers of
+   scale->in_type are decoded and each block is scaled to the data type of
+   bmeta as it's written.
+7. If hdr_batch is specified, the ENVI header is added to it rather than
+   written, and it's up to the caller to flush the batch once all the bands
+   are converted.
+******************************************************************************/
+int convert_tiff_to_img
+(
+    TIFF **fp_tiff,            /* I: handles for the GeoTIFF band opened for
+                                     reading, one per decoding thread */
+    int ntiff,                 /* I: number of handles (at least 1) */
+    char *gtif_file,           /* I: name of the input GeoTIFF file */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    const Ingest_band_scale_t *scale, /* I: scaling of the band; NULL to
+                                     write the digital numbers */
+    Envi_hdr_batch_t *hdr_batch, /* I/O: batch the ENVI header is added to;
+                                     NULL to write the header right away */
+    int hdr_slot               /* I: slot of the ENVI header in hdr_batch */
+)
+{
+    char FUNC_NAME[] = "convert_tiff_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    char *img_file = NULL;    /* name of the output raw binary file */
+    char envi_file[STR_SIZE]; /* name of the output ENVI header file */
+    int line;                 /* starting line of the current block */
+    int block_lines;          /* number of lines read at a time */
+    int nblock_lines;         /* number of lines in the current block */
+    int nbytes;               /* number of bytes in the data type */
+    int out_nbytes;           /* number of bytes in the data type written */
+    int count;                /* number of chars copied in snprintf */
+    int status = SUCCESS;     /* return status */
+    bool rb_open = false;     /* is the raw binary file open? */
+    enum Espa_data_type in_type;  /* data type of the TIFF pixels */
+    uint8 *file_buf = NULL;   /* buffer for a block of TIFF lines, sized
+                                 based on the data type */
+    uint8 *out_buf = NULL;    /* buffer for a block of scaled lines; the
+                                 block buffer if the band isn't scaled */
+    Lpgs_tiff_reader_t reader;  /* reader for the GeoTIFF strips or tiles */
+    Raw_binary_writer_t rbw;  /* writer for the raw binary file */
+    Envi_header_t envi_hdr;   /* output ENVI header information */
+
+    memset (&reader, 0, sizeof (reader));
+
+    /* Determine the number of bytes for the input data type */
+    in_type = (scale != NULL) ? scale->in_type : bmeta->data_type;
+    if (in_type == ESPA_UINT8)
+        nbytes = sizeof (uint8);
+    else if (in_type == ESPA_INT16)
+        nbytes = sizeof (int16);
+    else if (in_type == ESPA_UINT16)
+        nbytes = sizeof (uint16);
+    else
+    {
+        sprintf (errmsg, "Unsupported data type.  Currently only uint8, "
+            "int16, and uint16 are supported.");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Set up the reader for the strips or tiles */
+    if (init_lpgs_tiff_reader (fp_tiff, ntiff, gtif_file, bmeta, nbytes,
+        &reader, &block_lines) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the reader for the TIFF file: %s",
+            gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Open the raw binary file for writing */
+    img_file = bmeta->file_name;
+    if (open_raw_binary_writer (img_file, get_raw_binary_cache_mode (),
+        RB_CODEC_NONE, &rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the output raw binary file: %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+    rb_open = true;
+
+    /* Compute the percent coverage of the QA bits as the band is written */
+    if (use_raw_binary_cover () && attach_raw_binary_cover (&rbw, bmeta) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Computing the percent coverage of the raw binary "
+            "file: %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Write the blocks while the next ones are decoded */
+    if (start_raw_binary_writer_background (&rbw,
+        RB_WRITER_BACKGROUND_BUFFERS) != SUCCESS)
+    {
+        sprintf (errmsg, "Starting the writes to the raw binary file: %s",
+            img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Allocate memory for a block of lines, based on the input data type */
+    file_buf = get_raw_binary_buffer ((size_t) block_lines *
+        bmeta->nsamps * nbytes, true);
+    if (file_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a block of %d lines x %d "
+            "samples.", block_lines, bmeta->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Allocate memory for a block of the scaled values */
+    out_buf = file_buf;
+    out_nbytes = nbytes;
+    if (scale != NULL)
+    {
+        out_nbytes = scale->out_nbytes;
+        out_buf = get_raw_binary_buffer ((size_t) block_lines *
+            bmeta->nsamps * out_nbytes, true);
+        if (out_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for a block of %d scaled "
+                "lines x %d samples.", block_lines, bmeta->nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    /* Loop through the lines in the TIFF file a block at a time, decoding
+       the strips or tiles into the block buffer, then writing the block to
+       the raw binary file */
+    for (line = 0; line < bmeta->nlines; line += block_lines)
+    {
+        nblock_lines = block_lines;
+        if (line + nblock_lines > bmeta->nlines)
+            nblock_lines = bmeta->nlines - line;
+
+        if (read_lpgs_tiff_block (&reader, gtif_file, line, nblock_lines,
+            file_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d from the TIFF file: %s",
+                line, line + nblock_lines - 1, gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+
+        /* Scale the digital numbers to the values written */
+        if (scale != NULL && apply_ingest_scale (scale, file_buf,
+            (size_t) nblock_lines * bmeta->nsamps, out_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Scaling lines %d-%d of the TIFF file: %s",
+                line, line + nblock_lines - 1, gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+
+        /* Write the current block to the raw binary file */
+        if (write_raw_binary_writer (&rbw, nblock_lines, bmeta->nsamps,
+            out_nbytes, out_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d to the raw binary file: %s",
+                line, line + nblock_lines - 1, img_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    /* Close the raw binary file */
+    rb_open = false;
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the output raw binary file: %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Create the ENVI header file this band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for this file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Write the ENVI header */
+    count = snprintf (envi_file, sizeof (envi_file), "%s", img_file);
+    if (count < 0 || count >= sizeof (envi_file))
+    {
+        sprintf (errmsg, "Overflow of envi_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+    cptr = strchr (envi_file, '.');
+    strcpy (cptr, ".hdr");
+
+    if (hdr_batch != NULL)
+        status = add_envi_hdr (hdr_batch, hdr_slot, envi_file, &envi_hdr);
+    else
+        status = write_envi_hdr (envi_file, &envi_hdr);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+cleanup:
+    /* Close the raw binary file and free the memory, whether or not the
+       band was converted */
+    if (rb_open)
+        close_raw_binary_writer (&rbw);
+    if (out_buf != NULL && out_buf != file_buf)
+        release_raw_binary_buffer (out_buf);
+    if (file_buf != NULL)
+        release_raw_binary_buffer (file_buf);
+    free (reader.unit_buf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_gtif_to_img
+
+PURPOSE: Convert the LPGS GeoTIFF band file to ESPA raw binary (.img) file and
+writes the associated ENVI header for each band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converterd GeoTIFF to raw binary
+
+NOTES:
+1. See convert_tiff_to_img for the details of the conversion.
+2. The GeoTIFF is opened once for each decoding thread.  When called from
+   the band loop of convert_lpgs_to_espa_meta, the strips or tiles of the
+   band are decoded by the threads which are done with their own bands, so
+   the last bands don't hold up the conversion.
+3. The GeoTIFF tag extender is registered before the first open, so this may
+   be called from several threads at once.
+******************************************************************************/
+int convert_gtif_to_img
+(
+    char *gtif_file,           /* I: name of the input GeoTIFF file */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    const Ingest_band_scale_t *scale,  /* I: scaling of the band; NULL to
+                                     write the digital numbers */
+    Envi_hdr_batch_t *hdr_batch, /* I/O: batch the ENVI header is added to;
+                                     NULL to write the header right away */
+    int hdr_slot,              /* I: slot of the ENVI header in hdr_batch */
+    int nthreads               /* I: number of threads for decoding the band
+                                     (ignored if threading isn't enabled) */
+)
+{
+    char FUNC_NAME[] = "convert_gtif_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the handles */
+    int ntiff = 1;            /* number of decoding threads and handles */
+    int status = SUCCESS;     /* return status */
+    TIFF **fp_tiff = NULL;    /* file pointers for the TIFF file */
+    ESPA_PROFILE_SCOPE ("convert_gtif_to_img");
+
+    ESPA_PROBE3 (band__start, bmeta->name, bmeta->nlines, bmeta->nsamps);
+
+#ifdef _OPENMP
+    if (nthreads > 1)
+        ntiff = nthreads;
+#endif
+
+    /* Open the TIFF file for reading by each decoding thread */
+    pthread_once (&xtiff_once, XTIFFInitialize);
+    fp_tiff = calloc (ntiff, sizeof (TIFF *));
+    if (fp_tiff == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the TIFF file pointers");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < ntiff; i++)
+    {
+        fp_tiff[i] = XTIFFOpen (gtif_file, "r");
+        if (fp_tiff[i] == NULL)
+        {
+            sprintf (errmsg, "Opening the LPGS GeoTIFF file: %s", gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    if (status == SUCCESS)
+        status = convert_tiff_to_img (fp_tiff, ntiff, gtif_file, bmeta,
+            gmeta, scale, hdr_batch, hdr_slot);
+
+    for (i = 0; i < ntiff; i++)
+    {
+        if (fp_tiff[i] != NULL)
+            XTIFFClose (fp_tiff[i]);
+    }
+    free (fp_tiff);
+
+    ESPA_PROBE2 (band__done, bmeta->name, status == SUCCESS ?
+        (long long) bmeta->nlines * bmeta->nsamps *
+        get_data_type_size (bmeta->data_type) : 0LL);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  set_lpgs_product
+
+PURPOSE: Adds the product ID, from the MTL filename, to the metadata and
+writes the XML file if one was specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting the product ID or writing the XML file
+SUCCESS         Successful completion
+
+NOTES:
+  1. The product ID is the MTL filename without the _MTL.txt
+     ({product_id}_MTL.txt).
+  2. If scales isn't NULL, the scaling of the bands requested via
+     ESPA_INGEST_SCALE is set up (see init_ingest_scale) before the XML file
+     is written, so it describes the scaled bands.
+******************************************************************************/
+static int set_lpgs_product
+(
+    char *lpgs_mtl_file,   /* I: LPGS MTL metadata filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename (NULL if
+                                 the XML file should not be written) */
+    Espa_internal_meta_t *xml_metadata, /* I/O: XML metadata structure */
+    Ingest_band_scale_t **scales  /* O: scaling of the bands (NULL if not
+                                 scaled), which must be freed by the caller;
+                                 NULL to write the bands unscaled */
+)
+{
+    char FUNC_NAME[] = "set_lpgs_product";  /* function name */
     char errmsg[STR_SIZE];   /* error message */
     char *cptr = NULL;       /* pointer to _MTL.txt in the MTL filename */
+    int count;               /* number of chars copied in snprintf */
+
+    /* Add the product ID which is pulled from the MTL filename */
+    count = snprintf (xml_metadata->global.product_id,
+        sizeof (xml_metadata->global.product_id), "%s", lpgs_mtl_file);
+    if (count < 0 || count >= sizeof (xml_metadata->global.product_id))
+    {
+        sprintf (errmsg, "Overflow of xml_metadata.global.product_id string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Strip off _MTL.txt filename extension to get the actual product name */
+    cptr = strrchr (xml_metadata->global.product_id, '_');
+    *cptr = '\0';
+
+    /* Describe the scaled bands */
+    if (scales != NULL && init_ingest_scale (xml_metadata, scales) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the scaling of the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (espa_xml_file != NULL)
+    {
+        /* Write the metadata from our internal metadata structure to the
+           output XML filename */
+        if (write_metadata (xml_metadata, espa_xml_file) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        /* Validate the input metadata file */
+        if (validate_xml_file (espa_xml_file) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/* Bands converted by convert_lpgs_bands */
+typedef struct
+{
+    char (*lpgs_bands)[STR_SIZE];  /* filenames of the LPGS bands */
+    bool del_src;             /* remove the source .tif files? */
+    int nthreads;             /* number of threads for decoding a band */
+    Espa_internal_meta_t *xml_metadata;  /* XML metadata of the bands */
+    Ingest_band_scale_t *scales;  /* scaling of the bands; NULL if they
+                                 aren't scaled */
+    Envi_hdr_batch_t *hdr_batch;  /* ENVI headers of the bands */
+} Lpgs_band_list_t;
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_bands
+
+PURPOSE: Converts a range of the LPGS GeoTIFF bands to raw binary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting a band
+SUCCESS         Successful completion
+
+NOTES:
+  1. Called by espa_parallel_for from convert_lpgs_to_espa_meta.
+******************************************************************************/
+static int convert_lpgs_bands
+(
+    void *arg,             /* I: bands being converted (Lpgs_band_list_t) */
+    int first,             /* I: first band of the range */
+    int end,               /* I: band after the range */
+    int runner             /* I: number of the thread (unused) */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_bands";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Lpgs_band_list_t *list = arg;  /* bands being converted */
+    Espa_internal_meta_t *xml_metadata = list->xml_metadata;  /* metadata */
+    int i;                   /* looping variable for the bands */
+
+    for (i = first; i < end; i++)
+    {
+        printf ("  Band %d: %s to %s\n", i, list->lpgs_bands[i],
+            xml_metadata->band[i].file_name);
+        if (convert_gtif_to_img (list->lpgs_bands[i], &xml_metadata->band[i],
+            &xml_metadata->global, get_ingest_band_scale (list->scales, i),
+            list->hdr_batch, i, list->nthreads) != SUCCESS)
+        {
+            sprintf (errmsg, "Converting band %d: %s", i,
+                list->lpgs_bands[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Remove the source file if specified */
+        if (list->del_src)
+        {
+            printf ("  Removing %s\n", list->lpgs_bands[i]);
+            if (unlink (list->lpgs_bands[i]) != 0)
+            {
+                sprintf (errmsg, "Deleting source file: %s",
+                    list->lpgs_bands[i]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_to_espa_meta
+
+PURPOSE: Converts the input LPGS GeoTIFF files (and associated MTL file) to
+the ESPA internal raw binary file format, populating the ESPA internal
+metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converted GeoTIFF to raw binary
+
+NOTES:
+  1. The LPGS GeoTIFF band files will be deciphered from the LPGS MTL file.
+  2. The ESPA raw binary band files will be generated from the product ID.
+  3. If espa_xml_file is NULL, the XML file is not written, and it is up to
+     the caller to write the populated metadata.  Otherwise the XML file is
+     written and validated before any of the bands are converted.
+  4. Each band is a separate GeoTIFF and raw binary file, so the bands are
+     converted concurrently when threading is enabled (ENABLE_THREADING=yes),
+     using the task runtime (see espa_task.h).  Each thread only writes to
+     its own band file and only reads the XML metadata, which is completely
+     populated before the band conversions.  Once a band fails, the bands
+     not yet started are skipped.
+  5. xml_metadata should be initialized by the caller, and the caller is
+     responsible for calling free_metadata on it.
+  6. The ENVI headers of the bands are collected as the bands are converted
+     and written together once they are all done.
+******************************************************************************/
+int convert_lpgs_to_espa_meta
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename (NULL if
+                                 the XML file should not be written) */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    int nthreads,          /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+    Espa_internal_meta_t *xml_metadata  /* O: XML metadata structure populated
+                                 by reading the MTL metadata file */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_to_espa_meta";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nlpgs_bands;         /* number of bands in the LPGS product */
+    char lpgs_bands[MAX_LPGS_BANDS][STR_SIZE];  /* array containing the file
+                                names of the LPGS bands */
+    Lpgs_band_list_t list;   /* bands being converted */
+    Ingest_band_scale_t *scales = NULL;  /* scaling of the bands */
+    Envi_hdr_batch_t hdr_batch;  /* ENVI headers of the bands */
+    int status;              /* return status */
+
+    /* Read the LPGS MTL file and populate our internal ESPA metadata
+       structure */
+    if (read_lpgs_mtl (lpgs_mtl_file, xml_metadata, &nlpgs_bands,
+        lpgs_bands) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the LPGS MTL file: %s", lpgs_mtl_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Add the product ID and write the XML file */
+    if (set_lpgs_product (lpgs_mtl_file, espa_xml_file, xml_metadata,
+        &scales) != SUCCESS)
+    {  /* Error messages already written */
+        free (scales);
+        return (ERROR);
+    }
+
+    /* Convert each of the LPGS GeoTIFF files to raw binary.  The bands are
+       independent, so they are converted in parallel if threading is
+       enabled. */
+    if (nthreads < 1)
+        nthreads = 1;
+    if (init_envi_hdr_batch (&hdr_batch, nlpgs_bands) != SUCCESS)
+    {  /* Error messages already written */
+        free (scales);
+        return (ERROR);
+    }
+    list.lpgs_bands = lpgs_bands;
+    list.del_src = del_src;
+    list.nthreads = nthreads;
+    list.xml_metadata = xml_metadata;
+    list.scales = scales;
+    list.hdr_batch = &hdr_batch;
+    pthread_once (&xtiff_once, XTIFFInitialize);
+    status = espa_parallel_for (0, nlpgs_bands, 1, nthreads,
+        convert_lpgs_bands, &list);
+    if (status == SUCCESS)
+        status = flush_envi_hdr_batch (&hdr_batch);
+    free_envi_hdr_batch (&hdr_batch);
+    free (scales);
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_to_espa
+
+PURPOSE: Converts the input LPGS GeoTIFF files (and associated MTL file) to
+the ESPA internal raw binary file format (and associated XML file).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF file
+SUCCESS         Successfully converted GeoTIFF to raw binary
+
+NOTES:
+  1. The LPGS GeoTIFF band files will be deciphered from the LPGS MTL file.
+  2. The ESPA raw binary band files will be generated from the ESPA XML
+     filename.
+  3. See convert_lpgs_to_espa_meta for the details of the conversion.
+******************************************************************************/
+int convert_lpgs_to_espa
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    int nthreads           /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+)
+{
+    int status;              /* return status */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
-    int i;                   /* looping variable */
-    int nlpgs_bands;         /* number of bands in the LPGS product */
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Convert the bands, writing the XML file before converting them */
+    status = convert_lpgs_to_espa_meta (lpgs_mtl_file, espa_xml_file, del_src,
+        nthreads, &xml_metadata);
+
+    /* Free the metadata structure */
+    free_metadata (&xml_metadata);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_to_espa_virtual
+
+PURPOSE: Creates a virtual ESPA product for the input LPGS product: the ESPA
+XML file is written with its bands pointing at the LPGS GeoTIFF files, rather
+than converting them to raw binary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the MTL file, checking the GeoTIFF files, or
+                writing the XML file
+SUCCESS         Successfully created the virtual product
+
+NOTES:
+  1. The LPGS GeoTIFF band files will be deciphered from the LPGS MTL file,
+     and become the file_names of the bands in the XML file.  No raw binary
+     or ENVI header files are written.
+  2. The bands are read through libtiff by the raw binary I/O library (see
+     raw_binary_tiff.h), so the product is read the same as a converted one,
+     but its bands can't be updated in place.
+  3. Only the directory of each GeoTIFF is read, to make sure it matches the
+     size and data type of its band, so the cost is the metadata only.
+******************************************************************************/
+int convert_lpgs_to_espa_virtual
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file    /* I: output ESPA XML metadata filename */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_to_espa_virtual";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the bands */
     int count;               /* number of chars copied in snprintf */
+    int nlpgs_bands;         /* number of bands in the LPGS product */
+    int status = SUCCESS;    /* return status */
     char lpgs_bands[MAX_LPGS_BANDS][STR_SIZE];  /* array containing the file
                                 names of the LPGS bands */
+    off_t band_size;         /* expected size of the band data (bytes) */
+    Espa_band_meta_t *bmeta = NULL;  /* band metadata */
+    Raw_binary_tiff_t *rbt = NULL;   /* GeoTIFF band */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                populated by reading the MTL metadata file */
 
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
@@ -1583,67 +2431,506 @@ int convert_lpgs_to_espa
     {
         sprintf (errmsg, "Reading the LPGS MTL file: %s", lpgs_mtl_file);
         error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
         return (ERROR);
     }
 
-    /* Add the product ID which is pulled from the MTL filename
-       ({product_id}_MTL.txt) */
-    count = snprintf (xml_metadata.global.product_id,
-        sizeof (xml_metadata.global.product_id), "%s", lpgs_mtl_file);
-    if (count < 0 || count >= sizeof (xml_metadata.global.product_id))
+    /* Point each band at its GeoTIFF, making sure the GeoTIFF holds the
+       band described by the MTL file */
+    for (i = 0; i < nlpgs_bands && status == SUCCESS; i++)
     {
-        sprintf (errmsg, "Overflow of xml_metadata.global.product_id string");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        bmeta = &xml_metadata.band[i];
+        count = snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s",
+            lpgs_bands[i]);
+        if (count < 0 || count >= sizeof (bmeta->file_name))
+        {
+            sprintf (errmsg, "Overflow of bmeta->file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* The band is only read as a GeoTIFF if its name says it is one */
+        if (!has_raw_binary_tiff_name (lpgs_bands[i]))
+        {
+            sprintf (errmsg, "LPGS band %s doesn't have a .tif extension, so "
+                "it can't be read in place.", lpgs_bands[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        rbt = open_raw_binary_tiff (lpgs_bands[i]);
+        if (rbt == NULL)
+        {
+            sprintf (errmsg, "Opening the LPGS GeoTIFF file: %s",
+                lpgs_bands[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        band_size = (off_t) bmeta->nlines * bmeta->nsamps *
+            get_data_type_size (bmeta->data_type);
+        if (get_raw_binary_tiff_size (rbt) != band_size)
+        {
+            sprintf (errmsg, "LPGS GeoTIFF file %s doesn't match the %d lines "
+                "x %d samples of band %s.", lpgs_bands[i], bmeta->nlines,
+                bmeta->nsamps, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        close_raw_binary_tiff (rbt);
+        printf ("  Band %d: %s (virtual)\n", i, lpgs_bands[i]);
     }
 
-    /* Strip off _MTL.txt filename extension to get the actual product name */
-    cptr = strrchr (xml_metadata.global.product_id, '_');
-    *cptr = '\0';
+    /* Add the product ID and write the XML file */
+    if (status == SUCCESS)
+        status = set_lpgs_product (lpgs_mtl_file, espa_xml_file,
+            &xml_metadata, NULL);
+
+    /* Free the metadata structure */
+    free_metadata (&xml_metadata);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_bundle_band
+
+PURPOSE: Converts a GeoTIFF band read from the bundle into memory to ESPA
+raw binary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the GeoTIFF band
+SUCCESS         Successfully converted GeoTIFF to raw binary
 
-    /* Write the metadata from our internal metadata structure to the output
-       XML filename */
-    if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
+NOTES:
+  1. The buffer is freed once the band has been converted.
+******************************************************************************/
+static int convert_lpgs_bundle_band
+(
+    char *gtif_file,           /* I: name of the GeoTIFF member */
+    uint8 *tiff_buf,           /* I: contents of the GeoTIFF member */
+    size_t tiff_size,          /* I: size of the GeoTIFF member (bytes) */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    const Ingest_band_scale_t *scale, /* I: scaling of the band; NULL to
+                                     write the digital numbers */
+    Envi_hdr_batch_t *hdr_batch, /* I/O: batch the ENVI header is added to */
+    int hdr_slot               /* I: slot of the ENVI header in hdr_batch */
+)
+{
+    int status;               /* return status */
+    TIFF *fp_tiff = NULL;     /* GeoTIFF opened from memory */
+
+    fp_tiff = open_lpgs_memory_tiff (gtif_file, tiff_buf, tiff_size);
+    if (fp_tiff == NULL)
     {  /* Error messages already written */
         return (ERROR);
     }
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
+    status = convert_tiff_to_img (&fp_tiff, 1, gtif_file, bmeta, gmeta,
+        scale, hdr_batch, hdr_slot);
+    XTIFFClose (fp_tiff);
+    return (status);
+}
+
+
+/* Band of a bundle converted by convert_lpgs_bundle_task */
+typedef struct
+{
+    int band;                  /* number of the band */
+    char gtif_file[STR_SIZE];  /* name of the GeoTIFF member */
+    uint8 *tiff_buf;           /* contents of the GeoTIFF member */
+    size_t tiff_size;          /* size of the GeoTIFF member (bytes) */
+    Espa_band_meta_t *bmeta;   /* band metadata for this band */
+    Espa_global_meta_t *gmeta; /* global metadata */
+    const Ingest_band_scale_t *scale;  /* scaling of the band; NULL if it
+                                  isn't scaled */
+    Envi_hdr_batch_t *hdr_batch;  /* ENVI headers of the bands */
+} Lpgs_bundle_band_t;
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_bundle_task
+
+PURPOSE: Converts a band read from the bundle, as a task of the task runtime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the band
+SUCCESS         Successful completion
+
+NOTES:
+  1. The task owns its argument and frees it.  The argument holds a copy of
+     the band's filename, since the task may outlive scan_lpgs_bundle.
+******************************************************************************/
+static int convert_lpgs_bundle_task
+(
+    void *arg                  /* I: band to be converted
+                                     (Lpgs_bundle_band_t) */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_bundle_task";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Lpgs_bundle_band_t *band = arg;  /* band to be converted */
+    int status;               /* return status */
+
+    status = convert_lpgs_bundle_band (band->gtif_file, band->tiff_buf,
+        band->tiff_size, band->bmeta, band->gmeta, band->scale,
+        band->hdr_batch, band->band);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Converting band %d: %s", band->band,
+            band->gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
     }
 
-    /* Convert each of the LPGS GeoTIFF files to raw binary */
-    for (i = 0; i < nlpgs_bands; i++)
+    free (band);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  scan_lpgs_bundle
+
+PURPOSE: Reads the members of the bundle, parsing the MTL file and converting
+each of the GeoTIFF bands it lists.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the bundle or converting the bands
+SUCCESS         Successfully converted the bands
+
+NOTES:
+  1. Each band is read into memory and converted from there.  The
+     conversions are submitted to the task group as tasks, which run while
+     the next members are read when threading is enabled, with at most
+     nthreads bands in memory waiting to be converted.  The caller waits on
+     the group, even if an error is returned.
+  2. The bands have to be matched against the MTL file, so bands archived
+     before the MTL file are picked up in a second pass over the bundle.
+     The MTL file is normally archived first, so one pass is usually enough.
+******************************************************************************/
+static int scan_lpgs_bundle
+(
+    Lpgs_bundle_t *bundle,  /* I/O: reader for the bundle */
+    char *espa_xml_file,    /* I: output ESPA XML metadata filename (NULL if
+                                  the XML file should not be written) */
+    int nthreads,           /* I: maximum number of bands being converted */
+    Espa_task_group_t *group,  /* I/O: group of the band conversions */
+    Envi_hdr_batch_t *hdr_batch,  /* I/O: batch the ENVI headers of the
+                                  bands are added to */
+    Espa_internal_meta_t *xml_metadata, /* O: XML metadata structure
+                                  populated from the MTL file */
+    Ingest_band_scale_t **scales  /* O: scaling of the bands (NULL if not
+                                  scaled); must be freed by the caller once
+                                  the band conversions are done */
+)
+{
+    char FUNC_NAME[] = "scan_lpgs_bundle";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char mtl_file[STR_SIZE]; /* name of the MTL file in the bundle */
+    char lpgs_bands[MAX_LPGS_BANDS][STR_SIZE];  /* array containing the file
+                                names of the LPGS bands */
+    const char *name = NULL; /* filename of the current member */
+    int i;                   /* looping variable for the bands */
+    int nlpgs_bands = 0;     /* number of bands in the LPGS product */
+    int nconverted = 0;      /* number of bands read from the bundle */
+    int ntasks = 0;          /* number of band conversions started since the
+                                last wait */
+    int len;                 /* length of the member filename */
+    bool have_mtl = false;   /* has the MTL file been read? */
+    bool skipped = false;    /* were members skipped before the MTL file? */
+    bool rewound = false;    /* has the bundle been rewound? */
+    bool found;              /* was another member found? */
+    bool converted[MAX_LPGS_BANDS];  /* has the band been read? */
+    uint8 *member_buf = NULL;  /* contents of the current member */
+    size_t member_size;      /* size of the current member (bytes) */
+    Lpgs_bundle_band_t *band = NULL;  /* band handed to a task */
+
+    for (i = 0; i < MAX_LPGS_BANDS; i++)
+        converted[i] = false;
+
+    while (!have_mtl || nconverted < nlpgs_bands)
     {
-        printf ("  Band %d: %s to %s\n", i, lpgs_bands[i],
-            xml_metadata.band[i].file_name);
-        if (convert_gtif_to_img (lpgs_bands[i], &xml_metadata.band[i],
-            &xml_metadata.global) != SUCCESS)
-        {
-            sprintf (errmsg, "Converting band %d: %s", i, lpgs_bands[i]);
-            error_handler (true, FUNC_NAME, errmsg);
+        if (next_lpgs_bundle_member (bundle, &found) != SUCCESS)
+        {  /* Error messages already written */
             return (ERROR);
         }
 
-        /* Remove the source file if specified */
-        if (del_src)
+        if (!found)
+        {
+            /* Go back for the bands archived before the MTL file */
+            if (have_mtl && skipped && !rewound)
+            {
+                if (rewind_lpgs_bundle (bundle) != SUCCESS)
+                {  /* Error messages already written */
+                    return (ERROR);
+                }
+                rewound = true;
+                continue;
+            }
+            break;
+        }
+
+        /* Parse the MTL file from memory */
+        name = get_lpgs_member_basename (bundle->member_name);
+        if (!have_mtl)
         {
-            printf ("  Removing %s\n", lpgs_bands[i]);
-            if (unlink (lpgs_bands[i]) != 0)
+            len = strlen (name);
+            if (len <= 8 || strcmp (&name[len-8], "_MTL.txt"))
+            {
+                skipped = true;
+                continue;
+            }
+
+            snprintf (mtl_file, sizeof (mtl_file), "%s", name);
+            if (read_lpgs_bundle_member (bundle, &member_buf, &member_size)
+                != SUCCESS ||
+                read_lpgs_mtl_buffer (mtl_file, (char *) member_buf,
+                member_size, xml_metadata, &nlpgs_bands, lpgs_bands) !=
+                SUCCESS)
             {
-                sprintf (errmsg, "Deleting source file: %s", lpgs_bands[i]);
+                sprintf (errmsg, "Reading the LPGS MTL file %s from %s",
+                    mtl_file, bundle->bundle_file);
                 error_handler (true, FUNC_NAME, errmsg);
+                free (member_buf);
+                return (ERROR);
+            }
+            free (member_buf);
+
+            if (set_lpgs_product (mtl_file, espa_xml_file, xml_metadata,
+                scales) != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+            have_mtl = true;
+            continue;
+        }
+
+        /* Find the band for this member */
+        for (i = 0; i < nlpgs_bands; i++)
+        {
+            if (!converted[i] &&
+                !strcmp (get_lpgs_member_basename (lpgs_bands[i]), name))
+                break;
+        }
+        if (i == nlpgs_bands)
+            continue;
+
+        /* Read the band into memory and convert it */
+        if (read_lpgs_bundle_member (bundle, &member_buf, &member_size) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Reading band %d: %s", i, lpgs_bands[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        converted[i] = true;
+        nconverted++;
+
+        printf ("  Band %d: %s to %s\n", i, bundle->member_name,
+            xml_metadata->band[i].file_name);
+        band = malloc (sizeof (Lpgs_bundle_band_t));
+        if (band == NULL)
+        {
+            free (member_buf);
+            sprintf (errmsg, "Allocating the task for band %d", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        band->band = i;
+        snprintf (band->gtif_file, sizeof (band->gtif_file), "%s",
+            lpgs_bands[i]);
+        band->tiff_buf = member_buf;
+        band->tiff_size = member_size;
+        band->bmeta = &xml_metadata->band[i];
+        band->gmeta = &xml_metadata->global;
+        band->scale = get_ingest_band_scale (*scales, i);
+        band->hdr_batch = hdr_batch;
+        espa_task_submit (group, convert_lpgs_bundle_task, band);
+
+        /* Bound the number of bands held in memory */
+        if (++ntasks >= nthreads)
+        {
+            if (espa_task_group_wait (group) != SUCCESS)
+            {  /* Error messages already written */
                 return (ERROR);
             }
+            ntasks = 0;
         }
     }
 
-    /* Free the metadata structure */
-    free_metadata (&xml_metadata);
+    if (!have_mtl)
+    {
+        sprintf (errmsg, "No _MTL.txt file found in %s", bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nlpgs_bands; i++)
+    {
+        if (!converted[i])
+        {
+            sprintf (errmsg, "Band %s listed in %s isn't in %s",
+                lpgs_bands[i], mtl_file, bundle->bundle_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_lpgs_bundle_to_espa_meta
+
+PURPOSE: Converts the LPGS GeoTIFF files (and associated MTL file) in an LPGS
+product bundle (.tar.gz) to the ESPA internal raw binary file format,
+populating the ESPA internal metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bundle
+SUCCESS         Successfully converted the bundle to raw binary
+
+NOTES:
+  1. The members are read directly from the compressed bundle, so the bundle
+     isn't extracted to disk.  The MTL file is parsed from memory and each
+     GeoTIFF band is read into memory and opened from there.
+  2. If espa_xml_file is NULL, the XML file is not written, and it is up to
+     the caller to write the populated metadata.  Otherwise the XML file is
+     written and validated as soon as the MTL file has been read.
+  3. If del_src is specified, the bundle is removed once all the bands have
+     been converted.
+  4. xml_metadata should be initialized by the caller, and the caller is
+     responsible for calling free_metadata on it.
+  5. The ENVI headers of the bands are collected as the bands are converted
+     and written together once they are all done.
+******************************************************************************/
+int convert_lpgs_bundle_to_espa_meta
+(
+    char *lpgs_bundle_file, /* I: input LPGS product bundle (.tar.gz) */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename (NULL if
+                                 the XML file should not be written) */
+    bool del_src,          /* I: should the bundle be removed after
+                                 conversion? */
+    int nthreads,          /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+    Espa_internal_meta_t *xml_metadata  /* O: XML metadata structure populated
+                                 by reading the MTL metadata file */
+)
+{
+    char FUNC_NAME[] = "convert_lpgs_bundle_to_espa_meta";  /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* status of reading the bundle */
+    int band_status = SUCCESS;  /* status of the band conversions */
+    Lpgs_bundle_t bundle;    /* reader for the bundle */
+    Espa_task_group_t group; /* group of the band conversions */
+    Ingest_band_scale_t *scales = NULL;  /* scaling of the bands */
+    Envi_hdr_batch_t hdr_batch;  /* ENVI headers of the bands */
+
+    if (init_envi_hdr_batch (&hdr_batch, MAX_LPGS_BANDS) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (open_lpgs_bundle (lpgs_bundle_file, &bundle) != SUCCESS)
+    {  /* Error messages already written */
+        free_envi_hdr_batch (&hdr_batch);
+        return (ERROR);
+    }
+
+    /* Read the bundle in this thread, which hands the bands off to the
+       other threads to be converted */
+    if (nthreads < 1)
+        nthreads = 1;
+    espa_task_group_init (&group);
+    status = scan_lpgs_bundle (&bundle, espa_xml_file, nthreads, &group,
+        &hdr_batch, xml_metadata, &scales);
+    band_status = espa_task_group_wait (&group);
+    if (status == SUCCESS && band_status == SUCCESS)
+        status = flush_envi_hdr_batch (&hdr_batch);
+    free_envi_hdr_batch (&hdr_batch);
+    free (scales);
+
+    close_lpgs_bundle (&bundle);
+    if (status != SUCCESS || band_status != SUCCESS)
+    {
+        sprintf (errmsg, "Converting the LPGS bundle: %s", lpgs_bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Remove the bundle if specified */
+    if (del_src)
+    {
+        printf ("  Removing %s\n", lpgs_bundle_file);
+        if (unlink (lpgs_bundle_file) != 0)
+        {
+            sprintf (errmsg, "Deleting source file: %s", lpgs_bundle_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
 
     /* Successful conversion */
     return (SUCCESS);
 }
 
+
+/******************************************************************************
+MODULE:  convert_lpgs_bundle_to_espa
+
+PURPOSE: Converts the LPGS GeoTIFF files (and associated MTL file) in an LPGS
+product bundle (.tar.gz) to the ESPA internal raw binary file format (and
+associated XML file).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bundle
+SUCCESS         Successfully converted the bundle to raw binary
+
+NOTES:
+  1. See convert_lpgs_bundle_to_espa_meta for the details of the conversion.
+******************************************************************************/
+int convert_lpgs_bundle_to_espa
+(
+    char *lpgs_bundle_file, /* I: input LPGS product bundle (.tar.gz) */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    bool del_src,          /* I: should the bundle be removed after
+                                 conversion? */
+    int nthreads           /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+)
+{
+    int status;              /* return status */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                populated by reading the MTL metadata file */
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Convert the bands, writing the XML file once the MTL file is read */
+    status = convert_lpgs_bundle_to_espa_meta (lpgs_bundle_file,
+        espa_xml_file, del_src, nthreads, &xml_metadata);
+
+    /* Free the metadata structure */
+    free_metadata (&xml_metadata);
+
+    return (status);
+}
@@ -24,8 +24,11 @@ NOTES:
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "raw_binary_io.h"
+#include "raw_binary_tiff.h"
 #include "write_metadata.h"
 #include "envi_header.h"
+#include "lpgs_bundle.h"
+#include "espa_ingest_scale.h"
 
 /* Defines */
 /* Maximum number of LPGS bands in a file; OLI/TIRS products have the most
@@ -33,6 +36,11 @@ NOTES:
    9 bands */
 #define MAX_LPGS_BANDS 12
 
+/* Number of lines read from the GeoTIFF and written to the raw binary file
+   at a time (rounded up to whole strips or tiles); this bounds the memory
+   used for each band conversion */
+#define LPGS_LINE_BLOCK 512
+
 /* Prototypes */
 int read_lpgs_mtl
 (
@@ -45,19 +53,99 @@ int read_lpgs_mtl
                                            the LPGS bands */
 );
 
+int read_lpgs_mtl_buffer
+(
+    char *mtl_file,                  /* I: name of the MTL metadata file,
+                                           written to the XML metadata */
+    char *mtl_buf,                   /* I/O: contents of the MTL file, with
+                                           room for a NUL after it */
+    size_t mtl_size,                 /* I: size of the MTL file (bytes) */
+    Espa_internal_meta_t *metadata,  /* I/O: input metadata structure to be
+                                           populated from the MTL file */
+    int *nlpgs_bands,                /* O: number of bands in LPGS product */
+    char lpgs_bands[][STR_SIZE]      /* O: array containing the filenames of
+                                           the LPGS bands */
+);
+
+int convert_tiff_to_img
+(
+    TIFF **fp_tiff,            /* I: handles for the GeoTIFF band opened for
+                                     reading, one per decoding thread */
+    int ntiff,                 /* I: number of handles (at least 1) */
+    char *gtif_file,           /* I: name of the input GeoTIFF file */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    const Ingest_band_scale_t *scale, /* I: scaling of the band; NULL to
+                                     write the digital numbers */
+    Envi_hdr_batch_t *hdr_batch, /* I/O: batch the ENVI header is added to;
+                                     NULL to write the header right away */
+    int hdr_slot               /* I: slot of the ENVI header in hdr_batch */
+);
+
 int convert_gtif_to_img
 (
     char *gtif_file,           /* I: name of the input GeoTIFF file */
     Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
-    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    const Ingest_band_scale_t *scale,  /* I: scaling of the band; NULL to
+                                     write the digital numbers */
+    Envi_hdr_batch_t *hdr_batch, /* I/O: batch the ENVI header is added to;
+                                     NULL to write the header right away */
+    int hdr_slot,              /* I: slot of the ENVI header in hdr_batch */
+    int nthreads               /* I: number of threads for decoding the band
+                                     (ignored if threading isn't enabled) */
+);
+
+int convert_lpgs_to_espa_meta
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename (NULL if
+                                 the XML file should not be written) */
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    int nthreads,          /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+    Espa_internal_meta_t *xml_metadata  /* O: XML metadata structure populated
+                                 by reading the MTL metadata file */
 );
 
 int convert_lpgs_to_espa
 (
     char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
+                                 conversion? */
+    int nthreads           /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+);
+
+int convert_lpgs_to_espa_virtual
+(
+    char *lpgs_mtl_file,   /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file    /* I: output ESPA XML metadata filename */
+);
+
+int convert_lpgs_bundle_to_espa_meta
+(
+    char *lpgs_bundle_file, /* I: input LPGS product bundle (.tar.gz) */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename (NULL if
+                                 the XML file should not be written) */
+    bool del_src,          /* I: should the bundle be removed after
+                                 conversion? */
+    int nthreads,          /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
+    Espa_internal_meta_t *xml_metadata  /* O: XML metadata structure populated
+                                 by reading the MTL metadata file */
+);
+
+int convert_lpgs_bundle_to_espa
+(
+    char *lpgs_bundle_file, /* I: input LPGS product bundle (.tar.gz) */
+    char *espa_xml_file,   /* I: output ESPA XML metadata filename */
+    bool del_src,          /* I: should the bundle be removed after
                                  conversion? */
+    int nthreads           /* I: number of threads to use for converting the
+                                 bands (ignored if threading isn't enabled) */
 );
 
 #endif
@@ -16,9 +16,13 @@ NOTES:
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
 *****************************************************************************/
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <math.h>
 #include <ctype.h>
 #include "convert_modis_to_espa.h"
+#include "espa_odl.h"
+#include "espa_task.h"
 
 /******************************************************************************
 MODULE:  doy_to_month_day
@@ -587,198 +591,186 @@ int get_sds_values
 
 
 /******************************************************************************
-MODULE:  read_core_metadata
+MODULE:  read_odl_metadata
 
-PURPOSE: Reads the core metadata, searching for the desired fields.
+PURPOSE: Reads an ODL metadata attribute of the HDF file and tokenizes it.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error reading the core metadata
-SUCCESS         Successfully read the core metadata
+ERROR           Error reading the metadata attribute
+SUCCESS         Successfully read and tokenized the metadata
 
 NOTES:
+  1. HDF-EOS splits long metadata into the attributes name.0, name.1, ...,
+     so the attribute is read either whole or as the concatenation of its
+     parts.  The parts may be padded with NULs, which are dropped.
+  2. The caller is responsible for freeing the metadata with free_odl upon
+     successful return.
 ******************************************************************************/
-int read_core_metadata
+static int read_odl_metadata
 (
-    int32 sd_id,              /* I: file ID for the HDF file */
-    char prod_date_time[],    /* O: production date/time */
-    char pge_version[]        /* O: PGE version */
+    int32 sd_id,              /* I: SD interface ID for the HDF file */
+    char *attr_base,          /* I: name of the metadata attribute */
+    Odl_index_t *odl          /* O: tokenized metadata */
 )
 {
-    char FUNC_NAME[] = "read_core_metadata";  /* function name */
+    char FUNC_NAME[] = "read_odl_metadata";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
     char attr_name[STR_SIZE];   /* attribute name */
-    char attrname[STR_SIZE];    /* holds the file_name string */
-    char *file_data = NULL;     /* character string used for reading the
-                                   CoreMetadata */
-    char *file_data_ptr = NULL; /* pointer to file_data for scanning */
-    int j;                  /* looping variable */
-    int count;              /* number of chars copied in snprintf */
-    int32 attr_indx = -1;   /* index for the current attribute */
-    int32 data_type;        /* attribute's data type */
-    int32 n_values;         /* number of vals of the attribute */
-    int32 status;           /* return status */
-    bool prod_date_found;   /* production date/time has been found */
-    bool pge_version_found; /* PGE version has been found */
-    int num_chars;          /* number of characters read in the line */
-    char token_buffer[STR_SIZE]; /* holds the current token */
-
-    /* Look for the CoreMetadata in the HDF file */
-    attr_indx = SDfindattr (sd_id, "CoreMetadata");
-
-    /* Only proceed if the attribute was found */
-    if (attr_indx == -1)
+    char attrname[STR_SIZE];    /* name of the attribute or part */
+    char *file_data = NULL;     /* concatenated metadata */
+    char *new_data = NULL;      /* reallocated metadata */
+    size_t size = 0;            /* size of the metadata (bytes) */
+    int j;                      /* looping variable for the parts */
+    int32 attr_indx = -1;       /* index for the current attribute */
+    int32 data_type;            /* attribute's data type */
+    int32 n_values;             /* number of vals of the attribute */
+    int32 status;               /* return status */
+
+    /* Read the whole attribute, or else each of its parts */
+    for (j = -1; j <= 9; j++)
     {
-        /* If not found then try concatenating sequence numbers */
-        for (j = 0; j <= 9; j++)
+        if (j == -1)
+            snprintf (attrname, sizeof (attrname), "%s", attr_base);
+        else
+            snprintf (attrname, sizeof (attrname), "%s.%d", attr_base, j);
+        attr_indx = SDfindattr (sd_id, attrname);
+        if (attr_indx == -1)
+            continue;
+
+        /* Get size of HDF file attribute */
+        status = SDattrinfo (sd_id, attr_indx, attr_name, &data_type,
+            &n_values);
+        if (status == -1)
         {
-            sprintf (attrname, "CoreMetadata.%d", j);
-            attr_indx = SDfindattr (sd_id, attrname);
-            if (attr_indx != -1)
-                break;
+            sprintf (errmsg, "Unable to get the size of %s attribute",
+                attrname);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (file_data);
+            return (ERROR);
         }
 
-        if (attr_indx == -1)
+        /* Grow the metadata for the attribute contents (add one character
+           for the end of string character) */
+        new_data = realloc (file_data, size + n_values + 1);
+        if (new_data == NULL)
         {
-            sprintf (errmsg, "Unable to locate CoreMetadata for reading");
+            sprintf (errmsg, "Unable to allocate %d bytes for %s", n_values,
+                attr_name);
             error_handler (true, FUNC_NAME, errmsg);
+            free (file_data);
             return (ERROR);
         }
-    }
+        file_data = new_data;
 
-    /* Get size of HDF file attribute */
-    status = SDattrinfo (sd_id, attr_indx, attr_name, &data_type, &n_values);
-    if (status == -1)
-    {
-        sprintf (errmsg, "Unable to get the size of CoreMetadata attribute");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        /* Read attribute from the HDF file */
+        status = SDreadattr (sd_id, attr_indx, &file_data[size]);
+        if (status == -1)
+        {
+            sprintf (errmsg, "Unable to read the %s HDF attribute", attrname);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (file_data);
+            return (ERROR);
+        }
+        size += strnlen (&file_data[size], n_values);
+        file_data[size] = '\0';
+
+        /* The whole attribute isn't split into parts */
+        if (j == -1)
+            break;
     }
 
-    /* Attempt to allocate memory for HDF file attribute contents (add one
-       character for the end of string character) */
-    file_data = calloc (n_values+1, sizeof (char));
-    if (file_data == NULL)
+    if (file_data == NULL || size == 0)
     {
-        sprintf (errmsg, "Unable to allocate %d bytes for %s", n_values,
-            attr_name);
+        sprintf (errmsg, "Unable to locate %s for reading", attr_base);
         error_handler (true, FUNC_NAME, errmsg);
+        free (file_data);
         return (ERROR);
     }
 
-    /* Read attribute from the HDF file */
-    status = SDreadattr (sd_id, attr_indx, file_data);
-    if (status == -1 || !strcmp (file_data, ""))
+    /* Tokenize the metadata; it's owned by odl from here on */
+    if (parse_odl (file_data, odl) != SUCCESS)
     {
-        free (file_data);
-        sprintf (errmsg, "Unable to read the CoreMetadata HDF attributes");
+        sprintf (errmsg, "Tokenizing the %s metadata", attr_base);
         error_handler (true, FUNC_NAME, errmsg);
+        free_odl (odl);
         return (ERROR);
     }
 
-    /* Walk through the file_data string one token at a time looking for the
-       production date and PGE version */
-    prod_date_found = false;
-    pge_version_found = false;
-    file_data_ptr = file_data;
-    status = ERROR;
-    while (sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars) != EOF)
-    {
-        /* If this token is END, then we are done with the metadata */
-        if (!strcmp (token_buffer, "END"))
-            break;
-
-        /* If the tokens have already been found, don't waste time with the
-           rest of the metadata */
-        if (prod_date_found && pge_version_found)
-            break;
-
-        /* Increment the file_data_ptr pointer to point to the next token */
-        file_data_ptr += num_chars;
-
-        /* Look for the PRODUCTIONDATETIME token */
-        if (!strcmp (token_buffer, "PRODUCTIONDATETIME") && !prod_date_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    return (SUCCESS);
+}
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+/******************************************************************************
+MODULE:  read_core_metadata
 
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+PURPOSE: Reads the core metadata, searching for the desired fields.
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the core metadata
+SUCCESS         Successfully read the core metadata
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+NOTES:
+  1. The production date/time and PGE version are empty if they aren't in
+     the core metadata.
+******************************************************************************/
+int read_core_metadata
+(
+    int32 sd_id,              /* I: file ID for the HDF file */
+    char prod_date_time[],    /* O: production date/time */
+    char pge_version[]        /* O: PGE version */
+)
+{
+    char FUNC_NAME[] = "read_core_metadata";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char *value = NULL;         /* value of the current field */
+    int count;                  /* number of chars copied in snprintf */
+    Odl_index_t odl;            /* tokenized CoreMetadata */
 
-            /* Store the value token (without the surrounding ""s) */
-            count = snprintf (prod_date_time, STR_SIZE, "%s", &token_buffer[1]);
-            if (count < 0 || count >= STR_SIZE)
-            {
-                sprintf (errmsg, "Overflow of prod_date_time string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            prod_date_time[strlen(prod_date_time)-1] = '\0';
+    /* Read and tokenize the CoreMetadata in the HDF file */
+    if (read_odl_metadata (sd_id, "CoreMetadata", &odl) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to read the CoreMetadata HDF attributes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            /* Production date/time was found */
-            prod_date_found = true;
+    /* Get the production date and PGE version */
+    prod_date_time[0] = '\0';
+    value = get_odl_value (&odl, "PRODUCTIONDATETIME");
+    if (value != NULL)
+    {
+        count = snprintf (prod_date_time, STR_SIZE, "%s", value);
+        if (count < 0 || count >= STR_SIZE)
+        {
+            sprintf (errmsg, "Overflow of prod_date_time string");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_odl (&odl);
+            return (ERROR);
         }
+    }
 
-        /* Look for the PGEVERSION token */
-        if (!strcmp (token_buffer, "PGEVERSION") && !pge_version_found)
+    pge_version[0] = '\0';
+    value = get_odl_value (&odl, "PGEVERSION");
+    if (value != NULL)
+    {
+        count = snprintf (pge_version, STR_SIZE, "%s", value);
+        if (count < 0 || count >= STR_SIZE)
         {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value token (without the surrounding ""s) */
-            count = snprintf (pge_version, STR_SIZE, "%s", &token_buffer[1]);
-            if (count < 0 || count >= STR_SIZE)
-            {
-                sprintf (errmsg, "Overflow of pge_version string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            pge_version[strlen(pge_version)-1] = '\0';
-
-            /* PGE version was found */
-            pge_version_found = true;
+            sprintf (errmsg, "Overflow of pge_version string");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_odl (&odl);
+            return (ERROR);
         }
-    }  /* end while */
+    }
 
-    /* Free dynamically allocated memory */
-    free (file_data);
+    /* Free the tokenized metadata */
+    free_odl (&odl);
 
     return (SUCCESS);
 }
@@ -797,6 +789,8 @@ ERROR           Error reading the archive metadata
 SUCCESS         Successfully read the archive metadata
 
 NOTES:
+  1. Bounding coordinates which aren't in the archive metadata are left as
+     they are.
 ******************************************************************************/
 int read_archive_metadata
 (
@@ -806,337 +800,239 @@ int read_archive_metadata
 {
     char FUNC_NAME[] = "read_archive_metadata";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
-    char attr_name[STR_SIZE];   /* attribute name */
-    char attrname[STR_SIZE];    /* holds the file_name string */
-    char *file_data = NULL;     /* character string used for reading the
-                                   ArchiveMetadata */
-    char *file_data_ptr = NULL; /* pointer to file_data for scanning */
-    int j;                  /* looping variable */
-    int32 attr_indx = -1;   /* index for the current attribute */
-    int32 data_type;        /* attribute's data type */
-    int32 n_values;         /* number of vals of the attribute */
-    int32 status;           /* return status */
-    bool north_bound_found; /* north bounding rectangle coord been found? */
-    bool south_bound_found; /* south bounding rectangle coord been found? */
-    bool east_bound_found;  /* east bounding rectangle coord been found? */
-    bool west_bound_found;  /* west bounding rectangle coord been found? */
-    int num_chars;          /* number of characters read in the line */
-    char token_buffer[STR_SIZE]; /* holds the current token */
-
-    /* Look for the ArchiveMetadata in the HDF file */
-    attr_indx = SDfindattr (sd_id, "ArchiveMetadata");
-
-    /* Only proceed if the attribute was found */
-    if (attr_indx == -1)
-    {
-        /* If not found then try concatenating sequence numbers */
-        for (j = 0; j <= 9; j++)
-        {
-            sprintf (attrname, "ArchiveMetadata.%d", j);
-            attr_indx = SDfindattr (sd_id, attrname);
-            if (attr_indx != -1)
-                break;
-        }
-
-        if (attr_indx == -1)
-        {
-            sprintf (errmsg, "Unable to locate ArchiveMetadata for reading");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-
-    /* Get size of HDF file attribute */
-    status = SDattrinfo (sd_id, attr_indx, attr_name, &data_type, &n_values);
-    if (status == -1)
-    {
-        sprintf (errmsg, "Unable to get the size of ArchiveMetadata attribute");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    /* Attempt to allocate memory for HDF file attribute contents (add one
-       character for the end of string character) */
-    file_data = calloc (n_values+1, sizeof (char));
-    if (file_data == NULL)
-    {
-        sprintf (errmsg, "Unable to allocate %d bytes for %s", n_values,
-            attr_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    char *value = NULL;         /* value of the current field */
+    int i;                      /* looping variable for the bounds */
+    Odl_index_t odl;            /* tokenized ArchiveMetadata */
+    const char *bound_key[4];   /* key of each bounding coordinate */
 
-    /* Read attribute from the HDF file */
-    status = SDreadattr (sd_id, attr_indx, file_data);
-    if (status == -1 || !strcmp (file_data, ""))
+    /* Read and tokenize the ArchiveMetadata in the HDF file */
+    if (read_odl_metadata (sd_id, "ArchiveMetadata", &odl) != SUCCESS)
     {
-        free (file_data);
         sprintf (errmsg, "Unable to read the ArchiveMetadata HDF attributes");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Walk through the file_data string one token at a time looking for the
-       bounding coordinates */
-    north_bound_found = false;
-    south_bound_found = false;
-    east_bound_found = false;
-    west_bound_found = false;
-    file_data_ptr = file_data;
-    status = ERROR;
-    while (sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars) != EOF)
+    /* Get the bounding coordinates */
+    bound_key[ESPA_WEST] = "WESTBOUNDINGCOORDINATE";
+    bound_key[ESPA_EAST] = "EASTBOUNDINGCOORDINATE";
+    bound_key[ESPA_NORTH] = "NORTHBOUNDINGCOORDINATE";
+    bound_key[ESPA_SOUTH] = "SOUTHBOUNDINGCOORDINATE";
+    for (i = 0; i < 4; i++)
     {
-        /* If this token is END, then we are done with the metadata */
-        if (!strcmp (token_buffer, "END"))
-            break;
+        value = get_odl_value (&odl, bound_key[i]);
+        if (value != NULL)
+            bound_coords[i] = atof (value);
+    }
 
-        /* If all the bounding coords have been found, don't waste time with
-           the rest of the metadata */
-        if (north_bound_found && south_bound_found && east_bound_found &&
-            west_bound_found)
-            break;
+    /* Free the tokenized metadata */
+    free_odl (&odl);
 
-        /* Increment the file_data_ptr pointer to point to the next token */
-        file_data_ptr += num_chars;
+    return (SUCCESS);
+}
 
-        /* Look for the NORTHBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "NORTHBOUNDINGCOORDINATE") &&
-            !north_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+/******************************************************************************
+MODULE:  read_modis_grids
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+PURPOSE: Reads the names of the grids in the MODIS HDF-EOS file from its
+structural metadata.
 
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the grid names
+SUCCESS         Successfully read the grid names
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+NOTES:
+  1. The grids are listed in the StructMetadata of the open file, in the
+     order GDinqgrid lists them, so the file doesn't need to be opened again
+     by name.
+******************************************************************************/
+static int read_modis_grids
+(
+    Modis_hdf_t *hdf,         /* I: open MODIS HDF file */
+    int32 *ngrids,            /* O: number of grids in the file */
+    char grid_names[][STR_SIZE] /* O: names of the grids */
+)
+{
+    char FUNC_NAME[] = "read_modis_grids";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* statement of the current grid name */
+    int count;                  /* number of chars copied in snprintf */
+    Odl_index_t odl;            /* tokenized StructMetadata */
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    if (read_odl_metadata (hdf->sd_id, "StructMetadata", &odl) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the structural metadata of %s",
+            hdf->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_NORTH] = atof (token_buffer);
-            north_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
+    *ngrids = 0;
+    for (i = find_odl_attr (&odl, "GridName"); i != -1;
+         i = odl.attrs[i].next)
+    {
+        if (*ngrids == MAX_MODIS_GRIDS)
+        {
+            sprintf (errmsg, "%s has more than the %d grids supported",
+                hdf->file_name, MAX_MODIS_GRIDS);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_odl (&odl);
+            return (ERROR);
         }
 
-        /* Look for the SOUTHBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "SOUTHBOUNDINGCOORDINATE") &&
-            !south_bound_found)
+        count = snprintf (grid_names[*ngrids], STR_SIZE, "%s",
+            odl.attrs[i].value);
+        if (count < 0 || count >= STR_SIZE)
         {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
-
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_SOUTH] = atof (token_buffer);
-            south_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
+            sprintf (errmsg, "Overflow of grid_names[i] string");
+            error_handler (true, FUNC_NAME, errmsg);
+            free_odl (&odl);
+            return (ERROR);
         }
+        (*ngrids)++;
+    }
 
-        /* Look for the EASTBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "EASTBOUNDINGCOORDINATE") &&
-            !east_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    free_odl (&odl);
+    return (SUCCESS);
+}
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+/******************************************************************************
+MODULE:  open_modis_hdf
+
+PURPOSE: Opens the MODIS HDF-EOS file for reading, once for both the grid
+and the SD interfaces.
 
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening the MODIS file
+SUCCESS         Successfully opened the MODIS file
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+NOTES:
+  1. The SD interface ID is the one HDF-EOS opened along with the grid
+     interface, so it must not be ended with SDend; close_modis_hdf closes
+     both.
+******************************************************************************/
+int open_modis_hdf
+(
+    char *modis_hdf_name,     /* I: name of MODIS file to be opened */
+    Modis_hdf_t *hdf          /* O: open MODIS file */
+)
+{
+    char FUNC_NAME[] = "open_modis_hdf";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int count;                /* number of chars copied in snprintf */
+    int32 hdf_id;             /* HDF file ID of the grid file */
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    count = snprintf (hdf->file_name, sizeof (hdf->file_name), "%s",
+        modis_hdf_name);
+    if (count < 0 || count >= sizeof (hdf->file_name))
+    {
+        sprintf (errmsg, "Overflow of hdf->file_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_EAST] = atof (token_buffer);
-            east_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
-        }
+    /* Open HDF-EOS file for reading */
+    hdf->gd_id = GDopen (modis_hdf_name, DFACC_READ);
+    if (hdf->gd_id < 0)
+    {
+        sprintf (errmsg, "Unable to open %s", modis_hdf_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        /* Look for the WESTBOUNDINGCOORDINATE token */
-        if (!strcmp (token_buffer, "WESTBOUNDINGCOORDINATE") &&
-            !west_bound_found)
-        {
-            /* Read the next three tokens, this should be the
-               NUM_VAL = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    /* Get the SD interface of the open file */
+    if (EHidinfo (hdf->gd_id, &hdf_id, &hdf->sd_id) != 0)
+    {
+        sprintf (errmsg, "Unable to access %s for reading as SDS",
+            modis_hdf_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        GDclose (hdf->gd_id);
+        return (ERROR);
+    }
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+    return (SUCCESS);
+}
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
 
-            /* Read the next three tokens, this should be the
-               VALUE = ... line */
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+/******************************************************************************
+MODULE:  close_modis_hdf
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+PURPOSE: Closes the MODIS HDF-EOS file.
 
-            sscanf (file_data_ptr, "%s%n", token_buffer, &num_chars);
-            file_data_ptr += num_chars;
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error closing the MODIS file
+SUCCESS         Successfully closed the MODIS file
 
-            /* Store the value of the bounding coordinate */
-            bound_coords[ESPA_WEST] = atof (token_buffer);
-            west_bound_found = true;
-            continue;  /* don't waste time looking for the other
-                          bounding rectangles with this token */
-        }
-    }  /* end while */
+NOTES:
+******************************************************************************/
+int close_modis_hdf
+(
+    Modis_hdf_t *hdf          /* I: open MODIS file */
+)
+{
+    char FUNC_NAME[] = "close_modis_hdf";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
 
-    /* Free dynamically allocated memory */
-    free (file_data);
+    if (GDclose (hdf->gd_id) != 0)
+    {
+        sprintf (errmsg, "Closing HDF file %s", hdf->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  read_modis_hdf
+MODULE:  read_modis_file_name
 
-PURPOSE: Read the metadata from the MODIS HDF file and populate the ESPA
-internal metadata structure
+PURPOSE: Reads the product information carried by the MODIS HDF filename
+into the global metadata.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error reading the MODIS file
-SUCCESS         Successfully populated the ESPA metadata structure
+ERROR           Error parsing the filename
+SUCCESS         Successfully parsed the filename
 
 NOTES:
+  1. The data provider, satellite, instrument, acquisition date, and the
+     horizontal and vertical tile numbers come from the filename.
+  2. basename and core_basename must hold STR_SIZE characters.
 ******************************************************************************/
-int read_modis_hdf
+static int read_modis_file_name
 (
-    char *modis_hdf_name,            /* I: name of MODIS file to be read */
-    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
-                                           populated from the MODIS file */
+    char *modis_hdf_name,     /* I: name of the MODIS file */
+    char *basename,           /* O: filename without path (uppercase) */
+    char *core_basename,      /* O: filename without path and extension */
+    Espa_global_meta_t *gmeta /* O: global metadata of the product */
 )
 {
-    char FUNC_NAME[] = "read_modis_hdf";  /* function name */
+    char FUNC_NAME[] = "read_modis_file_name";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    char basename[STR_SIZE];  /* filename without path (uppercase) */
-    char core_basename[STR_SIZE]; /* filename without path and extension */
-    char strbuf[STR_SIZE];    /* temporary buffer to string data */
-    char gridstr[STR_SIZE];   /* list of comma-separated grids in HDF file */
-    char fieldstr[STR_SIZE];  /* list of comma-separated fields in HDF file */
-    char prod_date_time[STR_SIZE];  /* production date/time */
-    char pge_version[STR_SIZE];     /* PGE version */
-    char grid_names[MAX_MODIS_GRIDS][STR_SIZE];  /* array of grid names vs.
-                                 comma-separated list of grids */
-    char modis_bands[MAX_MODIS_BANDS][STR_SIZE]; /* array containing names of
-                                 the MODIS bands/SDSs to be written to the
-                                 ESPA XML file */
-    char longname[MAX_MODIS_BANDS][STR_SIZE]; /* array long_name attributes */
-    char qa_desc[MAX_MODIS_BANDS][HUGE_STR_SIZE]; /* array qa description
-                                                     attributes */
-    char units[MAX_MODIS_BANDS][STR_SIZE];    /* array units attributes */
     char yearstr[5];          /* string to hold the acquisition year */
     char doystr[4];           /* string to hold the acquisition DOY */
     char htile[3];            /* string to hold the horiztonal tile */
     char vtile[3];            /* string to hold the vertical tile */
     char *cptr = NULL;        /* character pointer for strings */
-    char *gridname = NULL;    /* pointer to the current grid name */
-    char *gridend = NULL;     /* pointer to end of current grid name */
-    char *gridlist = NULL;    /* list of grids in the HDF file */
-    char *fieldname = NULL;   /* pointer to the current field name */
-    char *fieldend = NULL;    /* pointer to end of current field name */
-    char *fieldlist = NULL;   /* list of fields in the HDF file */
-    char *dimname = NULL;     /* pointer to the current dimension name */
-
-    int i, j, k;              /* looping variables */
     int count;                /* number of chars copied in snprintf */
     int acq_doy;              /* acquisition DOY */
     int acq_year;             /* acquisition year */
     int acq_month;            /* acquisition month */
     int acq_day;              /* acquisition day */
-    int nmodis_bands;         /* number of bands that will be in the ESPA
-                                 product from the MODIS file */
-    int sdsfield = 0;         /* current SDS field to be processed */
-    int32 fid;                /* file ID for the HDF-EOS file */
-    int32 gid;                /* grid ID for the HDF-EOS file */
-    int32 sd_id;              /* file ID for the HDF file */
-    int32 ngrids;             /* number of grids in the HDF-EOS file */
-    int32 nfields;            /* number of fields/SDSs in the current grid */
-    int32 rank;               /* rank for the current SDS */
-    int32 dtype;              /* datatype for the current SDS */
-    int32 bufsize;            /* size of the returned buffer */
-    int32 status;             /* return status */
-    int32 projcode;           /* projection code */
-    int32 zonecode;           /* UTM zone code */
-    int32 spherecode;         /* sphere code */
-    int32 origincode;         /* grid origin for corner points */
-    int32 xdimsize;           /* x-dimension */
-    int32 ydimsize;           /* y-dimension */
-    int32 tmprank[256];       /* temporary array of dimensions */
-    int32 tmpdtype[256];    /* temporary array of data types */
-    int32 dims[MAX_MODIS_DIMS]; /* dimensions read from the SDS */
-    int32 grid_dims[MAX_MODIS_GRIDS][2];  /* x,y dimensions of current grid */
-    int32 data_type[MAX_MODIS_BANDS];     /* data type for each SDS */
-    double projparm[15];      /* projection parameters */
-    double central_meridian;  /* central meridian for the sinusoidal projection
-                                 (in DMS) */
-    double scalevalue[MAX_MODIS_BANDS];    /* scale factor for current SDS */
-    double offsetvalue[MAX_MODIS_BANDS];   /* offset for current SDS */
-    double minvalue[MAX_MODIS_BANDS];  /* minimum band value for current SDS */
-    double maxvalue[MAX_MODIS_BANDS];  /* maximum band value for current SDS */
-    double fillvalue[MAX_MODIS_BANDS]; /* fill value for current SDS */
-
-    Img_coord_float_t img;        /* image coordinates for current pixel */
-    Geo_coord_t geo;              /* geodetic coordinates (note radians) */
-    Space_def_t geoloc_def;       /* geolocation space information */
-    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
-    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
-                                                       metadata structure */
-    Espa_band_meta_t *bmeta;      /* pointer to the array of bands metadata */
 
     /* Get the basename of the input HDF file */
     cptr = strrchr (modis_hdf_name, '/');
@@ -1144,8 +1040,8 @@ int read_modis_hdf
     {
         /* Copy the basename from the cptr, after moving off of the '/' */
         cptr++;
-        count = snprintf (basename, sizeof (basename), "%s", cptr);
-        if (count < 0 || count >= sizeof (basename))
+        count = snprintf (basename, STR_SIZE, "%s", cptr);
+        if (count < 0 || count >= STR_SIZE)
         {
             sprintf (errmsg, "Overflow of basename string");
             error_handler (true, FUNC_NAME, errmsg);
@@ -1156,8 +1052,8 @@ int read_modis_hdf
     {
         /* Copy the filename itself as the basename since it doesn't have a
            path in the filename */
-        count = snprintf (basename, sizeof (basename), "%s", modis_hdf_name);
-        if (count < 0 || count >= sizeof (basename))
+        count = snprintf (basename, STR_SIZE, "%s", modis_hdf_name);
+        if (count < 0 || count >= STR_SIZE)
         {
             sprintf (errmsg, "Overflow of basename string");
             error_handler (true, FUNC_NAME, errmsg);
@@ -1166,8 +1062,8 @@ int read_modis_hdf
     }
 
     /* Strip the extension off the basename */
-    count = snprintf (core_basename, sizeof (core_basename), "%s", basename);
-    if (count < 0 || count >= sizeof (core_basename))
+    count = snprintf (core_basename, STR_SIZE, "%s", basename);
+    if (count < 0 || count >= STR_SIZE)
     {
         sprintf (errmsg, "Overflow of core_basename string");
         error_handler (true, FUNC_NAME, errmsg);
@@ -1264,25 +1160,188 @@ int read_modis_hdf
     vtile[2] = '\0';
     gmeta->vtile = atoi (vtile);
 
-    /* Open HDF-EOS file for reading */
-    fid = GDopen (modis_hdf_name, DFACC_READ);
-    if (fid < 0)
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_modis_corners
+
+PURPOSE: Computes the geographic UL and LR corners of the MODIS tile from its
+projection corners.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the corners
+SUCCESS         Successfully computed the corners
+
+NOTES:
+  1. The projection information and the bands must be set in the metadata.
+******************************************************************************/
+static int set_modis_corners
+(
+    Espa_internal_meta_t *metadata   /* I/O: metadata of the MODIS file */
+)
+{
+    char FUNC_NAME[] = "set_modis_corners";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Img_coord_float_t img;        /* image coordinates for current pixel */
+    Geo_coord_t geo;              /* geodetic coordinates (note radians) */
+    Space_def_t geoloc_def;       /* geolocation space information */
+    Geoloc_t *geoloc_map = NULL;  /* geolocation mapping information */
+    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = metadata->band;  /* pointer to the array of
+                                                  bands metadata */
+
+    /* Get geolocation information from the XML file (using the first band) to
+       prepare for computing the bounding coordinates */
+    if (!get_geoloc_info (metadata, &geoloc_def))
     {
-        sprintf (errmsg, "Unable to open %s", modis_hdf_name);
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Open as HDF file for reading */
-    sd_id = SDstart (modis_hdf_name, DFACC_RDONLY);
-    if (sd_id < 0)
+    /* Setup the mapping structure */
+    geoloc_map = setup_mapping (&geoloc_def);
+    if (geoloc_map == NULL)
     {
-        sprintf (errmsg, "Unable to open %s for reading as SDS",
-            modis_hdf_name);
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
+    /* Get the geographic coords for the UL corner */
+    img.l = 0.0;
+    img.s = 0.0;
+    img.is_fill = false;
+    if (!from_space (geoloc_map, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping UL corner to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geoloc_map);
+        return (ERROR);
+    }
+    gmeta->ul_corner[0] = geo.lat * DEG;
+    gmeta->ul_corner[1] = geo.lon * DEG;
+
+    /* Get the geographic coords for the LR corner */
+    img.l = bmeta[0].nlines-1;
+    img.s = bmeta[0].nsamps-1;
+    img.is_fill = false;
+    if (!from_space (geoloc_map, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping LR corner to lat/long");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geoloc_map);
+        return (ERROR);
+    }
+    gmeta->lr_corner[0] = geo.lat * DEG;
+    gmeta->lr_corner[1] = geo.lon * DEG;
+
+    /* Free the geolocation structure */
+    free (geoloc_map);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_modis_hdf
+
+PURPOSE: Read the metadata from the MODIS HDF file and populate the ESPA
+internal metadata structure
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the MODIS file
+SUCCESS         Successfully populated the ESPA metadata structure
+
+NOTES:
+  1. The grid information and the SDS attributes are read through the one
+     open MODIS file.
+******************************************************************************/
+int read_modis_hdf
+(
+    Modis_hdf_t *hdf,                /* I: open MODIS file to be read */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the MODIS file */
+)
+{
+    char FUNC_NAME[] = "read_modis_hdf";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *modis_hdf_name = hdf->file_name;  /* name of the MODIS file */
+    char basename[STR_SIZE];  /* filename without path (uppercase) */
+    char core_basename[STR_SIZE]; /* filename without path and extension */
+    char strbuf[STR_SIZE];    /* temporary buffer to string data */
+    char fieldstr[STR_SIZE];  /* list of comma-separated fields in HDF file */
+    char prod_date_time[STR_SIZE];  /* production date/time */
+    char pge_version[STR_SIZE];     /* PGE version */
+    char grid_names[MAX_MODIS_GRIDS][STR_SIZE];  /* array of grid names vs.
+                                 comma-separated list of grids */
+    char modis_bands[MAX_MODIS_BANDS][STR_SIZE]; /* array containing names of
+                                 the MODIS bands/SDSs to be written to the
+                                 ESPA XML file */
+    char longname[MAX_MODIS_BANDS][STR_SIZE]; /* array long_name attributes */
+    char qa_desc[MAX_MODIS_BANDS][HUGE_STR_SIZE]; /* array qa description
+                                                     attributes */
+    char units[MAX_MODIS_BANDS][STR_SIZE];    /* array units attributes */
+    char *gridname = NULL;    /* pointer to the current grid name */
+    char *fieldname = NULL;   /* pointer to the current field name */
+    char *fieldend = NULL;    /* pointer to end of current field name */
+    char *fieldlist = NULL;   /* list of fields in the HDF file */
+    char *dimname = NULL;     /* pointer to the current dimension name */
+
+    int i, j, k;              /* looping variables */
+    int count;                /* number of chars copied in snprintf */
+    int nmodis_bands;         /* number of bands that will be in the ESPA
+                                 product from the MODIS file */
+    int sdsfield = 0;         /* current SDS field to be processed */
+    int32 fid = hdf->gd_id;   /* file ID for the HDF-EOS file */
+    int32 gid;                /* grid ID for the HDF-EOS file */
+    int32 sd_id = hdf->sd_id; /* SD interface ID for the HDF file */
+    int32 ngrids;             /* number of grids in the HDF-EOS file */
+    int32 nfields;            /* number of fields/SDSs in the current grid */
+    int32 rank;               /* rank for the current SDS */
+    int32 dtype;              /* datatype for the current SDS */
+    int32 status;             /* return status */
+    int32 projcode;           /* projection code */
+    int32 zonecode;           /* UTM zone code */
+    int32 spherecode;         /* sphere code */
+    int32 origincode;         /* grid origin for corner points */
+    int32 xdimsize;           /* x-dimension */
+    int32 ydimsize;           /* y-dimension */
+    int32 tmprank[256];       /* temporary array of dimensions */
+    int32 tmpdtype[256];    /* temporary array of data types */
+    int32 dims[MAX_MODIS_DIMS]; /* dimensions read from the SDS */
+    int32 grid_dims[MAX_MODIS_GRIDS][2];  /* x,y dimensions of current grid */
+    int32 data_type[MAX_MODIS_BANDS];     /* data type for each SDS */
+    double projparm[15];      /* projection parameters */
+    double central_meridian;  /* central meridian for the sinusoidal projection
+                                 (in DMS) */
+    double scalevalue[MAX_MODIS_BANDS];    /* scale factor for current SDS */
+    double offsetvalue[MAX_MODIS_BANDS];   /* offset for current SDS */
+    double minvalue[MAX_MODIS_BANDS];  /* minimum band value for current SDS */
+    double maxvalue[MAX_MODIS_BANDS];  /* maximum band value for current SDS */
+    double fillvalue[MAX_MODIS_BANDS]; /* fill value for current SDS */
+
+    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta;      /* pointer to the array of bands metadata */
+
+    /* Get the product information from the HDF filename */
+    if (read_modis_file_name (modis_hdf_name, basename, core_basename, gmeta)
+        != SUCCESS)
+    {   /* Error messages already written */
+        return (ERROR);
+    }
+
     /* Read the production date/time and PGE version from the core metadata */
     status = read_core_metadata (sd_id, prod_date_time, pge_version);
     if (status != SUCCESS)
@@ -1302,12 +1361,16 @@ int read_modis_hdf
     }
 
     /* Get the list of grids in the HDF-EOS file */
-    ngrids = GDinqgrid (modis_hdf_name, gridstr, &bufsize);
-    gridlist = gridstr;
+    if (read_modis_grids (hdf, &ngrids, grid_names) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the grids of the HDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
     /* Check if there are any grids. If no data in the grid then most likely
        this is swath or point data. This application only supports grid data. */
-    if (ngrids < 1 || strlen (gridlist) < 1)
+    if (ngrids < 1)
     {
         sprintf (errmsg, "No grid data found in %s. This application only "
             "supports gridded HDF-EOS data, not swath or point HDF-EOS data.",
@@ -1320,21 +1383,8 @@ int read_modis_hdf
     nmodis_bands = 0;
     for (i = 0; i < ngrids; i++)
     {
-        /* Get next grid name from comma-separated gridlist */
-        gridname = gridlist;
-        gridend = strchr (gridlist, ',');
-        if (gridend != NULL)
-        {
-            gridlist = gridend + 1;
-            *gridend = '\0';
-        }
-        count = snprintf (grid_names[i], sizeof(grid_names[i]), "%s", gridname);
-        if (count < 0 || count >= sizeof (grid_names[i]))
-        {
-            sprintf (errmsg, "Overflow of grid_names[i] string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        /* Get next grid name */
+        gridname = grid_names[i];
 
         /* Attach to next grid */
         gid = GDattach (fid, gridname);
@@ -1429,15 +1479,6 @@ int read_modis_hdf
         GDdetach (gid);
     }  /* end for i loop through ngrids */
 
-    /* Close the HDF file */
-    status = SDend (sd_id);
-    if (status != 0)
-    {
-        sprintf (errmsg, "Closing HDF file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* Allocate bands for the XML structure */
     metadata->nbands = nmodis_bands;
     if (allocate_band_metadata (metadata, metadata->nbands) != SUCCESS)
@@ -1664,129 +1705,741 @@ int read_modis_hdf
                 return (ERROR);
             }
 
-            count = snprintf (bmeta[nmodis_bands].data_units,
-                sizeof (bmeta[nmodis_bands].data_units), "%s",
-                units[nmodis_bands]);
-            if (count < 0 || count >= sizeof (bmeta[nmodis_bands].data_units))
-            {
-                sprintf (errmsg, "Overflow of bmeta[].data_units string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            count = snprintf (bmeta[nmodis_bands].data_units,
+                sizeof (bmeta[nmodis_bands].data_units), "%s",
+                units[nmodis_bands]);
+            if (count < 0 || count >= sizeof (bmeta[nmodis_bands].data_units))
+            {
+                sprintf (errmsg, "Overflow of bmeta[].data_units string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Get the QA description information.  If it's not fill, then
+               this is a QA band and change the category to flag that.  The
+               MOD13 products also use Legend for "MIR reflectance" SDSs to
+               provide additional information, but these aren't QA bands. */
+            count = snprintf (bmeta[nmodis_bands].qa_desc,
+                sizeof (bmeta[nmodis_bands].qa_desc), "%s",
+                qa_desc[nmodis_bands]);
+            if (count < 0 || count >= sizeof (bmeta[nmodis_bands].qa_desc))
+            {
+                sprintf (errmsg, "Overflow of bmeta[].qa_desc string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (strcmp (bmeta[nmodis_bands].qa_desc, ESPA_STRING_META_FILL) &&
+                !strstr (bmeta[nmodis_bands].name, "MIR reflectance"))
+                strcpy (bmeta[nmodis_bands].category, "qa");
+
+            /* Add the production date/time and PGE version from the core
+               metadata */
+            count = snprintf (bmeta[nmodis_bands].production_date,
+                sizeof (bmeta[nmodis_bands].production_date), "%s",
+                prod_date_time);
+            if (count < 0 ||
+                count >= sizeof (bmeta[nmodis_bands].production_date))
+            {
+                sprintf (errmsg, "Overflow of bmeta[].production_date string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            count = snprintf (bmeta[nmodis_bands].app_version,
+                sizeof (bmeta[nmodis_bands].app_version), "PGE Version %s",
+                pge_version);
+            if (count < 0 ||
+                count >= sizeof (bmeta[nmodis_bands].app_version))
+            {
+                sprintf (errmsg, "Overflow of bmeta[].app_version string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Increment the overall band/SDS count */
+            nmodis_bands++;
+        }  /* end for j loop through nfields */
+
+        /* Close grid */
+        GDdetach (gid);
+    }  /* end for i (loop through the grids) */
+
+    /* Set the orientation angle to 0.0 */
+    gmeta->orientation_angle = 0.0;
+
+    /* Compute the geographic corners of the tile */
+    if (set_modis_corners (metadata) != SUCCESS)
+    {   /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Successful read */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_modis_product_key
+
+PURPOSE: Gets the key of the MODIS product from the basename of the file: the
+short name and the collection, e.g. MOD09GA.006 for
+MOD09GA.A2013241.h08v05.006.2015251120055.HDF.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A basename with fewer than four fields gives its first field as the
+     key.
+******************************************************************************/
+static void get_modis_product_key
+(
+    char *basename,           /* I: filename without path (uppercase) */
+    char *product_key         /* O: key of the product (STR_SIZE characters) */
+)
+{
+    char *first = NULL;       /* end of the short name */
+    char *ptr = NULL;         /* start of the collection */
+    char *end = NULL;         /* end of the collection */
+    int field;                /* looping variable for the fields */
+
+    snprintf (product_key, STR_SIZE, "%s", basename);
+    first = strchr (product_key, '.');
+    if (first == NULL)
+        return;
+
+    /* Skip the acquisition date and the tile to get to the collection */
+    ptr = first;
+    for (field = 1; field < 3 && ptr != NULL; field++)
+        ptr = strchr (ptr + 1, '.');
+    if (ptr == NULL)
+    {
+        *first = '\0';
+        return;
+    }
+    end = strchr (ptr + 1, '.');
+    if (end != NULL)
+        *end = '\0';
+    memmove (first, ptr, strlen (ptr) + 1);
+}
+
+
+/******************************************************************************
+MODULE:  read_modis_layout
+
+PURPOSE: Reads the grid and SDS layout of the MODIS file: its grids, the SDSs
+and dimensions of each grid, and the projection and corners of the first
+grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the layout
+SUCCESS         Successfully read the layout
+
+NOTES:
+  1. This only goes through the grid interface, without selecting any SDS
+     or reading any of their attributes.
+******************************************************************************/
+static int read_modis_layout
+(
+    Modis_hdf_t *hdf,         /* I: open MODIS HDF file */
+    Modis_layout_t *layout    /* O: layout of the file */
+)
+{
+    char FUNC_NAME[] = "read_modis_layout";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the grids */
+    int32 gid;                /* grid ID for the HDF-EOS file */
+    int32 nfields;            /* number of fields/SDSs in the current grid */
+    int32 zonecode;           /* UTM zone code */
+    int32 tmprank[256];       /* temporary array of dimensions */
+    int32 tmpdtype[256];      /* temporary array of data types */
+    double ul_corner[2];      /* projection UL x, y of the current grid */
+    double lr_corner[2];      /* projection LR x, y of the current grid */
+
+    if (read_modis_grids (hdf, &layout->ngrids, layout->grid_names) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading the grids of the HDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < layout->ngrids; i++)
+    {
+        gid = GDattach (hdf->gd_id, layout->grid_names[i]);
+        if (gid < 0)
+        {
+            sprintf (errmsg, "Unable to attach to grid %s",
+                layout->grid_names[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Get the list of fields and the dimensions of this grid */
+        nfields = GDinqfields (gid, layout->field_list[i], tmprank,
+            tmpdtype);
+        if (nfields < 0 || GDgridinfo (gid, &layout->grid_dims[i][0],
+            &layout->grid_dims[i][1], ul_corner, lr_corner) != 0)
+        {
+            sprintf (errmsg, "Reading the fields and dimensions of grid %s",
+                layout->grid_names[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            GDdetach (gid);
+            return (ERROR);
+        }
+
+        /* The projection and corners are those of the first grid, as in
+           read_modis_hdf */
+        if (i == 0)
+        {
+            if (GDprojinfo (gid, &layout->projcode, &zonecode,
+                &layout->spherecode, layout->projparm) != 0)
+            {
+                sprintf (errmsg, "Reading grid projection information from "
+                    "HDF header");
+                error_handler (true, FUNC_NAME, errmsg);
+                GDdetach (gid);
+                return (ERROR);
+            }
+            layout->ul_corner[0] = ul_corner[0];
+            layout->ul_corner[1] = ul_corner[1];
+            layout->lr_corner[0] = lr_corner[0];
+            layout->lr_corner[1] = lr_corner[1];
+        }
+
+        GDdetach (gid);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  match_modis_layout
+
+PURPOSE: Checks whether two MODIS files have the same grid and SDS layout.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The layouts differ
+true            The layouts match
+
+NOTES:
+  1. The corners aren't compared, since they differ for each tile.
+******************************************************************************/
+static bool match_modis_layout
+(
+    Modis_layout_t *layout1,  /* I: layout of the first file */
+    Modis_layout_t *layout2   /* I: layout of the second file */
+)
+{
+    int i;                    /* looping variable */
+
+    if (layout1->ngrids != layout2->ngrids ||
+        layout1->projcode != layout2->projcode ||
+        layout1->spherecode != layout2->spherecode)
+        return (false);
+
+    for (i = 0; i < 15; i++)
+    {
+        if (layout1->projparm[i] != layout2->projparm[i])
+            return (false);
+    }
+
+    for (i = 0; i < layout1->ngrids; i++)
+    {
+        if (strcmp (layout1->grid_names[i], layout2->grid_names[i]) ||
+            strcmp (layout1->field_list[i], layout2->field_list[i]) ||
+            layout1->grid_dims[i][0] != layout2->grid_dims[i][0] ||
+            layout1->grid_dims[i][1] != layout2->grid_dims[i][1])
+            return (false);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  init_modis_template
+
+PURPOSE: Initializes an empty MODIS product template.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void init_modis_template
+(
+    Modis_template_t *tmpl    /* O: empty template */
+)
+{
+    tmpl->valid = false;
+    tmpl->product_key[0] = '\0';
+    tmpl->nbands = 0;
+    tmpl->band = NULL;
+    tmpl->core_len = 0;
+}
+
+
+/******************************************************************************
+MODULE:  free_modis_template
+
+PURPOSE: Frees the MODIS product template and empties it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void free_modis_template
+(
+    Modis_template_t *tmpl    /* I/O: template to be freed */
+)
+{
+    free (tmpl->band);
+    init_modis_template (tmpl);
+}
+
+
+/******************************************************************************
+MODULE:  set_modis_template
+
+PURPOSE: Makes the metadata of a MODIS file read in full the template of its
+product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the template
+SUCCESS         Successfully set the template
+
+NOTES:
+  1. The MODIS bands have no bitmap, class or percent cover metadata, so
+     the band metadata is copied as is, apart from the arena, which belongs
+     to the metadata of the file.
+******************************************************************************/
+static int set_modis_template
+(
+    char *product_key,        /* I: key of the product */
+    char *core_basename,      /* I: filename without path and extension */
+    Modis_layout_t *layout,   /* I: layout of the file */
+    Espa_internal_meta_t *metadata,  /* I: metadata of the file */
+    Modis_template_t *tmpl    /* I/O: template of the product */
+)
+{
+    char FUNC_NAME[] = "set_modis_template";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable for the bands */
+    Espa_band_meta_t *band = NULL;  /* copy of the band metadata */
+
+    band = malloc (metadata->nbands * sizeof (Espa_band_meta_t));
+    if (band == NULL)
+    {
+        sprintf (errmsg, "Allocating the band metadata of the template");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    memcpy (band, metadata->band, metadata->nbands *
+        sizeof (Espa_band_meta_t));
+    for (i = 0; i < metadata->nbands; i++)
+        band[i].arena = NULL;
+
+    free_modis_template (tmpl);
+    snprintf (tmpl->product_key, sizeof (tmpl->product_key), "%s",
+        product_key);
+    tmpl->layout = *layout;
+    tmpl->global = metadata->global;
+    tmpl->nbands = metadata->nbands;
+    tmpl->band = band;
+    tmpl->core_len = strlen (core_basename);
+    tmpl->valid = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_modis_hdf_template
+
+PURPOSE: Reads the metadata of a MODIS file through the template of its
+product, reading only the fields which differ between tiles.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the MODIS file
+SUCCESS         Successfully populated the ESPA metadata structure
+
+NOTES:
+  1. The file's grid and SDS layout is compared with the template's.  If it
+     isn't of the template's product (short name and collection) or the
+     layout differs, or the template is empty, the file is read in full by
+     read_modis_hdf and becomes the template.
+  2. Otherwise the SDS discovery, the SDS attributes (scale, offset, range,
+     fill, long name, units and QA description), the data types and the
+     band names come from the template.  Only the acquisition date and tile
+     numbers (from the filename), the production date/time and PGE version
+     (core metadata), the bounding coordinates (archive metadata), the
+     projection corners, and the band filenames and pixel sizes are set for
+     the tile.
+******************************************************************************/
+int read_modis_hdf_template
+(
+    Modis_hdf_t *hdf,                /* I: open MODIS file to be read */
+    Modis_template_t *tmpl,          /* I/O: template of the product */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the MODIS file */
+)
+{
+    char FUNC_NAME[] = "read_modis_hdf_template";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char basename[STR_SIZE];  /* filename without path (uppercase) */
+    char core_basename[STR_SIZE]; /* filename without path and extension */
+    char product_key[STR_SIZE];     /* key of the file's product */
+    char prod_date_time[STR_SIZE];  /* production date/time */
+    char pge_version[STR_SIZE];     /* PGE version */
+    int i;                    /* looping variable for the bands */
+    int count;                /* number of chars copied in snprintf */
+    Modis_layout_t layout;    /* layout of the file */
+    Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to the band metadata */
+
+    /* Start from the template's global metadata; the fields of the tile are
+       set from here on */
+    if (tmpl->valid)
+        *gmeta = tmpl->global;
+
+    /* Get the product information from the HDF filename and the layout of
+       the file */
+    if (read_modis_file_name (hdf->file_name, basename, core_basename, gmeta)
+        != SUCCESS)
+    {   /* Error messages already written */
+        return (ERROR);
+    }
+    get_modis_product_key (basename, product_key);
+
+    if (read_modis_layout (hdf, &layout) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the layout of %s", hdf->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Read the file in full, and make it the template, unless it matches
+       the template */
+    if (!tmpl->valid || strcmp (product_key, tmpl->product_key) ||
+        !match_modis_layout (&layout, &tmpl->layout))
+    {
+        init_metadata_struct (metadata);
+        if (read_modis_hdf (hdf, metadata) != SUCCESS)
+        {   /* Error messages already written */
+            return (ERROR);
+        }
+
+        if (set_modis_template (product_key, core_basename, &layout,
+            metadata, tmpl) != SUCCESS)
+        {   /* Error messages already written */
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+
+    /* Read the production date/time and PGE version from the core metadata,
+       and the bounding coordinates from the archive metadata */
+    if (read_core_metadata (hdf->sd_id, prod_date_time, pge_version) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading the core metadata from the HDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < 4; i++)
+        gmeta->bounding_coords[i] = ESPA_FLOAT_META_FILL;
+    if (read_archive_metadata (hdf->sd_id, gmeta->bounding_coords) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading the archive metadata from the HDF file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Projection corners of the tile */
+    gmeta->proj_info.ul_corner[0] = layout.ul_corner[0];
+    gmeta->proj_info.ul_corner[1] = layout.ul_corner[1];
+    gmeta->proj_info.lr_corner[0] = layout.lr_corner[0];
+    gmeta->proj_info.lr_corner[1] = layout.lr_corner[1];
+
+    /* Copy the bands of the template */
+    if (allocate_band_metadata (metadata, tmpl->nbands) != SUCCESS)
+    {   /* Error messages already printed */
+        return (ERROR);
+    }
+    bmeta = metadata->band;
+
+    /* The band filenames are the tile's core basename followed by the SDS
+       part of the template's filenames, which was already cleaned up */
+    cleanup_file_name (core_basename);
+    for (i = 0; i < tmpl->nbands; i++)
+    {
+        memcpy (&bmeta[i], &tmpl->band[i], sizeof (Espa_band_meta_t));
+        bmeta[i].arena = metadata->arena;
+
+        count = snprintf (bmeta[i].file_name, sizeof (bmeta[i].file_name),
+            "%s%s", core_basename, &tmpl->band[i].file_name[tmpl->core_len]);
+        if (count < 0 || count >= sizeof (bmeta[i].file_name))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Compute the pixel size */
+        bmeta[i].pixel_size[1] = (gmeta->proj_info.ul_corner[1] -
+            gmeta->proj_info.lr_corner[1]) / bmeta[i].nlines;
+        bmeta[i].pixel_size[0] = (gmeta->proj_info.lr_corner[0] -
+            gmeta->proj_info.ul_corner[0]) / bmeta[i].nsamps;
+
+        /* Add the production date/time and PGE version from the core
+           metadata */
+        count = snprintf (bmeta[i].production_date,
+            sizeof (bmeta[i].production_date), "%s", prod_date_time);
+        if (count < 0 || count >= sizeof (bmeta[i].production_date))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].production_date string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        count = snprintf (bmeta[i].app_version,
+            sizeof (bmeta[i].app_version), "PGE Version %s", pge_version);
+        if (count < 0 || count >= sizeof (bmeta[i].app_version))
+        {
+            sprintf (errmsg, "Overflow of bmeta[].app_version string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Compute the geographic corners of the tile */
+    if (set_modis_corners (metadata) != SUCCESS)
+    {   /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/* Block written by write_modis_block_task */
+typedef struct
+{
+    FILE *fp_rb;              /* raw binary file */
+    int nlines;               /* number of lines in the block */
+    int nsamps;               /* number of samples in each line */
+    int nbytes;               /* number of bytes per pixel */
+    void *buf;                /* block to be written */
+} Modis_block_write_t;
+
+/******************************************************************************
+MODULE:  write_modis_block_task
+
+PURPOSE: Writes a block of an SDS to the raw binary file, as a task of the
+task runtime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the block
+SUCCESS         Successfully wrote the block
+
+NOTES:
+******************************************************************************/
+static int write_modis_block_task
+(
+    void *arg                 /* I: block to be written
+                                    (Modis_block_write_t) */
+)
+{
+    Modis_block_write_t *block = arg;  /* block to be written */
+
+    return (write_raw_binary (block->fp_rb, block->nlines, block->nsamps,
+        block->nbytes, block->buf));
+}
 
-            /* Get the QA description information.  If it's not fill, then
-               this is a QA band and change the category to flag that.  The
-               MOD13 products also use Legend for "MIR reflectance" SDSs to
-               provide additional information, but these aren't QA bands. */
-            count = snprintf (bmeta[nmodis_bands].qa_desc,
-                sizeof (bmeta[nmodis_bands].qa_desc), "%s",
-                qa_desc[nmodis_bands]);
-            if (count < 0 || count >= sizeof (bmeta[nmodis_bands].qa_desc))
-            {
-                sprintf (errmsg, "Overflow of bmeta[].qa_desc string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            if (strcmp (bmeta[nmodis_bands].qa_desc, ESPA_STRING_META_FILL) &&
-                !strstr (bmeta[nmodis_bands].name, "MIR reflectance"))
-                strcpy (bmeta[nmodis_bands].category, "qa");
 
-            /* Add the production date/time and PGE version from the core
-               metadata */
-            count = snprintf (bmeta[nmodis_bands].production_date,
-                sizeof (bmeta[nmodis_bands].production_date), "%s",
-                prod_date_time);
-            if (count < 0 ||
-                count >= sizeof (bmeta[nmodis_bands].production_date))
-            {
-                sprintf (errmsg, "Overflow of bmeta[].production_date string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+/* Chunk layout of an SDS, as read by read_modis_block */
+typedef struct
+{
+    int block_lines;          /* number of lines read at a time; a multiple
+                                 of chunk_lines for chunked SDSs */
+    int chunk_lines;          /* number of lines in a row of chunks; 0 if
+                                 the SDS isn't chunked */
+    bool read_chunks;         /* are the chunks as wide as the SDS, so they
+                                 are read whole with SDreadchunk? */
+} Modis_sds_chunks_t;
 
-            count = snprintf (bmeta[nmodis_bands].app_version,
-                sizeof (bmeta[nmodis_bands].app_version), "PGE Version %s",
-                pge_version);
-            if (count < 0 ||
-                count >= sizeof (bmeta[nmodis_bands].app_version))
-            {
-                sprintf (errmsg, "Overflow of bmeta[].app_version string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+/******************************************************************************
+MODULE:  get_modis_sds_chunks
 
-            /* Increment the overall band/SDS count */
-            nmodis_bands++;
-        }  /* end for j loop through nfields */
+PURPOSE: Gets the chunk layout of an SDS and sets up its chunk cache, so each
+chunk is decompressed only once while the SDS is read in blocks of lines.
 
-        /* Close grid */
-        GDdetach (gid);
-    }  /* end for i (loop through the grids) */
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the chunk information or setting the chunk
+                cache
+SUCCESS         Successfully set up the chunk layout
 
-    /* Close the HDF-EOS file */
-    GDclose (fid);
+NOTES:
+  1. The blocks of a chunked SDS are whole rows of chunks, the most that fit
+     in MODIS_LINE_BLOCK lines, or a single row of chunks if it has more
+     lines.  A block that starts or ends inside a row of chunks would
+     decompress the chunks of that row for both blocks.
+  2. The chunk cache holds a whole row of chunks, so SDreaddata decompresses
+     each chunk of the row once rather than once per line it reads.
+  3. Chunks as wide as the SDS, and not NBIT packed, are already laid out as
+     lines, so they are read with SDreadchunk straight into the block buffer
+     without going through the chunk cache.
+******************************************************************************/
+static int get_modis_sds_chunks
+(
+    int32 sds_id,             /* I: SDS ID in the HDF file */
+    Espa_band_meta_t *bmeta,  /* I: band metadata of the SDS */
+    Modis_sds_chunks_t *chunks  /* O: chunk layout of the SDS */
+)
+{
+    char FUNC_NAME[] = "get_modis_sds_chunks";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    HDF_CHUNK_DEF chunk_def;  /* chunking definition of the SDS */
+    int32 flags;              /* chunking and compression flags */
+    int32 nchunks;            /* number of chunks in a row of chunks */
+    int chunk_samps;          /* number of samples in a chunk */
 
-    /* Set the orientation angle to 0.0 */
-    gmeta->orientation_angle = 0.0;
+    chunks->block_lines = MODIS_LINE_BLOCK;
+    chunks->chunk_lines = 0;
+    chunks->read_chunks = false;
 
-    /* Get geolocation information from the XML file (using the first band) to
-       prepare for computing the bounding coordinates */
-    if (!get_geoloc_info (metadata, &geoloc_def))
+    if (SDgetchunkinfo (sds_id, &chunk_def, &flags) == FAIL)
     {
-        sprintf (errmsg, "Copying the geolocation information from the XML "
-            "metadata structure.");
+        sprintf (errmsg, "Getting the chunk information of the SDS: %s",
+            bmeta->name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    if (flags == HDF_NONE)
+        return (SUCCESS);
 
-    /* Setup the mapping structure */
-    geoloc_map = setup_mapping (&geoloc_def);
-    if (geoloc_map == NULL)
+    chunks->chunk_lines = chunk_def.chunk_lengths[0];
+    chunk_samps = chunk_def.chunk_lengths[1];
+    if (chunks->chunk_lines <= 0 || chunk_samps <= 0)
     {
-        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        sprintf (errmsg, "Invalid %d x %d chunks in the SDS: %s",
+            chunks->chunk_lines, chunk_samps, bmeta->name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Get the geographic coords for the UL corner */
-    img.l = 0.0;
-    img.s = 0.0;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    if (chunks->chunk_lines < MODIS_LINE_BLOCK)
+        chunks->block_lines = (MODIS_LINE_BLOCK / chunks->chunk_lines) *
+            chunks->chunk_lines;
+    else
+        chunks->block_lines = chunks->chunk_lines;
+
+    chunks->read_chunks = (chunk_samps == bmeta->nsamps &&
+        (flags == HDF_CHUNK || flags == (HDF_CHUNK | HDF_COMP)));
+    if (chunks->read_chunks)
+        return (SUCCESS);
+
+    nchunks = (bmeta->nsamps + chunk_samps - 1) / chunk_samps;
+    if (SDsetchunkcache (sds_id, nchunks, 0) == FAIL)
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
+        sprintf (errmsg, "Setting the chunk cache of the SDS: %s",
+            bmeta->name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    gmeta->ul_corner[0] = geo.lat * DEG;
-    gmeta->ul_corner[1] = geo.lon * DEG;
 
-    /* Get the geographic coords for the LR corner */
-    img.l = bmeta[0].nlines-1;
-    img.s = bmeta[0].nsamps-1;
-    img.is_fill = false;
-    if (!from_space (geoloc_map, &img, &geo))
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_modis_block
+
+PURPOSE: Reads a block of lines of an SDS, a whole row of chunks at a time for
+chunked SDSs.
+
+RETURN VALUE:
+Type = int32
+Value           Description
+-----           -----------
+-1              Error reading the block
+0               Successfully read the block
+
+NOTES:
+  1. The block must start at a multiple of chunks->block_lines, and buf must
+     have room for chunks->block_lines lines.  Chunks read with SDreadchunk
+     are whole, so the last row of chunks may fill buf past nlines.
+******************************************************************************/
+static int32 read_modis_block
+(
+    int32 sds_id,             /* I: SDS ID in the HDF file */
+    Modis_sds_chunks_t *chunks,  /* I: chunk layout of the SDS */
+    int line,                 /* I: first line of the block */
+    int nlines,               /* I: number of lines in the block */
+    int nsamps,               /* I: number of samples in each line */
+    int nbytes,               /* I: number of bytes per pixel */
+    uint8 *buf                /* O: block of lines */
+)
+{
+    int chunk_line;           /* first line of the current row of chunks */
+    int32 start[2];           /* starting point to read SDS data */
+    int32 edges[2];           /* number of values to read in SDS data */
+    int32 origin[2];          /* chunk coordinates of the chunk to read */
+
+    if (!chunks->read_chunks)
     {
-        sprintf (errmsg, "Mapping UL corner to lat/long");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        start[0] = line;
+        start[1] = 0;
+        edges[0] = nlines;
+        edges[1] = nsamps;
+        return (SDreaddata (sds_id, start, NULL, edges, buf));
     }
-    gmeta->lr_corner[0] = geo.lat * DEG;
-    gmeta->lr_corner[1] = geo.lon * DEG;
 
-    /* Free the geolocation structure */
-    free (geoloc_map);
+    for (chunk_line = line; chunk_line < line + nlines;
+         chunk_line += chunks->chunk_lines)
+    {
+        origin[0] = chunk_line / chunks->chunk_lines;
+        origin[1] = 0;
+        if (SDreadchunk (sds_id, origin, buf + (size_t) (chunk_line - line) *
+            nsamps * nbytes) == FAIL)
+            return (-1);
+    }
 
-    /* Successful read */
-    return (SUCCESS);
+    return (0);
 }
 
 
 /******************************************************************************
-MODULE:  convert_hdf_to_img
+MODULE:  convert_hdf_bands
 
-PURPOSE: Convert the MODIS HDF SDS to an ESPA raw binary (.img) file and writes
-the associated ENVI header for each band.
+PURPOSE: Convert a subset of the MODIS HDF SDSs to ESPA raw binary (.img)
+files and writes the associated ENVI header for each band.  The bands
+first_band, first_band + band_step, first_band + 2*band_step, ... in the XML
+metadata are converted.
 
 RETURN VALUE:
 Type = int
@@ -1796,49 +2449,75 @@ ERROR           Error converting the MODIS SDS
 SUCCESS         Successfully converted MODIS SDS to raw binary
 
 NOTES:
+  1. The HDF file is opened by the caller; each worker process has its own
+     HDF file handle.
+  2. Each SDS is read and written MODIS_LINE_BLOCK lines at a time, so only
+     two block buffers are held in memory instead of the entire SDS.  The
+     blocks of chunked SDSs are aligned to the rows of chunks, so each chunk
+     is decompressed once (see get_modis_sds_chunks).
+  3. When threading is enabled the current block is written to the raw
+     binary file by a task of the task runtime (see espa_task.h) while the
+     next block is read from the SDS, alternating between the two block
+     buffers.  All HDF calls are made by this thread, since the HDF library
+     is not thread-safe.
+  4. The SDSs of the scaled bands (see espa_ingest_scale.h) are read as
+     their digital numbers, and each block is scaled to the data type of the
+     band metadata before it's written.
+  5. The ENVI headers are added to hdr_batch, in the slot of each band, and
+     it's up to the caller to flush the batch (see convert_hdf_band_set).
 ******************************************************************************/
-int convert_hdf_to_img
+static int convert_hdf_bands
 (
-    char *modis_hdf_name,      /* I: name of MODIS file to be processed */
-    Espa_internal_meta_t *xml_metadata /* I: metadata structure for HDF file */
+    int32 sd_id,               /* I: SD interface ID for the HDF file */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                              file */
+    const Ingest_band_scale_t *scales,  /* I: scaling of each band; NULL to
+                                     write the digital numbers */
+    int first_band,            /* I: index of the first band to convert */
+    int band_step,             /* I: step between the bands to convert */
+    Envi_hdr_batch_t *hdr_batch  /* I/O: batch the ENVI headers are added
+                                     to */
 )
 {
-    char FUNC_NAME[] = "convert_hdf_to_img";  /* function name */
+    char FUNC_NAME[] = "convert_hdf_bands";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
     char *cptr = NULL;        /* pointer to the file extension */
     char *img_file = NULL;    /* name of the output raw binary file */
     char envi_file[STR_SIZE]; /* name of the output ENVI header file */
     int i;                    /* looping variable for bands in XML file */
     int nbytes;               /* number of bytes in the data type */
+    int out_nbytes;           /* number of bytes in the data type written */
     int count;                /* number of chars copied in snprintf */
-    int32 sd_id;              /* file ID for the HDF file */
+    int line;                 /* starting line of the current block */
+    int nblock_lines;         /* number of lines in the current block */
+    int next_nblock_lines;    /* number of lines in the next block */
+    int curr_buf;             /* index of the buffer for the current block */
+    int write_status;         /* return status of the raw binary write */
+    Modis_block_write_t curr_block;  /* current block being written */
+    Espa_task_group_t write_group;   /* write of the current block */
+    Modis_sds_chunks_t chunks;       /* chunk layout of the SDS */
     int32 sds_id;             /* SDS ID in the HDF file */
     int32 sds_index;          /* index of current SDS name */
-    int32 start[2];           /* starting point to read SDS data */
-    int32 edges[2];           /* number of values to read in SDS data */
     int32 status;             /* return status of the HDF function */
-    void *file_buf = NULL;    /* pointer to correct input file buffer */
+    uint8 *file_buf[2] = {NULL, NULL};  /* block buffers for reading the SDS
+                                 and writing the raw binary file, sized based
+                                 on the data type */
+    uint8 *out_buf[2] = {NULL, NULL};  /* block buffers of the scaled values;
+                                 the read buffers if the band isn't scaled */
+    enum Espa_data_type in_type;  /* data type of the SDS */
+    const Ingest_band_scale_t *scale;  /* scaling of the band */
     FILE *fp_rb = NULL;       /* file pointer for the raw binary file */
     Envi_header_t envi_hdr;   /* output ENVI header information */
     Espa_band_meta_t *bmeta = NULL;  /* pointer to band metadata */
     Espa_global_meta_t *gmeta = &xml_metadata->global;  /* global metadata */
 
-    /* Open as HDF file for reading */
-    sd_id = SDstart (modis_hdf_name, DFACC_RDONLY);
-    if (sd_id < 0)
-    {
-        sprintf (errmsg, "Unable to open %s for reading as SDS",
-            modis_hdf_name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* Loop through the bands in the metadata file and convert each on to
        the ESPA format */
-    for (i = 0; i < xml_metadata->nbands; i++)
+    for (i = first_band; i < xml_metadata->nbands; i += band_step)
     {
         /* Set up the band metadata pointer */
         bmeta = &xml_metadata->band[i];
+        scale = get_ingest_band_scale (scales, i);
 
         /* Find the SDS name */
         sds_index = SDnametoindex (sd_id, bmeta->name);
@@ -1859,6 +2538,15 @@ int convert_hdf_to_img
             return (ERROR);
         }
 
+        /* Get the chunk layout, which sets the size of the blocks */
+        if (get_modis_sds_chunks (sds_id, bmeta, &chunks) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting up the reads of the SDS: %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
         /* Open the raw binary file for writing */
         img_file = bmeta->file_name;
         fp_rb = open_raw_binary (img_file, "wb");
@@ -1870,61 +2558,137 @@ int convert_hdf_to_img
             return (ERROR);
         }
 
-        /* Allocate memory for the entire image, based on the input data type.
-           Since HDF reading works off of a void pointer and the raw binary
-           write works off of a void pointer, there's no need to use a data
-           type specific pointer for reading/writing memory.  Just make sure
-           there are enough bytes for reading the data, based on the data
+        /* Allocate memory for two blocks of lines, based on the input data
+           type.  Since HDF reading works off of a void pointer and the raw
+           binary write works off of a void pointer, there's no need to use a
+           data type specific pointer for reading/writing memory.  Just make
+           sure there are enough bytes for reading the data, based on the data
            type. */
-        if (bmeta->data_type == ESPA_UINT8 || bmeta->data_type == ESPA_INT8)
+        in_type = (scale != NULL) ? scale->in_type : bmeta->data_type;
+        if (in_type == ESPA_UINT8 || in_type == ESPA_INT8)
             nbytes = sizeof (uint8);
-        else if (bmeta->data_type == ESPA_UINT16 ||
-            bmeta->data_type == ESPA_INT16)
+        else if (in_type == ESPA_UINT16 || in_type == ESPA_INT16)
             nbytes = sizeof (uint16);
-        else if (bmeta->data_type == ESPA_UINT32 ||
-            bmeta->data_type == ESPA_INT32)
+        else if (in_type == ESPA_UINT32 || in_type == ESPA_INT32)
             nbytes = sizeof (uint32);
-        else if (bmeta->data_type == ESPA_FLOAT32)
+        else if (in_type == ESPA_FLOAT32)
             nbytes = sizeof (float32);
-        else if (bmeta->data_type == ESPA_FLOAT64)
+        else if (in_type == ESPA_FLOAT64)
             nbytes = sizeof (float64);
         else
         {
-            sprintf (errmsg, "Unsupported data type %d.", bmeta->data_type);
+            sprintf (errmsg, "Unsupported data type %d.", in_type);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        file_buf = calloc (bmeta->nlines * bmeta->nsamps, nbytes);
-        if (file_buf == NULL)
+        file_buf[0] = calloc ((size_t) chunks.block_lines * bmeta->nsamps,
+            nbytes);
+        file_buf[1] = calloc ((size_t) chunks.block_lines * bmeta->nsamps,
+            nbytes);
+        if (file_buf[0] == NULL || file_buf[1] == NULL)
         {
-            sprintf (errmsg, "Allocating memory for the image data containing "
-                "%d lines x %d samples.", bmeta->nlines, bmeta->nsamps);
+            sprintf (errmsg, "Allocating memory for two blocks of %d lines x "
+                "%d samples.", chunks.block_lines, bmeta->nsamps);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Read the entire tile */
-        start[0] = 0;
-        start[1] = 0;
-        edges[0] = bmeta->nlines;
-        edges[1] = bmeta->nsamps;
-        status = SDreaddata (sds_id, start, NULL, edges, file_buf);
+        /* Allocate memory for two blocks of the scaled values */
+        out_buf[0] = file_buf[0];
+        out_buf[1] = file_buf[1];
+        out_nbytes = nbytes;
+        if (scale != NULL)
+        {
+            out_nbytes = scale->out_nbytes;
+            out_buf[0] = calloc ((size_t) chunks.block_lines *
+                bmeta->nsamps, out_nbytes);
+            out_buf[1] = calloc ((size_t) chunks.block_lines *
+                bmeta->nsamps, out_nbytes);
+            if (out_buf[0] == NULL || out_buf[1] == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for two blocks of %d "
+                    "scaled lines x %d samples.", chunks.block_lines,
+                    bmeta->nsamps);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        /* Read the first block of lines */
+        nblock_lines = chunks.block_lines;
+        if (nblock_lines > bmeta->nlines)
+            nblock_lines = bmeta->nlines;
+        status = read_modis_block (sds_id, &chunks, 0, nblock_lines,
+            bmeta->nsamps, nbytes, file_buf[0]);
         if (status == -1)
         {
-            sprintf (errmsg, "Reading data from the SDS: %s", bmeta->name);
+            sprintf (errmsg, "Reading lines %d-%d from the SDS: %s", 0,
+                nblock_lines - 1, bmeta->name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Write entire image to the raw binary file */
-        if (write_raw_binary (fp_rb, bmeta->nlines, bmeta->nsamps, nbytes,
-            file_buf) != SUCCESS)
+        /* Loop through the blocks of the SDS, writing the current block to
+           the raw binary file while the next block is read into the other
+           buffer */
+        curr_buf = 0;
+        for (line = 0; line < bmeta->nlines; line += chunks.block_lines)
         {
-            sprintf (errmsg, "Writing image to the raw binary file: %s",
-                img_file);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            /* Determine the size of the next block, if there is one */
+            next_nblock_lines = chunks.block_lines;
+            if (line + nblock_lines + next_nblock_lines > bmeta->nlines)
+                next_nblock_lines = bmeta->nlines - line - nblock_lines;
+            status = 0;
+
+            /* Scale the digital numbers of the current block */
+            if (scale != NULL && apply_ingest_scale (scale,
+                file_buf[curr_buf], (size_t) nblock_lines * bmeta->nsamps,
+                out_buf[curr_buf]) != SUCCESS)
+            {
+                sprintf (errmsg, "Scaling lines %d-%d of the SDS: %s", line,
+                    line + nblock_lines - 1, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Write the current block to the raw binary file */
+            curr_block.fp_rb = fp_rb;
+            curr_block.nlines = nblock_lines;
+            curr_block.nsamps = bmeta->nsamps;
+            curr_block.nbytes = out_nbytes;
+            curr_block.buf = out_buf[curr_buf];
+            espa_task_group_init (&write_group);
+            espa_task_submit (&write_group, write_modis_block_task,
+                &curr_block);
+
+            /* Read the next block from the SDS */
+            if (next_nblock_lines > 0)
+                status = read_modis_block (sds_id, &chunks,
+                    line + nblock_lines, next_nblock_lines, bmeta->nsamps,
+                    nbytes, file_buf[1 - curr_buf]);
+            write_status = espa_task_group_wait (&write_group);
+
+            if (write_status != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d to the raw binary file: "
+                    "%s", line, line + nblock_lines - 1, img_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            if (status == -1)
+            {
+                sprintf (errmsg, "Reading lines %d-%d from the SDS: %s",
+                    line + nblock_lines, line + nblock_lines +
+                    next_nblock_lines - 1, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* The next block becomes the current block */
+            nblock_lines = next_nblock_lines;
+            curr_buf = 1 - curr_buf;
         }
 
         /* Close the HDF SDS and raw binary file */
@@ -1938,7 +2702,15 @@ int convert_hdf_to_img
         }
 
         /* Free the memory */
-        free (file_buf);
+        if (scale != NULL)
+        {
+            free (out_buf[0]);
+            free (out_buf[1]);
+        }
+        free (file_buf[0]);
+        free (file_buf[1]);
+        file_buf[0] = NULL;
+        file_buf[1] = NULL;
 
         /* Create the ENVI header file this band */
         if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
@@ -1960,7 +2732,7 @@ int convert_hdf_to_img
         cptr = strrchr (envi_file, '.');
         strcpy (cptr, ".hdr");
 
-        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+        if (add_envi_hdr (hdr_batch, i, envi_file, &envi_hdr) != SUCCESS)
         {
             sprintf (errmsg, "Writing the ENVI header file: %s.", envi_file);
             error_handler (true, FUNC_NAME, errmsg);
@@ -1968,17 +2740,165 @@ int convert_hdf_to_img
         }
     }  /* end for */
 
-    /* Close the HDF file */
-    status = SDend (sd_id);
-    if (status == -1)
-    {
-        sprintf (errmsg, "Ending access to HDF file: %s", modis_hdf_name);
-        error_handler (true, FUNC_NAME, errmsg);
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_hdf_band_set
+
+PURPOSE: Converts a subset of the MODIS HDF SDSs, as convert_hdf_bands, and
+writes the ENVI headers of the bands together once they are all converted.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the MODIS SDSs or writing the headers
+SUCCESS         Successfully converted MODIS SDSs to raw binary
+
+NOTES:
+  1. The headers are collected in memory while the bands are converted, so
+     each band costs no header file writes of its own (see
+     flush_envi_hdr_batch).
+******************************************************************************/
+static int convert_hdf_band_set
+(
+    int32 sd_id,               /* I: SD interface ID for the HDF file */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                              file */
+    const Ingest_band_scale_t *scales,  /* I: scaling of each band; NULL to
+                                     write the digital numbers */
+    int first_band,            /* I: index of the first band to convert */
+    int band_step              /* I: step between the bands to convert */
+)
+{
+    int status;               /* return status */
+    Envi_hdr_batch_t hdr_batch;  /* ENVI headers of the bands */
+
+    if (init_envi_hdr_batch (&hdr_batch, xml_metadata->nbands) != SUCCESS)
+    {  /* Error messages already written */
         return (ERROR);
     }
 
-    /* Successful conversion */
-    return (SUCCESS);
+    status = convert_hdf_bands (sd_id, xml_metadata, scales, first_band,
+        band_step, &hdr_batch);
+    if (status == SUCCESS)
+        status = flush_envi_hdr_batch (&hdr_batch);
+    free_envi_hdr_batch (&hdr_batch);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  convert_hdf_to_img
+
+PURPOSE: Convert the MODIS HDF SDS to an ESPA raw binary (.img) file and writes
+the associated ENVI header for each band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the MODIS SDS
+SUCCESS         Successfully converted MODIS SDS to raw binary
+
+NOTES:
+  1. The HDF library is not thread-safe, so the SDSs are converted in
+     parallel by forking nworkers worker processes.  Worker w converts the
+     bands w, w + nworkers, w + 2*nworkers, ... and opens its own handle to
+     the HDF file, since the handle of the open file can't be shared between
+     processes.  Each band is written to its own output files, so nothing
+     needs to be merged after the workers are done.
+  2. If nworkers is 1 then the bands are converted in this process, through
+     the open file.
+  3. scales is set up before the workers are forked, so they all have it.
+******************************************************************************/
+int convert_hdf_to_img
+(
+    Modis_hdf_t *hdf,          /* I: open MODIS file to be processed */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                              file */
+    const Ingest_band_scale_t *scales,  /* I: scaling of each band, from
+                                     init_ingest_scale; NULL to write the
+                                     digital numbers */
+    int nworkers               /* I: number of worker processes to use for
+                                     converting the SDSs */
+)
+{
+    char FUNC_NAME[] = "convert_hdf_to_img";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int w;                    /* looping variable for the workers */
+    int nstarted;             /* number of workers which were started */
+    int wstatus;              /* exit status of the worker process */
+    int status = SUCCESS;     /* overall status of the workers */
+    int32 sd_id;              /* SD interface ID for the worker's handle */
+    pid_t pid[MAX_MODIS_BANDS]; /* process ID of each worker */
+
+    /* There is no need for workers beyond the number of bands */
+    if (nworkers > xml_metadata->nbands)
+        nworkers = xml_metadata->nbands;
+    if (nworkers > MAX_MODIS_BANDS)
+        nworkers = MAX_MODIS_BANDS;
+
+    /* Convert the bands in this process if only one worker is requested */
+    if (nworkers <= 1)
+        return (convert_hdf_band_set (hdf->sd_id, xml_metadata, scales, 0,
+            1));
+
+    /* Flush the output so it isn't duplicated by each of the workers */
+    fflush (stdout);
+    fflush (stderr);
+
+    /* Start the workers, each converting its own subset of the bands */
+    for (w = 0; w < nworkers; w++)
+    {
+        pid[w] = fork ();
+        if (pid[w] == -1)
+        {
+            sprintf (errmsg, "Starting worker process %d", w);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        if (pid[w] == 0)
+        {
+            /* Worker process, with its own handle to the HDF file */
+            sd_id = SDstart (hdf->file_name, DFACC_RDONLY);
+            if (sd_id < 0)
+            {
+                sprintf (errmsg, "Unable to open %s for reading as SDS",
+                    hdf->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (EXIT_FAILURE);
+            }
+
+            if (convert_hdf_band_set (sd_id, xml_metadata, scales, w,
+                nworkers) != SUCCESS)
+                exit (EXIT_FAILURE);
+            SDend (sd_id);
+            exit (EXIT_SUCCESS);
+        }
+    }
+    nstarted = w;
+
+    /* Wait for all of the workers which were started to finish */
+    for (w = 0; w < nstarted; w++)
+    {
+        if (waitpid (pid[w], &wstatus, 0) == -1 || !WIFEXITED (wstatus) ||
+            WEXITSTATUS (wstatus) != EXIT_SUCCESS)
+        {
+            sprintf (errmsg, "Worker process %d failed converting the SDSs",
+                w);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    return (status);
 }
 
 
@@ -1998,29 +2918,63 @@ SUCCESS         Successfully converted MODIS to ESPA format
 NOTES:
   1. The ESPA raw binary band files will be generated from the ESPA XML
      filename.
+  2. When converting many tiles of the same product, pass the same template
+     for each of them so only the first tile's metadata is read in full (see
+     read_modis_hdf_template).
 ******************************************************************************/
 int convert_modis_to_espa
 (
     char *modis_hdf_file,  /* I: input MODIS HDF filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
                                  conversion? */
+    int nworkers,          /* I: number of worker processes to use for
+                                 converting the SDSs */
+    Modis_template_t *tmpl /* I/O: template of the product shared by the
+                                 tiles; NULL to read the file in full */
 )
 {
     char FUNC_NAME[] = "convert_modis_to_espa";  /* function name */
     char errmsg[STR_SIZE];   /* error message */
+    int status;              /* return status of reading the metadata */
+    Modis_hdf_t hdf;         /* open MODIS HDF file */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
+    Ingest_band_scale_t *scales = NULL;  /* scaling of the bands */
 
     /* Initialize the metadata structure */
     init_metadata_struct (&xml_metadata);
 
+    /* Open the MODIS HDF file once for both the metadata and the SDSs */
+    if (open_modis_hdf (modis_hdf_file, &hdf) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the MODIS HDF file: %s", modis_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Read the MODIS HDF file and populate our internal ESPA metadata
        structure */
-    if (read_modis_hdf (modis_hdf_file, &xml_metadata) != SUCCESS)
+    if (tmpl != NULL)
+        status = read_modis_hdf_template (&hdf, tmpl, &xml_metadata);
+    else
+        status = read_modis_hdf (&hdf, &xml_metadata);
+    if (status != SUCCESS)
     {
         sprintf (errmsg, "Reading the MODIS HDF file: %s", modis_hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_modis_hdf (&hdf);
+        return (ERROR);
+    }
+
+    /* Describe the scaled bands, if the bands are scaled to physical
+       values */
+    if (init_ingest_scale (&xml_metadata, &scales) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the scaling of the bands of %s",
+            modis_hdf_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_modis_hdf (&hdf);
         return (ERROR);
     }
 
@@ -2028,20 +2982,33 @@ int convert_modis_to_espa
        XML filename */
     if (write_metadata (&xml_metadata, espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
+        free (scales);
+        close_modis_hdf (&hdf);
         return (ERROR);
     }
 
     /* Validate the output metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
+        free (scales);
+        close_modis_hdf (&hdf);
         return (ERROR);
     }
 
     /* Convert each of the MODIS HDF bands/SDSs to raw binary */
-    if (convert_hdf_to_img (modis_hdf_file, &xml_metadata) != SUCCESS)
+    status = convert_hdf_to_img (&hdf, &xml_metadata, scales, nworkers);
+    free (scales);
+    if (status != SUCCESS)
     {
         sprintf (errmsg, "Converting %s to ESPA", modis_hdf_file);
         error_handler (true, FUNC_NAME, errmsg);
+        close_modis_hdf (&hdf);
+        return (ERROR);
+    }
+
+    /* Close the MODIS HDF file */
+    if (close_modis_hdf (&hdf) != SUCCESS)
+    {  /* Error messages already written */
         return (ERROR);
     }
 
@@ -27,6 +27,7 @@ NOTES:
 #include "raw_binary_io.h"
 #include "write_metadata.h"
 #include "envi_header.h"
+#include "espa_ingest_scale.h"
 
 /* Defines */
 /* maximum number of MODIS bands/SDSs in a file */
@@ -39,26 +40,107 @@ NOTES:
 /* maximum number of grids for each file */
 #define MAX_MODIS_GRIDS 10
 
+/* number of lines of each SDS read and written at a time */
+#define MODIS_LINE_BLOCK 256
+
+/* Type definitions */
+/* MODIS HDF-EOS file opened once for both the grid and the SD interfaces */
+typedef struct
+{
+    char file_name[STR_SIZE];  /* name of the MODIS file */
+    int32 gd_id;               /* file ID for the HDF-EOS grid interface */
+    int32 sd_id;               /* SD interface ID of the same open file */
+} Modis_hdf_t;
+
+/* Grid and SDS layout of a MODIS file, shared by the tiles of a product */
+typedef struct
+{
+    int32 ngrids;              /* number of grids */
+    char grid_names[MAX_MODIS_GRIDS][STR_SIZE];  /* names of the grids */
+    char field_list[MAX_MODIS_GRIDS][STR_SIZE];  /* comma-separated list of
+                                                    the SDSs of each grid */
+    int32 grid_dims[MAX_MODIS_GRIDS][2];  /* x,y dimensions of each grid */
+    int32 projcode;            /* projection code of the first grid */
+    int32 spherecode;          /* sphere code of the first grid */
+    double projparm[15];       /* projection parameters of the first grid */
+    double ul_corner[2];       /* projection UL x, y of the first grid */
+    double lr_corner[2];       /* projection LR x, y of the first grid */
+} Modis_layout_t;
+
+/* Metadata shared by the tiles of a MODIS product, taken from the first tile
+   read in full and reused for the later tiles of the same product */
+typedef struct
+{
+    bool valid;                /* has the template been set? */
+    char product_key[STR_SIZE];  /* short name and collection of the
+                                    product, e.g. MOD09GA.006 */
+    Modis_layout_t layout;     /* grid and SDS layout of the product */
+    Espa_global_meta_t global; /* global metadata of the first tile */
+    int nbands;                /* number of bands */
+    Espa_band_meta_t *band;    /* band metadata of the first tile */
+    int core_len;              /* length of the first tile's core basename,
+                                  which starts its band filenames */
+} Modis_template_t;
+
 /* Prototypes */
+int open_modis_hdf
+(
+    char *modis_hdf_name,     /* I: name of MODIS file to be opened */
+    Modis_hdf_t *hdf          /* O: open MODIS file */
+);
+
+int close_modis_hdf
+(
+    Modis_hdf_t *hdf          /* I: open MODIS file */
+);
+
 int read_modis_hdf
 (
-    char *modis_hdf_name,            /* I: name of MODIS file to be read */
+    Modis_hdf_t *hdf,                /* I: open MODIS file to be read */
+    Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
+                                           populated from the MODIS file */
+);
+
+void init_modis_template
+(
+    Modis_template_t *tmpl    /* O: empty template */
+);
+
+void free_modis_template
+(
+    Modis_template_t *tmpl    /* I/O: template to be freed */
+);
+
+int read_modis_hdf_template
+(
+    Modis_hdf_t *hdf,                /* I: open MODIS file to be read */
+    Modis_template_t *tmpl,          /* I/O: template of the product */
     Espa_internal_meta_t *metadata   /* I/O: input metadata structure to be
                                            populated from the MODIS file */
 );
 
 int convert_hdf_to_img
 (
-    char *modis_hdf_name,      /* I: name of MODIS file to be processed */
-    Espa_internal_meta_t *xml_metadata /* I: metadata structure for HDF file */
+    Modis_hdf_t *hdf,          /* I: open MODIS file to be processed */
+    Espa_internal_meta_t *xml_metadata, /* I: metadata structure for HDF
+                                              file */
+    const Ingest_band_scale_t *scales,  /* I: scaling of each band, from
+                                     init_ingest_scale; NULL to write the
+                                     digital numbers */
+    int nworkers               /* I: number of worker processes to use for
+                                     converting the SDSs */
 );
 
 int convert_modis_to_espa
 (
     char *modis_hdf_file,  /* I: input MODIS HDF filename */
     char *espa_xml_file,   /* I: output ESPA XML metadata filename */
-    bool del_src           /* I: should the source .tif files be removed after
+    bool del_src,          /* I: should the source .tif files be removed after
                                  conversion? */
+    int nworkers,          /* I: number of worker processes to use for
+                                 converting the SDSs */
+    Modis_template_t *tmpl /* I/O: template of the product shared by the
+                                 tiles; NULL to read the file in full */
 );
 
 #endif
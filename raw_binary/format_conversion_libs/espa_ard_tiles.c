@@ -0,0 +1,1193 @@
+/*****************************************************************************
+FILE: espa_ard_tiles.c
+
+PURPOSE: Contains functions for cutting a scene into the tiles of a fixed
+grid, such as the Albers ARD grids, in a single reprojection pass.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. Each band is resampled once onto the smallest block of whole tiles
+     covering all the tiles produced, a strip of REPROJ_TILE_SIZE lines at a
+     time (see espa_reproject.h).  The tiles of a row are written from each
+     strip concurrently by the task pool, so the input band is streamed
+     through once rather than once per tile.
+*****************************************************************************/
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "espa_ard_tiles.h"
+#include "espa_task.h"
+#include "envi_header.h"
+
+/* Tile being written */
+typedef struct
+{
+    int h;                       /* horizontal tile number */
+    int v;                       /* vertical tile number */
+    char dir[STR_SIZE];          /* output directory of the tile */
+    char xml_file[STR_SIZE];     /* output XML file of the tile */
+    Geoloc_t *space;             /* geolocation of the tile */
+    Espa_global_meta_t global;   /* global metadata of the tile */
+    Espa_band_meta_t *band;      /* band metadata of the tile; the band
+                                    arrays are shared with the input, other
+                                    than the percent coverage */
+    Raw_binary_writer_t rbw;     /* writer of the current band */
+    bool is_open;                /* is the writer open? */
+} Ard_tile_t;
+
+/* Strip of a row of tiles being written by the task pool */
+typedef struct
+{
+    Reproj_job_t *job;           /* resampled strip of the band */
+    Ard_tile_t *tile;            /* tiles of the row */
+    int h0;                      /* horizontal tile number of the first
+                                    sample of the strip */
+    int tile_size;               /* number of lines and samples in a tile */
+} Ard_write_job_t;
+
+
+/******************************************************************************
+MODULE:  get_ard_grid
+
+PURPOSE: Determines the space definition of the first tile of the grid from
+the template product and the grid definition.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the grid
+SUCCESS         Successfully determined the grid
+
+NOTES:
+  1. The other tiles are offset from tile h000v000 by whole tiles.
+******************************************************************************/
+int get_ard_grid
+(
+    Espa_internal_meta_t *template_meta,  /* I: metadata of the template
+                                   product giving the grid projection */
+    Ard_grid_opts_t *opts,   /* I: definition of the tile grid */
+    Space_def_t *grid        /* O: space definition of tile h000v000 */
+)
+{
+    char FUNC_NAME[] = "get_ard_grid";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (opts->tile_size < 1)
+    {
+        sprintf (errmsg, "Invalid tile size: %d", opts->tile_size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!get_geoloc_info (template_meta, grid))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the "
+            "template metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (opts->pixel_size > 0.0)
+    {
+        grid->pixel_size[0] = opts->pixel_size;
+        grid->pixel_size[1] = opts->pixel_size;
+    }
+    if (opts->has_origin)
+    {
+        grid->ul_corner.x = opts->origin_x;
+        grid->ul_corner.y = opts->origin_y;
+    }
+    grid->img_size.l = opts->tile_size;
+    grid->img_size.s = opts->tile_size;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_ard_outline
+
+PURPOSE: Maps the outline of the input scene onto the tile grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the outline
+SUCCESS         Successfully mapped the outline
+
+NOTES:
+  1. The outline is 4 * REPROJ_EDGE_POINTS points going clockwise around
+     the edges of the scene from its upper left corner, in image
+     coordinates of the grid relative to tile h000v000.
+******************************************************************************/
+static int get_ard_outline
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *grid_space,    /* I: geolocation of tile h000v000 */
+    Img_coord_float_t *outline  /* O: outline of the scene on the grid
+                                   (4 * REPROJ_EDGE_POINTS points) */
+)
+{
+    char FUNC_NAME[] = "get_ard_outline";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int npts = 4 * REPROJ_EDGE_POINTS;  /* number of outline points */
+    int nlines = in_space->def.img_size.l;  /* lines in the input scene */
+    int nsamps = in_space->def.img_size.s;  /* samples in the input scene */
+    int i;                   /* looping variable */
+    double t;                /* position along an edge, from 0 to 1 */
+    Img_coord_float_t *pt = NULL;  /* current outline point */
+    Geo_coord_t *geo = NULL; /* geodetic coordinates of the outline */
+
+    geo = calloc (npts, sizeof (Geo_coord_t));
+    if (geo == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the outline points");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Top, right, bottom and left edges, each without its last corner */
+    for (i = 0; i < REPROJ_EDGE_POINTS; i++)
+    {
+        t = (double) i / REPROJ_EDGE_POINTS;
+        pt = &outline[i];
+        pt->l = 0.0;
+        pt->s = t * nsamps;
+        pt = &outline[REPROJ_EDGE_POINTS + i];
+        pt->l = t * nlines;
+        pt->s = nsamps;
+        pt = &outline[2*REPROJ_EDGE_POINTS + i];
+        pt->l = nlines;
+        pt->s = (1.0 - t) * nsamps;
+        pt = &outline[3*REPROJ_EDGE_POINTS + i];
+        pt->l = (1.0 - t) * nlines;
+        pt->s = 0.0;
+    }
+    for (i = 0; i < npts; i++)
+        outline[i].is_fill = false;
+
+    if (!from_space_batch (in_space, npts, outline, geo) ||
+        !to_space_batch (grid_space, npts, geo, outline))
+    {
+        sprintf (errmsg, "Mapping the outline of the input scene to the "
+            "tile grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (geo);
+        return (ERROR);
+    }
+
+    free (geo);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  inside_ard_outline
+
+PURPOSE: Determines whether a point of the grid is inside the outline of the
+scene.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The point is outside the outline
+true            The point is inside the outline
+
+NOTES:
+  1. Counts the crossings of the outline by a ray from the point toward
+     increasing samples.
+******************************************************************************/
+static bool inside_ard_outline
+(
+    Img_coord_float_t *outline,  /* I: outline of the scene on the grid */
+    int npts,                /* I: number of outline points */
+    double line,             /* I: line of the point */
+    double samp              /* I: sample of the point */
+)
+{
+    int i, j;                /* current and previous outline points */
+    bool inside = false;     /* is the point inside the outline? */
+    double s;                /* sample where an edge crosses the line */
+
+    for (i = 0, j = npts - 1; i < npts; j = i++)
+    {
+        if ((outline[i].l > line) == (outline[j].l > line))
+            continue;
+
+        s = outline[i].s + (line - outline[i].l) *
+            (outline[j].s - outline[i].s) / (outline[j].l - outline[i].l);
+        if (samp < s)
+            inside = !inside;
+    }
+
+    return (inside);
+}
+
+
+/******************************************************************************
+MODULE:  ard_tile_in_outline
+
+PURPOSE: Determines whether a tile overlaps the outline of the scene.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The tile doesn't overlap the scene
+true            The tile overlaps the scene
+
+NOTES:
+  1. The tile overlaps the scene if a point of the outline is within the
+     tile or a corner of the tile is within the outline.  An edge of the
+     outline crossing the tile without either leaves a corner of the tile
+     inside the outline.
+  2. The tile is shrunk by SUBSET_WINDOW_TOL, so a scene which only touches
+     the edge of a tile doesn't overlap it.
+******************************************************************************/
+static bool ard_tile_in_outline
+(
+    Img_coord_float_t *outline,  /* I: outline of the scene on the grid */
+    int npts,                /* I: number of outline points */
+    int h,                   /* I: horizontal tile number */
+    int v,                   /* I: vertical tile number */
+    int tile_size            /* I: number of lines and samples in a tile */
+)
+{
+    int i;                   /* looping variable */
+    double line0 = (double) v * tile_size + SUBSET_WINDOW_TOL;
+                             /* first line of the tile */
+    double line1 = (double) (v + 1) * tile_size - SUBSET_WINDOW_TOL;
+                             /* last line of the tile */
+    double samp0 = (double) h * tile_size + SUBSET_WINDOW_TOL;
+                             /* first sample of the tile */
+    double samp1 = (double) (h + 1) * tile_size - SUBSET_WINDOW_TOL;
+                             /* last sample of the tile */
+
+    for (i = 0; i < npts; i++)
+    {
+        if (outline[i].l > line0 && outline[i].l < line1 &&
+            outline[i].s > samp0 && outline[i].s < samp1)
+            return (true);
+    }
+
+    return (inside_ard_outline (outline, npts, line0, samp0) ||
+        inside_ard_outline (outline, npts, line0, samp1) ||
+        inside_ard_outline (outline, npts, line1, samp0) ||
+        inside_ard_outline (outline, npts, line1, samp1));
+}
+
+
+/******************************************************************************
+MODULE:  ard_tile_in_bounds
+
+PURPOSE: Determines whether the bounding coordinates of a tile overlap the
+bounding coordinates of the scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the bounds of the tile
+SUCCESS         Successfully compared the bounds
+
+NOTES:
+  1. Scenes without bounding coordinates, or whose bounding coordinates
+     cross the antimeridian, overlap every tile.
+******************************************************************************/
+static int ard_tile_in_bounds
+(
+    Geoloc_t *grid_space,    /* I: geolocation of tile h000v000 */
+    Espa_global_meta_t *gmeta,  /* I: global metadata of the input scene */
+    int h,                   /* I: horizontal tile number */
+    int v,                   /* I: vertical tile number */
+    bool *overlaps           /* O: do the bounds overlap? */
+)
+{
+    char FUNC_NAME[] = "ard_tile_in_bounds";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int tile_size = grid_space->def.img_size.l;  /* size of a tile */
+    double *coords = gmeta->bounding_coords;  /* bounds of the scene */
+    Space_def_t def = grid_space->def;  /* space definition of the tile */
+    Geoloc_t *space = NULL;  /* geolocation of the tile */
+    Geo_bounds_t bounds;     /* bounding coordinates of the tile */
+
+    *overlaps = true;
+    if (coords[ESPA_WEST] == ESPA_FLOAT_META_FILL ||
+        coords[ESPA_EAST] == ESPA_FLOAT_META_FILL ||
+        coords[ESPA_NORTH] == ESPA_FLOAT_META_FILL ||
+        coords[ESPA_SOUTH] == ESPA_FLOAT_META_FILL ||
+        coords[ESPA_WEST] > coords[ESPA_EAST])
+        return (SUCCESS);
+
+    window_to_map (grid_space, (double) v * tile_size,
+        (double) h * tile_size, &def.ul_corner.x, &def.ul_corner.y);
+    space = setup_mapping (&def);
+    if (space == NULL)
+    {
+        sprintf (errmsg, "Setting up the mapping structure of tile "
+            ARD_TILE_DIR_FORMAT, h, v);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!compute_bounds (space, tile_size, tile_size, &bounds))
+    {
+        sprintf (errmsg, "Computing the bounding coordinates of tile "
+            ARD_TILE_DIR_FORMAT, h, v);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (space);
+        return (ERROR);
+    }
+    free (space);
+
+    *overlaps = !(bounds.max_lon < coords[ESPA_WEST] ||
+        bounds.min_lon > coords[ESPA_EAST] ||
+        bounds.max_lat < coords[ESPA_SOUTH] ||
+        bounds.min_lat > coords[ESPA_NORTH]);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_ard_tiles
+
+PURPOSE: Determines the tiles of the grid overlapping the input scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the tiles
+SUCCESS         Successfully determined the tiles
+
+NOTES:
+  1. Only the tiles within the footprint of the scene on the grid are
+     checked, and the bounding coordinates of each one are compared with
+     the bounding coordinates of the scene before its overlap with the
+     outline of the scene is checked.
+  2. The tiles before tile h000v000 and after tile number ARD_MAX_TILE_NUM
+     are not part of the grid.
+******************************************************************************/
+int get_ard_tiles
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Espa_global_meta_t *gmeta,  /* I: global metadata of the input scene;
+                                   provides the bounding coordinates */
+    Geoloc_t *grid_space,    /* I: geolocation of tile h000v000 */
+    int *ntiles,             /* O: number of tiles overlapping the scene */
+    Ard_tile_id_t **tiles    /* O: tiles overlapping the scene, by row and
+                                   then column; NULL if there are none */
+)
+{
+    char FUNC_NAME[] = "get_ard_tiles";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int npts = 4 * REPROJ_EDGE_POINTS;  /* number of outline points */
+    int tile_size = grid_space->def.img_size.l;  /* size of a tile */
+    int i;                   /* looping variable for the outline */
+    int h, v;                /* current tile numbers */
+    int h0, h1, v0, v1;      /* range of tile numbers of the footprint */
+    bool overlaps;           /* do the bounds of the tile overlap? */
+    double min_line, max_line;  /* line range of the footprint */
+    double min_samp, max_samp;  /* sample range of the footprint */
+    Img_coord_float_t *outline = NULL;  /* outline of the scene on the grid */
+
+    *ntiles = 0;
+    *tiles = NULL;
+
+    outline = calloc (npts, sizeof (Img_coord_float_t));
+    if (outline == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the outline of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (get_ard_outline (in_space, grid_space, outline) != SUCCESS)
+    {  /* Error messages already written */
+        free (outline);
+        return (ERROR);
+    }
+
+    /* Range of tiles covered by the footprint of the scene */
+    min_line = max_line = outline[0].l;
+    min_samp = max_samp = outline[0].s;
+    for (i = 1; i < npts; i++)
+    {
+        min_line = min (min_line, outline[i].l);
+        max_line = max (max_line, outline[i].l);
+        min_samp = min (min_samp, outline[i].s);
+        max_samp = max (max_samp, outline[i].s);
+    }
+
+    min_line = max (0.0, floor ((min_line + SUBSET_WINDOW_TOL) / tile_size));
+    min_samp = max (0.0, floor ((min_samp + SUBSET_WINDOW_TOL) / tile_size));
+    max_line = min (ARD_MAX_TILE_NUM,
+        floor ((max_line - SUBSET_WINDOW_TOL) / tile_size));
+    max_samp = min (ARD_MAX_TILE_NUM,
+        floor ((max_samp - SUBSET_WINDOW_TOL) / tile_size));
+    if (max_line < min_line || max_samp < min_samp)
+    {
+        free (outline);
+        return (SUCCESS);
+    }
+    v0 = (int) min_line;
+    v1 = (int) max_line;
+    h0 = (int) min_samp;
+    h1 = (int) max_samp;
+
+    *tiles = calloc ((size_t) (v1 - v0 + 1) * (h1 - h0 + 1),
+        sizeof (Ard_tile_id_t));
+    if (*tiles == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the tiles");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (outline);
+        return (ERROR);
+    }
+
+    for (v = v0; v <= v1; v++)
+    {
+        for (h = h0; h <= h1; h++)
+        {
+            if (ard_tile_in_bounds (grid_space, gmeta, h, v, &overlaps)
+                != SUCCESS)
+            {  /* Error messages already written */
+                free (outline);
+                free (*tiles);
+                *tiles = NULL;
+                return (ERROR);
+            }
+
+            if (overlaps &&
+                ard_tile_in_outline (outline, npts, h, v, tile_size))
+            {
+                (*tiles)[*ntiles].h = h;
+                (*tiles)[*ntiles].v = v;
+                (*ntiles)++;
+            }
+        }
+    }
+
+    free (outline);
+    if (*ntiles == 0)
+    {
+        free (*tiles);
+        *tiles = NULL;
+    }
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_ard_tile_range
+
+PURPOSE: Writes the lines of the resampled strip to a chunk of the tiles of a
+row; the chunk function of the task pool.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing a tile
+SUCCESS         Successfully wrote the tiles
+
+NOTES:
+******************************************************************************/
+static int write_ard_tile_range
+(
+    void *arg,            /* I: strip being written (Ard_write_job_t *) */
+    int first,            /* I: first tile of the chunk */
+    int end,              /* I: tile after the last one of the chunk */
+    int runner            /* I: number of the runner */
+)
+{
+    char FUNC_NAME[] = "write_ard_tile_range";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Ard_write_job_t *wjob = arg;  /* strip being written */
+    Reproj_job_t *job = wjob->job;  /* resampled strip */
+    Ard_tile_t *tile = NULL; /* current tile */
+    int size = job->band.size;  /* bytes per pixel */
+    int i;                /* looping variable for the tiles */
+    int line;             /* looping variable for the lines */
+    size_t samp0;         /* first sample of the tile in the strip */
+    char *buf = NULL;     /* first pixel of the tile in a line */
+
+    for (i = first; i < end; i++)
+    {
+        tile = &wjob->tile[i];
+        samp0 = (size_t) (tile->h - wjob->h0) * wjob->tile_size;
+        for (line = 0; line < job->strip_nlines; line++)
+        {
+            buf = (char *) job->strip +
+                ((size_t) line * job->out_nsamps + samp0) * size;
+            if (write_raw_binary_writer (&tile->rbw, 1, wjob->tile_size,
+                size, buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the band file of tile "
+                    ARD_TILE_DIR_FORMAT ": %s", tile->h, tile->v,
+                    tile->rbw.file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_ard_tile_band
+
+PURPOSE: Opens the band file of a tile for writing and sets up its band
+metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening the band file
+SUCCESS         Successfully opened the band file
+
+NOTES:
+  1. As for reprojected bands, a band without a fill value gets a fill value
+     of 0 and the statistics are recomputed if requested.
+******************************************************************************/
+static int open_ard_tile_band
+(
+    Ard_tile_t *tile,        /* I/O: tile being written */
+    Espa_band_meta_t *bmeta, /* I/O: band metadata of the tile */
+    char *base,              /* I: band filename without the directory */
+    bool has_fill            /* I: does the input band have a fill value? */
+)
+{
+    char FUNC_NAME[] = "open_ard_tile_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char out_file[STR_SIZE]; /* output band filename */
+    int count;               /* number of chars copied in snprintf */
+
+    count = snprintf (out_file, sizeof (out_file), "%s/%s", tile->dir, base);
+    if (count < 0 || count >= sizeof (out_file))
+    {
+        sprintf (errmsg, "Overflow of out_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (open_raw_binary_writer (out_file, get_raw_binary_cache_mode (),
+        get_raw_binary_codec (), &tile->rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the output band file: %s",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    tile->is_open = true;
+
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+    bmeta->sub_sample.factor = 1;
+    bmeta->constant.is_constant = false;
+    bmeta->tiling.is_tiled = false;
+    if (!has_fill)
+        bmeta->fill_value = 0;
+    if (use_raw_binary_stats () && attach_raw_binary_stats (&tile->rbw,
+        bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the statistics of the %s band",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (use_raw_binary_cover () && attach_raw_binary_cover (&tile->rbw,
+        bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the percent coverage of the %s "
+            "band", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (use_raw_binary_checksum ())
+        attach_raw_binary_checksum (&tile->rbw, bmeta);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_ard_tile_band
+
+PURPOSE: Closes the band file of a tile, updates its band metadata for the
+tile and writes its ENVI header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error closing the band file
+SUCCESS         Successfully closed the band file
+
+NOTES:
+******************************************************************************/
+static int close_ard_tile_band
+(
+    Ard_tile_t *tile,        /* I/O: tile being written */
+    Espa_band_meta_t *bmeta, /* I/O: band metadata of the tile */
+    char *base               /* I: band filename without the directory */
+)
+{
+    char FUNC_NAME[] = "close_ard_tile_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char hdr_file[STR_SIZE]; /* output ENVI header filename */
+    Envi_header_t envi_hdr;  /* output ENVI header information */
+
+    tile->is_open = false;
+    strcpy (hdr_file, tile->rbw.file_name);
+    if (close_raw_binary_writer (&tile->rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the output band file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Update the band metadata for the tile */
+    bmeta->nlines = tile->space->def.img_size.l;
+    bmeta->nsamps = tile->space->def.img_size.s;
+    bmeta->pixel_size[0] = tile->space->def.pixel_size[0];
+    bmeta->pixel_size[1] = tile->space->def.pixel_size[1];
+    strcpy (bmeta->pixel_units, tile->global.proj_info.units);
+    snprintf (bmeta->file_name, sizeof (bmeta->file_name), "%s", base);
+
+    /* Write the ENVI header for the band */
+    if (create_envi_struct (bmeta, &tile->global, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    sprintf (&hdr_file[strlen(hdr_file)-3], "hdr");
+    if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  tile_ard_band
+
+PURPOSE: Resamples a band onto the block of tiles and writes it to each tile,
+a row of tiles at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error tiling the band
+SUCCESS         Successfully tiled the band
+
+NOTES:
+  1. The rows of the block without a tile to write aren't resampled.
+******************************************************************************/
+static int tile_ard_band
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *block_space,   /* I: geolocation of the block of tiles */
+    char *in_dir,            /* I: directory of the input XML file */
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    int iband,               /* I: index of the band */
+    int ntiles,              /* I: number of tiles */
+    Ard_tile_t *tiles,       /* I/O: tiles, by row and then column */
+    int h0,                  /* I: horizontal tile number of the block */
+    int v0                   /* I: vertical tile number of the block */
+)
+{
+    char FUNC_NAME[] = "tile_ard_band";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_file[STR_SIZE];      /* input band filename */
+    char *base = NULL;           /* band filename without the directory */
+    int count;                   /* number of chars copied in snprintf */
+    int first, end;              /* tiles of the current row */
+    int i;                       /* looping variable for the tiles */
+    int line;                    /* first line of the strip in the row */
+    int nlines;                  /* number of lines in the strip */
+    int tile_size = tiles[0].space->def.img_size.l;  /* size of a tile */
+    int status = SUCCESS;        /* return status */
+    Reproj_job_t job;            /* strips being resampled */
+    Ard_write_job_t wjob;        /* strip being written */
+
+    if (bmeta->file_name[0] == '/')
+        count = snprintf (in_file, sizeof (in_file), "%s", bmeta->file_name);
+    else
+        count = snprintf (in_file, sizeof (in_file), "%s/%s", in_dir,
+            bmeta->file_name);
+    if (count < 0 || count >= sizeof (in_file))
+    {
+        sprintf (errmsg, "Overflow of in_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    base = strrchr (bmeta->file_name, '/');
+    base = (base == NULL) ? bmeta->file_name : base + 1;
+    if (strlen (base) < 3)
+    {
+        sprintf (errmsg, "Invalid output filename for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (init_reproject_job (in_space, block_space, bmeta, in_file, &job) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        free_reproject_job (&job);
+        return (ERROR);
+    }
+
+    wjob.job = &job;
+    wjob.h0 = h0;
+    wjob.tile_size = tile_size;
+    for (first = 0; first < ntiles && status == SUCCESS; first = end)
+    {
+        for (end = first; end < ntiles && tiles[end].v == tiles[first].v;
+            end++)
+            ;
+
+        /* Open the band of each tile of the row */
+        for (i = first; i < end && status == SUCCESS; i++)
+            status = open_ard_tile_band (&tiles[i], &tiles[i].band[iband],
+                base, job.band.has_fill);
+
+        /* Resample the row a strip at a time, and write each strip to the
+           tiles of the row */
+        wjob.tile = &tiles[first];
+        for (line = 0; line < tile_size && status == SUCCESS;
+            line += REPROJ_TILE_SIZE)
+        {
+            nlines = min (REPROJ_TILE_SIZE, tile_size - line);
+            status = reproject_strip (&job,
+                (tiles[first].v - v0) * tile_size + line, nlines);
+            if (status == SUCCESS)
+                status = espa_parallel_for (0, end - first, 1, job.nthreads,
+                    write_ard_tile_range, &wjob);
+        }
+
+        /* Close the band of each tile of the row */
+        for (i = first; i < end && status == SUCCESS; i++)
+            status = close_ard_tile_band (&tiles[i], &tiles[i].band[iband],
+                base);
+    }
+
+    /* Close the band files left open by an error */
+    for (i = 0; i < ntiles; i++)
+    {
+        if (tiles[i].is_open)
+        {
+            close_raw_binary_writer (&tiles[i].rbw);
+            tiles[i].is_open = false;
+        }
+    }
+
+    free_reproject_job (&job);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Tiling band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_ard_tile
+
+PURPOSE: Creates the output directory of a tile and sets up its geolocation
+and metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the tile
+SUCCESS         Successfully set up the tile
+
+NOTES:
+  1. The percent coverage of the input bands doesn't apply to the tile, so
+     it is left out unless it is recomputed.
+******************************************************************************/
+static int init_ard_tile
+(
+    Ard_tile_id_t *id,       /* I: tile numbers */
+    Geoloc_t *grid_space,    /* I: geolocation of tile h000v000 */
+    char *out_dir,           /* I: output directory of the tiles */
+    char *in_path,           /* I: resolved directory of the input XML
+                                   file */
+    char *xml_base,          /* I: input XML filename without the
+                                   directory */
+    Espa_internal_meta_t *xml_metadata,   /* I: metadata of the scene */
+    Espa_internal_meta_t *template_meta,  /* I: metadata of the template */
+    Ard_tile_t *tile         /* O: tile to be written */
+)
+{
+    char FUNC_NAME[] = "init_ard_tile";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char out_path[PATH_MAX]; /* resolved output directory */
+    int count;               /* number of chars copied in snprintf */
+    int i;                   /* looping variable for the bands */
+    int tile_size = grid_space->def.img_size.l;  /* size of a tile */
+    Space_def_t def = grid_space->def;  /* space definition of the tile */
+    Subset_window_t window;  /* whole tile */
+
+    tile->h = id->h;
+    tile->v = id->v;
+    count = snprintf (tile->dir, sizeof (tile->dir), "%s/" ARD_TILE_DIR_FORMAT,
+        out_dir, id->h, id->v);
+    if (count < 0 || count >= sizeof (tile->dir))
+    {
+        sprintf (errmsg, "Overflow of the tile directory string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    count = snprintf (tile->xml_file, sizeof (tile->xml_file), "%s/%s",
+        tile->dir, xml_base);
+    if (count < 0 || count >= sizeof (tile->xml_file))
+    {
+        sprintf (errmsg, "Overflow of the tile XML filename string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The bands of the tile can't overwrite the input bands */
+    if (mkdir (tile->dir, 0755) != 0 && errno != EEXIST)
+    {
+        sprintf (errmsg, "Creating the tile directory: %s", tile->dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (realpath (tile->dir, out_path) == NULL || !strcmp (in_path, out_path))
+    {
+        sprintf (errmsg, "The tile directory %s must be a different "
+            "directory than the directory of the input XML file", tile->dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Geolocation of the tile */
+    window_to_map (grid_space, (double) id->v * tile_size,
+        (double) id->h * tile_size, &def.ul_corner.x, &def.ul_corner.y);
+    tile->space = setup_mapping (&def);
+    if (tile->space == NULL)
+    {
+        sprintf (errmsg, "Setting up the mapping structure of tile "
+            ARD_TILE_DIR_FORMAT, id->h, id->v);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Global metadata, with the projection information of the template and
+       the corners and bounding coordinates of the tile */
+    tile->global = xml_metadata->global;
+    tile->global.proj_info = template_meta->global.proj_info;
+    tile->global.orientation_angle = template_meta->global.orientation_angle;
+    window.line0 = 0;
+    window.samp0 = 0;
+    window.nlines = tile_size;
+    window.nsamps = tile_size;
+    if (update_subset_geoloc (tile->space, &window, &tile->global) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Band metadata, updated as each band is written */
+    tile->band = malloc (xml_metadata->nbands * sizeof (Espa_band_meta_t));
+    if (tile->band == NULL)
+    {
+        sprintf (errmsg, "Allocating the band metadata of tile "
+            ARD_TILE_DIR_FORMAT, id->h, id->v);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        tile->band[i] = xml_metadata->band[i];
+        tile->band[i].percent_cover = NULL;
+        tile->band[i].ncover = 0;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_ard_tiles
+
+PURPOSE: Frees the geolocation and band metadata of the tiles.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_ard_tiles
+(
+    int ntiles,              /* I: number of tiles */
+    int nbands,              /* I: number of bands of each tile */
+    Ard_tile_t *tiles        /* I/O: tiles to be freed */
+)
+{
+    int i, b;                /* looping variables for the tiles and bands */
+
+    if (tiles == NULL)
+        return;
+
+    for (i = 0; i < ntiles; i++)
+    {
+        if (tiles[i].band != NULL)
+        {
+            for (b = 0; b < nbands; b++)
+            {
+                if (tiles[i].band[b].arena == NULL)
+                    free (tiles[i].band[b].percent_cover);
+            }
+            free (tiles[i].band);
+        }
+        free (tiles[i].space);
+    }
+    free (tiles);
+}
+
+
+/******************************************************************************
+MODULE:  tile_ard_xml
+
+PURPOSE: Cuts the input XML file into the tiles of the grid which it
+overlaps, writing each tile as an ESPA product in its own directory of the
+output directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error tiling the scene
+SUCCESS         Successfully tiled the scene
+
+NOTES:
+  1. All the bands are resampled onto the tile grid, as by reproject_xml.
+     The projection information and orientation of the tiles are copied
+     from the template, and the corners and bounding coordinates are
+     computed for each tile.
+  2. A scene which doesn't overlap any tile of the grid isn't an error; no
+     tiles are written.
+******************************************************************************/
+int tile_ard_xml
+(
+    char *in_xml_file,       /* I: input XML file to be tiled */
+    char *out_dir,           /* I: output directory of the tiles */
+    char *template_xml_file, /* I: XML file of the template product giving
+                                   the grid projection */
+    Ard_grid_opts_t *opts,   /* I: definition of the tile grid */
+    int *ntiles              /* O: number of tiles written */
+)
+{
+    char FUNC_NAME[] = "tile_ard_xml";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_dir[STR_SIZE];       /* directory of the input XML file */
+    char in_path[PATH_MAX];      /* resolved input directory */
+    char *xml_base = NULL;       /* input XML filename without directory */
+    int i;                       /* looping variable */
+    int h0, h1, v0, v1;          /* range of tile numbers of the tiles */
+    int status = SUCCESS;        /* return status */
+    Space_def_t in_def;          /* input space definition */
+    Space_def_t grid_def;        /* space definition of tile h000v000 */
+    Space_def_t block_def;       /* space definition of the block of tiles */
+    Geoloc_t *in_space = NULL;   /* geolocation of the input scene */
+    Geoloc_t *grid_space = NULL; /* geolocation of tile h000v000 */
+    Geoloc_t *block_space = NULL;  /* geolocation of the block of tiles */
+    Ard_tile_id_t *ids = NULL;   /* tiles overlapping the scene */
+    Ard_tile_t *tiles = NULL;    /* tiles being written */
+    Espa_internal_meta_t xml_metadata;   /* XML metadata of the scene */
+    Espa_internal_meta_t template_meta;  /* XML metadata of the template */
+    Espa_internal_meta_t tile_meta;      /* XML metadata of a tile */
+
+    *ntiles = 0;
+
+    /* Read the input and template metadata */
+    if (validate_xml_file (in_xml_file) != SUCCESS ||
+        validate_xml_file (template_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    init_metadata_struct (&xml_metadata);
+    init_metadata_struct (&template_meta);
+    if (parse_metadata (in_xml_file, &xml_metadata) != SUCCESS ||
+        parse_metadata (template_xml_file, &template_meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (get_subset_dir (in_xml_file, in_dir) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (realpath (in_dir, in_path) == NULL)
+    {
+        sprintf (errmsg, "Resolving the directory of the input XML file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    xml_base = strrchr (in_xml_file, '/');
+    xml_base = (xml_base == NULL) ? in_xml_file : xml_base + 1;
+
+    /* Set up the mapping of the input scene and the tile grid */
+    if (!get_geoloc_info (&xml_metadata, &in_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    in_space = setup_mapping (&in_def);
+    if (in_space == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (get_ard_grid (&template_meta, opts, &grid_def) != SUCCESS)
+    {  /* Error messages already written */
+        free (in_space);
+        return (ERROR);
+    }
+
+    grid_space = setup_mapping (&grid_def);
+    if (grid_space == NULL)
+    {
+        sprintf (errmsg, "Setting up the mapping structure of the tile "
+            "grid.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (in_space);
+        return (ERROR);
+    }
+
+    /* Determine the tiles overlapping the scene */
+    if (get_ard_tiles (in_space, &xml_metadata.global, grid_space, ntiles,
+        &ids) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the tiles overlapping %s",
+            in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (in_space);
+        free (grid_space);
+        return (ERROR);
+    }
+    if (*ntiles == 0)
+    {
+        free_metadata (&xml_metadata);
+        free_metadata (&template_meta);
+        free (in_space);
+        free (grid_space);
+        return (SUCCESS);
+    }
+
+    /* The block of whole tiles covering the tiles, which each band is
+       resampled onto */
+    h0 = h1 = ids[0].h;
+    v0 = ids[0].v;
+    v1 = ids[*ntiles - 1].v;
+    for (i = 1; i < *ntiles; i++)
+    {
+        h0 = min (h0, ids[i].h);
+        h1 = max (h1, ids[i].h);
+    }
+    if ((double) (h1 - h0 + 1) * grid_def.img_size.s > INT_MAX ||
+        (double) (v1 - v0 + 1) * grid_def.img_size.l > INT_MAX)
+    {
+        sprintf (errmsg, "The tiles overlapping %s are too large to be "
+            "resampled together", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status == SUCCESS)
+    {
+        block_def = grid_def;
+        window_to_map (grid_space, (double) v0 * grid_def.img_size.l,
+            (double) h0 * grid_def.img_size.s, &block_def.ul_corner.x,
+            &block_def.ul_corner.y);
+        block_def.img_size.l = (v1 - v0 + 1) * grid_def.img_size.l;
+        block_def.img_size.s = (h1 - h0 + 1) * grid_def.img_size.s;
+        block_space = setup_mapping (&block_def);
+        tiles = calloc (*ntiles, sizeof (Ard_tile_t));
+        if (block_space == NULL || tiles == NULL)
+        {
+            sprintf (errmsg, "Setting up the block of tiles");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Set up the tiles and write their bands */
+    for (i = 0; i < *ntiles && status == SUCCESS; i++)
+        status = init_ard_tile (&ids[i], grid_space, out_dir, in_path,
+            xml_base, &xml_metadata, &template_meta, &tiles[i]);
+
+    for (i = 0; i < xml_metadata.nbands && status == SUCCESS; i++)
+        status = tile_ard_band (in_space, block_space, in_dir,
+            &xml_metadata.band[i], i, *ntiles, tiles, h0, v0);
+
+    /* Write the metadata of each tile and validate it */
+    tile_meta = xml_metadata;
+    for (i = 0; i < *ntiles && status == SUCCESS; i++)
+    {
+        tile_meta.global = tiles[i].global;
+        tile_meta.band = tiles[i].band;
+        if (write_metadata (&tile_meta, tiles[i].xml_file) != SUCCESS ||
+            validate_xml_file (tiles[i].xml_file) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+        }
+    }
+
+    /* Free the tiles, the metadata structures and the mappings */
+    free_ard_tiles (*ntiles, xml_metadata.nbands, tiles);
+    free (ids);
+    free_metadata (&xml_metadata);
+    free_metadata (&template_meta);
+    free (in_space);
+    free (grid_space);
+    free (block_space);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Tiling %s", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        *ntiles = 0;
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
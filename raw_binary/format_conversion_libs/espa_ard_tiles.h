@@ -0,0 +1,101 @@
+/*****************************************************************************
+FILE: espa_ard_tiles.h
+
+PURPOSE: Contains defines, structures and prototypes for cutting a scene into
+the tiles of a fixed grid, such as the Albers ARD grids, in a single
+reprojection pass.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The grid has the projection and orientation of a template product.
+     Tile hHHHvVVV covers lines VVV * tile_size to (VVV + 1) * tile_size - 1
+     of the grid and the same range of samples for HHH, counted from the
+     grid origin, which is the upper left corner of tile h000v000.
+  2. A tile is produced if the outline of the scene overlaps it.  The tiles
+     checked are narrowed down first by the footprint of the scene on the
+     grid and then by the bounding coordinates of the scene and the tile.
+  3. Each tile is written as an ESPA product in its own hHHHvVVV directory
+     of the output directory.  The bands keep their filenames and the XML
+     file keeps the name of the input XML file.
+*****************************************************************************/
+
+#ifndef ESPA_ARD_TILES_H
+#define ESPA_ARD_TILES_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_geoloc.h"
+#include "espa_reproject.h"
+
+/* Defines */
+/* Default number of lines and samples in a tile */
+#define ARD_DEFAULT_TILE_SIZE 5000
+
+/* Largest tile number along each axis of the grid */
+#define ARD_MAX_TILE_NUM 999
+
+/* Directory name of a tile from its horizontal and vertical tile numbers */
+#define ARD_TILE_DIR_FORMAT "h%03dv%03d"
+
+/* Type definitions */
+/* Definition of the tile grid, other than its projection */
+typedef struct
+{
+    int tile_size;               /* number of lines and samples in a tile */
+    double pixel_size;           /* pixel size of the tiles; 0 for the pixel
+                                    size of the template */
+    bool has_origin;             /* was the grid origin given?  Otherwise it
+                                    is the upper left corner of the
+                                    template. */
+    double origin_x;             /* projection x of the grid origin */
+    double origin_y;             /* projection y of the grid origin */
+} Ard_grid_opts_t;
+
+/* Tile of the grid */
+typedef struct
+{
+    int h;                       /* horizontal tile number */
+    int v;                       /* vertical tile number */
+} Ard_tile_id_t;
+
+/* Prototypes */
+int get_ard_grid
+(
+    Espa_internal_meta_t *template_meta,  /* I: metadata of the template
+                                   product giving the grid projection */
+    Ard_grid_opts_t *opts,   /* I: definition of the tile grid */
+    Space_def_t *grid        /* O: space definition of tile h000v000 */
+);
+
+int get_ard_tiles
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Espa_global_meta_t *gmeta,  /* I: global metadata of the input scene;
+                                   provides the bounding coordinates */
+    Geoloc_t *grid_space,    /* I: geolocation of tile h000v000 */
+    int *ntiles,             /* O: number of tiles overlapping the scene */
+    Ard_tile_id_t **tiles    /* O: tiles overlapping the scene, by row and
+                                   then column; NULL if there are none */
+);
+
+int tile_ard_xml
+(
+    char *in_xml_file,       /* I: input XML file to be tiled */
+    char *out_dir,           /* I: output directory of the tiles */
+    char *template_xml_file, /* I: XML file of the template product giving
+                                   the grid projection */
+    Ard_grid_opts_t *opts,   /* I: definition of the tile grid */
+    int *ntiles              /* O: number of tiles written */
+);
+
+#endif
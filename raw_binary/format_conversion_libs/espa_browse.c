@@ -0,0 +1,909 @@
+/*****************************************************************************
+FILE: espa_browse.c
+
+PURPOSE: Contains functions for creating a small browse (quick-look) PNG
+image of one or three bands of a product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The browse takes every stride'th line and sample of the bands.  Each
+     band is read from its coarsest overview level (see
+     raw_binary_overview.h) whose factor divides the stride, so only a
+     fraction of the band is read; bands without overviews are read with a
+     strided window.
+  2. The stretch of each band comes from the histogram of its statistics,
+     computed when the band was written, so the band doesn't have to be
+     scanned.  Bands without statistics are stretched using the values of
+     the browse pixels.
+  3. A browse pixel is fill if its full resolution pixel is fill in the
+     valid mask of the scene (see raw_binary_valid.h), or if its value is
+     the fill value in any of the bands.
+  4. The PNG is written a line at a time as the lines are stretched, with
+     the compressed pixels streamed into IDAT chunks, so the browse is only
+     held in memory once, as the pixels read from the bands.
+*****************************************************************************/
+#include <stdint.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "espa_browse.h"
+#include "raw_binary_io.h"
+#include "raw_binary_overview.h"
+#include "raw_binary_valid.h"
+
+/* Band of the browse */
+typedef struct
+{
+    Espa_band_meta_t *bmeta;     /* band of the product */
+    Espa_band_meta_t src;        /* band or overview level which is read */
+    int factor;                  /* reduction factor of the overview level
+                                    read; 1 for the band itself */
+    uint8_t *pixels;             /* browse pixels in the data type of the
+                                    band */
+    double low;                  /* value stretched to 1 */
+    double high;                 /* value stretched to 255 */
+} Browse_band_t;
+
+/* PNG being written */
+typedef struct
+{
+    FILE *fp;                    /* PNG file */
+    z_stream strm;               /* compression of the pixels */
+    uint8_t *idat;               /* compressed pixels of the current IDAT
+                                    chunk */
+} Browse_png_t;
+
+
+/******************************************************************************
+MODULE:  get_pixel_value
+
+PURPOSE: Returns the value of a pixel of the specified data type.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+value           Value of the pixel
+
+NOTES:
+******************************************************************************/
+static double get_pixel_value
+(
+    const uint8_t *px,       /* I: pixel */
+    enum Espa_data_type data_type  /* I: data type of the pixel */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            return (*(const int8_t *) px);
+        case ESPA_UINT8:
+            return (*px);
+        case ESPA_INT16:
+            return (*(const int16_t *) px);
+        case ESPA_UINT16:
+            return (*(const uint16_t *) px);
+        case ESPA_INT32:
+            return (*(const int32_t *) px);
+        case ESPA_UINT32:
+            return (*(const uint32_t *) px);
+        case ESPA_FLOAT32:
+            return (*(const float *) px);
+        default:
+            return (*(const double *) px);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  is_fill_value
+
+PURPOSE: Determines whether a band value is fill.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The value is the fill value of the band, or not a number
+false           The value is valid
+
+NOTES:
+******************************************************************************/
+static bool is_fill_value
+(
+    Espa_band_meta_t *bmeta, /* I: band of the value */
+    double value             /* I: value */
+)
+{
+    return (isnan (value) || (bmeta->fill_value != ESPA_INT_META_FILL &&
+        value == (double) bmeta->fill_value));
+}
+
+
+/******************************************************************************
+MODULE:  get_browse_stride
+
+PURPOSE: Returns the step between the lines and samples of the bands which
+are taken for the browse.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+stride          Step between the browse lines and samples
+
+NOTES:
+  1. The smallest stride which keeps the longest side within size is
+     rounded up to a multiple of the largest overview factor it can be, as
+     long as the browse loses no more than a fifth of its size, so more of
+     the browse can be read from the overviews.
+******************************************************************************/
+static int get_browse_stride
+(
+    int nlines,              /* I: number of lines of the bands */
+    int nsamps,              /* I: number of samples of the bands */
+    int size                 /* I: largest number of pixels of the longest
+                                   side of the browse */
+)
+{
+    int longest = (nlines > nsamps) ? nlines : nsamps;  /* longest side */
+    int stride = (longest + size - 1) / size;  /* smallest stride */
+    int factor;              /* overview factor */
+    int rounded;             /* stride rounded up to a multiple of factor */
+
+    for (factor = 2 << (RB_MAX_OVERVIEWS - 1); factor > 1; factor /= 2)
+    {
+        rounded = (stride + factor - 1) / factor * factor;
+        if (factor <= stride && rounded - stride <= stride / 4)
+            return (rounded);
+    }
+
+    return (stride);
+}
+
+
+/******************************************************************************
+MODULE:  read_browse_band
+
+PURPOSE: Chooses the band or overview level the browse pixels of a band are
+read from, and reads them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band
+SUCCESS         Successfully read the band
+
+NOTES:
+  1. An overview level is only used if its file has the size of the level,
+     so a missing or partly written level falls back to a finer one.
+******************************************************************************/
+static int read_browse_band
+(
+    Browse_band_t *band,     /* I/O: band of the browse; bmeta is set on
+                                     input */
+    int stride,              /* I: step between the browse lines and
+                                   samples of the band */
+    int nlines,              /* I: number of lines of the browse */
+    int nsamps               /* I: number of samples of the browse */
+)
+{
+    char FUNC_NAME[] = "read_browse_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char ovr_file[STR_SIZE]; /* name of an overview level */
+    int k;                   /* looping variable for the overview levels */
+    int factor;              /* reduction factor of an overview level */
+    int nbytes;              /* number of bytes per pixel */
+    int status;              /* return status */
+    struct stat st;          /* status of an overview file */
+    FILE *fp = NULL;         /* band or overview level */
+
+    nbytes = get_data_type_size (band->bmeta->data_type);
+    band->src = *band->bmeta;
+    band->factor = 1;
+    for (k = RB_MAX_OVERVIEWS; k > 0; k--)
+    {
+        factor = 1 << k;
+        if (stride % factor != 0 ||
+            get_raw_binary_overview_name (band->bmeta->file_name, factor,
+            ovr_file, sizeof (ovr_file)) != SUCCESS ||
+            stat (ovr_file, &st) != 0)
+            continue;
+        band->src.nlines = (band->bmeta->nlines + factor - 1) / factor;
+        band->src.nsamps = (band->bmeta->nsamps + factor - 1) / factor;
+        if (st.st_size != (off_t) band->src.nlines * band->src.nsamps *
+            nbytes)
+            continue;
+        snprintf (band->src.file_name, sizeof (band->src.file_name), "%s",
+            ovr_file);
+        band->src.tiling.is_tiled = false;
+        band->factor = factor;
+        break;
+    }
+    if (band->factor == 1)
+        band->src = *band->bmeta;
+
+    band->pixels = malloc ((size_t) nlines * nsamps * nbytes);
+    if (band->pixels == NULL)
+    {
+        sprintf (errmsg, "Allocating the browse pixels of band %s",
+            band->bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = open_raw_binary (band->src.file_name, "rb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening band %s", band->src.file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    status = read_raw_binary_window (fp, &band->src, 0, 0, nlines, nsamps,
+        stride / band->factor, band->pixels);
+    close_raw_binary (fp);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the browse pixels of band %s",
+            band->bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_histogram_percentile
+
+PURPOSE: Finds a percentile of the band values from the histogram of the
+band statistics.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The percentile was found
+false           The band has no histogram
+
+NOTES:
+  1. The values within a bin are taken to be spread evenly across it.
+******************************************************************************/
+static bool get_histogram_percentile
+(
+    Espa_band_stats_t *stats,  /* I: statistics of the band */
+    double pct,              /* I: percentile, from 0 to 100 */
+    double *value            /* O: value of the percentile */
+)
+{
+    int b;                   /* looping variable for the bins */
+    double total = 0.0;      /* number of pixels in the histogram */
+    double target;           /* number of pixels below the percentile */
+    double count = 0.0;      /* number of pixels in the bins so far */
+    double width;            /* width of a bin */
+
+    if (stats->valid_pixels == ESPA_INT_META_FILL || stats->nbins < 1 ||
+        stats->nbins > ESPA_STATS_NBINS || stats->hist_max < stats->hist_min)
+        return (false);
+    for (b = 0; b < stats->nbins; b++)
+        total += stats->histogram[b];
+    if (total <= 0.0)
+        return (false);
+
+    target = pct / 100.0 * total;
+    width = (stats->hist_max - stats->hist_min) / stats->nbins;
+    for (b = 0; b < stats->nbins; b++)
+    {
+        if (stats->histogram[b] > 0 &&
+            count + stats->histogram[b] >= target)
+        {
+            *value = stats->hist_min + width * (b + (target - count) /
+                stats->histogram[b]);
+            return (true);
+        }
+        count += stats->histogram[b];
+    }
+
+    *value = stats->hist_max;
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  compare_values
+
+PURPOSE: Compares two band values for qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first value is smaller
+0               The values are equal
+> 0             The first value is larger
+
+NOTES:
+******************************************************************************/
+static int compare_values
+(
+    const void *a,          /* I: first value */
+    const void *b           /* I: second value */
+)
+{
+    double va = *(const double *) a;  /* first value */
+    double vb = *(const double *) b;  /* second value */
+
+    return ((va < vb) ? -1 : (va > vb));
+}
+
+
+/******************************************************************************
+MODULE:  get_browse_stretch
+
+PURPOSE: Finds the band values stretched to the ends of the browse values.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory
+SUCCESS         Successfully found the stretch
+
+NOTES:
+  1. The percentiles come from the histogram of the band statistics if
+     there is one, otherwise from the non-fill browse pixels of the band.
+******************************************************************************/
+static int get_browse_stretch
+(
+    Browse_band_t *band,     /* I/O: band of the browse; the low and high
+                                     values are set */
+    long npixels,            /* I: number of browse pixels */
+    Browse_options_t *opts   /* I: options of the browse */
+)
+{
+    char FUNC_NAME[] = "get_browse_stretch";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nbytes;              /* number of bytes per pixel */
+    long i;                  /* looping variable for the pixels */
+    long nvalid = 0;         /* number of non-fill pixels */
+    double value;            /* value of a pixel */
+    double pos;              /* position of a percentile in the values */
+    double *values = NULL;   /* non-fill values, sorted */
+
+    if (get_histogram_percentile (&band->bmeta->stats, opts->low,
+        &band->low) &&
+        get_histogram_percentile (&band->bmeta->stats, opts->high,
+        &band->high))
+        return (SUCCESS);
+
+    values = malloc ((npixels > 0 ? npixels : 1) * sizeof (double));
+    if (values == NULL)
+    {
+        sprintf (errmsg, "Allocating the values of band %s",
+            band->bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    nbytes = get_data_type_size (band->bmeta->data_type);
+    for (i = 0; i < npixels; i++)
+    {
+        value = get_pixel_value (&band->pixels[i * nbytes],
+            band->bmeta->data_type);
+        if (!is_fill_value (band->bmeta, value))
+            values[nvalid++] = value;
+    }
+
+    band->low = 0.0;
+    band->high = 0.0;
+    if (nvalid > 0)
+    {
+        qsort (values, nvalid, sizeof (double), compare_values);
+        pos = opts->low / 100.0 * (nvalid - 1);
+        band->low = values[(long) pos] + (pos - floor (pos)) *
+            (values[(long) ceil (pos)] - values[(long) pos]);
+        pos = opts->high / 100.0 * (nvalid - 1);
+        band->high = values[(long) pos] + (pos - floor (pos)) *
+            (values[(long) ceil (pos)] - values[(long) pos]);
+    }
+    free (values);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  put_png_uint32
+
+PURPOSE: Stores a 32-bit value in the big-endian byte order of the PNG.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void put_png_uint32
+(
+    uint8_t *buf,            /* O: four bytes of the value */
+    uint32_t value           /* I: value */
+)
+{
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+
+/******************************************************************************
+MODULE:  write_png_chunk
+
+PURPOSE: Writes a chunk of the PNG.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chunk
+SUCCESS         Successfully wrote the chunk
+
+NOTES:
+******************************************************************************/
+static int write_png_chunk
+(
+    FILE *fp,                /* I: PNG file */
+    const char *type,        /* I: four-character type of the chunk */
+    const uint8_t *data,     /* I: data of the chunk */
+    uint32_t size            /* I: number of bytes of data */
+)
+{
+    uint8_t head[8];         /* length and type of the chunk */
+    uint8_t tail[4];         /* CRC of the chunk */
+    uLong crc;               /* CRC of the type and data */
+
+    put_png_uint32 (head, size);
+    memcpy (&head[4], type, 4);
+    crc = crc32 (0L, &head[4], 4);
+    if (size > 0)
+        crc = crc32 (crc, data, size);
+    put_png_uint32 (tail, crc);
+
+    if (fwrite (head, 1, 8, fp) != 8 ||
+        (size > 0 && fwrite (data, 1, size, fp) != size) ||
+        fwrite (tail, 1, 4, fp) != 4)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_png_pixels
+
+PURPOSE: Compresses the next bytes of the PNG pixels, writing an IDAT chunk
+each time the chunk buffer fills up.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compressing or writing the pixels
+SUCCESS         Successfully added the pixels
+
+NOTES:
+  1. A flush of Z_FINISH ends the pixels and writes the last IDAT chunk.
+******************************************************************************/
+static int add_png_pixels
+(
+    Browse_png_t *png,       /* I/O: PNG being written */
+    uint8_t *data,           /* I: bytes of the pixels */
+    size_t size,             /* I: number of bytes */
+    int flush                /* I: Z_NO_FLUSH, or Z_FINISH for the last
+                                   bytes */
+)
+{
+    int ret;                 /* return status of deflate */
+
+    png->strm.next_in = data;
+    png->strm.avail_in = size;
+    while (1)
+    {
+        ret = deflate (&png->strm, flush);
+        if (ret == Z_STREAM_ERROR)
+            return (ERROR);
+
+        if (png->strm.avail_out == 0)
+        {
+            if (write_png_chunk (png->fp, "IDAT", png->idat,
+                BROWSE_IDAT_SIZE) != SUCCESS)
+                return (ERROR);
+            png->strm.next_out = png->idat;
+            png->strm.avail_out = BROWSE_IDAT_SIZE;
+            continue;
+        }
+
+        if (flush != Z_FINISH || ret == Z_STREAM_END)
+            break;
+    }
+
+    if (flush == Z_FINISH && png->strm.avail_out < BROWSE_IDAT_SIZE)
+        return (write_png_chunk (png->fp, "IDAT", png->idat,
+            BROWSE_IDAT_SIZE - png->strm.avail_out));
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_browse_fill
+
+PURPOSE: Marks the fill pixels of a browse line from the valid mask of the
+scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the valid mask
+SUCCESS         Successfully marked the fill pixels
+
+NOTES:
+  1. The line extents of the mask give the fill pixels of the lines without
+     fill inside their extent, so only the lines with fill inside their
+     extent are read from the mask.
+******************************************************************************/
+static int get_browse_fill
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask of the scene */
+    int line,                /* I: full resolution line of the browse
+                                   line */
+    int nsamps,              /* I: number of samples of the browse */
+    int stride,              /* I: step between the browse samples */
+    uint8_t *mask_line,      /* I: buffer for a line of the mask */
+    bool *fill               /* O: fill flag of each browse sample */
+)
+{
+    int s;                   /* looping variable for the browse samples */
+    long samp;               /* full resolution sample */
+    const Raw_binary_valid_line_t *ext = NULL;  /* extent of the line */
+
+    ext = get_raw_binary_valid_line (valid, line);
+    if (ext->nvalid != ext->end - ext->start &&
+        read_raw_binary_valid (valid, line, 1, mask_line) != SUCCESS)
+        return (ERROR);
+
+    for (s = 0; s < nsamps; s++)
+    {
+        samp = (long) s * stride;
+        fill[s] = samp < ext->start || samp >= ext->end ||
+            (ext->nvalid != ext->end - ext->start &&
+            mask_line[samp] == RB_VALID_FILL);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_browse_png
+
+PURPOSE: Stretches the browse pixels of the bands and writes them as a PNG,
+a line at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the PNG
+SUCCESS         Successfully wrote the PNG
+
+NOTES:
+  1. Each line uses the PNG Up filter, the difference from the line above,
+     which compresses the smooth browse lines well at almost no cost.
+  2. Fill pixels are 0 in every channel, which the tRNS chunk marks as
+     transparent; valid pixels are stretched to 1-255.
+******************************************************************************/
+static int write_browse_png
+(
+    char *output,            /* I: output PNG filename */
+    int nbands,              /* I: number of bands of the browse */
+    Browse_band_t *band,     /* I: bands of the browse */
+    Raw_binary_valid_t *valid,  /* I: valid mask of the scene; NULL if there
+                                      is none */
+    int nlines,              /* I: number of lines of the browse */
+    int nsamps,              /* I: number of samples of the browse */
+    int stride,              /* I: step between the browse lines and
+                                   samples */
+    int level                /* I: zlib compression level */
+)
+{
+    char FUNC_NAME[] = "write_browse_png";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    static const uint8_t signature[8] =
+        {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};  /* PNG signature */
+    int b;                   /* looping variable for the bands */
+    int l;                   /* looping variable for the browse lines */
+    int s;                   /* looping variable for the browse samples */
+    int nbytes;              /* number of bytes per pixel of the bands */
+    int status = SUCCESS;    /* return status */
+    long v;                  /* stretched value */
+    size_t row_size = (size_t) nsamps * nbands;  /* bytes of a PNG line */
+    size_t px;               /* offset of a pixel in the bands */
+    double value;            /* value of a band pixel */
+    double scale[3];         /* stretch of each band */
+    uint8_t byte;            /* unfiltered byte of the PNG line */
+    uint8_t ihdr[13];        /* IHDR chunk */
+    uint8_t trns[6] = {0};   /* tRNS chunk; all 0 is transparent */
+    uint8_t *row = NULL;     /* current PNG line, then the filtered line */
+    uint8_t *prev = NULL;    /* previous PNG line */
+    uint8_t *mask_line = NULL;  /* line of the valid mask */
+    bool *fill = NULL;       /* fill flag of each browse sample */
+    Browse_png_t png;        /* PNG being written */
+
+    memset (&png, 0, sizeof (png));
+    nbytes = get_data_type_size (band[0].bmeta->data_type);
+    for (b = 0; b < nbands; b++)
+    {
+        scale[b] = (band[b].high > band[b].low) ?
+            254.0 / (band[b].high - band[b].low) : 0.0;
+    }
+
+    row = malloc (row_size + 1);
+    prev = calloc (row_size + 1, 1);
+    fill = malloc (nsamps * sizeof (bool));
+    png.idat = malloc (BROWSE_IDAT_SIZE);
+    if (valid != NULL)
+        mask_line = malloc (band[0].bmeta->nsamps);
+    if (row == NULL || prev == NULL || fill == NULL || png.idat == NULL ||
+        (valid != NULL && mask_line == NULL))
+    {
+        sprintf (errmsg, "Allocating the lines of the browse");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    if (deflateInit (&png.strm, level) != Z_OK)
+    {
+        sprintf (errmsg, "Initializing the compression of the browse");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+    png.strm.next_out = png.idat;
+    png.strm.avail_out = BROWSE_IDAT_SIZE;
+
+    png.fp = fopen (output, "wb");
+    if (png.fp == NULL)
+    {
+        sprintf (errmsg, "Opening the browse file: %s", output);
+        error_handler (true, FUNC_NAME, errmsg);
+        deflateEnd (&png.strm);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Header: 8-bit grayscale or RGB, with the 0 pixel transparent */
+    put_png_uint32 (&ihdr[0], nsamps);
+    put_png_uint32 (&ihdr[4], nlines);
+    ihdr[8] = 8;
+    ihdr[9] = (nbands == 3) ? 2 : 0;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+    if (fwrite (signature, 1, sizeof (signature), png.fp) !=
+        sizeof (signature) ||
+        write_png_chunk (png.fp, "IHDR", ihdr, sizeof (ihdr)) != SUCCESS ||
+        write_png_chunk (png.fp, "tRNS", trns, (nbands == 3) ? 6 : 2)
+        != SUCCESS)
+        status = ERROR;
+
+    for (l = 0; l < nlines && status == SUCCESS; l++)
+    {
+        if (valid != NULL)
+        {
+            if (get_browse_fill (valid, l * stride, nsamps, stride,
+                mask_line, fill) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading the valid mask for browse line %d",
+                    l);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+        else
+            memset (fill, 0, nsamps * sizeof (bool));
+
+        /* Stretch the line */
+        for (s = 0; s < nsamps; s++)
+        {
+            px = ((size_t) l * nsamps + s) * nbytes;
+            for (b = 0; b < nbands && !fill[s]; b++)
+            {
+                value = get_pixel_value (&band[b].pixels[px],
+                    band[b].bmeta->data_type);
+                if (is_fill_value (band[b].bmeta, value))
+                {
+                    fill[s] = true;
+                    break;
+                }
+                v = 1 + lround ((value - band[b].low) * scale[b]);
+                row[1 + s * nbands + b] = (v < 1) ? 1 : (v > 255) ? 255 : v;
+            }
+            if (fill[s])
+                memset (&row[1 + s * nbands], 0, nbands);
+        }
+
+        /* Filter it with the line above, keeping the line for the next
+           one */
+        row[0] = 2;
+        for (px = 1; px <= row_size; px++)
+        {
+            byte = row[px];
+            row[px] = (uint8_t) (row[px] - prev[px]);
+            prev[px] = byte;
+        }
+
+        if (add_png_pixels (&png, row, row_size + 1,
+            (l == nlines - 1) ? Z_FINISH : Z_NO_FLUSH) != SUCCESS)
+            status = ERROR;
+    }
+    deflateEnd (&png.strm);
+
+    if (status == SUCCESS &&
+        write_png_chunk (png.fp, "IEND", NULL, 0) != SUCCESS)
+        status = ERROR;
+    if (fclose (png.fp) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the browse file: %s", output);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+cleanup:
+    free (row);
+    free (prev);
+    free (fill);
+    free (mask_line);
+    free (png.idat);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  create_browse
+
+PURPOSE: Creates a browse PNG image of one or three bands of a product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the browse
+SUCCESS         Successfully created the browse
+
+NOTES:
+  1. The browse takes every stride'th line and sample of the bands,
+     starting with the first, where the stride is the smallest which keeps
+     the longest side within the size of the options (see
+     get_browse_stride).
+  2. Only the browse pixels are read, from the overviews of the bands
+     where they're available, and the bands are stretched from their
+     write-time histograms, so creating a browse costs about the same for
+     any size of scene.
+******************************************************************************/
+int create_browse
+(
+    char *espa_xml_file,     /* I: input ESPA XML metadata filename */
+    int nbands,              /* I: number of bands of the browse; 1 for
+                                   grayscale or 3 for red, green, blue */
+    char bands[][STR_SIZE],  /* I: names of the bands of the browse */
+    char *output,            /* I: output PNG filename */
+    Browse_options_t *opts,  /* I: options of the browse */
+    int *nlines,             /* O: number of lines of the browse */
+    int *nsamps              /* O: number of samples of the browse */
+)
+{
+    char FUNC_NAME[] = "create_browse";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int b;                       /* looping variable for the bands */
+    int index;                   /* index of a band in the metadata */
+    int stride;                  /* step between the browse lines and
+                                    samples */
+    int status = SUCCESS;        /* return status */
+    Browse_band_t band[3];       /* bands of the browse */
+    Raw_binary_valid_t *valid = NULL;  /* valid mask of the scene */
+    Espa_internal_meta_t meta;   /* metadata of the product */
+
+    *nlines = 0;
+    *nsamps = 0;
+    if ((nbands != 1 && nbands != 3) || opts->size < 1 ||
+        opts->size > BROWSE_MAX_SIZE || opts->low < 0.0 ||
+        opts->high > 100.0 || opts->low >= opts->high)
+    {
+        sprintf (errmsg, "Invalid number of bands (%d), browse size (%d) or "
+            "percentiles (%g, %g)", nbands, opts->size, opts->low,
+            opts->high);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    init_metadata_struct (&meta);
+    if (parse_metadata (espa_xml_file, &meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    memset (band, 0, sizeof (band));
+    for (b = 0; b < nbands; b++)
+    {
+        index = find_band_metadata (&meta, NULL, bands[b], NULL);
+        if (index < 0)
+        {
+            sprintf (errmsg, "Band %s isn't in the product", bands[b]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+        band[b].bmeta = &meta.band[index];
+        if (b > 0 && (band[b].bmeta->nlines != band[0].bmeta->nlines ||
+            band[b].bmeta->nsamps != band[0].bmeta->nsamps ||
+            band[b].bmeta->data_type != band[0].bmeta->data_type))
+        {
+            sprintf (errmsg, "Band %s doesn't have the same size and data "
+                "type as band %s", band[b].bmeta->name,
+                band[0].bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+    if (get_data_type_size (band[0].bmeta->data_type) == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type of band %s",
+            band[0].bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Read the browse pixels of the bands and find their stretch */
+    stride = get_browse_stride (band[0].bmeta->nlines,
+        band[0].bmeta->nsamps, opts->size);
+    *nlines = (band[0].bmeta->nlines - 1) / stride + 1;
+    *nsamps = (band[0].bmeta->nsamps - 1) / stride + 1;
+    for (b = 0; b < nbands; b++)
+    {
+        if (read_browse_band (&band[b], stride, *nlines, *nsamps) != SUCCESS
+            || get_browse_stretch (&band[b], (long) *nlines * *nsamps, opts)
+            != SUCCESS)
+        {
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    /* Stretch and write the browse */
+    valid = open_scene_valid_mask (&meta, band[0].bmeta);
+    status = write_browse_png (output, nbands, band, valid, *nlines,
+        *nsamps, stride, opts->level);
+
+cleanup:
+    for (b = 0; b < nbands; b++)
+        free (band[b].pixels);
+    close_raw_binary_valid (valid);
+    free_metadata (&meta);
+    return (status);
+}
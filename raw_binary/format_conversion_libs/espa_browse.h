@@ -0,0 +1,73 @@
+/*****************************************************************************
+FILE: espa_browse.h
+
+PURPOSE: Contains defines, structures and prototypes for creating a small
+browse (quick-look) PNG image of one or three bands of a product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The browse is a grayscale image of one band or an RGB image of three
+     bands, whose longest side is at most the requested size.  The bands
+     have to have the same size and data type.
+  2. Each band is linearly stretched between two percentiles of its values
+     to 1-255.  Fill pixels are 0 and are marked as transparent in the PNG.
+*****************************************************************************/
+
+#ifndef ESPA_BROWSE_H
+#define ESPA_BROWSE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+
+/* Defines */
+/* Default number of pixels of the longest side of the browse */
+#define BROWSE_DEFAULT_SIZE 1024
+
+/* Largest number of pixels of the longest side of the browse */
+#define BROWSE_MAX_SIZE 8192
+
+/* Default percentiles stretched to the ends of the browse values */
+#define BROWSE_DEFAULT_LOW 2.0
+#define BROWSE_DEFAULT_HIGH 98.0
+
+/* Default zlib compression level of the PNG */
+#define BROWSE_DEFAULT_LEVEL 6
+
+/* Number of bytes of compressed pixels in each IDAT chunk of the PNG */
+#define BROWSE_IDAT_SIZE 65536
+
+/* Type definitions */
+/* Options of the browse */
+typedef struct
+{
+    int size;                    /* number of pixels of the longest side */
+    double low;                  /* percentile of the band values stretched
+                                    to 1 */
+    double high;                 /* percentile of the band values stretched
+                                    to 255 */
+    int level;                   /* zlib compression level of the PNG */
+} Browse_options_t;
+
+/* Prototypes */
+int create_browse
+(
+    char *espa_xml_file,     /* I: input ESPA XML metadata filename */
+    int nbands,              /* I: number of bands of the browse; 1 for
+                                   grayscale or 3 for red, green, blue */
+    char bands[][STR_SIZE],  /* I: names of the bands of the browse */
+    char *output,            /* I: output PNG filename */
+    Browse_options_t *opts,  /* I: options of the browse */
+    int *nlines,             /* O: number of lines of the browse */
+    int *nsamps              /* O: number of samples of the browse */
+);
+
+#endif
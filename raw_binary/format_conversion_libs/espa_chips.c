@@ -0,0 +1,1296 @@
+/*****************************************************************************
+FILE: espa_chips.c
+
+PURPOSE: Contains functions for extracting fixed-size multi-band chips of a
+product, for example as training samples.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The chips are sorted by row of chips and sample, so nearby chips are
+     read together.  They are read CHIP_BATCH at a time from all the bands
+     at once through the asynchronous I/O queue (see raw_binary_async.h).
+     The lines of the chips of a batch are sorted by file offset and the
+     lines which overlap, or are no more than CHIP_MAX_GAP bytes apart, are
+     gathered into a single read.
+  2. Bands which have no file descriptor (chunked, tiled, constant, GeoTIFF
+     or derived bands) are read a chip at a time with
+     read_raw_binary_window, which only reads the tiles of a tiled band that
+     the chip touches.
+  3. If the scene has a valid mask (see raw_binary_valid.h), the fill
+     fraction of each chip is found from the mask and the chips with too
+     much fill are rejected before their bands are read.  Otherwise a pixel
+     is fill if it's fill in any of the bands, found once the chip is read.
+*****************************************************************************/
+#include <stdint.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "espa_chips.h"
+#include "convert_espa_to_zarr.h"
+#include "raw_binary_io.h"
+#include "raw_binary_async.h"
+#include "raw_binary_valid.h"
+
+/* Chip being extracted */
+typedef struct
+{
+    int line0;                   /* first line of the chip */
+    int samp0;                   /* first sample of the chip */
+    int index;                   /* position of the center in the input
+                                    list */
+    double fill_fraction;        /* fraction of fill pixels */
+} Chip_t;
+
+/* Line of a chip in a band, read as part of a gathered read */
+typedef struct
+{
+    long offset;                 /* byte offset of the line in the band */
+    int chip;                    /* chip of the batch */
+    int line;                    /* line of the chip */
+    size_t staged;               /* offset of the line in the staging
+                                    buffer of the band */
+} Chip_segment_t;
+
+/* Chips being extracted, a batch at a time */
+typedef struct
+{
+    int nbands;                  /* number of bands of the chips */
+    Espa_band_meta_t **bmeta;    /* metadata of each band */
+    FILE **fp;                   /* file of each band */
+    int size;                    /* number of lines and samples in a chip */
+    int nbytes;                  /* number of bytes per pixel */
+    Chip_segment_t **seg;        /* lines of the chips of the batch, per
+                                    band */
+    uint8_t **staging;           /* gathered reads of the batch, per band */
+    size_t *staging_size;        /* allocated size of each staging buffer */
+    uint8_t *band_buf;           /* chip of a band read as a window */
+    uint8_t *chip_buf;           /* interleaved chips of the batch */
+} Chip_job_t;
+
+
+/******************************************************************************
+MODULE:  compare_chips
+
+PURPOSE: Orders the chips by row of chips, then by sample and line, for
+qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first chip is read first
+0               The chips are at the same location
+> 0             The second chip is read first
+
+NOTES:
+  1. The row of chips is the first line of the chip divided by CHIP_BATCH,
+     so the chips of a row are read across the band rather than zigzagging
+     between lines.
+******************************************************************************/
+static int compare_chips
+(
+    const void *a,          /* I: first chip */
+    const void *b           /* I: second chip */
+)
+{
+    const Chip_t *ca = a;   /* first chip */
+    const Chip_t *cb = b;   /* second chip */
+    int ra = ca->line0 / CHIP_BATCH;  /* row of the first chip */
+    int rb = cb->line0 / CHIP_BATCH;  /* row of the second chip */
+
+    if (ra != rb)
+        return ((ra < rb) ? -1 : 1);
+    if (ca->samp0 != cb->samp0)
+        return ((ca->samp0 < cb->samp0) ? -1 : 1);
+    if (ca->line0 != cb->line0)
+        return ((ca->line0 < cb->line0) ? -1 : 1);
+    return ((ca->index < cb->index) ? -1 : (ca->index > cb->index));
+}
+
+
+/******************************************************************************
+MODULE:  compare_segments
+
+PURPOSE: Orders the chip lines by file offset, for qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first line is earlier in the file
+0               The lines are at the same offset
+> 0             The second line is earlier in the file
+
+NOTES:
+******************************************************************************/
+static int compare_segments
+(
+    const void *a,          /* I: first chip line */
+    const void *b           /* I: second chip line */
+)
+{
+    long oa = ((const Chip_segment_t *) a)->offset;  /* first offset */
+    long ob = ((const Chip_segment_t *) b)->offset;  /* second offset */
+
+    return ((oa < ob) ? -1 : (oa > ob));
+}
+
+
+/******************************************************************************
+MODULE:  count_chip_fill
+
+PURPOSE: Counts the fill pixels of a chip from the valid mask of the scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the valid mask
+SUCCESS         Successfully counted the fill pixels
+
+NOTES:
+  1. The line extents of the mask give the fill pixels of the lines without
+     fill inside their extent, so only the lines with fill inside their
+     extent are read from the mask.
+******************************************************************************/
+static int count_chip_fill
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask of the scene */
+    Chip_t *chip,            /* I: chip */
+    int size,                /* I: number of lines and samples in the chip */
+    uint8_t *mask_line,      /* I: buffer for a line of the mask */
+    long *nfill              /* O: number of fill pixels of the chip */
+)
+{
+    int l;                   /* looping variable for the chip lines */
+    int s;                   /* looping variable for the samples */
+    int first, end;          /* valid extent of the line in the chip */
+    const Raw_binary_valid_line_t *ext = NULL;  /* extent of a line */
+
+    *nfill = 0;
+    for (l = 0; l < size; l++)
+    {
+        ext = get_raw_binary_valid_line (valid, chip->line0 + l);
+        first = ((int) ext->start > chip->samp0) ? (int) ext->start :
+            chip->samp0;
+        end = ((int) ext->end < chip->samp0 + size) ? (int) ext->end :
+            chip->samp0 + size;
+        if (end <= first)
+        {
+            *nfill += size;
+            continue;
+        }
+
+        /* Outside the extent is fill */
+        *nfill += size - (end - first);
+        if (ext->nvalid == ext->end - ext->start)
+            continue;
+
+        if (read_raw_binary_valid (valid, chip->line0 + l, 1, mask_line)
+            != SUCCESS)
+            return (ERROR);
+        for (s = first; s < end; s++)
+        {
+            if (mask_line[s] == RB_VALID_FILL)
+                (*nfill)++;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_pixel_value
+
+PURPOSE: Returns the value of a pixel of the specified data type.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+value           Value of the pixel
+
+NOTES:
+******************************************************************************/
+static double get_pixel_value
+(
+    const uint8_t *px,       /* I: pixel */
+    enum Espa_data_type data_type  /* I: data type of the pixel */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            return (*(const int8_t *) px);
+        case ESPA_UINT8:
+            return (*px);
+        case ESPA_INT16:
+            return (*(const int16_t *) px);
+        case ESPA_UINT16:
+            return (*(const uint16_t *) px);
+        case ESPA_INT32:
+            return (*(const int32_t *) px);
+        case ESPA_UINT32:
+            return (*(const uint32_t *) px);
+        case ESPA_FLOAT32:
+            return (*(const float *) px);
+        default:
+            return (*(const double *) px);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  count_chip_data_fill
+
+PURPOSE: Counts the pixels of a chip which are fill in any of its bands.
+
+RETURN VALUE:
+Type = long
+Value           Description
+-----           -----------
+nfill           Number of fill pixels of the chip
+
+NOTES:
+  1. Bands without a fill value have no fill pixels.
+******************************************************************************/
+static long count_chip_data_fill
+(
+    Chip_job_t *job,         /* I: chips being extracted */
+    const uint8_t *chip      /* I: interleaved chip */
+)
+{
+    int b;                   /* looping variable for the bands */
+    long p;                  /* looping variable for the pixels */
+    long npix = (long) job->size * job->size;  /* pixels in the chip */
+    long nfill = 0;          /* number of fill pixels */
+    const uint8_t *px = chip;  /* current pixel of the current band */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+
+    for (p = 0; p < npix; p++)
+    {
+        for (b = 0; b < job->nbands; b++, px += job->nbytes)
+        {
+            bmeta = job->bmeta[b];
+            if (bmeta->fill_value != ESPA_INT_META_FILL &&
+                get_pixel_value (px, bmeta->data_type) ==
+                (double) bmeta->fill_value)
+                break;
+        }
+        if (b < job->nbands)
+        {
+            nfill++;
+            px += (size_t) (job->nbands - b) * job->nbytes;
+        }
+    }
+
+    return (nfill);
+}
+
+
+/******************************************************************************
+MODULE:  interleave_chip_line
+
+PURPOSE: Copies a line of a chip of a band into the interleaved chips.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void interleave_chip_line
+(
+    Chip_job_t *job,         /* I/O: chips being extracted */
+    const uint8_t *src,      /* I: line of the chip of the band */
+    int chip,                /* I: chip of the batch */
+    int line,                /* I: line of the chip */
+    int band                 /* I: band of the line */
+)
+{
+    int s;                   /* looping variable for the samples */
+    int size = job->size;    /* number of samples in a chip line */
+    int nbands = job->nbands;  /* number of bands */
+    size_t out_pix;          /* first output pixel of the line */
+
+    out_pix = (((size_t) chip * size + line) * size) * nbands + band;
+    switch (job->nbytes)
+    {
+        case 1:
+            for (s = 0; s < size; s++)
+                job->chip_buf[out_pix + (size_t) s * nbands] = src[s];
+            break;
+        case 2:
+            for (s = 0; s < size; s++)
+                ((uint16_t *) job->chip_buf)[out_pix + (size_t) s * nbands] =
+                    ((const uint16_t *) src)[s];
+            break;
+        case 4:
+            for (s = 0; s < size; s++)
+                ((uint32_t *) job->chip_buf)[out_pix + (size_t) s * nbands] =
+                    ((const uint32_t *) src)[s];
+            break;
+        default:
+            for (s = 0; s < size; s++)
+                ((uint64_t *) job->chip_buf)[out_pix + (size_t) s * nbands] =
+                    ((const uint64_t *) src)[s];
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  submit_band_batch
+
+PURPOSE: Submits the gathered reads of the lines of a batch of chips of a
+band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error submitting the reads
+SUCCESS         Successfully submitted the reads
+
+NOTES:
+  1. The chip lines are sorted by file offset, and each run of lines which
+     overlap or are no more than CHIP_MAX_GAP bytes apart is read with one
+     request into the staging buffer of the band.  The staged offset of each
+     line is kept for interleaving it once the reads complete.
+******************************************************************************/
+static int submit_band_batch
+(
+    Chip_job_t *job,         /* I/O: chips being extracted */
+    Raw_binary_async_t *aio, /* I/O: asynchronous I/O queue */
+    int band,                /* I: band to be read */
+    Chip_t *chips,           /* I: chips of the batch */
+    int nchips               /* I: number of chips in the batch */
+)
+{
+    char FUNC_NAME[] = "submit_band_batch";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int c;                   /* looping variable for the chips */
+    int l;                   /* looping variable for the chip lines */
+    int k;                   /* looping variable for the segments */
+    int nseg;                /* number of chip lines of the batch */
+    int pass;                /* sizing pass (0) or submitting pass (1) */
+    long run_start = 0;      /* file offset of the current run */
+    long run_end = 0;        /* file offset after the current run */
+    long seg_end;            /* file offset after the current line */
+    size_t run_staged = 0;   /* staged offset of the current run */
+    size_t line_bytes = (size_t) job->size * job->nbytes;
+                             /* number of bytes in a chip line */
+    uint8_t *new_buf = NULL; /* reallocated staging buffer */
+    Chip_segment_t *seg = job->seg[band];  /* chip lines of the band */
+    Espa_band_meta_t *bmeta = job->bmeta[band];  /* band */
+
+    nseg = 0;
+    for (c = 0; c < nchips; c++)
+    {
+        for (l = 0; l < job->size; l++, nseg++)
+        {
+            seg[nseg].offset = ((long) (chips[c].line0 + l) * bmeta->nsamps +
+                chips[c].samp0) * job->nbytes;
+            seg[nseg].chip = c;
+            seg[nseg].line = l;
+        }
+    }
+    qsort (seg, nseg, sizeof (Chip_segment_t), compare_segments);
+
+    /* Size the staging buffer for the runs, then submit them */
+    for (pass = 0; pass < 2; pass++)
+    {
+        run_staged = 0;
+        for (k = 0; k <= nseg; k++)
+        {
+            /* Extend the current run with the line if it's close enough */
+            if (k > 0 && k < nseg &&
+                seg[k].offset <= run_end + CHIP_MAX_GAP)
+            {
+                seg[k].staged = run_staged + (seg[k].offset - run_start);
+                seg_end = seg[k].offset + (long) line_bytes;
+                if (seg_end > run_end)
+                    run_end = seg_end;
+                continue;
+            }
+
+            /* Otherwise finish the current run and start a new one */
+            if (k > 0)
+            {
+                if (pass == 1 && submit_raw_binary_read (aio, job->fp[band],
+                    run_start, run_end - run_start,
+                    &job->staging[band][run_staged]) != SUCCESS)
+                {
+                    sprintf (errmsg, "Submitting the chip reads of band %s",
+                        bmeta->name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                run_staged += run_end - run_start;
+            }
+            if (k < nseg)
+            {
+                run_start = seg[k].offset;
+                run_end = run_start + (long) line_bytes;
+                seg[k].staged = run_staged;
+            }
+        }
+
+        if (pass == 0 && run_staged > job->staging_size[band])
+        {
+            new_buf = realloc (job->staging[band], run_staged);
+            if (new_buf == NULL)
+            {
+                sprintf (errmsg, "Allocating the staging buffer of band %s",
+                    bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            job->staging[band] = new_buf;
+            job->staging_size[band] = run_staged;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_chip_batch
+
+PURPOSE: Reads a batch of chips from all the bands, interleaving them into
+the chip buffer.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the chips
+SUCCESS         Successfully read the chips
+
+NOTES:
+  1. The gathered reads of all the bands with a file descriptor are in
+     flight at once; the other bands are read a chip at a time as windows
+     while the reads complete.
+******************************************************************************/
+static int read_chip_batch
+(
+    Chip_job_t *job,         /* I/O: chips being extracted */
+    Raw_binary_async_t *aio, /* I/O: asynchronous I/O queue; NULL if no band
+                                   has a file descriptor */
+    Chip_t *chips,           /* I: chips of the batch */
+    int nchips               /* I: number of chips in the batch */
+)
+{
+    char FUNC_NAME[] = "read_chip_batch";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int b;                   /* looping variable for the bands */
+    int c;                   /* looping variable for the chips */
+    int l;                   /* looping variable for the chip lines */
+    int k;                   /* looping variable for the segments */
+    int status = SUCCESS;    /* return status */
+    size_t line_bytes = (size_t) job->size * job->nbytes;
+                             /* number of bytes in a chip line */
+    Chip_segment_t *seg = NULL;  /* chip lines of a band */
+
+    for (b = 0; b < job->nbands && status == SUCCESS; b++)
+    {
+        if (fileno (job->fp[b]) != -1)
+            status = submit_band_batch (job, aio, b, chips, nchips);
+    }
+
+    /* Read the bands without a file descriptor meanwhile */
+    for (b = 0; b < job->nbands && status == SUCCESS; b++)
+    {
+        if (fileno (job->fp[b]) != -1)
+            continue;
+        for (c = 0; c < nchips && status == SUCCESS; c++)
+        {
+            status = read_raw_binary_window (job->fp[b], job->bmeta[b],
+                chips[c].line0, chips[c].samp0, job->size, job->size, 1,
+                job->band_buf);
+            for (l = 0; l < job->size && status == SUCCESS; l++)
+                interleave_chip_line (job, &job->band_buf[l * line_bytes], c,
+                    l, b);
+        }
+    }
+
+    if (aio != NULL && wait_raw_binary_async (aio) != SUCCESS)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Reading a batch of %d chips", nchips);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Interleave the gathered lines */
+    for (b = 0; b < job->nbands; b++)
+    {
+        if (fileno (job->fp[b]) == -1)
+            continue;
+        seg = job->seg[b];
+        for (k = 0; k < nchips * job->size; k++)
+            interleave_chip_line (job, &job->staging[b][seg[k].staged],
+                seg[k].chip, seg[k].line, b);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_zarr_chip
+
+PURPOSE: Compresses and writes a chip as a chunk of the Zarr array of the
+chips.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the chunk
+SUCCESS         Successfully wrote the chunk
+
+NOTES:
+******************************************************************************/
+static int write_zarr_chip
+(
+    char *array_dir,         /* I: directory of the Zarr array */
+    int nchip,               /* I: number of the chip in the array */
+    uint8_t *chip,           /* I: interleaved chip */
+    size_t chip_bytes,       /* I: number of bytes in the chip */
+    Bytef *comp_buf,         /* I: buffer for the compressed chip */
+    uLong comp_bound,        /* I: size of comp_buf */
+    int level                /* I: zlib compression level */
+)
+{
+    char FUNC_NAME[] = "write_zarr_chip";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char chunk_file[STR_SIZE];  /* name of the chunk file */
+    uLongf comp_len = comp_bound;  /* size of the compressed chip */
+    FILE *fp = NULL;            /* chunk file pointer */
+
+    snprintf (chunk_file, sizeof (chunk_file), "%s/%d.0.0.0", array_dir,
+        nchip);
+    if (compress2 (comp_buf, &comp_len, chip, chip_bytes, level) != Z_OK)
+    {
+        sprintf (errmsg, "Compressing the Zarr chunk: %s", chunk_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = fopen (chunk_file, "wb");
+    if (fp == NULL || fwrite (comp_buf, 1, comp_len, fp) != comp_len)
+    {
+        sprintf (errmsg, "Writing the Zarr chunk file: %s", chunk_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (fp != NULL)
+            fclose (fp);
+        return (ERROR);
+    }
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Closing the Zarr chunk file: %s", chunk_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_chip_index
+
+PURPOSE: Writes the CSV index of the chips of a raw binary chip file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the index
+SUCCESS         Successfully wrote the index
+
+NOTES:
+  1. The index is named after the chip file, with the .csv extension.  Its
+     comment lines give the shape and data type of the chips and the bands,
+     and it has a row per chip in the order of the chip file.
+******************************************************************************/
+static int write_chip_index
+(
+    char *output,            /* I: raw binary file of the chips */
+    Chip_job_t *job,         /* I: chips being extracted */
+    Chip_t **kept,           /* I: chips written, in order */
+    int nkept                /* I: number of chips written */
+)
+{
+    char FUNC_NAME[] = "write_chip_index";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char index_file[STR_SIZE];   /* index filename */
+    char *base = NULL;           /* index filename without the directory */
+    char *cptr = NULL;           /* extension of the filename */
+    int b;                       /* looping variable for the bands */
+    int i;                       /* looping variable for the chips */
+    int half = job->size / 2;    /* offset of the center in the chip */
+    FILE *fp = NULL;             /* index file pointer */
+
+    snprintf (index_file, sizeof (index_file), "%s", output);
+    base = strrchr (index_file, '/');
+    base = (base == NULL) ? index_file : base + 1;
+    cptr = strrchr (base, '.');
+    if (cptr == NULL || cptr == base)
+        cptr = &base[strlen (base)];
+    if ((cptr - index_file) + 5 > sizeof (index_file))
+    {
+        sprintf (errmsg, "Overflow of index_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (cptr, ".csv");
+
+    fp = fopen (index_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the chip index file: %s", index_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fprintf (fp, "# %d chips of %d lines x %d samples x %d bands, dtype %s, "
+        "band interleaved by pixel\n# bands:", nkept, job->size, job->size,
+        job->nbands, get_zarr_dtype (job->bmeta[0]->data_type));
+    for (b = 0; b < job->nbands; b++)
+        fprintf (fp, " %s", job->bmeta[b]->name);
+    fprintf (fp, "\nchip,index,center_line,center_samp,fill_fraction\n");
+    for (i = 0; i < nkept; i++)
+        fprintf (fp, "%d,%d,%d,%d,%.6f\n", i, kept[i]->index,
+            kept[i]->line0 + half, kept[i]->samp0 + half,
+            kept[i]->fill_fraction);
+
+    if (fclose (fp) != 0)
+    {
+        sprintf (errmsg, "Writing the chip index file: %s", index_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_chip_dims
+
+PURPOSE: Writes the .zattrs of an array of the chip store with its
+dimensions.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the attributes
+SUCCESS         Successfully wrote the attributes
+
+NOTES:
+  1. The array of the chips also lists the bands, in the order they are
+     interleaved.
+******************************************************************************/
+static int write_chip_dims
+(
+    char *zarr_dir,          /* I: Zarr store (directory) */
+    char *name,              /* I: name of the array */
+    Chip_job_t *job          /* I: chips being extracted; the bands are
+                                   listed if not NULL */
+)
+{
+    char array_dir[STR_SIZE];    /* directory of the array */
+    char json_file[STR_SIZE];    /* name of the .zattrs file */
+    int b;                       /* looping variable for the bands */
+    FILE *fp = NULL;             /* .zattrs file pointer */
+
+    snprintf (array_dir, sizeof (array_dir), "%s/%s", zarr_dir, name);
+    fp = open_zarr_json (array_dir, ".zattrs", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (job == NULL)
+        fprintf (fp, "{\n  \"_ARRAY_DIMENSIONS\": [\"chip\"]");
+    else
+    {
+        fprintf (fp, "{\n  \"_ARRAY_DIMENSIONS\": [\"chip\", \"y\", \"x\", "
+            "\"band\"],\n  \"bands\": [");
+        for (b = 0; b < job->nbands; b++)
+        {
+            fprintf (fp, "%s", (b > 0) ? ", " : "");
+            write_zarr_string (fp, job->bmeta[b]->name);
+        }
+        fprintf (fp, "]");
+    }
+    fprintf (fp, "\n}\n");
+
+    return (close_zarr_json (fp, json_file));
+}
+
+
+/******************************************************************************
+MODULE:  write_chip_store_meta
+
+PURPOSE: Writes the metadata of the Zarr array of the chips and the arrays of
+the chip centers, once all the chips are written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the metadata
+SUCCESS         Successfully wrote the metadata
+
+NOTES:
+  1. The center_line, center_samp, index and fill_fraction arrays give the
+     center, the position in the input list and the fill fraction of each
+     chip.  They are left out if no chips were written.
+******************************************************************************/
+static int write_chip_store_meta
+(
+    char *zarr_dir,          /* I: Zarr store (directory) */
+    char *array_dir,         /* I: directory of the array of the chips */
+    Chip_job_t *job,         /* I: chips being extracted */
+    Chip_t **kept,           /* I: chips written, in order */
+    int nkept,               /* I: number of chips written */
+    long fill_value,         /* I: fill value of the chips */
+    int level                /* I: zlib compression level */
+)
+{
+    char FUNC_NAME[] = "write_chip_store_meta";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int i;                       /* looping variable for the chips */
+    int half = job->size / 2;    /* offset of the center in the chip */
+    int shape[4];                /* size of each dimension of the array */
+    int chunks[4];               /* chunk size of each dimension */
+    int status;                  /* return status */
+    int32_t *ivalues = NULL;     /* integer values of the chips */
+    double *fill = NULL;         /* fill fraction of the chips */
+
+    shape[0] = nkept;
+    shape[1] = shape[2] = job->size;
+    shape[3] = job->nbands;
+    chunks[0] = 1;
+    chunks[1] = chunks[2] = job->size;
+    chunks[3] = job->nbands;
+    if (write_zarr_array_meta (array_dir, 4, shape, chunks,
+            get_zarr_dtype (job->bmeta[0]->data_type), fill_value, level)
+            != SUCCESS ||
+        write_chip_dims (zarr_dir, "chips", job) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (nkept == 0)
+        return (SUCCESS);
+
+    ivalues = malloc (nkept * sizeof (int32_t));
+    fill = malloc (nkept * sizeof (double));
+    if (ivalues == NULL || fill == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the chip centers");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (ivalues);
+        free (fill);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nkept; i++)
+        ivalues[i] = kept[i]->line0 + half;
+    status = write_zarr_vector (zarr_dir, "center_line", "<i4", nkept,
+        sizeof (int32_t), ivalues, level);
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < nkept; i++)
+            ivalues[i] = kept[i]->samp0 + half;
+        status = write_zarr_vector (zarr_dir, "center_samp", "<i4", nkept,
+            sizeof (int32_t), ivalues, level);
+    }
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < nkept; i++)
+            ivalues[i] = kept[i]->index;
+        status = write_zarr_vector (zarr_dir, "index", "<i4", nkept,
+            sizeof (int32_t), ivalues, level);
+    }
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < nkept; i++)
+            fill[i] = kept[i]->fill_fraction;
+        status = write_zarr_vector (zarr_dir, "fill_fraction", "<f8", nkept,
+            sizeof (double), fill, level);
+    }
+    if (status == SUCCESS &&
+        (write_chip_dims (zarr_dir, "center_line", NULL) != SUCCESS ||
+         write_chip_dims (zarr_dir, "center_samp", NULL) != SUCCESS ||
+         write_chip_dims (zarr_dir, "index", NULL) != SUCCESS ||
+         write_chip_dims (zarr_dir, "fill_fraction", NULL) != SUCCESS))
+        status = ERROR;
+
+    free (ivalues);
+    free (fill);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_chips
+
+PURPOSE: Reads the chips a batch at a time, rejects the chips with too much
+fill, and writes the others to the raw binary file or the Zarr array.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the chips
+SUCCESS         Successfully wrote the chips
+
+NOTES:
+  1. The fill fraction of the chips is already known if the scene has a
+     valid mask; otherwise it's a negative value and is found from the
+     chip.
+******************************************************************************/
+static int write_chips
+(
+    Chip_job_t *job,         /* I/O: chips being extracted */
+    Raw_binary_async_t *aio, /* I/O: asynchronous I/O queue, or NULL */
+    Chip_t *chips,           /* I/O: chips to be read, in read order */
+    int nchips,              /* I: number of chips to be read */
+    double max_fill,         /* I: largest fill fraction which is kept */
+    FILE *fp_out,            /* I: raw binary chip file, or NULL */
+    char *array_dir,         /* I: directory of the Zarr array, or NULL */
+    int level,               /* I: zlib compression level */
+    Chip_t **kept,           /* O: chips written, in order */
+    int *nkept               /* O: number of chips written */
+)
+{
+    char FUNC_NAME[] = "write_chips";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int first;               /* first chip of the current batch */
+    int nbatch;              /* number of chips in the current batch */
+    int c;                   /* looping variable for the chips */
+    size_t chip_bytes;       /* number of bytes in an interleaved chip */
+    uint8_t *chip = NULL;    /* current interleaved chip */
+    uLong comp_bound = 0;    /* size of comp_buf */
+    Bytef *comp_buf = NULL;  /* compressed chip */
+
+    chip_bytes = (size_t) job->size * job->size * job->nbands * job->nbytes;
+    if (array_dir != NULL)
+    {
+        comp_bound = compressBound (chip_bytes);
+        comp_buf = malloc (comp_bound);
+        if (comp_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the compressed chips");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    *nkept = 0;
+    for (first = 0; first < nchips; first += nbatch)
+    {
+        nbatch = (nchips - first < CHIP_BATCH) ? nchips - first : CHIP_BATCH;
+        if (read_chip_batch (job, aio, &chips[first], nbatch) != SUCCESS)
+        {  /* Error messages already written */
+            free (comp_buf);
+            return (ERROR);
+        }
+
+        for (c = 0; c < nbatch; c++)
+        {
+            chip = &job->chip_buf[c * chip_bytes];
+            if (chips[first + c].fill_fraction < 0.0)
+            {
+                chips[first + c].fill_fraction = (double)
+                    count_chip_data_fill (job, chip) /
+                    ((double) job->size * job->size);
+                if (chips[first + c].fill_fraction > max_fill)
+                    continue;
+            }
+
+            if (fp_out != NULL)
+            {
+                if (fwrite (chip, 1, chip_bytes, fp_out) != chip_bytes)
+                {
+                    sprintf (errmsg, "Writing chip %d of the chip file",
+                        *nkept);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+            }
+            else if (write_zarr_chip (array_dir, *nkept, chip, chip_bytes,
+                comp_buf, comp_bound, level) != SUCCESS)
+            {  /* Error messages already written */
+                free (comp_buf);
+                return (ERROR);
+            }
+            kept[(*nkept)++] = &chips[first + c];
+        }
+    }
+
+    free (comp_buf);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_chip_bands
+
+PURPOSE: Finds and opens the bands of the chips, which have to have the same
+size and data type.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error finding or opening the bands
+SUCCESS         Successfully opened the bands
+
+NOTES:
+******************************************************************************/
+static int open_chip_bands
+(
+    Espa_internal_meta_t *meta,  /* I/O: metadata of the product */
+    int nbands,              /* I: number of bands of the chips */
+    char bands[][STR_SIZE],  /* I: names of the bands */
+    Chip_job_t *job          /* I/O: chips being extracted; the bands are
+                                   set and opened */
+)
+{
+    char FUNC_NAME[] = "open_chip_bands";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int b;                   /* looping variable for the bands */
+    int band;                /* index of the band in the metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+
+    for (b = 0; b < nbands; b++)
+    {
+        band = find_band_metadata (meta, NULL, bands[b], NULL);
+        if (band < 0)
+        {
+            sprintf (errmsg, "Band %s isn't in the product", bands[b]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        bmeta = &meta->band[band];
+        if (b > 0 && (bmeta->nlines != job->bmeta[0]->nlines ||
+            bmeta->nsamps != job->bmeta[0]->nsamps ||
+            bmeta->data_type != job->bmeta[0]->data_type))
+        {
+            sprintf (errmsg, "Band %s doesn't have the same size and data "
+                "type as band %s", bmeta->name, job->bmeta[0]->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        job->bmeta[b] = bmeta;
+
+        job->fp[b] = open_raw_binary (bmeta->file_name, "rb");
+        if (job->fp[b] == NULL)
+        {
+            sprintf (errmsg, "Opening band %s", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    job->nbytes = get_data_type_size (job->bmeta[0]->data_type);
+    if (job->nbytes == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type of band %s",
+            job->bmeta[0]->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  extract_chips
+
+PURPOSE: Extracts fixed-size multi-band chips centered on the given pixels
+of a product, written as a raw binary file or a Zarr store.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error extracting the chips
+SUCCESS         Successfully extracted the chips
+
+NOTES:
+  1. Chips which don't fit in the bands, or whose fraction of fill pixels is
+     larger than max_fill, are left out.
+  2. The Zarr store has the global metadata of the product as its
+     attributes, and holds the chips array with the center_line,
+     center_samp, index and fill_fraction arrays along its chip dimension.
+     The fill value of the chips array is the fill value of the bands if
+     they all have the same one.
+******************************************************************************/
+int extract_chips
+(
+    char *espa_xml_file,     /* I: input ESPA XML metadata filename */
+    int nbands,              /* I: number of bands of the chips */
+    char bands[][STR_SIZE],  /* I: names of the bands of the chips, in the
+                                   order they are interleaved */
+    int ncenters,            /* I: number of chip centers */
+    Chip_center_t *centers,  /* I: center of each chip */
+    char *output,            /* I: output raw binary file of the chips, or
+                                   the output Zarr store */
+    Chip_options_t *opts,    /* I: options of the extraction */
+    int *nchips              /* O: number of chips written */
+)
+{
+    char FUNC_NAME[] = "extract_chips";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char array_dir[STR_SIZE];    /* directory of the Zarr array */
+    int b;                       /* looping variable for the bands */
+    int i;                       /* looping variable for the centers */
+    int nin = 0;                 /* number of chips in the bands */
+    int nkept = 0;               /* number of chips written */
+    int half = opts->size / 2;   /* offset of the center in a chip */
+    int status = SUCCESS;        /* return status */
+    long nfill;                  /* number of fill pixels of a chip */
+    long fill_value;             /* fill value of the Zarr array */
+    bool use_aio = false;        /* does any band have a file descriptor? */
+    uint8_t *mask_line = NULL;   /* line of the valid mask */
+    Chip_t *chips = NULL;        /* chips in the bands */
+    Chip_t **kept = NULL;        /* chips written */
+    Chip_job_t job;              /* chips being extracted */
+    Raw_binary_async_t *aio = NULL;  /* asynchronous I/O queue */
+    Raw_binary_valid_t *valid = NULL;  /* valid mask of the scene */
+    FILE *fp_out = NULL;         /* raw binary chip file */
+    Espa_internal_meta_t meta;   /* metadata of the product */
+
+    *nchips = 0;
+    if (nbands < 1 || opts->size < 1 || opts->size > CHIP_MAX_SIZE)
+    {
+        sprintf (errmsg, "Invalid number of bands (%d) or chip size (%d)",
+            nbands, opts->size);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    init_metadata_struct (&meta);
+    if (parse_metadata (espa_xml_file, &meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    memset (&job, 0, sizeof (job));
+    job.nbands = nbands;
+    job.size = opts->size;
+    job.bmeta = calloc (nbands, sizeof (Espa_band_meta_t *));
+    job.fp = calloc (nbands, sizeof (FILE *));
+    job.seg = calloc (nbands, sizeof (Chip_segment_t *));
+    job.staging = calloc (nbands, sizeof (uint8_t *));
+    job.staging_size = calloc (nbands, sizeof (size_t));
+    chips = malloc ((ncenters > 0 ? ncenters : 1) * sizeof (Chip_t));
+    kept = malloc ((ncenters > 0 ? ncenters : 1) * sizeof (Chip_t *));
+    if (job.bmeta == NULL || job.fp == NULL || job.seg == NULL ||
+        job.staging == NULL || job.staging_size == NULL || chips == NULL ||
+        kept == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the chips");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    status = open_chip_bands (&meta, nbands, bands, &job);
+    if (status != SUCCESS)
+        goto cleanup;
+
+    for (b = 0; b < nbands && status == SUCCESS; b++)
+    {
+        if (fileno (job.fp[b]) == -1)
+            continue;
+        use_aio = true;
+        job.seg[b] = malloc ((size_t) CHIP_BATCH * job.size *
+            sizeof (Chip_segment_t));
+        if (job.seg[b] == NULL)
+            status = ERROR;
+    }
+    job.band_buf = malloc ((size_t) job.size * job.size * job.nbytes);
+    job.chip_buf = malloc ((size_t) CHIP_BATCH * job.size * job.size *
+        nbands * job.nbytes);
+    if (status != SUCCESS || job.band_buf == NULL || job.chip_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a batch of chips");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    /* Keep the chips which fit in the bands, in read order */
+    for (i = 0; i < ncenters; i++)
+    {
+        chips[nin].line0 = centers[i].line - half;
+        chips[nin].samp0 = centers[i].samp - half;
+        chips[nin].index = i;
+        chips[nin].fill_fraction = -1.0;
+        if (chips[nin].line0 >= 0 && chips[nin].samp0 >= 0 &&
+            chips[nin].line0 + job.size <= job.bmeta[0]->nlines &&
+            chips[nin].samp0 + job.size <= job.bmeta[0]->nsamps)
+            nin++;
+    }
+    qsort (chips, nin, sizeof (Chip_t), compare_chips);
+
+    /* Reject the chips with too much fill up front if there's a valid
+       mask */
+    valid = open_scene_valid_mask (&meta, job.bmeta[0]);
+    if (valid != NULL)
+    {
+        mask_line = malloc (job.bmeta[0]->nsamps);
+        if (mask_line == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the valid mask");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+
+        for (i = 0, b = 0; i < nin; i++)
+        {
+            if (count_chip_fill (valid, &chips[i], job.size, mask_line,
+                &nfill) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading the valid mask for the chips");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                goto cleanup;
+            }
+            chips[i].fill_fraction = (double) nfill /
+                ((double) job.size * job.size);
+            if (chips[i].fill_fraction <= opts->max_fill)
+                chips[b++] = chips[i];
+        }
+        nin = b;
+    }
+
+    /* Set up the output */
+    if (opts->format == CHIP_RAW)
+    {
+        fp_out = fopen (output, "wb");
+        if (fp_out == NULL)
+        {
+            sprintf (errmsg, "Opening the chip file: %s", output);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+    else
+    {
+        i = snprintf (array_dir, sizeof (array_dir), "%s/chips", output);
+        if (i < 0 || i >= sizeof (array_dir))
+        {
+            sprintf (errmsg, "Overflow of array_dir string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            goto cleanup;
+        }
+        if (make_zarr_dir (output) != SUCCESS ||
+            write_zarr_group_meta (output, &meta.global) != SUCCESS ||
+            make_zarr_dir (array_dir) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    if (use_aio)
+    {
+        aio = open_raw_binary_async (RB_ASYNC_QUEUE_DEPTH);
+        if (aio == NULL)
+        {  /* Error messages already written */
+            status = ERROR;
+            goto cleanup;
+        }
+    }
+
+    status = write_chips (&job, aio, chips, nin, opts->max_fill, fp_out,
+        (fp_out == NULL) ? array_dir : NULL, opts->level, kept, &nkept);
+    if (status != SUCCESS)
+        goto cleanup;
+
+    /* Describe the chips */
+    if (fp_out != NULL)
+    {
+        if (fclose (fp_out) != 0)
+        {
+            sprintf (errmsg, "Closing the chip file: %s", output);
+            error_handler (true, FUNC_NAME, errmsg);
+            fp_out = NULL;
+            status = ERROR;
+            goto cleanup;
+        }
+        fp_out = NULL;
+        status = write_chip_index (output, &job, kept, nkept);
+    }
+    else
+    {
+        fill_value = job.bmeta[0]->fill_value;
+        for (b = 1; b < nbands; b++)
+        {
+            if (job.bmeta[b]->fill_value != fill_value)
+                fill_value = ESPA_INT_META_FILL;
+        }
+        status = write_chip_store_meta (output, array_dir, &job, kept, nkept,
+            fill_value, opts->level);
+    }
+    if (status == SUCCESS)
+        *nchips = nkept;
+
+cleanup:
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Extracting the chips of %s to %s", espa_xml_file,
+            output);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    if (fp_out != NULL)
+        fclose (fp_out);
+    if (aio != NULL)
+        close_raw_binary_async (aio);
+    if (valid != NULL)
+        close_raw_binary_valid (valid);
+    for (b = 0; b < nbands; b++)
+    {
+        if (job.fp != NULL && job.fp[b] != NULL)
+            close_raw_binary (job.fp[b]);
+        if (job.seg != NULL)
+            free (job.seg[b]);
+        if (job.staging != NULL)
+            free (job.staging[b]);
+    }
+    free (job.bmeta);
+    free (job.fp);
+    free (job.seg);
+    free (job.staging);
+    free (job.staging_size);
+    free (job.band_buf);
+    free (job.chip_buf);
+    free (mask_line);
+    free (chips);
+    free (kept);
+    free_metadata (&meta);
+
+    return (status);
+}
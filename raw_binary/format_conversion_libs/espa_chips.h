@@ -0,0 +1,92 @@
+/*****************************************************************************
+FILE: espa_chips.h
+
+PURPOSE: Contains defines, structures and prototypes for extracting
+fixed-size multi-band chips of a product, for example as training samples.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The bands of the chips have to have the same size and data type.  Each
+     chip is size x size pixels centered on a given line and sample, with the
+     pixels holding the values of all the bands one after the other (band
+     interleaved by pixel).
+  2. The chips are written either one after the other to a raw binary file,
+     with a CSV index of the chips next to it, or as a Zarr array of
+     [chip, y, x, band] with the chip centers as arrays of the chip
+     dimension.
+  3. The chips are written in the order they are read, which is sorted for
+     locality rather than the order of the centers.  The index of each chip
+     gives the position of its center in the input list.
+*****************************************************************************/
+
+#ifndef ESPA_CHIPS_H
+#define ESPA_CHIPS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+
+/* Defines */
+/* Default number of lines and samples in a chip */
+#define CHIP_DEFAULT_SIZE 256
+
+/* Largest number of lines or samples in a chip */
+#define CHIP_MAX_SIZE 4096
+
+/* Number of chips read from all the bands at a time */
+#define CHIP_BATCH 32
+
+/* Largest gap between the chip lines of a band, in bytes, which is read
+   rather than splitting the read in two */
+#define CHIP_MAX_GAP 4096
+
+/* Type definitions */
+/* Output format of the chips */
+typedef enum
+{
+    CHIP_RAW,            /* band interleaved by pixel raw binary file */
+    CHIP_ZARR            /* Zarr array of [chip, y, x, band] */
+} Chip_format_t;
+
+/* Options of the chip extraction */
+typedef struct
+{
+    Chip_format_t format;        /* output format */
+    int size;                    /* number of lines and samples in a chip */
+    double max_fill;             /* largest fraction of fill pixels of a
+                                    chip which is kept */
+    int level;                   /* zlib compression level of the Zarr
+                                    chunks */
+} Chip_options_t;
+
+/* Center of a chip, in pixels of the bands */
+typedef struct
+{
+    int line;                    /* line of the center (0-based) */
+    int samp;                    /* sample of the center (0-based) */
+} Chip_center_t;
+
+/* Prototypes */
+int extract_chips
+(
+    char *espa_xml_file,     /* I: input ESPA XML metadata filename */
+    int nbands,              /* I: number of bands of the chips */
+    char bands[][STR_SIZE],  /* I: names of the bands of the chips, in the
+                                   order they are interleaved */
+    int ncenters,            /* I: number of chip centers */
+    Chip_center_t *centers,  /* I: center of each chip */
+    char *output,            /* I: output raw binary file of the chips, or
+                                   the output Zarr store */
+    Chip_options_t *opts,    /* I: options of the extraction */
+    int *nchips              /* O: number of chips written */
+);
+
+#endif
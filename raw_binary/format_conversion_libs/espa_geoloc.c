@@ -25,15 +25,57 @@ NOTES:
 6. GCTP stands for the General Cartographic Transformation Package and the
    library and associated code is available as a subdirectory delivered with
    the HDF-EOS code.
+7. UTM scenes on the ESPA spheroids are mapped with the Transverse Mercator
+   equations from GCTP and zone constants precomputed by setup_mapping,
+   avoiding the GCTP dispatch for each point.
+8. Sinusoidal (MODIS) tiles on the MODIS sphere are mapped the same way with
+   the closed-form spherical Sinusoidal equations.
+9. Albers Conical Equal Area (the ARD grids) and polar stereographic scenes
+   on the ESPA spheroids are mapped the same way with the ellipsoidal
+   equations from GCTP.
+10. 'setup_mapping' caches the projection setups it has done, reusing them
+   for later space definitions in the same projection.  GCTP is only
+   initialized again when a cached projection mapped through GCTP isn't the
+   one GCTP was last set up for.
 *****************************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "espa_geoloc.h"
 
 /* Constants */
 #define MAX_PROJ (99)  /* Maximum map projection number */
 #define GCTP_OK 0    /* Okay status return from the GCTP package */
+#define MAPPING_CACHE_SIZE 16  /* Number of projection setups cached */
+
+/* Projection a setup is for */
+typedef struct
+{
+    int proj_num;                   /* GCTP map projection number */
+    int zone;                       /* GCTP zone number */
+    int spheroid;                   /* GCTP spheroid number */
+    double proj_param[NPROJ_PARAM]; /* GCTP projection parameters as given
+                                       to setup_mapping */
+} Mapping_key_t;
+
+/* Cached projection setup */
+typedef struct
+{
+    Mapping_key_t key;     /* Projection of the setup */
+    Geoloc_t setup;        /* Geolocation structure of the setup; only the
+                              projection fields are reused */
+} Mapping_cache_t;
+
+/* Projection setups cached by setup_mapping, the projection GCTP was last
+   initialized for, and the lock for them */
+static Mapping_cache_t mapping_cache[MAPPING_CACHE_SIZE];
+static int num_mapping_cache = 0;
+static int next_mapping_cache = 0;
+static Mapping_key_t gctp_mapping;
+static bool gctp_mapping_set = false;
+static pthread_mutex_t mapping_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Prototypes for initializing the GCTP projections */
 int for_init (int outsys, int outzone, double *outparm, int outdatum, 
@@ -44,6 +86,1299 @@ int inv_init (int insys, int inzone, double *inparm, int indatum,
     int (*inv_trans[])(double, double, double*, double*));
  
 
+/* Spheroid axes used for the UTM, Albers and PS fast paths (match sphdz.c
+   in GCTP so the results agree with the GCTP transformations) */
+#define SPH_CLARKE_1866_MAJOR 6378206.4
+#define SPH_CLARKE_1866_MINOR 6356583.8
+#define SPH_GRS80_MAJOR 6378137.0
+#define SPH_GRS80_MINOR 6356752.31414
+#define SPH_WGS84_MAJOR 6378137.0
+#define SPH_WGS84_MINOR 6356752.314245
+
+/* Spacing, in pixels, of the points mapped along each edge of the image by
+   compute_bounds before refining, and the tolerance (degrees) of the
+   refined bounds */
+#define BOUNDS_STEP 64
+#define BOUNDS_TOL 1.0e-7
+
+/* Convergence tolerance and iteration limit for the UTM inverse latitude
+   (match tminv.c in GCTP) */
+#define UTM_EPSLN 1.0e-10
+#define UTM_MAX_ITER 6
+
+/* Radius of the MODIS sphere used for the sinusoidal fast path (matches
+   sphdz.c in GCTP), and the tolerance for a latitude at a pole (matches
+   sininv.c in GCTP) */
+#define SIN_MODIS_SPHERE_RADIUS 6371007.181
+#define SIN_EPSLN 1.0e-10
+
+/* Tolerances and iteration limits for the Albers and PS fast paths (match
+   alberinv.c, psinv.c and cproj.c in GCTP) */
+#define ALBERS_EPSLN 1.0e-10
+#define ALBERS_PHI_EPSLN 1.0e-7
+#define ALBERS_MAX_ITER 25
+#define PS_EPSLN 1.0e-10
+#define PS_MAX_ITER 15
+
+
+/******************************************************************************
+MODULE:  get_spheroid_axes
+
+PURPOSE:  Gets the semi-major and semi-minor axes of the spheroids supported
+by the fast paths.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The fast paths don't support this spheroid
+true       Successfully got the axes
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Only the ellipsoids used for ESPA datums are supported; anything else
+   continues to go through GCTP.
+******************************************************************************/
+static bool get_spheroid_axes
+(
+    int spheroid,          /* I: GCTP spheroid number */
+    double *r_major,       /* O: semi-major axis (meters) */
+    double *r_minor        /* O: semi-minor axis (meters) */
+)
+{
+    switch (spheroid)
+    {
+        case GCTP_CLARKE_1866:
+            *r_major = SPH_CLARKE_1866_MAJOR;
+            *r_minor = SPH_CLARKE_1866_MINOR;
+            break;
+        case GCTP_GRS80:
+            *r_major = SPH_GRS80_MAJOR;
+            *r_minor = SPH_GRS80_MINOR;
+            break;
+        case GCTP_WGS84:
+            *r_major = SPH_WGS84_MAJOR;
+            *r_minor = SPH_WGS84_MINOR;
+            break;
+        default:
+            return (false);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  init_utm
+
+PURPOSE:  Precomputes the Transverse Mercator constants for a UTM zone.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The UTM fast path doesn't support this zone/spheroid
+true       Successfully set up the UTM constants
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This follows the UTM initialization in GCTP (utmfor.c/utminv.c): scale
+   factor of 0.9996, central meridian from the zone, false easting of 500000,
+   and false northing of 10000000 for southern (negative) zones.
+2. Only the ellipsoids used for ESPA datums are supported; anything else
+   continues to go through GCTP.
+******************************************************************************/
+static bool init_utm
+(
+    int zone,              /* I: UTM zone; negative for southern zones */
+    int spheroid,          /* I: GCTP spheroid number */
+    Utm_proj_t *utm        /* O: UTM constants */
+)
+{
+    double r_minor;        /* semi-minor axis */
+    double es;             /* eccentricity squared */
+
+    if (abs (zone) < 1 || abs (zone) > 60)
+        return (false);
+
+    if (!get_spheroid_axes (spheroid, &utm->r_major, &r_minor))
+        return (false);
+
+    es = 1.0 - (r_minor / utm->r_major) * (r_minor / utm->r_major);
+    utm->es = es;
+    utm->esp = es / (1.0 - es);
+    utm->e0 = 1.0 - 0.25 * es * (1.0 + es / 16.0 * (3.0 + 1.25 * es));
+    utm->e1 = 0.375 * es * (1.0 + 0.25 * es * (1.0 + 0.46875 * es));
+    utm->e2 = 0.05859375 * es * es * (1.0 + 0.75 * es);
+    utm->e3 = es * es * es * (35.0 / 3072.0);
+
+    utm->scale_factor = 0.9996;
+    utm->lon_center = ((6 * abs (zone)) - 183) * RAD;
+    utm->false_easting = 500000.0;
+    utm->false_northing = (zone < 0) ? 10000000.0 : 0.0;
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  utm_adjust_lon
+
+PURPOSE:  Wraps a longitude into the range -PI to PI.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+           Adjusted longitude (radians)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static inline double utm_adjust_lon
+(
+    double lon             /* I: longitude (radians) */
+)
+{
+    while (fabs (lon) > PI)
+        lon -= (lon < 0.0) ? -2.0 * PI : 2.0 * PI;
+    return (lon);
+}
+
+
+/******************************************************************************
+MODULE:  utm_inverse
+
+PURPOSE:  Maps a UTM projection coordinate to longitude and latitude.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The latitude failed to converge
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the ellipsoidal Transverse Mercator inverse from GCTP (tminv.c),
+   specialized for UTM (latitude of origin of zero) with the zone constants
+   precomputed by init_utm.  The multiple angle sines are built from one sin
+   and cos per iteration, which agrees with GCTP to the last bit or two.
+******************************************************************************/
+static inline bool utm_inverse
+(
+    const Utm_proj_t *utm, /* I: UTM constants */
+    double x,              /* I: projection x (meters) */
+    double y,              /* I: projection y (meters) */
+    double *lon,           /* O: longitude (radians) */
+    double *lat            /* O: latitude (radians) */
+)
+{
+    double con, phi;                  /* temporary angles */
+    double delta_phi;                 /* difference between latitudes */
+    double sin_phi, cos_phi, tan_phi; /* sin, cos, and tangent values */
+    double sin_2phi, cos_2phi;        /* sin and cos of twice the latitude */
+    double c, cs, t, ts, n, r, d, ds; /* temporary variables */
+    double esp = utm->esp;            /* second eccentricity squared */
+    int i;                            /* iteration counter */
+
+    x -= utm->false_easting;
+    y -= utm->false_northing;
+
+    /* Iterate for the footpoint latitude */
+    con = (y / utm->scale_factor) / utm->r_major;
+    phi = con;
+    for (i = 0; ; i++)
+    {
+        /* sin(4*phi) and sin(6*phi) come from the multiple angle identities
+           so each iteration needs a single sin and cos */
+        sin_2phi = sin (2.0 * phi);
+        cos_2phi = cos (2.0 * phi);
+        delta_phi = ((con + utm->e1 * sin_2phi - utm->e2 * 2.0 * sin_2phi *
+            cos_2phi + utm->e3 * sin_2phi * (3.0 - 4.0 * sin_2phi *
+            sin_2phi)) / utm->e0) - phi;
+        phi += delta_phi;
+        if (fabs (delta_phi) <= UTM_EPSLN)
+            break;
+        if (i >= UTM_MAX_ITER)
+            return (false);
+    }
+
+    if (fabs (phi) >= PI * 0.5)
+    {
+        *lat = (y < 0.0) ? -PI * 0.5 : PI * 0.5;
+        *lon = utm->lon_center;
+        return (true);
+    }
+
+    sin_phi = sin (phi);
+    cos_phi = cos (phi);
+    tan_phi = sin_phi / cos_phi;
+    c = esp * cos_phi * cos_phi;
+    cs = c * c;
+    t = tan_phi * tan_phi;
+    ts = t * t;
+    con = 1.0 - utm->es * sin_phi * sin_phi;
+    n = utm->r_major / sqrt (con);
+    r = n * (1.0 - utm->es) / con;
+    d = x / (n * utm->scale_factor);
+    ds = d * d;
+
+    *lat = phi - (n * tan_phi * ds / r) * (0.5 - ds / 24.0 * (5.0 + 3.0 * t +
+        10.0 * c - 4.0 * cs - 9.0 * esp - ds / 30.0 * (61.0 + 90.0 * t +
+        298.0 * c + 45.0 * ts - 252.0 * esp - 3.0 * cs)));
+    *lon = utm_adjust_lon (utm->lon_center + (d * (1.0 - ds / 6.0 * (1.0 +
+        2.0 * t + c - ds / 20.0 * (5.0 - 2.0 * c + 28.0 * t - 3.0 * cs +
+        8.0 * esp + 24.0 * ts))) / cos_phi));
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  utm_forward
+
+PURPOSE:  Maps a longitude and latitude to a UTM projection coordinate.
+
+RETURN VALUE: N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the ellipsoidal Transverse Mercator forward from GCTP (tmfor.c),
+   specialized for UTM (latitude of origin of zero) with the zone constants
+   precomputed by init_utm.  The multiple angle sines are built from the sin
+   and cos of the latitude.
+******************************************************************************/
+static inline void utm_forward
+(
+    const Utm_proj_t *utm, /* I: UTM constants */
+    double lon,            /* I: longitude (radians) */
+    double lat,            /* I: latitude (radians) */
+    double *x,             /* O: projection x (meters) */
+    double *y              /* O: projection y (meters) */
+)
+{
+    double delta_lon;        /* longitude from the central meridian */
+    double sin_phi, cos_phi; /* sin and cos of the latitude */
+    double al, als;          /* temporary values */
+    double c, t, tq;         /* temporary values */
+    double con, n, ml;       /* cone constant, small m */
+    double sin_2phi, cos_2phi; /* sin and cos of twice the latitude */
+    double esp = utm->esp;   /* second eccentricity squared */
+
+    delta_lon = utm_adjust_lon (lon - utm->lon_center);
+    sin_phi = sin (lat);
+    cos_phi = cos (lat);
+
+    al = cos_phi * delta_lon;
+    als = al * al;
+    c = esp * cos_phi * cos_phi;
+    tq = sin_phi / cos_phi;
+    t = tq * tq;
+    con = 1.0 - utm->es * sin_phi * sin_phi;
+    n = utm->r_major / sqrt (con);
+
+    /* Distance along the meridian, with the multiple angles of the latitude
+       built from its sin and cos */
+    sin_2phi = 2.0 * sin_phi * cos_phi;
+    cos_2phi = cos_phi * cos_phi - sin_phi * sin_phi;
+    ml = utm->r_major * (utm->e0 * lat - utm->e1 * sin_2phi + utm->e2 * 2.0 *
+        sin_2phi * cos_2phi - utm->e3 * sin_2phi * (3.0 - 4.0 * sin_2phi *
+        sin_2phi));
+
+    *x = utm->scale_factor * n * al * (1.0 + als / 6.0 * (1.0 - t + c +
+        als / 20.0 * (5.0 - 18.0 * t + t * t + 72.0 * c - 58.0 * esp))) +
+        utm->false_easting;
+    *y = utm->scale_factor * (ml + n * tq * (als * (0.5 + als / 24.0 *
+        (5.0 - t + 9.0 * c + 4.0 * c * c + als / 30.0 * (61.0 - 58.0 * t +
+        t * t + 600.0 * c - 330.0 * esp))))) + utm->false_northing;
+}
+
+
+/******************************************************************************
+MODULE:  init_sin
+
+PURPOSE:  Precomputes the constants for a sinusoidal grid.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The sinusoidal fast path doesn't support this spheroid
+true       Successfully set up the sinusoidal constants
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This follows the Sinusoidal initialization in GCTP (sinfor.c/sininv.c).
+   GCTP takes the radius from the spheroid code rather than from the sphere
+   radius parameter, so the same is done here.
+2. Only the MODIS sphere is supported; anything else continues to go through
+   GCTP.
+******************************************************************************/
+static bool init_sin
+(
+    int spheroid,          /* I: GCTP spheroid number */
+    const double *proj_param, /* I: GCTP projection parameters, with the
+                                    central meridian in degrees */
+    Sin_proj_t *sin_proj   /* O: sinusoidal constants */
+)
+{
+    if (spheroid != GCTP_MODIS_SPHERE)
+        return (false);
+
+    sin_proj->radius = SIN_MODIS_SPHERE_RADIUS;
+    sin_proj->lon_center = proj_param[4] * RAD;
+    sin_proj->false_easting = proj_param[6];
+    sin_proj->false_northing = proj_param[7];
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  sin_forward
+
+PURPOSE:  Maps a longitude and latitude to a sinusoidal projection coordinate.
+
+RETURN VALUE: N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the spherical Sinusoidal forward from GCTP (sinfor.c).
+******************************************************************************/
+static inline void sin_forward
+(
+    const Sin_proj_t *sin_proj, /* I: sinusoidal constants */
+    double lon,            /* I: longitude (radians) */
+    double lat,            /* I: latitude (radians) */
+    double *x,             /* O: projection x (meters) */
+    double *y              /* O: projection y (meters) */
+)
+{
+    double delta_lon;      /* longitude from the central meridian */
+
+    delta_lon = utm_adjust_lon (lon - sin_proj->lon_center);
+    *x = sin_proj->radius * delta_lon * cos (lat) + sin_proj->false_easting;
+    *y = sin_proj->radius * lat + sin_proj->false_northing;
+}
+
+
+/******************************************************************************
+MODULE:  sin_inverse
+
+PURPOSE:  Maps a sinusoidal projection coordinate to longitude and latitude.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The coordinate is beyond the poles
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the spherical Sinusoidal inverse from GCTP (sininv.c).  Points at
+   the poles get the central meridian.
+******************************************************************************/
+static inline bool sin_inverse
+(
+    const Sin_proj_t *sin_proj, /* I: sinusoidal constants */
+    double x,              /* I: projection x (meters) */
+    double y,              /* I: projection y (meters) */
+    double *lon,           /* O: longitude (radians) */
+    double *lat            /* O: latitude (radians) */
+)
+{
+    double phi;            /* latitude */
+
+    phi = (y - sin_proj->false_northing) / sin_proj->radius;
+    if (fabs (phi) > PI * 0.5)
+        return (false);
+
+    if (fabs (fabs (phi) - PI * 0.5) > SIN_EPSLN)
+        *lon = utm_adjust_lon (sin_proj->lon_center +
+            (x - sin_proj->false_easting) / (sin_proj->radius * cos (phi)));
+    else
+        *lon = sin_proj->lon_center;
+    *lat = phi;
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  sin_to_space_batch
+
+PURPOSE:  Maps an array of points from geodetic coordinates to line, sample
+space for a sinusoidal grid.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      A point is fill
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The fill points are checked before any point is mapped, so the mapping
+   loop is straight-line code with no calls other than cos, which the
+   compiler can unroll and vectorize.
+2. Produces the same results as calling sin_forward for each point in
+   to_space_batch.
+******************************************************************************/
+static bool sin_to_space_batch
+(
+    Geoloc_t *this,          /* I: geolocation structure */
+    int npts,                /* I: number of points to be mapped */
+    Geo_coord_t *geo,        /* I: array of geodetic coordinates (radians) */
+    Img_coord_float_t *img   /* O: array of image coordinates (for UL corner
+                                   of pixel) */
+)
+{
+    char FUNC_NAME[] = "sin_to_space_batch";  /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    int i;                          /* looping variable for the points */
+    double radius = this->sin_proj.radius;          /* sphere radius */
+    double lon_center = this->sin_proj.lon_center;  /* central meridian */
+    double false_easting = this->sin_proj.false_easting;   /* false easting */
+    double false_northing = this->sin_proj.false_northing; /* false northing */
+    double ul_x = this->def.ul_corner.x;  /* UL projection x */
+    double ul_y = this->def.ul_corner.y;  /* UL projection y */
+    double pixel_size_x = this->def.pixel_size[0];  /* pixel size in x */
+    double pixel_size_y = this->def.pixel_size[1];  /* pixel size in y */
+    double sin_orien = this->sin_orien;   /* sine of the orientation */
+    double cos_orien = this->cos_orien;   /* cosine of the orientation */
+    double dx, dy;                  /* delta x, y values */
+
+    for (i = 0; i < npts; i++)
+    {
+        img[i].is_fill = true;
+        if (geo[i].is_fill)
+        {
+            sprintf (errmsg, "Forward mapping called with geodetic coordinate "
+                "that is fill for point %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+    }
+
+    for (i = 0; i < npts; i++)
+    {
+        dx = (radius * utm_adjust_lon (geo[i].lon - lon_center) *
+            cos (geo[i].lat) + false_easting) - ul_x;
+        dy = (radius * geo[i].lat + false_northing) - ul_y;
+
+        img[i].l = ((dx * sin_orien) - (dy * cos_orien)) / pixel_size_y;
+        img[i].s = ((dx * cos_orien) + (dy * sin_orien)) / pixel_size_x;
+        img[i].is_fill = false;
+    }
+
+    /* Successful completion */
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  albers_qs
+
+PURPOSE:  Computes the Albers function q of a latitude.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+           q of the latitude
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is qsfnz from GCTP (cproj.c), for the ellipsoids supported by the
+   fast path.
+******************************************************************************/
+static inline double albers_qs
+(
+    const Albers_proj_t *albers, /* I: Albers constants */
+    double sin_phi         /* I: sine of the latitude */
+)
+{
+    double con = albers->e * sin_phi;  /* eccentricity times the sine */
+
+    return ((1.0 - albers->es) * (sin_phi / (1.0 - con * con) -
+        (0.5 / albers->e) * log ((1.0 - con) / (1.0 + con))));
+}
+
+
+/******************************************************************************
+MODULE:  init_albers
+
+PURPOSE:  Precomputes the constants for an Albers Conical Equal Area grid.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The Albers fast path doesn't support this grid
+true       Successfully set up the Albers constants
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This follows the Albers initialization in GCTP (alberfor.c/alberinv.c),
+   with the standard parallels, central meridian and latitude of origin in
+   degrees before they were converted to DMS.
+2. Standard parallels on opposite sides of the equator are left for GCTP to
+   report.
+3. The coefficients of the series for the latitude from the authalic
+   latitude are from Snyder (1987), equation 3-18.
+******************************************************************************/
+static bool init_albers
+(
+    int spheroid,          /* I: GCTP spheroid number */
+    const double *proj_param, /* I: GCTP projection parameters, with the
+                                    angles in degrees */
+    Albers_proj_t *albers  /* O: Albers constants */
+)
+{
+    double r_minor;        /* semi-minor axis */
+    double lat1, lat2;     /* standard parallels */
+    double lat_origin;     /* latitude of origin */
+    double sin_po, cos_po; /* sin and cos values */
+    double ms1, ms2;       /* small m of the standard parallels */
+    double qs0, qs1, qs2;  /* q of the latitude of origin and the standard
+                              parallels */
+    double con;            /* temporary variable */
+    double es;             /* eccentricity squared */
+
+    if (!get_spheroid_axes (spheroid, &albers->r_major, &r_minor))
+        return (false);
+
+    lat1 = proj_param[2] * RAD;
+    lat2 = proj_param[3] * RAD;
+    lat_origin = proj_param[5] * RAD;
+    if (fabs (lat1 + lat2) < ALBERS_EPSLN)
+        return (false);
+
+    albers->lon_center = proj_param[4] * RAD;
+    albers->false_easting = proj_param[6];
+    albers->false_northing = proj_param[7];
+    albers->es = 1.0 - (r_minor / albers->r_major) * (r_minor /
+        albers->r_major);
+    albers->e = sqrt (albers->es);
+
+    sin_po = sin (lat1);
+    cos_po = cos (lat1);
+    con = albers->e * sin_po;
+    ms1 = cos_po / sqrt (1.0 - con * con);
+    qs1 = albers_qs (albers, sin_po);
+
+    sin_po = sin (lat2);
+    cos_po = cos (lat2);
+    con = albers->e * sin_po;
+    ms2 = cos_po / sqrt (1.0 - con * con);
+    qs2 = albers_qs (albers, sin_po);
+
+    qs0 = albers_qs (albers, sin (lat_origin));
+
+    if (fabs (lat1 - lat2) > ALBERS_EPSLN)
+        albers->ns0 = (ms1 * ms1 - ms2 * ms2) / (qs2 - qs1);
+    else
+        albers->ns0 = sin (lat1);
+    albers->c = ms1 * ms1 + albers->ns0 * qs1;
+    albers->rh = albers->r_major * sqrt (albers->c - albers->ns0 * qs0) /
+        albers->ns0;
+    albers->pole_con = 1.0 - 0.5 * (1.0 - albers->es) * log ((1.0 -
+        albers->e) / (1.0 + albers->e)) / albers->e;
+
+    es = albers->es;
+    albers->auth[0] = es / 3.0 + es * es * 31.0 / 180.0 + es * es * es *
+        517.0 / 5040.0;
+    albers->auth[1] = es * es * 23.0 / 360.0 + es * es * es * 251.0 / 3780.0;
+    albers->auth[2] = es * es * es * 761.0 / 45360.0;
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  albers_forward
+
+PURPOSE:  Maps a longitude and latitude to an Albers projection coordinate.
+
+RETURN VALUE: N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the ellipsoidal Albers forward from GCTP (alberfor.c) with the
+   grid constants precomputed by init_albers.
+******************************************************************************/
+static inline void albers_forward
+(
+    const Albers_proj_t *albers, /* I: Albers constants */
+    double lon,            /* I: longitude (radians) */
+    double lat,            /* I: latitude (radians) */
+    double *x,             /* O: projection x (meters) */
+    double *y              /* O: projection y (meters) */
+)
+{
+    double rh1;            /* radius of the parallel of the latitude */
+    double theta;          /* angle from the central meridian */
+
+    rh1 = albers->r_major * sqrt (albers->c - albers->ns0 *
+        albers_qs (albers, sin (lat))) / albers->ns0;
+    theta = albers->ns0 * utm_adjust_lon (lon - albers->lon_center);
+    *x = rh1 * sin (theta) + albers->false_easting;
+    *y = albers->rh - rh1 * cos (theta) + albers->false_northing;
+}
+
+
+/******************************************************************************
+MODULE:  albers_inverse
+
+PURPOSE:  Maps an Albers projection coordinate to longitude and latitude.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The latitude failed to converge
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the ellipsoidal Albers inverse from GCTP (alberinv.c), with the
+   latitude iteration of phi1z (cproj.c) inlined.
+2. GCTP starts the iteration from the spherical latitude, which takes
+   three or more iterations, each with a log.  Here it is started from the
+   series for the latitude from the authalic latitude, which is already
+   within about 1e-9 radians, so a single iteration converges.
+******************************************************************************/
+static inline bool albers_inverse
+(
+    const Albers_proj_t *albers, /* I: Albers constants */
+    double x,              /* I: projection x (meters) */
+    double y,              /* I: projection y (meters) */
+    double *lon,           /* O: longitude (radians) */
+    double *lat            /* O: latitude (radians) */
+)
+{
+    double rh1;            /* radius of the parallel of the point */
+    double qs;             /* q of the latitude */
+    double con;            /* temporary sign value */
+    double com;            /* temporary variable */
+    double theta;          /* angle from the central meridian */
+    double phi;            /* latitude */
+    double dphi;           /* change in the latitude */
+    double sin_phi, cos_phi; /* sin and cos of the latitude */
+    double sin_2b, cos_2b; /* sin and cos of twice the authalic latitude */
+    double e = albers->e;  /* eccentricity */
+    int i;                 /* iteration counter */
+
+    x -= albers->false_easting;
+    y = albers->rh - y + albers->false_northing;
+    con = (albers->ns0 >= 0.0) ? 1.0 : -1.0;
+    rh1 = con * sqrt (x * x + y * y);
+    theta = 0.0;
+    if (rh1 != 0.0)
+        theta = atan2 (con * x, con * y);
+    con = rh1 * albers->ns0 / albers->r_major;
+    qs = (albers->c - con * con) / albers->ns0;
+
+    if (fabs (fabs (albers->pole_con) - fabs (qs)) > ALBERS_EPSLN)
+    {
+        /* Start from the series for the latitude, with the multiple angles
+           of the authalic latitude built from one sin and cos */
+        con = qs / albers->pole_con;
+        phi = asin ((con > 1.0) ? 1.0 : (con < -1.0) ? -1.0 : con);
+        sin_2b = sin (2.0 * phi);
+        cos_2b = cos (2.0 * phi);
+        phi += sin_2b * (albers->auth[0] + albers->auth[1] * 2.0 * cos_2b +
+            albers->auth[2] * (3.0 - 4.0 * sin_2b * sin_2b));
+
+        /* Iterate for the latitude */
+        for (i = 1; ; i++)
+        {
+            sin_phi = sin (phi);
+            cos_phi = cos (phi);
+            con = e * sin_phi;
+            com = 1.0 - con * con;
+            dphi = 0.5 * com * com / cos_phi * (qs / (1.0 - albers->es) -
+                sin_phi / com + 0.5 / e * log ((1.0 - con) / (1.0 + con)));
+            phi += dphi;
+            if (fabs (dphi) <= ALBERS_PHI_EPSLN)
+                break;
+            if (i >= ALBERS_MAX_ITER)
+                return (false);
+        }
+        *lat = phi;
+    }
+    else
+        *lat = (qs >= 0.0) ? PI * 0.5 : -PI * 0.5;
+    *lon = utm_adjust_lon (theta / albers->ns0 + albers->lon_center);
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  ps_small_t
+
+PURPOSE:  Computes the conformal small t of a latitude for the polar
+stereographic projection.
+
+RETURN VALUE:
+Type = double
+Value      Description
+-----      -----------
+           Small t of the latitude
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is tsfnz from GCTP (cproj.c).
+******************************************************************************/
+static inline double ps_small_t
+(
+    double e,              /* I: eccentricity */
+    double phi,            /* I: latitude (radians) */
+    double sin_phi         /* I: sine of the latitude */
+)
+{
+    double con = e * sin_phi;  /* eccentricity times the sine */
+
+    return (tan (0.5 * (PI * 0.5 - phi)) / pow ((1.0 - con) / (1.0 + con),
+        0.5 * e));
+}
+
+
+/******************************************************************************
+MODULE:  init_ps
+
+PURPOSE:  Precomputes the constants for a polar stereographic grid.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The PS fast path doesn't support this spheroid
+true       Successfully set up the PS constants
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This follows the polar stereographic initialization in GCTP
+   (psfor.c/psinv.c), with the longitude of the pole and the latitude of
+   true scale in degrees before they were converted to DMS.  The ratio of
+   the distance from the pole to small t is folded into one constant.
+2. The coefficients of the series for the latitude from the conformal
+   latitude are from Snyder (1987), equation 3-5.
+******************************************************************************/
+static bool init_ps
+(
+    int spheroid,          /* I: GCTP spheroid number */
+    const double *proj_param, /* I: GCTP projection parameters, with the
+                                    angles in degrees */
+    Ps_proj_t *ps          /* O: PS constants */
+)
+{
+    double r_minor;        /* semi-minor axis */
+    double center_lat;     /* latitude of true scale */
+    double con;            /* temporary variable */
+    double mcs, tcs;       /* small m and small t of the latitude of true
+                              scale */
+    double e4;             /* e4 of the eccentricity */
+    double sin_phi, cos_phi; /* sin and cos values */
+    double es;             /* eccentricity squared */
+
+    if (!get_spheroid_axes (spheroid, &ps->r_major, &r_minor))
+        return (false);
+
+    ps->lon_center = proj_param[4] * RAD;
+    center_lat = proj_param[5] * RAD;
+    ps->false_easting = proj_param[6];
+    ps->false_northing = proj_param[7];
+    ps->e = sqrt (1.0 - (r_minor / ps->r_major) * (r_minor / ps->r_major));
+    ps->fac = (center_lat < 0.0) ? -1.0 : 1.0;
+
+    if (fabs (fabs (center_lat) - PI * 0.5) > PS_EPSLN)
+    {
+        con = ps->fac * center_lat;
+        sin_phi = sin (con);
+        cos_phi = cos (con);
+        mcs = cos_phi / sqrt (1.0 - ps->e * ps->e * sin_phi * sin_phi);
+        tcs = ps_small_t (ps->e, con, sin_phi);
+        ps->rh_scale = ps->r_major * mcs / tcs;
+    }
+    else
+    {
+        e4 = sqrt (pow (1.0 + ps->e, 1.0 + ps->e) *
+            pow (1.0 - ps->e, 1.0 - ps->e));
+        ps->rh_scale = 2.0 * ps->r_major / e4;
+    }
+
+    es = ps->e * ps->e;
+    ps->conf[0] = es / 2.0 + es * es * 5.0 / 24.0 + es * es * es / 12.0 +
+        es * es * es * es * 13.0 / 360.0;
+    ps->conf[1] = es * es * 7.0 / 48.0 + es * es * es * 29.0 / 240.0 +
+        es * es * es * es * 811.0 / 11520.0;
+    ps->conf[2] = es * es * es * 7.0 / 120.0 + es * es * es * es * 81.0 /
+        1120.0;
+    ps->conf[3] = es * es * es * es * 4279.0 / 161280.0;
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  ps_forward
+
+PURPOSE:  Maps a longitude and latitude to a polar stereographic projection
+coordinate.
+
+RETURN VALUE: N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the ellipsoidal polar stereographic forward from GCTP (psfor.c)
+   with the grid constants precomputed by init_ps.
+******************************************************************************/
+static inline void ps_forward
+(
+    const Ps_proj_t *ps,   /* I: PS constants */
+    double lon,            /* I: longitude (radians) */
+    double lat,            /* I: latitude (radians) */
+    double *x,             /* O: projection x (meters) */
+    double *y              /* O: projection y (meters) */
+)
+{
+    double delta_lon;      /* longitude from the pole's longitude */
+    double phi;            /* latitude, positive toward the pole */
+    double rh;             /* distance from the pole */
+
+    delta_lon = ps->fac * utm_adjust_lon (lon - ps->lon_center);
+    phi = ps->fac * lat;
+    rh = ps->rh_scale * ps_small_t (ps->e, phi, sin (phi));
+    *x = ps->fac * rh * sin (delta_lon) + ps->false_easting;
+    *y = -ps->fac * rh * cos (delta_lon) + ps->false_northing;
+}
+
+
+/******************************************************************************
+MODULE:  ps_inverse
+
+PURPOSE:  Maps a polar stereographic projection coordinate to longitude and
+latitude.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      The latitude failed to converge
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. This is the ellipsoidal polar stereographic inverse from GCTP (psinv.c),
+   with the latitude iteration of phi2z (cproj.c) inlined.
+2. GCTP starts the iteration from the conformal latitude, which takes four
+   or five iterations, each with an atan and a pow.  Here it is started from
+   the series for the latitude from the conformal latitude, which is already
+   within about 1e-11 radians, so a single iteration converges.
+******************************************************************************/
+static inline bool ps_inverse
+(
+    const Ps_proj_t *ps,   /* I: PS constants */
+    double x,              /* I: projection x (meters) */
+    double y,              /* I: projection y (meters) */
+    double *lon,           /* O: longitude (radians) */
+    double *lat            /* O: latitude (radians) */
+)
+{
+    double rh;             /* distance from the pole */
+    double ts;             /* small t of the latitude */
+    double phi;            /* latitude, positive toward the pole */
+    double dphi;           /* change in the latitude */
+    double con;            /* temporary variable */
+    double sin_2c, cos_2c; /* sin and cos of twice the conformal latitude */
+    double e = ps->e;      /* eccentricity */
+    int i;                 /* iteration counter */
+
+    x = (x - ps->false_easting) * ps->fac;
+    y = (y - ps->false_northing) * ps->fac;
+    rh = sqrt (x * x + y * y);
+    ts = rh / ps->rh_scale;
+
+    /* Start from the series for the latitude, with the multiple angles of
+       the conformal latitude built from one sin and cos */
+    phi = PI * 0.5 - 2.0 * atan (ts);
+    sin_2c = sin (2.0 * phi);
+    cos_2c = cos (2.0 * phi);
+    phi += sin_2c * (ps->conf[0] + ps->conf[1] * 2.0 * cos_2c + ps->conf[2] *
+        (3.0 - 4.0 * sin_2c * sin_2c) + ps->conf[3] * 4.0 * cos_2c * (1.0 -
+        2.0 * sin_2c * sin_2c));
+
+    /* Iterate for the latitude */
+    for (i = 0; ; i++)
+    {
+        con = e * sin (phi);
+        dphi = PI * 0.5 - 2.0 * atan (ts * pow ((1.0 - con) / (1.0 + con),
+            0.5 * e)) - phi;
+        phi += dphi;
+        if (fabs (dphi) <= PS_EPSLN)
+            break;
+        if (i >= PS_MAX_ITER)
+            return (false);
+    }
+
+    *lat = ps->fac * phi;
+    if (rh == 0.0)
+        *lon = ps->fac * ps->lon_center;
+    else
+        *lon = utm_adjust_lon (ps->fac * atan2 (x, -y) + ps->lon_center);
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  conic_to_space_batch
+
+PURPOSE:  Maps an array of points from geodetic coordinates to line, sample
+space for an Albers or polar stereographic grid.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      A point is fill
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Like sin_to_space_batch, the fill points are checked before any point is
+   mapped.  The Albers and PS forward equations are closed-form, so each
+   mapping loop is straight-line code over the points, with the grid
+   constants held in locals.
+2. Produces the same results as calling albers_forward or ps_forward for
+   each point in to_space_batch.
+******************************************************************************/
+static bool conic_to_space_batch
+(
+    Geoloc_t *this,          /* I: geolocation structure */
+    int npts,                /* I: number of points to be mapped */
+    Geo_coord_t *geo,        /* I: array of geodetic coordinates (radians) */
+    Img_coord_float_t *img   /* O: array of image coordinates (for UL corner
+                                   of pixel) */
+)
+{
+    char FUNC_NAME[] = "conic_to_space_batch";  /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    int i;                          /* looping variable for the points */
+    Albers_proj_t albers = this->albers;  /* local copy of the Albers
+                                             constants */
+    Ps_proj_t ps = this->ps;        /* local copy of the PS constants */
+    double ul_x = this->def.ul_corner.x;  /* UL projection x */
+    double ul_y = this->def.ul_corner.y;  /* UL projection y */
+    double pixel_size_x = this->def.pixel_size[0];  /* pixel size in x */
+    double pixel_size_y = this->def.pixel_size[1];  /* pixel size in y */
+    double sin_orien = this->sin_orien;   /* sine of the orientation */
+    double cos_orien = this->cos_orien;   /* cosine of the orientation */
+    double x, y;                    /* projection coordinates */
+    double dx, dy;                  /* delta x, y values */
+
+    for (i = 0; i < npts; i++)
+    {
+        img[i].is_fill = true;
+        if (geo[i].is_fill)
+        {
+            sprintf (errmsg, "Forward mapping called with geodetic coordinate "
+                "that is fill for point %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+    }
+
+    /* Separate loops for each projection, so neither has a branch on the
+       projection */
+    if (this->use_albers)
+    {
+        for (i = 0; i < npts; i++)
+        {
+            albers_forward (&albers, geo[i].lon, geo[i].lat, &x, &y);
+            dx = x - ul_x;
+            dy = y - ul_y;
+
+            img[i].l = ((dx * sin_orien) - (dy * cos_orien)) / pixel_size_y;
+            img[i].s = ((dx * cos_orien) + (dy * sin_orien)) / pixel_size_x;
+            img[i].is_fill = false;
+        }
+    }
+    else
+    {
+        for (i = 0; i < npts; i++)
+        {
+            ps_forward (&ps, geo[i].lon, geo[i].lat, &x, &y);
+            dx = x - ul_x;
+            dy = y - ul_y;
+
+            img[i].l = ((dx * sin_orien) - (dy * cos_orien)) / pixel_size_y;
+            img[i].s = ((dx * cos_orien) + (dy * sin_orien)) / pixel_size_x;
+            img[i].is_fill = false;
+        }
+    }
+
+    /* Successful completion */
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  same_mapping_key
+
+PURPOSE:  Determines whether a mapping cache key is for the projection of a
+space definition.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Key is for another projection
+true       Key is for the projection
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static bool same_mapping_key
+(
+    const Mapping_key_t *key,    /* I: mapping cache key */
+    const Space_def_t *space_def /* I: space definition structure */
+)
+{
+    int i;                       /* looping variable */
+
+    if (key->proj_num != space_def->proj_num ||
+        key->zone != space_def->zone || key->spheroid != space_def->spheroid)
+        return (false);
+
+    for (i = 0; i < NPROJ_PARAM; i++)
+    {
+        if (key->proj_param[i] != space_def->proj_param[i])
+            return (false);
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  set_mapping_key
+
+PURPOSE:  Sets a mapping cache key to a projection.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void set_mapping_key
+(
+    Mapping_key_t *key,          /* O: mapping cache key */
+    int proj_num,                /* I: GCTP projection number */
+    int zone,                    /* I: GCTP zone number */
+    int spheroid,                /* I: GCTP spheroid number */
+    const double *proj_param     /* I: GCTP projection parameters, angles in
+                                       degrees */
+)
+{
+    key->proj_num = proj_num;
+    key->zone = zone;
+    key->spheroid = spheroid;
+    memcpy (key->proj_param, proj_param, sizeof (key->proj_param));
+}
+
+
+/******************************************************************************
+MODULE:  init_mapping_proj
+
+PURPOSE:  Sets up the projection part of the geolocation data structure,
+converting the angular projection parameters to DMS and initializing the
+forward and inverse mapping functions via GCTP.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred in the setup
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The mapping cache lock must be held, since GCTP is initialized.
+******************************************************************************/
+static int init_mapping_proj
+(
+    Geoloc_t *this,            /* I/O: geolocation structure with the space
+                                       definition copied */
+    const double *proj_param   /* I: GCTP projection parameters, angles in
+                                     degrees */
+)
+{
+    char FUNC_NAME[] = "init_mapping_proj"; /* function name */
+    char errmsg[STR_SIZE];              /* error message */
+    char file27[] = "FILE27";           /* file for NAD27 (only for State Plane)
+                                           so just use something fake for now */
+    char file83[] = "FILE83";           /* file for NAD83 (only for State Plane)
+                                           so just use something fake for now */
+    double temp1, temp2;                /* temp variables for PS projection */
+    int iflag;                          /* return status from GCTP */
+    int (*for_trans[MAX_PROJ + 1])();   /* forward transformation function */
+    int (*inv_trans[MAX_PROJ + 1])();   /* inverse transformation function */
+
+    /* Convert angular projection parameters to DMS the necessary projections */
+    if (this->def.proj_num == GCTP_PS_PROJ)
+    {
+        /* Central meridian and origin of latitude */
+        if (!degdms (&this->def.proj_param[4], &temp1, "DEG", "LON" ) ||
+            !degdms (&this->def.proj_param[5], &temp2, "DEG", "LAT" ))
+        {
+            sprintf (errmsg, "Converting PS angular parameters from degrees "
+                "to DMS");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->def.proj_param[4] = temp1;
+        this->def.proj_param[5] = temp2;
+    }
+    else if (this->def.proj_num == GCTP_ALBERS_PROJ)
+    {
+        /* Standard parallels */
+        if (!degdms (&this->def.proj_param[2], &temp1, "DEG", "LON" ) ||
+            !degdms (&this->def.proj_param[3], &temp2, "DEG", "LAT" ))
+        {
+            sprintf (errmsg, "Converting ALBERS angular parameters from "
+                "degrees to DMS");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->def.proj_param[2] = temp1;
+        this->def.proj_param[3] = temp2;
+
+        /* Central meridian and origin of latitude */
+        if (!degdms (&this->def.proj_param[4], &temp1, "DEG", "LON" ) ||
+            !degdms (&this->def.proj_param[5], &temp2, "DEG", "LAT" ))
+        {
+            sprintf (errmsg, "Converting ALBERS angular parameters from "
+                "degrees to DMS");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->def.proj_param[4] = temp1;
+        this->def.proj_param[5] = temp2;
+    }
+    else if (this->def.proj_num == GCTP_SIN_PROJ)
+    {
+        if (!degdms (&this->def.proj_param[4], &temp1, "DEG", "LON" ))
+        {
+            sprintf (errmsg, "Converting SIN angular parameters from degrees "
+                "to DMS");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        this->def.proj_param[4] = temp1;
+    }
+     
+    /* Setup the forward transform */
+    gctp_mapping_set = false;
+    for_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
+        this->def.spheroid, file27, file83, &iflag, for_trans);
+    if (iflag)
+    {
+        sprintf (errmsg, "Error returned from for_init");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    this->for_trans = for_trans[this->def.proj_num];
+  
+    /* Setup the inverse transform */
+    inv_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
+        this->def.spheroid, file27, file83, &iflag, inv_trans);
+    if (iflag)
+    {
+        sprintf (errmsg, "Error returned from for_init");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    this->inv_trans = inv_trans[this->def.proj_num];
+    gctp_mapping_set = true;
+    set_mapping_key (&gctp_mapping, this->def.proj_num, this->def.zone,
+        this->def.spheroid, proj_param);
+
+    /* UTM scenes are mapped with the precomputed zone constants instead of
+       going through the GCTP function pointers */
+    this->use_utm = false;
+    if (this->def.proj_num == GCTP_UTM_PROJ)
+        this->use_utm = init_utm (this->def.zone, this->def.spheroid,
+            &this->utm);
+
+    /* Likewise for sinusoidal tiles, whose constants are set from the
+       central meridian in degrees before it was converted to DMS */
+    this->use_sin = false;
+    if (this->def.proj_num == GCTP_SIN_PROJ)
+        this->use_sin = init_sin (this->def.spheroid, proj_param,
+            &this->sin_proj);
+
+    /* And for Albers and polar stereographic grids */
+    this->use_albers = false;
+    if (this->def.proj_num == GCTP_ALBERS_PROJ)
+        this->use_albers = init_albers (this->def.spheroid, proj_param,
+            &this->albers);
+    this->use_ps = false;
+    if (this->def.proj_num == GCTP_PS_PROJ)
+        this->use_ps = init_ps (this->def.spheroid, proj_param, &this->ps);
+  
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  setup_mapping
 
@@ -65,6 +1400,10 @@ NOTES:
    routine to free the memory for this pointer.
 2. Make sure the corners Space_def_t are reported as the upper left of the
    the since that's what the other routines are expecting.
+3. The projection setup is cached by projection number, zone, spheroid
+   (datum) and projection parameters, so processing many scenes in the same
+   few projections doesn't convert the parameters and initialize GCTP for
+   each scene.
 ******************************************************************************/
 Geoloc_t *setup_mapping
 (
@@ -73,16 +1412,11 @@ Geoloc_t *setup_mapping
 {
     char FUNC_NAME[] = "setup_mapping"; /* function name */
     char errmsg[STR_SIZE];              /* error message */
-    char file27[] = "FILE27";           /* file for NAD27 (only for State Plane)
-                                           so just use something fake for now */
-    char file83[] = "FILE83";           /* file for NAD83 (only for State Plane)
-                                           so just use something fake for now */
     Geoloc_t *this = NULL;              /* pointer to the space structure */
-    double temp1, temp2;                /* temp variables for PS projection */
+    Geoloc_t *cached = NULL;            /* cached setup of the projection */
+    Mapping_cache_t *entry = NULL;      /* mapping cache entry to fill */
     int i;                              /* looping variable */
-    int iflag;                          /* return status from GCTP */
-    int (*for_trans[MAX_PROJ + 1])();   /* forward transformation function */
-    int (*inv_trans[MAX_PROJ + 1])();   /* inverse transformation function */
+    int status = SUCCESS;               /* return status */
   
     /* Verify some of the space definition parameters */
     if (space_def->img_size.l < 1) 
@@ -141,86 +1475,66 @@ Geoloc_t *setup_mapping
     this->sin_orien = sin (space_def->orientation_angle);
     this->cos_orien = cos (space_def->orientation_angle);
   
-    /* Convert angular projection parameters to DMS the necessary projections */
-    if (this->def.proj_num == GCTP_PS_PROJ)
+    /* Reuse the projection setup of an earlier call for the same
+       projection, if it's cached */
+    pthread_mutex_lock (&mapping_cache_lock);
+    for (i = 0; i < num_mapping_cache; i++)
     {
-        /* Central meridian and origin of latitude */
-        if (!degdms (&this->def.proj_param[4], &temp1, "DEG", "LON" ) ||
-            !degdms (&this->def.proj_param[5], &temp2, "DEG", "LAT" ))
-        {
-            free (this);
-            sprintf (errmsg, "Converting PS angular parameters from degrees "
-                "to DMS");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (NULL);
-        }
-        this->def.proj_param[4] = temp1;
-        this->def.proj_param[5] = temp2;
+        if (same_mapping_key (&mapping_cache[i].key, space_def))
+            break;
     }
-    else if (this->def.proj_num == GCTP_ALBERS_PROJ)
+    if (i < num_mapping_cache)
     {
-        /* Standard parallels */
-        if (!degdms (&this->def.proj_param[2], &temp1, "DEG", "LON" ) ||
-            !degdms (&this->def.proj_param[3], &temp2, "DEG", "LAT" ))
-        {
-            free (this);
-            sprintf (errmsg, "Converting ALBERS angular parameters from "
-                "degrees to DMS");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (NULL);
-        }
-        this->def.proj_param[2] = temp1;
-        this->def.proj_param[3] = temp2;
-
-        /* Central meridian and origin of latitude */
-        if (!degdms (&this->def.proj_param[4], &temp1, "DEG", "LON" ) ||
-            !degdms (&this->def.proj_param[5], &temp2, "DEG", "LAT" ))
+        cached = &mapping_cache[i].setup;
+        for (i = 0; i < NPROJ_PARAM; i++) 
+            this->def.proj_param[i] = cached->def.proj_param[i];
+        this->for_trans = cached->for_trans;
+        this->inv_trans = cached->inv_trans;
+        this->use_utm = cached->use_utm;
+        this->utm = cached->utm;
+        this->use_sin = cached->use_sin;
+        this->sin_proj = cached->sin_proj;
+        this->use_albers = cached->use_albers;
+        this->albers = cached->albers;
+        this->use_ps = cached->use_ps;
+        this->ps = cached->ps;
+
+        /* The GCTP functions keep their state in globals, so GCTP has to be
+           initialized again if it was last set up for another projection */
+        if (!this->use_utm && !this->use_sin && !this->use_albers &&
+            !this->use_ps &&
+            (!gctp_mapping_set || !same_mapping_key (&gctp_mapping, space_def)))
         {
-            free (this);
-            sprintf (errmsg, "Converting ALBERS angular parameters from "
-                "degrees to DMS");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (NULL);
+            for (i = 0; i < NPROJ_PARAM; i++) 
+                this->def.proj_param[i] = space_def->proj_param[i];
+            status = init_mapping_proj (this, space_def->proj_param);
         }
-        this->def.proj_param[4] = temp1;
-        this->def.proj_param[5] = temp2;
     }
-    else if (this->def.proj_num == GCTP_SIN_PROJ)
+    else
     {
-        if (!degdms (&this->def.proj_param[4], &temp1, "DEG", "LON" ))
+        status = init_mapping_proj (this, space_def->proj_param);
+        if (status == SUCCESS)
         {
-            free (this);
-            sprintf (errmsg, "Converting SIN angular parameters from degrees "
-                "to DMS");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (NULL);
+            /* Cache the setup, replacing the oldest one if the cache is
+               full */
+            entry = &mapping_cache[next_mapping_cache];
+            next_mapping_cache = (next_mapping_cache + 1) % MAPPING_CACHE_SIZE;
+            if (num_mapping_cache < MAPPING_CACHE_SIZE)
+                num_mapping_cache++;
+            set_mapping_key (&entry->key, space_def->proj_num, space_def->zone,
+                space_def->spheroid, space_def->proj_param);
+            entry->setup = *this;
         }
-        this->def.proj_param[4] = temp1;
-    }
-     
-    /* Setup the forward transform */
-    for_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
-        this->def.spheroid, file27, file83, &iflag, for_trans);
-    if (iflag)
-    {
-        free (this);
-        sprintf (errmsg, "Error returned from for_init");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (NULL);
     }
-    this->for_trans = for_trans[this->def.proj_num];
-  
-    /* Setup the inverse transform */
-    inv_init (this->def.proj_num, this->def.zone, this->def.proj_param, 
-        this->def.spheroid, file27, file83, &iflag, inv_trans);
-    if (iflag)
+    pthread_mutex_unlock (&mapping_cache_lock);
+
+    if (status != SUCCESS)
     {
         free (this);
-        sprintf (errmsg, "Error returned from for_init");
+        sprintf (errmsg, "Setting up the projection");
         error_handler (true, FUNC_NAME, errmsg);
         return (NULL);
     }
-    this->inv_trans = inv_trans[this->def.proj_num];
   
     /* Successful completion */
     return (this);
@@ -270,7 +1584,15 @@ bool to_space
     }
 
     /* Do the forward mapping */
-    if (this->for_trans (geo->lon, geo->lat, &map.x, &map.y) != GCTP_OK) 
+    if (this->use_utm)
+        utm_forward (&this->utm, geo->lon, geo->lat, &map.x, &map.y);
+    else if (this->use_sin)
+        sin_forward (&this->sin_proj, geo->lon, geo->lat, &map.x, &map.y);
+    else if (this->use_albers)
+        albers_forward (&this->albers, geo->lon, geo->lat, &map.x, &map.y);
+    else if (this->use_ps)
+        ps_forward (&this->ps, geo->lon, geo->lat, &map.x, &map.y);
+    else if (this->for_trans (geo->lon, geo->lat, &map.x, &map.y) != GCTP_OK) 
     {
         sprintf (errmsg, "Geodetic coordinate failed the forward mapping.");
         error_handler (true, FUNC_NAME, errmsg);
@@ -324,6 +1646,7 @@ bool from_space
     Map_coord_t map;                  /* coordinate in projection space */
     double dx, dy;                    /* delta x, y values */
     double dl, ds;                    /* delta line, sample values */
+    bool mapped;                      /* was the point mapped? */
 
     /* If this coordinate is fill then skip */
     geo->is_fill = true;
@@ -346,7 +1669,20 @@ bool from_space
     map.x = this->def.ul_corner.x + dx;
 
     /* Do the inverse mapping */
-    if (this->inv_trans (map.x, map.y, &geo->lon, &geo->lat) != GCTP_OK) 
+    if (this->use_utm)
+        mapped = utm_inverse (&this->utm, map.x, map.y, &geo->lon, &geo->lat);
+    else if (this->use_sin)
+        mapped = sin_inverse (&this->sin_proj, map.x, map.y, &geo->lon,
+            &geo->lat);
+    else if (this->use_albers)
+        mapped = albers_inverse (&this->albers, map.x, map.y, &geo->lon,
+            &geo->lat);
+    else if (this->use_ps)
+        mapped = ps_inverse (&this->ps, map.x, map.y, &geo->lon, &geo->lat);
+    else
+        mapped = this->inv_trans (map.x, map.y, &geo->lon, &geo->lat) ==
+            GCTP_OK;
+    if (!mapped)
     {
         sprintf (errmsg, "Projection coordinate failed the inverse mapping.");
         error_handler (true, FUNC_NAME, errmsg);
@@ -359,6 +1695,218 @@ bool from_space
 }
 
 
+/******************************************************************************
+MODULE:  to_space_batch
+
+PURPOSE:  Maps an array of points from geodetic coordinates to line, sample
+space.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Report image coordinates for the UL corner of the pixel.
+2. Produces the same results as calling to_space for each point, but the
+   geolocation fields, including the UTM constants, are pulled out of the
+   structure once for the whole array instead of once per point.
+3. Sinusoidal grids are mapped by sin_to_space_batch, and Albers and polar
+   stereographic grids by conic_to_space_batch.
+******************************************************************************/
+bool to_space_batch
+(
+    Geoloc_t *this,          /* I: geolocation structure; for_trans function
+                                   is used for the forward mapping */
+    int npts,                /* I: number of points to be mapped */
+    Geo_coord_t *geo,        /* I: array of geodetic coordinates (radians) */
+    Img_coord_float_t *img   /* O: array of image coordinates (for UL corner
+                                   of pixel) */
+)
+{
+    char FUNC_NAME[] = "to_space_batch";  /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    int i;                          /* looping variable for the points */
+    int (*for_trans)(double lat, double lon, double *x, double *y);
+                                    /* forward transformation function */
+    Map_coord_t map;                /* coordinate in projection space */
+    double ul_x = this->def.ul_corner.x;  /* UL projection x */
+    double ul_y = this->def.ul_corner.y;  /* UL projection y */
+    double pixel_size_x = this->def.pixel_size[0];  /* pixel size in x */
+    double pixel_size_y = this->def.pixel_size[1];  /* pixel size in y */
+    double sin_orien = this->sin_orien;   /* sine of the orientation */
+    double cos_orien = this->cos_orien;   /* cosine of the orientation */
+    bool use_utm = this->use_utm;         /* use the UTM constants? */
+    Utm_proj_t utm = this->utm;           /* local copy of the UTM constants */
+    double dx, dy;                  /* delta x, y values */
+    double dl, ds;                  /* delta line, sample values */
+
+    /* Sinusoidal tiles have their own loop */
+    if (this->use_sin)
+        return (sin_to_space_batch (this, npts, geo, img));
+    if (this->use_albers || this->use_ps)
+        return (conic_to_space_batch (this, npts, geo, img));
+
+    for_trans = this->for_trans;
+    for (i = 0; i < npts; i++)
+    {
+        /* If this coordinate is fill then skip */
+        img[i].is_fill = true;
+        if (geo[i].is_fill)
+        {
+            sprintf (errmsg, "Forward mapping called with geodetic coordinate "
+                "that is fill for point %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+
+        /* Do the forward mapping */
+        if (use_utm)
+            utm_forward (&utm, geo[i].lon, geo[i].lat, &map.x, &map.y);
+        else if (for_trans (geo[i].lon, geo[i].lat, &map.x, &map.y) !=
+            GCTP_OK) 
+        {
+            sprintf (errmsg, "Geodetic coordinate failed the forward mapping "
+                "for point %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+
+        /* Determine the line, sample location from the projection space */
+        dx = map.x - ul_x;
+        dy = map.y - ul_y;
+
+        dl = (dx * sin_orien) - (dy * cos_orien);
+        ds = (dx * cos_orien) + (dy * sin_orien);
+
+        img[i].l = dl / pixel_size_y;
+        img[i].s = ds / pixel_size_x;
+        img[i].is_fill = false;
+    }
+
+    /* Successful completion */
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  from_space_batch
+
+PURPOSE:  Maps an array of points from line, sample space to geodetic
+coordinates.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successful mapping
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Report image coordinates for the UL corner of the pixel.
+2. Produces the same results as calling from_space for each point, but the
+   geolocation fields, including the UTM, sinusoidal, Albers and PS
+   constants, are pulled out of the structure once for the whole array
+   instead of once per point.
+******************************************************************************/
+bool from_space_batch
+(
+    Geoloc_t *this,          /* I: geolocation structure; inv_trans function
+                                   is used for the inverse mapping */
+    int npts,                /* I: number of points to be mapped */
+    Img_coord_float_t *img,  /* I: array of image coordinates (for UL corner
+                                   of pixel) */
+    Geo_coord_t *geo         /* O: array of geodetic coordinates (radians) */
+)
+{
+    char FUNC_NAME[] = "from_space_batch";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int i;                            /* looping variable for the points */
+    int (*inv_trans)(double x, double y, double *lat, double *lon);
+                                      /* inverse transformation function */
+    Map_coord_t map;                  /* coordinate in projection space */
+    double ul_x = this->def.ul_corner.x;  /* UL projection x */
+    double ul_y = this->def.ul_corner.y;  /* UL projection y */
+    double pixel_size_x = this->def.pixel_size[0];  /* pixel size in x */
+    double pixel_size_y = this->def.pixel_size[1];  /* pixel size in y */
+    double sin_orien = this->sin_orien;   /* sine of the orientation */
+    double cos_orien = this->cos_orien;   /* cosine of the orientation */
+    bool use_utm = this->use_utm;         /* use the UTM constants? */
+    Utm_proj_t utm = this->utm;           /* local copy of the UTM constants */
+    bool use_sin = this->use_sin;         /* use the sinusoidal constants? */
+    Sin_proj_t sin_proj = this->sin_proj; /* local copy of the sinusoidal
+                                             constants */
+    bool use_albers = this->use_albers;   /* use the Albers constants? */
+    Albers_proj_t albers = this->albers;  /* local copy of the Albers
+                                             constants */
+    bool use_ps = this->use_ps;           /* use the PS constants? */
+    Ps_proj_t ps = this->ps;              /* local copy of the PS constants */
+    double dx, dy;                    /* delta x, y values */
+    double dl, ds;                    /* delta line, sample values */
+    bool mapped;                      /* was the point mapped? */
+
+    inv_trans = this->inv_trans;
+    for (i = 0; i < npts; i++)
+    {
+        /* If this coordinate is fill then skip */
+        geo[i].is_fill = true;
+        if (img[i].is_fill)
+        {
+            sprintf (errmsg, "Inverse mapping called with line, sample "
+                "coordinate that is fill for point %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+
+        /* Determine the line,sample location in projection space */
+        dl = img[i].l * pixel_size_y;
+        ds = img[i].s * pixel_size_x;
+
+        dy = (ds * sin_orien) - (dl * cos_orien);
+        dx = (ds * cos_orien) + (dl * sin_orien);
+
+        map.y = ul_y + dy;
+        map.x = ul_x + dx;
+
+        /* Do the inverse mapping */
+        if (use_utm)
+            mapped = utm_inverse (&utm, map.x, map.y, &geo[i].lon,
+                &geo[i].lat);
+        else if (use_sin)
+            mapped = sin_inverse (&sin_proj, map.x, map.y, &geo[i].lon,
+                &geo[i].lat);
+        else if (use_albers)
+            mapped = albers_inverse (&albers, map.x, map.y, &geo[i].lon,
+                &geo[i].lat);
+        else if (use_ps)
+            mapped = ps_inverse (&ps, map.x, map.y, &geo[i].lon,
+                &geo[i].lat);
+        else
+            mapped = inv_trans (map.x, map.y, &geo[i].lon, &geo[i].lat) ==
+                GCTP_OK;
+        if (!mapped)
+        {
+            sprintf (errmsg, "Projection coordinate failed the inverse "
+                "mapping for point %d.", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (false);
+        }
+        geo[i].is_fill = false;
+    }
+
+    /* Successful completion */
+    return (true);
+}
+
+
 /******************************************************************************
 MODULE:  get_geoloc_info
 
@@ -518,6 +2066,193 @@ bool get_geoloc_info
 }
 
 
+/******************************************************************************
+MODULE:  get_bounds_step
+
+PURPOSE:  Determines the spacing of the coarse samples along the image edges
+for compute_bounds.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+1          ESPA_BOUNDS_MODE is "exact", so every pixel along the edges is
+           mapped
+BOUNDS_STEP  Adaptive mode (the default)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The environment variable is only read the first time.
+******************************************************************************/
+static int get_bounds_step ()
+{
+    static int step = 0;       /* cached spacing of the edge samples */
+    char *mode = NULL;         /* value of ESPA_BOUNDS_MODE */
+
+    if (step == 0)
+    {
+        mode = getenv ("ESPA_BOUNDS_MODE");
+        if (mode != NULL && !strcmp (mode, "exact"))
+            step = 1;
+        else
+            step = BOUNDS_STEP;
+    }
+
+    return (step);
+}
+
+
+/******************************************************************************
+MODULE:  set_edge_point
+
+PURPOSE:  Sets the image coordinates of a point along one of the image edges.
+
+RETURN VALUE: N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The edges are the outer edges of the image (top, bottom, left, right for
+   edges 0-3), so the bottom and right edges are at nlines and nsamps.
+******************************************************************************/
+static void set_edge_point
+(
+    int edge,                 /* I: edge of the image (0-3) */
+    int pos,                  /* I: sample (top/bottom) or line (left/right)
+                                    along the edge */
+    int nlines,               /* I: number of lines in the scene */
+    int nsamps,               /* I: number of samples in the scene */
+    Img_coord_float_t *img    /* O: image coordinates of the point */
+)
+{
+    if (edge < 2)
+    {
+        img->l = (edge == 0) ? 0.0 : (double) nlines;
+        img->s = (double) pos;
+    }
+    else
+    {
+        img->l = (double) pos;
+        img->s = (edge == 2) ? 0.0 : (double) nsamps;
+    }
+    img->is_fill = false;
+}
+
+
+/******************************************************************************
+MODULE:  update_bounds
+
+PURPOSE:  Expands the bounding coordinates to include a geodetic coordinate.
+
+RETURN VALUE: N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void update_bounds
+(
+    Geo_coord_t *geo,         /* I: geodetic coordinate (radians) */
+    Geo_bounds_t *bounds      /* I/O: boundary for the scene */
+)
+{
+    bounds->max_lat = max (bounds->max_lat, geo->lat*DEG);
+    bounds->min_lat = min (bounds->min_lat, geo->lat*DEG);
+    bounds->max_lon = max (bounds->max_lon, geo->lon*DEG);
+    bounds->min_lon = min (bounds->min_lon, geo->lon*DEG);
+}
+
+
+/******************************************************************************
+MODULE:  refine_bounds
+
+PURPOSE:  Refines the bounding coordinates along the part of an image edge
+between two mapped points, mapping only the points where the edge could
+extend past the current bounds.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error occurred in the mapping
+true       Successfully refined the bounds
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The midpoint of the segment is mapped and compared to the chord between
+   the end points.  Along a smooth edge the lat/long stay within the chord
+   plus the midpoint deviation, so if that can't beat the current bounds by
+   more than BOUNDS_TOL the segment is done.  Otherwise both halves are
+   refined, down to single pixels.
+2. A longitude wrap at the antimeridian shows up as a large deviation, so the
+   segment containing it is refined to single pixels like the full walk.
+******************************************************************************/
+static bool refine_bounds
+(
+    Geoloc_t *space,          /* I: geolocation structure */
+    int edge,                 /* I: edge of the image (0-3) */
+    int nlines,               /* I: number of lines in the scene */
+    int nsamps,               /* I: number of samples in the scene */
+    int first,                /* I: first point of the segment along edge */
+    int last,                 /* I: last point of the segment along edge */
+    Geo_coord_t *first_geo,   /* I: geodetic coordinates of the first point */
+    Geo_coord_t *last_geo,    /* I: geodetic coordinates of the last point */
+    Geo_bounds_t *bounds      /* I/O: boundary for the scene */
+)
+{
+    char FUNC_NAME[] = "refine_bounds";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int mid;                          /* midpoint of the segment */
+    Img_coord_float_t img;            /* image coordinates of the midpoint */
+    Geo_coord_t geo;                  /* geodetic coordinates of midpoint */
+    double lat1, lat2, lon1, lon2;    /* end point lat/long (degrees) */
+    double dlat, dlon;                /* midpoint deviation from the chord */
+
+    /* Every pixel of the segment has already been mapped */
+    if (last - first <= 1)
+        return (true);
+
+    mid = (first + last) / 2;
+    set_edge_point (edge, mid, nlines, nsamps, &img);
+    if (!from_space (space, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping point %d on edge %d of the image to "
+            "lat/long", mid, edge);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (false);
+    }
+    update_bounds (&geo, bounds);
+
+    /* See if the segment could extend past the bounds */
+    lat1 = first_geo->lat * DEG;
+    lat2 = last_geo->lat * DEG;
+    lon1 = first_geo->lon * DEG;
+    lon2 = last_geo->lon * DEG;
+    dlat = fabs (geo.lat * DEG - 0.5 * (lat1 + lat2));
+    dlon = fabs (geo.lon * DEG - 0.5 * (lon1 + lon2));
+    if (max (lat1, lat2) + dlat <= bounds->max_lat + BOUNDS_TOL &&
+        min (lat1, lat2) - dlat >= bounds->min_lat - BOUNDS_TOL &&
+        max (lon1, lon2) + dlon <= bounds->max_lon + BOUNDS_TOL &&
+        min (lon1, lon2) - dlon >= bounds->min_lon - BOUNDS_TOL)
+        return (true);
+
+    /* Refine both halves */
+    if (!refine_bounds (space, edge, nlines, nsamps, first, mid, first_geo,
+        &geo, bounds) ||
+        !refine_bounds (space, edge, nlines, nsamps, mid, last, &geo,
+        last_geo, bounds))
+        return (false);
+
+    return (true);
+}
+
+
 /******************************************************************************
 MODULE:  compute_bounds
 
@@ -544,6 +2279,11 @@ NOTES:
 2. This assumes the setup mapping was setup using the UL of the UL pixel.
    It then loops around the outer edges of each pixel as it loops around the
    outer edges of the entire image.
+3. By default the edges are mapped every BOUNDS_STEP pixels, then each
+   segment between those points is refined only where the edge could extend
+   past the bounds (see refine_bounds).  The bounds are within BOUNDS_TOL
+   degrees of mapping every pixel along the edges, which is still done if
+   ESPA_BOUNDS_MODE is set to "exact".
 ******************************************************************************/
 bool compute_bounds
 (
@@ -559,7 +2299,15 @@ bool compute_bounds
     char errmsg[STR_SIZE];            /* error message */
     Img_coord_float_t img;            /* image coordinates for current pixel */
     Geo_coord_t geo;                  /* geodetic coordinates (note radians) */
-    int ix, iy;                       /* current x,y coordinates */
+    Img_coord_float_t *edge_img = NULL; /* image coordinates along an edge */
+    Geo_coord_t *edge_geo = NULL;     /* geodetic coordinates along the edges */
+    int edge_pts[4];                  /* number of points along each edge */
+    int edge;                         /* current edge of the image */
+    int edge_len;                     /* number of pixels along the edge */
+    int step;                         /* spacing of the points along edges */
+    int max_pts;                      /* number of points on the longest edge */
+    int i;                            /* looping variable for the points */
+    Geo_coord_t *geo_pts = NULL;      /* geodetic coordinates for the edge */
 
     /* Initialize the bounding coordinates with the upper left of the UL
        corner */
@@ -578,94 +2326,73 @@ bool compute_bounds
     bounds->max_lon = geo.lon * DEG;
     bounds->min_lon = geo.lon * DEG;
 
+    /* Allocate the coordinates for the points along each edge of the image */
+    step = get_bounds_step ();
+    max_pts = (max (nlines, nsamps) + step - 1) / step + 1;
+    edge_img = malloc (max_pts * sizeof (Img_coord_float_t));
+    edge_geo = malloc (4 * max_pts * sizeof (Geo_coord_t));
+    if (edge_img == NULL || edge_geo == NULL)
+    {
+        free (edge_img);
+        free (edge_geo);
+        sprintf (errmsg, "Allocating memory for the image edge coordinates");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (false);
+    }
+
     /* Determine the bounding coords by looping around the edges of the image
        in line, sample space and converting to lat/long space. Remember that
        the to/from space mappings are initialized using the UL of the UL corner
        of the image. Thus we need to go an extra pixel to the right and bottom
-       of the image to get the true outer extents. */
-    /** top -- go to (nsamps-1) + 1 to get to the far right edge of the
-        image **/
-    for (ix = 0; ix <= nsamps; ix++)
-    {
-        iy = 0;
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
-        {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (false);
-        }
-
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-    }
-
-    /** bottom -- go to (nsamps-1) + 1 to get to the far right edge of the
-        image **/
-    for (ix = 0; ix <= nsamps; ix++)
+       of the image to get the true outer extents (top, bottom, left, and
+       right edges respectively).  The points along each edge are mapped as a
+       single batch. */
+    for (edge = 0; edge < 4; edge++)
     {
-        iy = nlines;  /* this is actually (nlines-1) + 1 to get to the very
-                         bottom edge of the image */
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
+        edge_len = (edge < 2) ? nsamps : nlines;
+        edge_pts[edge] = (edge_len + step - 1) / step + 1;
+        for (i = 0; i < edge_pts[edge]; i++)
+            set_edge_point (edge, min (i * step, edge_len), nlines, nsamps,
+                &edge_img[i]);
+
+        geo_pts = &edge_geo[edge * max_pts];
+        if (!from_space_batch (space, edge_pts[edge], edge_img, geo_pts))
         {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
+            free (edge_img);
+            free (edge_geo);
+            sprintf (errmsg, "Mapping edge %d of the image to lat/long", edge);
             error_handler (true, FUNC_NAME, errmsg);
             return (false);
         }
 
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
+        for (i = 0; i < edge_pts[edge]; i++)
+            update_bounds (&geo_pts[i], bounds);
     }
 
-    /** left -- go to (nlines-1) + 1 to get to the bottom edge of the image **/
-    for (iy = 0; iy <= nlines; iy++)
+    /* Refine the segments between the points once the bounds from all the
+       edges are known, so fewer segments need refining */
+    for (edge = 0; edge < 4; edge++)
     {
-        ix = 0;
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
+        edge_len = (edge < 2) ? nsamps : nlines;
+        geo_pts = &edge_geo[edge * max_pts];
+        for (i = 0; i < edge_pts[edge] - 1; i++)
         {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (false);
+            if (!refine_bounds (space, edge, nlines, nsamps, i * step,
+                min ((i + 1) * step, edge_len), &geo_pts[i], &geo_pts[i+1],
+                bounds))
+            {
+                free (edge_img);
+                free (edge_geo);
+                sprintf (errmsg, "Refining edge %d of the image", edge);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (false);
+            }
         }
-
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
     }
 
-    /** right -- go to (nlines-1) + 1 to get to the bottom edge of the image **/
-    for (iy = 0; iy <= nlines; iy++)
-    {
-        ix = nsamps;  /* this is actually (nsamps-1) + 1 to get to the far
-                         right edge of the image */
-        img.l = (double) iy;
-        img.s = (double) ix;
-        img.is_fill = false;
-        if (!from_space (space, &img, &geo))
-        {
-            sprintf (errmsg, "Mapping top line of the image to lat/long");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (false);
-        }
-
-        bounds->max_lat = max (bounds->max_lat, geo.lat*DEG);
-        bounds->min_lat = min (bounds->min_lat, geo.lat*DEG);
-        bounds->max_lon = max (bounds->max_lon, geo.lon*DEG);
-        bounds->min_lon = min (bounds->min_lon, geo.lon*DEG);
-    }
+    /* Free the edge coordinates */
+    free (edge_img);
+    free (edge_geo);
 
     /* Successful completion */
     return (true);
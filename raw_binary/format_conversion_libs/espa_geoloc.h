@@ -104,6 +104,66 @@ typedef struct
                                the image to be rotated counter-clockwise. */
 } Space_def_t;
 
+/* Structure to store the precomputed Transverse Mercator constants for a
+   UTM zone, used to map UTM scenes without going through GCTP */
+typedef struct
+{
+    double r_major;        /* Semi-major axis (meters) */
+    double scale_factor;   /* Scale factor at the central meridian */
+    double lon_center;     /* Central meridian of the zone (radians) */
+    double false_easting;  /* False easting (meters) */
+    double false_northing; /* False northing (meters) */
+    double es;             /* Eccentricity squared */
+    double esp;            /* Second eccentricity squared */
+    double e0, e1, e2, e3; /* Meridian distance series constants */
+} Utm_proj_t;
+
+/* Structure to store the constants of a sinusoidal (MODIS) grid, used to map
+   SIN tiles without going through GCTP */
+typedef struct
+{
+    double radius;         /* Radius of the sphere (meters) */
+    double lon_center;     /* Central meridian (radians) */
+    double false_easting;  /* False easting (meters) */
+    double false_northing; /* False northing (meters) */
+} Sin_proj_t;
+
+/* Structure to store the precomputed Albers Conical Equal Area constants of
+   a grid (such as the CONUS, Alaska and Hawaii ARD grids), used to map
+   Albers scenes without going through GCTP */
+typedef struct
+{
+    double r_major;        /* Semi-major axis (meters) */
+    double es;             /* Eccentricity squared */
+    double e;              /* Eccentricity */
+    double c;              /* Constant C of the cone */
+    double ns0;            /* Cone constant n */
+    double rh;             /* Radius of the latitude of origin (meters) */
+    double lon_center;     /* Central meridian (radians) */
+    double false_easting;  /* False easting (meters) */
+    double false_northing; /* False northing (meters) */
+    double pole_con;       /* Value of q at the poles */
+    double auth[3];        /* Coefficients of the series for the latitude
+                              from the authalic latitude */
+} Albers_proj_t;
+
+/* Structure to store the precomputed polar stereographic constants of a
+   grid, used to map PS scenes without going through GCTP */
+typedef struct
+{
+    double r_major;        /* Semi-major axis (meters) */
+    double e;              /* Eccentricity */
+    double fac;            /* 1 for the north pole, -1 for the south pole */
+    double rh_scale;       /* Distance from the pole per unit of the
+                              conformal small t (meters) */
+    double lon_center;     /* Longitude straight down from the pole
+                              (radians) */
+    double false_easting;  /* False easting (meters) */
+    double false_northing; /* False northing (meters) */
+    double conf[4];        /* Coefficients of the series for the latitude
+                              from the conformal latitude */
+} Ps_proj_t;
+
 /* Structure to store the geolocation information */
 typedef struct
 {
@@ -114,6 +174,25 @@ typedef struct
                            /* Inverse transformation function call */
     double cos_orien;      /* Cosine of the orientation angle */
     double sin_orien;      /* Sine of the orientation angle */
+    bool use_utm;          /* Flag to indicate the UTM constants are set and
+                              are used instead of for_trans and inv_trans;
+                              'true' = use UTM; 'false' = use GCTP */
+    Utm_proj_t utm;        /* UTM zone constants */
+    bool use_sin;          /* Flag to indicate the sinusoidal constants are
+                              set and are used instead of for_trans and
+                              inv_trans; 'true' = use SIN; 'false' = use
+                              GCTP */
+    Sin_proj_t sin_proj;   /* Sinusoidal constants */
+    bool use_albers;       /* Flag to indicate the Albers constants are set
+                              and are used instead of for_trans and
+                              inv_trans; 'true' = use ALBERS; 'false' = use
+                              GCTP */
+    Albers_proj_t albers;  /* Albers constants */
+    bool use_ps;           /* Flag to indicate the polar stereographic
+                              constants are set and are used instead of
+                              for_trans and inv_trans; 'true' = use PS;
+                              'false' = use GCTP */
+    Ps_proj_t ps;          /* Polar stereographic constants */
 } Geoloc_t;
 
 /* Prototypes */
@@ -144,6 +223,24 @@ bool from_space
     Geo_coord_t *geo         /* O: geodetic coordinates (radians) */
 );
 
+bool to_space_batch
+(
+    Geoloc_t *this,          /* I: geolocation structure; for_trans function
+                                   is used for the forward mapping */
+    int npts,                /* I: number of points to be mapped */
+    Geo_coord_t *geo,        /* I: array of geodetic coordinates (radians) */
+    Img_coord_float_t *img   /* O: array of image coordinates */
+);
+
+bool from_space_batch
+(
+    Geoloc_t *this,          /* I: geolocation structure; inv_trans function
+                                   is used for the inverse mapping */
+    int npts,                /* I: number of points to be mapped */
+    Img_coord_float_t *img,  /* I: array of image coordinates */
+    Geo_coord_t *geo         /* O: array of geodetic coordinates (radians) */
+);
+
 bool compute_bounds
 (
     Geoloc_t *space,          /* I: geolocation structure which contains the
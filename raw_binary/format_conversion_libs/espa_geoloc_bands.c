@@ -0,0 +1,727 @@
+/*****************************************************************************
+FILE: espa_geoloc_bands.c
+
+PURPOSE: Contains functions for creating per-pixel latitude and longitude
+bands for the current scene.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format written via this library follows the ESPA internal
+     metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
+     the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The latitude and longitude are for the center of each pixel.
+*****************************************************************************/
+#include "espa_geoloc_bands.h"
+
+/******************************************************************************
+MODULE:  get_geoloc_band
+
+PURPOSE: Determines the representative band for the geolocation bands.  This
+is the same band get_geoloc_info uses for the image size and pixel size.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0-nbands        Index of the representative band in the XML metadata
+
+NOTES:
+******************************************************************************/
+static int get_geoloc_band
+(
+    Espa_internal_meta_t *xml_meta   /* I: input XML metadata */
+)
+{
+    int i;                  /* looping variable */
+    int refl_indx = 0;      /* index of band1 or first band */
+
+    /* Use band1 for Landsat (Level 1 products), otherwise the first band */
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        if (!strcmp (xml_meta->band[i].name, "band1") &&
+            !strncmp (xml_meta->band[i].product, "L1", 2))
+            refl_indx = i;
+    }
+
+    return (refl_indx);
+}
+
+
+/******************************************************************************
+MODULE:  get_geoloc_cache_key
+
+PURPOSE: Builds the derived band cache key of the geolocation bands from
+everything they depend on: the projection and grid of the scene, and the
+compression of the bands.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void get_geoloc_cache_key
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    Derived_cache_key_t *key         /* O: cache key of the bands */
+)
+{
+    Espa_proj_meta_t *proj = &xml_meta->global.proj_info;
+                                /* projection of the scene */
+    Espa_band_meta_t *bmeta = &xml_meta->band[get_geoloc_band (xml_meta)];
+                                /* representative band */
+    Raw_binary_codec_t codec = get_raw_binary_codec ();
+                                /* compression of the output bands */
+
+    init_derived_cache_key (key, "geolocation_bands");
+    add_derived_cache_bytes (key, &proj->proj_type, sizeof (proj->proj_type));
+    add_derived_cache_bytes (key, &proj->datum_type,
+        sizeof (proj->datum_type));
+    add_derived_cache_bytes (key, &proj->utm_zone, sizeof (proj->utm_zone));
+    add_derived_cache_bytes (key, proj->ul_corner, sizeof (proj->ul_corner));
+    add_derived_cache_string (key, proj->grid_origin);
+    add_derived_cache_bytes (key, &proj->longitude_pole,
+        sizeof (proj->longitude_pole));
+    add_derived_cache_bytes (key, &proj->latitude_true_scale,
+        sizeof (proj->latitude_true_scale));
+    add_derived_cache_bytes (key, &proj->false_easting,
+        sizeof (proj->false_easting));
+    add_derived_cache_bytes (key, &proj->false_northing,
+        sizeof (proj->false_northing));
+    add_derived_cache_bytes (key, &proj->standard_parallel1,
+        sizeof (proj->standard_parallel1));
+    add_derived_cache_bytes (key, &proj->standard_parallel2,
+        sizeof (proj->standard_parallel2));
+    add_derived_cache_bytes (key, &proj->central_meridian,
+        sizeof (proj->central_meridian));
+    add_derived_cache_bytes (key, &proj->origin_latitude,
+        sizeof (proj->origin_latitude));
+    add_derived_cache_bytes (key, &proj->sphere_radius,
+        sizeof (proj->sphere_radius));
+    add_derived_cache_bytes (key, &bmeta->nlines, sizeof (bmeta->nlines));
+    add_derived_cache_bytes (key, &bmeta->nsamps, sizeof (bmeta->nsamps));
+    add_derived_cache_bytes (key, bmeta->pixel_size,
+        sizeof (bmeta->pixel_size));
+    add_derived_cache_bytes (key, &codec, sizeof (codec));
+}
+
+
+/******************************************************************************
+MODULE:  get_grid_pos
+
+PURPOSE: Returns the line or sample of the specified grid point.  Grid points
+are every GEOLOC_GRID_STEP pixels, with the last grid point on the last pixel
+of the image.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0-(npix-1)      Line or sample of the grid point
+
+NOTES:
+******************************************************************************/
+static int get_grid_pos
+(
+    int indx,     /* I: grid point index */
+    int npix      /* I: number of lines or samples in the image */
+)
+{
+    int pos = indx * GEOLOC_GRID_STEP;   /* line or sample of the grid point */
+
+    if (pos > npix - 1)
+        pos = npix - 1;
+    return (pos);
+}
+
+
+/******************************************************************************
+MODULE:  map_grid_row
+
+PURPOSE: Maps the grid points along one line of the image to latitude and
+longitude in a single batch.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the grid points
+SUCCESS         Successfully mapped the grid points
+
+NOTES:
+  1. The line and sample may be fractional, so this is also used for the
+     centers of the grid cells.
+  2. The latitude and longitude are returned in degrees.
+******************************************************************************/
+static int map_grid_row
+(
+    Geoloc_t *space,          /* I: geolocation mapping structure */
+    double line,              /* I: line of the grid row */
+    int npts,                 /* I: number of points in the grid row */
+    const double *samps,      /* I: sample of each point in the grid row */
+    Img_coord_float_t *img,   /* I/O: work array of image coordinates */
+    Geo_coord_t *geo,         /* I/O: work array of geodetic coordinates */
+    double *lat,              /* O: latitude of each point (degrees) */
+    double *lon               /* O: longitude of each point (degrees) */
+)
+{
+    char FUNC_NAME[] = "map_grid_row";   /* function name */
+    char errmsg[STR_SIZE];               /* error message */
+    int i;                               /* looping variable */
+
+    /* Map the centers of the pixels */
+    for (i = 0; i < npts; i++)
+    {
+        img[i].l = line + 0.5;
+        img[i].s = samps[i] + 0.5;
+        img[i].is_fill = false;
+    }
+
+    if (!from_space_batch (space, npts, img, geo))
+    {
+        sprintf (errmsg, "Mapping the grid points along line %g to lat/long",
+            line);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < npts; i++)
+    {
+        lat[i] = geo[i].lat * DEG;
+        lon[i] = geo[i].lon * DEG;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_geoloc_bands
+
+PURPOSE: Creates the latitude and longitude bands for the current scene and
+writes them directly to the output files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating or writing the geolocation bands
+SUCCESS         Successfully created the geolocation bands
+
+NOTES:
+  1. The bands are 32-bit float latitude and longitude in degrees for the
+     center of each pixel.
+  2. The pixels on a grid every GEOLOC_GRID_STEP lines and samples are mapped
+     exactly.  For each grid cell the center of the cell is also mapped and
+     compared to the bilinear estimate from the four corners; where they
+     agree within GEOLOC_INTERP_TOL the pixels in the cell are interpolated,
+     otherwise (high curvature or a longitude wrap at the antimeridian) they
+     are mapped exactly.
+  3. The exactly mapped pixels of each line are gathered and mapped in a
+     single from_space_batch call.
+  4. The bands are written GEOLOC_LINE_BLOCK lines at a time, so only the
+     block buffers and the grid rows for the block are held in memory.
+******************************************************************************/
+int write_geoloc_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    char *lat_file,                  /* I: output latitude filename */
+    char *lon_file                   /* I: output longitude filename */
+)
+{
+    char FUNC_NAME[] = "write_geoloc_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int line;                   /* current line in the band */
+    int samp;                   /* current sample in the band */
+    int nblock_lines;           /* number of lines in the current block */
+    int nlines;                 /* number of lines in the bands */
+    int nsamps;                 /* number of samples in the bands */
+    int nrows;                  /* number of grid rows */
+    int ncols;                  /* number of grid columns */
+    int ncells;                 /* number of grid cells across a line */
+    int row;                    /* current grid cell row */
+    int first_row;              /* first grid cell row of the block */
+    int last_row;               /* last grid cell row of the block */
+    int nblock_rows;            /* number of grid cell rows in the block */
+    int col;                    /* current grid cell column */
+    int last_samp;              /* last sample of the current grid cell */
+    int nexact;                 /* number of exactly mapped pixels in line */
+    int i;                      /* looping variable */
+    int *exact_samp = NULL;     /* sample of each exactly mapped pixel */
+    bool interp_ok;             /* can the whole image be interpolated? */
+    unsigned char *interp = NULL;  /* flag for each grid cell in the block
+                                      indicating it can be interpolated */
+    double *grid_samp = NULL;   /* sample of each grid column */
+    double *mid_samp = NULL;    /* sample of the center of each grid cell */
+    double *grid_lat = NULL;    /* latitude of the grid rows in the block */
+    double *grid_lon = NULL;    /* longitude of the grid rows in the block */
+    double *mid_lat = NULL;     /* latitude of the grid cell centers */
+    double *mid_lon = NULL;     /* longitude of the grid cell centers */
+    double top, bottom;         /* lines of the grid cell top and bottom */
+    double lt, ls;              /* fractional line, sample in the cell */
+    double *top_lat, *bottom_lat;  /* latitude along the top and bottom of
+                                      the current grid cell */
+    double *top_lon, *bottom_lon;  /* longitude along the top and bottom of
+                                      the current grid cell */
+    double left, right;         /* values along the cell edges at the line */
+    double delta;               /* difference from the bilinear estimate */
+    float *lat_buf = NULL;      /* block of latitude values */
+    float *lon_buf = NULL;      /* block of longitude values */
+    Img_coord_float_t *img = NULL;  /* image coordinates to be mapped */
+    Geo_coord_t *geo = NULL;    /* mapped geodetic coordinates */
+    Space_def_t space_def;      /* geolocation space definition */
+    Geoloc_t *space = NULL;     /* geolocation mapping structure */
+    Raw_binary_writer_t rbw_lat;  /* output latitude band writer */
+    Raw_binary_writer_t rbw_lon;  /* output longitude band writer */
+    Raw_binary_cache_t cache = get_raw_binary_cache_mode ();
+                                /* page cache handling for the output */
+    Raw_binary_codec_t codec = get_raw_binary_codec ();
+                                /* compression of the output bands */
+
+    /* Set up the mapping from line/sample to lat/long */
+    if (!get_geoloc_info (xml_meta, &space_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    space = setup_mapping (&space_def);
+    if (space == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    nlines = space_def.img_size.l;
+    nsamps = space_def.img_size.s;
+
+    /* Determine the grid.  With a single line or sample there are no grid
+       cells and every pixel is mapped exactly. */
+    nrows = (nlines - 1 + GEOLOC_GRID_STEP - 1) / GEOLOC_GRID_STEP + 1;
+    ncols = (nsamps - 1 + GEOLOC_GRID_STEP - 1) / GEOLOC_GRID_STEP + 1;
+    interp_ok = (nrows > 1 && ncols > 1);
+    ncells = interp_ok ? ncols - 1 : 1;
+
+    /* Allocate the block buffers and the grid for a block of lines */
+    lat_buf = calloc ((size_t) GEOLOC_LINE_BLOCK * nsamps, sizeof (float));
+    lon_buf = calloc ((size_t) GEOLOC_LINE_BLOCK * nsamps, sizeof (float));
+    img = calloc (nsamps, sizeof (Img_coord_float_t));
+    geo = calloc (nsamps, sizeof (Geo_coord_t));
+    exact_samp = calloc (nsamps, sizeof (int));
+    grid_samp = calloc (ncols, sizeof (double));
+    mid_samp = calloc (ncells, sizeof (double));
+    grid_lat = calloc ((size_t) (GEOLOC_LINE_BLOCK / GEOLOC_GRID_STEP + 2) *
+        ncols, sizeof (double));
+    grid_lon = calloc ((size_t) (GEOLOC_LINE_BLOCK / GEOLOC_GRID_STEP + 2) *
+        ncols, sizeof (double));
+    mid_lat = calloc (ncells, sizeof (double));
+    mid_lon = calloc (ncells, sizeof (double));
+    interp = calloc ((size_t) (GEOLOC_LINE_BLOCK / GEOLOC_GRID_STEP + 1) *
+        ncells, sizeof (unsigned char));
+    if (lat_buf == NULL || lon_buf == NULL || img == NULL || geo == NULL ||
+        exact_samp == NULL || grid_samp == NULL || mid_samp == NULL ||
+        grid_lat == NULL || grid_lon == NULL || mid_lat == NULL ||
+        mid_lon == NULL || interp == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the geolocation bands "
+            "containing %d lines x %d samples.", GEOLOC_LINE_BLOCK, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (col = 0; col < ncols; col++)
+        grid_samp[col] = get_grid_pos (col, nsamps);
+    if (interp_ok)
+    {
+        for (col = 0; col < ncells; col++)
+            mid_samp[col] = 0.5 * (grid_samp[col] + grid_samp[col+1]);
+    }
+
+    /* Open the output files */
+    if (open_raw_binary_writer (lat_file, cache, codec, &rbw_lat) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the latitude file: %s", lat_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (open_raw_binary_writer (lon_file, cache, codec, &rbw_lon) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the longitude file: %s", lon_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Loop through the lines a block at a time */
+    for (line = 0; line < nlines; line += GEOLOC_LINE_BLOCK)
+    {
+        nblock_lines = GEOLOC_LINE_BLOCK;
+        if (line + nblock_lines > nlines)
+            nblock_lines = nlines - line;
+
+        /* Map the grid rows covering the block and flag the grid cells that
+           can be interpolated */
+        first_row = line / GEOLOC_GRID_STEP;
+        last_row = (line + nblock_lines - 1) / GEOLOC_GRID_STEP;
+        if (interp_ok && last_row > nrows - 2)
+            last_row = nrows - 2;
+        nblock_rows = last_row - first_row + 1;
+        if (interp_ok)
+        {
+            for (row = 0; row <= nblock_rows; row++)
+            {
+                if (map_grid_row (space,
+                    get_grid_pos (first_row + row, nlines), ncols, grid_samp,
+                    img, geo, &grid_lat[row * ncols],
+                    &grid_lon[row * ncols]) != SUCCESS)
+                {
+                    sprintf (errmsg, "Mapping the geolocation grid");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+            }
+
+            for (row = 0; row < nblock_rows; row++)
+            {
+                top = get_grid_pos (first_row + row, nlines);
+                bottom = get_grid_pos (first_row + row + 1, nlines);
+                if (map_grid_row (space, 0.5 * (top + bottom), ncells,
+                    mid_samp, img, geo, mid_lat, mid_lon) != SUCCESS)
+                {
+                    sprintf (errmsg, "Mapping the geolocation grid centers");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+
+                for (col = 0; col < ncells; col++)
+                {
+                    top_lat = &grid_lat[row * ncols + col];
+                    bottom_lat = &grid_lat[(row + 1) * ncols + col];
+                    top_lon = &grid_lon[row * ncols + col];
+                    bottom_lon = &grid_lon[(row + 1) * ncols + col];
+                    delta = fabs (mid_lat[col] - 0.25 * (top_lat[0] +
+                        top_lat[1] + bottom_lat[0] + bottom_lat[1]));
+                    delta = max (delta, fabs (mid_lon[col] - 0.25 *
+                        (top_lon[0] + top_lon[1] + bottom_lon[0] +
+                        bottom_lon[1])));
+                    interp[row * ncells + col] = (delta < GEOLOC_INTERP_TOL);
+                }
+            }
+        }
+
+        /* Fill each line of the block, interpolating within the flagged
+           grid cells and gathering the rest for a single batch mapping */
+        for (i = 0; i < nblock_lines; i++)
+        {
+            float *lat_line = &lat_buf[(size_t) i * nsamps];
+            float *lon_line = &lon_buf[(size_t) i * nsamps];
+
+            nexact = 0;
+            if (!interp_ok)
+            {
+                for (samp = 0; samp < nsamps; samp++)
+                    exact_samp[nexact++] = samp;
+            }
+            else
+            {
+                row = (line + i) / GEOLOC_GRID_STEP;
+                if (row > nrows - 2)
+                    row = nrows - 2;
+                top = get_grid_pos (row, nlines);
+                bottom = get_grid_pos (row + 1, nlines);
+                lt = (line + i - top) / (bottom - top);
+                row -= first_row;
+
+                for (col = 0; col < ncells; col++)
+                {
+                    /* The last cell also covers the last sample */
+                    last_samp = grid_samp[col+1] - 1;
+                    if (col == ncells - 1)
+                        last_samp = nsamps - 1;
+
+                    if (!interp[row * ncells + col])
+                    {
+                        for (samp = grid_samp[col]; samp <= last_samp; samp++)
+                            exact_samp[nexact++] = samp;
+                        continue;
+                    }
+
+                    top_lat = &grid_lat[row * ncols + col];
+                    bottom_lat = &grid_lat[(row + 1) * ncols + col];
+                    top_lon = &grid_lon[row * ncols + col];
+                    bottom_lon = &grid_lon[(row + 1) * ncols + col];
+                    for (samp = grid_samp[col]; samp <= last_samp; samp++)
+                    {
+                        ls = (samp - grid_samp[col]) /
+                            (grid_samp[col+1] - grid_samp[col]);
+                        left = top_lat[0] + lt * (bottom_lat[0] - top_lat[0]);
+                        right = top_lat[1] + lt * (bottom_lat[1] - top_lat[1]);
+                        lat_line[samp] = left + ls * (right - left);
+                        left = top_lon[0] + lt * (bottom_lon[0] - top_lon[0]);
+                        right = top_lon[1] + lt * (bottom_lon[1] - top_lon[1]);
+                        lon_line[samp] = left + ls * (right - left);
+                    }
+                }
+            }
+
+            /* Map the remaining pixels of the line in one batch */
+            if (nexact > 0)
+            {
+                for (samp = 0; samp < nexact; samp++)
+                {
+                    img[samp].l = line + i + 0.5;
+                    img[samp].s = exact_samp[samp] + 0.5;
+                    img[samp].is_fill = false;
+                }
+
+                if (!from_space_batch (space, nexact, img, geo))
+                {
+                    sprintf (errmsg, "Mapping line %d to lat/long", line + i);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+
+                for (samp = 0; samp < nexact; samp++)
+                {
+                    lat_line[exact_samp[samp]] = geo[samp].lat * DEG;
+                    lon_line[exact_samp[samp]] = geo[samp].lon * DEG;
+                }
+            }
+        }
+
+        /* Write the current block of each band */
+        if (write_raw_binary_writer (&rbw_lat, nblock_lines, nsamps,
+            sizeof (float), lat_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the latitude file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (write_raw_binary_writer (&rbw_lon, nblock_lines, nsamps,
+            sizeof (float), lon_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the longitude file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Close the files and free the buffers */
+    if (close_raw_binary_writer (&rbw_lat) != SUCCESS ||
+        close_raw_binary_writer (&rbw_lon) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the geolocation band files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    free (lat_buf);
+    free (lon_buf);
+    free (img);
+    free (geo);
+    free (exact_samp);
+    free (grid_samp);
+    free (mid_samp);
+    free (grid_lat);
+    free (grid_lon);
+    free (mid_lat);
+    free (mid_lon);
+    free (interp);
+    free (space);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_geoloc_bands
+
+PURPOSE: Creates the latitude and longitude bands for the current scene and
+sets up the band metadata for them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the geolocation bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output filenames are the product ID with _lat.img and _lon.img
+     appended for the latitude and longitude bands respectively.
+  2. The band data and ENVI headers are written by this routine.  The bands
+     are returned in out_meta but are not added to the XML metadata; it is up
+     to the caller to append them to the XML file or the metadata structure.
+     The caller is responsible for calling free_metadata on out_meta.
+  3. If the ESPA_DERIVED_CACHE environment variable names a cache (see
+     derived_cache.h), the bands of an earlier scene on the same projection
+     and grid are restored from it rather than generated, and generated
+     bands are added to it.
+******************************************************************************/
+int create_geoloc_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the latitude and
+                                           longitude bands; global metadata
+                                           is not valid */
+)
+{
+    char FUNC_NAME[] = "create_geoloc_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char tmp_ext[STR_SIZE];      /* temporary filename extension */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    int i;                       /* looping variable */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* pointer to global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for bands */
+    Derived_cache_key_t key;     /* derived band cache key of the bands */
+
+    /* Use the same representative band as the geolocation information */
+    bmeta = &xml_meta->band[get_geoloc_band (xml_meta)];
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    /* Allocate memory for two output bands */
+    if (allocate_band_metadata (out_meta, 2) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the geolocation bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the band metadata for the latitude and longitude bands */
+    for (i = 0; i < 2; i++)
+    {
+        out_bmeta = &out_meta->band[i];
+        strcpy (out_bmeta->product, "intermediate_data");
+        strcpy (out_bmeta->source, "level1");
+        strcpy (out_bmeta->category, "image");
+        out_bmeta->data_type = ESPA_FLOAT32;
+        strncpy (tmpstr, bmeta->short_name, 3);
+        tmpstr[3] = '\0';
+
+        /* Band-specific names */
+        switch (i)
+        {
+            case (0):  /* latitude */
+                strcpy (out_bmeta->name, "latitude");
+                sprintf (out_bmeta->short_name, "%sLAT", tmpstr);
+                strcpy (out_bmeta->long_name, "pixel center latitude");
+                sprintf (tmp_ext, "lat.img");
+                out_bmeta->valid_range[0] = -90.0;
+                out_bmeta->valid_range[1] = 90.0;
+                break;
+
+            case (1):  /* longitude */
+                strcpy (out_bmeta->name, "longitude");
+                sprintf (out_bmeta->short_name, "%sLON", tmpstr);
+                strcpy (out_bmeta->long_name, "pixel center longitude");
+                sprintf (tmp_ext, "lon.img");
+                out_bmeta->valid_range[0] = -180.0;
+                out_bmeta->valid_range[1] = 180.0;
+                break;
+        }
+
+        /* Use the product name to create the geolocation filename */
+        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name), "%s_%s",
+            gmeta->product_id, tmp_ext);
+
+        strcpy (out_bmeta->data_units, "degrees");
+        out_bmeta->resample_method = ESPA_BI;
+        out_bmeta->nlines = bmeta->nlines;
+        out_bmeta->nsamps = bmeta->nsamps;
+        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+        sprintf (out_bmeta->app_version, "create_geolocation_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (out_bmeta->production_date, production_date);
+    }
+
+    /* Use the geolocation bands of an earlier scene on the same grid if
+       they're cached, or else generate them for this scene and write them to
+       the output files */
+    get_geoloc_cache_key (xml_meta, &key);
+    if (read_derived_cache (&key, 2, out_meta->band))
+        printf ("Using the cached geolocation bands\n");
+    else
+    {
+        if (write_geoloc_bands (xml_meta, out_meta->band[0].file_name,
+            out_meta->band[1].file_name) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        /* Cache the bands for later scenes.  The bands are still good if
+           they can't be cached. */
+        if (write_derived_cache (&key, 2, out_meta->band) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to cache the geolocation bands");
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+
+    /* Write the ENVI header for each of the geolocation bands */
+    for (i = 0; i < 2; i++)
+    {
+        /* Create the ENVI header using the geolocation band */
+        out_bmeta = &out_meta->band[i];
+        if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header */
+        sprintf (tmpstr, "%s", out_bmeta->file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
@@ -0,0 +1,61 @@
+/*****************************************************************************
+FILE: espa_geoloc_bands.h
+
+PURPOSE: Contains defines and prototypes to generate per-pixel latitude and
+longitude bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef ESPA_GEOLOC_BANDS_H
+#define ESPA_GEOLOC_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_geoloc.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
+#include "derived_cache.h"
+
+/* Defines */
+/* Number of lines written to each geolocation band at a time; this should
+   be a multiple of GEOLOC_GRID_STEP */
+#define GEOLOC_LINE_BLOCK 256
+
+/* Spacing, in lines and samples, of the grid of exactly mapped pixels */
+#define GEOLOC_GRID_STEP 16
+
+/* Maximum difference, in degrees, between the exactly mapped center of a
+   grid cell and the bilinear estimate from its corners for the cell to be
+   interpolated.  This is below the resolution of the float output. */
+#define GEOLOC_INTERP_TOL 1.0e-6
+
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
+
+/* Prototypes */
+int write_geoloc_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    char *lat_file,                  /* I: output latitude filename */
+    char *lon_file                   /* I: output longitude filename */
+);
+
+int create_geoloc_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the latitude and
+                                           longitude bands; global metadata
+                                           is not valid */
+);
+
+#endif
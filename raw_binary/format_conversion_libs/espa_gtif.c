@@ -0,0 +1,1240 @@
+/*****************************************************************************
+FILE: espa_gtif.c
+
+PURPOSE: Contains functions for writing raw binary bands to tiled GeoTIFF
+files, and their georeferencing information, using libtiff and libgeotiff.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The GeoKeys are generated directly from the projection information in
+     the global metadata, so the ENVI header for the band is not needed.
+*****************************************************************************/
+
+#include <unistd.h>
+#include "espa_gtif.h"
+#include "espa_io_limit.h"
+
+/* GeoTIFF EPSG codes for the UTM zones (zone number is added) and the
+   GeoTIFF projection codes for the UTM zones of an unknown datum */
+#define GTIF_PCS_WGS84_UTM_NORTH 32600
+#define GTIF_PCS_WGS84_UTM_SOUTH 32700
+#define GTIF_PCS_NAD83_UTM_NORTH 26900
+#define GTIF_PCS_NAD27_UTM_NORTH 26700
+#define GTIF_PROJ_UTM_NORTH 16000
+#define GTIF_PROJ_UTM_SOUTH 16100
+
+/* Field information for the GDAL metadata and nodata tags, which aren't
+   known by libtiff */
+static const TIFFFieldInfo gdal_field_info[] =
+{
+    {TIFFTAG_GDAL_METADATA, -1, -1, TIFF_ASCII, FIELD_CUSTOM, true, false,
+     "GDALMetadata"},
+    {TIFFTAG_GDAL_NODATA, -1, -1, TIFF_ASCII, FIELD_CUSTOM, true, false,
+     "GDALNoDataValue"}
+};
+
+
+/******************************************************************************
+MODULE:  get_gtif_sample_info
+
+PURPOSE: Determines the TIFF bits per sample, sample format, and number of
+bytes per pixel for the ESPA data type.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unsupported data type
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+static int get_gtif_sample_info
+(
+    enum Espa_data_type data_type, /* I: ESPA data type of the band */
+    uint16 *bits_per_sample,   /* O: TIFF bits per sample */
+    uint16 *sample_format,     /* O: TIFF sample format */
+    int *nbytes                /* O: number of bytes per pixel */
+)
+{
+    char FUNC_NAME[] = "get_gtif_sample_info";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            *nbytes = sizeof (int8);
+            *sample_format = SAMPLEFORMAT_INT;
+            break;
+        case ESPA_UINT8:
+            *nbytes = sizeof (uint8);
+            *sample_format = SAMPLEFORMAT_UINT;
+            break;
+        case ESPA_INT16:
+            *nbytes = sizeof (int16);
+            *sample_format = SAMPLEFORMAT_INT;
+            break;
+        case ESPA_UINT16:
+            *nbytes = sizeof (uint16);
+            *sample_format = SAMPLEFORMAT_UINT;
+            break;
+        case ESPA_INT32:
+            *nbytes = sizeof (int32);
+            *sample_format = SAMPLEFORMAT_INT;
+            break;
+        case ESPA_UINT32:
+            *nbytes = sizeof (uint32);
+            *sample_format = SAMPLEFORMAT_UINT;
+            break;
+        case ESPA_FLOAT32:
+            *nbytes = sizeof (float);
+            *sample_format = SAMPLEFORMAT_IEEEFP;
+            break;
+        case ESPA_FLOAT64:
+            *nbytes = sizeof (double);
+            *sample_format = SAMPLEFORMAT_IEEEFP;
+            break;
+        default:
+            sprintf (errmsg, "Unsupported ESPA data type %d", data_type);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    *bits_per_sample = *nbytes * 8;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_gtif_geographic_keys
+
+PURPOSE: Sets the GeoKeys describing the geographic coordinate system
+(datum and ellipsoid) of the product.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Products without a datum are written with a user-defined ellipsoid.  For
+     the sinusoidal projection this is the sphere used by the projection,
+     otherwise the WGS84 ellipsoid is used.
+******************************************************************************/
+static void set_gtif_geographic_keys
+(
+    GTIF *gtif,                /* I: GeoTIFF key handle */
+    Espa_proj_meta_t *proj     /* I: projection information */
+)
+{
+    double semi_major;         /* semi-major axis of the ellipsoid */
+    double semi_minor;         /* semi-minor axis of the ellipsoid */
+
+    GTIFKeySet (gtif, GeogAngularUnitsGeoKey, TYPE_SHORT, 1, Angular_Degree);
+    switch (proj->datum_type)
+    {
+        case ESPA_WGS84:
+            GTIFKeySet (gtif, GeographicTypeGeoKey, TYPE_SHORT, 1, GCS_WGS_84);
+            break;
+
+        case ESPA_NAD83:
+            GTIFKeySet (gtif, GeographicTypeGeoKey, TYPE_SHORT, 1, GCS_NAD83);
+            break;
+
+        case ESPA_NAD27:
+            GTIFKeySet (gtif, GeographicTypeGeoKey, TYPE_SHORT, 1, GCS_NAD27);
+            break;
+
+        default:
+            if (proj->proj_type == GCTP_SIN_PROJ)
+            {
+                semi_major = proj->sphere_radius;
+                semi_minor = proj->sphere_radius;
+            }
+            else
+            {
+                semi_major = GCTP_WGS84_SEMI_MAJOR;
+                semi_minor = GCTP_WGS84_SEMI_MINOR;
+            }
+            GTIFKeySet (gtif, GeographicTypeGeoKey, TYPE_SHORT, 1,
+                KvUserDefined);
+            GTIFKeySet (gtif, GeogGeodeticDatumGeoKey, TYPE_SHORT, 1,
+                KvUserDefined);
+            GTIFKeySet (gtif, GeogEllipsoidGeoKey, TYPE_SHORT, 1,
+                KvUserDefined);
+            GTIFKeySet (gtif, GeogSemiMajorAxisGeoKey, TYPE_DOUBLE, 1,
+                semi_major);
+            GTIFKeySet (gtif, GeogSemiMinorAxisGeoKey, TYPE_DOUBLE, 1,
+                semi_minor);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  set_gtif_georeference
+
+PURPOSE: Writes the tie point, pixel scale, and GeoKeys for the band to the
+open TIFF file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting the georeferencing information
+SUCCESS         Successful completion
+
+NOTES:
+  1. The tie point refers to the outer corner of the UL pixel
+     (RasterPixelIsArea).  If the grid origin is the center of the pixel,
+     then the UL corner is adjusted by half a pixel for this band's
+     resolution.
+******************************************************************************/
+int set_gtif_georeference
+(
+    TIFF *tif,                 /* I: open TIFF file to be georeferenced */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+)
+{
+    char FUNC_NAME[] = "set_gtif_georeference";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int pcs_code;             /* projected coordinate system code */
+    double tie_points[6];     /* raster to model tie point */
+    double pixel_scale[3];    /* pixel size in x, y, z */
+    Espa_proj_meta_t *proj = &gmeta->proj_info;  /* projection information */
+    GTIF *gtif = NULL;        /* GeoTIFF key handle */
+
+    /* Set the tie point for the UL corner and the pixel size */
+    tie_points[0] = tie_points[1] = tie_points[2] = tie_points[5] = 0.0;
+    if (!strcmp (proj->grid_origin, "CENTER"))
+    {
+        tie_points[3] = proj->ul_corner[0] - 0.5 * bmeta->pixel_size[0];
+        tie_points[4] = proj->ul_corner[1] + 0.5 * bmeta->pixel_size[1];
+    }
+    else
+    {
+        tie_points[3] = proj->ul_corner[0];
+        tie_points[4] = proj->ul_corner[1];
+    }
+    pixel_scale[0] = bmeta->pixel_size[0];
+    pixel_scale[1] = bmeta->pixel_size[1];
+    pixel_scale[2] = 0.0;
+
+    if (!TIFFSetField (tif, TIFFTAG_GEOTIEPOINTS, 6, tie_points) ||
+        !TIFFSetField (tif, TIFFTAG_GEOPIXELSCALE, 3, pixel_scale))
+    {
+        sprintf (errmsg, "Setting the GeoTIFF tie point and pixel scale");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the GeoKeys */
+    gtif = GTIFNew (tif);
+    if (gtif == NULL)
+    {
+        sprintf (errmsg, "Allocating the GeoTIFF key handle");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    GTIFKeySet (gtif, GTRasterTypeGeoKey, TYPE_SHORT, 1, RasterPixelIsArea);
+    if (proj->proj_type == GCTP_GEO_PROJ)
+    {
+        GTIFKeySet (gtif, GTModelTypeGeoKey, TYPE_SHORT, 1,
+            ModelTypeGeographic);
+        set_gtif_geographic_keys (gtif, proj);
+    }
+    else
+    {
+        GTIFKeySet (gtif, GTModelTypeGeoKey, TYPE_SHORT, 1,
+            ModelTypeProjected);
+        GTIFKeySet (gtif, ProjLinearUnitsGeoKey, TYPE_SHORT, 1, Linear_Meter);
+    }
+
+    switch (proj->proj_type)
+    {
+        case GCTP_GEO_PROJ:
+            break;
+
+        case GCTP_UTM_PROJ:
+            /* Use the EPSG code for the zone if there is one for the datum,
+               otherwise use the UTM projection code for the zone */
+            pcs_code = KvUserDefined;
+            if (proj->datum_type == ESPA_WGS84 && proj->utm_zone > 0)
+                pcs_code = GTIF_PCS_WGS84_UTM_NORTH + proj->utm_zone;
+            else if (proj->datum_type == ESPA_WGS84)
+                pcs_code = GTIF_PCS_WGS84_UTM_SOUTH - proj->utm_zone;
+            else if (proj->datum_type == ESPA_NAD83 && proj->utm_zone > 0)
+                pcs_code = GTIF_PCS_NAD83_UTM_NORTH + proj->utm_zone;
+            else if (proj->datum_type == ESPA_NAD27 && proj->utm_zone > 0)
+                pcs_code = GTIF_PCS_NAD27_UTM_NORTH + proj->utm_zone;
+
+            GTIFKeySet (gtif, ProjectedCSTypeGeoKey, TYPE_SHORT, 1, pcs_code);
+            if (pcs_code == KvUserDefined)
+            {
+                set_gtif_geographic_keys (gtif, proj);
+                if (proj->utm_zone > 0)
+                    GTIFKeySet (gtif, ProjectionGeoKey, TYPE_SHORT, 1,
+                        GTIF_PROJ_UTM_NORTH + proj->utm_zone);
+                else
+                    GTIFKeySet (gtif, ProjectionGeoKey, TYPE_SHORT, 1,
+                        GTIF_PROJ_UTM_SOUTH - proj->utm_zone);
+            }
+            break;
+
+        case GCTP_ALBERS_PROJ:
+            GTIFKeySet (gtif, ProjectedCSTypeGeoKey, TYPE_SHORT, 1,
+                KvUserDefined);
+            GTIFKeySet (gtif, ProjectionGeoKey, TYPE_SHORT, 1, KvUserDefined);
+            GTIFKeySet (gtif, ProjCoordTransGeoKey, TYPE_SHORT, 1,
+                CT_AlbersEqualArea);
+            GTIFKeySet (gtif, ProjStdParallel1GeoKey, TYPE_DOUBLE, 1,
+                proj->standard_parallel1);
+            GTIFKeySet (gtif, ProjStdParallel2GeoKey, TYPE_DOUBLE, 1,
+                proj->standard_parallel2);
+            GTIFKeySet (gtif, ProjNatOriginLongGeoKey, TYPE_DOUBLE, 1,
+                proj->central_meridian);
+            GTIFKeySet (gtif, ProjNatOriginLatGeoKey, TYPE_DOUBLE, 1,
+                proj->origin_latitude);
+            GTIFKeySet (gtif, ProjFalseEastingGeoKey, TYPE_DOUBLE, 1,
+                proj->false_easting);
+            GTIFKeySet (gtif, ProjFalseNorthingGeoKey, TYPE_DOUBLE, 1,
+                proj->false_northing);
+            set_gtif_geographic_keys (gtif, proj);
+            break;
+
+        case GCTP_PS_PROJ:
+            GTIFKeySet (gtif, ProjectedCSTypeGeoKey, TYPE_SHORT, 1,
+                KvUserDefined);
+            GTIFKeySet (gtif, ProjectionGeoKey, TYPE_SHORT, 1, KvUserDefined);
+            GTIFKeySet (gtif, ProjCoordTransGeoKey, TYPE_SHORT, 1,
+                CT_PolarStereographic);
+            GTIFKeySet (gtif, ProjStraightVertPoleLongGeoKey, TYPE_DOUBLE, 1,
+                proj->longitude_pole);
+            GTIFKeySet (gtif, ProjNatOriginLatGeoKey, TYPE_DOUBLE, 1,
+                proj->latitude_true_scale);
+            GTIFKeySet (gtif, ProjScaleAtNatOriginGeoKey, TYPE_DOUBLE, 1, 1.0);
+            GTIFKeySet (gtif, ProjFalseEastingGeoKey, TYPE_DOUBLE, 1,
+                proj->false_easting);
+            GTIFKeySet (gtif, ProjFalseNorthingGeoKey, TYPE_DOUBLE, 1,
+                proj->false_northing);
+            set_gtif_geographic_keys (gtif, proj);
+            break;
+
+        case GCTP_SIN_PROJ:
+            GTIFKeySet (gtif, ProjectedCSTypeGeoKey, TYPE_SHORT, 1,
+                KvUserDefined);
+            GTIFKeySet (gtif, ProjectionGeoKey, TYPE_SHORT, 1, KvUserDefined);
+            GTIFKeySet (gtif, ProjCoordTransGeoKey, TYPE_SHORT, 1,
+                CT_Sinusoidal);
+            GTIFKeySet (gtif, ProjCenterLongGeoKey, TYPE_DOUBLE, 1,
+                proj->central_meridian);
+            GTIFKeySet (gtif, ProjFalseEastingGeoKey, TYPE_DOUBLE, 1,
+                proj->false_easting);
+            GTIFKeySet (gtif, ProjFalseNorthingGeoKey, TYPE_DOUBLE, 1,
+                proj->false_northing);
+            set_gtif_geographic_keys (gtif, proj);
+            break;
+
+        default:
+            sprintf (errmsg, "Unsupported projection type (%d).  GEO "
+                "projection code (%d) or UTM projection code (%d) or ALBERS "
+                "projection code (%d) or PS projection code (%d) or SIN "
+                "projection code (%d) expected.", proj->proj_type,
+                GCTP_GEO_PROJ, GCTP_UTM_PROJ, GCTP_ALBERS_PROJ, GCTP_PS_PROJ,
+                GCTP_SIN_PROJ);
+            error_handler (true, FUNC_NAME, errmsg);
+            GTIFFree (gtif);
+            return (ERROR);
+    }
+
+    /* Write the keys to the TIFF directory */
+    if (!GTIFWriteKeys (gtif))
+    {
+        sprintf (errmsg, "Writing the GeoKeys");
+        error_handler (true, FUNC_NAME, errmsg);
+        GTIFFree (gtif);
+        return (ERROR);
+    }
+    GTIFFree (gtif);
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_tfw_file
+
+PURPOSE: Writes the ESRI world file (.tfw) for the GeoTIFF band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the world file
+SUCCESS         Successful completion
+
+NOTES:
+  1. The world file coordinates refer to the center of the UL pixel.
+******************************************************************************/
+int write_tfw_file
+(
+    char *gtif_file,           /* I: name of the GeoTIFF file; the world file
+                                     will be written using the .tfw
+                                     extension */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+)
+{
+    char FUNC_NAME[] = "write_tfw_file";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char tfw_file[STR_SIZE];  /* name of the world file */
+    char *cptr = NULL;        /* pointer to the file extension */
+    int count;                /* number of chars copied in snprintf */
+    double ul_x, ul_y;        /* center of the UL pixel */
+    FILE *fp = NULL;          /* file pointer for the world file */
+
+    /* Replace the file extension with .tfw */
+    count = snprintf (tfw_file, sizeof (tfw_file), "%s", gtif_file);
+    if (count < 0 || count >= sizeof (tfw_file) - 4)
+    {
+        sprintf (errmsg, "Overflow of tfw_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (tfw_file, '.');
+    if (cptr == NULL)
+        cptr = &tfw_file[count];
+    strcpy (cptr, ".tfw");
+
+    /* Determine the center of the UL pixel */
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+    {
+        ul_x = gmeta->proj_info.ul_corner[0];
+        ul_y = gmeta->proj_info.ul_corner[1];
+    }
+    else
+    {
+        ul_x = gmeta->proj_info.ul_corner[0] + 0.5 * bmeta->pixel_size[0];
+        ul_y = gmeta->proj_info.ul_corner[1] - 0.5 * bmeta->pixel_size[1];
+    }
+
+    /* Write the world file */
+    fp = fopen (tfw_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the world file: %s", tfw_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fprintf (fp, "%.10f\n%.10f\n%.10f\n%.10f\n%.10f\n%.10f\n",
+        bmeta->pixel_size[0], 0.0, 0.0, -bmeta->pixel_size[1], ul_x, ul_y);
+    fclose (fp);
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_gtif_image_fields
+
+PURPOSE: Sets the TIFF fields describing the image structure and compression
+of the current directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The compression isn't supported by libtiff
+SUCCESS         Successful completion
+
+NOTES:
+  1. Compressed images use the horizontal differencing predictor for integer
+     data and the floating point predictor for floating point data.
+******************************************************************************/
+static int set_gtif_image_fields
+(
+    TIFF *tif,                 /* I: open TIFF file */
+    int nlines,                /* I: number of lines in the image */
+    int nsamps,                /* I: number of samples in the image */
+    int nbands,                /* I: number of bands (samples per pixel) */
+    uint16 planar_config,      /* I: TIFF planar configuration of the bands */
+    uint16 bits_per_sample,    /* I: TIFF bits per sample */
+    uint16 sample_format,      /* I: TIFF sample format */
+    Gtif_compress_t compress,  /* I: compression of the tiles */
+    char *nodata,              /* I: string version of the fill value */
+    bool reduced               /* I: is this a reduced-resolution overview? */
+)
+{
+    char FUNC_NAME[] = "set_gtif_image_fields";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    uint16 compression = COMPRESSION_NONE;  /* TIFF compression */
+
+    switch (compress)
+    {
+        case GTIF_COMPRESS_NONE:
+            break;
+        case GTIF_COMPRESS_DEFLATE:
+            compression = COMPRESSION_ADOBE_DEFLATE;
+            break;
+        case GTIF_COMPRESS_ZSTD:
+#ifdef COMPRESSION_ZSTD
+            compression = COMPRESSION_ZSTD;
+            break;
+#else
+            sprintf (errmsg, "This libtiff doesn't support zstd compression");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+#endif
+    }
+
+    if (compression != COMPRESSION_NONE && !TIFFIsCODECConfigured (compression))
+    {
+        sprintf (errmsg, "The %s codec isn't configured in libtiff",
+            compress == GTIF_COMPRESS_ZSTD ? "zstd" : "deflate");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (reduced)
+        TIFFSetField (tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE);
+    TIFFSetField (tif, TIFFTAG_IMAGEWIDTH, nsamps);
+    TIFFSetField (tif, TIFFTAG_IMAGELENGTH, nlines);
+    TIFFSetField (tif, TIFFTAG_BITSPERSAMPLE, bits_per_sample);
+    TIFFSetField (tif, TIFFTAG_SAMPLEFORMAT, sample_format);
+    TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, nbands);
+    TIFFSetField (tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField (tif, TIFFTAG_PLANARCONFIG, planar_config);
+    TIFFSetField (tif, TIFFTAG_COMPRESSION, compression);
+    TIFFSetField (tif, TIFFTAG_TILEWIDTH, GTIF_TILE_SIZE);
+    TIFFSetField (tif, TIFFTAG_TILELENGTH, GTIF_TILE_SIZE);
+    TIFFSetField (tif, TIFFTAG_GDAL_NODATA, nodata);
+
+    if (compression != COMPRESSION_NONE)
+    {
+        TIFFSetField (tif, TIFFTAG_PREDICTOR,
+            sample_format == SAMPLEFORMAT_IEEEFP ? PREDICTOR_FLOATINGPOINT :
+            PREDICTOR_HORIZONTAL);
+        if (compress == GTIF_COMPRESS_DEFLATE)
+            TIFFSetField (tif, TIFFTAG_ZIPQUALITY, GTIF_DEFLATE_LEVEL);
+#ifdef COMPRESSION_ZSTD
+        else
+            TIFFSetField (tif, TIFFTAG_ZSTD_LEVEL, GTIF_ZSTD_LEVEL);
+#endif
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_gtif_tiles
+
+PURPOSE: Writes a raw binary image to the tiles of the current TIFF
+directory, optionally adding the lines to the overviews being built.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the image or writing the tiles
+SUCCESS         Successful completion
+
+NOTES:
+  1. The image is read one row of tiles (GTIF_TILE_SIZE lines) at a time.
+     Tiles extending past the edge of the image are padded with zeros.
+  2. If the image is reclaimed, the lines of each tile row are released
+     once they're read.
+******************************************************************************/
+static int write_gtif_tiles
+(
+    TIFF *tif,                 /* I: open TIFF file */
+    FILE *fp_rb,               /* I: raw binary image, at the first line */
+    char *img_file,            /* I: name of the raw binary image */
+    char *gtif_file,           /* I: name of the GeoTIFF file */
+    int nlines,                /* I: number of lines in the image */
+    int nsamps,                /* I: number of samples in the image */
+    int nbytes,                /* I: number of bytes per pixel */
+    uint8 *row_buf,            /* I: buffer for a row of tiles */
+    uint8 *tile_buf,           /* I: buffer for a single tile */
+    Raw_binary_overview_t *ovr, /* I/O: overviews to be built from the image;
+                                     NULL for none */
+    Raw_binary_reclaim_t *rcl  /* I/O: reclamation of the image; NULL if it
+                                     isn't reclaimed */
+)
+{
+    char FUNC_NAME[] = "write_gtif_tiles";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int line;                 /* starting line of the current tile row */
+    int samp;                 /* starting sample of the current tile */
+    int l;                    /* looping variable for lines in the tile */
+    int nrows;                /* number of lines in the current tile row */
+    int ncols;                /* number of samples in the current tile */
+
+    /* Loop through the rows of tiles, reading the lines for the tile row
+       and then writing each tile in the row */
+    for (line = 0; line < nlines; line += GTIF_TILE_SIZE)
+    {
+        nrows = GTIF_TILE_SIZE;
+        if (line + nrows > nlines)
+            nrows = nlines - line;
+
+        if (read_raw_binary (fp_rb, nrows, nsamps, nbytes, row_buf)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d from %s", line,
+                line + nrows - 1, img_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (rcl != NULL)
+            reclaim_raw_binary_lines (rcl, line + nrows);
+
+        if (ovr != NULL &&
+            add_raw_binary_overview_lines (ovr, nrows, row_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Building the overviews from lines %d-%d of %s",
+                line, line + nrows - 1, img_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (samp = 0; samp < nsamps; samp += GTIF_TILE_SIZE)
+        {
+            ncols = GTIF_TILE_SIZE;
+            if (samp + ncols > nsamps)
+                ncols = nsamps - samp;
+
+            if (nrows < GTIF_TILE_SIZE || ncols < GTIF_TILE_SIZE)
+                memset (tile_buf, 0, (size_t) GTIF_TILE_SIZE *
+                    GTIF_TILE_SIZE * nbytes);
+            for (l = 0; l < nrows; l++)
+                memcpy (&tile_buf[(size_t) l * GTIF_TILE_SIZE * nbytes],
+                    &row_buf[((size_t) l * nsamps + samp) * nbytes],
+                    (size_t) ncols * nbytes);
+
+            espa_io_throttle (ESPA_IO_WRITE, (size_t) GTIF_TILE_SIZE *
+                GTIF_TILE_SIZE * nbytes);
+            if (TIFFWriteTile (tif, tile_buf, samp, line, 0, 0) < 0)
+            {
+                sprintf (errmsg, "Writing tile at line %d, sample %d to %s",
+                    line, samp, gtif_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_gtif_overview_levels
+
+PURPOSE: Determines the number of overview levels for a Cloud-Optimized
+GeoTIFF, which are added until the overview fits in a single tile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+nlevels         Number of overview levels (0 to RB_MAX_OVERVIEWS)
+
+NOTES:
+******************************************************************************/
+static int get_gtif_overview_levels
+(
+    int nlines,                /* I: number of lines in the band */
+    int nsamps                 /* I: number of samples in the band */
+)
+{
+    int nlevels = 0;          /* number of overview levels */
+    int factor = 1;           /* reduction factor of the current level */
+
+    while (nlevels < RB_MAX_OVERVIEWS &&
+        ((nlines + factor - 1) / factor > GTIF_TILE_SIZE ||
+         (nsamps + factor - 1) / factor > GTIF_TILE_SIZE))
+    {
+        nlevels++;
+        factor *= 2;
+    }
+
+    return (nlevels);
+}
+
+
+/******************************************************************************
+MODULE:  remove_gtif_overviews
+
+PURPOSE: Removes the temporary raw binary files of the overviews.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void remove_gtif_overviews
+(
+    Raw_binary_overview_t *ovr /* I: overviews built for the band */
+)
+{
+    int k;                    /* looping variable for the levels */
+
+    for (k = 0; k < ovr->nlevels; k++)
+        unlink (ovr->level[k].file_name);
+}
+
+
+/******************************************************************************
+MODULE:  write_gtif_band
+
+PURPOSE: Converts the raw binary band to a tiled GeoTIFF file, along with the
+associated world file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the GeoTIFF band
+SUCCESS         Successful completion
+
+NOTES:
+  1. The raw binary band is read one row of tiles (GTIF_TILE_SIZE lines) at a
+     time, so the memory used is bounded by the tile row and not the size of
+     the band.
+  2. The fill value of the band is written as the GDAL nodata value.
+  3. For a Cloud-Optimized GeoTIFF the reduced-resolution overviews (2x, 4x,
+     ... until the overview fits in a tile, up to RB_MAX_OVERVIEWS levels)
+     are built while the band is written, into temporary raw binary files
+     next to the GeoTIFF file.  They're then appended to the GeoTIFF as
+     reduced-resolution directories, with the same tiling and compression
+     as the band, and the temporary files are removed.
+  4. If reclaim_src is set, the lines of the raw binary band are released
+     as they're read, so the band is no longer usable if the conversion
+     fails.
+******************************************************************************/
+int write_gtif_band
+(
+    char *img_file,            /* I: name of the input raw binary band */
+    char *gtif_file,           /* I: name of the output GeoTIFF file */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Gtif_compress_t compress,  /* I: compression of the tiles */
+    bool cog,                  /* I: should a Cloud-Optimized GeoTIFF with
+                                     overviews be written? */
+    bool reclaim_src           /* I: should the source band be reclaimed as
+                                     it's read? see raw_binary_reclaim.h */
+)
+{
+    char FUNC_NAME[] = "write_gtif_band";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char nodata[STR_SIZE];    /* string version of the fill value */
+    char *cptr = NULL;        /* pointer to the .tif extension */
+    int k;                    /* looping variable for the overview levels */
+    int nlevels = 0;          /* number of overview levels */
+    int nbytes;               /* number of bytes per pixel */
+    int status = SUCCESS;     /* return status */
+    uint16 bits_per_sample;   /* TIFF bits per sample */
+    uint16 sample_format;     /* TIFF sample format */
+    uint8 *row_buf = NULL;    /* buffer for a row of tiles from the band */
+    uint8 *tile_buf = NULL;   /* buffer for a single tile */
+    FILE *fp_rb = NULL;       /* file pointer for the raw binary band */
+    FILE *fp_ovr = NULL;      /* file pointer for an overview level */
+    TIFF *tif = NULL;         /* file pointer for the GeoTIFF file */
+    Espa_band_meta_t ovr_bmeta;  /* band metadata naming the temporary
+                                    overview files */
+    Raw_binary_overview_t ovr;   /* overviews of the band */
+    Raw_binary_overview_level_t *lvl = NULL;  /* current overview level */
+    Raw_binary_reclaim_t rcl;    /* reclamation of the band */
+
+    if (get_gtif_sample_info (bmeta->data_type, &bits_per_sample,
+        &sample_format, &nbytes) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the TIFF data type for %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Allocate the tile row and tile buffers */
+    row_buf = calloc ((size_t) GTIF_TILE_SIZE * bmeta->nsamps, nbytes);
+    tile_buf = calloc ((size_t) GTIF_TILE_SIZE * GTIF_TILE_SIZE, nbytes);
+    if (row_buf == NULL || tile_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a row of %d x %d tiles",
+            GTIF_TILE_SIZE, GTIF_TILE_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (row_buf);
+        free (tile_buf);
+        return (ERROR);
+    }
+
+    /* Open the raw binary band for reading */
+    fp_rb = open_raw_binary (img_file, "rb");
+    if (fp_rb == NULL)
+    {
+        sprintf (errmsg, "Opening the input raw binary file: %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (row_buf);
+        free (tile_buf);
+        return (ERROR);
+    }
+
+    /* Open the GeoTIFF file for writing */
+    tif = XTIFFOpen (gtif_file, "w");
+    if (tif == NULL)
+    {
+        sprintf (errmsg, "Opening the output GeoTIFF file: %s", gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary (fp_rb);
+        free (row_buf);
+        free (tile_buf);
+        return (ERROR);
+    }
+    TIFFMergeFieldInfo (tif, gdal_field_info,
+        sizeof (gdal_field_info) / sizeof (gdal_field_info[0]));
+
+    /* Set up the image structure and georeferencing */
+    snprintf (nodata, sizeof (nodata), "%ld", bmeta->fill_value);
+    if (set_gtif_image_fields (tif, bmeta->nlines, bmeta->nsamps, 1,
+        PLANARCONFIG_CONTIG, bits_per_sample, sample_format, compress, nodata, false) != SUCCESS ||
+        set_gtif_georeference (tif, bmeta, gmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting the image fields and georeferencing for %s",
+            gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        XTIFFClose (tif);
+        close_raw_binary (fp_rb);
+        free (row_buf);
+        free (tile_buf);
+        return (ERROR);
+    }
+
+    /* Set up the overviews, named after the GeoTIFF file so they don't
+       overwrite any overviews of the raw binary band */
+    memset (&ovr, 0, sizeof (ovr));
+    if (cog)
+        nlevels = get_gtif_overview_levels (bmeta->nlines, bmeta->nsamps);
+    if (nlevels > 0)
+    {
+        ovr_bmeta = *bmeta;
+        snprintf (ovr_bmeta.file_name, sizeof (ovr_bmeta.file_name), "%s",
+            gtif_file);
+        cptr = strrchr (ovr_bmeta.file_name, '.');
+        if (cptr != NULL)
+            *cptr = '\0';
+        strncat (ovr_bmeta.file_name, "_cogtmp.img",
+            sizeof (ovr_bmeta.file_name) - strlen (ovr_bmeta.file_name) - 1);
+        if (open_raw_binary_overviews (&ovr_bmeta, nlevels, &ovr) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting up the overviews for %s", gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            XTIFFClose (tif);
+            close_raw_binary (fp_rb);
+            free (row_buf);
+            free (tile_buf);
+            return (ERROR);
+        }
+    }
+
+    /* Write the band, building the overviews as it's read */
+    open_raw_binary_reclaim (bmeta, reclaim_src, &rcl);
+    status = write_gtif_tiles (tif, fp_rb, img_file, gtif_file,
+        bmeta->nlines, bmeta->nsamps, nbytes, row_buf, tile_buf,
+        nlevels > 0 ? &ovr : NULL, &rcl);
+    close_raw_binary_reclaim (&rcl);
+    close_raw_binary (fp_rb);
+    if (nlevels > 0 && close_raw_binary_overviews (&ovr) != SUCCESS)
+        status = ERROR;
+
+    /* Append each overview level as a reduced-resolution directory */
+    for (k = 0; k < nlevels && status == SUCCESS; k++)
+    {
+        lvl = &ovr.level[k];
+        if (!TIFFWriteDirectory (tif) ||
+            set_gtif_image_fields (tif, lvl->nlines, lvl->nsamps, 1,
+            PLANARCONFIG_CONTIG, bits_per_sample, sample_format, compress,
+            nodata, true) != SUCCESS)
+        {
+            sprintf (errmsg, "Starting the %dx overview of %s", lvl->factor,
+                gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        fp_ovr = open_raw_binary (lvl->file_name, "rb");
+        if (fp_ovr == NULL)
+        {
+            sprintf (errmsg, "Opening the overview file: %s", lvl->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        status = write_gtif_tiles (tif, fp_ovr, lvl->file_name, gtif_file,
+            lvl->nlines, lvl->nsamps, nbytes, row_buf, tile_buf, NULL, NULL);
+        close_raw_binary (fp_ovr);
+    }
+
+    /* Close the files and free the memory */
+    XTIFFClose (tif);
+    remove_gtif_overviews (&ovr);
+    free (row_buf);
+    free (tile_buf);
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Write the associated world file */
+    if (write_tfw_file (gtif_file, bmeta, gmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the world file for %s", gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_gtif_band_descriptions
+
+PURPOSE: Generates the GDAL metadata XML naming each band of a multi-band
+GeoTIFF file.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            Error allocating memory
+non-NULL        GDAL metadata XML; the caller is responsible for freeing it
+
+NOTES:
+  1. The band names are written as the GDAL band descriptions, so clients
+     can identify the bands without the XML metadata.
+******************************************************************************/
+static char *get_gtif_band_descriptions
+(
+    int nbands,                /* I: number of bands in the file */
+    Espa_band_meta_t **bmeta   /* I: band metadata for each band */
+)
+{
+    char *gdal_meta = NULL;   /* GDAL metadata XML */
+    int b;                    /* looping variable for the bands */
+    size_t gdal_meta_size;    /* allocated size of the GDAL metadata */
+    size_t len;               /* current length of the GDAL metadata */
+
+    gdal_meta_size = (size_t) nbands * (STR_SIZE + 80) + 40;
+    gdal_meta = malloc (gdal_meta_size);
+    if (gdal_meta == NULL)
+        return (NULL);
+
+    len = snprintf (gdal_meta, gdal_meta_size, "<GDALMetadata>\n");
+    for (b = 0; b < nbands; b++)
+        len += snprintf (&gdal_meta[len], gdal_meta_size - len,
+            "  <Item name=\"DESCRIPTION\" sample=\"%d\" "
+            "role=\"description\">%s</Item>\n", b, bmeta[b]->name);
+    snprintf (&gdal_meta[len], gdal_meta_size - len, "</GDALMetadata>");
+
+    return (gdal_meta);
+}
+
+
+/******************************************************************************
+MODULE:  write_gtif_multiband
+
+PURPOSE: Converts a set of raw binary bands, all of the same size and data
+type, to a single multi-band tiled GeoTIFF file, along with the associated
+world file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the GeoTIFF file
+SUCCESS         Successful completion
+
+NOTES:
+  1. The bands are read together one row of tiles (GTIF_TILE_SIZE lines) at
+     a time, so the file is written in a single pass over the raw binary
+     bands and the memory used is bounded by a tile row of each band.
+  2. Band interleave writes each band as a separate plane of tiles
+     (PLANARCONFIG_SEPARATE), and pixel interleave writes the bands of each
+     pixel together (PLANARCONFIG_CONTIG).
+  3. The georeferencing, world file, and GDAL nodata value come from the
+     first band.  GDAL supports a single nodata value per file.
+  4. If reclaim_src is set, the lines of the raw binary bands are released
+     as they're read, so the bands are no longer usable if the conversion
+     fails.
+******************************************************************************/
+int write_gtif_multiband
+(
+    char *gtif_file,           /* I: name of the output GeoTIFF file */
+    int nbands,                /* I: number of bands to be written */
+    Espa_band_meta_t **bmeta,  /* I: band metadata for each band, in the
+                                     order the bands are written */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Gtif_compress_t compress,  /* I: compression of the tiles */
+    Gtif_interleave_t interleave, /* I: interleave of the bands; must be
+                                       band or pixel */
+    bool reclaim_src           /* I: should the source bands be reclaimed as
+                                     they're read? see raw_binary_reclaim.h */
+)
+{
+    char FUNC_NAME[] = "write_gtif_multiband";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char nodata[STR_SIZE];    /* string version of the fill value */
+    char *gdal_meta = NULL;   /* GDAL metadata with the band descriptions */
+    int b;                    /* looping variable for the bands */
+    int line;                 /* starting line of the current tile row */
+    int samp;                 /* starting sample of the current tile */
+    int l;                    /* looping variable for lines in the tile */
+    int s;                    /* looping variable for samples in the tile */
+    int nrows;                /* number of lines in the current tile row */
+    int ncols;                /* number of samples in the current tile */
+    int nlines = bmeta[0]->nlines;  /* number of lines in the bands */
+    int nsamps = bmeta[0]->nsamps;  /* number of samples in the bands */
+    int nbytes;               /* number of bytes per pixel */
+    int status = SUCCESS;     /* return status */
+    size_t row_size;          /* number of bytes in a tile row of a band */
+    size_t tile_size;         /* number of bytes in a tile of a band */
+    uint16 bits_per_sample;   /* TIFF bits per sample */
+    uint16 sample_format;     /* TIFF sample format */
+    uint16 planar_config;     /* TIFF planar configuration */
+    uint8 *row_buf = NULL;    /* buffer for a row of tiles from each band */
+    uint8 *tile_buf = NULL;   /* buffer for a single tile */
+    uint8 *row_ptr = NULL;    /* pointer to the tile row of the band */
+    uint8 *tile_ptr = NULL;   /* pointer to the current pixel of the tile */
+    FILE **fp_rb = NULL;      /* file pointers for the raw binary bands */
+    TIFF *tif = NULL;         /* file pointer for the GeoTIFF file */
+    Raw_binary_reclaim_t *rcl = NULL;  /* reclamation of the bands */
+
+    if (interleave != GTIF_INTERLEAVE_BAND &&
+        interleave != GTIF_INTERLEAVE_PIXEL)
+    {
+        sprintf (errmsg, "Band or pixel interleave is required for a "
+            "multi-band GeoTIFF file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    planar_config = interleave == GTIF_INTERLEAVE_BAND ?
+        PLANARCONFIG_SEPARATE : PLANARCONFIG_CONTIG;
+
+    /* Make sure the bands can be written to the same file */
+    for (b = 1; b < nbands; b++)
+    {
+        if (bmeta[b]->nlines != nlines || bmeta[b]->nsamps != nsamps ||
+            bmeta[b]->data_type != bmeta[0]->data_type)
+        {
+            sprintf (errmsg, "Band %s doesn't have the same size and data "
+                "type as band %s", bmeta[b]->name, bmeta[0]->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (get_gtif_sample_info (bmeta[0]->data_type, &bits_per_sample,
+        &sample_format, &nbytes) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the TIFF data type for %s",
+            bmeta[0]->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Allocate the tile row buffers for every band, the tile buffer, and
+       the band file pointers */
+    row_size = (size_t) GTIF_TILE_SIZE * nsamps * nbytes;
+    tile_size = (size_t) GTIF_TILE_SIZE * GTIF_TILE_SIZE * nbytes;
+    row_buf = malloc (row_size * nbands);
+    tile_buf = calloc (interleave == GTIF_INTERLEAVE_PIXEL ? nbands : 1,
+        tile_size);
+    fp_rb = calloc (nbands, sizeof (FILE *));
+    rcl = calloc (nbands, sizeof (Raw_binary_reclaim_t));
+    gdal_meta = get_gtif_band_descriptions (nbands, bmeta);
+    if (row_buf == NULL || tile_buf == NULL || fp_rb == NULL ||
+        rcl == NULL || gdal_meta == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for a row of %d x %d tiles of "
+            "%d bands", GTIF_TILE_SIZE, GTIF_TILE_SIZE, nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (row_buf);
+        free (tile_buf);
+        free (fp_rb);
+        free (rcl);
+        free (gdal_meta);
+        return (ERROR);
+    }
+
+    /* Set up the reclamation of the raw binary bands */
+    for (b = 0; b < nbands; b++)
+        open_raw_binary_reclaim (bmeta[b], reclaim_src, &rcl[b]);
+
+    /* Open the raw binary bands for reading */
+    for (b = 0; b < nbands; b++)
+    {
+        fp_rb[b] = open_raw_binary (bmeta[b]->file_name, "rb");
+        if (fp_rb[b] == NULL)
+        {
+            sprintf (errmsg, "Opening the input raw binary file: %s",
+                bmeta[b]->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    /* Open the GeoTIFF file for writing and set up the image structure,
+       band descriptions, and georeferencing */
+    if (status == SUCCESS)
+    {
+        tif = XTIFFOpen (gtif_file, "w");
+        if (tif == NULL)
+        {
+            sprintf (errmsg, "Opening the output GeoTIFF file: %s",
+                gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        TIFFMergeFieldInfo (tif, gdal_field_info,
+            sizeof (gdal_field_info) / sizeof (gdal_field_info[0]));
+        snprintf (nodata, sizeof (nodata), "%ld", bmeta[0]->fill_value);
+        TIFFSetField (tif, TIFFTAG_GDAL_METADATA, gdal_meta);
+        if (set_gtif_image_fields (tif, nlines, nsamps, nbands,
+            planar_config, bits_per_sample, sample_format, compress, nodata,
+            false) != SUCCESS ||
+            set_gtif_georeference (tif, bmeta[0], gmeta) != SUCCESS)
+        {
+            sprintf (errmsg, "Setting the image fields and georeferencing "
+                "for %s", gtif_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Loop through the rows of tiles, reading the lines for the tile row
+       from each band and then writing each tile in the row.  Tiles
+       extending past the edge of the image are padded with zeros. */
+    for (line = 0; line < nlines && status == SUCCESS; line += GTIF_TILE_SIZE)
+    {
+        nrows = GTIF_TILE_SIZE;
+        if (line + nrows > nlines)
+            nrows = nlines - line;
+
+        for (b = 0; b < nbands; b++)
+        {
+            if (read_raw_binary (fp_rb[b], nrows, nsamps, nbytes,
+                &row_buf[b * row_size]) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d from %s", line,
+                    line + nrows - 1, bmeta[b]->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            reclaim_raw_binary_lines (&rcl[b], line + nrows);
+        }
+
+        for (samp = 0; samp < nsamps && status == SUCCESS;
+            samp += GTIF_TILE_SIZE)
+        {
+            ncols = GTIF_TILE_SIZE;
+            if (samp + ncols > nsamps)
+                ncols = nsamps - samp;
+
+            if (nrows < GTIF_TILE_SIZE || ncols < GTIF_TILE_SIZE)
+                memset (tile_buf, 0, tile_size *
+                    (interleave == GTIF_INTERLEAVE_PIXEL ? nbands : 1));
+
+            if (interleave == GTIF_INTERLEAVE_PIXEL)
+            {
+                /* Interleave the bands of each pixel in the tile */
+                for (l = 0; l < nrows; l++)
+                {
+                    tile_ptr = &tile_buf[(size_t) l * GTIF_TILE_SIZE *
+                        nbands * nbytes];
+                    for (s = 0; s < ncols; s++)
+                    {
+                        for (b = 0; b < nbands; b++)
+                        {
+                            row_ptr = &row_buf[b * row_size +
+                                ((size_t) l * nsamps + samp + s) * nbytes];
+                            memcpy (tile_ptr, row_ptr, nbytes);
+                            tile_ptr += nbytes;
+                        }
+                    }
+                }
+
+                espa_io_throttle (ESPA_IO_WRITE, tile_size * nbands);
+                if (TIFFWriteTile (tif, tile_buf, samp, line, 0, 0) < 0)
+                {
+                    sprintf (errmsg, "Writing tile at line %d, sample %d to "
+                        "%s", line, samp, gtif_file);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                }
+                continue;
+            }
+
+            /* Write the tile for each band plane */
+            for (b = 0; b < nbands; b++)
+            {
+                row_ptr = &row_buf[b * row_size];
+                for (l = 0; l < nrows; l++)
+                    memcpy (&tile_buf[(size_t) l * GTIF_TILE_SIZE * nbytes],
+                        &row_ptr[((size_t) l * nsamps + samp) * nbytes],
+                        (size_t) ncols * nbytes);
+
+                espa_io_throttle (ESPA_IO_WRITE, tile_size);
+                if (TIFFWriteTile (tif, tile_buf, samp, line, 0, b) < 0)
+                {
+                    sprintf (errmsg, "Writing tile at line %d, sample %d of "
+                        "band %s to %s", line, samp, bmeta[b]->name,
+                        gtif_file);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Close the files and free the memory */
+    if (tif != NULL)
+        XTIFFClose (tif);
+    for (b = 0; b < nbands; b++)
+    {
+        if (fp_rb[b] != NULL)
+            close_raw_binary (fp_rb[b]);
+        close_raw_binary_reclaim (&rcl[b]);
+    }
+    free (row_buf);
+    free (tile_buf);
+    free (fp_rb);
+    free (rcl);
+    free (gdal_meta);
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Write the associated world file */
+    if (write_tfw_file (gtif_file, bmeta[0], gmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the world file for %s", gtif_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
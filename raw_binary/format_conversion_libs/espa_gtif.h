@@ -0,0 +1,106 @@
+/*****************************************************************************
+FILE: espa_gtif.h
+
+PURPOSE: Contains defines and prototypes for writing GeoTIFF files and their
+georeferencing information directly from the ESPA internal metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef ESPA_GTIF_H
+#define ESPA_GTIF_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "geotiffio.h"
+#include "xtiffio.h"
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_io.h"
+#include "raw_binary_overview.h"
+#include "raw_binary_reclaim.h"
+
+/* Defines */
+/* Size (in pixels) of the square tiles written to the GeoTIFF files.  TIFF
+   requires the tile dimensions to be a multiple of 16. */
+#define GTIF_TILE_SIZE 256
+
+/* GDAL private tags for storing the metadata (band descriptions) as XML and
+   the nodata value as an ASCII string */
+#define TIFFTAG_GDAL_METADATA 42112
+#define TIFFTAG_GDAL_NODATA 42113
+
+/* Compression levels for the compressed tiles */
+#define GTIF_DEFLATE_LEVEL 6
+#define GTIF_ZSTD_LEVEL 9
+
+/* Type definitions */
+/* Compression of the GeoTIFF tiles */
+typedef enum
+{
+    GTIF_COMPRESS_NONE,     /* uncompressed tiles (default) */
+    GTIF_COMPRESS_DEFLATE,  /* tiles compressed with deflate */
+    GTIF_COMPRESS_ZSTD      /* tiles compressed with zstd; requires libtiff
+                               built with zstd */
+} Gtif_compress_t;
+
+/* Layout of the bands of a product in the GeoTIFF files */
+typedef enum
+{
+    GTIF_INTERLEAVE_NONE,   /* each band in its own file (default) */
+    GTIF_INTERLEAVE_BAND,   /* bands in one file, each band a separate plane
+                               of tiles */
+    GTIF_INTERLEAVE_PIXEL   /* bands in one file, interleaved by pixel */
+} Gtif_interleave_t;
+
+/* Prototypes */
+int set_gtif_georeference
+(
+    TIFF *tif,                 /* I: open TIFF file to be georeferenced */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+);
+
+int write_tfw_file
+(
+    char *gtif_file,           /* I: name of the GeoTIFF file; the world file
+                                     will be written using the .tfw
+                                     extension */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta  /* I: pointer to global metadata */
+);
+
+int write_gtif_band
+(
+    char *img_file,            /* I: name of the input raw binary band */
+    char *gtif_file,           /* I: name of the output GeoTIFF file */
+    Espa_band_meta_t *bmeta,   /* I: pointer to band metadata for this band */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Gtif_compress_t compress,  /* I: compression of the tiles */
+    bool cog,                  /* I: should a Cloud-Optimized GeoTIFF with
+                                     overviews be written? */
+    bool reclaim_src           /* I: should the source band be reclaimed as
+                                     it's read? see raw_binary_reclaim.h */
+);
+
+int write_gtif_multiband
+(
+    char *gtif_file,           /* I: name of the output GeoTIFF file */
+    int nbands,                /* I: number of bands to be written */
+    Espa_band_meta_t **bmeta,  /* I: band metadata for each band, in the
+                                     order the bands are written */
+    Espa_global_meta_t *gmeta, /* I: pointer to global metadata */
+    Gtif_compress_t compress,  /* I: compression of the tiles */
+    Gtif_interleave_t interleave, /* I: interleave of the bands; must be
+                                       band or pixel */
+    bool reclaim_src           /* I: should the source bands be reclaimed as
+                                     they're read? see raw_binary_reclaim.h */
+);
+
+#endif
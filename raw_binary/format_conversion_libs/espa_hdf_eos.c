@@ -72,6 +72,119 @@ double deg_to_dms
 }
 
 
+/******************************************************************************
+MODULE:  init_meta_buf
+
+PURPOSE:  Allocates an empty metadata buffer.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error allocating the buffer
+true       Successful processing
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The buffer grows as strings are appended, so size is only the initial
+     size.  The caller is responsible for calling free_meta_buf.
+******************************************************************************/
+bool init_meta_buf
+(
+    Espa_meta_buf_t *meta,  /* O: metadata buffer */
+    size_t size             /* I: initial size of the buffer, in bytes */
+)
+{
+    if (size < 1)
+        size = 1;
+    meta->str = malloc (size);
+    meta->len = 0;
+    meta->size = size;
+    if (meta->str == NULL)
+        return false;
+    meta->str[0] = '\0';
+
+    return true;
+}
+
+
+/******************************************************************************
+MODULE:  free_meta_buf
+
+PURPOSE:  Frees the string of a metadata buffer.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void free_meta_buf
+(
+    Espa_meta_buf_t *meta   /* I/O: metadata buffer */
+)
+{
+    free (meta->str);
+    meta->str = NULL;
+    meta->len = 0;
+    meta->size = 0;
+}
+
+
+/******************************************************************************
+MODULE:  append_meta_len
+
+PURPOSE:  Appends nc characters to the metadata buffer, growing the buffer
+if needed.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error growing the buffer
+true       Successful processing
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The buffer is doubled when it fills, so building the metadata takes
+     time linear in its length.
+******************************************************************************/
+static bool append_meta_len
+(
+    Espa_meta_buf_t *meta,  /* I/O: metadata buffer */
+    const char *str,        /* I: characters to append to the buffer */
+    size_t nc               /* I: number of characters to append */
+)
+{
+    size_t size;            /* new size of the buffer */
+    char *str_new = NULL;   /* grown buffer */
+
+    if (meta->len + nc + 1 > meta->size)
+    {
+        size = meta->size * 2;
+        if (size < meta->len + nc + 1)
+            size = meta->len + nc + 1;
+        str_new = realloc (meta->str, size);
+        if (str_new == NULL)
+            return false;
+        meta->str = str_new;
+        meta->size = size;
+    }
+
+    memcpy (&meta->str[meta->len], str, nc);
+    meta->len += nc;
+    meta->str[meta->len] = '\0';
+
+    return true;
+}
+
+
 /******************************************************************************
 MODULE:  append_meta
 
@@ -81,7 +194,7 @@ RETURN VALUE:
 Type = bool
 Value      Description
 -----      -----------
-false      Error in the number of attributes
+false      Error growing the buffer
 true       Successful processing
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
@@ -91,72 +204,168 @@ NOTES:
 ******************************************************************************/
 bool append_meta
 (
-    char *cbuf,  /* I/O: input metadata buffer */
-    int *ic,     /* I/O: index of current location in metadata buffer */
-    char *str    /* I: string to append to the metadata buffer */
+    Espa_meta_buf_t *meta,  /* I/O: metadata buffer */
+    const char *str         /* I: string to append to the metadata buffer */
 )
 {
-    int nc, i;
-  
-    /* Validate the string and number of attributes */
-    if (*ic < 0)
-        return false;
-    nc = strlen (str);
-    if (nc <= 0)
-        return false;
-    if (*ic + nc > ESPA_MAX_METADATA_SIZE)
-        return false;
-  
-    /* Add the string to the metadata */
-    for (i = 0; i < nc; i++)
+    return append_meta_len (meta, str, strlen (str));
+}
+
+
+/******************************************************************************
+MODULE:  append_meta_int
+
+PURPOSE:  Appends the decimal value of an integer to the metadata buffer.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error growing the buffer
+true       Successful processing
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The digits are formatted directly rather than with sprintf, since this
+     is called for every field of the metadata.
+******************************************************************************/
+bool append_meta_int
+(
+    Espa_meta_buf_t *meta,  /* I/O: metadata buffer */
+    int value               /* I: value to append to the metadata buffer */
+)
+{
+    char digits[16];        /* digits of the value, from the end */
+    int nc = 0;             /* number of characters in digits */
+    unsigned int uvalue;    /* magnitude of the value */
+
+    uvalue = value < 0 ? 0U - (unsigned int) value : (unsigned int) value;
+    do
+    {
+        digits[sizeof (digits) - 1 - nc++] = '0' + uvalue % 10;
+        uvalue /= 10;
+    } while (uvalue > 0);
+    if (value < 0)
+        digits[sizeof (digits) - 1 - nc++] = '-';
+
+    return append_meta_len (meta, &digits[sizeof (digits) - nc], nc);
+}
+
+
+/******************************************************************************
+MODULE:  get_hdf_eos_type
+
+PURPOSE:  Returns the HDF-EOS name of the data type of a band.
+
+RETURN VALUE:
+Type = const char *
+Value      Description
+-----      -----------
+{all}      Name of the HDF data type
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static const char *get_hdf_eos_type
+(
+    enum Espa_data_type data_type   /* I: ESPA data type */
+)
+{
+    switch (data_type)
     {
-        cbuf[*ic] = str[i];
-        (*ic)++;
+        case ESPA_INT8: return ("DFNT_INT8");
+        case ESPA_UINT8: return ("DFNT_UINT8");
+        case ESPA_INT16: return ("DFNT_INT16");
+        case ESPA_UINT16: return ("DFNT_UINT16");
+        case ESPA_INT32: return ("DFNT_INT32");
+        case ESPA_UINT32: return ("DFNT_UINT32");
+        case ESPA_FLOAT32: return ("DFNT_FLOAT32");
+        case ESPA_FLOAT64: return ("DFNT_FLOAT64");
+        default: return ("");
     }
-    cbuf[*ic] = '\0';
-  
-    return true;
 }
 
+
 /******************************************************************************
-MODULE:  write_hdf_eos_attr
+MODULE:  append_hdf_eos_field
+
+PURPOSE:  Appends the DataField object of a band to the metadata buffer.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+false      Error growing the buffer
+true       Successful processing
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The object is assembled from its pieces rather than formatted with
+     snprintf, since there is one for every band.
+******************************************************************************/
+static bool append_hdf_eos_field
+(
+    Espa_meta_buf_t *meta,  /* I/O: metadata buffer */
+    int field,              /* I: number of the field in the grid, from 1 */
+    Espa_band_meta_t *bmeta /* I: band of the field */
+)
+{
+    return (append_meta (meta, "\t\t\tOBJECT=DataField_") &&
+        append_meta_int (meta, field) &&
+        append_meta (meta, "\n\t\t\t\tDataFieldName=\"") &&
+        append_meta (meta, bmeta->name) &&
+        append_meta (meta, "\"\n\t\t\t\tDataType=") &&
+        append_meta (meta, get_hdf_eos_type (bmeta->data_type)) &&
+        append_meta (meta, "\n\t\t\t\tDimList=(\"YDim\",\"XDim\")\n"
+            "\t\t\tEND_OBJECT=DataField_") &&
+        append_meta_int (meta, field) &&
+        append_meta (meta, "\n"));
+}
 
-PURPOSE:  Write the spatial definition HDF-EOS attributes to the HDF file and
-move the SDSs to the Grid.
+
+/******************************************************************************
+MODULE:  build_hdf_eos_struct_meta
+
+PURPOSE:  Builds the HDF-EOS structural metadata, with a Grid for each
+resolution of the bands.
 
 RETURN VALUE:
 Type = int
 Value      Description
 -----      -----------
-ERROR      Error occurred writing the metadata to the HDF file
+ERROR      Error occurred building the metadata
 SUCCESS    Successful completion
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
 
 NOTES:
+  1. processed and grid must have room for each band.
 ******************************************************************************/
-int write_hdf_eos_attr
+static int build_hdf_eos_struct_meta
 (
-    char *hdf_file,            /* I: HDF file to write attributes to */
-    Espa_internal_meta_t *xml_metadata   /* I: XML metadata structure */
+    Espa_internal_meta_t *xml_metadata,  /* I: XML metadata structure */
+    Espa_meta_buf_t *meta,     /* I/O: buffer for the structural metadata */
+    bool *processed,           /* O: was each band processed already */
+    int *num_grids,            /* O: number of grids */
+    int *grid                  /* O: which band in XML each grid is based on */
 )
 {
-    char FUNC_NAME[] = "write_hdf_eos_attr";  /* function name */
+    char FUNC_NAME[] = "build_hdf_eos_struct_meta";  /* function name */
     char errmsg[STR_SIZE];                    /* error message */
     char grid_name[] = "Grid";                /* name of the HDF-EOS grid */
-    char struct_meta[ESPA_MAX_METADATA_SIZE]; /* structural metadata */
     char cbuf[ESPA_MAX_METADATA_SIZE];        /* temp buffer for metadata */
-    char *dim_names[2] = {"YDim", "XDim"};    /* base names for dimensions */
     char proj_str[STR_SIZE];                  /* projection string */
     char datum_str[STR_SIZE];                 /* datum string */
-    char dtype[STR_SIZE];                     /* data type */
-    char temp_name[STR_SIZE];                 /* temporary grid name */
     double ul_corner[2];     /* UL corner x,y -- Geographic is DMS */
     double lr_corner[2];     /* LR corner x,y -- Geographic is DMS */
     double proj_parms[NPROJ_PARAM];  /* projection parameters */
-    double dval;             /* temporary double value */
-    int meta_indx;           /* index of current location in metadata buffer */
     int sphere_code = -99;   /* GCTP value for the associated spheroid */
     int i;                   /* looping variable */
     int count;               /* number of chars copied in snprintf */
@@ -165,16 +374,7 @@ int write_hdf_eos_attr
     int isds;                /* looping variable for SDSs */
     int ngrids;              /* number of grids written to HDF file */
     int nfields;             /* number of fields written for this grid */
-    int igrid;               /* looping variable for the grids */
-    int grid[MAX_TOTAL_BANDS]; /* which band in XML was the grid based on */
-    int32 hdf_id;            /* HDF-EOS file ID */
-    int32 hdf_file_id;       /* HDF file ID */
-    bool processed[MAX_TOTAL_BANDS];  /* was this band processed already */
     bool done;               /* are we done processing all bands */
-    int32 vgroup_id[3];      /* array to hold Vgroup IDs */
-    int32 sds_index;         /* index of SDS in the HDF file */
-    int32 sds_id;            /* SDS ID */
-    Espa_hdf_attr_t attr;    /* attributes for writing the metadata */
     Espa_global_meta_t *gmeta = &xml_metadata->global;
                              /* pointer to global metadata structure */
   
@@ -183,7 +383,6 @@ int write_hdf_eos_attr
         processed[isds] = false;
 
     /* Build the HDF-EOS header */
-    meta_indx = 0;
     count = snprintf (cbuf, sizeof (cbuf), "%s",
         "\nGROUP=SwathStructure\n" 
         "END_GROUP=SwathStructure\n" 
@@ -196,7 +395,7 @@ int write_hdf_eos_attr
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to the start of the metadata string");
         error_handler (true, FUNC_NAME, errmsg);
@@ -262,7 +461,7 @@ int write_hdf_eos_attr
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to metadata string (grid information "
             "start)");
@@ -306,7 +505,7 @@ int write_hdf_eos_attr
         }
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to metadata string (grid information "
             "start)");
@@ -327,7 +526,7 @@ int write_hdf_eos_attr
             return (ERROR);
         }
 
-        if (!append_meta (struct_meta, &meta_indx, cbuf))
+        if (!append_meta (meta, cbuf))
         {
             sprintf (errmsg, "Error appending to metadata string (zone "
                 "number)");
@@ -346,7 +545,7 @@ int write_hdf_eos_attr
             return (ERROR);
         }
 
-        if (!append_meta (struct_meta, &meta_indx, cbuf))
+        if (!append_meta (meta, cbuf))
         {
             sprintf (errmsg, "Error appending to metadata string (grid "
                 "projection parameters start)");
@@ -417,7 +616,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string ("
                     "individual grid projection parameters)");
@@ -434,7 +633,7 @@ int write_hdf_eos_attr
             return (ERROR);
         }
 
-        if (!append_meta (struct_meta, &meta_indx, cbuf))
+        if (!append_meta (meta, cbuf))
         {
             sprintf (errmsg, "Error appending to metadata string (grid "
                 "projection parameters end)");
@@ -477,7 +676,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string (grid "
                     "information end)");
@@ -497,7 +696,7 @@ int write_hdf_eos_attr
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to metadata string (grid information "
             "end)");
@@ -517,7 +716,7 @@ int write_hdf_eos_attr
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to metadata string (SDS group "
             "start)");
@@ -536,34 +735,8 @@ int write_hdf_eos_attr
              xml_metadata->band[0].pixel_size[1]))
         {
             processed[isds] = true;
-            switch (xml_metadata->band[isds].data_type)
-            {
-                case ESPA_INT8: strcpy (dtype, "DFNT_INT8"); break;
-                case ESPA_UINT8: strcpy (dtype, "DFNT_UINT8"); break;
-                case ESPA_INT16: strcpy (dtype, "DFNT_INT16"); break;
-                case ESPA_UINT16: strcpy (dtype, "DFNT_UINT16"); break;
-                case ESPA_INT32: strcpy (dtype, "DFNT_INT32"); break;
-                case ESPA_UINT32: strcpy (dtype, "DFNT_UINT32"); break;
-                case ESPA_FLOAT32: strcpy (dtype, "DFNT_FLOAT32"); break;
-                case ESPA_FLOAT64: strcpy (dtype, "DFNT_FLOAT64"); break;
-            }
-
-            count = snprintf (cbuf, sizeof (cbuf),
-                "\t\t\tOBJECT=DataField_%d\n"
-                "\t\t\t\tDataFieldName=\"%s\"\n"
-                "\t\t\t\tDataType=%s\n"
-                "\t\t\t\tDimList=(\"%s\",\"%s\")\n"
-                "\t\t\tEND_OBJECT=DataField_%d\n",
-                nfields+1, xml_metadata->band[isds].name, dtype,
-                dim_names[0], dim_names[1], nfields+1);
-            if (count < 0 || count >= sizeof (cbuf))
-            {
-                sprintf (errmsg, "Overflow of cbuf string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_hdf_eos_field (meta, nfields+1,
+                &xml_metadata->band[isds]))
             {
                 sprintf (errmsg, "Error appending to metadata string "
                     "(SDS group)");
@@ -587,7 +760,7 @@ int write_hdf_eos_attr
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to metadata string (SDS group end)");
         error_handler (true, FUNC_NAME, errmsg);
@@ -630,7 +803,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending grid header to the metadata "
                     "string");
@@ -694,7 +867,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string (grid "
                     "information start)");
@@ -740,7 +913,7 @@ int write_hdf_eos_attr
                 }
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string (grid "
                     "information start)");
@@ -761,7 +934,7 @@ int write_hdf_eos_attr
                     return (ERROR);
                 }
 
-                if (!append_meta (struct_meta, &meta_indx, cbuf))
+                if (!append_meta (meta, cbuf))
                 {
                     sprintf (errmsg, "Error appending to metadata string (zone "
                         "number)");
@@ -781,7 +954,7 @@ int write_hdf_eos_attr
                     return (ERROR);
                 }
 
-                if (!append_meta (struct_meta, &meta_indx, cbuf))
+                if (!append_meta (meta, cbuf))
                 {
                     sprintf (errmsg, "Error appending to metadata string (grid "
                         "projection parameters start)");
@@ -860,7 +1033,7 @@ int write_hdf_eos_attr
                         return (ERROR);
                     }
 
-                    if (!append_meta (struct_meta, &meta_indx, cbuf))
+                    if (!append_meta (meta, cbuf))
                     {
                         sprintf (errmsg, "Error appending to metadata string ("
                             "individual grid projection parameters)");
@@ -877,7 +1050,7 @@ int write_hdf_eos_attr
                     return (ERROR);
                 }
 
-                if (!append_meta (struct_meta, &meta_indx, cbuf))
+                if (!append_meta (meta, cbuf))
                 {
                     sprintf (errmsg, "Error appending to metadata string (grid "
                         "projection parameters end)");
@@ -921,7 +1094,7 @@ int write_hdf_eos_attr
                         return (ERROR);
                     }
         
-                    if (!append_meta (struct_meta, &meta_indx, cbuf))
+                    if (!append_meta (meta, cbuf))
                     {
                         sprintf (errmsg, "Error appending to metadata string "
                             "(grid information end)");
@@ -941,7 +1114,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
         
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string (grid "
                     "information end)");
@@ -961,7 +1134,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string (SDS "
                     "group start)");
@@ -980,33 +1153,8 @@ int write_hdf_eos_attr
                      xml_metadata->band[isds].pixel_size[1]))
                 {
                     processed[i] = true;
-                    switch (xml_metadata->band[i].data_type)
-                    {
-                        case ESPA_INT8: strcpy(dtype, "DFNT_INT8"); break;
-                        case ESPA_UINT8: strcpy(dtype, "DFNT_UINT8"); break;
-                        case ESPA_INT16: strcpy(dtype, "DFNT_INT16"); break;
-                        case ESPA_UINT16: strcpy(dtype, "DFNT_UINT16"); break;
-                        case ESPA_INT32: strcpy(dtype, "DFNT_INT32"); break;
-                        case ESPA_UINT32: strcpy(dtype, "DFNT_UINT32"); break;
-                        case ESPA_FLOAT32: strcpy(dtype, "DFNT_FLOAT32"); break;
-                        case ESPA_FLOAT64: strcpy(dtype, "DFNT_FLOAT64"); break;
-                    }
-
-                    count = snprintf (cbuf, sizeof (cbuf),
-                        "\t\t\tOBJECT=DataField_%d\n"
-                        "\t\t\t\tDataFieldName=\"%s\"\n"
-                        "\t\t\t\tDataType=%s\n"
-                        "\t\t\t\tDimList=(\"%s\",\"%s\")\n"
-                        "\t\t\tEND_OBJECT=DataField_%d\n",
-                        nfields+1, xml_metadata->band[i].name, dtype,
-                        dim_names[0], dim_names[1], nfields+1);
-                    if (count < 0 || count >= sizeof (cbuf))
-                    {
-                        sprintf (errmsg, "Overflow of cbuf string");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        return (ERROR);
-                    }
-                    if (!append_meta (struct_meta, &meta_indx, cbuf))
+                    if (!append_hdf_eos_field (meta, nfields+1,
+                        &xml_metadata->band[i]))
                     {
                         sprintf (errmsg, "Error appending to metadata string "
                             "(SDS group)");
@@ -1030,7 +1178,7 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
 
-            if (!append_meta (struct_meta, &meta_indx, cbuf))
+            if (!append_meta (meta, cbuf))
             {
                 sprintf (errmsg, "Error appending to metadata string (SDS "
                     "group end)");
@@ -1070,68 +1218,58 @@ int write_hdf_eos_attr
         return (ERROR);
     }
 
-    if (!append_meta (struct_meta, &meta_indx, cbuf))
+    if (!append_meta (meta, cbuf))
     {
         sprintf (errmsg, "Error appending to metadata string (tail)");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-  
-    /* Write file attributes */
-    hdf_file_id = SDstart ((char *) hdf_file, DFACC_RDWR);
-    if (hdf_file_id == HDF_ERROR) 
-    {
-        sprintf (errmsg, "Error opening file for SD access: %s", hdf_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-    
-    attr.type = DFNT_FLOAT64;
-    attr.nval = 1;
-    attr.name = OUTPUT_ORIENTATION_ANGLE_HDF;
-    dval = (double) gmeta->orientation_angle;
-    if (put_attr_double (hdf_file_id, &attr, &dval) != SUCCESS)
-    {
-        sprintf (errmsg, "Error writing attribute (orientation angle)");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-  
-    attr.type = DFNT_CHAR8;
-    attr.nval = strlen (struct_meta);
-    attr.name = OUTPUT_STRUCT_METADATA;
-    if (put_attr_string (hdf_file_id, &attr, struct_meta) != SUCCESS)
-    {
-        sprintf (errmsg, "Error writing attribute (struct_meta)");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-  
-    if (SDend (hdf_file_id) == HDF_ERROR) 
-    {
-        sprintf (errmsg, "Error ending SD access");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-  
-    /* Setup the HDF Vgroup */
-    hdf_id = Hopen ((char *)hdf_file, DFACC_RDWR, 0);
-    if (hdf_id == HDF_ERROR) 
-    {
-        sprintf (errmsg, "Error opening the HDF file for Vgroup access: %s",
-            hdf_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-  
-    /* Start the Vgroup access */
-    if (Vstart (hdf_id) == HDF_ERROR) 
-    {
-        sprintf (errmsg, "Error starting Vgroup access");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-  
+
+    *num_grids = ngrids;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_hdf_eos_grids
+
+PURPOSE:  Defines the Vgroups of the HDF-EOS Grids and moves the SDSs of each
+Grid's resolution to its Data Fields.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the Grids to the HDF file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int write_hdf_eos_grids
+(
+    int32 hdf_id,              /* I: HDF file ID with Vgroup access started */
+    int32 hdf_file_id,         /* I: SD interface ID of the HDF file */
+    Espa_internal_meta_t *xml_metadata,  /* I: XML metadata structure */
+    int ngrids,                /* I: number of grids */
+    const int *grid            /* I: which band in XML each grid is based on */
+)
+{
+    char FUNC_NAME[] = "write_hdf_eos_grids";  /* function name */
+    char errmsg[STR_SIZE];                    /* error message */
+    char grid_name[] = "Grid";                /* name of the HDF-EOS grid */
+    char temp_name[STR_SIZE];                 /* temporary grid name */
+    int count;               /* number of chars copied in snprintf */
+    int mycount;             /* integer value to use in the name of the 2nd,
+                                3rd, etc. grid dimensions */
+    int isds;                /* looping variable for SDSs */
+    int igrid;               /* looping variable for the grids */
+    int32 vgroup_id[3];      /* array to hold Vgroup IDs */
+    int32 sds_index;         /* index of SDS in the HDF file */
+    int32 sds_id;            /* SDS ID */
+
     /* Loop through the Grids, define them, and then assign appropriate SDSs
        to the Data Fields */
     for (igrid = 0; igrid < ngrids; igrid++)
@@ -1237,16 +1375,7 @@ int write_hdf_eos_attr
             return (ERROR);
         }
   
-        /* Attach SDSs to Data Fields Vgroup */
-        hdf_file_id = SDstart ((char *)hdf_file, DFACC_RDWR);
-        if (hdf_file_id == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error opening output file for SD access");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-  
-        /* Loop through the bands and attach those with the same resolution
+        /* Attach SDSs to Data Fields Vgroup.  Loop through the bands and attach those with the same resolution
            as the current grid */
         for (isds = 0; isds < xml_metadata->nbands; isds++)
         {
@@ -1289,13 +1418,6 @@ int write_hdf_eos_attr
                 return (ERROR);
             }
         }
-        
-        if (SDend (hdf_file_id) == HDF_ERROR) 
-        {
-            sprintf (errmsg, "Error ending SD access");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
   
         /* Detach Vgroups */
         if (Vdetach (vgroup_id[0]) == HDF_ERROR) 
@@ -1318,20 +1440,113 @@ int write_hdf_eos_attr
         }
     }
 
-    /* Close access */
-    if (Vend (hdf_id) == HDF_ERROR) 
+    return (SUCCESS);
+}
+
+
+
+/******************************************************************************
+MODULE:  write_hdf_eos_attr
+
+PURPOSE:  Write the spatial definition HDF-EOS attributes to the HDF file and
+move the SDSs to the Grid.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred writing the metadata to the HDF file
+SUCCESS    Successful completion
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The HDF file must already be open for both Vgroup (Hopen/Vstart) and SD
+     (SDstart) access, and the SDSs must already be created.  The structural
+     metadata is built in memory and written in the same session as the SDSs,
+     so the file doesn't need to be reopened.  The caller is responsible for
+     closing the file.
+  2. The structural metadata is built in a buffer which grows as needed,
+     presized for the number of bands, so it's built in time linear in its
+     length and isn't limited in size.
+******************************************************************************/
+int write_hdf_eos_attr
+(
+    int32 hdf_id,              /* I: HDF file ID with Vgroup access started */
+    int32 hdf_file_id,         /* I: SD interface ID of the HDF file */
+    Espa_internal_meta_t *xml_metadata   /* I: XML metadata structure */
+)
+{
+    char FUNC_NAME[] = "write_hdf_eos_attr";  /* function name */
+    char errmsg[STR_SIZE];                    /* error message */
+    double dval;             /* temporary double value */
+    int ngrids;              /* number of grids written to HDF file */
+    int *grid = NULL;        /* which band in XML each grid is based on */
+    int status = SUCCESS;    /* return status */
+    bool *processed = NULL;  /* was this band processed already */
+    Espa_hdf_attr_t attr;    /* attributes for writing the metadata */
+    Espa_meta_buf_t struct_meta;  /* structural metadata */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;
+                             /* pointer to global metadata structure */
+
+    /* Allocate the structural metadata and the grids of the bands */
+    grid = malloc (xml_metadata->nbands * sizeof (int));
+    processed = calloc (xml_metadata->nbands, sizeof (bool));
+    if (!init_meta_buf (&struct_meta, ESPA_META_HEADER_SIZE +
+        (size_t) xml_metadata->nbands * ESPA_META_FIELD_SIZE) ||
+        grid == NULL || processed == NULL)
     {
-        sprintf (errmsg, "Error ending Vgroup access");
+        sprintf (errmsg, "Allocating the structural metadata for %d bands",
+            xml_metadata->nbands);
         error_handler (true, FUNC_NAME, errmsg);
+        free_meta_buf (&struct_meta);
+        free (grid);
+        free (processed);
         return (ERROR);
     }
-    if (Hclose (hdf_id) == HDF_ERROR) 
+
+    /* Build and write the structural metadata, then move the SDSs to the
+       grids */
+    attr.type = DFNT_FLOAT64;
+    attr.nval = 1;
+    attr.name = OUTPUT_ORIENTATION_ANGLE_HDF;
+    dval = (double) gmeta->orientation_angle;
+    if (build_hdf_eos_struct_meta (xml_metadata, &struct_meta, processed,
+        &ngrids, grid) != SUCCESS)
+    {
+        sprintf (errmsg, "Building the structural metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else if (put_attr_double (hdf_file_id, &attr, &dval) != SUCCESS)
     {
-        sprintf (errmsg, "Error ending HDF access");
+        sprintf (errmsg, "Error writing attribute (orientation angle)");
         error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        status = ERROR;
+    }
+    else
+    {
+        attr.type = DFNT_CHAR8;
+        attr.nval = struct_meta.len;
+        attr.name = OUTPUT_STRUCT_METADATA;
+        if (put_attr_string (hdf_file_id, &attr, struct_meta.str) != SUCCESS)
+        {
+            sprintf (errmsg, "Error writing attribute (struct_meta)");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (write_hdf_eos_grids (hdf_id, hdf_file_id, xml_metadata,
+            ngrids, grid) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the grids");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
     }
 
-    return (SUCCESS);
+    free_meta_buf (&struct_meta);
+    free (grid);
+    free (processed);
+    return (status);
 }
-
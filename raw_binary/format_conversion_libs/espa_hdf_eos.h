@@ -35,20 +35,51 @@ NOTES:
 #define SPHERE_GRS80 8
 #define SPHERE_WGS84 12
 
-/* size of the metadata string for defining the HDF-EOS metadata */
+/* size of the temporary buffer for each piece of the HDF-EOS metadata */
 #define ESPA_MAX_METADATA_SIZE 10240
 
+/* initial size of the structural metadata buffer: room for the grid
+   definitions, plus the DataField object of each band */
+#define ESPA_META_HEADER_SIZE 4096
+#define ESPA_META_FIELD_SIZE 192
+
+/* Type definitions */
+/* Growable buffer for building the metadata string */
+typedef struct
+{
+    char *str;       /* null-terminated metadata string */
+    size_t len;      /* length of the string */
+    size_t size;     /* allocated size of str, in bytes */
+} Espa_meta_buf_t;
+
 /* Prototypes */
+bool init_meta_buf
+(
+    Espa_meta_buf_t *meta,  /* O: metadata buffer */
+    size_t size             /* I: initial size of the buffer, in bytes */
+);
+
+void free_meta_buf
+(
+    Espa_meta_buf_t *meta   /* I/O: metadata buffer */
+);
+
 bool append_meta
 (
-    char *cbuf,  /* I/O: input metadata buffer */
-    int *ic,     /* I/O: index of current location in metadata buffer */
-    char *str    /* I: string to append to the metadata buffer */
+    Espa_meta_buf_t *meta,  /* I/O: metadata buffer */
+    const char *str         /* I: string to append to the metadata buffer */
+);
+
+bool append_meta_int
+(
+    Espa_meta_buf_t *meta,  /* I/O: metadata buffer */
+    int value               /* I: value to append to the metadata buffer */
 );
 
 int write_hdf_eos_attr
 (
-    char *hdf_file,            /* I: HDF file to write attributes to */
+    int32 hdf_id,              /* I: HDF file ID with Vgroup access started */
+    int32 hdf_file_id,         /* I: SD interface ID of the HDF file */
     Espa_internal_meta_t *xml_metadata  /* I: XML metadata structure */
 );
 
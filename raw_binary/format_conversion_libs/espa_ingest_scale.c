@@ -0,0 +1,366 @@
+/*****************************************************************************
+FILE: espa_ingest_scale.c
+
+PURPOSE: Contains functions for writing the bands of an ingested product as
+physical values rather than digital numbers.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The pixels are scaled by the conversion kernels of raw_binary_convert.h,
+     so the scaling is done as the blocks of a band are converted, without
+     another pass over the band.
+*****************************************************************************/
+#include <math.h>
+#include <string.h>
+#include "espa_ingest_scale.h"
+#include "raw_binary_io.h"
+#include "raw_binary_convert.h"
+
+/* Scaling requested via INGEST_SCALE_ENV */
+typedef struct
+{
+    enum Espa_data_type out_type;  /* data type of the scaled bands */
+    float out_scale;             /* scale factor of the scaled bands; 1 for
+                                    float32 */
+} Ingest_scale_opts_t;
+
+
+/******************************************************************************
+MODULE:  get_ingest_scale_opts
+
+PURPOSE: Gets the scaling of the ingested bands from the ESPA_INGEST_SCALE
+environment variable.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The environment variable has an unknown value
+SUCCESS         The scaling was read
+
+NOTES:
+  1. use_scale is false if the variable isn't set, or is "no" or "off".
+******************************************************************************/
+static int get_ingest_scale_opts
+(
+    bool *use_scale,             /* O: are the bands scaled? */
+    Ingest_scale_opts_t *opts    /* O: scaling of the bands */
+)
+{
+    char FUNC_NAME[] = "get_ingest_scale_opts";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *mode = getenv (INGEST_SCALE_ENV);  /* requested scaling */
+    float out_scale;             /* requested int16 scale factor */
+
+    *use_scale = false;
+    if (mode == NULL || *mode == '\0' || !strcmp (mode, "no") ||
+        !strcmp (mode, "off"))
+        return (SUCCESS);
+
+    if (!strcmp (mode, "float32"))
+    {
+        opts->out_type = ESPA_FLOAT32;
+        opts->out_scale = 1.0;
+    }
+    else if (!strcmp (mode, "int16"))
+    {
+        opts->out_type = ESPA_INT16;
+        opts->out_scale = INGEST_SCALE_DEFAULT_INT16;
+    }
+    else if (sscanf (mode, "int16:%f", &out_scale) == 1 && out_scale > 0.0)
+    {
+        opts->out_type = ESPA_INT16;
+        opts->out_scale = out_scale;
+    }
+    else
+    {
+        sprintf (errmsg, "Invalid %s value %s; expected float32, int16 or "
+            "int16:<scale>", INGEST_SCALE_ENV, mode);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *use_scale = true;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  scale_ingest_range
+
+PURPOSE: Scales a value of the valid range of a band to the values written.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+value           The scaled value, rounded and limited to int16 for the int16
+                bands
+
+NOTES:
+******************************************************************************/
+static float scale_ingest_range
+(
+    const Ingest_band_scale_t *scale,  /* I: scaling of the band */
+    float value                  /* I: digital number */
+)
+{
+    double scaled = (double) value * scale->scale + scale->offset;
+                                 /* scaled value */
+
+    if (scale->out_type != ESPA_INT16)
+        return (scaled);
+
+    scaled = rint (scaled);
+    if (scaled < -32768.0)
+        scaled = -32768.0;
+    if (scaled > 32767.0)
+        scaled = 32767.0;
+    return (scaled);
+}
+
+
+/******************************************************************************
+MODULE:  init_ingest_scale
+
+PURPOSE: Sets up the scaling of the bands of an ingested product, and updates
+the metadata of the scaled bands to describe the values written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the requested scaling or allocating memory
+SUCCESS         The scaling was set up
+
+NOTES:
+  1. Call before the XML file is written and the bands are converted.  The
+     converters read the digital numbers as scales[i].in_type for the
+     scaled bands, since xml_metadata then has the type written.
+  2. The physical values are digital number * a + c, for the scale factor
+     and offset or the radiance gain and bias of the band.  The values
+     written are the physical values / s, for the scale factor s of the
+     int16 bands (1 for float32).  The radiance and reflectance gains and
+     biases of the band are changed to apply to the values written, so
+     gain * s / a and bias - gain * c / a.
+******************************************************************************/
+int init_ingest_scale
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the ingested
+                                       product; the scaled bands are updated
+                                       to describe the values written */
+    Ingest_band_scale_t **scales  /* O: scaling of each band; NULL if the
+                                       bands aren't scaled, and otherwise
+                                       must be freed by the caller */
+)
+{
+    char FUNC_NAME[] = "init_ingest_scale";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    bool use_scale;              /* are the bands scaled? */
+    bool use_radiance;           /* is the physical value the radiance? */
+    Ingest_scale_opts_t opts;    /* requested scaling */
+    Ingest_band_scale_t *scale;  /* scaling of the current band */
+    Espa_band_meta_t *bmeta;     /* metadata of the current band */
+    double gain;                 /* scale from the digital numbers to the
+                                    physical values */
+    double bias;                 /* offset from the digital numbers to the
+                                    physical values */
+    float range;                 /* swapped valid range value */
+    int i;                       /* looping variable for the bands */
+
+    *scales = NULL;
+    if (get_ingest_scale_opts (&use_scale, &opts) != SUCCESS)
+        return (ERROR);
+    if (!use_scale || xml_metadata->nbands <= 0)
+        return (SUCCESS);
+
+    *scales = calloc (xml_metadata->nbands, sizeof (Ingest_band_scale_t));
+    if (*scales == NULL)
+    {
+        sprintf (errmsg, "Allocating the scaling of %d bands",
+            xml_metadata->nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        bmeta = &xml_metadata->band[i];
+        scale = &(*scales)[i];
+
+        /* Only the integer bands with physical values are scaled */
+        if (!strcmp (bmeta->category, "qa") ||
+            bmeta->data_type == ESPA_FLOAT32 ||
+            bmeta->data_type == ESPA_FLOAT64)
+            continue;
+        use_radiance = false;
+        if (bmeta->scale_factor != ESPA_FLOAT_META_FILL &&
+            (bmeta->scale_factor != 1.0 ||
+             (bmeta->add_offset != ESPA_FLOAT_META_FILL &&
+              bmeta->add_offset != 0.0)))
+        {
+            gain = bmeta->scale_factor;
+            bias = (bmeta->add_offset != ESPA_FLOAT_META_FILL) ?
+                bmeta->add_offset : 0.0;
+        }
+        else if (bmeta->rad_gain != ESPA_FLOAT_META_FILL &&
+            bmeta->rad_gain != 0.0)
+        {
+            gain = bmeta->rad_gain;
+            bias = (bmeta->rad_bias != ESPA_FLOAT_META_FILL) ?
+                bmeta->rad_bias : 0.0;
+            use_radiance = true;
+        }
+        else
+            continue;
+
+        scale->active = true;
+        scale->in_type = bmeta->data_type;
+        scale->in_nbytes = get_data_type_size (bmeta->data_type);
+        scale->out_type = opts.out_type;
+        scale->out_nbytes = get_data_type_size (opts.out_type);
+        scale->scale = gain / opts.out_scale;
+        scale->offset = bias / opts.out_scale;
+        scale->has_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+        scale->fill_value = bmeta->fill_value;
+
+        /* Describe the values written */
+        if (bmeta->valid_range[0] != ESPA_FLOAT_META_FILL &&
+            bmeta->valid_range[1] != ESPA_FLOAT_META_FILL)
+        {
+            bmeta->valid_range[0] = scale_ingest_range (scale,
+                bmeta->valid_range[0]);
+            bmeta->valid_range[1] = scale_ingest_range (scale,
+                bmeta->valid_range[1]);
+            if (bmeta->valid_range[0] > bmeta->valid_range[1])
+            {
+                range = bmeta->valid_range[0];
+                bmeta->valid_range[0] = bmeta->valid_range[1];
+                bmeta->valid_range[1] = range;
+            }
+        }
+        if (bmeta->rad_gain != ESPA_FLOAT_META_FILL)
+        {
+            if (bmeta->rad_bias != ESPA_FLOAT_META_FILL)
+                bmeta->rad_bias -= bmeta->rad_gain * bias / gain;
+            bmeta->rad_gain *= opts.out_scale / gain;
+        }
+        if (bmeta->refl_gain != ESPA_FLOAT_META_FILL)
+        {
+            if (bmeta->refl_bias != ESPA_FLOAT_META_FILL)
+                bmeta->refl_bias -= bmeta->refl_gain * bias / gain;
+            bmeta->refl_gain *= opts.out_scale / gain;
+        }
+        bmeta->data_type = opts.out_type;
+        bmeta->fill_value = INGEST_SCALE_FILL;
+        bmeta->saturate_value = ESPA_INT_META_FILL;
+        bmeta->scale_factor = (opts.out_type == ESPA_FLOAT32) ?
+            ESPA_FLOAT_META_FILL : opts.out_scale;
+        bmeta->add_offset = ESPA_FLOAT_META_FILL;
+        if (use_radiance)
+            strcpy (bmeta->data_units, "radiance (W/(m^2 sr um))");
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_ingest_band_scale
+
+PURPOSE: Gets the scaling of a band, for the converters.
+
+RETURN VALUE:
+Type = const Ingest_band_scale_t *
+Value           Description
+-----           -----------
+NULL            The band isn't scaled
+non-NULL        Scaling of the band
+
+NOTES:
+******************************************************************************/
+const Ingest_band_scale_t *get_ingest_band_scale
+(
+    const Ingest_band_scale_t *scales,  /* I: scaling of each band, from
+                                        init_ingest_scale (may be NULL) */
+    int band                      /* I: index of the band */
+)
+{
+    if (scales == NULL || !scales[band].active)
+        return (NULL);
+    return (&scales[band]);
+}
+
+
+/******************************************************************************
+MODULE:  apply_ingest_scale
+
+PURPOSE: Scales a block of digital numbers of a band to the values written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error scaling the pixels
+SUCCESS         The pixels were scaled
+
+NOTES:
+  1. The fill pixels are written as INGEST_SCALE_FILL.  The int16 values
+     are rounded and saturate to the int16 range (see raw_binary_convert.h),
+     staged as float32 INGEST_SCALE_CHUNK pixels at a time.
+******************************************************************************/
+int apply_ingest_scale
+(
+    const Ingest_band_scale_t *scale,  /* I: scaling of the band */
+    const void *in,               /* I: digital numbers read */
+    size_t npix,                  /* I: number of pixels */
+    void *out                     /* O: values to be written, of
+                                        scale->out_type */
+)
+{
+    char FUNC_NAME[] = "apply_ingest_scale";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    float stage[INGEST_SCALE_CHUNK];  /* physical values of a chunk */
+    size_t first;                /* first pixel of the chunk */
+    size_t nchunk;               /* number of pixels in the chunk */
+
+    if (scale->out_type == ESPA_FLOAT32)
+    {
+        if (scale_raw_binary_pixels (in, scale->in_type, npix, scale->scale,
+            scale->offset, scale->has_fill, scale->fill_value,
+            INGEST_SCALE_FILL, out) != SUCCESS)
+        {
+            sprintf (errmsg, "Scaling %zu pixels", npix);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+
+    for (first = 0; first < npix; first += nchunk)
+    {
+        nchunk = npix - first;
+        if (nchunk > INGEST_SCALE_CHUNK)
+            nchunk = INGEST_SCALE_CHUNK;
+
+        if (scale_raw_binary_pixels ((const char *) in +
+            first * scale->in_nbytes, scale->in_type, nchunk, scale->scale,
+            scale->offset, scale->has_fill, scale->fill_value,
+            INGEST_SCALE_FILL, stage) != SUCCESS ||
+            convert_raw_binary_pixels (stage, ESPA_FLOAT32, nchunk,
+            scale->out_type, (char *) out + first * scale->out_nbytes) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Scaling pixels %zu-%zu", first,
+                first + nchunk - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
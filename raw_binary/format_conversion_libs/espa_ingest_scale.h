@@ -0,0 +1,98 @@
+/*****************************************************************************
+FILE: espa_ingest_scale.h
+
+PURPOSE: Contains defines, structures and prototypes for writing the bands
+of an ingested product as physical values rather than digital numbers.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The scaling is selected via the ESPA_INGEST_SCALE environment variable:
+     "float32" writes the physical values as float32, and "int16" or
+     "int16:<scale>" writes them as int16 with the given scale factor
+     (INGEST_SCALE_DEFAULT_INT16 if none).  It's off by default, and the
+     bands are then written as the digital numbers of the input product.
+  2. The physical values of a band are digital number * scale_factor +
+     add_offset if the input product gives a scale factor, or else the TOA
+     radiance (digital number * rad_gain + rad_bias).  The QA bands, the
+     floating point bands and the bands with neither are left as they are.
+  3. The scaled bands have a fill value of INGEST_SCALE_FILL and no
+     saturation value, since the saturated digital numbers are no longer
+     known.  Their radiance and reflectance gains and biases apply to the
+     stored values, but the Level-1 tools (such as create_toa_bands) expect
+     digital numbers, so the scaling is for products handed straight to
+     consumers of the physical values.
+*****************************************************************************/
+
+#ifndef ESPA_INGEST_SCALE_H
+#define ESPA_INGEST_SCALE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Environment variable selecting the scaling of the ingested bands */
+#define INGEST_SCALE_ENV "ESPA_INGEST_SCALE"
+
+/* Fill value of the scaled bands */
+#define INGEST_SCALE_FILL -9999
+
+/* Scale factor of the int16 bands if none is given */
+#define INGEST_SCALE_DEFAULT_INT16 0.0001
+
+/* Number of pixels staged as float32 at a time for the int16 bands */
+#define INGEST_SCALE_CHUNK 4096
+
+/* Type definitions */
+/* Scaling of one band, from the digital numbers read to the values
+   written */
+typedef struct
+{
+    bool active;                 /* is the band scaled? */
+    enum Espa_data_type in_type; /* data type of the digital numbers */
+    int in_nbytes;               /* number of bytes per digital number */
+    enum Espa_data_type out_type;  /* data type of the values written */
+    int out_nbytes;              /* number of bytes per value written */
+    float scale;                 /* scale from the digital numbers to the
+                                    values written */
+    float offset;                /* offset from the digital numbers to the
+                                    values written */
+    bool has_fill;               /* do the digital numbers have a fill
+                                    value? */
+    long fill_value;             /* fill value of the digital numbers */
+} Ingest_band_scale_t;
+
+/* Prototypes */
+int init_ingest_scale
+(
+    Espa_internal_meta_t *xml_metadata, /* I/O: metadata of the ingested
+                                       product; the scaled bands are updated
+                                       to describe the values written */
+    Ingest_band_scale_t **scales  /* O: scaling of each band; NULL if the
+                                       bands aren't scaled, and otherwise
+                                       must be freed by the caller */
+);
+
+const Ingest_band_scale_t *get_ingest_band_scale
+(
+    const Ingest_band_scale_t *scales,  /* I: scaling of each band, from
+                                        init_ingest_scale (may be NULL) */
+    int band                      /* I: index of the band */
+);
+
+int apply_ingest_scale
+(
+    const Ingest_band_scale_t *scale,  /* I: scaling of the band */
+    const void *in,               /* I: digital numbers read */
+    size_t npix,                  /* I: number of pixels */
+    void *out                     /* O: values to be written, of
+                                        scale->out_type */
+);
+
+#endif
@@ -0,0 +1,1473 @@
+/*****************************************************************************
+FILE: espa_mosaic.c
+
+PURPOSE: Contains functions for mosaicking the bands of several scenes onto
+the grid of a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The tiles of each strip of the output are composited concurrently by
+     the task pool (see espa_task.h).  A tile only visits the scenes whose
+     footprint overlaps it, in priority order, and stops once every pixel
+     has a value.
+  3. Each runner keeps up to MOSAIC_MAX_OPEN band files open across tiles
+     and bands, so mosaics of many scenes don't run out of file handles or
+     reopen the same files for every tile.
+*****************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "espa_mosaic.h"
+#include "espa_memory.h"
+#include "espa_task.h"
+#include "raw_binary_pool.h"
+
+/* Input scene of the mosaic */
+typedef struct
+{
+    char *xml_file;              /* input XML file of the scene */
+    char dir[STR_SIZE];          /* directory of the XML file */
+    int order;                   /* position of the scene in the input list */
+    Espa_internal_meta_t meta;   /* metadata of the scene */
+    Geoloc_t *space;             /* geolocation of the scene */
+    int line0;                   /* first output line of the footprint */
+    int samp0;                   /* first output sample of the footprint */
+    int line1;                   /* output line after the footprint */
+    int samp1;                   /* output sample after the footprint */
+    int qa_band;                 /* index of the QA band; -1 if none */
+    Reproj_band_t qa;            /* QA band, resampled by nearest neighbor */
+} Mosaic_scene_t;
+
+/* Band file kept open by a runner */
+typedef struct
+{
+    int scene;                   /* scene of the band */
+    int band;                    /* index of the band in the scene */
+    FILE *fp;                    /* band file; NULL if the slot is unused */
+    unsigned long last_use;      /* use count when last used */
+} Mosaic_handle_t;
+
+/* Resources of a runner of the task pool */
+typedef struct
+{
+    Mosaic_handle_t handle[MOSAIC_MAX_OPEN];  /* open band files */
+    unsigned long nuses;         /* number of band file uses so far */
+    Reproj_window_t window;      /* input window of the current scene */
+    Reproj_window_t qa_window;   /* QA window of the current scene */
+    float *in_line;              /* input line of each tile pixel */
+    float *in_samp;              /* input sample of each tile pixel */
+    void *tile;                  /* resampled pixels of the current scene */
+    void *qa_tile;               /* resampled QA of the current scene */
+    unsigned char *done;         /* has each tile pixel been set? */
+    int ndone;                   /* number of tile pixels set */
+} Mosaic_runner_t;
+
+/* Band being mosaicked, a strip of tiles at a time */
+typedef struct
+{
+    Mosaic_scene_t *scene;       /* input scenes in priority order */
+    int nscenes;                 /* number of input scenes */
+    Mosaic_options_t *opts;      /* options of the mosaic */
+    Geoloc_t *out_space;         /* geolocation of the output grid */
+    Reproj_band_t *band;         /* band of each scene; bmeta is NULL if the
+                                    scene doesn't have the band */
+    int *band_index;             /* index of the band in each scene */
+    int size;                    /* number of bytes per pixel */
+    unsigned char fill[8];       /* output fill pixel */
+    int strip_line0;             /* first output line of the strip */
+    int strip_nlines;            /* number of lines in the strip */
+    int out_nsamps;              /* number of samples in the output */
+    void *strip;                 /* output pixels of the strip */
+    Mosaic_runner_t *runner;     /* resources of each runner */
+} Mosaic_job_t;
+
+
+/******************************************************************************
+MODULE:  compare_latest
+
+PURPOSE: Orders the scenes by acquisition, latest first; the qsort compare
+function of MOSAIC_LATEST and MOSAIC_QA.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+<0, 0, >0       The first scene comes before, with, or after the second
+
+NOTES:
+  1. Scenes acquired at the same time keep the order of the input list.
+******************************************************************************/
+static int compare_latest
+(
+    const void *a,           /* I: first scene */
+    const void *b            /* I: second scene */
+)
+{
+    const Mosaic_scene_t *sa = a;  /* first scene */
+    const Mosaic_scene_t *sb = b;  /* second scene */
+    int cmp;                 /* comparison of the acquisitions */
+
+    cmp = strcmp (sb->meta.global.acquisition_date,
+        sa->meta.global.acquisition_date);
+    if (cmp == 0)
+        cmp = strcmp (sb->meta.global.scene_center_time,
+            sa->meta.global.scene_center_time);
+    if (cmp == 0)
+        cmp = sa->order - sb->order;
+    return (cmp);
+}
+
+
+/******************************************************************************
+MODULE:  compare_zenith
+
+PURPOSE: Orders the scenes by solar zenith angle, lowest first; the qsort
+compare function of MOSAIC_ZENITH.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+<0, 0, >0       The first scene comes before, with, or after the second
+
+NOTES:
+  1. Scenes with the same solar zenith angle are ordered by acquisition.
+******************************************************************************/
+static int compare_zenith
+(
+    const void *a,           /* I: first scene */
+    const void *b            /* I: second scene */
+)
+{
+    const Mosaic_scene_t *sa = a;  /* first scene */
+    const Mosaic_scene_t *sb = b;  /* second scene */
+
+    if (sa->meta.global.solar_zenith < sb->meta.global.solar_zenith)
+        return (-1);
+    if (sa->meta.global.solar_zenith > sb->meta.global.solar_zenith)
+        return (1);
+    return (compare_latest (a, b));
+}
+
+
+/******************************************************************************
+MODULE:  get_pixel_value
+
+PURPOSE: Returns a pixel of a buffer in the band's data type as a double.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+value           Value of the pixel
+
+NOTES:
+******************************************************************************/
+static double get_pixel_value
+(
+    enum Espa_data_type data_type,  /* I: data type of the buffer */
+    const void *buf,         /* I: buffer of pixels */
+    size_t indx              /* I: index of the pixel */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            return (((const int8_t *) buf)[indx]);
+        case ESPA_UINT8:
+            return (((const uint8_t *) buf)[indx]);
+        case ESPA_INT16:
+            return (((const int16_t *) buf)[indx]);
+        case ESPA_UINT16:
+            return (((const uint16_t *) buf)[indx]);
+        case ESPA_INT32:
+            return (((const int32_t *) buf)[indx]);
+        case ESPA_UINT32:
+            return (((const uint32_t *) buf)[indx]);
+        case ESPA_FLOAT32:
+            return (((const float *) buf)[indx]);
+        case ESPA_FLOAT64:
+            return (((const double *) buf)[indx]);
+    }
+
+    return (0.0);
+}
+
+
+/******************************************************************************
+MODULE:  set_fill_pixel
+
+PURPOSE: Converts the fill value of an output band to a pixel in the band's
+data type.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void set_fill_pixel
+(
+    enum Espa_data_type data_type,  /* I: data type of the band */
+    int fill_value,          /* I: fill value of the band */
+    unsigned char *fill      /* O: fill pixel; 8 bytes */
+)
+{
+    memset (fill, 0, 8);
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            *(int8_t *) fill = fill_value;
+            break;
+        case ESPA_UINT8:
+            *(uint8_t *) fill = fill_value;
+            break;
+        case ESPA_INT16:
+            *(int16_t *) fill = fill_value;
+            break;
+        case ESPA_UINT16:
+            *(uint16_t *) fill = fill_value;
+            break;
+        case ESPA_INT32:
+            *(int32_t *) fill = fill_value;
+            break;
+        case ESPA_UINT32:
+            *(uint32_t *) fill = fill_value;
+            break;
+        case ESPA_FLOAT32:
+            *(float *) fill = fill_value;
+            break;
+        case ESPA_FLOAT64:
+            *(double *) fill = fill_value;
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  get_band_handle
+
+PURPOSE: Returns the open file of a band of a scene, opening it in place of
+the least recently used file of the runner if needed.
+
+RETURN VALUE:
+Type = FILE *
+Value           Description
+-----           -----------
+NULL            Error opening the band file
+non-NULL        Band file
+
+NOTES:
+******************************************************************************/
+static FILE *get_band_handle
+(
+    Mosaic_scene_t *scene,   /* I: scene of the band */
+    int scene_num,           /* I: number of the scene */
+    int band_num,            /* I: index of the band in the scene */
+    Mosaic_runner_t *run     /* I/O: resources of the runner */
+)
+{
+    char FUNC_NAME[] = "get_band_handle";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char band_file[STR_SIZE];  /* band filename */
+    char *file_name = scene->meta.band[band_num].file_name;
+                             /* band filename in the metadata */
+    int count;               /* number of chars copied in snprintf */
+    int i;                   /* looping variable for the open files */
+    int slot = 0;            /* slot the band file is opened in */
+    Mosaic_handle_t *handle = run->handle;  /* open band files */
+
+    for (i = 0; i < MOSAIC_MAX_OPEN; i++)
+    {
+        if (handle[i].fp != NULL && handle[i].scene == scene_num &&
+            handle[i].band == band_num)
+        {
+            handle[i].last_use = ++run->nuses;
+            return (handle[i].fp);
+        }
+
+        /* Use an unused slot, or else the least recently used one */
+        if (handle[slot].fp != NULL && (handle[i].fp == NULL ||
+            handle[i].last_use < handle[slot].last_use))
+            slot = i;
+    }
+
+    if (handle[slot].fp != NULL)
+        close_raw_binary (handle[slot].fp);
+    handle[slot].fp = NULL;
+
+    if (file_name[0] == '/')
+        count = snprintf (band_file, sizeof (band_file), "%s", file_name);
+    else
+        count = snprintf (band_file, sizeof (band_file), "%s/%s",
+            scene->dir, file_name);
+    if (count < 0 || count >= sizeof (band_file))
+    {
+        sprintf (errmsg, "Overflow of band_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    handle[slot].fp = open_raw_binary (band_file, "rb");
+    if (handle[slot].fp == NULL)
+    {
+        sprintf (errmsg, "Opening the input band file: %s", band_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    handle[slot].scene = scene_num;
+    handle[slot].band = band_num;
+    handle[slot].last_use = ++run->nuses;
+
+    return (handle[slot].fp);
+}
+
+
+/******************************************************************************
+MODULE:  read_scene_part
+
+PURPOSE: Reads the window of a band of a scene for part of a tile and
+resamples it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the band
+SUCCESS         Successfully resampled the part
+
+NOTES:
+******************************************************************************/
+static int read_scene_part
+(
+    Mosaic_scene_t *scene,   /* I: scene of the band */
+    int scene_num,           /* I: number of the scene */
+    int band_num,            /* I: index of the band in the scene */
+    Reproj_band_t *band,     /* I: band being resampled */
+    Reproj_window_t *window, /* I/O: window of the band for the part */
+    Mosaic_runner_t *run,    /* I/O: resources of the runner */
+    int nlines,              /* I: number of lines in the part */
+    int nsamps,              /* I: number of samples in the part */
+    const float *in_line,    /* I: input line of each pixel of the part */
+    const float *in_samp,    /* I: input sample of each pixel of the part */
+    int stride,              /* I: number of pixels between the lines of the
+                                   part */
+    void *out                /* O: resampled pixels of the part */
+)
+{
+    FILE *fp = NULL;         /* band file */
+
+    if (window->nlines > 0)
+    {
+        fp = get_band_handle (scene, scene_num, band_num, run);
+        if (fp == NULL)
+            return (ERROR);
+
+        if (read_reproject_window (fp, band, window) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
+    resample_reproject_tile (band, window, nlines, nsamps, in_line, in_samp,
+        stride, out, stride);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  composite_part
+
+PURPOSE: Sets the pixels of part of a tile not set yet from the valid pixels
+of a scene, splitting the part in two while its window of the scene is
+larger than REPROJ_MAX_WINDOW.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the scene
+SUCCESS         Successfully composited the part
+
+NOTES:
+  1. With clear_only, a pixel is only used if the QA band of the scene, if
+     it has one, has none of the QA mask bits set.
+******************************************************************************/
+static int composite_part
+(
+    Mosaic_job_t *job,       /* I: band being mosaicked */
+    Mosaic_runner_t *run,    /* I/O: resources of the runner */
+    int scene_num,           /* I: number of the scene */
+    bool clear_only,         /* I: only use pixels whose QA is clear? */
+    int samp0,               /* I: first output sample of the tile */
+    int tile_nsamps,         /* I: number of samples in the tile */
+    int part_line,           /* I: first line of the part in the tile */
+    int part_samp,           /* I: first sample of the part in the tile */
+    int nlines,              /* I: number of lines in the part */
+    int nsamps               /* I: number of samples in the part */
+)
+{
+    Mosaic_scene_t *scene = &job->scene[scene_num];  /* scene */
+    Reproj_band_t *band = &job->band[scene_num];  /* band of the scene */
+    bool use_qa;             /* check the QA of the pixels? */
+    int half;                /* size of the first half of a split part */
+    int line, samp;          /* current line and sample in the part */
+    size_t indx;             /* index of the pixel in the tile */
+    size_t part = (size_t) part_line * tile_nsamps + part_samp;
+                             /* index of the part in the tile */
+    double y, x;             /* location in the band */
+    double fill = band->bmeta->fill_value;  /* fill value of the band */
+    float *in_line = &run->in_line[part];   /* input lines of the part */
+    float *in_samp = &run->in_samp[part];   /* input samples of the part */
+    unsigned long qa;        /* QA of the pixel */
+
+    use_qa = clear_only && scene->qa_band >= 0;
+    if (!get_reproject_window (band, nlines, nsamps, in_line, in_samp,
+        tile_nsamps, &run->window))
+        return (SUCCESS);
+    if (use_qa)
+        get_reproject_window (&scene->qa, nlines, nsamps, in_line, in_samp,
+            tile_nsamps, &run->qa_window);
+
+    /* Split parts with large windows */
+    if (nlines * nsamps > 1 &&
+        ((size_t) run->window.nlines * run->window.nsamps > REPROJ_MAX_WINDOW
+        || (use_qa && (size_t) run->qa_window.nlines *
+        run->qa_window.nsamps > REPROJ_MAX_WINDOW)))
+    {
+        if (nlines >= nsamps)
+        {
+            half = nlines / 2;
+            if (composite_part (job, run, scene_num, clear_only, samp0,
+                tile_nsamps, part_line, part_samp, half, nsamps) != SUCCESS)
+                return (ERROR);
+            return (composite_part (job, run, scene_num, clear_only, samp0,
+                tile_nsamps, part_line + half, part_samp, nlines - half,
+                nsamps));
+        }
+
+        half = nsamps / 2;
+        if (composite_part (job, run, scene_num, clear_only, samp0,
+            tile_nsamps, part_line, part_samp, nlines, half) != SUCCESS)
+            return (ERROR);
+        return (composite_part (job, run, scene_num, clear_only, samp0,
+            tile_nsamps, part_line, part_samp + half, nlines,
+            nsamps - half));
+    }
+
+    /* Resample the band, and the QA band if needed */
+    if (read_scene_part (scene, scene_num, job->band_index[scene_num], band,
+        &run->window, run, nlines, nsamps, in_line, in_samp, tile_nsamps,
+        (char *) run->tile + part * band->size) != SUCCESS)
+        return (ERROR);
+    if (use_qa && read_scene_part (scene, scene_num, scene->qa_band,
+        &scene->qa, &run->qa_window, run, nlines, nsamps, in_line, in_samp,
+        tile_nsamps, (char *) run->qa_tile + part * scene->qa.size) !=
+        SUCCESS)
+        return (ERROR);
+
+    /* Set the pixels not set yet from the valid pixels of the scene */
+    for (line = 0; line < nlines; line++)
+    {
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            indx = part + (size_t) line * tile_nsamps + samp;
+            if (run->done[indx] || !get_reproject_location (band,
+                run->in_line[indx], run->in_samp[indx], &y, &x))
+                continue;
+
+            if (band->has_fill && fabs (get_pixel_value
+                (band->bmeta->data_type, run->tile, indx) - fill) <
+                ESPA_EPSILON)
+                continue;
+
+            if (use_qa)
+            {
+                if (!get_reproject_location (&scene->qa, run->in_line[indx],
+                    run->in_samp[indx], &y, &x))
+                    continue;
+                qa = (unsigned long) get_pixel_value
+                    (scene->qa.bmeta->data_type, run->qa_tile, indx);
+                if (qa & job->opts->qa_mask)
+                    continue;
+            }
+
+            memcpy ((char *) job->strip + ((size_t) (part_line + line) *
+                job->out_nsamps + samp0 + part_samp + samp) * job->size,
+                (char *) run->tile + indx * job->size, job->size);
+            run->done[indx] = 1;
+            run->ndone++;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_tile_range
+
+PURPOSE: Composites a chunk of the tiles of a strip; the chunk function of the
+task pool.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compositing a tile
+SUCCESS         Successfully composited the tiles
+
+NOTES:
+  1. With the QA priority, the first pass uses the clear pixels of the
+     scenes, and the second pass fills the remaining pixels from the scenes
+     with a QA band.
+******************************************************************************/
+static int mosaic_tile_range
+(
+    void *arg,            /* I: band being mosaicked (Mosaic_job_t *) */
+    int first,            /* I: first tile of the chunk */
+    int end,              /* I: tile after the last one of the chunk */
+    int runner            /* I: number of the runner */
+)
+{
+    Mosaic_job_t *job = arg;  /* band being mosaicked */
+    Mosaic_runner_t *run = &job->runner[runner];  /* runner resources */
+    Mosaic_scene_t *scene = NULL;  /* current scene */
+    int tile;             /* looping variable for the tiles */
+    int samp0;            /* first sample of the tile */
+    int nsamps;           /* number of samples in the tile */
+    int nlines = job->strip_nlines;  /* number of lines in the tile */
+    int npasses;          /* number of passes over the scenes */
+    int pass;             /* looping variable for the passes */
+    int line;             /* looping variable for the tile lines */
+    int samp;             /* looping variable for the tile samples */
+    int i;                /* looping variable for the scenes */
+    char *out = NULL;     /* output pixel of the tile in the strip */
+
+    npasses = (job->opts->priority == MOSAIC_QA) ? 2 : 1;
+    for (tile = first; tile < end; tile++)
+    {
+        samp0 = tile * REPROJ_TILE_SIZE;
+        nsamps = min (REPROJ_TILE_SIZE, job->out_nsamps - samp0);
+
+        /* Start with fill */
+        for (line = 0; line < nlines; line++)
+        {
+            out = (char *) job->strip + ((size_t) line * job->out_nsamps +
+                samp0) * job->size;
+            for (samp = 0; samp < nsamps; samp++, out += job->size)
+                memcpy (out, job->fill, job->size);
+        }
+        memset (run->done, 0, (size_t) nlines * nsamps);
+        run->ndone = 0;
+
+        for (pass = 0; pass < npasses; pass++)
+        {
+            for (i = 0; i < job->nscenes && run->ndone < nlines * nsamps;
+                i++)
+            {
+                scene = &job->scene[i];
+                if (job->band[i].bmeta == NULL ||
+                    (pass > 0 && scene->qa_band < 0) ||
+                    scene->line1 <= job->strip_line0 ||
+                    scene->line0 >= job->strip_line0 + nlines ||
+                    scene->samp1 <= samp0 || scene->samp0 >= samp0 + nsamps)
+                    continue;
+
+                if (map_reproject_tile (job->out_space, scene->space,
+                    job->strip_line0, samp0, nlines, nsamps, run->in_line,
+                    run->in_samp) != SUCCESS)
+                    return (ERROR);
+
+                if (composite_part (job, run, i, pass == 0 && npasses > 1,
+                    samp0, nsamps, 0, 0, nlines, nsamps) != SUCCESS)
+                    return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_part_lines
+
+PURPOSE: Finds the output lines of a part of the mosaic.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The strips of the output are split evenly across the parts, so every
+     part starts at the beginning of a strip.  A mosaic which isn't split
+     has a single part with all the lines.
+******************************************************************************/
+static void get_part_lines
+(
+    Mosaic_options_t *opts,  /* I: options of the mosaic */
+    int part,                /* I: part of the mosaic */
+    int out_nlines,          /* I: number of lines in the output */
+    int *line0,              /* O: first line of the part */
+    int *line1               /* O: line after the last line of the part */
+)
+{
+    long nstrips;            /* number of strips in the output */
+
+    if (opts->nparts <= 1)
+    {
+        *line0 = 0;
+        *line1 = out_nlines;
+        return;
+    }
+
+    nstrips = (out_nlines + REPROJ_TILE_SIZE - 1) / REPROJ_TILE_SIZE;
+    *line0 = (int) (part * nstrips / opts->nparts) * REPROJ_TILE_SIZE;
+    *line1 = (int) min ((part + 1) * nstrips / opts->nparts *
+        REPROJ_TILE_SIZE, out_nlines);
+}
+
+
+/******************************************************************************
+MODULE:  get_part_file
+
+PURPOSE: Names the file of a part of an output band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The part filename is too long
+SUCCESS         Successfully named the part file
+
+NOTES:
+  1. The part file is the output band file with .part and the number of the
+     part appended.
+******************************************************************************/
+static int get_part_file
+(
+    char *out_file,          /* I: output band file */
+    int part,                /* I: part of the mosaic */
+    char *part_file          /* O: part file; STR_SIZE characters */
+)
+{
+    char FUNC_NAME[] = "get_part_file";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int count;                   /* number of chars copied in snprintf */
+
+    count = snprintf (part_file, STR_SIZE, "%s.part%04d", out_file, part);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of part_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  gather_parts
+
+PURPOSE: Writes the parts of a band, written earlier, to the output band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading a part or writing the output band
+SUCCESS         Successfully gathered the parts
+
+NOTES:
+  1. Each part has to be complete, so a part whose worker failed is
+     reported rather than leaving a hole in the output band.
+  2. The lines are copied a strip at a time through the strip buffer, and
+     the output band is checkpointed after each strip, as when it's
+     composited.
+******************************************************************************/
+static int gather_parts
+(
+    Mosaic_job_t *job,       /* I/O: mosaic, with the strip buffer */
+    char *out_file,          /* I: output band file */
+    int out_nlines,          /* I: number of lines in the output */
+    int first_line,          /* I: first line not yet written */
+    Raw_binary_writer_t *rbw /* I/O: writer of the output band */
+)
+{
+    char FUNC_NAME[] = "gather_parts";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char part_file[STR_SIZE];    /* part filename */
+    int part;                    /* looping variable for the parts */
+    int line;                    /* first line of the current strip */
+    int nlines;                  /* number of lines in the current strip */
+    int line0, line1;            /* lines of the part */
+    int status = SUCCESS;        /* return status */
+    off_t line_bytes = (off_t) job->out_nsamps * job->size;
+                                 /* number of bytes in an output line */
+    struct stat part_stat;       /* status of the part file */
+    FILE *fp = NULL;             /* part file */
+
+    for (part = 0; part < job->opts->nparts && status == SUCCESS; part++)
+    {
+        get_part_lines (job->opts, part, out_nlines, &line0, &line1);
+        if (line1 <= first_line)
+            continue;
+
+        if (get_part_file (out_file, part, part_file) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        if (stat (part_file, &part_stat) != 0 ||
+            part_stat.st_size != (line1 - line0) * line_bytes)
+        {
+            sprintf (errmsg, "Part %d of %s is missing or incomplete", part,
+                out_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        fp = open_raw_binary (part_file, "rb");
+        if (fp == NULL)
+        {
+            sprintf (errmsg, "Opening the part file: %s", part_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        line = max (line0, first_line);
+        if (fseeko (fp, (line - line0) * line_bytes, SEEK_SET) != 0)
+        {
+            sprintf (errmsg, "Seeking to line %d of the part file: %s", line,
+                part_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+
+        for (; status == SUCCESS && line < line1; line += nlines)
+        {
+            nlines = min (REPROJ_TILE_SIZE, line1 - line);
+            if (read_raw_binary (fp, nlines, job->out_nsamps, job->size,
+                job->strip) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d from the part file: %s",
+                    line, line + nlines - 1, part_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            else if (write_raw_binary_writer (rbw, nlines, job->out_nsamps,
+                job->size, job->strip) != SUCCESS ||
+                checkpoint_raw_binary_writer (rbw) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to write to the output band file: "
+                    "%s", out_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+        close_raw_binary (fp);
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  remove_parts
+
+PURPOSE: Removes the part files of a band, and their checkpoints, once the
+output is complete.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Missing part files aren't an error.
+******************************************************************************/
+static void remove_parts
+(
+    Mosaic_options_t *opts,  /* I: options of the mosaic */
+    char *out_dir,           /* I: directory of the output XML file */
+    Espa_band_meta_t *bmeta  /* I: metadata of the output band */
+)
+{
+    char out_file[STR_SIZE];     /* output band filename */
+    char part_file[STR_SIZE];    /* part filename */
+    int part;                    /* looping variable for the parts */
+    int count;                   /* number of chars copied in snprintf */
+
+    count = snprintf (out_file, sizeof (out_file), "%s/%s", out_dir,
+        bmeta->file_name);
+    if (count < 0 || count >= sizeof (out_file))
+        return;
+
+    for (part = 0; part < opts->nparts; part++)
+    {
+        if (get_part_file (out_file, part, part_file) != SUCCESS)
+            return;
+        unlink (part_file);
+        espa_remove_checkpoint (part_file);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_band
+
+PURPOSE: Writes a band of the mosaic to the output directory, along with its
+ENVI header, and updates the band metadata for the grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mosaicking the band
+SUCCESS         Successfully mosaicked the band
+
+NOTES:
+  1. The output band has the filename of the band of the first input scene,
+     without any directory, in the directory of the output XML file.
+  2. A band without a fill value gets a fill value of 0, since the output
+     pixels outside the scenes are set to 0.
+  3. With checkpointing on (see espa_checkpoint.h), the output band is
+     checkpointed after each strip, and a band left by a failed run resumes
+     after its last checkpointed strip.
+  4. A part of a split mosaic is written to its part file, without the
+     statistics, checksum, percent coverage or compression of the output
+     band, which are applied when the parts are gathered.  The band
+     metadata and ENVI header are left for the gather.
+******************************************************************************/
+static int mosaic_band
+(
+    Mosaic_job_t *job,       /* I/O: mosaic, with the scenes and runners */
+    int nthreads,            /* I: number of runners */
+    char *out_dir,           /* I: directory of the output XML file */
+    Espa_global_meta_t *gmeta,  /* I: global metadata of the output */
+    Espa_band_meta_t *bmeta  /* I/O: metadata of the output band */
+)
+{
+    char FUNC_NAME[] = "mosaic_band";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char out_file[STR_SIZE];     /* output band filename */
+    char part_file[STR_SIZE];    /* part filename */
+    char *write_file = out_file; /* file written by this run */
+    char hdr_file[STR_SIZE];     /* output ENVI header filename */
+    char stage[ESPA_CHECKPOINT_STAGE_SIZE];  /* checkpoint stage name */
+    char *base = NULL;           /* band filename without the directory */
+    int count;                   /* number of chars copied in snprintf */
+    int first_line;              /* first line not yet written */
+    int line0, line1;            /* lines written by this run */
+    int ntiles;                  /* number of tiles across a strip */
+    int i, j;                    /* looping variables */
+    int status = SUCCESS;        /* status of the strips */
+    int out_nlines = job->out_space->def.img_size.l;  /* output lines */
+    bool write_part;             /* is a part of a split mosaic written? */
+    Espa_band_meta_t *sbmeta = NULL;  /* band metadata of a scene */
+    Raw_binary_writer_t rbw;     /* output band writer */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+
+    base = strrchr (bmeta->file_name, '/');
+    base = (base == NULL) ? bmeta->file_name : base + 1;
+    count = snprintf (out_file, sizeof (out_file), "%s/%s", out_dir, base);
+    if (count < 0 || count >= sizeof (out_file) || strlen (base) < 3)
+    {
+        sprintf (errmsg, "Invalid output filename for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Match the band of each scene */
+    for (i = 0; i < job->nscenes; i++)
+    {
+        job->band_index[i] = -1;
+        job->band[i].bmeta = NULL;
+        for (j = 0; j < job->scene[i].meta.nbands; j++)
+        {
+            sbmeta = &job->scene[i].meta.band[j];
+            if (strcmp (sbmeta->name, bmeta->name))
+                continue;
+
+            if (sbmeta->data_type != bmeta->data_type)
+            {
+                sprintf (errmsg, "Band %s of %s has a different data type "
+                    "than in the first scene", bmeta->name,
+                    job->scene[i].xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            job->band_index[i] = j;
+            init_reproject_band (sbmeta, job->scene[i].space, &job->band[i]);
+            break;
+        }
+    }
+
+    job->size = get_data_type_size (bmeta->data_type);
+    if (bmeta->fill_value == ESPA_INT_META_FILL)
+        bmeta->fill_value = 0;
+    set_fill_pixel (bmeta->data_type, bmeta->fill_value, job->fill);
+
+    /* Open the output file, or the file of the part, which resumes from its
+       checkpoint if one was left for the same band, scenes and grid */
+    write_part = (job->opts->nparts > 1 && !job->opts->gather);
+    get_part_lines (job->opts, job->opts->part, out_nlines, &line0, &line1);
+    if (write_part)
+    {
+        if (get_part_file (out_file, job->opts->part, part_file) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+        write_file = part_file;
+        snprintf (stage, sizeof (stage), "mosaic %s %d scenes %dx%d "
+            "part %d/%d", bmeta->name, job->nscenes, out_nlines,
+            job->out_nsamps, job->opts->part, job->opts->nparts);
+    }
+    else
+    {
+        line0 = 0;
+        line1 = out_nlines;
+        snprintf (stage, sizeof (stage), "mosaic %s %d scenes %dx%d",
+            bmeta->name, job->nscenes, out_nlines, job->out_nsamps);
+    }
+    if (open_raw_binary_writer_resumable (write_file,
+        get_raw_binary_cache_mode (), write_part ? RB_CODEC_NONE :
+        get_raw_binary_codec (), stage, &rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the output band file: %s",
+            write_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The statistics, checksum and sub-sampling of the input band don't
+       apply, and its percent coverage is recomputed if requested */
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+    bmeta->sub_sample.factor = 1;
+    bmeta->constant.is_constant = false;
+    if (!write_part && use_raw_binary_stats () &&
+        attach_raw_binary_stats (&rbw, bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the statistics of the %s band",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (!write_part && use_raw_binary_cover () &&
+        attach_raw_binary_cover (&rbw, bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the percent coverage of the %s "
+            "band", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (!write_part && use_raw_binary_checksum ())
+        attach_raw_binary_checksum (&rbw, bmeta);
+    if (resume_raw_binary_writer (&rbw, &first_line) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to resume the output band file: %s",
+            write_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Composite the lines a strip of tiles at a time, or copy them from the
+       parts */
+    ntiles = (job->out_nsamps + REPROJ_TILE_SIZE - 1) / REPROJ_TILE_SIZE;
+    if (job->opts->gather)
+        status = gather_parts (job, out_file, out_nlines, first_line, &rbw);
+    for (job->strip_line0 = line0 + first_line;
+        !job->opts->gather && job->strip_line0 < line1;
+        job->strip_line0 += REPROJ_TILE_SIZE)
+    {
+        job->strip_nlines = min (REPROJ_TILE_SIZE,
+            line1 - job->strip_line0);
+        status = espa_parallel_for (0, ntiles, 1, nthreads,
+            mosaic_tile_range, job);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Compositing lines %d-%d of band %s",
+                job->strip_line0, job->strip_line0 + job->strip_nlines - 1,
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            break;
+        }
+
+        if (write_raw_binary_writer (&rbw, job->strip_nlines,
+            job->out_nsamps, job->size, job->strip) != SUCCESS ||
+            checkpoint_raw_binary_writer (&rbw) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the output band file: %s",
+                write_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the output band file: %s", write_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+    if (write_part)
+        return (SUCCESS);
+
+    /* Update the band metadata for the output grid */
+    bmeta->nlines = out_nlines;
+    bmeta->nsamps = job->out_nsamps;
+    bmeta->pixel_size[0] = job->out_space->def.pixel_size[0];
+    bmeta->pixel_size[1] = job->out_space->def.pixel_size[1];
+    strcpy (bmeta->pixel_units, gmeta->proj_info.units);
+    memmove (bmeta->file_name, base, strlen (base) + 1);
+
+    /* Write the ENVI header for the band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (hdr_file, out_file);
+    sprintf (&hdr_file[strlen(hdr_file)-3], "hdr");
+    if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_scene
+
+PURPOSE: Reads the metadata of an input scene and sets up its geolocation and
+QA band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the scene
+SUCCESS         Successfully set up the scene
+
+NOTES:
+******************************************************************************/
+static int open_scene
+(
+    char *xml_file,          /* I: input XML file of the scene */
+    int order,               /* I: position of the scene in the input list */
+    char *out_path,          /* I: resolved directory of the output */
+    Mosaic_options_t *opts,  /* I: options of the mosaic */
+    Mosaic_scene_t *scene    /* O: input scene */
+)
+{
+    char FUNC_NAME[] = "open_scene";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_path[PATH_MAX];      /* resolved input directory */
+    int i;                       /* looping variable for the bands */
+    Space_def_t in_def;          /* input space definition */
+
+    scene->xml_file = xml_file;
+    scene->order = order;
+    scene->qa_band = -1;
+    if (validate_xml_file (xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (parse_metadata (xml_file, &scene->meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* The mosaic bands can't overwrite the input bands */
+    if (get_subset_dir (xml_file, scene->dir) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (realpath (scene->dir, in_path) == NULL)
+    {
+        sprintf (errmsg, "Resolving the directory of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!strcmp (in_path, out_path))
+    {
+        sprintf (errmsg, "The output XML file must be in a different "
+            "directory than the input XML file %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!get_geoloc_info (&scene->meta, &in_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    scene->space = setup_mapping (&in_def);
+    if (scene->space == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure of %s",
+            xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Find the QA band */
+    if (opts->priority != MOSAIC_QA)
+        return (SUCCESS);
+
+    for (i = 0; i < scene->meta.nbands; i++)
+    {
+        if (!strcmp (scene->meta.band[i].name, opts->qa_band))
+        {
+            if (scene->meta.band[i].data_type == ESPA_FLOAT32 ||
+                scene->meta.band[i].data_type == ESPA_FLOAT64)
+            {
+                sprintf (errmsg, "QA band %s of %s isn't an integer band",
+                    opts->qa_band, xml_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            scene->qa_band = i;
+            init_reproject_band (&scene->meta.band[i], scene->space,
+                &scene->qa);
+            scene->qa.method = ESPA_NN;
+            break;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  mosaic_xml
+
+PURPOSE: Mosaics the bands of several scenes onto the grid of a template
+product, writing the mosaic bands to the directory of the output XML file
+and their metadata to the output XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mosaicking the scenes
+SUCCESS         Successfully mosaicked the scenes
+
+NOTES:
+  1. The output XML file has to be in a different directory than the input
+     XML files, since the mosaic bands keep the filenames of the first
+     scene.
+  2. The global metadata is that of the first scene, with the projection
+     information and orientation of the template and the corners and
+     bounding coordinates of the grid.
+  3. Every part of a split mosaic, and the gather, has to be given the same
+     scenes, template and options, so they all find the same grid.  Writing
+     a part doesn't write the output XML file; the gather writes it and
+     removes the part files.
+******************************************************************************/
+int mosaic_xml
+(
+    int nscenes,             /* I: number of input scenes */
+    char **in_xml_file,      /* I: input XML file of each scene */
+    char *out_xml_file,      /* I: output XML file; the mosaic bands are
+                                   written to its directory */
+    char *template_xml_file, /* I: XML file of the template product */
+    Mosaic_options_t *opts   /* I: options of the mosaic */
+)
+{
+    char FUNC_NAME[] = "mosaic_xml";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char out_dir[STR_SIZE];      /* directory of the output XML file */
+    char out_path[PATH_MAX];     /* resolved output directory */
+    int i, j;                    /* looping variables */
+    int nthreads;                /* number of runners */
+    int nqa = 0;                 /* number of scenes with the QA band */
+    int status = SUCCESS;        /* return status */
+    size_t strip_bytes;          /* bytes in a strip */
+    size_t runner_bytes;         /* bytes held by each runner */
+    size_t tile_pixels = (size_t) REPROJ_TILE_SIZE * REPROJ_TILE_SIZE;
+                                 /* number of pixels in a tile */
+    double line[2], samp[2];     /* footprint of a scene on the grid */
+    Space_def_t out_def;         /* output grid */
+    Geoloc_t **in_space = NULL;  /* geolocation of each scene */
+    Mosaic_scene_t *scene = NULL;  /* input scenes */
+    Mosaic_job_t job;            /* band being mosaicked */
+    Mosaic_runner_t *run = NULL; /* resources of a runner */
+    Subset_window_t grid_window; /* whole output grid */
+    Espa_internal_meta_t out_meta;       /* XML metadata of the output */
+    Espa_internal_meta_t template_meta;  /* XML metadata of the template */
+
+    if (nscenes < 1)
+    {
+        sprintf (errmsg, "No input scenes to mosaic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (opts->priority == MOSAIC_QA && opts->qa_band[0] == '\0')
+    {
+        sprintf (errmsg, "The QA priority requires the name of the QA band");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (opts->nparts < 0 || opts->nparts > MOSAIC_MAX_PARTS ||
+        (opts->nparts > 1 && !opts->gather &&
+        (opts->part < 0 || opts->part >= opts->nparts)) ||
+        (opts->gather && opts->nparts < 2))
+    {
+        sprintf (errmsg, "Invalid part %d of %d parts of the mosaic",
+            opts->part, opts->nparts);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Read the template and the output metadata, which starts as the
+       metadata of the first scene */
+    if (validate_xml_file (template_xml_file) != SUCCESS ||
+        validate_xml_file (in_xml_file[0]) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    init_metadata_struct (&template_meta);
+    init_metadata_struct (&out_meta);
+    if (parse_metadata (template_xml_file, &template_meta) != SUCCESS ||
+        parse_metadata (in_xml_file[0], &out_meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (get_subset_dir (out_xml_file, out_dir) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (realpath (out_dir, out_path) == NULL)
+    {
+        sprintf (errmsg, "Resolving the directory of the output XML file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Read the scenes */
+    scene = calloc (nscenes, sizeof (Mosaic_scene_t));
+    in_space = calloc (nscenes, sizeof (Geoloc_t *));
+    if (scene == NULL || in_space == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the input scenes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nscenes; i++)
+    {
+        init_metadata_struct (&scene[i].meta);
+        if (open_scene (in_xml_file[i], i, out_path, opts, &scene[i]) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Reading input scene %s", in_xml_file[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        in_space[i] = scene[i].space;
+        if (scene[i].qa_band >= 0)
+            nqa++;
+    }
+
+    /* A QA band in none of the scenes is most likely a misspelled name */
+    if (opts->priority == MOSAIC_QA && nqa == 0)
+    {
+        sprintf (errmsg, "None of the input scenes has the QA band %s",
+            opts->qa_band);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the output grid */
+    status = get_reproject_grid (nscenes, in_space, &template_meta,
+        opts->pixel_size, opts->template_extent, &out_def);
+    free (in_space);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the output grid of the mosaic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&job, 0, sizeof (job));
+    job.out_space = setup_mapping (&out_def);
+    if (job.out_space == NULL)
+    {
+        sprintf (errmsg, "Setting up the mapping structure of the output "
+            "grid.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Find the footprint of each scene on the grid, with a margin for the
+       resampling kernels */
+    for (i = 0; i < nscenes; i++)
+    {
+        if (get_reproject_footprint (scene[i].space, job.out_space, &line[0],
+            &line[1], &samp[0], &samp[1]) != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the footprint of %s",
+                scene[i].xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        scene[i].line0 = (int) max (floor (line[0]) - 1.0, -1.0);
+        scene[i].samp0 = (int) max (floor (samp[0]) - 1.0, -1.0);
+        scene[i].line1 = (int) min (ceil (line[1]) + 1.0,
+            out_def.img_size.l + 1.0);
+        scene[i].samp1 = (int) min (ceil (samp[1]) + 1.0,
+            out_def.img_size.s + 1.0);
+    }
+
+    /* Put the scenes in priority order */
+    qsort (scene, nscenes, sizeof (Mosaic_scene_t),
+        (opts->priority == MOSAIC_ZENITH) ? compare_zenith : compare_latest);
+
+    /* Size the runners and the strip to the memory budget */
+    job.scene = scene;
+    job.nscenes = nscenes;
+    job.opts = opts;
+    job.out_nsamps = out_def.img_size.s;
+    strip_bytes = (size_t) REPROJ_TILE_SIZE * job.out_nsamps *
+        sizeof (double);
+    runner_bytes = 2 * REPROJ_MAX_WINDOW * (sizeof (double) + sizeof (float))
+        + tile_pixels * (2 * sizeof (float) + 2 * sizeof (double) + 1);
+    nthreads = espa_budget_threads (runner_bytes, strip_bytes,
+        espa_task_nthreads ());
+
+    job.strip = get_raw_binary_buffer (strip_bytes, false);
+    job.band = calloc (nscenes, sizeof (Reproj_band_t));
+    job.band_index = calloc (nscenes, sizeof (int));
+    job.runner = calloc (nthreads, sizeof (Mosaic_runner_t));
+    if (job.strip == NULL || job.band == NULL || job.band_index == NULL ||
+        job.runner == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the mosaic");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < nthreads; i++)
+    {
+        run = &job.runner[i];
+        run->in_line = malloc (tile_pixels * sizeof (float));
+        run->in_samp = malloc (tile_pixels * sizeof (float));
+        run->tile = malloc (tile_pixels * sizeof (double));
+        run->qa_tile = malloc (tile_pixels * sizeof (double));
+        run->done = malloc (tile_pixels);
+        if (run->in_line == NULL || run->in_samp == NULL ||
+            run->tile == NULL || run->qa_tile == NULL || run->done == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the tiles");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Update the projection information and geolocation for the grid, which
+       the ENVI headers of the bands use */
+    out_meta.global.proj_info = template_meta.global.proj_info;
+    out_meta.global.orientation_angle =
+        template_meta.global.orientation_angle;
+    grid_window.line0 = 0;
+    grid_window.samp0 = 0;
+    grid_window.nlines = out_def.img_size.l;
+    grid_window.nsamps = out_def.img_size.s;
+    status = update_subset_geoloc (job.out_space, &grid_window,
+        &out_meta.global);
+
+    /* Mosaic the bands */
+    for (i = 0; i < out_meta.nbands && status == SUCCESS; i++)
+    {
+        status = mosaic_band (&job, nthreads, out_dir, &out_meta.global,
+            &out_meta.band[i]);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Mosaicking band %s", out_meta.band[i].name);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+    }
+
+    /* Write the metadata of the output and validate it, unless only a part
+       was written */
+    if (opts->nparts <= 1 || opts->gather)
+    {
+        if (status == SUCCESS)
+            status = write_metadata (&out_meta, out_xml_file);
+        if (status == SUCCESS)
+            status = validate_xml_file (out_xml_file);
+
+        /* The output is complete, so the checkpoints of the bands and the
+           parts are no longer needed */
+        for (i = 0; i < out_meta.nbands && status == SUCCESS; i++)
+        {
+            remove_raw_binary_checkpoint (out_dir, &out_meta.band[i]);
+            if (opts->gather)
+                remove_parts (opts, out_dir, &out_meta.band[i]);
+        }
+    }
+
+    /* Close the files and free the memory */
+    for (i = 0; i < nthreads; i++)
+    {
+        run = &job.runner[i];
+        for (j = 0; j < MOSAIC_MAX_OPEN; j++)
+        {
+            if (run->handle[j].fp != NULL)
+                close_raw_binary (run->handle[j].fp);
+        }
+        free_reproject_window (&run->window);
+        free_reproject_window (&run->qa_window);
+        free (run->in_line);
+        free (run->in_samp);
+        free (run->tile);
+        free (run->qa_tile);
+        free (run->done);
+    }
+    for (i = 0; i < nscenes; i++)
+    {
+        free_metadata (&scene[i].meta);
+        free (scene[i].space);
+    }
+    free (job.runner);
+    free (job.band);
+    free (job.band_index);
+    free (job.out_space);
+    release_raw_binary_buffer (job.strip);
+    free (scene);
+    free_metadata (&out_meta);
+    free_metadata (&template_meta);
+
+    return (status);
+}
@@ -0,0 +1,94 @@
+/*****************************************************************************
+FILE: espa_mosaic.h
+
+PURPOSE: Contains defines, structures and prototypes for mosaicking the bands
+of several scenes onto the grid of a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The output bands are the bands of the first input scene.  The bands of
+     the other scenes are matched to them by name, and have to have the same
+     data type.
+  2. Each output pixel is taken from the first scene, in priority order,
+     with a valid pixel there.  A pixel is valid if it is within the scene
+     and isn't fill.  With the QA priority, pixels whose QA band has any of
+     the QA mask bits set are only used where no scene has a clear pixel.
+  3. The output is processed in the tiles of the reprojection engine (see
+     espa_reproject.h), reading each scene only in the window a tile maps
+     to.
+  4. A mosaic may be split into parts, each a range of whole strips of
+     output lines, which are written separately (e.g. by workers on several
+     nodes sharing the output directory, see espa_distribute) to part files
+     next to the output bands.  A part only reads the scenes whose footprint
+     overlaps its lines.  A final run with gather set joins the parts into
+     the output bands and writes the XML file.
+*****************************************************************************/
+
+#ifndef ESPA_MOSAIC_H
+#define ESPA_MOSAIC_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_geoloc.h"
+#include "espa_reproject.h"
+
+/* Defines */
+/* Number of band files each thread keeps open, reusing the least recently
+   used one when more are needed */
+#define MOSAIC_MAX_OPEN 16
+
+/* Largest number of parts a mosaic can be split into */
+#define MOSAIC_MAX_PARTS 4096
+
+/* Type definitions */
+/* Order in which the scenes are used for each output pixel */
+typedef enum
+{
+    MOSAIC_LATEST,       /* latest acquisition first */
+    MOSAIC_ZENITH,       /* lowest solar zenith first */
+    MOSAIC_QA            /* latest acquisition first, preferring pixels
+                            whose QA is clear */
+} Mosaic_priority_t;
+
+/* Options of the mosaic */
+typedef struct
+{
+    Mosaic_priority_t priority;  /* order the scenes are used in */
+    char qa_band[STR_SIZE];      /* name of the QA band, for MOSAIC_QA */
+    unsigned long qa_mask;       /* QA bits marking a pixel as not clear,
+                                    for MOSAIC_QA */
+    double pixel_size;           /* output pixel size; 0 for the pixel size
+                                    of the template */
+    bool template_extent;        /* use the extent of the template, rather
+                                    than the extent of the scenes? */
+    int nparts;                  /* number of parts the output lines are
+                                    split into; 0 or 1 for the whole
+                                    mosaic at once */
+    int part;                    /* part to be written, from 0 to
+                                    nparts - 1; ignored by gather */
+    bool gather;                 /* join the parts already written into the
+                                    output bands and XML file? */
+} Mosaic_options_t;
+
+/* Prototypes */
+int mosaic_xml
+(
+    int nscenes,             /* I: number of input scenes */
+    char **in_xml_file,      /* I: input XML file of each scene */
+    char *out_xml_file,      /* I: output XML file; the mosaic bands are
+                                   written to its directory */
+    char *template_xml_file, /* I: XML file of the template product */
+    Mosaic_options_t *opts   /* I: options of the mosaic */
+);
+
+#endif
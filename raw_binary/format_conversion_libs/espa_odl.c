@@ -0,0 +1,441 @@
+/*****************************************************************************
+FILE: espa_odl.c
+
+PURPOSE: Contains functions for tokenizing the ODL metadata of HDF-EOS files
+and looking up its values.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_odl.h for the statements and keys of the metadata.
+*****************************************************************************/
+#include <stdint.h>
+#include "espa_odl.h"
+
+/* Whitespace between the tokens of the metadata */
+#define ODL_SPACE " \t\r\n"
+
+/* Maximum nesting depth of the OBJECTs whose names are tracked */
+#define ODL_MAX_DEPTH 32
+
+
+/******************************************************************************
+MODULE:  hash_odl_key
+
+PURPOSE: Returns the hash of a key of the ODL metadata.
+
+RETURN VALUE:
+Type = uint32_t
+Value           Description
+-----           -----------
+hash            32-bit FNV-1a hash of the key
+
+NOTES:
+******************************************************************************/
+static uint32_t hash_odl_key
+(
+    const char *key             /* I: key to be hashed */
+)
+{
+    uint32_t hash = 2166136261u;   /* FNV-1a hash of the key */
+
+    for (; *key != '\0'; key++)
+    {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619u;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  skip_odl_space
+
+PURPOSE: Skips the whitespace and comments of the ODL metadata.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+ptr             First character after the whitespace and comments
+
+NOTES:
+******************************************************************************/
+static char *skip_odl_space
+(
+    char *ptr                   /* I: current position in the metadata */
+)
+{
+    while (1)
+    {
+        ptr += strspn (ptr, ODL_SPACE);
+        if (ptr[0] != '/' || ptr[1] != '*')
+            return (ptr);
+
+        /* Skip the comment, up to the end of the metadata if it isn't
+           closed */
+        ptr = strstr (ptr + 2, "*/");
+        if (ptr == NULL)
+            return ("");
+        ptr += 2;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  scan_odl_value
+
+PURPOSE: Finds the end of the value of an ODL statement.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+end             First character after the value
+
+NOTES:
+  1. A quoted value ends at the closing quote, and a list at the closing
+     parenthesis matching the opening one, skipping any quoted strings in
+     the list.  Any other value ends at the next whitespace.
+******************************************************************************/
+static char *scan_odl_value
+(
+    char *ptr                   /* I: start of the value */
+)
+{
+    int depth = 0;              /* nesting depth of the parentheses */
+    char *end = NULL;           /* end of a quoted string */
+
+    if (*ptr == '"')
+    {
+        end = strchr (ptr + 1, '"');
+        return ((end != NULL) ? end + 1 : ptr + strlen (ptr));
+    }
+
+    if (*ptr != '(')
+        return (ptr + strcspn (ptr, ODL_SPACE));
+
+    for (; *ptr != '\0'; ptr++)
+    {
+        if (*ptr == '"')
+        {
+            end = strchr (ptr + 1, '"');
+            if (end == NULL)
+                return (ptr + strlen (ptr));
+            ptr = end;
+        }
+        else if (*ptr == '(')
+            depth++;
+        else if (*ptr == ')' && --depth == 0)
+            return (ptr + 1);
+    }
+
+    return (ptr);
+}
+
+
+/******************************************************************************
+MODULE:  add_odl_attr
+
+PURPOSE: Adds a statement to the tokenized ODL metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the statement
+SUCCESS         Successfully added the statement
+
+NOTES:
+******************************************************************************/
+static int add_odl_attr
+(
+    Odl_index_t *odl,           /* I/O: tokenized metadata */
+    int *size,                  /* I/O: allocated number of statements */
+    char *key,                  /* I: key of the statement */
+    char *value                 /* I: value of the statement */
+)
+{
+    char FUNC_NAME[] = "add_odl_attr";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Odl_attr_t *new_attrs = NULL;  /* reallocated statements */
+
+    if (odl->nattrs == *size)
+    {
+        *size = (*size > 0) ? *size * 2 : 256;
+        new_attrs = realloc (odl->attrs, *size * sizeof (Odl_attr_t));
+        if (new_attrs == NULL)
+        {
+            sprintf (errmsg, "Allocating %d ODL statements", *size);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        odl->attrs = new_attrs;
+    }
+
+    odl->attrs[odl->nattrs].key = key;
+    odl->attrs[odl->nattrs].value = value;
+    odl->attrs[odl->nattrs].next = -1;
+    odl->nattrs++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  index_odl
+
+PURPOSE: Builds the hash table of the keys of the tokenized ODL metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the hash table
+SUCCESS         Successfully built the hash table
+
+NOTES:
+  1. Each slot holds the first statement of a key, and collisions are
+     resolved by linear probing.  The other statements of the key are
+     chained to the first.
+******************************************************************************/
+static int index_odl
+(
+    Odl_index_t *odl            /* I/O: tokenized metadata */
+)
+{
+    char FUNC_NAME[] = "index_odl";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for statements */
+    int slot;                   /* slot in the hash table */
+    int *tail = NULL;           /* last statement of the key of each slot */
+
+    /* Size the table to at most half full */
+    odl->nslots = 64;
+    while (odl->nslots < 2 * odl->nattrs)
+        odl->nslots *= 2;
+
+    odl->slot = malloc (odl->nslots * sizeof (int));
+    tail = malloc (odl->nslots * sizeof (int));
+    if (odl->slot == NULL || tail == NULL)
+    {
+        sprintf (errmsg, "Allocating the ODL hash table of %d slots",
+            odl->nslots);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (tail);
+        return (ERROR);
+    }
+    for (slot = 0; slot < odl->nslots; slot++)
+        odl->slot[slot] = -1;
+
+    for (i = 0; i < odl->nattrs; i++)
+    {
+        slot = hash_odl_key (odl->attrs[i].key) & (odl->nslots - 1);
+        while (odl->slot[slot] != -1 &&
+            strcmp (odl->attrs[odl->slot[slot]].key, odl->attrs[i].key))
+            slot = (slot + 1) & (odl->nslots - 1);
+
+        if (odl->slot[slot] == -1)
+            odl->slot[slot] = i;
+        else
+            odl->attrs[tail[slot]].next = i;
+        tail[slot] = i;
+    }
+
+    free (tail);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_odl
+
+PURPOSE: Tokenizes the ODL metadata in a single pass and indexes its keys.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error tokenizing the metadata
+SUCCESS         Successfully tokenized the metadata
+
+NOTES:
+  1. The metadata is owned by odl from here on, even if there is an error,
+     and is freed by free_odl.
+  2. A statement without a value (such as END) has no = after its name.
+******************************************************************************/
+int parse_odl
+(
+    char *text,                 /* I: ODL metadata, NUL terminated; it is
+                                      tokenized in place and freed by
+                                      free_odl */
+    Odl_index_t *odl            /* O: tokenized metadata and its index */
+)
+{
+    char *ptr = NULL;           /* current position in the metadata */
+    char *name = NULL;          /* name of the current statement */
+    char *name_end = NULL;      /* end of the name of the statement */
+    char *value = NULL;         /* value of the current statement */
+    char *value_end = NULL;     /* end of the value of the statement */
+    char *object[ODL_MAX_DEPTH];  /* names of the enclosing OBJECTs */
+    int depth = 0;              /* nesting depth of the OBJECTs */
+    char *key = NULL;           /* key of the current statement */
+    int size = 0;               /* allocated number of statements */
+
+    odl->text = text;
+    odl->nattrs = 0;
+    odl->attrs = NULL;
+    odl->nslots = 0;
+    odl->slot = NULL;
+
+    ptr = skip_odl_space (text);
+    while (*ptr != '\0')
+    {
+        /* Get the name of the statement */
+        name = ptr;
+        name_end = name + strcspn (name, ODL_SPACE "=");
+        ptr = skip_odl_space (name_end);
+
+        /* Get the value, if there is one */
+        value = "";
+        if (*ptr == '=')
+        {
+            ptr = skip_odl_space (ptr + 1);
+            value = ptr;
+            value_end = scan_odl_value (value);
+            ptr = (*value_end != '\0') ? value_end + 1 : value_end;
+
+            /* Strip the quotes of a quoted value */
+            if (*value == '"')
+            {
+                value++;
+                if (value_end > value && value_end[-1] == '"')
+                    value_end--;
+            }
+            *value_end = '\0';
+        }
+        *name_end = '\0';
+        ptr = skip_odl_space (ptr);
+
+        if (!strcmp (name, "END"))
+            break;
+
+        /* Key the VALUE of an OBJECT on the name of the object */
+        key = name;
+        if (!strcmp (name, "OBJECT"))
+        {
+            if (depth < ODL_MAX_DEPTH)
+                object[depth] = value;
+            depth++;
+        }
+        else if (!strcmp (name, "END_OBJECT"))
+        {
+            if (depth > 0)
+                depth--;
+        }
+        else if (!strcmp (name, "VALUE") && depth > 0 &&
+                 depth <= ODL_MAX_DEPTH)
+            key = object[depth-1];
+
+        if (add_odl_attr (odl, &size, key, value) != SUCCESS)
+        {   /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
+    return (index_odl (odl));
+}
+
+
+/******************************************************************************
+MODULE:  find_odl_attr
+
+PURPOSE: Finds the first statement of a key of the ODL metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              Key isn't in the metadata
+other           Index of the first statement of the key in odl->attrs; the
+                others are chained through the next member
+
+NOTES:
+******************************************************************************/
+int find_odl_attr
+(
+    Odl_index_t *odl,           /* I: tokenized metadata */
+    const char *key             /* I: key to be found */
+)
+{
+    int slot;                   /* slot in the hash table */
+
+    if (odl->nslots == 0)
+        return (-1);
+
+    for (slot = hash_odl_key (key) & (odl->nslots - 1);
+         odl->slot[slot] != -1; slot = (slot + 1) & (odl->nslots - 1))
+    {
+        if (!strcmp (odl->attrs[odl->slot[slot]].key, key))
+            return (odl->slot[slot]);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  get_odl_value
+
+PURPOSE: Returns the value of the first statement of a key of the ODL
+metadata.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            Key isn't in the metadata
+other           Value of the key
+
+NOTES:
+******************************************************************************/
+char *get_odl_value
+(
+    Odl_index_t *odl,           /* I: tokenized metadata */
+    const char *key             /* I: key to be found */
+)
+{
+    int i = find_odl_attr (odl, key);  /* first statement of the key */
+
+    return ((i != -1) ? odl->attrs[i].value : NULL);
+}
+
+
+/******************************************************************************
+MODULE:  free_odl
+
+PURPOSE: Frees the tokenized ODL metadata and its index.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void free_odl
+(
+    Odl_index_t *odl            /* I/O: tokenized metadata to be freed */
+)
+{
+    free (odl->text);
+    free (odl->attrs);
+    free (odl->slot);
+    odl->text = NULL;
+    odl->attrs = NULL;
+    odl->slot = NULL;
+    odl->nattrs = 0;
+    odl->nslots = 0;
+}
@@ -0,0 +1,89 @@
+/*****************************************************************************
+FILE: espa_odl.h
+
+PURPOSE: Contains defines, structures and prototypes for tokenizing the ODL
+(Object Description Language) metadata of HDF-EOS files, such as the
+CoreMetadata, ArchiveMetadata and StructMetadata attributes of the MODIS
+products.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The metadata is tokenized in place in a single pass into a list of
+     name = value statements.  Each statement is keyed on its name, except
+     for the VALUE statement of an OBJECT which is keyed on the name of the
+     object, so
+         OBJECT                 = PRODUCTIONDATETIME
+           NUM_VAL              = 1
+           VALUE                = "2013-09-09T12:00:55.000Z"
+         END_OBJECT             = PRODUCTIONDATETIME
+     gives the key PRODUCTIONDATETIME the value 2013-09-09T12:00:55.000Z.
+  2. Quoted values are stored without the quotes, and lists in parentheses
+     are stored as they are.  The metadata ends at the END statement.
+  3. The keys are indexed in a hash table, and the statements with the same
+     key are chained in the order of the metadata.
+*****************************************************************************/
+
+#ifndef ESPA_ODL_H
+#define ESPA_ODL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Type definitions */
+/* Statement of the ODL metadata */
+typedef struct
+{
+    char *key;                  /* key of the statement */
+    char *value;                /* value of the statement; empty if it has
+                                   none */
+    int next;                   /* index of the next statement with the same
+                                   key; -1 if none */
+} Odl_attr_t;
+
+/* Tokenized ODL metadata and the index of its keys */
+typedef struct
+{
+    char *text;                 /* metadata, tokenized in place */
+    int nattrs;                 /* number of statements */
+    Odl_attr_t *attrs;          /* statements, in the order of the
+                                   metadata */
+    int nslots;                 /* number of slots in the hash table; power
+                                   of 2 */
+    int *slot;                  /* first statement of the key of each slot
+                                   of the hash table; -1 if empty */
+} Odl_index_t;
+
+/* Prototypes */
+int parse_odl
+(
+    char *text,                 /* I: ODL metadata, NUL terminated; it is
+                                      tokenized in place and freed by
+                                      free_odl */
+    Odl_index_t *odl            /* O: tokenized metadata and its index */
+);
+
+int find_odl_attr
+(
+    Odl_index_t *odl,           /* I: tokenized metadata */
+    const char *key             /* I: key to be found */
+);
+
+char *get_odl_value
+(
+    Odl_index_t *odl,           /* I: tokenized metadata */
+    const char *key             /* I: key to be found */
+);
+
+void free_odl
+(
+    Odl_index_t *odl            /* I/O: tokenized metadata to be freed */
+);
+
+#endif
@@ -0,0 +1,851 @@
+/*****************************************************************************
+FILE: espa_package.c
+
+PURPOSE: Contains functions for packaging the files of a product as a tar
+archive for delivery, without staging them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_package.h for the layout of the archive.
+*****************************************************************************/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <zlib.h>
+#include "espa_package.h"
+#include "espa_task.h"
+
+/* Largest size written as octal digits in the size field of a tar header;
+   larger sizes are written in base-256 */
+#define PKG_TAR_OCTAL_MAX 077777777777L
+
+/* Size of the buffer used when the data can't be copied in the kernel */
+#define PKG_COPY_BUFSIZE (1024 * 1024)
+
+/* POSIX ustar header */
+typedef struct
+{
+    char name[100];          /* member name, or its last part */
+    char mode[8];            /* permissions, octal */
+    char uid[8];             /* owner user ID, octal */
+    char gid[8];             /* owner group ID, octal */
+    char size[12];           /* size of the member data, octal or base-256 */
+    char mtime[12];          /* modification time, octal */
+    char chksum[8];          /* sum of the bytes of the header, octal */
+    char typeflag;           /* type of the member; '0' for a file */
+    char linkname[100];      /* target of a link; unused */
+    char magic[6];           /* "ustar" */
+    char version[2];         /* "00" */
+    char uname[32];          /* owner user name; unused */
+    char gname[32];          /* owner group name; unused */
+    char devmajor[8];        /* device major number; unused */
+    char devminor[8];        /* device minor number; unused */
+    char prefix[155];        /* directory part of a long member name */
+    char pad[12];            /* padding to PKG_TAR_BLOCK_SIZE */
+} Pkg_tar_header_t;
+
+/* Archive being written */
+typedef struct
+{
+    char *archive;           /* name of the archive, for messages */
+    int fd;                  /* file descriptor of the archive */
+    bool is_file;            /* is the archive a regular file? */
+    Pkg_compress_t compress; /* compression of the archive */
+    int level;               /* deflate level of the compressed archive */
+    off_t nbytes;            /* number of bytes of the tar archive so far */
+    int nblocks;             /* number of blocks compressed at a time */
+    uint8_t *in_buf;         /* tar archive not yet compressed */
+    size_t in_len;           /* number of bytes in in_buf */
+    uLong comp_bound;        /* size of each compressed block buffer */
+    uint8_t **comp_buf;      /* compressed blocks */
+    size_t *comp_len;        /* size of each compressed block */
+} Pkg_writer_t;
+
+
+/******************************************************************************
+MODULE:  write_package_fd
+
+PURPOSE: Writes a buffer to the archive file descriptor, resuming after
+partial writes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the buffer
+SUCCESS         Successfully wrote the buffer
+
+NOTES:
+******************************************************************************/
+static int write_package_fd
+(
+    Pkg_writer_t *pw,        /* I: archive being written */
+    const uint8_t *buf,      /* I: data to be written */
+    size_t len               /* I: number of bytes to be written */
+)
+{
+    char FUNC_NAME[] = "write_package_fd";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    ssize_t nwritten;        /* number of bytes written by write */
+
+    while (len > 0)
+    {
+        nwritten = write (pw->fd, buf, len);
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+        {
+            sprintf (errmsg, "Writing the archive %s", pw->archive);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        buf += nwritten;
+        len -= nwritten;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compress_package_blocks
+
+PURPOSE: Compresses blocks of the archive as gzip members, as the chunk
+function of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compressing a block
+SUCCESS         Successfully compressed the blocks
+
+NOTES:
+******************************************************************************/
+static int compress_package_blocks
+(
+    void *arg,               /* I: archive being written */
+    int first,               /* I: first block to be compressed */
+    int end,                 /* I: block after the last one */
+    int runner               /* I: number of the runner; unused */
+)
+{
+    char FUNC_NAME[] = "compress_package_blocks";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Pkg_writer_t *pw = arg;  /* archive being written */
+    int b;                   /* looping variable for the blocks */
+    int zstatus;             /* status of deflate */
+    size_t start;            /* offset of the block in in_buf */
+    z_stream zs;             /* deflate stream of the block */
+
+    for (b = first; b < end; b++)
+    {
+        start = (size_t) b * PKG_GZIP_BLOCK_SIZE;
+        memset (&zs, 0, sizeof (zs));
+        if (deflateInit2 (&zs, pw->level, Z_DEFLATED, MAX_WBITS + 16, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            sprintf (errmsg, "Initializing the compression of the archive");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        zs.next_in = &pw->in_buf[start];
+        zs.avail_in = (pw->in_len - start < PKG_GZIP_BLOCK_SIZE) ?
+            pw->in_len - start : PKG_GZIP_BLOCK_SIZE;
+        zs.next_out = pw->comp_buf[b];
+        zs.avail_out = pw->comp_bound;
+        zstatus = deflate (&zs, Z_FINISH);
+        pw->comp_len[b] = zs.total_out;
+        deflateEnd (&zs);
+        if (zstatus != Z_STREAM_END)
+        {
+            sprintf (errmsg, "Compressing block %d of the archive", b);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  flush_package
+
+PURPOSE: Compresses the buffered part of the archive and writes it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compressing or writing the archive
+SUCCESS         Successfully wrote the buffered archive
+
+NOTES:
+******************************************************************************/
+static int flush_package
+(
+    Pkg_writer_t *pw         /* I/O: archive being written */
+)
+{
+    int b;                   /* looping variable for the blocks */
+    int nblocks;             /* number of buffered blocks */
+
+    if (pw->in_len == 0)
+        return (SUCCESS);
+
+    nblocks = (pw->in_len + PKG_GZIP_BLOCK_SIZE - 1) / PKG_GZIP_BLOCK_SIZE;
+    if (espa_parallel_for (0, nblocks, 1, nblocks, compress_package_blocks,
+        pw) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    for (b = 0; b < nblocks; b++)
+    {
+        if (write_package_fd (pw, pw->comp_buf[b], pw->comp_len[b])
+            != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+    pw->in_len = 0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_package
+
+PURPOSE: Writes a buffer to the tar archive, buffering it for compression if
+the archive is compressed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the buffer
+SUCCESS         Successfully wrote the buffer
+
+NOTES:
+******************************************************************************/
+static int write_package
+(
+    Pkg_writer_t *pw,        /* I/O: archive being written */
+    const void *buf,         /* I: data to be written */
+    size_t len               /* I: number of bytes to be written */
+)
+{
+    const uint8_t *data = buf;   /* data not yet written */
+    size_t in_size = (size_t) pw->nblocks * PKG_GZIP_BLOCK_SIZE;
+                                 /* size of in_buf */
+    size_t n;                    /* number of bytes buffered at a time */
+
+    pw->nbytes += len;
+    if (pw->compress == PKG_COMPRESS_NONE)
+        return (write_package_fd (pw, data, len));
+
+    while (len > 0)
+    {
+        n = (len < in_size - pw->in_len) ? len : in_size - pw->in_len;
+        memcpy (&pw->in_buf[pw->in_len], data, n);
+        pw->in_len += n;
+        data += n;
+        len -= n;
+        if (pw->in_len == in_size && flush_package (pw) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  copy_package_data
+
+PURPOSE: Copies the data of a file into the tar archive.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the data
+SUCCESS         Successfully copied the data
+
+NOTES:
+  1. Uncompressed, the data is copied in the kernel: with copy_file_range if
+     the archive is a regular file, else (or if it isn't supported between
+     these files) with sendfile, and through a user-space buffer only if
+     neither can be used.  Compressed, the data is read straight into the
+     buffer of blocks to be compressed.
+******************************************************************************/
+static int copy_package_data
+(
+    Pkg_writer_t *pw,        /* I/O: archive being written */
+    int in_fd,               /* I: file descriptor of the file */
+    off_t size,              /* I: size of the file */
+    char *file_name          /* I: name of the file, for messages */
+)
+{
+    char FUNC_NAME[] = "copy_package_data";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *buf = NULL;        /* buffer for copying through user space */
+    size_t in_size = (size_t) pw->nblocks * PKG_GZIP_BLOCK_SIZE;
+                             /* size of in_buf */
+    size_t n;                /* number of bytes to be copied at a time */
+    ssize_t ncopied = 0;     /* number of bytes copied at a time */
+    off_t offset = 0;        /* offset in the file of the next copy */
+    bool use_copy_range = pw->is_file;  /* should copy_file_range be used? */
+    bool use_sendfile = true;           /* should sendfile be used? */
+
+    while (offset < size)
+    {
+        n = (size - offset < PKG_COPY_BUFSIZE) ? size - offset :
+            PKG_COPY_BUFSIZE;
+        if (pw->compress != PKG_COMPRESS_NONE)
+        {
+            /* Read straight into the blocks to be compressed */
+            if (n > in_size - pw->in_len)
+                n = in_size - pw->in_len;
+            ncopied = pread (in_fd, &pw->in_buf[pw->in_len], n, offset);
+            if (ncopied > 0)
+            {
+                pw->in_len += ncopied;
+                if (pw->in_len == in_size && flush_package (pw) != SUCCESS)
+                {  /* Error messages already written */
+                    free (buf);
+                    return (ERROR);
+                }
+            }
+        }
+        else if (use_copy_range)
+        {
+            ncopied = copy_file_range (in_fd, &offset, pw->fd, NULL, n, 0);
+            if (ncopied > 0)
+            {
+                pw->nbytes += ncopied;
+                continue;
+            }
+            use_copy_range = false;
+            continue;
+        }
+        else if (use_sendfile)
+        {
+            ncopied = sendfile (pw->fd, in_fd, &offset, n);
+            if (ncopied > 0)
+            {
+                pw->nbytes += ncopied;
+                continue;
+            }
+            use_sendfile = false;
+            continue;
+        }
+        else
+        {
+            if (buf == NULL)
+            {
+                buf = malloc (PKG_COPY_BUFSIZE);
+                if (buf == NULL)
+                {
+                    sprintf (errmsg, "Allocating memory for the copy buffer");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+            }
+            ncopied = pread (in_fd, buf, n, offset);
+            if (ncopied > 0 && write_package_fd (pw, (uint8_t *) buf,
+                ncopied) != SUCCESS)
+            {  /* Error messages already written */
+                free (buf);
+                return (ERROR);
+            }
+            if (ncopied > 0)
+                pw->nbytes += ncopied;
+        }
+
+        if (ncopied < 0 && errno == EINTR)
+            continue;
+        if (ncopied <= 0)
+        {
+            sprintf (errmsg, "Reading %s into the archive %s", file_name,
+                pw->archive);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (buf);
+            return (ERROR);
+        }
+        if (pw->compress != PKG_COMPRESS_NONE)
+            pw->nbytes += ncopied;
+        offset += ncopied;
+    }
+
+    free (buf);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_tar_name
+
+PURPOSE: Sets the name of a member in a tar header, splitting a long name
+between the prefix and name fields.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name is too long for a ustar header
+SUCCESS         Successfully set the name
+
+NOTES:
+******************************************************************************/
+static int set_tar_name
+(
+    char *member_name,       /* I: name of the member */
+    Pkg_tar_header_t *hdr    /* I/O: tar header */
+)
+{
+    char FUNC_NAME[] = "set_tar_name";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t len = strlen (member_name);   /* length of the name */
+    size_t split;            /* length of the prefix */
+
+    if (len <= sizeof (hdr->name))
+    {
+        memcpy (hdr->name, member_name, len);
+        return (SUCCESS);
+    }
+
+    /* Split at the last '/' which leaves the name short enough */
+    for (split = len - 1; split > 0; split--)
+    {
+        if (member_name[split] == '/' &&
+            len - split - 1 <= sizeof (hdr->name) &&
+            split <= sizeof (hdr->prefix))
+            break;
+    }
+    if (split == 0 || len - split - 1 == 0)
+    {
+        sprintf (errmsg, "The name %s is too long for a tar header",
+            member_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memcpy (hdr->prefix, member_name, split);
+    memcpy (hdr->name, &member_name[split + 1], len - split - 1);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_package_file
+
+PURPOSE: Adds a file to the tar archive: its header, its data, and the
+padding to the end of its last block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error adding the file
+SUCCESS         Successfully added the file
+
+NOTES:
+  1. Sizes too large for the octal size field (8 GiB or more) are written in
+     base-256, as GNU tar does.
+******************************************************************************/
+static int add_package_file
+(
+    Pkg_writer_t *pw,        /* I/O: archive being written */
+    char *file_name,         /* I: name of the file on disk */
+    char *member_name        /* I: name of the file in the archive */
+)
+{
+    char FUNC_NAME[] = "add_package_file";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    unsigned int chksum = 0; /* sum of the bytes of the header */
+    int i;                   /* looping variable */
+    int in_fd;               /* file descriptor of the file */
+    int status;              /* return status */
+    off_t size;              /* size of the file, shifted for base-256 */
+    size_t npad;             /* padding after the data */
+    uint8_t zeros[PKG_TAR_BLOCK_SIZE];  /* padding */
+    struct stat st;          /* status of the file */
+    Pkg_tar_header_t hdr;    /* tar header of the file */
+
+    in_fd = open (file_name, O_RDONLY);
+    if (in_fd == -1 || fstat (in_fd, &st) == -1 || !S_ISREG (st.st_mode))
+    {
+        sprintf (errmsg, "Opening the file %s as a regular file", file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (in_fd != -1)
+            close (in_fd);
+        return (ERROR);
+    }
+
+    memset (&hdr, 0, sizeof (hdr));
+    if (set_tar_name (member_name, &hdr) != SUCCESS)
+    {  /* Error messages already written */
+        close (in_fd);
+        return (ERROR);
+    }
+    sprintf (hdr.mode, "%07o", (unsigned int) (st.st_mode & 07777));
+    sprintf (hdr.uid, "%07o", (unsigned int) (st.st_uid & 07777777));
+    sprintf (hdr.gid, "%07o", (unsigned int) (st.st_gid & 07777777));
+    if (st.st_size <= PKG_TAR_OCTAL_MAX)
+        sprintf (hdr.size, "%011lo", (unsigned long) st.st_size);
+    else
+    {
+        size = st.st_size;
+        for (i = sizeof (hdr.size) - 1; i > 0; i--, size >>= 8)
+            hdr.size[i] = (char) (size & 0xff);
+        hdr.size[0] = (char) 0x80;
+    }
+    sprintf (hdr.mtime, "%011lo", (unsigned long) st.st_mtime);
+    hdr.typeflag = '0';
+    memcpy (hdr.magic, "ustar", 6);
+    memcpy (hdr.version, "00", 2);
+
+    /* The checksum is found with its own field set to spaces */
+    memset (hdr.chksum, ' ', sizeof (hdr.chksum));
+    for (i = 0; i < sizeof (hdr); i++)
+        chksum += ((unsigned char *) &hdr)[i];
+    sprintf (hdr.chksum, "%06o", chksum);
+    hdr.chksum[7] = ' ';
+
+    status = write_package (pw, &hdr, sizeof (hdr));
+    if (status == SUCCESS)
+        status = copy_package_data (pw, in_fd, st.st_size, file_name);
+    close (in_fd);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Adding %s to the archive", file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    npad = (PKG_TAR_BLOCK_SIZE - pw->nbytes % PKG_TAR_BLOCK_SIZE) %
+        PKG_TAR_BLOCK_SIZE;
+    memset (zeros, 0, sizeof (zeros));
+    return (write_package (pw, zeros, npad));
+}
+
+
+/******************************************************************************
+MODULE:  add_product_file
+
+PURPOSE: Adds a file of the product, named relative to the directory of the
+XML file, to the tar archive under the prefix.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error adding the file
+SUCCESS         Successfully added the file
+
+NOTES:
+******************************************************************************/
+static int add_product_file
+(
+    Pkg_writer_t *pw,        /* I/O: archive being written */
+    char *xml_dir,           /* I: directory of the XML file */
+    char *file_name,         /* I: name of the file, relative to xml_dir */
+    char *prefix,            /* I: directory the file is archived under;
+                                   empty for none */
+    int *nfiles              /* I/O: number of files archived */
+)
+{
+    char FUNC_NAME[] = "add_product_file";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char src_file[STR_SIZE];     /* name of the file on disk */
+    char member_name[STR_SIZE];  /* name of the file in the archive */
+    int count;                   /* number of chars copied in snprintf */
+
+    count = snprintf (src_file, sizeof (src_file), "%s/%s", xml_dir,
+        file_name);
+    if (count < 0 || count >= sizeof (src_file))
+    {
+        sprintf (errmsg, "Overflow of src_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (member_name, sizeof (member_name), "%s%s%s", prefix,
+        (prefix[0] != '\0') ? "/" : "", file_name);
+    if (count < 0 || count >= sizeof (member_name))
+    {
+        sprintf (errmsg, "Overflow of member_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (add_package_file (pw, src_file, member_name) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    (*nfiles)++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_band_files
+
+PURPOSE: Adds the band files of the product and their ENVI headers to the
+tar archive.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error adding the files
+SUCCESS         Successfully added the files
+
+NOTES:
+  1. Band files shared by multiple bands are only added once.  Absolute band
+     filenames point outside the product, so they are left out with a
+     warning.
+******************************************************************************/
+static int add_band_files
+(
+    Pkg_writer_t *pw,        /* I/O: archive being written */
+    Espa_internal_meta_t *meta,  /* I: metadata of the product */
+    char *xml_dir,           /* I: directory of the XML file */
+    char *prefix,            /* I: directory the files are archived under */
+    int *nfiles              /* I/O: number of files archived */
+)
+{
+    char FUNC_NAME[] = "add_band_files";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char hdr_file[STR_SIZE];     /* ENVI header of the band file */
+    char src_file[STR_SIZE];     /* ENVI header on disk */
+    char *band_file = NULL;      /* band filename from the XML file */
+    char *cptr = NULL;           /* pointer to the file extension */
+    int i, j;                    /* looping variables for the bands */
+    int count;                   /* number of chars copied in snprintf */
+
+    for (i = 0; i < meta->nbands; i++)
+    {
+        band_file = meta->band[i].file_name;
+        if (band_file[0] == '/')
+        {
+            sprintf (errmsg, "Band file %s is outside the product and isn't "
+                "packaged", band_file);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        /* Skip band files which were already added */
+        for (j = 0; j < i; j++)
+        {
+            if (!strcmp (band_file, meta->band[j].file_name))
+                break;
+        }
+        if (j < i)
+            continue;
+
+        if (add_product_file (pw, xml_dir, band_file, prefix, nfiles)
+            != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        /* Add the ENVI header for the band file, if it exists */
+        count = snprintf (hdr_file, sizeof (hdr_file), "%s", band_file);
+        cptr = strrchr (hdr_file, '.');
+        if (count < 0 || count + 4 >= sizeof (hdr_file) || cptr == NULL ||
+            strchr (cptr, '/') != NULL)
+            continue;
+        strcpy (cptr, ".hdr");
+        count = snprintf (src_file, sizeof (src_file), "%s/%s", xml_dir,
+            hdr_file);
+        if (count < 0 || count >= sizeof (src_file) ||
+            access (src_file, F_OK) != 0)
+            continue;
+
+        if (add_product_file (pw, xml_dir, hdr_file, prefix, nfiles)
+            != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  package_espa_product
+
+PURPOSE: Packages the files of a product as a tar archive, optionally
+compressed with gzip.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error packaging the product
+SUCCESS         Successfully packaged the product
+
+NOTES:
+  1. The XML file is archived first, then the band files and their ENVI
+     headers in band order, then the valid mask of the scene if it has
+     one.
+******************************************************************************/
+int package_espa_product
+(
+    char *espa_xml_file,     /* I: input ESPA XML metadata filename */
+    char *archive,           /* I: output archive; "-" for the standard
+                                   output */
+    Pkg_options_t *opts,     /* I: options of the package */
+    int *nfiles              /* O: number of files archived */
+)
+{
+    char FUNC_NAME[] = "package_espa_product";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char xml_dir[STR_SIZE];      /* directory of the XML file */
+    char xml_base[STR_SIZE];     /* name of the XML file in its directory */
+    char *valid_mask = NULL;     /* valid mask of the scene */
+    char *cptr = NULL;           /* last '/' of the XML filename */
+    int b;                       /* looping variable for the blocks */
+    int count;                   /* number of chars copied in snprintf */
+    int status = SUCCESS;        /* return status */
+    uint8_t zeros[2 * PKG_TAR_BLOCK_SIZE];  /* end of the archive */
+    struct stat st;              /* status of the archive */
+    Pkg_writer_t pw;             /* archive being written */
+    Espa_internal_meta_t meta;   /* metadata of the product */
+
+    *nfiles = 0;
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    init_metadata_struct (&meta);
+    if (parse_metadata (espa_xml_file, &meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Split the XML filename into its directory and name */
+    count = snprintf (xml_dir, sizeof (xml_dir), "%s", espa_xml_file);
+    if (count < 0 || count >= sizeof (xml_dir))
+    {
+        sprintf (errmsg, "Overflow of xml_dir string");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&meta);
+        return (ERROR);
+    }
+    cptr = strrchr (xml_dir, '/');
+    if (cptr == NULL)
+    {
+        strcpy (xml_base, xml_dir);
+        strcpy (xml_dir, ".");
+    }
+    else
+    {
+        strcpy (xml_base, cptr + 1);
+        *cptr = '\0';
+        if (xml_dir[0] == '\0')
+            strcpy (xml_dir, "/");
+    }
+
+    /* Set up the archive */
+    memset (&pw, 0, sizeof (pw));
+    pw.archive = archive;
+    pw.compress = opts->compress;
+    pw.level = opts->level;
+    if (!strcmp (archive, "-"))
+        pw.fd = STDOUT_FILENO;
+    else
+        pw.fd = open (archive, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (pw.fd == -1 || fstat (pw.fd, &st) == -1)
+    {
+        sprintf (errmsg, "Opening the archive %s", archive);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&meta);
+        return (ERROR);
+    }
+    pw.is_file = S_ISREG (st.st_mode);
+
+    if (pw.compress != PKG_COMPRESS_NONE)
+    {
+        pw.nblocks = espa_task_nthreads ();
+        pw.comp_bound = compressBound (PKG_GZIP_BLOCK_SIZE) + 32;
+        pw.in_buf = malloc ((size_t) pw.nblocks * PKG_GZIP_BLOCK_SIZE);
+        pw.comp_buf = calloc (pw.nblocks, sizeof (uint8_t *));
+        pw.comp_len = calloc (pw.nblocks, sizeof (size_t));
+        if (pw.in_buf == NULL || pw.comp_buf == NULL || pw.comp_len == NULL)
+            status = ERROR;
+        for (b = 0; b < pw.nblocks && status == SUCCESS; b++)
+        {
+            pw.comp_buf[b] = malloc (pw.comp_bound);
+            if (pw.comp_buf[b] == NULL)
+                status = ERROR;
+        }
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Allocating memory for compressing the archive");
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+    }
+
+    /* Add the files of the product */
+    if (status == SUCCESS)
+        status = add_product_file (&pw, xml_dir, xml_base, opts->prefix,
+            nfiles);
+    if (status == SUCCESS)
+        status = add_band_files (&pw, &meta, xml_dir, opts->prefix, nfiles);
+    valid_mask = meta.global.valid_mask;
+    if (status == SUCCESS && strcmp (valid_mask, ESPA_STRING_META_FILL))
+    {
+        if (valid_mask[0] == '/')
+        {
+            sprintf (errmsg, "Valid mask %s is outside the product and isn't "
+                "packaged", valid_mask);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+        else
+            status = add_product_file (&pw, xml_dir, valid_mask,
+                opts->prefix, nfiles);
+    }
+
+    /* End the archive with two zero blocks */
+    memset (zeros, 0, sizeof (zeros));
+    if (status == SUCCESS)
+        status = write_package (&pw, zeros, sizeof (zeros));
+    if (status == SUCCESS && pw.compress != PKG_COMPRESS_NONE)
+        status = flush_package (&pw);
+
+    if (pw.fd != STDOUT_FILENO && close (pw.fd) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing the archive %s", archive);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Packaging %s into %s", espa_xml_file, archive);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    for (b = 0; b < pw.nblocks && pw.comp_buf != NULL; b++)
+        free (pw.comp_buf[b]);
+    free (pw.comp_buf);
+    free (pw.comp_len);
+    free (pw.in_buf);
+    free_metadata (&meta);
+
+    return (status);
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+FILE: espa_package.h
+
+PURPOSE: Contains defines, structures and prototypes for packaging the files
+of a product as a tar archive for delivery, without staging them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The archive holds the XML file, the band files and their ENVI headers,
+     and the valid mask of the scene, under the names the XML file refers
+     to them by, so the XML file remains valid once the archive is
+     extracted.  The tar headers (POSIX ustar) are written here rather than
+     by the tar command.
+  2. Uncompressed, the file data is copied into the archive in the kernel
+     with copy_file_range, or sendfile if the archive isn't a regular file
+     (e.g. a pipe), so it's never read into user space.
+  3. Compressed, the archive is split into PKG_GZIP_BLOCK_SIZE blocks which
+     are deflated in parallel by the task runtime (see espa_task.h), each as
+     its own gzip member.  Concatenated gzip members are a valid gzip file,
+     which gzip, tar and open_lpgs_bundle read as a single stream.
+*****************************************************************************/
+
+#ifndef ESPA_PACKAGE_H
+#define ESPA_PACKAGE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+
+/* Defines */
+/* Size of the tar header and data blocks */
+#define PKG_TAR_BLOCK_SIZE 512
+
+/* Size of the blocks of the archive which are compressed in parallel, each
+   as its own gzip member */
+#define PKG_GZIP_BLOCK_SIZE (4 * 1024 * 1024)
+
+/* Default deflate level of the compressed archive */
+#define PKG_GZIP_LEVEL 6
+
+/* Type definitions */
+/* Compression of the archive */
+typedef enum
+{
+    PKG_COMPRESS_NONE,       /* tar archive */
+    PKG_COMPRESS_GZIP        /* gzip-compressed tar archive */
+} Pkg_compress_t;
+
+/* Options of the package */
+typedef struct
+{
+    Pkg_compress_t compress;     /* compression of the archive */
+    int level;                   /* deflate level of the compressed
+                                    archive */
+    char prefix[STR_SIZE];       /* directory the files are archived under;
+                                    empty for none */
+} Pkg_options_t;
+
+/* Prototypes */
+int package_espa_product
+(
+    char *espa_xml_file,     /* I: input ESPA XML metadata filename */
+    char *archive,           /* I: output archive; "-" for the standard
+                                   output */
+    Pkg_options_t *opts,     /* I: options of the package */
+    int *nfiles              /* O: number of files archived */
+);
+
+#endif
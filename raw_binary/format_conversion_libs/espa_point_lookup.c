@@ -0,0 +1,390 @@
+/*****************************************************************************
+FILE: espa_point_lookup.c
+
+PURPOSE: Contains functions for mapping many geographic points to the lines
+and samples of the products in an ESPA catalog.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The points are sorted by longitude once, so the points inside the
+     bounding coordinates of a product are found with a binary search rather
+     than by testing every point against every product.
+  2. The products are mapped one after the other.  GCTP isn't re-entrant,
+     and the projection setups are already shared between the products in
+     the same projection by the setup_mapping cache.
+*****************************************************************************/
+#include <math.h>
+#include "espa_point_lookup.h"
+#include "parse_metadata.h"
+
+/* Point in longitude order */
+typedef struct
+{
+    double lon;                  /* longitude of the point (degrees) */
+    int point;                   /* index of the point */
+} Point_order_t;
+
+
+/******************************************************************************
+MODULE:  compare_point_lon
+
+PURPOSE: Orders the points by longitude, for qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+< 0             The first point is west of the second
+0               The points have the same longitude
+> 0             The first point is east of the second
+
+NOTES:
+******************************************************************************/
+static int compare_point_lon
+(
+    const void *first,           /* I: first point (Point_order_t) */
+    const void *second           /* I: second point (Point_order_t) */
+)
+{
+    const Point_order_t *point1 = first;   /* first point */
+    const Point_order_t *point2 = second;  /* second point */
+
+    if (point1->lon < point2->lon)
+        return -1;
+    if (point1->lon > point2->lon)
+        return 1;
+    return point1->point - point2->point;
+}
+
+
+/******************************************************************************
+MODULE:  find_scene_points
+
+PURPOSE: Finds the points inside a range of longitudes and latitudes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+>= 0            Number of points added to candidates
+
+NOTES:
+  1. order must be sorted by longitude.  The points found are appended to
+     candidates, which must have room for all the points.
+******************************************************************************/
+static int find_scene_points
+(
+    const Point_order_t *order,  /* I: points sorted by longitude */
+    int npoints,                 /* I: number of points */
+    const Espa_point_t *points,  /* I: points to be looked up */
+    double west,                 /* I: western longitude of the range */
+    double east,                 /* I: eastern longitude of the range */
+    double north,                /* I: northern latitude of the range */
+    double south,                /* I: southern latitude of the range */
+    int *candidates              /* O: indexes of the points found */
+)
+{
+    int low = 0;                 /* first point which may be in the range */
+    int high = npoints;          /* point past the last point searched */
+    int mid;                     /* middle point of the search */
+    int i;                       /* looping variable */
+    int count = 0;               /* number of points found */
+    const Espa_point_t *point;   /* current point */
+
+    /* Find the first point at or east of the western longitude */
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (order[mid].lon < west)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (i = low; i < npoints && order[i].lon <= east; i++)
+    {
+        point = &points[order[i].point];
+        if (point->lat <= north && point->lat >= south)
+            candidates[count++] = order[i].point;
+    }
+
+    return count;
+}
+
+
+/******************************************************************************
+MODULE:  map_scene_points
+
+PURPOSE: Maps the points found inside the bounding coordinates of a product
+to its lines and samples.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the XML file or mapping the points
+SUCCESS         The points were mapped
+
+NOTES:
+  1. The image size checked is that of the band used by get_geoloc_info,
+     which is band1 of Level-1 products or else the first band.
+******************************************************************************/
+static int map_scene_points
+(
+    const char *xml_file,        /* I: XML file of the product */
+    const Espa_point_t *points,  /* I: points to be looked up */
+    int ncandidates,             /* I: number of points to be mapped */
+    const int *candidates,       /* I: indexes of the points to be mapped */
+    Geo_coord_t *geo,            /* I: room for the geodetic coordinates of
+                                       the points */
+    Img_coord_float_t *img,      /* I: room for the image coordinates of the
+                                       points */
+    Espa_point_match_t *matches  /* O: locations of the points, without the
+                                       scene index */
+)
+{
+    char FUNC_NAME[] = "map_scene_points";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata of the product */
+    Space_def_t space_def;       /* space definition of the product */
+    Geoloc_t *space = NULL;      /* geolocation of the product */
+    int i;                       /* looping variable */
+    int status = SUCCESS;        /* return status */
+
+    /* Only the global metadata and the band sizes are needed */
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata_lazy ((char *) xml_file, &xml_metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Parsing the XML file %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    if (!get_geoloc_info (&xml_metadata, &space_def))
+    {
+        sprintf (errmsg, "Getting the space definition of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else
+    {
+        space = setup_mapping (&space_def);
+        if (space == NULL)
+        {
+            sprintf (errmsg, "Setting up the mapping of %s", xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < ncandidates; i++)
+        {
+            geo[i].lat = points[candidates[i]].lat * RAD;
+            geo[i].lon = points[candidates[i]].lon * RAD;
+            geo[i].is_fill = false;
+        }
+
+        if (!to_space_batch (space, ncandidates, geo, img))
+        {
+            sprintf (errmsg, "Mapping %d points to %s", ncandidates,
+                xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < ncandidates; i++)
+        {
+            matches[i].point = candidates[i];
+            matches[i].line = img[i].l;
+            matches[i].samp = img[i].s;
+            matches[i].in_bounds = !img[i].is_fill &&
+                img[i].l >= 0.0 && img[i].l < space_def.img_size.l &&
+                img[i].s >= 0.0 && img[i].s < space_def.img_size.s;
+        }
+    }
+
+    free (space);
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  lookup_catalog_points
+
+PURPOSE: Maps a set of geographic points to the lines and samples of the
+products in a catalog.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error searching the catalog, allocating memory or mapping the
+                points
+SUCCESS         The points were looked up
+
+NOTES:
+  1. A location is returned for each point inside the bounding coordinates
+     of a product, grouped by product in catalog order and in longitude
+     order within a product.  in_bounds tells whether the point falls on a
+     pixel of the product, since the bounding coordinates are a box around
+     the image.  The pixel of a point is (int) line, (int) samp.
+  2. Bounding coordinates with a western longitude greater than the eastern
+     one are taken to cross the antimeridian.
+  3. The products whose XML file can't be read, such as those removed since
+     the catalog was updated, are skipped with a warning.
+******************************************************************************/
+int lookup_catalog_points
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const Espa_catalog_query_t *query,  /* I: products to be searched; NULL
+                                        for all the products */
+    int npoints,                  /* I: number of points */
+    const Espa_point_t *points,   /* I: points to be looked up */
+    Espa_point_match_t **matches, /* O: locations of the points in the
+                                        products, grouped by product; must
+                                        be freed by the caller */
+    int *nmatches                 /* O: number of locations */
+)
+{
+    char FUNC_NAME[] = "lookup_catalog_points";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int *scenes = NULL;          /* indexes of the scenes searched */
+    int nscenes = 0;             /* number of scenes searched */
+    int *candidates = NULL;      /* points inside the bounding coordinates */
+    int ncandidates;             /* number of points inside the bounding
+                                    coordinates */
+    Point_order_t *order = NULL; /* points sorted by longitude */
+    Geo_coord_t *geo = NULL;     /* geodetic coordinates of the candidates */
+    Img_coord_float_t *img = NULL;  /* image coordinates of the candidates */
+    Espa_point_match_t *new_matches;  /* reallocated locations */
+    int max_matches = 0;         /* number of locations allocated */
+    const Espa_catalog_scene_t *scene;  /* current scene record */
+    const double *bounds;        /* bounding coordinates of the scene */
+    const char *xml_file;        /* XML file of the scene */
+    int i, j;                    /* looping variables */
+    int status = SUCCESS;        /* return status */
+
+    *matches = NULL;
+    *nmatches = 0;
+    if (npoints <= 0)
+        return (SUCCESS);
+
+    /* Find the scenes to be searched */
+    if (query != NULL)
+    {
+        if (query_espa_catalog (catalog, query, &scenes, &nscenes) != SUCCESS)
+        {
+            sprintf (errmsg, "Querying the catalog");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        nscenes = catalog->nscenes;
+        scenes = malloc ((nscenes > 0 ? nscenes : 1) * sizeof (int));
+        if (scenes == NULL)
+        {
+            sprintf (errmsg, "Allocating the scene list");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (i = 0; i < nscenes; i++)
+            scenes[i] = i;
+    }
+
+    order = malloc (npoints * sizeof (Point_order_t));
+    candidates = malloc (npoints * sizeof (int));
+    geo = malloc (npoints * sizeof (Geo_coord_t));
+    img = malloc (npoints * sizeof (Img_coord_float_t));
+    if (order == NULL || candidates == NULL || geo == NULL || img == NULL)
+    {
+        sprintf (errmsg, "Allocating the work arrays for %d points", npoints);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+        goto cleanup;
+    }
+
+    for (i = 0; i < npoints; i++)
+    {
+        order[i].lon = points[i].lon;
+        order[i].point = i;
+    }
+    qsort (order, npoints, sizeof (Point_order_t), compare_point_lon);
+
+    for (i = 0; i < nscenes; i++)
+    {
+        scene = &catalog->scene[scenes[i]];
+        bounds = scene->bounding_coords;
+        if (bounds[0] <= bounds[1])
+            ncandidates = find_scene_points (order, npoints, points,
+                bounds[0], bounds[1], bounds[2], bounds[3], candidates);
+        else
+        {
+            ncandidates = find_scene_points (order, npoints, points,
+                bounds[0], 180.0, bounds[2], bounds[3], candidates);
+            ncandidates += find_scene_points (order, npoints, points,
+                -180.0, bounds[1], bounds[2], bounds[3],
+                &candidates[ncandidates]);
+        }
+        if (ncandidates == 0)
+            continue;
+
+        /* Make room for the locations of the scene */
+        if (*nmatches + ncandidates > max_matches)
+        {
+            max_matches = 2 * max_matches;
+            if (max_matches < *nmatches + ncandidates)
+                max_matches = *nmatches + ncandidates;
+            new_matches = realloc (*matches,
+                max_matches * sizeof (Espa_point_match_t));
+            if (new_matches == NULL)
+            {
+                sprintf (errmsg, "Allocating %d point locations",
+                    max_matches);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                goto cleanup;
+            }
+            *matches = new_matches;
+        }
+
+        xml_file = get_catalog_xml_file (catalog, scenes[i]);
+        if (map_scene_points (xml_file, points, ncandidates, candidates, geo,
+            img, &(*matches)[*nmatches]) != SUCCESS)
+        {
+            sprintf (errmsg, "Skipping the product %s", xml_file);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        for (j = 0; j < ncandidates; j++)
+            (*matches)[*nmatches + j].scene = scenes[i];
+        *nmatches += ncandidates;
+    }
+
+cleanup:
+    free (scenes);
+    free (order);
+    free (candidates);
+    free (geo);
+    free (img);
+    if (status != SUCCESS)
+    {
+        free (*matches);
+        *matches = NULL;
+        *nmatches = 0;
+    }
+    return (status);
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+FILE: espa_point_lookup.h
+
+PURPOSE: Contains structures and prototypes for mapping many geographic
+points to the lines and samples of the products in an ESPA catalog.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The points are grouped by product using the bounding coordinates in the
+     catalog, so only the XML files of the products with points inside their
+     bounding coordinates are parsed, and each of them is mapped once for
+     all of its points through to_space_batch.
+*****************************************************************************/
+
+#ifndef ESPA_POINT_LOOKUP_H
+#define ESPA_POINT_LOOKUP_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_catalog.h"
+#include "espa_geoloc.h"
+
+/* Type definitions */
+/* Geographic point to be looked up */
+typedef struct
+{
+    double lat;                  /* latitude (degrees) */
+    double lon;                  /* longitude (degrees) */
+} Espa_point_t;
+
+/* Location of a point in a product */
+typedef struct
+{
+    int point;                   /* index of the point */
+    int scene;                   /* index of the scene record of the product
+                                    in the catalog */
+    double line;                 /* line of the point, from the UL corner of
+                                    the UL pixel */
+    double samp;                 /* sample of the point, from the UL corner
+                                    of the UL pixel */
+    bool in_bounds;              /* is the point inside the lines and samples
+                                    of the product? */
+} Espa_point_match_t;
+
+/* Prototypes */
+int lookup_catalog_points
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const Espa_catalog_query_t *query,  /* I: products to be searched; NULL
+                                        for all the products */
+    int npoints,                  /* I: number of points */
+    const Espa_point_t *points,   /* I: points to be looked up */
+    Espa_point_match_t **matches, /* O: locations of the points in the
+                                        products, grouped by product; must
+                                        be freed by the caller */
+    int *nmatches                 /* O: number of locations */
+);
+
+#endif
@@ -0,0 +1,1685 @@
+/*****************************************************************************
+FILE: espa_reproject.c
+
+PURPOSE: Contains functions for reprojecting and resampling the bands of a
+scene onto the grid of a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The tiles of each strip of the output are resampled concurrently by the
+     task pool (see espa_task.h).  Each runner keeps its own input file and
+     window, so the input held in memory is bounded by REPROJ_MAX_WINDOW
+     pixels per runner.
+  3. The bilinear and cubic convolution kernels sum the rows of the kernel
+     with SSE2 when it is available.  The scalar kernel uses the same float
+     operations in the same order, so the output doesn't depend on which was
+     used.
+*****************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "espa_reproject.h"
+#include "espa_memory.h"
+#include "espa_task.h"
+#include "raw_binary_pool.h"
+
+/******************************************************************************
+MODULE:  get_reproject_footprint
+
+PURPOSE: Determines the range of lines and samples of the output grid covered
+by an input scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the edges of the input scene
+SUCCESS         Successfully determined the footprint
+
+NOTES:
+  1. The edges of the input scene are mapped at REPROJ_EDGE_POINTS points
+     each, since they are curved on the output grid in most projections.
+     The range is in image coordinates of the pixel edges, and can extend
+     beyond the output grid.
+******************************************************************************/
+int get_reproject_footprint
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    double *min_line,        /* O: first line covered */
+    double *max_line,        /* O: last line covered */
+    double *min_samp,        /* O: first sample covered */
+    double *max_samp         /* O: last sample covered */
+)
+{
+    char FUNC_NAME[] = "get_reproject_footprint";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int npts = 4 * REPROJ_EDGE_POINTS;  /* number of edge points */
+    int nlines = in_space->def.img_size.l;  /* lines in the input scene */
+    int nsamps = in_space->def.img_size.s;  /* samples in the input scene */
+    int i;                   /* looping variable */
+    int status = SUCCESS;    /* return status */
+    double t;                /* position along an edge, from 0 to 1 */
+    Img_coord_float_t *img = NULL;  /* image coordinates of the edges */
+    Geo_coord_t *geo = NULL; /* geodetic coordinates of the edges */
+
+    img = calloc (npts, sizeof (Img_coord_float_t));
+    geo = calloc (npts, sizeof (Geo_coord_t));
+    if (img == NULL || geo == NULL)
+    {
+        free (img);
+        free (geo);
+        sprintf (errmsg, "Allocating memory for the edge points");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < REPROJ_EDGE_POINTS; i++)
+    {
+        t = (double) i / (REPROJ_EDGE_POINTS - 1);
+        img[i].l = 0.0;
+        img[i].s = t * nsamps;
+        img[REPROJ_EDGE_POINTS + i].l = nlines;
+        img[REPROJ_EDGE_POINTS + i].s = t * nsamps;
+        img[2*REPROJ_EDGE_POINTS + i].l = t * nlines;
+        img[2*REPROJ_EDGE_POINTS + i].s = 0.0;
+        img[3*REPROJ_EDGE_POINTS + i].l = t * nlines;
+        img[3*REPROJ_EDGE_POINTS + i].s = nsamps;
+    }
+    for (i = 0; i < npts; i++)
+        img[i].is_fill = false;
+
+    if (from_space_batch (in_space, npts, img, geo) &&
+        to_space_batch (out_space, npts, geo, img))
+    {
+        *min_line = *max_line = img[0].l;
+        *min_samp = *max_samp = img[0].s;
+        for (i = 1; i < npts; i++)
+        {
+            *min_line = min (*min_line, img[i].l);
+            *max_line = max (*max_line, img[i].l);
+            *min_samp = min (*min_samp, img[i].s);
+            *max_samp = max (*max_samp, img[i].s);
+        }
+    }
+    else
+    {
+        sprintf (errmsg, "Mapping the edges of the input scene to the "
+            "output grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    free (img);
+    free (geo);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_reproject_grid
+
+PURPOSE: Determines the output grid from the template product, covering the
+input scenes or the template.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the grid
+SUCCESS         Successfully determined the grid
+
+NOTES:
+  1. The grid has the projection, orientation and pixel alignment of the
+     representative band of the template.  Unless the extent of the
+     template is used, it is the smallest window of the template grid,
+     extended as needed, covering the footprints of all the input scenes.
+******************************************************************************/
+int get_reproject_grid
+(
+    int nscenes,             /* I: number of input scenes */
+    Geoloc_t **in_space,     /* I: geolocation of each input scene */
+    Espa_internal_meta_t *template_meta,  /* I: metadata of the template
+                                   product giving the output projection */
+    double pixel_size,       /* I: output pixel size; 0 for the pixel size
+                                   of the template */
+    bool template_extent,    /* I: use the extent of the template, rather
+                                   than the extent of the input scenes on
+                                   the template grid? */
+    Space_def_t *grid        /* O: output grid */
+)
+{
+    char FUNC_NAME[] = "get_reproject_grid";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the scenes */
+    double min_line = 0.0, max_line = 0.0;  /* line range of the scenes */
+    double min_samp = 0.0, max_samp = 0.0;  /* sample range of the scenes */
+    double line[2], samp[2]; /* line and sample range of a scene */
+    double line0, samp0;     /* first line and sample of the grid */
+    Geoloc_t *out_space = NULL;  /* geolocation of the template grid */
+
+    if (!get_geoloc_info (template_meta, grid))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the "
+            "template metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Change the pixel size, keeping the extent of the template */
+    if (pixel_size > 0.0)
+    {
+        grid->img_size.l = (int) ceil (grid->img_size.l *
+            grid->pixel_size[1] / pixel_size - SUBSET_WINDOW_TOL);
+        grid->img_size.s = (int) ceil (grid->img_size.s *
+            grid->pixel_size[0] / pixel_size - SUBSET_WINDOW_TOL);
+        grid->pixel_size[0] = pixel_size;
+        grid->pixel_size[1] = pixel_size;
+    }
+
+    if (template_extent)
+        return (SUCCESS);
+
+    /* Combine the footprints of the input scenes on the template grid */
+    out_space = setup_mapping (grid);
+    if (out_space == NULL)
+    {
+        sprintf (errmsg, "Setting up the mapping structure of the template "
+            "grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nscenes; i++)
+    {
+        if (get_reproject_footprint (in_space[i], out_space, &line[0],
+            &line[1], &samp[0], &samp[1]) != SUCCESS)
+        {
+            sprintf (errmsg, "Determining the footprint of input scene %d",
+                i + 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (out_space);
+            return (ERROR);
+        }
+
+        if (i == 0)
+        {
+            min_line = line[0];
+            max_line = line[1];
+            min_samp = samp[0];
+            max_samp = samp[1];
+            continue;
+        }
+        min_line = min (min_line, line[0]);
+        max_line = max (max_line, line[1]);
+        min_samp = min (min_samp, samp[0]);
+        max_samp = max (max_samp, samp[1]);
+    }
+
+    /* Snap the extent to the template grid */
+    line0 = floor (min_line + SUBSET_WINDOW_TOL);
+    samp0 = floor (min_samp + SUBSET_WINDOW_TOL);
+    max_line = ceil (max_line - SUBSET_WINDOW_TOL);
+    max_samp = ceil (max_samp - SUBSET_WINDOW_TOL);
+    if (nscenes < 1 || max_line - line0 < 1.0 || max_samp - samp0 < 1.0 ||
+        max_line - line0 > INT_MAX || max_samp - samp0 > INT_MAX)
+    {
+        sprintf (errmsg, "Invalid extent of the input scenes on the template "
+            "grid: %g lines x %g samples", max_line - line0,
+            max_samp - samp0);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (out_space);
+        return (ERROR);
+    }
+
+    window_to_map (out_space, line0, samp0, &grid->ul_corner.x,
+        &grid->ul_corner.y);
+    grid->img_size.l = (int) (max_line - line0);
+    grid->img_size.s = (int) (max_samp - samp0);
+
+    free (out_space);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_reproject_band
+
+PURPOSE: Sets up the resampling of an input band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A band without a pixel size is assumed to have the pixel size of the
+     representative band.
+******************************************************************************/
+void init_reproject_band
+(
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Reproj_band_t *band      /* O: input band being resampled */
+)
+{
+    band->bmeta = bmeta;
+    band->size = get_data_type_size (bmeta->data_type);
+    band->method = bmeta->resample_method;
+    if (band->method != ESPA_BI && band->method != ESPA_CC)
+        band->method = ESPA_NN;
+    band->has_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    band->fill = (float) bmeta->fill_value;
+
+    band->line_scale = 1.0;
+    band->samp_scale = 1.0;
+    if (bmeta->pixel_size[0] > 0.0 && bmeta->pixel_size[1] > 0.0)
+    {
+        band->samp_scale = in_space->def.pixel_size[0] / bmeta->pixel_size[0];
+        band->line_scale = in_space->def.pixel_size[1] / bmeta->pixel_size[1];
+    }
+}
+
+
+/******************************************************************************
+MODULE:  get_node_pos
+
+PURPOSE: Returns the line or sample of an exactly mapped pixel of a tile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0 - n-1         Line or sample within the tile
+
+NOTES:
+  1. The last node is on the last line or sample of the tile.
+******************************************************************************/
+static int get_node_pos
+(
+    int node,            /* I: node number */
+    int n                /* I: number of lines or samples in the tile */
+)
+{
+    return (min (node * REPROJ_GRID_STEP, n - 1));
+}
+
+
+/******************************************************************************
+MODULE:  map_reproject_tile
+
+PURPOSE: Determines the input location of each pixel of an output tile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The tile is too large
+SUCCESS         Successfully mapped the tile
+
+NOTES:
+  1. The centers of the pixels every REPROJ_GRID_STEP lines and samples, and
+     on the last line and sample, are mapped exactly and the rest are
+     interpolated bilinearly.
+  2. Normally the nodes are mapped in one batch.  If a node can't be mapped,
+     such as outside the valid area of a projection, the nodes are mapped
+     one by one without reporting the failures, and the pixels next to the
+     failed nodes are NAN.
+******************************************************************************/
+int map_reproject_tile
+(
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    int line0,               /* I: first output line of the tile */
+    int samp0,               /* I: first output sample of the tile */
+    int nlines,              /* I: number of lines in the tile */
+    int nsamps,              /* I: number of samples in the tile */
+    float *in_line,          /* O: input line of each tile pixel; NAN if it
+                                   couldn't be mapped */
+    float *in_samp           /* O: input sample of each tile pixel; NAN if it
+                                   couldn't be mapped */
+)
+{
+    char FUNC_NAME[] = "map_reproject_tile";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nrows;               /* number of node rows */
+    int ncols;               /* number of node columns */
+    int nnodes;              /* number of nodes */
+    int row, col;            /* node row and column of a pixel's cell */
+    int row1, col1;          /* node row and column after the cell */
+    int top, bottom;         /* lines of the top and bottom of the cell */
+    int left, right;         /* samples of the left and right of the cell */
+    int line, samp;          /* current line and sample in the tile */
+    int i;                   /* looping variable */
+    double lt, ls;           /* fractional line, sample in the cell */
+    const double *nl[4];     /* input lines of the cell corners */
+    const double *ns[4];     /* input samples of the cell corners */
+    Img_coord_float_t img[REPROJ_MAX_NODES];  /* image coordinates */
+    Geo_coord_t geo[REPROJ_MAX_NODES];        /* geodetic coordinates */
+    double node_line[REPROJ_MAX_NODES];  /* input line of each node */
+    double node_samp[REPROJ_MAX_NODES];  /* input sample of each node */
+
+    if (nlines < 1 || nsamps < 1 || nlines > REPROJ_TILE_SIZE ||
+        nsamps > REPROJ_TILE_SIZE)
+    {
+        sprintf (errmsg, "Invalid tile size: %d lines x %d samples", nlines,
+            nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Map the nodes */
+    nrows = (nlines - 1 + REPROJ_GRID_STEP - 1) / REPROJ_GRID_STEP + 1;
+    ncols = (nsamps - 1 + REPROJ_GRID_STEP - 1) / REPROJ_GRID_STEP + 1;
+    nnodes = nrows * ncols;
+    for (row = 0; row < nrows; row++)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            i = row * ncols + col;
+            img[i].l = line0 + get_node_pos (row, nlines) + 0.5;
+            img[i].s = samp0 + get_node_pos (col, nsamps) + 0.5;
+            img[i].is_fill = false;
+        }
+    }
+
+    set_error_deferred (true);
+    if (from_space_batch (out_space, nnodes, img, geo) &&
+        to_space_batch (in_space, nnodes, geo, img))
+    {
+        for (i = 0; i < nnodes; i++)
+        {
+            node_line[i] = img[i].l;
+            node_samp[i] = img[i].s;
+        }
+    }
+    else
+    {
+        for (row = 0; row < nrows; row++)
+        {
+            for (col = 0; col < ncols; col++)
+            {
+                i = row * ncols + col;
+                img[i].l = line0 + get_node_pos (row, nlines) + 0.5;
+                img[i].s = samp0 + get_node_pos (col, nsamps) + 0.5;
+                img[i].is_fill = false;
+                if (from_space (out_space, &img[i], &geo[i]) &&
+                    to_space (in_space, &geo[i], &img[i]))
+                {
+                    node_line[i] = img[i].l;
+                    node_samp[i] = img[i].s;
+                }
+                else
+                {
+                    node_line[i] = NAN;
+                    node_samp[i] = NAN;
+                }
+            }
+        }
+        clear_thread_errors ();
+    }
+    set_error_deferred (false);
+
+    /* Interpolate the pixels within each cell of nodes */
+    for (line = 0; line < nlines; line++)
+    {
+        row = min (line / REPROJ_GRID_STEP, max (nrows - 2, 0));
+        row1 = min (row + 1, nrows - 1);
+        top = get_node_pos (row, nlines);
+        bottom = get_node_pos (row1, nlines);
+        lt = (bottom > top) ? (double) (line - top) / (bottom - top) : 0.0;
+
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            col = min (samp / REPROJ_GRID_STEP, max (ncols - 2, 0));
+            col1 = min (col + 1, ncols - 1);
+            left = get_node_pos (col, nsamps);
+            right = get_node_pos (col1, nsamps);
+            ls = (right > left) ? (double) (samp - left) / (right - left) :
+                0.0;
+
+            nl[0] = &node_line[row * ncols + col];
+            nl[1] = &node_line[row * ncols + col1];
+            nl[2] = &node_line[row1 * ncols + col];
+            nl[3] = &node_line[row1 * ncols + col1];
+            ns[0] = &node_samp[row * ncols + col];
+            ns[1] = &node_samp[row * ncols + col1];
+            ns[2] = &node_samp[row1 * ncols + col];
+            ns[3] = &node_samp[row1 * ncols + col1];
+
+            i = line * nsamps + samp;
+            if (isnan (*nl[0]) || isnan (*nl[1]) || isnan (*nl[2]) ||
+                isnan (*nl[3]))
+            {
+                in_line[i] = NAN;
+                in_samp[i] = NAN;
+                continue;
+            }
+
+            in_line[i] = (1.0 - lt) * (*nl[0] + ls * (*nl[1] - *nl[0])) +
+                lt * (*nl[2] + ls * (*nl[3] - *nl[2]));
+            in_samp[i] = (1.0 - lt) * (*ns[0] + ls * (*ns[1] - *ns[0])) +
+                lt * (*ns[2] + ls * (*ns[3] - *ns[2]));
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_reproject_location
+
+PURPOSE: Scales an input location to a band and checks that it is within the
+band.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The location is outside the band or couldn't be mapped
+true            The location is within the band
+
+NOTES:
+******************************************************************************/
+bool get_reproject_location
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    float in_line,           /* I: input line */
+    float in_samp,           /* I: input sample */
+    double *line,            /* O: line in the band */
+    double *samp             /* O: sample in the band */
+)
+{
+    if (isnan (in_line) || isnan (in_samp))
+        return (false);
+
+    *line = in_line * band->line_scale;
+    *samp = in_samp * band->samp_scale;
+    return (*line >= 0.0 && *samp >= 0.0 && *line < band->bmeta->nlines &&
+        *samp < band->bmeta->nsamps);
+}
+
+
+/******************************************************************************
+MODULE:  get_reproject_window
+
+PURPOSE: Determines the window of an input band needed to resample part of an
+output tile.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           No pixel of the part is within the band; the window is
+                empty
+true            The window was determined
+
+NOTES:
+  1. The window covers the kernels of all the pixels, clipped to the band.
+******************************************************************************/
+bool get_reproject_window
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    int nlines,              /* I: number of lines in the part of the tile */
+    int nsamps,              /* I: number of samples in the part */
+    const float *in_line,    /* I: input line of each pixel of the part */
+    const float *in_samp,    /* I: input sample of each pixel of the part */
+    int stride,              /* I: number of pixels between the lines of
+                                   in_line and in_samp */
+    Reproj_window_t *window  /* O: window of the band; the buffers are left
+                                   as they are */
+)
+{
+    int line, samp;          /* current line and sample in the part */
+    int line1, samp1;        /* line and sample after the window */
+    bool found = false;      /* is a pixel within the band? */
+    double y, x;             /* location in the band */
+    double min_y = 0.0, max_y = 0.0;  /* line range of the pixels */
+    double min_x = 0.0, max_x = 0.0;  /* sample range of the pixels */
+
+    for (line = 0; line < nlines; line++)
+    {
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            if (!get_reproject_location (band, in_line[line * stride + samp],
+                in_samp[line * stride + samp], &y, &x))
+                continue;
+
+            if (!found)
+            {
+                min_y = max_y = y;
+                min_x = max_x = x;
+                found = true;
+                continue;
+            }
+            min_y = min (min_y, y);
+            max_y = max (max_y, y);
+            min_x = min (min_x, x);
+            max_x = max (max_x, x);
+        }
+    }
+
+    if (!found)
+    {
+        window->nlines = 0;
+        window->nsamps = 0;
+        return (false);
+    }
+
+    /* The cubic convolution kernel, the largest, is 4 pixels wide starting
+       one pixel before the pixel center on or before the location */
+    window->line0 = max ((int) floor (min_y - 0.5) - 1, 0);
+    window->samp0 = max ((int) floor (min_x - 0.5) - 1, 0);
+    line1 = min ((int) floor (max_y - 0.5) + 3, band->bmeta->nlines);
+    samp1 = min ((int) floor (max_x - 0.5) + 3, band->bmeta->nsamps);
+    window->nlines = line1 - window->line0;
+    window->nsamps = samp1 - window->samp0;
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  read_reproject_window
+
+PURPOSE: Reads the window of an input band, converting it to floats for the
+bilinear and cubic convolution kernels.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the window
+SUCCESS         Successfully read the window
+
+NOTES:
+******************************************************************************/
+int read_reproject_window
+(
+    FILE *fp,                /* I: input band file */
+    Reproj_band_t *band,     /* I: input band being resampled */
+    Reproj_window_t *window  /* I/O: window to be read; the buffers are
+                                   grown as needed */
+)
+{
+    char FUNC_NAME[] = "read_reproject_window";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t npix = (size_t) window->nlines * window->nsamps;
+                             /* number of pixels in the window */
+    size_t i;                /* looping variable */
+
+    if (npix == 0)
+        return (SUCCESS);
+
+    if (window->raw_bytes < npix * band->size)
+    {
+        release_raw_binary_buffer (window->raw);
+        window->raw_bytes = npix * band->size;
+        window->raw = get_raw_binary_buffer (window->raw_bytes, false);
+        if (window->raw == NULL)
+        {
+            window->raw_bytes = 0;
+            sprintf (errmsg, "Allocating memory for a window of %d lines x "
+                "%d samples", window->nlines, window->nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (read_raw_binary_window (fp, band->bmeta, window->line0,
+        window->samp0, window->nlines, window->nsamps, 1, window->raw) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading lines %d-%d of band %s", window->line0,
+            window->line0 + window->nlines - 1, band->bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (band->method == ESPA_NN)
+        return (SUCCESS);
+
+    if (window->data_bytes < npix * sizeof (float))
+    {
+        release_raw_binary_buffer (window->data);
+        window->data_bytes = npix * sizeof (float);
+        window->data = get_raw_binary_buffer (window->data_bytes, false);
+        if (window->data == NULL)
+        {
+            window->data_bytes = 0;
+            sprintf (errmsg, "Allocating memory for a window of %d lines x "
+                "%d samples", window->nlines, window->nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    switch (band->bmeta->data_type)
+    {
+        case ESPA_INT8:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((int8_t *) window->raw)[i];
+            break;
+        case ESPA_UINT8:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((uint8_t *) window->raw)[i];
+            break;
+        case ESPA_INT16:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((int16_t *) window->raw)[i];
+            break;
+        case ESPA_UINT16:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((uint16_t *) window->raw)[i];
+            break;
+        case ESPA_INT32:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((int32_t *) window->raw)[i];
+            break;
+        case ESPA_UINT32:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((uint32_t *) window->raw)[i];
+            break;
+        case ESPA_FLOAT32:
+            memcpy (window->data, window->raw, npix * sizeof (float));
+            break;
+        case ESPA_FLOAT64:
+            for (i = 0; i < npix; i++)
+                window->data[i] = ((double *) window->raw)[i];
+            break;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  store_value
+
+PURPOSE: Stores a resampled value in the output, rounded and clipped to the
+range of the band's data type.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void store_value
+(
+    enum Espa_data_type data_type,  /* I: data type of the band */
+    float value,             /* I: resampled value */
+    void *out,               /* O: output pixels */
+    size_t indx              /* I: index of the pixel */
+)
+{
+    double dvalue = value;   /* value as a double, for the 32-bit types */
+
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            ((int8_t *) out)[indx] = lrintf (min (max (value, INT8_MIN),
+                INT8_MAX));
+            break;
+        case ESPA_UINT8:
+            ((uint8_t *) out)[indx] = lrintf (min (max (value, 0.0f),
+                UINT8_MAX));
+            break;
+        case ESPA_INT16:
+            ((int16_t *) out)[indx] = lrintf (min (max (value, INT16_MIN),
+                INT16_MAX));
+            break;
+        case ESPA_UINT16:
+            ((uint16_t *) out)[indx] = lrintf (min (max (value, 0.0f),
+                UINT16_MAX));
+            break;
+        case ESPA_INT32:
+            ((int32_t *) out)[indx] = llrint (min (max (dvalue, INT32_MIN),
+                INT32_MAX));
+            break;
+        case ESPA_UINT32:
+            ((uint32_t *) out)[indx] = llrint (min (max (dvalue, 0.0),
+                UINT32_MAX));
+            break;
+        case ESPA_FLOAT32:
+            ((float *) out)[indx] = value;
+            break;
+        case ESPA_FLOAT64:
+            ((double *) out)[indx] = dvalue;
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  copy_pixel
+
+PURPOSE: Copies a pixel of the input window to the output.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void copy_pixel
+(
+    int size,                /* I: number of bytes per pixel */
+    const void *in,          /* I: input pixels */
+    size_t in_indx,          /* I: index of the input pixel */
+    void *out,               /* O: output pixels */
+    size_t out_indx          /* I: index of the output pixel */
+)
+{
+    switch (size)
+    {
+        case 1:
+            ((uint8_t *) out)[out_indx] = ((const uint8_t *) in)[in_indx];
+            break;
+        case 2:
+            ((uint16_t *) out)[out_indx] = ((const uint16_t *) in)[in_indx];
+            break;
+        case 4:
+            ((uint32_t *) out)[out_indx] = ((const uint32_t *) in)[in_indx];
+            break;
+        default:
+            memcpy ((char *) out + out_indx * size,
+                (const char *) in + in_indx * size, size);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  apply_kernel
+
+PURPOSE: Applies a bilinear or cubic convolution kernel to the input window.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           A pixel of the kernel is fill
+true            The value was computed
+
+NOTES:
+  1. Each row of the kernel is weighted in 4 lanes, which are summed down
+     the rows and then across as (0 + 2) + (1 + 3).  The bilinear kernel
+     uses the first 2 lanes.
+  2. Kernel pixels outside the band take the value of the nearest pixel of
+     the band.
+******************************************************************************/
+static bool apply_kernel
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    Reproj_window_t *window, /* I: window of the band */
+    int line0,               /* I: first line of the kernel in the band */
+    int samp0,               /* I: first sample of the kernel in the band */
+    int width,               /* I: width of the kernel; 2 or 4 */
+    const float *wx,         /* I: 4 sample weights; unused ones are 0 */
+    const float *wy,         /* I: line weights */
+    float *value             /* O: resampled value */
+)
+{
+    int j, k;                /* looping variables for the kernel */
+    int line, samp;          /* line and sample of a kernel pixel */
+    float pix;               /* kernel pixel */
+    float acc[4];            /* sum of each lane */
+
+#ifdef __SSE2__
+    /* Kernels within the window */
+    if (line0 >= window->line0 && samp0 >= window->samp0 &&
+        line0 + width <= window->line0 + window->nlines &&
+        samp0 + width <= window->samp0 + window->nsamps)
+    {
+        const float *row;        /* kernel row in the window */
+        __m128 vwx = _mm_loadu_ps (wx);  /* sample weights */
+        __m128 vfill = _mm_set1_ps (band->fill);  /* fill value */
+        __m128 vacc = _mm_setzero_ps ();  /* lane sums */
+        __m128 vrow;             /* pixels of a kernel row */
+        int mask = 0;            /* lanes with fill pixels */
+
+        row = &window->data[(size_t) (line0 - window->line0) *
+            window->nsamps + (samp0 - window->samp0)];
+        for (j = 0; j < width; j++, row += window->nsamps)
+        {
+            if (width == 4)
+                vrow = _mm_loadu_ps (row);
+            else
+                vrow = _mm_castpd_ps (_mm_load_sd ((const double *) row));
+            mask |= _mm_movemask_ps (_mm_cmpeq_ps (vrow, vfill));
+            vacc = _mm_add_ps (vacc, _mm_mul_ps (_mm_set1_ps (wy[j]),
+                _mm_mul_ps (vwx, vrow)));
+        }
+        if (band->has_fill && (mask & ((1 << width) - 1)))
+            return (false);
+
+        vacc = _mm_add_ps (vacc, _mm_movehl_ps (vacc, vacc));
+        vacc = _mm_add_ss (vacc, _mm_shuffle_ps (vacc, vacc, 1));
+        *value = _mm_cvtss_f32 (vacc);
+        return (true);
+    }
+#endif
+
+    /* Kernels at the edges of the window, or without SSE2 */
+    for (k = 0; k < 4; k++)
+        acc[k] = 0.0f;
+    for (j = 0; j < width; j++)
+    {
+        line = min (max (line0 + j, window->line0),
+            window->line0 + window->nlines - 1) - window->line0;
+        for (k = 0; k < width; k++)
+        {
+            samp = min (max (samp0 + k, window->samp0),
+                window->samp0 + window->nsamps - 1) - window->samp0;
+            pix = window->data[(size_t) line * window->nsamps + samp];
+            if (band->has_fill && pix == band->fill)
+                return (false);
+            acc[k] = acc[k] + wy[j] * (wx[k] * pix);
+        }
+    }
+
+    *value = (acc[0] + acc[2]) + (acc[1] + acc[3]);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  resample_reproject_tile
+
+PURPOSE: Resamples part of an output tile from the window of an input band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Pixels outside the band, or which couldn't be mapped, are set to the
+     fill value of the band, or 0 if it doesn't have one.
+******************************************************************************/
+void resample_reproject_tile
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    Reproj_window_t *window, /* I: window of the band read for the part */
+    int nlines,              /* I: number of lines in the part of the tile */
+    int nsamps,              /* I: number of samples in the part */
+    const float *in_line,    /* I: input line of each pixel of the part */
+    const float *in_samp,    /* I: input sample of each pixel of the part */
+    int stride,              /* I: number of pixels between the lines of
+                                   in_line and in_samp */
+    void *out,               /* O: output pixels in the band's data type */
+    int out_stride           /* I: number of pixels between the lines of
+                                   out */
+)
+{
+    int line, samp;          /* current line and sample in the part */
+    int nn_line, nn_samp;    /* nearest pixel of the window */
+    int width;               /* width of the kernel */
+    size_t indx;             /* index of the output pixel */
+    double y, x;             /* location in the band */
+    double v, u;             /* location relative to the pixel centers */
+    float ty, tx;            /* fractional location between the centers */
+    float wy[4], wx[4];      /* line and sample weights of the kernel */
+    float value;             /* resampled value */
+    float a = REPROJ_CUBIC_A;  /* cubic convolution parameter */
+    float fill = band->has_fill ? band->fill : 0.0f;  /* output fill */
+
+    width = (band->method == ESPA_CC) ? 4 : 2;
+    for (line = 0; line < nlines; line++)
+    {
+        for (samp = 0; samp < nsamps; samp++)
+        {
+            indx = (size_t) line * out_stride + samp;
+            if (window->nlines == 0 || !get_reproject_location (band,
+                in_line[line * stride + samp], in_samp[line * stride + samp],
+                &y, &x))
+            {
+                store_value (band->bmeta->data_type, fill, out, indx);
+                continue;
+            }
+
+            nn_line = (int) y - window->line0;
+            nn_samp = (int) x - window->samp0;
+            if (band->method != ESPA_NN)
+            {
+                v = y - 0.5;
+                u = x - 0.5;
+                ty = (float) (v - floor (v));
+                tx = (float) (u - floor (u));
+                if (band->method == ESPA_BI)
+                {
+                    wy[0] = 1.0f - ty;
+                    wy[1] = ty;
+                    wx[0] = 1.0f - tx;
+                    wx[1] = tx;
+                    wx[2] = wx[3] = 0.0f;
+                }
+                else
+                {
+                    wy[0] = ((a * ty - 2.0f * a) * ty + a) * ty;
+                    wy[1] = ((a + 2.0f) * ty - (a + 3.0f)) * ty * ty + 1.0f;
+                    wy[2] = ((-(a + 2.0f) * ty + (2.0f * a + 3.0f)) * ty - a)
+                        * ty;
+                    wy[3] = (-a * ty + a) * ty * ty;
+                    wx[0] = ((a * tx - 2.0f * a) * tx + a) * tx;
+                    wx[1] = ((a + 2.0f) * tx - (a + 3.0f)) * tx * tx + 1.0f;
+                    wx[2] = ((-(a + 2.0f) * tx + (2.0f * a + 3.0f)) * tx - a)
+                        * tx;
+                    wx[3] = (-a * tx + a) * tx * tx;
+                }
+
+                if (apply_kernel (band, window,
+                    (int) floor (v) - (width == 4),
+                    (int) floor (u) - (width == 4), width, wx, wy, &value))
+                {
+                    store_value (band->bmeta->data_type, value, out, indx);
+                    continue;
+                }
+            }
+
+            /* Nearest neighbor, including kernels with fill pixels */
+            copy_pixel (band->size, window->raw,
+                (size_t) nn_line * window->nsamps + nn_samp, out, indx);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  free_reproject_window
+
+PURPOSE: Releases the buffers of a window.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void free_reproject_window
+(
+    Reproj_window_t *window  /* I/O: window whose buffers are released */
+)
+{
+    release_raw_binary_buffer (window->raw);
+    release_raw_binary_buffer (window->data);
+    window->raw = NULL;
+    window->data = NULL;
+    window->raw_bytes = 0;
+    window->data_bytes = 0;
+}
+
+
+/******************************************************************************
+MODULE:  resample_tile_part
+
+PURPOSE: Reads the input window of part of a tile and resamples the part,
+splitting it in two while the window is larger than REPROJ_MAX_WINDOW.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the input band
+SUCCESS         Successfully resampled the part
+
+NOTES:
+******************************************************************************/
+static int resample_tile_part
+(
+    Reproj_job_t *job,       /* I: strip being resampled */
+    Reproj_runner_t *run,    /* I/O: resources of the runner */
+    int nlines,              /* I: number of lines in the part */
+    int nsamps,              /* I: number of samples in the part */
+    const float *in_line,    /* I: input line of each pixel of the part */
+    const float *in_samp,    /* I: input sample of each pixel of the part */
+    int stride,              /* I: number of pixels between the lines of
+                                   in_line and in_samp */
+    char *out                /* O: output pixels of the part in the strip */
+)
+{
+    char FUNC_NAME[] = "resample_tile_part";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int half;                /* size of the first half of a split part */
+    size_t out_line = (size_t) job->out_nsamps * job->band.size;
+                             /* bytes in a line of the strip */
+    Reproj_window_t *window = &run->window;  /* input window */
+
+    if (get_reproject_window (&job->band, nlines, nsamps, in_line, in_samp,
+        stride, window))
+    {
+        /* Split parts with large windows */
+        if ((size_t) window->nlines * window->nsamps > REPROJ_MAX_WINDOW &&
+            nlines * nsamps > 1)
+        {
+            if (nlines >= nsamps)
+            {
+                half = nlines / 2;
+                if (resample_tile_part (job, run, half, nsamps, in_line,
+                    in_samp, stride, out) != SUCCESS)
+                    return (ERROR);
+                return (resample_tile_part (job, run, nlines - half, nsamps,
+                    &in_line[half * stride], &in_samp[half * stride],
+                    stride, out + half * out_line));
+            }
+
+            half = nsamps / 2;
+            if (resample_tile_part (job, run, nlines, half, in_line, in_samp,
+                stride, out) != SUCCESS)
+                return (ERROR);
+            return (resample_tile_part (job, run, nlines, nsamps - half,
+                &in_line[half], &in_samp[half], stride,
+                out + half * job->band.size));
+        }
+
+        if (run->fp == NULL)
+        {
+            run->fp = open_raw_binary (job->in_file, "rb");
+            if (run->fp == NULL)
+            {
+                sprintf (errmsg, "Opening the input band file: %s",
+                    job->in_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        if (read_reproject_window (run->fp, &job->band, window) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
+    resample_reproject_tile (&job->band, window, nlines, nsamps, in_line,
+        in_samp, stride, out, job->out_nsamps);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  reproject_tile_range
+
+PURPOSE: Resamples a chunk of the tiles of a strip; the chunk function of the
+task pool.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error resampling a tile
+SUCCESS         Successfully resampled the tiles
+
+NOTES:
+******************************************************************************/
+static int reproject_tile_range
+(
+    void *arg,            /* I: strip being resampled (Reproj_job_t *) */
+    int first,            /* I: first tile of the chunk */
+    int end,              /* I: tile after the last one of the chunk */
+    int runner            /* I: number of the runner */
+)
+{
+    Reproj_job_t *job = arg;  /* strip being resampled */
+    Reproj_runner_t *run = &job->runner[runner];  /* runner resources */
+    int tile;             /* looping variable for the tiles */
+    int samp0;            /* first sample of the tile */
+    int nsamps;           /* number of samples in the tile */
+
+    for (tile = first; tile < end; tile++)
+    {
+        samp0 = tile * REPROJ_TILE_SIZE;
+        nsamps = min (REPROJ_TILE_SIZE, job->out_nsamps - samp0);
+        if (map_reproject_tile (job->out_space, job->in_space,
+            job->strip_line0, samp0, job->strip_nlines, nsamps, run->in_line,
+            run->in_samp) != SUCCESS)
+            return (ERROR);
+
+        if (resample_tile_part (job, run, job->strip_nlines, nsamps,
+            run->in_line, run->in_samp, nsamps,
+            (char *) job->strip + (size_t) samp0 * job->band.size) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_reproject_job
+
+PURPOSE: Sets up the resampling of an input band onto the output grid a strip
+at a time, sizing the runners and the strip to the memory budget.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the job
+SUCCESS         Successfully set up the job
+
+NOTES:
+  1. The job is released with free_reproject_job, also after an error.
+******************************************************************************/
+int init_reproject_job
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    char *in_file,           /* I: input band filename */
+    Reproj_job_t *job        /* O: strips of the band to be resampled */
+)
+{
+    char FUNC_NAME[] = "init_reproject_job";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int count;                   /* number of chars copied in snprintf */
+    int i;                       /* looping variable for the runners */
+    size_t strip_bytes;          /* bytes in a strip */
+    size_t runner_bytes;         /* bytes held by each runner */
+
+    memset (job, 0, sizeof (*job));
+    count = snprintf (job->in_file, sizeof (job->in_file), "%s", in_file);
+    if (count < 0 || count >= sizeof (job->in_file))
+    {
+        sprintf (errmsg, "Overflow of in_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    init_reproject_band (bmeta, in_space, &job->band);
+    if (job->band.size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Size the runners and the strip to the memory budget */
+    job->in_space = in_space;
+    job->out_space = out_space;
+    job->out_nsamps = out_space->def.img_size.s;
+    strip_bytes = (size_t) REPROJ_TILE_SIZE * job->out_nsamps *
+        job->band.size;
+    runner_bytes = (size_t) REPROJ_MAX_WINDOW * (job->band.size +
+        sizeof (float)) + 2 * REPROJ_TILE_SIZE * REPROJ_TILE_SIZE *
+        sizeof (float);
+    job->nthreads = espa_budget_threads (runner_bytes, strip_bytes,
+        espa_task_nthreads ());
+    job->ntiles = (job->out_nsamps + REPROJ_TILE_SIZE - 1) /
+        REPROJ_TILE_SIZE;
+
+    job->strip = get_raw_binary_buffer (strip_bytes, false);
+    job->runner = calloc (job->nthreads, sizeof (Reproj_runner_t));
+    if (job->strip == NULL || job->runner == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < job->nthreads; i++)
+    {
+        job->runner[i].in_line = malloc ((size_t) REPROJ_TILE_SIZE *
+            REPROJ_TILE_SIZE * sizeof (float));
+        job->runner[i].in_samp = malloc ((size_t) REPROJ_TILE_SIZE *
+            REPROJ_TILE_SIZE * sizeof (float));
+        if (job->runner[i].in_line == NULL || job->runner[i].in_samp == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the tile locations");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  reproject_strip
+
+PURPOSE: Resamples a strip of lines of the output grid into the strip buffer
+of the job, with the tiles of the strip resampled concurrently.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error resampling the strip
+SUCCESS         Successfully resampled the strip
+
+NOTES:
+******************************************************************************/
+int reproject_strip
+(
+    Reproj_job_t *job,       /* I/O: strips of the band being resampled */
+    int line0,               /* I: first output line of the strip */
+    int nlines               /* I: number of lines in the strip; at most
+                                   REPROJ_TILE_SIZE */
+)
+{
+    char FUNC_NAME[] = "reproject_strip";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+
+    job->strip_line0 = line0;
+    job->strip_nlines = nlines;
+    if (espa_parallel_for (0, job->ntiles, 1, job->nthreads,
+        reproject_tile_range, job) != SUCCESS)
+    {
+        sprintf (errmsg, "Resampling lines %d-%d of band %s", line0,
+            line0 + nlines - 1, job->band.bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_reproject_job
+
+PURPOSE: Closes the input files of the runners and frees the buffers of a
+job.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void free_reproject_job
+(
+    Reproj_job_t *job        /* I/O: job whose resources are released */
+)
+{
+    int i;                   /* looping variable for the runners */
+
+    if (job->runner != NULL)
+    {
+        for (i = 0; i < job->nthreads; i++)
+        {
+            if (job->runner[i].fp != NULL)
+                close_raw_binary (job->runner[i].fp);
+            free_reproject_window (&job->runner[i].window);
+            free (job->runner[i].in_line);
+            free (job->runner[i].in_samp);
+        }
+        free (job->runner);
+    }
+    if (job->strip != NULL)
+        release_raw_binary_buffer (job->strip);
+    job->runner = NULL;
+    job->strip = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  reproject_band
+
+PURPOSE: Writes a band resampled onto the output grid to the output
+directory, along with its ENVI header, and updates the band metadata for the
+grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reprojecting the band
+SUCCESS         Successfully reprojected the band
+
+NOTES:
+  1. The output band has the same filename as the input band, without any
+     directory, in the directory of the output XML file.
+  2. A band without a fill value gets a fill value of 0, since the output
+     pixels outside the input scene are set to 0.
+  3. With checkpointing on (see espa_checkpoint.h), the output band is
+     checkpointed after each strip, and a band left by a failed run resumes
+     after its last checkpointed strip.
+******************************************************************************/
+static int reproject_band
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    char *in_dir,            /* I: directory of the input XML file */
+    char *out_dir,           /* I: directory of the output XML file */
+    Espa_global_meta_t *gmeta,  /* I: global metadata of the output */
+    Espa_band_meta_t *bmeta  /* I/O: metadata of the band */
+)
+{
+    char FUNC_NAME[] = "reproject_band";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_file[STR_SIZE];      /* input band filename */
+    char out_file[STR_SIZE];     /* output band filename */
+    char hdr_file[STR_SIZE];     /* output ENVI header filename */
+    char stage[ESPA_CHECKPOINT_STAGE_SIZE];  /* checkpoint stage name */
+    char *base = NULL;           /* band filename without the directory */
+    int count;                   /* number of chars copied in snprintf */
+    int first_line;              /* first line not yet written */
+    int line0;                   /* first line of the current strip */
+    int nlines;                  /* number of lines in the current strip */
+    int status = SUCCESS;        /* status of the strips */
+    int out_nlines = out_space->def.img_size.l;  /* output lines */
+    Reproj_job_t job;            /* strips being resampled */
+    Raw_binary_writer_t rbw;     /* output band writer */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+
+    /* Determine the input and output filenames */
+    if (bmeta->file_name[0] == '/')
+        count = snprintf (in_file, sizeof (in_file), "%s", bmeta->file_name);
+    else
+        count = snprintf (in_file, sizeof (in_file), "%s/%s", in_dir,
+            bmeta->file_name);
+    if (count < 0 || count >= sizeof (in_file))
+    {
+        sprintf (errmsg, "Overflow of in_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    base = strrchr (bmeta->file_name, '/');
+    base = (base == NULL) ? bmeta->file_name : base + 1;
+    count = snprintf (out_file, sizeof (out_file), "%s/%s", out_dir, base);
+    if (count < 0 || count >= sizeof (out_file) || strlen (base) < 3)
+    {
+        sprintf (errmsg, "Invalid output filename for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (init_reproject_job (in_space, out_space, bmeta, in_file, &job) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        free_reproject_job (&job);
+        return (ERROR);
+    }
+
+    /* Open the output file, which resumes from its checkpoint if one was
+       left for the same band and grid */
+    snprintf (stage, sizeof (stage), "reproject %s %dx%d", bmeta->name,
+        out_nlines, job.out_nsamps);
+    if (open_raw_binary_writer_resumable (out_file,
+        get_raw_binary_cache_mode (), get_raw_binary_codec (), stage, &rbw)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the output band file: %s",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_reproject_job (&job);
+        return (ERROR);
+    }
+
+    /* The statistics, checksum and sub-sampling of the input band don't
+       apply, and its percent coverage is recomputed if requested */
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+    bmeta->sub_sample.factor = 1;
+    bmeta->constant.is_constant = false;
+    if (!job.band.has_fill)
+        bmeta->fill_value = 0;
+    if (use_raw_binary_stats () && attach_raw_binary_stats (&rbw, bmeta) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the statistics of the %s band",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (use_raw_binary_cover () && attach_raw_binary_cover (&rbw, bmeta) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the percent coverage of the %s "
+            "band", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (use_raw_binary_checksum ())
+        attach_raw_binary_checksum (&rbw, bmeta);
+    if (resume_raw_binary_writer (&rbw, &first_line) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to resume the output band file: %s",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Resample the output a strip of tiles at a time */
+    for (line0 = first_line; line0 < out_nlines; line0 += REPROJ_TILE_SIZE)
+    {
+        nlines = min (REPROJ_TILE_SIZE, out_nlines - line0);
+        status = reproject_strip (&job, line0, nlines);
+        if (status != SUCCESS)
+        {  /* Error messages already written */
+            break;
+        }
+
+        if (write_raw_binary_writer (&rbw, nlines, job.out_nsamps,
+            job.band.size, job.strip) != SUCCESS ||
+            checkpoint_raw_binary_writer (&rbw) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the output band file: %s",
+                out_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    /* Close the files and free the buffers */
+    free_reproject_job (&job);
+
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the output band file: %s", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (status != SUCCESS)
+        return (ERROR);
+
+    /* Update the band metadata for the output grid */
+    bmeta->nlines = out_nlines;
+    bmeta->nsamps = job.out_nsamps;
+    bmeta->pixel_size[0] = out_space->def.pixel_size[0];
+    bmeta->pixel_size[1] = out_space->def.pixel_size[1];
+    strcpy (bmeta->pixel_units, gmeta->proj_info.units);
+    memmove (bmeta->file_name, base, strlen (base) + 1);
+
+    /* Write the ENVI header for the band */
+    if (create_envi_struct (bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (hdr_file, out_file);
+    sprintf (&hdr_file[strlen(hdr_file)-3], "hdr");
+    if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  reproject_xml
+
+PURPOSE: Reprojects the bands of the input XML file onto the grid of a
+template product, writing the reprojected bands to the directory of the
+output XML file and their metadata to the output XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reprojecting the scene
+SUCCESS         Successfully reprojected the scene
+
+NOTES:
+  1. The output XML file has to be in a different directory than the input
+     XML file, since the reprojected bands keep their filenames.
+  2. All the bands are resampled onto the same grid.  The projection
+     information and orientation are copied from the template, and the
+     corners and bounding coordinates are computed for the grid.
+******************************************************************************/
+int reproject_xml
+(
+    char *in_xml_file,       /* I: input XML file to be reprojected */
+    char *out_xml_file,      /* I: output XML file; the reprojected bands are
+                                   written to its directory */
+    char *template_xml_file, /* I: XML file of the template product */
+    double pixel_size,       /* I: output pixel size; 0 for the pixel size
+                                   of the template */
+    bool template_extent     /* I: use the extent of the template? */
+)
+{
+    char FUNC_NAME[] = "reproject_xml";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_dir[STR_SIZE];       /* directory of the input XML file */
+    char out_dir[STR_SIZE];      /* directory of the output XML file */
+    char in_path[PATH_MAX];      /* resolved input directory */
+    char out_path[PATH_MAX];     /* resolved output directory */
+    int i;                       /* looping variable for the bands */
+    Space_def_t in_def;          /* input space definition */
+    Space_def_t out_def;         /* output grid */
+    Geoloc_t *in_space = NULL;   /* geolocation of the input scene */
+    Geoloc_t *out_space = NULL;  /* geolocation of the output grid */
+    Subset_window_t grid_window; /* whole output grid */
+    Espa_internal_meta_t xml_metadata;   /* XML metadata of the scene */
+    Espa_internal_meta_t template_meta;  /* XML metadata of the template */
+
+    /* Read the input and template metadata */
+    if (validate_xml_file (in_xml_file) != SUCCESS ||
+        validate_xml_file (template_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    init_metadata_struct (&xml_metadata);
+    init_metadata_struct (&template_meta);
+    if (parse_metadata (in_xml_file, &xml_metadata) != SUCCESS ||
+        parse_metadata (template_xml_file, &template_meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* The reprojected bands can't overwrite the input bands */
+    if (get_subset_dir (in_xml_file, in_dir) != SUCCESS ||
+        get_subset_dir (out_xml_file, out_dir) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (realpath (in_dir, in_path) == NULL ||
+        realpath (out_dir, out_path) == NULL)
+    {
+        sprintf (errmsg, "Resolving the directories of the input and output "
+            "XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!strcmp (in_path, out_path))
+    {
+        sprintf (errmsg, "The output XML file must be in a different "
+            "directory than the input XML file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the mapping of the input scene and the output grid */
+    if (!get_geoloc_info (&xml_metadata, &in_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    in_space = setup_mapping (&in_def);
+    if (in_space == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (get_reproject_grid (1, &in_space, &template_meta, pixel_size,
+        template_extent, &out_def) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the output grid of %s", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    out_space = setup_mapping (&out_def);
+    if (out_space == NULL)
+    {
+        sprintf (errmsg, "Setting up the mapping structure of the output "
+            "grid.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Update the projection information and geolocation for the grid, which
+       the ENVI headers of the bands use */
+    xml_metadata.global.proj_info = template_meta.global.proj_info;
+    xml_metadata.global.orientation_angle =
+        template_meta.global.orientation_angle;
+    grid_window.line0 = 0;
+    grid_window.samp0 = 0;
+    grid_window.nlines = out_def.img_size.l;
+    grid_window.nsamps = out_def.img_size.s;
+    if (update_subset_geoloc (out_space, &grid_window, &xml_metadata.global)
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Reproject the bands */
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        if (reproject_band (in_space, out_space, in_dir, out_dir,
+            &xml_metadata.global, &xml_metadata.band[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Reprojecting band %s of %s",
+                xml_metadata.band[i].name, in_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Write the metadata of the output and validate it */
+    if (write_metadata (&xml_metadata, out_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (validate_xml_file (out_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* The output is complete, so the checkpoints of the bands are no longer
+       needed */
+    for (i = 0; i < xml_metadata.nbands; i++)
+        remove_raw_binary_checkpoint (out_dir, &xml_metadata.band[i]);
+
+    /* Free the metadata structures and the mappings */
+    free_metadata (&xml_metadata);
+    free_metadata (&template_meta);
+    free (in_space);
+    free (out_space);
+
+    /* Successful reprojection */
+    return (SUCCESS);
+}
@@ -0,0 +1,249 @@
+/*****************************************************************************
+FILE: espa_reproject.h
+
+PURPOSE: Contains defines, structures and prototypes for reprojecting and
+resampling the bands of a scene onto the grid of a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The output grid is processed in tiles.  The input location of each
+     output pixel is interpolated from a grid of exactly mapped pixels every
+     REPROJ_GRID_STEP lines and samples of the tile, and the input band is
+     read only in the window the tile maps to.
+  2. Each band is resampled with its resample_method: nearest neighbor
+     (ESPA_NN, and ESPA_NONE), bilinear (ESPA_BI) or cubic convolution
+     (ESPA_CC).  A pixel whose bilinear or cubic convolution kernel includes
+     a fill pixel gets the nearest neighbor value instead.
+  3. Input locations are image coordinates of the representative band of
+     the input scene (see get_geoloc_info), for the upper left corner of the
+     pixel, and are scaled to each band by the ratio of the pixel sizes.
+*****************************************************************************/
+
+#ifndef ESPA_REPROJECT_H
+#define ESPA_REPROJECT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_geoloc.h"
+#include "espa_spatial_subset.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
+
+/* Defines */
+/* Number of lines and samples in each output tile */
+#define REPROJ_TILE_SIZE 256
+
+/* Spacing, in lines and samples, of the exactly mapped pixels of a tile */
+#define REPROJ_GRID_STEP 16
+
+/* Largest number of exactly mapped pixels in a tile */
+#define REPROJ_MAX_NODES ((REPROJ_TILE_SIZE / REPROJ_GRID_STEP + 1) * \
+    (REPROJ_TILE_SIZE / REPROJ_GRID_STEP + 1))
+
+/* Largest number of pixels in the input window of a tile.  The tiles whose
+   window would be larger, such as when reducing the resolution a lot, are
+   resampled in parts. */
+#define REPROJ_MAX_WINDOW (1024 * 1024)
+
+/* Number of points mapped along each edge of the input scene to find the
+   extent of the output grid */
+#define REPROJ_EDGE_POINTS 256
+
+/* Parameter of the cubic convolution kernel */
+#define REPROJ_CUBIC_A -0.5f
+
+/* Type definitions */
+/* Input band being resampled */
+typedef struct
+{
+    Espa_band_meta_t *bmeta;     /* metadata of the input band; provides the
+                                    size and data type */
+    int size;                    /* number of bytes per pixel */
+    enum Espa_resampling_type method;  /* ESPA_NN, ESPA_BI or ESPA_CC */
+    bool has_fill;               /* does the band have a fill value? */
+    float fill;                  /* fill value, for the kernels */
+    double line_scale;           /* band lines per representative line */
+    double samp_scale;           /* band samples per representative sample */
+} Reproj_band_t;
+
+/* Window of an input band read for a tile */
+typedef struct
+{
+    int line0;                   /* first line of the window (0-based) */
+    int samp0;                   /* first sample of the window (0-based) */
+    int nlines;                  /* number of lines; 0 if the tile doesn't
+                                    overlap the band */
+    int nsamps;                  /* number of samples */
+    void *raw;                   /* window pixels in the band's data type */
+    size_t raw_bytes;            /* allocated size of raw */
+    float *data;                 /* window pixels as floats, for the bilinear
+                                    and cubic convolution kernels */
+    size_t data_bytes;           /* allocated size of data */
+} Reproj_window_t;
+
+/* Resources of a runner of the task pool */
+typedef struct
+{
+    FILE *fp;                    /* input band file; opened on first use */
+    Reproj_window_t window;      /* input window of the current tile */
+    float *in_line;              /* input line of each tile pixel */
+    float *in_samp;              /* input sample of each tile pixel */
+} Reproj_runner_t;
+
+/* Strips of output tiles of a band resampled by the task pool */
+typedef struct
+{
+    Geoloc_t *in_space;          /* geolocation of the input scene */
+    Geoloc_t *out_space;         /* geolocation of the output grid */
+    Reproj_band_t band;          /* input band being resampled */
+    char in_file[STR_SIZE];      /* input band filename */
+    int strip_line0;             /* first output line of the strip */
+    int strip_nlines;            /* number of lines in the strip */
+    int out_nsamps;              /* number of samples in the output */
+    int ntiles;                  /* number of tiles across a strip */
+    int nthreads;                /* number of runners */
+    void *strip;                 /* output pixels of the strip, in the band's
+                                    data type */
+    Reproj_runner_t *runner;     /* resources of each runner */
+} Reproj_job_t;
+
+/* Prototypes */
+int get_reproject_footprint
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    double *min_line,        /* O: first line covered */
+    double *max_line,        /* O: last line covered */
+    double *min_samp,        /* O: first sample covered */
+    double *max_samp         /* O: last sample covered */
+);
+
+int get_reproject_grid
+(
+    int nscenes,             /* I: number of input scenes */
+    Geoloc_t **in_space,     /* I: geolocation of each input scene */
+    Espa_internal_meta_t *template_meta,  /* I: metadata of the template
+                                   product giving the output projection */
+    double pixel_size,       /* I: output pixel size; 0 for the pixel size
+                                   of the template */
+    bool template_extent,    /* I: use the extent of the template, rather
+                                   than the extent of the input scenes on
+                                   the template grid? */
+    Space_def_t *grid        /* O: output grid */
+);
+
+void init_reproject_band
+(
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Reproj_band_t *band      /* O: input band being resampled */
+);
+
+int map_reproject_tile
+(
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    int line0,               /* I: first output line of the tile */
+    int samp0,               /* I: first output sample of the tile */
+    int nlines,              /* I: number of lines in the tile */
+    int nsamps,              /* I: number of samples in the tile */
+    float *in_line,          /* O: input line of each tile pixel; NAN if it
+                                   couldn't be mapped */
+    float *in_samp           /* O: input sample of each tile pixel; NAN if it
+                                   couldn't be mapped */
+);
+
+bool get_reproject_location
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    float in_line,           /* I: input line */
+    float in_samp,           /* I: input sample */
+    double *line,            /* O: line in the band */
+    double *samp             /* O: sample in the band */
+);
+
+bool get_reproject_window
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    int nlines,              /* I: number of lines in the part of the tile */
+    int nsamps,              /* I: number of samples in the part */
+    const float *in_line,    /* I: input line of each pixel of the part */
+    const float *in_samp,    /* I: input sample of each pixel of the part */
+    int stride,              /* I: number of pixels between the lines of
+                                   in_line and in_samp */
+    Reproj_window_t *window  /* O: window of the band; the buffers are left
+                                   as they are */
+);
+
+int read_reproject_window
+(
+    FILE *fp,                /* I: input band file */
+    Reproj_band_t *band,     /* I: input band being resampled */
+    Reproj_window_t *window  /* I/O: window to be read; the buffers are
+                                   grown as needed */
+);
+
+void resample_reproject_tile
+(
+    Reproj_band_t *band,     /* I: input band being resampled */
+    Reproj_window_t *window, /* I: window of the band read for the part */
+    int nlines,              /* I: number of lines in the part of the tile */
+    int nsamps,              /* I: number of samples in the part */
+    const float *in_line,    /* I: input line of each pixel of the part */
+    const float *in_samp,    /* I: input sample of each pixel of the part */
+    int stride,              /* I: number of pixels between the lines of
+                                   in_line and in_samp */
+    void *out,               /* O: output pixels in the band's data type */
+    int out_stride           /* I: number of pixels between the lines of
+                                   out */
+);
+
+void free_reproject_window
+(
+    Reproj_window_t *window  /* I/O: window whose buffers are released */
+);
+
+int init_reproject_job
+(
+    Geoloc_t *in_space,      /* I: geolocation of the input scene */
+    Geoloc_t *out_space,     /* I: geolocation of the output grid */
+    Espa_band_meta_t *bmeta, /* I: metadata of the input band */
+    char *in_file,           /* I: input band filename */
+    Reproj_job_t *job        /* O: strips of the band to be resampled */
+);
+
+int reproject_strip
+(
+    Reproj_job_t *job,       /* I/O: strips of the band being resampled */
+    int line0,               /* I: first output line of the strip */
+    int nlines               /* I: number of lines in the strip; at most
+                                   REPROJ_TILE_SIZE */
+);
+
+void free_reproject_job
+(
+    Reproj_job_t *job        /* I/O: job whose resources are released */
+);
+
+int reproject_xml
+(
+    char *in_xml_file,       /* I: input XML file to be reprojected */
+    char *out_xml_file,      /* I: output XML file; the reprojected bands are
+                                   written to its directory */
+    char *template_xml_file, /* I: XML file of the template product */
+    double pixel_size,       /* I: output pixel size; 0 for the pixel size
+                                   of the template */
+    bool template_extent     /* I: use the extent of the template? */
+);
+
+#endif
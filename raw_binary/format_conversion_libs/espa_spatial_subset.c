@@ -0,0 +1,847 @@
+/*****************************************************************************
+FILE: espa_spatial_subset.c
+
+PURPOSE: Contains functions for subsetting the bands of a scene to a
+projection-space or latitude/longitude box, reading only the window of each
+band covering the box.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. Image coordinates are for the upper left corner of the pixel, as in
+     espa_geoloc.c, so pixel (l, s) covers lines l to l+1 and samples s to
+     s+1.
+*****************************************************************************/
+#include <limits.h>
+#include "espa_spatial_subset.h"
+#include "espa_memory.h"
+#include "espa_tune.h"
+#include "espa_task.h"
+#include "raw_binary_pool.h"
+
+/* Bands being subset by the task pool */
+typedef struct
+{
+    Espa_internal_meta_t *meta;  /* metadata of the scene; the band sizes and
+                                    filenames are updated as the bands are
+                                    written */
+    Subset_window_t *window;     /* window of each band */
+    char in_dir[STR_SIZE];       /* directory of the input XML file */
+    char out_dir[STR_SIZE];      /* directory of the output XML file */
+    Raw_binary_cache_t cache;    /* page cache handling for the output */
+    Raw_binary_codec_t codec;    /* compression of the output bands */
+    bool band_stats;             /* compute the statistics of the bands? */
+    bool band_cover;             /* compute the percent coverage of the
+                                    class and QA bands? */
+    bool band_checksum;          /* compute the checksums of the bands? */
+    int nthreads;                /* number of bands subset at a time */
+} Spatial_subset_t;
+
+/******************************************************************************
+MODULE:  get_subset_dir
+
+PURPOSE: Determines the directory portion of a filename, to be used as the
+prefix for the band filenames which are relative to the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the directory
+SUCCESS         Successfully determined the directory
+
+NOTES:
+  1. If the filename doesn't contain a directory then the current directory
+     (".") is returned.
+******************************************************************************/
+int get_subset_dir
+(
+    char *filename,      /* I: filename to get the directory of */
+    char *dir            /* O: directory of the filename (STR_SIZE) */
+)
+{
+    char FUNC_NAME[] = "get_subset_dir";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *cptr = NULL;       /* pointer to the last / in the filename */
+    int count;               /* number of chars copied in snprintf */
+
+    count = snprintf (dir, STR_SIZE, "%s", filename);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of dir string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (dir, '/');
+    if (cptr == NULL)
+        strcpy (dir, ".");
+    else if (cptr == dir)
+        dir[1] = '\0';
+    else
+        *cptr = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  window_to_map
+
+PURPOSE: Determines the projection coordinates of a line/sample location of
+the representative band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. This is the forward half of from_space, without the inverse mapping to
+     latitude and longitude.
+******************************************************************************/
+void window_to_map
+(
+    Geoloc_t *space,     /* I: geolocation of the representative band */
+    double line,         /* I: line location */
+    double samp,         /* I: sample location */
+    double *x,           /* O: projection x coordinate */
+    double *y            /* O: projection y coordinate */
+)
+{
+    double dl = line * space->def.pixel_size[1];  /* delta line */
+    double ds = samp * space->def.pixel_size[0];  /* delta sample */
+
+    *x = space->def.ul_corner.x + (ds * space->cos_orien) +
+        (dl * space->sin_orien);
+    *y = space->def.ul_corner.y + (ds * space->sin_orien) -
+        (dl * space->cos_orien);
+}
+
+
+/******************************************************************************
+MODULE:  get_spatial_window
+
+PURPOSE: Determines the window of lines and samples of the representative
+band covering a projection-space or latitude/longitude box.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The box isn't valid or doesn't overlap the scene
+SUCCESS         Successfully determined the window
+
+NOTES:
+  1. A projection box is mapped from its four corners.  The edges of a
+     latitude/longitude box are curved in most projections, so they are
+     mapped at SUBSET_EDGE_POINTS points each.
+  2. The window covers every pixel the box covers, even partially, and is
+     clipped to the scene.
+******************************************************************************/
+int get_spatial_window
+(
+    Geoloc_t *space,         /* I: geolocation of the representative band */
+    Spatial_box_t *box,      /* I: box the scene is subset to */
+    Subset_window_t *window  /* O: window of the representative band covering
+                                   the box */
+)
+{
+    char FUNC_NAME[] = "get_spatial_window";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int npts;                /* number of points mapped */
+    int i;                   /* looping variable */
+    int line0, line1;        /* first line and line after the window */
+    int samp0, samp1;        /* first sample and sample after the window */
+    double t;                /* position along an edge, from 0 to 1 */
+    double dx, dy;           /* delta x, y of a corner */
+    double min_line, max_line;  /* line range of the box */
+    double min_samp, max_samp;  /* sample range of the box */
+    double x[4], y[4];       /* corners of a projection box */
+    Geo_coord_t *geo = NULL; /* points along the edges of the box */
+    Img_coord_float_t *img = NULL;  /* image coordinates of the points */
+
+    if (box->west >= box->east || box->south >= box->north)
+    {
+        sprintf (errmsg, "The west and south edges of the box must be less "
+            "than the east and north edges");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (box->geographic)
+    {
+        if (box->south < -90.0 || box->north > 90.0 || box->west < -180.0 ||
+            box->east > 180.0)
+        {
+            sprintf (errmsg, "The latitudes of the box must be from -90 to "
+                "90 and the longitudes from -180 to 180");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Map the points along the north, south, west and east edges */
+        npts = 4 * SUBSET_EDGE_POINTS;
+        geo = calloc (npts, sizeof (Geo_coord_t));
+        img = calloc (npts, sizeof (Img_coord_float_t));
+        if (geo == NULL || img == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the edges of the box");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (i = 0; i < SUBSET_EDGE_POINTS; i++)
+        {
+            t = (double) i / (SUBSET_EDGE_POINTS - 1);
+            geo[i].lat = box->north * RAD;
+            geo[i].lon = (box->west + t * (box->east - box->west)) * RAD;
+            geo[SUBSET_EDGE_POINTS + i].lat = box->south * RAD;
+            geo[SUBSET_EDGE_POINTS + i].lon = geo[i].lon;
+            geo[2*SUBSET_EDGE_POINTS + i].lat =
+                (box->south + t * (box->north - box->south)) * RAD;
+            geo[2*SUBSET_EDGE_POINTS + i].lon = box->west * RAD;
+            geo[3*SUBSET_EDGE_POINTS + i].lat =
+                geo[2*SUBSET_EDGE_POINTS + i].lat;
+            geo[3*SUBSET_EDGE_POINTS + i].lon = box->east * RAD;
+        }
+        for (i = 0; i < npts; i++)
+            geo[i].is_fill = false;
+
+        if (!to_space_batch (space, npts, geo, img))
+        {
+            sprintf (errmsg, "Mapping the edges of the box to the scene");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        /* Map the corners of the projection box with the inverse of
+           window_to_map */
+        npts = 4;
+        img = calloc (npts, sizeof (Img_coord_float_t));
+        if (img == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the corners of the box");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        x[0] = x[3] = box->west;
+        x[1] = x[2] = box->east;
+        y[0] = y[1] = box->north;
+        y[2] = y[3] = box->south;
+        for (i = 0; i < npts; i++)
+        {
+            dx = x[i] - space->def.ul_corner.x;
+            dy = y[i] - space->def.ul_corner.y;
+            img[i].l = ((dx * space->sin_orien) - (dy * space->cos_orien)) /
+                space->def.pixel_size[1];
+            img[i].s = ((dx * space->cos_orien) + (dy * space->sin_orien)) /
+                space->def.pixel_size[0];
+            img[i].is_fill = false;
+        }
+    }
+
+    /* Find the lines and samples covered by the box */
+    min_line = max_line = img[0].l;
+    min_samp = max_samp = img[0].s;
+    for (i = 1; i < npts; i++)
+    {
+        min_line = min (min_line, img[i].l);
+        max_line = max (max_line, img[i].l);
+        min_samp = min (min_samp, img[i].s);
+        max_samp = max (max_samp, img[i].s);
+    }
+    free (geo);
+    free (img);
+
+    /* Clip the window to the scene before converting to integers, so boxes
+       far outside the scene can't overflow */
+    min_line = max (min_line, 0.0);
+    min_samp = max (min_samp, 0.0);
+    max_line = min (max_line, (double) space->def.img_size.l);
+    max_samp = min (max_samp, (double) space->def.img_size.s);
+
+    line0 = (int) floor (min_line + SUBSET_WINDOW_TOL);
+    line1 = (int) ceil (max_line - SUBSET_WINDOW_TOL);
+    samp0 = (int) floor (min_samp + SUBSET_WINDOW_TOL);
+    samp1 = (int) ceil (max_samp - SUBSET_WINDOW_TOL);
+    if (line1 <= line0 || samp1 <= samp0)
+    {
+        sprintf (errmsg, "The box doesn't overlap the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    window->line0 = line0;
+    window->samp0 = samp0;
+    window->nlines = line1 - line0;
+    window->nsamps = samp1 - samp0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  scale_window
+
+PURPOSE: Determines the window of a band covering the same area as the window
+of the representative band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The window is scaled by the ratio of the pixel sizes, rounding outward,
+     and clipped to the band.  A band without a pixel size is assumed to
+     have the pixel size of the representative band.
+******************************************************************************/
+static void scale_window
+(
+    Geoloc_t *space,         /* I: geolocation of the representative band */
+    Subset_window_t *ref,    /* I: window of the representative band */
+    Espa_band_meta_t *bmeta, /* I: metadata of the band */
+    Subset_window_t *window  /* O: window of the band */
+)
+{
+    double line_ratio = 1.0; /* representative lines per band line */
+    double samp_ratio = 1.0; /* representative samples per band sample */
+    int line1;               /* line after the window */
+    int samp1;               /* sample after the window */
+
+    if (bmeta->pixel_size[0] > 0.0 && bmeta->pixel_size[1] > 0.0)
+    {
+        samp_ratio = space->def.pixel_size[0] / bmeta->pixel_size[0];
+        line_ratio = space->def.pixel_size[1] / bmeta->pixel_size[1];
+    }
+
+    window->line0 = (int) floor (ref->line0 * line_ratio + SUBSET_WINDOW_TOL);
+    window->samp0 = (int) floor (ref->samp0 * samp_ratio + SUBSET_WINDOW_TOL);
+    line1 = (int) ceil ((ref->line0 + ref->nlines) * line_ratio -
+        SUBSET_WINDOW_TOL);
+    samp1 = (int) ceil ((ref->samp0 + ref->nsamps) * samp_ratio -
+        SUBSET_WINDOW_TOL);
+
+    /* Keep at least one pixel of the band */
+    window->line0 = min (window->line0, bmeta->nlines - 1);
+    window->samp0 = min (window->samp0, bmeta->nsamps - 1);
+    line1 = max (min (line1, bmeta->nlines), window->line0 + 1);
+    samp1 = max (min (samp1, bmeta->nsamps), window->samp0 + 1);
+
+    window->nlines = line1 - window->line0;
+    window->nsamps = samp1 - window->samp0;
+}
+
+
+/******************************************************************************
+MODULE:  update_subset_geoloc
+
+PURPOSE: Updates the projection corners, the latitude/longitude corners and
+the bounding coordinates of the global metadata for the window of the
+representative band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the window
+SUCCESS         Successfully updated the metadata
+
+NOTES:
+  1. The projection corners are the centers or the upper left corners of the
+     corner pixels, as given by the grid origin.  The latitude/longitude
+     corners are the centers of the corner pixels.
+  2. The valid mask of the scene is dropped, since it doesn't match the
+     window.
+******************************************************************************/
+int update_subset_geoloc
+(
+    Geoloc_t *space,         /* I: geolocation of the representative band */
+    Subset_window_t *window, /* I: window of the representative band */
+    Espa_global_meta_t *gmeta  /* I/O: global metadata to be updated */
+)
+{
+    char FUNC_NAME[] = "update_subset_geoloc";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    double offset = 0.0;     /* offset of the corners in the corner pixels */
+    Space_def_t def = space->def;  /* space definition of the window */
+    Geoloc_t *sub = NULL;    /* geolocation of the window */
+    Geo_bounds_t bounds;     /* bounding coordinates of the window */
+    Img_coord_float_t img;   /* image coordinates of a corner */
+    Geo_coord_t geo;         /* geodetic coordinates of a corner */
+
+    /* The valid mask is for the full scene */
+    strcpy (gmeta->valid_mask, ESPA_STRING_META_FILL);
+
+    /* Projection corners */
+    if (!strcmp (gmeta->proj_info.grid_origin, "CENTER"))
+        offset = 0.5;
+    window_to_map (space, window->line0 + offset, window->samp0 + offset,
+        &gmeta->proj_info.ul_corner[0], &gmeta->proj_info.ul_corner[1]);
+    window_to_map (space, window->line0 + window->nlines - 1 + offset,
+        window->samp0 + window->nsamps - 1 + offset,
+        &gmeta->proj_info.lr_corner[0], &gmeta->proj_info.lr_corner[1]);
+
+    /* Set up the mapping of the window */
+    window_to_map (space, window->line0, window->samp0, &def.ul_corner.x,
+        &def.ul_corner.y);
+    def.img_size.l = window->nlines;
+    def.img_size.s = window->nsamps;
+    sub = setup_mapping (&def);
+    if (sub == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure of "
+            "the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Latitude/longitude corners */
+    img.l = 0.5;
+    img.s = 0.5;
+    img.is_fill = false;
+    if (!from_space (sub, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping the upper left corner of the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    gmeta->ul_corner[0] = geo.lat * DEG;
+    gmeta->ul_corner[1] = geo.lon * DEG;
+
+    img.l = window->nlines - 0.5;
+    img.s = window->nsamps - 0.5;
+    if (!from_space (sub, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping the lower right corner of the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    gmeta->lr_corner[0] = geo.lat * DEG;
+    gmeta->lr_corner[1] = geo.lon * DEG;
+
+    /* Bounding coordinates */
+    if (!compute_bounds (sub, window->nlines, window->nsamps, &bounds))
+    {
+        sprintf (errmsg, "Computing the bounding coordinates of the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    gmeta->bounding_coords[ESPA_WEST] = bounds.min_lon;
+    gmeta->bounding_coords[ESPA_EAST] = bounds.max_lon;
+    gmeta->bounding_coords[ESPA_NORTH] = bounds.max_lat;
+    gmeta->bounding_coords[ESPA_SOUTH] = bounds.min_lat;
+
+    free (sub);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_band
+
+PURPOSE: Writes the window of a band to the output directory, along with its
+ENVI header, and updates the band metadata for the window.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the band
+SUCCESS         Successfully subset the band
+
+NOTES:
+  1. The output band has the same filename as the input band, without any
+     directory, in the directory of the output XML file.
+  2. The statistics and checksum of the input band don't apply to the
+     window; they are computed for the output band if enabled and cleared
+     otherwise.  The window of a sub-sampled band no longer matches the full
+     resolution size, so its sub-sampling is cleared as well.
+******************************************************************************/
+static int subset_band
+(
+    Spatial_subset_t *subset,  /* I/O: bands being subset */
+    int band                   /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "subset_band";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_file[STR_SIZE];      /* input band filename */
+    char out_file[STR_SIZE];     /* output band filename */
+    char hdr_file[STR_SIZE];     /* output ENVI header filename */
+    char *base = NULL;           /* band filename without the directory */
+    int count;                   /* number of chars copied in snprintf */
+    int size;                    /* number of bytes per pixel */
+    int line;                    /* current line in the window */
+    int block_lines;             /* number of lines in each block */
+    int nblock_lines;            /* number of lines in the current block */
+    void *buf = NULL;            /* block of lines of the window */
+    FILE *fp = NULL;             /* input band file */
+    Raw_binary_writer_t rbw;     /* output band writer */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_band_meta_t *bmeta = &subset->meta->band[band];  /* band metadata */
+    Subset_window_t *window = &subset->window[band];  /* window of the band */
+
+    /* Determine the input and output filenames */
+    if (bmeta->file_name[0] == '/')
+        count = snprintf (in_file, sizeof (in_file), "%s", bmeta->file_name);
+    else
+        count = snprintf (in_file, sizeof (in_file), "%s/%s", subset->in_dir,
+            bmeta->file_name);
+    if (count < 0 || count >= sizeof (in_file))
+    {
+        sprintf (errmsg, "Overflow of in_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    base = strrchr (bmeta->file_name, '/');
+    base = (base == NULL) ? bmeta->file_name : base + 1;
+    count = snprintf (out_file, sizeof (out_file), "%s/%s", subset->out_dir,
+        base);
+    if (count < 0 || count >= sizeof (out_file) || strlen (base) < 3)
+    {
+        sprintf (errmsg, "Invalid output filename for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    size = get_data_type_size (bmeta->data_type);
+    if (size <= 0)
+    {
+        sprintf (errmsg, "Unsupported data type for band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Allocate a block of lines of the window, sharing the memory budget
+       with the other bands subset at the same time */
+    block_lines = espa_budget_lines ((size_t) window->nsamps * size *
+        subset->nthreads, 0, espa_tune_line_block (SUBSET_LINE_BLOCK));
+    buf = get_raw_binary_buffer ((size_t) block_lines * window->nsamps *
+        size, false);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for band %s containing %d lines "
+            "x %d samples.", bmeta->name, block_lines, window->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Open the input and output files */
+    fp = open_raw_binary (in_file, "rb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the input band file: %s", in_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (open_raw_binary_writer (out_file, subset->cache, subset->codec, &rbw)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the output band file: %s",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+    bmeta->sub_sample.factor = 1;
+    bmeta->constant.is_constant = false;
+    if (subset->band_stats && attach_raw_binary_stats (&rbw, bmeta) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the statistics of the %s band",
+            out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (subset->band_cover && attach_raw_binary_cover (&rbw, bmeta) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the percent coverage of the %s "
+            "band", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (subset->band_checksum)
+        attach_raw_binary_checksum (&rbw, bmeta);
+
+    /* Copy the window a block of lines at a time.  The band metadata still
+       has the size of the input band, which the windowed read needs. */
+    for (line = 0; line < window->nlines; line += block_lines)
+    {
+        nblock_lines = block_lines;
+        if (line + nblock_lines > window->nlines)
+            nblock_lines = window->nlines - line;
+
+        if (read_raw_binary_window (fp, bmeta, window->line0 + line,
+            window->samp0, nblock_lines, window->nsamps, 1, buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of band %s",
+                window->line0 + line, window->line0 + line + nblock_lines - 1,
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (write_raw_binary_writer (&rbw, nblock_lines, window->nsamps, size,
+            buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the output band file: %s",
+                out_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Close the files and free the block buffer */
+    close_raw_binary (fp);
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the output band file: %s", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    release_raw_binary_buffer (buf);
+
+    /* Update the band metadata for the window */
+    bmeta->nlines = window->nlines;
+    bmeta->nsamps = window->nsamps;
+    memmove (bmeta->file_name, base, strlen (base) + 1);
+
+    /* Write the ENVI header for the band */
+    if (create_envi_struct (bmeta, &subset->meta->global, &envi_hdr) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (hdr_file, out_file);
+    sprintf (&hdr_file[strlen(hdr_file)-3], "hdr");
+    if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_band_range
+
+PURPOSE: Subsets a chunk of the bands; the chunk function of the task pool.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting a band
+SUCCESS         Successfully subset the bands
+
+NOTES:
+******************************************************************************/
+static int subset_band_range
+(
+    void *arg,            /* I: bands being subset (Spatial_subset_t *) */
+    int first,            /* I: first band of the chunk */
+    int end,              /* I: band after the last one of the chunk */
+    int runner            /* I: number of the runner (not used) */
+)
+{
+    int band;             /* looping variable for the bands */
+
+    for (band = first; band < end; band++)
+    {
+        if (subset_band (arg, band) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_xml_by_box
+
+PURPOSE: Subsets the bands of the input XML file to a projection-space or
+latitude/longitude box, writing the subset bands to the directory of the
+output XML file and the metadata of the subset to the output XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error subsetting the scene
+SUCCESS         Successfully subset the scene
+
+NOTES:
+  1. The output XML file has to be in a different directory than the input
+     XML file, since the subset bands keep their filenames.
+  2. The band sizes, the projection and latitude/longitude corners, and the
+     bounding coordinates are updated for the window.  The bands are subset
+     concurrently by the task pool (see espa_task.h).
+******************************************************************************/
+int subset_xml_by_box
+(
+    char *in_xml_file,   /* I: input XML file to be subset */
+    char *out_xml_file,  /* I: output XML file; the subset bands are written
+                               to its directory */
+    Spatial_box_t *box   /* I: box the scene is subset to */
+)
+{
+    char FUNC_NAME[] = "subset_xml_by_box";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char in_path[PATH_MAX];      /* resolved input directory */
+    char out_path[PATH_MAX];     /* resolved output directory */
+    int i;                       /* looping variable for the bands */
+    size_t line_bytes = 0;       /* bytes in the widest line of a window */
+    Space_def_t space_def;       /* geolocation space definition */
+    Geoloc_t *space = NULL;      /* geolocation of the representative band */
+    Subset_window_t ref_window;  /* window of the representative band */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata of the scene */
+    Spatial_subset_t subset;     /* bands being subset */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (in_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (in_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* The subset bands can't overwrite the input bands */
+    memset (&subset, 0, sizeof (subset));
+    if (get_subset_dir (in_xml_file, subset.in_dir) != SUCCESS ||
+        get_subset_dir (out_xml_file, subset.out_dir) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (realpath (subset.in_dir, in_path) == NULL ||
+        realpath (subset.out_dir, out_path) == NULL)
+    {
+        sprintf (errmsg, "Resolving the directories of the input and output "
+            "XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!strcmp (in_path, out_path))
+    {
+        sprintf (errmsg, "The output XML file must be in a different "
+            "directory than the input XML file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Find the window of the representative band covering the box */
+    if (!get_geoloc_info (&xml_metadata, &space_def))
+    {
+        sprintf (errmsg, "Copying the geolocation information from the XML "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    space = setup_mapping (&space_def);
+    if (space == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (get_spatial_window (space, box, &ref_window) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the window of %s", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Scale the window to each band */
+    subset.window = calloc (max (xml_metadata.nbands, 1),
+        sizeof (Subset_window_t));
+    if (subset.window == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the band windows");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands; i++)
+    {
+        scale_window (space, &ref_window, &xml_metadata.band[i],
+            &subset.window[i]);
+        line_bytes = max (line_bytes, (size_t) subset.window[i].nsamps *
+            get_data_type_size (xml_metadata.band[i].data_type));
+    }
+
+    /* Update the geolocation of the scene for the window, which the ENVI
+       headers of the bands use */
+    if (update_subset_geoloc (space, &ref_window, &xml_metadata.global) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Subset the bands */
+    subset.meta = &xml_metadata;
+    subset.cache = get_raw_binary_cache_mode ();
+    subset.codec = get_raw_binary_codec ();
+    subset.band_stats = use_raw_binary_stats ();
+    subset.band_cover = use_raw_binary_cover ();
+    subset.band_checksum = use_raw_binary_checksum ();
+    subset.nthreads = espa_budget_threads (line_bytes * SUBSET_LINE_BLOCK, 0,
+        min (espa_task_nthreads (), max (xml_metadata.nbands, 1)));
+    if (espa_parallel_for (0, xml_metadata.nbands, 1, subset.nthreads,
+        subset_band_range, &subset) != SUCCESS)
+    {
+        sprintf (errmsg, "Subsetting the bands of %s", in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the metadata of the subset and validate it */
+    if (write_metadata (&xml_metadata, out_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (validate_xml_file (out_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Free the metadata structure and the windows */
+    free_metadata (&xml_metadata);
+    free (subset.window);
+    free (space);
+
+    /* Successful subset */
+    return (SUCCESS);
+}
@@ -0,0 +1,108 @@
+/*****************************************************************************
+FILE: espa_spatial_subset.h
+
+PURPOSE: Contains defines, structures and prototypes for subsetting the bands
+of a scene to a projection-space or latitude/longitude box.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The box is converted to a window of lines and samples of the
+     representative band (see get_geoloc_info), which is scaled to each
+     band by the ratio of the pixel sizes.  The bands are expected to share
+     the upper left corner of the representative band.
+  2. Only the lines and samples of the window are read from the input bands.
+*****************************************************************************/
+
+#ifndef ESPA_SPATIAL_SUBSET_H
+#define ESPA_SPATIAL_SUBSET_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "espa_geoloc.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
+
+/* Defines */
+/* Number of lines of a band copied at a time, unless the node profile sets
+   line_block (see espa_tune.h) */
+#define SUBSET_LINE_BLOCK 256
+
+/* Number of points mapped along each edge of a latitude/longitude box, since
+   the edges are curved in the projection of the scene */
+#define SUBSET_EDGE_POINTS 256
+
+/* Tolerance, in pixels, for a box edge to be on a pixel edge rather than
+   partially covering the next pixel */
+#define SUBSET_WINDOW_TOL 1.0e-6
+
+/* Type definitions */
+/* Box the scene is subset to */
+typedef struct
+{
+    bool geographic;     /* are the edges latitudes and longitudes (degrees),
+                            rather than projection coordinates? */
+    double west;         /* west edge; longitude or projection x */
+    double east;         /* east edge; longitude or projection x */
+    double north;        /* north edge; latitude or projection y */
+    double south;        /* south edge; latitude or projection y */
+} Spatial_box_t;
+
+/* Window of lines and samples of a band */
+typedef struct
+{
+    int line0;           /* first line of the window (0-based) */
+    int samp0;           /* first sample of the window (0-based) */
+    int nlines;          /* number of lines in the window */
+    int nsamps;          /* number of samples in the window */
+} Subset_window_t;
+
+/* Prototypes */
+int get_subset_dir
+(
+    char *filename,      /* I: filename to get the directory of */
+    char *dir            /* O: directory of the filename (STR_SIZE) */
+);
+
+void window_to_map
+(
+    Geoloc_t *space,     /* I: geolocation of the representative band */
+    double line,         /* I: line location */
+    double samp,         /* I: sample location */
+    double *x,           /* O: projection x coordinate */
+    double *y            /* O: projection y coordinate */
+);
+
+int get_spatial_window
+(
+    Geoloc_t *space,         /* I: geolocation of the representative band */
+    Spatial_box_t *box,      /* I: box the scene is subset to */
+    Subset_window_t *window  /* O: window of the representative band covering
+                                   the box */
+);
+
+int update_subset_geoloc
+(
+    Geoloc_t *space,         /* I: geolocation of the representative band */
+    Subset_window_t *window, /* I: window of the representative band */
+    Espa_global_meta_t *gmeta  /* I/O: global metadata to be updated */
+);
+
+int subset_xml_by_box
+(
+    char *in_xml_file,   /* I: input XML file to be subset */
+    char *out_xml_file,  /* I: output XML file; the subset bands are written
+                               to its directory */
+    Spatial_box_t *box   /* I: box the scene is subset to */
+);
+
+#endif
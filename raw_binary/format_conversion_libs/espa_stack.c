@@ -0,0 +1,1304 @@
+/*****************************************************************************
+FILE: espa_stack.c
+
+PURPOSE: Contains functions for stacking a band of several acquisitions of
+the same grid into a time series.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The band is read a block of lines at a time from all the acquisitions
+     at once through the asynchronous I/O queue (see raw_binary_async.h),
+     reading the next block while the current one is interleaved or
+     compressed by the task pool (see espa_task.h).
+  3. The input bands are read by file offset, so compressed (chunked) bands
+     can't be stacked.
+*****************************************************************************/
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "espa_stack.h"
+#include "espa_spatial_subset.h"
+#include "convert_espa_to_zarr.h"
+#include "envi_header.h"
+#include "raw_binary_io.h"
+#include "raw_binary_async.h"
+#include "raw_binary_pool.h"
+#include "espa_task.h"
+
+/* Acquisition of the stack */
+typedef struct
+{
+    char *xml_file;              /* input XML file of the product */
+    int order;                   /* position of the product in the input
+                                    list */
+    int date;                    /* acquisition date, year * 1000 + DOY */
+    char product_id[STR_SIZE];   /* product ID */
+    FILE *fp;                    /* band file */
+} Stack_acq_t;
+
+/* Stack being written, a block of lines at a time */
+typedef struct
+{
+    Stack_acq_t *acq;            /* acquisitions in date order */
+    int nacq;                    /* number of acquisitions */
+    int nlines;                  /* number of lines in the band */
+    int nsamps;                  /* number of samples in the band */
+    int size;                    /* number of bytes per pixel */
+    int block_lines;             /* number of lines in a full block */
+    int first_line;              /* first line written */
+    int end_line;                /* line after the last line written */
+    bool write_meta;             /* should the metadata of the Zarr store be
+                                    written? */
+    int line;                    /* first line of the current block */
+    int nblock_lines;            /* number of lines in the current block */
+    uint8_t *block;              /* current block; the lines of each
+                                    acquisition start block_lines * nsamps
+                                    pixels after the previous one */
+    uint8_t *out_buf;            /* interleaved lines of the cube */
+    char *array_dir;             /* directory of the Zarr array */
+    int chunk_samps;             /* number of samples in a Zarr chunk */
+    int level;                   /* zlib compression level */
+    bool skip_fill;              /* should all-fill chunks be skipped? */
+    uint8_t *fill_chunk;         /* Zarr chunk of fill values */
+    uint8_t **chunk_buf;         /* chunk being compressed, per runner */
+    uint8_t **comp_buf;          /* compressed chunk, per runner */
+    uLong comp_bound;            /* size of each comp_buf */
+} Stack_job_t;
+
+
+/******************************************************************************
+MODULE:  compare_dates
+
+PURPOSE: Orders the acquisitions by date, keeping the order of the input
+list for the same date; the qsort compare function of the acquisitions.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+<0, 0, >0       The first acquisition goes before, with or after the second
+
+NOTES:
+******************************************************************************/
+static int compare_dates
+(
+    const void *a,           /* I: first acquisition */
+    const void *b            /* I: second acquisition */
+)
+{
+    const Stack_acq_t *aa = a;   /* first acquisition */
+    const Stack_acq_t *ab = b;   /* second acquisition */
+
+    if (aa->date != ab->date)
+        return ((aa->date < ab->date) ? -1 : 1);
+    return (aa->order - ab->order);
+}
+
+
+/******************************************************************************
+MODULE:  get_acq_date
+
+PURPOSE: Determines the date of an acquisition, as year * 1000 + DOY.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the date
+SUCCESS         Successfully determined the date
+
+NOTES:
+  1. The date is the first valid pixel of the center line of the date band
+     if the product has one, so it matches the date bands of the product.
+     Otherwise, or if the center line is all fill, it is the acquisition
+     date of the global metadata.
+******************************************************************************/
+static int get_acq_date
+(
+    Espa_internal_meta_t *meta,  /* I: metadata of the product */
+    char *dir,               /* I: directory of the XML file */
+    int *date                /* O: date of the acquisition */
+)
+{
+    char FUNC_NAME[] = "get_acq_date";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char band_file[STR_SIZE];    /* date band filename */
+    int i;                       /* index of the date band */
+    int s;                       /* looping variable for the samples */
+    int count;                   /* number of chars copied in snprintf */
+    int year, month, day;        /* acquisition date */
+    int status;                  /* status of reading the center line */
+    uint32_t value;              /* date of a pixel */
+    uint32_t *line_buf = NULL;   /* center line of the date band */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the date band */
+    struct tm tm;                /* acquisition date, for the DOY */
+    FILE *fp = NULL;             /* date band file */
+
+    i = find_band_metadata (meta, NULL, STACK_DATE_BAND, NULL);
+    if (i >= 0 && meta->band[i].data_type == ESPA_UINT32)
+    {
+        bmeta = &meta->band[i];
+        if (bmeta->file_name[0] == '/')
+            count = snprintf (band_file, sizeof (band_file), "%s",
+                bmeta->file_name);
+        else
+            count = snprintf (band_file, sizeof (band_file), "%s/%s", dir,
+                bmeta->file_name);
+        if (count < 0 || count >= sizeof (band_file))
+        {
+            sprintf (errmsg, "Overflow of band_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        line_buf = malloc (bmeta->nsamps * sizeof (uint32_t));
+        if (line_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for a line of the date band");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        fp = open_raw_binary (band_file, "rb");
+        status = (fp == NULL) ? ERROR : SUCCESS;
+        if (status == SUCCESS)
+            status = read_raw_binary_window (fp, bmeta, bmeta->nlines / 2,
+                0, 1, bmeta->nsamps, 1, line_buf);
+        if (fp != NULL)
+            close_raw_binary (fp);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the center line of the date band %s",
+                band_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (line_buf);
+            return (ERROR);
+        }
+
+        for (s = 0; s < bmeta->nsamps; s++)
+        {
+            value = line_buf[s];
+            if (value == 0 || (bmeta->fill_value != ESPA_INT_META_FILL &&
+                value == (uint32_t) bmeta->fill_value))
+                continue;
+            if (value % 1000 >= 1 && value % 1000 <= 366)
+            {
+                *date = (int) value;
+                free (line_buf);
+                return (SUCCESS);
+            }
+        }
+        free (line_buf);
+    }
+
+    /* Use the acquisition date (YYYY-MM-DD), letting mktime find the DOY */
+    if (sscanf (meta->global.acquisition_date, "%4d-%2d-%2d", &year, &month,
+        &day) != 3 || year < 1970 || month < 1 || month > 12 || day < 1 ||
+        day > 31)
+    {
+        sprintf (errmsg, "Invalid acquisition date: %s",
+            meta->global.acquisition_date);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&tm, 0, sizeof (tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = 12;
+    tm.tm_isdst = -1;
+    if (mktime (&tm) == (time_t) -1)
+    {
+        sprintf (errmsg, "Converting the acquisition date: %s",
+            meta->global.acquisition_date);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    *date = year * 1000 + tm.tm_yday + 1;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_acq
+
+PURPOSE: Reads the metadata of an acquisition, determines its date, and opens
+its band file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the acquisition
+SUCCESS         Successfully opened the acquisition
+
+NOTES:
+  1. The band has to have the size and data type of the band of the first
+     product, given by ref_band.
+******************************************************************************/
+static int open_acq
+(
+    char *xml_file,          /* I: input XML file of the product */
+    int order,               /* I: position of the product in the input
+                                   list */
+    char *band_name,         /* I: name of the band to be stacked */
+    Espa_band_meta_t *ref_band,  /* I: band of the first product */
+    Stack_acq_t *acq         /* O: acquisition */
+)
+{
+    char FUNC_NAME[] = "open_acq";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char dir[STR_SIZE];          /* directory of the XML file */
+    char band_file[STR_SIZE];    /* band filename */
+    int i;                       /* index of the band */
+    int count;                   /* number of chars copied in snprintf */
+    int status = SUCCESS;        /* return status */
+    Espa_band_meta_t *bmeta = NULL;  /* metadata of the band */
+    Espa_internal_meta_t meta;   /* metadata of the product */
+
+    acq->xml_file = xml_file;
+    acq->order = order;
+    acq->fp = NULL;
+    if (validate_xml_file (xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Only the band names, files and sizes are needed */
+    init_metadata_struct (&meta);
+    if (parse_metadata_lazy (xml_file, &meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (get_subset_dir (xml_file, dir) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&meta);
+        return (ERROR);
+    }
+
+    i = find_band_metadata (&meta, NULL, band_name, NULL);
+    if (i < 0)
+    {
+        sprintf (errmsg, "Band %s isn't in %s", band_name, xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&meta);
+        return (ERROR);
+    }
+    bmeta = &meta.band[i];
+
+    if (bmeta->nlines != ref_band->nlines ||
+        bmeta->nsamps != ref_band->nsamps ||
+        bmeta->data_type != ref_band->data_type)
+    {
+        sprintf (errmsg, "Band %s of %s has a different size or data type "
+            "than in the first product", band_name, xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status == SUCCESS)
+        status = get_acq_date (&meta, dir, &acq->date);
+
+    if (status == SUCCESS)
+    {
+        snprintf (acq->product_id, sizeof (acq->product_id), "%s",
+            meta.global.product_id);
+        if (bmeta->file_name[0] == '/')
+            count = snprintf (band_file, sizeof (band_file), "%s",
+                bmeta->file_name);
+        else
+            count = snprintf (band_file, sizeof (band_file), "%s/%s", dir,
+                bmeta->file_name);
+        if (count < 0 || count >= sizeof (band_file))
+        {
+            sprintf (errmsg, "Overflow of band_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        acq->fp = open_raw_binary (band_file, "rb");
+        if (acq->fp == NULL)
+        {
+            sprintf (errmsg, "Opening the input band file: %s", band_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (fileno (acq->fp) < 0)
+        {
+            sprintf (errmsg, "Input band file %s is compressed (chunked), "
+                "which can't be stacked", band_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    free_metadata (&meta);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  read_stack_block
+
+PURPOSE: Submits the reads of a block of lines of every acquisition.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error submitting the reads
+SUCCESS         Successfully submitted the reads
+
+NOTES:
+  1. The buffer must not be used until wait_raw_binary_async returns.
+******************************************************************************/
+static int read_stack_block
+(
+    Raw_binary_async_t *aio, /* I/O: asynchronous I/O queue */
+    Stack_job_t *job,        /* I: stack being written */
+    int line,                /* I: first line of the block */
+    int nblock_lines,        /* I: number of lines in the block */
+    uint8_t *buf             /* O: block of all the acquisitions */
+)
+{
+    int a;                   /* looping variable for the acquisitions */
+    size_t line_bytes = (size_t) job->nsamps * job->size;
+                             /* number of bytes in a line */
+
+    for (a = 0; a < job->nacq; a++)
+    {
+        if (submit_raw_binary_read (aio, job->acq[a].fp,
+            (long) line * line_bytes, nblock_lines * line_bytes,
+            &buf[a * job->block_lines * line_bytes]) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  interleave_stack_lines
+
+PURPOSE: Interleaves a range of lines of the current block into the lines of
+the cube, as the chunk function of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successfully interleaved the lines
+
+NOTES:
+  1. Each pixel of the cube holds the values of the acquisitions in date
+     order.
+******************************************************************************/
+static int interleave_stack_lines
+(
+    void *arg,              /* I: stack being written (Stack_job_t *) */
+    int first,              /* I: first line of the block */
+    int end,                /* I: line after the last one */
+    int runner              /* I: number of the runner */
+)
+{
+    Stack_job_t *job = arg; /* stack being written */
+    int l;                  /* looping variable for the lines */
+    int a;                  /* looping variable for the acquisitions */
+    int s;                  /* looping variable for the samples */
+    int nacq = job->nacq;   /* number of acquisitions */
+    int nsamps = job->nsamps;   /* number of samples in a line */
+    size_t in_pix;          /* first input pixel of the line */
+    size_t out_pix;         /* first output pixel of the line */
+    uint8_t *in8, *out8;    /* 8-bit input and output lines */
+    uint16_t *in16, *out16; /* 16-bit input and output lines */
+    uint32_t *in32, *out32; /* 32-bit input and output lines */
+    uint64_t *in64, *out64; /* 64-bit input and output lines */
+
+    for (l = first; l < end; l++)
+    {
+        for (a = 0; a < nacq; a++)
+        {
+            in_pix = ((size_t) a * job->block_lines + l) * nsamps;
+            out_pix = (size_t) l * nsamps * nacq + a;
+            switch (job->size)
+            {
+                case 1:
+                    in8 = job->block + in_pix;
+                    out8 = job->out_buf + out_pix;
+                    for (s = 0; s < nsamps; s++)
+                        out8[(size_t) s * nacq] = in8[s];
+                    break;
+                case 2:
+                    in16 = (uint16_t *) job->block + in_pix;
+                    out16 = (uint16_t *) job->out_buf + out_pix;
+                    for (s = 0; s < nsamps; s++)
+                        out16[(size_t) s * nacq] = in16[s];
+                    break;
+                case 4:
+                    in32 = (uint32_t *) job->block + in_pix;
+                    out32 = (uint32_t *) job->out_buf + out_pix;
+                    for (s = 0; s < nsamps; s++)
+                        out32[(size_t) s * nacq] = in32[s];
+                    break;
+                default:
+                    in64 = (uint64_t *) job->block + in_pix;
+                    out64 = (uint64_t *) job->out_buf + out_pix;
+                    for (s = 0; s < nsamps; s++)
+                        out64[(size_t) s * nacq] = in64[s];
+                    break;
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  compress_stack_chunks
+
+PURPOSE: Pads, compresses and writes a range of the Zarr chunks of the
+current block, as the chunk function of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error compressing or writing a chunk
+SUCCESS         Successfully wrote the chunks
+
+NOTES:
+  1. Each chunk holds all the acquisitions, so the block is one row of
+     chunks.  Chunks which are all fill aren't written (see
+     convert_espa_to_zarr.h).
+******************************************************************************/
+static int compress_stack_chunks
+(
+    void *arg,              /* I: stack being written (Stack_job_t *) */
+    int first,              /* I: first chunk column */
+    int end,                /* I: chunk column after the last one */
+    int runner              /* I: number of the runner */
+)
+{
+    char FUNC_NAME[] = "compress_stack_chunks";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char chunk_file[STR_SIZE];  /* name of the chunk file */
+    int c;                      /* looping variable for the chunk columns */
+    int a;                      /* looping variable for the acquisitions */
+    int l;                      /* looping variable for the chunk lines */
+    int samp;                   /* first sample of the chunk */
+    int nchunk_samps;           /* number of band samples in the chunk */
+    size_t chunk_bytes;         /* number of bytes in a chunk */
+    size_t chunk_line_bytes;    /* number of bytes in a chunk line */
+    size_t line_bytes;          /* number of bytes in a band line */
+    uLongf comp_len;            /* size of the compressed chunk */
+    Stack_job_t *job = arg;     /* stack being written */
+    uint8_t *chunk = job->chunk_buf[runner];  /* chunk being compressed */
+    FILE *fp = NULL;            /* chunk file pointer */
+
+    chunk_line_bytes = (size_t) job->chunk_samps * job->size;
+    chunk_bytes = (size_t) job->nacq * job->block_lines * chunk_line_bytes;
+    line_bytes = (size_t) job->nsamps * job->size;
+    for (c = first; c < end; c++)
+    {
+        /* Copy the chunk, padding the edge chunks with fill */
+        samp = c * job->chunk_samps;
+        nchunk_samps = job->chunk_samps;
+        if (samp + nchunk_samps > job->nsamps)
+            nchunk_samps = job->nsamps - samp;
+        if (nchunk_samps < job->chunk_samps ||
+            job->nblock_lines < job->block_lines)
+            memcpy (chunk, job->fill_chunk, chunk_bytes);
+        for (a = 0; a < job->nacq; a++)
+        {
+            for (l = 0; l < job->nblock_lines; l++)
+                memcpy (&chunk[((size_t) a * job->block_lines + l) *
+                    chunk_line_bytes], &job->block[((size_t) a *
+                    job->block_lines + l) * line_bytes + (size_t) samp *
+                    job->size], (size_t) nchunk_samps * job->size);
+        }
+
+        snprintf (chunk_file, sizeof (chunk_file), "%s/0.%d.%d",
+            job->array_dir, job->line / job->block_lines, c);
+
+        /* Leave out the chunks which are all fill, removing any left from a
+           previous stack */
+        if (job->skip_fill && !memcmp (chunk, job->fill_chunk, chunk_bytes))
+        {
+            unlink (chunk_file);
+            continue;
+        }
+
+        comp_len = job->comp_bound;
+        if (compress2 (job->comp_buf[runner], &comp_len, chunk, chunk_bytes,
+            job->level) != Z_OK)
+        {
+            sprintf (errmsg, "Compressing the Zarr chunk: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        fp = fopen (chunk_file, "wb");
+        if (fp == NULL)
+        {
+            sprintf (errmsg, "Creating the Zarr chunk file: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (fwrite (job->comp_buf[runner], 1, comp_len, fp) != comp_len)
+        {
+            sprintf (errmsg, "Writing the Zarr chunk file: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fp);
+            return (ERROR);
+        }
+        if (fclose (fp) != 0)
+        {
+            sprintf (errmsg, "Closing the Zarr chunk file: %s", chunk_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_stack
+
+PURPOSE: Reads the band of all the acquisitions a block of lines at a time
+and writes the blocks to the cube or the Zarr array.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the stack
+SUCCESS         Successfully wrote the stack
+
+NOTES:
+  1. The reads of the next block are in flight while the current block is
+     processed, so two blocks of all the acquisitions are held in memory.
+  2. fp_cube is NULL for the Zarr array, whose job has the chunk buffers of
+     nthreads runners.
+  3. Only the lines from first_line to end_line are written, which for a
+     part of the Zarr array are whole rows of chunks.
+******************************************************************************/
+static int write_stack
+(
+    Stack_job_t *job,        /* I/O: stack being written */
+    int nthreads,            /* I: number of runners */
+    FILE *fp_cube            /* I: cube file; NULL for the Zarr array */
+)
+{
+    char FUNC_NAME[] = "write_stack";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int line;                    /* first line of the current block */
+    int next_lines;              /* number of lines in the next block */
+    int ncols;                   /* number of chunk columns */
+    int cur;                     /* buffer of the current block */
+    int status = SUCCESS;        /* return status */
+    size_t block_bytes;          /* bytes in a block of all acquisitions */
+    uint8_t *block_buf[2] = {NULL, NULL};  /* current and next blocks */
+    Raw_binary_async_t *aio = NULL;  /* asynchronous I/O queue */
+
+    block_bytes = (size_t) job->nacq * job->block_lines * job->nsamps *
+        job->size;
+    block_buf[0] = get_raw_binary_buffer (block_bytes, false);
+    block_buf[1] = get_raw_binary_buffer (block_bytes, false);
+    if (block_buf[0] == NULL || block_buf[1] == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for %d lines of %d acquisitions",
+            job->block_lines, job->nacq);
+        error_handler (true, FUNC_NAME, errmsg);
+        release_raw_binary_buffer (block_buf[0]);
+        release_raw_binary_buffer (block_buf[1]);
+        return (ERROR);
+    }
+
+    aio = open_raw_binary_async ((job->nacq < RB_ASYNC_QUEUE_DEPTH) ?
+        job->nacq : RB_ASYNC_QUEUE_DEPTH);
+    if (aio == NULL)
+    {
+        sprintf (errmsg, "Opening the asynchronous I/O queue for the "
+            "acquisitions");
+        error_handler (true, FUNC_NAME, errmsg);
+        release_raw_binary_buffer (block_buf[0]);
+        release_raw_binary_buffer (block_buf[1]);
+        return (ERROR);
+    }
+
+    /* Start reading the first block */
+    ncols = (fp_cube != NULL) ? 0 :
+        (job->nsamps + job->chunk_samps - 1) / job->chunk_samps;
+    next_lines = (job->end_line - job->first_line < job->block_lines) ?
+        job->end_line - job->first_line : job->block_lines;
+    if (next_lines > 0 && read_stack_block (aio, job, job->first_line,
+        next_lines, block_buf[0]) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading lines %d-%d of the acquisitions",
+            job->first_line, job->first_line + next_lines - 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    for (line = job->first_line, cur = 0;
+        status == SUCCESS && line < job->end_line;
+        line += job->block_lines, cur = !cur)
+    {
+        job->line = line;
+        job->nblock_lines = job->block_lines;
+        if (line + job->nblock_lines > job->end_line)
+            job->nblock_lines = job->end_line - line;
+
+        if (wait_raw_binary_async (aio) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of the acquisitions", line,
+                line + job->nblock_lines - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Start reading the next block into the other buffer */
+        if (line + job->block_lines < job->end_line)
+        {
+            next_lines = job->block_lines;
+            if (line + job->block_lines + next_lines > job->end_line)
+                next_lines = job->end_line - line - job->block_lines;
+            if (read_stack_block (aio, job, line + job->block_lines,
+                next_lines, block_buf[!cur]) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d of the acquisitions",
+                    line + job->block_lines,
+                    line + job->block_lines + next_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+        }
+
+        /* Interleave and write the block to the cube, or write its chunks
+           to the Zarr array */
+        job->block = block_buf[cur];
+        if (fp_cube != NULL)
+        {
+            status = espa_parallel_for (0, job->nblock_lines, 1, nthreads,
+                interleave_stack_lines, job);
+            if (status == SUCCESS && write_raw_binary (fp_cube,
+                job->nblock_lines, job->nsamps * job->nacq, job->size,
+                job->out_buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d of the cube", line,
+                    line + job->nblock_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+        else
+            status = espa_parallel_for (0, ncols, 1, nthreads,
+                compress_stack_chunks, job);
+    }
+
+    /* Let any reads still in flight after an error finish before the
+       buffers are released */
+    if (status != SUCCESS)
+        wait_raw_binary_async (aio);
+    close_raw_binary_async (aio);
+    release_raw_binary_buffer (block_buf[0]);
+    release_raw_binary_buffer (block_buf[1]);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_stack_cube
+
+PURPOSE: Writes the cube of the stack, with its ENVI header, and the XML
+metadata describing it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the cube
+SUCCESS         Successfully wrote the cube
+
+NOTES:
+  1. The cube is named after the output XML file, with the .img extension,
+     in the same directory.  Each acquisition is a band of the XML metadata
+     named after the band and the date, whose file is the cube, as for the
+     products converted to BIP (see convert_espa_to_raw_binary_bip.h).
+  2. The band names of the ENVI header are left out if there are more than
+     MAX_ENVI_BANDS acquisitions.
+******************************************************************************/
+static int write_stack_cube
+(
+    Stack_job_t *job,        /* I/O: stack being written */
+    char *out_xml_file,      /* I: output XML file */
+    Espa_internal_meta_t *meta,  /* I/O: metadata of the first product; its
+                                   bands are restored on return */
+    int band                 /* I: index of the band in meta */
+)
+{
+    char FUNC_NAME[] = "write_stack_cube";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char cube_file[STR_SIZE];    /* cube filename */
+    char hdr_file[STR_SIZE];     /* ENVI header filename */
+    char *base = NULL;           /* cube filename without the directory */
+    char *cptr = NULL;           /* extension of the filenames */
+    int a;                       /* looping variable for the acquisitions */
+    int ndup = 0;                /* number of previous acquisitions on the
+                                    same date */
+    int nthreads;                /* number of runners */
+    int nbands;                  /* number of bands of the first product */
+    int status;                  /* return status */
+    Espa_band_meta_t *bmeta = NULL;  /* bands of the first product */
+    Espa_band_meta_t *acq_band = NULL;  /* band of each acquisition */
+    Envi_header_t envi_hdr;      /* ENVI header information */
+    FILE *fp_cube = NULL;        /* cube file */
+
+    /* Name the cube after the XML file */
+    snprintf (cube_file, sizeof (cube_file), "%s", out_xml_file);
+    base = strrchr (cube_file, '/');
+    base = (base == NULL) ? cube_file : base + 1;
+    cptr = strrchr (base, '.');
+    if (cptr == NULL)
+        cptr = &base[strlen (base)];
+    if ((cptr - cube_file) + 5 > sizeof (cube_file) || cptr == base)
+    {
+        sprintf (errmsg, "Invalid output XML filename: %s", out_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (cptr, ".img");
+    strcpy (hdr_file, cube_file);
+    strcpy (&hdr_file[cptr - cube_file], ".hdr");
+
+    /* Write the cube */
+    job->out_buf = get_raw_binary_buffer ((size_t) job->block_lines *
+        job->nsamps * job->nacq * job->size, false);
+    if (job->out_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the lines of the cube");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp_cube = open_raw_binary (cube_file, "wb");
+    if (fp_cube == NULL)
+    {
+        sprintf (errmsg, "Opening the cube file: %s", cube_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        release_raw_binary_buffer (job->out_buf);
+        return (ERROR);
+    }
+
+    nthreads = espa_task_nthreads ();
+    if (nthreads > job->block_lines)
+        nthreads = job->block_lines;
+    status = write_stack (job, nthreads, fp_cube);
+    close_raw_binary (fp_cube);
+    release_raw_binary_buffer (job->out_buf);
+    job->out_buf = NULL;
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Set up a band for each acquisition, without the statistics, checksum
+       and percent coverage of the band of the first product */
+    acq_band = calloc (job->nacq, sizeof (Espa_band_meta_t));
+    if (acq_band == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the acquisition bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (a = 0; a < job->nacq; a++)
+    {
+        acq_band[a] = meta->band[band];
+        ndup = (a > 0 && job->acq[a].date == job->acq[a-1].date) ?
+            ndup + 1 : 0;
+        if (ndup > 0)
+            snprintf (acq_band[a].name, sizeof (acq_band[a].name),
+                "%s_%07d_%d", meta->band[band].name, job->acq[a].date,
+                ndup + 1);
+        else
+            snprintf (acq_band[a].name, sizeof (acq_band[a].name), "%s_%07d",
+                meta->band[band].name, job->acq[a].date);
+        snprintf (acq_band[a].file_name, sizeof (acq_band[a].file_name),
+            "%s", base);
+        acq_band[a].stats.valid_pixels = ESPA_INT_META_FILL;
+        acq_band[a].stats.nbins = 0;
+        acq_band[a].checksum[0] = '\0';
+        acq_band[a].ncover = 0;
+        acq_band[a].percent_cover = NULL;
+        acq_band[a].arena = NULL;
+    }
+
+    /* Write the ENVI header of the cube */
+    status = create_envi_struct (&acq_band[0], &meta->global, &envi_hdr);
+    if (status == SUCCESS)
+    {
+        envi_hdr.nbands = job->nacq;
+        strcpy (envi_hdr.interleave, "BIP");
+        for (a = 0; a < job->nacq && a < MAX_ENVI_BANDS; a++)
+            snprintf (envi_hdr.band_names[a], sizeof (envi_hdr.band_names[a]),
+                "%s", acq_band[a].name);
+        status = write_envi_hdr (hdr_file, &envi_hdr);
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (acq_band);
+        return (ERROR);
+    }
+
+    /* Write the XML metadata with the acquisition bands in place of the
+       bands of the first product */
+    free_band_index (meta);
+    bmeta = meta->band;
+    nbands = meta->nbands;
+    meta->band = acq_band;
+    meta->nbands = job->nacq;
+    status = write_metadata (meta, out_xml_file);
+    if (status == SUCCESS)
+        status = validate_xml_file (out_xml_file);
+    free_band_index (meta);
+    meta->band = bmeta;
+    meta->nbands = nbands;
+    free (acq_band);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML metadata of the cube: %s",
+            out_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_stack_zarr_meta
+
+PURPOSE: Writes the metadata of the Zarr store of the stack: its attributes,
+the coordinates of each dimension, and the metadata of the array of the
+band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the metadata
+SUCCESS         Successfully wrote the metadata
+
+NOTES:
+  1. The attributes of the store are the global metadata of the first
+     product, without the metadata specific to its acquisition.  The time
+     coordinate has the date of each acquisition, as year * 1000 + DOY, and
+     lists the product IDs in the same order.
+******************************************************************************/
+static int write_stack_zarr_meta
+(
+    Stack_job_t *job,        /* I: stack being written */
+    char *zarr_dir,          /* I: output Zarr store (directory) */
+    Espa_internal_meta_t *meta,  /* I: metadata of the first product */
+    int band,                /* I: index of the band in meta */
+    char *array_dir          /* I: directory of the array of the band */
+)
+{
+    char FUNC_NAME[] = "write_stack_zarr_meta";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char coord_dir[STR_SIZE];    /* directory of the time coordinate */
+    char json_file[STR_SIZE];    /* name of the .zattrs file of the time */
+    int a;                       /* looping variable for the acquisitions */
+    int status = SUCCESS;        /* return status */
+    int shape[3];                /* size of each dimension of the array */
+    int chunks[3];               /* chunk size of each dimension */
+    int32_t *dates = NULL;       /* date of each acquisition */
+    Espa_band_meta_t *bmeta = &meta->band[band];  /* band of the stack */
+    Espa_global_meta_t gmeta;    /* global metadata of the store */
+    FILE *fp = NULL;             /* .zattrs file pointer */
+
+    /* Attributes of the store */
+    gmeta = meta->global;
+    strcpy (gmeta.acquisition_date, ESPA_STRING_META_FILL);
+    strcpy (gmeta.scene_center_time, ESPA_STRING_META_FILL);
+    strcpy (gmeta.level1_production_date, ESPA_STRING_META_FILL);
+    strcpy (gmeta.product_id, ESPA_STRING_META_FILL);
+    strcpy (gmeta.lpgs_metadata_file, ESPA_STRING_META_FILL);
+    gmeta.solar_zenith = ESPA_FLOAT_META_FILL;
+    gmeta.solar_azimuth = ESPA_FLOAT_META_FILL;
+    gmeta.earth_sun_dist = ESPA_FLOAT_META_FILL;
+    if (make_zarr_dir (zarr_dir) != SUCCESS ||
+        write_zarr_group_meta (zarr_dir, &gmeta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Time coordinate */
+    dates = malloc (job->nacq * sizeof (int32_t));
+    if (dates == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the dates");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (a = 0; a < job->nacq; a++)
+        dates[a] = job->acq[a].date;
+    status = write_zarr_vector (zarr_dir, STACK_TIME_DIM, "<i4", job->nacq,
+        sizeof (int32_t), dates, job->level);
+    free (dates);
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    snprintf (coord_dir, sizeof (coord_dir), "%s/%s", zarr_dir,
+        STACK_TIME_DIM);
+    fp = open_zarr_json (coord_dir, ".zattrs", json_file);
+    if (fp == NULL)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    fprintf (fp, "{\n  \"_ARRAY_DIMENSIONS\": [\"%s\"]", STACK_TIME_DIM);
+    write_zarr_text_attr (fp, "long_name", "acquisition date");
+    write_zarr_text_attr (fp, "description", "year * 1000 + day of year");
+    fprintf (fp, ",\n  \"product_id\": [");
+    for (a = 0; a < job->nacq; a++)
+    {
+        fprintf (fp, "%s\n    ", (a > 0) ? "," : "");
+        write_zarr_string (fp, job->acq[a].product_id);
+    }
+    fprintf (fp, "\n  ]\n}\n");
+    if (close_zarr_json (fp, json_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Spatial coordinates */
+    if (write_zarr_coord (zarr_dir, "y", true, &meta->global.proj_info,
+            bmeta, job->level) != SUCCESS ||
+        write_zarr_coord (zarr_dir, "x", false, &meta->global.proj_info,
+            bmeta, job->level) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Array of the band */
+    shape[0] = job->nacq;
+    shape[1] = job->nlines;
+    shape[2] = job->nsamps;
+    chunks[0] = job->nacq;
+    chunks[1] = job->block_lines;
+    chunks[2] = job->chunk_samps;
+    if (make_zarr_dir (array_dir) != SUCCESS ||
+        write_zarr_array_meta (array_dir, 3, shape, chunks,
+            get_zarr_dtype (bmeta->data_type), bmeta->fill_value,
+            job->level) != SUCCESS ||
+        write_zarr_band_attrs (array_dir, bmeta, STACK_TIME_DIM, "y", "x")
+            != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_stack_zarr
+
+PURPOSE: Writes the stack to a Zarr store, as an array of [time, y, x] named
+after the band with the coordinates of each dimension.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the store
+SUCCESS         Successfully wrote the store
+
+NOTES:
+  1. For a part of a stack split into parts, only the chunks of the part
+     are written, and the metadata of the store is left to the first part.
+     Every chunk is its own file, so the parts can be written concurrently
+     to the same store.
+******************************************************************************/
+static int write_stack_zarr
+(
+    Stack_job_t *job,        /* I/O: stack being written */
+    char *zarr_dir,          /* I: output Zarr store (directory) */
+    Espa_internal_meta_t *meta,  /* I: metadata of the first product */
+    int band                 /* I: index of the band in meta */
+)
+{
+    char FUNC_NAME[] = "write_stack_zarr";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char array_dir[STR_SIZE];    /* directory of the array of the band */
+    int r;                       /* looping variable for the runners */
+    int count;                   /* number of chars copied in snprintf */
+    int ncols;                   /* number of chunk columns */
+    int nthreads;                /* number of runners */
+    int status = SUCCESS;        /* return status */
+    size_t chunk_bytes;          /* number of bytes in a chunk */
+    Espa_band_meta_t *bmeta = &meta->band[band];  /* band of the stack */
+
+    if (!strcmp (bmeta->name, STACK_TIME_DIM) || !strcmp (bmeta->name, "y")
+        || !strcmp (bmeta->name, "x"))
+    {
+        sprintf (errmsg, "Band %s has the name of a coordinate of the store",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (array_dir, sizeof (array_dir), "%s/%s", zarr_dir,
+        bmeta->name);
+    if (count < 0 || count >= sizeof (array_dir))
+    {
+        sprintf (errmsg, "Overflow of array_dir string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (job->write_meta)
+        status = write_stack_zarr_meta (job, zarr_dir, meta, band,
+            array_dir);
+    else if (make_zarr_dir (zarr_dir) != SUCCESS ||
+        make_zarr_dir (array_dir) != SUCCESS)
+        status = ERROR;
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Allocate the fill chunk and the buffers of each runner */
+    job->array_dir = array_dir;
+    job->skip_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    chunk_bytes = (size_t) job->nacq * job->block_lines * job->chunk_samps *
+        job->size;
+    job->comp_bound = compressBound (chunk_bytes);
+    ncols = (job->nsamps + job->chunk_samps - 1) / job->chunk_samps;
+    nthreads = espa_task_nthreads ();
+    if (nthreads > ncols)
+        nthreads = ncols;
+
+    job->fill_chunk = malloc (chunk_bytes);
+    job->chunk_buf = calloc (nthreads, sizeof (uint8_t *));
+    job->comp_buf = calloc (nthreads, sizeof (uint8_t *));
+    if (job->fill_chunk == NULL || job->chunk_buf == NULL ||
+        job->comp_buf == NULL)
+        status = ERROR;
+    for (r = 0; r < nthreads && status == SUCCESS; r++)
+    {
+        job->chunk_buf[r] = malloc (chunk_bytes);
+        job->comp_buf[r] = malloc (job->comp_bound);
+        if (job->chunk_buf[r] == NULL || job->comp_buf[r] == NULL)
+            status = ERROR;
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating memory for the chunks of band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else
+    {
+        set_zarr_fill (bmeta, chunk_bytes / job->size, job->fill_chunk);
+        status = write_stack (job, nthreads, NULL);
+    }
+
+    for (r = 0; r < nthreads && job->chunk_buf != NULL; r++)
+    {
+        free (job->chunk_buf[r]);
+        free (job->comp_buf[r]);
+    }
+    free (job->chunk_buf);
+    free (job->comp_buf);
+    free (job->fill_chunk);
+    job->chunk_buf = NULL;
+    job->comp_buf = NULL;
+    job->fill_chunk = NULL;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  stack_band
+
+PURPOSE: Stacks a band of several acquisitions of the same grid into a time
+series, written as a cube or a Zarr store.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error stacking the band
+SUCCESS         Successfully stacked the band
+
+NOTES:
+  1. The acquisitions are stacked in date order, with the acquisitions of
+     the same date in the order of the input list.
+  2. The band metadata of the stack is that of the first product.
+  3. Only a Zarr stack can be split into parts, since the cube is a single
+     file.  Every part has to be given the same products and options.
+******************************************************************************/
+int stack_band
+(
+    int nproducts,           /* I: number of input products */
+    char **in_xml_file,      /* I: input XML file of each product */
+    char *band_name,         /* I: name of the band to be stacked */
+    char *output,            /* I: output XML file of the cube, whose
+                                   directory the cube is written to, or the
+                                   output Zarr store */
+    Stack_options_t *opts    /* I: options of the stack */
+)
+{
+    char FUNC_NAME[] = "stack_band";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int i;                       /* looping variable for the products */
+    int band;                    /* index of the band in the first product */
+    long nrows;                  /* number of rows of Zarr chunks */
+    int status = SUCCESS;        /* return status */
+    Stack_acq_t *acq = NULL;     /* acquisitions */
+    Stack_job_t job;             /* stack being written */
+    Espa_internal_meta_t meta;   /* metadata of the first product */
+
+    if (nproducts < 1)
+    {
+        sprintf (errmsg, "No input products to stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (opts->nparts > 1 && (opts->format != STACK_ZARR || opts->part < 0 ||
+        opts->part >= opts->nparts))
+    {
+        sprintf (errmsg, "Invalid part %d of %d parts of the stack; only a "
+            "Zarr stack can be split into parts", opts->part, opts->nparts);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The metadata of the stack starts as the metadata of the first
+       product */
+    if (validate_xml_file (in_xml_file[0]) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    init_metadata_struct (&meta);
+    if (parse_metadata (in_xml_file[0], &meta) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    band = find_band_metadata (&meta, NULL, band_name, NULL);
+    if (band < 0)
+    {
+        sprintf (errmsg, "Band %s isn't in %s", band_name, in_xml_file[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&meta);
+        return (ERROR);
+    }
+
+    /* Open the acquisitions and put them in date order */
+    acq = calloc (nproducts, sizeof (Stack_acq_t));
+    if (acq == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the acquisitions");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&meta);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nproducts && status == SUCCESS; i++)
+    {
+        status = open_acq (in_xml_file[i], i, band_name, &meta.band[band],
+            &acq[i]);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Reading input product %s", in_xml_file[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+    }
+
+    if (status == SUCCESS)
+    {
+        qsort (acq, nproducts, sizeof (Stack_acq_t), compare_dates);
+
+        memset (&job, 0, sizeof (job));
+        job.acq = acq;
+        job.nacq = nproducts;
+        job.nlines = meta.band[band].nlines;
+        job.nsamps = meta.band[band].nsamps;
+        job.size = get_data_type_size (meta.band[band].data_type);
+        job.first_line = 0;
+        job.end_line = job.nlines;
+        job.write_meta = true;
+        if (opts->format == STACK_CUBE)
+        {
+            job.block_lines = STACK_BLOCK_LINES;
+            status = write_stack_cube (&job, output, &meta, band);
+        }
+        else
+        {
+            job.block_lines = opts->chunk_lines;
+            job.chunk_samps = opts->chunk_samps;
+            job.level = opts->level;
+            if (opts->nparts > 1)
+            {
+                nrows = (job.nlines + job.block_lines - 1) / job.block_lines;
+                job.first_line = (int) (opts->part * nrows / opts->nparts) *
+                    job.block_lines;
+                job.end_line = (int) ((opts->part + 1) * nrows /
+                    opts->nparts) * job.block_lines;
+                if (job.end_line > job.nlines)
+                    job.end_line = job.nlines;
+                job.write_meta = (opts->part == 0);
+            }
+            status = write_stack_zarr (&job, output, &meta, band);
+        }
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Stacking band %s of %d acquisitions to %s",
+                band_name, nproducts, output);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+    }
+
+    /* Close the band files and free the memory */
+    for (i = 0; i < nproducts; i++)
+    {
+        if (acq[i].fp != NULL)
+            close_raw_binary (acq[i].fp);
+    }
+    free (acq);
+    free_metadata (&meta);
+
+    return (status);
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+FILE: espa_stack.h
+
+PURPOSE: Contains defines, structures and prototypes for stacking a band of
+several acquisitions of the same grid into a time series.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The products have to be on the same grid, and their bands of the given
+     name have to have the same size and data type.
+  2. The date of each acquisition is year * 1000 + DOY, taken from the date
+     band of the product (see generate_date_bands.h) if it has one, and from
+     its acquisition date otherwise.  The acquisitions are stacked in date
+     order.
+  3. The stack is written either as a cube whose pixels hold the values of
+     all the dates one after the other (a band interleaved by pixel raw
+     binary file, with the dates as its bands), or as a Zarr array of
+     [time, y, x] with the dates as the time coordinate.
+  4. A Zarr stack may be split into parts, each a range of whole rows of
+     chunks, which are written separately (e.g. by workers on several nodes
+     sharing the store, see espa_distribute) to the same store.  The first
+     part also writes the metadata of the store.
+*****************************************************************************/
+
+#ifndef ESPA_STACK_H
+#define ESPA_STACK_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+
+/* Defines */
+/* Number of lines read from every acquisition at a time for the cube */
+#define STACK_BLOCK_LINES 16
+
+/* Default number of lines and samples in a chunk of the Zarr array; each
+   chunk holds all the dates */
+#define STACK_CHUNK_LINES 64
+#define STACK_CHUNK_SAMPS 256
+
+/* Name of the band holding the date of each pixel */
+#define STACK_DATE_BAND "combined_date"
+
+/* Name of the time dimension and coordinate of the Zarr array */
+#define STACK_TIME_DIM "time"
+
+/* Type definitions */
+/* Output format of the stack */
+typedef enum
+{
+    STACK_CUBE,          /* pixel interleaved raw binary cube */
+    STACK_ZARR           /* Zarr array of [time, y, x] */
+} Stack_format_t;
+
+/* Options of the stack */
+typedef struct
+{
+    Stack_format_t format;       /* output format */
+    int chunk_lines;             /* number of lines in a Zarr chunk */
+    int chunk_samps;             /* number of samples in a Zarr chunk */
+    int level;                   /* zlib compression level of the Zarr
+                                    chunks */
+    int nparts;                  /* number of parts the rows of chunks are
+                                    split into; 0 or 1 for the whole
+                                    stack at once */
+    int part;                    /* part to be written, from 0 to
+                                    nparts - 1 */
+} Stack_options_t;
+
+/* Prototypes */
+int stack_band
+(
+    int nproducts,           /* I: number of input products */
+    char **in_xml_file,      /* I: input XML file of each product */
+    char *band_name,         /* I: name of the band to be stacked */
+    char *output,            /* I: output XML file of the cube, whose
+                                   directory the cube is written to, or the
+                                   output Zarr store */
+    Stack_options_t *opts    /* I: options of the stack */
+);
+
+#endif
@@ -0,0 +1,744 @@
+/*****************************************************************************
+FILE: lpgs_bundle.c
+
+PURPOSE: Contains functions for reading the members of an LPGS product bundle
+(.tar.gz) directly from the compressed stream, and for opening the GeoTIFF
+members from memory, so the bundle doesn't have to be extracted to disk.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The archive is read with zlib, which also reads an uncompressed .tar
+     file transparently.  The stream is only read forward, so the members are
+     visited in the order they were archived.
+  2. ustar, GNU long name ('L'), and pax extended header ('x') entries are
+     supported.  Entries other than regular files are skipped.
+*****************************************************************************/
+
+#include <stdint.h>
+#include "lpgs_bundle.h"
+
+/* Offsets and sizes of the tar header fields */
+#define TAR_NAME_OFFSET 0
+#define TAR_NAME_SIZE 100
+#define TAR_SIZE_OFFSET 124
+#define TAR_SIZE_SIZE 12
+#define TAR_CHKSUM_OFFSET 148
+#define TAR_CHKSUM_SIZE 8
+#define TAR_TYPEFLAG_OFFSET 156
+#define TAR_MAGIC_OFFSET 257
+#define TAR_PREFIX_OFFSET 345
+#define TAR_PREFIX_SIZE 155
+
+/* Largest extended header (long name or pax records) which is parsed */
+#define TAR_MAX_EXTENDED_SIZE (64 * 1024)
+
+/* Contents of a TIFF file held in memory */
+typedef struct
+{
+    uint8 *buf;               /* contents of the TIFF file */
+    toff_t size;              /* size of the TIFF file (bytes) */
+    toff_t offset;            /* current offset in the TIFF file */
+} Lpgs_memory_tiff_t;
+
+
+/******************************************************************************
+MODULE:  get_tar_number
+
+PURPOSE: Parses a numeric field of a tar header, which is either octal ASCII
+or, for large values, base-256 with the high bit of the first byte set.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Invalid numeric field
+SUCCESS         Successful completion
+
+NOTES:
+******************************************************************************/
+static int get_tar_number
+(
+    const unsigned char *field, /* I: numeric field of the tar header */
+    int field_size,            /* I: size of the field (bytes) */
+    off_t *value               /* O: value of the field */
+)
+{
+    int i;                    /* looping variable for the field bytes */
+    off_t num = 0;            /* value being parsed */
+
+    /* Base-256 (GNU extension for sizes of 8GB and larger) */
+    if (field[0] & 0x80)
+    {
+        num = field[0] & 0x3f;
+        for (i = 1; i < field_size; i++)
+            num = (num << 8) | field[i];
+        *value = num;
+        return (SUCCESS);
+    }
+
+    /* Octal ASCII, optionally surrounded by spaces and NUL terminated */
+    for (i = 0; i < field_size && field[i] == ' '; i++)
+        ;
+    for ( ; i < field_size && field[i] >= '0' && field[i] <= '7'; i++)
+        num = (num << 3) + (field[i] - '0');
+    if (i < field_size && field[i] != ' ' && field[i] != '\0')
+        return (ERROR);
+
+    *value = num;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_bundle_bytes
+
+PURPOSE: Reads the specified number of bytes from the bundle stream.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading, or the stream ended early
+SUCCESS         Successful completion
+
+NOTES:
+  1. gzread takes an unsigned int count, so large reads are done in pieces.
+******************************************************************************/
+static int read_bundle_bytes
+(
+    Lpgs_bundle_t *bundle,     /* I: reader for the bundle */
+    void *buf,                 /* O: buffer for the bytes read */
+    size_t nbytes              /* I: number of bytes to be read */
+)
+{
+    uint8 *ptr = buf;         /* current position in the buffer */
+    unsigned int nread;       /* number of bytes in the current read */
+    int count;                /* number of bytes read by gzread */
+
+    while (nbytes > 0)
+    {
+        nread = nbytes > (1U << 30) ? (1U << 30) : (unsigned int) nbytes;
+        count = gzread (bundle->gz, ptr, nread);
+        if (count <= 0)
+            return (ERROR);
+        ptr += count;
+        nbytes -= count;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  skip_bundle_bytes
+
+PURPOSE: Skips forward the specified number of bytes in the bundle stream.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error skipping, or the stream ended early
+SUCCESS         Successful completion
+
+NOTES:
+  1. The skipped bytes still have to be decompressed, but aren't copied.
+******************************************************************************/
+static int skip_bundle_bytes
+(
+    Lpgs_bundle_t *bundle,     /* I: reader for the bundle */
+    off_t nbytes               /* I: number of bytes to be skipped */
+)
+{
+    z_off_t start;            /* uncompressed offset before the skip */
+    int zerr;                 /* zlib error status */
+
+    if (nbytes <= 0)
+        return (SUCCESS);
+
+    start = gztell (bundle->gz);
+    if (gzseek (bundle->gz, (z_off_t) nbytes, SEEK_CUR) != start + nbytes)
+        return (ERROR);
+
+    /* Seeking past the end of the stream isn't an error until it's read */
+    gzerror (bundle->gz, &zerr);
+    if (zerr != Z_OK)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_tar_extended
+
+PURPOSE: Reads the data of an extended tar entry (GNU long name or pax
+records) as a NUL-terminated string.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the entry, or it's too large
+SUCCESS         Successful completion
+
+NOTES:
+  1. The caller is responsible for freeing the returned data.
+******************************************************************************/
+static int read_tar_extended
+(
+    Lpgs_bundle_t *bundle,     /* I: reader for the bundle */
+    off_t size,                /* I: size of the entry data (bytes) */
+    char **data                /* O: data of the entry */
+)
+{
+    char FUNC_NAME[] = "read_tar_extended";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    off_t pad;                /* padding after the data */
+
+    if (size > TAR_MAX_EXTENDED_SIZE)
+    {
+        sprintf (errmsg, "Extended tar header of %ld bytes is too large in "
+            "%s", (long) size, bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *data = malloc (size + 1);
+    if (*data == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for an extended tar header");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    pad = (LPGS_TAR_BLOCK_SIZE - size % LPGS_TAR_BLOCK_SIZE) %
+        LPGS_TAR_BLOCK_SIZE;
+    if (read_bundle_bytes (bundle, *data, size) != SUCCESS ||
+        skip_bundle_bytes (bundle, pad) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading an extended tar header from %s",
+            bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (*data);
+        *data = NULL;
+        return (ERROR);
+    }
+    (*data)[size] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_pax_records
+
+PURPOSE: Parses the path and size from the records of a pax extended header.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Each record is "<length> <keyword>=<value>\n".  Records other than path
+     and size are ignored.
+******************************************************************************/
+static void parse_pax_records
+(
+    char *pax,                 /* I: records of the pax extended header */
+    off_t pax_size,            /* I: size of the records (bytes) */
+    char *path,                /* O: path from the records; unchanged if none */
+    off_t *size                /* O: size from the records; unchanged if
+                                     none */
+)
+{
+    char *rec = pax;          /* current record */
+    char *key = NULL;         /* keyword of the current record */
+    char *value = NULL;       /* value of the current record */
+    char *end = NULL;         /* end of the current record */
+    long len;                 /* length of the current record */
+
+    while (rec < pax + pax_size)
+    {
+        len = strtol (rec, &key, 10);
+        if (len <= 0 || key == rec || *key != ' ' || rec + len > pax + pax_size)
+            break;
+        end = rec + len - 1;
+        key++;
+        value = strchr (key, '=');
+        if (value != NULL && value < end && *end == '\n')
+        {
+            *value++ = '\0';
+            *end = '\0';
+            if (!strcmp (key, "path"))
+                snprintf (path, STR_SIZE, "%s", value);
+            else if (!strcmp (key, "size"))
+                *size = (off_t) strtoll (value, NULL, 10);
+        }
+        rec += len;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  open_lpgs_bundle
+
+PURPOSE: Opens an LPGS product bundle for reading its members.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening the bundle
+SUCCESS         Successful completion
+
+NOTES:
+  1. next_lpgs_bundle_member needs to be called to get to the first member.
+******************************************************************************/
+int open_lpgs_bundle
+(
+    char *bundle_file,         /* I: name of the bundle (.tar.gz) file */
+    Lpgs_bundle_t *bundle      /* O: reader for the bundle */
+)
+{
+    char FUNC_NAME[] = "open_lpgs_bundle";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int count;                /* number of chars copied in snprintf */
+
+    memset (bundle, 0, sizeof (Lpgs_bundle_t));
+    count = snprintf (bundle->bundle_file, sizeof (bundle->bundle_file), "%s",
+        bundle_file);
+    if (count < 0 || count >= sizeof (bundle->bundle_file))
+    {
+        sprintf (errmsg, "Overflow of bundle->bundle_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    bundle->gz = gzopen (bundle_file, "rb");
+    if (bundle->gz == NULL)
+    {
+        sprintf (errmsg, "Opening the LPGS bundle: %s", bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    gzbuffer (bundle->gz, LPGS_BUNDLE_BUFFER_SIZE);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  next_lpgs_bundle_member
+
+PURPOSE: Advances to the next regular file in the bundle, skipping whatever
+is left of the current member.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the tar headers
+SUCCESS         Successful completion
+
+NOTES:
+  1. found is false once the end of the archive has been reached.
+******************************************************************************/
+int next_lpgs_bundle_member
+(
+    Lpgs_bundle_t *bundle,     /* I/O: reader for the bundle */
+    bool *found                /* O: was another member found? false at the
+                                     end of the archive */
+)
+{
+    char FUNC_NAME[] = "next_lpgs_bundle_member";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char long_name[STR_SIZE] = "";  /* name from an extended header */
+    char *ext = NULL;         /* data of an extended header */
+    unsigned char hdr[LPGS_TAR_BLOCK_SIZE];  /* tar header block */
+    char typeflag;            /* type of the tar entry */
+    int i;                    /* looping variable for the header bytes */
+    int count;                /* number of bytes read by gzread */
+    int zerr;                 /* zlib error status */
+    off_t size;               /* size of the tar entry (bytes) */
+    off_t ext_size = -1;      /* size from a pax extended header */
+    off_t chksum;             /* checksum stored in the header */
+    off_t sum;                /* checksum computed from the header */
+
+    *found = false;
+
+    /* Skip the rest of the current member */
+    if (skip_bundle_bytes (bundle, bundle->member_remaining +
+        bundle->member_pad) != SUCCESS)
+    {
+        sprintf (errmsg, "Skipping member %s of %s", bundle->member_name,
+            bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    bundle->member_name[0] = '\0';
+    bundle->member_size = 0;
+    bundle->member_remaining = 0;
+    bundle->member_pad = 0;
+
+    while (1)
+    {
+        /* Read the next header; the archive should end with zero blocks,
+           but a stream ending on a block boundary is accepted */
+        count = gzread (bundle->gz, hdr, LPGS_TAR_BLOCK_SIZE);
+        gzerror (bundle->gz, &zerr);
+        if (count == 0 && zerr == Z_OK)
+            return (SUCCESS);
+        if (count != LPGS_TAR_BLOCK_SIZE)
+        {
+            sprintf (errmsg, "Truncated tar header in %s",
+                bundle->bundle_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Compute the checksum, with the checksum field as spaces.  A zero
+           block marks the end of the archive. */
+        sum = 0;
+        for (i = 0; i < LPGS_TAR_BLOCK_SIZE; i++)
+            sum += hdr[i];
+        if (sum == 0)
+            return (SUCCESS);
+        for (i = 0; i < TAR_CHKSUM_SIZE; i++)
+            sum += ' ' - hdr[TAR_CHKSUM_OFFSET + i];
+
+        if (get_tar_number (&hdr[TAR_CHKSUM_OFFSET], TAR_CHKSUM_SIZE,
+            &chksum) != SUCCESS || chksum != sum ||
+            get_tar_number (&hdr[TAR_SIZE_OFFSET], TAR_SIZE_SIZE, &size) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Invalid tar header in %s; is it a .tar.gz "
+                "file?", bundle->bundle_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (ext_size >= 0)
+            size = ext_size;
+
+        typeflag = hdr[TAR_TYPEFLAG_OFFSET];
+        if (typeflag == 'L' || typeflag == 'x')
+        {
+            /* Extended headers apply to the next entry */
+            if (read_tar_extended (bundle, size, &ext) != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+            if (typeflag == 'L')
+                snprintf (long_name, sizeof (long_name), "%s", ext);
+            else
+                parse_pax_records (ext, size, long_name, &ext_size);
+            free (ext);
+            continue;
+        }
+
+        if (typeflag != '0' && typeflag != '\0' && typeflag != '7')
+        {
+            /* Not a regular file, so skip its data */
+            long_name[0] = '\0';
+            ext_size = -1;
+            if (skip_bundle_bytes (bundle, size + (LPGS_TAR_BLOCK_SIZE -
+                size % LPGS_TAR_BLOCK_SIZE) % LPGS_TAR_BLOCK_SIZE) != SUCCESS)
+            {
+                sprintf (errmsg, "Skipping a tar entry in %s",
+                    bundle->bundle_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            continue;
+        }
+
+        /* Determine the member name, using the ustar prefix if there is one */
+        if (long_name[0] != '\0')
+            snprintf (bundle->member_name, sizeof (bundle->member_name), "%s",
+                long_name);
+        else if (!memcmp (&hdr[TAR_MAGIC_OFFSET], "ustar", 5) &&
+            hdr[TAR_PREFIX_OFFSET] != '\0')
+            snprintf (bundle->member_name, sizeof (bundle->member_name),
+                "%.*s/%.*s", TAR_PREFIX_SIZE, &hdr[TAR_PREFIX_OFFSET],
+                TAR_NAME_SIZE, &hdr[TAR_NAME_OFFSET]);
+        else
+            snprintf (bundle->member_name, sizeof (bundle->member_name),
+                "%.*s", TAR_NAME_SIZE, &hdr[TAR_NAME_OFFSET]);
+
+        bundle->member_size = size;
+        bundle->member_remaining = size;
+        bundle->member_pad = (LPGS_TAR_BLOCK_SIZE - size %
+            LPGS_TAR_BLOCK_SIZE) % LPGS_TAR_BLOCK_SIZE;
+        *found = true;
+        return (SUCCESS);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  read_lpgs_bundle_member
+
+PURPOSE: Reads the contents of the current member of the bundle into memory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the member
+SUCCESS         Successful completion
+
+NOTES:
+  1. The member can only be read once, right after next_lpgs_bundle_member.
+******************************************************************************/
+int read_lpgs_bundle_member
+(
+    Lpgs_bundle_t *bundle,     /* I/O: reader for the bundle */
+    uint8 **member_buf,        /* O: contents of the current member; the
+                                     caller is responsible for freeing it */
+    size_t *member_size        /* O: size of the current member (bytes) */
+)
+{
+    char FUNC_NAME[] = "read_lpgs_bundle_member";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    *member_buf = NULL;
+    *member_size = 0;
+    if (bundle->member_remaining != bundle->member_size)
+    {
+        sprintf (errmsg, "Member %s of %s has already been read",
+            bundle->member_name, bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Allocate one extra byte so text members can be NUL terminated */
+    *member_buf = malloc (bundle->member_size + 1);
+    if (*member_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating %ld bytes for member %s of %s",
+            (long) bundle->member_size, bundle->member_name,
+            bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (read_bundle_bytes (bundle, *member_buf, bundle->member_size) !=
+        SUCCESS)
+    {
+        sprintf (errmsg, "Reading member %s of %s", bundle->member_name,
+            bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (*member_buf);
+        *member_buf = NULL;
+        return (ERROR);
+    }
+    (*member_buf)[bundle->member_size] = '\0';
+
+    *member_size = bundle->member_size;
+    bundle->member_remaining = 0;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  rewind_lpgs_bundle
+
+PURPOSE: Rewinds the bundle to the start of the archive.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error rewinding the bundle
+SUCCESS         Successful completion
+
+NOTES:
+  1. The bundle is decompressed again from the start.
+******************************************************************************/
+int rewind_lpgs_bundle
+(
+    Lpgs_bundle_t *bundle      /* I/O: reader for the bundle */
+)
+{
+    char FUNC_NAME[] = "rewind_lpgs_bundle";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+
+    if (gzrewind (bundle->gz) != 0)
+    {
+        sprintf (errmsg, "Rewinding the LPGS bundle: %s", bundle->bundle_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    bundle->member_name[0] = '\0';
+    bundle->member_size = 0;
+    bundle->member_remaining = 0;
+    bundle->member_pad = 0;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_lpgs_bundle
+
+PURPOSE: Closes the bundle.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void close_lpgs_bundle
+(
+    Lpgs_bundle_t *bundle      /* I/O: reader for the bundle */
+)
+{
+    if (bundle->gz != NULL)
+        gzclose (bundle->gz);
+    bundle->gz = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  get_lpgs_member_basename
+
+PURPOSE: Returns the filename of the member without its directories, which
+is how the files are named in the MTL file.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+basename        Pointer to the filename within member_name
+
+NOTES:
+******************************************************************************/
+const char *get_lpgs_member_basename
+(
+    const char *member_name    /* I: name of the member in the archive */
+)
+{
+    const char *cptr = strrchr (member_name, '/');
+
+    return (cptr == NULL ? member_name : cptr + 1);
+}
+
+
+/* libtiff client procedures for a TIFF file held in memory.  The file is
+   read-only and is "mapped" so libtiff reads the strips in place. */
+static tmsize_t read_memory_tiff (thandle_t fd, void *buf, tmsize_t size)
+{
+    Lpgs_memory_tiff_t *mem = (Lpgs_memory_tiff_t *) fd;
+
+    if (mem->offset >= mem->size)
+        return (0);
+    if ((toff_t) size > mem->size - mem->offset)
+        size = mem->size - mem->offset;
+    memcpy (buf, &mem->buf[mem->offset], size);
+    mem->offset += size;
+    return (size);
+}
+
+static tmsize_t write_memory_tiff (thandle_t fd, void *buf, tmsize_t size)
+{
+    return (0);
+}
+
+static toff_t seek_memory_tiff (thandle_t fd, toff_t off, int whence)
+{
+    Lpgs_memory_tiff_t *mem = (Lpgs_memory_tiff_t *) fd;
+
+    if (whence == SEEK_CUR)
+        off += mem->offset;
+    else if (whence == SEEK_END)
+        off += mem->size;
+    mem->offset = off;
+    return (off);
+}
+
+static int close_memory_tiff (thandle_t fd)
+{
+    Lpgs_memory_tiff_t *mem = (Lpgs_memory_tiff_t *) fd;
+
+    free (mem->buf);
+    free (mem);
+    return (0);
+}
+
+static toff_t size_memory_tiff (thandle_t fd)
+{
+    return (((Lpgs_memory_tiff_t *) fd)->size);
+}
+
+static int map_memory_tiff (thandle_t fd, void **base, toff_t *size)
+{
+    Lpgs_memory_tiff_t *mem = (Lpgs_memory_tiff_t *) fd;
+
+    *base = mem->buf;
+    *size = mem->size;
+    return (1);
+}
+
+static void unmap_memory_tiff (thandle_t fd, void *base, toff_t size)
+{
+}
+
+
+/******************************************************************************
+MODULE:  open_lpgs_memory_tiff
+
+PURPOSE: Opens a GeoTIFF file held in memory for reading.
+
+RETURN VALUE:
+Type = TIFF *
+Value           Description
+-----           -----------
+NULL            Error opening the TIFF; the buffer has been freed
+non-NULL        Open TIFF, to be closed with XTIFFClose
+
+NOTES:
+  1. The buffer is owned by the TIFF once this is called, and is freed when
+     the TIFF is closed.
+******************************************************************************/
+TIFF *open_lpgs_memory_tiff
+(
+    char *tiff_name,           /* I: name of the TIFF, for messages */
+    uint8 *tiff_buf,           /* I: contents of the TIFF file; ownership is
+                                     taken and the buffer is freed when the
+                                     TIFF is closed */
+    size_t tiff_size           /* I: size of the TIFF file (bytes) */
+)
+{
+    char FUNC_NAME[] = "open_lpgs_memory_tiff";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Lpgs_memory_tiff_t *mem = NULL;  /* TIFF file in memory */
+    TIFF *tif = NULL;         /* open TIFF */
+
+    mem = malloc (sizeof (Lpgs_memory_tiff_t));
+    if (mem == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the TIFF %s", tiff_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (tiff_buf);
+        return (NULL);
+    }
+    mem->buf = tiff_buf;
+    mem->size = tiff_size;
+    mem->offset = 0;
+
+    tif = XTIFFClientOpen (tiff_name, "r", (thandle_t) mem, read_memory_tiff,
+        write_memory_tiff, seek_memory_tiff, close_memory_tiff,
+        size_memory_tiff, map_memory_tiff, unmap_memory_tiff);
+    if (tif == NULL)
+    {
+        sprintf (errmsg, "Opening the TIFF %s from memory", tiff_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_memory_tiff ((thandle_t) mem);
+        return (NULL);
+    }
+
+    return (tif);
+}
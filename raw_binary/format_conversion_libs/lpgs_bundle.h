@@ -0,0 +1,94 @@
+/*****************************************************************************
+FILE: lpgs_bundle.h
+
+PURPOSE: Contains defines, structures, and prototypes for reading the members
+of an LPGS product bundle (.tar.gz) directly from the compressed stream.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef LPGS_BUNDLE_H
+#define LPGS_BUNDLE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <zlib.h>
+#include "xtiffio.h"
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Size of the tar header and data blocks */
+#define LPGS_TAR_BLOCK_SIZE 512
+
+/* Size of the buffer used by zlib for reading the compressed bundle */
+#define LPGS_BUNDLE_BUFFER_SIZE (1024 * 1024)
+
+/* Type definitions */
+/* Reader for the members of a bundle */
+typedef struct
+{
+    char bundle_file[STR_SIZE];  /* name of the bundle file */
+    gzFile gz;                /* compressed stream of the bundle */
+    char member_name[STR_SIZE];  /* name of the current member, as stored in
+                                    the archive */
+    off_t member_size;        /* size of the current member (bytes) */
+    off_t member_remaining;   /* bytes of the current member not yet read */
+    off_t member_pad;         /* padding after the current member to the end
+                                 of its last block */
+} Lpgs_bundle_t;
+
+/* Prototypes */
+int open_lpgs_bundle
+(
+    char *bundle_file,         /* I: name of the bundle (.tar.gz) file */
+    Lpgs_bundle_t *bundle      /* O: reader for the bundle */
+);
+
+int next_lpgs_bundle_member
+(
+    Lpgs_bundle_t *bundle,     /* I/O: reader for the bundle */
+    bool *found                /* O: was another member found? false at the
+                                     end of the archive */
+);
+
+int read_lpgs_bundle_member
+(
+    Lpgs_bundle_t *bundle,     /* I/O: reader for the bundle */
+    uint8 **member_buf,        /* O: contents of the current member; the
+                                     caller is responsible for freeing it */
+    size_t *member_size        /* O: size of the current member (bytes) */
+);
+
+int rewind_lpgs_bundle
+(
+    Lpgs_bundle_t *bundle      /* I/O: reader for the bundle */
+);
+
+void close_lpgs_bundle
+(
+    Lpgs_bundle_t *bundle      /* I/O: reader for the bundle */
+);
+
+const char *get_lpgs_member_basename
+(
+    const char *member_name    /* I: name of the member in the archive */
+);
+
+TIFF *open_lpgs_memory_tiff
+(
+    char *tiff_name,           /* I: name of the TIFF, for messages */
+    uint8 *tiff_buf,           /* I: contents of the TIFF file; ownership is
+                                     taken and the buffer is freed when the
+                                     TIFF is closed */
+    size_t tiff_size           /* I: size of the TIFF file (bytes) */
+);
+
+#endif
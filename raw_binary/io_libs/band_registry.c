@@ -0,0 +1,315 @@
+/*****************************************************************************
+FILE: band_registry.c
+
+PURPOSE: Contains functions for registering the bands created by stages
+running concurrently on one scene, and for adding them to the metadata of the
+scene in a deterministic order.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See band_registry.h for how the registry is used.
+  2. The count of reserved slots is only ever advanced with a compare and
+     swap, so a reservation which doesn't fit doesn't use up the slots left
+     for smaller ones.  The state of a slot is set with release semantics
+     once its band is in place, and read with acquire semantics by the merge.
+*****************************************************************************/
+
+#include "band_registry.h"
+
+/******************************************************************************
+MODULE:  init_band_registry
+
+PURPOSE:  Allocates a band registry of the specified number of slots.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the registry
+SUCCESS         Successfully allocated the registry
+
+NOTES:
+  1. The band array isn't zeroed, so only the pages of the slots which are
+     used are touched.
+******************************************************************************/
+int init_band_registry
+(
+    Espa_band_registry_t *registry,  /* O: band registry */
+    int nslots                    /* I: number of bands the registry holds */
+)
+{
+    char FUNC_NAME[] = "init_band_registry";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+
+    if (nslots < 1)
+        nslots = 1;
+    registry->nslots = nslots;
+    registry->nreserved = 0;
+    registry->band = malloc (nslots * sizeof (Espa_band_meta_t));
+    registry->order = calloc (nslots, sizeof (int));
+    registry->state = calloc (nslots, sizeof (int));
+    registry->blocks = calloc (nslots, sizeof (Espa_arena_block_t *));
+    if (registry->band == NULL || registry->order == NULL ||
+        registry->state == NULL || registry->blocks == NULL)
+    {
+        sprintf (errmsg, "Allocating a band registry of %d bands", nslots);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_band_registry (registry);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  reserve_band_slots
+
+PURPOSE:  Reserves a run of slots of the band registry, for the bands of a
+stage.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              There aren't enough free slots left
+other           First of the reserved slots
+
+NOTES:
+  1. It's safe to call this from several threads at once; no lock is
+     taken.
+  2. No message is written when the slots don't fit (see note 3 of
+     band_registry.h).
+******************************************************************************/
+int reserve_band_slots
+(
+    Espa_band_registry_t *registry,  /* I/O: band registry */
+    int nbands                    /* I: number of slots to reserve */
+)
+{
+    int nreserved;                /* number of slots handed out before */
+
+    nreserved = __atomic_load_n (&registry->nreserved, __ATOMIC_RELAXED);
+    do
+    {
+        if (nbands < 1 || nbands > registry->nslots - nreserved)
+            return (-1);
+    } while (!__atomic_compare_exchange_n (&registry->nreserved, &nreserved,
+        nreserved + nbands, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return (nreserved);
+}
+
+
+/******************************************************************************
+MODULE:  commit_band_slots
+
+PURPOSE:  Moves the bands of a stage into the slots reserved for them, and
+commits them with their order key.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The number of bands in src_meta must be the number of slots reserved.
+  2. As with merge_band_metadata, the band pointers and the arena blocks of
+     src_meta are moved, not copied, and free_metadata may still be called
+     on src_meta.  Only the slots of the reservation are written, so this
+     may be called from several threads at once.
+******************************************************************************/
+void commit_band_slots
+(
+    Espa_band_registry_t *registry,  /* I/O: band registry */
+    int first_slot,               /* I: first slot from reserve_band_slots */
+    int order,                    /* I: order key of the bands */
+    Espa_internal_meta_t *src_meta   /* I/O: metadata of the bands to be
+                                        committed; bands are removed upon
+                                        return */
+)
+{
+    int i;                        /* looping variable */
+
+    memcpy (&registry->band[first_slot], src_meta->band,
+        src_meta->nbands * sizeof (Espa_band_meta_t));
+    if (src_meta->arena != NULL)
+    {
+        registry->blocks[first_slot] = src_meta->arena->blocks;
+        src_meta->arena->blocks = NULL;
+    }
+
+    for (i = first_slot; i < first_slot + src_meta->nbands; i++)
+    {
+        registry->order[i] = order;
+        __atomic_store_n (&registry->state[i], BAND_SLOT_COMMITTED,
+            __ATOMIC_RELEASE);
+    }
+
+    free (src_meta->band);
+    src_meta->band = NULL;
+    src_meta->nbands = 0;
+    free_band_index (src_meta);
+}
+
+
+/******************************************************************************
+MODULE:  merge_registry_bands
+
+PURPOSE:  Moves the committed bands of an order key to the end of the bands
+in the metadata structure, in the order of their slots.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error merging the bands
+SUCCESS         Successfully merged the bands, or there were none
+
+NOTES:
+  1. This must not be called while bands are being committed, nor while
+     another thread reads the metadata.
+  2. If the bands can't be added, they stay in the registry and are freed
+     with it.
+******************************************************************************/
+int merge_registry_bands
+(
+    Espa_band_registry_t *registry,  /* I/O: band registry */
+    int order,                    /* I: order key of the bands to merge */
+    Espa_internal_meta_t *internal_meta  /* I/O: metadata the bands are
+                                        added to */
+)
+{
+    char FUNC_NAME[] = "merge_registry_bands";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for the slots */
+    int nbands = 0;               /* number of bands to merge */
+    int first_slot = -1;          /* first slot of the bands */
+    int nreserved;                /* number of slots handed out */
+    int status;                   /* return status */
+    Espa_arena_block_t *blocks = NULL;  /* arena blocks of the bands */
+    Espa_arena_block_t *last = NULL;    /* last of the arena blocks */
+    Espa_internal_meta_t src_meta;  /* bands to be merged */
+
+    nreserved = __atomic_load_n (&registry->nreserved, __ATOMIC_ACQUIRE);
+    for (i = 0; i < nreserved; i++)
+    {
+        if (__atomic_load_n (&registry->state[i], __ATOMIC_ACQUIRE) ==
+            BAND_SLOT_COMMITTED && registry->order[i] == order)
+            nbands++;
+    }
+    if (nbands == 0)
+        return (SUCCESS);
+
+    init_metadata_struct (&src_meta);
+    src_meta.band = malloc (nbands * sizeof (Espa_band_meta_t));
+    src_meta.arena = calloc (1, sizeof (Espa_meta_arena_t));
+    if (src_meta.band == NULL || src_meta.arena == NULL)
+    {
+        sprintf (errmsg, "Allocating the %d bands to be merged", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&src_meta);
+        return (ERROR);
+    }
+
+    /* Gather the bands and chain the arena blocks of their reservations */
+    for (i = 0; i < nreserved; i++)
+    {
+        if (registry->state[i] != BAND_SLOT_COMMITTED ||
+            registry->order[i] != order)
+            continue;
+        if (first_slot < 0)
+            first_slot = i;
+        src_meta.band[src_meta.nbands++] = registry->band[i];
+
+        if (registry->blocks[i] != NULL)
+        {
+            if (last == NULL)
+                blocks = registry->blocks[i];
+            else
+                last->next = registry->blocks[i];
+            for (last = registry->blocks[i]; last->next != NULL;
+                 last = last->next)
+                ;
+            registry->blocks[i] = NULL;
+        }
+    }
+    src_meta.arena->blocks = blocks;
+
+    status = merge_band_metadata (internal_meta, &src_meta);
+    if (src_meta.nbands == 0)
+    {   /* The bands were moved, even if they couldn't be indexed */
+        for (i = 0; i < nreserved; i++)
+        {
+            if (registry->state[i] == BAND_SLOT_COMMITTED &&
+                registry->order[i] == order)
+                registry->state[i] = BAND_SLOT_MERGED;
+        }
+    }
+    else
+    {   /* Give the blocks back to the registry, which still has the bands */
+        registry->blocks[first_slot] = src_meta.arena->blocks;
+        src_meta.arena->blocks = NULL;
+        src_meta.nbands = 0;
+    }
+    free_metadata (&src_meta);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Merging the bands of order key %d", order);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_band_registry
+
+PURPOSE:  Frees the band registry, along with the bands which were committed
+but not merged.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+void free_band_registry
+(
+    Espa_band_registry_t *registry   /* I: band registry */
+)
+{
+    int i;                        /* looping variable for the slots */
+    Espa_arena_block_t *block = NULL;  /* current arena block */
+    Espa_arena_block_t *next = NULL;   /* next arena block */
+
+    for (i = 0; registry->state != NULL && i < registry->nreserved; i++)
+    {
+        if (registry->state[i] == BAND_SLOT_COMMITTED &&
+            registry->band[i].arena == NULL)
+        {
+            free (registry->band[i].bitmap_description);
+            free (registry->band[i].class_values);
+            free (registry->band[i].percent_cover);
+        }
+
+        for (block = registry->blocks[i]; block != NULL; block = next)
+        {
+            next = block->next;
+            free (block);
+        }
+    }
+
+    free (registry->band);
+    free (registry->order);
+    free (registry->state);
+    free (registry->blocks);
+    registry->band = NULL;
+    registry->order = NULL;
+    registry->state = NULL;
+    registry->blocks = NULL;
+    registry->nslots = 0;
+    registry->nreserved = 0;
+}
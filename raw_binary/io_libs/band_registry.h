@@ -0,0 +1,100 @@
+/*****************************************************************************
+FILE: band_registry.h
+
+PURPOSE: Contains defines, structures and prototypes for the band registry,
+which lets stages running concurrently on one scene register the bands they
+created without a lock, to be added to the metadata of the scene later in a
+deterministic order.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The registry is a band array sized when it's created.  A stage reserves
+     a run of slots for its bands with an atomic update of the count of
+     reserved slots, moves its bands into them, and commits them along with
+     its order key.  Stages never wait on each other, and the metadata of
+     the scene isn't changed while other stages may be reading it.
+  2. Once the stages are done, merge_registry_bands adds the committed bands
+     of an order key to the metadata, in the order of their slots.  Merging
+     the order keys one after the other gives the same band order as adding
+     the bands of each stage in turn, however the stages were scheduled,
+     provided each order key is used for a single reservation.
+  3. A reservation which doesn't fit in the registry fails without a message,
+     leaving the bands to the caller, which can add them to the metadata
+     itself.
+*****************************************************************************/
+
+#ifndef BAND_REGISTRY_H
+#define BAND_REGISTRY_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Type definitions */
+/* States of the slots of a band registry */
+typedef enum
+{
+    BAND_SLOT_RESERVED,           /* reserved, or not yet handed out */
+    BAND_SLOT_COMMITTED,          /* holds a band to be merged */
+    BAND_SLOT_MERGED              /* band moved to the metadata */
+} Band_slot_state_t;
+
+/* Band registry */
+typedef struct
+{
+    int nslots;                   /* number of slots in the band array */
+    int nreserved;                /* number of slots handed out; updated
+                                     atomically */
+    Espa_band_meta_t *band;       /* bands of the slots */
+    int *order;                   /* order key of the band in each slot */
+    int *state;                   /* state of each slot (Band_slot_state_t);
+                                     set atomically */
+    Espa_arena_block_t **blocks;  /* arena blocks of the bands committed
+                                     with each slot, held by the first slot
+                                     of the reservation; NULL for the
+                                     others */
+} Espa_band_registry_t;
+
+/* Prototypes */
+int init_band_registry
+(
+    Espa_band_registry_t *registry,  /* O: band registry */
+    int nslots                    /* I: number of bands the registry holds */
+);
+
+int reserve_band_slots
+(
+    Espa_band_registry_t *registry,  /* I/O: band registry */
+    int nbands                    /* I: number of slots to reserve */
+);
+
+void commit_band_slots
+(
+    Espa_band_registry_t *registry,  /* I/O: band registry */
+    int first_slot,               /* I: first slot from reserve_band_slots */
+    int order,                    /* I: order key of the bands */
+    Espa_internal_meta_t *src_meta   /* I/O: metadata of the bands to be
+                                        committed; bands are removed upon
+                                        return */
+);
+
+int merge_registry_bands
+(
+    Espa_band_registry_t *registry,  /* I/O: band registry */
+    int order,                    /* I: order key of the bands to merge */
+    Espa_internal_meta_t *internal_meta  /* I/O: metadata the bands are
+                                        added to */
+);
+
+void free_band_registry
+(
+    Espa_band_registry_t *registry   /* I: band registry */
+);
+
+#endif
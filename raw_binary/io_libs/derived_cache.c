@@ -0,0 +1,699 @@
+/*****************************************************************************
+FILE: derived_cache.c
+
+PURPOSE: Stores the bands written by a stage in a cache, keyed by the stage
+and the digests of its inputs, and restores them for a later run on the same
+inputs.  Reprocessing a scene then only copies the derived bands which are a
+pure function of its inputs (angle, date and geolocation bands) instead of
+computing them again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See derived_cache.h for the layout of the cache.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "derived_cache.h"
+#include "raw_binary_io.h"
+#include "raw_binary_s3.h"
+#include "raw_binary_checksum.h"
+#include "espa_profile.h"
+
+/* Local defines */
+#define FNV_OFFSET_BASIS 14695981039346656037ULL /* 64-bit FNV-1a basis */
+#define FNV_PRIME 1099511628211ULL  /* 64-bit FNV-1a prime */
+
+/* Header at the start of a cached band file.  The band file follows as it
+   was written. */
+typedef struct
+{
+    char magic[8];                  /* DERIVED_CACHE_MAGIC */
+    int version;                    /* DERIVED_CACHE_VERSION */
+    int band;                       /* index of the band in the entry */
+    int nbands;                     /* number of bands in the entry */
+    int nlines;                     /* number of lines in the band */
+    int nsamps;                     /* number of samples in the band */
+    int unused;                     /* pads the header to 8 bytes; 0 */
+    uint64_t hash;                  /* hash of the key of the entry */
+    int64_t file_size;              /* number of bytes of the band file */
+    Espa_sub_sample_t sub_sample;   /* sub-sampling of the band */
+    Espa_tiling_t tiling;           /* tiling of the band */
+    Espa_band_stats_t stats;        /* statistics of the band */
+    char checksum[STR_SIZE];        /* checksum of the band file */
+} Derived_cache_header_t;
+
+
+/******************************************************************************
+MODULE:  hash_bytes
+
+PURPOSE: Adds a block of bytes to a 64-bit FNV-1a hash.
+
+RETURN VALUE:
+Type = uint64_t
+Value        Description
+-----        -----------
+hash         Updated hash
+
+NOTES:
+******************************************************************************/
+static uint64_t hash_bytes
+(
+    uint64_t hash,              /* I: hash so far */
+    const void *bytes,          /* I: bytes to add */
+    size_t count                /* I: number of bytes */
+)
+{
+    const unsigned char *byte = bytes;  /* current byte */
+    size_t i;                           /* looping variable */
+
+    for (i = 0; i < count; i++)
+    {
+        hash ^= byte[i];
+        hash *= FNV_PRIME;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  use_derived_cache
+
+PURPOSE: Determines if the derived band cache was requested via the
+ESPA_DERIVED_CACHE environment variable.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_DERIVED_CACHE names the cache
+false        ESPA_DERIVED_CACHE isn't set, or is empty
+
+NOTES:
+******************************************************************************/
+bool use_derived_cache ()
+{
+    char *cache = getenv ("ESPA_DERIVED_CACHE");  /* cache location */
+
+    return (cache != NULL && cache[0] != '\0');
+}
+
+
+/******************************************************************************
+MODULE:  init_derived_cache_key
+
+PURPOSE: Starts the key of the outputs of a stage with the stage name and
+the library version.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The stage name is also the directory of its entries in the cache, so it
+     shouldn't hold a '/'.
+******************************************************************************/
+void init_derived_cache_key
+(
+    Derived_cache_key_t *key,   /* O: key of the outputs of the stage */
+    const char *stage           /* I: name of the stage */
+)
+{
+    int version = DERIVED_CACHE_VERSION;  /* version of the cache layout */
+
+    memset (key, 0, sizeof (*key));
+    snprintf (key->stage, sizeof (key->stage), "%s", stage);
+    key->hash = FNV_OFFSET_BASIS;
+    add_derived_cache_string (key, stage);
+    add_derived_cache_string (key, ESPA_COMMON_VERSION);
+    add_derived_cache_bytes (key, &version, sizeof (version));
+}
+
+
+/******************************************************************************
+MODULE:  add_derived_cache_bytes
+
+PURPOSE: Adds an input value to the key of the outputs of a stage.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Values are added as their bytes, so a structure shouldn't be added
+     whole unless its padding is known to be zero; add its fields instead.
+******************************************************************************/
+void add_derived_cache_bytes
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    const void *bytes,          /* I: input bytes */
+    size_t nbytes               /* I: number of bytes */
+)
+{
+    key->hash = hash_bytes (key->hash, bytes, nbytes);
+}
+
+
+/******************************************************************************
+MODULE:  add_derived_cache_string
+
+PURPOSE: Adds an input string to the key of the outputs of a stage.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The terminating NULL is added too, so consecutive strings can't run
+     together.
+******************************************************************************/
+void add_derived_cache_string
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    const char *str             /* I: input string */
+)
+{
+    key->hash = hash_bytes (key->hash, str, strlen (str) + 1);
+}
+
+
+/******************************************************************************
+MODULE:  add_derived_cache_file
+
+PURPOSE: Adds the digest of the contents of an input file to the key of the
+outputs of a stage.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the file
+SUCCESS      Successful completion
+
+NOTES:
+  1. The digest is the CRC32C of the whole file, so the key doesn't depend on
+     the name or modification time of the file.
+******************************************************************************/
+int add_derived_cache_file
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    char *file_name             /* I: input file */
+)
+{
+    uint32_t crc;               /* CRC32C of the file */
+
+    if (compute_raw_binary_crc32c (file_name, &crc) != SUCCESS)
+        return (ERROR);
+
+    add_derived_cache_bytes (key, &crc, sizeof (crc));
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_derived_cache_band
+
+PURPOSE: Adds the digest of the contents of an input band to the key of the
+outputs of a stage.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the band file
+SUCCESS      Successful completion
+
+NOTES:
+  1. The checksum in the band metadata is used if there is one, so the band
+     file doesn't need to be read.  Otherwise the CRC32C of the band file is
+     computed, which is the same value.
+******************************************************************************/
+int add_derived_cache_band
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    Espa_band_meta_t *bmeta     /* I: metadata of the input band */
+)
+{
+    uint32_t crc;               /* CRC32C of the band file */
+
+    if (bmeta->checksum[0] != '\0' &&
+        strcmp (bmeta->checksum, ESPA_STRING_META_FILL) &&
+        sscanf (bmeta->checksum, "%8x", &crc) == 1)
+    {
+        add_derived_cache_bytes (key, &crc, sizeof (crc));
+        return (SUCCESS);
+    }
+
+    return (add_derived_cache_file (key, bmeta->file_name));
+}
+
+
+/******************************************************************************
+MODULE:  get_derived_cache_name
+
+PURPOSE: Builds the name of the cached file of a band of an entry, or of the
+directory of the entry.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Name is too long
+SUCCESS      Successful completion
+
+NOTES:
+  1. A band of -1 gives the directory of the entry.
+******************************************************************************/
+static int get_derived_cache_name
+(
+    const Derived_cache_key_t *key, /* I: key of the entry */
+    int band,                   /* I: index of the band; -1 for the entry */
+    char *name                  /* O: name of the file (PATH_MAX) */
+)
+{
+    char *cache = getenv ("ESPA_DERIVED_CACHE");  /* cache location */
+    int count;                  /* number of characters in the name */
+
+    count = snprintf (name, PATH_MAX, "%s/%s/%016llx", cache, key->stage,
+        (unsigned long long) key->hash);
+    if (count >= 0 && count < PATH_MAX && band >= 0)
+        count += snprintf (&name[count], PATH_MAX - count, "/band%d%s", band,
+            DERIVED_CACHE_EXT);
+    if (count < 0 || count >= PATH_MAX)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_derived_cache_file
+
+PURPOSE: Opens a file or object as a plain stream of its bytes.
+
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the file
+non-NULL     Opened stream
+
+NOTES:
+  1. Unlike open_raw_binary, the encoded band layouts (chunked, tiled, ...)
+     aren't decoded, so the band files are cached as they were written.
+******************************************************************************/
+static FILE *open_derived_cache_file
+(
+    const char *name,           /* I: name of the file or object */
+    char *access_type           /* I: "rb" or "wb" */
+)
+{
+    if (is_raw_binary_s3_url (name))
+        return (open_raw_binary_s3_stream ((char *) name, access_type));
+
+    return (fopen (name, access_type));
+}
+
+
+/******************************************************************************
+MODULE:  copy_derived_cache_data
+
+PURPOSE: Copies a number of bytes from one stream to another.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading or writing the bytes
+SUCCESS      Successful completion
+
+NOTES:
+******************************************************************************/
+static int copy_derived_cache_data
+(
+    FILE *in,                   /* I: stream to read */
+    FILE *out,                  /* I: stream to write */
+    int64_t nbytes,             /* I: number of bytes to copy */
+    void *buf                   /* I: buffer of DERIVED_CACHE_BLOCK_SIZE
+                                      bytes */
+)
+{
+    size_t count;               /* number of bytes in the current block */
+
+    while (nbytes > 0)
+    {
+        count = (nbytes < DERIVED_CACHE_BLOCK_SIZE) ? (size_t) nbytes
+            : DERIVED_CACHE_BLOCK_SIZE;
+        if (fread (buf, 1, count, in) != count ||
+            fwrite (buf, 1, count, out) != count)
+            return (ERROR);
+        nbytes -= count;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_derived_cache_band
+
+PURPOSE: Opens the cached file of a band of an entry and reads its header.
+
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         The band isn't cached, or its file doesn't match the entry
+non-NULL     Cached file, positioned after the header
+
+NOTES:
+  1. A missing file isn't reported.
+******************************************************************************/
+static FILE *open_derived_cache_band
+(
+    const Derived_cache_key_t *key, /* I: key of the entry */
+    int band,                   /* I: index of the band */
+    int nbands,                 /* I: number of bands in the entry */
+    Derived_cache_header_t *header  /* O: header of the cached file */
+)
+{
+    char name[PATH_MAX];        /* name of the cached file */
+    bool exists;                /* does the cached object exist? */
+    off_t size;                 /* size of the cached object */
+    struct stat file_stat;      /* status of the cached file */
+    FILE *fptr = NULL;          /* cached file */
+
+    if (get_derived_cache_name (key, band, name) != SUCCESS)
+        return (NULL);
+
+    /* Look for the file first, so a miss doesn't report an error */
+    if (is_raw_binary_s3_url (name))
+    {
+        if (stat_raw_binary_s3 (name, &exists, &size) != SUCCESS || !exists)
+            return (NULL);
+    }
+    else if (stat (name, &file_stat) != 0)
+        return (NULL);
+
+    fptr = open_derived_cache_file (name, "rb");
+    if (fptr == NULL)
+        return (NULL);
+
+    if (fread (header, sizeof (*header), 1, fptr) != 1 ||
+        memcmp (header->magic, DERIVED_CACHE_MAGIC, sizeof (header->magic)) ||
+        header->version != DERIVED_CACHE_VERSION ||
+        header->hash != key->hash || header->band != band ||
+        header->nbands != nbands || header->file_size < 0)
+    {
+        fclose (fptr);
+        return (NULL);
+    }
+
+    return (fptr);
+}
+
+
+/******************************************************************************
+MODULE:  read_derived_cache
+
+PURPOSE: Restores the output bands of a stage from the cache, if they were
+cached by an earlier run on the same inputs.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The band files were restored and the band metadata updated
+false        The cache isn't enabled, or doesn't hold all the bands
+
+NOTES:
+  1. The band files are restored to the file names in the band metadata,
+     and the size, sub-sampling, tiling, statistics and checksum of each
+     band are set from the cache.  The rest of the band metadata is left as
+     the stage set it up.
+  2. A missing or unreadable cache isn't an error; the bands simply need to
+     be computed.  The band metadata is only updated if every band was
+     restored, though some of the band files may have been overwritten.
+******************************************************************************/
+bool read_derived_cache
+(
+    const Derived_cache_key_t *key, /* I: key of the outputs of the stage */
+    int nbands,                 /* I: number of output bands */
+    Espa_band_meta_t *bands     /* I/O: output bands; the band files are
+                                   restored from the cache and the band
+                                   metadata updated */
+)
+{
+    int i;                      /* looping variable for the bands */
+    int status = SUCCESS;       /* status of restoring the bands */
+    void *buf = NULL;           /* block of the copied band file */
+    FILE *in = NULL;            /* cached band file */
+    FILE *out = NULL;           /* restored band file */
+    Derived_cache_header_t *header = NULL;  /* header of each band */
+
+    if (!use_derived_cache () || nbands < 1)
+        return (false);
+
+    header = calloc (nbands, sizeof (Derived_cache_header_t));
+    buf = malloc (DERIVED_CACHE_BLOCK_SIZE);
+    if (header == NULL || buf == NULL)
+    {
+        free (header);
+        free (buf);
+        espa_profile_count_cache (ESPA_PROFILE_CACHE_DERIVED, false);
+        return (false);
+    }
+
+    for (i = 0; i < nbands && status == SUCCESS; i++)
+    {
+        in = open_derived_cache_band (key, i, nbands, &header[i]);
+        if (in == NULL)
+        {
+            status = ERROR;
+            break;
+        }
+
+        out = open_derived_cache_file (bands[i].file_name, "wb");
+        if (out == NULL ||
+            copy_derived_cache_data (in, out, header[i].file_size, buf)
+            != SUCCESS)
+            status = ERROR;
+        fclose (in);
+        if (out != NULL && fclose (out) != 0)
+            status = ERROR;
+    }
+    free (buf);
+
+    /* Only update the band metadata once every band has been restored */
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < nbands; i++)
+        {
+            bands[i].nlines = header[i].nlines;
+            bands[i].nsamps = header[i].nsamps;
+            bands[i].sub_sample = header[i].sub_sample;
+            bands[i].tiling = header[i].tiling;
+            bands[i].stats = header[i].stats;
+            snprintf (bands[i].checksum, sizeof (bands[i].checksum), "%s",
+                header[i].checksum);
+        }
+    }
+
+    free (header);
+    espa_profile_count_cache (ESPA_PROFILE_CACHE_DERIVED, status == SUCCESS);
+    return (status == SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_derived_cache_band
+
+PURPOSE: Stores a band of the outputs of a stage in the cache.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the band to the cache
+SUCCESS      Successful completion
+
+NOTES:
+  1. A local file is written to a temporary file that is renamed into
+     place, so concurrent runs never see a partial band.  An object is only
+     created once its upload completes.
+******************************************************************************/
+static int write_derived_cache_band
+(
+    const Derived_cache_key_t *key, /* I: key of the outputs of the stage */
+    int band,                   /* I: index of the band */
+    int nbands,                 /* I: number of output bands */
+    const Espa_band_meta_t *bmeta,  /* I: output band, already written */
+    void *buf                   /* I: buffer of DERIVED_CACHE_BLOCK_SIZE
+                                      bytes */
+)
+{
+    char name[PATH_MAX];        /* name of the cached file */
+    char tmpfile[PATH_MAX];     /* temporary name of the cached file */
+    int status = SUCCESS;       /* status of writing the band */
+    bool local;                 /* is the cache a local directory? */
+    off_t file_size;            /* size of the band file */
+    FILE *in = NULL;            /* band file */
+    FILE *out = NULL;           /* cached band file */
+    Derived_cache_header_t header;  /* header of the cached file */
+
+    if (get_derived_cache_name (key, band, name) != SUCCESS)
+        return (ERROR);
+    local = !is_raw_binary_s3_url (name);
+    if (local && snprintf (tmpfile, PATH_MAX, "%s.%ld.tmp", name,
+        (long) getpid ()) >= PATH_MAX)
+        return (ERROR);
+
+    in = open_derived_cache_file (bmeta->file_name, "rb");
+    if (in == NULL)
+        return (ERROR);
+    if (fseeko (in, 0, SEEK_END) != 0 || (file_size = ftello (in)) < 0 ||
+        fseeko (in, 0, SEEK_SET) != 0)
+    {
+        fclose (in);
+        return (ERROR);
+    }
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, DERIVED_CACHE_MAGIC, sizeof (header.magic));
+    header.version = DERIVED_CACHE_VERSION;
+    header.band = band;
+    header.nbands = nbands;
+    header.nlines = bmeta->nlines;
+    header.nsamps = bmeta->nsamps;
+    header.hash = key->hash;
+    header.file_size = file_size;
+    header.sub_sample = bmeta->sub_sample;
+    header.tiling = bmeta->tiling;
+    header.stats = bmeta->stats;
+    snprintf (header.checksum, sizeof (header.checksum), "%s",
+        bmeta->checksum);
+
+    out = open_derived_cache_file (local ? tmpfile : name, "wb");
+    if (out == NULL)
+    {
+        fclose (in);
+        return (ERROR);
+    }
+    if (fwrite (&header, sizeof (header), 1, out) != 1 ||
+        copy_derived_cache_data (in, out, file_size, buf) != SUCCESS)
+        status = ERROR;
+    fclose (in);
+
+    /* Closing an object completes its upload */
+    if (fclose (out) != 0)
+        status = ERROR;
+    if (local && (status != SUCCESS || rename (tmpfile, name) != 0))
+    {
+        unlink (tmpfile);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_derived_cache
+
+PURPOSE: Stores the output bands of a stage in the cache, so later runs on
+the same inputs can restore them.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the bands to the cache
+SUCCESS      The bands were stored, or the cache isn't enabled
+
+NOTES:
+  1. The band files and metadata need to be complete, i.e. the band files
+     closed and their statistics and checksums set.
+  2. The caller should only warn about an error, since the bands themselves
+     were written.
+******************************************************************************/
+int write_derived_cache
+(
+    const Derived_cache_key_t *key, /* I: key of the outputs of the stage */
+    int nbands,                 /* I: number of output bands */
+    const Espa_band_meta_t *bands   /* I: output bands, already written */
+)
+{
+    char FUNC_NAME[] = "write_derived_cache";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char dir[PATH_MAX];         /* directory of the entry */
+    char *sep = NULL;           /* separator of the stage directory */
+    int i;                      /* looping variable for the bands */
+    void *buf = NULL;           /* block of the copied band file */
+
+    if (!use_derived_cache ())
+        return (SUCCESS);
+
+    if (get_derived_cache_name (key, -1, dir) != SUCCESS)
+    {
+        sprintf (errmsg, "Derived band cache directory is too long");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Objects need no directories; locally, create the stage and entry
+       directories */
+    if (!is_raw_binary_s3_url (dir))
+    {
+        sep = strrchr (dir, '/');
+        *sep = '\0';
+        if (mkdir (dir, 0777) != 0 && errno != EEXIST)
+        {
+            sprintf (errmsg, "Unable to create the derived band cache "
+                "directory %s", dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        *sep = '/';
+        if (mkdir (dir, 0777) != 0 && errno != EEXIST)
+        {
+            sprintf (errmsg, "Unable to create the derived band cache "
+                "directory %s", dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    buf = malloc (DERIVED_CACHE_BLOCK_SIZE);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for copying the bands to the "
+            "derived band cache");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        if (write_derived_cache_band (key, i, nbands, &bands[i], buf)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to store band %s in the derived band "
+                "cache %s", bands[i].file_name, dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (buf);
+            return (ERROR);
+        }
+    }
+
+    free (buf);
+    return (SUCCESS);
+}
@@ -0,0 +1,115 @@
+/*****************************************************************************
+FILE: derived_cache.h
+
+PURPOSE: Contains defines, structures and prototypes for the cache of derived
+bands, which lets a stage reuse the bands it wrote for an earlier run on the
+same inputs instead of computing them again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cache is only used when the ESPA_DERIVED_CACHE environment variable
+     names the cache, either a directory or an s3://bucket/prefix in the
+     object store (see raw_binary_s3.h), which lets several hosts share it.
+     Nothing is ever removed from the cache, so it is up to the user to
+     clean it out.
+  2. A stage builds the key of its outputs from its stage name, the library
+     version (ESPA_COMMON_VERSION and DERIVED_CACHE_VERSION), and the
+     digests of everything the band data depends on: input files, the
+     parameters of the stage, and the metadata values it uses.  The stage
+     is responsible for adding every input to the key.
+  3. An entry holds one file per output band: a header with the band size,
+     sub-sampling, tiling, statistics and checksum as they were written,
+     followed by the band file as written (plain, chunked or tiled).  The
+     stage still sets up the rest of the band metadata and writes the ENVI
+     headers itself.
+  4. The entries are named <cache>/<stage>/<key hash>/band<n>.dco.  Local
+     entries are written to a temporary file which is renamed into place,
+     and objects are only created when they are completely uploaded, so a
+     partial entry is never read.
+*****************************************************************************/
+
+#ifndef DERIVED_CACHE_H
+#define DERIVED_CACHE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Identifies the cached band files and the version of their layout */
+#define DERIVED_CACHE_MAGIC "ESPADCO"
+#define DERIVED_CACHE_VERSION 1
+
+/* Extension of the cached band files */
+#define DERIVED_CACHE_EXT ".dco"
+
+/* Size of the blocks copied to and from the cache */
+#define DERIVED_CACHE_BLOCK_SIZE (4 * 1024 * 1024)
+
+/* Type definitions */
+/* Key of the outputs of a stage */
+typedef struct
+{
+    char stage[STR_SIZE];   /* name of the stage */
+    uint64_t hash;          /* 64-bit FNV-1a hash of the stage, version and
+                               inputs */
+} Derived_cache_key_t;
+
+/* Prototypes */
+bool use_derived_cache ();
+
+void init_derived_cache_key
+(
+    Derived_cache_key_t *key,   /* O: key of the outputs of the stage */
+    const char *stage           /* I: name of the stage */
+);
+
+void add_derived_cache_bytes
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    const void *bytes,          /* I: input bytes */
+    size_t nbytes               /* I: number of bytes */
+);
+
+void add_derived_cache_string
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    const char *str             /* I: input string */
+);
+
+int add_derived_cache_file
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    char *file_name             /* I: input file */
+);
+
+int add_derived_cache_band
+(
+    Derived_cache_key_t *key,   /* I/O: key of the outputs of the stage */
+    Espa_band_meta_t *bmeta     /* I: metadata of the input band */
+);
+
+bool read_derived_cache
+(
+    const Derived_cache_key_t *key, /* I: key of the outputs of the stage */
+    int nbands,                 /* I: number of output bands */
+    Espa_band_meta_t *bands     /* I/O: output bands; the band files are
+                                   restored from the cache and the band
+                                   metadata updated */
+);
+
+int write_derived_cache
+(
+    const Derived_cache_key_t *key, /* I: key of the outputs of the stage */
+    int nbands,                 /* I: number of output bands */
+    const Espa_band_meta_t *bands   /* I: output bands, already written */
+);
+
+#endif
@@ -9,22 +9,26 @@ at the USGS EROS
 LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 
 NOTES:
+  1. The headers of a stage's bands may be collected in an Envi_hdr_batch_t
+     as the bands are written, and all written together at the end of the
+     stage (see flush_envi_hdr_batch).
 *****************************************************************************/
 
+#define _GNU_SOURCE
 #include "envi_header.h"
+#include "raw_binary_async.h"
 
 /******************************************************************************
-MODULE:  write_envi_hdr
+MODULE:  print_envi_hdr
 
-PURPOSE:  Writes the ENVI header to the specified file using the input info
-provided.
+PURPOSE:  Prints the ENVI header to a stream using the input info provided.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           An error occurred generating the header file
-SUCCESS         Header file was successful
+ERROR           An error occurred generating the header
+SUCCESS         Header was successful
 
 NOTES:
   1. Only supports GEO, UTM, ALBERS, PS, and SIN projections.
@@ -37,13 +41,13 @@ NOTES:
      NAD27: GEOGCS["GCS_North_American_1927",DATUM["D_North_American_1927",SPHEROID["Clarke_1866",6378206.4,294.9786982]],PRIMEM["Greenwich",0.0],UNIT["Degree",0.0174532925199433]]
      NAD83: GEOGCS["GCS_North_American_1983",DATUM["D_North_American_1983",SPHEROID["GRS_1980",6378137.0,298.257222101]],PRIMEM["Greenwich",0.0],UNIT["Degree",0.0174532925199433]]
 ******************************************************************************/
-int write_envi_hdr
+static int print_envi_hdr
 (
-    char *hdr_file,     /* I: name of ENVI header file to be generated */
+    FILE *hdr_fptr,     /* I: stream the ENVI header is printed to */
     Envi_header_t *hdr  /* I: input ENVI header information */
 )
 {
-    char FUNC_NAME[] = "write_envi_hdr";   /* function name */
+    char FUNC_NAME[] = "print_envi_hdr";   /* function name */
     char errmsg[STR_SIZE];        /* error message */
     char geogcs_str[STR_SIZE];    /* string for the GCS code */
     char datum_str[STR_SIZE];     /* string for the datum code */
@@ -54,16 +58,6 @@ int write_envi_hdr
     double semi_major_axis=-99.0; /* semi-major axis for the spheroid */
     double semi_minor_axis=-99.0; /* semi-minor axis for the spheroid */
     double inv_flattening=-99.0;  /* inverse flattening for the spheroid */
-    FILE *hdr_fptr = NULL;        /* file pointer to the ENVI header file */
-
-    /* Open the header file */
-    hdr_fptr = fopen (hdr_file, "w");
-    if (hdr_fptr == NULL)
-    {
-        sprintf (errmsg, "Opening %s for write access.", hdr_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
     /* Verify the projection is GEO, UTM, ALBERS, PS, or SIN and datum is
        WGS-84 */
@@ -277,20 +271,339 @@ int write_envi_hdr
 */
     }
 
-    /* Write the array of band names */
-    fprintf (hdr_fptr, "band names = {%s", hdr->band_names[0]);
-    for (i = 1; i < hdr->nbands; i++)
-        fprintf (hdr_fptr, ", %s", hdr->band_names[i]);
-    fprintf (hdr_fptr, "}\n");
-
-    /* Close the header file */
-    fclose (hdr_fptr);
+    /* Write the array of band names, which only holds the names of the
+       first MAX_ENVI_BANDS bands; ENVI names the bands itself otherwise */
+    if (hdr->nbands <= MAX_ENVI_BANDS)
+    {
+        fprintf (hdr_fptr, "band names = {%s", hdr->band_names[0]);
+        for (i = 1; i < hdr->nbands; i++)
+            fprintf (hdr_fptr, ", %s", hdr->band_names[i]);
+        fprintf (hdr_fptr, "}\n");
+    }
 
     /* Successful completion */
     return (SUCCESS);
 }
 
 
+/******************************************************************************
+MODULE:  write_envi_hdr
+
+PURPOSE:  Writes the ENVI header to the specified file using the input info
+provided.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred generating the header file
+SUCCESS         Header file was successful
+
+NOTES:
+  1. See print_envi_hdr for the projections and datums supported.
+******************************************************************************/
+int write_envi_hdr
+(
+    char *hdr_file,     /* I: name of ENVI header file to be generated */
+    Envi_header_t *hdr  /* I: input ENVI header information */
+)
+{
+    char FUNC_NAME[] = "write_envi_hdr";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status;                   /* status of printing the header */
+    FILE *hdr_fptr = NULL;        /* file pointer to the ENVI header file */
+
+    /* Open the header file */
+    hdr_fptr = fopen (hdr_file, "w");
+    if (hdr_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for write access.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Print the header and close the file */
+    status = print_envi_hdr (hdr_fptr, hdr);
+    if (fclose (hdr_fptr) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_envi_hdr_batch
+
+PURPOSE:  Initializes a batch of ENVI headers with a slot for each header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the slots
+SUCCESS         Successful completion
+
+NOTES:
+  1. The slots are empty until a header is added to them, so a batch may be
+     sized for the largest number of bands a stage writes.
+******************************************************************************/
+int init_envi_hdr_batch
+(
+    Envi_hdr_batch_t *batch,  /* O: batch of ENVI headers */
+    int nslots                /* I: number of headers the batch holds */
+)
+{
+    char FUNC_NAME[] = "init_envi_hdr_batch";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+
+    batch->nslots = nslots;
+    batch->hdr_files = calloc (nslots, sizeof (char *));
+    batch->hdr_text = calloc (nslots, sizeof (char *));
+    batch->hdr_size = calloc (nslots, sizeof (size_t));
+    if (batch->hdr_files == NULL || batch->hdr_text == NULL ||
+        batch->hdr_size == NULL)
+    {
+        free_envi_hdr_batch (batch);
+        sprintf (errmsg, "Allocating a batch of %d ENVI headers.", nslots);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_envi_hdr
+
+PURPOSE:  Adds an ENVI header to a slot of the batch, to be written by
+flush_envi_hdr_batch.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred generating the header
+SUCCESS         Header was added
+
+NOTES:
+  1. The header is printed to memory right away, so unsupported projections
+     and datums are reported here rather than at the flush.
+  2. Each slot is only touched by the thread adding to it, so the threads of
+     a stage may add the headers of their own bands concurrently.
+******************************************************************************/
+int add_envi_hdr
+(
+    Envi_hdr_batch_t *batch,  /* I/O: batch of ENVI headers */
+    int slot,           /* I: slot of the header (e.g. the band index) */
+    char *hdr_file,     /* I: name of ENVI header file to be generated */
+    Envi_header_t *hdr  /* I: input ENVI header information */
+)
+{
+    char FUNC_NAME[] = "add_envi_hdr";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *text = NULL;            /* contents of the header */
+    size_t size = 0;              /* size of the contents */
+    int status;                   /* status of printing the header */
+    FILE *hdr_fptr = NULL;        /* stream the header is printed to */
+
+    if (slot < 0 || slot >= batch->nslots)
+    {
+        sprintf (errmsg, "ENVI header slot %d is outside the batch of %d.",
+            slot, batch->nslots);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    hdr_fptr = open_memstream (&text, &size);
+    if (hdr_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening a memory stream for %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    status = print_envi_hdr (hdr_fptr, hdr);
+    if (fclose (hdr_fptr) != 0 && status == SUCCESS)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        free (text);
+        sprintf (errmsg, "Generating the ENVI header %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    free (batch->hdr_files[slot]);
+    free (batch->hdr_text[slot]);
+    batch->hdr_files[slot] = strdup (hdr_file);
+    batch->hdr_text[slot] = text;
+    batch->hdr_size[slot] = size;
+    if (batch->hdr_files[slot] == NULL)
+    {
+        sprintf (errmsg, "Allocating the name of %s.", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  flush_envi_hdr_batch
+
+PURPOSE:  Writes all the ENVI headers added to the batch to their files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred writing the header files
+SUCCESS         Header files were written
+
+NOTES:
+  1. The header files are all created first, and their contents are then
+     written through an asynchronous I/O queue (see raw_binary_async.h), so
+     with io_uring the writes go to the kernel together rather than as a
+     write and close per band.  A single header, or a queue which can't be
+     opened, is written directly.
+  2. The slots written are emptied, so the batch may be flushed again as
+     more headers are added.
+******************************************************************************/
+int flush_envi_hdr_batch
+(
+    Envi_hdr_batch_t *batch   /* I/O: batch of ENVI headers */
+)
+{
+    char FUNC_NAME[] = "flush_envi_hdr_batch";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int i;                        /* looping variable for the slots */
+    int nhdrs = 0;                /* number of headers to be written */
+    int status = SUCCESS;         /* status of the writes */
+    FILE **hdr_fptr = NULL;       /* header files */
+    Raw_binary_async_t *aio = NULL;  /* queue of the writes */
+
+    for (i = 0; i < batch->nslots; i++)
+    {
+        if (batch->hdr_files[i] != NULL)
+            nhdrs++;
+    }
+    if (nhdrs == 0)
+        return (SUCCESS);
+
+    hdr_fptr = calloc (batch->nslots, sizeof (FILE *));
+    if (hdr_fptr == NULL)
+    {
+        sprintf (errmsg, "Allocating the file pointers of %d ENVI headers.",
+            nhdrs);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (nhdrs > 1)
+        aio = open_raw_binary_async (nhdrs < RB_ASYNC_QUEUE_DEPTH ?
+            nhdrs : RB_ASYNC_QUEUE_DEPTH);
+
+    /* Create the files and queue their contents */
+    for (i = 0; i < batch->nslots && status == SUCCESS; i++)
+    {
+        if (batch->hdr_files[i] == NULL)
+            continue;
+        hdr_fptr[i] = fopen (batch->hdr_files[i], "w");
+        if (hdr_fptr[i] == NULL)
+        {
+            sprintf (errmsg, "Opening %s for write access.",
+                batch->hdr_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (aio != NULL)
+            status = submit_raw_binary_write (aio, hdr_fptr[i], 0,
+                batch->hdr_size[i], batch->hdr_text[i]);
+        else if (fwrite (batch->hdr_text[i], 1, batch->hdr_size[i],
+            hdr_fptr[i]) != batch->hdr_size[i])
+        {
+            sprintf (errmsg, "Writing the ENVI header file %s.",
+                batch->hdr_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Wait for the writes even after an error, since they use the
+       contents of the slots */
+    if (aio != NULL)
+    {
+        if (wait_raw_binary_async (aio) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing %d ENVI header files.", nhdrs);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        close_raw_binary_async (aio);
+    }
+
+    for (i = 0; i < batch->nslots; i++)
+    {
+        if (hdr_fptr[i] != NULL && fclose (hdr_fptr[i]) != 0 &&
+            status == SUCCESS)
+        {
+            sprintf (errmsg, "Closing the ENVI header file %s.",
+                batch->hdr_files[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (hdr_fptr[i] != NULL)
+        {
+            free (batch->hdr_files[i]);
+            free (batch->hdr_text[i]);
+            batch->hdr_files[i] = NULL;
+            batch->hdr_text[i] = NULL;
+        }
+    }
+    free (hdr_fptr);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  free_envi_hdr_batch
+
+PURPOSE:  Frees a batch of ENVI headers, including any not yet written.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void free_envi_hdr_batch
+(
+    Envi_hdr_batch_t *batch   /* I/O: batch of ENVI headers */
+)
+{
+    int i;                        /* looping variable for the slots */
+
+    for (i = 0; i < batch->nslots; i++)
+    {
+        if (batch->hdr_files != NULL)
+            free (batch->hdr_files[i]);
+        if (batch->hdr_text != NULL)
+            free (batch->hdr_text[i]);
+    }
+    free (batch->hdr_files);
+    free (batch->hdr_text);
+    free (batch->hdr_size);
+    batch->hdr_files = NULL;
+    batch->hdr_text = NULL;
+    batch->hdr_size = NULL;
+    batch->nslots = 0;
+}
+
+
 /******************************************************************************
 MODULE:  create_envi_struct
 
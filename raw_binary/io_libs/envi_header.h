@@ -73,6 +73,16 @@ typedef struct {
                                size is nbands */
 } Envi_header_t;
 
+/* ENVI headers of a stage's bands, held in memory until they are all
+   written by flush_envi_hdr_batch */
+typedef struct {
+    int nslots;          /* number of headers the batch holds */
+    char **hdr_files;    /* name of the header file of each slot; NULL if
+                            the slot is empty */
+    char **hdr_text;     /* contents of the header of each slot */
+    size_t *hdr_size;    /* size of the contents of each slot (bytes) */
+} Envi_hdr_batch_t;
+
 
 /* Prototypes */
 int write_envi_hdr
@@ -88,4 +98,28 @@ int create_envi_struct
     Envi_header_t *hdr         /* I/O: output ENVI header information */
 );
 
+int init_envi_hdr_batch
+(
+    Envi_hdr_batch_t *batch,  /* O: batch of ENVI headers */
+    int nslots                /* I: number of headers the batch holds */
+);
+
+int add_envi_hdr
+(
+    Envi_hdr_batch_t *batch,  /* I/O: batch of ENVI headers */
+    int slot,           /* I: slot of the header (e.g. the band index) */
+    char *hdr_file,     /* I: name of ENVI header file to be generated */
+    Envi_header_t *hdr  /* I: input ENVI header information */
+);
+
+int flush_envi_hdr_batch
+(
+    Envi_hdr_batch_t *batch   /* I/O: batch of ENVI headers */
+);
+
+void free_envi_hdr_batch
+(
+    Envi_hdr_batch_t *batch   /* I/O: batch of ENVI headers */
+);
+
 #endif
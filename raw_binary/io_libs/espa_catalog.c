@@ -0,0 +1,1493 @@
+/*****************************************************************************
+FILE: espa_catalog.c
+
+PURPOSE: Contains functions for building, updating and querying the catalog
+of ESPA products, so scenes can be found by satellite, acquisition date,
+path/row, tile or band product without parsing each XML file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML files are parsed with parse_metadata_lazy, which skips the band
+     details (bitmap descriptions, classes, cover types, QA description and
+     statistics) since they aren't cataloged.
+  2. Updating a catalog only parses the XML files which are new or whose
+     size or modification time changed since they were cataloged.  Scenes
+     whose XML file no longer exists are removed.
+  3. A query narrows the scenes with whichever of the acquisition date,
+     path/row, tile and band product indexes selects the fewest records, then
+     checks the rest of the query on each of them.
+  4. The catalog is written to a temporary file which is renamed over the
+     previous catalog, so readers never see a partial catalog.
+*****************************************************************************/
+
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libxml/parser.h>
+#include "espa_catalog.h"
+#include "parse_metadata.h"
+
+/* XML file being cataloged by update_espa_catalog */
+typedef struct
+{
+    char *xml_file;               /* name of the XML file */
+    int old_scene;                /* scene record in the previous catalog;
+                                     -1 if the XML file wasn't cataloged */
+    bool keep;                    /* is the XML file in the updated catalog */
+    bool parse;                   /* does the XML file need to be parsed */
+    Espa_catalog_scene_t scene;   /* scene record */
+    Espa_catalog_band_t *band;    /* band records; allocated if the XML file
+                                     was parsed, otherwise in the previous
+                                     catalog */
+} Catalog_entry_t;
+
+/* Work shared by the threads parsing the XML files */
+typedef struct
+{
+    Catalog_entry_t **entry;      /* entries to be parsed */
+    int nentries;                 /* number of entries to be parsed */
+    int next;                     /* next entry to be parsed */
+    pthread_mutex_t lock;         /* lock for next */
+} Catalog_work_t;
+
+/* Sort key of the path/row and tile indexes */
+typedef struct
+{
+    int32_t key1;                 /* path or htile */
+    int32_t key2;                 /* row or vtile */
+    int32_t index;                /* scene index */
+} Catalog_grid_key_t;
+
+/* Sort key of the band product index */
+typedef struct
+{
+    const char *product;          /* band product */
+    int32_t index;                /* band index */
+} Catalog_product_key_t;
+
+
+/******************************************************************************
+MODULE: init_catalog_query
+
+PURPOSE: Initializes a query to match every scene in the catalog.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void init_catalog_query
+(
+    Espa_catalog_query_t *query   /* O: query matching any scene */
+)
+{
+    query->satellite = NULL;
+    query->instrument = NULL;
+    query->start_date = NULL;
+    query->end_date = NULL;
+    query->wrs_path = ESPA_INT_META_FILL;
+    query->wrs_row = ESPA_INT_META_FILL;
+    query->htile = ESPA_INT_META_FILL;
+    query->vtile = ESPA_INT_META_FILL;
+    query->product = NULL;
+    query->use_bbox = false;
+}
+
+
+/******************************************************************************
+MODULE: open_espa_catalog
+
+PURPOSE: Memory maps the catalog file and checks its layout.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error opening or mapping the catalog, or it isn't a catalog with
+             the current layout
+SUCCESS      The catalog was opened
+
+NOTES:
+  1. The catalog must be closed with close_espa_catalog.
+*****************************************************************************/
+int open_espa_catalog
+(
+    char *catalog_file,           /* I: name of the catalog file */
+    Espa_catalog_t *catalog       /* O: opened catalog */
+)
+{
+    char FUNC_NAME[] = "open_espa_catalog";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    struct stat cat_stat;         /* status of the catalog file */
+    Espa_catalog_header_t header; /* header of the catalog */
+    uint64_t size;                /* size of the catalog file */
+    int fd;                       /* file descriptor of the catalog */
+
+    memset (catalog, 0, sizeof (Espa_catalog_t));
+
+    fd = open (catalog_file, O_RDONLY);
+    if (fd < 0)
+    {
+        sprintf (errmsg, "Opening the catalog %s", catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (fstat (fd, &cat_stat) != 0 ||
+        cat_stat.st_size < (off_t) sizeof (Espa_catalog_header_t))
+    {
+        close (fd);
+        sprintf (errmsg, "%s is not an ESPA catalog", catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    size = cat_stat.st_size;
+
+    catalog->map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (catalog->map == MAP_FAILED)
+    {
+        catalog->map = NULL;
+        sprintf (errmsg, "Mapping the catalog %s", catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    catalog->map_size = size;
+
+    /* Make sure it's a catalog with the current layout, and every section is
+       within the file */
+    memcpy (&header, catalog->map, sizeof (header));
+    if (memcmp (header.magic, ESPA_CATALOG_MAGIC, sizeof (header.magic)))
+    {
+        close_espa_catalog (catalog);
+        sprintf (errmsg, "%s is not an ESPA catalog", catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (header.version != ESPA_CATALOG_VERSION ||
+        header.scene_size != (int32_t) sizeof (Espa_catalog_scene_t) ||
+        header.band_size != (int32_t) sizeof (Espa_catalog_band_t))
+    {
+        close_espa_catalog (catalog);
+        sprintf (errmsg, "Catalog %s is version %d; version %d is "
+            "supported.  Rebuild the catalog.", catalog_file, header.version,
+            ESPA_CATALOG_VERSION);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (header.nscenes < 0 || header.nscenes > INT_MAX ||
+        header.nbands < 0 || header.nbands > INT_MAX ||
+        header.scene_offset > size || header.nscenes > (int64_t)
+        ((size - header.scene_offset) / sizeof (Espa_catalog_scene_t)) ||
+        header.band_offset > size || header.nbands > (int64_t)
+        ((size - header.band_offset) / sizeof (Espa_catalog_band_t)) ||
+        header.pathrow_offset > size || header.nscenes > (int64_t)
+        ((size - header.pathrow_offset) / sizeof (int32_t)) ||
+        header.tile_offset > size || header.nscenes > (int64_t)
+        ((size - header.tile_offset) / sizeof (int32_t)) ||
+        header.product_offset > size || header.nbands > (int64_t)
+        ((size - header.product_offset) / sizeof (int32_t)) ||
+        header.strings_offset > size ||
+        header.strings_size > size - header.strings_offset)
+    {
+        close_espa_catalog (catalog);
+        sprintf (errmsg, "Catalog %s is truncated or corrupt", catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    catalog->nscenes = (int) header.nscenes;
+    catalog->nbands = (int) header.nbands;
+    catalog->scene = (const Espa_catalog_scene_t *)
+        ((const char *) catalog->map + header.scene_offset);
+    catalog->band = (const Espa_catalog_band_t *)
+        ((const char *) catalog->map + header.band_offset);
+    catalog->by_pathrow = (const int32_t *)
+        ((const char *) catalog->map + header.pathrow_offset);
+    catalog->by_tile = (const int32_t *)
+        ((const char *) catalog->map + header.tile_offset);
+    catalog->by_product = (const int32_t *)
+        ((const char *) catalog->map + header.product_offset);
+    catalog->strings = (const char *) catalog->map + header.strings_offset;
+    catalog->strings_size = header.strings_size;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: close_espa_catalog
+
+PURPOSE: Unmaps the catalog.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void close_espa_catalog
+(
+    Espa_catalog_t *catalog       /* I/O: catalog to be closed */
+)
+{
+    if (catalog->map != NULL)
+        munmap (catalog->map, catalog->map_size);
+    memset (catalog, 0, sizeof (Espa_catalog_t));
+}
+
+
+/******************************************************************************
+MODULE: get_catalog_xml_file
+
+PURPOSE: Returns the name of the XML file of a scene record.
+
+RETURN VALUE:
+Type = const char *
+Value        Description
+-----        -----------
+""           The name isn't within the catalog (corrupt catalog)
+other        Name of the XML file
+
+NOTES:
+*****************************************************************************/
+const char *get_catalog_xml_file
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    int scene                     /* I: index of the scene record */
+)
+{
+    uint64_t offset = catalog->scene[scene].xml_file;  /* name offset */
+
+    if (offset >= catalog->strings_size ||
+        memchr (catalog->strings + offset, '\0',
+        catalog->strings_size - offset) == NULL)
+        return ("");
+    return (catalog->strings + offset);
+}
+
+
+/******************************************************************************
+MODULE: compare_grid
+
+PURPOSE: Compares the path/row (or tile) of a scene to the ones in the query.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+< 0          The scene sorts before the query
+0            The scene matches the query
+> 0          The scene sorts after the query
+
+NOTES:
+  1. A key2 of ESPA_INT_META_FILL matches any row (or vtile).
+*****************************************************************************/
+static int compare_grid
+(
+    int32_t scene_key1,           /* I: path or htile of the scene */
+    int32_t scene_key2,           /* I: row or vtile of the scene */
+    int key1,                     /* I: path or htile of the query */
+    int key2                      /* I: row or vtile of the query */
+)
+{
+    if (scene_key1 != key1)
+        return (scene_key1 < key1 ? -1 : 1);
+    if (key2 == ESPA_INT_META_FILL || scene_key2 == key2)
+        return (0);
+    return (scene_key2 < key2 ? -1 : 1);
+}
+
+
+/******************************************************************************
+MODULE: find_grid_range
+
+PURPOSE: Finds the range of the path/row or tile index matching the query.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The range is [*first, *last); it's empty if no scene matches.
+*****************************************************************************/
+static void find_grid_range
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    bool tile,                    /* I: use the tile index (otherwise the
+                                        path/row index) */
+    int key1,                     /* I: path or htile of the query */
+    int key2,                     /* I: row or vtile of the query */
+    int *first,                   /* O: first matching index entry */
+    int *last                     /* O: entry after the last match */
+)
+{
+    const int32_t *index = tile ? catalog->by_tile : catalog->by_pathrow;
+    const Espa_catalog_scene_t *scene = NULL;  /* scene of an index entry */
+    int low, high, mid;           /* binary search bounds */
+    int bound;                    /* which bound is being searched */
+    int cmp;                      /* comparison of the scene to the query */
+
+    for (bound = 0; bound < 2; bound++)
+    {
+        low = 0;
+        high = catalog->nscenes;
+        while (low < high)
+        {
+            mid = low + (high - low) / 2;
+            scene = &catalog->scene[index[mid]];
+            if (tile)
+                cmp = compare_grid (scene->htile, scene->vtile, key1, key2);
+            else
+                cmp = compare_grid (scene->wrs_path, scene->wrs_row, key1,
+                    key2);
+            if (cmp >= bound)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        if (bound == 0)
+            *first = low;
+        else
+            *last = low;
+    }
+}
+
+
+/******************************************************************************
+MODULE: find_product_range
+
+PURPOSE: Finds the range of the band product index matching the query.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The range is [*first, *last); it's empty if no band matches.
+*****************************************************************************/
+static void find_product_range
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const char *product,          /* I: band product of the query */
+    int *first,                   /* O: first matching index entry */
+    int *last                     /* O: entry after the last match */
+)
+{
+    int low, high, mid;           /* binary search bounds */
+    int bound;                    /* which bound is being searched */
+    int cmp;                      /* comparison of the products */
+
+    for (bound = 0; bound < 2; bound++)
+    {
+        low = 0;
+        high = catalog->nbands;
+        while (low < high)
+        {
+            mid = low + (high - low) / 2;
+            cmp = strcmp (catalog->band[catalog->by_product[mid]].product,
+                product);
+            if (cmp >= bound)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        if (bound == 0)
+            *first = low;
+        else
+            *last = low;
+    }
+}
+
+
+/******************************************************************************
+MODULE: find_date_range
+
+PURPOSE: Finds the range of scene records acquired within the query dates.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The range is [*first, *last); it's empty if no scene matches.
+  2. The yyyy-mm-dd dates sort as strings.
+*****************************************************************************/
+static void find_date_range
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const char *start_date,       /* I: first date; NULL for any */
+    const char *end_date,         /* I: last date; NULL for any */
+    int *first,                   /* O: first matching scene */
+    int *last                     /* O: scene after the last match */
+)
+{
+    int low, high, mid;           /* binary search bounds */
+
+    low = 0;
+    high = catalog->nscenes;
+    while (start_date != NULL && low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (strcmp (catalog->scene[mid].acquisition_date, start_date) >= 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    *first = low;
+
+    low = *first;
+    high = catalog->nscenes;
+    while (end_date != NULL && low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (strcmp (catalog->scene[mid].acquisition_date, end_date) > 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    *last = (end_date != NULL) ? low : catalog->nscenes;
+}
+
+
+/******************************************************************************
+MODULE: scene_matches
+
+PURPOSE: Checks the whole query on a scene record.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The scene matches the query
+false        The scene doesn't match the query
+
+NOTES:
+*****************************************************************************/
+static bool scene_matches
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const Espa_catalog_query_t *query,  /* I: scenes to be found */
+    int index                     /* I: index of the scene record */
+)
+{
+    const Espa_catalog_scene_t *scene = &catalog->scene[index];
+    int i;                        /* looping variable for the bands */
+
+    if ((query->satellite != NULL &&
+         strcmp (scene->satellite, query->satellite)) ||
+        (query->instrument != NULL &&
+         strcmp (scene->instrument, query->instrument)) ||
+        (query->start_date != NULL &&
+         strcmp (scene->acquisition_date, query->start_date) < 0) ||
+        (query->end_date != NULL &&
+         strcmp (scene->acquisition_date, query->end_date) > 0) ||
+        (query->wrs_path != ESPA_INT_META_FILL &&
+         scene->wrs_path != query->wrs_path) ||
+        (query->wrs_row != ESPA_INT_META_FILL &&
+         scene->wrs_row != query->wrs_row) ||
+        (query->htile != ESPA_INT_META_FILL &&
+         scene->htile != query->htile) ||
+        (query->vtile != ESPA_INT_META_FILL &&
+         scene->vtile != query->vtile))
+        return (false);
+
+    /* The bounding coordinates have to overlap the bounding box; boxes
+       crossing the antimeridian aren't handled */
+    if (query->use_bbox &&
+        (scene->bounding_coords[0] > query->bbox[1] ||
+         scene->bounding_coords[1] < query->bbox[0] ||
+         scene->bounding_coords[2] < query->bbox[3] ||
+         scene->bounding_coords[3] > query->bbox[2]))
+        return (false);
+
+    if (query->product == NULL)
+        return (true);
+    if (scene->first_band < 0 || scene->nbands < 0 ||
+        scene->first_band > catalog->nbands - scene->nbands)
+        return (false);
+    for (i = 0; i < scene->nbands; i++)
+    {
+        if (!strcmp (catalog->band[scene->first_band + i].product,
+            query->product))
+            return (true);
+    }
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE: compare_ints
+
+PURPOSE: qsort comparison of two ints.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+< 0, 0, > 0  The first int is less than, equal to or greater than the second
+
+NOTES:
+*****************************************************************************/
+static int compare_ints
+(
+    const void *a,                /* I: first int */
+    const void *b                 /* I: second int */
+)
+{
+    int ia = *(const int *) a;
+    int ib = *(const int *) b;
+
+    return ((ia > ib) - (ia < ib));
+}
+
+
+/******************************************************************************
+MODULE: query_espa_catalog
+
+PURPOSE: Finds the scenes in the catalog matching the query.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the list of scenes
+SUCCESS      The query was done; *nscenes may be 0
+
+NOTES:
+  1. The scenes are returned in catalog order, i.e. by acquisition date and
+     XML filename.
+  2. The wrs_row (or vtile) is only used to narrow the search if the wrs_path
+     (or htile) is also specified; otherwise it's just checked on each scene.
+*****************************************************************************/
+int query_espa_catalog
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const Espa_catalog_query_t *query,  /* I: scenes to be found */
+    int **scenes,                 /* O: indexes of the matching scene
+                                        records in catalog order; must be
+                                        freed by the caller */
+    int *nscenes                  /* O: number of matching scenes */
+)
+{
+    char FUNC_NAME[] = "query_espa_catalog";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    enum {BY_DATE, BY_PATHROW, BY_TILE, BY_PRODUCT} source = BY_DATE;
+                                  /* index narrowing the search */
+    int first, last;              /* range of the narrowing index */
+    int range_first, range_last;  /* range of another index */
+    int count = 0;                /* number of matching scenes */
+    int index;                    /* scene index */
+    int i;                        /* looping variable */
+
+    *scenes = NULL;
+    *nscenes = 0;
+
+    /* Pick the index which selects the fewest records */
+    find_date_range (catalog, query->start_date, query->end_date, &first,
+        &last);
+    if (query->wrs_path != ESPA_INT_META_FILL)
+    {
+        find_grid_range (catalog, false, query->wrs_path, query->wrs_row,
+            &range_first, &range_last);
+        if (range_last - range_first < last - first)
+        {
+            source = BY_PATHROW;
+            first = range_first;
+            last = range_last;
+        }
+    }
+    if (query->htile != ESPA_INT_META_FILL)
+    {
+        find_grid_range (catalog, true, query->htile, query->vtile,
+            &range_first, &range_last);
+        if (range_last - range_first < last - first)
+        {
+            source = BY_TILE;
+            first = range_first;
+            last = range_last;
+        }
+    }
+    if (query->product != NULL)
+    {
+        find_product_range (catalog, query->product, &range_first,
+            &range_last);
+        if (range_last - range_first < last - first)
+        {
+            source = BY_PRODUCT;
+            first = range_first;
+            last = range_last;
+        }
+    }
+    if (last <= first)
+        return (SUCCESS);
+
+    *scenes = malloc ((last - first) * sizeof (int));
+    if (*scenes == NULL)
+    {
+        sprintf (errmsg, "Allocating the list of %d scenes", last - first);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Check the rest of the query on each selected scene */
+    for (i = first; i < last; i++)
+    {
+        if (source == BY_PATHROW)
+            index = catalog->by_pathrow[i];
+        else if (source == BY_TILE)
+            index = catalog->by_tile[i];
+        else if (source == BY_PRODUCT)
+            index = catalog->band[catalog->by_product[i]].scene;
+        else
+            index = i;
+        if (index < 0 || index >= catalog->nscenes)
+            continue;
+        if (scene_matches (catalog, query, index))
+            (*scenes)[count++] = index;
+    }
+
+    /* Put the scenes in catalog order; the product index lists a scene once
+       for each band with the product */
+    if (source != BY_DATE)
+    {
+        qsort (*scenes, count, sizeof (int), compare_ints);
+        for (i = 0, *nscenes = 0; i < count; i++)
+        {
+            if (*nscenes == 0 || (*scenes)[i] != (*scenes)[*nscenes - 1])
+                (*scenes)[(*nscenes)++] = (*scenes)[i];
+        }
+    }
+    else
+        *nscenes = count;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: copy_catalog_string
+
+PURPOSE: Copies a metadata string into a catalog record field, truncating it
+if needed.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void copy_catalog_string
+(
+    char *dest,                   /* O: catalog record field */
+    const char *src,              /* I: metadata string */
+    size_t size                   /* I: size of the field */
+)
+{
+    strncpy (dest, src, size - 1);
+    dest[size - 1] = '\0';
+}
+
+
+/******************************************************************************
+MODULE: parse_catalog_entry
+
+PURPOSE: Parses the XML file of an entry into its scene and band records.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The XML file was parsed
+false        Error parsing the XML file or allocating the band records
+
+NOTES:
+  1. The XML file's size and modification time are already in the scene
+     record.
+*****************************************************************************/
+static bool parse_catalog_entry
+(
+    Catalog_entry_t *entry        /* I/O: entry to be parsed */
+)
+{
+    Espa_internal_meta_t xml_metadata;  /* metadata of the XML file */
+    Espa_global_meta_t *gmeta = &xml_metadata.global;  /* global metadata */
+    Espa_catalog_scene_t *scene = &entry->scene;  /* scene record */
+    Espa_catalog_band_t *band = NULL;   /* band record */
+    const Espa_band_hot_t *hot = NULL;  /* compact copies of the bands */
+    int i;                        /* looping variable for the bands */
+
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata_lazy (entry->xml_file, &xml_metadata) != SUCCESS)
+    {
+        free_metadata (&xml_metadata);
+        return (false);
+    }
+
+    copy_catalog_string (scene->satellite, gmeta->satellite,
+        sizeof (scene->satellite));
+    copy_catalog_string (scene->instrument, gmeta->instrument,
+        sizeof (scene->instrument));
+    copy_catalog_string (scene->acquisition_date, gmeta->acquisition_date,
+        sizeof (scene->acquisition_date));
+    copy_catalog_string (scene->product_id, gmeta->product_id,
+        sizeof (scene->product_id));
+    scene->wrs_path = gmeta->wrs_path;
+    scene->wrs_row = gmeta->wrs_row;
+    scene->htile = gmeta->htile;
+    scene->vtile = gmeta->vtile;
+    memcpy (scene->bounding_coords, gmeta->bounding_coords,
+        sizeof (scene->bounding_coords));
+    scene->nbands = xml_metadata.nbands;
+
+    if (xml_metadata.nbands > 0)
+    {
+        entry->band = calloc (xml_metadata.nbands,
+            sizeof (Espa_catalog_band_t));
+        if (entry->band == NULL)
+        {
+            free_metadata (&xml_metadata);
+            return (false);
+        }
+    }
+
+    /* Copy the bands from their compact copies, which the parse indexed */
+    hot = get_band_hot (&xml_metadata, 0);
+    for (i = 0; hot != NULL && i < xml_metadata.nbands; i++)
+    {
+        band = &entry->band[i];
+        copy_catalog_string (band->product, get_band_hot_string (
+            &xml_metadata, hot[i].key[ESPA_BAND_KEY_PRODUCT]),
+            sizeof (band->product));
+        copy_catalog_string (band->name, get_band_hot_string (
+            &xml_metadata, hot[i].key[ESPA_BAND_KEY_NAME]),
+            sizeof (band->name));
+        copy_catalog_string (band->category, get_band_hot_string (
+            &xml_metadata, hot[i].key[ESPA_BAND_KEY_CATEGORY]),
+            sizeof (band->category));
+        band->data_type = hot[i].data_type;
+        band->nlines = hot[i].nlines;
+        band->nsamps = hot[i].nsamps;
+        band->pixel_size[0] = hot[i].pixel_size[0];
+        band->pixel_size[1] = hot[i].pixel_size[1];
+    }
+    if (hot == NULL && xml_metadata.nbands > 0)
+    {
+        free (entry->band);
+        entry->band = NULL;
+        free_metadata (&xml_metadata);
+        return (false);
+    }
+
+    free_metadata (&xml_metadata);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE: parse_catalog_worker
+
+PURPOSE: Thread parsing the XML files of the entries until there are none
+left.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+  1. An entry whose XML file can't be parsed is left out of the catalog.
+*****************************************************************************/
+static void *parse_catalog_worker
+(
+    void *arg                     /* I: Catalog_work_t being done */
+)
+{
+    char FUNC_NAME[] = "parse_catalog_worker";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Catalog_work_t *work = arg;   /* work shared by the threads */
+    Catalog_entry_t *entry = NULL;  /* entry being parsed */
+    int next;                     /* index of the entry being parsed */
+
+    while (true)
+    {
+        pthread_mutex_lock (&work->lock);
+        next = work->next++;
+        pthread_mutex_unlock (&work->lock);
+        if (next >= work->nentries)
+            break;
+
+        entry = work->entry[next];
+        if (!parse_catalog_entry (entry))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Skipping %s which couldn't "
+                "be parsed", entry->xml_file);
+            error_handler (false, FUNC_NAME, errmsg);
+            entry->keep = false;
+        }
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE: parse_catalog_entries
+
+PURPOSE: Parses the XML files of the entries in parallel.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error starting the threads
+SUCCESS      The XML files were parsed; the entries which couldn't be parsed
+             are no longer kept
+
+NOTES:
+*****************************************************************************/
+static int parse_catalog_entries
+(
+    Catalog_entry_t **entry,      /* I/O: entries to be parsed */
+    int nentries,                 /* I: number of entries to be parsed */
+    int nthreads                  /* I: number of threads */
+)
+{
+    char FUNC_NAME[] = "parse_catalog_entries";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    pthread_t thread[ESPA_CATALOG_MAX_THREADS];   /* parsing threads */
+    Catalog_work_t work;          /* work shared by the threads */
+    int nstarted;                 /* number of threads started */
+    int i;                        /* looping variable for the threads */
+
+    if (nthreads > ESPA_CATALOG_MAX_THREADS)
+        nthreads = ESPA_CATALOG_MAX_THREADS;
+    if (nthreads > nentries)
+        nthreads = nentries;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    work.entry = entry;
+    work.nentries = nentries;
+    work.next = 0;
+    pthread_mutex_init (&work.lock, NULL);
+
+    /* Initialize libxml2 before the threads use it */
+    init_espa_xml ();
+
+    for (nstarted = 0; nstarted < nthreads - 1; nstarted++)
+    {
+        if (pthread_create (&thread[nstarted], NULL, parse_catalog_worker,
+            &work) != 0)
+            break;
+    }
+    if (nstarted == 0 && nthreads > 1)
+    {
+        sprintf (errmsg, "Starting the parsing threads; parsing the XML "
+            "files serially");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    /* This thread parses too */
+    parse_catalog_worker (&work);
+    for (i = 0; i < nstarted; i++)
+        pthread_join (thread[i], NULL);
+    pthread_mutex_destroy (&work.lock);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: compare_entry_names
+
+PURPOSE: qsort comparison of two entries by XML filename.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+< 0, 0, > 0  The first entry sorts before, with or after the second
+
+NOTES:
+  1. Entries with the same name are ordered with the one from the previous
+     catalog first.
+*****************************************************************************/
+static int compare_entry_names
+(
+    const void *a,                /* I: first Catalog_entry_t */
+    const void *b                 /* I: second Catalog_entry_t */
+)
+{
+    const Catalog_entry_t *ea = a;
+    const Catalog_entry_t *eb = b;
+    int cmp = strcmp (ea->xml_file, eb->xml_file);
+
+    if (cmp != 0)
+        return (cmp);
+    return ((ea->old_scene < eb->old_scene) - (ea->old_scene > eb->old_scene));
+}
+
+
+/******************************************************************************
+MODULE: compare_entry_dates
+
+PURPOSE: qsort comparison of two entry pointers by acquisition date and XML
+filename, which is the order of the scene records.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+< 0, 0, > 0  The first entry sorts before, with or after the second
+
+NOTES:
+*****************************************************************************/
+static int compare_entry_dates
+(
+    const void *a,                /* I: first Catalog_entry_t pointer */
+    const void *b                 /* I: second Catalog_entry_t pointer */
+)
+{
+    const Catalog_entry_t *ea = *(Catalog_entry_t * const *) a;
+    const Catalog_entry_t *eb = *(Catalog_entry_t * const *) b;
+    int cmp = strcmp (ea->scene.acquisition_date, eb->scene.acquisition_date);
+
+    if (cmp != 0)
+        return (cmp);
+    return (strcmp (ea->xml_file, eb->xml_file));
+}
+
+
+/******************************************************************************
+MODULE: compare_grid_keys
+
+PURPOSE: qsort comparison of two path/row or tile index keys.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+< 0, 0, > 0  The first key sorts before, with or after the second
+
+NOTES:
+*****************************************************************************/
+static int compare_grid_keys
+(
+    const void *a,                /* I: first Catalog_grid_key_t */
+    const void *b                 /* I: second Catalog_grid_key_t */
+)
+{
+    const Catalog_grid_key_t *ka = a;
+    const Catalog_grid_key_t *kb = b;
+
+    if (ka->key1 != kb->key1)
+        return (ka->key1 < kb->key1 ? -1 : 1);
+    if (ka->key2 != kb->key2)
+        return (ka->key2 < kb->key2 ? -1 : 1);
+    return ((ka->index > kb->index) - (ka->index < kb->index));
+}
+
+
+/******************************************************************************
+MODULE: compare_product_keys
+
+PURPOSE: qsort comparison of two band product index keys.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+< 0, 0, > 0  The first key sorts before, with or after the second
+
+NOTES:
+*****************************************************************************/
+static int compare_product_keys
+(
+    const void *a,                /* I: first Catalog_product_key_t */
+    const void *b                 /* I: second Catalog_product_key_t */
+)
+{
+    const Catalog_product_key_t *ka = a;
+    const Catalog_product_key_t *kb = b;
+    int cmp = strcmp (ka->product, kb->product);
+
+    if (cmp != 0)
+        return (cmp);
+    return ((ka->index > kb->index) - (ka->index < kb->index));
+}
+
+
+/******************************************************************************
+MODULE: write_catalog_padding
+
+PURPOSE: Pads the catalog file to the next 8-byte boundary.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The padding was written
+false        Error writing the padding
+
+NOTES:
+*****************************************************************************/
+static bool write_catalog_padding
+(
+    FILE *fptr,                   /* I: catalog file being written */
+    uint64_t *offset              /* I/O: offset in the catalog file */
+)
+{
+    static const char zeros[8] = {0};   /* padding bytes */
+    size_t npad = (8 - (*offset & 7)) & 7;  /* number of padding bytes */
+
+    *offset += npad;
+    return (npad == 0 || fwrite (zeros, 1, npad, fptr) == npad);
+}
+
+
+/******************************************************************************
+MODULE: write_catalog
+
+PURPOSE: Writes the scene records of the kept entries, with their band
+records and the indexes, to the catalog file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the indexes or writing the catalog
+SUCCESS      The catalog was written
+
+NOTES:
+  1. The entries are in scene record order.
+  2. The catalog is written to a temporary file which is renamed to the
+     catalog file once it's complete.
+*****************************************************************************/
+static int write_catalog
+(
+    char *catalog_file,           /* I: name of the catalog file */
+    Catalog_entry_t **entry,      /* I: kept entries in scene order */
+    int nscenes                   /* I: number of kept entries */
+)
+{
+    char FUNC_NAME[] = "write_catalog";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char tmp_file[PATH_MAX];      /* temporary catalog file */
+    Espa_catalog_header_t header; /* header of the catalog */
+    Espa_catalog_scene_t scene;   /* scene record being written */
+    Espa_catalog_band_t band;     /* band record being written */
+    Catalog_grid_key_t *grid = NULL;  /* path/row and tile index keys */
+    Catalog_product_key_t *product = NULL;  /* band product index keys */
+    int32_t *index = NULL;        /* index being written */
+    int64_t nbands = 0;           /* number of band records */
+    uint64_t strings_size = 0;    /* size of the XML filenames */
+    uint64_t offset;              /* offset in the catalog file */
+    FILE *fptr = NULL;            /* catalog file pointer */
+    bool ok = true;               /* were the sections written */
+    int b, i;                     /* looping variables */
+
+    for (i = 0; i < nscenes; i++)
+    {
+        nbands += entry[i]->scene.nbands;
+        strings_size += strlen (entry[i]->xml_file) + 1;
+    }
+    if (nbands > INT_MAX)
+    {
+        sprintf (errmsg, "Too many bands to be cataloged");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Sort the indexes */
+    grid = malloc ((nscenes > 0 ? nscenes : 1) * sizeof (Catalog_grid_key_t));
+    product = malloc ((nbands > 0 ? nbands : 1)
+        * sizeof (Catalog_product_key_t));
+    index = malloc ((nbands > nscenes ? nbands : nscenes > 0 ? nscenes : 1)
+        * sizeof (int32_t));
+    if (grid == NULL || product == NULL || index == NULL)
+    {
+        free (grid);
+        free (product);
+        free (index);
+        sprintf (errmsg, "Allocating the catalog indexes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the header */
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, ESPA_CATALOG_MAGIC, sizeof (header.magic));
+    header.version = ESPA_CATALOG_VERSION;
+    header.scene_size = sizeof (Espa_catalog_scene_t);
+    header.band_size = sizeof (Espa_catalog_band_t);
+    header.nscenes = nscenes;
+    header.nbands = nbands;
+    header.strings_size = strings_size;
+    offset = sizeof (header);
+    header.scene_offset = offset;
+    offset += nscenes * sizeof (Espa_catalog_scene_t);
+    header.band_offset = offset;
+    offset += nbands * sizeof (Espa_catalog_band_t);
+    header.pathrow_offset = offset;
+    offset += (nscenes * sizeof (int32_t) + 7) & ~(uint64_t) 7;
+    header.tile_offset = offset;
+    offset += (nscenes * sizeof (int32_t) + 7) & ~(uint64_t) 7;
+    header.product_offset = offset;
+    offset += (nbands * sizeof (int32_t) + 7) & ~(uint64_t) 7;
+    header.strings_offset = offset;
+
+    snprintf (tmp_file, sizeof (tmp_file), "%s.%ld.tmp", catalog_file,
+        (long) getpid ());
+    fptr = fopen (tmp_file, "wb");
+    if (fptr == NULL)
+    {
+        free (grid);
+        free (product);
+        free (index);
+        sprintf (errmsg, "Opening the temporary catalog %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ok = (fwrite (&header, sizeof (header), 1, fptr) == 1);
+
+    /* Scene records */
+    nbands = 0;
+    strings_size = 0;
+    for (i = 0; ok && i < nscenes; i++)
+    {
+        scene = entry[i]->scene;
+        scene.first_band = nbands;
+        scene.xml_file = strings_size;
+        ok = (fwrite (&scene, sizeof (scene), 1, fptr) == 1);
+        nbands += scene.nbands;
+        strings_size += strlen (entry[i]->xml_file) + 1;
+    }
+
+    /* Band records */
+    nbands = 0;
+    for (i = 0; ok && i < nscenes; i++)
+    {
+        for (b = 0; ok && b < entry[i]->scene.nbands; b++)
+        {
+            band = entry[i]->band[b];
+            band.scene = i;
+            ok = (fwrite (&band, sizeof (band), 1, fptr) == 1);
+            product[nbands].product = entry[i]->band[b].product;
+            product[nbands].index = nbands;
+            nbands++;
+        }
+    }
+
+    /* Path/row index */
+    offset = header.pathrow_offset;
+    for (i = 0; i < nscenes; i++)
+    {
+        grid[i].key1 = entry[i]->scene.wrs_path;
+        grid[i].key2 = entry[i]->scene.wrs_row;
+        grid[i].index = i;
+    }
+    qsort (grid, nscenes, sizeof (Catalog_grid_key_t), compare_grid_keys);
+    for (i = 0; i < nscenes; i++)
+        index[i] = grid[i].index;
+    if (ok)
+    {
+        ok = (fwrite (index, sizeof (int32_t), nscenes, fptr)
+            == (size_t) nscenes);
+        offset += nscenes * sizeof (int32_t);
+        ok = ok && write_catalog_padding (fptr, &offset);
+    }
+
+    /* Tile index */
+    for (i = 0; i < nscenes; i++)
+    {
+        grid[i].key1 = entry[i]->scene.htile;
+        grid[i].key2 = entry[i]->scene.vtile;
+        grid[i].index = i;
+    }
+    qsort (grid, nscenes, sizeof (Catalog_grid_key_t), compare_grid_keys);
+    for (i = 0; i < nscenes; i++)
+        index[i] = grid[i].index;
+    if (ok)
+    {
+        ok = (fwrite (index, sizeof (int32_t), nscenes, fptr)
+            == (size_t) nscenes);
+        offset += nscenes * sizeof (int32_t);
+        ok = ok && write_catalog_padding (fptr, &offset);
+    }
+
+    /* Band product index */
+    qsort (product, nbands, sizeof (Catalog_product_key_t),
+        compare_product_keys);
+    for (i = 0; i < nbands; i++)
+        index[i] = product[i].index;
+    if (ok)
+    {
+        ok = (fwrite (index, sizeof (int32_t), nbands, fptr)
+            == (size_t) nbands);
+        offset += nbands * sizeof (int32_t);
+        ok = ok && write_catalog_padding (fptr, &offset);
+    }
+    free (grid);
+    free (product);
+    free (index);
+
+    /* XML filenames */
+    for (i = 0; ok && i < nscenes; i++)
+    {
+        ok = (fwrite (entry[i]->xml_file, strlen (entry[i]->xml_file) + 1, 1,
+            fptr) == 1);
+    }
+
+    if (fclose (fptr) != 0 || !ok)
+    {
+        unlink (tmp_file);
+        sprintf (errmsg, "Writing the temporary catalog %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (rename (tmp_file, catalog_file) != 0)
+    {
+        unlink (tmp_file);
+        sprintf (errmsg, "Renaming the temporary catalog to %s",
+            catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: is_old_catalog
+
+PURPOSE: Determines if the catalog file exists, and if it has a layout which
+can't be updated.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The file exists but isn't a catalog
+SUCCESS      *exists and *old are set
+
+NOTES:
+*****************************************************************************/
+static int is_old_catalog
+(
+    char *catalog_file,           /* I: name of the catalog file */
+    bool *exists,                 /* O: does the catalog file exist */
+    bool *old                     /* O: does it have a previous layout */
+)
+{
+    char FUNC_NAME[] = "is_old_catalog";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Espa_catalog_header_t header; /* header of the catalog */
+    FILE *fptr = NULL;            /* catalog file pointer */
+    bool read_ok;                 /* was the header read */
+
+    *exists = false;
+    *old = false;
+    fptr = fopen (catalog_file, "rb");
+    if (fptr == NULL)
+        return (SUCCESS);
+    *exists = true;
+    read_ok = (fread (&header, sizeof (header), 1, fptr) == 1);
+    fclose (fptr);
+
+    if (!read_ok || memcmp (header.magic, ESPA_CATALOG_MAGIC,
+        sizeof (header.magic)))
+    {
+        sprintf (errmsg, "%s exists and is not an ESPA catalog",
+            catalog_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    *old = (header.version != ESPA_CATALOG_VERSION ||
+        header.scene_size != (int32_t) sizeof (Espa_catalog_scene_t) ||
+        header.band_size != (int32_t) sizeof (Espa_catalog_band_t));
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: update_espa_catalog
+
+PURPOSE: Creates or updates the catalog with the XML files.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the previous catalog or writing the catalog
+SUCCESS      The catalog was written
+
+NOTES:
+  1. The updated catalog holds the XML files already in the catalog which
+     still exist, and the XML files passed in.  An XML file is parsed if it
+     isn't in the catalog yet, or its size or modification time changed.
+  2. The XML filenames are cataloged as they are passed in, so the same file
+     should always be passed with the same name (e.g. the absolute path).
+  3. XML files which don't exist or can't be parsed are reported and left out
+     of the catalog.
+  4. A catalog written by a different version of the library is rebuilt from
+     scratch, since its XML filenames can't be read.
+*****************************************************************************/
+int update_espa_catalog
+(
+    char *catalog_file,           /* I: name of the catalog file; created if
+                                        it doesn't exist */
+    int nxml_files,               /* I: number of XML files to be added */
+    char **xml_files,             /* I: XML files to be added or updated */
+    int nthreads,                 /* I: number of threads parsing the XML
+                                        files */
+    Espa_catalog_counts_t *counts /* O: what was done; may be NULL */
+)
+{
+    char FUNC_NAME[] = "update_espa_catalog";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Espa_catalog_t old_catalog;   /* previous catalog */
+    Espa_catalog_counts_t my_counts;  /* counts if the caller has none */
+    Catalog_entry_t *entry = NULL;    /* entries of all the XML files */
+    Catalog_entry_t **work = NULL;    /* entries to be parsed, then the kept
+                                         entries in scene order */
+    Catalog_entry_t *e = NULL;    /* current entry */
+    struct stat xml_stat;         /* status of an XML file */
+    bool exists, old;             /* state of the previous catalog */
+    int nentries = 0;             /* number of entries */
+    int nwork = 0;                /* number of entries in work */
+    int status = SUCCESS;         /* return status */
+    int i, j;                     /* looping variables */
+
+    if (counts == NULL)
+        counts = &my_counts;
+    memset (counts, 0, sizeof (Espa_catalog_counts_t));
+    memset (&old_catalog, 0, sizeof (old_catalog));
+
+    /* Open the previous catalog */
+    if (is_old_catalog (catalog_file, &exists, &old) != SUCCESS)
+        return (ERROR);
+    if (old)
+    {
+        sprintf (errmsg, "Rebuilding the catalog %s, which was written by a "
+            "different version", catalog_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    else if (exists && open_espa_catalog (catalog_file, &old_catalog)
+        != SUCCESS)
+        return (ERROR);
+
+    /* Gather the cataloged and new XML files, in name order with the
+       cataloged entry first */
+    entry = calloc (old_catalog.nscenes + nxml_files + 1,
+        sizeof (Catalog_entry_t));
+    work = calloc (old_catalog.nscenes + nxml_files + 1,
+        sizeof (Catalog_entry_t *));
+    if (entry == NULL || work == NULL)
+    {
+        free (entry);
+        free (work);
+        close_espa_catalog (&old_catalog);
+        sprintf (errmsg, "Allocating the catalog entries");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < old_catalog.nscenes; i++)
+    {
+        entry[nentries].xml_file = (char *) get_catalog_xml_file (
+            &old_catalog, i);
+        entry[nentries++].old_scene = i;
+    }
+    for (i = 0; i < nxml_files; i++)
+    {
+        entry[nentries].xml_file = xml_files[i];
+        entry[nentries++].old_scene = -1;
+    }
+    qsort (entry, nentries, sizeof (Catalog_entry_t), compare_entry_names);
+
+    /* Decide which XML files are kept and which need to be parsed */
+    for (i = 0; i < nentries; i++)
+    {
+        e = &entry[i];
+        if (e->xml_file[0] == '\0' ||
+            (i > 0 && !strcmp (e->xml_file, entry[i-1].xml_file)))
+            continue;
+
+        if (stat (e->xml_file, &xml_stat) != 0 || !S_ISREG (xml_stat.st_mode))
+        {
+            if (e->old_scene >= 0)
+                counts->nremoved++;
+            else
+            {
+                snprintf (errmsg, sizeof (errmsg), "Skipping %s which is "
+                    "not a file", e->xml_file);
+                error_handler (false, FUNC_NAME, errmsg);
+                counts->nfailed++;
+            }
+            continue;
+        }
+
+        e->keep = true;
+        if (e->old_scene >= 0)
+        {
+            e->scene = old_catalog.scene[e->old_scene];
+            if (e->scene.xml_size == xml_stat.st_size &&
+                e->scene.xml_mtime_sec == xml_stat.st_mtim.tv_sec &&
+                e->scene.xml_mtime_nsec == xml_stat.st_mtim.tv_nsec &&
+                e->scene.first_band >= 0 && e->scene.nbands >= 0 &&
+                e->scene.first_band <= old_catalog.nbands - e->scene.nbands)
+            {
+                e->band = (Espa_catalog_band_t *)
+                    &old_catalog.band[e->scene.first_band];
+                counts->nreused++;
+                continue;
+            }
+        }
+
+        memset (&e->scene, 0, sizeof (e->scene));
+        e->scene.xml_size = xml_stat.st_size;
+        e->scene.xml_mtime_sec = xml_stat.st_mtim.tv_sec;
+        e->scene.xml_mtime_nsec = xml_stat.st_mtim.tv_nsec;
+        e->parse = true;
+        work[nwork++] = e;
+    }
+
+    /* Parse the new and changed XML files */
+    status = parse_catalog_entries (work, nwork, nthreads);
+    for (i = 0; i < nwork; i++)
+    {
+        if (work[i]->keep)
+            counts->nparsed++;
+        else
+            counts->nfailed++;
+    }
+
+    /* Write the kept entries in scene order */
+    if (status == SUCCESS)
+    {
+        for (i = 0, j = 0; i < nentries; i++)
+        {
+            if (entry[i].keep)
+                work[j++] = &entry[i];
+        }
+        counts->nscenes = j;
+        qsort (work, j, sizeof (Catalog_entry_t *), compare_entry_dates);
+        status = write_catalog (catalog_file, work, j);
+    }
+
+    for (i = 0; i < nentries; i++)
+    {
+        if (entry[i].parse)
+            free (entry[i].band);
+    }
+    free (entry);
+    free (work);
+    close_espa_catalog (&old_catalog);
+
+    return (status);
+}
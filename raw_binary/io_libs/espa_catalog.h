@@ -0,0 +1,195 @@
+/*****************************************************************************
+FILE: espa_catalog.h
+
+PURPOSE: Contains defines, structures and prototypes for the catalog of ESPA
+products, which indexes the global metadata and a summary of the bands of
+many XML metadata files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The catalog is a single file with a header followed by the scene
+     records (sorted by acquisition date and XML filename), the band records
+     (grouped by scene), the path/row, tile and band product indexes, and
+     the XML filenames.  Each section starts on an 8-byte boundary.
+  2. The records and indexes are stored in the native byte order, so the
+     catalog is memory mapped as-is by open_espa_catalog.  The layout is also
+     read by py_modules/espa_catalog.py, so any change to it must change
+     ESPA_CATALOG_VERSION and be made there too.
+*****************************************************************************/
+
+#ifndef ESPA_CATALOG_H
+#define ESPA_CATALOG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Identifies the catalog files and the version of their layout */
+#define ESPA_CATALOG_MAGIC "ESPACATL"
+#define ESPA_CATALOG_VERSION 1
+
+/* Size of the strings stored in the catalog records; longer values are
+   truncated */
+#define ESPA_CATALOG_STR_SIZE 64
+#define ESPA_CATALOG_DATE_SIZE 16
+#define ESPA_CATALOG_CATEGORY_SIZE 16
+
+/* Maximum number of threads parsing the XML files */
+#define ESPA_CATALOG_MAX_THREADS 64
+
+/* Header of the catalog file */
+typedef struct
+{
+    char magic[8];                /* ESPA_CATALOG_MAGIC */
+    int32_t version;              /* ESPA_CATALOG_VERSION */
+    int32_t scene_size;           /* size of Espa_catalog_scene_t */
+    int32_t band_size;            /* size of Espa_catalog_band_t */
+    int32_t reserved;             /* unused; 0 */
+    int64_t nscenes;              /* number of scene records */
+    int64_t nbands;               /* number of band records */
+    uint64_t strings_size;        /* size of the XML filenames section */
+    uint64_t scene_offset;        /* offset of the scene records */
+    uint64_t band_offset;         /* offset of the band records */
+    uint64_t pathrow_offset;      /* offset of the path/row index */
+    uint64_t tile_offset;         /* offset of the tile index */
+    uint64_t product_offset;      /* offset of the band product index */
+    uint64_t strings_offset;      /* offset of the XML filenames */
+} Espa_catalog_header_t;
+
+/* Summary of the global metadata of one XML file */
+typedef struct
+{
+    int64_t xml_size;             /* size of the XML file */
+    int64_t xml_mtime_sec;        /* modification time of the XML file */
+    int64_t xml_mtime_nsec;       /* nanoseconds of the modification time */
+    uint64_t xml_file;            /* offset of the XML filename in the XML
+                                     filenames section */
+    char satellite[ESPA_CATALOG_STR_SIZE];   /* satellite */
+    char instrument[ESPA_CATALOG_STR_SIZE];  /* instrument */
+    char acquisition_date[ESPA_CATALOG_DATE_SIZE];  /* yyyy-mm-dd */
+    char product_id[ESPA_CATALOG_STR_SIZE];  /* product ID */
+    int32_t wrs_path;             /* WRS path; ESPA_INT_META_FILL if none */
+    int32_t wrs_row;              /* WRS row; ESPA_INT_META_FILL if none */
+    int32_t htile;                /* MODIS horizontal tile; ESPA_INT_META_FILL
+                                     if none */
+    int32_t vtile;                /* MODIS vertical tile; ESPA_INT_META_FILL
+                                     if none */
+    double bounding_coords[4];    /* geographic west, east, north, south */
+    int32_t first_band;           /* index of the first band record */
+    int32_t nbands;               /* number of band records */
+} Espa_catalog_scene_t;
+
+/* Summary of one band of an XML file */
+typedef struct
+{
+    char product[ESPA_CATALOG_STR_SIZE];     /* product type */
+    char name[ESPA_CATALOG_STR_SIZE];        /* band name */
+    char category[ESPA_CATALOG_CATEGORY_SIZE];  /* category type */
+    int32_t scene;                /* index of the scene record */
+    int32_t data_type;            /* enum Espa_data_type of the band */
+    int32_t nlines;               /* number of lines in the band */
+    int32_t nsamps;               /* number of samples in the band */
+    double pixel_size[2];         /* pixel size x, y */
+} Espa_catalog_band_t;
+
+/* Catalog opened by open_espa_catalog */
+typedef struct
+{
+    void *map;                    /* mapping of the catalog file */
+    size_t map_size;              /* size of the mapping */
+    int nscenes;                  /* number of scene records */
+    int nbands;                   /* number of band records */
+    const Espa_catalog_scene_t *scene;  /* scene records */
+    const Espa_catalog_band_t *band;    /* band records */
+    const int32_t *by_pathrow;    /* scene indexes sorted by WRS path and
+                                     row */
+    const int32_t *by_tile;       /* scene indexes sorted by MODIS htile and
+                                     vtile */
+    const int32_t *by_product;    /* band indexes sorted by band product */
+    const char *strings;          /* XML filenames */
+    uint64_t strings_size;        /* size of the XML filenames */
+} Espa_catalog_t;
+
+/* Scenes to be found by query_espa_catalog; NULL strings and
+   ESPA_INT_META_FILL numbers match any scene */
+typedef struct
+{
+    char *satellite;              /* satellite */
+    char *instrument;             /* instrument */
+    char *start_date;             /* first acquisition date (yyyy-mm-dd) */
+    char *end_date;               /* last acquisition date (yyyy-mm-dd) */
+    int wrs_path;                 /* WRS path */
+    int wrs_row;                  /* WRS row */
+    int htile;                    /* MODIS horizontal tile */
+    int vtile;                    /* MODIS vertical tile */
+    char *product;                /* product of at least one band */
+    bool use_bbox;                /* must the scene overlap bbox? */
+    double bbox[4];               /* geographic west, east, north, south
+                                     the bounding coordinates of the scene
+                                     have to overlap */
+} Espa_catalog_query_t;
+
+/* Counts reported by update_espa_catalog */
+typedef struct
+{
+    int nscenes;                  /* scenes in the updated catalog */
+    int nparsed;                  /* XML files parsed */
+    int nreused;                  /* scenes kept from the previous catalog */
+    int nremoved;                 /* scenes removed since their XML file no
+                                     longer exists */
+    int nfailed;                  /* XML files which couldn't be parsed */
+} Espa_catalog_counts_t;
+
+/* Prototypes */
+void init_catalog_query
+(
+    Espa_catalog_query_t *query   /* O: query matching any scene */
+);
+
+int open_espa_catalog
+(
+    char *catalog_file,           /* I: name of the catalog file */
+    Espa_catalog_t *catalog       /* O: opened catalog */
+);
+
+void close_espa_catalog
+(
+    Espa_catalog_t *catalog       /* I/O: catalog to be closed */
+);
+
+const char *get_catalog_xml_file
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    int scene                     /* I: index of the scene record */
+);
+
+int query_espa_catalog
+(
+    const Espa_catalog_t *catalog, /* I: opened catalog */
+    const Espa_catalog_query_t *query,  /* I: scenes to be found */
+    int **scenes,                 /* O: indexes of the matching scene
+                                        records in catalog order; must be
+                                        freed by the caller */
+    int *nscenes                  /* O: number of matching scenes */
+);
+
+int update_espa_catalog
+(
+    char *catalog_file,           /* I: name of the catalog file; created if
+                                        it doesn't exist */
+    int nxml_files,               /* I: number of XML files to be added */
+    char **xml_files,             /* I: XML files to be added or updated */
+    int nthreads,                 /* I: number of threads parsing the XML
+                                        files */
+    Espa_catalog_counts_t *counts /* O: what was done; may be NULL */
+);
+
+#endif
@@ -15,388 +15,1806 @@ NOTES:
      The schema for the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
   2. This code relies on the libxml2 library developed for the Gnome project.
+  3. The XML library and the compiled schema are shared by all threads.
+     init_espa_xml and load_espa_schema set them up under espa_xml_lock, and
+     cleanup_espa_xml tears them down once no thread uses them.  The
+     compiled schema is only read while validating, so each validation just
+     needs a validation context of its own.
 *****************************************************************************/
+#include <pthread.h>
 #include <sys/stat.h>
 #include "espa_metadata.h"
+#include "metadata_cache.h"
+#include "espa_task.h"
+#include "espa_profile.h"
+
+/* Compiled ESPA schema, cached for the life of the process */
+static xmlSchemaPtr espa_schema = NULL;
+
+/* Has the XML library been initialized by init_espa_xml? */
+static bool espa_xml_initialized = false;
+
+/* Lock for the initialization of the XML library and the schema cache */
+static pthread_mutex_t espa_xml_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* XML files validated by validate_xml_files */
+typedef struct
+{
+    char **meta_file;             /* XML files to be validated */
+    int *status;                  /* status of the validation of each file */
+    xmlSchemaValidCtxtPtr *valid_ctxt;  /* validation context of each
+                                           runner; NULL until it's used */
+} Espa_validate_work_t;
+
+/******************************************************************************
+MODULE:  init_espa_xml
+
+PURPOSE:  Initializes the XML library for use by any number of threads.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. libxml2 needs to be initialized before threads use it at the same time.
+     The parsing and validation functions of this library call this
+     themselves, so applications only need to call it if they use libxml2
+     directly from several threads.
+  2. Calling it again is harmless; the XML library is initialized again
+     after cleanup_espa_xml.
+******************************************************************************/
+void init_espa_xml ()
+{
+    pthread_mutex_lock (&espa_xml_lock);
+    if (!espa_xml_initialized)
+    {
+        xmlInitParser ();
+        xmlLineNumbersDefault (1);
+        espa_xml_initialized = true;
+    }
+    pthread_mutex_unlock (&espa_xml_lock);
+}
+
+
+/******************************************************************************
+MODULE:  cleanup_espa_xml
+
+PURPOSE:  Frees the cached ESPA schema and cleans up the XML library.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. This is the teardown of init_espa_xml, to be called once at the end of
+     the application after all the threads are done with the XML files.
+  2. The XML library cleanup also frees the built-in schema types used by the
+     cached schema, which is why it's only done here rather than after each
+     validation or parse.
+******************************************************************************/
+void cleanup_espa_xml ()
+{
+    free_espa_schema ();
+
+    pthread_mutex_lock (&espa_xml_lock);
+    xmlSchemaCleanupTypes();
+    xmlCleanupParser();   /* cleanup the XML library */
+    espa_xml_initialized = false;
+    pthread_mutex_unlock (&espa_xml_lock);
+}
+
+/******************************************************************************
+MODULE:  load_espa_schema
+
+PURPOSE:  Parses and compiles the ESPA schema, caching it for use by all
+subsequent calls to validate_xml_file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the schema
+SUCCESS         Schema was parsed and cached (or was already cached)
+
+NOTES:
+  1. If schema_file is NULL, the schema specified by the ESPA_SCHEMA
+     environment variable is used.  If that isn't defined, then the
+     LOCAL_ESPA_SCHEMA file is used.  If that doesn't exist, then the schema
+     is retrieved from ESPA_SCHEMA on the ESPA http site, and a warning is
+     written since this requires network access.
+  2. validate_xml_file calls this automatically the first time it's used.
+     Long-running applications which embed this library can call it once at
+     startup so the schema isn't compiled while processing the first scene.
+  3. The schema stays cached until free_espa_schema or cleanup_espa_xml is
+     called.
+******************************************************************************/
+int load_espa_schema
+(
+    char *schema_file       /* I: name of schema file or URL to be compiled;
+                                  NULL to use the default locations */
+)
+{
+    char FUNC_NAME[] = "load_espa_schema";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status = SUCCESS;         /* return status */
+    xmlSchemaParserCtxtPtr ctxt = NULL;  /* parser context for the schema */
+    struct stat statbuf;          /* buffer for the file stat function */
+
+    init_espa_xml ();
+    pthread_mutex_lock (&espa_xml_lock);
+    {
+        espa_profile_count_cache (ESPA_PROFILE_CACHE_SCHEMA,
+            espa_schema != NULL);
+        if (espa_schema == NULL)
+        {
+            /* Get the ESPA schema environment variable which specifies the
+               location of the XML schema to be used */
+            if (schema_file == NULL)
+                schema_file = getenv ("ESPA_SCHEMA");
+            if (schema_file == NULL)
+            {  /* ESPA schema environment variable wasn't defined. Try the
+                  version in /usr/local... */
+                schema_file = LOCAL_ESPA_SCHEMA;
+                if (stat (schema_file, &statbuf) == -1)
+                {  /* /usr/local ESPA schema file doesn't exist.  Try the
+                      version on the ESPA http site... */
+                    schema_file = ESPA_SCHEMA;
+                    sprintf (errmsg, "ESPA_SCHEMA environment variable isn't "
+                        "defined and %s doesn't exist.  Retrieving the schema "
+                        "from %s.", LOCAL_ESPA_SCHEMA, ESPA_SCHEMA);
+                    error_handler (false, FUNC_NAME, errmsg);
+                }
+            }
+
+            /* Set up the schema parser and parse the schema file/URL */
+            ctxt = xmlSchemaNewParserCtxt (schema_file);
+            xmlSchemaSetParserErrors (ctxt,
+                (xmlSchemaValidityErrorFunc) fprintf,
+                (xmlSchemaValidityWarningFunc) fprintf, stderr);
+            espa_schema = xmlSchemaParse (ctxt);
+
+            /* Free the schema parser context */
+            xmlSchemaFreeParserCtxt (ctxt);
+
+            if (espa_schema == NULL)
+            {
+                sprintf (errmsg, "Unable to parse the schema: %s",
+                    schema_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+        }
+    }
+    pthread_mutex_unlock (&espa_xml_lock);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  free_espa_schema
+
+PURPOSE:  Frees the cached ESPA schema.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. No thread may be validating with the schema.  The next validation
+     compiles the schema again.
+******************************************************************************/
+void free_espa_schema ()
+{
+    pthread_mutex_lock (&espa_xml_lock);
+    if (espa_schema != NULL)
+    {
+        xmlSchemaFree (espa_schema);
+        espa_schema = NULL;
+    }
+    pthread_mutex_unlock (&espa_xml_lock);
+}
+
+
+/******************************************************************************
+MODULE:  validate_xml_with_ctxt
+
+PURPOSE:  Validates the specified XML file with a validation context of the
+cached schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           XML does not validate against the schema
+SUCCESS         XML validates
+
+NOTES:
+  1. See validate_xml_file for the files which aren't validated again.
+******************************************************************************/
+static int validate_xml_with_ctxt
+(
+    char *meta_file,          /* I: name of metadata file to be validated */
+    xmlSchemaValidCtxtPtr valid_ctxt  /* I: validation context of the
+                                            schema */
+)
+{
+    char FUNC_NAME[] = "validate_xml_with_ctxt";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    int status;                   /* return status */
+    xmlDocPtr doc = NULL;         /* resulting document tree */
+
+    /* Skip the validation of XML written by this library */
+    if (is_metadata_stamped (meta_file))
+    {
+        if (getenv ("ESPA_VERBOSE") != NULL)
+            printf ("%s: %s is unchanged since it was written by this "
+                "library; skipping the schema validation\n", FUNC_NAME,
+                meta_file);
+        return (SUCCESS);
+    }
+
+    /* Load the XML file and parse it to the document tree */
+    doc = xmlReadFile (meta_file, NULL, 0);
+    if (doc == NULL)
+    {
+        sprintf (errmsg, "Could not parse %s", meta_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate the XML metadata against the schema */
+    status = xmlSchemaValidateDoc (valid_ctxt, doc);
+    xmlFreeDoc (doc);
+
+    if (status > 0)
+    {
+        sprintf (errmsg, "%s fails to validate", meta_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    else if (status != 0)
+    {
+        sprintf (errmsg, "%s validation generated an internal error",
+            meta_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  new_espa_valid_ctxt
+
+PURPOSE:  Compiles the schema unless it's already cached, and creates a
+validation context for it.
+
+RETURN VALUE:
+Type = xmlSchemaValidCtxtPtr
+Value           Description
+-----           -----------
+NULL            Error compiling the schema or creating the context
+other           Validation context, to be freed with xmlSchemaFreeValidCtxt
+
+NOTES:
+******************************************************************************/
+static xmlSchemaValidCtxtPtr new_espa_valid_ctxt ()
+{
+    char FUNC_NAME[] = "new_espa_valid_ctxt";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlSchemaValidCtxtPtr valid_ctxt = NULL;  /* validation context */
+
+    if (load_espa_schema (NULL) != SUCCESS)
+    {
+        sprintf (errmsg, "Possible schema file not found.  ESPA_SCHEMA "
+            "environment variable isn't defined.  The first default schema "
+            "location of %s doesn't exist.  And the second default location of "
+            "%s was used as the last default.", LOCAL_ESPA_SCHEMA, ESPA_SCHEMA);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    valid_ctxt = xmlSchemaNewValidCtxt (espa_schema);
+    if (valid_ctxt == NULL)
+    {
+        sprintf (errmsg, "Creating the schema validation context");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    xmlSchemaSetValidErrors (valid_ctxt, (xmlSchemaValidityErrorFunc) fprintf,
+        (xmlSchemaValidityWarningFunc) fprintf, stderr);
+
+    return (valid_ctxt);
+}
+
+
+/******************************************************************************
+MODULE:  validate_xml_file
+
+PURPOSE:  Validates the specified XML file with the specified schema file/URL.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           XML does not validate against the specified schema
+SUCCESS         XML validates
+
+NOTES:
+  1. The schema is compiled on the first call (see load_espa_schema) and the
+     compiled schema is reused for all later calls.
+  2. If ESPA_XML_VALIDATION is "stamp", XML files which are unchanged since
+     they were written by this version of the library (see
+     is_metadata_stamped) aren't validated again.  A message is printed for
+     each skipped file if ESPA_VERBOSE is set.  All other XML files are
+     fully validated.
+  3. It may be called by several threads at the same time.  Use
+     validate_xml_files to validate many XML files.
+******************************************************************************/
+int validate_xml_file
+(
+    char *meta_file           /* I: name of metadata file to be validated */
+)
+{
+    int status;                   /* return status */
+    xmlSchemaValidCtxtPtr valid_ctxt = NULL;  /* pointer to validate from the
+                                                 schema */
+
+    /* Compile the schema, unless it's already cached */
+    valid_ctxt = new_espa_valid_ctxt ();
+    if (valid_ctxt == NULL)
+        return (ERROR);
+
+    status = validate_xml_with_ctxt (meta_file, valid_ctxt);
+    xmlSchemaFreeValidCtxt (valid_ctxt);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  validate_files_chunk
+
+PURPOSE:  espa_parallel_for chunk function validating a range of the XML
+files with the validation context of the runner.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the validation context
+SUCCESS         The XML files were validated; the status of each one is
+                saved in the work
+
+NOTES:
+******************************************************************************/
+static int validate_files_chunk
+(
+    void *arg,              /* I: XML files validated (Espa_validate_work_t) */
+    int first,              /* I: first file of the chunk */
+    int end,                /* I: file after the last one of the chunk */
+    int runner              /* I: number of the runner */
+)
+{
+    Espa_validate_work_t *work = arg;  /* XML files validated */
+    int i;                  /* looping variable for the files */
+
+    if (work->valid_ctxt[runner] == NULL)
+    {
+        work->valid_ctxt[runner] = new_espa_valid_ctxt ();
+        if (work->valid_ctxt[runner] == NULL)
+            return (ERROR);
+    }
+
+    for (i = first; i < end; i++)
+    {
+        work->status[i] = validate_xml_with_ctxt (work->meta_file[i],
+            work->valid_ctxt[runner]);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  validate_xml_files
+
+PURPOSE:  Validates a list of XML files against the schema, in parallel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory or compiling the schema
+SUCCESS         The XML files were validated; nfailed tells how many of them
+                fail to validate
+
+NOTES:
+  1. The schema is compiled once and shared by the threads, and each thread
+     reuses one validation context for all of its files.
+  2. A file which fails to validate doesn't stop the rest from being
+     validated.  Its status is ERROR in file_status.
+******************************************************************************/
+int validate_xml_files
+(
+    int nfiles,               /* I: number of XML files */
+    char **meta_file,         /* I: names of the XML files to be validated */
+    int nthreads,             /* I: number of threads validating the files */
+    int *file_status,         /* O: status of the validation of each file
+                                    (SUCCESS or ERROR); NULL if not needed */
+    int *nfailed              /* O: number of files failing to validate */
+)
+{
+    char FUNC_NAME[] = "validate_xml_files";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Espa_validate_work_t work;    /* XML files validated */
+    int status;                   /* return status */
+    int i;                        /* looping variable */
+
+    *nfailed = 0;
+    if (nfiles < 1)
+        return (SUCCESS);
+
+    /* Compile the schema before the threads need it */
+    if (load_espa_schema (NULL) != SUCCESS)
+        return (ERROR);
+
+    if (nthreads < 1)
+        nthreads = 1;
+    else if (nthreads > ESPA_TASK_MAX_THREADS)
+        nthreads = ESPA_TASK_MAX_THREADS;
+
+    work.meta_file = meta_file;
+    work.status = calloc (nfiles, sizeof (int));
+    work.valid_ctxt = calloc (nthreads, sizeof (xmlSchemaValidCtxtPtr));
+    if (work.status == NULL || work.valid_ctxt == NULL)
+    {
+        sprintf (errmsg, "Allocating the status of the XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (work.status);
+        free (work.valid_ctxt);
+        return (ERROR);
+    }
+
+    status = espa_parallel_for (0, nfiles, 1, nthreads, validate_files_chunk,
+        &work);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Validating the XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else
+    {
+        for (i = 0; i < nfiles; i++)
+        {
+            if (work.status[i] != SUCCESS)
+                (*nfailed)++;
+            if (file_status != NULL)
+                file_status[i] = work.status[i];
+        }
+    }
+
+    for (i = 0; i < nthreads; i++)
+    {
+        if (work.valid_ctxt[i] != NULL)
+            xmlSchemaFreeValidCtxt (work.valid_ctxt[i]);
+    }
+    free (work.valid_ctxt);
+    free (work.status);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_metadata_struct
+
+PURPOSE:  Initializes the ESPA internal metadata structure, particularly the
+pointers within each sub-structure.  Assigns field values to fill to make it
+easier to detect if the values were parsed from the input metadata file or
+assigned by the user.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void init_metadata_struct
+(
+    Espa_internal_meta_t *internal_meta   /* I: pointer to internal metadata
+                                                structure to be initialized */
+)
+{
+    Espa_global_meta_t *gmeta = &internal_meta->global;
+                                 /* pointer to the global metadata structure */
+
+    /* Initialze the number of bands */
+    internal_meta->nbands = 0;
+    internal_meta->band = NULL;
+    internal_meta->arena = NULL;
+    internal_meta->band_index = NULL;
+    internal_meta->lazy_file = NULL;
+
+    /* Initialize the global metadata values to fill for use by the write
+       metadata routines */
+    strcpy (gmeta->data_provider, ESPA_STRING_META_FILL);
+    strcpy (gmeta->satellite, ESPA_STRING_META_FILL);
+    strcpy (gmeta->instrument, ESPA_STRING_META_FILL);
+    strcpy (gmeta->acquisition_date, ESPA_STRING_META_FILL);
+    strcpy (gmeta->scene_center_time, ESPA_STRING_META_FILL);
+    strcpy (gmeta->level1_production_date, ESPA_STRING_META_FILL);
+    gmeta->solar_zenith = ESPA_FLOAT_META_FILL;
+    gmeta->solar_azimuth = ESPA_FLOAT_META_FILL;
+    strcpy (gmeta->solar_units, ESPA_STRING_META_FILL);
+    gmeta->earth_sun_dist = ESPA_FLOAT_META_FILL;
+    gmeta->wrs_system = ESPA_INT_META_FILL;
+    gmeta->wrs_path = ESPA_INT_META_FILL;
+    gmeta->wrs_row = ESPA_INT_META_FILL;
+    gmeta->htile = ESPA_INT_META_FILL;
+    gmeta->vtile = ESPA_INT_META_FILL;
+    strcpy (gmeta->lpgs_metadata_file, ESPA_STRING_META_FILL);
+    strcpy (gmeta->valid_mask, ESPA_STRING_META_FILL);
+    strcpy (gmeta->product_id, ESPA_STRING_META_FILL);
+    gmeta->ul_corner[0] = gmeta->ul_corner[1] = ESPA_FLOAT_META_FILL;
+    gmeta->lr_corner[0] = gmeta->lr_corner[1] = ESPA_FLOAT_META_FILL;
+    gmeta->bounding_coords[0] = ESPA_FLOAT_META_FILL;
+    gmeta->bounding_coords[1] = ESPA_FLOAT_META_FILL;
+    gmeta->bounding_coords[2] = ESPA_FLOAT_META_FILL;
+    gmeta->bounding_coords[3] = ESPA_FLOAT_META_FILL;
+    gmeta->proj_info.proj_type = ESPA_INT_META_FILL;
+    gmeta->proj_info.datum_type = ESPA_NODATUM;
+    gmeta->orientation_angle = ESPA_FLOAT_META_FILL;
+}
+
+
+/******************************************************************************
+MODULE:  init_band_metadata
+
+PURPOSE: Initializes the band metadata structure.  The nbits, nclass, ncover
+fields are set to 0 and the pointers to NULL.  The other fields are set to
+fill to make it easy to distinguish if they were populated by reading an input
+metadata file or assigned directly.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void init_band_metadata
+(
+    Espa_band_meta_t *bmeta   /* I: pointer to band metadata structure */
+)
+{
+    bmeta->nbits = 0;
+    bmeta->bitmap_description = NULL;
+    bmeta->nclass = 0;
+    bmeta->class_values = NULL;
+    bmeta->ncover = 0;
+    bmeta->percent_cover = NULL;
+    bmeta->arena = NULL;
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+    bmeta->sub_sample.factor = 1;
+    bmeta->sub_sample.nlines = 0;
+    bmeta->sub_sample.nsamps = 0;
+    bmeta->constant.is_constant = false;
+    bmeta->constant.value = 0.0;
+    bmeta->constant.fill_band[0] = '\0';
+    bmeta->derived.is_derived = false;
+    bmeta->derived.expression[0] = '\0';
+    bmeta->tiling.is_tiled = false;
+    bmeta->tiling.nlines = 0;
+    bmeta->tiling.nsamps = 0;
+    bmeta->provenance.stage[0] = '\0';
+    bmeta->provenance.key[0] = '\0';
+
+    strcpy (bmeta->product, ESPA_STRING_META_FILL);
+    strcpy (bmeta->source, ESPA_STRING_META_FILL);
+    strcpy (bmeta->name, ESPA_STRING_META_FILL);
+    strcpy (bmeta->category, ESPA_STRING_META_FILL);
+    bmeta->data_type = ESPA_UINT8;
+    bmeta->nlines = ESPA_INT_META_FILL;
+    bmeta->nsamps = ESPA_INT_META_FILL;
+    bmeta->fill_value = ESPA_INT_META_FILL;
+    bmeta->saturate_value = ESPA_INT_META_FILL;
+    bmeta->scale_factor = ESPA_FLOAT_META_FILL;
+    bmeta->add_offset = ESPA_FLOAT_META_FILL;
+    bmeta->resample_method = ESPA_NONE;
+    strcpy (bmeta->short_name, ESPA_STRING_META_FILL);
+    strcpy (bmeta->long_name, ESPA_STRING_META_FILL);
+    strcpy (bmeta->file_name, ESPA_STRING_META_FILL);
+    bmeta->pixel_size[0] = bmeta->pixel_size[1] = ESPA_FLOAT_META_FILL;
+    strcpy (bmeta->pixel_units, ESPA_STRING_META_FILL);
+    strcpy (bmeta->data_units, ESPA_STRING_META_FILL);
+    bmeta->valid_range[0] = bmeta->valid_range[1] = ESPA_FLOAT_META_FILL;
+    bmeta->rad_gain = ESPA_FLOAT_META_FILL;
+    bmeta->rad_bias = ESPA_FLOAT_META_FILL;
+    bmeta->refl_gain = ESPA_FLOAT_META_FILL;
+    bmeta->refl_bias = ESPA_FLOAT_META_FILL;
+    bmeta->k1_const = ESPA_FLOAT_META_FILL;
+    bmeta->k2_const = ESPA_FLOAT_META_FILL;
+    strcpy (bmeta->qa_desc, ESPA_STRING_META_FILL);
+    strcpy (bmeta->app_version, ESPA_STRING_META_FILL);
+    strcpy (bmeta->production_date, ESPA_STRING_META_FILL);
+}
+
+
+/******************************************************************************
+MODULE:  get_metadata_arena
+
+PURPOSE:  Returns the arena of the ESPA internal metadata structure, creating
+it if it doesn't exist yet.
+
+RETURN VALUE:
+Type = Espa_meta_arena_t *
+Value           Description
+-----           -----------
+NULL            Error allocating the arena
+non-NULL        Pointer to the arena
+
+NOTES:
+  1. The arena is freed by free_metadata.
+******************************************************************************/
+Espa_meta_arena_t *get_metadata_arena
+(
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure */
+)
+{
+    char FUNC_NAME[] = "get_metadata_arena";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+
+    if (internal_meta->arena == NULL)
+    {
+        internal_meta->arena = calloc (1, sizeof (Espa_meta_arena_t));
+        if (internal_meta->arena == NULL)
+        {
+            sprintf (errmsg, "Allocating ESPA metadata arena");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    return (internal_meta->arena);
+}
+
+
+/******************************************************************************
+MODULE:  alloc_metadata_arena
+
+PURPOSE:  Allocates size bytes of zeroed memory from the metadata arena.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Error allocating the memory
+non-NULL        Pointer to the allocated memory
+
+NOTES:
+  1. Memory is handed out from the current block until it is full, at which
+     point a new block of ESPA_ARENA_BLOCK_SIZE bytes is started.  Requests
+     larger than half a block get a block of their own, which is placed behind
+     the current block so the remainder of the current block isn't wasted.
+  2. The memory can't be freed individually; it is released with the arena.
+******************************************************************************/
+void *alloc_metadata_arena
+(
+    Espa_meta_arena_t *arena,  /* I/O: arena to allocate from */
+    size_t size                /* I: number of bytes to allocate */
+)
+{
+    char FUNC_NAME[] = "alloc_metadata_arena";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Espa_arena_block_t *block = arena->blocks;  /* current block */
+    size_t header;                  /* aligned size of the block header */
+    void *ptr = NULL;               /* allocated memory */
+
+    /* Keep every allocation aligned for any of the band array types */
+    header = (sizeof (Espa_arena_block_t) + 15) & ~(size_t) 15;
+    size = (size + 15) & ~(size_t) 15;
+    if (size == 0)
+        size = 16;
+
+    if (block == NULL || block->size - block->used < size)
+    {
+        size_t block_size = (size > ESPA_ARENA_BLOCK_SIZE / 2) ?
+            size : ESPA_ARENA_BLOCK_SIZE;
+
+        block = calloc (1, header + block_size);
+        if (block == NULL)
+        {
+            sprintf (errmsg, "Allocating %ld bytes of ESPA metadata",
+                (long) size);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+        block->size = block_size;
+
+        if (block_size == size && arena->blocks != NULL)
+        {   /* Dedicated block goes behind the current block */
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        else
+        {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    ptr = (char *) block + header + block->used;
+    block->used += size;
+    return (ptr);
+}
+
+
+/******************************************************************************
+MODULE:  intern_metadata_string
+
+PURPOSE:  Stores a read-only copy of the string in the arena of the band and
+returns it.  If one of the bitmap descriptions of the band already holds the
+same string, that copy is returned instead.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            Error allocating the memory
+non-NULL        Pointer to the stored string
+
+NOTES:
+  1. The string is stored at its actual length, so it must not be written to.
+     Strings which will be filled in later should be allocated with
+     allocate_bitmap_metadata.
+  2. The band must have an arena, since the strings are released with it.
+******************************************************************************/
+char *intern_metadata_string
+(
+    Espa_band_meta_t *bmeta,   /* I/O: band metadata structure owning the
+                                       string */
+    const char *str            /* I: string to be stored */
+)
+{
+    char FUNC_NAME[] = "intern_metadata_string";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    char *copy = NULL;              /* stored string */
+    size_t len = strlen (str) + 1;  /* length of the string with the NULL */
+    int i;                          /* looping variable */
+
+    /* Reuse an identical description of this band */
+    for (i = 0; i < bmeta->nbits; i++)
+    {
+        if (bmeta->bitmap_description[i] != NULL &&
+            strcmp (bmeta->bitmap_description[i], str) == 0)
+            return (bmeta->bitmap_description[i]);
+    }
+
+    if (bmeta->arena == NULL)
+    {
+        sprintf (errmsg, "Band %s doesn't have a metadata arena", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    copy = alloc_metadata_arena (bmeta->arena, len);
+    if (copy == NULL)
+        return (NULL);
+
+    memcpy (copy, str, len);
+    return (copy);
+}
+
+
+/******************************************************************************
+MODULE:  free_metadata_arena
+
+PURPOSE:  Frees all the blocks of the metadata arena and the arena itself.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+void free_metadata_arena
+(
+    Espa_meta_arena_t *arena   /* I: arena to be freed; may be NULL */
+)
+{
+    Espa_arena_block_t *block = NULL;  /* current block */
+    Espa_arena_block_t *next = NULL;   /* next block */
+
+    if (arena == NULL)
+        return;
+
+    for (block = arena->blocks; block != NULL; block = next)
+    {
+        next = block->next;
+        free (block);
+    }
+    free (arena);
+}
+
+
+/******************************************************************************
+MODULE:  allocate_band_metadata
+
+PURPOSE:  Allocates memory in the ESPA internal metadata structure for nbands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the nbands
+SUCCESS         Successfully allocated memory
+
+NOTES:
+  1. Initializes the bitmap_description and class_values for each band to NULL
+     and sets the nbits, nclass, ncover to 0.
+  2. The bands use the arena of the internal metadata structure for their
+     bitmap, class and cover arrays.
+******************************************************************************/
+int allocate_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I: pointer to internal metadata
+                                                structure */
+    int nbands                            /* I: number of bands to allocate
+                                                for the band field in the
+                                                internal_meta */
+)
+{
+    char FUNC_NAME[] = "allocate_band_metadata";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Espa_band_meta_t *bmeta = NULL; /* pointer to array of bands metadata */
+    int i;                          /* looping variable */
+
+    /* Allocate the number of bands to nbands and the associated pointers */
+    internal_meta->nbands = nbands;
+    internal_meta->band = calloc (nbands, sizeof (Espa_band_meta_t));
+    if (internal_meta->band == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata for %d bands", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    bmeta = internal_meta->band;
+
+    if (get_metadata_arena (internal_meta) == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata arena");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Initialize each band */
+    for (i = 0; i < nbands; i++)
+    {
+        init_band_metadata (&bmeta[i]);
+        bmeta[i].arena = internal_meta->arena;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  allocate_class_metadata
+
+PURPOSE:  Allocates memory in the ESPA band metadata structure for nclasses.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for nclasses
+SUCCESS         Successfully allocated memory
+
+NOTES:
+******************************************************************************/
+int allocate_class_metadata
+(
+    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
+    int nclass                    /* I: number of classes to allocate for the
+                                        band metadata */
+)
+{
+    char FUNC_NAME[] = "allocate_class_metadata";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+
+    /* Allocate the number of classes to nclass and the associated class_values
+       pointer */
+    band_meta->nclass = nclass;
+    if (band_meta->arena != NULL)
+        band_meta->class_values = alloc_metadata_arena (band_meta->arena,
+            nclass * sizeof (Espa_class_t));
+    else
+        band_meta->class_values = calloc (nclass, sizeof (Espa_class_t));
+    if (band_meta->class_values == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata for %d nclasses",
+            nclass);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  allocate_percent_coverage_metadata
+
+PURPOSE:  Allocates memory in the ESPA band metadata structure for ncover types.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for ncover types
+SUCCESS         Successfully allocated memory
+
+NOTES:
+******************************************************************************/
+int allocate_percent_coverage_metadata
+(
+    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
+    int ncover                    /* I: number of cover types to allocate for
+                                        the band metadata */
+)
+{
+    char FUNC_NAME[] = "allocate_percent_coverage_metadata"; /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+
+    /* Allocate the number of cover types to ncover and the associated cover
+       type descripts to the pointer */
+    band_meta->ncover = ncover;
+    if (band_meta->arena != NULL)
+        band_meta->percent_cover = alloc_metadata_arena (band_meta->arena,
+            ncover * sizeof (Espa_percent_cover_t));
+    else
+        band_meta->percent_cover = calloc (ncover,
+            sizeof (Espa_percent_cover_t));
+    if (band_meta->percent_cover == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata for %d cover types",
+            ncover);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  allocate_bitmap_metadata
+
+PURPOSE:  Allocates memory in the ESPA band metadata structure for nbits.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for nbits
+SUCCESS         Successfully allocated memory
+
+NOTES:
+  1. The pointers and the STR_SIZE descriptions are allocated as one block,
+     so only bitmap_description itself is freed.
+******************************************************************************/
+int allocate_bitmap_metadata
+(
+    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
+    int nbits                     /* I: number of bits to allocate for the
+                                        bitmap metadata */
+)
+{
+    char FUNC_NAME[] = "allocate_bitmap_metadata";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *strings = NULL;         /* block holding all the descriptions */
+    size_t size;                  /* size of the pointers and strings */
+    int i;                        /* looping variable */
+
+    /* Allocate the number of bits to nbits and the associated bitmap pointer,
+       followed by STR_SIZE characters for each bit description */
+    band_meta->nbits = nbits;
+    size = nbits * (sizeof (char *) + STR_SIZE);
+    if (band_meta->arena != NULL)
+        band_meta->bitmap_description = alloc_metadata_arena (band_meta->arena,
+            size);
+    else
+        band_meta->bitmap_description = calloc (1, size);
+    if (band_meta->bitmap_description == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata for %d nbits", nbits);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strings = (char *) &band_meta->bitmap_description[nbits];
+    for (i = 0; i < nbits; i++)
+        band_meta->bitmap_description[i] = &strings[i * STR_SIZE];
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  merge_band_metadata
+
+PURPOSE:  Moves the bands in the source metadata structure to the end of the
+bands in the destination metadata structure.  This is the in-memory
+equivalent of append_metadata for a metadata structure which is still being
+used.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the merged bands
+SUCCESS         Successfully merged the bands
+
+NOTES:
+  1. The band pointers (bitmap descriptions, classes, cover types) are moved,
+     not copied.  On return the source structure doesn't contain any bands,
+     and free_metadata may still be called on it.
+  2. The arena blocks of the source structure are handed over to the
+     destination arena along with the bands.
+  3. The global metadata of the source structure is not used.
+******************************************************************************/
+int merge_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to append the bands
+                                                  to */
+    Espa_internal_meta_t *src_meta        /* I/O: pointer to internal metadata
+                                                  structure containing the
+                                                  bands to be moved; bands are
+                                                  removed upon return */
+)
+{
+    char FUNC_NAME[] = "merge_band_metadata";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Espa_band_meta_t *bmeta = NULL; /* pointer to array of bands metadata */
+    Espa_meta_arena_t *arena = NULL;  /* destination arena */
+    Espa_arena_block_t *block = NULL; /* last block of the source arena */
+    int nbands;                     /* number of bands after the merge */
+    int i;                          /* looping variable */
+
+    if (src_meta->nbands == 0)
+        return (SUCCESS);
+
+    arena = get_metadata_arena (internal_meta);
+    if (arena == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA metadata arena");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Grow the band array to hold the new bands */
+    nbands = internal_meta->nbands + src_meta->nbands;
+    bmeta = realloc (internal_meta->band, nbands * sizeof (Espa_band_meta_t));
+    if (bmeta == NULL)
+    {
+        sprintf (errmsg, "Allocating ESPA band metadata for %d bands", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Move the bands, after which the source structure no longer owns them */
+    memcpy (&bmeta[internal_meta->nbands], src_meta->band,
+        src_meta->nbands * sizeof (Espa_band_meta_t));
+    for (i = internal_meta->nbands; i < nbands; i++)
+    {
+        if (bmeta[i].arena != NULL)
+            bmeta[i].arena = arena;
+    }
+    internal_meta->band = bmeta;
+    internal_meta->nbands = nbands;
+
+    /* Splice the source blocks in behind the current destination block so
+       the destination keeps allocating from its own block */
+    if (src_meta->arena != NULL && src_meta->arena->blocks != NULL)
+    {
+        for (block = src_meta->arena->blocks; block->next != NULL;
+             block = block->next)
+            ;
+        if (arena->blocks == NULL)
+            arena->blocks = src_meta->arena->blocks;
+        else
+        {
+            block->next = arena->blocks->next;
+            arena->blocks->next = src_meta->arena->blocks;
+        }
+        src_meta->arena->blocks = NULL;
+    }
+
+    free (src_meta->band);
+    src_meta->band = NULL;
+    src_meta->nbands = 0;
+    free_band_index (src_meta);
+
+    /* Keep the lookup index current with the merged bands */
+    if (build_band_index (internal_meta) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the merged bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  remove_band_metadata
+
+PURPOSE:  Removes a band from a metadata structure, moving the bands after it
+down by one.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Invalid band index, or error indexing the remaining bands
+SUCCESS         Successfully removed the band
+
+NOTES:
+  1. The band pointers (bitmap descriptions, classes, cover types) are freed
+     unless they are in the arena, which keeps them until the metadata is
+     freed.
+  2. The band file itself is not removed.
+  3. The band details of metadata parsed by parse_metadata_lazy must be
+     loaded before a band is removed, since they are matched to the bands by
+     index.
+******************************************************************************/
+int remove_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to remove the band
+                                                  from */
+    int band_index                        /* I: index of the band */
+)
+{
+    char FUNC_NAME[] = "remove_band_metadata";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Espa_band_meta_t *bmeta = NULL; /* band removed */
+
+    if (band_index < 0 || band_index >= internal_meta->nbands)
+    {
+        sprintf (errmsg, "Band index %d is out of range; there are %d bands",
+            band_index, internal_meta->nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    bmeta = &internal_meta->band[band_index];
+    if (bmeta->arena == NULL)
+    {
+        free (bmeta->bitmap_description);
+        free (bmeta->class_values);
+        free (bmeta->percent_cover);
+    }
+
+    memmove (bmeta, bmeta + 1, (internal_meta->nbands - band_index - 1) *
+        sizeof (Espa_band_meta_t));
+    internal_meta->nbands--;
+
+    /* Keep the lookup index current with the remaining bands */
+    if (build_band_index (internal_meta) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the remaining bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  band_key
+
+PURPOSE:  Returns the indexed field of the band for the specified key.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+non-NULL        Pointer to the field of the band
+
+NOTES:
+******************************************************************************/
+static const char *band_key
+(
+    const Espa_band_meta_t *bmeta,  /* I: pointer to band metadata structure */
+    Espa_band_key_t key             /* I: field of the band to be returned */
+)
+{
+    if (key == ESPA_BAND_KEY_NAME)
+        return (bmeta->name);
+    else if (key == ESPA_BAND_KEY_PRODUCT)
+        return (bmeta->product);
+    else
+        return (bmeta->category);
+}
+
+
+/******************************************************************************
+MODULE:  hash_band_string
+
+PURPOSE:  Hashes a string of the band index.
+
+RETURN VALUE:
+Type = unsigned int
+Value           Description
+-----           -----------
+any             Hash of the string
+
+NOTES:
+  1. Uses the 32-bit FNV-1a hash.  The slot of the string in a table of
+     nslots slots, a power of 2, is the hash masked by nslots - 1.
+******************************************************************************/
+static unsigned int hash_band_string
+(
+    const char *str    /* I: string to be hashed */
+)
+{
+    unsigned int hash = 2166136261u;   /* running hash value */
+
+    for (; *str != '\0'; str++)
+    {
+        hash ^= (unsigned char) *str;
+        hash *= 16777619u;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  intern_hot_string
+
+PURPOSE:  Adds a string to the string pool of the compact bands, unless the
+pool already holds it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+>= 0            Offset of the string in the pool
+
+NOTES:
+  1. The table maps the strings already in the pool to their offsets, plus
+     one so 0 marks an empty entry.  It has ntable entries, a power of 2, and
+     is never full since it has more entries than strings are added.
+******************************************************************************/
+static int intern_hot_string
+(
+    const char *str,   /* I: string to be added */
+    unsigned int hash, /* I: hash of the string */
+    char *strings,     /* I/O: string pool */
+    int *used,         /* I/O: number of bytes of the pool in use */
+    int *table,        /* I/O: offsets of the strings in the pool */
+    int ntable         /* I: number of entries in the table */
+)
+{
+    int t;             /* current entry of the table */
+    int offset;        /* offset of the string */
+
+    for (t = hash & (ntable - 1); table[t] != 0; t = (t + 1) & (ntable - 1))
+    {
+        if (!strcmp (&strings[table[t] - 1], str))
+            return (table[t] - 1);
+    }
+
+    offset = *used;
+    strcpy (&strings[offset], str);
+    *used += strlen (str) + 1;
+    table[t] = offset + 1;
+
+    return (offset);
+}
+
+
+/******************************************************************************
+MODULE:  build_band_hot
+
+PURPOSE:  Builds the compact copy of the bands, and the string pool of their
+names, products, categories and file names, for the band index.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the compact bands
+SUCCESS         Successfully built the compact bands
+
+NOTES:
+******************************************************************************/
+static int build_band_hot
+(
+    Espa_internal_meta_t *internal_meta,  /* I: pointer to internal metadata
+                                                  structure being indexed */
+    Espa_band_index_t *index              /* I/O: band index */
+)
+{
+    Espa_band_meta_t *bmeta = NULL; /* current band */
+    Espa_band_hot_t *hot = NULL;    /* compact copy of the current band */
+    size_t size = 1;                /* size of the string pool */
+    int used = 0;                   /* number of bytes of the pool in use */
+    int ntable;                     /* number of entries in the table */
+    int *table = NULL;              /* offsets of the interned strings */
+    int i, k;                       /* looping variables */
+
+    for (i = 0; i < internal_meta->nbands; i++)
+    {
+        bmeta = &internal_meta->band[i];
+        for (k = 0; k < ESPA_BAND_NKEYS; k++)
+            size += strlen (band_key (bmeta, k)) + 1;
+        size += strlen (bmeta->file_name) + 1;
+    }
+    for (ntable = 16; ntable < 2 * (ESPA_BAND_NKEYS + 1) *
+         internal_meta->nbands; ntable *= 2)
+        ;
+
+    index->hot = malloc ((internal_meta->nbands + 1) *
+        sizeof (Espa_band_hot_t));
+    index->strings = malloc (size);
+    table = calloc (ntable, sizeof (int));
+    if (index->hot == NULL || index->strings == NULL || table == NULL)
+    {
+        free (table);
+        return (ERROR);
+    }
+
+    for (i = 0; i < internal_meta->nbands; i++)
+    {
+        bmeta = &internal_meta->band[i];
+        hot = &index->hot[i];
+        for (k = 0; k < ESPA_BAND_NKEYS; k++)
+        {
+            hot->hash[k] = hash_band_string (band_key (bmeta, k));
+            hot->key[k] = intern_hot_string (band_key (bmeta, k),
+                hot->hash[k], index->strings, &used, table, ntable);
+        }
+        hot->file_name = intern_hot_string (bmeta->file_name,
+            hash_band_string (bmeta->file_name), index->strings, &used,
+            table, ntable);
+        hot->data_type = bmeta->data_type;
+        hot->nlines = bmeta->nlines;
+        hot->nsamps = bmeta->nsamps;
+        hot->fill_value = bmeta->fill_value;
+        hot->scale_factor = bmeta->scale_factor;
+        hot->add_offset = bmeta->add_offset;
+        hot->pixel_size[0] = bmeta->pixel_size[0];
+        hot->pixel_size[1] = bmeta->pixel_size[1];
+    }
+
+    free (table);
+    return (SUCCESS);
+}
+
 
 /******************************************************************************
-MODULE:  validate_xml_file
+MODULE:  band_matches
 
-PURPOSE:  Validates the specified XML file with the specified schema file/URL.
+PURPOSE:  Determines if the band matches the specified product, name and
+category.  A NULL product, name or category matches any band.
 
 RETURN VALUE:
-Type = int
+Type = bool
 Value           Description
 -----           -----------
-ERROR           XML does not validate against the specified schema
-SUCCESS         XML validates
+true            The band matches
+false           The band doesn't match
 
 NOTES:
 ******************************************************************************/
-int validate_xml_file
+static bool band_matches
 (
-    char *meta_file           /* I: name of metadata file to be validated */
+    const Espa_band_meta_t *bmeta,  /* I: pointer to band metadata structure */
+    const char *product,            /* I: product of the band or NULL */
+    const char *name,               /* I: name of the band or NULL */
+    const char *category            /* I: category of the band or NULL */
 )
 {
-    char FUNC_NAME[] = "validate_xml_file";   /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    char *schema_file = NULL;     /* name of schema file or URL to be validated
-                                     against */
-    int status;                   /* return status */
-    xmlDocPtr doc = NULL;         /* resulting document tree */
-    xmlSchemaPtr schema = NULL;   /* pointer to the schema */
-    xmlSchemaParserCtxtPtr ctxt = NULL;  /* parser context for the schema */
-    xmlSchemaValidCtxtPtr valid_ctxt = NULL;  /* pointer to validate from the
-                                                 schema */
-    struct stat statbuf;          /* buffer for the file stat function */
+    return ((name == NULL || !strcmp (bmeta->name, name)) &&
+            (product == NULL || !strcmp (bmeta->product, product)) &&
+            (category == NULL || !strcmp (bmeta->category, category)));
+}
 
-    /* Get the ESPA schema environment variable which specifies the location
-       of the XML schema to be used */
-    schema_file = getenv ("ESPA_SCHEMA");
-    if (schema_file == NULL)
-    {  /* ESPA schema environment variable wasn't defined. Try the version in
-          /usr/local... */
-        schema_file = LOCAL_ESPA_SCHEMA;
-        if (stat (schema_file, &statbuf) == -1)
-        {  /* /usr/local ESPA schema file doesn't exist.  Try the version on
-              the ESPA http site... */
-            schema_file = ESPA_SCHEMA;
-        }
-    }
 
-    /* Set up the schema parser and parse the schema file/URL */
-    xmlLineNumbersDefault (1);
-    ctxt = xmlSchemaNewParserCtxt (schema_file);
-    xmlSchemaSetParserErrors (ctxt, (xmlSchemaValidityErrorFunc) fprintf,
-        (xmlSchemaValidityWarningFunc) fprintf, stderr);
-    schema = xmlSchemaParse (ctxt);
+/******************************************************************************
+MODULE:  band_hot_matches
 
-    /* Free the schema parser context */
-    xmlSchemaFreeParserCtxt (ctxt);
+PURPOSE:  Determines if the compact copy of the band matches the specified
+strings of the keys.  A NULL string matches any band.
 
-    /* Load the XML file and parse it to the document tree */
-    doc = xmlReadFile (meta_file, NULL, 0);
-    if (doc == NULL)
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The band matches
+false           The band doesn't match
+
+NOTES:
+  1. The hashes are compared first, so the strings are only compared for
+     the bands which most likely match.
+******************************************************************************/
+static bool band_hot_matches
+(
+    const Espa_band_index_t *index, /* I: band index */
+    int band,                       /* I: index of the band */
+    const char *value[],            /* I: string of each key or NULL */
+    const unsigned int hash[]       /* I: hash of each string */
+)
+{
+    const Espa_band_hot_t *hot = &index->hot[band];  /* compact band */
+    int k;                          /* looping variable for the keys */
+
+    for (k = 0; k < ESPA_BAND_NKEYS; k++)
     {
-        sprintf (errmsg, "Could not parse %s", meta_file);
-        error_handler (true, FUNC_NAME, errmsg);
-        sprintf (errmsg, "Possible schema file not found.  ESPA_SCHEMA "
-            "environment variable isn't defined.  The first default schema "
-            "location of %s doesn't exist.  And the second default location of "
-            "%s was used as the last default.", LOCAL_ESPA_SCHEMA, ESPA_SCHEMA);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        if (value[k] != NULL && (hot->hash[k] != hash[k] ||
+            strcmp (&index->strings[hot->key[k]], value[k])))
+            return (false);
     }
 
-    /* Identify the schema file as the validation source */
-    valid_ctxt = xmlSchemaNewValidCtxt (schema);
-    xmlSchemaSetValidErrors (valid_ctxt, (xmlSchemaValidityErrorFunc) fprintf,
-        (xmlSchemaValidityWarningFunc) fprintf, stderr);
+    return (true);
+}
 
-    /* Validate the XML metadata against the schema */
-    status = xmlSchemaValidateDoc (valid_ctxt, doc);
-    if (status > 0)
+
+/******************************************************************************
+MODULE:  build_band_index
+
+PURPOSE:  Builds (or rebuilds) the hashed lookup index of the bands in the ESPA
+internal metadata structure by name, product and category.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the index
+SUCCESS         Successfully built the index
+
+NOTES:
+  1. The index is built by parse_metadata, subset_metadata_by_band and
+     merge_band_metadata.  find_band_metadata rebuilds it if the band array
+     has been reallocated or resized since, but applications which rename
+     bands after the index was built need to call build_band_index or
+     free_band_index themselves.
+  2. Building the index modifies the metadata structure, so it shouldn't be
+     done while other threads are looking up bands in the same structure.
+  3. The index also holds the compact copy of the bands (see
+     Espa_band_hot_t), which is a snapshot of the bands as they were when it
+     was built.  Applications which change those fields of the bands need
+     to rebuild the index before they use the compact copy.
+******************************************************************************/
+int build_band_index
+(
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure to be indexed */
+)
+{
+    char FUNC_NAME[] = "build_band_index";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Espa_band_index_t *index = NULL;  /* band index */
+    int nslots;                     /* number of slots in each hash table */
+    int *tables = NULL;             /* storage for all the tables */
+    int i, k;                       /* looping variables */
+    int s;                          /* current slot */
+    unsigned int mask;              /* mask of the slot of a hash */
+
+    free_band_index (internal_meta);
+
+    /* Use at least twice as many slots as bands to keep the chains short */
+    for (nslots = 16; nslots < 2 * internal_meta->nbands; nslots *= 2)
+        ;
+
+    index = calloc (1, sizeof (Espa_band_index_t));
+    tables = malloc (ESPA_BAND_NKEYS * (nslots + internal_meta->nbands + 1) *
+        sizeof (int));
+    if (index == NULL || tables == NULL)
     {
-        sprintf (errmsg, "%s fails to validate", meta_file);
+        free (index);
+        free (tables);
+        sprintf (errmsg, "Allocating the band index for %d bands",
+            internal_meta->nbands);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    else if (status != 0)
+    index->band = internal_meta->band;
+    index->nbands = internal_meta->nbands;
+    index->nslots = nslots;
+    index->slot[0] = tables;
+    if (build_band_hot (internal_meta, index) != SUCCESS)
     {
-        sprintf (errmsg, "%s validation generated an internal error",
-            meta_file);
+        internal_meta->band_index = index;
+        free_band_index (internal_meta);
+        sprintf (errmsg, "Allocating the compact copy of %d bands",
+            internal_meta->nbands);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    mask = (unsigned int) (nslots - 1);
 
-    /* Free the resources and clean up the memory */
-    xmlSchemaFreeValidCtxt (valid_ctxt);
-    xmlFreeDoc (doc);
-    if (schema != NULL)
-        xmlSchemaFree (schema);
-    xmlSchemaCleanupTypes();
-    xmlCleanupParser();   /* cleanup the XML library */
-    xmlMemoryDump();      /* for debugging */
+    for (k = 0; k < ESPA_BAND_NKEYS; k++)
+    {
+        index->slot[k] = &tables[k * (nslots + internal_meta->nbands + 1)];
+        index->next[k] = &index->slot[k][nslots];
+        for (s = 0; s < nslots; s++)
+            index->slot[k][s] = -1;
+
+        /* Insert the bands from last to first so each chain is in band
+           order */
+        for (i = internal_meta->nbands - 1; i >= 0; i--)
+        {
+            s = index->hot[i].hash[k] & mask;
+            index->next[k][i] = index->slot[k][s];
+            index->slot[k][s] = i;
+        }
+    }
 
-    /* Successful completion */
+    internal_meta->band_index = index;
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  init_metadata_struct
+MODULE:  free_band_index
 
-PURPOSE:  Initializes the ESPA internal metadata structure, particularly the
-pointers within each sub-structure.  Assigns field values to fill to make it
-easier to detect if the values were parsed from the input metadata file or
-assigned by the user.
+PURPOSE:  Frees the lookup index of the bands in the ESPA internal metadata
+structure.
 
-RETURN VALUE:
-Type = None
+RETURN VALUE: N/A
 
 NOTES:
 ******************************************************************************/
-void init_metadata_struct
+void free_band_index
 (
-    Espa_internal_meta_t *internal_meta   /* I: pointer to internal metadata
-                                                structure to be initialized */
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure */
 )
 {
-    Espa_global_meta_t *gmeta = &internal_meta->global;
-                                 /* pointer to the global metadata structure */
-
-    /* Initialze the number of bands */
-    internal_meta->nbands = 0;
-    internal_meta->band = NULL;
-
-    /* Initialize the global metadata values to fill for use by the write
-       metadata routines */
-    strcpy (gmeta->data_provider, ESPA_STRING_META_FILL);
-    strcpy (gmeta->satellite, ESPA_STRING_META_FILL);
-    strcpy (gmeta->instrument, ESPA_STRING_META_FILL);
-    strcpy (gmeta->acquisition_date, ESPA_STRING_META_FILL);
-    strcpy (gmeta->scene_center_time, ESPA_STRING_META_FILL);
-    strcpy (gmeta->level1_production_date, ESPA_STRING_META_FILL);
-    gmeta->solar_zenith = ESPA_FLOAT_META_FILL;
-    gmeta->solar_azimuth = ESPA_FLOAT_META_FILL;
-    strcpy (gmeta->solar_units, ESPA_STRING_META_FILL);
-    gmeta->earth_sun_dist = ESPA_FLOAT_META_FILL;
-    gmeta->wrs_system = ESPA_INT_META_FILL;
-    gmeta->wrs_path = ESPA_INT_META_FILL;
-    gmeta->wrs_row = ESPA_INT_META_FILL;
-    gmeta->htile = ESPA_INT_META_FILL;
-    gmeta->vtile = ESPA_INT_META_FILL;
-    strcpy (gmeta->lpgs_metadata_file, ESPA_STRING_META_FILL);
-    strcpy (gmeta->product_id, ESPA_STRING_META_FILL);
-    gmeta->ul_corner[0] = gmeta->ul_corner[1] = ESPA_FLOAT_META_FILL;
-    gmeta->lr_corner[0] = gmeta->lr_corner[1] = ESPA_FLOAT_META_FILL;
-    gmeta->bounding_coords[0] = ESPA_FLOAT_META_FILL;
-    gmeta->bounding_coords[1] = ESPA_FLOAT_META_FILL;
-    gmeta->bounding_coords[2] = ESPA_FLOAT_META_FILL;
-    gmeta->bounding_coords[3] = ESPA_FLOAT_META_FILL;
-    gmeta->proj_info.proj_type = ESPA_INT_META_FILL;
-    gmeta->proj_info.datum_type = ESPA_NODATUM;
-    gmeta->orientation_angle = ESPA_FLOAT_META_FILL;
+    if (internal_meta->band_index == NULL)
+        return;
+
+    /* All the tables share the storage of the first slot table */
+    free (internal_meta->band_index->slot[0]);
+    free (internal_meta->band_index->hot);
+    free (internal_meta->band_index->strings);
+    free (internal_meta->band_index);
+    internal_meta->band_index = NULL;
 }
 
 
 /******************************************************************************
-MODULE:  allocate_band_metadata
+MODULE:  current_band_index
 
-PURPOSE:  Allocates memory in the ESPA internal metadata structure for nbands.
+PURPOSE:  Returns the band index of the ESPA internal metadata structure,
+building it first if it doesn't exist or no longer matches the band array.
 
 RETURN VALUE:
-Type = int
+Type = Espa_band_index_t *
 Value           Description
 -----           -----------
-ERROR           Error allocating memory for the nbands
-SUCCESS         Successfully allocated memory
+NULL            The index couldn't be built
+non-NULL        Band index
 
 NOTES:
-  1. Initializes the bitmap_description and class_values for each band to NULL
-     and sets the nbits, nclass, ncover to 0.
 ******************************************************************************/
-int allocate_band_metadata
+static Espa_band_index_t *current_band_index
 (
-    Espa_internal_meta_t *internal_meta,  /* I: pointer to internal metadata
-                                                structure */
-    int nbands                            /* I: number of bands to allocate
-                                                for the band field in the
-                                                internal_meta */
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure */
 )
 {
-    char FUNC_NAME[] = "allocate_band_metadata";   /* function name */
-    char errmsg[STR_SIZE];          /* error message */
-    Espa_band_meta_t *bmeta = NULL; /* pointer to array of bands metadata */
-    int i;                          /* looping variable */
-
-    /* Allocate the number of bands to nbands and the associated pointers */
-    internal_meta->nbands = nbands;
-    internal_meta->band = calloc (nbands, sizeof (Espa_band_meta_t));
-    if (internal_meta->band == NULL)
-    {
-        sprintf (errmsg, "Allocating ESPA band metadata for %d bands", nbands);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-    bmeta = internal_meta->band;
+    Espa_band_index_t *index = internal_meta->band_index;  /* band index */
 
-    /* Set the nbits, nclass, ncover fields in the band metadata to 0 for each
-       band and initialize the pointers to NULL.  Initialize the other fields to
-       fill to make it easy to distinguish if they were populated by reading
-       an input metadata file or assigned directly. */
-    for (i = 0; i < nbands; i++)
+    if (index == NULL || index->band != internal_meta->band ||
+        index->nbands != internal_meta->nbands)
     {
-        bmeta[i].nbits = 0;
-        bmeta[i].bitmap_description = NULL;
-        bmeta[i].nclass = 0;
-        bmeta[i].class_values = NULL;
-        bmeta[i].ncover = 0;
-        bmeta[i].percent_cover = NULL;
-
-        strcpy (bmeta[i].product, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].source, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].name, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].category, ESPA_STRING_META_FILL);
-        bmeta[i].data_type = ESPA_UINT8;
-        bmeta[i].nlines = ESPA_INT_META_FILL;
-        bmeta[i].nsamps = ESPA_INT_META_FILL;
-        bmeta[i].fill_value = ESPA_INT_META_FILL;
-        bmeta[i].saturate_value = ESPA_INT_META_FILL;
-        bmeta[i].scale_factor = ESPA_FLOAT_META_FILL;
-        bmeta[i].add_offset = ESPA_FLOAT_META_FILL;
-        bmeta[i].resample_method = ESPA_NONE;
-        strcpy (bmeta[i].short_name, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].long_name, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].file_name, ESPA_STRING_META_FILL);
-        bmeta[i].pixel_size[0] = bmeta[i].pixel_size[1] = ESPA_FLOAT_META_FILL;
-        strcpy (bmeta[i].pixel_units, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].data_units, ESPA_STRING_META_FILL);
-        bmeta[i].valid_range[0] = bmeta[i].valid_range[1] =
-            ESPA_FLOAT_META_FILL;
-        bmeta[i].rad_gain = ESPA_FLOAT_META_FILL;
-        bmeta[i].rad_bias = ESPA_FLOAT_META_FILL;
-        bmeta[i].refl_gain = ESPA_FLOAT_META_FILL;
-        bmeta[i].refl_bias = ESPA_FLOAT_META_FILL;
-        bmeta[i].k1_const = ESPA_FLOAT_META_FILL;
-        bmeta[i].k2_const = ESPA_FLOAT_META_FILL;
-        strcpy (bmeta[i].qa_desc, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].app_version, ESPA_STRING_META_FILL);
-        strcpy (bmeta[i].production_date, ESPA_STRING_META_FILL);
+        if (build_band_index (internal_meta) != SUCCESS)
+            return (NULL);
+        index = internal_meta->band_index;
     }
 
-    return (SUCCESS);
+    return (index);
 }
 
 
 /******************************************************************************
-MODULE:  allocate_class_metadata
+MODULE:  get_band_hot
 
-PURPOSE:  Allocates memory in the ESPA band metadata structure for nclasses.
+PURPOSE:  Returns the compact copy of a band, for scanning the bands without
+touching their full metadata.
 
 RETURN VALUE:
-Type = int
+Type = const Espa_band_hot_t *
 Value           Description
 -----           -----------
-ERROR           Error allocating memory for nclasses
-SUCCESS         Successfully allocated memory
+NULL            Invalid band index, or the band index couldn't be built
+non-NULL        Compact copy of the band
 
 NOTES:
+  1. The compact copy of the bands is in the band index, which is built
+     first if it isn't current (see note 3 of build_band_index).  The
+     compact bands are contiguous, so the pointer to the first one may be
+     indexed by band for the others.
+  2. The strings of the compact band are returned by get_band_hot_string.
 ******************************************************************************/
-int allocate_class_metadata
+const Espa_band_hot_t *get_band_hot
 (
-    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
-    int nclass                    /* I: number of classes to allocate for the
-                                        band metadata */
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure */
+    int band                              /* I: index of the band */
 )
 {
-    char FUNC_NAME[] = "allocate_class_metadata";   /* function name */
-    char errmsg[STR_SIZE];        /* error message */
+    Espa_band_index_t *index = NULL;  /* band index */
 
-    /* Allocate the number of classes to nclass and the associated class_values
-       pointer */
-    band_meta->nclass = nclass;
-    band_meta->class_values = calloc (nclass, sizeof (Espa_class_t));
-    if (band_meta->class_values == NULL)
-    {
-        sprintf (errmsg, "Allocating ESPA band metadata for %d nclasses",
-            nclass);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    if (band < 0 || band >= internal_meta->nbands)
+        return (NULL);
 
-    return (SUCCESS);
+    index = current_band_index (internal_meta);
+    if (index == NULL)
+        return (NULL);
+
+    return (&index->hot[band]);
 }
 
 
 /******************************************************************************
-MODULE:  allocate_percent_coverage_metadata
+MODULE:  get_band_hot_string
 
-PURPOSE:  Allocates memory in the ESPA band metadata structure for ncover types.
+PURPOSE:  Returns a string of a compact band from the string pool.
 
 RETURN VALUE:
-Type = int
+Type = const char *
 Value           Description
 -----           -----------
-ERROR           Error allocating memory for ncover types
-SUCCESS         Successfully allocated memory
+non-NULL        The string
 
 NOTES:
+  1. The offset must come from a compact band returned by get_band_hot
+     since the index was last built.  Equal strings have equal offsets, so
+     the offsets may be compared instead of the strings.
 ******************************************************************************/
-int allocate_percent_coverage_metadata
+const char *get_band_hot_string
 (
-    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
-    int ncover                    /* I: number of cover types to allocate for
-                                        the band metadata */
+    const Espa_internal_meta_t *internal_meta,  /* I: pointer to internal
+                                                  metadata structure */
+    int offset                            /* I: offset of the string from
+                                                the compact band */
 )
 {
-    char FUNC_NAME[] = "allocate_percent_coverage_metadata"; /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-
-    /* Allocate the number of cover types to ncover and the associated cover
-       type descripts to the pointer */
-    band_meta->ncover = ncover;
-    band_meta->percent_cover = calloc (ncover, sizeof (Espa_percent_cover_t));
-    if (band_meta->percent_cover == NULL)
-    {
-        sprintf (errmsg, "Allocating ESPA band metadata for %d cover types",
-            ncover);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    return (SUCCESS);
+    return (&internal_meta->band_index->strings[offset]);
 }
 
 
 /******************************************************************************
-MODULE:  allocate_bitmap_metadata
+MODULE:  find_next_band_metadata
 
-PURPOSE:  Allocates memory in the ESPA band metadata structure for nbits.
+PURPOSE:  Finds the next band after prev in the ESPA internal metadata
+structure which matches the specified product, name and category.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error allocating memory for nbits
-SUCCESS         Successfully allocated memory
+-1              No more bands match
+0 - nbands-1    Index of the next matching band
 
 NOTES:
+  1. A NULL product, name or category matches any band.  The name is the most
+     selective key, so it is used for the hash lookup when it is specified.
+  2. The index is built first if it doesn't exist or no longer matches the
+     band array.  If it can't be built the bands are searched directly.
+  3. prev must be -1 or a band returned for the same product, name and
+     category, so it is in the chain of the slot being walked.  All the
+     matching bands are visited in band order by starting with -1 and
+     passing each band found back in, in time proportional to the number of
+     bands in the slot rather than in the product.
+  4. The bands in the chain are matched on their compact copies, so only
+     the band which is returned has its full metadata touched.
 ******************************************************************************/
-int allocate_bitmap_metadata
+int find_next_band_metadata
 (
-    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
-    int nbits                     /* I: number of bits to allocate for the
-                                        bitmap metadata */
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to be searched */
+    int prev,                             /* I: band returned by the previous
+                                                search; -1 to start from the
+                                                first band */
+    const char *product,                  /* I: product of the band; NULL
+                                                for any product */
+    const char *name,                     /* I: name of the band; NULL for
+                                                any name */
+    const char *category                  /* I: category of the band; NULL
+                                                for any category */
 )
 {
-    char FUNC_NAME[] = "allocate_bitmap_metadata";   /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    int i;                        /* looping variable */
-
-    /* Allocate the number of bits to nbits and the associated bitmap pointer */
-    band_meta->nbits = nbits;
-    band_meta->bitmap_description = calloc (nbits, sizeof (char *));
-    if (band_meta->bitmap_description == NULL)
+    Espa_band_index_t *index = NULL;  /* band index */
+    Espa_band_key_t key;            /* key used for the hash lookup */
+    const char *value[ESPA_BAND_NKEYS];  /* string of each key or NULL */
+    unsigned int hash[ESPA_BAND_NKEYS];  /* hash of each string */
+    int i;                          /* current band */
+    int k;                          /* looping variable for the keys */
+
+    if (name != NULL)
+        key = ESPA_BAND_KEY_NAME;
+    else if (product != NULL)
+        key = ESPA_BAND_KEY_PRODUCT;
+    else if (category != NULL)
+        key = ESPA_BAND_KEY_CATEGORY;
+    else
+        return (prev + 1 < internal_meta->nbands ? prev + 1 : -1);
+
+    /* Make sure the index is current */
+    index = current_band_index (internal_meta);
+
+    /* Search the bands directly if the index isn't available */
+    if (index == NULL)
     {
-        sprintf (errmsg, "Allocating ESPA bitmap description");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        for (i = prev + 1; i < internal_meta->nbands; i++)
+        {
+            if (band_matches (&internal_meta->band[i], product, name,
+                category))
+                return (i);
+        }
+        return (-1);
     }
 
-    for (i = 0; i < nbits; i++)
+    value[ESPA_BAND_KEY_NAME] = name;
+    value[ESPA_BAND_KEY_PRODUCT] = product;
+    value[ESPA_BAND_KEY_CATEGORY] = category;
+    for (k = 0; k < ESPA_BAND_NKEYS; k++)
+        hash[k] = (value[k] != NULL) ? hash_band_string (value[k]) : 0;
+
+    /* Walk the chain of the slot, which also holds bands whose key merely
+       hashes to the same slot */
+    if (prev < 0)
+        i = index->slot[key][hash[key] & (unsigned int) (index->nslots - 1)];
+    else
+        i = index->next[key][prev];
+    for ( ; i >= 0; i = index->next[key][i])
     {
-        band_meta->bitmap_description[i] = calloc (STR_SIZE, sizeof (char));
-        if (band_meta->bitmap_description[i] == NULL)
-        {
-            sprintf (errmsg, "Allocating ESPA band metadata for %d nbits",
-                nbits);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        if (band_hot_matches (index, i, value, hash))
+            return (i);
     }
 
-    return (SUCCESS);
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  find_band_metadata
+
+PURPOSE:  Finds the first band in the ESPA internal metadata structure which
+matches the specified product, name and category.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              No band matches
+0 - nbands-1    Index of the first matching band
+
+NOTES:
+  1. See find_next_band_metadata.
+******************************************************************************/
+int find_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to be searched */
+    const char *product,                  /* I: product of the band; NULL
+                                                for any product */
+    const char *name,                     /* I: name of the band; NULL for
+                                                any name */
+    const char *category                  /* I: category of the band; NULL
+                                                for any category */
+)
+{
+    return (find_next_band_metadata (internal_meta, -1, product, name,
+        category));
 }
 
 
@@ -408,6 +1826,8 @@ PURPOSE:  Frees memory in the ESPA internal metadata structure.
 RETURN VALUE: N/A
 
 NOTES:
+  1. The band arrays which live in the arena are released together with the
+     arena; only the bands without an arena free their arrays one by one.
 ******************************************************************************/
 void free_metadata
 (
@@ -415,25 +1835,29 @@ void free_metadata
                                                 structure */
 )
 {
-    int i, b;                      /* looping variables */
+    int i;                         /* looping variable */
 
     /* Free the pointers in the band metadata */
     for (i = 0; i < internal_meta->nbands; i++)
     {
-        if (internal_meta->band[i].nbits > 0)
-        {
-            for (b = 0; b < internal_meta->band[i].nbits; b++)
-                free (internal_meta->band[i].bitmap_description[b]);
-            free (internal_meta->band[i].bitmap_description);
-        }
+        if (internal_meta->band[i].arena != NULL)
+            continue;
 
+        free (internal_meta->band[i].bitmap_description);
         free (internal_meta->band[i].class_values);
         free (internal_meta->band[i].percent_cover);
     }
 
-    /* Free the band pointer itself */
+    /* Free the band pointer itself and the arena */
     if (internal_meta->band)
         free (internal_meta->band);
+    internal_meta->band = NULL;
+    internal_meta->nbands = 0;
+    free_band_index (internal_meta);
+    free_metadata_arena (internal_meta->arena);
+    internal_meta->arena = NULL;
+    free (internal_meta->lazy_file);
+    internal_meta->lazy_file = NULL;
 }
 
 
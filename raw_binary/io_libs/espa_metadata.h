@@ -29,11 +29,15 @@ NOTES:
    but the schema version will contain the major and minor version number
    (i.e. 1.2) */
 #define LIBXML_SCHEMAS_ENABLED
-#define ESPA_SCHEMA_VERSION "2.0"
+#define ESPA_SCHEMA_VERSION "2.1"
 #define ESPA_NS "http://espa.cr.usgs.gov/v2"
 #define ESPA_SCHEMA_LOCATION "http://espa.cr.usgs.gov/v2"
-#define ESPA_SCHEMA "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v2_0.xsd"
-#define LOCAL_ESPA_SCHEMA "/usr/local/espa-product-formatter/schema/espa_internal_metadata_v2_0.xsd"
+#define ESPA_SCHEMA "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v2_1.xsd"
+#define LOCAL_ESPA_SCHEMA "/usr/local/espa-product-formatter/schema/espa_internal_metadata_v2_1.xsd"
+
+/* Size of each memory block in the metadata arena.  Requests larger than a
+   block are given a block of their own. */
+#define ESPA_ARENA_BLOCK_SIZE 65536
 
 /* Data types */
 enum Espa_data_type
@@ -54,11 +58,6 @@ enum Espa_geographic_type
     ESPA_WEST, ESPA_EAST, ESPA_NORTH, ESPA_SOUTH
 };
 
-/* Local define to specify the maximum total bands and product types.  This
-   should be sufficient for ESPA products. */
-#define MAX_TOTAL_BANDS 100
-#define MAX_TOTAL_PRODUCT_TYPES 50
-
 /* Local defines for fill or not used data values in the metadata */
 #define ESPA_INT_META_FILL -3333
 #define ESPA_FLOAT_META_FILL -3333.00
@@ -80,6 +79,82 @@ typedef struct
                                      cloud, etc.)*/
 } Espa_percent_cover_t;
 
+/* Type of the band file checksums */
+#define ESPA_CHECKSUM_TYPE "crc32c"
+
+/* Sub-sampling of a band stored at a reduced resolution.  Pixel (l, s) of the
+   band is pixel (l * factor, s * factor) of the full resolution band. */
+typedef struct
+{
+    int factor;                  /* sub-sampling factor; 1 if the band is at
+                                    full resolution */
+    int nlines;                  /* number of lines at full resolution */
+    int nsamps;                  /* number of samples at full resolution */
+} Espa_sub_sample_t;
+
+/* Constant value of a band which is generated on read rather than stored
+   (see raw_binary_constant.h) */
+typedef struct
+{
+    bool is_constant;            /* is the band a constant band? */
+    double value;                /* value of the pixels which aren't fill */
+    char fill_band[STR_SIZE];    /* file name of the band whose fill pixels
+                                    are fill in this band; empty if none */
+} Espa_constant_t;
+
+/* Band-math expression of a band derived from other bands of the product
+   (see raw_binary_derived.h) */
+typedef struct
+{
+    bool is_derived;             /* is the band a derived band? */
+    char expression[STR_SIZE];   /* expression over the names of the bands
+                                    it's derived from */
+} Espa_derived_t;
+
+/* Tiles of a band stored in an internally tiled layout rather than line by
+   line (see raw_binary_tiled.h) */
+typedef struct
+{
+    bool is_tiled;               /* is the band stored in tiles? */
+    int nlines;                  /* number of lines in a tile */
+    int nsamps;                  /* number of samples in a tile */
+} Espa_tiling_t;
+
+/* Provenance of a band written by a pipeline stage (see espa_pipeline.h):
+   the stage and a digest of what the stage's outputs depend on */
+typedef struct
+{
+    char stage[STR_SIZE];        /* name of the stage which wrote the band;
+                                    empty if the band has no provenance */
+    char key[STR_SIZE];          /* digest of the stage parameters and
+                                    version and of its input bands, as 16
+                                    hexadecimal digits */
+} Espa_provenance_t;
+
+/* Number of bins in the histogram of the band statistics */
+#define ESPA_STATS_NBINS 256
+
+/* Statistics of the pixel values of a band, computed while it's written */
+typedef struct
+{
+    long valid_pixels;            /* number of valid pixels; ESPA_INT_META_FILL
+                                     if no statistics are available */
+    long fill_pixels;             /* number of fill pixels */
+    long out_of_range_pixels;     /* number of non-fill pixels outside the
+                                     valid range */
+    double min;                   /* minimum valid pixel value */
+    double max;                   /* maximum valid pixel value */
+    double mean;                  /* mean of the valid pixel values */
+    double stddev;                /* standard deviation of the valid pixel
+                                     values */
+    int nbins;                    /* number of bins in histogram; 0 if there
+                                     is no histogram */
+    double hist_min;              /* lowest value covered by the histogram */
+    double hist_max;              /* highest value covered by the histogram;
+                                     the bins are of equal width */
+    long histogram[ESPA_STATS_NBINS];  /* number of valid pixels in each bin */
+} Espa_band_stats_t;
+
 typedef struct
 {
     int proj_type;        /* projection number (see GCTP_* in gctp_defines.h) */
@@ -136,6 +211,8 @@ typedef struct
     char scene_center_time[STR_SIZE];  /* GMT time at scene center */
     char product_id[STR_SIZE];    /* product ID */
     char lpgs_metadata_file[STR_SIZE]; /* name of LPGS metadata file */
+    char valid_mask[STR_SIZE];    /* name of the valid mask of the scene (see
+                                     raw_binary_valid.h) */
     float orientation_angle;      /* orientation angle of the scene (degrees) */
     float solar_zenith;           /* solar zenith angle (degrees) */
     float solar_azimuth;          /* solar azimuth angle (degrees) */
@@ -148,6 +225,21 @@ typedef struct
     int vtile;                    /* MODIS vertical tile number */
 } Espa_global_meta_t;
 
+/* Memory block of the metadata arena; the data follows the header */
+typedef struct espa_arena_block
+{
+    struct espa_arena_block *next;  /* next (older) block in the arena */
+    size_t size;                 /* number of data bytes in the block */
+    size_t used;                 /* number of data bytes handed out */
+} Espa_arena_block_t;
+
+/* Arena holding the variable-length band arrays (bitmap descriptions, classes
+   and cover types) of a metadata structure, which are released all at once */
+typedef struct
+{
+    Espa_arena_block_t *blocks;  /* list of blocks, current block first */
+} Espa_meta_arena_t;
+
 typedef struct
 {
     char product[STR_SIZE];      /* product type */
@@ -187,6 +279,22 @@ typedef struct
     Espa_class_t *class_values;  /* support class value descriptions */
     int ncover;                  /* number of cover types in percent_coverage */
     Espa_percent_cover_t *percent_cover; /* support percent cover description */
+    Espa_band_stats_t stats;     /* statistics of the band pixel values */
+    char checksum[STR_SIZE];     /* CRC32C of the band file as 8 hexadecimal
+                                    digits; empty if there is no checksum */
+    Espa_sub_sample_t sub_sample; /* sub-sampling of the band (see
+                                    read_raw_binary_upsampled) */
+    Espa_constant_t constant;    /* constant value of the band, if it is
+                                    a constant band */
+    Espa_derived_t derived;      /* expression of the band, if it is a
+                                    derived band */
+    Espa_tiling_t tiling;        /* tile size of the band, if it is a tiled
+                                    band */
+    Espa_provenance_t provenance;  /* stage which wrote the band, if it was
+                                    written by a pipeline stage */
+    Espa_meta_arena_t *arena;    /* arena holding the bitmap_description,
+                                    class_values and percent_cover arrays;
+                                    NULL if they are individually allocated */
     char qa_desc[HUGE_STR_SIZE]; /* description of the QA bits where
                                     they are not bit-specific and don't fit
                                     as classes */
@@ -195,26 +303,132 @@ typedef struct
     char production_date[STR_SIZE];  /* date the band was produced */
 } Espa_band_meta_t;
 
+/* Band metadata fields which are indexed for the band lookups */
+typedef enum
+{
+    ESPA_BAND_KEY_NAME,
+    ESPA_BAND_KEY_PRODUCT,
+    ESPA_BAND_KEY_CATEGORY,
+    ESPA_BAND_NKEYS
+} Espa_band_key_t;
+
+/* Compact copy of the band fields read by the band scans and lookups.  A
+   band's metadata spans tens of kilobytes, mostly descriptive strings, so
+   the index keeps these fields in a packed array (about 80 bytes a band)
+   which scans can walk without touching the full band metadata.  The
+   strings are interned in the string pool of the index, so equal strings
+   have the same offset. */
+typedef struct
+{
+    unsigned int hash[ESPA_BAND_NKEYS];  /* hash of the name, product and
+                                    category */
+    int key[ESPA_BAND_NKEYS];    /* offset of the name, product and category
+                                    in the string pool */
+    int file_name;               /* offset of the file name in the string
+                                    pool */
+    enum Espa_data_type data_type;  /* data type of this band */
+    int nlines;                  /* number of lines in the dataset */
+    int nsamps;                  /* number of samples in the dataset */
+    long fill_value;             /* fill value of the band */
+    float scale_factor;          /* scaling factor */
+    float add_offset;            /* offset to be added */
+    double pixel_size[2];        /* pixel size x, y */
+} Espa_band_hot_t;
+
+/* Hashed index of the bands by name, product and category.  Each hash table
+   slot holds the first band hashing to it and the bands in a slot are chained
+   in band order, so a lookup returns the same band as a linear search. */
+typedef struct
+{
+    Espa_band_meta_t *band;      /* band array the index was built for */
+    int nbands;                  /* number of bands in the index */
+    int nslots;                  /* number of slots in each hash table; power
+                                    of 2 */
+    int *slot[ESPA_BAND_NKEYS];  /* first band in each slot; -1 if empty */
+    int *next[ESPA_BAND_NKEYS];  /* next band in the same slot; -1 at the end
+                                    of the chain */
+    Espa_band_hot_t *hot;        /* compact copy of each band */
+    char *strings;               /* string pool of the compact bands */
+} Espa_band_index_t;
+
 typedef struct
 {
     char meta_namespace[STR_SIZE];  /* namespace for this metadata file */
     Espa_global_meta_t global;  /* global metadata */
     int nbands;                 /* number of bands in the metadata file */
     Espa_band_meta_t *band;     /* array of band metadata */
+    Espa_meta_arena_t *arena;   /* arena for the band arrays; NULL until the
+                                   first band is allocated */
+    Espa_band_index_t *band_index;  /* lookup index of the bands; NULL until
+                                       it is built */
+    char *lazy_file;            /* XML file the band details still need to
+                                   be loaded from (see load_band_details);
+                                   NULL if they have been loaded */
 } Espa_internal_meta_t;
 
 /* Prototypes */
+int load_espa_schema
+(
+    char *schema_file       /* I: name of schema file or URL to be compiled;
+                                  NULL to use the default locations */
+);
+
+void free_espa_schema ();
+
+void init_espa_xml ();
+
+void cleanup_espa_xml ();
+
 int validate_xml_file
 (
     char *meta_file           /* I: name of metadata file to be validated */
 );
 
+int validate_xml_files
+(
+    int nfiles,               /* I: number of XML files */
+    char **meta_file,         /* I: names of the XML files to be validated */
+    int nthreads,             /* I: number of threads validating the files */
+    int *file_status,         /* O: status of the validation of each file
+                                    (SUCCESS or ERROR); NULL if not needed */
+    int *nfailed              /* O: number of files failing to validate */
+);
+
 void init_metadata_struct
 (
     Espa_internal_meta_t *internal_meta   /* I: pointer to internal metadata
                                                 structure to be initialized */
 );
 
+void init_band_metadata
+(
+    Espa_band_meta_t *bmeta   /* I: pointer to band metadata structure */
+);
+
+Espa_meta_arena_t *get_metadata_arena
+(
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure */
+);
+
+void *alloc_metadata_arena
+(
+    Espa_meta_arena_t *arena,  /* I/O: arena to allocate from */
+    size_t size                /* I: number of bytes to allocate */
+);
+
+char *intern_metadata_string
+(
+    Espa_band_meta_t *bmeta,   /* I/O: band metadata structure owning the
+                                       string */
+    const char *str            /* I: string to be stored */
+);
+
+void free_metadata_arena
+(
+    Espa_meta_arena_t *arena   /* I: arena to be freed; may be NULL */
+);
+
 int allocate_band_metadata
 (
     Espa_internal_meta_t *internal_meta,  /* I: pointer to internal metadata
@@ -233,7 +447,8 @@ int allocate_class_metadata
 
 int allocate_percent_coverage_metadata
 (
-    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */    int ncover                    /* I: number of cover types to allocate for
+    Espa_band_meta_t *band_meta,  /* I: pointer to band metadata structure */
+    int ncover                    /* I: number of cover types to allocate for
                                         the band metadata */
 );
 
@@ -244,6 +459,79 @@ int allocate_bitmap_metadata
                                         bitmap metadata */
 );
 
+int merge_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to append the bands
+                                                  to */
+    Espa_internal_meta_t *src_meta        /* I/O: pointer to internal metadata
+                                                  structure containing the
+                                                  bands to be moved; bands are
+                                                  removed upon return */
+);
+
+int remove_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to remove the band
+                                                  from */
+    int band_index                        /* I: index of the band */
+);
+
+int build_band_index
+(
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure to be indexed */
+);
+
+void free_band_index
+(
+    Espa_internal_meta_t *internal_meta   /* I/O: pointer to internal metadata
+                                                  structure */
+);
+
+const Espa_band_hot_t *get_band_hot
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure */
+    int band                              /* I: index of the band */
+);
+
+const char *get_band_hot_string
+(
+    const Espa_internal_meta_t *internal_meta,  /* I: pointer to internal
+                                                  metadata structure */
+    int offset                            /* I: offset of the string from
+                                                the compact band */
+);
+
+int find_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to be searched */
+    const char *product,                  /* I: product of the band; NULL
+                                                for any product */
+    const char *name,                     /* I: name of the band; NULL for
+                                                any name */
+    const char *category                  /* I: category of the band; NULL
+                                                for any category */
+);
+
+int find_next_band_metadata
+(
+    Espa_internal_meta_t *internal_meta,  /* I/O: pointer to internal metadata
+                                                  structure to be searched */
+    int prev,                             /* I: band returned by the previous
+                                                search; -1 to start from the
+                                                first band */
+    const char *product,                  /* I: product of the band; NULL
+                                                for any product */
+    const char *name,                     /* I: name of the band; NULL for
+                                                any name */
+    const char *category                  /* I: category of the band; NULL
+                                                for any category */
+);
+
 void free_metadata
 (
     Espa_internal_meta_t *internal_meta   /* I: pointer to internal metadata
@@ -0,0 +1,739 @@
+/*****************************************************************************
+FILE: metadata_cache.c
+
+PURPOSE: Contains functions for reading and writing the binary sidecar cache
+of the parsed ESPA internal metadata, so the XML doesn't need to be parsed
+again by each application which reads it, and for the writer stamp which
+lets the schema validation be skipped for XML written by this library.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The sidecar is only used if the ESPA_METADATA_CACHE environment variable
+     is set to "sidecar".
+  2. The sidecar is a header followed by the namespace, the global metadata,
+     and each band structure followed by its bitmap descriptions, classes and
+     cover types.  The structures are stored as they are in memory, so the
+     header also records their sizes and the sidecar is ignored if they don't
+     match (i.e. it was written by a different build of the library).
+  3. The sidecar is only used if the size, modification time and CRC32C of
+     the XML file match the ones it was written for.  Anything else, such as
+     a missing, stale, truncated or corrupt sidecar, falls back to parsing the
+     XML file.
+  4. The writer stamp is only written and trusted if the ESPA_XML_VALIDATION
+     environment variable is set to "stamp".  It uses the same key as the
+     sidecar, so any change to the XML file after it was written by this
+     library (e.g. by another tool or by hand) brings back the full schema
+     validation.
+*****************************************************************************/
+
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "metadata_cache.h"
+#include "raw_binary_checksum.h"
+
+/* Header of the sidecar */
+typedef struct
+{
+    char magic[8];                /* METADATA_CACHE_MAGIC */
+    int32_t version;              /* METADATA_CACHE_VERSION */
+    int32_t global_size;          /* size of Espa_global_meta_t */
+    int32_t band_size;            /* size of Espa_band_meta_t */
+    int32_t str_size;             /* STR_SIZE */
+    int32_t nbands;               /* number of bands */
+    uint32_t data_crc;            /* CRC32C of the data after the header */
+    uint64_t data_size;           /* size of the data after the header */
+    int64_t xml_size;             /* size of the XML file */
+    int64_t xml_mtime_sec;        /* modification time of the XML file */
+    int64_t xml_mtime_nsec;       /* nanoseconds of the modification time */
+    uint32_t xml_crc;             /* CRC32C of the XML file */
+    uint32_t reserved;            /* unused; 0 */
+} Metadata_cache_header_t;
+
+/* Position in the sidecar data as it is unpacked */
+typedef struct
+{
+    const char *ptr;              /* next byte of the data */
+    size_t left;                  /* number of bytes left in the data */
+} Metadata_cache_cursor_t;
+
+/* Contents of the writer stamp */
+typedef struct
+{
+    char magic[8];                /* METADATA_STAMP_MAGIC */
+    int32_t version;              /* METADATA_STAMP_VERSION */
+    char schema_version[12];      /* ESPA_SCHEMA_VERSION */
+    int64_t xml_size;             /* size of the XML file */
+    int64_t xml_mtime_sec;        /* modification time of the XML file */
+    int64_t xml_mtime_nsec;       /* nanoseconds of the modification time */
+    uint32_t xml_crc;             /* CRC32C of the XML file */
+    uint32_t reserved;            /* unused; 0 */
+} Metadata_stamp_t;
+
+
+/******************************************************************************
+MODULE: use_metadata_cache
+
+PURPOSE: Determines if the metadata sidecar was requested via the
+ESPA_METADATA_CACHE environment variable.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_METADATA_CACHE is "sidecar"
+false        ESPA_METADATA_CACHE isn't set, or is anything else
+
+NOTES:
+*****************************************************************************/
+bool use_metadata_cache ()
+{
+    char *cache = getenv ("ESPA_METADATA_CACHE");  /* requested cache */
+
+    return (cache != NULL && !strcmp (cache, "sidecar"));
+}
+
+
+/******************************************************************************
+MODULE: use_metadata_stamp
+
+PURPOSE: Determines if the writer stamp was requested via the
+ESPA_XML_VALIDATION environment variable.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_XML_VALIDATION is "stamp"
+false        ESPA_XML_VALIDATION isn't set, or is anything else (i.e. all
+             XML files are fully validated)
+
+NOTES:
+*****************************************************************************/
+bool use_metadata_stamp ()
+{
+    char *validation = getenv ("ESPA_XML_VALIDATION");  /* requested mode */
+
+    return (validation != NULL && !strcmp (validation, "stamp"));
+}
+
+
+/******************************************************************************
+MODULE: get_cache_name
+
+PURPOSE: Builds the name of the sidecar or writer stamp for the XML file.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The name was built
+false        The name is too long
+
+NOTES:
+*****************************************************************************/
+static bool get_cache_name
+(
+    const char *xml_file,         /* I: name of the XML metadata file */
+    const char *ext,              /* I: extension of the sidecar */
+    char cache_file[PATH_MAX]     /* O: name of the sidecar */
+)
+{
+    int count;                    /* number of characters in the name */
+
+    count = snprintf (cache_file, PATH_MAX, "%s%s", xml_file, ext);
+    return (count > 0 && count < PATH_MAX);
+}
+
+
+/******************************************************************************
+MODULE: get_cache_key
+
+PURPOSE: Determines the size, modification time and CRC32C of the XML file.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The key was determined
+false        The XML file isn't a regular file or couldn't be read
+
+NOTES:
+  1. The XML file is read with a single read; the metadata files are small.
+*****************************************************************************/
+static bool get_cache_key
+(
+    const char *xml_file,         /* I: name of the XML metadata file */
+    Metadata_cache_key_t *key     /* O: key of the XML file */
+)
+{
+    struct stat xml_stat;         /* status of the XML file */
+    char *xml_text = NULL;        /* contents of the XML file */
+    FILE *fptr = NULL;            /* file pointer to the XML file */
+    bool status;                  /* was the XML file read */
+
+    key->valid = false;
+    if (stat (xml_file, &xml_stat) != 0 || !S_ISREG (xml_stat.st_mode))
+        return (false);
+
+    xml_text = malloc (xml_stat.st_size > 0 ? xml_stat.st_size : 1);
+    if (xml_text == NULL)
+        return (false);
+    fptr = fopen (xml_file, "r");
+    if (fptr == NULL)
+    {
+        free (xml_text);
+        return (false);
+    }
+    status = (fread (xml_text, 1, xml_stat.st_size, fptr)
+        == (size_t) xml_stat.st_size);
+    fclose (fptr);
+
+    if (status)
+    {
+        key->size = xml_stat.st_size;
+        key->mtime_sec = xml_stat.st_mtim.tv_sec;
+        key->mtime_nsec = xml_stat.st_mtim.tv_nsec;
+        key->crc = update_raw_binary_crc32c (0, xml_text, xml_stat.st_size);
+        key->valid = true;
+    }
+    free (xml_text);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: take_cache_data
+
+PURPOSE: Returns the next nbytes of the sidecar data and moves past them.
+
+RETURN VALUE:
+Type = const void *
+Value        Description
+-----        -----------
+NULL         There aren't nbytes left in the data
+non-NULL     Pointer to the bytes
+
+NOTES:
+*****************************************************************************/
+static const void *take_cache_data
+(
+    Metadata_cache_cursor_t *cursor,  /* I/O: position in the data */
+    size_t nbytes                     /* I: number of bytes to take */
+)
+{
+    const char *ptr = cursor->ptr;    /* start of the bytes */
+
+    if (nbytes > cursor->left)
+        return (NULL);
+    cursor->ptr += nbytes;
+    cursor->left -= nbytes;
+    return (ptr);
+}
+
+
+/******************************************************************************
+MODULE: unpack_band
+
+PURPOSE: Unpacks a band and its bitmap descriptions, classes and cover types
+from the sidecar data.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the band arrays, or the data is malformed
+SUCCESS      The band was unpacked
+
+NOTES:
+  1. The band has been initialized by allocate_band_metadata, so the arrays
+     come from the arena of the metadata structure.
+*****************************************************************************/
+static int unpack_band
+(
+    Metadata_cache_cursor_t *cursor,  /* I/O: position in the data */
+    Espa_band_meta_t *bmeta           /* O: band metadata */
+)
+{
+    Espa_meta_arena_t *arena = bmeta->arena;  /* arena of the band */
+    const void *src = NULL;           /* band data in the sidecar */
+    int nbits, nclass, ncover;        /* number of bits, classes and covers */
+    int i;                            /* looping variable */
+
+    src = take_cache_data (cursor, sizeof (Espa_band_meta_t));
+    if (src == NULL)
+        return (ERROR);
+    memcpy (bmeta, src, sizeof (Espa_band_meta_t));
+    bmeta->arena = arena;
+    bmeta->bitmap_description = NULL;
+    bmeta->class_values = NULL;
+    bmeta->percent_cover = NULL;
+    nbits = bmeta->nbits;
+    nclass = bmeta->nclass;
+    ncover = bmeta->ncover;
+
+    if (nbits > 0)
+    {
+        if ((size_t) nbits > cursor->left / STR_SIZE ||
+            allocate_bitmap_metadata (bmeta, nbits) != SUCCESS)
+            return (ERROR);
+        src = take_cache_data (cursor, (size_t) nbits * STR_SIZE);
+        for (i = 0; i < nbits; i++)
+            memcpy (bmeta->bitmap_description[i], (const char *) src
+                + (size_t) i * STR_SIZE, STR_SIZE);
+    }
+
+    if (nclass > 0)
+    {
+        if ((size_t) nclass > cursor->left / sizeof (Espa_class_t) ||
+            allocate_class_metadata (bmeta, nclass) != SUCCESS)
+            return (ERROR);
+        src = take_cache_data (cursor, nclass * sizeof (Espa_class_t));
+        memcpy (bmeta->class_values, src, nclass * sizeof (Espa_class_t));
+    }
+
+    if (ncover > 0)
+    {
+        if ((size_t) ncover > cursor->left / sizeof (Espa_percent_cover_t) ||
+            allocate_percent_coverage_metadata (bmeta, ncover) != SUCCESS)
+            return (ERROR);
+        src = take_cache_data (cursor, ncover * sizeof (Espa_percent_cover_t));
+        memcpy (bmeta->percent_cover, src,
+            ncover * sizeof (Espa_percent_cover_t));
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_metadata_cache
+
+PURPOSE: Loads the metadata from the sidecar of the XML file, if there is a
+sidecar and it was written for the current XML file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error indexing the bands of the loaded metadata
+SUCCESS      The metadata was loaded, or loaded is false and the XML file
+             needs to be parsed
+
+NOTES:
+  1. The key of the XML file is returned even if the sidecar isn't used, so
+     a new sidecar can be written for the XML file once it's parsed.  Taking
+     the key before parsing means a sidecar is never written for a newer XML
+     file than the one which was parsed.
+  2. The sidecar is read with a single read.
+  3. If the sidecar can't be used the metadata structure is left as it was
+     initialized.
+*****************************************************************************/
+int read_metadata_cache
+(
+    char *xml_file,                 /* I: name of the XML metadata file */
+    Metadata_cache_key_t *key,      /* O: key of the current XML file */
+    Espa_internal_meta_t *metadata, /* O: metadata loaded from the sidecar;
+                                          initialized via
+                                          init_metadata_struct */
+    bool *loaded                    /* O: was the metadata loaded */
+)
+{
+    char FUNC_NAME[] = "read_metadata_cache";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char cache_file[PATH_MAX];        /* name of the sidecar */
+    char *data = NULL;                /* contents of the sidecar */
+    struct stat cache_stat;           /* status of the sidecar */
+    FILE *fptr = NULL;                /* file pointer to the sidecar */
+    Metadata_cache_header_t header;   /* header of the sidecar */
+    Metadata_cache_cursor_t cursor;   /* position in the sidecar data */
+    const void *src = NULL;           /* data in the sidecar */
+    int status = SUCCESS;             /* status of unpacking the bands */
+    int i;                            /* looping variable */
+
+    *loaded = false;
+    if (!get_cache_key (xml_file, key) || !get_cache_name (xml_file,
+        METADATA_CACHE_EXT, cache_file))
+        return (SUCCESS);
+
+    /* Read the whole sidecar */
+    fptr = fopen (cache_file, "rb");
+    if (fptr == NULL)
+        return (SUCCESS);
+    if (fstat (fileno (fptr), &cache_stat) != 0 ||
+        cache_stat.st_size < (off_t) sizeof (header) ||
+        (data = malloc (cache_stat.st_size)) == NULL ||
+        fread (data, 1, cache_stat.st_size, fptr)
+        != (size_t) cache_stat.st_size)
+    {
+        fclose (fptr);
+        free (data);
+        return (SUCCESS);
+    }
+    fclose (fptr);
+
+    /* Make sure it has the same layout and was written for this XML file */
+    memcpy (&header, data, sizeof (header));
+    cursor.ptr = data + sizeof (header);
+    cursor.left = cache_stat.st_size - sizeof (header);
+    if (memcmp (header.magic, METADATA_CACHE_MAGIC, sizeof (header.magic)) ||
+        header.version != METADATA_CACHE_VERSION ||
+        header.global_size != (int32_t) sizeof (Espa_global_meta_t) ||
+        header.band_size != (int32_t) sizeof (Espa_band_meta_t) ||
+        header.str_size != STR_SIZE || header.nbands < 0 ||
+        header.data_size != cursor.left ||
+        header.xml_size != key->size ||
+        header.xml_mtime_sec != key->mtime_sec ||
+        header.xml_mtime_nsec != key->mtime_nsec ||
+        header.xml_crc != key->crc ||
+        header.data_crc != update_raw_binary_crc32c (0, cursor.ptr,
+        cursor.left))
+    {
+        free (data);
+        return (SUCCESS);
+    }
+
+    /* Unpack the namespace and global metadata */
+    src = take_cache_data (&cursor, sizeof (metadata->meta_namespace));
+    if (src == NULL)
+        status = ERROR;
+    else
+    {
+        memcpy (metadata->meta_namespace, src,
+            sizeof (metadata->meta_namespace));
+        src = take_cache_data (&cursor, sizeof (Espa_global_meta_t));
+        if (src == NULL)
+            status = ERROR;
+        else
+            memcpy (&metadata->global, src, sizeof (Espa_global_meta_t));
+    }
+
+    /* Unpack the bands */
+    if (status == SUCCESS && header.nbands > 0)
+    {
+        if ((size_t) header.nbands > cursor.left / sizeof (Espa_band_meta_t)
+            || allocate_band_metadata (metadata, header.nbands) != SUCCESS)
+            status = ERROR;
+        for (i = 0; status == SUCCESS && i < header.nbands; i++)
+            status = unpack_band (&cursor, &metadata->band[i]);
+    }
+    free (data);
+
+    if (status != SUCCESS || cursor.left != 0)
+    {
+        /* Fall back to parsing the XML file */
+        free_metadata (metadata);
+        init_metadata_struct (metadata);
+        return (SUCCESS);
+    }
+
+    /* Index the bands for the band lookups */
+    if (build_band_index (metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the bands of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *loaded = true;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_metadata_cache
+
+PURPOSE: Writes the sidecar for the metadata parsed from the XML file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the sidecar
+SUCCESS      The sidecar was written, or there is no key for the XML file
+
+NOTES:
+  1. The sidecar is written to a temporary file that is renamed into place,
+     so concurrent readers never see a partial sidecar.
+  2. A failure is reported as a warning, since the sidecar is optional and
+     the parsed metadata can still be used.
+*****************************************************************************/
+int write_metadata_cache
+(
+    char *xml_file,                 /* I: name of the XML metadata file */
+    Metadata_cache_key_t *key,      /* I: key of the XML file the metadata
+                                          was parsed from */
+    Espa_internal_meta_t *metadata  /* I: parsed metadata */
+)
+{
+    char FUNC_NAME[] = "write_metadata_cache";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char cache_file[PATH_MAX];        /* name of the sidecar */
+    char tmpfile[PATH_MAX];           /* temporary name of the sidecar */
+    char *data = NULL;                /* data after the header */
+    char *ptr = NULL;                 /* current position in the data */
+    size_t data_size;                 /* size of the data after the header */
+    int i, j;                         /* looping variables */
+    bool written;                     /* was the sidecar written */
+    FILE *fptr = NULL;                /* file pointer to the sidecar */
+    Espa_band_meta_t *bmeta = NULL;   /* current band */
+    Espa_band_meta_t band;            /* band as stored in the sidecar */
+    Metadata_cache_header_t header;   /* header of the sidecar */
+
+    if (!key->valid)
+        return (SUCCESS);
+    if (!get_cache_name (xml_file, METADATA_CACHE_EXT, cache_file) ||
+        snprintf (tmpfile, PATH_MAX, "%s.%ld.tmp", cache_file,
+        (long) getpid ()) >= PATH_MAX)
+    {
+        sprintf (errmsg, "Metadata sidecar filename is too long");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Determine the size of the data */
+    data_size = sizeof (metadata->meta_namespace) + sizeof (Espa_global_meta_t)
+        + metadata->nbands * sizeof (Espa_band_meta_t);
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        bmeta = &metadata->band[i];
+        if (bmeta->nbits > 0)
+            data_size += (size_t) bmeta->nbits * STR_SIZE;
+        if (bmeta->nclass > 0)
+            data_size += bmeta->nclass * sizeof (Espa_class_t);
+        if (bmeta->ncover > 0)
+            data_size += bmeta->ncover * sizeof (Espa_percent_cover_t);
+    }
+
+    data = malloc (data_size);
+    if (data == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the metadata sidecar");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Pack the namespace, global metadata and bands */
+    ptr = data;
+    memcpy (ptr, metadata->meta_namespace, sizeof (metadata->meta_namespace));
+    ptr += sizeof (metadata->meta_namespace);
+    memcpy (ptr, &metadata->global, sizeof (Espa_global_meta_t));
+    ptr += sizeof (Espa_global_meta_t);
+    for (i = 0; i < metadata->nbands; i++)
+    {
+        bmeta = &metadata->band[i];
+        band = *bmeta;
+        band.bitmap_description = NULL;
+        band.class_values = NULL;
+        band.percent_cover = NULL;
+        band.arena = NULL;
+        memcpy (ptr, &band, sizeof (Espa_band_meta_t));
+        ptr += sizeof (Espa_band_meta_t);
+
+        for (j = 0; j < bmeta->nbits; j++)
+        {
+            memcpy (ptr, bmeta->bitmap_description[j], STR_SIZE);
+            ptr += STR_SIZE;
+        }
+        if (bmeta->nclass > 0)
+        {
+            memcpy (ptr, bmeta->class_values,
+                bmeta->nclass * sizeof (Espa_class_t));
+            ptr += bmeta->nclass * sizeof (Espa_class_t);
+        }
+        if (bmeta->ncover > 0)
+        {
+            memcpy (ptr, bmeta->percent_cover,
+                bmeta->ncover * sizeof (Espa_percent_cover_t));
+            ptr += bmeta->ncover * sizeof (Espa_percent_cover_t);
+        }
+    }
+
+    /* Fill in the header */
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, METADATA_CACHE_MAGIC, sizeof (header.magic));
+    header.version = METADATA_CACHE_VERSION;
+    header.global_size = sizeof (Espa_global_meta_t);
+    header.band_size = sizeof (Espa_band_meta_t);
+    header.str_size = STR_SIZE;
+    header.nbands = metadata->nbands;
+    header.data_crc = update_raw_binary_crc32c (0, data, data_size);
+    header.data_size = data_size;
+    header.xml_size = key->size;
+    header.xml_mtime_sec = key->mtime_sec;
+    header.xml_mtime_nsec = key->mtime_nsec;
+    header.xml_crc = key->crc;
+
+    /* Write the sidecar */
+    fptr = fopen (tmpfile, "wb");
+    if (fptr == NULL)
+    {
+        free (data);
+        sprintf (errmsg, "Unable to open the metadata sidecar %s", tmpfile);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    written = (fwrite (&header, sizeof (header), 1, fptr) == 1 &&
+        fwrite (data, 1, data_size, fptr) == data_size);
+    free (data);
+    if (fclose (fptr) != 0 || !written || rename (tmpfile, cache_file) != 0)
+    {
+        sprintf (errmsg, "Unable to write the metadata sidecar %s",
+            cache_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        unlink (tmpfile);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_metadata_stamp
+
+PURPOSE: Writes the writer stamp for an XML file which was just written by
+this library.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the stamp
+SUCCESS      The stamp was written, or the stamp isn't in use
+
+NOTES:
+  1. The stamp must be written after the XML file is complete, since it
+     records the size, modification time and CRC32C of the final file.
+  2. The stamp is written to a temporary file that is renamed into place.
+  3. A failure is reported as a warning and only means the XML file will be
+     fully validated; any stale stamp is removed so it can't be trusted.
+*****************************************************************************/
+int write_metadata_stamp
+(
+    char *xml_file                  /* I: name of the XML metadata file */
+)
+{
+    char FUNC_NAME[] = "write_metadata_stamp";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char stamp_file[PATH_MAX];        /* name of the stamp */
+    char tmpfile[PATH_MAX];           /* temporary name of the stamp */
+    bool written;                     /* was the stamp written */
+    FILE *fptr = NULL;                /* file pointer to the stamp */
+    Metadata_cache_key_t key;         /* key of the XML file */
+    Metadata_stamp_t stamp;           /* contents of the stamp */
+
+    if (!use_metadata_stamp ())
+        return (SUCCESS);
+    if (!get_cache_name (xml_file, METADATA_STAMP_EXT, stamp_file) ||
+        snprintf (tmpfile, PATH_MAX, "%s.%ld.tmp", stamp_file,
+        (long) getpid ()) >= PATH_MAX)
+    {
+        sprintf (errmsg, "XML writer stamp filename is too long");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (!get_cache_key (xml_file, &key))
+    {
+        unlink (stamp_file);
+        sprintf (errmsg, "Unable to read the XML file for its writer stamp");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&stamp, 0, sizeof (stamp));
+    memcpy (stamp.magic, METADATA_STAMP_MAGIC, sizeof (stamp.magic));
+    stamp.version = METADATA_STAMP_VERSION;
+    strncpy (stamp.schema_version, ESPA_SCHEMA_VERSION,
+        sizeof (stamp.schema_version) - 1);
+    stamp.xml_size = key.size;
+    stamp.xml_mtime_sec = key.mtime_sec;
+    stamp.xml_mtime_nsec = key.mtime_nsec;
+    stamp.xml_crc = key.crc;
+
+    /* Write the stamp */
+    fptr = fopen (tmpfile, "wb");
+    if (fptr == NULL)
+    {
+        unlink (stamp_file);
+        sprintf (errmsg, "Unable to open the XML writer stamp %s", tmpfile);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    written = (fwrite (&stamp, sizeof (stamp), 1, fptr) == 1);
+    if (fclose (fptr) != 0 || !written || rename (tmpfile, stamp_file) != 0)
+    {
+        unlink (tmpfile);
+        unlink (stamp_file);
+        sprintf (errmsg, "Unable to write the XML writer stamp %s",
+            stamp_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: is_metadata_stamped
+
+PURPOSE: Determines if the XML file is exactly as it was written by this
+version of the library, according to its writer stamp.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The stamp is in use and matches the XML file
+false        The stamp isn't in use, is missing or doesn't match the XML file
+
+NOTES:
+  1. The stamp must match the writer and schema versions of this library as
+     well as the size, modification time and CRC32C of the XML file.
+*****************************************************************************/
+bool is_metadata_stamped
+(
+    char *xml_file                  /* I: name of the XML metadata file */
+)
+{
+    char stamp_file[PATH_MAX];        /* name of the stamp */
+    char schema_version[12];          /* expected schema version */
+    bool status;                      /* was the stamp read */
+    FILE *fptr = NULL;                /* file pointer to the stamp */
+    Metadata_cache_key_t key;         /* key of the XML file */
+    Metadata_stamp_t stamp;           /* contents of the stamp */
+
+    if (!use_metadata_stamp () ||
+        !get_cache_name (xml_file, METADATA_STAMP_EXT, stamp_file))
+        return (false);
+
+    fptr = fopen (stamp_file, "rb");
+    if (fptr == NULL)
+        return (false);
+    status = (fread (&stamp, sizeof (stamp), 1, fptr) == 1);
+    fclose (fptr);
+
+    memset (schema_version, 0, sizeof (schema_version));
+    strncpy (schema_version, ESPA_SCHEMA_VERSION, sizeof (schema_version) - 1);
+    if (!status ||
+        memcmp (stamp.magic, METADATA_STAMP_MAGIC, sizeof (stamp.magic)) ||
+        stamp.version != METADATA_STAMP_VERSION ||
+        memcmp (stamp.schema_version, schema_version, sizeof (schema_version)))
+        return (false);
+
+    /* Check the stamp against the current XML file */
+    if (!get_cache_key (xml_file, &key))
+        return (false);
+    return (stamp.xml_size == key.size &&
+        stamp.xml_mtime_sec == key.mtime_sec &&
+        stamp.xml_mtime_nsec == key.mtime_nsec &&
+        stamp.xml_crc == key.crc);
+}
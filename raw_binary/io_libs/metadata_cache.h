@@ -0,0 +1,91 @@
+/*****************************************************************************
+FILE: metadata_cache.h
+
+PURPOSE: Contains defines, structures and prototypes for the binary sidecar
+cache of the parsed ESPA internal metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The sidecar is the XML filename with METADATA_CACHE_EXT appended.  It
+     holds a flat copy of the metadata structure, keyed on the size,
+     modification time and CRC32C of the XML file it was parsed from.
+  2. The writer stamp is the XML filename with METADATA_STAMP_EXT appended.
+     It records that the XML file was written by write_metadata or
+     append_metadata, using the same key, so validate_xml_file can skip the
+     schema validation of the file.
+*****************************************************************************/
+
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Extension appended to the XML filename for the sidecar */
+#define METADATA_CACHE_EXT ".mcache"
+
+/* Identifies the sidecar files and the version of their layout */
+#define METADATA_CACHE_MAGIC "ESPAMETA"
+#define METADATA_CACHE_VERSION 1
+
+/* Extension appended to the XML filename for the writer stamp */
+#define METADATA_STAMP_EXT ".stamp"
+
+/* Identifies the writer stamps and the version of the writer; the version
+   must be changed whenever the XML written by write_metadata changes */
+#define METADATA_STAMP_MAGIC "ESPASTMP"
+#define METADATA_STAMP_VERSION 1
+
+/* Identifies the XML file a sidecar was written for */
+typedef struct
+{
+    bool valid;           /* was the XML file found and read */
+    int64_t size;         /* size of the XML file */
+    int64_t mtime_sec;    /* modification time of the XML file */
+    int64_t mtime_nsec;   /* nanoseconds of the modification time */
+    uint32_t crc;         /* CRC32C of the XML file */
+} Metadata_cache_key_t;
+
+/* Prototypes */
+bool use_metadata_cache ();
+
+bool use_metadata_stamp ();
+
+int read_metadata_cache
+(
+    char *xml_file,                 /* I: name of the XML metadata file */
+    Metadata_cache_key_t *key,      /* O: key of the current XML file */
+    Espa_internal_meta_t *metadata, /* O: metadata loaded from the sidecar;
+                                          initialized via
+                                          init_metadata_struct */
+    bool *loaded                    /* O: was the metadata loaded */
+);
+
+int write_metadata_cache
+(
+    char *xml_file,                 /* I: name of the XML metadata file */
+    Metadata_cache_key_t *key,      /* I: key of the XML file the metadata
+                                          was parsed from */
+    Espa_internal_meta_t *metadata  /* I: parsed metadata */
+);
+
+int write_metadata_stamp
+(
+    char *xml_file                  /* I: name of the XML metadata file */
+);
+
+bool is_metadata_stamped
+(
+    char *xml_file                  /* I: name of the XML metadata file */
+);
+
+#endif
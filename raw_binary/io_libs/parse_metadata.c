@@ -1,6 +1,6 @@
 /*****************************************************************************
 FILE: parse_metadata.c
-  
+
 PURPOSE: Contains functions for parsing the ESPA internal metadata files.
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
@@ -14,304 +14,225 @@ NOTES:
      The schema for the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
   2. This code relies on the libxml2 library developed for the Gnome project.
+  3. The metadata file is parsed in a single pass with the libxml2 text
+     reader, and the values are stored directly in the ESPA internal metadata
+     structure as the elements are read.  No document tree is built.
+  4. The element and attribute names returned by the reader are interned in
+     the reader's dictionary.  The names known to this parser are interned in
+     the same dictionary and placed in a small hash table keyed on the string
+     address, so each name is identified with a pointer lookup rather than a
+     string comparison.
 *****************************************************************************/
 
-#include "espa_metadata.h"
+#include <stdint.h>
+#include "parse_metadata.h"
+#include "metadata_cache.h"
+#include "espa_profile.h"
+
+/* Identifiers for the element and attribute names known to the parser.  The
+   order must match that of xml_names. */
+typedef enum
+{
+    XN_UNKNOWN = -1,
+    /* Sections */
+    XN_GLOBAL_METADATA, XN_BANDS, XN_BAND,
+    /* Global metadata elements */
+    XN_DATA_PROVIDER, XN_SATELLITE, XN_INSTRUMENT, XN_ACQUISITION_DATE,
+    XN_SCENE_CENTER_TIME, XN_LEVEL1_PRODUCTION_DATE, XN_SOLAR_ANGLES,
+    XN_EARTH_SUN_DISTANCE, XN_WRS, XN_MODIS, XN_LPGS_METADATA_FILE,
+    XN_PRODUCT_ID, XN_CORNER, XN_BOUNDING_COORDINATES, XN_WEST, XN_EAST,
+    XN_NORTH, XN_SOUTH, XN_PROJECTION_INFORMATION, XN_ORIENTATION_ANGLE,
+    XN_VALID_MASK,
+    /* Projection information elements */
+    XN_CORNER_POINT, XN_GRID_ORIGIN, XN_UTM_PROJ_PARAMS, XN_PS_PROJ_PARAMS,
+    XN_ALBERS_PROJ_PARAMS, XN_SIN_PROJ_PARAMS, XN_ZONE_CODE,
+    XN_LONGITUDE_POLE, XN_LATITUDE_TRUE_SCALE, XN_FALSE_EASTING,
+    XN_FALSE_NORTHING, XN_STANDARD_PARALLEL1, XN_STANDARD_PARALLEL2,
+    XN_CENTRAL_MERIDIAN, XN_ORIGIN_LATITUDE, XN_SPHERE_RADIUS,
+    /* Band elements */
+    XN_SHORT_NAME, XN_LONG_NAME, XN_FILE_NAME, XN_PIXEL_SIZE,
+    XN_RESAMPLE_METHOD, XN_DATA_UNITS, XN_VALID_RANGE, XN_RADIANCE,
+    XN_REFLECTANCE, XN_THERMAL_CONST, XN_QA_DESCRIPTION, XN_APP_VERSION,
+    XN_PRODUCTION_DATE, XN_BITMAP_DESCRIPTION, XN_BIT, XN_CLASS_VALUES,
+    XN_CLASS, XN_PERCENT_COVERAGE, XN_COVER, XN_STATISTICS, XN_HISTOGRAM,
+    XN_CHECKSUM, XN_SUB_SAMPLE, XN_CONSTANT,
+    XN_DERIVED, XN_TILING, XN_PROVENANCE,
+    /* Attributes */
+    XN_ZENITH, XN_AZIMUTH, XN_UNITS, XN_SYSTEM, XN_PATH, XN_ROW, XN_HTILE,
+    XN_VTILE, XN_LOCATION, XN_LATITUDE, XN_LONGITUDE, XN_PROJECTION,
+    XN_DATUM, XN_X, XN_Y, XN_PRODUCT, XN_SOURCE, XN_NAME, XN_CATEGORY,
+    XN_DATA_TYPE, XN_NLINES, XN_NSAMPS, XN_FILL_VALUE, XN_SATURATE_VALUE,
+    XN_SCALE_FACTOR, XN_ADD_OFFSET, XN_MIN, XN_MAX, XN_GAIN, XN_BIAS, XN_K1,
+    XN_K2, XN_NUM, XN_TYPE, XN_VALID_PIXELS, XN_FILL_PIXELS,
+    XN_OUT_OF_RANGE_PIXELS, XN_MEAN, XN_STDDEV, XN_NBINS, XN_FACTOR,
+    XN_VALUE, XN_FILL_BAND, XN_EXPRESSION, XN_STAGE, XN_KEY,
+    XN_NUM_NAMES
+} Xml_name_t;
+
+static const char *xml_names[XN_NUM_NAMES] =
+{
+    "global_metadata", "bands", "band",
+    "data_provider", "satellite", "instrument", "acquisition_date",
+    "scene_center_time", "level1_production_date", "solar_angles",
+    "earth_sun_distance", "wrs", "modis", "lpgs_metadata_file",
+    "product_id", "corner", "bounding_coordinates", "west", "east",
+    "north", "south", "projection_information", "orientation_angle",
+    "valid_mask",
+    "corner_point", "grid_origin", "utm_proj_params", "ps_proj_params",
+    "albers_proj_params", "sin_proj_params", "zone_code",
+    "longitude_pole", "latitude_true_scale", "false_easting",
+    "false_northing", "standard_parallel1", "standard_parallel2",
+    "central_meridian", "origin_latitude", "sphere_radius",
+    "short_name", "long_name", "file_name", "pixel_size",
+    "resample_method", "data_units", "valid_range", "radiance",
+    "reflectance", "thermal_const", "qa_description", "app_version",
+    "production_date", "bitmap_description", "bit", "class_values",
+    "class", "percent_coverage", "cover", "statistics", "histogram",
+    "checksum", "sub_sample", "constant",
+    "derived", "tiling", "provenance",
+    "zenith", "azimuth", "units", "system", "path", "row", "htile",
+    "vtile", "location", "latitude", "longitude", "projection",
+    "datum", "x", "y", "product", "source", "name", "category",
+    "data_type", "nlines", "nsamps", "fill_value", "saturate_value",
+    "scale_factor", "add_offset", "min", "max", "gain", "bias", "k1",
+    "k2", "num", "type", "valid_pixels", "fill_pixels",
+    "out_of_range_pixels", "mean", "stddev", "nbins", "factor",
+    "value", "fill_band", "expression", "stage", "key"
+};
+
+/* Size of the name hash table; must be a power of 2 larger than
+   XN_NUM_NAMES */
+#define XML_NAME_HASH_SIZE 256
+
+/* State of the metadata parser */
+typedef struct
+{
+    xmlTextReaderPtr reader;   /* reader for the XML file */
+    const xmlChar *espa_ns;    /* interned ESPA namespace */
+    const xmlChar *names[XN_NUM_NAMES];  /* interned known names */
+    const xmlChar *hash_key[XML_NAME_HASH_SIZE];  /* interned name for each
+                                  slot of the hash table; NULL if empty */
+    Xml_name_t hash_id[XML_NAME_HASH_SIZE];  /* name ID for each slot */
+    bool lazy;                 /* skip the band details (see
+                                  parse_metadata_lazy) */
+} Xml_parser_t;
+
 
 /******************************************************************************
-MODULE:  add_global_metadata_proj_info_albers
+MODULE:  hash_xml_name
 
-PURPOSE: Add the ALBERS projection elements node to the global metadata
-projection information structure.
+PURPOSE: Returns the hash table slot for an interned name.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the projection_info elements
-SUCCESS         Successful parse of the projection_info values
+slot            Starting slot in the hash table for this name
 
 NOTES:
 ******************************************************************************/
-int add_global_metadata_proj_info_albers
+static int hash_xml_name
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    const xmlChar *name         /* I: interned name */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata_proj_info_albers"; /* func name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
+    uintptr_t addr = (uintptr_t) name;   /* address of the name */
 
-    /* Make sure the projection type specified matches the projection
-       parameters type */
-    if (gmeta->proj_info.proj_type != GCTP_ALBERS_PROJ)
-    {
-        sprintf (errmsg, "Projection type is not ALBERS so the fact that "
-            "albers_proj_params exists is a mismatch in the "
-            "projection_information.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    return ((int) ((addr >> 3) ^ (addr >> 11)) & (XML_NAME_HASH_SIZE - 1));
+}
 
-    /* Process the siblings in the projection information */
-    for (cur_node = a_node->children; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
 
-        if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "standard_parallel1"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:albers_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.standard_parallel1 =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "standard_parallel2"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:albers_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.standard_parallel2 =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "central_meridian"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:albers_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.central_meridian =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "origin_latitude"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:albers_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.origin_latitude =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_easting"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing global_metadata:"
-                    "projection_information:albers_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.false_easting =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_northing"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:albers_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.false_northing =
-                atof ((const char *) child_node->content);
-        }
-        else
+/******************************************************************************
+MODULE:  init_xml_names
+
+PURPOSE: Interns the known element and attribute names in the dictionary of
+the parser's reader.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error interning the names
+SUCCESS         Successfully interned the names
+
+NOTES:
+******************************************************************************/
+static int init_xml_names
+(
+    Xml_parser_t *parser        /* I/O: parser state, with its reader */
+)
+{
+    char FUNC_NAME[] = "init_xml_names";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for names */
+    int slot;                   /* slot in the hash table */
+
+    /* Intern the namespace and names, and add the names to the hash table */
+    parser->espa_ns = xmlTextReaderConstString (parser->reader,
+        (const xmlChar *) ESPA_NS);
+    for (slot = 0; slot < XML_NAME_HASH_SIZE; slot++)
+        parser->hash_key[slot] = NULL;
+    for (i = 0; i < XN_NUM_NAMES; i++)
+    {
+        parser->names[i] = xmlTextReaderConstString (parser->reader,
+            (const xmlChar *) xml_names[i]);
+        if (parser->names[i] == NULL)
         {
-            sprintf (errmsg, "Unknown albers_proj_params element: %s",
-                cur_node->name);
-            error_handler (false, FUNC_NAME, errmsg);
+            sprintf (errmsg, "Interning the name %s", xml_names[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
+
+        slot = hash_xml_name (parser->names[i]);
+        while (parser->hash_key[slot] != NULL)
+            slot = (slot + 1) & (XML_NAME_HASH_SIZE - 1);
+        parser->hash_key[slot] = parser->names[i];
+        parser->hash_id[slot] = i;
     }
+    parser->lazy = false;
 
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  add_global_metadata_proj_info_ps
+MODULE:  init_xml_parser
 
-PURPOSE: Add the Polar Stereographic projection elements node to the global
-metadata projection information structure.
+PURPOSE: Opens the reader for the metadata file and interns the known element
+and attribute names in the reader's dictionary.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the projection_info elements
-SUCCESS         Successful parse of the projection_info values
+ERROR           Error setting up the reader
+SUCCESS         Successfully set up the reader
 
 NOTES:
 ******************************************************************************/
-int add_global_metadata_proj_info_ps
+static int init_xml_parser
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    char *metafile,             /* I: input metadata file or URL */
+    Xml_parser_t *parser        /* O: parser state */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata_proj_info_ps"; /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
+    char FUNC_NAME[] = "init_xml_parser";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
 
-    /* Make sure the projection type specified matches the projection
-       parameters type */
-    if (gmeta->proj_info.proj_type != GCTP_PS_PROJ)
+    /* Establish the reader for this metadata file */
+    init_espa_xml ();
+    parser->reader = xmlNewTextReaderFilename (metafile);
+    if (parser->reader == NULL)
     {
-        sprintf (errmsg, "Error: projection type is not PS so the fact that "
-            "ps_proj_params exists is a mismatch in projection_information.");
+        sprintf (errmsg, "Setting up reader for %s", metafile);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Process the siblings in the projection information */
-    for (cur_node = a_node->children; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
+    if (init_xml_names (parser) != SUCCESS)
     {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
-
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "longitude_pole"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:ps_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.longitude_pole =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "latitude_true_scale"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:ps_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.latitude_true_scale =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_easting"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:ps_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.false_easting =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_northing"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:ps_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.false_northing =
-                atof ((const char *) child_node->content);
-        }
-        else
-        {
-            sprintf (errmsg, "Unknown ps_proj_params element: %s",
-                cur_node->name);
-            error_handler (false, FUNC_NAME, errmsg);
-        }
+        xmlFreeTextReader (parser->reader);
+        return (ERROR);
     }
 
     return (SUCCESS);
@@ -319,931 +240,922 @@ int add_global_metadata_proj_info_ps
 
 
 /******************************************************************************
-MODULE:  add_global_metadata_proj_info_sin
+MODULE:  get_xml_name_id
 
-PURPOSE: Add the SIN projection elements node to the global metadata projection
-information structure.
+PURPOSE: Identifies the local name of the current element or attribute.
 
 RETURN VALUE:
-Type = int
+Type = Xml_name_t
 Value           Description
 -----           -----------
-ERROR           Error parsing the projection_info elements
-SUCCESS         Successful parse of the projection_info values
+XN_UNKNOWN      Name isn't known to the parser
+other           ID of the name
 
 NOTES:
+  1. Names from the reader's dictionary are found with the hash table.  If
+     the reader returned a string which isn't in the dictionary, the names are
+     compared directly.
 ******************************************************************************/
-int add_global_metadata_proj_info_sin
+static Xml_name_t get_xml_name_id
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    Xml_parser_t *parser        /* I: parser state */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata_proj_info_sin"; /* func name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
+    const xmlChar *name = NULL; /* local name of the current node */
+    int slot;                   /* slot in the hash table */
+    int i;                      /* looping variable for names */
 
-    /* Make sure the projection type specified matches the projection
-       parameters type */
-    if (gmeta->proj_info.proj_type != GCTP_SIN_PROJ)
+    name = xmlTextReaderConstLocalName (parser->reader);
+    if (name == NULL)
+        return (XN_UNKNOWN);
+
+    for (slot = hash_xml_name (name); parser->hash_key[slot] != NULL;
+         slot = (slot + 1) & (XML_NAME_HASH_SIZE - 1))
     {
-        sprintf (errmsg, "Projection type is not SIN so the fact that "
-            "sin_proj_params exists is a mismatch in the "
-            "projection_information.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        if (parser->hash_key[slot] == name)
+            return (parser->hash_id[slot]);
     }
 
-    /* Process the siblings in the projection information */
-    for (cur_node = a_node->children; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
+    for (i = 0; i < XN_NUM_NAMES; i++)
     {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
-
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "sphere_radius"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:sin_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.sphere_radius =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "central_meridian"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:sin_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.central_meridian =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_easting"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing global_metadata:"
-                    "projection_information:sin_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.false_easting =
-                atof ((const char *) child_node->content);
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "false_northing"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Error processing global_metadata:"
-                    "projection_information:sin_proj_params element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-    
-            /* Copy the content of the child node into the value for this
-               field */
-            gmeta->proj_info.false_northing =
-                atof ((const char *) child_node->content);
-        }
-        else
-        {
-            sprintf (errmsg, "Unknown sin_proj_params element: %s",
-                cur_node->name);
-            error_handler (false, FUNC_NAME, errmsg);
-        }
+        if (xmlStrEqual (name, parser->names[i]))
+            return (i);
     }
 
-    return (SUCCESS);
+    return (XN_UNKNOWN);
 }
 
 
 /******************************************************************************
-MODULE:  add_global_metadata_proj_info_utm
+MODULE:  next_child_element
 
-PURPOSE: Add the UTM projection elements node to the global metadata projection
-information structure.
+PURPOSE: Advances the reader to the next child element of the element at the
+specified depth.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the projection_info elements
-SUCCESS         Successful parse of the projection_info values
+-1              Error reading the XML file
+0               No more child elements; the reader is at the end of the parent
+1               Reader is at the next child element
 
 NOTES:
+  1. The caller must not call this for an empty parent element, since there
+     is no end element for it.
 ******************************************************************************/
-int add_global_metadata_proj_info_utm
+static int next_child_element
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    Xml_parser_t *parser,       /* I: parser state */
+    int parent_depth            /* I: depth of the parent element */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata_proj_info_utm"; /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
+    int status;                 /* status of reading the next node */
+    int node_type;              /* type of the current node */
 
-    /* Make sure the projection type specified matches the projection
-       parameters type */
-    if (gmeta->proj_info.proj_type != GCTP_UTM_PROJ)
+    while ((status = xmlTextReaderRead (parser->reader)) == 1)
     {
-        sprintf (errmsg, "Projection type is not UTM so the fact that "
-            "utm_proj_params exists is a mismatch in the "
-            "projection_information.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        node_type = xmlTextReaderNodeType (parser->reader);
+        if (node_type == XML_READER_TYPE_END_ELEMENT &&
+            xmlTextReaderDepth (parser->reader) == parent_depth)
+            return (0);
+        if (node_type == XML_READER_TYPE_ELEMENT)
+            return (1);
     }
 
-    /* Set up the current and child pointers */
-    cur_node = a_node->children;
-    child_node = cur_node->children;
+    return (-1);
+}
+
 
-    /* Process the zone code for UTM */
-    if (xmlStrEqual (cur_node->name, (const xmlChar *) "zone_code"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Error processing global_metadata:"
-                "projection_information:utm_proj_params element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+/******************************************************************************
+MODULE:  skip_element
 
-        /* Copy the content of the child node into the value for this
-           field */
-        gmeta->proj_info.utm_zone = atoi ((const char *) child_node->content);
-    }
-    else
+PURPOSE: Advances the reader to the end of the current element, skipping its
+contents.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the XML file
+SUCCESS         Reader is at the end of the current element
+
+NOTES:
+******************************************************************************/
+static int skip_element
+(
+    Xml_parser_t *parser        /* I: parser state */
+)
+{
+    int depth;                  /* depth of the element */
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while (xmlTextReaderRead (parser->reader) == 1)
     {
-        sprintf (errmsg, "Unknown utm_proj_params element: %s",
-            cur_node->name);
-        error_handler (false, FUNC_NAME, errmsg);
+        if (xmlTextReaderNodeType (parser->reader) ==
+            XML_READER_TYPE_END_ELEMENT &&
+            xmlTextReaderDepth (parser->reader) == depth)
+            return (SUCCESS);
     }
 
-    return (SUCCESS);
+    return (ERROR);
 }
 
 
 /******************************************************************************
-MODULE:  add_global_metadata_proj_info
+MODULE:  is_espa_element
 
-PURPOSE: Add the projection elements node to the global metadata structure.
+PURPOSE: Determines if the current element is in the ESPA namespace, writing
+a warning and skipping the element if it isn't.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the projection_info elements
-SUCCESS         Successful parse of the projection_info values
+-1              Error skipping the element
+0               Element isn't in the ESPA namespace and has been skipped
+1               Element is in the ESPA namespace
 
 NOTES:
 ******************************************************************************/
-int add_global_metadata_proj_info
+static int is_espa_element
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    Xml_parser_t *parser        /* I: parser state */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata_proj_info"; /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    xmlNsPtr ns = NULL;           /* pointer to the namespace */
-    xmlChar *attr_val = NULL;     /* attribute value */
-    bool is_ul = false;           /* is this the UL corner */
-    bool is_lr = false;           /* is this the LR corner */
-    double x, y;                  /* x/y values */
-    int count;                    /* number of chars copied in snprintf */
-
-    /* Set up the current and child pointers */
-    cur_node = a_node;
-    ns = cur_node->nsDef;
-    child_node = cur_node->children;
-
-    /* Verify the namespace of this node is our ESPA namespace.  If it isn't
-       then the element won't be added to the metadata structure. */
-    if (!xmlStrEqual (ns->href, (const xmlChar *) ESPA_NS))
-    {
-        sprintf (errmsg, "Skipping %s since it is not in the ESPA namespace",
-            cur_node->name);
-        error_handler (false, FUNC_NAME, errmsg);
-        return (SUCCESS);
-    }
-
-    /* Initialize the datum to no datum */
-    gmeta->proj_info.datum_type = ESPA_NODATUM;
+    char FUNC_NAME[] = "is_espa_element";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    const xmlChar *ns = NULL;   /* namespace of the current element */
+
+    ns = xmlTextReaderConstNamespaceUri (parser->reader);
+    if (ns == parser->espa_ns || xmlStrEqual (ns, parser->espa_ns))
+        return (1);
+
+    sprintf (errmsg, "Skipping %s since it is not in the ESPA namespace",
+        xmlTextReaderConstLocalName (parser->reader));
+    error_handler (false, FUNC_NAME, errmsg);
+    return (skip_element (parser) == SUCCESS ? 0 : -1);
+}
 
-    /* Handle the element attributes */
-    for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-    {
-        attr_val = xmlGetProp (cur_node, attr->name);
-        if (xmlStrEqual (attr->name, (const xmlChar *) "projection"))
-        {
-            if (xmlStrEqual (attr_val, (const xmlChar *) "GEO"))
-                gmeta->proj_info.proj_type = GCTP_GEO_PROJ;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "UTM"))
-                gmeta->proj_info.proj_type = GCTP_UTM_PROJ;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "PS"))
-                gmeta->proj_info.proj_type = GCTP_PS_PROJ;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "ALBERS"))
-                gmeta->proj_info.proj_type = GCTP_ALBERS_PROJ;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "SIN"))
-                gmeta->proj_info.proj_type = GCTP_SIN_PROJ;
-        }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "datum"))
-        {
-            if (xmlStrEqual (attr_val, (const xmlChar *) "WGS84"))
-                gmeta->proj_info.datum_type = ESPA_WGS84;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "NAD27"))
-                gmeta->proj_info.datum_type = ESPA_NAD27;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "NAD83"))
-                gmeta->proj_info.datum_type = ESPA_NAD83;
-        }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "units"))
-        {
-            count = snprintf (gmeta->proj_info.units,
-                sizeof (gmeta->proj_info.units), "%s", (const char *) attr_val);
-            if (count < 0 || count >= sizeof (gmeta->proj_info.units))
-            {
-                sprintf (errmsg, "Overflow of gmeta->proj_info.units string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else
-        {
-            sprintf (errmsg, "Unknown attribute for element (%s): %s",
-                cur_node->name, attr->name);
-            error_handler (false, FUNC_NAME, errmsg);
-        }
-        xmlFree (attr_val);
-    }
 
-    /* Process the siblings in the projection information */
-    for (cur_node = a_node->children; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
+/******************************************************************************
+MODULE:  skip_unknown_element
 
-        /* Check for the element nodes within the projection_information
-           element */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "corner_point"))
-        {
-            /* Handle the element attributes */
-            x = -9999.0;
-            y = -9999.0;
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-            {
-                attr_val = xmlGetProp (cur_node, attr->name);
-                if (xmlStrEqual (attr->name, (const xmlChar *) "location"))
-                {
-                    is_ul = false;
-                    is_lr = false;
-                    if (xmlStrEqual (attr_val, (const xmlChar *) "UL"))
-                        is_ul = true;
-                    else if (xmlStrEqual (attr_val, (const xmlChar *) "LR"))
-                        is_lr = true;
-                    else
-                    {
-                        sprintf (errmsg, "Unknown corner_point location "
-                            "specified (%s). UL and LR expected.", attr_val);
-                        error_handler (false, FUNC_NAME, errmsg);
-                    }
-                }
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "x"))
-                    x = atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "y"))
-                    y = atof ((const char *) attr_val);
-                else
-                {
-                    sprintf (errmsg, "unknown attribute for element (%s): %s",
-                        cur_node->name, attr->name);
-                    error_handler (false, FUNC_NAME, errmsg);
-                }
-                xmlFree (attr_val);
-            }
+PURPOSE: Writes a warning for an unknown element and skips it.
 
-            /* Populate the correct corner point */
-            if (is_ul)
-            {
-                gmeta->proj_info.ul_corner[0] = x;
-                gmeta->proj_info.ul_corner[1] = y;
-            }
-            else if (is_lr)
-            {
-                gmeta->proj_info.lr_corner[0] = x;
-                gmeta->proj_info.lr_corner[1] = y;
-            }
-        }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "grid_origin"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing global_metadata:"
-                    "projection_information element: %s.", cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error skipping the element
+SUCCESS         Element was skipped
 
-            /* Copy the content of the child node into the value for this
-               field */
-            count = snprintf (gmeta->proj_info.grid_origin,
-                sizeof (gmeta->proj_info.grid_origin), "%s", 
-                (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (gmeta->proj_info.grid_origin))
-            {
-                sprintf (errmsg, "Overflow of gmeta->proj_info.grid_origin");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "utm_proj_params"))
-        {
-            /* Handle the projection-specific parameters */
-            if (add_global_metadata_proj_info_utm (cur_node, gmeta))
-            {
-                sprintf (errmsg, "Processing projection_information:"
-                    "utm_proj_params elements");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "ps_proj_params"))
-        {
-            /* Handle the projection-specific parameters */
-            if (add_global_metadata_proj_info_ps (cur_node, gmeta))
-            {
-                sprintf (errmsg, "Processing projection_information:"
-                    "ps_proj_params elements");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "albers_proj_params"))
-        {
-            /* Handle the projection-specific parameters */
-            if (add_global_metadata_proj_info_albers (cur_node, gmeta))
-            {
-                sprintf (errmsg, "Processing projection_information:"
-                    "albers_proj_params elements");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "sin_proj_params"))
-        {
-            /* Handle the projection-specific parameters */
-            if (add_global_metadata_proj_info_sin (cur_node, gmeta))
-            {
-                sprintf (errmsg, "Processing projection_information:"
-                    "sin_proj_params elements");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else
-        {
-            sprintf (errmsg, "Unknown projection information element: %s",
-                cur_node->name);
-            error_handler (false, FUNC_NAME, errmsg);
-        }
-    }  /* end for cur_node */
+NOTES:
+******************************************************************************/
+static int skip_unknown_element
+(
+    Xml_parser_t *parser,       /* I: parser state */
+    const char *section         /* I: name of the section being parsed */
+)
+{
+    char FUNC_NAME[] = "skip_unknown_element";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
 
-    return (SUCCESS);
+    sprintf (errmsg, "Unknown %s element: %s", section,
+        xmlTextReaderConstLocalName (parser->reader));
+    error_handler (false, FUNC_NAME, errmsg);
+    return (skip_element (parser));
 }
 
 
 /******************************************************************************
-MODULE:  add_global_metadata_bounding_coords
+MODULE:  next_attribute
 
-PURPOSE: Add the bounding coords elements node to the global metadata structure
+PURPOSE: Moves the reader to the next attribute of the current element.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the bounding_coords elements
-SUCCESS         Successful parse of the bounding_coords values
+0               No more attributes; the reader is back at the element
+1               Reader is at the next attribute
 
 NOTES:
+  1. Namespace declarations are skipped.
 ******************************************************************************/
-int add_global_metadata_bounding_coords
+static int next_attribute
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    Xml_parser_t *parser,       /* I: parser state */
+    Xml_name_t *id,             /* O: ID of the attribute name */
+    const char **value          /* O: value of the attribute */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata_bounding_coords";/* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    xmlNsPtr ns = NULL;           /* pointer to the namespace */
-    int indx;                     /* index into the bounding coords array */
-
-    /* Set up the current and child pointers */
-    cur_node = a_node;
-    ns = cur_node->nsDef;
-    child_node = cur_node->children;
-
-    /* Verify the namespace of this node is our ESPA namespace.  If it isn't
-       then the element won't be added to the metadata structure. */
-    if (!xmlStrEqual (ns->href, (const xmlChar *) ESPA_NS))
+    while (xmlTextReaderMoveToNextAttribute (parser->reader) == 1)
     {
-        sprintf (errmsg, "Skipping %s since it is not in the ESPA namespace",
-            cur_node->name);
-        error_handler (false, FUNC_NAME, errmsg);
-        return (SUCCESS);
+        if (xmlTextReaderIsNamespaceDecl (parser->reader) == 1)
+            continue;
+
+        *id = get_xml_name_id (parser);
+        *value = (const char *) xmlTextReaderConstValue (parser->reader);
+        return (1);
     }
 
-    /* Look for the ESPA global metadata bounding coordinates elements and
-       process them */
-    indx = 0;
-    if (xmlStrEqual (cur_node->name, (const xmlChar *) "west"))
-        indx = ESPA_WEST;
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "east"))
-        indx = ESPA_EAST;
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "north"))
-        indx = ESPA_NORTH;
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "south"))
-        indx = ESPA_SOUTH;
-    else
+    xmlTextReaderMoveToElement (parser->reader);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  unknown_attribute
+
+PURPOSE: Writes a warning for an unknown attribute.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void unknown_attribute
+(
+    Xml_parser_t *parser        /* I: parser state, at the attribute */
+)
+{
+    char FUNC_NAME[] = "unknown_attribute";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    sprintf (errmsg, "Unknown attribute: %s",
+        xmlTextReaderConstLocalName (parser->reader));
+    error_handler (false, FUNC_NAME, errmsg);
+}
+
+
+/******************************************************************************
+MODULE:  copy_string
+
+PURPOSE: Copies a value to a metadata string, checking for overflow.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Value doesn't fit in the metadata string
+SUCCESS         Successfully copied the value
+
+NOTES:
+******************************************************************************/
+static int copy_string
+(
+    char *field,                /* O: metadata string */
+    size_t size,                /* I: size of the metadata string */
+    const char *value,          /* I: value to copy */
+    const char *field_name      /* I: name of the field for error messages */
+)
+{
+    char FUNC_NAME[] = "copy_string";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int count;                  /* number of chars copied in snprintf */
+
+    count = snprintf (field, size, "%s", value);
+    if (count < 0 || count >= size)
     {
-        sprintf (errmsg, "Unknown bounding coords element: %s", cur_node->name);
-        error_handler (false, FUNC_NAME, errmsg);
+        sprintf (errmsg, "Overflow of %s string", field_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_element_text
+
+PURPOSE: Reads the text content of the current element, leaving the reader at
+the end of the element.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Element has no text, or the text is too long
+SUCCESS         Successfully read the text
+
+NOTES:
+  1. Whitespace-only content is treated as no text, matching the text nodes
+     reported by the reader.
+******************************************************************************/
+static int read_element_text
+(
+    Xml_parser_t *parser,       /* I: parser state */
+    const char *section,        /* I: name of the section being parsed */
+    char *text,                 /* O: text of the element */
+    size_t size                 /* I: size of the text buffer */
+)
+{
+    char FUNC_NAME[] = "read_element_text";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char name[STR_SIZE];        /* name of the element */
+    const xmlChar *value = NULL;  /* value of the current text node */
+    int depth;                  /* depth of the element */
+    int node_type;              /* type of the current node */
+    size_t length = 0;          /* length of the text so far */
+    size_t value_len;           /* length of the current text node */
+    bool found_text = false;    /* was a text node found? */
+
+    snprintf (name, sizeof (name), "%s",
+        (const char *) xmlTextReaderConstLocalName (parser->reader));
+    text[0] = '\0';
+    if (!xmlTextReaderIsEmptyElement (parser->reader))
+    {
+        depth = xmlTextReaderDepth (parser->reader);
+        while (xmlTextReaderRead (parser->reader) == 1)
+        {
+            node_type = xmlTextReaderNodeType (parser->reader);
+            if (node_type == XML_READER_TYPE_END_ELEMENT &&
+                xmlTextReaderDepth (parser->reader) == depth)
+                break;
+            if (node_type != XML_READER_TYPE_TEXT &&
+                node_type != XML_READER_TYPE_CDATA)
+                continue;
+
+            /* Append the text */
+            found_text = true;
+            value = xmlTextReaderConstValue (parser->reader);
+            value_len = strlen ((const char *) value);
+            if (length + value_len >= size)
+            {
+                sprintf (errmsg, "Overflow of %s:%s string", section, name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            memcpy (&text[length], value, value_len + 1);
+            length += value_len;
+        }
     }
 
-    /* Expect the child node to be a text node containing the value of
-       this field */
-    if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+    if (!found_text)
     {
-        sprintf (errmsg, "Processing global_metadata element: %s.",
-            cur_node->name);
+        sprintf (errmsg, "Processing %s element: %s.", section, name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Copy the content of the child node into the value for this field */
-    gmeta->bounding_coords[indx] = atof ((const char *) child_node->content);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_element_double
+
+PURPOSE: Reads the text content of the current element as a double.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the text
+SUCCESS         Successfully read the value
+
+NOTES:
+******************************************************************************/
+static int read_element_double
+(
+    Xml_parser_t *parser,       /* I: parser state */
+    const char *section,        /* I: name of the section being parsed */
+    double *value               /* O: value of the element */
+)
+{
+    char text[STR_SIZE];        /* text of the element */
+
+    if (read_element_text (parser, section, text, sizeof (text)) != SUCCESS)
+        return (ERROR);
 
+    *value = atof (text);
     return (SUCCESS);
 }
 
+
 /******************************************************************************
-MODULE:  add_global_metadata
+MODULE:  parse_proj_params
 
-PURPOSE: Add the current element node to the global metadata structure.
+PURPOSE: Parses the projection-specific parameters in the projection
+information.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the global_metadata elements
-SUCCESS         Successful parse of the global_metadata values
+ERROR           Error parsing the projection parameters
+SUCCESS         Successful parse of the projection parameters
 
 NOTES:
 ******************************************************************************/
-int add_global_metadata
+static int parse_proj_params
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+    Xml_parser_t *parser,       /* I: parser state, at the *_proj_params
+                                      element */
+    int proj_type,              /* I: projection type expected for these
+                                      parameters */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata structure */
 )
 {
-    char FUNC_NAME[] = "add_global_metadata";   /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    xmlNsPtr ns = NULL;           /* pointer to the namespace */
-    xmlChar *attr_val = NULL;     /* attribute value */
-    bool is_ul = false;           /* is this the UL corner */
-    bool is_lr = false;           /* is this the LR corner */
-    double latitude, longitude;   /* lat/long values */
-    int count;                    /* number of chars copied in snprintf */
-
-    /* Set up the current and child pointers */
-    cur_node = a_node;
-    ns = cur_node->nsDef;
-    child_node = cur_node->children;
-
-    /* Verify the namespace of this node is our ESPA namespace.  If it isn't
-       then the element won't be added to the metadata structure. */
-    if (!xmlStrEqual (ns->href, (const xmlChar *) ESPA_NS))
+    char FUNC_NAME[] = "parse_proj_params";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char section[STR_SIZE];     /* name of the section for messages */
+    char text[STR_SIZE];        /* text of the element */
+    int depth;                  /* depth of the parameters element */
+    int status;                 /* return status */
+    double *value = NULL;       /* parameter to be read */
+
+    sprintf (section, "global_metadata:projection_information:%s",
+        xmlTextReaderConstLocalName (parser->reader));
+
+    /* Make sure the projection type specified matches the projection
+       parameters type */
+    if (gmeta->proj_info.proj_type != proj_type)
     {
-        sprintf (errmsg, "Skipping %s since it is not in the ESPA namespace",
-            cur_node->name);
+        sprintf (errmsg, "Projection type does not match %s in the "
+            "projection_information.", section);
         error_handler (true, FUNC_NAME, errmsg);
-        return (SUCCESS);
+        return (ERROR);
     }
 
-    /* Look for the ESPA global metadata elements and process them */
-    if (xmlStrEqual (cur_node->name, (const xmlChar *) "data_provider"))
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
     {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+        value = NULL;
+        switch (get_xml_name_id (parser))
         {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            case XN_ZONE_CODE:
+                if (read_element_text (parser, section, text, sizeof (text))
+                    != SUCCESS)
+                    return (ERROR);
+                gmeta->proj_info.utm_zone = atoi (text);
+                continue;
+            case XN_LONGITUDE_POLE:
+                value = &gmeta->proj_info.longitude_pole;
+                break;
+            case XN_LATITUDE_TRUE_SCALE:
+                value = &gmeta->proj_info.latitude_true_scale;
+                break;
+            case XN_FALSE_EASTING:
+                value = &gmeta->proj_info.false_easting;
+                break;
+            case XN_FALSE_NORTHING:
+                value = &gmeta->proj_info.false_northing;
+                break;
+            case XN_STANDARD_PARALLEL1:
+                value = &gmeta->proj_info.standard_parallel1;
+                break;
+            case XN_STANDARD_PARALLEL2:
+                value = &gmeta->proj_info.standard_parallel2;
+                break;
+            case XN_CENTRAL_MERIDIAN:
+                value = &gmeta->proj_info.central_meridian;
+                break;
+            case XN_ORIGIN_LATITUDE:
+                value = &gmeta->proj_info.origin_latitude;
+                break;
+            case XN_SPHERE_RADIUS:
+                value = &gmeta->proj_info.sphere_radius;
+                break;
+            default:
+                if (skip_unknown_element (parser, section) != SUCCESS)
+                    return (ERROR);
+                continue;
         }
 
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->data_provider, sizeof (gmeta->data_provider),
-            "%s", (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->data_provider))
-        {
-            sprintf (errmsg, "Overflow of gmeta->data_provider string");
-            error_handler (true, FUNC_NAME, errmsg);
+        if (read_element_double (parser, section, value) != SUCCESS)
             return (ERROR);
-        }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "satellite"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->satellite, sizeof (gmeta->satellite), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->satellite))
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_proj_info
+
+PURPOSE: Parses the projection information into the global metadata
+structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection_info elements
+SUCCESS         Successful parse of the projection_info values
+
+NOTES:
+******************************************************************************/
+static int parse_proj_info
+(
+    Xml_parser_t *parser,       /* I: parser state, at the
+                                      projection_information element */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata structure */
+)
+{
+    char FUNC_NAME[] = "parse_proj_info";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char section[] = "global_metadata:projection_information";
+    Xml_name_t id;              /* ID of the current attribute */
+    const char *value = NULL;   /* value of the current attribute */
+    int depth;                  /* depth of the projection information */
+    int status;                 /* return status */
+    bool is_ul, is_lr;          /* is this the UL or LR corner */
+    double x, y;                /* x/y values */
+
+    /* Initialize the datum to no datum */
+    gmeta->proj_info.datum_type = ESPA_NODATUM;
+
+    /* Handle the element attributes */
+    while (next_attribute (parser, &id, &value))
+    {
+        if (id == XN_PROJECTION)
         {
-            sprintf (errmsg, "Overflow of gmeta->satellite string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            if (!strcmp (value, "GEO"))
+                gmeta->proj_info.proj_type = GCTP_GEO_PROJ;
+            else if (!strcmp (value, "UTM"))
+                gmeta->proj_info.proj_type = GCTP_UTM_PROJ;
+            else if (!strcmp (value, "PS"))
+                gmeta->proj_info.proj_type = GCTP_PS_PROJ;
+            else if (!strcmp (value, "ALBERS"))
+                gmeta->proj_info.proj_type = GCTP_ALBERS_PROJ;
+            else if (!strcmp (value, "SIN"))
+                gmeta->proj_info.proj_type = GCTP_SIN_PROJ;
         }
-    }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "instrument"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+        else if (id == XN_DATUM)
         {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            if (!strcmp (value, "WGS84"))
+                gmeta->proj_info.datum_type = ESPA_WGS84;
+            else if (!strcmp (value, "NAD27"))
+                gmeta->proj_info.datum_type = ESPA_NAD27;
+            else if (!strcmp (value, "NAD83"))
+                gmeta->proj_info.datum_type = ESPA_NAD83;
         }
-
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->instrument, sizeof (gmeta->instrument), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->instrument))
+        else if (id == XN_UNITS)
         {
-            sprintf (errmsg, "Overflow of gmeta->instrument string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            if (copy_string (gmeta->proj_info.units,
+                sizeof (gmeta->proj_info.units), value,
+                "gmeta->proj_info.units") != SUCCESS)
+                return (ERROR);
         }
+        else
+            unknown_attribute (parser);
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "acquisition_date"))
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    /* Process the elements within the projection information */
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
     {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+        switch (get_xml_name_id (parser))
         {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            case XN_CORNER_POINT:
+                x = y = -9999.0;
+                is_ul = is_lr = false;
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_LOCATION)
+                    {
+                        is_ul = !strcmp (value, "UL");
+                        is_lr = !strcmp (value, "LR");
+                        if (!is_ul && !is_lr)
+                        {
+                            sprintf (errmsg, "Unknown corner_point location "
+                                "specified (%s). UL and LR expected.", value);
+                            error_handler (false, FUNC_NAME, errmsg);
+                        }
+                    }
+                    else if (id == XN_X)
+                        x = atof (value);
+                    else if (id == XN_Y)
+                        y = atof (value);
+                    else
+                        unknown_attribute (parser);
+                }
+
+                /* Populate the correct corner point */
+                if (is_ul)
+                {
+                    gmeta->proj_info.ul_corner[0] = x;
+                    gmeta->proj_info.ul_corner[1] = y;
+                }
+                else if (is_lr)
+                {
+                    gmeta->proj_info.lr_corner[0] = x;
+                    gmeta->proj_info.lr_corner[1] = y;
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_GRID_ORIGIN:
+                status = read_element_text (parser, section,
+                    gmeta->proj_info.grid_origin,
+                    sizeof (gmeta->proj_info.grid_origin));
+                break;
+
+            case XN_UTM_PROJ_PARAMS:
+                status = parse_proj_params (parser, GCTP_UTM_PROJ, gmeta);
+                break;
+
+            case XN_PS_PROJ_PARAMS:
+                status = parse_proj_params (parser, GCTP_PS_PROJ, gmeta);
+                break;
+
+            case XN_ALBERS_PROJ_PARAMS:
+                status = parse_proj_params (parser, GCTP_ALBERS_PROJ, gmeta);
+                break;
+
+            case XN_SIN_PROJ_PARAMS:
+                status = parse_proj_params (parser, GCTP_SIN_PROJ, gmeta);
+                break;
+
+            default:
+                status = skip_unknown_element (parser, section);
+                break;
         }
 
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->acquisition_date,
-            sizeof (gmeta->acquisition_date), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->acquisition_date))
+        if (status != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of gmeta->acquisition_date string");
+            sprintf (errmsg, "Processing the %s elements", section);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
     }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "scene_center_time"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->scene_center_time,
-            sizeof (gmeta->scene_center_time), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->scene_center_time))
-        {
-            sprintf (errmsg, "Overflow of gmeta->scene_center_time string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "level1_production_date"))
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_bounding_coords
+
+PURPOSE: Parses the bounding coordinates into the global metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the bounding_coords elements
+SUCCESS         Successful parse of the bounding_coords values
+
+NOTES:
+******************************************************************************/
+static int parse_bounding_coords
+(
+    Xml_parser_t *parser,       /* I: parser state, at the
+                                      bounding_coordinates element */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata structure */
+)
+{
+    char section[] = "global_metadata:bounding_coordinates";
+    int depth;                  /* depth of the bounding coordinates */
+    int status;                 /* return status */
+    int indx;                   /* index into the bounding coords array */
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
     {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+        switch (get_xml_name_id (parser))
         {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            case XN_WEST:
+                indx = ESPA_WEST;
+                break;
+            case XN_EAST:
+                indx = ESPA_EAST;
+                break;
+            case XN_NORTH:
+                indx = ESPA_NORTH;
+                break;
+            case XN_SOUTH:
+                indx = ESPA_SOUTH;
+                break;
+            default:
+                if (skip_unknown_element (parser, section) != SUCCESS)
+                    return (ERROR);
+                continue;
         }
 
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->level1_production_date,
-            sizeof (gmeta->level1_production_date), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->level1_production_date))
-        {
-            sprintf (errmsg, "Overflow of gmeta->level1_production_date");
-            error_handler (true, FUNC_NAME, errmsg);
+        if (read_element_double (parser, section,
+            &gmeta->bounding_coords[indx]) != SUCCESS)
             return (ERROR);
-        }
     }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "solar_angles"))
+
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_global_element
+
+PURPOSE: Parses the current element of the global_metadata section into the
+global metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the element
+SUCCESS         Successful parse of the element, or it was skipped
+
+NOTES:
+  1. The reader is left at the end of the element.
+******************************************************************************/
+static int parse_global_element
+(
+    Xml_parser_t *parser,       /* I: parser state, at a child element of the
+                                      global_metadata element */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata structure */
+)
+{
+    char FUNC_NAME[] = "parse_global_element";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char section[] = "global_metadata";
+    Xml_name_t id;              /* ID of the current attribute */
+    const char *value = NULL;   /* value of the current attribute */
+    int status;                 /* return status */
+    bool is_ul, is_lr;          /* is this the UL or LR corner */
+    double latitude, longitude; /* lat/long values */
+    double dvalue;              /* value of the element */
+
+    switch (get_xml_name_id (parser))
     {
-        /* Handle the element attributes */
-        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-        {
-            attr_val = xmlGetProp (cur_node, attr->name);
-            if (xmlStrEqual (attr->name, (const xmlChar *) "zenith"))
-                gmeta->solar_zenith = atof ((const char *) attr_val);
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "azimuth"))
-                gmeta->solar_azimuth = atof ((const char *) attr_val);
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "units"))
-            {
-                count = snprintf (gmeta->solar_units,
-                    sizeof (gmeta->solar_units), "%s", (const char *) attr_val);
-                if (count < 0 || count >= sizeof (gmeta->solar_units))
+        case XN_DATA_PROVIDER:
+            status = read_element_text (parser, section,
+                gmeta->data_provider, sizeof (gmeta->data_provider));
+            break;
+
+        case XN_SATELLITE:
+            status = read_element_text (parser, section,
+                gmeta->satellite, sizeof (gmeta->satellite));
+            break;
+
+        case XN_INSTRUMENT:
+            status = read_element_text (parser, section,
+                gmeta->instrument, sizeof (gmeta->instrument));
+            break;
+
+        case XN_ACQUISITION_DATE:
+            status = read_element_text (parser, section,
+                gmeta->acquisition_date,
+                sizeof (gmeta->acquisition_date));
+            break;
+
+        case XN_SCENE_CENTER_TIME:
+            status = read_element_text (parser, section,
+                gmeta->scene_center_time,
+                sizeof (gmeta->scene_center_time));
+            break;
+
+        case XN_LEVEL1_PRODUCTION_DATE:
+            status = read_element_text (parser, section,
+                gmeta->level1_production_date,
+                sizeof (gmeta->level1_production_date));
+            break;
+
+        case XN_LPGS_METADATA_FILE:
+            status = read_element_text (parser, section,
+                gmeta->lpgs_metadata_file,
+                sizeof (gmeta->lpgs_metadata_file));
+            break;
+
+        case XN_PRODUCT_ID:
+            status = read_element_text (parser, section,
+                gmeta->product_id, sizeof (gmeta->product_id));
+            break;
+
+        case XN_EARTH_SUN_DISTANCE:
+            status = read_element_double (parser, section, &dvalue);
+            gmeta->earth_sun_dist = dvalue;
+            break;
+
+        case XN_ORIENTATION_ANGLE:
+            status = read_element_double (parser, section, &dvalue);
+            gmeta->orientation_angle = dvalue;
+            break;
+
+        case XN_VALID_MASK:
+            status = read_element_text (parser, section,
+                gmeta->valid_mask, sizeof (gmeta->valid_mask));
+            break;
+
+        case XN_SOLAR_ANGLES:
+            while (next_attribute (parser, &id, &value))
+            {
+                if (id == XN_ZENITH)
+                    gmeta->solar_zenith = atof (value);
+                else if (id == XN_AZIMUTH)
+                    gmeta->solar_azimuth = atof (value);
+                else if (id == XN_UNITS)
                 {
-                    sprintf (errmsg, "Overflow of gmeta->solar_units string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
+                    if (copy_string (gmeta->solar_units,
+                        sizeof (gmeta->solar_units), value,
+                        "gmeta->solar_units") != SUCCESS)
+                        return (ERROR);
                 }
+                else
+                    unknown_attribute (parser);
             }
-            else
-            {
-                sprintf (errmsg, "WARNING: unknown attribute for element "
-                    "(%s): %s\n", cur_node->name, attr->name);
-                error_handler (false, FUNC_NAME, errmsg);
-            }
-            xmlFree (attr_val);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "earth_sun_distance"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+            status = skip_element (parser);
+            break;
 
-        /* Copy the content of the child node into the value for this field */
-        gmeta->earth_sun_dist = atof ((const char *) child_node->content);
-    }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "wrs"))
-    {
-        /* Handle the element attributes */
-        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-        {
-            attr_val = xmlGetProp (cur_node, attr->name);
-            if (xmlStrEqual (attr->name, (const xmlChar *) "system"))
-                gmeta->wrs_system = atoi ((const char *) attr_val);
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "path"))
-                gmeta->wrs_path = atoi ((const char *) attr_val);
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "row"))
-                gmeta->wrs_row = atoi ((const char *) attr_val);
-            else
+        case XN_WRS:
+            while (next_attribute (parser, &id, &value))
             {
-                sprintf (errmsg, "WARNING: unknown attribute for element "
-                    "(%s): %s\n", cur_node->name, attr->name);
-                error_handler (false, FUNC_NAME, errmsg);
+                if (id == XN_SYSTEM)
+                    gmeta->wrs_system = atoi (value);
+                else if (id == XN_PATH)
+                    gmeta->wrs_path = atoi (value);
+                else if (id == XN_ROW)
+                    gmeta->wrs_row = atoi (value);
+                else
+                    unknown_attribute (parser);
             }
-            xmlFree (attr_val);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "modis"))
-    {
-        /* Handle the element attributes */
-        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-        {
-            attr_val = xmlGetProp (cur_node, attr->name);
-            if (xmlStrEqual (attr->name, (const xmlChar *) "htile"))
-                gmeta->htile = atoi ((const char *) attr_val);
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "vtile"))
-                gmeta->vtile = atoi ((const char *) attr_val);
-            else
+            status = skip_element (parser);
+            break;
+
+        case XN_MODIS:
+            while (next_attribute (parser, &id, &value))
             {
-                sprintf (errmsg, "WARNING: unknown attribute for element "
-                    "(%s): %s\n", cur_node->name, attr->name);
-                error_handler (false, FUNC_NAME, errmsg);
+                if (id == XN_HTILE)
+                    gmeta->htile = atoi (value);
+                else if (id == XN_VTILE)
+                    gmeta->vtile = atoi (value);
+                else
+                    unknown_attribute (parser);
             }
-            xmlFree (attr_val);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "lpgs_metadata_file"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->lpgs_metadata_file,
-            sizeof (gmeta->lpgs_metadata_file), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->lpgs_metadata_file))
-        {
-            sprintf (errmsg, "Overflow of gmeta->lpgs_metadata_file string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "product_id"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+            status = skip_element (parser);
+            break;
 
-        /* Copy the content of the child node into the value for this field */
-        count = snprintf (gmeta->product_id, sizeof (gmeta->product_id), "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= sizeof (gmeta->product_id))
-        {
-            sprintf (errmsg, "Overflow of gmeta->product_id string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name, (const xmlChar *) "corner"))
-    {
-        /* Handle the element attributes */
-        latitude = -9999.0;
-        longitude = -9999.0;
-        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-        {
-            attr_val = xmlGetProp (cur_node, attr->name);
-            if (xmlStrEqual (attr->name, (const xmlChar *) "location"))
+        case XN_CORNER:
+            latitude = longitude = -9999.0;
+            is_ul = is_lr = false;
+            while (next_attribute (parser, &id, &value))
             {
-                is_ul = false;
-                is_lr = false;
-                if (xmlStrEqual (attr_val, (const xmlChar *) "UL"))
-                    is_ul = true;
-                else if (xmlStrEqual (attr_val, (const xmlChar *) "LR"))
-                    is_lr = true;
-                else
+                if (id == XN_LOCATION)
                 {
-                    sprintf (errmsg, "WARNING: unknown corner location "
-                        "specified (%s). UL and LR expected.\n", attr_val);
-                    error_handler (false, FUNC_NAME, errmsg);
+                    is_ul = !strcmp (value, "UL");
+                    is_lr = !strcmp (value, "LR");
+                    if (!is_ul && !is_lr)
+                    {
+                        sprintf (errmsg, "Unknown corner location "
+                            "specified (%s). UL and LR expected.", value);
+                        error_handler (false, FUNC_NAME, errmsg);
+                    }
                 }
+                else if (id == XN_LATITUDE)
+                    latitude = atof (value);
+                else if (id == XN_LONGITUDE)
+                    longitude = atof (value);
+                else
+                    unknown_attribute (parser);
             }
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "latitude"))
-                latitude = atof ((const char *) attr_val);
-            else if (xmlStrEqual (attr->name, (const xmlChar *) "longitude"))
-                longitude = atof ((const char *) attr_val);
-            else
+
+            /* Populate the correct corner point */
+            if (is_ul)
             {
-                sprintf (errmsg, "WARNING: unknown attribute for element "
-                    "(%s): %s\n", cur_node->name, attr->name);
-                error_handler (false, FUNC_NAME, errmsg);
+                gmeta->ul_corner[0] = latitude;
+                gmeta->ul_corner[1] = longitude;
             }
-            xmlFree (attr_val);
-        }
-
-        /* Populate the correct corner point */
-        if (is_ul)
-        {
-            gmeta->ul_corner[0] = latitude;
-            gmeta->ul_corner[1] = longitude;
-        }
-        else if (is_lr)
-        {
-            gmeta->lr_corner[0] = latitude;
-            gmeta->lr_corner[1] = longitude;
-        }
-    }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "bounding_coordinates"))
-    {
-        /* Process the siblings in the bounding coordinates */
-        for (cur_node = a_node->children; cur_node;
-             cur_node = xmlNextElementSibling (cur_node))
-        {
-            if (add_global_metadata_bounding_coords (cur_node, gmeta))
+            else if (is_lr)
             {
-                sprintf (errmsg, "Processing bounding_coordinates element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
+                gmeta->lr_corner[0] = latitude;
+                gmeta->lr_corner[1] = longitude;
             }
-        }
-    }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "projection_information"))
-    {
-        /* Process the elements within the projection information */
-        if (add_global_metadata_proj_info (cur_node, gmeta))
-        {
-            sprintf (errmsg, "Processing projection_information elements");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }
-    else if (xmlStrEqual (cur_node->name,
-        (const xmlChar *) "orientation_angle"))
-    {
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Processing global_metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+            status = skip_element (parser);
+            break;
+
+        case XN_BOUNDING_COORDINATES:
+            status = parse_bounding_coords (parser, gmeta);
+            break;
 
-        /* Copy the content of the child node into the value for this field */
-        gmeta->orientation_angle = atof ((const char *) child_node->content);
+        case XN_PROJECTION_INFORMATION:
+            status = parse_proj_info (parser, gmeta);
+            break;
+
+        default:
+            status = skip_unknown_element (parser, section);
+            break;
     }
-    else
+
+    if (status != SUCCESS)
     {
-        sprintf (errmsg, "Unknown element (%s) in the global_metadata",
-            cur_node->name);
-        error_handler (false, FUNC_NAME, errmsg);
+        sprintf (errmsg, "Consuming global_metadata element '%s'.",
+            xmlTextReaderConstLocalName (parser->reader));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     return (SUCCESS);
@@ -1251,1296 +1163,1878 @@ int add_global_metadata
 
 
 /******************************************************************************
-MODULE:  add_band_metadata_bitmap_description
+MODULE:  parse_global_metadata
 
-PURPOSE: Adds the bit elements to the bitmap description to the band metadata
+PURPOSE: Parses the global_metadata section into the global metadata
 structure.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the bit elements
-SUCCESS         Successful parse of the bit values
+ERROR           Error parsing the global_metadata elements
+SUCCESS         Successful parse of the global_metadata values
 
 NOTES:
-1. Memory is allocated in the band metadata for the number of bits in the
-   bitmap description.
 ******************************************************************************/
-int add_band_metadata_bitmap_description
+static int parse_global_metadata
 (
-    xmlNode *a_node,            /* I/O: pointer to the element node to
-                                        process */
-    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
-                                      band in the bands structure */
+    Xml_parser_t *parser,       /* I: parser state, at the global_metadata
+                                      element */
+    Espa_global_meta_t *gmeta   /* I/O: global metadata structure */
 )
 {
-    char FUNC_NAME[] = "add_band_metadata_bitmap_description"; /* func name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    int nbits = 0;                /* number of bits in the bitmap description */
-    int count;                    /* number of chars copied in snprintf */
-
-    /* Count the number of siblings which are bit descriptions */
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* If this is a bit element then count it */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "bit"))
-            nbits++;
-    }
+    int depth;                  /* depth of the global metadata */
+    int status;                 /* return status */
 
-    /* Allocate memory in the band structure for the number of bits */
-    if (allocate_bitmap_metadata (bmeta, nbits) != SUCCESS)
-    {
-        sprintf (errmsg, "Allocating memory to the band structure for %d "
-            "bits in the bitmap description.", nbits);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
 
-    /* Process the siblings as long as they are bit elements.  Assume the XML
-       file has a description for every bit number inclusive from 0 to nbits-1
-       therefore the bit num attribute will not be stored. */
-    nbits = 0;
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
     {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
-
-        /* If this isn't a bit element then skip to the next one */
-        if (!xmlStrEqual (cur_node->name, (const xmlChar *) "bit"))
+        /* Elements which aren't in the ESPA namespace are skipped */
+        status = is_espa_element (parser);
+        if (status == 0)
             continue;
-
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Error processing band metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
+        else if (status < 0)
             return (ERROR);
-        }
 
-        /* Copy the content of the child node into the array of bits in the
-           bitmap_description */
-        count = snprintf (bmeta->bitmap_description[nbits], STR_SIZE, "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= STR_SIZE)
-        {
-            sprintf (errmsg, "Overflow of bmeta->bitmap_description[nbits]");
-            error_handler (true, FUNC_NAME, errmsg);
+        if (parse_global_element (parser, gmeta) != SUCCESS)
             return (ERROR);
-        }
-
-        /* Increment the bit count */
-        nbits++;
     }
 
-    /* Successful processing */
-    return (SUCCESS);
+    return (status == 0 ? SUCCESS : ERROR);
 }
 
 
 /******************************************************************************
-MODULE:  add_band_metadata_class_values
+MODULE:  grow_array
 
-PURPOSE: Adds the class elements to the band metadata structure.
+PURPOSE: Makes sure an array has space for at least one more element,
+doubling its size as needed.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the class elements
-SUCCESS         Successful parse of the class values
+ERROR           Error allocating memory
+SUCCESS         Successfully grew the array
 
 NOTES:
-1. Memory is allocated in the band metadata for the number of classes in the
-   class values.
 ******************************************************************************/
-int add_band_metadata_class_values
+static int grow_array
 (
-    xmlNode *a_node,            /* I/O: pointer to the element node to
-                                        process */
-    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
-                                      band in the bands structure */
+    void **array,               /* I/O: array to be grown */
+    int *nalloc,                /* I/O: number of elements allocated */
+    int count,                  /* I: number of elements in use */
+    size_t elem_size,           /* I: size of each element */
+    const char *array_name      /* I: name of the array for error messages */
 )
 {
-    char FUNC_NAME[] = "add_band_metadata_class_values"; /* func name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
-    xmlChar *attr_val = NULL;     /* attribute value */
-    int nclass = 0;               /* number of classes in the class values */
-    int count;                    /* number of chars copied in snprintf */
-
-    /* Count the number of siblings which are class descriptions */
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* If this is a class element then count it */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "class"))
-            nclass++;
-    }
+    char FUNC_NAME[] = "grow_array";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int new_alloc;              /* new number of elements */
+    void *new_array = NULL;     /* reallocated array */
+
+    if (count < *nalloc)
+        return (SUCCESS);
 
-    /* Allocate memory in the band structure for the number of classes */
-    if (allocate_class_metadata (bmeta, nclass) != SUCCESS)
+    new_alloc = (*nalloc > 0) ? *nalloc * 2 : 8;
+    new_array = realloc (*array, new_alloc * elem_size);
+    if (new_array == NULL)
     {
-        sprintf (errmsg, "Allocating memory to the band structure for %d "
-            "classes in the class_values.", nclass);
+        sprintf (errmsg, "Allocating ESPA metadata for %d %s", new_alloc,
+            array_name);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Process the siblings as long as they are class elements */
-    nclass = 0;
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
-
-        /* If this isn't a class element then skip to the next one */
-        if (!xmlStrEqual (cur_node->name, (const xmlChar *) "class"))
-            continue;
-
-        /* Handle the element attributes */
-        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-        {
-            attr_val = xmlGetProp (cur_node, attr->name);
-            if (xmlStrEqual (attr->name, (const xmlChar *) "num"))
-                bmeta->class_values[nclass].class =
-                    atoi ((const char *) attr_val);
-            else
-            {
-                sprintf (errmsg, "WARNING: unknown attribute for element "
-                    "(%s): %s\n", cur_node->name, attr->name);
-                error_handler (false, FUNC_NAME, errmsg);
-            }
-            xmlFree (attr_val);
-        }
-
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Error processing band metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        /* Copy the content of the child node into the array of classes in the
-           class_values */
-        count = snprintf (bmeta->class_values[nclass].description,
-            STR_SIZE, "%s",
-            (const char *) child_node->content);
-        if (count < 0 || count >= STR_SIZE)
-        {
-            sprintf (errmsg,
-                "Overflow of bmeta->class_values[nclass].description");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        /* Increment the class count */
-        nclass++;
-    }
-
-    /* Successful processing */
+    *array = new_array;
+    *nalloc = new_alloc;
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  add_band_metadata_percent_coverage
+MODULE:  move_to_arena
 
-PURPOSE: Adds the percent cover elements to the band metadata structure.
+PURPOSE: Moves a heap array holding count elements into the metadata arena,
+using exactly the space needed for the elements.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the percent cover elements
-SUCCESS         Successful parse of the percent cover values
+ERROR           Error allocating memory
+SUCCESS         Successfully moved the array
 
 NOTES:
-1. Memory is allocated in the band metadata for the number of cover types in
-   the percent cover container.
+  1. The heap array is freed upon return.
 ******************************************************************************/
-int add_band_metadata_percent_coverage
+static int move_to_arena
 (
-    xmlNode *a_node,            /* I/O: pointer to the element node to
-                                        process */
-    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
-                                      band in the bands structure */
+    Espa_meta_arena_t *arena,   /* I/O: arena to move the array into */
+    void **array,               /* I/O: array to be moved */
+    int count,                  /* I: number of elements in use */
+    size_t elem_size            /* I: size of each element */
 )
 {
-    char FUNC_NAME[] = "add_band_metadata_percent_coverage"; /* func name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
-    xmlChar *attr_val = NULL;     /* attribute value */
-    int ncover = 0;               /* number of cover types in the percent cover
-                                     container */
-    int count;                    /* number of chars copied in snprintf */
-
-    /* Count the number of siblings which are cover type descriptions */
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* If this is a cover element then count it */
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "cover"))
-            ncover++;
-    }
+    void *new_array = NULL;     /* array in the arena */
 
-    /* Allocate memory in the band structure for the number of cover types */
-    if (allocate_percent_coverage_metadata (bmeta, ncover) != SUCCESS)
-    {
-        sprintf (errmsg, "Allocating memory to the band structure for %d "
-            "cover types in the percent_coverage container.", ncover);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    if (*array == NULL)
+        return (SUCCESS);
 
-    /* Process the siblings as long as they are cover type elements */
-    ncover = 0;
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
+    new_array = alloc_metadata_arena (arena, count * elem_size);
+    if (new_array == NULL)
     {
-        /* Set up the child pointer */
-        child_node = cur_node->children;
-
-        /* If this isn't a cover type element then skip to the next one */
-        if (!xmlStrEqual (cur_node->name, (const xmlChar *) "cover"))
-            continue;
-
-        /* Handle the element attributes */
-        for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-        {
-            attr_val = xmlGetProp (cur_node, attr->name);
-            if (xmlStrEqual (attr->name, (const xmlChar *) "type"))
-            {
-                count = snprintf (bmeta->percent_cover[ncover].description,
-                    STR_SIZE, "%s",
-                    (const char *) attr_val);
-                if (count < 0 || count >= STR_SIZE)
-                {
-                    sprintf (errmsg,
-                        "Overflow of bmeta->percent_cover[ncover].description");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-            else
-            {
-                sprintf (errmsg, "WARNING: unknown attribute for element "
-                    "(%s): %s\n", cur_node->name, attr->name);
-                error_handler (false, FUNC_NAME, errmsg);
-            }
-            xmlFree (attr_val);
-        }
-
-        /* Expect the child node to be a text node containing the value of
-           this field */
-        if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-        {
-            sprintf (errmsg, "Error processing band metadata element: %s.",
-                cur_node->name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        /* Copy the content of the child node into the array of cover types in
-           the percent_cover field */
-        bmeta->percent_cover[ncover].percent =
-            atof ((const char *) child_node->content);
-
-        /* Increment the cover type count */
-        ncover++;
+        free (*array);
+        *array = NULL;
+        return (ERROR);
     }
 
-    /* Successful processing */
+    memcpy (new_array, *array, count * elem_size);
+    free (*array);
+    *array = new_array;
     return (SUCCESS);
 }
 
 
 /******************************************************************************
-MODULE:  add_band_metadata
+MODULE:  parse_band_items
 
-PURPOSE: Add the current band element node to the current band metadata
-structure and process the childrend of this node.
+PURPOSE: Parses the bit, class, or cover elements of the bitmap_description,
+class_values, or percent_coverage lists into heap arrays of the band metadata
+structure.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the band metadata elements
-SUCCESS         Successful parse of the band metadata values
+ERROR           Error parsing the list elements
+SUCCESS         Successful parse of the list
 
 NOTES:
+  1. Memory is allocated in the band metadata for the elements in the list.
+  2. Assume the XML file has a description for every bit number inclusive
+     from 0 to nbits-1 therefore the bit num attribute will not be stored.
+  3. The bit descriptions are stored at their actual length, and identical
+     descriptions within the band share the same string.
 ******************************************************************************/
-int add_band_metadata
+static int parse_band_items
 (
-    xmlNode *a_node,            /* I: pointer to the element node to process */
-    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
-                                      band in the bands structure */
+    Xml_parser_t *parser,       /* I: parser state, at the list element */
+    Xml_name_t item_id,         /* I: ID of the list item elements */
+    const char *section,        /* I: name of the section for messages */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata structure */
 )
 {
-    char FUNC_NAME[] = "add_band_metadata";   /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlAttrPtr attr = NULL;       /* pointer to the element attributes */
-    xmlNode *cur_node = NULL;     /* pointer to the current node */
-    xmlNode *child_node = NULL;   /* pointer to the child node */
-    xmlNsPtr ns = NULL;           /* pointer to the namespace */
-    xmlChar *attr_val = NULL;     /* attribute value */
-    int count;                    /* number of chars copied in snprintf */
-
-    /* Set up the current and child pointers */
-    cur_node = a_node;
-    ns = cur_node->nsDef;
-
-    /* Verify the namespace of this node is our ESPA namespace.  If it isn't
-       then the element won't be added to the metadata structure. */
-    if (!xmlStrEqual (ns->href, (const xmlChar *) ESPA_NS))
-    {
-        sprintf (errmsg, "Skipping %s since it is not in the ESPA namespace",
-            cur_node->name);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (SUCCESS);
-    }
-
-    /* Handle the element attributes for the band element */
-    for (attr = cur_node->properties; attr != NULL; attr = attr->next)
+    char FUNC_NAME[] = "parse_band_items";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char text[STR_SIZE];        /* text of the element */
+    Xml_name_t id;              /* ID of the current attribute */
+    const char *value = NULL;   /* value of the current attribute */
+    int depth;                  /* depth of the list element */
+    int status;                 /* return status */
+    int nalloc = 0;             /* number of list items allocated */
+    char *bit_desc = NULL;      /* stored bit description */
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
     {
-        attr_val = xmlGetProp (cur_node, attr->name);
-        if (xmlStrEqual (attr->name, (const xmlChar *) "product"))
-        {
-            count = snprintf (bmeta->product, sizeof (bmeta->product),
-                "%s", (const char *) attr_val);
-            if (count < 0 || count >= sizeof (bmeta->product))
-            {
-                sprintf (errmsg, "Overflow of bmeta->product string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "source"))
-        {
-            count = snprintf (bmeta->source, sizeof (bmeta->source),
-                "%s", (const char *) attr_val);
-            if (count < 0 || count >= sizeof (bmeta->source))
-            {
-                sprintf (errmsg, "Overflow of bmeta->source string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "name"))
+        /* If this isn't a list item then skip to the next one */
+        if (get_xml_name_id (parser) != item_id)
         {
-            count = snprintf (bmeta->name, sizeof (bmeta->name),
-                "%s", (const char *) attr_val);
-            if (count < 0 || count >= sizeof (bmeta->name))
-            {
-                sprintf (errmsg, "Overflow of bmeta->name string");
-                error_handler (true, FUNC_NAME, errmsg);
+            if (skip_element (parser) != SUCCESS)
                 return (ERROR);
-            }
+            continue;
         }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "category"))
+
+        if (item_id == XN_BIT)
         {
-            count = snprintf (bmeta->category, sizeof (bmeta->category),
-                "%s", (const char *) attr_val);
-            if (count < 0 || count >= sizeof (bmeta->category))
-            {
-                sprintf (errmsg, "Overflow of bmeta->category string");
-                error_handler (true, FUNC_NAME, errmsg);
+            if (grow_array ((void **) &bmeta->bitmap_description, &nalloc,
+                bmeta->nbits, sizeof (char *), "bitmap descriptions") !=
+                SUCCESS)
                 return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "data_type"))
-        {
-            if (xmlStrEqual (attr_val, (const xmlChar *) "INT8"))
-                bmeta->data_type = ESPA_INT8;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "UINT8"))
-                bmeta->data_type = ESPA_UINT8;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "INT16"))
-                bmeta->data_type = ESPA_INT16;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "UINT16"))
-                bmeta->data_type = ESPA_UINT16;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "INT32"))
-                bmeta->data_type = ESPA_INT32;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "UINT32"))
-                bmeta->data_type = ESPA_UINT32;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "FLOAT32"))
-                bmeta->data_type = ESPA_FLOAT32;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "FLOAT64"))
-                bmeta->data_type = ESPA_FLOAT64;
-        }
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "nlines"))
-            bmeta->nlines = atoi ((const char *) attr_val);
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "nsamps"))
-            bmeta->nsamps = atoi ((const char *) attr_val);
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "fill_value"))
-            bmeta->fill_value = atoi ((const char *) attr_val);
-        else if (xmlStrEqual (attr->name,
-            (const xmlChar *) "saturate_value"))
-            bmeta->saturate_value = atoi ((const char *) attr_val);
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "scale_factor"))
-            bmeta->scale_factor = atof ((const char *) attr_val);
-        else if (xmlStrEqual (attr->name, (const xmlChar *) "add_offset"))
-            bmeta->add_offset = atof ((const char *) attr_val);
-        else
-        {
-            sprintf (errmsg, "WARNING: unknown attribute for element (%s): "
-                "%s\n", cur_node->name, attr->name);
-            error_handler (false, FUNC_NAME, errmsg);
-        }
-        xmlFree (attr_val);
-    }
 
-    /* Process the children of this node; start with the first child then
-       process it's siblings */
-    for (cur_node = a_node->children; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        child_node = cur_node->children;
-        if (xmlStrEqual (cur_node->name, (const xmlChar *) "short_name"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
+            if (read_element_text (parser, section, text, sizeof (text)) !=
+                SUCCESS)
                 return (ERROR);
-            }
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->short_name, sizeof (bmeta->short_name),
-                "%s", (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->short_name))
+            bit_desc = intern_metadata_string (bmeta, text);
+            if (bit_desc == NULL)
             {
-                sprintf (errmsg, "Overflow of bmeta->short_name string");
+                sprintf (errmsg, "Allocating ESPA band metadata for %d nbits",
+                    bmeta->nbits + 1);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
+            bmeta->bitmap_description[bmeta->nbits] = bit_desc;
+            bmeta->nbits++;
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "long_name"))
+        else if (item_id == XN_CLASS)
         {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
+            if (grow_array ((void **) &bmeta->class_values, &nalloc,
+                bmeta->nclass, sizeof (Espa_class_t), "classes") != SUCCESS)
                 return (ERROR);
-            }
+            bmeta->nclass++;
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->long_name, sizeof (bmeta->long_name),
-                "%s", (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->long_name))
-            {
-                sprintf (errmsg, "Overflow of bmeta->long_name string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "file_name"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+            while (next_attribute (parser, &id, &value))
             {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
+                if (id == XN_NUM)
+                    bmeta->class_values[bmeta->nclass-1].class = atoi (value);
+                else
+                    unknown_attribute (parser);
             }
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->file_name, sizeof (bmeta->file_name),
-                "%s", (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->file_name))
-            {
-                sprintf (errmsg, "Overflow of bmeta->file_name string");
-                error_handler (true, FUNC_NAME, errmsg);
+            if (read_element_text (parser, section,
+                bmeta->class_values[bmeta->nclass-1].description,
+                sizeof (bmeta->class_values[bmeta->nclass-1].description)) !=
+                SUCCESS)
                 return (ERROR);
-            }
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "pixel_size"))
+        else
         {
-            /* Handle the element attributes */
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
+            if (grow_array ((void **) &bmeta->percent_cover, &nalloc,
+                bmeta->ncover, sizeof (Espa_percent_cover_t), "cover types")
+                != SUCCESS)
+                return (ERROR);
+            bmeta->ncover++;
+
+            while (next_attribute (parser, &id, &value))
             {
-                attr_val = xmlGetProp (cur_node, attr->name);
-                if (xmlStrEqual (attr->name, (const xmlChar *) "x"))
-                    bmeta->pixel_size[0] =
-                        (double) atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "y"))
-                    bmeta->pixel_size[1] =
-                        (double) atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "units"))
+                if (id == XN_TYPE)
                 {
-                    count = snprintf (bmeta->pixel_units,
-                        sizeof (bmeta->pixel_units), "%s",
-                        (const char *) attr_val);
-                    if (count < 0 || count >= sizeof (bmeta->pixel_units))
-                    {
-                        sprintf (errmsg, "Overflow of bmeta->pixel_units");
-                        error_handler (true, FUNC_NAME, errmsg);
+                    if (copy_string (
+                        bmeta->percent_cover[bmeta->ncover-1].description,
+                        sizeof (bmeta->percent_cover[0].description), value,
+                        "percent_cover description") != SUCCESS)
                         return (ERROR);
-                    }
                 }
                 else
-                {
-                    sprintf (errmsg, "WARNING: unknown attribute for element "
-                        "(%s): %s\n", cur_node->name, attr->name);
-                    error_handler (false, FUNC_NAME, errmsg);
-                }
-                xmlFree (attr_val);
+                    unknown_attribute (parser);
             }
+
+            if (read_element_text (parser, section, text, sizeof (text)) !=
+                SUCCESS)
+                return (ERROR);
+            bmeta->percent_cover[bmeta->ncover-1].percent = atof (text);
+        }
+    }
+
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_band_list
+
+PURPOSE: Parses the bitmap_description, class_values, or percent_coverage list
+into the band metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the list elements
+SUCCESS         Successful parse of the list
+
+NOTES:
+  1. The list is gathered on the heap and then moved into the arena of the
+     band at its final size.  If the list can't be parsed the heap array is
+     freed, since free_metadata doesn't free the arrays of arena bands.
+******************************************************************************/
+static int parse_band_list
+(
+    Xml_parser_t *parser,       /* I: parser state, at the list element */
+    Xml_name_t list_id,         /* I: ID of the list element */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata structure */
+)
+{
+    char FUNC_NAME[] = "parse_band_list";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char section[STR_SIZE];     /* name of the section for messages */
+    Xml_name_t item_id;         /* ID of the list item elements */
+    void **array = NULL;        /* heap array of the list */
+    int *count = NULL;          /* number of elements in the list */
+    size_t elem_size;           /* size of each list element */
+
+    sprintf (section, "band:%s", xmlTextReaderConstLocalName (parser->reader));
+    if (list_id == XN_BITMAP_DESCRIPTION)
+    {
+        item_id = XN_BIT;
+        array = (void **) &bmeta->bitmap_description;
+        count = &bmeta->nbits;
+        elem_size = sizeof (char *);
+    }
+    else if (list_id == XN_CLASS_VALUES)
+    {
+        item_id = XN_CLASS;
+        array = (void **) &bmeta->class_values;
+        count = &bmeta->nclass;
+        elem_size = sizeof (Espa_class_t);
+    }
+    else
+    {
+        item_id = XN_COVER;
+        array = (void **) &bmeta->percent_cover;
+        count = &bmeta->ncover;
+        elem_size = sizeof (Espa_percent_cover_t);
+    }
+
+    if (*array != NULL)
+    {
+        sprintf (errmsg, "Duplicate %s list", section);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    if (parse_band_items (parser, item_id, section, bmeta) != SUCCESS)
+    {
+        free (*array);
+        *array = NULL;
+        *count = 0;
+        return (ERROR);
+    }
+
+    /* Move the list into the arena at its final size */
+    if (move_to_arena (bmeta->arena, array, *count, elem_size) != SUCCESS)
+    {
+        *count = 0;
+        sprintf (errmsg, "Moving the %s list into the metadata arena",
+            section);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_band_statistics
+
+PURPOSE: Parses the statistics element, and its histogram, into the band
+metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the statistics
+SUCCESS         Successful parse of the statistics
+
+NOTES:
+  1. A histogram with more than ESPA_STATS_NBINS bins, or with fewer counts
+     than bins, is an error.
+******************************************************************************/
+static int parse_band_statistics
+(
+    Xml_parser_t *parser,       /* I: parser state, at the statistics
+                                      element */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata structure for the
+                                        current band */
+)
+{
+    char FUNC_NAME[] = "parse_band_statistics";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char section[] = "statistics";
+    char text[ESPA_STATS_NBINS * 24];  /* text of the histogram counts */
+    char *cptr = NULL;          /* current count in the text */
+    char *end = NULL;           /* end of the current count */
+    Xml_name_t id;              /* ID of the current element/attribute */
+    const char *value = NULL;   /* value of the current attribute */
+    Espa_band_stats_t *stats = &bmeta->stats;  /* band statistics */
+    int depth;                  /* depth of the statistics element */
+    int status;                 /* return status */
+    int j;                      /* looping variable for the bins */
+
+    /* Statistics without min/max/mean/stddev have no valid pixels */
+    stats->min = stats->max = ESPA_FLOAT_META_FILL;
+    stats->mean = stats->stddev = ESPA_FLOAT_META_FILL;
+    stats->nbins = 0;
+    while (next_attribute (parser, &id, &value))
+    {
+        switch (id)
+        {
+            case XN_VALID_PIXELS:
+                stats->valid_pixels = atol (value);
+                break;
+            case XN_FILL_PIXELS:
+                stats->fill_pixels = atol (value);
+                break;
+            case XN_OUT_OF_RANGE_PIXELS:
+                stats->out_of_range_pixels = atol (value);
+                break;
+            case XN_MIN:
+                stats->min = atof (value);
+                break;
+            case XN_MAX:
+                stats->max = atof (value);
+                break;
+            case XN_MEAN:
+                stats->mean = atof (value);
+                break;
+            case XN_STDDEV:
+                stats->stddev = atof (value);
+                break;
+            default:
+                unknown_attribute (parser);
+                break;
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "resample_method"))
+    }
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
+    {
+        if (get_xml_name_id (parser) != XN_HISTOGRAM)
         {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
+            if (skip_unknown_element (parser, section) != SUCCESS)
                 return (ERROR);
-            }
+            continue;
+        }
 
-            /* Use the attribute value to set the resample_method */
-            if (xmlStrEqual (child_node->content,
-                (const xmlChar *) "cubic convolution"))
-                bmeta->resample_method = ESPA_CC;
-            else if (xmlStrEqual (child_node->content,
-                (const xmlChar *) "nearest neighbor"))
-                bmeta->resample_method = ESPA_NN;
-            else if (xmlStrEqual (child_node->content,
-                (const xmlChar *) "bilinear"))
-                bmeta->resample_method = ESPA_BI;
-            else if (xmlStrEqual (child_node->content,
-                (const xmlChar *) "none"))
-                bmeta->resample_method = ESPA_NONE;
+        while (next_attribute (parser, &id, &value))
+        {
+            if (id == XN_MIN)
+                stats->hist_min = atof (value);
+            else if (id == XN_MAX)
+                stats->hist_max = atof (value);
+            else if (id == XN_NBINS)
+                stats->nbins = atoi (value);
             else
-            {
-                sprintf (errmsg, "WARNING: unknown option for element (%s): "
-                    "%s\n", cur_node->name, child_node->content);
-                error_handler (false, FUNC_NAME, errmsg);
-            }
+                unknown_attribute (parser);
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "data_units"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->data_units, sizeof (bmeta->data_units),
-                "%s", (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->data_units))
-            {
-                sprintf (errmsg, "Overflow of bmeta->data_units string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        if (stats->nbins < 0 || stats->nbins > ESPA_STATS_NBINS)
+        {
+            sprintf (errmsg, "Histogram of band %s has %d bins; at most %d "
+                "are supported.", bmeta->name, stats->nbins,
+                ESPA_STATS_NBINS);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "resample_method"))
+
+        if (read_element_text (parser, section, text, sizeof (text)) !=
+            SUCCESS)
+            return (ERROR);
+
+        cptr = text;
+        for (j = 0; j < stats->nbins; j++)
         {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
+            stats->histogram[j] = strtol (cptr, &end, 10);
+            if (end == cptr)
             {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
+                sprintf (errmsg, "Histogram of band %s has fewer than the %d "
+                    "counts expected.", bmeta->name, stats->nbins);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
-
-            /* Copy the content of the child node into value for this field */
-            if (xmlStrEqual (attr_val, (const xmlChar *) "cubic convolution"))
-                bmeta->resample_method = ESPA_CC;
-            else if (xmlStrEqual (attr_val,
-                (const xmlChar *) "nearest neighbor"))
-                bmeta->resample_method = ESPA_NN;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "bilinear"))
-                bmeta->resample_method = ESPA_BI;
-            else if (xmlStrEqual (attr_val, (const xmlChar *) "none"))
-                bmeta->resample_method = ESPA_NONE;
+            cptr = end;
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "valid_range"))
+    }
+
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_band
+
+PURPOSE: Parses the current band element into the band metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the band metadata elements
+SUCCESS         Successful parse of the band metadata values
+
+NOTES:
+******************************************************************************/
+static int parse_band
+(
+    Xml_parser_t *parser,       /* I: parser state, at the band element */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata structure for the
+                                        current band */
+)
+{
+    char FUNC_NAME[] = "parse_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char section[] = "band";
+    char text[STR_SIZE];        /* text of the element */
+    Xml_name_t id;              /* ID of the current element/attribute */
+    const char *value = NULL;   /* value of the current attribute */
+    int depth;                  /* depth of the band element */
+    int status;                 /* return status */
+
+    /* Handle the element attributes for the band element */
+    while (next_attribute (parser, &id, &value))
+    {
+        status = SUCCESS;
+        switch (id)
         {
-            /* Handle the element attributes */
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-            {
-                attr_val = xmlGetProp (cur_node, attr->name);
-                if (xmlStrEqual (attr->name, (const xmlChar *) "min"))
-                    bmeta->valid_range[0] = atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "max"))
-                    bmeta->valid_range[1] = atof ((const char *) attr_val);
+            case XN_PRODUCT:
+                status = copy_string (bmeta->product, sizeof (bmeta->product),
+                    value, "bmeta->product");
+                break;
+            case XN_SOURCE:
+                status = copy_string (bmeta->source, sizeof (bmeta->source),
+                    value, "bmeta->source");
+                break;
+            case XN_NAME:
+                status = copy_string (bmeta->name, sizeof (bmeta->name),
+                    value, "bmeta->name");
+                break;
+            case XN_CATEGORY:
+                status = copy_string (bmeta->category,
+                    sizeof (bmeta->category), value, "bmeta->category");
+                break;
+            case XN_DATA_TYPE:
+                if (!strcmp (value, "INT8"))
+                    bmeta->data_type = ESPA_INT8;
+                else if (!strcmp (value, "UINT8"))
+                    bmeta->data_type = ESPA_UINT8;
+                else if (!strcmp (value, "INT16"))
+                    bmeta->data_type = ESPA_INT16;
+                else if (!strcmp (value, "UINT16"))
+                    bmeta->data_type = ESPA_UINT16;
+                else if (!strcmp (value, "INT32"))
+                    bmeta->data_type = ESPA_INT32;
+                else if (!strcmp (value, "UINT32"))
+                    bmeta->data_type = ESPA_UINT32;
+                else if (!strcmp (value, "FLOAT32"))
+                    bmeta->data_type = ESPA_FLOAT32;
+                else if (!strcmp (value, "FLOAT64"))
+                    bmeta->data_type = ESPA_FLOAT64;
                 else
                 {
-                    sprintf (errmsg, "WARNING: unknown attribute for element "
-                        "(%s): %s\n", cur_node->name, attr->name);
+                    sprintf (errmsg, "Unsupported band data_type: %s", value);
                     error_handler (false, FUNC_NAME, errmsg);
                 }
-                xmlFree (attr_val);
-            }
+                break;
+            case XN_NLINES:
+                bmeta->nlines = atoi (value);
+                break;
+            case XN_NSAMPS:
+                bmeta->nsamps = atoi (value);
+                break;
+            case XN_FILL_VALUE:
+                bmeta->fill_value = atoi (value);
+                break;
+            case XN_SATURATE_VALUE:
+                bmeta->saturate_value = atoi (value);
+                break;
+            case XN_SCALE_FACTOR:
+                bmeta->scale_factor = atof (value);
+                break;
+            case XN_ADD_OFFSET:
+                bmeta->add_offset = atof (value);
+                break;
+            default:
+                unknown_attribute (parser);
+                break;
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "radiance"))
+
+        if (status != SUCCESS)
+            return (ERROR);
+    }
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    /* Process the children of this band */
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
+    {
+        id = get_xml_name_id (parser);
+        switch (id)
         {
-            /* Handle the element attributes */
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-            {
-                attr_val = xmlGetProp (cur_node, attr->name);
-                if (xmlStrEqual (attr->name, (const xmlChar *) "gain"))
-                    bmeta->rad_gain = atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "bias"))
-                    bmeta->rad_bias = atof ((const char *) attr_val);
+            case XN_SHORT_NAME:
+                status = read_element_text (parser, section,
+                    bmeta->short_name, sizeof (bmeta->short_name));
+                break;
+
+            case XN_LONG_NAME:
+                status = read_element_text (parser, section,
+                    bmeta->long_name, sizeof (bmeta->long_name));
+                break;
+
+            case XN_FILE_NAME:
+                status = read_element_text (parser, section,
+                    bmeta->file_name, sizeof (bmeta->file_name));
+                break;
+
+            case XN_DATA_UNITS:
+                status = read_element_text (parser, section,
+                    bmeta->data_units, sizeof (bmeta->data_units));
+                break;
+
+            case XN_QA_DESCRIPTION:
+                if (parser->lazy)
+                    status = skip_element (parser);
+                else
+                    status = read_element_text (parser, section,
+                        bmeta->qa_desc, sizeof (bmeta->qa_desc));
+                break;
+
+            case XN_APP_VERSION:
+                status = read_element_text (parser, section,
+                    bmeta->app_version, sizeof (bmeta->app_version));
+                break;
+
+            case XN_PRODUCTION_DATE:
+                status = read_element_text (parser, section,
+                    bmeta->production_date, sizeof (bmeta->production_date));
+                break;
+
+            case XN_RESAMPLE_METHOD:
+                status = read_element_text (parser, section, text,
+                    sizeof (text));
+                if (status != SUCCESS)
+                    break;
+                if (!strcmp (text, "cubic convolution"))
+                    bmeta->resample_method = ESPA_CC;
+                else if (!strcmp (text, "nearest neighbor"))
+                    bmeta->resample_method = ESPA_NN;
+                else if (!strcmp (text, "bilinear"))
+                    bmeta->resample_method = ESPA_BI;
+                else if (!strcmp (text, "none"))
+                    bmeta->resample_method = ESPA_NONE;
                 else
                 {
-                    sprintf (errmsg, "WARNING: unknown attribute for element "
-                        "(%s): %s\n", cur_node->name, attr->name);
+                    sprintf (errmsg, "Unknown resample method: %s", text);
                     error_handler (false, FUNC_NAME, errmsg);
                 }
-                xmlFree (attr_val);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "reflectance"))
-        {
-            /* Handle the element attributes */
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-            {
-                attr_val = xmlGetProp (cur_node, attr->name);
-                if (xmlStrEqual (attr->name, (const xmlChar *) "gain"))
-                    bmeta->refl_gain = atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "bias"))
-                    bmeta->refl_bias = atof ((const char *) attr_val);
-                else
+                break;
+
+            case XN_PIXEL_SIZE:
+                while (next_attribute (parser, &id, &value))
                 {
-                    sprintf (errmsg, "WARNING: unknown attribute for element "
-                        "(%s): %s\n", cur_node->name, attr->name);
-                    error_handler (false, FUNC_NAME, errmsg);
+                    if (id == XN_X)
+                        bmeta->pixel_size[0] = atof (value);
+                    else if (id == XN_Y)
+                        bmeta->pixel_size[1] = atof (value);
+                    else if (id == XN_UNITS)
+                    {
+                        if (copy_string (bmeta->pixel_units,
+                            sizeof (bmeta->pixel_units), value,
+                            "bmeta->pixel_units") != SUCCESS)
+                            return (ERROR);
+                    }
+                    else
+                        unknown_attribute (parser);
                 }
-                xmlFree (attr_val);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "thermal_const"))
-        {
-            /* Handle the element attributes */
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-            {
-                attr_val = xmlGetProp (cur_node, attr->name);
-                if (xmlStrEqual (attr->name, (const xmlChar *) "k1"))
-                    bmeta->k1_const = atof ((const char *) attr_val);
-                else if (xmlStrEqual (attr->name, (const xmlChar *) "k2"))
-                    bmeta->k2_const = atof ((const char *) attr_val);
-                else
+                status = skip_element (parser);
+                break;
+
+            case XN_SUB_SAMPLE:
+                while (next_attribute (parser, &id, &value))
                 {
-                    sprintf (errmsg, "WARNING: unknown attribute for element "
-                        "(%s): %s\n", cur_node->name, attr->name);
-                    error_handler (false, FUNC_NAME, errmsg);
+                    if (id == XN_FACTOR)
+                        bmeta->sub_sample.factor = atoi (value);
+                    else if (id == XN_NLINES)
+                        bmeta->sub_sample.nlines = atoi (value);
+                    else if (id == XN_NSAMPS)
+                        bmeta->sub_sample.nsamps = atoi (value);
+                    else
+                        unknown_attribute (parser);
                 }
-                xmlFree (attr_val);
-            }
-        }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "qa_description"))
-        {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+                status = skip_element (parser);
+                break;
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->qa_desc, sizeof (bmeta->qa_desc), "%s",
-                (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->qa_desc))
-            {
-                sprintf (errmsg, "Overflow of bmeta->qa_desc string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            case XN_CONSTANT:
+                bmeta->constant.is_constant = true;
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_VALUE)
+                        bmeta->constant.value = atof (value);
+                    else if (id == XN_FILL_BAND)
+                    {
+                        if (copy_string (bmeta->constant.fill_band,
+                            sizeof (bmeta->constant.fill_band), value,
+                            "bmeta->constant.fill_band") != SUCCESS)
+                            return (ERROR);
+                    }
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_DERIVED:
+                bmeta->derived.is_derived = true;
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_EXPRESSION)
+                    {
+                        if (copy_string (bmeta->derived.expression,
+                            sizeof (bmeta->derived.expression), value,
+                            "bmeta->derived.expression") != SUCCESS)
+                            return (ERROR);
+                    }
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_TILING:
+                bmeta->tiling.is_tiled = true;
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_NLINES)
+                        bmeta->tiling.nlines = atoi (value);
+                    else if (id == XN_NSAMPS)
+                        bmeta->tiling.nsamps = atoi (value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_PROVENANCE:
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_STAGE)
+                        snprintf (bmeta->provenance.stage,
+                            sizeof (bmeta->provenance.stage), "%s", value);
+                    else if (id == XN_KEY)
+                        snprintf (bmeta->provenance.key,
+                            sizeof (bmeta->provenance.key), "%s", value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_VALID_RANGE:
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_MIN)
+                        bmeta->valid_range[0] = atof (value);
+                    else if (id == XN_MAX)
+                        bmeta->valid_range[1] = atof (value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_RADIANCE:
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_GAIN)
+                        bmeta->rad_gain = atof (value);
+                    else if (id == XN_BIAS)
+                        bmeta->rad_bias = atof (value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_REFLECTANCE:
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_GAIN)
+                        bmeta->refl_gain = atof (value);
+                    else if (id == XN_BIAS)
+                        bmeta->refl_bias = atof (value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_THERMAL_CONST:
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_K1)
+                        bmeta->k1_const = atof (value);
+                    else if (id == XN_K2)
+                        bmeta->k2_const = atof (value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = skip_element (parser);
+                break;
+
+            case XN_BITMAP_DESCRIPTION:
+            case XN_CLASS_VALUES:
+            case XN_PERCENT_COVERAGE:
+                if (parser->lazy)
+                    status = skip_element (parser);
+                else
+                    status = parse_band_list (parser, id, bmeta);
+                break;
+
+            case XN_STATISTICS:
+                if (parser->lazy)
+                    status = skip_element (parser);
+                else
+                    status = parse_band_statistics (parser, bmeta);
+                break;
+
+            case XN_CHECKSUM:
+                text[0] = '\0';
+                while (next_attribute (parser, &id, &value))
+                {
+                    if (id == XN_TYPE)
+                        snprintf (text, sizeof (text), "%s", value);
+                    else
+                        unknown_attribute (parser);
+                }
+                status = read_element_text (parser, section,
+                    bmeta->checksum, sizeof (bmeta->checksum));
+                if (status == SUCCESS && strcmp (text, ESPA_CHECKSUM_TYPE))
+                {
+                    sprintf (errmsg, "Ignoring the %s checksum of band %s; "
+                        "only %s checksums are supported.", text,
+                        bmeta->name, ESPA_CHECKSUM_TYPE);
+                    error_handler (false, FUNC_NAME, errmsg);
+                    bmeta->checksum[0] = '\0';
+                }
+                break;
+
+            default:
+                status = skip_unknown_element (parser, section);
+                break;
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "app_version"))
+
+        if (status != SUCCESS)
         {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            sprintf (errmsg, "Consuming band metadata element for band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->app_version, sizeof (bmeta->app_version),
-                "%s", (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->app_version))
-            {
-                sprintf (errmsg, "Overflow of bmeta->app_version string");
-                error_handler (true, FUNC_NAME, errmsg);
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_bands
+
+PURPOSE: Parses the bands section into the band metadata of the ESPA internal
+metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the bands elements
+SUCCESS         Successful parse of the bands
+
+NOTES:
+  1. Memory is allocated for the bands as they are found, and the band array
+     is trimmed to the number of bands once the section has been read.
+******************************************************************************/
+static int parse_bands
+(
+    Xml_parser_t *parser,           /* I: parser state, at the bands
+                                          element */
+    Espa_internal_meta_t *metadata  /* I/O: ESPA internal metadata structure
+                                          to be filled */
+)
+{
+    char FUNC_NAME[] = "parse_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int depth;                  /* depth of the bands element */
+    int status;                 /* return status */
+    int nalloc = 0;             /* number of bands allocated */
+    Espa_band_meta_t *bmeta = NULL;  /* trimmed band array */
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
+    {
+        /* Elements which aren't in the ESPA namespace are skipped */
+        status = is_espa_element (parser);
+        if (status == 0)
+            continue;
+        else if (status < 0)
+            return (ERROR);
+
+        if (get_xml_name_id (parser) != XN_BAND)
+        {
+            if (skip_unknown_element (parser, "bands") != SUCCESS)
                 return (ERROR);
-            }
+            continue;
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "production_date"))
+
+        /* Add and initialize a new band */
+        if (grow_array ((void **) &metadata->band, &nalloc, metadata->nbands,
+            sizeof (Espa_band_meta_t), "bands") != SUCCESS)
+            return (ERROR);
+        init_band_metadata (&metadata->band[metadata->nbands]);
+        metadata->band[metadata->nbands].arena = get_metadata_arena (metadata);
+        if (metadata->band[metadata->nbands].arena == NULL)
+            return (ERROR);
+        metadata->nbands++;
+
+        if (parse_band (parser, &metadata->band[metadata->nbands-1]) !=
+            SUCCESS)
         {
-            /* Expect the child node to be a text node containing the value of
-               this field */
-            if (child_node == NULL || child_node->type != XML_TEXT_NODE) 
-            {
-                sprintf (errmsg, "Processing band metadata element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            sprintf (errmsg, "Consuming band metadata element %d",
+                metadata->nbands - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
 
-            /* Copy the content of the child node into value for this field */
-            count = snprintf (bmeta->production_date,
-                sizeof (bmeta->production_date), "%s",
-                (const char *) child_node->content);
-            if (count < 0 || count >= sizeof (bmeta->production_date))
-            {
-                sprintf (errmsg, "Overflow of bmeta->production_date string");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+    /* Release the unused bands */
+    if (metadata->nbands > 0 && metadata->nbands < nalloc)
+    {
+        bmeta = realloc (metadata->band,
+            metadata->nbands * sizeof (Espa_band_meta_t));
+        if (bmeta != NULL)
+            metadata->band = bmeta;
+    }
+
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_metadata_root
+
+PURPOSE: Parses the global metadata and bands sections of the root element
+into the ESPA internal metadata structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the sections
+SUCCESS         Successful parse of the sections
+
+NOTES:
+******************************************************************************/
+static int parse_metadata_root
+(
+    Xml_parser_t *parser,           /* I: parser state, at the root
+                                          element */
+    Espa_internal_meta_t *metadata  /* I/O: ESPA internal metadata structure
+                                          to be filled */
+)
+{
+    int depth;                  /* depth of the root element */
+    int status;                 /* return status */
+
+    if (xmlTextReaderIsEmptyElement (parser->reader))
+        return (SUCCESS);
+
+    depth = xmlTextReaderDepth (parser->reader);
+    while ((status = next_child_element (parser, depth)) == 1)
+    {
+        /* Elements which aren't in the ESPA namespace are skipped */
+        status = is_espa_element (parser);
+        if (status == 0)
+            continue;
+        else if (status < 0)
+            return (ERROR);
+
+        switch (get_xml_name_id (parser))
+        {
+            case XN_GLOBAL_METADATA:
+                status = parse_global_metadata (parser, &metadata->global);
+                break;
+            case XN_BANDS:
+                status = parse_bands (parser, metadata);
+                break;
+            default:
+                status = skip_unknown_element (parser, "metadata");
+                break;
+        }
+
+        if (status != SUCCESS)
+            return (ERROR);
+    }
+
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  parse_metadata_file
+
+PURPOSE: Parse the input metadata file and populate the associated ESPA
+internal metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
+
+NOTES:
+  1. The file is read in a single pass; the values are stored in the metadata
+     structure as each element is read and no document tree is built.
+  2. In lazy mode the band details (QA description, bitmap descriptions,
+     classes, cover types and statistics) are skipped.
+******************************************************************************/
+static int parse_metadata_file
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata, /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+    bool lazy                       /* I: skip the band details */
+)
+{
+    char FUNC_NAME[] = "parse_metadata_file";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    Xml_parser_t parser;        /* parser state */
+    const xmlChar *ns = NULL;   /* namespace of the root element */
+    int status;                 /* return status */
+
+    /* Establish the reader for this metadata file */
+    if (init_xml_parser (metafile, &parser) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the parser for %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    parser.lazy = lazy;
+
+    /* Find the root element */
+    while ((status = xmlTextReaderRead (parser.reader)) == 1)
+    {
+        if (xmlTextReaderNodeType (parser.reader) == XML_READER_TYPE_ELEMENT)
+            break;
+    }
+    if (status != 1)
+    {
+        sprintf (errmsg, "Failed to parse %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeTextReader (parser.reader);
+        return (ERROR);
+    }
+
+    /* Store the namespace for the overall metadata file */
+    ns = xmlTextReaderConstNamespaceUri (parser.reader);
+    if (ns == NULL)
+        ns = (const xmlChar *) "";
+    if (copy_string (metadata->meta_namespace,
+        sizeof (metadata->meta_namespace), (const char *) ns,
+        "metadata->meta_namespace") != SUCCESS)
+    {
+        xmlFreeTextReader (parser.reader);
+        return (ERROR);
+    }
+
+    /* Parse the global metadata and the bands directly into the ESPA internal
+       metadata structure */
+    if (parse_metadata_root (&parser, metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Parsing the metadata file into the internal "
+            "metadata structure.");
+        error_handler (true, FUNC_NAME, errmsg);
+        xmlFreeTextReader (parser.reader);
+        return (ERROR);
+    }
+
+    /* Free the reader and associated memory.  The XML library itself is
+       cleaned up by cleanup_espa_xml, since the cached schema relies on it. */
+    xmlFreeTextReader (parser.reader);
+
+    /* Index the bands for the band lookups */
+    if (build_band_index (metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the bands of %s", metafile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_metadata
+
+PURPOSE: Parse the input metadata file and populate the associated ESPA
+internal metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
+
+NOTES:
+  1. The file is read in a single pass; the values are stored in the metadata
+     structure as each element is read and no document tree is built.
+  2. If ESPA_METADATA_CACHE is "sidecar", the metadata is loaded from the
+     binary sidecar of the file when it was written for the current file,
+     and otherwise a new sidecar is written once the file is parsed (see
+     metadata_cache.c).
+******************************************************************************/
+int parse_metadata
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    bool use_cache = use_metadata_cache ();  /* is the sidecar used */
+    bool loaded;                /* was the metadata loaded from the sidecar */
+    Metadata_cache_key_t key;   /* key of the metadata file for the sidecar */
+    ESPA_PROFILE_SCOPE ("parse_metadata");
+
+    /* Load the metadata from the sidecar if it's up to date */
+    if (use_cache)
+    {
+        if (read_metadata_cache (metafile, &key, metadata, &loaded) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+        espa_profile_count_cache (ESPA_PROFILE_CACHE_METADATA, loaded);
+        if (loaded)
+            return (SUCCESS);
+    }
+
+    if (parse_metadata_file (metafile, metadata, false) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Save the parsed metadata for the next application which reads this
+       file.  A failure has already been reported as a warning. */
+    if (use_cache)
+        write_metadata_cache (metafile, &key, metadata);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_metadata_lazy
+
+PURPOSE: Parse the global metadata and the main band fields of the input
+metadata file, leaving the band details to be loaded when they're needed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
+
+NOTES:
+  1. This is for applications which only need the global metadata and the
+     band attributes, names, files, sizes and calibration.  The QA
+     description, bitmap descriptions, classes, cover types and statistics of
+     the bands are left as initialized by init_band_metadata until
+     load_band_details is called.
+  2. write_metadata loads the band details itself.  The bands must have
+     their details loaded before they're given to append_metadata or
+     merge_band_metadata.
+  3. An up-to-date sidecar (see parse_metadata) holds the complete metadata,
+     so it is used if available and the band details are then loaded.
+******************************************************************************/
+int parse_metadata_lazy
+(
+    char *metafile,                 /* I: input metadata file */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+)
+{
+    char FUNC_NAME[] = "parse_metadata_lazy";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    bool loaded;                /* was the metadata loaded from the sidecar */
+    Metadata_cache_key_t key;   /* key of the metadata file for the sidecar */
+
+    /* Load the complete metadata from the sidecar if it's up to date */
+    if (use_metadata_cache ())
+    {
+        if (read_metadata_cache (metafile, &key, metadata, &loaded) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
         }
-        else if (xmlStrEqual (cur_node->name,
-            (const xmlChar *) "bitmap_description"))
+        espa_profile_count_cache (ESPA_PROFILE_CACHE_METADATA, loaded);
+        if (loaded)
+            return (SUCCESS);
+    }
+
+    if (parse_metadata_file (metafile, metadata, true) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Remember where the band details come from */
+    metadata->lazy_file = strdup (metafile);
+    if (metadata->lazy_file == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the metadata filename");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  load_band_details
+
+PURPOSE: Loads the band details (QA description, bitmap descriptions,
+classes, cover types and statistics) skipped by parse_metadata_lazy.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the band details, or the file no longer has
+                the same bands
+SUCCESS         The band details are loaded
+
+NOTES:
+  1. Nothing is done if the band details have already been loaded, or the
+     metadata wasn't parsed by parse_metadata_lazy.
+  2. The file is parsed again in full and the details are copied into the
+     arena of the metadata structure.
+******************************************************************************/
+int load_band_details
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata structure from
+                                            parse_metadata_lazy */
+)
+{
+    char FUNC_NAME[] = "load_band_details";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i, j;                   /* looping variables */
+    int status = SUCCESS;       /* return status */
+    Espa_band_meta_t *src = NULL;  /* band with the details */
+    Espa_band_meta_t *dst = NULL;  /* band missing the details */
+    Espa_internal_meta_t full;  /* complete metadata of the file */
+
+    if (metadata->lazy_file == NULL)
+        return (SUCCESS);
+
+    init_metadata_struct (&full);
+    if (parse_metadata_file (metadata->lazy_file, &full, false) != SUCCESS)
+    {
+        sprintf (errmsg, "Parsing the band details of %s",
+            metadata->lazy_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&full);
+        return (ERROR);
+    }
+
+    if (full.nbands != metadata->nbands)
+        status = ERROR;
+    for (i = 0; status == SUCCESS && i < metadata->nbands; i++)
+    {
+        src = &full.band[i];
+        dst = &metadata->band[i];
+        if (strcmp (src->name, dst->name) || strcmp (src->product,
+            dst->product))
         {
-            if (add_band_metadata_bitmap_description (cur_node->children,
-                bmeta) != SUCCESS)
-            {
-                sprintf (errmsg, "Processing bitmap_description element: "
-                    "%s.", cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            status = ERROR;
+            break;
         }
-        else if (xmlStrEqual (cur_node->name, (const xmlChar *) "class_values"))
+
+        strcpy (dst->qa_desc, src->qa_desc);
+        dst->stats = src->stats;
+        if (src->nbits > 0)
         {
-            if (add_band_metadata_class_values (cur_node->children, bmeta) !=
-                SUCCESS)
-            {
-                sprintf (errmsg, "Processing class_values element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            status = allocate_bitmap_metadata (dst, src->nbits);
+            for (j = 0; status == SUCCESS && j < src->nbits; j++)
+                strcpy (dst->bitmap_description[j],
+                    src->bitmap_description[j]);
         }
-        else if (xmlStrEqual (cur_node->name,
-             (const xmlChar *) "percent_coverage"))
+        if (status == SUCCESS && src->nclass > 0)
         {
-            if (add_band_metadata_percent_coverage (cur_node->children, bmeta)
-                != SUCCESS)
-            {
-                sprintf (errmsg, "Processing percent_coverage element: %s.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            status = allocate_class_metadata (dst, src->nclass);
+            if (status == SUCCESS)
+                memcpy (dst->class_values, src->class_values,
+                    src->nclass * sizeof (Espa_class_t));
         }
-        else
+        if (status == SUCCESS && src->ncover > 0)
         {
-            sprintf (errmsg, "Unknown element (%s) in the band metadata",
-                cur_node->name);
-            error_handler (false, FUNC_NAME, errmsg);
+            status = allocate_percent_coverage_metadata (dst, src->ncover);
+            if (status == SUCCESS)
+                memcpy (dst->percent_cover, src->percent_cover,
+                    src->ncover * sizeof (Espa_percent_cover_t));
         }
-    } /* for siblings */
+    }
+    free_metadata (&full);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Loading the band details of %s; the bands in the "
+            "file have changed", metadata->lazy_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    free (metadata->lazy_file);
+    metadata->lazy_file = NULL;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_node_parser
+
+PURPOSE: Sets up a parser which walks the document tree of an element node,
+and advances it to that element.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the parser, or the node isn't an element of
+                a document
+SUCCESS         Parser is at the element
+
+NOTES:
+  1. Used by the document tree functions below, which are kept for
+     applications written against the earlier version of this library.  The
+     document is walked from its start to the element, so these are slower
+     than parse_metadata for a whole file.
+******************************************************************************/
+static int open_node_parser
+(
+    xmlNode *a_node,            /* I: element node of a document tree */
+    Xml_parser_t *parser        /* O: parser state, at the element */
+)
+{
+    char FUNC_NAME[] = "open_node_parser";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+
+    if (a_node == NULL || a_node->type != XML_ELEMENT_NODE ||
+        a_node->doc == NULL)
+    {
+        sprintf (errmsg, "Expected an element node of an XML document");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    init_espa_xml ();
+    parser->reader = xmlReaderWalker (a_node->doc);
+    if (parser->reader == NULL)
+    {
+        sprintf (errmsg, "Setting up the reader for element %s",
+            a_node->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (init_xml_names (parser) != SUCCESS)
+    {
+        xmlFreeTextReader (parser->reader);
+        return (ERROR);
+    }
+
+    /* Walk the document to the element */
+    while (xmlTextReaderRead (parser->reader) == 1)
+    {
+        if (xmlTextReaderNodeType (parser->reader) ==
+            XML_READER_TYPE_ELEMENT &&
+            xmlTextReaderCurrentNode (parser->reader) == a_node)
+            return (SUCCESS);
+    }
+
+    sprintf (errmsg, "Finding element %s in its document", a_node->name);
+    error_handler (true, FUNC_NAME, errmsg);
+    xmlFreeTextReader (parser->reader);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  add_proj_params_node
+
+PURPOSE: Parses a *_proj_params element of a document tree into the global
+metadata projection information structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection parameters
+SUCCESS         Successful parse of the projection parameters
+
+NOTES:
+******************************************************************************/
+static int add_proj_params_node
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    int proj_type,              /* I: projection type expected for these
+                                      parameters */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    Xml_parser_t parser;        /* parser state */
+    int status;                 /* return status */
+
+    if (open_node_parser (a_node, &parser) != SUCCESS)
+        return (ERROR);
+    status = parse_proj_params (&parser, proj_type, gmeta);
+    xmlFreeTextReader (parser.reader);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  add_global_metadata_proj_info_albers
+
+PURPOSE: Add the ALBERS projection elements node to the global metadata
+projection information structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection_info elements
+SUCCESS         Successful parse of the projection_info values
+
+NOTES:
+  1. Deprecated; kept for applications which parse the document tree
+     themselves.  Use parse_metadata to parse a metadata file.
+******************************************************************************/
+int add_global_metadata_proj_info_albers
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    return (add_proj_params_node (a_node, GCTP_ALBERS_PROJ, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  add_global_metadata_proj_info_ps
+
+PURPOSE: Add the PS projection elements node to the global metadata
+projection information structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection_info elements
+SUCCESS         Successful parse of the projection_info values
+
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+******************************************************************************/
+int add_global_metadata_proj_info_ps
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    return (add_proj_params_node (a_node, GCTP_PS_PROJ, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  add_global_metadata_proj_info_sin
+
+PURPOSE: Add the SIN projection elements node to the global metadata
+projection information structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection_info elements
+SUCCESS         Successful parse of the projection_info values
+
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+******************************************************************************/
+int add_global_metadata_proj_info_sin
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    return (add_proj_params_node (a_node, GCTP_SIN_PROJ, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  add_global_metadata_proj_info_utm
+
+PURPOSE: Add the UTM projection elements node to the global metadata
+projection information structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection_info elements
+SUCCESS         Successful parse of the projection_info values
+
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+******************************************************************************/
+int add_global_metadata_proj_info_utm
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    return (add_proj_params_node (a_node, GCTP_UTM_PROJ, gmeta));
+}
+
+
+/******************************************************************************
+MODULE:  add_global_metadata_proj_info
+
+PURPOSE: Add the projection_information element node to the global metadata
+structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the projection_info elements
+SUCCESS         Successful parse of the projection_info values
+
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+******************************************************************************/
+int add_global_metadata_proj_info
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    Xml_parser_t parser;        /* parser state */
+    int status;                 /* return status */
+
+    if (open_node_parser (a_node, &parser) != SUCCESS)
+        return (ERROR);
+    status = parse_proj_info (&parser, gmeta);
+    xmlFreeTextReader (parser.reader);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  add_global_metadata_bounding_coords
+
+PURPOSE: Add the bounding_coordinates element node to the global metadata
+structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the bounding_coords elements
+SUCCESS         Successful parse of the bounding_coords values
 
-    return (SUCCESS);
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+******************************************************************************/
+int add_global_metadata_bounding_coords
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
+)
+{
+    Xml_parser_t parser;        /* parser state */
+    int status;                 /* return status */
+
+    if (open_node_parser (a_node, &parser) != SUCCESS)
+        return (ERROR);
+    status = parse_bounding_coords (&parser, gmeta);
+    xmlFreeTextReader (parser.reader);
+    return (status);
 }
 
 
 /******************************************************************************
-MODULE:  parse_xml_into_struct
+MODULE:  add_global_metadata
 
-PURPOSE: Parse the XML document data into the ESPA internal metadata structure.
+PURPOSE: Add a child element node of the global_metadata element to the
+global metadata structure.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the metadata elements
-SUCCESS         Successful parse of the metadata values
+ERROR           Error parsing the global_metadata elements
+SUCCESS         Successful parse of the global_metadata values
 
 NOTES:
-1. Uses a stack of character strings to keep track of the nodes that have
-   been parsed.  The stack must be allocated before calling this routine.
+  1. Deprecated; see add_global_metadata_proj_info_albers.
 ******************************************************************************/
-int parse_xml_into_struct
+int add_global_metadata
 (
-    xmlNode *a_node,                  /* I: pointer to the current node */
-    Espa_internal_meta_t *metadata,   /* I: ESPA internal metadata structure
-                                            to be filled */
-    int *top_of_stack,                /* I: pointer to top of the stack */
-    char **stack                      /* I: stack to use for parsing */
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_global_meta_t *gmeta   /* I: global metadata structure */
 )
 {
-    char FUNC_NAME[] = "parse_xml_into_struct";  /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    char *curr_stack_element = NULL;  /* element popped from the stack */
-    xmlNode *cur_node = NULL;    /* pointer to the current node */
-    xmlNode *sib_node = NULL;    /* pointer to the sibling node */
-    static int nbands = 0;       /* number of bands in the XML structure */
-    static bool global_metadata = false;  /* are we parsing the global metadata
-                                    section of the ESPA metadata? */
-    static bool bands_metadata = false;   /* are we parsing the bands metadata
-                                    section of the ESPA metadata? */
-    static int cur_band = 0;     /* current band being processed in the
-                                    bands metadata section */
-    bool skip_child;             /* boolean to specify the children of this
-                                    node should not be processed */
-
-    /* Start at the input node and traverse the tree, visiting all the children
-       and siblings */
-    for (cur_node = a_node; cur_node;
-         cur_node = xmlNextElementSibling (cur_node))
-    {
-        /* Process the children of this element unless otherwise specified */
-        skip_child = false;
+    Xml_parser_t parser;        /* parser state */
+    int status;                 /* return status */
 
-        /* Only print the ELEMENT node types */
-        if (cur_node->type == XML_ELEMENT_NODE) 
-        {
-            /* Push the element to the stack and turn the booleans on if this
-               is either the global_metadata or the bands elements */
-            //printf ("***Pushed %s\n", cur_node->name); fflush (stdout);
-            if (push (top_of_stack, stack, (const char *) cur_node->name))
-            {
-                sprintf (errmsg, "Pushing element '%s' to the stack.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+    if (open_node_parser (a_node, &parser) != SUCCESS)
+        return (ERROR);
+    status = is_espa_element (&parser);
+    if (status == 1)
+        status = parse_global_element (&parser, gmeta);
+    else
+        status = (status == 0) ? SUCCESS : ERROR;
+    xmlFreeTextReader (parser.reader);
+    return (status);
+}
 
-            /* Turn the boolean on if this is the global_metadata. Flag an
-               issue if we have already traversed into the global metadata
-               section. */
-            if (xmlStrEqual (cur_node->name,
-                (const xmlChar *) "global_metadata"))
-            {
-                if (global_metadata)
-                {
-                    sprintf (errmsg, "Current element node is '%s' however we "
-                        "are already in the global_metadata section.",
-                        cur_node->name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                global_metadata = true;
-            }
 
-            /* Turn the boolean on if this is the bands metadata. Flag an
-               issue if we have already traversed into the bands section.
-               Count the number of band elements in this structure, then
-               allocate memory for the nbands. */
-            if (xmlStrEqual (cur_node->name, (const xmlChar *) "bands"))
-            {
-                if (bands_metadata)
-                {
-                    sprintf (errmsg, "Current element node is '%s' however we "
-                        "are already in the bands section.", cur_node->name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-                bands_metadata = true;
-                cur_band = 0;  /* reset to zero for start of band count */
+/******************************************************************************
+MODULE:  add_band_list_node
 
-                /* Count the number of siblings which are band elements */
-                nbands = 0;
-                for (sib_node = cur_node->children; sib_node;
-                     sib_node = xmlNextElementSibling (sib_node))
-                {
-                    /* If this is a band element then count it */
-                    if (xmlStrEqual (sib_node->name, (const xmlChar *) "band"))
-                        nbands++;
-                }
+PURPOSE: Parses the bitmap_description, class_values, or percent_coverage list
+of a document tree into the band metadata structure.
 
-                if (allocate_band_metadata (metadata, nbands) != SUCCESS)
-                {   /* Error messages already printed */
-                    return (ERROR);
-                }
-            }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the list
+SUCCESS         Successful parse of the list
+
+NOTES:
+  1. As in the earlier version of this library, a_node is the first child of
+     the list element, so NULL is an empty list.
+******************************************************************************/
+static int add_band_list_node
+(
+    xmlNode *a_node,            /* I: first child node of the list element */
+    Xml_name_t list_id,         /* I: ID of the list element */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
+)
+{
+    Xml_parser_t parser;        /* parser state */
+    int status;                 /* return status */
 
-            /* Print out the name of the element */
-            xmlAttrPtr attr;     /* pointer to the element attributes */
-            //printf ("node type: Element, name: %s\n", cur_node->name);
+    if (a_node == NULL)
+        return (SUCCESS);
 
-            /* Print out the attribute properties for this element */
-            for (attr = cur_node->properties; attr != NULL; attr = attr->next)
-            {
-                xmlChar *v = xmlGetProp (cur_node, attr->name);
-                //printf (" @%s=%s ", attr->name, v);
-                xmlFree (v);
-            }
-            //printf ("\n"); fflush (stdout);
+    if (open_node_parser (a_node->parent, &parser) != SUCCESS)
+        return (ERROR);
+    status = parse_band_list (&parser, list_id, bmeta);
+    xmlFreeTextReader (parser.reader);
+    return (status);
+}
 
-            /* If we are IN the global metadata (don't process the actual
-               global_metadata element) then consume this node and add the
-               information to the global metadata structure */
-            if (global_metadata && !xmlStrEqual (cur_node->name,
-                (const xmlChar *) "global_metadata"))
-            {
-                if (add_global_metadata (cur_node, &metadata->global))
-                {
-                    sprintf (errmsg, "Consuming global_metadata element '%s'.",
-                        cur_node->name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
 
-                /* Skip processing the children of this node, since they
-                   will be handled by the global metadata parser */
-                skip_child = true;
-            }
+/******************************************************************************
+MODULE:  add_band_metadata_bitmap_description
 
-            /* If we are IN the bands metadata and at a band element, then
-               consume this node and add the information to the band metadata
-               structure for the current band */
-            if (bands_metadata && xmlStrEqual (cur_node->name,
-                (const xmlChar *) "band"))
-            {
-                if (cur_band >= nbands)
-                {
-                    sprintf (errmsg, "Number of bands consumed already "
-                        "reached the total number of bands allocated for this "
-                        "XML file (%d).", nbands);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+PURPOSE: Add the bit elements of the bitmap_description to the band metadata
+structure.
 
-                if (add_band_metadata (cur_node, &metadata->band[cur_band++]))
-                {
-                    sprintf (errmsg, "Consuming band metadata element '%s'.",
-                        cur_node->name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the bit elements
+SUCCESS         Successful parse of the bit values
 
-                /* Skip processing the children of this node, since they
-                   will be handled by the global metadata parser */
-                skip_child = true;
-            }
-        }
-        else if (cur_node->type == XML_TEXT_NODE) 
-        {
-            /* Print out the text for the element */
-            //printf ("   node type: Text, content: %s\n", cur_node->content);
-        }
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+  2. Memory is allocated in the band metadata for the number of bits in the
+     bitmap description.
+******************************************************************************/
+int add_band_metadata_bitmap_description
+(
+    xmlNode *a_node,            /* I/O: pointer to the element node to
+                                        process */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
+)
+{
+    return (add_band_list_node (a_node, XN_BITMAP_DESCRIPTION, bmeta));
+}
 
-        /* Parse the children of this node if they haven't been consumed
-           elsewhere */
-        if (!skip_child)
-        {
-            if (parse_xml_into_struct (cur_node->children, metadata,
-                top_of_stack, stack))
-            {
-                sprintf (errmsg, "Parsing the children of this element '%s'.",
-                    cur_node->name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
 
-        /* Done with the element and its siblings so pop the element name off
-           the stack */
-        if (cur_node->type == XML_ELEMENT_NODE)
-        {
-            curr_stack_element = pop (top_of_stack, stack);
-            if (curr_stack_element == NULL)
-            {
-                sprintf (errmsg, "Popping elements off the stack.");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-            //printf ("***Popped %s\n", curr_stack_element); fflush (stdout);
+/******************************************************************************
+MODULE:  add_band_metadata_class_values
 
-            if (!strcmp (curr_stack_element, "global_metadata"))
-                global_metadata = false;
-            if (!strcmp (curr_stack_element, "bands"))
-                bands_metadata = false;
-        }
-    }  /* for cur_node */
+PURPOSE: Add the class elements of the class_values to the band metadata
+structure.
 
-    return (SUCCESS);
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the class elements
+SUCCESS         Successful parse of the class values
+
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+  2. Memory is allocated in the band metadata for the number of classes.
+******************************************************************************/
+int add_band_metadata_class_values
+(
+    xmlNode *a_node,            /* I/O: pointer to the element node to
+                                        process */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
+)
+{
+    return (add_band_list_node (a_node, XN_CLASS_VALUES, bmeta));
 }
 
 
 /******************************************************************************
-MODULE:  parse_metadata
+MODULE:  add_band_metadata_percent_coverage
 
-PURPOSE: Parse the input metadata file and populate the associated ESPA
-internal metadata file.
+PURPOSE: Add the cover elements of the percent_coverage to the band metadata
+structure.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error parsing the metadata elements
-SUCCESS         Successful parse of the metadata values
+ERROR           Error parsing the cover elements
+SUCCESS         Successful parse of the cover values
 
 NOTES:
-1. Uses a stack of character strings to keep track of the nodes that have beend
-   found in the metadata document.
-2. For debugging purposes
-   xmlDocDump (stderr, doc);
-   can be used to dump/print the XML doc to the screen.
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+  2. Memory is allocated in the band metadata for the number of cover types.
 ******************************************************************************/
-int parse_metadata
+int add_band_metadata_percent_coverage
 (
-    char *metafile,                 /* I: input metadata file or URL */
-    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
-                                          been initialized via
-                                          init_metadata_struct */
+    xmlNode *a_node,            /* I/O: pointer to the element node to
+                                        process */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
 )
 {
-    char FUNC_NAME[] = "parse_metadata";  /* function name */
-    char errmsg[STR_SIZE];        /* error message */
-    xmlTextReaderPtr reader;  /* reader for the XML file */
-    xmlDocPtr doc = NULL;     /* document tree pointer */
-    xmlNodePtr current=NULL;  /* pointer to the current node */
-    int status;               /* return status */
-    int nodeType;             /* node type (element, text, attribute, etc.) */
-    int top_of_stack;         /* top of the stack */
-    int count;                /* number of chars copied in snprintf */
-    char **stack = NULL;      /* stack to keep track of elements in the tree */
+    return (add_band_list_node (a_node, XN_PERCENT_COVERAGE, bmeta));
+}
 
-    /* Establish the reader for this metadata file */
-    reader = xmlNewTextReaderFilename (metafile);
-    if (reader == NULL)
-    {
-        sprintf (errmsg, "Setting up reader for %s", metafile);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    /* Use the reader to parse the XML file, looking at each of the nodes,
-       until the entire file has been parsed.  Start by reading the first
-       node in the file. */
-    status = xmlTextReaderRead (reader);
-    while (status == 1)
-    {
-        /* Determine what kind of node the reader is at (element, end element,
-           attribute, text/white space) and handle the information as desired */
-        nodeType = xmlTextReaderNodeType (reader);
-        if (nodeType == -1)
-        {
-            sprintf (errmsg, "Getting node type");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-        switch (nodeType)
-        {
-            case XML_READER_TYPE_ELEMENT:
-            {  /* Node is an element (ex. <global_metadata> */
-                xmlNodePtr node=NULL;
-                if (doc==NULL)
-                {
-                    doc=xmlNewDoc (BAD_CAST "1.0");
-                }
+/******************************************************************************
+MODULE:  add_band_metadata
 
-                /* Get the URI defining the namespace for this node */
-                if (xmlTextReaderConstNamespaceUri (reader) != NULL)
-                {
-                    /* Search the namespace for a document */
-                    xmlNsPtr ns = xmlSearchNs (doc, current,
-                        xmlTextReaderConstNamespaceUri(reader));
+PURPOSE: Add the band element node to the band metadata structure.
 
-                    /* Create a tree node for this element in the XML file
-                       using the element name */
-                    node = xmlNewNode (ns, xmlTextReaderConstName(reader));
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the band metadata elements
+SUCCESS         Successful parse of the band metadata values
 
-                    /* If the namespace is empty (i.e. root) then create a
-                       new namespace pointer with this node */
-                    if (ns == NULL)
-                    {
-                        ns = xmlNewNs (node,
-                            xmlTextReaderConstNamespaceUri(reader),
-                            xmlTextReaderConstPrefix(reader));
-                    }
-                }
-                else
-                {
-                    /* Create a tree node for this element in the XML file
-                       using the element name */
-                    node = xmlNewNode (0, xmlTextReaderConstName(reader));
-                }
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+  2. The band needs a metadata arena for its lists, as set up by
+     allocate_band_metadata.
+******************************************************************************/
+int add_band_metadata
+(
+    xmlNode *a_node,            /* I: pointer to the element node to process */
+    Espa_band_meta_t *bmeta     /* I: band metadata structure for current
+                                      band in the bands structure */
+)
+{
+    Xml_parser_t parser;        /* parser state */
+    int status;                 /* return status */
 
-                /* Set the element as the root if appropriate otherwise add
-                   it as a child to the previous element */
-                if (current == NULL)
-                {
-                    xmlDocSetRootElement (doc, node);
-                }
-                else
-                {
-                    xmlAddChild (current, node);
-                }
-                current = node;
+    if (open_node_parser (a_node, &parser) != SUCCESS)
+        return (ERROR);
+    status = parse_band (&parser, bmeta);
+    xmlFreeTextReader (parser.reader);
+    return (status);
+}
 
-                /* If the element has attributes, then handle them */
-                if (xmlTextReaderHasAttributes (reader))
-                {
-                    /* Get the number of attributes and then process each one */
-                    int i;
-                    int n_att = xmlTextReaderAttributeCount (reader);
-                    for (i = 0; i < n_att; i++)
-                    {
-                        /* Read each attribute, obtain the name and value,
-                           then add it as a property for this node in the
-                           tree */
-                        const xmlChar *k = NULL;
-                        xmlChar *v = NULL;
-                        xmlTextReaderMoveToAttributeNo (reader, i);
-                        k = xmlTextReaderConstName (reader);
-                        v = xmlTextReaderValue (reader);
-                        if (xmlTextReaderConstNamespaceUri (reader) != NULL)
-                        {
-                            if (!xmlStrEqual (
-                                xmlTextReaderConstNamespaceUri(reader),
-                                BAD_CAST "http://www.w3.org/2000/xmlns/"))
-                            {
-                                /* Search the namespace for the document */
-                                xmlNsPtr ns = xmlSearchNs (doc, current,
-                                    xmlTextReaderConstNamespaceUri(reader));
-                                if (ns == NULL)
-                                {
-                                    ns = xmlNewNs (node,
-                                        xmlTextReaderConstNamespaceUri(reader),
-                                        xmlTextReaderConstPrefix(reader));
-                                }
-
-                                /* Create a new property tagged with this
-                                   namespace and carried by this node */
-                                xmlNewNsProp (current, ns,
-                                    xmlTextReaderConstLocalName(reader), v);
-                            }
-                         }
-                         else
-                         {
-                            /* Add the attribute as a property of the node
-                               in the tree */
-                            xmlNewProp (current, k, v);
-                         }
-
-                         /* Free the XML value pointer */
-                         xmlFree (v);
-                    }
 
-                    /* We are done with the attributes so go to the current
-                       attribute node */
-                    xmlTextReaderMoveToElement (reader);
-                }
+/******************************************************************************
+MODULE:  parse_xml_into_struct
 
-                /* If this is an empty element, then return to the parent */
-                if (xmlTextReaderIsEmptyElement(reader))
-                    current = current->parent;
-                break;
-            }  /* End: Node is an element */
+PURPOSE: Parse the element nodes of a document tree, starting at a_node and
+continuing with its siblings, into the ESPA internal metadata structure.
 
-            case XML_READER_TYPE_END_ELEMENT:
-            {  /* Node is an end element (ex. </global_metadata>, so return
-                  to the parent */
-                current = current->parent;
-                break;
-            }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error parsing the metadata elements
+SUCCESS         Successful parse of the metadata values
 
-            case XML_READER_TYPE_TEXT:
-            {  /* Node is text or white space */
-                /* Read the value of the text and add it as text for the
-                   node, which is then added as a child to the tree */
-                const xmlChar *v = xmlTextReaderConstValue (reader);
-                xmlNodePtr node = xmlNewDocText (doc, v);
-                xmlAddChild (current, node);
-                break;
-            }
-        }  /* end switch */
+NOTES:
+  1. Deprecated; see add_global_metadata_proj_info_albers.
+  2. The global_metadata and bands elements are parsed as sections, and any
+     other element as the root of the metadata.  The stack is no longer
+     used, and may be NULL.
+******************************************************************************/
+int parse_xml_into_struct
+(
+    xmlNode *a_node,                  /* I: pointer to the current node */
+    Espa_internal_meta_t *metadata,   /* I: ESPA internal metadata structure
+                                            to be filled */
+    int *top_of_stack,                /* I: pointer to top of the stack
+                                            (unused) */
+    char **stack                      /* I: stack to use for parsing
+                                            (unused) */
+)
+{
+    char FUNC_NAME[] = "parse_xml_into_struct";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    xmlNode *cur_node = NULL;     /* pointer to the current node */
+    Xml_parser_t parser;          /* parser state */
+    int status;                   /* return status */
 
-        /* Read the next node */
-        status = xmlTextReaderRead (reader);
-    }  /* end while */
-    if (status != 0)
+    for (cur_node = a_node; cur_node; cur_node = cur_node->next)
     {
-        sprintf (errmsg, "Failed to parse %s", metafile);
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+        if (cur_node->type != XML_ELEMENT_NODE)
+            continue;
 
-    /* If the document tree is not NULL then send in the root node of the
-       tree to be parsed and read into the ESPA metadata structure */
-    if (doc != NULL)
-    {
-        /* Store the namespace for the overall metadata file */
-        xmlNsPtr ns = xmlDocGetRootElement(doc)->nsDef;
-        count = snprintf (metadata->meta_namespace,
-            sizeof (metadata->meta_namespace), "%s", (const char *) ns->href);
-        if (count < 0 || count >= sizeof (metadata->meta_namespace))
-        {
-            sprintf (errmsg, "Overflow of metadata->meta_namespace string");
-            error_handler (true, FUNC_NAME, errmsg);
+        if (open_node_parser (cur_node, &parser) != SUCCESS)
             return (ERROR);
-        }
-
-        /* Initialize the stack to hold the elements */
-        if (init_stack (&top_of_stack, &stack))
+        switch (get_xml_name_id (&parser))
         {
-            sprintf (errmsg, "Initializing the stack.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            case XN_GLOBAL_METADATA:
+                status = parse_global_metadata (&parser, &metadata->global);
+                break;
+            case XN_BANDS:
+                status = parse_bands (&parser, metadata);
+                break;
+            default:
+                status = parse_metadata_root (&parser, metadata);
+                break;
         }
-        //print_element_names (xmlDocGetRootElement (doc));
+        xmlFreeTextReader (parser.reader);
 
-        /* Parse the XML document into our ESPA internal metadata structure */
-        if (parse_xml_into_struct (xmlDocGetRootElement(doc), metadata,
-            &top_of_stack, stack))
+        if (status != SUCCESS)
         {
-            sprintf (errmsg, "Parsing the metadata file into the internal "
-                "metadata structure.");
+            sprintf (errmsg, "Parsing element '%s'.", cur_node->name);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
-
-        /* Clean up the XML document and the stack */
-        xmlFreeDoc (doc);
-        free_stack (&stack);
     }
 
-    /* Free the reader and associated memory */
-    xmlFreeTextReader (reader);
-    xmlCleanupParser();
-    xmlMemoryDump();
+    /* Index the bands for the band lookups */
+    if (build_band_index (metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
     return (SUCCESS);
 }
-
@@ -9,6 +9,11 @@ at the USGS EROS
 LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 
 NOTES:
+  1. The add_* functions and parse_xml_into_struct parse the nodes of a
+     libxml2 document tree which the caller has read.  They are deprecated
+     and only kept for applications written against earlier versions of this
+     library; parse_metadata reads a metadata file without building a tree,
+     and is much faster.
 *****************************************************************************/
 
 #ifndef PARSE_METADATA_H
@@ -24,6 +29,29 @@ NOTES:
 #include "error_handler.h"
 #include "espa_metadata.h"
 
+int parse_metadata
+(
+    char *metafile,                 /* I: input metadata file or URL */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+);
+
+int parse_metadata_lazy
+(
+    char *metafile,                 /* I: input metadata file */
+    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
+                                          been initialized via
+                                          init_metadata_struct */
+);
+
+int load_band_details
+(
+    Espa_internal_meta_t *metadata  /* I/O: metadata structure from
+                                            parse_metadata_lazy */
+);
+
+/* Deprecated document tree functions (see note 1) */
 int add_global_metadata_proj_info_albers
 (
     xmlNode *a_node,            /* I: pointer to the element node to process */
@@ -102,16 +130,10 @@ int parse_xml_into_struct
     xmlNode *a_node,                  /* I: pointer to the current node */
     Espa_internal_meta_t *metadata,   /* I: ESPA internal metadata structure
                                             to be filled */
-    int *top_of_stack,                /* I: pointer to top of the stack */
-    char **stack                      /* I: stack to use for parsing */
-);
-
-int parse_metadata
-(
-    char *metafile,                 /* I: input metadata file or URL */
-    Espa_internal_meta_t *metadata  /* I: input metadata structure which has
-                                          been initialized via
-                                          init_metadata_struct */
+    int *top_of_stack,                /* I: pointer to top of the stack
+                                            (unused) */
+    char **stack                      /* I: stack to use for parsing
+                                            (unused) */
 );
 
 #endif
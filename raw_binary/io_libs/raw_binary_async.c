@@ -0,0 +1,858 @@
+/*****************************************************************************
+FILE: raw_binary_async.c
+
+PURPOSE: Contains functions for reading/writing blocks of raw binary files
+asynchronously, so that the reads/writes for all the bands of a block can be
+in flight at the same time instead of one blocking call per band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The io_uring backend talks to the kernel directly through the io_uring
+     system calls, so no additional library is needed.  The thread backend
+     only needs pthreads.
+  2. The requests use the file descriptor of the FILE pointer with explicit
+     offsets, bypassing the stdio buffer.  Files used for asynchronous I/O
+     shouldn't also be written via the stdio routines without an fflush.
+  3. A queue is meant to be used by a single thread; the thread backend uses
+     its threads internally only.
+*****************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "raw_binary_async.h"
+#include "espa_profile.h"
+#include "espa_io_limit.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define RB_HAVE_IO_URING
+#endif
+#endif
+#endif
+
+/* Type of the asynchronous request */
+typedef enum {
+  RB_ASYNC_READ,
+  RB_ASYNC_WRITE
+} Raw_binary_async_op_t;
+
+/* Request slot; nbytes and offset describe what still has to be transferred
+   so short transfers can be resumed */
+typedef struct {
+    Raw_binary_async_op_t op;   /* read or write */
+    int fd;                     /* file descriptor of the raw binary file */
+    struct iovec iov;           /* remaining buffer and number of bytes */
+    off_t offset;               /* file offset of the remaining bytes */
+} Raw_binary_async_req_t;
+
+struct raw_binary_async
+{
+    int queue_depth;            /* number of request slots */
+    Raw_binary_async_req_t *req;/* request slots */
+    int *free_slot;             /* stack of the free request slots */
+    int nfree;                  /* number of free request slots */
+    int ninflight;              /* number of requests not complete yet */
+    int status;                 /* SUCCESS, or ERROR if a request failed since
+                                   the last wait */
+    char errmsg[STR_SIZE];      /* message for the first failed request */
+    bool use_uring;             /* is the io_uring backend in use? */
+
+#ifdef RB_HAVE_IO_URING
+    /* io_uring backend */
+    int ring_fd;                /* file descriptor of the ring */
+    void *sq_ring;              /* mapped submission queue ring */
+    void *cq_ring;              /* mapped completion queue ring */
+    size_t sq_ring_size;        /* size of the submission ring mapping */
+    size_t cq_ring_size;        /* size of the completion ring mapping */
+    struct io_uring_sqe *sqes;  /* mapped submission queue entries */
+    size_t sqes_size;           /* size of the submission entries mapping */
+    unsigned *sq_tail;          /* submission queue tail */
+    unsigned *sq_mask;          /* submission queue index mask */
+    unsigned *sq_array;         /* submission queue index array */
+    unsigned *cq_head;          /* completion queue head */
+    unsigned *cq_tail;          /* completion queue tail */
+    unsigned *cq_mask;          /* completion queue index mask */
+    struct io_uring_cqe *cqes;  /* completion queue entries */
+#endif
+
+    /* Thread backend */
+    int nthreads;               /* number of threads started */
+    pthread_t thread[RB_ASYNC_MAX_THREADS];  /* worker threads */
+    pthread_mutex_t lock;       /* lock for the queue state */
+    pthread_cond_t work_cond;   /* signaled when a request is pending */
+    pthread_cond_t done_cond;   /* signaled when a request completes */
+    int *pending;               /* circular list of pending request slots */
+    int pending_head;           /* first pending request */
+    int npending;               /* number of pending requests */
+    bool shutdown;              /* should the threads exit? */
+};
+
+
+/******************************************************************************
+MODULE: record_async_error
+
+PURPOSE: Records the failure of a request, to be reported by the next wait.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. Only the first failure is kept.  The thread backend calls this with the
+     queue lock held.
+******************************************************************************/
+static void record_async_error
+(
+    Raw_binary_async_t *aio,        /* I/O: asynchronous I/O queue */
+    Raw_binary_async_req_t *req,    /* I: failed request */
+    int err                         /* I: errno of the failure; 0 if the end
+                                          of the file was reached */
+)
+{
+    if (aio->status == ERROR)
+        return;
+
+    aio->status = ERROR;
+    snprintf (aio->errmsg, sizeof (aio->errmsg), "%s of %ld bytes at offset "
+        "%ld failed: %s", req->op == RB_ASYNC_READ ? "Reading" : "Writing",
+        (long) req->iov.iov_len, (long) req->offset,
+        err ? strerror (err) : "unexpected end of file");
+}
+
+
+/******************************************************************************
+MODULE: complete_async_request
+
+PURPOSE: Accounts for res bytes transferred by the request.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The request is done (transferred completely or failed)
+false        Bytes remain to be transferred
+
+NOTES:
+******************************************************************************/
+static bool complete_async_request
+(
+    Raw_binary_async_t *aio,        /* I/O: asynchronous I/O queue */
+    Raw_binary_async_req_t *req,    /* I/O: request to be updated */
+    long res                        /* I: bytes transferred; -errno on
+                                          failure */
+)
+{
+    if (res < 0)
+    {
+        record_async_error (aio, req, (int) -res);
+        return (true);
+    }
+    else if (res == 0 && req->iov.iov_len > 0)
+    {
+        record_async_error (aio, req, 0);
+        return (true);
+    }
+
+    espa_profile_count_io (req->op == RB_ASYNC_READ ? ESPA_PROFILE_READ :
+        ESPA_PROFILE_WRITE, ESPA_PROFILE_ASYNC, res);
+    req->iov.iov_base = (char *) req->iov.iov_base + res;
+    req->iov.iov_len -= res;
+    req->offset += res;
+    return (req->iov.iov_len == 0);
+}
+
+
+#ifdef RB_HAVE_IO_URING
+/******************************************************************************
+MODULE: open_async_uring
+
+PURPOSE: Sets up the io_uring rings for the queue.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        io_uring isn't available
+SUCCESS      The rings were set up
+
+NOTES:
+  1. A failure isn't reported, since the thread backend is used instead.
+******************************************************************************/
+static int open_async_uring
+(
+    Raw_binary_async_t *aio         /* I/O: asynchronous I/O queue */
+)
+{
+    struct io_uring_params params;  /* ring setup parameters */
+
+    memset (&params, 0, sizeof (params));
+    aio->ring_fd = (int) syscall (__NR_io_uring_setup, aio->queue_depth,
+        &params);
+    if (aio->ring_fd < 0)
+        return (ERROR);
+
+    /* Map the submission and completion rings, which share a mapping on
+       newer kernels */
+    aio->sq_ring_size = params.sq_off.array +
+        params.sq_entries * sizeof (unsigned);
+    aio->cq_ring_size = params.cq_off.cqes +
+        params.cq_entries * sizeof (struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (aio->cq_ring_size > aio->sq_ring_size)
+            aio->sq_ring_size = aio->cq_ring_size;
+        aio->cq_ring_size = 0;
+    }
+
+    aio->sq_ring = mmap (NULL, aio->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_SQ_RING);
+    if (aio->sq_ring == MAP_FAILED)
+    {
+        close (aio->ring_fd);
+        return (ERROR);
+    }
+
+    if (aio->cq_ring_size == 0)
+        aio->cq_ring = aio->sq_ring;
+    else
+    {
+        aio->cq_ring = mmap (NULL, aio->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_CQ_RING);
+        if (aio->cq_ring == MAP_FAILED)
+        {
+            munmap (aio->sq_ring, aio->sq_ring_size);
+            close (aio->ring_fd);
+            return (ERROR);
+        }
+    }
+
+    aio->sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+    aio->sqes = mmap (NULL, aio->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_SQES);
+    if (aio->sqes == MAP_FAILED)
+    {
+        if (aio->cq_ring != aio->sq_ring)
+            munmap (aio->cq_ring, aio->cq_ring_size);
+        munmap (aio->sq_ring, aio->sq_ring_size);
+        close (aio->ring_fd);
+        return (ERROR);
+    }
+
+    aio->sq_tail = (unsigned *) ((char *) aio->sq_ring + params.sq_off.tail);
+    aio->sq_mask = (unsigned *) ((char *) aio->sq_ring +
+        params.sq_off.ring_mask);
+    aio->sq_array = (unsigned *) ((char *) aio->sq_ring + params.sq_off.array);
+    aio->cq_head = (unsigned *) ((char *) aio->cq_ring + params.cq_off.head);
+    aio->cq_tail = (unsigned *) ((char *) aio->cq_ring + params.cq_off.tail);
+    aio->cq_mask = (unsigned *) ((char *) aio->cq_ring +
+        params.cq_off.ring_mask);
+    aio->cqes = (struct io_uring_cqe *) ((char *) aio->cq_ring +
+        params.cq_off.cqes);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: queue_uring_request
+
+PURPOSE: Queues the request in the slot to the kernel.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error submitting the request
+SUCCESS      The request was submitted
+
+NOTES:
+  1. There are never more requests in flight than submission entries, so
+     an entry is always available.
+******************************************************************************/
+static int queue_uring_request
+(
+    Raw_binary_async_t *aio,        /* I/O: asynchronous I/O queue */
+    int slot                        /* I: request slot to be submitted */
+)
+{
+    Raw_binary_async_req_t *req = &aio->req[slot];  /* request */
+    struct io_uring_sqe *sqe = NULL;  /* submission entry */
+    unsigned tail;                  /* submission queue tail */
+    unsigned idx;                   /* index of the submission entry */
+    int ret;                        /* return from io_uring_enter */
+
+    tail = *aio->sq_tail;
+    idx = tail & *aio->sq_mask;
+    sqe = &aio->sqes[idx];
+    memset (sqe, 0, sizeof (*sqe));
+    sqe->opcode = (req->op == RB_ASYNC_READ) ?
+        IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = req->fd;
+    sqe->addr = (unsigned long) &req->iov;
+    sqe->len = 1;
+    sqe->off = req->offset;
+    sqe->user_data = slot;
+    aio->sq_array[idx] = idx;
+    __atomic_store_n (aio->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    do
+    {
+        ret = (int) syscall (__NR_io_uring_enter, aio->ring_fd, 1, 0, 0,
+            NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return (ret < 0 ? ERROR : SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: reap_uring_request
+
+PURPOSE: Waits for the next completion and retires or resubmits its request.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error waiting on the ring
+SUCCESS      A completion was processed
+
+NOTES:
+******************************************************************************/
+static int reap_uring_request
+(
+    Raw_binary_async_t *aio         /* I/O: asynchronous I/O queue */
+)
+{
+    struct io_uring_cqe *cqe = NULL;  /* completion entry */
+    unsigned head;                  /* completion queue head */
+    int slot;                       /* request slot of the completion */
+    long res;                       /* result of the request */
+    int ret;                        /* return from io_uring_enter */
+
+    head = *aio->cq_head;
+    while (head == __atomic_load_n (aio->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        ret = (int) syscall (__NR_io_uring_enter, aio->ring_fd, 0, 1,
+            IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR)
+            return (ERROR);
+    }
+
+    cqe = &aio->cqes[head & *aio->cq_mask];
+    slot = (int) cqe->user_data;
+    res = cqe->res;
+    __atomic_store_n (aio->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    if (complete_async_request (aio, &aio->req[slot], res))
+    {
+        aio->free_slot[aio->nfree++] = slot;
+        aio->ninflight--;
+        return (SUCCESS);
+    }
+
+    /* Resubmit the remainder of a short transfer */
+    if (queue_uring_request (aio, slot) != SUCCESS)
+    {
+        record_async_error (aio, &aio->req[slot], errno);
+        aio->free_slot[aio->nfree++] = slot;
+        aio->ninflight--;
+    }
+
+    return (SUCCESS);
+}
+#endif
+
+
+/******************************************************************************
+MODULE: async_worker
+
+PURPOSE: Thread of the thread backend; services the pending requests with
+pread/pwrite until the queue is closed.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+******************************************************************************/
+static void *async_worker
+(
+    void *arg                       /* I: asynchronous I/O queue */
+)
+{
+    Raw_binary_async_t *aio = arg;  /* asynchronous I/O queue */
+    Raw_binary_async_req_t *req = NULL;  /* current request */
+    int slot;                       /* current request slot */
+    long res;                       /* bytes transferred */
+    bool done;                      /* is the request finished? */
+
+    pthread_mutex_lock (&aio->lock);
+    while (1)
+    {
+        while (aio->npending == 0 && !aio->shutdown)
+            pthread_cond_wait (&aio->work_cond, &aio->lock);
+        if (aio->npending == 0)
+            break;
+
+        slot = aio->pending[aio->pending_head];
+        aio->pending_head = (aio->pending_head + 1) % aio->queue_depth;
+        aio->npending--;
+        req = &aio->req[slot];
+        pthread_mutex_unlock (&aio->lock);
+
+        /* Transfer the request, resuming after short transfers */
+        do
+        {
+            if (req->op == RB_ASYNC_READ)
+                res = pread (req->fd, req->iov.iov_base, req->iov.iov_len,
+                    req->offset);
+            else
+                res = pwrite (req->fd, req->iov.iov_base, req->iov.iov_len,
+                    req->offset);
+            if (res < 0 && errno == EINTR)
+            {
+                done = false;
+                continue;
+            }
+
+            pthread_mutex_lock (&aio->lock);
+            done = complete_async_request (aio, req, res < 0 ? -errno : res);
+            if (!done)
+                pthread_mutex_unlock (&aio->lock);
+        } while (!done);
+
+        /* Retire the request; the lock is held */
+        aio->free_slot[aio->nfree++] = slot;
+        aio->ninflight--;
+        pthread_cond_broadcast (&aio->done_cond);
+    }
+    pthread_mutex_unlock (&aio->lock);
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE: open_async_threads
+
+PURPOSE: Starts the threads of the thread backend.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error starting the threads
+SUCCESS      The threads were started
+
+NOTES:
+******************************************************************************/
+static int open_async_threads
+(
+    Raw_binary_async_t *aio         /* I/O: asynchronous I/O queue */
+)
+{
+    int nthreads;                   /* number of threads to start */
+
+    aio->pending = calloc (aio->queue_depth, sizeof (int));
+    if (aio->pending == NULL)
+        return (ERROR);
+
+    nthreads = aio->queue_depth;
+    if (nthreads > RB_ASYNC_MAX_THREADS)
+        nthreads = RB_ASYNC_MAX_THREADS;
+
+    for (aio->nthreads = 0; aio->nthreads < nthreads; aio->nthreads++)
+    {
+        if (pthread_create (&aio->thread[aio->nthreads], NULL, async_worker,
+            aio) != 0)
+            break;
+    }
+
+    return (aio->nthreads > 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_async
+
+PURPOSE: Opens an asynchronous I/O queue which allows up to queue_depth
+requests to be in flight at once.
+
+RETURN VALUE:
+Type = Raw_binary_async_t *
+Value        Description
+-----        -----------
+NULL         Error opening the queue
+non-NULL     Pointer to the opened queue
+
+NOTES:
+  1. The io_uring backend is used if it's available, otherwise the thread
+     backend.  Setting ESPA_ASYNC_IO to "threads" forces the thread backend.
+******************************************************************************/
+Raw_binary_async_t *open_raw_binary_async
+(
+    int queue_depth      /* I: maximum number of requests in flight */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_async";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    char *backend = getenv ("ESPA_ASYNC_IO");  /* requested backend */
+    Raw_binary_async_t *aio = NULL; /* asynchronous I/O queue */
+    int i;                          /* looping variable */
+
+    if (queue_depth < 1)
+        queue_depth = RB_ASYNC_QUEUE_DEPTH;
+
+    aio = calloc (1, sizeof (Raw_binary_async_t));
+    if (aio != NULL)
+    {
+        aio->req = calloc (queue_depth, sizeof (Raw_binary_async_req_t));
+        aio->free_slot = calloc (queue_depth, sizeof (int));
+    }
+    if (aio == NULL || aio->req == NULL || aio->free_slot == NULL)
+    {
+        if (aio != NULL)
+        {
+            free (aio->req);
+            free (aio->free_slot);
+            free (aio);
+        }
+        sprintf (errmsg, "Allocating the asynchronous I/O queue for %d "
+            "requests", queue_depth);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    aio->queue_depth = queue_depth;
+    for (i = 0; i < queue_depth; i++)
+        aio->free_slot[i] = queue_depth - 1 - i;
+    aio->nfree = queue_depth;
+    aio->status = SUCCESS;
+
+#ifdef RB_HAVE_IO_URING
+    if (backend == NULL || strcmp (backend, "threads"))
+        aio->use_uring = (open_async_uring (aio) == SUCCESS);
+#else
+    (void) backend;
+#endif
+
+    if (!aio->use_uring)
+    {
+        pthread_mutex_init (&aio->lock, NULL);
+        pthread_cond_init (&aio->work_cond, NULL);
+        pthread_cond_init (&aio->done_cond, NULL);
+        if (open_async_threads (aio) != SUCCESS)
+        {
+            close_raw_binary_async (aio);
+            sprintf (errmsg, "Starting the asynchronous I/O threads");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    return (aio);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_async_backend
+
+PURPOSE: Returns the name of the backend used by the queue.
+
+RETURN VALUE:
+Type = const char *
+Value        Description
+-----        -----------
+"io_uring"   The kernel io_uring interface is used
+"threads"    The thread backend is used
+
+NOTES:
+******************************************************************************/
+const char *get_raw_binary_async_backend
+(
+    Raw_binary_async_t *aio   /* I: asynchronous I/O queue */
+)
+{
+    return (aio->use_uring ? "io_uring" : "threads");
+}
+
+
+/******************************************************************************
+MODULE: submit_raw_binary_request
+
+PURPOSE: Submits a read or write request to the queue, first waiting for a
+request to complete if the queue is full.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error submitting the request
+SUCCESS      The request was submitted
+
+NOTES:
+******************************************************************************/
+static int submit_raw_binary_request
+(
+    Raw_binary_async_t *aio,  /* I/O: asynchronous I/O queue */
+    Raw_binary_async_op_t op, /* I: read or write */
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    long offset,        /* I: byte offset in the file */
+    size_t nbytes,      /* I: number of bytes to transfer */
+    void *buf           /* I/O: buffer for the transfer */
+)
+{
+    char FUNC_NAME[] = "submit_raw_binary_request";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    Raw_binary_async_req_t *req = NULL;  /* request */
+    int slot;                       /* request slot */
+
+    /* Keep the job to its I/O rate before the request is in flight */
+    espa_io_throttle (op == RB_ASYNC_READ ? ESPA_IO_READ : ESPA_IO_WRITE,
+        nbytes);
+
+#ifdef RB_HAVE_IO_URING
+    if (aio->use_uring)
+    {
+        /* Make room by retiring a completed request */
+        while (aio->nfree == 0)
+        {
+            if (reap_uring_request (aio) != SUCCESS)
+            {
+                sprintf (errmsg, "Waiting for asynchronous I/O: %s",
+                    strerror (errno));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        slot = aio->free_slot[--aio->nfree];
+        req = &aio->req[slot];
+        req->op = op;
+        req->fd = fileno (rb_fptr);
+        req->iov.iov_base = buf;
+        req->iov.iov_len = nbytes;
+        req->offset = offset;
+        aio->ninflight++;
+
+        if (queue_uring_request (aio, slot) != SUCCESS)
+        {
+            aio->free_slot[aio->nfree++] = slot;
+            aio->ninflight--;
+            sprintf (errmsg, "Submitting asynchronous I/O: %s",
+                strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+#endif
+
+    pthread_mutex_lock (&aio->lock);
+    while (aio->nfree == 0)
+        pthread_cond_wait (&aio->done_cond, &aio->lock);
+
+    slot = aio->free_slot[--aio->nfree];
+    req = &aio->req[slot];
+    req->op = op;
+    req->fd = fileno (rb_fptr);
+    req->iov.iov_base = buf;
+    req->iov.iov_len = nbytes;
+    req->offset = offset;
+    aio->ninflight++;
+
+    aio->pending[(aio->pending_head + aio->npending) % aio->queue_depth] =
+        slot;
+    aio->npending++;
+    pthread_cond_signal (&aio->work_cond);
+    pthread_mutex_unlock (&aio->lock);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: submit_raw_binary_read
+
+PURPOSE: Submits a read of nbytes at offset of the raw binary file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error submitting the read
+SUCCESS      The read was submitted
+
+NOTES:
+  1. Failures of the read itself are reported by wait_raw_binary_async.
+******************************************************************************/
+int submit_raw_binary_read
+(
+    Raw_binary_async_t *aio,  /* I/O: asynchronous I/O queue */
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    long offset,        /* I: byte offset in the file to read from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer to read into; must not be touched until
+                              wait_raw_binary_async returns */
+)
+{
+    return (submit_raw_binary_request (aio, RB_ASYNC_READ, rb_fptr, offset,
+        nbytes, buf));
+}
+
+
+/******************************************************************************
+MODULE: submit_raw_binary_write
+
+PURPOSE: Submits a write of nbytes at offset of the raw binary file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error submitting the write
+SUCCESS      The write was submitted
+
+NOTES:
+  1. Failures of the write itself are reported by wait_raw_binary_async.
+******************************************************************************/
+int submit_raw_binary_write
+(
+    Raw_binary_async_t *aio,  /* I/O: asynchronous I/O queue */
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    long offset,        /* I: byte offset in the file to write to */
+    size_t nbytes,      /* I: number of bytes to write */
+    void *buf           /* I: buffer to write from; must not be modified
+                              until wait_raw_binary_async returns */
+)
+{
+    return (submit_raw_binary_request (aio, RB_ASYNC_WRITE, rb_fptr, offset,
+        nbytes, buf));
+}
+
+
+/******************************************************************************
+MODULE: wait_raw_binary_async
+
+PURPOSE: Waits for all the submitted requests to complete.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        One or more of the requests failed
+SUCCESS      All the requests completed successfully
+
+NOTES:
+  1. The first failure since the previous wait is reported.
+******************************************************************************/
+int wait_raw_binary_async
+(
+    Raw_binary_async_t *aio   /* I/O: asynchronous I/O queue */
+)
+{
+    char FUNC_NAME[] = "wait_raw_binary_async";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    int status;                     /* status of the requests */
+
+#ifdef RB_HAVE_IO_URING
+    if (aio->use_uring)
+    {
+        while (aio->ninflight > 0)
+        {
+            if (reap_uring_request (aio) != SUCCESS)
+            {
+                sprintf (errmsg, "Waiting for asynchronous I/O: %s",
+                    strerror (errno));
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+    else
+#endif
+    {
+        pthread_mutex_lock (&aio->lock);
+        while (aio->ninflight > 0)
+            pthread_cond_wait (&aio->done_cond, &aio->lock);
+        pthread_mutex_unlock (&aio->lock);
+    }
+
+    status = aio->status;
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s", aio->errmsg);
+        error_handler (true, FUNC_NAME, errmsg);
+        aio->status = SUCCESS;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_async
+
+PURPOSE: Waits for the outstanding requests and closes the queue.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. Call wait_raw_binary_async first if the status of the outstanding
+     requests matters.
+******************************************************************************/
+void close_raw_binary_async
+(
+    Raw_binary_async_t *aio   /* I: asynchronous I/O queue to be closed */
+)
+{
+    int i;                          /* looping variable */
+
+    if (aio == NULL)
+        return;
+
+#ifdef RB_HAVE_IO_URING
+    if (aio->use_uring)
+    {
+        while (aio->ninflight > 0 && reap_uring_request (aio) == SUCCESS)
+            ;
+        munmap (aio->sqes, aio->sqes_size);
+        if (aio->cq_ring != aio->sq_ring)
+            munmap (aio->cq_ring, aio->cq_ring_size);
+        munmap (aio->sq_ring, aio->sq_ring_size);
+        close (aio->ring_fd);
+    }
+    else
+#endif
+    {
+        /* The threads finish the pending requests before exiting */
+        pthread_mutex_lock (&aio->lock);
+        aio->shutdown = true;
+        pthread_cond_broadcast (&aio->work_cond);
+        pthread_mutex_unlock (&aio->lock);
+        for (i = 0; i < aio->nthreads; i++)
+            pthread_join (aio->thread[i], NULL);
+
+        pthread_mutex_destroy (&aio->lock);
+        pthread_cond_destroy (&aio->work_cond);
+        pthread_cond_destroy (&aio->done_cond);
+        free (aio->pending);
+    }
+
+    free (aio->req);
+    free (aio->free_slot);
+    free (aio);
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+FILE: raw_binary_async.h
+
+PURPOSE: Contains defines and prototypes for the asynchronous reading/writing
+of blocks of raw binary files, allowing several requests to be in flight at
+once.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. On Linux the requests are queued to the kernel via io_uring.  If io_uring
+     isn't available (older kernels, or blocked by the container) or the
+     ESPA_ASYNC_IO environment variable is set to "threads", the requests are
+     serviced by a pool of threads doing pread/pwrite.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_ASYNC_H
+#define RAW_BINARY_ASYNC_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Default number of requests which can be in flight at once */
+#define RB_ASYNC_QUEUE_DEPTH 32
+
+/* Maximum number of threads used by the thread backend */
+#define RB_ASYNC_MAX_THREADS 8
+
+/* Asynchronous I/O queue; the contents depend on the backend in use */
+typedef struct raw_binary_async Raw_binary_async_t;
+
+/* Prototypes */
+Raw_binary_async_t *open_raw_binary_async
+(
+    int queue_depth      /* I: maximum number of requests in flight */
+);
+
+const char *get_raw_binary_async_backend
+(
+    Raw_binary_async_t *aio   /* I: asynchronous I/O queue */
+);
+
+int submit_raw_binary_read
+(
+    Raw_binary_async_t *aio,  /* I/O: asynchronous I/O queue */
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    long offset,        /* I: byte offset in the file to read from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer to read into; must not be touched until
+                              wait_raw_binary_async returns */
+);
+
+int submit_raw_binary_write
+(
+    Raw_binary_async_t *aio,  /* I/O: asynchronous I/O queue */
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    long offset,        /* I: byte offset in the file to write to */
+    size_t nbytes,      /* I: number of bytes to write */
+    void *buf           /* I: buffer to write from; must not be modified
+                              until wait_raw_binary_async returns */
+);
+
+int wait_raw_binary_async
+(
+    Raw_binary_async_t *aio   /* I/O: asynchronous I/O queue */
+);
+
+void close_raw_binary_async
+(
+    Raw_binary_async_t *aio   /* I: asynchronous I/O queue to be closed */
+);
+
+#endif
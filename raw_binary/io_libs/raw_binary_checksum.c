@@ -0,0 +1,370 @@
+/*****************************************************************************
+FILE: raw_binary_checksum.c
+  
+PURPOSE: Contains functions for computing and verifying the CRC32C checksums
+of raw binary band files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The CRC32C is computed with the SSE4.2 crc32 instruction on 64-bit x86
+     processors which support it, and with a slice-by-8 table otherwise.  The
+     instruction set is chosen at runtime, the first time the CRC32C is
+     computed.
+  2. The ESPA_CHECKSUM_ISA environment variable can be set to "scalar" to
+     force the table-driven kernel (used for verifying the SSE4.2 kernel).
+*****************************************************************************/
+
+#if defined(__x86_64__)
+#define CHECKSUM_HAVE_SSE42
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "raw_binary_checksum.h"
+#include "raw_binary_shm.h"
+
+/* Reflected CRC32C (Castagnoli) polynomial */
+#define CRC32C_POLY 0x82f63b78
+
+/* Instruction set used by the kernel; chosen on first use */
+static int checksum_isa = -1;
+
+/* Slice-by-8 tables for the scalar kernel */
+static uint32_t crc32c_table[8][256];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+
+
+/******************************************************************************
+MODULE: use_raw_binary_checksum
+
+PURPOSE: Determines if the band checksums were requested via the
+ESPA_BAND_CHECKSUM environment variable.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_BAND_CHECKSUM is "crc32c"
+false        ESPA_BAND_CHECKSUM isn't set, or is anything else
+
+NOTES:
+*****************************************************************************/
+bool use_raw_binary_checksum ()
+{
+    char *checksum = getenv ("ESPA_BAND_CHECKSUM");  /* requested checksum */
+
+    return (checksum != NULL && !strcmp (checksum, ESPA_CHECKSUM_TYPE));
+}
+
+
+/******************************************************************************
+MODULE:  get_raw_binary_checksum_isa
+
+PURPOSE: Determines the instruction set to be used for the CRC32C kernel.
+
+RETURN VALUE:
+Type = Raw_binary_checksum_isa_t
+Value                Description
+-----                -----------
+RB_CHECKSUM_SCALAR   Table-driven kernel is used
+RB_CHECKSUM_SSE42    SSE4.2 kernel is used
+
+NOTES:
+  1. If this is first called from multiple threads at once, each thread
+     determines and stores the same value.
+******************************************************************************/
+Raw_binary_checksum_isa_t get_raw_binary_checksum_isa ()
+{
+    char *isa_env = NULL;     /* value of the ESPA_CHECKSUM_ISA variable */
+    int isa = RB_CHECKSUM_SCALAR;  /* instruction set to be used */
+
+    if (checksum_isa != -1)
+        return ((Raw_binary_checksum_isa_t) checksum_isa);
+
+    isa_env = getenv ("ESPA_CHECKSUM_ISA");
+    if (isa_env == NULL || strcmp (isa_env, "scalar"))
+    {
+#if defined(CHECKSUM_HAVE_SSE42)
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("sse4.2"))
+            isa = RB_CHECKSUM_SSE42;
+#endif
+    }
+
+    checksum_isa = isa;
+    return ((Raw_binary_checksum_isa_t) isa);
+}
+
+
+/******************************************************************************
+Scalar kernel.  The tables are built once; table k holds the CRC of a byte
+followed by k zero bytes.
+******************************************************************************/
+static void init_crc32c_table ()
+{
+    uint32_t crc;             /* CRC of the current byte */
+    int i, j, k;              /* looping variables */
+
+    for (i = 0; i < 256; i++)
+    {
+        crc = i;
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+        crc32c_table[0][i] = crc;
+    }
+
+    for (k = 1; k < 8; k++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            crc = crc32c_table[k-1][i];
+            crc32c_table[k][i] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+        }
+    }
+}
+
+static uint32_t crc32c_scalar
+(
+    uint32_t crc, const uint8_t *p, size_t nbytes
+)
+{
+    uint32_t lo, hi;          /* low and high words of the current 8 bytes */
+
+    pthread_once (&crc32c_table_once, init_crc32c_table);
+
+    while (nbytes >= 8)
+    {
+        lo = crc ^ ((uint32_t) p[0] | (uint32_t) p[1] << 8 |
+            (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+        hi = (uint32_t) p[4] | (uint32_t) p[5] << 8 |
+            (uint32_t) p[6] << 16 | (uint32_t) p[7] << 24;
+        crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+            crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+            crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+            crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+        p += 8;
+        nbytes -= 8;
+    }
+
+    while (nbytes-- > 0)
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xff];
+
+    return (crc);
+}
+
+
+/******************************************************************************
+SSE4.2 kernel.
+******************************************************************************/
+#if defined(CHECKSUM_HAVE_SSE42)
+__attribute__ ((target ("sse4.2")))
+static uint32_t crc32c_sse42
+(
+    uint32_t crc, const uint8_t *p, size_t nbytes
+)
+{
+    uint64_t crc64;           /* CRC of the 8-byte words */
+    uint64_t word;            /* current 8 bytes */
+
+    /* Align to 8 bytes for the word loop */
+    while (nbytes > 0 && ((uintptr_t) p & 7) != 0)
+    {
+        crc = _mm_crc32_u8 (crc, *p++);
+        nbytes--;
+    }
+
+    crc64 = crc;
+    while (nbytes >= 8)
+    {
+        memcpy (&word, p, sizeof (word));
+        crc64 = _mm_crc32_u64 (crc64, word);
+        p += 8;
+        nbytes -= 8;
+    }
+    crc = (uint32_t) crc64;
+
+    while (nbytes-- > 0)
+        crc = _mm_crc32_u8 (crc, *p++);
+
+    return (crc);
+}
+#endif
+
+
+/******************************************************************************
+MODULE: update_raw_binary_crc32c
+
+PURPOSE: Adds a block of bytes to a running CRC32C.
+ 
+RETURN VALUE:
+Type = uint32_t
+Value        Description
+-----        -----------
+crc          CRC32C of the preceding bytes and buf
+
+NOTES:
+  1. As with the zlib crc32, the running value is the final CRC of the bytes
+     so far, so the blocks can be any size.
+*****************************************************************************/
+uint32_t update_raw_binary_crc32c
+(
+    uint32_t crc,          /* I: CRC32C of the preceding bytes; 0 to start */
+    const void *buf,       /* I: bytes to be added to the CRC32C */
+    size_t nbytes          /* I: number of bytes in buf */
+)
+{
+    crc = ~crc;
+#if defined(CHECKSUM_HAVE_SSE42)
+    if (get_raw_binary_checksum_isa () == RB_CHECKSUM_SSE42)
+        return (~crc32c_sse42 (crc, buf, nbytes));
+#endif
+    return (~crc32c_scalar (crc, buf, nbytes));
+}
+
+
+/******************************************************************************
+MODULE: format_raw_binary_checksum
+
+PURPOSE: Stores a CRC32C in the band metadata.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+*****************************************************************************/
+void format_raw_binary_checksum
+(
+    uint32_t crc,          /* I: CRC32C of a band file */
+    Espa_band_meta_t *bmeta  /* O: band metadata; checksum is set */
+)
+{
+    snprintf (bmeta->checksum, sizeof (bmeta->checksum), "%08x",
+        (unsigned int) crc);
+}
+
+
+/******************************************************************************
+MODULE: compute_raw_binary_crc32c
+
+PURPOSE: Computes the CRC32C of an existing raw binary file.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the file
+SUCCESS      Computing the CRC32C was successful
+
+NOTES:
+*****************************************************************************/
+int compute_raw_binary_crc32c
+(
+    char *file_name,       /* I: name of the raw binary file */
+    uint32_t *crc          /* O: CRC32C of the file */
+)
+{
+    char FUNC_NAME[] = "compute_raw_binary_crc32c"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* pointer to the raw binary file */
+    char *buf = NULL;        /* block of the file */
+    size_t nread;            /* number of bytes read */
+    int status = SUCCESS;    /* return status */
+    int fd;                  /* file descriptor of a shared memory band */
+
+    /* A band kept in shared memory is read from its segment */
+    fd = open_raw_binary_shm (file_name, O_RDONLY);
+    if (fd >= 0)
+    {
+        fptr = fdopen (fd, "rb");
+        if (fptr == NULL)
+            close (fd);
+    }
+    else
+        fptr = fopen (file_name, "rb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening raw binary file %s for the checksum.",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    buf = malloc (RB_CHECKSUM_BLOCK_SIZE);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the checksum buffer for %s.", file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (fptr);
+        return (ERROR);
+    }
+
+    *crc = 0;
+    while ((nread = fread (buf, 1, RB_CHECKSUM_BLOCK_SIZE, fptr)) > 0)
+        *crc = update_raw_binary_crc32c (*crc, buf, nread);
+    if (ferror (fptr))
+    {
+        sprintf (errmsg, "Reading raw binary file %s for the checksum.",
+            file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    free (buf);
+    fclose (fptr);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: verify_raw_binary_checksum
+
+PURPOSE: Verifies the band file against the checksum in the band metadata.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The band has no checksum, the file couldn't be read, or the
+             file doesn't match the checksum
+SUCCESS      The file matches the checksum
+
+NOTES:
+*****************************************************************************/
+int verify_raw_binary_checksum
+(
+    Espa_band_meta_t *bmeta  /* I: metadata of the band to be verified */
+)
+{
+    char FUNC_NAME[] = "verify_raw_binary_checksum"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint32_t crc;            /* CRC32C of the band file */
+    unsigned long expected;  /* CRC32C in the band metadata */
+    char *end = NULL;        /* end of the checksum in the metadata */
+
+    expected = strtoul (bmeta->checksum, &end, 16);
+    if (bmeta->checksum[0] == '\0' || *end != '\0')
+    {
+        sprintf (errmsg, "Band %s doesn't have a valid checksum.",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (compute_raw_binary_crc32c (bmeta->file_name, &crc) != SUCCESS)
+        return (ERROR);
+
+    if (crc != expected)
+    {
+        sprintf (errmsg, "Band file %s has checksum %08x, but the metadata "
+            "has %s.", bmeta->file_name, (unsigned int) crc, bmeta->checksum);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
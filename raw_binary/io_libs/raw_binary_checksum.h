@@ -0,0 +1,67 @@
+/*****************************************************************************
+FILE: raw_binary_checksum.h
+  
+PURPOSE: Contains defines and prototypes for the CRC32C checksums of raw
+binary band files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The checksum is the CRC32C (Castagnoli) of the bytes of the band file,
+     stored in the band metadata as 8 hexadecimal digits.  It's computed
+     while the band is written, so verifying the product doesn't need the
+     band to be read again at production time.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_CHECKSUM_H
+#define RAW_BINARY_CHECKSUM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Size of the blocks read when computing the checksum of a file */
+#define RB_CHECKSUM_BLOCK_SIZE (8 * 1024 * 1024)
+
+/* Instruction sets for the CRC32C kernel */
+typedef enum {
+    RB_CHECKSUM_SCALAR,  /* table-driven kernel */
+    RB_CHECKSUM_SSE42    /* SSE4.2 crc32 instruction */
+} Raw_binary_checksum_isa_t;
+
+/* Prototypes */
+bool use_raw_binary_checksum ();
+
+Raw_binary_checksum_isa_t get_raw_binary_checksum_isa ();
+
+uint32_t update_raw_binary_crc32c
+(
+    uint32_t crc,          /* I: CRC32C of the preceding bytes; 0 to start */
+    const void *buf,       /* I: bytes to be added to the CRC32C */
+    size_t nbytes          /* I: number of bytes in buf */
+);
+
+void format_raw_binary_checksum
+(
+    uint32_t crc,          /* I: CRC32C of a band file */
+    Espa_band_meta_t *bmeta  /* O: band metadata; checksum is set */
+);
+
+int compute_raw_binary_crc32c
+(
+    char *file_name,       /* I: name of the raw binary file */
+    uint32_t *crc          /* O: CRC32C of the file */
+);
+
+int verify_raw_binary_checksum
+(
+    Espa_band_meta_t *bmeta  /* I: metadata of the band to be verified */
+);
+
+#endif
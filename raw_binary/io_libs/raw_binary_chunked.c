@@ -0,0 +1,1372 @@
+/*****************************************************************************
+FILE: raw_binary_chunked.c
+  
+PURPOSE: Contains functions for compressing the chunks of a chunked raw binary
+band, and for reading chunked bands with random access and transparent
+decompression.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_chunked.h for the layout of a chunked band.  The header,
+     index, and trailer are written in the native byte order, the same as the
+     raw binary band data.
+  2. The chunks are written by the raw binary writer (see
+     open_raw_binary_writer) when a codec other than RB_CODEC_NONE is
+     requested.
+  3. Chunks are compressed and decoded in parallel by the task runtime (see
+     espa_task.h) when threading is enabled.
+  4. An rle chunk is a sequence of runs, each the run length as an unsigned
+     LEB128 number (7 bits per byte, low bits first, high bit set on all but
+     the last byte) followed by the repeated byte.
+  5. A delta chunk is, for each line, the blocks of RB_DELTA_BLOCK residuals
+     (the last block of a line may be shorter), each a byte with the bit
+     width followed by the residuals packed at that width, low bits first.
+     The lines are decoded with SSE2 on x86 processors, where the prefix sum
+     along the line is done 8 samples at a time.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#if defined(__SSE2__)
+#define CHUNKED_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#include "raw_binary_chunked.h"
+#include "raw_binary_shm.h"
+#include "espa_profile.h"
+#include "espa_io_limit.h"
+#include "espa_task.h"
+
+/* Chunked band opened for reading */
+struct raw_binary_chunked
+{
+    char file_name[STR_SIZE];   /* name of the chunked band */
+    int fd;                     /* file descriptor of the band */
+    Raw_binary_codec_t codec;   /* compression of the chunks */
+    Raw_binary_chunked_trailer_t trailer;  /* band size and chunking */
+    uint64_t *index;            /* file offset of each chunk, followed by the
+                                   offset of the index */
+    size_t chunk_bytes;         /* uncompressed size of a full chunk */
+    off_t size;                 /* uncompressed size of the band */
+    long cached;                /* chunk held in cache, or -1 */
+    char *cache;                /* last decoded chunk, for reads which don't
+                                   cover whole chunks */
+    off_t pos;                  /* current position of the stream */
+};
+
+/******************************************************************************
+MODULE: get_raw_binary_codec
+
+PURPOSE: Returns the compression requested for the bands written by the tools
+via the ESPA_BAND_CODEC environment variable.
+ 
+RETURN VALUE:
+Type = Raw_binary_codec_t
+Value              Description
+-----              -----------
+RB_CODEC_NONE      ESPA_BAND_CODEC isn't set, or is "none"
+RB_CODEC_DEFLATE   ESPA_BAND_CODEC is "deflate"
+RB_CODEC_BITPACK   ESPA_BAND_CODEC is "bitpack"
+RB_CODEC_RLE       ESPA_BAND_CODEC is "rle"
+RB_CODEC_DELTA     ESPA_BAND_CODEC is "delta"
+
+NOTES:
+*****************************************************************************/
+Raw_binary_codec_t get_raw_binary_codec ()
+{
+    char *codec = getenv ("ESPA_BAND_CODEC");  /* requested codec */
+
+    if (codec != NULL && !strcmp (codec, "deflate"))
+        return (RB_CODEC_DEFLATE);
+    if (codec != NULL && !strcmp (codec, "bitpack"))
+        return (RB_CODEC_BITPACK);
+    if (codec != NULL && !strcmp (codec, "rle"))
+        return (RB_CODEC_RLE);
+    if (codec != NULL && !strcmp (codec, "delta"))
+        return (RB_CODEC_DELTA);
+
+    return (RB_CODEC_NONE);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_mask_codec
+
+PURPOSE: Returns the compression requested for the binary mask bands written
+by the tools via the ESPA_MASK_CODEC environment variable.
+ 
+RETURN VALUE:
+Type = Raw_binary_codec_t
+Value              Description
+-----              -----------
+RB_CODEC_NONE      ESPA_MASK_CODEC is "none"
+RB_CODEC_DEFLATE   ESPA_MASK_CODEC is "deflate"
+RB_CODEC_BITPACK   ESPA_MASK_CODEC is "bitpack"
+RB_CODEC_RLE       ESPA_MASK_CODEC is "rle"
+RB_CODEC_DELTA     ESPA_MASK_CODEC is "delta"
+other              ESPA_MASK_CODEC isn't set, so the codec of the other
+                   bands is used (see get_raw_binary_codec)
+
+NOTES:
+*****************************************************************************/
+Raw_binary_codec_t get_raw_binary_mask_codec ()
+{
+    char *codec = getenv ("ESPA_MASK_CODEC");  /* requested codec */
+
+    if (codec == NULL)
+        return (get_raw_binary_codec ());
+
+    if (!strcmp (codec, "deflate"))
+        return (RB_CODEC_DEFLATE);
+    if (!strcmp (codec, "bitpack"))
+        return (RB_CODEC_BITPACK);
+    if (!strcmp (codec, "rle"))
+        return (RB_CODEC_RLE);
+    if (!strcmp (codec, "delta"))
+        return (RB_CODEC_DELTA);
+
+    return (RB_CODEC_NONE);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_angle_codec
+
+PURPOSE: Returns the compression requested for the per-pixel angle bands
+written by the tools via the ESPA_ANGLE_CODEC environment variable.
+ 
+RETURN VALUE:
+Type = Raw_binary_codec_t
+Value              Description
+-----              -----------
+RB_CODEC_NONE      ESPA_ANGLE_CODEC is "none", or it isn't set and the other
+                   bands aren't compressed
+RB_CODEC_DEFLATE   ESPA_ANGLE_CODEC is "deflate"
+RB_CODEC_BITPACK   ESPA_ANGLE_CODEC is "bitpack"
+RB_CODEC_RLE       ESPA_ANGLE_CODEC is "rle"
+RB_CODEC_DELTA     ESPA_ANGLE_CODEC is "delta", or it isn't set and the other
+                   bands are compressed
+
+NOTES:
+  1. The angle bands vary smoothly across the scene, so when the other bands
+     are compressed the delta codec is used for them by default; it stores
+     them several times smaller than deflate.
+*****************************************************************************/
+Raw_binary_codec_t get_raw_binary_angle_codec ()
+{
+    char *codec = getenv ("ESPA_ANGLE_CODEC");  /* requested codec */
+
+    if (codec == NULL)
+    {
+        if (get_raw_binary_codec () == RB_CODEC_NONE)
+            return (RB_CODEC_NONE);
+        return (RB_CODEC_DELTA);
+    }
+
+    if (!strcmp (codec, "deflate"))
+        return (RB_CODEC_DEFLATE);
+    if (!strcmp (codec, "bitpack"))
+        return (RB_CODEC_BITPACK);
+    if (!strcmp (codec, "rle"))
+        return (RB_CODEC_RLE);
+    if (!strcmp (codec, "delta"))
+        return (RB_CODEC_DELTA);
+
+    return (RB_CODEC_NONE);
+}
+
+
+/******************************************************************************
+MODULE: pread_chunked
+
+PURPOSE: Reads nbytes at the specified offset of the file, continuing after
+short reads and interrupts.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred or the end of the file was reached
+SUCCESS      Reading was successful
+
+NOTES:
+*****************************************************************************/
+static int pread_chunked
+(
+    int fd,             /* I: file descriptor of the chunked band */
+    void *buf,          /* O: buffer of nbytes */
+    size_t nbytes,      /* I: number of bytes to read */
+    off_t offset        /* I: byte offset in the file to read from */
+)
+{
+    ssize_t nread;           /* number of bytes read by the current call */
+
+    espa_io_throttle (ESPA_IO_READ, nbytes);
+    while (nbytes > 0)
+    {
+        nread = pread (fd, buf, nbytes, offset);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return (ERROR);
+        espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_POSIX, nread);
+
+        buf = (char *) buf + nread;
+        nbytes -= nread;
+        offset += nread;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_chunked
+
+PURPOSE: Determines if the open raw binary file is a chunked band.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file starts with the chunked band signature
+false        The file is a plain raw binary band (or can't be read)
+
+NOTES:
+  1. The file is read with pread, so the file position isn't changed.
+*****************************************************************************/
+bool is_raw_binary_chunked
+(
+    int fd              /* I: file descriptor of the raw binary file */
+)
+{
+    char magic[8];           /* signature at the start of the file */
+
+    if (pread_chunked (fd, magic, sizeof (magic), 0) != SUCCESS)
+        return (false);
+
+    return (memcmp (magic, RB_CHUNKED_MAGIC, sizeof (magic)) == 0);
+}
+
+
+/******************************************************************************
+MODULE: bitpack_chunk
+
+PURPOSE: Packs a chunk whose bytes are all 0 or 1 to one bit per byte.
+ 
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The chunk has a byte other than 0 or 1
+n            Number of bytes in the packed chunk, (raw_len + 7) / 8
+
+NOTES:
+  1. dst must hold (raw_len + 7) / 8 bytes.
+*****************************************************************************/
+static size_t bitpack_chunk
+(
+    const unsigned char *raw,   /* I: uncompressed chunk */
+    size_t raw_len,     /* I: number of bytes in the chunk */
+    unsigned char *dst  /* O: packed chunk */
+)
+{
+    size_t i;                /* looping variable for the bytes */
+    unsigned char bits = 0;  /* packed bits of the current byte */
+    unsigned char any = 0;   /* all the chunk bytes or'd together */
+
+    for (i = 0; i < raw_len; i++)
+    {
+        any |= raw[i];
+        bits = (bits << 1) | (raw[i] & 1);
+        if (i % 8 == 7)
+        {
+            dst[i / 8] = bits;
+            bits = 0;
+        }
+    }
+    if (raw_len % 8)
+        dst[raw_len / 8] = bits << (8 - raw_len % 8);
+
+    if (any > 1)
+        return (0);
+
+    return ((raw_len + 7) / 8);
+}
+
+
+/******************************************************************************
+MODULE: rle_chunk
+
+PURPOSE: Run-length encodes a chunk.
+ 
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The encoded chunk wouldn't be smaller than the chunk
+n            Number of bytes in the encoded chunk
+
+NOTES:
+  1. dst must hold raw_len bytes.
+*****************************************************************************/
+static size_t rle_chunk
+(
+    const unsigned char *raw,   /* I: uncompressed chunk */
+    size_t raw_len,     /* I: number of bytes in the chunk */
+    unsigned char *dst  /* O: encoded chunk */
+)
+{
+    size_t i = 0;            /* start of the current run */
+    size_t run;              /* length of the current run */
+    size_t count;            /* part of the run length left to encode */
+    size_t len = 0;          /* number of bytes encoded */
+
+    while (i < raw_len)
+    {
+        for (run = 1; i + run < raw_len && raw[i + run] == raw[i]; run++)
+            ;
+
+        /* The run length, 7 bits at a time, then the byte; a run takes at
+           most 11 bytes */
+        if (len + 11 > raw_len)
+            return (0);
+        for (count = run; count >= 0x80; count >>= 7)
+            dst[len++] = (count & 0x7f) | 0x80;
+        dst[len++] = count;
+        dst[len++] = raw[i];
+
+        i += run;
+    }
+
+    if (len >= raw_len)
+        return (0);
+
+    return (len);
+}
+
+
+/******************************************************************************
+MODULE: unrle_chunk
+
+PURPOSE: Decodes a run-length encoded chunk.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The encoded chunk is corrupt or doesn't decode to raw_len bytes
+SUCCESS      Decoding was successful
+
+NOTES:
+*****************************************************************************/
+static int unrle_chunk
+(
+    const unsigned char *comp,  /* I: encoded chunk */
+    size_t comp_len,    /* I: number of bytes in the encoded chunk */
+    unsigned char *raw, /* O: decoded chunk */
+    size_t raw_len      /* I: number of bytes in the decoded chunk */
+)
+{
+    size_t i = 0;            /* position in the encoded chunk */
+    size_t len = 0;          /* number of bytes decoded */
+    uint64_t run;            /* length of the current run */
+    int shift;               /* bit position of the next 7 bits of the run */
+
+    while (i < comp_len)
+    {
+        run = 0;
+        for (shift = 0; i < comp_len && shift < 64; shift += 7)
+        {
+            run |= (uint64_t) (comp[i] & 0x7f) << shift;
+            if (!(comp[i++] & 0x80))
+                break;
+        }
+
+        if (i >= comp_len || run == 0 || run > raw_len - len)
+            return (ERROR);
+        memset (raw + len, comp[i++], run);
+        len += run;
+    }
+
+    if (len != raw_len)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: delta_chunk
+
+PURPOSE: Encodes a chunk of 16-bit samples as the residuals of a planar
+prediction, bit-packed in blocks.
+ 
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The samples aren't 16-bit, or the encoded chunk wouldn't be
+             smaller than the chunk
+n            Number of bytes in the encoded chunk
+
+NOTES:
+  1. dst must hold raw_len bytes.
+  2. The residual of a sample is its difference from the sample above less
+     the same difference for the sample to its left, modulo 2^16, so
+     decoding is exact for any values.
+*****************************************************************************/
+static size_t delta_chunk
+(
+    const unsigned char *raw,   /* I: uncompressed chunk */
+    size_t raw_len,     /* I: number of bytes in the chunk */
+    int nsamps,         /* I: number of samples per line */
+    int sample_size,    /* I: number of bytes per sample */
+    unsigned char *dst  /* O: encoded chunk */
+)
+{
+    const uint16_t *line = NULL;  /* current line of the chunk */
+    const uint16_t *prev = NULL;  /* line above, or NULL for the first line */
+    uint16_t zz[RB_DELTA_BLOCK];  /* zigzag coded residuals of a block */
+    uint16_t diff;           /* difference of a sample from the one above */
+    uint16_t left;           /* same difference for the sample to the left */
+    uint16_t resid;          /* residual of a sample */
+    uint16_t any;            /* all the residuals of a block or'd together */
+    uint32_t bits;           /* packed bits not yet stored */
+    size_t nlines;           /* number of lines in the chunk */
+    size_t len = 0;          /* number of bytes encoded */
+    size_t y;                /* looping variable for the lines */
+    int x;                   /* looping variable for the blocks */
+    int i;                   /* looping variable for the block samples */
+    int n;                   /* number of samples in the block */
+    int width;               /* bits per residual of the block */
+    int nbits;               /* number of packed bits not yet stored */
+
+    if (sample_size != 2 || nsamps <= 0 ||
+        raw_len % ((size_t) nsamps * 2) != 0)
+        return (0);
+    nlines = raw_len / ((size_t) nsamps * 2);
+
+    for (y = 0; y < nlines; y++)
+    {
+        line = (const uint16_t *) raw + y * nsamps;
+        left = 0;
+        for (x = 0; x < nsamps; x += n)
+        {
+            n = nsamps - x;
+            if (n > RB_DELTA_BLOCK)
+                n = RB_DELTA_BLOCK;
+
+            any = 0;
+            for (i = 0; i < n; i++)
+            {
+                diff = line[x+i];
+                if (prev != NULL)
+                    diff -= prev[x+i];
+                resid = diff - left;
+                left = diff;
+                zz[i] = (uint16_t) (resid << 1) ^ (uint16_t) -(resid >> 15);
+                any |= zz[i];
+            }
+            for (width = 0; width < 16 && (any >> width) != 0; width++)
+                ;
+
+            /* The width byte and the packed residuals */
+            if (len + 1 + ((size_t) n * width + 7) / 8 >= raw_len)
+                return (0);
+            dst[len++] = width;
+            bits = 0;
+            nbits = 0;
+            for (i = 0; i < n; i++)
+            {
+                bits |= (uint32_t) zz[i] << nbits;
+                for (nbits += width; nbits >= 8; nbits -= 8)
+                {
+                    dst[len++] = bits & 0xff;
+                    bits >>= 8;
+                }
+            }
+            if (nbits > 0)
+                dst[len++] = bits;
+        }
+        prev = line;
+    }
+
+    return (len);
+}
+
+
+/******************************************************************************
+MODULE: undelta_line
+
+PURPOSE: Rebuilds a line of 16-bit samples from its zigzag coded residuals
+and the line above.
+ 
+RETURN VALUE: None
+
+NOTES:
+  1. The differences from the line above are the prefix sum of the
+     residuals, which is computed 8 samples at a time with SSE2 (log2(8)
+     shifted adds, then the last sum is carried to the next 8).
+*****************************************************************************/
+static void undelta_line
+(
+    const uint16_t *zz, /* I: zigzag coded residuals of the line */
+    const uint16_t *prev, /* I: line above, or NULL for the first line */
+    uint16_t *line,     /* O: decoded line */
+    int nsamps          /* I: number of samples per line */
+)
+{
+    int x = 0;               /* looping variable for the samples */
+    uint16_t diff = 0;       /* difference of a sample from the one above */
+#if defined(CHUNKED_HAVE_SSE2)
+    __m128i one = _mm_set1_epi16 (1);      /* low bit of each sample */
+    __m128i carry = _mm_setzero_si128 ();  /* last difference, in each lane */
+    __m128i v;               /* 8 samples being decoded */
+
+    for (; x + 8 <= nsamps; x += 8)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) (zz + x));
+        v = _mm_xor_si128 (_mm_srli_epi16 (v, 1),
+            _mm_sub_epi16 (_mm_setzero_si128 (), _mm_and_si128 (v, one)));
+        v = _mm_add_epi16 (v, _mm_slli_si128 (v, 2));
+        v = _mm_add_epi16 (v, _mm_slli_si128 (v, 4));
+        v = _mm_add_epi16 (v, _mm_slli_si128 (v, 8));
+        v = _mm_add_epi16 (v, carry);
+        carry = _mm_shufflehi_epi16 (v, 0xff);
+        carry = _mm_unpackhi_epi64 (carry, carry);
+        if (prev != NULL)
+            v = _mm_add_epi16 (v,
+                _mm_loadu_si128 ((const __m128i *) (prev + x)));
+        _mm_storeu_si128 ((__m128i *) (line + x), v);
+    }
+    diff = (uint16_t) _mm_cvtsi128_si32 (carry);
+#endif
+
+    for (; x < nsamps; x++)
+    {
+        diff += (uint16_t) (zz[x] >> 1) ^ (uint16_t) -(zz[x] & 1);
+        line[x] = diff;
+        if (prev != NULL)
+            line[x] += prev[x];
+    }
+}
+
+
+/******************************************************************************
+MODULE: undelta_chunk
+
+PURPOSE: Decodes a delta chunk, a line at a time.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The encoded chunk is corrupt or doesn't decode to raw_len bytes,
+             or an error occurred allocating the line buffer
+SUCCESS      Decoding was successful
+
+NOTES:
+*****************************************************************************/
+static int undelta_chunk
+(
+    const unsigned char *comp,  /* I: encoded chunk */
+    size_t comp_len,    /* I: number of bytes in the encoded chunk */
+    unsigned char *raw, /* O: decoded chunk */
+    size_t raw_len,     /* I: number of bytes in the decoded chunk */
+    int nsamps,         /* I: number of samples per line */
+    int sample_size     /* I: number of bytes per sample */
+)
+{
+    uint16_t *zz = NULL;     /* zigzag coded residuals of a line */
+    uint16_t *line = NULL;   /* current line of the chunk */
+    uint16_t *prev = NULL;   /* line above, or NULL for the first line */
+    uint32_t bits;           /* unpacked bits not yet used */
+    uint32_t mask;           /* mask of the low width bits */
+    size_t nlines;           /* number of lines in the chunk */
+    size_t pos = 0;          /* position in the encoded chunk */
+    size_t y;                /* looping variable for the lines */
+    int x;                   /* looping variable for the blocks */
+    int i;                   /* looping variable for the block samples */
+    int n;                   /* number of samples in the block */
+    int width;               /* bits per residual of the block */
+    int nbits;               /* number of unpacked bits not yet used */
+    int status = SUCCESS;    /* return status */
+
+    if (sample_size != 2 || nsamps <= 0 ||
+        raw_len % ((size_t) nsamps * 2) != 0)
+        return (ERROR);
+    nlines = raw_len / ((size_t) nsamps * 2);
+
+    zz = malloc (nsamps * sizeof (uint16_t));
+    if (zz == NULL)
+        return (ERROR);
+
+    for (y = 0; y < nlines && status == SUCCESS; y++)
+    {
+        /* Unpack the residuals of the line */
+        for (x = 0; x < nsamps && status == SUCCESS; x += n)
+        {
+            n = nsamps - x;
+            if (n > RB_DELTA_BLOCK)
+                n = RB_DELTA_BLOCK;
+
+            width = (pos < comp_len) ? comp[pos++] : 17;
+            if (width > 16 ||
+                ((size_t) n * width + 7) / 8 > comp_len - pos)
+            {
+                status = ERROR;
+                break;
+            }
+            mask = (1u << width) - 1;
+            bits = 0;
+            nbits = 0;
+            for (i = 0; i < n; i++)
+            {
+                for (; nbits < width; nbits += 8)
+                    bits |= (uint32_t) comp[pos++] << nbits;
+                zz[x+i] = bits & mask;
+                bits >>= width;
+                nbits -= width;
+            }
+        }
+        if (status != SUCCESS)
+            break;
+
+        line = (uint16_t *) raw + y * nsamps;
+        undelta_line (zz, prev, line, nsamps);
+        prev = line;
+    }
+    free (zz);
+
+    if (status != SUCCESS || pos != comp_len)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/* Chunks compressed by compress_chunk_range */
+typedef struct
+{
+    Raw_binary_codec_t codec;  /* compression to be applied */
+    const char *src;    /* uncompressed data for the chunks */
+    size_t chunk_bytes; /* uncompressed size of a full chunk */
+    size_t nbytes;      /* number of bytes in src */
+    int nsamps;         /* number of samples per line */
+    int sample_size;    /* number of bytes per sample */
+    int nchunks;        /* number of chunks in src */
+    char **dst;         /* buffer holding each stored chunk */
+    size_t *dst_len;    /* stored size of each chunk */
+} Rb_chunk_batch_t;
+
+
+/******************************************************************************
+MODULE: compress_chunk_range
+
+PURPOSE: Compresses a range of the chunks of a batch, as a chunk of
+espa_parallel_for.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred allocating a compressed chunk buffer
+SUCCESS      Compressing was successful
+
+NOTES:
+*****************************************************************************/
+static int compress_chunk_range
+(
+    void *arg,          /* I/O: batch of chunks (Rb_chunk_batch_t) */
+    int first,          /* I: first chunk of the range */
+    int end,            /* I: chunk after the range */
+    int runner          /* I: number of the thread (unused) */
+)
+{
+    Rb_chunk_batch_t *batch = arg;  /* batch of chunks */
+    int k;                   /* looping variable for the chunks */
+
+    for (k = first; k < end; k++)
+    {
+        const char *raw = batch->src + (size_t) k * batch->chunk_bytes;
+                                            /* chunk data */
+        size_t raw_len = batch->chunk_bytes;  /* uncompressed chunk size */
+        uLongf comp_len;                    /* compressed chunk size */
+        char *dst = NULL;                   /* stored chunk */
+
+        if (k == batch->nchunks - 1)
+            raw_len = batch->nbytes - (size_t) k * batch->chunk_bytes;
+
+        comp_len = compressBound (raw_len);
+        dst = malloc (comp_len);
+        batch->dst[k] = dst;
+        if (dst == NULL)
+            return (ERROR);
+
+        /* Keep the chunk uncompressed if it doesn't get smaller */
+        if (batch->codec == RB_CODEC_DEFLATE)
+        {
+            if (compress2 ((Bytef *) dst, &comp_len, (const Bytef *) raw,
+                raw_len, RB_DEFLATE_LEVEL) != Z_OK)
+                comp_len = raw_len;
+        }
+        else if (batch->codec == RB_CODEC_BITPACK)
+            comp_len = bitpack_chunk ((const unsigned char *) raw, raw_len,
+                (unsigned char *) dst);
+        else if (batch->codec == RB_CODEC_RLE)
+            comp_len = rle_chunk ((const unsigned char *) raw, raw_len,
+                (unsigned char *) dst);
+        else if (batch->codec == RB_CODEC_DELTA)
+            comp_len = delta_chunk ((const unsigned char *) raw, raw_len,
+                batch->nsamps, batch->sample_size, (unsigned char *) dst);
+        else
+            comp_len = raw_len;
+
+        if (comp_len == 0 || comp_len >= raw_len)
+        {
+            memcpy (dst, raw, raw_len);
+            comp_len = raw_len;
+        }
+        batch->dst_len[k] = comp_len;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: compress_raw_binary_chunks
+
+PURPOSE: Compresses consecutive chunks of a band, in parallel.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred compressing the chunks
+SUCCESS      Compressing was successful
+
+NOTES:
+  1. There can be at most RB_CHUNK_BATCH chunks in src.
+  2. A chunk which doesn't get smaller is stored uncompressed, so the stored
+     size never exceeds the uncompressed size.
+  3. The caller is responsible for freeing each of the dst buffers, even on
+     error (the ones not allocated are set to NULL).
+*****************************************************************************/
+int compress_raw_binary_chunks
+(
+    Raw_binary_codec_t codec,  /* I: compression to be applied */
+    const char *src,    /* I: uncompressed data for the chunks */
+    size_t chunk_bytes, /* I: uncompressed size of a full chunk */
+    size_t nbytes,      /* I: number of bytes in src; only the last chunk may
+                              be shorter than chunk_bytes */
+    int nsamps,         /* I: number of samples per line */
+    int sample_size,    /* I: number of bytes per sample */
+    char **dst,         /* O: buffer holding each stored chunk; free'd by the
+                              caller */
+    size_t *dst_len     /* O: stored size of each chunk */
+)
+{
+    char FUNC_NAME[] = "compress_raw_binary_chunks"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nchunks;             /* number of chunks in src */
+    int k;                   /* looping variable for the chunks */
+    Rb_chunk_batch_t batch;  /* batch of chunks being compressed */
+
+    nchunks = (nbytes + chunk_bytes - 1) / chunk_bytes;
+    if (nchunks > RB_CHUNK_BATCH)
+    {
+        sprintf (errmsg, "Compressing %d chunks at once; at most %d are "
+            "supported.", nchunks, RB_CHUNK_BATCH);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The chunks not compressed after an error are left NULL */
+    for (k = 0; k < nchunks; k++)
+        dst[k] = NULL;
+
+    batch.codec = codec;
+    batch.src = src;
+    batch.chunk_bytes = chunk_bytes;
+    batch.nbytes = nbytes;
+    batch.nsamps = nsamps;
+    batch.sample_size = sample_size;
+    batch.nchunks = nchunks;
+    batch.dst = dst;
+    batch.dst_len = dst_len;
+    if (espa_parallel_for (0, nchunks, 1, espa_task_nthreads (),
+        compress_chunk_range, &batch) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the compressed chunk buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_chunked
+
+PURPOSE: Opens a chunked band for reading, and reads and validates its chunk
+index.
+ 
+RETURN VALUE:
+Type = Raw_binary_chunked_t *
+Value        Description
+-----        -----------
+NULL         Error opening the band, or it isn't a valid chunked band
+non-NULL     Pointer to the opened chunked band
+
+NOTES:
+*****************************************************************************/
+Raw_binary_chunked_t *open_raw_binary_chunked
+(
+    char *infile        /* I: name of the chunked band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_chunked"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint64_t c;              /* looping variable for the chunks */
+    uint64_t nchunks;        /* number of chunks expected for the lines */
+    struct stat statbuf;     /* buffer for the file stat function */
+    Raw_binary_chunked_header_t header;   /* header of the band */
+    Raw_binary_chunked_trailer_t *tr = NULL;  /* trailer of the band */
+    Raw_binary_chunked_t *rbc = NULL;     /* chunked band */
+
+    rbc = calloc (1, sizeof (Raw_binary_chunked_t));
+    if (rbc == NULL)
+    {
+        sprintf (errmsg, "Allocating the chunked band structure for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (rbc->file_name, infile, sizeof (rbc->file_name) - 1);
+    rbc->cached = -1;
+    tr = &rbc->trailer;
+
+    rbc->fd = open_raw_binary_shm (infile, O_RDONLY);
+    if (rbc->fd == -1)
+        rbc->fd = open (infile, O_RDONLY);
+    if (rbc->fd == -1)
+    {
+        sprintf (errmsg, "Opening the chunked band %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbc);
+        return (NULL);
+    }
+
+    /* Read and check the header and trailer */
+    if (fstat (rbc->fd, &statbuf) == -1 ||
+        statbuf.st_size < (off_t) (sizeof (header) + sizeof (*tr)) ||
+        pread_chunked (rbc->fd, &header, sizeof (header), 0) != SUCCESS ||
+        pread_chunked (rbc->fd, tr, sizeof (*tr),
+            statbuf.st_size - sizeof (*tr)) != SUCCESS ||
+        memcmp (header.magic, RB_CHUNKED_MAGIC, sizeof (header.magic)) ||
+        memcmp (tr->magic, RB_CHUNKED_MAGIC, sizeof (tr->magic)) ||
+        header.version != RB_CHUNKED_VERSION ||
+        header.codec > RB_CODEC_DELTA ||
+        tr->chunk_lines == 0 || tr->nsamps == 0 || tr->nbytes == 0)
+    {
+        sprintf (errmsg, "%s isn't a valid chunked raw binary band.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (NULL);
+    }
+    rbc->codec = header.codec;
+    rbc->chunk_bytes = (size_t) tr->chunk_lines * tr->nsamps * tr->nbytes;
+    rbc->size = (off_t) tr->nlines * tr->nsamps * tr->nbytes;
+
+    nchunks = (tr->nlines + tr->chunk_lines - 1) / tr->chunk_lines;
+    if (tr->nchunks != nchunks || tr->index_offset + (nchunks + 1) *
+        sizeof (uint64_t) + sizeof (*tr) != (uint64_t) statbuf.st_size)
+    {
+        sprintf (errmsg, "Chunk index of the chunked band %s doesn't match "
+            "the size of the band.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (NULL);
+    }
+
+    /* Read and check the chunk index */
+    rbc->index = malloc ((nchunks + 1) * sizeof (uint64_t));
+    rbc->cache = malloc (rbc->chunk_bytes);
+    if (rbc->index == NULL || rbc->cache == NULL)
+    {
+        sprintf (errmsg, "Allocating the chunk index and cache for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (NULL);
+    }
+
+    if (pread_chunked (rbc->fd, rbc->index, (nchunks + 1) * sizeof (uint64_t),
+        tr->index_offset) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the chunk index of %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (NULL);
+    }
+
+    for (c = 0; c < nchunks; c++)
+    {
+        if (rbc->index[c] > rbc->index[c+1] ||
+            rbc->index[c+1] - rbc->index[c] > rbc->chunk_bytes)
+            break;
+    }
+    if (rbc->index[0] != sizeof (header) || c < nchunks ||
+        rbc->index[nchunks] != tr->index_offset)
+    {
+        sprintf (errmsg, "Chunk index of %s is corrupt.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (NULL);
+    }
+
+    return (rbc);
+}
+
+
+/******************************************************************************
+MODULE: decode_chunk
+
+PURPOSE: Reads and decompresses a single chunk of the chunked band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading or decompressing the chunk
+SUCCESS      Decoding was successful
+
+NOTES:
+  1. Only pread and local buffers are used, so chunks can be decoded by
+     several threads at once.
+*****************************************************************************/
+static int decode_chunk
+(
+    Raw_binary_chunked_t *rbc,  /* I: chunked band */
+    uint64_t chunk,     /* I: chunk to be decoded */
+    char *out           /* O: buffer for the uncompressed chunk */
+)
+{
+    char FUNC_NAME[] = "decode_chunk"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *comp = NULL;       /* compressed chunk */
+    size_t stored;           /* stored size of the chunk */
+    size_t expected;         /* uncompressed size of the chunk */
+    uLongf raw_len;          /* size of the decompressed chunk */
+    size_t i;                /* looping variable for the unpacked bytes */
+    int status = SUCCESS;    /* return status */
+
+    expected = rbc->chunk_bytes;
+    if (chunk == rbc->trailer.nchunks - 1)
+        expected = rbc->size - (off_t) chunk * rbc->chunk_bytes;
+    raw_len = expected;
+    stored = rbc->index[chunk+1] - rbc->index[chunk];
+
+    /* Chunks stored uncompressed are read directly */
+    if (stored == expected)
+        status = pread_chunked (rbc->fd, out, expected, rbc->index[chunk]);
+    else
+    {
+        comp = malloc (stored);
+        if (comp == NULL ||
+            pread_chunked (rbc->fd, comp, stored, rbc->index[chunk]) !=
+                SUCCESS)
+            status = ERROR;
+        else if (rbc->codec == RB_CODEC_BITPACK)
+        {
+            /* Expand the bits, first byte in the high bit */
+            if (stored != (expected + 7) / 8)
+                status = ERROR;
+            else
+            {
+                for (i = 0; i < expected; i++)
+                    out[i] = ((unsigned char) comp[i / 8] >> (7 - i % 8))
+                        & 1;
+            }
+        }
+        else if (rbc->codec == RB_CODEC_RLE)
+            status = unrle_chunk ((unsigned char *) comp, stored,
+                (unsigned char *) out, expected);
+        else if (rbc->codec == RB_CODEC_DELTA)
+            status = undelta_chunk ((unsigned char *) comp, stored,
+                (unsigned char *) out, expected, rbc->trailer.nsamps,
+                rbc->trailer.nbytes);
+        else if (uncompress ((Bytef *) out, &raw_len, (Bytef *) comp, stored)
+            != Z_OK || raw_len != expected)
+            status = ERROR;
+        free (comp);
+    }
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Decoding chunk %lu of the chunked band %s.",
+            (unsigned long) chunk, rbc->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (status);
+}
+
+
+/* Whole chunks decoded by decode_chunk_range */
+typedef struct
+{
+    Raw_binary_chunked_t *rbc;  /* chunked band */
+    uint64_t chunk;     /* first chunk decoded */
+    char *out;          /* buffer for the uncompressed chunks */
+} Rb_chunk_run_t;
+
+
+/******************************************************************************
+MODULE: decode_chunk_range
+
+PURPOSE: Decodes a range of whole chunks, as a chunk of espa_parallel_for.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred decoding a chunk
+SUCCESS      Decoding was successful
+
+NOTES:
+*****************************************************************************/
+static int decode_chunk_range
+(
+    void *arg,          /* I: chunks being decoded (Rb_chunk_run_t) */
+    int first,          /* I: first chunk of the range, from run->chunk */
+    int end,            /* I: chunk after the range */
+    int runner          /* I: number of the thread (unused) */
+)
+{
+    Rb_chunk_run_t *run = arg;  /* chunks being decoded */
+    int k;                   /* looping variable for the chunks */
+
+    for (k = first; k < end; k++)
+    {
+        if (decode_chunk (run->rbc, run->chunk + k,
+            run->out + (size_t) k * run->rbc->chunk_bytes) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_chunked
+
+PURPOSE: Reads nbytes of uncompressed band data at the specified offset of the
+chunked band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the data, or the data is beyond the
+             end of the band
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Whole chunks are decoded directly into buf, in parallel.  The partial
+     chunks at the ends of the range go through the single chunk cache, so
+     reading a band a line at a time decodes each chunk once.
+*****************************************************************************/
+int read_raw_binary_chunked
+(
+    Raw_binary_chunked_t *rbc,  /* I/O: chunked band */
+    off_t offset,       /* I: uncompressed byte offset to read from */
+    size_t nbytes,      /* I: number of uncompressed bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_chunked"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *out = buf;         /* current output location */
+    uint64_t chunk;          /* current chunk */
+    size_t within;           /* offset of the read in the current chunk */
+    size_t ncopy;            /* number of bytes copied from the cache */
+    long nfull;              /* number of whole chunks to be decoded */
+    Rb_chunk_run_t run;      /* whole chunks being decoded */
+
+    if (offset < 0 || offset + (off_t) nbytes > rbc->size)
+    {
+        sprintf (errmsg, "Reading %lu bytes at offset %ld is beyond the end "
+            "of the chunked band %s.", (unsigned long) nbytes, (long) offset,
+            rbc->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (nbytes > 0)
+    {
+        chunk = offset / rbc->chunk_bytes;
+        within = offset % rbc->chunk_bytes;
+
+        /* Decode the whole chunks straight into the output */
+        nfull = 0;
+        if (within == 0)
+        {
+            nfull = nbytes / rbc->chunk_bytes;
+            if (offset + (off_t) nbytes == rbc->size)
+                nfull = (nbytes + rbc->chunk_bytes - 1) / rbc->chunk_bytes;
+        }
+        if (nfull > 0)
+        {
+            run.rbc = rbc;
+            run.chunk = chunk;
+            run.out = out;
+            if (espa_parallel_for (0, (int) nfull, 1, espa_task_nthreads (),
+                decode_chunk_range, &run) != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+
+            ncopy = (size_t) nfull * rbc->chunk_bytes;
+            if (ncopy > nbytes)
+                ncopy = nbytes;
+        }
+        else
+        {
+            /* Go through the cache for a partial chunk */
+            if (rbc->cached != (long) chunk)
+            {
+                rbc->cached = -1;
+                if (decode_chunk (rbc, chunk, rbc->cache) != SUCCESS)
+                    return (ERROR);
+                rbc->cached = chunk;
+            }
+
+            ncopy = rbc->chunk_bytes - within;
+            if (ncopy > nbytes)
+                ncopy = nbytes;
+            memcpy (out, rbc->cache + within, ncopy);
+        }
+
+        out += ncopy;
+        offset += ncopy;
+        nbytes -= ncopy;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_chunked_size
+
+PURPOSE: Returns the uncompressed size of the chunked band.
+ 
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+size         Number of bytes of band data
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_chunked_size
+(
+    Raw_binary_chunked_t *rbc   /* I: chunked band */
+)
+{
+    return (rbc->size);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_chunked
+
+PURPOSE: Closes the chunked band and frees its index and cache.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_chunked
+(
+    Raw_binary_chunked_t *rbc   /* I: chunked band to be closed */
+)
+{
+    if (rbc == NULL)
+        return;
+
+    if (rbc->fd != -1)
+        close (rbc->fd);
+    free (rbc->index);
+    free (rbc->cache);
+    free (rbc);
+}
+
+
+/******************************************************************************
+MODULE: chunked_stream_read
+
+PURPOSE: Read function of the stdio stream for a chunked band.
+ 
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           An error occurred reading the band
+0            The end of the band was reached
+n            Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t chunked_stream_read
+(
+    void *cookie,       /* I/O: chunked band */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    Raw_binary_chunked_t *rbc = cookie;   /* chunked band */
+
+    if (rbc->pos >= rbc->size)
+        return (0);
+    if ((off_t) size > rbc->size - rbc->pos)
+        size = rbc->size - rbc->pos;
+
+    if (read_raw_binary_chunked (rbc, rbc->pos, size, buf) != SUCCESS)
+        return (-1);
+    rbc->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: chunked_stream_seek
+
+PURPOSE: Seek function of the stdio stream for a chunked band, positioning
+the stream in the uncompressed band data.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The new position is invalid
+0            Seeking was successful
+
+NOTES:
+*****************************************************************************/
+static int chunked_stream_seek
+(
+    void *cookie,       /* I/O: chunked band */
+    off64_t *offset,    /* I/O: requested offset; returns the new position */
+    int whence          /* I: SEEK_SET, SEEK_CUR, or SEEK_END */
+)
+{
+    Raw_binary_chunked_t *rbc = cookie;   /* chunked band */
+    off64_t pos;             /* new position */
+
+    if (whence == SEEK_SET)
+        pos = *offset;
+    else if (whence == SEEK_CUR)
+        pos = rbc->pos + *offset;
+    else if (whence == SEEK_END)
+        pos = rbc->size + *offset;
+    else
+        return (-1);
+
+    if (pos < 0)
+        return (-1);
+    rbc->pos = pos;
+    *offset = pos;
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: chunked_stream_close
+
+PURPOSE: Close function of the stdio stream for a chunked band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            Closing was successful
+
+NOTES:
+*****************************************************************************/
+static int chunked_stream_close
+(
+    void *cookie        /* I: chunked band */
+)
+{
+    close_raw_binary_chunked (cookie);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_chunked_stream
+
+PURPOSE: Opens a chunked band as a read-only stdio stream of the uncompressed
+band data, so it can be read with fread/fseek like a plain raw binary band.
+ 
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the chunked band
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. The stream has a small (BUFSIZ) buffer.  glibc passes a read larger
+     than the buffer to read_raw_binary_chunked as a single request, so its
+     chunks are decoded in parallel, while the small reads after each seek
+     of a window read only refill the small buffer.  (An unbuffered cookie
+     stream hands large reads over in tiny pieces.)
+  2. The stream has no file descriptor; fileno returns -1.
+*****************************************************************************/
+FILE *open_raw_binary_chunked_stream
+(
+    char *infile        /* I: name of the chunked band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_chunked_stream"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* stream for the chunked band */
+    Raw_binary_chunked_t *rbc = NULL;     /* chunked band */
+    cookie_io_functions_t funcs =         /* stream functions */
+        {chunked_stream_read, NULL, chunked_stream_seek, chunked_stream_close};
+
+    rbc = open_raw_binary_chunked (infile);
+    if (rbc == NULL)
+        return (NULL);
+
+    fptr = fopencookie (rbc, "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for the chunked band %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, BUFSIZ);
+
+    return (fptr);
+}
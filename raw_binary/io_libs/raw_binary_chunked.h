@@ -0,0 +1,162 @@
+/*****************************************************************************
+FILE: raw_binary_chunked.h
+  
+PURPOSE: Contains defines, structures, and prototypes for the compressed
+(chunked) raw binary band format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A chunked band holds the same data as the raw binary band, split into
+     chunks of chunk_lines lines which are each compressed independently,
+     followed by an index of the chunk offsets so any chunk can be decoded
+     without the ones before it.  The layout of the file is:
+         Raw_binary_chunked_header_t
+         chunk 0 ... chunk nchunks-1
+         uint64_t index[nchunks+1]  (file offset of each chunk, then the
+                                     offset of the index itself)
+         Raw_binary_chunked_trailer_t
+  2. A chunk with a stored size equal to its uncompressed size is stored
+     uncompressed, which is done whenever compressing doesn't make it smaller.
+  3. The codec in the header marks how the chunks are encoded.  The bitpack
+     codec stores a chunk whose bytes are all 0 or 1 (a mask band) as one
+     bit per byte, first byte in the high bit, and the rle codec stores a
+     chunk as runs of repeated bytes.  A chunk that can't be bit-packed is
+     stored uncompressed, per note 2.
+  4. The delta codec is for smooth 16-bit bands, such as the angle bands.
+     Each sample is predicted from its neighbors to the left, above, and
+     above-left (left + above - above-left, which is exact for a plane), so
+     the residuals of a smooth band are mostly 0 or +/-1.  The residuals are
+     zigzag coded and bit-packed in blocks of RB_DELTA_BLOCK samples along
+     each line, each block with the number of bits of its largest residual.
+     The first line of a chunk is predicted from the left only, so chunks
+     still decode independently.  Bands of other sample sizes are stored
+     uncompressed, per note 2.
+  5. Chunked bands are recognized by the signature at the start of the file,
+     so the file_name in the band metadata doesn't change.  They are read
+     transparently by open_raw_binary/read_raw_binary, read_raw_binary_window,
+     and open_raw_binary_mapped (which decodes the band into memory), but
+     can't be opened for update.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_CHUNKED_H
+#define RAW_BINARY_CHUNKED_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Signature at the start and the end of a chunked band */
+#define RB_CHUNKED_MAGIC "ESPACHK1"
+#define RB_CHUNKED_VERSION 1
+
+/* Preferred uncompressed size of a chunk; chunks hold whole lines */
+#define RB_CHUNK_SIZE (1024 * 1024)
+
+/* Maximum number of chunks compressed or decoded in parallel at once */
+#define RB_CHUNK_BATCH 16
+
+/* zlib compression level for the deflate codec; favors speed since the
+   bands are mostly scratch files */
+#define RB_DEFLATE_LEVEL 1
+
+/* Number of residuals bit-packed with the same width by the delta codec */
+#define RB_DELTA_BLOCK 64
+
+/* Compression applied to the chunks of a band written via the raw binary
+   writer */
+typedef enum {
+  RB_CODEC_NONE,        /* write a plain, uncompressed raw binary band */
+  RB_CODEC_DEFLATE,     /* write a chunked band compressed with zlib */
+  RB_CODEC_BITPACK,     /* write a chunked band of 0/1 bytes packed to one
+                           bit each */
+  RB_CODEC_RLE,         /* write a chunked band run-length encoded */
+  RB_CODEC_DELTA        /* write a chunked band of 16-bit samples predicted
+                           from their neighbors, with the residuals
+                           bit-packed */
+} Raw_binary_codec_t;
+
+/* Header at the start of a chunked band */
+typedef struct {
+    char magic[8];              /* RB_CHUNKED_MAGIC, not NULL-terminated */
+    uint32_t version;           /* RB_CHUNKED_VERSION */
+    uint32_t codec;             /* Raw_binary_codec_t of the chunks */
+} Raw_binary_chunked_header_t;
+
+/* Trailer at the end of a chunked band */
+typedef struct {
+    uint64_t nlines;            /* number of lines in the band */
+    uint64_t nchunks;           /* number of chunks in the band */
+    uint64_t index_offset;      /* file offset of the chunk index */
+    uint32_t nsamps;            /* number of samples per line */
+    uint32_t nbytes;            /* number of bytes per pixel */
+    uint32_t chunk_lines;       /* number of lines per chunk; the last chunk
+                                   may have fewer */
+    uint32_t reserved;          /* unused, set to 0 */
+    char magic[8];              /* RB_CHUNKED_MAGIC, not NULL-terminated */
+} Raw_binary_chunked_trailer_t;
+
+/* Chunked band opened for reading; the contents are private */
+typedef struct raw_binary_chunked Raw_binary_chunked_t;
+
+/* Prototypes */
+Raw_binary_codec_t get_raw_binary_codec ();
+
+Raw_binary_codec_t get_raw_binary_mask_codec ();
+
+Raw_binary_codec_t get_raw_binary_angle_codec ();
+
+bool is_raw_binary_chunked
+(
+    int fd              /* I: file descriptor of the raw binary file */
+);
+
+int compress_raw_binary_chunks
+(
+    Raw_binary_codec_t codec,  /* I: compression to be applied */
+    const char *src,    /* I: uncompressed data for the chunks */
+    size_t chunk_bytes, /* I: uncompressed size of a full chunk */
+    size_t nbytes,      /* I: number of bytes in src; only the last chunk may
+                              be shorter than chunk_bytes */
+    int nsamps,         /* I: number of samples per line */
+    int sample_size,    /* I: number of bytes per sample */
+    char **dst,         /* O: buffer holding each stored chunk; free'd by the
+                              caller */
+    size_t *dst_len     /* O: stored size of each chunk */
+);
+
+Raw_binary_chunked_t *open_raw_binary_chunked
+(
+    char *infile        /* I: name of the chunked band to be opened */
+);
+
+int read_raw_binary_chunked
+(
+    Raw_binary_chunked_t *rbc,  /* I/O: chunked band */
+    off_t offset,       /* I: uncompressed byte offset to read from */
+    size_t nbytes,      /* I: number of uncompressed bytes to read */
+    void *buf           /* O: buffer of nbytes */
+);
+
+off_t get_raw_binary_chunked_size
+(
+    Raw_binary_chunked_t *rbc   /* I: chunked band */
+);
+
+void close_raw_binary_chunked
+(
+    Raw_binary_chunked_t *rbc   /* I: chunked band to be closed */
+);
+
+FILE *open_raw_binary_chunked_stream
+(
+    char *infile        /* I: name of the chunked band to be opened */
+);
+
+#endif
@@ -0,0 +1,677 @@
+/*****************************************************************************
+FILE: raw_binary_constant.c
+  
+PURPOSE: Contains functions for writing constant (virtual) bands, and for
+reading them with the pixels generated on demand.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_constant.h for the format of a constant band.  The file
+     is written in the native byte order, the same as the raw binary band
+     data.
+  2. The pixels are generated RB_CONSTANT_BLOCK at a time.  The fill mask
+     band is read through open_raw_binary, so it can itself be a chunked,
+     GeoTIFF or constant band.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "raw_binary_constant.h"
+#include "raw_binary_io.h"
+
+/* Constant band opened for reading */
+struct raw_binary_constant
+{
+    char file_name[STR_SIZE];   /* name of the constant band */
+    Raw_binary_constant_header_t header;  /* description of the band */
+    int nbytes;                 /* number of bytes per pixel */
+    int mask_nbytes;            /* number of bytes per pixel of the mask */
+    char value_px[8];           /* value as a pixel of the band */
+    char fill_px[8];            /* fill value as a pixel of the band */
+    char mask_fill_px[8];       /* fill value as a pixel of the mask */
+    FILE *mask_fptr;            /* fill mask band; NULL if there is none */
+    char *block;                /* block of generated pixels */
+    char *mask_block;           /* block of fill mask pixels */
+    off_t size;                 /* size of the band data */
+    off_t pos;                  /* current position of the stream */
+};
+
+/******************************************************************************
+MODULE: use_raw_binary_constant
+
+PURPOSE: Determines if the tools should write the bands which are known to be
+constant as constant bands, via the ESPA_CONSTANT_BANDS environment variable.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_CONSTANT_BANDS is "yes"
+false        ESPA_CONSTANT_BANDS isn't set, or is anything else
+
+NOTES:
+*****************************************************************************/
+bool use_raw_binary_constant ()
+{
+    char *constant = getenv ("ESPA_CONSTANT_BANDS");  /* requested mode */
+
+    return (constant != NULL && !strcmp (constant, "yes"));
+}
+
+
+/******************************************************************************
+MODULE: encode_pixel
+
+PURPOSE: Converts a value to a pixel of the specified data type.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Values for the integer data types are rounded to the nearest integer.
+*****************************************************************************/
+static void encode_pixel
+(
+    enum Espa_data_type data_type,  /* I: data type of the pixel */
+    double value,       /* I: value of the pixel */
+    char *px            /* O: pixel, of up to 8 bytes */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            *(int8_t *) px = (int8_t) lround (value);
+            break;
+        case ESPA_UINT8:
+            *(uint8_t *) px = (uint8_t) lround (value);
+            break;
+        case ESPA_INT16:
+            *(int16_t *) px = (int16_t) lround (value);
+            break;
+        case ESPA_UINT16:
+            *(uint16_t *) px = (uint16_t) lround (value);
+            break;
+        case ESPA_INT32:
+            *(int32_t *) px = (int32_t) llround (value);
+            break;
+        case ESPA_UINT32:
+            *(uint32_t *) px = (uint32_t) llround (value);
+            break;
+        case ESPA_FLOAT32:
+            *(float *) px = (float) value;
+            break;
+        case ESPA_FLOAT64:
+            *(double *) px = value;
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_constant
+
+PURPOSE: Writes a constant band, in place of the band data, and tags the band
+metadata with the constant.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the band
+SUCCESS      Writing was successful
+
+NOTES:
+  1. The fill mask band is referred to by its file name, so it needs to stay
+     alongside the constant band.
+  2. The statistics and checksum of the band aren't computed.
+*****************************************************************************/
+int write_raw_binary_constant
+(
+    Espa_band_meta_t *bmeta,    /* I/O: band metadata of the constant band;
+                                      provides the file name, size, data type
+                                      and fill value; the constant is set */
+    double value,               /* I: value of the pixels */
+    Espa_band_meta_t *mask_bmeta /* I: band metadata of the fill mask band;
+                                      its fill pixels are fill in the
+                                      constant band; NULL for no fill mask */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_constant"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* constant band file */
+    Raw_binary_constant_header_t header;  /* contents of the file */
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, RB_CONSTANT_MAGIC, sizeof (header.magic));
+    header.version = RB_CONSTANT_VERSION;
+    header.data_type = bmeta->data_type;
+    header.nlines = bmeta->nlines;
+    header.nsamps = bmeta->nsamps;
+    header.value = value;
+    header.fill_value = bmeta->fill_value;
+    if (mask_bmeta != NULL)
+    {
+        if (mask_bmeta->nlines != bmeta->nlines ||
+            mask_bmeta->nsamps != bmeta->nsamps ||
+            mask_bmeta->fill_value == ESPA_INT_META_FILL ||
+            bmeta->fill_value == ESPA_INT_META_FILL)
+        {
+            sprintf (errmsg, "Fill mask band %s doesn't match the size of the "
+                "constant band %s, or one of them has no fill value.",
+                mask_bmeta->file_name, bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        header.mask_data_type = mask_bmeta->data_type;
+        header.mask_fill_value = mask_bmeta->fill_value;
+        strncpy (header.mask_file, mask_bmeta->file_name,
+            sizeof (header.mask_file) - 1);
+    }
+
+    fptr = fopen (bmeta->file_name, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the constant band %s.", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (fwrite (&header, sizeof (header), 1, fptr) != 1 || fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Writing the constant band %s.", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Tag the band metadata with the constant */
+    bmeta->constant.is_constant = true;
+    bmeta->constant.value = value;
+    strcpy (bmeta->constant.fill_band, header.mask_file);
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_constant
+
+PURPOSE: Determines if the open band file is a constant band.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file starts with the constant band signature
+false        The file is a plain raw binary band (or can't be read)
+
+NOTES:
+  1. The file is read with pread, so the file position isn't changed.
+*****************************************************************************/
+bool is_raw_binary_constant
+(
+    int fd              /* I: file descriptor of the band file */
+)
+{
+    char magic[8];           /* signature at the start of the file */
+
+    if (pread (fd, magic, sizeof (magic), 0) != sizeof (magic))
+        return (false);
+
+    return (memcmp (magic, RB_CONSTANT_MAGIC, sizeof (magic)) == 0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_constant
+
+PURPOSE: Opens a constant band for reading, along with its fill mask band.
+ 
+RETURN VALUE:
+Type = Raw_binary_constant_t *
+Value        Description
+-----        -----------
+NULL         Error opening the band, or it isn't a valid constant band
+non-NULL     Pointer to the opened constant band
+
+NOTES:
+*****************************************************************************/
+Raw_binary_constant_t *open_raw_binary_constant
+(
+    char *infile        /* I: name of the constant band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_constant"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char mask_file[STR_SIZE];  /* path of the fill mask band */
+    char *cptr = NULL;       /* end of the directory of the constant band */
+    int count;               /* number of chars copied in snprintf */
+    FILE *fptr = NULL;       /* constant band file */
+    Raw_binary_constant_header_t *header = NULL;  /* contents of the file */
+    Raw_binary_constant_t *rbk = NULL;    /* constant band */
+
+    rbk = calloc (1, sizeof (Raw_binary_constant_t));
+    if (rbk == NULL)
+    {
+        sprintf (errmsg, "Allocating the constant band structure for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (rbk->file_name, infile, sizeof (rbk->file_name) - 1);
+    header = &rbk->header;
+
+    fptr = fopen (infile, "rb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the constant band %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbk);
+        return (NULL);
+    }
+    if (fread (header, sizeof (*header), 1, fptr) != 1)
+        memset (header, 0, sizeof (*header));
+    fclose (fptr);
+    header->mask_file[sizeof (header->mask_file) - 1] = '\0';
+
+    /* Check the band description */
+    rbk->nbytes = get_data_type_size (header->data_type);
+    rbk->mask_nbytes = get_data_type_size (header->mask_data_type);
+    if (memcmp (header->magic, RB_CONSTANT_MAGIC, sizeof (header->magic)) ||
+        header->version != RB_CONSTANT_VERSION || rbk->nbytes == ERROR ||
+        rbk->mask_nbytes == ERROR)
+    {
+        sprintf (errmsg, "%s isn't a valid constant band.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbk);
+        return (NULL);
+    }
+    rbk->size = (off_t) header->nlines * header->nsamps * rbk->nbytes;
+    encode_pixel (header->data_type, header->value, rbk->value_px);
+    encode_pixel (header->data_type, header->fill_value, rbk->fill_px);
+    encode_pixel (header->mask_data_type, header->mask_fill_value,
+        rbk->mask_fill_px);
+
+    rbk->block = malloc ((size_t) RB_CONSTANT_BLOCK * rbk->nbytes);
+    if (rbk->block == NULL)
+    {
+        sprintf (errmsg, "Allocating the pixel block for %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_constant (rbk);
+        return (NULL);
+    }
+
+    /* Open the fill mask band, relative to the directory of the constant
+       band */
+    if (header->mask_file[0] != '\0')
+    {
+        cptr = strrchr (infile, '/');
+        if (header->mask_file[0] == '/' || cptr == NULL)
+            count = snprintf (mask_file, sizeof (mask_file), "%s",
+                header->mask_file);
+        else
+            count = snprintf (mask_file, sizeof (mask_file), "%.*s/%s",
+                (int) (cptr - infile), infile, header->mask_file);
+        if (count < 0 || count >= sizeof (mask_file))
+        {
+            sprintf (errmsg, "Overflow of mask_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_constant (rbk);
+            return (NULL);
+        }
+
+        rbk->mask_block = malloc ((size_t) RB_CONSTANT_BLOCK *
+            rbk->mask_nbytes);
+        rbk->mask_fptr = open_raw_binary (mask_file, "rb");
+        if (rbk->mask_block == NULL || rbk->mask_fptr == NULL)
+        {
+            sprintf (errmsg, "Opening the fill mask band %s of the constant "
+                "band %s.", mask_file, infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_constant (rbk);
+            return (NULL);
+        }
+    }
+
+    return (rbk);
+}
+
+
+/******************************************************************************
+MODULE: generate_constant_block
+
+PURPOSE: Generates a block of pixels of the constant band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the fill mask band
+SUCCESS      Generating the pixels was successful
+
+NOTES:
+*****************************************************************************/
+static int generate_constant_block
+(
+    Raw_binary_constant_t *rbk, /* I/O: constant band */
+    off_t pixel,        /* I: first pixel of the block */
+    int npix            /* I: number of pixels in the block */
+)
+{
+    char FUNC_NAME[] = "generate_constant_block"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *px = rbk->block;   /* current pixel */
+    char *mask_px = rbk->mask_block;  /* current fill mask pixel */
+    int i;                   /* looping variable for the pixels */
+
+    if (rbk->mask_fptr == NULL)
+    {
+        for (i = 0; i < npix; i++, px += rbk->nbytes)
+            memcpy (px, rbk->value_px, rbk->nbytes);
+        return (SUCCESS);
+    }
+
+    if (fseeko (rbk->mask_fptr, pixel * rbk->mask_nbytes, SEEK_SET) != 0 ||
+        fread (rbk->mask_block, rbk->mask_nbytes, npix, rbk->mask_fptr) !=
+            (size_t) npix)
+    {
+        sprintf (errmsg, "Reading the fill mask of the constant band %s.",
+            rbk->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < npix; i++, px += rbk->nbytes,
+        mask_px += rbk->mask_nbytes)
+    {
+        if (memcmp (mask_px, rbk->mask_fill_px, rbk->mask_nbytes) == 0)
+            memcpy (px, rbk->fill_px, rbk->nbytes);
+        else
+            memcpy (px, rbk->value_px, rbk->nbytes);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_constant
+
+PURPOSE: Reads nbytes of band data at the specified offset of the constant
+band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the data, or the data is beyond the
+             end of the band
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Without a fill mask the pixels are all the same, so a block which has
+     already been generated is reused for the rest of the read.
+*****************************************************************************/
+int read_raw_binary_constant
+(
+    Raw_binary_constant_t *rbk, /* I/O: constant band */
+    off_t offset,       /* I: byte offset in the band to read from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_constant"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *out = buf;         /* current output location */
+    off_t pixel;             /* first pixel of the current block */
+    size_t within;           /* offset of the read in the current block */
+    size_t ncopy;            /* number of bytes copied */
+    off_t npix;              /* number of pixels in the current block */
+    bool generated = false;  /* has a block been generated? */
+
+    if (offset < 0 || offset + (off_t) nbytes > rbk->size)
+    {
+        sprintf (errmsg, "Reading %lu bytes at offset %ld is beyond the end "
+            "of the constant band %s.", (unsigned long) nbytes, (long) offset,
+            rbk->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (nbytes > 0)
+    {
+        pixel = offset / rbk->nbytes;
+        within = offset % rbk->nbytes;
+        npix = rbk->size / rbk->nbytes - pixel;
+        if (npix > RB_CONSTANT_BLOCK)
+            npix = RB_CONSTANT_BLOCK;
+
+        if (rbk->mask_fptr != NULL || !generated)
+        {
+            if (generate_constant_block (rbk, pixel, (int) npix) != SUCCESS)
+                return (ERROR);
+            generated = true;
+        }
+
+        ncopy = (size_t) npix * rbk->nbytes - within;
+        if (ncopy > nbytes)
+            ncopy = nbytes;
+        memcpy (out, rbk->block + within, ncopy);
+
+        out += ncopy;
+        offset += ncopy;
+        nbytes -= ncopy;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_constant_size
+
+PURPOSE: Returns the size of the band data of the constant band.
+ 
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+size         Number of bytes of band data
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_constant_size
+(
+    Raw_binary_constant_t *rbk  /* I: constant band */
+)
+{
+    return (rbk->size);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_constant
+
+PURPOSE: Closes the constant band and its fill mask band.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_constant
+(
+    Raw_binary_constant_t *rbk  /* I: constant band to be closed */
+)
+{
+    if (rbk == NULL)
+        return;
+
+    if (rbk->mask_fptr != NULL)
+        close_raw_binary (rbk->mask_fptr);
+    free (rbk->block);
+    free (rbk->mask_block);
+    free (rbk);
+}
+
+
+/******************************************************************************
+MODULE: constant_stream_read
+
+PURPOSE: Read function of the stdio stream for a constant band.
+ 
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           An error occurred reading the band
+0            The end of the band was reached
+n            Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t constant_stream_read
+(
+    void *cookie,       /* I/O: constant band */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    Raw_binary_constant_t *rbk = cookie;   /* constant band */
+
+    if (rbk->pos >= rbk->size)
+        return (0);
+    if ((off_t) size > rbk->size - rbk->pos)
+        size = rbk->size - rbk->pos;
+
+    if (read_raw_binary_constant (rbk, rbk->pos, size, buf) != SUCCESS)
+        return (-1);
+    rbk->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: constant_stream_seek
+
+PURPOSE: Seek function of the stdio stream for a constant band, positioning
+the stream in the band data.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The new position is invalid
+0            Seeking was successful
+
+NOTES:
+*****************************************************************************/
+static int constant_stream_seek
+(
+    void *cookie,       /* I/O: constant band */
+    off64_t *offset,    /* I/O: requested offset; returns the new position */
+    int whence          /* I: SEEK_SET, SEEK_CUR, or SEEK_END */
+)
+{
+    Raw_binary_constant_t *rbk = cookie;   /* constant band */
+    off64_t pos;             /* new position */
+
+    if (whence == SEEK_SET)
+        pos = *offset;
+    else if (whence == SEEK_CUR)
+        pos = rbk->pos + *offset;
+    else if (whence == SEEK_END)
+        pos = rbk->size + *offset;
+    else
+        return (-1);
+
+    if (pos < 0)
+        return (-1);
+    rbk->pos = pos;
+    *offset = pos;
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: constant_stream_close
+
+PURPOSE: Close function of the stdio stream for a constant band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            Closing was successful
+
+NOTES:
+*****************************************************************************/
+static int constant_stream_close
+(
+    void *cookie        /* I: constant band */
+)
+{
+    close_raw_binary_constant (cookie);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_constant_stream
+
+PURPOSE: Opens a constant band as a read-only stdio stream of the band data,
+so it can be read with fread/fseek like a plain raw binary band.
+ 
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the constant band
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. As with chunked bands (see open_raw_binary_chunked_stream), the stream
+     has a small (BUFSIZ) buffer, so large reads are handed to
+     read_raw_binary_constant in one piece.
+  2. The stream has no file descriptor; fileno returns -1.
+*****************************************************************************/
+FILE *open_raw_binary_constant_stream
+(
+    char *infile        /* I: name of the constant band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_constant_stream"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* stream for the constant band */
+    Raw_binary_constant_t *rbk = NULL;    /* constant band */
+    cookie_io_functions_t funcs =         /* stream functions */
+        {constant_stream_read, NULL, constant_stream_seek,
+         constant_stream_close};
+
+    rbk = open_raw_binary_constant (infile);
+    if (rbk == NULL)
+        return (NULL);
+
+    fptr = fopencookie (rbk, "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for the constant band %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_constant (rbk);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, BUFSIZ);
+
+    return (fptr);
+}
@@ -0,0 +1,115 @@
+/*****************************************************************************
+FILE: raw_binary_constant.h
+  
+PURPOSE: Contains defines, structures, and prototypes for the constant
+(virtual) raw binary band format.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A constant band has the same value for every pixel, other than the fill
+     pixels of an optional fill mask band.  Rather than the band data, its
+     file holds only a Raw_binary_constant_header_t describing the band,
+     so it costs no storage or write I/O.  The band metadata is tagged with
+     the constant (see Espa_constant_t), so readers of the XML know the band
+     is constant without reading it.
+  2. The pixels of a constant band are generated as they are read: the
+     value, or the band's fill value where the fill mask band is fill.  A
+     relative fill mask file name is relative to the directory of the
+     constant band.
+  3. Constant bands are recognized by the signature at the start of the
+     file, the same as chunked bands.  They are read transparently by
+     open_raw_binary/read_raw_binary, read_raw_binary_window, and
+     open_raw_binary_mapped (which generates the band in memory), so the
+     exporters to other formats write out the full band, but they can't be
+     opened for update.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_CONSTANT_H
+#define RAW_BINARY_CONSTANT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Signature at the start of a constant band */
+#define RB_CONSTANT_MAGIC "ESPACON1"
+#define RB_CONSTANT_VERSION 1
+
+/* Number of pixels generated at a time when reading a constant band */
+#define RB_CONSTANT_BLOCK 65536
+
+/* Contents of a constant band file */
+typedef struct {
+    char magic[8];              /* RB_CONSTANT_MAGIC, not NULL-terminated */
+    uint32_t version;           /* RB_CONSTANT_VERSION */
+    uint32_t data_type;         /* Espa_data_type of the band */
+    uint32_t nlines;            /* number of lines in the band */
+    uint32_t nsamps;            /* number of samples per line */
+    double value;               /* value of the pixels */
+    double fill_value;          /* value of the fill pixels */
+    uint32_t mask_data_type;    /* Espa_data_type of the fill mask band */
+    uint32_t reserved;          /* unused, set to 0 */
+    double mask_fill_value;     /* fill value of the fill mask band */
+    char mask_file[STR_SIZE];   /* file name of the fill mask band; empty if
+                                   there is no fill mask */
+} Raw_binary_constant_header_t;
+
+/* Constant band opened for reading; the contents are private */
+typedef struct raw_binary_constant Raw_binary_constant_t;
+
+/* Prototypes */
+bool use_raw_binary_constant ();
+
+int write_raw_binary_constant
+(
+    Espa_band_meta_t *bmeta,    /* I/O: band metadata of the constant band;
+                                      provides the file name, size, data type
+                                      and fill value; the constant is set */
+    double value,               /* I: value of the pixels */
+    Espa_band_meta_t *mask_bmeta /* I: band metadata of the fill mask band;
+                                      its fill pixels are fill in the
+                                      constant band; NULL for no fill mask */
+);
+
+bool is_raw_binary_constant
+(
+    int fd              /* I: file descriptor of the band file */
+);
+
+Raw_binary_constant_t *open_raw_binary_constant
+(
+    char *infile        /* I: name of the constant band to be opened */
+);
+
+int read_raw_binary_constant
+(
+    Raw_binary_constant_t *rbk, /* I/O: constant band */
+    off_t offset,       /* I: byte offset in the band to read from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+);
+
+off_t get_raw_binary_constant_size
+(
+    Raw_binary_constant_t *rbk  /* I: constant band */
+);
+
+void close_raw_binary_constant
+(
+    Raw_binary_constant_t *rbk  /* I: constant band to be closed */
+);
+
+FILE *open_raw_binary_constant_stream
+(
+    char *infile        /* I: name of the constant band to be opened */
+);
+
+#endif
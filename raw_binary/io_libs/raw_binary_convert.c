@@ -0,0 +1,894 @@
+/*****************************************************************************
+FILE: raw_binary_convert.c
+
+PURPOSE: Contains functions for converting rows of pixels between the ESPA
+data types, and for applying the scale factor and offset of a band to get
+its physical values.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The common conversions have SSE2 and AVX2 kernels for x86 and a NEON
+     kernel for 64-bit ARM: widening uint8 to 16-bit, uint8, int16, uint16
+     and int32 to float32 (with or without the scale factor and offset), and
+     float32 to uint8, int16 and uint16.  The other conversions, and the
+     pixels left over at the end of the row by the vector kernels, are done
+     one pixel at a time.  As in fill_mask.c, the instruction set is chosen
+     at runtime, the first time one of the kernels is called, based on what
+     the processor supports.
+  2. The vector kernels use the same float operations as the scalar ones,
+     multiplying and then adding, so the output doesn't depend on which was
+     used.
+  3. The ESPA_CONVERT_ISA environment variable can be set to "scalar" to
+     force the scalar kernels (used for verifying the vector kernels).
+*****************************************************************************/
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_HAVE_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define CONVERT_HAVE_NEON
+#include <arm_neon.h>
+#endif
+#include <math.h>
+#include "raw_binary_convert.h"
+#include "raw_binary_io.h"
+
+/* Instruction set used by the kernels; chosen on first use */
+static int convert_isa = -1;
+
+
+/******************************************************************************
+MODULE:  get_convert_isa
+
+PURPOSE: Determines the instruction set to be used for the conversion
+kernels.
+
+RETURN VALUE:
+Type = Convert_isa_t
+Value              Description
+-----              -----------
+CONVERT_SCALAR     Scalar kernels are used
+CONVERT_SSE2       SSE2 kernels are used
+CONVERT_AVX2       AVX2 kernels are used
+CONVERT_NEON       NEON kernels are used
+
+NOTES:
+  1. If this is first called from multiple threads at once, each thread
+     determines and stores the same value.
+******************************************************************************/
+Convert_isa_t get_convert_isa ()
+{
+    char *isa_env = NULL;     /* value of the ESPA_CONVERT_ISA variable */
+    int isa = CONVERT_SCALAR; /* instruction set to be used */
+
+    if (convert_isa != -1)
+        return ((Convert_isa_t) convert_isa);
+
+    isa_env = getenv ("ESPA_CONVERT_ISA");
+    if (isa_env == NULL || strcmp (isa_env, "scalar"))
+    {
+#if defined(CONVERT_HAVE_X86)
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("avx2"))
+            isa = CONVERT_AVX2;
+        else if (__builtin_cpu_supports ("sse2"))
+            isa = CONVERT_SSE2;
+#elif defined(CONVERT_HAVE_NEON)
+        isa = CONVERT_NEON;
+#endif
+    }
+
+    convert_isa = isa;
+    return ((Convert_isa_t) isa);
+}
+
+
+/******************************************************************************
+MODULE:  get_type_range
+
+PURPOSE: Gets the range of values of an ESPA data type.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The data type is an integer data type
+false           The data type is a floating point data type
+
+NOTES:
+  1. The range isn't set for the floating point data types.
+******************************************************************************/
+static bool get_type_range
+(
+    enum Espa_data_type data_type, /* I: ESPA data type */
+    double *min,           /* O: lowest value of the data type */
+    double *max            /* O: highest value of the data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            *min = INT8_MIN;
+            *max = INT8_MAX;
+            return (true);
+        case ESPA_UINT8:
+            *min = 0;
+            *max = UINT8_MAX;
+            return (true);
+        case ESPA_INT16:
+            *min = INT16_MIN;
+            *max = INT16_MAX;
+            return (true);
+        case ESPA_UINT16:
+            *min = 0;
+            *max = UINT16_MAX;
+            return (true);
+        case ESPA_INT32:
+            *min = INT32_MIN;
+            *max = INT32_MAX;
+            return (true);
+        case ESPA_UINT32:
+            *min = 0;
+            *max = UINT32_MAX;
+            return (true);
+        default:
+            return (false);
+    }
+}
+
+
+/******************************************************************************
+Scalar kernels.  These also handle the pixels left over at the end of the
+row by the vector kernels.
+******************************************************************************/
+static double load_pixel
+(
+    const void *in, enum Espa_data_type in_type, size_t p
+)
+{
+    switch (in_type)
+    {
+        case ESPA_INT8:
+            return (((const int8_t *) in)[p]);
+        case ESPA_UINT8:
+            return (((const uint8_t *) in)[p]);
+        case ESPA_INT16:
+            return (((const int16_t *) in)[p]);
+        case ESPA_UINT16:
+            return (((const uint16_t *) in)[p]);
+        case ESPA_INT32:
+            return (((const int32_t *) in)[p]);
+        case ESPA_UINT32:
+            return (((const uint32_t *) in)[p]);
+        case ESPA_FLOAT32:
+            return (((const float *) in)[p]);
+        default:
+            return (((const double *) in)[p]);
+    }
+}
+
+static void store_pixel
+(
+    void *out, enum Espa_data_type out_type, size_t p, double value
+)
+{
+    switch (out_type)
+    {
+        case ESPA_INT8:
+            ((int8_t *) out)[p] = (int8_t) value;
+            break;
+        case ESPA_UINT8:
+            ((uint8_t *) out)[p] = (uint8_t) value;
+            break;
+        case ESPA_INT16:
+            ((int16_t *) out)[p] = (int16_t) value;
+            break;
+        case ESPA_UINT16:
+            ((uint16_t *) out)[p] = (uint16_t) value;
+            break;
+        case ESPA_INT32:
+            ((int32_t *) out)[p] = (int32_t) value;
+            break;
+        case ESPA_UINT32:
+            ((uint32_t *) out)[p] = (uint32_t) value;
+            break;
+        case ESPA_FLOAT32:
+            ((float *) out)[p] = (float) value;
+            break;
+        default:
+            ((double *) out)[p] = value;
+            break;
+    }
+}
+
+static void convert_pixels_scalar
+(
+    const void *in, enum Espa_data_type in_type, size_t start, size_t npix,
+    enum Espa_data_type out_type, void *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    bool is_int;              /* is the output an integer data type? */
+    double min = 0, max = 0;  /* range of the output data type */
+    double value;             /* current pixel */
+
+    is_int = get_type_range (out_type, &min, &max);
+    for (p = start; p < npix; p++)
+    {
+        value = load_pixel (in, in_type, p);
+        if (is_int)
+        {
+            /* The negated comparison also catches NaN */
+            if (!(value >= min))
+                value = min;
+            else if (value > max)
+                value = max;
+            value = rint (value);
+        }
+        store_pixel (out, out_type, p, value);
+    }
+}
+
+static void widen_uint8_scalar
+(
+    const uint8_t *in, size_t start, size_t npix, uint16_t *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+
+    for (p = start; p < npix; p++)
+        out[p] = in[p];
+}
+
+static void scale_pixels_scalar
+(
+    const void *in, enum Espa_data_type in_type, size_t start, size_t npix,
+    float scale, float offset, bool has_fill, long fill_value,
+    float out_fill, float *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    double value;             /* current pixel */
+    float fvalue;             /* current pixel as a float */
+
+    for (p = start; p < npix; p++)
+    {
+        value = load_pixel (in, in_type, p);
+        if (has_fill && value == (double) fill_value)
+            out[p] = out_fill;
+        else
+        {
+            fvalue = (float) value;
+            out[p] = fvalue * scale + offset;
+        }
+    }
+}
+
+
+#if defined(CONVERT_HAVE_X86)
+/******************************************************************************
+SSE2 kernels (8 or 16 pixels at a time)
+******************************************************************************/
+__attribute__ ((target ("sse2")))
+static void widen_uint8_sse2
+(
+    const uint8_t *in, size_t npix, uint16_t *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i data;             /* current pixels */
+
+    for (p = 0; p + 16 <= npix; p += 16)
+    {
+        data = _mm_loadu_si128 ((const __m128i *) &in[p]);
+        _mm_storeu_si128 ((__m128i *) &out[p], _mm_unpacklo_epi8 (data,
+            zero));
+        _mm_storeu_si128 ((__m128i *) &out[p+8], _mm_unpackhi_epi8 (data,
+            zero));
+    }
+
+    widen_uint8_scalar (in, p, npix, out);
+}
+
+__attribute__ ((target ("sse2")))
+static void scale_pixels_sse2
+(
+    const void *in, enum Espa_data_type in_type, size_t npix, float scale,
+    float offset, bool has_fill, long fill_value, float out_fill, float *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    int h;                    /* looping variable for the halves */
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i fill = _mm_set1_epi32 ((int32_t) fill_value);
+    __m128 vscale = _mm_set1_ps (scale);
+    __m128 voffset = _mm_set1_ps (offset);
+    __m128 vout_fill = _mm_set1_ps (out_fill);
+    __m128i data;             /* current pixels */
+    __m128i ival[2];          /* current pixels as int32 */
+    __m128 value;             /* physical values of the current pixels */
+    __m128 mask;              /* fill mask of the current pixels */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+    {
+        switch (in_type)
+        {
+            case ESPA_UINT8:
+                data = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)
+                    &((const uint8_t *) in)[p]), zero);
+                ival[0] = _mm_unpacklo_epi16 (data, zero);
+                ival[1] = _mm_unpackhi_epi16 (data, zero);
+                break;
+            case ESPA_INT16:
+                data = _mm_loadu_si128 ((const __m128i *)
+                    &((const int16_t *) in)[p]);
+                ival[0] = _mm_srai_epi32 (_mm_unpacklo_epi16 (data, data),
+                    16);
+                ival[1] = _mm_srai_epi32 (_mm_unpackhi_epi16 (data, data),
+                    16);
+                break;
+            case ESPA_UINT16:
+                data = _mm_loadu_si128 ((const __m128i *)
+                    &((const uint16_t *) in)[p]);
+                ival[0] = _mm_unpacklo_epi16 (data, zero);
+                ival[1] = _mm_unpackhi_epi16 (data, zero);
+                break;
+            default:  /* ESPA_INT32 */
+                ival[0] = _mm_loadu_si128 ((const __m128i *)
+                    &((const int32_t *) in)[p]);
+                ival[1] = _mm_loadu_si128 ((const __m128i *)
+                    &((const int32_t *) in)[p+4]);
+                break;
+        }
+
+        for (h = 0; h < 2; h++)
+        {
+            value = _mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (ival[h]),
+                vscale), voffset);
+            if (has_fill)
+            {
+                mask = _mm_castsi128_ps (_mm_cmpeq_epi32 (ival[h], fill));
+                value = _mm_or_ps (_mm_and_ps (mask, vout_fill),
+                    _mm_andnot_ps (mask, value));
+            }
+            _mm_storeu_ps (&out[p + 4*h], value);
+        }
+    }
+
+    scale_pixels_scalar (in, in_type, p, npix, scale, offset, has_fill,
+        fill_value, out_fill, out);
+}
+
+__attribute__ ((target ("sse2")))
+static void narrow_float_sse2
+(
+    const float *in, size_t npix, enum Espa_data_type out_type, float min,
+    float max, void *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    __m128 vmin = _mm_set1_ps (min);
+    __m128 vmax = _mm_set1_ps (max);
+    __m128i bias = _mm_set1_epi32 (32768);
+    __m128i lo, hi;           /* rounded values of the current pixels */
+    __m128i packed;           /* packed 16-bit values */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+    {
+        /* max returns its second operand for NaN, so NaN is clamped to
+           the lowest value */
+        lo = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_loadu_ps (&in[p]),
+            vmin), vmax));
+        hi = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_loadu_ps
+            (&in[p+4]), vmin), vmax));
+        switch (out_type)
+        {
+            case ESPA_UINT8:
+                packed = _mm_packs_epi32 (lo, hi);
+                _mm_storel_epi64 ((__m128i *) &((uint8_t *) out)[p],
+                    _mm_packus_epi16 (packed, packed));
+                break;
+            case ESPA_UINT16:
+                /* SSE2 only has a signed pack, so pack around 0 and flip
+                   the sign bit back */
+                packed = _mm_packs_epi32 (_mm_sub_epi32 (lo, bias),
+                    _mm_sub_epi32 (hi, bias));
+                _mm_storeu_si128 ((__m128i *) &((uint16_t *) out)[p],
+                    _mm_xor_si128 (packed, _mm_set1_epi16 ((short) 0x8000)));
+                break;
+            default:  /* ESPA_INT16 */
+                _mm_storeu_si128 ((__m128i *) &((int16_t *) out)[p],
+                    _mm_packs_epi32 (lo, hi));
+                break;
+        }
+    }
+
+    convert_pixels_scalar (in, ESPA_FLOAT32, p, npix, out_type, out);
+}
+
+
+/******************************************************************************
+AVX2 kernels (8 or 16 pixels at a time)
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static void widen_uint8_avx2
+(
+    const uint8_t *in, size_t npix, uint16_t *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+
+    for (p = 0; p + 16 <= npix; p += 16)
+        _mm256_storeu_si256 ((__m256i *) &out[p], _mm256_cvtepu8_epi16
+            (_mm_loadu_si128 ((const __m128i *) &in[p])));
+
+    widen_uint8_scalar (in, p, npix, out);
+}
+
+__attribute__ ((target ("avx2")))
+static void scale_pixels_avx2
+(
+    const void *in, enum Espa_data_type in_type, size_t npix, float scale,
+    float offset, bool has_fill, long fill_value, float out_fill, float *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    __m256i fill = _mm256_set1_epi32 ((int32_t) fill_value);
+    __m256 vscale = _mm256_set1_ps (scale);
+    __m256 voffset = _mm256_set1_ps (offset);
+    __m256 vout_fill = _mm256_set1_ps (out_fill);
+    __m256i ival;             /* current pixels as int32 */
+    __m256 value;             /* physical values of the current pixels */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+    {
+        switch (in_type)
+        {
+            case ESPA_UINT8:
+                ival = _mm256_cvtepu8_epi32 (_mm_loadl_epi64
+                    ((const __m128i *) &((const uint8_t *) in)[p]));
+                break;
+            case ESPA_INT16:
+                ival = _mm256_cvtepi16_epi32 (_mm_loadu_si128
+                    ((const __m128i *) &((const int16_t *) in)[p]));
+                break;
+            case ESPA_UINT16:
+                ival = _mm256_cvtepu16_epi32 (_mm_loadu_si128
+                    ((const __m128i *) &((const uint16_t *) in)[p]));
+                break;
+            default:  /* ESPA_INT32 */
+                ival = _mm256_loadu_si256 ((const __m256i *)
+                    &((const int32_t *) in)[p]);
+                break;
+        }
+
+        value = _mm256_add_ps (_mm256_mul_ps (_mm256_cvtepi32_ps (ival),
+            vscale), voffset);
+        if (has_fill)
+            value = _mm256_blendv_ps (value, vout_fill, _mm256_castsi256_ps
+                (_mm256_cmpeq_epi32 (ival, fill)));
+        _mm256_storeu_ps (&out[p], value);
+    }
+
+    scale_pixels_scalar (in, in_type, p, npix, scale, offset, has_fill,
+        fill_value, out_fill, out);
+}
+
+__attribute__ ((target ("avx2")))
+static void narrow_float_avx2
+(
+    const float *in, size_t npix, enum Espa_data_type out_type, float min,
+    float max, void *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    __m256 vmin = _mm256_set1_ps (min);
+    __m256 vmax = _mm256_set1_ps (max);
+    __m256i ival;             /* rounded values of the current pixels */
+    __m128i lo, hi;           /* first and last 4 rounded values */
+    __m128i packed;           /* packed 16-bit values */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+    {
+        /* max returns its second operand for NaN, so NaN is clamped to
+           the lowest value */
+        ival = _mm256_cvtps_epi32 (_mm256_min_ps (_mm256_max_ps
+            (_mm256_loadu_ps (&in[p]), vmin), vmax));
+        lo = _mm256_castsi256_si128 (ival);
+        hi = _mm256_extracti128_si256 (ival, 1);
+        switch (out_type)
+        {
+            case ESPA_UINT8:
+                packed = _mm_packs_epi32 (lo, hi);
+                _mm_storel_epi64 ((__m128i *) &((uint8_t *) out)[p],
+                    _mm_packus_epi16 (packed, packed));
+                break;
+            case ESPA_UINT16:
+                _mm_storeu_si128 ((__m128i *) &((uint16_t *) out)[p],
+                    _mm_packus_epi32 (lo, hi));
+                break;
+            default:  /* ESPA_INT16 */
+                _mm_storeu_si128 ((__m128i *) &((int16_t *) out)[p],
+                    _mm_packs_epi32 (lo, hi));
+                break;
+        }
+    }
+
+    convert_pixels_scalar (in, ESPA_FLOAT32, p, npix, out_type, out);
+}
+#endif
+
+
+#if defined(CONVERT_HAVE_NEON)
+/******************************************************************************
+NEON kernels (8 pixels at a time)
+******************************************************************************/
+static void widen_uint8_neon
+(
+    const uint8_t *in, size_t npix, uint16_t *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+        vst1q_u16 (&out[p], vmovl_u8 (vld1_u8 (&in[p])));
+
+    widen_uint8_scalar (in, p, npix, out);
+}
+
+static void scale_pixels_neon
+(
+    const void *in, enum Espa_data_type in_type, size_t npix, float scale,
+    float offset, bool has_fill, long fill_value, float out_fill, float *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    int h;                    /* looping variable for the halves */
+    int32x4_t fill = vdupq_n_s32 ((int32_t) fill_value);
+    float32x4_t vscale = vdupq_n_f32 (scale);
+    float32x4_t voffset = vdupq_n_f32 (offset);
+    float32x4_t vout_fill = vdupq_n_f32 (out_fill);
+    uint16x8_t data_u16;      /* current unsigned pixels */
+    int16x8_t data_s16;       /* current signed pixels */
+    int32x4_t ival[2];        /* current pixels as int32 */
+    float32x4_t value;        /* physical values of the current pixels */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+    {
+        switch (in_type)
+        {
+            case ESPA_UINT8:
+            case ESPA_UINT16:
+                if (in_type == ESPA_UINT8)
+                    data_u16 = vmovl_u8 (vld1_u8 (&((const uint8_t *) in)[p]));
+                else
+                    data_u16 = vld1q_u16 (&((const uint16_t *) in)[p]);
+                ival[0] = vreinterpretq_s32_u32 (vmovl_u16 (vget_low_u16
+                    (data_u16)));
+                ival[1] = vreinterpretq_s32_u32 (vmovl_u16 (vget_high_u16
+                    (data_u16)));
+                break;
+            case ESPA_INT16:
+                data_s16 = vld1q_s16 (&((const int16_t *) in)[p]);
+                ival[0] = vmovl_s16 (vget_low_s16 (data_s16));
+                ival[1] = vmovl_s16 (vget_high_s16 (data_s16));
+                break;
+            default:  /* ESPA_INT32 */
+                ival[0] = vld1q_s32 (&((const int32_t *) in)[p]);
+                ival[1] = vld1q_s32 (&((const int32_t *) in)[p+4]);
+                break;
+        }
+
+        for (h = 0; h < 2; h++)
+        {
+            value = vaddq_f32 (vmulq_f32 (vcvtq_f32_s32 (ival[h]), vscale),
+                voffset);
+            if (has_fill)
+                value = vbslq_f32 (vceqq_s32 (ival[h], fill), vout_fill,
+                    value);
+            vst1q_f32 (&out[p + 4*h], value);
+        }
+    }
+
+    scale_pixels_scalar (in, in_type, p, npix, scale, offset, has_fill,
+        fill_value, out_fill, out);
+}
+
+static void narrow_float_neon
+(
+    const float *in, size_t npix, enum Espa_data_type out_type, float min,
+    float max, void *out
+)
+{
+    size_t p;                 /* looping variable for pixels */
+    float32x4_t vmin = vdupq_n_f32 (min);
+    float32x4_t vmax = vdupq_n_f32 (max);
+    int32x4_t lo, hi;         /* rounded values of the current pixels */
+
+    for (p = 0; p + 8 <= npix; p += 8)
+    {
+        /* maxnm returns the number for NaN, so NaN is clamped to the lowest
+           value */
+        lo = vcvtnq_s32_f32 (vminnmq_f32 (vmaxnmq_f32 (vld1q_f32 (&in[p]),
+            vmin), vmax));
+        hi = vcvtnq_s32_f32 (vminnmq_f32 (vmaxnmq_f32 (vld1q_f32
+            (&in[p+4]), vmin), vmax));
+        switch (out_type)
+        {
+            case ESPA_UINT8:
+                vst1_u8 (&((uint8_t *) out)[p], vqmovun_s16 (vcombine_s16
+                    (vqmovn_s32 (lo), vqmovn_s32 (hi))));
+                break;
+            case ESPA_UINT16:
+                vst1q_u16 (&((uint16_t *) out)[p], vcombine_u16
+                    (vqmovun_s32 (lo), vqmovun_s32 (hi)));
+                break;
+            default:  /* ESPA_INT16 */
+                vst1q_s16 (&((int16_t *) out)[p], vcombine_s16
+                    (vqmovn_s32 (lo), vqmovn_s32 (hi)));
+                break;
+        }
+    }
+
+    convert_pixels_scalar (in, ESPA_FLOAT32, p, npix, out_type, out);
+}
+#endif
+
+
+/******************************************************************************
+MODULE:  widen_uint8_pixels
+
+PURPOSE: Widens uint8 pixels to 16-bit pixels.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void widen_uint8_pixels
+(
+    const uint8_t *in,     /* I: input pixels */
+    size_t npix,           /* I: number of pixels */
+    uint16_t *out          /* O: output pixels (int16 or uint16) */
+)
+{
+    switch (get_convert_isa ())
+    {
+#if defined(CONVERT_HAVE_X86)
+        case CONVERT_AVX2:
+            widen_uint8_avx2 (in, npix, out);
+            break;
+        case CONVERT_SSE2:
+            widen_uint8_sse2 (in, npix, out);
+            break;
+#elif defined(CONVERT_HAVE_NEON)
+        case CONVERT_NEON:
+            widen_uint8_neon (in, npix, out);
+            break;
+#endif
+        default:
+            widen_uint8_scalar (in, 0, npix, out);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  scale_int_pixels
+
+PURPOSE: Converts integer pixels to their float32 physical values.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The vector kernels handle uint8, int16, uint16 and int32 pixels, and the
+     fill value must be in the range of the input data type.
+******************************************************************************/
+static void scale_int_pixels
+(
+    const void *in,        /* I: input pixels */
+    enum Espa_data_type in_type,  /* I: data type of the input pixels */
+    size_t npix,           /* I: number of pixels */
+    float scale,           /* I: scale factor of the pixels */
+    float offset,          /* I: offset of the pixels */
+    bool has_fill,         /* I: do the pixels have a fill value? */
+    long fill_value,       /* I: fill value of the input pixels */
+    float out_fill,        /* I: output value of the fill pixels */
+    float *out             /* O: physical values of the pixels */
+)
+{
+    if (in_type != ESPA_UINT8 && in_type != ESPA_INT16 &&
+        in_type != ESPA_UINT16 && in_type != ESPA_INT32)
+    {
+        scale_pixels_scalar (in, in_type, 0, npix, scale, offset, has_fill,
+            fill_value, out_fill, out);
+        return;
+    }
+
+    switch (get_convert_isa ())
+    {
+#if defined(CONVERT_HAVE_X86)
+        case CONVERT_AVX2:
+            scale_pixels_avx2 (in, in_type, npix, scale, offset, has_fill,
+                fill_value, out_fill, out);
+            break;
+        case CONVERT_SSE2:
+            scale_pixels_sse2 (in, in_type, npix, scale, offset, has_fill,
+                fill_value, out_fill, out);
+            break;
+#elif defined(CONVERT_HAVE_NEON)
+        case CONVERT_NEON:
+            scale_pixels_neon (in, in_type, npix, scale, offset, has_fill,
+                fill_value, out_fill, out);
+            break;
+#endif
+        default:
+            scale_pixels_scalar (in, in_type, 0, npix, scale, offset,
+                has_fill, fill_value, out_fill, out);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  narrow_float_pixels
+
+PURPOSE: Converts float32 pixels to uint8, int16 or uint16 pixels, rounding
+them and saturating them to the range of the output data type.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void narrow_float_pixels
+(
+    const float *in,       /* I: input pixels */
+    size_t npix,           /* I: number of pixels */
+    enum Espa_data_type out_type, /* I: data type of the output pixels */
+    void *out              /* O: output pixels */
+)
+{
+    double min = 0, max = 0;  /* range of the output data type */
+
+    get_type_range (out_type, &min, &max);
+    switch (get_convert_isa ())
+    {
+#if defined(CONVERT_HAVE_X86)
+        case CONVERT_AVX2:
+            narrow_float_avx2 (in, npix, out_type, (float) min, (float) max,
+                out);
+            break;
+        case CONVERT_SSE2:
+            narrow_float_sse2 (in, npix, out_type, (float) min, (float) max,
+                out);
+            break;
+#elif defined(CONVERT_HAVE_NEON)
+        case CONVERT_NEON:
+            narrow_float_neon (in, npix, out_type, (float) min, (float) max,
+                out);
+            break;
+#endif
+        default:
+            convert_pixels_scalar (in, ESPA_FLOAT32, 0, npix, out_type, out);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  convert_raw_binary_pixels
+
+PURPOSE: Converts pixels from one ESPA data type to another.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unsupported data type
+SUCCESS         Successfully converted the pixels
+
+NOTES:
+  1. See raw_binary_convert.h for how the values are converted.
+******************************************************************************/
+int convert_raw_binary_pixels
+(
+    const void *in,        /* I: input pixels */
+    enum Espa_data_type in_type,  /* I: data type of the input pixels */
+    size_t npix,           /* I: number of pixels */
+    enum Espa_data_type out_type, /* I: data type of the output pixels */
+    void *out              /* O: output pixels; may not overlap the input
+                                 pixels unless the types are the same */
+)
+{
+    char FUNC_NAME[] = "convert_raw_binary_pixels";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int nbytes;               /* number of bytes per input pixel */
+
+    nbytes = get_data_type_size (in_type);
+    if (nbytes == ERROR || get_data_type_size (out_type) == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type conversion from %d to %d",
+            in_type, out_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (in_type == out_type)
+        memmove (out, in, npix * nbytes);
+    else if (in_type == ESPA_UINT8 &&
+        (out_type == ESPA_INT16 || out_type == ESPA_UINT16))
+        widen_uint8_pixels (in, npix, out);
+    else if (out_type == ESPA_FLOAT32 && in_type != ESPA_FLOAT64)
+        scale_int_pixels (in, in_type, npix, 1.0f, 0.0f, false, 0, 0.0f,
+            out);
+    else if (in_type == ESPA_FLOAT32 && (out_type == ESPA_UINT8 ||
+        out_type == ESPA_INT16 || out_type == ESPA_UINT16))
+        narrow_float_pixels (in, npix, out_type, out);
+    else
+        convert_pixels_scalar (in, in_type, 0, npix, out_type, out);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  scale_raw_binary_pixels
+
+PURPOSE: Converts integer pixels to their float32 physical values by
+applying the scale factor and offset of the band, passing the fill pixels
+through as the output fill value.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The input isn't an integer data type
+SUCCESS         Successfully converted the pixels
+
+NOTES:
+  1. The physical values are computed in float32, as (float) in * scale +
+     offset.
+******************************************************************************/
+int scale_raw_binary_pixels
+(
+    const void *in,        /* I: input pixels */
+    enum Espa_data_type in_type,  /* I: data type of the input pixels; must
+                                        be an integer data type */
+    size_t npix,           /* I: number of pixels */
+    float scale,           /* I: scale factor of the pixels */
+    float offset,          /* I: offset of the pixels */
+    bool has_fill,         /* I: do the pixels have a fill value? */
+    long fill_value,       /* I: fill value of the input pixels */
+    float out_fill,        /* I: output value of the fill pixels */
+    float *out             /* O: physical values of the pixels, which are
+                                 in * scale + offset */
+)
+{
+    char FUNC_NAME[] = "scale_raw_binary_pixels";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    double min, max;          /* range of the input data type */
+
+    if (!get_type_range (in_type, &min, &max))
+    {
+        sprintf (errmsg, "Scaling is only supported for integer data types, "
+            "not %d", in_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* A fill value outside the range of the data type can't match any
+       pixel */
+    if (has_fill && (fill_value < min || fill_value > max))
+        has_fill = false;
+
+    scale_int_pixels (in, in_type, npix, scale, offset, has_fill,
+        fill_value, out_fill, out);
+    return (SUCCESS);
+}
@@ -0,0 +1,70 @@
+/*****************************************************************************
+FILE: raw_binary_convert.h
+
+PURPOSE: Contains defines and prototypes for converting rows of pixels
+between the ESPA data types, and for applying the scale factor and offset of
+a band to get its physical values.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Widening conversions are exact (other than int32 and uint32 values
+     beyond 2^24 converted to float32).  Narrowing conversions saturate to
+     the range of the output data type, and floating point values are
+     rounded to the nearest integer (half to even) when converted to an
+     integer data type.  NaN values are converted to the lowest value of
+     the output data type.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_CONVERT_H
+#define RAW_BINARY_CONVERT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Instruction sets available for the conversion kernels */
+typedef enum {
+    CONVERT_SCALAR,
+    CONVERT_SSE2,
+    CONVERT_AVX2,
+    CONVERT_NEON
+} Convert_isa_t;
+
+/* Prototypes */
+Convert_isa_t get_convert_isa ();
+
+int convert_raw_binary_pixels
+(
+    const void *in,        /* I: input pixels */
+    enum Espa_data_type in_type,  /* I: data type of the input pixels */
+    size_t npix,           /* I: number of pixels */
+    enum Espa_data_type out_type, /* I: data type of the output pixels */
+    void *out              /* O: output pixels; may not overlap the input
+                                 pixels unless the types are the same */
+);
+
+int scale_raw_binary_pixels
+(
+    const void *in,        /* I: input pixels */
+    enum Espa_data_type in_type,  /* I: data type of the input pixels; must
+                                        be an integer data type */
+    size_t npix,           /* I: number of pixels */
+    float scale,           /* I: scale factor of the pixels */
+    float offset,          /* I: offset of the pixels */
+    bool has_fill,         /* I: do the pixels have a fill value? */
+    long fill_value,       /* I: fill value of the input pixels */
+    float out_fill,        /* I: output value of the fill pixels */
+    float *out             /* O: physical values of the pixels, which are
+                                 in * scale + offset */
+);
+
+#endif
@@ -0,0 +1,367 @@
+/*****************************************************************************
+FILE: raw_binary_cover.c
+
+PURPOSE: Contains functions for accumulating the percent coverage of the
+classes or QA bits of a raw binary band while it's written.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Only the number of pixels of each value is counted while the band is
+     written, which is one increment per pixel however many cover types the
+     band has.  The cover types are matched against the values when the band
+     is finished.  This limits the bands to 8-bit and 16-bit integer data,
+     which is what the class and QA bands are.
+  2. A pixel is fill if it equals the band fill_value.  The fill pixels
+     aren't counted in the percentages.
+*****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include "raw_binary_cover.h"
+
+/******************************************************************************
+MODULE: use_raw_binary_cover
+
+PURPOSE: Determines if the percent coverage was requested via the
+ESPA_PERCENT_COVER environment variable.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_PERCENT_COVER is "yes"
+false        ESPA_PERCENT_COVER isn't set, or is anything else
+
+NOTES:
+*****************************************************************************/
+bool use_raw_binary_cover ()
+{
+    char *cover = getenv ("ESPA_PERCENT_COVER");  /* requested coverage */
+
+    return (cover != NULL && !strcmp (cover, "yes"));
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_cover_types
+
+PURPOSE: Gets the cover types of a band from its classes or bitmap
+description.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            The band has no cover types
+other        Number of cover types of the band
+
+NOTES:
+  1. A band with class_values has one cover type per class, the pixels with
+     the class value.
+  2. Otherwise a band with a bitmap_description has one cover type per
+     single-bit field, the pixels with the bit set.  The fields of several
+     bits with the same description (such as the confidence levels of the
+     Landsat QA) and the unused bits have no cover type.
+*****************************************************************************/
+int get_raw_binary_cover_types
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata; provides the classes
+                                       or the bitmap_description */
+    Raw_binary_cover_type_t *types  /* O: cover types of the band (NULL to
+                                       only count them); sized for nclass or
+                                       nbits types */
+)
+{
+    int i;                   /* looping variable for the classes and bits */
+    int ntypes = 0;          /* number of cover types */
+    char **desc = NULL;      /* bitmap descriptions of the band */
+
+    if (bmeta->nclass > 0 && bmeta->class_values != NULL)
+    {
+        for (i = 0; i < bmeta->nclass; i++)
+        {
+            if (types != NULL)
+            {
+                types[ntypes].description =
+                    bmeta->class_values[i].description;
+                types[ntypes].mask = -1L;
+                types[ntypes].value = bmeta->class_values[i].class;
+            }
+            ntypes++;
+        }
+        return (ntypes);
+    }
+
+    if (bmeta->nbits <= 0 || bmeta->bitmap_description == NULL)
+        return (0);
+
+    /* Bits 0 to 15 at most, so the masks fit the 16-bit data types */
+    desc = bmeta->bitmap_description;
+    for (i = 0; i < bmeta->nbits && i < 16; i++)
+    {
+        if ((i > 0 && !strcmp (desc[i], desc[i-1])) ||
+            (i < bmeta->nbits - 1 && !strcmp (desc[i], desc[i+1])))
+            continue;
+        if (desc[i][0] == '\0' || !strncasecmp (desc[i], "unused", 6) ||
+            !strncasecmp (desc[i], "not used", 8))
+            continue;
+
+        if (types != NULL)
+        {
+            types[ntypes].description = desc[i];
+            types[ntypes].mask = 1L << i;
+            types[ntypes].value = 1L << i;
+        }
+        ntypes++;
+    }
+
+    return (ntypes);
+}
+
+
+/******************************************************************************
+MODULE: init_raw_binary_cover
+
+PURPOSE: Initializes the percent coverage accumulator for a band.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The data type of the band isn't supported, or there is no
+             memory for the counts
+SUCCESS      Initializing was successful
+
+NOTES:
+  1. The caller releases the accumulator with finish_raw_binary_cover, or
+     with free_raw_binary_cover if the band isn't finished.
+*****************************************************************************/
+int init_raw_binary_cover
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata; provides the data
+                                       type, fill value, and cover types */
+    Raw_binary_cover_t *cover    /* O: percent coverage accumulator */
+)
+{
+    char FUNC_NAME[] = "init_raw_binary_cover"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int max_types;           /* number of cover types allocated */
+
+    memset (cover, 0, sizeof (Raw_binary_cover_t));
+    cover->data_type = bmeta->data_type;
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            cover->nbytes = 1;
+            cover->offset = INT8_MIN;
+            cover->nvalues = UINT8_MAX + 1;
+            break;
+        case ESPA_UINT8:
+            cover->nbytes = 1;
+            cover->offset = 0;
+            cover->nvalues = UINT8_MAX + 1;
+            break;
+        case ESPA_INT16:
+            cover->nbytes = 2;
+            cover->offset = INT16_MIN;
+            cover->nvalues = UINT16_MAX + 1;
+            break;
+        case ESPA_UINT16:
+            cover->nbytes = 2;
+            cover->offset = 0;
+            cover->nvalues = UINT16_MAX + 1;
+            break;
+        default:
+            sprintf (errmsg, "Unsupported data type for the percent coverage "
+                "of band %s.", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    cover->use_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    cover->fill_value = bmeta->fill_value;
+
+    max_types = (bmeta->nclass > bmeta->nbits) ? bmeta->nclass : bmeta->nbits;
+    if (max_types < 1)
+        max_types = 1;
+    cover->types = malloc (max_types * sizeof (Raw_binary_cover_type_t));
+    cover->counts = calloc (cover->nvalues, sizeof (long));
+    if (cover->types == NULL || cover->counts == NULL)
+    {
+        sprintf (errmsg, "Allocating the pixel counts for the percent "
+            "coverage of band %s.", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_raw_binary_cover (cover);
+        return (ERROR);
+    }
+    cover->ntypes = get_raw_binary_cover_types (bmeta, cover->types);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: accumulate_raw_binary_cover
+
+PURPOSE: Adds a block of pixels to the pixel counts of the percent coverage.
+
+RETURN VALUE: N/A
+
+NOTES:
+*****************************************************************************/
+void accumulate_raw_binary_cover
+(
+    Raw_binary_cover_t *cover,   /* I/O: percent coverage accumulator */
+    const void *img_array,       /* I: block of pixels of the band's data
+                                       type */
+    size_t npixels               /* I: number of pixels in img_array */
+)
+{
+    size_t i;                    /* looping variable for the pixels */
+    long *counts = cover->counts;  /* number of pixels of each value */
+
+    switch (cover->data_type)
+    {
+        case ESPA_INT8:
+        {
+            const int8_t *pix = img_array;
+            for (i = 0; i < npixels; i++)
+                counts[pix[i] - INT8_MIN]++;
+            break;
+        }
+        case ESPA_UINT8:
+        {
+            const uint8_t *pix = img_array;
+            for (i = 0; i < npixels; i++)
+                counts[pix[i]]++;
+            break;
+        }
+        case ESPA_INT16:
+        {
+            const int16_t *pix = img_array;
+            for (i = 0; i < npixels; i++)
+                counts[pix[i] - INT16_MIN]++;
+            break;
+        }
+        case ESPA_UINT16:
+        {
+            const uint16_t *pix = img_array;
+            for (i = 0; i < npixels; i++)
+                counts[pix[i]]++;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: finish_raw_binary_cover
+
+PURPOSE: Computes the percent coverage of each cover type from the pixel
+counts and stores it in the band metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error allocating the percent coverage of the band
+SUCCESS      The percent coverage is set
+
+NOTES:
+  1. The percentages are 0 if all the pixels are fill.
+  2. Any percent coverage already in the band metadata, such as the one
+     copied from an input band, is replaced.
+*****************************************************************************/
+int finish_raw_binary_cover
+(
+    Raw_binary_cover_t *cover,   /* I/O: percent coverage accumulator; its
+                                       memory is released */
+    Espa_band_meta_t *bmeta      /* O: band metadata; percent_cover and
+                                       ncover are set */
+)
+{
+    char FUNC_NAME[] = "finish_raw_binary_cover"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int t;                   /* looping variable for the cover types */
+    int v;                   /* looping variable for the pixel values */
+    int fill_index = -1;     /* index of the count of the fill value */
+    long value;              /* pixel value of the current count */
+    long ntotal = 0;         /* number of non-fill pixels */
+    long ntype;              /* number of pixels of the cover type */
+    Raw_binary_cover_type_t *type = NULL;  /* current cover type */
+
+    if (cover->use_fill && cover->fill_value >= cover->offset &&
+        cover->fill_value < cover->offset + cover->nvalues)
+        fill_index = (int) (cover->fill_value - cover->offset);
+
+    for (v = 0; v < cover->nvalues; v++)
+    {
+        if (v != fill_index)
+            ntotal += cover->counts[v];
+    }
+
+    /* Replace the percent coverage of the band */
+    if (bmeta->arena == NULL)
+        free (bmeta->percent_cover);
+    bmeta->percent_cover = NULL;
+    bmeta->ncover = 0;
+    if (allocate_percent_coverage_metadata (bmeta, cover->ntypes) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the percent coverage of band %s.",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_raw_binary_cover (cover);
+        return (ERROR);
+    }
+
+    for (t = 0; t < cover->ntypes; t++)
+    {
+        type = &cover->types[t];
+        ntype = 0;
+        for (v = 0; v < cover->nvalues; v++)
+        {
+            value = v + cover->offset;
+            if (cover->counts[v] != 0 && v != fill_index &&
+                (value & type->mask) == type->value)
+                ntype += cover->counts[v];
+        }
+
+        snprintf (bmeta->percent_cover[t].description,
+            sizeof (bmeta->percent_cover[t].description), "%s",
+            type->description);
+        bmeta->percent_cover[t].percent = (ntotal > 0) ?
+            (float) (100.0 * ntype / ntotal) : 0.0;
+    }
+
+    free_raw_binary_cover (cover);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: free_raw_binary_cover
+
+PURPOSE: Releases the memory of the percent coverage accumulator.
+
+RETURN VALUE: N/A
+
+NOTES:
+*****************************************************************************/
+void free_raw_binary_cover
+(
+    Raw_binary_cover_t *cover    /* I/O: percent coverage accumulator */
+)
+{
+    free (cover->counts);
+    cover->counts = NULL;
+    free (cover->types);
+    cover->types = NULL;
+    cover->ntypes = 0;
+}
@@ -0,0 +1,93 @@
+/*****************************************************************************
+FILE: raw_binary_cover.h
+
+PURPOSE: Contains defines, structures, and prototypes for accumulating the
+percent coverage of the classes or QA bits of a raw binary band while it's
+written.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cover types come from the band metadata: one per class of a band
+     with class_values, or else one per single-bit field of a band with a
+     bitmap_description.  The percentages are of the non-fill pixels.
+  2. The pixel values are counted a block of pixels at a time, so the band
+     doesn't have to be read again to compute the percentages.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_COVER_H
+#define RAW_BINARY_COVER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Cover type counted for a band; a pixel is of the type if its value and
+   the mask equal the value of the type */
+typedef struct {
+    const char *description;    /* description of the cover type, from the
+                                   band metadata */
+    long mask;                  /* bits of the pixel value compared */
+    long value;                 /* value of the compared bits */
+} Raw_binary_cover_type_t;
+
+/* Pixel counts accumulated so far for a band */
+typedef struct {
+    enum Espa_data_type data_type;  /* data type of the band */
+    int nbytes;                 /* number of bytes per pixel */
+    bool use_fill;              /* does the band have a fill value? */
+    long fill_value;            /* fill value of the band */
+    long offset;                /* pixel value of the first count (the
+                                   lowest value of the data type) */
+    int nvalues;                /* number of pixel values counted */
+    long *counts;               /* number of pixels of each value */
+    int ntypes;                 /* number of cover types */
+    Raw_binary_cover_type_t *types;  /* cover types of the band */
+} Raw_binary_cover_t;
+
+/* Prototypes */
+bool use_raw_binary_cover ();
+
+int get_raw_binary_cover_types
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata; provides the classes
+                                       or the bitmap_description */
+    Raw_binary_cover_type_t *types  /* O: cover types of the band (NULL to
+                                       only count them); sized for nclass or
+                                       nbits types */
+);
+
+int init_raw_binary_cover
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata; provides the data
+                                       type, fill value, and cover types */
+    Raw_binary_cover_t *cover    /* O: percent coverage accumulator */
+);
+
+void accumulate_raw_binary_cover
+(
+    Raw_binary_cover_t *cover,   /* I/O: percent coverage accumulator */
+    const void *img_array,       /* I: block of pixels of the band's data
+                                       type */
+    size_t npixels               /* I: number of pixels in img_array */
+);
+
+int finish_raw_binary_cover
+(
+    Raw_binary_cover_t *cover,   /* I/O: percent coverage accumulator; its
+                                       memory is released */
+    Espa_band_meta_t *bmeta      /* O: band metadata; percent_cover and
+                                       ncover are set */
+);
+
+void free_raw_binary_cover
+(
+    Raw_binary_cover_t *cover    /* I/O: percent coverage accumulator */
+);
+
+#endif
@@ -0,0 +1,1007 @@
+/*****************************************************************************
+FILE: raw_binary_derived.c
+  
+PURPOSE: Contains functions for computing derived bands, either lazily when
+they're read or materialized in one pass for several bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_derived.h for the derived bands, and raw_binary_expr.h
+     for their expressions.
+  2. The pixels are computed RB_EXPR_VECTOR at a time.  A lazy band keeps
+     the last vector it computed, since the stdio stream reads it in pieces
+     which don't line up with the vectors.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "raw_binary_derived.h"
+#include "raw_binary_io.h"
+#include "espa_memory.h"
+#include "espa_tune.h"
+
+/* Lazy derived band opened for reading */
+struct raw_binary_derived
+{
+    char file_name[STR_SIZE];   /* name of the lazy derived band */
+    Raw_binary_derived_header_t header;  /* description of the band */
+    Raw_binary_derived_operand_t operand[RB_EXPR_MAX_OPERANDS]; /* bands used
+                                   by the expression */
+    Raw_binary_operands_t operands;  /* names of the bands used */
+    Raw_binary_expr_t expr;     /* compiled expression */
+    int nbytes;                 /* number of bytes per pixel */
+    int operand_nbytes[RB_EXPR_MAX_OPERANDS];  /* bytes per pixel of the
+                                   bands used */
+    FILE *operand_fptr[RB_EXPR_MAX_OPERANDS];  /* bands used; NULL until
+                                   opened */
+    void *raw;                  /* pixels of a band used, for one vector */
+    double *values[RB_EXPR_MAX_OPERANDS];  /* physical values of the bands
+                                   used, for one vector */
+    double *stack;              /* evaluation stack */
+    char *block;                /* computed pixels of the last vector */
+    off_t block_pixel;          /* first pixel of the last vector; -1 if
+                                   none has been computed */
+    off_t size;                 /* size of the band data */
+    off_t pos;                  /* current position of the stream */
+};
+
+
+/******************************************************************************
+MODULE: resolve_derived_operands
+
+PURPOSE: Finds the bands used by the derived band expressions in the product
+metadata.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        A band isn't in the product, or isn't the size of the derived
+             band
+SUCCESS      All the bands were found
+
+NOTES:
+*****************************************************************************/
+static int resolve_derived_operands
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata of the product */
+    Raw_binary_operands_t *operands, /* I: bands used by the expressions */
+    Espa_band_meta_t *bmeta,    /* I: band metadata of a derived band */
+    int *band_index             /* O: index in xml_meta of each band used */
+)
+{
+    char FUNC_NAME[] = "resolve_derived_operands"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i, j;                /* looping variables */
+
+    for (i = 0; i < operands->noperands; i++)
+    {
+        j = find_band_metadata (xml_meta, NULL, operands->name[i], NULL);
+        if (j < 0)
+        {
+            sprintf (errmsg, "Band %s of the expression of the derived "
+                "band %s isn't in the product.", operands->name[i],
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (xml_meta->band[j].nlines != bmeta->nlines ||
+            xml_meta->band[j].nsamps != bmeta->nsamps)
+        {
+            sprintf (errmsg, "Band %s isn't the same size as the derived "
+                "band %s.", operands->name[i], bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        band_index[i] = j;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_derived
+
+PURPOSE: Writes a lazy derived band, whose pixels are computed when it's
+read.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred compiling the expression or writing the band
+SUCCESS      Writing was successful
+
+NOTES:
+  1. The statistics and checksum of the band aren't computed.
+*****************************************************************************/
+int write_raw_binary_derived
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata of the product, providing
+                                      the bands used by the expression */
+    Espa_band_meta_t *bmeta     /* I: band metadata of the derived band;
+                                      provides the file name, size, scaling
+                                      and derived.expression */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_derived"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int band_index[RB_EXPR_MAX_OPERANDS];  /* bands used by the expression */
+    int i;                   /* looping variable */
+    FILE *fptr = NULL;       /* lazy derived band file */
+    Raw_binary_operands_t operands;     /* bands used by the expression */
+    Raw_binary_expr_t expr;             /* compiled expression */
+    Raw_binary_derived_header_t header; /* header of the file */
+    Raw_binary_derived_operand_t operand; /* band used, as stored */
+
+    operands.noperands = 0;
+    if (compile_raw_binary_expr (bmeta->derived.expression, &operands, &expr)
+        != SUCCESS ||
+        resolve_derived_operands (xml_meta, &operands, bmeta, band_index)
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, RB_DERIVED_MAGIC, sizeof (header.magic));
+    header.version = RB_DERIVED_VERSION;
+    header.nlines = bmeta->nlines;
+    header.nsamps = bmeta->nsamps;
+    header.noperands = operands.noperands;
+    get_raw_binary_scaling (bmeta, &header.scaling);
+    strcpy (header.expression, bmeta->derived.expression);
+
+    fptr = fopen (bmeta->file_name, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the derived band %s.", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (fwrite (&header, sizeof (header), 1, fptr) != 1)
+    {
+        fclose (fptr);
+        sprintf (errmsg, "Writing the derived band %s.", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < operands.noperands; i++)
+    {
+        memset (&operand, 0, sizeof (operand));
+        strcpy (operand.name, operands.name[i]);
+        strcpy (operand.file_name, xml_meta->band[band_index[i]].file_name);
+        get_raw_binary_scaling (&xml_meta->band[band_index[i]],
+            &operand.scaling);
+        if (fwrite (&operand, sizeof (operand), 1, fptr) != 1)
+        {
+            fclose (fptr);
+            sprintf (errmsg, "Writing the derived band %s.",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    if (fclose (fptr) != 0)
+    {
+        sprintf (errmsg, "Writing the derived band %s.", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    bmeta->derived.is_derived = true;
+    bmeta->stats.valid_pixels = ESPA_INT_META_FILL;
+    bmeta->stats.nbins = 0;
+    bmeta->checksum[0] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: materialize_raw_binary_derived
+
+PURPOSE: Computes the derived bands and writes their band data, in one pass
+over the bands they use.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred computing or writing the bands
+SUCCESS      Computing the bands was successful
+
+NOTES:
+  1. The bands used are read a block of lines at a time, once for all the
+     derived bands, and the block is evaluated RB_EXPR_VECTOR pixels at a
+     time for each derived band in turn, so the values of the bands used
+     stay in the cache.
+  2. The derived bands must all be the size of the bands they use.
+  3. The statistics, percent coverage, and checksum of the derived bands
+     are computed as they're written, if requested by their environment
+     variables.
+*****************************************************************************/
+int materialize_raw_binary_derived
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata of the product, providing
+                                      the bands used by the expressions */
+    int nbands,                 /* I: number of derived bands */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata of the derived bands;
+                                      provide the file name, size, scaling
+                                      and derived.expression */
+)
+{
+    char FUNC_NAME[] = "materialize_raw_binary_derived"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nlines = bmeta[0].nlines;   /* number of lines in the bands */
+    int nsamps = bmeta[0].nsamps;   /* number of samples in the bands */
+    int band_index[RB_EXPR_MAX_OPERANDS];  /* bands used by the expressions */
+    int in_nbytes[RB_EXPR_MAX_OPERANDS];   /* bytes per pixel of each band
+                                              used */
+    int *out_nbytes = NULL;  /* bytes per pixel of each derived band */
+    int block_lines;         /* number of lines in a block */
+    int nblock_lines;        /* number of lines in the current block */
+    int line;                /* current line */
+    int depth = 1;           /* largest evaluation stack of the
+                                expressions */
+    int status = ERROR;      /* return status */
+    int npix;                /* number of pixels in the current vector */
+    long pix;                /* first pixel of the current vector */
+    long block_pix;          /* number of pixels in the current block */
+    size_t line_bytes = 0;   /* bytes of the block buffers per line */
+    int i, b;                /* looping variables */
+    double *result = NULL;   /* values of a derived band for a vector */
+    double *values[RB_EXPR_MAX_OPERANDS];  /* physical values of each band
+                                              used, for a vector */
+    double *stack = NULL;    /* evaluation stack */
+    char *in_buf[RB_EXPR_MAX_OPERANDS];    /* block of each band used */
+    char **out_buf = NULL;   /* block of each derived band */
+    FILE *in_fptr[RB_EXPR_MAX_OPERANDS];   /* bands used */
+    Raw_binary_operands_t operands;     /* bands used by the expressions */
+    Raw_binary_expr_t *expr = NULL;     /* compiled expressions */
+    Raw_binary_scaling_t in_scaling[RB_EXPR_MAX_OPERANDS]; /* scaling of the
+                                           bands used */
+    Raw_binary_scaling_t *out_scaling = NULL;  /* scaling of the derived
+                                           bands */
+    Raw_binary_writer_t *rbw = NULL;    /* writers of the derived bands */
+
+    for (i = 0; i < RB_EXPR_MAX_OPERANDS; i++)
+    {
+        values[i] = NULL;
+        in_buf[i] = NULL;
+        in_fptr[i] = NULL;
+    }
+
+    expr = calloc (nbands, sizeof (Raw_binary_expr_t));
+    out_nbytes = calloc (nbands, sizeof (int));
+    out_buf = calloc (nbands, sizeof (char *));
+    out_scaling = calloc (nbands, sizeof (Raw_binary_scaling_t));
+    rbw = calloc (nbands, sizeof (Raw_binary_writer_t));
+    if (expr == NULL || out_nbytes == NULL || out_buf == NULL ||
+        out_scaling == NULL || rbw == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the derived bands.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    for (b = 0; b < nbands; b++)
+        rbw[b].fd = -1;
+
+    /* Compile the expressions, sharing the bands they use */
+    operands.noperands = 0;
+    for (b = 0; b < nbands; b++)
+    {
+        if (bmeta[b].nlines != nlines || bmeta[b].nsamps != nsamps)
+        {
+            sprintf (errmsg, "Derived band %s isn't the same size as derived "
+                "band %s.", bmeta[b].name, bmeta[0].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (compile_raw_binary_expr (bmeta[b].derived.expression, &operands,
+            &expr[b]) != SUCCESS)
+        {
+            sprintf (errmsg, "Compiling the expression of derived band %s.",
+                bmeta[b].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (expr[b].depth > depth)
+            depth = expr[b].depth;
+        get_raw_binary_scaling (&bmeta[b], &out_scaling[b]);
+        out_nbytes[b] = get_data_type_size (bmeta[b].data_type);
+        if (out_nbytes[b] == ERROR)
+        {
+            sprintf (errmsg, "Unsupported data type for derived band %s.",
+                bmeta[b].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        line_bytes += (size_t) nsamps * out_nbytes[b];
+    }
+    if (resolve_derived_operands (xml_meta, &operands, &bmeta[0], band_index)
+        != SUCCESS)
+    {  /* Error messages already written */
+        goto cleanup;
+    }
+
+    /* Open the bands used */
+    for (i = 0; i < operands.noperands; i++)
+    {
+        get_raw_binary_scaling (&xml_meta->band[band_index[i]],
+            &in_scaling[i]);
+        in_nbytes[i] = get_data_type_size (in_scaling[i].data_type);
+        if (in_nbytes[i] == ERROR)
+        {
+            sprintf (errmsg, "Unsupported data type for band %s.",
+                operands.name[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        line_bytes += (size_t) nsamps * in_nbytes[i];
+
+        in_fptr[i] = open_raw_binary (xml_meta->band[band_index[i]].file_name,
+            "rb");
+        if (in_fptr[i] == NULL)
+        {
+            sprintf (errmsg, "Opening band %s.", operands.name[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    /* Open the derived bands */
+    for (b = 0; b < nbands; b++)
+    {
+        if (open_raw_binary_writer (bmeta[b].file_name,
+            get_raw_binary_cache_mode (), get_raw_binary_codec (), &rbw[b])
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to open the derived band file: %s",
+                bmeta[b].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        bmeta[b].derived.is_derived = true;
+        bmeta[b].stats.valid_pixels = ESPA_INT_META_FILL;
+        bmeta[b].stats.nbins = 0;
+        bmeta[b].checksum[0] = '\0';
+        if ((use_raw_binary_stats () &&
+             attach_raw_binary_stats (&rbw[b], &bmeta[b]) != SUCCESS) ||
+            (use_raw_binary_cover () &&
+             attach_raw_binary_cover (&rbw[b], &bmeta[b]) != SUCCESS))
+        {
+            sprintf (errmsg, "Unable to compute the statistics or percent "
+                "coverage of the %s band", bmeta[b].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        if (use_raw_binary_checksum ())
+            attach_raw_binary_checksum (&rbw[b], &bmeta[b]);
+    }
+
+    /* Allocate the block buffers and the vectors */
+    block_lines = espa_budget_lines (line_bytes, (operands.noperands + depth
+        + 1) * RB_EXPR_VECTOR * sizeof (double),
+        espa_tune_line_block (RB_DERIVED_BLOCK_LINES));
+    for (i = 0; i < operands.noperands; i++)
+    {
+        in_buf[i] = malloc ((size_t) block_lines * nsamps * in_nbytes[i]);
+        values[i] = malloc (RB_EXPR_VECTOR * sizeof (double));
+        if (in_buf[i] == NULL || values[i] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for band %s.",
+                operands.name[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    for (b = 0; b < nbands; b++)
+    {
+        out_buf[b] = malloc ((size_t) block_lines * nsamps * out_nbytes[b]);
+        if (out_buf[b] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for derived band %s.",
+                bmeta[b].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+    stack = malloc ((size_t) depth * RB_EXPR_VECTOR * sizeof (double));
+    if (stack == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the evaluation stack.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Compute the derived bands a block of lines at a time */
+    for (line = 0; line < nlines; line += block_lines)
+    {
+        nblock_lines = block_lines;
+        if (line + nblock_lines > nlines)
+            nblock_lines = nlines - line;
+        block_pix = (long) nblock_lines * nsamps;
+
+        for (i = 0; i < operands.noperands; i++)
+        {
+            if (read_raw_binary (in_fptr[i], nblock_lines, nsamps,
+                in_nbytes[i], in_buf[i]) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading band %s at line %d.",
+                    operands.name[i], line);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+        }
+
+        for (pix = 0; pix < block_pix; pix += RB_EXPR_VECTOR)
+        {
+            npix = RB_EXPR_VECTOR;
+            if (pix + npix > block_pix)
+                npix = block_pix - pix;
+
+            for (i = 0; i < operands.noperands; i++)
+                unpack_raw_binary_values (in_buf[i] + pix * in_nbytes[i],
+                    &in_scaling[i], npix, values[i]);
+
+            for (b = 0; b < nbands; b++)
+            {
+                result = evaluate_raw_binary_expr (&expr[b], values, npix,
+                    stack);
+                pack_raw_binary_values (result, &out_scaling[b], npix,
+                    out_buf[b] + pix * out_nbytes[b]);
+            }
+        }
+
+        for (b = 0; b < nbands; b++)
+        {
+            if (write_raw_binary_writer (&rbw[b], nblock_lines, nsamps,
+                out_nbytes[b], out_buf[b]) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing derived band %s at line %d.",
+                    bmeta[b].name, line);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+        }
+    }
+
+    status = SUCCESS;
+    for (b = 0; b < nbands; b++)
+    {
+        if (close_raw_binary_writer (&rbw[b]) != SUCCESS)
+        {
+            sprintf (errmsg, "Closing derived band %s.", bmeta[b].name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        rbw[b].fd = -1;
+    }
+
+cleanup:
+    for (i = 0; i < RB_EXPR_MAX_OPERANDS; i++)
+    {
+        if (in_fptr[i] != NULL)
+            close_raw_binary (in_fptr[i]);
+        free (in_buf[i]);
+        free (values[i]);
+    }
+    for (b = 0; b < nbands && rbw != NULL; b++)
+    {
+        if (rbw[b].fd != -1)
+            close_raw_binary_writer (&rbw[b]);
+        if (out_buf != NULL)
+            free (out_buf[b]);
+    }
+    free (stack);
+    free (expr);
+    free (out_nbytes);
+    free (out_buf);
+    free (out_scaling);
+    free (rbw);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_derived
+
+PURPOSE: Determines if the open band file is a lazy derived band.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file starts with the lazy derived band signature
+false        The file is a plain raw binary band (or can't be read)
+
+NOTES:
+  1. The file is read with pread, so the file position isn't changed.
+*****************************************************************************/
+bool is_raw_binary_derived
+(
+    int fd              /* I: file descriptor of the band file */
+)
+{
+    char magic[8];           /* signature at the start of the file */
+
+    if (pread (fd, magic, sizeof (magic), 0) != sizeof (magic))
+        return (false);
+
+    return (memcmp (magic, RB_DERIVED_MAGIC, sizeof (magic)) == 0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_derived
+
+PURPOSE: Opens a lazy derived band for reading, along with the bands it
+uses.
+ 
+RETURN VALUE:
+Type = Raw_binary_derived_t *
+Value        Description
+-----        -----------
+NULL         Error opening the band, or it isn't a valid lazy derived band
+non-NULL     Pointer to the opened lazy derived band
+
+NOTES:
+*****************************************************************************/
+Raw_binary_derived_t *open_raw_binary_derived
+(
+    char *infile        /* I: name of the lazy derived band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_derived"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char operand_file[STR_SIZE];  /* path of a band used */
+    char *cptr = NULL;       /* end of the directory of the derived band */
+    char *name = NULL;       /* file name of a band used */
+    int count;               /* number of chars copied in snprintf */
+    int i;                   /* looping variable */
+    bool valid;              /* is the file a valid lazy derived band? */
+    FILE *fptr = NULL;       /* lazy derived band file */
+    Raw_binary_derived_header_t *header = NULL;  /* contents of the file */
+    Raw_binary_derived_t *rbd = NULL;    /* lazy derived band */
+
+    rbd = calloc (1, sizeof (Raw_binary_derived_t));
+    if (rbd == NULL)
+    {
+        sprintf (errmsg, "Allocating the derived band structure for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (rbd->file_name, infile, sizeof (rbd->file_name) - 1);
+    rbd->block_pixel = -1;
+    header = &rbd->header;
+
+    fptr = fopen (infile, "rb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the derived band %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbd);
+        return (NULL);
+    }
+    valid = (fread (header, sizeof (*header), 1, fptr) == 1 &&
+        !memcmp (header->magic, RB_DERIVED_MAGIC, sizeof (header->magic)) &&
+        header->version == RB_DERIVED_VERSION &&
+        header->noperands <= RB_EXPR_MAX_OPERANDS &&
+        fread (rbd->operand, sizeof (Raw_binary_derived_operand_t),
+            header->noperands, fptr) == header->noperands);
+    fclose (fptr);
+    header->expression[sizeof (header->expression) - 1] = '\0';
+
+    /* Compile the expression, with the bands in the order they're stored */
+    rbd->nbytes = get_data_type_size (header->scaling.data_type);
+    rbd->operands.noperands = 0;
+    for (i = 0; valid && i < (int) header->noperands; i++)
+    {
+        rbd->operand[i].name[STR_SIZE - 1] = '\0';
+        rbd->operand[i].file_name[STR_SIZE - 1] = '\0';
+        strcpy (rbd->operands.name[i], rbd->operand[i].name);
+        rbd->operand_nbytes[i] = get_data_type_size (
+            rbd->operand[i].scaling.data_type);
+        if (rbd->operand_nbytes[i] == ERROR)
+            valid = false;
+    }
+    rbd->operands.noperands = header->noperands;
+    if (!valid || rbd->nbytes == ERROR ||
+        compile_raw_binary_expr (header->expression, &rbd->operands,
+            &rbd->expr) != SUCCESS ||
+        rbd->operands.noperands != (int) header->noperands)
+    {
+        sprintf (errmsg, "%s isn't a valid derived band.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbd);
+        return (NULL);
+    }
+    rbd->size = (off_t) header->nlines * header->nsamps * rbd->nbytes;
+
+    rbd->raw = malloc (RB_EXPR_VECTOR * sizeof (double));
+    rbd->stack = malloc ((size_t) (rbd->expr.depth > 0 ? rbd->expr.depth : 1)
+        * RB_EXPR_VECTOR * sizeof (double));
+    rbd->block = malloc ((size_t) RB_EXPR_VECTOR * rbd->nbytes);
+    if (rbd->raw == NULL || rbd->stack == NULL || rbd->block == NULL)
+    {
+        sprintf (errmsg, "Allocating the buffers for %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_derived (rbd);
+        return (NULL);
+    }
+
+    /* Open the bands used, relative to the directory of the derived band */
+    cptr = strrchr (infile, '/');
+    for (i = 0; i < (int) header->noperands; i++)
+    {
+        name = rbd->operand[i].file_name;
+        if (name[0] == '/' || cptr == NULL)
+            count = snprintf (operand_file, sizeof (operand_file), "%s",
+                name);
+        else
+            count = snprintf (operand_file, sizeof (operand_file), "%.*s/%s",
+                (int) (cptr - infile), infile, name);
+        if (count < 0 || count >= sizeof (operand_file))
+        {
+            sprintf (errmsg, "Overflow of operand_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_derived (rbd);
+            return (NULL);
+        }
+
+        rbd->values[i] = malloc (RB_EXPR_VECTOR * sizeof (double));
+        rbd->operand_fptr[i] = open_raw_binary (operand_file, "rb");
+        if (rbd->values[i] == NULL || rbd->operand_fptr[i] == NULL)
+        {
+            sprintf (errmsg, "Opening band %s used by the derived band %s.",
+                operand_file, infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_derived (rbd);
+            return (NULL);
+        }
+    }
+
+    return (rbd);
+}
+
+
+/******************************************************************************
+MODULE: compute_derived_vector
+
+PURPOSE: Computes a vector of pixels of the lazy derived band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the bands used
+SUCCESS      Computing the pixels was successful
+
+NOTES:
+*****************************************************************************/
+static int compute_derived_vector
+(
+    Raw_binary_derived_t *rbd,  /* I/O: lazy derived band */
+    off_t pixel,        /* I: first pixel of the vector */
+    int npix            /* I: number of pixels in the vector */
+)
+{
+    char FUNC_NAME[] = "compute_derived_vector"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
+    double *result = NULL;   /* values of the derived band */
+
+    for (i = 0; i < rbd->operands.noperands; i++)
+    {
+        if (fseeko (rbd->operand_fptr[i], pixel * rbd->operand_nbytes[i],
+            SEEK_SET) != 0 ||
+            fread (rbd->raw, rbd->operand_nbytes[i], npix,
+            rbd->operand_fptr[i]) != (size_t) npix)
+        {
+            sprintf (errmsg, "Reading band %s used by the derived band %s.",
+                rbd->operand[i].name, rbd->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            rbd->block_pixel = -1;
+            return (ERROR);
+        }
+        unpack_raw_binary_values (rbd->raw, &rbd->operand[i].scaling, npix,
+            rbd->values[i]);
+    }
+
+    result = evaluate_raw_binary_expr (&rbd->expr, rbd->values, npix,
+        rbd->stack);
+    pack_raw_binary_values (result, &rbd->header.scaling, npix, rbd->block);
+    rbd->block_pixel = pixel;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_derived
+
+PURPOSE: Reads nbytes of band data at the specified offset of the lazy
+derived band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the data, or the data is beyond the
+             end of the band
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The pixels are computed a vector (RB_EXPR_VECTOR pixels, aligned to a
+     multiple of RB_EXPR_VECTOR) at a time.
+*****************************************************************************/
+int read_raw_binary_derived
+(
+    Raw_binary_derived_t *rbd,  /* I/O: lazy derived band */
+    off_t offset,       /* I: byte offset in the band to read from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_derived"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *out = buf;         /* current output location */
+    off_t pixel;             /* first pixel of the current vector */
+    off_t npix;              /* number of pixels in the current vector */
+    size_t within;           /* offset of the read in the current vector */
+    size_t ncopy;            /* number of bytes copied */
+
+    if (offset < 0 || offset + (off_t) nbytes > rbd->size)
+    {
+        sprintf (errmsg, "Reading %lu bytes at offset %ld is beyond the end "
+            "of the derived band %s.", (unsigned long) nbytes, (long) offset,
+            rbd->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (nbytes > 0)
+    {
+        pixel = offset / rbd->nbytes / RB_EXPR_VECTOR * RB_EXPR_VECTOR;
+        within = offset - pixel * rbd->nbytes;
+        npix = rbd->size / rbd->nbytes - pixel;
+        if (npix > RB_EXPR_VECTOR)
+            npix = RB_EXPR_VECTOR;
+
+        if (pixel != rbd->block_pixel &&
+            compute_derived_vector (rbd, pixel, (int) npix) != SUCCESS)
+            return (ERROR);
+
+        ncopy = (size_t) npix * rbd->nbytes - within;
+        if (ncopy > nbytes)
+            ncopy = nbytes;
+        memcpy (out, rbd->block + within, ncopy);
+
+        out += ncopy;
+        offset += ncopy;
+        nbytes -= ncopy;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_derived_size
+
+PURPOSE: Returns the size of the band data of the lazy derived band.
+ 
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+size         Number of bytes of band data
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_derived_size
+(
+    Raw_binary_derived_t *rbd   /* I: lazy derived band */
+)
+{
+    return (rbd->size);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_derived
+
+PURPOSE: Closes the lazy derived band and the bands it uses.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_derived
+(
+    Raw_binary_derived_t *rbd   /* I: lazy derived band to be closed */
+)
+{
+    int i;                   /* looping variable */
+
+    if (rbd == NULL)
+        return;
+
+    for (i = 0; i < RB_EXPR_MAX_OPERANDS; i++)
+    {
+        if (rbd->operand_fptr[i] != NULL)
+            close_raw_binary (rbd->operand_fptr[i]);
+        free (rbd->values[i]);
+    }
+    free (rbd->raw);
+    free (rbd->stack);
+    free (rbd->block);
+    free (rbd);
+}
+
+
+/******************************************************************************
+MODULE: derived_stream_read
+
+PURPOSE: Read function of the stdio stream for a lazy derived band.
+ 
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           An error occurred reading the band
+0            The end of the band was reached
+n            Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t derived_stream_read
+(
+    void *cookie,       /* I/O: lazy derived band */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    Raw_binary_derived_t *rbd = cookie;   /* lazy derived band */
+
+    if (rbd->pos >= rbd->size)
+        return (0);
+    if ((off_t) size > rbd->size - rbd->pos)
+        size = rbd->size - rbd->pos;
+
+    if (read_raw_binary_derived (rbd, rbd->pos, size, buf) != SUCCESS)
+        return (-1);
+    rbd->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: derived_stream_seek
+
+PURPOSE: Seek function of the stdio stream for a lazy derived band,
+positioning the stream in the band data.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The new position is invalid
+0            Seeking was successful
+
+NOTES:
+*****************************************************************************/
+static int derived_stream_seek
+(
+    void *cookie,       /* I/O: lazy derived band */
+    off64_t *offset,    /* I/O: requested offset; returns the new position */
+    int whence          /* I: SEEK_SET, SEEK_CUR, or SEEK_END */
+)
+{
+    Raw_binary_derived_t *rbd = cookie;   /* lazy derived band */
+    off64_t pos;             /* new position */
+
+    if (whence == SEEK_SET)
+        pos = *offset;
+    else if (whence == SEEK_CUR)
+        pos = rbd->pos + *offset;
+    else if (whence == SEEK_END)
+        pos = rbd->size + *offset;
+    else
+        return (-1);
+
+    if (pos < 0)
+        return (-1);
+    rbd->pos = pos;
+    *offset = pos;
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: derived_stream_close
+
+PURPOSE: Close function of the stdio stream for a lazy derived band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            Closing was successful
+
+NOTES:
+*****************************************************************************/
+static int derived_stream_close
+(
+    void *cookie        /* I: lazy derived band */
+)
+{
+    close_raw_binary_derived (cookie);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_derived_stream
+
+PURPOSE: Opens a lazy derived band as a read-only stdio stream of the band
+data, so it can be read with fread/fseek like a plain raw binary band.
+ 
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the lazy derived band
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. As with chunked bands (see open_raw_binary_chunked_stream), the stream
+     has a small (BUFSIZ) buffer, so large reads are handed to
+     read_raw_binary_derived in one piece.
+  2. The stream has no file descriptor; fileno returns -1.
+*****************************************************************************/
+FILE *open_raw_binary_derived_stream
+(
+    char *infile        /* I: name of the lazy derived band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_derived_stream"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* stream for the lazy derived band */
+    Raw_binary_derived_t *rbd = NULL;     /* lazy derived band */
+    cookie_io_functions_t funcs =         /* stream functions */
+        {derived_stream_read, NULL, derived_stream_seek,
+         derived_stream_close};
+
+    rbd = open_raw_binary_derived (infile);
+    if (rbd == NULL)
+        return (NULL);
+
+    fptr = fopencookie (rbd, "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for the derived band %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_derived (rbd);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, BUFSIZ);
+
+    return (fptr);
+}
@@ -0,0 +1,131 @@
+/*****************************************************************************
+FILE: raw_binary_derived.h
+  
+PURPOSE: Contains defines, structures, and prototypes for derived bands,
+which are computed from other bands of the product by a band-math
+expression.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A derived band (e.g. a spectral index such as the NDVI) is declared in
+     the band metadata by its expression (see Espa_derived_t and
+     raw_binary_expr.h), and is computed with its own data_type,
+     scale_factor, add_offset, and fill_value.
+  2. A derived band is either materialized, with its band data computed and
+     written by materialize_raw_binary_derived, or lazy.  The file of a lazy
+     band (written by write_raw_binary_derived) holds only the expression
+     and the file names and scaling of the bands it uses.  Its pixels are
+     computed when the band is read: lazy bands are read transparently by
+     open_raw_binary/read_raw_binary, read_raw_binary_window, and
+     open_raw_binary_mapped (which computes the band in memory), but can't
+     be opened for update.
+  3. materialize_raw_binary_derived computes any number of derived bands in
+     one pass, reading each band they use once.
+  4. The relative file names of the bands used by a lazy band are relative
+     to the directory of the lazy band, so they need to stay together.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_DERIVED_H
+#define RAW_BINARY_DERIVED_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_expr.h"
+
+/* Signature at the start of a lazy derived band file */
+#define RB_DERIVED_MAGIC "ESPADRV1"
+
+/* Version of the lazy derived band format */
+#define RB_DERIVED_VERSION 1
+
+/* Number of lines in a block of the fused computation of derived bands,
+   unless the node profile sets line_block (see espa_tune.h) */
+#define RB_DERIVED_BLOCK_LINES 256
+
+/* Band used by a lazy derived band, stored after its header */
+typedef struct
+{
+    char name[STR_SIZE];        /* name of the band in the expression */
+    char file_name[STR_SIZE];   /* file name of the band */
+    Raw_binary_scaling_t scaling;  /* scaling of the band */
+} Raw_binary_derived_operand_t;
+
+/* Header at the start of a lazy derived band file, in the native byte
+   order; followed by noperands Raw_binary_derived_operand_t */
+typedef struct
+{
+    char magic[8];              /* RB_DERIVED_MAGIC, not nul terminated */
+    uint32_t version;           /* RB_DERIVED_VERSION */
+    uint32_t nlines;            /* number of lines in the band */
+    uint32_t nsamps;            /* number of samples in the band */
+    uint32_t noperands;         /* number of bands used by the expression */
+    Raw_binary_scaling_t scaling;  /* scaling of the derived band */
+    char expression[STR_SIZE];  /* band-math expression */
+} Raw_binary_derived_header_t;
+
+/* Lazy derived band opened for reading; the contents are private */
+typedef struct raw_binary_derived Raw_binary_derived_t;
+
+/* Prototypes */
+int write_raw_binary_derived
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata of the product, providing
+                                      the bands used by the expression */
+    Espa_band_meta_t *bmeta     /* I: band metadata of the derived band;
+                                      provides the file name, size, scaling
+                                      and derived.expression */
+);
+
+int materialize_raw_binary_derived
+(
+    Espa_internal_meta_t *xml_meta, /* I: metadata of the product, providing
+                                      the bands used by the expressions */
+    int nbands,                 /* I: number of derived bands */
+    Espa_band_meta_t *bmeta     /* I/O: band metadata of the derived bands;
+                                      provide the file name, size, scaling
+                                      and derived.expression */
+);
+
+bool is_raw_binary_derived
+(
+    int fd              /* I: file descriptor of the band file */
+);
+
+Raw_binary_derived_t *open_raw_binary_derived
+(
+    char *infile        /* I: name of the lazy derived band to be opened */
+);
+
+int read_raw_binary_derived
+(
+    Raw_binary_derived_t *rbd,  /* I/O: lazy derived band */
+    off_t offset,       /* I: byte offset in the band to read from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+);
+
+off_t get_raw_binary_derived_size
+(
+    Raw_binary_derived_t *rbd   /* I: lazy derived band */
+);
+
+void close_raw_binary_derived
+(
+    Raw_binary_derived_t *rbd   /* I: lazy derived band to be closed */
+);
+
+FILE *open_raw_binary_derived_stream
+(
+    char *infile        /* I: name of the lazy derived band to be opened */
+);
+
+#endif
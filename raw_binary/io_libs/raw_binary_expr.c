@@ -0,0 +1,696 @@
+/*****************************************************************************
+FILE: raw_binary_expr.c
+  
+PURPOSE: Contains functions for compiling and evaluating the band-math
+expressions of derived bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_expr.h for the expression syntax.  The expressions are
+     parsed by recursive descent:
+       expr    := term { ("+" | "-") term }
+       term    := unary { ("*" | "/") unary }
+       unary   := "-" unary | primary
+       primary := number | name | name "(" expr { "," expr } ")" |
+                  "(" expr ")"
+*****************************************************************************/
+
+#include <ctype.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include "raw_binary_expr.h"
+
+/* State of the expression parser */
+typedef struct
+{
+    const char *expression;     /* expression being compiled */
+    const char *pos;            /* current position in the expression */
+    int stack;                  /* current depth of the evaluation stack */
+    Raw_binary_operands_t *operands;  /* bands used by the expression */
+    Raw_binary_expr_t *expr;    /* compiled expression */
+} Expr_parser_t;
+
+/* Functions of the expressions */
+static const struct
+{
+    const char *name;           /* name of the function */
+    int nargs;                  /* number of arguments */
+    Raw_binary_opcode_t opcode; /* operation */
+} expr_functions[] =
+{
+    {"abs", 1, RB_OP_ABS},
+    {"sqrt", 1, RB_OP_SQRT},
+    {"min", 2, RB_OP_MIN},
+    {"max", 2, RB_OP_MAX}
+};
+
+static int parse_expr (Expr_parser_t *parser);
+
+
+/******************************************************************************
+MODULE: expr_error
+
+PURPOSE: Reports an error at the current position of the expression.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Always
+
+NOTES:
+*****************************************************************************/
+static int expr_error
+(
+    Expr_parser_t *parser,      /* I: expression parser */
+    const char *problem         /* I: description of the error */
+)
+{
+    char FUNC_NAME[] = "compile_raw_binary_expr"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    snprintf (errmsg, sizeof (errmsg), "%s at character %d of the "
+        "expression: %.500s", problem,
+        (int) (parser->pos - parser->expression) + 1, parser->expression);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE: emit_op
+
+PURPOSE: Appends an operation to the compiled expression, tracking the depth
+of the evaluation stack.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The expression has too many operations
+SUCCESS      The operation was added
+
+NOTES:
+*****************************************************************************/
+static int emit_op
+(
+    Expr_parser_t *parser,      /* I/O: expression parser */
+    Raw_binary_opcode_t opcode, /* I: operation */
+    int operand,                /* I: index of the band for RB_OP_OPERAND */
+    double value                /* I: constant for RB_OP_CONST */
+)
+{
+    Raw_binary_expr_t *expr = parser->expr;   /* compiled expression */
+
+    if (expr->nops >= RB_EXPR_MAX_OPS)
+        return (expr_error (parser, "Too many operations"));
+
+    expr->op[expr->nops].opcode = opcode;
+    expr->op[expr->nops].operand = operand;
+    expr->op[expr->nops].value = value;
+    expr->nops++;
+
+    /* Pushes add to the stack, the two-argument operations take one off */
+    if (opcode == RB_OP_OPERAND || opcode == RB_OP_CONST)
+        parser->stack++;
+    else if (opcode != RB_OP_NEG && opcode != RB_OP_ABS &&
+        opcode != RB_OP_SQRT)
+        parser->stack--;
+    if (parser->stack > expr->depth)
+        expr->depth = parser->stack;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: skip_space
+
+PURPOSE: Skips white space in the expression and returns the next character.
+ 
+RETURN VALUE:
+Type = char
+Value        Description
+-----        -----------
+c            Next character of the expression; '\0' at the end
+
+NOTES:
+*****************************************************************************/
+static char skip_space
+(
+    Expr_parser_t *parser       /* I/O: expression parser */
+)
+{
+    while (isspace ((unsigned char) *parser->pos))
+        parser->pos++;
+    return (*parser->pos);
+}
+
+
+/******************************************************************************
+MODULE: parse_primary
+
+PURPOSE: Parses a number, band name, function call, or parenthesized
+expression.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Syntax error in the expression
+SUCCESS      Parsing was successful
+
+NOTES:
+*****************************************************************************/
+static int parse_primary
+(
+    Expr_parser_t *parser       /* I/O: expression parser */
+)
+{
+    Raw_binary_operands_t *operands = parser->operands;  /* bands used */
+    char name[STR_SIZE];     /* band or function name */
+    char *end = NULL;        /* end of a number */
+    const char *start = NULL;  /* start of a name */
+    double value;            /* value of a number */
+    size_t len;              /* length of a name */
+    int nargs;               /* number of function arguments */
+    int i;                   /* looping variable */
+    char c = skip_space (parser);  /* next character */
+
+    /* Parenthesized expression */
+    if (c == '(')
+    {
+        parser->pos++;
+        if (parse_expr (parser) != SUCCESS)
+            return (ERROR);
+        if (skip_space (parser) != ')')
+            return (expr_error (parser, "Missing )"));
+        parser->pos++;
+        return (SUCCESS);
+    }
+
+    /* Number */
+    if (isdigit ((unsigned char) c) || c == '.')
+    {
+        value = strtod (parser->pos, &end);
+        if (end == parser->pos)
+            return (expr_error (parser, "Invalid number"));
+        parser->pos = end;
+        return (emit_op (parser, RB_OP_CONST, -1, value));
+    }
+
+    if (!isalpha ((unsigned char) c) && c != '_')
+        return (expr_error (parser, c == '\0' ? "Unexpected end" :
+            "Unexpected character"));
+
+    /* Band or function name */
+    start = parser->pos;
+    while (isalnum ((unsigned char) *parser->pos) || *parser->pos == '_')
+        parser->pos++;
+    len = parser->pos - start;
+    if (len >= sizeof (name))
+        return (expr_error (parser, "Name too long"));
+    memcpy (name, start, len);
+    name[len] = '\0';
+
+    /* Function call */
+    if (skip_space (parser) == '(')
+    {
+        for (i = 0; i < (int) (sizeof (expr_functions) /
+            sizeof (expr_functions[0])); i++)
+        {
+            if (!strcmp (name, expr_functions[i].name))
+                break;
+        }
+        if (i == (int) (sizeof (expr_functions) / sizeof (expr_functions[0])))
+        {
+            parser->pos = start;
+            return (expr_error (parser, "Unknown function"));
+        }
+
+        parser->pos++;
+        nargs = 0;
+        do
+        {
+            if (nargs > 0)
+                parser->pos++;
+            if (parse_expr (parser) != SUCCESS)
+                return (ERROR);
+            nargs++;
+        } while (skip_space (parser) == ',');
+        if (*parser->pos != ')')
+            return (expr_error (parser, "Missing )"));
+        if (nargs != expr_functions[i].nargs)
+            return (expr_error (parser, "Wrong number of arguments"));
+        parser->pos++;
+        return (emit_op (parser, expr_functions[i].opcode, -1, 0.0));
+    }
+
+    /* Band, added to the operands if it's new */
+    for (i = 0; i < operands->noperands; i++)
+    {
+        if (!strcmp (name, operands->name[i]))
+            break;
+    }
+    if (i == operands->noperands)
+    {
+        if (operands->noperands >= RB_EXPR_MAX_OPERANDS)
+        {
+            parser->pos = start;
+            return (expr_error (parser, "Too many bands"));
+        }
+        strcpy (operands->name[operands->noperands++], name);
+    }
+    return (emit_op (parser, RB_OP_OPERAND, i, 0.0));
+}
+
+
+/******************************************************************************
+MODULE: parse_unary
+
+PURPOSE: Parses a negated or plain primary.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Syntax error in the expression
+SUCCESS      Parsing was successful
+
+NOTES:
+*****************************************************************************/
+static int parse_unary
+(
+    Expr_parser_t *parser       /* I/O: expression parser */
+)
+{
+    if (skip_space (parser) == '-')
+    {
+        parser->pos++;
+        if (parse_unary (parser) != SUCCESS)
+            return (ERROR);
+        return (emit_op (parser, RB_OP_NEG, -1, 0.0));
+    }
+
+    return (parse_primary (parser));
+}
+
+
+/******************************************************************************
+MODULE: parse_term
+
+PURPOSE: Parses a product or quotient of unaries.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Syntax error in the expression
+SUCCESS      Parsing was successful
+
+NOTES:
+*****************************************************************************/
+static int parse_term
+(
+    Expr_parser_t *parser       /* I/O: expression parser */
+)
+{
+    char c;                  /* operator */
+
+    if (parse_unary (parser) != SUCCESS)
+        return (ERROR);
+
+    while ((c = skip_space (parser)) == '*' || c == '/')
+    {
+        parser->pos++;
+        if (parse_unary (parser) != SUCCESS ||
+            emit_op (parser, c == '*' ? RB_OP_MUL : RB_OP_DIV, -1, 0.0)
+            != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: parse_expr
+
+PURPOSE: Parses a sum or difference of terms.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Syntax error in the expression
+SUCCESS      Parsing was successful
+
+NOTES:
+*****************************************************************************/
+static int parse_expr
+(
+    Expr_parser_t *parser       /* I/O: expression parser */
+)
+{
+    char c;                  /* operator */
+
+    if (parse_term (parser) != SUCCESS)
+        return (ERROR);
+
+    while ((c = skip_space (parser)) == '+' || c == '-')
+    {
+        parser->pos++;
+        if (parse_term (parser) != SUCCESS ||
+            emit_op (parser, c == '+' ? RB_OP_ADD : RB_OP_SUB, -1, 0.0)
+            != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: compile_raw_binary_expr
+
+PURPOSE: Compiles a band-math expression.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Syntax error in the expression, or it's too large
+SUCCESS      Compiling was successful
+
+NOTES:
+  1. Expressions compiled with the same operands share the bands they use,
+     so the bands are read once for all of them.
+*****************************************************************************/
+int compile_raw_binary_expr
+(
+    const char *expression,     /* I: expression to be compiled */
+    Raw_binary_operands_t *operands, /* I/O: bands used by the expression are
+                                      added if not already present */
+    Raw_binary_expr_t *expr     /* O: compiled expression */
+)
+{
+    Expr_parser_t parser;    /* expression parser */
+
+    parser.expression = expression;
+    parser.pos = expression;
+    parser.stack = 0;
+    parser.operands = operands;
+    parser.expr = expr;
+    expr->nops = 0;
+    expr->depth = 0;
+
+    if (parse_expr (&parser) != SUCCESS)
+        return (ERROR);
+    if (skip_space (&parser) != '\0')
+        return (expr_error (&parser, "Unexpected character"));
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: evaluate_raw_binary_expr
+
+PURPOSE: Evaluates a compiled expression for a vector of pixels.
+ 
+RETURN VALUE:
+Type = double *
+Value        Description
+-----        -----------
+result       Physical values of the expression for the pixels; this is the
+             bottom of the stack
+
+NOTES:
+  1. The values of each operand band are given by values[operand], for the
+     operands of the expression's compile_raw_binary_expr calls.
+*****************************************************************************/
+double *evaluate_raw_binary_expr
+(
+    const Raw_binary_expr_t *expr, /* I: compiled expression */
+    double **values,            /* I: physical values of each operand band */
+    int npix,                   /* I: number of pixels (up to
+                                      RB_EXPR_VECTOR) */
+    double *stack               /* I/O: evaluation stack of expr->depth *
+                                      RB_EXPR_VECTOR values */
+)
+{
+    int top = -1;            /* top of the stack */
+    int i, k;                /* looping variables */
+    double *x = NULL;        /* entry above y, for two-argument operations */
+    double *y = NULL;        /* top of the stack after the operation */
+    double value;            /* constant */
+
+    for (k = 0; k < expr->nops; k++)
+    {
+        /* The pushes add an entry y, the one-argument operations replace
+           the top entry y, and the two-argument operations combine the top
+           two entries x and y into y */
+        if (expr->op[k].opcode == RB_OP_OPERAND ||
+            expr->op[k].opcode == RB_OP_CONST)
+            top++;
+        else if (expr->op[k].opcode != RB_OP_NEG &&
+            expr->op[k].opcode != RB_OP_ABS && expr->op[k].opcode != RB_OP_SQRT)
+            top--;
+        y = stack + (size_t) top * RB_EXPR_VECTOR;
+        x = y + RB_EXPR_VECTOR;
+
+        switch (expr->op[k].opcode)
+        {
+            case RB_OP_OPERAND:
+                memcpy (y, values[expr->op[k].operand],
+                    npix * sizeof (double));
+                break;
+            case RB_OP_CONST:
+                value = expr->op[k].value;
+                for (i = 0; i < npix; i++)
+                    y[i] = value;
+                break;
+            case RB_OP_NEG:
+                for (i = 0; i < npix; i++)
+                    y[i] = -y[i];
+                break;
+            case RB_OP_ABS:
+                for (i = 0; i < npix; i++)
+                    y[i] = fabs (y[i]);
+                break;
+            case RB_OP_SQRT:
+                for (i = 0; i < npix; i++)
+                    y[i] = sqrt (y[i]);
+                break;
+            case RB_OP_ADD:
+                for (i = 0; i < npix; i++)
+                    y[i] += x[i];
+                break;
+            case RB_OP_SUB:
+                for (i = 0; i < npix; i++)
+                    y[i] -= x[i];
+                break;
+            case RB_OP_MUL:
+                for (i = 0; i < npix; i++)
+                    y[i] *= x[i];
+                break;
+            case RB_OP_DIV:
+                for (i = 0; i < npix; i++)
+                    y[i] /= x[i];
+                break;
+            case RB_OP_MIN:
+                for (i = 0; i < npix; i++)
+                    y[i] = (x[i] < y[i] || isnan (x[i])) ? x[i] : y[i];
+                break;
+            case RB_OP_MAX:
+                for (i = 0; i < npix; i++)
+                    y[i] = (x[i] > y[i] || isnan (x[i])) ? x[i] : y[i];
+                break;
+        }
+    }
+
+    return (stack);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_scaling
+
+PURPOSE: Gets the scaling of a band from its metadata.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void get_raw_binary_scaling
+(
+    Espa_band_meta_t *bmeta,    /* I: band metadata */
+    Raw_binary_scaling_t *scaling  /* O: scaling of the band */
+)
+{
+    scaling->data_type = bmeta->data_type;
+    scaling->has_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    scaling->fill_value = bmeta->fill_value;
+    scaling->scale_factor = 1.0;
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        scaling->scale_factor = bmeta->scale_factor;
+    scaling->add_offset = 0.0;
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        scaling->add_offset = bmeta->add_offset;
+}
+
+
+/* Converts npix pixels of type TYPE in buf to physical values */
+#define UNPACK_VALUES(TYPE) \
+    { \
+        const TYPE *px = buf; \
+        for (i = 0; i < npix; i++) \
+            values[i] = (scaling->has_fill && px[i] == (TYPE) fill) ? NAN : \
+                px[i] * scale + offset; \
+    }
+
+/******************************************************************************
+MODULE: unpack_raw_binary_values
+
+PURPOSE: Converts the pixels of a band to their physical values.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Fill pixels are NaN.
+*****************************************************************************/
+void unpack_raw_binary_values
+(
+    const void *buf,            /* I: pixels of the band */
+    const Raw_binary_scaling_t *scaling,  /* I: scaling of the band */
+    int npix,                   /* I: number of pixels */
+    double *values              /* O: physical values; NaN for fill */
+)
+{
+    int i;                   /* looping variable */
+    double fill = scaling->fill_value;      /* fill value */
+    double scale = scaling->scale_factor;   /* scale factor */
+    double offset = scaling->add_offset;    /* offset */
+
+    switch (scaling->data_type)
+    {
+        case ESPA_INT8:
+            UNPACK_VALUES (int8_t);
+            break;
+        case ESPA_UINT8:
+            UNPACK_VALUES (uint8_t);
+            break;
+        case ESPA_INT16:
+            UNPACK_VALUES (int16_t);
+            break;
+        case ESPA_UINT16:
+            UNPACK_VALUES (uint16_t);
+            break;
+        case ESPA_INT32:
+            UNPACK_VALUES (int32_t);
+            break;
+        case ESPA_UINT32:
+            UNPACK_VALUES (uint32_t);
+            break;
+        case ESPA_FLOAT32:
+            UNPACK_VALUES (float);
+            break;
+        case ESPA_FLOAT64:
+            UNPACK_VALUES (double);
+            break;
+    }
+}
+
+
+/* Converts npix physical values to pixels of integer type TYPE in buf,
+   rounded and clamped to the range of the type */
+#define PACK_INTEGERS(TYPE, MIN, MAX) \
+    { \
+        TYPE *px = buf; \
+        double v; \
+        for (i = 0; i < npix; i++) \
+        { \
+            v = (values[i] - offset) / scale; \
+            if (!isfinite (v)) \
+                px[i] = (TYPE) fill; \
+            else \
+                px[i] = (TYPE) (v < (MIN) ? (MIN) : v > (MAX) ? (MAX) : \
+                    floor (v + 0.5)); \
+        } \
+    }
+
+/* Converts npix physical values to pixels of floating point type TYPE */
+#define PACK_FLOATS(TYPE) \
+    { \
+        TYPE *px = buf; \
+        double v; \
+        for (i = 0; i < npix; i++) \
+        { \
+            v = (values[i] - offset) / scale; \
+            px[i] = isfinite (v) ? (TYPE) v : (TYPE) fill; \
+        } \
+    }
+
+/******************************************************************************
+MODULE: pack_raw_binary_values
+
+PURPOSE: Converts physical values to the pixels of a band.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. Values which aren't finite (fill or invalid) are set to the fill value,
+     or to 0 if the band has no fill value.
+  2. Values for the integer data types are rounded and clamped to the range
+     of the type.
+*****************************************************************************/
+void pack_raw_binary_values
+(
+    const double *values,       /* I: physical values; non-finite for fill */
+    const Raw_binary_scaling_t *scaling,  /* I: scaling of the band */
+    int npix,                   /* I: number of pixels */
+    void *buf                   /* O: pixels of the band */
+)
+{
+    int i;                   /* looping variable */
+    double fill = scaling->has_fill ? scaling->fill_value : 0.0;  /* fill */
+    double scale = scaling->scale_factor;   /* scale factor */
+    double offset = scaling->add_offset;    /* offset */
+
+    switch (scaling->data_type)
+    {
+        case ESPA_INT8:
+            PACK_INTEGERS (int8_t, INT8_MIN, INT8_MAX);
+            break;
+        case ESPA_UINT8:
+            PACK_INTEGERS (uint8_t, 0, UINT8_MAX);
+            break;
+        case ESPA_INT16:
+            PACK_INTEGERS (int16_t, INT16_MIN, INT16_MAX);
+            break;
+        case ESPA_UINT16:
+            PACK_INTEGERS (uint16_t, 0, UINT16_MAX);
+            break;
+        case ESPA_INT32:
+            PACK_INTEGERS (int32_t, INT32_MIN, INT32_MAX);
+            break;
+        case ESPA_UINT32:
+            PACK_INTEGERS (uint32_t, 0, UINT32_MAX);
+            break;
+        case ESPA_FLOAT32:
+            PACK_FLOATS (float);
+            break;
+        case ESPA_FLOAT64:
+            PACK_FLOATS (double);
+            break;
+    }
+}
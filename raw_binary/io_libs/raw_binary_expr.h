@@ -0,0 +1,133 @@
+/*****************************************************************************
+FILE: raw_binary_expr.h
+  
+PURPOSE: Contains defines, structures, and prototypes for compiling and
+evaluating the band-math expressions of derived bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. An expression is made of band names (the name of a band in the XML,
+     e.g. sr_band4), numbers, the operators + - * / and parentheses, and
+     the functions abs(x), sqrt(x), min(x, y), and max(x, y).  For example
+     the NDVI of Landsat 8 is (sr_band5 - sr_band4) / (sr_band5 + sr_band4).
+  2. The bands are used as their physical values (scale_factor and
+     add_offset applied).  Their fill pixels are NaN, which propagates
+     through the operators, so a result is fill if any of the bands it uses
+     is fill, or if it isn't finite (e.g. division by zero).
+  3. The expression is compiled to a short program which is evaluated on
+     vectors of RB_EXPR_VECTOR pixels, with one tight loop per operation
+     which the compiler can vectorize.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_EXPR_H
+#define RAW_BINARY_EXPR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Most distinct bands used by the expressions compiled together */
+#define RB_EXPR_MAX_OPERANDS 16
+
+/* Most operations in a compiled expression */
+#define RB_EXPR_MAX_OPS 64
+
+/* Number of pixels evaluated at a time */
+#define RB_EXPR_VECTOR 1024
+
+/* Operations of a compiled expression */
+typedef enum
+{
+    RB_OP_OPERAND,      /* push the values of a band */
+    RB_OP_CONST,        /* push a constant */
+    RB_OP_NEG,
+    RB_OP_ADD,
+    RB_OP_SUB,
+    RB_OP_MUL,
+    RB_OP_DIV,
+    RB_OP_ABS,
+    RB_OP_SQRT,
+    RB_OP_MIN,
+    RB_OP_MAX
+} Raw_binary_opcode_t;
+
+typedef struct
+{
+    Raw_binary_opcode_t opcode; /* operation */
+    int operand;                /* index of the band for RB_OP_OPERAND */
+    double value;               /* constant for RB_OP_CONST */
+} Raw_binary_op_t;
+
+/* Compiled expression; the operations are in postfix order */
+typedef struct
+{
+    int nops;                   /* number of operations */
+    Raw_binary_op_t op[RB_EXPR_MAX_OPS];  /* operations */
+    int depth;                  /* largest depth of the evaluation stack */
+} Raw_binary_expr_t;
+
+/* Bands used by one or more compiled expressions */
+typedef struct
+{
+    int noperands;              /* number of bands */
+    char name[RB_EXPR_MAX_OPERANDS][STR_SIZE];  /* band names */
+} Raw_binary_operands_t;
+
+/* Conversion between the pixels of a band and their physical values.  The
+   fields are of fixed size so it can be stored in a derived band file. */
+typedef struct
+{
+    int32_t data_type;          /* enum Espa_data_type of the pixels */
+    int32_t has_fill;           /* does the band have a fill value? */
+    double fill_value;          /* fill value of the pixels */
+    double scale_factor;        /* scale factor; 1 if the band has none */
+    double add_offset;          /* offset; 0 if the band has none */
+} Raw_binary_scaling_t;
+
+/* Prototypes */
+int compile_raw_binary_expr
+(
+    const char *expression,     /* I: expression to be compiled */
+    Raw_binary_operands_t *operands, /* I/O: bands used by the expression are
+                                      added if not already present */
+    Raw_binary_expr_t *expr     /* O: compiled expression */
+);
+
+double *evaluate_raw_binary_expr
+(
+    const Raw_binary_expr_t *expr, /* I: compiled expression */
+    double **values,            /* I: physical values of each operand band */
+    int npix,                   /* I: number of pixels (up to
+                                      RB_EXPR_VECTOR) */
+    double *stack               /* I/O: evaluation stack of expr->depth *
+                                      RB_EXPR_VECTOR values */
+);
+
+void get_raw_binary_scaling
+(
+    Espa_band_meta_t *bmeta,    /* I: band metadata */
+    Raw_binary_scaling_t *scaling  /* O: scaling of the band */
+);
+
+void unpack_raw_binary_values
+(
+    const void *buf,            /* I: pixels of the band */
+    const Raw_binary_scaling_t *scaling,  /* I: scaling of the band */
+    int npix,                   /* I: number of pixels */
+    double *values              /* O: physical values; NaN for fill */
+);
+
+void pack_raw_binary_values
+(
+    const double *values,       /* I: physical values; non-finite for fill */
+    const Raw_binary_scaling_t *scaling,  /* I: scaling of the band */
+    int npix,                   /* I: number of pixels */
+    void *buf                   /* O: pixels of the band */
+);
+
+#endif
@@ -12,7 +12,28 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 *****************************************************************************/
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "raw_binary_io.h"
+#include "raw_binary_pool.h"
+#include "raw_binary_tiff.h"
+#include "raw_binary_constant.h"
+#include "raw_binary_derived.h"
+#include "raw_binary_tiled.h"
+#include "raw_binary_s3.h"
+#include "raw_binary_pipe.h"
+#include "raw_binary_shm.h"
+#include "espa_profile.h"
+#include "espa_probe.h"
+#include "espa_io_limit.h"
+#include "espa_tune.h"
 
 /* define the read/write formats to be used for opening a file */
 typedef enum {
@@ -22,6 +43,104 @@ typedef enum {
 } Raw_binary_format_t;
 const char raw_binary_format[][4] = {"rb", "wb", "rb+"};
 
+/* define the encoded bands which are decoded rather than mapped */
+typedef enum {
+  RB_CHUNKED,
+  RB_TIFF,
+  RB_CONSTANT,
+  RB_DERIVED,
+  RB_TILED,
+} Raw_binary_encoding_t;
+static const char raw_binary_encoding[][21] = {"compressed (chunked)",
+    "GeoTIFF", "constant", "derived", "tiled"};
+
+/* define the state of the files opened by open_raw_binary, kept by file
+   descriptor and resolved once when the file is opened (see
+   get_raw_binary_fd_state) */
+#define RB_FD_STATE_SIZE 4096
+#define RB_FD_OPEN 0x01        /* the file was opened by open_raw_binary */
+#define RB_FD_HOLES 0x02       /* the file may have holes to be skipped */
+#define RB_FD_SPARSE 0x04      /* zero fill is left as holes when written */
+#define RB_FD_PREFETCH 0x08    /* the file is read ahead as it's read */
+static unsigned char raw_binary_fd_state[RB_FD_STATE_SIZE];
+
+/* sparse mode requested in the environment, read once */
+static pthread_once_t sparse_mode_once = PTHREAD_ONCE_INIT;
+static bool sparse_mode = false;
+
+
+/******************************************************************************
+MODULE: resolve_raw_binary_fd_state
+
+PURPOSE: Determines how a raw binary file is read and written: whether it
+may have holes, whether zero fill written to it is left as holes, and
+whether it's read ahead.
+ 
+RETURN VALUE:
+Type = unsigned char
+Value        Description
+-----        -----------
+other        RB_FD_* flags of the file, without RB_FD_OPEN
+
+NOTES:
+  1. A file may have holes if it's a regular file with fewer blocks
+     allocated than its size.  Any other file is read as a single run of
+     data.
+*****************************************************************************/
+static unsigned char resolve_raw_binary_fd_state
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    bool reading        /* I: is the file opened for reading? */
+)
+{
+    struct stat st;          /* status of the file */
+    unsigned char state = 0; /* state of the file */
+
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode))
+        return (state);
+
+    if ((off_t) st.st_blocks * 512 < st.st_size)
+        state |= RB_FD_HOLES;
+    if (get_raw_binary_sparse_mode ())
+        state |= RB_FD_SPARSE;
+    if (reading)
+        state |= RB_FD_PREFETCH;
+
+    return (state);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_fd_state
+
+PURPOSE: Returns the state of a raw binary file resolved by open_raw_binary.
+ 
+RETURN VALUE:
+Type = unsigned char
+Value        Description
+-----        -----------
+other        RB_FD_* flags of the file
+
+NOTES:
+  1. A file which wasn't opened by open_raw_binary, or whose file
+     descriptor is past the table, is resolved on each call instead.
+  2. The state is only used to skip work, so a stale entry of a file
+     closed without close_raw_binary costs at most a wasted check; holes
+     are read as zeros and zero fill is written either way.
+*****************************************************************************/
+static unsigned char get_raw_binary_fd_state
+(
+    int fd              /* I: file descriptor of the raw binary file, or -1 */
+)
+{
+    if (fd < 0)
+        return (0);
+    if (fd < RB_FD_STATE_SIZE && (raw_binary_fd_state[fd] & RB_FD_OPEN))
+        return (raw_binary_fd_state[fd]);
+
+    return (resolve_raw_binary_fd_state (fd, true));
+}
+
 /******************************************************************************
 MODULE: open_raw_binary
 
@@ -35,6 +154,26 @@ NULL         Error opening the specified file for read specified access
 non-NULL     FILE pointer to the opened file
 
 NOTES:
+  1. A compressed (chunked) band opened for reading returns a stream of the
+     uncompressed band data, so it's read the same as a plain band.
+  2. Likewise a GeoTIFF band of a virtual product (see raw_binary_tiff.h)
+     returns a stream of the decoded band data, and a constant band (see
+     raw_binary_constant.h) a stream of its generated pixels.  A lazy
+     derived band (see raw_binary_derived.h) returns a stream of its pixels
+     computed from the bands it uses.
+  3. A tiled band (see raw_binary_tiled.h) returns a stream of its pixels in
+     line-major order.
+  4. A band named by an s3:// URL is an object in an S3-compatible store
+     (see raw_binary_s3.h), opened as a stream which reads it with ranged
+     GETs or writes it as a multipart upload.
+  5. A band named "-" or a FIFO is the next band of a band stream (see
+     raw_binary_pipe.h), opened as a stream of the band data on the pipe.
+  6. If the bands are kept in shared memory (see raw_binary_shm.h), a band
+     written is created as a segment when there's room, and a band with a
+     segment is read or updated from it.
+  7. Whether the file may have holes, and whether zero fill written to it
+     is left as holes, are resolved here once rather than on each read or
+     write (see get_raw_binary_fd_state).
 *****************************************************************************/
 FILE *open_raw_binary
 (
@@ -47,9 +186,54 @@ FILE *open_raw_binary
     char FUNC_NAME[] = "open_raw_binary"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
     FILE *rb_fptr = NULL;    /* pointer to the raw binary file */
+    int shm_fd = -1;         /* file descriptor of a shared memory band */
+
+    /* Objects are read and written through a stream of requests to the
+       store */
+    if (is_raw_binary_s3_url (infile))
+    {
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is an object and can't be "
+                "opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_s3_stream (infile,
+            (access_type[0] == 'r') ? "rb" : "wb");
+    }
+
+    /* Bands on pipes are read and written in order through the band
+       stream */
+    if (is_raw_binary_pipe (infile))
+    {
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is a pipe and can't be "
+                "opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_pipe (infile,
+            (access_type[0] == 'r') ? "rb" : "wb", NULL);
+    }
+
+    /* Bands kept in shared memory are opened from their segments */
+    if (access_type[0] == 'r')
+        shm_fd = open_raw_binary_shm (infile,
+            (strchr (access_type, '+') != NULL) ? O_RDWR : O_RDONLY);
+    else if (access_type[0] == 'w')
+        shm_fd = open_raw_binary_shm (infile, O_RDWR | O_CREAT | O_TRUNC);
 
     /* Open the file with the specified access type */
-    rb_fptr = fopen (infile, access_type);
+    if (shm_fd >= 0)
+    {
+        rb_fptr = fdopen (shm_fd, access_type);
+        if (rb_fptr == NULL)
+            close (shm_fd);
+    }
+    else
+        rb_fptr = fopen (infile, access_type);
     if (rb_fptr == NULL)
     {
         sprintf (errmsg, "Opening raw binary file %s with %s access.",
@@ -58,6 +242,92 @@ FILE *open_raw_binary
         return NULL;
     }
 
+    /* Chunked bands are read through a stream which decompresses them */
+    if (access_type[0] == 'r' && is_raw_binary_chunked (fileno (rb_fptr)))
+    {
+        fclose (rb_fptr);
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is a compressed (chunked) "
+                "band and can't be opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_chunked_stream (infile);
+    }
+
+    /* GeoTIFF bands are read through a stream which decodes them */
+    if (access_type[0] == 'r' && is_raw_binary_tiff (infile,
+        fileno (rb_fptr)))
+    {
+        fclose (rb_fptr);
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is a GeoTIFF band and "
+                "can't be opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_tiff_stream (infile);
+    }
+
+    /* Constant bands are read through a stream which generates them */
+    if (access_type[0] == 'r' && is_raw_binary_constant (fileno (rb_fptr)))
+    {
+        fclose (rb_fptr);
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is a constant band and "
+                "can't be opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_constant_stream (infile);
+    }
+
+    /* Lazy derived bands are read through a stream which computes them */
+    if (access_type[0] == 'r' && is_raw_binary_derived (fileno (rb_fptr)))
+    {
+        fclose (rb_fptr);
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is a derived band and "
+                "can't be opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_derived_stream (infile);
+    }
+
+    /* Tiled bands are read through a stream which untiles them */
+    if (access_type[0] == 'r' && is_raw_binary_tiled (fileno (rb_fptr)))
+    {
+        fclose (rb_fptr);
+        if (strchr (access_type, '+') != NULL)
+        {
+            sprintf (errmsg, "Raw binary file %s is a tiled band and can't "
+                "be opened for update.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return NULL;
+        }
+        return open_raw_binary_tiled_stream (infile);
+    }
+
+    /* Bands read from the start get a larger kernel read-ahead, and their
+       first window is requested now */
+    if (access_type[0] == 'r')
+    {
+        posix_fadvise (fileno (rb_fptr), 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise (fileno (rb_fptr), 0, RB_PREFETCH_SIZE,
+            POSIX_FADV_WILLNEED);
+    }
+
+    /* Resolve how the file is read and written */
+    if (fileno (rb_fptr) >= 0 && fileno (rb_fptr) < RB_FD_STATE_SIZE)
+        raw_binary_fd_state[fileno (rb_fptr)] = RB_FD_OPEN |
+            resolve_raw_binary_fd_state (fileno (rb_fptr),
+            access_type[0] == 'r');
+
     /* Return the file pointer */
     return rb_fptr;
 }
@@ -78,10 +348,232 @@ void close_raw_binary
     FILE *fptr      /* I: pointer to raw binary file to be closed */
 )
 {
+    int fd = fileno (fptr);  /* file descriptor of the file, or -1 */
+
+    complete_raw_binary_shm (fd);
+    if (fd >= 0 && fd < RB_FD_STATE_SIZE)
+        raw_binary_fd_state[fd] = 0;
     fclose (fptr);
 }
 
 
+/******************************************************************************
+MODULE: is_zero_block
+
+PURPOSE: Determines whether a block of data is all zero.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         All the bytes of the block are zero
+false        The block has a non-zero byte
+
+NOTES:
+*****************************************************************************/
+static bool is_zero_block
+(
+    const char *data,   /* I: block of data */
+    size_t nbytes       /* I: number of bytes in the block (> 0) */
+)
+{
+    return (data[0] == 0 && memcmp (data, data + 1, nbytes - 1) == 0);
+}
+
+
+/******************************************************************************
+MODULE: get_fill_run
+
+PURPOSE: Returns the length of the run at the start of the data to be
+written which is either whole blocks of zero fill, to be left as a hole, or
+data to be written.
+ 
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+other        Number of bytes in the run
+
+NOTES:
+  1. The blocks are RB_SPARSE_BLOCK bytes aligned to their offset in the
+     file.  A partial block at the start or the end of the data is a run of
+     its own, so the rest of the block can be written by the next call.
+*****************************************************************************/
+static size_t get_fill_run
+(
+    const char *data,   /* I: data to be written */
+    size_t nbytes,      /* I: number of bytes of data */
+    off_t offset,       /* I: file offset the data is written at */
+    bool *fill          /* O: is the run zero fill? */
+)
+{
+    size_t head;             /* bytes before the first whole block */
+    size_t nrun;             /* number of bytes in the run */
+
+    head = (RB_SPARSE_BLOCK - offset % RB_SPARSE_BLOCK) % RB_SPARSE_BLOCK;
+    if (head > 0 || nbytes < RB_SPARSE_BLOCK)
+    {
+        nrun = (head > 0 && head < nbytes) ? head : nbytes;
+        *fill = is_zero_block (data, nrun);
+        return (nrun);
+    }
+
+    *fill = is_zero_block (data, RB_SPARSE_BLOCK);
+    for (nrun = RB_SPARSE_BLOCK; nrun + RB_SPARSE_BLOCK <= nbytes;
+         nrun += RB_SPARSE_BLOCK)
+    {
+        if (is_zero_block (data + nrun, RB_SPARSE_BLOCK) != *fill)
+            break;
+    }
+
+    return (nrun);
+}
+
+
+/******************************************************************************
+MODULE: skip_fill_run
+
+PURPOSE: Leaves a run of zero fill in the file as a hole rather than
+writing it.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The file can't have holes; the run needs to be written
+SUCCESS      The run reads back as zeros
+
+NOTES:
+  1. Data already in the file over the run is deallocated, and the file is
+     extended over a run past its end, so a hole at the end of the file
+     doesn't shorten it.
+*****************************************************************************/
+static int skip_fill_run
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    off_t offset,       /* I: file offset of the run */
+    off_t nbytes        /* I: number of bytes in the run */
+)
+{
+    struct stat st;          /* status of the file */
+    off_t end = offset + nbytes;  /* file offset of the end of the run */
+
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode))
+        return (ERROR);
+
+    if (offset < st.st_size)
+    {
+#ifdef FALLOC_FL_PUNCH_HOLE
+        if (fallocate (fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+            ((end < st.st_size) ? end : st.st_size) - offset) != 0)
+            return (ERROR);
+#else
+        return (ERROR);
+#endif
+    }
+
+    if (end > st.st_size && ftruncate (fd, end) != 0)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: prefetch_raw_binary
+
+PURPOSE: Asks the kernel to read ahead the next window of a band, when a
+read of the band enters a new RB_PREFETCH_SIZE window.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The read cursor drives the read-ahead, so it follows each band even
+     when the lines of many bands are read in turn, which defeats the
+     kernel's own read-ahead heuristics.  The window after the current one
+     is requested with POSIX_FADV_WILLNEED, so the next lines are in the
+     page cache before they're read.
+  2. Only the first read of a window makes a request, so the cost is one
+     system call per RB_PREFETCH_SIZE bytes read.  Streams without a file
+     descriptor are left alone.
+*****************************************************************************/
+static void prefetch_raw_binary
+(
+    int fd,             /* I: file descriptor of the raw binary file, or -1 */
+    off_t offset,       /* I: file offset of the read */
+    size_t nbytes       /* I: number of bytes read */
+)
+{
+    off_t first;             /* window of the start of the read */
+    off_t last;              /* window of the end of the read */
+
+    if (fd == -1 || nbytes == 0)
+        return;
+
+    first = offset / RB_PREFETCH_SIZE;
+    last = (offset + (off_t) nbytes) / RB_PREFETCH_SIZE;
+    if (offset != 0 && first == last)
+        return;
+
+    posix_fadvise (fd, (last + 1) * RB_PREFETCH_SIZE, RB_PREFETCH_SIZE,
+        POSIX_FADV_WILLNEED);
+}
+
+
+/******************************************************************************
+MODULE: get_hole_run
+
+PURPOSE: Returns the length of the run of the file starting at offset which
+is either a hole or data.
+ 
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+other        Number of bytes in the run, at most nbytes
+
+NOTES:
+  1. Holes are found with SEEK_DATA/SEEK_HOLE.  The callers only look for
+     them in files which may have holes (see get_raw_binary_fd_state).
+  2. The file offset of fd is restored, so this can be used on the file of
+     a stream.
+*****************************************************************************/
+static size_t get_hole_run
+(
+    int fd,             /* I: file descriptor of the raw binary file */
+    off_t offset,       /* I: file offset of the run */
+    size_t nbytes,      /* I: number of bytes to be read */
+    bool *hole          /* O: is the run a hole? */
+)
+{
+    struct stat st;          /* status of the file */
+    off_t cur;               /* current file offset of fd */
+    off_t next;              /* file offset of the end of the run */
+
+    *hole = false;
+    cur = lseek (fd, 0, SEEK_CUR);
+    next = lseek (fd, offset, SEEK_DATA);
+    if (next == -1 && errno == ENXIO && fstat (fd, &st) == 0)
+        next = st.st_size;  /* the rest of the file is a hole, if the offset
+                               is inside it */
+    if (next > offset)
+        *hole = true;
+    else if (next == offset)
+        next = lseek (fd, offset, SEEK_HOLE);
+    lseek (fd, cur, SEEK_SET);
+
+    if (next <= offset)
+    {
+        *hole = false;
+        return (nbytes);
+    }
+
+    return (((size_t) (next - offset) < nbytes) ? (size_t) (next - offset) :
+        nbytes);
+}
+
+
 /******************************************************************************
 MODULE: write_raw_binary
 
@@ -95,6 +587,8 @@ ERROR        An error occurred writing data to the raw binary file
 SUCCESS      Writing was successful
 
 NOTES:
+  1. If sparse files are requested (see get_raw_binary_sparse_mode), whole
+     blocks of zero fill are left as holes in the file.
 *****************************************************************************/
 int write_raw_binary
 (
@@ -108,14 +602,52 @@ int write_raw_binary
 {
     char FUNC_NAME[] = "write_raw_binary"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int nvals;               /* number of values written to the file */
+    int fd = fileno (rb_fptr);  /* file descriptor of the file, or -1 */
+    const char *data = img_array;  /* data to be written */
+    size_t nbytes = (size_t) nlines * nsamps * size;  /* bytes to write */
+    size_t nwritten = 0;     /* number of bytes written so far */
+    size_t nrun;             /* number of bytes in the current run */
+    size_t nput;             /* number of bytes written of the run */
+    unsigned char state = get_raw_binary_fd_state (fd);  /* state of the
+                                                             file */
+    off_t offset = -1;       /* file offset of the data; -1 if the file
+                                isn't written sparse */
+    bool fill;               /* is the current run zero fill? */
+
+    if (state & RB_FD_SPARSE)
+        offset = ftello (rb_fptr);
+
+    /* Write the data to the raw binary file, skipping the zero fill */
+    while (nwritten < nbytes)
+    {
+        nrun = nbytes - nwritten;
+        fill = false;
+        if (offset != -1)
+            nrun = get_fill_run (data + nwritten, nrun, offset + nwritten,
+                &fill);
+        if (fill && fflush (rb_fptr) == 0 &&
+            skip_fill_run (fd, offset + nwritten, nrun) == SUCCESS &&
+            fseeko (rb_fptr, offset + nwritten + nrun, SEEK_SET) == 0)
+        {
+            /* The file now has a hole for its readers to skip */
+            if (fd < RB_FD_STATE_SIZE && (state & RB_FD_OPEN))
+                raw_binary_fd_state[fd] |= RB_FD_HOLES;
+            nwritten += nrun;
+            continue;
+        }
 
-    /* Write the data to the raw binary file */
-    nvals = fwrite (img_array, size, nlines * nsamps, rb_fptr);
-    if (nvals != nlines * nsamps)
+        espa_io_throttle (ESPA_IO_WRITE, nrun);
+        nput = fwrite (data + nwritten, 1, nrun, rb_fptr);
+        espa_profile_count_io (ESPA_PROFILE_WRITE, ESPA_PROFILE_STDIO, nput);
+        nwritten += nput;
+        if (nput != nrun)
+            break;
+    }
+    ESPA_PROBE3 (write__block, fd, nlines, (long long) nwritten);
+    if (nwritten != nbytes)
     {
-        sprintf (errmsg, "Writing %d elements of %d bytes in size to the "
-            "raw binary file.", nlines * nsamps, size);
+        sprintf (errmsg, "Writing %lld elements of %d bytes in size to the "
+            "raw binary file.", (long long) nlines * nsamps, size);
         error_handler (true, FUNC_NAME, errmsg);
         return ERROR;
     }
@@ -137,6 +669,11 @@ ERROR        An error occurred reading data from the raw binary file
 SUCCESS      Reading was successful
 
 NOTES:
+  1. Holes in a sparse file are returned as zeros without reading them (see
+     get_hole_run).  Files without holes are read without looking for them
+     (see get_raw_binary_fd_state).
+  2. The band is read ahead by RB_PREFETCH_SIZE windows as the reads move
+     through it (see prefetch_raw_binary).
 *****************************************************************************/
 int read_raw_binary
 (
@@ -151,14 +688,51 @@ int read_raw_binary
 {
     char FUNC_NAME[] = "read_raw_binary"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int nvals;               /* number of values read from the file */
+    int fd = fileno (rb_fptr);  /* file descriptor of the file, or -1 */
+    char *data = img_array;  /* data read */
+    size_t nbytes = (size_t) nlines * nsamps * size;  /* bytes to read */
+    size_t nread = 0;        /* number of bytes read so far */
+    size_t nrun;             /* number of bytes in the current run */
+    size_t ngot;             /* number of bytes read of the run */
+    unsigned char state = get_raw_binary_fd_state (fd);  /* state of the
+                                                             file */
+    off_t offset = -1;       /* file offset of the data; -1 if it isn't
+                                needed */
+    bool hole;               /* is the current run a hole? */
+
+    if (state & (RB_FD_HOLES | RB_FD_PREFETCH))
+        offset = ftello (rb_fptr);
+    if (state & RB_FD_PREFETCH)
+        prefetch_raw_binary (fd, offset, nbytes);
+
+    /* Read the data from the raw binary file, filling the holes with zeros */
+    while (nread < nbytes)
+    {
+        nrun = nbytes - nread;
+        hole = false;
+        if (offset != -1 && (state & RB_FD_HOLES))
+            nrun = get_hole_run (fd, offset + nread, nrun, &hole);
+        if (hole)
+        {
+            memset (data + nread, 0, nrun);
+            if (fseeko (rb_fptr, offset + nread + nrun, SEEK_SET) != 0)
+                break;
+            nread += nrun;
+            continue;
+        }
 
-    /* Read the data from the raw binary file */
-    nvals = fread (img_array, size, nlines * nsamps, rb_fptr);
-    if (nvals != nlines * nsamps)
+        espa_io_throttle (ESPA_IO_READ, nrun);
+        ngot = fread (data + nread, 1, nrun, rb_fptr);
+        espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_STDIO, ngot);
+        nread += ngot;
+        if (ngot != nrun)
+            break;
+    }
+    ESPA_PROBE3 (read__block, fd, nlines, (long long) nread);
+    if (nread != nbytes)
     {
-        sprintf (errmsg, "Reading %d elements of %d bytes in size from the "
-            "raw binary file.", nlines * nsamps, size);
+        sprintf (errmsg, "Reading %lld elements of %d bytes in size from "
+            "the raw binary file.", (long long) nlines * nsamps, size);
         error_handler (true, FUNC_NAME, errmsg);
         return ERROR;
     }
@@ -166,3 +740,2946 @@ int read_raw_binary
     return SUCCESS;
 }
 
+
+/******************************************************************************
+MODULE: pread_full
+
+PURPOSE: Reads nbytes at the specified offset of the file, continuing after
+short reads and interrupts.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred or the end of the file was reached
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Streams without a file descriptor (chunked bands) are read with fseeko
+     and fread instead.
+  2. Holes in a sparse file are returned as zeros without reading them.
+*****************************************************************************/
+static int pread_full
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    int fd,             /* I: file descriptor of the raw binary file, or -1 */
+    void *buf,          /* O: buffer of nbytes */
+    size_t nbytes,      /* I: number of bytes to read */
+    off_t offset        /* I: byte offset in the file to read from */
+)
+{
+    ssize_t nread;           /* number of bytes read by the current call */
+    size_t nrun;             /* number of bytes in the current run */
+    bool holes;              /* may the file have holes? */
+    bool hole = false;       /* is the current run a hole? */
+
+    if (fd == -1)
+    {
+        if (fseeko (rb_fptr, offset, SEEK_SET) != 0)
+            return (ERROR);
+        espa_io_throttle (ESPA_IO_READ, nbytes);
+        nread = fread (buf, 1, nbytes, rb_fptr);
+        espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_STDIO, nread);
+        return ((size_t) nread == nbytes ? SUCCESS : ERROR);
+    }
+
+    holes = (get_raw_binary_fd_state (fd) & RB_FD_HOLES) != 0;
+    while (nbytes > 0)
+    {
+        nrun = nbytes;
+        if (holes)
+            nrun = get_hole_run (fd, offset, nbytes, &hole);
+        if (hole)
+        {
+            memset (buf, 0, nrun);
+            buf = (char *) buf + nrun;
+            nbytes -= nrun;
+            offset += nrun;
+            continue;
+        }
+
+        espa_io_throttle (ESPA_IO_READ, nrun);
+        nread = pread (fd, buf, nrun, offset);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return (ERROR);
+        espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_POSIX, nread);
+
+        buf = (char *) buf + nread;
+        nbytes -= nread;
+        offset += nread;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: pick_window_lines
+
+PURPOSE: Copies the pixels of window lines out of a buffer holding the band
+bytes from the first window pixel of the first line to the last window
+pixel of the last line.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void pick_window_lines
+(
+    const char *staging, /* I: band bytes of the window lines */
+    int nread_lines,    /* I: number of window lines in staging */
+    int nsamps,         /* I: number of samples in a window line */
+    int stride,         /* I: step between the lines/samples read */
+    int nbytes,         /* I: number of bytes per pixel */
+    off_t pitch,        /* I: bytes between consecutive window lines */
+    char *out           /* O: output window lines */
+)
+{
+    int l, s;                /* looping variables */
+    size_t out_line = (size_t) nsamps * nbytes;  /* bytes in an output
+                                                    window line */
+    const char *src = NULL;  /* current pixel in the staging buffer */
+
+    for (l = 0; l < nread_lines; l++, out += out_line)
+    {
+        src = staging + l * pitch;
+        if (stride == 1)
+            memcpy (out, src, out_line);
+        else
+        {
+            for (s = 0; s < nsamps; s++, src += (size_t) stride * nbytes)
+                memcpy (out + (size_t) s * nbytes, src, nbytes);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: read_s3_window
+
+PURPOSE: Reads a window of a band stored as an object, fetching the reads
+of window lines as parallel ranged GETs.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the window
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The window lines are grouped into reads the same way as for a file
+     (rows_per_read lines per read), and up to RB_S3_MAX_REQUESTS reads are
+     fetched at a time.  Reads of contiguous lines go directly to the
+     output.
+*****************************************************************************/
+static int read_s3_window
+(
+    Espa_band_meta_t *bmeta, /* I: band metadata for the band being read */
+    int line0,          /* I: first line of the window (0-based) */
+    int samp0,          /* I: first sample of the window (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    int stride,         /* I: step between the lines/samples read */
+    int nbytes,         /* I: number of bytes per pixel */
+    int rows_per_read,  /* I: number of window lines per read */
+    void *img_array     /* O: array of nlines * nsamps pixels */
+)
+{
+    char FUNC_NAME[] = "read_s3_window"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int line;                /* first window line of the current batch */
+    int nruns;               /* number of reads in the current batch */
+    int r;                   /* looping variable for the reads */
+    int status = SUCCESS;    /* return status */
+    bool direct;             /* are the reads made into the output? */
+    off_t line_bytes = (off_t) bmeta->nsamps * nbytes;  /* bytes in a
+                                                            band line */
+    off_t pitch = line_bytes * stride;  /* bytes between window lines */
+    size_t span = ((size_t) (nsamps - 1) * stride + 1) * nbytes;  /* bytes
+                             of a band line covered by the window */
+    size_t out_line = (size_t) nsamps * nbytes;  /* bytes in an output
+                                                    window line */
+    size_t run_size = (rows_per_read - 1) * pitch + span;  /* bytes of a
+                                                              full read */
+    char *staging = NULL;    /* buffers for the reads of a batch */
+    char *out = img_array;   /* output line of the current batch */
+    off_t offset[RB_S3_MAX_REQUESTS];   /* object offset of each read */
+    size_t size[RB_S3_MAX_REQUESTS];    /* number of bytes of each read */
+    int nrows[RB_S3_MAX_REQUESTS];      /* window lines of each read */
+    void *buf[RB_S3_MAX_REQUESTS];      /* buffer of each read */
+    Raw_binary_s3_t *rbs = NULL;        /* object of the band */
+
+    rbs = open_raw_binary_s3 (bmeta->file_name, "rb");
+    if (rbs == NULL)
+    {
+        sprintf (errmsg, "Opening the object of band %s.", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    direct = (stride == 1 && rows_per_read == 1);
+    if (!direct)
+    {
+        staging = malloc (RB_S3_MAX_REQUESTS * run_size);
+        if (staging == NULL)
+        {
+            sprintf (errmsg, "Allocating the staging buffers for reading "
+                "band %s.", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_s3 (rbs);
+            return (ERROR);
+        }
+    }
+
+    for (line = 0; line < nlines && status == SUCCESS; )
+    {
+        /* Set up a batch of reads */
+        for (nruns = 0; nruns < RB_S3_MAX_REQUESTS && line < nlines;
+            nruns++)
+        {
+            nrows[nruns] = rows_per_read;
+            if (line + nrows[nruns] > nlines)
+                nrows[nruns] = nlines - line;
+            offset[nruns] = (line0 + (off_t) line * stride) * line_bytes +
+                (off_t) samp0 * nbytes;
+            size[nruns] = (nrows[nruns] - 1) * pitch + span;
+            buf[nruns] = direct ? out + (size_t) nruns * out_line :
+                staging + nruns * run_size;
+            line += nrows[nruns];
+        }
+
+        if (read_raw_binary_s3_ranges (rbs, nruns, offset, size, buf) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Reading window lines of band %s.",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        for (r = 0; r < nruns; r++)
+        {
+            if (!direct)
+                pick_window_lines (buf[r], nrows[r], nsamps, stride, nbytes,
+                    pitch, out);
+            out += nrows[r] * out_line;
+        }
+    }
+
+    free (staging);
+    close_raw_binary_s3 (rbs);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_window
+
+PURPOSE: Reads a window of nlines x nsamps pixels from the raw binary band,
+starting at line0/samp0 and taking every stride'th line and sample.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the window
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The window is read with pread and 64-bit offsets, so the current file
+     position and the stdio buffer of the FILE pointer aren't used.  Chunked
+     bands are read via their stream, which does move the position.
+  2. A stride of 1 reads a contiguous window; a stride of n sub-samples the
+     band the same way as a sub-sample factor of n, starting at line0/samp0.
+  3. Whole lines are read with a single pread.  Otherwise consecutive window
+     lines are coalesced into one pread of up to RB_WINDOW_STAGING_SIZE bytes
+     when the gap between them is no larger than the part that is needed;
+     sparser windows are read a line at a time.
+  4. The window of a tiled band (tagged with its tiling in the band
+     metadata) is read a row of tiles at a time, reading only the tiles the
+     window touches.
+  5. The window of a band stored as an object (see raw_binary_s3.h) is read
+     as parallel ranged GETs of only the window lines, grouped the same way
+     as for a file.
+*****************************************************************************/
+int read_raw_binary_window
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    Espa_band_meta_t *bmeta, /* I: band metadata for the band being read;
+                              provides the band size and data type */
+    int line0,          /* I: first line of the window (0-based) */
+    int samp0,          /* I: first sample of the window (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    int stride,         /* I: step between the lines/samples read; 1 for a
+                              contiguous window */
+    void *img_array     /* O: array of nlines * nsamps pixels of the band's
+                              data type (sufficient space should already have
+                              been allocated) */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_window"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int fd;                  /* file descriptor of the raw binary file */
+    int nbytes;              /* number of bytes per pixel */
+    int line;                /* current window line */
+    int nread_lines;         /* number of window lines in the current read */
+    int rows_per_read;       /* number of window lines per read */
+    off_t line_bytes;        /* number of bytes in a band line */
+    off_t pitch;             /* bytes between consecutive window lines */
+    off_t offset;            /* file offset of the current read */
+    size_t span;             /* bytes of a band line covered by the window */
+    size_t out_line;         /* bytes in an output window line */
+    char *staging = NULL;    /* buffer for coalesced or strided reads */
+    char *out = img_array;   /* current output line */
+    Raw_binary_tiled_t *rbt = NULL;  /* tiled band */
+
+    /* Validate the window against the band */
+    nbytes = get_data_type_size (bmeta->data_type);
+    if (nbytes == ERROR || stride < 1 || nlines < 1 || nsamps < 1 ||
+        line0 < 0 || samp0 < 0 ||
+        line0 + (long) (nlines - 1) * stride >= bmeta->nlines ||
+        samp0 + (long) (nsamps - 1) * stride >= bmeta->nsamps)
+    {
+        sprintf (errmsg, "Window of %d lines x %d samples at line %d, sample "
+            "%d with a stride of %d doesn't fit in band %s of %d lines x %d "
+            "samples.", nlines, nsamps, line0, samp0, stride, bmeta->name,
+            bmeta->nlines, bmeta->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fd = fileno (rb_fptr);
+    line_bytes = (off_t) bmeta->nsamps * nbytes;
+    pitch = line_bytes * stride;
+
+    /* Tiled bands are read by tile rather than through their line-major
+       stream */
+    if (fd == -1 && bmeta->tiling.is_tiled)
+    {
+        rbt = open_raw_binary_tiled (bmeta->file_name);
+        if (rbt == NULL || read_raw_binary_tiled_window (rbt, line0, samp0,
+            nlines, nsamps, stride, img_array) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading a window of the tiled band %s.",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_tiled (rbt);
+            return (ERROR);
+        }
+        close_raw_binary_tiled (rbt);
+        return (SUCCESS);
+    }
+
+    span = ((size_t) (nsamps - 1) * stride + 1) * nbytes;
+    out_line = (size_t) nsamps * nbytes;
+    ESPA_PROBE3 (read__block, fd, nlines, (long long) nlines * out_line);
+
+    /* Whole consecutive lines are read directly with a single read */
+    if (stride == 1 && samp0 == 0 && nsamps == bmeta->nsamps)
+    {
+        if (pread_full (rb_fptr, fd, img_array, (size_t) nlines * out_line,
+            line0 * line_bytes) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading %d lines at line %d of raw binary band "
+                "%s.", nlines, line0, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        return (SUCCESS);
+    }
+
+    /* Coalesce the window lines if the gaps between them are small */
+    rows_per_read = 1;
+    if (pitch - (off_t) span <= (off_t) span && pitch < RB_WINDOW_STAGING_SIZE)
+        rows_per_read = RB_WINDOW_STAGING_SIZE / pitch;
+    if (rows_per_read > nlines)
+        rows_per_read = nlines;
+
+    /* Objects are read with parallel requests rather than through their
+       stream */
+    if (fd == -1 && is_raw_binary_s3_url (bmeta->file_name))
+        return (read_s3_window (bmeta, line0, samp0, nlines, nsamps, stride,
+            nbytes, rows_per_read, img_array));
+
+    /* Contiguous samples read a line at a time go directly to the output */
+    if (stride > 1 || rows_per_read > 1)
+    {
+        staging = malloc ((rows_per_read - 1) * pitch + span);
+        if (staging == NULL)
+        {
+            sprintf (errmsg, "Allocating the staging buffer for reading "
+                "raw binary band %s.", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    for (line = 0; line < nlines; line += nread_lines)
+    {
+        nread_lines = rows_per_read;
+        if (line + nread_lines > nlines)
+            nread_lines = nlines - line;
+        offset = (line0 + (off_t) line * stride) * line_bytes +
+            (off_t) samp0 * nbytes;
+
+        if (pread_full (rb_fptr, fd, staging != NULL ? staging : out,
+            (nread_lines - 1) * pitch + span, offset) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading window line %d of raw binary band %s.",
+                line, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (staging);
+            return (ERROR);
+        }
+
+        if (staging == NULL)
+        {
+            out += out_line;
+            continue;
+        }
+
+        /* Pick the window pixels out of the staging buffer */
+        pick_window_lines (staging, nread_lines, nsamps, stride, nbytes,
+            pitch, out);
+        out += nread_lines * out_line;
+    }
+
+    free (staging);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: convert_to_double
+
+PURPOSE: Converts npix pixels of the ESPA data type to double.
+ 
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void convert_to_double
+(
+    enum Espa_data_type data_type, /* I: data type of the pixels */
+    const void *src,    /* I: pixels to be converted */
+    size_t npix,        /* I: number of pixels */
+    double *dst         /* O: converted pixels */
+)
+{
+    size_t i;           /* looping variable for the pixels */
+
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const int8_t *) src)[i];
+            break;
+        case ESPA_UINT8:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const uint8_t *) src)[i];
+            break;
+        case ESPA_INT16:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const int16_t *) src)[i];
+            break;
+        case ESPA_UINT16:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const uint16_t *) src)[i];
+            break;
+        case ESPA_INT32:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const int32_t *) src)[i];
+            break;
+        case ESPA_UINT32:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const uint32_t *) src)[i];
+            break;
+        case ESPA_FLOAT32:
+            for (i = 0; i < npix; i++)
+                dst[i] = ((const float *) src)[i];
+            break;
+        case ESPA_FLOAT64:
+            memcpy (dst, src, npix * sizeof (double));
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: store_from_double
+
+PURPOSE: Stores a pixel value in the ESPA data type, rounding it to the
+nearest integer for the integer data types.
+ 
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The interpolated values lie between the values they were interpolated
+     from, so they are within the range of the data type.
+*****************************************************************************/
+static void store_from_double
+(
+    enum Espa_data_type data_type, /* I: data type of the pixel */
+    void *dst,          /* O: array of pixels */
+    size_t indx,        /* I: index of the pixel in dst */
+    double value        /* I: value to be stored */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            ((int8_t *) dst)[indx] = (int8_t) lround (value);
+            break;
+        case ESPA_UINT8:
+            ((uint8_t *) dst)[indx] = (uint8_t) lround (value);
+            break;
+        case ESPA_INT16:
+            ((int16_t *) dst)[indx] = (int16_t) lround (value);
+            break;
+        case ESPA_UINT16:
+            ((uint16_t *) dst)[indx] = (uint16_t) lround (value);
+            break;
+        case ESPA_INT32:
+            ((int32_t *) dst)[indx] = (int32_t) llround (value);
+            break;
+        case ESPA_UINT32:
+            ((uint32_t *) dst)[indx] = (uint32_t) llround (value);
+            break;
+        case ESPA_FLOAT32:
+            ((float *) dst)[indx] = (float) value;
+            break;
+        case ESPA_FLOAT64:
+            ((double *) dst)[indx] = value;
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_upsampled
+
+PURPOSE: Reads a window of nlines x nsamps full resolution pixels from a
+sub-sampled raw binary band, bilinearly interpolating the sub-sampled pixels
+as they are read.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the window
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The window is in full resolution lines/samples (see the sub_sample of
+     the band metadata).  Pixel (l, s) of the sub-sampled band is pixel
+     (l * factor, s * factor) at full resolution, so those pixels are
+     returned as is and the ones in between are interpolated.  Pixels past
+     the last sub-sampled line/sample take the values of that line/sample.
+  2. If one of the sub-sampled pixels contributing to an output pixel is
+     fill, the nearest of the four is used instead of interpolating, so the
+     fill doesn't bleed into the valid pixels around it.
+  3. Only the sub-sampled pixels covering the window are read, via
+     read_raw_binary_window.  Bands which aren't sub-sampled are read
+     directly, so this routine can be used for any band.
+*****************************************************************************/
+int read_raw_binary_upsampled
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    Espa_band_meta_t *bmeta, /* I: band metadata for the band being read;
+                              provides the band size, data type, fill value
+                              and sub-sampling */
+    int line0,          /* I: first full resolution line of the window
+                              (0-based) */
+    int samp0,          /* I: first full resolution sample of the window
+                              (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    void *img_array     /* O: array of nlines * nsamps pixels of the band's
+                              data type (sufficient space should already have
+                              been allocated) */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_upsampled"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int factor = bmeta->sub_sample.factor;  /* sub-sampling factor */
+    int nbytes;              /* number of bytes per pixel */
+    int sub_line0;           /* first sub-sampled line of the window */
+    int sub_samp0;           /* first sub-sampled sample of the window */
+    int sub_nlines;          /* number of sub-sampled lines read */
+    int sub_nsamps;          /* number of sub-sampled samples read */
+    int row0, row1;          /* sub-sampled rows (relative to sub_line0)
+                                above and below the current output line */
+    int converted0 = -1;     /* row held in drow0; -1 if none */
+    int converted1 = -1;     /* row held in drow1; -1 if none */
+    int line, samp;          /* full resolution line/sample */
+    int l, s;                /* looping variables for the output window */
+    int k;                   /* looping variable for the neighbors */
+    int nearest;             /* nearest of the four neighbors */
+    bool use_fill;           /* does the band have a fill value? */
+    bool has_fill;           /* is a contributing neighbor fill? */
+    double fill;             /* fill value of the band */
+    double wl;               /* weight of the row below */
+    double v[4];             /* values of the four neighbors */
+    double w[4];             /* weights of the four neighbors */
+    double value;            /* interpolated value */
+    double *dtmp = NULL;     /* temporary for swapping the rows */
+    double *drow0 = NULL;    /* sub-sampled row above, as double */
+    double *drow1 = NULL;    /* sub-sampled row below, as double */
+    double *ws = NULL;       /* weight of the sample to the right for each
+                                output sample */
+    int *s0 = NULL;          /* sub-sampled sample (relative to sub_samp0) to
+                                the left of each output sample */
+    int *s1 = NULL;          /* sub-sampled sample to the right */
+    char *sub = NULL;        /* sub-sampled pixels covering the window */
+
+    /* Bands at full resolution are read directly */
+    if (factor <= 1)
+        return (read_raw_binary_window (rb_fptr, bmeta, line0, samp0,
+            nlines, nsamps, 1, img_array));
+
+    /* Validate the sub-sampling and the window against the band */
+    nbytes = get_data_type_size (bmeta->data_type);
+    if (nbytes == ERROR ||
+        (bmeta->sub_sample.nlines - 1) / factor + 1 != bmeta->nlines ||
+        (bmeta->sub_sample.nsamps - 1) / factor + 1 != bmeta->nsamps)
+    {
+        sprintf (errmsg, "Band %s of %d lines x %d samples isn't a "
+            "sub-sampling by %d of %d lines x %d samples.", bmeta->name,
+            bmeta->nlines, bmeta->nsamps, factor, bmeta->sub_sample.nlines,
+            bmeta->sub_sample.nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (nlines < 1 || nsamps < 1 || line0 < 0 || samp0 < 0 ||
+        line0 + (long) nlines > bmeta->sub_sample.nlines ||
+        samp0 + (long) nsamps > bmeta->sub_sample.nsamps)
+    {
+        sprintf (errmsg, "Window of %d lines x %d samples at line %d, sample "
+            "%d doesn't fit in the full resolution band %s of %d lines x %d "
+            "samples.", nlines, nsamps, line0, samp0, bmeta->name,
+            bmeta->sub_sample.nlines, bmeta->sub_sample.nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Determine the sub-sampled pixels surrounding the window */
+    sub_line0 = line0 / factor;
+    sub_nlines = (line0 + nlines - 1) / factor + 2 - sub_line0;
+    if (sub_line0 + sub_nlines > bmeta->nlines)
+        sub_nlines = bmeta->nlines - sub_line0;
+    sub_samp0 = samp0 / factor;
+    sub_nsamps = (samp0 + nsamps - 1) / factor + 2 - sub_samp0;
+    if (sub_samp0 + sub_nsamps > bmeta->nsamps)
+        sub_nsamps = bmeta->nsamps - sub_samp0;
+
+    sub = malloc ((size_t) sub_nlines * sub_nsamps * nbytes);
+    drow0 = malloc (sub_nsamps * sizeof (double));
+    drow1 = malloc (sub_nsamps * sizeof (double));
+    ws = malloc (nsamps * sizeof (double));
+    s0 = malloc (nsamps * sizeof (int));
+    s1 = malloc (nsamps * sizeof (int));
+    if (sub == NULL || drow0 == NULL || drow1 == NULL || ws == NULL ||
+        s0 == NULL || s1 == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for upsampling raw binary band "
+            "%s.", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (sub);
+        free (drow0);
+        free (drow1);
+        free (ws);
+        free (s0);
+        free (s1);
+        return (ERROR);
+    }
+
+    if (read_raw_binary_window (rb_fptr, bmeta, sub_line0, sub_samp0,
+        sub_nlines, sub_nsamps, 1, sub) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the sub-sampled pixels of raw binary band "
+            "%s.", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (sub);
+        free (drow0);
+        free (drow1);
+        free (ws);
+        free (s0);
+        free (s1);
+        return (ERROR);
+    }
+
+    /* The neighbors and weights of the samples are the same for every
+       line */
+    for (s = 0; s < nsamps; s++)
+    {
+        samp = samp0 + s;
+        s0[s] = samp / factor - sub_samp0;
+        s1[s] = s0[s] + 1;
+        ws[s] = (double) (samp % factor) / factor;
+        if (s1[s] >= sub_nsamps)
+        {
+            s1[s] = s0[s];
+            ws[s] = 0.0;
+        }
+    }
+
+    use_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    fill = bmeta->fill_value;
+    for (l = 0; l < nlines; l++)
+    {
+        line = line0 + l;
+        row0 = line / factor - sub_line0;
+        row1 = row0 + 1;
+        wl = (double) (line % factor) / factor;
+        if (row1 >= sub_nlines)
+        {
+            row1 = row0;
+            wl = 0.0;
+        }
+
+        /* Convert the rows used by this line, reusing the ones from the
+           previous line */
+        if (converted0 != row0)
+        {
+            if (converted1 == row0)
+            {
+                dtmp = drow0;
+                drow0 = drow1;
+                drow1 = dtmp;
+                converted1 = -1;
+            }
+            else
+                convert_to_double (bmeta->data_type,
+                    sub + (size_t) row0 * sub_nsamps * nbytes, sub_nsamps,
+                    drow0);
+            converted0 = row0;
+        }
+        if (converted1 != row1)
+        {
+            convert_to_double (bmeta->data_type,
+                sub + (size_t) row1 * sub_nsamps * nbytes, sub_nsamps, drow1);
+            converted1 = row1;
+        }
+
+        for (s = 0; s < nsamps; s++)
+        {
+            v[0] = drow0[s0[s]];
+            v[1] = drow0[s1[s]];
+            v[2] = drow1[s0[s]];
+            v[3] = drow1[s1[s]];
+            w[0] = (1.0 - wl) * (1.0 - ws[s]);
+            w[1] = (1.0 - wl) * ws[s];
+            w[2] = wl * (1.0 - ws[s]);
+            w[3] = wl * ws[s];
+
+            has_fill = false;
+            if (use_fill)
+            {
+                for (k = 0; k < 4; k++)
+                {
+                    if (w[k] > 0.0 && v[k] == fill)
+                        has_fill = true;
+                }
+            }
+
+            if (has_fill)
+            {
+                nearest = 0;
+                for (k = 1; k < 4; k++)
+                {
+                    if (w[k] > w[nearest])
+                        nearest = k;
+                }
+                value = v[nearest];
+            }
+            else
+                value = w[0] * v[0] + w[1] * v[1] + w[2] * v[2] +
+                    w[3] * v[3];
+
+            store_from_double (bmeta->data_type, img_array,
+                (size_t) l * nsamps + s, value);
+        }
+    }
+
+    free (sub);
+    free (drow0);
+    free (drow1);
+    free (ws);
+    free (s0);
+    free (s1);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_data_type_size
+
+PURPOSE: Returns the number of bytes per pixel for the ESPA data type
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Unsupported data type
+nbytes       Number of bytes per pixel
+
+NOTES:
+*****************************************************************************/
+int get_data_type_size
+(
+    enum Espa_data_type data_type   /* I: ESPA data type */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+        case ESPA_UINT8:
+            return (1);
+        case ESPA_INT16:
+        case ESPA_UINT16:
+            return (2);
+        case ESPA_INT32:
+        case ESPA_UINT32:
+        case ESPA_FLOAT32:
+            return (4);
+        case ESPA_FLOAT64:
+            return (8);
+    }
+
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE: decode_raw_binary_mapped
+
+PURPOSE: Decodes a chunked, GeoTIFF, constant, lazy derived, or tiled band
+into memory in place of mapping it.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred decoding the band
+SUCCESS      Decoding was successful
+
+NOTES:
+  1. The chunks are decoded in parallel directly into the band buffer.
+  2. The strips or tiles of a GeoTIFF band are decoded directly into the
+     band buffer, bypassing its block cache.
+  3. The pixels of a constant or lazy derived band are generated into the
+     band buffer.
+  4. A tiled band is untiled into the band buffer a row of tiles at a time.
+*****************************************************************************/
+static int decode_raw_binary_mapped
+(
+    Raw_binary_encoding_t encoding, /* I: encoding of the band */
+    Raw_binary_mapped_t *rbmap   /* I/O: band to be decoded */
+)
+{
+    char FUNC_NAME[] = "decode_raw_binary_mapped"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status;              /* return status of the decoding */
+    Raw_binary_chunked_t *rbc = NULL;     /* chunked band */
+    Raw_binary_tiff_t *rbt = NULL;        /* GeoTIFF band */
+    Raw_binary_constant_t *rbk = NULL;    /* constant band */
+    Raw_binary_derived_t *rbd = NULL;     /* lazy derived band */
+    Raw_binary_tiled_t *rbtl = NULL;      /* tiled band */
+
+    if (rbmap->writable)
+    {
+        sprintf (errmsg, "Raw binary file %s is a %s band and can't be "
+            "mapped for writing.", rbmap->file_name,
+            raw_binary_encoding[encoding]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (encoding == RB_TILED)
+    {
+        rbtl = open_raw_binary_tiled (rbmap->file_name);
+        if (rbtl == NULL)
+            return (ERROR);
+
+        status = ERROR;
+        if (get_raw_binary_tiled_size (rbtl) < (off_t) rbmap->size)
+        {
+            sprintf (errmsg, "Tiled band %s is smaller than the %d lines x "
+                "%d samples x %d bytes expected.", rbmap->file_name,
+                rbmap->nlines, rbmap->nsamps, rbmap->nbytes);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+        else
+        {
+            rbmap->data = malloc (rbmap->size);
+            if (rbmap->data != NULL)
+                status = read_raw_binary_tiled (rbtl, 0, rbmap->size,
+                    rbmap->data);
+            if (status != SUCCESS)
+            {
+                sprintf (errmsg, "Untiling the tiled band %s into memory.",
+                    rbmap->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (rbmap->data);
+                rbmap->data = NULL;
+            }
+        }
+
+        close_raw_binary_tiled (rbtl);
+        rbmap->decoded = (status == SUCCESS);
+        return (status);
+    }
+
+    if (encoding == RB_DERIVED)
+    {
+        rbd = open_raw_binary_derived (rbmap->file_name);
+        if (rbd == NULL)
+            return (ERROR);
+
+        status = ERROR;
+        if (get_raw_binary_derived_size (rbd) < (off_t) rbmap->size)
+        {
+            sprintf (errmsg, "Derived band %s is smaller than the %d lines "
+                "x %d samples x %d bytes expected.", rbmap->file_name,
+                rbmap->nlines, rbmap->nsamps, rbmap->nbytes);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+        else
+        {
+            rbmap->data = malloc (rbmap->size);
+            if (rbmap->data != NULL)
+                status = read_raw_binary_derived (rbd, 0, rbmap->size,
+                    rbmap->data);
+            if (status != SUCCESS)
+            {
+                sprintf (errmsg, "Computing the derived band %s in memory.",
+                    rbmap->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (rbmap->data);
+                rbmap->data = NULL;
+            }
+        }
+
+        close_raw_binary_derived (rbd);
+        rbmap->decoded = (status == SUCCESS);
+        return (status);
+    }
+
+    if (encoding == RB_CONSTANT)
+    {
+        rbk = open_raw_binary_constant (rbmap->file_name);
+        if (rbk == NULL)
+            return (ERROR);
+
+        status = ERROR;
+        if (get_raw_binary_constant_size (rbk) < (off_t) rbmap->size)
+        {
+            sprintf (errmsg, "Constant band %s is smaller than the %d lines "
+                "x %d samples x %d bytes expected.", rbmap->file_name,
+                rbmap->nlines, rbmap->nsamps, rbmap->nbytes);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+        else
+        {
+            rbmap->data = malloc (rbmap->size);
+            if (rbmap->data != NULL)
+                status = read_raw_binary_constant (rbk, 0, rbmap->size,
+                    rbmap->data);
+            if (status != SUCCESS)
+            {
+                sprintf (errmsg, "Generating the constant band %s in "
+                    "memory.", rbmap->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (rbmap->data);
+                rbmap->data = NULL;
+            }
+        }
+
+        close_raw_binary_constant (rbk);
+        rbmap->decoded = (status == SUCCESS);
+        return (status);
+    }
+
+    if (encoding == RB_TIFF)
+    {
+        rbt = open_raw_binary_tiff (rbmap->file_name);
+        if (rbt == NULL)
+            return (ERROR);
+
+        status = ERROR;
+        if (get_raw_binary_tiff_size (rbt) < (off_t) rbmap->size)
+        {
+            sprintf (errmsg, "GeoTIFF band %s is smaller than the %d lines "
+                "x %d samples x %d bytes expected.", rbmap->file_name,
+                rbmap->nlines, rbmap->nsamps, rbmap->nbytes);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+        else
+        {
+            rbmap->data = malloc (rbmap->size);
+            if (rbmap->data != NULL)
+                status = read_raw_binary_tiff (rbt, 0, rbmap->size,
+                    rbmap->data);
+            if (status != SUCCESS)
+            {
+                sprintf (errmsg, "Decoding the GeoTIFF band %s into memory.",
+                    rbmap->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (rbmap->data);
+                rbmap->data = NULL;
+            }
+        }
+
+        close_raw_binary_tiff (rbt);
+        rbmap->decoded = (status == SUCCESS);
+        return (status);
+    }
+
+    rbc = open_raw_binary_chunked (rbmap->file_name);
+    if (rbc == NULL)
+        return (ERROR);
+
+    if (get_raw_binary_chunked_size (rbc) < (off_t) rbmap->size)
+    {
+        sprintf (errmsg, "Chunked band %s is smaller than the %d lines x "
+            "%d samples x %d bytes expected.", rbmap->file_name, rbmap->nlines,
+            rbmap->nsamps, rbmap->nbytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_chunked (rbc);
+        return (ERROR);
+    }
+
+    rbmap->data = malloc (rbmap->size);
+    if (rbmap->data == NULL ||
+        read_raw_binary_chunked (rbc, 0, rbmap->size, rbmap->data) != SUCCESS)
+    {
+        sprintf (errmsg, "Decoding the chunked band %s into memory.",
+            rbmap->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbmap->data);
+        rbmap->data = NULL;
+        close_raw_binary_chunked (rbc);
+        return (ERROR);
+    }
+
+    close_raw_binary_chunked (rbc);
+    rbmap->decoded = true;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_mapped
+
+PURPOSE: Memory maps the raw binary band described by the band metadata, and
+advises the kernel of the expected access pattern.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred mapping the band
+SUCCESS      Mapping was successful
+
+NOTES:
+  1. The band data is available directly via rbmap->data, without copying it
+     into a separate buffer.  Since the pages come from the page cache, tools
+     run back to back on the same band share the same pages.
+  2. The file must contain at least nlines * nsamps pixels of the band's data
+     type.
+  3. close_raw_binary_mapped must be called to unmap the band.
+  4. Compressed (chunked) bands and GeoTIFF bands can't be mapped, so they
+     are decoded into memory instead.  These can only be opened read-only.
+*****************************************************************************/
+int open_raw_binary_mapped
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata for the band to be
+                                       mapped; provides the filename, size,
+                                       and data type */
+    bool writable,               /* I: should the band be mapped for writing
+                                       (changes are written back to the
+                                       file)? */
+    Raw_binary_access_t access,  /* I: expected access pattern */
+    Raw_binary_mapped_t *rbmap   /* O: mapped band */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_mapped"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int advice;              /* madvise hint for the access pattern */
+    struct stat statbuf;     /* buffer for the file stat function */
+
+    /* Initialize the mapped band information from the band metadata */
+    memset (rbmap, 0, sizeof (Raw_binary_mapped_t));
+    rbmap->fd = -1;
+    strncpy (rbmap->file_name, bmeta->file_name, sizeof (rbmap->file_name)-1);
+    rbmap->nlines = bmeta->nlines;
+    rbmap->nsamps = bmeta->nsamps;
+    rbmap->data_type = bmeta->data_type;
+    rbmap->writable = writable;
+    rbmap->nbytes = get_data_type_size (bmeta->data_type);
+    if (rbmap->nbytes == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type for raw binary file %s.",
+            rbmap->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    rbmap->size = (size_t) rbmap->nlines * rbmap->nsamps * rbmap->nbytes;
+
+    /* Open the file (or its shared memory segment) and make sure it's large
+       enough for the band */
+    rbmap->fd = open_raw_binary_shm (rbmap->file_name,
+        writable ? O_RDWR : O_RDONLY);
+    if (rbmap->fd == -1)
+        rbmap->fd = open (rbmap->file_name, writable ? O_RDWR : O_RDONLY);
+    if (rbmap->fd == -1)
+    {
+        sprintf (errmsg, "Opening raw binary file %s for mapping.",
+            rbmap->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Chunked bands are decoded rather than mapped */
+    if (is_raw_binary_chunked (rbmap->fd))
+    {
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (decode_raw_binary_mapped (RB_CHUNKED, rbmap));
+    }
+
+    /* As are the GeoTIFF bands of a virtual product */
+    if (is_raw_binary_tiff (rbmap->file_name, rbmap->fd))
+    {
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (decode_raw_binary_mapped (RB_TIFF, rbmap));
+    }
+
+    /* And constant bands */
+    if (is_raw_binary_constant (rbmap->fd))
+    {
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (decode_raw_binary_mapped (RB_CONSTANT, rbmap));
+    }
+
+    /* And lazy derived bands */
+    if (is_raw_binary_derived (rbmap->fd))
+    {
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (decode_raw_binary_mapped (RB_DERIVED, rbmap));
+    }
+
+    /* And tiled bands */
+    if (is_raw_binary_tiled (rbmap->fd))
+    {
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (decode_raw_binary_mapped (RB_TILED, rbmap));
+    }
+
+    if (fstat (rbmap->fd, &statbuf) == -1 ||
+        (size_t) statbuf.st_size < rbmap->size)
+    {
+        sprintf (errmsg, "Raw binary file %s is smaller than the %d lines x "
+            "%d samples x %d bytes expected.", rbmap->file_name, rbmap->nlines,
+            rbmap->nsamps, rbmap->nbytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (ERROR);
+    }
+
+    /* Map the band */
+    rbmap->data = mmap (NULL, rbmap->size,
+        writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+        rbmap->fd, 0);
+    if (rbmap->data == MAP_FAILED)
+    {
+        sprintf (errmsg, "Mapping %lu bytes of raw binary file %s.",
+            (unsigned long) rbmap->size, rbmap->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        rbmap->data = NULL;
+        close (rbmap->fd);
+        rbmap->fd = -1;
+        return (ERROR);
+    }
+    espa_profile_count_io (ESPA_PROFILE_MAP, ESPA_PROFILE_MMAP, rbmap->size);
+
+    /* Advise the kernel of the access pattern.  This is only a hint, so a
+       failure isn't fatal. */
+    if (access == RB_ACCESS_RANDOM)
+        advice = MADV_RANDOM;
+    else
+        advice = MADV_SEQUENTIAL;
+    if (madvise (rbmap->data, rbmap->size, advice) != 0)
+    {
+        sprintf (errmsg, "Unable to set the access advice for %s.",
+            rbmap->file_name);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_mapped_line
+
+PURPOSE: Returns a pointer to the start of the specified line in the mapped
+band
+ 
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Line is outside of the band
+non-NULL     Pointer to the first pixel in the line
+
+NOTES:
+*****************************************************************************/
+void *get_raw_binary_mapped_line
+(
+    Raw_binary_mapped_t *rbmap,  /* I: mapped band */
+    int line                     /* I: line to be accessed (0-based) */
+)
+{
+    if (rbmap->data == NULL || line < 0 || line >= rbmap->nlines)
+        return (NULL);
+
+    return ((char *) rbmap->data +
+        (size_t) line * rbmap->nsamps * rbmap->nbytes);
+}
+
+
+/******************************************************************************
+MODULE: release_raw_binary_mapped_lines
+
+PURPOSE: Releases the pages of lines of a mapped band which won't be accessed
+again, so they no longer count towards the resident memory of the process
+ 
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The pages are dropped from the mapping, not from the page cache, so the
+     lines can still be accessed; they are just read back in.
+  2. Only the whole pages within the lines are released.  Bands mapped for
+     writing and decoded chunked bands are left alone.
+*****************************************************************************/
+void release_raw_binary_mapped_lines
+(
+    Raw_binary_mapped_t *rbmap,  /* I: mapped band */
+    int line,                    /* I: first line to be released (0-based) */
+    int nlines                   /* I: number of lines to be released */
+)
+{
+    size_t page_size = sysconf (_SC_PAGESIZE);  /* size of a memory page */
+    size_t line_bytes;       /* number of bytes in a band line */
+    size_t start;            /* offset of the first page released */
+    size_t end;              /* offset after the last page released */
+
+    if (rbmap->data == NULL || rbmap->writable || rbmap->decoded ||
+        line < 0 || nlines < 1 || line >= rbmap->nlines)
+        return;
+    if (line + nlines > rbmap->nlines)
+        nlines = rbmap->nlines - line;
+
+    line_bytes = (size_t) rbmap->nsamps * rbmap->nbytes;
+    start = ((size_t) line * line_bytes + page_size - 1) / page_size *
+        page_size;
+    end = (size_t) (line + nlines) * line_bytes;
+    if (line + nlines < rbmap->nlines)
+        end = end / page_size * page_size;
+    if (end > start)
+        madvise ((char *) rbmap->data + start, end - start, MADV_DONTNEED);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_mapped
+
+PURPOSE: Unmaps and closes the memory-mapped band.  Bands mapped for writing
+are synced to disk before being unmapped.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred syncing or unmapping the band
+SUCCESS      Unmapping was successful
+
+NOTES:
+*****************************************************************************/
+int close_raw_binary_mapped
+(
+    Raw_binary_mapped_t *rbmap   /* I: mapped band to be unmapped/closed */
+)
+{
+    char FUNC_NAME[] = "close_raw_binary_mapped"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+
+    if (rbmap->data != NULL && rbmap->decoded)
+    {
+        free (rbmap->data);
+        rbmap->data = NULL;
+    }
+    else if (rbmap->data != NULL)
+    {
+        if (rbmap->writable && msync (rbmap->data, rbmap->size, MS_SYNC) != 0)
+        {
+            sprintf (errmsg, "Syncing the mapped raw binary file %s.",
+                rbmap->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+
+        if (munmap (rbmap->data, rbmap->size) != 0)
+        {
+            sprintf (errmsg, "Unmapping the raw binary file %s.",
+                rbmap->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        rbmap->data = NULL;
+    }
+
+    if (rbmap->fd != -1)
+    {
+        close (rbmap->fd);
+        rbmap->fd = -1;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: alloc_raw_binary_aligned
+
+PURPOSE: Allocates a buffer aligned for O_DIRECT writes.
+ 
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error allocating the buffer
+non-NULL     Pointer to the buffer; release it with free
+
+NOTES:
+  1. The buffer is aligned to RB_DIRECT_ALIGN bytes.  Aligned buffers whose
+     size is a multiple of RB_DIRECT_ALIGN are written by the raw binary
+     writer without going through its staging buffer.
+*****************************************************************************/
+void *alloc_raw_binary_aligned
+(
+    size_t nbytes       /* I: number of bytes to allocate */
+)
+{
+    void *buf = NULL;        /* aligned buffer */
+
+    if (posix_memalign (&buf, RB_DIRECT_ALIGN, nbytes) != 0)
+        return (NULL);
+
+    return (buf);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_cache_mode
+
+PURPOSE: Returns the page cache handling requested for write-once outputs via
+the ESPA_WRITE_CACHE environment variable, or else the write_cache setting
+of the node profile.
+ 
+RETURN VALUE:
+Type = Raw_binary_cache_t
+Value                Description
+-----                -----------
+RB_CACHE_NORMAL      Neither is set, or the mode is "normal"
+RB_CACHE_DONTNEED    The mode is "dontneed"
+RB_CACHE_DIRECT      The mode is "direct"
+
+NOTES:
+  1. Outputs which are read again by the next processing stage generally
+     want to stay in the cache, hence the default.
+  2. espa_autotune measures the modes on the node and writes the fastest to
+     the node profile (see espa_tune.h).
+*****************************************************************************/
+Raw_binary_cache_t get_raw_binary_cache_mode ()
+{
+    const char *mode = getenv ("ESPA_WRITE_CACHE");  /* requested cache
+                                                         mode */
+
+    if (mode == NULL || mode[0] == '\0')
+        mode = espa_tune_value ("write_cache");
+
+    if (mode != NULL && !strcmp (mode, "dontneed"))
+        return (RB_CACHE_DONTNEED);
+    else if (mode != NULL && !strcmp (mode, "direct"))
+        return (RB_CACHE_DIRECT);
+
+    return (RB_CACHE_NORMAL);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_sparse_mode
+
+PURPOSE: Returns whether sparse files were requested via the
+ESPA_WRITE_SPARSE environment variable, in which case the raw binary writers
+leave whole blocks of zero fill as holes rather than writing them.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_WRITE_SPARSE is "yes"
+false        ESPA_WRITE_SPARSE isn't set, or is anything else
+
+NOTES:
+  1. A hole reads back as zeros for any reader, so only fill which is zero
+     is skipped; a band with a non-zero fill value is written in full.  The
+     blocks are RB_SPARSE_BLOCK bytes.
+  2. The readers here return the holes without reading them from disk (see
+     get_hole_run).
+  3. The environment variable is read once, on the first call.
+*****************************************************************************/
+static void init_sparse_mode ()
+{
+    char *mode = getenv ("ESPA_WRITE_SPARSE");  /* requested sparse mode */
+
+    sparse_mode = (mode != NULL && !strcmp (mode, "yes"));
+}
+
+bool get_raw_binary_sparse_mode ()
+{
+    pthread_once (&sparse_mode_once, init_sparse_mode);
+    return (sparse_mode);
+}
+
+
+/******************************************************************************
+MODULE: drop_writer_cache
+
+PURPOSE: Writes back the data written since the last call and drops it from
+the page cache.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. Unless final is set, the pages are only dropped once at least
+     RB_WRITER_BUFFER_SIZE bytes have been written since the last drop.
+  2. This is advisory, so failures are ignored.
+*****************************************************************************/
+static void drop_writer_cache
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    bool final                   /* I: is this the end of the file? */
+)
+{
+    off_t len = rbw->offset - rbw->dropped;  /* bytes not yet dropped */
+
+    if (rbw->cache == RB_CACHE_NORMAL || len == 0 ||
+        (!final && len < RB_WRITER_BUFFER_SIZE))
+        return;
+
+    /* Only clean pages can be dropped, so wait for them to be written */
+#ifdef SYNC_FILE_RANGE_WRITE
+    sync_file_range (rbw->fd, rbw->dropped, len, SYNC_FILE_RANGE_WAIT_BEFORE |
+        SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+    fdatasync (rbw->fd);
+#endif
+    posix_fadvise (rbw->fd, rbw->dropped, len, POSIX_FADV_DONTNEED);
+    rbw->dropped = rbw->offset;
+}
+
+
+/******************************************************************************
+MODULE: pwrite_run
+
+PURPOSE: Writes a run of nbytes at the current offset of the raw binary
+writer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the data
+SUCCESS      Writing was successful
+
+NOTES:
+  1. If the file system rejects an O_DIRECT write, O_DIRECT is turned off and
+     the writer continues with RB_CACHE_DONTNEED.
+*****************************************************************************/
+static int pwrite_run
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    const void *buf,             /* I: data to be written */
+    size_t nbytes                /* I: number of bytes to write */
+)
+{
+    char FUNC_NAME[] = "pwrite_run"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    ssize_t nwritten;        /* number of bytes written by the current call */
+
+    espa_io_throttle (ESPA_IO_WRITE, nbytes);
+    while (nbytes > 0)
+    {
+        nwritten = pwrite (rbw->fd, buf, nbytes, rbw->offset);
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten < 0 && errno == EINVAL && rbw->cache == RB_CACHE_DIRECT)
+        {
+            sprintf (errmsg, "O_DIRECT writes aren't supported for %s.  "
+                "Dropping the written pages from the cache instead.",
+                rbw->file_name);
+            error_handler (false, FUNC_NAME, errmsg);
+            fcntl (rbw->fd, F_SETFL, fcntl (rbw->fd, F_GETFL) & ~O_DIRECT);
+            rbw->cache = RB_CACHE_DONTNEED;
+            continue;
+        }
+        if (nwritten <= 0)
+        {
+            sprintf (errmsg, "Writing %lu bytes at offset %ld of the raw "
+                "binary file %s.", (unsigned long) nbytes, (long) rbw->offset,
+                rbw->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        espa_profile_count_io (ESPA_PROFILE_WRITE, ESPA_PROFILE_POSIX,
+            nwritten);
+
+        buf = (const char *) buf + nwritten;
+        nbytes -= nwritten;
+        rbw->offset += nwritten;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: pwrite_writer
+
+PURPOSE: Writes nbytes at the current offset of the raw binary writer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the data
+SUCCESS      Writing was successful
+
+NOTES:
+  1. A sparse writer leaves whole blocks of zero fill as holes.  The blocks
+     are aligned to RB_DIRECT_ALIGN, so the runs around them are still valid
+     O_DIRECT writes.
+*****************************************************************************/
+static int pwrite_writer
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    const void *buf,             /* I: data to be written */
+    size_t nbytes                /* I: number of bytes to write */
+)
+{
+    const char *data = buf;  /* remaining data to be written */
+    size_t nrun;             /* number of bytes in the current run */
+    bool fill;               /* is the current run zero fill? */
+
+    while (nbytes > 0)
+    {
+        nrun = nbytes;
+        fill = false;
+        if (rbw->sparse)
+            nrun = get_fill_run (data, nbytes, rbw->offset, &fill);
+
+        if (fill && skip_fill_run (rbw->fd, rbw->offset, nrun) == SUCCESS)
+            rbw->offset += nrun;
+        else if (pwrite_run (rbw, data, nrun) != SUCCESS)
+            return (ERROR);
+
+        data += nrun;
+        nbytes -= nrun;
+    }
+
+    drop_writer_cache (rbw, false);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: append_writer
+
+PURPOSE: Appends nbytes to the file of the raw binary writer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the data
+SUCCESS      Writing was successful
+
+NOTES:
+  1. With O_DIRECT the data is staged in the aligned buffer and written one
+     full buffer at a time.  Aligned data from alloc_raw_binary_aligned is
+     written directly when the staging buffer is empty.
+*****************************************************************************/
+static int append_writer
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    const void *buf,             /* I: data to be written */
+    size_t nbytes                /* I: number of bytes to write */
+)
+{
+    const char *data = buf;  /* remaining data to be written */
+    size_t ncopy;            /* number of bytes copied to the buffer */
+
+    if (rbw->checksum_band != NULL)
+        rbw->crc = update_raw_binary_crc32c (rbw->crc, data, nbytes);
+
+    if (rbw->cache != RB_CACHE_DIRECT)
+        return (pwrite_writer (rbw, data, nbytes));
+
+    /* Write whole aligned blocks directly from an aligned array */
+    if (rbw->nbuf == 0 && ((unsigned long) data % RB_DIRECT_ALIGN) == 0 &&
+        nbytes >= RB_DIRECT_ALIGN)
+    {
+        ncopy = nbytes - nbytes % RB_DIRECT_ALIGN;
+        if (pwrite_writer (rbw, data, ncopy) != SUCCESS)
+            return (ERROR);
+        data += ncopy;
+        nbytes -= ncopy;
+    }
+
+    /* Stage the rest, writing the buffer each time it fills */
+    while (nbytes > 0)
+    {
+        ncopy = RB_WRITER_BUFFER_SIZE - rbw->nbuf;
+        if (ncopy > nbytes)
+            ncopy = nbytes;
+        memcpy (rbw->buf + rbw->nbuf, data, ncopy);
+        rbw->nbuf += ncopy;
+        data += ncopy;
+        nbytes -= ncopy;
+
+        if (rbw->nbuf == RB_WRITER_BUFFER_SIZE)
+        {
+            if (pwrite_writer (rbw, rbw->buf, rbw->nbuf) != SUCCESS)
+                return (ERROR);
+            rbw->nbuf = 0;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: open_writer
+
+PURPOSE: Opens a raw binary file for sequential writing with the specified
+page cache handling and open flags.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred opening the file
+SUCCESS      Opening was successful
+
+NOTES:
+  1. See open_raw_binary_writer.
+*****************************************************************************/
+static int open_writer
+(
+    char *outfile,               /* I: name of the raw binary file to be
+                                       opened */
+    Raw_binary_cache_t cache,    /* I: page cache handling for the file */
+    Raw_binary_codec_t codec,    /* I: compression of the band; RB_CODEC_NONE
+                                       for a plain raw binary band */
+    int flags,                   /* I: flags for opening the file */
+    Raw_binary_writer_t *rbw     /* O: raw binary writer for the file */
+)
+{
+    char FUNC_NAME[] = "open_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    memset (rbw, 0, sizeof (Raw_binary_writer_t));
+    strncpy (rbw->file_name, outfile, sizeof (rbw->file_name) - 1);
+    rbw->cache = cache;
+    rbw->sparse = get_raw_binary_sparse_mode ();
+    rbw->codec = codec;
+
+    /* Bands kept in shared memory are written to their segments, where the
+       page cache handling doesn't apply */
+    rbw->fd = open_raw_binary_shm (outfile, flags);
+    if (rbw->fd != -1)
+        rbw->cache = RB_CACHE_NORMAL;
+    else if (cache == RB_CACHE_DIRECT)
+    {
+        rbw->buf = get_raw_binary_buffer (RB_WRITER_BUFFER_SIZE, false);
+        if (rbw->buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the O_DIRECT buffer for %s.",
+                outfile);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        rbw->fd = open (outfile, flags | O_DIRECT, 0644);
+        if (rbw->fd == -1 && errno == EINVAL)
+        {
+            sprintf (errmsg, "O_DIRECT isn't supported for %s.  Dropping the "
+                "written pages from the cache instead.", outfile);
+            error_handler (false, FUNC_NAME, errmsg);
+            rbw->cache = RB_CACHE_DONTNEED;
+        }
+    }
+
+    if (rbw->fd == -1 && rbw->cache != RB_CACHE_DIRECT)
+        rbw->fd = open (outfile, flags, 0644);
+    if (rbw->fd == -1)
+    {
+        sprintf (errmsg, "Opening raw binary file %s for writing.", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        release_raw_binary_buffer (rbw->buf);
+        rbw->buf = NULL;
+        return (ERROR);
+    }
+
+    /* Start a chunked band with its header */
+    if (codec != RB_CODEC_NONE)
+    {
+        memcpy (rbw->header.magic, RB_CHUNKED_MAGIC,
+            sizeof (rbw->header.magic));
+        rbw->header.version = RB_CHUNKED_VERSION;
+        rbw->header.codec = codec;
+        if (append_writer (rbw, &rbw->header, sizeof (rbw->header)) !=
+            SUCCESS)
+        {
+            close (rbw->fd);
+            rbw->fd = -1;
+            release_raw_binary_buffer (rbw->buf);
+            rbw->buf = NULL;
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_writer
+
+PURPOSE: Creates or overwrites a raw binary file for sequential writing with
+the specified page cache handling.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred opening the file
+SUCCESS      Opening was successful
+
+NOTES:
+  1. RB_CACHE_DIRECT falls back to RB_CACHE_DONTNEED if the file system
+     doesn't support O_DIRECT.
+  2. close_raw_binary_writer must be called to complete the file.
+  3. A codec other than RB_CODEC_NONE writes a compressed (chunked) band,
+     see raw_binary_chunked.h.  The chunk size is set from the line size of
+     the first write.
+  4. If sparse files are requested (see get_raw_binary_sparse_mode), whole
+     blocks of zero fill are left as holes in the file.
+  5. If the bands are kept in shared memory (see raw_binary_shm.h), the band
+     is written to a segment when there's room, with the normal page cache
+     handling.
+*****************************************************************************/
+int open_raw_binary_writer
+(
+    char *outfile,               /* I: name of the raw binary file to be
+                                       created or overwritten */
+    Raw_binary_cache_t cache,    /* I: page cache handling for the file */
+    Raw_binary_codec_t codec,    /* I: compression of the band; RB_CODEC_NONE
+                                       for a plain raw binary band */
+    Raw_binary_writer_t *rbw     /* O: raw binary writer for the file */
+)
+{
+    return (open_writer (outfile, cache, codec, O_WRONLY | O_CREAT | O_TRUNC,
+        rbw));
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_writer_resumable
+
+PURPOSE: Opens a raw binary file for sequential writing which can be
+checkpointed, so a stage which failed part way through writing it can resume
+where its last checkpoint left off.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred opening the file
+SUCCESS      Opening was successful
+
+NOTES:
+  1. With checkpointing on (see espa_checkpoint.h), an existing file isn't
+     truncated until resume_raw_binary_writer has read its checkpoint, which
+     must be called after the statistics, percent coverage and checksum are
+     attached and before the first write.  checkpoint_raw_binary_writer is
+     then called after each block is written, and a final checkpoint is
+     written when the file is closed, so a complete file is skipped when
+     the stage resumes.
+  2. The stage removes the checkpoint with espa_remove_checkpoint once its
+     whole output is complete.
+  3. Only plain raw binary bands can be resumed, since the pending chunks of
+     a chunked band aren't in the file.  With a codec, or with checkpointing
+     off, this is the same as open_raw_binary_writer.
+  4. RB_CACHE_DIRECT is replaced by RB_CACHE_DONTNEED, so all the data
+     written is in the file when a checkpoint is taken rather than partly in
+     the staging buffer.
+*****************************************************************************/
+int open_raw_binary_writer_resumable
+(
+    char *outfile,               /* I: name of the raw binary file to be
+                                       created or resumed */
+    Raw_binary_cache_t cache,    /* I: page cache handling for the file */
+    Raw_binary_codec_t codec,    /* I: compression of the band; RB_CODEC_NONE
+                                       for a plain raw binary band */
+    const char *stage,           /* I: name of the stage writing the file,
+                                       identifying the output */
+    Raw_binary_writer_t *rbw     /* O: raw binary writer for the file */
+)
+{
+    if (espa_checkpoint_interval () < 0 || codec != RB_CODEC_NONE)
+        return (open_raw_binary_writer (outfile, cache, codec, rbw));
+
+    if (cache == RB_CACHE_DIRECT)
+        cache = RB_CACHE_DONTNEED;
+    if (open_writer (outfile, cache, codec, O_WRONLY | O_CREAT, rbw) !=
+        SUCCESS)
+        return (ERROR);
+
+    if (espa_init_checkpoint (outfile, stage, &rbw->checkpoint) != SUCCESS)
+    {
+        close (rbw->fd);
+        rbw->fd = -1;
+        return (ERROR);
+    }
+    rbw->resumable = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_chunks
+
+PURPOSE: Compresses consecutive chunks of a chunked band and appends them to
+the file, recording their offsets in the chunk index.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred compressing or writing the chunks
+SUCCESS      Writing was successful
+
+NOTES:
+  1. There can be at most RB_CHUNK_BATCH chunks in src; they are compressed
+     in parallel.
+*****************************************************************************/
+static int write_chunks
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    const char *src,             /* I: uncompressed data of the chunks */
+    size_t nbytes                /* I: number of bytes in src */
+)
+{
+    char FUNC_NAME[] = "write_chunks"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *dst[RB_CHUNK_BATCH] = {NULL};   /* stored chunks */
+    size_t dst_len[RB_CHUNK_BATCH];       /* stored size of each chunk */
+    size_t nchunks;          /* number of chunks in src */
+    size_t nindex;           /* number of chunks written so far */
+    uint64_t *index = NULL;  /* reallocated chunk index */
+    int status = SUCCESS;    /* return status */
+    size_t k;                /* looping variable for the chunks */
+
+    nchunks = (nbytes + rbw->chunk_bytes - 1) / rbw->chunk_bytes;
+    nindex = rbw->trailer.nchunks;
+
+    /* Leave room for the chunks and the final index entry */
+    if (nindex + nchunks + 1 > rbw->max_index)
+    {
+        index = realloc (rbw->index, (rbw->max_index + nchunks + 1 +
+            RB_CHUNK_BATCH * 4) * sizeof (uint64_t));
+        if (index == NULL)
+        {
+            sprintf (errmsg, "Allocating the chunk index for %s.",
+                rbw->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        rbw->index = index;
+        rbw->max_index += nchunks + 1 + RB_CHUNK_BATCH * 4;
+    }
+
+    if (compress_raw_binary_chunks (rbw->codec, src, rbw->chunk_bytes,
+        nbytes, rbw->trailer.nsamps, rbw->trailer.nbytes, dst, dst_len)
+        != SUCCESS)
+        status = ERROR;
+
+    for (k = 0; k < nchunks && status == SUCCESS; k++)
+    {
+        rbw->index[nindex + k] = rbw->offset + rbw->nbuf;
+        status = append_writer (rbw, dst[k], dst_len[k]);
+    }
+
+    for (k = 0; k < nchunks; k++)
+        free (dst[k]);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing chunks %lu-%lu of %s.",
+            (unsigned long) nindex, (unsigned long) (nindex + nchunks - 1),
+            rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    rbw->trailer.nchunks += nchunks;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: attach_raw_binary_stats
+
+PURPOSE: Computes the statistics of the band while it's written by the raw
+binary writer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The data type of the band isn't supported
+SUCCESS      The statistics will be computed
+
+NOTES:
+  1. The fill_value, valid_range, and data_type of bmeta must be set before
+     calling this function.  The statistics are stored in bmeta->stats by
+     close_raw_binary_writer, so bmeta must remain valid until then.
+*****************************************************************************/
+int attach_raw_binary_stats
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    Espa_band_meta_t *bmeta      /* I/O: metadata of the band being written;
+                                       stats is set when the writer is
+                                       closed */
+)
+{
+    if (init_raw_binary_stats (bmeta, &rbw->stats) != SUCCESS)
+        return (ERROR);
+    rbw->stats_band = bmeta;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: attach_raw_binary_cover
+
+PURPOSE: Computes the percent coverage of the classes or QA bits of the band
+while it's written by the raw binary writer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The data type of the band isn't supported
+SUCCESS      The percent coverage will be computed, or the band has no cover
+             types
+
+NOTES:
+  1. The fill_value, data_type, and class_values or bitmap_description of
+     bmeta must be set before calling this function (see
+     get_raw_binary_cover_types).  Nothing is computed for a band without
+     cover types.
+  2. The percent coverage is stored in bmeta->percent_cover by
+     close_raw_binary_writer, so bmeta must remain valid until then.
+*****************************************************************************/
+int attach_raw_binary_cover
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    Espa_band_meta_t *bmeta      /* I/O: metadata of the band being written;
+                                       percent_cover is set when the writer
+                                       is closed */
+)
+{
+    if (get_raw_binary_cover_types (bmeta, NULL) == 0)
+        return (SUCCESS);
+    if (init_raw_binary_cover (bmeta, &rbw->cover) != SUCCESS)
+        return (ERROR);
+    rbw->cover_band = bmeta;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: attach_raw_binary_checksum
+
+PURPOSE: Computes the checksum of the file while it's written by the raw
+binary writer.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. This must be called before the first write.  The checksum covers the
+     whole file, including the header, index, and trailer of a chunked band.
+     It's stored in bmeta->checksum by close_raw_binary_writer, so bmeta
+     must remain valid until then.
+*****************************************************************************/
+void attach_raw_binary_checksum
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    Espa_band_meta_t *bmeta      /* I/O: metadata of the band being written;
+                                       checksum is set when the writer is
+                                       closed */
+)
+{
+    /* The header of a chunked band was written when the file was opened */
+    rbw->crc = 0;
+    if (rbw->codec != RB_CODEC_NONE)
+        rbw->crc = update_raw_binary_crc32c (0, &rbw->header,
+            sizeof (rbw->header));
+    rbw->checksum_band = bmeta;
+}
+
+
+/* Checkpoint record of a resumable raw binary writer, followed by the
+   statistics and the pixel counts of the percent coverage, if attached */
+typedef struct {
+    uint64_t offset;            /* number of bytes in the file */
+    int32_t nlines;             /* number of lines written */
+    uint32_t crc;               /* CRC32C of the bytes written */
+    int32_t has_stats;          /* are the statistics attached? */
+    int32_t cover_nvalues;      /* number of pixel counts of the percent
+                                   coverage; 0 if it isn't attached */
+} Writer_checkpoint_t;
+
+
+/******************************************************************************
+MODULE: get_writer_checkpoint_size
+
+PURPOSE: Returns the size of the checkpoint record of a resumable raw binary
+writer.
+ 
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+other        Size of the checkpoint record (bytes)
+
+NOTES:
+*****************************************************************************/
+static size_t get_writer_checkpoint_size
+(
+    const Raw_binary_writer_t *rbw   /* I: raw binary writer */
+)
+{
+    size_t size = sizeof (Writer_checkpoint_t);  /* size of the record */
+
+    if (rbw->stats_band != NULL)
+        size += sizeof (Raw_binary_stats_t);
+    if (rbw->cover_band != NULL)
+        size += (size_t) rbw->cover.nvalues * sizeof (long);
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: save_writer_checkpoint
+
+PURPOSE: Makes the data written so far durable and saves the checkpoint of a
+resumable raw binary writer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred syncing the file or saving the checkpoint
+SUCCESS      The checkpoint was saved
+
+NOTES:
+*****************************************************************************/
+static int save_writer_checkpoint
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer */
+)
+{
+    char FUNC_NAME[] = "save_writer_checkpoint"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t size = get_writer_checkpoint_size (rbw);  /* size of the record */
+    char *record = NULL;     /* checkpoint record */
+    char *next = NULL;       /* next part of the record */
+    Writer_checkpoint_t *ckpt = NULL;  /* start of the record */
+    int status;              /* status of saving the checkpoint */
+
+    if (fdatasync (rbw->fd) != 0)
+    {
+        sprintf (errmsg, "Syncing the raw binary file %s.", rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    record = calloc (1, size);
+    if (record == NULL)
+    {
+        sprintf (errmsg, "Allocating the checkpoint of %s.", rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    ckpt = (Writer_checkpoint_t *) record;
+    ckpt->offset = rbw->offset;
+    ckpt->nlines = rbw->nlines;
+    ckpt->crc = rbw->crc;
+    ckpt->has_stats = (rbw->stats_band != NULL);
+    ckpt->cover_nvalues = (rbw->cover_band != NULL) ? rbw->cover.nvalues : 0;
+    next = record + sizeof (Writer_checkpoint_t);
+    if (rbw->stats_band != NULL)
+    {
+        memcpy (next, &rbw->stats, sizeof (Raw_binary_stats_t));
+        next += sizeof (Raw_binary_stats_t);
+    }
+    if (rbw->cover_band != NULL)
+        memcpy (next, rbw->cover.counts, ckpt->cover_nvalues * sizeof (long));
+
+    status = espa_save_checkpoint (&rbw->checkpoint, record, size);
+    free (record);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: resume_raw_binary_writer
+
+PURPOSE: Resumes a resumable raw binary writer from the checkpoint of its
+file, restoring the statistics, percent coverage and checksum accumulated
+up to the checkpoint.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred truncating the file
+SUCCESS      The writer is ready to write line nlines
+
+NOTES:
+  1. It must be called after the statistics, percent coverage and checksum
+     are attached and before the first write.  Without a usable checkpoint,
+     or for a writer which isn't resumable, nlines is 0.
+  2. The data written after the checkpoint is truncated, so the stage
+     continues writing from line nlines.  A checkpoint for more data than
+     the file holds is ignored.
+*****************************************************************************/
+int resume_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int *nlines                  /* O: number of lines already written */
+)
+{
+    char FUNC_NAME[] = "resume_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t size = get_writer_checkpoint_size (rbw);  /* size of the record */
+    char *record = NULL;     /* checkpoint record */
+    char *next = NULL;       /* next part of the record */
+    Writer_checkpoint_t *ckpt = NULL;  /* start of the record */
+    struct stat st;          /* status of the file */
+
+    *nlines = 0;
+    if (!rbw->resumable)
+        return (SUCCESS);
+
+    record = malloc (size);
+    ckpt = (Writer_checkpoint_t *) record;
+    if (record != NULL &&
+        espa_load_checkpoint (&rbw->checkpoint, record, size) &&
+        ckpt->has_stats == (rbw->stats_band != NULL) &&
+        ckpt->cover_nvalues ==
+            ((rbw->cover_band != NULL) ? rbw->cover.nvalues : 0) &&
+        fstat (rbw->fd, &st) == 0 && (uint64_t) st.st_size >= ckpt->offset)
+    {
+        rbw->offset = ckpt->offset;
+        rbw->dropped = ckpt->offset;
+        rbw->nlines = ckpt->nlines;
+        rbw->crc = ckpt->crc;
+        next = record + sizeof (Writer_checkpoint_t);
+        if (rbw->stats_band != NULL)
+        {
+            memcpy (&rbw->stats, next, sizeof (Raw_binary_stats_t));
+            next += sizeof (Raw_binary_stats_t);
+        }
+        if (rbw->cover_band != NULL)
+            memcpy (rbw->cover.counts, next,
+                ckpt->cover_nvalues * sizeof (long));
+        *nlines = rbw->nlines;
+
+        printf ("Resuming %s at line %d\n", rbw->file_name, rbw->nlines);
+    }
+    free (record);
+
+    if (ftruncate (rbw->fd, rbw->offset) != 0)
+    {
+        sprintf (errmsg, "Truncating the raw binary file %s to %ld bytes.",
+            rbw->file_name, (long) rbw->offset);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/* Background writing thread of a raw binary writer and its queue of blocks
+   of lines, see start_raw_binary_writer_background */
+typedef struct {
+    char *buf;                  /* copy of the lines, from the buffer pool */
+    size_t size;                /* allocated size of buf */
+    int nlines;                 /* number of lines in the block */
+    int nsamps;                 /* number of samples per line */
+    int nbytes;                 /* number of bytes per pixel */
+} Writer_block_t;
+
+struct raw_binary_background {
+    pthread_t thread;           /* writing thread */
+    pthread_mutex_t lock;       /* lock for the queue state */
+    pthread_cond_t ready_cond;  /* signaled when a block is queued or the
+                                   thread should stop */
+    pthread_cond_t done_cond;   /* signaled when a block has been written */
+    Writer_block_t *block;      /* ring of queued blocks */
+    int nblocks;                /* number of blocks in the ring */
+    int head;                   /* next block to be written */
+    int count;                  /* number of blocks queued or being
+                                   written */
+    bool stop;                  /* should the thread stop once the queue is
+                                   empty? */
+    bool failed;                /* has a write failed? */
+};
+
+
+/******************************************************************************
+MODULE: drain_writer_background
+
+PURPOSE: Waits until the background thread of a raw binary writer has
+written all the queued blocks.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        A background write failed
+SUCCESS      All the queued blocks were written
+
+NOTES:
+  1. A writer without a background thread is already drained.
+*****************************************************************************/
+static int drain_writer_background
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer */
+)
+{
+    Raw_binary_background_t *bg = rbw->background;  /* background thread */
+    bool failed;             /* has a write failed? */
+
+    if (bg == NULL)
+        return (SUCCESS);
+
+    pthread_mutex_lock (&bg->lock);
+    while (bg->count > 0)
+        pthread_cond_wait (&bg->done_cond, &bg->lock);
+    failed = bg->failed;
+    pthread_mutex_unlock (&bg->lock);
+
+    return (failed ? ERROR : SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: checkpoint_raw_binary_writer
+
+PURPOSE: Saves a checkpoint of a resumable raw binary writer, if one is due.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred saving the checkpoint
+SUCCESS      The checkpoint was saved, or wasn't due
+
+NOTES:
+  1. The stage calls this after each block it writes; the checkpoints are
+     only saved every ESPA_CHECKPOINT_INTERVAL seconds (see
+     espa_checkpoint.h), since the file is synced for each one.
+  2. A writer which isn't resumable is never checkpointed.
+  3. The blocks queued to a background thread are written first, so the
+     checkpoint covers all the blocks written by the stage.
+*****************************************************************************/
+int checkpoint_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer */
+)
+{
+    if (!rbw->resumable || !espa_checkpoint_due (&rbw->checkpoint))
+        return (SUCCESS);
+
+    if (drain_writer_background (rbw) != SUCCESS)
+        return (ERROR);
+
+    return (save_writer_checkpoint (rbw));
+}
+
+
+/******************************************************************************
+MODULE: remove_raw_binary_checkpoint
+
+PURPOSE: Removes the checkpoint of a band file, once the product it belongs
+to is complete.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. The band filename is relative to dir unless it's an absolute path.
+  2. A missing checkpoint isn't an error.
+*****************************************************************************/
+void remove_raw_binary_checkpoint
+(
+    char *dir,                   /* I: directory of the XML file of the
+                                       product */
+    Espa_band_meta_t *bmeta      /* I: metadata of the band */
+)
+{
+    char band_file[STR_SIZE];    /* band filename */
+    int count;                   /* number of chars copied in snprintf */
+
+    if (bmeta->file_name[0] == '/')
+        count = snprintf (band_file, sizeof (band_file), "%s",
+            bmeta->file_name);
+    else
+        count = snprintf (band_file, sizeof (band_file), "%s/%s", dir,
+            bmeta->file_name);
+    if (count > 0 && count < sizeof (band_file))
+        espa_remove_checkpoint (band_file);
+}
+
+
+/******************************************************************************
+MODULE: write_writer_lines
+
+PURPOSE: Appends nlines of data to the raw binary file.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the data
+SUCCESS      Writing was successful
+
+NOTES:
+  1. For a chunked band the lines are collected until RB_CHUNK_BATCH chunks
+     are available, which are then compressed in parallel.  Whole batches are
+     compressed directly from img_array.  All the writes to a chunked band
+     must have the same number of samples and bytes per pixel.
+  2. If statistics or the percent coverage were attached, img_array must be
+     of the band's data type.
+*****************************************************************************/
+static int write_writer_lines
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              to the raw binary file */
+)
+{
+    char FUNC_NAME[] = "write_writer_lines"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    const char *data = img_array;  /* remaining data to be written */
+    size_t nbytes = (size_t) nlines * nsamps * size;  /* bytes remaining */
+    size_t batch_bytes;      /* uncompressed size of a batch of chunks */
+    size_t ncopy;            /* number of bytes copied to the chunk buffer */
+
+    /* Add the lines to the band statistics */
+    if (rbw->stats_band != NULL)
+    {
+        if (size != rbw->stats.nbytes)
+        {
+            sprintf (errmsg, "Writing %d-byte pixels to %s, which has %d-byte "
+                "pixels.", size, rbw->file_name, rbw->stats.nbytes);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        accumulate_raw_binary_stats (&rbw->stats, img_array,
+            (size_t) nlines * nsamps);
+    }
+
+    /* Add the lines to the pixel counts of the percent coverage */
+    if (rbw->cover_band != NULL)
+    {
+        if (size != rbw->cover.nbytes)
+        {
+            sprintf (errmsg, "Writing %d-byte pixels to %s, which has %d-byte "
+                "pixels.", size, rbw->file_name, rbw->cover.nbytes);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        accumulate_raw_binary_cover (&rbw->cover, img_array,
+            (size_t) nlines * nsamps);
+    }
+    ESPA_PROBE3 (write__block, rbw->fd, nlines, (long long) nbytes);
+
+    if (rbw->codec == RB_CODEC_NONE)
+    {
+        if (append_writer (rbw, data, nbytes) != SUCCESS)
+        {
+            /* A checkpoint can't describe a partially written block */
+            rbw->resumable = false;
+            return (ERROR);
+        }
+        rbw->nlines += nlines;
+        return (SUCCESS);
+    }
+
+    /* Size the chunks from the first write */
+    if (rbw->line_bytes == 0)
+    {
+        rbw->line_bytes = (size_t) nsamps * size;
+        rbw->trailer.nsamps = nsamps;
+        rbw->trailer.nbytes = size;
+        rbw->trailer.chunk_lines = RB_CHUNK_SIZE / rbw->line_bytes;
+        if (rbw->trailer.chunk_lines < 1)
+            rbw->trailer.chunk_lines = 1;
+        rbw->chunk_bytes = rbw->trailer.chunk_lines * rbw->line_bytes;
+        rbw->chunk_buf = malloc (RB_CHUNK_BATCH * rbw->chunk_bytes);
+        if (rbw->chunk_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the chunk buffer for %s.",
+                rbw->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else if ((size_t) nsamps * size != rbw->line_bytes ||
+        (uint32_t) size != rbw->trailer.nbytes)
+    {
+        sprintf (errmsg, "Writing lines of %d samples x %d bytes to the "
+            "chunked band %s, which has lines of %u samples x %u bytes.",
+            nsamps, size, rbw->file_name, rbw->trailer.nsamps,
+            rbw->trailer.nbytes);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    batch_bytes = RB_CHUNK_BATCH * rbw->chunk_bytes;
+    rbw->trailer.nlines += nlines;
+    while (nbytes > 0)
+    {
+        if (rbw->nchunk_buf == 0 && nbytes >= batch_bytes)
+        {
+            if (write_chunks (rbw, data, batch_bytes) != SUCCESS)
+                return (ERROR);
+            data += batch_bytes;
+            nbytes -= batch_bytes;
+            continue;
+        }
+
+        ncopy = batch_bytes - rbw->nchunk_buf;
+        if (ncopy > nbytes)
+            ncopy = nbytes;
+        memcpy (rbw->chunk_buf + rbw->nchunk_buf, data, ncopy);
+        rbw->nchunk_buf += ncopy;
+        data += ncopy;
+        nbytes -= ncopy;
+
+        if (rbw->nchunk_buf == batch_bytes)
+        {
+            if (write_chunks (rbw, rbw->chunk_buf, batch_bytes) != SUCCESS)
+                return (ERROR);
+            rbw->nchunk_buf = 0;
+        }
+    }
+    rbw->nlines += nlines;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: writer_background_thread
+
+PURPOSE: Writes the blocks queued to a raw binary writer, in order, until
+it's stopped.
+
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Always
+
+NOTES:
+  1. After a failed write the remaining blocks are dropped; the failure is
+     returned by the next write_raw_binary_writer or close_raw_binary_writer.
+*****************************************************************************/
+static void *writer_background_thread
+(
+    void *arg           /* I/O: raw binary writer */
+)
+{
+    Raw_binary_writer_t *rbw = arg;  /* raw binary writer */
+    Raw_binary_background_t *bg = rbw->background;  /* background thread */
+    Writer_block_t *blk = NULL;      /* block being written */
+    bool failed;             /* has a write failed? */
+
+    pthread_mutex_lock (&bg->lock);
+    while (true)
+    {
+        while (bg->count == 0 && !bg->stop)
+            pthread_cond_wait (&bg->ready_cond, &bg->lock);
+        if (bg->count == 0)
+            break;
+        blk = &bg->block[bg->head];
+        failed = bg->failed;
+        pthread_mutex_unlock (&bg->lock);
+
+        /* The block stays queued while it's written, so the producer can't
+           reuse its buffer */
+        if (!failed && write_writer_lines (rbw, blk->nlines, blk->nsamps,
+            blk->nbytes, blk->buf) != SUCCESS)
+            failed = true;
+
+        pthread_mutex_lock (&bg->lock);
+        if (failed)
+            bg->failed = true;
+        bg->head = (bg->head + 1) % bg->nblocks;
+        bg->count--;
+        pthread_cond_broadcast (&bg->done_cond);
+    }
+    pthread_mutex_unlock (&bg->lock);
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE: start_raw_binary_writer_background
+
+PURPOSE: Starts a background thread which makes the writes of a raw binary
+writer, so the caller can compute the next block of lines while the last
+ones are written.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred starting the thread
+SUCCESS      The writes are made in the background
+
+NOTES:
+  1. Each write_raw_binary_writer copies its lines into one of nbuffers
+     buffers from the buffer pool (see raw_binary_pool.h) and returns; it
+     only waits when all the buffers are still queued.  Two buffers overlap
+     the computing of a block with the writing of the last one, and three
+     also absorb the jitter of the writes.
+  2. Statistics, percent coverage and checksums are attached before this
+     is called, and are accumulated by the thread.
+  3. A failed write is reported by the next write_raw_binary_writer, and by
+     close_raw_binary_writer, which waits for the queued blocks.
+     checkpoint_raw_binary_writer waits for them too before saving a
+     checkpoint.
+*****************************************************************************/
+int start_raw_binary_writer_background
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int nbuffers                 /* I: number of blocks of lines which can
+                                       be queued; at least 2 */
+)
+{
+    char FUNC_NAME[] = "start_raw_binary_writer_background"; /* function
+                                                                 name */
+    char errmsg[STR_SIZE];   /* error message */
+    Raw_binary_background_t *bg = NULL;  /* background thread */
+
+    if (rbw->background != NULL)
+        return (SUCCESS);
+    if (nbuffers < 2)
+        nbuffers = 2;
+
+    bg = calloc (1, sizeof (Raw_binary_background_t));
+    if (bg != NULL)
+    {
+        bg->block = calloc (nbuffers, sizeof (Writer_block_t));
+        if (bg->block == NULL)
+        {
+            free (bg);
+            bg = NULL;
+        }
+    }
+    if (bg == NULL)
+    {
+        sprintf (errmsg, "Allocating the background writer of %s.",
+            rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    bg->nblocks = nbuffers;
+    pthread_mutex_init (&bg->lock, NULL);
+    pthread_cond_init (&bg->ready_cond, NULL);
+    pthread_cond_init (&bg->done_cond, NULL);
+
+    rbw->background = bg;
+    if (pthread_create (&bg->thread, NULL, writer_background_thread, rbw)
+        != 0)
+    {
+        sprintf (errmsg, "Starting the background writer of %s.",
+            rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        rbw->background = NULL;
+        pthread_mutex_destroy (&bg->lock);
+        pthread_cond_destroy (&bg->ready_cond);
+        pthread_cond_destroy (&bg->done_cond);
+        free (bg->block);
+        free (bg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: stop_writer_background
+
+PURPOSE: Waits for the queued blocks of a raw binary writer to be written,
+and stops its background thread.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        A background write failed
+SUCCESS      All the blocks were written
+
+NOTES:
+*****************************************************************************/
+static int stop_writer_background
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer */
+)
+{
+    Raw_binary_background_t *bg = rbw->background;  /* background thread */
+    int i;                   /* looping variable for the blocks */
+    int status;              /* return status */
+
+    if (bg == NULL)
+        return (SUCCESS);
+
+    pthread_mutex_lock (&bg->lock);
+    bg->stop = true;
+    pthread_cond_signal (&bg->ready_cond);
+    pthread_mutex_unlock (&bg->lock);
+    pthread_join (bg->thread, NULL);
+    status = bg->failed ? ERROR : SUCCESS;
+
+    for (i = 0; i < bg->nblocks; i++)
+        release_raw_binary_buffer (bg->block[i].buf);
+    pthread_mutex_destroy (&bg->lock);
+    pthread_cond_destroy (&bg->ready_cond);
+    pthread_cond_destroy (&bg->done_cond);
+    free (bg->block);
+    free (bg);
+    rbw->background = NULL;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_writer
+
+PURPOSE: Appends nlines of data to the raw binary file.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the data
+SUCCESS      Writing was successful
+
+NOTES:
+  1. See write_writer_lines.
+  2. With a background thread (see start_raw_binary_writer_background) the
+     lines are copied and queued, and ERROR reports an earlier write which
+     failed in the background.
+*****************************************************************************/
+int write_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              to the raw binary file */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t nbytes = (size_t) nlines * nsamps * size;  /* bytes to write */
+    Raw_binary_background_t *bg = rbw->background;  /* background thread */
+    Writer_block_t *blk = NULL;  /* block for the lines */
+
+    if (bg == NULL)
+        return (write_writer_lines (rbw, nlines, nsamps, size, img_array));
+
+    /* Wait for a free buffer */
+    pthread_mutex_lock (&bg->lock);
+    while (bg->count == bg->nblocks && !bg->failed)
+        pthread_cond_wait (&bg->done_cond, &bg->lock);
+    if (bg->failed)
+    {
+        pthread_mutex_unlock (&bg->lock);
+        sprintf (errmsg, "An earlier write to %s failed.", rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    blk = &bg->block[(bg->head + bg->count) % bg->nblocks];
+    pthread_mutex_unlock (&bg->lock);
+
+    /* The free buffer isn't touched by the thread until it's queued */
+    if (blk->size < nbytes)
+    {
+        release_raw_binary_buffer (blk->buf);
+        blk->buf = get_raw_binary_buffer (nbytes, false);
+        blk->size = (blk->buf != NULL) ? nbytes : 0;
+        if (blk->buf == NULL)
+        {
+            sprintf (errmsg, "Allocating a background write buffer for %s.",
+                rbw->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    memcpy (blk->buf, img_array, nbytes);
+    blk->nlines = nlines;
+    blk->nsamps = nsamps;
+    blk->nbytes = size;
+
+    pthread_mutex_lock (&bg->lock);
+    bg->count++;
+    pthread_cond_signal (&bg->ready_cond);
+    pthread_mutex_unlock (&bg->lock);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: close_chunked_writer
+
+PURPOSE: Writes the pending chunks, the chunk index, and the trailer of a
+chunked band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the end of the band
+SUCCESS      Writing was successful
+
+NOTES:
+*****************************************************************************/
+static int close_chunked_writer
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer */
+)
+{
+    char FUNC_NAME[] = "close_chunked_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint64_t *index = NULL;  /* reallocated chunk index */
+
+    if (rbw->nchunk_buf > 0)
+    {
+        if (write_chunks (rbw, rbw->chunk_buf, rbw->nchunk_buf) != SUCCESS)
+            return (ERROR);
+        rbw->nchunk_buf = 0;
+    }
+
+    /* A band which was never written to has no chunks */
+    if (rbw->line_bytes == 0)
+    {
+        rbw->trailer.nsamps = 1;
+        rbw->trailer.nbytes = 1;
+        rbw->trailer.chunk_lines = 1;
+    }
+
+    if (rbw->max_index == 0)
+    {
+        index = malloc (sizeof (uint64_t));
+        if (index == NULL)
+        {
+            sprintf (errmsg, "Allocating the chunk index for %s.",
+                rbw->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        rbw->index = index;
+        rbw->max_index = 1;
+    }
+
+    /* The index ends with its own offset, marking the end of the last chunk */
+    rbw->trailer.index_offset = rbw->offset + rbw->nbuf;
+    rbw->index[rbw->trailer.nchunks] = rbw->trailer.index_offset;
+    memcpy (rbw->trailer.magic, RB_CHUNKED_MAGIC, sizeof (rbw->trailer.magic));
+    if (append_writer (rbw, rbw->index, (rbw->trailer.nchunks + 1) *
+        sizeof (uint64_t)) != SUCCESS ||
+        append_writer (rbw, &rbw->trailer, sizeof (rbw->trailer)) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the chunk index of %s.", rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_writer
+
+PURPOSE: Writes the remaining staged data, drops the remaining pages from the
+cache if requested, and closes the raw binary file.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the remaining data
+SUCCESS      Closing was successful
+
+NOTES:
+  1. With O_DIRECT the last partial block is written padded to
+     RB_DIRECT_ALIGN bytes, and the file is then truncated to its real size.
+  2. A chunked band is completed by writing the pending chunks, the chunk
+     index, and the trailer.
+  3. If statistics, the percent coverage or a checksum were attached, they
+     are stored in the band metadata when the file was completed
+     successfully.
+  4. A resumable writer saves a final checkpoint of the complete file.
+  5. A background thread is stopped once the queued blocks are written; a
+     failed background write makes the close fail.
+*****************************************************************************/
+int close_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer to be closed */
+)
+{
+    char FUNC_NAME[] = "close_raw_binary_writer"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    off_t file_size;         /* size of the complete file */
+    size_t npad;             /* number of bytes written including padding */
+
+    if (rbw->fd == -1)
+        return (SUCCESS);
+
+    /* Write the blocks queued to the background thread */
+    if (stop_writer_background (rbw) != SUCCESS)
+        status = ERROR;
+
+    /* Complete a chunked band */
+    if (rbw->codec != RB_CODEC_NONE &&
+        close_chunked_writer (rbw) != SUCCESS)
+        status = ERROR;
+
+    if (rbw->nbuf > 0)
+    {
+        file_size = rbw->offset + rbw->nbuf;
+        npad = rbw->nbuf;
+        if (rbw->cache == RB_CACHE_DIRECT)
+        {
+            npad = (rbw->nbuf + RB_DIRECT_ALIGN - 1) / RB_DIRECT_ALIGN *
+                RB_DIRECT_ALIGN;
+            memset (rbw->buf + rbw->nbuf, 0, npad - rbw->nbuf);
+        }
+
+        if (pwrite_writer (rbw, rbw->buf, npad) != SUCCESS)
+            status = ERROR;
+        else if (rbw->offset != file_size &&
+            ftruncate (rbw->fd, file_size) != 0)
+        {
+            sprintf (errmsg, "Truncating the raw binary file %s to %ld bytes.",
+                rbw->file_name, (long) file_size);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        rbw->offset = file_size;
+        rbw->nbuf = 0;
+    }
+
+    drop_writer_cache (rbw, true);
+
+    /* Checkpoint the complete file, so a resumed stage skips it */
+    if (rbw->resumable && status == SUCCESS &&
+        save_writer_checkpoint (rbw) != SUCCESS)
+        status = ERROR;
+
+    complete_raw_binary_shm (rbw->fd);
+    if (close (rbw->fd) != 0)
+    {
+        sprintf (errmsg, "Closing the raw binary file %s.", rbw->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    rbw->fd = -1;
+
+    if (rbw->stats_band != NULL && status == SUCCESS)
+        finish_raw_binary_stats (&rbw->stats, &rbw->stats_band->stats);
+    rbw->stats_band = NULL;
+    if (rbw->cover_band != NULL && status == SUCCESS)
+    {
+        if (finish_raw_binary_cover (&rbw->cover, rbw->cover_band)
+            != SUCCESS)
+            status = ERROR;
+    }
+    else
+        free_raw_binary_cover (&rbw->cover);
+    rbw->cover_band = NULL;
+    if (rbw->checksum_band != NULL && status == SUCCESS)
+        format_raw_binary_checksum (rbw->crc, rbw->checksum_band);
+    rbw->checksum_band = NULL;
+
+    release_raw_binary_buffer (rbw->buf);
+    rbw->buf = NULL;
+    free (rbw->chunk_buf);
+    rbw->chunk_buf = NULL;
+    free (rbw->index);
+    rbw->index = NULL;
+
+    return (status);
+}
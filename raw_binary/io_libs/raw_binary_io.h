@@ -17,7 +17,114 @@ NOTES:
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
 #include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_chunked.h"
+#include "raw_binary_stats.h"
+#include "raw_binary_cover.h"
+#include "raw_binary_checksum.h"
+#include "espa_checkpoint.h"
+
+/* Maximum number of bytes read at once when coalescing the lines of a
+   window read */
+#define RB_WINDOW_STAGING_SIZE (4 * 1024 * 1024)
+
+/* Size of the read-ahead windows of bands read a block of lines at a time;
+   the next window is prefetched as the reads enter the current one */
+#define RB_PREFETCH_SIZE (8 * 1024 * 1024)
+
+/* Alignment of the buffers, sizes and offsets of O_DIRECT writes */
+#define RB_DIRECT_ALIGN 4096
+
+/* Size of the blocks of zero fill left as holes in sparse files, aligned to
+   their offset in the file; a multiple of RB_DIRECT_ALIGN */
+#define RB_SPARSE_BLOCK (64 * 1024)
+
+/* Size of the staging buffer of the raw binary writer.  Also the amount of
+   data written between dropping the written pages from the page cache. */
+#define RB_WRITER_BUFFER_SIZE (8 * 1024 * 1024)
+
+/* Number of blocks of lines queued to the background thread of a raw binary
+   writer, see start_raw_binary_writer_background */
+#define RB_WRITER_BACKGROUND_BUFFERS 3
+
+/* Page cache handling for the files written by the raw binary writer */
+typedef enum {
+  RB_CACHE_NORMAL,      /* leave the written pages in the page cache */
+  RB_CACHE_DONTNEED,    /* drop the pages from the cache once written back */
+  RB_CACHE_DIRECT       /* bypass the page cache with O_DIRECT */
+} Raw_binary_cache_t;
+
+/* Background writing thread of a raw binary writer; the contents are
+   private */
+typedef struct raw_binary_background Raw_binary_background_t;
+
+/* Structure for a raw binary file written via the raw binary writer */
+typedef struct {
+    char file_name[STR_SIZE];   /* name of the raw binary file */
+    int fd;                     /* file descriptor of the file */
+    Raw_binary_cache_t cache;   /* page cache handling in use */
+    bool sparse;                /* are blocks of zero fill left as holes?
+                                   see get_raw_binary_sparse_mode */
+    char *buf;                  /* aligned staging buffer for O_DIRECT */
+    size_t nbuf;                /* number of bytes in the staging buffer */
+    off_t offset;               /* file offset of the next write */
+    off_t dropped;              /* file offset up to which the pages have
+                                   been dropped from the cache */
+    Raw_binary_codec_t codec;   /* compression of the chunks; RB_CODEC_NONE
+                                   writes a plain raw binary band */
+    Raw_binary_chunked_header_t header;    /* header of a chunked band */
+    Raw_binary_chunked_trailer_t trailer;  /* chunking of the band */
+    size_t line_bytes;          /* bytes per line; 0 until the first write */
+    size_t chunk_bytes;         /* uncompressed size of a chunk */
+    char *chunk_buf;            /* uncompressed data of the pending chunks */
+    size_t nchunk_buf;          /* number of bytes in chunk_buf */
+    uint64_t *index;            /* file offset of each chunk written */
+    size_t max_index;           /* number of entries allocated in index */
+    Espa_band_meta_t *stats_band;  /* band metadata receiving the statistics
+                                   of the written data; NULL if the
+                                   statistics aren't computed */
+    Raw_binary_stats_t stats;   /* statistics accumulated so far */
+    Espa_band_meta_t *cover_band;  /* band metadata receiving the percent
+                                   coverage of the written data; NULL if it
+                                   isn't computed */
+    Raw_binary_cover_t cover;   /* pixel counts of the percent coverage */
+    Espa_band_meta_t *checksum_band;  /* band metadata receiving the
+                                   checksum of the file; NULL if the
+                                   checksum isn't computed */
+    uint32_t crc;               /* CRC32C of the bytes written so far */
+    int nlines;                 /* number of lines written so far */
+    bool resumable;             /* can the file be checkpointed and resumed?
+                                   see open_raw_binary_writer_resumable */
+    Espa_checkpoint_t checkpoint;  /* checkpoint of the file, if resumable */
+    Raw_binary_background_t *background;  /* thread making the writes; NULL
+                                   if they're made by the caller */
+} Raw_binary_writer_t;
+
+/* Access patterns for memory-mapped bands, used to advise the kernel how the
+   pages will be accessed */
+typedef enum {
+  RB_ACCESS_SEQUENTIAL,
+  RB_ACCESS_RANDOM
+} Raw_binary_access_t;
+
+/* Structure for a memory-mapped raw binary band */
+typedef struct {
+    char file_name[STR_SIZE];   /* name of the mapped raw binary file */
+    int fd;                     /* file descriptor of the mapped file */
+    void *data;                 /* pointer to the mapped band data; cast to
+                                   the type of data_type */
+    size_t size;                /* size of the mapping in bytes */
+    int nlines;                 /* number of lines in the band */
+    int nsamps;                 /* number of samples in the band */
+    enum Espa_data_type data_type;  /* data type of the band */
+    int nbytes;                 /* number of bytes per pixel */
+    bool writable;              /* was the band mapped for writing? */
+    bool decoded;               /* was a chunked, GeoTIFF, constant, lazy
+                                   derived, or tiled band decoded into
+                                   memory rather than mapped? */
+} Raw_binary_mapped_t;
 
 /* Prototypes */
 FILE *open_raw_binary
@@ -54,4 +161,167 @@ int read_raw_binary
                               already have been allocated) */
 );
 
+int read_raw_binary_window
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    Espa_band_meta_t *bmeta, /* I: band metadata for the band being read;
+                              provides the band size and data type */
+    int line0,          /* I: first line of the window (0-based) */
+    int samp0,          /* I: first sample of the window (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    int stride,         /* I: step between the lines/samples read; 1 for a
+                              contiguous window */
+    void *img_array     /* O: array of nlines * nsamps pixels of the band's
+                              data type (sufficient space should already have
+                              been allocated) */
+);
+
+int read_raw_binary_upsampled
+(
+    FILE *rb_fptr,      /* I: pointer to the raw binary file */
+    Espa_band_meta_t *bmeta, /* I: band metadata for the band being read;
+                              provides the band size, data type, fill value
+                              and sub-sampling */
+    int line0,          /* I: first full resolution line of the window
+                              (0-based) */
+    int samp0,          /* I: first full resolution sample of the window
+                              (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    void *img_array     /* O: array of nlines * nsamps pixels of the band's
+                              data type (sufficient space should already have
+                              been allocated) */
+);
+
+void *alloc_raw_binary_aligned
+(
+    size_t nbytes       /* I: number of bytes to allocate */
+);
+
+Raw_binary_cache_t get_raw_binary_cache_mode ();
+
+bool get_raw_binary_sparse_mode ();
+
+int open_raw_binary_writer
+(
+    char *outfile,               /* I: name of the raw binary file to be
+                                       created or overwritten */
+    Raw_binary_cache_t cache,    /* I: page cache handling for the file */
+    Raw_binary_codec_t codec,    /* I: compression of the band; RB_CODEC_NONE
+                                       for a plain raw binary band */
+    Raw_binary_writer_t *rbw     /* O: raw binary writer for the file */
+);
+
+int open_raw_binary_writer_resumable
+(
+    char *outfile,               /* I: name of the raw binary file to be
+                                       created or resumed */
+    Raw_binary_cache_t cache,    /* I: page cache handling for the file */
+    Raw_binary_codec_t codec,    /* I: compression of the band; RB_CODEC_NONE
+                                       for a plain raw binary band */
+    const char *stage,           /* I: name of the stage writing the file,
+                                       identifying the output */
+    Raw_binary_writer_t *rbw     /* O: raw binary writer for the file */
+);
+
+int attach_raw_binary_stats
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    Espa_band_meta_t *bmeta      /* I/O: metadata of the band being written;
+                                       stats is set when the writer is
+                                       closed */
+);
+
+int attach_raw_binary_cover
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    Espa_band_meta_t *bmeta      /* I/O: metadata of the band being written;
+                                       percent_cover is set when the writer
+                                       is closed */
+);
+
+void attach_raw_binary_checksum
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    Espa_band_meta_t *bmeta      /* I/O: metadata of the band being written;
+                                       checksum is set when the writer is
+                                       closed */
+);
+
+int resume_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int *nlines                  /* O: number of lines already written */
+);
+
+int checkpoint_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer */
+);
+
+void remove_raw_binary_checkpoint
+(
+    char *dir,                   /* I: directory of the XML file of the
+                                       product */
+    Espa_band_meta_t *bmeta      /* I: metadata of the band */
+);
+
+int start_raw_binary_writer_background
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int nbuffers                 /* I: number of blocks of lines which can
+                                       be queued; at least 2 */
+);
+
+int write_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw,    /* I/O: raw binary writer */
+    int nlines,         /* I: number of lines to write to the file */
+    int nsamps,         /* I: number of samples to write to the file */
+    int size,           /* I: number of bytes per pixel (ex. sizeof(uint8)) */
+    void *img_array     /* I: array of nlines * nsamps * size to be written
+                              to the raw binary file */
+);
+
+int close_raw_binary_writer
+(
+    Raw_binary_writer_t *rbw     /* I/O: raw binary writer to be closed */
+);
+
+int get_data_type_size
+(
+    enum Espa_data_type data_type   /* I: ESPA data type */
+);
+
+int open_raw_binary_mapped
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata for the band to be
+                                       mapped; provides the filename, size,
+                                       and data type */
+    bool writable,               /* I: should the band be mapped for writing
+                                       (changes are written back to the
+                                       file)? */
+    Raw_binary_access_t access,  /* I: expected access pattern */
+    Raw_binary_mapped_t *rbmap   /* O: mapped band */
+);
+
+void *get_raw_binary_mapped_line
+(
+    Raw_binary_mapped_t *rbmap,  /* I: mapped band */
+    int line                     /* I: line to be accessed (0-based) */
+);
+
+void release_raw_binary_mapped_lines
+(
+    Raw_binary_mapped_t *rbmap,  /* I: mapped band */
+    int line,                    /* I: first line to be released (0-based) */
+    int nlines                   /* I: number of lines to be released */
+);
+
+int close_raw_binary_mapped
+(
+    Raw_binary_mapped_t *rbmap   /* I: mapped band to be unmapped/closed */
+);
+
 #endif
@@ -0,0 +1,541 @@
+/*****************************************************************************
+FILE: raw_binary_overview.c
+  
+PURPOSE: Contains functions for building the reduced-resolution overviews of
+a raw binary band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Image bands are reduced by averaging the non-fill pixels of each
+     factor x factor block of the band; a block which is all fill is fill in
+     the overview.  QA bands, bit-mapped or class bands, and bands whose
+     resample_method is nearest neighbor use the pixel nearest the center of
+     the block instead.
+  2. Each level is computed directly from the full resolution band, not from
+     the previous level, so the averages are exact.
+*****************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "raw_binary_overview.h"
+
+/* Converts n pixels of a data type to double */
+#define CONVERT_TO_DOUBLE(TYPE) \
+    for (i = 0; i < n; i++) \
+        dst[i] = ((const TYPE *) src)[i];
+
+/* Stores a pixel value in the line of a data type */
+#define STORE_PIXEL(TYPE) \
+    ((TYPE *) buf)[i] = (TYPE) value;
+
+
+/******************************************************************************
+MODULE: convert_line_to_double
+
+PURPOSE: Converts a line of the band to double for averaging.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+*****************************************************************************/
+static void convert_line_to_double
+(
+    enum Espa_data_type data_type, /* I: data type of the band */
+    const void *src,             /* I: line of the band */
+    int n,                       /* I: number of samples in the line */
+    double *dst                  /* O: line converted to double */
+)
+{
+    int i;                       /* looping variable for the samples */
+
+    switch (data_type)
+    {
+        case ESPA_INT8: CONVERT_TO_DOUBLE (int8_t); break;
+        case ESPA_UINT8: CONVERT_TO_DOUBLE (uint8_t); break;
+        case ESPA_INT16: CONVERT_TO_DOUBLE (int16_t); break;
+        case ESPA_UINT16: CONVERT_TO_DOUBLE (uint16_t); break;
+        case ESPA_INT32: CONVERT_TO_DOUBLE (int32_t); break;
+        case ESPA_UINT32: CONVERT_TO_DOUBLE (uint32_t); break;
+        case ESPA_FLOAT32: CONVERT_TO_DOUBLE (float); break;
+        case ESPA_FLOAT64: CONVERT_TO_DOUBLE (double); break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: store_average_line
+
+PURPOSE: Converts the sums of the current line of an overview level to the
+average pixel values, and resets the sums for the next line.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. Averages of integer bands are rounded to the nearest integer.  Samples
+     without non-fill pixels are set to the fill value, or to 0 if the band
+     has no fill value.
+*****************************************************************************/
+static void store_average_line
+(
+    Raw_binary_overview_t *ovr,  /* I: overviews being built */
+    Raw_binary_overview_level_t *lvl  /* I/O: level of the line */
+)
+{
+    void *buf = lvl->line_buf;   /* line of the level */
+    double value;                /* value of the current sample */
+    int i;                       /* looping variable for the samples */
+
+    for (i = 0; i < lvl->nsamps; i++)
+    {
+        if (lvl->count[i] == 0)
+            value = ovr->use_fill ? ovr->fill_value : 0.0;
+        else
+        {
+            value = lvl->sum[i] / lvl->count[i];
+            if (ovr->data_type != ESPA_FLOAT32 &&
+                ovr->data_type != ESPA_FLOAT64)
+                value = floor (value + 0.5);
+        }
+
+        switch (ovr->data_type)
+        {
+            case ESPA_INT8: STORE_PIXEL (int8_t); break;
+            case ESPA_UINT8: STORE_PIXEL (uint8_t); break;
+            case ESPA_INT16: STORE_PIXEL (int16_t); break;
+            case ESPA_UINT16: STORE_PIXEL (uint16_t); break;
+            case ESPA_INT32: STORE_PIXEL (int32_t); break;
+            case ESPA_UINT32: STORE_PIXEL (uint32_t); break;
+            case ESPA_FLOAT32: STORE_PIXEL (float); break;
+            case ESPA_FLOAT64: STORE_PIXEL (double); break;
+        }
+    }
+
+    memset (lvl->sum, 0, lvl->nsamps * sizeof (double));
+    memset (lvl->count, 0, lvl->nsamps * sizeof (int));
+}
+
+
+/******************************************************************************
+MODULE: free_raw_binary_overviews
+
+PURPOSE: Closes the overview files and frees the buffers of the levels.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred closing the overview files
+SUCCESS      Freeing was successful
+
+NOTES:
+*****************************************************************************/
+static int free_raw_binary_overviews
+(
+    Raw_binary_overview_t *ovr   /* I/O: overviews being built */
+)
+{
+    int status = SUCCESS;        /* return status */
+    int k;                       /* looping variable for the levels */
+
+    for (k = 0; k < ovr->nlevels; k++)
+    {
+        if (close_raw_binary_writer (&ovr->level[k].rbw) != SUCCESS)
+            status = ERROR;
+        free (ovr->level[k].sum);
+        ovr->level[k].sum = NULL;
+        free (ovr->level[k].count);
+        ovr->level[k].count = NULL;
+        free (ovr->level[k].line_buf);
+        ovr->level[k].line_buf = NULL;
+    }
+    free (ovr->dline);
+    ovr->dline = NULL;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_overview_name
+
+PURPOSE: Generates the name of an overview file from the name of the band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The overview name doesn't fit in ovr_file
+SUCCESS      Generating the name was successful
+
+NOTES:
+  1. _ovr<factor> is inserted before the .img extension, or appended if the
+     band file doesn't end in .img.
+*****************************************************************************/
+int get_raw_binary_overview_name
+(
+    char *img_file,        /* I: name of the raw binary band */
+    int factor,            /* I: reduction factor of the overview level */
+    char *ovr_file,        /* O: name of the overview file */
+    size_t ovr_size        /* I: size of the ovr_file buffer */
+)
+{
+    char FUNC_NAME[] = "get_raw_binary_overview_name"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t len = strlen (img_file);  /* length of the band name */
+    int count;               /* number of chars copied in snprintf */
+
+    if (len > 4 && !strcmp (&img_file[len-4], ".img"))
+        len -= 4;
+    count = snprintf (ovr_file, ovr_size, "%.*s_ovr%d.img", (int) len,
+        img_file, factor);
+    if (count < 0 || (size_t) count >= ovr_size)
+    {
+        sprintf (errmsg, "Overflow of the overview filename for %s",
+            img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_overviews
+
+PURPOSE: Sets up the overview levels of a band and creates their files.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred setting up the levels
+SUCCESS      Opening was successful
+
+NOTES:
+  1. The overview files are written with the page cache handling of
+     get_raw_binary_cache_mode.
+*****************************************************************************/
+int open_raw_binary_overviews
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    int nlevels,                 /* I: number of overview levels to build
+                                       (1 to RB_MAX_OVERVIEWS) */
+    Raw_binary_overview_t *ovr   /* O: overviews being built */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_overviews"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Raw_binary_cache_t cache = get_raw_binary_cache_mode ();
+                             /* page cache handling for the levels */
+    Raw_binary_overview_level_t *lvl = NULL;  /* current level */
+    int k;                   /* looping variable for the levels */
+
+    memset (ovr, 0, sizeof (Raw_binary_overview_t));
+    if (nlevels < 1 || nlevels > RB_MAX_OVERVIEWS)
+    {
+        sprintf (errmsg, "Number of overview levels (%d) must be from 1 to "
+            "%d.", nlevels, RB_MAX_OVERVIEWS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    ovr->nbytes = get_data_type_size (bmeta->data_type);
+    if (ovr->nbytes == ERROR)
+    {
+        sprintf (errmsg, "Unsupported data type for the overviews of band "
+            "%s.", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ovr->data_type = bmeta->data_type;
+    ovr->nlines = bmeta->nlines;
+    ovr->nsamps = bmeta->nsamps;
+    ovr->use_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    ovr->fill_value = bmeta->fill_value;
+    ovr->average = !(bmeta->resample_method == ESPA_NN ||
+        !strcmp (bmeta->category, "qa") || bmeta->nbits > 0 ||
+        bmeta->nclass > 0);
+
+    if (ovr->average)
+    {
+        ovr->dline = malloc (bmeta->nsamps * sizeof (double));
+        if (ovr->dline == NULL)
+        {
+            sprintf (errmsg, "Allocating the overview line of band %s.",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    for (k = 0; k < nlevels; k++)
+    {
+        lvl = &ovr->level[k];
+        lvl->factor = 2 << k;
+        lvl->nlines = (bmeta->nlines + lvl->factor - 1) / lvl->factor;
+        lvl->nsamps = (bmeta->nsamps + lvl->factor - 1) / lvl->factor;
+        lvl->rbw.fd = -1;
+        ovr->nlevels = k + 1;
+
+        lvl->line_buf = malloc ((size_t) lvl->nsamps * ovr->nbytes);
+        if (ovr->average)
+        {
+            lvl->sum = calloc (lvl->nsamps, sizeof (double));
+            lvl->count = calloc (lvl->nsamps, sizeof (int));
+        }
+        if (lvl->line_buf == NULL ||
+            (ovr->average && (lvl->sum == NULL || lvl->count == NULL)))
+        {
+            sprintf (errmsg, "Allocating the %dx overview line of band %s.",
+                lvl->factor, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free_raw_binary_overviews (ovr);
+            return (ERROR);
+        }
+
+        if (get_raw_binary_overview_name (bmeta->file_name, lvl->factor,
+            lvl->file_name, sizeof (lvl->file_name)) != SUCCESS ||
+            open_raw_binary_writer (lvl->file_name, cache, RB_CODEC_NONE,
+            &lvl->rbw) != SUCCESS)
+        {
+            sprintf (errmsg, "Creating the %dx overview of band %s.",
+                lvl->factor, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            lvl->rbw.fd = -1;
+            free_raw_binary_overviews (ovr);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: add_raw_binary_overview_lines
+
+PURPOSE: Adds the next lines of the band to the overview levels, writing each
+overview line once all its band lines have been added.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the overviews
+SUCCESS      Adding the lines was successful
+
+NOTES:
+  1. The lines can be added any number at a time, in order from the first
+     line of the band.
+*****************************************************************************/
+int add_raw_binary_overview_lines
+(
+    Raw_binary_overview_t *ovr,  /* I/O: overviews being built */
+    int nlines,                  /* I: number of band lines in img_array */
+    void *img_array              /* I: next nlines full lines of the band */
+)
+{
+    char FUNC_NAME[] = "add_raw_binary_overview_lines"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Raw_binary_overview_level_t *lvl = NULL;  /* current level */
+    const char *src = NULL;  /* current line of the band */
+    double value;            /* value of the current pixel */
+    int f;                   /* reduction factor of the current level */
+    int row;                 /* row of the current line in its block */
+    int block_lines;         /* number of band lines in the current block */
+    int s, s_end;            /* band samples of the current block */
+    int l, k, os;            /* looping variables for the lines, levels, and
+                                overview samples */
+
+    if (ovr->line + nlines > ovr->nlines)
+    {
+        sprintf (errmsg, "Adding lines %d-%d to the overviews of a band with "
+            "%d lines.", ovr->line, ovr->line + nlines - 1, ovr->nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (l = 0; l < nlines; l++, ovr->line++)
+    {
+        src = (const char *) img_array + (size_t) l * ovr->nsamps *
+            ovr->nbytes;
+        if (ovr->average)
+            convert_line_to_double (ovr->data_type, src, ovr->nsamps,
+                ovr->dline);
+
+        for (k = 0; k < ovr->nlevels; k++)
+        {
+            lvl = &ovr->level[k];
+            f = lvl->factor;
+            row = ovr->line % f;
+            block_lines = ovr->nlines - (ovr->line - row);
+            if (block_lines > f)
+                block_lines = f;
+
+            if (ovr->average)
+            {
+                /* Sum the non-fill pixels; NaNs are skipped as well */
+                for (os = 0; os < lvl->nsamps; os++)
+                {
+                    s_end = (os + 1) * f;
+                    if (s_end > ovr->nsamps)
+                        s_end = ovr->nsamps;
+                    for (s = os * f; s < s_end; s++)
+                    {
+                        value = ovr->dline[s];
+                        if (value != value ||
+                            (ovr->use_fill && value == ovr->fill_value))
+                            continue;
+                        lvl->sum[os] += value;
+                        lvl->count[os]++;
+                    }
+                }
+            }
+            else if (row == (f / 2 < block_lines ? f / 2 : block_lines - 1))
+            {
+                /* Take the pixel nearest the center of each block */
+                for (os = 0; os < lvl->nsamps; os++)
+                {
+                    s = os * f + f / 2;
+                    if (s >= ovr->nsamps)
+                        s = ovr->nsamps - 1;
+                    memcpy ((char *) lvl->line_buf + (size_t) os *
+                        ovr->nbytes, src + (size_t) s * ovr->nbytes,
+                        ovr->nbytes);
+                }
+            }
+
+            /* Write the overview line at the end of its block */
+            if (row == block_lines - 1)
+            {
+                if (ovr->average)
+                    store_average_line (ovr, lvl);
+                if (write_raw_binary_writer (&lvl->rbw, 1, lvl->nsamps,
+                    ovr->nbytes, lvl->line_buf) != SUCCESS)
+                {
+                    sprintf (errmsg, "Writing line %d of the %dx overview %s.",
+                        ovr->line / f, f, lvl->file_name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_overviews
+
+PURPOSE: Completes the overview files and frees the buffers of the levels.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Not all the band lines were added, or an error occurred closing
+             the overview files
+SUCCESS      Closing was successful
+
+NOTES:
+*****************************************************************************/
+int close_raw_binary_overviews
+(
+    Raw_binary_overview_t *ovr   /* I/O: overviews to be completed */
+)
+{
+    char FUNC_NAME[] = "close_raw_binary_overviews"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+
+    if (ovr->line != ovr->nlines)
+    {
+        sprintf (errmsg, "Only %d of the %d band lines were added to the "
+            "overviews.", ovr->line, ovr->nlines);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (free_raw_binary_overviews (ovr) != SUCCESS)
+        status = ERROR;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: build_raw_binary_overviews
+
+PURPOSE: Builds the overview levels of a band in a single pass through the
+band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the band or writing the overviews
+SUCCESS      Building the overviews was successful
+
+NOTES:
+  1. The band is read RB_OVERVIEW_BLOCK_LINES lines at a time.
+*****************************************************************************/
+int build_raw_binary_overviews
+(
+    FILE *rb_fptr,               /* I: raw binary band, positioned at the
+                                       first line */
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    int nlevels,                 /* I: number of overview levels to build */
+    Raw_binary_overview_t *ovr   /* O: sizes and files of the levels built;
+                                       the levels are completed */
+)
+{
+    char FUNC_NAME[] = "build_raw_binary_overviews"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    void *block = NULL;      /* block of lines of the band */
+    int line;                /* first line of the current block */
+    int nlines;              /* number of lines in the current block */
+
+    if (open_raw_binary_overviews (bmeta, nlevels, ovr) != SUCCESS)
+        return (ERROR);
+
+    block = malloc ((size_t) RB_OVERVIEW_BLOCK_LINES * bmeta->nsamps *
+        ovr->nbytes);
+    if (block == NULL)
+    {
+        sprintf (errmsg, "Allocating the block of lines of band %s.",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_raw_binary_overviews (ovr);
+        return (ERROR);
+    }
+
+    for (line = 0; line < bmeta->nlines; line += nlines)
+    {
+        nlines = RB_OVERVIEW_BLOCK_LINES;
+        if (line + nlines > bmeta->nlines)
+            nlines = bmeta->nlines - line;
+
+        if (read_raw_binary (rb_fptr, nlines, bmeta->nsamps, ovr->nbytes,
+            block) != SUCCESS ||
+            add_raw_binary_overview_lines (ovr, nlines, block) != SUCCESS)
+        {
+            sprintf (errmsg, "Building the overviews of band %s from lines "
+                "%d-%d.", bmeta->name, line, line + nlines - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (block);
+            free_raw_binary_overviews (ovr);
+            return (ERROR);
+        }
+    }
+
+    free (block);
+    return (close_raw_binary_overviews (ovr));
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************
+FILE: raw_binary_overview.h
+  
+PURPOSE: Contains defines, structures, and prototypes for building the
+reduced-resolution overviews of a raw binary band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Overview level k (1-based) reduces the band by a factor of 2^k in each
+     direction, so the levels are 2x, 4x, 8x, and 16x.  Each level is written
+     as a sibling raw binary file of the band, with _ovr<factor> added before
+     the .img extension.
+  2. All the levels are built from the full resolution lines in a single
+     pass through the band, so the band only needs to be read once.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_OVERVIEW_H
+#define RAW_BINARY_OVERVIEW_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_io.h"
+
+/* Maximum number of overview levels (2x, 4x, 8x, and 16x) */
+#define RB_MAX_OVERVIEWS 4
+
+/* Number of lines of the band read at a time by build_raw_binary_overviews */
+#define RB_OVERVIEW_BLOCK_LINES 256
+
+/* A single overview level being built */
+typedef struct {
+    int factor;                 /* reduction factor of the level */
+    int nlines;                 /* number of lines in the level */
+    int nsamps;                 /* number of samples in the level */
+    char file_name[STR_SIZE];   /* name of the raw binary file of the level */
+    Raw_binary_writer_t rbw;    /* writer for the level */
+    double *sum;                /* sum of the non-fill pixels for each sample
+                                   of the current line (averaging only) */
+    int *count;                 /* number of non-fill pixels in sum */
+    void *line_buf;             /* current line of the level in the data type
+                                   of the band */
+} Raw_binary_overview_level_t;
+
+/* Overviews being built for a band */
+typedef struct {
+    enum Espa_data_type data_type;  /* data type of the band */
+    int nbytes;                 /* number of bytes per pixel */
+    int nlines;                 /* number of lines in the band */
+    int nsamps;                 /* number of samples in the band */
+    bool average;               /* are the pixels averaged (true), or is the
+                                   nearest neighbor used (false)? */
+    bool use_fill;              /* does the band have a fill value? */
+    double fill_value;          /* fill value of the band */
+    int line;                   /* next line of the band to be added */
+    double *dline;              /* current band line converted to double
+                                   (averaging only) */
+    int nlevels;                /* number of overview levels */
+    Raw_binary_overview_level_t level[RB_MAX_OVERVIEWS];  /* levels */
+} Raw_binary_overview_t;
+
+/* Prototypes */
+int get_raw_binary_overview_name
+(
+    char *img_file,        /* I: name of the raw binary band */
+    int factor,            /* I: reduction factor of the overview level */
+    char *ovr_file,        /* O: name of the overview file */
+    size_t ovr_size        /* I: size of the ovr_file buffer */
+);
+
+int open_raw_binary_overviews
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    int nlevels,                 /* I: number of overview levels to build
+                                       (1 to RB_MAX_OVERVIEWS) */
+    Raw_binary_overview_t *ovr   /* O: overviews being built */
+);
+
+int add_raw_binary_overview_lines
+(
+    Raw_binary_overview_t *ovr,  /* I/O: overviews being built */
+    int nlines,                  /* I: number of band lines in img_array */
+    void *img_array              /* I: next nlines full lines of the band */
+);
+
+int close_raw_binary_overviews
+(
+    Raw_binary_overview_t *ovr   /* I/O: overviews to be completed */
+);
+
+int build_raw_binary_overviews
+(
+    FILE *rb_fptr,               /* I: raw binary band, positioned at the
+                                       first line */
+    Espa_band_meta_t *bmeta,     /* I: metadata of the band */
+    int nlevels,                 /* I: number of overview levels to build */
+    Raw_binary_overview_t *ovr   /* O: sizes and files of the levels built;
+                                       the levels are completed */
+);
+
+#endif
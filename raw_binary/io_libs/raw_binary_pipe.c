@@ -0,0 +1,1015 @@
+/*****************************************************************************
+FILE: raw_binary_pipe.c
+
+PURPOSE: Contains functions for reading and writing the band streams, which
+carry raw binary bands and their metadata through pipes.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_pipe.h for the stream format.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "raw_binary_io.h"
+#include "raw_binary_pipe.h"
+#include "espa_profile.h"
+
+/* Types of the band header fields */
+typedef enum {
+  PIPE_STRING,          /* char [STR_SIZE] */
+  PIPE_INT,             /* int */
+  PIPE_LONG,            /* long */
+  PIPE_FLOAT,           /* float */
+  PIPE_FLOAT2,          /* float [2] */
+  PIPE_DOUBLE2,         /* double [2] */
+  PIPE_DATA_TYPE        /* enum Espa_data_type */
+} Pipe_field_type_t;
+
+/* Field of the band header */
+typedef struct {
+    const char *key;            /* name of the field in the header */
+    Pipe_field_type_t type;     /* type of the field */
+    size_t offset;              /* offset of the field in Espa_band_meta_t */
+} Pipe_field_t;
+
+/* Fields of Espa_band_meta_t carried by the band header */
+static const Pipe_field_t pipe_fields[] = {
+    {"name", PIPE_STRING, offsetof (Espa_band_meta_t, name)},
+    {"short_name", PIPE_STRING, offsetof (Espa_band_meta_t, short_name)},
+    {"long_name", PIPE_STRING, offsetof (Espa_band_meta_t, long_name)},
+    {"product", PIPE_STRING, offsetof (Espa_band_meta_t, product)},
+    {"source", PIPE_STRING, offsetof (Espa_band_meta_t, source)},
+    {"category", PIPE_STRING, offsetof (Espa_band_meta_t, category)},
+    {"file_name", PIPE_STRING, offsetof (Espa_band_meta_t, file_name)},
+    {"data_type", PIPE_DATA_TYPE, offsetof (Espa_band_meta_t, data_type)},
+    {"nlines", PIPE_INT, offsetof (Espa_band_meta_t, nlines)},
+    {"nsamps", PIPE_INT, offsetof (Espa_band_meta_t, nsamps)},
+    {"fill_value", PIPE_LONG, offsetof (Espa_band_meta_t, fill_value)},
+    {"saturate_value", PIPE_INT,
+        offsetof (Espa_band_meta_t, saturate_value)},
+    {"scale_factor", PIPE_FLOAT, offsetof (Espa_band_meta_t, scale_factor)},
+    {"add_offset", PIPE_FLOAT, offsetof (Espa_band_meta_t, add_offset)},
+    {"pixel_size", PIPE_DOUBLE2, offsetof (Espa_band_meta_t, pixel_size)},
+    {"pixel_units", PIPE_STRING, offsetof (Espa_band_meta_t, pixel_units)},
+    {"data_units", PIPE_STRING, offsetof (Espa_band_meta_t, data_units)},
+    {"valid_range", PIPE_FLOAT2, offsetof (Espa_band_meta_t, valid_range)},
+    {"app_version", PIPE_STRING, offsetof (Espa_band_meta_t, app_version)},
+    {"production_date", PIPE_STRING,
+        offsetof (Espa_band_meta_t, production_date)},
+    {NULL, PIPE_STRING, 0}
+};
+
+/* Names of the data types in the band header */
+static const char *pipe_data_type[] = {"INT8", "UINT8", "INT16", "UINT16",
+    "INT32", "UINT32", "FLOAT32", "FLOAT64"};
+
+/* Pipe opened by the process, kept open between its bands */
+typedef struct {
+    char name[STR_SIZE];        /* name of the pipe */
+    bool writing;               /* is the pipe written? */
+    int fd;                     /* file descriptor of the pipe */
+    bool busy;                  /* is a band open on the pipe? */
+} Pipe_entry_t;
+
+/* Pipes opened by the process, and the lock for them */
+static Pipe_entry_t pipe_table[RB_PIPE_MAX_OPEN];
+static int pipe_nopen = 0;
+static pthread_mutex_t pipe_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Band open on a pipe */
+typedef struct {
+    int entry;                  /* index of the pipe in pipe_table */
+    int fd;                     /* file descriptor of the pipe */
+    bool writing;               /* is the band being written? */
+    size_t line_bytes;          /* bytes per line of the band written; 0 if
+                                   not known */
+    uint64_t left;              /* bytes left in the line block being
+                                   read */
+    bool ended;                 /* was the end of the band read? */
+    bool failed;                /* did reading or writing the band fail? */
+} Pipe_stream_t;
+
+
+/******************************************************************************
+MODULE: is_raw_binary_pipe
+
+PURPOSE: Determines whether a band file is the standard input or output, or
+a FIFO.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The band is streamed through a pipe
+false        The band is a file or an object
+
+NOTES:
+*****************************************************************************/
+bool is_raw_binary_pipe
+(
+    const char *name    /* I: name of the band file */
+)
+{
+    struct stat statbuf;     /* status of the file */
+
+    if (!strcmp (name, RB_PIPE_STDIO))
+        return (true);
+
+    return (stat (name, &statbuf) == 0 && S_ISFIFO (statbuf.st_mode));
+}
+
+
+/******************************************************************************
+MODULE: acquire_pipe
+
+PURPOSE: Opens a pipe, or finds it already open, and marks it as having a
+band open.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           Error opening the pipe, or a band is already open on it
+other        Index of the pipe in pipe_table
+
+NOTES:
+*****************************************************************************/
+static int acquire_pipe
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    bool writing        /* I: is the pipe written? */
+)
+{
+    char FUNC_NAME[] = "acquire_pipe"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the pipes */
+    int fd;                  /* file descriptor of the pipe */
+
+    pthread_mutex_lock (&pipe_lock);
+    for (i = 0; i < pipe_nopen; i++)
+    {
+        if (pipe_table[i].writing == writing &&
+            !strcmp (pipe_table[i].name, name))
+            break;
+    }
+
+    if (i < pipe_nopen && pipe_table[i].busy)
+    {
+        pthread_mutex_unlock (&pipe_lock);
+        snprintf (errmsg, sizeof (errmsg), "A band is already open on pipe "
+            "%s.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (-1);
+    }
+
+    if (i == pipe_nopen)
+    {
+        if (pipe_nopen == RB_PIPE_MAX_OPEN || strlen (name) >= STR_SIZE)
+        {
+            pthread_mutex_unlock (&pipe_lock);
+            snprintf (errmsg, sizeof (errmsg), "Unable to open pipe %s; at "
+                "most %d pipes can be open.", name, RB_PIPE_MAX_OPEN);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (-1);
+        }
+
+        if (!strcmp (name, RB_PIPE_STDIO))
+        {
+            /* The stream takes over the standard output, and the messages
+               printed from here on go to the standard error instead */
+            if (writing)
+            {
+                fflush (stdout);
+                fd = dup (STDOUT_FILENO);
+                if (fd >= 0)
+                    dup2 (STDERR_FILENO, STDOUT_FILENO);
+            }
+            else
+                fd = STDIN_FILENO;
+        }
+        else
+            fd = open (name, (writing ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+        if (fd < 0)
+        {
+            pthread_mutex_unlock (&pipe_lock);
+            snprintf (errmsg, sizeof (errmsg), "Opening pipe %s: %s", name,
+                strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            return (-1);
+        }
+
+        strcpy (pipe_table[i].name, name);
+        pipe_table[i].writing = writing;
+        pipe_table[i].fd = fd;
+        pipe_nopen++;
+    }
+
+    pipe_table[i].busy = true;
+    pthread_mutex_unlock (&pipe_lock);
+
+    return (i);
+}
+
+
+/******************************************************************************
+MODULE: release_pipe
+
+PURPOSE: Marks a pipe as having no band open, leaving it open for the next
+band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void release_pipe
+(
+    int entry           /* I: index of the pipe in pipe_table */
+)
+{
+    pthread_mutex_lock (&pipe_lock);
+    pipe_table[entry].busy = false;
+    pthread_mutex_unlock (&pipe_lock);
+}
+
+
+/******************************************************************************
+MODULE: read_pipe_data
+
+PURPOSE: Reads bytes from a pipe, until all of them are read or the pipe is
+closed by the writer.
+
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           Error reading the pipe
+other        Number of bytes read; less than nbytes at the end of the pipe
+
+NOTES:
+*****************************************************************************/
+static ssize_t read_pipe_data
+(
+    int fd,             /* I: file descriptor of the pipe */
+    void *buf,          /* O: buffer of nbytes bytes */
+    size_t nbytes       /* I: number of bytes to be read */
+)
+{
+    size_t ngot = 0;         /* number of bytes read so far */
+    ssize_t nread;           /* number of bytes read by a call */
+
+    while (ngot < nbytes)
+    {
+        nread = read (fd, (char *) buf + ngot, nbytes - ngot);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0)
+            return (-1);
+        if (nread == 0)
+            break;
+        ngot += nread;
+    }
+
+    return (ngot);
+}
+
+
+/******************************************************************************
+MODULE: write_pipe_data
+
+PURPOSE: Writes all of a buffer to a pipe.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the pipe
+SUCCESS      All the bytes were written
+
+NOTES:
+*****************************************************************************/
+static int write_pipe_data
+(
+    int fd,             /* I: file descriptor of the pipe */
+    const void *buf,    /* I: data to be written */
+    size_t nbytes       /* I: number of bytes to be written */
+)
+{
+    size_t nput = 0;         /* number of bytes written so far */
+    ssize_t nwritten;        /* number of bytes written by a call */
+
+    while (nput < nbytes)
+    {
+        nwritten = write (fd, (const char *) buf + nput, nbytes - nput);
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+            return (ERROR);
+        nput += nwritten;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_pipe_record
+
+PURPOSE: Reads the next record of a band stream.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the record, or the stream ended
+SUCCESS      The record was read
+
+NOTES:
+*****************************************************************************/
+static int read_pipe_record
+(
+    int fd,             /* I: file descriptor of the pipe */
+    Raw_binary_pipe_record_t *rec  /* O: record read */
+)
+{
+    char FUNC_NAME[] = "read_pipe_record"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    ssize_t nread;           /* number of bytes read */
+
+    nread = read_pipe_data (fd, rec, sizeof (*rec));
+    if (nread != sizeof (*rec))
+    {
+        if (nread < 0)
+            snprintf (errmsg, sizeof (errmsg), "Reading the band stream: %s",
+                strerror (errno));
+        else
+            sprintf (errmsg, "Unexpected end of the band stream");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_pipe_record
+
+PURPOSE: Writes a record of a band stream, followed by its data.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the record
+SUCCESS      The record was written
+
+NOTES:
+*****************************************************************************/
+static int write_pipe_record
+(
+    int fd,             /* I: file descriptor of the pipe */
+    const char *magic,  /* I: record type */
+    uint32_t nlines,    /* I: nlines of the record */
+    const void *data,   /* I: data of the record; NULL if none */
+    size_t nbytes       /* I: number of bytes of data */
+)
+{
+    char FUNC_NAME[] = "write_pipe_record"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Raw_binary_pipe_record_t rec;  /* record */
+
+    memset (&rec, 0, sizeof (rec));
+    memcpy (rec.magic, magic, sizeof (rec.magic));
+    rec.nlines = nlines;
+    rec.nbytes = nbytes;
+
+    if (write_pipe_data (fd, &rec, sizeof (rec)) != SUCCESS ||
+        (nbytes > 0 && write_pipe_data (fd, data, nbytes) != SUCCESS))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing the band stream: %s",
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_pipe_band_header
+
+PURPOSE: Formats the band header of a band stream.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The header doesn't fit in the buffer
+other        Length of the header
+
+NOTES:
+  1. Each field is a "key = value" line; a field of two values has them
+     separated by a space.  Newlines in the strings are written as spaces.
+*****************************************************************************/
+static int write_pipe_band_header
+(
+    const Espa_band_meta_t *bmeta,  /* I: band metadata */
+    char *buf,          /* O: header */
+    size_t size         /* I: size of the buffer */
+)
+{
+    const Pipe_field_t *field = NULL;  /* current field */
+    const char *ptr = NULL;  /* field in the band metadata */
+    char *cptr = NULL;       /* current character of a string field */
+    size_t len = 0;          /* length of the header */
+    size_t start;            /* start of the current line */
+    int count;               /* number of chars copied in snprintf */
+    int dtype;               /* data type of the band */
+
+    for (field = pipe_fields; field->key != NULL; field++)
+    {
+        ptr = (const char *) bmeta + field->offset;
+        start = len;
+        switch (field->type)
+        {
+            case PIPE_STRING:
+                count = snprintf (buf + len, size - len, "%s = %s\n",
+                    field->key, ptr);
+                break;
+            case PIPE_INT:
+                count = snprintf (buf + len, size - len, "%s = %d\n",
+                    field->key, *(const int *) ptr);
+                break;
+            case PIPE_LONG:
+                count = snprintf (buf + len, size - len, "%s = %ld\n",
+                    field->key, *(const long *) ptr);
+                break;
+            case PIPE_FLOAT:
+                count = snprintf (buf + len, size - len, "%s = %.9g\n",
+                    field->key, *(const float *) ptr);
+                break;
+            case PIPE_FLOAT2:
+                count = snprintf (buf + len, size - len, "%s = %.9g %.9g\n",
+                    field->key, ((const float *) ptr)[0],
+                    ((const float *) ptr)[1]);
+                break;
+            case PIPE_DOUBLE2:
+                count = snprintf (buf + len, size - len,
+                    "%s = %.17g %.17g\n", field->key,
+                    ((const double *) ptr)[0], ((const double *) ptr)[1]);
+                break;
+            case PIPE_DATA_TYPE:
+            default:
+                dtype = *(const enum Espa_data_type *) ptr;
+                if (dtype < ESPA_INT8 || dtype > ESPA_FLOAT64)
+                    continue;
+                count = snprintf (buf + len, size - len, "%s = %s\n",
+                    field->key, pipe_data_type[dtype]);
+                break;
+        }
+        if (count < 0 || (size_t) count >= size - len)
+            return (ERROR);
+        len += count;
+
+        /* Keep the value of a string on its line */
+        for (cptr = buf + start; cptr < buf + len - 1; cptr++)
+        {
+            if (*cptr == '\n' || *cptr == '\r')
+                *cptr = ' ';
+        }
+    }
+
+    return ((int) len);
+}
+
+
+/******************************************************************************
+MODULE: read_pipe_band_header
+
+PURPOSE: Sets the band metadata from the band header of a band stream.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Lines which aren't a known "key = value" field are ignored.
+*****************************************************************************/
+static void read_pipe_band_header
+(
+    char *header,       /* I: header, NULL-terminated; modified */
+    Espa_band_meta_t *bmeta  /* I/O: band metadata */
+)
+{
+    const Pipe_field_t *field = NULL;  /* field of the current line */
+    char *line = NULL;       /* current line of the header */
+    char *next = NULL;       /* next line of the header */
+    char *value = NULL;      /* value of the current line */
+    char *ptr = NULL;        /* field in the band metadata */
+    int i;                   /* looping variable for the data types */
+
+    for (line = header; line != NULL && *line != '\0'; line = next)
+    {
+        next = strchr (line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+        value = strstr (line, " = ");
+        if (value == NULL)
+            continue;
+        *value = '\0';
+        value += 3;
+
+        for (field = pipe_fields; field->key != NULL; field++)
+        {
+            if (!strcmp (field->key, line))
+                break;
+        }
+        if (field->key == NULL)
+            continue;
+
+        ptr = (char *) bmeta + field->offset;
+        switch (field->type)
+        {
+            case PIPE_STRING:
+                snprintf (ptr, STR_SIZE, "%s", value);
+                break;
+            case PIPE_INT:
+                *(int *) ptr = atoi (value);
+                break;
+            case PIPE_LONG:
+                *(long *) ptr = atol (value);
+                break;
+            case PIPE_FLOAT:
+                *(float *) ptr = atof (value);
+                break;
+            case PIPE_FLOAT2:
+                sscanf (value, "%f %f", &((float *) ptr)[0],
+                    &((float *) ptr)[1]);
+                break;
+            case PIPE_DOUBLE2:
+                sscanf (value, "%lf %lf", &((double *) ptr)[0],
+                    &((double *) ptr)[1]);
+                break;
+            case PIPE_DATA_TYPE:
+            default:
+                for (i = ESPA_INT8; i <= ESPA_FLOAT64; i++)
+                {
+                    if (!strcmp (value, pipe_data_type[i]))
+                        *(enum Espa_data_type *) ptr = i;
+                }
+                break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE: pipe_stream_read
+
+PURPOSE: Read function of the stdio stream of a band on a pipe.
+
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           Error reading the band
+0            End of the band
+other        Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t pipe_stream_read
+(
+    void *cookie,       /* I/O: band on the pipe */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    char FUNC_NAME[] = "pipe_stream_read"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Pipe_stream_t *ps = cookie;  /* band on the pipe */
+    Raw_binary_pipe_record_t rec;  /* record of the stream */
+    ssize_t nread;           /* number of bytes read */
+
+    if (ps->writing || ps->failed)
+        return (-1);
+
+    /* Move to the next line block with data */
+    while (ps->left == 0)
+    {
+        if (ps->ended)
+            return (0);
+        if (read_pipe_record (ps->fd, &rec) != SUCCESS)
+        {
+            ps->failed = true;
+            return (-1);
+        }
+        if (!memcmp (rec.magic, RB_PIPE_END_MAGIC, sizeof (rec.magic)))
+            ps->ended = true;
+        else if (!memcmp (rec.magic, RB_PIPE_BLOCK_MAGIC,
+            sizeof (rec.magic)))
+            ps->left = rec.nbytes;
+        else
+        {
+            sprintf (errmsg, "Expected a line block in the band stream");
+            error_handler (true, FUNC_NAME, errmsg);
+            ps->failed = true;
+            return (-1);
+        }
+    }
+
+    if (size > ps->left)
+        size = ps->left;
+    nread = read_pipe_data (ps->fd, buf, size);
+    if (nread != (ssize_t) size)
+    {
+        sprintf (errmsg, "Unexpected end of a line block in the band stream");
+        error_handler (true, FUNC_NAME, errmsg);
+        ps->failed = true;
+        return (-1);
+    }
+    ps->left -= nread;
+    espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_PIPE, nread);
+
+    return (nread);
+}
+
+
+/******************************************************************************
+MODULE: pipe_stream_write
+
+PURPOSE: Write function of the stdio stream of a band on a pipe.
+
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+0            Error writing the band
+other        Number of bytes written
+
+NOTES:
+  1. Each write is a line block.  The stream buffer is a whole number of
+     lines, so the blocks are whole lines unless the band is written in
+     pieces of lines.
+*****************************************************************************/
+static ssize_t pipe_stream_write
+(
+    void *cookie,       /* I/O: band on the pipe */
+    const char *buf,    /* I: data to be written */
+    size_t size         /* I: number of bytes to be written */
+)
+{
+    Pipe_stream_t *ps = cookie;  /* band on the pipe */
+    uint32_t nlines = 0;     /* number of whole lines in the block */
+
+    if (!ps->writing || ps->failed)
+        return (0);
+
+    if (ps->line_bytes > 0 && size % ps->line_bytes == 0)
+        nlines = size / ps->line_bytes;
+    if (write_pipe_record (ps->fd, RB_PIPE_BLOCK_MAGIC, nlines, buf, size)
+        != SUCCESS)
+    {
+        ps->failed = true;
+        return (0);
+    }
+    espa_profile_count_io (ESPA_PROFILE_WRITE, ESPA_PROFILE_PIPE, size);
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: pipe_stream_close
+
+PURPOSE: Close function of the stdio stream of a band on a pipe.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           Error ending the band
+0            Closing was successful
+
+NOTES:
+  1. A band written is ended with the end record.  A band read is skipped
+     to its end record if it wasn't read to the end.  The pipe is left
+     open for the next band either way.
+*****************************************************************************/
+static int pipe_stream_close
+(
+    void *cookie        /* I: band on the pipe */
+)
+{
+    Pipe_stream_t *ps = cookie;  /* band on the pipe */
+    char buf[BUFSIZ];        /* data of the band skipped */
+    int status = 0;          /* return status */
+
+    if (ps->writing)
+    {
+        if (ps->failed || write_pipe_record (ps->fd, RB_PIPE_END_MAGIC, 0,
+            NULL, 0) != SUCCESS)
+            status = -1;
+    }
+    else
+    {
+        while (!ps->ended && !ps->failed)
+            pipe_stream_read (ps, buf, sizeof (buf));
+        if (ps->failed)
+            status = -1;
+    }
+
+    release_pipe (ps->entry);
+    free (ps);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_pipe
+
+PURPOSE: Opens the next band of a pipe for reading, or starts a band on a
+pipe for writing, as a stdio stream of the band data.
+
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the pipe, or reading or writing the band header
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. The stream has no file descriptor; fileno returns -1.  It can't be
+     seeked.  fclose ends the band (see pipe_stream_close) and returns EOF
+     if that fails.
+  2. The blocks written are RB_PIPE_BLOCK_SIZE bytes, rounded down to a
+     whole number of lines if the band metadata gives the band size.
+*****************************************************************************/
+FILE *open_raw_binary_pipe
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    const char *access_type,  /* I: "rb" to read a band or "wb" to write
+                                 one */
+    Espa_band_meta_t *bmeta   /* I/O: band read: set from the band header,
+                                 if not NULL; band written: written as its
+                                 header, or an empty header if NULL */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_pipe"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *header = NULL;     /* band header */
+    int len = 0;             /* length of the band header */
+    int status = SUCCESS;    /* status of the band header */
+    size_t block_size = RB_PIPE_BLOCK_SIZE;  /* size of the line blocks */
+    FILE *fptr = NULL;       /* stream for the band */
+    Pipe_stream_t *ps = NULL;  /* band on the pipe */
+    Raw_binary_pipe_record_t rec;  /* record of the band header */
+    cookie_io_functions_t funcs =         /* stream functions */
+        {pipe_stream_read, pipe_stream_write, NULL, pipe_stream_close};
+
+    ps = calloc (1, sizeof (Pipe_stream_t));
+    header = malloc (RB_PIPE_MAX_HEADER + 1);
+    if (ps == NULL || header == NULL)
+    {
+        sprintf (errmsg, "Allocating the stream for pipe %s.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (ps);
+        free (header);
+        return (NULL);
+    }
+    ps->writing = (access_type[0] == 'w');
+
+    ps->entry = acquire_pipe (name, ps->writing);
+    if (ps->entry < 0)
+    {
+        free (ps);
+        free (header);
+        return (NULL);
+    }
+    ps->fd = pipe_table[ps->entry].fd;
+
+    if (ps->writing)
+    {
+        /* Write the band header, and size the blocks to whole lines */
+        if (bmeta != NULL)
+        {
+            len = write_pipe_band_header (bmeta, header,
+                RB_PIPE_MAX_HEADER + 1);
+            if (bmeta->nsamps > 0)
+                ps->line_bytes = (size_t) bmeta->nsamps *
+                    get_data_type_size (bmeta->data_type);
+        }
+        if (len < 0)
+        {
+            sprintf (errmsg, "Band header of pipe %s is too long.", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+            status = write_pipe_record (ps->fd, RB_PIPE_BAND_MAGIC,
+                RB_PIPE_VERSION, header, len);
+        if (ps->line_bytes > 0 && ps->line_bytes <= block_size)
+            block_size = block_size / ps->line_bytes * ps->line_bytes;
+        else if (ps->line_bytes > 0)
+            block_size = ps->line_bytes;
+    }
+    else
+    {
+        /* Read the band header */
+        status = read_pipe_record (ps->fd, &rec);
+        if (status == SUCCESS && (memcmp (rec.magic, RB_PIPE_BAND_MAGIC,
+            sizeof (rec.magic)) || rec.nbytes > RB_PIPE_MAX_HEADER))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Pipe %s doesn't start a band "
+                "of a band stream.", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (status == SUCCESS && read_pipe_data (ps->fd, header, rec.nbytes)
+            != (ssize_t) rec.nbytes)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Reading the band header of "
+                "pipe %s.", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (status == SUCCESS && bmeta != NULL)
+        {
+            header[rec.nbytes] = '\0';
+            read_pipe_band_header (header, bmeta);
+        }
+    }
+    free (header);
+    if (status != SUCCESS)
+    {
+        release_pipe (ps->entry);
+        free (ps);
+        return (NULL);
+    }
+
+    fptr = fopencookie (ps, ps->writing ? "wb" : "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for pipe %s.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        release_pipe (ps->entry);
+        free (ps);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, ps->writing ? block_size : BUFSIZ);
+
+    return (fptr);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_pipe_product
+
+PURPOSE: Writes the XML metadata of a product to a pipe, starting the band
+stream of the product.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the XML file or writing the pipe
+SUCCESS      The XML metadata was written
+
+NOTES:
+  1. The bands of the product are then written with open_raw_binary_pipe,
+     in the order of the XML.
+*****************************************************************************/
+int write_raw_binary_pipe_product
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    const char *xml_file  /* I: XML metadata file of the product */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_pipe_product"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *xml = NULL;        /* contents of the XML file */
+    long size;               /* size of the XML file */
+    int entry;               /* index of the pipe in pipe_table */
+    int status;              /* return status */
+    FILE *fp = NULL;         /* XML file */
+
+    fp = fopen (xml_file, "rb");
+    if (fp == NULL || fseek (fp, 0, SEEK_END) != 0 ||
+        (size = ftell (fp)) < 0 || size > RB_PIPE_MAX_PRODUCT ||
+        fseek (fp, 0, SEEK_SET) != 0 || (xml = malloc (size + 1)) == NULL ||
+        fread (xml, 1, size, fp) != (size_t) size)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Reading XML file %s for the band "
+            "stream.", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (fp != NULL)
+            fclose (fp);
+        free (xml);
+        return (ERROR);
+    }
+    fclose (fp);
+
+    entry = acquire_pipe (name, true);
+    if (entry < 0)
+    {
+        free (xml);
+        return (ERROR);
+    }
+    status = write_pipe_record (pipe_table[entry].fd, RB_PIPE_PRODUCT_MAGIC,
+        0, xml, size);
+    release_pipe (entry);
+    free (xml);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_pipe_product
+
+PURPOSE: Reads the XML metadata of a product from the start of its band
+stream, and writes it to an XML file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the pipe or writing the XML file
+SUCCESS      The XML file was written
+
+NOTES:
+  1. The bands of the product are then read with open_raw_binary_pipe, in
+     the order of the XML.
+*****************************************************************************/
+int read_raw_binary_pipe_product
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    const char *xml_file  /* I: XML metadata file to be written */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_pipe_product"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *xml = NULL;        /* contents of the XML file */
+    int entry;               /* index of the pipe in pipe_table */
+    int status;              /* return status */
+    FILE *fp = NULL;         /* XML file */
+    Raw_binary_pipe_record_t rec;  /* product record */
+
+    entry = acquire_pipe (name, false);
+    if (entry < 0)
+        return (ERROR);
+
+    status = read_pipe_record (pipe_table[entry].fd, &rec);
+    if (status == SUCCESS && (memcmp (rec.magic, RB_PIPE_PRODUCT_MAGIC,
+        sizeof (rec.magic)) || rec.nbytes > RB_PIPE_MAX_PRODUCT))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Pipe %s doesn't start the band "
+            "stream of a product.", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    if (status == SUCCESS)
+    {
+        xml = malloc (rec.nbytes + 1);
+        if (xml == NULL || read_pipe_data (pipe_table[entry].fd, xml,
+            rec.nbytes) != (ssize_t) rec.nbytes)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Reading the XML metadata "
+                "from pipe %s.", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    release_pipe (entry);
+
+    if (status == SUCCESS)
+    {
+        fp = fopen (xml_file, "wb");
+        if (fp == NULL || fwrite (xml, 1, rec.nbytes, fp) != rec.nbytes)
+            status = ERROR;
+        if (fp != NULL && fclose (fp) != 0)
+            status = ERROR;
+        if (status != SUCCESS)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Writing XML file %s from the "
+                "band stream.", xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+    }
+    free (xml);
+
+    return (status);
+}
@@ -0,0 +1,107 @@
+/*****************************************************************************
+FILE: raw_binary_pipe.h
+
+PURPOSE: Contains defines, structures, and prototypes for the band streams,
+which carry raw binary bands and their metadata through pipes between the
+tools.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A band stream is a sequence of records, each a Raw_binary_pipe_record_t
+     followed by nbytes of data.  A band is a RB_PIPE_BAND_MAGIC record,
+     whose data is a text header of "key = value" lines with the fields of
+     its Espa_band_meta_t (see raw_binary_pipe.c), then
+     RB_PIPE_BLOCK_MAGIC records holding the band data in blocks of whole
+     lines, then a RB_PIPE_END_MAGIC record.  A stream of a whole product
+     starts with a RB_PIPE_PRODUCT_MAGIC record holding its XML metadata,
+     followed by its bands in the order of the XML.  The numbers are in the
+     byte order of the host.
+  2. A band named "-" is on the standard input (read) or output (write),
+     and a band whose file is a FIFO is streamed through the FIFO.
+     open_raw_binary opens them as stdio streams (with no file descriptor)
+     of the band data, so they're read and written the same as a band on
+     disk, in order.  Pipes can't be opened for update, mapped or seeked.
+     Once a band is written to the standard output, stdout is redirected to
+     the standard error, so the messages printed don't corrupt the stream.
+  3. The pipe is kept open after a band is closed, so several bands are
+     streamed through it one after another, and only one band may be open
+     on a pipe at a time.  A band closed before it is read to the end is
+     skipped to its end, so the next band is read from its start.
+  4. A header field the reader doesn't know is ignored, and a field the
+     writer doesn't have is left as initialized, so the header can grow.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_PIPE_H
+#define RAW_BINARY_PIPE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Name of the band on the standard input or output */
+#define RB_PIPE_STDIO "-"
+
+/* Record types of a band stream */
+#define RB_PIPE_PRODUCT_MAGIC "ESPX"
+#define RB_PIPE_BAND_MAGIC "ESPB"
+#define RB_PIPE_BLOCK_MAGIC "LBLK"
+#define RB_PIPE_END_MAGIC "LEND"
+
+/* Version of the band header */
+#define RB_PIPE_VERSION 1
+
+/* Largest band header and product XML in a stream */
+#define RB_PIPE_MAX_HEADER (64 * 1024)
+#define RB_PIPE_MAX_PRODUCT (64 * 1024 * 1024)
+
+/* Size of the line blocks written, rounded down to whole lines */
+#define RB_PIPE_BLOCK_SIZE (1024 * 1024)
+
+/* Maximum number of pipes open at once */
+#define RB_PIPE_MAX_OPEN 16
+
+/* Record of a band stream */
+typedef struct {
+    char magic[4];              /* record type, not NULL-terminated */
+    uint32_t nlines;            /* lines in a line block, or the version of
+                                   a band header; 0 otherwise */
+    uint64_t nbytes;            /* number of bytes following the record */
+} Raw_binary_pipe_record_t;
+
+/* Prototypes */
+bool is_raw_binary_pipe
+(
+    const char *name    /* I: name of the band file */
+);
+
+FILE *open_raw_binary_pipe
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    const char *access_type,  /* I: "rb" to read a band or "wb" to write
+                                 one */
+    Espa_band_meta_t *bmeta   /* I/O: band read: set from the band header,
+                                 if not NULL; band written: written as its
+                                 header, or an empty header if NULL */
+);
+
+int write_raw_binary_pipe_product
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    const char *xml_file  /* I: XML metadata file of the product */
+);
+
+int read_raw_binary_pipe_product
+(
+    const char *name,   /* I: "-" or the name of a FIFO */
+    const char *xml_file  /* I: XML metadata file to be written */
+);
+
+#endif
@@ -0,0 +1,322 @@
+/*****************************************************************************
+FILE: raw_binary_pool.c
+
+PURPOSE: Contains functions for the pool of aligned buffers for blocks of raw
+binary lines, so the stages and scenes of a process reuse warm memory rather
+than paying for the page faults and zeroing of new buffers each time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each buffer is mapped with a header page in front of it, holding its
+     size class and the link to the next free buffer of the class.  Buffers
+     larger than the largest size class are mapped to their size and are
+     unmapped when released.
+  2. New mappings are already zero, so only recycled buffers are zeroed
+     when the caller asks for it.
+  3. With NUMA placement on (see espa_numa.h), the free buffers are kept
+     per node, so a thread only gets back buffers first touched on its own
+     node.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "error_handler.h"
+#include "espa_memory.h"
+#include "espa_numa.h"
+#include "espa_profile.h"
+#include "raw_binary_io.h"
+#include "raw_binary_pool.h"
+
+/* Marks the header of a pool buffer */
+#define POOL_MAGIC 0x45535042u
+
+/* Header in the page in front of each buffer */
+typedef struct pool_header
+{
+    uint32_t magic;             /* POOL_MAGIC */
+    int size_class;             /* size class; -1 if larger than the classes */
+    int node;                   /* NUMA node of the thread which mapped it */
+    size_t map_size;            /* size of the mapping, with the header */
+    struct pool_header *next;   /* next free buffer of the size class */
+} Pool_header_t;
+
+/* Pool mode: -1 until the environment is read, then 0 (off), 1 (on) or
+   2 (huge pages) */
+static int pool_mode = -1;
+static pthread_once_t pool_mode_once = PTHREAD_ONCE_INIT;
+
+/* Free buffers of each NUMA node and size class, and their number and total
+   size */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static Pool_header_t *pool_free[ESPA_NUMA_MAX_NODES][RB_POOL_NCLASSES];
+static int pool_nfree[ESPA_NUMA_MAX_NODES][RB_POOL_NCLASSES];
+static size_t pool_cached = 0;
+
+/* Total size of the buffers handed out and not yet released, for the
+   profiler's buffer pool gauge */
+static long long pool_in_use = 0;
+
+/******************************************************************************
+MODULE: init_pool_mode
+
+PURPOSE: Reads the pool mode from the ESPA_BUFFER_POOL environment variable.
+ 
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. An unknown mode is reported as a warning and the default is used.
+*****************************************************************************/
+static void init_pool_mode (void)
+{
+    char FUNC_NAME[] = "init_pool_mode";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *mode = getenv ("ESPA_BUFFER_POOL");  /* requested mode */
+
+    pool_mode = 1;
+    if (mode == NULL || mode[0] == '\0' || !strcmp (mode, "on"))
+        return;
+
+    if (!strcmp (mode, "off"))
+        pool_mode = 0;
+    else if (!strcmp (mode, "huge"))
+        pool_mode = 2;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown ESPA_BUFFER_POOL %s; "
+            "using on", mode);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+}
+
+
+/******************************************************************************
+MODULE: get_pool_size_class
+
+PURPOSE: Returns the size class of a buffer.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The buffer is larger than the largest size class
+other        Size class of the buffer
+
+NOTES:
+*****************************************************************************/
+static int get_pool_size_class
+(
+    size_t nbytes       /* I: number of bytes in the buffer */
+)
+{
+    int size_class;          /* size class of the buffer */
+
+    for (size_class = 0; size_class < RB_POOL_NCLASSES; size_class++)
+    {
+        if (nbytes <= ((size_t) RB_POOL_MIN_SIZE << size_class))
+            return (size_class);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_buffer
+
+PURPOSE: Returns an aligned buffer from the pool, mapping a new one if there
+isn't a free buffer of its size class.
+ 
+RETURN VALUE:
+Type = void *
+Value        Description
+-----        -----------
+NULL         Error mapping the buffer
+non-NULL     Pointer to the buffer; release it with release_raw_binary_buffer
+
+NOTES:
+  1. A buffer which isn't zeroed holds whatever its last user left in it.
+*****************************************************************************/
+void *get_raw_binary_buffer
+(
+    size_t nbytes,      /* I: number of bytes needed */
+    bool zero           /* I: should the buffer be zeroed? */
+)
+{
+    int size_class;          /* size class of the buffer */
+    int node = espa_numa_node ();  /* NUMA node of the calling thread */
+    size_t map_size;         /* size of the mapping, with the header */
+    size_t cached = 0;       /* bytes of free buffers left in the pool */
+    void *map = NULL;        /* new mapping */
+    Pool_header_t *hdr = NULL;  /* header of the buffer */
+
+    pthread_once (&pool_mode_once, init_pool_mode);
+    if (nbytes == 0)
+        nbytes = 1;
+    size_class = get_pool_size_class (nbytes);
+
+    /* Reuse a free buffer of the size class */
+    if (size_class >= 0)
+    {
+        pthread_mutex_lock (&pool_lock);
+        hdr = pool_free[node][size_class];
+        if (hdr != NULL)
+        {
+            pool_free[node][size_class] = hdr->next;
+            pool_nfree[node][size_class]--;
+            pool_cached -= hdr->map_size;
+            cached = pool_cached;
+        }
+        pthread_mutex_unlock (&pool_lock);
+
+        if (hdr != NULL)
+        {
+            espa_profile_set_gauge (ESPA_PROFILE_POOL_CACHED, cached);
+            espa_profile_set_gauge (ESPA_PROFILE_POOL_IN_USE,
+                __atomic_add_fetch (&pool_in_use, hdr->map_size,
+                __ATOMIC_RELAXED));
+            hdr->next = NULL;
+            if (zero)
+                memset ((char *) hdr + RB_DIRECT_ALIGN, 0, nbytes);
+            return ((char *) hdr + RB_DIRECT_ALIGN);
+        }
+        map_size = RB_DIRECT_ALIGN + ((size_t) RB_POOL_MIN_SIZE << size_class);
+    }
+    else
+        map_size = RB_DIRECT_ALIGN + (nbytes + RB_DIRECT_ALIGN - 1) /
+            RB_DIRECT_ALIGN * RB_DIRECT_ALIGN;
+
+    map = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return (NULL);
+#ifdef MADV_HUGEPAGE
+    if (pool_mode == 2 && map_size - RB_DIRECT_ALIGN >= RB_POOL_HUGE_SIZE)
+        madvise (map, map_size, MADV_HUGEPAGE);
+#endif
+
+    hdr = map;
+    hdr->magic = POOL_MAGIC;
+    hdr->size_class = size_class;
+    hdr->node = node;
+    hdr->map_size = map_size;
+    hdr->next = NULL;
+    espa_profile_set_gauge (ESPA_PROFILE_POOL_IN_USE,
+        __atomic_add_fetch (&pool_in_use, map_size, __ATOMIC_RELAXED));
+    return ((char *) map + RB_DIRECT_ALIGN);
+}
+
+
+/******************************************************************************
+MODULE: release_raw_binary_buffer
+
+PURPOSE: Returns a buffer to the pool, or unmaps it if the pool is off or
+already holds enough free buffers.
+ 
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+void release_raw_binary_buffer
+(
+    void *buf           /* I: buffer from get_raw_binary_buffer, or NULL */
+)
+{
+    char FUNC_NAME[] = "release_raw_binary_buffer";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    size_t max_cached = RB_POOL_MAX_CACHED;   /* most bytes kept */
+    size_t budget = espa_memory_budget ();    /* memory budget */
+    size_t cached = 0;       /* bytes of free buffers in the pool */
+    Pool_header_t *hdr = NULL;  /* header of the buffer */
+    bool keep = false;       /* is the buffer kept by the pool? */
+
+    if (buf == NULL)
+        return;
+
+    hdr = (Pool_header_t *) ((char *) buf - RB_DIRECT_ALIGN);
+    if (hdr->magic != POOL_MAGIC)
+    {
+        sprintf (errmsg, "Releasing a buffer which isn't from the pool");
+        error_handler (true, FUNC_NAME, errmsg);
+        return;
+    }
+
+    if (budget > 0 && budget / 4 < max_cached)
+        max_cached = budget / 4;
+
+    if (pool_mode != 0 && hdr->size_class >= 0)
+    {
+        pthread_mutex_lock (&pool_lock);
+        if (pool_nfree[hdr->node][hdr->size_class] < RB_POOL_MAX_FREE &&
+            pool_cached + hdr->map_size <= max_cached)
+        {
+            hdr->next = pool_free[hdr->node][hdr->size_class];
+            pool_free[hdr->node][hdr->size_class] = hdr;
+            pool_nfree[hdr->node][hdr->size_class]++;
+            pool_cached += hdr->map_size;
+            cached = pool_cached;
+            keep = true;
+        }
+        pthread_mutex_unlock (&pool_lock);
+    }
+
+    espa_profile_set_gauge (ESPA_PROFILE_POOL_IN_USE,
+        __atomic_sub_fetch (&pool_in_use, hdr->map_size, __ATOMIC_RELAXED));
+    if (keep)
+        espa_profile_set_gauge (ESPA_PROFILE_POOL_CACHED, cached);
+
+    if (!keep)
+    {
+        hdr->magic = 0;
+        munmap (hdr, hdr->map_size);
+    }
+}
+
+
+/******************************************************************************
+MODULE: trim_raw_binary_pool
+
+PURPOSE: Unmaps the free buffers held by the pool.
+ 
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The buffers still in use aren't affected, and are kept by the pool as
+     usual when they're released.
+*****************************************************************************/
+void trim_raw_binary_pool (void)
+{
+    int node;                /* looping variable for the NUMA nodes */
+    int size_class;          /* looping variable for the size classes */
+    Pool_header_t *hdr = NULL;  /* header of a free buffer */
+    Pool_header_t *next = NULL; /* header of the next free buffer */
+
+    pthread_mutex_lock (&pool_lock);
+    for (node = 0; node < ESPA_NUMA_MAX_NODES; node++)
+    {
+        for (size_class = 0; size_class < RB_POOL_NCLASSES; size_class++)
+        {
+            for (hdr = pool_free[node][size_class]; hdr != NULL; hdr = next)
+            {
+                next = hdr->next;
+                hdr->magic = 0;
+                munmap (hdr, hdr->map_size);
+            }
+            pool_free[node][size_class] = NULL;
+            pool_nfree[node][size_class] = 0;
+        }
+    }
+    pool_cached = 0;
+    pthread_mutex_unlock (&pool_lock);
+    espa_profile_set_gauge (ESPA_PROFILE_POOL_CACHED, 0);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+FILE: raw_binary_pool.h
+
+PURPOSE: Contains defines and prototypes for the pool of aligned buffers for
+blocks of raw binary lines, which are recycled between the stages and scenes
+of a process instead of being allocated and freed by each one.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The buffers are in size classes, each twice the size of the one before,
+     starting at RB_POOL_MIN_SIZE.  A released buffer is kept for the next
+     request of its size class, so its pages are already faulted in.
+  2. The buffers are aligned to RB_DIRECT_ALIGN bytes (a page), which also
+     aligns them to the cache lines and for O_DIRECT writes.
+  3. The pool is selected via the ESPA_BUFFER_POOL environment variable:
+     "on" (the default) keeps the released buffers, "huge" also advises the
+     kernel to back the buffers of RB_POOL_HUGE_SIZE bytes or more with
+     transparent huge pages, and "off" unmaps each buffer when released.
+  4. The pool is thread safe.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_POOL_H
+#define RAW_BINARY_POOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Defines */
+/* Size of the smallest size class (bytes) */
+#define RB_POOL_MIN_SIZE (64 * 1024)
+
+/* Number of size classes; larger buffers aren't kept by the pool */
+#define RB_POOL_NCLASSES 16
+
+/* Maximum number of released buffers kept in each size class, per NUMA
+   node */
+#define RB_POOL_MAX_FREE 4
+
+/* Maximum number of bytes of released buffers kept by the pool; a quarter
+   of the memory budget if that is smaller (see espa_memory.h) */
+#define RB_POOL_MAX_CACHED (512 * 1024 * 1024)
+
+/* Smallest buffer advised to use huge pages when ESPA_BUFFER_POOL is
+   "huge" */
+#define RB_POOL_HUGE_SIZE (2 * 1024 * 1024)
+
+/* Prototypes */
+void *get_raw_binary_buffer
+(
+    size_t nbytes,      /* I: number of bytes needed */
+    bool zero           /* I: should the buffer be zeroed? */
+);
+
+void release_raw_binary_buffer
+(
+    void *buf           /* I: buffer from get_raw_binary_buffer, or NULL */
+);
+
+void trim_raw_binary_pool (void);
+
+#endif
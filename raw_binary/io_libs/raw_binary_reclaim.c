@@ -0,0 +1,210 @@
+/*****************************************************************************
+FILE: raw_binary_reclaim.c
+  
+PURPOSE: Contains functions for releasing the disk blocks of the source bands
+as a format conversion consumes them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_reclaim.h.  Reclamation is advisory: a file which can't
+     be opened for writing or a file system without hole punching just
+     leaves the source files to be removed after the conversion.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "raw_binary_reclaim.h"
+#include "raw_binary_io.h"
+#include "raw_binary_tiff.h"
+#include "raw_binary_constant.h"
+#include "raw_binary_tiled.h"
+#include "raw_binary_derived.h"
+
+/******************************************************************************
+MODULE: get_raw_binary_reclaim_mode
+
+PURPOSE: Returns whether reclamation of the source bands was requested via
+the ESPA_RECLAIM_SOURCE environment variable.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_RECLAIM_SOURCE is "yes"
+false        ESPA_RECLAIM_SOURCE isn't set, or is anything else
+
+NOTES:
+  1. It only applies to conversions which remove their source files.
+*****************************************************************************/
+bool get_raw_binary_reclaim_mode ()
+{
+    char *mode = getenv ("ESPA_RECLAIM_SOURCE");  /* requested mode */
+
+    return (mode != NULL && !strcmp (mode, "yes"));
+}
+
+
+/******************************************************************************
+MODULE: can_reclaim_raw_binary_sources
+
+PURPOSE: Determines whether the source bands of the product can be
+reclaimed as they're converted.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         Reclamation was requested and no band depends on another
+false        The source bands need to be left intact until the end
+
+NOTES:
+  1. A lazy derived band is computed from the other bands when it's read,
+     so they can't be reclaimed before it's converted.
+*****************************************************************************/
+bool can_reclaim_raw_binary_sources
+(
+    Espa_internal_meta_t *xml_metadata  /* I: metadata of the source
+                                              product */
+)
+{
+    int i;                   /* looping variable for the bands */
+    int fd;                  /* file descriptor of the current band */
+    bool derived;            /* is the current band a derived band? */
+
+    if (!get_raw_binary_reclaim_mode ())
+        return (false);
+
+    for (i = 0; i < xml_metadata->nbands; i++)
+    {
+        fd = open (xml_metadata->band[i].file_name, O_RDONLY);
+        if (fd == -1)
+            continue;
+        derived = is_raw_binary_derived (fd);
+        close (fd);
+        if (derived)
+        {
+            printf ("Band %s is derived from the other bands, so the source "
+                "bands aren't reclaimed\n", xml_metadata->band[i].name);
+            return (false);
+        }
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_reclaim
+
+PURPOSE: Sets up the reclamation of a source band.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. If reclaim isn't set, or the band isn't a plain raw binary band which
+     can be opened for writing, nothing is reclaimed from it.
+*****************************************************************************/
+void open_raw_binary_reclaim
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the source band */
+    bool reclaim,                /* I: should the band be reclaimed? */
+    Raw_binary_reclaim_t *rcl    /* O: reclamation of the band */
+)
+{
+    memset (rcl, 0, sizeof (Raw_binary_reclaim_t));
+    strncpy (rcl->file_name, bmeta->file_name, sizeof (rcl->file_name) - 1);
+    rcl->line_bytes = (size_t) bmeta->nsamps *
+        get_data_type_size (bmeta->data_type);
+    rcl->fd = -1;
+    if (!reclaim)
+        return;
+
+    rcl->fd = open (bmeta->file_name, O_RDWR);
+    if (rcl->fd == -1)
+        return;
+
+    /* Encoded bands aren't the band data itself */
+    if (is_raw_binary_chunked (rcl->fd) ||
+        is_raw_binary_tiff (rcl->file_name, rcl->fd) ||
+        is_raw_binary_constant (rcl->fd) || is_raw_binary_derived (rcl->fd) ||
+        is_raw_binary_tiled (rcl->fd))
+    {
+        close (rcl->fd);
+        rcl->fd = -1;
+    }
+}
+
+
+/******************************************************************************
+MODULE: reclaim_raw_binary_lines
+
+PURPOSE: Releases the disk blocks of the lines at the start of the source
+band which have been consumed.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. Only whole RB_DIRECT_ALIGN blocks are released, so the lines not yet
+     consumed are never touched.
+  2. If the file system can't punch holes, a warning is written and nothing
+     more is reclaimed from the band.
+*****************************************************************************/
+void reclaim_raw_binary_lines
+(
+    Raw_binary_reclaim_t *rcl,   /* I/O: reclamation of the band */
+    int nlines                   /* I: number of lines at the start of the
+                                       band which have been consumed */
+)
+{
+    char FUNC_NAME[] = "reclaim_raw_binary_lines"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    off_t end;               /* end of the blocks to be released */
+
+    if (rcl->fd == -1)
+        return;
+
+    end = (off_t) nlines * rcl->line_bytes;
+    end -= end % RB_DIRECT_ALIGN;
+    if (end <= rcl->reclaimed)
+        return;
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (fallocate (rcl->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+        rcl->reclaimed, end - rcl->reclaimed) == 0)
+    {
+        rcl->reclaimed = end;
+        return;
+    }
+#endif
+
+    sprintf (errmsg, "Holes can't be punched in %s, so it's removed after "
+        "the conversion instead.", rcl->file_name);
+    error_handler (false, FUNC_NAME, errmsg);
+    close_raw_binary_reclaim (rcl);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_reclaim
+
+PURPOSE: Ends the reclamation of a source band.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_reclaim
+(
+    Raw_binary_reclaim_t *rcl    /* I/O: reclamation of the band */
+)
+{
+    if (rcl->fd != -1)
+        close (rcl->fd);
+    rcl->fd = -1;
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+FILE: raw_binary_reclaim.h
+  
+PURPOSE: Contains defines, structures, and prototypes for releasing the disk
+blocks of the source bands as a format conversion consumes them.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A conversion which removes its source files (del_src) normally removes
+     them once they're converted, so the source and the converted product
+     are both on disk until then.  With reclamation on (see
+     get_raw_binary_reclaim_mode), the lines of a source band already
+     converted are punched out of its file (FALLOC_FL_PUNCH_HOLE) while the
+     conversion runs, keeping the peak disk usage close to the size of the
+     product.
+  2. The source files are no longer usable once reclaimed, so a conversion
+     which fails part way through can't be run again from them.
+  3. Only plain raw binary bands are reclaimed.  Compressed (chunked),
+     GeoTIFF, constant and derived bands are left alone, and nothing is
+     reclaimed from a product with a derived band, since it's computed from
+     the other bands (see can_reclaim_raw_binary_sources).
+*****************************************************************************/
+
+#ifndef RAW_BINARY_RECLAIM_H
+#define RAW_BINARY_RECLAIM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Source band being reclaimed */
+typedef struct {
+    char file_name[STR_SIZE];   /* name of the raw binary file */
+    int fd;                     /* file descriptor of the file; -1 if it
+                                   isn't reclaimed */
+    size_t line_bytes;          /* number of bytes per line */
+    off_t reclaimed;            /* number of bytes at the start of the file
+                                   released so far */
+} Raw_binary_reclaim_t;
+
+/* Prototypes */
+bool get_raw_binary_reclaim_mode ();
+
+bool can_reclaim_raw_binary_sources
+(
+    Espa_internal_meta_t *xml_metadata  /* I: metadata of the source
+                                              product */
+);
+
+void open_raw_binary_reclaim
+(
+    Espa_band_meta_t *bmeta,     /* I: metadata of the source band */
+    bool reclaim,                /* I: should the band be reclaimed? */
+    Raw_binary_reclaim_t *rcl    /* O: reclamation of the band */
+);
+
+void reclaim_raw_binary_lines
+(
+    Raw_binary_reclaim_t *rcl,   /* I/O: reclamation of the band */
+    int nlines                   /* I: number of lines at the start of the
+                                       band which have been consumed */
+);
+
+void close_raw_binary_reclaim
+(
+    Raw_binary_reclaim_t *rcl    /* I/O: reclamation of the band */
+);
+
+#endif
@@ -0,0 +1,1798 @@
+/*****************************************************************************
+FILE: raw_binary_s3.c
+
+PURPOSE: Contains functions for reading and writing raw binary bands stored
+as objects in an S3-compatible object store.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_s3.h for the access pattern and the settings.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <string.h>
+#include "raw_binary_s3.h"
+#include "espa_profile.h"
+
+#ifdef ENABLE_S3
+#include <pthread.h>
+#include <curl/curl.h>
+
+/* Size of an ETag of a part of a multipart upload */
+#define RB_S3_ETAG_SIZE 128
+
+/* Default endpoint and region of the store */
+#define RB_S3_DEFAULT_ENDPOINT "https://s3.amazonaws.com"
+#define RB_S3_DEFAULT_REGION "us-east-1"
+
+/* Method of a request to the store */
+typedef enum
+{
+    S3_HEAD,
+    S3_GET,
+    S3_PUT,
+    S3_POST,
+    S3_DELETE
+} S3_method_t;
+
+/* Request to the store */
+typedef struct
+{
+    S3_method_t method;      /* method of the request */
+    char query[STR_SIZE];    /* query string of the request, or empty */
+    off_t offset;            /* first byte of a ranged GET */
+    size_t nbytes;           /* number of bytes of a ranged GET; 0 for the
+                                whole object */
+    uint8_t *buf;            /* response body */
+    size_t size;             /* allocated size of buf */
+    size_t len;              /* number of bytes received in buf */
+    bool grow;               /* can buf be reallocated as it's received? */
+    const uint8_t *body;     /* body sent by a PUT or POST */
+    size_t body_len;         /* number of bytes in the body */
+    size_t body_pos;         /* number of bytes of the body sent */
+    char etag[RB_S3_ETAG_SIZE];  /* ETag of the response */
+    long http_status;        /* HTTP status of the response */
+    bool missing_ok;         /* is a missing object (404) expected, so it
+                                isn't reported? */
+    curl_off_t content_length;   /* Content-Length of the response */
+    int tries;               /* number of times the request was tried */
+    CURL *curl;              /* handle of the request in flight */
+} S3_request_t;
+
+/* Block of an object in the cache */
+typedef struct
+{
+    off_t block;             /* number of the block; -1 if the slot is
+                                empty */
+    uint8_t *data;           /* data of the block */
+    unsigned long used;      /* when the block was last used */
+} S3_block_t;
+
+/* Object opened for reading or writing */
+struct raw_binary_s3
+{
+    char url[STR_SIZE];      /* s3:// URL of the object */
+    char http_url[STR_SIZE]; /* path-style URL of the object */
+    bool writing;            /* is the object being written? */
+    CURLM *multi;            /* requests in flight; keeps the connections
+                                to the store */
+    struct curl_slist *headers;  /* headers of every request */
+    char userpwd[STR_SIZE];  /* access and secret keys; empty if the
+                                requests aren't signed */
+    char sigv4[STR_SIZE];    /* signature provider, region and service */
+    off_t size;              /* size of the object being read */
+    off_t last_end;          /* offset after the last read */
+    unsigned long clock;     /* use counter of the cache */
+    S3_block_t cache[RB_S3_CACHE_BLOCKS];  /* cached blocks */
+    uint8_t *part[RB_S3_UPLOAD_PARTS];     /* parts not yet uploaded */
+    int nfull;               /* number of full parts not yet uploaded */
+    size_t part_len;         /* number of bytes in the part being filled */
+    char upload_id[STR_SIZE];  /* ID of the multipart upload; empty if it
+                                  isn't started */
+    int nparts;              /* number of parts uploaded */
+    char (*etag)[RB_S3_ETAG_SIZE];  /* ETag of each uploaded part */
+    bool failed;             /* has writing the object failed? */
+};
+
+static pthread_once_t s3_init_once = PTHREAD_ONCE_INIT;
+static CURLcode s3_init_status = CURLE_FAILED_INIT;
+
+
+/******************************************************************************
+MODULE: init_s3
+
+PURPOSE: Initializes libcurl once for the process.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void init_s3 (void)
+{
+    s3_init_status = curl_global_init (CURL_GLOBAL_DEFAULT);
+}
+
+
+/******************************************************************************
+MODULE: encode_s3_path
+
+PURPOSE: Percent-encodes a key or query value of an object for a URL.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The encoded string doesn't fit
+SUCCESS      Successfully encoded the string
+
+NOTES:
+  1. The unreserved characters are kept, and '/' is kept if requested (for
+     keys), as AWS Signature Version 4 expects.
+*****************************************************************************/
+static int encode_s3_path
+(
+    const char *in,     /* I: string to be encoded */
+    bool keep_slash,    /* I: is '/' kept as is? */
+    char *out,          /* O: encoded string */
+    size_t out_size     /* I: size of out */
+)
+{
+    size_t n = 0;            /* length of out */
+    unsigned char c;         /* current character */
+
+    for (; *in != '\0'; in++)
+    {
+        c = (unsigned char) *in;
+        if (isalnum (c) || c == '-' || c == '_' || c == '.' || c == '~' ||
+            (keep_slash && c == '/'))
+        {
+            if (n + 1 >= out_size)
+                return (ERROR);
+            out[n++] = c;
+        }
+        else
+        {
+            if (n + 3 >= out_size)
+                return (ERROR);
+            sprintf (&out[n], "%%%02X", c);
+            n += 3;
+        }
+    }
+    out[n] = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: s3_write_body
+
+PURPOSE: libcurl write callback, storing the response body of a request.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The body doesn't fit; the request fails
+other        Number of bytes stored
+
+NOTES:
+*****************************************************************************/
+static size_t s3_write_body
+(
+    char *data,         /* I: received data */
+    size_t size,        /* I: size of an item */
+    size_t nitems,      /* I: number of items */
+    void *userdata      /* I/O: request */
+)
+{
+    S3_request_t *req = userdata;    /* request */
+    size_t n = size * nitems;        /* number of bytes received */
+    size_t new_size;                 /* reallocated size of the body */
+    uint8_t *new_buf = NULL;         /* reallocated body */
+
+    if (req->len + n > req->size)
+    {
+        if (!req->grow)
+            return (0);
+        new_size = (req->size > 0) ? req->size : 4096;
+        while (new_size < req->len + n)
+            new_size *= 2;
+        new_buf = realloc (req->buf, new_size);
+        if (new_buf == NULL)
+            return (0);
+        req->buf = new_buf;
+        req->size = new_size;
+    }
+
+    memcpy (&req->buf[req->len], data, n);
+    req->len += n;
+    espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_S3, n);
+    return (n);
+}
+
+
+/******************************************************************************
+MODULE: s3_read_body
+
+PURPOSE: libcurl read callback, sending the body of a PUT request.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+0            The whole body was sent
+other        Number of bytes sent
+
+NOTES:
+*****************************************************************************/
+static size_t s3_read_body
+(
+    char *data,         /* O: buffer for the data to be sent */
+    size_t size,        /* I: size of an item */
+    size_t nitems,      /* I: number of items */
+    void *userdata      /* I/O: request */
+)
+{
+    S3_request_t *req = userdata;    /* request */
+    size_t n = size * nitems;        /* number of bytes requested */
+
+    if (n > req->body_len - req->body_pos)
+        n = req->body_len - req->body_pos;
+    memcpy (data, &req->body[req->body_pos], n);
+    req->body_pos += n;
+    espa_profile_count_io (ESPA_PROFILE_WRITE, ESPA_PROFILE_S3, n);
+    return (n);
+}
+
+
+/******************************************************************************
+MODULE: s3_header
+
+PURPOSE: libcurl header callback, keeping the ETag of the response.
+
+RETURN VALUE:
+Type = size_t
+Value        Description
+-----        -----------
+other        Number of bytes of the header
+
+NOTES:
+*****************************************************************************/
+static size_t s3_header
+(
+    char *data,         /* I: header line, not NULL-terminated */
+    size_t size,        /* I: size of an item */
+    size_t nitems,      /* I: number of items */
+    void *userdata      /* I/O: request */
+)
+{
+    S3_request_t *req = userdata;    /* request */
+    size_t n = size * nitems;        /* length of the header line */
+    size_t len;                      /* length of the ETag */
+    char *value = NULL;              /* value of the header */
+
+    if (n > 5 && !strncasecmp (data, "etag:", 5))
+    {
+        value = data + 5;
+        len = n - 5;
+        while (len > 0 && isspace ((unsigned char) *value))
+        {
+            value++;
+            len--;
+        }
+        while (len > 0 && isspace ((unsigned char) value[len-1]))
+            len--;
+        if (len < sizeof (req->etag))
+        {
+            memcpy (req->etag, value, len);
+            req->etag[len] = '\0';
+        }
+    }
+
+    return (n);
+}
+
+
+/******************************************************************************
+MODULE: start_s3_request
+
+PURPOSE: Sets up a request to the store and adds it to the requests in
+flight.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error setting up the request
+SUCCESS      Successfully started the request
+
+NOTES:
+*****************************************************************************/
+static int start_s3_request
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object */
+    S3_request_t *req      /* I/O: request */
+)
+{
+    char url[STR_SIZE];      /* URL of the request */
+    char range[STR_SIZE];    /* byte range of a ranged GET */
+    CURL *curl = req->curl;  /* handle of the request */
+    int count;               /* number of chars copied in snprintf */
+
+    count = snprintf (url, sizeof (url), "%s%s", rbs->http_url, req->query);
+    if (count < 0 || count >= sizeof (url))
+        return (ERROR);
+
+    if (curl == NULL)
+    {
+        curl = curl_easy_init ();
+        if (curl == NULL)
+            return (ERROR);
+        req->curl = curl;
+    }
+    else
+        curl_easy_reset (curl);
+    req->len = 0;
+    req->body_pos = 0;
+    req->etag[0] = '\0';
+    req->http_status = 0;
+    req->tries++;
+
+    curl_easy_setopt (curl, CURLOPT_URL, url);
+    curl_easy_setopt (curl, CURLOPT_PRIVATE, req);
+    curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt (curl, CURLOPT_HTTPHEADER, rbs->headers);
+    curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, s3_write_body);
+    curl_easy_setopt (curl, CURLOPT_WRITEDATA, req);
+    curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, s3_header);
+    curl_easy_setopt (curl, CURLOPT_HEADERDATA, req);
+    if (rbs->userpwd[0] != '\0')
+    {
+        curl_easy_setopt (curl, CURLOPT_USERPWD, rbs->userpwd);
+        curl_easy_setopt (curl, CURLOPT_AWS_SIGV4, rbs->sigv4);
+    }
+
+    switch (req->method)
+    {
+        case S3_HEAD:
+            curl_easy_setopt (curl, CURLOPT_NOBODY, 1L);
+            break;
+        case S3_GET:
+            if (req->nbytes > 0)
+            {
+                snprintf (range, sizeof (range), "%lld-%lld",
+                    (long long) req->offset,
+                    (long long) req->offset + (long long) req->nbytes - 1);
+                curl_easy_setopt (curl, CURLOPT_RANGE, range);
+            }
+            break;
+        case S3_PUT:
+            curl_easy_setopt (curl, CURLOPT_UPLOAD, 1L);
+            curl_easy_setopt (curl, CURLOPT_READFUNCTION, s3_read_body);
+            curl_easy_setopt (curl, CURLOPT_READDATA, req);
+            curl_easy_setopt (curl, CURLOPT_INFILESIZE_LARGE,
+                (curl_off_t) req->body_len);
+            break;
+        case S3_POST:
+            curl_easy_setopt (curl, CURLOPT_POST, 1L);
+            curl_easy_setopt (curl, CURLOPT_POSTFIELDS, req->body);
+            curl_easy_setopt (curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                (curl_off_t) req->body_len);
+            break;
+        case S3_DELETE:
+            curl_easy_setopt (curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+            break;
+    }
+
+    if (curl_multi_add_handle (rbs->multi, curl) != CURLM_OK)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: run_s3_requests
+
+PURPOSE: Runs requests to the store, up to RB_S3_MAX_REQUESTS in parallel.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        A request failed
+SUCCESS      All the requests succeeded
+
+NOTES:
+  1. Requests which fail with a transfer error, a server error (5xx) or
+     throttling (429) are tried again, up to RB_S3_TRIES times.  A ranged
+     GET which returns fewer bytes than requested fails.
+*****************************************************************************/
+static int run_s3_requests
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object */
+    int nreq,           /* I: number of requests */
+    S3_request_t *req   /* I/O: requests */
+)
+{
+    char FUNC_NAME[] = "run_s3_requests"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int next = 0;            /* next request to be started */
+    int nactive = 0;         /* number of requests in flight */
+    int nrunning;            /* number of transfers still running */
+    int nmsgs;               /* number of messages left */
+    int i;                   /* looping variable for the requests */
+    int status = SUCCESS;    /* return status */
+    bool ok;                 /* did the request succeed? */
+    CURLMsg *msg = NULL;     /* message of a finished transfer */
+    S3_request_t *done = NULL;  /* finished request */
+    char *method_name[] = {"HEAD", "GET", "PUT", "POST", "DELETE"};
+
+    for (i = 0; i < nreq; i++)
+        req[i].tries = 0;
+
+    while (next < nreq || nactive > 0)
+    {
+        /* Keep up to RB_S3_MAX_REQUESTS requests in flight */
+        while (status == SUCCESS && next < nreq &&
+            nactive < RB_S3_MAX_REQUESTS)
+        {
+            if (start_s3_request (rbs, &req[next]) != SUCCESS)
+            {
+                sprintf (errmsg, "Setting up a request for object %s.",
+                    rbs->url);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            next++;
+            nactive++;
+        }
+        if (status != SUCCESS)
+            next = nreq;
+        if (nactive == 0)
+            break;
+
+        if (curl_multi_perform (rbs->multi, &nrunning) != CURLM_OK)
+        {
+            sprintf (errmsg, "Running the requests for object %s.", rbs->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        while ((msg = curl_multi_info_read (rbs->multi, &nmsgs)) != NULL)
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, &done);
+            curl_easy_getinfo (msg->easy_handle, CURLINFO_RESPONSE_CODE,
+                &done->http_status);
+            curl_easy_getinfo (msg->easy_handle,
+                CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &done->content_length);
+            curl_multi_remove_handle (rbs->multi, msg->easy_handle);
+            nactive--;
+
+            ok = (msg->data.result == CURLE_OK &&
+                done->http_status >= 200 && done->http_status < 300);
+            if (ok && done->method == S3_GET && done->nbytes > 0 &&
+                done->len != done->nbytes)
+                ok = false;
+            if (ok)
+                continue;
+
+            /* Try the request again if the failure may be transient */
+            if (status == SUCCESS && done->tries < RB_S3_TRIES &&
+                (msg->data.result != CURLE_OK ||
+                 done->http_status >= 500 || done->http_status == 429))
+            {
+                if (start_s3_request (rbs, done) == SUCCESS)
+                {
+                    nactive++;
+                    continue;
+                }
+            }
+
+            if (status == SUCCESS &&
+                !(done->missing_ok && done->http_status == 404))
+            {
+                if (msg->data.result != CURLE_OK)
+                    sprintf (errmsg, "%s request for object %s%s failed: "
+                        "%s.", method_name[done->method], rbs->url,
+                        done->query, curl_easy_strerror (msg->data.result));
+                else
+                    sprintf (errmsg, "%s request for object %s%s failed "
+                        "with HTTP status %ld.", method_name[done->method],
+                        rbs->url, done->query, done->http_status);
+                error_handler (true, FUNC_NAME, errmsg);
+            }
+            status = ERROR;
+            next = nreq;
+        }
+
+        if (nactive > 0 &&
+            curl_multi_poll (rbs->multi, NULL, 0, 1000, NULL) != CURLM_OK)
+        {
+            sprintf (errmsg, "Waiting for the requests for object %s.",
+                rbs->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+    }
+
+    /* Release the handles, including any left in flight after an error */
+    for (i = 0; i < nreq; i++)
+    {
+        if (req[i].curl != NULL)
+        {
+            curl_multi_remove_handle (rbs->multi, req[i].curl);
+            curl_easy_cleanup (req[i].curl);
+            req[i].curl = NULL;
+        }
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: run_s3_request
+
+PURPOSE: Runs a single request to the store, whose response body is kept.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The request failed
+SUCCESS      The request succeeded
+
+NOTES:
+  1. The caller is responsible for freeing the response body (req->buf).
+*****************************************************************************/
+static int run_s3_request
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object */
+    S3_method_t method,    /* I: method of the request */
+    char *query,        /* I: query string of the request, or "" */
+    const char *body,   /* I: body of a PUT or POST, or NULL */
+    S3_request_t *req   /* O: request, with its response */
+)
+{
+    memset (req, 0, sizeof (S3_request_t));
+    req->method = method;
+    snprintf (req->query, sizeof (req->query), "%s", query);
+    req->grow = true;
+    if (body != NULL)
+    {
+        req->body = (const uint8_t *) body;
+        req->body_len = strlen (body);
+    }
+
+    return (run_s3_requests (rbs, 1, req));
+}
+
+
+/******************************************************************************
+MODULE: get_s3_xml_value
+
+PURPOSE: Gets the value of an element of an XML response of the store.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+false        The element isn't in the response
+true         The value was found
+
+NOTES:
+*****************************************************************************/
+static bool get_s3_xml_value
+(
+    S3_request_t *req,  /* I: request with its response */
+    char *element,      /* I: name of the element */
+    char *value,        /* O: value of the element */
+    size_t value_size   /* I: size of value */
+)
+{
+    char tag[STR_SIZE];      /* start tag of the element */
+    char *start = NULL;      /* start of the value */
+    char *end = NULL;        /* end of the value */
+    char *body = NULL;       /* NULL-terminated response */
+
+    if (req->buf == NULL)
+        return (false);
+    body = strndup ((char *) req->buf, req->len);
+    if (body == NULL)
+        return (false);
+
+    snprintf (tag, sizeof (tag), "<%s>", element);
+    start = strstr (body, tag);
+    if (start != NULL)
+    {
+        start += strlen (tag);
+        end = strchr (start, '<');
+    }
+    if (start == NULL || end == NULL || end - start >= value_size)
+    {
+        free (body);
+        return (false);
+    }
+
+    memcpy (value, start, end - start);
+    value[end - start] = '\0';
+    free (body);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_s3_url
+
+PURPOSE: Determines if the name of a band file is the URL of an object.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+false        The band is a file
+true         The band is an object
+
+NOTES:
+*****************************************************************************/
+bool is_raw_binary_s3_url
+(
+    const char *name    /* I: name of the band file */
+)
+{
+    return (!strncmp (name, RB_S3_SCHEME, strlen (RB_S3_SCHEME)));
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_s3
+
+PURPOSE: Opens an object of the store for reading or writing.
+
+RETURN VALUE:
+Type = Raw_binary_s3_t *
+Value        Description
+-----        -----------
+NULL         Error opening the object
+non-NULL     Opened object
+
+NOTES:
+  1. An object opened for reading must exist; its size is read from the
+     store.  An object opened for writing is only created when it's
+     closed.
+*****************************************************************************/
+Raw_binary_s3_t *open_raw_binary_s3
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    char *access_type   /* I: "rb" to read the object or "wb" to write it */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_s3"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* encoded bucket and key */
+    char endpoint[STR_SIZE]; /* endpoint of the store */
+    char header[STR_SIZE];   /* header of the requests */
+    char *env = NULL;        /* environment setting */
+    char *secret = NULL;     /* secret key */
+    char *key = NULL;        /* key of the object */
+    struct curl_slist *new_headers = NULL;  /* extended headers */
+    int i;                   /* looping variable for the cache */
+    int count;               /* number of chars copied in snprintf */
+    S3_request_t req;        /* request for the size of the object */
+    Raw_binary_s3_t *rbs = NULL;  /* opened object */
+
+    if (!is_raw_binary_s3_url (url) ||
+        (strcmp (access_type, "rb") && strcmp (access_type, "wb")))
+    {
+        sprintf (errmsg, "Object %s can only be opened with rb or wb "
+            "access.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    key = strchr (url + strlen (RB_S3_SCHEME), '/');
+    if (key == NULL || key == url + strlen (RB_S3_SCHEME) || key[1] == '\0')
+    {
+        sprintf (errmsg, "%s isn't an s3://bucket/key URL.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    pthread_once (&s3_init_once, init_s3);
+    if (s3_init_status != CURLE_OK)
+    {
+        sprintf (errmsg, "Initializing libcurl for object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    rbs = calloc (1, sizeof (Raw_binary_s3_t));
+    if (rbs == NULL)
+    {
+        sprintf (errmsg, "Allocating the object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    for (i = 0; i < RB_S3_CACHE_BLOCKS; i++)
+        rbs->cache[i].block = -1;
+    rbs->writing = (access_type[0] == 'w');
+    rbs->last_end = -1;
+    snprintf (rbs->url, sizeof (rbs->url), "%s", url);
+
+    /* Path-style URL of the object */
+    env = getenv ("ESPA_S3_ENDPOINT");
+    snprintf (endpoint, sizeof (endpoint), "%s",
+        (env != NULL && env[0] != '\0') ? env : RB_S3_DEFAULT_ENDPOINT);
+    count = strlen (endpoint);
+    while (count > 0 && endpoint[count-1] == '/')
+        endpoint[--count] = '\0';
+    if (encode_s3_path (url + strlen (RB_S3_SCHEME), true, path,
+        sizeof (path)) != SUCCESS)
+        count = -1;
+    else
+        count = snprintf (rbs->http_url, sizeof (rbs->http_url), "%s/%s",
+            endpoint, path);
+    if (count < 0 || count >= sizeof (rbs->http_url))
+    {
+        sprintf (errmsg, "Overflow of the URL of object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbs);
+        return (NULL);
+    }
+
+    /* Credentials; requests are unsigned without them (public buckets) */
+    env = getenv ("AWS_ACCESS_KEY_ID");
+    secret = getenv ("AWS_SECRET_ACCESS_KEY");
+    if (env != NULL && env[0] != '\0' && secret != NULL)
+    {
+        snprintf (rbs->userpwd, sizeof (rbs->userpwd), "%s:%s", env, secret);
+        env = getenv ("AWS_REGION");
+        snprintf (rbs->sigv4, sizeof (rbs->sigv4), "aws:amz:%s:s3",
+            (env != NULL && env[0] != '\0') ? env : RB_S3_DEFAULT_REGION);
+    }
+
+    /* The payload isn't hashed, and uploads don't wait for 100-continue */
+    rbs->headers = curl_slist_append (NULL,
+        "x-amz-content-sha256: UNSIGNED-PAYLOAD");
+    if (rbs->headers != NULL)
+    {
+        new_headers = curl_slist_append (rbs->headers, "Expect:");
+        if (new_headers == NULL)
+        {
+            curl_slist_free_all (rbs->headers);
+            rbs->headers = NULL;
+        }
+    }
+    env = getenv ("AWS_SESSION_TOKEN");
+    if (rbs->headers != NULL && rbs->userpwd[0] != '\0' && env != NULL &&
+        env[0] != '\0')
+    {
+        snprintf (header, sizeof (header), "x-amz-security-token: %s", env);
+        new_headers = curl_slist_append (rbs->headers, header);
+        if (new_headers == NULL)
+        {
+            curl_slist_free_all (rbs->headers);
+            rbs->headers = NULL;
+        }
+    }
+
+    rbs->multi = curl_multi_init ();
+    if (rbs->headers == NULL || rbs->multi == NULL)
+    {
+        sprintf (errmsg, "Setting up the requests for object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_s3 (rbs);
+        return (NULL);
+    }
+
+    if (rbs->writing)
+        return (rbs);
+
+    /* Get the size of the object */
+    if (run_s3_request (rbs, S3_HEAD, "", NULL, &req) != SUCCESS ||
+        req.content_length < 0)
+    {
+        sprintf (errmsg, "Opening object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (req.buf);
+        close_raw_binary_s3 (rbs);
+        return (NULL);
+    }
+    free (req.buf);
+    rbs->size = req.content_length;
+
+    return (rbs);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_s3_ranges
+
+PURPOSE: Reads byte ranges of an object into their buffers, as parallel
+ranged GETs which bypass the cache.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the ranges
+SUCCESS      Successfully read the ranges
+
+NOTES:
+*****************************************************************************/
+int read_raw_binary_s3_ranges
+(
+    Raw_binary_s3_t *rbs,  /* I: object opened for reading */
+    int nranges,        /* I: number of byte ranges */
+    const off_t *offset,   /* I: byte offset of each range */
+    const size_t *nbytes,  /* I: number of bytes of each range */
+    void **buf          /* O: buffer of each range */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_s3_ranges"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the ranges */
+    int nreq = 0;            /* number of requests */
+    int status;              /* return status */
+    S3_request_t *req = NULL;  /* request of each range */
+
+    req = calloc (nranges > 0 ? nranges : 1, sizeof (S3_request_t));
+    if (req == NULL)
+    {
+        sprintf (errmsg, "Allocating the requests for object %s.", rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nranges; i++)
+    {
+        if (offset[i] < 0 || offset[i] + (off_t) nbytes[i] > rbs->size)
+        {
+            sprintf (errmsg, "Range of %zu bytes at %lld is outside object "
+                "%s.", nbytes[i], (long long) offset[i], rbs->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (req);
+            return (ERROR);
+        }
+        if (nbytes[i] == 0)
+            continue;
+        req[nreq].method = S3_GET;
+        req[nreq].offset = offset[i];
+        req[nreq].nbytes = nbytes[i];
+        req[nreq].buf = buf[i];
+        req[nreq].size = nbytes[i];
+        nreq++;
+    }
+
+    status = run_s3_requests (rbs, nreq, req);
+    free (req);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_s3
+
+PURPOSE: Reads bytes of an object through the block cache.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the object
+SUCCESS      Successfully read the bytes
+
+NOTES:
+  1. The blocks of the read which aren't cached are fetched in parallel,
+     with the next RB_S3_READAHEAD blocks if the read follows the previous
+     one.  The least recently used blocks are replaced.  A read of more
+     blocks than the cache holds is read directly into the buffer.
+*****************************************************************************/
+int read_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for reading */
+    off_t offset,       /* I: byte offset in the object */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_s3"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    off_t first;             /* first block of the read */
+    off_t last;              /* last block of the read */
+    off_t fetch_last;        /* last block fetched, with the read-ahead */
+    off_t b;                 /* looping variable for the blocks */
+    off_t block_start;       /* offset of the current block */
+    size_t block_len;        /* number of bytes in the current block */
+    size_t n;                /* number of bytes copied from a block */
+    int i;                   /* looping variable for the cache slots */
+    int slot;                /* cache slot of the current block */
+    int nreq = 0;            /* number of blocks fetched */
+    int status;              /* return status */
+    unsigned long pinned;    /* blocks used at or after this are kept */
+    uint8_t *out = buf;      /* current output byte */
+    off_t *range_offset = NULL;   /* offsets of a direct read */
+    size_t *range_nbytes = NULL;  /* sizes of a direct read */
+    void **range_buf = NULL;      /* buffers of a direct read */
+    S3_request_t req[RB_S3_CACHE_BLOCKS];  /* requests for the blocks */
+    int req_slot[RB_S3_CACHE_BLOCKS];      /* slot of each request */
+
+    if (nbytes == 0)
+        return (SUCCESS);
+    if (offset < 0 || offset + (off_t) nbytes > rbs->size)
+    {
+        sprintf (errmsg, "Read of %zu bytes at %lld is outside object %s.",
+            nbytes, (long long) offset, rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    first = offset / RB_S3_BLOCK_SIZE;
+    last = (offset + nbytes - 1) / RB_S3_BLOCK_SIZE;
+
+    /* Large reads go straight to the buffer, a block per request */
+    if (last - first + 1 > RB_S3_CACHE_BLOCKS - RB_S3_READAHEAD)
+    {
+        n = last - first + 1;
+        range_offset = malloc (n * sizeof (off_t));
+        range_nbytes = malloc (n * sizeof (size_t));
+        range_buf = malloc (n * sizeof (void *));
+        if (range_offset == NULL || range_nbytes == NULL || range_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the ranges for object %s.",
+                rbs->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else
+        {
+            for (b = first; b <= last; b++)
+            {
+                i = b - first;
+                range_offset[i] = (b == first) ? offset :
+                    b * (off_t) RB_S3_BLOCK_SIZE;
+                block_start = (b + 1) * (off_t) RB_S3_BLOCK_SIZE;
+                if (block_start > offset + (off_t) nbytes)
+                    block_start = offset + nbytes;
+                range_nbytes[i] = block_start - range_offset[i];
+                range_buf[i] = out + (range_offset[i] - offset);
+            }
+            status = read_raw_binary_s3_ranges (rbs, n, range_offset,
+                range_nbytes, range_buf);
+        }
+        free (range_offset);
+        free (range_nbytes);
+        free (range_buf);
+        rbs->last_end = offset + nbytes;
+        return (status);
+    }
+
+    /* Keep the cached blocks of the read */
+    pinned = rbs->clock + 1;
+    for (i = 0; i < RB_S3_CACHE_BLOCKS; i++)
+    {
+        if (rbs->cache[i].block >= first && rbs->cache[i].block <= last)
+            rbs->cache[i].used = ++rbs->clock;
+    }
+
+    /* Fetch the missing blocks, with the read-ahead of an in-order read */
+    fetch_last = last;
+    if (offset == rbs->last_end)
+        fetch_last = last + RB_S3_READAHEAD;
+    if (fetch_last > (rbs->size - 1) / RB_S3_BLOCK_SIZE)
+        fetch_last = (rbs->size - 1) / RB_S3_BLOCK_SIZE;
+    memset (req, 0, sizeof (req));
+    for (b = first; b <= fetch_last; b++)
+    {
+        for (i = 0; i < RB_S3_CACHE_BLOCKS; i++)
+        {
+            if (rbs->cache[i].block == b)
+                break;
+        }
+        if (i < RB_S3_CACHE_BLOCKS)
+            continue;
+
+        /* Replace the least recently used block which isn't needed */
+        slot = -1;
+        for (i = 0; i < RB_S3_CACHE_BLOCKS; i++)
+        {
+            if (rbs->cache[i].used < pinned && (slot == -1 ||
+                rbs->cache[i].used < rbs->cache[slot].used))
+                slot = i;
+        }
+        if (slot == -1)
+            break;
+        if (rbs->cache[slot].data == NULL)
+        {
+            rbs->cache[slot].data = malloc (RB_S3_BLOCK_SIZE);
+            if (rbs->cache[slot].data == NULL)
+            {
+                sprintf (errmsg, "Allocating the cache of object %s.",
+                    rbs->url);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        rbs->cache[slot].block = b;
+        rbs->cache[slot].used = ++rbs->clock;
+
+        block_start = b * (off_t) RB_S3_BLOCK_SIZE;
+        block_len = (rbs->size - block_start < RB_S3_BLOCK_SIZE) ?
+            rbs->size - block_start : RB_S3_BLOCK_SIZE;
+        req[nreq].method = S3_GET;
+        req[nreq].offset = block_start;
+        req[nreq].nbytes = block_len;
+        req[nreq].buf = rbs->cache[slot].data;
+        req[nreq].size = block_len;
+        req_slot[nreq] = slot;
+        nreq++;
+    }
+
+    if (run_s3_requests (rbs, nreq, req) != SUCCESS)
+    {
+        for (i = 0; i < nreq; i++)
+            rbs->cache[req_slot[i]].block = -1;
+        sprintf (errmsg, "Reading %zu bytes at %lld of object %s.", nbytes,
+            (long long) offset, rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Copy the read out of the cached blocks */
+    for (b = first; b <= last; b++)
+    {
+        for (slot = 0; slot < RB_S3_CACHE_BLOCKS; slot++)
+        {
+            if (rbs->cache[slot].block == b)
+                break;
+        }
+        block_start = b * (off_t) RB_S3_BLOCK_SIZE;
+        i = (b == first) ? offset - block_start : 0;
+        n = RB_S3_BLOCK_SIZE - i;
+        if (n > (size_t) (offset + nbytes - (block_start + i)))
+            n = offset + nbytes - (block_start + i);
+        memcpy (out, &rbs->cache[slot].data[i], n);
+        out += n;
+    }
+    rbs->last_end = offset + nbytes;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: upload_s3_parts
+
+PURPOSE: Uploads the full parts of an object being written, and the part
+being filled if it's the last one, starting the multipart upload if needed.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error uploading the parts
+SUCCESS      Successfully uploaded the parts
+
+NOTES:
+*****************************************************************************/
+static int upload_s3_parts
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for writing */
+    bool last           /* I: is the part being filled the last part? */
+)
+{
+    char FUNC_NAME[] = "upload_s3_parts"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char upload_id[STR_SIZE];  /* encoded ID of the upload */
+    int i;                   /* looping variable for the parts */
+    int nreq;                /* number of parts uploaded */
+    char (*new_etag)[RB_S3_ETAG_SIZE] = NULL;  /* reallocated ETags */
+    S3_request_t req[RB_S3_UPLOAD_PARTS];  /* requests for the parts */
+
+    nreq = rbs->nfull + ((last && rbs->part_len > 0) ? 1 : 0);
+    if (nreq == 0)
+        return (SUCCESS);
+
+    /* Start the multipart upload */
+    if (rbs->upload_id[0] == '\0')
+    {
+        if (run_s3_request (rbs, S3_POST, "?uploads", "", &req[0]) !=
+            SUCCESS || !get_s3_xml_value (&req[0], "UploadId",
+            rbs->upload_id, sizeof (rbs->upload_id)))
+        {
+            sprintf (errmsg, "Starting the upload of object %s.", rbs->url);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (req[0].buf);
+            rbs->upload_id[0] = '\0';
+            return (ERROR);
+        }
+        free (req[0].buf);
+    }
+    if (encode_s3_path (rbs->upload_id, false, upload_id,
+        sizeof (upload_id)) != SUCCESS)
+    {
+        sprintf (errmsg, "Overflow of the upload ID of object %s.",
+            rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    new_etag = realloc (rbs->etag, (rbs->nparts + nreq) *
+        sizeof (*rbs->etag));
+    if (new_etag == NULL)
+    {
+        sprintf (errmsg, "Allocating the parts of object %s.", rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    rbs->etag = new_etag;
+
+    memset (req, 0, sizeof (req));
+    for (i = 0; i < nreq; i++)
+    {
+        req[i].method = S3_PUT;
+        snprintf (req[i].query, sizeof (req[i].query),
+            "?partNumber=%d&uploadId=%s", rbs->nparts + i + 1, upload_id);
+        req[i].body = rbs->part[i];
+        req[i].body_len = (i < rbs->nfull) ? RB_S3_PART_SIZE :
+            rbs->part_len;
+        req[i].grow = true;
+    }
+    if (run_s3_requests (rbs, nreq, req) != SUCCESS)
+    {
+        for (i = 0; i < nreq; i++)
+            free (req[i].buf);
+        sprintf (errmsg, "Uploading parts %d-%d of object %s.",
+            rbs->nparts + 1, rbs->nparts + nreq, rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nreq; i++)
+    {
+        free (req[i].buf);
+        snprintf (rbs->etag[rbs->nparts + i], RB_S3_ETAG_SIZE, "%s",
+            req[i].etag);
+    }
+    rbs->nparts += nreq;
+    rbs->nfull = 0;
+    if (last)
+        rbs->part_len = 0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_s3
+
+PURPOSE: Appends data to an object being written.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the object
+SUCCESS      Successfully buffered or uploaded the data
+
+NOTES:
+  1. The data is buffered until RB_S3_UPLOAD_PARTS parts are full, which
+     are then uploaded in parallel.
+*****************************************************************************/
+int write_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for writing */
+    const void *buf,    /* I: data to be appended to the object */
+    size_t nbytes       /* I: number of bytes to be appended */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_s3"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    const uint8_t *data = buf;   /* data not yet buffered */
+    size_t n;                /* number of bytes buffered at a time */
+    uint8_t *part = NULL;    /* part being filled */
+
+    if (rbs->failed)
+        return (ERROR);
+
+    while (nbytes > 0)
+    {
+        part = rbs->part[rbs->nfull];
+        if (part == NULL)
+        {
+            part = malloc (RB_S3_PART_SIZE);
+            if (part == NULL)
+            {
+                sprintf (errmsg, "Allocating a part of object %s.",
+                    rbs->url);
+                error_handler (true, FUNC_NAME, errmsg);
+                rbs->failed = true;
+                return (ERROR);
+            }
+            rbs->part[rbs->nfull] = part;
+        }
+
+        n = RB_S3_PART_SIZE - rbs->part_len;
+        if (n > nbytes)
+            n = nbytes;
+        memcpy (&part[rbs->part_len], data, n);
+        rbs->part_len += n;
+        data += n;
+        nbytes -= n;
+
+        if (rbs->part_len == RB_S3_PART_SIZE)
+        {
+            rbs->nfull++;
+            rbs->part_len = 0;
+            if (rbs->nfull == RB_S3_UPLOAD_PARTS &&
+                upload_s3_parts (rbs, false) != SUCCESS)
+            {
+                rbs->failed = true;
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: finish_s3_upload
+
+PURPOSE: Creates the object being written, from its single part or by
+completing its multipart upload.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error creating the object
+SUCCESS      Successfully created the object
+
+NOTES:
+  1. The store may report an error completing an upload in the body of a
+     successful response, so the body is checked too.
+*****************************************************************************/
+static int finish_s3_upload
+(
+    Raw_binary_s3_t *rbs   /* I/O: object opened for writing */
+)
+{
+    char FUNC_NAME[] = "finish_s3_upload"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char query[STR_SIZE];    /* query of the completion */
+    char upload_id[STR_SIZE];  /* encoded ID of the upload */
+    char code[STR_SIZE];     /* error code in the response */
+    char *body = NULL;       /* list of the parts */
+    size_t body_size;        /* allocated size of body */
+    size_t len = 0;          /* length of body */
+    int i;                   /* looping variable for the parts */
+    int status;              /* return status */
+    S3_request_t req;        /* request creating the object */
+
+    /* Small objects are a single PUT */
+    if (rbs->upload_id[0] == '\0' && rbs->nfull == 0)
+    {
+        memset (&req, 0, sizeof (req));
+        req.method = S3_PUT;
+        req.body = rbs->part[0];
+        req.body_len = rbs->part_len;
+        req.grow = true;
+        status = run_s3_requests (rbs, 1, &req);
+        free (req.buf);
+        if (status != SUCCESS)
+        {
+            sprintf (errmsg, "Writing object %s.", rbs->url);
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+        return (status);
+    }
+
+    if (upload_s3_parts (rbs, true) != SUCCESS)
+        return (ERROR);
+
+    body_size = 128 + (size_t) rbs->nparts * (RB_S3_ETAG_SIZE + 64);
+    body = malloc (body_size);
+    if (body == NULL)
+    {
+        sprintf (errmsg, "Allocating the part list of object %s.", rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    len += sprintf (&body[len], "<CompleteMultipartUpload>");
+    for (i = 0; i < rbs->nparts; i++)
+        len += sprintf (&body[len], "<Part><PartNumber>%d</PartNumber>"
+            "<ETag>%s</ETag></Part>", i + 1, rbs->etag[i]);
+    sprintf (&body[len], "</CompleteMultipartUpload>");
+
+    encode_s3_path (rbs->upload_id, false, upload_id, sizeof (upload_id));
+    snprintf (query, sizeof (query), "?uploadId=%s", upload_id);
+    status = run_s3_request (rbs, S3_POST, query, body, &req);
+    if (status == SUCCESS &&
+        get_s3_xml_value (&req, "Code", code, sizeof (code)))
+    {
+        sprintf (errmsg, "Completing the upload of object %s failed: %s.",
+            rbs->url, code);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    free (req.buf);
+    free (body);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Completing the upload of object %s.", rbs->url);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_s3_size
+
+PURPOSE: Returns the size of an object opened for reading.
+
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+size         Size of the object (bytes)
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_s3_size
+(
+    Raw_binary_s3_t *rbs   /* I: object opened for reading */
+)
+{
+    return (rbs->size);
+}
+
+
+/******************************************************************************
+MODULE: stat_raw_binary_s3
+
+PURPOSE: Determines if an object exists, and its size.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error asking the store for the object
+SUCCESS      Successfully determined if the object exists
+
+NOTES:
+  1. A missing object isn't an error and isn't reported, so this can be used
+     to look for objects which may not have been written yet.
+*****************************************************************************/
+int stat_raw_binary_s3
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    bool *exists,       /* O: does the object exist? */
+    off_t *size         /* O: size of the object, if it exists */
+)
+{
+    char FUNC_NAME[] = "stat_raw_binary_s3"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status;              /* status of the request */
+    S3_request_t req;        /* request for the size of the object */
+    Raw_binary_s3_t *rbs = NULL;  /* object */
+
+    /* Opening the object for writing sets up the requests without sending
+       any; it's closed as a read so nothing is uploaded */
+    *exists = false;
+    rbs = open_raw_binary_s3 (url, "wb");
+    if (rbs == NULL)
+        return (ERROR);
+    rbs->writing = false;
+
+    memset (&req, 0, sizeof (S3_request_t));
+    req.method = S3_HEAD;
+    req.grow = true;
+    req.missing_ok = true;
+    status = run_s3_requests (rbs, 1, &req);
+    free (req.buf);
+    close_raw_binary_s3 (rbs);
+
+    if (status == SUCCESS && req.content_length >= 0)
+    {
+        *exists = true;
+        *size = req.content_length;
+    }
+    else if (req.http_status != 404)
+    {
+        sprintf (errmsg, "Looking for object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_s3
+
+PURPOSE: Closes an object, creating it if it's being written.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error creating the object
+SUCCESS      Successfully closed the object
+
+NOTES:
+  1. A multipart upload which fails is aborted, so the store drops its
+     parts.
+*****************************************************************************/
+int close_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs   /* I: object to be closed; an object being
+                                 written is completed */
+)
+{
+    char query[STR_SIZE];    /* query of the abort */
+    char upload_id[STR_SIZE];  /* encoded ID of the upload */
+    int i;                   /* looping variable */
+    int status = SUCCESS;    /* return status */
+    S3_request_t req;        /* request aborting the upload */
+
+    if (rbs == NULL)
+        return (SUCCESS);
+
+    if (rbs->writing && rbs->multi != NULL)
+    {
+        if (rbs->failed || finish_s3_upload (rbs) != SUCCESS)
+            status = ERROR;
+        if (status != SUCCESS && rbs->upload_id[0] != '\0' &&
+            encode_s3_path (rbs->upload_id, false, upload_id,
+            sizeof (upload_id)) == SUCCESS)
+        {
+            snprintf (query, sizeof (query), "?uploadId=%s", upload_id);
+            run_s3_request (rbs, S3_DELETE, query, NULL, &req);
+            free (req.buf);
+        }
+    }
+
+    for (i = 0; i < RB_S3_CACHE_BLOCKS; i++)
+        free (rbs->cache[i].data);
+    for (i = 0; i < RB_S3_UPLOAD_PARTS; i++)
+        free (rbs->part[i]);
+    free (rbs->etag);
+    if (rbs->multi != NULL)
+        curl_multi_cleanup (rbs->multi);
+    curl_slist_free_all (rbs->headers);
+    free (rbs);
+
+    return (status);
+}
+
+#else
+
+/* Without ENABLE_S3 the objects can't be opened */
+bool is_raw_binary_s3_url
+(
+    const char *name    /* I: name of the band file */
+)
+{
+    return (!strncmp (name, RB_S3_SCHEME, strlen (RB_S3_SCHEME)));
+}
+
+Raw_binary_s3_t *open_raw_binary_s3
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    char *access_type   /* I: "rb" to read the object or "wb" to write it */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_s3"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    sprintf (errmsg, "Object %s can't be opened; the object store support "
+        "isn't built (ENABLE_S3=yes).", url);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (NULL);
+}
+
+int read_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for reading */
+    off_t offset,       /* I: byte offset in the object */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    return (ERROR);
+}
+
+int read_raw_binary_s3_ranges
+(
+    Raw_binary_s3_t *rbs,  /* I: object opened for reading */
+    int nranges,        /* I: number of byte ranges */
+    const off_t *offset,   /* I: byte offset of each range */
+    const size_t *nbytes,  /* I: number of bytes of each range */
+    void **buf          /* O: buffer of each range */
+)
+{
+    return (ERROR);
+}
+
+int write_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for writing */
+    const void *buf,    /* I: data to be appended to the object */
+    size_t nbytes       /* I: number of bytes to be appended */
+)
+{
+    return (ERROR);
+}
+
+off_t get_raw_binary_s3_size
+(
+    Raw_binary_s3_t *rbs   /* I: object opened for reading */
+)
+{
+    return (0);
+}
+
+int stat_raw_binary_s3
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    bool *exists,       /* O: does the object exist? */
+    off_t *size         /* O: size of the object, if it exists */
+)
+{
+    char FUNC_NAME[] = "stat_raw_binary_s3"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    *exists = false;
+    sprintf (errmsg, "Object %s can't be looked for; the object store "
+        "support isn't built (ENABLE_S3=yes).", url);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+int close_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs   /* I: object to be closed */
+)
+{
+    return (SUCCESS);
+}
+
+#endif
+
+
+/* Position of the stream of an object */
+typedef struct
+{
+    Raw_binary_s3_t *rbs;    /* object */
+    bool writing;            /* is the object being written? */
+    off_t pos;               /* position of the stream */
+} S3_stream_t;
+
+
+/******************************************************************************
+MODULE: s3_stream_read
+
+PURPOSE: Read function of the stdio stream of an object.
+
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           Error reading the object
+0            End of the object
+other        Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t s3_stream_read
+(
+    void *cookie,       /* I/O: stream of the object */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    S3_stream_t *ss = cookie;    /* stream of the object */
+    off_t obj_size = get_raw_binary_s3_size (ss->rbs);  /* object size */
+
+    if (ss->writing)
+        return (-1);
+    if (ss->pos >= obj_size)
+        return (0);
+    if ((off_t) size > obj_size - ss->pos)
+        size = obj_size - ss->pos;
+
+    if (read_raw_binary_s3 (ss->rbs, ss->pos, size, buf) != SUCCESS)
+        return (-1);
+    ss->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: s3_stream_write
+
+PURPOSE: Write function of the stdio stream of an object.
+
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+0            Error writing the object
+other        Number of bytes written
+
+NOTES:
+*****************************************************************************/
+static ssize_t s3_stream_write
+(
+    void *cookie,       /* I/O: stream of the object */
+    const char *buf,    /* I: data to be written */
+    size_t size         /* I: number of bytes to be written */
+)
+{
+    S3_stream_t *ss = cookie;    /* stream of the object */
+
+    if (!ss->writing || write_raw_binary_s3 (ss->rbs, buf, size) != SUCCESS)
+        return (0);
+    ss->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: s3_stream_seek
+
+PURPOSE: Seek function of the stdio stream of an object.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The new position is invalid
+0            Seeking was successful
+
+NOTES:
+  1. An object being written is written in order, so its stream can only be
+     positioned at its end.
+*****************************************************************************/
+static int s3_stream_seek
+(
+    void *cookie,       /* I/O: stream of the object */
+    off64_t *offset,    /* I/O: requested offset; returns the new position */
+    int whence          /* I: SEEK_SET, SEEK_CUR, or SEEK_END */
+)
+{
+    S3_stream_t *ss = cookie;    /* stream of the object */
+    off64_t pos;             /* new position */
+
+    if (whence == SEEK_SET)
+        pos = *offset;
+    else if (whence == SEEK_CUR)
+        pos = ss->pos + *offset;
+    else if (whence == SEEK_END && !ss->writing)
+        pos = get_raw_binary_s3_size (ss->rbs) + *offset;
+    else if (whence == SEEK_END)
+        pos = ss->pos + *offset;
+    else
+        return (-1);
+
+    if (pos < 0 || (ss->writing && pos != ss->pos))
+        return (-1);
+    ss->pos = pos;
+    *offset = pos;
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: s3_stream_close
+
+PURPOSE: Close function of the stdio stream of an object.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           Error creating the object being written
+0            Closing was successful
+
+NOTES:
+*****************************************************************************/
+static int s3_stream_close
+(
+    void *cookie        /* I: stream of the object */
+)
+{
+    S3_stream_t *ss = cookie;    /* stream of the object */
+    int status;              /* status of closing the object */
+
+    status = close_raw_binary_s3 (ss->rbs);
+    free (ss);
+
+    return ((status == SUCCESS) ? 0 : -1);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_s3_stream
+
+PURPOSE: Opens an object as a stdio stream, so it can be read with
+fread/fseek or written with fwrite like a plain raw binary band.
+
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the object
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. As with tiled bands (see open_raw_binary_tiled_stream), the stream has
+     a small (BUFSIZ) buffer, so large reads and writes are handed to the
+     object in one piece.
+  2. The stream has no file descriptor; fileno returns -1.  An object being
+     written is only created when the stream is closed, and fclose returns
+     EOF if that fails.
+*****************************************************************************/
+FILE *open_raw_binary_s3_stream
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    char *access_type   /* I: "rb" to read the object or "wb" to write it */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_s3_stream"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* stream for the object */
+    S3_stream_t *ss = NULL;  /* stream of the object */
+    cookie_io_functions_t funcs =         /* stream functions */
+        {s3_stream_read, s3_stream_write, s3_stream_seek, s3_stream_close};
+
+    ss = calloc (1, sizeof (S3_stream_t));
+    if (ss == NULL)
+    {
+        sprintf (errmsg, "Allocating the stream for object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    ss->writing = (access_type[0] == 'w');
+
+    ss->rbs = open_raw_binary_s3 (url, access_type);
+    if (ss->rbs == NULL)
+    {
+        free (ss);
+        return (NULL);
+    }
+
+    fptr = fopencookie (ss, ss->writing ? "wb" : "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for object %s.", url);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_s3 (ss->rbs);
+        free (ss);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, BUFSIZ);
+
+    return (fptr);
+}
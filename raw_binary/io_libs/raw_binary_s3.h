@@ -0,0 +1,142 @@
+/*****************************************************************************
+FILE: raw_binary_s3.h
+
+PURPOSE: Contains defines, structures, and prototypes for reading and writing
+raw binary bands stored as objects in an S3-compatible object store.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A band whose file name is an s3://bucket/key URL is an object holding
+     the plain raw binary band data.  open_raw_binary opens it as a stdio
+     stream (with no file descriptor), so it's read and written the same as
+     a band on disk.  Objects can't be opened for update, and the encoded
+     layouts (chunked, tiled, ...) aren't recognized in objects.
+  2. Reads are ranged GETs of RB_S3_BLOCK_SIZE blocks, which are kept in a
+     small cache.  The missing blocks of a read, and the next
+     RB_S3_READAHEAD blocks when the object is read in order, are fetched
+     in parallel, up to RB_S3_MAX_REQUESTS at a time.
+     read_raw_binary_window fetches only the lines of the window, as
+     parallel ranged GETs, bypassing the cache.
+  3. Writes are sequential.  The data is uploaded as a multipart upload of
+     RB_S3_PART_SIZE parts, RB_S3_UPLOAD_PARTS of them in parallel, which is
+     completed when the stream is closed, or as a single PUT if it's
+     smaller than a part.  An upload which fails is aborted, so a partial
+     object is never left behind.
+  4. The store is reached through libcurl with AWS Signature Version 4
+     authentication, using path-style URLs (endpoint/bucket/key) so any
+     S3-compatible store works.  The environment gives the settings:
+       ESPA_S3_ENDPOINT       endpoint URL (default https://s3.amazonaws.com)
+       AWS_REGION             region of the bucket (default us-east-1)
+       AWS_ACCESS_KEY_ID      access key; requests are unsigned without it
+       AWS_SECRET_ACCESS_KEY  secret key
+       AWS_SESSION_TOKEN      session token of temporary credentials
+  5. The object store support is only built with ENABLE_S3=yes, which
+     links the libraries with libcurl.  Otherwise opening an s3:// band
+     fails with an error.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_S3_H
+#define RAW_BINARY_S3_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Defines */
+/* URL scheme of the bands stored as objects */
+#define RB_S3_SCHEME "s3://"
+
+/* Size of the blocks read from an object and cached */
+#define RB_S3_BLOCK_SIZE (4 * 1024 * 1024)
+
+/* Number of blocks cached per object */
+#define RB_S3_CACHE_BLOCKS 16
+
+/* Number of blocks read ahead when an object is read in order */
+#define RB_S3_READAHEAD 4
+
+/* Largest number of requests to the store in flight per object */
+#define RB_S3_MAX_REQUESTS 8
+
+/* Size of the parts of a multipart upload; the store requires at least
+   5 MiB for all but the last part */
+#define RB_S3_PART_SIZE (16 * 1024 * 1024)
+
+/* Number of parts buffered and uploaded in parallel */
+#define RB_S3_UPLOAD_PARTS 4
+
+/* Number of times a failed request is tried */
+#define RB_S3_TRIES 3
+
+/* Type definitions */
+/* Object opened for reading or writing; the contents are private */
+typedef struct raw_binary_s3 Raw_binary_s3_t;
+
+/* Prototypes */
+bool is_raw_binary_s3_url
+(
+    const char *name    /* I: name of the band file */
+);
+
+Raw_binary_s3_t *open_raw_binary_s3
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    char *access_type   /* I: "rb" to read the object or "wb" to write it */
+);
+
+int read_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for reading */
+    off_t offset,       /* I: byte offset in the object */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+);
+
+int read_raw_binary_s3_ranges
+(
+    Raw_binary_s3_t *rbs,  /* I: object opened for reading */
+    int nranges,        /* I: number of byte ranges */
+    const off_t *offset,   /* I: byte offset of each range */
+    const size_t *nbytes,  /* I: number of bytes of each range */
+    void **buf          /* O: buffer of each range */
+);
+
+int write_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs,  /* I/O: object opened for writing */
+    const void *buf,    /* I: data to be appended to the object */
+    size_t nbytes       /* I: number of bytes to be appended */
+);
+
+off_t get_raw_binary_s3_size
+(
+    Raw_binary_s3_t *rbs   /* I: object opened for reading */
+);
+
+int stat_raw_binary_s3
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    bool *exists,       /* O: does the object exist? */
+    off_t *size         /* O: size of the object, if it exists */
+);
+
+int close_raw_binary_s3
+(
+    Raw_binary_s3_t *rbs   /* I: object to be closed; an object being
+                                 written is completed */
+);
+
+FILE *open_raw_binary_s3_stream
+(
+    char *url,          /* I: s3://bucket/key URL of the object */
+    char *access_type   /* I: "rb" to read the object or "wb" to write it */
+);
+
+#endif
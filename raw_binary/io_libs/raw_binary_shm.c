@@ -0,0 +1,936 @@
+/*****************************************************************************
+FILE: raw_binary_shm.c
+
+PURPOSE: Contains functions for keeping raw binary bands in shared memory
+segments between the processes of a node.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_shm.h.
+*****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "raw_binary_shm.h"
+#include "espa_memory.h"
+
+/* Limit of the segments in bytes; 0 if the bands aren't kept in shared
+   memory */
+static size_t shm_limit = 0;
+static pthread_once_t shm_limit_once = PTHREAD_ONCE_INIT;
+
+/* Registry mapped by this process, and the file descriptor it's locked
+   with */
+static Raw_binary_shm_registry_t *shm_registry = NULL;
+static int shm_registry_fd = -1;
+static pthread_once_t shm_registry_once = PTHREAD_ONCE_INIT;
+
+/* Lock of the threads of this process; the record lock of the registry
+   only locks out the other processes */
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Segments being written by this process, by file descriptor */
+static int shm_write_fd[RB_SHM_MAX_WRITES];
+static int shm_write_slot[RB_SHM_MAX_WRITES];
+static int shm_nwrites = 0;
+
+
+/******************************************************************************
+MODULE: read_shm_limit
+
+PURPOSE: Reads the limit of the shared memory bands from ESPA_SHM_BANDS.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Called once, through pthread_once.
+*****************************************************************************/
+static void read_shm_limit (void)
+{
+    char FUNC_NAME[] = "read_shm_limit"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *value = getenv (RB_SHM_ENV);  /* value of ESPA_SHM_BANDS */
+    long pages;              /* number of pages of physical memory */
+
+    if (value == NULL || *value == '\0' || !strcmp (value, "off"))
+        return;
+
+    if (!strcmp (value, "on"))
+    {
+        pages = sysconf (_SC_PHYS_PAGES);
+        if (pages > 0)
+            shm_limit = (size_t) pages * sysconf (_SC_PAGESIZE) /
+                RB_SHM_DEFAULT_FRACTION;
+    }
+    else if (espa_parse_memory_size (value, &shm_limit) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid %s value %s; the bands "
+            "are written to disk.", RB_SHM_ENV, value);
+        error_handler (false, FUNC_NAME, errmsg);
+        shm_limit = 0;
+    }
+}
+
+
+/******************************************************************************
+MODULE: use_raw_binary_shm
+
+PURPOSE: Determines whether the bands are kept in shared memory.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_SHM_BANDS sets a limit for the shared memory bands
+false        The bands are only read from and written to disk
+
+NOTES:
+*****************************************************************************/
+bool use_raw_binary_shm (void)
+{
+    pthread_once (&shm_limit_once, read_shm_limit);
+    return (shm_limit > 0);
+}
+
+
+/******************************************************************************
+MODULE: set_shm_registry_lock
+
+PURPOSE: Takes or releases the record lock of the registry.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           Error setting the lock
+0            The lock was set
+
+NOTES:
+  1. Record locks belong to the process, so the processes forked after the
+     registry is opened lock each other out, unlike with flock.
+*****************************************************************************/
+static int set_shm_registry_lock
+(
+    int fd,                 /* I: file descriptor of the registry */
+    short type              /* I: F_WRLCK to lock, F_UNLCK to unlock */
+)
+{
+    struct flock lock;       /* lock of the whole registry */
+    int status;              /* status of fcntl */
+
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    do
+        status = fcntl (fd, F_SETLKW, &lock);
+    while (status != 0 && errno == EINTR);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: map_shm_registry
+
+PURPOSE: Creates or opens the registry of the segments, and maps it.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Called once, through pthread_once.  If the registry can't be mapped,
+     a warning is written and the bands are written to disk.
+*****************************************************************************/
+static void map_shm_registry (void)
+{
+    char FUNC_NAME[] = "map_shm_registry"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char name[NAME_MAX];     /* name of the registry */
+    struct stat statbuf;     /* status of the registry */
+    void *addr = MAP_FAILED; /* mapping of the registry */
+    int fd;                  /* file descriptor of the registry */
+
+    snprintf (name, sizeof (name), RB_SHM_REGISTRY_NAME,
+        (unsigned) getuid ());
+    fd = shm_open (name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd >= 0 && set_shm_registry_lock (fd, F_WRLCK) == 0)
+    {
+        /* The first process to open the registry sizes it; its slots start
+           out zero, so free */
+        if (fstat (fd, &statbuf) == 0 &&
+            ((size_t) statbuf.st_size >= sizeof (Raw_binary_shm_registry_t)
+            || ftruncate (fd, sizeof (Raw_binary_shm_registry_t)) == 0))
+            addr = mmap (NULL, sizeof (Raw_binary_shm_registry_t),
+                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        set_shm_registry_lock (fd, F_UNLCK);
+    }
+
+    if (addr == MAP_FAILED)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unable to map the shared memory "
+            "band registry %s: %s.  The bands are written to disk.", name,
+            strerror (errno));
+        error_handler (false, FUNC_NAME, errmsg);
+        if (fd >= 0)
+            close (fd);
+        return;
+    }
+
+    shm_registry = addr;
+    shm_registry_fd = fd;
+}
+
+
+/******************************************************************************
+MODULE: lock_shm_registry
+
+PURPOSE: Maps the registry if needed, and locks it.
+
+RETURN VALUE:
+Type = Raw_binary_shm_registry_t *
+Value        Description
+-----        -----------
+NULL         The bands aren't kept in shared memory, or the registry isn't
+             available
+non-NULL     The locked registry
+
+NOTES:
+  1. unlock_shm_registry must be called once done with the registry.
+*****************************************************************************/
+static Raw_binary_shm_registry_t *lock_shm_registry (void)
+{
+    if (!use_raw_binary_shm ())
+        return (NULL);
+    pthread_once (&shm_registry_once, map_shm_registry);
+    if (shm_registry == NULL)
+        return (NULL);
+
+    pthread_mutex_lock (&shm_lock);
+    set_shm_registry_lock (shm_registry_fd, F_WRLCK);
+
+    return (shm_registry);
+}
+
+
+/******************************************************************************
+MODULE: unlock_shm_registry
+
+PURPOSE: Unlocks the registry.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void unlock_shm_registry (void)
+{
+    set_shm_registry_lock (shm_registry_fd, F_UNLCK);
+    pthread_mutex_unlock (&shm_lock);
+}
+
+
+/******************************************************************************
+MODULE: get_shm_path
+
+PURPOSE: Gets the absolute name of a band file, which the segment of the band
+is registered under.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The name is too long
+SUCCESS      The absolute name was set
+
+NOTES:
+  1. The name isn't resolved further, so the band must be named the same
+     way (relative to the same directory, or by the same absolute name)
+     by each stage.
+*****************************************************************************/
+static int get_shm_path
+(
+    const char *file_name,  /* I: name of the band file */
+    char *path              /* O: absolute name; STR_SIZE characters */
+)
+{
+    char cwd[PATH_MAX];      /* current directory */
+    int count;               /* number of chars copied in snprintf */
+
+    if (file_name[0] == '/')
+        count = snprintf (path, STR_SIZE, "%s", file_name);
+    else if (getcwd (cwd, sizeof (cwd)) != NULL)
+        count = snprintf (path, STR_SIZE, "%s/%s", cwd, file_name);
+    else
+        return (ERROR);
+
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_shm_segment_name
+
+PURPOSE: Gets the name of the segment in a slot of the registry.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+*****************************************************************************/
+static void get_shm_segment_name
+(
+    const Raw_binary_shm_registry_t *reg,  /* I: registry */
+    int slot,               /* I: slot of the segment */
+    char *name,             /* O: name of the segment */
+    size_t size             /* I: size of name */
+)
+{
+    snprintf (name, size, RB_SHM_SEGMENT_NAME, (unsigned) getuid (), slot,
+        reg->entry[slot].generation);
+}
+
+
+/******************************************************************************
+MODULE: is_shm_process_alive
+
+PURPOSE: Determines whether a process is still running.
+
+RETURN VALUE:
+Type = bool
+
+NOTES:
+*****************************************************************************/
+static bool is_shm_process_alive
+(
+    pid_t pid               /* I: process ID; 0 for no process */
+)
+{
+    return (pid > 0 && (kill (pid, 0) == 0 || errno == EPERM));
+}
+
+
+/******************************************************************************
+MODULE: count_shm_holders
+
+PURPOSE: Drops the processes which exited from the holders of a segment, and
+counts the others.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0 or more    Reference count of the segment
+
+NOTES:
+*****************************************************************************/
+static int count_shm_holders
+(
+    Raw_binary_shm_entry_t *entry  /* I/O: segment */
+)
+{
+    int i;                   /* looping variable for the holders */
+    int count = 0;           /* number of live holders */
+
+    for (i = 0; i < RB_SHM_MAX_HOLDERS; i++)
+    {
+        if (entry->holders[i] == 0)
+            continue;
+        if (is_shm_process_alive (entry->holders[i]))
+            count++;
+        else
+            entry->holders[i] = 0;
+    }
+
+    return (count);
+}
+
+
+/******************************************************************************
+MODULE: add_shm_holder
+
+PURPOSE: Counts the calling process as a reference to a segment, and marks
+the segment as just used.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. If the holders are all live processes, the process isn't counted.
+     The count only orders the segments spilled, so that's harmless.
+*****************************************************************************/
+static void add_shm_holder
+(
+    Raw_binary_shm_entry_t *entry  /* I/O: segment */
+)
+{
+    pid_t pid = getpid ();   /* calling process */
+    int i;                   /* looping variable for the holders */
+    int free_slot = -1;      /* free holder slot */
+
+    entry->last_use = time (NULL);
+    count_shm_holders (entry);
+    for (i = 0; i < RB_SHM_MAX_HOLDERS; i++)
+    {
+        if (entry->holders[i] == pid)
+            return;
+        if (entry->holders[i] == 0 && free_slot < 0)
+            free_slot = i;
+    }
+    if (free_slot >= 0)
+        entry->holders[free_slot] = pid;
+}
+
+
+/******************************************************************************
+MODULE: is_shm_being_written
+
+PURPOSE: Determines whether a segment is being written by a live process.
+
+RETURN VALUE:
+Type = bool
+
+NOTES:
+  1. A segment whose writer exited without completing it is treated as
+     complete, as its band file would be.
+*****************************************************************************/
+static bool is_shm_being_written
+(
+    const Raw_binary_shm_entry_t *entry  /* I: segment */
+)
+{
+    return (entry->writer != 0 && is_shm_process_alive (entry->writer));
+}
+
+
+/******************************************************************************
+MODULE: get_shm_segment_size
+
+PURPOSE: Gets the current size of a segment.
+
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+-1           The segment no longer exists
+other        Size of the segment in bytes
+
+NOTES:
+*****************************************************************************/
+static off_t get_shm_segment_size
+(
+    const Raw_binary_shm_registry_t *reg,  /* I: registry */
+    int slot                /* I: slot of the segment */
+)
+{
+    char name[NAME_MAX];     /* name of the segment */
+    struct stat statbuf;     /* status of the segment */
+    int fd;                  /* file descriptor of the segment */
+    off_t size = -1;         /* size of the segment */
+
+    get_shm_segment_name (reg, slot, name, sizeof (name));
+    fd = shm_open (name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return (-1);
+    if (fstat (fd, &statbuf) == 0)
+        size = statbuf.st_size;
+    close (fd);
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: free_shm_segment
+
+PURPOSE: Removes a segment and frees its slot in the registry.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The processes which have the segment open or mapped keep it until they
+     close it.
+*****************************************************************************/
+static void free_shm_segment
+(
+    Raw_binary_shm_registry_t *reg,  /* I/O: registry */
+    int slot                /* I: slot of the segment */
+)
+{
+    char name[NAME_MAX];     /* name of the segment */
+    Raw_binary_shm_entry_t *entry = &reg->entry[slot];  /* segment */
+
+    get_shm_segment_name (reg, slot, name, sizeof (name));
+    shm_unlink (name);
+    entry->path[0] = '\0';
+    entry->writer = 0;
+    memset (entry->holders, 0, sizeof (entry->holders));
+}
+
+
+/******************************************************************************
+MODULE: spill_shm_segment
+
+PURPOSE: Writes a segment to its band file on disk, and removes it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the band file; the segment is kept
+SUCCESS      The band was written to disk
+
+NOTES:
+*****************************************************************************/
+static int spill_shm_segment
+(
+    Raw_binary_shm_registry_t *reg,  /* I/O: registry */
+    int slot                /* I: slot of the segment */
+)
+{
+    char FUNC_NAME[] = "spill_shm_segment"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char name[NAME_MAX];     /* name of the segment */
+    char *data = NULL;       /* mapping of the segment */
+    struct stat statbuf;     /* status of the segment */
+    size_t offset;           /* offset of the next block written */
+    size_t nblock;           /* number of bytes in the block */
+    ssize_t nwritten;        /* number of bytes written by a call */
+    int status = SUCCESS;    /* return status */
+    int in;                  /* file descriptor of the segment */
+    int out;                 /* file descriptor of the band file */
+    Raw_binary_shm_entry_t *entry = &reg->entry[slot];  /* segment */
+
+    get_shm_segment_name (reg, slot, name, sizeof (name));
+    in = shm_open (name, O_RDONLY | O_CLOEXEC, 0);
+    if (in < 0)
+    {
+        /* Nothing left to spill */
+        free_shm_segment (reg, slot);
+        return (SUCCESS);
+    }
+    if (fstat (in, &statbuf) != 0)
+    {
+        close (in);
+        return (ERROR);
+    }
+
+    out = open (entry->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+        status = ERROR;
+    if (status == SUCCESS && statbuf.st_size > 0)
+    {
+        data = mmap (NULL, statbuf.st_size, PROT_READ, MAP_SHARED, in, 0);
+        if (data == MAP_FAILED)
+        {
+            data = NULL;
+            status = ERROR;
+        }
+    }
+    for (offset = 0; status == SUCCESS && offset < (size_t) statbuf.st_size;
+        offset += nwritten)
+    {
+        nblock = statbuf.st_size - offset;
+        if (nblock > RB_SHM_SPILL_BLOCK)
+            nblock = RB_SHM_SPILL_BLOCK;
+        nwritten = write (out, data + offset, nblock);
+        if (nwritten < 0 && errno == EINTR)
+            nwritten = 0;
+        else if (nwritten <= 0)
+            status = ERROR;
+    }
+    if (data != NULL)
+        munmap (data, statbuf.st_size);
+    if (out >= 0 && close (out) != 0)
+        status = ERROR;
+    close (in);
+
+    if (status != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing shared memory band %s "
+            "to disk: %s", entry->path, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    free_shm_segment (reg, slot);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: make_shm_room
+
+PURPOSE: Spills segments to disk until the segments are under the limit.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The segments are under the limit, and a slot is free
+false        The segments being written (or those which can't be spilled)
+             still take the limit, or every slot
+
+NOTES:
+  1. The segments not being written are spilled, those with no references
+     first, then the least recently used.
+  2. The slot of the band being written, if it already has a segment, isn't
+     spilled or counted, since its contents are about to be replaced.
+*****************************************************************************/
+static bool make_shm_room
+(
+    Raw_binary_shm_registry_t *reg,  /* I/O: registry */
+    int keep                /* I: slot which isn't spilled; -1 for none */
+)
+{
+    off_t size[RB_SHM_MAX_SEGMENTS];  /* size of each segment */
+    size_t total = 0;        /* bytes in the segments */
+    int nfree = 0;           /* number of free slots */
+    int slot;                /* looping variable for the slots */
+    int victim;              /* slot spilled next */
+    int refs;                /* reference count of a segment */
+    int victim_refs = 0;     /* reference count of the victim */
+    Raw_binary_shm_entry_t *entry = NULL;  /* segment */
+
+    for (slot = 0; slot < RB_SHM_MAX_SEGMENTS; slot++)
+    {
+        size[slot] = 0;
+        if (reg->entry[slot].path[0] == '\0')
+            nfree++;
+        else if (slot != keep)
+        {
+            size[slot] = get_shm_segment_size (reg, slot);
+            if (size[slot] < 0)
+            {
+                /* The segment was removed behind the registry's back */
+                free_shm_segment (reg, slot);
+                size[slot] = 0;
+                nfree++;
+            }
+            total += size[slot];
+        }
+    }
+
+    while (total >= shm_limit || nfree == 0)
+    {
+        victim = -1;
+        for (slot = 0; slot < RB_SHM_MAX_SEGMENTS; slot++)
+        {
+            entry = &reg->entry[slot];
+            if (slot == keep || entry->path[0] == '\0' ||
+                is_shm_being_written (entry))
+                continue;
+            refs = count_shm_holders (entry);
+            if (victim < 0 || (refs == 0 && victim_refs > 0) ||
+                ((refs == 0) == (victim_refs == 0) &&
+                entry->last_use < reg->entry[victim].last_use))
+            {
+                victim = slot;
+                victim_refs = refs;
+            }
+        }
+        if (victim < 0 || spill_shm_segment (reg, victim) != SUCCESS)
+            return (false);
+
+        total -= size[victim];
+        nfree++;
+    }
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_shm
+
+PURPOSE: Opens the shared memory segment of a band, or creates one to write
+the band to.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The band isn't kept in shared memory; it's opened from disk
+other        File descriptor of the segment
+
+NOTES:
+  1. Without O_CREAT, the segment of the band is opened if it has one, for
+     reading or for update depending on the access mode.
+  2. With O_CREAT and O_TRUNC, a new segment is created for the band if
+     the segments can be brought under the limit, and
+     the band file is removed so it isn't read in place of the segment.
+     Otherwise the band's segment, if any, is removed and -1 is returned.
+     O_CREAT without O_TRUNC only reopens an existing segment to continue
+     writing it.
+  3. complete_raw_binary_shm must be called on the file descriptor of a
+     segment written before it's closed.
+*****************************************************************************/
+int open_raw_binary_shm
+(
+    const char *file_name,  /* I: name of the band file */
+    int flags               /* I: open flags; O_CREAT to write the band */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_shm"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char path[STR_SIZE];     /* absolute name of the band file */
+    char name[NAME_MAX];     /* name of the segment */
+    bool create = (flags & O_CREAT) != 0;  /* is the band written? */
+    bool truncate = (flags & O_TRUNC) != 0;  /* is the band rewritten? */
+    int slot;                /* looping variable for the slots */
+    int found = -1;          /* slot of the band's segment */
+    int fd = -1;             /* file descriptor of the segment */
+    Raw_binary_shm_registry_t *reg = NULL;  /* registry */
+    Raw_binary_shm_entry_t *entry = NULL;   /* segment of the band */
+
+    if (!use_raw_binary_shm () || get_shm_path (file_name, path) != SUCCESS)
+        return (-1);
+    reg = lock_shm_registry ();
+    if (reg == NULL)
+        return (-1);
+
+    for (slot = 0; slot < RB_SHM_MAX_SEGMENTS && found < 0; slot++)
+    {
+        if (!strcmp (reg->entry[slot].path, path))
+            found = slot;
+    }
+
+    if (create && truncate && !make_shm_room (reg, found))
+    {
+        /* No room; the band goes to disk, and an older segment of it is
+           dropped so it isn't read in its place */
+        if (found >= 0)
+            free_shm_segment (reg, found);
+        unlock_shm_registry ();
+        return (-1);
+    }
+    if (found < 0 && !(create && truncate))
+    {
+        unlock_shm_registry ();
+        return (-1);
+    }
+
+    /* A band rewritten gets a new segment, so the processes reading the
+       old one keep it intact */
+    if (found >= 0 && create && truncate)
+        free_shm_segment (reg, found);
+    else if (found < 0)
+    {
+        for (slot = 0; slot < RB_SHM_MAX_SEGMENTS && found < 0; slot++)
+        {
+            if (reg->entry[slot].path[0] == '\0')
+                found = slot;
+        }
+    }
+    entry = &reg->entry[found];
+    if (entry->path[0] == '\0')
+    {
+        entry->generation++;
+        strcpy (entry->path, path);
+    }
+
+    get_shm_segment_name (reg, found, name, sizeof (name));
+    fd = shm_open (name, ((flags & O_ACCMODE) == O_RDONLY ? O_RDONLY : O_RDWR)
+        | (create ? O_CREAT : 0) | (truncate ? O_TRUNC : 0) | O_CLOEXEC,
+        0644);
+    if (fd < 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening shared memory band %s: "
+            "%s.  The band is opened from disk.", path, strerror (errno));
+        error_handler (false, FUNC_NAME, errmsg);
+        free_shm_segment (reg, found);
+        unlock_shm_registry ();
+        return (-1);
+    }
+    add_shm_holder (entry);
+
+    if (create)
+    {
+        entry->writer = getpid ();
+        if (truncate)
+            unlink (path);
+
+        /* Remember the segment, so closing it marks it complete */
+        if (shm_nwrites < RB_SHM_MAX_WRITES)
+        {
+            shm_write_fd[shm_nwrites] = fd;
+            shm_write_slot[shm_nwrites] = found;
+            shm_nwrites++;
+        }
+    }
+    unlock_shm_registry ();
+
+    return (fd);
+}
+
+
+/******************************************************************************
+MODULE: complete_raw_binary_shm
+
+PURPOSE: Marks a segment written by this process as complete, so it can be
+spilled.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Called by the raw binary I/O library before closing a band it wrote.
+     Other file descriptors are ignored.
+*****************************************************************************/
+void complete_raw_binary_shm
+(
+    int fd                  /* I: file descriptor of the band */
+)
+{
+    int i;                   /* looping variable for the written segments */
+    int slot = -1;           /* slot of the segment */
+    Raw_binary_shm_registry_t *reg = NULL;  /* registry */
+
+    if (fd < 0 || shm_registry == NULL)
+        return;
+
+    reg = lock_shm_registry ();
+    if (reg == NULL)
+        return;
+    for (i = 0; i < shm_nwrites; i++)
+    {
+        if (shm_write_fd[i] == fd)
+        {
+            slot = shm_write_slot[i];
+            shm_nwrites--;
+            shm_write_fd[i] = shm_write_fd[shm_nwrites];
+            shm_write_slot[i] = shm_write_slot[shm_nwrites];
+            break;
+        }
+    }
+    if (slot >= 0 && reg->entry[slot].writer == getpid ())
+        reg->entry[slot].writer = 0;
+    unlock_shm_registry ();
+}
+
+
+/******************************************************************************
+MODULE: flush_raw_binary_shm
+
+PURPOSE: Writes the shared memory bands to their band files on disk, or
+discards them, and removes their segments.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing a band to disk
+SUCCESS      The bands were flushed
+
+NOTES:
+  1. The bands still being written are skipped with a warning.
+*****************************************************************************/
+int flush_raw_binary_shm
+(
+    const char *prefix,     /* I: flush the bands whose absolute file names
+                                  start with prefix; NULL for all */
+    bool drop               /* I: discard the bands rather than writing
+                                  them to disk? */
+)
+{
+    char FUNC_NAME[] = "flush_raw_binary_shm"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int slot;                /* looping variable for the slots */
+    int status = SUCCESS;    /* return status */
+    Raw_binary_shm_registry_t *reg = NULL;  /* registry */
+    Raw_binary_shm_entry_t *entry = NULL;   /* segment */
+
+    reg = lock_shm_registry ();
+    if (reg == NULL)
+        return (SUCCESS);
+
+    for (slot = 0; slot < RB_SHM_MAX_SEGMENTS; slot++)
+    {
+        entry = &reg->entry[slot];
+        if (entry->path[0] == '\0' || (prefix != NULL &&
+            strncmp (entry->path, prefix, strlen (prefix))))
+            continue;
+
+        if (is_shm_being_written (entry))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Shared memory band %s is "
+                "still being written by process %d; skipped.", entry->path,
+                (int) entry->writer);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+
+        if (drop)
+            free_shm_segment (reg, slot);
+        else if (spill_shm_segment (reg, slot) != SUCCESS)
+            status = ERROR;
+    }
+    unlock_shm_registry ();
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: list_raw_binary_shm
+
+PURPOSE: Lists the shared memory bands, one JSON line each.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0 or more    Number of bands listed
+
+NOTES:
+  1. Each line gives the "file_name", "bytes", "references" (the live
+     processes which opened the band), "writing" and "last_use" (seconds
+     since the epoch) of a band.
+*****************************************************************************/
+int list_raw_binary_shm
+(
+    FILE *out               /* I: stream the segments are listed to */
+)
+{
+    int slot;                /* looping variable for the slots */
+    int count = 0;           /* number of bands listed */
+    Raw_binary_shm_registry_t *reg = NULL;  /* registry */
+    Raw_binary_shm_entry_t *entry = NULL;   /* segment */
+
+    reg = lock_shm_registry ();
+    if (reg == NULL)
+        return (0);
+
+    for (slot = 0; slot < RB_SHM_MAX_SEGMENTS; slot++)
+    {
+        entry = &reg->entry[slot];
+        if (entry->path[0] == '\0')
+            continue;
+        fprintf (out, "{\"file_name\": \"%s\", \"bytes\": %lld, "
+            "\"references\": %d, \"writing\": %s, \"last_use\": %lld}\n",
+            entry->path, (long long) get_shm_segment_size (reg, slot),
+            count_shm_holders (entry),
+            is_shm_being_written (entry) ? "true" : "false",
+            (long long) entry->last_use);
+        count++;
+    }
+    unlock_shm_registry ();
+
+    return (count);
+}
@@ -0,0 +1,117 @@
+/*****************************************************************************
+FILE: raw_binary_shm.h
+
+PURPOSE: Contains defines, structures, and prototypes for the raw binary bands
+kept in shared memory segments, which hand intermediate bands from one stage
+to the next on a node without writing them to disk.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The bands are kept in shared memory if the ESPA_SHM_BANDS environment
+     variable is set to the most memory they may take, as a number of bytes
+     with an optional K, M, G or T suffix, or to "on" for a quarter of the
+     physical memory.  It's off by default.
+  2. A band written through the raw binary I/O library is then written to a
+     POSIX shared memory segment (in /dev/shm) registered under the absolute
+     name of its band file, rather than to the file.  A band read, mapped or
+     updated through the library by any process of the same user is opened
+     from its segment if it has one, so the next stage maps the pixels the
+     last stage wrote with no copy.  Bands with no segment are opened from
+     disk as usual.
+  3. The registry of the segments is itself a shared memory segment, locked
+     with a record lock.  Each segment has a reference count: the live
+     processes which opened it.  When a new segment would take the segments
+     over the limit, the segments not being written are spilled to their
+     band files on disk, those with no references and least recently used
+     first.  A segment spilled while it's open stays valid for the
+     processes which have it open.  If there still isn't room, the band is
+     written to disk.
+  4. The segments outlive the processes, so they're left for the next stage
+     to read.  flush_raw_binary_shm (see the espa_shm_bands tool) writes
+     them to their band files once the stages are done, and must be run
+     before the bands are read by anything other than the raw binary I/O
+     library, or the node is rebooted.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_SHM_H
+#define RAW_BINARY_SHM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Defines */
+/* Environment variable with the limit of the shared memory bands */
+#define RB_SHM_ENV "ESPA_SHM_BANDS"
+
+/* Fraction of the physical memory the segments may take by default */
+#define RB_SHM_DEFAULT_FRACTION 4
+
+/* Maximum number of segments, and of processes counted as referencing a
+   segment */
+#define RB_SHM_MAX_SEGMENTS 512
+#define RB_SHM_MAX_HOLDERS 16
+
+/* Maximum number of segments being written by a process at once */
+#define RB_SHM_MAX_WRITES 64
+
+/* Names of the registry and of the segments, with the user ID, and the
+   registry slot and generation of the segment */
+#define RB_SHM_REGISTRY_NAME "/espa_bands_%u"
+#define RB_SHM_SEGMENT_NAME "/espa_band_%u_%d_%u"
+
+/* Size of the blocks copied when spilling a segment to disk */
+#define RB_SHM_SPILL_BLOCK (8 * 1024 * 1024)
+
+/* Segment in the registry */
+typedef struct {
+    char path[STR_SIZE];        /* absolute name of the band file; empty if
+                                   the slot is free */
+    uint32_t generation;        /* number of segments the slot has held */
+    pid_t writer;               /* process writing the segment; 0 once it's
+                                   complete */
+    pid_t holders[RB_SHM_MAX_HOLDERS];  /* processes which opened the
+                                   segment; 0 for no process */
+    int64_t last_use;           /* time the segment was last opened */
+} Raw_binary_shm_entry_t;
+
+/* Registry of the segments */
+typedef struct {
+    Raw_binary_shm_entry_t entry[RB_SHM_MAX_SEGMENTS];  /* segments */
+} Raw_binary_shm_registry_t;
+
+/* Prototypes */
+bool use_raw_binary_shm (void);
+
+int open_raw_binary_shm
+(
+    const char *file_name,  /* I: name of the band file */
+    int flags               /* I: open flags; O_CREAT to write the band */
+);
+
+void complete_raw_binary_shm
+(
+    int fd                  /* I: file descriptor of the band */
+);
+
+int flush_raw_binary_shm
+(
+    const char *prefix,     /* I: flush the bands whose absolute file names
+                                  start with prefix; NULL for all */
+    bool drop               /* I: discard the bands rather than writing
+                                  them to disk? */
+);
+
+int list_raw_binary_shm
+(
+    FILE *out               /* I: stream the segments are listed to */
+);
+
+#endif
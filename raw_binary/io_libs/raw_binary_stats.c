@@ -0,0 +1,352 @@
+/*****************************************************************************
+FILE: raw_binary_stats.c
+  
+PURPOSE: Contains functions for accumulating the statistics (pixel counts,
+min/max, mean/standard deviation, and histogram) of a raw binary band while
+it's written.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A pixel is fill if it equals the band fill_value, and valid if it isn't
+     fill and is within the band valid_range (NaNs are never valid).  Bands
+     without a valid range accept the whole range of the data type.
+  2. The histogram covers the valid range, or the whole range of 8-bit data
+     types.  Integer bands with a narrow range get one bin per value.  Other
+     bands without a valid range have no histogram.
+  3. The counts, min/max, and sums are computed in branch-free loops which are
+     vectorized by the compiler (with OpenMP SIMD reductions when OpenMP is
+     enabled); only the histogram is updated a pixel at a time.
+*****************************************************************************/
+
+#include <math.h>
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include "raw_binary_stats.h"
+
+/******************************************************************************
+MODULE: STATS_KERNEL
+
+PURPOSE: Defines the accumulation function for a data type.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. The first loop does the counts, min/max, and sums for all the pixels;
+     the second loop updates the histogram for the valid pixels.
+*****************************************************************************/
+#ifdef _OPENMP
+#define STATS_SIMD _Pragma ("omp simd reduction(min:vmin) reduction(max:vmax) reduction(+:sum,sum_sq,nvalid,nfill)")
+#else
+#define STATS_SIMD
+#endif
+
+#define STATS_KERNEL(NAME, TYPE)                                              \
+static void NAME                                                              \
+(                                                                             \
+    Raw_binary_stats_t *stats,   /* I/O: statistics accumulator */            \
+    const TYPE *pix,             /* I: block of pixels */                     \
+    size_t npixels               /* I: number of pixels in the block */       \
+)                                                                             \
+{                                                                             \
+    const double fill = stats->fill_value;   /* fill value */                 \
+    const bool use_fill = stats->use_fill;   /* is there a fill value? */     \
+    const double rmin = stats->range_min;    /* lowest valid value */         \
+    const double rmax = stats->range_max;    /* highest valid value */        \
+    const double shift = stats->shift;       /* value subtracted from sums */ \
+    double vmin = stats->min;    /* minimum valid value */                    \
+    double vmax = stats->max;    /* maximum valid value */                    \
+    double sum = 0.0;            /* sum of the shifted valid values */        \
+    double sum_sq = 0.0;         /* sum of squares of the shifted values */   \
+    long nvalid = 0;             /* number of valid pixels */                 \
+    long nfill = 0;              /* number of fill pixels */                  \
+    long bin;                    /* histogram bin of the current pixel */     \
+    size_t i;                    /* looping variable for the pixels */        \
+                                                                              \
+    STATS_SIMD                                                                \
+    for (i = 0; i < npixels; i++)                                             \
+    {                                                                         \
+        double v = pix[i];                                                    \
+        int is_fill = use_fill && v == fill;                                  \
+        int is_valid = !is_fill && v >= rmin && v <= rmax;                    \
+        double d = is_valid ? v - shift : 0.0;                                \
+        nfill += is_fill;                                                     \
+        nvalid += is_valid;                                                   \
+        sum += d;                                                             \
+        sum_sq += d * d;                                                      \
+        vmin = (is_valid && v < vmin) ? v : vmin;                             \
+        vmax = (is_valid && v > vmax) ? v : vmax;                             \
+    }                                                                         \
+                                                                              \
+    stats->valid_pixels += nvalid;                                            \
+    stats->fill_pixels += nfill;                                              \
+    stats->out_of_range_pixels += npixels - nvalid - nfill;                   \
+    stats->sum += sum;                                                        \
+    stats->sum_sq += sum_sq;                                                  \
+    stats->min = vmin;                                                        \
+    stats->max = vmax;                                                        \
+                                                                              \
+    if (stats->nbins == 0 || nvalid == 0)                                     \
+        return;                                                               \
+    for (i = 0; i < npixels; i++)                                             \
+    {                                                                         \
+        double v = pix[i];                                                    \
+        if ((use_fill && v == fill) || !(v >= rmin && v <= rmax))             \
+            continue;                                                         \
+        bin = (long) ((v - stats->hist_min) * stats->bin_scale);              \
+        if (bin >= stats->nbins)                                              \
+            bin = stats->nbins - 1;                                           \
+        stats->histogram[bin]++;                                              \
+    }                                                                         \
+}
+
+STATS_KERNEL (accumulate_int8, int8_t)
+STATS_KERNEL (accumulate_uint8, uint8_t)
+STATS_KERNEL (accumulate_int16, int16_t)
+STATS_KERNEL (accumulate_uint16, uint16_t)
+STATS_KERNEL (accumulate_int32, int32_t)
+STATS_KERNEL (accumulate_uint32, uint32_t)
+STATS_KERNEL (accumulate_float32, float)
+STATS_KERNEL (accumulate_float64, double)
+
+
+/******************************************************************************
+MODULE: use_raw_binary_stats
+
+PURPOSE: Determines if the band statistics were requested via the
+ESPA_BAND_STATS environment variable.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_BAND_STATS is "yes"
+false        ESPA_BAND_STATS isn't set, or is anything else
+
+NOTES:
+*****************************************************************************/
+bool use_raw_binary_stats ()
+{
+    char *stats = getenv ("ESPA_BAND_STATS");  /* requested statistics */
+
+    return (stats != NULL && !strcmp (stats, "yes"));
+}
+
+
+/******************************************************************************
+MODULE: init_raw_binary_stats
+
+PURPOSE: Initializes the statistics accumulator for a band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        The data type of the band isn't supported
+SUCCESS      Initializing was successful
+
+NOTES:
+*****************************************************************************/
+int init_raw_binary_stats
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata; provides the data
+                                       type, fill value, and valid range */
+    Raw_binary_stats_t *stats    /* O: statistics accumulator */
+)
+{
+    char FUNC_NAME[] = "init_raw_binary_stats"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    bool is_integer = true;  /* is the data type an integer type? */
+    bool has_range;          /* does the band have a valid range? */
+    double width;            /* width of the histogram range */
+
+    memset (stats, 0, sizeof (Raw_binary_stats_t));
+    stats->data_type = bmeta->data_type;
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8:
+            stats->nbytes = 1;
+            stats->range_min = INT8_MIN;
+            stats->range_max = INT8_MAX;
+            break;
+        case ESPA_UINT8:
+            stats->nbytes = 1;
+            stats->range_min = 0;
+            stats->range_max = UINT8_MAX;
+            break;
+        case ESPA_INT16:
+            stats->nbytes = 2;
+            stats->range_min = INT16_MIN;
+            stats->range_max = INT16_MAX;
+            break;
+        case ESPA_UINT16:
+            stats->nbytes = 2;
+            stats->range_min = 0;
+            stats->range_max = UINT16_MAX;
+            break;
+        case ESPA_INT32:
+            stats->nbytes = 4;
+            stats->range_min = INT32_MIN;
+            stats->range_max = INT32_MAX;
+            break;
+        case ESPA_UINT32:
+            stats->nbytes = 4;
+            stats->range_min = 0;
+            stats->range_max = UINT32_MAX;
+            break;
+        case ESPA_FLOAT32:
+            stats->nbytes = 4;
+            stats->range_min = -FLT_MAX;
+            stats->range_max = FLT_MAX;
+            is_integer = false;
+            break;
+        case ESPA_FLOAT64:
+            stats->nbytes = 8;
+            stats->range_min = -DBL_MAX;
+            stats->range_max = DBL_MAX;
+            is_integer = false;
+            break;
+        default:
+            sprintf (errmsg, "Unsupported data type for the statistics of "
+                "band %s.", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+    }
+
+    stats->use_fill = (bmeta->fill_value != ESPA_INT_META_FILL);
+    stats->fill_value = bmeta->fill_value;
+
+    has_range = fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON && fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON && bmeta->valid_range[0] <= bmeta->valid_range[1];
+    if (has_range)
+    {
+        stats->range_min = bmeta->valid_range[0];
+        stats->range_max = bmeta->valid_range[1];
+    }
+
+    /* Summing relative to the middle of a finite range keeps the sum of
+       squares from losing precision */
+    if (has_range || is_integer)
+        stats->shift = floor ((stats->range_min + stats->range_max) / 2.0);
+
+    stats->min = DBL_MAX;
+    stats->max = -DBL_MAX;
+
+    /* Set up the histogram bins */
+    if (has_range || stats->nbytes == 1)
+    {
+        stats->hist_min = stats->range_min;
+        stats->hist_max = stats->range_max;
+        width = stats->hist_max - stats->hist_min;
+        if (is_integer)
+            width += 1.0;
+        stats->nbins = ESPA_STATS_NBINS;
+        if (is_integer && width < ESPA_STATS_NBINS)
+            stats->nbins = (int) width;
+        if (width > 0.0)
+            stats->bin_scale = stats->nbins / width;
+        else
+            stats->nbins = 1;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: accumulate_raw_binary_stats
+
+PURPOSE: Adds a block of pixels to the band statistics.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+*****************************************************************************/
+void accumulate_raw_binary_stats
+(
+    Raw_binary_stats_t *stats,   /* I/O: statistics accumulator */
+    const void *img_array,       /* I: block of pixels of the band's data
+                                       type */
+    size_t npixels               /* I: number of pixels in img_array */
+)
+{
+    switch (stats->data_type)
+    {
+        case ESPA_INT8:
+            accumulate_int8 (stats, img_array, npixels);
+            break;
+        case ESPA_UINT8:
+            accumulate_uint8 (stats, img_array, npixels);
+            break;
+        case ESPA_INT16:
+            accumulate_int16 (stats, img_array, npixels);
+            break;
+        case ESPA_UINT16:
+            accumulate_uint16 (stats, img_array, npixels);
+            break;
+        case ESPA_INT32:
+            accumulate_int32 (stats, img_array, npixels);
+            break;
+        case ESPA_UINT32:
+            accumulate_uint32 (stats, img_array, npixels);
+            break;
+        case ESPA_FLOAT32:
+            accumulate_float32 (stats, img_array, npixels);
+            break;
+        case ESPA_FLOAT64:
+            accumulate_float64 (stats, img_array, npixels);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE: finish_raw_binary_stats
+
+PURPOSE: Computes the final band statistics from the accumulator.
+ 
+RETURN VALUE: N/A
+
+NOTES:
+  1. The min, max, mean, and stddev are set to ESPA_FLOAT_META_FILL if there
+     are no valid pixels.
+*****************************************************************************/
+void finish_raw_binary_stats
+(
+    Raw_binary_stats_t *stats,   /* I: statistics accumulator */
+    Espa_band_stats_t *band_stats  /* O: statistics of the band */
+)
+{
+    double mean;             /* mean of the shifted valid values */
+    double variance;         /* variance of the valid values */
+
+    band_stats->valid_pixels = stats->valid_pixels;
+    band_stats->fill_pixels = stats->fill_pixels;
+    band_stats->out_of_range_pixels = stats->out_of_range_pixels;
+
+    if (stats->valid_pixels > 0)
+    {
+        mean = stats->sum / stats->valid_pixels;
+        variance = stats->sum_sq / stats->valid_pixels - mean * mean;
+        band_stats->min = stats->min;
+        band_stats->max = stats->max;
+        band_stats->mean = stats->shift + mean;
+        band_stats->stddev = (variance > 0.0) ? sqrt (variance) : 0.0;
+    }
+    else
+    {
+        band_stats->min = band_stats->max = ESPA_FLOAT_META_FILL;
+        band_stats->mean = band_stats->stddev = ESPA_FLOAT_META_FILL;
+    }
+
+    band_stats->nbins = stats->nbins;
+    band_stats->hist_min = stats->hist_min;
+    band_stats->hist_max = stats->hist_max;
+    memcpy (band_stats->histogram, stats->histogram,
+        stats->nbins * sizeof (long));
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************
+FILE: raw_binary_stats.h
+  
+PURPOSE: Contains defines, structures, and prototypes for accumulating the
+statistics of a raw binary band while it's written.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The statistics are accumulated a block of pixels at a time, so the band
+     doesn't have to be read again to compute them.  The fill_value and
+     valid_range of the band metadata decide which pixels are valid.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_STATS_H
+#define RAW_BINARY_STATS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Statistics accumulated so far for a band */
+typedef struct {
+    enum Espa_data_type data_type;  /* data type of the band */
+    int nbytes;                 /* number of bytes per pixel */
+    bool use_fill;              /* does the band have a fill value? */
+    double fill_value;          /* fill value of the band */
+    double range_min;           /* lowest valid value; the lowest value of
+                                   the data type if there is no valid
+                                   range */
+    double range_max;           /* highest valid value; the highest value of
+                                   the data type if there is no valid
+                                   range */
+    double shift;               /* value subtracted before summing, to keep
+                                   the sum of squares accurate */
+    long valid_pixels;          /* number of valid pixels */
+    long fill_pixels;           /* number of fill pixels */
+    long out_of_range_pixels;   /* number of non-fill, invalid pixels */
+    double min;                 /* minimum valid value */
+    double max;                 /* maximum valid value */
+    double sum;                 /* sum of the shifted valid values */
+    double sum_sq;              /* sum of squares of the shifted valid
+                                   values */
+    int nbins;                  /* number of histogram bins; 0 for none */
+    double hist_min;            /* lowest value covered by the histogram */
+    double hist_max;            /* highest value covered by the histogram */
+    double bin_scale;           /* bins per unit of pixel value */
+    long histogram[ESPA_STATS_NBINS];  /* number of valid pixels per bin */
+} Raw_binary_stats_t;
+
+/* Prototypes */
+bool use_raw_binary_stats ();
+
+int init_raw_binary_stats
+(
+    Espa_band_meta_t *bmeta,     /* I: band metadata; provides the data
+                                       type, fill value, and valid range */
+    Raw_binary_stats_t *stats    /* O: statistics accumulator */
+);
+
+void accumulate_raw_binary_stats
+(
+    Raw_binary_stats_t *stats,   /* I/O: statistics accumulator */
+    const void *img_array,       /* I: block of pixels of the band's data
+                                       type */
+    size_t npixels               /* I: number of pixels in img_array */
+);
+
+void finish_raw_binary_stats
+(
+    Raw_binary_stats_t *stats,   /* I: statistics accumulator */
+    Espa_band_stats_t *band_stats  /* O: statistics of the band */
+);
+
+#endif
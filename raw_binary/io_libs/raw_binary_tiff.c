@@ -0,0 +1,751 @@
+/*****************************************************************************
+FILE: raw_binary_tiff.c
+  
+PURPOSE: Contains functions for reading GeoTIFF bands with random access, as
+if they were raw binary bands, for virtual ESPA products.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_tiff.h for how GeoTIFF bands are used.
+  2. The band is decoded a block at a time, where a block is a full-width
+     row of strips or tiles.  The last RB_TIFF_CACHE_BLOCKS blocks decoded
+     are cached, so reading a band a line at a time (or a window at a time)
+     decodes each strip or tile once.
+  3. libtiff returns the samples in the native byte order, the same as the
+     raw binary bands.
+  4. The GeoTIFF tags are registered with libtiff so it doesn't warn about
+     them, without needing the GeoTIFF library itself.
+  5. A GeoTIFF band has a single libtiff handle, so it should only be read
+     by one thread at a time.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "tiffio.h"
+#include "raw_binary_tiff.h"
+
+/* Decoded block held in the cache */
+typedef struct
+{
+    long block;                 /* block held in this slot, or -1 */
+    unsigned long used;         /* clock value of the last use of the slot */
+    char *data;                 /* decoded block of block_bytes */
+} Rb_tiff_slot_t;
+
+/* GeoTIFF band opened for reading */
+struct raw_binary_tiff
+{
+    char file_name[STR_SIZE];   /* name of the GeoTIFF band */
+    TIFF *tif;                  /* libtiff handle of the band */
+    bool tiled;                 /* is the GeoTIFF tiled? */
+    bool scanlines;             /* read with TIFFReadScanline? */
+    uint32 width;               /* number of samples in a line */
+    uint32 length;              /* number of lines in the band */
+    int nbytes;                 /* number of bytes per sample */
+    uint32 tile_width;          /* width of a tile; 0 for strips */
+    uint32 block_lines;         /* number of lines in a block */
+    size_t row_bytes;           /* number of bytes in a line */
+    size_t block_bytes;         /* decoded size of a full block */
+    tmsize_t tile_size;         /* decoded size of a tile */
+    char *tile_buf;             /* buffer for a single tile */
+    off_t size;                 /* decoded size of the band */
+    unsigned long clock;        /* counter of the cache uses */
+    Rb_tiff_slot_t cache[RB_TIFF_CACHE_BLOCKS];  /* recently decoded blocks */
+    off_t pos;                  /* current position of the stream */
+};
+
+/* GeoTIFF tags, so libtiff reads them without warnings */
+static const TIFFFieldInfo geotiff_field_info[] =
+{
+    {33550, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, true, true,
+        "ModelPixelScaleTag"},
+    {33922, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, true, true,
+        "ModelTiepointTag"},
+    {34264, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, true, true,
+        "ModelTransformationTag"},
+    {34735, -1, -1, TIFF_SHORT, FIELD_CUSTOM, true, true,
+        "GeoKeyDirectoryTag"},
+    {34736, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, true, true,
+        "GeoDoubleParamsTag"},
+    {34737, -1, -1, TIFF_ASCII, FIELD_CUSTOM, true, false,
+        "GeoASCIIParamsTag"}
+};
+
+static TIFFExtendProc parent_extender = NULL;
+static pthread_once_t tag_extender_once = PTHREAD_ONCE_INIT;
+
+/******************************************************************************
+MODULE: extend_geotiff_tags
+
+PURPOSE: Tag extender which adds the GeoTIFF tags to each TIFF opened.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void extend_geotiff_tags
+(
+    TIFF *tif           /* I/O: TIFF being opened */
+)
+{
+    TIFFMergeFieldInfo (tif, geotiff_field_info,
+        sizeof (geotiff_field_info) / sizeof (geotiff_field_info[0]));
+    if (parent_extender != NULL)
+        (*parent_extender) (tif);
+}
+
+
+/******************************************************************************
+MODULE: init_tag_extender
+
+PURPOSE: Installs the GeoTIFF tag extender, once for the process.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+static void init_tag_extender ()
+{
+    parent_extender = TIFFSetTagExtender (extend_geotiff_tags);
+}
+
+
+/******************************************************************************
+MODULE: has_raw_binary_tiff_name
+
+PURPOSE: Determines if the band filename has a GeoTIFF extension.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The filename ends in .tif or .tiff, in any case
+false        The filename has another extension, or none
+
+NOTES:
+*****************************************************************************/
+bool has_raw_binary_tiff_name
+(
+    const char *file_name   /* I: name of the band file */
+)
+{
+    const char *ext = NULL;  /* extension of the filename */
+
+    ext = strrchr (file_name, '.');
+    if (ext == NULL || strchr (ext, '/') != NULL)
+        return (false);
+
+    return (!strcasecmp (ext, ".tif") || !strcasecmp (ext, ".tiff"));
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_tiff
+
+PURPOSE: Determines if the open band file is a GeoTIFF.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file has a GeoTIFF extension and starts with a TIFF or
+             BigTIFF signature
+false        The file is a plain raw binary band (or can't be read)
+
+NOTES:
+  1. The backend is selected by the filename from the band metadata, not by
+     the data, so a raw binary band whose first pixels happen to match the
+     TIFF signature is still read as raw binary.
+  2. The file is read with pread, so the file position isn't changed.
+*****************************************************************************/
+bool is_raw_binary_tiff
+(
+    const char *file_name,  /* I: name of the band file */
+    int fd              /* I: file descriptor of the band file */
+)
+{
+    unsigned char magic[4];  /* signature at the start of the file */
+
+    if (!has_raw_binary_tiff_name (file_name))
+        return (false);
+
+    if (pread (fd, magic, sizeof (magic), 0) != sizeof (magic))
+        return (false);
+
+    /* Little endian (II) or big endian (MM), then 42 for TIFF or 43 for
+       BigTIFF in that byte order */
+    if (magic[0] == 'I' && magic[1] == 'I' && magic[3] == 0)
+        return (magic[2] == 42 || magic[2] == 43);
+    if (magic[0] == 'M' && magic[1] == 'M' && magic[2] == 0)
+        return (magic[3] == 42 || magic[3] == 43);
+
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_tiff
+
+PURPOSE: Opens a GeoTIFF band for reading, and determines its strip or tile
+organization.
+ 
+RETURN VALUE:
+Type = Raw_binary_tiff_t *
+Value        Description
+-----        -----------
+NULL         Error opening the band, or it isn't a supported GeoTIFF
+non-NULL     Pointer to the opened GeoTIFF band
+
+NOTES:
+  1. Uncompressed strips longer than RB_TIFF_BLOCK_LINES (such as a single
+     strip for the whole band) are read a scanline at a time, in blocks of
+     RB_TIFF_BLOCK_LINES lines, to keep the cache small.
+*****************************************************************************/
+Raw_binary_tiff_t *open_raw_binary_tiff
+(
+    char *infile        /* I: name of the GeoTIFF band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_tiff"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the cache slots */
+    uint16 bits_per_sample;  /* bits per sample of the GeoTIFF */
+    uint16 samples_per_pixel;  /* samples per pixel of the GeoTIFF */
+    uint16 compression;      /* compression of the GeoTIFF */
+    uint32 rows_per_strip;   /* lines in a strip */
+    uint32 tile_length;      /* lines in a tile */
+    Raw_binary_tiff_t *rbt = NULL;  /* GeoTIFF band */
+
+    rbt = calloc (1, sizeof (Raw_binary_tiff_t));
+    if (rbt == NULL)
+    {
+        sprintf (errmsg, "Allocating the GeoTIFF band structure for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (rbt->file_name, infile, sizeof (rbt->file_name) - 1);
+    for (i = 0; i < RB_TIFF_CACHE_BLOCKS; i++)
+        rbt->cache[i].block = -1;
+
+    pthread_once (&tag_extender_once, init_tag_extender);
+    rbt->tif = TIFFOpen (infile, "r");
+    if (rbt->tif == NULL)
+    {
+        sprintf (errmsg, "Opening the GeoTIFF band %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbt);
+        return (NULL);
+    }
+
+    /* Get the size and layout of the band */
+    TIFFGetFieldDefaulted (rbt->tif, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+    TIFFGetFieldDefaulted (rbt->tif, TIFFTAG_SAMPLESPERPIXEL,
+        &samples_per_pixel);
+    TIFFGetFieldDefaulted (rbt->tif, TIFFTAG_COMPRESSION, &compression);
+    if (!TIFFGetField (rbt->tif, TIFFTAG_IMAGEWIDTH, &rbt->width) ||
+        !TIFFGetField (rbt->tif, TIFFTAG_IMAGELENGTH, &rbt->length) ||
+        rbt->width == 0 || rbt->length == 0 || samples_per_pixel != 1 ||
+        (bits_per_sample != 8 && bits_per_sample != 16 &&
+         bits_per_sample != 32 && bits_per_sample != 64))
+    {
+        sprintf (errmsg, "%s isn't a supported GeoTIFF band.  Only single "
+            "band GeoTIFFs of 8, 16, 32, or 64 bit samples are supported.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_tiff (rbt);
+        return (NULL);
+    }
+    rbt->nbytes = bits_per_sample / 8;
+    rbt->row_bytes = (size_t) rbt->width * rbt->nbytes;
+    rbt->size = (off_t) rbt->length * rbt->row_bytes;
+
+    rbt->tiled = TIFFIsTiled (rbt->tif);
+    if (rbt->tiled)
+    {
+        if (!TIFFGetField (rbt->tif, TIFFTAG_TILEWIDTH, &rbt->tile_width) ||
+            !TIFFGetField (rbt->tif, TIFFTAG_TILELENGTH, &tile_length) ||
+            rbt->tile_width == 0 || tile_length == 0)
+        {
+            sprintf (errmsg, "Tiles of the GeoTIFF band %s are invalid.",
+                infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_tiff (rbt);
+            return (NULL);
+        }
+        rbt->block_lines = tile_length;
+        rbt->tile_size = TIFFTileSize (rbt->tif);
+        rbt->tile_buf = malloc (rbt->tile_size);
+        if (rbt->tile_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the tile buffer for %s.", infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_tiff (rbt);
+            return (NULL);
+        }
+    }
+    else
+    {
+        TIFFGetFieldDefaulted (rbt->tif, TIFFTAG_ROWSPERSTRIP,
+            &rows_per_strip);
+        if (rows_per_strip == 0 || rows_per_strip > rbt->length)
+            rows_per_strip = rbt->length;
+        rbt->block_lines = rows_per_strip;
+        if (compression == COMPRESSION_NONE &&
+            rows_per_strip > RB_TIFF_BLOCK_LINES)
+        {
+            rbt->scanlines = true;
+            rbt->block_lines = RB_TIFF_BLOCK_LINES;
+        }
+    }
+    rbt->block_bytes = (size_t) rbt->block_lines * rbt->row_bytes;
+
+    return (rbt);
+}
+
+
+/******************************************************************************
+MODULE: decode_tiff_block
+
+PURPOSE: Decodes a block (a full-width row of strips or tiles) of the GeoTIFF
+band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading or decoding the block
+SUCCESS      Decoding was successful
+
+NOTES:
+  1. The last block of the band may have fewer than block_lines lines; only
+     its lines are decoded.
+*****************************************************************************/
+static int decode_tiff_block
+(
+    Raw_binary_tiff_t *rbt,     /* I/O: GeoTIFF band */
+    long block,         /* I: block to be decoded */
+    char *out           /* O: buffer for the decoded block */
+)
+{
+    char FUNC_NAME[] = "decode_tiff_block"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    uint32 line;             /* first line of the block */
+    uint32 nlines;           /* number of lines in the block */
+    uint32 samp;             /* first sample of the current tile */
+    uint32 nsamps;           /* number of samples used from the tile */
+    uint32 i;                /* looping variable for the lines */
+    size_t tile_row;         /* number of bytes in a line of a tile */
+    int status = SUCCESS;    /* return status */
+
+    line = (uint32) block * rbt->block_lines;
+    nlines = rbt->block_lines;
+    if (line + nlines > rbt->length)
+        nlines = rbt->length - line;
+
+    if (rbt->tiled)
+    {
+        /* Copy the lines of each tile across the block into place */
+        tile_row = (size_t) rbt->tile_width * rbt->nbytes;
+        for (samp = 0; samp < rbt->width && status == SUCCESS;
+            samp += rbt->tile_width)
+        {
+            if (TIFFReadEncodedTile (rbt->tif, TIFFComputeTile (rbt->tif,
+                samp, line, 0, 0), rbt->tile_buf, rbt->tile_size) == -1)
+            {
+                status = ERROR;
+                break;
+            }
+
+            nsamps = rbt->tile_width;
+            if (samp + nsamps > rbt->width)
+                nsamps = rbt->width - samp;
+            for (i = 0; i < nlines; i++)
+                memcpy (out + i * rbt->row_bytes + (size_t) samp *
+                    rbt->nbytes, rbt->tile_buf + i * tile_row,
+                    (size_t) nsamps * rbt->nbytes);
+        }
+    }
+    else if (rbt->scanlines)
+    {
+        for (i = 0; i < nlines; i++)
+        {
+            if (TIFFReadScanline (rbt->tif, out + i * rbt->row_bytes,
+                line + i, 0) == -1)
+            {
+                status = ERROR;
+                break;
+            }
+        }
+    }
+    else if (TIFFReadEncodedStrip (rbt->tif, TIFFComputeStrip (rbt->tif,
+        line, 0), out, (tmsize_t) nlines * rbt->row_bytes) == -1)
+        status = ERROR;
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Decoding lines %u-%u of the GeoTIFF band %s.",
+            line, line + nlines - 1, rbt->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: get_cached_block
+
+PURPOSE: Returns the decoded block from the cache, decoding it into the least
+recently used slot if it isn't already cached.
+ 
+RETURN VALUE:
+Type = char *
+Value        Description
+-----        -----------
+NULL         An error occurred decoding the block
+non-NULL     Pointer to the decoded block
+
+NOTES:
+*****************************************************************************/
+static char *get_cached_block
+(
+    Raw_binary_tiff_t *rbt,     /* I/O: GeoTIFF band */
+    long block          /* I: block to be returned */
+)
+{
+    char FUNC_NAME[] = "get_cached_block"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for the cache slots */
+    Rb_tiff_slot_t *slot = &rbt->cache[0];  /* slot for the block */
+
+    for (i = 0; i < RB_TIFF_CACHE_BLOCKS; i++)
+    {
+        if (rbt->cache[i].block == block)
+        {
+            rbt->cache[i].used = ++rbt->clock;
+            return (rbt->cache[i].data);
+        }
+        if (rbt->cache[i].used < slot->used)
+            slot = &rbt->cache[i];
+    }
+
+    /* Decode the block into the least recently used slot */
+    if (slot->data == NULL)
+    {
+        slot->data = malloc (rbt->block_bytes);
+        if (slot->data == NULL)
+        {
+            sprintf (errmsg, "Allocating a cache block of %lu bytes for %s.",
+                (unsigned long) rbt->block_bytes, rbt->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (NULL);
+        }
+    }
+
+    slot->block = -1;
+    if (decode_tiff_block (rbt, block, slot->data) != SUCCESS)
+        return (NULL);
+    slot->block = block;
+    slot->used = ++rbt->clock;
+
+    return (slot->data);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_tiff
+
+PURPOSE: Reads nbytes of decoded band data at the specified offset of the
+GeoTIFF band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the data, or the data is beyond the
+             end of the band
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Whole blocks which aren't cached are decoded directly into buf, so
+     reading a large part of the band doesn't churn the cache.  The partial
+     blocks at the ends of the range go through the cache.
+*****************************************************************************/
+int read_raw_binary_tiff
+(
+    Raw_binary_tiff_t *rbt,     /* I/O: GeoTIFF band */
+    off_t offset,       /* I: byte offset in the decoded band to read from */
+    size_t nbytes,      /* I: number of decoded bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_tiff"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *out = buf;         /* current output location */
+    char *data = NULL;       /* decoded block from the cache */
+    long block;              /* current block */
+    size_t within;           /* offset of the read in the current block */
+    size_t ncopy;            /* number of bytes copied */
+    int i;                   /* looping variable for the cache slots */
+
+    if (offset < 0 || offset + (off_t) nbytes > rbt->size)
+    {
+        sprintf (errmsg, "Reading %lu bytes at offset %ld is beyond the end "
+            "of the GeoTIFF band %s.", (unsigned long) nbytes, (long) offset,
+            rbt->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (nbytes > 0)
+    {
+        block = offset / rbt->block_bytes;
+        within = offset % rbt->block_bytes;
+        ncopy = rbt->block_bytes - within;
+        if (offset + (off_t) ncopy > rbt->size)
+            ncopy = rbt->size - offset;
+
+        /* Decode a whole block straight into the output, unless it's
+           already cached */
+        for (i = 0; i < RB_TIFF_CACHE_BLOCKS; i++)
+        {
+            if (rbt->cache[i].block == block)
+                break;
+        }
+        if (within == 0 && ncopy <= nbytes && i == RB_TIFF_CACHE_BLOCKS)
+        {
+            if (decode_tiff_block (rbt, block, out) != SUCCESS)
+                return (ERROR);
+        }
+        else
+        {
+            data = get_cached_block (rbt, block);
+            if (data == NULL)
+                return (ERROR);
+
+            if (ncopy > nbytes)
+                ncopy = nbytes;
+            memcpy (out, data + within, ncopy);
+        }
+
+        out += ncopy;
+        offset += ncopy;
+        nbytes -= ncopy;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_tiff_size
+
+PURPOSE: Returns the decoded size of the GeoTIFF band.
+ 
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+size         Number of bytes of band data
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_tiff_size
+(
+    Raw_binary_tiff_t *rbt      /* I: GeoTIFF band */
+)
+{
+    return (rbt->size);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_tiff
+
+PURPOSE: Closes the GeoTIFF band and frees its cache.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_tiff
+(
+    Raw_binary_tiff_t *rbt      /* I: GeoTIFF band to be closed */
+)
+{
+    int i;                   /* looping variable for the cache slots */
+
+    if (rbt == NULL)
+        return;
+
+    if (rbt->tif != NULL)
+        TIFFClose (rbt->tif);
+    for (i = 0; i < RB_TIFF_CACHE_BLOCKS; i++)
+        free (rbt->cache[i].data);
+    free (rbt->tile_buf);
+    free (rbt);
+}
+
+
+/******************************************************************************
+MODULE: tiff_stream_read
+
+PURPOSE: Read function of the stdio stream for a GeoTIFF band.
+ 
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           An error occurred reading the band
+0            The end of the band was reached
+n            Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t tiff_stream_read
+(
+    void *cookie,       /* I/O: GeoTIFF band */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    Raw_binary_tiff_t *rbt = cookie;   /* GeoTIFF band */
+
+    if (rbt->pos >= rbt->size)
+        return (0);
+    if ((off_t) size > rbt->size - rbt->pos)
+        size = rbt->size - rbt->pos;
+
+    if (read_raw_binary_tiff (rbt, rbt->pos, size, buf) != SUCCESS)
+        return (-1);
+    rbt->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: tiff_stream_seek
+
+PURPOSE: Seek function of the stdio stream for a GeoTIFF band, positioning
+the stream in the decoded band data.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The new position is invalid
+0            Seeking was successful
+
+NOTES:
+*****************************************************************************/
+static int tiff_stream_seek
+(
+    void *cookie,       /* I/O: GeoTIFF band */
+    off64_t *offset,    /* I/O: requested offset; returns the new position */
+    int whence          /* I: SEEK_SET, SEEK_CUR, or SEEK_END */
+)
+{
+    Raw_binary_tiff_t *rbt = cookie;   /* GeoTIFF band */
+    off64_t pos;             /* new position */
+
+    if (whence == SEEK_SET)
+        pos = *offset;
+    else if (whence == SEEK_CUR)
+        pos = rbt->pos + *offset;
+    else if (whence == SEEK_END)
+        pos = rbt->size + *offset;
+    else
+        return (-1);
+
+    if (pos < 0)
+        return (-1);
+    rbt->pos = pos;
+    *offset = pos;
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: tiff_stream_close
+
+PURPOSE: Close function of the stdio stream for a GeoTIFF band.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            Closing was successful
+
+NOTES:
+*****************************************************************************/
+static int tiff_stream_close
+(
+    void *cookie        /* I: GeoTIFF band */
+)
+{
+    close_raw_binary_tiff (cookie);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_tiff_stream
+
+PURPOSE: Opens a GeoTIFF band as a read-only stdio stream of the decoded band
+data, so it can be read with fread/fseek like a plain raw binary band.
+ 
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the GeoTIFF band
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. As with chunked bands (see open_raw_binary_chunked_stream), the stream
+     has a small (BUFSIZ) buffer, so large reads are handed to
+     read_raw_binary_tiff in one piece.
+  2. The stream has no file descriptor; fileno returns -1.
+*****************************************************************************/
+FILE *open_raw_binary_tiff_stream
+(
+    char *infile        /* I: name of the GeoTIFF band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_tiff_stream"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* stream for the GeoTIFF band */
+    Raw_binary_tiff_t *rbt = NULL;     /* GeoTIFF band */
+    cookie_io_functions_t funcs =      /* stream functions */
+        {tiff_stream_read, NULL, tiff_stream_seek, tiff_stream_close};
+
+    rbt = open_raw_binary_tiff (infile);
+    if (rbt == NULL)
+        return (NULL);
+
+    fptr = fopencookie (rbt, "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for the GeoTIFF band %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_tiff (rbt);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, BUFSIZ);
+
+    return (fptr);
+}
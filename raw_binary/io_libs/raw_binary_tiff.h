@@ -0,0 +1,90 @@
+/*****************************************************************************
+FILE: raw_binary_tiff.h
+  
+PURPOSE: Contains defines, structures, and prototypes for reading GeoTIFF
+bands in place of raw binary bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A virtual ESPA product (see convert_lpgs_to_espa) has band file_names
+     pointing at the source GeoTIFFs rather than at raw binary files.  The
+     GeoTIFF is decoded on demand, so reading it gives the same bytes as the
+     raw binary band which would have been converted from it: the lines of
+     the band in order, in the native byte order.
+  2. GeoTIFF bands are recognized by the .tif or .tiff extension of the
+     file_name in the band metadata, and the TIFF signature at the start of
+     the file is then checked.  The data of a headerless raw binary band may
+     start with any bytes, so the signature alone isn't used.  GeoTIFF bands
+     are read transparently by open_raw_binary/read_raw_binary,
+     read_raw_binary_window, and open_raw_binary_mapped (which decodes the
+     band into memory), but can't be opened for update.
+  3. Only single-sample (one band per file) GeoTIFFs are supported, which is
+     how the LPGS bands are delivered.  Stripped and tiled GeoTIFFs,
+     compressed or not, are supported.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_TIFF_H
+#define RAW_BINARY_TIFF_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+
+/* Number of decoded blocks (a full-width row of strips or tiles) cached for
+   each GeoTIFF band */
+#define RB_TIFF_CACHE_BLOCKS 8
+
+/* Number of lines in a block for uncompressed strips longer than this,
+   which are read a scanline at a time */
+#define RB_TIFF_BLOCK_LINES 256
+
+/* GeoTIFF band opened for reading; the contents are private */
+typedef struct raw_binary_tiff Raw_binary_tiff_t;
+
+/* Prototypes */
+bool has_raw_binary_tiff_name
+(
+    const char *file_name   /* I: name of the band file */
+);
+
+bool is_raw_binary_tiff
+(
+    const char *file_name,  /* I: name of the band file */
+    int fd              /* I: file descriptor of the band file */
+);
+
+Raw_binary_tiff_t *open_raw_binary_tiff
+(
+    char *infile        /* I: name of the GeoTIFF band to be opened */
+);
+
+int read_raw_binary_tiff
+(
+    Raw_binary_tiff_t *rbt,     /* I/O: GeoTIFF band */
+    off_t offset,       /* I: byte offset in the decoded band to read from */
+    size_t nbytes,      /* I: number of decoded bytes to read */
+    void *buf           /* O: buffer of nbytes */
+);
+
+off_t get_raw_binary_tiff_size
+(
+    Raw_binary_tiff_t *rbt      /* I: GeoTIFF band */
+);
+
+void close_raw_binary_tiff
+(
+    Raw_binary_tiff_t *rbt      /* I: GeoTIFF band to be closed */
+);
+
+FILE *open_raw_binary_tiff_stream
+(
+    char *infile        /* I: name of the GeoTIFF band to be opened */
+);
+
+#endif
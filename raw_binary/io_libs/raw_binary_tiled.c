@@ -0,0 +1,950 @@
+/*****************************************************************************
+FILE: raw_binary_tiled.c
+
+PURPOSE: Contains functions for converting raw binary bands to and from the
+internally tiled layout, and for reading tiled bands either as line-major
+band data or a window at a time.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_tiled.h for the layout of a tiled band.  The file is
+     written in the native byte order, the same as the raw binary band data.
+  2. The tiles of a row of tiles are contiguous in the file, so reading the
+     band line by line reads each row of tiles with a single pread, and a
+     window reads the tiles it touches in each row of tiles with a single
+     pread.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "raw_binary_tiled.h"
+#include "raw_binary_io.h"
+#include "raw_binary_checksum.h"
+#include "raw_binary_shm.h"
+#include "espa_profile.h"
+#include "espa_io_limit.h"
+
+/* Tiled band opened for reading */
+struct raw_binary_tiled
+{
+    char file_name[STR_SIZE];   /* name of the tiled band */
+    Raw_binary_tiled_header_t header;  /* description of the band */
+    int fd;                     /* file descriptor of the band file */
+    int nbytes;                 /* number of bytes per pixel */
+    int ntile_rows;             /* number of rows of tiles */
+    int ntile_cols;             /* number of tiles in a row of tiles */
+    size_t tile_bytes;          /* number of bytes in a tile */
+    size_t row_bytes;           /* number of bytes in a row of tiles */
+    char *row_buf;              /* current row of tiles; allocated on the
+                                   first line-major read */
+    int cached_row;             /* row of tiles in row_buf; -1 if none */
+    off_t size;                 /* size of the line-major band data */
+    off_t pos;                  /* current position of the stream */
+};
+
+/******************************************************************************
+MODULE: pread_tiled
+
+PURPOSE: Reads nbytes at the specified offset of the file, continuing after
+short reads and interrupts.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred or the end of the file was reached
+SUCCESS      Reading was successful
+
+NOTES:
+*****************************************************************************/
+static int pread_tiled
+(
+    int fd,             /* I: file descriptor of the tiled band */
+    void *buf,          /* O: buffer of nbytes */
+    size_t nbytes,      /* I: number of bytes to read */
+    off_t offset        /* I: byte offset in the file to read from */
+)
+{
+    ssize_t nread;           /* number of bytes read by the current call */
+
+    espa_io_throttle (ESPA_IO_READ, nbytes);
+    while (nbytes > 0)
+    {
+        nread = pread (fd, buf, nbytes, offset);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return (ERROR);
+        espa_profile_count_io (ESPA_PROFILE_READ, ESPA_PROFILE_POSIX, nread);
+
+        buf = (char *) buf + nread;
+        nbytes -= nread;
+        offset += nread;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: convert_band_layout
+
+PURPOSE: Rewrites a raw binary band either in tiles of the specified size or
+line by line, replacing the band file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred converting the band
+SUCCESS      Converting was successful
+
+NOTES:
+  1. The band is read through open_raw_binary, so it can be a plain, chunked,
+     GeoTIFF or tiled band.  It's written to a temporary file alongside the
+     band, which is renamed over the band once it's complete.
+  2. A row of tiles (or tile_nlines lines) is converted at a time.
+  3. The checksum of the band is recomputed if it has one, since it covers
+     the bytes of the file.  The statistics are unchanged.
+*****************************************************************************/
+static int convert_band_layout
+(
+    Espa_band_meta_t *bmeta,    /* I/O: band metadata of the band; the tiling
+                                      is updated */
+    int tile_nlines,            /* I: number of lines in a tile; 0 to write
+                                      the band line by line */
+    int tile_nsamps             /* I: number of samples in a tile */
+)
+{
+    char FUNC_NAME[] = "convert_band_layout"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tmp_file[STR_SIZE]; /* name of the temporary band file */
+    char *header_buf = NULL; /* padded header of the tiled band */
+    char *line_buf = NULL;   /* lines of the band read */
+    char *row_buf = NULL;    /* row of tiles written */
+    char *src = NULL;        /* current line of line_buf */
+    char *dst = NULL;        /* current line of a tile in row_buf */
+    int nbytes;              /* number of bytes per pixel */
+    int count;               /* number of chars copied in snprintf */
+    int line;                /* first line of the current block */
+    int nread_lines;         /* number of lines in the current block */
+    int block_lines;         /* number of lines per block */
+    int ntile_cols = 0;      /* number of tiles in a row of tiles */
+    int l, t;                /* looping variables */
+    int ncopy;               /* number of samples copied to a tile */
+    int status = ERROR;      /* return status */
+    size_t tile_bytes = 0;   /* number of bytes in a tile */
+    size_t line_bytes;       /* number of bytes in a band line */
+    size_t out_bytes;        /* number of bytes written per block */
+    uint32_t crc;            /* CRC32C of the converted band file */
+    FILE *in_fptr = NULL;    /* band being converted */
+    FILE *out_fptr = NULL;   /* converted band */
+    Raw_binary_tiled_header_t header;  /* header of the tiled band */
+
+    if (bmeta->constant.is_constant || bmeta->derived.is_derived)
+    {
+        sprintf (errmsg, "Band %s is a constant or derived band, which isn't "
+            "stored, so its layout can't be changed.", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    nbytes = get_data_type_size (bmeta->data_type);
+    if (nbytes == ERROR || (tile_nlines != 0 &&
+        (tile_nlines < 1 || tile_nsamps < 1)))
+    {
+        sprintf (errmsg, "Unsupported data type or tile size of %d lines x "
+            "%d samples for band %s.", tile_nlines, tile_nsamps, bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    line_bytes = (size_t) bmeta->nsamps * nbytes;
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.layout",
+        bmeta->file_name);
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of tmp_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the blocks of lines converted at a time */
+    if (tile_nlines != 0)
+    {
+        block_lines = tile_nlines;
+        ntile_cols = (bmeta->nsamps + tile_nsamps - 1) / tile_nsamps;
+        tile_bytes = (size_t) tile_nlines * tile_nsamps * nbytes;
+        out_bytes = ntile_cols * tile_bytes;
+    }
+    else
+    {
+        block_lines = RB_TILED_DEFAULT_SIZE;
+        out_bytes = block_lines * line_bytes;
+    }
+
+    line_buf = malloc (block_lines * line_bytes);
+    if (tile_nlines != 0)
+    {
+        row_buf = malloc (out_bytes);
+        header_buf = calloc (1, RB_TILED_HEADER_SIZE);
+    }
+    if (line_buf == NULL ||
+        (tile_nlines != 0 && (row_buf == NULL || header_buf == NULL)))
+    {
+        sprintf (errmsg, "Allocating the buffers for converting band %s.",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    in_fptr = open_raw_binary (bmeta->file_name, "rb");
+    if (in_fptr == NULL)
+        goto cleanup;
+    out_fptr = fopen (tmp_file, "wb");
+    if (out_fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the temporary band file %s.", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    if (tile_nlines != 0)
+    {
+        memset (&header, 0, sizeof (header));
+        memcpy (header.magic, RB_TILED_MAGIC, sizeof (header.magic));
+        header.version = RB_TILED_VERSION;
+        header.data_type = bmeta->data_type;
+        header.nlines = bmeta->nlines;
+        header.nsamps = bmeta->nsamps;
+        header.tile_nlines = tile_nlines;
+        header.tile_nsamps = tile_nsamps;
+        memcpy (header_buf, &header, sizeof (header));
+        if (fwrite (header_buf, RB_TILED_HEADER_SIZE, 1, out_fptr) != 1)
+        {
+            sprintf (errmsg, "Writing the header of band %s.", tmp_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    for (line = 0; line < bmeta->nlines; line += nread_lines)
+    {
+        nread_lines = block_lines;
+        if (line + nread_lines > bmeta->nlines)
+            nread_lines = bmeta->nlines - line;
+
+        if (read_raw_binary (in_fptr, nread_lines, bmeta->nsamps, nbytes,
+            line_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading line %d of band %s.", line,
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+
+        /* Lines are written as they are read */
+        if (tile_nlines == 0)
+        {
+            if (fwrite (line_buf, line_bytes, nread_lines, out_fptr) !=
+                (size_t) nread_lines)
+            {
+                sprintf (errmsg, "Writing line %d of band %s.", line,
+                    tmp_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                goto cleanup;
+            }
+            continue;
+        }
+
+        /* Scatter the lines into the row of tiles, padding the edge tiles
+           with zeros */
+        if (nread_lines < tile_nlines || bmeta->nsamps % tile_nsamps != 0)
+            memset (row_buf, 0, out_bytes);
+        for (t = 0; t < ntile_cols; t++)
+        {
+            ncopy = bmeta->nsamps - t * tile_nsamps;
+            if (ncopy > tile_nsamps)
+                ncopy = tile_nsamps;
+            src = line_buf + (size_t) t * tile_nsamps * nbytes;
+            dst = row_buf + t * tile_bytes;
+            for (l = 0; l < nread_lines; l++, src += line_bytes,
+                dst += (size_t) tile_nsamps * nbytes)
+                memcpy (dst, src, (size_t) ncopy * nbytes);
+        }
+
+        if (fwrite (row_buf, out_bytes, 1, out_fptr) != 1)
+        {
+            sprintf (errmsg, "Writing the tiles at line %d of band %s.",
+                line, tmp_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+    }
+
+    close_raw_binary (in_fptr);
+    in_fptr = NULL;
+    if (fclose (out_fptr) != 0)
+    {
+        out_fptr = NULL;
+        sprintf (errmsg, "Closing the temporary band file %s.", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+    out_fptr = NULL;
+
+    if (rename (tmp_file, bmeta->file_name) != 0)
+    {
+        sprintf (errmsg, "Replacing band %s with %s.", bmeta->file_name,
+            tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
+
+    /* Tag the band metadata with the new layout */
+    bmeta->tiling.is_tiled = (tile_nlines != 0);
+    bmeta->tiling.nlines = tile_nlines;
+    bmeta->tiling.nsamps = tile_nlines != 0 ? tile_nsamps : 0;
+    if (bmeta->checksum[0] != '\0')
+    {
+        if (compute_raw_binary_crc32c (bmeta->file_name, &crc) != SUCCESS)
+        {
+            sprintf (errmsg, "Computing the checksum of band %s.",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        format_raw_binary_checksum (crc, bmeta);
+    }
+    status = SUCCESS;
+
+cleanup:
+    if (in_fptr != NULL)
+        close_raw_binary (in_fptr);
+    if (out_fptr != NULL)
+    {
+        fclose (out_fptr);
+        unlink (tmp_file);
+    }
+    free (header_buf);
+    free (line_buf);
+    free (row_buf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_tiled
+
+PURPOSE: Rewrites a raw binary band in tiles of the specified size, and tags
+the band metadata with the tiling.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred tiling the band
+SUCCESS      Tiling was successful
+
+NOTES:
+  1. A band which is already tiled is re-tiled to the new tile size.
+  2. Constant and derived bands aren't stored, so they can't be tiled.
+*****************************************************************************/
+int write_raw_binary_tiled
+(
+    Espa_band_meta_t *bmeta,    /* I/O: band metadata of the band to be tiled;
+                                      provides the file name, size and data
+                                      type; the tiling is set */
+    int tile_nlines,            /* I: number of lines in a tile */
+    int tile_nsamps             /* I: number of samples in a tile */
+)
+{
+    char FUNC_NAME[] = "write_raw_binary_tiled"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    if (tile_nlines < 1 || tile_nsamps < 1)
+    {
+        sprintf (errmsg, "Invalid tile size of %d lines x %d samples for "
+            "band %s.", tile_nlines, tile_nsamps, bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (convert_band_layout (bmeta, tile_nlines, tile_nsamps));
+}
+
+
+/******************************************************************************
+MODULE: write_raw_binary_untiled
+
+PURPOSE: Rewrites a tiled band line by line, as a plain raw binary band, and
+clears the tiling of the band metadata.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred untiling the band
+SUCCESS      Untiling was successful
+
+NOTES:
+  1. This is only needed for consumers which read the band files directly
+     rather than through open_raw_binary.
+*****************************************************************************/
+int write_raw_binary_untiled
+(
+    Espa_band_meta_t *bmeta     /* I/O: band metadata of the tiled band;
+                                      provides the file name, size and data
+                                      type; the tiling is cleared */
+)
+{
+    return (convert_band_layout (bmeta, 0, 0));
+}
+
+
+/******************************************************************************
+MODULE: is_raw_binary_tiled
+
+PURPOSE: Determines if the open band file is a tiled band.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The file starts with the tiled band signature
+false        The file is a plain raw binary band (or can't be read)
+
+NOTES:
+  1. The file is read with pread, so the file position isn't changed.
+*****************************************************************************/
+bool is_raw_binary_tiled
+(
+    int fd              /* I: file descriptor of the band file */
+)
+{
+    char magic[8];           /* signature at the start of the file */
+
+    if (pread (fd, magic, sizeof (magic), 0) != sizeof (magic))
+        return (false);
+
+    return (memcmp (magic, RB_TILED_MAGIC, sizeof (magic)) == 0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_tiled
+
+PURPOSE: Opens a tiled band for reading.
+
+RETURN VALUE:
+Type = Raw_binary_tiled_t *
+Value        Description
+-----        -----------
+NULL         Error opening the band, or it isn't a valid tiled band
+non-NULL     Pointer to the opened tiled band
+
+NOTES:
+  1. Only the header is read, so opening a tiled band to read a window of it
+     is cheap.
+*****************************************************************************/
+Raw_binary_tiled_t *open_raw_binary_tiled
+(
+    char *infile        /* I: name of the tiled band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_tiled"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    struct stat statbuf;     /* buffer for the file stat function */
+    Raw_binary_tiled_header_t *header = NULL;  /* header of the band */
+    Raw_binary_tiled_t *rbt = NULL;       /* tiled band */
+
+    rbt = calloc (1, sizeof (Raw_binary_tiled_t));
+    if (rbt == NULL)
+    {
+        sprintf (errmsg, "Allocating the tiled band structure for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (rbt->file_name, infile, sizeof (rbt->file_name) - 1);
+    header = &rbt->header;
+    rbt->cached_row = -1;
+
+    rbt->fd = open_raw_binary_shm (infile, O_RDONLY);
+    if (rbt->fd == -1)
+        rbt->fd = open (infile, O_RDONLY);
+    if (rbt->fd == -1)
+    {
+        sprintf (errmsg, "Opening the tiled band %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (rbt);
+        return (NULL);
+    }
+    if (pread_tiled (rbt->fd, header, sizeof (*header), 0) != SUCCESS)
+        memset (header, 0, sizeof (*header));
+
+    /* Check the band description and that the file holds all the tiles */
+    rbt->nbytes = get_data_type_size (header->data_type);
+    if (memcmp (header->magic, RB_TILED_MAGIC, sizeof (header->magic)) ||
+        header->version != RB_TILED_VERSION || rbt->nbytes == ERROR ||
+        header->tile_nlines < 1 || header->tile_nsamps < 1)
+    {
+        sprintf (errmsg, "%s isn't a valid tiled band.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_tiled (rbt);
+        return (NULL);
+    }
+    rbt->ntile_rows = (header->nlines + header->tile_nlines - 1) /
+        header->tile_nlines;
+    rbt->ntile_cols = (header->nsamps + header->tile_nsamps - 1) /
+        header->tile_nsamps;
+    rbt->tile_bytes = (size_t) header->tile_nlines * header->tile_nsamps *
+        rbt->nbytes;
+    rbt->row_bytes = rbt->ntile_cols * rbt->tile_bytes;
+    rbt->size = (off_t) header->nlines * header->nsamps * rbt->nbytes;
+
+    if (fstat (rbt->fd, &statbuf) == -1 || statbuf.st_size <
+        RB_TILED_HEADER_SIZE + (off_t) rbt->ntile_rows * rbt->row_bytes)
+    {
+        sprintf (errmsg, "Tiled band %s is missing some of its tiles.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_tiled (rbt);
+        return (NULL);
+    }
+
+    return (rbt);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_tiled
+
+PURPOSE: Reads nbytes of line-major band data at the specified offset of the
+tiled band.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the data, or the data is beyond the
+             end of the band
+SUCCESS      Reading was successful
+
+NOTES:
+  1. The current row of tiles is kept, so reading the band a line at a time
+     reads each row of tiles once.
+*****************************************************************************/
+int read_raw_binary_tiled
+(
+    Raw_binary_tiled_t *rbt,    /* I/O: tiled band */
+    off_t offset,       /* I: byte offset in the line-major band data to read
+                              from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_tiled"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *out = buf;         /* current output location */
+    int tile_nlines = rbt->header.tile_nlines;  /* lines in a tile */
+    int tile_nsamps = rbt->header.tile_nsamps;  /* samples in a tile */
+    int row;                 /* row of tiles of the current line */
+    int line, samp;          /* current line and sample of the band */
+    int nsamps;              /* number of samples left in the tile line */
+    off_t pixel;             /* current pixel of the band */
+    size_t within;           /* offset of the read in the current pixel */
+    size_t ncopy;            /* number of bytes copied */
+    char *src = NULL;        /* current pixel in the row of tiles */
+
+    if (offset < 0 || offset + (off_t) nbytes > rbt->size)
+    {
+        sprintf (errmsg, "Reading %lu bytes at offset %ld is beyond the end "
+            "of the tiled band %s.", (unsigned long) nbytes, (long) offset,
+            rbt->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (nbytes > 0 && rbt->row_buf == NULL)
+    {
+        rbt->row_buf = malloc (rbt->row_bytes);
+        if (rbt->row_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating the row of tiles for %s.",
+                rbt->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    while (nbytes > 0)
+    {
+        pixel = offset / rbt->nbytes;
+        within = offset % rbt->nbytes;
+        line = pixel / rbt->header.nsamps;
+        samp = pixel % rbt->header.nsamps;
+
+        /* Read the row of tiles holding the line */
+        row = line / tile_nlines;
+        if (row != rbt->cached_row)
+        {
+            if (pread_tiled (rbt->fd, rbt->row_buf, rbt->row_bytes,
+                RB_TILED_HEADER_SIZE + (off_t) row * rbt->row_bytes)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Reading the tiles at line %d of the tiled "
+                    "band %s.", line, rbt->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                rbt->cached_row = -1;
+                return (ERROR);
+            }
+            rbt->cached_row = row;
+        }
+
+        /* Copy the rest of the line in the current tile */
+        src = rbt->row_buf + (samp / tile_nsamps) * rbt->tile_bytes +
+            ((size_t) (line % tile_nlines) * tile_nsamps +
+            samp % tile_nsamps) * rbt->nbytes;
+        nsamps = tile_nsamps - samp % tile_nsamps;
+        if (nsamps > (int) rbt->header.nsamps - samp)
+            nsamps = rbt->header.nsamps - samp;
+        ncopy = (size_t) nsamps * rbt->nbytes - within;
+        if (ncopy > nbytes)
+            ncopy = nbytes;
+        memcpy (out, src + within, ncopy);
+
+        out += ncopy;
+        offset += ncopy;
+        nbytes -= ncopy;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_tiled_window
+
+PURPOSE: Reads a window of nlines x nsamps pixels from the tiled band,
+starting at line0/samp0 and taking every stride'th line and sample.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the window, or the window doesn't fit
+             in the band
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Only the tiles the window touches are read, with one pread of the
+     contiguous tiles in each row of tiles.  Rows of tiles without any of the
+     strided window lines are skipped.
+  2. The band's row of tiles isn't used, so this can be called for the same
+     band from multiple threads.
+*****************************************************************************/
+int read_raw_binary_tiled_window
+(
+    Raw_binary_tiled_t *rbt,    /* I: tiled band */
+    int line0,          /* I: first line of the window (0-based) */
+    int samp0,          /* I: first sample of the window (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    int stride,         /* I: step between the lines/samples read */
+    void *img_array     /* O: array of nlines * nsamps pixels */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_tiled_window"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int tile_nlines = rbt->header.tile_nlines;  /* lines in a tile */
+    int tile_nsamps = rbt->header.tile_nsamps;  /* samples in a tile */
+    int nbytes = rbt->nbytes;  /* number of bytes per pixel */
+    long last_line;          /* last band line of the window */
+    long last_samp;          /* last band sample of the window */
+    int col0, col1;          /* first and last tile columns of the window */
+    int row;                 /* current row of tiles */
+    int l, s;                /* current window line and sample */
+    int line, samp;          /* current band line and sample */
+    int ncopy;               /* number of samples copied from a tile */
+    char *tiles = NULL;      /* tiles of the window in a row of tiles */
+    char *out = NULL;        /* current output pixel */
+    char *src = NULL;        /* current pixel in the tiles */
+    size_t run_bytes;        /* bytes of the tiles of the window in a row */
+
+    last_line = line0 + (long) (nlines - 1) * stride;
+    last_samp = samp0 + (long) (nsamps - 1) * stride;
+    if (stride < 1 || nlines < 1 || nsamps < 1 || line0 < 0 || samp0 < 0 ||
+        last_line >= rbt->header.nlines || last_samp >= rbt->header.nsamps)
+    {
+        sprintf (errmsg, "Window of %d lines x %d samples at line %d, sample "
+            "%d with a stride of %d doesn't fit in the tiled band %s.",
+            nlines, nsamps, line0, samp0, stride, rbt->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    col0 = samp0 / tile_nsamps;
+    col1 = last_samp / tile_nsamps;
+    run_bytes = (col1 - col0 + 1) * rbt->tile_bytes;
+    tiles = malloc (run_bytes);
+    if (tiles == NULL)
+    {
+        sprintf (errmsg, "Allocating the tiles for reading a window of %s.",
+            rbt->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    l = 0;
+    while (l < nlines)
+    {
+        /* Read the tiles of the window in the row of tiles of the next
+           window line */
+        line = line0 + l * stride;
+        row = line / tile_nlines;
+        if (pread_tiled (rbt->fd, tiles, run_bytes, RB_TILED_HEADER_SIZE +
+            (off_t) row * rbt->row_bytes + col0 * rbt->tile_bytes) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the tiles at line %d of the tiled band "
+                "%s.", line, rbt->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (tiles);
+            return (ERROR);
+        }
+
+        /* Copy the window lines in the row of tiles */
+        for (; l < nlines && (line = line0 + l * stride) / tile_nlines == row;
+            l++)
+        {
+            out = (char *) img_array + (size_t) l * nsamps * nbytes;
+            for (s = 0; s < nsamps; s += ncopy)
+            {
+                samp = samp0 + s * stride;
+                src = tiles + (samp / tile_nsamps - col0) * rbt->tile_bytes +
+                    ((size_t) (line % tile_nlines) * tile_nsamps +
+                    samp % tile_nsamps) * nbytes;
+                if (stride == 1)
+                {
+                    ncopy = tile_nsamps - samp % tile_nsamps;
+                    if (ncopy > nsamps - s)
+                        ncopy = nsamps - s;
+                }
+                else
+                    ncopy = 1;
+                memcpy (out + (size_t) s * nbytes, src,
+                    (size_t) ncopy * nbytes);
+            }
+        }
+    }
+
+    free (tiles);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_tiled_size
+
+PURPOSE: Returns the size of the line-major band data of the tiled band.
+
+RETURN VALUE:
+Type = off_t
+Value        Description
+-----        -----------
+size         Number of bytes of band data
+
+NOTES:
+*****************************************************************************/
+off_t get_raw_binary_tiled_size
+(
+    Raw_binary_tiled_t *rbt     /* I: tiled band */
+)
+{
+    return (rbt->size);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_tiled
+
+PURPOSE: Closes the tiled band.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_tiled
+(
+    Raw_binary_tiled_t *rbt     /* I: tiled band to be closed */
+)
+{
+    if (rbt == NULL)
+        return;
+
+    if (rbt->fd != -1)
+        close (rbt->fd);
+    free (rbt->row_buf);
+    free (rbt);
+}
+
+
+/******************************************************************************
+MODULE: tiled_stream_read
+
+PURPOSE: Read function of the stdio stream for a tiled band.
+
+RETURN VALUE:
+Type = ssize_t
+Value        Description
+-----        -----------
+-1           An error occurred reading the band
+0            The end of the band was reached
+n            Number of bytes read
+
+NOTES:
+*****************************************************************************/
+static ssize_t tiled_stream_read
+(
+    void *cookie,       /* I/O: tiled band */
+    char *buf,          /* O: buffer of size bytes */
+    size_t size         /* I: number of bytes requested */
+)
+{
+    Raw_binary_tiled_t *rbt = cookie;   /* tiled band */
+
+    if (rbt->pos >= rbt->size)
+        return (0);
+    if ((off_t) size > rbt->size - rbt->pos)
+        size = rbt->size - rbt->pos;
+
+    if (read_raw_binary_tiled (rbt, rbt->pos, size, buf) != SUCCESS)
+        return (-1);
+    rbt->pos += size;
+
+    return (size);
+}
+
+
+/******************************************************************************
+MODULE: tiled_stream_seek
+
+PURPOSE: Seek function of the stdio stream for a tiled band, positioning the
+stream in the line-major band data.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+-1           The new position is invalid
+0            Seeking was successful
+
+NOTES:
+*****************************************************************************/
+static int tiled_stream_seek
+(
+    void *cookie,       /* I/O: tiled band */
+    off64_t *offset,    /* I/O: requested offset; returns the new position */
+    int whence          /* I: SEEK_SET, SEEK_CUR, or SEEK_END */
+)
+{
+    Raw_binary_tiled_t *rbt = cookie;   /* tiled band */
+    off64_t pos;             /* new position */
+
+    if (whence == SEEK_SET)
+        pos = *offset;
+    else if (whence == SEEK_CUR)
+        pos = rbt->pos + *offset;
+    else if (whence == SEEK_END)
+        pos = rbt->size + *offset;
+    else
+        return (-1);
+
+    if (pos < 0)
+        return (-1);
+    rbt->pos = pos;
+    *offset = pos;
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: tiled_stream_close
+
+PURPOSE: Close function of the stdio stream for a tiled band.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+0            Closing was successful
+
+NOTES:
+*****************************************************************************/
+static int tiled_stream_close
+(
+    void *cookie        /* I: tiled band */
+)
+{
+    close_raw_binary_tiled (cookie);
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_tiled_stream
+
+PURPOSE: Opens a tiled band as a read-only stdio stream of the line-major band
+data, so it can be read with fread/fseek like a plain raw binary band.
+
+RETURN VALUE:
+Type = FILE *
+Value        Description
+-----        -----------
+NULL         Error opening the tiled band
+non-NULL     FILE pointer to the opened stream
+
+NOTES:
+  1. As with chunked bands (see open_raw_binary_chunked_stream), the stream
+     has a small (BUFSIZ) buffer, so large reads are handed to
+     read_raw_binary_tiled in one piece.
+  2. The stream has no file descriptor; fileno returns -1.
+*****************************************************************************/
+FILE *open_raw_binary_tiled_stream
+(
+    char *infile        /* I: name of the tiled band to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_tiled_stream"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    FILE *fptr = NULL;       /* stream for the tiled band */
+    Raw_binary_tiled_t *rbt = NULL;       /* tiled band */
+    cookie_io_functions_t funcs =         /* stream functions */
+        {tiled_stream_read, NULL, tiled_stream_seek, tiled_stream_close};
+
+    rbt = open_raw_binary_tiled (infile);
+    if (rbt == NULL)
+        return (NULL);
+
+    fptr = fopencookie (rbt, "rb", funcs);
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the stream for the tiled band %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_tiled (rbt);
+        return (NULL);
+    }
+    setvbuf (fptr, NULL, _IOFBF, BUFSIZ);
+
+    return (fptr);
+}
@@ -0,0 +1,129 @@
+/*****************************************************************************
+FILE: raw_binary_tiled.h
+  
+PURPOSE: Contains defines, structures, and prototypes for the internally
+tiled raw binary band layout.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A tiled band stores its pixels in tiles of tile_nlines x tile_nsamps
+     pixels rather than line by line, so a small 2D window of the band is a
+     few contiguous reads instead of one read per line.  The file holds a
+     Raw_binary_tiled_header_t, padded to RB_TILED_HEADER_SIZE bytes, then
+     the tiles row of tiles by row of tiles, left to right, each stored line
+     by line.  The tiles on the right and bottom edges of the band are padded
+     with zeros to the full tile size, so every tile is at a fixed offset.
+  2. The band metadata is tagged with the tile size (see Espa_tiling_t), so
+     readers of the XML know the layout without reading the band.
+  3. Tiled bands are recognized by the signature at the start of the file,
+     the same as chunked bands.  They are read transparently as line-major
+     band data by open_raw_binary/read_raw_binary and open_raw_binary_mapped
+     (which untiles the band in memory), so the exporters to other formats
+     convert to line-major order only as they read the band.
+     read_raw_binary_window reads only the tiles a window touches.  Tiled
+     bands can't be opened for update.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_TILED_H
+#define RAW_BINARY_TILED_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Signature at the start of a tiled band */
+#define RB_TILED_MAGIC "ESPATIL1"
+#define RB_TILED_VERSION 1
+
+/* Size of the header at the start of a tiled band; the tiles start on a page
+   boundary */
+#define RB_TILED_HEADER_SIZE 4096
+
+/* Default number of lines and samples in a tile */
+#define RB_TILED_DEFAULT_SIZE 256
+
+/* Header at the start of a tiled band file */
+typedef struct {
+    char magic[8];              /* RB_TILED_MAGIC, not NULL-terminated */
+    uint32_t version;           /* RB_TILED_VERSION */
+    uint32_t data_type;         /* Espa_data_type of the band */
+    uint32_t nlines;            /* number of lines in the band */
+    uint32_t nsamps;            /* number of samples per line */
+    uint32_t tile_nlines;       /* number of lines in a tile */
+    uint32_t tile_nsamps;       /* number of samples in a tile */
+} Raw_binary_tiled_header_t;
+
+/* Tiled band opened for reading; the contents are private */
+typedef struct raw_binary_tiled Raw_binary_tiled_t;
+
+/* Prototypes */
+int write_raw_binary_tiled
+(
+    Espa_band_meta_t *bmeta,    /* I/O: band metadata of the band to be tiled;
+                                      provides the file name, size and data
+                                      type; the tiling is set */
+    int tile_nlines,            /* I: number of lines in a tile */
+    int tile_nsamps             /* I: number of samples in a tile */
+);
+
+int write_raw_binary_untiled
+(
+    Espa_band_meta_t *bmeta     /* I/O: band metadata of the tiled band;
+                                      provides the file name, size and data
+                                      type; the tiling is cleared */
+);
+
+bool is_raw_binary_tiled
+(
+    int fd              /* I: file descriptor of the band file */
+);
+
+Raw_binary_tiled_t *open_raw_binary_tiled
+(
+    char *infile        /* I: name of the tiled band to be opened */
+);
+
+int read_raw_binary_tiled
+(
+    Raw_binary_tiled_t *rbt,    /* I/O: tiled band */
+    off_t offset,       /* I: byte offset in the line-major band data to read
+                              from */
+    size_t nbytes,      /* I: number of bytes to read */
+    void *buf           /* O: buffer of nbytes */
+);
+
+int read_raw_binary_tiled_window
+(
+    Raw_binary_tiled_t *rbt,    /* I: tiled band */
+    int line0,          /* I: first line of the window (0-based) */
+    int samp0,          /* I: first sample of the window (0-based) */
+    int nlines,         /* I: number of lines in the output window */
+    int nsamps,         /* I: number of samples in the output window */
+    int stride,         /* I: step between the lines/samples read */
+    void *img_array     /* O: array of nlines * nsamps pixels */
+);
+
+off_t get_raw_binary_tiled_size
+(
+    Raw_binary_tiled_t *rbt     /* I: tiled band */
+);
+
+void close_raw_binary_tiled
+(
+    Raw_binary_tiled_t *rbt     /* I: tiled band to be closed */
+);
+
+FILE *open_raw_binary_tiled_stream
+(
+    char *infile        /* I: name of the tiled band to be opened */
+);
+
+#endif
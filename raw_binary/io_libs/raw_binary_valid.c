@@ -0,0 +1,562 @@
+/*****************************************************************************
+FILE: raw_binary_valid.c
+  
+PURPOSE: Contains functions for writing the valid mask of a scene, and for
+finding its fill pixels from the mask.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_valid.h for the format of a valid mask.  The file is
+     written in the native byte order, the same as the raw binary band data.
+  2. The mask is written a line at a time as the lines are added, and the
+     line extents and the header are written when it's finished.
+*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "raw_binary_valid.h"
+
+/* Valid mask opened for writing or reading */
+struct raw_binary_valid
+{
+    char file_name[STR_SIZE];   /* name of the valid mask */
+    Raw_binary_valid_header_t header;  /* description of the mask */
+    Raw_binary_valid_line_t *lines;    /* extent of each line */
+    uint8_t *row;               /* bit-packed mask of a line */
+    int line;                   /* next line to be written */
+    FILE *fptr;                 /* valid mask being written; NULL if it's
+                                   opened for reading */
+    int fd;                     /* valid mask being read; -1 if it's opened
+                                   for writing */
+};
+
+/******************************************************************************
+MODULE: create_raw_binary_valid
+
+PURPOSE: Creates a valid mask, to be written a line at a time.
+ 
+RETURN VALUE:
+Type = Raw_binary_valid_t *
+Value        Description
+-----        -----------
+NULL         An error occurred creating the mask
+non-NULL     Valid mask to be written
+
+NOTES:
+  1. add_raw_binary_valid_line adds the lines, and finish_raw_binary_valid
+     finishes the mask once all the lines are added.
+*****************************************************************************/
+Raw_binary_valid_t *create_raw_binary_valid
+(
+    char *outfile,      /* I: name of the valid mask to be written */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps          /* I: number of samples per line */
+)
+{
+    char FUNC_NAME[] = "create_raw_binary_valid"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Raw_binary_valid_t *valid = NULL;  /* valid mask */
+
+    valid = calloc (1, sizeof (Raw_binary_valid_t));
+    if (valid == NULL)
+    {
+        sprintf (errmsg, "Allocating the valid mask structure for %s.",
+            outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (valid->file_name, outfile, sizeof (valid->file_name) - 1);
+    valid->fd = -1;
+
+    memcpy (valid->header.magic, RB_VALID_MAGIC, sizeof (valid->header.magic));
+    valid->header.version = RB_VALID_VERSION;
+    valid->header.nlines = nlines;
+    valid->header.nsamps = nsamps;
+    valid->header.row_bytes = (nsamps + 7) / 8;
+
+    valid->lines = calloc (nlines, sizeof (Raw_binary_valid_line_t));
+    valid->row = malloc (valid->header.row_bytes);
+    if (valid->lines == NULL || valid->row == NULL)
+    {
+        sprintf (errmsg, "Allocating the line extents of the valid mask %s.",
+            outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+
+    /* Write a placeholder for the header, which is rewritten once the
+       number of valid pixels is known */
+    valid->fptr = fopen (outfile, "wb");
+    if (valid->fptr == NULL ||
+        fwrite (&valid->header, sizeof (valid->header), 1, valid->fptr) != 1)
+    {
+        sprintf (errmsg, "Creating the valid mask %s.", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+
+    return (valid);
+}
+
+
+/******************************************************************************
+MODULE: add_raw_binary_valid_line
+
+PURPOSE: Adds the next line of the scene to a valid mask.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the line
+SUCCESS      Writing was successful
+
+NOTES:
+*****************************************************************************/
+int add_raw_binary_valid_line
+(
+    Raw_binary_valid_t *valid,  /* I/O: valid mask being written */
+    const uint8_t *fill_mask    /* I: nsamps pixels of the next line,
+                                      non-zero for the fill pixels */
+)
+{
+    char FUNC_NAME[] = "add_raw_binary_valid_line"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int samp;                /* looping variable for the samples */
+    int nsamps = valid->header.nsamps;  /* number of samples per line */
+    Raw_binary_valid_line_t *extent = NULL;  /* extent of the line */
+
+    if (valid->line >= (int) valid->header.nlines)
+    {
+        sprintf (errmsg, "All %u lines of the valid mask %s were already "
+            "added.", valid->header.nlines, valid->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    extent = &valid->lines[valid->line];
+
+    /* Pack the line, and find the extent of its valid pixels */
+    memset (valid->row, 0, valid->header.row_bytes);
+    for (samp = 0; samp < nsamps; samp++)
+    {
+        if (fill_mask[samp])
+            continue;
+
+        valid->row[samp >> 3] |= (uint8_t) (1 << (samp & 7));
+        if (extent->nvalid == 0)
+            extent->start = samp;
+        extent->end = samp + 1;
+        extent->nvalid++;
+    }
+
+    if (fwrite (valid->row, valid->header.row_bytes, 1, valid->fptr) != 1)
+    {
+        sprintf (errmsg, "Writing line %d of the valid mask %s.", valid->line,
+            valid->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    valid->header.nvalid += extent->nvalid;
+    valid->line++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: finish_raw_binary_valid
+
+PURPOSE: Writes the line extents and the header of a valid mask once all the
+lines are added, and closes it.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred writing the mask
+SUCCESS      Writing was successful
+
+NOTES:
+*****************************************************************************/
+int finish_raw_binary_valid
+(
+    Raw_binary_valid_t *valid   /* I: valid mask being written; it's closed
+                                      even if an error occurs */
+)
+{
+    char FUNC_NAME[] = "finish_raw_binary_valid"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int status = SUCCESS;    /* return status */
+    FILE *fptr = valid->fptr;  /* valid mask file */
+
+    if (valid->line != (int) valid->header.nlines)
+    {
+        sprintf (errmsg, "Only %d of the %u lines of the valid mask %s were "
+            "added.", valid->line, valid->header.nlines, valid->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (ERROR);
+    }
+
+    if (fwrite (valid->lines, sizeof (Raw_binary_valid_line_t),
+            valid->header.nlines, fptr) != valid->header.nlines ||
+        fseek (fptr, 0, SEEK_SET) != 0 ||
+        fwrite (&valid->header, sizeof (valid->header), 1, fptr) != 1)
+        status = ERROR;
+
+    valid->fptr = NULL;
+    if (fclose (fptr) != 0)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the line extents of the valid mask %s.",
+            valid->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    close_raw_binary_valid (valid);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE: open_raw_binary_valid
+
+PURPOSE: Opens a valid mask for reading, and loads its line extents.
+ 
+RETURN VALUE:
+Type = Raw_binary_valid_t *
+Value        Description
+-----        -----------
+NULL         An error occurred opening the mask
+non-NULL     Valid mask
+
+NOTES:
+*****************************************************************************/
+Raw_binary_valid_t *open_raw_binary_valid
+(
+    char *infile        /* I: name of the valid mask to be opened */
+)
+{
+    char FUNC_NAME[] = "open_raw_binary_valid"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int line;                /* looping variable for the lines */
+    off_t offset;            /* offset of the line extents in the file */
+    size_t nbytes;           /* size of the line extents */
+    Raw_binary_valid_header_t *header = NULL;  /* description of the mask */
+    Raw_binary_valid_line_t *extent = NULL;    /* extent of a line */
+    Raw_binary_valid_t *valid = NULL;  /* valid mask */
+
+    valid = calloc (1, sizeof (Raw_binary_valid_t));
+    if (valid == NULL)
+    {
+        sprintf (errmsg, "Allocating the valid mask structure for %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (valid->file_name, infile, sizeof (valid->file_name) - 1);
+    header = &valid->header;
+
+    valid->fd = open (infile, O_RDONLY);
+    if (valid->fd < 0)
+    {
+        sprintf (errmsg, "Opening the valid mask %s.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+    if (pread (valid->fd, header, sizeof (*header), 0) != sizeof (*header))
+        memset (header, 0, sizeof (*header));
+
+    if (memcmp (header->magic, RB_VALID_MAGIC, sizeof (header->magic)) ||
+        header->version != RB_VALID_VERSION ||
+        header->row_bytes != (header->nsamps + 7) / 8)
+    {
+        sprintf (errmsg, "%s isn't a valid mask.", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+
+    /* Load the line extents, which follow the mask */
+    nbytes = (size_t) header->nlines * sizeof (Raw_binary_valid_line_t);
+    offset = sizeof (*header) + (off_t) header->nlines * header->row_bytes;
+    valid->lines = malloc (nbytes);
+    valid->row = malloc (header->row_bytes);
+    if (valid->lines == NULL || valid->row == NULL)
+    {
+        sprintf (errmsg, "Allocating the line extents of the valid mask %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+    if (pread (valid->fd, valid->lines, nbytes, offset) != (ssize_t) nbytes)
+    {
+        sprintf (errmsg, "Reading the line extents of the valid mask %s.",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+
+    /* Make sure the extents are within the lines */
+    for (line = 0; line < (int) header->nlines; line++)
+    {
+        extent = &valid->lines[line];
+        if (extent->start > extent->end || extent->end > header->nsamps ||
+            extent->nvalid > extent->end - extent->start)
+        {
+            sprintf (errmsg, "Line %d of the valid mask %s has an invalid "
+                "extent.", line, infile);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary_valid (valid);
+            return (NULL);
+        }
+    }
+
+    return (valid);
+}
+
+
+/******************************************************************************
+MODULE: open_scene_valid_mask
+
+PURPOSE: Opens the valid mask of the scene for a band, if the scene has one
+and it applies to the band.
+ 
+RETURN VALUE:
+Type = Raw_binary_valid_t *
+Value        Description
+-----        -----------
+NULL         The scene has no valid mask for the band
+non-NULL     Valid mask of the scene
+
+NOTES:
+  1. The mask applies to the bands the size of the mask.  A mask which can't
+     be opened is reported as a warning, and the caller reads the bands to
+     find the fill pixels instead.
+*****************************************************************************/
+Raw_binary_valid_t *open_scene_valid_mask
+(
+    Espa_internal_meta_t *xml_meta,  /* I: metadata of the scene */
+    Espa_band_meta_t *bmeta     /* I: band the mask is used for */
+)
+{
+    char FUNC_NAME[] = "open_scene_valid_mask"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* global metadata */
+    Raw_binary_valid_t *valid = NULL;  /* valid mask */
+
+    if (!strcmp (gmeta->valid_mask, ESPA_STRING_META_FILL))
+        return (NULL);
+
+    valid = open_raw_binary_valid (gmeta->valid_mask);
+    if (valid == NULL)
+    {
+        sprintf (errmsg, "The valid mask %s of the scene isn't used.",
+            gmeta->valid_mask);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    if (valid->header.nlines != bmeta->nlines ||
+        valid->header.nsamps != bmeta->nsamps)
+    {
+        close_raw_binary_valid (valid);
+        return (NULL);
+    }
+
+    return (valid);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_valid_line
+
+PURPOSE: Gets the extent of the valid pixels of a line.
+ 
+RETURN VALUE:
+Type = const Raw_binary_valid_line_t *
+Value        Description
+-----        -----------
+non-NULL     Extent of the line
+
+NOTES:
+*****************************************************************************/
+const Raw_binary_valid_line_t *get_raw_binary_valid_line
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask */
+    int line            /* I: line of the mask */
+)
+{
+    return (&valid->lines[line]);
+}
+
+
+/******************************************************************************
+MODULE: get_raw_binary_valid_extent
+
+PURPOSE: Gets the extent of the valid pixels of a block of lines, as offsets
+from the first pixel of the block.
+ 
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The block has valid pixels
+false        The block is all fill
+
+NOTES:
+  1. The pixels of the block before first and from end on are all fill.
+*****************************************************************************/
+bool get_raw_binary_valid_extent
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask */
+    int line,           /* I: first line of the block */
+    int nlines,         /* I: number of lines in the block */
+    long *first,        /* O: first valid pixel of the block */
+    long *end           /* O: pixel after the last valid pixel of the
+                              block */
+)
+{
+    int l;                   /* looping variable for the lines */
+    long nsamps = valid->header.nsamps;  /* number of samples per line */
+    bool found = false;      /* was a valid pixel found? */
+    Raw_binary_valid_line_t *extent = NULL;  /* extent of a line */
+
+    *first = 0;
+    *end = 0;
+    for (l = 0; l < nlines; l++)
+    {
+        extent = &valid->lines[line + l];
+        if (extent->nvalid == 0)
+            continue;
+
+        if (!found)
+            *first = l * nsamps + extent->start;
+        *end = l * nsamps + extent->end;
+        found = true;
+    }
+
+    return (found);
+}
+
+
+/******************************************************************************
+MODULE: read_raw_binary_valid
+
+PURPOSE: Reads the fill mask of a block of lines from a valid mask.
+ 
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        An error occurred reading the mask
+SUCCESS      Reading was successful
+
+NOTES:
+  1. Only the lines with fill inside their extent are read from the file;
+     the others are set from their extent.
+*****************************************************************************/
+int read_raw_binary_valid
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask */
+    int line,           /* I: first line of the block */
+    int nlines,         /* I: number of lines in the block */
+    uint8_t *fill_mask  /* O: nlines x nsamps pixels, RB_VALID_FILL for the
+                              fill pixels and RB_VALID_CLEAR otherwise */
+)
+{
+    char FUNC_NAME[] = "read_raw_binary_valid"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int l;                   /* looping variable for the lines */
+    uint32_t samp;           /* looping variable for the samples */
+    uint32_t row_bytes = valid->header.row_bytes;  /* bytes per mask line */
+    size_t nsamps = valid->header.nsamps;  /* number of samples per line */
+    uint8_t *mask = NULL;    /* fill mask of the current line */
+    Raw_binary_valid_line_t *extent = NULL;  /* extent of the current line */
+
+    if (line < 0 || nlines < 0 ||
+        line + nlines > (int) valid->header.nlines)
+    {
+        sprintf (errmsg, "Lines %d-%d are outside the valid mask %s.", line,
+            line + nlines - 1, valid->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (l = 0; l < nlines; l++)
+    {
+        extent = &valid->lines[line + l];
+        mask = fill_mask + l * nsamps;
+
+        /* Fill before and after the extent */
+        memset (mask, RB_VALID_FILL, extent->start);
+        memset (mask + extent->end, RB_VALID_FILL, nsamps - extent->end);
+
+        /* The extent is all valid unless it has fill inside it */
+        if (extent->nvalid == extent->end - extent->start)
+        {
+            memset (mask + extent->start, RB_VALID_CLEAR, extent->nvalid);
+            continue;
+        }
+
+        if (pread (valid->fd, valid->row, row_bytes,
+            sizeof (valid->header) + (off_t) (line + l) * row_bytes) !=
+            (ssize_t) row_bytes)
+        {
+            sprintf (errmsg, "Reading line %d of the valid mask %s.",
+                line + l, valid->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (samp = extent->start; samp < extent->end; samp++)
+        {
+            mask[samp] = ((valid->row[samp >> 3] >> (samp & 7)) & 1) ?
+                RB_VALID_CLEAR : RB_VALID_FILL;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE: close_raw_binary_valid
+
+PURPOSE: Closes a valid mask and frees its memory.  A mask being written is
+closed without being finished.
+ 
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+*****************************************************************************/
+void close_raw_binary_valid
+(
+    Raw_binary_valid_t *valid   /* I: valid mask to be closed */
+)
+{
+    if (valid == NULL)
+        return;
+
+    if (valid->fptr != NULL)
+        fclose (valid->fptr);
+    if (valid->fd >= 0)
+        close (valid->fd);
+    free (valid->lines);
+    free (valid->row);
+    free (valid);
+}
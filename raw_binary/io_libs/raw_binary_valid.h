@@ -0,0 +1,132 @@
+/*****************************************************************************
+FILE: raw_binary_valid.h
+  
+PURPOSE: Contains defines, structures, and prototypes for the valid mask of
+a scene, which records the pixels that aren't fill in any band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The valid mask is written by clip_band_misalignment, which already
+     finds the pixels that are fill in any band, and is referenced by the
+     valid_mask of the global metadata.  It applies to the bands the size of
+     the mask; the later stages use it to find the fill pixels without
+     reading the bands.
+  2. The file holds a Raw_binary_valid_header_t, the bit-packed mask (one bit
+     per pixel, set for the valid pixels, the first sample of a line in the
+     lowest bit of the first byte of the line), and the extent of the valid
+     pixels of each line (Raw_binary_valid_line_t).
+  3. The line extents are loaded when the mask is opened, so the lines or
+     blocks which are all fill, and the part of a line outside its extent,
+     can be skipped without reading the mask.  Only the lines with fill
+     inside their extent need their mask read.
+*****************************************************************************/
+
+#ifndef RAW_BINARY_VALID_H
+#define RAW_BINARY_VALID_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Signature at the start of a valid mask */
+#define RB_VALID_MAGIC "ESPAVLD1"
+#define RB_VALID_VERSION 1
+
+/* Values of the unpacked mask for fill and valid pixels, the same as the
+   fill masks of the level 1 library */
+#define RB_VALID_FILL 0xFF
+#define RB_VALID_CLEAR 0x00
+
+/* Header of a valid mask file */
+typedef struct {
+    char magic[8];              /* RB_VALID_MAGIC, not NULL-terminated */
+    uint32_t version;           /* RB_VALID_VERSION */
+    uint32_t nlines;            /* number of lines in the mask */
+    uint32_t nsamps;            /* number of samples per line */
+    uint32_t row_bytes;         /* number of bytes per line of the mask */
+    uint32_t reserved;          /* unused, set to 0 */
+    uint64_t nvalid;            /* number of valid pixels */
+} Raw_binary_valid_header_t;
+
+/* Extent of the valid pixels of a line; start and end are 0 if the line is
+   all fill */
+typedef struct {
+    uint32_t start;             /* first valid sample */
+    uint32_t end;               /* sample after the last valid sample */
+    uint32_t nvalid;            /* number of valid pixels; end - start if
+                                   there is no fill inside the extent */
+} Raw_binary_valid_line_t;
+
+/* Valid mask opened for writing or reading; the contents are private */
+typedef struct raw_binary_valid Raw_binary_valid_t;
+
+/* Prototypes */
+Raw_binary_valid_t *create_raw_binary_valid
+(
+    char *outfile,      /* I: name of the valid mask to be written */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps          /* I: number of samples per line */
+);
+
+int add_raw_binary_valid_line
+(
+    Raw_binary_valid_t *valid,  /* I/O: valid mask being written */
+    const uint8_t *fill_mask    /* I: nsamps pixels of the next line,
+                                      non-zero for the fill pixels */
+);
+
+int finish_raw_binary_valid
+(
+    Raw_binary_valid_t *valid   /* I: valid mask being written; it's closed
+                                      even if an error occurs */
+);
+
+Raw_binary_valid_t *open_raw_binary_valid
+(
+    char *infile        /* I: name of the valid mask to be opened */
+);
+
+Raw_binary_valid_t *open_scene_valid_mask
+(
+    Espa_internal_meta_t *xml_meta,  /* I: metadata of the scene */
+    Espa_band_meta_t *bmeta     /* I: band the mask is used for */
+);
+
+const Raw_binary_valid_line_t *get_raw_binary_valid_line
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask */
+    int line            /* I: line of the mask */
+);
+
+bool get_raw_binary_valid_extent
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask */
+    int line,           /* I: first line of the block */
+    int nlines,         /* I: number of lines in the block */
+    long *first,        /* O: first valid pixel of the block */
+    long *end           /* O: pixel after the last valid pixel of the
+                              block */
+);
+
+int read_raw_binary_valid
+(
+    Raw_binary_valid_t *valid,  /* I: valid mask */
+    int line,           /* I: first line of the block */
+    int nlines,         /* I: number of lines in the block */
+    uint8_t *fill_mask  /* O: nlines x nsamps pixels, RB_VALID_FILL for the
+                              fill pixels and RB_VALID_CLEAR otherwise */
+);
+
+void close_raw_binary_valid
+(
+    Raw_binary_valid_t *valid   /* I: valid mask to be closed */
+);
+
+#endif
@@ -16,9 +16,280 @@ NOTES:
      the ESPA internal metadata format is available at
      http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
 *****************************************************************************/
+#define _GNU_SOURCE
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
 #include "subset_metadata.h"
 
+/******************************************************************************
+MODULE:  copy_subset_band
+
+PURPOSE: Copies the metadata of a band to a band of the subset metadata
+structure.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the band metadata
+SUCCESS         Successfully copied the band metadata
+
+NOTES:
+******************************************************************************/
+static int copy_subset_band
+(
+    Espa_band_meta_t *out_band,    /* O: band of the subset metadata */
+    Espa_band_meta_t *in_band      /* I: band of the input metadata */
+)
+{
+    char FUNC_NAME[] = "copy_subset_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int k;                   /* looping variable */
+    int count;               /* number of chars copied in snprintf */
+
+    count = snprintf (out_band->product,
+        sizeof (out_band->product), "%s",
+        in_band->product);
+    if (count < 0 || count >= sizeof (out_band->product))
+    {
+        sprintf (errmsg, "Overflow of out_band->product string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->source,
+        sizeof (out_band->source), "%s", in_band->source);
+    if (count < 0 || count >= sizeof (out_band->source))
+    {
+        sprintf (errmsg, "Overflow of out_band->source string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->name,
+        sizeof (out_band->name), "%s",
+        in_band->name);
+    if (count < 0 || count >= sizeof (out_band->name))
+    {
+        sprintf (errmsg, "Overflow of out_band->name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->category,
+        sizeof (out_band->category), "%s",
+        in_band->category);
+    if (count < 0 || count >= sizeof (out_band->category))
+    {
+        sprintf (errmsg, "Overflow of out_band->category "
+            "string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    out_band->data_type = in_band->data_type;
+    out_band->nlines = in_band->nlines;
+    out_band->nsamps = in_band->nsamps;
+    out_band->fill_value = in_band->fill_value;
+    out_band->saturate_value = in_band->saturate_value;
+    out_band->scale_factor = in_band->scale_factor;
+    out_band->add_offset = in_band->add_offset;
+    out_band->resample_method = in_band->resample_method;
+    count = snprintf (out_band->short_name,
+        sizeof (out_band->short_name), "%s",
+        in_band->short_name);
+    if (count < 0 || count >= sizeof (out_band->short_name))
+    {
+        sprintf (errmsg, "Overflow of out_band->short_name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->long_name,
+        sizeof (out_band->long_name), "%s",
+        in_band->long_name);
+    if (count < 0 || count >= sizeof (out_band->long_name))
+    {
+        sprintf (errmsg, "Overflow of out_band->long_name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->file_name,
+        sizeof (out_band->file_name), "%s",
+        in_band->file_name);
+    if (count < 0 || count >= sizeof (out_band->file_name))
+    {
+        sprintf (errmsg, "Overflow of out_band->file_name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    out_band->pixel_size[0] = in_band->pixel_size[0];
+    out_band->pixel_size[1] = in_band->pixel_size[1];
+    count = snprintf (out_band->pixel_units,
+        sizeof (out_band->pixel_units), "%s",
+        in_band->pixel_units);
+    if (count < 0 || count >= sizeof (out_band->pixel_units))
+    {
+        sprintf (errmsg, "Overflow of out_band->pixel_units");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->data_units,
+        sizeof (out_band->data_units), "%s",
+        in_band->data_units);
+    if (count < 0 || count >= sizeof (out_band->data_units))
+    {
+        sprintf (errmsg, "Overflow of out_band->data_units");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    out_band->valid_range[0] = in_band->valid_range[0];
+    out_band->valid_range[1] = in_band->valid_range[1];
+    out_band->valid_range[0] = in_band->valid_range[0];
+    out_band->valid_range[1] = in_band->valid_range[1];
+    out_band->rad_gain = in_band->rad_gain;
+    out_band->rad_bias = in_band->rad_bias;
+    out_band->refl_gain = in_band->refl_gain;
+    out_band->refl_bias = in_band->refl_bias;
+    out_band->k1_const = in_band->k1_const;
+    out_band->k2_const = in_band->k2_const;
+
+    /* If there is a bitmap description, then allocate memory and copy
+       the information */
+    out_band->nbits = in_band->nbits;
+    if (in_band->nbits != 0)
+    {
+        if (allocate_bitmap_metadata (out_band,
+            out_band->nbits) != SUCCESS)
+        {  /* Error messages already printed */
+            return (ERROR);
+        }
+
+        for (k = 0; k < in_band->nbits; k++)
+        {
+            count = snprintf (out_band->bitmap_description[k],
+                STR_SIZE, "%s", in_band->bitmap_description[k]);
+            if (count < 0 || count >= STR_SIZE)
+            {
+                sprintf (errmsg, "Overflow of "
+                    "out_band->bitmap_description[k] string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* If there are class descriptions, then allocate memory and copy
+       the information */
+    out_band->nclass = in_band->nclass;
+    if (in_band->nclass != 0)
+    {
+        if (allocate_class_metadata (out_band,
+            out_band->nclass) != SUCCESS)
+        {  /* Error messages already printed */
+            return (ERROR);
+        }
+
+        for (k = 0; k < in_band->nclass; k++)
+        {
+            out_band->class_values[k].class =
+                in_band->class_values[k].class;
+            count = snprintf (
+                out_band->class_values[k].description,
+                sizeof (out_band->class_values[k].description),
+                "%s", in_band->class_values[k].description);
+            if (count < 0 || count >=
+                sizeof (out_band->class_values[k].description))
+            {
+                sprintf (errmsg, "Overflow of "
+                    "out_band->class_values[k].description");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* If there are cover type descriptions, then allocate memory and
+       copy the information */
+    out_band->ncover = in_band->ncover;
+    if (in_band->ncover != 0)
+    {
+        if (allocate_percent_coverage_metadata (out_band,
+            out_band->ncover) != SUCCESS)
+        {  /* Error messages already printed */
+            return (ERROR);
+        }
+
+        for (k = 0; k < in_band->ncover; k++)
+        {
+             out_band->percent_cover[k].percent =
+                 in_band->percent_cover[k].percent;
+             count = snprintf (
+                 out_band->percent_cover[k].description,
+                 sizeof (out_band->percent_cover[k].description),
+                 "%s", in_band->percent_cover[k].description);
+             if (count < 0 || count >= sizeof
+                  (out_band->percent_cover[k].description))
+             {
+                 sprintf (errmsg, "Overflow of "
+                     "out_band->percent_cover[k].description");
+                 error_handler (true, FUNC_NAME, errmsg);
+                 return (ERROR);
+             }
+        }
+    }
+
+    /* The band data is the same, so the statistics still apply */
+    out_band->stats = in_band->stats;
+    strcpy (out_band->checksum, in_band->checksum);
+    out_band->sub_sample = in_band->sub_sample;
+    out_band->constant = in_band->constant;
+    out_band->derived = in_band->derived;
+    out_band->tiling = in_band->tiling;
+
+    count = snprintf (out_band->qa_desc,
+        sizeof (out_band->qa_desc), "%s",
+        in_band->qa_desc);
+    if (count < 0 || count >= sizeof (out_band->qa_desc))
+    {
+        sprintf (errmsg, "Overflow of out_band->qa_desc");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->app_version,
+        sizeof (out_band->app_version), "%s",
+        in_band->app_version);
+    if (count < 0 || count >= sizeof (out_band->app_version))
+    {
+        sprintf (errmsg, "Overflow of out_band->app_version");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    count = snprintf (out_band->production_date,
+        sizeof (out_band->production_date), "%s",
+        in_band->production_date);
+    if (count < 0 || count >= sizeof (out_band->production_date))
+    {
+        sprintf (errmsg, "Overflow of "
+            "out_band->production_date string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  subset_metadata_by_product
 
@@ -35,6 +306,9 @@ SUCCESS         Successfully subset the metadata structure
 NOTES:
   1. If no bands match the product type, then the global and projection
      information will still be copied.
+  2. The bands of each product type are found through the band index (see
+     find_next_band_metadata), so the subset takes time linear in the number
+     of bands rather than comparing every product type with every band.
 ******************************************************************************/
 int subset_metadata_by_product
 (
@@ -50,10 +324,10 @@ int subset_metadata_by_product
 {
     char FUNC_NAME[] = "subset_metadata_by_product";   /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int i, j, k;             /* looping variables */
+    int i, j;                /* looping variables */
     int iband;               /* current output band */
     int count;               /* number of chars copied in snprintf */
-    bool found;              /* was the product found */
+    bool *selected = NULL;   /* is each input band in the subset? */
 
     /* Initialize the output metadata structure */
     init_metadata_struct (outmeta);
@@ -174,6 +448,16 @@ int subset_metadata_by_product
         return (ERROR);
     }
 
+    count = snprintf (outmeta->global.valid_mask,
+        sizeof (outmeta->global.valid_mask), "%s",
+        inmeta->global.valid_mask);
+    if (count < 0 || count >= sizeof (outmeta->global.valid_mask))
+    {
+        sprintf (errmsg, "Overflow of outmeta->global.valid_mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     outmeta->global.ul_corner[0] = inmeta->global.ul_corner[0];
     outmeta->global.ul_corner[1] = inmeta->global.ul_corner[1];
     outmeta->global.lr_corner[0] = inmeta->global.lr_corner[0];
@@ -243,256 +527,60 @@ int subset_metadata_by_product
 
     /* Copy the bands metadata, for those bands specified to be subset into
        the new metadata structure */
+    selected = calloc (inmeta->nbands, sizeof (bool));
+    if (selected == NULL)
+    {
+        sprintf (errmsg, "Allocating the list of selected bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Select the bands of each product type, walking the bands of the
+       product in the band index, so the product types aren't compared with
+       every band */
+    for (j = 0; j < nproducts; j++)
+    {
+        for (i = find_band_metadata (inmeta, products[j], NULL, NULL);
+             i >= 0;
+             i = find_next_band_metadata (inmeta, i, products[j], NULL, NULL))
+            selected[i] = true;
+    }
+
+    /* Add the selected bands to the new metadata structure, in the order of
+       the input bands */
     iband = 0;
     for (i = 0; i < inmeta->nbands; i++)
     {
-        /* Is this band one of those specified for the product subset? */
-        found = false;
-        for (j = 0; j < nproducts; j++)
-        {
-            if (!strcmp (inmeta->band[i].product, products[j]))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
+        if (!selected[i])
             continue;
 
-        /* Add this band to the new metadata structure */
-        count = snprintf (outmeta->band[iband].product,
-            sizeof (outmeta->band[iband].product), "%s",
-            inmeta->band[i].product);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].product))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].product string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].source,
-            sizeof (outmeta->band[iband].source), "%s", inmeta->band[i].source);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].source))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].source string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].name,
-            sizeof (outmeta->band[iband].name), "%s", inmeta->band[i].name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].name))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].name string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].category,
-            sizeof (outmeta->band[iband].category), "%s",
-            inmeta->band[i].category);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].category))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].category "
-                "string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        outmeta->band[iband].data_type = inmeta->band[i].data_type;
-        outmeta->band[iband].nlines = inmeta->band[i].nlines;
-        outmeta->band[iband].nsamps = inmeta->band[i].nsamps;
-        outmeta->band[iband].fill_value = inmeta->band[i].fill_value;
-        outmeta->band[iband].saturate_value = inmeta->band[i].saturate_value;
-        outmeta->band[iband].scale_factor = inmeta->band[i].scale_factor;
-        outmeta->band[iband].add_offset = inmeta->band[i].add_offset;
-        outmeta->band[iband].resample_method = inmeta->band[i].resample_method;
-        count = snprintf (outmeta->band[iband].short_name,
-            sizeof (outmeta->band[iband].short_name), "%s",
-            inmeta->band[i].short_name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].short_name))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].short_name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].long_name,
-            sizeof (outmeta->band[iband].long_name), "%s",
-            inmeta->band[i].long_name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].long_name))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].long_name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].file_name,
-            sizeof (outmeta->band[iband].file_name), "%s",
-            inmeta->band[i].file_name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].file_name))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].file_name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        outmeta->band[iband].pixel_size[0] = inmeta->band[i].pixel_size[0];
-        outmeta->band[iband].pixel_size[1] = inmeta->band[i].pixel_size[1];
-        count = snprintf (outmeta->band[iband].pixel_units,
-            sizeof (outmeta->band[iband].pixel_units), "%s",
-            inmeta->band[i].pixel_units);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].pixel_units))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].pixel_units");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].data_units,
-            sizeof (outmeta->band[iband].data_units), "%s",
-            inmeta->band[i].data_units);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].data_units))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].data_units");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        outmeta->band[iband].valid_range[0] = inmeta->band[i].valid_range[0];
-        outmeta->band[iband].valid_range[1] = inmeta->band[i].valid_range[1];
-        outmeta->band[iband].valid_range[0] = inmeta->band[i].valid_range[0];
-        outmeta->band[iband].valid_range[1] = inmeta->band[i].valid_range[1];
-        outmeta->band[iband].rad_gain = inmeta->band[i].rad_gain;
-        outmeta->band[iband].rad_bias = inmeta->band[i].rad_bias;
-        outmeta->band[iband].refl_gain = inmeta->band[i].refl_gain;
-        outmeta->band[iband].refl_bias = inmeta->band[i].refl_bias;
-        outmeta->band[iband].k1_const = inmeta->band[i].k1_const;
-        outmeta->band[iband].k2_const = inmeta->band[i].k2_const;
-
-        /* If there is a bitmap description, then allocate memory and copy
-           the information */
-        outmeta->band[iband].nbits = inmeta->band[i].nbits;
-        if (inmeta->band[i].nbits != 0)
-        {
-            if (allocate_bitmap_metadata (&outmeta->band[iband],
-                outmeta->band[iband].nbits) != SUCCESS)
-            {  /* Error messages already printed */
-                return (ERROR);
-            }
-
-            for (k = 0; k < inmeta->band[i].nbits; k++)
-            {
-                count = snprintf (outmeta->band[iband].bitmap_description[k],
-                    STR_SIZE, "%s", inmeta->band[i].bitmap_description[k]);
-                if (count < 0 || count >= STR_SIZE)
-                {
-                    sprintf (errmsg, "Overflow of "
-                        "outmeta->band[iband].bitmap_description[k] string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-        }
-
-        /* If there are class descriptions, then allocate memory and copy
-           the information */
-        outmeta->band[iband].nclass = inmeta->band[i].nclass;
-        if (inmeta->band[i].nclass != 0)
-        {
-            if (allocate_class_metadata (&outmeta->band[iband],
-                outmeta->band[iband].nclass) != SUCCESS)
-            {  /* Error messages already printed */
-                return (ERROR);
-            }
-
-            for (k = 0; k < inmeta->band[i].nclass; k++)
-            {
-                 outmeta->band[iband].class_values[k].class =
-                     inmeta->band[i].class_values[k].class;
-                 count = snprintf (
-                     outmeta->band[iband].class_values[k].description,
-                     sizeof (outmeta->band[iband].class_values[k].description),
-                     "%s", inmeta->band[i].class_values[k].description);
-                 if (count < 0 || count >= sizeof
-                      (outmeta->band[iband].class_values[k].description))
-                 {
-                     sprintf (errmsg, "Overflow of "
-                         "outmeta->band[iband].class_values[k].description");
-                     error_handler (true, FUNC_NAME, errmsg);
-                     return (ERROR);
-                 }
-            }
-        }
-
-        /* If there are cover type descriptions, then allocate memory and
-           copy the information */
-        outmeta->band[iband].ncover = inmeta->band[i].ncover;
-        if (inmeta->band[i].ncover != 0)
-        {
-            if (allocate_percent_coverage_metadata (&outmeta->band[iband],
-                outmeta->band[iband].ncover) != SUCCESS)
-            {  /* Error messages already printed */
-                return (ERROR);
-            }
-
-            for (k = 0; k < inmeta->band[i].ncover; k++)
-            {
-                 outmeta->band[iband].percent_cover[k].percent =
-                     inmeta->band[i].percent_cover[k].percent;
-                 count = snprintf (
-                     outmeta->band[iband].percent_cover[k].description,
-                     sizeof (outmeta->band[iband].percent_cover[k].description),
-                     "%s", inmeta->band[i].percent_cover[k].description);
-                 if (count < 0 || count >= sizeof
-                      (outmeta->band[iband].percent_cover[k].description))
-                 {
-                     sprintf (errmsg, "Overflow of "
-                         "outmeta->band[iband].percent_cover[k].description");
-                     error_handler (true, FUNC_NAME, errmsg);
-                     return (ERROR);
-                 }
-            }
-        }
-
-        count = snprintf (outmeta->band[iband].qa_desc,
-            sizeof (outmeta->band[iband].qa_desc), "%s",
-            inmeta->band[i].qa_desc);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].qa_desc))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].qa_desc");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].app_version,
-            sizeof (outmeta->band[iband].app_version), "%s",
-            inmeta->band[i].app_version);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].app_version))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].app_version");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-
-        count = snprintf (outmeta->band[iband].production_date,
-            sizeof (outmeta->band[iband].production_date), "%s",
-            inmeta->band[i].production_date);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].production_date))
+        if (copy_subset_band (&outmeta->band[iband], &inmeta->band[i])
+            != SUCCESS)
         {
-            sprintf(errmsg, "Overflow of outmeta->band[iband].production_date");
+            sprintf (errmsg, "Copying the metadata of band %s",
+                inmeta->band[i].name);
             error_handler (true, FUNC_NAME, errmsg);
+            free (selected);
             return (ERROR);
         }
 
         /* Increment the band count */
         iband++;
     }
+    free (selected);
 
     /* Subtract the number of skipped bands from the subset metadata band
        count */
     outmeta->nbands = iband;
 
+    /* Index the subset bands for the band lookups */
+    if (build_band_index (outmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the subset bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* If no bands matched the product type, then print a warning */
     if (iband == 0)
     {
@@ -536,12 +624,11 @@ int subset_metadata_by_band
 {
     char FUNC_NAME[] = "subset_metadata_by_band";   /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int i, j, k;             /* looping variables */
+    int i, j;                /* looping variables */
     int count;               /* number of chars copied in snprintf */
     int iband;               /* current output band */
     int nskip;               /* number of bands skipped as they weren't found
                                 in the input metadata structure */
-    bool found;              /* was the band found */
 
     /* Initialize the output metadata structure */
     init_metadata_struct (outmeta);
@@ -659,6 +746,16 @@ int subset_metadata_by_band
         return (ERROR);
     }
 
+    count = snprintf (outmeta->global.valid_mask,
+        sizeof (outmeta->global.valid_mask), "%s",
+        inmeta->global.valid_mask);
+    if (count < 0 || count >= sizeof (outmeta->global.valid_mask))
+    {
+        sprintf (errmsg, "Overflow of outmeta->global.valid_mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     outmeta->global.ul_corner[0] = inmeta->global.ul_corner[0];
     outmeta->global.ul_corner[1] = inmeta->global.ul_corner[1];
     outmeta->global.lr_corner[0] = inmeta->global.lr_corner[0];
@@ -730,16 +827,8 @@ int subset_metadata_by_band
     for (i = 0; i < nbands; i++)
     {
         /* Is this band one of those specified for the band subset? */
-        found = false;
-        for (j = 0; j < inmeta->nbands; j++)
-        {
-            if (!strcmp (inmeta->band[j].name, bands[i]))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
+        j = find_band_metadata (inmeta, NULL, bands[i], NULL);
+        if (j < 0)
         {
             sprintf (errmsg, "Band '%s' not found in the XML structure. "
                 "Skipping.", bands[i]);
@@ -753,239 +842,408 @@ int subset_metadata_by_band
         iband = i - nskip;
 
         /* Add this band to the new metadata structure */
-        count = snprintf (outmeta->band[iband].product,
-            sizeof (outmeta->band[iband].product), "%s",
-            inmeta->band[j].product);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].product))
+        if (copy_subset_band (&outmeta->band[iband], &inmeta->band[j])
+            != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].product string");
+            sprintf (errmsg, "Copying the metadata of band %s", bands[i]);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }
 
-        count = snprintf (outmeta->band[iband].source,
-            sizeof (outmeta->band[iband].source), "%s", inmeta->band[j].source);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].source))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].source string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Subtract the number of skipped bands from the subset metadata band
+       count */
+    outmeta->nbands -= nskip;
 
-        count = snprintf (outmeta->band[iband].name,
-            sizeof (outmeta->band[iband].name), "%s",
-            inmeta->band[j].name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].name))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].name string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Index the subset bands for the band lookups */
+    if (build_band_index (outmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Indexing the subset bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        count = snprintf (outmeta->band[iband].category,
-            sizeof (outmeta->band[iband].category), "%s",
-            inmeta->band[j].category);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].category))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].category "
-                "string");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Successful subset */
+    return (SUCCESS);
+}
 
-        outmeta->band[iband].data_type = inmeta->band[j].data_type;
-        outmeta->band[iband].nlines = inmeta->band[j].nlines;
-        outmeta->band[iband].nsamps = inmeta->band[j].nsamps;
-        outmeta->band[iband].fill_value = inmeta->band[j].fill_value;
-        outmeta->band[iband].saturate_value = inmeta->band[j].saturate_value;
-        outmeta->band[iband].scale_factor = inmeta->band[j].scale_factor;
-        outmeta->band[iband].add_offset = inmeta->band[j].add_offset;
-        outmeta->band[iband].resample_method = inmeta->band[j].resample_method;
-        count = snprintf (outmeta->band[iband].short_name,
-            sizeof (outmeta->band[iband].short_name), "%s",
-            inmeta->band[j].short_name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].short_name))
-        {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].short_name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        count = snprintf (outmeta->band[iband].long_name,
-            sizeof (outmeta->band[iband].long_name), "%s",
-            inmeta->band[j].long_name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].long_name))
+/******************************************************************************
+MODULE:  get_file_dir
+
+PURPOSE: Determines the directory portion of a filename, to be used as the
+prefix for the band filenames which are relative to the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error determining the directory
+SUCCESS         Successfully determined the directory
+
+NOTES:
+  1. If the filename doesn't contain a directory then the current directory
+     (".") is returned.
+******************************************************************************/
+static int get_file_dir
+(
+    char *filename,      /* I: filename to get the directory of */
+    char *dir            /* O: directory of the filename (STR_SIZE) */
+)
+{
+    char FUNC_NAME[] = "get_file_dir";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *cptr = NULL;       /* pointer to the last / in the filename */
+    int count;               /* number of chars copied in snprintf */
+
+    count = snprintf (dir, STR_SIZE, "%s", filename);
+    if (count < 0 || count >= STR_SIZE)
+    {
+        sprintf (errmsg, "Overflow of dir string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    cptr = strrchr (dir, '/');
+    if (cptr == NULL)
+        strcpy (dir, ".");
+    else if (cptr == dir)
+        dir[1] = '\0';
+    else
+        *cptr = '\0';
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  copy_file_data
+
+PURPOSE: Copies the contents of the source file to the destination file, as a
+reflink if requested and supported, in the kernel via copy_file_range if
+supported, or otherwise through a user-space buffer.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error copying the file
+SUCCESS         Successfully copied the file
+
+NOTES:
+  1. The destination file is created or truncated with the permissions of the
+     source file.
+******************************************************************************/
+static int copy_file_data
+(
+    char *src_file,      /* I: source file to be copied */
+    char *dst_file,      /* I: destination file to be created */
+    bool reflink         /* I: should a reflink be attempted first? */
+)
+{
+    char FUNC_NAME[] = "copy_file_data";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *buf = NULL;        /* buffer for copying through user space */
+    int in_fd;               /* file descriptor of the source file */
+    int out_fd;              /* file descriptor of the destination file */
+    ssize_t nread;           /* number of bytes read into the buffer */
+    ssize_t nwritten;        /* number of bytes written from the buffer */
+    ssize_t ncopied;         /* number of bytes copied by copy_file_range */
+    off_t remaining;         /* number of bytes remaining to be copied */
+    struct stat src_stat;    /* status of the source file */
+
+    /* Open the source and destination files */
+    in_fd = open (src_file, O_RDONLY);
+    if (in_fd == -1 || fstat (in_fd, &src_stat) == -1)
+    {
+        sprintf (errmsg, "Opening the source file: %s", src_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    out_fd = open (dst_file, O_WRONLY | O_CREAT | O_TRUNC,
+        src_stat.st_mode & 0777);
+    if (out_fd == -1)
+    {
+        sprintf (errmsg, "Creating the destination file: %s", dst_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close (in_fd);
+        return (ERROR);
+    }
+
+    /* Clone the file if reflinks are supported, which shares the extents
+       of the source file instead of copying them */
+#ifdef FICLONE
+    if (reflink && ioctl (out_fd, FICLONE, in_fd) == 0)
+    {
+        close (in_fd);
+        close (out_fd);
+        return (SUCCESS);
+    }
+#endif
+
+    /* Copy the data in the kernel.  copy_file_range advances the file
+       offsets, so if it isn't supported (different file systems or older
+       kernels) the remaining data is copied through user space from the
+       current offsets. */
+    remaining = src_stat.st_size;
+    while (remaining > 0)
+    {
+        ncopied = copy_file_range (in_fd, NULL, out_fd, NULL, remaining, 0);
+        if (ncopied <= 0)
+            break;
+        remaining -= ncopied;
+    }
+
+    if (remaining > 0)
+    {
+        buf = malloc (SUBSET_COPY_BUFSIZE);
+        if (buf == NULL)
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].long_name");
+            sprintf (errmsg, "Allocating memory for the copy buffer");
             error_handler (true, FUNC_NAME, errmsg);
+            close (in_fd);
+            close (out_fd);
             return (ERROR);
         }
 
-        count = snprintf (outmeta->band[iband].file_name,
-            sizeof (outmeta->band[iband].file_name), "%s",
-            inmeta->band[j].file_name);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].file_name))
+        while ((nread = read (in_fd, buf, SUBSET_COPY_BUFSIZE)) > 0)
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].file_name");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            nwritten = write (out_fd, buf, nread);
+            if (nwritten != nread)
+            {
+                nread = -1;
+                break;
+            }
         }
+        free (buf);
 
-        outmeta->band[iband].pixel_size[0] = inmeta->band[j].pixel_size[0];
-        outmeta->band[iband].pixel_size[1] = inmeta->band[j].pixel_size[1];
-        count = snprintf (outmeta->band[iband].pixel_units,
-            sizeof (outmeta->band[iband].pixel_units), "%s",
-            inmeta->band[j].pixel_units);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].pixel_units))
+        if (nread < 0)
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].pixel_units");
+            sprintf (errmsg, "Copying %s to %s", src_file, dst_file);
             error_handler (true, FUNC_NAME, errmsg);
+            close (in_fd);
+            close (out_fd);
             return (ERROR);
         }
+    }
+
+    close (in_fd);
+    if (close (out_fd) != 0)
+    {
+        sprintf (errmsg, "Closing the destination file: %s", dst_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  materialize_file
+
+PURPOSE: Materializes a single band file at the destination as a hard link,
+reflink, or copy of the source file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error materializing the file
+SUCCESS         Successfully materialized the file
+
+NOTES:
+  1. If the destination already is the source file (i.e. the subset XML file
+     is written to the same directory as the input XML file), then nothing
+     is done.  Any other existing destination file is replaced.
+******************************************************************************/
+static int materialize_file
+(
+    char *src_file,      /* I: source band file */
+    char *dst_file,      /* I: destination band file */
+    Subset_files_t files /* I: how the band file should be materialized */
+)
+{
+    char FUNC_NAME[] = "materialize_file";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    struct stat src_stat;    /* status of the source file */
+    struct stat dst_stat;    /* status of the destination file */
 
-        count = snprintf (outmeta->band[iband].data_units,
-            sizeof (outmeta->band[iband].data_units), "%s",
-            inmeta->band[j].data_units);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].data_units))
+    if (stat (src_file, &src_stat) == -1)
+    {
+        sprintf (errmsg, "Band file referenced in the XML file does not "
+            "exist: %s", src_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (stat (dst_file, &dst_stat) == 0)
+    {
+        /* Nothing to do if the destination is the source file */
+        if (src_stat.st_dev == dst_stat.st_dev &&
+            src_stat.st_ino == dst_stat.st_ino)
+            return (SUCCESS);
+
+        if (unlink (dst_file) != 0)
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].data_units");
+            sprintf (errmsg, "Removing the existing file: %s", dst_file);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
+    }
 
-        outmeta->band[iband].valid_range[0] = inmeta->band[j].valid_range[0];
-        outmeta->band[iband].valid_range[1] = inmeta->band[j].valid_range[1];
-        outmeta->band[iband].valid_range[0] = inmeta->band[j].valid_range[0];
-        outmeta->band[iband].valid_range[1] = inmeta->band[j].valid_range[1];
-        outmeta->band[iband].rad_gain = inmeta->band[j].rad_gain;
-        outmeta->band[iband].rad_bias = inmeta->band[j].rad_bias;
-        outmeta->band[iband].refl_gain = inmeta->band[j].refl_gain;
-        outmeta->band[iband].refl_bias = inmeta->band[j].refl_bias;
-        outmeta->band[iband].k1_const = inmeta->band[j].k1_const;
-        outmeta->band[iband].k2_const = inmeta->band[j].k2_const;
-
-        /* If there is a bitmap description, then allocate memory and copy
-           the information */
-        outmeta->band[iband].nbits = inmeta->band[j].nbits;
-        if (inmeta->band[j].nbits != 0)
-        {
-            if (allocate_bitmap_metadata (&outmeta->band[iband],
-                outmeta->band[iband].nbits) != SUCCESS)
-            {  /* Error messages already printed */
+    switch (files)
+    {
+        case SUBSET_FILES_HARDLINK:
+            if (link (src_file, dst_file) != 0)
+            {
+                sprintf (errmsg, "Hard linking %s to %s.  Hard links "
+                    "require both files to be on the same file system.",
+                    dst_file, src_file);
+                error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
+            break;
 
-            for (k = 0; k < inmeta->band[j].nbits; k++)
+        case SUBSET_FILES_REFLINK:
+        case SUBSET_FILES_COPY:
+            if (copy_file_data (src_file, dst_file,
+                files == SUBSET_FILES_REFLINK) != SUCCESS)
             {
-                count = snprintf (outmeta->band[iband].bitmap_description[k],
-                    STR_SIZE, "%s", inmeta->band[j].bitmap_description[k]);
-                if (count < 0 || count >= STR_SIZE)
-                {
-                    sprintf (errmsg, "Overflow of "
-                        "outmeta->band[iband].bitmap_description[k] string");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-        }
-
-        /* If there are class descriptions, then allocate memory and copy
-           the information */
-        outmeta->band[iband].nclass = inmeta->band[j].nclass;
-        if (inmeta->band[j].nclass != 0)
-        {
-            if (allocate_class_metadata (&outmeta->band[iband],
-                outmeta->band[iband].nclass) != SUCCESS)
-            {  /* Error messages already printed */
+                sprintf (errmsg, "Copying %s to %s", src_file, dst_file);
+                error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
+            break;
 
-            for (k = 0; k < inmeta->band[j].nclass; k++)
-            {
-                outmeta->band[iband].class_values[k].class =
-                    inmeta->band[j].class_values[k].class;
-                count = snprintf (
-                    outmeta->band[iband].class_values[k].description,
-                    sizeof (outmeta->band[iband].class_values[k].description),
-                    "%s", inmeta->band[j].class_values[k].description);
-                if (count < 0 || count >=
-                    sizeof (outmeta->band[iband].class_values[k].description))
-                {
-                    sprintf (errmsg, "Overflow of "
-                        "outmeta->band[iband].class_values[k].description");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }
-        }
+        default:
+            break;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  materialize_subset_files
 
-        /* If there are cover type descriptions, then allocate memory and
-           copy the information */
-        outmeta->band[iband].ncover = inmeta->band[j].ncover;
-        if (inmeta->band[j].ncover != 0)
+PURPOSE: Materializes the band files referenced by the subset XML file in the
+directory of the subset XML file, as hard links, reflinks, or copies of the
+band files of the input XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error materializing the band files
+SUCCESS         Successfully materialized the band files
+
+NOTES:
+  1. The band filenames are relative to the directory of the XML file, so the
+     same filenames are used in the subset directory and the subset XML file
+     remains valid.  Absolute band filenames already point to the input band
+     files, so they are not materialized.
+  2. The ENVI header (.hdr) for each band file is also materialized if it
+     exists.
+  3. Band files shared by multiple bands are only materialized once.  The
+     file names are compared through the compact copies of the bands (see
+     get_band_hot), where equal names have the same offset, so finding the
+     shared files doesn't touch the full metadata of the earlier bands.
+******************************************************************************/
+int materialize_subset_files
+(
+    char *in_xml_file,   /* I: input XML file which was subset */
+    char *out_xml_file,  /* I: output subset XML file */
+    Espa_internal_meta_t *subset_meta, /* I: subset metadata structure */
+    Subset_files_t files /* I: how the band files should be materialized */
+)
+{
+    char FUNC_NAME[] = "materialize_subset_files";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char src_dir[STR_SIZE];  /* directory of the input XML file */
+    char dst_dir[STR_SIZE];  /* directory of the subset XML file */
+    char src_file[STR_SIZE]; /* source band or header file */
+    char dst_file[STR_SIZE]; /* destination band or header file */
+    char *cptr = NULL;       /* pointer to the file extension */
+    char *band_file = NULL;  /* band filename from the XML file */
+    int i, j;                /* looping variables for the bands */
+    int count;               /* number of chars copied in snprintf */
+    const Espa_band_hot_t *hot = NULL;  /* compact copies of the bands */
+
+    if (files == SUBSET_FILES_NONE)
+        return (SUCCESS);
+
+    if (get_file_dir (in_xml_file, src_dir) != SUCCESS ||
+        get_file_dir (out_xml_file, dst_dir) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the directories of the XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    hot = get_band_hot (subset_meta, 0);
+    for (i = 0; i < subset_meta->nbands; i++)
+    {
+        band_file = subset_meta->band[i].file_name;
+        if (band_file[0] == '/')
+            continue;
+
+        /* Skip band files which were already materialized */
+        for (j = 0; j < i; j++)
         {
-            if (allocate_percent_coverage_metadata (&outmeta->band[iband],
-                outmeta->band[iband].ncover) != SUCCESS)
-            {  /* Error messages already printed */
-                return (ERROR);
-            }
+            if (hot != NULL ? hot[j].file_name == hot[i].file_name :
+                !strcmp (band_file, subset_meta->band[j].file_name))
+                break;
+        }
+        if (j < i)
+            continue;
 
-            for (k = 0; k < inmeta->band[j].ncover; k++)
-            {
-                 outmeta->band[iband].percent_cover[k].percent =
-                     inmeta->band[j].percent_cover[k].percent;
-                 count = snprintf (
-                     outmeta->band[iband].percent_cover[k].description,
-                     sizeof (outmeta->band[iband].percent_cover[k].description),
-                     "%s", inmeta->band[j].percent_cover[k].description);
-                 if (count < 0 || count >= sizeof
-                      (outmeta->band[iband].percent_cover[k].description))
-                 {
-                     sprintf (errmsg, "Overflow of "
-                         "outmeta->band[iband].percent_cover[k].description");
-                     error_handler (true, FUNC_NAME, errmsg);
-                     return (ERROR);
-                 }
-            }
+        /* Materialize the band file */
+        count = snprintf (src_file, sizeof (src_file), "%s/%s", src_dir,
+            band_file);
+        if (count < 0 || count >= sizeof (src_file))
+        {
+            sprintf (errmsg, "Overflow of src_file string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
 
-        count = snprintf (outmeta->band[iband].qa_desc,
-            sizeof (outmeta->band[iband].qa_desc), "%s",
-            inmeta->band[j].qa_desc);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].qa_desc))
+        count = snprintf (dst_file, sizeof (dst_file), "%s/%s", dst_dir,
+            band_file);
+        if (count < 0 || count >= sizeof (dst_file))
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].qa_desc");
+            sprintf (errmsg, "Overflow of dst_file string");
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        count = snprintf (outmeta->band[iband].app_version,
-            sizeof (outmeta->band[iband].app_version), "%s",
-            inmeta->band[j].app_version);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].app_version))
+        if (materialize_file (src_file, dst_file, files) != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of outmeta->band[iband].app_version");
+            sprintf (errmsg, "Materializing the band file: %s", band_file);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        count = snprintf (outmeta->band[iband].production_date,
-            sizeof (outmeta->band[iband].production_date), "%s",
-            inmeta->band[j].production_date);
-        if (count < 0 || count >= sizeof (outmeta->band[iband].production_date))
+        /* Materialize the ENVI header for the band file, if it exists */
+        cptr = strrchr (src_file, '.');
+        if (cptr == NULL || strchr (cptr, '/') != NULL)
+            continue;
+        strcpy (cptr, ".hdr");
+        if (access (src_file, F_OK) != 0)
+            continue;
+
+        cptr = strrchr (dst_file, '.');
+        strcpy (cptr, ".hdr");
+        if (materialize_file (src_file, dst_file, files) != SUCCESS)
         {
-            sprintf (errmsg, "Overflow of "
-                "outmeta->band[iband].production_date string");
+            sprintf (errmsg, "Materializing the ENVI header file: %s",
+                src_file);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
     }
 
-    /* Subtract the number of skipped bands from the subset metadata band
-       count */
-    outmeta->nbands -= nskip;
-
-    /* Successful subset */
     return (SUCCESS);
 }
 
@@ -1005,6 +1263,8 @@ SUCCESS         Successfully subset the XML file
 NOTES:
   1. If no bands match the product type, then the global and projection
      information will still be copied.
+  2. If requested, the band files referenced by the subset XML file are also
+     materialized next to it.  See materialize_subset_files.
 ******************************************************************************/
 int subset_xml_by_product
 (
@@ -1012,8 +1272,10 @@ int subset_xml_by_product
     char *out_xml_file,  /* I: output XML file to be subset */
     int nproducts,       /* I: number of product types to be included in the
                                subset product */
-    char products[][STR_SIZE]  /* I: array of nproducts product types to be used
-                               for subsetting */
+    char products[][STR_SIZE], /* I: array of nproducts product types to be
+                               used for subsetting */
+    Subset_files_t files /* I: how the band files referenced by the subset
+                               XML file should be materialized */
 )
 {
     char FUNC_NAME[] = "subset_xml_by_product";   /* function name */
@@ -1061,6 +1323,16 @@ int subset_xml_by_product
         return (ERROR);
     }
 
+    /* Materialize the band files for the subset XML file */
+    if (materialize_subset_files (in_xml_file, out_xml_file,
+        &out_xml_metadata, files) != SUCCESS)
+    {
+        sprintf (errmsg, "Materializing the band files for the subset XML "
+            "file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Free the metadata structures */
     free_metadata (&in_xml_metadata);
     free_metadata (&out_xml_metadata);
@@ -1085,6 +1357,8 @@ SUCCESS         Successfully subset the XML file
 NOTES:
   1. If nbands is 0, then the global and projection information will still
      be copied.
+  2. If requested, the band files referenced by the subset XML file are also
+     materialized next to it.  See materialize_subset_files.
 ******************************************************************************/
 int subset_xml_by_band
 (
@@ -1092,8 +1366,10 @@ int subset_xml_by_band
     char *out_xml_file,  /* I: output XML file to be subset */
     int nbands,          /* I: number of bands to be included in the subset
                                XML file */
-    char bands[][STR_SIZE] /* I: array of nbands band names to be appear in
+    char bands[][STR_SIZE], /* I: array of nbands band names to be appear in
                                the subset XML file */
+    Subset_files_t files /* I: how the band files referenced by the subset
+                               XML file should be materialized */
 )
 {
     char FUNC_NAME[] = "subset_xml_by_band";   /* function name */
@@ -1141,6 +1417,16 @@ int subset_xml_by_band
         return (ERROR);
     }
 
+    /* Materialize the band files for the subset XML file */
+    if (materialize_subset_files (in_xml_file, out_xml_file,
+        &out_xml_metadata, files) != SUCCESS)
+    {
+        sprintf (errmsg, "Materializing the band files for the subset XML "
+            "file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Free the metadata structures */
     free_metadata (&in_xml_metadata);
     free_metadata (&out_xml_metadata);
@@ -23,6 +23,23 @@ NOTES:
 #include "write_metadata.h"
 
 /* Defines */
+/* size of the buffer used when the band files have to be copied through
+   user space */
+#define SUBSET_COPY_BUFSIZE (1024*1024)
+
+/* Type definitions */
+/* How the band files referenced by the subset XML file are materialized in
+   the directory of the subset XML file */
+typedef enum
+{
+    SUBSET_FILES_NONE,      /* only the subset XML file is written (default) */
+    SUBSET_FILES_HARDLINK,  /* hard links to the input band files */
+    SUBSET_FILES_REFLINK,   /* reflinks (FICLONE) of the input band files,
+                               copied if the file system doesn't support
+                               reflinks */
+    SUBSET_FILES_COPY       /* copies of the input band files, made in the
+                               kernel via copy_file_range where possible */
+} Subset_files_t;
 
 /* Prototypes */
 int subset_metadata_by_product
@@ -49,14 +66,24 @@ int subset_metadata_by_band
                                          for subsetting */
 );
 
+int materialize_subset_files
+(
+    char *in_xml_file,   /* I: input XML file which was subset */
+    char *out_xml_file,  /* I: output subset XML file */
+    Espa_internal_meta_t *subset_meta, /* I: subset metadata structure */
+    Subset_files_t files /* I: how the band files should be materialized */
+);
+
 int subset_xml_by_product
 (
     char *in_xml_file,   /* I: input XML file to be subset */
     char *out_xml_file,  /* I: output XML file to be subset */
     int nproducts,       /* I: number of product types to be included in the
                                subset product */
-    char products[][STR_SIZE] /* I: array of nproducts product types to be used
-                               for subsetting */
+    char products[][STR_SIZE], /* I: array of nproducts product types to be
+                               used for subsetting */
+    Subset_files_t files /* I: how the band files referenced by the subset
+                               XML file should be materialized */
 );
 
 int subset_xml_by_band
@@ -65,8 +92,10 @@ int subset_xml_by_band
     char *out_xml_file,  /* I: output XML file to be subset */
     int nbands,          /* I: number of bands to be included in the subset
                                XML file */
-    char bands[][STR_SIZE] /* I: array of nbands band names to be appear in
+    char bands[][STR_SIZE], /* I: array of nbands band names to be appear in
                                the subset XML file */
+    Subset_files_t files /* I: how the band files referenced by the subset
+                               XML file should be materialized */
 );
 
 #endif
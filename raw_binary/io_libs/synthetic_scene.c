@@ -0,0 +1,936 @@
+/*****************************************************************************
+FILE: synthetic_scene.c
+
+PURPOSE: Contains functions for writing synthetic ESPA products: the XML
+metadata and a raw binary band for each of the image bands and the optional
+quality band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The bands are generated and written SYNTHETIC_LINE_BLOCK lines at a
+     time, so bands of up to SYNTHETIC_MAX_SIZE x SYNTHETIC_MAX_SIZE pixels
+     don't need to be held in memory.
+  2. The pseudo-random values are a hash of the seed, band, line, and
+     sample, so any block of a band can be generated on its own and the
+     quality band can tell which pixels of the image bands are fill.
+*****************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "raw_binary_io.h"
+#include "envi_header.h"
+#include "write_metadata.h"
+#include "synthetic_scene.h"
+
+/* Footprint of the scene; the pixels outside the rotated rectangle are fill.
+   u runs across the footprint (between its left and right edges) and v
+   along it. */
+typedef struct
+{
+    double cos_angle;       /* cosine of the footprint rotation */
+    double sin_angle;       /* sine of the footprint rotation */
+    double center_x;        /* sample coordinate of the footprint center */
+    double center_y;        /* line coordinate of the footprint center */
+    double half_u;          /* half the width of the footprint (pixels) */
+    double half_v;          /* half the length of the footprint (pixels) */
+} Synthetic_footprint_t;
+
+
+/******************************************************************************
+MODULE:  hash_pixel
+
+PURPOSE: Hashes the seed, band, line, and sample of a pixel into a
+pseudo-random number.
+
+RETURN VALUE:
+Type = uint64_t
+Value           Description
+-----           -----------
+hash            Pseudo-random 64-bit number
+
+NOTES:
+  1. This is the splitmix64 finalizer applied to the packed coordinates.
+******************************************************************************/
+static inline uint64_t hash_pixel
+(
+    unsigned int seed,      /* I: seed of the product */
+    int band,               /* I: band index */
+    int line,               /* I: line of the pixel */
+    int samp                /* I: sample of the pixel */
+)
+{
+    uint64_t x;             /* hashed value */
+
+    x = ((uint64_t) seed << 32) ^ ((uint64_t) (band + 1) << 56) ^
+        ((uint64_t) line << 24) ^ (uint64_t) samp;
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return (x ^ (x >> 31));
+}
+
+
+/******************************************************************************
+MODULE:  hash_fraction
+
+PURPOSE: Converts a hash to a fraction from 0 to 1.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+fraction        Fraction in [0, 1)
+
+NOTES:
+******************************************************************************/
+static inline double hash_fraction
+(
+    uint64_t hash           /* I: pseudo-random number */
+)
+{
+    return ((hash >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/******************************************************************************
+MODULE:  get_synthetic_range
+
+PURPOSE: Gets the fill value and the valid range of the synthetic bands of a
+data type.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unsupported data type
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_synthetic_range
+(
+    enum Espa_data_type data_type,  /* I: data type of the band */
+    long *fill_value,       /* O: fill value */
+    double *range_min,      /* O: lowest valid value */
+    double *range_max       /* O: highest valid value */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8:
+            *fill_value = -128; *range_min = -100.0; *range_max = 100.0;
+            break;
+        case ESPA_UINT8:
+            *fill_value = 0; *range_min = 1.0; *range_max = 255.0;
+            break;
+        case ESPA_INT16:
+            *fill_value = -9999; *range_min = -2000.0; *range_max = 16000.0;
+            break;
+        case ESPA_UINT16:
+            *fill_value = 0; *range_min = 1.0; *range_max = 65535.0;
+            break;
+        case ESPA_INT32:
+            *fill_value = -9999; *range_min = -2000.0; *range_max = 1000000.0;
+            break;
+        case ESPA_UINT32:
+            *fill_value = 0; *range_min = 1.0; *range_max = 1000000.0;
+            break;
+        case ESPA_FLOAT32:
+        case ESPA_FLOAT64:
+            *fill_value = -9999; *range_min = 0.0; *range_max = 1.0;
+            break;
+        default:
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_synthetic_scene
+
+PURPOSE: Sets a synthetic product to the defaults: seven INT16 Landsat 8
+bands of 1000 x 1000 pixels in UTM zone 13, with a footprint 12 degrees off
+north.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void init_synthetic_scene
+(
+    Synthetic_scene_t *scene    /* O: synthetic product set to the defaults */
+)
+{
+    memset (scene, 0, sizeof (Synthetic_scene_t));
+    strcpy (scene->satellite, "LANDSAT_8");
+    strcpy (scene->instrument, "OLI_TIRS");
+    strcpy (scene->product, "L1T");
+    strcpy (scene->acquisition_date, "2013-10-14");
+    scene->nbands = 7;
+    scene->band_names = NULL;
+    scene->qa_band = false;
+    scene->data_type = ESPA_INT16;
+    scene->nlines = 1000;
+    scene->nsamps = 1000;
+    scene->fill = SYNTHETIC_FILL_FOOTPRINT;
+    scene->footprint_angle = 12.0;
+    scene->misalign = 0;
+    scene->fill_fraction = 0.01;
+    scene->seed = 1;
+
+    scene->proj_info.proj_type = GCTP_UTM_PROJ;
+    scene->proj_info.datum_type = ESPA_WGS84;
+    strcpy (scene->proj_info.units, "meters");
+    scene->proj_info.ul_corner[0] = 415000.0;
+    scene->proj_info.ul_corner[1] = 4428000.0;
+    strcpy (scene->proj_info.grid_origin, "CENTER");
+    scene->proj_info.utm_zone = 13;
+    scene->pixel_size = 30.0;
+
+    scene->bounding_coords[ESPA_WEST] = -106.0;
+    scene->bounding_coords[ESPA_EAST] = -105.65;
+    scene->bounding_coords[ESPA_NORTH] = 40.0;
+    scene->bounding_coords[ESPA_SOUTH] = 39.73;
+}
+
+
+/******************************************************************************
+MODULE:  init_footprint
+
+PURPOSE: Computes the footprint of the scene, as the largest rectangle at the
+footprint angle which fits the bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The footprint doesn't fit the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The corners of the footprint touch the edges of the bands, which needs
+     an angle below 45 degrees and a small enough angle for the aspect ratio
+     of the bands.
+  2. The edge insets of each band are hashed from the seed when they're
+     needed (see get_footprint_span), so there's no limit on the number of
+     bands.
+******************************************************************************/
+static int init_footprint
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    Synthetic_footprint_t *footprint /* O: footprint of the scene */
+)
+{
+    char FUNC_NAME[] = "init_footprint";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    double angle = scene->footprint_angle * M_PI / 180.0;  /* rotation */
+    double cos_2angle;      /* cosine of twice the rotation */
+
+    footprint->cos_angle = cos (angle);
+    footprint->sin_angle = sin (angle);
+    footprint->center_x = scene->nsamps / 2.0;
+    footprint->center_y = scene->nlines / 2.0;
+
+    /* Solve for the rectangle whose bounding box is the band */
+    cos_2angle = cos (2.0 * angle);
+    if (fabs (scene->footprint_angle) >= 45.0 || cos_2angle <= 0.0)
+    {
+        sprintf (errmsg, "Footprint angle must be between -45 and 45 degrees");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    footprint->half_u = (footprint->center_x * footprint->cos_angle -
+        footprint->center_y * fabs (footprint->sin_angle)) / cos_2angle;
+    footprint->half_v = (footprint->center_y * footprint->cos_angle -
+        footprint->center_x * fabs (footprint->sin_angle)) / cos_2angle;
+    if (footprint->half_u <= scene->misalign ||
+        footprint->half_v <= 0.0)
+    {
+        sprintf (errmsg, "Footprint angle of %g degrees is too large for "
+            "bands of %d lines x %d samples", scene->footprint_angle,
+            scene->nlines, scene->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_footprint_span
+
+PURPOSE: Gets the samples of a line of a band which are inside the footprint.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. A pixel is inside if its center is.  first_samp is greater than
+     last_samp if no sample of the line is inside.
+******************************************************************************/
+static void get_footprint_span
+(
+    const Synthetic_scene_t *scene,        /* I: synthetic product */
+    const Synthetic_footprint_t *footprint,/* I: footprint of the scene */
+    int band,               /* I: band index */
+    int line,               /* I: line index */
+    int *first_samp,        /* O: first sample inside the footprint */
+    int *last_samp          /* O: last sample inside the footprint */
+)
+{
+    double dy = line + 0.5 - footprint->center_y;  /* line from the center */
+    double cos_a = footprint->cos_angle;  /* cosine of the rotation */
+    double sin_a = footprint->sin_angle;  /* sine of the rotation */
+    double u_offset;        /* u of the sample at the footprint center */
+    double v_offset;        /* v of the sample at the footprint center */
+    double x_min;           /* lowest sample coordinate inside */
+    double x_max;           /* highest sample coordinate inside */
+    double x1, x2;          /* sample coordinates of the v limits */
+    int left_inset = 0;     /* pixels the left edge of the band is moved
+                               inward */
+    int right_inset = 0;    /* pixels the right edge of the band is moved
+                               inward */
+
+    /* Move the edges of the band inward by up to misalign pixels */
+    if (scene->misalign > 0)
+    {
+        left_inset = hash_pixel (scene->seed, band, -1, 0) %
+            (scene->misalign + 1);
+        right_inset = hash_pixel (scene->seed, band, -1, 1) %
+            (scene->misalign + 1);
+    }
+
+    /* u = dx cos + dy sin must be within the band's edges */
+    u_offset = dy * sin_a;
+    x_min = (-footprint->half_u + left_inset - u_offset) / cos_a;
+    x_max = (footprint->half_u - right_inset - u_offset) / cos_a;
+
+    /* v = -dx sin + dy cos must be within the top and bottom */
+    v_offset = dy * cos_a;
+    if (sin_a != 0.0)
+    {
+        x1 = (v_offset - footprint->half_v) / sin_a;
+        x2 = (v_offset + footprint->half_v) / sin_a;
+        x_min = fmax (x_min, fmin (x1, x2));
+        x_max = fmin (x_max, fmax (x1, x2));
+    }
+    else if (fabs (v_offset) > footprint->half_v)
+        x_max = x_min - 1.0;
+
+    /* Convert to the samples whose centers are inside */
+    x_min += footprint->center_x;
+    x_max += footprint->center_x;
+    *first_samp = (int) fmax (ceil (x_min - 0.5), 0.0);
+    *last_samp = (int) fmin (floor (x_max - 0.5), scene->nsamps - 1.0);
+}
+
+
+/******************************************************************************
+MODULE:  is_random_fill
+
+PURPOSE: Determines whether a pixel of a band is fill in the random fill
+pattern.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The pixel is fill
+false           The pixel isn't fill
+
+NOTES:
+  1. A different hash than the pixel values is used, so the fill pixels
+     don't depend on the values.
+******************************************************************************/
+static inline bool is_random_fill
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    int band,               /* I: band index */
+    int line,               /* I: line index */
+    int samp                /* I: sample index */
+)
+{
+    return (hash_fraction (hash_pixel (~scene->seed, band, line, samp)) <
+        scene->fill_fraction);
+}
+
+
+/******************************************************************************
+MODULE:  store_pixel
+
+PURPOSE: Stores a pixel value in a buffer of the data type.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static inline void store_pixel
+(
+    void *buf,              /* I/O: buffer of the band's data type */
+    size_t pix,             /* I: index of the pixel in the buffer */
+    enum Espa_data_type data_type,  /* I: data type of the band */
+    double value            /* I: value of the pixel */
+)
+{
+    switch (data_type)
+    {
+        case ESPA_INT8: ((int8_t *) buf)[pix] = (int8_t) value; break;
+        case ESPA_UINT8: ((uint8_t *) buf)[pix] = (uint8_t) value; break;
+        case ESPA_INT16: ((int16_t *) buf)[pix] = (int16_t) value; break;
+        case ESPA_UINT16: ((uint16_t *) buf)[pix] = (uint16_t) value; break;
+        case ESPA_INT32: ((int32_t *) buf)[pix] = (int32_t) value; break;
+        case ESPA_UINT32: ((uint32_t *) buf)[pix] = (uint32_t) value; break;
+        case ESPA_FLOAT32: ((float *) buf)[pix] = (float) value; break;
+        case ESPA_FLOAT64: ((double *) buf)[pix] = value; break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  generate_image_block
+
+PURPOSE: Generates a block of lines of an image band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The valid values are a gradient across the band, an offset for the
+     band, and pseudo-random noise, scaled to the valid range.
+******************************************************************************/
+static void generate_image_block
+(
+    const Synthetic_scene_t *scene,        /* I: synthetic product */
+    const Synthetic_footprint_t *footprint,/* I: footprint of the scene */
+    const Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    int band,               /* I: band index */
+    int first_line,         /* I: first line of the block */
+    int nlines,             /* I: number of lines in the block */
+    void *buf               /* O: block of the band's data type */
+)
+{
+    int line;               /* line index */
+    int samp;               /* sample index */
+    int first_samp;         /* first sample inside the footprint */
+    int last_samp;          /* last sample inside the footprint */
+    size_t pix;             /* pixel index in the block */
+    double range_min = bmeta->valid_range[0];  /* lowest valid value */
+    double range = bmeta->valid_range[1] - bmeta->valid_range[0];
+                            /* width of the valid range */
+    double band_offset = 0.1 * (band % 4) / 3.0;  /* offset of the band */
+    double frac;            /* fraction of the valid range */
+    bool fill;              /* is the pixel fill? */
+
+    for (line = first_line; line < first_line + nlines; line++)
+    {
+        first_samp = 0;
+        last_samp = scene->nsamps - 1;
+        if (scene->fill == SYNTHETIC_FILL_FOOTPRINT)
+            get_footprint_span (scene, footprint, band, line, &first_samp,
+                &last_samp);
+
+        pix = (size_t) (line - first_line) * scene->nsamps;
+        for (samp = 0; samp < scene->nsamps; samp++, pix++)
+        {
+            if (scene->fill == SYNTHETIC_FILL_RANDOM)
+                fill = is_random_fill (scene, band, line, samp);
+            else
+                fill = (samp < first_samp || samp > last_samp);
+
+            if (fill)
+            {
+                store_pixel (buf, pix, bmeta->data_type, bmeta->fill_value);
+                continue;
+            }
+
+            frac = 0.3 * ((double) line / scene->nlines +
+                (double) samp / scene->nsamps) + band_offset + 0.3 *
+                hash_fraction (hash_pixel (scene->seed, band, line, samp));
+            store_pixel (buf, pix, bmeta->data_type, range_min + frac * range);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  generate_qa_block
+
+PURPOSE: Generates a block of lines of the quality band, marking the pixels
+which are fill in any image band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void generate_qa_block
+(
+    const Synthetic_scene_t *scene,        /* I: synthetic product */
+    const Synthetic_footprint_t *footprint,/* I: footprint of the scene */
+    int first_line,         /* I: first line of the block */
+    int nlines,             /* I: number of lines in the block */
+    uint16_t *buf           /* O: block of the quality band */
+)
+{
+    int line;               /* line index */
+    int samp;               /* sample index */
+    int band;               /* band index */
+    int first_samp;         /* first sample inside all the footprints */
+    int last_samp;          /* last sample inside all the footprints */
+    int band_first;         /* first sample inside the band's footprint */
+    int band_last;          /* last sample inside the band's footprint */
+    uint16_t *qa;           /* current line of the quality band */
+
+    for (line = first_line; line < first_line + nlines; line++)
+    {
+        qa = buf + (size_t) (line - first_line) * scene->nsamps;
+        memset (qa, 0, scene->nsamps * sizeof (uint16_t));
+
+        if (scene->fill == SYNTHETIC_FILL_FOOTPRINT)
+        {
+            /* Valid pixels are inside the footprint of every band */
+            first_samp = 0;
+            last_samp = scene->nsamps - 1;
+            for (band = 0; band < scene->nbands; band++)
+            {
+                get_footprint_span (scene, footprint, band, line,
+                    &band_first, &band_last);
+                if (band_first > first_samp)
+                    first_samp = band_first;
+                if (band_last < last_samp)
+                    last_samp = band_last;
+            }
+            for (samp = 0; samp < scene->nsamps; samp++)
+                if (samp < first_samp || samp > last_samp)
+                    qa[samp] = 1;
+        }
+        else if (scene->fill == SYNTHETIC_FILL_RANDOM)
+        {
+            for (samp = 0; samp < scene->nsamps; samp++)
+            {
+                for (band = 0; band < scene->nbands; band++)
+                {
+                    if (is_random_fill (scene, band, line, samp))
+                    {
+                        qa[samp] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  fill_synthetic_metadata
+
+PURPOSE: Fills the metadata of a synthetic product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the product description or allocating the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The band files are named <base_name>_<band name>.img.
+******************************************************************************/
+int fill_synthetic_metadata
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    const char *base_name,           /* I: prefix of the band filenames */
+    Espa_internal_meta_t *metadata   /* O: metadata of the product; must
+                                           have been initialized with
+                                           init_metadata_struct */
+)
+{
+    char FUNC_NAME[] = "fill_synthetic_metadata";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    Espa_global_meta_t *gmeta = &metadata->global;  /* global metadata */
+    Espa_band_meta_t *bmeta;   /* metadata of the current band */
+    int nbands;             /* number of bands, including the quality band */
+    int i;                  /* band index */
+    int count;              /* number of chars copied in snprintf */
+    long fill_value;        /* fill value of the image bands */
+    double range_min;       /* lowest valid value of the image bands */
+    double range_max;       /* highest valid value of the image bands */
+
+    /* Validate the product description */
+    nbands = scene->nbands + (scene->qa_band ? 1 : 0);
+    if (scene->nbands < 1)
+    {
+        sprintf (errmsg, "Number of bands must be at least 1");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (scene->nlines < 1 || scene->nlines > SYNTHETIC_MAX_SIZE ||
+        scene->nsamps < 1 || scene->nsamps > SYNTHETIC_MAX_SIZE)
+    {
+        sprintf (errmsg, "Number of lines and samples must be from 1 to %d",
+            SYNTHETIC_MAX_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (scene->fill_fraction < 0.0 || scene->fill_fraction > 1.0)
+    {
+        sprintf (errmsg, "Fill fraction must be from 0 to 1");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (scene->misalign < 0)
+    {
+        sprintf (errmsg, "Misalignment must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (scene->pixel_size <= 0.0)
+    {
+        sprintf (errmsg, "Pixel size must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (get_synthetic_range (scene->data_type, &fill_value, &range_min,
+        &range_max) != SUCCESS)
+    {
+        sprintf (errmsg, "Unsupported data type %d", scene->data_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Global metadata */
+    strcpy (metadata->meta_namespace, ESPA_NS);
+    strcpy (gmeta->data_provider, "USGS/EROS");
+    strcpy (gmeta->satellite, scene->satellite);
+    strcpy (gmeta->instrument, scene->instrument);
+    strcpy (gmeta->acquisition_date, scene->acquisition_date);
+    strcpy (gmeta->scene_center_time, "17:37:41.0000000Z");
+    strcpy (gmeta->level1_production_date, "2013-10-15T00:00:00Z");
+    gmeta->bounding_coords[ESPA_WEST] = scene->bounding_coords[ESPA_WEST];
+    gmeta->bounding_coords[ESPA_EAST] = scene->bounding_coords[ESPA_EAST];
+    gmeta->bounding_coords[ESPA_NORTH] = scene->bounding_coords[ESPA_NORTH];
+    gmeta->bounding_coords[ESPA_SOUTH] = scene->bounding_coords[ESPA_SOUTH];
+    gmeta->ul_corner[0] = scene->bounding_coords[ESPA_NORTH];
+    gmeta->ul_corner[1] = scene->bounding_coords[ESPA_WEST];
+    gmeta->lr_corner[0] = scene->bounding_coords[ESPA_SOUTH];
+    gmeta->lr_corner[1] = scene->bounding_coords[ESPA_EAST];
+    if (!strncmp (scene->satellite, "LANDSAT", 7))
+    {
+        gmeta->wrs_system = 2;
+        gmeta->wrs_path = 33;
+        gmeta->wrs_row = 32;
+    }
+    gmeta->orientation_angle = 0.0;
+    gmeta->solar_zenith = 45.0;
+    gmeta->solar_azimuth = 150.0;
+    strcpy (gmeta->solar_units, "degrees");
+
+    /* Projection, with the LR corner at the center of the last pixel */
+    gmeta->proj_info = scene->proj_info;
+    gmeta->proj_info.lr_corner[0] = scene->proj_info.ul_corner[0] +
+        scene->pixel_size * (scene->nsamps - 1);
+    gmeta->proj_info.lr_corner[1] = scene->proj_info.ul_corner[1] -
+        scene->pixel_size * (scene->nlines - 1);
+
+    if (allocate_band_metadata (metadata, nbands) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the metadata of %d bands", nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nbands; i++)
+    {
+        bmeta = &metadata->band[i];
+        if (i == scene->nbands)
+        {
+            /* Quality band */
+            strcpy (bmeta->name, "qa");
+            strcpy (bmeta->category, "qa");
+            bmeta->data_type = ESPA_UINT16;
+            bmeta->fill_value = 1;
+            bmeta->valid_range[0] = 0.0;
+            bmeta->valid_range[1] = 65535.0;
+            bmeta->resample_method = ESPA_NN;
+            strcpy (bmeta->data_units, "quality/feature classification");
+        }
+        else
+        {
+            if (scene->band_names != NULL)
+                count = snprintf (bmeta->name, sizeof (bmeta->name), "%s",
+                    scene->band_names[i]);
+            else
+                count = snprintf (bmeta->name, sizeof (bmeta->name),
+                    "band%d", i + 1);
+            if (count < 0 || count >= sizeof (bmeta->name))
+            {
+                sprintf (errmsg, "Overflow of bmeta->name string");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            strcpy (bmeta->category, "image");
+            bmeta->data_type = scene->data_type;
+            bmeta->fill_value = fill_value;
+            bmeta->valid_range[0] = range_min;
+            bmeta->valid_range[1] = range_max;
+            bmeta->resample_method = ESPA_CC;
+            strcpy (bmeta->data_units, "digital numbers");
+        }
+
+        strcpy (bmeta->product, scene->product);
+        strcpy (bmeta->source, "level1");
+        bmeta->nlines = scene->nlines;
+        bmeta->nsamps = scene->nsamps;
+        count = snprintf (bmeta->file_name, sizeof (bmeta->file_name),
+            "%s_%s.img", base_name, bmeta->name);
+        if (count < 0 || count >= sizeof (bmeta->file_name))
+        {
+            sprintf (errmsg, "Overflow of bmeta->file_name string");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        snprintf (bmeta->short_name, sizeof (bmeta->short_name), "%.*s%s",
+            4, scene->instrument, bmeta->name);
+        snprintf (bmeta->long_name, sizeof (bmeta->long_name),
+            "synthetic %s", bmeta->name);
+        bmeta->pixel_size[0] = scene->pixel_size;
+        bmeta->pixel_size[1] = scene->pixel_size;
+        strcpy (bmeta->pixel_units, scene->proj_info.units);
+        strcpy (bmeta->app_version, "synthetic_scene");
+        strcpy (bmeta->production_date, "2013-10-15T00:00:00Z");
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_synthetic_band
+
+PURPOSE: Generates and writes a band of a synthetic product and its ENVI
+header.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int write_synthetic_band
+(
+    const Synthetic_scene_t *scene,        /* I: synthetic product */
+    const Synthetic_footprint_t *footprint,/* I: footprint of the scene */
+    Espa_internal_meta_t *metadata,  /* I: metadata of the product */
+    int band,               /* I: band index */
+    const char *dir_name,   /* I: directory of the product; empty for the
+                                  current directory */
+    void *buf               /* I: buffer for a block of any band */
+)
+{
+    char FUNC_NAME[] = "write_synthetic_band";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char img_file[STR_SIZE];/* name of the band file */
+    char hdr_file[STR_SIZE];/* name of the ENVI header file */
+    char *cptr;             /* pointer to the file extension */
+    int count;              /* number of chars copied in snprintf */
+    int line;               /* first line of the current block */
+    int nlines;             /* number of lines in the current block */
+    int nbytes;             /* number of bytes per pixel */
+    Espa_band_meta_t *bmeta = &metadata->band[band];  /* band metadata */
+    Envi_header_t envi_hdr; /* ENVI header of the band */
+    FILE *fp;               /* band file */
+
+    count = snprintf (img_file, sizeof (img_file), "%s%s", dir_name,
+        bmeta->file_name);
+    if (count < 0 || count >= sizeof (img_file))
+    {
+        sprintf (errmsg, "Overflow of img_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    nbytes = get_data_type_size (bmeta->data_type);
+    fp = open_raw_binary (img_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the band file %s", img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (line = 0; line < scene->nlines; line += SYNTHETIC_LINE_BLOCK)
+    {
+        nlines = scene->nlines - line;
+        if (nlines > SYNTHETIC_LINE_BLOCK)
+            nlines = SYNTHETIC_LINE_BLOCK;
+
+        if (band == scene->nbands)
+            generate_qa_block (scene, footprint, line, nlines, buf);
+        else
+            generate_image_block (scene, footprint, bmeta, band, line,
+                nlines, buf);
+
+        if (write_raw_binary (fp, nlines, scene->nsamps, nbytes, buf)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Writing lines %d-%d of the band file %s", line,
+                line + nlines - 1, img_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary (fp);
+            return (ERROR);
+        }
+    }
+    close_raw_binary (fp);
+
+    /* Write the ENVI header next to the band file */
+    if (create_envi_struct (bmeta, &metadata->global, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the ENVI header structure for %s",
+            img_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (hdr_file, img_file);
+    cptr = strrchr (hdr_file, '.');
+    strcpy (cptr, ".hdr");
+    if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file %s", hdr_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_synthetic_scene
+
+PURPOSE: Writes a synthetic product: the bands and their ENVI headers to the
+directory of the XML file, and the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the product
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The band files are named after the XML file, without its .xml
+     extension, and the band names.
+******************************************************************************/
+int create_synthetic_scene
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    char *xml_file                   /* I: name of the XML file; the bands
+                                           are written to its directory */
+)
+{
+    char FUNC_NAME[] = "create_synthetic_scene";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char dir_name[STR_SIZE];  /* directory of the XML file, with the
+                                 trailing slash */
+    char base_name[STR_SIZE]; /* XML filename without directory or
+                                 extension */
+    char *cptr;             /* pointer into the filenames */
+    int band;               /* band index */
+    int count;              /* number of chars copied in snprintf */
+    Espa_internal_meta_t metadata;   /* metadata of the product */
+    Synthetic_footprint_t footprint; /* footprint of the scene */
+    void *buf = NULL;       /* block of a band */
+
+    /* Split the XML filename into its directory and base name */
+    count = snprintf (dir_name, sizeof (dir_name), "%s", xml_file);
+    if (count < 0 || count >= sizeof (dir_name))
+    {
+        sprintf (errmsg, "Overflow of dir_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    cptr = strrchr (dir_name, '/');
+    if (cptr != NULL)
+    {
+        strcpy (base_name, cptr + 1);
+        cptr[1] = '\0';
+    }
+    else
+    {
+        strcpy (base_name, dir_name);
+        dir_name[0] = '\0';
+    }
+    cptr = strrchr (base_name, '.');
+    if (cptr != NULL && !strcmp (cptr, ".xml"))
+        *cptr = '\0';
+
+    init_metadata_struct (&metadata);
+    if (fill_synthetic_metadata (scene, base_name, &metadata) != SUCCESS)
+    {
+        sprintf (errmsg, "Filling the metadata of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&metadata);
+        return (ERROR);
+    }
+
+    if (scene->fill == SYNTHETIC_FILL_FOOTPRINT &&
+        init_footprint (scene, &footprint) != SUCCESS)
+    {
+        sprintf (errmsg, "Computing the footprint of %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&metadata);
+        return (ERROR);
+    }
+
+    /* One buffer is large enough for a block of any band */
+    buf = malloc ((size_t) SYNTHETIC_LINE_BLOCK * scene->nsamps *
+        sizeof (double));
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating a block of %d lines x %d samples",
+            SYNTHETIC_LINE_BLOCK, scene->nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&metadata);
+        return (ERROR);
+    }
+
+    for (band = 0; band < metadata.nbands; band++)
+    {
+        if (write_synthetic_band (scene, &footprint, &metadata, band,
+            dir_name, buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing band %s of %s",
+                metadata.band[band].name, xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (buf);
+            free_metadata (&metadata);
+            return (ERROR);
+        }
+    }
+    free (buf);
+
+    if (write_metadata (&metadata, xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML file %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&metadata);
+        return (ERROR);
+    }
+
+    free_metadata (&metadata);
+    return (SUCCESS);
+}
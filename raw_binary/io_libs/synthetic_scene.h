@@ -0,0 +1,102 @@
+/*****************************************************************************
+FILE: synthetic_scene.h
+
+PURPOSE: Contains defines, structures, and prototypes for writing synthetic
+ESPA products, so the tools can be benchmarked and stress-tested at
+realistic sizes without real Landsat or MODIS data.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. A synthetic product is an ESPA XML file written by write_metadata and a
+     raw binary file (with an ENVI header) for each band, written by
+     write_raw_binary.  The pixel values are a gradient with pseudo-random
+     noise within the valid range of the data type, so they are the same for
+     the same seed.
+  2. The footprint fill pattern marks the pixels outside a rotated rectangle
+     as fill, like the footprint of a Landsat scene.  The left and right
+     edges of the footprint are moved inward by up to "misalign" pixels for
+     each band, so the fill isn't aligned between the bands, as
+     clip_band_misalignment expects of TM and ETM+ scenes.
+  3. The quality band is a UINT16 band named "qa" with bit 0 (designated
+     fill) set where any image band is fill.
+*****************************************************************************/
+
+#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+
+/* Defines */
+/* Largest synthetic band, in lines or samples */
+#define SYNTHETIC_MAX_SIZE 100000
+
+/* Number of lines of a band generated and written at a time */
+#define SYNTHETIC_LINE_BLOCK 64
+
+/* Fill patterns of the synthetic bands */
+typedef enum
+{
+    SYNTHETIC_FILL_NONE,        /* no fill pixels */
+    SYNTHETIC_FILL_FOOTPRINT,   /* fill outside a rotated scene footprint */
+    SYNTHETIC_FILL_RANDOM       /* pseudo-random fill pixels */
+} Synthetic_fill_t;
+
+/* Description of a synthetic product */
+typedef struct
+{
+    char satellite[STR_SIZE];   /* satellite of the product */
+    char instrument[STR_SIZE];  /* instrument of the product */
+    char product[STR_SIZE];     /* product type of the bands */
+    char acquisition_date[STR_SIZE];  /* acquisition date (yyyy-mm-dd) */
+    int nbands;                 /* number of image bands */
+    const char **band_names;    /* names of the image bands; NULL for band1,
+                                   band2, ... */
+    bool qa_band;               /* add the quality band? */
+    enum Espa_data_type data_type;  /* data type of the image bands */
+    int nlines;                 /* number of lines in each band */
+    int nsamps;                 /* number of samples in each band */
+    Synthetic_fill_t fill;      /* fill pattern */
+    double footprint_angle;     /* rotation of the footprint (degrees) */
+    int misalign;               /* largest number of pixels the footprint
+                                   edges of the bands differ by */
+    double fill_fraction;       /* fraction of random fill pixels */
+    unsigned int seed;          /* seed of the pseudo-random values */
+    Espa_proj_meta_t proj_info; /* projection; the UL corner is given and
+                                   the LR corner is computed */
+    double pixel_size;          /* pixel size in the projection units */
+    double bounding_coords[4];  /* geographic west, east, north, south; the
+                                   corners are taken from these, since they
+                                   aren't projected */
+} Synthetic_scene_t;
+
+/* Prototypes */
+void init_synthetic_scene
+(
+    Synthetic_scene_t *scene    /* O: synthetic product set to the defaults */
+);
+
+int fill_synthetic_metadata
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    const char *base_name,           /* I: prefix of the band filenames */
+    Espa_internal_meta_t *metadata   /* O: metadata of the product; must
+                                           have been initialized with
+                                           init_metadata_struct */
+);
+
+int create_synthetic_scene
+(
+    const Synthetic_scene_t *scene,  /* I: synthetic product */
+    char *xml_file                   /* I: name of the XML file; the bands
+                                           are written to its directory */
+);
+
+#endif
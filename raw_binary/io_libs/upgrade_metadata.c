@@ -0,0 +1,739 @@
+/*****************************************************************************
+FILE: upgrade_metadata.c
+
+PURPOSE: Contains functions for upgrading ESPA XML metadata files to a newer
+version of the ESPA internal metadata schema, one file at a time or a list
+of files in parallel.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. An XML file is upgraded in one streaming pass: each node read by the
+     libxml2 reader is written by the libxml2 writer, so the memory used
+     doesn't depend on the size of the file.  The text, whitespace and
+     comments are kept, so the upgraded file only differs from the original
+     where the schemas differ.
+  2. The upgrade moves the elements to the namespace of the new schema,
+     updates the version and schemaLocation of espa_metadata, and applies
+     the element changes of each schema version in between:
+       1.2  toa_reflectance is renamed radiance
+       1.3  calibrated_nt is removed
+       2.0  scene_id is renamed product_id
+     The rest of the changes only added optional elements or relaxed types,
+     so the older elements are valid as they are.
+  3. The upgraded file is written next to the output file and renamed over
+     it once complete, so an XML file upgraded in place is never left
+     partially written.
+*****************************************************************************/
+
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <libxml/parser.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
+#include "espa_metadata.h"
+#include "espa_task.h"
+#include "upgrade_metadata.h"
+
+/* Namespace of the xsi:schemaLocation attribute */
+#define XSI_NS "http://www.w3.org/2001/XMLSchema-instance"
+
+/* ESPA internal metadata schema version */
+typedef struct
+{
+    const char *version;    /* version of the schema */
+    const char *ns;         /* namespace of the schema */
+    const char *schema;     /* location of the schema */
+} Schema_version_t;
+
+/* Schema versions, oldest first */
+#define NSCHEMA_VERSIONS 6
+static const Schema_version_t schema_versions[NSCHEMA_VERSIONS] =
+{
+    {"1.0", "http://espa.cr.usgs.gov/v1.0",
+     "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd"},
+    {"1.1", "http://espa.cr.usgs.gov/v1.1",
+     "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_1.xsd"},
+    {"1.2", "http://espa.cr.usgs.gov/v1.2",
+     "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_2.xsd"},
+    {"1.3", "http://espa.cr.usgs.gov/v1",
+     "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_3.xsd"},
+    {"2.0", "http://espa.cr.usgs.gov/v2",
+     "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v2_0.xsd"},
+    {"2.1", "http://espa.cr.usgs.gov/v2",
+     "http://espa.cr.usgs.gov/schema/espa_internal_metadata_v2_1.xsd"}
+};
+
+/* Element renamed or removed by a schema version */
+typedef struct
+{
+    int version;            /* index of the schema version of the change */
+    const char *old_name;   /* name of the element before the change */
+    const char *new_name;   /* name of the element after the change; NULL
+                               if the element was removed */
+} Element_change_t;
+
+#define NELEMENT_CHANGES 3
+static const Element_change_t element_changes[NELEMENT_CHANGES] =
+{
+    {2, "toa_reflectance", "radiance"},
+    {3, "calibrated_nt", NULL},
+    {4, "scene_id", "product_id"}
+};
+
+/* State of the upgrade of an XML file */
+typedef struct
+{
+    xmlTextReaderPtr reader;   /* reader of the input XML file */
+    xmlTextWriterPtr writer;   /* writer of the upgraded XML file */
+    int from;               /* index of the schema version of the input */
+    int to;                 /* index of the schema version upgraded to */
+    xmlChar *whitespace;    /* whitespace not yet written, which is dropped
+                               with a removed element */
+} Upgrade_state_t;
+
+/* XML files upgraded by upgrade_metadata_files */
+typedef struct
+{
+    char **in_xml_file;     /* XML files to be upgraded */
+    char **out_xml_file;    /* upgraded XML files */
+    const char *version;    /* schema version to upgrade to */
+    int *status;            /* status of the upgrade of each file */
+    bool *upgraded;         /* was each file older than the version? */
+} Upgrade_work_t;
+
+
+/******************************************************************************
+MODULE:  find_schema_version
+
+PURPOSE: Finds a schema version by its version number or namespace.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The schema version isn't known
+0..             Index of the schema version
+
+NOTES:
+******************************************************************************/
+static int find_schema_version
+(
+    const char *version,    /* I: version of the schema; NULL to use ns */
+    const char *ns          /* I: namespace of the schema; NULL to use
+                                  version */
+)
+{
+    int i;                  /* looping variable for the versions */
+
+    for (i = 0; i < NSCHEMA_VERSIONS; i++)
+    {
+        if (version != NULL && !strcmp (version, schema_versions[i].version))
+            return (i);
+        if (version == NULL && ns != NULL &&
+            !strcmp (ns, schema_versions[i].ns))
+            return (i);
+    }
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  is_espa_schema_version
+
+PURPOSE: Determines if a version is one of the ESPA internal metadata schema
+versions.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The schema version is known
+false           The schema version isn't known
+
+NOTES:
+******************************************************************************/
+bool is_espa_schema_version
+(
+    const char *version     /* I: schema version, such as "1.2" */
+)
+{
+    return (find_schema_version (version, NULL) >= 0);
+}
+
+
+/******************************************************************************
+MODULE:  upgrade_element_name
+
+PURPOSE: Applies the element changes of the schema versions upgraded through
+to the local name of an ESPA element.
+
+RETURN VALUE:
+Type = const char *
+Value           Description
+-----           -----------
+NULL            The element was removed
+other           Local name of the element in the upgraded schema
+
+NOTES:
+******************************************************************************/
+static const char *upgrade_element_name
+(
+    const Upgrade_state_t *state,  /* I: state of the upgrade */
+    const char *name        /* I: local name of the element */
+)
+{
+    int i;                  /* looping variable for the changes */
+
+    for (i = 0; i < NELEMENT_CHANGES && name != NULL; i++)
+    {
+        if (element_changes[i].version > state->from &&
+            element_changes[i].version <= state->to &&
+            !strcmp (name, element_changes[i].old_name))
+            name = element_changes[i].new_name;
+    }
+
+    return (name);
+}
+
+
+/******************************************************************************
+MODULE:  flush_whitespace
+
+PURPOSE: Writes the whitespace held back before the current node.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the whitespace
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int flush_whitespace
+(
+    Upgrade_state_t *state  /* I/O: state of the upgrade */
+)
+{
+    int count = 0;          /* number of bytes written */
+
+    if (state->whitespace != NULL)
+    {
+        count = xmlTextWriterWriteRaw (state->writer, state->whitespace);
+        xmlFree (state->whitespace);
+        state->whitespace = NULL;
+    }
+
+    return (count < 0 ? ERROR : SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_upgraded_element
+
+PURPOSE: Writes the start of the current element of the reader with its
+attributes, upgraded to the new schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the element
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The ESPA namespace declarations are moved to the new namespace, and
+     the version and schemaLocation of espa_metadata are updated.
+******************************************************************************/
+static int write_upgraded_element
+(
+    Upgrade_state_t *state, /* I/O: state of the upgrade */
+    const char *name        /* I: local name of the element in the upgraded
+                                  schema */
+)
+{
+    const Schema_version_t *from = &schema_versions[state->from];
+    const Schema_version_t *to = &schema_versions[state->to];
+    xmlTextReaderPtr reader = state->reader;  /* reader of the input */
+    const char *prefix;     /* namespace prefix of the element */
+    const char *attr_name;  /* qualified name of the attribute */
+    const char *attr_ns;    /* namespace of the attribute */
+    const char *value;      /* value of the attribute */
+    char qname[STR_SIZE];   /* qualified name of the element */
+    char schema_location[STR_SIZE];  /* upgraded schemaLocation */
+    bool is_root;           /* is the element espa_metadata? */
+    int count;              /* number of chars copied in snprintf */
+
+    prefix = (const char *) xmlTextReaderConstPrefix (reader);
+    if (prefix != NULL)
+        count = snprintf (qname, sizeof (qname), "%s:%s", prefix, name);
+    else
+        count = snprintf (qname, sizeof (qname), "%s", name);
+    if (count < 0 || count >= sizeof (qname))
+        return (ERROR);
+    if (xmlTextWriterStartElement (state->writer, BAD_CAST qname) < 0)
+        return (ERROR);
+
+    is_root = (xmlTextReaderDepth (reader) == 0);
+    snprintf (schema_location, sizeof (schema_location), "%s %s", to->ns,
+        to->schema);
+    while (xmlTextReaderMoveToNextAttribute (reader) == 1)
+    {
+        attr_name = (const char *) xmlTextReaderConstName (reader);
+        attr_ns = (const char *) xmlTextReaderConstNamespaceUri (reader);
+        value = (const char *) xmlTextReaderConstValue (reader);
+        if (xmlTextReaderIsNamespaceDecl (reader) == 1)
+        {
+            if (!strcmp (value, from->ns))
+                value = to->ns;
+        }
+        else if (is_root && attr_ns == NULL && !strcmp (attr_name, "version"))
+            value = to->version;
+        else if (is_root && attr_ns != NULL && !strcmp (attr_ns, XSI_NS) &&
+            !strcmp ((const char *) xmlTextReaderConstLocalName (reader),
+            "schemaLocation"))
+            value = schema_location;
+
+        if (xmlTextWriterWriteAttribute (state->writer, BAD_CAST attr_name,
+            BAD_CAST value) < 0)
+            return (ERROR);
+    }
+    xmlTextReaderMoveToElement (reader);
+
+    if (xmlTextReaderIsEmptyElement (reader) &&
+        xmlTextWriterEndElement (state->writer) < 0)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  copy_upgraded_nodes
+
+PURPOSE: Reads the nodes of the input XML file following espa_metadata and
+writes them upgraded to the new schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the nodes
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The reader is positioned on espa_metadata, which is written first.
+******************************************************************************/
+static int copy_upgraded_nodes
+(
+    Upgrade_state_t *state  /* I/O: state of the upgrade */
+)
+{
+    xmlTextReaderPtr reader = state->reader;  /* reader of the input */
+    xmlTextWriterPtr writer = state->writer;  /* writer of the output */
+    const char *espa_ns = schema_versions[state->from].ns;  /* namespace of
+                               the input elements */
+    const char *ns;         /* namespace of the element */
+    const char *name;       /* local name of the element */
+    const xmlChar *value;   /* value of the node */
+    int node_type;          /* type of the node */
+    int count = 0;          /* number of bytes written */
+    int status = 1;         /* status of the reader */
+
+    while (status == 1)
+    {
+        node_type = xmlTextReaderNodeType (reader);
+        value = xmlTextReaderConstValue (reader);
+        count = 0;
+
+        /* Hold back the whitespace until the next node is known to be
+           written */
+        if (node_type == XML_READER_TYPE_WHITESPACE ||
+            node_type == XML_READER_TYPE_SIGNIFICANT_WHITESPACE)
+        {
+            if (state->whitespace == NULL)
+                state->whitespace = xmlStrdup (value);
+            else
+                state->whitespace = xmlStrcat (state->whitespace, value);
+            status = xmlTextReaderRead (reader);
+            continue;
+        }
+
+        if (node_type == XML_READER_TYPE_ELEMENT)
+        {
+            name = (const char *) xmlTextReaderConstLocalName (reader);
+            ns = (const char *) xmlTextReaderConstNamespaceUri (reader);
+            if (ns != NULL && !strcmp (ns, espa_ns))
+                name = upgrade_element_name (state, name);
+
+            /* Skip a removed element with the whitespace before it */
+            if (name == NULL)
+            {
+                xmlFree (state->whitespace);
+                state->whitespace = NULL;
+                status = xmlTextReaderNext (reader);
+                continue;
+            }
+
+            if (flush_whitespace (state) != SUCCESS ||
+                write_upgraded_element (state, name) != SUCCESS)
+                return (ERROR);
+        }
+        else
+        {
+            if (flush_whitespace (state) != SUCCESS)
+                return (ERROR);
+
+            switch (node_type)
+            {
+                case XML_READER_TYPE_END_ELEMENT:
+                    count = xmlTextWriterFullEndElement (writer);
+                    break;
+
+                case XML_READER_TYPE_TEXT:
+                    count = xmlTextWriterWriteString (writer, value);
+                    break;
+
+                case XML_READER_TYPE_CDATA:
+                    count = xmlTextWriterWriteCDATA (writer, value);
+                    break;
+
+                case XML_READER_TYPE_COMMENT:
+                    count = xmlTextWriterWriteComment (writer, value);
+                    break;
+
+                case XML_READER_TYPE_PROCESSING_INSTRUCTION:
+                    count = xmlTextWriterWritePI (writer,
+                        xmlTextReaderConstName (reader), value);
+                    break;
+
+                default:
+                    break;
+            }
+            if (count < 0)
+                return (ERROR);
+        }
+
+        status = xmlTextReaderRead (reader);
+    }
+
+    return (status == 0 ? SUCCESS : ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  upgrade_metadata_file
+
+PURPOSE: Upgrades an XML file to a version of the ESPA internal metadata
+schema.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading, upgrading or writing the XML file
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The schema version of the XML file is the version of espa_metadata, or
+     the version of its namespace if it has no version.
+  2. An XML file already at the version is copied to the output file, or
+     left alone if it's upgraded in place.  upgraded is false for it.
+  3. Comments and processing instructions before espa_metadata are kept.
+     The XML declaration is always written with UTF-8 encoding.
+******************************************************************************/
+int upgrade_metadata_file
+(
+    const char *in_xml_file,   /* I: XML file to be upgraded */
+    const char *out_xml_file,  /* I: upgraded XML file; may be the same as
+                                     in_xml_file to upgrade it in place */
+    const char *version,       /* I: schema version to upgrade to */
+    bool *upgraded             /* O: was the XML file older than version? */
+)
+{
+    char FUNC_NAME[] = "upgrade_metadata_file";   /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char tmp_file[PATH_MAX];   /* upgraded XML file being written */
+    xmlChar *root_version;     /* version of espa_metadata */
+    Upgrade_state_t state;     /* state of the upgrade */
+    bool in_place;             /* is the XML file upgraded in place? */
+    int node_type;             /* type of the node */
+    int count;                 /* number of chars copied in snprintf */
+    int status = SUCCESS;      /* status of the upgrade */
+
+    *upgraded = false;
+    state.to = find_schema_version (version, NULL);
+    if (state.to < 0)
+    {
+        sprintf (errmsg, "Unknown schema version %s", version);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    in_place = !strcmp (in_xml_file, out_xml_file);
+
+    count = snprintf (tmp_file, sizeof (tmp_file), "%s.upgrade",
+        out_xml_file);
+    if (count < 0 || count >= sizeof (tmp_file))
+    {
+        sprintf (errmsg, "Overflow of tmp_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    state.whitespace = NULL;
+    state.writer = NULL;
+    state.reader = xmlReaderForFile (in_xml_file, NULL, XML_PARSE_NONET);
+    if (state.reader == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the XML file %s",
+            in_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    state.writer = xmlNewTextWriterFilename (tmp_file, 0);
+    if (state.writer == NULL ||
+        xmlTextWriterStartDocument (state.writer, NULL, "UTF-8", NULL) < 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Creating the XML file %s",
+            tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Copy the nodes before espa_metadata, one per line */
+    while (status == SUCCESS)
+    {
+        if (xmlTextReaderRead (state.reader) != 1)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Reading espa_metadata from "
+                "the XML file %s", in_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        node_type = xmlTextReaderNodeType (state.reader);
+        if (node_type == XML_READER_TYPE_ELEMENT)
+            break;
+        if ((node_type == XML_READER_TYPE_COMMENT &&
+            xmlTextWriterWriteComment (state.writer,
+            xmlTextReaderConstValue (state.reader)) < 0) ||
+            (node_type == XML_READER_TYPE_PROCESSING_INSTRUCTION &&
+            xmlTextWriterWritePI (state.writer,
+            xmlTextReaderConstName (state.reader),
+            xmlTextReaderConstValue (state.reader)) < 0) ||
+            xmlTextWriterWriteRaw (state.writer, BAD_CAST "\n") < 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Writing the XML file %s",
+                tmp_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Determine the schema version of the XML file */
+    if (status == SUCCESS)
+    {
+        root_version = xmlTextReaderGetAttribute (state.reader,
+            BAD_CAST "version");
+        state.from = find_schema_version ((const char *) root_version,
+            NULL);
+        if (state.from < 0)
+            state.from = find_schema_version (NULL, (const char *)
+                xmlTextReaderConstNamespaceUri (state.reader));
+        xmlFree (root_version);
+
+        if (strcmp ((const char *) xmlTextReaderConstLocalName
+            (state.reader), "espa_metadata") || state.from < 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "%s isn't an ESPA XML file of "
+                "a known schema version", in_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        else if (state.from > state.to)
+        {
+            snprintf (errmsg, sizeof (errmsg), "%s is schema version %s, "
+                "which can't be downgraded to %s", in_xml_file,
+                schema_versions[state.from].version, version);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        *upgraded = (state.from < state.to);
+    }
+
+    /* Write the upgraded XML file unless it would be the same file */
+    if (status == SUCCESS && (*upgraded || !in_place))
+    {
+        if (copy_upgraded_nodes (&state) != SUCCESS ||
+            xmlTextWriterEndDocument (state.writer) < 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Upgrading the XML file %s to "
+                "%s", in_xml_file, out_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    xmlFree (state.whitespace);
+    xmlFreeTextReader (state.reader);
+    if (state.writer != NULL)
+        xmlFreeTextWriter (state.writer);
+
+    /* Replace the output file with the upgraded file */
+    if (status == SUCCESS && (*upgraded || !in_place))
+    {
+        if (rename (tmp_file, out_xml_file) != 0)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Renaming %s to %s", tmp_file,
+                out_xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    if (status != SUCCESS || (!*upgraded && in_place))
+        unlink (tmp_file);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  upgrade_files_chunk
+
+PURPOSE: espa_parallel_for chunk function upgrading a range of the XML files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         The XML files were processed; the status of each one is
+                saved in the work
+
+NOTES:
+  1. A file which fails doesn't stop the rest from being upgraded.
+******************************************************************************/
+static int upgrade_files_chunk
+(
+    void *arg,              /* I: XML files upgraded (Upgrade_work_t) */
+    int first,              /* I: first file of the chunk */
+    int end,                /* I: file after the last one of the chunk */
+    int runner              /* I: number of the runner; not used */
+)
+{
+    Upgrade_work_t *work = arg;  /* XML files upgraded */
+    int i;                  /* looping variable for the files */
+
+    for (i = first; i < end; i++)
+    {
+        work->status[i] = upgrade_metadata_file (work->in_xml_file[i],
+            work->out_xml_file[i], work->version, &work->upgraded[i]);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  upgrade_metadata_files
+
+PURPOSE: Upgrades a list of XML files to a version of the ESPA internal
+metadata schema, in parallel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory or starting the upgrades
+SUCCESS         The XML files were processed; counts tells how many of them
+                failed
+
+NOTES:
+  1. The files are handed out to the threads one at a time, since their
+     sizes vary.
+******************************************************************************/
+int upgrade_metadata_files
+(
+    int nfiles,                /* I: number of XML files */
+    char **in_xml_file,        /* I: XML files to be upgraded */
+    char **out_xml_file,       /* I: upgraded XML files */
+    const char *version,       /* I: schema version to upgrade to */
+    int nthreads,              /* I: number of threads upgrading the files */
+    int *file_status,          /* O: status of the upgrade of each file
+                                     (SUCCESS or ERROR); NULL if not needed */
+    Upgrade_counts_t *counts   /* O: what the upgrade did */
+)
+{
+    char FUNC_NAME[] = "upgrade_metadata_files";   /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    Upgrade_work_t work;       /* XML files upgraded */
+    int status;                /* status of the upgrades */
+    int i;                     /* looping variable for the files */
+
+    counts->nupgraded = 0;
+    counts->ncurrent = 0;
+    counts->nfailed = 0;
+    if (nfiles < 1)
+        return (SUCCESS);
+
+    if (!is_espa_schema_version (version))
+    {
+        sprintf (errmsg, "Unknown schema version %s", version);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    work.in_xml_file = in_xml_file;
+    work.out_xml_file = out_xml_file;
+    work.version = version;
+    work.status = calloc (nfiles, sizeof (int));
+    work.upgraded = calloc (nfiles, sizeof (bool));
+    if (work.status == NULL || work.upgraded == NULL)
+    {
+        sprintf (errmsg, "Allocating the status of the XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (work.status);
+        free (work.upgraded);
+        return (ERROR);
+    }
+
+    /* Initialize libxml2 before the threads use it */
+    init_espa_xml ();
+
+    if (nthreads < 1)
+        nthreads = 1;
+    else if (nthreads > UPGRADE_MAX_THREADS)
+        nthreads = UPGRADE_MAX_THREADS;
+    status = espa_parallel_for (0, nfiles, 1, nthreads, upgrade_files_chunk,
+        &work);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Upgrading the XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else
+    {
+        for (i = 0; i < nfiles; i++)
+        {
+            if (work.status[i] != SUCCESS)
+                counts->nfailed++;
+            else if (work.upgraded[i])
+                counts->nupgraded++;
+            else
+                counts->ncurrent++;
+            if (file_status != NULL)
+                file_status[i] = work.status[i];
+        }
+    }
+
+    free (work.status);
+    free (work.upgraded);
+    return (status);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+FILE: upgrade_metadata.h
+
+PURPOSE: Contains defines, structures, and prototypes for upgrading ESPA XML
+metadata files to a newer version of the ESPA internal metadata schema.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The schema versions known are 1.0, 1.1, 1.2, 1.3 and 2.0.  Only
+     upgrades are supported, since the older schemas can't hold the
+     elements added by the newer ones.
+*****************************************************************************/
+
+#ifndef UPGRADE_METADATA_H
+#define UPGRADE_METADATA_H
+
+#include <stdbool.h>
+#include "error_handler.h"
+
+/* Defines */
+/* Largest number of threads upgrading the XML files */
+#define UPGRADE_MAX_THREADS 64
+
+/* Type definitions */
+/* What upgrade_metadata_files did */
+typedef struct
+{
+    int nupgraded;          /* number of XML files upgraded */
+    int ncurrent;           /* number of XML files already at the version */
+    int nfailed;            /* number of XML files which couldn't be
+                               upgraded */
+} Upgrade_counts_t;
+
+/* Prototypes */
+bool is_espa_schema_version
+(
+    const char *version     /* I: schema version, such as "1.2" */
+);
+
+int upgrade_metadata_file
+(
+    const char *in_xml_file,   /* I: XML file to be upgraded */
+    const char *out_xml_file,  /* I: upgraded XML file; may be the same as
+                                     in_xml_file to upgrade it in place */
+    const char *version,       /* I: schema version to upgrade to */
+    bool *upgraded             /* O: was the XML file older than version? */
+);
+
+int upgrade_metadata_files
+(
+    int nfiles,                /* I: number of XML files */
+    char **in_xml_file,        /* I: XML files to be upgraded */
+    char **out_xml_file,       /* I: upgraded XML files */
+    const char *version,       /* I: schema version to upgrade to */
+    int nthreads,              /* I: number of threads upgrading the files */
+    int *file_status,          /* O: status of the upgrade of each file
+                                     (SUCCESS or ERROR); NULL if not needed */
+    Upgrade_counts_t *counts   /* O: what the upgrade did */
+);
+
+#endif
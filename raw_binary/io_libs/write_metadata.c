@@ -17,7 +17,590 @@ NOTES:
 *****************************************************************************/
 
 #include <math.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "write_metadata.h"
+#include "parse_metadata.h"
+#include "metadata_cache.h"
+#include "espa_profile.h"
+
+/* Growable in-memory buffer the XML is formatted into before it is written
+   to disk with a single write */
+typedef struct
+{
+    char *text;       /* formatted XML, not NUL terminated */
+    size_t len;       /* number of characters in text */
+    size_t size;      /* allocated size of text */
+    bool failed;      /* an allocation failed; the contents are incomplete */
+} Xml_buf_t;
+
+/* Closing elements at the end of the XML file (i.e. bands and
+   espa_metadata) */
+#define XML_CLOSING "    </bands>\n</espa_metadata>\n"
+
+/******************************************************************************
+MODULE:  xml_buf_reserve
+
+PURPOSE: Makes sure the XML buffer has room for the specified number of
+additional characters, growing it geometrically as needed.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The buffer could not be grown
+true            There is room for the additional characters
+
+NOTES:
+  1. On failure the buffer is marked as failed, so the callers don't need to
+     check every append.  The failure is reported when the buffer is written.
+******************************************************************************/
+static bool xml_buf_reserve
+(
+    Xml_buf_t *buf,             /* I/O: XML buffer */
+    size_t nchars               /* I: number of additional characters */
+)
+{
+    size_t new_size;            /* new allocated size of the buffer */
+    char *new_text = NULL;      /* reallocated buffer */
+
+    if (buf->failed)
+        return (false);
+    if (buf->len + nchars <= buf->size)
+        return (true);
+
+    new_size = buf->size > 0 ? buf->size : XML_BUF_SIZE;
+    while (new_size < buf->len + nchars)
+        new_size *= 2;
+    new_text = realloc (buf->text, new_size);
+    if (new_text == NULL)
+    {
+        buf->failed = true;
+        return (false);
+    }
+    buf->text = new_text;
+    buf->size = new_size;
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  xml_buf_add
+
+PURPOSE: Appends a string to the XML buffer.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void xml_buf_add
+(
+    Xml_buf_t *buf,             /* I/O: XML buffer */
+    const char *str             /* I: string to be appended */
+)
+{
+    size_t nchars = strlen (str);  /* number of characters in the string */
+
+    if (!xml_buf_reserve (buf, nchars))
+        return;
+    memcpy (&buf->text[buf->len], str, nchars);
+    buf->len += nchars;
+}
+
+
+/******************************************************************************
+MODULE:  xml_buf_add_long
+
+PURPOSE: Appends the decimal representation of a long integer to the XML
+buffer.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. This produces the same characters as the "%ld" format, without going
+     through the printf machinery for each histogram bin.
+******************************************************************************/
+static void xml_buf_add_long
+(
+    Xml_buf_t *buf,             /* I/O: XML buffer */
+    long value                  /* I: value to be appended */
+)
+{
+    char digits[24];            /* digits of the value, last digit first */
+    int ndigits = 0;            /* number of digits */
+    unsigned long mag;          /* magnitude of the value */
+
+    if (!xml_buf_reserve (buf, sizeof (digits)))
+        return;
+
+    if (value < 0)
+    {
+        buf->text[buf->len++] = '-';
+        mag = 0UL - (unsigned long) value;
+    }
+    else
+        mag = (unsigned long) value;
+
+    do
+    {
+        digits[ndigits++] = (char) ('0' + mag % 10);
+        mag /= 10;
+    } while (mag > 0);
+
+    while (ndigits > 0)
+        buf->text[buf->len++] = digits[--ndigits];
+}
+
+
+/******************************************************************************
+MODULE:  xml_buf_printf
+
+PURPOSE: Appends printf-style formatted text to the XML buffer.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The text is formatted directly into the buffer; the buffer is only
+     grown and the text reformatted when it doesn't fit.
+******************************************************************************/
+static void xml_buf_printf
+(
+    Xml_buf_t *buf,             /* I/O: XML buffer */
+    const char *format,         /* I: printf format */
+    ...                         /* I: values for the format */
+)
+{
+    va_list args;               /* variable argument list */
+    int nchars;                 /* number of characters formatted */
+
+    if (!xml_buf_reserve (buf, XML_BUF_SLACK))
+        return;
+
+    va_start (args, format);
+    nchars = vsnprintf (&buf->text[buf->len], buf->size - buf->len, format,
+        args);
+    va_end (args);
+    if (nchars < 0)
+    {
+        buf->failed = true;
+        return;
+    }
+
+    if ((size_t) nchars >= buf->size - buf->len)
+    {
+        /* Leave room for the terminating NUL vsnprintf writes */
+        if (!xml_buf_reserve (buf, (size_t) nchars + 1))
+            return;
+        va_start (args, format);
+        vsnprintf (&buf->text[buf->len], buf->size - buf->len, format, args);
+        va_end (args);
+    }
+    buf->len += nchars;
+}
+
+
+/******************************************************************************
+MODULE:  sync_xml_dir
+
+PURPOSE: Flushes the directory of the XML file to disk, so a file renamed into
+it survives a crash.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. A failure is only a warning, since the file itself is already in place.
+     Some file systems don't support syncing a directory.
+******************************************************************************/
+static void sync_xml_dir
+(
+    const char *xml_file        /* I: name of the XML file */
+)
+{
+    char FUNC_NAME[] = "sync_xml_dir";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char dir[PATH_MAX];         /* directory of the XML file */
+    char *cptr = NULL;          /* pointer to the last slash */
+    int fd;                     /* file descriptor of the directory */
+
+    snprintf (dir, sizeof (dir), "%s", xml_file);
+    cptr = strrchr (dir, '/');
+    if (cptr == NULL)
+        strcpy (dir, ".");
+    else if (cptr == dir)
+        cptr[1] = '\0';
+    else
+        *cptr = '\0';
+
+    fd = open (dir, O_RDONLY);
+    if (fd < 0 || fsync (fd) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Syncing the directory %s of the "
+            "XML file", dir);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    if (fd >= 0)
+        close (fd);
+}
+
+
+/******************************************************************************
+MODULE:  write_xml_buf
+
+PURPOSE: Writes the XML buffer to the specified XML file, replacing any
+existing file, and frees the buffer.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the XML file
+SUCCESS         Successfully wrote the XML file
+
+NOTES:
+  1. The XML is written with a single write to a temporary file in the same
+     directory, which is synced to disk and then renamed into place, and the
+     directory is synced after the rename.  A crash or full disk partway
+     through leaves the original XML file as it was, never a truncated one.
+     The temporary file is given the mode of the file it replaces.
+  2. The buffer is freed whether or not the write succeeds.
+  3. The writer stamp is updated after the file is in place (see
+     write_metadata_stamp).  A failure to write the stamp is only a warning.
+******************************************************************************/
+static int write_xml_buf
+(
+    Xml_buf_t *buf,             /* I: formatted XML; freed on return */
+    const char *xml_file        /* I: name of the XML file to be written */
+)
+{
+    char FUNC_NAME[] = "write_xml_buf";   /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char tmpfile[PATH_MAX];     /* temporary XML filename */
+    bool written;               /* was the whole buffer written */
+    bool replace;               /* is an existing XML file replaced */
+    FILE *fptr = NULL;          /* file pointer to the temporary XML file */
+    struct stat st;             /* status of the existing XML file */
+
+    if (buf->failed)
+    {
+        free (buf->text);
+        sprintf (errmsg, "Allocating memory to format the XML for %s",
+            xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (snprintf (tmpfile, PATH_MAX, "%s.%ld.tmp", xml_file, (long) getpid ())
+        >= PATH_MAX)
+    {
+        free (buf->text);
+        sprintf (errmsg, "XML filename is too long");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fptr = fopen (tmpfile, "w");
+    if (fptr == NULL)
+    {
+        free (buf->text);
+        sprintf (errmsg, "Opening %s for write access.", tmpfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Keep the permissions of the file being replaced */
+    replace = (stat (xml_file, &st) == 0);
+    if (replace && fchmod (fileno (fptr), st.st_mode & 07777) != 0)
+    {
+        sprintf (errmsg, "Setting the mode of %s", tmpfile);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    /* Make sure the new XML is on disk before it replaces the old one */
+    written = (fwrite (buf->text, 1, buf->len, fptr) == buf->len &&
+        fflush (fptr) == 0 && fsync (fileno (fptr)) == 0);
+    free (buf->text);
+    if (fclose (fptr) != 0 || !written || rename (tmpfile, xml_file) != 0)
+    {
+        sprintf (errmsg, "Writing the XML metadata file %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmpfile);
+        return (ERROR);
+    }
+    sync_xml_dir (xml_file);
+
+    /* Stamp the file as written by this library */
+    write_metadata_stamp ((char *) xml_file);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_band_statistics
+
+PURPOSE: Writes the statistics element of a band, if the band has statistics.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The min, max, mean, and stddev are left out if there are no valid pixels.
+******************************************************************************/
+static void write_band_statistics
+(
+    Xml_buf_t *buf,             /* I/O: XML buffer */
+    Espa_band_stats_t *stats    /* I: statistics of the band */
+)
+{
+    int j;                      /* looping variable for the bins */
+
+    if (stats->valid_pixels == ESPA_INT_META_FILL)
+        return;
+
+    xml_buf_printf (buf,
+        "            <statistics valid_pixels=\"%ld\" fill_pixels=\"%ld\" "
+        "out_of_range_pixels=\"%ld\"", stats->valid_pixels,
+        stats->fill_pixels, stats->out_of_range_pixels);
+    if (stats->valid_pixels > 0)
+        xml_buf_printf (buf, " min=\"%f\" max=\"%f\" mean=\"%f\" stddev=\"%f\"",
+            stats->min, stats->max, stats->mean, stats->stddev);
+
+    if (stats->nbins <= 0)
+    {
+        xml_buf_add (buf, "/>\n");
+        return;
+    }
+
+    xml_buf_printf (buf, ">\n"
+        "                <histogram min=\"%f\" max=\"%f\" nbins=\"%d\">",
+        stats->hist_min, stats->hist_max, stats->nbins);
+    for (j = 0; j < stats->nbins; j++)
+    {
+        if (j > 0)
+            xml_buf_add (buf, " ");
+        xml_buf_add_long (buf, stats->histogram[j]);
+    }
+    xml_buf_add (buf, "</histogram>\n"
+        "            </statistics>\n");
+}
+
+
+/******************************************************************************
+MODULE:  write_band
+
+PURPOSE: Writes the band element for a band.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The optional parameters are only written if they have been specified
+     and are not fill.
+******************************************************************************/
+static void write_band
+(
+    Xml_buf_t *buf,             /* I/O: XML buffer */
+    Espa_band_meta_t *bmeta     /* I: band metadata */
+)
+{
+    char my_dtype[STR_SIZE];    /* data type string */
+    char my_rtype[STR_SIZE];    /* resampling type string */
+    int j;                      /* looping variable */
+
+    switch (bmeta->data_type)
+    {
+        case ESPA_INT8: strcpy (my_dtype, "INT8"); break;
+        case ESPA_UINT8: strcpy (my_dtype, "UINT8"); break;
+        case ESPA_INT16: strcpy (my_dtype, "INT16"); break;
+        case ESPA_UINT16: strcpy (my_dtype, "UINT16"); break;
+        case ESPA_INT32: strcpy (my_dtype, "INT32"); break;
+        case ESPA_UINT32: strcpy (my_dtype, "UINT32"); break;
+        case ESPA_FLOAT32: strcpy (my_dtype, "FLOAT32"); break;
+        case ESPA_FLOAT64: strcpy (my_dtype, "FLOAT64"); break;
+        default: strcpy (my_dtype, "undefined"); break;
+    }
+
+    switch (bmeta->resample_method)
+    {
+        case ESPA_CC: strcpy (my_rtype, "cubic convolution"); break;
+        case ESPA_NN: strcpy (my_rtype, "nearest neighbor"); break;
+        case ESPA_BI: strcpy (my_rtype, "bilinear"); break;
+        case ESPA_NONE: strcpy (my_rtype, "none"); break;
+        default: strcpy (my_rtype, "undefined"); break;
+    }
+
+    if (!strcmp (bmeta->source, ESPA_STRING_META_FILL)) /*no source type*/
+        xml_buf_printf (buf,
+            "        <band product=\"%s\" name=\"%s\" category=\"%s\" "
+            "data_type=\"%s\" nlines=\"%d\" nsamps=\"%d\"",
+            bmeta->product, bmeta->name, bmeta->category, my_dtype,
+            bmeta->nlines, bmeta->nsamps);
+    else  /* contains a source type */
+        xml_buf_printf (buf,
+            "        <band product=\"%s\" source=\"%s\" name=\"%s\" "
+            "category=\"%s\" data_type=\"%s\" nlines=\"%d\" nsamps=\"%d\"",
+            bmeta->product, bmeta->source, bmeta->name,
+            bmeta->category, my_dtype, bmeta->nlines, bmeta->nsamps);
+
+    if (bmeta->fill_value != ESPA_INT_META_FILL)
+        xml_buf_printf (buf, " fill_value=\"%ld\"", bmeta->fill_value);
+    if (bmeta->saturate_value != ESPA_INT_META_FILL)
+        xml_buf_printf (buf, " saturate_value=\"%d\"",
+            bmeta->saturate_value);
+    if (fabs (bmeta->scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        xml_buf_printf (buf, " scale_factor=\"%f\"", bmeta->scale_factor);
+    if (fabs (bmeta->add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        xml_buf_printf (buf, " add_offset=\"%f\"", bmeta->add_offset);
+    xml_buf_add (buf, ">\n");
+
+    xml_buf_printf (buf,
+        "            <short_name>%s</short_name>\n"
+        "            <long_name>%s</long_name>\n"
+        "            <file_name>%s</file_name>\n"
+        "            <pixel_size x=\"%g\" y=\"%g\" units=\"%s\"/>\n"
+        "            <resample_method>%s</resample_method>\n",
+        bmeta->short_name, bmeta->long_name, bmeta->file_name,
+        bmeta->pixel_size[0], bmeta->pixel_size[1],
+        bmeta->pixel_units, my_rtype);
+
+    if (bmeta->sub_sample.factor > 1)
+        xml_buf_printf (buf,
+            "            <sub_sample factor=\"%d\" nlines=\"%d\" "
+            "nsamps=\"%d\"/>\n", bmeta->sub_sample.factor,
+            bmeta->sub_sample.nlines, bmeta->sub_sample.nsamps);
+
+    if (bmeta->constant.is_constant)
+    {
+        xml_buf_printf (buf, "            <constant value=\"%.15g\"",
+            bmeta->constant.value);
+        if (bmeta->constant.fill_band[0] != '\0')
+            xml_buf_printf (buf, " fill_band=\"%s\"",
+                bmeta->constant.fill_band);
+        xml_buf_add (buf, "/>\n");
+    }
+
+    if (bmeta->derived.is_derived)
+        xml_buf_printf (buf,
+            "            <derived expression=\"%s\"/>\n",
+            bmeta->derived.expression);
+
+    if (bmeta->tiling.is_tiled)
+        xml_buf_printf (buf,
+            "            <tiling nlines=\"%d\" nsamps=\"%d\"/>\n",
+            bmeta->tiling.nlines, bmeta->tiling.nsamps);
+
+    if (strcmp (bmeta->data_units, ESPA_STRING_META_FILL))
+        xml_buf_printf (buf,
+            "            <data_units>%s</data_units>\n",
+            bmeta->data_units);
+
+    if (fabs (bmeta->valid_range[0] - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON &&
+        fabs (bmeta->valid_range[1] - ESPA_FLOAT_META_FILL) >
+        ESPA_EPSILON)
+    {
+        xml_buf_printf (buf,
+            "            <valid_range min=\"%f\" max=\"%f\"/>\n",
+            bmeta->valid_range[0], bmeta->valid_range[1]);
+    }
+
+    if (fabs (bmeta->rad_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->rad_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+    {
+        xml_buf_printf (buf,
+            "            <radiance gain=\"%.5g\" bias=\"%.5g\"/>\n",
+            bmeta->rad_gain, bmeta->rad_bias);
+    }
+
+    if (fabs (bmeta->refl_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->refl_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+    {
+        xml_buf_printf (buf,
+            "            <reflectance gain=\"%.5g\" bias=\"%.5g\"/>\n",
+            bmeta->refl_gain, bmeta->refl_bias);
+    }
+
+    if (fabs (bmeta->k1_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->k2_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+    {
+        xml_buf_printf (buf,
+            "            <thermal_const k1=\"%.2f\" k2=\"%.2f\"/>\n",
+            bmeta->k1_const, bmeta->k2_const);
+    }
+
+    if (bmeta->nbits != ESPA_INT_META_FILL && bmeta->nbits > 0)
+    {
+        xml_buf_add (buf,
+            "            <bitmap_description>\n");
+        for (j = 0; j < bmeta->nbits; j++)
+        {
+            xml_buf_printf (buf,
+                "                <bit num=\"%d\">%s</bit>\n",
+                j, bmeta->bitmap_description[j]);
+        }
+        xml_buf_add (buf,
+            "            </bitmap_description>\n");
+    }
+
+    if (bmeta->nclass != ESPA_INT_META_FILL && bmeta->nclass > 0)
+    {
+        xml_buf_add (buf,
+            "            <class_values>\n");
+        for (j = 0; j < bmeta->nclass; j++)
+        {
+            xml_buf_printf (buf,
+                "                <class num=\"%d\">%s</class>\n",
+                bmeta->class_values[j].class,
+                bmeta->class_values[j].description);
+        }
+        xml_buf_add (buf,
+            "            </class_values>\n");
+    }
+
+    if (strcmp (bmeta->qa_desc, ESPA_STRING_META_FILL))
+        xml_buf_printf (buf,
+            "            <qa_description>%s"
+            "            </qa_description>\n", bmeta->qa_desc);
+
+    if (bmeta->ncover != ESPA_FLOAT_META_FILL && bmeta->ncover > 0)
+    {
+        xml_buf_add (buf,
+            "            <percent_coverage>\n");
+        for (j = 0; j < bmeta->ncover; j++)
+        {
+            xml_buf_printf (buf,
+                "                <cover type=\"%s\">%.2f</cover>\n",
+                bmeta->percent_cover[j].description,
+                bmeta->percent_cover[j].percent);
+        }
+        xml_buf_add (buf,
+            "            </percent_coverage>\n");
+    }
+
+    write_band_statistics (buf, &bmeta->stats);
+    if (bmeta->checksum[0] != '\0')
+        xml_buf_printf (buf,
+            "            <checksum type=\"%s\">%s</checksum>\n",
+            ESPA_CHECKSUM_TYPE, bmeta->checksum);
+
+    if (bmeta->provenance.stage[0] != '\0')
+        xml_buf_printf (buf,
+            "            <provenance stage=\"%s\" key=\"%s\"/>\n",
+            bmeta->provenance.stage, bmeta->provenance.key);
+
+    xml_buf_printf (buf,
+        "            <app_version>%s</app_version>\n"
+        "            <production_date>%s</production_date>\n"
+        "        </band>\n",
+        bmeta->app_version, bmeta->production_date);
+}
+
 
 /******************************************************************************
 MODULE:  write_metadata
@@ -37,6 +620,9 @@ NOTES:
      existing metadata file, use append_metadata.
   3. It is recommended that validate_meta be used after writing the XML file
      to make sure the new file is valid against the ESPA schema.
+  4. The XML is formatted in memory and written all at once, so an existing
+     file is only replaced by a complete one (see write_xml_buf).
+  5. Band details left out by parse_metadata_lazy are loaded first.
 ******************************************************************************/
 int write_metadata
 (
@@ -46,30 +632,24 @@ int write_metadata
                                            be written to or overwritten */
 )
 {
-    char FUNC_NAME[] = "write_metadata";       /* function name */
-    char errmsg[STR_SIZE];   /* error message */
     char myproj[STR_SIZE];   /* projection type string */
     char mydatum[STR_SIZE];  /* datum string */
-    char my_dtype[STR_SIZE]; /* data type string */
-    char my_rtype[STR_SIZE]; /* resampling type string */
-    int i, j;                /* looping variables */
-    FILE *fptr = NULL;       /* file pointer to the XML metadata file */
+    int i;                   /* looping variable */
+    Xml_buf_t xbuf = {NULL, 0, 0, false};  /* buffer for the formatted XML */
     Espa_global_meta_t *gmeta = &metadata->global;  /* pointer to the global
                                                        metadata structure */
     Espa_band_meta_t *bmeta = metadata->band;  /* pointer to the array of
                                                   bands metadata */
+    ESPA_PROFILE_SCOPE ("write_metadata");
 
-    /* Open the metadata XML file for write or rewrite privelages */
-    fptr = fopen (xml_file, "w");
-    if (fptr == NULL)
-    {
-        sprintf (errmsg, "Opening %s for write access.", xml_file);
-        error_handler (true, FUNC_NAME, errmsg);
+    /* Load any band details left out by parse_metadata_lazy */
+    if (load_band_details (metadata) != SUCCESS)
+    {  /* Error messages already written */
         return (ERROR);
     }
 
     /* Write the overall header */
-    fprintf (fptr,
+    xml_buf_printf (&xbuf,
         "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n"
         "<espa_metadata version=\"%s\"\n"
         "xmlns=\"%s\"\n"
@@ -78,7 +658,7 @@ int write_metadata
         ESPA_SCHEMA_LOCATION, ESPA_SCHEMA);
 
     /* Write the global metadata */
-    fprintf (fptr,
+    xml_buf_printf (&xbuf,
         "    <global_metadata>\n"
         "        <data_provider>%s</data_provider>\n"
         "        <satellite>%s</satellite>\n"
@@ -86,53 +666,53 @@ int write_metadata
         gmeta->data_provider, gmeta->satellite, gmeta->instrument);
 
     if (strcmp (gmeta->acquisition_date, ESPA_STRING_META_FILL))
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <acquisition_date>%s</acquisition_date>\n",
         gmeta->acquisition_date);
 
     if (strcmp (gmeta->scene_center_time, ESPA_STRING_META_FILL))
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <scene_center_time>%s</scene_center_time>\n",
         gmeta->scene_center_time);
 
     if (strcmp (gmeta->level1_production_date, ESPA_STRING_META_FILL))
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <level1_production_date>%s</level1_production_date>\n",
         gmeta->level1_production_date);
 
     if (fabs (gmeta->solar_azimuth - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
         fabs (gmeta->solar_zenith - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <solar_angles zenith=\"%f\" azimuth=\"%f\" units=\"%s\"/>\n",
         gmeta->solar_zenith, gmeta->solar_azimuth, gmeta->solar_units);
 
     if (fabs (gmeta->earth_sun_dist - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <earth_sun_distance>%f</earth_sun_distance>\n",
         gmeta->earth_sun_dist);
 
     if (gmeta->wrs_system != ESPA_INT_META_FILL)
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <wrs system=\"%d\" path=\"%d\" row=\"%d\"/>\n",
         gmeta->wrs_system, gmeta->wrs_path, gmeta->wrs_row);
 
     if (gmeta->htile != ESPA_INT_META_FILL &&
         gmeta->vtile != ESPA_INT_META_FILL)
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <modis htile=\"%d\" vtile=\"%d\"/>\n",
         gmeta->htile, gmeta->vtile);
 
     if (strcmp (gmeta->product_id, ESPA_STRING_META_FILL))
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <product_id>%s</product_id>\n", gmeta->product_id);
 
     if (strcmp (gmeta->lpgs_metadata_file, ESPA_STRING_META_FILL))
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
         "        <lpgs_metadata_file>%s</lpgs_metadata_file>\n",
         gmeta->lpgs_metadata_file);
 
     /* Write the global metadata - corners and bounding coords */
-    fprintf (fptr,
+    xml_buf_printf (&xbuf,
         "        <corner location=\"UL\" latitude=\"%lf\" longitude=\"%lf\"/>\n"
         "        <corner location=\"LR\" latitude=\"%lf\" longitude=\"%lf\"/>\n"
         "        <bounding_coordinates>\n"
@@ -164,18 +744,18 @@ int write_metadata
             case ESPA_NAD27: strcpy (mydatum, "NAD27"); break;
             case ESPA_NAD83: strcpy (mydatum, "NAD83"); break;
         }
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
             "        <projection_information projection=\"%s\" datum=\"%s\" "
             "units=\"%s\">\n", myproj, mydatum,
             gmeta->proj_info.units);
     }
     else
     {
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
             "        <projection_information projection=\"%s\" units=\"%s\">\n",
             myproj, gmeta->proj_info.units);
     }
-    fprintf (fptr,
+    xml_buf_printf (&xbuf,
         "            <corner_point location=\"UL\" x=\"%lf\" y=\"%lf\"/>\n"
         "            <corner_point location=\"LR\" x=\"%lf\" y=\"%lf\"/>\n"
         "            <grid_origin>%s</grid_origin>\n",
@@ -186,7 +766,7 @@ int write_metadata
     /* UTM-specific parameters */
     if (gmeta->proj_info.proj_type == GCTP_UTM_PROJ)
     {
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
             "            <utm_proj_params>\n"
             "                <zone_code>%d</zone_code>\n"
             "            </utm_proj_params>\n",
@@ -196,7 +776,7 @@ int write_metadata
     /* ALBERS-specific parameters */
     if (gmeta->proj_info.proj_type == GCTP_ALBERS_PROJ)
     {
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
             "            <albers_proj_params>\n"
             "                <standard_parallel1>%lf</standard_parallel1>\n"
             "                <standard_parallel2>%lf</standard_parallel2>\n"
@@ -214,7 +794,7 @@ int write_metadata
     /* PS-specific parameters */
     if (gmeta->proj_info.proj_type == GCTP_PS_PROJ)
     {
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
             "            <ps_proj_params>\n"
             "                <longitude_pole>%lf</longitude_pole>\n"
             "                <latitude_true_scale>%lf</latitude_true_scale>\n"
@@ -229,7 +809,7 @@ int write_metadata
     /* SIN-specific parameters */
     if (gmeta->proj_info.proj_type == GCTP_SIN_PROJ)
     {
-        fprintf (fptr,
+        xml_buf_printf (&xbuf,
             "            <sin_proj_params>\n"
             "                <sphere_radius>%lf</sphere_radius>\n"
             "                <central_meridian>%lf</central_meridian>\n"
@@ -240,184 +820,37 @@ int write_metadata
             gmeta->proj_info.false_easting, gmeta->proj_info.false_northing);
     }
 
-    fprintf (fptr,
+    xml_buf_add (&xbuf,
         "        </projection_information>\n");
 
     /* Continue with the global metadata */
-    fprintf (fptr,
+    xml_buf_printf (&xbuf,
         "        <orientation_angle>%f</orientation_angle>\n",
             gmeta->orientation_angle);
 
-    fprintf (fptr,
+    if (strcmp (gmeta->valid_mask, ESPA_STRING_META_FILL))
+        xml_buf_printf (&xbuf,
+            "        <valid_mask>%s</valid_mask>\n", gmeta->valid_mask);
+
+    xml_buf_add (&xbuf,
         "    </global_metadata>\n\n");
 
     /* Write the bands metadata */
-    fprintf (fptr,
+    xml_buf_add (&xbuf,
         "    <bands>\n");
 
-    /* Write the bands themselves.  Make sure the optional parameters have
-       been specified and are not fill, otherwise don't write them out. */
+    /* Write the bands themselves */
     for (i = 0; i < metadata->nbands; i++)
-    {
-        switch (bmeta[i].data_type)
-        {
-            case ESPA_INT8: strcpy (my_dtype, "INT8"); break;
-            case ESPA_UINT8: strcpy (my_dtype, "UINT8"); break;
-            case ESPA_INT16: strcpy (my_dtype, "INT16"); break;
-            case ESPA_UINT16: strcpy (my_dtype, "UINT16"); break;
-            case ESPA_INT32: strcpy (my_dtype, "INT32"); break;
-            case ESPA_UINT32: strcpy (my_dtype, "UINT32"); break;
-            case ESPA_FLOAT32: strcpy (my_dtype, "FLOAT32"); break;
-            case ESPA_FLOAT64: strcpy (my_dtype, "FLOAT64"); break;
-            default: strcpy (my_dtype, "undefined"); break;
-        }
-
-        switch (bmeta[i].resample_method)
-        {
-            case ESPA_CC: strcpy (my_rtype, "cubic convolution"); break;
-            case ESPA_NN: strcpy (my_rtype, "nearest neighbor"); break;
-            case ESPA_BI: strcpy (my_rtype, "bilinear"); break;
-            case ESPA_NONE: strcpy (my_rtype, "none"); break;
-            default: strcpy (my_rtype, "undefined"); break;
-        }
-
-        if (!strcmp (bmeta[i].source, ESPA_STRING_META_FILL)) /*no source type*/
-            fprintf (fptr,
-                "        <band product=\"%s\" name=\"%s\" category=\"%s\" "
-                "data_type=\"%s\" nlines=\"%d\" nsamps=\"%d\"",
-                bmeta[i].product, bmeta[i].name, bmeta[i].category, my_dtype,
-                bmeta[i].nlines, bmeta[i].nsamps);
-        else  /* contains a source type */
-            fprintf (fptr,
-                "        <band product=\"%s\" source=\"%s\" name=\"%s\" "
-                "category=\"%s\" data_type=\"%s\" nlines=\"%d\" nsamps=\"%d\"",
-                bmeta[i].product, bmeta[i].source, bmeta[i].name,
-                bmeta[i].category, my_dtype, bmeta[i].nlines, bmeta[i].nsamps);
-
-        if (bmeta[i].fill_value != ESPA_INT_META_FILL)
-            fprintf (fptr, " fill_value=\"%ld\"", bmeta[i].fill_value);
-        if (bmeta[i].saturate_value != ESPA_INT_META_FILL)
-            fprintf (fptr, " saturate_value=\"%d\"",
-            bmeta[i].saturate_value);
-        if (fabs (bmeta[i].scale_factor-ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-            fprintf (fptr, " scale_factor=\"%f\"", bmeta[i].scale_factor);
-        if (fabs (bmeta[i].add_offset-ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-            fprintf (fptr, " add_offset=\"%f\"", bmeta[i].add_offset);
-        fprintf (fptr, ">\n");
-
-        fprintf (fptr,
-            "            <short_name>%s</short_name>\n"
-            "            <long_name>%s</long_name>\n"
-            "            <file_name>%s</file_name>\n"
-            "            <pixel_size x=\"%g\" y=\"%g\" units=\"%s\"/>\n"
-            "            <resample_method>%s</resample_method>\n",
-            bmeta[i].short_name, bmeta[i].long_name, bmeta[i].file_name,
-            bmeta[i].pixel_size[0], bmeta[i].pixel_size[1],
-            bmeta[i].pixel_units, my_rtype);
-
-        if (strcmp (bmeta[i].data_units, ESPA_STRING_META_FILL))
-            fprintf (fptr,
-                "            <data_units>%s</data_units>\n",
-                bmeta[i].data_units);
-
-        if (fabs (bmeta[i].valid_range[0] - ESPA_FLOAT_META_FILL) >
-            ESPA_EPSILON &&
-            fabs (bmeta[i].valid_range[1] - ESPA_FLOAT_META_FILL) >
-            ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <valid_range min=\"%f\" max=\"%f\"/>\n",
-                bmeta[i].valid_range[0], bmeta[i].valid_range[1]);
-        }
-
-        if (fabs (bmeta[i].rad_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
-            fabs (bmeta[i].rad_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <radiance gain=\"%.5g\" bias=\"%.5g\"/>\n",
-                bmeta[i].rad_gain, bmeta[i].rad_bias);
-        }
-
-        if (fabs (bmeta[i].refl_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
-            fabs (bmeta[i].refl_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <reflectance gain=\"%.5g\" bias=\"%.5g\"/>\n",
-                bmeta[i].refl_gain, bmeta[i].refl_bias);
-        }
-
-        if (fabs (bmeta[i].k1_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
-            fabs (bmeta[i].k2_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <thermal_const k1=\"%.2f\" k2=\"%.2f\"/>\n",
-                bmeta[i].k1_const, bmeta[i].k2_const);
-        }
-
-        if (bmeta[i].nbits != ESPA_INT_META_FILL && bmeta[i].nbits > 0)
-        {
-            fprintf (fptr,
-                "            <bitmap_description>\n");
-            for (j = 0; j < bmeta[i].nbits; j++)
-            {
-                fprintf (fptr,
-                    "                <bit num=\"%d\">%s</bit>\n",
-                    j, bmeta[i].bitmap_description[j]);
-            }
-            fprintf (fptr,
-                "            </bitmap_description>\n");
-        }
-
-        if (bmeta[i].nclass != ESPA_INT_META_FILL && bmeta[i].nclass > 0)
-        {
-            fprintf (fptr,
-                "            <class_values>\n");
-            for (j = 0; j < bmeta[i].nclass; j++)
-            {
-                fprintf (fptr,
-                    "                <class num=\"%d\">%s</class>\n",
-                     bmeta[i].class_values[j].class,
-                     bmeta[i].class_values[j].description);
-            }
-            fprintf (fptr,
-                "            </class_values>\n");
-        }
-
-        if (strcmp (bmeta[i].qa_desc, ESPA_STRING_META_FILL))
-            fprintf (fptr,
-                "            <qa_description>%s"
-                "            </qa_description>\n", bmeta[i].qa_desc);
-
-        if (bmeta[i].ncover != ESPA_FLOAT_META_FILL && bmeta[i].ncover > 0)
-        {
-            fprintf (fptr,
-                "            <percent_coverage>\n");
-            for (j = 0; j < bmeta[i].ncover; j++)
-            {
-                fprintf (fptr,
-                    "                <cover type=\"%s\">%.2f</cover>\n",
-                     bmeta[i].percent_cover[j].description,
-                     bmeta[i].percent_cover[j].percent);
-            }
-            fprintf (fptr,
-                "            </percent_coverage>\n");
-        }
-
-        fprintf (fptr,
-            "            <app_version>%s</app_version>\n"
-            "            <production_date>%s</production_date>\n"
-            "        </band>\n",
-            bmeta[i].app_version, bmeta[i].production_date);
-    }
+        write_band (&xbuf, &bmeta[i]);
 
     /* Finish it off */
-    fprintf (fptr,
-        "    </bands>\n");
-    fprintf (fptr,
-        "</espa_metadata>\n");
+    xml_buf_add (&xbuf, XML_CLOSING);
 
-    /* Close the XML file */
-    fclose (fptr);
+    /* Write the XML file, replacing it if it already exists */
+    if (write_xml_buf (&xbuf, xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
 
     /* Successful generation */
     return (SUCCESS);
@@ -425,9 +858,10 @@ int write_metadata
 
 
 /******************************************************************************
-MODULE:  append_metadata
+MODULE:  rewrite_append
 
-PURPOSE: Append additional bands to an existing metadata file
+PURPOSE: Appends formatted bands to an existing metadata file by rewriting
+the whole file.
 
 RETURN VALUE:
 Type = int
@@ -437,248 +871,256 @@ ERROR           Error appending the metadata file
 SUCCESS         Successfully appended to the metadata file
 
 NOTES:
-  1. If the XML file specified already exists, it will be overwritten.
-  2. Use this routine to append bands to and existing metadata file, use
-     write_metadata to create a new metadata file.
-  3. It is recommended that validate_meta be used after appending to the XML
-     file to make sure the new file is valid against the ESPA schema.
+  1. The existing XML is read into memory and the new bands replace its
+     closing </bands> line and everything after it.  The whole file is then
+     replaced at once (see write_xml_buf), so an error partway through
+     leaves the original XML file as it was.
+  2. The bands buffer is freed whether or not the append succeeds.
 ******************************************************************************/
-int append_metadata
+static int rewrite_append
 (
-    int nbands,               /* I: number of bands to be appended */
-    Espa_band_meta_t *bmeta,  /* I: pointer to the array of bands metadata
-                                    containing nbands */
+    Xml_buf_t *bands,         /* I: formatted bands and closing elements;
+                                    freed on return */
     char *xml_file            /* I: name of the XML metadata file for appending
-                                    the bands in bmeta */
+                                    the bands */
 )
 {
-    char FUNC_NAME[] = "append_metadata";       /* function name */
+    char FUNC_NAME[] = "rewrite_append";        /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    char my_dtype[STR_SIZE]; /* data type string */
-    char my_rtype[STR_SIZE]; /* resampling type string */
-    char linebuf[MAX_LINE_SIZE];  /* buffer to hold each line */
-    char *cur_ptr;           /* pointer index in the line buffer */
-    int i, j;                /* looping variables */
+    char *cur_ptr;           /* pointer to the current line in the XML */
+    char *end_ptr;           /* pointer to the end of the XML */
+    char *next_ptr;          /* pointer to the start of the next line */
+    long file_size;          /* size of the existing XML file */
     FILE *fptr = NULL;       /* file pointer to the XML metadata file */
-    fpos_t cur_pos;          /* current position in the file */
+    Xml_buf_t xbuf = {NULL, 0, 0, false};  /* buffer for the formatted XML */
 
-    /* Open the metadata XML file for write or rewrite privelages */
-    fptr = fopen (xml_file, "r+");
+    /* Read the existing metadata XML file into the buffer */
+    fptr = fopen (xml_file, "r");
     if (fptr == NULL)
     {
-        sprintf (errmsg, "Opening %s for write access.", xml_file);
+        free (bands->text);
+        sprintf (errmsg, "Opening %s for read access.", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (fseek (fptr, 0, SEEK_END) != 0 || (file_size = ftell (fptr)) < 0 ||
+        fseek (fptr, 0, SEEK_SET) != 0 ||
+        !xml_buf_reserve (&xbuf, (size_t) file_size + XML_BUF_SLACK) ||
+        fread (xbuf.text, 1, file_size, fptr) != (size_t) file_size)
+    {
+        fclose (fptr);
+        free (xbuf.text);
+        free (bands->text);
+        sprintf (errmsg, "Reading the XML metadata file %s", xml_file);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    fclose (fptr);
+    xbuf.len = file_size;
 
-    /* Skip through the XML file looking for the closing </bands> element.
+    /* Skip through the XML looking for the closing </bands> element.
        That's where we want to append the new bands and then close everything
        off (i.e. bands and espa_metadata). Note, if the closing </bands>
        element is not found in the XML file, then the bands will simply be
        appended at the end of the XML file. This will likely leave an XML
        file which does not validate against the ESPA schema, but the input
        XML likely didn't validate either in this case. */
-    if (fgetpos (fptr, &cur_pos) == -1)
-    {
-        sprintf (errmsg, "Getting the current position in the XML fstream.");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-    while (fgets (linebuf, MAX_LINE_SIZE, fptr))
+    end_ptr = xbuf.text + xbuf.len;
+    for (next_ptr = xbuf.text; next_ptr < end_ptr; )
     {
         /* Skip past the front end white space from proper indentation in
            the metadata file */
-        cur_ptr = linebuf;
-        while (cur_ptr[0] == ' ' || cur_ptr[0] == '\t')
+        cur_ptr = next_ptr;
+        while (cur_ptr < end_ptr && (cur_ptr[0] == ' ' || cur_ptr[0] == '\t'))
             cur_ptr++;
-        if (!strncmp (cur_ptr, "</bands>", 8))
+        if (end_ptr - cur_ptr >= 8 && !strncmp (cur_ptr, "</bands>", 8))
         {
-            /* </bands> line was found.  Now seek back to the beginning of
-               that line in the file. */
-            if (fsetpos (fptr, &cur_pos) == -1)
-            {
-                sprintf (errmsg, "Setting current position in the XML fstream "
-                    "to the start of the </bands> line.");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-
-            /* Clear the while loop */
+            /* </bands> line was found.  Drop it and everything after it. */
+            xbuf.len = next_ptr - xbuf.text;
             break;
         }
 
-        /* Store the location of the current stream so we can get back here */
-        if (fgetpos (fptr, &cur_pos) == -1)
-        {
-            sprintf (errmsg, "Getting current position in the XML fstream.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        /* Move to the start of the next line */
+        cur_ptr = memchr (cur_ptr, '\n', end_ptr - cur_ptr);
+        next_ptr = (cur_ptr == NULL) ? end_ptr : cur_ptr + 1;
     }
 
-    /* Append the new bands.  Make sure the optional parameters have been
-       specified and are not fill, otherwise don't write them out. */
-    for (i = 0; i < nbands; i++)
+    /* Append the new bands and closing elements */
+    if (xml_buf_reserve (&xbuf, bands->len))
     {
-        switch (bmeta[i].data_type)
-        {
-            case ESPA_INT8: strcpy (my_dtype, "INT8"); break;
-            case ESPA_UINT8: strcpy (my_dtype, "UINT8"); break;
-            case ESPA_INT16: strcpy (my_dtype, "INT16"); break;
-            case ESPA_UINT16: strcpy (my_dtype, "UINT16"); break;
-            case ESPA_INT32: strcpy (my_dtype, "INT32"); break;
-            case ESPA_UINT32: strcpy (my_dtype, "UINT32"); break;
-            case ESPA_FLOAT32: strcpy (my_dtype, "FLOAT32"); break;
-            case ESPA_FLOAT64: strcpy (my_dtype, "FLOAT64"); break;
-            default: strcpy (my_dtype, "undefined"); break;
-        }
+        memcpy (&xbuf.text[xbuf.len], bands->text, bands->len);
+        xbuf.len += bands->len;
+    }
+    free (bands->text);
 
-        switch (bmeta[i].resample_method)
-        {
-            case ESPA_CC: strcpy (my_rtype, "cubic convolution"); break;
-            case ESPA_NN: strcpy (my_rtype, "nearest neighbor"); break;
-            case ESPA_BI: strcpy (my_rtype, "bilinear"); break;
-            case ESPA_NONE: strcpy (my_rtype, "none"); break;
-            default: strcpy (my_rtype, "undefined"); break;
-        }
+    /* Replace the XML file */
+    if (write_xml_buf (&xbuf, xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
 
-        if (!strcmp (bmeta[i].source, ESPA_STRING_META_FILL)) /*no source type*/
-            fprintf (fptr,
-                "        <band product=\"%s\" name=\"%s\" category=\"%s\" "
-                "data_type=\"%s\" nlines=\"%d\" nsamps=\"%d\"",
-                bmeta[i].product, bmeta[i].name, bmeta[i].category, my_dtype,
-                bmeta[i].nlines, bmeta[i].nsamps);
-        else  /* contains a source type */
-            fprintf (fptr,
-                "        <band product=\"%s\" source=\"%s\" name=\"%s\" "
-                "category=\"%s\" data_type=\"%s\" nlines=\"%d\" nsamps=\"%d\"",
-                bmeta[i].product, bmeta[i].source, bmeta[i].name,
-                bmeta[i].category, my_dtype, bmeta[i].nlines, bmeta[i].nsamps);
-
-        if (bmeta[i].fill_value != ESPA_INT_META_FILL)
-            fprintf (fptr, " fill_value=\"%ld\"", bmeta[i].fill_value);
-        if (bmeta[i].saturate_value != ESPA_INT_META_FILL)
-            fprintf (fptr, " saturate_value=\"%d\"",
-            bmeta[i].saturate_value);
-        if (fabs (bmeta[i].scale_factor - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-            fprintf (fptr, " scale_factor=\"%f\"", bmeta[i].scale_factor);
-        if (fabs (bmeta[i].add_offset - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-            fprintf (fptr, " add_offset=\"%f\"", bmeta[i].add_offset);
-        fprintf (fptr, ">\n");
-
-        fprintf (fptr,
-            "            <short_name>%s</short_name>\n"
-            "            <long_name>%s</long_name>\n"
-            "            <file_name>%s</file_name>\n"
-            "            <pixel_size x=\"%g\" y=\"%g\" units=\"%s\"/>\n"
-            "            <resample_method>%s</resample_method>\n",
-            bmeta[i].short_name, bmeta[i].long_name, bmeta[i].file_name,
-            bmeta[i].pixel_size[0], bmeta[i].pixel_size[1],
-            bmeta[i].pixel_units, my_rtype);
-
-        if (strcmp (bmeta[i].data_units, ESPA_STRING_META_FILL))
-            fprintf (fptr,
-                "            <data_units>%s</data_units>\n",
-                bmeta[i].data_units);
-
-        if (fabs (bmeta[i].valid_range[0] - ESPA_FLOAT_META_FILL) >
-            ESPA_EPSILON &&
-            fabs (bmeta[i].valid_range[1] - ESPA_FLOAT_META_FILL) >
-            ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <valid_range min=\"%f\" max=\"%f\"/>\n",
-                bmeta[i].valid_range[0], bmeta[i].valid_range[1]);
-        }
+    /* Successful rewrite */
+    return (SUCCESS);
+}
 
-        if (fabs (bmeta[i].rad_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
-            fabs (bmeta[i].rad_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <radiance gain=\"%.5g\" bias=\"%.5g\"/>\n",
-                bmeta[i].rad_gain, bmeta[i].rad_bias);
-        }
 
-        if (fabs (bmeta[i].refl_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
-            fabs (bmeta[i].refl_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <reflectance gain=\"%.5g\" bias=\"%.5g\"/>\n",
-                bmeta[i].refl_gain, bmeta[i].refl_bias);
-        }
+/******************************************************************************
+MODULE:  append_in_place
 
-        if (fabs (bmeta[i].k1_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
-            fabs (bmeta[i].k2_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
-        {
-            fprintf (fptr,
-                "            <thermal_const k1=\"%.2f\" k2=\"%.2f\"/>\n",
-                bmeta[i].k1_const, bmeta[i].k2_const);
-        }
+PURPOSE: Appends formatted bands to an existing metadata file in place, if
+the file ends with the closing elements written by write_metadata.
 
-        if (bmeta[i].nbits != ESPA_INT_META_FILL && bmeta[i].nbits > 0)
-        {
-            fprintf (fptr,
-                "            <bitmap_description>\n");
-            for (j = 0; j < bmeta[i].nbits; j++)
-            {
-                fprintf (fptr,
-                    "                <bit num=\"%d\">%s</bit>\n",
-                    j, bmeta[i].bitmap_description[j]);
-            }
-            fprintf (fptr,
-                "            </bitmap_description>\n");
-        }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error appending the metadata file
+SUCCESS         The bands were appended, or the file doesn't end with the
+                expected closing elements and appended is false
 
-        if (bmeta[i].nclass != ESPA_INT_META_FILL && bmeta[i].nclass > 0)
-        {
-            fprintf (fptr,
-                "            <class_values>\n");
-            for (j = 0; j < bmeta[i].nclass; j++)
-            {
-                fprintf (fptr,
-                    "                <class num=\"%d\">%s</class>\n",
-                     bmeta[i].class_values[j].class,
-                     bmeta[i].class_values[j].description);
-            }
-            fprintf (fptr,
-                "            </class_values>\n");
-        }
+NOTES:
+  1. The closing elements are at a known offset from the end of the file, so
+     the insertion point is found without reading the rest of the XML and
+     only the new bands are written, overwriting the old closing elements.
+  2. If the write fails the file is truncated back and the closing elements
+     are restored, so the original XML is left as it was.  Unlike
+     rewrite_append, a crash during the single write itself can still leave
+     the file incomplete.
+******************************************************************************/
+static int append_in_place
+(
+    Xml_buf_t *bands,         /* I: formatted bands and closing elements */
+    char *xml_file,           /* I: name of the XML metadata file for appending
+                                    the bands */
+    bool *appended            /* O: were the bands appended */
+)
+{
+    char FUNC_NAME[] = "append_in_place";       /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tail[sizeof (XML_CLOSING)];  /* closing elements of the file */
+    size_t tail_len = sizeof (XML_CLOSING) - 1;  /* length of the closing
+                                                    elements */
+    long insert_pos;         /* offset of the closing elements in the file */
+    bool written;            /* were the new bands written */
+    FILE *fptr = NULL;       /* file pointer to the XML metadata file */
+
+    *appended = false;
+
+    /* Open the metadata XML file for update */
+    fptr = fopen (xml_file, "r+");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening %s for write access.", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-        if (strcmp (bmeta[i].qa_desc, ESPA_STRING_META_FILL))
-            fprintf (fptr,
-                "            <qa_description>%s"
-                "            </qa_description>\n", bmeta[i].qa_desc);
+    /* See if the file ends with the closing elements */
+    if (fseek (fptr, 0, SEEK_END) != 0 ||
+        (insert_pos = ftell (fptr) - (long) tail_len) < 0 ||
+        fseek (fptr, insert_pos, SEEK_SET) != 0 ||
+        fread (tail, 1, tail_len, fptr) != tail_len ||
+        memcmp (tail, XML_CLOSING, tail_len))
+    {
+        fclose (fptr);
+        return (SUCCESS);
+    }
 
-        if (bmeta[i].ncover != ESPA_FLOAT_META_FILL && bmeta[i].ncover > 0)
+    /* Overwrite the closing elements with the new bands, which end with the
+       closing elements */
+    written = (fseek (fptr, insert_pos, SEEK_SET) == 0 &&
+        fwrite (bands->text, 1, bands->len, fptr) == bands->len &&
+        fflush (fptr) == 0);
+    if (!written)
+    {
+        /* Put the original end of the file back */
+        if (fseek (fptr, insert_pos, SEEK_SET) == 0)
+            fwrite (XML_CLOSING, 1, tail_len, fptr);
+        fflush (fptr);
+        if (ftruncate (fileno (fptr), insert_pos + tail_len) != 0)
         {
-            fprintf (fptr,
-                "            <percent_coverage>\n");
-            for (j = 0; j < bmeta[i].ncover; j++)
-            {
-                fprintf (fptr,
-                    "                <cover type=\"%s\">%.2f</cover>\n",
-                     bmeta[i].percent_cover[j].description,
-                     bmeta[i].percent_cover[j].percent);
-            }
-            fprintf (fptr,
-                "            </percent_coverage>\n");
+            sprintf (errmsg, "Restoring the end of %s", xml_file);
+            error_handler (false, FUNC_NAME, errmsg);
         }
+    }
+    if (fclose (fptr) != 0 || !written)
+    {
+        sprintf (errmsg, "Appending the bands to %s", xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *appended = true;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  append_metadata
+
+PURPOSE: Append additional bands to an existing metadata file
 
-        fprintf (fptr,
-            "            <app_version>%s</app_version>\n"
-            "            <production_date>%s</production_date>\n"
-            "        </band>\n",
-            bmeta[i].app_version, bmeta[i].production_date);
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error appending the metadata file
+SUCCESS         Successfully appended to the metadata file
+
+NOTES:
+  1. If the XML file specified already exists, it will be overwritten.
+  2. Use this routine to append bands to and existing metadata file, use
+     write_metadata to create a new metadata file.
+  3. It is recommended that validate_meta be used after appending to the XML
+     file to make sure the new file is valid against the ESPA schema.
+  4. The new bands are formatted in memory.  When the file ends with the
+     closing elements written by write_metadata, only the new bands are
+     written (see append_in_place), so the cost doesn't grow with the size of
+     the existing XML.  Otherwise the whole file is rewritten (see
+     rewrite_append).
+******************************************************************************/
+int append_metadata
+(
+    int nbands,               /* I: number of bands to be appended */
+    Espa_band_meta_t *bmeta,  /* I: pointer to the array of bands metadata
+                                    containing nbands */
+    char *xml_file            /* I: name of the XML metadata file for appending
+                                    the bands in bmeta */
+)
+{
+    int i;                   /* looping variable */
+    bool appended;           /* were the bands appended in place */
+    Xml_buf_t xbuf = {NULL, 0, 0, false};  /* buffer for the formatted bands */
+
+    /* Format the new bands and close everything off (i.e. bands and
+       espa_metadata) */
+    for (i = 0; i < nbands; i++)
+        write_band (&xbuf, &bmeta[i]);
+    xml_buf_add (&xbuf, XML_CLOSING);
+    if (xbuf.failed)
+    {  /* Let write_xml_buf report the allocation failure */
+        return (write_xml_buf (&xbuf, xml_file));
     }
 
-    /* Finish it off */
-    fprintf (fptr,
-        "    </bands>\n");
-    fprintf (fptr,
-        "</espa_metadata>\n");
+    /* Append the bands in place if possible */
+    if (append_in_place (&xbuf, xml_file, &appended) != SUCCESS)
+    {  /* Error messages already written */
+        free (xbuf.text);
+        return (ERROR);
+    }
+    if (appended)
+    {
+        free (xbuf.text);
+        write_metadata_stamp (xml_file);
+        return (SUCCESS);
+    }
 
-    /* Close the XML file */
-    fclose (fptr);
+    /* Otherwise rewrite the file with the new bands */
+    if (rewrite_append (&xbuf, xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
 
     /* Successful append */
     return (SUCCESS);
@@ -809,6 +1251,7 @@ void print_metadata_struct
 
     printf ("  orientation_angle: %f\n",
         metadata->global.orientation_angle);
+    printf ("  valid_mask: %s\n", metadata->global.valid_mask);
     printf ("\n");
 
     printf ("DEBUG Bands Metadata structure:\n");
@@ -843,6 +1286,22 @@ void print_metadata_struct
         printf ("    file_name: %s\n", metadata->band[i].file_name);
         printf ("    pixel_size (x, y) : %g %g\n",
             metadata->band[i].pixel_size[0], metadata->band[i].pixel_size[1]);
+        if (metadata->band[i].sub_sample.factor > 1)
+            printf ("    sub_sample: factor %d of %d lines x %d samples\n",
+                metadata->band[i].sub_sample.factor,
+                metadata->band[i].sub_sample.nlines,
+                metadata->band[i].sub_sample.nsamps);
+        if (metadata->band[i].constant.is_constant)
+            printf ("    constant: %.15g (fill from %s)\n",
+                metadata->band[i].constant.value,
+                metadata->band[i].constant.fill_band[0] != '\0' ?
+                metadata->band[i].constant.fill_band : "none");
+        if (metadata->band[i].derived.is_derived)
+            printf ("    derived: %s\n", metadata->band[i].derived.expression);
+        if (metadata->band[i].tiling.is_tiled)
+            printf ("    tiling: %d lines x %d samples\n",
+                metadata->band[i].tiling.nlines,
+                metadata->band[i].tiling.nsamps);
         printf ("    data_units: %s\n", metadata->band[i].data_units);
         if (metadata->band[i].valid_range[0] != 0.0 ||
             metadata->band[i].valid_range[1] != 0.0)
@@ -899,6 +1358,30 @@ void print_metadata_struct
                      metadata->band[i].percent_cover[j].percent);
             }
         }
+        if (metadata->band[i].stats.valid_pixels != ESPA_INT_META_FILL)
+        {
+            printf ("    statistics: %ld valid, %ld fill, %ld out of range "
+                "pixels\n", metadata->band[i].stats.valid_pixels,
+                metadata->band[i].stats.fill_pixels,
+                metadata->band[i].stats.out_of_range_pixels);
+            if (metadata->band[i].stats.valid_pixels > 0)
+                printf ("      min %g, max %g, mean %g, stddev %g\n",
+                    metadata->band[i].stats.min, metadata->band[i].stats.max,
+                    metadata->band[i].stats.mean,
+                    metadata->band[i].stats.stddev);
+            if (metadata->band[i].stats.nbins > 0)
+                printf ("      histogram of %d bins from %g to %g\n",
+                    metadata->band[i].stats.nbins,
+                    metadata->band[i].stats.hist_min,
+                    metadata->band[i].stats.hist_max);
+        }
+        if (metadata->band[i].checksum[0] != '\0')
+            printf ("    checksum: %s %s\n", ESPA_CHECKSUM_TYPE,
+                metadata->band[i].checksum);
+        if (metadata->band[i].provenance.stage[0] != '\0')
+            printf ("    provenance: stage %s key %s\n",
+                metadata->band[i].provenance.stage,
+                metadata->band[i].provenance.key);
         printf ("    app_version: %s\n", metadata->band[i].app_version);
         printf ("    production_date: %s\n", metadata->band[i].production_date);
         printf ("\n");
@@ -24,6 +24,13 @@ NOTES:
 /* maximum number of characters per line in the XML file */
 #define MAX_LINE_SIZE 1024
 
+/* initial size of the buffer the XML file is formatted into */
+#define XML_BUF_SIZE 65536
+
+/* free space kept in the XML buffer so most formatted elements fit without
+   growing the buffer and reformatting */
+#define XML_BUF_SLACK 1024
+
 /* Prototypes */
 int write_metadata
 (
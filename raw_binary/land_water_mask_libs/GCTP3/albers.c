@@ -0,0 +1,530 @@
+/*******************************************************************************
+Name: ALBERS CONICAL EQUAL AREA
+
+Purpose: Provides the transformations between Easting/Northing and longitude/
+    latitude for the Albers Conical Equal Area projection.  The Easting and
+    Northing values are in meters.  The longitude and latitude are in radians.
+
+Algorithm References
+
+1.  Snyder, John P., "Map Projections--A Working Manual", U.S. Geological
+    Survey Professional Paper 1395 (Supersedes USGS Bulletin 1532), United
+    State Government Printing Office, Washington D.C., 1987.
+
+2.  Snyder, John P. and Voxland, Philip M., "An Album of Map Projections",
+    U.S. Geological Survey Professional Paper 1453 , United State Government
+    Printing Office, Washington D.C., 1989.
+*******************************************************************************/
+#include <stdlib.h>
+#include "cproj.h"
+#include "gctp.h"
+#include "local.h"
+
+/* structure to hold the setup data relevant to this projection */
+struct albers_proj
+{
+    double r_major;         /* major axis */
+    double r_minor;         /* minor axis */
+    double c;               /* constant c */
+    double e3;              /* eccentricity */
+    double es;              /* eccentricity squared */
+    double rh;              /* height above ellipsoid */
+    double ns0;             /* ratio between meridians */
+    double lat1;            /* first standard parallel */
+    double lat2;            /* second standard parallel */
+    double center_lon;      /* center longitude */
+    double lat_origin;      /* center latitude */
+    double false_easting;   /* x offset in meters */
+    double false_northing;  /* y offset in meters */
+    double auth[3];         /* coefficients of the series for the latitude
+                               from the authalic latitude */
+    double qs_pole;         /* function q at the poles */
+};
+
+/*****************************************************************************
+Name: print_info
+
+Purpose: Prints a summary of information about this projection.
+
+Returns:
+    nothing
+
+*****************************************************************************/
+static void print_info
+(
+    const TRANSFORMATION *trans
+)
+{
+    struct albers_proj *cache_ptr = (struct albers_proj *)trans->cache;
+
+    gctp_print_title("ALBERS CONICAL EQUAL-AREA");
+    gctp_print_radius2(cache_ptr->r_major, cache_ptr->r_minor);
+    gctp_print_stanparl(cache_ptr->lat1, cache_ptr->lat2);
+    gctp_print_cenlonmer(cache_ptr->center_lon);
+    gctp_print_origin(cache_ptr->lat_origin);
+    gctp_print_offsetp(cache_ptr->false_easting, cache_ptr->false_northing);
+}
+
+/*******************************************************************************
+Name: common_init
+
+Purpose: Initialization routine for initializing the projection information
+    that is common to both the forward and inverse transformations.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*******************************************************************************/
+static int common_init
+(
+    TRANSFORMATION *trans   /* I/O: transformation to initialize */
+)
+{
+    double r_major;             /* major axis */
+    double r_minor;             /* minor axis */
+    double radius;
+    double lat1;                /* first standard parallel */
+    double lat2;                /* second standard parallel */
+    double center_lon;          /* center longitude */
+    double lat_origin;          /* center latitude */
+    double false_easting;       /* x offset in meters */
+    double false_northing;      /* y offset in meters */
+
+    double sin_po, cos_po;      /* sin and cos values */
+    double con;                 /* temporary variable */
+    double es, temp;            /* eccentricity squared and temp var */
+    double e3;                  /* eccentricity */
+    double ms1;                 /* small m 1 */
+    double ms2;                 /* small m 2 */
+    double qs0;                 /* small q 0 */
+    double qs1;                 /* small q 1 */
+    double qs2;                 /* small q 2 */
+
+    const GCTP_PROJECTION *proj = &trans->proj;
+    struct albers_proj *cache = NULL;
+    int spheroid = proj->spheroid;
+
+    gctp_get_spheroid(spheroid, proj->parameters, &r_major, &r_minor, &radius);
+    false_easting  = proj->parameters[6];
+    false_northing = proj->parameters[7];
+
+    if (gctp_dms2degrees(proj->parameters[2], &lat1) != GCTP_SUCCESS)
+    {
+        GCTP_PRINT_ERROR("Error converting first standard parallel in "
+            "parameter 2 from DMS to degrees: %f", proj->parameters[2]);
+        return GCTP_ERROR;
+    }
+    lat1 *= 3600 * S2R;
+
+    if (gctp_dms2degrees(proj->parameters[3], &lat2) != GCTP_SUCCESS)
+    {
+        GCTP_PRINT_ERROR("Error converting second standard parallel in "
+            "parameter 3 from DMS to degrees: %f", proj->parameters[3]);
+        return GCTP_ERROR;
+    }
+    lat2 *= 3600 * S2R;
+
+    if (gctp_dms2degrees(proj->parameters[4], &center_lon) != GCTP_SUCCESS)
+    {
+        GCTP_PRINT_ERROR("Error converting center longitude in parameter 4 "
+            "from DMS to degrees: %f", proj->parameters[4]);
+        return GCTP_ERROR;
+    }
+    center_lon *= 3600 * S2R;
+
+    if (gctp_dms2degrees(proj->parameters[5], &lat_origin) != GCTP_SUCCESS)
+    {
+        GCTP_PRINT_ERROR("Error converting center latitude in parameter 5 "
+            "from DMS to degrees: %f", proj->parameters[5]);
+        return GCTP_ERROR;
+    }
+    lat_origin *= 3600 * S2R;
+
+    if (fabs(lat1 + lat2) < EPSLN)
+    {
+        GCTP_PRINT_ERROR("Equal latitudes for Standard Parallels on opposite "
+            "sides of equator");
+        return GCTP_ERROR;
+    }
+
+    /* Allocate a structure for the cached info */
+    cache = malloc(sizeof(*cache));
+    if (!cache)
+    {
+        GCTP_PRINT_ERROR("Error allocating memory for cache buffer");
+        return GCTP_ERROR;
+    }
+    trans->cache = cache;
+
+    /* Save the information to the cache */
+    cache->r_major = r_major;
+    cache->r_minor = r_minor;
+    cache->lat1 = lat1;
+    cache->lat2 = lat2;
+    cache->center_lon = center_lon;
+    cache->lat_origin = lat_origin;
+    cache->false_northing = false_northing;
+    cache->false_easting = false_easting;
+
+    temp = r_minor / r_major;
+    es = 1.0 - SQUARE(temp);
+    e3 = sqrt(es);
+    cache->es = es;
+    cache->e3 = e3;
+
+    sincos(lat1, &sin_po, &cos_po);
+    con = sin_po;
+
+    ms1 = gctp_calc_small_radius(e3, sin_po, cos_po);
+    qs1 = qsfnz(e3, sin_po);
+
+    sincos(lat2, &sin_po, &cos_po);
+
+    ms2 = gctp_calc_small_radius(e3, sin_po, cos_po);
+    qs2 = qsfnz(e3, sin_po);
+
+    sincos(lat_origin, &sin_po, &cos_po);
+
+    qs0 = qsfnz(e3, sin_po);
+
+    if (fabs(lat1 - lat2) > EPSLN)
+        cache->ns0 = (ms1 * ms1 - ms2 * ms2) / (qs2 - qs1);
+    else
+        cache->ns0 = con;
+    cache->c = ms1 * ms1 + cache->ns0 * qs1;
+    cache->rh = r_major * sqrt(cache->c - cache->ns0 * qs0) / cache->ns0;
+
+    /* Coefficients of the series for the latitude from the authalic
+       latitude (Snyder equation 3-18), used to start the inverse iteration
+       close to the solution */
+    cache->qs_pole = qsfnz(e3, 1.0);
+    cache->auth[0] = es / 3.0 + SQUARE(es) * 31.0 / 180.0
+        + es * SQUARE(es) * 517.0 / 5040.0;
+    cache->auth[1] = SQUARE(es) * 23.0 / 360.0
+        + es * SQUARE(es) * 251.0 / 3780.0;
+    cache->auth[2] = es * SQUARE(es) * 761.0 / 45360.0;
+
+    trans->print_info = print_info;
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: albers_phi1
+
+Purpose: Computes the latitude for the inverse transformation.  This is the
+    iteration of phi1z, started from the series for the latitude from the
+    authalic latitude instead of from the spherical latitude, so it usually
+    converges in one iteration instead of three or more.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static inline int albers_phi1
+(
+    const struct albers_proj *cache_ptr, /* I: cached projection constants */
+    double qs,      /* I: function q of the latitude */
+    double *lat     /* O: Latitude */
+)
+{
+    double e3 = cache_ptr->e3;  /* eccentricity */
+    double phi;                 /* latitude */
+    double dphi;                /* change in the latitude */
+    double con, com;            /* temporary variables */
+    double sinpi, cospi;        /* sin and cos of the latitude */
+    double sin_2b, cos_2b;      /* sin and cos of twice the authalic
+                                   latitude */
+    long i;
+
+    phi = asinz(qs / cache_ptr->qs_pole);
+    sincos(2.0 * phi, &sin_2b, &cos_2b);
+    phi += sin_2b * (cache_ptr->auth[0] + cache_ptr->auth[1] * 2.0 * cos_2b
+        + cache_ptr->auth[2] * (3.0 - 4.0 * SQUARE(sin_2b)));
+
+    for (i = 1; i <= 25; i++)
+    {
+        sincos(phi, &sinpi, &cospi);
+        con = e3 * sinpi;
+        com = 1.0 - con * con;
+        dphi = .5 * com * com / cospi * (qs / (1.0 - cache_ptr->es)
+            - sinpi / com + .5 / e3 * log((1.0 - con) / (1.0 + con)));
+        phi += dphi;
+        if (fabs(dphi) <= 1e-7)
+        {
+            *lat = phi;
+            return GCTP_SUCCESS;
+        }
+    }
+
+    GCTP_PRINT_ERROR("Convergence error");
+    return GCTP_ERROR;
+}
+
+/*****************************************************************************
+Name: albers_inverse
+
+Purpose: Transforms Albers X,Y to lat,long using the cached projection
+    constants.  This is shared by the single coordinate and array transforms
+    so the array loop can be specialized with the constants kept local.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static inline int albers_inverse
+(
+    const struct albers_proj *cache_ptr, /* I: cached projection constants */
+    double x,       /* I: X projection coordinate */
+    double y,       /* I: Y projection coordinate */
+    double *lon,    /* O: Longitude */
+    double *lat     /* O: Latitude */
+)
+{
+    double rh1;     /* height above ellipsoid */
+    double qs;      /* function q */
+    double con;     /* temporary sign value */
+    double theta;   /* angle */
+    long flag;      /* error flag */
+
+    flag = 0;
+    x -= cache_ptr->false_easting;
+    y = cache_ptr->rh - y + cache_ptr->false_northing;
+    if (cache_ptr->ns0 >= 0)
+    {
+        rh1 = sqrt(x * x + y * y);
+        con = 1.0;
+    }
+    else
+    {
+        rh1 = -sqrt(x * x + y * y);
+        con = -1.0;
+    }
+    theta = 0.0;
+    if (rh1 != 0.0)
+        theta = atan2(con * x, con * y);
+    con = rh1 * cache_ptr->ns0 / cache_ptr->r_major;
+    qs = (cache_ptr->c - con * con) / cache_ptr->ns0;
+    if (cache_ptr->e3 >= 1e-10)
+    {
+        con = 1 - .5 * (1.0 - cache_ptr->es) * log((1.0 - cache_ptr->e3)
+            / (1.0 + cache_ptr->e3)) / cache_ptr->e3;
+        if (fabs(fabs(con) - fabs(qs)) > .0000000001)
+        {
+            if (albers_phi1(cache_ptr, qs, lat) != GCTP_SUCCESS)
+                return GCTP_ERROR;
+        }
+        else
+        {
+            if (qs >= 0)
+                *lat = .5 * PI;
+            else
+                *lat = -.5 * PI;
+        }
+    }
+    else
+    {
+        *lat = phi1z(cache_ptr->e3, qs, &flag);
+        if (flag != 0)
+            return GCTP_ERROR;
+    }
+    *lon = adjust_lon(theta / cache_ptr->ns0 + cache_ptr->center_lon);
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: inverse_transform
+
+Purpose: Transforms X,Y to lat,long
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int inverse_transform
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    double x,       /* I: X projection coordinate */
+    double y,       /* I: Y projection coordinate */
+    double *lon,    /* O: Longitude */
+    double *lat     /* O: Latitude */
+)
+{
+    return albers_inverse((const struct albers_proj *)trans->cache, x, y,
+        lon, lat);
+}
+
+/*****************************************************************************
+Name: inverse_transform_array
+
+Purpose: Transforms an array of Albers X,Y to lat,long in place.  The cached
+    constants are copied locally once for the whole array.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int inverse_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,      /* I: number of coordinates */
+    double *x,      /* I/O: X projection coordinates in, longitudes out */
+    double *y       /* I/O: Y projection coordinates in, latitudes out */
+)
+{
+    const struct albers_proj cache = *(const struct albers_proj *)trans->cache;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (albers_inverse(&cache, x[i], y[i], &x[i], &y[i]) != GCTP_SUCCESS)
+            return GCTP_ERROR;
+    }
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: albers_forward
+
+Purpose: Transforms lat,long to Albers X,Y using the cached projection
+    constants.  This is shared by the single coordinate and array transforms
+    so the array loop can be specialized with the constants kept local.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static inline int albers_forward
+(
+    const struct albers_proj *cache_ptr, /* I: cached projection constants */
+    double lon,         /* I: Longitude */
+    double lat,         /* I: Latitude */
+    double *x,          /* O: X projection coordinate */
+    double *y           /* O: Y projection coordinate */
+)
+{
+    double sin_phi, cos_phi;    /* sine and cos values */
+    double sin_theta, cos_theta;/* sine and cos of the angle */
+    double qs;                  /* small q */
+    double theta;               /* angle */
+    double rh1;                 /* height above ellipsoid */
+
+    sincos(lat, &sin_phi, &cos_phi);
+    qs = qsfnz(cache_ptr->e3, sin_phi);
+    rh1 = cache_ptr->r_major * sqrt(cache_ptr->c - cache_ptr->ns0 * qs)
+        / cache_ptr->ns0;
+    theta = cache_ptr->ns0 * adjust_lon(lon - cache_ptr->center_lon);
+    sincos(theta, &sin_theta, &cos_theta);
+    *x = rh1 * sin_theta + cache_ptr->false_easting;
+    *y = cache_ptr->rh - rh1 * cos_theta + cache_ptr->false_northing;
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: forward_transform
+
+Purpose: Transforms lat,long to Albers X,Y
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int forward_transform
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    double lon,         /* I: Longitude */
+    double lat,         /* I: Latitude */
+    double *x,          /* O: X projection coordinate */
+    double *y           /* O: Y projection coordinate */
+)
+{
+    return albers_forward((const struct albers_proj *)trans->cache, lon, lat,
+        x, y);
+}
+
+/*****************************************************************************
+Name: forward_transform_array
+
+Purpose: Transforms an array of lat,long to Albers X,Y in place.  The cached
+    constants are copied locally once for the whole array.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int forward_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,      /* I: number of coordinates */
+    double *x,      /* I/O: longitudes in, X projection coordinates out */
+    double *y       /* I/O: latitudes in, Y projection coordinates out */
+)
+{
+    const struct albers_proj cache = *(const struct albers_proj *)trans->cache;
+    int i;
+
+    for (i = 0; i < count; i++)
+        albers_forward(&cache, x[i], y[i], &x[i], &y[i]);
+
+    return GCTP_SUCCESS;
+}
+
+
+/*****************************************************************************
+Name: gctp_albers_inverse_init
+
+Purpose: Initializes the inverse Albers transformation
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+int gctp_albers_inverse_init
+(
+    TRANSFORMATION *trans
+)
+{
+    /* Call the common routine used for the forward and inverse init */
+    if (common_init(trans) != GCTP_SUCCESS)
+    {
+        GCTP_PRINT_ERROR(
+            "Error initializing Albers inverse projection");
+        return GCTP_ERROR;
+    }
+
+    trans->transform = inverse_transform;
+    trans->transform_array = inverse_transform_array;
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: gctp_albers_forward_init
+
+Purpose: Initializes the forward Albers transformation
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+int gctp_albers_forward_init
+(
+    TRANSFORMATION *trans
+)
+{
+    /* Call the common routine used for the forward and inverse init */
+    if (common_init(trans) != GCTP_SUCCESS)
+    {
+        GCTP_PRINT_ERROR(
+            "Error initializing Albers forward projection");
+        return GCTP_ERROR;
+    }
+
+    trans->transform = forward_transform;
+    trans->transform_array = forward_transform_array;
+
+    return GCTP_SUCCESS;
+}
@@ -137,6 +137,19 @@ int gctp_transform
     double * out_coor      /* O: array of (x, y) or (lon, lat) */
 );
 
+/* Routine to transform an array of coordinates using a transformation set up
+   by gctp_create_transformation.  The output arrays may be the same as the
+   input arrays. */
+int gctp_transform_batch
+(
+    const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,             /* I: number of coordinates */
+    const double *in_x,    /* I: array of lon or x values */
+    const double *in_y,    /* I: array of lat or y values */
+    double *out_x,         /* O: array of x or lon values */
+    double *out_y          /* O: array of y or lat values */
+);
+
 typedef enum gctp_message_type_enum
 {
     GCTP_INFO_MESSAGE,
@@ -181,4 +194,9 @@ int gctp_calc_utm_zone
 
 void gctp_only_allow_threadsafe_transforms();
 
+int gctp_is_threadsafe_transformation
+(
+    const GCTP_TRANSFORMATION *trans
+);
+
 #endif
@@ -26,7 +26,7 @@ static INIT_ROUTINE forward_init[GCTP_MAX_PROJ_CODE + 1] =
         gctp_geo_init,         /* 0 = Geographic */
         gctp_utm_forward_init, /* 1 = Universal Transverse Mercator (UTM) */
         gctp_state_plane_forward_init, /* 2 = State Plane Coordinates */
-        NULL,           /* 3 = Albers Conical Equal Area */
+        gctp_albers_forward_init, /* 3 = Albers Conical Equal Area */
         gctp_lamcc_forward_init, /* 4 = Lambert Conformal Conic */
         NULL,           /* 5 = Mercator */
         gctp_ps_forward_init,  /* 6 = Polar Stereographic */
@@ -39,7 +39,7 @@ static INIT_ROUTINE forward_init[GCTP_MAX_PROJ_CODE + 1] =
         NULL,           /* 13 = Gnomonic */
         NULL,           /* 14 = Orthographic */
         NULL,           /* 15 = General Vertical Near-Side Perspective */
-        NULL,           /* 16 = Sinusiodal */
+        gctp_sin_forward_init, /* 16 = Sinusiodal */
         NULL,           /* 17 = Equirectangular */
         NULL,           /* 18 = Miller Cylindrical */
         NULL,           /* 19 = Van der Grinten */
@@ -64,7 +64,7 @@ static INIT_ROUTINE inverse_init[GCTP_MAX_PROJ_CODE + 1] =
         gctp_geo_init,         /* 0 = Geographic */
         gctp_utm_inverse_init, /* 1 = Universal Transverse Mercator (UTM) */
         gctp_state_plane_inverse_init, /* 2 = State Plane Coordinates */
-        NULL,           /* 3 = Albers Conical Equal Area */
+        gctp_albers_inverse_init, /* 3 = Albers Conical Equal Area */
         gctp_lamcc_inverse_init, /* 4 = Lambert Conformal Conic */
         NULL,           /* 5 = Mercator */
         gctp_ps_inverse_init,  /* 6 = Polar Stereographic */
@@ -77,7 +77,7 @@ static INIT_ROUTINE inverse_init[GCTP_MAX_PROJ_CODE + 1] =
         NULL,           /* 13 = Gnomonic */
         NULL,           /* 14 = Orthographic */
         NULL,           /* 15 = General Vertical Near-Side Perspective */
-        NULL,           /* 16 = Sinusiodal */
+        gctp_sin_inverse_init, /* 16 = Sinusiodal */
         NULL,           /* 17 = Equirectangular */
         NULL,           /* 18 = Miller Cylindrical */
         NULL,           /* 19 = Van der Grinten */
@@ -198,11 +198,13 @@ GCTP_TRANSFORMATION *gctp_create_transformation
 
     /* default to no forward or inverse transformation routines */
     trans->forward.transform = NULL;
+    trans->forward.transform_array = NULL;
     trans->forward.destroy = NULL;
     trans->forward.cache = NULL;
     trans->forward.print_info = NULL;
 
     trans->inverse.transform = NULL;
+    trans->inverse.transform_array = NULL;
     trans->inverse.destroy = NULL;
     trans->inverse.cache = NULL;
     trans->inverse.print_info = NULL;
@@ -345,3 +347,23 @@ void gctp_only_allow_threadsafe_transforms()
 {
     only_threadsafe = 1;
 }
+
+/****************************************************************************
+Name: gctp_is_threadsafe_transformation
+
+Purpose: Determines whether a transformation is threadsafe, meaning separate
+    transformations created from the same projections can be used from
+    different threads at the same time.  Transformations that fall back to
+    the old gctp interface are not threadsafe.
+
+Returns:
+    1 if the transformation is threadsafe, 0 if it is not
+
+****************************************************************************/
+int gctp_is_threadsafe_transformation
+(
+    const GCTP_TRANSFORMATION *trans
+)
+{
+    return !trans->use_gctp;
+}
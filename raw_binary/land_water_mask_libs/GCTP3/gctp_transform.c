@@ -144,3 +144,143 @@ int gctp_transform
 
     return GCTP_SUCCESS;
 }
+
+/****************************************************************************
+Name: gctp_transform_batch
+
+Purpose: Performs a coordinate transformation on an array of coordinates with
+    the given previously created transformation.  The transformation checks
+    and setup are done once for the whole array, and each step (unit
+    conversion, inverse and forward transform) is run over the whole array
+    before the next.  Projections with an array transform (currently UTM/TM)
+    run it over the whole array with their constants hoisted out of the
+    loop.
+
+Returns: GCTP_SUCCESS, GCTP_ERROR or GCTP_IN_BREAK
+
+Notes:
+    - The output arrays may be the same as the input arrays.
+    - If a coordinate fails, the error is returned and the contents of the
+      output arrays are undefined.
+
+****************************************************************************/
+int gctp_transform_batch
+(
+    const GCTP_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,             /* I: number of coordinates */
+    const double *in_x,    /* I: array of lon or x values */
+    const double *in_y,    /* I: array of lat or y values */
+    double *out_x,         /* O: array of x or lon values */
+    double *out_y          /* O: array of y or lat values */
+)
+{
+    const TRANSFORMATION *inverse;
+    const TRANSFORMATION *forward;
+    double factor;
+    int i;
+
+    /* Verify the transformation provided is valid */
+    if (!trans)
+    {
+        GCTP_PRINT_ERROR("Invalid transformation provided");
+        return GCTP_ERROR;
+    }
+
+    /* If the use_gctp flag is set, fall back to using gctp one coordinate at
+       a time */
+    /* TODO - remove this after all the projections have been converted */
+    if (trans->use_gctp)
+    {
+        for (i = 0; i < count; i++)
+        {
+            double in_coor[2];
+            double out_coor[2];
+            int status;
+
+            in_coor[0] = in_x[i];
+            in_coor[1] = in_y[i];
+            status = call_gctp(trans, in_coor, out_coor);
+            if (status != GCTP_SUCCESS)
+                return status;
+            out_x[i] = out_coor[0];
+            out_y[i] = out_coor[1];
+        }
+        return GCTP_SUCCESS;
+    }
+
+    inverse = &trans->inverse;
+    forward = &trans->forward;
+
+    /* Convert the input coordinates into the units used by the transforms */
+    factor = inverse->unit_conversion_factor;
+    for (i = 0; i < count; i++)
+    {
+        out_x[i] = in_x[i] * factor;
+        out_y[i] = in_y[i] * factor;
+    }
+
+    /* Do the inverse transformation in place to get lon/lat, using the
+       projection's array transform if it has one */
+    if (inverse->transform_array)
+    {
+        if (inverse->transform_array(inverse, count, out_x, out_y)
+                != GCTP_SUCCESS)
+        {
+            GCTP_PRINT_ERROR("Error in inverse transformation");
+            return GCTP_ERROR;
+        }
+    }
+    else if (inverse->transform)
+    {
+        for (i = 0; i < count; i++)
+        {
+            int status;
+
+            status = inverse->transform(inverse, out_x[i], out_y[i],
+                &out_x[i], &out_y[i]);
+            if (status != GCTP_SUCCESS)
+            {
+                if (status == IN_BREAK)
+                {
+                    /* In a break area, so return that indication */
+                    return GCTP_IN_BREAK;
+                }
+                GCTP_PRINT_ERROR("Error in inverse transformation");
+                return GCTP_ERROR;
+            }
+        }
+    }
+
+    /* Do the forward transformation in place */
+    if (forward->transform_array)
+    {
+        if (forward->transform_array(forward, count, out_x, out_y)
+                != GCTP_SUCCESS)
+        {
+            GCTP_PRINT_ERROR("Error in forward transformation");
+            return GCTP_ERROR;
+        }
+    }
+    else if (forward->transform)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (forward->transform(forward, out_x[i], out_y[i],
+                    &out_x[i], &out_y[i]) != GCTP_SUCCESS)
+            {
+                GCTP_PRINT_ERROR("Error in forward transformation");
+                return GCTP_ERROR;
+            }
+        }
+    }
+
+    /* Convert the output coordinates into the requested units */
+    factor = forward->unit_conversion_factor;
+    for (i = 0; i < count; i++)
+    {
+        out_x[i] *= factor;
+        out_y[i] *= factor;
+    }
+
+    return GCTP_SUCCESS;
+}
@@ -28,12 +28,21 @@ typedef void (*DESTROY_TRANSFORM)(TRANSFORMATION *);
 typedef int (*TRANSFORM_FUNC)(const TRANSFORMATION *trans,
     double in_x, double in_y, double *out_x, double *out_y);
 
+/* Function typedef for an array transform function.  The coordinates are
+   transformed in place, with the same input and output meanings as
+   TRANSFORM_FUNC.  Projections that don't provide one are transformed one
+   coordinate at a time with the TRANSFORM_FUNC. */
+typedef int (*TRANSFORM_ARRAY_FUNC)(const TRANSFORMATION *trans,
+    int count, double *x, double *y);
+
 /* Define a structure for tracking the information for a transformation.  The
    same structure works for both forward and inverse transformations. */
 struct transformation
 {
     GCTP_PROJECTION proj;     /* projection information */
     TRANSFORM_FUNC transform; /* function pointer for the transform function */
+    TRANSFORM_ARRAY_FUNC transform_array; /* optional function pointer for
+                                  transforming an array of coordinates */
     DESTROY_TRANSFORM destroy; /* Function pointer to clean up the
                                   transformation.  Note that most projections
                                   can leave this at the default NULL. */
@@ -85,6 +94,10 @@ void gctp_print_message
 /*********** Internal routines for initializing projections ***************/
 int gctp_geo_init(TRANSFORMATION *trans);
 
+int gctp_albers_inverse_init(TRANSFORMATION *trans);
+
+int gctp_albers_forward_init(TRANSFORMATION *trans);
+
 int gctp_lamcc_inverse_init(TRANSFORMATION *trans);
 
 int gctp_lamcc_forward_init(TRANSFORMATION *trans);
@@ -109,6 +122,10 @@ int gctp_som_inverse_init(TRANSFORMATION *trans);
 
 int gctp_som_forward_init(TRANSFORMATION *trans);
 
+int gctp_sin_inverse_init(TRANSFORMATION *trans);
+
+int gctp_sin_forward_init(TRANSFORMATION *trans);
+
 int gctp_tm_inverse_init(TRANSFORMATION *trans);
 
 int gctp_tm_forward_init(TRANSFORMATION *trans);
@@ -35,6 +35,8 @@ struct ps_proj
     double tcs;             /* small value t */
     double false_northing;  /* y offset in meters */
     double false_easting;   /* x offset in meters */
+    double conf[4];         /* coefficients of the series for the latitude
+                               from the conformal latitude */
 };
 
 /*****************************************************************************
@@ -148,30 +150,94 @@ static int common_init
         cache->tcs = gctp_calc_small_t(cache->e, con1, sinphi);
     }
 
+    /* Coefficients of the series for the latitude from the conformal
+       latitude (Snyder equation 3-5), used to start the inverse iteration
+       close to the solution */
+    cache->conf[0] = es / 2.0 + SQUARE(es) * 5.0 / 24.0
+        + es * SQUARE(es) / 12.0 + SQUARE(SQUARE(es)) * 13.0 / 360.0;
+    cache->conf[1] = SQUARE(es) * 7.0 / 48.0 + es * SQUARE(es) * 29.0 / 240.0
+        + SQUARE(SQUARE(es)) * 811.0 / 11520.0;
+    cache->conf[2] = es * SQUARE(es) * 7.0 / 120.0
+        + SQUARE(SQUARE(es)) * 81.0 / 1120.0;
+    cache->conf[3] = SQUARE(SQUARE(es)) * 4279.0 / 161280.0;
+
     trans->print_info = print_info;
 
     return GCTP_SUCCESS;
 }
 
 /*****************************************************************************
-Name: inverse_transform
+Name: ps_phi2
 
-Purpose: Transforms X,Y to lat,long
+Purpose: Computes the latitude for the inverse transformation.  This is the
+    iteration of gctp_calc_phi2, started from the series for the latitude
+    from the conformal latitude instead of from the conformal latitude
+    itself, so it usually converges in one iteration instead of four or
+    five.
 
 Returns:
     GCTP_SUCCESS or GCTP_ERROR
 
 *****************************************************************************/
-static int inverse_transform
+static inline int ps_phi2
 (
-    const TRANSFORMATION *trans, /* I: transformation information */
+    const struct ps_proj *cache_ptr, /* I: cached projection constants */
+    double ts,      /* I: Constant value t */
+    double *phi2    /* O: calculated value of phi2 */
+)
+{
+    double e = cache_ptr->e;    /* eccentricity */
+    double phi;                 /* latitude */
+    double dphi;                /* change in the latitude */
+    double con;                 /* temporary variable */
+    double sin_2c, cos_2c;      /* sin and cos of twice the conformal
+                                   latitude */
+    long i;
+
+    phi = HALF_PI - 2 * atan(ts);
+    sincos(2.0 * phi, &sin_2c, &cos_2c);
+    phi += sin_2c * (cache_ptr->conf[0] + cache_ptr->conf[1] * 2.0 * cos_2c
+        + cache_ptr->conf[2] * (3.0 - 4.0 * SQUARE(sin_2c))
+        + cache_ptr->conf[3] * 4.0 * cos_2c * (1.0 - 2.0 * SQUARE(sin_2c)));
+
+    for (i = 0; i <= 15; i++)
+    {
+        con = e * sin(phi);
+        dphi = HALF_PI - 2 * atan(ts * pow((1.0 - con) / (1.0 + con), .5 * e))
+            - phi;
+        phi += dphi;
+        if (fabs(dphi) <= .0000000001)
+        {
+            *phi2 = phi;
+            return GCTP_SUCCESS;
+        }
+    }
+
+    GCTP_PRINT_ERROR("Failed to converge to a solution for phi2");
+    return GCTP_ERROR;
+}
+
+/*****************************************************************************
+Name: ps_inverse
+
+Purpose: Transforms polar stereographic X,Y to lat,long using the cached
+    projection constants.  This is shared by the single coordinate and array
+    transforms so the array loop can be specialized with the constants kept
+    local.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static inline int ps_inverse
+(
+    const struct ps_proj *cache_ptr, /* I: cached projection constants */
     double x,       /* I: X projection coordinate */
     double y,       /* I: Y projection coordinate */
     double *lon,    /* O: Longitude */
     double *lat     /* O: Latitude */
 )
 {
-    struct ps_proj *cache_ptr = (struct ps_proj *)trans->cache;
     double rh;          /* height above ellipsiod */
     double ts;          /* small value t */
     double temp;        /* temporary variable */
@@ -184,7 +250,7 @@ static int inverse_transform
         ts = rh * cache_ptr->tcs/(cache_ptr->r_major * cache_ptr->mcs);
     else
         ts = rh * cache_ptr->e4 / (cache_ptr->r_major * 2.0);
-    if (gctp_calc_phi2(cache_ptr->e, ts, &phi2) != GCTP_SUCCESS)
+    if (ps_phi2(cache_ptr, ts, &phi2) != GCTP_SUCCESS)
         return GCTP_ERROR;
 
     *lat = cache_ptr->fac * phi2;
@@ -200,29 +266,83 @@ static int inverse_transform
 }
 
 /*****************************************************************************
-Name: forward_transform
+Name: inverse_transform
 
-Purpose: Transforms lat,long to polar stereographic X,Y
+Purpose: Transforms X,Y to lat,long
 
 Returns:
     GCTP_SUCCESS or GCTP_ERROR
 
 *****************************************************************************/
-static int forward_transform
+static int inverse_transform
 (
     const TRANSFORMATION *trans, /* I: transformation information */
+    double x,       /* I: X projection coordinate */
+    double y,       /* I: Y projection coordinate */
+    double *lon,    /* O: Longitude */
+    double *lat     /* O: Latitude */
+)
+{
+    return ps_inverse((const struct ps_proj *)trans->cache, x, y, lon, lat);
+}
+
+/*****************************************************************************
+Name: inverse_transform_array
+
+Purpose: Transforms an array of polar stereographic X,Y to lat,long in
+    place.  The cached constants are copied locally once for the whole
+    array.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int inverse_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,      /* I: number of coordinates */
+    double *x,      /* I/O: X projection coordinates in, longitudes out */
+    double *y       /* I/O: Y projection coordinates in, latitudes out */
+)
+{
+    const struct ps_proj cache = *(const struct ps_proj *)trans->cache;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (ps_inverse(&cache, x[i], y[i], &x[i], &y[i]) != GCTP_SUCCESS)
+            return GCTP_ERROR;
+    }
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: ps_forward
+
+Purpose: Transforms lat,long to polar stereographic X,Y using the cached
+    projection constants.  This is shared by the single coordinate and array
+    transforms so the array loop can be specialized with the constants kept
+    local.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static inline int ps_forward
+(
+    const struct ps_proj *cache_ptr, /* I: cached projection constants */
     double lon,         /* I: Longitude */
     double lat,         /* I: Latitude */
     double *x,          /* O: X projection coordinate */
     double *y           /* O: Y projection coordinate */
 )
 {
-    struct ps_proj *cache_ptr = (struct ps_proj *)trans->cache;
-
     double con1;            /* adjusted longitude */
     double con2;            /* adjusted latitude */
     double rh;              /* height above ellipsoid */
     double sinphi;          /* sin value */
+    double sin_lon, cos_lon;/* sin and cos of the adjusted longitude */
     double ts;              /* value of small t */
 
     con1 = cache_ptr->fac * adjust_lon(lon - cache_ptr->center_lon);
@@ -233,8 +353,58 @@ static int forward_transform
         rh = cache_ptr->r_major * cache_ptr->mcs * ts / cache_ptr->tcs;
     else
         rh = 2.0 * cache_ptr->r_major * ts / cache_ptr->e4;
-    *x = cache_ptr->fac * rh * sin(con1) + cache_ptr->false_easting;
-    *y = -cache_ptr->fac * rh * cos(con1) + cache_ptr->false_northing;;
+    sincos(con1, &sin_lon, &cos_lon);
+    *x = cache_ptr->fac * rh * sin_lon + cache_ptr->false_easting;
+    *y = -cache_ptr->fac * rh * cos_lon + cache_ptr->false_northing;
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: forward_transform
+
+Purpose: Transforms lat,long to polar stereographic X,Y
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int forward_transform
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    double lon,         /* I: Longitude */
+    double lat,         /* I: Latitude */
+    double *x,          /* O: X projection coordinate */
+    double *y           /* O: Y projection coordinate */
+)
+{
+    return ps_forward((const struct ps_proj *)trans->cache, lon, lat, x, y);
+}
+
+/*****************************************************************************
+Name: forward_transform_array
+
+Purpose: Transforms an array of lat,long to polar stereographic X,Y in
+    place.  The cached constants are copied locally once for the whole
+    array.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int forward_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,      /* I: number of coordinates */
+    double *x,      /* I/O: longitudes in, X projection coordinates out */
+    double *y       /* I/O: latitudes in, Y projection coordinates out */
+)
+{
+    const struct ps_proj cache = *(const struct ps_proj *)trans->cache;
+    int i;
+
+    for (i = 0; i < count; i++)
+        ps_forward(&cache, x[i], y[i], &x[i], &y[i]);
 
     return GCTP_SUCCESS;
 }
@@ -263,6 +433,7 @@ int gctp_ps_inverse_init
     }
 
     trans->transform = inverse_transform;
+    trans->transform_array = inverse_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -290,6 +461,7 @@ int gctp_ps_forward_init
     }
 
     trans->transform = forward_transform;
+    trans->transform_array = forward_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -24,46 +24,6 @@
 
 /* GCTP Function prototypes */
 
-long alberforint
-(
-    double r_maj,
-    double r_min,
-    double lat1,
-    double lat2,
-    double lon0,
-    double lat0,
-    double false_east,
-    double false_north
-);
-
-long alberfor
-(
-    double lon,
-    double lat,
-    double *x,
-    double *y
-);
-
-long alberinvint
-(
-    double r_maj,               /* major axis                           */
-    double r_min,               /* minor axis                           */
-    double lat1,                /* first standard parallel              */
-    double lat2,                /* second standard parallel             */
-    double lon0,                /* center longitude                     */
-    double lat0,                /* center lattitude                     */
-    double false_east,          /* x offset in meters                   */
-    double false_north          /* y offset in meters                   */
-);
-
-long alberinv
-(
-    double x,                   /* (O) X projection coordinate  */
-    double y,                   /* (O) Y projection coordinate      */
-    double *lon,                /* (I) Longitude                */
-    double *lat                 /* (I) Latitude             */
-);
-
 long alconforint
 (
     double r_maj,               /* Major axis                           */
@@ -721,38 +681,6 @@ long robinv
     double *lat              /* (I) Latitude */
 );
 
-long sinforint
-(
-    double r,                /* (I) Radius of the earth (sphere)     */
-    double center_long,      /* (I) Center longitude                 */
-    double false_east,       /* x offset in meters                   */
-    double false_north       /* y offset in meters                   */
-);
-
-long sinfor
-(
-    double lon,              /* (I) Longitude */
-    double lat,              /* (I) Latitude */
-    double *x,               /* (O) X projection coordinate */
-    double *y                /* (O) Y projection coordinate */
-);
-
-long sininvint
-(
-    double r,                /* (I) Radius of the earth (sphere)     */
-    double center_long,      /* (I) Center longitude                 */
-    double false_east,       /* x offset in meters                   */
-    double false_north       /* y offset in meters                   */
-);
-
-long sininv
-(
-    double x,                /* (I) X projection coordinate */
-    double y,                /* (I) Y projection coordinate */
-    double *lon,             /* (O) Longitude */
-    double *lat              /* (O) Latitude */
-);
-
 void sphdz
 (
     long isph,               /* spheroid code number                         */
@@ -299,28 +299,30 @@ static int utm_common_init
 }
 
 /*****************************************************************************
-Name: inverse_transform
+Name: tm_inverse
 
-Purpose: Transforms UTM/TM X,Y to lat,long
+Purpose: Transforms UTM/TM X,Y to lat,long using the cached projection
+    constants.  This is shared by the single coordinate and array transforms
+    so the array loop can be specialized with the constants kept local.
 
 Returns:
     GCTP_SUCCESS or GCTP_ERROR
 
 *****************************************************************************/
-static int inverse_transform
+static inline int tm_inverse
 (
-    const TRANSFORMATION *trans, /* I: transformation information */
+    const struct tm_proj *cache_ptr, /* I: cached projection constants */
     double x,       /* I: X projection coordinate */
     double y,       /* I: Y projection coordinate */
     double *lon,    /* O: Longitude */
     double *lat     /* O: Latitude */
 )
 {
-    struct tm_proj *cache_ptr = (struct tm_proj *)trans->cache;
     double con,phi;                 /* temporary angles */
     double delta_phi;               /* difference between longitudes */
     long i;                         /* counter variable */
     double sin_phi, cos_phi, tan_phi;   /* sin cos and tangent values */
+    double sin_2phi, cos_2phi;      /* sin and cos of twice the latitude */
     double c, cs, t, ts, n, r, d, ds;   /* temporary variables */
     double f, h, g, temp;           /* temporary variables */
     long max_iter = 6;              /* maximun number of iterations */
@@ -357,8 +359,12 @@ static int inverse_transform
     phi = con;
     for (i = 0; ;i++)
     {
-        delta_phi = ((con + cache_ptr->e1 * sin(2.0*phi) - cache_ptr->e2
-                  * sin(4.0*phi) + cache_ptr->e3 * sin(6.0*phi))
+        /* sin(4*phi) and sin(6*phi) come from the multiple angle identities
+           so each iteration needs a single sincos */
+        sincos(2.0*phi, &sin_2phi, &cos_2phi);
+        delta_phi = ((con + cache_ptr->e1 * sin_2phi - cache_ptr->e2
+                  * 2.0 * sin_2phi * cos_2phi + cache_ptr->e3 * sin_2phi
+                  * (3.0 - 4.0 * SQUARE(sin_2phi)))
                 / cache_ptr->e0) - phi;
         phi += delta_phi;
         if (fabs(delta_phi) <= EPSLN)
@@ -373,7 +379,7 @@ static int inverse_transform
     if (fabs(phi) < HALF_PI)
     {
         sincos(phi, &sin_phi, &cos_phi);
-        tan_phi = tan(phi);
+        tan_phi = sin_phi / cos_phi;
         c    = cache_ptr->esp * SQUARE(cos_phi);
         cs   = SQUARE(c);
         t    = SQUARE(tan_phi);
@@ -401,30 +407,83 @@ static int inverse_transform
 }
 
 /*****************************************************************************
-Name: forward_transform
+Name: inverse_transform
 
-Purpose: Transforms lat,long to UTM/TM X,Y
+Purpose: Transforms UTM/TM X,Y to lat,long
 
 Returns:
     GCTP_SUCCESS or GCTP_ERROR
 
 *****************************************************************************/
-static int forward_transform
+static int inverse_transform
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    double x,       /* I: X projection coordinate */
+    double y,       /* I: Y projection coordinate */
+    double *lon,    /* O: Longitude */
+    double *lat     /* O: Latitude */
+)
+{
+    return tm_inverse((const struct tm_proj *)trans->cache, x, y, lon, lat);
+}
+
+/*****************************************************************************
+Name: inverse_transform_array
+
+Purpose: Transforms an array of UTM/TM X,Y to lat,long in place.  The cached
+    constants are copied locally once for the whole array.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int inverse_transform_array
 (
     const TRANSFORMATION *trans, /* I: transformation information */
+    int count,      /* I: number of coordinates */
+    double *x,      /* I/O: X projection coordinates in, longitudes out */
+    double *y       /* I/O: Y projection coordinates in, latitudes out */
+)
+{
+    const struct tm_proj cache = *(const struct tm_proj *)trans->cache;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (tm_inverse(&cache, x[i], y[i], &x[i], &y[i]) != GCTP_SUCCESS)
+            return GCTP_ERROR;
+    }
+
+    return GCTP_SUCCESS;
+}
+
+/*****************************************************************************
+Name: tm_forward
+
+Purpose: Transforms lat,long to UTM/TM X,Y using the cached projection
+    constants.  This is shared by the single coordinate and array transforms
+    so the array loop can be specialized with the constants kept local.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static inline int tm_forward
+(
+    const struct tm_proj *cache_ptr, /* I: cached projection constants */
     double lon,         /* I: Longitude */
     double lat,         /* I: Latitude */
     double *x,          /* O: X projection coordinate */
     double *y           /* O: Y projection coordinate */
 )
 {
-    struct tm_proj *cache_ptr = (struct tm_proj *)trans->cache;
     double delta_lon;       /* Delta longitude (Given longitude - center) */
     double sin_phi, cos_phi;/* sin and cos value */
     double al, als;         /* temporary values */
     double b;               /* temporary values */
     double c, t, tq;        /* temporary values */
     double con, n, ml;      /* cone constant, small m */
+    double sin_2phi, cos_2phi; /* sin and cos of twice the latitude */
 
     /* Forward equations */
     delta_lon = adjust_lon(lon - cache_ptr->lon_center);
@@ -455,12 +514,18 @@ static int forward_transform
     al  = cos_phi * delta_lon;
     als = SQUARE(al);
     c   = cache_ptr->esp * SQUARE(cos_phi);
-    tq  = tan(lat);
+    tq  = sin_phi / cos_phi;
     t   = SQUARE(tq);
     con = 1.0 - cache_ptr->es * SQUARE(sin_phi);
     n   = cache_ptr->r_major / sqrt(con);
-    ml  = cache_ptr->r_major * gctp_calc_dist_from_equator(cache_ptr->e0,
-            cache_ptr->e1, cache_ptr->e2, cache_ptr->e3, lat);
+
+    /* Distance along the meridian, with the multiple angles of the latitude
+       built from the sin and cos already computed */
+    sin_2phi = 2.0 * sin_phi * cos_phi;
+    cos_2phi = SQUARE(cos_phi) - SQUARE(sin_phi);
+    ml  = cache_ptr->r_major * (cache_ptr->e0 * lat - cache_ptr->e1 * sin_2phi
+        + cache_ptr->e2 * 2.0 * sin_2phi * cos_2phi - cache_ptr->e3
+        * sin_2phi * (3.0 - 4.0 * SQUARE(sin_2phi)));
 
     *x  = cache_ptr->scale_factor * n * al * (1.0 + als / 6.0
         * (1.0 - t + c + als / 20.0 * (5.0 - 18.0 * t + SQUARE(t) + 72.0
@@ -474,6 +539,57 @@ static int forward_transform
     return GCTP_SUCCESS;
 }
 
+/*****************************************************************************
+Name: forward_transform
+
+Purpose: Transforms lat,long to UTM/TM X,Y
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int forward_transform
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    double lon,         /* I: Longitude */
+    double lat,         /* I: Latitude */
+    double *x,          /* O: X projection coordinate */
+    double *y           /* O: Y projection coordinate */
+)
+{
+    return tm_forward((const struct tm_proj *)trans->cache, lon, lat, x, y);
+}
+
+/*****************************************************************************
+Name: forward_transform_array
+
+Purpose: Transforms an array of lat,long to UTM/TM X,Y in place.  The cached
+    constants are copied locally once for the whole array.
+
+Returns:
+    GCTP_SUCCESS or GCTP_ERROR
+
+*****************************************************************************/
+static int forward_transform_array
+(
+    const TRANSFORMATION *trans, /* I: transformation information */
+    int count,      /* I: number of coordinates */
+    double *x,      /* I/O: longitudes in, X projection coordinates out */
+    double *y       /* I/O: latitudes in, Y projection coordinates out */
+)
+{
+    const struct tm_proj cache = *(const struct tm_proj *)trans->cache;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (tm_forward(&cache, x[i], y[i], &x[i], &y[i]) != GCTP_SUCCESS)
+            return GCTP_ERROR;
+    }
+
+    return GCTP_SUCCESS;
+}
+
 /*****************************************************************************
 Name: gctp_utm_inverse_init
 
@@ -496,6 +612,7 @@ int gctp_utm_inverse_init
     }
 
     trans->transform = inverse_transform;
+    trans->transform_array = inverse_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -522,6 +639,7 @@ int gctp_utm_forward_init
     }
 
     trans->transform = forward_transform;
+    trans->transform_array = forward_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -548,6 +666,7 @@ int gctp_tm_inverse_init
     }
 
     trans->transform = inverse_transform;
+    trans->transform_array = inverse_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -574,6 +693,7 @@ int gctp_tm_forward_init
     }
 
     trans->transform = forward_transform;
+    trans->transform_array = forward_transform_array;
 
     return GCTP_SUCCESS;
 }
@@ -10,6 +10,12 @@ at the USGS EROS
 LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 
 NOTES:
+  1. The masks of several grids of a scene, such as the 15m panchromatic and
+     30m multispectral grids of Landsat 8, can be made with one pass over the
+     polygon (see generate_land_water_masks).
+  2. When a land/water raster is named by ESPA_LAND_WATER_RASTER, the masks
+     are looked up in it if it is fine enough for the grid, and are made from
+     the polygon otherwise (see land_water_raster.c).
 *****************************************************************************/
 
 #include <stdio.h>
@@ -17,71 +23,49 @@ NOTES:
 #include <limits.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #include "generate_land_water_mask.h"
+#include "espa_alloc.h"
+
+/* Tolerance, in fine pixels, for a grid to nest in a finer grid */
+#define LW_GRID_TOLERANCE 1e-6
 
 /******************************************************************************
-MODULE:  generate_land_water_mask
+MODULE:  setup_mask_grid
 
-PURPOSE:  This function creates the land/water mask (land = 1) for the area
-covered by the scene.  If the output mask image name is provided, the mask
-image is written to a file with that name.
+PURPOSE:  Sets up the image grid and projection of the land/water mask for a
+representative band of the scene.
 
 RETURN VALUE:
 Type = int
 Value        Description
 -------      -----------
-ERROR        Error occurred opening or reading the file
+ERROR        The datum of the scene isn't supported
 SUCCESS      Successful completion
 
 NOTES:
-1. Memory for the land water mask will be allocated for the entire image
-   (nlines x nsamps x sizeof (unsigned char)).  It is up to the calling routine
-   to free this memory.
 ******************************************************************************/
-int generate_land_water_mask
+static int setup_mask_grid
 (
     Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
-    const char land_mass_polygon[],   /* I: name of land mass polygon file */
-    unsigned char **land_water_mask,  /* O: pointer to land water mask buffer,
-                                            memory is allocated and the
-                                            mask is populated */
-    int *nlines,                      /* O: number of lines in the mask */
-    int *nsamps                       /* O: number of samples in the mask */
+    int refl_indx,                    /* I: index of the representative band
+                                            in the XML metadata */
+    IAS_IMAGE *mask_image,            /* O: image grid of the mask */
+    IAS_PROJECTION *mask_projection   /* O: projection of the mask */
 )
 {
-    char FUNC_NAME[] = "generate_land_water_mask";   /* function name */
+    char FUNC_NAME[] = "setup_mask_grid";   /* function name */
     char errmsg[STR_SIZE];            /* error message */
     int i;                            /* looping variable */
-    int refl_indx = -9;               /* band index in XML file for the
-                                         representative reflectance band */
     double upper_left_x;              /* upper left X coordinate */
     double upper_left_y;              /* upper left Y coordinate */
     double lower_right_x;             /* lower right X coordinate */
     double lower_right_y;             /* lower right Y coordinate */
     Espa_global_meta_t *gmeta = &xml_meta->global;
                                       /* pointer to global metadata structure */
-    IAS_IMAGE mask_image;             /* image data used to build mask */
-    IAS_PROJECTION mask_projection;   /* projection data */
-
-    /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_meta->nbands; i++)
-    {
-        if (!strcmp (xml_meta->band[i].name, "band1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
-
-    /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
-    {
-        sprintf (errmsg, "Band 1 (band1) was not found in the XML file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    Espa_band_meta_t *bmeta = &xml_meta->band[refl_indx];
+                                      /* representative band metadata */
 
     /* If the grid origin is center, then adjust for the resolution.  The
        corners will be written for the outer extents of the corner. */
@@ -89,15 +73,15 @@ int generate_land_water_mask
     {
         /* UL corner - go from center to UL of UL */
         upper_left_x = gmeta->proj_info.ul_corner[0] -
-            0.5 * xml_meta->band[refl_indx].pixel_size[0];
+            0.5 * bmeta->pixel_size[0];
         upper_left_y = gmeta->proj_info.ul_corner[1] +
-            0.5 * xml_meta->band[refl_indx].pixel_size[1];
+            0.5 * bmeta->pixel_size[1];
 
         /* LR corner - go from center to LR of LR */
         lower_right_x = gmeta->proj_info.lr_corner[0] +
-            0.5 * xml_meta->band[refl_indx].pixel_size[0];
+            0.5 * bmeta->pixel_size[0];
         lower_right_y = gmeta->proj_info.lr_corner[1] -
-            0.5 * xml_meta->band[refl_indx].pixel_size[1];
+            0.5 * bmeta->pixel_size[1];
     }
     else
     {
@@ -108,74 +92,72 @@ int generate_land_water_mask
 
         /* LR corner - go from UL of LR to LR of LR */
         lower_right_x = gmeta->proj_info.lr_corner[0] +
-            xml_meta->band[refl_indx].pixel_size[0];
+            bmeta->pixel_size[0];
         lower_right_y = gmeta->proj_info.lr_corner[1] -
-            xml_meta->band[refl_indx].pixel_size[1];
+            bmeta->pixel_size[1];
     }
 
     /* Set the level-1 image band metadata to image structure */
-    mask_image.corners = (struct IAS_CORNERS)
+    mask_image->corners = (struct IAS_CORNERS)
         {
             {upper_left_x, upper_left_y},
             {lower_right_x, upper_left_y},
             {upper_left_x, lower_right_y},
             {lower_right_x, lower_right_y}
         };
-    mask_image.pixel_size_x = xml_meta->band[refl_indx].pixel_size[0];
-    mask_image.pixel_size_y = xml_meta->band[refl_indx].pixel_size[1];
-    mask_image.nl = xml_meta->band[refl_indx].nlines;
-    mask_image.ns = xml_meta->band[refl_indx].nsamps;
-    mask_image.band_number = xml_meta->nbands+1;  /* not used */
-    *nlines = xml_meta->band[refl_indx].nlines;
-    *nsamps = xml_meta->band[refl_indx].nsamps;
+    mask_image->pixel_size_x = bmeta->pixel_size[0];
+    mask_image->pixel_size_y = bmeta->pixel_size[1];
+    mask_image->nl = bmeta->nlines;
+    mask_image->ns = bmeta->nsamps;
+    mask_image->band_number = xml_meta->nbands+1;  /* not used */
 
     /* Set the projection contents based on info from the XML */
     for (i = 0; i < NPROJ_PARAM; i++)
-        mask_projection.parameters[i] = 0.0;
+        mask_projection->parameters[i] = 0.0;
 
     if (gmeta->proj_info.proj_type == GCTP_UTM_PROJ)
     {
-        mask_projection.proj_code = GCTP_UTM_PROJ;
-        mask_projection.units = METER;
-        mask_projection.zone = gmeta->proj_info.utm_zone;
+        mask_projection->proj_code = GCTP_UTM_PROJ;
+        mask_projection->units = METER;
+        mask_projection->zone = gmeta->proj_info.utm_zone;
     }
     else if (gmeta->proj_info.proj_type == GCTP_PS_PROJ)
     {
-        mask_projection.proj_code = GCTP_PS_PROJ;
-        mask_projection.units = METER;
-        mask_projection.parameters[4] =
+        mask_projection->proj_code = GCTP_PS_PROJ;
+        mask_projection->units = METER;
+        mask_projection->parameters[4] =
             deg_to_dms (gmeta->proj_info.longitude_pole);
-        mask_projection.parameters[5] =
+        mask_projection->parameters[5] =
             deg_to_dms (gmeta->proj_info.latitude_true_scale);
-        mask_projection.parameters[6] = gmeta->proj_info.false_easting;
-        mask_projection.parameters[7] = gmeta->proj_info.false_northing;
+        mask_projection->parameters[6] = gmeta->proj_info.false_easting;
+        mask_projection->parameters[7] = gmeta->proj_info.false_northing;
     }
     else if (gmeta->proj_info.proj_type == GCTP_ALBERS_PROJ)
     {
-        mask_projection.proj_code = GCTP_ALBERS_PROJ;
-        mask_projection.units = METER;
-        mask_projection.parameters[2] =
+        mask_projection->proj_code = GCTP_ALBERS_PROJ;
+        mask_projection->units = METER;
+        mask_projection->parameters[2] =
             deg_to_dms (gmeta->proj_info.standard_parallel1);
-        mask_projection.parameters[3] =
+        mask_projection->parameters[3] =
             deg_to_dms (gmeta->proj_info.standard_parallel2);
-        mask_projection.parameters[4] =
+        mask_projection->parameters[4] =
             deg_to_dms (gmeta->proj_info.central_meridian);
-        mask_projection.parameters[5] =
+        mask_projection->parameters[5] =
             deg_to_dms (gmeta->proj_info.origin_latitude);
-        mask_projection.parameters[6] = gmeta->proj_info.false_easting;
-        mask_projection.parameters[7] = gmeta->proj_info.false_northing;
+        mask_projection->parameters[6] = gmeta->proj_info.false_easting;
+        mask_projection->parameters[7] = gmeta->proj_info.false_northing;
     }
 
     switch (gmeta->proj_info.datum_type)
     {
         case (ESPA_WGS84):
-            mask_projection.spheroid = SPHERE_WGS84;
+            mask_projection->spheroid = SPHERE_WGS84;
             break;
         case (ESPA_NAD83):
-            mask_projection.spheroid = SPHERE_GRS80;
+            mask_projection->spheroid = SPHERE_GRS80;
             break;
         case (ESPA_NAD27):
-            mask_projection.spheroid = SPHERE_CLARKE_1866;
+            mask_projection->spheroid = SPHERE_CLARKE_1866;
             break;
         case (ESPA_NODATUM):
             sprintf (errmsg, "ESPA_NODATUM is not supported for converting "
@@ -188,27 +170,62 @@ int generate_land_water_mask
     printf("==================================================\n");
     printf("= Summary of land/water image and projection     =\n");
     printf("==================================================\n");
-    printf("   upper_left_x = %lf\n", mask_image.corners.upleft.x);
-    printf("   upper_left_y = %lf\n", mask_image.corners.upleft.y);
-    printf("  upper_right_x = %lf\n", mask_image.corners.upright.x);
-    printf("  upper_right_y = %lf\n", mask_image.corners.upright.y);
-    printf("   lower_left_x = %lf\n", mask_image.corners.loleft.x);
-    printf("   lower_left_y = %lf\n", mask_image.corners.loleft.y);
-    printf("  lower_right_x = %lf\n", mask_image.corners.loright.x);
-    printf("  lower_right_y = %lf\n", mask_image.corners.loright.y);
-    printf("   pixel_size_y = %lf\n", mask_image.pixel_size_y);
-    printf("   pixel_size_x = %lf\n", mask_image.pixel_size_x);
-    printf("  nLinesInImage = %d\n", mask_image.nl);
-    printf("       nSamples = %d\n", mask_image.ns);
-    printf("    band_number = %d\n", mask_image.band_number);
-    printf("projection code = %d\n", mask_projection.proj_code);
-    printf("      zone code = %d\n", mask_projection.zone);
-    printf("  spheroid code = %d\n", mask_projection.spheroid);
-    printf("          units = %d\n", mask_projection.units);
+    printf("   upper_left_x = %lf\n", mask_image->corners.upleft.x);
+    printf("   upper_left_y = %lf\n", mask_image->corners.upleft.y);
+    printf("  upper_right_x = %lf\n", mask_image->corners.upright.x);
+    printf("  upper_right_y = %lf\n", mask_image->corners.upright.y);
+    printf("   lower_left_x = %lf\n", mask_image->corners.loleft.x);
+    printf("   lower_left_y = %lf\n", mask_image->corners.loleft.y);
+    printf("  lower_right_x = %lf\n", mask_image->corners.loright.x);
+    printf("  lower_right_y = %lf\n", mask_image->corners.loright.y);
+    printf("   pixel_size_y = %lf\n", mask_image->pixel_size_y);
+    printf("   pixel_size_x = %lf\n", mask_image->pixel_size_x);
+    printf("  nLinesInImage = %d\n", mask_image->nl);
+    printf("       nSamples = %d\n", mask_image->ns);
+    printf("    band_number = %d\n", mask_image->band_number);
+    printf("projection code = %d\n", mask_projection->proj_code);
+    printf("      zone code = %d\n", mask_projection->zone);
+    printf("  spheroid code = %d\n", mask_projection->spheroid);
+    printf("          units = %d\n", mask_projection->units);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  generate_mask_for_grid
+
+PURPOSE:  Generates the land/water mask (land = 1) of an image grid from the
+land-mass polygon, or reads it from the cache.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating or generating the mask
+SUCCESS      Successful completion
+
+NOTES:
+1. The mask is allocated with espa_alloc_large, and it is up to the calling
+   routine to free it with espa_free_large.
+******************************************************************************/
+static int generate_mask_for_grid
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *mask_image,      /* I: image grid of the mask */
+    const IAS_PROJECTION *mask_projection, /* I: projection of the mask */
+    unsigned char **land_water_mask   /* O: land/water mask, nl x ns */
+)
+{
+    char FUNC_NAME[] = "generate_mask_for_grid";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    bool used_raster = false;         /* was the mask made from the raster? */
+    Lw_raster_t *raster = get_land_water_raster ();
+                                      /* land/water raster, or NULL */
 
     /* Allocate memory for the land/water mask and initialize to all zeros */
-    *land_water_mask = calloc (mask_image.nl * mask_image.ns,
-        sizeof (unsigned char));
+    *land_water_mask = espa_alloc_large ((size_t) mask_image->nl *
+        mask_image->ns * sizeof (unsigned char));
     if (*land_water_mask == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the land/water mask.");
@@ -216,15 +233,815 @@ int generate_land_water_mask
         return (ERROR);
     }
 
+    /* Use the mask of an earlier scene on the same grid if it is cached */
+    if (read_land_water_mask_cache (land_mass_polygon, mask_image,
+        mask_projection, *land_water_mask))
+    {
+        printf ("Using the cached land/water mask\n");
+        return (SUCCESS);
+    }
+
+    /* Look the mask up in the land/water raster if there is one fine enough
+       for this grid.  Those masks aren't cached, since the lookup is about
+       as quick as reading the cache. */
+    if (raster != NULL)
+    {
+        if (raster_land_water_mask (raster, mask_image, mask_projection,
+            *land_water_mask, &used_raster) != SUCCESS)
+        {
+            sprintf (errmsg, "Looking up the land/water mask in the raster");
+            error_handler (true, FUNC_NAME, errmsg);
+            espa_free_large (*land_water_mask);
+            *land_water_mask = NULL;
+            return (ERROR);
+        }
+        if (used_raster)
+            return (SUCCESS);
+    }
+
     /* Use the land-mass polygon to generate a land/water mask for this
        scene */
-    if (ias_geo_shape_mask_projection(land_mass_polygon, &mask_image,
-        &mask_projection, *land_water_mask) != SUCCESS)
+    if (ias_geo_shape_mask_projection(land_mass_polygon, mask_image,
+        mask_projection, *land_water_mask) != SUCCESS)
     {
         sprintf (errmsg, "Creating land and water mask");
         error_handler (true, FUNC_NAME, errmsg);
+        espa_free_large (*land_water_mask);
+        *land_water_mask = NULL;
+        return (ERROR);
+    }
+
+    /* Cache the mask for later scenes.  The mask is still good if it can't
+       be cached. */
+    if (write_land_water_mask_cache (land_mass_polygon, mask_image,
+        mask_projection, *land_water_mask) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to cache the land/water mask");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_grid_factor
+
+PURPOSE:  Determines how many pixels of a finer grid make up a pixel of a
+coarser grid along one direction.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+0            The coarse pixel size isn't a whole multiple of the fine one
+n            Number of fine pixels per coarse pixel
+
+NOTES:
+******************************************************************************/
+static int get_grid_factor
+(
+    double fine_size,                 /* I: pixel size of the finer grid */
+    double coarse_size                /* I: pixel size of the coarser grid */
+)
+{
+    double ratio = coarse_size / fine_size;   /* pixel size ratio */
+
+    if (ratio < 1.0 - LW_GRID_TOLERANCE ||
+        fabs (ratio - round (ratio)) > LW_GRID_TOLERANCE)
+        return (0);
+
+    return ((int) round (ratio));
+}
+
+
+/******************************************************************************
+MODULE:  get_block_range
+
+PURPOSE:  Determines the fine pixels, along one direction, a coarse pixel is
+reduced from.
+
+RETURN VALUE: None
+
+NOTES:
+1. The mask value of a pixel is the one at its sample point, so for the
+   exact reduction the range is the fine sample points next to the sample
+   point of the coarse pixel: one if they coincide, otherwise the two on
+   either side.  For the other reductions it's the fine sample points within
+   the coarse pixel.
+******************************************************************************/
+static void get_block_range
+(
+    double start,                     /* I: sample point of the coarse pixel,
+                                            in fine pixels */
+    int factor,                       /* I: fine pixels per coarse pixel */
+    Lw_reduce_t reduce,               /* I: reduction of the mixed blocks */
+    long *first,                      /* O: first fine pixel of the range */
+    long *last                        /* O: last fine pixel of the range */
+)
+{
+    if (reduce == LW_REDUCE_EXACT)
+    {
+        *first = (long) floor (start + LW_GRID_TOLERANCE);
+        *last = (long) ceil (start - LW_GRID_TOLERANCE);
+    }
+    else
+    {
+        *first = (long) ceil (start - LW_GRID_TOLERANCE);
+        *last = *first + factor - 1;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  reduce_land_water_mask
+
+PURPOSE:  Derives the land/water mask of a coarser grid from the mask of a
+finer grid, testing only the pixels of the mixed blocks against the
+land-mass polygon.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory or testing the mixed pixels
+SUCCESS      Successful completion
+
+NOTES:
+1. The coarse pixel size must be a whole multiple of the fine one (see
+   get_grid_factor), but the grids don't need to share an origin.
+2. A coarse pixel whose fine block is all land or all water takes that
+   value.  For a mixed block, the reduction picks the value: the exact
+   reduction tests the sample point of the pixel against the polygon, the
+   majority reduction takes the more common value (testing the pixel on a
+   tie), and the any-land reduction makes it land.  Pixels whose block is
+   outside the fine mask are always tested.
+3. With the exact reduction, the mask is the same as the one generated for
+   the coarse grid, except where the coastline passes between two fine
+   sample points that agree.
+******************************************************************************/
+static int reduce_land_water_mask
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *fine_image,      /* I: image grid of the fine mask */
+    const unsigned char *fine_mask,   /* I: land/water mask of the fine grid */
+    const IAS_IMAGE *mask_image,      /* I: image grid of the coarse mask */
+    const IAS_PROJECTION *mask_projection, /* I: projection of the masks */
+    Lw_reduce_t reduce,               /* I: reduction of the mixed blocks */
+    unsigned char *land_water_mask    /* O: land/water mask of the coarse
+                                            grid, nl x ns */
+)
+{
+    char FUNC_NAME[] = "reduce_land_water_mask";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int line, samp;                   /* looping variables for the coarse
+                                         mask */
+    int factor_x, factor_y;           /* fine pixels per coarse pixel */
+    long first_line, last_line;       /* fine lines of the block */
+    long first_samp, last_samp;       /* fine samples of the block */
+    long fl, fs;                      /* looping variables for the block */
+    long nland;                       /* land pixels in the block */
+    long npix;                        /* pixels in the block */
+    double offset_x, offset_y;        /* sample point of the first coarse
+                                         pixel, in fine pixels */
+    size_t index;                     /* coarse mask index */
+    size_t nmixed = 0;                /* number of pixels to be tested */
+    size_t max_mixed = 0;             /* allocated size of mixed */
+    size_t *mixed = NULL;             /* pixels to be tested */
+    size_t *new_mixed = NULL;         /* reallocated pixels to be tested */
+
+    factor_x = get_grid_factor (fine_image->pixel_size_x,
+        mask_image->pixel_size_x);
+    factor_y = get_grid_factor (fine_image->pixel_size_y,
+        mask_image->pixel_size_y);
+    offset_x = (mask_image->corners.upleft.x - fine_image->corners.upleft.x)
+        / fine_image->pixel_size_x;
+    offset_y = (fine_image->corners.upleft.y - mask_image->corners.upleft.y)
+        / fine_image->pixel_size_y;
+
+    for (line = 0; line < mask_image->nl; line++)
+    {
+        get_block_range (offset_y + (double) factor_y * line, factor_y,
+            reduce, &first_line, &last_line);
+
+        for (samp = 0; samp < mask_image->ns; samp++)
+        {
+            index = (size_t) line * mask_image->ns + samp;
+            get_block_range (offset_x + (double) factor_x * samp, factor_x,
+                reduce, &first_samp, &last_samp);
+
+            /* Count the land in the block, if it's in the fine mask */
+            nland = 0;
+            npix = 0;
+            if (first_line >= 0 && first_samp >= 0 &&
+                last_line < fine_image->nl && last_samp < fine_image->ns)
+            {
+                for (fl = first_line; fl <= last_line; fl++)
+                {
+                    for (fs = first_samp; fs <= last_samp; fs++)
+                    {
+                        if (fine_mask[(size_t) fl * fine_image->ns + fs])
+                            nland++;
+                    }
+                }
+                npix = (last_line - first_line + 1) *
+                    (last_samp - first_samp + 1);
+            }
+
+            /* Uniform blocks take their value, and the mixed ones are
+               reduced as requested */
+            if (npix > 0 && nland == 0)
+            {
+                land_water_mask[index] = 0;
+                continue;
+            }
+            if (npix > 0 && nland == npix)
+            {
+                land_water_mask[index] = IAS_GEO_SHAPE_MASK_VALID;
+                continue;
+            }
+            if (npix > 0 && reduce == LW_REDUCE_ANY_LAND)
+            {
+                land_water_mask[index] = IAS_GEO_SHAPE_MASK_VALID;
+                continue;
+            }
+            if (npix > 0 && reduce == LW_REDUCE_MAJORITY &&
+                2 * nland != npix)
+            {
+                land_water_mask[index] = (2 * nland > npix)
+                    ? IAS_GEO_SHAPE_MASK_VALID : 0;
+                continue;
+            }
+
+            /* Test the rest against the polygon */
+            if (nmixed == max_mixed)
+            {
+                max_mixed = (max_mixed == 0) ? 4096 : 2 * max_mixed;
+                new_mixed = realloc (mixed, max_mixed * sizeof (size_t));
+                if (new_mixed == NULL)
+                {
+                    sprintf (errmsg, "Allocating the list of mixed pixels");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    free (mixed);
+                    return (ERROR);
+                }
+                mixed = new_mixed;
+            }
+            mixed[nmixed++] = index;
+        }
+    }
+
+    printf ("Derived the %d x %d land/water mask from the %d x %d mask, "
+        "testing %lu mixed pixels\n", mask_image->nl, mask_image->ns,
+        fine_image->nl, fine_image->ns, (unsigned long) nmixed);
+
+    if (ias_geo_shape_mask_points (land_mass_polygon, mask_image,
+        mask_projection, nmixed, mixed, land_water_mask) != SUCCESS)
+    {
+        sprintf (errmsg, "Testing the mixed pixels of the land/water mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (mixed);
+        return (ERROR);
+    }
+    free (mixed);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  generate_land_water_masks
+
+PURPOSE:  This function creates the land/water masks (land = 1) for the area
+covered by the scene, on the grids of several representative bands, with a
+single pass over the land-mass polygon.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error occurred generating the masks
+SUCCESS      Successful completion
+
+NOTES:
+1. The mask of the finest grid is generated from the land-mass polygon, and
+   the mask of each coarser grid whose pixel size is a whole multiple of it
+   is derived from it by block reduction (see reduce_land_water_mask).  The
+   masks of the other grids are generated from the polygon.
+2. Memory for each land water mask will be allocated for the entire image
+   (nlines x nsamps x sizeof (unsigned char)) with espa_alloc_large.  It is
+   up to the calling routine to free this memory with espa_free_large.  On
+   error, none of the masks are returned.
+3. If the ESPA_LAND_WATER_MASK_CACHE environment variable names a cache
+   directory, cached masks are used as for generate_land_water_mask.  A mask
+   derived with a majority or any-land reduction isn't the mask of its grid,
+   so those reductions don't use the cache for the coarser grids, and
+   derived masks are never added to it.
+******************************************************************************/
+int generate_land_water_masks
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    int nmasks,                       /* I: number of masks (grids) */
+    const char *band_names[],         /* I: representative band of the grid
+                                            of each mask */
+    Lw_reduce_t reduce,               /* I: reduction of the mixed blocks of
+                                            the coarser grids */
+    unsigned char *land_water_mask[], /* O: land water mask buffer of each
+                                            grid, memory is allocated and the
+                                            mask is populated */
+    int nlines[],                     /* O: number of lines in each mask */
+    int nsamps[]                      /* O: number of samples in each mask */
+)
+{
+    char FUNC_NAME[] = "generate_land_water_masks";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int m;                            /* looping variable for the masks */
+    int finest = 0;                   /* mask on the finest grid */
+    int refl_indx;                    /* band index in XML file for the
+                                         representative band */
+    int status = SUCCESS;             /* return status */
+    IAS_IMAGE mask_image[LW_MAX_MASKS];    /* image grid of each mask */
+    IAS_PROJECTION mask_projection[LW_MAX_MASKS]; /* projection of each
+                                                     mask */
+
+    if (nmasks < 1 || nmasks > LW_MAX_MASKS)
+    {
+        sprintf (errmsg, "Number of land/water masks must be from 1 to %d",
+            LW_MAX_MASKS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (m = 0; m < nmasks; m++)
+        land_water_mask[m] = NULL;
+
+    /* Set up the grid of each mask */
+    for (m = 0; m < nmasks; m++)
+    {
+        refl_indx = find_band_metadata (xml_meta, NULL, band_names[m], NULL);
+        if (refl_indx < 0)
+        {
+            sprintf (errmsg, "Band %s was not found in the XML file",
+                band_names[m]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (setup_mask_grid (xml_meta, refl_indx, &mask_image[m],
+            &mask_projection[m]) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+        nlines[m] = mask_image[m].nl;
+        nsamps[m] = mask_image[m].ns;
+
+        if (mask_image[m].pixel_size_x * mask_image[m].pixel_size_y <
+            mask_image[finest].pixel_size_x * mask_image[finest].pixel_size_y)
+            finest = m;
+    }
+
+    /* Make the mask of the finest grid from the polygon */
+    if (generate_mask_for_grid (land_mass_polygon, &mask_image[finest],
+        &mask_projection[finest], &land_water_mask[finest]) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Derive the others from it where the grids nest */
+    for (m = 0; m < nmasks && status == SUCCESS; m++)
+    {
+        if (m == finest)
+            continue;
+
+        if (get_grid_factor (mask_image[finest].pixel_size_x,
+                mask_image[m].pixel_size_x) == 0 ||
+            get_grid_factor (mask_image[finest].pixel_size_y,
+                mask_image[m].pixel_size_y) == 0)
+        {
+            printf ("The %s grid doesn't nest in the %s grid; generating "
+                "its land/water mask from the polygon\n", band_names[m],
+                band_names[finest]);
+            status = generate_mask_for_grid (land_mass_polygon,
+                &mask_image[m], &mask_projection[m], &land_water_mask[m]);
+            continue;
+        }
+
+        land_water_mask[m] = espa_alloc_large ((size_t) mask_image[m].nl *
+            mask_image[m].ns * sizeof (unsigned char));
+        if (land_water_mask[m] == NULL)
+        {
+            sprintf (errmsg, "Error allocating memory for the land/water "
+                "mask.");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        if (reduce == LW_REDUCE_EXACT &&
+            read_land_water_mask_cache (land_mass_polygon, &mask_image[m],
+                &mask_projection[m], land_water_mask[m]))
+        {
+            printf ("Using the cached land/water mask\n");
+            continue;
+        }
+
+        status = reduce_land_water_mask (land_mass_polygon,
+            &mask_image[finest], land_water_mask[finest], &mask_image[m],
+            &mask_projection[m], reduce, land_water_mask[m]);
+    }
+
+    if (status != SUCCESS)
+    {
+        for (m = 0; m < nmasks; m++)
+        {
+            espa_free_large (land_water_mask[m]);
+            land_water_mask[m] = NULL;
+        }
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  generate_land_water_mask
+
+PURPOSE:  This function creates the land/water mask (land = 1) for the area
+covered by the scene.  If the output mask image name is provided, the mask
+image is written to a file with that name.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error occurred opening or reading the file
+SUCCESS      Successful completion
+
+NOTES:
+1. Memory for the land water mask will be allocated for the entire image
+   (nlines x nsamps x sizeof (unsigned char)) with espa_alloc_large.  It is
+   up to the calling routine to free this memory with espa_free_large.
+2. If the ESPA_LAND_WATER_MASK_CACHE environment variable names a cache
+   directory, a cached mask on the same grid is used when there is one, and
+   a generated mask is added to the cache.
+3. The mask is on the grid of band 1.
+******************************************************************************/
+int generate_land_water_mask
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    unsigned char **land_water_mask,  /* O: pointer to land water mask buffer,
+                                            memory is allocated and the
+                                            mask is populated */
+    int *nlines,                      /* O: number of lines in the mask */
+    int *nsamps                       /* O: number of samples in the mask */
+)
+{
+    const char *band_names[] = {"band1"};   /* band of the mask grid */
+
+    return (generate_land_water_masks (xml_meta, land_mass_polygon, 1,
+        band_names, LW_REDUCE_EXACT, land_water_mask, nlines, nsamps));
+}
+
+
+/******************************************************************************
+MODULE:  write_land_water_mask_band
+
+PURPOSE: Writes a land/water mask to its output file, and sets up the band
+metadata for it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the land/water mask
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The land/water mask filename is the same as the representative band in
+     the input XML file, with the _B1.img replaced with _land_water_mask.img
+     for band 1 and _land_water_mask_<band>.img for the other bands.
+  2. The band is written bit-packed or run-length encoded when
+     ESPA_MASK_CODEC is set to "bitpack" or "rle" (see
+     get_raw_binary_mask_codec).  The readers in raw_binary_io expand it as
+     it is read.
+  3. When ESPA_PERCENT_COVER is yes, the percentages of water and land are
+     computed while the band is written and returned in its percent_cover.
+******************************************************************************/
+static int write_land_water_mask_band
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char band_name[],           /* I: representative band of the mask
+                                            grid */
+    const char production_date[],     /* I: production date of the band */
+    unsigned char *land_water_mask,   /* I: land/water mask, nl x ns */
+    int nlines,                       /* I: number of lines in the mask */
+    int nsamps,                       /* I: number of samples in the mask */
+    Espa_band_meta_t *out_bmeta       /* O: band metadata for the land/water
+                                            mask */
+)
+{
+    char FUNC_NAME[] = "write_land_water_mask_band";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char maskfile[STR_SIZE];     /* output land/water mask filename */
+    char *cptr = NULL;           /* character pointer for the '_' in filename */
+    int refl_indx = -9;          /* index of the representative band */
+    Raw_binary_writer_t rbw;     /* writer for the land/water mask */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* pointer to global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+
+    /* Find the representative band in the XML */
+    refl_indx = find_band_metadata (xml_meta, NULL, band_name, NULL);
+    if (refl_indx < 0)
+    {
+        sprintf (errmsg, "Band %s was not found in the XML file", band_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Make sure the number of lines and samples of the band matches what
+       was used for creating the land/water mask, otherwise we will have a
+       mismatch in the resolution and output XML information. */
+    bmeta = &xml_meta->band[refl_indx];
+    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
+    {
+        sprintf (errmsg, "Band %s from this application does not match the "
+            "band from the generate_land_water_mask function call.  Local "
+            "nlines/nsamps: %d, %d   Returned nlines/nsamps: %d, %d",
+            band_name, bmeta->nlines, bmeta->nsamps, nlines, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the band metadata for the land/water mask */
+    strcpy (out_bmeta->product, "intermediate_data");
+    strcpy (out_bmeta->source, "level1");
+    if (!strcmp (band_name, "band1"))
+        strcpy (out_bmeta->name, "land_water_mask");
+    else
+        snprintf (out_bmeta->name, sizeof (out_bmeta->name),
+            "land_water_mask_%s", band_name);
+    strcpy (out_bmeta->category, "qa");
+    out_bmeta->data_type = ESPA_UINT8;
+    out_bmeta->nlines = nlines;
+    out_bmeta->nsamps = nsamps;
+    strncpy (tmpstr, bmeta->short_name, 3);
+    sprintf (out_bmeta->short_name, "%sLWMASK", tmpstr);
+    strcpy (out_bmeta->long_name, "static land/water mask");
+    out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+    out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+    strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+    strcpy (out_bmeta->data_units, "quality/feature classification");
+    out_bmeta->valid_range[0] = 0.0;
+    out_bmeta->valid_range[1] = 1.0;
+    sprintf (out_bmeta->app_version, "create_land_water_mask_%s",
+        ESPA_COMMON_VERSION);
+
+    /* Use the representative band filename to create the land/mask
+       filename */
+    strcpy (out_bmeta->file_name, bmeta->file_name);
+    cptr = strrchr (out_bmeta->file_name, '_');
+    if (!cptr)
+    {
+        sprintf (errmsg, "Unable to find the _ in the %s filename for "
+            "creating the land/water mask filename.", band_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    sprintf (cptr, "_%s.img", out_bmeta->name);
+
+    /* Set up the 2 classes for land (1) and water (0) */
+    out_bmeta->nclass = 2;
+    if (allocate_class_metadata (out_bmeta, 2) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the classes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    out_bmeta->class_values[0].class = 0;
+    out_bmeta->class_values[1].class = 1;
+    strcpy (out_bmeta->class_values[0].description, "water");
+    strcpy (out_bmeta->class_values[1].description, "land");
+    strcpy (out_bmeta->production_date, production_date);
+
+    /* Write the land/water mask file, encoded as requested for mask bands */
+    strcpy (maskfile, out_bmeta->file_name);
+    if (open_raw_binary_writer (maskfile, get_raw_binary_cache_mode (),
+        get_raw_binary_mask_codec (), &rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to open the land/water mask file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (use_raw_binary_cover () &&
+        attach_raw_binary_cover (&rbw, out_bmeta) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to compute the percent coverage of the "
+            "land/water mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_writer (&rbw);
+        return (ERROR);
+    }
+
+    /* Write the data for this band */
+    if (write_raw_binary_writer (&rbw, nlines, nsamps, sizeof (unsigned char),
+        land_water_mask) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to write to the land/water mask file");
+        error_handler (true, FUNC_NAME, errmsg);
+        close_raw_binary_writer (&rbw);
+        return (ERROR);
+    }
+
+    /* Close the file for this band */
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to complete the land/water mask file");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Create the ENVI header using the representative band */
+    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Error creating the ENVI header file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the ENVI header */
+    sprintf (tmpstr, "%s", maskfile);
+    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+        error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
     return (SUCCESS);
 }
+
+
+/******************************************************************************
+MODULE:  create_land_water_masks
+
+PURPOSE: Creates the land/water masks for the current scene on the grids of
+several representative bands, writes them to the output land/water mask
+files, and sets up the band metadata for them.  The land/water masks are
+generated from a static land-mass polygon with a single pass over it (see
+generate_land_water_masks).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water masks
+SUCCESS         No errors encountered
+
+NOTES:
+  1. See write_land_water_mask_band for the names and encoding of the
+     output bands.
+  2. The band data and ENVI headers are written by this routine.  The bands
+     are returned in out_meta, in the order of band_names, but are not added
+     to the XML metadata; it is up to the caller to append them to the XML
+     file or the metadata structure.  The caller is responsible for calling
+     free_metadata on out_meta.
+******************************************************************************/
+int create_land_water_masks
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    int nmasks,                       /* I: number of masks (grids) */
+    const char *band_names[],         /* I: representative band of the grid
+                                            of each mask */
+    Lw_reduce_t reduce,               /* I: reduction of the mixed blocks of
+                                            the coarser grids */
+    Espa_internal_meta_t *out_meta    /* O: metadata for the land/water mask
+                                            bands; global metadata is not
+                                            valid */
+)
+{
+    char FUNC_NAME[] = "create_land_water_masks";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char production_date[MAX_DATE_LEN+1]; /* current date/time for production */
+    int m;                       /* looping variable for the masks */
+    int nlines[LW_MAX_MASKS];    /* number of lines in each mask */
+    int nsamps[LW_MAX_MASKS];    /* number of samples in each mask */
+    int status = SUCCESS;        /* return status */
+    unsigned char *land_water_mask[LW_MAX_MASKS];  /* land/water masks */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+
+    /* Generate the land/water masks for this scene. Memory is allocated for
+       the land/water masks. */
+    if (generate_land_water_masks (xml_meta, land_mass_polygon, nmasks,
+        band_names, reduce, land_water_mask, nlines, nsamps) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    /* Allocate memory for the output bands */
+    if (allocate_band_metadata (out_meta, nmasks) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the land/water mask "
+            "bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (status == SUCCESS && time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (status == SUCCESS)
+    {
+        tm = gmtime (&tp);
+        if (tm == NULL)
+        {
+            sprintf (errmsg, "Converting time to UTC.");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    if (status == SUCCESS &&
+        strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm)
+        == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Write each mask with its ENVI header */
+    for (m = 0; m < nmasks && status == SUCCESS; m++)
+    {
+        status = write_land_water_mask_band (xml_meta, band_names[m],
+            production_date, land_water_mask[m], nlines[m], nsamps[m],
+            &out_meta->band[m]);
+    }
+
+    for (m = 0; m < nmasks; m++)
+        espa_free_large (land_water_mask[m]);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  create_land_water_mask
+
+PURPOSE: Creates the land/water mask for the current scene, writes it to the
+output land/water mask file, and sets up the band metadata for it.  The
+land/water mask is generated from a static land-mass polygon.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water mask
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The land/water mask filename is the same as band 1 in the input XML file
+     with the _B1.img replaced with _land_water_mask.img.
+  2. The band data and ENVI header are written by this routine.  The band is
+     returned in out_meta but is not added to the XML metadata; it is up to
+     the caller to append it to the XML file or the metadata structure.  The
+     caller is responsible for calling free_metadata on out_meta.
+  3. The band is written bit-packed or run-length encoded when
+     ESPA_MASK_CODEC is set to "bitpack" or "rle" (see
+     get_raw_binary_mask_codec).  The readers in raw_binary_io expand it as
+     it is read.
+  4. When ESPA_PERCENT_COVER is yes, the percentages of water and land are
+     computed while the band is written and returned in its percent_cover.
+******************************************************************************/
+int create_land_water_mask
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    Espa_internal_meta_t *out_meta    /* O: metadata for the land/water mask
+                                            band; global metadata is not
+                                            valid */
+)
+{
+    const char *band_names[] = {"band1"};   /* band of the mask grid */
+
+    return (create_land_water_masks (xml_meta, land_mass_polygon, 1,
+        band_names, LW_REDUCE_EXACT, out_meta));
+}
@@ -1,9 +1,13 @@
 #ifndef LAND_WATER_MASK_H
 #define LAND_WATER_MASK_H
 
+#include <stdint.h>
+
 /* ESPA Includes */
 #include "error_handler.h"
 #include "espa_metadata.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
 #include "espa_hdf_eos.h"
 
 /* IAS Includes */
@@ -12,6 +16,48 @@
 
 #define NAME_STRLEN  256
 
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
+
+/* Maximum number of grids the land/water masks are made for at once */
+#define LW_MAX_MASKS 4
+
+/* How the land/water mask of a coarser grid is derived from the mask of the
+   finest grid, for blocks with both land and water (see
+   generate_land_water_masks) */
+typedef enum {
+    LW_REDUCE_EXACT,      /* test the pixel against the polygon */
+    LW_REDUCE_MAJORITY,   /* take the more common of land and water */
+    LW_REDUCE_ANY_LAND    /* make the pixel land */
+} Lw_reduce_t;
+
+/* Land/water raster pyramid file (see land_water_raster.c) */
+#define LW_RASTER_MAGIC "ESPALWR1"
+#define LW_RASTER_VERSION 1
+#define LW_RASTER_MAX_LEVELS 8
+
+/* Tile index codes of tiles which are all water or all land; any other code
+   is the file offset of the bits of the tile */
+#define LW_RASTER_WATER 0
+#define LW_RASTER_LAND 1
+
+/* Header at the start of a land/water raster file, in native byte order */
+typedef struct
+{
+    char magic[8];                  /* LW_RASTER_MAGIC, not terminated */
+    uint32_t version;               /* LW_RASTER_VERSION */
+    uint32_t nlevels;               /* number of levels, finest first */
+    uint32_t tile_size;             /* cells along each side of a tile */
+    uint32_t cells_per_degree;      /* cells per degree of the finest level;
+                                       each level has half the cells per
+                                       degree of the one before */
+    uint64_t level_offset[LW_RASTER_MAX_LEVELS];  /* file offset of the tile
+                                       index of each level */
+} Lw_raster_header_t;
+
+/* Land/water raster opened for reading */
+typedef struct lw_raster Lw_raster_t;
+
 double deg_to_dms
 (
     double flt_deg   /* I: input decimal degree value */
@@ -28,4 +74,92 @@ int generate_land_water_mask
     int *nsamps                       /* O: number of samples in the mask */
 );
 
+int generate_land_water_masks
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    int nmasks,                       /* I: number of masks (grids) */
+    const char *band_names[],         /* I: representative band of the grid
+                                            of each mask */
+    Lw_reduce_t reduce,               /* I: reduction of the mixed blocks of
+                                            the coarser grids */
+    unsigned char *land_water_mask[], /* O: land water mask buffer of each
+                                            grid, memory is allocated and the
+                                            mask is populated */
+    int nlines[],                     /* O: number of lines in each mask */
+    int nsamps[]                      /* O: number of samples in each mask */
+);
+
+int create_land_water_masks
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    int nmasks,                       /* I: number of masks (grids) */
+    const char *band_names[],         /* I: representative band of the grid
+                                            of each mask */
+    Lw_reduce_t reduce,               /* I: reduction of the mixed blocks of
+                                            the coarser grids */
+    Espa_internal_meta_t *out_meta    /* O: metadata for the land/water mask
+                                            bands; global metadata is not
+                                            valid */
+);
+
+int create_land_water_mask
+(
+    Espa_internal_meta_t *xml_meta,   /* I: input XML metadata */
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    Espa_internal_meta_t *out_meta    /* O: metadata for the land/water mask
+                                            band; global metadata is not
+                                            valid */
+);
+
+int write_land_water_raster
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const char raster_file[],         /* I: name of the raster file */
+    int cells_per_degree,             /* I: cells per degree of the finest
+                                            level */
+    int nlevels,                      /* I: number of levels */
+    int tile_size                     /* I: cells along each side of a
+                                            tile; a multiple of 8 */
+);
+
+Lw_raster_t *open_land_water_raster
+(
+    const char raster_file[]          /* I: name of the raster file */
+);
+
+void close_land_water_raster
+(
+    Lw_raster_t *raster               /* I: raster to be closed, or NULL */
+);
+
+Lw_raster_t *get_land_water_raster (void);
+
+int raster_land_water_mask
+(
+    const Lw_raster_t *raster,        /* I: land/water raster */
+    const IAS_IMAGE *image,           /* I: image grid of the mask */
+    const IAS_PROJECTION *projection, /* I: projection of the mask */
+    unsigned char *land_water_mask,   /* O: land/water mask, nl x ns */
+    bool *used                        /* O: was the mask made from the
+                                            raster? */
+);
+
+bool read_land_water_mask_cache
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *image,           /* I: mask image grid */
+    const IAS_PROJECTION *projection, /* I: mask projection */
+    unsigned char *land_water_mask    /* O: land/water mask, nl x ns */
+);
+
+int write_land_water_mask_cache
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *image,           /* I: mask image grid */
+    const IAS_PROJECTION *projection, /* I: mask projection */
+    const unsigned char *land_water_mask  /* I: land/water mask, nl x ns */
+);
+
 #endif
@@ -6,15 +6,25 @@ Purpose: Provides a wrapper around GCTP.
 Notes:
     - It might be useful add a routine to print out transformation info by
       echoing through to the gctp_print_transformation_info routine
+    - Batch and daemon processing keeps needing the same few transformations
+      (geographic to the UTM zones of the scenes), so the transformations
+      released by ias_geo_release_proj_transformation are kept in a cache
+      and handed out again by ias_geo_get_proj_transformation instead of
+      initializing GCTP again.  A cached transformation is only used by one
+      caller at a time.  Transformations which aren't threadsafe keep state
+      in GCTP globals which the next transformation may overwrite, so they
+      aren't cached.
 
 *****************************************************************************/
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <pthread.h>
 #include "gctp.h"
 #include "ias_logging.h"
 #include "ias_lw_geo.h"
 #include "ias_const.h"
+#include "espa_profile.h"
 
 /* Declare a private structure to store information about a projection
    transformation. */
@@ -31,8 +41,17 @@ struct ias_geo_proj_transformation
                                    so they can be converted to degrees */
     int target_is_dms;          /* Flag to indicate the target units are DMS
                                    so they can be converted to degrees */
+    IAS_PROJECTION source;      /* Source projection, the cache key */
+    IAS_PROJECTION target;      /* Target projection, the cache key */
 };
 
+/* Transformations released to the cache, oldest first, and the lock for
+   them */
+static IAS_GEO_PROJ_TRANSFORMATION
+    *cached_transformations[IAS_GEO_PROJ_CACHE_SIZE];
+static int num_cached_transformations = 0;
+static pthread_mutex_t transformation_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*****************************************************************************
 Name: copy_ias_proj_to_gctp_proj
 
@@ -166,6 +185,10 @@ IAS_GEO_PROJ_TRANSFORMATION *ias_geo_create_proj_transformation
         return NULL;
     }
 
+    /* Save the projections as the cache key */
+    trans->source = *source_projection;
+    trans->target = *target_projection;
+
     /* Copy the source IAS projection to the GCTP version of a projection */
     copy_ias_proj_to_gctp_proj(source_projection, &source_proj);
     if (source_proj.units == DMS)
@@ -239,6 +262,147 @@ void ias_geo_destroy_proj_transformation
     }
 }
 
+/*****************************************************************************
+Name: is_same_projection
+
+Purpose: Determines whether two projections are the same, field by field.
+
+Returns: TRUE if the projections are the same, FALSE if they are not
+
+*****************************************************************************/
+static int is_same_projection
+(
+    const IAS_PROJECTION *proj1,    /* I: first projection */
+    const IAS_PROJECTION *proj2     /* I: second projection */
+)
+{
+    int i;
+
+    if (proj1->proj_code != proj2->proj_code || proj1->zone != proj2->zone
+        || proj1->units != proj2->units || proj1->spheroid != proj2->spheroid)
+        return FALSE;
+
+    for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+    {
+        if (proj1->parameters[i] != proj2->parameters[i])
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************
+Name: ias_geo_get_proj_transformation
+
+Purpose: Gets a projection transformation from the cache, or creates it if
+    the cache doesn't have an unused one for the projections.
+
+Returns: A pointer to the transformation or NULL if there is an error.
+
+Notes:
+    - The caller has the only use of the transformation until it's given
+      back with ias_geo_release_proj_transformation.
+
+*****************************************************************************/
+IAS_GEO_PROJ_TRANSFORMATION *ias_geo_get_proj_transformation
+(
+    const IAS_PROJECTION *source_projection, /* I: source projection */
+    const IAS_PROJECTION *target_projection  /* I: target projection */
+)
+{
+    IAS_GEO_PROJ_TRANSFORMATION *trans = NULL; /* transformation found */
+    int i;
+
+    /* Take the most recently released transformation for the projections
+       out of the cache */
+    pthread_mutex_lock(&transformation_cache_lock);
+    for (i = num_cached_transformations - 1; i >= 0; i--)
+    {
+        if (is_same_projection(&cached_transformations[i]->source,
+                source_projection)
+            && is_same_projection(&cached_transformations[i]->target,
+                target_projection))
+        {
+            trans = cached_transformations[i];
+            num_cached_transformations--;
+            memmove(&cached_transformations[i], &cached_transformations[i + 1],
+                (num_cached_transformations - i) * sizeof(trans));
+            break;
+        }
+    }
+    pthread_mutex_unlock(&transformation_cache_lock);
+
+    espa_profile_count_cache(ESPA_PROFILE_CACHE_TRANSFORM, trans != NULL);
+    if (trans)
+        return trans;
+
+    return ias_geo_create_proj_transformation(source_projection,
+        target_projection);
+}
+
+/*****************************************************************************
+Name: ias_geo_release_proj_transformation
+
+Purpose: Gives back a transformation from ias_geo_get_proj_transformation,
+    keeping it in the cache for the next caller needing the same projections.
+
+Returns: nothing
+
+Notes:
+    - When the cache is full, the transformation released the longest ago
+      is destroyed.  Transformations which aren't threadsafe are destroyed
+      right away.
+
+*****************************************************************************/
+void ias_geo_release_proj_transformation
+(
+    IAS_GEO_PROJ_TRANSFORMATION *trans
+)
+{
+    IAS_GEO_PROJ_TRANSFORMATION *evicted = NULL; /* transformation removed
+                                                    from the cache */
+
+    if (!trans)
+        return;
+    if (!ias_geo_is_threadsafe_transformation(trans))
+    {
+        ias_geo_destroy_proj_transformation(trans);
+        return;
+    }
+
+    pthread_mutex_lock(&transformation_cache_lock);
+    if (num_cached_transformations == IAS_GEO_PROJ_CACHE_SIZE)
+    {
+        evicted = cached_transformations[0];
+        num_cached_transformations--;
+        memmove(&cached_transformations[0], &cached_transformations[1],
+            num_cached_transformations * sizeof(trans));
+    }
+    cached_transformations[num_cached_transformations++] = trans;
+    pthread_mutex_unlock(&transformation_cache_lock);
+
+    ias_geo_destroy_proj_transformation(evicted);
+}
+
+/*****************************************************************************
+Name: ias_geo_clear_proj_transformation_cache
+
+Purpose: Destroys the transformations kept in the cache.
+
+Returns: nothing
+
+*****************************************************************************/
+void ias_geo_clear_proj_transformation_cache()
+{
+    int i;
+
+    pthread_mutex_lock(&transformation_cache_lock);
+    for (i = 0; i < num_cached_transformations; i++)
+        ias_geo_destroy_proj_transformation(cached_transformations[i]);
+    num_cached_transformations = 0;
+    pthread_mutex_unlock(&transformation_cache_lock);
+}
+
 /****************************************************************************
 Name: ias_geo_only_allow_threadsafe_transforms
 
@@ -258,6 +422,27 @@ void ias_geo_only_allow_threadsafe_transforms()
     gctp_only_allow_threadsafe_transforms();
 }
 
+/****************************************************************************
+Name: ias_geo_is_threadsafe_transformation
+
+Purpose: Determines whether a transformation is threadsafe, meaning separate
+    transformations created from the same projections can be used from
+    different threads at the same time.
+
+Returns:
+    TRUE if the transformation is threadsafe, FALSE if it is not
+
+****************************************************************************/
+int ias_geo_is_threadsafe_transformation
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans
+)
+{
+    if (gctp_is_threadsafe_transformation(trans->gctp_transform))
+        return TRUE;
+    return FALSE;
+}
+
 /*****************************************************************************
 Name: ias_geo_transform_coordinate
 
@@ -372,3 +557,74 @@ int ias_geo_transform_coordinate
     return SUCCESS;
 }
 
+
+/*****************************************************************************
+Name: ias_geo_transform_coordinates
+
+Purpose: Using a projection transformation, convert an array of input
+    coordinates from the source projection to the target projection.  This
+    gives the same results as calling ias_geo_transform_coordinate for each
+    coordinate, but the transformation setup is only done once for the array.
+
+Returns: SUCCESS or ERROR
+
+Notes:
+    - The output arrays may be the same as the input arrays.
+    - Transformations that need SOM coordinate swapping or DMS units are
+      converted one coordinate at a time.
+*****************************************************************************/
+int ias_geo_transform_coordinates
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,              /* I: Number of coordinates */
+    const double *inx,      /* I: Input X projection coordinates */
+    const double *iny,      /* I: Input Y projection coordinates */
+    double *outx,           /* O: Output X projection coordinates */
+    double *outy            /* O: Output Y projection coordinates */
+)
+{
+    int status;          /* Status code from call to GCTP */
+    int index;           /* Coordinate loop counter */
+
+    /* Verify the transformation provided is valid */
+    if (trans == NULL)
+    {
+        IAS_LOG_ERROR("Invalid transformation provided");
+        return ERROR;
+    }
+
+    /* The SOM and DMS conversions are only done one coordinate at a time */
+    if (trans->source_is_som || trans->target_is_som || trans->source_is_dms
+        || trans->target_is_dms)
+    {
+        for (index = 0; index < count; index++)
+        {
+            if (ias_geo_transform_coordinate(trans, inx[index], iny[index],
+                &outx[index], &outy[index]) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Transforming coordinate %d", index);
+                return ERROR;
+            }
+        }
+        return SUCCESS;
+    }
+
+    /* Call the GCTP transformation routine for all the coordinates */
+    status = gctp_transform_batch(trans->gctp_transform, count, inx, iny,
+        outx, outy);
+    if (status != GCTP_SUCCESS)
+    {
+        if (status == GCTP_IN_BREAK)
+        {
+            /* We don't support any projections that can have break areas, so
+               just include some rudimentary support for it, but consider it an
+               error for now */
+            IAS_LOG_ERROR("In projection break");
+            return ERROR;
+        }
+        IAS_LOG_ERROR("Failed converting between coordinate systems in GCTP");
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
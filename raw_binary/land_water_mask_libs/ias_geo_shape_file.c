@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* IAS Library Includes */
 #include "ias_lw_geo.h"
@@ -917,3 +921,1754 @@ int ias_geo_reduce_polygon
     }
     return SUCCESS;
 }
+
+/*****************************************************************************
+NAME:  set_polygon_extent
+
+PURPOSE:  Set the bounds of a polygon from its vertices and rebuild its
+          segments, in groups of IAS_POLYGON_SEGMENT_SIZE sides.  Polygons
+          with no more sides than that are left without segments.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  Any existing segments are freed, so the polygon must own them.
+*****************************************************************************/
+static int set_polygon_extent
+(
+    IAS_POLYGON_LINKED_LIST *polygon    /* I/O: Polygon to update */
+)
+{
+    unsigned int num_points = polygon->num_points; /* Number of vertices */
+    unsigned int point;         /* Point loop counter */
+    unsigned int seg;           /* Segment loop counter */
+
+    free(polygon->poly_seg);
+    polygon->poly_seg = NULL;
+    polygon->num_segs = (num_points - 1 > IAS_POLYGON_SEGMENT_SIZE)
+        ? (num_points - 2) / IAS_POLYGON_SEGMENT_SIZE + 1 : 0;
+    if (polygon->num_segs > 0)
+    {
+        polygon->poly_seg = malloc(polygon->num_segs
+            * sizeof(IAS_POLYGON_SEGMENT));
+        if (!polygon->poly_seg)
+        {
+            IAS_LOG_ERROR("Allocating memory for the polygon segments");
+            polygon->num_segs = 0;
+            return ERROR;
+        }
+    }
+
+    for (seg = 0; seg < polygon->num_segs; seg++)
+    {
+        IAS_POLYGON_SEGMENT *segment = &polygon->poly_seg[seg];
+
+        segment->first_point = seg * IAS_POLYGON_SEGMENT_SIZE;
+        segment->last_point = segment->first_point + IAS_POLYGON_SEGMENT_SIZE;
+        if (segment->last_point > num_points - 1)
+            segment->last_point = num_points - 1;
+        segment->min_x = segment->max_x
+            = polygon->point_x[segment->first_point];
+        segment->min_y = segment->max_y
+            = polygon->point_y[segment->first_point];
+        for (point = segment->first_point + 1;
+             point <= segment->last_point; point++)
+        {
+            segment->min_x = fmin(segment->min_x, polygon->point_x[point]);
+            segment->max_x = fmax(segment->max_x, polygon->point_x[point]);
+            segment->min_y = fmin(segment->min_y, polygon->point_y[point]);
+            segment->max_y = fmax(segment->max_y, polygon->point_y[point]);
+        }
+    }
+
+    polygon->min_x = polygon->max_x = polygon->point_x[0];
+    polygon->min_y = polygon->max_y = polygon->point_y[0];
+    for (point = 1; point < num_points; point++)
+    {
+        polygon->min_x = fmin(polygon->min_x, polygon->point_x[point]);
+        polygon->max_x = fmax(polygon->max_x, polygon->point_x[point]);
+        polygon->min_y = fmin(polygon->min_y, polygon->point_y[point]);
+        polygon->max_y = fmax(polygon->max_y, polygon->point_y[point]);
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  clip_ring_to_edge
+
+PURPOSE:  Clip a closed ring of vertices to one side of the clip box, keeping
+          the vertices on the inside of the edge and adding a vertex where
+          each side of the ring crosses it (one Sutherland-Hodgman stage).
+
+RETURN VALUE:
+Type = unsigned int
+Value    Description
+-----    -----------
+count    Number of output vertices, including the final point that
+         duplicates the first point (0 if the ring is entirely outside)
+
+NOTES:  The output arrays must hold at least twice the number of input
+        vertices, less one.
+*****************************************************************************/
+static unsigned int clip_ring_to_edge
+(
+    unsigned int num_points,    /* I: Number of input vertices, including the
+                                      final point that duplicates the first */
+    const double *in_x,         /* I: Input x vertices */
+    const double *in_y,         /* I: Input y vertices */
+    int edge,                   /* I: Clip edge: 0 = min x, 1 = max x,
+                                      2 = min y, 3 = max y */
+    double limit,               /* I: Coordinate of the clip edge */
+    double *out_x,              /* O: Output x vertices */
+    double *out_y               /* O: Output y vertices */
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of output vertices */
+    const double *in_value;     /* Input coordinate compared to the edge */
+    double sign;                /* Sign of the inside of the edge */
+
+    if (num_points < 2)
+        return 0;
+
+    in_value = (edge < 2) ? in_x : in_y;
+    sign = (edge % 2 == 0) ? 1.0 : -1.0;
+
+    for (point = 0; point + 1 < num_points; point++)
+    {
+        int inside;             /* First vertex of the side is inside */
+        int next_inside;        /* Second vertex of the side is inside */
+
+        inside = sign * (in_value[point] - limit) >= 0.0;
+        next_inside = sign * (in_value[point + 1] - limit) >= 0.0;
+
+        if (inside)
+        {
+            out_x[count] = in_x[point];
+            out_y[count] = in_y[point];
+            count++;
+        }
+
+        /* Add the crossing when the side goes through the edge */
+        if (inside != next_inside)
+        {
+            double fraction = (limit - in_value[point])
+                / (in_value[point + 1] - in_value[point]);
+
+            if (edge < 2)
+            {
+                out_x[count] = limit;
+                out_y[count] = in_y[point]
+                    + fraction * (in_y[point + 1] - in_y[point]);
+            }
+            else
+            {
+                out_x[count] = in_x[point]
+                    + fraction * (in_x[point + 1] - in_x[point]);
+                out_y[count] = limit;
+            }
+            count++;
+        }
+    }
+
+    /* Close the ring, unless fewer than three vertices are left */
+    if (count < 3)
+        return 0;
+    out_x[count] = out_x[0];
+    out_y[count] = out_y[0];
+
+    return count + 1;
+}
+
+/*****************************************************************************
+NAME:  clip_polygon_group
+
+PURPOSE:  Build a copy of a polygon list, and the children of each polygon,
+          clipped to a box.  Polygons that don't overlap the box, or that are
+          clipped away, are left out along with their children.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The clipped polygons are closed along the sides of the box.  For
+        points strictly inside the box, the even/odd crossing tests give the
+        same result as for the original polygons.
+*****************************************************************************/
+static int clip_polygon_group
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: First polygon in list */
+    const double clip_box[4],   /* I: Min x, max x, min y, max y of the box */
+    IAS_POLYGON_LINKED_LIST **head          /* O: First clipped polygon */
+)
+{
+    IAS_POLYGON_LINKED_LIST *list_tail = NULL; /* Tail of the clipped list */
+
+    *head = NULL;
+    for (; polygon; polygon = polygon->next)
+    {
+        IAS_POLYGON_LINKED_LIST *clipped;   /* New clipped polygon */
+        double *point_x = NULL; /* Clipped x vertices */
+        double *point_y = NULL; /* Clipped y vertices */
+        unsigned int num_points;/* Number of clipped vertices */
+        int edge;               /* Clip edge loop counter */
+
+        /* Skip the polygon, and its children, if it is outside the box */
+        if (polygon->num_points < 4 || polygon->min_x > clip_box[1]
+            || polygon->max_x < clip_box[0] || polygon->min_y > clip_box[3]
+            || polygon->max_y < clip_box[2])
+            continue;
+
+        /* Clip to each edge of the box the polygon extends past.  The
+           vertices of the original polygon are only read, by the first
+           stage, or copied when no stage is needed. */
+        num_points = polygon->num_points;
+        for (edge = 0; edge < 4 && num_points > 0; edge++)
+        {
+            double *next_x;     /* Output x vertices of the stage */
+            double *next_y;     /* Output y vertices of the stage */
+
+            if ((edge == 0 && polygon->min_x >= clip_box[0])
+                || (edge == 1 && polygon->max_x <= clip_box[1])
+                || (edge == 2 && polygon->min_y >= clip_box[2])
+                || (edge == 3 && polygon->max_y <= clip_box[3]))
+                continue;
+
+            /* Each side adds at most its first vertex and a crossing */
+            next_x = malloc(2 * num_points * sizeof(double));
+            next_y = malloc(2 * num_points * sizeof(double));
+            if (!next_x || !next_y)
+            {
+                IAS_LOG_ERROR("Allocating memory for the clipped polygon");
+                free(next_x);
+                free(next_y);
+                free(point_x);
+                free(point_y);
+                ias_geo_free_polygon_linked_list(*head);
+                *head = NULL;
+                return ERROR;
+            }
+
+            num_points = clip_ring_to_edge(num_points,
+                point_x ? point_x : polygon->point_x,
+                point_y ? point_y : polygon->point_y, edge, clip_box[edge],
+                next_x, next_y);
+            free(point_x);
+            free(point_y);
+            point_x = next_x;
+            point_y = next_y;
+        }
+
+        if (num_points == 0)
+        {
+            free(point_x);
+            free(point_y);
+            continue;
+        }
+
+        /* The polygon is inside the box, so copy it as it is */
+        if (!point_x)
+        {
+            point_x = malloc(num_points * sizeof(double));
+            point_y = malloc(num_points * sizeof(double));
+            if (point_x && point_y)
+            {
+                memcpy(point_x, polygon->point_x,
+                    num_points * sizeof(double));
+                memcpy(point_y, polygon->point_y,
+                    num_points * sizeof(double));
+            }
+        }
+
+        clipped = calloc(1, sizeof(IAS_POLYGON_LINKED_LIST));
+        if (!point_x || !point_y || !clipped)
+        {
+            IAS_LOG_ERROR("Allocating memory for the clipped polygon");
+            free(point_x);
+            free(point_y);
+            free(clipped);
+            ias_geo_free_polygon_linked_list(*head);
+            *head = NULL;
+            return ERROR;
+        }
+
+        clipped->id = polygon->id;
+        clipped->num_points = num_points;
+        clipped->point_x = point_x;
+        clipped->point_y = point_y;
+
+        /* Add the polygon to the tail of the list */
+        if (list_tail)
+        {
+            list_tail->next = clipped;
+            clipped->prev = list_tail;
+        }
+        else
+            *head = clipped;
+        list_tail = clipped;
+
+        /* Find the bounds and rebuild the segments for the new vertices */
+        if (set_polygon_extent(clipped) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Setting the extent of clipped polygon %u",
+                polygon->id);
+            ias_geo_free_polygon_linked_list(*head);
+            *head = NULL;
+            return ERROR;
+        }
+
+        /* Clip the children the same way */
+        if (polygon->child && clip_polygon_group(polygon->child, clip_box,
+            &clipped->child) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Clipping the children of polygon %u",
+                polygon->id);
+            ias_geo_free_polygon_linked_list(*head);
+            *head = NULL;
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_clip_polygon
+
+PURPOSE:  Clip a polygon list to a bounding box.  Polygons, and children,
+          outside the box are discarded, and the rest are cut down to the
+          part inside the box, so the work to use them depends on the detail
+          inside the box rather than the size of the original polygons.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The input list is not changed, so it can be a list loaded from a
+        packed polygon file.  The clipped list is newly allocated and must be
+        freed with ias_geo_free_polygon_linked_list.  A point on the edge of
+        the box may test differently against the clipped polygons, so the
+        box should be padded past the points of interest.  A box crossing
+        180 longitude can't be used.
+*****************************************************************************/
+int ias_geo_clip_polygon
+(
+    const IAS_POLYGON_LINKED_LIST *polygon_list, /* I: First polygon in list */
+    double upper_left_x,                    /* I: Upper left x */
+    double lower_right_x,                   /* I: Lower right x */
+    double upper_left_y,                    /* I: Upper left y */
+    double lower_right_y,                   /* I: Lower right y */
+    IAS_POLYGON_LINKED_LIST **clipped_list  /* O: First clipped polygon */
+)
+{
+    double clip_box[4];         /* Min x, max x, min y, max y of the box */
+
+    *clipped_list = NULL;
+
+    if (upper_left_x > lower_right_x)
+    {
+        IAS_LOG_ERROR(
+            "Upper left longitude greater than lower right longitude");
+        return ERROR;
+    }
+
+    if (upper_left_y < lower_right_y)
+    {
+        IAS_LOG_ERROR("Upper left latitude less than lower right latitude");
+        return ERROR;
+    }
+
+    clip_box[0] = upper_left_x;
+    clip_box[1] = lower_right_x;
+    clip_box[2] = lower_right_y;
+    clip_box[3] = upper_left_y;
+
+    return clip_polygon_group(polygon_list, clip_box, clipped_list);
+}
+
+/*****************************************************************************
+NAME:  ias_geo_shift_polygon
+
+PURPOSE:  Move the polygons in a list, and all their children, along x, such
+          as by 360 degrees of longitude to bring polygons west of -180 next
+          to a mask east of 180.
+
+RETURN VALUE: None
+
+NOTES:  The polygons are changed in place, so they must own their vertices
+        and segments; a list loaded from a packed polygon file can't be
+        shifted, but a clipped copy of it can.
+*****************************************************************************/
+void ias_geo_shift_polygon
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list,  /* I/O: First polygon in list */
+    double shift_x                          /* I: Amount added to x */
+)
+{
+    IAS_POLYGON_LINKED_LIST *polygon;   /* Current polygon */
+    unsigned int point;                 /* Point loop counter */
+    unsigned int seg;                   /* Segment loop counter */
+
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+    {
+        for (point = 0; point < polygon->num_points; point++)
+            polygon->point_x[point] += shift_x;
+        for (seg = 0; seg < polygon->num_segs; seg++)
+        {
+            polygon->poly_seg[seg].min_x += shift_x;
+            polygon->poly_seg[seg].max_x += shift_x;
+        }
+        polygon->min_x += shift_x;
+        polygon->max_x += shift_x;
+
+        ias_geo_shift_polygon(polygon->child, shift_x);
+    }
+}
+
+/*****************************************************************************
+NAME:  get_side_distance
+
+PURPOSE:  Compute the distance from a point to a polygon side.
+
+RETURN VALUE:
+Type = double
+Value    Description
+-----    -----------
+distance Distance from the point to the nearest point on the side
+
+*****************************************************************************/
+static double get_side_distance
+(
+    double x,                   /* I: X of the point */
+    double y,                   /* I: Y of the point */
+    double x0,                  /* I: X of the first vertex of the side */
+    double y0,                  /* I: Y of the first vertex of the side */
+    double x1,                  /* I: X of the second vertex of the side */
+    double y1                   /* I: Y of the second vertex of the side */
+)
+{
+    double dx = x1 - x0;        /* X length of the side */
+    double dy = y1 - y0;        /* Y length of the side */
+    double length_squared = dx * dx + dy * dy; /* Squared side length */
+    double fraction = 0.0;      /* Position of the nearest point on the side */
+
+    if (length_squared > 0.0)
+    {
+        fraction = ((x - x0) * dx + (y - y0) * dy) / length_squared;
+        if (fraction < 0.0)
+            fraction = 0.0;
+        else if (fraction > 1.0)
+            fraction = 1.0;
+    }
+
+    return hypot(x - (x0 + fraction * dx), y - (y0 + fraction * dy));
+}
+
+/*****************************************************************************
+NAME:  simplify_ring
+
+PURPOSE:  Simplify a closed ring of vertices with the Douglas-Peucker
+          algorithm, keeping only the vertices needed to stay within the
+          tolerance of the original ring.  The kept vertices are moved to the
+          front of the arrays.
+
+RETURN VALUE:
+Type = unsigned int
+Value    Description
+-----    -----------
+count    Number of kept vertices, including the final point that duplicates
+         the first point
+
+NOTES:  The ring is split at its first vertex and the vertex farthest from
+        it, and each half is simplified on its own.  A ring that would be left
+        with fewer than three sides is not changed.  The keep flags must hold
+        num_points entries and the stack twice that.
+*****************************************************************************/
+static unsigned int simplify_ring
+(
+    unsigned int num_points,    /* I: Number of vertices, including the final
+                                      point that duplicates the first */
+    double *point_x,            /* I/O: X vertices */
+    double *point_y,            /* I/O: Y vertices */
+    double tolerance,           /* I: Largest distance a removed vertex can
+                                      be from the simplified ring */
+    unsigned char *keep,        /* I: Work space for the keep flags */
+    unsigned int *stack         /* I: Work space for the pending ranges */
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int far_point = 0; /* Vertex farthest from the first one */
+    unsigned int num_pending;   /* Number of entries on the stack */
+    unsigned int count;         /* Number of kept vertices */
+    double far_distance = -1.0; /* Distance to the farthest vertex */
+
+    memset(keep, 0, num_points);
+    for (point = 1; point < num_points - 1; point++)
+    {
+        double distance = hypot(point_x[point] - point_x[0],
+            point_y[point] - point_y[0]);
+
+        if (distance > far_distance)
+        {
+            far_distance = distance;
+            far_point = point;
+        }
+    }
+    keep[0] = keep[far_point] = keep[num_points - 1] = 1;
+
+    /* Each range on the stack is a pair of kept vertices whose vertices in
+       between still need checking.  A range is only pushed when it has
+       vertices in between, so the stack never holds more than one entry per
+       vertex. */
+    num_pending = 0;
+    stack[num_pending++] = 0;
+    stack[num_pending++] = far_point;
+    stack[num_pending++] = far_point;
+    stack[num_pending++] = num_points - 1;
+    while (num_pending > 0)
+    {
+        unsigned int last = stack[--num_pending];   /* End of the range */
+        unsigned int first = stack[--num_pending];  /* Start of the range */
+        unsigned int split = first;     /* Vertex farthest from the side */
+        double max_distance = -1.0;     /* Distance of the split vertex */
+
+        for (point = first + 1; point < last; point++)
+        {
+            double distance = get_side_distance(point_x[point],
+                point_y[point], point_x[first], point_y[first],
+                point_x[last], point_y[last]);
+
+            if (distance > max_distance)
+            {
+                max_distance = distance;
+                split = point;
+            }
+        }
+
+        if (max_distance <= tolerance)
+            continue;
+
+        keep[split] = 1;
+        if (split - first > 1)
+        {
+            stack[num_pending++] = first;
+            stack[num_pending++] = split;
+        }
+        if (last - split > 1)
+        {
+            stack[num_pending++] = split;
+            stack[num_pending++] = last;
+        }
+    }
+
+    /* Leave the ring as it is if fewer than three sides would be left */
+    for (point = 0, count = 0; point < num_points; point++)
+        count += keep[point];
+    if (count < 4)
+        return num_points;
+
+    for (point = 0, count = 0; point < num_points; point++)
+    {
+        if (keep[point])
+        {
+            point_x[count] = point_x[point];
+            point_y[count] = point_y[point];
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_simplify_polygon
+
+PURPOSE:  Simplify the polygons in a list, and all their children, removing
+          the vertices that are within a tolerance of the lines between the
+          vertices kept.  Coastline detail much smaller than a mask sample
+          can't change the mask by much, but costs as much as any other
+          detail to process.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The polygons are changed in place, so they must own their vertices
+        and segments; a list loaded from a packed polygon file can't be
+        simplified, but a clipped copy of it can.  The tolerance is in the
+        units of the vertices, with x and y treated alike.  A polygon that
+        would be simplified to fewer than three sides, such as an island
+        smaller than the tolerance, is left as it is.
+*****************************************************************************/
+int ias_geo_simplify_polygon
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list,  /* I/O: First polygon in list */
+    double tolerance                        /* I: Simplification tolerance */
+)
+{
+    IAS_POLYGON_LINKED_LIST *polygon;   /* Current polygon in loop */
+
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+    {
+        unsigned char *keep;    /* Keep flags for the vertices */
+        unsigned int *stack;    /* Pending ranges of vertices */
+        unsigned int num_points;/* Number of kept vertices */
+        double *point_x;        /* Resized x vertices */
+        double *point_y;        /* Resized y vertices */
+
+        if (polygon->child && ias_geo_simplify_polygon(polygon->child,
+            tolerance) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Simplifying the children of polygon %u",
+                polygon->id);
+            return ERROR;
+        }
+
+        /* A triangle can't be simplified */
+        if (polygon->num_points <= 4)
+            continue;
+
+        keep = malloc(polygon->num_points);
+        stack = malloc(2 * polygon->num_points * sizeof(unsigned int));
+        if (!keep || !stack)
+        {
+            IAS_LOG_ERROR("Allocating memory for simplifying polygon %u",
+                polygon->id);
+            free(keep);
+            free(stack);
+            return ERROR;
+        }
+
+        num_points = simplify_ring(polygon->num_points, polygon->point_x,
+            polygon->point_y, tolerance, keep, stack);
+        free(keep);
+        free(stack);
+
+        if (num_points == polygon->num_points)
+            continue;
+
+        polygon->num_points = num_points;
+
+        /* Give back the memory of the removed vertices */
+        point_x = realloc(polygon->point_x, num_points * sizeof(double));
+        if (point_x)
+            polygon->point_x = point_x;
+        point_y = realloc(polygon->point_y, num_points * sizeof(double));
+        if (point_y)
+            polygon->point_y = point_y;
+
+        if (set_polygon_extent(polygon) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Setting the extent of simplified polygon %u",
+                polygon->id);
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  get_polygon_index_cell_range
+
+PURPOSE:  Compute the range of index cells in one direction overlapped by a
+          bounding box range.  The range is widened by a small tolerance so
+          points on a cell boundary find the polygons on both sides of it.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void get_polygon_index_cell_range
+(
+    double grid_min,            /* I: Minimum bounds of the grid */
+    double cell_size,           /* I: Size of each cell */
+    unsigned int num_cells,     /* I: Number of cells */
+    double min_value,           /* I: Minimum bounds of the range */
+    double max_value,           /* I: Maximum bounds of the range */
+    unsigned int *first_cell,   /* O: First cell overlapped */
+    unsigned int *last_cell     /* O: Last cell overlapped */
+)
+{
+    double tolerance = cell_size * 1.0e-6; /* Cell boundary tolerance */
+    double cell;                           /* Cell of a bounds value */
+
+    cell = floor((min_value - tolerance - grid_min) / cell_size);
+    if (cell < 0)
+        cell = 0;
+    else if (cell > num_cells - 1)
+        cell = num_cells - 1;
+    *first_cell = (unsigned int)cell;
+
+    cell = floor((max_value + tolerance - grid_min) / cell_size);
+    if (cell < 0)
+        cell = 0;
+    else if (cell > num_cells - 1)
+        cell = num_cells - 1;
+    *last_cell = (unsigned int)cell;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_create_polygon_index
+
+PURPOSE:  Build a packed grid index over the bounding boxes of the polygons in
+          a list, so the polygons that can contain a point, or be crossed by
+          a scan from it, are found without walking the whole list.
+
+RETURN VALUE:
+Type = IAS_POLYGON_INDEX *
+Value    Description
+-----    -----------
+NULL     Operation failed
+index    Pointer to the new polygon index
+
+NOTES:  Only the polygons in the list itself are indexed.  Their children are
+        reached through the child pointers.  The index refers to the polygons
+        in the list, so it must be destroyed before the list is freed or
+        reduced.
+*****************************************************************************/
+IAS_POLYGON_INDEX *ias_geo_create_polygon_index
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list   /* I: First polygon in list */
+)
+{
+    IAS_POLYGON_INDEX *index;           /* New polygon index */
+    IAS_POLYGON_LINKED_LIST *polygon;   /* Current polygon in loop */
+    unsigned int npolygons = 0;         /* Number of polygons in the list */
+    unsigned int num_cells;             /* Total number of cells */
+    unsigned int num_entries;           /* Total number of cell entries */
+    unsigned int *fill;                 /* Next entry to fill for each cell */
+    unsigned int cell;                  /* Cell loop counter */
+
+    index = calloc(1, sizeof(IAS_POLYGON_INDEX));
+    if (index == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index");
+        return NULL;
+    }
+
+    /* Find the combined bounding box of the polygons */
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+    {
+        if (npolygons == 0 || polygon->min_x < index->min_x)
+            index->min_x = polygon->min_x;
+        if (npolygons == 0 || polygon->max_x > index->max_x)
+            index->max_x = polygon->max_x;
+        if (npolygons == 0 || polygon->min_y < index->min_y)
+            index->min_y = polygon->min_y;
+        if (npolygons == 0 || polygon->max_y > index->max_y)
+            index->max_y = polygon->max_y;
+        npolygons++;
+    }
+
+    /* Size the grid so each cell holds only a few polygons on average */
+    index->num_cells_x = (unsigned int)ceil(sqrt((double)npolygons));
+    if (index->num_cells_x < 1)
+        index->num_cells_x = 1;
+    else if (index->num_cells_x > IAS_POLYGON_INDEX_MAX_CELLS)
+        index->num_cells_x = IAS_POLYGON_INDEX_MAX_CELLS;
+    index->num_cells_y = index->num_cells_x;
+    num_cells = index->num_cells_x * index->num_cells_y;
+
+    index->cell_size_x = (index->max_x - index->min_x) / index->num_cells_x;
+    index->cell_size_y = (index->max_y - index->min_y) / index->num_cells_y;
+    if (index->cell_size_x <= 0)
+        index->cell_size_x = 1.0;
+    if (index->cell_size_y <= 0)
+        index->cell_size_y = 1.0;
+
+    index->cell_start = calloc(num_cells + 1, sizeof(unsigned int));
+    fill = malloc(num_cells * sizeof(unsigned int));
+    if (index->cell_start == NULL || fill == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index cells");
+        free(fill);
+        ias_geo_destroy_polygon_index(index);
+        return NULL;
+    }
+
+    /* Count the polygons overlapping each cell */
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+    {
+        unsigned int first_x, last_x; /* Range of x cells for the polygon */
+        unsigned int first_y, last_y; /* Range of y cells for the polygon */
+        unsigned int x_cell, y_cell;  /* Cell loop counters */
+
+        get_polygon_index_cell_range(index->min_x, index->cell_size_x,
+            index->num_cells_x, polygon->min_x, polygon->max_x, &first_x,
+            &last_x);
+        get_polygon_index_cell_range(index->min_y, index->cell_size_y,
+            index->num_cells_y, polygon->min_y, polygon->max_y, &first_y,
+            &last_y);
+        for (y_cell = first_y; y_cell <= last_y; y_cell++)
+        {
+            for (x_cell = first_x; x_cell <= last_x; x_cell++)
+                index->cell_start[y_cell * index->num_cells_x + x_cell + 1]++;
+        }
+    }
+
+    /* Convert the counts to starting entries */
+    for (cell = 0; cell < num_cells; cell++)
+    {
+        index->cell_start[cell + 1] += index->cell_start[cell];
+        fill[cell] = index->cell_start[cell];
+    }
+    num_entries = index->cell_start[num_cells];
+
+    index->cell_polygons = malloc((num_entries > 0 ? num_entries : 1)
+        * sizeof(IAS_POLYGON_LINKED_LIST *));
+    if (index->cell_polygons == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon index entries");
+        free(fill);
+        ias_geo_destroy_polygon_index(index);
+        return NULL;
+    }
+
+    /* Fill in the polygons for each cell, keeping the list order so the
+       search order matches a walk of the list */
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+    {
+        unsigned int first_x, last_x; /* Range of x cells for the polygon */
+        unsigned int first_y, last_y; /* Range of y cells for the polygon */
+        unsigned int x_cell, y_cell;  /* Cell loop counters */
+
+        get_polygon_index_cell_range(index->min_x, index->cell_size_x,
+            index->num_cells_x, polygon->min_x, polygon->max_x, &first_x,
+            &last_x);
+        get_polygon_index_cell_range(index->min_y, index->cell_size_y,
+            index->num_cells_y, polygon->min_y, polygon->max_y, &first_y,
+            &last_y);
+        for (y_cell = first_y; y_cell <= last_y; y_cell++)
+        {
+            for (x_cell = first_x; x_cell <= last_x; x_cell++)
+            {
+                cell = y_cell * index->num_cells_x + x_cell;
+                index->cell_polygons[fill[cell]++] = polygon;
+            }
+        }
+    }
+
+    free(fill);
+    return index;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_destroy_polygon_index
+
+PURPOSE:  Free the polygon index memory.  The indexed polygons are not freed.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+void ias_geo_destroy_polygon_index
+(
+    IAS_POLYGON_INDEX *index                /* I: Polygon index to free */
+)
+{
+    if (index == NULL)
+        return;
+
+    free(index->cell_start);
+    free(index->cell_polygons);
+    free(index);
+}
+
+/* Round a packed polygon file offset up to the next 8 byte boundary */
+#define PACKED_POLYGON_ALIGN(offset) (((offset) + 7) & ~((uint64_t)7))
+
+/* Maps a top-level polygon in a list to its packed record number */
+typedef struct packed_polygon_lookup
+{
+    const IAS_POLYGON_LINKED_LIST *polygon; /* Top-level polygon */
+    uint32_t record;                        /* Record number */
+} PACKED_POLYGON_LOOKUP;
+
+/*****************************************************************************
+NAME:  count_packed_polygons
+
+PURPOSE:  Count the polygons, vertices, and segments in a polygon list and
+          all of its children.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void count_packed_polygons
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: First polygon in list */
+    uint64_t *num_polygons,                 /* I/O: Polygon counter */
+    uint64_t *num_points,                   /* I/O: Vertex counter */
+    uint64_t *num_segs                      /* I/O: Segment counter */
+)
+{
+    while (polygon)
+    {
+        (*num_polygons)++;
+        *num_points += polygon->num_points;
+        *num_segs += polygon->num_segs;
+        count_packed_polygons(polygon->child, num_polygons, num_points,
+            num_segs);
+        polygon = polygon->next;
+    }
+}
+
+/*****************************************************************************
+NAME:  pack_polygon_group
+
+PURPOSE:  Copy a group of sibling polygons into consecutive packed records,
+          starting at a given record, and then pack the children of each of
+          them after the records already used.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void pack_polygon_group
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: First polygon in group */
+    uint32_t first_record,          /* I: Record for the first polygon */
+    IAS_PACKED_POLYGON_RECORD *records, /* I/O: Polygon records */
+    double *point_x,                /* I/O: X vertices */
+    double *point_y,                /* I/O: Y vertices */
+    IAS_POLYGON_SEGMENT *poly_seg,  /* I/O: Polygon segments */
+    uint32_t *next_record,          /* I/O: Next unused record */
+    uint64_t *next_point,           /* I/O: Next unused vertex */
+    uint64_t *next_seg              /* I/O: Next unused segment */
+)
+{
+    const IAS_POLYGON_LINKED_LIST *current; /* Current polygon in group */
+    const IAS_POLYGON_LINKED_LIST *child;   /* Current child polygon */
+    IAS_PACKED_POLYGON_RECORD *record;      /* Current polygon record */
+
+    /* Copy the polygons in the group */
+    record = &records[first_record];
+    for (current = polygon; current; current = current->next, record++)
+    {
+        record->id = current->id;
+        record->num_points = current->num_points;
+        record->num_segs = current->num_segs;
+        record->num_children = 0;
+        for (child = current->child; child; child = child->next)
+            record->num_children++;
+        record->first_child = 0;
+        record->unused = 0;
+        record->first_point = *next_point;
+        record->first_seg = *next_seg;
+        record->min_x = current->min_x;
+        record->max_x = current->max_x;
+        record->min_y = current->min_y;
+        record->max_y = current->max_y;
+
+        memcpy(&point_x[*next_point], current->point_x,
+            current->num_points * sizeof(double));
+        memcpy(&point_y[*next_point], current->point_y,
+            current->num_points * sizeof(double));
+        memcpy(&poly_seg[*next_seg], current->poly_seg,
+            current->num_segs * sizeof(IAS_POLYGON_SEGMENT));
+        *next_point += current->num_points;
+        *next_seg += current->num_segs;
+    }
+
+    /* Reserve a run of records for the children of each polygon and
+       pack them */
+    record = &records[first_record];
+    for (current = polygon; current; current = current->next, record++)
+    {
+        if (!current->child)
+            continue;
+
+        record->first_child = *next_record;
+        *next_record += record->num_children;
+        pack_polygon_group(current->child, record->first_child, records,
+            point_x, point_y, poly_seg, next_record, next_point, next_seg);
+    }
+}
+
+/*****************************************************************************
+NAME:  compare_packed_polygon_lookup
+
+PURPOSE:  Comparison function for sorting and searching the top-level polygon
+          lookup table by polygon address.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+-1       First polygon address is lower
+0        Polygon addresses are the same
+1        First polygon address is higher
+
+*****************************************************************************/
+static int compare_packed_polygon_lookup
+(
+    const void *first,          /* I: First lookup entry */
+    const void *second          /* I: Second lookup entry */
+)
+{
+    uintptr_t first_polygon
+        = (uintptr_t)((const PACKED_POLYGON_LOOKUP *)first)->polygon;
+    uintptr_t second_polygon
+        = (uintptr_t)((const PACKED_POLYGON_LOOKUP *)second)->polygon;
+
+    if (first_polygon < second_polygon)
+        return -1;
+    if (first_polygon > second_polygon)
+        return 1;
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  write_packed_section
+
+PURPOSE:  Write one section of a packed polygon file at its offset, padding
+          the file with zeros up to the offset.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int write_packed_section
+(
+    FILE *fp,                   /* I: Packed polygon file pointer */
+    uint64_t offset,            /* I: Offset of the section */
+    const void *data,           /* I: Section data */
+    size_t size                 /* I: Size of the section in bytes */
+)
+{
+    static const char zero[8] = {0}; /* Padding bytes */
+    off_t position;             /* Current file position */
+
+    position = ftello(fp);
+    if (position < 0 || (uint64_t)position > offset
+        || offset - position > sizeof(zero))
+    {
+        IAS_LOG_ERROR("Packed polygon file section offset is invalid");
+        return ERROR;
+    }
+
+    if (offset > (uint64_t)position && fwrite(zero, 1, offset - position, fp)
+        != offset - position)
+    {
+        IAS_LOG_ERROR("Writing out the packed polygon section padding");
+        return ERROR;
+    }
+
+    if (size > 0 && fwrite(data, 1, size, fp) != size)
+    {
+        IAS_LOG_ERROR("Writing out the packed polygon section");
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_write_packed_polygon
+
+PURPOSE:  Write a polygon list out to a packed polygon file, which can be
+          memory mapped with ias_geo_open_packed_polygon.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The polygon list is normally the full list read from a polygon file
+        by ias_geo_load_polygon.  The grid index of the top-level polygons is
+        built with ias_geo_create_polygon_index, so a packed file finds the
+        same polygons as an index built after loading.
+*****************************************************************************/
+int ias_geo_write_packed_polygon
+(
+    const char *packed_file,                /* I: Packed polygon filename */
+    const IAS_POLYGON_LINKED_LIST *polygon_list /* I: First polygon in list */
+)
+{
+    IAS_PACKED_POLYGON_HEADER header;   /* Packed file header */
+    IAS_PACKED_POLYGON_RECORD *records = NULL; /* Polygon records */
+    IAS_POLYGON_SEGMENT *poly_seg = NULL;  /* Polygon segments */
+    IAS_POLYGON_INDEX *index = NULL;    /* Index of the top-level polygons */
+    PACKED_POLYGON_LOOKUP *lookup = NULL; /* Top-level polygon lookup */
+    const IAS_POLYGON_LINKED_LIST *polygon; /* Current polygon in loop */
+    double *point_x = NULL;             /* X vertices */
+    double *point_y = NULL;             /* Y vertices */
+    uint32_t *cell_polygons = NULL;     /* Index cell entries */
+    uint64_t num_polygons = 0;          /* Number of polygons */
+    uint64_t num_points = 0;            /* Number of vertices */
+    uint64_t num_segs = 0;              /* Number of segments */
+    uint64_t num_cells;                 /* Number of index cells */
+    uint64_t entry;                     /* Index cell entry loop counter */
+    uint32_t next_record;               /* Next unused polygon record */
+    uint64_t next_point = 0;            /* Next unused vertex */
+    uint64_t next_seg = 0;              /* Next unused segment */
+    int status = ERROR;                 /* Return status */
+    FILE *fp = NULL;                    /* Packed polygon file pointer */
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IAS_PACKED_POLYGON_MAGIC,
+        IAS_PACKED_POLYGON_MAGIC_SIZE);
+
+    /* Count the polygons */
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+        header.num_top_polygons++;
+    count_packed_polygons(polygon_list, &num_polygons, &num_points,
+        &num_segs);
+    if (header.num_top_polygons == 0 || num_polygons > UINT32_MAX)
+    {
+        IAS_LOG_ERROR("Invalid number of polygons (%llu) for a packed "
+            "polygon file", (unsigned long long)num_polygons);
+        return ERROR;
+    }
+    header.num_polygons = num_polygons;
+    header.num_points = num_points;
+    header.num_segs = num_segs;
+
+    /* Index the top-level polygons */
+    index = ias_geo_create_polygon_index(
+        (IAS_POLYGON_LINKED_LIST *)polygon_list);
+    if (!index)
+    {
+        IAS_LOG_ERROR("Creating the polygon index");
+        return ERROR;
+    }
+    header.min_x = index->min_x;
+    header.max_x = index->max_x;
+    header.min_y = index->min_y;
+    header.max_y = index->max_y;
+    header.cell_size_x = index->cell_size_x;
+    header.cell_size_y = index->cell_size_y;
+    header.num_cells_x = index->num_cells_x;
+    header.num_cells_y = index->num_cells_y;
+    num_cells = (uint64_t)index->num_cells_x * index->num_cells_y;
+    header.num_cell_entries = index->cell_start[num_cells];
+
+    /* Lay out the sections */
+    header.records_offset = PACKED_POLYGON_ALIGN(sizeof(header));
+    header.point_x_offset = PACKED_POLYGON_ALIGN(header.records_offset
+        + num_polygons * sizeof(IAS_PACKED_POLYGON_RECORD));
+    header.point_y_offset = PACKED_POLYGON_ALIGN(header.point_x_offset
+        + num_points * sizeof(double));
+    header.segs_offset = PACKED_POLYGON_ALIGN(header.point_y_offset
+        + num_points * sizeof(double));
+    header.cell_start_offset = PACKED_POLYGON_ALIGN(header.segs_offset
+        + num_segs * sizeof(IAS_POLYGON_SEGMENT));
+    header.cell_polygons_offset = PACKED_POLYGON_ALIGN(
+        header.cell_start_offset + (num_cells + 1) * sizeof(uint32_t));
+
+    /* Allocate the sections */
+    records = malloc(num_polygons * sizeof(IAS_PACKED_POLYGON_RECORD));
+    point_x = malloc((num_points + 1) * sizeof(double));
+    point_y = malloc((num_points + 1) * sizeof(double));
+    poly_seg = malloc((num_segs + 1) * sizeof(IAS_POLYGON_SEGMENT));
+    lookup = malloc(header.num_top_polygons * sizeof(PACKED_POLYGON_LOOKUP));
+    cell_polygons = malloc((header.num_cell_entries + 1) * sizeof(uint32_t));
+    if (!records || !point_x || !point_y || !poly_seg || !lookup
+        || !cell_polygons)
+    {
+        IAS_LOG_ERROR("Allocating memory for the packed polygons");
+        goto cleanup;
+    }
+
+    /* Pack the polygons, with the top-level polygons in list order first */
+    next_record = header.num_top_polygons;
+    pack_polygon_group(polygon_list, 0, records, point_x, point_y, poly_seg,
+        &next_record, &next_point, &next_seg);
+
+    /* Convert the index cell entries to top-level record numbers */
+    next_record = 0;
+    for (polygon = polygon_list; polygon; polygon = polygon->next)
+    {
+        lookup[next_record].polygon = polygon;
+        lookup[next_record].record = next_record;
+        next_record++;
+    }
+    qsort(lookup, header.num_top_polygons, sizeof(PACKED_POLYGON_LOOKUP),
+        compare_packed_polygon_lookup);
+    for (entry = 0; entry < header.num_cell_entries; entry++)
+    {
+        PACKED_POLYGON_LOOKUP key;      /* Polygon to look up */
+        PACKED_POLYGON_LOOKUP *found;   /* Matching lookup entry */
+
+        key.polygon = index->cell_polygons[entry];
+        found = bsearch(&key, lookup, header.num_top_polygons,
+            sizeof(PACKED_POLYGON_LOOKUP), compare_packed_polygon_lookup);
+        if (!found)
+        {
+            IAS_LOG_ERROR("Polygon index entry is not a top-level polygon");
+            goto cleanup;
+        }
+        cell_polygons[entry] = found->record;
+    }
+
+    /* Write the file */
+    if ((fp = fopen(packed_file, "wb")) == NULL)
+    {
+        IAS_LOG_ERROR("Unable to open %s for writing.", packed_file);
+        goto cleanup;
+    }
+
+    if (write_packed_section(fp, 0, &header, sizeof(header)) != SUCCESS
+        || write_packed_section(fp, header.records_offset, records,
+            num_polygons * sizeof(IAS_PACKED_POLYGON_RECORD)) != SUCCESS
+        || write_packed_section(fp, header.point_x_offset, point_x,
+            num_points * sizeof(double)) != SUCCESS
+        || write_packed_section(fp, header.point_y_offset, point_y,
+            num_points * sizeof(double)) != SUCCESS
+        || write_packed_section(fp, header.segs_offset, poly_seg,
+            num_segs * sizeof(IAS_POLYGON_SEGMENT)) != SUCCESS
+        || write_packed_section(fp, header.cell_start_offset,
+            index->cell_start, (num_cells + 1) * sizeof(uint32_t)) != SUCCESS
+        || write_packed_section(fp, header.cell_polygons_offset,
+            cell_polygons, header.num_cell_entries * sizeof(uint32_t))
+            != SUCCESS)
+    {
+        IAS_LOG_ERROR("Writing the packed polygon file %s", packed_file);
+        goto cleanup;
+    }
+
+    status = SUCCESS;
+
+cleanup:
+    if (fp && fclose(fp) != 0 && status == SUCCESS)
+    {
+        IAS_LOG_ERROR("Closing the packed polygon file %s", packed_file);
+        status = ERROR;
+    }
+    ias_geo_destroy_polygon_index(index);
+    free(records);
+    free(point_x);
+    free(point_y);
+    free(poly_seg);
+    free(lookup);
+    free(cell_polygons);
+    return status;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_is_packed_polygon_file
+
+PURPOSE:  Determine whether a polygon file is a packed polygon file.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+TRUE     The file starts with the packed polygon magic string
+FALSE    The file is not a packed polygon file or cannot be read
+
+*****************************************************************************/
+int ias_geo_is_packed_polygon_file
+(
+    const char *polygon_file                /* I: Polygon filename */
+)
+{
+    char magic[IAS_PACKED_POLYGON_MAGIC_SIZE]; /* Start of the file */
+    FILE *fp;                               /* Polygon file pointer */
+    int is_packed;                          /* Magic string found flag */
+
+    if ((fp = fopen(polygon_file, "r")) == NULL)
+        return FALSE;
+
+    is_packed = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)
+        && memcmp(magic, IAS_PACKED_POLYGON_MAGIC, sizeof(magic)) == 0);
+    fclose(fp);
+
+    return is_packed ? TRUE : FALSE;
+}
+
+/*****************************************************************************
+NAME:  check_packed_section
+
+PURPOSE:  Verify a section of a packed polygon file is aligned and lies
+          within the mapped file.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+TRUE     The section is valid
+FALSE    The section is not valid
+
+*****************************************************************************/
+static int check_packed_section
+(
+    size_t map_size,            /* I: Size of the mapped file */
+    uint64_t offset,            /* I: Offset of the section */
+    uint64_t count,             /* I: Number of elements in the section */
+    size_t element_size         /* I: Size of each element */
+)
+{
+    if (offset % 8 != 0 || offset > map_size)
+        return FALSE;
+    if (count > (map_size - offset) / element_size)
+        return FALSE;
+    return TRUE;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_open_packed_polygon
+
+PURPOSE:  Memory map a packed polygon file read-only.  The mapping is shared,
+          so concurrent processes using the same file share one copy of it.
+
+RETURN VALUE:
+Type = IAS_PACKED_POLYGON *
+Value    Description
+-----    -----------
+NULL     Operation failed
+packed   Pointer to the mapped packed polygon file
+
+*****************************************************************************/
+IAS_PACKED_POLYGON *ias_geo_open_packed_polygon
+(
+    const char *packed_file                 /* I: Packed polygon filename */
+)
+{
+    IAS_PACKED_POLYGON *packed;             /* Mapped packed polygon file */
+    const IAS_PACKED_POLYGON_HEADER *header;/* File header */
+    const char *base;                       /* Start of the mapping */
+    struct stat file_stat;                  /* File status */
+    uint64_t num_cells;                     /* Number of index cells */
+    int fd;                                 /* Packed polygon file descriptor */
+
+    fd = open(packed_file, O_RDONLY);
+    if (fd < 0)
+    {
+        IAS_LOG_ERROR("Unable to open %s for reading.", packed_file);
+        return NULL;
+    }
+
+    if (fstat(fd, &file_stat) != 0)
+    {
+        IAS_LOG_ERROR("Getting the size of %s", packed_file);
+        close(fd);
+        return NULL;
+    }
+
+    if ((uint64_t)file_stat.st_size < sizeof(IAS_PACKED_POLYGON_HEADER))
+    {
+        IAS_LOG_ERROR("%s is too small to be a packed polygon file",
+            packed_file);
+        close(fd);
+        return NULL;
+    }
+
+    packed = calloc(1, sizeof(IAS_PACKED_POLYGON));
+    if (packed == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the packed polygon file");
+        close(fd);
+        return NULL;
+    }
+
+    packed->map_size = file_stat.st_size;
+    packed->map = mmap(NULL, packed->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (packed->map == MAP_FAILED)
+    {
+        IAS_LOG_ERROR("Memory mapping %s", packed_file);
+        free(packed);
+        return NULL;
+    }
+
+    /* Validate the header and the section layout */
+    base = packed->map;
+    header = packed->map;
+    num_cells = (uint64_t)header->num_cells_x * header->num_cells_y;
+    if (memcmp(header->magic, IAS_PACKED_POLYGON_MAGIC,
+        IAS_PACKED_POLYGON_MAGIC_SIZE) != 0)
+    {
+        IAS_LOG_ERROR("%s is not a packed polygon file", packed_file);
+        ias_geo_close_packed_polygon(packed);
+        return NULL;
+    }
+
+    if (header->num_top_polygons == 0
+        || header->num_top_polygons > header->num_polygons
+        || num_cells == 0 || header->cell_size_x <= 0
+        || header->cell_size_y <= 0
+        || !check_packed_section(packed->map_size, header->records_offset,
+            header->num_polygons, sizeof(IAS_PACKED_POLYGON_RECORD))
+        || !check_packed_section(packed->map_size, header->point_x_offset,
+            header->num_points, sizeof(double))
+        || !check_packed_section(packed->map_size, header->point_y_offset,
+            header->num_points, sizeof(double))
+        || !check_packed_section(packed->map_size, header->segs_offset,
+            header->num_segs, sizeof(IAS_POLYGON_SEGMENT))
+        || !check_packed_section(packed->map_size, header->cell_start_offset,
+            num_cells + 1, sizeof(uint32_t))
+        || !check_packed_section(packed->map_size,
+            header->cell_polygons_offset, header->num_cell_entries,
+            sizeof(uint32_t)))
+    {
+        IAS_LOG_ERROR("%s has an invalid packed polygon layout", packed_file);
+        ias_geo_close_packed_polygon(packed);
+        return NULL;
+    }
+
+    packed->header = header;
+    packed->records = (const IAS_PACKED_POLYGON_RECORD *)
+        (base + header->records_offset);
+    packed->point_x = (const double *)(base + header->point_x_offset);
+    packed->point_y = (const double *)(base + header->point_y_offset);
+    packed->poly_seg = (const IAS_POLYGON_SEGMENT *)
+        (base + header->segs_offset);
+    packed->cell_start = (const uint32_t *)(base + header->cell_start_offset);
+    packed->cell_polygons = (const uint32_t *)
+        (base + header->cell_polygons_offset);
+
+    if (packed->cell_start[num_cells] != header->num_cell_entries)
+    {
+        IAS_LOG_ERROR("%s has an invalid packed polygon index", packed_file);
+        ias_geo_close_packed_polygon(packed);
+        return NULL;
+    }
+
+    return packed;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_close_packed_polygon
+
+PURPOSE:  Unmap a packed polygon file.  Any polygon list loaded from it must
+          be freed first.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+void ias_geo_close_packed_polygon
+(
+    IAS_PACKED_POLYGON *packed              /* I: Packed polygon to close */
+)
+{
+    if (packed == NULL)
+        return;
+
+    if (packed->map && packed->map != MAP_FAILED)
+        munmap(packed->map, packed->map_size);
+    free(packed);
+}
+
+/*****************************************************************************
+NAME:  compare_packed_records
+
+PURPOSE:  Comparison function for sorting the record numbers of the candidate
+          top-level polygons.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+-1       First record number is lower
+0        Record numbers are the same
+1        First record number is higher
+
+*****************************************************************************/
+static int compare_packed_records
+(
+    const void *first,          /* I: First record number */
+    const void *second          /* I: Second record number */
+)
+{
+    uint32_t first_record = *(const uint32_t *)first;
+    uint32_t second_record = *(const uint32_t *)second;
+
+    if (first_record < second_record)
+        return -1;
+    if (first_record > second_record)
+        return 1;
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  load_packed_polygon_group
+
+PURPOSE:  Build polygon list nodes for a run of packed records, keeping only
+          the polygons that overlap the bounding box, and load the children of
+          each kept polygon the same way.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+*****************************************************************************/
+static int load_packed_polygon_group
+(
+    const IAS_PACKED_POLYGON *packed,   /* I: Packed polygon file */
+    const uint32_t *record_list,        /* I: Record numbers to load, or NULL
+                                              for consecutive records */
+    uint32_t first_record,              /* I: First record when consecutive */
+    uint32_t num_records,               /* I: Number of records to load */
+    double upper_left_x,                /* I: Upper left x */
+    double lower_right_x,               /* I: Lower right x */
+    double upper_left_y,                /* I: Upper left y */
+    double lower_right_y,               /* I: Lower right y */
+    IAS_POLYGON_LINKED_LIST **head      /* O: First polygon in group */
+)
+{
+    const IAS_PACKED_POLYGON_HEADER *header = packed->header;
+    IAS_POLYGON_LINKED_LIST *list_tail = NULL; /* Tail of the polygon list */
+    uint32_t count;                     /* Record loop counter */
+
+    *head = NULL;
+    for (count = 0; count < num_records; count++)
+    {
+        const IAS_PACKED_POLYGON_RECORD *record; /* Current record */
+        IAS_POLYGON_LINKED_LIST *polygon;        /* New polygon node */
+        uint32_t record_number;                  /* Current record number */
+
+        record_number = record_list ? record_list[count]
+            : first_record + count;
+        record = &packed->records[record_number];
+
+        /* Skip the polygon if it is outside the bounding box */
+        if (record->min_y > upper_left_y || record->max_y < lower_right_y
+            || record->min_x > lower_right_x || record->max_x < upper_left_x)
+            continue;
+
+        /* Verify the record refers to data within the file.  Children are
+           always stored after their parent. */
+        if (record->first_point > header->num_points
+            || record->num_points > header->num_points - record->first_point
+            || record->first_seg > header->num_segs
+            || record->num_segs > header->num_segs - record->first_seg
+            || (record->num_children > 0
+                && (record->first_child <= record_number
+                || record->first_child > header->num_polygons
+                || record->num_children
+                    > header->num_polygons - record->first_child)))
+        {
+            IAS_LOG_ERROR("Packed polygon record %u is invalid",
+                record_number);
+            ias_geo_free_packed_polygon_linked_list(*head);
+            *head = NULL;
+            return ERROR;
+        }
+
+        polygon = calloc(1, sizeof(IAS_POLYGON_LINKED_LIST));
+        if (polygon == NULL)
+        {
+            IAS_LOG_ERROR("Allocating memory for linked list");
+            ias_geo_free_packed_polygon_linked_list(*head);
+            *head = NULL;
+            return ERROR;
+        }
+
+        /* Point the polygon at its vertices and segments in the mapped file.
+           The mapping is read-only, so the polygon must not be modified. */
+        polygon->id = record->id;
+        polygon->num_points = record->num_points;
+        polygon->point_x = (double *)&packed->point_x[record->first_point];
+        polygon->point_y = (double *)&packed->point_y[record->first_point];
+        polygon->min_x = record->min_x;
+        polygon->max_x = record->max_x;
+        polygon->min_y = record->min_y;
+        polygon->max_y = record->max_y;
+        polygon->num_segs = record->num_segs;
+        polygon->poly_seg
+            = (IAS_POLYGON_SEGMENT *)&packed->poly_seg[record->first_seg];
+
+        /* Add the polygon to the tail of the list */
+        if (list_tail)
+        {
+            list_tail->next = polygon;
+            polygon->prev = list_tail;
+        }
+        else
+            *head = polygon;
+        list_tail = polygon;
+
+        /* Load the children overlapping the bounding box */
+        if (record->num_children > 0 && load_packed_polygon_group(packed,
+            NULL, record->first_child, record->num_children, upper_left_x,
+            lower_right_x, upper_left_y, lower_right_y, &polygon->child)
+            != SUCCESS)
+        {
+            IAS_LOG_ERROR("Loading the children of packed polygon %u",
+                record->id);
+            ias_geo_free_packed_polygon_linked_list(*head);
+            *head = NULL;
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_load_packed_polygon
+
+PURPOSE:  Build a polygon list from a mapped packed polygon file, keeping only
+          the polygons that overlap the bounding box.  The list matches the
+          one ias_geo_load_polygon followed by ias_geo_reduce_polygon gives
+          for the same bounding box and the polygon file the packed file was
+          made from.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The polygons point at the vertices and segments in the mapping, so
+        the list must be freed with ias_geo_free_packed_polygon_linked_list
+        before the packed file is closed, and must not be reduced or
+        otherwise modified.
+*****************************************************************************/
+int ias_geo_load_packed_polygon
+(
+    const IAS_PACKED_POLYGON *packed,   /* I: Packed polygon file */
+    double upper_left_x,                /* I: Upper left x */
+    double lower_right_x,               /* I: Lower right x */
+    double upper_left_y,                /* I: Upper left y */
+    double lower_right_y,               /* I: Lower right y */
+    IAS_POLYGON_LINKED_LIST **head      /* O: Polygon pointer */
+)
+{
+    const IAS_PACKED_POLYGON_HEADER *header = packed->header;
+    unsigned int first_x, last_x;       /* Range of x cells for the box */
+    unsigned int first_y, last_y;       /* Range of y cells for the box */
+    unsigned int x_cell, y_cell;        /* Cell loop counters */
+    uint32_t *candidates;               /* Candidate top-level records */
+    uint64_t num_candidates = 0;        /* Number of candidates */
+    uint64_t num_unique = 0;            /* Number of distinct candidates */
+    uint64_t entry;                     /* Cell entry loop counter */
+    int status;                         /* Return status */
+
+    *head = NULL;
+
+    if (upper_left_x > lower_right_x)
+    {
+        IAS_LOG_ERROR(
+            "Upper left longitude greater than lower right longitude");
+        return ERROR;
+    }
+
+    if (upper_left_y < lower_right_y)
+    {
+        IAS_LOG_ERROR("Upper left latitude less than lower right latitude");
+        return ERROR;
+    }
+
+    /* Find the index cells overlapped by the bounding box */
+    get_polygon_index_cell_range(header->min_x, header->cell_size_x,
+        header->num_cells_x, upper_left_x, lower_right_x, &first_x, &last_x);
+    get_polygon_index_cell_range(header->min_y, header->cell_size_y,
+        header->num_cells_y, lower_right_y, upper_left_y, &first_y, &last_y);
+
+    for (y_cell = first_y; y_cell <= last_y; y_cell++)
+    {
+        for (x_cell = first_x; x_cell <= last_x; x_cell++)
+        {
+            unsigned int cell = y_cell * header->num_cells_x + x_cell;
+
+            if (packed->cell_start[cell] > packed->cell_start[cell + 1]
+                || packed->cell_start[cell + 1] > header->num_cell_entries)
+            {
+                IAS_LOG_ERROR("Packed polygon index cell %u is invalid",
+                    cell);
+                return ERROR;
+            }
+            num_candidates += packed->cell_start[cell + 1]
+                - packed->cell_start[cell];
+        }
+    }
+
+    /* Gather the top-level polygons in those cells, in file order so the
+       list order matches the polygon file */
+    candidates = malloc((num_candidates + 1) * sizeof(uint32_t));
+    if (candidates == NULL)
+    {
+        IAS_LOG_ERROR("Allocating memory for the candidate polygons");
+        return ERROR;
+    }
+
+    num_candidates = 0;
+    for (y_cell = first_y; y_cell <= last_y; y_cell++)
+    {
+        for (x_cell = first_x; x_cell <= last_x; x_cell++)
+        {
+            unsigned int cell = y_cell * header->num_cells_x + x_cell;
+
+            for (entry = packed->cell_start[cell];
+                 entry < packed->cell_start[cell + 1]; entry++)
+            {
+                if (packed->cell_polygons[entry] >= header->num_top_polygons)
+                {
+                    IAS_LOG_ERROR("Packed polygon index entry %llu is "
+                        "invalid", (unsigned long long)entry);
+                    free(candidates);
+                    return ERROR;
+                }
+                candidates[num_candidates++] = packed->cell_polygons[entry];
+            }
+        }
+    }
+
+    qsort(candidates, num_candidates, sizeof(uint32_t),
+        compare_packed_records);
+    for (entry = 0; entry < num_candidates; entry++)
+    {
+        if (num_unique == 0 || candidates[entry] != candidates[num_unique - 1])
+            candidates[num_unique++] = candidates[entry];
+    }
+
+    status = load_packed_polygon_group(packed, candidates, 0, num_unique,
+        upper_left_x, lower_right_x, upper_left_y, lower_right_y, head);
+    free(candidates);
+    if (status != SUCCESS)
+    {
+        IAS_LOG_ERROR("Loading the packed polygons");
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_free_packed_polygon_linked_list
+
+PURPOSE:  Free the nodes of a polygon list loaded from a packed polygon file.
+          The vertices and segments belong to the mapped file and are not
+          freed.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+void ias_geo_free_packed_polygon_linked_list
+(
+    IAS_POLYGON_LINKED_LIST *polygon    /* I: First polygon in list */
+)
+{
+    IAS_POLYGON_LINKED_LIST *next;      /* Next polygon in list */
+
+    while (polygon)
+    {
+        ias_geo_free_packed_polygon_linked_list(polygon->child);
+        next = polygon->next;
+        free(polygon);
+        polygon = next;
+    }
+}
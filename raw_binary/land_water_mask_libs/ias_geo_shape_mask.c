@@ -3,6 +3,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define SHAPE_MASK_HAVE_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SHAPE_MASK_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 /* IAS Library Includes */
 #include "ias_types.h"        
@@ -12,17 +20,137 @@
 #include "ias_const.h"
 #include "gctp.h"
 #include "config.h"
+#include "espa_profile.h"
+#include "espa_probe.h"
+#include "espa_alloc.h"
+#include "espa_task.h"
+#include "espa_progress.h"
 
 /* Local Defines */
 #define GRID_SIZE_HORZ 20
 #define GRID_SIZE_VERT 20
+#define GRID_REFINE_SIZE 5  /* Smallest block a grid tile is split into along
+                               the polygon edges */
 #define ALL_BITS_SET 255
 #define NO_BITS_SET 0
 
+/* Mask samples of padding around the mask bounding box when clipping the
+   polygons to it */
+#define MASK_CLIP_PAD_PIXELS 2
+
+/* Simplification tolerance for the clipped polygons, in mask samples.  Zero
+   keeps the full polygon detail. */
+#define MASK_SIMPLIFY_PIXELS 0.25
+
 #ifndef HAVE_LITTLE_ENDIAN
 #error("This code does not properly support big endian")
 #endif
 
+/* Instruction set used to expand the bit mask to a byte mask; chosen on
+   first use.  The ESPA_SHAPE_MASK_ISA environment variable can be set to
+   "scalar" to force the scalar expansion. */
+static int expand_isa = -1;
+
+/* Packed polygon file kept mapped by ias_geo_keep_packed_polygon_resident,
+   and its name.  Masks from that file use this mapping instead of mapping
+   the file again. */
+static IAS_PACKED_POLYGON *resident_packed = NULL;
+static char *resident_packed_file = NULL;
+
+/*****************************************************************************
+NAME:  get_frame_longitude
+
+PURPOSE:  Take a longitude into the longitude frame of a mask, the 360 degrees
+          starting at frame_west.
+
+RETURN VALUE:
+Type = double
+Description: The longitude, moved by a multiple of 360 degrees into the frame
+
+NOTES:  The longitude is moved without a branch, so the same code runs for
+        the masks crossing 180 longitude as for any other.
+*****************************************************************************/
+static inline double get_frame_longitude
+(
+    double longitude,           /* I: Longitude (degrees) */
+    double frame_west           /* I: West edge of the frame (degrees) */
+)
+{
+    return longitude - 360.0 * floor((longitude - frame_west) / 360.0);
+}
+
+/*****************************************************************************
+NAME:  set_mask_longitude_frame
+
+PURPOSE:  Choose the longitude frame of a mask from its bounding box, once for
+          the mask.  The lower right longitude is taken east of the upper left
+          one, so a box crossing 180 longitude ends past 180 instead of
+          wrapping, and the frame is the 360 degrees centered on the box.
+
+RETURN VALUE:
+Type = double
+Description: West edge of the frame (degrees)
+
+NOTES:  The polygons of the mask are moved into the frame as they are loaded
+        (see load_mask_polygons), so the mask samples and the polygons share
+        the frame and no sample needs wrapping.
+*****************************************************************************/
+static double set_mask_longitude_frame
+(
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double *lower_right_long    /* I/O: Lower right longitude for mask */
+)
+{
+    if (*lower_right_long < upper_left_long)
+        *lower_right_long += 360.0;
+
+    return (upper_left_long + *lower_right_long) / 2.0 - 180.0;
+}
+
+/*****************************************************************************
+NAME:  convert_lat_long_to_input_line_sample
+
+PURPOSE:  Converts a lat/long coordinate to input line/sample and confirms it
+    falls within the image.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+TRUE     Pixel in mask
+FALSE    Pixel not in mask
+
+*****************************************************************************/
+static int convert_lat_long_to_input_line_sample
+(
+    const IAS_DBL_LAT_LONG *transformed_pixel, /* I: Pixel lat/long */
+    double frame_west,          /* I: West edge of the longitude frame */
+    double min_lng,             /* I: Minimum image longitude */
+    double max_lat,             /* I: Maximum image latitude */
+    double delta_longitude,     /* I: Change in longitude from bounding box */
+    double delta_latitude,      /* I: Change in latatiude from bounding box */
+    int num_samples,            /* I: Number of samples in input image */
+    int num_lines,              /* I: Number of lines in input image */
+    IAS_DBL_LS *translated_pixel/* O: Translated to bit mask line/sample */
+)
+{
+    /* Translate lat/long to mask line/sample, in the longitude frame of the
+       mask */  
+    translated_pixel->samp = (get_frame_longitude(transformed_pixel->lng,
+        frame_west) - min_lng) / delta_longitude;
+    translated_pixel->line = (max_lat - transformed_pixel->lat)
+        / delta_latitude;
+            
+    /* Check if the line sample falls within the image */
+    if (translated_pixel->line >= 0 && translated_pixel->line < num_lines 
+        && translated_pixel->samp >= 0 && translated_pixel->samp < num_samples)
+    {
+        return TRUE;
+    } 
+
+    return FALSE;
+}
+
 /*****************************************************************************
 NAME:  convert_target_xy_to_input_line_sample
 
@@ -43,6 +171,7 @@ static int convert_target_xy_to_input_line_sample
     const IAS_DBL_XY *current_pixel,   /* I: Pixel X/Y coordinate */
     IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation,/* I: Transformation
                                                                  Projection */
+    double frame_west,          /* I: West edge of the longitude frame */
     double min_lng,             /* I: Minimum image longitude */
     double max_lat,             /* I: Maximum image latitude */
     double delta_longitude,     /* I: Change in longitude from bounding box */
@@ -64,20 +193,332 @@ static int convert_target_xy_to_input_line_sample
     }
             
     /* Translate lat/long to mask line/sample */  
-    translated_pixel->samp = (transformed_pixel.lng - min_lng) 
-        / delta_longitude;
-    translated_pixel->line = (max_lat - transformed_pixel.lat) / delta_latitude;
-            
-    /* Check if the line sample falls within the image */
-    if (translated_pixel->line >= 0 && translated_pixel->line < num_lines 
-        && translated_pixel->samp >= 0 && translated_pixel->samp < num_samples)
+    return convert_lat_long_to_input_line_sample(&transformed_pixel,
+        frame_west, min_lng, max_lat, delta_longitude, delta_latitude,
+        num_samples, num_lines, translated_pixel);
+}
+
+/*****************************************************************************
+NAME:  ias_geo_keep_packed_polygon_resident
+
+PURPOSE:  Map a packed polygon file for the life of the process, so the masks
+          made from it don't map and page in the file each time.  A long
+          running process making many masks, such as espa_worker, calls this
+          once at startup; processes forked afterwards share the mapping.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  Only one packed polygon file is kept resident; calling this again
+        replaces it.  A polygon file which is not packed is left to be read
+        for each mask as before.
+*****************************************************************************/
+int ias_geo_keep_packed_polygon_resident
+(
+    const char *polygon_file    /* I: Packed polygon filename */
+)
+{
+    IAS_PACKED_POLYGON *packed; /* Packed polygon file */
+    char *packed_file;          /* Copy of the packed polygon filename */
+
+    if (!ias_geo_is_packed_polygon_file(polygon_file))
     {
-        return TRUE;
-    } 
+        IAS_LOG_ERROR("%s is not a packed polygon file", polygon_file);
+        return ERROR;
+    }
 
-    return FALSE;
+    packed = ias_geo_open_packed_polygon(polygon_file);
+    if (!packed)
+    {
+        IAS_LOG_ERROR("Opening the packed polygon file %s", polygon_file);
+        return ERROR;
+    }
+
+    packed_file = strdup(polygon_file);
+    if (!packed_file)
+    {
+        IAS_LOG_ERROR("Allocating memory for the packed polygon filename");
+        ias_geo_close_packed_polygon(packed);
+        return ERROR;
+    }
+
+    /* Start reading the whole file in now, rather than on the first masks */
+    madvise(packed->map, packed->map_size, MADV_WILLNEED);
+
+    if (resident_packed)
+        ias_geo_close_packed_polygon(resident_packed);
+    free(resident_packed_file);
+    resident_packed = packed;
+    resident_packed_file = packed_file;
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  load_clipped_polygons
+
+PURPOSE:  Load the polygons that overlap a box within -180 to 180 longitude,
+          clipped to the box.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The clipped polygons are a copy, which must be freed with
+        ias_geo_free_polygon_linked_list.  The polygons are read from the
+        packed polygon file if one is given, and from the polygon file
+        otherwise.
+*****************************************************************************/
+static int load_clipped_polygons
+(
+    const char *polygon_file,   /* I: Polygon filename */
+    const IAS_PACKED_POLYGON *packed, /* I: Packed polygon file, or NULL */
+    double west_long,           /* I: West longitude of the box */
+    double east_long,           /* I: East longitude of the box */
+    double north_lat,           /* I: North latitude of the box */
+    double south_lat,           /* I: South latitude of the box */
+    IAS_POLYGON_LINKED_LIST **clipped_list /* O: Clipped polygon list */
+)
+{
+    FILE *fp;                   /* Polygon file pointer */
+    IAS_POLYGON_LINKED_LIST *polygon_list; /* Polygons overlapping the box */
+
+    *clipped_list = NULL;
+
+    if (packed)
+    {
+        if (ias_geo_load_packed_polygon(packed, west_long, east_long,
+            north_lat, south_lat, &polygon_list) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Loading the packed polygon file %s",
+                polygon_file);
+            return ERROR;
+        }
+    }
+    else
+    {
+        /* Open the polygon file. */
+        if ((fp = fopen(polygon_file, "r")) == NULL)
+        {
+            IAS_LOG_ERROR("Unable to open %s for reading.", polygon_file);
+            return ERROR;
+        }
+
+        /* Load the polygons. */
+        if (ias_geo_load_polygon(fp, west_long, east_long, south_lat,
+            north_lat, &polygon_list) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Loading the polygon file %s", polygon_file);
+            fclose(fp);
+            return ERROR;
+        }
+
+        /* Close the polygon file. */
+        fclose(fp);
+    }
+
+    if (ias_geo_clip_polygon(polygon_list, west_long, east_long, north_lat,
+        south_lat, clipped_list) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Clipping the polygons to the mask");
+        if (packed)
+            ias_geo_free_packed_polygon_linked_list(polygon_list);
+        else
+            ias_geo_free_polygon_linked_list(polygon_list);
+        return ERROR;
+    }
+
+    if (packed)
+        ias_geo_free_packed_polygon_linked_list(polygon_list);
+    else
+        ias_geo_free_polygon_linked_list(polygon_list);
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  load_mask_polygons
+
+PURPOSE:  Load the polygons that overlap the mask bounding box, in the
+          longitude frame of the mask.  The polygon file can either be a
+          polygon file written by ias_geo_dump_polygon or a packed polygon
+          file, which is memory mapped instead of read.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The polygons are clipped to the mask bounding box padded by
+        MASK_CLIP_PAD_PIXELS mask samples, so a large land mass only brings
+        along its coastline near the mask, and then simplified to within
+        MASK_SIMPLIFY_PIXELS mask samples.  The clipped polygons are a copy,
+        which must be freed with ias_geo_free_polygon_linked_list, and a
+        packed polygon file is closed once they are made, unless it is the
+        resident packed polygon file.
+        The lower right longitude must be east of the upper left one (see
+        set_mask_longitude_frame).  When the box crosses 180 longitude, the
+        polygons are clipped to the part of the box up to 180, and to the
+        rest of it taken back by 360 degrees; the polygons of the rest are
+        then moved east by 360 degrees.  Each part of a polygon is loaded
+        once, in the longitudes of the mask, so neither the samples nor the
+        polygons are wrapped later.
+*****************************************************************************/
+static int load_mask_polygons
+(
+    const char *polygon_file,   /* I: Polygon filename */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    IAS_POLYGON_LINKED_LIST **polygon_list /* O: Polygon list */
+)
+{
+    IAS_PACKED_POLYGON *packed = NULL; /* Packed polygon file, if used */
+    IAS_POLYGON_LINKED_LIST *wrapped_list = NULL; /* Polygons past 180
+                                                     longitude */
+    IAS_POLYGON_LINKED_LIST *tail;  /* Last polygon of the list */
+    double pad_lat;             /* Latitude padding for the clip box */
+    double pad_long;            /* Longitude padding for the clip box */
+    double west_long;           /* West longitude of the clip box */
+    double east_long;           /* East longitude of the clip box */
+    int status = SUCCESS;       /* Return status */
+
+    *polygon_list = NULL;
+
+    /* Map a packed polygon file, unless it is already resident. */
+    if (resident_packed && strcmp(polygon_file, resident_packed_file) == 0)
+        packed = resident_packed;
+    else if (ias_geo_is_packed_polygon_file(polygon_file))
+    {
+        packed = ias_geo_open_packed_polygon(polygon_file);
+        if (!packed)
+        {
+            IAS_LOG_ERROR("Opening the packed polygon file %s", polygon_file);
+            return ERROR;
+        }
+    }
+
+    ESPA_PROBE2(polygon__load, polygon_file, packed != NULL);
+    espa_profile_count_cache(ESPA_PROFILE_CACHE_POLYGON,
+        packed != NULL && packed == resident_packed);
+
+    /* Pad the box so the mask samples along its edges are well inside it */
+    pad_lat = MASK_CLIP_PAD_PIXELS * (upper_left_lat - lower_right_lat)
+        / num_lines;
+    pad_long = MASK_CLIP_PAD_PIXELS * (lower_right_long - upper_left_long)
+        / num_samples;
+    west_long = upper_left_long - pad_long;
+    east_long = lower_right_long + pad_long;
+
+    /* The part of the box up to 180 longitude */
+    if (west_long < 180.0)
+    {
+        status = load_clipped_polygons(polygon_file, packed,
+            fmax(west_long, -180.0), fmin(east_long, 180.0),
+            upper_left_lat + pad_lat, lower_right_lat - pad_lat,
+            polygon_list);
+    }
+
+    /* The part past 180 longitude, moved into the frame of the mask */
+    if (status == SUCCESS && east_long > 180.0)
+    {
+        status = load_clipped_polygons(polygon_file, packed,
+            fmax(west_long, 180.0) - 360.0, fmin(east_long - 360.0, 180.0),
+            upper_left_lat + pad_lat, lower_right_lat - pad_lat,
+            &wrapped_list);
+        if (status == SUCCESS)
+            ias_geo_shift_polygon(wrapped_list, 360.0);
+
+        if (!*polygon_list)
+            *polygon_list = wrapped_list;
+        else if (wrapped_list)
+        {
+            for (tail = *polygon_list; tail->next; tail = tail->next)
+                ;
+            tail->next = wrapped_list;
+            wrapped_list->prev = tail;
+        }
+    }
+
+    if (packed && packed != resident_packed)
+        ias_geo_close_packed_polygon(packed);
+
+    if (status != SUCCESS)
+    {
+        IAS_LOG_ERROR("Loading the polygons around the mask");
+        ias_geo_free_polygon_linked_list(*polygon_list);
+        *polygon_list = NULL;
+        return ERROR;
+    }
+
+    /* Detail well under a mask sample can't be seen in the mask, so drop
+       it.  The tolerance uses the smaller sample spacing so no direction is
+       simplified by more than MASK_SIMPLIFY_PIXELS samples. */
+    if (MASK_SIMPLIFY_PIXELS > 0 && ias_geo_simplify_polygon(*polygon_list,
+        MASK_SIMPLIFY_PIXELS * fmin(pad_lat, pad_long)
+        / MASK_CLIP_PAD_PIXELS) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Simplifying the polygons for the mask");
+        ias_geo_free_polygon_linked_list(*polygon_list);
+        *polygon_list = NULL;
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  set_mask_bits
+
+PURPOSE:  Set a run of bits in the bit mask, writing whole bytes where the run
+          covers them.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void set_mask_bits
+(
+    unsigned char *mask,    /* I/O: Bit mask */
+    size_t first_bit,       /* I: First bit to set */
+    size_t last_bit         /* I: Bit after the last one to set */
+)
+{
+    size_t first_byte;      /* First byte of the run */
+    size_t last_byte;       /* Byte holding the bit after the run */
+
+    if (first_bit >= last_bit)
+        return;
+
+    first_byte = first_bit / 8;
+    last_byte = last_bit / 8;
+
+    /* Bits are stored most significant bit first */
+    if (first_byte == last_byte)
+    {
+        mask[first_byte] |= (ALL_BITS_SET >> (first_bit % 8))
+            & ~(ALL_BITS_SET >> (last_bit % 8));
+        return;
+    }
+
+    mask[first_byte] |= ALL_BITS_SET >> (first_bit % 8);
+    memset(&mask[first_byte + 1], ALL_BITS_SET, last_byte - first_byte - 1);
+    if (last_bit % 8)
+        mask[last_byte] |= ~(ALL_BITS_SET >> (last_bit % 8)) & ALL_BITS_SET;
 }
 
+#if defined(SHAPE_MASK_HAVE_X86)
 /*****************************************************************************
 NAME:  ias_geo_shape_mask
 
@@ -92,6 +533,8 @@ Value    Description
 SUCCESS  Successful completion
 ERROR    Operation failed
 
+NOTES:  The lower right longitude can be past 180, or less than the upper
+        left one, for a mask crossing 180 longitude.
 *****************************************************************************/
 int ias_geo_shape_mask
 (
@@ -106,53 +549,40 @@ int ias_geo_shape_mask
 )
 {
     unsigned int line;          /* Line counter */
-    unsigned int index;         /* Generic counter */
+    size_t index;               /* Generic counter */
     double delta_latitude;      /* Delta latitude */
     double delta_longitude;     /* Delta longitude */
     IAS_POLYGON_LINKED_LIST *polygon_list; /* Polygon linked list pointer */
-    FILE *fp;                   /* Polygon file pointer */
-
-    /* Open the polygon file. */
-    if ((fp = fopen(polygon_file, "r")) == NULL)
-    {
-        IAS_LOG_ERROR("Unable to open %s for reading.", polygon_file);
-        return ERROR;
-    }
-
-    /* Load the polygons. */
-    if (ias_geo_load_polygon(fp, upper_left_long, lower_right_long,
-        lower_right_lat, upper_left_lat, &polygon_list) != SUCCESS)
+    IAS_POLYGON_INDEX *polygon_index; /* Index of the polygon list */
+    ESPA_PROFILE_SCOPE("ias_geo_shape_mask");
+
+    /* Work in the longitude frame of the mask, and load the polygons
+       within the bounding box into it. */
+    set_mask_longitude_frame(upper_left_long, &lower_right_long);
+    if (load_mask_polygons(polygon_file, num_lines, num_samples,
+        upper_left_lat, lower_right_lat, upper_left_long, lower_right_long,
+        &polygon_list) != SUCCESS)
     {
-        IAS_LOG_ERROR("Loading the polygon file %s", polygon_file);
-        fclose(fp);
+        IAS_LOG_ERROR("Loading the polygons for the mask");
         return ERROR;
     }
 
-    /* Close the polygon file. */
-    fclose(fp);
-
-    /* Discard polygons outside the bounding box. */
-    if (ias_geo_reduce_polygon(&polygon_list, upper_left_long, lower_right_long,
-        upper_left_lat, lower_right_lat) != SUCCESS)
+    /* Index the remaining polygons so each sample only checks the polygons
+       near it. */
+    polygon_index = ias_geo_create_polygon_index(polygon_list);
+    if (!polygon_index)
     {
-        IAS_LOG_ERROR("Reducing the polygon");
+        IAS_LOG_ERROR("Creating the polygon index");
+        ias_geo_free_polygon_linked_list(polygon_list);
         return ERROR;
     }
 
     /* Initialize the mask to all zeros. */
-    memset(mask, 0, num_lines * num_samples / 8 + 1);
+    memset(mask, 0, (size_t)num_lines * num_samples / 8 + 1);
 
     /* Determine the mask value for each sample location. */
     delta_latitude = (upper_left_lat - lower_right_lat) / num_lines;
-    if (lower_right_long >= upper_left_long)
-    {
-        delta_longitude = (lower_right_long - upper_left_long) / num_samples;
-    }
-    else
-    {
-        delta_longitude = (lower_right_long - upper_left_long + 360) 
-            / num_samples;
-    }
+    delta_longitude = (lower_right_long - upper_left_long) / num_samples;
 
     /* Loop through each line */
     for (line = 0, index = 0; line < num_lines; line++)
@@ -170,38 +600,24 @@ int ias_geo_shape_mask
             double longitude;           /* Longitude */
             double distance;            /* Distance from point to polygon */
             int inside_flag;            /* Inside/Outside polygon flag */
+            size_t run_start;           /* Mask index of the run start */
 
             longitude = upper_left_long + delta_longitude * sample;
 
-            /* Adjust for 180 crossing. */
-            if (longitude >= 180)
-            {
-                longitude -= 360;
-            }
-
             /* Initialize the flag and distances */
             inside_flag = 0;
             distance = 1e10;
 
             /* Determine if point is inside the shape */
-            inside_flag = ias_geo_point_in_shape_distance(polygon_list,
-                latitude, longitude, 0, &distance, &polygon_hit);
+            inside_flag = ias_geo_point_in_indexed_shape_distance(
+                polygon_index, latitude, longitude, &distance, &polygon_hit);
             
             /* Progress down the line using the distance provided by 
                point_in_shape_distance so we don't have to recalculate
                distance for each lat/long */
+            run_start = index;
             while (sample < num_samples && distance > 0)
             {
-                /* Set bit if point is inside the polygon */
-                if (inside_flag)
-                {
-                    unsigned int byte;  /* Byte level indexing */
-                    unsigned int bit;   /* Bit-level indexing */
-                    byte = index / 8;
-                    bit = 7 - index % 8;
-                    mask[byte] |= 1 << bit;
-                }
-    
                 /* Progress to the next sample and to the next mask
                    index */
                 sample++;
@@ -211,90 +627,1098 @@ int ias_geo_shape_mask
                 distance -= delta_longitude;
             }
 
+            /* Set the bits of the run if it is inside the polygon */
+            if (inside_flag)
+                set_mask_bits(mask, run_start, index);
+
             sample--;
             index--;
         } /* longitude loop */
     } /* latitude loop */
     
     /* Free storage. */
+    ias_geo_destroy_polygon_index(polygon_index);
     ias_geo_free_polygon_linked_list(polygon_list);
 
     return SUCCESS;
 }
 
+/* Polygon edge used by the scanline fill */
+typedef struct shape_mask_edge
+{
+    double x0;              /* X (longitude) of the first vertex */
+    double y0;              /* Y (latitude) of the first vertex */
+    double x1;              /* X (longitude) of the second vertex */
+    double y1;              /* Y (latitude) of the second vertex */
+    double min_y;           /* Minimum y of the edge */
+    double max_y;           /* Maximum y of the edge */
+    unsigned int group;     /* Top-level polygon the edge belongs to */
+} SHAPE_MASK_EDGE;
+
+/* Edge crossing of a scanline */
+typedef struct shape_mask_crossing
+{
+    unsigned int group;     /* Top-level polygon the crossing belongs to */
+    double x;               /* X (longitude) of the crossing */
+} SHAPE_MASK_CROSSING;
+
 /*****************************************************************************
-NAME:  ias_geo_shape_mask_projection
+NAME:  count_polygon_edges
 
-PURPOSE:  Generate a shape mask for a given region in a given projection.
+PURPOSE:  Count the edges of a polygon list, including the edges of all the
+          child polygons.
 
 RETURN VALUE:
-Type = int
+Type = size_t
 Value    Description
 -----    -----------
-SUCCESS  Successful completion
-ERROR    Operation failed
+count    Number of edges
 
-NOTES: Mask should already be initialized when passed to the routine. It should 
-       be initialized with all zeros.
 *****************************************************************************/
-int ias_geo_shape_mask_projection
+static size_t count_polygon_edges
 (
-    const char *polygon_file,         /* I: Polygon filename */
-    const IAS_IMAGE *image,           /* I: Input image struct pointer */
-    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
-    unsigned char *mask               /* O: Mask buffer */
+    const IAS_POLYGON_LINKED_LIST *polygon  /* I: First polygon in list */
 )
 {
-    IAS_DBL_LAT_LONG corners[4];    /* Lat/Long corners: UL, UR, LL, LR */
-    const IAS_CORNERS *corners_ptr; /* Image corners  */
-    double lng[4];                  /* Corner longitudes */
-    unsigned int min_lat = 0;       /* Minimum latitude */
-    unsigned int max_lat = 0;       /* Maximum latitude */
-    unsigned int min_lng = 0;       /* Minimum longitude */
-    unsigned int max_lng = 0;       /* Maximum longitude */
-    double delta_latitude;          /* Delta latitude */
-    double delta_longitude;         /* Delta longitude */
-    unsigned char *bit_mask = NULL; /* Bit mask */
-    int num_horz_grids;             /* Number of horizontal grids for image */
-    int num_vert_grids;             /* Number of vertical grids for image */
-    int vgrid;                      /* Loop variable for current vert grid */
-    int hgrid;                      /* Loop variable for current horz grid */
-    unsigned int num_lines;         /* Number of lines in passed image */
-    unsigned int num_samples;       /* Number of samples in passed image */
+    size_t count = 0;   /* Number of edges */
+
+    for (; polygon; polygon = polygon->next)
+    {
+        /* The last point is a copy of the first, closing the polygon */
+        if (polygon->num_points > 1)
+            count += polygon->num_points - 1;
+        count += count_polygon_edges(polygon->child);
+    }
+
+    return count;
+}
+
+/*****************************************************************************
+NAME:  add_polygon_edges
+
+PURPOSE:  Add the edges of a polygon list, including the edges of all the
+          child polygons, to the edge table.  Horizontal edges never cross a
+          scanline, so they are left out.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void add_polygon_edges
+(
+    const IAS_POLYGON_LINKED_LIST *polygon, /* I: First polygon in list */
+    unsigned int group,         /* I: Top-level polygon for the edges, or
+                                      the index of the first polygon for the
+                                      top-level list */
+    int top_level,              /* I: Flag for the top-level list, where each
+                                      polygon starts a new group */
+    SHAPE_MASK_EDGE *edges,     /* I/O: Edge table */
+    size_t *num_edges           /* I/O: Number of edges in the table */
+)
+{
+    unsigned int point;         /* Point loop counter */
+
+    for (; polygon; polygon = polygon->next, group += top_level)
+    {
+        for (point = 0; point + 1 < polygon->num_points; point++)
+        {
+            SHAPE_MASK_EDGE *edge;  /* New edge */
+
+            if (polygon->point_y[point] == polygon->point_y[point + 1])
+                continue;
+
+            edge = &edges[(*num_edges)++];
+            edge->x0 = polygon->point_x[point];
+            edge->y0 = polygon->point_y[point];
+            edge->x1 = polygon->point_x[point + 1];
+            edge->y1 = polygon->point_y[point + 1];
+            edge->min_y = (edge->y0 < edge->y1) ? edge->y0 : edge->y1;
+            edge->max_y = (edge->y0 < edge->y1) ? edge->y1 : edge->y0;
+            edge->group = group;
+        }
+
+        add_polygon_edges(polygon->child, group, FALSE, edges, num_edges);
+    }
+}
+
+/*****************************************************************************
+NAME:  compare_crossings
+
+PURPOSE:  qsort comparison placing the crossings in order of increasing x.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+-1/0/1   First crossing sorts before/with/after the second
+
+*****************************************************************************/
+static int compare_crossings
+(
+    const void *a,          /* I: First crossing */
+    const void *b           /* I: Second crossing */
+)
+{
+    const SHAPE_MASK_CROSSING *crossing_a = a;
+    const SHAPE_MASK_CROSSING *crossing_b = b;
+
+    if (crossing_a->x < crossing_b->x)
+        return -1;
+    if (crossing_a->x > crossing_b->x)
+        return 1;
+    return 0;
+}
+
+/*****************************************************************************
+NAME:  sort_crossings
+
+PURPOSE:  Sort the crossings of one polygon group in order of increasing x.
+          Most groups cross a line only a few times, so short runs are
+          insertion sorted.
+
+RETURN VALUE: None
+
+*****************************************************************************/
+static void sort_crossings
+(
+    SHAPE_MASK_CROSSING *crossings, /* I/O: Crossings to sort */
+    size_t num_crossings            /* I: Number of crossings */
+)
+{
+    size_t i, j;                    /* Loop counters */
+
+    if (num_crossings > 16)
+    {
+        qsort(crossings, num_crossings, sizeof(SHAPE_MASK_CROSSING),
+            compare_crossings);
+        return;
+    }
+
+    for (i = 1; i < num_crossings; i++)
+    {
+        SHAPE_MASK_CROSSING crossing = crossings[i]; /* Crossing to place */
+
+        for (j = i; j > 0 && crossings[j - 1].x > crossing.x; j--)
+            crossings[j] = crossings[j - 1];
+        crossings[j] = crossing;
+    }
+}
+
+/*****************************************************************************
+NAME:  find_first_sample_at_or_after
+
+PURPOSE:  Find the first sample in a range whose longitude is at or after a
+          given longitude.  The sample longitudes increase across the range.
+
+RETURN VALUE:
+Type = unsigned int
+Value    Description
+-----    -----------
+sample   First sample in the range at or after the longitude, or the end of
+         the range if there isn't one
+
+*****************************************************************************/
+static unsigned int find_first_sample_at_or_after
+(
+    double longitude,       /* I: Longitude to find */
+    double first_longitude, /* I: Longitude of sample 0 */
+    double delta_longitude, /* I: Change in longitude per sample */
+    unsigned int first,     /* I: First sample in the range */
+    unsigned int last       /* I: Sample after the last one in the range */
+)
+{
+    double estimate;        /* Estimated sample */
+    unsigned int sample;    /* Sample found */
+
+    /* Start from the estimate and step to the exact sample, using the same
+       longitude computation as the point-in-polygon mask */
+    estimate = ceil((longitude - first_longitude) / delta_longitude);
+    if (estimate <= first)
+        sample = first;
+    else if (estimate >= last)
+        sample = last;
+    else
+        sample = (unsigned int)estimate;
+
+    while (sample > first && first_longitude + delta_longitude * (sample - 1)
+        >= longitude)
+        sample--;
+    while (sample < last && first_longitude + delta_longitude * sample
+        < longitude)
+        sample++;
+
+    return sample;
+}
+
+/*****************************************************************************
+NAME:  expand_mask_bytes_avx2
+
+PURPOSE:  Expand whole bytes of the bit mask to the byte mask, 4 bytes of bits
+          (32 samples) at a time, using AVX2.
+
+RETURN VALUE:
+Type = size_t
+Description: Number of bytes of bits expanded, which leaves fewer than 4 for
+             the caller.
+
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static size_t expand_mask_bytes_avx2
+(
+    const unsigned char *bit_mask, /* I: Bit mask bytes to expand */
+    size_t num_bytes,       /* I: Number of bytes of bits */
+    unsigned char value,    /* I: Value for the set bits */
+    unsigned char *mask     /* O: Byte mask, 8 samples per bit mask byte */
+)
+{
+    size_t byte;            /* Bit mask byte counter */
+    /* Spread each of the 4 bit bytes across 8 output bytes.  The shuffle
+       works within each 128-bit half, which both hold all 4 bytes. */
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    /* Bit of each output byte, most significant bit first */
+    const __m256i select = _mm256_set1_epi64x(0x0102040810204080LL);
+    const __m256i values = _mm256_set1_epi8((char)value);
+
+    for (byte = 0; byte + 4 <= num_bytes; byte += 4)
+    {
+        int bits;           /* 4 bytes of bits */
+        __m256i bytes;      /* Bits spread to the output bytes */
+
+        memcpy(&bits, &bit_mask[byte], sizeof(bits));
+        bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(bits), spread);
+        bytes = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, select), select);
+        _mm256_storeu_si256((__m256i *)&mask[byte * 8],
+            _mm256_and_si256(bytes, values));
+    }
+
+    return byte;
+}
+#endif
+
+#if defined(SHAPE_MASK_HAVE_NEON)
+/*****************************************************************************
+NAME:  expand_mask_bytes_neon
+
+PURPOSE:  Expand whole bytes of the bit mask to the byte mask, 2 bytes of bits
+          (16 samples) at a time, using NEON.
+
+RETURN VALUE:
+Type = size_t
+Description: Number of bytes of bits expanded, which leaves fewer than 2 for
+             the caller.
+
+*****************************************************************************/
+static size_t expand_mask_bytes_neon
+(
+    const unsigned char *bit_mask, /* I: Bit mask bytes to expand */
+    size_t num_bytes,       /* I: Number of bytes of bits */
+    unsigned char value,    /* I: Value for the set bits */
+    unsigned char *mask     /* O: Byte mask, 8 samples per bit mask byte */
+)
+{
+    size_t byte;            /* Bit mask byte counter */
+    /* Bit of each output byte, most significant bit first */
+    static const uint8_t select_bits[16] = {0x80, 0x40, 0x20, 0x10, 0x08,
+        0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+    const uint8x16_t select = vld1q_u8(select_bits);
+    const uint8x16_t values = vdupq_n_u8(value);
+
+    for (byte = 0; byte + 2 <= num_bytes; byte += 2)
+    {
+        uint8x16_t bytes = vcombine_u8(vdup_n_u8(bit_mask[byte]),
+            vdup_n_u8(bit_mask[byte + 1]));
+
+        vst1q_u8(&mask[byte * 8], vandq_u8(vtstq_u8(bytes, select), values));
+    }
+
+    return byte;
+}
+#endif
+
+/*****************************************************************************
+NAME:  ias_geo_expand_mask_bits
+
+PURPOSE:  Expand a run of bits from a bit mask (most significant bit first,
+          as built by ias_geo_shape_mask) to one byte per sample.  Samples
+          whose bit is set are given the value passed in, and the others are
+          set to zero.
+
+RETURN VALUE: None
+
+NOTES:  Whole bytes of bits are expanded with AVX2 or NEON when the processor
+        has them.
+*****************************************************************************/
+void ias_geo_expand_mask_bits
+(
+    const unsigned char *bit_mask, /* I: Bit mask */
+    size_t first_bit,       /* I: First bit to expand */
+    size_t num_bits,        /* I: Number of bits to expand */
+    unsigned char value,    /* I: Value for the set bits */
+    unsigned char *mask     /* O: Byte mask, one byte per bit */
+)
+{
+    size_t bit = first_bit;             /* Bit counter */
+    size_t last_bit = first_bit + num_bits; /* Bit after the run */
+    size_t num_bytes;                   /* Whole bytes of bits in the run */
+    size_t done = 0;                    /* Whole bytes expanded */
+
+    /* Bits up to the first byte boundary */
+    for (; bit < last_bit && bit % 8; bit++)
+        *mask++ = (bit_mask[bit / 8] & (0x80 >> (bit % 8))) ? value : 0;
+
+    num_bytes = (last_bit - bit) / 8;
+    if (num_bytes > 0)
+    {
+        if (expand_isa == -1)
+        {
+            char *isa_env = getenv("ESPA_SHAPE_MASK_ISA"); /* ISA override */
+            int isa = 0;                /* Vector kernel available */
+
+            if (isa_env == NULL || strcmp(isa_env, "scalar"))
+            {
+#if defined(SHAPE_MASK_HAVE_X86)
+                __builtin_cpu_init();
+                isa = __builtin_cpu_supports("avx2");
+#elif defined(SHAPE_MASK_HAVE_NEON)
+                isa = 1;
+#endif
+            }
+            expand_isa = isa;
+        }
+
+#if defined(SHAPE_MASK_HAVE_X86)
+        if (expand_isa)
+            done = expand_mask_bytes_avx2(&bit_mask[bit / 8], num_bytes,
+                value, mask);
+#elif defined(SHAPE_MASK_HAVE_NEON)
+        if (expand_isa)
+            done = expand_mask_bytes_neon(&bit_mask[bit / 8], num_bytes,
+                value, mask);
+#endif
+        bit += done * 8;
+        mask += done * 8;
+    }
+
+    /* Remaining bits */
+    for (; bit < last_bit; bit++)
+        *mask++ = (bit_mask[bit / 8] & (0x80 >> (bit % 8))) ? value : 0;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_scanline
+
+PURPOSE:  Generate a mask image (per-bit buffer) based on a set of polygons,
+          filling each line of the mask from the polygon edge crossings.
+          Values of zero denote locations outside the polygons, values of one
+          represent locations inside a polygon.  The mask has the same layout
+          as the one from ias_geo_shape_mask.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  The edges are bucketed once by the first line they cross and kept in
+        an active edge table as the lines move south, so each line only
+        computes the crossings of the edges that span it.  The active table is kept in
+        top-level polygon order, so only the crossings of each polygon need
+        sorting.  A sample is inside a polygon when an odd number of that
+        polygon's crossings (including the crossings of its children) lie
+        east of it, which is the same test ias_geo_point_in_shape makes.
+        Overlapping top-level polygons are combined.
+        The lower right longitude can be past 180, or less than the upper
+        left one, for a mask crossing 180 longitude; the polygons are loaded
+        in the longitude frame of the mask, so each span is filled once.
+*****************************************************************************/
+int ias_geo_shape_mask_scanline
+(
+    const char *polygon_file,   /* I: Polygon filename */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    unsigned char *mask         /* O: Mask buffer */
+)
+{
+    unsigned int line;          /* Line counter */
+    double delta_latitude;      /* Delta latitude */
+    double delta_longitude;     /* Delta longitude */
+    size_t num_edges = 0;       /* Number of polygon edges */
+    size_t edge;                /* Edge loop counter */
+    size_t num_active = 0;      /* Number of active edges */
+    size_t *line_start_edge = NULL; /* First entry in line_edges for each
+                                       line (num_lines + 1 entries) */
+    unsigned int *start_line = NULL;/* First line crossed by each edge */
+    SHAPE_MASK_EDGE *edges = NULL;  /* Polygon edges */
+    SHAPE_MASK_EDGE **line_edges = NULL; /* Edges ordered by first line */
+    SHAPE_MASK_EDGE **active = NULL;/* Active edges for the current line */
+    SHAPE_MASK_EDGE **merged = NULL;/* Active edges being merged */
+    SHAPE_MASK_CROSSING *crossings = NULL; /* Crossings for the current line */
+    IAS_POLYGON_LINKED_LIST *polygon_list; /* Polygon linked list pointer */
+
+    /* Work in the longitude frame of the mask, and load the polygons
+       within the bounding box into it. */
+    set_mask_longitude_frame(upper_left_long, &lower_right_long);
+    if (load_mask_polygons(polygon_file, num_lines, num_samples,
+        upper_left_lat, lower_right_lat, upper_left_long, lower_right_long,
+        &polygon_list) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Loading the polygons for the mask");
+        return ERROR;
+    }
+
+    /* Copy the polygon edges, in polygon group order */
+    num_edges = count_polygon_edges(polygon_list);
+    edges = malloc((num_edges + 1) * sizeof(SHAPE_MASK_EDGE));
+    start_line = malloc((num_edges + 1) * sizeof(unsigned int));
+    line_edges = malloc((num_edges + 1) * sizeof(SHAPE_MASK_EDGE *));
+    active = malloc((num_edges + 1) * sizeof(SHAPE_MASK_EDGE *));
+    merged = malloc((num_edges + 1) * sizeof(SHAPE_MASK_EDGE *));
+    crossings = malloc((num_edges + 1) * sizeof(SHAPE_MASK_CROSSING));
+    line_start_edge = calloc(num_lines + 1, sizeof(size_t));
+    if (!edges || !start_line || !line_edges || !active || !merged 
+        || !crossings || !line_start_edge)
+    {
+        IAS_LOG_ERROR("Allocating memory for the polygon edges");
+        free(edges);
+        free(start_line);
+        free(line_edges);
+        free(active);
+        free(merged);
+        free(crossings);
+        free(line_start_edge);
+        ias_geo_free_polygon_linked_list(polygon_list);
+        return ERROR;
+    }
+
+    num_edges = 0;
+    add_polygon_edges(polygon_list, 0, TRUE, edges, &num_edges);
+
+    /* The edges hold copies of the vertices, so the polygons are done */
+    ias_geo_free_polygon_linked_list(polygon_list);
+
+    /* Initialize the mask to all zeros. */
+    memset(mask, 0, (size_t)num_lines * num_samples / 8 + 1);
+
+    /* Determine the mask value for each sample location. */
+    delta_latitude = (upper_left_lat - lower_right_lat) / num_lines;
+    delta_longitude = (lower_right_long - upper_left_long) / num_samples;
+
+    /* Find the first line each edge crosses.  An edge crosses a line when
+       one end is above the line and the other is not.  Edges that don't
+       cross any line are marked with num_lines. */
+    for (edge = 0; edge < num_edges; edge++)
+    {
+        double estimate;        /* Estimated first line */
+        unsigned int first;     /* First line below the top of the edge */
+
+        estimate = floor((upper_left_lat - edges[edge].max_y)
+            / delta_latitude) + 1;
+        if (estimate <= 0)
+            first = 0;
+        else if (estimate >= num_lines)
+            first = num_lines;
+        else
+            first = (unsigned int)estimate;
+
+        /* Step to the exact line, using the same latitude computation as
+           the line loop */
+        while (first > 0 && upper_left_lat - delta_latitude * (first - 1)
+            < edges[edge].max_y)
+            first--;
+        while (first < num_lines && upper_left_lat - delta_latitude * first
+            >= edges[edge].max_y)
+            first++;
+
+        if (first < num_lines && edges[edge].min_y
+            > upper_left_lat - delta_latitude * first)
+            first = num_lines;
+
+        start_line[edge] = first;
+        if (first < num_lines)
+            line_start_edge[first + 1]++;
+    }
+
+    /* Order the edges by first line.  The placement is stable, so the edges
+       for each line stay in polygon group order. */
+    for (line = 0; line < num_lines; line++)
+        line_start_edge[line + 1] += line_start_edge[line];
+    for (edge = 0; edge < num_edges; edge++)
+    {
+        if (start_line[edge] < num_lines)
+            line_edges[line_start_edge[start_line[edge]]++] = &edges[edge];
+    }
+    for (line = num_lines; line > 0; line--)
+        line_start_edge[line] = line_start_edge[line - 1];
+    line_start_edge[0] = 0;
+    free(start_line);
+
+    /* Loop through each line */
+    for (line = 0; line < num_lines; line++)
+    {
+        double latitude;            /* Latitude */
+        size_t num_kept;            /* Number of active edges kept */
+        size_t new_edge;            /* New edge loop counter */
+        size_t last_new;            /* Entry after the line's new edges */
+        size_t count;               /* Number of merged edges */
+        size_t first_crossing;      /* First crossing of the current group */
+        size_t crossing;            /* Crossing loop counter */
+        SHAPE_MASK_EDGE **swap;     /* Swap pointer for the edge tables */
+
+        latitude = upper_left_lat - delta_latitude * line;
+
+        /* Drop the edges that ended above the line */
+        for (edge = 0, num_kept = 0; edge < num_active; edge++)
+        {
+            if (active[edge]->min_y <= latitude)
+                active[num_kept++] = active[edge];
+        }
+        num_active = num_kept;
+
+        /* Merge in the edges that start at the line, keeping the active
+           table in polygon group order */
+        new_edge = line_start_edge[line];
+        last_new = line_start_edge[line + 1];
+        if (new_edge < last_new)
+        {
+            for (edge = 0, count = 0; edge < num_active
+                 || new_edge < last_new; )
+            {
+                if (new_edge == last_new || (edge < num_active
+                    && active[edge]->group <= line_edges[new_edge]->group))
+                    merged[count++] = active[edge++];
+                else
+                    merged[count++] = line_edges[new_edge++];
+            }
+
+            swap = active;
+            active = merged;
+            merged = swap;
+            num_active = count;
+        }
+
+        /* Compute the crossings the same way as the point-in-polygon test */
+        for (edge = 0; edge < num_active; edge++)
+        {
+            crossings[edge].group = active[edge]->group;
+            crossings[edge].x = (active[edge]->x1 - active[edge]->x0)
+                * (latitude - active[edge]->y0)
+                / (active[edge]->y1 - active[edge]->y0) + active[edge]->x0;
+        }
+
+        /* Fill the spans of each polygon group.  The samples from each
+           even crossing up to the next odd one have an odd number of
+           crossings east of them, so they are inside. */
+        for (first_crossing = 0; first_crossing < num_active; )
+        {
+            size_t last_crossing;   /* End of the current group */
+
+            for (last_crossing = first_crossing + 1; last_crossing
+                 < num_active && crossings[last_crossing].group
+                 == crossings[first_crossing].group; last_crossing++)
+                ;
+            sort_crossings(&crossings[first_crossing],
+                last_crossing - first_crossing);
+
+            /* An odd count only comes from a degenerate polygon, and its
+               last crossing is ignored */
+            for (crossing = first_crossing; crossing + 1 < last_crossing;
+                 crossing += 2)
+            {
+                double span_start = crossings[crossing].x; /* Span start */
+                double span_end = crossings[crossing + 1].x; /* Span end */
+                unsigned int first_sample;  /* First sample in the span */
+                unsigned int last_sample;   /* Sample after the span */
+                size_t line_start = (size_t)line * num_samples;
+
+                first_sample = find_first_sample_at_or_after(span_start,
+                    upper_left_long, delta_longitude, 0, num_samples);
+                last_sample = find_first_sample_at_or_after(span_end,
+                    upper_left_long, delta_longitude, first_sample,
+                    num_samples);
+                set_mask_bits(mask, line_start + first_sample,
+                    line_start + last_sample);
+            }
+
+            first_crossing = last_crossing;
+        }
+    } /* latitude loop */
+    
+    /* Free storage. */
+    free(edges);
+    free(line_edges);
+    free(active);
+    free(merged);
+    free(crossings);
+    free(line_start_edge);
+
+    return SUCCESS;
+}
+
+/* Inputs shared by all the tiles when building the mask from the bit mask */
+typedef struct shape_mask_tile_grid
+{
+    const IAS_IMAGE *image;         /* Input image struct pointer */
+    const unsigned char *bit_mask;  /* Bit mask of the bounding box */
+    unsigned char *mask;            /* Output mask buffer */
+    double frame_west;              /* West edge of the longitude frame */
+    double min_lng;                 /* Minimum longitude of the bit mask */
+    double max_lat;                 /* Maximum latitude of the bit mask */
+    double delta_longitude;         /* Delta longitude of the bit mask */
+    double delta_latitude;          /* Delta latitude of the bit mask */
+    int num_horz_grids;             /* Number of horizontal grids for image */
+    int num_vert_grids;             /* Number of vertical grids for image */
+    IAS_GEO_PROJ_TRANSFORMATION **thread_transformations; /* Transformation
+                                                     for each tile thread */
+} SHAPE_MASK_TILE_GRID;
+
+/*****************************************************************************
+NAME:  fill_mask_block
+
+PURPOSE:  Set the mask for a block of the image from the bit mask of the
+          bounding box.  A block whose corners fall in a part of the bit mask
+          that is all set or all clear is filled without projecting each of
+          its pixels.  Otherwise the block is split into quarters that are
+          checked the same way, down to GRID_REFINE_SIZE lines and samples,
+          so only the blocks along the polygon edges have each of their
+          pixels projected.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  Each block only writes its own part of the mask, so blocks can be
+        processed at the same time as long as each uses its own
+        transformation.  Blocks are no bigger than a grid tile.
+*****************************************************************************/
+static int fill_mask_block
+(
+    const SHAPE_MASK_TILE_GRID *tile_grid, /* I: Inputs shared by the tiles */
+    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation,/* I: Transformation
+                                                                 Projection */
+    unsigned int first_line,        /* I: First image line of the block */
+    unsigned int first_sample,      /* I: First image sample of the block */
+    unsigned int block_lines,       /* I: Number of lines in the block */
+    unsigned int block_samples      /* I: Number of samples in the block */
+)
+{
+    const IAS_IMAGE *image = tile_grid->image; /* Input image */
+    const IAS_CORNERS *corners_ptr = &image->corners; /* Image corners */
+    const unsigned char *bit_mask = tile_grid->bit_mask; /* Bit mask */
+    unsigned char *mask = tile_grid->mask; /* Output mask */
+    double frame_west = tile_grid->frame_west; /* Longitude frame */
+    double min_lng = tile_grid->min_lng;   /* Minimum longitude */
+    double max_lat = tile_grid->max_lat;   /* Maximum latitude */
+    double delta_longitude = tile_grid->delta_longitude; /* Delta longitude */
+    double delta_latitude = tile_grid->delta_latitude;   /* Delta latitude */
+    unsigned int num_lines = image->nl;     /* Number of lines in image */
+    unsigned int num_samples = image->ns;   /* Number of samples in image */
     unsigned int line;              /* Loop variable for lines in image */
     unsigned int sample;            /* Loop variable for samples in image */
     unsigned int index;             /* Loop variable for generic use */
-    double oparm[IAS_PROJ_PARAM_SIZE];/* Output projection parameters */
-    IAS_PROJECTION geographic_projection; /* Geographic projection struct */
-    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation; /* Transformation
-                                                               struct */ 
+    IAS_DBL_LS translated_pixel[4];     /* Translated  line/samp */ 
+    IAS_DBL_XY grid_corners[4];         /* UL LL UR LR */
+    int grid_value = -1;                /* Grid match value */
+    int bad_grid = 0;                   /* Boolean for bad grid check */
+
+    /* Determine corners for current block */
+    grid_corners[0].y = corners_ptr->upleft.y - (first_line
+        * image->pixel_size_y);
+    grid_corners[0].x = (first_sample * image->pixel_size_x)
+        + corners_ptr->upleft.x;
+
+    grid_corners[1].y = grid_corners[0].y - (block_lines
+        * image->pixel_size_y);
+    grid_corners[1].x = grid_corners[0].x;
+
+    grid_corners[2].y = grid_corners[0].y;
+    grid_corners[2].x = grid_corners[0].x + (block_samples
+        * image->pixel_size_x);
+
+    grid_corners[3].y = grid_corners[1].y;
+    grid_corners[3].x = grid_corners[2].x;
+    
+    /* Transform the block corners to bit mask line/sample */
+    for (index = 0; index < 4; index ++)
+    {
+        int status; /* Status placeholder */
+
+        status = convert_target_xy_to_input_line_sample(
+            &grid_corners[index], geographic_transformation, 
+            frame_west, min_lng, max_lat, 
+            delta_longitude, delta_latitude, num_samples, 
+            num_lines, &translated_pixel[index]);
+        if (status == ERROR)
+        {
+            IAS_LOG_ERROR("Translating grid corners for grid line %u"
+                " sample %u ", first_line, first_sample);
+            return ERROR;
+        }
+        else if (!status)
+        {
+            bad_grid = 1;
+        }
+    }
 
-    /* Set up pointer to image members & grid values */
-    corners_ptr = &image->corners;
-    num_lines = image->nl;
-    num_samples = image->ns;
-    num_horz_grids = floor(num_samples / GRID_SIZE_HORZ);
-    num_vert_grids = floor(num_lines / GRID_SIZE_VERT);
+    /* If all corners are in bit_mask check bit_mask grid */
+    if (!bad_grid)
+    {
+        int min_line = 0;   /* Max line index in bit_mask */
+        int max_line = 0;   /* Min line index in bit_mask */
+        int min_samp = 0;   /* Min sample index in bit_mask */
+        int max_samp = 0;   /* Max sample index in bit_mask */
+        IAS_LNG_LS max_ls;  /* Maximum line/sample */
+        IAS_LNG_LS min_ls;  /* Minimum line/sample */
+
+        /* Creating bounding box around bit_mask grid */
+        for (index = 1; index < 4; index++)
+        {
+            if (translated_pixel[min_line].line
+                > translated_pixel[index].line)
+            {
+                min_line = index;
+            }
+            else if (translated_pixel[max_line].line 
+                     < translated_pixel[index].line)
+            {
+                max_line = index;
+            }   
 
-    /* Initalize output parameters to 0.0 */
-    for (index = 0; index < IAS_PROJ_PARAM_SIZE; index++)
+            if (translated_pixel[min_samp].samp 
+                > translated_pixel[index].samp)
+            {    
+                min_samp = index;
+            }
+
+            else if (translated_pixel[max_samp].samp 
+                     < translated_pixel[index].samp)
+            {    
+                max_samp = index;
+            }
+        }
+
+        max_ls.line = translated_pixel[max_line].line + 1;
+        max_ls.samp = translated_pixel[max_samp].samp + 1;
+        min_ls.line = translated_pixel[min_line].line;
+        min_ls.samp = translated_pixel[min_samp].samp;
+
+        /* Make sure the max_ls is still in the image */
+        if (max_ls.line >= num_lines || max_ls.samp >= num_samples)
+        {
+            bad_grid = 1;
+        }
+        else
+        {
+            /* Get the bounding box check value */
+            grid_value = bit_mask[((size_t)min_ls.line * num_samples
+                + min_ls.samp) / 8];
+            if (grid_value != ALL_BITS_SET && grid_value != NO_BITS_SET)
+            {
+                bad_grid = 1;
+            }
+        }
+
+        if (!bad_grid)
+        {
+            /* Check that all the bytes holding the bounding box are
+               identical */
+            for (line = min_ls.line; line <= max_ls.line; line++)
+            {
+                size_t line_start = (size_t)line * num_samples;
+                size_t byte;        /* Bit mask byte */
+
+                for (byte = (line_start + min_ls.samp) / 8;
+                     byte <= (line_start + max_ls.samp) / 8; byte++)
+                {
+                    if (bit_mask[byte] != grid_value)
+                    {
+                        bad_grid = 1;
+                        break;  
+                    }
+                }
+
+                if (bad_grid)
+                {
+                    break;
+                }
+            }
+        }
+    }
+ 
+    /* Block is either all set bits or all empty bits */
+    if (!bad_grid)
     {
-        oparm[index] = 0.0;
+        if (grid_value == NO_BITS_SET)
+        {
+            return SUCCESS;
+        }
+
+        for (line = first_line; line < first_line + block_lines; line++)
+        {    
+            memset(&mask[(size_t)line * num_samples + first_sample],
+                IAS_GEO_SHAPE_MASK_VALID, block_samples);
+        }
+
+        return SUCCESS;
     }
 
-    /* Set up target projection */
-    ias_geo_set_projection(GEO, NULLZONE, DEGREE, WGS84_SPHEROID, oparm,
-        &geographic_projection);
+    /* Split the block into quarters to narrow down the pixels near the
+       polygon edges that have to be projected.  A side that is already
+       small enough isn't split. */
+    if (block_lines > GRID_REFINE_SIZE || block_samples > GRID_REFINE_SIZE)
+    {
+        unsigned int split_lines = block_lines;     /* Lines in the first
+                                                       half */
+        unsigned int split_samples = block_samples; /* Samples in the first
+                                                       half */
 
-    /* Create the transfomation */
-    geographic_transformation = ias_geo_create_proj_transformation(projection, 
-        &geographic_projection);
-    if (!geographic_transformation)
+        if (block_lines > GRID_REFINE_SIZE)
+            split_lines = (block_lines + 1) / 2;
+        if (block_samples > GRID_REFINE_SIZE)
+            split_samples = (block_samples + 1) / 2;
+
+        for (index = 0; index < 4; index++)
+        {
+            unsigned int sub_line = (index / 2) ? split_lines : 0;
+            unsigned int sub_sample = (index % 2) ? split_samples : 0;
+            unsigned int sub_lines = (index / 2)
+                ? block_lines - split_lines : split_lines;
+            unsigned int sub_samples = (index % 2)
+                ? block_samples - split_samples : split_samples;
+
+            if (sub_lines == 0 || sub_samples == 0)
+                continue;
+
+            if (fill_mask_block(tile_grid, geographic_transformation,
+                first_line + sub_line, first_sample + sub_sample, sub_lines,
+                sub_samples) != SUCCESS)
+            {
+                return ERROR;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    /* Loop through the block converting each pixel to lat/long, one line at
+       a time */
+    for (line = first_line; line < first_line + block_lines; line++)
+    {    
+        double pixel_x[GRID_SIZE_HORZ];   /* X coordinates of the pixels */
+        double pixel_y[GRID_SIZE_HORZ];   /* Y coordinates of the pixels */
+        double pixel_lng[GRID_SIZE_HORZ]; /* Longitudes of the pixels */
+        double pixel_lat[GRID_SIZE_HORZ]; /* Latitudes of the pixels */
+
+        /* Calculate the X/Y coordinates for the line of the block */
+        for (sample = 0; sample < block_samples; sample++)
+        {
+            pixel_x[sample] = ((first_sample + sample) 
+                * image->pixel_size_x) + corners_ptr->upleft.x;
+            pixel_y[sample] = corners_ptr->upleft.y - (line 
+                * image->pixel_size_y);
+        }
+
+        /* Transform the line of the block to lat/long */
+        if (ias_geo_transform_coordinates(geographic_transformation, 
+            block_samples, pixel_x, pixel_y, pixel_lng, pixel_lat) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Translating pixels for line %u sample %u", line,
+                first_sample);
+            return ERROR;
+        }
+
+        for (sample = first_sample; sample < first_sample + block_samples;
+             sample++)
+        {
+            int status; /* Status placeholder */
+            IAS_DBL_LAT_LONG transformed_pixel; /* Pixel lat/long */
+            IAS_DBL_LS translated_pixel; /* Translated to line/samp */
+
+            /* Check if pixel is part of bit mask */
+            transformed_pixel.lng = pixel_lng[sample - first_sample];
+            transformed_pixel.lat = pixel_lat[sample - first_sample];
+            status = convert_lat_long_to_input_line_sample(
+                &transformed_pixel, frame_west, min_lng, max_lat, 
+                delta_longitude, delta_latitude, num_samples, 
+                num_lines, &translated_pixel);
+            if (status) 
+            {
+                size_t byte;       /* Byte level indexing */
+                unsigned int bit;  /* Bit level indexing */
+                size_t mask_index; /* Pixel index in the bit mask */
+                int nearest_line = round(translated_pixel.line);
+                int nearest_sample = round(translated_pixel.samp);
+
+                /* Clamp the line to the image after rounding up might
+                   go off the edge */
+                if (nearest_line >= num_lines)
+                    nearest_line = num_lines - 1;
+                if (nearest_sample >= num_samples)
+                    nearest_sample = num_samples - 1;
+
+                mask_index = (size_t)nearest_line * num_samples
+                    + nearest_sample;
+                byte = mask_index / 8;
+                bit = 7 - mask_index % 8;
+                if (bit_mask[byte] & (1 << bit))
+                {
+                    mask[(size_t)line * num_samples + sample]
+                        = IAS_GEO_SHAPE_MASK_VALID;
+                }
+            } 
+        }
+    } 
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  fill_mask_tile
+
+PURPOSE:  Set the mask for one grid tile of the image from the bit mask of the
+          bounding box.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  Each tile only writes its own part of the mask, so tiles can be
+        processed at the same time as long as each uses its own
+        transformation.
+*****************************************************************************/
+static int fill_mask_tile
+(
+    const SHAPE_MASK_TILE_GRID *tile_grid, /* I: Inputs shared by the tiles */
+    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation,/* I: Transformation
+                                                                 Projection */
+    int vgrid,                      /* I: Vertical grid of the tile */
+    int hgrid                       /* I: Horizontal grid of the tile */
+)
+{
+    const IAS_IMAGE *image = tile_grid->image; /* Input image */
+    int grid_lines = GRID_SIZE_VERT;    /* Number of lines in grid */
+    int grid_samples = GRID_SIZE_HORZ;  /* Number of samples in grid */
+
+    /* If it is the end of the image determine smaller grid */
+    if (vgrid == tile_grid->num_vert_grids)
+    {
+        grid_lines = image->nl % GRID_SIZE_VERT;
+        if (grid_lines == 0)
+        {   
+            return SUCCESS;
+        }
+    }
+
+    /* If it is the end of the image determine smaller grid */
+    if (hgrid == tile_grid->num_horz_grids)
+    {
+        grid_samples = image->ns % GRID_SIZE_HORZ;
+        if (grid_samples == 0)
+        {   
+            return SUCCESS;
+        }
+    }
+
+    if (fill_mask_block(tile_grid, geographic_transformation,
+        GRID_SIZE_VERT * vgrid, GRID_SIZE_HORZ * hgrid, grid_lines,
+        grid_samples) != SUCCESS)
     {
-        IAS_LOG_ERROR("Creating projection transformation");
         return ERROR;
     }
 
+    ESPA_PROBE4(mask__tile, GRID_SIZE_VERT * vgrid, GRID_SIZE_HORZ * hgrid,
+        grid_lines, grid_samples);
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  fill_mask_tiles
+
+PURPOSE:  Set the mask for a range of the grid tiles of the image, numbered
+          across each row of tiles.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  Called by espa_parallel_for; the runner number selects the thread's
+        transformation.
+*****************************************************************************/
+static int fill_mask_tiles
+(
+    void *arg,                      /* I: Inputs shared by the tiles
+                                          (SHAPE_MASK_TILE_GRID) */
+    int first,                      /* I: First tile of the range */
+    int end,                        /* I: Tile after the range */
+    int runner                      /* I: Thread processing the range */
+)
+{
+    const SHAPE_MASK_TILE_GRID *tile_grid = arg; /* Inputs of the tiles */
+    int tile;                       /* Loop variable for the tiles */
+
+    for (tile = first; tile < end; tile++)
+    {
+        if (fill_mask_tile(tile_grid, 
+            tile_grid->thread_transformations[runner], 
+            tile / (tile_grid->num_horz_grids + 1),
+            tile % (tile_grid->num_horz_grids + 1)) != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  get_image_lat_long_box
+
+PURPOSE:  Find the latitude/longitude bounding box of the corners of an
+          image.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES:  If the image crosses 180 longitude, the longitudes east of it are
+        taken once around, so lower_right_long is past 180.
+*****************************************************************************/
+static int get_image_lat_long_box
+(
+    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation,/* I: Transformation
+                                                                 to lat/long */
+    const IAS_CORNERS *corners_ptr, /* I: Image corners */
+    double *upper_left_lat,         /* O: Maximum latitude of the corners */
+    double *lower_right_lat,        /* O: Minimum latitude of the corners */
+    double *upper_left_long,        /* O: Minimum longitude of the corners */
+    double *lower_right_long        /* O: Maximum longitude of the corners */
+)
+{
+    IAS_DBL_LAT_LONG corners[4];    /* Lat/Long corners: UL, UR, LL, LR */
+    double lng[4];                  /* Corner longitudes */
+    unsigned int min_lat = 0;       /* Minimum latitude */
+    unsigned int max_lat = 0;       /* Maximum latitude */
+    unsigned int min_lng = 0;       /* Minimum longitude */
+    unsigned int max_lng = 0;       /* Maximum longitude */
+    unsigned int index;             /* Loop variable for the corners */
+
     /* Convert the corner coordinates to lat/long. */
     if (ias_geo_transform_coordinate(geographic_transformation, 
             corners_ptr->upleft.x, corners_ptr->upleft.y, &corners[0].lng, 
@@ -302,7 +1726,6 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting upper left projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -312,7 +1735,6 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting upper right projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -322,7 +1744,6 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting lower left projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -332,7 +1753,6 @@ int ias_geo_shape_mask_projection
     {
         IAS_LOG_ERROR("Error converting lower right projection parameters to "
                 "lat/long.");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
         return ERROR;
     }
 
@@ -375,283 +1795,384 @@ int ias_geo_shape_mask_projection
             max_lng = index;
         }
     }
-    
-    /* Allocate memory for the bit_mask */
-    bit_mask = calloc(1, num_lines * num_samples / 8 + 1);
+
+    *upper_left_lat = corners[max_lat].lat;
+    *lower_right_lat = corners[min_lat].lat;
+    *upper_left_long = lng[min_lng];
+    *lower_right_long = lng[max_lng];
+
+    return SUCCESS;
+}
+
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_projection
+
+PURPOSE:  Generate a shape mask for a given region in a given projection.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
+
+NOTES: Mask should already be initialized when passed to the routine. It should 
+       be initialized with all zeros.
+       When built with threading enabled and the transformation is
+       threadsafe, the grid tiles are processed in parallel by the threads
+       of the task runtime (see espa_task.h).
+       The tiles are processed a row (GRID_SIZE_VERT lines) at a time.  The
+       progress is reported (see espa_progress.h) before each row, and
+       ERROR is returned if the job was cancelled.
+*****************************************************************************/
+int ias_geo_shape_mask_projection
+(
+    const char *polygon_file,         /* I: Polygon filename */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    unsigned char *mask               /* O: Mask buffer */
+)
+{
+    const IAS_CORNERS *corners_ptr; /* Image corners  */
+    double upper_left_lat;          /* Maximum latitude of the corners */
+    double lower_right_lat;         /* Minimum latitude of the corners */
+    double upper_left_long;         /* Minimum longitude of the corners */
+    double lower_right_long;        /* Maximum longitude of the corners */
+    double frame_west;              /* West edge of the longitude frame */
+    double delta_latitude;          /* Delta latitude */
+    double delta_longitude;         /* Delta longitude */
+    unsigned char *bit_mask = NULL; /* Bit mask */
+    int num_horz_grids;             /* Number of horizontal grids for image */
+    int num_vert_grids;             /* Number of vertical grids for image */
+    int num_row_tiles;              /* Number of grid tiles in a row */
+    int row;                        /* Loop variable for the rows of tiles */
+    int nthreads;                   /* Number of threads for the tiles */
+    int thread;                     /* Loop variable for threads */
+    int status = SUCCESS;           /* Status of the grid tiles */
+    unsigned int num_lines;         /* Number of lines in passed image */
+    unsigned int num_samples;       /* Number of samples in passed image */
+    size_t index;                   /* Loop variable for generic use */
+    double oparm[IAS_PROJ_PARAM_SIZE];/* Output projection parameters */
+    IAS_PROJECTION geographic_projection; /* Geographic projection struct */
+    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation; /* Transformation
+                                                               struct */ 
+    IAS_GEO_PROJ_TRANSFORMATION **thread_transformations; /* Transformation
+                                                             for each thread */
+    SHAPE_MASK_TILE_GRID tile_grid; /* Inputs shared by the grid tiles */
+    ESPA_PROFILE_SCOPE("ias_geo_shape_mask_projection");
+
+    /* Set up pointer to image members & grid values */
+    corners_ptr = &image->corners;
+    num_lines = image->nl;
+    num_samples = image->ns;
+    num_horz_grids = floor(num_samples / GRID_SIZE_HORZ);
+    num_vert_grids = floor(num_lines / GRID_SIZE_VERT);
+
+    /* Initalize output parameters to 0.0 */
+    for (index = 0; index < IAS_PROJ_PARAM_SIZE; index++)
+    {
+        oparm[index] = 0.0;
+    }
+
+    /* Set up target projection */
+    ias_geo_set_projection(GEO, NULLZONE, DEGREE, WGS84_SPHEROID, oparm,
+        &geographic_projection);
+
+    /* Get the transfomation, reusing a cached one from an earlier mask */
+    geographic_transformation = ias_geo_get_proj_transformation(projection,
+        &geographic_projection);
+    if (!geographic_transformation)
+    {
+        IAS_LOG_ERROR("Creating projection transformation");
+        return ERROR;
+    }
+
+    /* Find the lat/long bounding box of the image corners */
+    if (get_image_lat_long_box(geographic_transformation, corners_ptr,
+        &upper_left_lat, &lower_right_lat, &upper_left_long,
+        &lower_right_long) != SUCCESS)
+    {
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return ERROR;
+    }
+
+    /* Choose the longitude frame of the mask once, so the pixels of a scene
+       crossing 180 longitude are placed in the bit mask without wrapping
+       each one */
+    frame_west = set_mask_longitude_frame(upper_left_long, &lower_right_long);
+
+    /* Allocate memory for the bit_mask, backed by huge pages since the
+       tiles access it all over */
+    bit_mask = espa_alloc_large((size_t)num_lines * num_samples / 8 + 1);
     if (!bit_mask)
     {
         IAS_LOG_ERROR("Allocating memory for the bit mask");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
+        ias_geo_release_proj_transformation(geographic_transformation);
         return ERROR;
     }
     
     /* Creating the shapemask */
-    if (ias_geo_shape_mask(polygon_file, num_lines, num_samples, 
-        corners[max_lat].lat, corners[min_lat].lat, lng[min_lng],
-        lng[max_lng], bit_mask) != SUCCESS)
+    if (ias_geo_shape_mask_scanline(polygon_file, num_lines, num_samples, 
+        upper_left_lat, lower_right_lat, upper_left_long, lower_right_long,
+        bit_mask) != SUCCESS)
     {
         IAS_LOG_ERROR("Creating the shape mask");
-        ias_geo_destroy_proj_transformation(geographic_transformation);
-        free(bit_mask);
+        ias_geo_release_proj_transformation(geographic_transformation);
+        espa_free_large(bit_mask);
         return ERROR;
     }
     
+    /* The mask is already all zeros, so if none of the bounding box is
+       inside a polygon there's nothing more to do */
+    for (index = 0; index <= (size_t)num_lines * num_samples / 8; index++)
+    {
+        if (bit_mask[index] != NO_BITS_SET)
+            break;
+    }
+    if (index > (size_t)num_lines * num_samples / 8)
+    {
+        espa_free_large(bit_mask);
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return SUCCESS;
+    }
+
     /* Determine the delta latitude/longitude */
-    delta_latitude = (corners[max_lat].lat - corners[min_lat].lat) 
-        / num_lines;
-    delta_longitude = (lng[max_lng] - lng[min_lng]) / num_samples;
+    delta_latitude = (upper_left_lat - lower_right_lat) / num_lines;
+    delta_longitude = (lower_right_long - upper_left_long) / num_samples;
     
-    /* Loop through the grids */
-    for (vgrid = 0; vgrid <= num_vert_grids; vgrid++)
+    /* Set up the tile grid shared by all the tiles */
+    tile_grid.image = image;
+    tile_grid.bit_mask = bit_mask;
+    tile_grid.mask = mask;
+    tile_grid.frame_west = frame_west;
+    tile_grid.min_lng = upper_left_long;
+    tile_grid.max_lat = upper_left_lat;
+    tile_grid.delta_longitude = delta_longitude;
+    tile_grid.delta_latitude = delta_latitude;
+    tile_grid.num_horz_grids = num_horz_grids;
+    tile_grid.num_vert_grids = num_vert_grids;
+    num_row_tiles = num_horz_grids + 1;
+
+    /* The tiles are independent, so when threading is enabled they are
+       handed out to the threads as each one finishes its previous tile.
+       Each thread needs its own transformation, so the tiles are only
+       threaded when the transformation is threadsafe. */
+    nthreads = 1;
+#ifdef _OPENMP
+    if (ias_geo_is_threadsafe_transformation(geographic_transformation))
+        nthreads = espa_task_nthreads();
+#endif
+    thread_transformations = calloc(nthreads, 
+        sizeof(IAS_GEO_PROJ_TRANSFORMATION *));
+    if (!thread_transformations)
     {
-        int grid_lines = GRID_SIZE_VERT; /* Number of lines in grid */
+        IAS_LOG_ERROR("Allocating memory for the thread transformations");
+        espa_free_large(bit_mask);
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return ERROR;
+    }
 
-        /* If it is the end of the image determine smaller grid */
-        if (vgrid == num_vert_grids)
+    thread_transformations[0] = geographic_transformation;
+    for (thread = 1; thread < nthreads; thread++)
+    {
+        thread_transformations[thread] = ias_geo_get_proj_transformation(
+            projection, &geographic_projection);
+        if (!thread_transformations[thread])
         {
-            grid_lines = num_lines % GRID_SIZE_VERT;
-            if (grid_lines == 0)
-            {   
-                continue;
-            }
+            IAS_LOG_ERROR("Creating projection transformation for thread %d",
+                thread);
+            status = ERROR;
+            break;
         }
+    }
 
-        for (hgrid = 0; hgrid <= num_horz_grids; hgrid++)
-        {
-            IAS_DBL_LS translated_pixel[4];     /* Translated  line/samp */ 
-            IAS_DBL_XY grid_corners[4];         /* UL LL UR LR */
-            int grid_value = -1;                /* Grid match value */
-            int bad_grid = 0;                   /* Boolean for bad grid check */
-            int grid_samples = GRID_SIZE_HORZ;  /* Number of samples in grid */
+    /* Loop through the rows of grids, reporting the progress and checking
+       for cancellation before each row */
+    tile_grid.thread_transformations = thread_transformations;
+    for (row = 0; status == SUCCESS && row <= num_vert_grids; row++)
+    {
+        status = espa_progress_update("ias_geo_shape_mask_projection",
+            (double) row / (num_vert_grids + 1));
+        if (status != SUCCESS)
+            break;
+        status = espa_parallel_for(row * num_row_tiles,
+            (row + 1) * num_row_tiles, 1, nthreads, fill_mask_tiles,
+            &tile_grid);
+    }
 
-            /* If it is the end of the image determine smaller grid */
-            if (hgrid == num_horz_grids)
-            {
-                grid_samples = num_samples % GRID_SIZE_HORZ;
-                if (grid_samples == 0)
-                {   
-                    continue;
-                }
-            }
+    for (thread = 1; thread < nthreads; thread++)
+        ias_geo_release_proj_transformation(thread_transformations[thread]);
+    free(thread_transformations);
 
-            /* Determine corners for current grid square */
-            grid_corners[0].y = corners_ptr->upleft.y - (GRID_SIZE_VERT 
-                * vgrid * image->pixel_size_y);
-            grid_corners[0].x = (GRID_SIZE_HORZ * hgrid 
-                * image->pixel_size_x) + corners_ptr->upleft.x;
+    if (status != SUCCESS)
+    {
+        IAS_LOG_ERROR("Creating the mask from the bit mask");
+        espa_free_large(bit_mask);
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return ERROR;
+    }
 
-            grid_corners[1].y = grid_corners[0].y - (grid_lines
-                * image->pixel_size_y);
-            grid_corners[1].x = grid_corners[0].x;
+    /* Free memory */
+    espa_free_large(bit_mask);
+    ias_geo_release_proj_transformation(geographic_transformation);
 
-            grid_corners[2].y = grid_corners[0].y;
-            grid_corners[2].x = grid_corners[0].x + (grid_samples
-                * image->pixel_size_x);
+    return SUCCESS;
+}
 
-            grid_corners[3].y = grid_corners[1].y;
-            grid_corners[3].x = grid_corners[2].x;
-            
-            /* Transform the grid corners to bit mask line/sample */
-            for (index = 0; index < 4; index ++)
-            {
-                int status; /* Status placeholder */
+/*****************************************************************************
+NAME:  ias_geo_shape_mask_points
 
-                status = convert_target_xy_to_input_line_sample(
-                    &grid_corners[index], geographic_transformation, 
-                    lng[min_lng], corners[max_lat].lat, 
-                    delta_longitude, delta_latitude, num_samples, 
-                    num_lines, &translated_pixel[index]);
-                if (status == ERROR)
-                {
-                    IAS_LOG_ERROR("Translating grid corners for grid line %d"
-                        " sample %d ", vgrid * GRID_SIZE_VERT, hgrid 
-                        * GRID_SIZE_HORZ);
-                    free(bit_mask);
-                    ias_geo_destroy_proj_transformation(
-                        geographic_transformation);
-                    return ERROR;
-                }
-                else if (!status)
-                {
-                    bad_grid = 1;
-                }
-            }
+PURPOSE:  Set the mask of selected pixels of an image by testing the location
+          of each one against the polygons, rather than making the mask of the
+          whole image.
 
-            /* If all corners are in bit_mask check bit_mask grid */
-            if (!bad_grid)
-            {
-                int min_line = 0;   /* Max line index in bit_mask */
-                int max_line = 0;   /* Min line index in bit_mask */
-                int min_samp = 0;   /* Min sample index in bit_mask */
-                int max_samp = 0;   /* Max sample index in bit_mask */
-                IAS_LNG_LS max_ls;  /* Maximum line/sample */
-                IAS_LNG_LS min_ls;  /* Minimum line/sample */
-
-                /* Creating bounding box around bit_mask grid */
-                for (index = 1; index < 4; index++)
-                {
-                    if (translated_pixel[min_line].line
-                        > translated_pixel[index].line)
-                    {
-                        min_line = index;
-                    }
-                    else if (translated_pixel[max_line].line 
-                             < translated_pixel[index].line)
-                    {
-                        max_line = index;
-                    }   
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+SUCCESS  Successful completion
+ERROR    Operation failed
 
-                    if (translated_pixel[min_samp].samp 
-                        > translated_pixel[index].samp)
-                    {    
-                        min_samp = index;
-                    }
+NOTES: The location of a pixel is the same as for
+       ias_geo_shape_mask_projection, so the tested pixels get the value they
+       would have in the mask of the whole image.  Each tested pixel is set
+       to IAS_GEO_SHAPE_MASK_VALID or zero; the other pixels aren't changed.
+       This is meant for a small part of the image, such as the pixels along
+       the coastlines; every pixel is projected and tested on its own.
+*****************************************************************************/
+int ias_geo_shape_mask_points
+(
+    const char *polygon_file,         /* I: Polygon filename */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    size_t num_pixels,                /* I: Number of pixels to test */
+    const size_t *pixels,             /* I: Mask index (line * samples +
+                                            sample) of each pixel */
+    unsigned char *mask               /* I/O: Mask buffer */
+)
+{
+    double upper_left_lat;          /* Maximum latitude of the corners */
+    double lower_right_lat;         /* Minimum latitude of the corners */
+    double upper_left_long;         /* Minimum longitude of the corners */
+    double lower_right_long;        /* Maximum longitude of the corners */
+    double frame_west;              /* West edge of the longitude frame */
+    double pixel_x[GRID_SIZE_HORZ]; /* X coordinates of a batch of pixels */
+    double pixel_y[GRID_SIZE_HORZ]; /* Y coordinates of a batch of pixels */
+    double pixel_lng[GRID_SIZE_HORZ]; /* Longitudes of a batch of pixels */
+    double pixel_lat[GRID_SIZE_HORZ]; /* Latitudes of a batch of pixels */
+    double oparm[IAS_PROJ_PARAM_SIZE];/* Output projection parameters */
+    size_t first;                   /* First pixel of the batch */
+    size_t count;                   /* Number of pixels in the batch */
+    size_t index;                   /* Loop variable for the batch */
+    int status = SUCCESS;           /* Status of the pixels */
+    IAS_PROJECTION geographic_projection; /* Geographic projection struct */
+    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation; /* Transformation
+                                                               struct */
+    IAS_POLYGON_LINKED_LIST *polygon_list; /* Polygon linked list pointer */
+    IAS_POLYGON_INDEX *polygon_index; /* Index of the polygon list */
+    ESPA_PROFILE_SCOPE("ias_geo_shape_mask_points");
 
-                    else if (translated_pixel[max_samp].samp 
-                             < translated_pixel[index].samp)
-                    {    
-                        max_samp = index;
-                    }
-                }
+    if (num_pixels == 0)
+        return SUCCESS;
 
-                max_ls.line = translated_pixel[max_line].line + 1;
-                max_ls.samp = translated_pixel[max_samp].samp + 1;
-                min_ls.line = translated_pixel[min_line].line;
-                min_ls.samp = translated_pixel[min_samp].samp;
- 
-                /* Make sure the max_ls is still in the image */
-                if (max_ls.line >= num_lines || max_ls.samp >= num_samples)
-                {
-                    bad_grid = 1;
-                }
-                else
-                {
-                    /* Get the bounding box check value */
-                    grid_value = bit_mask[(min_ls.line * num_samples 
-                        + min_ls.samp) / 8];
-                    if (grid_value != ALL_BITS_SET && grid_value != NO_BITS_SET)
-                    {
-                        bad_grid = 1;
-                    }
-                }
+    /* Set up the transformation to lat/long */
+    for (index = 0; index < IAS_PROJ_PARAM_SIZE; index++)
+    {
+        oparm[index] = 0.0;
+    }
+    ias_geo_set_projection(GEO, NULLZONE, DEGREE, WGS84_SPHEROID, oparm,
+        &geographic_projection);
+    geographic_transformation = ias_geo_get_proj_transformation(projection,
+        &geographic_projection);
+    if (!geographic_transformation)
+    {
+        IAS_LOG_ERROR("Creating projection transformation");
+        return ERROR;
+    }
 
-                if (!bad_grid)
-                {
-                    /* Check that all the values in the bounding box are 
-                       identical*/
-                    for (line = min_ls.line; line < max_ls.line; line++)
-                    {
-                        for (sample = min_ls.samp; sample < max_ls.samp; 
-                             sample += 8)
-                        {
-                            int grid_index = (line * num_samples + sample) / 8;
-                            if (bit_mask[grid_index] != grid_value)
-                            {
-                                bad_grid = 1;
-                                break;  
-                            }
-                        }
-
-                        if (bad_grid)
-                        {
-                            break;
-                        }
-                    }
-                }
-            }
-         
-            /* Grid is either all set bits or all empty bits */
-            if (!bad_grid)
-            {
-                if (grid_value == NO_BITS_SET)
-                {
-                    continue;
-                }
+    /* Load and index the polygons around the image, clipped and simplified
+       at the resolution of the image */
+    if (get_image_lat_long_box(geographic_transformation, &image->corners,
+        &upper_left_lat, &lower_right_lat, &upper_left_long,
+        &lower_right_long) != SUCCESS)
+    {
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return ERROR;
+    }
 
-                for (line = GRID_SIZE_VERT * vgrid; line < GRID_SIZE_VERT 
-                 * vgrid + grid_lines; line++)
-                {    
-                    for (sample = GRID_SIZE_HORZ * hgrid; sample 
-                        < GRID_SIZE_HORZ * hgrid + grid_samples; sample++)
-                    {
-                        index = line * num_samples + sample;
-                        mask[index] = IAS_GEO_SHAPE_MASK_VALID;
-                    }
-                }
+    frame_west = set_mask_longitude_frame(upper_left_long, &lower_right_long);
+    if (load_mask_polygons(polygon_file, image->nl, image->ns,
+        upper_left_lat, lower_right_lat, upper_left_long, lower_right_long,
+        &polygon_list) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Loading the polygons for the mask");
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return ERROR;
+    }
 
-                continue;
-            }
+    polygon_index = ias_geo_create_polygon_index(polygon_list);
+    if (!polygon_index)
+    {
+        IAS_LOG_ERROR("Creating the polygon index");
+        ias_geo_free_polygon_linked_list(polygon_list);
+        ias_geo_release_proj_transformation(geographic_transformation);
+        return ERROR;
+    }
 
-            /* Loop through image converting each pixel to lat/long */
-            for (line = GRID_SIZE_VERT * vgrid; line < GRID_SIZE_VERT 
-                 * vgrid + grid_lines; line++)
-            {    
-                IAS_DBL_XY current_pixel;/* Current pixel in image using x/y */
+    /* Project the pixels a batch at a time and test each one */
+    for (first = 0; first < num_pixels && status == SUCCESS; first += count)
+    {
+        count = num_pixels - first;
+        if (count > GRID_SIZE_HORZ)
+            count = GRID_SIZE_HORZ;
 
-                /* Calculate the Y coordinate */
-                current_pixel.y = corners_ptr->upleft.y - (line 
-                    * image->pixel_size_y);
-    
-                for (sample = GRID_SIZE_HORZ * hgrid; sample < GRID_SIZE_HORZ
-                     * hgrid + grid_samples; sample++)
-                {
-                    int status; /* Status placeholder */
-                    IAS_DBL_LS translated_pixel; /* Translated to line/samp */
-
-                    /* Calculate the X Coordinate */
-                    current_pixel.x = (sample * image->pixel_size_x) 
-                        + corners_ptr->upleft.x;
-
-                    /* Check if pixel is part of bit mask */
-                    status = convert_target_xy_to_input_line_sample(
-                        &current_pixel, geographic_transformation, 
-                        lng[min_lng], corners[max_lat].lat, 
-                        delta_longitude, delta_latitude, num_samples, 
-                        num_lines, &translated_pixel);
-                    if (status == ERROR)
-                    {
-                        IAS_LOG_ERROR("Translating pixel for line %d sample %d",
-                            line, sample);
-                        free(bit_mask);
-                        ias_geo_destroy_proj_transformation(
-                            geographic_transformation);
-                        return ERROR;
-                    }
-                    else if (status) 
-                    {
-                        unsigned int byte; /* Byte level indexing */
-                        unsigned int bit;  /* Bit level indexing */
-                        int mask_index;
-                        int nearest_line = round(translated_pixel.line);
-                        int nearest_sample = round(translated_pixel.samp);
-
-                        /* Clamp the line to the image after rounding up might
-                           go off the edge */
-                        if (nearest_line >= num_lines)
-                            nearest_line = num_lines - 1;
-                        if (nearest_sample >= num_samples)
-                            nearest_sample = num_samples - 1;
-
-                        mask_index = nearest_line * num_samples 
-                            + nearest_sample;
-                        byte = mask_index / 8;
-                        bit = 7 - mask_index % 8;
-                        index = line * num_samples + sample;
-                        if (bit_mask[byte] & (1 << bit))
-                        {
-                            mask[index] = IAS_GEO_SHAPE_MASK_VALID;
-                        }
-                    } 
-                }
-            } 
+        for (index = 0; index < count; index++)
+        {
+            size_t pixel = pixels[first + index];   /* Pixel mask index */
+
+            pixel_x[index] = (pixel % image->ns) * image->pixel_size_x
+                + image->corners.upleft.x;
+            pixel_y[index] = image->corners.upleft.y
+                - (pixel / image->ns) * image->pixel_size_y;
+        }
+
+        if (ias_geo_transform_coordinates(geographic_transformation, count,
+            pixel_x, pixel_y, pixel_lng, pixel_lat) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Translating the pixels to lat/long");
+            status = ERROR;
+            break;
+        }
+
+        for (index = 0; index < count; index++)
+        {
+            IAS_POLYGON_LINKED_LIST *polygon_hit; /* Polygon hit */
+            double distance = 1e10; /* Distance to the polygon boundary */
+            double longitude = get_frame_longitude(pixel_lng[index],
+                frame_west);        /* Pixel longitude in the frame */
+            int inside_flag;        /* Inside/Outside polygon flag */
+
+            inside_flag = ias_geo_point_in_indexed_shape_distance(
+                polygon_index, pixel_lat[index], longitude, &distance,
+                &polygon_hit);
+            if (inside_flag == ERROR)
+            {
+                IAS_LOG_ERROR("Testing pixel %zu against the polygons",
+                    pixels[first + index]);
+                status = ERROR;
+                break;
+            }
+            mask[pixels[first + index]] = inside_flag
+                ? IAS_GEO_SHAPE_MASK_VALID : 0;
         }
     }
 
-    /* Free memory */
-    free(bit_mask);
-    ias_geo_destroy_proj_transformation(geographic_transformation);
+    /* Free storage. */
+    ias_geo_destroy_polygon_index(polygon_index);
+    ias_geo_free_polygon_linked_list(polygon_list);
+    ias_geo_release_proj_transformation(geographic_transformation);
 
-    return SUCCESS;
+    return status;
 }
 
 /*****************************************************************************
@@ -725,6 +2246,100 @@ int ias_geo_point_in_shape
     return FALSE;
 }
 
+/*****************************************************************************
+NAME:  check_polygon_distance
+
+PURPOSE:  Determine whether a given point is within one polygon of a set, and
+          update the distance (in the latitude or longitude direction) to the
+          nearest polygon boundary.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+FALSE    Point outside the polygon; the search should continue
+TRUE     Point inside the polygon; in_shape holds the result for the set
+ERROR    Unable to compute
+*****************************************************************************/
+static int check_polygon_distance
+(
+    IAS_POLYGON_LINKED_LIST *polygon,   /* I: Polygon to check */
+    double latitude,        /* I: Point latitude (degrees) */
+    double longitude,       /* I: Point longitude (degrees) */
+    unsigned int direction, /* I: Direction to measure distance: 0 = x, 1 = y */
+    double *distance,       /* I/O: Distance from point to polygon boundary in 
+                                    specified direction */
+    IAS_POLYGON_LINKED_LIST **polygon_hit, /* O: Polygon hit */
+    int *in_shape           /* O: Whether the point is inside the set, when
+                                  the point is inside this polygon */
+)
+{
+    IAS_POLYGON_LINKED_LIST *child_hit; /* Child polygon hit */
+    double hit_distance;                /* Distance from point to polygon */
+    int inside;                         /* Inside/outside polygon flag */
+
+    /* Check the bounding box, and only consider polygons with
+       bounding boxes within the current minimum distance. */
+    if (polygon->min_y > latitude || polygon->max_y < latitude 
+        || polygon->max_x < longitude || polygon->min_x > longitude 
+        + *distance)
+    {
+        return FALSE;
+    }
+            
+    /* Determine whether the point is inside or outside the polygon. */
+    inside = ias_math_point_in_closed_polygon_distance(polygon->num_points 
+        - 1, polygon->point_x, polygon->point_y, longitude, latitude,
+        polygon->num_segs, polygon->poly_seg, direction, &hit_distance);
+    if (inside == ERROR)
+    {
+        IAS_LOG_ERROR("Checking point in polygon distance ");
+        return ERROR;
+    }
+
+    if (inside)
+    {
+        *polygon_hit = polygon;
+        *distance = hit_distance;
+        *in_shape = TRUE;
+        
+        /* If there are polygons within this one and we're inside a child
+           polygon, then our point is considered to be outside the parent
+           polygon. */
+        if (polygon->child)
+        {
+            inside = ias_geo_point_in_shape_distance(polygon->child, 
+                latitude, longitude, direction, &hit_distance, &child_hit);
+            if (inside == ERROR)
+            {
+                IAS_LOG_ERROR("Computing the point in shape distance");
+                return ERROR;
+            }
+            
+            /* No error check the distance */
+            if (inside || (hit_distance > 0 && hit_distance < *distance))
+            {
+                *polygon_hit = child_hit;
+                *distance = hit_distance;
+
+                if (inside)
+                {
+                    *in_shape = FALSE;
+                }
+            }
+        }
+        
+        return TRUE;
+    }
+    else if (hit_distance > 0 && hit_distance < *distance)
+    {
+        *polygon_hit = polygon;
+        *distance = hit_distance;
+    }
+
+    return FALSE;
+}
+
 /*****************************************************************************
 NAME:  ias_geo_point_in_shape_distance
 
@@ -752,70 +2367,21 @@ int ias_geo_point_in_shape_distance
 )
 {
     IAS_POLYGON_LINKED_LIST *polygon;   /* Polygon linked list pointer */
-    IAS_POLYGON_LINKED_LIST *child_hit; /* Child polygon hit */
-    double hit_distance;                /* Distance from point to polygon */
-    int inside;                         /* Inside/outside polygon flag */
+    int in_shape;                       /* Inside/outside shape flag */
+    int status;                         /* Polygon check status */
 
     polygon = polygon_list;
     while (polygon)
     {
-        /* Check the bounding box, and only consider polygons with
-           bounding boxes within the current minimum distance. */
-        if (polygon->min_y > latitude || polygon->max_y < latitude 
-            || polygon->max_x < longitude || polygon->min_x > longitude 
-            + *distance)
+        status = check_polygon_distance(polygon, latitude, longitude,
+            direction, distance, polygon_hit, &in_shape);
+        if (status == ERROR)
         {
-            polygon = polygon->next;
-            continue;
-        }
-                
-        /* Determine whether the point is inside or outside the polygon. */
-        inside = ias_math_point_in_closed_polygon_distance(polygon->num_points 
-            - 1, polygon->point_x, polygon->point_y, longitude, latitude,
-            polygon->num_segs, polygon->poly_seg, direction, &hit_distance);
-        if (inside == ERROR)
-        {
-            IAS_LOG_ERROR("Checking point in polygon distance ");
             return ERROR;
         }
-
-        if (inside)
-        {
-            *polygon_hit = polygon;
-            *distance = hit_distance;
-            
-            /* If there are polygons within this one and we're inside a child
-               polygon, then our point is considered to be outside the parent
-               polygon. */
-            if (polygon->child)
-            {
-                inside = ias_geo_point_in_shape_distance(polygon->child, 
-                    latitude, longitude, direction, &hit_distance, &child_hit);
-                if (inside == ERROR)
-                {
-                    IAS_LOG_ERROR("Computing the point in shape distance");
-                    return ERROR;
-                }
-                
-                /* No error check the distance */
-                if (inside || (hit_distance > 0 && hit_distance < *distance))
-                {
-                    *polygon_hit = child_hit;
-                    *distance = hit_distance;
-
-                    if (inside)
-                    {
-                        return FALSE;
-                    }
-                }
-            }
-            
-            return TRUE;
-        }
-        else if (hit_distance > 0 && hit_distance < *distance)
+        else if (status)
         {
-            *polygon_hit = polygon;
-            *distance = hit_distance;
+            return in_shape;
         }
 
         /* Point to next polygon. */
@@ -824,3 +2390,105 @@ int ias_geo_point_in_shape_distance
     
     return FALSE;
 }
+
+/*****************************************************************************
+NAME:  ias_geo_point_in_indexed_shape_distance
+
+PURPOSE:  Determine whether a given point is within a set of polygons, and
+          find the distance in the longitude direction to the nearest polygon
+          boundary, using an index of the polygon list.  Only the polygons
+          listed for the index cell holding the point are checked.
+
+RETURN VALUE:
+Type = int
+Value    Description
+-----    -----------
+FALSE    Point outside the polygons
+TRUE     Point inside a polygon
+ERROR    Unable to compute
+
+NOTES:  When the point is outside the polygons, the distance is limited to the
+        end of the index cell, since polygons in the following cells were not
+        checked.
+*****************************************************************************/
+int ias_geo_point_in_indexed_shape_distance
+(
+    const IAS_POLYGON_INDEX *index, /* I: Index of the polygon list */
+    double latitude,        /* I: Point latitude (degrees) */
+    double longitude,       /* I: Point longitude (degrees) */
+    double *distance,       /* I/O: Distance from point to polygon boundary in
+                                    the longitude direction */
+    IAS_POLYGON_LINKED_LIST **polygon_hit  /* O: Polygon hit */
+)
+{
+    double tolerance;           /* Cell boundary tolerance */
+    double cell_end;            /* Longitude of the end of the cell */
+    double cell;                /* Cell of the point */
+    unsigned int x_cell;        /* X cell of the point */
+    unsigned int y_cell;        /* Y cell of the point */
+    unsigned int entry;         /* Cell entry loop counter */
+    unsigned int last_entry;    /* Entry after the last one for the cell */
+    int in_shape;               /* Inside/outside shape flag */
+    int status;                 /* Polygon check status */
+
+    /* No polygon can hold or be crossed by a point outside the grid at this
+       latitude or past the end of the grid */
+    if (index->cell_start[index->num_cells_x * index->num_cells_y] == 0
+        || latitude < index->min_y || latitude > index->max_y
+        || longitude > index->max_x)
+    {
+        return FALSE;
+    }
+
+    /* Before the grid, the first boundary can't be closer than the start of
+       the grid */
+    if (longitude < index->min_x)
+    {
+        if (index->min_x - longitude < *distance)
+            *distance = index->min_x - longitude;
+        return FALSE;
+    }
+
+    /* Find the cell holding the point */
+    cell = floor((latitude - index->min_y) / index->cell_size_y);
+    y_cell = (cell > index->num_cells_y - 1) ? index->num_cells_y - 1 
+        : (unsigned int)cell;
+    cell = floor((longitude - index->min_x) / index->cell_size_x);
+    x_cell = (cell > index->num_cells_x - 1) ? index->num_cells_x - 1 
+        : (unsigned int)cell;
+
+    /* A point on the end of a cell is handled in the next cell, so the
+       remaining distance in the cell is always positive.  The cells overlap
+       by the same tolerance, so the polygons touching the point are in the
+       next cell as well. */
+    tolerance = index->cell_size_x * 1.0e-6;
+    cell_end = index->min_x + (x_cell + 1) * index->cell_size_x;
+    if (x_cell < index->num_cells_x - 1 && cell_end - longitude <= tolerance)
+    {
+        x_cell++;
+        cell_end += index->cell_size_x;
+    }
+
+    /* Don't look past the end of the cell, except in the last cell */
+    if (x_cell < index->num_cells_x - 1 && cell_end - longitude < *distance)
+        *distance = cell_end - longitude;
+
+    /* Check the polygons for the cell */
+    entry = index->cell_start[y_cell * index->num_cells_x + x_cell];
+    last_entry = index->cell_start[y_cell * index->num_cells_x + x_cell + 1];
+    for (; entry < last_entry; entry++)
+    {
+        status = check_polygon_distance(index->cell_polygons[entry], latitude,
+            longitude, 0, distance, polygon_hit, &in_shape);
+        if (status == ERROR)
+        {
+            return ERROR;
+        }
+        else if (status)
+        {
+            return in_shape;
+        }
+    }
+
+    return FALSE;
+}
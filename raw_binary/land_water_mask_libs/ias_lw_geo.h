@@ -4,6 +4,7 @@
 #define IAS_LW_GEO_H
 
 #include <stdio.h>
+#include <stdint.h>
 #include "ias_structures.h"
 #include "ias_math.h"
 
@@ -18,6 +19,10 @@
 /* Define shape mask value */
 #define IAS_GEO_SHAPE_MASK_VALID 0x1
 
+/* Number of unused projection transformations kept for reuse by
+   ias_geo_get_proj_transformation */
+#define IAS_GEO_PROJ_CACHE_SIZE 16
+
 /* Type defines for projection related structures */
 typedef struct ias_geo_proj_transformation IAS_GEO_PROJ_TRANSFORMATION;
 /* The ias_projection structure matches the gctp_projection structure
@@ -34,6 +39,110 @@ typedef struct ias_projection
                         /* Array of projection parameters */
 } IAS_PROJECTION;
 
+/* Maximum number of index cells in each direction for the polygon index */
+#define IAS_POLYGON_INDEX_MAX_CELLS 256
+
+/* Number of sides in each segment of a polygon built by ias_geo_clip_polygon
+   or ias_geo_simplify_polygon.  Smaller polygons are built without
+   segments. */
+#define IAS_POLYGON_SEGMENT_SIZE 64
+
+/* Packed grid index over the bounding boxes of a polygon list.  The grid
+   covers the combined bounding box of the polygons, and each cell lists the
+   polygons whose bounding box overlaps the cell.  The polygons for cell
+   (x_cell, y_cell) are cell_polygons[cell_start[c]] through
+   cell_polygons[cell_start[c + 1] - 1], where
+   c = y_cell * num_cells_x + x_cell. */
+typedef struct ias_polygon_index
+{
+    double min_x;               /* Minimum x bounds of the grid */
+    double max_x;               /* Maximum x bounds of the grid */
+    double min_y;               /* Minimum y bounds of the grid */
+    double max_y;               /* Maximum y bounds of the grid */
+    double cell_size_x;         /* Size of each cell in x */
+    double cell_size_y;         /* Size of each cell in y */
+    unsigned int num_cells_x;   /* Number of cells in x */
+    unsigned int num_cells_y;   /* Number of cells in y */
+    unsigned int *cell_start;   /* Start of each cell's polygons in
+                                   cell_polygons (num cells + 1 entries) */
+    IAS_POLYGON_LINKED_LIST **cell_polygons; /* Polygons for each cell */
+} IAS_POLYGON_INDEX;
+
+/* Magic string at the start of a packed polygon file */
+#define IAS_PACKED_POLYGON_MAGIC "IASPPLY1"
+#define IAS_PACKED_POLYGON_MAGIC_SIZE 8
+
+/* Header of a packed polygon file.  A packed polygon file holds the same
+   polygons as a polygon file written by ias_geo_dump_polygon, laid out so it
+   can be memory mapped and used without reading or copying the vertices:
+     - the polygon records, with the top-level polygons first in file order
+       and the children of each polygon stored as a contiguous run of
+       records
+     - the x and y vertices of all the polygons, each as one contiguous
+       array, including the final point that duplicates the first point
+     - the polygon segments of all the polygons
+     - a grid index of the top-level polygons, laid out the same as an
+       IAS_POLYGON_INDEX with record numbers in place of the polygon pointers
+   Each section starts at the byte offset given in the header, aligned to 8
+   bytes.  The values are in the native byte order, the same as the polygon
+   files. */
+typedef struct ias_packed_polygon_header
+{
+    char magic[IAS_PACKED_POLYGON_MAGIC_SIZE]; /* IAS_PACKED_POLYGON_MAGIC */
+    uint32_t num_polygons;      /* Total number of polygon records */
+    uint32_t num_top_polygons;  /* Number of top-level polygon records */
+    uint64_t num_points;        /* Total number of vertices */
+    uint64_t num_segs;          /* Total number of polygon segments */
+    double min_x;               /* Minimum x bounds of the index grid */
+    double max_x;               /* Maximum x bounds of the index grid */
+    double min_y;               /* Minimum y bounds of the index grid */
+    double max_y;               /* Maximum y bounds of the index grid */
+    double cell_size_x;         /* Size of each index cell in x */
+    double cell_size_y;         /* Size of each index cell in y */
+    uint32_t num_cells_x;       /* Number of index cells in x */
+    uint32_t num_cells_y;       /* Number of index cells in y */
+    uint64_t num_cell_entries;  /* Number of index cell entries */
+    uint64_t records_offset;    /* Offset of the polygon records */
+    uint64_t point_x_offset;    /* Offset of the x vertices */
+    uint64_t point_y_offset;    /* Offset of the y vertices */
+    uint64_t segs_offset;       /* Offset of the polygon segments */
+    uint64_t cell_start_offset; /* Offset of the index cell starts
+                                   (num cells + 1 entries) */
+    uint64_t cell_polygons_offset; /* Offset of the index cell entries */
+} IAS_PACKED_POLYGON_HEADER;
+
+/* Polygon record in a packed polygon file */
+typedef struct ias_packed_polygon_record
+{
+    uint32_t id;                /* Polygon id */
+    uint32_t num_points;        /* Number of vertices, including the final
+                                   point that duplicates the first point */
+    uint32_t num_segs;          /* Number of polygon segments */
+    uint32_t num_children;      /* Number of child polygons */
+    uint32_t first_child;       /* Record number of the first child */
+    uint32_t unused;            /* Pads the record to an 8 byte boundary */
+    uint64_t first_point;       /* First vertex of the polygon */
+    uint64_t first_seg;         /* First segment of the polygon */
+    double min_x;               /* Minimum x bounds */
+    double max_x;               /* Maximum x bounds */
+    double min_y;               /* Minimum y bounds */
+    double max_y;               /* Maximum y bounds */
+} IAS_PACKED_POLYGON_RECORD;
+
+/* Read-only memory mapping of a packed polygon file */
+typedef struct ias_packed_polygon
+{
+    void *map;                  /* Start of the mapping */
+    size_t map_size;            /* Size of the mapping in bytes */
+    const IAS_PACKED_POLYGON_HEADER *header;  /* File header */
+    const IAS_PACKED_POLYGON_RECORD *records; /* Polygon records */
+    const double *point_x;      /* X vertices */
+    const double *point_y;      /* Y vertices */
+    const IAS_POLYGON_SEGMENT *poly_seg;      /* Polygon segments */
+    const uint32_t *cell_start; /* Index cell starts */
+    const uint32_t *cell_polygons;            /* Index cell entries */
+} IAS_PACKED_POLYGON;
+
 int ias_geo_check_start_end_date
 (
     int isdate,   /* I: start date (YYYYMMDD) */
@@ -501,8 +610,26 @@ void ias_geo_destroy_proj_transformation
     IAS_GEO_PROJ_TRANSFORMATION *trans
 );
 
+IAS_GEO_PROJ_TRANSFORMATION *ias_geo_get_proj_transformation
+(
+    const IAS_PROJECTION *source_projection, /* I: source projection */
+    const IAS_PROJECTION *target_projection  /* I: target projection */
+);
+
+void ias_geo_release_proj_transformation
+(
+    IAS_GEO_PROJ_TRANSFORMATION *trans
+);
+
+void ias_geo_clear_proj_transformation_cache();
+
 void ias_geo_only_allow_threadsafe_transforms();
 
+int ias_geo_is_threadsafe_transformation
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans
+);
+
 int ias_geo_transform_coordinate
 (
     const IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation to use */
@@ -512,6 +639,16 @@ int ias_geo_transform_coordinate
     double *outy            /* O: Output Y projection coordinate */
 );
 
+int ias_geo_transform_coordinates
+(
+    const IAS_GEO_PROJ_TRANSFORMATION *trans, /* I: transformation to use */
+    int count,              /* I: Number of coordinates */
+    const double *inx,      /* I: Input X projection coordinates */
+    const double *iny,      /* I: Input Y projection coordinates */
+    double *outx,           /* O: Output X projection coordinates */
+    double *outy            /* O: Output Y projection coordinates */
+);
+
 void ias_geo_set_projection
 (
     int proj_code,          /* I: input projection code */
@@ -563,6 +700,79 @@ int ias_geo_reduce_polygon
     double lower_right_y                    /* I: Lower right y */
 );
 
+int ias_geo_clip_polygon
+(
+    const IAS_POLYGON_LINKED_LIST *polygon_list, /* I: First polygon in list */
+    double upper_left_x,                    /* I: Upper left x */
+    double lower_right_x,                   /* I: Lower right x */
+    double upper_left_y,                    /* I: Upper left y */
+    double lower_right_y,                   /* I: Lower right y */
+    IAS_POLYGON_LINKED_LIST **clipped_list  /* O: First clipped polygon */
+);
+
+void ias_geo_shift_polygon
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list,  /* I/O: First polygon in list */
+    double shift_x                          /* I: Amount added to x */
+);
+
+int ias_geo_simplify_polygon
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list,  /* I/O: First polygon in list */
+    double tolerance                        /* I: Simplification tolerance */
+);
+
+IAS_POLYGON_INDEX *ias_geo_create_polygon_index
+(
+    IAS_POLYGON_LINKED_LIST *polygon_list   /* I: First polygon in list */
+);
+
+void ias_geo_destroy_polygon_index
+(
+    IAS_POLYGON_INDEX *index                /* I: Polygon index to free */
+);
+
+int ias_geo_write_packed_polygon
+(
+    const char *packed_file,                /* I: Packed polygon filename */
+    const IAS_POLYGON_LINKED_LIST *polygon_list /* I: First polygon in list */
+);
+
+int ias_geo_is_packed_polygon_file
+(
+    const char *polygon_file                /* I: Polygon filename */
+);
+
+IAS_PACKED_POLYGON *ias_geo_open_packed_polygon
+(
+    const char *packed_file                 /* I: Packed polygon filename */
+);
+
+void ias_geo_close_packed_polygon
+(
+    IAS_PACKED_POLYGON *packed              /* I: Packed polygon to close */
+);
+
+int ias_geo_load_packed_polygon
+(
+    const IAS_PACKED_POLYGON *packed,   /* I: Packed polygon file */
+    double upper_left_x,                /* I: Upper left x */
+    double lower_right_x,               /* I: Lower right x */
+    double upper_left_y,                /* I: Upper left y */
+    double lower_right_y,               /* I: Lower right y */
+    IAS_POLYGON_LINKED_LIST **head      /* O: Polygon pointer */
+);
+
+void ias_geo_free_packed_polygon_linked_list
+(
+    IAS_POLYGON_LINKED_LIST *polygon    /* I: First polygon in list */
+);
+
+int ias_geo_keep_packed_polygon_resident
+(
+    const char *polygon_file    /* I: Packed polygon filename */
+);
+
 int ias_geo_shape_mask
 (
     const char *polygon_file,   /* I: Polygon filename */
@@ -575,6 +785,27 @@ int ias_geo_shape_mask
     unsigned char *mask         /* O: Mask buffer */
 );
 
+int ias_geo_shape_mask_scanline
+(
+    const char *polygon_file,   /* I: Polygon filename */
+    unsigned int num_lines,     /* I: Number of lines in mask */
+    unsigned int num_samples,   /* I: Number of samples in mask */
+    double upper_left_lat,      /* I: Upper left latitude for mask */
+    double lower_right_lat,     /* I: Lower right latitude for mask */
+    double upper_left_long,     /* I: Upper left longitude for mask */
+    double lower_right_long,    /* I: Lower right longitude for mask */
+    unsigned char *mask         /* O: Mask buffer */
+);
+
+void ias_geo_expand_mask_bits
+(
+    const unsigned char *bit_mask, /* I: Bit mask */
+    size_t first_bit,       /* I: First bit to expand */
+    size_t num_bits,        /* I: Number of bits to expand */
+    unsigned char value,    /* I: Value for the set bits */
+    unsigned char *mask     /* O: Byte mask, one byte per bit */
+);
+
 int ias_geo_shape_mask_projection
 (
     const char *polygon_file,         /* I: Polygon filename */
@@ -583,6 +814,17 @@ int ias_geo_shape_mask_projection
     unsigned char *mask               /* O: Mask buffer */
 );
 
+int ias_geo_shape_mask_points
+(
+    const char *polygon_file,         /* I: Polygon filename */
+    const IAS_IMAGE *image,           /* I: Input image struct pointer */
+    const IAS_PROJECTION *projection, /* I: Input projection struct pointer */
+    size_t num_pixels,                /* I: Number of pixels to test */
+    const size_t *pixels,             /* I: Mask index (line * samples +
+                                            sample) of each pixel */
+    unsigned char *mask               /* I/O: Mask buffer */
+);
+
 int ias_geo_point_in_shape
 (
     IAS_POLYGON_LINKED_LIST *polygon_list,  /* I: Polygon list */
@@ -601,4 +843,14 @@ int ias_geo_point_in_shape_distance
     IAS_POLYGON_LINKED_LIST **polygon_hit  /* O: Polygon hit */
 );
 
+int ias_geo_point_in_indexed_shape_distance
+(
+    const IAS_POLYGON_INDEX *index, /* I: Index of the polygon list */
+    double latitude,        /* I: Point latitude (degrees) */
+    double longitude,       /* I: Point longitude (degrees) */
+    double *distance,       /* I/O: Distance from point to polygon boundary in
+                                    the longitude direction */
+    IAS_POLYGON_LINKED_LIST **polygon_hit  /* O: Polygon hit */
+);
+
 #endif
@@ -1,3 +1,15 @@
+/* Standard Library Includes */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define POLYGON_HAVE_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define POLYGON_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
 /* IAS Library Includes */
 #include "ias_logging.h"
 #include "ias_types.h"  
@@ -5,6 +17,444 @@
 #include "ias_math.h"
 #include "ias_const.h"
 
+/* Instruction sets for the polygon side kernels.  Each kernel has a scalar
+   version, AVX2 and AVX-512 versions for x86, and a NEON version for 64-bit
+   ARM.  The vector kernels test 4, 8, or 2 sides at a time, loading the
+   first and second vertex of each side from the vertex arrays at
+   consecutive offsets, and give the same results as the scalar kernels.
+   The ESPA_POLYGON_ISA environment variable can be set to "scalar" to
+   force the scalar kernels (used for verifying the vector kernels). */
+typedef enum
+{
+    POLYGON_SCALAR,
+    POLYGON_AVX2,
+    POLYGON_AVX512,
+    POLYGON_NEON
+} POLYGON_ISA;
+
+/* Instruction set used by the kernels; chosen on first use */
+static int polygon_isa = -1;
+
+/*****************************************************************************
+NAME:  get_polygon_isa
+
+PURPOSE: Determine the instruction set to be used for the polygon side
+         kernels.
+
+RETURN VALUE:
+Type = POLYGON_ISA
+Value           Description
+-----           -----------
+POLYGON_SCALAR  Scalar kernels are used
+POLYGON_AVX2    AVX2 kernels are used
+POLYGON_AVX512  AVX-512 kernels are used
+POLYGON_NEON    NEON kernels are used
+
+Notes:  If this is first called from multiple threads at once, each thread
+        determines and stores the same value.
+*****************************************************************************/
+static POLYGON_ISA get_polygon_isa()
+{
+    char *isa_env;              /* Value of the ESPA_POLYGON_ISA variable */
+    int isa = POLYGON_SCALAR;   /* Instruction set to be used */
+
+    if (polygon_isa != -1)
+        return (POLYGON_ISA)polygon_isa;
+
+    isa_env = getenv("ESPA_POLYGON_ISA");
+    if (isa_env == NULL || strcmp(isa_env, "scalar"))
+    {
+#if defined(POLYGON_HAVE_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            isa = POLYGON_AVX512;
+        else if (__builtin_cpu_supports("avx2"))
+            isa = POLYGON_AVX2;
+#elif defined(POLYGON_HAVE_NEON)
+        isa = POLYGON_NEON;
+#endif
+    }
+
+    polygon_isa = isa;
+    return (POLYGON_ISA)isa;
+}
+
+/*****************************************************************************
+Scalar kernels.  These also handle the sides left over at the end of a range
+by the vector kernels.
+
+count_crossings returns the number of sides from first_point up to
+last_point crossed by a ray from the point toward +y.  count_crossings_distance
+does the same, and also lowers min_distance to the distance along the ray to
+each crossing.
+*****************************************************************************/
+static unsigned int count_crossings_scalar
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+
+    for (point = first_point; point < last_point; point++)
+    {
+        if (((vert_x[point] > point_x) != (vert_x[point + 1] > point_x))
+            && (point_y < (vert_y[point + 1] - vert_y[point])
+            * (point_x - vert_x[point]) / (vert_x[point + 1]
+            - vert_x[point]) + vert_y[point]))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static unsigned int count_crossings_distance_scalar
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point,
+    double *min_distance
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    double local_distance;      /* Distance to the crossing */
+
+    for (point = first_point; point < last_point; point++)
+    {
+        if ((vert_x[point] > point_x) == (vert_x[point + 1] > point_x))
+            continue;
+
+        local_distance = (vert_y[point + 1] - vert_y[point])
+            * (point_x - vert_x[point]) / (vert_x[point + 1]
+            - vert_x[point]) + vert_y[point] - point_y;
+
+        if (local_distance <= 0)
+            continue;
+
+        count++;
+        if (local_distance < *min_distance)
+            *min_distance = local_distance;
+    }
+
+    return count;
+}
+
+#if defined(POLYGON_HAVE_X86)
+/*****************************************************************************
+AVX2 kernels (4 sides at a time)
+*****************************************************************************/
+__attribute__ ((target ("avx2")))
+static unsigned int count_crossings_avx2
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    __m256d px = _mm256_set1_pd(point_x);
+    __m256d py = _mm256_set1_pd(point_y);
+
+    for (point = first_point; point + 4 <= last_point; point += 4)
+    {
+        __m256d x0 = _mm256_loadu_pd(&vert_x[point]);
+        __m256d x1 = _mm256_loadu_pd(&vert_x[point + 1]);
+        __m256d y0 = _mm256_loadu_pd(&vert_y[point]);
+        __m256d y1 = _mm256_loadu_pd(&vert_y[point + 1]);
+        __m256d straddle;       /* Sides with ends on each side of x */
+        __m256d cross_y;        /* Y of the crossing of each side */
+
+        straddle = _mm256_xor_pd(_mm256_cmp_pd(x0, px, _CMP_GT_OQ),
+            _mm256_cmp_pd(x1, px, _CMP_GT_OQ));
+        cross_y = _mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(
+            _mm256_sub_pd(y1, y0), _mm256_sub_pd(px, x0)),
+            _mm256_sub_pd(x1, x0)), y0);
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_and_pd(
+            straddle, _mm256_cmp_pd(py, cross_y, _CMP_LT_OQ))));
+    }
+
+    return count + count_crossings_scalar(vert_x, vert_y, point_x, point_y,
+        point, last_point);
+}
+
+__attribute__ ((target ("avx2")))
+static unsigned int count_crossings_distance_avx2
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point,
+    double *min_distance
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int lane;          /* Lane loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    double lanes[4];            /* Lanes of the minimum distance */
+    __m256d px = _mm256_set1_pd(point_x);
+    __m256d py = _mm256_set1_pd(point_y);
+    __m256d zero = _mm256_setzero_pd();
+    __m256d no_crossing = _mm256_set1_pd(HUGE_VAL);
+    __m256d min_dist = no_crossing;
+
+    for (point = first_point; point + 4 <= last_point; point += 4)
+    {
+        __m256d x0 = _mm256_loadu_pd(&vert_x[point]);
+        __m256d x1 = _mm256_loadu_pd(&vert_x[point + 1]);
+        __m256d y0 = _mm256_loadu_pd(&vert_y[point]);
+        __m256d y1 = _mm256_loadu_pd(&vert_y[point + 1]);
+        __m256d distance;       /* Distance to the crossing of each side */
+        __m256d crossed;        /* Sides crossed ahead of the point */
+
+        distance = _mm256_sub_pd(_mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(
+            _mm256_sub_pd(y1, y0), _mm256_sub_pd(px, x0)),
+            _mm256_sub_pd(x1, x0)), y0), py);
+        crossed = _mm256_and_pd(_mm256_xor_pd(
+            _mm256_cmp_pd(x0, px, _CMP_GT_OQ),
+            _mm256_cmp_pd(x1, px, _CMP_GT_OQ)),
+            _mm256_cmp_pd(distance, zero, _CMP_GT_OQ));
+        count += __builtin_popcount(_mm256_movemask_pd(crossed));
+        min_dist = _mm256_min_pd(min_dist,
+            _mm256_blendv_pd(no_crossing, distance, crossed));
+    }
+
+    _mm256_storeu_pd(lanes, min_dist);
+    for (lane = 0; lane < 4; lane++)
+    {
+        if (lanes[lane] < *min_distance)
+            *min_distance = lanes[lane];
+    }
+
+    return count + count_crossings_distance_scalar(vert_x, vert_y, point_x,
+        point_y, point, last_point, min_distance);
+}
+
+/*****************************************************************************
+AVX-512 kernels (8 sides at a time)
+*****************************************************************************/
+__attribute__ ((target ("avx512f")))
+static unsigned int count_crossings_avx512
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    __m512d px = _mm512_set1_pd(point_x);
+    __m512d py = _mm512_set1_pd(point_y);
+
+    for (point = first_point; point + 8 <= last_point; point += 8)
+    {
+        __m512d x0 = _mm512_loadu_pd(&vert_x[point]);
+        __m512d x1 = _mm512_loadu_pd(&vert_x[point + 1]);
+        __mmask8 straddle;      /* Sides with ends on each side of x */
+        __m512d cross_y;        /* Y of the crossing of each side */
+
+        straddle = _mm512_cmp_pd_mask(x0, px, _CMP_GT_OQ)
+            ^ _mm512_cmp_pd_mask(x1, px, _CMP_GT_OQ);
+        if (!straddle)
+            continue;
+
+        cross_y = _mm512_add_pd(_mm512_div_pd(_mm512_mul_pd(
+            _mm512_sub_pd(_mm512_loadu_pd(&vert_y[point + 1]),
+            _mm512_loadu_pd(&vert_y[point])), _mm512_sub_pd(px, x0)),
+            _mm512_sub_pd(x1, x0)), _mm512_loadu_pd(&vert_y[point]));
+        count += __builtin_popcount(_mm512_mask_cmp_pd_mask(straddle, py,
+            cross_y, _CMP_LT_OQ));
+    }
+
+    return count + count_crossings_scalar(vert_x, vert_y, point_x, point_y,
+        point, last_point);
+}
+
+__attribute__ ((target ("avx512f")))
+static unsigned int count_crossings_distance_avx512
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point,
+    double *min_distance
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    double lane_min;            /* Minimum distance over the lanes */
+    __m512d px = _mm512_set1_pd(point_x);
+    __m512d py = _mm512_set1_pd(point_y);
+    __m512d zero = _mm512_setzero_pd();
+    __m512d min_dist = _mm512_set1_pd(HUGE_VAL);
+
+    for (point = first_point; point + 8 <= last_point; point += 8)
+    {
+        __m512d x0 = _mm512_loadu_pd(&vert_x[point]);
+        __m512d x1 = _mm512_loadu_pd(&vert_x[point + 1]);
+        __m512d y0;             /* Y of the first vertex of each side */
+        __m512d distance;       /* Distance to the crossing of each side */
+        __mmask8 straddle;      /* Sides with ends on each side of x */
+        __mmask8 crossed;       /* Sides crossed ahead of the point */
+
+        straddle = _mm512_cmp_pd_mask(x0, px, _CMP_GT_OQ)
+            ^ _mm512_cmp_pd_mask(x1, px, _CMP_GT_OQ);
+        if (!straddle)
+            continue;
+
+        y0 = _mm512_loadu_pd(&vert_y[point]);
+        distance = _mm512_sub_pd(_mm512_add_pd(_mm512_div_pd(_mm512_mul_pd(
+            _mm512_sub_pd(_mm512_loadu_pd(&vert_y[point + 1]), y0),
+            _mm512_sub_pd(px, x0)), _mm512_sub_pd(x1, x0)), y0), py);
+        crossed = _mm512_mask_cmp_pd_mask(straddle, distance, zero,
+            _CMP_GT_OQ);
+        count += __builtin_popcount(crossed);
+        min_dist = _mm512_mask_min_pd(min_dist, crossed, min_dist, distance);
+    }
+
+    lane_min = _mm512_reduce_min_pd(min_dist);
+    if (lane_min < *min_distance)
+        *min_distance = lane_min;
+
+    return count + count_crossings_distance_scalar(vert_x, vert_y, point_x,
+        point_y, point, last_point, min_distance);
+}
+#endif
+
+#if defined(POLYGON_HAVE_NEON)
+/*****************************************************************************
+NEON kernels (2 sides at a time)
+*****************************************************************************/
+static unsigned int count_crossings_neon
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    float64x2_t px = vdupq_n_f64(point_x);
+    float64x2_t py = vdupq_n_f64(point_y);
+
+    for (point = first_point; point + 2 <= last_point; point += 2)
+    {
+        float64x2_t x0 = vld1q_f64(&vert_x[point]);
+        float64x2_t x1 = vld1q_f64(&vert_x[point + 1]);
+        float64x2_t y0 = vld1q_f64(&vert_y[point]);
+        float64x2_t y1 = vld1q_f64(&vert_y[point + 1]);
+        float64x2_t cross_y;    /* Y of the crossing of each side */
+        uint64x2_t crossed;     /* Sides crossed by the ray */
+
+        cross_y = vaddq_f64(vdivq_f64(vmulq_f64(vsubq_f64(y1, y0),
+            vsubq_f64(px, x0)), vsubq_f64(x1, x0)), y0);
+        crossed = vandq_u64(veorq_u64(vcgtq_f64(x0, px), vcgtq_f64(x1, px)),
+            vcltq_f64(py, cross_y));
+        count += (vgetq_lane_u64(crossed, 0) & 1)
+            + (vgetq_lane_u64(crossed, 1) & 1);
+    }
+
+    return count + count_crossings_scalar(vert_x, vert_y, point_x, point_y,
+        point, last_point);
+}
+
+static unsigned int count_crossings_distance_neon
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point,
+    double *min_distance
+)
+{
+    unsigned int point;         /* Point loop counter */
+    unsigned int count = 0;     /* Number of crossings */
+    double lane_min;            /* Minimum distance over the lanes */
+    float64x2_t px = vdupq_n_f64(point_x);
+    float64x2_t py = vdupq_n_f64(point_y);
+    float64x2_t zero = vdupq_n_f64(0.0);
+    float64x2_t no_crossing = vdupq_n_f64(HUGE_VAL);
+    float64x2_t min_dist = no_crossing;
+
+    for (point = first_point; point + 2 <= last_point; point += 2)
+    {
+        float64x2_t x0 = vld1q_f64(&vert_x[point]);
+        float64x2_t x1 = vld1q_f64(&vert_x[point + 1]);
+        float64x2_t y0 = vld1q_f64(&vert_y[point]);
+        float64x2_t y1 = vld1q_f64(&vert_y[point + 1]);
+        float64x2_t distance;   /* Distance to the crossing of each side */
+        uint64x2_t crossed;     /* Sides crossed ahead of the point */
+
+        distance = vsubq_f64(vaddq_f64(vdivq_f64(vmulq_f64(
+            vsubq_f64(y1, y0), vsubq_f64(px, x0)), vsubq_f64(x1, x0)), y0),
+            py);
+        crossed = vandq_u64(veorq_u64(vcgtq_f64(x0, px), vcgtq_f64(x1, px)),
+            vcgtq_f64(distance, zero));
+        count += (vgetq_lane_u64(crossed, 0) & 1)
+            + (vgetq_lane_u64(crossed, 1) & 1);
+        min_dist = vminq_f64(min_dist,
+            vbslq_f64(crossed, distance, no_crossing));
+    }
+
+    lane_min = vminvq_f64(min_dist);
+    if (lane_min < *min_distance)
+        *min_distance = lane_min;
+
+    return count + count_crossings_distance_scalar(vert_x, vert_y, point_x,
+        point_y, point, last_point, min_distance);
+}
+#endif
+
+/*****************************************************************************
+Dispatch to the kernels for the instruction set in use.
+*****************************************************************************/
+static unsigned int count_crossings
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point
+)
+{
+    switch (get_polygon_isa())
+    {
+#if defined(POLYGON_HAVE_X86)
+        case POLYGON_AVX512:
+            return count_crossings_avx512(vert_x, vert_y, point_x, point_y,
+                first_point, last_point);
+        case POLYGON_AVX2:
+            return count_crossings_avx2(vert_x, vert_y, point_x, point_y,
+                first_point, last_point);
+#elif defined(POLYGON_HAVE_NEON)
+        case POLYGON_NEON:
+            return count_crossings_neon(vert_x, vert_y, point_x, point_y,
+                first_point, last_point);
+#endif
+        default:
+            return count_crossings_scalar(vert_x, vert_y, point_x, point_y,
+                first_point, last_point);
+    }
+}
+
+static unsigned int count_crossings_distance
+(
+    const double *vert_x, const double *vert_y, double point_x,
+    double point_y, unsigned int first_point, unsigned int last_point,
+    double *min_distance
+)
+{
+    switch (get_polygon_isa())
+    {
+#if defined(POLYGON_HAVE_X86)
+        case POLYGON_AVX512:
+            return count_crossings_distance_avx512(vert_x, vert_y, point_x,
+                point_y, first_point, last_point, min_distance);
+        case POLYGON_AVX2:
+            return count_crossings_distance_avx2(vert_x, vert_y, point_x,
+                point_y, first_point, last_point, min_distance);
+#elif defined(POLYGON_HAVE_NEON)
+        case POLYGON_NEON:
+            return count_crossings_distance_neon(vert_x, vert_y, point_x,
+                point_y, first_point, last_point, min_distance);
+#endif
+        default:
+            return count_crossings_distance_scalar(vert_x, vert_y, point_x,
+                point_y, first_point, last_point, min_distance);
+    }
+}
+
 /*****************************************************************************
 NAME:  ias_math_point_in_closed_polygon
 
@@ -40,10 +490,8 @@ int ias_math_point_in_closed_polygon
     const IAS_POLYGON_SEGMENT *poly_seg /* I: Array of polygon segments */
 )
 {
-    unsigned int point;         /* Point loop counter */
     unsigned int segment;       /* Segment loop counter */
-    int intflag = 0;            /* Flag denoting even (0) or odd (1) 
-                                    number of polygon side intersections */
+    unsigned int count = 0;     /* Number of polygon side intersections */
 
     if (num_sides < 3) 
     {
@@ -61,39 +509,21 @@ int ias_math_point_in_closed_polygon
             {
                 continue;
             }
-            /* Loop through the points in this segment checking the
-               number of intersections */
-            for (point = poly_seg[segment].first_point; 
-                 point < poly_seg[segment].last_point; point++)
-            {
-                if (((vert_x[point] > point_x) != (vert_x[point + 1] > point_x))
-                    && (point_y < (vert_y[point + 1] - vert_y[point]) 
-                    * (point_x - vert_x[point]) / (vert_x[point + 1] 
-                    - vert_x[point]) + vert_y[point]))
-                {
-                    intflag = !intflag;
-                }
-            }
+            /* Count the intersections of the sides in this segment */
+            count += count_crossings(vert_x, vert_y, point_x, point_y,
+                poly_seg[segment].first_point, poly_seg[segment].last_point);
         }
     }
     else
     {
-        /* Loop through the points checking the number of intersections */
-        for (point = 0; point < num_sides; point++)
-        {
-            if (((vert_x[point] > point_x) != (vert_x[point + 1] > point_x))
-                && (point_y < (vert_y[point + 1] - vert_y[point]) * (point_x
-                - vert_x[point]) / (vert_x[point + 1] - vert_x[point])
-                + vert_y[point]))
-            {
-                intflag = !intflag;
-            }
-        }
+        /* Count the intersections of all the sides */
+        count = count_crossings(vert_x, vert_y, point_x, point_y, 0,
+            num_sides);
     }
 
     /* If the number of intersections is even, the point is outside the
        polygon.  If the number is odd, the point is inside the polygon. */
-    return intflag;
+    return count & 1;
 }
 
 /*****************************************************************************
@@ -136,15 +566,14 @@ int ias_math_point_in_closed_polygon_distance
 )
 {
     unsigned int segment;               /* Loop variable per segment */
-    unsigned int point;                 /* Loop variable per point */
-    double local_distance;              /* Distance */
+    unsigned int count = 0;             /* Number of polygon side
+                                           intersections */
+    double min_distance = HUGE_VAL;     /* Distance to the nearest
+                                           intersection */
     const double *local_vert_x = vert_x;/* Local vertex x */
     const double *local_vert_y = vert_y;/* Local vertex y */
     double local_x = point_x;           /* Local x coordinate */
     double local_y = point_y;           /* Local y coordinate */
-    int intflag = 0;                    /* Flag denoting even (0) or odd (1)
-                                           number of polygon side 
-                                           intersections */
 
     /* Initialize the distance to a negative number. */
     *distance = -1;
@@ -182,61 +611,23 @@ int ias_math_point_in_closed_polygon_distance
                 continue;
             }
 
-            for (point = poly_seg[segment].first_point; 
-                 point < poly_seg[segment].last_point; point++)
-            {
-                if ((local_vert_x[point] > local_x) == 
-                    (local_vert_x[point + 1] > local_x))
-                {
-                    continue;
-                }
-
-                local_distance = (local_vert_y[point + 1] - 
-                    local_vert_y[point]) * (local_x - 
-                    local_vert_x[point]) / (local_vert_x[point + 1] -
-                    local_vert_x[point]) + local_vert_y[point] - 
-                    local_y;
-
-                if (local_distance <= 0)
-                {
-                    continue;
-                }
-
-                intflag = !intflag;
-
-                if (*distance > local_distance || *distance < 0)
-                    *distance = local_distance;
-            }
+            /* Count the intersections of the sides in this segment */
+            count += count_crossings_distance(local_vert_x, local_vert_y,
+                local_x, local_y, poly_seg[segment].first_point,
+                poly_seg[segment].last_point, &min_distance);
         }
     }
     else
     {
-        for (point = 0; point < num_sides; point++)
-        {
-            if ((local_vert_x[point] > local_x) == 
-                (local_vert_x[point + 1] > local_x))
-            {
-                continue;
-            }
-        
-            local_distance = (local_vert_y[point + 1] - 
-                local_vert_y[point]) * (local_x - local_vert_x[point]) 
-                / (local_vert_x[point + 1] - local_vert_x[point]) + 
-                local_vert_y[point] - local_y;
-
-            if (local_distance <= 0)
-            {
-                continue;
-            }
-
-            intflag = !intflag;
-
-            if (*distance > local_distance || *distance < 0)
-                *distance = local_distance;
-        }
+        /* Count the intersections of all the sides */
+        count = count_crossings_distance(local_vert_x, local_vert_y, local_x,
+            local_y, 0, num_sides, &min_distance);
     }
 
+    if (count > 0)
+        *distance = min_distance;
+
     /* If the number of intersections is even, the point is outside the
        polygon.  If the number is odd, the point is inside the polygon. */
-    return intflag;
+    return count & 1;
 }
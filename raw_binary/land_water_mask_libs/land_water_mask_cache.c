@@ -0,0 +1,542 @@
+/*****************************************************************************
+FILE:  land_water_mask_cache
+
+PURPOSE: Stores generated land/water masks in a cache directory and reuses
+them for later scenes on the same grid.  Repeat acquisitions of a WRS path/row
+are usually on the same projection and pixel size, with corners that only
+differ by whole pixels, so their masks can be cut from an earlier one instead
+of being generated from the land-mass polygon again.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The cache is only used when the ESPA_LAND_WATER_MASK_CACHE environment
+     variable names the cache directory.  Nothing is ever removed from the
+     cache, so it is up to the user to clean it out.
+  2. The masks are kept in subdirectories named for the hash of the grid
+     key: the projection, the pixel size, and the digest of the land-mass
+     polygon file.  Each mask file holds the key and the corner of its grid,
+     and the mask bit-packed by line.
+  3. The polygon file digest is its size and modification time, and the hash
+     of its first and last DIGEST_SAMPLE_SIZE bytes, which is enough to tell
+     polygon file releases apart without reading the whole file.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "generate_land_water_mask.h"
+
+/* Local defines */
+#define CACHE_MAGIC "ESPALWM"       /* Identifies a mask cache file */
+#define CACHE_VERSION 1             /* Version of the cache layout, and of
+                                       the mask generation */
+#define CACHE_EXTENSION ".lwm"      /* Extension of the mask cache files */
+#define DIGEST_SAMPLE_SIZE 1048576  /* Bytes hashed at each end of the
+                                       polygon file */
+#define FNV_OFFSET_BASIS 14695981039346656037ULL /* 64-bit FNV-1a basis */
+#define FNV_PRIME 1099511628211ULL  /* 64-bit FNV-1a prime */
+#define ALIGN_TOLERANCE 1.0e-3      /* Largest fraction of a pixel the grids
+                                       can be off and still be aligned */
+
+/* Grid key of a cached mask.  Masks with the same key can be cut from each
+   other when their corners are a whole number of pixels apart. */
+typedef struct
+{
+    IAS_PROJECTION projection;      /* Projection of the mask */
+    double pixel_size[2];           /* Pixel size in x and y */
+    long long polygon_size;         /* Size of the land-mass polygon file */
+    long long polygon_mtime;        /* Modification time of the polygon file */
+    uint64_t polygon_hash;          /* Hash of the polygon file samples */
+} Lw_mask_cache_key_t;
+
+/* Header at the start of a mask cache file.  The mask lines follow, each
+   bit-packed into (nsamps + 7) / 8 bytes with the first sample in the high
+   bit. */
+typedef struct
+{
+    char magic[8];                  /* CACHE_MAGIC */
+    int version;                    /* CACHE_VERSION */
+    int nlines;                     /* Number of lines in the mask */
+    int nsamps;                     /* Number of samples in the mask */
+    int unused;                     /* Pads the header to 8 bytes */
+    double upper_left[2];           /* Upper left x/y of the mask extents */
+    Lw_mask_cache_key_t key;        /* Grid key of the mask */
+} Lw_mask_cache_header_t;
+
+
+/******************************************************************************
+MODULE:  hash_bytes
+
+PURPOSE: Adds a block of bytes to a 64-bit FNV-1a hash.
+
+RETURN VALUE:
+Type = uint64_t
+Value        Description
+-----        -----------
+hash         Updated hash
+
+NOTES:
+******************************************************************************/
+static uint64_t hash_bytes
+(
+    uint64_t hash,              /* I: hash so far */
+    const void *bytes,          /* I: bytes to add */
+    size_t count                /* I: number of bytes */
+)
+{
+    const unsigned char *byte = bytes;  /* current byte */
+    size_t i;                           /* looping variable */
+
+    for (i = 0; i < count; i++)
+    {
+        hash ^= byte[i];
+        hash *= FNV_PRIME;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  get_cache_key
+
+PURPOSE: Builds the grid key of the mask for the current scene.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error reading the land-mass polygon file
+SUCCESS      Successful completion
+
+NOTES:
+******************************************************************************/
+static int get_cache_key
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *image,           /* I: mask image grid */
+    const IAS_PROJECTION *projection, /* I: mask projection */
+    Lw_mask_cache_key_t *key          /* O: grid key */
+)
+{
+    unsigned char *sample = NULL;     /* polygon file sample */
+    size_t count;                     /* bytes read */
+    struct stat polygon_stat;         /* polygon file status */
+    FILE *fptr = NULL;                /* polygon file pointer */
+
+    /* Zero the whole key, padding included, so keys can be compared and
+       hashed as bytes */
+    memset (key, 0, sizeof (*key));
+    key->projection = *projection;
+    key->pixel_size[0] = image->pixel_size_x;
+    key->pixel_size[1] = image->pixel_size_y;
+
+    fptr = fopen (land_mass_polygon, "rb");
+    if (fptr == NULL || fstat (fileno (fptr), &polygon_stat) != 0)
+    {
+        if (fptr)
+            fclose (fptr);
+        return (ERROR);
+    }
+    key->polygon_size = polygon_stat.st_size;
+    key->polygon_mtime = polygon_stat.st_mtime;
+
+    sample = malloc (DIGEST_SAMPLE_SIZE);
+    if (sample == NULL)
+    {
+        fclose (fptr);
+        return (ERROR);
+    }
+
+    /* Hash the start and the end of the file */
+    key->polygon_hash = FNV_OFFSET_BASIS;
+    count = fread (sample, 1, DIGEST_SAMPLE_SIZE, fptr);
+    key->polygon_hash = hash_bytes (key->polygon_hash, sample, count);
+    if (polygon_stat.st_size > DIGEST_SAMPLE_SIZE)
+    {
+        if (fseeko (fptr, -DIGEST_SAMPLE_SIZE, SEEK_END) != 0)
+        {
+            free (sample);
+            fclose (fptr);
+            return (ERROR);
+        }
+        count = fread (sample, 1, DIGEST_SAMPLE_SIZE, fptr);
+        key->polygon_hash = hash_bytes (key->polygon_hash, sample, count);
+    }
+
+    free (sample);
+    if (ferror (fptr))
+    {
+        fclose (fptr);
+        return (ERROR);
+    }
+    fclose (fptr);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_cache_bucket
+
+PURPOSE: Builds the name of the cache subdirectory for a grid key.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Name is too long
+SUCCESS      Successful completion
+
+NOTES:
+******************************************************************************/
+static int get_cache_bucket
+(
+    const char *cache_dir,            /* I: cache directory */
+    const Lw_mask_cache_key_t *key,   /* I: grid key */
+    char *bucket                      /* O: cache subdirectory (PATH_MAX) */
+)
+{
+    int count;                        /* number of characters in the name */
+
+    count = snprintf (bucket, PATH_MAX, "%s/%016llx", cache_dir,
+        (unsigned long long) hash_bytes (FNV_OFFSET_BASIS, key,
+        sizeof (*key)));
+    if (count < 0 || count >= PATH_MAX)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_grid_offset
+
+PURPOSE: Finds where a requested mask grid sits within a cached mask grid.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The cached grid is aligned to the requested one to a whole
+             pixel and covers all of it
+false        The cached mask can't be used
+
+NOTES:
+******************************************************************************/
+static bool get_grid_offset
+(
+    const Lw_mask_cache_header_t *header, /* I: cached mask header */
+    const IAS_IMAGE *image,           /* I: requested mask image grid */
+    int *line_offset,                 /* O: cached line of the first line */
+    int *samp_offset                  /* O: cached sample of the first
+                                            sample */
+)
+{
+    double line;                      /* line offset in pixels */
+    double samp;                      /* sample offset in pixels */
+
+    samp = (image->corners.upleft.x - header->upper_left[0])
+        / image->pixel_size_x;
+    line = (header->upper_left[1] - image->corners.upleft.y)
+        / image->pixel_size_y;
+    if (fabs (samp - floor (samp + 0.5)) > ALIGN_TOLERANCE ||
+        fabs (line - floor (line + 0.5)) > ALIGN_TOLERANCE)
+        return (false);
+
+    *samp_offset = (int) floor (samp + 0.5);
+    *line_offset = (int) floor (line + 0.5);
+    if (*samp_offset < 0 || *line_offset < 0 ||
+        *samp_offset + image->ns > header->nsamps ||
+        *line_offset + image->nl > header->nlines)
+        return (false);
+
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  read_cached_mask
+
+PURPOSE: Reads the requested part of a cached mask into the land/water mask
+buffer.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The mask was read
+false        The cached mask could not be read
+
+NOTES:
+******************************************************************************/
+static bool read_cached_mask
+(
+    FILE *fptr,                       /* I: cached mask file, positioned
+                                            after the header */
+    const Lw_mask_cache_header_t *header, /* I: cached mask header */
+    const IAS_IMAGE *image,           /* I: requested mask image grid */
+    int line_offset,                  /* I: cached line of the first line */
+    int samp_offset,                  /* I: cached sample of the first
+                                            sample */
+    unsigned char *land_water_mask    /* O: land/water mask */
+)
+{
+    int line;                         /* looping variable */
+    size_t row_bytes = (header->nsamps + 7) / 8;  /* bytes per cached line */
+    unsigned char *row = NULL;        /* packed line of the cached mask */
+
+    row = malloc (row_bytes);
+    if (row == NULL)
+        return (false);
+
+    for (line = 0; line < image->nl; line++)
+    {
+        unsigned char *out = &land_water_mask[(size_t) line * image->ns];
+
+        if (fseeko (fptr, sizeof (*header) + (off_t) (line_offset + line)
+            * row_bytes, SEEK_SET) != 0 ||
+            fread (row, 1, row_bytes, fptr) != row_bytes)
+        {
+            free (row);
+            return (false);
+        }
+
+        ias_geo_expand_mask_bits (row, samp_offset, image->ns, 1, out);
+    }
+
+    free (row);
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  read_land_water_mask_cache
+
+PURPOSE: Fills the land/water mask for the current scene from a cached mask
+on the same grid, if there is one.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         The mask was filled from the cache
+false        The cache isn't enabled, or has no mask covering the scene
+
+NOTES:
+  1. A missing or unreadable cache isn't an error; the mask simply needs to
+     be generated.
+******************************************************************************/
+bool read_land_water_mask_cache
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *image,           /* I: mask image grid */
+    const IAS_PROJECTION *projection, /* I: mask projection */
+    unsigned char *land_water_mask    /* O: land/water mask, nl x ns */
+)
+{
+    char *cache_dir = getenv ("ESPA_LAND_WATER_MASK_CACHE");
+                                      /* cache directory */
+    char bucket[PATH_MAX];            /* cache subdirectory for the key */
+    char filename[PATH_MAX];          /* cached mask filename */
+    int line_offset;                  /* cached line of the first line */
+    int samp_offset;                  /* cached sample of the first sample */
+    bool found = false;               /* was the mask found? */
+    DIR *dir = NULL;                  /* cache subdirectory */
+    struct dirent *entry = NULL;      /* cache subdirectory entry */
+    Lw_mask_cache_key_t key;          /* grid key of the scene */
+
+    if (cache_dir == NULL || *cache_dir == '\0')
+        return (false);
+
+    if (get_cache_key (land_mass_polygon, image, projection, &key) != SUCCESS
+        || get_cache_bucket (cache_dir, &key, bucket) != SUCCESS)
+        return (false);
+
+    dir = opendir (bucket);
+    if (dir == NULL)
+        return (false);
+
+    /* Use the first cached mask that covers the scene */
+    while (!found && (entry = readdir (dir)) != NULL)
+    {
+        size_t len = strlen (entry->d_name);  /* length of the entry name */
+        Lw_mask_cache_header_t header;        /* cached mask header */
+        FILE *fptr = NULL;                    /* cached mask file */
+
+        if (len <= strlen (CACHE_EXTENSION) || strcmp (&entry->d_name[len -
+            strlen (CACHE_EXTENSION)], CACHE_EXTENSION))
+            continue;
+
+        if (snprintf (filename, PATH_MAX, "%s/%s", bucket, entry->d_name)
+            >= PATH_MAX)
+            continue;
+
+        fptr = fopen (filename, "rb");
+        if (fptr == NULL)
+            continue;
+
+        if (fread (&header, sizeof (header), 1, fptr) == 1 &&
+            !memcmp (header.magic, CACHE_MAGIC, sizeof (header.magic)) &&
+            header.version == CACHE_VERSION &&
+            !memcmp (&header.key, &key, sizeof (key)) &&
+            get_grid_offset (&header, image, &line_offset, &samp_offset))
+        {
+            found = read_cached_mask (fptr, &header, image, line_offset,
+                samp_offset, land_water_mask);
+        }
+
+        fclose (fptr);
+    }
+
+    closedir (dir);
+    return (found);
+}
+
+
+/******************************************************************************
+MODULE:  write_land_water_mask_cache
+
+PURPOSE: Stores the land/water mask for the current scene in the cache, so
+later scenes on the same grid can use it.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-----        -----------
+ERROR        Error writing the mask to the cache
+SUCCESS      The mask was stored, or the cache isn't enabled
+
+NOTES:
+  1. The mask is written to a temporary file that is renamed into place, so
+     concurrent runs never see a partial mask.
+******************************************************************************/
+int write_land_water_mask_cache
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const IAS_IMAGE *image,           /* I: mask image grid */
+    const IAS_PROJECTION *projection, /* I: mask projection */
+    const unsigned char *land_water_mask  /* I: land/water mask, nl x ns */
+)
+{
+    char FUNC_NAME[] = "write_land_water_mask_cache";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char *cache_dir = getenv ("ESPA_LAND_WATER_MASK_CACHE");
+                                      /* cache directory */
+    char bucket[PATH_MAX];            /* cache subdirectory for the key */
+    char filename[PATH_MAX];          /* cached mask filename */
+    char tmpfile[PATH_MAX];           /* temporary cached mask filename */
+    int line, samp;                   /* looping variables */
+    int count;                        /* number of characters in a name */
+    size_t row_bytes = (image->ns + 7) / 8;  /* bytes per packed line */
+    unsigned char *row = NULL;        /* packed line of the mask */
+    FILE *fptr = NULL;                /* cached mask file */
+    Lw_mask_cache_header_t header;    /* cached mask header */
+
+    if (cache_dir == NULL || *cache_dir == '\0')
+        return (SUCCESS);
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+    header.version = CACHE_VERSION;
+    header.nlines = image->nl;
+    header.nsamps = image->ns;
+    header.upper_left[0] = image->corners.upleft.x;
+    header.upper_left[1] = image->corners.upleft.y;
+    if (get_cache_key (land_mass_polygon, image, projection, &header.key)
+        != SUCCESS || get_cache_bucket (cache_dir, &header.key, bucket)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to build the cache key for the land/water "
+            "mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (mkdir (bucket, 0777) != 0 && errno != EEXIST)
+    {
+        sprintf (errmsg, "Unable to create the land/water mask cache "
+            "directory %s", bucket);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Name the mask for its whole header, so each grid is only stored once */
+    count = snprintf (filename, PATH_MAX, "%s/%016llx%s", bucket,
+        (unsigned long long) hash_bytes (FNV_OFFSET_BASIS, &header,
+        sizeof (header)), CACHE_EXTENSION);
+    if (count < 0 || count >= PATH_MAX ||
+        snprintf (tmpfile, PATH_MAX, "%s.%ld.tmp", filename, (long) getpid ())
+        >= PATH_MAX)
+    {
+        sprintf (errmsg, "Land/water mask cache filename is too long");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    row = malloc (row_bytes);
+    if (row == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the packed mask line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fptr = fopen (tmpfile, "wb");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Unable to open the land/water mask cache file %s",
+            tmpfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (row);
+        return (ERROR);
+    }
+
+    if (fwrite (&header, sizeof (header), 1, fptr) != 1)
+        line = -1;
+    else
+    {
+        for (line = 0; line < image->nl; line++)
+        {
+            const unsigned char *in = &land_water_mask[(size_t) line
+                * image->ns];
+
+            memset (row, 0, row_bytes);
+            for (samp = 0; samp < image->ns; samp++)
+            {
+                if (in[samp])
+                    row[samp >> 3] |= 0x80 >> (samp & 7);
+            }
+
+            if (fwrite (row, 1, row_bytes, fptr) != row_bytes)
+            {
+                line = -1;
+                break;
+            }
+        }
+    }
+    free (row);
+
+    if (fclose (fptr) != 0 || line < 0 || rename (tmpfile, filename) != 0)
+    {
+        sprintf (errmsg, "Unable to write the land/water mask cache file %s",
+            filename);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmpfile);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
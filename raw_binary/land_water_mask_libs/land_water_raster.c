@@ -0,0 +1,845 @@
+/*****************************************************************************
+FILE:  land_water_raster
+
+PURPOSE: Rasterizes the land-mass polygon into a global pyramid of tiled bit
+rasters, and makes land/water masks by looking up each mask pixel in it
+rather than testing it against the polygon.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The layout of a raster file is:
+         Lw_raster_header_t
+         the tiles of level 0, then its tile index
+         ...
+         the tiles of level nlevels-1, then its tile index
+     Level k has cells_per_degree / 2^k cells per degree, from 90 latitude
+     and -180 longitude, split into tiles of tile_size x tile_size cells.
+     The tile index of a level holds, for each tile in row order, either
+     LW_RASTER_WATER or LW_RASTER_LAND for a tile which is all water or all
+     land, or the file offset of the bits of the tile, a line at a time with
+     the first cell in the high bit (the same as the polygon bit masks).
+     The file is in the native byte order, and is memory mapped to be read.
+  2. A cell holds the polygon test of the point at its upper left corner, the
+     same as the cells of the bit masks of ias_geo_shape_mask_scanline, and a
+     location is looked up in the cell whose point is nearest to it.
+  3. The lat/long of the mask pixels is interpolated from a grid of points
+     every LW_RASTER_GRID pixels, which are the only ones projected.  The
+     projections of the scenes are smooth enough at that spacing that the
+     error is far below a raster cell.
+  4. The masks are used when the ESPA_LAND_WATER_RASTER environment variable
+     names a raster file.  The finest level is used for a grid only if its
+     cells are at most half the size of the mask pixels; the mask is
+     otherwise made from the polygon, which remains the exact method.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "generate_land_water_mask.h"
+#include "espa_task.h"
+
+/* Pixels between the projected grid points of a mask */
+#define LW_RASTER_GRID 16
+
+/* One level of an opened raster */
+typedef struct
+{
+    double cells_per_degree;        /* Cells per degree of the level */
+    long nrows;                     /* Number of cell rows, 180 degrees */
+    long ncols;                     /* Number of cell columns, 360 degrees */
+    long tiles_x;                   /* Number of tiles along a row */
+    const uint64_t *index;          /* Tile index of the level */
+} Lw_raster_level_t;
+
+/* Raster opened for reading */
+struct lw_raster
+{
+    char file_name[STR_SIZE];       /* Name of the raster file */
+    unsigned char *map;             /* Mapping of the whole file */
+    size_t map_size;                /* Size of the mapping */
+    int nlevels;                    /* Number of levels */
+    int tile_size;                  /* Cells along each side of a tile */
+    Lw_raster_level_t level[LW_RASTER_MAX_LEVELS];  /* Each level */
+};
+
+/* Row of tiles rasterized by rasterize_tile_range */
+typedef struct
+{
+    const char *land_mass_polygon;  /* Name of land mass polygon file */
+    double cells_per_degree;        /* Cells per degree of the level */
+    int tile_size;                  /* Cells along each side of a tile */
+    long tile_row;                  /* Row of the tiles */
+    uint64_t *codes;                /* Code of each tile of the row */
+    unsigned char **bits;           /* Bits of each mixed tile, or NULL */
+} Lw_raster_row_t;
+
+/* Mask lines looked up by lookup_mask_lines */
+typedef struct
+{
+    const Lw_raster_t *raster;      /* Raster to look up */
+    int level;                      /* Level used */
+    const IAS_IMAGE *image;         /* Image grid of the mask */
+    int nodes_x;                    /* Number of grid points along a row */
+    const double *node_lat;         /* Latitude of each grid point */
+    const double *node_lng;         /* Longitude of each grid point */
+    unsigned char *mask;            /* Land/water mask */
+} Lw_raster_lookup_t;
+
+/* Raster named by ESPA_LAND_WATER_RASTER, opened on first use */
+static Lw_raster_t *env_raster = NULL;
+static pthread_once_t env_raster_once = PTHREAD_ONCE_INIT;
+
+
+/******************************************************************************
+MODULE:  rasterize_tile_range
+
+PURPOSE: Rasterizes a range of the tiles of a row, as a chunk of
+espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error rasterizing a tile
+SUCCESS      Successful completion
+
+NOTES:
+******************************************************************************/
+static int rasterize_tile_range
+(
+    void *arg,                  /* I/O: row of tiles (Lw_raster_row_t) */
+    int first,                  /* I: first tile of the range */
+    int end,                    /* I: tile after the range */
+    int runner                  /* I: number of the thread (unused) */
+)
+{
+    Lw_raster_row_t *row = arg; /* row of tiles */
+    size_t nbytes = (size_t) row->tile_size * row->tile_size / 8;
+                                /* bytes of tile bits */
+    double span = row->tile_size / row->cells_per_degree;
+                                /* degrees covered by a tile */
+    double upper_left_lat = 90.0 - row->tile_row * span;
+                                /* latitude of the row */
+    double upper_left_long;     /* longitude of the tile */
+    unsigned char *bits = NULL; /* bits of the tile */
+    size_t i;                   /* looping variable for the bytes */
+    int tx;                     /* looping variable for the tiles */
+
+    for (tx = first; tx < end; tx++)
+    {
+        bits = malloc (nbytes + 1);
+        if (bits == NULL)
+            return (ERROR);
+
+        upper_left_long = -180.0 + tx * span;
+        if (ias_geo_shape_mask_scanline (row->land_mass_polygon,
+            row->tile_size, row->tile_size, upper_left_lat,
+            upper_left_lat - span, upper_left_long, upper_left_long + span,
+            bits) != SUCCESS)
+        {
+            free (bits);
+            return (ERROR);
+        }
+
+        /* Tiles of only water or only land are kept as their code */
+        for (i = 1; i < nbytes && bits[i] == bits[0]; i++)
+            ;
+        if (i == nbytes && (bits[0] == 0 || bits[0] == 0xff))
+        {
+            row->codes[tx] = bits[0] ? LW_RASTER_LAND : LW_RASTER_WATER;
+            free (bits);
+        }
+        else
+            row->bits[tx] = bits;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_land_water_raster
+
+PURPOSE: Rasterizes the land-mass polygon into a global land/water raster
+pyramid file.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error rasterizing the polygon or writing the file
+SUCCESS      Successful completion
+
+NOTES:
+1. Each level is rasterized from the polygon, so every level is as exact as
+   its cell size allows.  The tiles of a row are rasterized in parallel by
+   the task runtime (see espa_task.h).
+2. A packed polygon file (see convert_land_mass_polygon) is kept mapped
+   while the tiles are made; any other polygon file is read for each tile.
+******************************************************************************/
+int write_land_water_raster
+(
+    const char land_mass_polygon[],   /* I: name of land mass polygon file */
+    const char raster_file[],         /* I: name of the raster file */
+    int cells_per_degree,             /* I: cells per degree of the finest
+                                            level */
+    int nlevels,                      /* I: number of levels */
+    int tile_size                     /* I: cells along each side of a
+                                            tile; a multiple of 8 */
+)
+{
+    char FUNC_NAME[] = "write_land_water_raster";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int k;                            /* looping variable for the levels */
+    int status = SUCCESS;             /* return status */
+    long ty, tx;                      /* looping variables for the tiles */
+    long tiles_x, tiles_y;            /* number of tiles of the level */
+    long level_cpd;                   /* cells per degree of the level */
+    size_t nbytes;                    /* bytes of tile bits */
+    uint64_t *index = NULL;           /* tile index of the level */
+    FILE *fp = NULL;                  /* raster file */
+    Lw_raster_header_t header;        /* header of the raster file */
+    Lw_raster_row_t row;              /* row of tiles being rasterized */
+
+    if (nlevels < 1 || nlevels > LW_RASTER_MAX_LEVELS || tile_size < 8 ||
+        tile_size % 8 != 0 || cells_per_degree < 1 ||
+        cells_per_degree % (1 << (nlevels - 1)) != 0)
+    {
+        sprintf (errmsg, "Invalid raster layout: %d cells per degree, %d "
+            "levels, tiles of %d cells.  There can be 1 to %d levels, the "
+            "cells per degree must be divisible by 2^(levels-1), and the "
+            "tile size a multiple of 8.", cells_per_degree, nlevels,
+            tile_size, LW_RASTER_MAX_LEVELS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (ias_geo_is_packed_polygon_file (land_mass_polygon) &&
+        ias_geo_keep_packed_polygon_resident (land_mass_polygon) != SUCCESS)
+    {
+        sprintf (errmsg, "Mapping the packed polygon file %s",
+            land_mass_polygon);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp = fopen (raster_file, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the raster file %s", raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The header is written again once the levels are in place */
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, LW_RASTER_MAGIC, sizeof (header.magic));
+    header.version = LW_RASTER_VERSION;
+    header.nlevels = nlevels;
+    header.tile_size = tile_size;
+    header.cells_per_degree = cells_per_degree;
+    if (fwrite (&header, sizeof (header), 1, fp) != 1)
+        status = ERROR;
+
+    nbytes = (size_t) tile_size * tile_size / 8;
+    row.land_mass_polygon = land_mass_polygon;
+    row.tile_size = tile_size;
+    row.codes = NULL;
+    row.bits = NULL;
+    for (k = 0; k < nlevels && status == SUCCESS; k++)
+    {
+        level_cpd = cells_per_degree >> k;
+        tiles_x = (360 * level_cpd + tile_size - 1) / tile_size;
+        tiles_y = (180 * level_cpd + tile_size - 1) / tile_size;
+        printf ("Rasterizing level %d: %ld cells per degree, %ld x %ld "
+            "tiles\n", k, level_cpd, tiles_y, tiles_x);
+
+        index = malloc (tiles_x * tiles_y * sizeof (uint64_t));
+        row.codes = malloc (tiles_x * sizeof (uint64_t));
+        row.bits = calloc (tiles_x, sizeof (unsigned char *));
+        if (index == NULL || row.codes == NULL || row.bits == NULL)
+        {
+            sprintf (errmsg, "Allocating the tile index of level %d", k);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        row.cells_per_degree = level_cpd;
+
+        for (ty = 0; ty < tiles_y && status == SUCCESS; ty++)
+        {
+            row.tile_row = ty;
+            if (espa_parallel_for (0, tiles_x, 1, espa_task_nthreads (),
+                rasterize_tile_range, &row) != SUCCESS)
+            {
+                sprintf (errmsg, "Rasterizing tile row %ld of level %d", ty,
+                    k);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+
+            /* Write the mixed tiles in order and index them */
+            for (tx = 0; tx < tiles_x; tx++)
+            {
+                if (row.bits[tx] != NULL)
+                {
+                    index[ty * tiles_x + tx] = ftello (fp);
+                    if (status == SUCCESS &&
+                        fwrite (row.bits[tx], nbytes, 1, fp) != 1)
+                    {
+                        sprintf (errmsg, "Writing the raster file %s",
+                            raster_file);
+                        error_handler (true, FUNC_NAME, errmsg);
+                        status = ERROR;
+                    }
+                    free (row.bits[tx]);
+                    row.bits[tx] = NULL;
+                }
+                else
+                    index[ty * tiles_x + tx] = row.codes[tx];
+            }
+        }
+
+        header.level_offset[k] = ftello (fp);
+        if (status == SUCCESS && fwrite (index, sizeof (uint64_t),
+            tiles_x * tiles_y, fp) != (size_t) (tiles_x * tiles_y))
+        {
+            sprintf (errmsg, "Writing the tile index to %s", raster_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+
+        free (index);
+        free (row.codes);
+        free (row.bits);
+        index = NULL;
+        row.codes = NULL;
+        row.bits = NULL;
+    }
+    free (index);
+    free (row.codes);
+    free (row.bits);
+
+    if (status == SUCCESS &&
+        (fseeko (fp, 0, SEEK_SET) != 0 ||
+         fwrite (&header, sizeof (header), 1, fp) != 1))
+    {
+        sprintf (errmsg, "Writing the header of %s", raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    if (fclose (fp) != 0 && status == SUCCESS)
+    {
+        sprintf (errmsg, "Closing the raster file %s", raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  open_land_water_raster
+
+PURPOSE: Maps a land/water raster file, and validates its header and tile
+indexes.
+
+RETURN VALUE:
+Type = Lw_raster_t *
+Value        Description
+-----        -----------
+NULL         Error opening the file, or it isn't a valid raster file
+non-NULL     Pointer to the opened raster
+
+NOTES:
+******************************************************************************/
+Lw_raster_t *open_land_water_raster
+(
+    const char raster_file[]          /* I: name of the raster file */
+)
+{
+    char FUNC_NAME[] = "open_land_water_raster";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int fd;                           /* raster file descriptor */
+    int k;                            /* looping variable for the levels */
+    long cpd;                         /* cells per degree of a level */
+    long tiles_y;                     /* number of tile rows of a level */
+    long ntiles;                      /* number of tiles of a level */
+    long t;                           /* looping variable for the tiles */
+    size_t nbytes;                    /* bytes of tile bits */
+    struct stat statbuf;              /* raster file status */
+    const Lw_raster_header_t *header; /* header of the raster file */
+    Lw_raster_level_t *level;         /* level being validated */
+    Lw_raster_t *raster = NULL;       /* opened raster */
+
+    raster = calloc (1, sizeof (Lw_raster_t));
+    if (raster == NULL)
+    {
+        sprintf (errmsg, "Allocating the raster structure");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+    strncpy (raster->file_name, raster_file, sizeof (raster->file_name) - 1);
+
+    fd = open (raster_file, O_RDONLY);
+    if (fd == -1 || fstat (fd, &statbuf) == -1 ||
+        statbuf.st_size < (off_t) sizeof (Lw_raster_header_t))
+    {
+        sprintf (errmsg, "Opening the land/water raster %s", raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        if (fd != -1)
+            close (fd);
+        free (raster);
+        return (NULL);
+    }
+
+    raster->map_size = statbuf.st_size;
+    raster->map = mmap (NULL, raster->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (raster->map == MAP_FAILED)
+    {
+        sprintf (errmsg, "Mapping the land/water raster %s", raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (raster);
+        return (NULL);
+    }
+
+    /* Check the header, then each level and its tile index */
+    header = (const Lw_raster_header_t *) raster->map;
+    if (memcmp (header->magic, LW_RASTER_MAGIC, sizeof (header->magic)) ||
+        header->version != LW_RASTER_VERSION || header->nlevels < 1 ||
+        header->nlevels > LW_RASTER_MAX_LEVELS || header->tile_size < 8 ||
+        header->tile_size % 8 != 0 || header->cells_per_degree < 1 ||
+        header->cells_per_degree % (1u << (header->nlevels - 1)) != 0)
+    {
+        sprintf (errmsg, "%s isn't a valid land/water raster", raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_land_water_raster (raster);
+        return (NULL);
+    }
+    raster->nlevels = header->nlevels;
+    raster->tile_size = header->tile_size;
+    nbytes = (size_t) raster->tile_size * raster->tile_size / 8;
+
+    for (k = 0; k < raster->nlevels; k++)
+    {
+        level = &raster->level[k];
+        cpd = header->cells_per_degree >> k;
+        level->cells_per_degree = cpd;
+        level->nrows = 180 * cpd;
+        level->ncols = 360 * cpd;
+        level->tiles_x = (level->ncols + raster->tile_size - 1) /
+            raster->tile_size;
+        tiles_y = (level->nrows + raster->tile_size - 1) / raster->tile_size;
+        ntiles = level->tiles_x * tiles_y;
+
+        if (header->level_offset[k] < sizeof (Lw_raster_header_t) ||
+            header->level_offset[k] % sizeof (uint64_t) != 0 ||
+            header->level_offset[k] + ntiles * sizeof (uint64_t) >
+                raster->map_size)
+            break;
+        level->index = (const uint64_t *) (raster->map +
+            header->level_offset[k]);
+
+        for (t = 0; t < ntiles; t++)
+        {
+            if (level->index[t] > LW_RASTER_LAND &&
+                (level->index[t] < sizeof (Lw_raster_header_t) ||
+                 level->index[t] + nbytes > raster->map_size))
+                break;
+        }
+        if (t < ntiles)
+            break;
+    }
+    if (k < raster->nlevels)
+    {
+        sprintf (errmsg, "Tile index of level %d of %s is corrupt", k,
+            raster_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        close_land_water_raster (raster);
+        return (NULL);
+    }
+
+    return (raster);
+}
+
+
+/******************************************************************************
+MODULE:  close_land_water_raster
+
+PURPOSE: Unmaps a land/water raster and frees it.
+
+RETURN VALUE: None
+
+NOTES:
+******************************************************************************/
+void close_land_water_raster
+(
+    Lw_raster_t *raster               /* I: raster to be closed, or NULL */
+)
+{
+    if (raster == NULL)
+        return;
+
+    if (raster->map != NULL && raster->map != MAP_FAILED)
+        munmap (raster->map, raster->map_size);
+    free (raster);
+}
+
+
+/******************************************************************************
+MODULE:  open_env_raster
+
+PURPOSE: Opens the raster named by ESPA_LAND_WATER_RASTER, once per process.
+
+RETURN VALUE: None
+
+NOTES:
+1. If the raster can't be opened, a warning is written and the masks are
+   made from the polygon.
+******************************************************************************/
+static void open_env_raster ()
+{
+    char FUNC_NAME[] = "open_env_raster";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char *raster_file = getenv ("ESPA_LAND_WATER_RASTER");
+                                      /* raster file */
+
+    if (raster_file == NULL || raster_file[0] == '\0')
+        return;
+
+    env_raster = open_land_water_raster (raster_file);
+    if (env_raster == NULL)
+    {
+        sprintf (errmsg, "Unable to use the land/water raster %s; the masks "
+            "are made from the land-mass polygon", raster_file);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  get_land_water_raster
+
+PURPOSE: Returns the land/water raster requested via the
+ESPA_LAND_WATER_RASTER environment variable.
+
+RETURN VALUE:
+Type = Lw_raster_t *
+Value        Description
+-----        -----------
+NULL         No raster was requested, or it couldn't be opened
+non-NULL     The raster, kept open for the life of the process
+
+NOTES:
+******************************************************************************/
+Lw_raster_t *get_land_water_raster ()
+{
+    pthread_once (&env_raster_once, open_env_raster);
+
+    return (env_raster);
+}
+
+
+/******************************************************************************
+MODULE:  lookup_raster_cell
+
+PURPOSE: Looks up a location in a level of the raster.
+
+RETURN VALUE:
+Type = unsigned char
+Value                      Description
+-----                      -----------
+0                          Water
+IAS_GEO_SHAPE_MASK_VALID   Land
+
+NOTES:
+******************************************************************************/
+static unsigned char lookup_raster_cell
+(
+    const Lw_raster_t *raster,        /* I: raster */
+    const Lw_raster_level_t *level,   /* I: level of the raster */
+    double lat,                       /* I: latitude (degrees) */
+    double lng                        /* I: longitude (degrees), in any
+                                            turn */
+)
+{
+    long row;                         /* cell row */
+    long col;                         /* cell column */
+    long cell;                        /* cell within its tile */
+    uint64_t entry;                   /* tile index entry */
+
+    row = lround ((90.0 - lat) * level->cells_per_degree);
+    if (row < 0)
+        row = 0;
+    else if (row >= level->nrows)
+        row = level->nrows - 1;
+    col = lround ((lng + 180.0) * level->cells_per_degree) % level->ncols;
+    if (col < 0)
+        col += level->ncols;
+
+    entry = level->index[(row / raster->tile_size) * level->tiles_x +
+        col / raster->tile_size];
+    if (entry == LW_RASTER_WATER)
+        return (0);
+    if (entry == LW_RASTER_LAND)
+        return (IAS_GEO_SHAPE_MASK_VALID);
+
+    cell = (row % raster->tile_size) * raster->tile_size +
+        col % raster->tile_size;
+    return ((raster->map[entry + cell / 8] >> (7 - cell % 8)) & 1
+        ? IAS_GEO_SHAPE_MASK_VALID : 0);
+}
+
+
+/******************************************************************************
+MODULE:  lookup_mask_lines
+
+PURPOSE: Interpolates the lat/long of a range of mask lines from the grid
+points and looks them up in the raster, as a chunk of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+SUCCESS      Successful completion
+
+NOTES:
+1. The longitudes of the 4 grid points around the pixels are taken within
+   180 degrees of the first, so cells crossing 180 longitude interpolate
+   correctly.
+******************************************************************************/
+static int lookup_mask_lines
+(
+    void *arg,                  /* I/O: mask being made (Lw_raster_lookup_t) */
+    int first,                  /* I: first line of the range */
+    int end,                    /* I: line after the range */
+    int runner                  /* I: number of the thread (unused) */
+)
+{
+    Lw_raster_lookup_t *lookup = arg;   /* mask being made */
+    const Lw_raster_level_t *level =
+        &lookup->raster->level[lookup->level];  /* level used */
+    int ns = lookup->image->ns;         /* samples per line */
+    int line;                           /* looping variable for the lines */
+    int samp;                           /* looping variable for samples */
+    int node;                           /* upper left grid point */
+    int i;                              /* looping variable for points */
+    double wy, wx;                      /* weights of the lower and right
+                                           grid points */
+    double lat[4], lng[4];              /* lat/long of the grid points */
+    double top, bottom;                 /* interpolated along x */
+    double pixel_lat, pixel_lng;        /* lat/long of the pixel */
+
+    for (line = first; line < end; line++)
+    {
+        wy = (double) (line % LW_RASTER_GRID) / LW_RASTER_GRID;
+        for (samp = 0; samp < ns; samp++)
+        {
+            /* Pick up the grid points at the start of each grid cell */
+            if (samp % LW_RASTER_GRID == 0)
+            {
+                node = (line / LW_RASTER_GRID) * lookup->nodes_x +
+                    samp / LW_RASTER_GRID;
+                for (i = 0; i < 4; i++)
+                {
+                    int n = node + (i / 2) * lookup->nodes_x + i % 2;
+                                        /* grid point */
+                    lat[i] = lookup->node_lat[n];
+                    lng[i] = lookup->node_lng[n];
+                    if (lng[i] - lng[0] > 180.0)
+                        lng[i] -= 360.0;
+                    else if (lng[i] - lng[0] < -180.0)
+                        lng[i] += 360.0;
+                }
+            }
+
+            wx = (double) (samp % LW_RASTER_GRID) / LW_RASTER_GRID;
+            top = lat[0] + wx * (lat[1] - lat[0]);
+            bottom = lat[2] + wx * (lat[3] - lat[2]);
+            pixel_lat = top + wy * (bottom - top);
+            top = lng[0] + wx * (lng[1] - lng[0]);
+            bottom = lng[2] + wx * (lng[3] - lng[2]);
+            pixel_lng = top + wy * (bottom - top);
+
+            lookup->mask[(size_t) line * ns + samp] = lookup_raster_cell (
+                lookup->raster, level, pixel_lat, pixel_lng);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  raster_land_water_mask
+
+PURPOSE: Makes the land/water mask of an image grid by looking up its pixels
+in the land/water raster.
+
+RETURN VALUE:
+Type = int
+Value        Description
+-------      -----------
+ERROR        Error allocating memory or projecting the grid points
+SUCCESS      Successful completion; see used
+
+NOTES:
+1. The coarsest level whose cells are at most half the size of the pixels is
+   used.  If even the finest level is coarser than that, used is false and
+   the mask isn't changed, so it can be made from the polygon instead.
+2. The lines are looked up in parallel by the task runtime (see
+   espa_task.h).
+******************************************************************************/
+int raster_land_water_mask
+(
+    const Lw_raster_t *raster,        /* I: land/water raster */
+    const IAS_IMAGE *image,           /* I: image grid of the mask */
+    const IAS_PROJECTION *projection, /* I: projection of the mask */
+    unsigned char *land_water_mask,   /* O: land/water mask, nl x ns */
+    bool *used                        /* O: was the mask made from the
+                                            raster? */
+)
+{
+    char FUNC_NAME[] = "raster_land_water_mask";   /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int nodes_x, nodes_y;             /* number of grid points */
+    int i, j;                         /* looping variables for the points */
+    int k;                            /* looping variable for the levels */
+    int center;                       /* grid point at the image center */
+    int status = SUCCESS;             /* return status */
+    double *node_x = NULL;            /* X of a row of grid points */
+    double *node_y = NULL;            /* Y of a row of grid points */
+    double *node_lat = NULL;          /* latitude of each grid point */
+    double *node_lng = NULL;          /* longitude of each grid point */
+    double dlat, dlng;                /* lat/long between grid points */
+    double step_x, step_y;            /* degrees between grid points */
+    double pixel_degrees;             /* smaller side of a pixel, degrees */
+    double oparm[IAS_PROJ_PARAM_SIZE];  /* geographic projection parameters */
+    IAS_PROJECTION geographic_projection; /* geographic projection */
+    IAS_GEO_PROJ_TRANSFORMATION *geographic_transformation = NULL;
+                                      /* transformation to lat/long */
+    Lw_raster_lookup_t lookup;        /* mask being made */
+
+    *used = false;
+    nodes_x = (image->ns - 1) / LW_RASTER_GRID + 2;
+    nodes_y = (image->nl - 1) / LW_RASTER_GRID + 2;
+
+    node_x = malloc (nodes_x * sizeof (double));
+    node_y = malloc (nodes_x * sizeof (double));
+    node_lat = malloc ((size_t) nodes_x * nodes_y * sizeof (double));
+    node_lng = malloc ((size_t) nodes_x * nodes_y * sizeof (double));
+    if (node_x == NULL || node_y == NULL || node_lat == NULL ||
+        node_lng == NULL)
+    {
+        sprintf (errmsg, "Allocating the grid points of the mask");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    /* Project the grid points, placed like the pixels of
+       ias_geo_shape_mask_projection */
+    if (status == SUCCESS)
+    {
+        for (i = 0; i < IAS_PROJ_PARAM_SIZE; i++)
+            oparm[i] = 0.0;
+        ias_geo_set_projection (GEO, NULLZONE, DEGREE, WGS84_SPHEROID, oparm,
+            &geographic_projection);
+        geographic_transformation = ias_geo_get_proj_transformation (
+            projection, &geographic_projection);
+        if (geographic_transformation == NULL)
+        {
+            sprintf (errmsg, "Creating the projection transformation");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    for (j = 0; j < nodes_y && status == SUCCESS; j++)
+    {
+        for (i = 0; i < nodes_x; i++)
+        {
+            node_x[i] = image->corners.upleft.x +
+                (double) i * LW_RASTER_GRID * image->pixel_size_x;
+            node_y[i] = image->corners.upleft.y -
+                (double) j * LW_RASTER_GRID * image->pixel_size_y;
+        }
+        if (ias_geo_transform_coordinates (geographic_transformation,
+            nodes_x, node_x, node_y, &node_lng[j * nodes_x],
+            &node_lat[j * nodes_x]) != SUCCESS)
+        {
+            sprintf (errmsg, "Projecting the grid points of the mask");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+    if (geographic_transformation != NULL)
+        ias_geo_release_proj_transformation (geographic_transformation);
+
+    /* Pick the level from the pixel size at the image center */
+    if (status == SUCCESS)
+    {
+        center = ((nodes_y - 1) / 2) * nodes_x + (nodes_x - 1) / 2;
+        dlat = node_lat[center + 1] - node_lat[center];
+        dlng = fmod (fabs (node_lng[center + 1] - node_lng[center]), 360.0);
+        if (dlng > 180.0)
+            dlng = 360.0 - dlng;
+        step_x = hypot (dlat, dlng * cos (node_lat[center] * M_PI / 180.0));
+        dlat = node_lat[center + nodes_x] - node_lat[center];
+        dlng = fmod (fabs (node_lng[center + nodes_x] - node_lng[center]),
+            360.0);
+        if (dlng > 180.0)
+            dlng = 360.0 - dlng;
+        step_y = hypot (dlat, dlng * cos (node_lat[center] * M_PI / 180.0));
+        pixel_degrees = fmin (step_x, step_y) / LW_RASTER_GRID;
+
+        for (k = raster->nlevels - 1; k >= 0; k--)
+        {
+            if (1.0 / raster->level[k].cells_per_degree <=
+                pixel_degrees / 2.0)
+                break;
+        }
+
+        if (k < 0)
+        {
+            printf ("The land/water raster cells are too large for %g "
+                "degree pixels; using the land-mass polygon\n",
+                pixel_degrees);
+        }
+        else
+        {
+            printf ("Using level %d of the land/water raster\n", k);
+            lookup.raster = raster;
+            lookup.level = k;
+            lookup.image = image;
+            lookup.nodes_x = nodes_x;
+            lookup.node_lat = node_lat;
+            lookup.node_lng = node_lng;
+            lookup.mask = land_water_mask;
+            status = espa_parallel_for (0, image->nl, LW_RASTER_GRID,
+                espa_task_nthreads (), lookup_mask_lines, &lookup);
+            *used = (status == SUCCESS);
+        }
+    }
+
+    free (node_x);
+    free (node_y);
+    free (node_lat);
+    free (node_lng);
+
+    return (status);
+}
@@ -19,10 +19,170 @@ NOTES:
 #include <unistd.h>
 #include <math.h>
 #include "clip_band_misalignment.h"
+#include "raw_binary_pool.h"
 
+/* Kernels of the clipping for one data type of the bands; the kernel of the
+   scene is selected once, so the lines are processed without dispatching on
+   the data type */
+typedef struct
+{
+    enum Espa_data_type data_type;  /* data type of the bands */
+    int nbytes;                     /* number of bytes per pixel */
+    int (*build) (void *band_rows[], int nbands, long fill_value, int nsamps,
+        uint8_t *fill_mask);        /* builds the fill mask of a line */
+    void (*apply) (void *band_rows[], int nbands, long fill_value,
+        uint8_t *fill_mask, int nsamps);  /* sets the fill of a line */
+} Clip_kernel_t;
+
+/* Generates the kernels of a data type from the fill mask functions of the
+   type with the same size; the fill values are compared bit for bit, so the
+   signed and unsigned types of a size share the functions */
+#define CLIP_KERNEL(name, type, build_fn, apply_fn)                         \
+static int build_clip_mask_##name                                           \
+(                                                                           \
+    void *band_rows[], int nbands, long fill_value, int nsamps,             \
+    uint8_t *fill_mask                                                      \
+)                                                                           \
+{                                                                           \
+    return (build_fn ((type **) band_rows, nbands, (type) fill_value,       \
+        nsamps, fill_mask));                                                \
+}                                                                           \
+                                                                            \
+static void apply_clip_mask_##name                                          \
+(                                                                           \
+    void *band_rows[], int nbands, long fill_value, uint8_t *fill_mask,     \
+    int nsamps                                                              \
+)                                                                           \
+{                                                                           \
+    apply_fn ((type **) band_rows, nbands, (type) fill_value, fill_mask,    \
+        nsamps);                                                            \
+}
+
+CLIP_KERNEL (uint8, uint8_t, build_fill_mask_uint8, apply_fill_mask_uint8)
+CLIP_KERNEL (int16, int16_t, build_fill_mask_int16, apply_fill_mask_int16)
+
+/* Kernels of the supported data types of the bands */
+static const Clip_kernel_t clip_kernels[] =
+{
+    {ESPA_UINT8, sizeof (uint8_t), build_clip_mask_uint8,
+        apply_clip_mask_uint8},
+    {ESPA_INT16, sizeof (int16_t), build_clip_mask_int16,
+        apply_clip_mask_int16},
+    {ESPA_UINT16, sizeof (uint16_t), build_clip_mask_int16,
+        apply_clip_mask_int16}
+};
 
 /******************************************************************************
-MODULE:  clip_band_misalignment
+MODULE:  get_clip_kernel
+
+PURPOSE: Gets the clipping kernels for the data type of the bands.
+
+RETURN VALUE:
+Type = const Clip_kernel_t *
+Value           Description
+-----           -----------
+NULL            The data type isn't supported
+non-NULL        Kernels of the data type
+
+NOTES:
+******************************************************************************/
+static const Clip_kernel_t *get_clip_kernel
+(
+    enum Espa_data_type data_type   /* I: data type of the bands */
+)
+{
+    int i;            /* looping variable */
+
+    for (i = 0; i < sizeof (clip_kernels) / sizeof (clip_kernels[0]); i++)
+    {
+        if (clip_kernels[i].data_type == data_type)
+            return (&clip_kernels[i]);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  read_clip_block
+
+PURPOSE: Submits the reads of a block of lines from each of the raw binary
+bands and the band quality band, starting at the specified line.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error submitting the reads
+SUCCESS         Successfully submitted the reads
+
+NOTES:
+  1. The buffers must not be used until wait_raw_binary_async returns.
+******************************************************************************/
+static int read_clip_block
+(
+    Raw_binary_async_t *aio, /* I/O: asynchronous I/O queue */
+    FILE *fp_rb[],    /* I: pointers to the raw binary band files */
+    FILE *fp_bqa,     /* I: pointer to the band quality file */
+    int bnd_count,    /* I: number of raw binary bands */
+    int line,         /* I: starting line of the block */
+    int nblock_lines, /* I: number of lines in the block */
+    int nsamps,       /* I: number of samples in each line */
+    int size,         /* I: number of bytes per pixel of the bands */
+    uint8_t *file_buf[], /* O: buffers for the block of each band */
+    uint16_t *bqa_buf /* O: buffer for the block of the band quality band */
+)
+{
+    int i;            /* looping variable */
+
+    for (i = 0; i < bnd_count; i++)
+    {
+        if (submit_raw_binary_read (aio, fp_rb[i],
+            (long) line * nsamps * size,
+            (size_t) nblock_lines * nsamps * size, file_buf[i]) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (submit_raw_binary_read (aio, fp_bqa,
+        (long) line * nsamps * sizeof (uint16_t),
+        (size_t) nblock_lines * nsamps * sizeof (uint16_t), bqa_buf));
+}
+
+
+/******************************************************************************
+MODULE:  write_clip_block
+
+PURPOSE: Submits the write of a block of lines to the raw binary band,
+starting at the specified line.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error submitting the write
+SUCCESS         Successfully submitted the write
+
+NOTES:
+  1. The buffer must not be modified until wait_raw_binary_async returns.
+******************************************************************************/
+static int write_clip_block
+(
+    Raw_binary_async_t *aio, /* I/O: asynchronous I/O queue */
+    FILE *fp_rb,      /* I: pointer to the raw binary file */
+    int line,         /* I: starting line of the block */
+    int nblock_lines, /* I: number of lines in the block */
+    int nsamps,       /* I: number of samples in each line */
+    int size,         /* I: number of bytes per pixel */
+    void *buf         /* I: buffer for the block of lines */
+)
+{
+    return (submit_raw_binary_write (aio, fp_rb, (long) line * nsamps * size,
+        (size_t) nblock_lines * nsamps * size, buf));
+}
+
+
+/******************************************************************************
+MODULE:  clip_band_misalignment_meta
 
 PURPOSE: Clips bands 1-7 and the thermal band to clean up the band
   misalignment.  Any pixel that is fill in one band will be fill in all bands.
@@ -39,56 +199,74 @@ NOTES:
      all bands match.  The quality band will be updated to mark fill pixels due
      to the band clipping.
   2. This only applies to TM and ETM+ products, thus any other sensors will
-     simply be returned as-is.
+     simply be returned as-is.  The bands may be uint8, int16 or uint16, but
+     all of the same type and fill value (0 if it isn't defined); the
+     kernels of the type are selected once (see Clip_kernel_t).
   3. This is meant to be run on the Level-1 raw binary dataset.
+  4. The bands are processed CLIP_LINE_BLOCK lines at a time, and only the
+     lines which contain fill are written back to the band files.
+  5. The pixels which aren't fill in any band are written to the valid mask
+     of the scene (see raw_binary_valid.h), the product ID with
+     _valid_mask.bin appended, as each line is processed.  The valid_mask of
+     the global metadata is the only change to the metadata, so a caller
+     holding the parsed metadata for other processing doesn't need to
+     re-read the XML file, but needs to write it.
+  6. The reads and writes of all the bands are submitted together through
+     the asynchronous I/O queue, and the next block is read into a second set
+     of buffers while the current block is processed.
 ******************************************************************************/
-int clip_band_misalignment
+int clip_band_misalignment_meta
 (
-    char *espa_xml_file    /* I: input ESPA XML metadata filename */
+    Espa_internal_meta_t *xml_metadata  /* I/O: input ESPA XML metadata; the
+                                           valid mask of the scene is set */
 )
 {
-    char FUNC_NAME[] = "clip_band_misalignment";  /* function name */
+    char FUNC_NAME[] = "clip_band_misalignment_meta";  /* function name */
     char errmsg[STR_SIZE];    /* error message */
     char curr_band[STR_SIZE]; /* current band to process */
+    char valid_file[STR_SIZE];/* name of the valid mask of the scene */
+    int count;                /* number of chars copied in snprintf */
     int i;                    /* looping variable */
-    int l, s;                 /* line, sample looping variable */
+    int l;                    /* line looping variable */
+    int line;                 /* starting line of the current block */
+    int nblock_lines;         /* number of lines in the current block */
+    int next_lines;           /* number of lines in the next block */
+    int run_end;              /* line after the current run of fill lines */
+    size_t offset;            /* offset of the current line in the block */
+    int nfill;                /* number of fill pixels in the current line */
     int bnd_count;            /* count of bands to process */
     int bnd;                  /* current band to process */
     int nlines = -99;         /* number of lines in the bands */
     int nsamps = -99;         /* number of samples in the bands */
+    int nbytes;               /* number of bytes per pixel of the bands */
+    long fill_value = 0;      /* fill value of the bands */
+    const Clip_kernel_t *kernel = NULL;  /* kernels of the data type of the
+                                            bands */
     int band_options[NBAND_OPTIONS] = {1, 2, 3, 4, 5, 6, 61, 62, 7};
                               /* various bands that will be used for clipping */
-    bool fill;                /* is the current pixel fill */
-    uint8_t *tmp_file_buf = NULL; /* overall buffer for uint8 input band data */
-    uint8_t *file_buf[NBAND_OPTIONS]; /* buffer for uint8 input band data one
-                                         for each band */
-    uint16_t *bqa_buf = NULL; /* buffer for band quality data */
-    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
-                                 populated by reading the XML metadata file */
+    bool line_fill[CLIP_LINE_BLOCK]; /* does the line in the block contain
+                                        fill */
+    uint8_t *fill_mask = NULL;/* mask of fill pixels in the current line */
+    void *line_buf[NBAND_OPTIONS]; /* pointers to the current line in the
+                                      block for each band */
+    int cur;                  /* buffer set of the current block (0 or 1) */
+    uint8_t *tmp_file_buf = NULL; /* overall buffer for input band data */
+    uint8_t *file_buf[2][NBAND_OPTIONS]; /* buffers for input band data one
+                                         for each band, for the current and
+                                         the next block */
+    uint16_t *tmp_bqa_buf = NULL; /* overall buffer for band quality data */
+    uint16_t *bqa_buf[2];     /* buffers for band quality data, for the
+                                 current and the next block */
+    Raw_binary_async_t *aio = NULL; /* asynchronous I/O queue for the bands */
+    Raw_binary_valid_t *valid = NULL; /* valid mask of the scene */
     Espa_global_meta_t *gmeta;/* pointer to the global metadata structure */
     Espa_band_meta_t *bmeta;  /* pointer to the array of bands metadata */
     FILE *fp_rb[NBAND_OPTIONS];/* file pointer for the bands -- bands 1-7 and
                                   thermal */
     FILE *fp_bqa = NULL;      /* file pointer for the band quality band */
 
-    /* Validate the input metadata file */
-    if (validate_xml_file (espa_xml_file) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-
-    /* Initialize the metadata structure */
-    init_metadata_struct (&xml_metadata);
-
-    /* Parse the metadata file into our internal metadata structure; also
-       allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
-    {  /* Error messages already written */
-        return (ERROR);
-    }
-    gmeta = &xml_metadata.global;
-    bmeta = xml_metadata.band;
+    gmeta = &xml_metadata->global;
+    bmeta = xml_metadata->band;
 
     /* Only process TM and ETM+ bands */
     if (strcmp (gmeta->instrument, "TM") && strcmp (gmeta->instrument, "ETM"))
@@ -99,51 +277,67 @@ int clip_band_misalignment
         return (SUCCESS);
     }
 
-    /* Loop through the bands and open bands 1-7 and the thermal bands */
+    /* Look up and open bands 1-7 and the thermal bands */
     bnd_count = 0;
-    for (i = 0; i < xml_metadata.nbands; i++)
+    for (bnd = 0; bnd < NBAND_OPTIONS; bnd++)
     {
-        for (bnd = 0; bnd < NBAND_OPTIONS; bnd++)
+        /* Is the current expected band in the metadata */
+        sprintf (curr_band, "band%d", band_options[bnd]);
+        i = find_band_metadata (xml_metadata, NULL, curr_band, NULL);
+        if (i < 0)
+            continue;
+
+        /* Open the band file */
+        fp_rb[bnd_count] = open_raw_binary (bmeta[i].file_name, "r+");
+        if (fp_rb[bnd_count] == NULL)
         {
-            /* Is the current band in the metadata one of our expected bands */
-            sprintf (curr_band, "band%d", band_options[bnd]);
-            if (!strcmp (bmeta[i].name, curr_band))
-            {
-                /* Open the band file */
-                fp_rb[bnd_count] = open_raw_binary (bmeta[i].file_name, "r+");
-                if (fp_rb[bnd_count] == NULL)
-                {
-                    sprintf (errmsg, "Opening the raw binary file: %s",
-                        bmeta[i].file_name);
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+            sprintf (errmsg, "Opening the raw binary file: %s",
+                bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
 
-                /* If this is the first band then store the image size */
-                if (bnd == 0)
-                {
-                    nlines = bmeta[i].nlines;
-                    nsamps = bmeta[i].nsamps;
-                }
+        /* If this is the first band then store the image size */
+        if (bnd == 0)
+        {
+            nlines = bmeta[i].nlines;
+            nsamps = bmeta[i].nsamps;
+        }
 
-                /* Increment the band count and goto the next metadata band */
-                bnd_count++;
-                break;
-            }
+        /* The first band found sets the data type and fill value, which the
+           other bands need to match */
+        if (bnd_count == 0)
+        {
+            kernel = get_clip_kernel (bmeta[i].data_type);
+            if (bmeta[i].fill_value != ESPA_INT_META_FILL)
+                fill_value = bmeta[i].fill_value;
+        }
+        if (kernel == NULL || bmeta[i].data_type != kernel->data_type ||
+            (bmeta[i].fill_value != ESPA_INT_META_FILL &&
+             bmeta[i].fill_value != fill_value))
+        {
+            sprintf (errmsg, "Band %s must be uint8, int16 or uint16 data, "
+                "with the same data type and fill value as the other bands",
+                curr_band);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
 
-        /* Is this the quality band */
-        sprintf (curr_band, "qa");
-        if (!strcmp (bmeta[i].name, curr_band))
+        /* Increment the band count */
+        bnd_count++;
+    }
+
+    /* Open the quality band */
+    i = find_band_metadata (xml_metadata, NULL, "qa", NULL);
+    if (i >= 0)
+    {
+        fp_bqa = open_raw_binary (bmeta[i].file_name, "r+");
+        if (fp_bqa == NULL)
         {
-            fp_bqa = open_raw_binary (bmeta[i].file_name, "r+");
-            if (fp_bqa == NULL)
-            {
-                sprintf (errmsg, "Opening the quality band binary file: %s",
-                    bmeta[i].file_name);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+            sprintf (errmsg, "Opening the quality band binary file: %s",
+                bmeta[i].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
     }
 
@@ -180,152 +374,280 @@ int clip_band_misalignment
         return (ERROR);
     }
 
-    /* Allocate one line of data for each band */
-    tmp_file_buf = calloc (nsamps * bnd_count, sizeof (uint8_t));
+    /* Allocate two blocks of lines for each band, so the next block can be
+       read while the current one is processed */
+    nbytes = kernel->nbytes;
+    tmp_file_buf = get_raw_binary_buffer ((size_t) 2 * CLIP_LINE_BLOCK *
+        nsamps * bnd_count * nbytes, true);
     if (tmp_file_buf == NULL)
     {
-        sprintf (errmsg, "Allocating memory for %d bands of uint8 data "
-            "containing %d samples.", bnd_count, nsamps);
+        sprintf (errmsg, "Allocating memory for %d bands of %d-byte data "
+            "containing 2 x %d lines x %d samples.", bnd_count, nbytes,
+            CLIP_LINE_BLOCK, nsamps);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    /* Break the buffer into bands */
-    file_buf[0] = tmp_file_buf;
-    for (i = 1; i < bnd_count; i++)
-        file_buf[i] = file_buf[i-1] + nsamps;
+    /* Break the buffer into blocks and bands */
+    for (cur = 0; cur < 2; cur++)
+    {
+        file_buf[cur][0] = tmp_file_buf +
+            (size_t) cur * CLIP_LINE_BLOCK * nsamps * bnd_count * nbytes;
+        for (i = 1; i < bnd_count; i++)
+            file_buf[cur][i] = file_buf[cur][i-1] +
+                (size_t) CLIP_LINE_BLOCK * nsamps * nbytes;
+    }
 
-    /* Allocate one line of data for the band quality band */
-    bqa_buf = calloc (nsamps, sizeof (uint16_t));
-    if (bqa_buf == NULL)
+    /* Allocate two blocks of lines for the band quality band */
+    tmp_bqa_buf = get_raw_binary_buffer ((size_t) 2 * CLIP_LINE_BLOCK *
+        nsamps * sizeof (uint16_t), true);
+    if (tmp_bqa_buf == NULL)
     {
         sprintf (errmsg, "Allocating memory for band quality uint16 data "
-            "containing %d samples.", nsamps);
+            "containing 2 x %d lines x %d samples.", CLIP_LINE_BLOCK, nsamps);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    bqa_buf[0] = tmp_bqa_buf;
+    bqa_buf[1] = tmp_bqa_buf + (size_t) CLIP_LINE_BLOCK * nsamps;
 
-    /* Loop through the lines of data and process each file */
-    for (l = 0; l < nlines; l++)
+    /* Allocate the fill mask for a single line */
+    fill_mask = calloc (nsamps, sizeof (uint8_t));
+    if (fill_mask == NULL)
     {
-        /* Read the current line from each band */
-        for (i = 0; i < bnd_count; i++)
-        {
-            /* Seek to the correct position to read the current line */
-            if (fseek (fp_rb[i], l * nsamps * sizeof (uint8_t), SEEK_SET) == -1)
-            {   
-                sprintf (errmsg, "Not able to seek for line %d of raw binary "
-                    "file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+        sprintf (errmsg, "Allocating memory for the fill mask containing %d "
+            "samples.", nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            /* Read the line */
-            if (read_raw_binary (fp_rb[i], 1, nsamps, sizeof (uint8_t),
-                file_buf[i]) != SUCCESS)
-            {   
-                sprintf (errmsg, "Reading line %d of raw binary file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
-        }
+    /* Create the valid mask of the scene */
+    count = snprintf (valid_file, sizeof (valid_file), "%s_valid_mask.bin",
+        gmeta->product_id);
+    if (count < 0 || count >= sizeof (valid_file))
+    {
+        sprintf (errmsg, "Overflow of valid_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    valid = create_raw_binary_valid (valid_file, nlines, nsamps);
+    if (valid == NULL)
+    {
+        sprintf (errmsg, "Creating the valid mask of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Open the asynchronous I/O queue, with room for the reads of the next
+       block and the writes of the current block for every band */
+    aio = open_raw_binary_async (2 * (bnd_count + 1));
+    if (aio == NULL)
+    {
+        sprintf (errmsg, "Opening the asynchronous I/O queue for the bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Start reading the first block */
+    nblock_lines = (nlines < CLIP_LINE_BLOCK) ? nlines : CLIP_LINE_BLOCK;
+    if (nlines > 0 && read_clip_block (aio, fp_rb, fp_bqa, bnd_count, 0,
+        nblock_lines, nsamps, nbytes, file_buf[0], bqa_buf[0]) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading lines 0-%d of the raw binary files",
+            nblock_lines - 1);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Loop through the lines of data a block at a time and process each
+       file */
+    for (line = 0, cur = 0; line < nlines; line += CLIP_LINE_BLOCK, cur = !cur)
+    {
+        nblock_lines = CLIP_LINE_BLOCK;
+        if (line + nblock_lines > nlines)
+            nblock_lines = nlines - line;
 
-        /* Seek to the correct position to read the current line */
-        if (fseek (fp_bqa, l * nsamps * sizeof (uint16_t), SEEK_SET) == -1)
-        {   
-            sprintf (errmsg, "Not able to seek for line %d of band quality "
-                "file", l);
+        /* Wait for the reads of the current block and the writes of the
+           previous block */
+        if (wait_raw_binary_async (aio) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of the raw binary files or "
+                "writing the previous block", line, line + nblock_lines - 1);
             error_handler (true, FUNC_NAME, errmsg);
             return (ERROR);
         }
 
-        /* Read the current line from the band quality band */
-        if (read_raw_binary (fp_bqa, 1, nsamps, sizeof (uint16_t), bqa_buf) !=
-            SUCCESS)
-        {   
-            sprintf (errmsg, "Reading line %d of band quality file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+        /* Start reading the next block into the other buffers, which are
+           free since the writes of the previous block are done */
+        if (line + CLIP_LINE_BLOCK < nlines)
+        {
+            next_lines = CLIP_LINE_BLOCK;
+            if (line + CLIP_LINE_BLOCK + next_lines > nlines)
+                next_lines = nlines - line - CLIP_LINE_BLOCK;
+            if (read_clip_block (aio, fp_rb, fp_bqa, bnd_count,
+                line + CLIP_LINE_BLOCK, next_lines, nsamps, nbytes,
+                file_buf[!cur], bqa_buf[!cur]) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d of the raw binary files",
+                    line + CLIP_LINE_BLOCK,
+                    line + CLIP_LINE_BLOCK + next_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
         }
 
-        /* Loop through all the pixels and assess if any are fill */
-        for (s = 0; s < nsamps; s++)
+        /* Loop through the lines in the block and flag any pixels which are
+           fill in any band */
+        for (l = 0; l < nblock_lines; l++)
         {
-            /* Check the current pixel for each band to be fill */
-            fill = false;
+            offset = (size_t) l * nsamps;
             for (i = 0; i < bnd_count; i++)
+                line_buf[i] = &file_buf[cur][i][(size_t) offset * nbytes];
+
+            nfill = kernel->build (line_buf, bnd_count, fill_value, nsamps,
+                fill_mask);
+            line_fill[l] = (nfill > 0);
+            if (add_raw_binary_valid_line (valid, fill_mask) != SUCCESS)
             {
-                /* Check for fill in the current band */
-                if (file_buf[i][s] == 0)
-                {
-                    fill = true;
-                    break;
-                }
+                sprintf (errmsg, "Adding line %d to the valid mask",
+                    line + l);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
             }
+            if (!line_fill[l])
+                continue;
 
             /* If a fill pixel was found, then set all pixels to fill and set
-               the band quality to fill */
-            if (fill)
-            {
-                for (i = 0; i < bnd_count; i++)
-                    file_buf[i][s] = 0;
-                bqa_buf[s] = 1;  /* first bit set to 1 for fill */
-            }
+               the band quality to fill (first bit set to 1) */
+            kernel->apply (line_buf, bnd_count, fill_value, fill_mask,
+                nsamps);
+            apply_fill_mask_qa (&bqa_buf[cur][offset], 1, fill_mask, nsamps);
         }
 
-        /* Write the current line for each band */
-        for (i = 0; i < bnd_count; i++)
+        /* Write back only the lines which contain fill, writing each run of
+           consecutive fill lines with a single write per band */
+        for (l = 0; l < nblock_lines; l = run_end)
         {
-            /* Seek to the correct position to write the current line */
-            if (fseek (fp_rb[i], l * nsamps * sizeof (uint8_t), SEEK_SET) == -1)
-            {   
-                sprintf (errmsg, "Not able to seek for line %d of raw binary "
-                    "file %d", l, i);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
+            /* Find the next run of lines containing fill */
+            while (l < nblock_lines && !line_fill[l])
+                l++;
+            run_end = l;
+            while (run_end < nblock_lines && line_fill[run_end])
+                run_end++;
+            if (run_end == l)
+                break;
+
+            offset = (size_t) l * nsamps;
+            for (i = 0; i < bnd_count; i++)
+            {
+                if (write_clip_block (aio, fp_rb[i], line + l, run_end - l,
+                    nsamps, nbytes, &file_buf[cur][i][(size_t) offset *
+                    nbytes]) != SUCCESS)
+                {
+                    sprintf (errmsg, "Writing lines %d-%d of raw binary file "
+                        "%d", line + l, line + run_end - 1, i);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
             }
 
-            /* Write the current line back out to the file */
-            if (write_raw_binary (fp_rb[i], 1, nsamps, sizeof (uint8_t),
-                file_buf[i]) != SUCCESS)
-            {   
-                sprintf (errmsg, "Writing line %d of raw binary file %d", l, i);
+            if (write_clip_block (aio, fp_bqa, line + l, run_end - l, nsamps,
+                sizeof (uint16_t), &bqa_buf[cur][offset]) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing lines %d-%d of band quality file",
+                    line + l, line + run_end - 1);
                 error_handler (true, FUNC_NAME, errmsg);
                 return (ERROR);
             }
         }
+    }  /* for line in nlines */
 
-        /* Seek to the correct position to write the current line */
-        if (fseek (fp_bqa, l * nsamps * sizeof (uint16_t), SEEK_SET) == -1)
-        {   
-            sprintf (errmsg, "Not able to seek for line %d of band quality "
-                "file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Wait for the writes of the last block */
+    if (wait_raw_binary_async (aio) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the last block of the raw binary files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    close_raw_binary_async (aio);
 
-        /* Write the current line back out to the band quality file */
-        if (write_raw_binary (fp_bqa, 1, nsamps, sizeof (uint16_t), bqa_buf) !=
-            SUCCESS)
-        {   
-            sprintf (errmsg, "Writing line %d of band quality file", l);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
-    }  /* for l in nlines */
+    /* Finish the valid mask and reference it from the metadata */
+    if (finish_raw_binary_valid (valid) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the valid mask of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (gmeta->valid_mask, valid_file);
 
-    /* Free the raw binary band buffer and the band quality band buffer */
-    free (tmp_file_buf);
-    free (bqa_buf);
+    /* Free the raw binary band buffer, the band quality band buffer, and the
+       fill mask */
+    release_raw_binary_buffer (tmp_file_buf);
+    release_raw_binary_buffer (tmp_bqa_buf);
+    free (fill_mask);
 
     /* Close the data files */
     for (i = 0; i < bnd_count; i++)
         close_raw_binary (fp_rb[i]);
     close_raw_binary (fp_bqa);
 
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  clip_band_misalignment
+
+PURPOSE: Reads the XML metadata file and clips bands 1-7 and the thermal band
+  to clean up the band misalignment.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error clipping bands
+SUCCESS         Successfully clipped bands
+
+NOTES:
+  1. See clip_band_misalignment_meta for the details of the clipping.
+  2. The XML file is rewritten if the valid mask of the scene was written.
+******************************************************************************/
+int clip_band_misalignment
+(
+    char *espa_xml_file    /* I: input ESPA XML metadata filename */
+)
+{
+    int status;                         /* return status */
+    Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
+                                 populated by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Clip the bands, and add the valid mask to the XML file */
+    status = clip_band_misalignment_meta (&xml_metadata);
+    if (status == SUCCESS &&
+        strcmp (xml_metadata.global.valid_mask, ESPA_STRING_META_FILL))
+        status = write_metadata (&xml_metadata, espa_xml_file);
+
     /* Free the metadata structure */
     free_metadata (&xml_metadata);
 
-    /* Successful conversion */
-    return (SUCCESS);
+    return (status);
 }
@@ -21,12 +21,25 @@ NOTES:
 #include "error_handler.h"
 #include "espa_metadata.h"
 #include "parse_metadata.h"
+#include "write_metadata.h"
 #include "raw_binary_io.h"
+#include "raw_binary_async.h"
+#include "raw_binary_valid.h"
+#include "fill_mask.h"
 
 /* Defines */
 #define NBAND_OPTIONS 9
 
+/* Number of lines read from each band at a time */
+#define CLIP_LINE_BLOCK 256
+
 /* Prototypes */
+int clip_band_misalignment_meta
+(
+    Espa_internal_meta_t *xml_metadata  /* I/O: input ESPA XML metadata; the
+                                           valid mask of the scene is set */
+);
+
 int clip_band_misalignment
 (
     char *espa_xml_file    /* I: input ESPA XML metadata filename */
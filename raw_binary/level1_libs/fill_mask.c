@@ -0,0 +1,697 @@
+/*****************************************************************************
+FILE: fill_mask.c
+  
+PURPOSE: Contains functions for building a mask of pixels which are fill in
+any of a set of bands, and for applying that mask to the bands and the
+quality band.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each kernel has a scalar version along with SSE2 and AVX2 versions for
+     x86 and a NEON version for 64-bit ARM.  The instruction set is chosen at
+     runtime, the first time one of the kernels is called, based on what the
+     processor supports.
+  2. The ESPA_FILL_MASK_ISA environment variable can be set to "scalar" to
+     force the scalar kernels (used for verifying the vector kernels).
+*****************************************************************************/
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FILL_MASK_HAVE_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define FILL_MASK_HAVE_NEON
+#include <arm_neon.h>
+#endif
+#include "fill_mask.h"
+
+/* Instruction set used by the kernels; chosen on first use */
+static int fill_mask_isa = -1;
+
+
+/******************************************************************************
+MODULE:  get_fill_mask_isa
+
+PURPOSE: Determines the instruction set to be used for the fill mask kernels.
+
+RETURN VALUE:
+Type = Fill_mask_isa_t
+Value              Description
+-----              -----------
+FILL_MASK_SCALAR   Scalar kernels are used
+FILL_MASK_SSE2     SSE2 kernels are used
+FILL_MASK_AVX2     AVX2 kernels are used
+FILL_MASK_NEON     NEON kernels are used
+
+NOTES:
+  1. If this is first called from multiple threads at once, each thread
+     determines and stores the same value.
+******************************************************************************/
+Fill_mask_isa_t get_fill_mask_isa ()
+{
+    char *isa_env = NULL;     /* value of the ESPA_FILL_MASK_ISA variable */
+    int isa = FILL_MASK_SCALAR;  /* instruction set to be used */
+
+    if (fill_mask_isa != -1)
+        return ((Fill_mask_isa_t) fill_mask_isa);
+
+    isa_env = getenv ("ESPA_FILL_MASK_ISA");
+    if (isa_env == NULL || strcmp (isa_env, "scalar"))
+    {
+#if defined(FILL_MASK_HAVE_X86)
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("avx2"))
+            isa = FILL_MASK_AVX2;
+        else if (__builtin_cpu_supports ("sse2"))
+            isa = FILL_MASK_SSE2;
+#elif defined(FILL_MASK_HAVE_NEON)
+        isa = FILL_MASK_NEON;
+#endif
+    }
+
+    fill_mask_isa = isa;
+    return ((Fill_mask_isa_t) isa);
+}
+
+
+/******************************************************************************
+Scalar kernels.  These also handle the samples left over at the end of the
+row by the vector kernels.
+******************************************************************************/
+static int build_mask_uint8_scalar
+(
+    uint8_t *band_rows[], int nbands, uint8_t fill_value, int start,
+    int nsamps, uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    uint8_t fill;             /* is the current pixel fill in any band */
+
+    for (s = start; s < nsamps; s++)
+    {
+        fill = 0;
+        for (i = 0; i < nbands; i++)
+            fill |= (band_rows[i][s] == fill_value);
+        fill_mask[s] = fill ? FILL_MASK_FILL : FILL_MASK_CLEAR;
+        nfill += fill;
+    }
+
+    return (nfill);
+}
+
+static int build_mask_int16_scalar
+(
+    int16_t *band_rows[], int nbands, int16_t fill_value, int start,
+    int nsamps, uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    uint8_t fill;             /* is the current pixel fill in any band */
+
+    for (s = start; s < nsamps; s++)
+    {
+        fill = 0;
+        for (i = 0; i < nbands; i++)
+            fill |= (band_rows[i][s] == fill_value);
+        fill_mask[s] = fill ? FILL_MASK_FILL : FILL_MASK_CLEAR;
+        nfill += fill;
+    }
+
+    return (nfill);
+}
+
+static void apply_mask_uint8_scalar
+(
+    uint8_t *row, uint8_t fill_value, uint8_t *fill_mask, int start,
+    int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+
+    for (s = start; s < nsamps; s++)
+        row[s] = (row[s] & ~fill_mask[s]) | (fill_value & fill_mask[s]);
+}
+
+static void apply_mask_uint16_scalar
+(
+    uint16_t *row, uint16_t fill_value, uint8_t *fill_mask, int start,
+    int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    uint16_t mask;            /* 16-bit version of the fill mask */
+
+    for (s = start; s < nsamps; s++)
+    {
+        mask = (uint16_t) -(fill_mask[s] != FILL_MASK_CLEAR);
+        row[s] = (row[s] & ~mask) | (fill_value & mask);
+    }
+}
+
+
+#if defined(FILL_MASK_HAVE_X86)
+/******************************************************************************
+SSE2 kernels (16 bytes at a time)
+******************************************************************************/
+__attribute__ ((target ("sse2")))
+static int build_mask_uint8_sse2
+(
+    uint8_t *band_rows[], int nbands, uint8_t fill_value, int nsamps,
+    uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    __m128i fill = _mm_set1_epi8 ((char) fill_value);
+    __m128i acc;              /* fill mask for the current samples */
+
+    for (s = 0; s + 16 <= nsamps; s += 16)
+    {
+        acc = _mm_setzero_si128 ();
+        for (i = 0; i < nbands; i++)
+            acc = _mm_or_si128 (acc, _mm_cmpeq_epi8 (fill,
+                _mm_loadu_si128 ((__m128i *) &band_rows[i][s])));
+        _mm_storeu_si128 ((__m128i *) &fill_mask[s], acc);
+        nfill += __builtin_popcount (_mm_movemask_epi8 (acc));
+    }
+
+    return (nfill + build_mask_uint8_scalar (band_rows, nbands, fill_value,
+        s, nsamps, fill_mask));
+}
+
+__attribute__ ((target ("sse2")))
+static int build_mask_int16_sse2
+(
+    int16_t *band_rows[], int nbands, int16_t fill_value, int nsamps,
+    uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    __m128i fill = _mm_set1_epi16 (fill_value);
+    __m128i acc_lo, acc_hi;   /* fill mask for the current samples */
+    __m128i acc;              /* packed 8-bit fill mask */
+
+    for (s = 0; s + 16 <= nsamps; s += 16)
+    {
+        acc_lo = acc_hi = _mm_setzero_si128 ();
+        for (i = 0; i < nbands; i++)
+        {
+            acc_lo = _mm_or_si128 (acc_lo, _mm_cmpeq_epi16 (fill,
+                _mm_loadu_si128 ((__m128i *) &band_rows[i][s])));
+            acc_hi = _mm_or_si128 (acc_hi, _mm_cmpeq_epi16 (fill,
+                _mm_loadu_si128 ((__m128i *) &band_rows[i][s+8])));
+        }
+        acc = _mm_packs_epi16 (acc_lo, acc_hi);
+        _mm_storeu_si128 ((__m128i *) &fill_mask[s], acc);
+        nfill += __builtin_popcount (_mm_movemask_epi8 (acc));
+    }
+
+    return (nfill + build_mask_int16_scalar (band_rows, nbands, fill_value,
+        s, nsamps, fill_mask));
+}
+
+__attribute__ ((target ("sse2")))
+static void apply_mask_uint8_sse2
+(
+    uint8_t *row, uint8_t fill_value, uint8_t *fill_mask, int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    __m128i fill = _mm_set1_epi8 ((char) fill_value);
+    __m128i mask;             /* fill mask for the current samples */
+    __m128i data;             /* current samples */
+
+    for (s = 0; s + 16 <= nsamps; s += 16)
+    {
+        mask = _mm_loadu_si128 ((__m128i *) &fill_mask[s]);
+        data = _mm_loadu_si128 ((__m128i *) &row[s]);
+        data = _mm_or_si128 (_mm_andnot_si128 (mask, data),
+            _mm_and_si128 (mask, fill));
+        _mm_storeu_si128 ((__m128i *) &row[s], data);
+    }
+
+    apply_mask_uint8_scalar (row, fill_value, fill_mask, s, nsamps);
+}
+
+__attribute__ ((target ("sse2")))
+static void apply_mask_uint16_sse2
+(
+    uint16_t *row, uint16_t fill_value, uint8_t *fill_mask, int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    __m128i fill = _mm_set1_epi16 ((short) fill_value);
+    __m128i mask;             /* 8-bit fill mask for the current samples */
+    __m128i mask16;           /* 16-bit fill mask for the current samples */
+    __m128i data;             /* current samples */
+
+    for (s = 0; s + 8 <= nsamps; s += 8)
+    {
+        mask = _mm_loadl_epi64 ((__m128i *) &fill_mask[s]);
+        mask16 = _mm_unpacklo_epi8 (mask, mask);
+        data = _mm_loadu_si128 ((__m128i *) &row[s]);
+        data = _mm_or_si128 (_mm_andnot_si128 (mask16, data),
+            _mm_and_si128 (mask16, fill));
+        _mm_storeu_si128 ((__m128i *) &row[s], data);
+    }
+
+    apply_mask_uint16_scalar (row, fill_value, fill_mask, s, nsamps);
+}
+
+
+/******************************************************************************
+AVX2 kernels (32 bytes at a time)
+******************************************************************************/
+__attribute__ ((target ("avx2")))
+static int build_mask_uint8_avx2
+(
+    uint8_t *band_rows[], int nbands, uint8_t fill_value, int nsamps,
+    uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    __m256i fill = _mm256_set1_epi8 ((char) fill_value);
+    __m256i acc;              /* fill mask for the current samples */
+
+    for (s = 0; s + 32 <= nsamps; s += 32)
+    {
+        acc = _mm256_setzero_si256 ();
+        for (i = 0; i < nbands; i++)
+            acc = _mm256_or_si256 (acc, _mm256_cmpeq_epi8 (fill,
+                _mm256_loadu_si256 ((__m256i *) &band_rows[i][s])));
+        _mm256_storeu_si256 ((__m256i *) &fill_mask[s], acc);
+        nfill += __builtin_popcount ((unsigned int)
+            _mm256_movemask_epi8 (acc));
+    }
+
+    return (nfill + build_mask_uint8_scalar (band_rows, nbands, fill_value,
+        s, nsamps, fill_mask));
+}
+
+__attribute__ ((target ("avx2")))
+static int build_mask_int16_avx2
+(
+    int16_t *band_rows[], int nbands, int16_t fill_value, int nsamps,
+    uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    __m256i fill = _mm256_set1_epi16 (fill_value);
+    __m256i acc_lo, acc_hi;   /* fill mask for the current samples */
+    __m256i acc;              /* packed 8-bit fill mask */
+
+    for (s = 0; s + 32 <= nsamps; s += 32)
+    {
+        acc_lo = acc_hi = _mm256_setzero_si256 ();
+        for (i = 0; i < nbands; i++)
+        {
+            acc_lo = _mm256_or_si256 (acc_lo, _mm256_cmpeq_epi16 (fill,
+                _mm256_loadu_si256 ((__m256i *) &band_rows[i][s])));
+            acc_hi = _mm256_or_si256 (acc_hi, _mm256_cmpeq_epi16 (fill,
+                _mm256_loadu_si256 ((__m256i *) &band_rows[i][s+16])));
+        }
+
+        /* The pack works within each 128-bit lane, so put the 64-bit
+           quarters back in sample order */
+        acc = _mm256_permute4x64_epi64 (_mm256_packs_epi16 (acc_lo, acc_hi),
+            0xD8);
+        _mm256_storeu_si256 ((__m256i *) &fill_mask[s], acc);
+        nfill += __builtin_popcount ((unsigned int)
+            _mm256_movemask_epi8 (acc));
+    }
+
+    return (nfill + build_mask_int16_scalar (band_rows, nbands, fill_value,
+        s, nsamps, fill_mask));
+}
+
+__attribute__ ((target ("avx2")))
+static void apply_mask_uint8_avx2
+(
+    uint8_t *row, uint8_t fill_value, uint8_t *fill_mask, int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    __m256i fill = _mm256_set1_epi8 ((char) fill_value);
+    __m256i mask;             /* fill mask for the current samples */
+    __m256i data;             /* current samples */
+
+    for (s = 0; s + 32 <= nsamps; s += 32)
+    {
+        mask = _mm256_loadu_si256 ((__m256i *) &fill_mask[s]);
+        data = _mm256_loadu_si256 ((__m256i *) &row[s]);
+        data = _mm256_blendv_epi8 (data, fill, mask);
+        _mm256_storeu_si256 ((__m256i *) &row[s], data);
+    }
+
+    apply_mask_uint8_scalar (row, fill_value, fill_mask, s, nsamps);
+}
+
+__attribute__ ((target ("avx2")))
+static void apply_mask_uint16_avx2
+(
+    uint16_t *row, uint16_t fill_value, uint8_t *fill_mask, int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    __m256i fill = _mm256_set1_epi16 ((short) fill_value);
+    __m256i mask16;           /* 16-bit fill mask for the current samples */
+    __m256i data;             /* current samples */
+
+    for (s = 0; s + 16 <= nsamps; s += 16)
+    {
+        mask16 = _mm256_cvtepi8_epi16 (_mm_loadu_si128 (
+            (__m128i *) &fill_mask[s]));
+        data = _mm256_loadu_si256 ((__m256i *) &row[s]);
+        data = _mm256_blendv_epi8 (data, fill, mask16);
+        _mm256_storeu_si256 ((__m256i *) &row[s], data);
+    }
+
+    apply_mask_uint16_scalar (row, fill_value, fill_mask, s, nsamps);
+}
+#endif
+
+
+#if defined(FILL_MASK_HAVE_NEON)
+/******************************************************************************
+NEON kernels (16 bytes at a time)
+******************************************************************************/
+static int build_mask_uint8_neon
+(
+    uint8_t *band_rows[], int nbands, uint8_t fill_value, int nsamps,
+    uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    uint8x16_t fill = vdupq_n_u8 (fill_value);
+    uint8x16_t acc;           /* fill mask for the current samples */
+
+    for (s = 0; s + 16 <= nsamps; s += 16)
+    {
+        acc = vdupq_n_u8 (0);
+        for (i = 0; i < nbands; i++)
+            acc = vorrq_u8 (acc, vceqq_u8 (fill, vld1q_u8 (&band_rows[i][s])));
+        vst1q_u8 (&fill_mask[s], acc);
+        nfill += vaddlvq_u8 (vshrq_n_u8 (acc, 7));
+    }
+
+    return (nfill + build_mask_uint8_scalar (band_rows, nbands, fill_value,
+        s, nsamps, fill_mask));
+}
+
+static int build_mask_int16_neon
+(
+    int16_t *band_rows[], int nbands, int16_t fill_value, int nsamps,
+    uint8_t *fill_mask
+)
+{
+    int i, s;                 /* looping variables for bands and samples */
+    int nfill = 0;            /* number of fill pixels */
+    int16x8_t fill = vdupq_n_s16 (fill_value);
+    uint16x8_t acc;           /* fill mask for the current samples */
+    uint8x8_t acc8;           /* narrowed 8-bit fill mask */
+
+    for (s = 0; s + 8 <= nsamps; s += 8)
+    {
+        acc = vdupq_n_u16 (0);
+        for (i = 0; i < nbands; i++)
+            acc = vorrq_u16 (acc, vceqq_s16 (fill,
+                vld1q_s16 (&band_rows[i][s])));
+        acc8 = vmovn_u16 (acc);
+        vst1_u8 (&fill_mask[s], acc8);
+        nfill += vaddlv_u8 (vshr_n_u8 (acc8, 7));
+    }
+
+    return (nfill + build_mask_int16_scalar (band_rows, nbands, fill_value,
+        s, nsamps, fill_mask));
+}
+
+static void apply_mask_uint8_neon
+(
+    uint8_t *row, uint8_t fill_value, uint8_t *fill_mask, int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    uint8x16_t fill = vdupq_n_u8 (fill_value);
+
+    for (s = 0; s + 16 <= nsamps; s += 16)
+        vst1q_u8 (&row[s], vbslq_u8 (vld1q_u8 (&fill_mask[s]), fill,
+            vld1q_u8 (&row[s])));
+
+    apply_mask_uint8_scalar (row, fill_value, fill_mask, s, nsamps);
+}
+
+static void apply_mask_uint16_neon
+(
+    uint16_t *row, uint16_t fill_value, uint8_t *fill_mask, int nsamps
+)
+{
+    int s;                    /* looping variable for samples */
+    uint16x8_t fill = vdupq_n_u16 (fill_value);
+    uint16x8_t mask16;        /* 16-bit fill mask for the current samples */
+
+    for (s = 0; s + 8 <= nsamps; s += 8)
+    {
+        mask16 = vreinterpretq_u16_s16 (vmovl_s8 (vreinterpret_s8_u8 (
+            vld1_u8 (&fill_mask[s]))));
+        vst1q_u16 (&row[s], vbslq_u16 (mask16, fill, vld1q_u16 (&row[s])));
+    }
+
+    apply_mask_uint16_scalar (row, fill_value, fill_mask, s, nsamps);
+}
+#endif
+
+
+/******************************************************************************
+MODULE:  build_fill_mask_uint8
+
+PURPOSE: Builds the mask of pixels which are fill in any of the uint8 bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+nfill           Number of fill pixels in the row
+
+NOTES:
+******************************************************************************/
+int build_fill_mask_uint8
+(
+    uint8_t *band_rows[],  /* I: array of nbands rows of uint8 data */
+    int nbands,            /* I: number of bands in band_rows */
+    uint8_t fill_value,    /* I: fill value of the bands */
+    int nsamps,            /* I: number of samples in each row */
+    uint8_t *fill_mask     /* O: FILL_MASK_FILL if the pixel is fill in any
+                                 band, otherwise FILL_MASK_CLEAR */
+)
+{
+    switch (get_fill_mask_isa ())
+    {
+#if defined(FILL_MASK_HAVE_X86)
+        case FILL_MASK_AVX2:
+            return (build_mask_uint8_avx2 (band_rows, nbands, fill_value,
+                nsamps, fill_mask));
+        case FILL_MASK_SSE2:
+            return (build_mask_uint8_sse2 (band_rows, nbands, fill_value,
+                nsamps, fill_mask));
+#elif defined(FILL_MASK_HAVE_NEON)
+        case FILL_MASK_NEON:
+            return (build_mask_uint8_neon (band_rows, nbands, fill_value,
+                nsamps, fill_mask));
+#endif
+        default:
+            return (build_mask_uint8_scalar (band_rows, nbands, fill_value, 0,
+                nsamps, fill_mask));
+    }
+}
+
+
+/******************************************************************************
+MODULE:  build_fill_mask_int16
+
+PURPOSE: Builds the mask of pixels which are fill in any of the int16 bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+nfill           Number of fill pixels in the row
+
+NOTES:
+******************************************************************************/
+int build_fill_mask_int16
+(
+    int16_t *band_rows[],  /* I: array of nbands rows of int16 data */
+    int nbands,            /* I: number of bands in band_rows */
+    int16_t fill_value,    /* I: fill value of the bands */
+    int nsamps,            /* I: number of samples in each row */
+    uint8_t *fill_mask     /* O: FILL_MASK_FILL if the pixel is fill in any
+                                 band, otherwise FILL_MASK_CLEAR */
+)
+{
+    switch (get_fill_mask_isa ())
+    {
+#if defined(FILL_MASK_HAVE_X86)
+        case FILL_MASK_AVX2:
+            return (build_mask_int16_avx2 (band_rows, nbands, fill_value,
+                nsamps, fill_mask));
+        case FILL_MASK_SSE2:
+            return (build_mask_int16_sse2 (band_rows, nbands, fill_value,
+                nsamps, fill_mask));
+#elif defined(FILL_MASK_HAVE_NEON)
+        case FILL_MASK_NEON:
+            return (build_mask_int16_neon (band_rows, nbands, fill_value,
+                nsamps, fill_mask));
+#endif
+        default:
+            return (build_mask_int16_scalar (band_rows, nbands, fill_value, 0,
+                nsamps, fill_mask));
+    }
+}
+
+
+/******************************************************************************
+MODULE:  apply_fill_mask_uint8
+
+PURPOSE: Sets the fill pixels in each of the uint8 bands to the fill value.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void apply_fill_mask_uint8
+(
+    uint8_t *band_rows[],  /* I/O: array of nbands rows of uint8 data */
+    int nbands,            /* I: number of bands in band_rows */
+    uint8_t fill_value,    /* I: fill value to be set for fill pixels */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in each row */
+)
+{
+    int i;                    /* looping variable for bands */
+    Fill_mask_isa_t isa = get_fill_mask_isa ();  /* instruction set */
+
+    for (i = 0; i < nbands; i++)
+    {
+        switch (isa)
+        {
+#if defined(FILL_MASK_HAVE_X86)
+            case FILL_MASK_AVX2:
+                apply_mask_uint8_avx2 (band_rows[i], fill_value, fill_mask,
+                    nsamps);
+                break;
+            case FILL_MASK_SSE2:
+                apply_mask_uint8_sse2 (band_rows[i], fill_value, fill_mask,
+                    nsamps);
+                break;
+#elif defined(FILL_MASK_HAVE_NEON)
+            case FILL_MASK_NEON:
+                apply_mask_uint8_neon (band_rows[i], fill_value, fill_mask,
+                    nsamps);
+                break;
+#endif
+            default:
+                apply_mask_uint8_scalar (band_rows[i], fill_value, fill_mask,
+                    0, nsamps);
+                break;
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  apply_fill_mask_uint16
+
+PURPOSE: Sets the fill pixels in a 16-bit row to the fill value.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void apply_fill_mask_uint16
+(
+    uint16_t *row,         /* I/O: row of 16-bit data */
+    uint16_t fill_value,   /* I: fill value to be set for fill pixels */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in the row */
+)
+{
+    switch (get_fill_mask_isa ())
+    {
+#if defined(FILL_MASK_HAVE_X86)
+        case FILL_MASK_AVX2:
+            apply_mask_uint16_avx2 (row, fill_value, fill_mask, nsamps);
+            break;
+        case FILL_MASK_SSE2:
+            apply_mask_uint16_sse2 (row, fill_value, fill_mask, nsamps);
+            break;
+#elif defined(FILL_MASK_HAVE_NEON)
+        case FILL_MASK_NEON:
+            apply_mask_uint16_neon (row, fill_value, fill_mask, nsamps);
+            break;
+#endif
+        default:
+            apply_mask_uint16_scalar (row, fill_value, fill_mask, 0, nsamps);
+            break;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  apply_fill_mask_int16
+
+PURPOSE: Sets the fill pixels in each of the int16 bands to the fill value.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void apply_fill_mask_int16
+(
+    int16_t *band_rows[],  /* I/O: array of nbands rows of int16 data */
+    int nbands,            /* I: number of bands in band_rows */
+    int16_t fill_value,    /* I: fill value to be set for fill pixels */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in each row */
+)
+{
+    int i;                    /* looping variable for bands */
+
+    for (i = 0; i < nbands; i++)
+        apply_fill_mask_uint16 ((uint16_t *) band_rows[i],
+            (uint16_t) fill_value, fill_mask, nsamps);
+}
+
+
+/******************************************************************************
+MODULE:  apply_fill_mask_qa
+
+PURPOSE: Sets the fill pixels in the uint16 QA row to the QA fill value.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void apply_fill_mask_qa
+(
+    uint16_t *qa_row,      /* I/O: row of uint16 QA data */
+    uint16_t qa_fill,      /* I: QA value to be set for fill pixels (bit 0
+                                 set for the Landsat band quality band) */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in the row */
+)
+{
+    apply_fill_mask_uint16 (qa_row, qa_fill, fill_mask, nsamps);
+}
@@ -0,0 +1,87 @@
+/*****************************************************************************
+FILE: fill_mask.h
+  
+PURPOSE: Contains defines and prototypes for building and applying a fill
+mask across multiple bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef FILL_MASK_H
+#define FILL_MASK_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "error_handler.h"
+
+/* Defines */
+/* Values of the fill mask for fill and non-fill pixels */
+#define FILL_MASK_FILL 0xFF
+#define FILL_MASK_CLEAR 0x00
+
+/* Instruction sets available for the fill mask kernels */
+typedef enum {
+    FILL_MASK_SCALAR,
+    FILL_MASK_SSE2,
+    FILL_MASK_AVX2,
+    FILL_MASK_NEON
+} Fill_mask_isa_t;
+
+/* Prototypes */
+Fill_mask_isa_t get_fill_mask_isa ();
+
+int build_fill_mask_uint8
+(
+    uint8_t *band_rows[],  /* I: array of nbands rows of uint8 data */
+    int nbands,            /* I: number of bands in band_rows */
+    uint8_t fill_value,    /* I: fill value of the bands */
+    int nsamps,            /* I: number of samples in each row */
+    uint8_t *fill_mask     /* O: FILL_MASK_FILL if the pixel is fill in any
+                                 band, otherwise FILL_MASK_CLEAR */
+);
+
+int build_fill_mask_int16
+(
+    int16_t *band_rows[],  /* I: array of nbands rows of int16 data */
+    int nbands,            /* I: number of bands in band_rows */
+    int16_t fill_value,    /* I: fill value of the bands */
+    int nsamps,            /* I: number of samples in each row */
+    uint8_t *fill_mask     /* O: FILL_MASK_FILL if the pixel is fill in any
+                                 band, otherwise FILL_MASK_CLEAR */
+);
+
+void apply_fill_mask_uint8
+(
+    uint8_t *band_rows[],  /* I/O: array of nbands rows of uint8 data */
+    int nbands,            /* I: number of bands in band_rows */
+    uint8_t fill_value,    /* I: fill value to be set for fill pixels */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in each row */
+);
+
+void apply_fill_mask_int16
+(
+    int16_t *band_rows[],  /* I/O: array of nbands rows of int16 data */
+    int nbands,            /* I: number of bands in band_rows */
+    int16_t fill_value,    /* I: fill value to be set for fill pixels */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in each row */
+);
+
+void apply_fill_mask_qa
+(
+    uint16_t *qa_row,      /* I/O: row of uint16 QA data */
+    uint16_t qa_fill,      /* I: QA value to be set for fill pixels (bit 0
+                                 set for the Landsat band quality band) */
+    uint8_t *fill_mask,    /* I: fill mask for the row */
+    int nsamps             /* I: number of samples in the row */
+);
+
+#endif
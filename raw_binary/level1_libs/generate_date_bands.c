@@ -16,6 +16,12 @@ NOTES:
 *****************************************************************************/
 #include <unistd.h>
 #include "generate_date_bands.h"
+#include "espa_memory.h"
+#include "espa_tune.h"
+#include "raw_binary_pool.h"
+#include "raw_binary_constant.h"
+#include "raw_binary_valid.h"
+#include "derived_cache.h"
 
 /******************************************************************************
 MODULE:  generate_doy
@@ -63,59 +69,47 @@ int generate_doy
 
 
 /******************************************************************************
-MODULE:  generate_date_bands
+MODULE:  get_scene_date
 
-PURPOSE: Creates the date bands for the current scene.  These include a
-DOY-year band, DOY band, and a year band.
+PURPOSE: Determines the year and DOY of the scene from the acquisition date,
+and finds the representative band (band 1) in the XML file.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           Error creating the date bands
-SUCCESS         Successfully created the date bands
+ERROR           Error determining the date or finding band 1
+SUCCESS         Successfully determined the date
 
 NOTES:
-  1. The combined date-year band will be an unsigned 32-bit integer in the form
-     of YYYYDOY (example 2015232 for Aug. 20, 2015).
-  2. The individual date and year bands will be unsigned 16-bit integers.
-  3. The number of lines and samples is pulled from band1 (LPGS level 1 product)     in the XML file.
 ******************************************************************************/
-int generate_date_bands
+static int get_scene_date
 (
     Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
-    unsigned int **jdate_band,       /* O: pointer to date buffer with
-                                           year*1000 + DOY */
-    unsigned short **doy_band,       /* O: pointer to DOY buffer */
-    unsigned short **year_band,      /* O: pointer to year buffer */
-    int *nlines,                     /* O: number of lines in date bands */
-    int *nsamps                      /* O: number of samples in date bands */
+    int *year,                       /* O: year of the acquisition date */
+    int *doy,                        /* O: DOY of the acquisition date */
+    int *refl_indx                   /* O: band index in XML file for the
+                                           representative band (band 1) */
 )
 {
-    char FUNC_NAME[] = "generate_date_bands";  /* function name */
+    char FUNC_NAME[] = "get_scene_date";  /* function name */
     char errmsg[STR_SIZE];      /* error message */
     char year_str[5];           /* string for the year */
     char month_str[3];          /* string for the month */
     char day_str[3];            /* string for the day */
-    int i;                      /* looping variable */
-    int year, month, day;       /* year, month, and day from the acquisition
-                                   date */
-    int doy;                    /* day of year */
-    int refl_indx = -9;         /* band index in XML file for the
-                                   representative reflectance band */
+    int month, day;             /* month and day from the acquisition date */
     Espa_global_meta_t *gmeta = &xml_meta->global;
                                       /* pointer to global metadata structure */
-    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
 
     /* Pull the year, month, and day from the acquisition date in the XML
        metadata (Example YYYY-MM-DD) */
     strncpy (year_str, gmeta->acquisition_date, 4);
     year_str[4] = '\0';
-    year = atoi (year_str);
-    if (year < 1970 || year > 9999)
+    *year = atoi (year_str);
+    if (*year < 1970 || *year > 9999)
     {
         sprintf (errmsg, "Invalid year value from the acquisition date: %d. "
-            "Should be between 1970 and 9999.\n", year);
+            "Should be between 1970 and 9999.\n", *year);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -143,39 +137,90 @@ int generate_date_bands
     }
      
     /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_meta->nbands; i++)
-    {
-        if (!strcmp (xml_meta->band[i].name, "band1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
+    *refl_indx = find_band_metadata (xml_meta, NULL, "band1", NULL);
 
     /* Determine the day of year */
-    doy = generate_doy (year, month, day);
-    if (doy < 1 || doy > 366)
+    *doy = generate_doy (*year, month, day);
+    if (*doy < 1 || *doy > 366)
     {
         sprintf (errmsg, "Invalid DOY value from the acquisition date: %d. "
-            "Should be between 1 and 366.\n", doy);
+            "Should be between 1 and 366.\n", *doy);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
      
     /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
+    if (*refl_indx < 0)
     {
         sprintf (errmsg, "Band 1 (band1) was not found in the XML file");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+
+    printf ("INFO: acquisition_date is %s\n", gmeta->acquisition_date);
+    printf ("INFO: year-month-day is %d-%d-%d\n", *year, month, day);
+    printf ("INFO: DOY is %d\n", *doy);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  generate_date_bands
+
+PURPOSE: Creates the date bands for the current scene.  These include a
+DOY-year band, DOY band, and a year band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the date bands
+SUCCESS         Successfully created the date bands
+
+NOTES:
+  1. The combined date-year band will be an unsigned 32-bit integer in the form
+     of YYYYDOY (example 2015232 for Aug. 20, 2015).
+  2. The individual date and year bands will be unsigned 16-bit integers.
+  3. The number of lines and samples is pulled from band1 (LPGS level 1 product)     in the XML file.
+  4. The bands are held in memory for the full scene.  write_date_bands writes
+     the same bands directly to the output files a block at a time.
+******************************************************************************/
+int generate_date_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    unsigned int **jdate_band,       /* O: pointer to date buffer with
+                                           year*1000 + DOY */
+    unsigned short **doy_band,       /* O: pointer to DOY buffer */
+    unsigned short **year_band,      /* O: pointer to year buffer */
+    int *nlines,                     /* O: number of lines in date bands */
+    int *nsamps                      /* O: number of samples in date bands */
+)
+{
+    char FUNC_NAME[] = "generate_date_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    size_t i;                   /* looping variable */
+    size_t npix;                /* number of pixels in the date bands */
+    int year;                   /* year from the acquisition date */
+    int doy;                    /* day of year */
+    int refl_indx;              /* band index in XML file for the
+                                   representative reflectance band */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+
+    /* Determine the date of the scene and the representative band */
+    if (get_scene_date (xml_meta, &year, &doy, &refl_indx) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the date of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
     bmeta = &xml_meta->band[refl_indx];
     *nlines = bmeta->nlines;
     *nsamps = bmeta->nsamps;
+    npix = (size_t) *nlines * *nsamps;
 
     /* Allocate memory for the date, DOY, and year bands */
-    *jdate_band = calloc (*nlines * *nsamps, sizeof (unsigned int));
+    *jdate_band = calloc (npix, sizeof (unsigned int));
     if (*jdate_band == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the date/year band");
@@ -183,7 +228,7 @@ int generate_date_bands
         return (ERROR);
     }
 
-    *doy_band = calloc (*nlines * *nsamps, sizeof (unsigned short));
+    *doy_band = calloc (npix, sizeof (unsigned short));
     if (*doy_band == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the DOY band");
@@ -191,8 +236,7 @@ int generate_date_bands
         return (ERROR);
     }
 
-    *year_band = calloc (*nlines * *nsamps,
-        sizeof (unsigned short));
+    *year_band = calloc (npix, sizeof (unsigned short));
     if (*year_band == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the year band");
@@ -200,13 +244,9 @@ int generate_date_bands
         return (ERROR);
     }
 
-    printf ("INFO: acquisition_date is %s\n", gmeta->acquisition_date);
-    printf ("INFO: year-month-day is %d-%d-%d\n", year, month, day);
-    printf ("INFO: DOY is %d\n", doy);
-
     /* Loop through each pixel and assign the date information to all of the
        pixels */
-    for (i = 0; i < *nlines * *nsamps; i++)
+    for (i = 0; i < npix; i++)
     {
         (*jdate_band)[i] = (unsigned int) (year * 1000 + doy);
         (*doy_band)[i] = (unsigned short) doy;
@@ -217,3 +257,637 @@ int generate_date_bands
     return (SUCCESS);
 }
 
+
+
+/******************************************************************************
+MODULE:  write_date_bands
+
+PURPOSE: Creates the date bands for the current scene and writes them directly
+to the output files.  These include a DOY-year band, DOY band, and a year
+band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating or writing the date bands
+SUCCESS         Successfully created the date bands
+
+NOTES:
+  1. See generate_date_bands for the contents of the bands.
+  2. The bands are written DATE_LINE_BLOCK lines at a time from one block
+     buffer per band, so only the block buffers are held in memory instead of
+     the full scene.  Without the fill mask the block buffers only need to be
+     filled once.
+  3. If the fill mask is used, the pixels which are fill in band 1 are set to
+     DATE_BAND_FILL in the date bands.  Band 1 is read a block at a time to
+     build the mask, unless the scene has a valid mask (see
+     raw_binary_valid.h), which is read instead.
+  4. With a memory budget (see espa_memory.h), the blocks are shrunk to fit
+     in it.
+******************************************************************************/
+int write_date_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    char *jdate_file,                /* I: output date/year filename */
+    char *doy_file,                  /* I: output DOY filename */
+    char *year_file,                 /* I: output year filename */
+    bool use_fill_mask               /* I: should the fill pixels in band 1
+                                           be set to fill in the date bands? */
+)
+{
+    char FUNC_NAME[] = "write_date_bands";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable */
+    int line;                   /* current line in the band */
+    int block_lines;            /* number of lines in a full block */
+    int nblock_lines;           /* number of lines in the current block */
+    int nlines;                 /* number of lines in date bands */
+    int nsamps;                 /* number of samples in date bands */
+    int npix;                   /* number of pixels in the current block */
+    int year;                   /* year from the acquisition date */
+    int doy;                    /* day of year */
+    int refl_indx;              /* band index in XML file for the
+                                   representative reflectance band */
+    int ref_size = 0;           /* number of bytes per pixel of band 1 */
+    unsigned int jdate;         /* date value with year*1000 + DOY */
+    unsigned int *jdate_buf = NULL;   /* block of date values */
+    unsigned short *doy_buf = NULL;   /* block of DOY values */
+    unsigned short *year_buf = NULL;  /* block of year values */
+    void *ref_buf = NULL;       /* block of band 1 values */
+    uint8_t *fill_mask = NULL;  /* fill mask for the block */
+    FILE *fp_jdate = NULL;      /* output date/year file pointer */
+    FILE *fp_doy = NULL;        /* output DOY file pointer */
+    FILE *fp_year = NULL;       /* output year file pointer */
+    FILE *fp_ref = NULL;        /* band 1 file pointer */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+    Raw_binary_valid_t *valid = NULL; /* valid mask of the scene */
+
+    /* Determine the date of the scene and the representative band */
+    if (get_scene_date (xml_meta, &year, &doy, &refl_indx) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the date of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    bmeta = &xml_meta->band[refl_indx];
+    nlines = bmeta->nlines;
+    nsamps = bmeta->nsamps;
+    jdate = (unsigned int) (year * 1000 + doy);
+
+    /* Use the valid mask of the scene for the fill mask, or else make sure
+       band 1 can be used for it */
+    if (use_fill_mask)
+        valid = open_scene_valid_mask (xml_meta, bmeta);
+    if (use_fill_mask && valid == NULL)
+    {
+        if (bmeta->data_type == ESPA_UINT8)
+            ref_size = sizeof (uint8_t);
+        else if (bmeta->data_type == ESPA_INT16 ||
+            bmeta->data_type == ESPA_UINT16)
+            ref_size = sizeof (int16_t);
+        else
+        {
+            sprintf (errmsg, "Band 1 must be 8-bit or 16-bit integer data to "
+                "be used for the fill mask");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (bmeta->fill_value == ESPA_INT_META_FILL)
+        {
+            sprintf (errmsg, "Band 1 does not have a fill value for the fill "
+                "mask");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Allocate a block of lines for each date band, and for band 1 and the
+       fill mask if the fill mask is used */
+    block_lines = espa_budget_lines ((size_t) nsamps * (sizeof (unsigned int)
+        + 2 * sizeof (unsigned short) + (use_fill_mask ? ref_size + 1 : 0)),
+        0, espa_tune_line_block (DATE_LINE_BLOCK));
+    jdate_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+        sizeof (unsigned int), true);
+    doy_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+        sizeof (unsigned short), true);
+    year_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+        sizeof (unsigned short), true);
+    if (jdate_buf == NULL || doy_buf == NULL || year_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the date bands containing %d "
+            "lines x %d samples.", block_lines, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (use_fill_mask)
+    {
+        fill_mask = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+            sizeof (uint8_t), true);
+        if (valid == NULL)
+            ref_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+                ref_size, true);
+        if (fill_mask == NULL || (valid == NULL && ref_buf == NULL))
+        {
+            sprintf (errmsg, "Allocating memory for band 1 and the fill mask "
+                "containing %d lines x %d samples.", block_lines, nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (use_fill_mask && valid == NULL)
+    {
+        fp_ref = open_raw_binary (bmeta->file_name, "rb");
+        if (fp_ref == NULL)
+        {
+            sprintf (errmsg, "Opening band 1 file: %s", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else
+    {
+        /* Without the fill mask every block has the same values */
+        for (i = 0; i < block_lines * nsamps; i++)
+        {
+            jdate_buf[i] = jdate;
+            doy_buf[i] = (unsigned short) doy;
+            year_buf[i] = (unsigned short) year;
+        }
+    }
+
+    /* Open the output files */
+    fp_jdate = open_raw_binary (jdate_file, "wb");
+    if (fp_jdate == NULL)
+    {
+        sprintf (errmsg, "Unable to open the date/year file: %s", jdate_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp_doy = open_raw_binary (doy_file, "wb");
+    if (fp_doy == NULL)
+    {
+        sprintf (errmsg, "Unable to open the date file: %s", doy_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    fp_year = open_raw_binary (year_file, "wb");
+    if (fp_year == NULL)
+    {
+        sprintf (errmsg, "Unable to open the year file: %s", year_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Loop through the lines a block at a time and write each band */
+    for (line = 0; line < nlines; line += block_lines)
+    {
+        nblock_lines = block_lines;
+        if (line + nblock_lines > nlines)
+            nblock_lines = nlines - line;
+        npix = nblock_lines * nsamps;
+
+        if (valid != NULL)
+        {
+            /* Read the fill mask of the current block from the valid mask,
+               whose fill pixels are FILL_MASK_FILL */
+            if (read_raw_binary_valid (valid, line, nblock_lines, fill_mask)
+                != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d of the valid mask",
+                    line, line + nblock_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (use_fill_mask)
+        {
+            /* Read the current block of band 1 and build the fill mask from
+               it, treating the block as a single row */
+            if (read_raw_binary (fp_ref, nblock_lines, nsamps, ref_size,
+                ref_buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d of band 1", line,
+                    line + nblock_lines - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            if (ref_size == sizeof (uint8_t))
+            {
+                uint8_t *ref_row = ref_buf;  /* band 1 block as a row */
+                build_fill_mask_uint8 (&ref_row, 1,
+                    (uint8_t) bmeta->fill_value, npix, fill_mask);
+            }
+            else
+            {
+                int16_t *ref_row = ref_buf;  /* band 1 block as a row */
+                build_fill_mask_int16 (&ref_row, 1,
+                    (int16_t) bmeta->fill_value, npix, fill_mask);
+            }
+        }
+
+        if (use_fill_mask)
+        {
+            /* Set the date values for the pixels which aren't fill */
+            for (i = 0; i < npix; i++)
+            {
+                if (fill_mask[i] == FILL_MASK_FILL)
+                {
+                    jdate_buf[i] = DATE_BAND_FILL;
+                    doy_buf[i] = DATE_BAND_FILL;
+                    year_buf[i] = DATE_BAND_FILL;
+                }
+                else
+                {
+                    jdate_buf[i] = jdate;
+                    doy_buf[i] = (unsigned short) doy;
+                    year_buf[i] = (unsigned short) year;
+                }
+            }
+        }
+
+        /* Write the current block of each band */
+        if (write_raw_binary (fp_jdate, nblock_lines, nsamps,
+            sizeof (unsigned int), jdate_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the date/year file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (write_raw_binary (fp_doy, nblock_lines, nsamps,
+            sizeof (unsigned short), doy_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the date file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (write_raw_binary (fp_year, nblock_lines, nsamps,
+            sizeof (unsigned short), year_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the year file");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Close the files and free the block buffers */
+    close_raw_binary (fp_jdate);
+    close_raw_binary (fp_doy);
+    close_raw_binary (fp_year);
+    if (fp_ref != NULL)
+        close_raw_binary (fp_ref);
+    release_raw_binary_buffer (jdate_buf);
+    release_raw_binary_buffer (doy_buf);
+    release_raw_binary_buffer (year_buf);
+    release_raw_binary_buffer (ref_buf);
+    release_raw_binary_buffer (fill_mask);
+    close_raw_binary_valid (valid);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_date_cache_key
+
+PURPOSE: Builds the derived band cache key of the date bands from everything
+they depend on: the acquisition date and the size of the scene, and the fill
+pixels of the scene if the fill mask is used.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the valid mask or band 1 for the fill pixels
+SUCCESS         Successfully built the key
+
+NOTES:
+  1. The fill pixels are those of the valid mask of the scene if it has one,
+     otherwise those of band 1.  The checksum of band 1 in the XML metadata
+     is used if there is one, so band 1 doesn't need to be read.
+******************************************************************************/
+static int get_date_cache_key
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int year,                        /* I: year of the acquisition date */
+    int doy,                         /* I: DOY of the acquisition date */
+    Espa_band_meta_t *bmeta,         /* I: representative band (band 1) */
+    bool use_fill_mask,              /* I: should the fill pixels in band 1
+                                           be set to fill in the date bands? */
+    Derived_cache_key_t *key         /* O: cache key of the date bands */
+)
+{
+    char *valid_mask = xml_meta->global.valid_mask;  /* valid mask file */
+
+    init_derived_cache_key (key, "date_bands");
+    add_derived_cache_bytes (key, &year, sizeof (year));
+    add_derived_cache_bytes (key, &doy, sizeof (doy));
+    add_derived_cache_bytes (key, &bmeta->nlines, sizeof (bmeta->nlines));
+    add_derived_cache_bytes (key, &bmeta->nsamps, sizeof (bmeta->nsamps));
+    add_derived_cache_bytes (key, &use_fill_mask, sizeof (use_fill_mask));
+    if (!use_fill_mask)
+        return (SUCCESS);
+
+    if (valid_mask[0] != '\0' && strcmp (valid_mask, ESPA_STRING_META_FILL))
+        return (add_derived_cache_file (key, valid_mask));
+
+    add_derived_cache_bytes (key, &bmeta->fill_value,
+        sizeof (bmeta->fill_value));
+    return (add_derived_cache_band (key, bmeta));
+}
+
+
+/******************************************************************************
+MODULE:  write_constant_date_bands
+
+PURPOSE: Writes the date/year bands for the current scene as constant bands,
+since every non-fill pixel has the same date.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the date bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. If the fill mask is used, the fill pixels of band 1 are fill in the date
+     bands when they're read, so band 1 needs to stay with the date bands.
+  2. The constant is recorded in the band metadata of each date band.
+******************************************************************************/
+static int write_constant_date_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    bool use_fill_mask,              /* I: should the fill pixels in band 1
+                                           be set to fill in the date bands? */
+    Espa_internal_meta_t *out_meta   /* I/O: metadata for the three date
+                                           bands */
+)
+{
+    int year;                    /* year of the scene acquisition */
+    int doy;                     /* day of year of the scene acquisition */
+    int refl_indx;               /* index of band1 */
+    Espa_band_meta_t *mask_bmeta = NULL;  /* band 1, for the fill mask */
+
+    if (get_scene_date (xml_meta, &year, &doy, &refl_indx) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (use_fill_mask)
+        mask_bmeta = &xml_meta->band[refl_indx];
+
+    if (write_raw_binary_constant (&out_meta->band[0], year * 1000.0 + doy,
+            mask_bmeta) != SUCCESS ||
+        write_raw_binary_constant (&out_meta->band[1], doy, mask_bmeta)
+            != SUCCESS ||
+        write_raw_binary_constant (&out_meta->band[2], year, mask_bmeta)
+            != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_date_bands
+
+PURPOSE: Creates the date/year bands for the current scene and sets up the
+band metadata for them. These bands are generated from the acquisition
+date/year in the XML metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the date bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output date/year filenames are the product ID with _date.img,
+     _doy.img, and _year.img appended for the combined date/year, day of year,
+     and year bands respectively.
+  2. The band data and ENVI headers are written by this routine.  The bands
+     are returned in out_meta but are not added to the XML metadata; it is up
+     to the caller to append them to the XML file or the metadata structure.
+     The caller is responsible for calling free_metadata on out_meta.
+  3. If ESPA_CONSTANT_BANDS is "yes" the date bands are written as constant
+     bands (see raw_binary_constant.h), which are generated when read.
+  4. Otherwise, if the ESPA_DERIVED_CACHE environment variable names a cache
+     (see derived_cache.h), the bands of an earlier run for the same date,
+     scene size and fill pixels are restored from it rather than generated,
+     and generated bands are added to it.
+******************************************************************************/
+int create_date_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    bool use_fill_mask,              /* I: should the fill pixels in band 1
+                                           be set to fill in the date bands? */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the three date bands;
+                                           global metadata is not valid */
+)
+{
+    char FUNC_NAME[] = "create_date_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char tmp_ext[STR_SIZE];      /* temporary filename extension */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    int i;                       /* looping variable */
+    int year;                    /* year of the scene acquisition */
+    int doy;                     /* day of year of the scene acquisition */
+    int refl_indx;               /* index of band1 */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* pointer to global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for bands */
+    Derived_cache_key_t key;     /* derived band cache key of the bands */
+    bool cache_ok;               /* can the bands be cached? */
+
+    /* Use band 1 as the representative band in the XML */
+    if (get_scene_date (xml_meta, &year, &doy, &refl_indx) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    bmeta = &xml_meta->band[refl_indx];
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    /* Allocate memory for three output bands */
+    if (allocate_band_metadata (out_meta, 3) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the date bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+  
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+  
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Loop through the three bands and append them to the XML file */
+    for (i = 0; i < 3; i++)
+    {
+        /* Set up the band metadata for the date bands */
+        out_bmeta = &out_meta->band[i];
+        strcpy (out_bmeta->product, "intermediate_data");
+        strcpy (out_bmeta->source, "level1");
+
+        /* Band-specific names */
+        switch (i)
+        {
+            case (0):  /* combined date/year */
+                strcpy (out_bmeta->name, "combined_date");
+                strcpy (out_bmeta->category, "image");
+                out_bmeta->data_type = ESPA_UINT32;
+                strncpy (tmpstr, bmeta->short_name, 3);
+                sprintf (out_bmeta->short_name, "%sDATE", tmpstr);
+                strcpy (out_bmeta->long_name,
+                    "doy and year (YEAR * 1000 + DOY)");
+                sprintf (tmp_ext, "date.img");
+                strcpy (out_bmeta->data_units, "date");
+                break;
+
+            case (1):  /* date */
+                strcpy (out_bmeta->name, "doy");
+                strcpy (out_bmeta->category, "image");
+                out_bmeta->data_type = ESPA_UINT16;
+                strncpy (tmpstr, bmeta->short_name, 3);
+                sprintf (out_bmeta->short_name, "%sDOY", tmpstr);
+                strcpy (out_bmeta->long_name, "day of year");
+                sprintf (tmp_ext, "doy.img");
+                out_bmeta->valid_range[0] = 1.0;
+                out_bmeta->valid_range[1] = 366.0;
+                strcpy (out_bmeta->data_units, "date");
+                break;
+
+            case (2):  /* year */
+                strcpy (out_bmeta->name, "year");
+                strcpy (out_bmeta->category, "image");
+                out_bmeta->data_type = ESPA_UINT16;
+                strncpy (tmpstr, bmeta->short_name, 3);
+                sprintf (out_bmeta->short_name, "%sYEAR", tmpstr);
+                strcpy (out_bmeta->long_name, "year");
+                sprintf (tmp_ext, "year.img");
+                out_bmeta->valid_range[0] = 1970.0;
+                out_bmeta->valid_range[1] = 9999.0;
+                strcpy (out_bmeta->data_units, "date");
+                break;
+        }
+
+        /* Use the product name to create the date filename */
+        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name), "%s_%s",
+            gmeta->product_id, tmp_ext);
+
+        out_bmeta->resample_method = ESPA_NN;
+        out_bmeta->nlines = bmeta->nlines;
+        out_bmeta->nsamps = bmeta->nsamps;
+        if (use_fill_mask)
+            out_bmeta->fill_value = DATE_BAND_FILL;
+        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+        sprintf (out_bmeta->app_version, "create_date_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (out_bmeta->production_date, production_date);
+    }
+
+    /* Generate the date bands for this scene and write them to the output
+       files, or just record the dates if constant bands are requested */
+    if (use_raw_binary_constant ())
+    {
+        if (write_constant_date_bands (xml_meta, use_fill_mask, out_meta)
+            != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+    else
+    {
+        /* Use the date bands of an earlier run on the same inputs if they're
+           cached.  The bands just aren't cached if the fill pixels can't be
+           read for the key. */
+        cache_ok = use_derived_cache () && get_date_cache_key (xml_meta, year,
+            doy, bmeta, use_fill_mask, &key) == SUCCESS;
+        if (cache_ok && read_derived_cache (&key, 3, out_meta->band))
+            printf ("Using the cached date bands\n");
+        else
+        {
+            if (write_date_bands (xml_meta, out_meta->band[0].file_name,
+                out_meta->band[1].file_name, out_meta->band[2].file_name,
+                use_fill_mask) != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+
+            /* Cache the bands for later runs.  The bands are still good if
+               they can't be cached. */
+            if (cache_ok &&
+                write_derived_cache (&key, 3, out_meta->band) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to cache the date bands");
+                error_handler (false, FUNC_NAME, errmsg);
+            }
+        }
+    }
+
+    /* Write the ENVI header for each of the date bands */
+    for (i = 0; i < 3; i++)
+    {
+        /* Create the ENVI header using the date band */
+        out_bmeta = &out_meta->band[i];
+        if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header */
+        sprintf (tmpstr, "%s", out_bmeta->file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
@@ -17,14 +17,25 @@ NOTES:
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include "error_handler.h"
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "write_metadata.h"
 #include "raw_binary_io.h"
 #include "envi_header.h"
+#include "fill_mask.h"
 
 /* Defines */
+/* Number of lines written to each date band at a time, unless the node
+   profile sets line_block (see espa_tune.h) */
+#define DATE_LINE_BLOCK 256
+
+/* Value of the date bands for fill pixels */
+#define DATE_BAND_FILL 0
+
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
 
 /* Prototypes */
 int generate_date_bands
@@ -38,4 +49,23 @@ int generate_date_bands
     int *nsamps                      /* O: number of samples in date bands */
 );
 
+int write_date_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    char *jdate_file,                /* I: output date/year filename */
+    char *doy_file,                  /* I: output DOY filename */
+    char *year_file,                 /* I: output year filename */
+    bool use_fill_mask               /* I: should the fill pixels in band 1
+                                           be set to fill in the date bands? */
+);
+
+int create_date_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    bool use_fill_mask,              /* I: should the fill pixels in band 1
+                                           be set to fill in the date bands? */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the three date bands;
+                                           global metadata is not valid */
+);
+
 #endif
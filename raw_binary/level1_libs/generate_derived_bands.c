@@ -0,0 +1,212 @@
+/*****************************************************************************
+FILE: generate_derived_bands.c
+  
+PURPOSE: Contains functions to create derived bands, such as spectral
+indices, from band-math expressions over the bands of the product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <ctype.h>
+#include "generate_derived_bands.h"
+
+
+/******************************************************************************
+MODULE:  create_derived_bands
+
+PURPOSE: Creates the derived bands and sets up the band metadata for them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the derived bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output filenames are the product ID with _<name>.img appended.
+     The size, pixel size and source of the derived bands come from the
+     first band used by the first expression.
+  2. The materialized bands are computed in one pass, reading each band the
+     expressions use once (see materialize_raw_binary_derived).
+  3. The band data and ENVI headers are written by this routine.  The bands
+     are returned in out_meta but are not added to the XML metadata; it is up
+     to the caller to append them to the XML file or the metadata structure.
+     The caller is responsible for calling free_metadata on out_meta.
+******************************************************************************/
+int create_derived_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int nbands,                      /* I: number of derived bands */
+    Derived_band_t *bands,           /* I: derived bands to be created */
+    Derived_options_t *opts,         /* I: data type, scaling and storage of
+                                           the derived bands */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the derived bands;
+                                           global metadata is not valid */
+)
+{
+    char FUNC_NAME[] = "create_derived_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    char *cptr = NULL;           /* pointer into the short name */
+    int i;                       /* looping variable for the bands */
+    int ref_indx;                /* index of the reference band */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* pointer to global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* reference band metadata */
+    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for derived bands */
+    Raw_binary_operands_t operands;   /* bands used by the first expression */
+    Raw_binary_expr_t expr;           /* compiled first expression */
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    if (nbands < 1 || nbands > DERIVED_MAX_BANDS)
+    {
+        sprintf (errmsg, "Number of derived bands must be from 1 to %d",
+            DERIVED_MAX_BANDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The first band used by the first expression is the reference band */
+    operands.noperands = 0;
+    if (compile_raw_binary_expr (bands[0].expression, &operands, &expr)
+        != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (operands.noperands == 0)
+    {
+        sprintf (errmsg, "Expression of the derived band %s doesn't use any "
+            "bands", bands[0].name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    ref_indx = find_band_metadata (xml_meta, NULL, operands.name[0], NULL);
+    if (ref_indx < 0)
+    {
+        sprintf (errmsg, "Band %s isn't in the XML file", operands.name[0]);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    bmeta = &xml_meta->band[ref_indx];
+
+    /* Allocate memory for the output bands */
+    if (allocate_band_metadata (out_meta, nbands) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the derived bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the band metadata for each derived band */
+    for (i = 0; i < nbands; i++)
+    {
+        out_bmeta = &out_meta->band[i];
+        strcpy (out_bmeta->product, "spectral_indices");
+        strcpy (out_bmeta->source, bmeta->product);
+        strcpy (out_bmeta->category, "index");
+        out_bmeta->data_type = opts->data_type;
+        snprintf (out_bmeta->name, sizeof (out_bmeta->name), "%s",
+            bands[i].name);
+        snprintf (out_bmeta->short_name, sizeof (out_bmeta->short_name),
+            "%.4s%.10s", bmeta->short_name, bands[i].name);
+        for (cptr = out_bmeta->short_name; *cptr != '\0'; cptr++)
+            *cptr = toupper ((unsigned char) *cptr);
+        snprintf (out_bmeta->long_name, sizeof (out_bmeta->long_name),
+            "%s derived from %s", bands[i].name, bmeta->product);
+        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name),
+            "%s_%s.img", gmeta->product_id, bands[i].name);
+        out_bmeta->derived.is_derived = true;
+        strcpy (out_bmeta->derived.expression, bands[i].expression);
+
+        out_bmeta->resample_method = ESPA_BI;
+        out_bmeta->nlines = bmeta->nlines;
+        out_bmeta->nsamps = bmeta->nsamps;
+        out_bmeta->fill_value = opts->fill_value;
+        out_bmeta->scale_factor = opts->scale_factor;
+        out_bmeta->add_offset = opts->add_offset;
+        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+        strcpy (out_bmeta->data_units, "band ratio index");
+        sprintf (out_bmeta->app_version, "create_derived_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (out_bmeta->production_date, production_date);
+    }
+
+    /* Write the lazy bands, or compute all the bands in one pass */
+    if (opts->lazy)
+    {
+        for (i = 0; i < nbands; i++)
+        {
+            if (write_raw_binary_derived (xml_meta, &out_meta->band[i])
+                != SUCCESS)
+            {  /* Error messages already written */
+                return (ERROR);
+            }
+        }
+    }
+    else if (materialize_raw_binary_derived (xml_meta, nbands,
+        out_meta->band) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Write the ENVI header of each derived band */
+    for (i = 0; i < nbands; i++)
+    {
+        out_bmeta = &out_meta->band[i];
+        if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        sprintf (tmpstr, "%s", out_bmeta->file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************
+FILE: generate_derived_bands.h
+
+PURPOSE: Contains defines, structures and prototypes to create derived
+bands, such as spectral indices, from band-math expressions over the bands
+of the product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_expr.h for the expressions, and raw_binary_derived.h for
+     materialized and lazy derived bands.
+*****************************************************************************/
+
+#ifndef GENERATE_DERIVED_BANDS_H
+#define GENERATE_DERIVED_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "raw_binary_derived.h"
+#include "envi_header.h"
+
+/* Defines */
+/* Largest number of derived bands created at a time */
+#define DERIVED_MAX_BANDS 16
+
+/* Default fill value of the derived bands */
+#define DERIVED_BAND_FILL -9999
+
+/* Default scale factor of the derived bands, for indices from -1 to 1 in
+   16-bit integers */
+#define DERIVED_SCALE_FACTOR 0.0001
+
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
+
+/* Type definitions */
+/* Derived band to be created */
+typedef struct
+{
+    char name[STR_SIZE];         /* name of the band, e.g. ndvi */
+    char expression[STR_SIZE];   /* band-math expression */
+} Derived_band_t;
+
+/* Data type and scaling of the derived bands, and how they're stored */
+typedef struct
+{
+    enum Espa_data_type data_type;  /* data type of the bands */
+    double scale_factor;         /* scale factor; ESPA_FLOAT_META_FILL for
+                                    none */
+    double add_offset;           /* offset; ESPA_FLOAT_META_FILL for none */
+    long fill_value;             /* fill value */
+    bool lazy;                   /* write lazy bands, computed when read,
+                                    rather than the band data? */
+} Derived_options_t;
+
+/* Prototypes */
+int create_derived_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int nbands,                      /* I: number of derived bands */
+    Derived_band_t *bands,           /* I: derived bands to be created */
+    Derived_options_t *opts,         /* I: data type, scaling and storage of
+                                           the derived bands */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the derived bands;
+                                           global metadata is not valid */
+);
+
+#endif
@@ -0,0 +1,109 @@
+/*****************************************************************************
+FILE: generate_overviews
+  
+PURPOSE: Contains functions for generating the reduced-resolution overviews
+of the bands in a product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include "generate_overviews.h"
+
+/******************************************************************************
+MODULE:  create_band_overviews
+
+PURPOSE: Creates the overview levels of each band in the XML metadata, along
+with their ENVI headers.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the overviews
+SUCCESS         Successful completion
+
+NOTES:
+  1. The overviews are written next to each band, as described in
+     raw_binary_overview.h.  They are quick-looks of the bands and are not
+     added to the XML metadata.
+  2. The ENVI header of each level has the same UL corner as the band, with
+     the pixel size multiplied by the reduction factor of the level.
+******************************************************************************/
+int create_band_overviews
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int nlevels                      /* I: number of overview levels for each
+                                           band (1 to RB_MAX_OVERVIEWS) */
+)
+{
+    char FUNC_NAME[] = "create_band_overviews";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char hdr_file[STR_SIZE];     /* name of the ENVI header of a level */
+    int i, k;                    /* looping variables for bands and levels */
+    FILE *fp_rb = NULL;          /* file pointer for the raw binary band */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Raw_binary_overview_t ovr;   /* overviews of the current band */
+    Raw_binary_overview_level_t *lvl = NULL;  /* current overview level */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        bmeta = &xml_meta->band[i];
+
+        /* Build the overview levels in a single pass through the band */
+        fp_rb = open_raw_binary (bmeta->file_name, "rb");
+        if (fp_rb == NULL)
+        {
+            sprintf (errmsg, "Opening the input raw binary file: %s",
+                bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (build_raw_binary_overviews (fp_rb, bmeta, nlevels, &ovr) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Building the overviews of band %s",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            close_raw_binary (fp_rb);
+            return (ERROR);
+        }
+        close_raw_binary (fp_rb);
+
+        /* Write the ENVI header for each level, starting from the header of
+           the band so the UL corner is that of the band */
+        for (k = 0; k < ovr.nlevels; k++)
+        {
+            lvl = &ovr.level[k];
+            if (create_envi_struct (bmeta, &xml_meta->global, &envi_hdr) !=
+                SUCCESS)
+            {
+                sprintf (errmsg, "Error creating the ENVI header file.");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            envi_hdr.nlines = lvl->nlines;
+            envi_hdr.nsamps = lvl->nsamps;
+            envi_hdr.pixel_size[0] *= lvl->factor;
+            envi_hdr.pixel_size[1] *= lvl->factor;
+
+            sprintf (hdr_file, "%s", lvl->file_name);
+            sprintf (&hdr_file[strlen(hdr_file)-3], "hdr");
+            if (write_envi_hdr (hdr_file, &envi_hdr) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing the ENVI header file: %s.",
+                    hdr_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
@@ -0,0 +1,35 @@
+/*****************************************************************************
+FILE: generate_overviews
+  
+PURPOSE: Contains defines and prototypes to generate the reduced-resolution
+overviews of the bands in a product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef GENERATE_OVERVIEWS_H
+#define GENERATE_OVERVIEWS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "raw_binary_io.h"
+#include "raw_binary_overview.h"
+#include "envi_header.h"
+
+/* Prototypes */
+int create_band_overviews
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int nlevels                      /* I: number of overview levels for each
+                                           band (1 to RB_MAX_OVERVIEWS) */
+);
+
+#endif
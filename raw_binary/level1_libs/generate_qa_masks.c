@@ -0,0 +1,854 @@
+/*****************************************************************************
+FILE: generate_qa_masks.c
+
+PURPOSE: Contains functions to expand the bit fields of a bit-packed QA band
+into separate 8-bit mask bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The QA band is read once, a block of lines at a time, and all the
+     selected fields are decoded from each block.
+  2. The pixels are decoded with SSE2 when it is available, 16 pixels at a
+     time, and one at a time otherwise and for the last pixels of a block.
+     Both give the same masks.
+*****************************************************************************/
+#include <ctype.h>
+#include <stdint.h>
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "generate_qa_masks.h"
+#include "espa_memory.h"
+#include "espa_tune.h"
+#include "espa_task.h"
+#include "raw_binary_pool.h"
+
+/* Block of pixels decoded by the chunks of espa_parallel_for */
+typedef struct
+{
+    const uint8_t *qa8;     /* QA values of the block for an 8-bit band, or
+                               NULL */
+    const uint16_t *qa16;   /* QA values of the block for a 16-bit band, or
+                               NULL */
+    int nfields;            /* number of fields decoded */
+    int shift[QA_MAX_FIELDS];       /* first bit of each field */
+    uint16_t mask[QA_MAX_FIELDS];   /* mask of the bits of each field, after
+                                       the shift */
+    uint8_t *masks[QA_MAX_FIELDS];  /* mask values of the block for each
+                                       field */
+    bool has_fill;          /* does the QA band have a fill value? */
+    uint16_t fill;          /* QA fill value */
+} Qa_block_t;
+
+/******************************************************************************
+MODULE:  make_field_name
+
+PURPOSE: Makes the name of a field from its description, for the mask band
+name.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The description is lowercased and each run of other characters than
+     letters and digits becomes one underscore, so "Cloud Confidence" is
+     cloud_confidence.
+******************************************************************************/
+static void make_field_name
+(
+    const char *description,  /* I: description of the field */
+    char *name                /* O: name of the field (STR_SIZE) */
+)
+{
+    int len = 0;              /* length of the name */
+    const char *c = NULL;     /* current character of the description */
+
+    for (c = description; *c != '\0' && len < STR_SIZE - 1; c++)
+    {
+        if (isalnum ((unsigned char) *c))
+            name[len++] = tolower ((unsigned char) *c);
+        else if (len > 0 && name[len-1] != '_')
+            name[len++] = '_';
+    }
+
+    /* Drop a trailing underscore */
+    if (len > 0 && name[len-1] == '_')
+        len--;
+    name[len] = '\0';
+}
+
+
+/******************************************************************************
+MODULE:  get_qa_fields
+
+PURPOSE: Gets the bit fields of a QA band from its bitmap_description.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band has no bitmap_description, or too many bits
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Consecutive bits with the same description are one field.  A field
+     whose name is already used by an earlier one gets _bit<n> appended.
+******************************************************************************/
+int get_qa_fields
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    int *nfields,              /* O: number of fields */
+    Qa_field_t *fields         /* O: fields of the QA band (QA_MAX_FIELDS) */
+)
+{
+    char FUNC_NAME[] = "get_qa_fields";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char suffix[STR_SIZE];     /* suffix of a repeated field name */
+    int bit;                   /* looping variable for the bits */
+    int i;                     /* looping variable for the fields */
+    Qa_field_t *field = NULL;  /* current field */
+
+    *nfields = 0;
+    if (bmeta->nbits <= 0 || bmeta->bitmap_description == NULL)
+    {
+        sprintf (errmsg, "Band %s has no bitmap description; use bit:<n> or "
+            "bits:<first>-<last> for its fields", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (bmeta->nbits > QA_MAX_FIELDS)
+    {
+        sprintf (errmsg, "Band %s has %d bits in its bitmap description; "
+            "only %d are supported", bmeta->name, bmeta->nbits,
+            QA_MAX_FIELDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (bit = 0; bit < bmeta->nbits; bit++)
+    {
+        /* Extend the current field if the bit has the same description */
+        if (field != NULL && !strcmp (bmeta->bitmap_description[bit],
+            field->description))
+        {
+            field->nbits++;
+            continue;
+        }
+
+        field = &fields[(*nfields)++];
+        snprintf (field->description, sizeof (field->description), "%s",
+            bmeta->bitmap_description[bit]);
+        make_field_name (field->description, field->name);
+        if (field->name[0] == '\0')
+            sprintf (field->name, "bit%d", bit);
+        field->shift = bit;
+        field->nbits = 1;
+
+        for (i = 0; i < *nfields - 1; i++)
+        {
+            if (!strcmp (fields[i].name, field->name))
+            {
+                sprintf (suffix, "_bit%d", bit);
+                field->name[STR_SIZE - strlen (suffix) - 1] = '\0';
+                strcat (field->name, suffix);
+                break;
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_bit_range
+
+PURPOSE: Parses a field given by its bits, as bit:<n> or
+bits:<first>-<last>.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The bit range isn't valid for the band
+SUCCESS         No errors encountered
+
+NOTES:
+  1. is_range is false, and the field is left as it is, if the requested
+     field isn't a bit range.
+  2. The description is the bitmap_description of the first bit when the
+     band has one.
+******************************************************************************/
+static int parse_bit_range
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    const char *spec,          /* I: requested field */
+    int band_bits,             /* I: number of bits of the QA data type */
+    bool *is_range,            /* O: is the requested field a bit range? */
+    Qa_field_t *field          /* O: field of the bit range */
+)
+{
+    char FUNC_NAME[] = "parse_bit_range";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char extra;                /* character after the bit range, if any */
+    int first;                 /* first bit of the range */
+    int last;                  /* last bit of the range */
+
+    *is_range = true;
+    if (sscanf (spec, "bits:%d-%d%c", &first, &last, &extra) == 2)
+        ;
+    else if (sscanf (spec, "bit:%d%c", &first, &extra) == 1)
+        last = first;
+    else if (!strncasecmp (spec, "bit", 3) && strchr (spec, ':') != NULL)
+    {
+        sprintf (errmsg, "Invalid bit range %s; use bit:<n> or "
+            "bits:<first>-<last>", spec);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    else
+    {
+        *is_range = false;
+        return (SUCCESS);
+    }
+
+    if (first < 0 || last < first || last >= band_bits)
+    {
+        sprintf (errmsg, "Bit range %s must be within bits 0-%d of band %s",
+            spec, band_bits - 1, bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    field->shift = first;
+    field->nbits = last - first + 1;
+    if (field->nbits == 1)
+    {
+        sprintf (field->name, "bit%d", first);
+        sprintf (field->description, "bit %d", first);
+    }
+    else
+    {
+        sprintf (field->name, "bits%d_%d", first, last);
+        sprintf (field->description, "bits %d-%d", first, last);
+    }
+
+    if (first < bmeta->nbits && bmeta->bitmap_description != NULL)
+        snprintf (field->description, sizeof (field->description), "%s",
+            bmeta->bitmap_description[first]);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  select_qa_fields
+
+PURPOSE: Selects the fields of a QA band to be expanded into masks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A field isn't in the QA band, or isn't valid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Each field of the list is a description of the bitmap_description
+     (case is ignored), the field name made from it (see make_field_name),
+     or a bit range (see parse_bit_range).
+  2. Without a list, all the fields of the bitmap_description are selected.
+  3. A field can't have more than QA_MAX_FIELD_BITS bits.
+******************************************************************************/
+int select_qa_fields
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    char *field_list,          /* I: comma-separated field descriptions or
+                                     bit ranges; NULL for all the fields */
+    int *nfields,              /* O: number of selected fields */
+    Qa_field_t *fields         /* O: selected fields (QA_MAX_FIELDS) */
+)
+{
+    char FUNC_NAME[] = "select_qa_fields";  /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char *list = NULL;         /* copy of the field list being split */
+    char *spec = NULL;         /* current requested field */
+    char *saveptr = NULL;      /* state of strtok_r */
+    int band_bits;             /* number of bits of the QA data type */
+    int nband_fields = 0;      /* number of fields of the bitmap_description */
+    int i, j;                  /* looping variables for the fields */
+    bool is_range;             /* is the requested field a bit range? */
+    bool have_fields = false;  /* were the band fields read? */
+    Qa_field_t band_fields[QA_MAX_FIELDS];  /* fields of the QA band */
+
+    *nfields = 0;
+    band_bits = (bmeta->data_type == ESPA_UINT8) ? 8 : 16;
+
+    if (field_list == NULL || field_list[0] == '\0')
+    {
+        if (get_qa_fields (bmeta, nfields, fields) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+    else
+    {
+        list = strdup (field_list);
+        if (list == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the field list");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (spec = strtok_r (list, ",", &saveptr); spec != NULL;
+            spec = strtok_r (NULL, ",", &saveptr))
+        {
+            if (*nfields == QA_MAX_FIELDS)
+            {
+                sprintf (errmsg, "At most %d fields can be selected",
+                    QA_MAX_FIELDS);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (list);
+                return (ERROR);
+            }
+
+            if (parse_bit_range (bmeta, spec, band_bits, &is_range,
+                &fields[*nfields]) != SUCCESS)
+            {  /* Error messages already written */
+                free (list);
+                return (ERROR);
+            }
+            if (is_range)
+            {
+                (*nfields)++;
+                continue;
+            }
+
+            /* Look the field up in the bitmap_description */
+            if (!have_fields)
+            {
+                if (get_qa_fields (bmeta, &nband_fields, band_fields)
+                    != SUCCESS)
+                {  /* Error messages already written */
+                    free (list);
+                    return (ERROR);
+                }
+                have_fields = true;
+            }
+
+            for (i = 0; i < nband_fields; i++)
+            {
+                if (!strcasecmp (spec, band_fields[i].description) ||
+                    !strcasecmp (spec, band_fields[i].name))
+                    break;
+            }
+            if (i == nband_fields)
+            {
+                sprintf (errmsg, "Field %s isn't in the bitmap description "
+                    "of band %s", spec, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (list);
+                return (ERROR);
+            }
+            fields[(*nfields)++] = band_fields[i];
+        }
+        free (list);
+    }
+
+    if (*nfields == 0)
+    {
+        sprintf (errmsg, "No fields were selected from band %s",
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Make sure each field fits in the mask and the data type, and that
+       each mask band name is used once */
+    for (i = 0; i < *nfields; i++)
+    {
+        if (fields[i].nbits > QA_MAX_FIELD_BITS)
+        {
+            sprintf (errmsg, "Field %s of band %s has %d bits; at most %d are "
+                "supported", fields[i].name, bmeta->name, fields[i].nbits,
+                QA_MAX_FIELD_BITS);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (fields[i].shift + fields[i].nbits > band_bits)
+        {
+            sprintf (errmsg, "Field %s is beyond the %d bits of band %s",
+                fields[i].name, band_bits, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (j = 0; j < i; j++)
+        {
+            if (!strcmp (fields[j].name, fields[i].name))
+            {
+                sprintf (errmsg, "Field %s is selected more than once",
+                    fields[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  decode_qa_pixels
+
+PURPOSE: Decodes the selected fields of a chunk of the pixels of a block.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successful completion
+
+NOTES:
+  1. This is the Espa_range_func_t of the QA band.
+  2. The mask value is (QA >> shift) & mask, or QA_MASK_FILL for the fill
+     pixels.  With SSE2 the 16 QA values are shifted as 16-bit integers and
+     packed to bytes; the fill bytes are all ones, so or-ing them in gives
+     QA_MASK_FILL since the field values are below it.
+******************************************************************************/
+static int decode_qa_pixels
+(
+    void *arg,              /* I: block of pixels (Qa_block_t *) */
+    int first,              /* I: first pixel of the chunk */
+    int end,                /* I: pixel after the last one of the chunk */
+    int runner              /* I: not used */
+)
+{
+    const Qa_block_t *blk = arg;  /* block of pixels */
+    int p = first;          /* looping variable for the pixels */
+    int f;                  /* looping variable for the fields */
+    uint16_t qa;            /* QA value of the pixel */
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i fill = _mm_set1_epi16 ((short) blk->fill);
+    __m128i raw;            /* 8-bit QA values of 16 pixels */
+    __m128i lo, hi;         /* QA values of the first and last 8 pixels */
+    __m128i is_fill;        /* fill mask of the 16 pixels, as bytes */
+    __m128i mask;           /* mask of the bits of the field */
+    __m128i count;          /* shift count of the field */
+
+    for (; p + 16 <= end; p += 16)
+    {
+        if (blk->qa8 != NULL)
+        {
+            raw = _mm_loadu_si128 ((const __m128i *) &blk->qa8[p]);
+            lo = _mm_unpacklo_epi8 (raw, zero);
+            hi = _mm_unpackhi_epi8 (raw, zero);
+        }
+        else
+        {
+            lo = _mm_loadu_si128 ((const __m128i *) &blk->qa16[p]);
+            hi = _mm_loadu_si128 ((const __m128i *) &blk->qa16[p+8]);
+        }
+
+        is_fill = zero;
+        if (blk->has_fill)
+            is_fill = _mm_packs_epi16 (_mm_cmpeq_epi16 (lo, fill),
+                _mm_cmpeq_epi16 (hi, fill));
+
+        for (f = 0; f < blk->nfields; f++)
+        {
+            count = _mm_cvtsi32_si128 (blk->shift[f]);
+            mask = _mm_set1_epi16 ((short) blk->mask[f]);
+            _mm_storeu_si128 ((__m128i *) &blk->masks[f][p], _mm_or_si128 (
+                _mm_packus_epi16 (
+                    _mm_and_si128 (_mm_srl_epi16 (lo, count), mask),
+                    _mm_and_si128 (_mm_srl_epi16 (hi, count), mask)),
+                is_fill));
+        }
+    }
+#endif
+
+    /* Remaining pixels */
+    for (; p < end; p++)
+    {
+        qa = (blk->qa8 != NULL) ? blk->qa8[p] : blk->qa16[p];
+        if (blk->has_fill && qa == blk->fill)
+        {
+            for (f = 0; f < blk->nfields; f++)
+                blk->masks[f][p] = QA_MASK_FILL;
+        }
+        else
+        {
+            for (f = 0; f < blk->nfields; f++)
+                blk->masks[f][p] = (uint8_t) ((qa >> blk->shift[f]) &
+                    blk->mask[f]);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_qa_masks
+
+PURPOSE: Expands the fields of a QA band into mask bands and writes them, a
+block of lines at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the mask bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The QA band must be 8-bit or 16-bit unsigned data.  Each block is read
+     once and all the masks are decoded from it.
+  2. Each block is read and written by the calling thread; its pixels are
+     decoded in chunks by the task pool (see espa_task.h).
+******************************************************************************/
+int write_qa_masks
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    int nfields,               /* I: number of fields */
+    Qa_field_t *fields,        /* I: fields to be expanded */
+    char **mask_files          /* I: output mask filename of each field */
+)
+{
+    char FUNC_NAME[] = "write_qa_masks";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int f;                      /* looping variable for the fields */
+    int line;                   /* current line in the band */
+    int block_lines;            /* number of lines in a full block */
+    int nblock_lines;           /* number of lines in the current block */
+    int nlines;                 /* number of lines in the band */
+    int nsamps;                 /* number of samples in the band */
+    int nthreads;               /* number of threads decoding the pixels */
+    int size;                   /* number of bytes per QA pixel */
+    size_t block_pix;           /* number of pixels in a full block */
+    void *qa_buf = NULL;        /* block of QA values */
+    uint8_t *mask_buf = NULL;   /* block of mask values for all the fields */
+    FILE *fp_qa = NULL;         /* QA band file pointer */
+    FILE *fp_mask[QA_MAX_FIELDS];  /* mask band file pointers */
+    Qa_block_t blk;             /* block of pixels being decoded */
+
+    nlines = bmeta->nlines;
+    nsamps = bmeta->nsamps;
+    if (bmeta->data_type == ESPA_UINT8)
+        size = sizeof (uint8_t);
+    else if (bmeta->data_type == ESPA_UINT16)
+        size = sizeof (uint16_t);
+    else
+    {
+        sprintf (errmsg, "QA band %s must be 8-bit or 16-bit unsigned "
+            "integer data", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (nfields < 1 || nfields > QA_MAX_FIELDS)
+    {
+        sprintf (errmsg, "Number of fields must be from 1 to %d",
+            QA_MAX_FIELDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the decoding of the pixels.  A fill value outside the data
+       type can't occur in the band. */
+    memset (&blk, 0, sizeof (blk));
+    blk.nfields = nfields;
+    for (f = 0; f < nfields; f++)
+    {
+        blk.shift[f] = fields[f].shift;
+        blk.mask[f] = (uint16_t) ((1 << fields[f].nbits) - 1);
+    }
+    blk.has_fill = bmeta->fill_value != ESPA_INT_META_FILL &&
+        bmeta->fill_value >= 0 && bmeta->fill_value < (1L << (8 * size));
+    blk.fill = (uint16_t) bmeta->fill_value;
+
+    /* Allocate a block of lines for the QA values and the masks */
+    block_lines = espa_budget_lines ((size_t) nsamps * (size + nfields), 0,
+        espa_tune_line_block (QA_LINE_BLOCK));
+    block_pix = (size_t) block_lines * nsamps;
+
+    qa_buf = get_raw_binary_buffer (block_pix * size, false);
+    mask_buf = get_raw_binary_buffer (block_pix * nfields, false);
+    if (qa_buf == NULL || mask_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the QA masks containing %d "
+            "lines x %d samples.", block_lines, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (size == sizeof (uint8_t))
+        blk.qa8 = qa_buf;
+    else
+        blk.qa16 = qa_buf;
+    for (f = 0; f < nfields; f++)
+        blk.masks[f] = &mask_buf[f * block_pix];
+
+    /* Open the input and output files */
+    fp_qa = open_raw_binary (bmeta->file_name, "rb");
+    if (fp_qa == NULL)
+    {
+        sprintf (errmsg, "Opening the QA band file: %s", bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (f = 0; f < nfields; f++)
+    {
+        fp_mask[f] = open_raw_binary (mask_files[f], "wb");
+        if (fp_mask[f] == NULL)
+        {
+            sprintf (errmsg, "Unable to open the mask file: %s",
+                mask_files[f]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Loop through the lines a block at a time, decoding the pixels of each
+       block in chunks */
+    nthreads = espa_task_nthreads ();
+    for (line = 0; line < nlines; line += block_lines)
+    {
+        nblock_lines = block_lines;
+        if (line + nblock_lines > nlines)
+            nblock_lines = nlines - line;
+
+        if (read_raw_binary (fp_qa, nblock_lines, nsamps, size, qa_buf)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of band %s", line,
+                line + nblock_lines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Decode the block; the chunk function can't fail */
+        espa_parallel_for (0, nblock_lines * nsamps, QA_PIXEL_GRAIN,
+            nthreads, decode_qa_pixels, &blk);
+
+        for (f = 0; f < nfields; f++)
+        {
+            if (write_raw_binary (fp_mask[f], nblock_lines, nsamps,
+                sizeof (uint8_t), blk.masks[f]) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to write to the mask file: %s",
+                    mask_files[f]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    /* Close the files and free the block buffers */
+    for (f = 0; f < nfields; f++)
+        close_raw_binary (fp_mask[f]);
+    close_raw_binary (fp_qa);
+    release_raw_binary_buffer (qa_buf);
+    release_raw_binary_buffer (mask_buf);
+
+    /* Successful decoding */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_qa_masks
+
+PURPOSE: Creates the mask bands of the selected fields of a QA band and sets
+up the band metadata for them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the mask bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The mask bands are named <QA band>_<field name> and the output
+     filenames are the product ID with _<mask band name>.img appended.  The
+     bitmap_description of each mask band has the description of its field
+     for each of its bits.
+  2. The band data and ENVI headers are written by this routine.  The bands
+     are returned in out_meta but are not added to the XML metadata; it is up
+     to the caller to append them to the XML file or the metadata structure.
+     The caller is responsible for calling free_metadata on out_meta.
+******************************************************************************/
+int create_qa_masks
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    char *qa_band,                   /* I: name of the QA band */
+    char *field_list,                /* I: comma-separated fields to be
+                                           expanded; NULL for all */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the mask bands;
+                                           global metadata is not valid */
+)
+{
+    char FUNC_NAME[] = "create_qa_masks";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    char *mask_files[QA_MAX_FIELDS];  /* output filename of each mask band */
+    int i;                       /* looping variable for the fields */
+    int bit;                     /* looping variable for the field bits */
+    int qa_indx;                 /* index of the QA band */
+    int nfields;                 /* number of selected fields */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* pointer to global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* QA band metadata */
+    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for the masks */
+    Qa_field_t fields[QA_MAX_FIELDS];  /* selected fields */
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    /* Find the QA band and the fields to be expanded */
+    qa_indx = find_band_metadata (xml_meta, NULL, qa_band, NULL);
+    if (qa_indx < 0)
+    {
+        sprintf (errmsg, "Band %s isn't in the XML file", qa_band);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    bmeta = &xml_meta->band[qa_indx];
+
+    if (bmeta->data_type != ESPA_UINT8 && bmeta->data_type != ESPA_UINT16)
+    {
+        sprintf (errmsg, "QA band %s must be 8-bit or 16-bit unsigned "
+            "integer data", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (select_qa_fields (bmeta, field_list, &nfields, fields) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Allocate memory for the output bands */
+    if (allocate_band_metadata (out_meta, nfields) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the mask bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the band metadata for each mask band */
+    for (i = 0; i < nfields; i++)
+    {
+        out_bmeta = &out_meta->band[i];
+        strcpy (out_bmeta->product, "qa_mask");
+        strcpy (out_bmeta->source, bmeta->source);
+        strcpy (out_bmeta->category, "qa");
+        out_bmeta->data_type = ESPA_UINT8;
+        snprintf (out_bmeta->name, sizeof (out_bmeta->name), "%s_%s",
+            bmeta->name, fields[i].name);
+        snprintf (out_bmeta->short_name, sizeof (out_bmeta->short_name),
+            "%.6sM%02d", bmeta->short_name, fields[i].shift);
+        snprintf (out_bmeta->long_name, sizeof (out_bmeta->long_name),
+            "%s mask from %s", fields[i].description, bmeta->name);
+        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name),
+            "%s_%s.img", gmeta->product_id, out_bmeta->name);
+        mask_files[i] = out_bmeta->file_name;
+
+        out_bmeta->resample_method = ESPA_NN;
+        out_bmeta->nlines = bmeta->nlines;
+        out_bmeta->nsamps = bmeta->nsamps;
+        if (bmeta->fill_value != ESPA_INT_META_FILL)
+            out_bmeta->fill_value = QA_MASK_FILL;
+        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+        strcpy (out_bmeta->data_units, "quality/feature classification");
+        out_bmeta->valid_range[0] = 0.0;
+        out_bmeta->valid_range[1] = (float) ((1 << fields[i].nbits) - 1);
+        sprintf (out_bmeta->app_version, "create_qa_masks_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (out_bmeta->production_date, production_date);
+
+        if (allocate_bitmap_metadata (out_bmeta, fields[i].nbits) != SUCCESS)
+        {
+            sprintf (errmsg, "Allocating the bitmap description of the mask "
+                "band %s", out_bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (bit = 0; bit < fields[i].nbits; bit++)
+            strcpy (out_bmeta->bitmap_description[bit],
+                fields[i].description);
+    }
+
+    /* Expand the fields from a single read of the QA band */
+    if (write_qa_masks (bmeta, nfields, fields, mask_files) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Write the ENVI header of each mask band */
+    for (i = 0; i < nfields; i++)
+    {
+        out_bmeta = &out_meta->band[i];
+        if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        sprintf (tmpstr, "%s", out_bmeta->file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
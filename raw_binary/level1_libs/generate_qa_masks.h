@@ -0,0 +1,102 @@
+/*****************************************************************************
+FILE: generate_qa_masks.h
+
+PURPOSE: Contains defines, structures and prototypes to expand the bit
+fields of a bit-packed QA band into separate 8-bit mask bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The fields of a QA band come from its bitmap_description.  Consecutive
+     bits with the same description form one field, such as the two bits of
+     the Landsat cloud confidence.  A field can also be given by its bits as
+     bit:<n> or bits:<first>-<last>, which doesn't need the descriptions.
+  2. Each mask pixel is the value of the field (0 to 2^nbits - 1), or
+     QA_MASK_FILL where the QA band is fill.
+*****************************************************************************/
+
+#ifndef GENERATE_QA_MASKS_H
+#define GENERATE_QA_MASKS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
+
+/* Defines */
+/* Number of lines decoded at a time, unless the node profile sets
+   line_block (see espa_tune.h) */
+#define QA_LINE_BLOCK 256
+
+/* Number of pixels each thread decodes at a time */
+#define QA_PIXEL_GRAIN 65536
+
+/* Largest number of fields of a QA band; one per bit of a 16-bit band */
+#define QA_MAX_FIELDS 16
+
+/* Largest number of bits in a field, so QA_MASK_FILL isn't a field value */
+#define QA_MAX_FIELD_BITS 7
+
+/* Value of the masks where the QA band is fill */
+#define QA_MASK_FILL 255
+
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
+
+/* Type definitions */
+/* Bit field of a QA band */
+typedef struct
+{
+    char name[STR_SIZE];         /* name of the field, used in the mask band
+                                    name */
+    char description[STR_SIZE];  /* description of the field */
+    int shift;                   /* first (lowest) bit of the field */
+    int nbits;                   /* number of bits in the field */
+} Qa_field_t;
+
+/* Prototypes */
+int get_qa_fields
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    int *nfields,              /* O: number of fields */
+    Qa_field_t *fields         /* O: fields of the QA band (QA_MAX_FIELDS) */
+);
+
+int select_qa_fields
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    char *field_list,          /* I: comma-separated field descriptions or
+                                     bit ranges; NULL for all the fields */
+    int *nfields,              /* O: number of selected fields */
+    Qa_field_t *fields         /* O: selected fields (QA_MAX_FIELDS) */
+);
+
+int write_qa_masks
+(
+    Espa_band_meta_t *bmeta,   /* I: QA band metadata */
+    int nfields,               /* I: number of fields */
+    Qa_field_t *fields,        /* I: fields to be expanded */
+    char **mask_files          /* I: output mask filename of each field */
+);
+
+int create_qa_masks
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    char *qa_band,                   /* I: name of the QA band */
+    char *field_list,                /* I: comma-separated fields to be
+                                           expanded; NULL for all */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the mask bands;
+                                           global metadata is not valid */
+);
+
+#endif
@@ -0,0 +1,1094 @@
+/*****************************************************************************
+FILE: generate_toa_bands.c
+
+PURPOSE: Contains functions to generate the top-of-atmosphere (TOA)
+reflectance and brightness temperature bands from the level 1 bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format written via this library follows the ESPA internal
+     metadata format found in ESPA Raw Binary Format v1.0.doc.  The schema for
+     the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+  2. The pixels are converted with SSE2 when it is available, 8 pixels at a
+     time, and one at a time otherwise and for the last pixels of a block.
+     Both use the same float operations, including the polynomial cosine
+     and logarithm below, so the output doesn't depend on which was used.
+*****************************************************************************/
+#include <unistd.h>
+#include <math.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "generate_toa_bands.h"
+#include "espa_memory.h"
+#include "espa_tune.h"
+#include "espa_task.h"
+#include "raw_binary_pool.h"
+#include "raw_binary_valid.h"
+
+/* Fill value and scale of the per-pixel solar zenith bands, as written by
+   create_angle_bands (see angle_bands.h) */
+#define TOA_ANGLE_FILL -9999
+#define TOA_ANGLE_RADIANS (float) (0.01 * M_PI / 180.0)
+
+/* Coefficients of the Taylor series of the cosine, accurate to 5e-7 over the
+   0 to 90 degree solar zenith angles */
+#define TOA_COS_C2 (float) (-1.0 / 2.0)
+#define TOA_COS_C4 (float) (1.0 / 24.0)
+#define TOA_COS_C6 (float) (-1.0 / 720.0)
+#define TOA_COS_C8 (float) (1.0 / 40320.0)
+#define TOA_COS_C10 (float) (-1.0 / 3628800.0)
+
+/* Coefficients of the series 2*atanh(t) of the logarithm of the mantissa,
+   accurate to 2e-8 since |t| <= 0.172 */
+#define TOA_LOG_C1 (float) 2.0
+#define TOA_LOG_C3 (float) (2.0 / 3.0)
+#define TOA_LOG_C5 (float) (2.0 / 5.0)
+#define TOA_LOG_C7 (float) (2.0 / 7.0)
+#define TOA_LOG_C9 (float) (2.0 / 9.0)
+#define TOA_LN2 (float) M_LN2
+#define TOA_SQRT2 (float) M_SQRT2
+
+/* Block of pixels converted by the chunks of espa_parallel_for */
+typedef struct
+{
+    const uint16_t *dn;     /* level 1 values of the block */
+    const int16_t *zenith;  /* solar zenith of each pixel of the block, or
+                               NULL to use cos_zenith */
+    int16_t *toa;           /* scaled TOA values of the block */
+    float gain;             /* gain from the level 1 value to the scaled
+                               reflectance, or to the radiance */
+    float bias;             /* bias from the level 1 value to the scaled
+                               reflectance, or to the radiance */
+    float cos_zenith;       /* cosine of the scene center solar zenith */
+    float k1;               /* K1 thermal constant */
+    float k2;               /* K2 thermal constant over the BT scale factor */
+    bool has_fill;          /* does the level 1 band have a fill value? */
+    uint16_t fill;          /* level 1 fill value */
+    uint16_t saturate;      /* level 1 saturated value */
+} Toa_block_t;
+
+/******************************************************************************
+MODULE:  toa_cos
+
+PURPOSE: Computes the cosine of an angle from 0 to pi/2 with a polynomial.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+cos(x)          Cosine of the angle
+
+NOTES:
+******************************************************************************/
+static inline float toa_cos
+(
+    float x                 /* I: angle (radians) */
+)
+{
+    float x2 = x * x;       /* square of the angle */
+
+    return (1.0f + x2 * (TOA_COS_C2 + x2 * (TOA_COS_C4 + x2 * (TOA_COS_C6
+        + x2 * (TOA_COS_C8 + x2 * TOA_COS_C10)))));
+}
+
+
+/******************************************************************************
+MODULE:  toa_log
+
+PURPOSE: Computes the natural logarithm of a positive number from its
+exponent and a polynomial of its mantissa.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+log(x)          Natural logarithm of the number
+
+NOTES:
+  1. The mantissa m is taken in [sqrt(2)/2, sqrt(2)) and its logarithm is
+     2*atanh((m-1)/(m+1)).  Zero, denormal, infinite and NaN values aren't
+     handled; the callers only pass values of at least 1.
+******************************************************************************/
+static inline float toa_log
+(
+    float x                 /* I: positive normal number */
+)
+{
+    int32_t bits;           /* bits of the number */
+    int32_t e;              /* exponent of the number */
+    float m;                /* mantissa of the number */
+    float t;                /* (m-1)/(m+1) */
+    float t2;               /* square of t */
+
+    memcpy (&bits, &x, sizeof (bits));
+    e = (bits >> 23) - 127;
+    bits = (bits & 0x7fffff) | 0x3f800000;
+    memcpy (&m, &bits, sizeof (m));
+    if (m > TOA_SQRT2)
+    {
+        m *= 0.5f;
+        e++;
+    }
+
+    t = (m - 1.0f) / (m + 1.0f);
+    t2 = t * t;
+    return ((float) e * TOA_LN2 + t * (TOA_LOG_C1 + t2 * (TOA_LOG_C3
+        + t2 * (TOA_LOG_C5 + t2 * (TOA_LOG_C7 + t2 * TOA_LOG_C9)))));
+}
+
+
+#ifdef __SSE2__
+/******************************************************************************
+MODULE:  toa_cos_ps
+
+PURPOSE: Computes the cosine of 4 angles from 0 to pi/2 as toa_cos does.
+
+RETURN VALUE:
+Type = __m128
+Value           Description
+-----           -----------
+cos(x)          Cosines of the angles
+
+NOTES:
+******************************************************************************/
+static inline __m128 toa_cos_ps
+(
+    __m128 x                /* I: angles (radians) */
+)
+{
+    __m128 x2 = _mm_mul_ps (x, x);  /* squares of the angles */
+    __m128 c;                       /* polynomial */
+
+    c = _mm_add_ps (_mm_set1_ps (TOA_COS_C8),
+        _mm_mul_ps (x2, _mm_set1_ps (TOA_COS_C10)));
+    c = _mm_add_ps (_mm_set1_ps (TOA_COS_C6), _mm_mul_ps (x2, c));
+    c = _mm_add_ps (_mm_set1_ps (TOA_COS_C4), _mm_mul_ps (x2, c));
+    c = _mm_add_ps (_mm_set1_ps (TOA_COS_C2), _mm_mul_ps (x2, c));
+    return (_mm_add_ps (_mm_set1_ps (1.0f), _mm_mul_ps (x2, c)));
+}
+
+
+/******************************************************************************
+MODULE:  toa_log_ps
+
+PURPOSE: Computes the natural logarithm of 4 positive numbers as toa_log
+does.
+
+RETURN VALUE:
+Type = __m128
+Value           Description
+-----           -----------
+log(x)          Natural logarithms of the numbers
+
+NOTES:
+  1. The mantissas above sqrt(2) are halved with a compare mask, and the
+     mask (-1 where true) is subtracted from the exponents.
+******************************************************************************/
+static inline __m128 toa_log_ps
+(
+    __m128 x                /* I: positive normal numbers */
+)
+{
+    __m128i bits = _mm_castps_si128 (x);  /* bits of the numbers */
+    __m128i e;              /* exponents of the numbers */
+    __m128 m;               /* mantissas of the numbers */
+    __m128 big;             /* mask of the mantissas above sqrt(2) */
+    __m128 t;               /* (m-1)/(m+1) */
+    __m128 t2;              /* squares of t */
+    __m128 p;               /* polynomial */
+
+    e = _mm_sub_epi32 (_mm_srli_epi32 (bits, 23), _mm_set1_epi32 (127));
+    m = _mm_castsi128_ps (_mm_or_si128 (_mm_and_si128 (bits,
+        _mm_set1_epi32 (0x7fffff)), _mm_set1_epi32 (0x3f800000)));
+    big = _mm_cmpgt_ps (m, _mm_set1_ps (TOA_SQRT2));
+    m = _mm_or_ps (_mm_and_ps (big, _mm_mul_ps (m, _mm_set1_ps (0.5f))),
+        _mm_andnot_ps (big, m));
+    e = _mm_sub_epi32 (e, _mm_castps_si128 (big));
+
+    t = _mm_div_ps (_mm_sub_ps (m, _mm_set1_ps (1.0f)),
+        _mm_add_ps (m, _mm_set1_ps (1.0f)));
+    t2 = _mm_mul_ps (t, t);
+    p = _mm_add_ps (_mm_set1_ps (TOA_LOG_C7),
+        _mm_mul_ps (t2, _mm_set1_ps (TOA_LOG_C9)));
+    p = _mm_add_ps (_mm_set1_ps (TOA_LOG_C5), _mm_mul_ps (t2, p));
+    p = _mm_add_ps (_mm_set1_ps (TOA_LOG_C3), _mm_mul_ps (t2, p));
+    p = _mm_mul_ps (t, _mm_add_ps (_mm_set1_ps (TOA_LOG_C1),
+        _mm_mul_ps (t2, p)));
+    return (_mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (e),
+        _mm_set1_ps (TOA_LN2)), p));
+}
+
+
+/******************************************************************************
+MODULE:  toa_pack_ps
+
+PURPOSE: Clamps 8 scaled TOA values to the valid range, rounds them to 16-bit
+integers and sets the fill and saturated pixels.
+
+RETURN VALUE:
+Type = __m128i
+Value           Description
+-----           -----------
+values          Output values of the 8 pixels
+
+NOTES:
+******************************************************************************/
+static inline __m128i toa_pack_ps
+(
+    __m128 lo,              /* I: scaled values of the first 4 pixels */
+    __m128 hi,              /* I: scaled values of the last 4 pixels */
+    float min,              /* I: lowest valid value */
+    float max,              /* I: highest valid value */
+    __m128i fill,           /* I: mask of the fill pixels */
+    __m128i sat             /* I: mask of the saturated pixels */
+)
+{
+    __m128i value;          /* rounded values */
+
+    lo = _mm_min_ps (_mm_max_ps (lo, _mm_set1_ps (min)), _mm_set1_ps (max));
+    hi = _mm_min_ps (_mm_max_ps (hi, _mm_set1_ps (min)), _mm_set1_ps (max));
+    value = _mm_packs_epi32 (_mm_cvtps_epi32 (lo), _mm_cvtps_epi32 (hi));
+
+    sat = _mm_andnot_si128 (fill, sat);
+    value = _mm_andnot_si128 (_mm_or_si128 (fill, sat), value);
+    return (_mm_or_si128 (value, _mm_or_si128 (
+        _mm_and_si128 (fill, _mm_set1_epi16 (TOA_BAND_FILL)),
+        _mm_and_si128 (sat, _mm_set1_epi16 (TOA_BAND_SATURATE)))));
+}
+#endif
+
+
+/******************************************************************************
+MODULE:  toa_round
+
+PURPOSE: Clamps a scaled TOA value to the valid range and rounds it to a
+16-bit integer.
+
+RETURN VALUE:
+Type = int16_t
+Value           Description
+-----           -----------
+value           Output value of the pixel
+
+NOTES:
+  1. lrintf rounds half to even in the default rounding mode, as SSE2 does.
+******************************************************************************/
+static inline int16_t toa_round
+(
+    float value,            /* I: scaled value */
+    float min,              /* I: lowest valid value */
+    float max               /* I: highest valid value */
+)
+{
+    if (value < min)
+        value = min;
+    else if (value > max)
+        value = max;
+    return ((int16_t) lrintf (value));
+}
+
+
+/******************************************************************************
+MODULE:  convert_refl_pixels
+
+PURPOSE: Converts a chunk of the pixels of a block from level 1 values to
+scaled TOA reflectance.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successful completion
+
+NOTES:
+  1. This is the Espa_range_func_t of the reflectance bands.
+  2. The reflectance is (gain * DN + bias) / cos(solar zenith), where the
+     gain and bias are the reflectance ones divided by the scale factor.
+******************************************************************************/
+static int convert_refl_pixels
+(
+    void *arg,              /* I: block of pixels (Toa_block_t *) */
+    int first,              /* I: first pixel of the chunk */
+    int end,                /* I: pixel after the last one of the chunk */
+    int runner              /* I: not used */
+)
+{
+    const Toa_block_t *blk = arg;  /* block of pixels */
+    int p = first;          /* looping variable for the pixels */
+    float cos_zenith;       /* cosine of the solar zenith of the pixel */
+    float refl;             /* scaled reflectance of the pixel */
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128 gain = _mm_set1_ps (blk->gain);
+    const __m128 bias = _mm_set1_ps (blk->bias);
+    const __m128 min_cos = _mm_set1_ps ((float) TOA_MIN_COS_ZENITH);
+    const __m128 radians = _mm_set1_ps (TOA_ANGLE_RADIANS);
+    __m128i dn;             /* level 1 values of 8 pixels */
+    __m128i angle;          /* scaled solar zenith of 8 pixels */
+    __m128i fill;           /* mask of the fill pixels */
+    __m128 lo, hi;          /* reflectance of the first and last 4 pixels */
+    __m128 cos_lo, cos_hi;  /* cosine of the solar zenith of the first and
+                               last 4 pixels */
+
+    cos_lo = cos_hi = _mm_set1_ps (blk->cos_zenith);
+    for (; p + 8 <= end; p += 8)
+    {
+        dn = _mm_loadu_si128 ((const __m128i *) &blk->dn[p]);
+        lo = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (dn, zero));
+        hi = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (dn, zero));
+        lo = _mm_add_ps (_mm_mul_ps (lo, gain), bias);
+        hi = _mm_add_ps (_mm_mul_ps (hi, gain), bias);
+
+        fill = zero;
+        if (blk->has_fill)
+            fill = _mm_cmpeq_epi16 (dn, _mm_set1_epi16 (blk->fill));
+
+        if (blk->zenith != NULL)
+        {
+            angle = _mm_loadu_si128 ((const __m128i *) &blk->zenith[p]);
+            fill = _mm_or_si128 (fill, _mm_cmpeq_epi16 (angle,
+                _mm_set1_epi16 (TOA_ANGLE_FILL)));
+            cos_lo = toa_cos_ps (_mm_mul_ps (_mm_cvtepi32_ps (_mm_srai_epi32
+                (_mm_unpacklo_epi16 (angle, angle), 16)), radians));
+            cos_hi = toa_cos_ps (_mm_mul_ps (_mm_cvtepi32_ps (_mm_srai_epi32
+                (_mm_unpackhi_epi16 (angle, angle), 16)), radians));
+            cos_lo = _mm_max_ps (cos_lo, min_cos);
+            cos_hi = _mm_max_ps (cos_hi, min_cos);
+        }
+
+        lo = _mm_div_ps (lo, cos_lo);
+        hi = _mm_div_ps (hi, cos_hi);
+        _mm_storeu_si128 ((__m128i *) &blk->toa[p], toa_pack_ps (lo, hi,
+            TOA_REFL_MIN, TOA_REFL_MAX, fill,
+            _mm_cmpeq_epi16 (dn, _mm_set1_epi16 (blk->saturate))));
+    }
+#endif
+
+    /* Remaining pixels */
+    for (; p < end; p++)
+    {
+        if (blk->has_fill && blk->dn[p] == blk->fill)
+        {
+            blk->toa[p] = TOA_BAND_FILL;
+            continue;
+        }
+
+        cos_zenith = blk->cos_zenith;
+        if (blk->zenith != NULL)
+        {
+            if (blk->zenith[p] == TOA_ANGLE_FILL)
+            {
+                blk->toa[p] = TOA_BAND_FILL;
+                continue;
+            }
+            cos_zenith = toa_cos ((float) blk->zenith[p] * TOA_ANGLE_RADIANS);
+            if (cos_zenith < (float) TOA_MIN_COS_ZENITH)
+                cos_zenith = (float) TOA_MIN_COS_ZENITH;
+        }
+
+        if (blk->dn[p] == blk->saturate)
+        {
+            blk->toa[p] = TOA_BAND_SATURATE;
+            continue;
+        }
+
+        refl = ((float) blk->dn[p] * blk->gain + blk->bias) / cos_zenith;
+        blk->toa[p] = toa_round (refl, TOA_REFL_MIN, TOA_REFL_MAX);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  convert_bt_pixels
+
+PURPOSE: Converts a chunk of the pixels of a block from level 1 values to
+scaled brightness temperature.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+SUCCESS         Successful completion
+
+NOTES:
+  1. This is the Espa_range_func_t of the thermal bands.
+  2. The radiance is L = gain * DN + bias, and the brightness temperature is
+     K2 / log(K1 / L + 1), where K2 is divided by the scale factor.  The
+     radiance is at least TOA_MIN_RADIANCE, so K1 / L + 1 is always at least
+     1 and its logarithm can use toa_log.
+******************************************************************************/
+static int convert_bt_pixels
+(
+    void *arg,              /* I: block of pixels (Toa_block_t *) */
+    int first,              /* I: first pixel of the chunk */
+    int end,                /* I: pixel after the last one of the chunk */
+    int runner              /* I: not used */
+)
+{
+    const Toa_block_t *blk = arg;  /* block of pixels */
+    int p = first;          /* looping variable for the pixels */
+    float rad;              /* radiance of the pixel */
+    float bt;               /* scaled brightness temperature of the pixel */
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128 gain = _mm_set1_ps (blk->gain);
+    const __m128 bias = _mm_set1_ps (blk->bias);
+    const __m128 min_rad = _mm_set1_ps ((float) TOA_MIN_RADIANCE);
+    const __m128 k1 = _mm_set1_ps (blk->k1);
+    const __m128 k2 = _mm_set1_ps (blk->k2);
+    const __m128 one = _mm_set1_ps (1.0f);
+    __m128i dn;             /* level 1 values of 8 pixels */
+    __m128i fill;           /* mask of the fill pixels */
+    __m128 lo, hi;          /* values of the first and last 4 pixels */
+
+    for (; p + 8 <= end; p += 8)
+    {
+        dn = _mm_loadu_si128 ((const __m128i *) &blk->dn[p]);
+        lo = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (dn, zero));
+        hi = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (dn, zero));
+        lo = _mm_max_ps (_mm_add_ps (_mm_mul_ps (lo, gain), bias), min_rad);
+        hi = _mm_max_ps (_mm_add_ps (_mm_mul_ps (hi, gain), bias), min_rad);
+        lo = _mm_div_ps (k2, toa_log_ps (_mm_add_ps (_mm_div_ps (k1, lo),
+            one)));
+        hi = _mm_div_ps (k2, toa_log_ps (_mm_add_ps (_mm_div_ps (k1, hi),
+            one)));
+
+        fill = zero;
+        if (blk->has_fill)
+            fill = _mm_cmpeq_epi16 (dn, _mm_set1_epi16 (blk->fill));
+        _mm_storeu_si128 ((__m128i *) &blk->toa[p], toa_pack_ps (lo, hi,
+            TOA_BT_MIN, TOA_BT_MAX, fill,
+            _mm_cmpeq_epi16 (dn, _mm_set1_epi16 (blk->saturate))));
+    }
+#endif
+
+    /* Remaining pixels */
+    for (; p < end; p++)
+    {
+        if (blk->has_fill && blk->dn[p] == blk->fill)
+            blk->toa[p] = TOA_BAND_FILL;
+        else if (blk->dn[p] == blk->saturate)
+            blk->toa[p] = TOA_BAND_SATURATE;
+        else
+        {
+            rad = (float) blk->dn[p] * blk->gain + blk->bias;
+            if (rad < (float) TOA_MIN_RADIANCE)
+                rad = (float) TOA_MIN_RADIANCE;
+            bt = blk->k2 / toa_log (blk->k1 / rad + 1.0f);
+            blk->toa[p] = toa_round (bt, TOA_BT_MIN, TOA_BT_MAX);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_solar_zenith_band
+
+PURPOSE: Finds the per-pixel solar zenith band to use for the reflectance of
+a level 1 band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              There is no usable solar zenith band
+other           Index of the solar zenith band in the XML metadata
+
+NOTES:
+  1. The solar zenith band of the level 1 band (solar_zenith_band<n> for
+     band<n>) is used, or else the average one (avg_solar_zenith_band).  It
+     must be 16-bit and, at full resolution, the size of the level 1 band;
+     sub-sampled bands are upsampled as they're read.
+******************************************************************************/
+static int find_solar_zenith_band
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    Espa_band_meta_t *bmeta          /* I: level 1 band metadata */
+)
+{
+    char name[STR_SIZE];    /* name of the solar zenith band */
+    int indx;               /* index of the solar zenith band */
+    Espa_band_meta_t *zmeta = NULL;  /* solar zenith band metadata */
+
+    snprintf (name, sizeof (name), "solar_zenith_%s", bmeta->name);
+    indx = find_band_metadata (xml_meta, NULL, name, NULL);
+    if (indx < 0)
+        indx = find_band_metadata (xml_meta, NULL, "avg_solar_zenith_band",
+            NULL);
+    if (indx < 0)
+        return (-1);
+
+    zmeta = &xml_meta->band[indx];
+    if (zmeta->data_type != ESPA_INT16)
+        return (-1);
+    if (zmeta->sub_sample.factor > 1)
+    {
+        if (zmeta->sub_sample.nlines != bmeta->nlines ||
+            zmeta->sub_sample.nsamps != bmeta->nsamps)
+            return (-1);
+    }
+    else if (zmeta->nlines != bmeta->nlines || zmeta->nsamps != bmeta->nsamps)
+        return (-1);
+
+    return (indx);
+}
+
+
+/******************************************************************************
+MODULE:  write_toa_band
+
+PURPOSE: Converts a level 1 band to TOA reflectance or brightness temperature
+and writes it, a block of lines at a time.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the TOA band
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The level 1 band must be 8-bit or 16-bit unsigned data.  8-bit values
+     are widened to 16 bits so one set of kernels handles both.
+  2. The reflectance uses the per-pixel solar zenith band when the scene has
+     one (see find_solar_zenith_band), and the scene center solar zenith
+     otherwise.  The reflectance gain and bias from the MTL file already
+     include the earth-sun distance, so it isn't applied again.
+  3. Each block is read and written by the calling thread; its pixels are
+     converted in chunks by the task pool (see espa_task.h).
+  4. If the scene has a valid mask (see raw_binary_valid.h), only the pixels
+     within the extent of the valid pixels of each block are converted, and
+     the blocks which are all fill are written as fill without reading
+     them.
+******************************************************************************/
+int write_toa_band
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int band_indx,                   /* I: index of the level 1 band */
+    bool thermal,                    /* I: write the brightness temperature
+                                           instead of the reflectance? */
+    char *toa_file                   /* I: output TOA filename */
+)
+{
+    char FUNC_NAME[] = "write_toa_band";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    int i;                      /* looping variable for the pixels */
+    int line;                   /* current line in the band */
+    int block_lines;            /* number of lines in a full block */
+    int nblock_lines;           /* number of lines in the current block */
+    int nlines;                 /* number of lines in the band */
+    int nsamps;                 /* number of samples in the band */
+    int npix;                   /* number of pixels in the current block */
+    int nthreads;               /* number of threads converting the pixels */
+    int zenith_indx = -1;       /* index of the solar zenith band */
+    long first;                 /* first valid pixel of the current block */
+    long end;                   /* pixel after the last valid pixel of the
+                                   current block */
+    size_t line_bytes;          /* bytes needed for each line of a block */
+    uint8_t *raw_buf = NULL;    /* block of 8-bit level 1 values */
+    uint16_t *dn_buf = NULL;    /* block of level 1 values */
+    int16_t *zenith_buf = NULL; /* block of solar zenith values */
+    int16_t *toa_buf = NULL;    /* block of TOA values */
+    FILE *fp_dn = NULL;         /* level 1 band file pointer */
+    FILE *fp_zenith = NULL;     /* solar zenith band file pointer */
+    FILE *fp_toa = NULL;        /* output TOA file pointer */
+    Espa_band_meta_t *bmeta = &xml_meta->band[band_indx];  /* level 1 band
+                                                              metadata */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* global metadata */
+    Espa_range_func_t convert = NULL;  /* converts a chunk of pixels */
+    Toa_block_t blk;            /* block of pixels being converted */
+    Raw_binary_valid_t *valid = NULL;  /* valid mask of the scene */
+
+    nlines = bmeta->nlines;
+    nsamps = bmeta->nsamps;
+    if (bmeta->data_type != ESPA_UINT8 && bmeta->data_type != ESPA_UINT16)
+    {
+        sprintf (errmsg, "Level 1 band %s must be 8-bit or 16-bit unsigned "
+            "integer data", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the conversion of the pixels */
+    memset (&blk, 0, sizeof (blk));
+    blk.has_fill = bmeta->fill_value != ESPA_INT_META_FILL;
+    blk.fill = (uint16_t) bmeta->fill_value;
+    if (bmeta->saturate_value != ESPA_INT_META_FILL)
+        blk.saturate = (uint16_t) bmeta->saturate_value;
+    else if (bmeta->data_type == ESPA_UINT8)
+        blk.saturate = UINT8_MAX;
+    else
+        blk.saturate = UINT16_MAX;
+
+    if (thermal)
+    {
+        blk.gain = (float) bmeta->rad_gain;
+        blk.bias = (float) bmeta->rad_bias;
+        blk.k1 = (float) bmeta->k1_const;
+        blk.k2 = (float) (bmeta->k2_const / TOA_BT_SCALE_FACT);
+        convert = convert_bt_pixels;
+    }
+    else
+    {
+        blk.gain = (float) (bmeta->refl_gain / TOA_REFL_SCALE_FACT);
+        blk.bias = (float) (bmeta->refl_bias / TOA_REFL_SCALE_FACT);
+        convert = convert_refl_pixels;
+
+        zenith_indx = find_solar_zenith_band (xml_meta, bmeta);
+        if (zenith_indx < 0)
+        {
+            if (fabs (gmeta->solar_zenith - ESPA_FLOAT_META_FILL) <
+                ESPA_EPSILON)
+            {
+                sprintf (errmsg, "There is no solar zenith band or scene "
+                    "center solar zenith for the reflectance of band %s",
+                    bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            blk.cos_zenith = (float) cos (gmeta->solar_zenith * M_PI / 180.0);
+            if (blk.cos_zenith < (float) TOA_MIN_COS_ZENITH)
+                blk.cos_zenith = (float) TOA_MIN_COS_ZENITH;
+        }
+    }
+
+    /* Allocate a block of lines for the level 1 values, the solar zenith
+       and the TOA values */
+    line_bytes = (size_t) nsamps * (sizeof (uint16_t) + sizeof (int16_t));
+    if (bmeta->data_type == ESPA_UINT8)
+        line_bytes += nsamps * sizeof (uint8_t);
+    if (zenith_indx >= 0)
+        line_bytes += nsamps * sizeof (int16_t);
+    block_lines = espa_budget_lines (line_bytes, 0,
+        espa_tune_line_block (TOA_LINE_BLOCK));
+
+    dn_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+        sizeof (uint16_t), false);
+    toa_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+        sizeof (int16_t), false);
+    if (dn_buf == NULL || toa_buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the TOA band containing %d "
+            "lines x %d samples.", block_lines, nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (bmeta->data_type == ESPA_UINT8)
+    {
+        raw_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+            sizeof (uint8_t), false);
+        if (raw_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the level 1 band "
+                "containing %d lines x %d samples.", block_lines, nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Open the input and output files */
+    fp_dn = open_raw_binary (bmeta->file_name, "rb");
+    if (fp_dn == NULL)
+    {
+        sprintf (errmsg, "Opening the level 1 band file: %s",
+            bmeta->file_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (zenith_indx >= 0)
+    {
+        zenith_buf = get_raw_binary_buffer ((size_t) block_lines * nsamps *
+            sizeof (int16_t), false);
+        if (zenith_buf == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the solar zenith band "
+                "containing %d lines x %d samples.", block_lines, nsamps);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        fp_zenith = open_raw_binary (xml_meta->band[zenith_indx].file_name,
+            "rb");
+        if (fp_zenith == NULL)
+        {
+            sprintf (errmsg, "Opening the solar zenith band file: %s",
+                xml_meta->band[zenith_indx].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    fp_toa = open_raw_binary (toa_file, "wb");
+    if (fp_toa == NULL)
+    {
+        sprintf (errmsg, "Unable to open the TOA file: %s", toa_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Use the valid mask of the scene to skip the fill pixels */
+    valid = open_scene_valid_mask (xml_meta, bmeta);
+
+    /* Loop through the lines a block at a time, converting the pixels of
+       each block in chunks */
+    nthreads = espa_task_nthreads ();
+    blk.dn = dn_buf;
+    blk.zenith = zenith_buf;
+    blk.toa = toa_buf;
+    for (line = 0; line < nlines; line += block_lines)
+    {
+        nblock_lines = block_lines;
+        if (line + nblock_lines > nlines)
+            nblock_lines = nlines - line;
+        npix = nblock_lines * nsamps;
+
+        /* Find the extent of the valid pixels of the block */
+        first = 0;
+        end = npix;
+        if (valid != NULL && !get_raw_binary_valid_extent (valid, line,
+            nblock_lines, &first, &end))
+        {
+            /* The block is all fill, so skip its level 1 values */
+            for (i = 0; i < npix; i++)
+                toa_buf[i] = TOA_BAND_FILL;
+            if (fseeko (fp_dn, (off_t) npix * (raw_buf != NULL ?
+                sizeof (uint8_t) : sizeof (uint16_t)), SEEK_CUR) != 0)
+            {
+                sprintf (errmsg, "Skipping lines %d-%d of band %s", line,
+                    line + nblock_lines - 1, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (raw_buf != NULL)
+        {
+            if (read_raw_binary (fp_dn, nblock_lines, nsamps,
+                sizeof (uint8_t), raw_buf) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading lines %d-%d of band %s", line,
+                    line + nblock_lines - 1, bmeta->name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            for (i = first; i < end; i++)
+                dn_buf[i] = raw_buf[i];
+        }
+        else if (read_raw_binary (fp_dn, nblock_lines, nsamps,
+            sizeof (uint16_t), dn_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of band %s", line,
+                line + nblock_lines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (first < end && fp_zenith != NULL && read_raw_binary_upsampled (
+            fp_zenith, &xml_meta->band[zenith_indx], line, 0, nblock_lines,
+            nsamps, zenith_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading lines %d-%d of the solar zenith band "
+                "for band %s", line, line + nblock_lines - 1, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Convert the valid extent of the block, and set the pixels
+           outside it to fill; the chunk functions can't fail */
+        if (first < end)
+        {
+            for (i = 0; i < first; i++)
+                toa_buf[i] = TOA_BAND_FILL;
+            for (i = end; i < npix; i++)
+                toa_buf[i] = TOA_BAND_FILL;
+            espa_parallel_for (first, end, TOA_PIXEL_GRAIN, nthreads, convert,
+                &blk);
+        }
+
+        if (write_raw_binary (fp_toa, nblock_lines, nsamps, sizeof (int16_t),
+            toa_buf) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the TOA file: %s", toa_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Close the files and free the block buffers */
+    close_raw_binary (fp_toa);
+    close_raw_binary (fp_dn);
+    close_raw_binary_valid (valid);
+    if (fp_zenith != NULL)
+        close_raw_binary (fp_zenith);
+    release_raw_binary_buffer (raw_buf);
+    release_raw_binary_buffer (dn_buf);
+    release_raw_binary_buffer (zenith_buf);
+    release_raw_binary_buffer (toa_buf);
+
+    /* Successful conversion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  toa_band_type
+
+PURPOSE: Determines which TOA band, if any, is generated for a band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              No TOA band is generated for the band
+0               The TOA reflectance is generated for the band
+1               The brightness temperature is generated for the band
+
+NOTES:
+  1. TOA bands are generated for the level 1 image bands (band<n>) of 8-bit
+     or 16-bit unsigned data which have the needed gains and constants.
+******************************************************************************/
+static int toa_band_type
+(
+    Espa_band_meta_t *bmeta          /* I: band metadata */
+)
+{
+    if (strcmp (bmeta->source, "level1") || strcmp (bmeta->category, "image")
+        || strncmp (bmeta->name, "band", 4) ||
+        (bmeta->data_type != ESPA_UINT8 && bmeta->data_type != ESPA_UINT16))
+        return (-1);
+
+    if (fabs (bmeta->refl_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->refl_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        return (0);
+
+    if (fabs (bmeta->rad_gain - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->rad_bias - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->k1_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON &&
+        fabs (bmeta->k2_const - ESPA_FLOAT_META_FILL) > ESPA_EPSILON)
+        return (1);
+
+    return (-1);
+}
+
+
+/******************************************************************************
+MODULE:  create_toa_bands
+
+PURPOSE: Creates the TOA reflectance and brightness temperature bands for the
+current scene and sets up the band metadata for them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the TOA bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output filenames are the product ID with _toa_band<n>.img appended
+     for the reflectance of band<n> and _bt_band<n>.img for the brightness
+     temperature.
+  2. The band data and ENVI headers are written by this routine.  The bands
+     are returned in out_meta but are not added to the XML metadata; it is up
+     to the caller to append them to the XML file or the metadata structure.
+     The caller is responsible for calling free_metadata on out_meta.
+******************************************************************************/
+int create_toa_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the TOA bands; global
+                                           metadata is not valid */
+)
+{
+    char FUNC_NAME[] = "create_toa_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary filename */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    int i;                       /* looping variable */
+    int nout;                    /* number of TOA bands */
+    int type;                    /* type of TOA band for the current band */
+    int *band_indx = NULL;       /* index of the level 1 band of each TOA
+                                    band */
+    time_t tp;                   /* time structure */
+    struct tm *tm = NULL;        /* time structure for UTC time */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    Espa_global_meta_t *gmeta = &xml_meta->global;  /* pointer to global
+                                                       metadata structure */
+    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
+    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for bands */
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    /* Count the level 1 bands which have TOA bands */
+    nout = 0;
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        if (toa_band_type (&xml_meta->band[i]) >= 0)
+            nout++;
+    }
+
+    if (nout == 0)
+    {
+        sprintf (errmsg, "No level 1 image bands have the reflectance gain "
+            "and bias or the thermal constants for the TOA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Allocate memory for the output bands */
+    if (allocate_band_metadata (out_meta, nout) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the TOA bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    band_indx = malloc (nout * sizeof (int));
+    if (band_indx == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the TOA band indexes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (band_indx);
+        return (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (band_indx);
+        return (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (band_indx);
+        return (ERROR);
+    }
+
+    /* Set up the band metadata for each TOA band */
+    nout = 0;
+    for (i = 0; i < xml_meta->nbands; i++)
+    {
+        bmeta = &xml_meta->band[i];
+        type = toa_band_type (bmeta);
+        if (type < 0)
+            continue;
+
+        band_indx[nout] = i;
+        out_bmeta = &out_meta->band[nout++];
+        strcpy (out_bmeta->source, "level1");
+        strcpy (out_bmeta->category, "image");
+        out_bmeta->data_type = ESPA_INT16;
+
+        /* The band number follows "band" in the level 1 band name */
+        if (type == 0)
+        {
+            strcpy (out_bmeta->product, "toa_refl");
+            snprintf (out_bmeta->name, sizeof (out_bmeta->name), "toa_%s",
+                bmeta->name);
+            snprintf (out_bmeta->short_name, sizeof (out_bmeta->short_name),
+                "%.3sTOA%s", bmeta->short_name, &bmeta->name[4]);
+            snprintf (out_bmeta->long_name, sizeof (out_bmeta->long_name),
+                "band %s top-of-atmosphere reflectance", &bmeta->name[4]);
+            strcpy (out_bmeta->data_units, "reflectance");
+            out_bmeta->scale_factor = TOA_REFL_SCALE_FACT;
+            out_bmeta->valid_range[0] = TOA_REFL_MIN;
+            out_bmeta->valid_range[1] = TOA_REFL_MAX;
+        }
+        else
+        {
+            strcpy (out_bmeta->product, "toa_bt");
+            snprintf (out_bmeta->name, sizeof (out_bmeta->name), "bt_%s",
+                bmeta->name);
+            snprintf (out_bmeta->short_name, sizeof (out_bmeta->short_name),
+                "%.3sBT%s", bmeta->short_name, &bmeta->name[4]);
+            snprintf (out_bmeta->long_name, sizeof (out_bmeta->long_name),
+                "band %s top-of-atmosphere brightness temperature",
+                &bmeta->name[4]);
+            strcpy (out_bmeta->data_units, "temperature (kelvin)");
+            out_bmeta->scale_factor = TOA_BT_SCALE_FACT;
+            out_bmeta->valid_range[0] = TOA_BT_MIN;
+            out_bmeta->valid_range[1] = TOA_BT_MAX;
+        }
+
+        /* Use the product name to create the TOA filename */
+        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name),
+            "%s_%s.img", gmeta->product_id, out_bmeta->name);
+
+        out_bmeta->resample_method = bmeta->resample_method;
+        out_bmeta->nlines = bmeta->nlines;
+        out_bmeta->nsamps = bmeta->nsamps;
+        out_bmeta->fill_value = TOA_BAND_FILL;
+        out_bmeta->saturate_value = TOA_BAND_SATURATE;
+        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
+        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
+        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
+        sprintf (out_bmeta->app_version, "create_toa_bands_%s",
+            ESPA_COMMON_VERSION);
+        strcpy (out_bmeta->production_date, production_date);
+    }
+
+    /* Generate each TOA band and write its ENVI header */
+    for (i = 0; i < nout; i++)
+    {
+        out_bmeta = &out_meta->band[i];
+        if (write_toa_band (xml_meta, band_indx[i],
+            !strcmp (out_bmeta->product, "toa_bt"), out_bmeta->file_name)
+            != SUCCESS)
+        {  /* Error messages already written */
+            free (band_indx);
+            return (ERROR);
+        }
+
+        /* Create the ENVI header using the TOA band */
+        if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (band_indx);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header */
+        sprintf (tmpstr, "%s", out_bmeta->file_name);
+        sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
+        if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (band_indx);
+            return (ERROR);
+        }
+    }
+
+    /* Successful completion */
+    free (band_indx);
+    return (SUCCESS);
+}
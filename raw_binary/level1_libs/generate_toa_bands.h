@@ -0,0 +1,84 @@
+/*****************************************************************************
+FILE: generate_toa_bands
+  
+PURPOSE: Contains defines and prototypes to generate the top-of-atmosphere
+(TOA) reflectance and brightness temperature bands from the level 1 bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The reflectance is generated for each level 1 image band with a
+     reflectance gain and bias, and the brightness temperature for each one
+     with a radiance gain and bias and the thermal K1 and K2 constants.
+  2. The bands are written as scaled 16-bit integers with the scale factors,
+     fill, saturation and valid range values defined below.
+*****************************************************************************/
+
+#ifndef GENERATE_TOA_BANDS_H
+#define GENERATE_TOA_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "envi_header.h"
+
+/* Defines */
+/* Number of lines converted at a time, unless the node profile sets
+   line_block (see espa_tune.h) */
+#define TOA_LINE_BLOCK 256
+
+/* Number of pixels each thread converts at a time */
+#define TOA_PIXEL_GRAIN 65536
+
+/* Values of the TOA bands for fill and saturated pixels */
+#define TOA_BAND_FILL -9999
+#define TOA_BAND_SATURATE 20000
+
+/* Scale factors and valid ranges of the scaled reflectance and brightness
+   temperature (kelvin) */
+#define TOA_REFL_SCALE_FACT 0.0001
+#define TOA_REFL_MIN -2000
+#define TOA_REFL_MAX 16000
+#define TOA_BT_SCALE_FACT 0.1
+#define TOA_BT_MIN 1500
+#define TOA_BT_MAX 3500
+
+/* Smallest cosine of the solar zenith used for the reflectance, so the
+   pixels with the sun at the horizon stay finite */
+#define TOA_MIN_COS_ZENITH 0.01
+
+/* Smallest radiance used for the brightness temperature, so the logarithm
+   stays finite */
+#define TOA_MIN_RADIANCE 0.000001
+
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
+
+/* Prototypes */
+int write_toa_band
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    int band_indx,                   /* I: index of the level 1 band */
+    bool thermal,                    /* I: write the brightness temperature
+                                           instead of the reflectance? */
+    char *toa_file                   /* I: output TOA filename */
+);
+
+int create_toa_bands
+(
+    Espa_internal_meta_t *xml_meta,  /* I: input XML metadata */
+    Espa_internal_meta_t *out_meta   /* O: metadata for the TOA bands; global
+                                           metadata is not valid */
+);
+
+#endif
@@ -0,0 +1,848 @@
+/*****************************************************************************
+FILE: angle_bands.c
+
+PURPOSE: Creates the Landsat solar and view/satellite per-pixel angle bands.
+Both the zenith and azimuth angles are created for each angle type for each
+Landsat band or for the average of the Landsat reflective bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include "angle_bands.h"
+#include "espa_alloc.h"
+#include "derived_cache.h"
+
+/* Writers for the angle bands of each input band, which are fed a block of
+   lines at a time by l8_per_pixel_angles_lines */
+typedef struct
+{
+    Espa_internal_meta_t *out_meta; /* metadata for the angle bands, with
+                                       NANGLE_BANDS bands per input band */
+    Raw_binary_cache_t cache;       /* page cache handling for the output */
+    Raw_binary_codec_t codec;       /* compression of the output bands */
+    bool band_stats;                /* compute the band statistics? */
+    bool band_checksum;             /* compute the band file checksums? */
+    Raw_binary_writer_t rbw[L8_NBANDS][NANGLE_BANDS]; /* writer for each
+                                       angle band */
+    bool open[L8_NBANDS][NANGLE_BANDS]; /* is the writer open? */
+    bool written[L8_NBANDS];        /* have all the lines of the input band
+                                       been written? */
+} Angle_band_writers_t;
+
+
+/******************************************************************************
+MODULE:  write_angle_band_lines
+
+PURPOSE: Writes a block of angle lines of an input band to its solar and
+sensor angle bands.  This is the line sink for l8_per_pixel_angles_lines.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the angle bands
+SUCCESS         No errors encountered
+
+NOTES:
+1. The angle band files are opened with the first block of the band and
+   closed with the last one.  The size of the band is set in the band
+   metadata when it's opened.
+******************************************************************************/
+static int write_angle_band_lines
+(
+    void *sink_data,          /* I/O: angle band writers */
+    int band_index,           /* I: index of the input band */
+    int band_lines,           /* I: number of lines in the band */
+    int first_line,           /* I: first line of the block */
+    int num_lines,            /* I: number of lines in the block */
+    int num_samps,            /* I: number of samples in each line */
+    const short *solar_zenith,  /* I: solar zenith angles for the block */
+    const short *solar_azimuth, /* I: solar azimuth angles for the block */
+    const short *sat_zenith,  /* I: satellite zenith angles for the block */
+    const short *sat_azimuth  /* I: satellite azimuth angles for the block */
+)
+{
+    char FUNC_NAME[] = "write_angle_band_lines";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Angle_band_writers_t *abw = sink_data;  /* angle band writers */
+    const short *angles[NANGLE_BANDS];  /* angles for the block, in the
+                                           angle band order */
+    Angle_band_t ang;            /* looping variable for solar/senor angle */
+    Raw_binary_writer_t *rbw = NULL;  /* writer for the current angle band */
+    Espa_band_meta_t *out_bmeta = NULL;  /* metadata for the current angle
+                                            band */
+
+    angles[SOLAR_ZEN] = solar_zenith;
+    angles[SOLAR_AZ] = solar_azimuth;
+    angles[SENSOR_ZEN] = sat_zenith;
+    angles[SENSOR_AZ] = sat_azimuth;
+
+    for (ang = 0; ang < NANGLE_BANDS; ang++)
+    {
+        out_bmeta = &abw->out_meta->band[band_index*NANGLE_BANDS + ang];
+        rbw = &abw->rbw[band_index][ang];
+        if (angles[ang] == NULL)
+        {
+            sprintf (errmsg, "Missing angles for %s", out_bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Open the output file for this band with its first block */
+        if (first_line == 0)
+        {
+            out_bmeta->nlines = band_lines;
+            out_bmeta->nsamps = num_samps;
+            if (open_raw_binary_writer (out_bmeta->file_name, abw->cache,
+                abw->codec, rbw) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to open the %s file",
+                    out_bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            abw->open[band_index][ang] = true;
+            if (abw->band_stats &&
+                attach_raw_binary_stats (rbw, out_bmeta) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to compute the statistics of the %s "
+                    "band", out_bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (abw->band_checksum)
+                attach_raw_binary_checksum (rbw, out_bmeta);
+
+            /* Write the blocks while the next ones are computed */
+            if (start_raw_binary_writer_background (rbw, 2) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to start writing the %s file",
+                    out_bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        /* Write the block of lines */
+        if (write_raw_binary_writer (rbw, num_lines, num_samps,
+            sizeof (short), (void *) angles[ang]) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write to the %s file",
+                out_bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Close the file for this band with its last block */
+        if (first_line + num_lines == band_lines)
+        {
+            abw->open[band_index][ang] = false;
+            if (close_raw_binary_writer (rbw) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to close the %s file",
+                    out_bmeta->file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+
+    if (first_line + num_lines == band_lines)
+        abw->written[band_index] = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  close_angle_band_writers
+
+PURPOSE: Closes the angle band writers left open after an error.
+
+RETURN VALUE:
+Type = None
+******************************************************************************/
+static void close_angle_band_writers
+(
+    Angle_band_writers_t *abw    /* I/O: angle band writers */
+)
+{
+    int i;                       /* looping variable for input bands */
+    Angle_band_t ang;            /* looping variable for solar/senor angle */
+
+    for (i = 0; i < L8_NBANDS; i++)
+    {
+        for (ang = 0; ang < NANGLE_BANDS; ang++)
+        {
+            if (abw->open[i][ang])
+            {
+                close_raw_binary_writer (&abw->rbw[i][ang]);
+                abw->open[i][ang] = false;
+            }
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  get_angle_cache_key
+
+PURPOSE: Builds the derived band cache key of the angle bands from everything
+they depend on: the angle coefficient file, the DEM, the options of the
+angle bands, and how the bands are written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the angle coefficient file or the DEM
+SUCCESS         Successfully built the key
+
+NOTES:
+1. Verifying the angle grid and the number of threads don't change the
+   angles, so they aren't part of the key.
+******************************************************************************/
+static int get_angle_cache_key
+(
+    char *ang_infile,     /* I: angle coefficient filename */
+    Espa_global_meta_t *gmeta, /* I: global metadata of the scene */
+    bool band_avg,        /* I: is the reflectance band average processed? */
+    int sub_sample,       /* I: sub-sampling factor of the angle bands */
+    int grid_spacing,     /* I: spacing of the exactly evaluated angle grid */
+    double max_grid_error, /* I: maximum angle grid interpolation error */
+    bool share_bands,     /* I: are the angles shared between bands? */
+    char *dem_file,       /* I: DEM of the terrain height, or NULL */
+    Raw_binary_codec_t codec, /* I: compression of the output bands */
+    bool band_stats,      /* I: are the band statistics computed? */
+    bool band_checksum,   /* I: are the band file checksums computed? */
+    Derived_cache_key_t *key  /* O: cache key of the angle bands */
+)
+{
+    bool use_dem = (dem_file != NULL);  /* is a DEM used? */
+
+    init_derived_cache_key (key, "angle_bands");
+    if (add_derived_cache_file (key, ang_infile) != SUCCESS)
+        return (ERROR);
+    add_derived_cache_string (key, gmeta->instrument);
+    add_derived_cache_bytes (key, &band_avg, sizeof (band_avg));
+    add_derived_cache_bytes (key, &sub_sample, sizeof (sub_sample));
+    add_derived_cache_bytes (key, &grid_spacing, sizeof (grid_spacing));
+    add_derived_cache_bytes (key, &max_grid_error, sizeof (max_grid_error));
+    add_derived_cache_bytes (key, &share_bands, sizeof (share_bands));
+    add_derived_cache_bytes (key, &use_dem, sizeof (use_dem));
+    if (use_dem && add_derived_cache_file (key, dem_file) != SUCCESS)
+        return (ERROR);
+    add_derived_cache_bytes (key, &codec, sizeof (codec));
+    add_derived_cache_bytes (key, &band_stats, sizeof (band_stats));
+    add_derived_cache_bytes (key, &band_checksum, sizeof (band_checksum));
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_angle_bands
+
+PURPOSE: Creates the Landsat solar and view/satellite per-pixel angles.  Both
+the zenith and azimuth angles are created for each angle type for each
+band.  An option is supported to write the average of the reflectance bands for
+each angle instead of writing the angle for each band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the angle bands
+SUCCESS         No errors encountered
+
+NOTES:
+1. Angles are written in degrees and scaled by 100.
+2. There are 4 bands written per input band (or average): solar zenith, solar
+   azimuth, sensor zenith, sensor azimuth.
+3. The angle coefficient file is the XML filename with the extension replaced
+   by _ANG.txt, and the output bands use the XML filename (without extension)
+   as their base name.
+4. The band data and ENVI headers are written by this routine.  The bands are
+   returned in out_meta but are not added to the XML metadata; it is up to the
+   caller to append them to the XML file or the metadata structure.  The
+   caller is responsible for calling free_metadata on out_meta.
+5. The per-band angles are written a block of lines at a time as they are
+   generated (see l8_per_pixel_angles_lines), so only a block of each band
+   is held in memory rather than every angle of every band.
+6. The angle bands are written once and not read again by this application,
+   so the page cache handling of the output files follows the
+   ESPA_WRITE_CACHE environment variable (see get_raw_binary_cache_mode).
+7. The angle bands compress well, so they are written as compressed
+   (chunked) bands if requested via the ESPA_ANGLE_CODEC or ESPA_BAND_CODEC
+   environment variables (see get_raw_binary_angle_codec).  The delta codec,
+   used by default when the other bands are compressed, suits the smooth
+   16-bit angles best.
+8. The statistics of the angle bands are computed while they're written, if
+   requested via the ESPA_BAND_STATS environment variable (see
+   use_raw_binary_stats), and stored in the band metadata of out_meta.
+   Likewise for the CRC32C checksums of the band files, via the
+   ESPA_BAND_CHECKSUM environment variable (see use_raw_binary_checksum).
+9. If a DEM is specified, the per-band angles are evaluated at the terrain
+   height of each pixel (see l8_angles_open_dem).  The reflectance band
+   average is always evaluated at zero height.
+10. With a sub-sampling factor of n, every nth line and sample is written and
+   the bands are tagged with their sub-sampling and full resolution size in
+   out_meta, so read_raw_binary_upsampled can interpolate them back to full
+   resolution.  The pixel size is n times that of the input band, which keeps
+   the first pixel centered on the first full resolution pixel.
+11. If the ESPA_DERIVED_CACHE environment variable names a cache (see
+   derived_cache.h), the bands of an earlier run on the same angle
+   coefficient file, DEM and options are restored from it rather than
+   generated, and generated bands are added to it.
+12. The ENVI headers of the bands are collected in memory and written
+   together once all the bands are done (see flush_envi_hdr_batch), rather
+   than as a separate file create and write for each band.
+******************************************************************************/
+int create_angle_bands
+(
+    char *xml_infile,     /* I: input XML filename, used for the angle
+                                coefficient and output band filenames */
+    Espa_internal_meta_t *xml_metadata, /* I: input XML metadata */
+    bool band_avg,        /* I: should the reflectance band average be
+                                processed? */
+    int sub_sample,       /* I: sub-sampling factor of the angle bands
+                                (1 = full resolution) */
+    int grid_spacing,     /* I: spacing of the exactly evaluated angle grid */
+    double max_grid_error, /* I: maximum angle grid interpolation error
+                                 (degrees) */
+    bool verify_grid,     /* I: should the interpolated angles be verified? */
+    int nthreads,         /* I: number of threads for generating the angles */
+    bool share_bands,     /* I: should the angles be shared between bands? */
+    char *dem_file,       /* I: DEM giving the terrain height of each pixel,
+                                or NULL to use zero height */
+    Espa_internal_meta_t *out_meta /* O: metadata for the angle bands; global
+                                         metadata is not valid */
+)
+{
+    char FUNC_NAME[] = "create_angle_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char tmpstr[STR_SIZE];       /* temporary string */
+    char tmpfile[STR_SIZE];      /* temporary filename */
+    char ang_infile[STR_SIZE];   /* input angle coefficient filename */
+    char outfile[STR_SIZE];      /* output base filename for angle bands */
+    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
+    char band_angle[NANGLE_BANDS][STR_SIZE] = {"solar zenith", "solar azimuth",
+                                    "sensor zenith", "sensor azimuth"};
+    char *cptr = NULL;           /* pointer to file extension */
+    bool process_l8 = false;     /* are we processing L8 vs. L4-7 */
+    bool process_l7 = false;     /* are we processing L7 vs. L4-5 or L8 */
+    int bndx;                    /* index of the XML band for the pixel size
+                                    of the current input band */
+    int i;                       /* looping variable for bands */
+    int count;                   /* number of chars copied in snprintf */
+    int curr_band;               /* current input band number */
+    int curr_bndx;               /* index of current input band */
+    int nbands;                  /* number of input bands to be read */
+    int out_nbands;              /* number of output bands to be written */
+    int nlines[MAX_NBANDS];      /* number of lines for each band */
+    int nsamps[MAX_NBANDS];      /* number of samples for each band */
+    int avg_nlines;              /* number of lines for band average */
+    int avg_nsamps;              /* number of samples for band average */
+    int l7_xml_bndx[] = {0, 1, 2, 3, 4, 5, 7, 8}; /* index of the XML band
+                                    for each Landsat 7 band (b1-b5, b61,
+                                    b7, b8).  The angle coefficient file has
+                                    a single band 6 for both thermal gains,
+                                    sized like b61. */
+    Angle_band_t ang;            /* looping variable for solar/senor angle */
+    ANGLES_FRAME frame[MAX_NBANDS];   /* image frame info for each band */
+    Angle_band_writers_t abw;      /* writers for the per-band angle bands */
+    short *curr_angle = NULL;      /* pointer to the current angle array */
+    ANGLES_FRAME avg_frame;        /* image frame info for band average */
+    short *avg_solar_zenith=NULL;  /* array for solar zenith angle average */
+    short *avg_solar_azimuth=NULL; /* array for solar azimuth angle average */
+    short *avg_sat_zenith=NULL;    /* array for satellite zenith angle avg */
+    short *avg_sat_azimuth=NULL;   /* array for satellite azimuth angle avg */
+    time_t tp;                     /* time structure */
+    struct tm *tm = NULL;          /* time structure for UTC time */
+    Raw_binary_writer_t rbw;       /* writer for the output angle band */
+    Raw_binary_cache_t cache = get_raw_binary_cache_mode ();
+                                   /* page cache handling for the output */
+    Raw_binary_codec_t codec = get_raw_binary_angle_codec ();
+                                   /* compression of the output bands */
+    bool band_stats = use_raw_binary_stats ();
+                                   /* should the band statistics be computed
+                                      while writing? */
+    bool band_checksum = use_raw_binary_checksum ();
+                                   /* should the band file checksums be
+                                      computed while writing? */
+    Envi_header_t envi_hdr;        /* output ENVI header information */
+    Envi_hdr_batch_t hdr_batch;    /* ENVI headers of the angle bands */
+    int status;                    /* status of the ENVI headers */
+    Espa_band_meta_t *bmeta=NULL;    /* pointer to array of bands metadata */
+    Espa_global_meta_t *gmeta=NULL;  /* pointer to the global metadata struct */
+    Espa_band_meta_t *out_bmeta = NULL; /* band metadata for angle bands */
+    Derived_cache_key_t key;       /* derived band cache key of the bands */
+    bool cache_ok;                 /* can the bands be cached? */
+    bool cached;                   /* were the bands restored from the
+                                      cache? */
+
+    bmeta = xml_metadata->band;
+    gmeta = &xml_metadata->global;
+
+    /* Determine if L8, L7 or L4-5 is being processed */
+    if (!strncmp (gmeta->instrument, "OLI", 3))
+        process_l8 = true;
+    else if (!strncmp (gmeta->instrument, "ETM", 3))
+        process_l7 = true;
+    else if (strncmp (gmeta->instrument, "TM", 2))
+    {
+        sprintf (errmsg, "Unsupported instrument %s; only TM, ETM+ and "
+            "OLI/TIRS are supported", gmeta->instrument);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Determine the angle coefficient filename and the output file basename */
+    strcpy (ang_infile, xml_infile);
+    cptr = strchr (ang_infile, '.');
+    strcpy (cptr, "_ANG.txt");
+
+    strcpy (outfile, xml_infile);
+    cptr = strchr (outfile, '.');
+    *cptr = '\0';
+
+    /* Initialize the output metadata structure.  The global metadata will
+       not be used and will not be valid. */
+    init_metadata_struct (out_meta);
+
+    /* Determine the number of input bands */
+    if (process_l8)
+        nbands = L8_NBANDS;
+    else if (process_l7)
+        nbands = L7_NBANDS;
+    else
+        nbands = L45_NBANDS;
+
+    /* Determine the number of output bands */
+    if (band_avg)
+        out_nbands = NANGLE_BANDS;
+    else if (process_l8)
+        out_nbands = L8_NBANDS * NANGLE_BANDS;
+    else if (process_l7)
+        out_nbands = L7_NBANDS * NANGLE_BANDS;
+    else
+        out_nbands = L45_NBANDS * NANGLE_BANDS;
+
+    /* Allocate memory for the output bands */
+    if (allocate_band_metadata (out_meta, out_nbands) != SUCCESS)
+    {
+        sprintf (errmsg, "Cannot allocate memory for the %d angle bands",
+            out_nbands);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Get the current date/time (UTC) for the production date of each band */
+    if (time (&tp) == -1)
+    {
+        sprintf (errmsg, "Unable to obtain the current time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    tm = gmtime (&tp);
+    if (tm == NULL)
+    {
+        sprintf (errmsg, "Converting time to UTC.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
+    {
+        sprintf (errmsg, "Formatting the production date/time.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Set up the metadata of the solar/sensor angle bands */
+    if (!band_avg)
+    {
+        /* Setup the XML file for these bands.  The size of each band is set
+           when it is written. */
+        for (i = 0; i < out_nbands; i++)
+        {
+            /* Set up the band metadata for the current band */
+            out_bmeta = &out_meta->band[i];
+            strcpy (out_bmeta->product, "intermediate_data");
+            strcpy (out_bmeta->source, "level1");
+            strcpy (out_bmeta->category, "image");
+
+            /* Setup filename-related items for all four bands: solar zenith,
+               solar azimuth, sensor zenith, sensor azimuth.  The band numbers
+               are those of the angle coefficient file, which follow a normal
+               numbering scheme.  The L7 XML bands need a little help to
+               find the one matching the band. */
+            curr_band = i / NANGLE_BANDS + 1;  /* current input band number */
+            curr_bndx = curr_band - 1;   /* index of current input band */
+            bndx = process_l7 ? l7_xml_bndx[curr_bndx] : curr_bndx;
+            switch (i % NANGLE_BANDS)
+            {
+                case (SOLAR_ZEN):  /* solar zenith */
+                    /* Determine the output file for the solar zenith band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_B%d_solar_zenith.img", outfile, curr_band);
+                    sprintf (out_bmeta->name, "solar_zenith_band%d", curr_band);
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSOLZEN", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "band %d solar zenith angles", curr_band);
+                    break;
+
+                case (SOLAR_AZ):  /* solar azimuth */
+                    /* Determine the output file for the solar azimuth band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_B%d_solar_azimuth.img", outfile, curr_band);
+                    sprintf (out_bmeta->name, "solar_azimuth_band%d",
+                        curr_band);
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSOLAZ", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "band %d solar azimuth angles", curr_band);
+                    break;
+
+                case (SENSOR_ZEN):  /* sensor zenith */
+                    /* Determine the output file for the sensor zenith band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_B%d_sensor_zenith.img", outfile, curr_band);
+                    sprintf (out_bmeta->name, "sensor_zenith_band%d",
+                        curr_band);
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSENZEN", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "band %d sensor zenith angles", curr_band);
+                    break;
+
+                case (SENSOR_AZ):  /* sensor azimuth */
+                    /* Determine the output file for the sensor azimuth band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_B%d_sensor_azimuth.img", outfile, curr_band);
+                    sprintf (out_bmeta->name, "sensor_azimuth_band%d",
+                        curr_band);
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSENAZ", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "band %d sensor azimuth angles", curr_band);
+                    break;
+            }
+            if (count < 0 || (size_t) count >= sizeof (tmpfile))
+            {
+                sprintf (errmsg, "Overflow of the filename of angle band %d",
+                    i);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name), "%s",
+                tmpfile);
+            out_bmeta->data_type = ESPA_INT16;
+            out_bmeta->fill_value = ANGLE_BAND_FILL;
+            out_bmeta->scale_factor = ANGLE_BAND_SCALE_FACT;
+            strcpy (out_bmeta->data_units, "degrees");
+            out_bmeta->pixel_size[0] =
+                bmeta[bndx].pixel_size[0] * sub_sample;
+            out_bmeta->pixel_size[1] =
+                bmeta[bndx].pixel_size[1] * sub_sample;
+            strcpy (out_bmeta->pixel_units, bmeta[bndx].pixel_units);
+            sprintf (out_bmeta->app_version, "create_angle_bands_%s",
+                ESPA_COMMON_VERSION);
+            strcpy (out_bmeta->production_date, production_date);
+        }
+    }  /* if !band_avg */
+    else
+    {
+        /* Setup the XML file for these bands.  The size of the bands is set
+           when they are generated. */
+        for (i = 0; i < out_nbands; i++)
+        {
+            /* Set up the band metadata for the current band */
+            out_bmeta = &out_meta->band[i];
+            strcpy (out_bmeta->product, "intermediate_data");
+            strcpy (out_bmeta->source, "level1");
+            strcpy (out_bmeta->category, "image");
+
+            /* Setup filename-related items for all four bands: solar zenith,
+               solar azimuth, sensor zenith, sensor azimuth */
+            switch (i)
+            {
+                case (SOLAR_ZEN):  /* solar zenith */
+                    /* Determine the output file for the solar zenith band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_avg_solar_zenith.img", outfile);
+                    sprintf (out_bmeta->name, "avg_solar_zenith_band");
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSOLZEN", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "average solar zenith angles");
+                    break;
+
+                case (SOLAR_AZ):  /* solar zenith */
+                    /* Determine the output file for the solar azimuth band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_avg_solar_azimuth.img", outfile);
+                    sprintf (out_bmeta->name, "avg_solar_azimuth_band");
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSOLAZ", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "average solar azimuth angles");
+                    break;
+
+                case (SENSOR_ZEN):  /* sensor zenith */
+                    /* Determine the output file for the sensor zenith band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_avg_sensor_zenith.img", outfile);
+                    sprintf (out_bmeta->name, "avg_sensor_zenith_band");
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSENZEN", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "average sensor zenith angles");
+                    break;
+
+                case (SENSOR_AZ):  /* sensor azimuth */
+                    /* Determine the output file for the sensor azimuth band */
+                    count = snprintf (tmpfile, sizeof (tmpfile),
+                        "%s_avg_sensor_azimuth.img", outfile);
+                    sprintf (out_bmeta->name, "avg_sensor_azimuth_band");
+                    strncpy (tmpstr, bmeta->short_name, 3);
+                    sprintf (out_bmeta->short_name, "%sSENAZ", tmpstr);
+                    sprintf (out_bmeta->long_name,
+                        "average sensor azimuth angles");
+                    break;
+            }
+            if (count < 0 || (size_t) count >= sizeof (tmpfile))
+            {
+                sprintf (errmsg, "Overflow of the filename of angle band %d",
+                    i);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name), "%s",
+                tmpfile);
+            out_bmeta->data_type = ESPA_INT16;
+            out_bmeta->fill_value = ANGLE_BAND_FILL;
+            out_bmeta->scale_factor = ANGLE_BAND_SCALE_FACT;
+            strcpy (out_bmeta->data_units, "degrees");
+            out_bmeta->pixel_size[0] = bmeta[0].pixel_size[0] * sub_sample;
+            out_bmeta->pixel_size[1] = bmeta[0].pixel_size[1] * sub_sample;
+            strcpy (out_bmeta->pixel_units, bmeta[0].pixel_units);
+            sprintf (out_bmeta->app_version, "create_angle_bands_%s",
+                ESPA_COMMON_VERSION);
+            strcpy (out_bmeta->production_date, production_date);
+        }
+    }  /* else (if !band_avg) */
+
+    /* Use the angle bands of an earlier run on the same inputs if they're
+       cached.  The bands just aren't cached if the inputs can't be read for
+       the key. */
+    cache_ok = use_derived_cache () && get_angle_cache_key (ang_infile,
+        gmeta, band_avg, sub_sample, grid_spacing, max_grid_error,
+        share_bands, dem_file, codec, band_stats, band_checksum, &key)
+        == SUCCESS;
+    cached = cache_ok && read_derived_cache (&key, out_nbands,
+        out_meta->band);
+    if (cached)
+        printf ("Using the cached angle bands\n");
+    else if (!band_avg)
+    {
+        /* Create the Landsat angle bands for all bands, writing the angle
+           bands as the lines are generated.  Create a product at the
+           requested sub-sampling with a fill value to match the Landsat
+           image data.  The angles are interpolated between the grid points
+           if a grid spacing was specified. */
+        memset (&abw, 0, sizeof (abw));
+        abw.out_meta = out_meta;
+        abw.cache = cache;
+        abw.codec = codec;
+        abw.band_stats = band_stats;
+        abw.band_checksum = band_checksum;
+        printf ("Generating and writing the angle bands ...\n");
+        if (l8_per_pixel_angles_lines (ang_infile, sub_sample, ANGLE_BAND_FILL,
+            "ALL", grid_spacing, max_grid_error, verify_grid, nthreads,
+            share_bands, AT_BOTH, dem_file, write_angle_band_lines, &abw,
+            frame, nlines, nsamps) != SUCCESS)
+        {  /* Error messages already written */
+            close_angle_band_writers (&abw);
+            return (ERROR);
+        }
+
+        /* Make sure the four different angle bands of each band were
+           written */
+        for (i = 0; i < nbands; i++)
+        {
+            if (!abw.written[i])
+            {
+                sprintf (errmsg, "Angles for band index %d are not in the "
+                    "angle coefficient file", i);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Tag the sub-sampled bands with their full resolution size */
+            if (sub_sample > 1)
+            {
+                for (ang = 0; ang < NANGLE_BANDS; ang++)
+                {
+                    out_bmeta = &out_meta->band[i*NANGLE_BANDS + ang];
+                    out_bmeta->sub_sample.factor = sub_sample;
+                    out_bmeta->sub_sample.nlines = frame[i].num_lines;
+                    out_bmeta->sub_sample.nsamps = frame[i].num_samps;
+                }
+            }
+        }  /* for i < nbands */
+    }  /* if !band_avg */
+    else
+    {
+        /* Create the average Landsat angle bands over the reflectance bands.
+           Create a product at the requested sub-sampling with a fill value
+           to match the Landsat image data. */
+        if (l8_per_pixel_avg_refl_angles (ang_infile, sub_sample,
+            ANGLE_BAND_FILL, share_bands, &avg_frame, &avg_solar_zenith,
+            &avg_solar_azimuth, &avg_sat_zenith, &avg_sat_azimuth,
+            &avg_nlines, &avg_nsamps) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        /* Set the size of the bands */
+        for (i = 0; i < out_nbands; i++)
+        {
+            out_bmeta = &out_meta->band[i];
+            out_bmeta->nlines = avg_nlines;
+            out_bmeta->nsamps = avg_nsamps;
+            if (sub_sample > 1)
+            {
+                out_bmeta->sub_sample.factor = sub_sample;
+                out_bmeta->sub_sample.nlines = avg_frame.num_lines;
+                out_bmeta->sub_sample.nsamps = avg_frame.num_samps;
+            }
+        }
+
+        /* Loop through the four different angle bands and write them */
+        for (ang = 0; ang < NANGLE_BANDS; ang++)
+        {
+            printf ("Writing %s band average angle ...\n", band_angle[ang]);
+
+            /* Grab the correct data array to be written for this angle
+               band */
+            switch (ang)
+            {
+                case (SOLAR_ZEN):
+                    curr_angle = avg_solar_zenith;
+                    break;
+                case (SOLAR_AZ):
+                    curr_angle = avg_solar_azimuth;
+                    break;
+                case (SENSOR_ZEN):
+                    curr_angle = avg_sat_zenith;
+                    break;
+                case (SENSOR_AZ):
+                    curr_angle = avg_sat_azimuth;
+                    break;
+                default:
+                    sprintf (errmsg, "Invalid angle type %d", ang);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+            }
+
+            /* Open the output file for this angle */
+            out_bmeta = &out_meta->band[ang];
+            if (open_raw_binary_writer (out_bmeta->file_name, cache, codec,
+                &rbw) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to open the average %s file",
+                    band_angle[ang]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            if (band_stats &&
+                attach_raw_binary_stats (&rbw, out_bmeta) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to compute the statistics of the "
+                    "average %s band", band_angle[ang]);
+                error_handler (true, FUNC_NAME, errmsg);
+                close_raw_binary_writer (&rbw);
+                return (ERROR);
+            }
+            if (band_checksum)
+                attach_raw_binary_checksum (&rbw, out_bmeta);
+    
+            /* Write the data for this band */
+            if (write_raw_binary_writer (&rbw, avg_nlines, avg_nsamps,
+                sizeof (short), curr_angle) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to write to average %s file",
+                    band_angle[ang]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Close the file and free the memory for this angle */
+            if (close_raw_binary_writer (&rbw) != SUCCESS)
+            {
+                sprintf (errmsg, "Unable to close the average %s file",
+                    band_angle[ang]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            espa_free_large (curr_angle);
+        }  /* for ang < NANGLE_BANDS */
+    }  /* else (if !band_avg) */
+
+    /* Cache the bands for later runs.  The bands are still good if they
+       can't be cached. */
+    if (cache_ok && !cached &&
+        write_derived_cache (&key, out_nbands, out_meta->band) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to cache the angle bands");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    /* Collect the ENVI header for each of the angle bands, then write them
+       all at once */
+    if (init_envi_hdr_batch (&hdr_batch, out_nbands) != SUCCESS)
+    {
+        sprintf (errmsg, "Error setting up the ENVI header files.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    status = SUCCESS;
+    for (i = 0; i < out_nbands && status == SUCCESS; i++)
+    {
+        /* Create the ENVI header */
+        out_bmeta = &out_meta->band[i];
+        if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Error creating the ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            continue;
+        }
+
+        /* Add the ENVI header to the batch */
+        sprintf (tmpfile, "%s", out_bmeta->file_name);
+        sprintf (&tmpfile[strlen(tmpfile)-3], "hdr");
+        status = add_envi_hdr (&hdr_batch, i, tmpfile, &envi_hdr);
+    }
+    if (status == SUCCESS)
+        status = flush_envi_hdr_batch (&hdr_batch);
+    free_envi_hdr_batch (&hdr_batch);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ENVI header files of the angle bands.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
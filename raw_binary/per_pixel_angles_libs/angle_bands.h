@@ -0,0 +1,73 @@
+/*****************************************************************************
+FILE: angle_bands.h
+
+PURPOSE: Contains defines and prototypes for creating the per-pixel solar and
+view/satellite angle bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+
+#ifndef ANGLE_BANDS_H
+#define ANGLE_BANDS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "l8_angles.h"
+
+/* Define the band information for each of the instruments.  Currently the
+   maximum number of input bands is the number of bands for L8. */
+#define MAX_NBANDS L8_NBANDS
+#define L45_NBANDS 7
+#define L7_NBANDS 8
+
+/* Define the fill value and the scaling factors (offsets the scale applied
+   in the  */
+#define ANGLE_BAND_FILL -9999
+#define ANGLE_BAND_SCALE_FACT 0.01
+
+/* Length of the production date string */
+#define MAX_DATE_LEN 28
+
+/* Define the solar/sensor angle band indices */
+typedef enum
+{
+    SOLAR_ZEN = 0,
+    SOLAR_AZ,
+    SENSOR_ZEN,
+    SENSOR_AZ,
+    NANGLE_BANDS
+} Angle_band_t;
+
+/* Prototypes */
+int create_angle_bands
+(
+    char *xml_infile,     /* I: input XML filename, used for the angle
+                                coefficient and output band filenames */
+    Espa_internal_meta_t *xml_metadata, /* I: input XML metadata */
+    bool band_avg,        /* I: should the reflectance band average be
+                                processed? */
+    int sub_sample,       /* I: sub-sampling factor of the angle bands
+                                (1 = full resolution) */
+    int grid_spacing,     /* I: spacing of the exactly evaluated angle grid */
+    double max_grid_error, /* I: maximum angle grid interpolation error
+                                 (degrees) */
+    bool verify_grid,     /* I: should the interpolated angles be verified? */
+    int nthreads,         /* I: number of threads for generating the angles */
+    bool share_bands,     /* I: should the angles be shared between bands? */
+    char *dem_file,       /* I: DEM giving the terrain height of each pixel,
+                                or NULL to use zero height */
+    Espa_internal_meta_t *out_meta /* O: metadata for the angle bands; global
+                                         metadata is not valid */
+);
+
+#endif
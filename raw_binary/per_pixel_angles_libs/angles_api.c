@@ -1,6 +1,11 @@
+/* Standard Library Includes */
+#include <math.h>
+#include <string.h>
+
 /* IAS Library Includes */
 #include "ias_logging.h"
 #include "ias_angle_gen_distro.h"
+#include "ias_angle_gen_private.h"
 
 /* Local Includes */
 #include "l8_angles.h"
@@ -13,12 +18,16 @@ Purpose: Calculate the satellite and solar zenith and azimuth angles.
 Note: ias_angle_gen_calculate_angles_rpc will return the angles in radians
   1. zenith values are from 0 to pi radians
   2. azimuth values are from -pi to pi radians
+  The angles are evaluated at the DEM height of the point, or at zero height
+  (to ensure the full scene coverage) without a DEM.
 
 Return: SUCCESS / ERROR
  ******************************************************************************/
 int calculate_angles
 (
     const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    L8_ANGLES_DEM *dem,                     /* I: DEM for the heights, or NULL
+                                                  for zero height */
     int line,                               /* I: L1T line coordinate */
     int samp,                               /* I: L1T sample coordinate */
     int band_index,                         /* I: Spectral band number */
@@ -27,11 +36,34 @@ int calculate_angles
     double *sun_angles                      /* O: Solar angles (radians) */
 )       
 {
-    double elev;            /* Elevation always set at 0 */
+    double elev;            /* Elevation of the point */
     int outside_image_flag; /* Outside of image flag */
 
     /* Default the elevation to 0 to ensure the full scene coverage */
     elev = 0;
+    if (dem != NULL && l8_angles_dem_heights(dem, metadata, band_index, line,
+        samp, 1, 1, &elev) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Looking up the DEM height at line %d sample %d",
+            line, samp);
+        return ERROR;
+    }
+
+    /* Calculate both sets of angles in one pass, so the SCAs are only
+       located once */
+    if (angle_type == AT_BOTH)
+    {
+        if (ias_angle_gen_calculate_sat_sun_angles_rpc(metadata, line, samp,
+            &elev, band_index, &outside_image_flag, sat_angles, sun_angles)
+            != SUCCESS)
+        {
+            IAS_LOG_ERROR("Evaluating satellite and solar angles for band "
+                "index %d", band_index);
+            return ERROR;
+        }
+
+        return SUCCESS;
+    }
 
     /* If angle type is not of solar type then it is either calculating
        both angles or just the satellite angles */
@@ -65,6 +97,142 @@ int calculate_angles
     return SUCCESS;
 }
 
+/*******************************************************************************
+Name: calculate_line_angles
+
+Purpose: Calculate the satellite and solar zenith and azimuth angles for a run
+  of equally spaced samples along an L1T line.
+
+Note: The angles are the same as calculate_angles gives for each sample (to
+  within rounding), but the line dependent parts of the rational polynomials
+  are only evaluated once.  The angles are stored as zenith/azimuth pairs for
+  each sample.  The elevation is set to 0, or looked up in the DEM, to match
+  calculate_angles.
+
+Return: SUCCESS / ERROR
+ ******************************************************************************/
+int calculate_line_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    L8_ANGLES_DEM *dem,                     /* I: DEM for the heights, or NULL
+                                                  for zero height */
+    int line,                               /* I: L1T line coordinate */
+    int first_samp,                         /* I: L1T sample coordinate of the
+                                                  first sample */
+    int samp_step,                          /* I: Spacing of the samples */
+    int num_samps,                          /* I: Number of samples */
+    int band_index,                         /* I: Spectral band number */
+    ANGLE_TYPE angle_type,                  /* I: Type of angles to generate */
+    double *sat_angles,                     /* O: Satellite angles (radians)
+                                                  for each sample */
+    double *sun_angles                      /* O: Solar angles (radians) for
+                                                  each sample */
+)
+{
+    double elev = 0;        /* Elevation without a DEM */
+    double heights[IAS_ANGLE_GEN_LINE_CHUNK]; /* DEM height of each sample */
+    int chunk;              /* First sample index of the chunk */
+
+    if (dem == NULL)
+    {
+        if (ias_angle_gen_calculate_line_angles_rpc(metadata, line,
+            first_samp, samp_step, num_samps, &elev, band_index, NULL,
+            (angle_type != AT_SOLAR) ? sat_angles : NULL,
+            (angle_type != AT_SATELLITE) ? sun_angles : NULL) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Evaluating angles for band index %d, line %d",
+                band_index, line);
+            return ERROR;
+        }
+
+        return SUCCESS;
+    }
+
+    /* Look up the heights and evaluate the angles a chunk of samples at a
+       time */
+    for (chunk = 0; chunk < num_samps; chunk += IAS_ANGLE_GEN_LINE_CHUNK)
+    {
+        int chunk_samps = num_samps - chunk;    /* Samples in the chunk */
+        int chunk_samp = first_samp + chunk * samp_step; /* First sample
+                                                   of the chunk */
+
+        if (chunk_samps > IAS_ANGLE_GEN_LINE_CHUNK)
+            chunk_samps = IAS_ANGLE_GEN_LINE_CHUNK;
+
+        if (l8_angles_dem_heights(dem, metadata, band_index, line,
+            chunk_samp, samp_step, chunk_samps, heights) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Looking up the DEM heights for line %d", line);
+            return ERROR;
+        }
+
+        if (ias_angle_gen_calculate_line_dem_angles_rpc(metadata, line,
+            chunk_samp, samp_step, chunk_samps, heights, band_index, NULL,
+            (angle_type != AT_SOLAR) ? &sat_angles[2 * chunk] : NULL,
+            (angle_type != AT_SATELLITE) ? &sun_angles[2 * chunk] : NULL)
+            != SUCCESS)
+        {
+            IAS_LOG_ERROR("Evaluating angles for band index %d, line %d",
+                band_index, line);
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: get_sca_key
+
+Purpose: Identify the SCA, or pair of overlapping SCAs, that contain an L1T
+  line/sample.  Two points with the same key are evaluated with the same
+  SCA rational polynomials.
+
+Note: The elevation is set to 0, or looked up in the DEM, to match
+  calculate_angles.
+
+Return: SCA key, or -1 if the point is not in any SCA
+ ******************************************************************************/
+int get_sca_key
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    L8_ANGLES_DEM *dem,                     /* I: DEM for the heights, or NULL
+                                                  for zero height */
+    int line,                               /* I: L1T line coordinate */
+    int samp,                               /* I: L1T sample coordinate */
+    int band_index                          /* I: Band index */
+)
+{
+    const IAS_ANGLE_GEN_BAND *band_ptr;     /* Pointer to current band */
+    double elev = 0;        /* Elevation of the point */
+    double l1r_line[2];     /* L1R line for each SCA found */
+    double l1r_samp[2];     /* L1R sample for each SCA found */
+    int nsca_found;         /* Number of SCAs containing the point */
+    int sca[2];             /* SCA index for each SCA found */
+
+    if (dem != NULL && l8_angles_dem_heights(dem, metadata, band_index, line,
+        samp, 1, 1, &elev) != SUCCESS)
+    {
+        return -1;
+    }
+
+    band_ptr = &metadata->band_metadata[band_index];
+    nsca_found = ias_angle_gen_find_scas(band_ptr, line, samp, &elev,
+        l1r_line, l1r_samp);
+    if (nsca_found < 1 || nsca_found > 2)
+        return -1;
+
+    /* The L1R sample is offset by the SCA index times the SCA width */
+    sca[0] = (int)floor(l1r_samp[0] / band_ptr->l1r_samps);
+    if (nsca_found == 1)
+        return sca[0];
+
+    sca[1] = (int)floor(l1r_samp[1] / band_ptr->l1r_samps);
+    if (sca[0] > sca[1])
+        return sca[1] * band_ptr->num_scas + sca[0] + band_ptr->num_scas;
+    return sca[0] * band_ptr->num_scas + sca[1] + band_ptr->num_scas;
+}
+
 /*******************************************************************************
 Name: get_active_lines
 
@@ -127,3 +295,111 @@ int get_frame
 
     return SUCCESS;
 }
+
+/*******************************************************************************
+Name: same_band_resolution
+
+Purpose: Determine whether two bands are in the same resolution group, i.e.
+  they have the same L1T image size and pixel size.
+
+Return: 1 if the bands are in the same resolution group, 0 if not
+ ******************************************************************************/
+int same_band_resolution
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    int band_index,                         /* I: Band index */
+    int other_index                         /* I: Band index to compare to */
+)
+{
+    const IAS_ANGLE_GEN_BAND *band_ptr = &metadata->band_metadata[band_index];
+    const IAS_ANGLE_GEN_BAND *other_ptr
+        = &metadata->band_metadata[other_index];
+
+    return band_ptr->l1t_lines == other_ptr->l1t_lines
+        && band_ptr->l1t_samps == other_ptr->l1t_samps
+        && band_ptr->pixel_size == other_ptr->pixel_size;
+}
+
+/*******************************************************************************
+Name: same_active_area
+
+Purpose: Determine whether two bands have the same active image area, i.e.
+  they are in the same resolution group and their active image corners are
+  identical.  Such bands have the same scene trim lookup table.
+
+Return: 1 if the active image areas are the same, 0 if not
+ ******************************************************************************/
+int same_active_area
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    int band_index,                         /* I: Band index */
+    int other_index                         /* I: Band index to compare to */
+)
+{
+    const IAS_ANGLE_GEN_BAND *band_ptr = &metadata->band_metadata[band_index];
+    const IAS_ANGLE_GEN_BAND *other_ptr
+        = &metadata->band_metadata[other_index];
+
+    return same_band_resolution(metadata, band_index, other_index)
+        && memcmp(band_ptr->active_l1t_corner_lines,
+            other_ptr->active_l1t_corner_lines,
+            sizeof(band_ptr->active_l1t_corner_lines)) == 0
+        && memcmp(band_ptr->active_l1t_corner_samps,
+            other_ptr->active_l1t_corner_samps,
+            sizeof(band_ptr->active_l1t_corner_samps)) == 0;
+}
+
+/*******************************************************************************
+Name: same_satellite_angles
+
+Purpose: Determine whether two bands generate exactly the same satellite
+  angles.  This is the case when the image framing, the active image area,
+  the SCA rational polynomials and the satellite angle rational polynomials
+  are all identical.
+
+Note: The coefficient structures only hold doubles, so they are compared
+  with memcmp.
+
+Return: 1 if the satellite angles are the same, 0 if not
+ ******************************************************************************/
+int same_satellite_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    int band_index,                         /* I: Band index */
+    int other_index                         /* I: Band index to compare to */
+)
+{
+    const IAS_ANGLE_GEN_BAND *band_ptr = &metadata->band_metadata[band_index];
+    const IAS_ANGLE_GEN_BAND *other_ptr
+        = &metadata->band_metadata[other_index];
+    int sca_index;          /* SCA index */
+
+    if (!same_active_area(metadata, band_index, other_index)
+        || band_ptr->num_scas != other_ptr->num_scas
+        || band_ptr->l1r_lines != other_ptr->l1r_lines
+        || band_ptr->l1r_samps != other_ptr->l1r_samps
+        || memcmp(&band_ptr->satellite, &other_ptr->satellite,
+            sizeof(band_ptr->satellite)) != 0)
+    {
+        return 0;
+    }
+
+    for (sca_index = 0; sca_index < band_ptr->num_scas; sca_index++)
+    {
+        const IAS_ANGLE_GEN_IMAGE_RPC *sca_ptr
+            = &band_ptr->sca_metadata[sca_index];
+        const IAS_ANGLE_GEN_IMAGE_RPC *other_sca_ptr
+            = &other_ptr->sca_metadata[sca_index];
+
+        if (sca_ptr->mean_height != other_sca_ptr->mean_height
+            || memcmp(&sca_ptr->line_terms, &other_sca_ptr->line_terms,
+                sizeof(sca_ptr->line_terms)) != 0
+            || memcmp(&sca_ptr->samp_terms, &other_sca_ptr->samp_terms,
+                sizeof(sca_ptr->samp_terms)) != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
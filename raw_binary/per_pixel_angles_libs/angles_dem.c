@@ -0,0 +1,566 @@
+/* Standard Library Includes */
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* IAS Library Includes */
+#include "ias_logging.h"
+#include "ias_angle_gen_distro.h"
+
+/* Local Includes */
+#include "l8_angles.h"
+
+/* Size (lines and samples) of the DEM tiles read into the cache */
+#define L8_DEM_TILE_SIZE 256
+
+/* Number of DEM tiles held in the cache.  The bands are generated a block of
+   lines at a time in turn, so the tiles under one block of the scene are
+   revisited by every band before the next block is started. */
+#define L8_DEM_CACHE_TILES 64
+
+/* DEM read in tiles, with the most recently used tiles held in memory */
+struct l8_angles_dem
+{
+    char filename[PATH_MAX];    /* DEM image filename */
+    FILE *fp;                   /* DEM image file */
+    int nlines;                 /* Lines in the DEM */
+    int nsamps;                 /* Samples in the DEM */
+    int data_type;              /* ENVI data type of the heights */
+    int swap_flag;              /* Flag to byte swap the heights */
+    long header_offset;         /* Bytes before the image data */
+    int fill_flag;              /* Flag that there's a fill value */
+    double fill_value;          /* Fill value of the heights */
+    double ul_x;                /* Map X of the center of the first DEM
+                                   pixel */
+    double ul_y;                /* Map Y of the center of the first DEM
+                                   pixel */
+    double pixel_x;             /* DEM pixel width in map units */
+    double pixel_y;             /* DEM pixel height in map units */
+    int tiles_across;           /* Tiles across the DEM */
+    int tiles_down;             /* Tiles down the DEM */
+    int *tile_slot;             /* Cache slot of each tile, -1 if not
+                                   cached */
+    int slot_tile[L8_DEM_CACHE_TILES]; /* Tile in each slot, -1 if empty */
+    unsigned long slot_use[L8_DEM_CACHE_TILES]; /* Last use of each slot */
+    float *slot_data;           /* Heights of the tile in each slot */
+    unsigned long use_clock;    /* Counter of the tile uses */
+    unsigned long lookups;      /* Number of heights looked up */
+    unsigned long tile_reads;   /* Number of tiles read from the file */
+};
+
+/******************************************************************************
+NAME: read_dem_header
+
+PURPOSE: Reads the size, data layout and map location of the DEM from its
+ENVI header.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The header was read
+    ERROR     The header couldn't be read or isn't supported
+
+NOTES:
+  1. The header is the DEM filename with its extension replaced by .hdr, as
+     for the ESPA raw binary bands.
+  2. Only single band DEMs of 16-bit signed or unsigned integer, or 32-bit
+     floating point, heights are supported.
+******************************************************************************/
+static int read_dem_header
+(
+    L8_ANGLES_DEM *dem          /* I/O: DEM, with the filename set */
+)
+{
+    char hdr_filename[PATH_MAX]; /* ENVI header filename */
+    char line[1024];            /* Line read from the header */
+    char entry[4096];           /* Header entry, joined across lines */
+    char *cptr;                 /* Pointer into the filename/entry */
+    FILE *fp;                   /* Header file */
+    int nbands = 1;             /* Bands in the DEM */
+    int byte_order = 0;         /* ENVI byte order of the heights */
+    int host_order;             /* ENVI byte order of this machine */
+    int map_info_flag = 0;      /* Flag that the map info was found */
+    double xref = 1.0, yref = 1.0; /* Reference pixel of the map info */
+    double easting = 0.0, northing = 0.0; /* Map coordinates of the
+                                   reference pixel */
+    unsigned short byte_test = 1; /* Value to determine the byte order */
+
+    /* Replace the extension with .hdr */
+    if (strlen(dem->filename) + 5 > sizeof(hdr_filename))
+    {
+        IAS_LOG_ERROR("DEM filename is too long: %s", dem->filename);
+        return ERROR;
+    }
+    strcpy(hdr_filename, dem->filename);
+    cptr = strrchr(hdr_filename, '.');
+    if (cptr == NULL || strchr(cptr, '/') != NULL)
+        cptr = &hdr_filename[strlen(hdr_filename)];
+    strcpy(cptr, ".hdr");
+
+    fp = fopen(hdr_filename, "r");
+    if (fp == NULL)
+    {
+        IAS_LOG_ERROR("Opening the DEM header %s", hdr_filename);
+        return ERROR;
+    }
+
+    dem->nlines = 0;
+    dem->nsamps = 0;
+    dem->data_type = 0;
+    dem->header_offset = 0;
+    dem->fill_flag = 0;
+    entry[0] = '\0';
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *value;            /* Value of the entry */
+
+        /* Join the entries that are continued over several lines */
+        if (strlen(entry) + strlen(line) >= sizeof(entry))
+        {
+            IAS_LOG_ERROR("DEM header entry is too long in %s",
+                hdr_filename);
+            fclose(fp);
+            return ERROR;
+        }
+        strcat(entry, line);
+        if (strchr(entry, '{') != NULL && strchr(entry, '}') == NULL)
+            continue;
+
+        value = strchr(entry, '=');
+        if (value != NULL)
+        {
+            *value++ = '\0';
+
+            /* Trim the keyword */
+            for (cptr = &entry[strlen(entry)];
+                 cptr > entry && (cptr[-1] == ' ' || cptr[-1] == '\t');
+                 cptr--)
+            {
+                cptr[-1] = '\0';
+            }
+
+            if (strcmp(entry, "samples") == 0)
+                dem->nsamps = atoi(value);
+            else if (strcmp(entry, "lines") == 0)
+                dem->nlines = atoi(value);
+            else if (strcmp(entry, "bands") == 0)
+                nbands = atoi(value);
+            else if (strcmp(entry, "header offset") == 0)
+                dem->header_offset = atol(value);
+            else if (strcmp(entry, "byte order") == 0)
+                byte_order = atoi(value);
+            else if (strcmp(entry, "data type") == 0)
+                dem->data_type = atoi(value);
+            else if (strcmp(entry, "data ignore value") == 0)
+            {
+                dem->fill_flag = 1;
+                dem->fill_value = atof(value);
+            }
+            else if (strcmp(entry, "map info") == 0)
+            {
+                /* {projection, x ref, y ref, easting, northing, x size,
+                   y size, ...} */
+                cptr = strchr(value, ',');
+                if (cptr == NULL || sscanf(cptr + 1, "%lf ,%lf ,%lf ,%lf "
+                    ",%lf ,%lf", &xref, &yref, &easting, &northing,
+                    &dem->pixel_x, &dem->pixel_y) != 6)
+                {
+                    IAS_LOG_ERROR("Invalid map info in the DEM header %s",
+                        hdr_filename);
+                    fclose(fp);
+                    return ERROR;
+                }
+                map_info_flag = 1;
+            }
+        }
+        entry[0] = '\0';
+    }
+    fclose(fp);
+
+    if (dem->nlines < 1 || dem->nsamps < 1 || nbands != 1)
+    {
+        IAS_LOG_ERROR("DEM %s must be a single band with at least one line "
+            "and sample", dem->filename);
+        return ERROR;
+    }
+    if (dem->data_type != 2 && dem->data_type != 4 && dem->data_type != 12)
+    {
+        IAS_LOG_ERROR("Unsupported data type %d for DEM %s; only 16-bit "
+            "integer and 32-bit float heights are supported", dem->data_type,
+            dem->filename);
+        return ERROR;
+    }
+    if (!map_info_flag || dem->pixel_x <= 0.0 || dem->pixel_y <= 0.0)
+    {
+        IAS_LOG_ERROR("DEM header %s is missing valid map info",
+            hdr_filename);
+        return ERROR;
+    }
+
+    /* ENVI byte order 0 is little endian, 1 is big endian */
+    host_order = (*(unsigned char *)&byte_test == 1) ? 0 : 1;
+    dem->swap_flag = (byte_order != host_order);
+
+    /* The reference pixel is one-based, with its corner at the integer
+       position, so the center of the first pixel is at 1.5 */
+    dem->ul_x = easting + (1.5 - xref) * dem->pixel_x;
+    dem->ul_y = northing - (1.5 - yref) * dem->pixel_y;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+NAME: l8_angles_open_dem
+
+PURPOSE: Opens a DEM to provide the heights for the angle generation.
+
+RETURN VALUE: Type = L8_ANGLES_DEM *
+    Value     Description
+    -----     -----------
+    non-NULL  The DEM that was opened
+    NULL      An error occurred opening the DEM
+
+NOTES:
+  1. The DEM is an ENVI raw binary image in the same map projection as the
+     scene, with heights in meters (as generated for the ESPA products).  It
+     doesn't need to be on the same grid as the scene; the height of the
+     nearest DEM post is used.
+  2. The DEM is read L8_DEM_TILE_SIZE square tiles at a time as they're
+     needed, so only the tiles covering the part of the scene being
+     generated are held in memory.
+  3. Release the DEM with l8_angles_close_dem.
+******************************************************************************/
+L8_ANGLES_DEM *l8_angles_open_dem
+(
+    const char *dem_filename    /* I: DEM image filename */
+)
+{
+    L8_ANGLES_DEM *dem;         /* DEM being opened */
+    int num_tiles;              /* Number of tiles in the DEM */
+    int tile;                   /* Tile index */
+    int slot;                   /* Cache slot index */
+
+    if (strlen(dem_filename) >= PATH_MAX)
+    {
+        IAS_LOG_ERROR("DEM filename is too long: %s", dem_filename);
+        return NULL;
+    }
+
+    dem = calloc(1, sizeof(*dem));
+    if (dem == NULL)
+    {
+        IAS_LOG_ERROR("Allocating the DEM structure");
+        return NULL;
+    }
+    strcpy(dem->filename, dem_filename);
+
+    if (read_dem_header(dem) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reading the header of DEM %s", dem_filename);
+        free(dem);
+        return NULL;
+    }
+
+    dem->tiles_across = (dem->nsamps + L8_DEM_TILE_SIZE - 1)
+        / L8_DEM_TILE_SIZE;
+    dem->tiles_down = (dem->nlines + L8_DEM_TILE_SIZE - 1)
+        / L8_DEM_TILE_SIZE;
+    num_tiles = dem->tiles_across * dem->tiles_down;
+    dem->tile_slot = malloc(num_tiles * sizeof(*dem->tile_slot));
+    dem->slot_data = malloc((size_t) L8_DEM_CACHE_TILES * L8_DEM_TILE_SIZE
+        * L8_DEM_TILE_SIZE * sizeof(*dem->slot_data));
+    if (dem->tile_slot == NULL || dem->slot_data == NULL)
+    {
+        IAS_LOG_ERROR("Allocating the DEM tile cache");
+        l8_angles_close_dem(dem);
+        return NULL;
+    }
+    for (tile = 0; tile < num_tiles; tile++)
+        dem->tile_slot[tile] = -1;
+    for (slot = 0; slot < L8_DEM_CACHE_TILES; slot++)
+        dem->slot_tile[slot] = -1;
+
+    dem->fp = fopen(dem_filename, "rb");
+    if (dem->fp == NULL)
+    {
+        IAS_LOG_ERROR("Opening DEM %s", dem_filename);
+        l8_angles_close_dem(dem);
+        return NULL;
+    }
+
+    IAS_LOG_INFO("Using DEM %s (%d lines, %d samples) for the angle "
+        "heights", dem_filename, dem->nlines, dem->nsamps);
+
+    return dem;
+}
+
+/******************************************************************************
+NAME: l8_angles_close_dem
+
+PURPOSE: Closes a DEM opened with l8_angles_open_dem and releases its tile
+cache.
+
+RETURN VALUE: Type = None
+
+NOTES:
+  1. Passing NULL does nothing.
+******************************************************************************/
+void l8_angles_close_dem
+(
+    L8_ANGLES_DEM *dem          /* I/O: DEM to close (or NULL) */
+)
+{
+    if (dem == NULL)
+        return;
+
+    if (dem->lookups > 0)
+    {
+        IAS_LOG_INFO("Read %lu DEM tiles for %lu height lookups",
+            dem->tile_reads, dem->lookups);
+    }
+
+    if (dem->fp != NULL)
+        fclose(dem->fp);
+    free(dem->tile_slot);
+    free(dem->slot_data);
+    free(dem);
+}
+
+/******************************************************************************
+NAME: read_dem_tile
+
+PURPOSE: Reads a tile of the DEM into a cache slot, converting the heights to
+float.  Fill heights are set to zero.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The tile was read
+    ERROR     An error occurred reading the tile
+******************************************************************************/
+static int read_dem_tile
+(
+    L8_ANGLES_DEM *dem,         /* I/O: DEM */
+    int tile,                   /* I: Tile index */
+    float *heights              /* O: Heights of the tile */
+)
+{
+    int first_line = (tile / dem->tiles_across) * L8_DEM_TILE_SIZE;
+    int first_samp = (tile % dem->tiles_across) * L8_DEM_TILE_SIZE;
+    int num_lines = dem->nlines - first_line;
+    int num_samps = dem->nsamps - first_samp;
+    int data_size = (dem->data_type == 4) ? 4 : 2; /* Bytes per height */
+    unsigned char buffer[L8_DEM_TILE_SIZE * 4]; /* Line of the tile */
+    int line;                   /* Line index within the tile */
+    int samp;                   /* Sample index within the tile */
+
+    if (num_lines > L8_DEM_TILE_SIZE)
+        num_lines = L8_DEM_TILE_SIZE;
+    if (num_samps > L8_DEM_TILE_SIZE)
+        num_samps = L8_DEM_TILE_SIZE;
+
+    for (line = 0; line < num_lines; line++)
+    {
+        off_t offset = dem->header_offset + ((off_t) (first_line + line)
+            * dem->nsamps + first_samp) * data_size;
+        float *height = &heights[line * L8_DEM_TILE_SIZE];
+
+        if (fseeko(dem->fp, offset, SEEK_SET) != 0
+            || fread(buffer, data_size, num_samps, dem->fp)
+                != (size_t) num_samps)
+        {
+            IAS_LOG_ERROR("Reading line %d of DEM %s", first_line + line,
+                dem->filename);
+            return ERROR;
+        }
+
+        for (samp = 0; samp < num_samps; samp++)
+        {
+            unsigned char *bytes = &buffer[samp * data_size];
+            double value;       /* Height read */
+
+            if (dem->swap_flag)
+            {
+                unsigned char temp = bytes[0];
+                bytes[0] = bytes[data_size - 1];
+                bytes[data_size - 1] = temp;
+                if (data_size == 4)
+                {
+                    temp = bytes[1];
+                    bytes[1] = bytes[2];
+                    bytes[2] = temp;
+                }
+            }
+
+            if (dem->data_type == 2)
+            {
+                short svalue;
+                memcpy(&svalue, bytes, sizeof(svalue));
+                value = svalue;
+            }
+            else if (dem->data_type == 12)
+            {
+                unsigned short usvalue;
+                memcpy(&usvalue, bytes, sizeof(usvalue));
+                value = usvalue;
+            }
+            else
+            {
+                float fvalue;
+                memcpy(&fvalue, bytes, sizeof(fvalue));
+                value = fvalue;
+            }
+
+            if (dem->fill_flag && value == dem->fill_value)
+                value = 0.0;
+            height[samp] = value;
+        }
+    }
+
+    dem->tile_reads++;
+    return SUCCESS;
+}
+
+/******************************************************************************
+NAME: get_dem_tile
+
+PURPOSE: Returns the heights of a DEM tile, reading the tile into the cache
+slot used least recently if it isn't already cached.
+
+RETURN VALUE: Type = const float *
+    Value     Description
+    -----     -----------
+    non-NULL  Heights of the tile, L8_DEM_TILE_SIZE samples per line
+    NULL      An error occurred reading the tile
+******************************************************************************/
+static const float *get_dem_tile
+(
+    L8_ANGLES_DEM *dem,         /* I/O: DEM */
+    int tile                    /* I: Tile index */
+)
+{
+    int slot = dem->tile_slot[tile]; /* Cache slot of the tile */
+    float *heights;             /* Heights of the slot */
+
+    if (slot < 0)
+    {
+        int index;              /* Cache slot index */
+
+        /* Replace the least recently used slot */
+        slot = 0;
+        for (index = 1; index < L8_DEM_CACHE_TILES; index++)
+        {
+            if (dem->slot_use[index] < dem->slot_use[slot])
+                slot = index;
+        }
+        if (dem->slot_tile[slot] >= 0)
+            dem->tile_slot[dem->slot_tile[slot]] = -1;
+        dem->slot_tile[slot] = -1;
+
+        heights = &dem->slot_data[(size_t) slot * L8_DEM_TILE_SIZE
+            * L8_DEM_TILE_SIZE];
+        if (read_dem_tile(dem, tile, heights) != SUCCESS)
+            return NULL;
+
+        dem->slot_tile[slot] = tile;
+        dem->tile_slot[tile] = slot;
+    }
+
+    dem->slot_use[slot] = ++dem->use_clock;
+    return &dem->slot_data[(size_t) slot * L8_DEM_TILE_SIZE
+        * L8_DEM_TILE_SIZE];
+}
+
+/******************************************************************************
+NAME: l8_angles_dem_heights
+
+PURPOSE: Looks up the DEM heights of a run of equally spaced samples along an
+L1T line of a band.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The heights were looked up
+    ERROR     An error occurred reading the DEM
+
+NOTES:
+  1. The height of the DEM post nearest each sample is used.  Samples
+     outside the DEM, or on DEM fill, get zero height to match the angles
+     generated without a DEM.
+  2. The scene upper left corner in the angle metadata is the center of the
+     first pixel.
+  3. The tile cache is shared by all the threads, so the lookups are done
+     one thread at a time.  The lookups are cheap next to the angle
+     evaluations they feed.
+******************************************************************************/
+int l8_angles_dem_heights
+(
+    L8_ANGLES_DEM *dem,         /* I/O: DEM */
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    int band_index,             /* I: Band index */
+    int line,                   /* I: L1T line coordinate */
+    int first_samp,             /* I: L1T sample coordinate of the first
+                                      sample */
+    int samp_step,              /* I: Spacing of the samples */
+    int num_samps,              /* I: Number of samples */
+    double *heights             /* O: Height of each sample (meters) */
+)
+{
+    double pixel_size = metadata->band_metadata[band_index].pixel_size;
+    double map_y;               /* Map Y of the line */
+    int dem_line;               /* DEM line of the line */
+    int index;                  /* Sample index */
+    int status = SUCCESS;       /* Status of the lookups */
+
+    map_y = metadata->corners.upleft.y - line * pixel_size;
+    dem_line = (int)floor((dem->ul_y - map_y) / dem->pixel_y + 0.5);
+
+#ifdef _OPENMP
+    #pragma omp critical (l8_angles_dem)
+#endif
+    {
+        int tile = -1;          /* Tile of the last lookup */
+        const float *tile_heights = NULL; /* Heights of the tile */
+
+        dem->lookups += num_samps;
+        for (index = 0; index < num_samps; index++)
+        {
+            double map_x = metadata->corners.upleft.x
+                + (first_samp + index * samp_step) * pixel_size;
+            int dem_samp = (int)floor((map_x - dem->ul_x) / dem->pixel_x
+                + 0.5);
+            int samp_tile;      /* Tile of the sample */
+
+            heights[index] = 0.0;
+            if (status != SUCCESS || dem_line < 0 || dem_line >= dem->nlines
+                || dem_samp < 0 || dem_samp >= dem->nsamps)
+            {
+                continue;
+            }
+
+            samp_tile = (dem_line / L8_DEM_TILE_SIZE) * dem->tiles_across
+                + dem_samp / L8_DEM_TILE_SIZE;
+            if (samp_tile != tile)
+            {
+                tile = samp_tile;
+                tile_heights = get_dem_tile(dem, tile);
+                if (tile_heights == NULL)
+                {
+                    IAS_LOG_ERROR("Reading the DEM tile for line %d sample "
+                        "%d", dem_line, dem_samp);
+                    status = ERROR;
+                    continue;
+                }
+            }
+
+            heights[index] = tile_heights[
+                (dem_line % L8_DEM_TILE_SIZE) * L8_DEM_TILE_SIZE
+                + dem_samp % L8_DEM_TILE_SIZE];
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,363 @@
+/* Standard Library Includes */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* IAS Library Includes */
+#include "ias_logging.h"
+#include "ias_angle_gen_distro.h"
+#include "ias_miscellaneous.h"
+#include "ias_satellite_attributes.h"
+
+/* Local Includes */
+#include "l8_angles.h"
+
+/* Angle metadata of a scene, held for point queries */
+struct l8_angles_query
+{
+    IAS_ANGLE_GEN_METADATA metadata; /* Angle metadata structure */
+    L8_ANGLES_DEM *dem;         /* DEM giving the heights, or NULL to use
+                                   zero height */
+    IAS_MISC_LINE_EXTENT *trim_lut[IAS_MAX_NBANDS]; /* Trim lookup table of
+                                   each band, NULL if the band isn't
+                                   present */
+};
+
+/* Point of a query in evaluation order */
+typedef struct l8_point_order
+{
+    int band_index;             /* Band index of the point */
+    int line;                   /* L1T line of the point */
+    int samp;                   /* L1T sample of the point */
+    int point;                  /* Index of the point in the query */
+} L8_POINT_ORDER;
+
+/******************************************************************************
+NAME: l8_angles_open_query
+
+PURPOSE: Reads the angle coefficient file of a scene, and sets it up for the
+angles to be evaluated at individual pixels.
+
+RETURN VALUE: Type = L8_ANGLES_QUERY *
+    Value     Description
+    -----     -----------
+    non-NULL  The query handle of the scene
+    NULL      An error occurred reading the angle coefficient file or the DEM
+
+NOTES:
+  1. The angle coefficient file is read through the ANG cache (see
+     ias_angle_gen_read_ang), so opening a scene queried before only loads
+     the cached metadata.
+  2. The trim lookup tables of the bands are built up front, so
+     l8_angles_query_points doesn't change the metadata.  The DEM tile cache
+     does change, so a query with a DEM must only be used by one thread at
+     a time.
+  3. Release the handle with l8_angles_close_query.
+******************************************************************************/
+L8_ANGLES_QUERY *l8_angles_open_query
+(
+    const char *angle_coeff_name, /* I: Angle coefficient filename */
+    const char *dem_filename    /* I: DEM giving the height of each pixel, or
+                                      NULL to use zero height */
+)
+{
+    L8_ANGLES_QUERY *query;     /* Query handle */
+    int band_index;             /* Band index */
+    int other_index;            /* Earlier band index */
+
+    if (ias_log_initialize("L8 Angles") != SUCCESS)
+    {
+        IAS_LOG_ERROR("Error initializing logging library");
+        return NULL;
+    }
+
+    query = calloc(1, sizeof(*query));
+    if (query == NULL)
+    {
+        IAS_LOG_ERROR("Allocating the angle query");
+        return NULL;
+    }
+
+    if (ias_angle_gen_read_ang(angle_coeff_name, &query->metadata) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reading the metadata file %s", angle_coeff_name);
+        free(query);
+        return NULL;
+    }
+    query->metadata.single_precision_flag = use_single_precision_angles();
+
+    /* The bands of a resolution group usually have the same active image
+       area, so they share their lookup table */
+    for (band_index = 0; band_index < IAS_MAX_NBANDS; band_index++)
+    {
+        if (!query->metadata.band_present[band_index])
+            continue;
+
+        for (other_index = 0; other_index < band_index; other_index++)
+        {
+            if (query->trim_lut[other_index] != NULL
+                && same_active_area(&query->metadata, band_index,
+                    other_index))
+            {
+                query->trim_lut[band_index] = query->trim_lut[other_index];
+                break;
+            }
+        }
+        if (query->trim_lut[band_index] != NULL)
+            continue;
+
+        query->trim_lut[band_index] = ias_misc_create_output_image_trim_lut(
+            get_active_lines(&query->metadata, band_index),
+            get_active_samples(&query->metadata, band_index),
+            query->metadata.band_metadata[band_index].l1t_lines,
+            query->metadata.band_metadata[band_index].l1t_samps);
+        if (query->trim_lut[band_index] == NULL)
+        {
+            IAS_LOG_ERROR("Creating the trim lookup table for band index %d",
+                band_index);
+            l8_angles_close_query(query);
+            return NULL;
+        }
+    }
+
+    if (dem_filename != NULL)
+    {
+        query->dem = l8_angles_open_dem(dem_filename);
+        if (query->dem == NULL)
+        {
+            IAS_LOG_ERROR("Opening the DEM %s", dem_filename);
+            l8_angles_close_query(query);
+            return NULL;
+        }
+    }
+
+    return query;
+}
+
+/******************************************************************************
+NAME: l8_angles_close_query
+
+PURPOSE: Releases a query handle opened by l8_angles_open_query.
+
+RETURN VALUE: Type = None
+******************************************************************************/
+void l8_angles_close_query
+(
+    L8_ANGLES_QUERY *query      /* I/O: Query handle to close (or NULL) */
+)
+{
+    int band_index;             /* Band index */
+    int other_index;            /* Later band index */
+
+    if (query == NULL)
+        return;
+
+    /* Free the lookup tables shared between bands only once */
+    for (band_index = 0; band_index < IAS_MAX_NBANDS; band_index++)
+    {
+        if (query->trim_lut[band_index] == NULL)
+            continue;
+
+        for (other_index = band_index + 1; other_index < IAS_MAX_NBANDS;
+             other_index++)
+        {
+            if (query->trim_lut[other_index] == query->trim_lut[band_index])
+                query->trim_lut[other_index] = NULL;
+        }
+        free(query->trim_lut[band_index]);
+    }
+
+    l8_angles_close_dem(query->dem);
+    ias_angle_gen_free(&query->metadata);
+    free(query);
+}
+
+/******************************************************************************
+NAME: compare_point_order
+
+PURPOSE: Orders the points of a query by band, line and sample, for qsort.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    < 0       The first point is evaluated first
+    0         The points are the same pixel
+    > 0       The second point is evaluated first
+******************************************************************************/
+static int compare_point_order
+(
+    const void *first,          /* I: First point (L8_POINT_ORDER) */
+    const void *second          /* I: Second point (L8_POINT_ORDER) */
+)
+{
+    const L8_POINT_ORDER *point1 = first;   /* First point */
+    const L8_POINT_ORDER *point2 = second;  /* Second point */
+
+    if (point1->band_index != point2->band_index)
+        return (point1->band_index < point2->band_index) ? -1 : 1;
+    if (point1->line != point2->line)
+        return (point1->line < point2->line) ? -1 : 1;
+    if (point1->samp != point2->samp)
+        return (point1->samp < point2->samp) ? -1 : 1;
+    return 0;
+}
+
+/******************************************************************************
+NAME: l8_angles_query_points
+
+PURPOSE: Evaluates the solar and/or satellite angles at a set of pixels of the
+scene of a query handle.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were evaluated
+    ERROR     A point has an invalid band number, or an error occurred
+              evaluating the angles
+
+NOTES:
+  1. The angles are the exact angles create_angle_bands gives the pixels
+     with a grid spacing of 1, in degrees rather than hundredths of degrees.
+     The points outside the active image area of their band, where the
+     angle bands are fill, have in_scene cleared and zero angles.
+  2. The points are evaluated in the order of their band, line and sample,
+     so the points of a line share the line dependent parts of the rational
+     polynomials and the SCA search (see calculate_line_angles).  The runs
+     of equally spaced samples along a line, such as the pixels of a field
+     plot, are evaluated together, IAS_ANGLE_GEN_LINE_CHUNK at a time.
+  3. The angles not generated for angle_type are set to zero.
+******************************************************************************/
+int l8_angles_query_points
+(
+    L8_ANGLES_QUERY *query,     /* I: Query handle of the scene */
+    ANGLE_TYPE angle_type,      /* I: Angles to evaluate (solar, satellite or
+                                      both) */
+    int num_points,             /* I: Number of points */
+    L8_ANGLE_POINT *points      /* I/O: Points, with the angles set on
+                                        return */
+)
+{
+    double sat_angles[2 * IAS_ANGLE_GEN_LINE_CHUNK]; /* Viewing angles */
+    double sun_angles[2 * IAS_ANGLE_GEN_LINE_CHUNK]; /* Solar angles */
+    double r2d = 45.0 / atan(1.0);  /* Conversion of radians to degrees */
+    L8_POINT_ORDER *order;      /* Points in the scene, in evaluation order */
+    const IAS_MISC_LINE_EXTENT *extent; /* Trim extent of the point line */
+    L8_ANGLE_POINT *point;      /* Current point */
+    int num_order = 0;          /* Number of points in the scene */
+    int band_index;             /* Band index of the point */
+    int run_start;              /* First point of the run of samples */
+    int run_length;             /* Number of points in the run */
+    int samp_step;              /* Spacing of the samples of the run */
+    int index;                  /* Point index */
+
+    if (num_points <= 0)
+        return SUCCESS;
+
+    order = malloc(num_points * sizeof(*order));
+    if (order == NULL)
+    {
+        IAS_LOG_ERROR("Allocating the order of %d points", num_points);
+        return ERROR;
+    }
+
+    /* Find the points in the scene, and clear the angles of the others */
+    for (index = 0; index < num_points; index++)
+    {
+        point = &points[index];
+        point->in_scene = 0;
+        point->solar_zenith = 0.0;
+        point->solar_azimuth = 0.0;
+        point->sat_zenith = 0.0;
+        point->sat_azimuth = 0.0;
+
+        band_index = ias_sat_attr_convert_band_number_to_index(
+            point->band_number);
+        if (band_index < 0 || band_index >= IAS_MAX_NBANDS
+            || query->trim_lut[band_index] == NULL)
+        {
+            IAS_LOG_ERROR("Band number %d of point %d isn't in the scene",
+                point->band_number, index);
+            free(order);
+            return ERROR;
+        }
+
+        if (point->line < 0
+            || point->line >= query->metadata.band_metadata[band_index].
+                l1t_lines
+            || point->samp < 0
+            || point->samp >= query->metadata.band_metadata[band_index].
+                l1t_samps)
+            continue;
+        extent = &query->trim_lut[band_index][point->line];
+        if (point->samp <= extent->start_sample
+            || point->samp >= extent->end_sample)
+            continue;
+
+        point->in_scene = 1;
+        order[num_order].band_index = band_index;
+        order[num_order].line = point->line;
+        order[num_order].samp = point->samp;
+        order[num_order].point = index;
+        num_order++;
+    }
+
+    qsort(order, num_order, sizeof(*order), compare_point_order);
+
+    /* Evaluate the runs of equally spaced samples along each line */
+    for (run_start = 0; run_start < num_order; run_start += run_length)
+    {
+        run_length = 1;
+        samp_step = 1;
+        if (run_start + 1 < num_order
+            && order[run_start + 1].band_index == order[run_start].band_index
+            && order[run_start + 1].line == order[run_start].line
+            && order[run_start + 1].samp > order[run_start].samp)
+        {
+            samp_step = order[run_start + 1].samp - order[run_start].samp;
+            while (run_length < IAS_ANGLE_GEN_LINE_CHUNK
+                && run_start + run_length < num_order
+                && order[run_start + run_length].band_index
+                    == order[run_start].band_index
+                && order[run_start + run_length].line
+                    == order[run_start].line
+                && order[run_start + run_length].samp
+                    == order[run_start].samp + run_length * samp_step)
+            {
+                run_length++;
+            }
+        }
+
+        if (calculate_line_angles(&query->metadata, query->dem,
+            order[run_start].line, order[run_start].samp, samp_step,
+            run_length, order[run_start].band_index, angle_type, sat_angles,
+            sun_angles) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Evaluating angles at line %d sample %d",
+                order[run_start].line, order[run_start].samp);
+            free(order);
+            return ERROR;
+        }
+
+        for (index = 0; index < run_length; index++)
+        {
+            point = &points[order[run_start + index].point];
+            if (angle_type != AT_SATELLITE)
+            {
+                point->solar_zenith = r2d
+                    * sun_angles[2 * index + IAS_ANGLE_GEN_ZENITH_INDEX];
+                point->solar_azimuth = r2d
+                    * sun_angles[2 * index + IAS_ANGLE_GEN_AZIMUTH_INDEX];
+            }
+            if (angle_type != AT_SOLAR)
+            {
+                point->sat_zenith = r2d
+                    * sat_angles[2 * index + IAS_ANGLE_GEN_ZENITH_INDEX];
+                point->sat_azimuth = r2d
+                    * sat_angles[2 * index + IAS_ANGLE_GEN_AZIMUTH_INDEX];
+            }
+        }
+    }
+
+    free(order);
+    return SUCCESS;
+}
@@ -0,0 +1,273 @@
+/* Standard Library Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+/* IAS Library Includes */
+#include "ias_logging.h"
+#include "ias_angle_gen_private.h"
+
+/* Local Defines */
+#define CACHE_MAGIC "IASANGC"   /* Identifies an ANG cache file */
+#define CACHE_VERSION 1         /* Version of the cache layout */
+#define CACHE_EXTENSION ".cache" /* Added to the ANG file name */
+#define HASH_BUFFER_SIZE 65536  /* Bytes read at a time for the hash */
+#define FNV_OFFSET_BASIS 14695981039346656037ULL /* 64-bit FNV-1a basis */
+#define FNV_PRIME 1099511628211ULL /* 64-bit FNV-1a prime */
+
+/* Header at the start of an ANG cache file.  The cache holds the raw
+   structures, so it is only valid on the system that wrote it; the version
+   and structure size catch layout changes. */
+typedef struct ang_cache_header
+{
+    char magic[8];              /* CACHE_MAGIC */
+    int version;                /* CACHE_VERSION */
+    int metadata_size;          /* Size of IAS_ANGLE_GEN_METADATA */
+    int ephem_count;            /* Number of ephemeris samples */
+    IAS_ANGLE_GEN_CACHE_KEY key; /* Key of the ANG file that was parsed */
+} ANG_CACHE_HEADER;
+
+/*******************************************************************************
+Name: get_cache_filename
+
+Purpose: Builds the name of the cache file for an ANG file.
+
+Return:
+    Type = integer
+    SUCCESS / ERROR if the name is too long
+ ******************************************************************************/
+static int get_cache_filename
+(
+    const char *ang_filename,   /* I: Angle file name */
+    char *cache_filename        /* O: Cache file name (PATH_MAX) */
+)
+{
+    int count;                  /* Number of characters in the name */
+
+    count = snprintf(cache_filename, PATH_MAX, "%s%s", ang_filename,
+        CACHE_EXTENSION);
+    if (count < 0 || count >= PATH_MAX)
+        return ERROR;
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_get_cache_key
+
+Purpose: Computes the key identifying the contents of an ANG file: the size
+         and the 64-bit FNV-1a hash of the file.
+
+Return:
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+int ias_angle_gen_get_cache_key
+(
+    const char *ang_filename,   /* I: Angle file name */
+    IAS_ANGLE_GEN_CACHE_KEY *key /* O: Key of the file contents */
+)
+{
+    unsigned char buffer[HASH_BUFFER_SIZE]; /* File contents */
+    size_t count;               /* Bytes read */
+    size_t index;               /* Byte index */
+    FILE *fp;                   /* ANG file pointer */
+
+    fp = fopen(ang_filename, "rb");
+    if (!fp)
+    {
+        IAS_LOG_ERROR("Opening %s", ang_filename);
+        return ERROR;
+    }
+
+    key->hash = FNV_OFFSET_BASIS;
+    key->size = 0;
+    while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        for (index = 0; index < count; index++)
+        {
+            key->hash ^= buffer[index];
+            key->hash *= FNV_PRIME;
+        }
+        key->size += count;
+    }
+
+    if (ferror(fp))
+    {
+        IAS_LOG_ERROR("Reading %s", ang_filename);
+        fclose(fp);
+        return ERROR;
+    }
+    fclose(fp);
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_load_ang_cache
+
+Purpose: Loads the angle metadata from the cache of an ANG file, if there is
+         a cache for the same ANG contents.
+
+Note: A missing, stale, or unreadable cache isn't an error; the ANG file
+      simply needs to be parsed.  The caller is responsible for calling
+      ias_angle_gen_free when the metadata is loaded.
+
+Return:
+    Type = integer
+    1 if the metadata was loaded, 0 if not
+ ******************************************************************************/
+int ias_angle_gen_load_ang_cache
+(
+    const char *ang_filename,   /* I: Angle file name */
+    const IAS_ANGLE_GEN_CACHE_KEY *key, /* I: Key of the ANG file contents */
+    IAS_ANGLE_GEN_METADATA *metadata /* O: Metadata structure to load */
+)
+{
+    char cache_filename[PATH_MAX]; /* Cache file name */
+    ANG_CACHE_HEADER header;    /* Cache file header */
+    FILE *fp;                   /* Cache file pointer */
+
+    if (get_cache_filename(ang_filename, cache_filename) != SUCCESS)
+        return 0;
+
+    fp = fopen(cache_filename, "rb");
+    if (!fp)
+        return 0;
+
+    /* Make sure the cache matches this ANG file and library */
+    if (fread(&header, sizeof(header), 1, fp) != 1
+        || memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != CACHE_VERSION
+        || header.metadata_size != (int)sizeof(*metadata)
+        || header.ephem_count < 1
+        || header.key.hash != key->hash || header.key.size != key->size)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    if (fread(metadata, sizeof(*metadata), 1, fp) != 1)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    /* The stored pointers are meaningless, so allocate the ephemeris and
+       solar vectors again */
+    metadata->ephem_count = header.ephem_count;
+    metadata->transformation = NULL;
+    if (ias_angle_gen_initialize(metadata) != SUCCESS)
+    {
+        metadata->ephemeris = NULL;
+        metadata->solar_vector = NULL;
+        fclose(fp);
+        return 0;
+    }
+
+    if (fread(metadata->ephemeris, sizeof(*metadata->ephemeris),
+            metadata->ephem_count, fp) != (size_t)metadata->ephem_count
+        || fread(metadata->solar_vector, sizeof(*metadata->solar_vector),
+            metadata->ephem_count, fp) != (size_t)metadata->ephem_count)
+    {
+        ias_angle_gen_free(metadata);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    return 1;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_write_ang_cache
+
+Purpose: Writes the angle metadata parsed from an ANG file to its cache, so
+         later runs on the same ANG file can skip parsing it.
+
+Note: The cache is written to a temporary file that is renamed into place,
+      so concurrent runs never see a partial cache.
+
+Return:
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+int ias_angle_gen_write_ang_cache
+(
+    const char *ang_filename,   /* I: Angle file name */
+    const IAS_ANGLE_GEN_CACHE_KEY *key, /* I: Key of the ANG file contents */
+    const IAS_ANGLE_GEN_METADATA *metadata /* I: Metadata structure */
+)
+{
+    char cache_filename[PATH_MAX]; /* Cache file name */
+    char temp_filename[PATH_MAX];  /* Temporary cache file name */
+    IAS_ANGLE_GEN_METADATA stored; /* Metadata as stored */
+    ANG_CACHE_HEADER header;    /* Cache file header */
+    int count;                  /* Number of characters in the name */
+    FILE *fp;                   /* Cache file pointer */
+
+    if (get_cache_filename(ang_filename, cache_filename) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Cache file name for %s is too long", ang_filename);
+        return ERROR;
+    }
+    count = snprintf(temp_filename, sizeof(temp_filename), "%s.%ld",
+        cache_filename, (long)getpid());
+    if (count < 0 || count >= (int)sizeof(temp_filename))
+    {
+        IAS_LOG_ERROR("Cache file name for %s is too long", ang_filename);
+        return ERROR;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.metadata_size = sizeof(*metadata);
+    header.ephem_count = metadata->ephem_count;
+    header.key = *key;
+
+    /* Don't store the pointers */
+    stored = *metadata;
+    stored.ephemeris = NULL;
+    stored.solar_vector = NULL;
+    stored.transformation = NULL;
+
+    fp = fopen(temp_filename, "wb");
+    if (!fp)
+    {
+        IAS_LOG_ERROR("Opening cache file %s", temp_filename);
+        return ERROR;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1
+        || fwrite(&stored, sizeof(stored), 1, fp) != 1
+        || fwrite(metadata->ephemeris, sizeof(*metadata->ephemeris),
+            metadata->ephem_count, fp) != (size_t)metadata->ephem_count
+        || fwrite(metadata->solar_vector, sizeof(*metadata->solar_vector),
+            metadata->ephem_count, fp) != (size_t)metadata->ephem_count)
+    {
+        IAS_LOG_ERROR("Writing cache file %s", temp_filename);
+        fclose(fp);
+        remove(temp_filename);
+        return ERROR;
+    }
+
+    if (fclose(fp) != 0)
+    {
+        IAS_LOG_ERROR("Closing cache file %s", temp_filename);
+        remove(temp_filename);
+        return ERROR;
+    }
+
+    if (rename(temp_filename, cache_filename) != 0)
+    {
+        IAS_LOG_ERROR("Renaming cache file %s to %s", temp_filename,
+            cache_filename);
+        remove(temp_filename);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
@@ -6,23 +6,58 @@
 #include "ias_math.h"
 #include "ias_angle_gen_private.h"
 
+/* The per-pixel rational polynomial evaluation is also compiled for the
+   offload device, for ias_angle_gen_calculate_tile_angles_rpc */
+#ifdef ENABLE_OFFLOAD
+#pragma omp declare target
+#endif
+
 /*******************************************************************************
-Name: calculate_rpc_vector_value
+Name: calculate_rpc_terms
 
-Purpose: Calculates the individual vector value used to evaluate the
-         rational polynomial coefficient.
+Purpose: Calculates the polynomial terms shared by the numerator and
+         denominator of the rational polynomial coefficients.  The terms
+         only depend on the location, so they can be reused for each of the
+         vector components and for both the satellite and solar angles.
  
 Return:
     Type = void
  ******************************************************************************/
-static void calculate_rpc_vector_value
+static void calculate_rpc_terms
 (
     double l1t_line,           /* I: L1T line coordinate */
     double l1t_samp,           /* I: L1T sample coordinate */
     double l1r_line,           /* I: L1R line coordinate */
     double l1r_samp,           /* I: L1R sample coordinate */
-    double mean_offset,        /* I: Vector mean offset */
     double height,             /* I: Input height */
+    double *terms              /* O: Polynomial terms, the first is always 1 */
+)
+{
+    terms[0] = 1.0;
+    terms[1] = l1t_line;
+    terms[2] = l1t_samp;
+    terms[3] = height;
+    terms[4] = l1r_line;
+    terms[5] = l1t_line * l1t_line;
+    terms[6] = l1t_samp * l1t_line;
+    terms[7] = l1t_samp * l1t_samp;
+    terms[8] = l1r_samp * l1r_line * l1r_line;
+    terms[9] = l1r_line * l1r_line * l1r_line;
+}
+
+/*******************************************************************************
+Name: calculate_rpc_vector_value
+
+Purpose: Calculates the individual vector value used to evaluate the
+         rational polynomial coefficient.
+ 
+Return:
+    Type = void
+ ******************************************************************************/
+static void calculate_rpc_vector_value
+(
+    const double *terms,       /* I: Polynomial terms */
+    double mean_offset,        /* I: Vector mean offset */
     const double *numerator,   /* I: Numerator values pointer */
     const double *denominator, /* I: Denominator values pointer */
     double *output_value       /* O: Output vector value */ 
@@ -30,46 +65,88 @@ static void calculate_rpc_vector_value
 {
     double equation_num;    /* Equation numerator */
     double equation_den;    /* Equation denominator */
+    int index;              /* Term index */
 
-    /* Calculate the numerator */
-    equation_num = numerator[0] + numerator[1] * l1t_line
-        + numerator[2] * l1t_samp
-        + numerator[3] * height
-        + numerator[4] * l1r_line
-        + numerator[5] * l1t_line * l1t_line
-        + numerator[6] * l1t_samp * l1t_line 
-        + numerator[7] * l1t_samp * l1t_samp
-        + numerator[8] * l1r_samp * l1r_line * l1r_line
-        + numerator[9] * l1r_line * l1r_line * l1r_line;
-       
-    /* Calculate the denominator */
-    equation_den = 1.0 + denominator[0] * l1t_line
-        + denominator[1] * l1t_samp
-        + denominator[2] * height
-        + denominator[3] * l1r_line 
-        + denominator[4] * l1t_line * l1t_line 
-        + denominator[5] * l1t_line * l1t_samp
-        + denominator[6] * l1t_samp * l1t_samp
-        + denominator[7] * l1r_samp * l1r_line * l1r_line
-        + denominator[8] * l1r_line * l1r_line * l1r_line;
+    /* Calculate the numerator and denominator.  The denominator has no
+       coefficient for the constant term. */
+    equation_num = numerator[0];
+    equation_den = 1.0;
+    for (index = 1; index < IAS_ANGLE_GEN_ANG_RPC_COEF; index++)
+    {
+        equation_num += numerator[index] * terms[index];
+        equation_den += denominator[index - 1] * terms[index];
+    }
    
     *output_value = mean_offset + (equation_num / equation_den);
 }
 
+#ifdef ENABLE_OFFLOAD
+#pragma omp end declare target
+#endif
+
 /*******************************************************************************
-Name: ias_angle_gen_calculate_angle_rpc
+Name: calculate_rpc_angles
 
-Purpose: Calculates the satellite viewing and solar illumination zenith and 
-         azimuth angles for a specified L1T line/sample and height (from DEM)
-         using the rational polynomial coefficients for the current band. If
-         the SCA location falls in the SCA overlap area it returns the
-         average value of the combined SCAs.
+Purpose: Calculates the zenith and azimuth angles for one set of rational
+         polynomial coefficients from the polynomial terms, and adds them to
+         the angles.
+ 
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+static int calculate_rpc_angles
+(
+    const IAS_ANGLE_GEN_ANG_RPC *data_ptr, /* I: Solar or satellite data */
+    const double *terms,    /* I: Polynomial terms */
+    double *angle           /* I/O: Zenith and azimuth angle sums */
+)
+{
+    IAS_VECTOR unit_vector;     /* Normalized vector */
+    IAS_VECTOR vector;          /* Viewing vector */
+
+    /* Calculate the rpc vector */ 
+    calculate_rpc_vector_value(terms, data_ptr->mean_offset.x,
+        data_ptr->x_terms.numerator, data_ptr->x_terms.denominator, 
+        &vector.x);
+
+    calculate_rpc_vector_value(terms, data_ptr->mean_offset.y,
+        data_ptr->y_terms.numerator, data_ptr->y_terms.denominator, 
+        &vector.y);
+
+    calculate_rpc_vector_value(terms, data_ptr->mean_offset.z,
+        data_ptr->z_terms.numerator, data_ptr->z_terms.denominator, 
+        &vector.z);
+
+    /* Normalize the vector in case the polynomial fit results in non-unit
+       vectors that will fail the following trig functions */
+    if (ias_math_compute_unit_vector(&vector, &unit_vector) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Unable to normalize the rpc vector");
+        return ERROR;
+    }
+
+    /* Calculate zenith and azimuth angles */
+    angle[IAS_ANGLE_GEN_ZENITH_INDEX] += acos(unit_vector.z);
+    angle[IAS_ANGLE_GEN_AZIMUTH_INDEX] += atan2(unit_vector.x, 
+        unit_vector.y);
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: calculate_angles_rpc
+
+Purpose: Calculates the zenith and azimuth angles for a specified L1T
+         line/sample and height for one or more sets of rational polynomial
+         coefficients of the current band.  The SCAs are located and the
+         polynomial terms are calculated only once for all the sets.
 
 Return: 
     Type = integer
     SUCCESS / ERROR
  ******************************************************************************/
-int ias_angle_gen_calculate_angles_rpc
+static int calculate_angles_rpc
 (
     const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
     double l1t_line,        /* I: Output space line coordinate */
@@ -77,20 +154,21 @@ int ias_angle_gen_calculate_angles_rpc
     const double *elev,     /* I: Pointer to input elevation or NULL if mean
                               scene height should be used*/
     int band_index,         /* I: Current band index */
-    IAS_ANGLE_GEN_TYPE sat_or_sun_type,     /* I: Angle calculation type */
+    int num_types,          /* I: Number of angle types to calculate */
+    const IAS_ANGLE_GEN_TYPE *types, /* I: Angle calculation types */
     int *outside_image_flag,/* O: Flag indicating return was outside image */
-    double *angle           /* O: Array containing zenith and azimuth angles */
+    double **angles         /* O: Zenith and azimuth angles for each type */
 )       
 {
     int nsca_found;     /* Number of SCAS containing the point */
     int sca_index;      /* SCA index */
+    int type_index;     /* Angle type index */
     double height;      /* Model height */
     double l1r_line[2]; /* Input space (L1R) line coordinate declared size 2
                            so it can support 2 SCAs */
     double l1r_samp[2]; /* Input space (L1R) sample coordinate declared size
                            2 so it can support 2 SCAs */
     const IAS_ANGLE_GEN_BAND *band_ptr;    /* Pointer to current band */
-    const IAS_ANGLE_GEN_ANG_RPC *data_ptr; /* Solar or satellite data pointer */
 
     /* Check that the band index is valid */
     if (!ias_angle_gen_valid_band_index(metadata, band_index))
@@ -100,8 +178,11 @@ int ias_angle_gen_calculate_angles_rpc
     }
 
     /* Initialize the output zenith and azimuth*/
-    angle[IAS_ANGLE_GEN_ZENITH_INDEX] = 0.0;
-    angle[IAS_ANGLE_GEN_AZIMUTH_INDEX] = 0.0;
+    for (type_index = 0; type_index < num_types; type_index++)
+    {
+        angles[type_index][IAS_ANGLE_GEN_ZENITH_INDEX] = 0.0;
+        angles[type_index][IAS_ANGLE_GEN_AZIMUTH_INDEX] = 0.0;
+    }
     *outside_image_flag = 0;
 
     /* Setup the band pointer */
@@ -135,17 +216,10 @@ int ias_angle_gen_calculate_angles_rpc
     l1t_samp -= band_ptr->satellite.samp_terms.l1t_mean_offset;
     height -= band_ptr->satellite.mean_height;
 
-    data_ptr = &band_ptr->solar;
-    if (sat_or_sun_type == IAS_ANGLE_GEN_SATELLITE)
-    {
-        data_ptr = &band_ptr->satellite;
-    }
-
     /* Check the located SCAs */
     for (sca_index = 0; sca_index < nsca_found; sca_index++)
     {
-        IAS_VECTOR unit_vector;     /* Normalized vector */
-        IAS_VECTOR vector;          /* Viewing vector */
+        double terms[IAS_ANGLE_GEN_ANG_RPC_COEF]; /* Polynomial terms */
         double l1r_line_from_offset;/* L1R line location using offset */        
         double l1r_samp_from_offset;/* L1R sample location using offset */
 
@@ -155,39 +229,915 @@ int ias_angle_gen_calculate_angles_rpc
         l1r_samp_from_offset = l1r_samp[sca_index] 
             - band_ptr->satellite.samp_terms.l1r_mean_offset;
 
-        /* Calculate the rpc vector */ 
-        calculate_rpc_vector_value(l1t_line, l1t_samp, l1r_line_from_offset, 
-            l1r_samp_from_offset, data_ptr->mean_offset.x, height, 
-            data_ptr->x_terms.numerator, data_ptr->x_terms.denominator, 
-            &vector.x);
-
-        calculate_rpc_vector_value(l1t_line, l1t_samp, l1r_line_from_offset, 
-            l1r_samp_from_offset, data_ptr->mean_offset.y, height, 
-            data_ptr->y_terms.numerator, data_ptr->y_terms.denominator, 
-            &vector.y);
-
-        calculate_rpc_vector_value(l1t_line, l1t_samp, l1r_line_from_offset, 
-            l1r_samp_from_offset, data_ptr->mean_offset.z, height, 
-            data_ptr->z_terms.numerator, data_ptr->z_terms.denominator, 
-            &vector.z);
-
-        /* Normalize the vector in case the polynomial fit results in non-unit
-           vectors that will fail the following trig functions */
-        if (ias_math_compute_unit_vector(&vector, &unit_vector) != SUCCESS)
+        calculate_rpc_terms(l1t_line, l1t_samp, l1r_line_from_offset,
+            l1r_samp_from_offset, height, terms);
+
+        for (type_index = 0; type_index < num_types; type_index++)
         {
-            IAS_LOG_ERROR("Unable to normalize the rpc vector");
-            return ERROR;
-        }
+            const IAS_ANGLE_GEN_ANG_RPC *data_ptr = &band_ptr->solar;
+                                    /* Solar or satellite data pointer */
 
-        /* Calculate zenith and azimuth angles */
-        angle[IAS_ANGLE_GEN_ZENITH_INDEX] += acos(unit_vector.z);
-        angle[IAS_ANGLE_GEN_AZIMUTH_INDEX] += atan2(unit_vector.x, 
-            unit_vector.y);
+            if (types[type_index] == IAS_ANGLE_GEN_SATELLITE)
+            {
+                data_ptr = &band_ptr->satellite;
+            }
+
+            if (calculate_rpc_angles(data_ptr, terms, angles[type_index])
+                != SUCCESS)
+            {
+                return ERROR;
+            }
+        }
     }
 
     /* Average the angles */
-    angle[IAS_ANGLE_GEN_ZENITH_INDEX] /= nsca_found;
-    angle[IAS_ANGLE_GEN_AZIMUTH_INDEX] /= nsca_found;
+    for (type_index = 0; type_index < num_types; type_index++)
+    {
+        angles[type_index][IAS_ANGLE_GEN_ZENITH_INDEX] /= nsca_found;
+        angles[type_index][IAS_ANGLE_GEN_AZIMUTH_INDEX] /= nsca_found;
+    }
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_calculate_angle_rpc
+
+Purpose: Calculates the satellite viewing and solar illumination zenith and 
+         azimuth angles for a specified L1T line/sample and height (from DEM)
+         using the rational polynomial coefficients for the current band. If
+         the SCA location falls in the SCA overlap area it returns the
+         average value of the combined SCAs.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+int ias_angle_gen_calculate_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double l1t_samp,        /* I: Output space sample coordinate */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    IAS_ANGLE_GEN_TYPE sat_or_sun_type,     /* I: Angle calculation type */
+    int *outside_image_flag,/* O: Flag indicating return was outside image */
+    double *angle           /* O: Array containing zenith and azimuth angles */
+)       
+{
+    return calculate_angles_rpc(metadata, l1t_line, l1t_samp, elev,
+        band_index, 1, &sat_or_sun_type, outside_image_flag, &angle);
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_calculate_sat_sun_angles_rpc
+
+Purpose: Calculates both the satellite viewing and the solar illumination
+         zenith and azimuth angles for a specified L1T line/sample and height
+         (from DEM).  This gives the same angles as calling
+         ias_angle_gen_calculate_angles_rpc for each type, but the SCAs are
+         located and the polynomial terms are calculated only once.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+int ias_angle_gen_calculate_sat_sun_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double l1t_samp,        /* I: Output space sample coordinate */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag indicating return was outside image */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles */
+    double *sun_angle       /* O: Solar zenith and azimuth angles */
+)       
+{
+    IAS_ANGLE_GEN_TYPE types[2] = {IAS_ANGLE_GEN_SATELLITE,
+        IAS_ANGLE_GEN_SOLAR};   /* Angle types to calculate */
+    double *angles[2];          /* Angles for each type */
+
+    angles[0] = sat_angle;
+    angles[1] = sun_angle;
+
+    return calculate_angles_rpc(metadata, l1t_line, l1t_samp, elev,
+        band_index, 2, types, outside_image_flag, angles);
+}
+
+/* Coefficients of one vector component of a rational polynomial for a fixed
+   L1T line and height.  The numerator and denominator become quadratics in
+   the L1T sample plus the terms of the L1R location. */
+typedef struct rpc_line_coefs
+{
+    double mean_offset;     /* Vector mean offset */
+    double num[6];          /* Numerator: constant, sample, sample squared,
+                               L1R line, L1R sample * line^2, L1R line^3 */
+    double den[6];          /* Denominator, in the same order */
+    double num_height;      /* Numerator height coefficient, for heights
+                               that vary along the line */
+    double den_height;      /* Denominator height coefficient */
+} RPC_LINE_COEFS;
+
+/*******************************************************************************
+Name: calculate_rpc_line_coefs
+
+Purpose: Folds the line and height dependent terms of the rational polynomial
+         for one vector component into the coefficients for a line.
+ 
+Return:
+    Type = void
+ ******************************************************************************/
+static void calculate_rpc_line_coefs
+(
+    const IAS_ANGLE_GEN_ANG_RPC_TERMS *rpc_terms, /* I: Component terms */
+    double mean_offset,        /* I: Vector mean offset */
+    double l1t_line,           /* I: L1T line coordinate (offset) */
+    double height,             /* I: Input height (offset) */
+    RPC_LINE_COEFS *coefs      /* O: Coefficients for the line */
+)
+{
+    const double *numerator = rpc_terms->numerator;
+    const double *denominator = rpc_terms->denominator;
+
+    /* See calculate_rpc_terms for the order of the terms */
+    coefs->mean_offset = mean_offset;
+    coefs->num[0] = numerator[0] + numerator[1] * l1t_line
+        + numerator[3] * height + numerator[5] * l1t_line * l1t_line;
+    coefs->num[1] = numerator[2] + numerator[6] * l1t_line;
+    coefs->num[2] = numerator[7];
+    coefs->num[3] = numerator[4];
+    coefs->num[4] = numerator[8];
+    coefs->num[5] = numerator[9];
+    coefs->den[0] = 1.0 + denominator[0] * l1t_line
+        + denominator[2] * height + denominator[4] * l1t_line * l1t_line;
+    coefs->den[1] = denominator[1] + denominator[5] * l1t_line;
+    coefs->den[2] = denominator[6];
+    coefs->den[3] = denominator[3];
+    coefs->den[4] = denominator[7];
+    coefs->den[5] = denominator[8];
+    coefs->num_height = numerator[3];
+    coefs->den_height = denominator[2];
+}
+
+/*******************************************************************************
+Name: calculate_rpc_line_value
+
+Purpose: Evaluates one vector component of a rational polynomial for one
+         sample along a line.
+ 
+Return:
+    Type = double, the vector component
+ ******************************************************************************/
+static inline double calculate_rpc_line_value
+(
+    const RPC_LINE_COEFS *coefs, /* I: Coefficients for the line */
+    double samp,               /* I: L1T sample coordinate (offset) */
+    double line,               /* I: L1R line coordinate (offset) */
+    double l1r_samp,           /* I: L1R sample coordinate (offset) */
+    double height              /* I: Height (offset) not already folded into
+                                     the coefficients */
+)
+{
+    double cubic = l1r_samp * line * line;
+    double line3 = line * line * line;
+    double equation_num;    /* Equation numerator */
+    double equation_den;    /* Equation denominator */
+
+    equation_num = coefs->num[0] + samp * (coefs->num[1]
+        + coefs->num[2] * samp) + coefs->num[3] * line
+        + coefs->num[4] * cubic + coefs->num[5] * line3
+        + coefs->num_height * height;
+    equation_den = coefs->den[0] + samp * (coefs->den[1]
+        + coefs->den[2] * samp) + coefs->den[3] * line
+        + coefs->den[4] * cubic + coefs->den[5] * line3
+        + coefs->den_height * height;
+    return coefs->mean_offset + equation_num / equation_den;
+}
+
+/*******************************************************************************
+Name: calculate_rpc_line_values
+
+Purpose: Evaluates one vector component of a rational polynomial for a run of
+         samples along a line.
+ 
+Return:
+    Type = void
+
+Notes:
+    The loops have no branches or calls, so they can be vectorized.  The
+    height of each sample is only added in when the heights vary along the
+    line; a single height is folded into the coefficients.
+ ******************************************************************************/
+static void calculate_rpc_line_values
+(
+    const RPC_LINE_COEFS *coefs, /* I: Coefficients for the line */
+    int num_samps,             /* I: Number of samples */
+    const double *l1t_samp,    /* I: L1T sample coordinates (offset) */
+    const double *l1r_line,    /* I: L1R line coordinates (offset) */
+    const double *l1r_samp,    /* I: L1R sample coordinates (offset) */
+    const double *height,      /* I: Height (offset) of each sample, or NULL
+                                     if it is folded into the coefficients */
+    double *value              /* O: Vector component for each sample */
+)
+{
+    int index;                 /* Sample index */
+
+    if (height)
+    {
+#ifdef _OPENMP
+        #pragma omp simd
+#endif
+        for (index = 0; index < num_samps; index++)
+        {
+            value[index] = calculate_rpc_line_value(coefs, l1t_samp[index],
+                l1r_line[index], l1r_samp[index], height[index]);
+        }
+        return;
+    }
+
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (index = 0; index < num_samps; index++)
+    {
+        value[index] = calculate_rpc_line_value(coefs, l1t_samp[index],
+            l1r_line[index], l1r_samp[index], 0.0);
+    }
+}
+
+/*******************************************************************************
+Name: calculate_vector_angles_float
+
+Purpose: Converts the vectors of a chunk of samples to zenith and azimuth
+         angles in single precision, and adds them to the angles of the
+         samples in the SCA.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+
+Notes:
+    1. The vectors are evaluated in double precision, since the rational
+       polynomials need it.  Only the normalization and the trig functions
+       are done in single precision, which is plenty for angles quantized to
+       hundredths of a degree, and lets the loop be vectorized (given a
+       vector math library for the trig functions).
+ ******************************************************************************/
+static int calculate_vector_angles_float
+(
+    int num_samps,             /* I: Number of samples */
+    double vector[3][IAS_ANGLE_GEN_LINE_CHUNK], /* I: Vector components */
+    const int *nsca_found,     /* I: SCAs containing each sample */
+    int sca_index,             /* I: SCA the vectors were evaluated for */
+    double *angle              /* I/O: Zenith and azimuth angle sums for each
+                                       sample */
+)
+{
+    float zenith[IAS_ANGLE_GEN_LINE_CHUNK];   /* Zenith angles */
+    float azimuth[IAS_ANGLE_GEN_LINE_CHUNK];  /* Azimuth angles */
+    int zero_length = 0;       /* Count of vectors that can't be normalized */
+    int index;                 /* Sample index */
+
+#ifdef _OPENMP
+    #pragma omp simd reduction(+:zero_length)
+#endif
+    for (index = 0; index < num_samps; index++)
+    {
+        float x = (float)vector[0][index];
+        float y = (float)vector[1][index];
+        float z = (float)vector[2][index];
+        float horizontal = sqrtf(x * x + y * y);
+
+        /* Only the samples in the SCA need a valid vector */
+        zero_length += (horizontal == 0.0f && z == 0.0f
+            && sca_index < nsca_found[index]);
+
+        /* The zenith angle is found from the horizontal and vertical parts
+           rather than with acos, which loses precision near the nadir in
+           single precision.  Neither needs the vector to be normalized. */
+        zenith[index] = atan2f(horizontal, z);
+        azimuth[index] = atan2f(x, y);
+    }
+
+    if (zero_length > 0)
+    {
+        IAS_LOG_ERROR("Unable to normalize the rpc vector");
+        return ERROR;
+    }
+
+    for (index = 0; index < num_samps; index++)
+    {
+        if (sca_index >= nsca_found[index])
+            continue;
+        angle[2 * index + IAS_ANGLE_GEN_ZENITH_INDEX] += zenith[index];
+        angle[2 * index + IAS_ANGLE_GEN_AZIMUTH_INDEX] += azimuth[index];
+    }
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: calculate_line_angles_rpc
+
+Purpose: Calculates the satellite viewing and/or solar illumination zenith and
+         azimuth angles for a run of equally spaced samples along an L1T line,
+         at a single height or at a height for each sample.  See
+         ias_angle_gen_calculate_line_angles_rpc.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+static int calculate_line_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    const double *samp_elev,/* I: Elevation of each sample, or NULL to use
+                                  elev for all of them */
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each sample indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each sample (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  sample (or NULL) */
+)
+{
+    double l1t_samp[IAS_ANGLE_GEN_LINE_CHUNK]; /* L1T samples (offset) */
+    double l1r_line[2][IAS_ANGLE_GEN_LINE_CHUNK]; /* L1R lines (offset) for
+                                                     up to 2 SCAs */
+    double l1r_samp[2][IAS_ANGLE_GEN_LINE_CHUNK]; /* L1R samples (offset) for
+                                                     up to 2 SCAs */
+    double vector[3][IAS_ANGLE_GEN_LINE_CHUNK];   /* Vector components */
+    double samp_offset[IAS_ANGLE_GEN_LINE_CHUNK]; /* Height (offset) of
+                                                   each sample */
+    int nsca_found[IAS_ANGLE_GEN_LINE_CHUNK]; /* SCAs containing each sample */
+    IAS_ANGLE_GEN_SCA_SPAN spans[IAS_ANGLE_GEN_MAX_SCA_SPANS]; /* SCA spans
+                                                                  of the line */
+    int num_spans = 0;      /* Number of SCA spans, 0 if not used */
+    int span_index = 0;     /* Span of the current sample */
+    RPC_LINE_COEFS coefs[2][3]; /* Line coefficients for each angle type and
+                                   vector component */
+    double *angles[2];      /* Angles for each type */
+    const IAS_ANGLE_GEN_BAND *band_ptr; /* Pointer to current band */
+    double height;          /* Model height */
+    double line_offset;     /* L1T line coordinate (offset) */
+    int num_types = 0;      /* Number of angle types to calculate */
+    int type_index;         /* Angle type index */
+    int chunk;              /* First sample of the current chunk */
+
+    /* Check that the band index is valid */
+    if (!ias_angle_gen_valid_band_index(metadata, band_index))
+    {
+        IAS_LOG_ERROR("Band index %d is invalid", band_index);
+        return ERROR;
+    }
+    band_ptr = &metadata->band_metadata[band_index];
+
+    /* Set the height to use.  Heights that vary along the line are added
+       in for each sample instead of being folded into the coefficients. */
+    height = band_ptr->satellite.mean_height;
+    if (elev && !samp_elev) 
+    {
+        height = *elev;
+    }
+
+    /* Fold the line into the coefficients of each angle type */
+    line_offset = l1t_line - band_ptr->satellite.line_terms.l1t_mean_offset;
+    if (sat_angle)
+    {
+        angles[num_types++] = sat_angle;
+    }
+    if (sun_angle)
+    {
+        angles[num_types++] = sun_angle;
+    }
+    for (type_index = 0; type_index < num_types; type_index++)
+    {
+        const IAS_ANGLE_GEN_ANG_RPC *data_ptr = 
+            (angles[type_index] == sat_angle) ? &band_ptr->satellite
+            : &band_ptr->solar;     /* Solar or satellite data pointer */
+        double height_offset = height - band_ptr->satellite.mean_height;
+
+        calculate_rpc_line_coefs(&data_ptr->x_terms, data_ptr->mean_offset.x,
+            line_offset, height_offset, &coefs[type_index][0]);
+        calculate_rpc_line_coefs(&data_ptr->y_terms, data_ptr->mean_offset.y,
+            line_offset, height_offset, &coefs[type_index][1]);
+        calculate_rpc_line_coefs(&data_ptr->z_terms, data_ptr->mean_offset.z,
+            line_offset, height_offset, &coefs[type_index][2]);
+    }
+
+    /* Find the SCAs along the line up front.  If the line is too broken up
+       for the span table, each sample is searched for instead. */
+    if (ias_angle_gen_find_sca_spans(band_ptr, l1t_line, first_samp,
+        samp_step, num_samps, elev, samp_elev, IAS_ANGLE_GEN_MAX_SCA_SPANS,
+        spans, &num_spans) != SUCCESS)
+    {
+        num_spans = 0;
+    }
+
+    for (chunk = 0; chunk < num_samps; chunk += IAS_ANGLE_GEN_LINE_CHUNK)
+    {
+        int chunk_samps;    /* Number of samples in the chunk */
+        int index;          /* Sample index within the chunk */
+        int sca_index;      /* SCA index */
+
+        chunk_samps = num_samps - chunk;
+        if (chunk_samps > IAS_ANGLE_GEN_LINE_CHUNK)
+            chunk_samps = IAS_ANGLE_GEN_LINE_CHUNK;
+
+        /* Locate the SCA(s) of each sample */
+        for (index = 0; index < chunk_samps; index++)
+        {
+            double samp = first_samp + (chunk + index) * samp_step;
+            const double *samp_height = samp_elev ? &samp_elev[chunk + index]
+                : elev;         /* Height of the sample */
+            double sca_line[2]; /* L1R lines for up to 2 SCAs */
+            double sca_samp[2]; /* L1R samples for up to 2 SCAs */
+
+            if (num_spans > 0)
+            {
+                const IAS_ANGLE_GEN_SCA_SPAN *span; /* Span of the sample */
+
+                while (spans[span_index].end_samp <= chunk + index)
+                    span_index++;
+                span = &spans[span_index];
+
+                nsca_found[index] = span->num_scas;
+                for (sca_index = 0; sca_index < span->num_scas; sca_index++)
+                {
+                    ias_angle_gen_sca_location(band_ptr, span->sca[sca_index],
+                        l1t_line, samp, samp_height, &sca_line[sca_index],
+                        &sca_samp[sca_index]);
+                    sca_samp[sca_index] += span->sca[sca_index]
+                        * band_ptr->l1r_samps;
+                }
+            }
+            else
+            {
+                nsca_found[index] = ias_angle_gen_find_scas(band_ptr,
+                    l1t_line, samp, samp_height, sca_line, sca_samp);
+            }
+            if (nsca_found[index] > 2)
+            {
+                IAS_LOG_ERROR("Too many SCAs found locating point in active "
+                    "image");
+                return ERROR;
+            }
+
+            l1t_samp[index] = samp
+                - band_ptr->satellite.samp_terms.l1t_mean_offset;
+            if (samp_elev)
+            {
+                samp_offset[index] = samp_elev[chunk + index]
+                    - band_ptr->satellite.mean_height;
+            }
+            for (sca_index = 0; sca_index < 2; sca_index++)
+            {
+                if (sca_index < nsca_found[index])
+                {
+                    l1r_line[sca_index][index] = sca_line[sca_index]
+                        - band_ptr->satellite.line_terms.l1r_mean_offset;
+                    l1r_samp[sca_index][index] = sca_samp[sca_index]
+                        - band_ptr->satellite.samp_terms.l1r_mean_offset;
+                }
+                else
+                {
+                    l1r_line[sca_index][index] = 0.0;
+                    l1r_samp[sca_index][index] = 0.0;
+                }
+            }
+
+            if (outside_image_flag)
+            {
+                outside_image_flag[chunk + index] = (nsca_found[index] < 1);
+            }
+            for (type_index = 0; type_index < num_types; type_index++)
+            {
+                angles[type_index][2 * (chunk + index)
+                    + IAS_ANGLE_GEN_ZENITH_INDEX] = 0.0;
+                angles[type_index][2 * (chunk + index)
+                    + IAS_ANGLE_GEN_AZIMUTH_INDEX] = 0.0;
+            }
+        }
+
+        /* Evaluate the vectors for each SCA and angle type over the chunk,
+           and add the angles of the samples in that SCA */
+        for (sca_index = 0; sca_index < 2; sca_index++)
+        {
+            for (type_index = 0; type_index < num_types; type_index++)
+            {
+                int axis;   /* Vector component index */
+
+                for (axis = 0; axis < 3; axis++)
+                {
+                    calculate_rpc_line_values(&coefs[type_index][axis],
+                        chunk_samps, l1t_samp, l1r_line[sca_index],
+                        l1r_samp[sca_index], samp_elev ? samp_offset : NULL,
+                        vector[axis]);
+                }
+
+                if (metadata->single_precision_flag)
+                {
+                    if (calculate_vector_angles_float(chunk_samps, vector,
+                        nsca_found, sca_index, &angles[type_index][2 * chunk])
+                        != SUCCESS)
+                    {
+                        return ERROR;
+                    }
+                    continue;
+                }
+
+                for (index = 0; index < chunk_samps; index++)
+                {
+                    IAS_VECTOR rpc_vector;  /* Viewing vector */
+                    IAS_VECTOR unit_vector; /* Normalized vector */
+                    double *angle;          /* Angles of the sample */
+
+                    if (sca_index >= nsca_found[index])
+                        continue;
+
+                    /* Normalize the vector in case the polynomial fit
+                       results in non-unit vectors that will fail the
+                       following trig functions */
+                    rpc_vector.x = vector[0][index];
+                    rpc_vector.y = vector[1][index];
+                    rpc_vector.z = vector[2][index];
+                    if (ias_math_compute_unit_vector(&rpc_vector,
+                        &unit_vector) != SUCCESS)
+                    {
+                        IAS_LOG_ERROR("Unable to normalize the rpc vector");
+                        return ERROR;
+                    }
+
+                    angle = &angles[type_index][2 * (chunk + index)];
+                    angle[IAS_ANGLE_GEN_ZENITH_INDEX] += acos(unit_vector.z);
+                    angle[IAS_ANGLE_GEN_AZIMUTH_INDEX] +=
+                        atan2(unit_vector.x, unit_vector.y);
+                }
+            }
+        }
+
+        /* Average the angles of the samples in the SCA overlap */
+        for (index = 0; index < chunk_samps; index++)
+        {
+            if (nsca_found[index] < 2)
+                continue;
+            for (type_index = 0; type_index < num_types; type_index++)
+            {
+                angles[type_index][2 * (chunk + index)
+                    + IAS_ANGLE_GEN_ZENITH_INDEX] /= nsca_found[index];
+                angles[type_index][2 * (chunk + index)
+                    + IAS_ANGLE_GEN_AZIMUTH_INDEX] /= nsca_found[index];
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_calculate_line_angles_rpc
+
+Purpose: Calculates the satellite viewing and/or solar illumination zenith and
+         azimuth angles for a run of equally spaced samples along an L1T line.
+         This gives the same angles as calling
+         ias_angle_gen_calculate_angles_rpc for each sample, to within
+         rounding.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+
+Notes:
+    1. The line and height dependent parts of the rational polynomials are
+       evaluated once for the line, leaving a quadratic in the sample plus
+       the L1R terms, which is evaluated for the whole run of samples at
+       once.  The SCAs are found for spans of samples along the line (see
+       ias_angle_gen_find_sca_spans) rather than searched for each sample.
+    2. The angles are stored as zenith/azimuth pairs for each sample.  Pass
+       NULL for the angle types that aren't needed.  Samples outside the
+       active image get zero angles and their outside_image_flag set.
+    3. If the single_precision_flag of the metadata is set, the vectors are
+       converted to angles in single precision (see
+       calculate_vector_angles_float).
+ ******************************************************************************/
+int ias_angle_gen_calculate_line_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each sample indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each sample (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  sample (or NULL) */
+)
+{
+    return calculate_line_angles_rpc(metadata, l1t_line, first_samp,
+        samp_step, num_samps, elev, NULL, band_index, outside_image_flag,
+        sat_angle, sun_angle);
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_calculate_line_dem_angles_rpc
+
+Purpose: Calculates the satellite viewing and/or solar illumination zenith and
+         azimuth angles for a run of equally spaced samples along an L1T line,
+         each at its own height (from a DEM).  This gives the same angles as
+         calling ias_angle_gen_calculate_angles_rpc for each sample with its
+         height, to within rounding.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+
+Notes:
+    1. The heights only enter the rational polynomials linearly, so they are
+       added in for each sample while the rest of the line dependent parts
+       are still evaluated once for the line.
+    2. See ias_angle_gen_calculate_line_angles_rpc for the output layout.
+ ******************************************************************************/
+int ias_angle_gen_calculate_line_dem_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples */
+    const double *samp_elev,/* I: Elevation of each sample */
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each sample indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each sample (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  sample (or NULL) */
+)
+{
+    return calculate_line_angles_rpc(metadata, l1t_line, first_samp,
+        samp_step, num_samps, NULL, samp_elev, band_index,
+        outside_image_flag, sat_angle, sun_angle);
+}
+
+#ifdef ENABLE_OFFLOAD
+/*******************************************************************************
+Name: calculate_tile_angles_offload
+
+Purpose: Calculates the angles of a tile of pixels on the offload device.
+         See ias_angle_gen_calculate_tile_angles_rpc.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+
+Notes:
+    1. Each pixel is evaluated independently with the full rational
+       polynomials, SCA search included, so the pixels spread across the
+       device threads.  Errors can't be logged on the device, so they are
+       counted and reported afterwards.
+    2. The band metadata is only copied to the device if it isn't already
+       there from ias_angle_gen_offload_metadata.
+ ******************************************************************************/
+static int calculate_tile_angles_offload
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double first_line,      /* I: Output space coordinate of the first line */
+    double line_step,       /* I: Spacing between the lines */
+    int num_lines,          /* I: Number of lines */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples in each line */
+    const double *elev,     /* I: Pointer to input elevation or NULL */
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Outside image flags (or NULL) */
+    double *sat_angle,      /* O: Satellite angles (or NULL) */
+    double *sun_angle       /* O: Solar angles (or NULL) */
+)
+{
+    const IAS_ANGLE_GEN_BAND *bands = metadata->band_metadata;
+                            /* Band metadata, mapped to the device */
+    size_t num_pixels = (size_t)num_lines * num_samps; /* Pixels in tile */
+    size_t num_flags = outside_image_flag ? num_pixels : 0; /* Flags */
+    size_t num_sat = sat_angle ? 2 * num_pixels : 0; /* Satellite angles */
+    size_t num_sun = sun_angle ? 2 * num_pixels : 0; /* Solar angles */
+    int use_elev = (elev != NULL); /* Flag to use the input elevation */
+    double elevation = elev ? *elev : 0.0; /* Input elevation */
+    int too_many_scas = 0;  /* Pixels in more than 2 SCAs */
+    int zero_length = 0;    /* Vectors that can't be normalized */
+    int line;               /* Line index */
+    int samp;               /* Sample index */
+
+    #pragma omp target teams distribute parallel for collapse(2) \
+        map(to: bands[band_index:1]) \
+        map(from: outside_image_flag[0:num_flags], sat_angle[0:num_sat], \
+            sun_angle[0:num_sun]) \
+        reduction(+:too_many_scas, zero_length)
+    for (line = 0; line < num_lines; line++)
+    {
+        for (samp = 0; samp < num_samps; samp++)
+        {
+            const IAS_ANGLE_GEN_BAND *band_ptr = &bands[band_index];
+            size_t pixel = (size_t)line * num_samps + samp; /* Pixel index */
+            double l1t_line = first_line + line * line_step;
+            double l1t_samp = first_samp + samp * samp_step;
+            double height = use_elev ? elevation
+                : band_ptr->satellite.mean_height; /* Model height */
+            double l1r_line[2]; /* L1R lines for up to 2 SCAs */
+            double l1r_samp[2]; /* L1R samples for up to 2 SCAs */
+            double *angles[2];  /* Angles of the pixel for each type */
+            const IAS_ANGLE_GEN_ANG_RPC *data_ptrs[2]; /* RPCs of each type */
+            int num_types = 0;  /* Number of angle types */
+            int nsca_found;     /* Number of SCAs containing the pixel */
+            int sca_index;      /* SCA index */
+            int type_index;     /* Angle type index */
+
+            if (sat_angle)
+            {
+                data_ptrs[num_types] = &band_ptr->satellite;
+                angles[num_types++] = &sat_angle[2 * pixel];
+            }
+            if (sun_angle)
+            {
+                data_ptrs[num_types] = &band_ptr->solar;
+                angles[num_types++] = &sun_angle[2 * pixel];
+            }
+            for (type_index = 0; type_index < num_types; type_index++)
+            {
+                angles[type_index][IAS_ANGLE_GEN_ZENITH_INDEX] = 0.0;
+                angles[type_index][IAS_ANGLE_GEN_AZIMUTH_INDEX] = 0.0;
+            }
+
+            nsca_found = ias_angle_gen_find_scas(band_ptr, l1t_line,
+                l1t_samp, use_elev ? &elevation : NULL, l1r_line, l1r_samp);
+            if (outside_image_flag)
+                outside_image_flag[pixel] = (nsca_found < 1);
+            if (nsca_found > 2)
+            {
+                too_many_scas++;
+                continue;
+            }
+
+            for (sca_index = 0; sca_index < nsca_found; sca_index++)
+            {
+                double terms[IAS_ANGLE_GEN_ANG_RPC_COEF]; /* Terms */
+
+                calculate_rpc_terms(
+                    l1t_line - band_ptr->satellite.line_terms.l1t_mean_offset,
+                    l1t_samp - band_ptr->satellite.samp_terms.l1t_mean_offset,
+                    l1r_line[sca_index]
+                        - band_ptr->satellite.line_terms.l1r_mean_offset,
+                    l1r_samp[sca_index]
+                        - band_ptr->satellite.samp_terms.l1r_mean_offset,
+                    height - band_ptr->satellite.mean_height, terms);
+
+                for (type_index = 0; type_index < num_types; type_index++)
+                {
+                    const IAS_ANGLE_GEN_ANG_RPC *data_ptr
+                        = data_ptrs[type_index];
+                    double x, y, z; /* Vector components */
+                    double length;  /* Vector length */
+
+                    calculate_rpc_vector_value(terms, data_ptr->mean_offset.x,
+                        data_ptr->x_terms.numerator,
+                        data_ptr->x_terms.denominator, &x);
+                    calculate_rpc_vector_value(terms, data_ptr->mean_offset.y,
+                        data_ptr->y_terms.numerator,
+                        data_ptr->y_terms.denominator, &y);
+                    calculate_rpc_vector_value(terms, data_ptr->mean_offset.z,
+                        data_ptr->z_terms.numerator,
+                        data_ptr->z_terms.denominator, &z);
+
+                    /* Normalize the vector, as ias_math_compute_unit_vector
+                       does on the host */
+                    length = sqrt(x * x + y * y + z * z);
+                    if (length == 0.0)
+                    {
+                        zero_length++;
+                        continue;
+                    }
+                    angles[type_index][IAS_ANGLE_GEN_ZENITH_INDEX]
+                        += acos(z / length);
+                    angles[type_index][IAS_ANGLE_GEN_AZIMUTH_INDEX]
+                        += atan2(x / length, y / length);
+                }
+            }
+
+            /* Average the angles of the pixels in the SCA overlap */
+            if (nsca_found < 2)
+                continue;
+            for (type_index = 0; type_index < num_types; type_index++)
+            {
+                angles[type_index][IAS_ANGLE_GEN_ZENITH_INDEX] /= nsca_found;
+                angles[type_index][IAS_ANGLE_GEN_AZIMUTH_INDEX] /= nsca_found;
+            }
+        }
+    }
+
+    if (too_many_scas > 0)
+    {
+        IAS_LOG_ERROR("Too many SCAs found locating %d points in active "
+            "image", too_many_scas);
+        return ERROR;
+    }
+    if (zero_length > 0)
+    {
+        IAS_LOG_ERROR("Unable to normalize %d rpc vectors", zero_length);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+#endif
+
+/*******************************************************************************
+Name: ias_angle_gen_calculate_tile_angles_rpc
+
+Purpose: Calculates the satellite viewing and/or solar illumination zenith and
+         azimuth angles for a tile of equally spaced pixels: num_lines lines
+         of num_samps samples each.  This gives the same angles as calling
+         ias_angle_gen_calculate_angles_rpc for each pixel, to within
+         rounding.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR
+
+Notes:
+    1. The angles are stored as zenith/azimuth pairs for each pixel, with
+       the pixels in line order.  Pass NULL for the angle types that aren't
+       needed.  Pixels outside the active image get zero angles and their
+       outside_image_flag set.
+    2. If the offload_flag of the metadata is set (see
+       ias_angle_gen_offload_metadata), the tile is evaluated on the offload
+       device, in double precision.  Otherwise each line is evaluated on the
+       host with ias_angle_gen_calculate_line_angles_rpc.
+ ******************************************************************************/
+int ias_angle_gen_calculate_tile_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double first_line,      /* I: Output space coordinate of the first line */
+    double line_step,       /* I: Spacing between the lines */
+    int num_lines,          /* I: Number of lines */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples in each line */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each pixel indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each pixel (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  pixel (or NULL) */
+)
+{
+    int line;               /* Line index */
+
+    /* Check that the band index is valid */
+    if (!ias_angle_gen_valid_band_index(metadata, band_index))
+    {
+        IAS_LOG_ERROR("Band index %d is invalid", band_index);
+        return ERROR;
+    }
+
+#ifdef ENABLE_OFFLOAD
+    if (metadata->offload_flag)
+    {
+        return calculate_tile_angles_offload(metadata, first_line, line_step,
+            num_lines, first_samp, samp_step, num_samps, elev, band_index,
+            outside_image_flag, sat_angle, sun_angle);
+    }
+#endif
+
+    for (line = 0; line < num_lines; line++)
+    {
+        size_t pixel = (size_t)line * num_samps; /* First pixel of line */
+
+        if (calculate_line_angles_rpc(metadata, first_line + line * line_step,
+            first_samp, samp_step, num_samps, elev, NULL, band_index,
+            outside_image_flag ? &outside_image_flag[pixel] : NULL,
+            sat_angle ? &sat_angle[2 * pixel] : NULL,
+            sun_angle ? &sun_angle[2 * pixel] : NULL) != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
 
     return SUCCESS;
 }
@@ -13,6 +13,9 @@
 #define IAS_ANGLE_GEN_SCENE_ID_LENGTH 40 /* Scene ID length */
 #define IAS_ANGLE_GEN_ZENITH_INDEX 0    /* Array index for the zenith angle */
 #define IAS_ANGLE_GEN_AZIMUTH_INDEX 1   /* Array index for the azimuth angle */
+#define IAS_ANGLE_GEN_LINE_CHUNK 256    /* Samples evaluated together by
+                                           ias_angle_gen_calculate_line_
+                                           angles_rpc */
 
 typedef enum ias_angle_gen_type
 {
@@ -124,6 +127,13 @@ typedef struct IAS_ANGLE_GEN_METADATA
     char spacecraft_id[IAS_ANGLE_GEN_SPACECRAFT_SIZE]; /* Spacecraft ID */
     char landsat_scene_id[IAS_ANGLE_GEN_SCENE_ID_LENGTH + 1]; /* Scene ID */
     IAS_GEO_PROJ_TRANSFORMATION *transformation; /* Projection transformation */
+    int single_precision_flag;  /* Flag to convert the vectors to angles in
+                                   single precision when evaluating a line
+                                   of angles (set by the caller, not read
+                                   from the file) */
+    int offload_flag;           /* Flag to evaluate tiles of angles on the
+                                   offload device, set by
+                                   ias_angle_gen_offload_metadata */
 } IAS_ANGLE_GEN_METADATA;
 
 /**********************  FUNCTION PROTOTYPES START  ***************************/
@@ -141,6 +151,96 @@ int ias_angle_gen_calculate_angles_rpc
     double *angle           /* O: Array containing zenith and azimuth angles */
 );
 
+int ias_angle_gen_calculate_sat_sun_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double l1t_samp,        /* I: Output space sample coordinate */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag indicating return was outside image */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles */
+    double *sun_angle       /* O: Solar zenith and azimuth angles */
+);
+
+int ias_angle_gen_calculate_line_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each sample indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each sample (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  sample (or NULL) */
+);
+
+int ias_angle_gen_calculate_line_dem_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double l1t_line,        /* I: Output space line coordinate */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples */
+    const double *samp_elev,/* I: Elevation of each sample */
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each sample indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each sample (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  sample (or NULL) */
+);
+
+int ias_angle_gen_calculate_tile_angles_rpc
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Metadata structure */
+    double first_line,      /* I: Output space coordinate of the first line */
+    double line_step,       /* I: Spacing between the lines */
+    int num_lines,          /* I: Number of lines */
+    double first_samp,      /* I: Output space coordinate of the first sample */
+    double samp_step,       /* I: Spacing between the samples */
+    int num_samps,          /* I: Number of samples in each line */
+    const double *elev,     /* I: Pointer to input elevation or NULL if mean
+                              scene height should be used*/
+    int band_index,         /* I: Current band index */
+    int *outside_image_flag,/* O: Flag for each pixel indicating it was
+                                  outside the image (or NULL) */
+    double *sat_angle,      /* O: Satellite zenith and azimuth angles for
+                                  each pixel (or NULL) */
+    double *sun_angle       /* O: Solar zenith and azimuth angles for each
+                                  pixel (or NULL) */
+);
+
+int ias_angle_gen_offload_available();
+
+int ias_angle_gen_offload_metadata
+(
+    IAS_ANGLE_GEN_METADATA *metadata /* I/O: Metadata structure */
+);
+
+void ias_angle_gen_release_offload_metadata
+(
+    IAS_ANGLE_GEN_METADATA *metadata /* I/O: Metadata structure */
+);
+
+double *ias_angle_gen_alloc_tile_buffer
+(
+    size_t num_values       /* I: Number of angle values in the buffer */
+);
+
+void ias_angle_gen_free_tile_buffer
+(
+    double *buffer          /* I: Buffer to free (or NULL) */
+);
+
 void ias_angle_gen_free
 (
     IAS_ANGLE_GEN_METADATA *metadata /* I: Metadata structure */
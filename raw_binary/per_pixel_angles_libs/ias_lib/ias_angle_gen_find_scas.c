@@ -4,31 +4,99 @@
 /* Local Defines */
 #define SCA_OVERLAP 50 /* Max number of overlapping pixels */
 
+/* Locating the SCAs is also compiled for the offload device, for
+   ias_angle_gen_calculate_tile_angles_rpc */
+#ifdef ENABLE_OFFLOAD
+#pragma omp declare target
+#endif
+
 /*******************************************************************************
-Name: ias_angle_gen_find_scas
+Name: ias_angle_gen_sca_location
 
-Purpose: Uses the L1T to L1R rational polynomials to determine which SCA, or
-         SCAs, the input L1T line/sample/height location falls in, and 
-         returns the L1R line/sample coordinates associated with each valid 
-         SCA
+Purpose: Uses the L1T to L1R rational polynomials of one SCA to compute the
+         L1R line/sample coordinates of an L1T line/sample/height location.
+         The L1R sample is relative to the start of the SCA.
 
-Note: If height not needed in find pass NULL pointer as height. Also the
-      l1r_line and l1r_samp pointers need to have space to for 2 SCA 
-      line/sample combinations.
+Note: If height not needed pass NULL pointer as height.  The location isn't
+      checked against the extent of the SCA.
+
+Return: 
+    Type = void
+ ******************************************************************************/
+void ias_angle_gen_sca_location
+(
+    const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
+    int sca_index,        /* I: SCA index */
+    double l1t_line,      /* I: Input L1T line */
+    double l1t_samp,      /* I: Input L1T sample */
+    const double *height, /* I: Input height, NULL for zero height */
+    double *l1r_line,     /* O: Output L1R line number */
+    double *l1r_samp      /* O: Output L1R sample number */
+)
+{
+    double line_offset;          /* Offset value of L1T line */
+    double samp_offset;          /* Offset value of L1T sample */
+    double height_offset;        /* Offset value of height */
+    const IAS_ANGLE_GEN_IMAGE_RPC_TERMS *line_terms;/* Line terms pointer */
+    const IAS_ANGLE_GEN_IMAGE_RPC_TERMS *samp_terms;/* Samp terms pointer */
+
+    line_terms = &metadata->sca_metadata[sca_index].line_terms;
+    samp_terms = &metadata->sca_metadata[sca_index].samp_terms;
+    line_offset = l1t_line - line_terms->l1t_mean_offset;
+    samp_offset = l1t_samp - samp_terms->l1t_mean_offset;
+
+    /* Check if height should be used */
+    if (height)
+    {    
+        height_offset = *height 
+            - metadata->sca_metadata[sca_index].mean_height;
+    }
+    else
+    {
+        height_offset = 0;
+    }
+
+    /* Calculate the l1r line and sample location */
+    *l1r_line = (line_terms->numerator[0] + line_terms->numerator[1] 
+        * line_offset + line_terms->numerator[2] * samp_offset 
+        + line_terms->numerator[3] * height_offset 
+        + line_terms->numerator[4] * line_offset * samp_offset) 
+        / (1.0 + line_terms->denominator[0] * line_offset 
+        + line_terms->denominator[1] * samp_offset 
+        + line_terms->denominator[2] * height_offset 
+        + line_terms->denominator[3] * line_offset * samp_offset) 
+        + line_terms->l1r_mean_offset;
+
+    *l1r_samp = (samp_terms->numerator[0] + samp_terms->numerator[1] 
+        * line_offset + samp_terms->numerator[2] * samp_offset
+        + samp_terms->numerator[3] * height_offset 
+        + samp_terms->numerator[4] * line_offset * samp_offset) 
+        / (1.0 + samp_terms->denominator[0] * line_offset 
+        + samp_terms->denominator[1] * samp_offset 
+        + samp_terms->denominator[2] * height_offset 
+        + samp_terms->denominator[3] * line_offset * samp_offset) 
+        + samp_terms->l1r_mean_offset;
+}
+
+/*******************************************************************************
+Name: locate_scas
+
+Purpose: Searches for the SCA, or SCAs, the input L1T line/sample/height
+         location falls in.  See ias_angle_gen_find_scas.
 
 Return: 
     Type = integer
-    On success: Number of SCAs found
-    On error: N/A
+    Number of SCAs found
  ******************************************************************************/
-int ias_angle_gen_find_scas
+static int locate_scas
 (
     const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
     double l1t_line,      /* I: Input L1T line */
     double l1t_samp,      /* I: Input L1T sample */
     const double *height, /* I: Input height, NULL for zero height */
     double *l1r_line,     /* O: Array of output L1R line numbers */
-    double *l1r_samp      /* O: Array of output L1R sample numbers */
+    double *l1r_samp,     /* O: Array of output L1R sample numbers */
+    int *sca_list         /* O: Array of the SCA indices found (or NULL) */
 ) 
 {
     int sca_index;   /* SCA index */
@@ -43,50 +111,11 @@ int ias_angle_gen_find_scas
     /* Compute the location for this SCA */
     while (sca_index >= 0 && sca_index < metadata->num_scas)
     {
-        double line_offset;          /* Offset value of L1T line */
-        double samp_offset;          /* Offset value of L1T sample */
-        double height_offset;        /* Offset value of height */
         double line;                 /* Local L1R line */
         double sample;               /* Local L1R sample */
-        const IAS_ANGLE_GEN_IMAGE_RPC_TERMS *line_terms;/* Line terms pointer */
-        const IAS_ANGLE_GEN_IMAGE_RPC_TERMS *samp_terms;/* Samp terms pointer */
-
-        line_terms = &metadata->sca_metadata[sca_index].line_terms;
-        samp_terms = &metadata->sca_metadata[sca_index].samp_terms;
-        line_offset = l1t_line - line_terms->l1t_mean_offset;
-        samp_offset = l1t_samp - samp_terms->l1t_mean_offset;
-
-        /* Check if height should be used */
-        if (height)
-        {    
-            height_offset = *height 
-                - metadata->sca_metadata[sca_index].mean_height;
-        }
-        else
-        {
-            height_offset = 0;
-        }
 
-        /* Calculate the l1r line and sample location */
-        line = (line_terms->numerator[0] + line_terms->numerator[1] 
-            * line_offset + line_terms->numerator[2] * samp_offset 
-            + line_terms->numerator[3] * height_offset 
-            + line_terms->numerator[4] * line_offset * samp_offset) 
-            / (1.0 + line_terms->denominator[0] * line_offset 
-            + line_terms->denominator[1] * samp_offset 
-            + line_terms->denominator[2] * height_offset 
-            + line_terms->denominator[3] * line_offset * samp_offset) 
-            + line_terms->l1r_mean_offset;
-
-        sample = (samp_terms->numerator[0] + samp_terms->numerator[1] 
-            * line_offset + samp_terms->numerator[2] * samp_offset
-            + samp_terms->numerator[3] * height_offset 
-            + samp_terms->numerator[4] * line_offset * samp_offset) 
-            / (1.0 + samp_terms->denominator[0] * line_offset 
-            + samp_terms->denominator[1] * samp_offset 
-            + samp_terms->denominator[2] * height_offset 
-            + samp_terms->denominator[3] * line_offset * samp_offset) 
-            + samp_terms->l1r_mean_offset;
+        ias_angle_gen_sca_location(metadata, sca_index, l1t_line, l1t_samp,
+            height, &line, &sample);
 
         /* See if we are in the right place */
         if (sample >= 0 && sample <= (metadata->l1r_samps - 1))
@@ -96,6 +125,10 @@ int ias_angle_gen_find_scas
             {
                 l1r_line[nsca_found] = line;
                 l1r_samp[nsca_found] = sample + sca_index * metadata->l1r_samps;
+                if (sca_list)
+                {
+                    sca_list[nsca_found] = sca_index;
+                }
                 nsca_found++;
             }
 
@@ -153,3 +186,227 @@ int ias_angle_gen_find_scas
 
     return nsca_found;
 }
+
+/*******************************************************************************
+Name: ias_angle_gen_find_scas
+
+Purpose: Uses the L1T to L1R rational polynomials to determine which SCA, or
+         SCAs, the input L1T line/sample/height location falls in, and 
+         returns the L1R line/sample coordinates associated with each valid 
+         SCA
+
+Note: If height not needed in find pass NULL pointer as height. Also the
+      l1r_line and l1r_samp pointers need to have space to for 2 SCA 
+      line/sample combinations.
+
+Return: 
+    Type = integer
+    On success: Number of SCAs found
+    On error: N/A
+ ******************************************************************************/
+int ias_angle_gen_find_scas
+(
+    const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
+    double l1t_line,      /* I: Input L1T line */
+    double l1t_samp,      /* I: Input L1T sample */
+    const double *height, /* I: Input height, NULL for zero height */
+    double *l1r_line,     /* O: Array of output L1R line numbers */
+    double *l1r_samp      /* O: Array of output L1R sample numbers */
+) 
+{
+    return locate_scas(metadata, l1t_line, l1t_samp, height, l1r_line,
+        l1r_samp, NULL);
+}
+
+#ifdef ENABLE_OFFLOAD
+#pragma omp end declare target
+#endif
+
+/* State for building the SCA spans of a line */
+typedef struct sca_span_builder
+{
+    const IAS_ANGLE_GEN_BAND *metadata; /* Metadata for current band */
+    double l1t_line;            /* L1T line */
+    double first_samp;          /* L1T coordinate of the first sample */
+    double samp_step;           /* Spacing between the samples */
+    const double *height;       /* Height, NULL for zero height */
+    const double *samp_heights; /* Height of each sample, NULL to use
+                                   height */
+    IAS_ANGLE_GEN_SCA_SPAN *spans; /* Spans found so far */
+    int max_spans;              /* Space available in spans */
+    int num_spans;              /* Number of spans found so far */
+} SCA_SPAN_BUILDER;
+
+/*******************************************************************************
+Name: get_sca_span_state
+
+Purpose: Finds the SCAs containing one sample of the line being divided into
+         spans, and returns them as a span starting at that sample.
+
+Return: 
+    Type = void
+ ******************************************************************************/
+static void get_sca_span_state
+(
+    const SCA_SPAN_BUILDER *builder, /* I: Span builder */
+    int index,                  /* I: Sample index along the line */
+    IAS_ANGLE_GEN_SCA_SPAN *state /* O: SCAs of the sample */
+)
+{
+    double l1r_line[2];         /* L1R lines for up to 2 SCAs */
+    double l1r_samp[2];         /* L1R samples for up to 2 SCAs */
+    const double *height = builder->samp_heights
+        ? &builder->samp_heights[index] : builder->height;
+
+    state->first_samp = index;
+    state->end_samp = index + 1;
+    state->num_scas = locate_scas(builder->metadata, builder->l1t_line,
+        builder->first_samp + index * builder->samp_step, height,
+        l1r_line, l1r_samp, state->sca);
+}
+
+/*******************************************************************************
+Name: same_sca_span_state
+
+Purpose: Compares the SCAs of two span states, ignoring the order the SCAs
+         were found in.
+
+Return: 
+    Type = integer
+    1 if the same SCAs were found, 0 if not
+ ******************************************************************************/
+static int same_sca_span_state
+(
+    const IAS_ANGLE_GEN_SCA_SPAN *first, /* I: First state */
+    const IAS_ANGLE_GEN_SCA_SPAN *second /* I: Second state */
+)
+{
+    if (first->num_scas != second->num_scas)
+        return 0;
+    if (first->num_scas == 0)
+        return 1;
+    if (first->num_scas == 1)
+        return first->sca[0] == second->sca[0];
+    return (first->sca[0] == second->sca[0] && first->sca[1] == second->sca[1])
+        || (first->sca[0] == second->sca[1] && first->sca[1] == second->sca[0]);
+}
+
+/*******************************************************************************
+Name: refine_sca_spans
+
+Purpose: Finds the span boundaries between two samples of the line by
+         bisection, and adds the spans that start after the first sample.
+         The SCAs are assumed not to change between two samples with the
+         same SCAs.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR if there isn't room for the spans
+ ******************************************************************************/
+static int refine_sca_spans
+(
+    SCA_SPAN_BUILDER *builder,  /* I/O: Span builder */
+    const IAS_ANGLE_GEN_SCA_SPAN *start, /* I: State of the first sample */
+    const IAS_ANGLE_GEN_SCA_SPAN *end    /* I: State of the last sample */
+)
+{
+    IAS_ANGLE_GEN_SCA_SPAN middle; /* State of the middle sample */
+
+    if (same_sca_span_state(start, end))
+        return SUCCESS;
+
+    /* Adjacent samples with different SCAs start a new span */
+    if (end->first_samp - start->first_samp == 1)
+    {
+        if (builder->num_spans >= builder->max_spans)
+            return ERROR;
+        builder->spans[builder->num_spans - 1].end_samp = end->first_samp;
+        builder->spans[builder->num_spans++] = *end;
+        return SUCCESS;
+    }
+
+    get_sca_span_state(builder, (start->first_samp + end->first_samp) / 2,
+        &middle);
+    if (refine_sca_spans(builder, start, &middle) != SUCCESS)
+        return ERROR;
+    return refine_sca_spans(builder, &middle, end);
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_find_sca_spans
+
+Purpose: Divides a run of equally spaced samples along an L1T line into spans
+         of samples that fall in the same SCA, or SCAs, so the SCAs of each
+         sample are known without searching for them.
+
+Note: The SCAs are located every IAS_ANGLE_GEN_SCA_SPAN_STEP L1T samples,
+      and the boundaries between them are found by bisection, so
+      ias_angle_gen_find_scas is only needed near the boundaries.  The step
+      is narrower than the SCA overlap, so no span is missed.  With a
+      height for each sample the SCA boundaries move with the terrain; the
+      heights are assumed to vary smoothly enough over a step for the
+      bisection to still find them.
+
+Return: 
+    Type = integer
+    SUCCESS / ERROR if more than max_spans spans are needed
+ ******************************************************************************/
+int ias_angle_gen_find_sca_spans
+(
+    const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
+    double l1t_line,      /* I: Input L1T line */
+    double first_samp,    /* I: Input L1T coordinate of the first sample */
+    double samp_step,     /* I: Spacing between the samples */
+    int num_samps,        /* I: Number of samples */
+    const double *height, /* I: Input height, NULL for zero height */
+    const double *samp_heights, /* I: Height of each sample, or NULL to use
+                                      height for all of them */
+    int max_spans,        /* I: Space available in spans */
+    IAS_ANGLE_GEN_SCA_SPAN *spans, /* O: Spans of the samples, in order */
+    int *num_spans        /* O: Number of spans */
+)
+{
+    SCA_SPAN_BUILDER builder;   /* Span builder */
+    IAS_ANGLE_GEN_SCA_SPAN start; /* State at the start of the step */
+    IAS_ANGLE_GEN_SCA_SPAN end;   /* State at the end of the step */
+    int step;                   /* Samples between the located samples */
+    int index;                  /* Sample index */
+
+    *num_spans = 0;
+    if (num_samps < 1)
+        return SUCCESS;
+    if (max_spans < 1)
+        return ERROR;
+
+    builder.metadata = metadata;
+    builder.l1t_line = l1t_line;
+    builder.first_samp = first_samp;
+    builder.samp_step = samp_step;
+    builder.height = height;
+    builder.samp_heights = samp_heights;
+    builder.spans = spans;
+    builder.max_spans = max_spans;
+
+    step = (int)(IAS_ANGLE_GEN_SCA_SPAN_STEP / samp_step);
+    if (step < 1)
+        step = 1;
+
+    get_sca_span_state(&builder, 0, &start);
+    spans[0] = start;
+    builder.num_spans = 1;
+    for (index = 0; index < num_samps - 1; index = end.first_samp)
+    {
+        int next = index + step;    /* Next sample to locate */
+
+        if (next > num_samps - 1)
+            next = num_samps - 1;
+        get_sca_span_state(&builder, next, &end);
+        if (refine_sca_spans(&builder, &start, &end) != SUCCESS)
+            return ERROR;
+        start = end;
+    }
+    spans[builder.num_spans - 1].end_samp = num_samps;
+
+    *num_spans = builder.num_spans;
+    return SUCCESS;
+}
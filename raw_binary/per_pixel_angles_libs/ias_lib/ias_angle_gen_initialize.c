@@ -49,6 +49,10 @@ int ias_angle_gen_initialize
         return ERROR;
     }
 
+    /* Default to evaluating the angles in double precision, on the host */
+    metadata->single_precision_flag = 0;
+    metadata->offload_flag = 0;
+
     return SUCCESS;
 }
 
@@ -65,6 +69,8 @@ void ias_angle_gen_free
     IAS_ANGLE_GEN_METADATA *metadata /* I: Metadata structure */
 )           
 {
+    ias_angle_gen_release_offload_metadata(metadata);
+
     free(metadata->ephemeris);
     metadata->ephemeris = NULL;
 
@@ -0,0 +1,168 @@
+/* Standard Library Includes */
+#include <stdlib.h>
+#ifdef ENABLE_OFFLOAD
+#include <omp.h>
+#endif
+
+/* IAS Library Includes */
+#include "ias_logging.h"
+#include "ias_angle_gen_private.h"
+
+#ifdef ENABLE_OFFLOAD
+/* Allocator for the pinned tile buffers, created on first use */
+static omp_allocator_handle_t tile_allocator = omp_null_allocator;
+static int tile_allocator_set = 0;
+#endif
+
+/*******************************************************************************
+Name: ias_angle_gen_offload_available
+
+Purpose: Determines whether the angles can be evaluated on an offload device
+         (GPU).  The library has to be built with ENABLE_OFFLOAD, and a
+         device has to be present at run time.
+
+Return:
+    Type = integer
+    TRUE if there is an offload device, FALSE if not
+ ******************************************************************************/
+int ias_angle_gen_offload_available()
+{
+#ifdef ENABLE_OFFLOAD
+    return (omp_get_num_devices() > 0);
+#else
+    return FALSE;
+#endif
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_offload_metadata
+
+Purpose: Copies the band metadata of a scene to the offload device and sets
+         the offload_flag, so ias_angle_gen_calculate_tile_angles_rpc
+         evaluates the tiles there without copying the coefficients again.
+
+Return:
+    Type = integer
+    SUCCESS / ERROR if there is no offload device
+
+Notes:
+    1. The metadata must stay at the same address until it's released with
+       ias_angle_gen_release_offload_metadata (ias_angle_gen_free does it).
+ ******************************************************************************/
+int ias_angle_gen_offload_metadata
+(
+    IAS_ANGLE_GEN_METADATA *metadata /* I/O: Metadata structure */
+)
+{
+#ifdef ENABLE_OFFLOAD
+    if (!ias_angle_gen_offload_available())
+    {
+        IAS_LOG_ERROR("No offload device is available");
+        return ERROR;
+    }
+
+    if (!metadata->offload_flag)
+    {
+        #pragma omp target enter data map(to: \
+            metadata->band_metadata[0:IAS_MAX_NBANDS])
+        metadata->offload_flag = 1;
+    }
+
+    return SUCCESS;
+#else
+    (void)metadata;
+    IAS_LOG_ERROR("Offloading the angles isn't supported by this build");
+    return ERROR;
+#endif
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_release_offload_metadata
+
+Purpose: Releases the device copy of the band metadata of a scene and clears
+         the offload_flag.
+
+Return:
+    Type = void
+ ******************************************************************************/
+void ias_angle_gen_release_offload_metadata
+(
+    IAS_ANGLE_GEN_METADATA *metadata /* I/O: Metadata structure */
+)
+{
+#ifdef ENABLE_OFFLOAD
+    if (metadata->offload_flag)
+    {
+        #pragma omp target exit data map(release: \
+            metadata->band_metadata[0:IAS_MAX_NBANDS])
+    }
+#endif
+    metadata->offload_flag = 0;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_alloc_tile_buffer
+
+Purpose: Allocates a buffer for the angles of a tile.  With offloading built
+         in, the buffer is pinned host memory when the OpenMP runtime
+         supports it, so the device writes the angles straight into it.
+
+Return:
+    Type = double *
+    Pointer to the buffer, or NULL if it can't be allocated
+
+Notes:
+    1. Free the buffer with ias_angle_gen_free_tile_buffer.
+ ******************************************************************************/
+double *ias_angle_gen_alloc_tile_buffer
+(
+    size_t num_values       /* I: Number of angle values in the buffer */
+)
+{
+    double *buffer;         /* Allocated buffer */
+
+#ifdef ENABLE_OFFLOAD
+    #pragma omp critical (ias_angle_gen_tile_allocator)
+    {
+        if (!tile_allocator_set)
+        {
+            omp_alloctrait_t traits[] = {{omp_atk_pinned, omp_atv_true},
+                {omp_atk_fallback, omp_atv_default_mem_fb}};
+
+            tile_allocator = omp_init_allocator(omp_default_mem_space, 2,
+                traits);
+            if (tile_allocator == omp_null_allocator)
+                tile_allocator = omp_default_mem_alloc;
+            tile_allocator_set = 1;
+        }
+    }
+    buffer = omp_alloc(num_values * sizeof(*buffer), tile_allocator);
+#else
+    buffer = malloc(num_values * sizeof(*buffer));
+#endif
+    if (!buffer)
+        IAS_LOG_ERROR("Allocating a tile buffer of %zu angles", num_values);
+
+    return buffer;
+}
+
+/*******************************************************************************
+Name: ias_angle_gen_free_tile_buffer
+
+Purpose: Frees a buffer from ias_angle_gen_alloc_tile_buffer.
+
+Return:
+    Type = void
+ ******************************************************************************/
+void ias_angle_gen_free_tile_buffer
+(
+    double *buffer          /* I: Buffer to free (or NULL) */
+)
+{
+#ifdef ENABLE_OFFLOAD
+    if (buffer)
+        omp_free(buffer, tile_allocator);
+#else
+    free(buffer);
+#endif
+}
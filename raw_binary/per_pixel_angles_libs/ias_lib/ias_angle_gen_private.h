@@ -4,6 +4,29 @@
 /* Local Library Includes */
 #include "ias_angle_gen_distro.h" /* Angle gen structs */
 
+/* L1T samples between the samples located when dividing a line into SCA
+   spans; kept under the SCA overlap so no span is skipped over */
+#define IAS_ANGLE_GEN_SCA_SPAN_STEP 32
+
+/* Most SCA spans along a line: each SCA, the overlaps, and the gaps */
+#define IAS_ANGLE_GEN_MAX_SCA_SPANS (4 * IAS_MAX_NSCAS + 1)
+
+/* Identifies the contents of an ANG file for its parsed metadata cache */
+typedef struct ias_angle_gen_cache_key
+{
+    unsigned long long hash;    /* 64-bit FNV-1a hash of the file */
+    unsigned long long size;    /* Size of the file in bytes */
+} IAS_ANGLE_GEN_CACHE_KEY;
+
+/* Run of samples along an L1T line in the same SCA, or SCAs */
+typedef struct ias_angle_gen_sca_span
+{
+    int first_samp;     /* Index of the first sample in the span */
+    int end_samp;       /* Index of the sample after the span */
+    int num_scas;       /* Number of SCAs containing the samples (0 to 2) */
+    int sca[2];         /* SCA indices, in the order they were found */
+} IAS_ANGLE_GEN_SCA_SPAN;
+
 int ias_angle_gen_calculate_vector
 (
     const IAS_ANGLE_GEN_METADATA *metadata,/* I: Metadata structure */
@@ -16,6 +39,20 @@ int ias_angle_gen_calculate_vector
     IAS_VECTOR *view         /* O: View vector */
 );
 
+#ifdef ENABLE_OFFLOAD
+#pragma omp declare target
+#endif
+void ias_angle_gen_sca_location
+(
+    const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
+    int sca_index,        /* I: SCA index */
+    double l1t_line,      /* I: Input L1T line */
+    double l1t_samp,      /* I: Input L1T sample */
+    const double *height, /* I: Input height, NULL for zero height */
+    double *l1r_line,     /* O: Output L1R line number */
+    double *l1r_samp      /* O: Output L1R sample number */
+);
+
 int ias_angle_gen_find_scas
 (
     const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
@@ -25,6 +62,44 @@ int ias_angle_gen_find_scas
     double *l1r_line,     /* O: Array of output L1R line numbers */
     double *l1r_samp      /* O: Array of output L1R sample numbers */
 );
+#ifdef ENABLE_OFFLOAD
+#pragma omp end declare target
+#endif
+
+int ias_angle_gen_find_sca_spans
+(
+    const IAS_ANGLE_GEN_BAND *metadata,/* I: Metadata for current band */
+    double l1t_line,      /* I: Input L1T line */
+    double first_samp,    /* I: Input L1T coordinate of the first sample */
+    double samp_step,     /* I: Spacing between the samples */
+    int num_samps,        /* I: Number of samples */
+    const double *height, /* I: Input height, NULL for zero height */
+    const double *samp_heights, /* I: Height of each sample, or NULL to use
+                                      height for all of them */
+    int max_spans,        /* I: Space available in spans */
+    IAS_ANGLE_GEN_SCA_SPAN *spans, /* O: Spans of the samples, in order */
+    int *num_spans        /* O: Number of spans */
+);
+
+int ias_angle_gen_get_cache_key
+(
+    const char *ang_filename,   /* I: Angle file name */
+    IAS_ANGLE_GEN_CACHE_KEY *key /* O: Key of the file contents */
+);
+
+int ias_angle_gen_load_ang_cache
+(
+    const char *ang_filename,   /* I: Angle file name */
+    const IAS_ANGLE_GEN_CACHE_KEY *key, /* I: Key of the ANG file contents */
+    IAS_ANGLE_GEN_METADATA *metadata /* O: Metadata structure to load */
+);
+
+int ias_angle_gen_write_ang_cache
+(
+    const char *ang_filename,   /* I: Angle file name */
+    const IAS_ANGLE_GEN_CACHE_KEY *key, /* I: Key of the ANG file contents */
+    const IAS_ANGLE_GEN_METADATA *metadata /* I: Metadata structure */
+);
 
 int ias_angle_gen_interpolate_ephemeris
 (
@@ -1,4 +1,5 @@
 /* Standard Library Includes */
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -10,6 +11,7 @@
 #include "ias_miscellaneous.h"  
 #include "ias_angle_gen_distro.h"
 #include "ias_angle_gen_private.h"
+#include "espa_profile.h"
 
 /* Local Defines */
 #define MAX_FIELD_NAME  32 /* Maximum number of characters in an ODL field */
@@ -100,6 +102,49 @@ static int construct_and_get_odl_field
     return SUCCESS;
 }
 
+/*******************************************************************************
+ Name: initialize_satellite
+
+ Purpose: Initializes the satellite attributes library for the spacecraft
+    of the ANG file, so the band numbers of the file are those of its
+    satellite.
+
+ Returns:
+    Type = integer
+    SUCCESS / ERROR
+ ******************************************************************************/
+static int initialize_satellite
+(
+    const char *spacecraft_id   /* I: Spacecraft ID, e.g. LANDSAT_8 */
+)
+{
+    int satellite_number;       /* Landsat satellite number */
+    int satellite_id;           /* Satellite ID of the satellite number */
+
+    if (sscanf(spacecraft_id, "LANDSAT_%d", &satellite_number) != 1)
+    {
+        IAS_LOG_ERROR("Unsupported spacecraft ID %s", spacecraft_id);
+        return ERROR;
+    }
+
+    satellite_id = ias_sat_attr_get_satellite_id_from_satellite_number(
+        satellite_number);
+    if (satellite_id == ERROR)
+    {
+        IAS_LOG_ERROR("Unsupported spacecraft ID %s", spacecraft_id);
+        return ERROR;
+    }
+
+    if (ias_sat_attr_initialize(satellite_id) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Initializing the satellite attributes for %s",
+            spacecraft_id);
+        return ERROR;
+    }
+
+    return SUCCESS;
+}
+
 /*******************************************************************************
 Name: ias_angle_gen_read_ang_header
 
@@ -133,6 +178,12 @@ static int ias_angle_gen_read_ang_header
         return ERROR;
     }
 
+    /* The band numbers are those of the satellite */
+    if (initialize_satellite(metadata->spacecraft_id) != SUCCESS)
+    {
+        return ERROR;
+    }
+
     /* Read number of bands */
     if (get_odl_field(sizeof(metadata->num_bands), IAS_ODL_Int, odl_data, 
         "FILE_HEADER", "NUMBER_OF_BANDS", 1, &metadata->num_bands) != SUCCESS)
@@ -149,6 +200,8 @@ static int ias_angle_gen_read_ang_header
     }
 
     /* Store the band list numbers in the data structure */
+    for (index = 0; index < IAS_MAX_NBANDS; index++)
+        metadata->band_present[index] = FALSE;
     for (index = 0; index < metadata->num_bands; index++) 
     {
         int band_index = ias_sat_attr_convert_band_number_to_index(
@@ -994,6 +1047,13 @@ Name: ias_angle_gen_read_ang
 
 Purpose: Read the ANG metadata file.
 
+Note: The parsed metadata is cached next to the ANG file (see
+      ias_angle_gen_cache.c), keyed by the hash of the ANG contents, so
+      reading the same ANG file again skips the ODL parse.
+      The satellite attributes library is initialized for the spacecraft
+      of the ANG file (Landsat 4, 5, 7 or 8), so the band numbers and
+      indices used with the metadata are those of that satellite.
+
 Returns: 
     Type = integer
     SUCCESS / ERROR
@@ -1005,8 +1065,31 @@ int ias_angle_gen_read_ang
 )       
 {
     IAS_OBJ_DESC *odl_data; /* Metadata ODL object */
+    IAS_ANGLE_GEN_CACHE_KEY cache_key; /* Key of the ANG file contents */
+    int cache_hit;          /* Flag: metadata loaded from the cache */
     int index;              /* Loop index */
 
+    /* Use the cached metadata if this ANG file has been parsed before */
+    if (ias_angle_gen_get_cache_key(ang_filename, &cache_key) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reading input metadata file %s", ang_filename);
+        return ERROR;
+    }
+    cache_hit = ias_angle_gen_load_ang_cache(ang_filename, &cache_key,
+        metadata);
+    espa_profile_count_cache(ESPA_PROFILE_CACHE_ANG, cache_hit);
+    if (cache_hit)
+    {
+        /* Set up the satellite attributes as a parse would */
+        if (initialize_satellite(metadata->spacecraft_id) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Reading the file header from %s", ang_filename);
+            ias_angle_gen_free(metadata);
+            return ERROR;
+        }
+        return SUCCESS;
+    }
+
     /* Open file */
     odl_data = ias_odl_read_tree(ang_filename);
     if (!odl_data)
@@ -1061,5 +1144,13 @@ int ias_angle_gen_read_ang
     /* Release the ODL structure */
     ias_odl_free_tree(odl_data);
 
+    /* Save the metadata for the next read.  The ANG directory may not be
+       writable, so this isn't fatal. */
+    if (ias_angle_gen_write_ang_cache(ang_filename, &cache_key, metadata)
+        != SUCCESS)
+    {
+        IAS_LOG_WARNING("Unable to cache the metadata of %s", ang_filename);
+    }
+
     return SUCCESS;
 }
@@ -35,7 +35,7 @@ int ias_angle_gen_write_image
 {
     FILE *output_file;           /* Output file pointer */
     char ang_filename[PATH_MAX]; /* Output angle file name */
-    int count;                   /* Total number of samples */
+    size_t count;                /* Total number of samples */
     int status;                  /* Status placeholder */
     const char *description;     /* Envi header description */
     int band_number;             /* Ouput band number */
@@ -55,7 +55,7 @@ int ias_angle_gen_write_image
     }
 
     /* Calculate the total number of samples */
-    count = num_lines * num_samps;
+    count = (size_t)num_lines * num_samps;
     
     if (sat_or_sun_type == IAS_ANGLE_GEN_SATELLITE)
     {
@@ -334,6 +334,10 @@ void ias_log_message
     const char *format, ...   /* I: format string for message */
 ) 
 {
+    /* Skip messages below the output level before touching the arguments */
+    if (log_level < ias_log_message_level)
+        return;
+
     /* If channels are enabled, ignore non-channel debug messages */
     if (channels_on && log_level == IAS_LOG_LEVEL_DEBUG)
         return;
@@ -362,6 +366,10 @@ void ias_log_message_with_channel
     const char *format, ...   /* I: format string for message */
 )
 {
+    /* Skip messages below the output level before searching the channels */
+    if (log_level < ias_log_message_level)
+        return;
+
     if (is_channel_enabled(channel))
     {
         va_list arglist;
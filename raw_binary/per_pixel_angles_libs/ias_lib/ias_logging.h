@@ -29,6 +29,12 @@ Notes on use:
       a '-'  character, the list is treated as a blacklist and all channels
       will be enabled except the listed channels. If IAS_LOG_CHANNELS is not 
       set, all channels are enabled. 
+    - The IAS_LOG_* macros check the level before their arguments are
+      evaluated, so a message below the output level costs a comparison.
+    - Messages below IAS_LOG_MIN_LEVEL are compiled out entirely.  It defaults
+      to IAS_LOG_LEVEL_DEBUG (all messages compiled in); the build sets it to
+      IAS_LOG_LEVEL_INFO unless ENABLE_DEBUG_LOGGING=yes, so the debug
+      messages only cost anything in diagnostic builds.
 
 ****************************************************************************/
 /* Allow GCC to error check the parameters to the ias_log_message routine
@@ -56,6 +62,11 @@ typedef enum IAS_LOG_MESSAGE_LEVEL {
 extern enum IAS_LOG_MESSAGE_LEVEL ias_log_message_level;
 #endif
 
+/* Lowest level of the messages compiled into the application */
+#ifndef IAS_LOG_MIN_LEVEL
+#define IAS_LOG_MIN_LEVEL IAS_LOG_LEVEL_DEBUG
+#endif
+
 int ias_log_initialize
 (
     const char *log_program_name /* I: name to output with each log message */
@@ -88,9 +99,16 @@ void ias_log_message_with_channel
 ) PRINT_FORMAT_ATTRIBUTE_WC; 
 
 
+/************************************************************************/
+/* Is the level compiled in and at or above the output level?  The compile
+   time test comes first so the whole condition folds to 0 for a level which
+   is compiled out. */
+#define IAS_LOG_LEVEL_ENABLED(level) \
+    (((level) >= (IAS_LOG_MIN_LEVEL)) && ((level) >= (ias_log_message_level)))
+
 /************************************************************************/
 #define IAS_LOG_DEBUG_ENABLED() \
-    (((IAS_LOG_LEVEL_DEBUG) >= (ias_log_message_level)) ? (1) : (0))
+    (IAS_LOG_LEVEL_ENABLED(IAS_LOG_LEVEL_DEBUG) ? (1) : (0))
 
 /************************************************************************/
 #define IAS_LOG_ERROR(format,...) \
@@ -98,34 +116,34 @@ ias_log_message(IAS_LOG_LEVEL_ERROR,__FILE__,__LINE__,format,##__VA_ARGS__)
 
 /************************************************************************/
 #define IAS_LOG_WARNING(format,...) \
-    if (IAS_LOG_LEVEL_WARN >= ias_log_message_level)          \
+    do { if (IAS_LOG_LEVEL_ENABLED(IAS_LOG_LEVEL_WARN))       \
         ias_log_message(IAS_LOG_LEVEL_WARN,__FILE__,__LINE__, \
-                        format,##__VA_ARGS__)
+                        format,##__VA_ARGS__); } while (0)
 
 /************************************************************************/
 #define IAS_LOG_INFO(format,...) \
-    if (IAS_LOG_LEVEL_INFO >= ias_log_message_level)          \
+    do { if (IAS_LOG_LEVEL_ENABLED(IAS_LOG_LEVEL_INFO))       \
         ias_log_message(IAS_LOG_LEVEL_INFO,__FILE__,__LINE__, \
-                        format,##__VA_ARGS__)
+                        format,##__VA_ARGS__); } while (0)
 
 /************************************************************************/
 #ifndef IAS_LOG_CHANNEL
 #define IAS_LOG_DEBUG(format,...) \
-    if (IAS_LOG_LEVEL_DEBUG >= ias_log_message_level)          \
+    do { if (IAS_LOG_LEVEL_ENABLED(IAS_LOG_LEVEL_DEBUG))       \
         ias_log_message(IAS_LOG_LEVEL_DEBUG,__FILE__,__LINE__, \
-                        format,##__VA_ARGS__) 
+                        format,##__VA_ARGS__); } while (0)
 #else
 #define IAS_LOG_DEBUG(format,...) \
-    if (IAS_LOG_LEVEL_DEBUG >= ias_log_message_level)          \
+    do { if (IAS_LOG_LEVEL_ENABLED(IAS_LOG_LEVEL_DEBUG))       \
         ias_log_message_with_channel(IAS_LOG_LEVEL_DEBUG, IAS_LOG_CHANNEL, \
-            __FILE__,__LINE__, format,##__VA_ARGS__) 
+            __FILE__,__LINE__, format,##__VA_ARGS__); } while (0)
 #endif
 
 /************************************************************************/
 #define IAS_LOG_DEBUG_TO_CHANNEL(channel,format,...) \
-    if (IAS_LOG_LEVEL_DEBUG >= ias_log_message_level) \
+    do { if (IAS_LOG_LEVEL_ENABLED(IAS_LOG_LEVEL_DEBUG)) \
         ias_log_message_with_channel(IAS_LOG_LEVEL_DEBUG, channel, \
-            __FILE__, __LINE__, format, ##__VA_ARGS__)
+            __FILE__, __LINE__, format, ##__VA_ARGS__); } while (0)
 
 /************************************************************************/
 
@@ -32,9 +32,10 @@ IAS_OBJ_DESC *ias_odl_read_tree
 
     strncpy(ODLPathName, p_ODLFile, MAXPATHLEN);
 
-    /* open and parse ODL file - error messages are suppressed */
-    if ((p_lp = OdlParseLabelFile(ODLPathName, NULL, ODL_NOEXPAND, TRUE)) 
-        == NULL)
+    /* open and parse ODL file - error messages are suppressed.  The tree
+       is allocated from one arena and released by ias_odl_free_tree in a
+       single call. */
+    if ((p_lp = OdlParseLabelFileArena(ODLPathName, NULL, TRUE)) == NULL)
     {
         IAS_LOG_ERROR("ODL Error on File: %s:  %s", ODLPathName, 
             ODLErrorMessage);
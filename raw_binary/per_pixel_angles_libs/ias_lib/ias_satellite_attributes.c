@@ -16,6 +16,122 @@ PURPOSE: Implements the Satellite Attributes library for applications
 
 static IAS_SATELLITE_ATTRIBUTES *curr_satellite;
 
+/* Number of distinct band classification masks */
+#define BAND_CLASS_COUNT (IAS_SECONDARY_BAND << 1)
+
+/* Lookup tables built from the current satellite's band attributes by
+   build_lookup_tables so the queries by band type, classification or sensor
+   are answered without searching the band attributes.  Entries without a
+   matching band hold ERROR. */
+static int band_number_from_type[IAS_NUM_BAND_TYPES];
+static int band_index_from_type_and_class[IAS_NUM_BAND_TYPES]
+                                         [BAND_CLASS_COUNT];
+static int sca_count_from_sensor[IAS_MAX_SENSORS];
+static int max_normal_detectors_from_sensor[IAS_MAX_SENSORS + 1]; /* the
+                                           last entry is for any sensor */
+static int sensor_band_index[IAS_MAX_TOTAL_BANDS];
+
+/*************************************************************************
+
+NAME: build_lookup_tables
+
+PURPOSE: Flattens the band attributes of the satellite into the lookup
+         tables indexed by band type, classification and sensor.  The first
+         band in band order wins where several bands match, the same as the
+         searches the tables replace.
+
+RETURNS: SUCCESS or ERROR
+
+**************************************************************************/
+static int build_lookup_tables
+(
+    const IAS_SATELLITE_ATTRIBUTES *satellite /* I: satellite attributes */
+)
+{
+    int band_index;
+    int sensor_band_count[IAS_MAX_SENSORS];
+    int type;
+    int band_class;
+    int sensor;
+
+    if (satellite->total_bands > IAS_MAX_TOTAL_BANDS)
+    {
+        IAS_LOG_ERROR("Satellite has %d bands, more than the %d supported",
+            satellite->total_bands, IAS_MAX_TOTAL_BANDS);
+        return ERROR;
+    }
+
+    for (type = 0; type < IAS_NUM_BAND_TYPES; type++)
+    {
+        band_number_from_type[type] = ERROR;
+        for (band_class = 0; band_class < BAND_CLASS_COUNT; band_class++)
+            band_index_from_type_and_class[type][band_class] = ERROR;
+    }
+    for (sensor = 0; sensor < IAS_MAX_SENSORS; sensor++)
+    {
+        sca_count_from_sensor[sensor] = ERROR;
+        max_normal_detectors_from_sensor[sensor] = ERROR;
+        sensor_band_count[sensor] = 0;
+    }
+    max_normal_detectors_from_sensor[IAS_MAX_SENSORS] = ERROR;
+
+    for (band_index = 0; band_index < satellite->total_bands; band_index++)
+    {
+        const IAS_BAND_ATTRIBUTES *band
+                = &satellite->band_attributes[band_index];
+
+        /* ias_sat_attr_convert_band_number_to_index depends on the band
+           number being the band index + 1 */
+        if ((band->band_number != band_index + 1)
+            || (band->band_index != band_index))
+        {
+            IAS_LOG_ERROR("Band attributes at index %d are out of order",
+                band_index);
+            return ERROR;
+        }
+
+        type = band->band_type;
+        band_class = band->band_classification;
+        if ((type >= 0) && (type < IAS_NUM_BAND_TYPES))
+        {
+            if (band_number_from_type[type] == ERROR)
+                band_number_from_type[type] = band->band_number;
+            if ((band_class >= 0) && (band_class < BAND_CLASS_COUNT)
+                && (band_index_from_type_and_class[type][band_class]
+                        == ERROR))
+            {
+                band_index_from_type_and_class[type][band_class]
+                    = band_index;
+            }
+        }
+
+        sensor = band->sensor_id;
+        sensor_band_index[band_index] = ERROR;
+        if ((sensor < 0) || (sensor >= IAS_MAX_SENSORS))
+            continue;
+        sensor_band_index[band_index] = sensor_band_count[sensor]++;
+        if (sca_count_from_sensor[sensor] == ERROR)
+            sca_count_from_sensor[sensor] = band->scas;
+        if (band_class & IAS_NORMAL_BAND)
+        {
+            if (band->detectors_per_sca
+                    > max_normal_detectors_from_sensor[sensor])
+            {
+                max_normal_detectors_from_sensor[sensor]
+                    = band->detectors_per_sca;
+            }
+            if (band->detectors_per_sca
+                    > max_normal_detectors_from_sensor[IAS_MAX_SENSORS])
+            {
+                max_normal_detectors_from_sensor[IAS_MAX_SENSORS]
+                    = band->detectors_per_sca;
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
 /*************************************************************************
 
 NAME: ias_sat_attr_initialize
@@ -37,11 +153,28 @@ int ias_sat_attr_initialize
     {
         case IAS_L8 :
             curr_satellite = ias_sat_attr_initialize_landsat8();
-            return SUCCESS;
+            break;
+        case IAS_L4 :
+        case IAS_L5 :
+            curr_satellite = ias_sat_attr_initialize_landsat45(satellite_id);
+            break;
+        case IAS_L7 :
+            curr_satellite = ias_sat_attr_initialize_landsat7();
+            break;
         default:
             IAS_LOG_ERROR("Unrecognized satellite type");
             return ERROR;
     }
+
+    /* Flatten the attributes into the lookup tables */
+    if (build_lookup_tables(curr_satellite) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Building the satellite attribute lookup tables");
+        curr_satellite = NULL;
+        return ERROR;
+    }
+
+    return SUCCESS;
 }
 
 /*************************************************************************
@@ -96,8 +229,17 @@ IAS_SATELLITE_ID ias_sat_attr_get_satellite_id_from_satellite_number
     int satellite_number /* I: The satellite number */
 )
 {
-    if (satellite_number == 8)
-        return IAS_L8;
+    switch (satellite_number)
+    {
+        case 4:
+            return IAS_L4;
+        case 5:
+            return IAS_L5;
+        case 7:
+            return IAS_L7;
+        case 8:
+            return IAS_L8;
+    }
 
     IAS_LOG_ERROR("Unsupported satellite number: %d", satellite_number);
 
@@ -124,6 +266,12 @@ int ias_sat_attr_get_satellite_number()
 
     switch (curr_satellite->satellite_id)
     {
+        case IAS_L4:
+            return 4;
+        case IAS_L5:
+            return 5;
+        case IAS_L7:
+            return 7;
         case IAS_L8:
             return 8;
         default:
@@ -186,8 +334,6 @@ int ias_sat_attr_get_sensor_sca_count
     int sensor_id           /* I: sensor ID */
 )
 {
-    int band_index;
-
     /* Has the library been initialized? */
     if (!curr_satellite)
     {
@@ -195,21 +341,15 @@ int ias_sat_attr_get_sensor_sca_count
         return ERROR;
     }
 
-    /* Loop through the bands to find a band for that sensor and return the
-       number of SCAs it has */
-    for (band_index = 0; band_index < curr_satellite->total_bands; band_index++)
+    /* Return the number of SCAs of the first band of that sensor */
+    if ((sensor_id < 0) || (sensor_id >= IAS_MAX_SENSORS)
+        || (sca_count_from_sensor[sensor_id] == ERROR))
     {
-        const IAS_BAND_ATTRIBUTES *band_attr 
-                = &curr_satellite->band_attributes[band_index];
-
-        if (band_attr->sensor_id == sensor_id)
-        {
-            return band_attr->scas;
-        }
+        IAS_LOG_ERROR("Unknown sensor ID: %d", sensor_id);
+        return ERROR;
     }
 
-    IAS_LOG_ERROR("Unknown sensor ID: %d", sensor_id);
-    return ERROR;
+    return sca_count_from_sensor[sensor_id];
 
 }
 
@@ -569,9 +709,6 @@ int ias_sat_attr_get_band_number_from_type
     IAS_BAND_TYPE band_type     /* I: band type to convert to a band number */
 )
 {
-    int band_index;
-    IAS_BAND_ATTRIBUTES *band;
-
     /* Check whether the Satellite Attributes haven't been initialized */
     if (!curr_satellite)
     {
@@ -579,19 +716,14 @@ int ias_sat_attr_get_band_number_from_type
         return ERROR;
     }         
 
-    band = curr_satellite->band_attributes;
-
-    /* search the bands to find a matching one */
-    for (band_index = 0; band_index < curr_satellite->total_bands; band_index++)
+    if ((band_type < 0) || (band_type >= IAS_NUM_BAND_TYPES)
+        || (band_number_from_type[band_type] == ERROR))
     {
-        if (band[band_index].band_type == band_type)
-        {
-            return band[band_index].band_number;
-        }
+        IAS_LOG_ERROR("Unrecognized band type: %d", band_type);
+        return ERROR;
     }
 
-    IAS_LOG_ERROR("Unrecognized band type: %d", band_type);
-    return ERROR;
+    return band_number_from_type[band_type];
 }
 
 /*************************************************************************
@@ -691,6 +823,8 @@ const char *ias_sat_attr_get_sensor_name
 {
     static const char *oli_name = "OLI";
     static const char *tirs_name = "TIRS";
+    static const char *tm_name = IAS_SENSOR_NAME_TM;
+    static const char *etm_name = IAS_SENSOR_NAME_ETM;
     static const char *unknown = IAS_SENSOR_NAME_UNKNOWN;
 
     switch (sensor_id)
@@ -699,6 +833,10 @@ const char *ias_sat_attr_get_sensor_name
             return oli_name;
         case IAS_TIRS:
             return tirs_name;
+        case IAS_TM:
+            return tm_name;
+        case IAS_ETM:
+            return etm_name;
         default:
             return unknown;
     }
@@ -724,11 +862,6 @@ int ias_sat_attr_convert_band_number_to_sensor_band_index
     int band_number
 )
 {
-    int band_index;
-    int sensor_band_index = 0;
-
-    IAS_BAND_ATTRIBUTES *bands;
-
     /* Check whether the Satellite Attributes haven't been initialized */
     if (!curr_satellite)
     {
@@ -736,22 +869,18 @@ int ias_sat_attr_convert_band_number_to_sensor_band_index
         return ERROR;
     }
 
-    bands = curr_satellite->band_attributes;
-
-    for (band_index = 0; band_index < curr_satellite->total_bands; band_index++)
+    /* The band must belong to the sensor; its index among the sensor's
+       bands is in the lookup table */
+    if ((band_number < 1) || (band_number > curr_satellite->total_bands)
+        || (curr_satellite->band_attributes[band_number - 1].sensor_id
+                != sensor_id))
     {
-        if (bands[band_index].sensor_id == sensor_id)
-        {
-
-            if (bands[band_index].band_number == band_number)
-                return sensor_band_index;
-            sensor_band_index++;
-        }
+        IAS_LOG_ERROR("Invalid sensor ID (%d) and band number combination "
+                      "(%d)", sensor_id, band_number);
+        return ERROR;
     }
 
-    IAS_LOG_ERROR("Invalid sensor ID (%d) and band number combination (%d)",
-                  sensor_id, band_number);
-    return ERROR;
+    return sensor_band_index[band_number - 1];
 }
 
 /*************************************************************************
@@ -827,45 +956,23 @@ int ias_sat_attr_get_sensor_max_normal_detectors
                                          TIRS */
 )
 {
-    int normal_band_list[IAS_MAX_NBANDS];
-    int band_count;
-    int max_detectors = -1;
-    int index;
-
-    if (ias_sat_attr_get_sensor_band_numbers(sensor_id, IAS_NORMAL_BAND, 0,
-            normal_band_list, IAS_MAX_NBANDS, &band_count) == ERROR)
+    /* Check whether the Satellite Attributes haven't been initialized */
+    if (!curr_satellite)
     {
-        IAS_LOG_ERROR("Failed to get the list of normal bands");
+        IAS_LOG_ERROR("Satellite Attributes haven't been initialized");
         return ERROR;
     }
 
-    /* find the maximum of all the bands */
-    for (index = 0; index < band_count; index++)
-    {
-        IAS_BAND_ATTRIBUTES *band;
-        int band_number = normal_band_list[index];
-        int band_index;
-
-        band_index = ias_sat_attr_convert_band_number_to_index(band_number);
-        if (band_index == ERROR)
-        {
-            IAS_LOG_ERROR("Unabled to convert band number %d to an index",
-                          band_number);
-            return ERROR;
-        }
-
-        band = &curr_satellite->band_attributes[band_index];
-        if (band->detectors_per_sca > max_detectors)
-            max_detectors = band->detectors_per_sca;
-    }
-
-    if (max_detectors == -1)
+    /* The maximum over the normal bands is in the lookup table, with
+       IAS_MAX_SENSORS standing for any sensor */
+    if ((sensor_id < 0) || (sensor_id > IAS_MAX_SENSORS)
+        || (max_normal_detectors_from_sensor[sensor_id] == ERROR))
     {
         IAS_LOG_ERROR("No normal bands found for sensor ID %d", sensor_id);
         return ERROR;
     }
 
-    return max_detectors;
+    return max_normal_detectors_from_sensor[sensor_id];
 }
 
 
@@ -885,7 +992,7 @@ int ias_sat_attr_get_band_name_from_type_and_class
     char *band_name                                /* O: Band name */
 )
 {
-    int band_index = 0;
+    int band_index = ERROR;
 
     /* Make sure the Satellite Attributes Library has been initialized */
     if (!curr_satellite)
@@ -894,26 +1001,25 @@ int ias_sat_attr_get_band_name_from_type_and_class
         return ERROR;
     }
 
-    /* Search all of the currently defined bands */
-    for (band_index = 0;  band_index < IAS_MAX_TOTAL_BANDS; band_index++)
+    /* Look up the first band with that type and classification */
+    if ((band_type >= 0) && (band_type < IAS_NUM_BAND_TYPES)
+        && ((int)band_classification >= 0)
+        && (band_classification < BAND_CLASS_COUNT))
     {
-
-        /* Found a match -- get the name and quit */
-        if ((curr_satellite->band_attributes[band_index].band_type
-                == band_type)
-            && (curr_satellite->band_attributes[band_index]
-                    .band_classification == band_classification))
-        {
-            strcpy(band_name,
-                curr_satellite->band_attributes[band_index].band_name);
-            return SUCCESS;
-        }
+        band_index = band_index_from_type_and_class[band_type]
+                                                   [band_classification];
     }
 
     /* Didn't find it, so it's an error */
-    IAS_LOG_ERROR("No band name corresponding to specified band type and "
-        "classification found");
-    return ERROR;
+    if (band_index == ERROR)
+    {
+        IAS_LOG_ERROR("No band name corresponding to specified band type and "
+            "classification found");
+        return ERROR;
+    }
+
+    strcpy(band_name, curr_satellite->band_attributes[band_index].band_name);
+    return SUCCESS;
 }
 
 
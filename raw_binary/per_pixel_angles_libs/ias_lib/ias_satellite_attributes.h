@@ -22,6 +22,13 @@
 #define IAS_SATELLITE_NAME_L8 "L8"
 #define IAS_SENSOR_NAME_L8    "OLITIRS"
 
+/* Accepted names for the Landsat 4, 5 and 7 satellites and sensors. */
+#define IAS_SATELLITE_NAME_L4 "L4"
+#define IAS_SATELLITE_NAME_L5 "L5"
+#define IAS_SENSOR_NAME_TM    "TM"
+#define IAS_SATELLITE_NAME_L7 "L7"
+#define IAS_SENSOR_NAME_ETM   "ETM"
+
 /* Satellite and sensor "names" when the satellite and/or sensor cannot
    be determined from the satellite attributes information. */
 #define IAS_SATELLITE_NAME_UNKNOWN   "Unknown"
@@ -34,13 +41,18 @@ typedef enum
     IAS_INVALID_SENSOR_ID = -1,
     IAS_OLI,        /* OLI sensor  */
     IAS_TIRS,       /* TIRS sensor */
+    IAS_TM,         /* Landsat 4/5 Thematic Mapper sensor */
+    IAS_ETM,        /* Landsat 7 Enhanced Thematic Mapper Plus sensor */
     IAS_MAX_SENSORS, /* Total number of supported sensors */
 } IAS_SENSOR_ID;
 
 /* An enumerated type for the supported satellites. */
 typedef enum
 {
-    IAS_L8          /* Landsat 8 */
+    IAS_L8,         /* Landsat 8 */
+    IAS_L4,         /* Landsat 4 */
+    IAS_L5,         /* Landsat 5 */
+    IAS_L7          /* Landsat 7 */
 
 } IAS_SATELLITE_ID;
 
@@ -86,12 +98,12 @@ typedef enum
     IAS_SPECTRAL_THERMAL
 } IAS_SPECTRAL_TYPE;
 
-/* The sensor types supported.  Currently, only pushbroom sensors are
-   supported.  However, this will allow expanding the sensor types supported
-   in the future. */
+/* The sensor types supported: the pushbroom OLI/TIRS sensors and the
+   whiskbroom (scanning) TM/ETM+ sensors. */
 typedef enum
 {
-    IAS_PUSHBROOM_SENSOR
+    IAS_PUSHBROOM_SENSOR,
+    IAS_WHISKBROOM_SENSOR
 
 } IAS_SENSOR_TYPE;
 
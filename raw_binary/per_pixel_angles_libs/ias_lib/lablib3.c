@@ -28,12 +28,217 @@
 /*                                                                        */
 /*========================================================================*/
 
+#include <sys/stat.h>
 #include "lablib3.h"
 
 long odl_message_count = {0};
 
 
 
+/*========================================================================*/
+/*                                                                        */
+/*                          Label Arena routines                          */
+/*                                                                        */
+/*========================================================================*/
+
+/*  Nodes are aligned to this boundary inside an arena block; strings are
+    packed with no padding  */
+#define ODL_ARENA_ALIGN      16
+
+/*  Smallest block chained onto an arena  */
+#define ODL_ARENA_MIN_BLOCK  4096
+
+/*  Size of a block header, rounded up so the block data stays aligned  */
+#define ODL_ARENA_HEADER \
+    ((sizeof(ODL_ARENA_BLOCK) + ODL_ARENA_ALIGN - 1) & ~(ODL_ARENA_ALIGN - 1))
+
+/*  One malloc'ed block of an arena.  Allocations are carved from the
+    front of the newest block; when it fills a block twice its size is
+    chained on in front of it.  */
+typedef struct Odl_Arena_Block_Structure
+{
+    struct Odl_Arena_Block_Structure *next;
+    size_t size;
+    size_t used;
+
+} ODL_ARENA_BLOCK;
+
+struct Odl_Arena_Structure
+{
+    ODL_ARENA_BLOCK *blocks;  /* newest block first; the arena itself
+                                 lives in the oldest one */
+    OBJDESC *root;            /* freeing this node releases the arena */
+    char *file_name;          /* label file name shared by all nodes */
+};
+
+/*  Arena the node constructors allocate from while OdlParseLabelFileArena
+    is parsing, NULL otherwise  */
+static ODL_ARENA *odl_arena = {NULL};
+
+
+/************************************************************************/
+/*                                                                      */
+/*  Local routine:  OdlArenaAlloc                                       */
+/*                                                                      */
+/*      Returns size bytes aligned to align (a power of two) from the   */
+/*      arena, chaining on a new block if the newest one is full.       */
+/*                                                                      */
+/************************************************************************/
+
+static void *OdlArenaAlloc (ODL_ARENA_BLOCK **blocks, size_t size, 
+                            size_t align)
+{
+    ODL_ARENA_BLOCK *block = *blocks;
+    ODL_ARENA_BLOCK *new_block = {NULL};
+    size_t offset = {0};
+    size_t block_size = {ODL_ARENA_MIN_BLOCK};
+
+    if (block != NULL)
+        offset = (block->used + align - 1) & ~(align - 1);
+
+    if ((block == NULL) || (offset + size > block->size))
+    {
+        if (block != NULL)
+            block_size = 2 * block->size;
+        if (block_size < size)
+            block_size = size;
+
+        if ((new_block = (ODL_ARENA_BLOCK *)malloc(ODL_ARENA_HEADER 
+                                                   + block_size)) == NULL)
+            SayGoodbye()
+
+        new_block->next = block;
+        new_block->size = block_size;
+        new_block->used = 0;
+        *blocks = block = new_block;
+        offset = 0;
+    }
+
+    block->used = offset + size;
+
+    return((char *)block + ODL_ARENA_HEADER + offset);
+
+}  /*  End:  "OdlArenaAlloc"  */
+
+
+/************************************************************************/
+/*                                                                      */
+/*  Local routine:  OdlArenaCreate                                      */
+/*                                                                      */
+/*      Creates an arena whose first block holds at least size_hint     */
+/*      bytes, so a label of known size usually fits in one block.     */
+/*                                                                      */
+/************************************************************************/
+
+static ODL_ARENA *OdlArenaCreate (size_t size_hint)
+{
+    ODL_ARENA_BLOCK *blocks = {NULL};
+    ODL_ARENA *arena = {NULL};
+
+    /*  open the first block at the hinted size, then hand it back empty  */
+    (void)OdlArenaAlloc(&blocks, size_hint, 1);
+    blocks->used = 0;
+
+    arena = (ODL_ARENA *)OdlArenaAlloc(&blocks, sizeof(ODL_ARENA), 
+                                       ODL_ARENA_ALIGN);
+    arena->blocks = blocks;
+    arena->root = NULL;
+    arena->file_name = NULL;
+
+    return(arena);
+
+}  /*  End:  "OdlArenaCreate"  */
+
+
+/************************************************************************/
+/*                                                                      */
+/*  Local routine:  OdlArenaRelease                                     */
+/*                                                                      */
+/*      Frees every block of the arena, and with them the arena itself  */
+/*      and all the nodes and strings allocated from it.                */
+/*                                                                      */
+/************************************************************************/
+
+static void OdlArenaRelease (ODL_ARENA *arena)
+{
+    ODL_ARENA_BLOCK *block = arena->blocks;
+    ODL_ARENA_BLOCK *next_block = {NULL};
+
+    for (; block != NULL; block = next_block)
+    {
+        next_block = block->next;
+        free(block);
+    }
+
+}  /*  End:  "OdlArenaRelease"  */
+
+
+/************************************************************************/
+/*                                                                      */
+/*  Local routine:  OdlNodeAlloc                                        */
+/*                                                                      */
+/*      Allocates a node from the parse arena, or with malloc when no   */
+/*      arena parse is in progress.                                     */
+/*                                                                      */
+/************************************************************************/
+
+static void *OdlNodeAlloc (size_t size)
+{
+    void *node = {NULL};
+
+    if (odl_arena != NULL)
+        node = OdlArenaAlloc(&odl_arena->blocks, size, ODL_ARENA_ALIGN);
+    else
+    if ((node = malloc(size)) == NULL)
+        SayGoodbye()
+
+    return(node);
+
+}  /*  End:  "OdlNodeAlloc"  */
+
+
+/************************************************************************/
+/*                                                                      */
+/*  Local routine:  OdlNodeString                                       */
+/*                                                                      */
+/*      Returns a copy of text for a node field, from the parse arena   */
+/*      or with malloc when no arena parse is in progress.  In an       */
+/*      arena, a file name matching the label's is shared rather than   */
+/*      copied for every node.                                          */
+/*                                                                      */
+/************************************************************************/
+
+static char *OdlNodeString (const char *text, int is_file_name)
+{
+    char *new_text = {NULL};
+    size_t size = {0};
+
+    if (text == NULL)
+        return(NULL);
+
+    if (odl_arena == NULL)
+    {
+        CopyString(new_text, text)
+        return(new_text);
+    }
+
+    if (is_file_name && (odl_arena->file_name != NULL) 
+        && (strcmp(odl_arena->file_name, text) == 0))
+        return(odl_arena->file_name);
+
+    size = strlen(text) + 1;
+    new_text = (char *)OdlArenaAlloc(&odl_arena->blocks, size, 1);
+    (void)memcpy(new_text, text, size);
+
+    if (is_file_name && (odl_arena->file_name == NULL))
+        odl_arena->file_name = new_text;
+
+    return(new_text);
+
+}  /*  End:  "OdlNodeString"  */
+
+
+
 
 
 /*========================================================================*/
@@ -139,6 +344,72 @@ OBJDESC *OdlParseLabelFile (char *filespec, char *message_fname, MASK expand,
 
 
 
+/************************************************************************/
+/*                                                                      */
+/*  Component:                                                          */
+/*                                                                      */
+/*      OdlParseLabelFileArena                                          */
+/*                                                                      */
+/*----------------------------------------------------------------------*/
+/*                                                                      */
+/*  Description:                                                        */
+/*                                                                      */
+/*      This routine parses a file containing a PDS label like          */
+/*      OdlParseLabelFile, but allocates every node and string of the   */
+/*      tree from a single arena sized from the label file, instead of  */
+/*      with one malloc apiece.  "^" keywords are not expanded, since   */
+/*      the expanded trees would not belong to the arena.               */
+/*                                                                      */
+/*      WARNING:  The tree is released in one call by passing its root  */
+/*                to OdlFreeTree.  Freeing any other node of the tree   */
+/*                does nothing; its memory goes with the root's.        */
+/*                                                                      */
+/************************************************************************/
+
+#ifdef _NO_PROTO
+
+OBJDESC *OdlParseLabelFileArena (filespec, message_fname, suppress_messages)
+
+char *filespec;
+char *message_fname;
+int suppress_messages;
+
+#else
+
+OBJDESC *OdlParseLabelFileArena (char *filespec, char *message_fname, 
+                                 int suppress_messages)
+
+#endif
+
+{
+    OBJDESC *root = {NULL};
+    ODL_ARENA *arena = {NULL};
+    struct stat label_stat;
+    size_t size_hint = {0};
+
+    /*  the tree typically takes a few times the label's size, mostly in
+        node structures for the short keyword lines  */
+    if ((filespec != NULL) && (stat(filespec, &label_stat) == 0))
+        size_hint = 4 * (size_t)label_stat.st_size;
+
+    arena = OdlArenaCreate(size_hint);
+
+    odl_arena = arena;
+    root = (OBJDESC *) OdlParseFile(filespec,NULL,message_fname,NULL,suppress_messages,1,1,0);
+    odl_arena = NULL;
+
+    if (root == NULL)
+        OdlArenaRelease(arena);
+    else
+        arena->root = root;
+
+    return(root);
+
+}  /*  End:  "OdlParseLabelFileArena"  */
+
+
+
+
 /************************************************************************/
 /*                                                                      */
 /*  Component:                                                          */
@@ -1024,16 +1295,17 @@ OBJDESC *OdlNewObjDesc (const char *object_class, const char *pre_comment,
 {
     OBJDESC *new_object = {NULL};
 
-    if ((new_object = (OBJDESC *)malloc(sizeof(OBJDESC))) == NULL)
+    if ((new_object = (OBJDESC *)OdlNodeAlloc(sizeof(OBJDESC))) == NULL)
         SayGoodbye()
     else
     {
-        CopyString(new_object->class, object_class)
-        CopyString(new_object->pre_comment, pre_comment)
-        CopyString(new_object->line_comment, line_comment)
-        CopyString(new_object->post_comment, post_comment)
-        CopyString(new_object->end_comment, end_comment)
-        CopyString(new_object->file_name, file_name)
+        new_object->class = OdlNodeString(object_class, FALSE);
+        new_object->pre_comment = OdlNodeString(pre_comment, FALSE);
+        new_object->line_comment = OdlNodeString(line_comment, FALSE);
+        new_object->post_comment = OdlNodeString(post_comment, FALSE);
+        new_object->end_comment = OdlNodeString(end_comment, FALSE);
+        new_object->file_name = OdlNodeString(file_name, TRUE);
+        new_object->arena = odl_arena;
 
         new_object->is_a_group = is_a_group;
         new_object->child_count = 0;
@@ -1943,15 +2215,16 @@ KEYWORD *OdlNewKwd (char *keyword_name, char *value_text, char *pre_comment,
 {
     KEYWORD *new_keyword = {NULL};
 
-    if ((new_keyword = (KEYWORD *)malloc(sizeof(KEYWORD))) == NULL)
+    if ((new_keyword = (KEYWORD *)OdlNodeAlloc(sizeof(KEYWORD))) == NULL)
         SayGoodbye()
     else
     {
-        CopyString(new_keyword->name, keyword_name)
-        CopyString(new_keyword->pre_comment, pre_comment)
-        CopyString(new_keyword->line_comment, line_comment)
-        CopyString(new_keyword->file_name, file_name)
-        CopyString(new_keyword->value, value_text)
+        new_keyword->name = OdlNodeString(keyword_name, FALSE);
+        new_keyword->pre_comment = OdlNodeString(pre_comment, FALSE);
+        new_keyword->line_comment = OdlNodeString(line_comment, FALSE);
+        new_keyword->file_name = OdlNodeString(file_name, TRUE);
+        new_keyword->value = OdlNodeString(value_text, FALSE);
+        new_keyword->arena = odl_arena;
 
         new_keyword->is_a_pointer = (keyword_name == NULL) ? FALSE : (*keyword_name == '^');
 
@@ -2459,6 +2732,14 @@ OBJDESC *OdlFreeTree (OBJDESC *object)
 
 #endif
 {
+    if ((object != NULL) && (object->arena != NULL))
+    {
+        /*  arena nodes go all at once, when the arena's root is freed  */
+        if (object->arena->root == object)
+            OdlArenaRelease(object->arena);
+        object = NULL;
+    }
+    else
     if (object != NULL)
     {
         (void)OdlFreeTree(object->first_child);
@@ -2580,6 +2861,9 @@ KEYWORD *OdlFreeKwd (KEYWORD *keyword)
 {
     KEYWORD *next_kwd = {NULL};
 
+    if ((keyword != NULL) && (keyword->arena != NULL))
+        next_kwd = keyword->right_sibling;
+    else
     if (keyword != NULL)
     {
         next_kwd = keyword->right_sibling;
@@ -3966,8 +4250,8 @@ OBJDESC *OdlParseFile( char *label_fname, FILE *label_fptr,
                                    suppress_messages);
     
                     /*  set the current object's remaining comment fields  */
-                    CopyString(curr_object->post_comment, comment)
-                    CopyString(curr_object->end_comment, line_comment)
+                    curr_object->post_comment = OdlNodeString(comment, FALSE);
+                    curr_object->end_comment = OdlNodeString(line_comment, FALSE);
     
                     /*  make curr object's parent the new current object  */
                     if (curr_object->parent != NULL)
@@ -3984,7 +4268,7 @@ OBJDESC *OdlParseFile( char *label_fname, FILE *label_fptr,
                      (strcmp(left_part, "END") == 0))
                 {
                     end_found = TRUE;
-                    CopyString(curr_object->post_comment, comment)
+                    curr_object->post_comment = OdlNodeString(comment, FALSE);
                 }
                 else
         /*------------------------------------------------------------------*/
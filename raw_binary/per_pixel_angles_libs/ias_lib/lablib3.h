@@ -69,6 +69,13 @@
 /*                              Typedefs                                  */
 /**************************************************************************/
 
+/*  An ODL_ARENA owns every node and string of a tree parsed with
+    OdlParseLabelFileArena, so the tree is released in one OdlFreeTree call
+    on its root instead of node by node.  Nodes of an arena tree must not
+    be mixed with individually allocated nodes.
+*/
+typedef struct Odl_Arena_Structure ODL_ARENA;
+
 typedef struct Object_Structure
 {
     char *class;
@@ -90,6 +97,7 @@ typedef struct Object_Structure
     struct Object_Structure *last_child;
     struct Keyword_Structure *first_keyword;
     struct Keyword_Structure *last_keyword;
+    ODL_ARENA *arena;   /*  owning arena, NULL if individually allocated  */
 
 } OBJDESC;
 
@@ -109,6 +117,7 @@ typedef struct Keyword_Structure
     struct Object_Structure *parent;
     struct Keyword_Structure *left_sibling;
     struct Keyword_Structure *right_sibling;
+    ODL_ARENA *arena;   /*  owning arena, NULL if individually allocated  */
 
 } KEYWORD;
 
@@ -119,6 +128,7 @@ typedef struct Keyword_Structure
 #ifdef _NO_PROTO
 
 OBJDESC *OdlParseLabelFile();
+OBJDESC *OdlParseLabelFileArena();
 OBJDESC *OdlParseLabelString();
 OBJDESC *OdlExpandLabelFile();
 unsigned short ExpandIsRecursive();
@@ -188,6 +198,7 @@ short CheckBalance();
 #else
 
 OBJDESC *OdlParseLabelFile (char *, char *, MASK, int);
+OBJDESC *OdlParseLabelFileArena (char *, char *, int);
 OBJDESC *OdlParseLabelString (char *, char *, MASK, int);
 OBJDESC *OdlExpandLabelFile (OBJDESC *, char *, MASK, int);
 unsigned short ExpandIsRecursive (KEYWORD *, char *);
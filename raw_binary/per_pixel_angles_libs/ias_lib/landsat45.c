@@ -0,0 +1,235 @@
+/*************************************************************************
+
+NAME: landsat45.c
+
+PURPOSE: Defines the attributes for Landsat 4 and 5
+
+**************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ias_logging.h"
+#include "ias_satellite_attributes.h"  /* Function prototypes and additional
+                                          required headers */
+#include "local_defines.h"
+
+#define TM_DETECTORS_PER_SCA_NORMAL 16
+#define TM_DETECTORS_PER_SCA_THERMAL 4
+#define TM_PIXEL_RESOLUTION_NORMAL 30
+#define TM_PIXEL_RESOLUTION_THERMAL 120
+#define TM_NUMBER_OF_SCA 1
+#define L45_TOTAL_NUMBER_OF_BANDS 7
+/* The QUANTIZE_CAL_MIN and QUANTIZE_CAL_MAX defines are used by
+   the radiance rescaling to adjust the output range of the data. */
+#define QUANTIZE_CAL_MIN 1
+#define QUANTIZE_CAL_MAX 255
+
+static IAS_SATELLITE_ATTRIBUTES tm_sat_attribs;
+static IAS_BAND_ATTRIBUTES tm_band_attribs[L45_TOTAL_NUMBER_OF_BANDS];
+static IAS_SENSOR_ID sensor_id[1];
+
+/*************************************************************************
+
+NAME: ias_sat_attr_initialize_landsat45
+
+PURPOSE: Initializes an IAS_SATELLITE_ATTRIBUTES structure for
+         Landsat 4 or 5, which carry the same Thematic Mapper sensor.
+
+RETURNS: Constant pointer to the created IAS_SATELLITE_ATTRIBUTES
+         structure or NULL if an error occurs
+
+NOTES:
+    The band numbers for Landsat 4 and 5 are defined as:
+        1: TM_Blue
+        2: TM_Green
+        3: TM_Red
+        4: TM_NIR
+        5: TM_SWIR1
+        6: TM_THERMAL
+        7: TM_SWIR2
+    The TM is a scanning sensor, so it has no blind or VRP bands.  Its
+    detector arrays are described as a single SCA per band, which is how
+    the angle coefficient files model them.
+
+**************************************************************************/
+IAS_SATELLITE_ATTRIBUTES *ias_sat_attr_initialize_landsat45
+(
+    IAS_SATELLITE_ID satellite_id   /* I: IAS_L4 or IAS_L5 */
+)
+{
+    int band_index;
+
+    /* Allocate sensor_ids pointer to static structure object */
+    tm_sat_attribs.sensor_ids = &sensor_id[0];
+
+    /* Allocate tm_band_attributes pointer to static structure object */
+    tm_sat_attribs.band_attributes = &tm_band_attribs[0];
+
+    /* Initialization the Satellite Attributes structure */
+    tm_sat_attribs.satellite_id = satellite_id;
+    tm_sat_attribs.sensors = 1;
+    tm_sat_attribs.bands = L45_TOTAL_NUMBER_OF_BANDS;
+    tm_sat_attribs.total_bands = L45_TOTAL_NUMBER_OF_BANDS;
+
+    strncpy(tm_sat_attribs.satellite_name, (satellite_id == IAS_L4)
+        ? IAS_SATELLITE_NAME_L4 : IAS_SATELLITE_NAME_L5,
+        sizeof(tm_sat_attribs.satellite_name));
+    tm_sat_attribs.satellite_name[sizeof(tm_sat_attribs.satellite_name) - 1]
+        = '\0';
+    strncpy(tm_sat_attribs.sensor_name, IAS_SENSOR_NAME_TM,
+        sizeof(tm_sat_attribs.sensor_name));
+    tm_sat_attribs.sensor_name[sizeof(tm_sat_attribs.sensor_name) - 1] = '\0';
+
+    sensor_id[0] = IAS_TM;
+
+    for (band_index = 0; band_index < L45_TOTAL_NUMBER_OF_BANDS; band_index++)
+    {
+        tm_band_attribs[band_index].band_number = band_index + 1;
+        tm_band_attribs[band_index].band_index = band_index;
+        tm_band_attribs[band_index].qcal_min = QUANTIZE_CAL_MIN;
+        tm_band_attribs[band_index].qcal_max = QUANTIZE_CAL_MAX;
+    }
+
+    /* Set up the TM blue band (band number 1) */
+    band_index = 0;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_Blue");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_BLUE_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    tm_band_attribs[band_index].normal_band_number = 1;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_NORMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_NORMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=450;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=520;
+
+    /* Set up the TM green band (band number 2) */
+    band_index++;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_Green");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_GREEN_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    tm_band_attribs[band_index].normal_band_number = 2;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_NORMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_NORMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=520;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=600;
+
+    /* Set up the TM red band (band number 3) */
+    band_index++;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_Red");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_RED_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    tm_band_attribs[band_index].normal_band_number = 3;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_NORMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_NORMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=630;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=690;
+
+    /* Set up the TM Near Infrared (NIR) band (band number 4) */
+    band_index++;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_NIR");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_NIR_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    tm_band_attribs[band_index].normal_band_number = 4;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_NORMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_NORMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=760;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=900;
+
+    /* Set up the first TM Shortwave Infrared (SWIR) band (band number 5) */
+    band_index++;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_SWIR1");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_SWIR1_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_SWIR;
+    tm_band_attribs[band_index].normal_band_number = 5;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_NORMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_NORMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=1550;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=1750;
+
+    /* Set up the TM thermal band (band number 6) */
+    band_index++;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_THERMAL");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_THERMAL1_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_THERMAL;
+    tm_band_attribs[band_index].normal_band_number = 6;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_THERMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_THERMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=10400;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=12500;
+
+    /* Set up the second TM Shortwave Infrared (SWIR) band (band number 7) */
+    band_index++;
+    strcpy(tm_band_attribs[band_index].band_name, "TM_SWIR2");
+    tm_band_attribs[band_index].sensor_id = IAS_TM;
+    tm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    tm_band_attribs[band_index].band_type = IAS_SWIR2_BAND;
+    tm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    tm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_SWIR;
+    tm_band_attribs[band_index].normal_band_number = 7;
+    tm_band_attribs[band_index].vrp_band_number = 0;
+    tm_band_attribs[band_index].blind_band_number = 0;
+    tm_band_attribs[band_index].secondary_band_number = 0;
+    tm_band_attribs[band_index].scas = TM_NUMBER_OF_SCA;
+    tm_band_attribs[band_index].detectors_per_sca =
+                            TM_DETECTORS_PER_SCA_NORMAL;
+    tm_band_attribs[band_index].lines_per_frame = 1;
+    tm_band_attribs[band_index].pixel_resolution = TM_PIXEL_RESOLUTION_NORMAL;
+    tm_band_attribs[band_index].wavelength_nm_range[0]=2080;
+    tm_band_attribs[band_index].wavelength_nm_range[1]=2350;
+
+    return &tm_sat_attribs;
+}
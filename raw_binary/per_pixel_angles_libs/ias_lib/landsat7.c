@@ -0,0 +1,263 @@
+/*************************************************************************
+
+NAME: landsat7.c
+
+PURPOSE: Defines the attributes for Landsat 7
+
+**************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ias_logging.h"
+#include "ias_satellite_attributes.h"  /* Function prototypes and additional
+                                          required headers */
+#include "local_defines.h"
+
+#define ETM_DETECTORS_PER_SCA_NORMAL 16
+#define ETM_DETECTORS_PER_SCA_THERMAL 8
+#define ETM_DETECTORS_PER_SCA_PAN 32
+#define ETM_PIXEL_RESOLUTION_NORMAL 30
+#define ETM_PIXEL_RESOLUTION_THERMAL 60
+#define ETM_PIXEL_RESOLUTION_PAN 15
+#define ETM_NUMBER_OF_SCA 1
+#define L7_TOTAL_NUMBER_OF_BANDS 8
+/* The QUANTIZE_CAL_MIN and QUANTIZE_CAL_MAX defines are used by
+   the radiance rescaling to adjust the output range of the data. */
+#define QUANTIZE_CAL_MIN 1
+#define QUANTIZE_CAL_MAX 255
+
+static IAS_SATELLITE_ATTRIBUTES etm_sat_attribs;
+static IAS_BAND_ATTRIBUTES etm_band_attribs[L7_TOTAL_NUMBER_OF_BANDS];
+static IAS_SENSOR_ID sensor_id[1];
+
+/*************************************************************************
+
+NAME: ias_sat_attr_initialize_landsat7
+
+PURPOSE: Initializes an IAS_SATELLITE_ATTRIBUTES structure for
+         Landsat 7.
+
+RETURNS: Constant pointer to the created IAS_SATELLITE_ATTRIBUTES
+         structure or NULL if an error occurs
+
+NOTES:
+    The band numbers for Landsat 7 are defined as:
+        1: ETM_Blue
+        2: ETM_Green
+        3: ETM_Red
+        4: ETM_NIR
+        5: ETM_SWIR1
+        6: ETM_THERMAL
+        7: ETM_SWIR2
+        8: ETM_PAN
+    Band 6 follows the angle coefficient files, which have a single band 6
+    for the low and high gain thermal images.  The ETM+ is a scanning
+    sensor, so it has no blind or VRP bands, and its detector arrays are
+    described as a single SCA per band.
+
+**************************************************************************/
+IAS_SATELLITE_ATTRIBUTES *ias_sat_attr_initialize_landsat7()
+{
+    int band_index;
+
+    /* Allocate sensor_ids pointer to static structure object */
+    etm_sat_attribs.sensor_ids = &sensor_id[0];
+
+    /* Allocate etm_band_attributes pointer to static structure object */
+    etm_sat_attribs.band_attributes = &etm_band_attribs[0];
+
+    /* Initialization the Satellite Attributes structure */
+    etm_sat_attribs.satellite_id = IAS_L7;
+    etm_sat_attribs.sensors = 1;
+    etm_sat_attribs.bands = L7_TOTAL_NUMBER_OF_BANDS;
+    etm_sat_attribs.total_bands = L7_TOTAL_NUMBER_OF_BANDS;
+
+    strncpy(etm_sat_attribs.satellite_name, IAS_SATELLITE_NAME_L7,
+        sizeof(etm_sat_attribs.satellite_name));
+    etm_sat_attribs.satellite_name[sizeof(etm_sat_attribs.satellite_name) - 1]
+        = '\0';
+    strncpy(etm_sat_attribs.sensor_name, IAS_SENSOR_NAME_ETM,
+        sizeof(etm_sat_attribs.sensor_name));
+    etm_sat_attribs.sensor_name[sizeof(etm_sat_attribs.sensor_name) - 1]
+        = '\0';
+
+    sensor_id[0] = IAS_ETM;
+
+    for (band_index = 0; band_index < L7_TOTAL_NUMBER_OF_BANDS; band_index++)
+    {
+        etm_band_attribs[band_index].band_number = band_index + 1;
+        etm_band_attribs[band_index].band_index = band_index;
+        etm_band_attribs[band_index].qcal_min = QUANTIZE_CAL_MIN;
+        etm_band_attribs[band_index].qcal_max = QUANTIZE_CAL_MAX;
+    }
+
+    /* Set up the ETM+ blue band (band number 1) */
+    band_index = 0;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_Blue");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_BLUE_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    etm_band_attribs[band_index].normal_band_number = 1;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_NORMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_NORMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=450;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=515;
+
+    /* Set up the ETM+ green band (band number 2) */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_Green");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_GREEN_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    etm_band_attribs[band_index].normal_band_number = 2;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_NORMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_NORMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=525;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=605;
+
+    /* Set up the ETM+ red band (band number 3) */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_Red");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_RED_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    etm_band_attribs[band_index].normal_band_number = 3;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_NORMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_NORMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=630;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=690;
+
+    /* Set up the ETM+ Near Infrared (NIR) band (band number 4) */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_NIR");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_NIR_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_VNIR;
+    etm_band_attribs[band_index].normal_band_number = 4;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_NORMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_NORMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=775;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=900;
+
+    /* Set up the first ETM+ Shortwave Infrared (SWIR) band (band number 5) */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_SWIR1");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_SWIR1_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_SWIR;
+    etm_band_attribs[band_index].normal_band_number = 5;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_NORMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_NORMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=1550;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=1750;
+
+    /* Set up the ETM+ thermal band (band number 6), which covers both the
+       low and high gain (VCID 1 and 2) images */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_THERMAL");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_THERMAL1_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_THERMAL;
+    etm_band_attribs[band_index].normal_band_number = 6;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_THERMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_THERMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=10400;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=12500;
+
+    /* Set up the second ETM+ Shortwave Infrared (SWIR) band (band number 7) */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_SWIR2");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_SWIR2_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_SWIR;
+    etm_band_attribs[band_index].normal_band_number = 7;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca =
+                            ETM_DETECTORS_PER_SCA_NORMAL;
+    etm_band_attribs[band_index].lines_per_frame = 1;
+    etm_band_attribs[band_index].pixel_resolution =
+                            ETM_PIXEL_RESOLUTION_NORMAL;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=2090;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=2350;
+
+    /* Set up the ETM+ Panchromatic band (band number 8) */
+    band_index++;
+    strcpy(etm_band_attribs[band_index].band_name, "ETM_PAN");
+    etm_band_attribs[band_index].sensor_id = IAS_ETM;
+    etm_band_attribs[band_index].sensor_type = IAS_WHISKBROOM_SENSOR;
+    etm_band_attribs[band_index].band_type = IAS_PAN_BAND;
+    etm_band_attribs[band_index].band_classification = IAS_NORMAL_BAND;
+    etm_band_attribs[band_index].spectral_type = IAS_SPECTRAL_PAN;
+    etm_band_attribs[band_index].normal_band_number = 8;
+    etm_band_attribs[band_index].vrp_band_number = 0;
+    etm_band_attribs[band_index].blind_band_number = 0;
+    etm_band_attribs[band_index].secondary_band_number = 0;
+    etm_band_attribs[band_index].scas = ETM_NUMBER_OF_SCA;
+    etm_band_attribs[band_index].detectors_per_sca = ETM_DETECTORS_PER_SCA_PAN;
+    etm_band_attribs[band_index].lines_per_frame = 2;
+    etm_band_attribs[band_index].pixel_resolution = ETM_PIXEL_RESOLUTION_PAN;
+    etm_band_attribs[band_index].wavelength_nm_range[0]=520;
+    etm_band_attribs[band_index].wavelength_nm_range[1]=900;
+
+    return &etm_sat_attribs;
+}
@@ -5,4 +5,11 @@
 
 IAS_SATELLITE_ATTRIBUTES *ias_sat_attr_initialize_landsat8();
 
+IAS_SATELLITE_ATTRIBUTES *ias_sat_attr_initialize_landsat45
+(
+    IAS_SATELLITE_ID satellite_id   /* I: IAS_L4 or IAS_L5 */
+);
+
+IAS_SATELLITE_ATTRIBUTES *ias_sat_attr_initialize_landsat7();
+
 #endif
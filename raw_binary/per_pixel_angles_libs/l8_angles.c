@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 /* IAS Library Includes */
 #include "ias_logging.h"
@@ -12,10 +13,78 @@
 
 /* Local Includes */
 #include "l8_angles.h"
+#include "espa_profile.h"
+#include "espa_probe.h"
+#include "espa_memory.h"
+#include "espa_alloc.h"
+#include "espa_task.h"
+#include "espa_progress.h"
+
+/* Angles evaluated exactly at one point of the angle grid */
+typedef struct angle_grid_point
+{
+    int sca_key;            /* SCA(s) containing the point, -1 if none */
+    double sat_angles[2];   /* Satellite angles (radians) */
+    double sun_angles[2];   /* Solar angles (radians) */
+} ANGLE_GRID_POINT;
+
+/* Indices of the angles generated for each band */
+#define ANG_SOLAR_ZENITH 0
+#define ANG_SOLAR_AZIMUTH 1
+#define ANG_SAT_ZENITH 2
+#define ANG_SAT_AZIMUTH 3
+#define NUM_ANGLES 4
+
+/* Output lines evaluated together when the angles are offloaded */
+#define OFFLOAD_TILE_LINES 64
 
 /* Prototypes */
+static int get_grid_rows (int num_lines, int spacing);
+static size_t get_angle_line_bytes (const IAS_ANGLE_GEN_METADATA *metadata,
+    const L8_ANGLES_PARAMETERS *parameters);
+static void log_grid_stats (const L8_ANGLES_PARAMETERS *parameters,
+    int num_cells, int num_interp_cells, int max_error);
+static void free_angle_buffers (IAS_ANGLE_GEN_METADATA *metadata,
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS],
+    short *band_line[NUM_ANGLES][L8_NBANDS], long *sum, ushort *pix_count,
+    short **avg_angles[NUM_ANGLES]);
+static IAS_MISC_LINE_EXTENT *get_trim_lut (
+    const IAS_ANGLE_GEN_METADATA *metadata, int band_index,
+    const ANGLES_FRAME *frame, IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS]);
+static void free_trim_luts (IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS]);
+static int init_angle_generation (char *angle_coeff_name, int subsamp_fact,
+    short fill_pix_value, char *band_list, int grid_spacing,
+    double max_grid_error, int verify_grid_flag, int nthreads,
+    int share_band_flag, const char *dem_filename,
+    L8_ANGLES_PARAMETERS *parameters, IAS_ANGLE_GEN_METADATA *metadata);
 static int process_parameters (char *angle_coeff_name, int subsamp_fact,
     short fill_pix_value, char *band_list, L8_ANGLES_PARAMETERS *parameters);
+static int grid_band_angles (const IAS_ANGLE_GEN_METADATA *metadata,
+    const L8_ANGLES_PARAMETERS *parameters, int band_index,
+    const IAS_MISC_LINE_EXTENT *trim_lut, int num_lines, int num_samps,
+    short *sat_zenith, short *sat_azimuth, short *solar_zenith,
+    short *solar_azimuth);
+static int grid_block_angles (const IAS_ANGLE_GEN_METADATA *metadata,
+    const L8_ANGLES_PARAMETERS *parameters, int band_index,
+    const IAS_MISC_LINE_EXTENT *trim_lut, int num_lines, int num_samps,
+    int first_row, int end_row, int buf_line, short *sat_zenith,
+    short *sat_azimuth, short *solar_zenith, short *solar_azimuth,
+    int *num_cells, int *num_interp_cells, int *max_error);
+static int exact_line_angles (const IAS_ANGLE_GEN_METADATA *metadata,
+    L8_ANGLES_DEM *dem, int band_index, const IAS_MISC_LINE_EXTENT *extent,
+    int line, int num_samps, int sub_sample, ANGLE_TYPE angle_type,
+    short background, short *sat_zenith, short *sat_azimuth,
+    short *solar_zenith, short *solar_azimuth);
+static int exact_block_angles (const IAS_ANGLE_GEN_METADATA *metadata,
+    const L8_ANGLES_PARAMETERS *parameters, int band_index,
+    const IAS_MISC_LINE_EXTENT *trim_lut, int num_samps, int first_line,
+    int end_line, int buf_line, short *sat_zenith, short *sat_azimuth,
+    short *solar_zenith, short *solar_azimuth);
+static int offload_block_angles (const IAS_ANGLE_GEN_METADATA *metadata,
+    const L8_ANGLES_PARAMETERS *parameters, int band_index,
+    const IAS_MISC_LINE_EXTENT *trim_lut, int num_samps, int first_line,
+    int end_line, int buf_line, short *sat_zenith, short *sat_azimuth,
+    short *solar_zenith, short *solar_azimuth);
 
 /**************************************************************************
 NAME: l8_per_pixel_angles
@@ -43,6 +112,8 @@ NOTES:
   3. It will be up to the calling routine to delete the memory allocated
      for these per band angle arrays.
   4. The angles that are returned are in degrees and have been scaled by 100.
+  5. Every pixel is evaluated exactly.  See l8_per_pixel_angles_grid for
+     evaluating the angles on a coarse grid and interpolating between.
 ***************************************************************************/
 int l8_per_pixel_angles
 (
@@ -52,11 +123,111 @@ int l8_per_pixel_angles
                                   sample from the line, where N=subsamp_fact */
     short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
     char *band_list,        /* I: Band list used to calculate angles for.
-                                  "ALL" - defaults to all bands 1 - 11.
+                                  "ALL" - defaults to all satellite bands.
+                                  Must be comma separated with no spaces in
+                                  between.  Example: 1,2,3,4,5,6,7,8,9
+                                  The solar/sat_zenith/azimuth arrays should
+                                  will have angles processed for these bands */
+    ANGLES_FRAME frame[L8_NBANDS],   /* O: Image frame info for each band */
+    short *solar_zenith[L8_NBANDS],  /* O: Array of pointers for the solar
+                                           zenith angle array, one per band
+                                           (if NULL, don't process), degrees
+                                           scaled by 100 */
+    short *solar_azimuth[L8_NBANDS], /* O: Array of pointers for the solar
+                                           azimuth angle array, one per band
+                                           (if NULL, don't process), degrees
+                                           scaled by 100 */
+    short *sat_zenith[L8_NBANDS],    /* O: Array of pointers for the satellite
+                                           zenith angle array, one per band
+                                           (if NULL, don't process), degrees
+                                           scaled by 100 */
+    short *sat_azimuth[L8_NBANDS],   /* O: Array of pointers for the satellite
+                                           azimuth angle array, one per band
+                                           (if NULL, don't process), degrees
+                                           scaled by 100 */
+    int nlines[L8_NBANDS],  /* O: Number of lines for each band, based on the
+                                  subsample factor */
+    int nsamps[L8_NBANDS]   /* O: Number of samples for each band, based on the
+                                  subsample factor */
+)
+{
+    return l8_per_pixel_angles_grid(angle_coeff_name, subsamp_fact,
+        fill_pix_value, band_list, 1, 0.0, 0, 1, 0, frame, solar_zenith,
+        solar_azimuth, sat_zenith, sat_azimuth, nlines, nsamps);
+}
+
+
+/**************************************************************************
+NAME: l8_per_pixel_angles_grid
+
+PURPOSE:   Uses the coefficients in the angle coefficients file to generate
+the satellite viewing angle and/or solar angle values, for the specified
+list of bands.  The angles can be evaluated exactly on a coarse grid and
+interpolated between the grid points.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred generating the per-pixel solar and/or
+                view angles
+SUCCESS         Angle band generation was successful
+
+NOTES:
+  1. See l8_per_pixel_angles for the allocation of the angle bands.
+  2. With a grid spacing greater than 1, the image is split into cells of
+     grid_spacing x grid_spacing output pixels.  The RPC model is evaluated
+     exactly at the cell corners and center, and the angles in the cell are
+     bilinearly interpolated from the corners.  A cell is evaluated exactly,
+     pixel by pixel, if its corners and center are not all in the same SCA or
+     SCA overlap, if an azimuth wraps around, or if the interpolated angles
+     at the center are off by more than max_grid_error.
+  3. The angles that are returned are in degrees and have been scaled by 100.
+  4. If the library was built with threading enabled, the lines of each band
+     (or the rows of grid cells) are split across nthreads threads.  The
+     output does not depend on the number of threads.
+  5. With sharing, the solar angles are only generated for the first band of
+     each resolution group (same image size and pixel size), and the other
+     bands in the group use those solar angles.  The solar angles of
+     co-registered bands differ by far less than the 0.01 degree output
+     quantization.  The satellite angles are only shared between bands whose
+     framing and rational polynomials are identical, so they are exact.
+  6. Shared bands point to the same angle array.  Use
+     l8_free_per_pixel_angles to release the angle arrays so each one is
+     only freed once.
+  7. The progress is reported (see espa_progress.h) after each band, and
+     ERROR is returned if the job was cancelled.  The angle arrays of the
+     bands already generated are left for l8_free_per_pixel_angles, as for
+     any other error.
+***************************************************************************/
+int l8_per_pixel_angles_grid
+(
+    char *angle_coeff_name, /* I: Angle coefficient filename */
+    int subsamp_fact,       /* I: Subsample factor used when calculating the
+                                  angles (1=full resolution). OW take every Nth
+                                  sample from the line, where N=subsamp_fact */
+    short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
+    char *band_list,        /* I: Band list used to calculate angles for.
+                                  "ALL" - defaults to all satellite bands.
                                   Must be comma separated with no spaces in
                                   between.  Example: 1,2,3,4,5,6,7,8,9
                                   The solar/sat_zenith/azimuth arrays should
                                   will have angles processed for these bands */
+    int grid_spacing,       /* I: Spacing, in output pixels, of the grid where
+                                  the angles are evaluated exactly and then
+                                  interpolated between (1=evaluate every
+                                  pixel exactly) */
+    double max_grid_error,  /* I: Maximum interpolation error at the center of
+                                  a grid cell (degrees); cells over this are
+                                  evaluated exactly */
+    int verify_grid_flag,   /* I: If set, also evaluate the interpolated pixels
+                                  exactly and report the maximum error */
+    int nthreads,           /* I: Number of threads to use for generating the
+                                  angle lines (only used if built with
+                                  threading enabled) */
+    int share_band_flag,    /* I: If set, share the solar angles within each
+                                  resolution group and the satellite angles
+                                  between bands with identical geometry */
     ANGLES_FRAME frame[L8_NBANDS],   /* O: Image frame info for each band */
     short *solar_zenith[L8_NBANDS],  /* O: Array of pointers for the solar
                                            zenith angle array, one per band
@@ -89,10 +260,13 @@ int l8_per_pixel_angles
     IAS_ANGLE_GEN_METADATA metadata;  /* Angle metadata structure */ 
     char root_filename[PATH_MAX];     /* Root filename */
     char *base_ptr;                   /* Basename pointer */
-    double r2d = 4500.0 / atan(1.0);  /* Conversion to hundredths of degrees;
-                                         this includes the conversion of radians
-                                         to degrees in addition to scaling by
-                                         100.0 */
+    int band_done[IAS_MAX_NBANDS] = {0}; /* Flags for the bands that have
+                                         their angle arrays set */
+    IAS_MISC_LINE_EXTENT *band_trim_lut[L8_NBANDS] = {NULL}; /* Image trim
+                                         lookup table for each band, shared
+                                         between bands with the same active
+                                         image area */
+    ESPA_PROFILE_SCOPE("l8_per_pixel_angles_grid");
 
     /* Make sure there is something to process */
     if (solar_zenith == NULL && solar_azimuth == NULL &&
@@ -103,40 +277,17 @@ int l8_per_pixel_angles
         return ERROR;
     }
 
-    /* Initialize the logging library */
-    if (ias_log_initialize("L8 Angles") != SUCCESS)
-    {
-        IAS_LOG_ERROR("Error initializing logging library");
-        return ERROR;
-    }
-
-    /* Initialize the satellite attributes */
-    if (ias_sat_attr_initialize(IAS_L8) != SUCCESS)
-    {
-        IAS_LOG_ERROR("Initializing satellite attributes library");
-        return ERROR;
-    }
-
-    /* Process the arguments */
-    if (process_parameters(angle_coeff_name, subsamp_fact, fill_pix_value,
-        band_list, &parameters) != SUCCESS)
-    {
-        IAS_LOG_ERROR("Invalid input parameters");
+    /* Set up the parameters and read the metadata file */
+    if (init_angle_generation(angle_coeff_name, subsamp_fact, fill_pix_value,
+        band_list, grid_spacing, max_grid_error, verify_grid_flag, nthreads,
+        share_band_flag, NULL, &parameters, &metadata) != SUCCESS)
+    {  /* Error messages already written */
         return ERROR;
     }
 
     /* Setup local sub sampling factor variable */
     sub_sample = parameters.sub_sample_factor;
 
-    /* Read the metadata file */
-    if (ias_angle_gen_read_ang(parameters.metadata_filename, &metadata) 
-        != SUCCESS)
-    {
-        IAS_LOG_ERROR("Reading the metadata file %s", 
-            parameters.metadata_filename);
-        return ERROR;
-    }
-
     /* Extract the basename from the file path */
     base_ptr = strrchr(parameters.metadata_filename, '/');
     if (base_ptr)
@@ -187,14 +338,25 @@ int l8_per_pixel_angles
     /* Process the angles for each band */
     for (band_index = 0; band_index < IAS_MAX_NBANDS; band_index++)
     {
-        int line;                       /* Line index */
-        int samp;                       /* Sample index */
-        int index;                      /* Current sample index*/
-        int tmp_percent;                /* Current percentage for printing
-                                           status */
-        int curr_tmp_percent;           /* Percentage for current line */
+        int status;                     /* Status of the line loop */
         IAS_MISC_LINE_EXTENT *trim_lut; /* Image trim lookup table */
         int band_number;                /* Band number */ 
+        int solar_source = -1;          /* Band the solar angles are shared
+                                           from, -1 if not shared */
+        int sat_source = -1;            /* Band the satellite angles are
+                                           shared from, -1 if not shared */
+        short *band_sat_zenith = NULL;  /* Satellite zenith angles to
+                                           generate for this band */
+        short *band_sat_azimuth = NULL; /* Satellite azimuth angles to
+                                           generate for this band */
+        short *band_solar_zenith = NULL;  /* Solar zenith angles to generate
+                                             for this band */
+        short *band_solar_azimuth = NULL; /* Solar azimuth angles to generate
+                                             for this band */
+
+        /* Check if this band should be processed */
+        if (!parameters.process_band[band_index])
+            continue;
 
         /* Retrieve the band number for current index */
         band_number = ias_sat_attr_convert_band_index_to_number(band_index);
@@ -205,10 +367,6 @@ int l8_per_pixel_angles
             return ERROR;
         }
 
-        /* Check if this band should be processed */
-        if (!parameters.process_band[band_index])
-            continue;
-
         /* Get framing information for this band if return is not successful
            then band is not present in metadata so continue */
 /* TODO -- do we need an array of frames vs. a single frame?? */
@@ -228,180 +386,191 @@ int l8_per_pixel_angles
         /* Calculate the angle sizes */
         nlines[band_index] = num_lines;
         nsamps[band_index] = num_samps;
-        angle_size = num_lines * num_samps * sizeof(short);
+        angle_size = (size_t) num_lines * num_samps * sizeof(short);
+
+        /* Look for earlier bands to share the angles from */
+        if (parameters.share_band_flag)
+        {
+            int other_index;            /* Earlier band index */
+
+            for (other_index = 0; other_index < band_index; other_index++)
+            {
+                if (!band_done[other_index])
+                    continue;
+
+                if (solar_source < 0 && same_band_resolution(&metadata,
+                    band_index, other_index))
+                {
+                    solar_source = other_index;
+                }
+                if (sat_source < 0 && same_satellite_angles(&metadata,
+                    band_index, other_index))
+                {
+                    sat_source = other_index;
+                }
+            }
+        }
 
         /* Allocate the satellite buffers if needed */
         if (sat_zenith != NULL)
         {
-            sat_zenith[band_index] = (short *)malloc(angle_size);
-            if (!sat_zenith[band_index])
+            if (sat_source >= 0)
+                sat_zenith[band_index] = sat_zenith[sat_source];
+            else
             {
-                IAS_LOG_ERROR("Allocating satellite zenith angle array for "
-                    "band number %d", band_number);
-                ias_angle_gen_free(&metadata);
-                return ERROR;
+                sat_zenith[band_index] = espa_alloc_large(angle_size);
+                if (!sat_zenith[band_index])
+                {
+                    IAS_LOG_ERROR("Allocating satellite zenith angle array "
+                        "for band number %d", band_number);
+                    ias_angle_gen_free(&metadata);
+                    return ERROR;
+                }
+                band_sat_zenith = sat_zenith[band_index];
             }
         }
 
         if (sat_azimuth != NULL)
         {
-            sat_azimuth[band_index] = (short *)malloc(angle_size);
-            if (!sat_azimuth[band_index])
+            if (sat_source >= 0)
+                sat_azimuth[band_index] = sat_azimuth[sat_source];
+            else
             {
-                IAS_LOG_ERROR("Allocating satellite azimuth angle array for "
-                    "band number %d", band_number);
-                ias_angle_gen_free(&metadata);
-                return ERROR;
+                sat_azimuth[band_index] = espa_alloc_large(angle_size);
+                if (!sat_azimuth[band_index])
+                {
+                    IAS_LOG_ERROR("Allocating satellite azimuth angle array "
+                        "for band number %d", band_number);
+                    ias_angle_gen_free(&metadata);
+                    return ERROR;
+                }
+                band_sat_azimuth = sat_azimuth[band_index];
             }
         }
 
         /* Allocate the solar buffers if needed */
         if (solar_zenith != NULL)
         {
-            solar_zenith[band_index] = (short *)malloc(angle_size);
-            if (!solar_zenith[band_index])
+            if (solar_source >= 0)
+                solar_zenith[band_index] = solar_zenith[solar_source];
+            else
             {
-                IAS_LOG_ERROR("Allocating solar zenith angle array for band "
-                    "number %d", band_number);
-                ias_angle_gen_free(&metadata);
-                return ERROR;
+                solar_zenith[band_index] = espa_alloc_large(angle_size);
+                if (!solar_zenith[band_index])
+                {
+                    IAS_LOG_ERROR("Allocating solar zenith angle array for "
+                        "band number %d", band_number);
+                    ias_angle_gen_free(&metadata);
+                    return ERROR;
+                }
+                band_solar_zenith = solar_zenith[band_index];
             }
         }
 
         if (solar_azimuth != NULL)
         {
-            solar_azimuth[band_index] = (short *)malloc(angle_size);
-            if (!solar_azimuth[band_index])
+            if (solar_source >= 0)
+                solar_azimuth[band_index] = solar_azimuth[solar_source];
+            else
             {
-                IAS_LOG_ERROR("Allocating solar azimuth angle array for band "
-                    "number %d", band_number);
-                ias_angle_gen_free(&metadata);
-                return ERROR;
+                solar_azimuth[band_index] = espa_alloc_large(angle_size);
+                if (!solar_azimuth[band_index])
+                {
+                    IAS_LOG_ERROR("Allocating solar azimuth angle array for "
+                        "band number %d", band_number);
+                    ias_angle_gen_free(&metadata);
+                    return ERROR;
+                }
+                band_solar_azimuth = solar_azimuth[band_index];
             }
         }
+        band_done[band_index] = 1;
 
-        /* Retrieve the trim look up table to remove the scene crenulation */
-        trim_lut = ias_misc_create_output_image_trim_lut(
-            get_active_lines(&metadata, band_index), 
-            get_active_samples(&metadata, band_index),
-            frame[band_index].num_lines, frame[band_index].num_samps);
-        if (!trim_lut)
+        /* Only generate the angles that aren't shared */
+        if (solar_source >= 0)
         {
-            IAS_LOG_ERROR("Creating the scene trim lookup table for band "
-                "number %d", band_number);
-            ias_angle_gen_free(&metadata);
-            return ERROR;
+            IAS_LOG_INFO("Sharing the solar angles of band number %d",
+                frame[solar_source].band_number);
         }
-
-        /* Loop through the L1T lines and samples, and just fill everything
-           with fill. */
-        if (sat_zenith)
+        if (sat_source >= 0)
         {
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    sat_zenith[band_index][index] = parameters.background;
+            IAS_LOG_INFO("Sharing the satellite angles of band number %d",
+                frame[sat_source].band_number);
         }
-
-        if (sat_azimuth)
+        parameters.angle_type = AT_UNKNOWN;
+        if (band_solar_zenith || band_solar_azimuth)
         {
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    sat_azimuth[band_index][index] = parameters.background;
+            if (band_sat_zenith || band_sat_azimuth)
+                parameters.angle_type = AT_BOTH;
+            else
+                parameters.angle_type = AT_SOLAR;
         }
+        else if (band_sat_zenith || band_sat_azimuth)
+            parameters.angle_type = AT_SATELLITE;
+        if (parameters.angle_type == AT_UNKNOWN)
+            continue;
 
-        if (solar_zenith)
+        /* Retrieve the trim look up table to remove the scene crenulation.
+           Pixels outside the actual range of image data are filled as the
+           angles are generated. */
+        trim_lut = get_trim_lut(&metadata, band_index, &frame[band_index],
+            band_trim_lut);
+        if (!trim_lut)
         {
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    solar_zenith[band_index][index] = parameters.background;
+            IAS_LOG_ERROR("Creating the scene trim lookup table for band "
+                "number %d", band_number);
+            free_trim_luts(band_trim_lut);
+            ias_angle_gen_free(&metadata);
+            return ERROR;
         }
 
-        if (solar_azimuth)
+        /* Evaluate the angles on the coarse grid and interpolate between
+           the grid points */
+        if (parameters.grid_spacing > 1)
         {
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    solar_azimuth[band_index][index] =
-                        parameters.background;
+            if (grid_band_angles(&metadata, &parameters, band_index, trim_lut,
+                num_lines, num_samps, band_sat_zenith, band_sat_azimuth,
+                band_solar_zenith, band_solar_azimuth) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Evaluating the angle grid in band %d",
+                    band_number);
+                free_trim_luts(band_trim_lut);
+                ias_angle_gen_free(&metadata);
+                return ERROR;
+            }
         }
-
-        /* Loop through the L1T lines and samples */
-        tmp_percent = 0;
-        for (line = 0, index = 0; line < frame[band_index].num_lines;
-             line += sub_sample)
+        else
         {
-            double sun_angles[2];   /* Solar angles */
-            double sat_angles[2];   /* Viewing angles */
-
-            /* update status? */
-            curr_tmp_percent = 100 * line / frame[band_index].num_lines;
-            if (curr_tmp_percent > tmp_percent)
+            /* Evaluate every pixel of the band exactly */
+            status = exact_block_angles(&metadata, &parameters, band_index,
+                trim_lut, num_samps, 0, num_lines, 0, band_sat_zenith,
+                band_sat_azimuth, band_solar_zenith, band_solar_azimuth);
+            if (status != SUCCESS)
             {
-                tmp_percent = curr_tmp_percent;
-                if (tmp_percent % 100 == 0)
-                {
-                    printf ("%d%% ", tmp_percent);
-                    fflush (stdout);
-                }
+                IAS_LOG_ERROR("Evaluating angles in band %d", band_number);
+                free_trim_luts(band_trim_lut);
+                ias_angle_gen_free(&metadata);
+                return ERROR;
             }
+        }
 
-            for (samp = 0; samp < frame[band_index].num_samps;
-                 samp += sub_sample, index++)
-            {
-                /* If the current sample falls outside the actual range of
-                   image data in this scene, then goto the next pixel.  Fill
-                   pixels are already handled. */
-                if (samp <= trim_lut[line].start_sample || 
-                    samp >= trim_lut[line].end_sample)
-                {
-                    continue;
-                }
-
-                /* Calculate the satellite and solar azimuth and zenith */
-                if (calculate_angles (&metadata, line, samp, band_index, 
-                    parameters.angle_type, sat_angles, sun_angles) != SUCCESS)
-                {
-                    IAS_LOG_ERROR("Evaluating angles in band %d", band_number);
-                    free(trim_lut);
-                    ias_angle_gen_free(&metadata);
-                    return ERROR;
-                }
-
-                /* Quantize the angles by converting from radians to degrees 
-                   and scaling by a factor of 100 so it can be stored in the
-                   short integer image */
-                if (sat_azimuth)
-                    sat_azimuth[band_index][index] = (short) round (r2d *
-                        sat_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
-                if (sat_zenith)
-                    sat_zenith[band_index][index] = (short) round (r2d *
-                        sat_angles[IAS_ANGLE_GEN_ZENITH_INDEX]);
-                if (solar_azimuth)
-                    solar_azimuth[band_index][index] = (short) round (r2d *
-                        sun_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
-                if (solar_zenith)
-                    solar_zenith[band_index][index] = (short) round (r2d *
-                        sun_angles[IAS_ANGLE_GEN_ZENITH_INDEX]);
-            }  /* for samp */
-        }  /* for line */
-
-        /* update status */
-        printf ("100%%\n");
-        fflush (stdout);
-
-        /* Free the lookup table */
-        free(trim_lut);
-        trim_lut = NULL;
+        /* Report the progress and check for cancellation.  This is only done
+           once the band is complete, since the lines may be processed by
+           several threads. */
+        if (espa_progress_update("l8_per_pixel_angles_grid",
+            (band_index + 1.0) / IAS_MAX_NBANDS) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Generating the angles after band %d",
+                band_number);
+            free_trim_luts(band_trim_lut);
+            ias_angle_gen_free(&metadata);
+            return ERROR;
+        }
+        ESPA_PROBE3(angle__band__done, band_number, num_lines, num_samps);
     }  /* for band */
 
-    /* Release the metadata */
+    /* Release the lookup tables and metadata */
+    free_trim_luts(band_trim_lut);
     ias_angle_gen_free(&metadata);
 
     return SUCCESS;
@@ -409,478 +578,2584 @@ int l8_per_pixel_angles
 
 
 /**************************************************************************
-NAME: l8_per_pixel_avg_refl_angles
+NAME: l8_per_pixel_angles_lines
 
 PURPOSE:   Uses the coefficients in the angle coefficients file to generate
 the satellite viewing angle and/or solar angle values, for the specified
-list of bands.  The average of the reflective bands will be calculated, on a
-per-pixel basis, and returned.
+list of bands, and passes them to the line sink a block of lines at a time
+instead of returning whole bands.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
 ERROR           An error occurred generating the per-pixel solar and/or
-                view angles
+                view angles, or the line sink returned an error
 SUCCESS         Angle band generation was successful
 
 NOTES:
-  1. The band pointers for solar zenith/azimuth and satellite zenith/azimuth
-     averages will have space allocated for the entire band
-     (nlines * nsamps * sizeof (short)), unless NULL is passed in for the
-     address.
-  2. If any of the above pointers are NULL, then those per-pixel angles will
-     not be calculated.
-  3. It will be up to the calling routine to delete the memory allocated
-     for this reflectance band average angle array.
-  4. The angles that are returned are in degrees and have been scaled by 100.
+  1. The angles are the same as those of l8_per_pixel_angles_grid.  Both the
+     zenith and azimuth angles are generated for the angle type; the other
+     angle pointers passed to the sink are NULL.
+  2. The frame, nlines and nsamps of all the bands are set before the sink is
+     first called.  Bands that aren't processed or aren't present in the
+     metadata are never passed to the sink.
+  3. The blocks of all the bands are generated in turn, block by block, so
+     the angles shared between bands only need to be held for one block.
+     Each band's blocks are passed to the sink in order, so the sink can
+     write them directly to the band files.  Only one block of each band is
+     in memory at a time.
+  4. Each block is L8_ANGLE_BLOCK_LINES lines, or enough whole rows of grid
+     cells to give the threads a row apiece.  The last block of a band may be
+     shorter or (with an angle grid) one line longer.  With a memory budget
+     (see espa_memory.h), the blocks are shrunk to fit the blocks of all the
+     bands in it, and the number of threads is cut to the rows (or lines) in
+     a block.  The sink's own buffers aren't included.
+  5. The angle lines passed to the sink are only valid until the sink returns.
+  6. With a DEM, the angles of each pixel are evaluated at its terrain height
+     (see l8_angles_open_dem) instead of at zero height.  The DEM tiles are
+     cached across the bands, since they're generated block by block.
+  7. The progress is reported (see espa_progress.h) before each block, and
+     ERROR is returned if the job was cancelled.
 ***************************************************************************/
-int l8_per_pixel_avg_refl_angles
+int l8_per_pixel_angles_lines
 (
-    char *angle_coeff_name,   /* I: Angle coefficient filename */
-    int subsamp_fact,         /* I: Subsample factor used when calculating the
-                                    angles (1=full resolution). OW take every
-                                    Nth sample from the line, where
-                                    N=subsamp_fact */
-    short fill_pix_value,     /* I: Fill pixel value to use (-32768:32767) */
-    ANGLES_FRAME *avg_frame,  /* O: Image frame info for the scene */
-    short **avg_solar_zenith, /* O: Addr of pointer for the average solar zenith
-                                    angle array (if NULL, don't process),
-                                    degrees scaled by 100 */
-    short **avg_solar_azimuth,/* O: Addr of pointer for the average solar
-                                    azimuth angle array (if NULL, don't
-                                    process), degrees scaled by 100 */
-    short **avg_sat_zenith,   /* O: Addr of pointer for the average satellite
-                                    zenith angle array (if NULL, don't process),
-                                    degrees scaled by 100 */
-    short **avg_sat_azimuth,  /* O: Addr of pointer for the average satellite
-                                    azimuth angle array (if NULL, don't
-                                    process), degrees scaled by 100 */
-    int *avg_nlines,          /* O: Number of lines for the bands, based on
-                                    on the subsample factor */
-    int *avg_nsamps           /* O: Number of samples for the bands, based on
-                                    the subsample factor */
+    char *angle_coeff_name, /* I: Angle coefficient filename */
+    int subsamp_fact,       /* I: Subsample factor used when calculating the
+                                  angles (1=full resolution). OW take every Nth
+                                  sample from the line, where N=subsamp_fact */
+    short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
+    char *band_list,        /* I: Band list used to calculate angles for.
+                                  "ALL" - defaults to all satellite bands.
+                                  Must be comma separated with no spaces in
+                                  between.  Example: 1,2,3,4,5,6,7,8,9 */
+    int grid_spacing,       /* I: Spacing, in output pixels, of the grid where
+                                  the angles are evaluated exactly and then
+                                  interpolated between (1=evaluate every
+                                  pixel exactly) */
+    double max_grid_error,  /* I: Maximum interpolation error at the center of
+                                  a grid cell (degrees); cells over this are
+                                  evaluated exactly */
+    int verify_grid_flag,   /* I: If set, also evaluate the interpolated pixels
+                                  exactly and report the maximum error */
+    int nthreads,           /* I: Number of threads to use for generating the
+                                  angle lines (only used if built with
+                                  threading enabled) */
+    int share_band_flag,    /* I: If set, share the solar angles within each
+                                  resolution group and the satellite angles
+                                  between bands with identical geometry */
+    ANGLE_TYPE angle_type,  /* I: Angles to generate (solar, satellite or
+                                  both) */
+    const char *dem_filename, /* I: DEM giving the height of each pixel, or
+                                  NULL to use zero height */
+    L8_ANGLES_LINE_SINK sink, /* I: Routine receiving the angle lines */
+    void *sink_data,        /* I/O: Data passed through to the sink */
+    ANGLES_FRAME frame[L8_NBANDS], /* O: Image frame info for each band */
+    int nlines[L8_NBANDS],  /* O: Number of lines for each band, based on the
+                                  subsample factor */
+    int nsamps[L8_NBANDS]   /* O: Number of samples for each band, based on the
+                                  subsample factor */
 )
 {
-    int band_index;                   /* band index */
-    int sub_sample;                   /* subsampling factor */
-    int line;                         /* line index */
-    int samp;                         /* sample index */
-    int index;                        /* current sample index */
-    int angle_size;                   /* memory alloc angle size */
-    ushort *pix_count = NULL;         /* array to carry the count of the
-                                         non-zero pixels used for the sum */
-    long *sum = NULL;                 /* array to carry the sum of the angles
-                                         for all the bands */
-    ANGLES_FRAME frame[L8_NBANDS];    /* image frame info for each band */
-    short *solar_zenith[L8_NBANDS];   /* array of pointers for the solar zenith
-                                         angle array, one per reflectance band.
-                                         Degrees scaled by 100 */
-    short *solar_azimuth[L8_NBANDS];  /* array of pointers for the solar
-                                         azimuth angle array, one per
-                                         reflectance band. Degrees scaled by
-                                         100 */
-    short *sat_zenith[L8_NBANDS];     /* array of pointers for the satellite
-                                         zenith angle array, one per
-                                         reflectance band. Degrees scaled by
-                                         100 */
-    short *sat_azimuth[L8_NBANDS];    /* array of pointers for the satellite
-                                         azimuth angle array, one per
-                                         reflectance band. Degrees scaled by
-                                         100 */
-    char refl_band_list[] = "1,2,3,4,5,6,7,9"; /* list of reflectance bands to
-                                         be used in the average */
-    bool process_band[L8_NBANDS] = {true, true, true, true, true, true, true,
-        false /* pan */, true, false /* band 10 */, false /* band 11 */};
-                                         /* which bands will be processed as
-                                            the average of reflectance bands */
-    int nlines[L8_NBANDS];  /* number of lines for each band, based on the
-                               subsample factor */
-    int nsamps[L8_NBANDS];  /* number of samples for each band, based on the
-                               subsample factor */
-
-    /* Create the Landsat 8 angle bands for the reflectance bands.  Create a
-       sub_sample product with a fill value of -9999 to match the Landsat 8
-       image data.  This call also allocates memory for the solar angles and
-       satellite/view angles for the reflectance band list. */
-    sub_sample = subsamp_fact;
-    if (l8_per_pixel_angles (angle_coeff_name, sub_sample, -9999,
-        refl_band_list, frame, solar_zenith, solar_azimuth, sat_zenith,
-        sat_azimuth, nlines, nsamps) != SUCCESS)
-    {  /* Error messages already written */
-        IAS_LOG_ERROR("Creating the per-pixel angles for the reflective bands");
+    int band_index;                   /* Band index */
+    int other_index;                  /* Earlier band index */
+    int band_number;                  /* Band number */
+    int ang;                          /* Angle index */
+    int block;                        /* Block index */
+    int max_blocks = 0;               /* Number of blocks in the largest band */
+    int unit_lines;                   /* Lines in a row of grid cells, or 1
+                                         when every pixel is evaluated */
+    int block_units;                  /* Rows of grid cells (or lines) in a
+                                         block */
+    int num_units[L8_NBANDS];         /* Rows of grid cells (or lines) in each
+                                         band */
+    int num_blocks[L8_NBANDS] = {0};  /* Blocks in each band, 0 if the band
+                                         isn't processed */
+    int solar_source[L8_NBANDS];      /* Band the solar angles are shared
+                                         from, -1 if not shared */
+    int sat_source[L8_NBANDS];        /* Band the satellite angles are shared
+                                         from, -1 if not shared */
+    ANGLE_TYPE band_type[L8_NBANDS];  /* Angles generated for each band
+                                         (AT_UNKNOWN if all are shared) */
+    int num_cells[L8_NBANDS] = {0};   /* Grid cells in each band */
+    int num_interp_cells[L8_NBANDS] = {0}; /* Interpolated grid cells in each
+                                         band */
+    int max_error[L8_NBANDS] = {0};   /* Largest verified error in each band
+                                         (degrees * 100) */
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS] = {NULL};  /* Image trim lookup
+                                         table for each band */
+    short *gen_block[NUM_ANGLES][L8_NBANDS] = {{NULL}};  /* Block of lines of
+                                         each angle generated for each band
+                                         (NULL if not generated) */
+    short *band_block[NUM_ANGLES][L8_NBANDS] = {{NULL}}; /* Block of lines of
+                                         each angle for each band.  Bands
+                                         sharing their angles point to the
+                                         block of the band they share from. */
+    L8_ANGLES_PARAMETERS parameters;  /* Parameters read in from file */
+    IAS_ANGLE_GEN_METADATA metadata;  /* Angle metadata structure */
+    ESPA_PROFILE_SCOPE("l8_per_pixel_angles_lines");
+
+    /* Make sure there is something to process */
+    if (angle_type == AT_UNKNOWN || sink == NULL)
+    {
+        IAS_LOG_ERROR("No angle type or line sink specified. Nothing to "
+            "process.");
         return ERROR;
     }
 
-    /* Allocate memory for the angle bands.  Just use the first band (band 1)
-       for the size of the band. */
-    angle_size = nlines[0] * nsamps[0];
-    if (avg_solar_zenith != NULL)
-    {
-        *avg_solar_zenith = calloc (angle_size, sizeof (short));
-        if (*avg_solar_zenith == NULL)
-        {
-            IAS_LOG_ERROR("Allocating average solar zenith angle array");
-            return ERROR;
-        }
+    /* Set up the parameters and read the metadata file */
+    if (init_angle_generation(angle_coeff_name, subsamp_fact, fill_pix_value,
+        band_list, grid_spacing, max_grid_error, verify_grid_flag, nthreads,
+        share_band_flag, dem_filename, &parameters, &metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return ERROR;
     }
 
-    if (avg_solar_azimuth != NULL)
+    /* Determine the size of the blocks */
+    unit_lines = parameters.grid_spacing;
+    block_units = L8_ANGLE_BLOCK_LINES / unit_lines;
+    if (block_units < parameters.nthreads)
+        block_units = parameters.nthreads;
+    if (block_units < 1)
+        block_units = 1;
+    if (espa_memory_budget() > 0)
     {
-        *avg_solar_azimuth = calloc (angle_size, sizeof (short));
-        if (*avg_solar_azimuth == NULL)
-        {
-            IAS_LOG_ERROR("Allocating average solar azimuth angle array");
-            return ERROR;
-        }
+        block_units = espa_budget_lines((size_t) unit_lines
+            * get_angle_line_bytes(&metadata, &parameters), 0, block_units);
+        if (parameters.nthreads > block_units)
+            parameters.nthreads = block_units;
     }
 
-    if (avg_sat_zenith != NULL)
+    /* Set up the frames, block buffers and trim lookup tables of the bands */
+    for (band_index = 0; band_index < L8_NBANDS; band_index++)
     {
-        *avg_sat_zenith = calloc (angle_size, sizeof (short));
-        if (*avg_sat_zenith == NULL)
+        size_t block_size;          /* Size of a block of angles (bytes) */
+        int block_lines;            /* Most lines in a block of this band */
+
+        band_type[band_index] = AT_UNKNOWN;
+        solar_source[band_index] = -1;
+        sat_source[band_index] = -1;
+        if (!parameters.process_band[band_index])
+            continue;
+
+        band_number = ias_sat_attr_convert_band_index_to_number(band_index);
+        if (band_number == ERROR)
         {
-            IAS_LOG_ERROR("Allocating average satellite zenith angle array");
+            IAS_LOG_ERROR("Getting band number for band index %d", band_index);
+            l8_angles_close_dem(parameters.dem);
+            free_angle_buffers(&metadata, trim_lut, band_block, NULL, NULL,
+                NULL);
             return ERROR;
         }
-    }
 
-    if (avg_sat_azimuth != NULL)
-    {
-        *avg_sat_azimuth = calloc (angle_size, sizeof (short));
-        if (*avg_sat_azimuth == NULL)
+        /* If the band isn't present in the metadata, skip it */
+        if (get_frame(&metadata, band_index, &frame[band_index]) != SUCCESS)
         {
-            IAS_LOG_ERROR("Allocating average satellite azimuth angle array");
-            return ERROR;
+            IAS_LOG_WARNING("Band not present in metadata for band number %d",
+                band_number);
+            continue;
         }
-    }
 
-    /* Allocate memory to hold the sum of the angles from all the bands.
-       Just use the first band (band 1) for the size of the band.  Also keep
-       an array for counting the non-zero pixels in the sum which will be used
-       to compute the average. */
-    angle_size = nlines[0] * nsamps[0];
-    sum = calloc (angle_size, sizeof (long));
-    if (sum == NULL)
-    {
-        IAS_LOG_ERROR("Allocating array for holding the sum of the bands");
-        return ERROR;
-    }
+        /* Calculate size of subsampled output image and its blocks */
+        nlines[band_index] = (frame[band_index].num_lines - 1)
+            / parameters.sub_sample_factor + 1;
+        nsamps[band_index] = (frame[band_index].num_samps - 1)
+            / parameters.sub_sample_factor + 1;
+        if (unit_lines > 1)
+            num_units[band_index] = get_grid_rows(nlines[band_index],
+                unit_lines);
+        else
+            num_units[band_index] = nlines[band_index];
+        num_blocks[band_index] = (num_units[band_index] + block_units - 1)
+            / block_units;
+        if (num_blocks[band_index] > max_blocks)
+            max_blocks = num_blocks[band_index];
+        block_lines = block_units * unit_lines + 1;
+        if (block_lines > nlines[band_index])
+            block_lines = nlines[band_index];
+        block_size = (size_t) block_lines * nsamps[band_index]
+            * sizeof(short);
+        IAS_LOG_INFO("Processing band number %d using %d as subsampling "
+            "factor", band_number, parameters.sub_sample_factor);
 
-    pix_count = calloc (angle_size, sizeof (ushort));
-    if (pix_count == NULL)
-    {
-        IAS_LOG_ERROR("Allocating array for holding the pixel count");
-        return ERROR;
-    }
+        /* Look for earlier bands to share the angles from */
+        if (parameters.share_band_flag)
+        {
+            for (other_index = 0; other_index < band_index; other_index++)
+            {
+                if (num_blocks[other_index] == 0)
+                    continue;
+
+                if (solar_source[band_index] < 0 && same_band_resolution(
+                    &metadata, band_index, other_index))
+                {
+                    solar_source[band_index] = other_index;
+                }
+                if (sat_source[band_index] < 0 && same_satellite_angles(
+                    &metadata, band_index, other_index))
+                {
+                    sat_source[band_index] = other_index;
+                }
+            }
+        }
+        if (solar_source[band_index] >= 0 && angle_type != AT_SATELLITE)
+        {
+            IAS_LOG_INFO("Sharing the solar angles of band number %d",
+                frame[solar_source[band_index]].band_number);
+        }
+        if (sat_source[band_index] >= 0 && angle_type != AT_SOLAR)
+        {
+            IAS_LOG_INFO("Sharing the satellite angles of band number %d",
+                frame[sat_source[band_index]].band_number);
+        }
+
+        /* Allocate the blocks of the angles generated for this band, and
+           point the shared ones at the band they're shared from */
+        for (ang = 0; ang < NUM_ANGLES; ang++)
+        {
+            int solar = (ang == ANG_SOLAR_ZENITH || ang == ANG_SOLAR_AZIMUTH);
+            int source = solar ? solar_source[band_index]
+                               : sat_source[band_index];
+
+            if ((solar && angle_type == AT_SATELLITE)
+                || (!solar && angle_type == AT_SOLAR))
+            {
+                continue;
+            }
+
+            if (source >= 0)
+            {
+                band_block[ang][band_index] = band_block[ang][source];
+                continue;
+            }
+
+            gen_block[ang][band_index] = espa_alloc_large(block_size);
+            if (gen_block[ang][band_index] == NULL)
+            {
+                IAS_LOG_ERROR("Allocating the angle block for band number %d",
+                    band_number);
+                l8_angles_close_dem(parameters.dem);
+                free_angle_buffers(&metadata, trim_lut, band_block, NULL,
+                    NULL, NULL);
+                return ERROR;
+            }
+            band_block[ang][band_index] = gen_block[ang][band_index];
+
+            if (solar)
+                band_type[band_index] = (band_type[band_index] == AT_SATELLITE)
+                    ? AT_BOTH : AT_SOLAR;
+            else
+                band_type[band_index] = (band_type[band_index] == AT_SOLAR)
+                    ? AT_BOTH : AT_SATELLITE;
+        }
+
+        /* Retrieve the trim look up table to remove the scene crenulation,
+           if any angles are generated for this band */
+        if (band_type[band_index] == AT_UNKNOWN)
+            continue;
+        if (get_trim_lut(&metadata, band_index, &frame[band_index],
+            trim_lut) == NULL)
+        {
+            IAS_LOG_ERROR("Creating the scene trim lookup table for band "
+                "number %d", band_number);
+            l8_angles_close_dem(parameters.dem);
+            free_angle_buffers(&metadata, trim_lut, band_block, NULL, NULL,
+                NULL);
+            return ERROR;
+        }
+    }
+
+    /* Generate the bands a block at a time.  Bands sharing angles are the
+       same size, so the block they share from was just generated. */
+    for (block = 0; block < max_blocks; block++)
+    {
+        /* Report the progress and check for cancellation */
+        if (espa_progress_update("l8_per_pixel_angles_lines",
+            (double) block / max_blocks) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Generating the angles at block %d of %d", block,
+                max_blocks);
+            l8_angles_close_dem(parameters.dem);
+            free_angle_buffers(&metadata, trim_lut, band_block, NULL, NULL,
+                NULL);
+            return ERROR;
+        }
+
+        for (band_index = 0; band_index < L8_NBANDS; band_index++)
+        {
+            int first_unit;         /* First row (or line) of the block */
+            int end_unit;           /* Row (or line) after the block */
+            int first_line;         /* First output line of the block */
+            int end_line;           /* Output line after the block */
+            int status;             /* Status of the generation */
+
+            if (block >= num_blocks[band_index])
+                continue;
+
+            first_unit = block * block_units;
+            end_unit = first_unit + block_units;
+            if (end_unit > num_units[band_index])
+                end_unit = num_units[band_index];
+            first_line = first_unit * unit_lines;
+            end_line = (end_unit == num_units[band_index])
+                ? nlines[band_index] : end_unit * unit_lines;
+
+            if (band_type[band_index] != AT_UNKNOWN)
+            {
+                /* Generate the angles, filling the pixels outside the
+                   scene as they're reached */
+                parameters.angle_type = band_type[band_index];
+                if (unit_lines > 1)
+                {
+                    status = grid_block_angles(&metadata, &parameters,
+                        band_index, trim_lut[band_index], nlines[band_index],
+                        nsamps[band_index], first_unit, end_unit, first_line,
+                        gen_block[ANG_SAT_ZENITH][band_index],
+                        gen_block[ANG_SAT_AZIMUTH][band_index],
+                        gen_block[ANG_SOLAR_ZENITH][band_index],
+                        gen_block[ANG_SOLAR_AZIMUTH][band_index],
+                        &num_cells[band_index], &num_interp_cells[band_index],
+                        &max_error[band_index]);
+                }
+                else
+                {
+                    status = exact_block_angles(&metadata, &parameters,
+                        band_index, trim_lut[band_index], nsamps[band_index],
+                        first_line, end_line, first_line,
+                        gen_block[ANG_SAT_ZENITH][band_index],
+                        gen_block[ANG_SAT_AZIMUTH][band_index],
+                        gen_block[ANG_SOLAR_ZENITH][band_index],
+                        gen_block[ANG_SOLAR_AZIMUTH][band_index]);
+                }
+                if (status != SUCCESS)
+                {
+                    IAS_LOG_ERROR("Evaluating angles in band %d, lines %d "
+                        "to %d", frame[band_index].band_number, first_line,
+                        end_line - 1);
+                    l8_angles_close_dem(parameters.dem);
+                    free_angle_buffers(&metadata, trim_lut, band_block, NULL,
+                        NULL, NULL);
+                    return ERROR;
+                }
+            }
+
+            /* Pass the block to the sink */
+            if ((*sink)(sink_data, band_index, nlines[band_index], first_line,
+                end_line - first_line, nsamps[band_index],
+                band_block[ANG_SOLAR_ZENITH][band_index],
+                band_block[ANG_SOLAR_AZIMUTH][band_index],
+                band_block[ANG_SAT_ZENITH][band_index],
+                band_block[ANG_SAT_AZIMUTH][band_index]) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Passing lines %d to %d of band %d to the line "
+                    "sink", first_line, end_line - 1,
+                    frame[band_index].band_number);
+                l8_angles_close_dem(parameters.dem);
+                free_angle_buffers(&metadata, trim_lut, band_block, NULL,
+                    NULL, NULL);
+                return ERROR;
+            }
+
+            if (block == num_blocks[band_index] - 1)
+            {
+                if (unit_lines > 1 && band_type[band_index] != AT_UNKNOWN)
+                {
+                    log_grid_stats(&parameters, num_cells[band_index],
+                        num_interp_cells[band_index], max_error[band_index]);
+                }
+                ESPA_PROBE3(angle__band__done, frame[band_index].band_number,
+                    nlines[band_index], nsamps[band_index]);
+            }
+        }  /* for band_index */
+    }  /* for block */
+
+    /* Release the DEM, blocks, lookup tables and metadata */
+    l8_angles_close_dem(parameters.dem);
+    free_angle_buffers(&metadata, trim_lut, band_block, NULL, NULL, NULL);
+
+    return SUCCESS;
+}
+
+
+/**************************************************************************
+NAME: l8_per_pixel_avg_refl_angles
+
+PURPOSE:   Uses the coefficients in the angle coefficients file to generate
+the satellite viewing angle and/or solar angle values, for the specified
+list of bands.  The average of the reflective bands will be calculated, on a
+per-pixel basis, and returned.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred generating the per-pixel solar and/or
+                view angles
+SUCCESS         Angle band generation was successful
+
+NOTES:
+  1. The band pointers for solar zenith/azimuth and satellite zenith/azimuth
+     averages will have space allocated for the entire band
+     (nlines * nsamps * sizeof (short)), unless NULL is passed in for the
+     address.
+  2. If any of the above pointers are NULL, then those per-pixel angles will
+     not be calculated.
+  3. It will be up to the calling routine to release the memory allocated
+     for this reflectance band average angle array, with espa_free_large.
+  4. The angles that are returned are in degrees and have been scaled by 100.
+  5. The average is computed in a single pass over the lines.  For each line
+     the angles of all the reflectance bands are generated into line buffers
+     and summed, and the averaged line is stored as soon as it is complete,
+     so the full resolution angle bands are never held in memory.
+  6. The reflectance bands must all be the same size as the first one (band
+     1).  Pixels where every band has a zero angle are averaged to zero.
+  7. The progress is reported (see espa_progress.h) every
+     L8_ANGLE_BLOCK_LINES lines, and ERROR is returned if the job was
+     cancelled.
+***************************************************************************/
+int l8_per_pixel_avg_refl_angles
+(
+    char *angle_coeff_name,   /* I: Angle coefficient filename */
+    int subsamp_fact,         /* I: Subsample factor used when calculating the
+                                    angles (1=full resolution). OW take every
+                                    Nth sample from the line, where
+                                    N=subsamp_fact */
+    short fill_pix_value,     /* I: Fill pixel value to use (-32768:32767) */
+    int share_band_flag,      /* I: If set, share the angles between the
+                                    reflectance bands (see
+                                    l8_per_pixel_angles_grid) */
+    ANGLES_FRAME *avg_frame,  /* O: Image frame info for the scene */
+    short **avg_solar_zenith, /* O: Addr of pointer for the average solar zenith
+                                    angle array (if NULL, don't process),
+                                    degrees scaled by 100 */
+    short **avg_solar_azimuth,/* O: Addr of pointer for the average solar
+                                    azimuth angle array (if NULL, don't
+                                    process), degrees scaled by 100 */
+    short **avg_sat_zenith,   /* O: Addr of pointer for the average satellite
+                                    zenith angle array (if NULL, don't process),
+                                    degrees scaled by 100 */
+    short **avg_sat_azimuth,  /* O: Addr of pointer for the average satellite
+                                    azimuth angle array (if NULL, don't
+                                    process), degrees scaled by 100 */
+    int *avg_nlines,          /* O: Number of lines for the bands, based on
+                                    on the subsample factor */
+    int *avg_nsamps           /* O: Number of samples for the bands, based on
+                                    the subsample factor */
+)
+{
+    int band_index;                   /* band index */
+    int other_index;                  /* earlier band index */
+    int band_number;                  /* band number */
+    int ang;                          /* angle index */
+    int out_line;                     /* output line index */
+    int out_samp;                     /* output sample index */
+    int line;                         /* L1T line index */
+    int sub_sample;                   /* subsampling factor */
+    int num_lines = 0;                /* number of lines in the average */
+    int num_samps = 0;                /* number of samples in the average */
+    size_t line_size = 0;             /* size of an angle line (bytes) */
+    bool have_band = false;           /* has the first band been set up? */
+    IAS_SPECTRAL_TYPE spectral_type;  /* spectral type of the current band */
+    ushort *pix_count = NULL;         /* count of the non-zero pixels used in
+                                         the sum, for each angle of the
+                                         current line */
+    long *sum = NULL;                 /* sum of the angles of all the bands,
+                                         for each angle of the current line */
+    L8_ANGLES_PARAMETERS parameters;  /* parameters for the angle generation */
+    IAS_ANGLE_GEN_METADATA metadata;  /* angle metadata structure */
+    ANGLES_FRAME frame[L8_NBANDS];    /* image frame info for each band */
+    ANGLE_TYPE angle_type[L8_NBANDS]; /* angles generated for each band
+                                         (AT_UNKNOWN if all are shared) */
+    int solar_source[L8_NBANDS];      /* band the solar angles are shared
+                                         from, -1 if not shared */
+    int sat_source[L8_NBANDS];        /* band the satellite angles are shared
+                                         from, -1 if not shared */
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS] = {NULL};  /* image trim lookup
+                                         table for each band */
+    short *band_line[NUM_ANGLES][L8_NBANDS] = {{NULL}};  /* current line of
+                                         each angle for each band.  Bands
+                                         sharing their angles point to the
+                                         same line, which is still added to
+                                         the sum for each band. */
+    short **avg_angles[NUM_ANGLES];  /* addresses of the average angle
+                                         arrays, in the angle index order */
+
+    /* Angle index order is solar zenith, solar azimuth, satellite zenith,
+       satellite azimuth */
+    avg_angles[ANG_SOLAR_ZENITH] = avg_solar_zenith;
+    avg_angles[ANG_SOLAR_AZIMUTH] = avg_solar_azimuth;
+    avg_angles[ANG_SAT_ZENITH] = avg_sat_zenith;
+    avg_angles[ANG_SAT_AZIMUTH] = avg_sat_azimuth;
+    for (ang = 0; ang < NUM_ANGLES; ang++)
+    {
+        if (avg_angles[ang] != NULL)
+            *avg_angles[ang] = NULL;
+    }
+
+    /* Set up the parameters for all the bands and read the metadata file;
+       the bands other than the reflectance bands are dropped below.  Use a
+       fill value of -9999 to match the Landsat image data.  Every pixel is
+       evaluated exactly. */
+    if (init_angle_generation(angle_coeff_name, subsamp_fact, -9999,
+        "ALL", 1, 0.0, 0, 1, share_band_flag, NULL, &parameters,
+        &metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return ERROR;
+    }
+    sub_sample = parameters.sub_sample_factor;
+
+    /* Set up the line buffers and trim lookup tables for each reflectance
+       band */
+    for (band_index = 0; band_index < L8_NBANDS; band_index++)
+    {
+        angle_type[band_index] = AT_UNKNOWN;
+        solar_source[band_index] = -1;
+        sat_source[band_index] = -1;
+        if (!parameters.process_band[band_index])
+            continue;
+
+        band_number = ias_sat_attr_convert_band_index_to_number(band_index);
+        if (band_number == ERROR)
+        {
+            IAS_LOG_ERROR("Getting band number for band index %d", band_index);
+            free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                pix_count, avg_angles);
+            return ERROR;
+        }
+
+        /* Only the reflectance bands are part of the average, which leaves
+           out the pan and thermal bands */
+        spectral_type = ias_sat_attr_get_spectral_type_from_band_number(
+            band_number);
+        if (spectral_type != IAS_SPECTRAL_VNIR
+            && spectral_type != IAS_SPECTRAL_SWIR)
+        {
+            parameters.process_band[band_index] = 0;
+            continue;
+        }
+
+        /* Bands not present in the metadata aren't part of the average */
+        if (get_frame(&metadata, band_index, &frame[band_index]) != SUCCESS)
+        {
+            IAS_LOG_WARNING("Band not present in metadata for band number %d",
+                band_number);
+            parameters.process_band[band_index] = 0;
+            continue;
+        }
+
+        /* The average is the size of the first band, and the other bands
+           need to match it */
+        if (!have_band)
+        {
+            num_lines = (frame[band_index].num_lines - 1) / sub_sample + 1;
+            num_samps = (frame[band_index].num_samps - 1) / sub_sample + 1;
+            line_size = num_samps * sizeof(short);
+            *avg_frame = frame[band_index];
+            have_band = true;
+        }
+        else if ((frame[band_index].num_lines - 1) / sub_sample + 1 !=
+            num_lines || (frame[band_index].num_samps - 1) / sub_sample + 1 !=
+            num_samps)
+        {
+            IAS_LOG_ERROR("Band number %d is not the same size as the other "
+                "reflectance bands", band_number);
+            free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                pix_count, avg_angles);
+            return ERROR;
+        }
+
+        /* Look for earlier bands to share the angles from */
+        if (share_band_flag)
+        {
+            for (other_index = 0; other_index < band_index; other_index++)
+            {
+                if (!parameters.process_band[other_index])
+                    continue;
+
+                if (solar_source[band_index] < 0 &&
+                    same_band_resolution(&metadata, band_index, other_index))
+                {
+                    solar_source[band_index] = other_index;
+                }
+                if (sat_source[band_index] < 0 &&
+                    same_satellite_angles(&metadata, band_index, other_index))
+                {
+                    sat_source[band_index] = other_index;
+                }
+            }
+        }
+
+        /* Allocate the line buffers for the angles that are generated for
+           this band, and point the shared ones at the band they're shared
+           from */
+        for (ang = 0; ang < NUM_ANGLES; ang++)
+        {
+            int source;             /* band these angles are shared from */
+
+            if (avg_angles[ang] == NULL)
+                continue;
+
+            if (ang == ANG_SOLAR_ZENITH || ang == ANG_SOLAR_AZIMUTH)
+                source = solar_source[band_index];
+            else
+                source = sat_source[band_index];
+
+            if (source >= 0)
+            {
+                band_line[ang][band_index] = band_line[ang][source];
+                continue;
+            }
+
+            band_line[ang][band_index] = espa_alloc_large(line_size);
+            if (band_line[ang][band_index] == NULL)
+            {
+                IAS_LOG_ERROR("Allocating the angle line buffer for band "
+                    "number %d", band_number);
+                free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                    pix_count, avg_angles);
+                return ERROR;
+            }
+
+            if (ang == ANG_SOLAR_ZENITH || ang == ANG_SOLAR_AZIMUTH)
+            {
+                if (angle_type[band_index] == AT_SATELLITE)
+                    angle_type[band_index] = AT_BOTH;
+                else if (angle_type[band_index] == AT_UNKNOWN)
+                    angle_type[band_index] = AT_SOLAR;
+            }
+            else
+            {
+                if (angle_type[band_index] == AT_SOLAR)
+                    angle_type[band_index] = AT_BOTH;
+                else if (angle_type[band_index] == AT_UNKNOWN)
+                    angle_type[band_index] = AT_SATELLITE;
+            }
+        }
+
+        /* Only bands generating their own angles need the trim lookup
+           table to remove the scene crenulation */
+        if (angle_type[band_index] == AT_UNKNOWN)
+            continue;
+        if (get_trim_lut(&metadata, band_index, &frame[band_index],
+            trim_lut) == NULL)
+        {
+            IAS_LOG_ERROR("Creating the scene trim lookup table for band "
+                "number %d", band_number);
+            free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                pix_count, avg_angles);
+            return ERROR;
+        }
+    }
+
+    if (!have_band)
+    {
+        IAS_LOG_ERROR("None of the reflectance bands are present in the "
+            "metadata");
+        free_angle_buffers(&metadata, trim_lut, band_line, sum, pix_count,
+            avg_angles);
+        return ERROR;
+    }
+
+    /* Allocate memory for the average angle bands */
+    for (ang = 0; ang < NUM_ANGLES; ang++)
+    {
+        if (avg_angles[ang] == NULL)
+            continue;
+
+        *avg_angles[ang] = espa_alloc_large((size_t) num_lines * line_size);
+        if (*avg_angles[ang] == NULL)
+        {
+            IAS_LOG_ERROR("Allocating average angle array");
+            free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                pix_count, avg_angles);
+            return ERROR;
+        }
+    }
+
+    /* Allocate memory to hold the sum of the angles from all the bands for
+       one line, and a count of the non-zero pixels in the sum which will be
+       used to compute the average */
+    sum = malloc(NUM_ANGLES * num_samps * sizeof(long));
+    pix_count = malloc(NUM_ANGLES * num_samps * sizeof(ushort));
+    if (sum == NULL || pix_count == NULL)
+    {
+        IAS_LOG_ERROR("Allocating arrays for holding the sum of the bands");
+        free_angle_buffers(&metadata, trim_lut, band_line, sum, pix_count,
+            avg_angles);
+        return ERROR;
+    }
+
+    /* Loop through the lines, generating the angles of all the bands for the
+       line and averaging them */
+    printf ("Computing average of the reflectance band angles ...\n");
+    for (out_line = 0; out_line < num_lines; out_line++)
+    {
+        /* Report the progress and check for cancellation once per block
+           of lines */
+        if (out_line % L8_ANGLE_BLOCK_LINES == 0 && espa_progress_update(
+            "l8_per_pixel_avg_refl_angles", (double) out_line / num_lines)
+            != SUCCESS)
+        {
+            IAS_LOG_ERROR("Averaging the angles at line %d", out_line);
+            free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                pix_count, avg_angles);
+            return ERROR;
+        }
+
+        line = out_line * sub_sample;
+        memset(sum, 0, NUM_ANGLES * num_samps * sizeof(long));
+        memset(pix_count, 0, NUM_ANGLES * num_samps * sizeof(ushort));
+
+        for (band_index = 0; band_index < L8_NBANDS; band_index++)
+        {
+            if (!parameters.process_band[band_index])
+                continue;
+
+            /* Generate the angles of this band that aren't shared */
+            if (angle_type[band_index] != AT_UNKNOWN)
+            {
+                /* Calculate the satellite and solar azimuth and zenith, with
+                   fill outside the actual range of image data in this
+                   scene */
+                if (exact_line_angles(&metadata, NULL, band_index,
+                    &trim_lut[band_index][line], line, num_samps, sub_sample,
+                    angle_type[band_index], parameters.background,
+                    (sat_source[band_index] < 0)
+                        ? band_line[ANG_SAT_ZENITH][band_index] : NULL,
+                    (sat_source[band_index] < 0)
+                        ? band_line[ANG_SAT_AZIMUTH][band_index] : NULL,
+                    (solar_source[band_index] < 0)
+                        ? band_line[ANG_SOLAR_ZENITH][band_index] : NULL,
+                    (solar_source[band_index] < 0)
+                        ? band_line[ANG_SOLAR_AZIMUTH][band_index] : NULL)
+                    != SUCCESS)
+                {
+                    IAS_LOG_ERROR("Evaluating angles in band %d at line %d",
+                        frame[band_index].band_number, line);
+                    free_angle_buffers(&metadata, trim_lut, band_line, sum,
+                        pix_count, avg_angles);
+                    return ERROR;
+                }
+            }
+
+            /* Add this band to the sums.  Skip values of 0 since they occur
+               on the scene edges and we don't want to count them. */
+            for (ang = 0; ang < NUM_ANGLES; ang++)
+            {
+                short *angle_line = band_line[ang][band_index];
+                long *angle_sum = &sum[ang * num_samps];
+                ushort *angle_count = &pix_count[ang * num_samps];
+
+                if (angle_line == NULL)
+                    continue;
+                for (out_samp = 0; out_samp < num_samps; out_samp++)
+                {
+                    if (angle_line[out_samp] != 0)
+                    {
+                        angle_sum[out_samp] += angle_line[out_samp];
+                        angle_count[out_samp]++;
+                    }
+                }
+            }
+        }  /* for band_index */
+
+        /* Store the average for this line */
+        for (ang = 0; ang < NUM_ANGLES; ang++)
+        {
+            short *avg_line;        /* current line of the average */
+
+            if (avg_angles[ang] == NULL)
+                continue;
+            avg_line = &(*avg_angles[ang])[(size_t) out_line * num_samps];
+            for (out_samp = 0; out_samp < num_samps; out_samp++)
+            {
+                int index = ang * num_samps + out_samp;
+                if (pix_count[index] == 0)
+                    avg_line[out_samp] = 0;
+                else
+                    avg_line[out_samp] = (short) (round ((float) sum[index] /
+                        pix_count[index]));
+            }
+        }
+    }  /* for out_line */
+
+    /* Free memory, keeping the average angle bands */
+    for (ang = 0; ang < NUM_ANGLES; ang++)
+        avg_angles[ang] = NULL;
+    free_angle_buffers(&metadata, trim_lut, band_line, sum, pix_count,
+        avg_angles);
+
+    *avg_nlines = num_lines;
+    *avg_nsamps = num_samps;
+
+    return SUCCESS;
+}
+
+
+/**************************************************************************
+NAME: free_angle_buffers
+
+PURPOSE:   Releases the metadata and working buffers used for streaming the
+angles of the bands, and the average angle arrays that were allocated.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Shared line buffers and trim lookup tables are only freed once.  Pass
+     NULL for the addresses of
+     the average angle arrays that should be kept, or for avg_angles if
+     there are none.
+***************************************************************************/
+static void free_angle_buffers
+(
+    IAS_ANGLE_GEN_METADATA *metadata,  /* I/O: Angle metadata structure */
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS], /* I/O: Trim lookup table for
+                                          each band (NULL if not created) */
+    short *band_line[NUM_ANGLES][L8_NBANDS],  /* I/O: Line buffers for each
+                                          angle of each band */
+    long *sum,                  /* I: Sums of the angles for the line (or
+                                      NULL) */
+    ushort *pix_count,          /* I: Pixel counts of the sums (or NULL) */
+    short **avg_angles[NUM_ANGLES]    /* I/O: Addresses of the average angle
+                                          arrays to free (NULL to keep) */
+)
+{
+    int ang;                /* Angle index */
+
+    free_trim_luts(trim_lut);
+
+    for (ang = 0; ang < NUM_ANGLES; ang++)
+    {
+        l8_free_per_pixel_angles(band_line[ang]);
+        if (avg_angles != NULL && avg_angles[ang] != NULL)
+        {
+            espa_free_large(*avg_angles[ang]);
+            *avg_angles[ang] = NULL;
+        }
+    }
+
+    free(sum);
+    free(pix_count);
+    ias_angle_gen_free(metadata);
+}
+
+
+/**************************************************************************
+NAME: get_trim_lut
+
+PURPOSE:   Returns the scene trim lookup table of a band, sharing the table
+of an earlier band with the same active image area or creating it if there
+is none.
+
+RETURN VALUE:
+Type = IAS_MISC_LINE_EXTENT *
+Value           Description
+-----           -----------
+non-NULL        Trim lookup table of the band, also set in trim_lut
+NULL            An error occurred creating the lookup table
+
+NOTES:
+  1. The bands of a resolution group usually have the same active image
+     area, so the table is only built once for each group.  Release the
+     tables with free_trim_luts.
+***************************************************************************/
+static IAS_MISC_LINE_EXTENT *get_trim_lut
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    int band_index,             /* I: Band index */
+    const ANGLES_FRAME *frame,  /* I: Image frame info of the band */
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS] /* I/O: Trim lookup table for
+                                      each band (NULL if not created) */
+)
+{
+    int other_index;            /* Earlier band index */
+
+    for (other_index = 0; other_index < band_index; other_index++)
+    {
+        if (trim_lut[other_index] != NULL
+            && same_active_area(metadata, band_index, other_index))
+        {
+            trim_lut[band_index] = trim_lut[other_index];
+            return trim_lut[band_index];
+        }
+    }
+
+    trim_lut[band_index] = ias_misc_create_output_image_trim_lut(
+        get_active_lines(metadata, band_index),
+        get_active_samples(metadata, band_index),
+        frame->num_lines, frame->num_samps);
+    return trim_lut[band_index];
+}
+
+
+/**************************************************************************
+NAME: free_trim_luts
+
+PURPOSE:   Releases the trim lookup tables of the bands, freeing the tables
+shared between bands only once.
+
+RETURN VALUE:
+Type = None
+***************************************************************************/
+static void free_trim_luts
+(
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS] /* I/O: Trim lookup table for
+                                      each band (NULL if not created).  Set
+                                      to NULL on return. */
+)
+{
+    int band_index;             /* Band index */
+    int other_index;            /* Later band index */
+
+    for (band_index = 0; band_index < L8_NBANDS; band_index++)
+    {
+        if (trim_lut[band_index] == NULL)
+            continue;
+
+        for (other_index = band_index + 1; other_index < L8_NBANDS;
+             other_index++)
+        {
+            if (trim_lut[other_index] == trim_lut[band_index])
+                trim_lut[other_index] = NULL;
+        }
+
+        free(trim_lut[band_index]);
+        trim_lut[band_index] = NULL;
+    }
+}
+
+
+/**************************************************************************
+NAME: l8_free_per_pixel_angles
+
+PURPOSE:   Releases the per band angle arrays allocated by
+l8_per_pixel_angles or l8_per_pixel_angles_grid.  Bands sharing their angles
+point to the same array, so each distinct array is only freed once.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The band pointers that weren't allocated must be NULL.
+  2. All the band pointers are set to NULL on return.
+  3. The arrays are allocated with espa_alloc_large, backed by huge pages
+     when they are large enough.
+***************************************************************************/
+void l8_free_per_pixel_angles
+(
+    short *angles[L8_NBANDS]  /* I/O: Array of pointers for the angle arrays,
+                                      one per band (NULL if not allocated).
+                                      Set to NULL on return. */
+)
+{
+    int band_index;         /* Band index */
+    int other_index;        /* Later band index */
+
+    if (angles == NULL)
+        return;
+
+    for (band_index = 0; band_index < L8_NBANDS; band_index++)
+    {
+        if (angles[band_index] == NULL)
+            continue;
+
+        /* Clear the later bands sharing this array */
+        for (other_index = band_index + 1; other_index < L8_NBANDS;
+             other_index++)
+        {
+            if (angles[other_index] == angles[band_index])
+                angles[other_index] = NULL;
+        }
+
+        espa_free_large(angles[band_index]);
+        angles[band_index] = NULL;
+    }
+}
+
+/******************************************************************************
+NAME: init_angle_generation
+
+PURPOSE: Initializes the IAS libraries, sets up the generation parameters and
+reads the angle coefficient file.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The parameters were set up and the metadata was read
+    ERROR     An error occurred setting up the parameters or reading the
+              metadata
+
+NOTES:
+  1. The caller is responsible for calling ias_angle_gen_free on the
+     metadata, and l8_angles_close_dem on the DEM, if successful.
+******************************************************************************/
+static int init_angle_generation
+(
+    char *angle_coeff_name,     /* I: Angle coefficient filename */
+    int subsamp_fact,           /* I: Subsample factor */
+    short fill_pix_value,       /* I: Fill pixel value to use (-32768:32767) */
+    char *band_list,            /* I: Band list used to calculate angles for */
+    int grid_spacing,           /* I: Spacing of the exactly evaluated angle
+                                      grid in output pixels */
+    double max_grid_error,      /* I: Maximum interpolation error at the
+                                      center of a grid cell (degrees) */
+    int verify_grid_flag,       /* I: Flag to verify the interpolated angles */
+    int nthreads,               /* I: Number of threads to use */
+    int share_band_flag,        /* I: Flag to share angles between bands */
+    const char *dem_filename,   /* I: DEM giving the heights, or NULL to use
+                                      zero height */
+    L8_ANGLES_PARAMETERS *parameters, /* O: Generation parameters */
+    IAS_ANGLE_GEN_METADATA *metadata  /* O: Angle metadata structure */
+)
+{
+    /* Initialize the logging library */
+    if (ias_log_initialize("L8 Angles") != SUCCESS)
+    {
+        IAS_LOG_ERROR("Error initializing logging library");
+        return ERROR;
+    }
+
+    /* Validate the angle grid parameters */
+    if (grid_spacing < 1)
+    {
+        IAS_LOG_ERROR("Invalid angle grid spacing %d", grid_spacing);
+        return ERROR;
+    }
+    if (max_grid_error < 0.0)
+    {
+        IAS_LOG_ERROR("Invalid maximum angle grid error %f", max_grid_error);
+        return ERROR;
+    }
+
+    /* Read the metadata file.  This also initializes the satellite
+       attributes for the satellite of the file, which the band list is
+       checked against. */
+    if (ias_angle_gen_read_ang(angle_coeff_name, metadata) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Reading the metadata file %s", angle_coeff_name);
+        return ERROR;
+    }
+
+    /* Process the arguments */
+    if (process_parameters(angle_coeff_name, subsamp_fact, fill_pix_value,
+        band_list, parameters) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Invalid input parameters");
+        ias_angle_gen_free(metadata);
+        return ERROR;
+    }
+
+    parameters->grid_spacing = grid_spacing;
+    parameters->max_grid_error = max_grid_error;
+    parameters->verify_grid_flag = verify_grid_flag;
+
+    /* Make sure the number of threads is valid */
+    if (nthreads < 1)
+        nthreads = 1;
+    parameters->nthreads = nthreads;
+    parameters->share_band_flag = share_band_flag;
+
+    /* Convert the angles in single precision if requested */
+    metadata->single_precision_flag = use_single_precision_angles();
+    if (metadata->single_precision_flag)
+        IAS_LOG_INFO("Converting the angle vectors in single precision");
+
+    /* Evaluate the angles on the offload device if requested.  The
+       coefficients are copied to the device once for the scene. */
+    if (use_angle_offload())
+    {
+        if (ias_angle_gen_offload_metadata(metadata) == SUCCESS)
+            IAS_LOG_INFO("Evaluating the angles on the offload device");
+        else
+            IAS_LOG_WARNING("Evaluating the angles on the host instead");
+    }
+
+    /* Open the DEM, if the angles are generated at the terrain height */
+    parameters->dem = NULL;
+    parameters->use_dem_flag = (dem_filename != NULL);
+    if (parameters->use_dem_flag)
+    {
+        parameters->dem = l8_angles_open_dem(dem_filename);
+        if (parameters->dem == NULL)
+        {
+            IAS_LOG_ERROR("Opening the DEM %s", dem_filename);
+            ias_angle_gen_free(metadata);
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+NAME: process_parameters
+
+PURPOSE: This fuction processes the l8_angles parameters to specify which
+angles to process and some of the processing information.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The parameters were successfully processed
+    ERROR     An error occurred processing the parameters
+******************************************************************************/
+static int process_parameters
+(
+    char *angle_coeff_name,     /* I: Angle coefficient filename */
+    int subsamp_fact,           /* I: Subsample factor used when calculating
+                                      the angles (1=full resolution). OW take
+                                      every Nth sample from the line, where
+                                      N=subsamp_fact */
+    short fill_pix_value,       /* I: Fill pixel value to use (-32768:32767) */
+    char *band_list,            /* I: Band list used to calculate angles for.
+                                      "ALL" - defaults to all satellite bands.
+                                      Must be comma separated with no spaces in
+                                      between.  Example: 1,2,3,4,5,6,7,8,9 */
+    L8_ANGLES_PARAMETERS *parameters /* O: Generation parameters */
+)
+{
+    int local_band_count;     /* Number of bands read */
+    int local_band_numbers[IAS_MAX_NBANDS] = {ERROR}; /* Read in band numbers */
+    int index;                /* Generic loop variable */
+    int band_list_init_value; /* Band list initialize value */
+    int band_already_in_list[IAS_MAX_NBANDS];
+    int status;
+
+    /* Copy the angle coefficient filename */
+    status = snprintf(parameters->metadata_filename, 
+        sizeof(parameters->metadata_filename), "%s", angle_coeff_name); 
+    if (status < 0 || status >= sizeof(parameters->metadata_filename))
+    {
+        IAS_LOG_ERROR("Copying the metadata filename");
+        return ERROR;
+    }   
+
+    /* Parse the sub sample factor */
+    parameters->sub_sample_factor = subsamp_fact;
+
+    /* Parse the fill pixel value */
+    parameters->background = fill_pix_value;
+
+    /* Parse the band list */
+    band_list_init_value = 1;
+    local_band_count = 0;
+
+    /* Parse the fill pixel value and band list */
+    int offset = 0;
+    int character_count = 0;
+    int band_length = strlen(band_list);
+
+    /* Check for the use of ALL in the band list.  If ALL was specified then
+       process all the normal bands of the satellite (1-11 for Landsat 8).
+       Otherwise, parse the band list provided. */
+    if ((!strcmp (band_list, "ALL")) || (!strcmp (band_list, "all")))
+    {
+        int normal_band_count = ias_sat_attr_get_normal_band_count();
+
+        for (index = 0; index < IAS_MAX_NBANDS; index++)
+            parameters->process_band[index] = (index < normal_band_count);
+    }
+    else
+    {
+        /* Read in the band list */
+        while (character_count <= band_length)
+        {
+            if (sscanf(band_list, "%d%n", &local_band_numbers[local_band_count],
+                &offset) < 1)
+            {
+                IAS_LOG_ERROR("Parsing the band list");
+                return ERROR;
+            }
+
+            character_count += offset + 1;
+            band_list += offset + 1; /* Move pointer ahead the number length 
+                                         + 1 (for the comma) */
+            local_band_count++;
+            if (local_band_count > IAS_MAX_NBANDS)
+            {
+                IAS_LOG_ERROR("Too many bands specified");
+                return ERROR;   
+            }
+        }
+
+        /* Initialize band list */
+        band_list_init_value = 0;
+        for (index = 0; index < IAS_MAX_NBANDS; index++)
+        {
+            parameters->process_band[index] = band_list_init_value;
+            band_already_in_list[index] = band_list_init_value;
+        }
+
+        for (index = 0; index < local_band_count; index++)
+        {
+            /* Convert the band number entered into a band index */
+            int temp_band_index = ias_sat_attr_convert_band_number_to_index(    
+                local_band_numbers[index]);
+            if (temp_band_index == ERROR)
+            {
+                /* No bands numbers entered, so it is an error */
+                IAS_LOG_ERROR("Illegal band number %d",
+                    local_band_numbers[index]);
+                return ERROR;
+            }
+
+            /* Make sure the band isn't already in the list */
+            if (temp_band_index != ERROR)
+            {
+                if (!band_already_in_list[temp_band_index])
+                {
+                    /* Put band in list and flag that it has been added to
+                       the list */
+                    parameters->process_band[temp_band_index] = 1;
+                    band_already_in_list[temp_band_index] += 1;
+                }
+                else if (band_already_in_list[temp_band_index] == 1)
+                {
+                     /* Only print the warning message once for each band */
+                     band_already_in_list[temp_band_index] += 1;
+
+                     IAS_LOG_WARNING("Warning: Band number %d appears multiple "
+                         "times in the BAND_LIST, only the first one was used",
+                         local_band_numbers[index]);
+                }
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+NAME: evaluate_grid_point
+
+PURPOSE: Evaluates the angles exactly at one point of the angle grid and
+identifies the SCA(s) the point falls in.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were evaluated, or the point is outside the SCAs
+    ERROR     An error occurred evaluating the angles
+******************************************************************************/
+static int evaluate_grid_point
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    L8_ANGLES_DEM *dem,         /* I: DEM for the heights (or NULL) */
+    int line,                   /* I: L1T line coordinate */
+    int samp,                   /* I: L1T sample coordinate */
+    int band_index,             /* I: Band index */
+    ANGLE_TYPE angle_type,      /* I: Type of angles to generate */
+    ANGLE_GRID_POINT *point     /* O: Angles at the grid point */
+)
+{
+    point->sat_angles[IAS_ANGLE_GEN_ZENITH_INDEX] = 0.0;
+    point->sat_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX] = 0.0;
+    point->sun_angles[IAS_ANGLE_GEN_ZENITH_INDEX] = 0.0;
+    point->sun_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX] = 0.0;
+
+    /* Points outside the SCAs can't be used for interpolation */
+    point->sca_key = get_sca_key(metadata, dem, line, samp, band_index);
+    if (point->sca_key < 0)
+        return SUCCESS;
+
+    return calculate_angles(metadata, dem, line, samp, band_index, angle_type,
+        point->sat_angles, point->sun_angles);
+}
+
+/******************************************************************************
+NAME: interpolate_grid_angles
+
+PURPOSE: Bilinearly interpolates the angles from the four corners of a grid
+cell.  The corners are ordered upper left, upper right, lower left, lower
+right.
+
+RETURN VALUE: Type = None
+******************************************************************************/
+static void interpolate_grid_angles
+(
+    const ANGLE_GRID_POINT corner[4], /* I: Angles at the cell corners */
+    double line_fraction,       /* I: Fraction of the cell height (0 - 1) */
+    double samp_fraction,       /* I: Fraction of the cell width (0 - 1) */
+    double *sat_angles,         /* O: Satellite angles (radians) */
+    double *sun_angles          /* O: Solar angles (radians) */
+)
+{
+    int angle_index;            /* Zenith or azimuth index */
+
+    for (angle_index = 0; angle_index < 2; angle_index++)
+    {
+        sat_angles[angle_index] = (1.0 - line_fraction)
+            * ((1.0 - samp_fraction) * corner[0].sat_angles[angle_index]
+                + samp_fraction * corner[1].sat_angles[angle_index])
+            + line_fraction
+            * ((1.0 - samp_fraction) * corner[2].sat_angles[angle_index]
+                + samp_fraction * corner[3].sat_angles[angle_index]);
+        sun_angles[angle_index] = (1.0 - line_fraction)
+            * ((1.0 - samp_fraction) * corner[0].sun_angles[angle_index]
+                + samp_fraction * corner[1].sun_angles[angle_index])
+            + line_fraction
+            * ((1.0 - samp_fraction) * corner[2].sun_angles[angle_index]
+                + samp_fraction * corner[3].sun_angles[angle_index]);
+    }
+}
+
+/* Number of points in a grid cell where the interpolated angles are checked
+   against the exact angles: the center and the middle of each edge */
+#define NUM_GRID_CHECK_POINTS 5
+
+/******************************************************************************
+NAME: check_grid_cell
+
+PURPOSE: Determines if the angles in a grid cell can be interpolated from the
+cell corners.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    TRUE      The cell can be interpolated
+    FALSE     The cell needs to be evaluated exactly
+
+NOTES:
+  1. All the corners and check points must fall in the same SCA, or the same
+     pair of overlapping SCAs, since the angles are discontinuous between
+     SCAs.
+  2. The azimuths at the corners must not wrap around between -pi and pi.
+  3. The angles interpolated at each check point must be within the maximum
+     error of the exact angles at that point.
+******************************************************************************/
+static int check_grid_cell
+(
+    const ANGLE_GRID_POINT corner[4], /* I: Angles at the cell corners */
+    const ANGLE_GRID_POINT *check, /* I: Angles at the check points */
+    const double *line_fraction, /* I: Fraction of the cell height at each
+                                       check point */
+    const double *samp_fraction, /* I: Fraction of the cell width at each
+                                       check point */
+    ANGLE_TYPE angle_type,      /* I: Type of angles to generate */
+    double max_error            /* I: Maximum error allowed (radians) */
+)
+{
+    double sat_angles[2];       /* Interpolated satellite angles */
+    double sun_angles[2];       /* Interpolated solar angles */
+    double min_sat_azimuth;     /* Minimum satellite azimuth at the corners */
+    double max_sat_azimuth;     /* Maximum satellite azimuth at the corners */
+    double min_sun_azimuth;     /* Minimum solar azimuth at the corners */
+    double max_sun_azimuth;     /* Maximum solar azimuth at the corners */
+    double pi = 4.0 * atan(1.0);
+    int angle_index;            /* Zenith or azimuth index */
+    int index;                  /* Corner or check point index */
+
+    /* Make sure all the points are in the same SCA(s) */
+    if (corner[0].sca_key < 0)
+        return FALSE;
+    for (index = 1; index < 4; index++)
+    {
+        if (corner[index].sca_key != corner[0].sca_key)
+            return FALSE;
+    }
+    for (index = 0; index < NUM_GRID_CHECK_POINTS; index++)
+    {
+        if (check[index].sca_key != corner[0].sca_key)
+            return FALSE;
+    }
+
+    /* Make sure the azimuths don't wrap around */
+    min_sat_azimuth = max_sat_azimuth =
+        corner[0].sat_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX];
+    min_sun_azimuth = max_sun_azimuth =
+        corner[0].sun_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX];
+    for (index = 1; index < 4; index++)
+    {
+        min_sat_azimuth = fmin(min_sat_azimuth,
+            corner[index].sat_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
+        max_sat_azimuth = fmax(max_sat_azimuth,
+            corner[index].sat_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
+        min_sun_azimuth = fmin(min_sun_azimuth,
+            corner[index].sun_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
+        max_sun_azimuth = fmax(max_sun_azimuth,
+            corner[index].sun_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
+    }
+    if (max_sat_azimuth - min_sat_azimuth > pi
+        || max_sun_azimuth - min_sun_azimuth > pi)
+    {
+        return FALSE;
+    }
+
+    /* Compare the interpolated and exact angles at the check points */
+    for (index = 0; index < NUM_GRID_CHECK_POINTS; index++)
+    {
+        interpolate_grid_angles(corner, line_fraction[index],
+            samp_fraction[index], sat_angles, sun_angles);
+        for (angle_index = 0; angle_index < 2; angle_index++)
+        {
+            if (angle_type != AT_SOLAR && fabs(sat_angles[angle_index]
+                - check[index].sat_angles[angle_index]) > max_error)
+            {
+                return FALSE;
+            }
+            if (angle_type != AT_SATELLITE && fabs(sun_angles[angle_index]
+                - check[index].sun_angles[angle_index]) > max_error)
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/******************************************************************************
+NAME: store_angles
+
+PURPOSE: Quantizes the angles for one pixel into the angle bands that are
+being generated.
+
+RETURN VALUE: Type = None
+******************************************************************************/
+static void store_angles
+(
+    const double *sat_angles,   /* I: Satellite angles (radians) */
+    const double *sun_angles,   /* I: Solar angles (radians) */
+    size_t index,               /* I: Index of the pixel in the bands */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth        /* O: Solar azimuth angles (or NULL) */
+)
+{
+    double r2d = 4500.0 / atan(1.0);  /* Conversion to hundredths of degrees;
+                                         this includes the conversion of radians
+                                         to degrees in addition to scaling by
+                                         100.0 */
+
+    if (sat_azimuth)
+        sat_azimuth[index] = (short) round (r2d *
+            sat_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
+    if (sat_zenith)
+        sat_zenith[index] = (short) round (r2d *
+            sat_angles[IAS_ANGLE_GEN_ZENITH_INDEX]);
+    if (solar_azimuth)
+        solar_azimuth[index] = (short) round (r2d *
+            sun_angles[IAS_ANGLE_GEN_AZIMUTH_INDEX]);
+    if (solar_zenith)
+        solar_zenith[index] = (short) round (r2d *
+            sun_angles[IAS_ANGLE_GEN_ZENITH_INDEX]);
+}
+
+/******************************************************************************
+NAME: store_fill
+
+PURPOSE: Stores the fill value for one pixel into the angle bands that are
+being generated.
+
+RETURN VALUE: Type = None
+******************************************************************************/
+static void store_fill
+(
+    short background,           /* I: Fill value */
+    size_t index,               /* I: Index of the pixel in the bands */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth        /* O: Solar azimuth angles (or NULL) */
+)
+{
+    if (sat_azimuth)
+        sat_azimuth[index] = background;
+    if (sat_zenith)
+        sat_zenith[index] = background;
+    if (solar_azimuth)
+        solar_azimuth[index] = background;
+    if (solar_zenith)
+        solar_zenith[index] = background;
+}
+
+/******************************************************************************
+NAME: grid_row_angles
+
+PURPOSE: Generates the angles for one row of grid cells in a band.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
+
+NOTES:
+  1. The cell counts and the maximum verified error are accumulated into the
+     values passed in, so several rows can be totaled together.
+******************************************************************************/
+static int grid_row_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    const L8_ANGLES_PARAMETERS *parameters, /* I: Generation parameters */
+    int band_index,             /* I: Band index */
+    const IAS_MISC_LINE_EXTENT *trim_lut, /* I: Image trim lookup table */
+    int line0,                  /* I: First line of the row of cells */
+    int num_lines,              /* I: Lines in output angle band */
+    int num_samps,              /* I: Samps in output angle band */
+    int buf_line,               /* I: Output line held in the first line of
+                                      the angle buffers */
+    double max_grid_error,      /* I: Maximum interpolation error (radians) */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth,       /* O: Solar azimuth angles (or NULL) */
+    int *num_cells,             /* I/O: Number of grid cells */
+    int *num_interp_cells,      /* I/O: Number of interpolated grid cells */
+    int *max_error              /* I/O: Largest verified error
+                                        (degrees * 100) */
+)
+{
+    int sub_sample = parameters->sub_sample_factor; /* Subsampling factor */
+    int spacing = parameters->grid_spacing; /* Grid spacing */
+    int line1;                  /* Last line of the cell */
+    int samp0, samp1;           /* First and last sample of the cell */
+    int last_line;              /* Last line filled from the cell */
+    int last_samp;              /* Last sample filled from the cell */
+    int line;                   /* Output line index */
+    int samp;                   /* Output sample index */
+
+    line1 = line0 + spacing;
+    if (line1 > num_lines - 1)
+        line1 = num_lines - 1;
+    last_line = (line1 == num_lines - 1) ? line1 : line1 - 1;
+
+    for (samp0 = 0; ; samp0 = samp1)
+    {
+        ANGLE_GRID_POINT corner[4]; /* Exact angles at the corners */
+        ANGLE_GRID_POINT check[NUM_GRID_CHECK_POINTS];
+                                    /* Exact angles at the check points */
+        int corner_line[4];         /* Output line of each corner */
+        int corner_samp[4];         /* Output sample of each corner */
+        int check_line[NUM_GRID_CHECK_POINTS]; /* Output line of each
+                                                  check point */
+        int check_samp[NUM_GRID_CHECK_POINTS]; /* Output sample of each
+                                                  check point */
+        double check_line_fraction[NUM_GRID_CHECK_POINTS];
+                                    /* Cell height fraction of each
+                                       check point */
+        double check_samp_fraction[NUM_GRID_CHECK_POINTS];
+                                    /* Cell width fraction of each
+                                       check point */
+        int center_line;            /* Output line of the center */
+        int center_samp;            /* Output sample of the center */
+        int interpolate;            /* Flag to interpolate the cell */
+        int index;                  /* Corner or check point index */
+        size_t pixel;               /* Index of the pixel in the bands */
+
+        samp1 = samp0 + spacing;
+        if (samp1 > num_samps - 1)
+            samp1 = num_samps - 1;
+        last_samp = (samp1 == num_samps - 1) ? samp1 : samp1 - 1;
+
+        /* Evaluate the cell corners and check points exactly */
+        corner_line[0] = corner_line[1] = line0;
+        corner_line[2] = corner_line[3] = line1;
+        corner_samp[0] = corner_samp[2] = samp0;
+        corner_samp[1] = corner_samp[3] = samp1;
+        for (index = 0; index < 4; index++)
+        {
+            if (evaluate_grid_point(metadata, parameters->dem,
+                corner_line[index] * sub_sample,
+                corner_samp[index] * sub_sample, band_index,
+                parameters->angle_type, &corner[index]) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Evaluating angle grid point at line %d "
+                    "sample %d", corner_line[index] * sub_sample,
+                    corner_samp[index] * sub_sample);
+                return ERROR;
+            }
+        }
+
+        center_line = (line0 + line1) / 2;
+        center_samp = (samp0 + samp1) / 2;
+        check_line[0] = center_line;
+        check_samp[0] = center_samp;
+        check_line[1] = line0;
+        check_samp[1] = center_samp;
+        check_line[2] = line1;
+        check_samp[2] = center_samp;
+        check_line[3] = center_line;
+        check_samp[3] = samp0;
+        check_line[4] = center_line;
+        check_samp[4] = samp1;
+        for (index = 0; index < NUM_GRID_CHECK_POINTS; index++)
+        {
+            if (evaluate_grid_point(metadata, parameters->dem,
+                check_line[index] * sub_sample,
+                check_samp[index] * sub_sample, band_index,
+                parameters->angle_type, &check[index]) != SUCCESS)
+            {
+                IAS_LOG_ERROR("Evaluating angle grid point at line %d "
+                    "sample %d", check_line[index] * sub_sample,
+                    check_samp[index] * sub_sample);
+                return ERROR;
+            }
+            check_line_fraction[index] = (line1 > line0)
+                ? (double)(check_line[index] - line0) / (line1 - line0)
+                : 0.0;
+            check_samp_fraction[index] = (samp1 > samp0)
+                ? (double)(check_samp[index] - samp0) / (samp1 - samp0)
+                : 0.0;
+        }
+
+        interpolate = check_grid_cell(corner, check, check_line_fraction,
+            check_samp_fraction, parameters->angle_type, max_grid_error);
+        (*num_cells)++;
+        if (interpolate)
+            (*num_interp_cells)++;
+
+        /* Fill the pixels in the cell */
+        for (line = line0; line <= last_line; line++)
+        {
+            int l1t_line = line * sub_sample;   /* L1T line */
+
+            for (samp = samp0; samp <= last_samp; samp++)
+            {
+                int l1t_samp = samp * sub_sample;   /* L1T sample */
+                double sun_angles[2];   /* Solar angles */
+                double sat_angles[2];   /* Viewing angles */
+
+                /* If the current sample falls outside the actual range
+                   of image data in this scene, then fill the pixel and
+                   goto the next one. */
+                pixel = (size_t) (line - buf_line) * num_samps + samp;
+                if (l1t_samp <= trim_lut[l1t_line].start_sample ||
+                    l1t_samp >= trim_lut[l1t_line].end_sample)
+                {
+                    store_fill(parameters->background, pixel, sat_zenith,
+                        sat_azimuth, solar_zenith, solar_azimuth);
+                    continue;
+                }
+
+                if (!interpolate || parameters->verify_grid_flag)
+                {
+                    if (calculate_angles(metadata, parameters->dem,
+                        l1t_line, l1t_samp, band_index,
+                        parameters->angle_type, sat_angles, sun_angles)
+                        != SUCCESS)
+                    {
+                        IAS_LOG_ERROR("Evaluating angles at line %d "
+                            "sample %d", l1t_line, l1t_samp);
+                        return ERROR;
+                    }
+                    store_angles(sat_angles, sun_angles, pixel,
+                        sat_zenith, sat_azimuth, solar_zenith,
+                        solar_azimuth);
+                }
+
+                if (interpolate)
+                {
+                    short exact[4];     /* Exact angles for verifying */
+                    short *bands[4];    /* Angle bands being generated */
+                    int band;           /* Angle band index */
+
+                    /* Save the exact angles before they are replaced
+                       with the interpolated ones */
+                    bands[0] = sat_zenith;
+                    bands[1] = sat_azimuth;
+                    bands[2] = solar_zenith;
+                    bands[3] = solar_azimuth;
+                    for (band = 0; band < 4; band++)
+                    {
+                        if (bands[band])
+                            exact[band] = bands[band][pixel];
+                    }
+
+                    interpolate_grid_angles(corner,
+                        (line1 > line0) ? (double)(line - line0)
+                            / (line1 - line0) : 0.0,
+                        (samp1 > samp0) ? (double)(samp - samp0)
+                            / (samp1 - samp0) : 0.0,
+                        sat_angles, sun_angles);
+                    store_angles(sat_angles, sun_angles, pixel,
+                        sat_zenith, sat_azimuth, solar_zenith,
+                        solar_azimuth);
+
+                    if (parameters->verify_grid_flag)
+                    {
+                        for (band = 0; band < 4; band++)
+                        {
+                            if (bands[band] && abs(bands[band][pixel]
+                                - exact[band]) > *max_error)
+                            {
+                                *max_error = abs(bands[band][pixel]
+                                    - exact[band]);
+                            }
+                        }
+                    }
+                }
+            }  /* for samp */
+        }  /* for line */
+
+        if (samp1 == num_samps - 1)
+            break;
+    }  /* for samp0 */
+
+    return SUCCESS;
+}
+
+
+/******************************************************************************
+NAME: grid_band_angles
+
+PURPOSE: Generates the angles for one band by evaluating the angles exactly
+on a coarse grid and interpolating between the grid points.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
+
+NOTES:
+  1. The pixels outside the actual range of image data in the scene are set
+     to the background value.
+  2. Each grid cell covers grid_spacing x grid_spacing output pixels, with the
+     last cell in each direction ending on the last line or sample.  See
+     check_grid_cell for when a cell is evaluated exactly instead.
+  3. If verification is requested, every interpolated pixel is also evaluated
+     exactly and the largest difference is reported.
+******************************************************************************/
+static int grid_band_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    const L8_ANGLES_PARAMETERS *parameters, /* I: Generation parameters */
+    int band_index,             /* I: Band index */
+    const IAS_MISC_LINE_EXTENT *trim_lut, /* I: Image trim lookup table */
+    int num_lines,              /* I: Lines in output angle band */
+    int num_samps,              /* I: Samps in output angle band */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth        /* O: Solar azimuth angles (or NULL) */
+)
+{
+    int num_cells = 0;          /* Number of grid cells */
+    int num_interp_cells = 0;   /* Number of interpolated grid cells */
+    int max_error = 0;          /* Largest verified error (degrees * 100) */
+
+    if (grid_block_angles(metadata, parameters, band_index, trim_lut,
+        num_lines, num_samps, 0, get_grid_rows(num_lines,
+        parameters->grid_spacing), 0, sat_zenith, sat_azimuth, solar_zenith,
+        solar_azimuth, &num_cells, &num_interp_cells, &max_error) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Generating the angles for the grid cells");
+        return ERROR;
+    }
+
+    log_grid_stats(parameters, num_cells, num_interp_cells, max_error);
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+NAME: get_grid_rows
+
+PURPOSE: Determines the number of rows of grid cells in a band.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    >= 1      Number of rows of grid cells
+
+NOTES:
+  1. The last row of cells ends on the last line, so it covers one more line
+     than the others, and a single line band still has one row.
+******************************************************************************/
+static int get_grid_rows
+(
+    int num_lines,              /* I: Lines in output angle band */
+    int spacing                 /* I: Grid spacing */
+)
+{
+    int num_rows;               /* Number of rows of grid cells */
+
+    num_rows = (num_lines + spacing - 2) / spacing;
+    if (num_rows < 1)
+        num_rows = 1;
+
+    return num_rows;
+}
+
+/******************************************************************************
+NAME: get_angle_line_bytes
+
+PURPOSE: Determines the memory needed for a line of the angle blocks of all
+the processed bands.
+
+RETURN VALUE: Type = size_t
+    Value     Description
+    -----     -----------
+    >= 0      Bytes for a line of every angle of every band
+
+NOTES:
+  1. This is an upper bound, since the angles shared between bands aren't
+     allocated for each band.
+******************************************************************************/
+static size_t get_angle_line_bytes
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata */
+    const L8_ANGLES_PARAMETERS *parameters  /* I: Generation parameters */
+)
+{
+    int band_index;             /* Band index */
+    size_t line_bytes = 0;      /* Bytes for a line of the blocks */
+    ANGLES_FRAME frame;         /* Image frame info for the band */
+
+    for (band_index = 0; band_index < L8_NBANDS; band_index++)
+    {
+        if (!parameters->process_band[band_index]
+            || get_frame(metadata, band_index, &frame) != SUCCESS)
+        {
+            continue;
+        }
+
+        line_bytes += (size_t) NUM_ANGLES * sizeof(short)
+            * ((frame.num_samps - 1) / parameters->sub_sample_factor + 1);
+    }
+
+    return line_bytes;
+}
+
+/******************************************************************************
+NAME: log_grid_stats
+
+PURPOSE: Reports how many of the grid cells of a band were interpolated, and
+the verified interpolation error.
+
+RETURN VALUE: Type = None
+******************************************************************************/
+static void log_grid_stats
+(
+    const L8_ANGLES_PARAMETERS *parameters, /* I: Generation parameters */
+    int num_cells,              /* I: Number of grid cells */
+    int num_interp_cells,       /* I: Number of interpolated grid cells */
+    int max_error               /* I: Largest verified error
+                                      (degrees * 100) */
+)
+{
+    IAS_LOG_INFO("Interpolated %d of %d angle grid cells with a grid spacing "
+        "of %d", num_interp_cells, num_cells, parameters->grid_spacing);
+    if (parameters->verify_grid_flag)
+    {
+        IAS_LOG_INFO("Maximum interpolation error against the exact angles: "
+            "%.2f degrees", (double) max_error / ANGLE_SCALE);
+    }
+}
+
+/* Block of rows of grid cells, or of lines, split across the threads */
+typedef struct angle_block
+{
+    const IAS_ANGLE_GEN_METADATA *metadata; /* Angle metadata structure */
+    const L8_ANGLES_PARAMETERS *parameters; /* Generation parameters */
+    int band_index;             /* Band index */
+    const IAS_MISC_LINE_EXTENT *trim_lut; /* Image trim lookup table */
+    int num_lines;              /* Lines in output angle band */
+    int num_samps;              /* Samps in output angle band */
+    int buf_line;               /* Output line held in the first line of the
+                                   angle buffers */
+    double max_grid_error;      /* Maximum interpolation error (radians) */
+    short *sat_zenith;          /* Satellite zenith angles (or NULL) */
+    short *sat_azimuth;         /* Satellite azimuth angles (or NULL) */
+    short *solar_zenith;        /* Solar zenith angles (or NULL) */
+    short *solar_azimuth;       /* Solar azimuth angles (or NULL) */
+    int num_cells[ESPA_TASK_MAX_THREADS]; /* Grid cells of each thread */
+    int num_interp_cells[ESPA_TASK_MAX_THREADS]; /* Interpolated grid cells
+                                   of each thread */
+    int max_error[ESPA_TASK_MAX_THREADS]; /* Largest verified error of each
+                                   thread (degrees * 100) */
+} ANGLE_BLOCK;
+
+/******************************************************************************
+NAME: grid_rows_angles
+
+PURPOSE: Generates the angles for a range of the rows of grid cells of a
+block, as a chunk of espa_parallel_for.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
+
+NOTES:
+  1. The cell counts and the verified error are accumulated into the
+     runner's entries of the block.
+******************************************************************************/
+static int grid_rows_angles
+(
+    void *arg,                  /* I/O: Block being generated (ANGLE_BLOCK) */
+    int first_row,              /* I: First row of grid cells */
+    int end_row,                /* I: Row of grid cells after the range */
+    int runner                  /* I: Thread generating the rows */
+)
+{
+    ANGLE_BLOCK *block = arg;   /* Block being generated */
+    int row;                    /* Grid cell row index */
+
+    for (row = first_row; row < end_row; row++)
+    {
+        if (grid_row_angles(block->metadata, block->parameters,
+            block->band_index, block->trim_lut,
+            row * block->parameters->grid_spacing, block->num_lines,
+            block->num_samps, block->buf_line, block->max_grid_error,
+            block->sat_zenith, block->sat_azimuth, block->solar_zenith,
+            block->solar_azimuth, &block->num_cells[runner],
+            &block->num_interp_cells[runner], &block->max_error[runner])
+            != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+NAME: grid_block_angles
+
+PURPOSE: Generates the angles for a block of rows of grid cells in a band.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
+
+NOTES:
+  1. The angle buffers hold the lines from buf_line through the last line of
+     the block.  The pixels outside the scene are set to the background
+     value.
+  2. The cell counts and the maximum verified error are accumulated into the
+     values passed in.
+******************************************************************************/
+static int grid_block_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    const L8_ANGLES_PARAMETERS *parameters, /* I: Generation parameters */
+    int band_index,             /* I: Band index */
+    const IAS_MISC_LINE_EXTENT *trim_lut, /* I: Image trim lookup table */
+    int num_lines,              /* I: Lines in output angle band */
+    int num_samps,              /* I: Samps in output angle band */
+    int first_row,              /* I: First row of grid cells in the block */
+    int end_row,                /* I: Row of grid cells after the block */
+    int buf_line,               /* I: Output line held in the first line of
+                                      the angle buffers */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth,       /* O: Solar azimuth angles (or NULL) */
+    int *num_cells,             /* I/O: Number of grid cells */
+    int *num_interp_cells,      /* I/O: Number of interpolated grid cells */
+    int *max_error              /* I/O: Largest verified error
+                                        (degrees * 100) */
+)
+{
+    int runner;                 /* Thread index */
+    ANGLE_BLOCK block;          /* Block split across the threads */
+
+    memset(&block, 0, sizeof(block));
+    block.metadata = metadata;
+    block.parameters = parameters;
+    block.band_index = band_index;
+    block.trim_lut = trim_lut;
+    block.num_lines = num_lines;
+    block.num_samps = num_samps;
+    block.buf_line = buf_line;
+    block.max_grid_error = parameters->max_grid_error * atan(1.0) / 45.0;
+    block.sat_zenith = sat_zenith;
+    block.sat_azimuth = sat_azimuth;
+    block.solar_zenith = solar_zenith;
+    block.solar_azimuth = solar_azimuth;
+
+    /* Loop through the rows of grid cells.  The rows are independent, so
+       they are split across the threads. */
+    if (espa_parallel_for(first_row, end_row, 1, parameters->nthreads,
+        grid_rows_angles, &block) != SUCCESS)
+    {
+        IAS_LOG_ERROR("Generating the angles for the grid cells");
+        return ERROR;
+    }
 
-    if (avg_sat_zenith != NULL)
+    for (runner = 0; runner < ESPA_TASK_MAX_THREADS; runner++)
     {
-        /* Loop through the reflectance bands and compute the average of these
-           bands. Some of the pixels on the scene edge will be zero and throws
-           off the average, so don't count the zero values. */
-        printf ("Computing average for satellite zenith ...\n");
-        for (band_index = 0; band_index < L8_NBANDS; band_index++)
-        {
-            /* Check if this band be added to the average */
-            if (!process_band[band_index])
-                continue;
+        *num_cells += block.num_cells[runner];
+        *num_interp_cells += block.num_interp_cells[runner];
+        if (block.max_error[runner] > *max_error)
+            *max_error = block.max_error[runner];
+    }
 
-            /* Add this band to the sum.  Skip values of 0 since they occur on
-               the scene edges and we don't want to count them. */
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    if (sat_zenith[band_index][index] != 0)
-                    {
-                        sum[index] += sat_zenith[band_index][index];
-                        pix_count[index]++;
-                    }
+    return SUCCESS;
+}
 
-            /* Release the memory */
-            free (sat_zenith[band_index]);
-        }
+/******************************************************************************
+NAME: get_exact_samp_range
 
-        /* Get the average */
-        band_index = 0;
-        for (line = 0, index = 0; line < frame[band_index].num_lines;
-             line += sub_sample)
-            for (samp = 0; samp < frame[band_index].num_samps;
-                 samp += sub_sample, index++)
-                (*avg_sat_zenith)[index] =
-                    (short) (round ((float) sum[index] / pix_count[index]));
-    }
+PURPOSE: Finds the output samples of a line strictly inside the trim extent
+of the L1T line, which are the samples evaluated exactly.
 
-    if (avg_sat_azimuth != NULL)
-    {
-        /* Clear the sum and pixel count arrays back to 0 */
-        memset (sum, 0, angle_size * sizeof (long));
-        memset (pix_count, 0, angle_size * sizeof (ushort));
+RETURN VALUE: Type = None
+******************************************************************************/
+static void get_exact_samp_range
+(
+    const IAS_MISC_LINE_EXTENT *extent, /* I: Image trim extent of the L1T
+                                      line */
+    int num_samps,              /* I: Samps in output angle band */
+    int sub_sample,             /* I: Subsampling factor */
+    int *first_samp,            /* O: First output sample in the scene */
+    int *end_samp               /* O: Output sample after the scene */
+)
+{
+    *first_samp = (extent->start_sample < 0)
+        ? 0 : extent->start_sample / sub_sample + 1;
+    *end_samp = (extent->end_sample <= 0)
+        ? 0 : (extent->end_sample - 1) / sub_sample + 1;
+    if (*first_samp > num_samps)
+        *first_samp = num_samps;
+    if (*end_samp > num_samps)
+        *end_samp = num_samps;
+    if (*end_samp < *first_samp)
+        *end_samp = *first_samp;
+}
 
-        /* Loop through the reflectance bands and compute the average of these
-           bands. Some of the pixels on the scene edge will be zero and throws
-           off the average, so don't count the zero values. */
-        printf ("Computing average for satellite azimuth ...\n");
-        for (band_index = 0; band_index < L8_NBANDS; band_index++)
-        {
-            /* Check if this band be added to the average */
-            if (!process_band[band_index])
-                continue;
+/******************************************************************************
+NAME: exact_line_angles
 
-            /* Add this band to the sum */
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    if (sat_azimuth[band_index][index] != 0)
-                    {
-                        sum[index] += sat_azimuth[band_index][index];
-                        pix_count[index]++;
-                    }
+PURPOSE: Generates the angles for one output line of a band by evaluating
+every pixel in the scene exactly.
 
-            /* Release the memory */
-            free (sat_azimuth[band_index]);
-        }
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
 
-        /* Get the average */
-        band_index = 0;
-        for (line = 0, index = 0; line < frame[band_index].num_lines;
-             line += sub_sample)
-            for (samp = 0; samp < frame[band_index].num_samps;
-                 samp += sub_sample, index++)
-                (*avg_sat_azimuth)[index] =
-                    (short) (round ((float) sum[index] / pix_count[index]));
+NOTES:
+  1. Only the samples within the actual range of image data in the scene are
+     evaluated.  The samples outside it are set to the background value.
+  2. The samples are evaluated IAS_ANGLE_GEN_LINE_CHUNK at a time along the
+     line (see calculate_line_angles), rather than one at a time.
+******************************************************************************/
+static int exact_line_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    L8_ANGLES_DEM *dem,         /* I: DEM for the heights (or NULL) */
+    int band_index,             /* I: Band index */
+    const IAS_MISC_LINE_EXTENT *extent, /* I: Image trim extent of the L1T
+                                      line */
+    int line,                   /* I: L1T line */
+    int num_samps,              /* I: Samps in output angle band */
+    int sub_sample,             /* I: Subsampling factor */
+    ANGLE_TYPE angle_type,      /* I: Type of angles to generate */
+    short background,           /* I: Fill value outside the scene */
+    short *sat_zenith,          /* O: Satellite zenith angle line (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angle line (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angle line (or NULL) */
+    short *solar_azimuth        /* O: Solar azimuth angle line (or NULL) */
+)
+{
+    double sat_angles[2 * IAS_ANGLE_GEN_LINE_CHUNK]; /* Viewing angles */
+    double sun_angles[2 * IAS_ANGLE_GEN_LINE_CHUNK]; /* Solar angles */
+    int first_samp;             /* First output sample in the scene */
+    int end_samp;               /* Output sample after the scene */
+    int chunk;                  /* First output sample of the chunk */
+    int index;                  /* Sample index within the chunk */
+
+    /* Find the output samples strictly inside the trim extent */
+    get_exact_samp_range(extent, num_samps, sub_sample, &first_samp,
+        &end_samp);
+
+    /* Fill the samples outside the scene */
+    for (index = 0; index < first_samp; index++)
+    {
+        store_fill(background, index, sat_zenith, sat_azimuth, solar_zenith,
+            solar_azimuth);
     }
-
-    if (avg_solar_zenith != NULL)
+    for (index = end_samp; index < num_samps; index++)
     {
-        /* Clear the sum and pixel count arrays back to 0 */
-        memset (sum, 0, angle_size * sizeof (long));
-        memset (pix_count, 0, angle_size * sizeof (ushort));
+        store_fill(background, index, sat_zenith, sat_azimuth, solar_zenith,
+            solar_azimuth);
+    }
 
-        /* Loop through the reflectance bands and compute the average of these
-           bands. Some of the pixels on the scene edge will be zero and throws
-           off the average, so don't count the zero values. */
-        printf ("Computing average for solar zenith ...\n");
-        for (band_index = 0; band_index < L8_NBANDS; band_index++)
-        {
-            /* Check if this band be added to the average */
-            if (!process_band[band_index])
-                continue;
+    for (chunk = first_samp; chunk < end_samp;
+         chunk += IAS_ANGLE_GEN_LINE_CHUNK)
+    {
+        int chunk_samps = end_samp - chunk; /* Samples in the chunk */
 
-            /* Add this band to the sum */
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    if (solar_zenith[band_index][index] != 0)
-                    {
-                        sum[index] += solar_zenith[band_index][index];
-                        pix_count[index]++;
-                    }
+        if (chunk_samps > IAS_ANGLE_GEN_LINE_CHUNK)
+            chunk_samps = IAS_ANGLE_GEN_LINE_CHUNK;
 
-            /* Release the memory */
-            free (solar_zenith[band_index]);
+        /* Calculate the satellite and solar azimuth and zenith */
+        if (calculate_line_angles(metadata, dem, line, chunk * sub_sample,
+            sub_sample, chunk_samps, band_index, angle_type, sat_angles,
+            sun_angles) != SUCCESS)
+        {
+            IAS_LOG_ERROR("Evaluating angles at line %d samples %d to %d",
+                line, chunk * sub_sample,
+                (chunk + chunk_samps - 1) * sub_sample);
+            return ERROR;
         }
 
-        /* Get the average */
-        band_index = 0;
-        for (line = 0, index = 0; line < frame[band_index].num_lines;
-             line += sub_sample)
-            for (samp = 0; samp < frame[band_index].num_samps;
-                 samp += sub_sample, index++)
-            {
-                (*avg_solar_zenith)[index] =
-                    (short) (round ((float) sum[index] / pix_count[index]));
-            }
-    }
-
-    if (avg_solar_azimuth != NULL)
-    {
-        /* Clear the sum and pixel count arrays back to 0 */
-        memset (sum, 0, angle_size * sizeof (long));
-        memset (pix_count, 0, angle_size * sizeof (ushort));
-
-        /* Loop through the reflectance bands and compute the average of these
-           bands. Some of the pixels on the scene edge will be zero and throws
-           off the average, so don't count the zero values. */
-        printf ("Computing average for solar azimuth ...\n");
-        for (band_index = 0; band_index < L8_NBANDS; band_index++)
+        for (index = 0; index < chunk_samps; index++)
         {
-            /* Check if this band be added to the average */
-            if (!process_band[band_index])
-                continue;
+            store_angles(&sat_angles[2 * index], &sun_angles[2 * index],
+                chunk + index, sat_zenith, sat_azimuth, solar_zenith,
+                solar_azimuth);
+        }
+    }
 
-            /* Add this band to the sum */
-            for (line = 0, index = 0; line < frame[band_index].num_lines;
-                 line += sub_sample)
-                for (samp = 0; samp < frame[band_index].num_samps;
-                     samp += sub_sample, index++)
-                    if (solar_azimuth[band_index][index] != 0)
-                    {
-                        sum[index] += solar_azimuth[band_index][index];
-                        pix_count[index]++;
-                    }
+    return SUCCESS;
+}
 
-            /* Release the memory */
-            free (solar_azimuth[band_index]);
-        }
+/******************************************************************************
+NAME: exact_lines_angles
 
-        /* Get the average */
-        band_index = 0;
-        for (line = 0, index = 0; line < frame[band_index].num_lines;
-             line += sub_sample)
-            for (samp = 0; samp < frame[band_index].num_samps;
-                 samp += sub_sample, index++)
-                (*avg_solar_azimuth)[index] =
-                    (short) (round ((float) sum[index] / pix_count[index]));
-    }
+PURPOSE: Generates the angles for a range of the lines of a block by
+evaluating every pixel exactly, as a chunk of espa_parallel_for.
 
-    /* Free memory */
-    free (sum);
-    free (pix_count);
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
+******************************************************************************/
+static int exact_lines_angles
+(
+    void *arg,                  /* I/O: Block being generated (ANGLE_BLOCK) */
+    int first_line,             /* I: First output line */
+    int end_line,               /* I: Output line after the range */
+    int runner                  /* I: Thread generating the lines (unused) */
+)
+{
+    ANGLE_BLOCK *block = arg;   /* Block being generated */
+    const L8_ANGLES_PARAMETERS *parameters = block->parameters;
+                                /* Generation parameters */
+    int sub_sample = parameters->sub_sample_factor; /* Subsampling factor */
+    int out_line;               /* Output line index */
 
-    /* Populate the band average frame using the first band (band 1) from the
-       band frames */
-    *avg_frame = frame[0];
-    *avg_nlines = nlines[0];
-    *avg_nsamps = nsamps[0];
+    for (out_line = first_line; out_line < end_line; out_line++)
+    {
+        int line = out_line * sub_sample;   /* L1T line */
+        size_t offset = (size_t) (out_line - block->buf_line)
+            * block->num_samps; /* Offset of the line in the buffers */
+
+        if (exact_line_angles(block->metadata, parameters->dem,
+            block->band_index, &block->trim_lut[line], line,
+            block->num_samps, sub_sample, parameters->angle_type,
+            parameters->background,
+            block->sat_zenith ? &block->sat_zenith[offset] : NULL,
+            block->sat_azimuth ? &block->sat_azimuth[offset] : NULL,
+            block->solar_zenith ? &block->solar_zenith[offset] : NULL,
+            block->solar_azimuth ? &block->solar_azimuth[offset] : NULL)
+            != SUCCESS)
+        {
+            return ERROR;
+        }
+    }  /* for out_line */
 
     return SUCCESS;
 }
 
 /******************************************************************************
-NAME: process_parameters
+NAME: exact_block_angles
 
-PURPOSE: This fuction processes the l8_angles parameters to specify which
-angles to process and some of the processing information.
+PURPOSE: Generates the angles for a block of lines in a band by evaluating
+every pixel exactly.
 
 RETURN VALUE: Type = int
     Value     Description
     -----     -----------
-    SUCCESS   The parameters were successfully processed
-    ERROR     An error occurred processing the parameters
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
+
+NOTES:
+  1. The angle buffers hold the lines from buf_line through end_line - 1.
+     The pixels outside the scene are set to the background value.
+  2. When the angles are offloaded and no DEM is used, the block is
+     evaluated on the offload device instead (see offload_block_angles).
 ******************************************************************************/
-static int process_parameters
+static int exact_block_angles
 (
-    char *angle_coeff_name,     /* I: Angle coefficient filename */
-    int subsamp_fact,           /* I: Subsample factor used when calculating
-                                      the angles (1=full resolution). OW take
-                                      every Nth sample from the line, where
-                                      N=subsamp_fact */
-    short fill_pix_value,       /* I: Fill pixel value to use (-32768:32767) */
-    char *band_list,            /* I: Band list used to calculate angles for.
-                                      "ALL" - defaults to all bands 1 - 11.
-                                      Must be comma separated with no spaces in
-                                      between.  Example: 1,2,3,4,5,6,7,8,9 */
-    L8_ANGLES_PARAMETERS *parameters /* O: Generation parameters */
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    const L8_ANGLES_PARAMETERS *parameters, /* I: Generation parameters */
+    int band_index,             /* I: Band index */
+    const IAS_MISC_LINE_EXTENT *trim_lut, /* I: Image trim lookup table */
+    int num_samps,              /* I: Samps in output angle band */
+    int first_line,             /* I: First output line of the block */
+    int end_line,               /* I: Output line after the block */
+    int buf_line,               /* I: Output line held in the first line of
+                                      the angle buffers */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth        /* O: Solar azimuth angles (or NULL) */
 )
 {
-    int local_band_count;     /* Number of bands read */
-    int local_band_numbers[IAS_MAX_NBANDS] = {ERROR}; /* Read in band numbers */
-    int index;                /* Generic loop variable */
-    int band_list_init_value; /* Band list initialize value */
-    int band_already_in_list[IAS_MAX_NBANDS];
-    int status;
+    ANGLE_BLOCK block;          /* Block split across the threads */
 
-    /* Copy the angle coefficient filename */
-    status = snprintf(parameters->metadata_filename, 
-        sizeof(parameters->metadata_filename), "%s", angle_coeff_name); 
-    if (status < 0 || status >= sizeof(parameters->metadata_filename))
+    if (metadata->offload_flag && parameters->dem == NULL)
     {
-        IAS_LOG_ERROR("Copying the metadata filename");
-        return ERROR;
-    }   
+        return offload_block_angles(metadata, parameters, band_index,
+            trim_lut, num_samps, first_line, end_line, buf_line, sat_zenith,
+            sat_azimuth, solar_zenith, solar_azimuth);
+    }
 
-    /* Parse the sub sample factor */
-    parameters->sub_sample_factor = subsamp_fact;
+    memset(&block, 0, sizeof(block));
+    block.metadata = metadata;
+    block.parameters = parameters;
+    block.band_index = band_index;
+    block.trim_lut = trim_lut;
+    block.num_samps = num_samps;
+    block.buf_line = buf_line;
+    block.sat_zenith = sat_zenith;
+    block.sat_azimuth = sat_azimuth;
+    block.solar_zenith = solar_zenith;
+    block.solar_azimuth = solar_azimuth;
+
+    /* The lines are independent, so they are split across the threads */
+    return espa_parallel_for(first_line, end_line, 1, parameters->nthreads,
+        exact_lines_angles, &block);
+}
 
-    /* Parse the fill pixel value */
-    parameters->background = fill_pix_value;
+/******************************************************************************
+NAME: offload_block_angles
 
-    /* Parse the band list */
-    band_list_init_value = 1;
-    local_band_count = 0;
+PURPOSE: Generates the angles for a block of lines in a band by evaluating
+every pixel exactly on the offload device.
 
-    /* Parse the fill pixel value and band list */
-    int offset = 0;
-    int character_count = 0;
-    int band_length = strlen(band_list);
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were generated
+    ERROR     An error occurred generating the angles
 
-    /* Check for the use of ALL in the band list.  If ALL was specified then
-       process bands 1-11.  Otherwise, parse the band list provided. */
-    if ((!strcmp (band_list, "ALL")) || (!strcmp (band_list, "all")))
+NOTES:
+  1. The block is evaluated OFFLOAD_TILE_LINES output lines at a time with
+     ias_angle_gen_calculate_tile_angles_rpc, at zero height to match
+     calculate_line_angles without a DEM.  The device writes the angles into
+     pinned tile buffers, which are then quantized into the angle buffers.
+  2. Every sample of a tile line is evaluated, which is simpler for the
+     device than the trimmed runs; the samples outside the scene are then
+     set to the background value as in exact_line_angles.
+******************************************************************************/
+static int offload_block_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    const L8_ANGLES_PARAMETERS *parameters, /* I: Generation parameters */
+    int band_index,             /* I: Band index */
+    const IAS_MISC_LINE_EXTENT *trim_lut, /* I: Image trim lookup table */
+    int num_samps,              /* I: Samps in output angle band */
+    int first_line,             /* I: First output line of the block */
+    int end_line,               /* I: Output line after the block */
+    int buf_line,               /* I: Output line held in the first line of
+                                      the angle buffers */
+    short *sat_zenith,          /* O: Satellite zenith angles (or NULL) */
+    short *sat_azimuth,         /* O: Satellite azimuth angles (or NULL) */
+    short *solar_zenith,        /* O: Solar zenith angles (or NULL) */
+    short *solar_azimuth        /* O: Solar azimuth angles (or NULL) */
+)
+{
+    int sub_sample = parameters->sub_sample_factor; /* Subsampling factor */
+    ANGLE_TYPE angle_type = parameters->angle_type; /* Angles to generate */
+    size_t tile_values = (size_t) 2 * OFFLOAD_TILE_LINES * num_samps;
+                                /* Angle values in a tile buffer */
+    double *sat_angles = NULL;  /* Satellite angles of the tile */
+    double *sun_angles = NULL;  /* Solar angles of the tile */
+    double elev = 0;            /* Elevation without a DEM */
+    int status = SUCCESS;       /* Return status */
+    int tile_line;              /* First output line of the tile */
+
+    sat_angles = ias_angle_gen_alloc_tile_buffer(tile_values);
+    sun_angles = ias_angle_gen_alloc_tile_buffer(tile_values);
+    if (sat_angles == NULL || sun_angles == NULL)
     {
-        for (index = 0; index < IAS_MAX_NBANDS; index++)
-            parameters->process_band[index] = 1;
+        IAS_LOG_ERROR("Allocating the offload tile buffers");
+        ias_angle_gen_free_tile_buffer(sat_angles);
+        ias_angle_gen_free_tile_buffer(sun_angles);
+        return ERROR;
     }
-    else
+
+    for (tile_line = first_line; tile_line < end_line;
+         tile_line += OFFLOAD_TILE_LINES)
     {
-        /* Read in the band list */
-        while (character_count <= band_length)
+        int tile_lines = end_line - tile_line; /* Lines in the tile */
+        int index;              /* Line index within the tile */
+
+        if (tile_lines > OFFLOAD_TILE_LINES)
+            tile_lines = OFFLOAD_TILE_LINES;
+
+        if (ias_angle_gen_calculate_tile_angles_rpc(metadata,
+            tile_line * sub_sample, sub_sample, tile_lines, 0, sub_sample,
+            num_samps, &elev, band_index, NULL,
+            (angle_type != AT_SOLAR) ? sat_angles : NULL,
+            (angle_type != AT_SATELLITE) ? sun_angles : NULL) != SUCCESS)
         {
-            if (sscanf(band_list, "%d%n", &local_band_numbers[local_band_count],
-                &offset) < 1)
-            {
-                IAS_LOG_ERROR("Parsing the band list");
-                return ERROR;
-            }
+            IAS_LOG_ERROR("Evaluating angles at lines %d to %d",
+                tile_line * sub_sample,
+                (tile_line + tile_lines - 1) * sub_sample);
+            status = ERROR;
+            break;
+        }
 
-            character_count += offset + 1;
-            band_list += offset + 1; /* Move pointer ahead the number length 
-                                         + 1 (for the comma) */
-            local_band_count++;
-            if (local_band_count > IAS_MAX_NBANDS)
+        for (index = 0; index < tile_lines; index++)
+        {
+            int line = (tile_line + index) * sub_sample; /* L1T line */
+            size_t offset = (size_t) (tile_line + index - buf_line)
+                * num_samps;    /* Offset of the line in the buffers */
+            size_t tile_offset = (size_t) 2 * index * num_samps;
+                                /* Offset of the line in the tile */
+            int first_samp;     /* First output sample in the scene */
+            int end_samp;       /* Output sample after the scene */
+            int samp;           /* Output sample */
+
+            get_exact_samp_range(&trim_lut[line], num_samps, sub_sample,
+                &first_samp, &end_samp);
+            for (samp = 0; samp < num_samps; samp++)
             {
-                IAS_LOG_ERROR("Too many bands specified");
-                return ERROR;   
+                if (samp < first_samp || samp >= end_samp)
+                {
+                    store_fill(parameters->background, samp,
+                        sat_zenith ? &sat_zenith[offset] : NULL,
+                        sat_azimuth ? &sat_azimuth[offset] : NULL,
+                        solar_zenith ? &solar_zenith[offset] : NULL,
+                        solar_azimuth ? &solar_azimuth[offset] : NULL);
+                    continue;
+                }
+                store_angles(&sat_angles[tile_offset + 2 * samp],
+                    &sun_angles[tile_offset + 2 * samp], samp,
+                    sat_zenith ? &sat_zenith[offset] : NULL,
+                    sat_azimuth ? &sat_azimuth[offset] : NULL,
+                    solar_zenith ? &solar_zenith[offset] : NULL,
+                    solar_azimuth ? &solar_azimuth[offset] : NULL);
             }
         }
+    }
 
-        /* Initialize band list */
-        band_list_init_value = 0;
-        for (index = 0; index < IAS_MAX_NBANDS; index++)
+    ias_angle_gen_free_tile_buffer(sat_angles);
+    ias_angle_gen_free_tile_buffer(sun_angles);
+    return status;
+}
+
+/******************************************************************************
+NAME: use_single_precision_angles
+
+PURPOSE: Determines whether the angle vectors should be converted to angles
+in single precision, as requested by the ESPA_ANGLE_PRECISION environment
+variable.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    1         ESPA_ANGLE_PRECISION is "single"
+    0         ESPA_ANGLE_PRECISION isn't set, or is anything else
+
+NOTES:
+  1. Use l8_compare_angle_precision to check the single precision angles
+     against the double precision ones for a scene.
+******************************************************************************/
+int use_single_precision_angles ()
+{
+    char *precision = getenv("ESPA_ANGLE_PRECISION"); /* requested
+                                                         precision */
+
+    return (precision != NULL && strcmp(precision, "single") == 0);
+}
+
+/******************************************************************************
+NAME: use_angle_offload
+
+PURPOSE: Determines whether the angles should be evaluated on the offload
+device (GPU), as requested by the ESPA_ANGLE_DEVICE environment variable.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    1         ESPA_ANGLE_DEVICE is "offload"
+    0         ESPA_ANGLE_DEVICE isn't set, or is anything else
+
+NOTES:
+  1. The library has to be built with ENABLE_OFFLOAD=yes for the device to be
+     used; otherwise the angles are still evaluated on the host.
+******************************************************************************/
+int use_angle_offload ()
+{
+    char *device = getenv("ESPA_ANGLE_DEVICE"); /* requested device */
+
+    return (device != NULL && strcmp(device, "offload") == 0);
+}
+
+/******************************************************************************
+NAME: get_seconds
+
+PURPOSE: Returns a monotonic time in seconds, for timing the angle
+evaluation.
+
+RETURN VALUE: Type = double
+******************************************************************************/
+static double get_seconds ()
+{
+    struct timespec now;        /* Current time */
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+/******************************************************************************
+NAME: l8_compare_angle_precision
+
+PURPOSE: Evaluates the angles of every band of a scene with the vectors
+converted to angles in double and in single precision, and reports the
+largest difference after quantizing to the output resolution, along with
+the time taken by each.
+
+RETURN VALUE: Type = int
+    Value     Description
+    -----     -----------
+    SUCCESS   The angles were compared
+    ERROR     An error occurred evaluating the angles
+
+NOTES:
+  1. Every line_step-th line of each band is evaluated at full resolution,
+     over the actual range of image data in the scene.  Both the solar and
+     the satellite angles are compared.
+  2. The differences are in hundredths of a degree, so a largest difference
+     of 0 means the single precision angles give the same output bands.
+     Differences of 1 are from angles that round either side of a
+     quantization step.
+******************************************************************************/
+int l8_compare_angle_precision
+(
+    char *angle_coeff_name, /* I: Angle coefficient filename */
+    int line_step,          /* I: Spacing of the lines compared in each
+                                  band */
+    int *max_diff,          /* O: Largest quantized difference (degrees
+                                  scaled by 100) */
+    long *num_diff,         /* O: Number of quantized angles that differ */
+    long *num_angles,       /* O: Number of quantized angles compared */
+    double *double_seconds, /* O: Time evaluating in double precision */
+    double *single_seconds  /* O: Time evaluating in single precision */
+)
+{
+    double sat_angles[2][2 * IAS_ANGLE_GEN_LINE_CHUNK]; /* Viewing angles for
+                                      each precision */
+    double sun_angles[2][2 * IAS_ANGLE_GEN_LINE_CHUNK]; /* Solar angles for
+                                      each precision */
+    double r2d = 4500.0 / atan(1.0); /* Conversion to hundredths of degrees */
+    double seconds[2] = {0.0, 0.0}; /* Time for each precision */
+    int band_index;                 /* Band index */
+    IAS_MISC_LINE_EXTENT *trim_lut[L8_NBANDS] = {NULL}; /* Image trim lookup
+                                      table for each band */
+    ANGLES_FRAME frame[L8_NBANDS];  /* Image frame info for each band */
+    L8_ANGLES_PARAMETERS parameters; /* Generation parameters */
+    IAS_ANGLE_GEN_METADATA metadata; /* Angle metadata structure */
+
+    *max_diff = 0;
+    *num_diff = 0;
+    *num_angles = 0;
+    if (line_step < 1)
+        line_step = 1;
+
+    if (init_angle_generation(angle_coeff_name, 1, 0, "ALL", 1, 0.0, 0, 1, 0,
+        NULL, &parameters, &metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return ERROR;
+    }
+
+    for (band_index = 0; band_index < L8_NBANDS; band_index++)
+    {
+        int band_max_diff = 0;      /* Largest difference in the band */
+        int line;                   /* L1T line */
+
+        if (!parameters.process_band[band_index]
+            || get_frame(&metadata, band_index, &frame[band_index])
+                != SUCCESS)
         {
-            parameters->process_band[index] = band_list_init_value;
-            band_already_in_list[index] = band_list_init_value;
+            continue;
         }
 
-        for (index = 0; index < local_band_count; index++)
+        if (get_trim_lut(&metadata, band_index, &frame[band_index],
+            trim_lut) == NULL)
         {
-            /* Convert the band number entered into a band index */
-            int temp_band_index = ias_sat_attr_convert_band_number_to_index(    
-                local_band_numbers[index]);
-            if (temp_band_index == ERROR)
-            {
-                /* No bands numbers entered, so it is an error */
-                IAS_LOG_ERROR("Illegal band number %d",
-                    local_band_numbers[index]);
-                return ERROR;
-            }
+            IAS_LOG_ERROR("Creating the scene trim lookup table for band "
+                "number %d", frame[band_index].band_number);
+            free_trim_luts(trim_lut);
+            ias_angle_gen_free(&metadata);
+            return ERROR;
+        }
 
-            /* Make sure the band isn't already in the list */
-            if (temp_band_index != ERROR)
+        for (line = 0; line < frame[band_index].num_lines; line += line_step)
+        {
+            const IAS_MISC_LINE_EXTENT *extent = &trim_lut[band_index][line];
+            int first_samp;         /* First sample in the scene */
+            int end_samp;           /* Sample after the scene */
+            int chunk;              /* First sample of the chunk */
+
+            first_samp = (extent->start_sample < 0)
+                ? 0 : extent->start_sample + 1;
+            end_samp = (extent->end_sample > frame[band_index].num_samps)
+                ? frame[band_index].num_samps : extent->end_sample;
+
+            for (chunk = first_samp; chunk < end_samp;
+                 chunk += IAS_ANGLE_GEN_LINE_CHUNK)
             {
-                if (!band_already_in_list[temp_band_index])
+                int chunk_samps = end_samp - chunk; /* Samples in the chunk */
+                int single;         /* Single precision flag */
+                int index;          /* Angle index */
+
+                if (chunk_samps > IAS_ANGLE_GEN_LINE_CHUNK)
+                    chunk_samps = IAS_ANGLE_GEN_LINE_CHUNK;
+
+                for (single = 0; single < 2; single++)
                 {
-                    /* Put band in list and flag that it has been added to
-                       the list */
-                    parameters->process_band[temp_band_index] = 1;
-                    band_already_in_list[temp_band_index] += 1;
+                    double start = get_seconds();  /* Start time */
+
+                    metadata.single_precision_flag = single;
+                    if (calculate_line_angles(&metadata, NULL, line, chunk,
+                        1, chunk_samps, band_index, AT_BOTH,
+                        sat_angles[single], sun_angles[single]) != SUCCESS)
+                    {
+                        IAS_LOG_ERROR("Evaluating angles in band %d at line "
+                            "%d", frame[band_index].band_number, line);
+                        free_trim_luts(trim_lut);
+                        ias_angle_gen_free(&metadata);
+                        return ERROR;
+                    }
+                    seconds[single] += get_seconds() - start;
                 }
-                else if (band_already_in_list[temp_band_index] == 1)
-                {
-                     /* Only print the warning message once for each band */
-                     band_already_in_list[temp_band_index] += 1;
 
-                     IAS_LOG_WARNING("Warning: Band number %d appears multiple "
-                         "times in the BAND_LIST, only the first one was used",
-                         local_band_numbers[index]);
+                /* Compare the quantized angles */
+                for (index = 0; index < 2 * chunk_samps; index++)
+                {
+                    int sat_diff = abs((int)round(r2d * sat_angles[0][index])
+                        - (int)round(r2d * sat_angles[1][index]));
+                    int sun_diff = abs((int)round(r2d * sun_angles[0][index])
+                        - (int)round(r2d * sun_angles[1][index]));
+
+                    *num_diff += (sat_diff != 0) + (sun_diff != 0);
+                    if (sat_diff > band_max_diff)
+                        band_max_diff = sat_diff;
+                    if (sun_diff > band_max_diff)
+                        band_max_diff = sun_diff;
                 }
+                *num_angles += 4 * chunk_samps;
             }
         }
+
+        IAS_LOG_INFO("Band %d: largest single precision angle difference "
+            "%d (degrees * 100)", frame[band_index].band_number,
+            band_max_diff);
+        if (band_max_diff > *max_diff)
+            *max_diff = band_max_diff;
     }
 
+    free_trim_luts(trim_lut);
+    ias_angle_gen_free(&metadata);
+
+    *double_seconds = seconds[0];
+    *single_seconds = seconds[1];
+
     return SUCCESS;
 }
@@ -16,6 +16,10 @@
 #define L8_NBANDS 11
 #define ANGLE_SCALE 100
 
+/* Number of output lines in each block of angles passed to the line sink of
+   l8_per_pixel_angles_lines */
+#define L8_ANGLE_BLOCK_LINES 64
+
 typedef enum angle_type
 {
     AT_UNKNOWN = 0, /* Unknown angle type */
@@ -36,6 +40,27 @@ typedef struct angles_frame
     IAS_PROJECTION projection; /* Projection information */ 
 } ANGLES_FRAME;
 
+/* DEM providing the heights of the angles (see l8_angles_open_dem) */
+typedef struct l8_angles_dem L8_ANGLES_DEM;
+
+/* Angle metadata of a scene held for point queries (see
+   l8_angles_open_query) */
+typedef struct l8_angles_query L8_ANGLES_QUERY;
+
+/* Pixel where l8_angles_query_points evaluates the angles */
+typedef struct l8_angle_point
+{
+    int band_number;        /* I: Band number of the pixel */
+    int line;               /* I: L1T line of the pixel in the band */
+    int samp;               /* I: L1T sample of the pixel in the band */
+    int in_scene;           /* O: Flag that the pixel is in the active image
+                                  area of the band */
+    double solar_zenith;    /* O: Solar zenith angle (degrees) */
+    double solar_azimuth;   /* O: Solar azimuth angle (degrees) */
+    double sat_zenith;      /* O: Satellite zenith angle (degrees) */
+    double sat_azimuth;     /* O: Satellite azimuth angle (degrees) */
+} L8_ANGLE_POINT;
+
 /* Holds all the information needed to run L8 Angles */
 typedef struct l8_angles_parameters
 {
@@ -45,6 +70,19 @@ typedef struct l8_angles_parameters
     ANGLE_TYPE angle_type;       /* Type of angles to be generated */
     int sub_sample_factor;       /* Sub-sampling factor to be used */
     short background;            /* Background value used for fill pixels */
+    int grid_spacing;            /* Spacing of the exactly evaluated angle
+                                    grid in output pixels (1=every pixel is
+                                    evaluated exactly) */
+    double max_grid_error;       /* Maximum interpolation error allowed at
+                                    the center of a grid cell (degrees) */
+    int verify_grid_flag;        /* Flag to compare interpolated angles
+                                    against the exact angles */
+    int nthreads;                /* Number of threads used to generate the
+                                    angle lines */
+    int share_band_flag;         /* Flag to share the angle arrays between
+                                    bands with the same geometry */
+    L8_ANGLES_DEM *dem;          /* DEM giving the height of each pixel, or
+                                    NULL to use zero height */
 } L8_ANGLES_PARAMETERS;
 
 /***************************** PROTOTYPES START *******************************/
@@ -56,7 +94,7 @@ int l8_per_pixel_angles
                                   sample from the line, where N=subsamp_fact */
     short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
     char *band_list,        /* I: Band list used to calculate angles for.
-                                  "ALL" - defaults to all bands 1 - 11.
+                                  "ALL" - defaults to all satellite bands.
                                   Must be comma separated with no spaces in
                                   between.  Example: 1,2,3,4,5,6,7,8,9
                                   The solar/sat_zenith/azimuth arrays should
@@ -78,6 +116,49 @@ int l8_per_pixel_angles
     int nsamps[L8_NBANDS]   /* O: Number of samples for each band */
 );
 
+int l8_per_pixel_angles_grid
+(
+    char *angle_coeff_name, /* I: Angle coefficient filename */
+    int subsamp_fact,       /* I: Subsample factor used when calculating the
+                                  angles (1=full resolution). OW take every Nth
+                                  sample from the line, where N=subsamp_fact */
+    short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
+    char *band_list,        /* I: Band list used to calculate angles for.
+                                  "ALL" - defaults to all satellite bands.
+                                  Must be comma separated with no spaces in
+                                  between.  Example: 1,2,3,4,5,6,7,8,9 */
+    int grid_spacing,       /* I: Spacing, in output pixels, of the grid where
+                                  the angles are evaluated exactly and then
+                                  interpolated between (1=evaluate every
+                                  pixel exactly) */
+    double max_grid_error,  /* I: Maximum interpolation error at the center of
+                                  a grid cell (degrees); cells over this are
+                                  evaluated exactly */
+    int verify_grid_flag,   /* I: If set, also evaluate the interpolated pixels
+                                  exactly and report the maximum error */
+    int nthreads,           /* I: Number of threads to use for generating the
+                                  angle lines (only used if built with
+                                  threading enabled) */
+    int share_band_flag,    /* I: If set, share the solar angles within each
+                                  resolution group and the satellite angles
+                                  between bands with identical geometry */
+    ANGLES_FRAME frame[L8_NBANDS],   /* O: Image frame info for each band */
+    short *solar_zenith[L8_NBANDS],  /* O: Array of pointers for the solar
+                                           zenith angle array, one per band
+                                           (if NULL, don't process) */
+    short *solar_azimuth[L8_NBANDS], /* O: Array of pointers for the solar
+                                           azimuth angle array, one per band
+                                           (if NULL, don't process) */
+    short *sat_zenith[L8_NBANDS],    /* O: Array of pointers for the satellite
+                                           zenith angle array, one per band
+                                           (if NULL, don't process)*/
+    short *sat_azimuth[L8_NBANDS],   /* O: Array of pointers for the satellite
+                                           azimuth angle array, one per band
+                                           (if NULL, don't process)*/
+    int nlines[L8_NBANDS],  /* O: Number of lines for each band */
+    int nsamps[L8_NBANDS]   /* O: Number of samples for each band */
+);
+
 int l8_per_pixel_avg_refl_angles
 (
     char *angle_coeff_name, /* I: Angle coefficient filename */
@@ -85,6 +166,9 @@ int l8_per_pixel_avg_refl_angles
                                   angles (1=full resolution). OW take every Nth
                                   sample from the line, where N=subsamp_fact */
     short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
+    int share_band_flag,    /* I: If set, share the angles between the
+                                  reflectance bands (see
+                                  l8_per_pixel_angles_grid) */
     ANGLES_FRAME *avg_frame,  /* O: Image frame info for the scene */
     short **avg_solar_zenith, /* O: Addr of pointer for the average solar zenith
                                     angle array (if NULL, don't process),
@@ -104,9 +188,133 @@ int l8_per_pixel_avg_refl_angles
                                     the subsample factor */
 );
 
+/* Receives a block of angle lines of a band from l8_per_pixel_angles_lines.
+   The angle pointers are NULL for the angles that aren't generated.  Returns
+   SUCCESS or ERROR; an error stops the angle generation. */
+typedef int (*L8_ANGLES_LINE_SINK)
+(
+    void *sink_data,          /* I/O: Data passed through to the sink */
+    int band_index,           /* I: Band index of the lines */
+    int band_lines,           /* I: Number of lines in the band */
+    int first_line,           /* I: First line of the block */
+    int num_lines,            /* I: Number of lines in the block */
+    int num_samps,            /* I: Number of samples in each line */
+    const short *solar_zenith,  /* I: Solar zenith angles for the block */
+    const short *solar_azimuth, /* I: Solar azimuth angles for the block */
+    const short *sat_zenith,  /* I: Satellite zenith angles for the block */
+    const short *sat_azimuth  /* I: Satellite azimuth angles for the block */
+);
+
+int l8_per_pixel_angles_lines
+(
+    char *angle_coeff_name, /* I: Angle coefficient filename */
+    int subsamp_fact,       /* I: Subsample factor used when calculating the
+                                  angles (1=full resolution). OW take every Nth
+                                  sample from the line, where N=subsamp_fact */
+    short fill_pix_value,   /* I: Fill pixel value to use (-32768:32767) */
+    char *band_list,        /* I: Band list used to calculate angles for.
+                                  "ALL" - defaults to all satellite bands.
+                                  Must be comma separated with no spaces in
+                                  between.  Example: 1,2,3,4,5,6,7,8,9 */
+    int grid_spacing,       /* I: Spacing, in output pixels, of the grid where
+                                  the angles are evaluated exactly and then
+                                  interpolated between (1=evaluate every
+                                  pixel exactly) */
+    double max_grid_error,  /* I: Maximum interpolation error at the center of
+                                  a grid cell (degrees) */
+    int verify_grid_flag,   /* I: If set, also evaluate the interpolated pixels
+                                  exactly and report the maximum error */
+    int nthreads,           /* I: Number of threads to use for generating the
+                                  angle lines */
+    int share_band_flag,    /* I: If set, share the angles between bands with
+                                  the same geometry */
+    ANGLE_TYPE angle_type,  /* I: Angles to generate (solar, satellite or
+                                  both) */
+    const char *dem_filename, /* I: DEM giving the height of each pixel, or
+                                  NULL to use zero height */
+    L8_ANGLES_LINE_SINK sink, /* I: Routine receiving the angle lines */
+    void *sink_data,        /* I/O: Data passed through to the sink */
+    ANGLES_FRAME frame[L8_NBANDS], /* O: Image frame info for each band */
+    int nlines[L8_NBANDS],  /* O: Number of lines for each band, based on the
+                                  subsample factor */
+    int nsamps[L8_NBANDS]   /* O: Number of samples for each band, based on the
+                                  subsample factor */
+);
+
+L8_ANGLES_QUERY *l8_angles_open_query
+(
+    const char *angle_coeff_name, /* I: Angle coefficient filename */
+    const char *dem_filename    /* I: DEM giving the height of each pixel, or
+                                      NULL to use zero height */
+);
+
+void l8_angles_close_query
+(
+    L8_ANGLES_QUERY *query      /* I/O: Query handle to close (or NULL) */
+);
+
+int l8_angles_query_points
+(
+    L8_ANGLES_QUERY *query,     /* I: Query handle of the scene */
+    ANGLE_TYPE angle_type,      /* I: Angles to evaluate (solar, satellite or
+                                      both) */
+    int num_points,             /* I: Number of points */
+    L8_ANGLE_POINT *points      /* I/O: Points, with the angles set on
+                                        return */
+);
+
+int l8_compare_angle_precision
+(
+    char *angle_coeff_name, /* I: Angle coefficient filename */
+    int line_step,          /* I: Spacing of the lines compared in each
+                                  band */
+    int *max_diff,          /* O: Largest quantized difference (degrees
+                                  scaled by 100) */
+    long *num_diff,         /* O: Number of quantized angles that differ */
+    long *num_angles,       /* O: Number of quantized angles compared */
+    double *double_seconds, /* O: Time evaluating in double precision */
+    double *single_seconds  /* O: Time evaluating in single precision */
+);
+
+int use_single_precision_angles ();
+
+int use_angle_offload ();
+
+void l8_free_per_pixel_angles
+(
+    short *angles[L8_NBANDS]  /* I/O: Array of pointers for the angle arrays,
+                                      one per band (NULL if not allocated).
+                                      Set to NULL on return. */
+);
+
+L8_ANGLES_DEM *l8_angles_open_dem
+(
+    const char *dem_filename    /* I: DEM image filename */
+);
+
+void l8_angles_close_dem
+(
+    L8_ANGLES_DEM *dem          /* I/O: DEM to close (or NULL) */
+);
+
+int l8_angles_dem_heights
+(
+    L8_ANGLES_DEM *dem,         /* I/O: DEM */
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    int band_index,             /* I: Band index */
+    int line,                   /* I: L1T line coordinate */
+    int first_samp,             /* I: L1T sample coordinate of the first
+                                      sample */
+    int samp_step,              /* I: Spacing of the samples */
+    int num_samps,              /* I: Number of samples */
+    double *heights             /* O: Height of each sample (meters) */
+);
+
 int calculate_angles
 (
     const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */ 
+    L8_ANGLES_DEM *dem,                     /* I: DEM for the heights, or NULL
+                                                  for zero height */
     int line,                               /* I: L1T line coordinate */
     int samp,                               /* I: L1T sample coordinate */
     int band_index,                         /* I: Spectral band number */
@@ -115,6 +323,34 @@ int calculate_angles
     double *sun_angles                      /* O: Solar angles */
 );
 
+int calculate_line_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */
+    L8_ANGLES_DEM *dem,                     /* I: DEM for the heights, or NULL
+                                                  for zero height */
+    int line,                               /* I: L1T line coordinate */
+    int first_samp,                         /* I: L1T sample coordinate of the
+                                                  first sample */
+    int samp_step,                          /* I: Spacing of the samples */
+    int num_samps,                          /* I: Number of samples */
+    int band_index,                         /* I: Spectral band number */
+    ANGLE_TYPE angle_type,                  /* I: Type of angles to generate */
+    double *sat_angles,                     /* O: Satellite angles (radians)
+                                                  for each sample */
+    double *sun_angles                      /* O: Solar angles (radians) for
+                                                  each sample */
+);
+
+int get_sca_key
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */ 
+    L8_ANGLES_DEM *dem,                     /* I: DEM for the heights, or NULL
+                                                  for zero height */
+    int line,                               /* I: L1T line coordinate */
+    int samp,                               /* I: L1T sample coordinate */
+    int band_index                          /* I: Band index */
+);
+
 const double *get_active_lines
 (
     const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */ 
@@ -134,6 +370,27 @@ int get_frame
     ANGLES_FRAME *frame                     /* O: Image frame info */
 );
 
+int same_band_resolution
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */ 
+    int band_index,                         /* I: Band index */
+    int other_index                         /* I: Band index to compare to */
+);
+
+int same_active_area
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */ 
+    int band_index,                         /* I: Band index */
+    int other_index                         /* I: Band index to compare to */
+);
+
+int same_satellite_angles
+(
+    const IAS_ANGLE_GEN_METADATA *metadata, /* I: Angle metadata structure */ 
+    int band_index,                         /* I: Band index */
+    int other_index                         /* I: Band index to compare to */
+);
+
 int read_parameters
 (
     const char *parameter_filename,       /* I: Parameter file name */
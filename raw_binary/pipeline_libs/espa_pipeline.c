@@ -0,0 +1,1688 @@
+/*****************************************************************************
+FILE: espa_pipeline.c
+
+PURPOSE: Contains functions for running the Level-1 processing stages
+(conversion, band clipping, angle bands, land/water mask, date bands, and
+export) on a single, in-memory copy of the ESPA XML metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each of the stand-alone tools parses the XML file, adds its bands, and
+     rewrites the XML file.  The pipeline parses (or generates) the metadata
+     once, the stages add their bands to the live metadata, and the XML file
+     is written and validated once before export or when the pipeline is
+     written.
+  2. The exports use the format conversion libraries, which read the XML
+     file, so the metadata is written before each export.
+  3. The land/water mask stage is in pipeline_land_water_mask.c, since the
+     IAS geo definitions of the land/water mask library conflict with those
+     of the per-pixel angles library.
+  4. The stages of a stage graph run as tasks of the shared task runtime
+     (see espa_task.h), one level of the graph at a time: every stage whose
+     inputs are ready runs concurrently with the others, and once they are
+     all done their bands are merged into the metadata one stage after the
+     other, in the order the stages were added.  So no stage reads the
+     metadata while it is being changed.  Each stage commits its bands to
+     the band registry of the level as soon as it's done (see
+     band_registry.h), without waiting on the other stages, and the bands
+     are merged from the registry with the stage index as their order key.
+  5. The provenance key of a stage digests its name and parameters, the
+     library version, and each band it may read: the bands which no stage
+     wrote, and those written by the stages it depends on.  A band is
+     digested by its name, file name and provenance key, along with its
+     checksum if it has one (see raw_binary_checksum.h), or else the size
+     and modification time of its file.  Bands written by unrelated stages
+     aren't digested, so a new version of one stage doesn't invalidate the
+     others.
+  6. See note 3 of espa_pipeline.h for the low-latency mode.  The bands of
+     a stage are published by the task of the stage, before they're
+     committed to the band registry, so publishing them doesn't wait for
+     the other stages of the level.
+*****************************************************************************/
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "espa_common.h"
+#include "espa_pipeline.h"
+#include "espa_task.h"
+#include "espa_profile.h"
+#include "band_registry.h"
+#include "raw_binary_shm.h"
+#include "convert_lpgs_to_espa.h"
+#include "convert_espa_to_gtif.h"
+#include "convert_espa_to_raw_binary_bip.h"
+#include "clip_band_misalignment.h"
+#include "generate_date_bands.h"
+#include "angle_bands.h"
+
+/* Local defines */
+#define FNV_OFFSET_BASIS 14695981039346656037ULL /* 64-bit FNV-1a basis */
+#define FNV_PRIME 1099511628211ULL  /* 64-bit FNV-1a prime */
+
+/* Serializes the band_ready callbacks of the stages */
+static pthread_mutex_t publish_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+MODULE:  use_pipeline_incremental
+
+PURPOSE: Determines if incremental mode was requested via the
+ESPA_INCREMENTAL environment variable.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_INCREMENTAL is "on"
+false        ESPA_INCREMENTAL isn't set, or is anything else
+
+NOTES:
+******************************************************************************/
+bool use_pipeline_incremental ()
+{
+    char *incremental = getenv (PIPELINE_INCREMENTAL_ENV);  /* requested
+                                                               mode */
+
+    return (incremental != NULL && !strcmp (incremental, "on"));
+}
+
+
+/******************************************************************************
+MODULE:  use_pipeline_low_latency
+
+PURPOSE: Determines if low-latency mode was requested via the
+ESPA_LOW_LATENCY environment variable.
+
+RETURN VALUE:
+Type = bool
+Value        Description
+-----        -----------
+true         ESPA_LOW_LATENCY is "on"
+false        ESPA_LOW_LATENCY isn't set, or is anything else
+
+NOTES:
+******************************************************************************/
+bool use_pipeline_low_latency ()
+{
+    char *low_latency = getenv (PIPELINE_LOW_LATENCY_ENV);  /* requested
+                                                               mode */
+
+    return (low_latency != NULL && !strcmp (low_latency, "on"));
+}
+
+
+/******************************************************************************
+MODULE:  start_low_latency
+
+PURPOSE: Sets up the low-latency processing of a scene, and returns the number
+of threads the band conversion should use.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+>= 1            Number of threads for converting the bands
+
+NOTES:
+  1. The bands are kept in shared memory unless ESPA_SHM_BANDS is already
+     set.  The limit of the shared memory is read once per process, so this
+     has no effect in a process which has already read or written a band.
+  2. The conversion uses every thread of the task runtime, or the number
+     of threads asked for if that's more.
+******************************************************************************/
+static int start_low_latency
+(
+    int nthreads                  /* I: number of threads asked for */
+)
+{
+    setenv (RB_SHM_ENV, "on", 0);
+
+    if (nthreads < espa_task_nthreads ())
+        nthreads = espa_task_nthreads ();
+
+    return (nthreads);
+}
+
+
+/******************************************************************************
+MODULE:  prefetch_pipeline_file
+
+PURPOSE: Starts reading a file into the page cache in the background.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The file is read ahead by the kernel (POSIX_FADV_WILLNEED), which
+     returns at once, so the reads of the stages find the data in memory
+     rather than waiting on the disk.  Files which can't be opened are
+     skipped.
+******************************************************************************/
+static void prefetch_pipeline_file
+(
+    const char *file_name         /* I: name of the file */
+)
+{
+    int fd;                       /* file descriptor of the file */
+
+    fd = open (file_name, O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+    close (fd);
+}
+
+
+/******************************************************************************
+MODULE:  prefetch_lpgs_files
+
+PURPOSE: Prefetches the GeoTIFF files of an LPGS product.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The GeoTIFF files are those named after the MTL file, the product ID
+     followed by the band, in the directory of the MTL file.
+******************************************************************************/
+static void prefetch_lpgs_files
+(
+    const char *lpgs_mtl_file     /* I: input LPGS MTL metadata filename */
+)
+{
+    char pattern[STR_SIZE];       /* pattern of the GeoTIFF files */
+    char *cptr = NULL;            /* pointer to _MTL.txt in the pattern */
+    size_t i;                     /* looping variable for the files */
+    glob_t files;                 /* GeoTIFF files of the product */
+
+    snprintf (pattern, sizeof (pattern) - 16, "%s", lpgs_mtl_file);
+    cptr = strrchr (pattern, '_');
+    if (cptr == NULL)
+        return;
+    strcpy (cptr, "_*.[Tt][Ii][Ff]");
+
+    if (glob (pattern, 0, NULL, &files) != 0)
+        return;
+    for (i = 0; i < files.gl_pathc; i++)
+        prefetch_pipeline_file (files.gl_pathv[i]);
+    globfree (&files);
+}
+
+
+/******************************************************************************
+MODULE:  get_absolute_name
+
+PURPOSE: Gets the absolute name of a file, as the shared memory bands are
+registered under.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The name is too long, or the current directory is unknown
+SUCCESS         The absolute name was set
+
+NOTES:
+******************************************************************************/
+static int get_absolute_name
+(
+    const char *file_name,        /* I: name of the file */
+    char *path                    /* O: absolute name; STR_SIZE characters */
+)
+{
+    char cwd[PATH_MAX];           /* current directory */
+    int count;                    /* number of chars copied in snprintf */
+
+    if (file_name[0] == '/')
+        count = snprintf (path, STR_SIZE, "%s", file_name);
+    else if (getcwd (cwd, sizeof (cwd)) != NULL)
+        count = snprintf (path, STR_SIZE, "%s/%s", cwd, file_name);
+    else
+        return (ERROR);
+
+    if (count < 0 || count >= STR_SIZE)
+        return (ERROR);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  publish_pipeline_bands
+
+PURPOSE: Publishes the bands of a stage in low-latency mode: the bands still
+in shared memory are written to their band files, and each band is passed to
+the band_ready callback of the pipeline.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing a band to disk
+SUCCESS         Successfully published the bands
+
+NOTES:
+  1. The bands published are those of the metadata whose provenance is the
+     stage; an empty stage publishes the bands no stage wrote.
+  2. The first band published marks the first-band milestone of the
+     profile.
+******************************************************************************/
+static int publish_pipeline_bands
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    Espa_internal_meta_t *meta,   /* I: metadata holding the bands */
+    const char *stage             /* I: name of the stage */
+)
+{
+    char FUNC_NAME[] = "publish_pipeline_bands";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char path[STR_SIZE];          /* absolute name of the band file */
+    int i;                        /* looping variable for the bands */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+
+    for (i = 0; i < meta->nbands; i++)
+    {
+        bmeta = &meta->band[i];
+        if (strcmp (bmeta->provenance.stage, stage))
+            continue;
+
+        if (use_raw_binary_shm () && (get_absolute_name (bmeta->file_name,
+            path) != SUCCESS || flush_raw_binary_shm (path, false)
+            != SUCCESS))
+        {
+            sprintf (errmsg, "Writing band %s to disk", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (pipeline->band_ready != NULL)
+        {
+            pthread_mutex_lock (&publish_lock);
+            pipeline->band_ready (pipeline->band_ready_arg, bmeta);
+            pthread_mutex_unlock (&publish_lock);
+        }
+        espa_profile_mark (ESPA_PROFILE_FIRST_BAND);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_espa_pipeline
+
+PURPOSE: Opens a pipeline for an existing ESPA scene by validating and parsing
+the XML metadata file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the XML metadata file
+SUCCESS         Successfully opened the pipeline
+
+NOTES:
+  1. close_espa_pipeline needs to be called to free the metadata.
+******************************************************************************/
+int open_espa_pipeline
+(
+    char *espa_xml_file,          /* I: input ESPA XML metadata filename */
+    Espa_pipeline_t *pipeline     /* O: pipeline handle for the scene */
+)
+{
+    char FUNC_NAME[] = "open_espa_pipeline";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int count;                /* number of chars copied in snprintf */
+    int i;                    /* looping variable for the bands */
+
+    /* Initialize the pipeline */
+    init_metadata_struct (&pipeline->metadata);
+    pipeline->modified = false;
+    pipeline->incremental = use_pipeline_incremental ();
+    pipeline->low_latency = use_pipeline_low_latency ();
+    pipeline->source_published = false;
+    pipeline->band_ready = NULL;
+    pipeline->band_ready_arg = NULL;
+    count = snprintf (pipeline->xml_file, sizeof (pipeline->xml_file), "%s",
+        espa_xml_file);
+    if (count < 0 || count >= sizeof (pipeline->xml_file))
+    {
+        sprintf (errmsg, "Overflow of pipeline->xml_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &pipeline->metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Start reading the bands the stages will read */
+    if (pipeline->low_latency)
+    {
+        start_low_latency (1);
+        for (i = 0; i < pipeline->metadata.nbands; i++)
+            prefetch_pipeline_file (pipeline->metadata.band[i].file_name);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_lpgs_pipeline
+
+PURPOSE: Opens a pipeline for a new ESPA scene by converting the LPGS GeoTIFF
+files (and associated MTL file) to the ESPA internal raw binary format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the LPGS product
+SUCCESS         Successfully opened the pipeline
+
+NOTES:
+  1. The XML metadata file isn't written until write_pipeline_metadata or one
+     of the exports is called.
+  2. close_espa_pipeline needs to be called to free the metadata.
+******************************************************************************/
+int open_lpgs_pipeline
+(
+    char *lpgs_mtl_file,          /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file,          /* I: output ESPA XML metadata filename */
+    bool del_src,                 /* I: should the source .tif files be
+                                        removed after conversion? */
+    int nthreads,                 /* I: number of threads to use for
+                                        converting the bands */
+    Espa_pipeline_t *pipeline     /* O: pipeline handle for the scene */
+)
+{
+    char FUNC_NAME[] = "open_lpgs_pipeline";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int count;                /* number of chars copied in snprintf */
+
+    /* Initialize the pipeline */
+    init_metadata_struct (&pipeline->metadata);
+    pipeline->modified = true;
+    pipeline->incremental = use_pipeline_incremental ();
+    pipeline->low_latency = use_pipeline_low_latency ();
+    pipeline->source_published = false;
+    pipeline->band_ready = NULL;
+    pipeline->band_ready_arg = NULL;
+    count = snprintf (pipeline->xml_file, sizeof (pipeline->xml_file), "%s",
+        espa_xml_file);
+    if (count < 0 || count >= sizeof (pipeline->xml_file))
+    {
+        sprintf (errmsg, "Overflow of pipeline->xml_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (pipeline->low_latency)
+    {
+        nthreads = start_low_latency (nthreads);
+        prefetch_lpgs_files (lpgs_mtl_file);
+    }
+
+    /* Convert the LPGS bands, keeping the metadata in memory */
+    if (convert_lpgs_to_espa_meta (lpgs_mtl_file, NULL, del_src, nthreads,
+        &pipeline->metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  open_lpgs_bundle_pipeline
+
+PURPOSE: Opens a pipeline for a new ESPA scene by converting the LPGS GeoTIFF
+files (and associated MTL file) read directly from an LPGS product bundle
+(.tar.gz) to the ESPA internal raw binary format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the LPGS product
+SUCCESS         Successfully opened the pipeline
+
+NOTES:
+  1. The XML metadata file isn't written until write_pipeline_metadata or one
+     of the exports is called.
+  2. close_espa_pipeline needs to be called to free the metadata.
+  3. Only the MTL file and the bands are read from the bundle, so stages
+     needing other files of the LPGS product (such as the angle coefficient
+     file for the angle bands) need those files on disk.
+******************************************************************************/
+int open_lpgs_bundle_pipeline
+(
+    char *lpgs_bundle_file,       /* I: input LPGS product bundle (.tar.gz) */
+    char *espa_xml_file,          /* I: output ESPA XML metadata filename */
+    bool del_src,                 /* I: should the bundle be removed after
+                                        conversion? */
+    int nthreads,                 /* I: number of threads to use for
+                                        converting the bands */
+    Espa_pipeline_t *pipeline     /* O: pipeline handle for the scene */
+)
+{
+    char FUNC_NAME[] = "open_lpgs_bundle_pipeline";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int count;                /* number of chars copied in snprintf */
+
+    /* Initialize the pipeline */
+    init_metadata_struct (&pipeline->metadata);
+    pipeline->modified = true;
+    pipeline->incremental = use_pipeline_incremental ();
+    pipeline->low_latency = use_pipeline_low_latency ();
+    pipeline->source_published = false;
+    pipeline->band_ready = NULL;
+    pipeline->band_ready_arg = NULL;
+    count = snprintf (pipeline->xml_file, sizeof (pipeline->xml_file), "%s",
+        espa_xml_file);
+    if (count < 0 || count >= sizeof (pipeline->xml_file))
+    {
+        sprintf (errmsg, "Overflow of pipeline->xml_file string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (pipeline->low_latency)
+    {
+        nthreads = start_low_latency (nthreads);
+        prefetch_pipeline_file (lpgs_bundle_file);
+    }
+
+    /* Convert the LPGS bands from the bundle, keeping the metadata in
+       memory */
+    if (convert_lpgs_bundle_to_espa_meta (lpgs_bundle_file, NULL, del_src,
+        nthreads, &pipeline->metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  clip_pipeline_bands
+
+PURPOSE: Clips the band misalignment for the scene in the pipeline.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error clipping the bands
+SUCCESS         Successfully clipped the bands
+
+NOTES:
+  1. The band data is changed in place, and the valid mask of the scene is
+     added to the metadata.
+  2. In incremental mode the bands of a scene which already has a valid mask
+     were clipped by an earlier run, and are left as they are, so the stages
+     reading them aren't invalidated by rewriting them.
+******************************************************************************/
+int clip_pipeline_bands
+(
+    Espa_pipeline_t *pipeline     /* I/O: pipeline handle for the scene */
+)
+{
+    char FUNC_NAME[] = "clip_pipeline_bands";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    int status;                       /* return status */
+
+    if (pipeline->incremental && strcmp (pipeline->metadata.global.valid_mask,
+        ESPA_STRING_META_FILL))
+    {
+        sprintf (errmsg, "The bands were already clipped; skipping the "
+            "clipping");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (SUCCESS);
+    }
+
+    status = clip_band_misalignment_meta (&pipeline->metadata);
+    if (status == SUCCESS && strcmp (pipeline->metadata.global.valid_mask,
+        ESPA_STRING_META_FILL))
+        pipeline->modified = true;
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  pipeline_angle_stage
+
+PURPOSE: Creates the solar and view/satellite per-pixel angle bands for the
+scene in the pipeline, as a stage function.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the angle bands
+SUCCESS         Successfully created the angle bands
+
+NOTES:
+  1. The angle coefficient file and output band names come from the XML
+     filename of the pipeline.
+  2. In low-latency mode the angles are generated with every thread of the
+     task runtime, if that's more than the options ask for.
+******************************************************************************/
+int pipeline_angle_stage
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: angle options
+                                        (Pipeline_angle_options_t *) */
+    Espa_internal_meta_t *out_meta /* O: metadata of the angle bands */
+)
+{
+    Pipeline_angle_options_t *opts = arg;  /* angle options */
+    int nthreads = opts->nthreads;  /* threads generating the angles */
+
+    if (pipeline->low_latency && nthreads < espa_task_nthreads ())
+        nthreads = espa_task_nthreads ();
+
+    return (create_angle_bands (pipeline->xml_file, &pipeline->metadata,
+        opts->band_avg, 1, opts->grid_spacing, opts->max_grid_error,
+        opts->verify_grid, nthreads, opts->share_bands,
+        (char *) opts->dem_file, out_meta));
+}
+
+
+/******************************************************************************
+MODULE:  add_pipeline_angle_bands
+
+PURPOSE: Creates the solar and view/satellite per-pixel angle bands for the
+scene in the pipeline and adds them to the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the angle bands
+SUCCESS         Successfully created the angle bands
+
+NOTES:
+  1. The angle coefficient file and output band names come from the XML
+     filename of the pipeline.
+******************************************************************************/
+int add_pipeline_angle_bands
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    bool band_avg,                /* I: should the reflectance band average
+                                        be processed? */
+    int grid_spacing,             /* I: spacing of the exactly evaluated
+                                        angle grid */
+    double max_grid_error,        /* I: maximum angle grid interpolation
+                                        error (degrees) */
+    bool verify_grid,             /* I: should the interpolated angles be
+                                        verified? */
+    int nthreads,                 /* I: number of threads for generating the
+                                        angles */
+    bool share_bands,             /* I: should the angles be shared between
+                                        bands? */
+    const char *dem_file          /* I: DEM giving the terrain height of each
+                                        pixel, or NULL to use zero height */
+)
+{
+    Pipeline_angle_options_t opts;    /* angle options */
+
+    opts.band_avg = band_avg;
+    opts.grid_spacing = grid_spacing;
+    opts.max_grid_error = max_grid_error;
+    opts.verify_grid = verify_grid;
+    opts.nthreads = nthreads;
+    opts.share_bands = share_bands;
+    opts.dem_file = dem_file;
+
+    return (run_pipeline_stage (pipeline, PIPELINE_ANGLE_STAGE, NULL,
+        pipeline_angle_stage, &opts));
+}
+
+
+/******************************************************************************
+MODULE:  pipeline_date_stage
+
+PURPOSE: Creates the date/year bands for the scene in the pipeline, as a
+stage function.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the date bands
+SUCCESS         Successfully created the date bands
+
+NOTES:
+******************************************************************************/
+int pipeline_date_stage
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: should the fill pixels in band 1 be
+                                        set to fill in the date bands?
+                                        (bool *) */
+    Espa_internal_meta_t *out_meta /* O: metadata of the date bands */
+)
+{
+    bool *use_fill_mask = arg;        /* use the band 1 fill? */
+
+    return (create_date_bands (&pipeline->metadata, *use_fill_mask,
+        out_meta));
+}
+
+
+/******************************************************************************
+MODULE:  add_pipeline_date_bands
+
+PURPOSE: Creates the date/year bands for the scene in the pipeline and adds
+them to the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the date bands
+SUCCESS         Successfully created the date bands
+
+NOTES:
+******************************************************************************/
+int add_pipeline_date_bands
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    bool use_fill_mask            /* I: should the fill pixels in band 1 be
+                                        set to fill in the date bands? */
+)
+{
+    return (run_pipeline_stage (pipeline, PIPELINE_DATE_STAGE, NULL,
+        pipeline_date_stage, &use_fill_mask));
+}
+
+
+/******************************************************************************
+MODULE:  hash_bytes
+
+PURPOSE: Adds a block of bytes to a 64-bit FNV-1a hash.
+
+RETURN VALUE:
+Type = uint64_t
+Value        Description
+-----        -----------
+hash         Updated hash
+
+NOTES:
+******************************************************************************/
+static uint64_t hash_bytes
+(
+    uint64_t hash,              /* I: hash so far */
+    const void *bytes,          /* I: bytes to add */
+    size_t count                /* I: number of bytes */
+)
+{
+    const unsigned char *byte = bytes;  /* current byte */
+    size_t i;                           /* looping variable */
+
+    for (i = 0; i < count; i++)
+    {
+        hash ^= byte[i];
+        hash *= FNV_PRIME;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  format_stage_params
+
+PURPOSE: Formats the parameters of a stage function of the library as text,
+for the provenance of its bands.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The parameters which don't change the bands, such as the number of
+     threads, are left out.  params is empty for the other stage functions.
+******************************************************************************/
+static void format_stage_params
+(
+    Espa_stage_func_t func,       /* I: stage function */
+    void *arg,                    /* I: argument of the stage */
+    char params[STR_SIZE]         /* O: parameters of the stage */
+)
+{
+    Pipeline_angle_options_t *opts = NULL;  /* angle options */
+
+    params[0] = '\0';
+    if (func == pipeline_angle_stage)
+    {
+        opts = arg;
+        snprintf (params, STR_SIZE, "band_avg=%d grid_spacing=%d "
+            "max_grid_error=%.17g verify_grid=%d share_bands=%d dem_file=%s",
+            opts->band_avg, opts->grid_spacing, opts->max_grid_error,
+            opts->verify_grid, opts->share_bands,
+            opts->dem_file != NULL ? opts->dem_file : "");
+    }
+    else if (func == pipeline_land_water_mask_stage)
+        snprintf (params, STR_SIZE, "land_mass_polygon=%s", (char *) arg);
+    else if (func == pipeline_date_stage)
+        snprintf (params, STR_SIZE, "use_fill_mask=%d", *(bool *) arg);
+}
+
+
+/******************************************************************************
+MODULE:  get_stage_key
+
+PURPOSE: Computes the provenance key the bands of a stage would have if it
+were run now.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. See note 5 of this file.  The bands written by the stage itself are
+     never digested.
+******************************************************************************/
+static void get_stage_key
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    const char *name,             /* I: name of the stage */
+    const char *params,           /* I: parameters of the stage */
+    const char *upstream[],       /* I: names of the stages the stage depends
+                                        on */
+    int nupstream,                /* I: number of names in upstream */
+    char key[STR_SIZE]            /* O: provenance key, as 16 hexadecimal
+                                        digits */
+)
+{
+    int i, j;                     /* looping variables */
+    bool input;                   /* may the stage read the band? */
+    uint64_t hash = FNV_OFFSET_BASIS;  /* digest of the stage */
+    long long file_info[2];       /* size and modification time of the band
+                                     file; -1 if it doesn't exist */
+    struct stat file_stat;        /* status of the band file */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+
+    hash = hash_bytes (hash, name, strlen (name) + 1);
+    hash = hash_bytes (hash, params, strlen (params) + 1);
+    hash = hash_bytes (hash, ESPA_COMMON_VERSION,
+        strlen (ESPA_COMMON_VERSION) + 1);
+
+    for (i = 0; i < pipeline->metadata.nbands; i++)
+    {
+        bmeta = &pipeline->metadata.band[i];
+        input = (bmeta->provenance.stage[0] == '\0');
+        for (j = 0; j < nupstream && !input; j++)
+            input = !strcmp (bmeta->provenance.stage, upstream[j]);
+        if (!input)
+            continue;
+
+        hash = hash_bytes (hash, bmeta->name, strlen (bmeta->name) + 1);
+        hash = hash_bytes (hash, bmeta->file_name,
+            strlen (bmeta->file_name) + 1);
+        hash = hash_bytes (hash, bmeta->provenance.key,
+            strlen (bmeta->provenance.key) + 1);
+        if (bmeta->checksum[0] != '\0')
+            hash = hash_bytes (hash, bmeta->checksum,
+                strlen (bmeta->checksum) + 1);
+        else
+        {
+            file_info[0] = -1;
+            file_info[1] = -1;
+            if (stat (bmeta->file_name, &file_stat) == 0)
+            {
+                file_info[0] = file_stat.st_size;
+                file_info[1] = file_stat.st_mtime;
+            }
+            hash = hash_bytes (hash, file_info, sizeof (file_info));
+        }
+    }
+
+    snprintf (key, STR_SIZE, "%016llx", (unsigned long long) hash);
+}
+
+
+/******************************************************************************
+MODULE:  stage_is_current
+
+PURPOSE: Determines whether the bands of a stage are in the metadata with the
+provenance key the stage would now give them, so the stage needn't be run.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The stage has bands, which are all up to date
+false           The stage has no bands, or a stale or missing band
+
+NOTES:
+******************************************************************************/
+static bool stage_is_current
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    const char *name,             /* I: name of the stage */
+    const char *key               /* I: current provenance key of the
+                                        stage */
+)
+{
+    int i;                        /* looping variable */
+    int nbands = 0;               /* number of bands of the stage */
+    struct stat file_stat;        /* status of the band file */
+    Espa_band_meta_t *bmeta = NULL;  /* current band */
+
+    for (i = 0; i < pipeline->metadata.nbands; i++)
+    {
+        bmeta = &pipeline->metadata.band[i];
+        if (strcmp (bmeta->provenance.stage, name))
+            continue;
+        if (strcmp (bmeta->provenance.key, key) ||
+            stat (bmeta->file_name, &file_stat) != 0)
+            return (false);
+        nbands++;
+    }
+
+    return (nbands > 0);
+}
+
+
+/******************************************************************************
+MODULE:  set_stage_provenance
+
+PURPOSE: Records the provenance of the bands created by a stage.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+static void set_stage_provenance
+(
+    const char *name,             /* I: name of the stage */
+    const char *key,              /* I: provenance key of the stage */
+    Espa_internal_meta_t *out_meta /* I/O: metadata of the bands created */
+)
+{
+    int i;                        /* looping variable */
+
+    for (i = 0; i < out_meta->nbands; i++)
+    {
+        snprintf (out_meta->band[i].provenance.stage,
+            sizeof (out_meta->band[i].provenance.stage), "%s", name);
+        snprintf (out_meta->band[i].provenance.key,
+            sizeof (out_meta->band[i].provenance.key), "%s", key);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  add_stage_bands
+
+PURPOSE: Records the provenance of the bands created by a stage, and adds them
+to the metadata in place of the bands the stage created before.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error adding the bands
+SUCCESS         Successfully added the bands
+
+NOTES:
+  1. The bands the stage committed to the band registry, if any, are added
+     before those left in out_meta.  Their provenance was recorded when
+     they were committed.
+******************************************************************************/
+static int add_stage_bands
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    const char *name,             /* I: name of the stage */
+    const char *key,              /* I: provenance key of the stage */
+    Espa_band_registry_t *registry,  /* I/O: band registry the stage
+                                         committed its bands to; NULL if
+                                         there is none */
+    int order,                    /* I: order key of the bands of the stage
+                                        in the registry */
+    Espa_internal_meta_t *out_meta /* I/O: metadata of the bands created;
+                                         the bands are removed on return */
+)
+{
+    int i;                        /* looping variable */
+
+    set_stage_provenance (name, key, out_meta);
+
+    /* Remove the stale bands of the stage, which the new bands replace */
+    for (i = pipeline->metadata.nbands - 1; i >= 0; i--)
+    {
+        if (strcmp (pipeline->metadata.band[i].provenance.stage, name))
+            continue;
+        if (remove_band_metadata (&pipeline->metadata, i) != SUCCESS)
+            return (ERROR);
+        pipeline->modified = true;
+    }
+
+    if (registry != NULL &&
+        merge_registry_bands (registry, order, &pipeline->metadata) != SUCCESS)
+        return (ERROR);
+    if (merge_band_metadata (&pipeline->metadata, out_meta) != SUCCESS)
+        return (ERROR);
+    pipeline->modified = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  run_pipeline_stage
+
+PURPOSE: Runs a stage function on the scene in the pipeline and adds the
+bands it created to the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the stage
+SUCCESS         Successfully ran the stage, or skipped it since its bands
+                are up to date
+
+NOTES:
+  1. The stage is taken to read only the bands which no stage wrote, for
+     its provenance key.
+  2. In incremental mode the stage isn't run if its bands are up to date
+     (see note 2 of espa_pipeline.h).
+******************************************************************************/
+int run_pipeline_stage
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    const char *name,             /* I: name of the stage */
+    const char *params,           /* I: parameters of the stage, as text;
+                                        NULL for those of the stage
+                                        functions of the library */
+    Espa_stage_func_t func,       /* I: stage function */
+    void *arg                     /* I: argument of the stage */
+)
+{
+    char FUNC_NAME[] = "run_pipeline_stage";  /* function name */
+    char errmsg[STR_SIZE];            /* error message */
+    char stage_params[STR_SIZE];      /* parameters of the stage */
+    char key[STR_SIZE];               /* provenance key of the stage */
+    int status;                       /* return status */
+    Espa_internal_meta_t out_meta;    /* output metadata of the stage */
+
+    if (params == NULL)
+    {
+        format_stage_params (func, arg, stage_params);
+        params = stage_params;
+    }
+    get_stage_key (pipeline, name, params, NULL, 0, key);
+    if (pipeline->incremental && stage_is_current (pipeline, name, key))
+    {
+        sprintf (errmsg, "The bands of stage %s are up to date; skipping the "
+            "stage", name);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (SUCCESS);
+    }
+
+    init_metadata_struct (&out_meta);
+    status = func (pipeline, arg, &out_meta);
+    if (status == SUCCESS && pipeline->low_latency)
+    {
+        set_stage_provenance (name, key, &out_meta);
+        status = publish_pipeline_bands (pipeline, &out_meta, name);
+    }
+    if (status == SUCCESS)
+        status = add_stage_bands (pipeline, name, key, NULL, 0, &out_meta);
+    free_metadata (&out_meta);
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  init_stage_graph
+
+PURPOSE: Initializes a stage graph without any stages.
+
+RETURN VALUE: N/A
+
+NOTES:
+******************************************************************************/
+void init_stage_graph
+(
+    Espa_stage_graph_t *graph     /* O: stage graph without stages */
+)
+{
+    graph->nstages = 0;
+}
+
+
+/******************************************************************************
+MODULE:  add_stage_to_graph
+
+PURPOSE: Adds a stage to a stage graph, with the names of the data it reads
+and writes.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Too many stages, or a name is too long
+SUCCESS         Successfully added the stage
+
+NOTES:
+  1. A stage depends on the stages which write one of the data it reads.
+     The data read which no stage writes, such as the bands of the scene,
+     have to exist before the graph is run.
+  2. The bands of the stages are added to the metadata in the order the
+     stages were added to the graph.
+  3. The parameters of the stage functions of the library are recorded for
+     the provenance of their bands.  Those of other stage functions are set
+     by set_stage_params.
+******************************************************************************/
+int add_stage_to_graph
+(
+    Espa_stage_graph_t *graph,    /* I/O: stage graph */
+    const char *name,             /* I: name of the stage */
+    Espa_stage_func_t func,       /* I: stage function */
+    void *arg,                    /* I: argument of the stage; must remain
+                                        valid until the graph is run */
+    const char *inputs,           /* I: names of the data read by the stage,
+                                        separated by spaces */
+    const char *outputs           /* I: names of the data written by the
+                                        stage, separated by spaces */
+)
+{
+    char FUNC_NAME[] = "add_stage_to_graph";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_pipeline_stage_t *stage = NULL;  /* stage added */
+
+    if (graph->nstages >= PIPELINE_MAX_STAGES)
+    {
+        sprintf (errmsg, "Stage graph already has %d stages",
+            PIPELINE_MAX_STAGES);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    stage = &graph->stage[graph->nstages];
+    if (strlen (name) >= sizeof (stage->name) ||
+        strlen (inputs) >= sizeof (stage->inputs) ||
+        strlen (outputs) >= sizeof (stage->outputs))
+    {
+        sprintf (errmsg, "Name, inputs or outputs of a stage are too long");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    strcpy (stage->name, name);
+    stage->func = func;
+    stage->arg = arg;
+    strcpy (stage->inputs, inputs);
+    strcpy (stage->outputs, outputs);
+    format_stage_params (func, arg, stage->params);
+    graph->nstages++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_stage_params
+
+PURPOSE: Sets the parameters of a stage of a stage graph, as text, for the
+provenance of its bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The graph has no such stage, or the parameters are too long
+SUCCESS         Successfully set the parameters
+
+NOTES:
+  1. The parameters should include everything which changes the bands of
+     the stage other than its input bands, such as its options and the
+     version of the application, so its bands are recreated when they
+     change.
+******************************************************************************/
+int set_stage_params
+(
+    Espa_stage_graph_t *graph,    /* I/O: stage graph */
+    const char *name,             /* I: name of the stage */
+    const char *params            /* I: parameters of the stage, as text */
+)
+{
+    char FUNC_NAME[] = "set_stage_params";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i;                    /* looping variable */
+
+    for (i = 0; i < graph->nstages; i++)
+    {
+        if (strcmp (graph->stage[i].name, name))
+            continue;
+        if (strlen (params) >= sizeof (graph->stage[i].params))
+        {
+            sprintf (errmsg, "Parameters of stage %s are too long", name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        strcpy (graph->stage[i].params, params);
+        return (SUCCESS);
+    }
+
+    sprintf (errmsg, "Stage graph has no stage %s", name);
+    error_handler (true, FUNC_NAME, errmsg);
+    return (ERROR);
+}
+
+
+/******************************************************************************
+MODULE:  names_overlap
+
+PURPOSE: Determines whether two lists of names, separated by spaces, have a
+name in common.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The lists have a name in common
+false           The lists don't have a name in common
+
+NOTES:
+******************************************************************************/
+static bool names_overlap
+(
+    const char *list1,    /* I: first list of names */
+    const char *list2     /* I: second list of names */
+)
+{
+    const char *name1 = list1;  /* current name of the first list */
+    const char *name2 = NULL;   /* current name of the second list */
+    size_t len1;          /* length of name1 */
+    size_t len2;          /* length of name2 */
+
+    while (*name1 != '\0')
+    {
+        while (isspace ((unsigned char) *name1))
+            name1++;
+        for (len1 = 0; name1[len1] != '\0' &&
+            !isspace ((unsigned char) name1[len1]); len1++)
+            ;
+        if (len1 == 0)
+            break;
+
+        name2 = list2;
+        while (*name2 != '\0')
+        {
+            while (isspace ((unsigned char) *name2))
+                name2++;
+            for (len2 = 0; name2[len2] != '\0' &&
+                !isspace ((unsigned char) name2[len2]); len2++)
+                ;
+            if (len2 == 0)
+                break;
+            if (len1 == len2 && !strncmp (name1, name2, len1))
+                return (true);
+            name2 += len2;
+        }
+        name1 += len1;
+    }
+
+    return (false);
+}
+
+
+/* Stage of a stage graph run as a task */
+typedef struct
+{
+    Espa_pipeline_t *pipeline;        /* pipeline handle for the scene */
+    Espa_pipeline_stage_t *stage;     /* stage to be run */
+    Espa_band_registry_t *registry;   /* band registry of the level */
+    int order;                        /* index of the stage, the order key of
+                                         its bands in the registry */
+    Espa_internal_meta_t out_meta;    /* metadata of the bands created, if
+                                         they didn't fit in the registry */
+    char key[STR_SIZE];               /* provenance key of the stage */
+    bool skipped;                     /* are the bands of the stage up to
+                                         date, so it isn't run? */
+    int status;                       /* status of the stage */
+} Stage_task_t;
+
+/******************************************************************************
+MODULE:  run_stage_task
+
+PURPOSE: Runs a stage of a stage graph, as a task of the task runtime.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the stage
+SUCCESS         Successfully ran the stage
+
+NOTES:
+  1. The bands of the stage are committed to the band registry of the level
+     when the stage succeeds.  If they don't fit, they're left in out_meta
+     and added from there.
+******************************************************************************/
+static int run_stage_task
+(
+    void *arg                         /* I: stage task (Stage_task_t *) */
+)
+{
+    Stage_task_t *task = arg;         /* stage task */
+    int first_slot;                   /* first registry slot of the bands */
+
+    task->status = task->stage->func (task->pipeline, task->stage->arg,
+        &task->out_meta);
+    if (task->status != SUCCESS || task->out_meta.nbands == 0)
+        return (task->status);
+
+    set_stage_provenance (task->stage->name, task->key, &task->out_meta);
+    if (task->pipeline->low_latency)
+    {
+        task->status = publish_pipeline_bands (task->pipeline,
+            &task->out_meta, task->stage->name);
+        if (task->status != SUCCESS)
+            return (task->status);
+    }
+    first_slot = reserve_band_slots (task->registry, task->out_meta.nbands);
+    if (first_slot >= 0)
+    {
+        commit_band_slots (task->registry, first_slot, task->order,
+            &task->out_meta);
+    }
+
+    return (task->status);
+}
+
+
+/******************************************************************************
+MODULE:  run_pipeline_stages
+
+PURPOSE: Runs the stages of a stage graph on the scene in the pipeline,
+running the stages which don't depend on each other concurrently, and adds
+the bands they created to the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running a stage, or the stages depend on each other in
+                a cycle
+SUCCESS         Successfully ran all the stages
+
+NOTES:
+  1. See note 4 of this file.  The stages of a level run with the task
+     runtime, so they only run concurrently when threading is enabled.
+  2. Once a stage fails, the stages depending on it aren't run, and the
+     bands of its level aren't added.
+  3. In incremental mode the stages whose bands are up to date aren't run
+     (see note 2 of espa_pipeline.h).  A stage is up to date only if the
+     stages it depends on were too, since their bands are digested in its
+     provenance key.
+  4. The band registry of a level has PIPELINE_STAGE_BANDS slots for each
+     of its stages, but a stage may use more than its share while the
+     others use less.
+******************************************************************************/
+int run_pipeline_stages
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    Espa_stage_graph_t *graph     /* I: stages to be run */
+)
+{
+    char FUNC_NAME[] = "run_pipeline_stages";  /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int i, j;                 /* looping variables for the stages */
+    int ndone = 0;            /* number of stages done */
+    int nready;               /* number of stages of the current level */
+    int nupstream;            /* number of stages a stage depends on */
+    const char *upstream[PIPELINE_MAX_STAGES];  /* names of the stages a
+                                 stage depends on */
+    int status = SUCCESS;     /* return status */
+    bool depends[PIPELINE_MAX_STAGES][PIPELINE_MAX_STAGES];  /* does stage i
+                                 read data written by stage j? */
+    bool done[PIPELINE_MAX_STAGES];   /* has the stage been run? */
+    bool ready[PIPELINE_MAX_STAGES];  /* is the stage in the current level? */
+    Stage_task_t task[PIPELINE_MAX_STAGES];  /* tasks of the current level */
+    Espa_task_group_t group;  /* tasks of the current level */
+    Espa_band_registry_t registry;  /* bands created by the current level */
+
+    /* Find the stages each stage depends on */
+    for (i = 0; i < graph->nstages; i++)
+    {
+        done[i] = false;
+        for (j = 0; j < graph->nstages; j++)
+        {
+            depends[i][j] = (i != j) && names_overlap (graph->stage[i].inputs,
+                graph->stage[j].outputs);
+        }
+    }
+
+    while (ndone < graph->nstages)
+    {
+        /* The stages whose dependencies are done make the next level */
+        nready = 0;
+        for (i = 0; i < graph->nstages; i++)
+        {
+            ready[i] = !done[i];
+            for (j = 0; j < graph->nstages && ready[i]; j++)
+            {
+                if (depends[i][j] && !done[j])
+                    ready[i] = false;
+            }
+            if (ready[i])
+                nready++;
+        }
+
+        if (nready == 0)
+        {
+            sprintf (errmsg, "The remaining stages depend on each other in a "
+                "cycle");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Run the stages of the level concurrently */
+        if (init_band_registry (&registry, nready * PIPELINE_STAGE_BANDS)
+            != SUCCESS)
+            return (ERROR);
+        espa_task_group_init (&group);
+        for (i = 0; i < graph->nstages; i++)
+        {
+            if (!ready[i])
+                continue;
+            task[i].pipeline = pipeline;
+            task[i].stage = &graph->stage[i];
+            task[i].registry = &registry;
+            task[i].order = i;
+            task[i].status = ERROR;
+            init_metadata_struct (&task[i].out_meta);
+
+            /* The bands of the stages it depends on are in the metadata
+               now, so its key can be computed */
+            nupstream = 0;
+            for (j = 0; j < graph->nstages; j++)
+            {
+                if (depends[i][j])
+                    upstream[nupstream++] = graph->stage[j].name;
+            }
+            get_stage_key (pipeline, graph->stage[i].name,
+                graph->stage[i].params, upstream, nupstream, task[i].key);
+            task[i].skipped = pipeline->incremental && stage_is_current (
+                pipeline, graph->stage[i].name, task[i].key);
+            if (task[i].skipped)
+            {
+                sprintf (errmsg, "The bands of stage %s are up to date; "
+                    "skipping the stage", graph->stage[i].name);
+                error_handler (false, FUNC_NAME, errmsg);
+                task[i].status = SUCCESS;
+                if (pipeline->low_latency)
+                    task[i].status = publish_pipeline_bands (pipeline,
+                        &pipeline->metadata, graph->stage[i].name);
+                continue;
+            }
+            espa_task_submit (&group, run_stage_task, &task[i]);
+        }
+        status = espa_task_group_wait (&group);
+
+        /* Add the bands of the stages, one stage after the other */
+        for (i = 0; i < graph->nstages; i++)
+        {
+            if (!ready[i])
+                continue;
+            if (task[i].status != SUCCESS)
+            {
+                sprintf (errmsg, "Running stage %s", graph->stage[i].name);
+                error_handler (true, FUNC_NAME, errmsg);
+            }
+            else if (status == SUCCESS && !task[i].skipped)
+            {
+                status = add_stage_bands (pipeline, graph->stage[i].name,
+                    task[i].key, &registry, i, &task[i].out_meta);
+            }
+            free_metadata (&task[i].out_meta);
+            done[i] = true;
+            ndone++;
+        }
+        free_band_registry (&registry);
+
+        if (status != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_pipeline_metadata
+
+PURPOSE: Writes the metadata of the pipeline to the XML file and validates
+it, if it has changed since it was read or last written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the XML metadata file
+SUCCESS         Successfully wrote the XML metadata file
+
+NOTES:
+  1. In low-latency mode the bands still in shared memory in the directory
+     of the XML file are written to disk before the XML file, and the bands
+     no stage wrote are published after it.  The scene is then complete, so
+     the completion milestone of the profile is marked.
+******************************************************************************/
+int write_pipeline_metadata
+(
+    Espa_pipeline_t *pipeline     /* I/O: pipeline handle for the scene */
+)
+{
+    char FUNC_NAME[] = "write_pipeline_metadata";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char path[STR_SIZE];          /* absolute name of the XML file */
+    char *cptr = NULL;            /* pointer to the XML file in its name */
+
+    if (pipeline->low_latency && use_raw_binary_shm ())
+    {
+        if (get_absolute_name (pipeline->xml_file, path) != SUCCESS)
+        {
+            sprintf (errmsg, "Getting the directory of %s",
+                pipeline->xml_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        cptr = strrchr (path, '/');
+        cptr[1] = '\0';
+        if (flush_raw_binary_shm (path, false) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+    }
+
+    if (pipeline->modified)
+    {
+        /* Write the metadata from our internal metadata structure to the
+           output XML filename */
+        if (write_metadata (&pipeline->metadata, pipeline->xml_file)
+            != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        /* Validate the output metadata file */
+        if (validate_xml_file (pipeline->xml_file) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+
+        pipeline->modified = false;
+    }
+
+    if (pipeline->low_latency)
+    {
+        if (!pipeline->source_published)
+        {
+            if (publish_pipeline_bands (pipeline, &pipeline->metadata, "")
+                != SUCCESS)
+                return (ERROR);
+            pipeline->source_published = true;
+        }
+        espa_profile_mark (ESPA_PROFILE_COMPLETE);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  export_pipeline_gtif
+
+PURPOSE: Writes the metadata of the pipeline and converts the scene to
+GeoTIFF.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting the scene
+SUCCESS         Successfully exported the scene
+
+NOTES:
+  1. If the source files are removed, the pipeline is left with only the
+     metadata and close_espa_pipeline should be the next call.
+******************************************************************************/
+int export_pipeline_gtif
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    char *gtif_file,              /* I: base output GeoTIFF filename */
+    Gtif_compress_t compress,     /* I: compression of the GeoTIFF tiles */
+    bool cog,                     /* I: should Cloud-Optimized GeoTIFFs be
+                                        written? */
+    Gtif_interleave_t interleave, /* I: layout of the bands of each product */
+    bool del_src                  /* I: should the source files be removed
+                                        after conversion? */
+)
+{
+    if (write_pipeline_metadata (pipeline) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (convert_espa_to_gtif (pipeline->xml_file, gtif_file, compress,
+        cog, interleave, del_src));
+}
+
+
+/******************************************************************************
+MODULE:  export_pipeline_hdf
+
+PURPOSE: Writes the metadata of the pipeline and converts the scene to
+HDF-EOS.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting the scene
+SUCCESS         Successfully exported the scene
+
+NOTES:
+  1. If the source files are removed, the pipeline is left with only the
+     metadata and close_espa_pipeline should be the next call.
+******************************************************************************/
+int export_pipeline_hdf
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    char *hdf_file,               /* I: output HDF filename */
+    Hdf_compress_t compress,      /* I: storage/compression to be used for
+                                        the SDSs */
+    bool del_src                  /* I: should the source files be removed
+                                        after conversion? */
+)
+{
+    if (write_pipeline_metadata (pipeline) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (convert_espa_to_hdf (pipeline->xml_file, hdf_file, compress,
+        del_src));
+}
+
+
+/******************************************************************************
+MODULE:  export_pipeline_bip
+
+PURPOSE: Writes the metadata of the pipeline and converts the scene to a
+raw binary BIP file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error exporting the scene
+SUCCESS         Successfully exported the scene
+
+NOTES:
+  1. If the source files are removed, the pipeline is left with only the
+     metadata and close_espa_pipeline should be the next call.
+******************************************************************************/
+int export_pipeline_bip
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    char *bip_file,               /* I: output BIP filename */
+    bool convert_qa,              /* I: should the QA bands be converted to
+                                        the data type of band 1? */
+    bool del_src                  /* I: should the source files be removed
+                                        after conversion? */
+)
+{
+    if (write_pipeline_metadata (pipeline) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    return (convert_espa_to_raw_binary_bip (pipeline->xml_file, bip_file,
+        convert_qa, del_src));
+}
+
+
+/******************************************************************************
+MODULE:  close_espa_pipeline
+
+PURPOSE: Frees the metadata of the pipeline.
+
+RETURN VALUE: N/A
+
+NOTES:
+  1. The metadata isn't written; write_pipeline_metadata needs to be called
+     first if there are changes which haven't been written.
+******************************************************************************/
+void close_espa_pipeline
+(
+    Espa_pipeline_t *pipeline     /* I: pipeline handle for the scene */
+)
+{
+    free_metadata (&pipeline->metadata);
+    pipeline->modified = false;
+}
@@ -0,0 +1,334 @@
+/*****************************************************************************
+FILE: espa_pipeline.h
+
+PURPOSE: Contains defines and prototypes for running the Level-1 processing
+stages on a single, in-memory copy of the ESPA XML metadata.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The stages adding bands can also be declared in a stage graph, with the
+     names of the data each one reads and writes, and run by
+     run_pipeline_stages.  The stages which don't depend on each other run
+     concurrently, so the time of the scene is that of its longest chain of
+     stages rather than the sum of all of them.
+  2. The bands written by a stage record its provenance: the name of the
+     stage and a key digesting the stage parameters, the library version and
+     the bands the stage read (see set_stage_params).  In incremental mode
+     (the ESPA_INCREMENTAL environment variable is set to "on", or the
+     pipeline's incremental flag is set), a stage whose bands are all in the
+     metadata with the key it would now have, and whose band files exist,
+     is skipped.  So rerunning a scene after a partial failure, or after a
+     new version of one stage, only reruns the stages whose outputs are
+     stale.  The stale bands of a stage which is rerun are replaced.
+  3. In low-latency mode (the ESPA_LOW_LATENCY environment variable is set
+     to "on"), the pipeline processes its scene for the shortest time to
+     the outputs rather than for the throughput of a batch.  The band
+     conversion and the angle stage use every thread of the task runtime;
+     the input files are prefetched with asynchronous readahead; the bands
+     are kept in shared memory between the stages (see raw_binary_shm.h)
+     unless ESPA_SHM_BANDS is already set; and the bands of each stage are
+     flushed to disk and published through the band_ready callback of the
+     pipeline as soon as the stage is done, without waiting for the others.
+     The source bands are published once the metadata is written.  The
+     profile (see espa_profile.h) reports the time to the first published
+     band and to the completed scene.
+*****************************************************************************/
+
+#ifndef ESPA_PIPELINE_H
+#define ESPA_PIPELINE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "convert_espa_to_hdf.h"
+#include "convert_espa_to_gtif.h"
+
+/* Defines */
+/* Largest number of stages in a stage graph */
+#define PIPELINE_MAX_STAGES 16
+
+/* Number of band registry slots for each stage of a level of a stage graph
+   (see band_registry.h) */
+#define PIPELINE_STAGE_BANDS 64
+
+/* Environment variable turning on incremental mode */
+#define PIPELINE_INCREMENTAL_ENV "ESPA_INCREMENTAL"
+
+/* Environment variable turning on low-latency mode */
+#define PIPELINE_LOW_LATENCY_ENV "ESPA_LOW_LATENCY"
+
+/* Names of the stages of the library, recorded in the provenance of their
+   bands */
+#define PIPELINE_ANGLE_STAGE "angle bands"
+#define PIPELINE_LAND_WATER_MASK_STAGE "land/water mask"
+#define PIPELINE_DATE_STAGE "date bands"
+
+/* Callback publishing a band of the scene in low-latency mode, once its
+   band file is complete on disk.  It's called from the thread of the stage
+   which created the band, but never by two threads at once. */
+typedef void (*Espa_band_ready_func_t)
+(
+    void *arg,                    /* I: argument of the callback */
+    const Espa_band_meta_t *bmeta /* I: metadata of the band */
+);
+
+/* Pipeline handle holding the live metadata for a scene, which is passed from
+   stage to stage and written to the XML file once */
+typedef struct
+{
+    char xml_file[STR_SIZE];       /* ESPA XML metadata filename */
+    Espa_internal_meta_t metadata; /* live XML metadata for the scene */
+    bool modified;                 /* has the metadata changed since it was
+                                      last read or written? */
+    bool incremental;              /* should the stages whose bands are up to
+                                      date be skipped? */
+    bool low_latency;              /* is the scene processed in low-latency
+                                      mode? */
+    bool source_published;         /* have the bands no stage wrote been
+                                      published? */
+    Espa_band_ready_func_t band_ready;  /* callback publishing the bands in
+                                      low-latency mode; NULL for none */
+    void *band_ready_arg;          /* argument of the callback */
+} Espa_pipeline_t;
+
+/* Stage function of a stage graph, which creates its bands from the metadata
+   of the scene and returns the metadata of those bands in out_meta.  The
+   metadata of the pipeline must only be read, since other stages read it at
+   the same time.  Returns SUCCESS or ERROR. */
+typedef int (*Espa_stage_func_t)
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: argument of the stage */
+    Espa_internal_meta_t *out_meta /* O: metadata of the bands created;
+                                         global metadata is not used */
+);
+
+/* Stage of a stage graph */
+typedef struct
+{
+    char name[STR_SIZE];          /* name of the stage, for the messages */
+    Espa_stage_func_t func;       /* stage function */
+    void *arg;                    /* argument of the stage function */
+    char inputs[STR_SIZE];        /* names of the data read by the stage,
+                                     separated by spaces */
+    char outputs[STR_SIZE];       /* names of the data written by the stage,
+                                     separated by spaces */
+    char params[STR_SIZE];        /* parameters of the stage, as text, for
+                                     the provenance of its bands */
+} Espa_pipeline_stage_t;
+
+/* Stages to be run on a scene by run_pipeline_stages */
+typedef struct
+{
+    int nstages;                  /* number of stages */
+    Espa_pipeline_stage_t stage[PIPELINE_MAX_STAGES];  /* stages, in the
+                                     order their bands are added */
+} Espa_stage_graph_t;
+
+/* Options of the angle bands stage (pipeline_angle_stage) */
+typedef struct
+{
+    bool band_avg;                /* should the reflectance band average be
+                                     processed? */
+    int grid_spacing;             /* spacing of the exactly evaluated angle
+                                     grid */
+    double max_grid_error;        /* maximum angle grid interpolation error
+                                     (degrees) */
+    bool verify_grid;             /* should the interpolated angles be
+                                     verified? */
+    int nthreads;                 /* number of threads for generating the
+                                     angles */
+    bool share_bands;             /* should the angles be shared between
+                                     bands? */
+    const char *dem_file;         /* DEM giving the terrain height of each
+                                     pixel, or NULL to use zero height */
+} Pipeline_angle_options_t;
+
+/* Prototypes */
+bool use_pipeline_incremental (void);
+
+bool use_pipeline_low_latency (void);
+
+int open_espa_pipeline
+(
+    char *espa_xml_file,          /* I: input ESPA XML metadata filename */
+    Espa_pipeline_t *pipeline     /* O: pipeline handle for the scene */
+);
+
+int open_lpgs_pipeline
+(
+    char *lpgs_mtl_file,          /* I: input LPGS MTL metadata filename */
+    char *espa_xml_file,          /* I: output ESPA XML metadata filename */
+    bool del_src,                 /* I: should the source .tif files be
+                                        removed after conversion? */
+    int nthreads,                 /* I: number of threads to use for
+                                        converting the bands */
+    Espa_pipeline_t *pipeline     /* O: pipeline handle for the scene */
+);
+
+int open_lpgs_bundle_pipeline
+(
+    char *lpgs_bundle_file,       /* I: input LPGS product bundle (.tar.gz) */
+    char *espa_xml_file,          /* I: output ESPA XML metadata filename */
+    bool del_src,                 /* I: should the bundle be removed after
+                                        conversion? */
+    int nthreads,                 /* I: number of threads to use for
+                                        converting the bands */
+    Espa_pipeline_t *pipeline     /* O: pipeline handle for the scene */
+);
+
+int clip_pipeline_bands
+(
+    Espa_pipeline_t *pipeline     /* I/O: pipeline handle for the scene */
+);
+
+int add_pipeline_angle_bands
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    bool band_avg,                /* I: should the reflectance band average
+                                        be processed? */
+    int grid_spacing,             /* I: spacing of the exactly evaluated
+                                        angle grid */
+    double max_grid_error,        /* I: maximum angle grid interpolation
+                                        error (degrees) */
+    bool verify_grid,             /* I: should the interpolated angles be
+                                        verified? */
+    int nthreads,                 /* I: number of threads for generating the
+                                        angles */
+    bool share_bands,             /* I: should the angles be shared between
+                                        bands? */
+    const char *dem_file          /* I: DEM giving the terrain height of each
+                                        pixel, or NULL to use zero height */
+);
+
+int add_pipeline_land_water_mask
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    const char land_mass_polygon[] /* I: name of land mass polygon file */
+);
+
+int add_pipeline_date_bands
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    bool use_fill_mask            /* I: should the fill pixels in band 1 be
+                                        set to fill in the date bands? */
+);
+
+int pipeline_angle_stage
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: angle options
+                                        (Pipeline_angle_options_t *) */
+    Espa_internal_meta_t *out_meta /* O: metadata of the angle bands */
+);
+
+int pipeline_land_water_mask_stage
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: name of land mass polygon file
+                                        (char *) */
+    Espa_internal_meta_t *out_meta /* O: metadata of the mask band */
+);
+
+int pipeline_date_stage
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: should the fill pixels in band 1 be
+                                        set to fill in the date bands?
+                                        (bool *) */
+    Espa_internal_meta_t *out_meta /* O: metadata of the date bands */
+);
+
+int run_pipeline_stage
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    const char *name,             /* I: name of the stage */
+    const char *params,           /* I: parameters of the stage, as text;
+                                        NULL for those of the stage
+                                        functions of the library */
+    Espa_stage_func_t func,       /* I: stage function */
+    void *arg                     /* I: argument of the stage */
+);
+
+void init_stage_graph
+(
+    Espa_stage_graph_t *graph     /* O: stage graph without stages */
+);
+
+int add_stage_to_graph
+(
+    Espa_stage_graph_t *graph,    /* I/O: stage graph */
+    const char *name,             /* I: name of the stage */
+    Espa_stage_func_t func,       /* I: stage function */
+    void *arg,                    /* I: argument of the stage; must remain
+                                        valid until the graph is run */
+    const char *inputs,           /* I: names of the data read by the stage,
+                                        separated by spaces */
+    const char *outputs           /* I: names of the data written by the
+                                        stage, separated by spaces */
+);
+
+int set_stage_params
+(
+    Espa_stage_graph_t *graph,    /* I/O: stage graph */
+    const char *name,             /* I: name of the stage */
+    const char *params            /* I: parameters of the stage, as text */
+);
+
+int run_pipeline_stages
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    Espa_stage_graph_t *graph     /* I: stages to be run */
+);
+
+int write_pipeline_metadata
+(
+    Espa_pipeline_t *pipeline     /* I/O: pipeline handle for the scene */
+);
+
+int export_pipeline_gtif
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    char *gtif_file,              /* I: base output GeoTIFF filename */
+    Gtif_compress_t compress,     /* I: compression of the GeoTIFF tiles */
+    bool cog,                     /* I: should Cloud-Optimized GeoTIFFs be
+                                        written? */
+    Gtif_interleave_t interleave, /* I: layout of the bands of each product */
+    bool del_src                  /* I: should the source files be removed
+                                        after conversion? */
+);
+
+int export_pipeline_hdf
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    char *hdf_file,               /* I: output HDF filename */
+    Hdf_compress_t compress,      /* I: storage/compression to be used for
+                                        the SDSs */
+    bool del_src                  /* I: should the source files be removed
+                                        after conversion? */
+);
+
+int export_pipeline_bip
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    char *bip_file,               /* I: output BIP filename */
+    bool convert_qa,              /* I: should the QA bands be converted to
+                                        the data type of band 1? */
+    bool del_src                  /* I: should the source files be removed
+                                        after conversion? */
+);
+
+void close_espa_pipeline
+(
+    Espa_pipeline_t *pipeline     /* I: pipeline handle for the scene */
+);
+
+#endif
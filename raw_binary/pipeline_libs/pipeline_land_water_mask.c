@@ -0,0 +1,70 @@
+/*****************************************************************************
+FILE: pipeline_land_water_mask.c
+
+PURPOSE: Contains the land/water mask stage of the ESPA processing pipeline.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. This is kept separate from espa_pipeline.c, since the IAS geo
+     definitions of the land/water mask library conflict with those of the
+     per-pixel angles library.
+*****************************************************************************/
+#include "espa_pipeline.h"
+#include "generate_land_water_mask.h"
+
+/******************************************************************************
+MODULE:  pipeline_land_water_mask_stage
+
+PURPOSE: Creates the land/water mask for the scene in the pipeline, as a stage
+function.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water mask
+SUCCESS         Successfully created the land/water mask
+
+NOTES:
+******************************************************************************/
+int pipeline_land_water_mask_stage
+(
+    Espa_pipeline_t *pipeline,    /* I: pipeline handle for the scene */
+    void *arg,                    /* I: name of land mass polygon file
+                                        (char *) */
+    Espa_internal_meta_t *out_meta /* O: metadata of the mask band */
+)
+{
+    return (create_land_water_mask (&pipeline->metadata, (char *) arg,
+        out_meta));
+}
+
+
+/******************************************************************************
+MODULE:  add_pipeline_land_water_mask
+
+PURPOSE: Creates the land/water mask for the scene in the pipeline and adds
+it to the metadata.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water mask
+SUCCESS         Successfully created the land/water mask
+
+NOTES:
+******************************************************************************/
+int add_pipeline_land_water_mask
+(
+    Espa_pipeline_t *pipeline,    /* I/O: pipeline handle for the scene */
+    const char land_mass_polygon[] /* I: name of land mass polygon file */
+)
+{
+    return (run_pipeline_stage (pipeline, PIPELINE_LAND_WATER_MASK_STAGE,
+        NULL, pipeline_land_water_mask_stage, (void *) land_mass_polygon));
+}
@@ -0,0 +1,408 @@
+/*****************************************************************************
+FILE: build_espa_catalog
+
+PURPOSE: Creates or updates the catalog of ESPA products from XML metadata
+files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#define _XOPEN_SOURCE 700
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "error_handler.h"
+#include "espa_catalog.h"
+
+/* XML files gathered from the command line, list file and directories */
+typedef struct
+{
+    char **name;          /* absolute names of the XML files */
+    int count;            /* number of XML files */
+    int size;             /* allocated size of name */
+} Xml_file_list_t;
+
+/* List being filled by the directory walk; nftw has no user argument */
+static Xml_file_list_t *walk_list = NULL;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("build_espa_catalog creates or updates the catalog of ESPA "
+            "products, which indexes the global metadata and a summary of "
+            "the bands of each XML file so the products can be found with "
+            "query_espa_catalog.  Only the XML files which are new or were "
+            "modified since the last update are parsed, and XML files which "
+            "no longer exist are removed from the catalog.\n\n");
+    printf ("usage: build_espa_catalog --catalog=catalog_filename "
+            "[--list=xml_list_filename] [--threads=nthreads] "
+            "[xml_file_or_directory ...]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -catalog: name of the catalog file to be created or "
+            "updated\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -list: name of a file listing one XML file per line, or - "
+            "for the standard input\n");
+    printf ("    -threads: number of threads parsing the XML files, from 1 "
+            "to %d (default is the number of processors)\n",
+            ESPA_CATALOG_MAX_THREADS);
+    printf ("    xml_file_or_directory: XML files to be cataloged; "
+            "directories are searched recursively for .xml files\n");
+    printf ("\nExample: build_espa_catalog --catalog=archive.espacat "
+            "/data/espa/2013\n");
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_file
+
+PURPOSE:  Adds the absolute name of an XML file to the list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the list
+SUCCESS         The XML file was added, or skipped with a warning if its
+                absolute name couldn't be determined
+
+NOTES:
+  1. The absolute name is used so the catalog refers to the same file no
+     matter which directory it is updated from.
+******************************************************************************/
+static int add_xml_file
+(
+    Xml_file_list_t *list,  /* I/O: list of XML files */
+    const char *xml_file    /* I: name of the XML file */
+)
+{
+    char FUNC_NAME[] = "add_xml_file";   /* function name */
+    char errmsg[STR_SIZE];               /* error message */
+    char abs_name[PATH_MAX];             /* absolute name of the XML file */
+    char **name = NULL;                  /* reallocated list */
+
+    if (realpath (xml_file, abs_name) == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Skipping %s which doesn't exist",
+            xml_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (SUCCESS);
+    }
+
+    if (list->count == list->size)
+    {
+        list->size = (list->size > 0) ? list->size * 2 : 1024;
+        name = realloc (list->name, list->size * sizeof (char *));
+        if (name == NULL)
+        {
+            sprintf (errmsg, "Allocating the list of XML files");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        list->name = name;
+    }
+
+    list->name[list->count] = strdup (abs_name);
+    if (list->name[list->count] == NULL)
+    {
+        sprintf (errmsg, "Allocating the list of XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    list->count++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  walk_xml_file
+
+PURPOSE:  nftw callback adding the .xml files found in a directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               Continue the walk
+1               Error adding the file; stop the walk
+
+NOTES:
+******************************************************************************/
+static int walk_xml_file
+(
+    const char *path,            /* I: name of the file */
+    const struct stat *sb,       /* I: status of the file */
+    int typeflag,                /* I: type of the file */
+    struct FTW *ftwbuf           /* I: position in the walk */
+)
+{
+    size_t len = strlen (path);  /* length of the name */
+
+    if (typeflag == FTW_F && len > 4 && !strcmp (path + len - 4, ".xml"))
+    {
+        if (add_xml_file (walk_list, path) != SUCCESS)
+            return (1);
+    }
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_list
+
+PURPOSE:  Adds the XML files named in a list file, one per line.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the list file or allocating the list
+SUCCESS         The XML files were added
+
+NOTES:
+******************************************************************************/
+static int add_xml_list
+(
+    Xml_file_list_t *list,   /* I/O: list of XML files */
+    const char *list_file    /* I: name of the list file; - for stdin */
+)
+{
+    char FUNC_NAME[] = "add_xml_list";   /* function name */
+    char errmsg[STR_SIZE];               /* error message */
+    char line[PATH_MAX];                 /* line of the list file */
+    FILE *fptr = NULL;                   /* list file pointer */
+    size_t len;                          /* length of the line */
+    int status = SUCCESS;                /* return status */
+
+    if (!strcmp (list_file, "-"))
+        fptr = stdin;
+    else
+        fptr = fopen (list_file, "r");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the list file %s", list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (status == SUCCESS && fgets (line, sizeof (line), fptr) != NULL)
+    {
+        len = strlen (line);
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' ||
+            line[len-1] == ' ' || line[len-1] == '\t'))
+            line[--len] = '\0';
+        if (len > 0)
+            status = add_xml_file (list, line);
+    }
+
+    if (fptr != stdin)
+        fclose (fptr);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the catalog file and the list of XML files.
+     The caller is responsible for freeing the allocated memory upon
+     successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,               /* I: number of cmd-line args */
+    char *argv[],           /* I: string of cmd-line args */
+    char **catalog_file,    /* O: address of the catalog filename */
+    Xml_file_list_t *list,  /* O: XML files to be cataloged */
+    int *nthreads           /* O: number of parsing threads */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    struct stat arg_stat;            /* status of an XML file or directory */
+    static struct option long_options[] =
+    {
+        {"catalog", required_argument, 0, 'c'},
+        {"list", required_argument, 0, 'l'},
+        {"threads", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'c':  /* catalog file */
+                *catalog_file = strdup (optarg);
+                break;
+
+            case 'l':  /* list of XML files */
+                if (add_xml_list (list, optarg) != SUCCESS)
+                    return (ERROR);
+                break;
+
+            case 't':  /* number of threads */
+                *nthreads = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the catalog file was specified */
+    if (*catalog_file == NULL)
+    {
+        sprintf (errmsg, "Catalog file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of threads is valid */
+    if (*nthreads < 1 || *nthreads > ESPA_CATALOG_MAX_THREADS)
+    {
+        sprintf (errmsg, "Number of threads must be from 1 to %d",
+            ESPA_CATALOG_MAX_THREADS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Add the XML files and search the directories */
+    walk_list = list;
+    for (; optind < argc; optind++)
+    {
+        if (stat (argv[optind], &arg_stat) == 0 && S_ISDIR (arg_stat.st_mode))
+        {
+            if (nftw (argv[optind], walk_xml_file, 32, FTW_PHYS) != 0)
+            {
+                sprintf (errmsg, "Searching %s for XML files", argv[optind]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else if (add_xml_file (list, argv[optind]) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates or updates the catalog with the XML files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error updating the catalog
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The XML files already in the catalog are always checked, so running
+     with no XML files refreshes the catalog.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *catalog_file = NULL;     /* catalog filename */
+    Xml_file_list_t list = {NULL, 0, 0};  /* XML files to be cataloged */
+    Espa_catalog_counts_t counts;  /* what the update did */
+    long nprocs = sysconf (_SC_NPROCESSORS_ONLN);  /* number of processors */
+    int nthreads;                  /* number of parsing threads */
+    int status;                    /* status of the update */
+    int i;                         /* looping variable */
+
+    nthreads = (nprocs < 1) ? 1 : (nprocs > ESPA_CATALOG_MAX_THREADS) ?
+        ESPA_CATALOG_MAX_THREADS : (int) nprocs;
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &catalog_file, &list, &nthreads) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Update the catalog */
+    status = update_espa_catalog (catalog_file, list.count, list.name,
+        nthreads, &counts);
+    if (status == SUCCESS)
+    {
+        printf ("%s: %d scenes (%d parsed, %d unchanged, %d removed, "
+            "%d failed)\n", catalog_file, counts.nscenes, counts.nparsed,
+            counts.nreused, counts.nremoved, counts.nfailed);
+    }
+
+    /* Free the pointers */
+    for (i = 0; i < list.count; i++)
+        free (list.name[i]);
+    free (list.name);
+    free (catalog_file);
+
+    /* Successful completion */
+    exit (status);
+}
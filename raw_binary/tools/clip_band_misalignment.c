@@ -17,6 +17,7 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "clip_band_misalignment.h"
+#include "espa_batch.h"
 
 /******************************************************************************
 MODULE: usage
@@ -37,10 +38,19 @@ void usage ()
             "band clipping.\n\n");
     printf ("usage: clip_band_misalignment "
             "--xml=output_xml_filename\n");
+    printf ("       clip_band_misalignment --scene_list=scene_list_filename "
+            "[--procs=nprocs]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
     printf ("\nExample: clip_band_misalignment "
             "--xml=LE70230282011250EDC00.xml\n");
 }
@@ -69,7 +79,9 @@ short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **xml_infile     /* O: address of input XML filename */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
@@ -79,6 +91,8 @@ short get_args
     static struct option long_options[] =
     {
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -110,7 +124,15 @@ short get_args
             case 'i':  /* XML infile */
                 *xml_infile = strdup (optarg);
                 break;
-     
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -121,10 +143,21 @@ short get_args
         }
     }
 
-    /* Make sure the infiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
@@ -134,6 +167,33 @@ short get_args
 }
 
 
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Clips the band-misalignment of one TM or ETM+ product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error clipping the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: not used */
+)
+{
+    /* Clip the bands */
+    return (clip_band_misalignment (xml_infile));
+}
+
+
 /******************************************************************************
 MODULE:  main
 
@@ -153,21 +213,32 @@ NOTES:
 int main (int argc, char** argv)
 {
     char *xml_infile = NULL;     /* input XML filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile) != SUCCESS)
+    if (get_args (argc, argv, &xml_infile, &scene_list, &nprocs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Clip the bands */
-    if (clip_band_misalignment (xml_infile) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
+    if (scene_list != NULL)
+    {
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene, NULL);
     }
+    else
+        status = process_scene (xml_infile, NULL, NULL);
 
     /* Free the pointers */
     free (xml_infile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+        exit (EXIT_FAILURE);
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
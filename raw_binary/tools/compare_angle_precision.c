@@ -0,0 +1,220 @@
+/*****************************************************************************
+FILE: compare_angle_precision
+
+PURPOSE: Compares the Landsat 8 per-pixel angles generated with the angle
+vectors converted in single precision against those converted in double
+precision, and reports the largest difference at the output resolution and
+the time taken by each.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Single precision is used by create_angle_bands when the
+     ESPA_ANGLE_PRECISION environment variable is set to "single".
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "angle_bands.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("compare_angle_precision evaluates the Landsat 8 solar and view "
+            "(satellite) per-pixel angles of each band with the angle vectors "
+            "converted in double and in single precision, and reports the "
+            "largest difference in hundredths of a degree (the resolution of "
+            "the angle bands).\n\n");
+    printf ("usage: compare_angle_precision "
+            "--ang=input_angle_coefficient_filename [--line_step=nlines]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -ang: name of the input angle coefficient file (_ANG.txt)\n");
+    printf ("    -line_step: compare every nlines lines of each band "
+            "(default is 10).\n");
+
+    printf ("\nExample: compare_angle_precision "
+            "--ang=LC80470272013287LGN00_ANG.txt\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file.  This should be a character
+     pointer set to NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **ang_infile,    /* O: address of input angle coefficient filename */
+    int *line_step        /* O: spacing of the lines compared */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"ang", required_argument, 0, 'i'},
+        {"line_step", required_argument, 0, 'l'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* angle coefficient file */
+                *ang_infile = strdup (optarg);
+                break;
+
+            case 'l':  /* line spacing */
+                *line_step = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infile was specified */
+    if (*ang_infile == NULL)
+    {
+        sprintf (errmsg, "Input angle coefficient file is a required "
+            "argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the line spacing is valid */
+    if (*line_step < 1)
+    {
+        sprintf (errmsg, "Line step must be 1 or more");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Compares the single and double precision per-pixel angles.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error comparing the angles, or the single precision angles
+                differ by more than one step of the output resolution
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "compare_angle_precision";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *ang_infile = NULL;     /* input angle coefficient filename */
+    int line_step = 10;          /* spacing of the lines compared */
+    int max_diff;                /* largest quantized difference */
+    long num_diff;               /* number of quantized angles that differ */
+    long num_angles;             /* number of quantized angles compared */
+    double double_seconds;       /* time in double precision */
+    double single_seconds;       /* time in single precision */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &ang_infile, &line_step) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (l8_compare_angle_precision (ang_infile, line_step, &max_diff,
+        &num_diff, &num_angles, &double_seconds, &single_seconds) != SUCCESS)
+    {
+        sprintf (errmsg, "Comparing the angle precision for %s", ang_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    printf ("Compared %ld angles: %ld differ, largest difference %d "
+        "(degrees * 100)\n", num_angles, num_diff, max_diff);
+    printf ("Double precision: %.3f seconds, single precision: %.3f "
+        "seconds\n", double_seconds, single_seconds);
+
+    free (ang_infile);
+
+    /* Angles on either side of a quantization step can round differently,
+       but anything more means the single precision isn't good enough */
+    if (max_diff > 1)
+    {
+        sprintf (errmsg, "Single precision angles differ by more than the "
+            "output resolution");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Successful completion */
+    exit (SUCCESS);
+}
@@ -2,7 +2,7 @@
 FILE: convert_espa_to_bip
   
 PURPOSE: Contains functions for converting the ESPA raw binary file format
-to raw binary band interleave by pixel (BIP).
+to raw binary band interleave by pixel (BIP) or by line (BIL).
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
@@ -17,6 +17,16 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_espa_to_raw_binary_bip.h"
+#include "espa_batch.h"
+
+/* Options for converting each product */
+typedef struct
+{
+    bool convert_qa;             /* should the QA bands (UINT8) be converted to
+                                    the native data type? */
+    bool del_src;                /* should source files be removed? */
+    Espa_interleave_t interleave;  /* interleaving of the output file */
+} Bip_convert_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -36,21 +46,38 @@ void usage ()
             "the input XML file will be written to a single raw binary file "
             "with the all the bands for a single pixel being written, "
             "followed by all the bands for the next pixel, etc. An associated "
-            "ENVI header file will be written for this raw binary file.\n\n");
+            "ENVI header file will be written for this raw binary file.  "
+            "With --interleave=bil the bands are instead interleaved by "
+            "line: line 1 of each band, followed by line 2 of each band, "
+            "etc.\n\n");
     printf ("usage: convert_espa_to_bip "
             "--xml=input_metadata_filename "
             "--bip=output_bip_filename "
-            "[--convert_qa] [--del_src_files]\n");
+            "[--interleave=bip|bil] [--convert_qa] [--del_src_files]\n");
+    printf ("       convert_espa_to_bip --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--interleave=bip|bil] [--convert_qa] "
+            "[--del_src_files]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
-    printf ("    -bip: filename of the output raw binary BIP file\n");
+    printf ("    -bip: filename of the output raw binary BIP (or BIL) "
+            "file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -interleave: bip to interleave the bands by pixel, or bil to "
+            "interleave them by line (default is bip)\n");
     printf ("    -convert_qa: should the QA bands (UINT8) be converted to the "
             "native data type of the first band, if QA bands are actually of "
             "a different data type from the other bands.\n");
     printf ("    -del_src_files: if specified the source image and header "
             "files will be removed\n");
+    printf ("    -scene_list: instead of -xml and -bip, name of a file "
+            "listing the XML file and the output BIP filename of each "
+            "product to be processed, one product per line, or - for the "
+            "standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
     printf ("\nExample: convert_espa_to_bip "
             "--xml=LE70230282011250EDC00.xml "
             "--bip=LE70230282011250EDC00.img\n");
@@ -85,7 +112,10 @@ short get_args
     bool *convert_qa,     /* O: should the QA bands (uint8) be converted to
                                 the data type of band 1 (if QA bands are of
                                 a different data type)? */
-    bool *del_src         /* O: should source files be removed? */
+    bool *del_src,        /* O: should source files be removed? */
+    Espa_interleave_t *interleave, /* O: interleaving of the output file */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
@@ -99,7 +129,10 @@ short get_args
         {"del_src_files", no_argument, &del_flag, 1},
         {"convert_qa", no_argument, &convert_flag, 1},
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
         {"bip", required_argument, 0, 'o'},
+        {"interleave", required_argument, 0, 'I'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -136,6 +169,29 @@ short get_args
                 *bip_outfile = strdup (optarg);
                 break;
      
+            case 'I':  /* interleave */
+                if (!strcasecmp (optarg, "bip"))
+                    *interleave = ESPA_INTERLEAVE_BIP;
+                else if (!strcasecmp (optarg, "bil"))
+                    *interleave = ESPA_INTERLEAVE_BIL;
+                else
+                {
+                    sprintf (errmsg, "Unknown interleave %s; must be bip or "
+                        "bil", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -146,18 +202,32 @@ short get_args
         }
     }
 
-    /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
-    if (*bip_outfile == NULL)
+    /* The output file is required with the XML input file, and is given by
+       the scene list otherwise */
+    if ((*xml_infile == NULL) != (*bip_outfile == NULL))
     {
-        sprintf (errmsg, "BIP output file is a required argument");
+        sprintf (errmsg, "BIP output file is a required argument with the XML "
+            "input file, and can't be used with the scene list");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
@@ -175,6 +245,49 @@ short get_args
 }
 
 
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Converts one ESPA internal format product to raw binary band
+interleave per pixel.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *bip_outfile,    /* I: output BIP filename */
+    void *arg             /* I: conversion options (Bip_convert_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    Bip_convert_options_t *opts = arg;  /* conversion options */
+
+    /* The scene list has to give the output file */
+    if (bip_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the output BIP filename "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the internal ESPA raw binary product to raw binary BIP or
+       BIL */
+    return (convert_espa_to_raw_binary_interleave (xml_infile, bip_outfile,
+        opts->interleave, opts->convert_qa, opts->del_src));
+}
+
+
 /******************************************************************************
 MODULE:  main
 
@@ -193,6 +306,8 @@ ERROR           Error doing the conversion
 SUCCESS         No errors encountered
 
 NOTES:
+  1. With a scene list, each product of the list is converted the same
+     way.
   1. The bands in the XML file will be written, in order, to the BIP file.
      These bands must be of the same datatype and same size, otherwise this
      function will exit with an error.
@@ -205,27 +320,36 @@ int main (int argc, char** argv)
 {
     char *xml_infile = NULL;     /* input XML filename */
     char *bip_outfile = NULL;    /* output BIP filename */
-    bool convert_qa = false;     /* should the QA bands (UINT8) be converted to
-                                    the native data type? */
-    bool del_src = false;        /* should source files be removed? */
+    char *scene_list = NULL;     /* list of products to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* return status of the conversion */
+    Bip_convert_options_t opts;  /* conversion options */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &bip_outfile, &convert_qa,
-        &del_src) != SUCCESS)
+    opts.convert_qa = false;
+    opts.del_src = false;
+    opts.interleave = ESPA_INTERLEAVE_BIP;
+    if (get_args (argc, argv, &xml_infile, &bip_outfile, &opts.convert_qa,
+        &opts.del_src, &opts.interleave, &scene_list, &nprocs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the internal ESPA raw binary product to raw binary BIP */
-    if (convert_espa_to_raw_binary_bip (xml_infile, bip_outfile, convert_qa,
-        del_src) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
-    }
+    /* Convert the products of the scene list, or the single product */
+    if (scene_list != NULL)
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+    else
+        status = process_scene (xml_infile, bip_outfile, &opts);
 
     /* Free the pointers */
     free (xml_infile);
     free (bip_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -17,6 +17,16 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_espa_to_gtif.h"
+#include "espa_batch.h"
+
+/* Options for converting each product */
+typedef struct
+{
+    bool del_src;                /* should source files be removed? */
+    bool cog;                    /* should COGs be written? */
+    Gtif_compress_t compress;    /* tile compression */
+    Gtif_interleave_t interleave;  /* band layout */
+} Gtif_convert_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -34,18 +44,43 @@ void usage ()
             "binary and associated XML metadata file) to GeoTIFF.  Each "
             "band represented in the input XML file will be written to a "
             "single GeoTIFF file using the base filename provided followed "
-            "by the band name with a .tif file extension.\n\n");
+            "by the band name with a .tif file extension.  The bands can "
+            "optionally be written as Cloud-Optimized GeoTIFFs, or the bands "
+            "of each product can be written to a single multi-band GeoTIFF "
+            "file.\n\n");
     printf ("usage: convert_espa_to_gtif "
             "--xml=input_metadata_filename "
             "--gtif=output_geotiff_base_filename "
+            "[--cog] [--compress=none|deflate|zstd] "
+            "[--interleave=none|band|pixel] "
             "[--del_src_files]\n");
+    printf ("       convert_espa_to_gtif --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--cog] [--compress=none|deflate|zstd] "
+            "[--interleave=none|band|pixel] [--del_src_files]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
     printf ("    -gtif: base filename of the output GeoTIFF files\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -cog: if specified each band is written as a "
+            "Cloud-Optimized GeoTIFF with internal overviews\n");
+    printf ("    -compress: compression of the GeoTIFF tiles; zstd requires "
+            "libtiff built with zstd support (default is none, or deflate "
+            "if -cog is specified)\n");
+    printf ("    -interleave: write the bands of each product which have the "
+            "same size and data type to a single GeoTIFF file named with the "
+            "product, interleaved by band or by pixel.  Can't be used with "
+            "-cog.  (default is none, one file per band)\n");
     printf ("    -del_src_files: if specified the source image and header "
             "files will be removed\n");
+    printf ("    -scene_list: instead of -xml and -gtif, name of a file "
+            "listing the XML file and the output GeoTIFF base filename of "
+            "each product to be processed, one product per line, or - for "
+            "the standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
     printf ("\nExample: convert_espa_to_gtif "
             "--xml=LE70230282011250EDC00.xml "
             "--gtif=LE70230282011250EDC00\n");
@@ -77,7 +112,12 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **gtif_outfile,  /* O: address of output GeoTIFF base filename */
-    bool *del_src         /* O: should source files be removed? */
+    Gtif_compress_t *compress, /* O: compression of the GeoTIFF tiles */
+    bool *cog,            /* O: should Cloud-Optimized GeoTIFFs be written? */
+    Gtif_interleave_t *interleave, /* O: layout of the bands of a product */
+    bool *del_src,        /* O: should source files be removed? */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
@@ -85,10 +125,17 @@ short get_args
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int cog_flag = 0;         /* flag for writing COGs */
+    bool compress_set = false;       /* was the compression specified? */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"cog", no_argument, &cog_flag, 1},
+        {"compress", required_argument, 0, 'c'},
+        {"interleave", required_argument, 0, 'l'},
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
         {"gtif", required_argument, 0, 'o'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -125,7 +172,50 @@ short get_args
             case 'o':  /* GeoTIFF base outfile */
                 *gtif_outfile = strdup (optarg);
                 break;
+
+            case 'c':  /* tile compression */
+                if (!strcmp (optarg, "none"))
+                    *compress = GTIF_COMPRESS_NONE;
+                else if (!strcmp (optarg, "deflate"))
+                    *compress = GTIF_COMPRESS_DEFLATE;
+                else if (!strcmp (optarg, "zstd"))
+                    *compress = GTIF_COMPRESS_ZSTD;
+                else
+                {
+                    sprintf (errmsg, "Unknown compression type: %s.  Valid "
+                        "values are none, deflate, and zstd.", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                compress_set = true;
+                break;
+
+            case 'l':  /* band interleave */
+                if (!strcmp (optarg, "none"))
+                    *interleave = GTIF_INTERLEAVE_NONE;
+                else if (!strcmp (optarg, "band"))
+                    *interleave = GTIF_INTERLEAVE_BAND;
+                else if (!strcmp (optarg, "pixel"))
+                    *interleave = GTIF_INTERLEAVE_PIXEL;
+                else
+                {
+                    sprintf (errmsg, "Unknown interleave: %s.  Valid values "
+                        "are none, band, and pixel.", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
      
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -136,18 +226,32 @@ short get_args
         }
     }
 
-    /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
-    if (*gtif_outfile == NULL)
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "GeoTIFF base output file is a required argument");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The output file is required with the XML input file, and is given by
+       the scene list otherwise */
+    if ((*xml_infile == NULL) != (*gtif_outfile == NULL))
+    {
+        sprintf (errmsg, "GeoTIFF base output file is a required argument "
+            "with the XML input file, and can't be used with the scene list");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
@@ -157,10 +261,69 @@ short get_args
     if (del_flag)
         *del_src = true;
 
+    /* Check the COG flag; COGs are compressed with deflate unless another
+       compression was specified */
+    if (cog_flag && *interleave != GTIF_INTERLEAVE_NONE)
+    {
+        sprintf (errmsg, "--cog can't be used with interleaved bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (cog_flag)
+    {
+        *cog = true;
+        if (!compress_set)
+            *compress = GTIF_COMPRESS_DEFLATE;
+    }
+
     return (SUCCESS);
 }
 
 
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Converts one ESPA internal format product to GeoTIFF.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *gtif_outfile,   /* I: output GeoTIFF base filename */
+    void *arg             /* I: conversion options
+                                (Gtif_convert_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    Gtif_convert_options_t *opts = arg;  /* conversion options */
+
+    /* The scene list has to give the output file */
+    if (gtif_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the output GeoTIFF "
+            "base filename for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the internal ESPA raw binary product to GeoTIFF */
+    return (convert_espa_to_gtif (xml_infile, gtif_outfile, opts->compress,
+        opts->cog, opts->interleave, opts->del_src));
+}
+
+
 /******************************************************************************
 MODULE:  main
 
@@ -177,28 +340,45 @@ ERROR           Error doing the conversion
 SUCCESS         No errors encountered
 
 NOTES:
+  1. With a scene list, each product of the list is converted the same
+     way.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
     char *xml_infile = NULL;     /* input XML filename */
-    char *gtif_outfile = NULL;   /* output base GeoTIFF filename */
-    bool del_src = false;        /* should source files be removed? */
+    char *gtif_outfile = NULL;   /* output GeoTIFF base filename */
+    char *scene_list = NULL;     /* list of products to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* return status of the conversion */
+    Gtif_convert_options_t opts;  /* conversion options */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &gtif_outfile, &del_src) != SUCCESS)
+    opts.del_src = false;
+    opts.cog = false;
+    opts.compress = GTIF_COMPRESS_NONE;
+    opts.interleave = GTIF_INTERLEAVE_NONE;
+    if (get_args (argc, argv, &xml_infile, &gtif_outfile, &opts.compress,
+        &opts.cog, &opts.interleave, &opts.del_src, &scene_list, &nprocs)
+        != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the internal ESPA raw binary product to GeoTIFF */
-    if (convert_espa_to_gtif (xml_infile, gtif_outfile, del_src) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
-    }
+    /* Convert the products of the scene list, or the single product */
+    if (scene_list != NULL)
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+    else
+        status = process_scene (xml_infile, gtif_outfile, &opts);
 
     /* Free the pointers */
     free (xml_infile);
     free (gtif_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -17,6 +17,15 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_espa_to_hdf.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Options for converting each product */
+typedef struct
+{
+    bool del_src;                /* should source files be removed? */
+    Hdf_compress_t compress;     /* SDS compression */
+} Hdf_convert_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -34,18 +43,39 @@ void usage ()
             "binary and associated XML metadata file) to HDF-EOS2 (HDF4).  "
             "Each band represented in the input XML file will be written to a "
             "a single HDF file with each SDS being represented as an external "
-            "dataset.\n\n");
+            "dataset, or as a chunked, compressed SDS if compression is "
+            "specified.\n\n");
     printf ("usage: convert_espa_to_hdf "
             "--xml=input_metadata_filename "
             "--hdf=output_hdf_filename "
-            "[--del_src_files]\n");
+            "[--compress=none|deflate|szip] "
+            "[--del_src_files] [--max_memory=size]\n");
+    printf ("       convert_espa_to_hdf --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--compress=none|deflate|szip] "
+            "[--del_src_files] [--max_memory=size]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
     printf ("    -hdf: filename of the output HDF file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -compress: write the bands into the HDF file as chunked "
+            "SDSs compressed with deflate or szip, instead of as external "
+            "datasets (default is none)\n");
     printf ("    -del_src_files: if specified the source image and header "
             "files will be removed\n");
+    printf ("    -scene_list: instead of -xml and -hdf, name of a file "
+            "listing the XML file and the output HDF filename of each "
+            "product to be processed, one product per line, or - for the "
+            "standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks and "
+            "threads are sized to fit it, and the scene list workers share "
+            "it (default is the ESPA_MAX_MEMORY environment variable, or no "
+            "budget)\n");
     printf ("\nExample: convert_espa_to_hdf "
             "--xml=LE70230282011250EDC00.xml "
             "--hdf=LE70230282011250EDC00.hdf\n");
@@ -77,7 +107,10 @@ short get_args
     char *argv[],         /* I: string of cmd-line args */
     char **xml_infile,    /* O: address of input XML filename */
     char **hdf_outfile,   /* O: address of output HDF filename */
-    bool *del_src         /* O: should source files be removed? */
+    Hdf_compress_t *compress, /* O: storage/compression for the SDSs */
+    bool *del_src,        /* O: should source files be removed? */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
@@ -89,7 +122,11 @@ short get_args
     {
         {"del_src_files", no_argument, &del_flag, 1},
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
         {"hdf", required_argument, 0, 'o'},
+        {"compress", required_argument, 0, 'c'},
+        {"max_memory", required_argument, 0, 'M'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -125,7 +162,40 @@ short get_args
             case 'o':  /* HDF outfile */
                 *hdf_outfile = strdup (optarg);
                 break;
+
+            case 'c':  /* SDS compression */
+                if (!strcmp (optarg, "none"))
+                    *compress = HDF_COMPRESS_NONE;
+                else if (!strcmp (optarg, "deflate"))
+                    *compress = HDF_COMPRESS_DEFLATE;
+                else if (!strcmp (optarg, "szip"))
+                    *compress = HDF_COMPRESS_SZIP;
+                else
+                {
+                    sprintf (errmsg, "Unknown compression type: %s.  Valid "
+                        "values are none, deflate, and szip.", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
      
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -136,18 +206,32 @@ short get_args
         }
     }
 
-    /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
-    if (*hdf_outfile == NULL)
+    /* The output file is required with the XML input file, and is given by
+       the scene list otherwise */
+    if ((*xml_infile == NULL) != (*hdf_outfile == NULL))
     {
-        sprintf (errmsg, "HDF output file is a required argument");
+        sprintf (errmsg, "HDF output file is a required argument with the XML "
+            "input file, and can't be used with the scene list");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
@@ -161,6 +245,48 @@ short get_args
 }
 
 
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Converts one ESPA internal format product to HDF-EOS2 (HDF4).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *hdf_outfile,    /* I: output HDF filename */
+    void *arg             /* I: conversion options (Hdf_convert_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    Hdf_convert_options_t *opts = arg;  /* conversion options */
+
+    /* The scene list has to give the output file */
+    if (hdf_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the output HDF filename "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the internal ESPA raw binary product to HDF with external or
+       compressed SDSs */
+    return (convert_espa_to_hdf (xml_infile, hdf_outfile, opts->compress,
+        opts->del_src));
+}
+
+
 /******************************************************************************
 MODULE:  main
 
@@ -177,28 +303,42 @@ ERROR           Error doing the conversion
 SUCCESS         No errors encountered
 
 NOTES:
+  1. With a scene list, each product of the list is converted the same
+     way.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
     char *xml_infile = NULL;     /* input XML filename */
     char *hdf_outfile = NULL;    /* output HDF filename */
-    bool del_src = false;        /* should source files be removed? */
+    char *scene_list = NULL;     /* list of products to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* return status of the conversion */
+    Hdf_convert_options_t opts;  /* conversion options */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &hdf_outfile, &del_src) != SUCCESS)
+    opts.del_src = false;
+    opts.compress = HDF_COMPRESS_NONE;
+    if (get_args (argc, argv, &xml_infile, &hdf_outfile, &opts.compress,
+        &opts.del_src, &scene_list, &nprocs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the internal ESPA raw binary product to HDF with external SDSs */
-    if (convert_espa_to_hdf (xml_infile, hdf_outfile, del_src) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
-    }
+    /* Convert the products of the scene list, or the single product */
+    if (scene_list != NULL)
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+    else
+        status = process_scene (xml_infile, hdf_outfile, &opts);
 
     /* Free the pointers */
     free (xml_infile);
     free (hdf_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
@@ -0,0 +1,342 @@
+/*****************************************************************************
+FILE: convert_espa_to_netcdf
+
+PURPOSE: Contains functions for converting the ESPA raw binary file format
+to a NetCDF-4 file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed via this library follows the ESPA
+     internal metadata format found in ESPA Raw Binary Format v1.0.doc.  The
+     schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "convert_espa_to_netcdf.h"
+#include "espa_batch.h"
+
+/* Options for converting each product */
+typedef struct
+{
+    int chunk_lines;             /* number of lines in a chunk */
+    int chunk_samps;             /* number of samples in a chunk */
+    int level;                   /* deflate level */
+} Netcdf_convert_options_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_espa_to_netcdf converts the ESPA internal format (raw "
+            "binary and associated XML metadata file) to a NetCDF-4 (HDF5) "
+            "file following the CF conventions.  Each band represented in "
+            "the input XML file is written to a chunked variable named after "
+            "the band, with the band metadata as its attributes and the "
+            "global metadata as the global attributes.  The chunks are "
+            "shuffled and deflated in parallel.\n\n");
+    printf ("usage: convert_espa_to_netcdf "
+            "--xml=input_metadata_filename "
+            "--netcdf=output_netcdf_filename "
+            "[--chunk_lines=nlines] [--chunk_samps=nsamps] [--level=n]\n");
+    printf ("       convert_espa_to_netcdf --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--chunk_lines=nlines] [--chunk_samps=nsamps] "
+            "[--level=n]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -netcdf: name of the output NetCDF-4 file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -chunk_lines: number of lines in each chunk, from 1 to %d "
+            "(default is %d)\n", NETCDF_MAX_CHUNK_SIZE, NETCDF_CHUNK_SIZE);
+    printf ("    -chunk_samps: number of samples in each chunk, from 1 to %d "
+            "(default is %d)\n", NETCDF_MAX_CHUNK_SIZE, NETCDF_CHUNK_SIZE);
+    printf ("    -level: deflate level of the chunks, from 0 "
+            "(stored) to 9 (default is %d)\n", NETCDF_DEFLATE_LEVEL);
+    printf ("    -scene_list: instead of -xml and -netcdf, name of a file "
+            "listing the XML file and the output NetCDF file of each product "
+            "to be processed, one product per line, or - for the standard "
+            "input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("\nExample: convert_espa_to_netcdf "
+            "--xml=LE70230282011250EDC00.xml "
+            "--netcdf=LE70230282011250EDC00.nc --chunk_lines=1024 "
+            "--chunk_samps=1024\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **netcdf_outfile, /* O: address of output NetCDF filename */
+    Netcdf_convert_options_t *opts, /* O: chunking and compression */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"netcdf", required_argument, 0, 'o'},
+        {"chunk_lines", required_argument, 0, 'l'},
+        {"chunk_samps", required_argument, 0, 's'},
+        {"level", required_argument, 0, 'z'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* NetCDF outfile */
+                *netcdf_outfile = strdup (optarg);
+                break;
+
+            case 'l':  /* chunk lines */
+                opts->chunk_lines = atoi (optarg);
+                break;
+
+            case 's':  /* chunk samples */
+                opts->chunk_samps = atoi (optarg);
+                break;
+
+            case 'z':  /* deflate level */
+                opts->level = atoi (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The output file is required with the XML input file, and is given
+       by the scene list otherwise */
+    if ((*xml_infile == NULL) != (*netcdf_outfile == NULL))
+    {
+        sprintf (errmsg, "NetCDF output file is a required argument with the "
+            "XML input file, and can't be used with the scene list");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the chunking and deflate level are valid */
+    if (opts->chunk_lines < 1 || opts->chunk_lines > NETCDF_MAX_CHUNK_SIZE ||
+        opts->chunk_samps < 1 || opts->chunk_samps > NETCDF_MAX_CHUNK_SIZE)
+    {
+        sprintf (errmsg, "Chunk lines and samples must be from 1 to %d",
+            NETCDF_MAX_CHUNK_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (opts->level < 0 || opts->level > 9)
+    {
+        sprintf (errmsg, "Deflate level must be from 0 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Converts one ESPA internal format product to a NetCDF-4 file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *netcdf_outfile, /* I: output NetCDF filename */
+    void *arg             /* I: conversion options
+                                (Netcdf_convert_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    Netcdf_convert_options_t *opts = arg;  /* conversion options */
+
+    /* The scene list has to give the output file */
+    if (netcdf_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the output NetCDF file "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the internal ESPA raw binary product to NetCDF */
+    return (convert_espa_to_netcdf (xml_infile, netcdf_outfile,
+        opts->chunk_lines, opts->chunk_samps, opts->level));
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Converts the ESPA internal format (raw binary and associated XML
+metadata file) to a NetCDF-4 file.  Each band represented in the input XML
+file will be written to a chunked, compressed variable of the file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. With a scene list, each product of the list is converted the same
+     way.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;     /* input XML filename */
+    char *netcdf_outfile = NULL; /* output NetCDF filename */
+    char *scene_list = NULL;     /* list of products to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* return status of the conversion */
+    Netcdf_convert_options_t opts;  /* conversion options */
+
+    /* Read the command-line arguments */
+    opts.chunk_lines = NETCDF_CHUNK_SIZE;
+    opts.chunk_samps = NETCDF_CHUNK_SIZE;
+    opts.level = NETCDF_DEFLATE_LEVEL;
+    if (get_args (argc, argv, &xml_infile, &netcdf_outfile, &opts,
+        &scene_list, &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Convert the products of the scene list, or the single product */
+    if (scene_list != NULL)
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+    else
+        status = process_scene (xml_infile, netcdf_outfile, &opts);
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (netcdf_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,226 @@
+/*****************************************************************************
+FILE: convert_land_mass_polygon
+  
+PURPOSE: Converts a land-mass polygon file to the packed polygon format, which
+is memory mapped by the land/water mask code instead of being read.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+#include "error_handler.h"
+#include "ias_lw_geo.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("convert_land_mass_polygon converts a land-mass polygon file to "
+            "the packed polygon format.  The packed file holds the polygon "
+            "vertices, bounds, and a spatial index in contiguous arrays, and "
+            "is memory mapped and shared by the land/water mask applications "
+            "instead of being read by each of them.\n\n");
+    printf ("usage: convert_land_mass_polygon "
+            "--input=input_polygon_filename "
+            "--output=output_packed_polygon_filename\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -input: name of the input land-mass polygon file\n");
+    printf ("    -output: name of the output packed polygon file\n");
+    printf ("\nExample: convert_land_mass_polygon "
+            "--input=land_no_buf.ply "
+            "--output=land_no_buf.pply\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **infile,        /* O: address of input polygon filename */
+    char **outfile        /* O: address of output packed polygon filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"input", required_argument, 0, 'i'},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+     
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* polygon infile */
+                *infile = strdup (optarg);
+                break;
+     
+            case 'o':  /* packed polygon outfile */
+                *outfile = strdup (optarg);
+                break;
+     
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*infile == NULL)
+    {
+        sprintf (errmsg, "Input polygon file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*outfile == NULL)
+    {
+        sprintf (errmsg, "Output packed polygon file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Reads all the polygons in the land-mass polygon file and writes them
+to the packed polygon file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The packed polygon file can be used anywhere the land-mass polygon file
+     is used, such as for the ESPA_LAND_MASS_POLYGON environment variable.
+     The land/water mask is the same with either file.
+  2. The packed polygon file is in the native byte order of the system which
+     created it, the same as the land-mass polygon file.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "convert_land_mass_polygon";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *infile = NULL;          /* input polygon filename */
+    char *outfile = NULL;         /* output packed polygon filename */
+    FILE *fptr = NULL;            /* input polygon file pointer */
+    IAS_POLYGON_LINKED_LIST *polygon_list = NULL;  /* land-mass polygons */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &infile, &outfile) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Read all the polygons from the input file */
+    fptr = fopen (infile, "r");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Unable to open the land-mass polygon file: %s",
+            infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    if (ias_geo_load_polygon (fptr, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX,
+        &polygon_list) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the land-mass polygon file: %s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        fclose (fptr);
+        exit (EXIT_FAILURE);
+    }
+    fclose (fptr);
+
+    /* Write the packed polygon file */
+    if (ias_geo_write_packed_polygon (outfile, polygon_list) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the packed polygon file: %s", outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        ias_geo_free_polygon_linked_list (polygon_list);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the polygons and the pointers */
+    ias_geo_free_polygon_linked_list (polygon_list);
+    free (infile);
+    free (outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
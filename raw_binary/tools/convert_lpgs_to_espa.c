@@ -17,6 +17,17 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_lpgs_to_espa.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Options for converting each product */
+typedef struct
+{
+    bool del_src;                 /* should source files be removed? */
+    bool virtual_bands;           /* should the bands be left as the
+                                     GeoTIFF files (virtual product)? */
+    int nthreads;                 /* number of threads for converting bands */
+} Lpgs_convert_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -32,18 +43,120 @@ void usage ()
 {
     printf ("convert_lpgs_to_espa converts the LPGS products (MTL file and "
             "associated GeoTIFF files) to the ESPA internal format (XML "
-            "metadata file and associated raw binary files).\n\n");
+            "metadata file and associated raw binary files).  The LPGS "
+            "product can also be read directly from its .tar.gz bundle "
+            "without extracting it.\n\n");
     printf ("usage: convert_lpgs_to_espa "
-            "--mtl=input_mtl_filename "
-            "[--del_src_files]\n");
+            "--mtl=input_mtl_filename | --bundle=input_bundle_filename "
+            "[--del_src_files | --virtual] [--threads=nthreads] "
+            "[--max_memory=size]\n");
+    printf ("       convert_lpgs_to_espa --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--del_src_files | --virtual] "
+            "[--threads=nthreads] [--max_memory=size]\n");
 
-    printf ("\nwhere the following parameters are required:\n");
+    printf ("\nwhere one of the following parameters is required:\n");
     printf ("    -mtl: name of the input LPGS MTL metadata file\n");
+    printf ("    -bundle: name of the input LPGS product bundle (.tar.gz, "
+            ".tgz, or .tar).  The XML file is named after the bundle.\n");
+    printf ("    -scene_list: name of a file listing the MTL files or "
+            "bundles to be processed, one per line, optionally followed by "
+            "the output XML filename, or - for the standard input\n");
+    printf ("\nwhere the following parameters are optional:\n");
     printf ("    -del_src_files: if specified the source GeoTIFF files will "
             "be removed.  The _MTL.txt file will remain along with the "
-            "gap directory for ETM+ products.\n");
+            "gap directory for ETM+ products.  For a bundle, the bundle "
+            "is removed.\n");
+    printf ("    -virtual: if specified only the XML file is written, with "
+            "the bands pointing at the source GeoTIFF files, which are "
+            "decoded as the bands are read.  Not supported for bundles, or "
+            "with -del_src_files.\n");
+    printf ("    -threads: number of threads to use for converting the bands "
+            "in parallel (default is 1).  Only used if the application was "
+            "built with threading enabled.\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks and "
+            "threads are sized to fit it, and the scene list workers share "
+            "it (default is the ESPA_MAX_MEMORY environment variable, or no "
+            "budget)\n");
     printf ("\nExample: convert_lpgs_to_espa "
             "--mtl=LE70230282011250EDC00_MTL.txt\n");
+    printf ("         convert_lpgs_to_espa "
+            "--bundle=LE70230282011250EDC00.tar.gz\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_xml_outfile
+
+PURPOSE:  Generates the output XML filename from the MTL or bundle filename.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            Error generating the XML filename
+non-NULL        Output XML filename, which the caller is responsible for
+                freeing
+
+NOTES:
+******************************************************************************/
+static char *get_xml_outfile
+(
+    char *infile,         /* I: input LPGS MTL or bundle filename */
+    bool bundle           /* I: is the input a bundle? */
+)
+{
+    char *xml_outfile = NULL;        /* output XML filename */
+    char *cptr = NULL;               /* pointer to the extension or _MTL.txt */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_xml_outfile";   /* function name */
+
+    /* Generate the XML filename from the bundle filename.  Change the
+       .tar.gz, .tgz, or .tar extension to .xml. */
+    if (bundle)
+    {
+        xml_outfile = malloc (strlen (infile) + 5);
+        if (xml_outfile != NULL)
+        {
+            strcpy (xml_outfile, infile);
+            cptr = strstr (xml_outfile, ".tar");
+            if (cptr == NULL)
+                cptr = strstr (xml_outfile, ".tgz");
+            if (cptr == NULL)
+                cptr = &xml_outfile[strlen (xml_outfile)];
+            strcpy (cptr, ".xml");
+        }
+    }
+
+    /* Generate the XML filename from the MTL filename.  Find the _MTL.txt and
+       change that to .xml. */
+    else
+    {
+        xml_outfile = strdup (infile);
+        if (xml_outfile != NULL)
+        {
+            cptr = strrchr (xml_outfile, '_');
+            if (cptr == NULL)
+            {
+                free (xml_outfile);
+                xml_outfile = NULL;
+            }
+            else
+                strcpy (cptr, ".xml");
+        }
+    }
+    if (xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file was not correctly generated from "
+            "%s", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+    return (xml_outfile);
 }
 
 
@@ -71,20 +184,30 @@ short get_args
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
     char **mtl_infile,    /* O: address of input LPGS MTL filename */
-    char **xml_outfile,   /* O: address of output XML filename */
-    bool *del_src         /* O: should source files be removed? */
+    char **bundle_infile, /* O: address of input LPGS bundle filename */
+    bool *del_src,        /* O: should source files be removed? */
+    bool *virtual_bands,  /* O: should a virtual product be written? */
+    int *nthreads,        /* O: number of threads for converting bands */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    char *cptr = NULL;               /* pointer to _MTL.txt in MTL filename */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
+    static int virtual_flag = 0;     /* flag for a virtual product */
     static struct option long_options[] =
     {
         {"del_src_files", no_argument, &del_flag, 1},
+        {"virtual", no_argument, &virtual_flag, 1},
         {"mtl", required_argument, 0, 'i'},
+        {"bundle", required_argument, 0, 'b'},
+        {"threads", required_argument, 0, 't'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"max_memory", required_argument, 0, 'M'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -116,7 +239,31 @@ short get_args
             case 'i':  /* LPGS MTL infile */
                 *mtl_infile = strdup (optarg);
                 break;
-     
+
+            case 'b':  /* LPGS bundle infile */
+                *bundle_infile = strdup (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                *nthreads = atoi (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -127,41 +274,165 @@ short get_args
         }
     }
 
-    /* Make sure the input MTL file was specified */
-    if (*mtl_infile == NULL)
+    /* Make sure one of the input MTL file, bundle, or scene list was
+       specified */
+    if ((*mtl_infile != NULL) + (*bundle_infile != NULL) +
+        (*scene_list != NULL) != 1)
     {
-        sprintf (errmsg, "LPGS MTL input file is a required argument");
+        sprintf (errmsg, "One of the LPGS MTL input file, the LPGS bundle, "
+            "or the scene list is a required argument");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
-    /* Generate the XML filename from the MTL filename.  Find the _MTL.txt and
-       change that to .xml. */
-    *xml_outfile = strdup (*mtl_infile);
-    cptr = strrchr (*xml_outfile, '_');
-    *cptr = '\0';
-    sprintf (*xml_outfile, "%s.xml", *xml_outfile);
-    if (*xml_outfile == NULL)
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of threads is valid */
+    if (*nthreads < 1)
     {
-        sprintf (errmsg, "XML output file was not correctly generated");
+        sprintf (errmsg, "Number of threads must be 1 or more");
         error_handler (true, FUNC_NAME, errmsg);
+        usage ();
         return (ERROR);
     }
 
-    /* Check the delete source files flag */
+    /* The bands of a virtual product are the source files */
+    if (del_flag && virtual_flag)
+    {
+        sprintf (errmsg, "The source files can't be removed for a virtual "
+            "product");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the delete source files and virtual product flags */
     if (del_flag)
         *del_src = true;
+    if (virtual_flag)
+        *virtual_bands = true;
 
     return (SUCCESS);
 }
 
 
+/******************************************************************************
+MODULE:  is_bundle
+
+PURPOSE:  Determines if the input is an LPGS bundle from its extension.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The input ends in .tar.gz, .tgz, or .tar
+false           The input is an MTL file
+
+NOTES:
+******************************************************************************/
+static bool is_bundle
+(
+    char *infile          /* I: input LPGS MTL or bundle filename */
+)
+{
+    const char *extensions[] = {".tar.gz", ".tgz", ".tar"};
+    size_t len = strlen (infile);   /* length of the filename */
+    size_t ext_len;                 /* length of the extension */
+    int i;                          /* looping variable */
+
+    for (i = 0; i < 3; i++)
+    {
+        ext_len = strlen (extensions[i]);
+        if (len >= ext_len && !strcmp (&infile[len - ext_len], extensions[i]))
+            return (true);
+    }
+    return (false);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Converts one LPGS product, from its MTL file or its bundle, to the
+ESPA internal format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Inputs ending in .tar.gz, .tgz, or .tar are read as bundles.
+  2. This is the Espa_batch_func_t of this application.
+  3. A virtual product needs the GeoTIFF files on disk, so bundles can't be
+     used for it.
+******************************************************************************/
+static int process_scene
+(
+    char *infile,         /* I: input LPGS MTL or bundle filename */
+    char *output,         /* I: output XML filename; NULL to name it after
+                                the input */
+    void *arg             /* I: conversion options
+                                (Lpgs_convert_options_t *) */
+)
+{
+    char FUNC_NAME[] = "process_scene";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Lpgs_convert_options_t *opts = arg;  /* conversion options */
+    char *xml_outfile = NULL;     /* output XML filename */
+    bool bundle;                  /* is the input a bundle? */
+    int status;                   /* return status of the conversion */
+
+    bundle = is_bundle (infile);
+    if (bundle && opts->virtual_bands)
+    {
+        sprintf (errmsg, "A virtual product can't be created from the "
+            "bundle %s; extract it first", infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (output != NULL)
+        xml_outfile = strdup (output);
+    else
+        xml_outfile = get_xml_outfile (infile, bundle);
+    if (xml_outfile == NULL)
+        return (ERROR);
+
+    /* Convert the LPGS MTL and data, either from disk or straight from the
+       bundle, to ESPA raw binary and XML; or just the MTL to XML for a
+       virtual product */
+    if (opts->virtual_bands)
+        status = convert_lpgs_to_espa_virtual (infile, xml_outfile);
+    else if (bundle)
+        status = convert_lpgs_bundle_to_espa (infile, xml_outfile,
+            opts->del_src, opts->nthreads);
+    else
+        status = convert_lpgs_to_espa (infile, xml_outfile, opts->del_src,
+            opts->nthreads);
+
+    free (xml_outfile);
+    return (status);
+}
+
+
 /******************************************************************************
 MODULE:  main
 
-PURPOSE:  Converts the LPGS products (MTL file and associated GeoTIFF files) to
-the ESPA internal format (XML metadata file and associated raw binary files).
+PURPOSE:  Converts the LPGS products (MTL file and associated GeoTIFF files),
+or an LPGS product bundle, to the ESPA internal format (XML metadata file and
+associated raw binary files).
 
 RETURN VALUE:
 Type = int
@@ -175,24 +446,40 @@ NOTES:
 int main (int argc, char** argv)
 {
     char *mtl_infile = NULL;      /* input LPGS MTL filename */
-    char *xml_outfile = NULL;     /* output XML filename */
-    bool del_src = false;         /* should source files be removed? */
+    char *bundle_infile = NULL;   /* input LPGS bundle filename */
+    char *scene_list = NULL;      /* list of products to be processed */
+    int nprocs = 1;               /* number of scenes processed concurrently */
+    Lpgs_convert_options_t opts;  /* conversion options */
+    int status;                   /* return status of the conversion */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &mtl_infile, &xml_outfile, &del_src) != SUCCESS)
+    opts.del_src = false;
+    opts.virtual_bands = false;
+    opts.nthreads = 1;
+    if (get_args (argc, argv, &mtl_infile, &bundle_infile, &opts.del_src,
+        &opts.virtual_bands, &opts.nthreads, &scene_list, &nprocs) !=
+        SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the LPGS MTL and data to ESPA raw binary and XML */
-    if (convert_lpgs_to_espa (mtl_infile, xml_outfile, del_src) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
-    }
+    /* Convert the products of the scene list, or the single product */
+    if (scene_list != NULL)
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+    else if (bundle_infile != NULL)
+        status = process_scene (bundle_infile, NULL, &opts);
+    else
+        status = process_scene (mtl_infile, NULL, &opts);
 
     /* Free the pointers */
     free (mtl_infile);
-    free (xml_outfile);
+    free (bundle_infile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
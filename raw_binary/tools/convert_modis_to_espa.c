@@ -17,6 +17,18 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "convert_modis_to_espa.h"
+#include "espa_batch.h"
+
+/* Options for converting each product */
+typedef struct
+{
+    bool del_src;                 /* should source files be removed? */
+    int nworkers;                 /* number of worker processes for
+                                     converting the SDSs */
+    Modis_template_t *tmpl;       /* template of the product shared by the
+                                     tiles of a scene list; NULL for a single
+                                     HDF file */
+} Modis_convert_options_t;
 
 /******************************************************************************
 MODULE: usage
@@ -35,12 +47,26 @@ void usage ()
             "files).\n\n");
     printf ("usage: convert_modis_to_espa "
             "--hdf=input_hdf_filename "
-            "[--del_src_files]\n");
+            "[--del_src_files] [--workers=nworkers]\n");
+    printf ("       convert_modis_to_espa --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--del_src_files] [--workers=nworkers]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -hdf: name of the input MODIS HDF file\n");
+    printf ("    -scene_list: instead of -hdf, name of a file listing the "
+            "HDF files to be processed, one per line, optionally followed by "
+            "the output XML filename, or - for the standard input.  The "
+            "metadata of the first tile of a product is read in full, and "
+            "later tiles of the same product and layout only read the "
+            "fields which differ between tiles.\n");
     printf ("    -del_src_files: if specified the source HDF file will "
             "be removed.\n");
+    printf ("    -workers: number of worker processes to use for converting "
+            "the SDSs in parallel (default is 1).  Each worker opens its own "
+            "handle to the HDF file.\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
     printf ("\nExample: convert_modis_to_espa "
             "--hdf=MOD09A1.A2013241.h08v05.005.2013252120055.hdf\n");
 }
@@ -70,13 +96,15 @@ short get_args
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
     char **hdf_infile,    /* O: address of input MODIS HDF filename */
-    char **xml_outfile,   /* O: address of output XML filename */
-    bool *del_src         /* O: should source files be removed? */
+    bool *del_src,        /* O: should source files be removed? */
+    int *nworkers,        /* O: number of worker processes for converting
+                                the SDSs */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
-    char *cptr = NULL;               /* pointer to .hdf in HDF filename */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int del_flag = 0;         /* flag for removing the source files */
@@ -84,6 +112,9 @@ short get_args
     {
         {"del_src_files", no_argument, &del_flag, 1},
         {"hdf", required_argument, 0, 'i'},
+        {"workers", required_argument, 0, 'w'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -115,7 +146,19 @@ short get_args
             case 'i':  /* MODIS HDF infile */
                 *hdf_infile = strdup (optarg);
                 break;
-     
+
+            case 'w':  /* number of worker processes */
+                *nworkers = atoi (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -126,25 +169,33 @@ short get_args
         }
     }
 
-    /* Make sure the input HDF file was specified */
-    if (*hdf_infile == NULL)
+    /* Make sure either the MODIS HDF input file or the scene list was
+       specified */
+    if ((*hdf_infile == NULL) == (*scene_list == NULL))
     {
-        sprintf (errmsg, "MODIS HDF input file is a required argument");
+        sprintf (errmsg, "Either the MODIS HDF input file or the scene list "
+            "is a required argument");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
-    /* Generate the XML filename from the HDF filename.  Find the .hdf and
-       change that to .xml. */
-    *xml_outfile = strdup (*hdf_infile);
-    cptr = strrchr (*xml_outfile, '.');
-    *cptr = '\0';
-    sprintf (*xml_outfile, "%s.xml", *xml_outfile);
-    if (*xml_outfile == NULL)
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "XML output file was not correctly generated");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
         error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of workers is valid */
+    if (*nworkers < 1)
+    {
+        sprintf (errmsg, "Number of workers must be 1 or more");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
         return (ERROR);
     }
 
@@ -156,11 +207,75 @@ short get_args
 }
 
 
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Converts one MODIS HDF product to the ESPA internal format.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the conversion
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *hdf_infile,     /* I: input MODIS HDF filename */
+    char *output,         /* I: output XML filename; NULL to name it after
+                                the input */
+    void *arg             /* I: conversion options
+                                (Modis_convert_options_t *) */
+)
+{
+    Modis_convert_options_t *opts = arg;  /* conversion options */
+    char *xml_outfile = NULL;     /* output XML filename */
+    char *cptr = NULL;            /* pointer to .hdf in HDF filename */
+    char errmsg[STR_SIZE];        /* error message */
+    char FUNC_NAME[] = "convert_modis_to_espa";   /* function name */
+    int status;                   /* return status of the conversion */
+
+    /* Generate the XML filename from the HDF filename, unless the scene list
+       gave it.  Find the .hdf and change that to .xml. */
+    if (output != NULL)
+        xml_outfile = strdup (output);
+    else
+    {
+        xml_outfile = malloc (strlen (hdf_infile) + 5);
+        if (xml_outfile != NULL)
+        {
+            strcpy (xml_outfile, hdf_infile);
+            cptr = strrchr (xml_outfile, '.');
+            if (cptr == NULL || strchr (cptr, '/') != NULL)
+                cptr = &xml_outfile[strlen (xml_outfile)];
+            strcpy (cptr, ".xml");
+        }
+    }
+    if (xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file was not correctly generated");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the MODIS HDF and data to ESPA raw binary and XML */
+    status = convert_modis_to_espa (hdf_infile, xml_outfile, opts->del_src,
+        opts->nworkers, opts->tmpl);
+
+    free (xml_outfile);
+    return (status);
+}
+
+
 /******************************************************************************
 MODULE:  main
 
-PURPOSE:  Converts the MODIS HDF product to the ESPA internal format (XML
-metadata file and associated raw binary files).
+PURPOSE:  Converts the MODIS HDF product, or each product of the scene list,
+to the ESPA internal format (XML metadata file and associated raw binary
+files).
 
 RETURN VALUE:
 Type = int
@@ -170,28 +285,47 @@ ERROR           Error doing the conversion
 SUCCESS         No errors encountered
 
 NOTES:
+  1. Each worker process of the scene list starts with an empty product
+     template and sets it from the first tile it converts.
 ******************************************************************************/
 int main (int argc, char** argv)
 {
     char *hdf_infile = NULL;      /* input MODIS HDF filename */
-    char *xml_outfile = NULL;     /* output XML filename */
-    bool del_src = false;         /* should source files be removed? */
+    char *scene_list = NULL;      /* list of HDF files to be processed */
+    int nprocs = 1;               /* number of scenes processed concurrently */
+    Modis_convert_options_t opts; /* conversion options */
+    Modis_template_t tmpl;        /* template of the product */
+    int status;                   /* return status of the conversion */
 
     /* Read the command-line arguments */
-    if (get_args (argc, argv, &hdf_infile, &xml_outfile, &del_src) != SUCCESS)
+    opts.del_src = false;
+    opts.nworkers = 1;
+    opts.tmpl = NULL;
+    if (get_args (argc, argv, &hdf_infile, &opts.del_src, &opts.nworkers,
+        &scene_list, &nprocs) != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Convert the MODIS HDF and data to ESPA raw binary and XML */
-    if (convert_modis_to_espa (hdf_infile, xml_outfile, del_src) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
+    /* Convert the HDF files of the scene list, or the single HDF file */
+    if (scene_list != NULL)
+    {
+        init_modis_template (&tmpl);
+        opts.tmpl = &tmpl;
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+        free_modis_template (&tmpl);
     }
+    else
+        status = process_scene (hdf_infile, NULL, &opts);
 
     /* Free the pointers */
     free (hdf_infile);
-    free (xml_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
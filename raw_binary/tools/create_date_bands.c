@@ -22,6 +22,8 @@ NOTES:
 #include "write_metadata.h"
 #include "raw_binary_io.h"
 #include "generate_date_bands.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
 
 /******************************************************************************
 MODULE: usage
@@ -43,11 +45,28 @@ void usage ()
             "input XML file with the _B1.img replaced with _date.img, "
             "_doy.img, and _year.img for the combined date/year, day of year, "
             "and year bands respectively.\n\n");
-    printf ("usage: create_date_bands --xml=input_metadata_filename\n");
+    printf ("usage: create_date_bands --xml=input_metadata_filename "
+            "[--use_fill_mask] [--max_memory=size]\n");
+    printf ("       create_date_bands --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--use_fill_mask] [--max_memory=size]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -use_fill_mask: set the date bands to fill (%d) wherever "
+            "band 1 is fill\n", DATE_BAND_FILL);
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks and "
+            "threads are sized to fit it, and the scene list workers share "
+            "it (default is the ESPA_MAX_MEMORY environment variable, or no "
+            "budget)\n");
     printf ("\nExample: create_date_bands "
             "--xml=LC80470272013287LGN00.xml\n");
 }
@@ -76,16 +95,26 @@ short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **xml_infile     /* O: address of input XML filename */
+    char **xml_infile,    /* O: address of input XML filename */
+    bool *use_fill_mask,  /* O: should band 1 fill be used as the date band
+                                fill? */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
     int option_index;                /* index for the command-line option */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
+    static int fill_flag = 0;        /* flag to indicate if the fill mask
+                                        should be used */
     static struct option long_options[] =
     {
+        {"use_fill_mask", no_argument, &fill_flag, 1},
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"max_memory", required_argument, 0, 'M'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -118,6 +147,22 @@ short get_args
             *xml_infile = strdup (optarg);
             break;
 
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -128,25 +173,39 @@ short get_args
         }
     }
 
-    /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
+    /* Check the flags */
+    if (fill_flag)
+        *use_fill_mask = true;
+
     return (SUCCESS);
 }
 
 
-#define MAX_DATE_LEN 28
 /******************************************************************************
-MODULE:  main
+MODULE:  process_scene
 
-PURPOSE: Creates the date/year bands for the current scene. These bands are
-generated from the acquisition date/year in the XML file.
+PURPOSE: Creates the date/year bands for one scene. These bands are generated
+from the acquisition date/year in the XML file.
 
 RETURN VALUE:
 Type = int
@@ -161,44 +220,30 @@ NOTES:
      the combined date/year, day of year, and year bands respectively.
   2. It is expected this will be run on the XML file that contains the
      converted LPGS Level 1 bands.
+  3. The date bands are written a block of lines at a time directly to the
+     output files, so the full bands are never held in memory.
+  4. This is the Espa_batch_func_t of this application.
 ******************************************************************************/
-int main (int argc, char** argv)
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: should band 1 fill be used as the date band
+                                fill? (bool *) */
+)
 {
     char FUNC_NAME[] = "create_date_bands";  /* function name */
     char errmsg[STR_SIZE];       /* error message */
-    char tmpstr[STR_SIZE];       /* temporary filename */
-    char tmp_ext[STR_SIZE];      /* temporary filename extension */
-    char jfile[STR_SIZE];        /* output date filename */
-    char production_date[MAX_DATE_LEN+1]; /* current date/year for production */
-    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
-    int i;                       /* looping variable */
-    int nlines;                  /* number of lines in date bands */
-    int nsamps;                  /* number of samples in date bands */
-    int refl_indx = -99;         /* index of band1 or first band */
-    unsigned int *jdate_buff = NULL;   /* date buffer */
-    unsigned short *jdoy_buff = NULL;  /* DOY buffer */
-    unsigned short *jyear_buff = NULL; /* year buffer */
-    time_t tp;                   /* time structure */
-    struct tm *tm = NULL;        /* time structure for UTC time */
-    FILE *fptr=NULL;             /* file pointer */
-    Envi_header_t envi_hdr;      /* output ENVI header information */
-    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
-    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
-    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for bands */
+    bool use_fill_mask = *(bool *) arg;  /* should band 1 fill be used as the
+                                            date band fill? */
     Espa_internal_meta_t out_meta;     /* output metadata for bands */
     Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
                                           by reading the XML metadata file */
 
-    /* Read the command-line arguments */
-    if (get_args (argc, argv, &espa_xml_file) != SUCCESS)
-    {   /* get_args already printed the error message */
-        exit (ERROR);
-    }
-
     /* Validate the input metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
+        return (ERROR);
     }
 
     /* Initialize the metadata structure */
@@ -206,295 +251,84 @@ int main (int argc, char** argv)
 
     /* Parse the metadata file into our internal metadata structure; also
        allocates space as needed for various pointers in the global and band
-       metadata */
-    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+       metadata.  Only the global metadata and the main band fields are
+       needed, so the band details are left out. */
+    if (parse_metadata_lazy (espa_xml_file, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        return (ERROR);
     }
-    gmeta = &xml_metadata.global;
 
-    /* Generate the date bands for this scene. Memory is allocated for the
-       buffers in this function call. */
-    if (generate_date_bands (&xml_metadata, &jdate_buff, &jdoy_buff,
-        &jyear_buff, &nlines, &nsamps) != SUCCESS)
+    /* Create the date bands and their ENVI headers */
+    if (create_date_bands (&xml_metadata, use_fill_mask, &out_meta) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
-    }
-
-    /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        if (!strcmp (xml_metadata.band[i].name, "band1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
-    }
-
-    /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
-    {
-        sprintf (errmsg, "Band 1 (band1) was not found in the XML file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Make sure the band 1 number of lines and samples matches what was used
-       for creating the date bands, otherwise we will have a mismatch in the
-       resolution and output XML information. */
-    bmeta = &xml_metadata.band[refl_indx];
-    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
-    {
-        sprintf (errmsg, "Band 1 from this application does not match band 1 "
-            "from the generate_date_bands function call.  Local nlines/nsamps: "
-            "%d, %d   Returned nlines/nsamps: %d, %d", bmeta->nlines,
-            bmeta->nsamps, nlines, nsamps);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Initialize the output metadata structure.  The global metadata will
-       not be used and will not be valid. */
-    init_metadata_struct (&out_meta);
-
-    /* Allocate memory for three output bands */
-    if (allocate_band_metadata (&out_meta, 3) != SUCCESS)
-    {
-        sprintf (errmsg, "Cannot allocate memory for the date bands");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Get the current date/time (UTC) for the production date of each band */
-    if (time (&tp) == -1)
-    {
-        sprintf (errmsg, "Unable to obtain the current time.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-  
-    tm = gmtime (&tp);
-    if (tm == NULL)
-    {
-        sprintf (errmsg, "Converting time to UTC.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-  
-    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
-    {
-        sprintf (errmsg, "Formatting the production date/time.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Loop through the three bands and append them to the XML file */
-    for (i = 0; i < 3; i++)
-    {
-        /* Set up the band metadata for the date bands */
-        out_bmeta = &out_meta.band[i];
-        strcpy (out_bmeta->product, "intermediate_data");
-        strcpy (out_bmeta->source, "level1");
-
-        /* Band-specific names */
-        switch (i)
-        {
-            case (0):  /* combined date/year */
-                strcpy (out_bmeta->name, "combined_date");
-                strcpy (out_bmeta->category, "image");
-                out_bmeta->data_type = ESPA_UINT32;
-                strncpy (tmpstr, bmeta->short_name, 3);
-                sprintf (out_bmeta->short_name, "%sDATE", tmpstr);
-                strcpy (out_bmeta->long_name,
-                    "doy and year (YEAR * 1000 + DOY)");
-                sprintf (tmp_ext, "date.img");
-                strcpy (out_bmeta->data_units, "date");
-                break;
-
-            case (1):  /* date */
-                strcpy (out_bmeta->name, "doy");
-                strcpy (out_bmeta->category, "image");
-                out_bmeta->data_type = ESPA_UINT16;
-                strncpy (tmpstr, bmeta->short_name, 3);
-                sprintf (out_bmeta->short_name, "%sDOY", tmpstr);
-                strcpy (out_bmeta->long_name, "day of year");
-                sprintf (tmp_ext, "doy.img");
-                out_bmeta->valid_range[0] = 1.0;
-                out_bmeta->valid_range[1] = 366.0;
-                strcpy (out_bmeta->data_units, "date");
-                break;
-
-            case (2):  /* year */
-                strcpy (out_bmeta->name, "year");
-                strcpy (out_bmeta->category, "image");
-                out_bmeta->data_type = ESPA_UINT16;
-                strncpy (tmpstr, bmeta->short_name, 3);
-                sprintf (out_bmeta->short_name, "%sYEAR", tmpstr);
-                strcpy (out_bmeta->long_name, "year");
-                sprintf (tmp_ext, "year.img");
-                out_bmeta->valid_range[0] = 1970.0;
-                out_bmeta->valid_range[1] = 9999.0;
-                strcpy (out_bmeta->data_units, "date");
-                break;
-        }
-
-        /* Use the product name to create the date filename */
-        snprintf (out_bmeta->file_name, sizeof (out_bmeta->file_name), "%s_%s",
-            gmeta->product_id, tmp_ext);
-
-        out_bmeta->resample_method = ESPA_NN;
-        out_bmeta->nlines = nlines;
-        out_bmeta->nsamps = nsamps;
-        out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
-        out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
-        strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
-        sprintf (out_bmeta->app_version, "create_date_bands_%s",
-            ESPA_COMMON_VERSION);
-        strcpy (out_bmeta->production_date, production_date);
-    }
-
-    /** Write the date/year file **/
-    out_bmeta = &out_meta.band[0];
-    strcpy (jfile, out_bmeta->file_name);
-    fptr = open_raw_binary (jfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the date/year file: %s", jfile);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned int),
-        jdate_buff) != SUCCESS)
-    {
-        sprintf (errmsg, "Unable to write to the date/year file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (jdate_buff);
-
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", jfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /** Write the date file **/
-    out_bmeta = &out_meta.band[1];
-    strcpy (jfile, out_bmeta->file_name);
-    fptr = open_raw_binary (jfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the date file: %s", jfile);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        return (ERROR);
     }
 
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned short),
-        jdoy_buff) != SUCCESS)
+    /* Append the date bands to the XML file */
+    if (append_metadata (3, out_meta.band, espa_xml_file) != SUCCESS)
     {
-        sprintf (errmsg, "Unable to write to the date file");
+        sprintf (errmsg, "Appending date bands to the XML file.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
 
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (jdoy_buff);
+    /* Free the input and output XML metadata */
+    free_metadata (&xml_metadata);
+    free_metadata (&out_meta);
 
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+    return (SUCCESS);
+}
 
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", jfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
 
-    /** Write the year file **/
-    out_bmeta = &out_meta.band[2];
-    strcpy (jfile, out_bmeta->file_name);
-    fptr = open_raw_binary (jfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the year file: %s", jfile);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+/******************************************************************************
+MODULE:  main
 
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned short),
-        jyear_buff) != SUCCESS)
-    {
-        sprintf (errmsg, "Unable to write to the year file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+PURPOSE: Creates the date/year bands for the current scene, or for each scene
+of the scene list.
 
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (jyear_buff);
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the date bands
+SUCCESS         No errors encountered
 
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
+    bool use_fill_mask = false;  /* should band 1 fill be used as the date
+                                    band fill? */
 
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", jfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
-        error_handler (true, FUNC_NAME, errmsg);
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &use_fill_mask, &scene_list,
+        &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
         exit (ERROR);
     }
 
-    /* Append the date bands to the XML file */
-    if (append_metadata (3, out_meta.band, espa_xml_file) != SUCCESS)
+    if (scene_list != NULL)
     {
-        sprintf (errmsg, "Appending date bands to the XML file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &use_fill_mask);
     }
-
-    /* Free the input and output XML metadata */
-    free_metadata (&xml_metadata);
-    free_metadata (&out_meta);
+    else
+        status = process_scene (espa_xml_file, NULL, &use_fill_mask);
 
     /* Free the pointers */
     free (espa_xml_file);
+    free (scene_list);
 
-    /* Successful completion */
-    exit (SUCCESS);
+    exit (status);
 }
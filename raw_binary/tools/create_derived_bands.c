@@ -0,0 +1,486 @@
+/*****************************************************************************
+FILE: create_derived_bands
+
+PURPOSE: Creates derived bands, such as spectral indices, from band-math
+expressions over the bands of the product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "envi_header.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "generate_derived_bands.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Derived bands to be created, shared by the scenes of a scene list */
+typedef struct
+{
+    int nbands;             /* number of derived bands */
+    Derived_band_t bands[DERIVED_MAX_BANDS];  /* derived bands */
+    Derived_options_t derived;  /* data type, scaling and storage of the
+                               derived bands */
+} Derived_band_options_t;
+
+/* Data type names of the --data_type option, in Espa_data_type order */
+static const char *data_type_names[] =
+{
+    "INT8", "UINT8", "INT16", "UINT16", "INT32", "UINT32", "FLOAT32",
+    "FLOAT64"
+};
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_derived_bands creates derived bands, such as spectral "
+            "indices, each from a band-math expression over the bands of "
+            "the product.  The bands used by all the expressions are read "
+            "once, in one pass.  An expression uses the band names from the "
+            "XML file, numbers, + - * / and parentheses, and the functions "
+            "abs, sqrt, min and max.  The bands are used as their physical "
+            "values (scale_factor and add_offset applied), and the derived "
+            "band is fill wherever a band it uses is fill.\n"
+            "The output filenames are the product ID with _<name>.img "
+            "appended, and the expression is recorded in the XML file.\n\n");
+    printf ("usage: create_derived_bands --xml=input_metadata_filename "
+            "--band=name=expression [--band=name=expression ...] "
+            "[--data_type=type] [--scale_factor=value] "
+            "[--add_offset=value] [--fill_value=value] [--lazy] "
+            "[--max_memory=size]\n");
+    printf ("       create_derived_bands --scene_list=scene_list_filename "
+            "--band=name=expression [--band=name=expression ...] "
+            "[--data_type=type] [--scale_factor=value] "
+            "[--add_offset=value] [--fill_value=value] [--lazy] "
+            "[--procs=nprocs] [--max_memory=size]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("    -band: name and expression of a derived band, up to %d "
+            "bands\n", DERIVED_MAX_BANDS);
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -data_type: data type of the derived bands, INT8, UINT8, "
+            "INT16, UINT16, INT32, UINT32, FLOAT32 or FLOAT64 (default is "
+            "INT16)\n");
+    printf ("    -scale_factor: scale factor of the derived bands (default "
+            "is %g)\n", DERIVED_SCALE_FACTOR);
+    printf ("    -add_offset: offset of the derived bands (default is "
+            "none)\n");
+    printf ("    -fill_value: fill value of the derived bands (default is "
+            "%d)\n", DERIVED_BAND_FILL);
+    printf ("    -lazy: write lazy bands, whose pixels are computed from the "
+            "bands they use whenever they're read, rather than the band "
+            "data\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks are "
+            "sized to fit it, and the scene list workers share it (default "
+            "is the ESPA_MAX_MEMORY environment variable, or no budget)\n");
+    printf ("\nExample: create_derived_bands "
+            "--xml=LC08_L1TP_047027_20131014_20170308_01_T1.xml "
+            "--band=\"ndvi=(sr_band5 - sr_band4) / (sr_band5 + sr_band4)\" "
+            "--band=\"nbr=(sr_band5 - sr_band7) / (sr_band5 + sr_band7)\"\n");
+}
+
+
+/******************************************************************************
+MODULE:  add_band
+
+PURPOSE:  Adds a derived band given as name=expression to the options.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The band is invalid or there are too many bands
+SUCCESS         The band was added
+
+NOTES:
+******************************************************************************/
+static int add_band
+(
+    char *spec,                    /* I: name=expression */
+    Derived_band_options_t *opts   /* I/O: derived bands */
+)
+{
+    char FUNC_NAME[] = "add_band";   /* function name */
+    char errmsg[STR_SIZE];           /* error message */
+    char *cptr = strchr (spec, '='); /* end of the name */
+    size_t len;                      /* length of the name */
+
+    if (opts->nbands >= DERIVED_MAX_BANDS)
+    {
+        sprintf (errmsg, "At most %d derived bands can be created",
+            DERIVED_MAX_BANDS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    len = (cptr == NULL) ? 0 : (size_t) (cptr - spec);
+    if (len == 0 || len >= STR_SIZE || strlen (cptr + 1) >= STR_SIZE ||
+        strspn (spec, "abcdefghijklmnopqrstuvwxyz"
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != len)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Derived band %.500s must be "
+            "name=expression, with a name of letters, digits and "
+            "underscores", spec);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memcpy (opts->bands[opts->nbands].name, spec, len);
+    opts->bands[opts->nbands].name[len] = '\0';
+    strcpy (opts->bands[opts->nbands].expression, cptr + 1);
+    opts->nbands++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file and the scene list.  These
+     should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs,          /* O: number of scenes processed concurrently */
+    Derived_band_options_t *opts  /* O: derived bands */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int i;                           /* looping variable */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int lazy_flag = 0;        /* flag to indicate if lazy bands
+                                        should be written */
+    static struct option long_options[] =
+    {
+        {"lazy", no_argument, &lazy_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"band", required_argument, 0, 'b'},
+        {"data_type", required_argument, 0, 't'},
+        {"scale_factor", required_argument, 0, 's'},
+        {"add_offset", required_argument, 0, 'o'},
+        {"fill_value", required_argument, 0, 'f'},
+        {"procs", required_argument, 0, 'P'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'b':  /* derived band */
+                if (add_band (optarg, opts) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 't':  /* data type */
+                for (i = 0; i <= ESPA_FLOAT64; i++)
+                {
+                    if (!strcmp (optarg, data_type_names[i]))
+                        break;
+                }
+                if (i > ESPA_FLOAT64)
+                {
+                    sprintf (errmsg, "Unknown data type %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                opts->derived.data_type = i;
+                break;
+
+            case 's':  /* scale factor */
+                opts->derived.scale_factor = atof (optarg);
+                break;
+
+            case 'o':  /* offset */
+                opts->derived.add_offset = atof (optarg);
+                break;
+
+            case 'f':  /* fill value */
+                opts->derived.fill_value = atol (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure at least one derived band was specified */
+    if (opts->nbands == 0)
+    {
+        sprintf (errmsg, "At least one derived band is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the scale factor is usable */
+    if (opts->derived.scale_factor == 0.0)
+    {
+        sprintf (errmsg, "Scale factor can't be 0");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the flags */
+    if (lazy_flag)
+        opts->derived.lazy = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE: Creates the derived bands for one scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the derived bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The derived bands are computed a block of lines at a time and written
+     directly to the output files, so the full bands are never held in
+     memory.
+  2. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: derived bands (Derived_band_options_t *) */
+)
+{
+    char FUNC_NAME[] = "create_derived_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Derived_band_options_t *opts = arg;  /* derived bands */
+    Espa_internal_meta_t out_meta;     /* output metadata for bands */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Create the derived bands and their ENVI headers */
+    if (create_derived_bands (&xml_metadata, opts->nbands, opts->bands,
+        &opts->derived, &out_meta) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
+    }
+
+    /* Append the derived bands to the XML file */
+    if (append_metadata (out_meta.nbands, out_meta.band, espa_xml_file)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Appending derived bands to the XML file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
+    }
+
+    /* Free the input and output XML metadata */
+    free_metadata (&xml_metadata);
+    free_metadata (&out_meta);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the derived bands for the current scene, or for each scene
+of the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the derived bands
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
+    static Derived_band_options_t opts;  /* derived bands */
+
+    opts.nbands = 0;
+    opts.derived.data_type = ESPA_INT16;
+    opts.derived.scale_factor = DERIVED_SCALE_FACTOR;
+    opts.derived.add_offset = ESPA_FLOAT_META_FILL;
+    opts.derived.fill_value = DERIVED_BAND_FILL;
+    opts.derived.lazy = false;
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &scene_list, &nprocs, &opts)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (scene_list != NULL)
+    {
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &opts);
+    }
+    else
+        status = process_scene (espa_xml_file, NULL, &opts);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    free (scene_list);
+
+    exit (status);
+}
@@ -0,0 +1,300 @@
+/*****************************************************************************
+FILE: create_espa_browse
+
+PURPOSE: Contains functions for creating a small browse (quick-look) PNG
+image of one or three bands of an ESPA raw binary product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_browse.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_espa_browse creates a small browse PNG image of the "
+            "input XML file, either grayscale from a single band or RGB "
+            "from a red, green and blue band.  Each band is stretched "
+            "between two percentiles of its values, and fill pixels are "
+            "transparent.  The browse is read from the overviews of the "
+            "bands where they're available, and stretched from the "
+            "histograms of the band statistics.\n\n");
+    printf ("usage: create_espa_browse "
+            "--xml=input_metadata_filename "
+            "{--band=band_name | --red=band_name --green=band_name "
+            "--blue=band_name} "
+            "--output=output_png_filename "
+            "[--size=npixels] [--low=percentile] [--high=percentile] "
+            "[--level=n]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file\n");
+    printf ("    -band: name of the band of a grayscale browse\n");
+    printf ("    -red, -green, -blue: names of the bands of an RGB browse.  "
+            "The bands have to have the same size and data type.\n");
+    printf ("    -output: name of the output PNG file\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -size: largest number of pixels of the longest side of the "
+            "browse, from 1 to %d (default is %d)\n", BROWSE_MAX_SIZE,
+            BROWSE_DEFAULT_SIZE);
+    printf ("    -low: percentile of the band values which is stretched to "
+            "the darkest value (default is %g)\n", BROWSE_DEFAULT_LOW);
+    printf ("    -high: percentile of the band values which is stretched to "
+            "the brightest value (default is %g)\n", BROWSE_DEFAULT_HIGH);
+    printf ("    -level: zlib compression level of the PNG, from 0 (stored) "
+            "to 9 (default is %d)\n", BROWSE_DEFAULT_LEVEL);
+    printf ("\nExample: create_espa_browse "
+            "--xml=LE07_L1TP_022033_20140228_20161028_01_T1.xml "
+            "--red=sr_band3 --green=sr_band2 --blue=sr_band1 "
+            "--output=browse.png --size=1024\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input XML and output.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+  2. The bands are returned in red, green, blue order for an RGB browse.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of the input XML filename */
+    int *nbands,          /* O: number of bands of the browse */
+    char bands[3][STR_SIZE], /* O: names of the bands of the browse */
+    char **output,        /* O: address of the output filename */
+    Browse_options_t *opts  /* O: options of the browse */
+)
+{
+    int c;                           /* current argument index */
+    int b;                           /* band of the current option */
+    int count;                       /* number of chars copied in snprintf */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    bool gray = false;               /* was --band specified? */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"band", required_argument, 0, 'k'},
+        {"red", required_argument, 0, 'r'},
+        {"green", required_argument, 0, 'g'},
+        {"blue", required_argument, 0, 'b'},
+        {"output", required_argument, 0, 'o'},
+        {"size", required_argument, 0, 's'},
+        {"low", required_argument, 0, 'l'},
+        {"high", required_argument, 0, 'u'},
+        {"level", required_argument, 0, 'z'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* input XML file */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'k':  /* grayscale band */
+            case 'r':  /* red band */
+            case 'g':  /* green band */
+            case 'b':  /* blue band */
+                b = (c == 'g') ? 1 : (c == 'b') ? 2 : 0;
+                if (c == 'k')
+                    gray = true;
+                count = snprintf (bands[b], sizeof (bands[b]), "%s", optarg);
+                if (count < 0 || count >= sizeof (bands[b]))
+                {
+                    sprintf (errmsg, "Overflow of bands[b] string");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                break;
+
+            case 'o':  /* output */
+                *output = strdup (optarg);
+                break;
+
+            case 's':  /* browse size */
+                opts->size = atoi (optarg);
+                break;
+
+            case 'l':  /* low percentile */
+                opts->low = atof (optarg);
+                break;
+
+            case 'u':  /* high percentile */
+                opts->high = atof (optarg);
+                break;
+
+            case 'z':  /* compression level */
+                opts->level = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the XML file, bands and output were specified, with either
+       a single band or all of red, green and blue */
+    *nbands = gray ? 1 : 3;
+    if (*xml_infile == NULL || *output == NULL || bands[0][0] == '\0' ||
+        (gray && (bands[1][0] != '\0' || bands[2][0] != '\0')) ||
+        (!gray && (bands[1][0] == '\0' || bands[2][0] == '\0')))
+    {
+        sprintf (errmsg, "The input XML file, output and either a band or "
+            "the red, green and blue bands are required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the browse size, percentiles and compression level are
+       valid */
+    if (opts->size < 1 || opts->size > BROWSE_MAX_SIZE)
+    {
+        sprintf (errmsg, "Browse size must be from 1 to %d",
+            BROWSE_MAX_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (opts->low < 0.0 || opts->high > 100.0 || opts->low >= opts->high)
+    {
+        sprintf (errmsg, "Percentiles must be from 0 to 100, with the low "
+            "percentile below the high one");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (opts->level < 0 || opts->level > 9)
+    {
+        sprintf (errmsg, "Compression level must be from 0 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Creates a browse PNG image of the bands of the input XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the browse
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *output = NULL;              /* output PNG filename */
+    char bands[3][STR_SIZE] = {"", "", ""};  /* bands of the browse */
+    int nbands = 0;                   /* number of bands of the browse */
+    int nlines;                       /* number of lines of the browse */
+    int nsamps;                       /* number of samples of the browse */
+    int status;                       /* return status of the browse */
+    Browse_options_t opts;            /* options of the browse */
+
+    /* Read the command-line arguments */
+    opts.size = BROWSE_DEFAULT_SIZE;
+    opts.low = BROWSE_DEFAULT_LOW;
+    opts.high = BROWSE_DEFAULT_HIGH;
+    opts.level = BROWSE_DEFAULT_LEVEL;
+    if (get_args (argc, argv, &xml_infile, &nbands, bands, &output, &opts)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Create the browse */
+    status = create_browse (xml_infile, nbands, bands, output, &opts,
+        &nlines, &nsamps);
+    if (status == SUCCESS)
+        printf ("Wrote a browse of %d lines x %d samples to %s\n", nlines,
+            nsamps, output);
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (output);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -10,6 +10,9 @@ at the USGS EROS
 LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 
 NOTES:
+  1. With --grids, a mask is made for the grid of each of the listed bands
+     with a single pass over the polygon; the coarser masks are reduced from
+     the mask of the finest grid (see generate_land_water_masks).
 *****************************************************************************/
 #include <getopt.h>
 #include <stdlib.h>
@@ -23,6 +26,18 @@ NOTES:
 #include "write_metadata.h"
 #include "raw_binary_io.h"
 #include "generate_land_water_mask.h"
+#include "espa_batch.h"
+
+/* Land/water masks made for each scene */
+typedef struct
+{
+    char *land_mass_polygon;      /* filename of the land-mass polygon */
+    int nmasks;                   /* number of masks (grids) */
+    const char *band_names[LW_MAX_MASKS];  /* representative band of the grid
+                                             of each mask */
+    Lw_reduce_t reduce;           /* reduction of the mixed blocks of the
+                                     coarser grids */
+} Lw_scene_args_t;
 
 /******************************************************************************
 MODULE: usage
@@ -39,13 +54,34 @@ void usage ()
     printf ("create_land_water_mask creates the land/water mask for the "
             "input scene, based on a static land-mass polygon.\n\n");
     printf ("usage: create_land_water_mask "
-            "--xml=input_metadata_filename\n");
+            "--xml=input_metadata_filename [--grids=band1,band8] "
+            "[--reduce=exact|majority|any_land]\n");
+    printf ("       create_land_water_mask --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--grids=band1,band8] "
+            "[--reduce=exact|majority|any_land]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
             "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -grids: comma-separated list of up to %d bands; a mask is "
+            "made on the grid of each, with one pass over the polygon "
+            "(default is band1)\n", LW_MAX_MASKS);
+    printf ("    -reduce: how the masks of the coarser grids are reduced "
+            "from the finest one where a block has both land and water: "
+            "exact tests the pixel against the polygon, majority takes the "
+            "more common value, any_land makes it land (default is "
+            "exact)\n");
     printf ("\nExample: create_land_water_mask "
             "--xml=LC80470272013287LGN00.xml\n");
+    printf ("         create_land_water_mask "
+            "--xml=LC80470272013287LGN00.xml --grids=band1,band8\n");
 }
 
 
@@ -72,7 +108,11 @@ short get_args
 (
     int argc,             /* I: number of cmd-line args */
     char *argv[],         /* I: string of cmd-line args */
-    char **xml_infile     /* O: address of input XML filename */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs,          /* O: number of scenes processed concurrently */
+    char **grids,         /* O: address of the list of grid bands */
+    Lw_reduce_t *reduce   /* O: reduction of the mixed blocks */
 )
 {
     int c;                           /* current argument index */
@@ -82,6 +122,10 @@ short get_args
     static struct option long_options[] =
     {
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"grids", required_argument, 0, 'g'},
+        {"reduce", required_argument, 0, 'r'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -114,6 +158,35 @@ short get_args
             *xml_infile = strdup (optarg);
             break;
 
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'g':  /* bands of the mask grids */
+                free (*grids);
+                *grids = strdup (optarg);
+                break;
+
+            case 'r':  /* reduction of the mixed blocks */
+                if (!strcmp (optarg, "exact"))
+                    *reduce = LW_REDUCE_EXACT;
+                else if (!strcmp (optarg, "majority"))
+                    *reduce = LW_REDUCE_MAJORITY;
+                else if (!strcmp (optarg, "any_land"))
+                    *reduce = LW_REDUCE_ANY_LAND;
+                else
+                {
+                    sprintf (errmsg, "Unknown reduction %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -124,10 +197,21 @@ short get_args
         }
     }
 
-    /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
@@ -137,12 +221,11 @@ short get_args
 }
 
 
-#define MAX_DATE_LEN 28
 /******************************************************************************
-MODULE:  main
+MODULE:  process_scene
 
-PURPOSE: Creates the land/water mask for the current scene and write it to the
-output land/water mask file.  The land/water mask is generated from a static
+PURPOSE: Creates the land/water mask for one scene and write it to the output
+land/water mask file.  The land/water mask is generated from a static
 land-mass polygon.
 
 RETURN VALUE:
@@ -153,63 +236,29 @@ ERROR           Error creating the land/water mask
 SUCCESS         No errors encountered
 
 NOTES:
-  1. The ESPA_LAND_MASS_POLYGON environment variable needs to be defined and
-     contain the full path and filename of the land-mass polygon to be used
-     to generate the land/water mask. It is recommended the land_no_buf.ply
-     polygon is used, which is delivered with this source code.
-  2. The land/water mask filename is the same as band 1 in the input XML file
-     with the _B1.img replaced with _land_water_mask.img.
+  1. The land/water mask filename is the same as band 1 in the input XML file
+     with the _B1.img replaced with _land_water_mask.img.  The masks of the
+     grids of other bands are named _land_water_mask_<band>.img.
+  2. This is the Espa_batch_func_t of this application.
 ******************************************************************************/
-int main (int argc, char** argv)
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: masks to be made (Lw_scene_args_t *) */
+)
 {
     char FUNC_NAME[] = "create_land_water_mask";  /* function name */
     char errmsg[STR_SIZE];       /* error message */
-    char tmpstr[STR_SIZE];       /* temporary filename */
-    char maskfile[STR_SIZE];     /* output land/water mask filename */
-    char production_date[MAX_DATE_LEN+1]; /* current date/time for production */
-    char *land_mass_polygon = NULL; /* filename of the land-mass polygon */
-    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
-    char *cptr = NULL;           /* character pointer for the '_' in filename */
-    int i;                       /* looping variable */
-    int nlines;                  /* number of lines in the land/water mask */
-    int nsamps;                  /* number of samples in the land/water mask */
-    int refl_indx = -99;         /* index of band1 or first band */
-    unsigned char *land_water_mask = NULL;  /* land/water mask buffer */
-    time_t tp;                   /* time structure */
-    struct tm *tm = NULL;        /* time structure for UTC time */
-    FILE *fptr=NULL;             /* file pointer */
-    Envi_header_t envi_hdr;      /* output ENVI header information */
-    Espa_global_meta_t *gmeta = NULL; /* pointer to global metadata structure */
-    Espa_band_meta_t *bmeta = NULL;   /* pointer to band metadata structure */
-    Espa_band_meta_t *out_bmeta = NULL;/* band metadata for land-water mask */
+    Lw_scene_args_t *args = arg; /* masks to be made */
     Espa_internal_meta_t out_meta;    /* output metadata for land-water mask */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure to be
                                 populated by reading the MTL metadata file */
 
-    /* Read the command-line arguments */
-    if (get_args (argc, argv, &espa_xml_file) != SUCCESS)
-    {   /* get_args already printed the error message */
-        exit (ERROR);
-    }
-
-    /* Get the ESPA land/water mask environment variable which specifies the
-       location of the land-mass polygon to be used */
-    land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
-    if (land_mass_polygon == NULL)
-    {
-        sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
-            "not defined. Define the environment variable to contain the "
-            "full path and filename of the land-mass polygon to be used "
-            "to generate the land/water mask.\n");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    printf ("Using land-mass polygon file: %s\n", land_mass_polygon);
-
     /* Validate the input metadata file */
     if (validate_xml_file (espa_xml_file) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
+        return (ERROR);
     }
 
     /* Initialize the metadata structure */
@@ -220,189 +269,137 @@ int main (int argc, char** argv)
        metadata */
     if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        return (ERROR);
     }
-    gmeta = &xml_metadata.global;
 
-    /* Generate the land/water mask for this scene. Memory is allocated for
-       the land/water mask. */
-    if (generate_land_water_mask (&xml_metadata, land_mass_polygon,
-        &land_water_mask, &nlines, &nsamps) != SUCCESS)
+    /* Generate the land/water masks for this scene and write them along
+       with their ENVI headers */
+    if (create_land_water_masks (&xml_metadata, args->land_mass_polygon,
+        args->nmasks, args->band_names, args->reduce, &out_meta) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
-    }
-
-    /* Use band 1 as the representative band in the XML */
-    for (i = 0; i < xml_metadata.nbands; i++)
-    {
-        if (!strcmp (xml_metadata.band[i].name, "band1"))
-        {
-            /* this is the index we'll use for reflectance band info */
-            refl_indx = i;
-            break;
-        }
+        free_metadata (&xml_metadata);
+        return (ERROR);
     }
 
-    /* Make sure the representative band was found in the XML file */
-    if (refl_indx == -9)
+    /* Append the land/water mask bands to the XML file */
+    if (append_metadata (args->nmasks, out_meta.band, espa_xml_file)
+        != SUCCESS)
     {
-        sprintf (errmsg, "Band 1 (band1) was not found in the XML file");
+        sprintf (errmsg, "Appending land/water mask to the XML file.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
     }
 
-    /* Make sure the band 1 number of lines and samples matches what was used
-       for creating the land/water mask, otherwise we will have a mismatch
-       in the resolution and output XML information. */
-    bmeta = &xml_metadata.band[refl_indx];
-    if (nlines != bmeta->nlines || nsamps != bmeta->nsamps)
-    {
-        sprintf (errmsg, "Band 1 from this application does not match band 1 "
-            "from the generate_land_water_mask function call.  Local nlines/"
-            "nsamps: %d, %d   Returned nlines/nsamps: %d, %d", bmeta->nlines,
-            bmeta->nsamps, nlines, nsamps);
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+    /* Free the input and output XML metadata */
+    free_metadata (&xml_metadata);
+    free_metadata (&out_meta);
 
-    /* Initialize the output metadata structure.  The global metadata will
-       not be used and will not be valid. */
-    init_metadata_struct (&out_meta);
+    return (SUCCESS);
+}
 
-    /* Allocate memory for a single output band */
-    if (allocate_band_metadata (&out_meta, 1) != SUCCESS)
-    {
-        sprintf (errmsg, "Cannot allocate memory for the land/water mask band");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    out_bmeta = &out_meta.band[0];
-
-    /* Set up the band metadata for the land/water mask */
-    strcpy (out_bmeta->product, "intermediate_data");
-    strcpy (out_bmeta->source, "level1");
-    strcpy (out_bmeta->name, "land_water_mask");
-    strcpy (out_bmeta->category, "qa");
-    out_bmeta->data_type = ESPA_UINT8;
-    out_bmeta->nlines = nlines;
-    out_bmeta->nsamps = nsamps;
-    strncpy (tmpstr, bmeta->short_name, 3);
-    sprintf (out_bmeta->short_name, "%sLWMASK", tmpstr);
-    strcpy (out_bmeta->long_name, "static land/water mask");
-    out_bmeta->pixel_size[0] = bmeta->pixel_size[0];
-    out_bmeta->pixel_size[1] = bmeta->pixel_size[1];
-    strcpy (out_bmeta->pixel_units, bmeta->pixel_units);
-    strcpy (out_bmeta->data_units, "quality/feature classification");
-    out_bmeta->valid_range[0] = 0.0;
-    out_bmeta->valid_range[1] = 1.0;
-    sprintf (out_bmeta->app_version, "create_land_water_mask_%s",
-        ESPA_COMMON_VERSION);
-
-    /* Use the band1 filename to create the land/mask filename */
-    strcpy (out_bmeta->file_name, bmeta->file_name);
-    cptr = strrchr (out_bmeta->file_name, '_');
-    if (!cptr)
-    {
-        sprintf (errmsg, "Unable to find the _ in the band 1 filename for "
-            "creating the land/water mask filename.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    sprintf (cptr, "_land_water_mask.img");
 
-    /* Set up the 2 classes for land (1) and water (0) */
-    out_bmeta->nclass = 2;
-    if (allocate_class_metadata (out_bmeta, 2) != SUCCESS)
-    {
-        sprintf (errmsg, "Cannot allocate memory for the classes");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    out_bmeta->class_values[0].class = 0;
-    out_bmeta->class_values[1].class = 1;
-    strcpy (out_bmeta->class_values[0].description, "water");
-    strcpy (out_bmeta->class_values[1].description, "land");
+/******************************************************************************
+MODULE:  main
 
-    /* Get the current date/time (UTC) for the production date of each band */
-    if (time (&tp) == -1)
-    {
-        sprintf (errmsg, "Unable to obtain the current time.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-  
-    tm = gmtime (&tp);
-    if (tm == NULL)
-    {
-        sprintf (errmsg, "Converting time to UTC.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-  
-    if (strftime (production_date, MAX_DATE_LEN, "%Y-%m-%dT%H:%M:%SZ", tm) == 0)
-    {
-        sprintf (errmsg, "Formatting the production date/time.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-    strcpy (out_bmeta->production_date, production_date);
+PURPOSE: Creates the land/water mask for the current scene, or for each scene
+of the scene list.
 
-    /* Write the land/water mask file */
-    strcpy (maskfile, out_bmeta->file_name);
-    fptr = open_raw_binary (maskfile, "wb");
-    if (!fptr)
-    {
-        sprintf (errmsg, "Unable to open the land/water mask file");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the land/water mask
+SUCCESS         No errors encountered
 
-    /* Write the data for this band */
-    if (write_raw_binary (fptr, nlines, nsamps, sizeof (unsigned char),
-        land_water_mask) != SUCCESS)
-    {
-        sprintf (errmsg, "Unable to write to the land/water mask file");
-        error_handler (true, FUNC_NAME, errmsg);
+NOTES:
+  1. The ESPA_LAND_MASS_POLYGON environment variable needs to be defined and
+     contain the full path and filename of the land-mass polygon to be used
+     to generate the land/water mask. It is recommended the land_no_buf.ply
+     polygon is used, which is delivered with this source code.  The
+     polygon can also be a packed polygon file made from it with
+     convert_land_mass_polygon, which is memory mapped instead of read.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "create_land_water_mask";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *land_mass_polygon = NULL; /* filename of the land-mass polygon */
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    char *grids = NULL;          /* comma-separated bands of the grids */
+    char *band = NULL;           /* band of the current grid */
+    char *saveptr = NULL;        /* state of strtok_r */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
+    Lw_scene_args_t args;        /* masks to be made for each scene */
+
+    /* Read the command-line arguments */
+    args.reduce = LW_REDUCE_EXACT;
+    if (get_args (argc, argv, &espa_xml_file, &scene_list, &nprocs, &grids,
+        &args.reduce) != SUCCESS)
+    {   /* get_args already printed the error message */
         exit (ERROR);
     }
 
-    /* Close the file and free the pointer for this band */
-    close_raw_binary (fptr);
-    free (land_water_mask);
-
-    /* Create the ENVI header using the representative band */
-    if (create_envi_struct (out_bmeta, gmeta, &envi_hdr) != SUCCESS)
+    /* Split the list of grid bands, band 1 if none were given */
+    args.nmasks = 0;
+    if (grids == NULL)
+        args.band_names[args.nmasks++] = "band1";
+    else
     {
-        sprintf (errmsg, "Error creating the ENVI header file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        for (band = strtok_r (grids, ",", &saveptr); band != NULL;
+             band = strtok_r (NULL, ",", &saveptr))
+        {
+            if (args.nmasks == LW_MAX_MASKS)
+            {
+                sprintf (errmsg, "At most %d grids can be listed",
+                    LW_MAX_MASKS);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+            args.band_names[args.nmasks++] = band;
+        }
+        if (args.nmasks == 0)
+        {
+            sprintf (errmsg, "No bands were listed for the grids");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
     }
 
-    /* Write the ENVI header */
-    sprintf (tmpstr, "%s", maskfile);
-    sprintf (&tmpstr[strlen(tmpstr)-3], "hdr");
-    if (write_envi_hdr (tmpstr, &envi_hdr) != SUCCESS)
+    /* Get the ESPA land/water mask environment variable which specifies the
+       location of the land-mass polygon to be used */
+    land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
+    if (land_mass_polygon == NULL)
     {
-        sprintf (errmsg, "Writing the ENVI header file: %s.", tmpstr);
+        sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
+            "not defined. Define the environment variable to contain the "
+            "full path and filename of the land-mass polygon to be used "
+            "to generate the land/water mask.\n");
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
+    printf ("Using land-mass polygon file: %s\n", land_mass_polygon);
+    args.land_mass_polygon = land_mass_polygon;
 
-    /* Append the land/water mask band to the XML file */
-    if (append_metadata (1, out_bmeta, espa_xml_file) != SUCCESS)
+    if (scene_list != NULL)
     {
-        sprintf (errmsg, "Appending land/water mask to the XML file.");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &args);
     }
-
-    /* Free the input and output XML metadata */
-    free_metadata (&xml_metadata);
-    free_metadata (&out_meta);
+    else
+        status = process_scene (espa_xml_file, NULL, &args);
 
     /* Free the pointers */
     free (espa_xml_file);
+    free (scene_list);
+    free (grids);
 
-    /* Successful completion */
-    exit (SUCCESS);
+    exit (status);
 }
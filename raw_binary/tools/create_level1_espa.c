@@ -0,0 +1,493 @@
+/*****************************************************************************
+FILE: create_level1_espa
+
+PURPOSE: Creates the ESPA Level-1 product from the LPGS product in a single
+process.  The LPGS bands are converted to the ESPA internal raw binary format,
+the band misalignment is clipped, and the angle bands, land/water mask and
+date bands are added, as done by the individual tools.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The stages run on a single in-memory copy of the XML metadata, which is
+     written and validated once after the last stage.
+  2. The angle bands, land/water mask and date bands only depend on the
+     clipped bands, so they run concurrently as a stage graph when threading
+     is enabled.
+  3. With -low_latency, each band is reported on the standard output as a
+     "Band ready:" line with its name and file as soon as it's on disk, so
+     an on-demand service can pick up the first bands while the others are
+     still being created.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_pipeline.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Options for creating each Level-1 product */
+typedef struct
+{
+    bool del_src;                 /* should source files be removed? */
+    bool angles;                  /* should the angle bands be created? */
+    bool band_avg;                /* should the angle band average be
+                                     created? */
+    bool land_water;              /* should the land/water mask be created? */
+    bool date_bands;              /* should the date bands be created? */
+    bool use_fill_mask;           /* should band 1 fill be used as the date
+                                     band fill? */
+    int nthreads;                 /* number of threads for the stages */
+    char *land_mass_polygon;      /* filename of the land-mass polygon */
+} Level1_options_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_level1_espa converts the LPGS products (MTL file and "
+            "associated GeoTIFF files) to the ESPA internal format (XML "
+            "metadata file and associated raw binary files), clips the band "
+            "misalignment, and optionally adds the per-pixel angle bands, "
+            "the land/water mask and the date bands.\n\n");
+    printf ("usage: create_level1_espa "
+            "--mtl=input_mtl_filename "
+            "[--del_src_files] [--threads=nthreads] [--angles] [--average] "
+            "[--land_water_mask] [--date_bands] [--use_fill_mask] "
+            "[--max_memory=size] [--low_latency]\n");
+    printf ("       create_level1_espa --scene_list=scene_list_filename "
+            "[--procs=nprocs] ...\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -mtl: name of the input LPGS MTL metadata file\n");
+    printf ("    -scene_list: instead of -mtl, name of a file listing the "
+            "MTL files to be processed, one per line, optionally followed by "
+            "the output XML filename, or - for the standard input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -del_src_files: if specified the source GeoTIFF files will "
+            "be removed.  The _MTL.txt file will remain along with the "
+            "gap directory for ETM+ products.\n");
+    printf ("    -threads: number of threads to use for converting the bands "
+            "and generating the angles in parallel (default is 1).  Only "
+            "used if the application was built with threading enabled.\n");
+    printf ("    -angles: create the solar and sensor angle bands for each "
+            "band\n");
+    printf ("    -average: create the angle bands for the average of the "
+            "reflectance bands instead of each band; implies -angles\n");
+    printf ("    -land_water_mask: create the land/water mask.  The "
+            "ESPA_LAND_MASS_POLYGON environment variable needs to point to "
+            "the land-mass polygon.\n");
+    printf ("    -date_bands: create the date/year bands\n");
+    printf ("    -use_fill_mask: set the date bands to fill wherever band 1 "
+            "is fill\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks and "
+            "threads are sized to fit it, and the scene list workers share "
+            "it (default is the ESPA_MAX_MEMORY environment variable, or no "
+            "budget)\n");
+    printf ("    -low_latency: process the scene for the shortest time to "
+            "its bands rather than for throughput, using every core, and "
+            "report each band on the standard output as soon as it is "
+            "complete (same as setting the %s environment variable to "
+            "on)\n", PIPELINE_LOW_LATENCY_ENV);
+    printf ("\nExample: create_level1_espa "
+            "--mtl=LC80470272013287LGN00_MTL.txt --angles --date_bands\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **mtl_infile,    /* O: address of input LPGS MTL filename */
+    bool *del_src,        /* O: should source files be removed? */
+    int *nthreads,        /* O: number of threads for the stages */
+    bool *angles,         /* O: should the angle bands be created? */
+    bool *band_avg,       /* O: should the angle band average be created? */
+    bool *land_water,     /* O: should the land/water mask be created? */
+    bool *date_bands,     /* O: should the date bands be created? */
+    bool *use_fill_mask,  /* O: should band 1 fill be used as the date band
+                                fill? */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs,          /* O: number of scenes processed concurrently */
+    bool *low_latency     /* O: should the scenes be processed in
+                                low-latency mode? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int del_flag = 0;         /* flag for removing the source files */
+    static int angles_flag = 0;      /* flag for creating the angle bands */
+    static int avg_flag = 0;         /* flag for the angle band average */
+    static int land_water_flag = 0;  /* flag for the land/water mask */
+    static int date_flag = 0;        /* flag for creating the date bands */
+    static int fill_flag = 0;        /* flag for the date band fill mask */
+    static int latency_flag = 0;     /* flag for low-latency mode */
+    static struct option long_options[] =
+    {
+        {"del_src_files", no_argument, &del_flag, 1},
+        {"angles", no_argument, &angles_flag, 1},
+        {"average", no_argument, &avg_flag, 1},
+        {"land_water_mask", no_argument, &land_water_flag, 1},
+        {"date_bands", no_argument, &date_flag, 1},
+        {"use_fill_mask", no_argument, &fill_flag, 1},
+        {"low_latency", no_argument, &latency_flag, 1},
+        {"mtl", required_argument, 0, 'i'},
+        {"threads", required_argument, 0, 't'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* LPGS MTL infile */
+                *mtl_infile = strdup (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                *nthreads = atoi (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the LPGS MTL input file or the scene list was
+       specified */
+    if ((*mtl_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the LPGS MTL input file or the scene list "
+            "is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of threads is valid */
+    if (*nthreads < 1)
+    {
+        sprintf (errmsg, "Number of threads must be 1 or more");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Check the flags */
+    if (del_flag)
+        *del_src = true;
+    if (angles_flag || avg_flag)
+        *angles = true;
+    if (avg_flag)
+        *band_avg = true;
+    if (land_water_flag)
+        *land_water = true;
+    if (date_flag)
+        *date_bands = true;
+    if (fill_flag)
+        *use_fill_mask = true;
+    if (latency_flag)
+        *low_latency = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  print_band_ready
+
+PURPOSE:  Reports a band which is complete in low-latency mode.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. This is the Espa_band_ready_func_t of this application.  The line is
+     flushed at once, since the reader is waiting for it.
+******************************************************************************/
+static void print_band_ready
+(
+    void *arg,                    /* I: not used */
+    const Espa_band_meta_t *bmeta /* I: metadata of the band */
+)
+{
+    printf ("Band ready: %s %s\n", bmeta->name, bmeta->file_name);
+    fflush (stdout);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Creates the ESPA Level-1 product from one LPGS product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the product
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The angle bands use the default grid options of create_angle_bands,
+     which evaluates the angles exactly at every pixel.
+  2. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *mtl_infile,     /* I: input LPGS MTL filename */
+    char *output,         /* I: output XML filename; NULL to name it after
+                                the MTL file */
+    void *arg             /* I: Level-1 options (Level1_options_t *) */
+)
+{
+    char FUNC_NAME[] = "create_level1_espa";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    Level1_options_t *opts = arg; /* Level-1 options */
+    char *xml_outfile = NULL;     /* output XML filename */
+    char *cptr = NULL;            /* pointer to _MTL.txt in MTL filename */
+    int status;                   /* return status of the stages */
+    Espa_pipeline_t pipeline;     /* pipeline handle for the scene */
+    Espa_stage_graph_t graph;     /* stages adding bands */
+    Pipeline_angle_options_t angle_opts;  /* options of the angle bands */
+
+    /* Generate the XML filename from the MTL filename, unless the scene list
+       gave it.  Find the _MTL.txt and change that to .xml. */
+    if (output != NULL)
+        xml_outfile = strdup (output);
+    else
+    {
+        xml_outfile = strdup (mtl_infile);
+        cptr = (xml_outfile == NULL) ? NULL : strrchr (xml_outfile, '_');
+        if (cptr == NULL)
+        {
+            free (xml_outfile);
+            xml_outfile = NULL;
+        }
+        else
+            strcpy (cptr, ".xml");
+    }
+    if (xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file was not correctly generated");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Convert the LPGS MTL and data to ESPA raw binary */
+    if (open_lpgs_pipeline (mtl_infile, xml_outfile, opts->del_src,
+        opts->nthreads, &pipeline) != SUCCESS)
+    {  /* Error messages already written */
+        free (xml_outfile);
+        return (ERROR);
+    }
+    pipeline.band_ready = print_band_ready;
+
+    /* Clip the band misalignment */
+    status = clip_pipeline_bands (&pipeline);
+
+    /* Create the angle bands, land/water mask and date bands, which only
+       read the clipped bands */
+    init_stage_graph (&graph);
+    angle_opts.band_avg = opts->band_avg;
+    angle_opts.grid_spacing = 1;
+    angle_opts.max_grid_error = 0.01;
+    angle_opts.verify_grid = false;
+    angle_opts.nthreads = opts->nthreads;
+    angle_opts.share_bands = false;
+    angle_opts.dem_file = NULL;
+    if (status == SUCCESS && opts->angles)
+        status = add_stage_to_graph (&graph, PIPELINE_ANGLE_STAGE,
+            pipeline_angle_stage, &angle_opts, "clipped_bands",
+            "angle_bands");
+    if (status == SUCCESS && opts->land_water)
+        status = add_stage_to_graph (&graph, PIPELINE_LAND_WATER_MASK_STAGE,
+            pipeline_land_water_mask_stage, opts->land_mass_polygon,
+            "clipped_bands", "land_water_mask");
+    if (status == SUCCESS && opts->date_bands)
+        status = add_stage_to_graph (&graph, PIPELINE_DATE_STAGE,
+            pipeline_date_stage, &opts->use_fill_mask, "clipped_bands",
+            "date_bands");
+    if (status == SUCCESS)
+        status = run_pipeline_stages (&pipeline, &graph);
+
+    /* Write the XML file once for all the stages */
+    if (status == SUCCESS)
+        status = write_pipeline_metadata (&pipeline);
+
+    /* Free the metadata and pointers */
+    close_espa_pipeline (&pipeline);
+    free (xml_outfile);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Creates the ESPA Level-1 product from the LPGS product (MTL file and
+associated GeoTIFF files), or from each LPGS product of the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the product
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "create_level1_espa";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *mtl_infile = NULL;      /* input LPGS MTL filename */
+    char *scene_list = NULL;      /* list of MTL files to be processed */
+    int nprocs = 1;               /* number of scenes processed concurrently */
+    int status;                   /* status of processing the scenes */
+    bool low_latency = false;     /* process in low-latency mode? */
+    Level1_options_t opts;        /* Level-1 options */
+
+    /* Read the command-line arguments */
+    opts.del_src = false;
+    opts.angles = false;
+    opts.band_avg = false;
+    opts.land_water = false;
+    opts.date_bands = false;
+    opts.use_fill_mask = false;
+    opts.nthreads = 1;
+    opts.land_mass_polygon = NULL;
+    if (get_args (argc, argv, &mtl_infile, &opts.del_src, &opts.nthreads,
+        &opts.angles, &opts.band_avg, &opts.land_water, &opts.date_bands,
+        &opts.use_fill_mask, &scene_list, &nprocs, &low_latency) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+    if (low_latency)
+        setenv (PIPELINE_LOW_LATENCY_ENV, "on", 1);
+
+    /* Make sure the land-mass polygon is available before doing any of the
+       processing */
+    if (opts.land_water)
+    {
+        opts.land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
+        if (opts.land_mass_polygon == NULL)
+        {
+            sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
+                "not defined. Define the environment variable to contain the "
+                "full path and filename of the land-mass polygon to be used "
+                "to generate the land/water mask.\n");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+        printf ("Using land-mass polygon file: %s\n",
+            opts.land_mass_polygon);
+    }
+
+    /* Create the products of the scene list, or the single product */
+    if (scene_list != NULL)
+        status = run_espa_batch (scene_list, nprocs, process_scene, &opts);
+    else
+        status = process_scene (mtl_infile, NULL, &opts);
+
+    /* Free the pointers */
+    free (mtl_infile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
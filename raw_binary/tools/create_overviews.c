@@ -0,0 +1,295 @@
+/*****************************************************************************
+FILE: create_overviews
+  
+PURPOSE: Creates the reduced-resolution overviews (quick-looks) of the bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "parse_metadata.h"
+#include "raw_binary_overview.h"
+#include "generate_overviews.h"
+#include "espa_batch.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_overviews creates the reduced-resolution overviews of "
+            "each band in the XML file, in a single pass through each band. "
+            "Level 1 reduces the band by 2x, level 2 by 4x, level 3 by 8x, "
+            "and level 4 by 16x. Image bands are averaged, ignoring the fill "
+            "pixels, and QA bands use the nearest neighbor.\n"
+            "The overview filenames are the same as the band with the .img "
+            "replaced with _ovr<factor>.img, for example _B1_ovr4.img. The "
+            "overviews are not added to the XML file.\n\n");
+    printf ("usage: create_overviews --xml=input_metadata_filename "
+            "[--levels=nlevels]\n");
+    printf ("       create_overviews --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--levels=nlevels]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -levels: number of overview levels to create, from 1 to "
+            "%d (default is %d)\n", RB_MAX_OVERVIEWS, RB_MAX_OVERVIEWS);
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("\nExample: create_overviews "
+            "--xml=LC80470272013287LGN00.xml --levels=3\n");
+    printf ("Example: create_overviews --scene_list=scenes.txt "
+            "--procs=8\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    int *nlevels,         /* O: number of overview levels */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"levels", required_argument, 0, 'l'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'l':  /* number of overview levels */
+                *nlevels = atoi (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of levels is valid */
+    if (*nlevels < 1 || *nlevels > RB_MAX_OVERVIEWS)
+    {
+        sprintf (errmsg, "Number of levels must be from 1 to %d",
+            RB_MAX_OVERVIEWS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE: Creates the overviews of the bands in one XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the overviews
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: number of overview levels (int *) */
+)
+{
+    int nlevels = *(int *) arg;        /* number of overview levels */
+    int status;                        /* return status */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Create the overviews and their ENVI headers */
+    status = create_band_overviews (&xml_metadata, nlevels);
+
+    /* Free the XML metadata */
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the overviews of the bands in the XML file, or in each XML
+file of the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the overviews
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int nlevels = RB_MAX_OVERVIEWS;    /* number of overview levels */
+    int status;                  /* status of processing the scenes */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &nlevels, &scene_list,
+        &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (scene_list != NULL)
+    {
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &nlevels);
+    }
+    else
+        status = process_scene (espa_xml_file, NULL, &nlevels);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    free (scene_list);
+
+    exit (status);
+}
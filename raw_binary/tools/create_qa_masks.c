@@ -0,0 +1,359 @@
+/*****************************************************************************
+FILE: create_qa_masks
+
+PURPOSE: Expands the bit fields of a bit-packed QA band into separate 8-bit
+mask bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "envi_header.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "generate_qa_masks.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Options of the masks, shared by the scenes of a scene list */
+typedef struct
+{
+    char *qa_band;          /* name of the QA band */
+    char *fields;           /* comma-separated fields to be expanded; NULL
+                               for all */
+} Qa_mask_options_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_qa_masks expands the bit fields of a bit-packed QA band "
+            "into separate 8-bit mask bands, one per field.  The fields come "
+            "from the bitmap description of the QA band, where consecutive "
+            "bits with the same description form one field.  Each mask "
+            "pixel is the value of its field, or %d where the QA band is "
+            "fill.  The QA band is read once for all the masks.\n"
+            "The mask bands are named <qa_band>_<field> and the output "
+            "filenames are the product ID with _<qa_band>_<field>.img "
+            "appended.\n\n", QA_MASK_FILL);
+    printf ("usage: create_qa_masks --xml=input_metadata_filename "
+            "--qa_band=qa_band_name [--fields=field_list] "
+            "[--max_memory=size]\n");
+    printf ("       create_qa_masks --scene_list=scene_list_filename "
+            "--qa_band=qa_band_name [--fields=field_list] [--procs=nprocs] "
+            "[--max_memory=size]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("    -qa_band: name of the bit-packed QA band\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -fields: comma-separated list of the fields to be "
+            "expanded, each the description of the field in the bitmap "
+            "description (case is ignored), the field name used in the mask "
+            "band name, or a bit range as bit:<n> or bits:<first>-<last> "
+            "(default is all the fields of the bitmap description)\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks are "
+            "sized to fit it, and the scene list workers share it (default "
+            "is the ESPA_MAX_MEMORY environment variable, or no budget)\n");
+    printf ("\nExample: create_qa_masks "
+            "--xml=LC08_L1TP_047027_20131014_20170308_01_T1.xml "
+            "--qa_band=qa --fields=\"Cloud,Cloud Confidence,bits:7-8\"\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file, the scene list and the
+     options.  All of these should be character pointers set to NULL on
+     input.  The caller is responsible for freeing the allocated memory upon
+     successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs,          /* O: number of scenes processed concurrently */
+    Qa_mask_options_t *opts  /* O: options of the masks */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"qa_band", required_argument, 0, 'q'},
+        {"fields", required_argument, 0, 'f'},
+        {"procs", required_argument, 0, 'P'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'q':  /* QA band */
+                opts->qa_band = strdup (optarg);
+                break;
+
+            case 'f':  /* fields */
+                opts->fields = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the QA band was specified */
+    if (opts->qa_band == NULL)
+    {
+        sprintf (errmsg, "QA band is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE: Creates the QA mask bands for one scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the QA mask bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The mask bands are written a block of lines at a time directly to the
+     output files, so the full bands are never held in memory.
+  2. The full metadata is parsed since the fields come from the bitmap
+     description of the QA band.
+  3. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: options of the masks (Qa_mask_options_t *) */
+)
+{
+    char FUNC_NAME[] = "create_qa_masks";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Qa_mask_options_t *opts = arg;     /* options of the masks */
+    Espa_internal_meta_t out_meta;     /* output metadata for bands */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Create the mask bands and their ENVI headers */
+    if (create_qa_masks (&xml_metadata, opts->qa_band, opts->fields,
+        &out_meta) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
+    }
+
+    /* Append the mask bands to the XML file */
+    if (append_metadata (out_meta.nbands, out_meta.band, espa_xml_file)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Appending QA mask bands to the XML file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
+    }
+
+    /* Free the input and output XML metadata */
+    free_metadata (&xml_metadata);
+    free_metadata (&out_meta);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the QA mask bands for the current scene, or for each scene
+of the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the QA mask bands
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
+    Qa_mask_options_t opts = {NULL, NULL};  /* options of the masks */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &scene_list, &nprocs, &opts)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (scene_list != NULL)
+    {
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &opts);
+    }
+    else
+        status = process_scene (espa_xml_file, NULL, &opts);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    free (scene_list);
+    free (opts.qa_band);
+    free (opts.fields);
+
+    exit (status);
+}
@@ -0,0 +1,633 @@
+/*****************************************************************************
+FILE: create_synthetic_scene
+
+PURPOSE: Creates a synthetic ESPA product, the XML file and its raw binary
+bands, for benchmarking and stress-testing the tools at realistic sizes
+without real Landsat or MODIS data.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "synthetic_scene.h"
+
+/* Band layouts of the TM and ETM+ instruments, as clip_band_misalignment
+   expects them */
+static const char *tm_bands[] = {"band1", "band2", "band3", "band4", "band5",
+    "band6", "band7"};
+static const char *etm_bands[] = {"band1", "band2", "band3", "band4", "band5",
+    "band61", "band62", "band7"};
+
+/* Codes of the command-line options which take a value */
+enum
+{
+    OPT_XML = 256, OPT_INSTRUMENT, OPT_NBANDS, OPT_DATA_TYPE, OPT_NLINES,
+    OPT_NSAMPS, OPT_FILL, OPT_FOOTPRINT_ANGLE, OPT_MISALIGN, OPT_FILL_FRACTION,
+    OPT_SEED, OPT_PROJ, OPT_DATUM, OPT_ZONE, OPT_UL_X, OPT_UL_Y,
+    OPT_PIXEL_SIZE, OPT_LONGITUDE_POLE, OPT_LATITUDE_TRUE_SCALE,
+    OPT_STANDARD_PARALLEL1, OPT_STANDARD_PARALLEL2, OPT_CENTRAL_MERIDIAN,
+    OPT_ORIGIN_LATITUDE, OPT_FALSE_EASTING, OPT_FALSE_NORTHING,
+    OPT_SPHERE_RADIUS, OPT_BOUNDS, OPT_HELP
+};
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_synthetic_scene writes a synthetic ESPA product: the XML "
+            "file and a raw binary band with an ENVI header for each band. "
+            "The bands are written to the directory of the XML file and "
+            "named after it.  The pixel values are a gradient with "
+            "pseudo-random noise, so the same options and seed give the same "
+            "product.\n\n");
+    printf ("usage: create_synthetic_scene --xml=output_metadata_filename "
+            "[--instrument=TM|ETM|OLI_TIRS] [--nbands=n] [--qa] "
+            "[--data_type=type] [--nlines=n] [--nsamps=n] "
+            "[--fill=none|footprint|random] [--footprint_angle=degrees] "
+            "[--misalign=pixels] [--fill_fraction=fraction] [--seed=n] "
+            "[--proj=geo|utm|ps|albers|sin] [--datum=WGS84|NAD83|NAD27|none] "
+            "[--zone=n] [--ul_x=x] [--ul_y=y] [--pixel_size=size] "
+            "[projection parameters] [--bounds=west,east,north,south]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the output XML metadata file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -instrument: TM writes the LANDSAT_5 bands band1-band7 and "
+            "ETM the LANDSAT_7 bands band1-band5, band61, band62, band7, both "
+            "with the quality band, as clip_band_misalignment expects; "
+            "OLI_TIRS writes LANDSAT_8 bands band1, band2, ... (default)\n");
+    printf ("    -nbands: number of image bands band1, band2, ...; "
+            "overrides the TM and ETM layouts (default is 7)\n");
+    printf ("    -qa: add the quality band, marking the pixels which are fill "
+            "in any image band (always added for TM and ETM)\n");
+    printf ("    -data_type: uint8, int8, int16, uint16, int32, uint32, "
+            "float32, or float64 (default is uint8 for TM and ETM and int16 "
+            "otherwise)\n");
+    printf ("    -nlines, -nsamps: size of the bands, from 1 to %d (default "
+            "is 1000 x 1000)\n", SYNTHETIC_MAX_SIZE);
+    printf ("    -fill: fill pattern; footprint fills outside a rotated scene "
+            "footprint and random fills pseudo-random pixels (default is "
+            "footprint)\n");
+    printf ("    -footprint_angle: rotation of the footprint from north, "
+            "between -45 and 45 degrees (default is 12)\n");
+    printf ("    -misalign: largest number of pixels the footprint edges of "
+            "the bands differ by (default is 0, or 5 for TM and ETM)\n");
+    printf ("    -fill_fraction: fraction of the pixels which are fill in "
+            "the random fill pattern (default is 0.01)\n");
+    printf ("    -seed: seed of the pseudo-random values (default is 1)\n");
+    printf ("    -proj: projection (default is utm)\n");
+    printf ("    -datum: datum (default is WGS84, or none for sin)\n");
+    printf ("    -zone: UTM zone, negative in the southern hemisphere "
+            "(default is 13)\n");
+    printf ("    -ul_x, -ul_y: projection coordinates of the center of the "
+            "UL pixel (default depends on the projection)\n");
+    printf ("    -pixel_size: pixel size in the projection units (default is "
+            "30 meters, 0.00025 degrees for geo, or 463.313 meters for "
+            "sin)\n");
+    printf ("    -longitude_pole, -latitude_true_scale: PS parameters "
+            "(default is 0, -71)\n");
+    printf ("    -standard_parallel1, -standard_parallel2, -origin_latitude: "
+            "Albers parameters (default is 29.5, 45.5, 23)\n");
+    printf ("    -central_meridian: Albers and SIN central meridian (default "
+            "is -96 for albers and 0 for sin)\n");
+    printf ("    -false_easting, -false_northing: PS, Albers, and SIN false "
+            "easting and northing (default is 0)\n");
+    printf ("    -sphere_radius: SIN sphere radius (default is "
+            "6371007.181)\n");
+    printf ("    -bounds: geographic bounding coordinates of the product "
+            "(default is -106,-105.65,40,39.73)\n");
+    printf ("\nExample: create_synthetic_scene --xml=synthetic_etm.xml "
+            "--instrument=ETM --nlines=7000 --nsamps=8000\n");
+}
+
+
+/******************************************************************************
+MODULE:  parse_double
+
+PURPOSE:  Converts the value of a command-line option to a double.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The value isn't a number
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int parse_double
+(
+    const char *option,   /* I: name of the option */
+    const char *value,    /* I: value of the option */
+    double *number        /* O: value converted to a double */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "parse_double";   /* function name */
+    char *end;                       /* end of the converted number */
+
+    *number = strtod (value, &end);
+    if (end == value || *end != '\0')
+    {
+        sprintf (errmsg, "Invalid value %s for --%s", value, option);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_projection_defaults
+
+PURPOSE:  Sets the projection of the synthetic product and the defaults of
+its parameters.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Unknown projection
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int set_projection_defaults
+(
+    const char *proj,            /* I: name of the projection */
+    Synthetic_scene_t *scene     /* I/O: synthetic product */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "set_projection_defaults";   /* function name */
+    Espa_proj_meta_t *proj_info = &scene->proj_info;  /* projection */
+
+    if (!strcmp (proj, "utm"))
+        return (SUCCESS);   /* already the default of the product */
+
+    proj_info->utm_zone = 0;
+    proj_info->false_easting = 0.0;
+    proj_info->false_northing = 0.0;
+    if (!strcmp (proj, "geo"))
+    {
+        proj_info->proj_type = GCTP_GEO_PROJ;
+        strcpy (proj_info->units, "degrees");
+        proj_info->ul_corner[0] = scene->bounding_coords[ESPA_WEST];
+        proj_info->ul_corner[1] = scene->bounding_coords[ESPA_NORTH];
+        scene->pixel_size = 0.00025;
+    }
+    else if (!strcmp (proj, "ps"))
+    {
+        proj_info->proj_type = GCTP_PS_PROJ;
+        proj_info->longitude_pole = 0.0;
+        proj_info->latitude_true_scale = -71.0;
+        proj_info->ul_corner[0] = -1000000.0;
+        proj_info->ul_corner[1] = 1000000.0;
+    }
+    else if (!strcmp (proj, "albers"))
+    {
+        proj_info->proj_type = GCTP_ALBERS_PROJ;
+        proj_info->standard_parallel1 = 29.5;
+        proj_info->standard_parallel2 = 45.5;
+        proj_info->central_meridian = -96.0;
+        proj_info->origin_latitude = 23.0;
+        proj_info->ul_corner[0] = -800000.0;
+        proj_info->ul_corner[1] = 2000000.0;
+    }
+    else if (!strcmp (proj, "sin"))
+    {
+        proj_info->proj_type = GCTP_SIN_PROJ;
+        proj_info->datum_type = ESPA_NODATUM;
+        proj_info->sphere_radius = 6371007.181;
+        proj_info->central_meridian = 0.0;
+        proj_info->ul_corner[0] = -8895604.157;
+        proj_info->ul_corner[1] = 4447802.079;
+        scene->pixel_size = 463.312716528;
+    }
+    else
+    {
+        sprintf (errmsg, "Unknown projection %s", proj);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments, validates that the required
+arguments were specified, and sets up the synthetic product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the output XML file.  It should be a character
+     pointer set to NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+  2. The instrument and projection are applied first, so the other options
+     override their defaults regardless of the order they are given in.
+******************************************************************************/
+short get_args
+(
+    int argc,                    /* I: number of cmd-line args */
+    char *argv[],                /* I: string of cmd-line args */
+    char **xml_outfile,          /* O: address of output XML filename */
+    Synthetic_scene_t *scene     /* O: synthetic product */
+)
+{
+    int c;                           /* current argument index */
+    int i;                           /* looping variable */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    const char *instrument = "OLI_TIRS";  /* instrument of the product */
+    const char *proj = "utm";        /* projection of the product */
+    int nbands = -1;                 /* number of image bands; -1 if not
+                                        given */
+    int misalign = -1;               /* footprint misalignment; -1 if not
+                                        given */
+    char *data_type = NULL;          /* data type of the image bands */
+    const char *value[OPT_HELP - OPT_XML];  /* values of the options which
+                                        override the defaults; NULL if not
+                                        given */
+    static int qa_flag = 0;          /* flag to indicate if the quality band
+                                        should be added */
+    static struct option long_options[] =
+    {
+        {"qa", no_argument, &qa_flag, 1},
+        {"xml", required_argument, 0, OPT_XML},
+        {"instrument", required_argument, 0, OPT_INSTRUMENT},
+        {"nbands", required_argument, 0, OPT_NBANDS},
+        {"data_type", required_argument, 0, OPT_DATA_TYPE},
+        {"nlines", required_argument, 0, OPT_NLINES},
+        {"nsamps", required_argument, 0, OPT_NSAMPS},
+        {"fill", required_argument, 0, OPT_FILL},
+        {"footprint_angle", required_argument, 0, OPT_FOOTPRINT_ANGLE},
+        {"misalign", required_argument, 0, OPT_MISALIGN},
+        {"fill_fraction", required_argument, 0, OPT_FILL_FRACTION},
+        {"seed", required_argument, 0, OPT_SEED},
+        {"proj", required_argument, 0, OPT_PROJ},
+        {"datum", required_argument, 0, OPT_DATUM},
+        {"zone", required_argument, 0, OPT_ZONE},
+        {"ul_x", required_argument, 0, OPT_UL_X},
+        {"ul_y", required_argument, 0, OPT_UL_Y},
+        {"pixel_size", required_argument, 0, OPT_PIXEL_SIZE},
+        {"longitude_pole", required_argument, 0, OPT_LONGITUDE_POLE},
+        {"latitude_true_scale", required_argument, 0,
+            OPT_LATITUDE_TRUE_SCALE},
+        {"standard_parallel1", required_argument, 0, OPT_STANDARD_PARALLEL1},
+        {"standard_parallel2", required_argument, 0, OPT_STANDARD_PARALLEL2},
+        {"central_meridian", required_argument, 0, OPT_CENTRAL_MERIDIAN},
+        {"origin_latitude", required_argument, 0, OPT_ORIGIN_LATITUDE},
+        {"false_easting", required_argument, 0, OPT_FALSE_EASTING},
+        {"false_northing", required_argument, 0, OPT_FALSE_NORTHING},
+        {"sphere_radius", required_argument, 0, OPT_SPHERE_RADIUS},
+        {"bounds", required_argument, 0, OPT_BOUNDS},
+        {"help", no_argument, 0, OPT_HELP},
+        {0, 0, 0, 0}
+    };
+    Espa_proj_meta_t *proj_info = &scene->proj_info;  /* projection */
+    struct
+    {
+        int code;                    /* code of the option */
+        const char *name;            /* name of the option */
+        double *param;               /* value set by the option */
+    } double_params[] =
+    {
+        {OPT_UL_X, "ul_x", &proj_info->ul_corner[0]},
+        {OPT_UL_Y, "ul_y", &proj_info->ul_corner[1]},
+        {OPT_PIXEL_SIZE, "pixel_size", &scene->pixel_size},
+        {OPT_LONGITUDE_POLE, "longitude_pole", &proj_info->longitude_pole},
+        {OPT_LATITUDE_TRUE_SCALE, "latitude_true_scale",
+            &proj_info->latitude_true_scale},
+        {OPT_STANDARD_PARALLEL1, "standard_parallel1",
+            &proj_info->standard_parallel1},
+        {OPT_STANDARD_PARALLEL2, "standard_parallel2",
+            &proj_info->standard_parallel2},
+        {OPT_CENTRAL_MERIDIAN, "central_meridian",
+            &proj_info->central_meridian},
+        {OPT_ORIGIN_LATITUDE, "origin_latitude", &proj_info->origin_latitude},
+        {OPT_FALSE_EASTING, "false_easting", &proj_info->false_easting},
+        {OPT_FALSE_NORTHING, "false_northing", &proj_info->false_northing},
+        {OPT_SPHERE_RADIUS, "sphere_radius", &proj_info->sphere_radius},
+        {OPT_FOOTPRINT_ANGLE, "footprint_angle", &scene->footprint_angle},
+        {OPT_FILL_FRACTION, "fill_fraction", &scene->fill_fraction}
+    };
+
+    init_synthetic_scene (scene);
+    for (i = 0; i < OPT_HELP - OPT_XML; i++)
+        value[i] = NULL;
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case OPT_HELP:  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case OPT_XML:  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case OPT_INSTRUMENT:  /* instrument layout */
+                instrument = optarg;
+                break;
+
+            case OPT_NBANDS:  /* number of image bands */
+                nbands = atoi (optarg);
+                break;
+
+            case OPT_DATA_TYPE:  /* data type of the image bands */
+                data_type = optarg;
+                break;
+
+            case OPT_MISALIGN:  /* footprint misalignment */
+                misalign = atoi (optarg);
+                break;
+
+            case OPT_PROJ:  /* projection */
+                proj = optarg;
+                break;
+
+            case OPT_NLINES:
+            case OPT_NSAMPS:
+            case OPT_FILL:
+            case OPT_FOOTPRINT_ANGLE:
+            case OPT_FILL_FRACTION:
+            case OPT_SEED:
+            case OPT_DATUM:
+            case OPT_ZONE:
+            case OPT_UL_X:
+            case OPT_UL_Y:
+            case OPT_PIXEL_SIZE:
+            case OPT_LONGITUDE_POLE:
+            case OPT_LATITUDE_TRUE_SCALE:
+            case OPT_STANDARD_PARALLEL1:
+            case OPT_STANDARD_PARALLEL2:
+            case OPT_CENTRAL_MERIDIAN:
+            case OPT_ORIGIN_LATITUDE:
+            case OPT_FALSE_EASTING:
+            case OPT_FALSE_NORTHING:
+            case OPT_SPHERE_RADIUS:
+            case OPT_BOUNDS:
+                /* Applied after the instrument and projection defaults */
+                value[c - OPT_XML] = optarg;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the XML output file was specified */
+    if (*xml_outfile == NULL)
+    {
+        sprintf (errmsg, "XML output file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Instrument layout */
+    if (!strcmp (instrument, "TM") || !strcmp (instrument, "ETM"))
+    {
+        strcpy (scene->satellite, instrument[0] == 'T' ? "LANDSAT_5" :
+            "LANDSAT_7");
+        strcpy (scene->instrument, instrument);
+        scene->band_names = instrument[0] == 'T' ? tm_bands : etm_bands;
+        scene->nbands = instrument[0] == 'T' ? 7 : 8;
+        scene->qa_band = true;
+        scene->data_type = ESPA_UINT8;
+        scene->misalign = 5;
+    }
+    else if (strcmp (instrument, "OLI_TIRS"))
+    {
+        sprintf (errmsg, "Instrument must be TM, ETM, or OLI_TIRS");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (nbands != -1)
+    {
+        scene->nbands = nbands;
+        scene->band_names = NULL;
+    }
+    if (misalign != -1)
+        scene->misalign = misalign;
+    if (qa_flag)
+        scene->qa_band = true;
+
+    if (data_type != NULL)
+    {
+        if (!strcmp (data_type, "int8"))
+            scene->data_type = ESPA_INT8;
+        else if (!strcmp (data_type, "uint8"))
+            scene->data_type = ESPA_UINT8;
+        else if (!strcmp (data_type, "int16"))
+            scene->data_type = ESPA_INT16;
+        else if (!strcmp (data_type, "uint16"))
+            scene->data_type = ESPA_UINT16;
+        else if (!strcmp (data_type, "int32"))
+            scene->data_type = ESPA_INT32;
+        else if (!strcmp (data_type, "uint32"))
+            scene->data_type = ESPA_UINT32;
+        else if (!strcmp (data_type, "float32"))
+            scene->data_type = ESPA_FLOAT32;
+        else if (!strcmp (data_type, "float64"))
+            scene->data_type = ESPA_FLOAT64;
+        else
+        {
+            sprintf (errmsg, "Unknown data type %s", data_type);
+            error_handler (true, FUNC_NAME, errmsg);
+            usage ();
+            return (ERROR);
+        }
+    }
+
+    /* Bounds come before the projection, since the geographic UL corner
+       defaults to them */
+    if (value[OPT_BOUNDS - OPT_XML] != NULL &&
+        sscanf (value[OPT_BOUNDS - OPT_XML], "%lf,%lf,%lf,%lf",
+        &scene->bounding_coords[ESPA_WEST], &scene->bounding_coords[ESPA_EAST],
+        &scene->bounding_coords[ESPA_NORTH],
+        &scene->bounding_coords[ESPA_SOUTH]) != 4)
+    {
+        sprintf (errmsg, "Bounds must be west,east,north,south");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (set_projection_defaults (proj, scene) != SUCCESS)
+    {
+        usage ();
+        return (ERROR);
+    }
+
+    /* Options overriding the defaults */
+    for (i = 0; i < sizeof (double_params) / sizeof (double_params[0]); i++)
+    {
+        if (value[double_params[i].code - OPT_XML] != NULL &&
+            parse_double (double_params[i].name,
+            value[double_params[i].code - OPT_XML], double_params[i].param)
+            != SUCCESS)
+        {
+            usage ();
+            return (ERROR);
+        }
+    }
+    if (value[OPT_NLINES - OPT_XML] != NULL)
+        scene->nlines = atoi (value[OPT_NLINES - OPT_XML]);
+    if (value[OPT_NSAMPS - OPT_XML] != NULL)
+        scene->nsamps = atoi (value[OPT_NSAMPS - OPT_XML]);
+    if (value[OPT_SEED - OPT_XML] != NULL)
+        scene->seed = strtoul (value[OPT_SEED - OPT_XML], NULL, 10);
+    if (value[OPT_ZONE - OPT_XML] != NULL)
+        proj_info->utm_zone = atoi (value[OPT_ZONE - OPT_XML]);
+
+    if (value[OPT_FILL - OPT_XML] != NULL)
+    {
+        if (!strcmp (value[OPT_FILL - OPT_XML], "none"))
+            scene->fill = SYNTHETIC_FILL_NONE;
+        else if (!strcmp (value[OPT_FILL - OPT_XML], "footprint"))
+            scene->fill = SYNTHETIC_FILL_FOOTPRINT;
+        else if (!strcmp (value[OPT_FILL - OPT_XML], "random"))
+            scene->fill = SYNTHETIC_FILL_RANDOM;
+        else
+        {
+            sprintf (errmsg, "Fill must be none, footprint, or random");
+            error_handler (true, FUNC_NAME, errmsg);
+            usage ();
+            return (ERROR);
+        }
+    }
+
+    if (value[OPT_DATUM - OPT_XML] != NULL)
+    {
+        if (!strcmp (value[OPT_DATUM - OPT_XML], "WGS84"))
+            proj_info->datum_type = ESPA_WGS84;
+        else if (!strcmp (value[OPT_DATUM - OPT_XML], "NAD83"))
+            proj_info->datum_type = ESPA_NAD83;
+        else if (!strcmp (value[OPT_DATUM - OPT_XML], "NAD27"))
+            proj_info->datum_type = ESPA_NAD27;
+        else if (!strcmp (value[OPT_DATUM - OPT_XML], "none"))
+            proj_info->datum_type = ESPA_NODATUM;
+        else
+        {
+            sprintf (errmsg, "Datum must be WGS84, NAD83, NAD27, or none");
+            error_handler (true, FUNC_NAME, errmsg);
+            usage ();
+            return (ERROR);
+        }
+    }
+
+    /* Make sure the UTM zone is valid */
+    if (proj_info->proj_type == GCTP_UTM_PROJ &&
+        (proj_info->utm_zone == 0 || abs (proj_info->utm_zone) > 60))
+    {
+        sprintf (errmsg, "UTM zone must be from 1 to 60, or -1 to -60 in the "
+            "southern hemisphere");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates a synthetic ESPA product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the product
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The remaining checks of the product description are done by
+     create_synthetic_scene, which reports them.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *espa_xml_file = NULL;  /* output ESPA XML metadata filename */
+    Synthetic_scene_t scene;     /* synthetic product */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &scene) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (create_synthetic_scene (&scene, espa_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the synthetic product %s", espa_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (espa_xml_file);
+        exit (ERROR);
+    }
+
+    printf ("Created %s: %d bands of %d lines x %d samples\n", espa_xml_file,
+        scene.nbands + (scene.qa_band ? 1 : 0), scene.nlines, scene.nsamps);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    exit (SUCCESS);
+}
@@ -0,0 +1,322 @@
+/*****************************************************************************
+FILE: create_toa_bands
+  
+PURPOSE: Creates the TOA reflectance and brightness temperature bands.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "envi_header.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "generate_toa_bands.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("create_toa_bands creates the top-of-atmosphere (TOA) "
+            "reflectance bands for the level 1 image bands which have a "
+            "reflectance gain and bias, and the brightness temperature bands "
+            "for the ones which have the thermal K1/K2 constants.  The "
+            "reflectance uses the per-pixel solar zenith bands when the "
+            "scene has them, and the scene center solar zenith otherwise.\n"
+            "The output filenames are the product ID with _toa_band<n>.img "
+            "and _bt_band<n>.img appended.  The bands are 16-bit integers "
+            "scaled by %g (reflectance) and %g (kelvin).\n\n",
+            TOA_REFL_SCALE_FACT, TOA_BT_SCALE_FACT);
+    printf ("usage: create_toa_bands --xml=input_metadata_filename "
+            "[--max_memory=size]\n");
+    printf ("       create_toa_bands --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--max_memory=size]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks and "
+            "threads are sized to fit it, and the scene list workers share "
+            "it (default is the ESPA_MAX_MEMORY environment variable, or no "
+            "budget)\n");
+    printf ("\nExample: create_toa_bands "
+            "--xml=LC80470272013287LGN00.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+     
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+            *xml_infile = strdup (optarg);
+            break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE: Creates the TOA reflectance and brightness temperature bands for
+one scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the TOA bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The output filenames are the product ID with _toa_band<n>.img and
+     _bt_band<n>.img appended.
+  2. It is expected this will be run on the XML file that contains the
+     converted LPGS Level 1 bands, and the angle bands if the per-pixel solar
+     zenith is to be used.
+  3. The TOA bands are written a block of lines at a time directly to the
+     output files, so the full bands are never held in memory.
+  4. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: not used */
+)
+{
+    char FUNC_NAME[] = "create_toa_bands";  /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    Espa_internal_meta_t out_meta;     /* output metadata for bands */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata.  Only the global metadata and the main band fields are
+       needed, so the band details are left out. */
+    if (parse_metadata_lazy (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* Create the TOA bands and their ENVI headers */
+    if (create_toa_bands (&xml_metadata, &out_meta) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
+    }
+
+    /* Append the TOA bands to the XML file */
+    if (append_metadata (out_meta.nbands, out_meta.band, espa_xml_file)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Appending TOA bands to the XML file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        free_metadata (&xml_metadata);
+        free_metadata (&out_meta);
+        return (ERROR);
+    }
+
+    /* Free the input and output XML metadata */
+    free_metadata (&xml_metadata);
+    free_metadata (&out_meta);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Creates the TOA reflectance and brightness temperature bands for the
+current scene, or for each scene of the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the TOA bands
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &scene_list, &nprocs)
+        != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (scene_list != NULL)
+    {
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                NULL);
+    }
+    else
+        status = process_scene (espa_xml_file, NULL, NULL);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    free (scene_list);
+
+    exit (status);
+}
@@ -0,0 +1,450 @@
+/*****************************************************************************
+FILE: espa_ard_tiles
+
+PURPOSE: Contains functions for cutting an ESPA raw binary product into the
+tiles of a fixed grid, such as the Albers ARD grids.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_ard_tiles.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Options applying to all the scenes */
+typedef struct
+{
+    char *template_xml;      /* XML file of the template product */
+    Ard_grid_opts_t grid;    /* definition of the tile grid */
+} Ard_options_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_ard_tiles cuts the bands of the input XML metadata file "
+            "into the tiles of a fixed grid in the projection of a template "
+            "product, resampling each band once for all the tiles it "
+            "overlaps, and writes each tile as an ESPA product in its own "
+            "hHHHvVVV directory of the output directory.\n\n");
+    printf ("usage: espa_ard_tiles "
+            "--xml=input_metadata_filename "
+            "--output_dir=output_directory "
+            "--template_xml=template_metadata_filename "
+            "[--tile_size=npixels] [--pixel_size=size] "
+            "[--origin_x=x --origin_y=y] [--max_memory=size]\n");
+    printf ("       espa_ard_tiles --scene_list=scene_list_filename "
+            "[--procs=nprocs] --template_xml=template_metadata_filename "
+            "[--tile_size=npixels] [--pixel_size=size] "
+            "[--origin_x=x --origin_y=y] [--max_memory=size]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -output_dir: directory the tile directories are written "
+            "to; each tile has the bands and XML filename of the input\n");
+    printf ("    -template_xml: name of the XML metadata file of the "
+            "template product, whose projection and orientation the tile "
+            "grid has\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -tile_size: number of lines and samples in a tile (default "
+            "is %d)\n", ARD_DEFAULT_TILE_SIZE);
+    printf ("    -pixel_size: pixel size of the tiles in the projection "
+            "units of the template (default is the pixel size of the "
+            "template)\n");
+    printf ("    -origin_x, -origin_y: projection coordinates of the upper "
+            "left corner of tile h000v000 (default is the upper left corner "
+            "of the template)\n");
+    printf ("    -scene_list: instead of -xml and -output_dir, name of a "
+            "file listing the input XML file and the output directory "
+            "of each product to be processed, one product per line, or - "
+            "for the standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the threads are sized "
+            "to fit it, and the scene list workers share it (default is the "
+            "ESPA_MAX_MEMORY environment variable, or no budget)\n");
+    printf ("\nExample: espa_ard_tiles "
+            "--xml=LC08_L1TP_033033_20170716_20170727_01_T1.xml "
+            "--output_dir=ard --template_xml=conus_albers.xml "
+            "--pixel_size=30 --origin_x=-2565585 --origin_y=3314805\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_coord
+
+PURPOSE:  Converts the value of a numeric option to a number.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The value isn't a number
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_coord
+(
+    const char *option,   /* I: name of the option */
+    const char *value,    /* I: value of the option */
+    double *coord         /* O: coordinate */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_coord";  /* function name */
+    char *end = NULL;                /* end of the number */
+
+    *coord = strtod (value, &end);
+    if (end == value || *end != '\0')
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid %s value: %s", option,
+            value);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input file and output directory.  All of
+     these should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **out_dir,       /* O: address of output directory */
+    Ard_options_t *opts,  /* O: options applying to all the scenes */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    bool has_x = false;              /* was the origin x given? */
+    bool has_y = false;              /* was the origin y given? */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"output_dir", required_argument, 0, 'o'},
+        {"template_xml", required_argument, 0, 't'},
+        {"tile_size", required_argument, 0, 's'},
+        {"pixel_size", required_argument, 0, 'p'},
+        {"origin_x", required_argument, 0, 'x'},
+        {"origin_y", required_argument, 0, 'y'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* output directory */
+                *out_dir = strdup (optarg);
+                break;
+
+            case 't':  /* template XML file */
+                opts->template_xml = strdup (optarg);
+                break;
+
+            case 's':  /* tile size */
+                opts->grid.tile_size = atoi (optarg);
+                break;
+
+            case 'p':  /* pixel size of the tiles */
+                if (get_coord ("pixel_size", optarg, &opts->grid.pixel_size)
+                    != SUCCESS || opts->grid.pixel_size <= 0.0)
+                {
+                    sprintf (errmsg, "Pixel size must be positive");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'x':  /* origin x */
+                if (get_coord ("origin_x", optarg, &opts->grid.origin_x) !=
+                    SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                has_x = true;
+                break;
+
+            case 'y':  /* origin y */
+                if (get_coord ("origin_y", optarg, &opts->grid.origin_y) !=
+                    SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                has_y = true;
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The output directory is required with the XML input file, and is given
+       by the scene list otherwise */
+    if ((*xml_infile == NULL) != (*out_dir == NULL))
+    {
+        sprintf (errmsg, "Output directory is a required argument with the "
+            "XML input file, and can't be used with the scene list");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the template was specified */
+    if (opts->template_xml == NULL)
+    {
+        sprintf (errmsg, "Template XML file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the grid is valid */
+    if (opts->grid.tile_size < 1)
+    {
+        sprintf (errmsg, "Tile size must be positive");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (has_x != has_y)
+    {
+        sprintf (errmsg, "Both the origin x and y must be specified");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    opts->grid.has_origin = has_x;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Cuts one XML metadata file into the tiles of the grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the tiling
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *out_dir,        /* I: output directory */
+    void *arg             /* I: options (Ard_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    int ntiles;                  /* number of tiles written */
+    Ard_options_t *opts = arg;   /* options applying to all the scenes */
+
+    /* The scene list has to give the output directory */
+    if (out_dir == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the output directory "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the tiles and their XML metadata files */
+    if (tile_ard_xml (xml_infile, out_dir, opts->template_xml, &opts->grid,
+        &ntiles) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    printf ("%s: %d tiles written to %s\n", xml_infile, ntiles, out_dir);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Cuts the bands of the input XML metadata file into the tiles of a
+fixed grid and creates an XML metadata file for each tile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the tiling
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *out_dir = NULL;             /* output directory */
+    char *scene_list = NULL;          /* list of products to be processed */
+    int nprocs = 1;                   /* number of scenes processed
+                                         concurrently */
+    int status;                       /* return status of the tiling */
+    Ard_options_t opts = {NULL, {ARD_DEFAULT_TILE_SIZE, 0.0, false, 0.0,
+        0.0}};                        /* options applying to all the
+                                         scenes */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &out_dir, &opts, &scene_list,
+        &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Tile the XML files of the scene list, or the single XML file.  The
+       schema is compiled once for all the scenes. */
+    if (scene_list != NULL)
+    {
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &opts);
+    }
+    else
+        status = process_scene (xml_infile, out_dir, &opts);
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (out_dir);
+    free (opts.template_xml);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
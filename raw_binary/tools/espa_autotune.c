@@ -0,0 +1,910 @@
+/*****************************************************************************
+FILE: espa_autotune
+
+PURPOSE: Measures the line block size, thread count and write cache handling
+which are fastest on this node, and writes them to the node profile read by
+the libraries.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The probes are:
+       write_cache   writes a band with each cache mode (normal, dontneed,
+                     direct) and syncs it to the disk
+       line_block    reads a band in blocks of 64 to 2048 lines, scales the
+                     blocks to physical values and writes them, as the
+                     line-streaming stages do
+       task_threads  scales a band in memory with 1, 2, 4, ... threads of
+                     the task pool, up to the number of CPUs
+     Each case is run --repeat times and its fastest run is kept.  A slower
+     choice is preferred when it is within a few percent of the fastest,
+     since the measurements are noisy: the normal cache mode, the smaller
+     block and the fewer threads.
+  2. The result of each case is written as a JSON line with the "probe",
+     "case", "seconds" and "mb_per_sec", followed by the profile itself.
+  3. The I/O probes run in the directory given by --dir, which should be on
+     the file system the products are processed on.  Their files are
+     removed at the end.
+  4. The node profile and the ESPA_TASK_THREADS and ESPA_WRITE_CACHE
+     environment variables are ignored while probing, so an earlier profile
+     doesn't limit the cases measured.
+*****************************************************************************/
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include "error_handler.h"
+#include "raw_binary_io.h"
+#include "raw_binary_convert.h"
+#include "espa_task.h"
+#include "espa_tune.h"
+
+/* Defines */
+/* Number of samples in the lines of the probe bands, as for a Landsat
+   scene */
+#define TUNE_NSAMPS 8000
+
+/* Default size of the probe bands and number of runs of each case */
+#define TUNE_DEFAULT_SIZE_MB 256
+#define TUNE_DEFAULT_REPEAT 3
+
+/* Line block sizes probed */
+#define TUNE_NBLOCKS 6
+static const int tune_blocks[TUNE_NBLOCKS] = {64, 128, 256, 512, 1024, 2048};
+
+/* Largest size of the band scaled by the thread probe, so it runs from the
+   memory rather than the disk */
+#define TUNE_MAX_THREAD_MB 64
+
+/* Fraction of the fastest time within which the preferred choice is kept */
+#define TUNE_CACHE_SLACK 0.05
+#define TUNE_BLOCK_SLACK 0.03
+#define TUNE_THREAD_SLACK 0.05
+
+/* Type definitions */
+/* Band scaled by the thread probe */
+typedef struct
+{
+    uint16_t *in;         /* input pixels */
+    float *out;           /* physical values of the pixels */
+} Tune_scale_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_autotune measures the line block size, number of threads "
+            "and write cache handling which are fastest on this node, and "
+            "writes them to the node profile the ESPA libraries read at "
+            "startup.\n\n");
+    printf ("usage: espa_autotune [--dir=probe_directory] "
+            "[--size_mb=size] [--repeat=nruns] "
+            "[--profile=profile_filename]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -dir: directory the I/O probes write their files to, which "
+            "should be on the file system the products are processed on "
+            "(default is the current directory)\n");
+    printf ("    -size_mb: size of the probe bands in megabytes (default is "
+            "%d)\n", TUNE_DEFAULT_SIZE_MB);
+    printf ("    -repeat: number of runs of each case, of which the fastest "
+            "is kept (default is %d)\n", TUNE_DEFAULT_REPEAT);
+    printf ("    -profile: name of the node profile to be written (default "
+            "is the ESPA_NODE_PROFILE environment variable, or %s)\n",
+            ESPA_TUNE_DEFAULT_PROFILE);
+    printf ("\nExample: espa_autotune --dir=/data/espa "
+            "--profile=/etc/espa/node_profile\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument is invalid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the probe directory and profile name.  The
+     caller is responsible for freeing the allocated memory upon successful
+     return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **dir,           /* O: address of the probe directory */
+    int *size_mb,         /* O: size of the probe bands in megabytes */
+    int *repeat,          /* O: number of runs of each case */
+    char **profile        /* O: address of the node profile filename */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"dir", required_argument, 0, 'd'},
+        {"size_mb", required_argument, 0, 's'},
+        {"repeat", required_argument, 0, 'r'},
+        {"profile", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'd':  /* probe directory */
+                free (*dir);
+                *dir = strdup (optarg);
+                break;
+
+            case 's':  /* size of the probe bands */
+                *size_mb = atoi (optarg);
+                break;
+
+            case 'r':  /* number of runs */
+                *repeat = atoi (optarg);
+                break;
+
+            case 'p':  /* node profile */
+                free (*profile);
+                *profile = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    if (*size_mb < 16 || *size_mb > 65536)
+    {
+        sprintf (errmsg, "Size of the probe bands must be from 16 to 65536 "
+            "megabytes");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*repeat < 1 || *repeat > 100)
+    {
+        sprintf (errmsg, "Number of runs must be from 1 to 100");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*dir == NULL || *profile == NULL)
+    {
+        sprintf (errmsg, "Allocating the probe directory and profile name");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  elapsed_seconds
+
+PURPOSE: Returns the time of the monotonic clock in seconds.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+seconds         Time of the monotonic clock
+
+NOTES:
+******************************************************************************/
+static double elapsed_seconds (void)
+{
+    struct timespec now;         /* current time */
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec + now.tv_nsec * 1e-9);
+}
+
+
+/******************************************************************************
+MODULE:  print_result
+
+PURPOSE: Writes the result of a case of a probe as a JSON line.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void print_result
+(
+    const char *probe,    /* I: name of the probe */
+    const char *pcase,    /* I: name of the case */
+    double seconds,       /* I: fastest time of the case */
+    double mbytes         /* I: megabytes processed by the case */
+)
+{
+    printf ("{\"probe\": \"%s\", \"case\": \"%s\", \"seconds\": %.6f, "
+        "\"mb_per_sec\": %.2f}\n", probe, pcase, seconds,
+        seconds > 0.0 ? mbytes / seconds : 0.0);
+    fflush (stdout);
+}
+
+
+/******************************************************************************
+MODULE:  fill_probe_lines
+
+PURPOSE: Fills lines of a probe band with varying pixels.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void fill_probe_lines
+(
+    uint16_t *buf,        /* O: lines of the band */
+    int line0,            /* I: first line of the band in the buffer */
+    int nlines            /* I: number of lines in the buffer */
+)
+{
+    size_t pix;           /* pixel of the buffer */
+    size_t npix = (size_t) nlines * TUNE_NSAMPS;  /* pixels in the buffer */
+
+    for (pix = 0; pix < npix; pix++)
+        buf[pix] = (uint16_t) ((line0 * 31 + pix * 7) % 10000);
+}
+
+
+/******************************************************************************
+MODULE:  write_probe_band
+
+PURPOSE: Writes a probe band with the given cache mode and syncs it to the
+disk.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band
+SUCCESS         Successfully wrote the band
+
+NOTES:
+******************************************************************************/
+static int write_probe_band
+(
+    char *file,           /* I: name of the band */
+    Raw_binary_cache_t cache,  /* I: page cache handling of the band */
+    int nlines,           /* I: number of lines of the band */
+    uint16_t *buf,        /* I: buffer of TUNE_NSAMPS * 256 pixels */
+    double *seconds       /* O: time taken */
+)
+{
+    char FUNC_NAME[] = "write_probe_band";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    double start;             /* start time */
+    int line;                 /* first line of the current block */
+    int nblock;               /* lines in the current block */
+    int fd;                   /* descriptor for syncing the band */
+    Raw_binary_writer_t rbw;  /* writer of the band */
+
+    start = elapsed_seconds ();
+    if (open_raw_binary_writer (file, cache, RB_CODEC_NONE, &rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Opening the probe band %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (line = 0; line < nlines; line += nblock)
+    {
+        nblock = nlines - line < 256 ? nlines - line : 256;
+        if (write_raw_binary_writer (&rbw, nblock, TUNE_NSAMPS,
+            sizeof (uint16_t), buf) != SUCCESS)
+        {
+            close_raw_binary_writer (&rbw);
+            sprintf (errmsg, "Writing the probe band %s", file);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+    {
+        sprintf (errmsg, "Closing the probe band %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Include the write back in the time, since the modes differ mainly in
+       when the pages reach the disk */
+    fd = open (file, O_RDONLY);
+    if (fd < 0 || fsync (fd) != 0)
+    {
+        if (fd >= 0)
+            close (fd);
+        sprintf (errmsg, "Syncing the probe band %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    close (fd);
+
+    *seconds = elapsed_seconds () - start;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  probe_write_cache
+
+PURPOSE: Measures the write cache modes and returns the fastest.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the probe bands
+SUCCESS         Successfully probed the modes
+
+NOTES:
+  1. A mode the file system doesn't support, such as direct on tmpfs, is
+     reported and skipped.  The last mode written leaves the band for the
+     line block probe.
+******************************************************************************/
+static int probe_write_cache
+(
+    char *file,           /* I: name of the probe band */
+    int nlines,           /* I: number of lines of the band */
+    int repeat,           /* I: number of runs of each mode */
+    const char **best_mode  /* O: fastest mode */
+)
+{
+    char FUNC_NAME[] = "probe_write_cache";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    static const char *mode_name[] = {"direct", "dontneed", "normal"};
+    static const Raw_binary_cache_t mode[] =
+        {RB_CACHE_DIRECT, RB_CACHE_DONTNEED, RB_CACHE_NORMAL};
+    double mbytes = (double) nlines * TUNE_NSAMPS * sizeof (uint16_t) / 1e6;
+    double seconds;           /* time of a run */
+    double best[3];           /* fastest run of each mode; 0 if failed */
+    double fastest = 0.0;     /* fastest run of all the modes */
+    int m;                    /* looping variable for the modes */
+    int r;                    /* looping variable for the runs */
+    uint16_t *buf = NULL;     /* block of the band */
+
+    buf = malloc ((size_t) 256 * TUNE_NSAMPS * sizeof (uint16_t));
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating the probe block");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    fill_probe_lines (buf, 0, 256);
+
+    for (m = 0; m < 3; m++)
+    {
+        best[m] = 0.0;
+        for (r = 0; r < repeat; r++)
+        {
+            if (write_probe_band (file, mode[m], nlines, buf, &seconds)
+                != SUCCESS)
+            {
+                best[m] = 0.0;
+                break;
+            }
+            if (best[m] == 0.0 || seconds < best[m])
+                best[m] = seconds;
+        }
+
+        if (best[m] == 0.0)
+        {
+            sprintf (errmsg, "Skipping the %s write cache mode",
+                mode_name[m]);
+            error_handler (false, FUNC_NAME, errmsg);
+            continue;
+        }
+        print_result ("write_cache", mode_name[m], best[m], mbytes);
+        if (fastest == 0.0 || best[m] < fastest)
+            fastest = best[m];
+    }
+    free (buf);
+
+    /* The normal mode is the last one, so the band exists if it succeeded */
+    if (best[2] == 0.0)
+    {
+        sprintf (errmsg, "Unable to write the probe band %s", file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *best_mode = mode_name[2];
+    if (best[2] > fastest * (1.0 + TUNE_CACHE_SLACK))
+    {
+        for (m = 0; m < 2; m++)
+        {
+            if (best[m] == fastest)
+                *best_mode = mode_name[m];
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  stream_probe_band
+
+PURPOSE: Reads a probe band in blocks, scales the blocks and writes them, as
+the line-streaming stages do.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the bands
+SUCCESS         Successfully streamed the band
+
+NOTES:
+******************************************************************************/
+static int stream_probe_band
+(
+    char *in_file,        /* I: name of the probe band */
+    char *out_file,       /* I: name of the scaled band */
+    int nlines,           /* I: number of lines of the band */
+    int block_lines,      /* I: number of lines in a block */
+    uint16_t *in_buf,     /* I: buffer of block_lines lines of input */
+    float *out_buf,       /* I: buffer of block_lines lines of output */
+    double *seconds       /* O: time taken */
+)
+{
+    char FUNC_NAME[] = "stream_probe_band";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    double start;             /* start time */
+    int line;                 /* first line of the current block */
+    int nblock;               /* lines in the current block */
+    int status = SUCCESS;     /* return status */
+    FILE *fp = NULL;          /* probe band */
+    Raw_binary_writer_t rbw;  /* writer of the scaled band */
+
+    start = elapsed_seconds ();
+    fp = open_raw_binary (in_file, "rb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the probe band %s", in_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (open_raw_binary_writer (out_file, RB_CACHE_NORMAL, RB_CODEC_NONE,
+        &rbw) != SUCCESS)
+    {
+        close_raw_binary (fp);
+        sprintf (errmsg, "Opening the scaled band %s", out_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (line = 0; line < nlines && status == SUCCESS; line += nblock)
+    {
+        nblock = nlines - line < block_lines ? nlines - line : block_lines;
+        if (read_raw_binary (fp, nblock, TUNE_NSAMPS, sizeof (uint16_t),
+            in_buf) != SUCCESS ||
+            scale_raw_binary_pixels (in_buf, ESPA_UINT16,
+            (size_t) nblock * TUNE_NSAMPS, 0.0001, 0.0, true, 0, -9999.0,
+            out_buf) != SUCCESS ||
+            write_raw_binary_writer (&rbw, nblock, TUNE_NSAMPS,
+            sizeof (float), out_buf) != SUCCESS)
+            status = ERROR;
+    }
+
+    close_raw_binary (fp);
+    if (close_raw_binary_writer (&rbw) != SUCCESS)
+        status = ERROR;
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Streaming the probe band %s", in_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *seconds = elapsed_seconds () - start;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  probe_line_block
+
+PURPOSE: Measures the line block sizes and returns the fastest.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error streaming the probe band
+SUCCESS         Successfully probed the block sizes
+
+NOTES:
+******************************************************************************/
+static int probe_line_block
+(
+    char *in_file,        /* I: name of the probe band */
+    char *out_file,       /* I: name of the scaled band */
+    int nlines,           /* I: number of lines of the band */
+    int repeat,           /* I: number of runs of each block size */
+    int *best_lines       /* O: fastest block size */
+)
+{
+    char FUNC_NAME[] = "probe_line_block";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char pcase[STR_SIZE];     /* name of the case */
+    double mbytes = (double) nlines * TUNE_NSAMPS * (sizeof (uint16_t) +
+        sizeof (float)) / 1e6;
+    double seconds;           /* time of a run */
+    double best[TUNE_NBLOCKS];  /* fastest run of each block size */
+    double fastest = 0.0;     /* fastest run of all the block sizes */
+    int max_lines = tune_blocks[TUNE_NBLOCKS - 1];  /* largest block */
+    int b;                    /* looping variable for the block sizes */
+    int r;                    /* looping variable for the runs */
+    uint16_t *in_buf = NULL;  /* input block */
+    float *out_buf = NULL;    /* output block */
+
+    in_buf = malloc ((size_t) max_lines * TUNE_NSAMPS * sizeof (uint16_t));
+    out_buf = malloc ((size_t) max_lines * TUNE_NSAMPS * sizeof (float));
+    if (in_buf == NULL || out_buf == NULL)
+    {
+        free (in_buf);
+        free (out_buf);
+        sprintf (errmsg, "Allocating the probe blocks");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (b = 0; b < TUNE_NBLOCKS; b++)
+    {
+        best[b] = 0.0;
+        for (r = 0; r < repeat; r++)
+        {
+            if (stream_probe_band (in_file, out_file, nlines, tune_blocks[b],
+                in_buf, out_buf, &seconds) != SUCCESS)
+            {
+                free (in_buf);
+                free (out_buf);
+                return (ERROR);
+            }
+            if (best[b] == 0.0 || seconds < best[b])
+                best[b] = seconds;
+        }
+
+        sprintf (pcase, "%d", tune_blocks[b]);
+        print_result ("line_block", pcase, best[b], mbytes);
+        if (fastest == 0.0 || best[b] < fastest)
+            fastest = best[b];
+    }
+    free (in_buf);
+    free (out_buf);
+
+    /* Smallest block within the slack of the fastest */
+    for (b = 0; b < TUNE_NBLOCKS; b++)
+    {
+        if (best[b] <= fastest * (1.0 + TUNE_BLOCK_SLACK))
+        {
+            *best_lines = tune_blocks[b];
+            break;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  scale_probe_rows
+
+PURPOSE: Scales a chunk of the lines of the thread probe band; the chunk
+function of espa_parallel_for.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error scaling the lines
+SUCCESS         Successfully scaled the lines
+
+NOTES:
+******************************************************************************/
+static int scale_probe_rows
+(
+    void *arg,            /* I: band being scaled (Tune_scale_t) */
+    int first,            /* I: first line of the chunk */
+    int end,              /* I: line after the last one of the chunk */
+    int runner            /* I: number of the runner (unused) */
+)
+{
+    Tune_scale_t *scale = arg;   /* band being scaled */
+    size_t offset = (size_t) first * TUNE_NSAMPS;  /* first pixel */
+
+    (void) runner;
+    return (scale_raw_binary_pixels (scale->in + offset, ESPA_UINT16,
+        (size_t) (end - first) * TUNE_NSAMPS, 0.0001, 0.0, true, 0, -9999.0,
+        scale->out + offset));
+}
+
+
+/******************************************************************************
+MODULE:  probe_task_threads
+
+PURPOSE: Measures the numbers of threads of the task pool and returns the
+fastest.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error scaling the probe band
+SUCCESS         Successfully probed the thread counts
+
+NOTES:
+******************************************************************************/
+static int probe_task_threads
+(
+    int nlines,           /* I: number of lines of the band */
+    int ncpus,            /* I: number of CPUs of the process */
+    int repeat,           /* I: number of runs of each thread count */
+    int *best_threads     /* O: fastest number of threads */
+)
+{
+    char FUNC_NAME[] = "probe_task_threads";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char pcase[STR_SIZE];     /* name of the case */
+    double mbytes = (double) nlines * TUNE_NSAMPS * (sizeof (uint16_t) +
+        sizeof (float)) / 1e6;
+    double start;             /* start time of a run */
+    double seconds;           /* time of a run */
+    double best[32];          /* fastest run of each thread count */
+    double fastest = 0.0;     /* fastest run of all the thread counts */
+    int nthreads[32];         /* thread counts probed */
+    int ncases = 0;           /* number of thread counts probed */
+    int t;                    /* looping variable for the thread counts */
+    int r;                    /* looping variable for the runs */
+    Tune_scale_t scale;       /* band being scaled */
+
+    scale.in = malloc ((size_t) nlines * TUNE_NSAMPS * sizeof (uint16_t));
+    scale.out = malloc ((size_t) nlines * TUNE_NSAMPS * sizeof (float));
+    if (scale.in == NULL || scale.out == NULL)
+    {
+        free (scale.in);
+        free (scale.out);
+        sprintf (errmsg, "Allocating the probe band");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    fill_probe_lines (scale.in, 0, nlines);
+
+    /* Powers of two up to the number of CPUs, and the number of CPUs */
+    for (t = 1; t < ncpus && ncases < 31; t *= 2)
+        nthreads[ncases++] = t;
+    nthreads[ncases++] = ncpus;
+
+    for (t = 0; t < ncases; t++)
+    {
+        best[t] = 0.0;
+        for (r = 0; r < repeat; r++)
+        {
+            start = elapsed_seconds ();
+            if (espa_parallel_for (0, nlines, 16, nthreads[t],
+                scale_probe_rows, &scale) != SUCCESS)
+            {
+                free (scale.in);
+                free (scale.out);
+                sprintf (errmsg, "Scaling the probe band with %d threads",
+                    nthreads[t]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            seconds = elapsed_seconds () - start;
+            if (best[t] == 0.0 || seconds < best[t])
+                best[t] = seconds;
+        }
+
+        sprintf (pcase, "%d", nthreads[t]);
+        print_result ("task_threads", pcase, best[t], mbytes);
+        if (fastest == 0.0 || best[t] < fastest)
+            fastest = best[t];
+    }
+    free (scale.in);
+    free (scale.out);
+
+    /* Fewest threads within the slack of the fastest */
+    for (t = 0; t < ncases; t++)
+    {
+        if (best[t] <= fastest * (1.0 + TUNE_THREAD_SLACK))
+        {
+            *best_threads = nthreads[t];
+            break;
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Runs the probes and writes the node profile.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the probes or writing the profile
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *dir = strdup (".");    /* probe directory */
+    char *profile = NULL;        /* node profile to be written */
+    char in_file[STR_SIZE];      /* probe band */
+    char out_file[STR_SIZE];     /* scaled probe band */
+    char host[STR_SIZE];         /* name of the node */
+    char date[STR_SIZE];         /* time of the probes */
+    char comment[STR_SIZE * 4];  /* comment of the profile */
+    char threads_str[STR_SIZE];  /* number of threads of the task pool */
+    const char *cache_mode = NULL;  /* fastest write cache mode */
+    int size_mb = TUNE_DEFAULT_SIZE_MB;  /* size of the probe bands */
+    int repeat = TUNE_DEFAULT_REPEAT;    /* number of runs of each case */
+    int nlines;                  /* number of lines of the probe band */
+    int thread_lines;            /* lines of the thread probe band */
+    int ncpus = 1;               /* number of CPUs of the process */
+    int block_lines = 0;         /* fastest line block size */
+    int threads = 1;             /* fastest number of threads */
+    int status = SUCCESS;        /* return status */
+    time_t now;                  /* time of the probes */
+    cpu_set_t allowed;           /* CPUs the process may run on */
+    Espa_tune_entry_t entry[3];  /* settings of the profile */
+
+    profile = getenv ("ESPA_NODE_PROFILE");
+    profile = strdup (profile != NULL && profile[0] != '\0' &&
+        strcmp (profile, "off") ? profile : ESPA_TUNE_DEFAULT_PROFILE);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &dir, &size_mb, &repeat, &profile) != SUCCESS)
+    {   /* get_args already printed the error message */
+        free (dir);
+        free (profile);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Probe without the settings of an earlier profile, with a task pool of
+       all the CPUs */
+    if (sched_getaffinity (0, sizeof (allowed), &allowed) == 0)
+        ncpus = CPU_COUNT (&allowed);
+    if (ncpus > ESPA_TASK_MAX_THREADS)
+        ncpus = ESPA_TASK_MAX_THREADS;
+    sprintf (threads_str, "%d", ncpus);
+    setenv ("ESPA_NODE_PROFILE", "off", 1);
+    setenv ("ESPA_TASK_THREADS", threads_str, 1);
+    unsetenv ("ESPA_WRITE_CACHE");
+
+    nlines = (int) ((size_t) size_mb * 1000000 / (TUNE_NSAMPS *
+        sizeof (uint16_t)));
+    thread_lines = (int) ((size_t) (size_mb < TUNE_MAX_THREAD_MB ? size_mb :
+        TUNE_MAX_THREAD_MB) * 1000000 / (TUNE_NSAMPS * sizeof (uint16_t)));
+    if (snprintf (in_file, sizeof (in_file), "%s/espa_autotune_%ld_in.img",
+        dir, (long) getpid ()) >= sizeof (in_file) ||
+        snprintf (out_file, sizeof (out_file),
+        "%s/espa_autotune_%ld_out.img", dir, (long) getpid ()) >=
+        sizeof (out_file))
+    {
+        sprintf (errmsg, "Overflow of the probe band filenames");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (dir);
+        free (profile);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Run the probes */
+    if (probe_write_cache (in_file, nlines, repeat, &cache_mode) != SUCCESS
+        || probe_line_block (in_file, out_file, nlines, repeat,
+        &block_lines) != SUCCESS ||
+        probe_task_threads (thread_lines, ncpus, repeat, &threads) !=
+        SUCCESS)
+        status = ERROR;
+    unlink (in_file);
+    unlink (out_file);
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Probing the node");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (dir);
+        free (profile);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Write the profile */
+    if (gethostname (host, sizeof (host)) != 0)
+        strcpy (host, "unknown");
+    host[sizeof (host) - 1] = '\0';
+    now = time (NULL);
+    strftime (date, sizeof (date), "%Y-%m-%dT%H:%M:%S", localtime (&now));
+    snprintf (comment, sizeof (comment), "Node profile written by "
+        "espa_autotune on %s at %s\nProbe directory %s, %d MB bands, %d "
+        "runs per case, %d CPUs", host, date, dir, size_mb, repeat, ncpus);
+
+    strcpy (entry[0].key, "task_threads");
+    sprintf (entry[0].value, "%d", threads);
+    strcpy (entry[1].key, "line_block");
+    sprintf (entry[1].value, "%d", block_lines);
+    strcpy (entry[2].key, "write_cache");
+    strcpy (entry[2].value, cache_mode);
+    if (write_espa_tune_profile (profile, comment, 3, entry) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the node profile");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (dir);
+        free (profile);
+        exit (EXIT_FAILURE);
+    }
+    printf ("{\"profile\": \"%s\", \"task_threads\": %d, \"line_block\": %d, "
+        "\"write_cache\": \"%s\"}\n", profile, threads, block_lines,
+        cache_mode);
+
+    /* Free the pointers */
+    free (dir);
+    free (profile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,497 @@
+/*****************************************************************************
+FILE: espa_band_stream
+
+PURPOSE: Packs the XML metadata and bands of an ESPA product into a band
+stream on a pipe, or unpacks a band stream into an ESPA product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_pipe.h for the band stream format.
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_io.h"
+#include "raw_binary_pipe.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_band_stream packs the XML metadata and bands of an ESPA "
+            "product into a band stream, which carries each band with its "
+            "metadata in blocks of lines, or unpacks a band stream back "
+            "into an ESPA product. The stream is written to or read from "
+            "the standard output or input, or a FIFO, so products move "
+            "between the stages of a pipeline, or between hosts, without "
+            "intermediate files. Tiled, compressed and virtual bands are "
+            "streamed as line-major data, and are unpacked as plain bands. "
+            "Constant and derived bands aren't stored, so only their "
+            "metadata is streamed.\n\n");
+    printf ("usage: espa_band_stream --pack --xml=input_metadata_filename "
+            "[--output=stream]\n");
+    printf ("       espa_band_stream --unpack --xml=output_metadata_filename "
+            "[--input=stream]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -pack: write the product to the band stream\n");
+    printf ("    -unpack: instead of -pack, read the product from the band "
+            "stream\n");
+    printf ("    -xml: name of the XML metadata file which follows the ESPA "
+            "internal raw binary schema; the bands unpacked are written "
+            "to the file names in the XML, relative to the current "
+            "directory\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -output: FIFO the stream is written to (default is -, the "
+            "standard output)\n");
+    printf ("    -input: FIFO the stream is read from (default is -, the "
+            "standard input)\n");
+    printf ("\nExample: espa_band_stream --pack "
+            "--xml=LC80470272013287LGN00.xml | ssh node 'cd /work && "
+            "espa_band_stream --unpack --xml=LC80470272013287LGN00.xml'\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the XML file and the stream.  These should be
+     character pointers set to NULL on input.  The caller is responsible for
+     freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_file,      /* O: address of the XML filename */
+    char **stream,        /* O: address of the stream name */
+    bool *unpack          /* O: is the stream unpacked? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int pack_flag = 0;        /* flag for packing the product */
+    static int unpack_flag = 0;      /* flag for unpacking the product */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"pack", no_argument, &pack_flag, 1},
+        {"unpack", no_argument, &unpack_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"output", required_argument, 0, 'o'},
+        {"input", required_argument, 0, 's'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML file */
+                *xml_file = strdup (optarg);
+                break;
+
+            case 'o':  /* output stream */
+            case 's':  /* input stream */
+                free (*stream);
+                *stream = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the XML file was specified */
+    if (*xml_file == NULL)
+    {
+        sprintf (errmsg, "XML file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure exactly one direction was specified */
+    if (pack_flag == unpack_flag)
+    {
+        sprintf (errmsg, "Either --pack or --unpack is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    *unpack = unpack_flag;
+
+    /* Make sure the stream is a pipe */
+    if (*stream == NULL)
+        *stream = strdup (RB_PIPE_STDIO);
+    if (!is_raw_binary_pipe (*stream))
+    {
+        sprintf (errmsg, "Stream %s must be - or a FIFO", *stream);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  copy_band_lines
+
+PURPOSE: Copies the lines of a band from one stream to another.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or writing the band
+SUCCESS         No errors encountered
+
+NOTES:
+  1. If crc isn't NULL, the CRC32C of the lines written is computed.
+******************************************************************************/
+static int copy_band_lines
+(
+    Espa_band_meta_t *bmeta,  /* I: metadata of the band */
+    FILE *in,             /* I: stream the band is read from */
+    FILE *out,            /* I: stream the band is written to */
+    uint32_t *crc         /* O: CRC32C of the lines written; NULL if not
+                                needed */
+)
+{
+    char FUNC_NAME[] = "copy_band_lines";  /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    int line;                      /* looping variable for the lines */
+    int size;                      /* bytes per pixel of the band */
+    int status = SUCCESS;          /* return status */
+    void *buf = NULL;              /* line of the band */
+
+    size = get_data_type_size (bmeta->data_type);
+    buf = malloc ((size_t) bmeta->nsamps * size);
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating a line of band %s", bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (crc != NULL)
+        *crc = 0;
+    for (line = 0; line < bmeta->nlines && status == SUCCESS; line++)
+    {
+        status = read_raw_binary (in, 1, bmeta->nsamps, size, buf);
+        if (status == SUCCESS)
+            status = write_raw_binary (out, 1, bmeta->nsamps, size, buf);
+        if (status == SUCCESS && crc != NULL)
+            *crc = update_raw_binary_crc32c (*crc, buf,
+                (size_t) bmeta->nsamps * size);
+    }
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Copying line %d of band %s", line - 1,
+            bmeta->name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    free (buf);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  pack_product
+
+PURPOSE: Writes the XML metadata and the bands of a product to a band
+stream.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the product or writing the stream
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int pack_product
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *stream          /* I: "-" or the FIFO the stream is written to */
+)
+{
+    char FUNC_NAME[] = "pack_product";  /* function name */
+    char errmsg[STR_SIZE];             /* error message */
+    int i;                             /* looping variable for the bands */
+    int status = SUCCESS;              /* return status */
+    FILE *in = NULL;                   /* band file */
+    FILE *out = NULL;                  /* band on the stream */
+    Espa_band_meta_t *bmeta = NULL;    /* current band */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    /* The XML goes first, so the reader knows the bands that follow */
+    status = write_raw_binary_pipe_product (stream, espa_xml_file);
+
+    for (i = 0; i < xml_metadata.nbands && status == SUCCESS; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        if (bmeta->constant.is_constant || bmeta->derived.is_derived)
+            continue;
+
+        in = open_raw_binary (bmeta->file_name, "rb");
+        if (in == NULL)
+        {
+            status = ERROR;
+            break;
+        }
+        out = open_raw_binary_pipe (stream, "wb", bmeta);
+        if (out == NULL)
+        {
+            close_raw_binary (in);
+            status = ERROR;
+            break;
+        }
+
+        status = copy_band_lines (bmeta, in, out, NULL);
+        close_raw_binary (in);
+        if (fclose (out) != 0 && status == SUCCESS)
+        {
+            sprintf (errmsg, "Ending band %s in the band stream",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    /* Free the XML metadata */
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  unpack_product
+
+PURPOSE: Reads the XML metadata and the bands of a product from a band
+stream, and writes them as an ESPA product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the stream or writing the product
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The bands are written as plain line-major bands, so a band which was
+     tiled is no longer marked tiled, and the checksum of a band is
+     recomputed for its new file.  The XML file is rewritten with them.
+******************************************************************************/
+static int unpack_product
+(
+    char *espa_xml_file,  /* I: output ESPA XML metadata filename */
+    char *stream          /* I: "-" or the FIFO the stream is read from */
+)
+{
+    char FUNC_NAME[] = "unpack_product";  /* function name */
+    char errmsg[STR_SIZE];             /* error message */
+    int i;                             /* looping variable for the bands */
+    int status = SUCCESS;              /* return status */
+    uint32_t crc;                      /* CRC32C of the band file */
+    FILE *in = NULL;                   /* band on the stream */
+    FILE *out = NULL;                  /* band file */
+    Espa_band_meta_t *bmeta = NULL;    /* current band */
+    Espa_band_meta_t header;           /* band header in the stream */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Write the XML from the stream, and read it like any XML file */
+    if (read_raw_binary_pipe_product (stream, espa_xml_file) != SUCCESS)
+        return (ERROR);
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+        return (ERROR);
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands && status == SUCCESS; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        if (bmeta->constant.is_constant || bmeta->derived.is_derived)
+            continue;
+
+        /* Make sure the next band in the stream is this band */
+        init_band_metadata (&header);
+        in = open_raw_binary_pipe (stream, "rb", &header);
+        if (in == NULL)
+        {
+            status = ERROR;
+            break;
+        }
+        if (strcmp (header.name, bmeta->name) ||
+            header.nlines != bmeta->nlines ||
+            header.nsamps != bmeta->nsamps ||
+            header.data_type != bmeta->data_type)
+        {
+            sprintf (errmsg, "Band %s in the band stream doesn't match band "
+                "%s of the XML", header.name, bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (in);
+            status = ERROR;
+            break;
+        }
+
+        out = open_raw_binary (bmeta->file_name, "wb");
+        if (out == NULL)
+        {
+            fclose (in);
+            status = ERROR;
+            break;
+        }
+
+        status = copy_band_lines (bmeta, in, out, &crc);
+        if (fclose (in) != 0 && status == SUCCESS)
+        {
+            sprintf (errmsg, "Reading band %s from the band stream",
+                bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+        if (fclose (out) != 0 && status == SUCCESS)
+        {
+            sprintf (errmsg, "Writing band file %s", bmeta->file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+
+        /* The band file is now a plain band */
+        bmeta->tiling.is_tiled = false;
+        if (bmeta->checksum[0] != '\0')
+            format_raw_binary_checksum (crc, bmeta);
+    }
+
+    if (status == SUCCESS)
+        status = write_metadata (&xml_metadata, espa_xml_file);
+
+    /* Free the XML metadata */
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Packs a product into a band stream, or unpacks one from it.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error packing or unpacking the product
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* ESPA XML metadata filename */
+    char *stream = NULL;         /* "-" or the FIFO of the band stream */
+    bool unpack = false;         /* is the stream unpacked? */
+    int status;                  /* status of packing or unpacking */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &espa_xml_file, &stream, &unpack) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (unpack)
+        status = unpack_product (espa_xml_file, stream);
+    else
+        status = pack_product (espa_xml_file, stream);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    free (stream);
+
+    exit (status);
+}
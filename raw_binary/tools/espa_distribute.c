@@ -0,0 +1,1103 @@
+/*****************************************************************************
+FILE: espa_distribute
+
+PURPOSE: Distributes a mosaic or a time-series stack across several nodes.
+The output is split into parts, which are handed out as jobs to espa_worker
+processes started on the nodes, and the parts of a mosaic are then gathered
+into the output bands and XML file.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each line of the node list is a shell command starting an espa_worker
+     which reads its jobs from the standard input, such as
+     "ssh node01 espa_worker".  The jobs and their results are JSON lines
+     sent over the pipes of the command, so no other transport (e.g. MPI)
+     is needed.
+  2. The parts are whole strips of the mosaic, or whole rows of chunks of
+     the Zarr store of the stack (see espa_mosaic.h and espa_stack.h).  The
+     input list, output and template have to be at the same paths on every
+     node, so they should be absolute paths on a filesystem shared by the
+     nodes.
+  3. Each worker is given one part at a time, so faster nodes take more
+     parts.  A part whose job fails is given out again, up to
+     DIST_MAX_ATTEMPTS times, and the part of a worker which exits is given
+     to the other workers.
+  4. With a catalog (see espa_catalog.h), the inputs are the products of the
+     catalog whose bounding coordinates overlap the bounding box, written to
+     an input list next to the output for the workers.
+*****************************************************************************/
+#include <getopt.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "espa_mosaic.h"
+#include "espa_stack.h"
+#include "espa_catalog.h"
+
+/* Defines */
+/* Largest number of nodes */
+#define DIST_MAX_NODES 256
+
+/* Number of times a part is run before the output fails */
+#define DIST_MAX_ATTEMPTS 3
+
+/* Default number of parts per node, so the nodes which finish early take
+   over the parts of the slower ones */
+#define DIST_PARTS_PER_NODE 4
+
+/* Type definitions */
+/* Worker started on a node */
+typedef struct
+{
+    char *command;                /* command starting the worker */
+    pid_t pid;                    /* process ID of the command; 0 once the
+                                     worker has exited */
+    FILE *to;                     /* stream the jobs are written to */
+    FILE *from;                   /* stream the results are read from */
+    int part;                     /* part being run; -1 if idle */
+} Dist_node_t;
+
+/* Output being distributed */
+typedef struct
+{
+    char *input_list;             /* input list, as seen by the workers */
+    char *output;                 /* output XML file or Zarr store */
+    char *template_xml;           /* template XML file of a mosaic; NULL
+                                     for a stack */
+    char *band_name;              /* band of a stack */
+    Mosaic_options_t mopts;       /* options of a mosaic */
+    int nparts;                   /* number of parts */
+} Dist_output_t;
+
+/* State of a part */
+typedef enum
+{
+    PART_PENDING,                 /* waiting for a worker */
+    PART_RUNNING,                 /* being run by a worker */
+    PART_DONE                     /* written */
+} Dist_part_state_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_distribute splits a mosaic, or a Zarr time-series stack, "
+            "into parts which are run by espa_worker processes on several "
+            "nodes sharing a filesystem, and joins the parts of a mosaic "
+            "into the output bands and XML file.\n\n");
+    printf ("usage: espa_distribute --nodes=node_list_filename "
+            "{--input_list=input_list_filename | "
+            "--catalog=catalog_filename --bbox=west,east,north,south "
+            "[--start_date=yyyy-mm-dd] [--end_date=yyyy-mm-dd]} "
+            "--output=output_filename "
+            "{--template_xml=template_metadata_filename "
+            "[--priority=latest|zenith|qa] [--qa_band=name] "
+            "[--qa_mask=bits] [--pixel_size=size] [--template_extent] | "
+            "--stack_band=band_name} [--nparts=nparts]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -nodes: name of a file listing the command starting an "
+            "espa_worker on each node, one per line (e.g. ssh node01 "
+            "espa_worker)\n");
+    printf ("    -input_list: name of a file listing the input XML metadata "
+            "files, one per line\n");
+    printf ("    -catalog, -bbox: instead of an input list, use the products "
+            "of a catalog built by build_espa_catalog which overlap the "
+            "geographic bounding box, in degrees, and optionally were "
+            "acquired from start_date to end_date\n");
+    printf ("    -output: name of the output XML metadata file of the "
+            "mosaic, or of the output Zarr store of the stack\n");
+    printf ("    -template_xml: name of the XML metadata file of the "
+            "template product of a mosaic (see espa_mosaic)\n");
+    printf ("    -stack_band: name of the band stacked into a Zarr store "
+            "(see espa_stack), instead of a mosaic\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -priority, -qa_band, -qa_mask, -pixel_size, "
+            "-template_extent: options of the mosaic (see espa_mosaic)\n");
+    printf ("    -nparts: number of parts the output is split into, from 2 "
+            "to %d (default is %d per node)\n", MOSAIC_MAX_PARTS,
+            DIST_PARTS_PER_NODE);
+    printf ("\nThe filenames have to be valid on every node, e.g. absolute "
+            "paths on the shared filesystem.\n");
+    printf ("\nExample: espa_distribute --nodes=nodes.txt "
+            "--input_list=/data/scenes.txt "
+            "--output=/data/mosaic/mosaic.xml "
+            "--template_xml=/data/albers_tile.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the filenames and band name.  All of these
+     should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+     The strings of the query point to the command-line arguments.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **node_list,     /* O: address of the node list filename */
+    char **catalog_file,  /* O: address of the catalog filename */
+    Espa_catalog_query_t *query,  /* O: products of the catalog; initialized
+                                        via init_catalog_query */
+    Dist_output_t *out    /* O: output being distributed */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int template_extent = 0;  /* flag for the template extent */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    char *end = NULL;                /* end of a number */
+    static struct option long_options[] =
+    {
+        {"template_extent", no_argument, &template_extent, 1},
+        {"nodes", required_argument, 0, 'N'},
+        {"input_list", required_argument, 0, 'i'},
+        {"catalog", required_argument, 0, 'c'},
+        {"bbox", required_argument, 0, 'g'},
+        {"start_date", required_argument, 0, 'b'},
+        {"end_date", required_argument, 0, 'e'},
+        {"output", required_argument, 0, 'o'},
+        {"template_xml", required_argument, 0, 't'},
+        {"stack_band", required_argument, 0, 's'},
+        {"priority", required_argument, 0, 'r'},
+        {"qa_band", required_argument, 0, 'q'},
+        {"qa_mask", required_argument, 0, 'm'},
+        {"pixel_size", required_argument, 0, 'p'},
+        {"nparts", required_argument, 0, 'n'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'N':  /* node list */
+                *node_list = strdup (optarg);
+                break;
+
+            case 'i':  /* input list */
+                out->input_list = strdup (optarg);
+                break;
+
+            case 'c':  /* catalog file */
+                *catalog_file = strdup (optarg);
+                break;
+
+            case 'g':  /* bounding box */
+                if (sscanf (optarg, "%lf,%lf,%lf,%lf", &query->bbox[0],
+                    &query->bbox[1], &query->bbox[2], &query->bbox[3]) != 4
+                    || query->bbox[0] > query->bbox[1] ||
+                    query->bbox[3] > query->bbox[2])
+                {
+                    sprintf (errmsg, "Invalid bounding box %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                query->use_bbox = true;
+                break;
+
+            case 'b':  /* first acquisition date */
+                query->start_date = optarg;
+                break;
+
+            case 'e':  /* last acquisition date */
+                query->end_date = optarg;
+                break;
+
+            case 'o':  /* output */
+                out->output = strdup (optarg);
+                break;
+
+            case 't':  /* template XML file */
+                out->template_xml = strdup (optarg);
+                break;
+
+            case 's':  /* band of the stack */
+                out->band_name = strdup (optarg);
+                break;
+
+            case 'r':  /* priority of the scenes */
+                if (!strcmp (optarg, "latest"))
+                    out->mopts.priority = MOSAIC_LATEST;
+                else if (!strcmp (optarg, "zenith"))
+                    out->mopts.priority = MOSAIC_ZENITH;
+                else if (!strcmp (optarg, "qa"))
+                    out->mopts.priority = MOSAIC_QA;
+                else
+                {
+                    sprintf (errmsg, "Unknown priority %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'q':  /* QA band name */
+                snprintf (out->mopts.qa_band, sizeof (out->mopts.qa_band),
+                    "%s", optarg);
+                break;
+
+            case 'm':  /* QA mask */
+                out->mopts.qa_mask = strtoul (optarg, &end, 0);
+                if (end == optarg || *end != '\0')
+                {
+                    sprintf (errmsg, "Invalid QA mask %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'p':  /* output pixel size */
+                out->mopts.pixel_size = strtod (optarg, &end);
+                if (end == optarg || *end != '\0' ||
+                    out->mopts.pixel_size <= 0.0)
+                {
+                    sprintf (errmsg, "Pixel size must be positive");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'n':  /* number of parts */
+                out->nparts = atoi (optarg);
+                if (out->nparts < 2 || out->nparts > MOSAIC_MAX_PARTS)
+                {
+                    sprintf (errmsg, "Number of parts must be from 2 to %d",
+                        MOSAIC_MAX_PARTS);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+    out->mopts.template_extent = (template_extent != 0);
+
+    /* Make sure the nodes, inputs, output and kind of output were
+       specified */
+    if (*node_list == NULL || out->output == NULL)
+    {
+        sprintf (errmsg, "The node list and output are required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if ((out->input_list != NULL) == (*catalog_file != NULL) ||
+        (*catalog_file != NULL && !query->use_bbox))
+    {
+        sprintf (errmsg, "Either the input list, or the catalog and the "
+            "bounding box, are required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if ((out->template_xml != NULL) == (out->band_name != NULL))
+    {
+        sprintf (errmsg, "Either the template XML file of a mosaic or the "
+            "band of a stack is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (out->mopts.priority == MOSAIC_QA && out->mopts.qa_band[0] == '\0')
+    {
+        sprintf (errmsg, "The QA band is a required argument with the QA "
+            "priority");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_list
+
+PURPOSE: Reads the lines of a list file, such as the node list or the input
+list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the list
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines and lines starting with # are ignored, and the whitespace
+     around each line is trimmed.  The caller is responsible for freeing the
+     lines and the list.
+******************************************************************************/
+static int read_list
+(
+    char *list_file,      /* I: name of the list file */
+    int *nitems,          /* O: number of lines */
+    char ***items         /* O: address of the lines */
+)
+{
+    char FUNC_NAME[] = "read_list";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char *line = NULL;    /* current line of the list */
+    size_t line_size = 0; /* allocated size of line */
+    char *ptr = NULL;     /* start of the item in the line */
+    char *end = NULL;     /* end of the item in the line */
+    char **new_ptr = NULL;  /* reallocated list of items */
+    int size = 0;         /* allocated number of items */
+    int status = SUCCESS; /* return status */
+    FILE *fptr = NULL;    /* list file pointer */
+
+    *nitems = 0;
+    *items = NULL;
+    fptr = fopen (list_file, "r");
+    if (fptr == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the list %s",
+            list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (getline (&line, &line_size, fptr) != -1)
+    {
+        /* Trim the whitespace around the item */
+        ptr = line;
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (*ptr == '\0' || *ptr == '#')
+            continue;
+        end = ptr + strlen (ptr);
+        while (end > ptr && isspace ((unsigned char) end[-1]))
+            end--;
+        *end = '\0';
+
+        if (*nitems == size)
+        {
+            size = (size > 0) ? size * 2 : 256;
+            new_ptr = realloc (*items, size * sizeof (char *));
+            if (new_ptr == NULL)
+            {
+                status = ERROR;
+                break;
+            }
+            *items = new_ptr;
+        }
+
+        (*items)[*nitems] = strdup (ptr);
+        if ((*items)[*nitems] == NULL)
+        {
+            status = ERROR;
+            break;
+        }
+        (*nitems)++;
+    }
+    free (line);
+    fclose (fptr);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the list");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else if (*nitems == 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "The list %s is empty",
+            list_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  free_list
+
+PURPOSE: Frees the lines read by read_list.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_list
+(
+    int nitems,           /* I: number of lines */
+    char **items          /* I: lines */
+)
+{
+    int i;                /* looping variable */
+
+    for (i = 0; i < nitems; i++)
+        free (items[i]);
+    free (items);
+}
+
+
+/******************************************************************************
+MODULE:  write_catalog_inputs
+
+PURPOSE: Writes the input list of the products of the catalog which match
+the query.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error querying the catalog or writing the input list
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int write_catalog_inputs
+(
+    char *catalog_file,   /* I: name of the catalog file */
+    Espa_catalog_query_t *query,  /* I: products to be used */
+    char *input_list      /* I: name of the input list to be written */
+)
+{
+    char FUNC_NAME[] = "write_catalog_inputs";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int *scenes = NULL;   /* matching scenes */
+    int nscenes = 0;      /* number of matching scenes */
+    int i;                /* looping variable */
+    int status = SUCCESS; /* return status */
+    Espa_catalog_t catalog;  /* opened catalog */
+    FILE *fptr = NULL;    /* input list file pointer */
+
+    if (open_espa_catalog (catalog_file, &catalog) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (query_espa_catalog (&catalog, query, &scenes, &nscenes) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_catalog (&catalog);
+        return (ERROR);
+    }
+
+    if (nscenes == 0)
+    {
+        sprintf (errmsg, "No products of the catalog overlap the bounding "
+            "box");
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+    else
+    {
+        fptr = fopen (input_list, "w");
+        if (fptr == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Opening the input list %s",
+                input_list);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+        }
+    }
+
+    for (i = 0; i < nscenes && fptr != NULL; i++)
+        fprintf (fptr, "%s\n", get_catalog_xml_file (&catalog, scenes[i]));
+    if (fptr != NULL && fclose (fptr) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing the input list %s",
+            input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    free (scenes);
+    close_espa_catalog (&catalog);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  start_node
+
+PURPOSE: Starts the worker of a node, with pipes to its standard input and
+output.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting the worker
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The command is run by /bin/sh, and its standard error is that of this
+     process, so the messages of the worker are seen here.
+******************************************************************************/
+static int start_node
+(
+    Dist_node_t *node     /* I/O: node, with its command */
+)
+{
+    char FUNC_NAME[] = "start_node";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int to_fd[2];         /* pipe to the worker */
+    int from_fd[2];       /* pipe from the worker */
+
+    node->part = -1;
+    if (pipe (to_fd) != 0)
+    {
+        sprintf (errmsg, "Creating the pipes: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (pipe (from_fd) != 0)
+    {
+        sprintf (errmsg, "Creating the pipes: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        close (to_fd[0]);
+        close (to_fd[1]);
+        return (ERROR);
+    }
+
+    fflush (stdout);
+    node->pid = fork ();
+    if (node->pid < 0)
+    {
+        sprintf (errmsg, "Starting a worker: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        node->pid = 0;
+        close (to_fd[0]);
+        close (to_fd[1]);
+        close (from_fd[0]);
+        close (from_fd[1]);
+        return (ERROR);
+    }
+
+    if (node->pid == 0)
+    {
+        /* The worker reads the jobs from to_fd and writes the results to
+           from_fd */
+        dup2 (to_fd[0], STDIN_FILENO);
+        dup2 (from_fd[1], STDOUT_FILENO);
+        close (to_fd[0]);
+        close (to_fd[1]);
+        close (from_fd[0]);
+        close (from_fd[1]);
+        execl ("/bin/sh", "sh", "-c", node->command, (char *) NULL);
+        _exit (127);
+    }
+
+    close (to_fd[0]);
+    close (from_fd[1]);
+    node->to = fdopen (to_fd[1], "w");
+    node->from = fdopen (from_fd[0], "r");
+    if (node->to == NULL || node->from == NULL)
+    {
+        sprintf (errmsg, "Opening the streams of a worker");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  stop_node
+
+PURPOSE: Stops the worker of a node and waits for it to exit.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. Closing the standard input of the worker ends its jobs, so it exits
+     once it is done.  A worker which failed is killed instead.
+******************************************************************************/
+static void stop_node
+(
+    Dist_node_t *node,    /* I/O: node */
+    bool failed           /* I: has the worker failed? */
+)
+{
+    int status;           /* exit status of the worker */
+
+    if (node->pid == 0)
+        return;
+
+    if (node->to != NULL)
+        fclose (node->to);
+    if (failed)
+        kill (node->pid, SIGTERM);
+    if (node->from != NULL)
+        fclose (node->from);
+    while (waitpid (node->pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    node->to = NULL;
+    node->from = NULL;
+    node->pid = 0;
+}
+
+
+/******************************************************************************
+MODULE:  write_json_string
+
+PURPOSE: Writes a string as a JSON string.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void write_json_string
+(
+    FILE *fp,             /* I: output stream */
+    const char *value     /* I: string to be written */
+)
+{
+    const unsigned char *cptr;  /* current character */
+
+    fputc ('"', fp);
+    for (cptr = (const unsigned char *) value; *cptr != '\0'; cptr++)
+    {
+        if (*cptr == '"' || *cptr == '\\')
+            fprintf (fp, "\\%c", *cptr);
+        else if (*cptr < 0x20)
+            fprintf (fp, "\\u%04x", *cptr);
+        else
+            fputc (*cptr, fp);
+    }
+    fputc ('"', fp);
+}
+
+
+/******************************************************************************
+MODULE:  send_part
+
+PURPOSE: Sends the job of a part to the worker of a node.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing to the worker
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The job ID is "part" followed by the number of the part.
+******************************************************************************/
+static int send_part
+(
+    Dist_node_t *node,    /* I/O: node */
+    Dist_output_t *out,   /* I: output being distributed */
+    int part              /* I: part to be run */
+)
+{
+    static const char *priority[] = {"latest", "zenith", "qa"};
+    FILE *fp = node->to;  /* stream to the worker */
+
+    fprintf (fp, "{\"id\": \"part%d\", \"%s\": ", part,
+        (out->template_xml != NULL) ? "mosaic" : "stack");
+    write_json_string (fp, out->input_list);
+    fprintf (fp, ", \"output\": ");
+    write_json_string (fp, out->output);
+    if (out->template_xml != NULL)
+    {
+        fprintf (fp, ", \"template\": ");
+        write_json_string (fp, out->template_xml);
+        fprintf (fp, ", \"priority\": \"%s\"",
+            priority[out->mopts.priority]);
+        if (out->mopts.qa_band[0] != '\0')
+        {
+            fprintf (fp, ", \"qa_band\": ");
+            write_json_string (fp, out->mopts.qa_band);
+        }
+        fprintf (fp, ", \"qa_mask\": \"0x%lx\"", out->mopts.qa_mask);
+        if (out->mopts.pixel_size > 0.0)
+            fprintf (fp, ", \"pixel_size\": %.17g", out->mopts.pixel_size);
+        fprintf (fp, ", \"template_extent\": %s",
+            out->mopts.template_extent ? "true" : "false");
+    }
+    else
+    {
+        fprintf (fp, ", \"band\": ");
+        write_json_string (fp, out->band_name);
+        fprintf (fp, ", \"format\": \"zarr\"");
+    }
+    fprintf (fp, ", \"part\": %d, \"nparts\": %d}\n", part, out->nparts);
+
+    if (fflush (fp) != 0 || ferror (fp))
+        return (ERROR);
+
+    node->part = part;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  run_parts
+
+PURPOSE: Hands out the parts to the workers of the nodes until all the parts
+are written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           A part failed DIST_MAX_ATTEMPTS times, or no worker is left
+SUCCESS         All the parts were written
+
+NOTES:
+  1. Each worker runs one part at a time, and is given the next pending
+     part as soon as it returns the result of its part.
+******************************************************************************/
+static int run_parts
+(
+    int nnodes,           /* I: number of nodes */
+    Dist_node_t *node,    /* I/O: nodes, with their workers started */
+    Dist_output_t *out    /* I: output being distributed */
+)
+{
+    char FUNC_NAME[] = "run_parts";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char line[STR_SIZE];  /* result of a job */
+    char result[STR_SIZE];  /* status of a job */
+    int i;                /* looping variable for the nodes */
+    int p;                /* looping variable for the parts */
+    int part;             /* part of a result */
+    int ndone = 0;        /* number of parts written */
+    int nrunning;         /* number of parts being run */
+    int npoll;            /* number of workers polled */
+    int status = SUCCESS; /* return status */
+    int *attempts = NULL; /* number of times each part was run */
+    int poll_node[DIST_MAX_NODES];  /* node of each polled worker */
+    bool ok;              /* did the part succeed? */
+    Dist_node_t *nd = NULL;  /* node of a result */
+    Dist_part_state_t *state = NULL;  /* state of each part */
+    struct pollfd fds[DIST_MAX_NODES];  /* workers polled for results */
+
+    attempts = calloc (out->nparts, sizeof (int));
+    state = calloc (out->nparts, sizeof (Dist_part_state_t));
+    if (attempts == NULL || state == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the parts");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (attempts);
+        free (state);
+        return (ERROR);
+    }
+
+    p = 0;
+    while (ndone < out->nparts && status == SUCCESS)
+    {
+        /* Hand the pending parts to the idle workers */
+        for (i = 0; i < nnodes; i++)
+        {
+            if (node[i].pid == 0 || node[i].part >= 0)
+                continue;
+            for (p = 0; p < out->nparts && state[p] != PART_PENDING; p++)
+                ;
+            if (p == out->nparts)
+                break;
+            if (send_part (&node[i], out, p) != SUCCESS)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Sending part %d to %s; "
+                    "the node is no longer used", p, node[i].command);
+                error_handler (false, FUNC_NAME, errmsg);
+                stop_node (&node[i], true);
+                continue;
+            }
+            state[p] = PART_RUNNING;
+            attempts[p]++;
+        }
+
+        /* Wait for the results of the running parts */
+        npoll = 0;
+        for (i = 0; i < nnodes; i++)
+        {
+            if (node[i].pid == 0 || node[i].part < 0)
+                continue;
+            fds[npoll].fd = fileno (node[i].from);
+            fds[npoll].events = POLLIN;
+            fds[npoll].revents = 0;
+            poll_node[npoll] = i;
+            npoll++;
+        }
+        nrunning = npoll;
+        if (nrunning == 0)
+        {
+            sprintf (errmsg, "No workers are left to run the remaining %d "
+                "parts", out->nparts - ndone);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        if (poll (fds, npoll, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            sprintf (errmsg, "Waiting for the workers: %s", strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        for (i = 0; i < npoll && status == SUCCESS; i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+
+            /* A worker which exited gives its part back */
+            nd = &node[poll_node[i]];
+            part = nd->part;
+            if (fgets (line, sizeof (line), nd->from) == NULL ||
+                sscanf (line, "{\"id\": \"part%d\", \"status\": \"%63[a-z]\"",
+                    &p, result) != 2 || p != part)
+            {
+                snprintf (errmsg, sizeof (errmsg), "Lost the worker %s "
+                    "running part %d; the node is no longer used",
+                    nd->command, part);
+                error_handler (false, FUNC_NAME, errmsg);
+                stop_node (nd, true);
+                ok = false;
+            }
+            else
+            {
+                ok = !strcmp (result, "success");
+                nd->part = -1;
+            }
+
+            if (ok)
+            {
+                state[part] = PART_DONE;
+                ndone++;
+                printf ("Part %d done (%d of %d)\n", part, ndone,
+                    out->nparts);
+                fflush (stdout);
+            }
+            else if (attempts[part] >= DIST_MAX_ATTEMPTS)
+            {
+                sprintf (errmsg, "Part %d failed %d times", part,
+                    attempts[part]);
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+            }
+            else
+                state[part] = PART_PENDING;
+        }
+    }
+
+    free (attempts);
+    free (state);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Runs the parts of a mosaic or stack on the workers of the nodes,
+and gathers the parts of a mosaic.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error distributing the output
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "espa_distribute";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char catalog_list[STR_SIZE];  /* input list of the catalog products */
+    char *node_list = NULL;       /* node list filename */
+    char *catalog_file = NULL;    /* catalog filename */
+    char **commands = NULL;       /* command of each node */
+    char **xml_infile = NULL;     /* input XML filenames */
+    int nnodes = 0;               /* number of nodes */
+    int nscenes = 0;              /* number of input XML files */
+    int i;                        /* looping variable */
+    int status = SUCCESS;         /* return status */
+    Dist_node_t *node = NULL;     /* nodes */
+    Dist_output_t out;            /* output being distributed */
+    Espa_catalog_query_t query;   /* products of the catalog */
+
+    /* Read the command-line arguments */
+    memset (&out, 0, sizeof (out));
+    out.mopts.priority = MOSAIC_LATEST;
+    init_catalog_query (&query);
+    if (get_args (argc, argv, &node_list, &catalog_file, &query, &out) !=
+        SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Select the inputs from the catalog */
+    if (catalog_file != NULL)
+    {
+        if (snprintf (catalog_list, sizeof (catalog_list), "%s.inputs.txt",
+            out.output) >= sizeof (catalog_list))
+        {
+            sprintf (errmsg, "Output filename is too long");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (EXIT_FAILURE);
+        }
+        if (write_catalog_inputs (catalog_file, &query, catalog_list) !=
+            SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+        out.input_list = strdup (catalog_list);
+    }
+
+    /* Start the workers */
+    if (read_list (node_list, &nnodes, &commands) != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+    if (nnodes > DIST_MAX_NODES)
+    {
+        sprintf (errmsg, "The node list has more than %d nodes",
+            DIST_MAX_NODES);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+    if (out.nparts == 0)
+    {
+        out.nparts = DIST_PARTS_PER_NODE * nnodes;
+        if (out.nparts > MOSAIC_MAX_PARTS)
+            out.nparts = MOSAIC_MAX_PARTS;
+    }
+
+    node = calloc (nnodes, sizeof (Dist_node_t));
+    if (node == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the nodes");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* A worker which goes away mustn't stop the distribution */
+    signal (SIGPIPE, SIG_IGN);
+    for (i = 0; i < nnodes; i++)
+    {
+        node[i].command = commands[i];
+        if (start_node (&node[i]) != SUCCESS)
+        {
+            sprintf (errmsg, "Starting the worker of node %d", i);
+            error_handler (false, FUNC_NAME, errmsg);
+            stop_node (&node[i], true);
+        }
+    }
+
+    /* Run the parts, and stop the workers */
+    printf ("Running %d parts on %d nodes\n", out.nparts, nnodes);
+    status = run_parts (nnodes, node, &out);
+    for (i = 0; i < nnodes; i++)
+        stop_node (&node[i], status != SUCCESS);
+
+    /* Gather the parts of a mosaic */
+    if (status == SUCCESS && out.template_xml != NULL)
+    {
+        status = read_list (out.input_list, &nscenes, &xml_infile);
+        if (status == SUCCESS)
+        {
+            out.mopts.nparts = out.nparts;
+            out.mopts.gather = true;
+            status = mosaic_xml (nscenes, xml_infile, out.output,
+                out.template_xml, &out.mopts);
+        }
+        free_list (nscenes, xml_infile);
+    }
+
+    if (status == SUCCESS && catalog_file != NULL)
+        unlink (catalog_list);
+
+    /* Free the pointers */
+    free_list (nnodes, commands);
+    free (node);
+    free (node_list);
+    free (catalog_file);
+    free (out.input_list);
+    free (out.output);
+    free (out.template_xml);
+    free (out.band_name);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Distributing %s", (out.template_xml != NULL) ?
+            "the mosaic" : "the stack");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
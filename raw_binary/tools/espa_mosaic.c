@@ -0,0 +1,459 @@
+/*****************************************************************************
+FILE: espa_mosaic
+
+PURPOSE: Contains functions for mosaicking the bands of several ESPA raw
+binary products onto the grid of a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include <ctype.h>
+#include "espa_mosaic.h"
+#include "espa_memory.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_mosaic mosaics the bands of the input XML metadata files "
+            "onto the grid of a template product, writing the mosaic bands "
+            "and a new XML metadata file for them.\n\n");
+    printf ("usage: espa_mosaic "
+            "--input_list=input_list_filename "
+            "--output_xml=output_metadata_filename "
+            "--template_xml=template_metadata_filename "
+            "[--priority=latest|zenith|qa] [--qa_band=name] "
+            "[--qa_mask=bits] [--pixel_size=size] [--template_extent] "
+            "[--max_memory=size] [--part=part --nparts=nparts] "
+            "[--gather --nparts=nparts]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -input_list: name of a file listing the input XML metadata "
+            "files, one per line, or - for the standard input; the bands "
+            "of the first file are mosaicked\n");
+    printf ("    -output_xml: name of the output XML metadata file; the "
+            "mosaic bands are written to its directory, which must differ "
+            "from the directories of the input XML files\n");
+    printf ("    -template_xml: name of the XML metadata file of the "
+            "template product, whose projection, orientation and pixel "
+            "alignment the output grid has\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -priority: order in which the scenes are used for each "
+            "pixel: latest acquisition first (latest), lowest solar zenith "
+            "first (zenith), or latest first preferring pixels whose QA is "
+            "clear (qa) (default is latest)\n");
+    printf ("    -qa_band: name of the QA band, required with "
+            "--priority=qa\n");
+    printf ("    -qa_mask: QA bits which mark a pixel as not clear, as a "
+            "decimal or 0x hexadecimal number, for --priority=qa (default "
+            "is 0)\n");
+    printf ("    -pixel_size: output pixel size in the projection units of "
+            "the template (default is the pixel size of the template)\n");
+    printf ("    -template_extent: the output covers the extent of the "
+            "template, rather than the extent of the input scenes on the "
+            "template grid\n");
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the threads are sized "
+            "to fit it (default is the ESPA_MAX_MEMORY environment "
+            "variable, or no budget)\n");
+    printf ("    -part, -nparts: only write part (from 0 to nparts - 1) of "
+            "the output lines split into nparts parts, to part files next "
+            "to the output bands; the output XML file isn't written\n");
+    printf ("    -gather: join the nparts parts written earlier into the "
+            "output bands, write the output XML file and remove the part "
+            "files\n");
+    printf ("\nIf the ESPA_CHECKPOINT_INTERVAL environment variable is set, "
+            "the output bands are checkpointed at most every that many "
+            "seconds, and a run which failed part way resumes from the "
+            "checkpoints when it is rerun with the same arguments.\n");
+    printf ("\nExample: espa_mosaic "
+            "--input_list=scenes.txt "
+            "--output_xml=mosaic/mosaic.xml "
+            "--template_xml=albers_tile.xml "
+            "--priority=qa --qa_band=pixel_qa --qa_mask=0x28\n");
+    printf ("Example: espa_mosaic "
+            "--input_list=scenes.txt "
+            "--output_xml=mosaic/mosaic.xml "
+            "--template_xml=albers_tile.xml --part=3 --nparts=16\n");
+}
+
+
+/******************************************************************************
+MODULE:  read_input_list
+
+PURPOSE: Reads the input XML files from the input list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the input list
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines and lines starting with # are ignored.  The caller is
+     responsible for freeing the filenames and the list.
+******************************************************************************/
+static int read_input_list
+(
+    char *input_list,     /* I: name of the input list; "-" for the standard
+                                input */
+    int *nscenes,         /* O: number of input XML files */
+    char ***xml_infile    /* O: address of the input XML filenames */
+)
+{
+    char errmsg[STR_SIZE];                 /* error message */
+    char FUNC_NAME[] = "read_input_list";  /* function name */
+    char *line = NULL;    /* current line of the input list */
+    size_t line_size = 0; /* allocated size of line */
+    char *ptr = NULL;     /* start of the filename in the line */
+    char *end = NULL;     /* end of the filename in the line */
+    char **new_ptr = NULL;  /* reallocated list of filenames */
+    int size = 0;         /* allocated number of filenames */
+    int status = SUCCESS; /* return status */
+    FILE *fptr = NULL;    /* input list file pointer */
+
+    *nscenes = 0;
+    *xml_infile = NULL;
+    fptr = strcmp (input_list, "-") ? fopen (input_list, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the input list %s", input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (getline (&line, &line_size, fptr) != -1)
+    {
+        /* Trim the whitespace around the filename */
+        ptr = line;
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (*ptr == '\0' || *ptr == '#')
+            continue;
+        end = ptr + strlen (ptr);
+        while (end > ptr && isspace ((unsigned char) end[-1]))
+            end--;
+        *end = '\0';
+
+        if (*nscenes == size)
+        {
+            size = (size > 0) ? size * 2 : 256;
+            new_ptr = realloc (*xml_infile, size * sizeof (char *));
+            if (new_ptr == NULL)
+            {
+                sprintf (errmsg, "Allocating the input list");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            *xml_infile = new_ptr;
+        }
+
+        (*xml_infile)[*nscenes] = strdup (ptr);
+        if ((*xml_infile)[*nscenes] == NULL)
+        {
+            sprintf (errmsg, "Allocating the input list");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        (*nscenes)++;
+    }
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    if (status == SUCCESS && *nscenes == 0)
+    {
+        sprintf (errmsg, "The input list %s has no XML files", input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **input_list,    /* O: address of the input list filename */
+    char **xml_outfile,   /* O: address of output XML filename */
+    char **template_xml,  /* O: address of template XML filename */
+    Mosaic_options_t *opts  /* O: options of the mosaic */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int template_extent = 0;  /* flag for the template extent */
+    static int gather = 0;           /* flag for gathering the parts */
+    int part = -1;                   /* part to be written */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    char *end = NULL;                /* end of a number */
+    static struct option long_options[] =
+    {
+        {"template_extent", no_argument, &template_extent, 1},
+        {"gather", no_argument, &gather, 1},
+        {"input_list", required_argument, 0, 'i'},
+        {"output_xml", required_argument, 0, 'o'},
+        {"template_xml", required_argument, 0, 't'},
+        {"priority", required_argument, 0, 'r'},
+        {"qa_band", required_argument, 0, 'q'},
+        {"qa_mask", required_argument, 0, 'm'},
+        {"pixel_size", required_argument, 0, 'p'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"part", required_argument, 0, 'P'},
+        {"nparts", required_argument, 0, 'n'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* input list */
+                *input_list = strdup (optarg);
+                break;
+
+            case 'o':  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case 't':  /* template XML file */
+                *template_xml = strdup (optarg);
+                break;
+
+            case 'r':  /* priority of the scenes */
+                if (!strcmp (optarg, "latest"))
+                    opts->priority = MOSAIC_LATEST;
+                else if (!strcmp (optarg, "zenith"))
+                    opts->priority = MOSAIC_ZENITH;
+                else if (!strcmp (optarg, "qa"))
+                    opts->priority = MOSAIC_QA;
+                else
+                {
+                    sprintf (errmsg, "Unknown priority %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'q':  /* QA band name */
+                snprintf (opts->qa_band, sizeof (opts->qa_band), "%s",
+                    optarg);
+                break;
+
+            case 'm':  /* QA mask */
+                opts->qa_mask = strtoul (optarg, &end, 0);
+                if (end == optarg || *end != '\0')
+                {
+                    sprintf (errmsg, "Invalid QA mask %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'p':  /* output pixel size */
+                opts->pixel_size = strtod (optarg, &end);
+                if (end == optarg || *end != '\0' || opts->pixel_size <= 0.0)
+                {
+                    sprintf (errmsg, "Pixel size must be positive");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'P':  /* part to be written */
+                part = atoi (optarg);
+                break;
+
+            case 'n':  /* number of parts */
+                opts->nparts = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+    opts->template_extent = (template_extent != 0);
+    opts->gather = (gather != 0);
+    opts->part = (part < 0) ? 0 : part;
+
+    /* Make sure the input list, output and template were specified */
+    if (*input_list == NULL || *xml_outfile == NULL || *template_xml == NULL)
+    {
+        sprintf (errmsg, "The input list, XML output file and template XML "
+            "file are required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The QA priority needs the QA band */
+    if (opts->priority == MOSAIC_QA && opts->qa_band[0] == '\0')
+    {
+        sprintf (errmsg, "The QA band is a required argument with the QA "
+            "priority");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* A part is either written or gathered, out of at least two parts */
+    if ((part >= 0 || opts->gather) && (opts->nparts < 2 ||
+        opts->nparts > MOSAIC_MAX_PARTS || (part >= 0) == opts->gather ||
+        part >= opts->nparts))
+    {
+        sprintf (errmsg, "Either --part or --gather must be given with "
+            "--nparts, from 2 to %d, and the part must be less than "
+            "nparts", MOSAIC_MAX_PARTS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (part < 0 && !opts->gather && opts->nparts != 0)
+    {
+        sprintf (errmsg, "--nparts requires --part or --gather");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Mosaics the bands of the input XML metadata files onto the grid of
+a template product and creates a new XML metadata file for the mosaic bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the mosaic
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *input_list = NULL;          /* list of input XML files */
+    char *xml_outfile = NULL;         /* output XML filename */
+    char *template_xml = NULL;        /* template XML filename */
+    char **xml_infile = NULL;         /* input XML filenames */
+    int nscenes = 0;                  /* number of input XML files */
+    int i;                            /* looping variable */
+    int status;                       /* return status of the mosaic */
+    Mosaic_options_t opts;            /* options of the mosaic */
+
+    /* Read the command-line arguments */
+    memset (&opts, 0, sizeof (opts));
+    opts.priority = MOSAIC_LATEST;
+    if (get_args (argc, argv, &input_list, &xml_outfile, &template_xml,
+        &opts) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Mosaic the XML files of the input list */
+    status = read_input_list (input_list, &nscenes, &xml_infile);
+    if (status == SUCCESS)
+        status = mosaic_xml (nscenes, xml_infile, xml_outfile, template_xml,
+            &opts);
+
+    /* Free the pointers */
+    for (i = 0; i < nscenes; i++)
+        free (xml_infile[i]);
+    free (xml_infile);
+    free (input_list);
+    free (xml_outfile);
+    free (template_xml);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,718 @@
+/*****************************************************************************
+FILE: espa_node_sched
+
+PURPOSE: Runs the node scheduler, which admits the jobs of the tool
+processes running on the node against its core and bandwidth budgets, so
+the CPU-bound and I/O-bound jobs keep both busy without oversubscribing
+either.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See espa_node_sched.h for the jobs and the protocol.  The tools find the
+     scheduler through ESPA_NODE_SCHED, which is also the default socket.
+  2. The waiting jobs of a class are admitted in the order they asked, once
+     the cores and bandwidth they ask for are free.  A job which can't be
+     admitted holds back the later jobs of its class, so a large job isn't
+     starved by smaller ones, but not those of the other class.  Once
+     MAX_PASSED jobs have been admitted ahead of a waiting job, no more are
+     admitted until it fits, so it isn't starved by the other class
+     either.
+  3. A job asking for more cores or bandwidth than the budget is given the
+     whole budget, so it runs once the others have left.
+  4. The connections are served by a single thread with poll, so the
+     scheduler holds no locks and a job is admitted as soon as another
+     leaves.
+*****************************************************************************/
+#include <getopt.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "error_handler.h"
+#include "espa_node_sched.h"
+
+/* Defines */
+/* Number of pending connections to the socket */
+#define SOCKET_BACKLOG 64
+
+/* Default bandwidth of an I/O-bound job whose rates aren't limited
+   (MB/s) */
+#define DEFAULT_JOB_MBPS 100.0
+
+/* Default bandwidth budget of the node, in default jobs */
+#define DEFAULT_BANDWIDTH_JOBS 4
+
+/* Number of jobs which may be admitted ahead of a waiting job */
+#define MAX_PASSED 16
+
+/* Job connected to the scheduler */
+typedef struct
+{
+    int fd;                       /* connection of the job */
+    bool has_request;             /* has the job asked to be admitted? */
+    bool admitted;                /* has the job been admitted? */
+    Espa_sched_class_t sched_class;  /* class of the job */
+    int cores;                    /* cores the job uses */
+    double mbps;                  /* bandwidth the job uses (MB/s) */
+    long pid;                     /* process ID of the job */
+    int passed;                   /* number of jobs admitted ahead of the
+                                     job while it waited */
+    char line[ESPA_SCHED_MAX_LINE];  /* request read so far */
+    int len;                      /* length of the request read so far */
+} Sched_job_t;
+
+/* Budgets of the node and the jobs connected */
+typedef struct
+{
+    int cores;                    /* core budget */
+    double bandwidth;             /* bandwidth budget (MB/s) */
+    double job_mbps;              /* bandwidth of an I/O-bound job which
+                                     doesn't give one (MB/s) */
+    int used_cores;               /* cores of the admitted jobs */
+    double used_mbps;             /* bandwidth of the admitted jobs */
+    int njobs;                    /* number of jobs connected */
+    int max_jobs;                 /* number of jobs allocated */
+    Sched_job_t *job;             /* jobs connected, in the order they
+                                     connected */
+} Sched_state_t;
+
+/* Set by the signal handler to stop the scheduler */
+static volatile sig_atomic_t stop_sched = 0;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_node_sched admits the jobs of the tools running on this "
+            "node against a core budget and a bandwidth budget. The tools "
+            "given its socket in ESPA_NODE_SCHED wait for their admission "
+            "before each scene of a scene list or espa_worker job, as "
+            "CPU-bound jobs (the angle, TOA, land/water mask, geolocation, "
+            "derived band and reprojection tools) asking for the threads "
+            "of their task pool, or as I/O-bound jobs (the ingests, exports "
+            "and the other tools) asking for one core and their I/O rates. "
+            "ESPA_SCHED_CLASS (cpu or io) overrides the class of a "
+            "tool.\n\n");
+    printf ("usage: espa_node_sched [--socket=socket_filename] "
+            "[--cores=ncores] [--bandwidth=MB/s] [--job_mbps=MB/s]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -socket: name of the UNIX socket to accept jobs on "
+            "(default is ESPA_NODE_SCHED)\n");
+    printf ("    -cores: core budget of the jobs (default is the number of "
+            "online CPUs)\n");
+    printf ("    -bandwidth: bandwidth budget of the jobs in MB/s (default "
+            "is %d times job_mbps)\n", DEFAULT_BANDWIDTH_JOBS);
+    printf ("    -job_mbps: bandwidth of an I/O-bound job whose I/O rates "
+            "aren't limited, in MB/s (default is %.0f)\n",
+            DEFAULT_JOB_MBPS);
+    printf ("\nExample: espa_node_sched --socket=/tmp/espa_sched.sock "
+            "--cores=32 --bandwidth=800 &\n");
+    printf ("         ESPA_NODE_SCHED=/tmp/espa_sched.sock "
+            "convert_espa_to_gtif --scene_list=scenes.txt --procs=8\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the socket filename.  The caller is
+     responsible for freeing it upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **socket_file,   /* O: address of the socket filename */
+    Sched_state_t *state  /* O: budgets of the node */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char *end = NULL;                /* end of a number */
+    char *env = NULL;                /* socket of the environment */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"socket", required_argument, 0, 's'},
+        {"cores", required_argument, 0, 'c'},
+        {"bandwidth", required_argument, 0, 'b'},
+        {"job_mbps", required_argument, 0, 'j'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 's':  /* socket filename */
+                free (*socket_file);
+                *socket_file = strdup (optarg);
+                break;
+
+            case 'c':  /* core budget */
+                state->cores = (int) strtol (optarg, &end, 10);
+                if (*end != '\0' || state->cores < 1)
+                {
+                    sprintf (errmsg, "cores must be a positive integer");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'b':  /* bandwidth budget */
+                state->bandwidth = strtod (optarg, &end);
+                if (*end != '\0' || !(state->bandwidth > 0.0))
+                {
+                    sprintf (errmsg, "bandwidth must be a positive number");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'j':  /* bandwidth of a job */
+                state->job_mbps = strtod (optarg, &end);
+                if (*end != '\0' || !(state->job_mbps > 0.0))
+                {
+                    sprintf (errmsg, "job_mbps must be a positive number");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* The socket defaults to the one the tools are given */
+    env = getenv (ESPA_SCHED_ENV);
+    if (*socket_file == NULL && env != NULL && env[0] != '\0')
+        *socket_file = strdup (env);
+    if (*socket_file == NULL)
+    {
+        sprintf (errmsg, "--socket is required unless %s is set",
+            ESPA_SCHED_ENV);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (state->bandwidth == 0.0)
+        state->bandwidth = DEFAULT_BANDWIDTH_JOBS * state->job_mbps;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_job
+
+PURPOSE: Adds the job of a new connection to the scheduler.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the job
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int add_job
+(
+    Sched_state_t *state, /* I/O: jobs of the scheduler */
+    int fd                /* I: connection of the job */
+)
+{
+    char FUNC_NAME[] = "add_job";   /* function name */
+    char errmsg[STR_SIZE];          /* error message */
+    int max_jobs;                   /* new number of jobs allocated */
+    Sched_job_t *new_job = NULL;    /* reallocated jobs */
+
+    if (state->njobs == state->max_jobs)
+    {
+        max_jobs = (state->max_jobs > 0) ? state->max_jobs * 2 : 64;
+        new_job = realloc (state->job, max_jobs * sizeof (Sched_job_t));
+        if (new_job == NULL)
+        {
+            sprintf (errmsg, "Allocating the jobs");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        state->job = new_job;
+        state->max_jobs = max_jobs;
+    }
+
+    memset (&state->job[state->njobs], 0, sizeof (Sched_job_t));
+    state->job[state->njobs].fd = fd;
+    state->njobs++;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  remove_job
+
+PURPOSE: Removes a job whose connection was closed, and releases its cores
+and bandwidth if it was admitted.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The later jobs are moved down, so the jobs stay in the order they
+     connected.
+******************************************************************************/
+static void remove_job
+(
+    Sched_state_t *state, /* I/O: jobs of the scheduler */
+    int index             /* I: index of the job */
+)
+{
+    Sched_job_t *job = &state->job[index];   /* job removed */
+
+    if (job->admitted)
+    {
+        state->used_cores -= job->cores;
+        state->used_mbps -= job->mbps;
+        if (state->used_mbps < 0.0)
+            state->used_mbps = 0.0;
+    }
+    close (job->fd);
+
+    state->njobs--;
+    memmove (job, job + 1, (state->njobs - index) * sizeof (Sched_job_t));
+}
+
+
+/******************************************************************************
+MODULE:  read_request
+
+PURPOSE: Reads from the connection of a job, and parses its request once
+the whole line has been read.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The connection was closed, or the request is invalid
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Anything a job writes after its request is ignored; a read of the end
+     of the connection means the job has left.
+******************************************************************************/
+static int read_request
+(
+    Sched_state_t *state, /* I: budgets of the node */
+    Sched_job_t *job      /* I/O: job read from */
+)
+{
+    char FUNC_NAME[] = "read_request";   /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char class_name[8];           /* class of the job */
+    char discard[ESPA_SCHED_MAX_LINE];  /* data after the request */
+    char *newline = NULL;         /* end of the request */
+    ssize_t nread;                /* number of bytes read */
+
+    if (job->has_request)
+    {
+        nread = read (job->fd, discard, sizeof (discard));
+        return ((nread > 0 || (nread < 0 && errno == EINTR)) ? SUCCESS
+            : ERROR);
+    }
+
+    nread = read (job->fd, &job->line[job->len],
+        sizeof (job->line) - 1 - job->len);
+    if (nread < 0 && errno == EINTR)
+        return (SUCCESS);
+    if (nread <= 0)
+        return (ERROR);
+    job->len += nread;
+    job->line[job->len] = '\0';
+
+    newline = strchr (job->line, '\n');
+    if (newline == NULL)
+    {
+        if (job->len < (int) sizeof (job->line) - 1)
+            return (SUCCESS);
+        sprintf (errmsg, "Request is longer than %d characters",
+            ESPA_SCHED_MAX_LINE);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    *newline = '\0';
+
+    if (sscanf (job->line, "admit %7s %d %lf %ld", class_name, &job->cores,
+        &job->mbps, &job->pid) != 4 ||
+        espa_sched_parse_class (class_name, &job->sched_class) != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid request: %s",
+            job->line);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Fit the job to the budgets */
+    if (job->cores < 1)
+        job->cores = 1;
+    if (job->cores > state->cores)
+        job->cores = state->cores;
+    if (!(job->mbps > 0.0))
+        job->mbps = (job->sched_class == ESPA_SCHED_IO) ? state->job_mbps
+            : 0.0;
+    if (job->mbps > state->bandwidth)
+        job->mbps = state->bandwidth;
+
+    job->has_request = true;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  admit_jobs
+
+PURPOSE: Admits the waiting jobs which fit the cores and bandwidth left.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The jobs are scanned in the order they connected.  Once a job of a
+     class doesn't fit, the later jobs of that class wait behind it, while
+     the jobs of the other class may still be admitted, until MAX_PASSED
+     of them have been.
+  2. A job whose connection can't be written to has left, and is removed.
+******************************************************************************/
+static void admit_jobs
+(
+    Sched_state_t *state  /* I/O: jobs of the scheduler */
+)
+{
+    bool blocked[2] = {false, false};  /* is each class held back? */
+    int i, j;                     /* looping variables for the jobs */
+    Sched_job_t *job = NULL;      /* current job */
+
+    for (i = 0; i < state->njobs; i++)
+    {
+        job = &state->job[i];
+        if (!job->has_request || job->admitted || blocked[job->sched_class])
+            continue;
+
+        if (state->used_cores + job->cores > state->cores ||
+            state->used_mbps + job->mbps > state->bandwidth + 1e-6)
+        {
+            if (job->passed >= MAX_PASSED)
+                break;
+            blocked[job->sched_class] = true;
+            continue;
+        }
+
+        if (write (job->fd, "ok\n", 3) != 3)
+        {
+            remove_job (state, i);
+            i--;
+            continue;
+        }
+
+        job->admitted = true;
+        for (j = 0; j < i; j++)
+        {
+            if (state->job[j].has_request && !state->job[j].admitted)
+                state->job[j].passed++;
+        }
+        state->used_cores += job->cores;
+        state->used_mbps += job->mbps;
+        printf ("Admitted %s job of process %ld (%d cores, %.1f MB/s); "
+            "%d of %d cores and %.1f of %.1f MB/s in use\n",
+            espa_sched_class_name (job->sched_class), job->pid, job->cores,
+            job->mbps, state->used_cores, state->cores, state->used_mbps,
+            state->bandwidth);
+        fflush (stdout);
+    }
+}
+
+
+/******************************************************************************
+MODULE:  stop_handler
+
+PURPOSE: Stops the scheduler on a signal.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void stop_handler
+(
+    int signum            /* I: signal received */
+)
+{
+    stop_sched = 1;
+}
+
+
+/******************************************************************************
+MODULE:  serve_socket
+
+PURPOSE: Accepts the connections of the jobs on a UNIX socket and admits
+them, until interrupted or terminated.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the socket or serving the connections
+SUCCESS         The scheduler was stopped
+
+NOTES:
+******************************************************************************/
+static int serve_socket
+(
+    char *socket_file,    /* I: name of the socket */
+    Sched_state_t *state  /* I/O: budgets and jobs of the scheduler */
+)
+{
+    char FUNC_NAME[] = "serve_socket";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int listen_fd;          /* listening socket */
+    int conn_fd;            /* connection socket */
+    int nfds = 0;           /* number of descriptors polled */
+    int i;                  /* looping variable for the jobs */
+    int status = SUCCESS;   /* return status */
+    struct pollfd *fds = NULL;  /* descriptors polled */
+    struct pollfd *new_fds = NULL;  /* reallocated descriptors */
+    struct sockaddr_un addr;   /* address of the socket */
+    struct sigaction action;   /* handler stopping the scheduler */
+
+    if (strlen (socket_file) >= sizeof (addr.sun_path))
+    {
+        sprintf (errmsg, "Socket filename is too long");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, socket_file);
+
+    listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        sprintf (errmsg, "Creating the socket: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    unlink (socket_file);
+    if (bind (listen_fd, (struct sockaddr *) &addr, sizeof (addr)) != 0 ||
+        listen (listen_fd, SOCKET_BACKLOG) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Listening on socket %s: %s",
+            socket_file, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        close (listen_fd);
+        return (ERROR);
+    }
+
+    /* Stop on SIGINT and SIGTERM; no SA_RESTART, so poll is interrupted */
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = stop_handler;
+    sigemptyset (&action.sa_mask);
+    sigaction (SIGINT, &action, NULL);
+    sigaction (SIGTERM, &action, NULL);
+
+    /* A job which goes away before reading its admission mustn't stop the
+       scheduler */
+    signal (SIGPIPE, SIG_IGN);
+
+    printf ("espa_node_sched admitting jobs on %s with %d cores and %.1f "
+        "MB/s\n", socket_file, state->cores, state->bandwidth);
+    fflush (stdout);
+
+    while (status == SUCCESS && !stop_sched)
+    {
+        /* Poll the listening socket and the connection of each job */
+        if (nfds < state->njobs + 1)
+        {
+            new_fds = realloc (fds, (state->max_jobs + 1) *
+                sizeof (struct pollfd));
+            if (new_fds == NULL)
+            {
+                sprintf (errmsg, "Allocating the polled descriptors");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            fds = new_fds;
+            nfds = state->max_jobs + 1;
+        }
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (i = 0; i < state->njobs; i++)
+        {
+            fds[i + 1].fd = state->job[i].fd;
+            fds[i + 1].events = POLLIN;
+            fds[i + 1].revents = 0;
+        }
+
+        if (poll (fds, state->njobs + 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            sprintf (errmsg, "Polling the connections: %s", strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        /* Read the requests, and release the jobs which have left.  The
+           jobs are scanned backwards, so removing one doesn't move the
+           descriptors of those still to be read. */
+        for (i = state->njobs - 1; i >= 0; i--)
+        {
+            if (fds[i + 1].revents == 0)
+                continue;
+            if (read_request (state, &state->job[i]) != SUCCESS)
+                remove_job (state, i);
+        }
+
+        /* Accept a new job */
+        if (fds[0].revents & POLLIN)
+        {
+            conn_fd = accept (listen_fd, NULL, NULL);
+            if (conn_fd < 0)
+            {
+                if (errno != EINTR && errno != ECONNABORTED)
+                {
+                    sprintf (errmsg, "Accepting a connection: %s",
+                        strerror (errno));
+                    error_handler (true, FUNC_NAME, errmsg);
+                    status = ERROR;
+                }
+            }
+            else if (add_job (state, conn_fd) != SUCCESS)
+            {
+                close (conn_fd);
+                status = ERROR;
+            }
+        }
+
+        admit_jobs (state);
+    }
+
+    for (i = state->njobs - 1; i >= 0; i--)
+        remove_job (state, i);
+    free (fds);
+    close (listen_fd);
+    unlink (socket_file);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Runs the node scheduler on its socket.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting or running the scheduler
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Stopping the scheduler closes the connections of the jobs, so the
+     waiting jobs run without admission.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *socket_file = NULL;     /* name of the socket */
+    int status;                   /* status of the scheduler */
+    long ncpus;                   /* number of online CPUs */
+    Sched_state_t state;          /* budgets and jobs of the scheduler */
+
+    /* Read the command-line arguments */
+    memset (&state, 0, sizeof (state));
+    ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+    state.cores = (ncpus > 0) ? (int) ncpus : 1;
+    state.job_mbps = DEFAULT_JOB_MBPS;
+    if (get_args (argc, argv, &socket_file, &state) != SUCCESS)
+    {   /* get_args already printed the error message */
+        free (socket_file);
+        exit (EXIT_FAILURE);
+    }
+
+    status = serve_socket (socket_file, &state);
+
+    free (socket_file);
+    free (state.job);
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -17,6 +17,16 @@ NOTES:
 *****************************************************************************/
 #include <getopt.h>
 #include "subset_metadata.h"
+#include "espa_batch.h"
+
+/* Options for subsetting each XML file */
+typedef struct
+{
+    int nproducts;               /* number of product types specified */
+    char (*products)[STR_SIZE];  /* array of nproducts product types */
+    Subset_files_t files;        /* how the subset band files should be
+                                    materialized */
+} Product_subset_options_t;
 
 
 /******************************************************************************
@@ -37,8 +47,12 @@ void usage ()
     printf ("usage: espa_product_subset "
             "--xml=input_metadata_filename "
             "--subset_xml=output_subset_metadata_filename "
+            "[--subset_files=none|hardlink|reflink|copy] "
             "--product=product_name (multiple --product options can be "
             "specified).\n");
+    printf ("       espa_product_subset --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--subset_files=none|hardlink|reflink|copy] "
+            "--product=product_name ...\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML metadata file which follows "
@@ -47,6 +61,20 @@ void usage ()
             "only the bands with the user-specified product types\n");
     printf ("    -product: name of the product type in the input XML file to "
             "be written to the subset XML file\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -subset_files: also materialize the band and ENVI header "
+            "files referenced by the subset XML file in the directory of the "
+            "subset XML file, as hard links, reflinks (copies on file "
+            "systems without reflink support), or copies of the input files "
+            "(default is none)\n");
+    printf ("    -scene_list: instead of -xml and -subset_xml, name of a "
+            "file listing the input XML file and the output subset XML file "
+            "of each product to be processed, one product per line, or - "
+            "for the standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
     printf ("\nExample: espa_product_subset "
             "--xml=LE70230282011250EDC00.xml "
             "--subset_xml=LE70230282011250EDC00_subset.xml "
@@ -80,7 +108,11 @@ short get_args
     char **xml_infile,    /* O: address of input XML filename */
     char **xml_subset_outfile,  /* O: address of output subset XML filename */
     int *nproducts,       /* O: number of product types in the subset */
-    char products[][STR_SIZE]  /* O: array of product types to be subset */
+    char products[][STR_SIZE], /* O: array of product types to be subset */
+    Subset_files_t *files, /* O: how the subset band files should be
+                                materialized */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
 )
 {
     int c;                           /* current argument index */
@@ -91,7 +123,10 @@ short get_args
     static struct option long_options[] =
     {
         {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
         {"subset_xml", required_argument, 0, 'o'},
+        {"subset_files", required_argument, 0, 'f'},
         {"product", required_argument, 0, 'p'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -129,6 +164,26 @@ short get_args
             case 'o':  /* XML subset outfile */
                 *xml_subset_outfile = strdup (optarg);
                 break;
+
+            case 'f':  /* materialize the subset band files */
+                if (!strcmp (optarg, "none"))
+                    *files = SUBSET_FILES_NONE;
+                else if (!strcmp (optarg, "hardlink"))
+                    *files = SUBSET_FILES_HARDLINK;
+                else if (!strcmp (optarg, "reflink"))
+                    *files = SUBSET_FILES_REFLINK;
+                else if (!strcmp (optarg, "copy"))
+                    *files = SUBSET_FILES_COPY;
+                else
+                {
+                    sprintf (errmsg, "Unknown subset files type: %s.  Valid "
+                        "values are none, hardlink, reflink, and copy.",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
      
             case 'p':  /* product type to be added */
                 count = snprintf (products[*nproducts], 
@@ -141,16 +196,16 @@ short get_args
                 }
 
                 (*nproducts)++;
-                if (*nproducts > MAX_TOTAL_PRODUCT_TYPES)
-                {
-                    sprintf (errmsg, "Maximum number of products (%d) has been "
-                        "reached. Results might not be trustworthy as the "
-                        "memory may have been trashed.",
-                        MAX_TOTAL_PRODUCT_TYPES);
-                    error_handler (false, FUNC_NAME, errmsg);
-                }
                 break;
      
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -161,18 +216,32 @@ short get_args
         }
     }
 
-    /* Make sure the infiles and outfiles were specified */
-    if (*xml_infile == NULL)
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
     {
-        sprintf (errmsg, "XML input file is a required argument");
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
     }
 
-    if (*xml_subset_outfile == NULL)
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
     {
-        sprintf (errmsg, "XML subset output file is a required argument");
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The subset output file is required with the XML input file, and is
+       given by the scene list otherwise */
+    if ((*xml_infile == NULL) != (*xml_subset_outfile == NULL))
+    {
+        sprintf (errmsg, "XML subset output file is a required argument with "
+            "the XML input file, and can't be used with the scene list");
         error_handler (true, FUNC_NAME, errmsg);
         usage ();
         return (ERROR);
@@ -191,6 +260,49 @@ short get_args
 }
 
 
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Subsets the bands of one XML metadata file based on the specified
+product types.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the subsetting
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *xml_subset_outfile,  /* I: output subset XML filename */
+    void *arg             /* I: subset options (Product_subset_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    Product_subset_options_t *opts = arg;  /* subset options */
+
+    /* The scene list has to give the subset XML file */
+    if (xml_subset_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the subset XML file "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Subset the input XML metadata file with the specified product types and
+       write to the output XML metadata file */
+    return (subset_xml_by_product (xml_infile, xml_subset_outfile,
+        opts->nproducts, opts->products, opts->files));
+}
+
+
 /******************************************************************************
 MODULE:  main
 
@@ -211,30 +323,56 @@ NOTES:
 ******************************************************************************/
 int main (int argc, char** argv)
 {
+    char FUNC_NAME[] = "main";        /* function name */
     char *xml_infile = NULL;          /* input XML filename */
     char *xml_subset_outfile = NULL;  /* output subset XML filename */
-    char products[MAX_TOTAL_PRODUCT_TYPES][STR_SIZE];  /* array of nproducts
-                                       product types */
-    int nproducts;                   /* number of product types specified */
+    char *scene_list = NULL;          /* list of products to be processed */
+    int nprocs = 1;                   /* number of scenes processed
+                                         concurrently */
+    int status;                       /* return status of the subsetting */
+    char (*products)[STR_SIZE] = NULL;  /* array of nproducts product
+                                         types */
+    Product_subset_options_t opts;  /* subset options */
 
-    /* Read the command-line arguments */
-    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &nproducts,
-        products) != SUCCESS)
+    /* Read the command-line arguments.  There can't be more product types
+       than arguments. */
+    products = calloc (argc, sizeof (*products));
+    if (products == NULL)
+    {
+        error_handler (true, FUNC_NAME, "Allocating the list of product types");
+        exit (EXIT_FAILURE);
+    }
+    opts.products = products;
+    opts.files = SUBSET_FILES_NONE;
+    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile,
+        &opts.nproducts, products, &opts.files, &scene_list, &nprocs)
+        != SUCCESS)
     {   /* get_args already printed the error message */
         exit (EXIT_FAILURE);
     }
 
-    /* Subset the input XML metadata file with the specified product types and
-       write to the output XML metadata file */
-    if (subset_xml_by_product (xml_infile, xml_subset_outfile, nproducts,
-        products) != SUCCESS)
-    {  /* Error messages already written */
-        exit (EXIT_FAILURE);
+    /* Subset the XML files of the scene list, or the single XML file.  The
+       schema is compiled once for all the scenes. */
+    if (scene_list != NULL)
+    {
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &opts);
     }
+    else
+        status = process_scene (xml_infile, xml_subset_outfile, &opts);
 
     /* Free the pointers */
+    free (products);
     free (xml_infile);
     free (xml_subset_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
 
     /* Successful completion */
     exit (EXIT_SUCCESS);
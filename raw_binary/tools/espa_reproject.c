@@ -0,0 +1,400 @@
+/*****************************************************************************
+FILE: espa_reproject
+
+PURPOSE: Contains functions for reprojecting the bands of an ESPA raw binary
+product onto the grid of a template product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_reproject.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/* Options applying to all the scenes */
+typedef struct
+{
+    char *template_xml;      /* XML file of the template product */
+    double pixel_size;       /* output pixel size; 0 for the template's */
+    bool template_extent;    /* use the extent of the template? */
+} Reproj_options_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_reproject reprojects and resamples the bands of the input "
+            "XML metadata file onto the grid of a template product, using "
+            "the resample method of each band, writing the reprojected "
+            "bands and a new XML metadata file for them.\n\n");
+    printf ("usage: espa_reproject "
+            "--xml=input_metadata_filename "
+            "--output_xml=output_metadata_filename "
+            "--template_xml=template_metadata_filename "
+            "[--pixel_size=size] [--template_extent] [--max_memory=size]\n");
+    printf ("       espa_reproject --scene_list=scene_list_filename "
+            "[--procs=nprocs] --template_xml=template_metadata_filename "
+            "[--pixel_size=size] [--template_extent] [--max_memory=size]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -output_xml: name of the output XML metadata file; the "
+            "reprojected bands are written to its directory, which must "
+            "differ from the directory of the input XML file\n");
+    printf ("    -template_xml: name of the XML metadata file of the "
+            "template product, whose projection, orientation and pixel "
+            "alignment the output grid has\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -pixel_size: output pixel size in the projection units of "
+            "the template (default is the pixel size of the template)\n");
+    printf ("    -template_extent: the output covers the extent of the "
+            "template, rather than the extent of the input scene on the "
+            "template grid\n");
+    printf ("    -scene_list: instead of -xml and -output_xml, name of a "
+            "file listing the input XML file and the output XML file "
+            "of each product to be processed, one product per line, or - "
+            "for the standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the threads are sized "
+            "to fit it, and the scene list workers share it (default is the "
+            "ESPA_MAX_MEMORY environment variable, or no budget)\n");
+    printf ("\nIf the ESPA_CHECKPOINT_INTERVAL environment variable is set, "
+            "the output bands are checkpointed at most every that many "
+            "seconds, and a run which failed part way resumes from the "
+            "checkpoints when it is rerun with the same arguments.\n");
+    printf ("\nExample: espa_reproject "
+            "--xml=LE70230282011250EDC00.xml "
+            "--output_xml=albers/LE70230282011250EDC00.xml "
+            "--template_xml=albers_tile.xml\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_coord
+
+PURPOSE:  Converts the value of a numeric option to a number.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The value isn't a number
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_coord
+(
+    const char *option,   /* I: name of the option */
+    const char *value,    /* I: value of the option */
+    double *coord         /* O: coordinate */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_coord";  /* function name */
+    char *end = NULL;                /* end of the number */
+
+    *coord = strtod (value, &end);
+    if (end == value || *end != '\0')
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid %s value: %s", option,
+            value);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **xml_outfile,   /* O: address of output XML filename */
+    Reproj_options_t *opts,  /* O: options applying to all the scenes */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int template_extent = 0;  /* flag for the template extent */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"template_extent", no_argument, &template_extent, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"output_xml", required_argument, 0, 'o'},
+        {"template_xml", required_argument, 0, 't'},
+        {"pixel_size", required_argument, 0, 'p'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML outfile */
+                *xml_outfile = strdup (optarg);
+                break;
+
+            case 't':  /* template XML file */
+                opts->template_xml = strdup (optarg);
+                break;
+
+            case 'p':  /* output pixel size */
+                if (get_coord ("pixel_size", optarg, &opts->pixel_size) !=
+                    SUCCESS || opts->pixel_size <= 0.0)
+                {
+                    sprintf (errmsg, "Pixel size must be positive");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+    opts->template_extent = (template_extent != 0);
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The output file is required with the XML input file, and is given by
+       the scene list otherwise */
+    if ((*xml_infile == NULL) != (*xml_outfile == NULL))
+    {
+        sprintf (errmsg, "XML output file is a required argument with the "
+            "XML input file, and can't be used with the scene list");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the template was specified */
+    if (opts->template_xml == NULL)
+    {
+        sprintf (errmsg, "Template XML file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Reprojects the bands of one XML metadata file onto the template
+grid.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the reprojection
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *xml_outfile,    /* I: output XML filename */
+    void *arg             /* I: options (Reproj_options_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+    Reproj_options_t *opts = arg;  /* options applying to all the scenes */
+
+    /* The scene list has to give the output XML file */
+    if (xml_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the output XML file "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Reproject the bands and write the output XML metadata file */
+    return (reproject_xml (xml_infile, xml_outfile, opts->template_xml,
+        opts->pixel_size, opts->template_extent));
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Reprojects the bands of the input XML metadata file onto the grid
+of a template product and creates a new XML metadata file for the
+reprojected bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the reprojection
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *xml_outfile = NULL;         /* output XML filename */
+    char *scene_list = NULL;          /* list of products to be processed */
+    int nprocs = 1;                   /* number of scenes processed
+                                         concurrently */
+    int status;                       /* return status of the reprojection */
+    Reproj_options_t opts = {NULL, 0.0, false};  /* options applying to
+                                         all the scenes */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &xml_outfile, &opts,
+        &scene_list, &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Reproject the XML files of the scene list, or the single XML file.  The
+       schema is compiled once for all the scenes. */
+    if (scene_list != NULL)
+    {
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &opts);
+    }
+    else
+        status = process_scene (xml_infile, xml_outfile, &opts);
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (xml_outfile);
+    free (opts.template_xml);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,224 @@
+/*****************************************************************************
+FILE: espa_shm_bands
+
+PURPOSE: Lists the raw binary bands kept in shared memory on this node, or
+writes them to their band files on disk.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. See raw_binary_shm.h for the shared memory bands.
+*****************************************************************************/
+#include <getopt.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "raw_binary_shm.h"
+
+/* Actions of the tool */
+typedef enum {
+    SHM_LIST,             /* list the bands */
+    SHM_FLUSH,            /* write the bands to disk */
+    SHM_DROP              /* discard the bands */
+} Shm_action_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_shm_bands lists the raw binary bands kept in shared "
+            "memory, which the tools write when ESPA_SHM_BANDS is set so the "
+            "next stage reads them without going through the disk. --flush "
+            "writes the bands to their band files and frees their memory, "
+            "once the last stage reading them is done, and --drop frees "
+            "their memory without writing them. The bands still being "
+            "written are left as they are.\n\n");
+    printf ("usage: espa_shm_bands --list\n");
+    printf ("       espa_shm_bands --flush [--prefix=directory]\n");
+    printf ("       espa_shm_bands --drop [--prefix=directory]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -list: list the bands, one JSON line each, with their "
+            "size, the number of processes using them and whether they're "
+            "being written\n");
+    printf ("    -flush: instead of -list, write the bands to disk\n");
+    printf ("    -drop: instead of -list, discard the bands\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -prefix: only flush or drop the bands whose file names "
+            "start with this directory or name (default is all the "
+            "bands)\n");
+    printf ("\nExample: ESPA_SHM_BANDS=16G create_toa_bands "
+            "--xml=LC80470272013287LGN00.xml && ... && espa_shm_bands "
+            "--flush --prefix=$PWD\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the prefix, which should be a character pointer
+     set to NULL on input.  The caller is responsible for freeing the
+     allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    Shm_action_t *action, /* O: action of the tool */
+    char **prefix         /* O: address of the prefix of the bands */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int list_flag = 0;        /* flag for listing the bands */
+    static int flush_flag = 0;       /* flag for flushing the bands */
+    static int drop_flag = 0;        /* flag for dropping the bands */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    char path[PATH_MAX];             /* absolute name of the prefix */
+    static struct option long_options[] =
+    {
+        {"list", no_argument, &list_flag, 1},
+        {"flush", no_argument, &flush_flag, 1},
+        {"drop", no_argument, &drop_flag, 1},
+        {"prefix", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'p':  /* prefix of the bands */
+                free (*prefix);
+                *prefix = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure exactly one action was specified */
+    if (list_flag + flush_flag + drop_flag != 1)
+    {
+        sprintf (errmsg, "One of --list, --flush or --drop is a required "
+            "argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (list_flag)
+        *action = SHM_LIST;
+    else if (flush_flag)
+        *action = SHM_FLUSH;
+    else
+        *action = SHM_DROP;
+
+    /* The bands are registered under their absolute names */
+    if (*prefix != NULL && realpath (*prefix, path) != NULL)
+    {
+        free (*prefix);
+        *prefix = strdup (path);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Lists, flushes or drops the shared memory bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing a band to disk
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    char *prefix = NULL;         /* prefix of the bands flushed or dropped */
+    int status = SUCCESS;        /* return status */
+    Shm_action_t action;         /* action of the tool */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &action, &prefix) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (!use_raw_binary_shm ())
+    {
+        sprintf (errmsg, "%s isn't set, so there are no shared memory "
+            "bands", RB_SHM_ENV);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    else if (action == SHM_LIST)
+        list_raw_binary_shm (stdout);
+    else
+        status = flush_raw_binary_shm (prefix, action == SHM_DROP);
+
+    /* Free the pointers */
+    free (prefix);
+
+    exit (status);
+}
@@ -0,0 +1,406 @@
+/*****************************************************************************
+FILE: espa_spatial_subset
+
+PURPOSE: Contains functions for subsetting the bands of an ESPA raw binary
+product to a projection-space or latitude/longitude box.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_spatial_subset.h"
+#include "espa_batch.h"
+#include "espa_memory.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_spatial_subset subsets the bands of the input XML metadata "
+            "file to a projection-space or latitude/longitude box, writing "
+            "the subset bands and a new XML metadata file for them.\n\n");
+    printf ("usage: espa_spatial_subset "
+            "--xml=input_metadata_filename "
+            "--subset_xml=output_subset_metadata_filename "
+            "(--ul_x=x --ul_y=y --lr_x=x --lr_y=y | "
+            "--west=lon --east=lon --north=lat --south=lat) "
+            "[--max_memory=size]\n");
+    printf ("       espa_spatial_subset --scene_list=scene_list_filename "
+            "[--procs=nprocs] (--ul_x=x ... | --west=lon ...) "
+            "[--max_memory=size]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -subset_xml: name of the output XML metadata file; the "
+            "subset bands are written to its directory, which must differ "
+            "from the directory of the input XML file\n");
+    printf ("    -ul_x, -ul_y, -lr_x, -lr_y: upper left and lower right "
+            "corners of the box in the projection coordinates of the "
+            "scene\n");
+    printf ("    -west, -east, -north, -south: edges of the box in degrees "
+            "of longitude and latitude, instead of the projection "
+            "corners\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -scene_list: instead of -xml and -subset_xml, name of a "
+            "file listing the input XML file and the output subset XML file "
+            "of each product to be processed, one product per line, or - "
+            "for the standard input\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("    -max_memory: memory budget of the process, in bytes with an "
+            "optional K, M, G or T suffix (e.g. 2G); the line blocks and "
+            "threads are sized to fit it, and the scene list workers share "
+            "it (default is the ESPA_MAX_MEMORY environment variable, or no "
+            "budget)\n");
+    printf ("\nExample: espa_spatial_subset "
+            "--xml=LE70230282011250EDC00.xml "
+            "--subset_xml=aoi/LE70230282011250EDC00.xml "
+            "--ul_x=500000 --ul_y=4800000 --lr_x=530000 --lr_y=4770000\n");
+    printf ("\nExample: espa_spatial_subset "
+            "--xml=LE70230282011250EDC00.xml "
+            "--subset_xml=aoi/LE70230282011250EDC00.xml "
+            "--west=-90.5 --east=-90.1 --north=43.2 --south=42.9\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_coord
+
+PURPOSE:  Converts the value of a box option to a number.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The value isn't a number
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_coord
+(
+    const char *option,   /* I: name of the option */
+    const char *value,    /* I: value of the option */
+    double *coord         /* O: coordinate */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_coord";  /* function name */
+    char *end = NULL;                /* end of the number */
+
+    *coord = strtod (value, &end);
+    if (end == value || *end != '\0')
+    {
+        snprintf (errmsg, sizeof (errmsg), "Invalid %s value: %s", option,
+            value);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    char **xml_subset_outfile,  /* O: address of output subset XML filename */
+    Spatial_box_t *box,   /* O: box the scenes are subset to */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    int nproj = 0;                   /* number of projection corner options */
+    int ngeo = 0;                    /* number of lat/long edge options */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"subset_xml", required_argument, 0, 'o'},
+        {"ul_x", required_argument, 0, 'x'},
+        {"ul_y", required_argument, 0, 'y'},
+        {"lr_x", required_argument, 0, 'X'},
+        {"lr_y", required_argument, 0, 'Y'},
+        {"west", required_argument, 0, 'w'},
+        {"east", required_argument, 0, 'e'},
+        {"north", required_argument, 0, 'n'},
+        {"south", required_argument, 0, 's'},
+        {"max_memory", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* XML subset outfile */
+                *xml_subset_outfile = strdup (optarg);
+                break;
+
+            case 'x':  /* projection corners */
+            case 'y':
+            case 'X':
+            case 'Y':
+                if (get_coord (long_options[option_index].name, optarg,
+                    (c == 'x') ? &box->west : (c == 'X') ? &box->east :
+                    (c == 'y') ? &box->north : &box->south) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                nproj++;
+                break;
+
+            case 'w':  /* latitude/longitude edges */
+            case 'e':
+            case 'n':
+            case 's':
+                if (get_coord (long_options[option_index].name, optarg,
+                    (c == 'w') ? &box->west : (c == 'e') ? &box->east :
+                    (c == 'n') ? &box->north : &box->south) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                ngeo++;
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'M':  /* memory budget */
+                if (espa_set_memory_budget (optarg) != SUCCESS)
+                {
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* The subset output file is required with the XML input file, and is
+       given by the scene list otherwise */
+    if ((*xml_infile == NULL) != (*xml_subset_outfile == NULL))
+    {
+        sprintf (errmsg, "XML subset output file is a required argument with "
+            "the XML input file, and can't be used with the scene list");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the box was given one way, completely */
+    if (!((nproj == 4 && ngeo == 0) || (nproj == 0 && ngeo == 4)))
+    {
+        sprintf (errmsg, "The box is required, either as the four projection "
+            "corner coordinates or as the four latitude/longitude edges");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    box->geographic = (ngeo == 4);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE:  Subsets the bands of one XML metadata file to the box.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the subsetting
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+******************************************************************************/
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *xml_subset_outfile,  /* I: output subset XML filename */
+    void *arg             /* I: box the scene is subset to (Spatial_box_t *) */
+)
+{
+    char errmsg[STR_SIZE];       /* error message */
+    char FUNC_NAME[] = "process_scene";  /* function name */
+
+    /* The scene list has to give the subset XML file */
+    if (xml_subset_outfile == NULL)
+    {
+        sprintf (errmsg, "The scene list doesn't give the subset XML file "
+            "for %s", xml_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Subset the bands to the box and write the output XML metadata file */
+    return (subset_xml_by_box (xml_infile, xml_subset_outfile, arg));
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Subsets the bands of the input XML metadata file to a
+projection-space or latitude/longitude box and creates a new XML metadata
+file for the subset bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the subsetting
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *xml_subset_outfile = NULL;  /* output subset XML filename */
+    char *scene_list = NULL;          /* list of products to be processed */
+    int nprocs = 1;                   /* number of scenes processed
+                                         concurrently */
+    int status;                       /* return status of the subsetting */
+    Spatial_box_t box;                /* box the scenes are subset to */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &xml_infile, &xml_subset_outfile, &box,
+        &scene_list, &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Subset the XML files of the scene list, or the single XML file.  The
+       schema is compiled once for all the scenes. */
+    if (scene_list != NULL)
+    {
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &box);
+    }
+    else
+        status = process_scene (xml_infile, xml_subset_outfile, &box);
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (xml_subset_outfile);
+    free (scene_list);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
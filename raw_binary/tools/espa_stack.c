@@ -0,0 +1,408 @@
+/*****************************************************************************
+FILE: espa_stack
+
+PURPOSE: Contains functions for stacking a band of several ESPA raw binary
+products of the same grid into a time series.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include <ctype.h>
+#include "espa_stack.h"
+#include "convert_espa_to_zarr.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_stack stacks a band of the input XML metadata files, which "
+            "have to be on the same grid, into a time series ordered by "
+            "acquisition date.  The stack is written either as a cube whose "
+            "pixels hold the values of all the dates (a BIP raw binary file "
+            "with a new XML metadata file for it), or as a Zarr store with "
+            "the dates as the time coordinate.  The date of each product is "
+            "taken from its %s band if it has one, and from its acquisition "
+            "date otherwise.\n\n", STACK_DATE_BAND);
+    printf ("usage: espa_stack "
+            "--input_list=input_list_filename "
+            "--band=band_name "
+            "--output=output_filename "
+            "[--format=cube|zarr] [--chunk_lines=nlines] "
+            "[--chunk_samps=nsamps] [--level=n] "
+            "[--part=part --nparts=nparts]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -input_list: name of a file listing the input XML metadata "
+            "files, one per line, or - for the standard input\n");
+    printf ("    -band: name of the band to be stacked\n");
+    printf ("    -output: name of the output XML metadata file of the cube, "
+            "which is written next to it with the .img extension, or the "
+            "name of the output Zarr store directory\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -format: output format, a cube (cube) or a Zarr store "
+            "(zarr) (default is cube)\n");
+    printf ("    -chunk_lines: number of lines in each Zarr chunk, from 1 to "
+            "%d (default is %d)\n", ZARR_MAX_CHUNK_SIZE, STACK_CHUNK_LINES);
+    printf ("    -chunk_samps: number of samples in each Zarr chunk, from 1 "
+            "to %d (default is %d)\n", ZARR_MAX_CHUNK_SIZE,
+            STACK_CHUNK_SAMPS);
+    printf ("    -level: zlib compression level of the Zarr chunks, from 0 "
+            "(stored) to 9 (default is %d)\n", ZARR_DEFLATE_LEVEL);
+    printf ("    -part, -nparts: only write part (from 0 to nparts - 1) of "
+            "the rows of chunks of a Zarr store split into nparts parts; "
+            "part 0 also writes the metadata of the store\n");
+    printf ("\nExample: espa_stack "
+            "--input_list=scenes.txt "
+            "--band=sr_ndvi "
+            "--output=ndvi_stack.zarr --format=zarr\n");
+}
+
+
+/******************************************************************************
+MODULE:  read_input_list
+
+PURPOSE: Reads the input XML files from the input list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the input list
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines and lines starting with # are ignored.  The caller is
+     responsible for freeing the filenames and the list.
+******************************************************************************/
+static int read_input_list
+(
+    char *input_list,     /* I: name of the input list; "-" for the standard
+                                input */
+    int *nproducts,       /* O: number of input XML files */
+    char ***xml_infile    /* O: address of the input XML filenames */
+)
+{
+    char errmsg[STR_SIZE];                 /* error message */
+    char FUNC_NAME[] = "read_input_list";  /* function name */
+    char *line = NULL;    /* current line of the input list */
+    size_t line_size = 0; /* allocated size of line */
+    char *ptr = NULL;     /* start of the filename in the line */
+    char *end = NULL;     /* end of the filename in the line */
+    char **new_ptr = NULL;  /* reallocated list of filenames */
+    int size = 0;         /* allocated number of filenames */
+    int status = SUCCESS; /* return status */
+    FILE *fptr = NULL;    /* input list file pointer */
+
+    *nproducts = 0;
+    *xml_infile = NULL;
+    fptr = strcmp (input_list, "-") ? fopen (input_list, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the input list %s", input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (getline (&line, &line_size, fptr) != -1)
+    {
+        /* Trim the whitespace around the filename */
+        ptr = line;
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (*ptr == '\0' || *ptr == '#')
+            continue;
+        end = ptr + strlen (ptr);
+        while (end > ptr && isspace ((unsigned char) end[-1]))
+            end--;
+        *end = '\0';
+
+        if (*nproducts == size)
+        {
+            size = (size > 0) ? size * 2 : 256;
+            new_ptr = realloc (*xml_infile, size * sizeof (char *));
+            if (new_ptr == NULL)
+            {
+                sprintf (errmsg, "Allocating the input list");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            *xml_infile = new_ptr;
+        }
+
+        (*xml_infile)[*nproducts] = strdup (ptr);
+        if ((*xml_infile)[*nproducts] == NULL)
+        {
+            sprintf (errmsg, "Allocating the input list");
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        (*nproducts)++;
+    }
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    if (status == SUCCESS && *nproducts == 0)
+    {
+        sprintf (errmsg, "The input list %s has no XML files", input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input list, band name and output.  All of
+     these should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **input_list,    /* O: address of the input list filename */
+    char **band_name,     /* O: address of the band name */
+    char **output,        /* O: address of the output filename */
+    Stack_options_t *opts /* O: options of the stack */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"input_list", required_argument, 0, 'i'},
+        {"band", required_argument, 0, 'b'},
+        {"output", required_argument, 0, 'o'},
+        {"format", required_argument, 0, 'f'},
+        {"chunk_lines", required_argument, 0, 'l'},
+        {"chunk_samps", required_argument, 0, 's'},
+        {"level", required_argument, 0, 'z'},
+        {"part", required_argument, 0, 'P'},
+        {"nparts", required_argument, 0, 'n'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* input list */
+                *input_list = strdup (optarg);
+                break;
+
+            case 'b':  /* band name */
+                *band_name = strdup (optarg);
+                break;
+
+            case 'o':  /* output */
+                *output = strdup (optarg);
+                break;
+
+            case 'f':  /* output format */
+                if (!strcmp (optarg, "cube"))
+                    opts->format = STACK_CUBE;
+                else if (!strcmp (optarg, "zarr"))
+                    opts->format = STACK_ZARR;
+                else
+                {
+                    sprintf (errmsg, "Unknown format %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'l':  /* chunk lines */
+                opts->chunk_lines = atoi (optarg);
+                break;
+
+            case 's':  /* chunk samples */
+                opts->chunk_samps = atoi (optarg);
+                break;
+
+            case 'z':  /* compression level */
+                opts->level = atoi (optarg);
+                break;
+
+            case 'P':  /* part to be written */
+                opts->part = atoi (optarg);
+                break;
+
+            case 'n':  /* number of parts */
+                opts->nparts = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the input list, band and output were specified */
+    if (*input_list == NULL || *band_name == NULL || *output == NULL)
+    {
+        sprintf (errmsg, "The input list, band name and output are required "
+            "arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the chunking and compression level are valid */
+    if (opts->chunk_lines < 1 || opts->chunk_lines > ZARR_MAX_CHUNK_SIZE ||
+        opts->chunk_samps < 1 || opts->chunk_samps > ZARR_MAX_CHUNK_SIZE)
+    {
+        sprintf (errmsg, "Chunk lines and samples must be from 1 to %d",
+            ZARR_MAX_CHUNK_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (opts->level < 0 || opts->level > 9)
+    {
+        sprintf (errmsg, "Compression level must be from 0 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Only a Zarr store can be split into parts */
+    if (opts->nparts != 0 && (opts->format != STACK_ZARR ||
+        opts->nparts < 2 || opts->part < 0 || opts->part >= opts->nparts))
+    {
+        sprintf (errmsg, "--nparts must be at least 2 with the zarr format, "
+            "and --part from 0 to nparts - 1");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Stacks a band of the input XML metadata files into a time series,
+written as a cube or a Zarr store.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the stack
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *input_list = NULL;          /* list of input XML files */
+    char *band_name = NULL;           /* name of the band to be stacked */
+    char *output = NULL;              /* output XML file or Zarr store */
+    char **xml_infile = NULL;         /* input XML filenames */
+    int nproducts = 0;                /* number of input XML files */
+    int i;                            /* looping variable */
+    int status;                       /* return status of the stack */
+    Stack_options_t opts;             /* options of the stack */
+
+    /* Read the command-line arguments */
+    opts.format = STACK_CUBE;
+    opts.chunk_lines = STACK_CHUNK_LINES;
+    opts.chunk_samps = STACK_CHUNK_SAMPS;
+    opts.level = ZARR_DEFLATE_LEVEL;
+    opts.nparts = 0;
+    opts.part = 0;
+    if (get_args (argc, argv, &input_list, &band_name, &output, &opts) !=
+        SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Stack the band of the XML files of the input list */
+    status = read_input_list (input_list, &nproducts, &xml_infile);
+    if (status == SUCCESS)
+        status = stack_band (nproducts, xml_infile, band_name, output,
+            &opts);
+
+    /* Free the pointers */
+    for (i = 0; i < nproducts; i++)
+        free (xml_infile[i]);
+    free (xml_infile);
+    free (input_list);
+    free (band_name);
+    free (output);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
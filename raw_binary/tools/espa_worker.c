@@ -0,0 +1,1936 @@
+/*****************************************************************************
+FILE: espa_worker
+
+PURPOSE: Runs Level-1 processing jobs in a long-running process, which loads
+the ESPA schema and the land-mass polygon once and keeps them resident for
+all the jobs.  The jobs are read as JSON lines from the standard input or
+from the connections to a UNIX socket, and the result of each job is written
+back as a JSON line.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. Each job is a flat JSON object on one line.  The input is given by one
+     of "xml" (an ESPA XML file), "mtl" (an LPGS MTL file) or "bundle" (an
+     LPGS product bundle), and "output" names the XML file created from an
+     MTL file or bundle.  The stages to run are selected with the booleans
+     "clip", "angles", "average", "land_water_mask", "date_bands" and
+     "use_fill_mask", and the scene can be exported with "gtif" (the base
+     GeoTIFF filename), "hdf" or "bip".  "threads" sets the number of
+     threads for the stages, "memory_mb" overrides the memory budget of the
+     job, "del_src" removes the LPGS source files, "incremental" skips the
+     stages whose bands are up to date (see espa_pipeline.h), and "id" is
+     copied to the result.
+  2. Each job runs in a forked child, so the schema and the polygon mapping
+     are shared with the worker rather than loaded again, and a job which
+     fails, crashes or exceeds its memory budget doesn't affect the others.
+     The job's memory budget also becomes the budget the library routines
+     size their line blocks and threads to (see espa_memory.h), unless
+     ESPA_MAX_MEMORY is smaller.
+  3. The result of each job is a JSON line with its "id", "status"
+     ("success" or "error"), "seconds" and "max_rss_kb".  The messages of
+     the worker and the jobs are written to the standard error, so the
+     standard output or the socket only holds the results.
+  4. With ESPA_PROFILE set, each job writes its own profile.
+  5. A job with "mosaic" or "stack" (the file listing the input XML files)
+     mosaics the scenes or stacks a band of the products instead, or a part
+     of them given by "part" and "nparts", so espa_distribute can spread a
+     mosaic or stack across the workers of several nodes.
+  6. "io_class" (interactive, normal or bulk), "io_read_mbps" and
+     "io_write_mbps" set the priority class and I/O rates of the job, in
+     place of ESPA_IO_CLASS and ESPA_IO_RATE (see espa_io_limit.h), so the
+     bulk exports of a node leave bandwidth to its interactive jobs.
+  7. With --metrics, the worker serves its metrics in the Prometheus text
+     format at http://[host:]port/metrics (see espa_metrics.h): the stage
+     latencies, I/O bytes, cache hits and pool gauges of all its jobs, and
+     its job counts and queue depths.
+  8. With a node scheduler (see espa_node_sched.h), each job waits in its
+     child to be admitted before it runs.  A job with the "angles" or
+     "land_water_mask" stages, or a mosaic, is CPU-bound and the others are
+     I/O-bound, unless "sched_class" (cpu or io) says otherwise.
+*****************************************************************************/
+#include <getopt.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "espa_pipeline.h"
+#include "espa_batch.h"
+#include "generate_land_water_mask.h"
+#include "espa_profile.h"
+#include "espa_memory.h"
+#include "espa_numa.h"
+#include "espa_mosaic.h"
+#include "espa_stack.h"
+#include "convert_espa_to_zarr.h"
+#include "espa_io_limit.h"
+#include "espa_metrics.h"
+#include "espa_node_sched.h"
+
+/* Defines */
+/* Maximum number of fields in a job */
+#define MAX_JOB_FIELDS 32
+
+/* Maximum length of a job line */
+#define MAX_JOB_LINE 8192
+
+/* Number of pending connections to the socket */
+#define SOCKET_BACKLOG 16
+
+/* Field of a job; strings are unescaped, and numbers and booleans are kept
+   as written */
+typedef struct
+{
+    char key[STR_SIZE];           /* name of the field */
+    char value[STR_SIZE];         /* value of the field */
+    bool is_string;               /* was the value a JSON string? */
+} Worker_field_t;
+
+/* Job read from a JSON line */
+typedef struct
+{
+    int nfields;                           /* number of fields */
+    Worker_field_t field[MAX_JOB_FIELDS];  /* fields of the job */
+} Worker_job_t;
+
+/* Job running in a child process */
+typedef struct
+{
+    pid_t pid;                    /* process ID of the child; 0 if unused */
+    char id[STR_SIZE];            /* ID of the job */
+    struct timeval start;         /* time the job was started */
+} Worker_child_t;
+
+/* Options of the worker */
+typedef struct
+{
+    int nprocs;                   /* number of jobs run concurrently */
+    long memory_mb;               /* default memory budget of each job in
+                                     megabytes; 0 for no limit */
+    char *land_mass_polygon;      /* filename of the land-mass polygon; NULL
+                                     if not defined */
+    char *metrics_address;        /* [host:]port the metrics are served on;
+                                     NULL if not served */
+} Worker_options_t;
+
+/* Fields a job may have, so misspelled fields are reported */
+static const char *job_keys[] =
+{
+    "id", "xml", "mtl", "bundle", "output", "clip", "angles", "average",
+    "land_water_mask", "date_bands", "use_fill_mask", "gtif", "hdf", "bip",
+    "threads", "memory_mb", "del_src", "mosaic", "stack", "template",
+    "priority", "qa_band", "qa_mask", "pixel_size", "template_extent",
+    "band", "format", "part", "nparts", "gather", "io_class",
+    "io_read_mbps", "io_write_mbps", "incremental", "sched_class", NULL
+};
+
+/* Set by the signal handler to stop accepting connections */
+static volatile sig_atomic_t stop_worker = 0;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("espa_worker runs Level-1 processing jobs in a long-running "
+            "process which loads the ESPA schema and the land-mass polygon "
+            "once for all the jobs. Each job is a JSON object on one line, "
+            "read from the standard input or from the connections to a UNIX "
+            "socket, and its result is written back as a JSON line.\n\n");
+    printf ("usage: espa_worker [--socket=socket_filename] [--procs=nprocs] "
+            "[--memory_mb=megabytes] [--metrics=[host:]port]\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -socket: name of the UNIX socket to accept jobs on; by "
+            "default the jobs are read from the standard input\n");
+    printf ("    -procs: number of jobs run concurrently, from 1 to %d "
+            "(default is 1)\n", ESPA_BATCH_MAX_PROCS);
+    printf ("    -memory_mb: address space limit of each job in megabytes; "
+            "a job may lower or raise it with \"memory_mb\" (default is no "
+            "limit)\n");
+    printf ("    -metrics: serve the Prometheus metrics of the worker at "
+            "http://[host:]port/metrics (default is not to serve them)\n");
+    printf ("\nJob fields: \"id\", one of \"xml\", \"mtl\" or \"bundle\", "
+            "\"output\" (required for a bundle), the stage booleans "
+            "\"clip\", \"angles\", \"average\", \"land_water_mask\", "
+            "\"date_bands\" and \"use_fill_mask\", the exports \"gtif\", "
+            "\"hdf\" and \"bip\", \"threads\", \"memory_mb\", "
+            "\"del_src\" and \"incremental\".\n");
+    printf ("\nMosaic jobs give the input list in \"mosaic\", with "
+            "\"output\", \"template\", \"priority\", \"qa_band\", "
+            "\"qa_mask\", \"pixel_size\", \"template_extent\", \"part\", "
+            "\"nparts\" and \"gather\"; stack jobs give it in \"stack\", "
+            "with \"band\", \"output\", \"format\", \"part\" and "
+            "\"nparts\".  \"threads\" sets their task pool size.\n");
+    printf ("\nAny job may set its I/O priority class with \"io_class\" "
+            "(interactive, normal or bulk) and its I/O rates in MB/s with "
+            "\"io_read_mbps\" and \"io_write_mbps\", and its class for "
+            "the node scheduler given by ESPA_NODE_SCHED with "
+            "\"sched_class\" (cpu or io).\n");
+    printf ("\nExample: echo '{\"id\": \"1\", \"mtl\": "
+            "\"LC08_L1TP_047027_20131014_20170308_01_T1_MTL.txt\", "
+            "\"clip\": true, \"land_water_mask\": true}' | espa_worker\n");
+    printf ("Example: espa_worker --socket=/tmp/espa_worker.sock --procs=8 "
+            "--memory_mb=4096 --metrics=9464\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates them.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the socket filename and metrics address.  They
+     should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **socket_file,   /* O: address of the socket filename */
+    int *nprocs,          /* O: number of jobs run concurrently */
+    long *memory_mb,      /* O: memory budget of each job in megabytes */
+    char **metrics_address  /* O: address the metrics are served on */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"socket", required_argument, 0, 's'},
+        {"procs", required_argument, 0, 'P'},
+        {"memory_mb", required_argument, 0, 'm'},
+        {"metrics", required_argument, 0, 'M'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 's':  /* socket filename */
+                *socket_file = strdup (optarg);
+                break;
+
+            case 'P':  /* number of jobs run concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case 'm':  /* memory budget of each job */
+                *memory_mb = atol (optarg);
+                break;
+
+            case 'M':  /* address the metrics are served on */
+                *metrics_address = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the number of concurrent jobs is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent jobs must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the memory budget is valid */
+    if (*memory_mb < 0)
+    {
+        sprintf (errmsg, "Memory budget must not be negative");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  parse_json_string
+
+PURPOSE: Parses a JSON string starting at the opening quote.
+
+RETURN VALUE:
+Type = char *
+Value           Description
+-----           -----------
+NULL            The string is malformed or too long
+pointer         Position just after the closing quote
+
+NOTES:
+  1. \u escapes are not supported, since the job fields are filenames and
+     options.
+******************************************************************************/
+static char *parse_json_string
+(
+    char *cptr,           /* I: position of the opening quote */
+    char *value           /* O: unescaped string (STR_SIZE) */
+)
+{
+    int len = 0;          /* length of the unescaped string */
+
+    for (cptr++; *cptr != '"'; cptr++)
+    {
+        if (*cptr == '\0' || len >= STR_SIZE - 1)
+            return (NULL);
+
+        if (*cptr == '\\')
+        {
+            cptr++;
+            switch (*cptr)
+            {
+                case '"': case '\\': case '/':
+                    value[len++] = *cptr;
+                    break;
+                case 'n':
+                    value[len++] = '\n';
+                    break;
+                case 't':
+                    value[len++] = '\t';
+                    break;
+                default:
+                    return (NULL);
+            }
+        }
+        else
+            value[len++] = *cptr;
+    }
+    value[len] = '\0';
+
+    return (cptr + 1);
+}
+
+
+/******************************************************************************
+MODULE:  parse_job
+
+PURPOSE: Parses a job from a JSON line.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The line isn't a flat JSON object of known fields
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The values must be strings, numbers, true, false or null; nested
+     objects and arrays are not supported.
+******************************************************************************/
+static int parse_job
+(
+    char *line,           /* I: JSON line */
+    Worker_job_t *job     /* O: parsed job */
+)
+{
+    char FUNC_NAME[] = "parse_job";  /* function name */
+    char errmsg[STR_SIZE];           /* error message */
+    char *cptr = line;               /* current position in the line */
+    Worker_field_t *field;           /* current field */
+    int len;                         /* length of a bare value */
+    int i;                           /* looping variable */
+
+    job->nfields = 0;
+
+    while (isspace ((unsigned char) *cptr))
+        cptr++;
+    if (*cptr++ != '{')
+    {
+        sprintf (errmsg, "Job is not a JSON object");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (1)
+    {
+        while (isspace ((unsigned char) *cptr))
+            cptr++;
+        if (*cptr == '}' && job->nfields == 0)
+        {
+            cptr++;
+            break;
+        }
+
+        if (job->nfields == MAX_JOB_FIELDS)
+        {
+            sprintf (errmsg, "Job has more than %d fields", MAX_JOB_FIELDS);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        field = &job->field[job->nfields];
+
+        /* Field name */
+        if (*cptr != '"' ||
+            (cptr = parse_json_string (cptr, field->key)) == NULL)
+        {
+            sprintf (errmsg, "Malformed field name in the job");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (i = 0; job_keys[i] != NULL; i++)
+        {
+            if (!strcmp (field->key, job_keys[i]))
+                break;
+        }
+        if (job_keys[i] == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Unknown job field %s",
+                field->key);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        while (isspace ((unsigned char) *cptr))
+            cptr++;
+        if (*cptr++ != ':')
+        {
+            snprintf (errmsg, sizeof (errmsg), "Missing value for job field "
+                "%s", field->key);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        while (isspace ((unsigned char) *cptr))
+            cptr++;
+
+        /* Field value; a string, or a bare number or literal */
+        if (*cptr == '"')
+        {
+            field->is_string = true;
+            cptr = parse_json_string (cptr, field->value);
+        }
+        else
+        {
+            field->is_string = false;
+            len = strcspn (cptr, ",} \t\r\n");
+            if (len == 0 || len >= STR_SIZE)
+                cptr = NULL;
+            else
+            {
+                strncpy (field->value, cptr, len);
+                field->value[len] = '\0';
+                cptr += len;
+            }
+        }
+        if (cptr == NULL)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Malformed value for job "
+                "field %s", field->key);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* A null value is the same as leaving the field out */
+        if (field->is_string || strcmp (field->value, "null"))
+            job->nfields++;
+
+        while (isspace ((unsigned char) *cptr))
+            cptr++;
+        if (*cptr == ',')
+            cptr++;
+        else if (*cptr == '}')
+        {
+            cptr++;
+            break;
+        }
+        else
+        {
+            sprintf (errmsg, "Expected , or } in the job");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    while (isspace ((unsigned char) *cptr))
+        cptr++;
+    if (*cptr != '\0')
+    {
+        sprintf (errmsg, "Unexpected text after the job object");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_job_field
+
+PURPOSE: Finds a field of a job.
+
+RETURN VALUE:
+Type = Worker_field_t *
+Value           Description
+-----           -----------
+NULL            The job doesn't have the field
+pointer         The field
+
+NOTES:
+******************************************************************************/
+static Worker_field_t *find_job_field
+(
+    Worker_job_t *job,    /* I: parsed job */
+    const char *key       /* I: name of the field */
+)
+{
+    int i;                /* looping variable */
+
+    for (i = job->nfields - 1; i >= 0; i--)
+    {
+        if (!strcmp (job->field[i].key, key))
+            return (&job->field[i]);
+    }
+
+    return (NULL);
+}
+
+
+/******************************************************************************
+MODULE:  get_job_string
+
+PURPOSE: Gets a string field of a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't a non-empty string
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_job_string
+(
+    Worker_job_t *job,    /* I: parsed job */
+    const char *key,      /* I: name of the field */
+    char **value          /* O: value of the field; NULL if the job doesn't
+                                have the field */
+)
+{
+    char FUNC_NAME[] = "get_job_string";  /* function name */
+    char errmsg[STR_SIZE];                /* error message */
+    Worker_field_t *field = find_job_field (job, key);  /* field of the job */
+
+    *value = NULL;
+    if (field == NULL)
+        return (SUCCESS);
+
+    if (!field->is_string || field->value[0] == '\0')
+    {
+        snprintf (errmsg, sizeof (errmsg), "Job field %s must be a "
+            "non-empty string", key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *value = field->value;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_job_bool
+
+PURPOSE: Gets a boolean field of a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't true or false
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_job_bool
+(
+    Worker_job_t *job,    /* I: parsed job */
+    const char *key,      /* I: name of the field */
+    bool *value           /* O: value of the field; false if the job doesn't
+                                have the field */
+)
+{
+    char FUNC_NAME[] = "get_job_bool";  /* function name */
+    char errmsg[STR_SIZE];              /* error message */
+    Worker_field_t *field = find_job_field (job, key);  /* field of the job */
+
+    *value = false;
+    if (field == NULL)
+        return (SUCCESS);
+
+    if (!field->is_string && !strcmp (field->value, "true"))
+        *value = true;
+    else if (field->is_string || strcmp (field->value, "false"))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Job field %s must be true or "
+            "false", key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_job_long
+
+PURPOSE: Gets an integer field of a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't an integer within the limits
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_job_long
+(
+    Worker_job_t *job,    /* I: parsed job */
+    const char *key,      /* I: name of the field */
+    long min_value,       /* I: smallest allowed value */
+    long max_value,       /* I: largest allowed value */
+    long *value           /* I/O: value of the field; unchanged if the job
+                                  doesn't have the field */
+)
+{
+    char FUNC_NAME[] = "get_job_long";  /* function name */
+    char errmsg[STR_SIZE];              /* error message */
+    char *end = NULL;                   /* end of the number */
+    long number;                        /* value of the field */
+    Worker_field_t *field = find_job_field (job, key);  /* field of the job */
+
+    if (field == NULL)
+        return (SUCCESS);
+
+    errno = 0;
+    number = strtol (field->value, &end, 10);
+    if (field->is_string || *end != '\0' || errno != 0 ||
+        number < min_value || number > max_value)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Job field %s must be an integer "
+            "from %ld to %ld", key, min_value, max_value);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *value = number;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  get_job_double
+
+PURPOSE: Gets a positive number field of a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The field isn't a positive number
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int get_job_double
+(
+    Worker_job_t *job,    /* I: parsed job */
+    const char *key,      /* I: name of the field */
+    double *value         /* I/O: value of the field; unchanged if the job
+                                  doesn't have the field */
+)
+{
+    char FUNC_NAME[] = "get_job_double";  /* function name */
+    char errmsg[STR_SIZE];                /* error message */
+    char *end = NULL;                     /* end of the number */
+    double number;                        /* value of the field */
+    Worker_field_t *field = find_job_field (job, key);  /* field of the job */
+
+    if (field == NULL)
+        return (SUCCESS);
+
+    errno = 0;
+    number = strtod (field->value, &end);
+    if (field->is_string || end == field->value || *end != '\0' ||
+        errno != 0 || !(number > 0.0))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Job field %s must be a positive "
+            "number", key);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *value = number;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_job_io_limit
+
+PURPOSE: Sets the priority class and I/O rates of a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the I/O fields of the job
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The fields the job doesn't have keep the values of the environment.
+     The job runs in its own child, so the limits end with it.
+******************************************************************************/
+static int set_job_io_limit
+(
+    Worker_job_t *job     /* I: parsed job */
+)
+{
+    char FUNC_NAME[] = "set_job_io_limit";  /* function name */
+    char errmsg[STR_SIZE];                  /* error message */
+    char *class_name = NULL;                /* priority class of the job */
+    double read_rate;                       /* read rate (MB/s) */
+    double write_rate;                      /* write rate (MB/s) */
+    Espa_io_class_t io_class;               /* priority class */
+
+    if (find_job_field (job, "io_class") == NULL &&
+        find_job_field (job, "io_read_mbps") == NULL &&
+        find_job_field (job, "io_write_mbps") == NULL)
+        return (SUCCESS);
+
+    espa_io_get_limit (&io_class, &read_rate, &write_rate);
+    if (get_job_string (job, "io_class", &class_name) != SUCCESS ||
+        get_job_double (job, "io_read_mbps", &read_rate) != SUCCESS ||
+        get_job_double (job, "io_write_mbps", &write_rate) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (class_name != NULL && espa_io_parse_class (class_name, &io_class)
+        != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown io_class %s; must be "
+            "interactive, normal or bulk", class_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (espa_io_set_limit (io_class, read_rate, write_rate));
+}
+
+
+/******************************************************************************
+MODULE:  admit_job
+
+PURPOSE: Waits until the node scheduler admits a job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the scheduling fields of the job
+SUCCESS         The job was admitted, or there's no node scheduler
+
+NOTES:
+  1. The admission is held until the child of the job exits, which closes
+     its connection to the scheduler.
+  2. A CPU-bound job uses the cores given by "threads", or else the threads
+     of its task pool.
+******************************************************************************/
+static int admit_job
+(
+    Worker_job_t *job     /* I: parsed job */
+)
+{
+    char FUNC_NAME[] = "admit_job";  /* function name */
+    char errmsg[STR_SIZE];           /* error message */
+    char *class_name = NULL;         /* class of the job */
+    bool angles, land_water;         /* CPU-bound stages of the job */
+    long nthreads = 0;               /* threads of the job; 0 if not given */
+    Espa_sched_class_t sched_class;  /* class of the job */
+
+    if (!espa_sched_enabled ())
+        return (SUCCESS);
+
+    if (get_job_string (job, "sched_class", &class_name) != SUCCESS ||
+        get_job_bool (job, "angles", &angles) != SUCCESS ||
+        get_job_bool (job, "land_water_mask", &land_water) != SUCCESS ||
+        get_job_long (job, "threads", 1, 256, &nthreads) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (class_name != NULL)
+    {
+        if (espa_sched_parse_class (class_name, &sched_class) != SUCCESS)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Unknown sched_class %s; must "
+                "be cpu or io", class_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    else if (angles || land_water || find_job_field (job, "mosaic") != NULL)
+        sched_class = ESPA_SCHED_CPU;
+    else
+        sched_class = ESPA_SCHED_IO;
+
+    espa_sched_admit (sched_class, (int) nthreads);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_job_list
+
+PURPOSE: Reads the XML files listed in the input list of a mosaic or stack
+job.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the input list
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines and lines starting with # are ignored.  The caller is
+     responsible for freeing the filenames and the list.
+******************************************************************************/
+static int read_job_list
+(
+    char *input_list,     /* I: name of the input list */
+    int *nfiles,          /* O: number of XML files */
+    char ***xml_file      /* O: address of the XML filenames */
+)
+{
+    char FUNC_NAME[] = "read_job_list";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char *line = NULL;    /* current line of the input list */
+    size_t line_size = 0; /* allocated size of line */
+    char *ptr = NULL;     /* start of the filename in the line */
+    char *end = NULL;     /* end of the filename in the line */
+    char **new_ptr = NULL;  /* reallocated list of filenames */
+    int size = 0;         /* allocated number of filenames */
+    int status = SUCCESS; /* return status */
+    FILE *fptr = NULL;    /* input list file pointer */
+
+    *nfiles = 0;
+    *xml_file = NULL;
+    fptr = fopen (input_list, "r");
+    if (fptr == NULL)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening the input list %s",
+            input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (getline (&line, &line_size, fptr) != -1)
+    {
+        /* Trim the whitespace around the filename */
+        ptr = line;
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (*ptr == '\0' || *ptr == '#')
+            continue;
+        end = ptr + strlen (ptr);
+        while (end > ptr && isspace ((unsigned char) end[-1]))
+            end--;
+        *end = '\0';
+
+        if (*nfiles == size)
+        {
+            size = (size > 0) ? size * 2 : 256;
+            new_ptr = realloc (*xml_file, size * sizeof (char *));
+            if (new_ptr == NULL)
+            {
+                status = ERROR;
+                break;
+            }
+            *xml_file = new_ptr;
+        }
+
+        (*xml_file)[*nfiles] = strdup (ptr);
+        if ((*xml_file)[*nfiles] == NULL)
+        {
+            status = ERROR;
+            break;
+        }
+        (*nfiles)++;
+    }
+    free (line);
+    fclose (fptr);
+
+    if (status != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the input list");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+    else if (*nfiles == 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "The input list %s has no XML "
+            "files", input_list);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_mosaic_job
+
+PURPOSE: Runs a job mosaicking the scenes of an input list, or a part of the
+mosaic, or gathering the parts (see espa_mosaic.h).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the job or in the mosaic
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The job has the input list in "mosaic", the output XML file in
+     "output", the template XML file in "template", and optionally
+     "priority" (latest, zenith or qa), "qa_band", "qa_mask" (a decimal or
+     0x hexadecimal string), "pixel_size", "template_extent", "part" and
+     "nparts", or "gather" and "nparts".
+******************************************************************************/
+static int run_mosaic_job
+(
+    Worker_job_t *job,          /* I: parsed job */
+    char *input_list            /* I: input list of the scenes */
+)
+{
+    char FUNC_NAME[] = "run_mosaic_job"; /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *output = NULL;          /* output XML filename */
+    char *template_xml = NULL;    /* template XML filename */
+    char *priority = NULL;        /* priority of the scenes */
+    char *qa_band = NULL;         /* name of the QA band */
+    char *qa_mask = NULL;         /* QA bits marking a pixel as not clear */
+    char *end = NULL;             /* end of the QA mask */
+    char **xml_infile = NULL;     /* input XML filenames */
+    long part = 0;                /* part to be written */
+    long nparts = 0;              /* number of parts */
+    int nscenes = 0;              /* number of input XML files */
+    int i;                        /* looping variable */
+    int status;                   /* return status of the mosaic */
+    Mosaic_options_t mopts;       /* options of the mosaic */
+
+    memset (&mopts, 0, sizeof (mopts));
+    mopts.priority = MOSAIC_LATEST;
+    if (get_job_string (job, "output", &output) != SUCCESS ||
+        get_job_string (job, "template", &template_xml) != SUCCESS ||
+        get_job_string (job, "priority", &priority) != SUCCESS ||
+        get_job_string (job, "qa_band", &qa_band) != SUCCESS ||
+        get_job_string (job, "qa_mask", &qa_mask) != SUCCESS ||
+        get_job_long (job, "part", 0, MOSAIC_MAX_PARTS - 1, &part) != SUCCESS
+        || get_job_long (job, "nparts", 0, MOSAIC_MAX_PARTS, &nparts) !=
+        SUCCESS || get_job_bool (job, "gather", &mopts.gather) != SUCCESS ||
+        get_job_double (job, "pixel_size", &mopts.pixel_size) != SUCCESS ||
+        get_job_bool (job, "template_extent", &mopts.template_extent) !=
+        SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (output == NULL || template_xml == NULL)
+    {
+        sprintf (errmsg, "A mosaic job requires output and template");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (priority == NULL || !strcmp (priority, "latest"))
+        mopts.priority = MOSAIC_LATEST;
+    else if (!strcmp (priority, "zenith"))
+        mopts.priority = MOSAIC_ZENITH;
+    else if (!strcmp (priority, "qa"))
+        mopts.priority = MOSAIC_QA;
+    else
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown priority %s", priority);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (qa_band != NULL)
+        snprintf (mopts.qa_band, sizeof (mopts.qa_band), "%s", qa_band);
+    if (qa_mask != NULL)
+    {
+        mopts.qa_mask = strtoul (qa_mask, &end, 0);
+        if (end == qa_mask || *end != '\0')
+        {
+            snprintf (errmsg, sizeof (errmsg), "Invalid QA mask %s",
+                qa_mask);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    mopts.part = (int) part;
+    mopts.nparts = (int) nparts;
+
+    /* Mosaic the XML files of the input list */
+    status = read_job_list (input_list, &nscenes, &xml_infile);
+    if (status == SUCCESS)
+        status = mosaic_xml (nscenes, xml_infile, output, template_xml,
+            &mopts);
+
+    for (i = 0; i < nscenes; i++)
+        free (xml_infile[i]);
+    free (xml_infile);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_stack_job
+
+PURPOSE: Runs a job stacking a band of the products of an input list into a
+time series, or a part of a Zarr stack (see espa_stack.h).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the job or in the stack
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The job has the input list in "stack", the band in "band", the output
+     in "output", and optionally "format" (cube or zarr, the default), and
+     "part" and "nparts".  The Zarr chunking and compression are the
+     defaults of espa_stack.
+******************************************************************************/
+static int run_stack_job
+(
+    Worker_job_t *job,          /* I: parsed job */
+    char *input_list            /* I: input list of the products */
+)
+{
+    char FUNC_NAME[] = "run_stack_job"; /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *output = NULL;          /* output XML file or Zarr store */
+    char *band_name = NULL;       /* name of the band to be stacked */
+    char *format = NULL;          /* output format */
+    char **xml_infile = NULL;     /* input XML filenames */
+    long part = 0;                /* part to be written */
+    long nparts = 0;              /* number of parts */
+    int nproducts = 0;            /* number of input XML files */
+    int i;                        /* looping variable */
+    int status;                   /* return status of the stack */
+    Stack_options_t sopts;        /* options of the stack */
+
+    if (get_job_string (job, "output", &output) != SUCCESS ||
+        get_job_string (job, "band", &band_name) != SUCCESS ||
+        get_job_string (job, "format", &format) != SUCCESS ||
+        get_job_long (job, "part", 0, INT_MAX - 1, &part) != SUCCESS ||
+        get_job_long (job, "nparts", 0, INT_MAX, &nparts) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    if (output == NULL || band_name == NULL)
+    {
+        sprintf (errmsg, "A stack job requires output and band");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    sopts.format = STACK_ZARR;
+    if (format != NULL && !strcmp (format, "cube"))
+        sopts.format = STACK_CUBE;
+    else if (format != NULL && strcmp (format, "zarr"))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Unknown format %s", format);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    sopts.chunk_lines = STACK_CHUNK_LINES;
+    sopts.chunk_samps = STACK_CHUNK_SAMPS;
+    sopts.level = ZARR_DEFLATE_LEVEL;
+    sopts.part = (int) part;
+    sopts.nparts = (int) nparts;
+
+    /* Stack the band of the XML files of the input list */
+    status = read_job_list (input_list, &nproducts, &xml_infile);
+    if (status == SUCCESS)
+        status = stack_band (nproducts, xml_infile, band_name, output,
+            &sopts);
+
+    for (i = 0; i < nproducts; i++)
+        free (xml_infile[i]);
+    free (xml_infile);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  run_job
+
+PURPOSE: Runs the stages of a job on its scene.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error in the job or in processing the scene
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The angle bands use the default grid options of create_angle_bands, and
+     the exports the default options of the convert_espa_to_* tools, as done
+     by create_level1_espa.
+  2. Mosaic and stack jobs are run by run_mosaic_job and run_stack_job, with
+     "threads" setting the size of the task pool.
+******************************************************************************/
+static int run_job
+(
+    Worker_job_t *job,          /* I: parsed job */
+    Worker_options_t *opts      /* I: options of the worker */
+)
+{
+    char FUNC_NAME[] = "run_job"; /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *xml_infile = NULL;      /* input ESPA XML filename */
+    char *mtl_infile = NULL;      /* input LPGS MTL filename */
+    char *bundle_infile = NULL;   /* input LPGS product bundle */
+    char *output = NULL;          /* output XML filename */
+    char *gtif_file = NULL;       /* base output GeoTIFF filename */
+    char *hdf_file = NULL;        /* output HDF filename */
+    char *bip_file = NULL;        /* output BIP filename */
+    char *mosaic_list = NULL;     /* input list of a mosaic */
+    char *stack_list = NULL;      /* input list of a stack */
+    char xml_outfile[STR_SIZE];   /* output XML filename */
+    char *cptr = NULL;            /* pointer to _MTL.txt in MTL filename */
+    bool clip, angles, band_avg;  /* stages to be run */
+    bool land_water, date_bands;  /* stages to be run */
+    bool use_fill_mask;           /* should band 1 fill be used as the date
+                                     band fill? */
+    bool del_src;                 /* should the source files be removed? */
+    bool incremental;             /* should the stages whose bands are up to
+                                     date be skipped? */
+    long nthreads = 1;            /* number of threads for the stages */
+    int ninputs;                  /* number of inputs given */
+    int status;                   /* return status of the stages */
+    Espa_pipeline_t pipeline;     /* pipeline handle for the scene */
+
+    /* Limit the I/O of the job, and wait for the node scheduler to admit
+       it */
+    if (set_job_io_limit (job) != SUCCESS || admit_job (job) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Run the mosaic and stack jobs, in a task pool of the job's threads */
+    if (get_job_string (job, "mosaic", &mosaic_list) != SUCCESS ||
+        get_job_string (job, "stack", &stack_list) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+    if (mosaic_list != NULL || stack_list != NULL)
+    {
+        nthreads = 0;
+        if (get_job_long (job, "threads", 1, 256, &nthreads) != SUCCESS)
+        {  /* Error messages already written */
+            return (ERROR);
+        }
+        if (nthreads > 0)
+        {
+            snprintf (xml_outfile, sizeof (xml_outfile), "%ld", nthreads);
+            setenv ("ESPA_TASK_THREADS", xml_outfile, 1);
+        }
+
+        if (mosaic_list != NULL && stack_list != NULL)
+        {
+            sprintf (errmsg, "Only one of mosaic or stack may be given");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        else if (mosaic_list != NULL)
+            return (run_mosaic_job (job, mosaic_list));
+        else
+            return (run_stack_job (job, stack_list));
+    }
+
+    /* Get the fields of the job */
+    if (get_job_string (job, "xml", &xml_infile) != SUCCESS ||
+        get_job_string (job, "mtl", &mtl_infile) != SUCCESS ||
+        get_job_string (job, "bundle", &bundle_infile) != SUCCESS ||
+        get_job_string (job, "output", &output) != SUCCESS ||
+        get_job_string (job, "gtif", &gtif_file) != SUCCESS ||
+        get_job_string (job, "hdf", &hdf_file) != SUCCESS ||
+        get_job_string (job, "bip", &bip_file) != SUCCESS ||
+        get_job_bool (job, "clip", &clip) != SUCCESS ||
+        get_job_bool (job, "angles", &angles) != SUCCESS ||
+        get_job_bool (job, "average", &band_avg) != SUCCESS ||
+        get_job_bool (job, "land_water_mask", &land_water) != SUCCESS ||
+        get_job_bool (job, "date_bands", &date_bands) != SUCCESS ||
+        get_job_bool (job, "use_fill_mask", &use_fill_mask) != SUCCESS ||
+        get_job_bool (job, "del_src", &del_src) != SUCCESS ||
+        get_job_bool (job, "incremental", &incremental) != SUCCESS ||
+        get_job_long (job, "threads", 1, 256, &nthreads) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    ninputs = (xml_infile != NULL) + (mtl_infile != NULL) +
+        (bundle_infile != NULL);
+    if (ninputs != 1)
+    {
+        sprintf (errmsg, "Exactly one of xml, mtl or bundle must be given");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (xml_infile != NULL && (output != NULL || del_src))
+    {
+        sprintf (errmsg, "output and del_src only apply to the mtl and "
+            "bundle inputs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (land_water && opts->land_mass_polygon == NULL)
+    {
+        sprintf (errmsg, "ESPA_LAND_MASS_POLYGON environment variable is "
+            "not defined, so the land/water mask can't be created");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Open the scene, converting the LPGS products to ESPA raw binary.  The
+       XML filename of an MTL file is the MTL filename with the _MTL.txt
+       changed to .xml, unless the job gave it. */
+    if (xml_infile != NULL)
+        status = open_espa_pipeline (xml_infile, &pipeline);
+    else
+    {
+        if (output != NULL)
+            cptr = NULL;
+        else if (mtl_infile != NULL)
+            cptr = strrchr (mtl_infile, '_');
+        if (output == NULL && cptr == NULL)
+        {
+            sprintf (errmsg, "output must be given for this input");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (output != NULL)
+            snprintf (xml_outfile, sizeof (xml_outfile), "%s", output);
+        else
+            snprintf (xml_outfile, sizeof (xml_outfile), "%.*s.xml",
+                (int) (cptr - mtl_infile), mtl_infile);
+
+        if (mtl_infile != NULL)
+            status = open_lpgs_pipeline (mtl_infile, xml_outfile, del_src,
+                nthreads, &pipeline);
+        else
+            status = open_lpgs_bundle_pipeline (bundle_infile, xml_outfile,
+                del_src, nthreads, &pipeline);
+    }
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Run the stages */
+    if (incremental)
+        pipeline.incremental = true;
+    if (clip)
+        status = clip_pipeline_bands (&pipeline);
+
+    if (status == SUCCESS && angles)
+        status = add_pipeline_angle_bands (&pipeline, band_avg, 1, 0.01,
+            false, nthreads, false, NULL);
+
+    if (status == SUCCESS && land_water)
+        status = add_pipeline_land_water_mask (&pipeline,
+            opts->land_mass_polygon);
+
+    if (status == SUCCESS && date_bands)
+        status = add_pipeline_date_bands (&pipeline, use_fill_mask);
+
+    if (status == SUCCESS)
+        status = write_pipeline_metadata (&pipeline);
+
+    /* Export the scene */
+    if (status == SUCCESS && gtif_file != NULL)
+        status = export_pipeline_gtif (&pipeline, gtif_file,
+            GTIF_COMPRESS_NONE, false, GTIF_INTERLEAVE_NONE, false);
+
+    if (status == SUCCESS && hdf_file != NULL)
+        status = export_pipeline_hdf (&pipeline, hdf_file, HDF_COMPRESS_NONE,
+            false);
+
+    if (status == SUCCESS && bip_file != NULL)
+        status = export_pipeline_bip (&pipeline, bip_file, false, false);
+
+    close_espa_pipeline (&pipeline);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  write_json_string
+
+PURPOSE: Writes a string as a JSON string.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void write_json_string
+(
+    FILE *fp,             /* I: output stream */
+    const char *value     /* I: string to be written */
+)
+{
+    const unsigned char *cptr;  /* current character */
+
+    fputc ('"', fp);
+    for (cptr = (const unsigned char *) value; *cptr != '\0'; cptr++)
+    {
+        if (*cptr == '"' || *cptr == '\\')
+            fprintf (fp, "\\%c", *cptr);
+        else if (*cptr < 0x20)
+            fprintf (fp, "\\u%04x", *cptr);
+        else
+            fputc (*cptr, fp);
+    }
+    fputc ('"', fp);
+}
+
+
+/******************************************************************************
+MODULE:  write_result
+
+PURPOSE: Writes the result of a job as a JSON line.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void write_result
+(
+    FILE *out,            /* I: stream the results are written to */
+    const char *id,       /* I: ID of the job */
+    bool success,         /* I: did the job succeed? */
+    double seconds,       /* I: elapsed time of the job */
+    long max_rss_kb       /* I: peak resident memory of the job */
+)
+{
+    fprintf (out, "{\"id\": ");
+    write_json_string (out, id);
+    fprintf (out, ", \"status\": \"%s\", \"seconds\": %.3f, "
+        "\"max_rss_kb\": %ld}\n", success ? "success" : "error", seconds,
+        max_rss_kb);
+    fflush (out);
+}
+
+
+/******************************************************************************
+MODULE:  set_job_metrics
+
+PURPOSE: Sets the job queue depths of the metrics from the running jobs.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void set_job_metrics
+(
+    Worker_child_t *child,  /* I: running jobs */
+    int nprocs,             /* I: number of job slots */
+    int waiting             /* I: number of jobs waiting for a slot */
+)
+{
+    int nrunning = 0;       /* number of jobs running */
+    int i;                  /* looping variable */
+
+    for (i = 0; i < nprocs; i++)
+    {
+        if (child[i].pid != 0)
+            nrunning++;
+    }
+    espa_metrics_set_jobs (nrunning, waiting, nprocs);
+}
+
+
+/******************************************************************************
+MODULE:  wait_for_job
+
+PURPOSE: Waits for one of the running jobs to finish and writes its result.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           No job could be waited for
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int wait_for_job
+(
+    Worker_child_t *child,  /* I/O: running jobs */
+    int nprocs,             /* I: number of job slots */
+    FILE *out               /* I: stream the results are written to */
+)
+{
+    char FUNC_NAME[] = "wait_for_job";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int wstatus;            /* exit status of the child */
+    int i;                  /* looping variable */
+    bool success;           /* did the job succeed? */
+    double seconds;         /* elapsed time of the job */
+    pid_t pid;              /* process ID of the finished child */
+    struct rusage usage;    /* resource usage of the finished child */
+    struct timeval now;     /* time the child finished */
+
+    do
+        pid = wait4 (-1, &wstatus, 0, &usage);
+    while (pid < 0 && errno == EINTR);
+    if (pid < 0)
+    {
+        sprintf (errmsg, "Waiting for a job: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    gettimeofday (&now, NULL);
+
+    for (i = 0; i < nprocs; i++)
+    {
+        if (child[i].pid != pid)
+            continue;
+
+        if (WIFSIGNALED (wstatus))
+        {
+            snprintf (errmsg, sizeof (errmsg), "Job %s was killed by signal "
+                "%d", child[i].id, WTERMSIG (wstatus));
+            error_handler (true, FUNC_NAME, errmsg);
+        }
+        success = WIFEXITED (wstatus) && WEXITSTATUS (wstatus) == SUCCESS;
+        seconds = (now.tv_sec - child[i].start.tv_sec) +
+            (now.tv_usec - child[i].start.tv_usec) * 1e-6;
+        write_result (out, child[i].id, success, seconds, usage.ru_maxrss);
+        child[i].pid = 0;
+        espa_metrics_count_job (success, seconds);
+        espa_metrics_clear_slot (i);
+        set_job_metrics (child, nprocs, 0);
+        break;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  start_job
+
+PURPOSE: Parses a job and starts it in a child process, once a job slot is
+free.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The child process couldn't be created
+SUCCESS         The job was started, or its error was written as its result
+
+NOTES:
+  1. A job which can't be parsed gets an error result without being run,
+     with the ID of the job if it was parsed before the error.
+******************************************************************************/
+static int start_job
+(
+    char *line,             /* I: JSON line of the job */
+    Worker_options_t *opts, /* I: options of the worker */
+    Worker_child_t *child,  /* I/O: running jobs */
+    FILE *out               /* I: stream the results are written to */
+)
+{
+    char FUNC_NAME[] = "start_job";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char *id = NULL;        /* ID of the job */
+    char budget[STR_SIZE];  /* memory budget of the library routines */
+    long memory_mb = opts->memory_mb;  /* memory budget of the job */
+    int slot;               /* job slot of the child */
+    int status;             /* return status of the job */
+    pid_t pid;              /* process ID of the child */
+    struct rlimit limit;    /* address space limit of the child */
+    struct timeval start;   /* time the job was started */
+    Worker_job_t job;       /* parsed job */
+
+    gettimeofday (&start, NULL);
+    status = parse_job (line, &job);
+    if (get_job_string (&job, "id", &id) != SUCCESS)
+        status = ERROR;
+    if (status == SUCCESS && get_job_long (&job, "memory_mb", 0,
+        LONG_MAX / (1024 * 1024), &memory_mb) != SUCCESS)
+        status = ERROR;
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        write_result (out, id == NULL ? "" : id, false, 0.0, 0);
+        return (SUCCESS);
+    }
+    if (id == NULL)
+        id = "";
+
+    /* Wait for a free job slot */
+    while (1)
+    {
+        for (slot = 0; slot < opts->nprocs; slot++)
+        {
+            if (child[slot].pid == 0)
+                break;
+        }
+        if (slot < opts->nprocs)
+            break;
+        set_job_metrics (child, opts->nprocs, 1);
+        if (wait_for_job (child, opts->nprocs, out) != SUCCESS)
+            return (ERROR);
+    }
+
+    fflush (NULL);
+    pid = fork ();
+    if (pid < 0)
+    {
+        sprintf (errmsg, "Creating the process for a job: %s",
+            strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (pid == 0)
+    {
+        /* Keep the job's messages out of the results */
+        dup2 (STDERR_FILENO, STDOUT_FILENO);
+        espa_metrics_set_slot (slot);
+
+        if (memory_mb > 0)
+        {
+            limit.rlim_cur = limit.rlim_max = (rlim_t) memory_mb * 1024 * 1024;
+            if (setrlimit (RLIMIT_AS, &limit) != 0)
+            {
+                sprintf (errmsg, "Setting the memory budget of the job");
+                error_handler (true, FUNC_NAME, errmsg);
+                _exit (ERROR);
+            }
+
+            if (espa_memory_budget () == 0 || espa_memory_budget () >
+                (size_t) memory_mb * 1024 * 1024)
+            {
+                snprintf (budget, sizeof (budget), "%ldM", memory_mb);
+                espa_set_memory_budget (budget);
+            }
+        }
+
+        /* Keep the job's threads and buffers on the NUMA node of its slot */
+        espa_numa_bind_process (slot);
+
+        espa_profile_reset ();
+        status = run_job (&job, opts);
+        espa_profile_report ();
+        fflush (NULL);
+        _exit (status);
+    }
+
+    child[slot].pid = pid;
+    child[slot].start = start;
+    snprintf (child[slot].id, sizeof (child[slot].id), "%s", id);
+    set_job_metrics (child, opts->nprocs, 0);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  run_jobs
+
+PURPOSE: Runs the jobs read from a stream until the end of the stream, and
+writes their results.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting or waiting for the jobs
+SUCCESS         All the jobs were run, successfully or not
+
+NOTES:
+  1. Blank lines are ignored.
+******************************************************************************/
+static int run_jobs
+(
+    FILE *in,               /* I: stream the jobs are read from */
+    FILE *out,              /* I: stream the results are written to */
+    Worker_options_t *opts  /* I: options of the worker */
+)
+{
+    char FUNC_NAME[] = "run_jobs";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    char line[MAX_JOB_LINE];  /* JSON line of a job */
+    int status = SUCCESS;   /* return status */
+    int i;                  /* looping variable */
+    Worker_child_t child[ESPA_BATCH_MAX_PROCS];  /* running jobs */
+
+    for (i = 0; i < opts->nprocs; i++)
+        child[i].pid = 0;
+
+    while (status == SUCCESS && !stop_worker &&
+        fgets (line, sizeof (line), in) != NULL)
+    {
+        if (strchr (line, '\n') == NULL && !feof (in))
+        {
+            sprintf (errmsg, "Job is longer than %d characters", MAX_JOB_LINE);
+            error_handler (true, FUNC_NAME, errmsg);
+            while ((i = fgetc (in)) != EOF && i != '\n')
+                ;
+            write_result (out, "", false, 0.0, 0);
+            continue;
+        }
+
+        if (line[strspn (line, " \t\r\n")] == '\0')
+            continue;
+
+        status = start_job (line, opts, child, out);
+    }
+
+    /* Wait for the jobs still running */
+    for (i = 0; i < opts->nprocs; i++)
+    {
+        while (child[i].pid != 0)
+        {
+            if (wait_for_job (child, opts->nprocs, out) != SUCCESS)
+                return (ERROR);
+        }
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  stop_handler
+
+PURPOSE: Stops the worker from accepting connections on a signal.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void stop_handler
+(
+    int signum            /* I: signal received */
+)
+{
+    stop_worker = 1;
+}
+
+
+/******************************************************************************
+MODULE:  serve_socket
+
+PURPOSE: Accepts connections on a UNIX socket and runs the jobs sent on each
+connection, until interrupted or terminated.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the socket or running the jobs
+SUCCESS         The worker was stopped
+
+NOTES:
+  1. The connections are served one at a time; the results of the jobs of a
+     connection are written back on that connection, which is closed once
+     the client has finished writing and all its jobs are done.
+******************************************************************************/
+static int serve_socket
+(
+    char *socket_file,      /* I: name of the socket */
+    Worker_options_t *opts  /* I: options of the worker */
+)
+{
+    char FUNC_NAME[] = "serve_socket";  /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int listen_fd;          /* listening socket */
+    int conn_fd;            /* connection socket */
+    int out_fd;             /* connection socket for the results */
+    int status = SUCCESS;   /* return status */
+    FILE *in = NULL;        /* stream the jobs are read from */
+    FILE *out = NULL;       /* stream the results are written to */
+    struct sockaddr_un addr;   /* address of the socket */
+    struct sigaction action;   /* handler stopping the worker */
+
+    if (strlen (socket_file) >= sizeof (addr.sun_path))
+    {
+        sprintf (errmsg, "Socket filename is too long");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, socket_file);
+
+    listen_fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        sprintf (errmsg, "Creating the socket: %s", strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    unlink (socket_file);
+    if (bind (listen_fd, (struct sockaddr *) &addr, sizeof (addr)) != 0 ||
+        listen (listen_fd, SOCKET_BACKLOG) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Listening on socket %s: %s",
+            socket_file, strerror (errno));
+        error_handler (true, FUNC_NAME, errmsg);
+        close (listen_fd);
+        return (ERROR);
+    }
+
+    /* Stop on SIGINT and SIGTERM; no SA_RESTART, so accept is interrupted */
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = stop_handler;
+    sigemptyset (&action.sa_mask);
+    sigaction (SIGINT, &action, NULL);
+    sigaction (SIGTERM, &action, NULL);
+
+    /* A client which goes away before reading its results mustn't stop the
+       worker */
+    signal (SIGPIPE, SIG_IGN);
+
+    printf ("espa_worker accepting jobs on %s\n", socket_file);
+    fflush (stdout);
+
+    while (status == SUCCESS && !stop_worker)
+    {
+        conn_fd = accept (listen_fd, NULL, NULL);
+        if (conn_fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            sprintf (errmsg, "Accepting a connection: %s", strerror (errno));
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+
+        out_fd = dup (conn_fd);
+        in = fdopen (conn_fd, "r");
+        out = (out_fd < 0) ? NULL : fdopen (out_fd, "w");
+        if (in == NULL || out == NULL)
+        {
+            sprintf (errmsg, "Opening the connection streams");
+            error_handler (true, FUNC_NAME, errmsg);
+            if (in != NULL)
+                fclose (in);
+            else
+                close (conn_fd);
+            if (out != NULL)
+                fclose (out);
+            else if (out_fd >= 0)
+                close (out_fd);
+            continue;
+        }
+
+        status = run_jobs (in, out, opts);
+        fclose (in);
+        fclose (out);
+    }
+
+    close (listen_fd);
+    unlink (socket_file);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Loads the ESPA schema and the land-mass polygon, and runs the jobs
+read from the standard input or the socket.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error starting the worker or running the jobs
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The exit status doesn't reflect the status of the jobs, which is given
+     by their results.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "espa_worker";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *socket_file = NULL;     /* name of the socket */
+    int results_fd;               /* standard output, for the results */
+    int status;                   /* status of running the jobs */
+    pid_t metrics_pid = -1;       /* process ID of the metrics server */
+    FILE *results = NULL;         /* stream the results are written to */
+    Worker_options_t opts;        /* options of the worker */
+
+    /* Read the command-line arguments */
+    opts.nprocs = 1;
+    opts.memory_mb = 0;
+    opts.metrics_address = NULL;
+    if (get_args (argc, argv, &socket_file, &opts.nprocs, &opts.memory_mb,
+        &opts.metrics_address) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Map the metrics before anything is profiled, so the counters of the
+       worker and its jobs are shared with the server */
+    if (opts.metrics_address != NULL)
+    {
+        if (espa_metrics_init () != SUCCESS)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+        metrics_pid = start_espa_metrics_server (opts.metrics_address);
+        if (metrics_pid < 0)
+        {  /* Error messages already written */
+            exit (EXIT_FAILURE);
+        }
+        espa_metrics_set_jobs (0, 0, opts.nprocs);
+    }
+
+    /* Compile the schema once for all the jobs */
+    if (load_espa_schema (NULL) != SUCCESS)
+    {  /* Error messages already written */
+        free (socket_file);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Keep a packed land-mass polygon mapped for all the jobs; any other
+       polygon file is read by each job */
+    opts.land_mass_polygon = getenv ("ESPA_LAND_MASS_POLYGON");
+    if (opts.land_mass_polygon != NULL &&
+        ias_geo_is_packed_polygon_file (opts.land_mass_polygon) &&
+        ias_geo_keep_packed_polygon_resident (opts.land_mass_polygon)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Loading the land-mass polygon");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (socket_file);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Run the jobs.  The messages are written to the standard output, so
+       without a socket the results keep the standard output to themselves
+       and the messages are sent to the standard error. */
+    if (socket_file != NULL)
+        status = serve_socket (socket_file, &opts);
+    else
+    {
+        fflush (stdout);
+        results_fd = dup (STDOUT_FILENO);
+        if (results_fd >= 0)
+            results = fdopen (results_fd, "w");
+        if (results == NULL || dup2 (STDERR_FILENO, STDOUT_FILENO) < 0)
+        {
+            sprintf (errmsg, "Redirecting the standard output");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (socket_file);
+            exit (EXIT_FAILURE);
+        }
+        status = run_jobs (stdin, results, &opts);
+        fclose (results);
+    }
+
+    free (socket_file);
+    if (metrics_pid > 0)
+    {
+        kill (metrics_pid, SIGTERM);
+        waitpid (metrics_pid, NULL, 0);
+    }
+    free (opts.metrics_address);
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,421 @@
+/*****************************************************************************
+FILE: extract_espa_chips
+
+PURPOSE: Contains functions for extracting fixed-size multi-band chips of an
+ESPA raw binary product, for example as training samples.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include <ctype.h>
+#include "espa_chips.h"
+#include "convert_espa_to_zarr.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("extract_espa_chips extracts square chips of the specified bands "
+            "of the input XML file, centered on the pixels of the centers "
+            "file.  The pixels of the chips hold the values of all the "
+            "bands (band interleaved by pixel).  The chips are written one "
+            "after the other to a raw binary file, with a CSV index of the "
+            "chips next to it, or as a Zarr array of [chip, y, x, band].  "
+            "Chips which don't fit in the bands or have too much fill are "
+            "left out.\n\n");
+    printf ("usage: extract_espa_chips "
+            "--xml=input_metadata_filename "
+            "--band=band_name [--band=band_name ...] "
+            "--centers=centers_filename "
+            "--output=output_filename "
+            "[--format=raw|zarr] [--size=npixels] [--max_fill=fraction] "
+            "[--level=n]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file\n");
+    printf ("    -band: name of a band of the chips; multiple --band options "
+            "can be specified, and the bands are interleaved in that "
+            "order.  The bands have to have the same size and data type.\n");
+    printf ("    -centers: name of a file listing the chip centers as a "
+            "0-based line and sample per line, or - for the standard "
+            "input\n");
+    printf ("    -output: name of the output raw binary chip file, whose "
+            "index is written next to it with the .csv extension, or the "
+            "name of the output Zarr store directory\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -format: output format, a raw binary file (raw) or a Zarr "
+            "store (zarr) (default is raw)\n");
+    printf ("    -size: number of lines and samples in a chip, from 1 to %d "
+            "(default is %d)\n", CHIP_MAX_SIZE, CHIP_DEFAULT_SIZE);
+    printf ("    -max_fill: largest fraction of fill pixels of a chip which "
+            "is kept, from 0.0 to 1.0 (default is 1.0)\n");
+    printf ("    -level: zlib compression level of the Zarr chunks, from 0 "
+            "(stored) to 9 (default is %d)\n", ZARR_DEFLATE_LEVEL);
+    printf ("\nExample: extract_espa_chips "
+            "--xml=LE07_L1TP_022033_20140228_20161028_01_T1.xml "
+            "--band=sr_band3 --band=sr_band4 --band=sr_band5 "
+            "--centers=samples.txt --output=chips.zarr --format=zarr "
+            "--size=128 --max_fill=0.1\n");
+}
+
+
+/******************************************************************************
+MODULE:  read_centers
+
+PURPOSE: Reads the chip centers from the centers file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the centers file
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Each line holds the line and sample of a center, separated by
+     whitespace or a comma.  Blank lines and lines starting with # are
+     ignored.  The caller is responsible for freeing the centers.
+******************************************************************************/
+static int read_centers
+(
+    char *centers_file,   /* I: name of the centers file; "-" for the
+                                standard input */
+    int *ncenters,        /* O: number of chip centers */
+    Chip_center_t **centers  /* O: address of the chip centers */
+)
+{
+    char errmsg[STR_SIZE];                 /* error message */
+    char FUNC_NAME[] = "read_centers";     /* function name */
+    char *line = NULL;    /* current line of the centers file */
+    size_t line_size = 0; /* allocated size of line */
+    char *ptr = NULL;     /* start of the center in the line */
+    Chip_center_t *new_ptr = NULL;  /* reallocated list of centers */
+    int size = 0;         /* allocated number of centers */
+    int nline = 0;        /* line number in the centers file */
+    int status = SUCCESS; /* return status */
+    FILE *fptr = NULL;    /* centers file pointer */
+
+    *ncenters = 0;
+    *centers = NULL;
+    fptr = strcmp (centers_file, "-") ? fopen (centers_file, "r") : stdin;
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the centers file %s", centers_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (getline (&line, &line_size, fptr) != -1)
+    {
+        nline++;
+        ptr = line;
+        while (isspace ((unsigned char) *ptr))
+            ptr++;
+        if (*ptr == '\0' || *ptr == '#')
+            continue;
+
+        if (*ncenters == size)
+        {
+            size = (size > 0) ? size * 2 : 1024;
+            new_ptr = realloc (*centers, size * sizeof (Chip_center_t));
+            if (new_ptr == NULL)
+            {
+                sprintf (errmsg, "Allocating the chip centers");
+                error_handler (true, FUNC_NAME, errmsg);
+                status = ERROR;
+                break;
+            }
+            *centers = new_ptr;
+        }
+
+        if (sscanf (ptr, "%d%*[ \t,]%d", &(*centers)[*ncenters].line,
+            &(*centers)[*ncenters].samp) != 2)
+        {
+            sprintf (errmsg, "Line %d of the centers file %s isn't a line "
+                "and sample", nline, centers_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            status = ERROR;
+            break;
+        }
+        (*ncenters)++;
+    }
+    free (line);
+    if (fptr != stdin)
+        fclose (fptr);
+
+    if (status == SUCCESS && *ncenters == 0)
+    {
+        sprintf (errmsg, "The centers file %s has no chip centers",
+            centers_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        status = ERROR;
+    }
+
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input XML, centers file and output.  All of
+     these should be character pointers set to NULL on input.  The caller is
+     responsible for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of the input XML filename */
+    int *nbands,          /* O: number of bands of the chips */
+    char bands[][STR_SIZE], /* O: names of the bands of the chips */
+    char **centers_file,  /* O: address of the centers filename */
+    char **output,        /* O: address of the output filename */
+    Chip_options_t *opts  /* O: options of the extraction */
+)
+{
+    int c;                           /* current argument index */
+    int count;                       /* number of chars copied in snprintf */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"xml", required_argument, 0, 'i'},
+        {"band", required_argument, 0, 'b'},
+        {"centers", required_argument, 0, 'c'},
+        {"output", required_argument, 0, 'o'},
+        {"format", required_argument, 0, 'f'},
+        {"size", required_argument, 0, 's'},
+        {"max_fill", required_argument, 0, 'm'},
+        {"level", required_argument, 0, 'z'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* input XML file */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'b':  /* band name to be added */
+                count = snprintf (bands[*nbands], sizeof (bands[*nbands]),
+                    "%s", optarg);
+                if (count < 0 || count >= sizeof (bands[*nbands]))
+                {
+                    sprintf (errmsg, "Overflow of bands[*nbands] string");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+
+                (*nbands)++;
+                break;
+
+            case 'c':  /* centers file */
+                *centers_file = strdup (optarg);
+                break;
+
+            case 'o':  /* output */
+                *output = strdup (optarg);
+                break;
+
+            case 'f':  /* output format */
+                if (!strcmp (optarg, "raw"))
+                    opts->format = CHIP_RAW;
+                else if (!strcmp (optarg, "zarr"))
+                    opts->format = CHIP_ZARR;
+                else
+                {
+                    sprintf (errmsg, "Unknown format %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 's':  /* chip size */
+                opts->size = atoi (optarg);
+                break;
+
+            case 'm':  /* largest fill fraction */
+                opts->max_fill = atof (optarg);
+                break;
+
+            case 'z':  /* compression level */
+                opts->level = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the XML file, bands, centers and output were specified */
+    if (*xml_infile == NULL || *nbands == 0 || *centers_file == NULL ||
+        *output == NULL)
+    {
+        sprintf (errmsg, "The input XML file, bands, centers file and output "
+            "are required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the chip size, fill fraction and compression level are
+       valid */
+    if (opts->size < 1 || opts->size > CHIP_MAX_SIZE)
+    {
+        sprintf (errmsg, "Chip size must be from 1 to %d", CHIP_MAX_SIZE);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (opts->max_fill < 0.0 || opts->max_fill > 1.0)
+    {
+        sprintf (errmsg, "Largest fill fraction must be from 0.0 to 1.0");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (opts->level < 0 || opts->level > 9)
+    {
+        sprintf (errmsg, "Compression level must be from 0 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Extracts the chips of the bands of the input XML file centered on
+the pixels of the centers file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error extracting the chips
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";        /* function name */
+    char *xml_infile = NULL;          /* input XML filename */
+    char *centers_file = NULL;        /* file of the chip centers */
+    char *output = NULL;              /* output chip file or Zarr store */
+    char (*bands)[STR_SIZE] = NULL;   /* bands of the chips */
+    int nbands = 0;                   /* number of bands of the chips */
+    int ncenters = 0;                 /* number of chip centers */
+    int nchips = 0;                   /* number of chips written */
+    int status;                       /* return status of the extraction */
+    Chip_center_t *centers = NULL;    /* chip centers */
+    Chip_options_t opts;              /* options of the extraction */
+
+    /* Read the command-line arguments.  There can't be more bands than
+       arguments. */
+    bands = calloc (argc, sizeof (*bands));
+    if (bands == NULL)
+    {
+        error_handler (true, FUNC_NAME, "Allocating the list of bands");
+        exit (EXIT_FAILURE);
+    }
+    opts.format = CHIP_RAW;
+    opts.size = CHIP_DEFAULT_SIZE;
+    opts.max_fill = 1.0;
+    opts.level = ZARR_DEFLATE_LEVEL;
+    if (get_args (argc, argv, &xml_infile, &nbands, bands, &centers_file,
+        &output, &opts) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Extract the chips at the centers */
+    status = read_centers (centers_file, &ncenters, &centers);
+    if (status == SUCCESS)
+        status = extract_chips (xml_infile, nbands, bands, ncenters,
+            centers, output, &opts, &nchips);
+    if (status == SUCCESS)
+        printf ("Wrote %d of %d chips to %s\n", nchips, ncenters, output);
+
+    /* Free the pointers */
+    free (bands);
+    free (centers);
+    free (xml_infile);
+    free (centers_file);
+    free (output);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,242 @@
+/*****************************************************************************
+FILE: package_espa_product
+
+PURPOSE: Contains functions for packaging the files of an ESPA raw binary
+product as a tar archive for delivery.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. The XML metadata format parsed or written via this library follows the
+     ESPA internal metadata format found in ESPA Raw Binary Format v1.0.doc.
+     The schema for the ESPA internal metadata format is available at
+     http://espa.cr.usgs.gov/schema/espa_internal_metadata_v1_0.xsd.
+*****************************************************************************/
+#include <getopt.h>
+#include "espa_package.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("package_espa_product packages the input XML file, its band "
+            "files and their ENVI headers, and the valid mask of the scene "
+            "as a tar archive, optionally compressed with gzip.  The files "
+            "are copied into the archive without staging them.\n\n");
+    printf ("usage: package_espa_product "
+            "--xml=input_metadata_filename "
+            "--output=output_archive "
+            "[--gzip] [--level=n] [--prefix=directory]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file\n");
+    printf ("    -output: name of the output archive, or - for the standard "
+            "output\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -gzip: compress the archive with gzip, in parallel\n");
+    printf ("    -level: deflate level of the compressed archive, from 1 to "
+            "9 (default is %d)\n", PKG_GZIP_LEVEL);
+    printf ("    -prefix: directory the files are archived under (default "
+            "is none)\n");
+    printf ("\nExample: package_espa_product "
+            "--xml=LE07_L1TP_022033_20140228_20161028_01_T1.xml "
+            "--output=LE07_L1TP_022033_20140228_20161028_01_T1.tar.gz "
+            "--gzip\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input XML and output.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of the input XML filename */
+    char **output,        /* O: address of the output archive */
+    Pkg_options_t *opts   /* O: options of the package */
+)
+{
+    int c;                           /* current argument index */
+    int count;                       /* number of chars copied in snprintf */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int gzip_flag = 0;        /* flag to compress the archive */
+    static struct option long_options[] =
+    {
+        {"gzip", no_argument, &gzip_flag, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"output", required_argument, 0, 'o'},
+        {"level", required_argument, 0, 'z'},
+        {"prefix", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* input XML file */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 'o':  /* output archive */
+                *output = strdup (optarg);
+                break;
+
+            case 'z':  /* compression level */
+                opts->level = atoi (optarg);
+                break;
+
+            case 'p':  /* directory in the archive */
+                count = snprintf (opts->prefix, sizeof (opts->prefix), "%s",
+                    optarg);
+                if (count < 0 || count >= sizeof (opts->prefix))
+                {
+                    sprintf (errmsg, "Overflow of opts->prefix string");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+
+                /* Trailing slashes are added back when archiving */
+                while (count > 0 && opts->prefix[count-1] == '/')
+                    opts->prefix[--count] = '\0';
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the XML file and output were specified */
+    if (*xml_infile == NULL || *output == NULL)
+    {
+        sprintf (errmsg, "The input XML file and output archive are required "
+            "arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the compression level is valid */
+    if (opts->level < 1 || opts->level > 9)
+    {
+        sprintf (errmsg, "Compression level must be from 1 to 9");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (gzip_flag)
+        opts->compress = PKG_COMPRESS_GZIP;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Packages the files of the input XML file as a tar archive.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error packaging the product
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The summary is written to the standard error when the archive is
+     written to the standard output.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *xml_infile = NULL;          /* input XML filename */
+    char *output = NULL;              /* output archive */
+    int nfiles = 0;                   /* number of files archived */
+    int status;                       /* return status of the package */
+    Pkg_options_t opts;               /* options of the package */
+
+    /* Read the command-line arguments */
+    opts.compress = PKG_COMPRESS_NONE;
+    opts.level = PKG_GZIP_LEVEL;
+    opts.prefix[0] = '\0';
+    if (get_args (argc, argv, &xml_infile, &output, &opts) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Package the product */
+    status = package_espa_product (xml_infile, output, &opts, &nfiles);
+    if (status == SUCCESS)
+        fprintf (strcmp (output, "-") ? stdout : stderr,
+            "Packaged %d files into %s\n", nfiles, output);
+
+    /* Free the pointers */
+    free (xml_infile);
+    free (output);
+
+    if (status != SUCCESS)
+    {  /* Error messages already written */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,421 @@
+/*****************************************************************************
+FILE: query_espa_catalog
+
+PURPOSE: Lists the ESPA products in a catalog which match the query, or the
+lines and samples of a set of points in those products.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+  1. With --points, the points in the file are looked up in the matching
+     products instead (see espa_point_lookup.h).
+*****************************************************************************/
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "espa_catalog.h"
+#include "espa_point_lookup.h"
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("query_espa_catalog lists the XML files of the products in a "
+            "catalog built by build_espa_catalog which match all the "
+            "specified criteria, in order of acquisition date.\n\n");
+    printf ("usage: query_espa_catalog --catalog=catalog_filename "
+            "[--satellite=satellite] [--instrument=instrument] "
+            "[--start_date=yyyy-mm-dd] [--end_date=yyyy-mm-dd] "
+            "[--path=wrs_path] [--row=wrs_row] [--htile=htile] "
+            "[--vtile=vtile] [--product=band_product] "
+            "[--bbox=west,east,north,south] [--long] "
+            "[--points=points_filename]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -catalog: name of the catalog file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -satellite: satellite of the products (e.g. LANDSAT_8)\n");
+    printf ("    -instrument: instrument of the products (e.g. OLI_TIRS)\n");
+    printf ("    -start_date: first acquisition date of the products\n");
+    printf ("    -end_date: last acquisition date of the products\n");
+    printf ("    -path, -row: WRS path and row of the products\n");
+    printf ("    -htile, -vtile: MODIS tile of the products\n");
+    printf ("    -product: product of at least one band of the products "
+            "(e.g. sr_refl)\n");
+    printf ("    -bbox: geographic bounding box, in degrees, which the "
+            "bounding coordinates of the products have to overlap\n");
+    printf ("    -long: also list the product ID, acquisition date, "
+            "path/row or tile, and number of bands\n");
+    printf ("    -points: file of geographic points, one lat,lon pair in "
+            "degrees per line; rather than the products, list the line and "
+            "sample of each point in each matching product covering it, as "
+            "the point number (from 0), XML file, line and sample\n");
+    printf ("\nExample: query_espa_catalog --catalog=archive.espacat "
+            "--satellite=LANDSAT_8 --path=47 --row=27 "
+            "--start_date=2013-06-01 --end_date=2013-09-30\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The query strings and the points filename point to the command-line
+     arguments.  Memory is allocated for the catalog file, which the caller
+     is responsible for freeing upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,                     /* I: number of cmd-line args */
+    char *argv[],                 /* I: string of cmd-line args */
+    char **catalog_file,          /* O: address of the catalog filename */
+    Espa_catalog_query_t *query,  /* O: query; initialized via
+                                        init_catalog_query */
+    bool *long_list,              /* O: list the scene details */
+    char **points_file            /* O: address of the points filename; NULL
+                                        to list the products */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static int long_flag = 0;        /* flag for the long listing */
+    static struct option long_options[] =
+    {
+        {"long", no_argument, &long_flag, 1},
+        {"catalog", required_argument, 0, 'c'},
+        {"satellite", required_argument, 0, 's'},
+        {"instrument", required_argument, 0, 'i'},
+        {"start_date", required_argument, 0, 'b'},
+        {"end_date", required_argument, 0, 'e'},
+        {"path", required_argument, 0, 'p'},
+        {"row", required_argument, 0, 'r'},
+        {"htile", required_argument, 0, 'x'},
+        {"vtile", required_argument, 0, 'y'},
+        {"product", required_argument, 0, 'd'},
+        {"bbox", required_argument, 0, 'g'},
+        {"points", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'c':  /* catalog file */
+                *catalog_file = strdup (optarg);
+                break;
+
+            case 's':  /* satellite */
+                query->satellite = optarg;
+                break;
+
+            case 'i':  /* instrument */
+                query->instrument = optarg;
+                break;
+
+            case 'b':  /* first acquisition date */
+                query->start_date = optarg;
+                break;
+
+            case 'e':  /* last acquisition date */
+                query->end_date = optarg;
+                break;
+
+            case 'p':  /* WRS path */
+                query->wrs_path = atoi (optarg);
+                break;
+
+            case 'r':  /* WRS row */
+                query->wrs_row = atoi (optarg);
+                break;
+
+            case 'x':  /* MODIS htile */
+                query->htile = atoi (optarg);
+                break;
+
+            case 'y':  /* MODIS vtile */
+                query->vtile = atoi (optarg);
+                break;
+
+            case 'd':  /* band product */
+                query->product = optarg;
+                break;
+
+            case 'g':  /* bounding box */
+                if (sscanf (optarg, "%lf,%lf,%lf,%lf", &query->bbox[0],
+                    &query->bbox[1], &query->bbox[2], &query->bbox[3]) != 4
+                    || query->bbox[0] > query->bbox[1] ||
+                    query->bbox[3] > query->bbox[2])
+                {
+                    sprintf (errmsg, "Invalid bounding box %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                query->use_bbox = true;
+                break;
+
+            case 't':  /* points file */
+                *points_file = optarg;
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the catalog file was specified */
+    if (*catalog_file == NULL)
+    {
+        sprintf (errmsg, "Catalog file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    *long_list = (long_flag != 0);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_points
+
+PURPOSE: Reads the geographic points to be looked up from a file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the file or a line isn't a lat,lon pair
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Blank lines are skipped.  Memory is allocated for the points, which
+     the caller is responsible for freeing upon successful return.
+******************************************************************************/
+int read_points
+(
+    char *points_file,            /* I: name of the points file */
+    Espa_point_t **points,        /* O: points read */
+    int *npoints                  /* O: number of points read */
+)
+{
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "read_points";  /* function name */
+    char line[STR_SIZE];             /* line of the file */
+    FILE *fp = NULL;                 /* points file */
+    Espa_point_t point;              /* point of the line */
+    Espa_point_t *new_points;        /* reallocated points */
+    int max_points = 0;              /* number of points allocated */
+    int line_num = 0;                /* line number in the file */
+
+    *points = NULL;
+    *npoints = 0;
+    fp = fopen (points_file, "r");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the points file %s", points_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        line_num++;
+        if (strspn (line, " \t\r\n") == strlen (line))
+            continue;
+        if (sscanf (line, "%lf,%lf", &point.lat, &point.lon) != 2 ||
+            fabs (point.lat) > 90.0 || fabs (point.lon) > 180.0)
+        {
+            sprintf (errmsg, "Invalid lat,lon pair on line %d of %s",
+                line_num, points_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fp);
+            free (*points);
+            *points = NULL;
+            return (ERROR);
+        }
+
+        if (*npoints == max_points)
+        {
+            max_points = (max_points == 0) ? 1024 : 2 * max_points;
+            new_points = realloc (*points,
+                max_points * sizeof (Espa_point_t));
+            if (new_points == NULL)
+            {
+                sprintf (errmsg, "Allocating %d points", max_points);
+                error_handler (true, FUNC_NAME, errmsg);
+                fclose (fp);
+                free (*points);
+                *points = NULL;
+                return (ERROR);
+            }
+            *points = new_points;
+        }
+        (*points)[(*npoints)++] = point;
+    }
+
+    fclose (fp);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Lists the products in the catalog which match the query.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or querying the catalog
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *catalog_file = NULL;     /* catalog filename */
+    Espa_catalog_query_t query;    /* products to be listed */
+    Espa_catalog_t catalog;        /* opened catalog */
+    const Espa_catalog_scene_t *scene = NULL;  /* matching scene */
+    bool long_list = false;        /* list the scene details */
+    char *points_file = NULL;      /* points filename */
+    Espa_point_t *points = NULL;   /* points to be looked up */
+    int npoints = 0;               /* number of points */
+    Espa_point_match_t *matches = NULL;  /* locations of the points */
+    int nmatches = 0;              /* number of locations */
+    int status = SUCCESS;          /* return status */
+    int *scenes = NULL;            /* matching scenes */
+    int nscenes = 0;               /* number of matching scenes */
+    int i;                         /* looping variable */
+
+    /* Read the command-line arguments */
+    init_catalog_query (&query);
+    if (get_args (argc, argv, &catalog_file, &query, &long_list,
+        &points_file) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Open and query the catalog */
+    if (open_espa_catalog (catalog_file, &catalog) != SUCCESS)
+    {  /* Error messages already written */
+        exit (ERROR);
+    }
+
+    /* Look the points up in the matching products */
+    if (points_file != NULL)
+    {
+        if (read_points (points_file, &points, &npoints) != SUCCESS ||
+            lookup_catalog_points (&catalog, &query, npoints, points,
+                &matches, &nmatches) != SUCCESS)
+        {  /* Error messages already written */
+            status = ERROR;
+        }
+
+        for (i = 0; i < nmatches; i++)
+        {
+            if (!matches[i].in_bounds)
+                continue;
+            printf ("%d %s %d %d\n", matches[i].point,
+                get_catalog_xml_file (&catalog, matches[i].scene),
+                (int) matches[i].line, (int) matches[i].samp);
+        }
+
+        free (matches);
+        free (points);
+        close_espa_catalog (&catalog);
+        free (catalog_file);
+        exit (status);
+    }
+
+    if (query_espa_catalog (&catalog, &query, &scenes, &nscenes) != SUCCESS)
+    {  /* Error messages already written */
+        close_espa_catalog (&catalog);
+        exit (ERROR);
+    }
+
+    /* List the matching products */
+    for (i = 0; i < nscenes; i++)
+    {
+        scene = &catalog.scene[scenes[i]];
+        if (!long_list)
+        {
+            printf ("%s\n", get_catalog_xml_file (&catalog, scenes[i]));
+            continue;
+        }
+
+        printf ("%s %s %s ", get_catalog_xml_file (&catalog, scenes[i]),
+            scene->product_id, scene->acquisition_date);
+        if (scene->wrs_path != ESPA_INT_META_FILL)
+            printf ("p%03dr%03d ", scene->wrs_path, scene->wrs_row);
+        else if (scene->htile != ESPA_INT_META_FILL)
+            printf ("h%02dv%02d ", scene->htile, scene->vtile);
+        printf ("%d bands\n", scene->nbands);
+    }
+
+    /* Free the pointers */
+    free (scenes);
+    close_espa_catalog (&catalog);
+    free (catalog_file);
+
+    /* Successful completion */
+    exit (SUCCESS);
+}
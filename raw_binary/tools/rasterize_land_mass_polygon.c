@@ -0,0 +1,248 @@
+/*****************************************************************************
+FILE: rasterize_land_mass_polygon
+
+PURPOSE: Rasterizes a land-mass polygon file into a global land/water raster
+pyramid, which the land/water mask code looks the mask pixels up in instead
+of testing them against the polygon.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "generate_land_water_mask.h"
+
+/* Defaults for the raster layout: 1 arc-second cells, 4 levels, tiles of
+   2048 x 2048 cells */
+#define DEFAULT_CELLS_PER_DEGREE 3600
+#define DEFAULT_LEVELS 4
+#define DEFAULT_TILE_SIZE 2048
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("rasterize_land_mass_polygon rasterizes a land-mass polygon file "
+            "into a global land/water raster.  The raster holds several "
+            "levels, each with half the resolution of the one before, split "
+            "into tiles; tiles which are all land or all water take no "
+            "space.  When the ESPA_LAND_WATER_RASTER environment variable "
+            "names the raster, the land/water mask applications look the "
+            "mask up in the raster for the grids it is fine enough for.\n\n");
+    printf ("usage: rasterize_land_mass_polygon "
+            "--input=input_polygon_filename "
+            "--output=output_raster_filename "
+            "[--cells_per_degree=n] [--levels=n] [--tile_size=n]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -input: name of the input land-mass polygon file (or the "
+            "packed polygon file)\n");
+    printf ("    -output: name of the output land/water raster file\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -cells_per_degree: cells per degree of the finest level; "
+            "must be divisible by 2^(levels-1) (default is %d)\n",
+            DEFAULT_CELLS_PER_DEGREE);
+    printf ("    -levels: number of levels, 1 to %d (default is %d)\n",
+            LW_RASTER_MAX_LEVELS, DEFAULT_LEVELS);
+    printf ("    -tile_size: cells along each side of a tile; a multiple of "
+            "8 (default is %d)\n", DEFAULT_TILE_SIZE);
+    printf ("\nExample: rasterize_land_mass_polygon "
+            "--input=land_no_buf.pply "
+            "--output=land_no_buf.lwr\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **infile,        /* O: address of input polygon filename */
+    char **outfile,       /* O: address of output raster filename */
+    int *cells_per_degree,  /* O: cells per degree of the finest level */
+    int *nlevels,         /* O: number of levels */
+    int *tile_size        /* O: cells along each side of a tile */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"input", required_argument, 0, 'i'},
+        {"output", required_argument, 0, 'o'},
+        {"cells_per_degree", required_argument, 0, 'c'},
+        {"levels", required_argument, 0, 'l'},
+        {"tile_size", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Set the defaults */
+    *cells_per_degree = DEFAULT_CELLS_PER_DEGREE;
+    *nlevels = DEFAULT_LEVELS;
+    *tile_size = DEFAULT_TILE_SIZE;
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* polygon infile */
+                *infile = strdup (optarg);
+                break;
+
+            case 'o':  /* raster outfile */
+                *outfile = strdup (optarg);
+                break;
+
+            case 'c':  /* cells per degree */
+                *cells_per_degree = atoi (optarg);
+                break;
+
+            case 'l':  /* number of levels */
+                *nlevels = atoi (optarg);
+                break;
+
+            case 't':  /* tile size */
+                *tile_size = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the infiles and outfiles were specified */
+    if (*infile == NULL)
+    {
+        sprintf (errmsg, "Input polygon file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    if (*outfile == NULL)
+    {
+        sprintf (errmsg, "Output raster file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Rasterizes the land-mass polygon file into the land/water raster
+file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error doing the rasterization
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The raster file is in the native byte order of the system which created
+     it, the same as the land-mass polygon file.
+  2. The tiles are rasterized in parallel; ESPA_TASK_THREADS limits the
+     number of threads used.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "rasterize_land_mass_polygon";  /* function name */
+    char errmsg[STR_SIZE];        /* error message */
+    char *infile = NULL;          /* input polygon filename */
+    char *outfile = NULL;         /* output raster filename */
+    int cells_per_degree;         /* cells per degree of the finest level */
+    int nlevels;                  /* number of levels */
+    int tile_size;                /* cells along each side of a tile */
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &infile, &outfile, &cells_per_degree, &nlevels,
+        &tile_size) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (EXIT_FAILURE);
+    }
+
+    /* Rasterize the polygons and write the raster file */
+    if (write_land_water_raster (infile, outfile, cells_per_degree, nlevels,
+        tile_size) != SUCCESS)
+    {
+        sprintf (errmsg, "Rasterizing %s to the land/water raster %s", infile,
+            outfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (EXIT_FAILURE);
+    }
+
+    /* Free the pointers */
+    free (infile);
+    free (outfile);
+
+    /* Successful completion */
+    exit (EXIT_SUCCESS);
+}
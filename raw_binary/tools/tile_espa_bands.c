@@ -0,0 +1,338 @@
+/*****************************************************************************
+FILE: tile_espa_bands
+  
+PURPOSE: Converts the bands of an ESPA product to the internally tiled raw
+binary layout, or back to line-major order.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "error_handler.h"
+#include "parse_metadata.h"
+#include "write_metadata.h"
+#include "raw_binary_tiled.h"
+#include "espa_batch.h"
+
+/* Options of a tiling run */
+typedef struct
+{
+    int tile_size;        /* number of lines and samples in a tile; 0 to
+                             convert the bands back to line-major order */
+} Tiling_opts_t;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("tile_espa_bands rewrites each band in the XML file in square "
+            "tiles, so windows of the bands are read a few tiles at a time "
+            "rather than a line at a time. The tile size is recorded in the "
+            "band metadata. Tiled bands are read transparently as line-major "
+            "data by the ESPA tools and the format converters. --untile "
+            "converts tiled bands back to line-major order for readers of "
+            "the band files themselves. Constant and derived bands aren't "
+            "stored, so they are left as they are.\n\n");
+    printf ("usage: tile_espa_bands --xml=input_metadata_filename "
+            "[--tile_size=npixels] [--untile]\n");
+    printf ("       tile_espa_bands --scene_list=scene_list_filename "
+            "[--procs=nprocs] [--tile_size=npixels] [--untile]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -xml: name of the input XML metadata file which follows "
+            "the ESPA internal raw binary schema\n");
+    printf ("    -scene_list: instead of -xml, name of a file listing the "
+            "XML files to be processed, one per line, or - for the standard "
+            "input\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -tile_size: number of lines and samples in a tile "
+            "(default is %d)\n", RB_TILED_DEFAULT_SIZE);
+    printf ("    -untile: convert tiled bands back to line-major order\n");
+    printf ("    -procs: number of scenes in the scene list processed "
+            "concurrently, from 1 to %d (default is 1)\n",
+            ESPA_BATCH_MAX_PROCS);
+    printf ("\nExample: tile_espa_bands "
+            "--xml=LC80470272013287LGN00.xml --tile_size=512\n");
+    printf ("Example: tile_espa_bands --scene_list=scenes.txt "
+            "--procs=8 --untile\n");
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the input and output files.  All of these should
+     be character pointers set to NULL on input.  The caller is responsible
+     for freeing the allocated memory upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,             /* I: number of cmd-line args */
+    char *argv[],         /* I: string of cmd-line args */
+    char **xml_infile,    /* O: address of input XML filename */
+    Tiling_opts_t *opts,  /* O: tiling options */
+    char **scene_list,    /* O: address of the scene list filename */
+    int *nprocs           /* O: number of scenes processed concurrently */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    static int untile = 0;           /* flag for untiling the bands */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    static struct option long_options[] =
+    {
+        {"untile", no_argument, &untile, 1},
+        {"xml", required_argument, 0, 'i'},
+        {"tile_size", required_argument, 0, 't'},
+        {"scene_list", required_argument, 0, 'L'},
+        {"procs", required_argument, 0, 'P'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'i':  /* XML infile */
+                *xml_infile = strdup (optarg);
+                break;
+
+            case 't':  /* tile size */
+                opts->tile_size = atoi (optarg);
+                break;
+
+            case 'L':  /* scene list */
+                *scene_list = strdup (optarg);
+                break;
+
+            case 'P':  /* number of scenes processed concurrently */
+                *nprocs = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure either the XML input file or the scene list was specified */
+    if ((*xml_infile == NULL) == (*scene_list == NULL))
+    {
+        sprintf (errmsg, "Either the XML input file or the scene list is a "
+            "required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of concurrent scenes is valid */
+    if (*nprocs < 1 || *nprocs > ESPA_BATCH_MAX_PROCS)
+    {
+        sprintf (errmsg, "Number of concurrent scenes must be from 1 to %d",
+            ESPA_BATCH_MAX_PROCS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the tile size is valid */
+    if (opts->tile_size < 1)
+    {
+        sprintf (errmsg, "Tile size must be at least 1");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+    if (untile)
+        opts->tile_size = 0;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  process_scene
+
+PURPOSE: Converts the layout of the bands in one XML file, and updates the
+tiling of the bands in the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bands
+SUCCESS         No errors encountered
+
+NOTES:
+  1. This is the Espa_batch_func_t of this application.
+  2. Bands which already have the requested layout are left as they are.
+     The XML file is rewritten after each converted band, so it always
+     matches the band files.
+******************************************************************************/
+static int process_scene
+(
+    char *espa_xml_file,  /* I: input ESPA XML metadata filename */
+    char *output,         /* I: not used */
+    void *arg             /* I: tiling options (Tiling_opts_t *) */
+)
+{
+    Tiling_opts_t *opts = arg;         /* tiling options */
+    int i;                             /* looping variable for the bands */
+    int status = SUCCESS;              /* return status */
+    Espa_band_meta_t *bmeta = NULL;    /* current band */
+    Espa_internal_meta_t xml_metadata; /* XML metadata structure to be populated
+                                          by reading the XML metadata file */
+
+    /* Validate the input metadata file */
+    if (validate_xml_file (espa_xml_file) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Initialize the metadata structure */
+    init_metadata_struct (&xml_metadata);
+
+    /* Parse the metadata file into our internal metadata structure; also
+       allocates space as needed for various pointers in the global and band
+       metadata */
+    if (parse_metadata (espa_xml_file, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        free_metadata (&xml_metadata);
+        return (ERROR);
+    }
+
+    for (i = 0; i < xml_metadata.nbands && status == SUCCESS; i++)
+    {
+        bmeta = &xml_metadata.band[i];
+        if (bmeta->constant.is_constant || bmeta->derived.is_derived)
+            continue;
+
+        /* Convert the band if its layout differs */
+        if (opts->tile_size == 0)
+        {
+            if (!bmeta->tiling.is_tiled)
+                continue;
+            status = write_raw_binary_untiled (bmeta);
+        }
+        else
+        {
+            if (bmeta->tiling.is_tiled &&
+                bmeta->tiling.nlines == opts->tile_size &&
+                bmeta->tiling.nsamps == opts->tile_size)
+                continue;
+            status = write_raw_binary_tiled (bmeta, opts->tile_size,
+                opts->tile_size);
+        }
+
+        if (status == SUCCESS)
+            status = write_metadata (&xml_metadata, espa_xml_file);
+    }
+
+    /* Free the XML metadata */
+    free_metadata (&xml_metadata);
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Converts the layout of the bands in the XML file, or in each XML
+file of the scene list.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error converting the bands
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char *espa_xml_file = NULL;  /* input ESPA XML metadata filename */
+    char *scene_list = NULL;     /* list of XML files to be processed */
+    int nprocs = 1;              /* number of scenes processed concurrently */
+    int status;                  /* status of processing the scenes */
+    Tiling_opts_t opts;          /* tiling options */
+
+    /* Read the command-line arguments */
+    opts.tile_size = RB_TILED_DEFAULT_SIZE;
+    if (get_args (argc, argv, &espa_xml_file, &opts, &scene_list,
+        &nprocs) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    if (scene_list != NULL)
+    {
+        /* Compile the schema once for all the scenes, then process them */
+        status = load_espa_schema (NULL);
+        if (status == SUCCESS)
+            status = run_espa_batch (scene_list, nprocs, process_scene,
+                &opts);
+    }
+    else
+        status = process_scene (espa_xml_file, NULL, &opts);
+
+    /* Free the pointers */
+    free (espa_xml_file);
+    free (scene_list);
+
+    exit (status);
+}
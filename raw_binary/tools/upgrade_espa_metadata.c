@@ -0,0 +1,513 @@
+/*****************************************************************************
+FILE: upgrade_espa_metadata
+
+PURPOSE: Upgrades ESPA XML metadata files, or the XML files of directory
+trees, to a newer version of the ESPA internal metadata schema.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+*****************************************************************************/
+#define _XOPEN_SOURCE 700
+#include <getopt.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "error_handler.h"
+#include "espa_metadata.h"
+#include "espa_task.h"
+#include "upgrade_metadata.h"
+
+/* XML files gathered from the command line and directories, with the names
+   they are upgraded to */
+typedef struct
+{
+    char **in_name;       /* names of the XML files */
+    char **out_name;      /* names of the upgraded XML files */
+    int count;            /* number of XML files */
+    int size;             /* allocated size of in_name and out_name */
+} Upgrade_file_list_t;
+
+/* List being filled by the directory walk, the output directory and the
+   length of the directory being walked; nftw has no user argument */
+static Upgrade_file_list_t *walk_list = NULL;
+static const char *walk_outdir = NULL;
+static size_t walk_root_len = 0;
+
+/******************************************************************************
+MODULE: usage
+
+PURPOSE: Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("upgrade_espa_metadata upgrades ESPA XML metadata files to a "
+            "newer version of the ESPA internal metadata schema.  Each file "
+            "is upgraded in one streaming pass, and the files are upgraded "
+            "in parallel.  Files already at the version are copied as they "
+            "are, or left alone when upgraded in place.\n\n");
+    printf ("usage: upgrade_espa_metadata "
+            "[--version=schema_version] [--output=output_directory] "
+            "[--threads=nthreads] [--validate] xml_file_or_directory ...\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    xml_file_or_directory: XML files to be upgraded; "
+            "directories are searched recursively for .xml files\n");
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -version: schema version to upgrade to (default is %s)\n",
+            ESPA_SCHEMA_VERSION);
+    printf ("    -output: directory the upgraded XML files are written to, "
+            "keeping the layout of the directories searched (default is to "
+            "upgrade the XML files in place)\n");
+    printf ("    -threads: number of threads upgrading the XML files, from 1 "
+            "to %d (default is the number of processors)\n",
+            UPGRADE_MAX_THREADS);
+    printf ("    -validate: validate the upgraded XML files against the "
+            "schema; only for version %s\n", ESPA_SCHEMA_VERSION);
+    printf ("\nExample: upgrade_espa_metadata --version=2.0 "
+            "--output=/data/espa_v2 /data/espa\n");
+}
+
+
+/******************************************************************************
+MODULE:  make_parent_dirs
+
+PURPOSE:  Creates the missing directories of the name of a file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating a directory
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int make_parent_dirs
+(
+    const char *file_name   /* I: name of the file */
+)
+{
+    char FUNC_NAME[] = "make_parent_dirs";   /* function name */
+    char errmsg[STR_SIZE];                   /* error message */
+    char dir[PATH_MAX];                      /* directory being created */
+    char *slash;                             /* end of the directory */
+
+    snprintf (dir, sizeof (dir), "%s", file_name);
+    for (slash = strchr (dir + 1, '/'); slash != NULL;
+        slash = strchr (slash + 1, '/'))
+    {
+        *slash = '\0';
+        if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+        {
+            snprintf (errmsg, sizeof (errmsg), "Creating the directory %s",
+                dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        *slash = '/';
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  add_xml_file
+
+PURPOSE:  Adds an XML file to the list, with the name it is upgraded to.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the list or creating the output
+                directory
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The upgraded name is the XML file itself without an output directory.
+     Otherwise it's the relative name in the output directory.
+******************************************************************************/
+static int add_xml_file
+(
+    Upgrade_file_list_t *list,  /* I/O: list of XML files */
+    const char *xml_file,   /* I: name of the XML file */
+    const char *outdir,     /* I: output directory; NULL to upgrade in
+                                  place */
+    const char *rel_name    /* I: name of the XML file relative to the
+                                  output directory */
+)
+{
+    char FUNC_NAME[] = "add_xml_file";   /* function name */
+    char errmsg[STR_SIZE];               /* error message */
+    char out_name[PATH_MAX];             /* name of the upgraded XML file */
+    char **name = NULL;                  /* reallocated list */
+    int count;                           /* number of chars copied */
+
+    if (outdir == NULL)
+        count = snprintf (out_name, sizeof (out_name), "%s", xml_file);
+    else
+        count = snprintf (out_name, sizeof (out_name), "%s/%s", outdir,
+            rel_name);
+    if (count < 0 || count >= sizeof (out_name))
+    {
+        sprintf (errmsg, "Overflow of out_name string");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (outdir != NULL && make_parent_dirs (out_name) != SUCCESS)
+        return (ERROR);
+
+    if (list->count == list->size)
+    {
+        list->size = (list->size > 0) ? list->size * 2 : 1024;
+        name = realloc (list->in_name, list->size * sizeof (char *));
+        if (name != NULL)
+        {
+            list->in_name = name;
+            name = realloc (list->out_name, list->size * sizeof (char *));
+            if (name != NULL)
+                list->out_name = name;
+        }
+        if (name == NULL)
+        {
+            sprintf (errmsg, "Allocating the list of XML files");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    list->in_name[list->count] = strdup (xml_file);
+    list->out_name[list->count] = strdup (out_name);
+    if (list->in_name[list->count] == NULL ||
+        list->out_name[list->count] == NULL)
+    {
+        free (list->in_name[list->count]);
+        free (list->out_name[list->count]);
+        sprintf (errmsg, "Allocating the list of XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    list->count++;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  walk_xml_file
+
+PURPOSE:  nftw callback adding the .xml files found in a directory.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+0               Continue the walk
+1               Error adding the file; stop the walk
+
+NOTES:
+******************************************************************************/
+static int walk_xml_file
+(
+    const char *path,            /* I: name of the file */
+    const struct stat *sb,       /* I: status of the file */
+    int typeflag,                /* I: type of the file */
+    struct FTW *ftwbuf           /* I: position in the walk */
+)
+{
+    size_t len = strlen (path);  /* length of the name */
+    const char *rel_name = path + walk_root_len;  /* name in the directory */
+
+    while (*rel_name == '/')
+        rel_name++;
+    if (typeflag == FTW_F && len > 4 && !strcmp (path + len - 4, ".xml"))
+    {
+        if (add_xml_file (walk_list, path, walk_outdir, rel_name) != SUCCESS)
+            return (1);
+    }
+
+    return (0);
+}
+
+
+/******************************************************************************
+MODULE:  get_args
+
+PURPOSE:  Gets the command-line arguments and validates that the required
+arguments were specified.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the command-line arguments or a command-line
+                argument and associated value were not specified
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Memory is allocated for the version, output directory and the list of
+     XML files.  The caller is responsible for freeing the allocated memory
+     upon successful return.
+******************************************************************************/
+short get_args
+(
+    int argc,               /* I: number of cmd-line args */
+    char *argv[],           /* I: string of cmd-line args */
+    char **version,         /* O: schema version to upgrade to */
+    char **outdir,          /* O: output directory; NULL for in place */
+    Upgrade_file_list_t *list,  /* O: XML files to be upgraded */
+    int *nthreads,          /* O: number of upgrading threads */
+    bool *validate          /* O: validate the upgraded XML files? */
+)
+{
+    int c;                           /* current argument index */
+    int option_index;                /* index for the command-line option */
+    char errmsg[STR_SIZE];           /* error message */
+    char FUNC_NAME[] = "get_args";   /* function name */
+    const char *base_name;           /* name of an XML file without its
+                                        directory */
+    struct stat arg_stat;            /* status of an XML file or directory */
+    static int validate_flag = 0;    /* flag to validate the XML files */
+    static struct option long_options[] =
+    {
+        {"validate", no_argument, &validate_flag, 1},
+        {"version", required_argument, 0, 'v'},
+        {"output", required_argument, 0, 'o'},
+        {"threads", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        /* optstring in call to getopt_long is empty since we will only
+           support the long options */
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                usage ();
+                return (ERROR);
+                break;
+
+            case 'v':  /* schema version */
+                free (*version);
+                *version = strdup (optarg);
+                break;
+
+            case 'o':  /* output directory */
+                *outdir = strdup (optarg);
+                break;
+
+            case 't':  /* number of threads */
+                *nthreads = atoi (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                return (ERROR);
+                break;
+        }
+    }
+
+    /* Make sure the schema version is known */
+    if (!is_espa_schema_version (*version))
+    {
+        sprintf (errmsg, "Unknown schema version %s", *version);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the upgraded XML files can be validated */
+    *validate = validate_flag;
+    if (*validate && strcmp (*version, ESPA_SCHEMA_VERSION))
+    {
+        sprintf (errmsg, "Only XML files upgraded to %s can be validated",
+            ESPA_SCHEMA_VERSION);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure the number of threads is valid */
+    if (*nthreads < 1 || *nthreads > UPGRADE_MAX_THREADS)
+    {
+        sprintf (errmsg, "Number of threads must be from 1 to %d",
+            UPGRADE_MAX_THREADS);
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Make sure XML files were specified */
+    if (optind >= argc)
+    {
+        sprintf (errmsg, "XML files or directories are required arguments");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* Add the XML files and search the directories.  The XML files named
+       on the command line are upgraded to the top of the output
+       directory. */
+    walk_list = list;
+    walk_outdir = *outdir;
+    for (; optind < argc; optind++)
+    {
+        if (stat (argv[optind], &arg_stat) == 0 && S_ISDIR (arg_stat.st_mode))
+        {
+            walk_root_len = strlen (argv[optind]);
+            if (nftw (argv[optind], walk_xml_file, 32, FTW_PHYS) != 0)
+            {
+                sprintf (errmsg, "Searching %s for XML files", argv[optind]);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+        else
+        {
+            base_name = strrchr (argv[optind], '/');
+            base_name = (base_name != NULL) ? base_name + 1 : argv[optind];
+            if (add_xml_file (list, argv[optind], *outdir, base_name)
+                != SUCCESS)
+                return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE: Upgrades the XML files to the schema version.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error upgrading the XML files, or some of them failed to be
+                upgraded or validated
+SUCCESS         No errors encountered
+
+NOTES:
+  1. Only the XML files which were upgraded or copied are validated.
+******************************************************************************/
+int main (int argc, char** argv)
+{
+    char FUNC_NAME[] = "main";     /* function name */
+    char errmsg[STR_SIZE];         /* error message */
+    char *version = NULL;          /* schema version to upgrade to */
+    char *outdir = NULL;           /* output directory */
+    Upgrade_file_list_t list = {NULL, NULL, 0, 0};  /* XML files */
+    char **valid_name = NULL;      /* upgraded XML files to be validated */
+    Upgrade_counts_t counts;       /* what the upgrade did */
+    bool validate = false;         /* validate the upgraded XML files? */
+    int *file_status = NULL;       /* status of the upgrade of each file */
+    int nthreads;                  /* number of upgrading threads */
+    int nvalid = 0;                /* number of XML files validated */
+    int ninvalid = 0;              /* number of XML files failing to
+                                      validate */
+    int status;                    /* status of the upgrade */
+    int i;                         /* looping variable */
+
+    nthreads = espa_task_nthreads ();
+    if (nthreads > UPGRADE_MAX_THREADS)
+        nthreads = UPGRADE_MAX_THREADS;
+    version = strdup (ESPA_SCHEMA_VERSION);
+
+    /* Read the command-line arguments */
+    if (get_args (argc, argv, &version, &outdir, &list, &nthreads,
+        &validate) != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* Upgrade the XML files */
+    file_status = calloc (list.count + 1, sizeof (int));
+    valid_name = calloc (list.count + 1, sizeof (char *));
+    if (file_status == NULL || valid_name == NULL)
+    {
+        sprintf (errmsg, "Allocating the status of the XML files");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    status = upgrade_metadata_files (list.count, list.in_name, list.out_name,
+        version, nthreads, file_status, &counts);
+    if (status == SUCCESS)
+    {
+        printf ("%d XML files upgraded to %s (%d already at the version, "
+            "%d failed)\n", counts.nupgraded, version, counts.ncurrent,
+            counts.nfailed);
+        if (counts.nfailed > 0)
+            status = ERROR;
+    }
+
+    /* Validate the upgraded XML files, sharing the compiled schema */
+    if (validate && status == SUCCESS)
+    {
+        for (i = 0; i < list.count; i++)
+        {
+            if (file_status[i] == SUCCESS)
+                valid_name[nvalid++] = list.out_name[i];
+        }
+        status = validate_xml_files (nvalid, valid_name, nthreads, NULL,
+            &ninvalid);
+        if (status == SUCCESS)
+        {
+            printf ("%d of %d upgraded XML files fail to validate\n",
+                ninvalid, nvalid);
+            if (ninvalid > 0)
+                status = ERROR;
+        }
+    }
+
+    /* Free the pointers */
+    for (i = 0; i < list.count; i++)
+    {
+        free (list.in_name[i]);
+        free (list.out_name[i]);
+    }
+    free (list.in_name);
+    free (list.out_name);
+    free (file_status);
+    free (valid_name);
+    free (version);
+    free (outdir);
+    cleanup_espa_xml ();
+
+    exit (status);
+}